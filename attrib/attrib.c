@@ -35,10 +35,11 @@ CHAR strAttribHelpText[] =
         "\n"
         "Display or manipulate file attributes.\n"
         "\n"
-        "ATTRIB [/license] [+Attrs] [-Attrs] [/b] [/d] [/s] [/v] [<file>...]\n"
+        "ATTRIB [/license] [+Attrs] [-Attrs] [/b] [/d] [/j <n>] [/s] [/v] [<file>...]\n"
         "\n"
         "   /b             Use basic search criteria for files only\n"
         "   /d             Include directories as well as files\n"
+        "   /j             Update the specified number of files concurrently\n"
         "   /s             Process files from all subdirectories\n"
         "   /v             Verbose output\n"
         "\n";
@@ -161,6 +162,12 @@ typedef struct _ATTRIB_CONTEXT {
      */
     YORI_STRING UnescapedPath;
 
+    /**
+     If files are being updated concurrently, points to the pool of threads
+     performing the updates.  NULL if files are updated as they are found.
+     */
+    PYORILIB_FILE_UPDATE_QUEUE UpdateQueue;
+
     /**
      Records the total number of files processed within a single command line
      argument.
@@ -210,6 +217,13 @@ AttribFileFoundCallback(
 
     AttribContext->FilesFoundThisArg++;
 
+    if (AttribContext->UpdateQueue != NULL) {
+        YoriLibFileUpdateQueueSubmit(AttribContext->UpdateQueue, FilePath);
+        AttribContext->SavedErrorThisArg = ERROR_SUCCESS;
+        AttribContext->FilesFound++;
+        return TRUE;
+    }
+
     ExistingAttributes = GetFileAttributes(FilePath->StartOfString);
     if (ExistingAttributes == (DWORD)-1) {
         LastError = GetLastError();
@@ -400,6 +414,8 @@ ENTRYPOINT(
     WORD MatchFlags;
     DWORD Result;
     DWORD NewAttributes;
+    DWORD ThreadCount = 1;
+    YORILIB_FILE_UPDATE_OPERATION UpdateOperation;
     BOOLEAN BasicEnumeration = FALSE;
     BOOLEAN MatchAllFiles = FALSE;
     ATTRIB_CONTEXT AttribContext;
@@ -447,6 +463,19 @@ ENTRYPOINT(
             } else if (YoriLibCompareStringLitIns(&Arg, _T("d")) == 0) {
                 AttribContext.IncludeDirectories = TRUE;
                 ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("j")) == 0) {
+                if (i + 1 < ArgC) {
+                    YORI_MAX_SIGNED_T LlThreadCount = 0;
+                    YORI_ALLOC_SIZE_T CharsConsumed = 0;
+                    if (YoriLibStringToNumber(&ArgV[i + 1], TRUE, &LlThreadCount, &CharsConsumed) &&
+                        CharsConsumed > 0 &&
+                        LlThreadCount > 0) {
+
+                        ThreadCount = (DWORD)LlThreadCount;
+                        ArgumentUnderstood = TRUE;
+                        i++;
+                    }
+                }
 
             } else if (YoriLibCompareStringLitIns(&Arg, _T("s")) == 0) {
                 AttribContext.Recursive = TRUE;
@@ -510,10 +539,29 @@ ENTRYPOINT(
         MatchFlags |= YORILIB_FILEENUM_BASIC_EXPANSION;
     }
 
+    //
+    //  Displaying attributes happens in enumeration order, so only changes
+    //  are performed concurrently.
+    //
+
+    if (ThreadCount > 1 &&
+        (AttribContext.AttributesToSet != 0 || AttribContext.AttributesToClear != 0)) {
+
+        ZeroMemory(&UpdateOperation, sizeof(UpdateOperation));
+        UpdateOperation.Flags = YORILIB_FILE_UPDATE_SET_ATTRIBUTES | YORILIB_FILE_UPDATE_NO_FOLLOW_LINKS;
+        UpdateOperation.AttributesToSet = AttribContext.AttributesToSet;
+        UpdateOperation.AttributesToClear = AttribContext.AttributesToClear;
+        UpdateOperation.ProgramName = _T("attrib");
+        AttribContext.UpdateQueue = YoriLibFileUpdateQueueCreate(&UpdateOperation, ThreadCount);
+    }
+
     if (MatchAllFiles) {
         YoriLibConstantString(&Arg, _T("*"));
 
         if (!YoriLibUserStringToSingleFilePath(&Arg, TRUE, &FullPath)) {
+            if (AttribContext.UpdateQueue != NULL) {
+                YoriLibFileUpdateQueueDestroy(AttribContext.UpdateQueue);
+            }
             return EXIT_FAILURE;
         }
 
@@ -560,6 +608,13 @@ ENTRYPOINT(
         }
     }
 
+    if (AttribContext.UpdateQueue != NULL) {
+        if (AttribContext.Verbose) {
+            YoriLibFileUpdateQueueDisplayStats(AttribContext.UpdateQueue);
+        }
+        YoriLibFileUpdateQueueDestroy(AttribContext.UpdateQueue);
+    }
+
     YoriLibFreeStringContents(&AttribContext.UnescapedPath);
 
     if (AttribContext.FilesFound == 0) {
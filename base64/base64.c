@@ -54,318 +54,464 @@ Base64Help(VOID)
 }
 
 /**
- A buffer for a single data stream.
+ The number of bytes of binary data encoded on each line of output.  This
+ matches the line length used by CryptBinaryToString.
  */
-typedef struct _BASE64_BUFFER {
+#define BASE64_BYTES_PER_LINE (48)
+
+/**
+ The number of characters of encoded data on each line of output.
+ */
+#define BASE64_CHARS_PER_LINE (64)
+
+/**
+ The number of lines of output encoded from each block of input.
+ */
+#define BASE64_LINES_PER_BLOCK (1024)
+
+/**
+ The number of bytes of input to decode at a time.
+ */
+#define BASE64_DECODE_BLOCK_SIZE (64 * 1024)
+
+/**
+ A value in the decode table indicating a character which is not part of
+ the base64 alphabet.
+ */
+#define BASE64_INVALID (0xFF)
+
+/**
+ A value in the decode table indicating a character which is white space
+ and should be ignored.
+ */
+#define BASE64_SKIP (0xFE)
+
+/**
+ A value in the decode table indicating the padding character.
+ */
+#define BASE64_PAD (0xFD)
+
+/**
+ The characters used to encode each six bit value.
+ */
+CONST UCHAR Base64Alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+/**
+ State for encoding or decoding a stream.
+ */
+typedef struct _BASE64_CONTEXT {
 
     /**
-     A handle to a pipe which is the source of data for this buffer.
+     A handle to the source of data.
      */
     HANDLE hSource;
 
     /**
-     The data buffer.
+     A handle to the target for data.
      */
-    YORI_LIB_BYTE_BUFFER ByteBuffer;
+    HANDLE hTarget;
 
-} BASE64_BUFFER, *PBASE64_BUFFER;
+    /**
+     A buffer of data read from the source.
+     */
+    PUCHAR InputBuffer;
 
-/**
- Populate data from stdin into an in memory buffer.
+    /**
+     A buffer of data to write to the target.
+     */
+    PUCHAR OutputBuffer;
 
- @param ThisBuffer A pointer to the process buffer set.
+    /**
+     For each pair of six bit values, the two encoded characters, indexed by
+     a twelve bit value.
+     */
+    UCHAR EncodePairs[4096][2];
 
- @return TRUE to indicate success, FALSE to indicate failure.
+    /**
+     For each input byte, the six bit value it encodes, or one of
+     BASE64_INVALID, BASE64_SKIP or BASE64_PAD.
+     */
+    UCHAR DecodeTable[256];
+
+} BASE64_CONTEXT, *PBASE64_CONTEXT;
+
+/**
+ Populate the tables used to encode and decode.
+
+ @param Base64Context Pointer to the context containing the tables.
  */
-BOOL
-Base64BufferPump(
-    __in PBASE64_BUFFER ThisBuffer
+VOID
+Base64InitializeTables(
+    __out PBASE64_CONTEXT Base64Context
     )
 {
-    DWORD BytesRead;
-    BOOL Result = FALSE;
-    PUCHAR WriteBuffer;
-    YORI_ALLOC_SIZE_T BytesAvailable;
+    DWORD Index;
 
-    while (TRUE) {
+    for (Index = 0; Index < 4096; Index++) {
+        Base64Context->EncodePairs[Index][0] = Base64Alphabet[Index >> 6];
+        Base64Context->EncodePairs[Index][1] = Base64Alphabet[Index & 0x3F];
+    }
 
-        WriteBuffer = YoriLibByteBufferGetPointerToEnd(&ThisBuffer->ByteBuffer, 16384, &BytesAvailable);
-        if (WriteBuffer == NULL) {
-            break;
-        }
+    for (Index = 0; Index < 256; Index++) {
+        Base64Context->DecodeTable[Index] = BASE64_INVALID;
+    }
 
-        if (ReadFile(ThisBuffer->hSource,
-                     WriteBuffer,
-                     BytesAvailable,
-                     &BytesRead,
-                     NULL)) {
+    for (Index = 0; Index < 64; Index++) {
+        Base64Context->DecodeTable[Base64Alphabet[Index]] = (UCHAR)Index;
+    }
 
-            if (BytesRead == 0) {
-                Result = TRUE;
-                break;
-            }
+    Base64Context->DecodeTable['='] = BASE64_PAD;
+    Base64Context->DecodeTable[' '] = BASE64_SKIP;
+    Base64Context->DecodeTable['\t'] = BASE64_SKIP;
+    Base64Context->DecodeTable['\r'] = BASE64_SKIP;
+    Base64Context->DecodeTable['\n'] = BASE64_SKIP;
+    Base64Context->DecodeTable['\0'] = BASE64_SKIP;
+}
 
-            YoriLibByteBufferAddToPopulatedLength(&ThisBuffer->ByteBuffer, BytesRead);
+/**
+ Read from the source until a buffer is full or the source has no more data.
+
+ @param hSource Handle to the source.
+
+ @param Buffer Pointer to the buffer to fill.
+
+ @param BufferLength The number of bytes in the buffer.
+
+ @return The number of bytes read, which is less than BufferLength only when
+         the end of the source is reached.
+ */
+DWORD
+Base64Fill(
+    __in HANDLE hSource,
+    __out_bcount(BufferLength) PUCHAR Buffer,
+    __in DWORD BufferLength
+    )
+{
+    DWORD BytesFilled;
+    DWORD BytesRead;
+
+    BytesFilled = 0;
+    while (BytesFilled < BufferLength) {
+        if (!ReadFile(hSource, &Buffer[BytesFilled], BufferLength - BytesFilled, &BytesRead, NULL) ||
+            BytesRead == 0) {
 
-        } else {
-            Result = TRUE;
             break;
         }
+        BytesFilled = BytesFilled + BytesRead;
     }
 
-    return Result;
+    return BytesFilled;
 }
 
 /**
- Allocate and initialize a buffer for an input stream.
+ Write a buffer to the target.
 
- @param Buffer Pointer to the buffer to allocate structures for.
+ @param hTarget Handle to the target.
 
- @return TRUE if the buffer is successfully initialized, FALSE if it is not.
+ @param Buffer Pointer to the data to write.
+
+ @param BufferLength The number of bytes to write.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
  */
+__success(return)
 BOOL
-Base64AllocateBuffer(
-    __out PBASE64_BUFFER Buffer
+Base64Write(
+    __in HANDLE hTarget,
+    __in_bcount(BufferLength) PUCHAR Buffer,
+    __in DWORD BufferLength
     )
 {
-    return YoriLibByteBufferInitialize(&Buffer->ByteBuffer, 1024);
-}
+    DWORD BytesSent;
+    DWORD BytesWritten;
+    DWORD Err;
+    LPTSTR ErrText;
 
-/**
- Free structures associated with a single input stream.
+    BytesSent = 0;
+    while (BytesSent < BufferLength) {
+        if (!WriteFile(hTarget, &Buffer[BytesSent], BufferLength - BytesSent, &BytesWritten, NULL)) {
+            Err = GetLastError();
+            ErrText = YoriLibGetWinErrorText(Err);
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("base64: failure to write to output: %s"), ErrText);
+            YoriLibFreeWinErrorText(ErrText);
+            return FALSE;
+        }
+        BytesSent = BytesSent + BytesWritten;
+    }
 
- @param ThisBuffer Pointer to the single stream's buffers to deallocate.
- */
-VOID
-Base64FreeBuffer(
-    __in PBASE64_BUFFER ThisBuffer
-    )
-{
-    YoriLibByteBufferCleanup(&ThisBuffer->ByteBuffer);
+    return TRUE;
 }
 
 /**
- Perform base64 encode and output to the requested device.
+ Encode a range of binary data into base64 text, inserting a line break
+ after every BASE64_BYTES_PER_LINE bytes of input and after any final
+ partial line.
 
- @param ThisBuffer Pointer to the buffer to output.
+ @param Base64Context Pointer to the context containing the encode table.
 
- @return TRUE to indicate success, FALSE to indicate failure.
+ @param Input Pointer to the binary data.
+
+ @param InputLength The number of bytes of binary data.
+
+ @param Output Pointer to a buffer to receive the encoded text.  This must be
+        large enough to contain the encoded form of InputLength bytes.
+
+ @return The number of bytes of encoded text.
  */
-BOOL
-Base64Encode(
-    __inout PBASE64_BUFFER ThisBuffer
+DWORD
+Base64EncodeBlock(
+    __in PBASE64_CONTEXT Base64Context,
+    __in_bcount(InputLength) PUCHAR Input,
+    __in DWORD InputLength,
+    __out PUCHAR Output
     )
 {
-    DWORD CharsRequired;
-    YORI_STRING Buffer;
-    DWORD Err;
-    LPTSTR ErrText;
-    PUCHAR SourceBuffer;
-    YORI_ALLOC_SIZE_T BytesPopulated;
+    DWORD InputIndex;
+    DWORD OutputIndex;
+    DWORD LineEnd;
+    DWORD Value;
+
+    InputIndex = 0;
+    OutputIndex = 0;
+
+    while (InputIndex < InputLength) {
+        LineEnd = InputIndex + BASE64_BYTES_PER_LINE;
+        if (LineEnd > InputLength) {
+            LineEnd = InputLength;
+        }
 
-    //
-    //  Calculate the buffer size needed
-    //
+        //
+        //  Encode each group of three bytes as two pairs of characters.
+        //
+
+        while (InputIndex + 3 <= LineEnd) {
+            Value = ((DWORD)Input[InputIndex] << 16) | ((DWORD)Input[InputIndex + 1] << 8) | Input[InputIndex + 2];
+            Output[OutputIndex] = Base64Context->EncodePairs[Value >> 12][0];
+            Output[OutputIndex + 1] = Base64Context->EncodePairs[Value >> 12][1];
+            Output[OutputIndex + 2] = Base64Context->EncodePairs[Value & 0xFFF][0];
+            Output[OutputIndex + 3] = Base64Context->EncodePairs[Value & 0xFFF][1];
+            InputIndex = InputIndex + 3;
+            OutputIndex = OutputIndex + 4;
+        }
 
-    SourceBuffer = YoriLibByteBufferGetPointerToValidData(&ThisBuffer->ByteBuffer, 0, &BytesPopulated);
-    if (!DllCrypt32.pCryptBinaryToStringW(SourceBuffer, BytesPopulated, CRYPT_STRING_BASE64, NULL, &CharsRequired)) {
-        Err = GetLastError();
-        ErrText = YoriLibGetWinErrorText(Err);
-        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("base64: failure to calculate buffer length in CryptBinaryToString: %s"), ErrText);
-        YoriLibFreeWinErrorText(ErrText);
-        return FALSE;
-    }
+        //
+        //  Encode and pad any remaining one or two bytes.
+        //
 
-    //
-    //  Check if the buffer size would overflow, and fail if so
-    //
+        if (InputIndex < LineEnd) {
+            Value = (DWORD)Input[InputIndex] << 16;
+            if (InputIndex + 1 < LineEnd) {
+                Value = Value | ((DWORD)Input[InputIndex + 1] << 8);
+            }
+            Output[OutputIndex] = Base64Alphabet[(Value >> 18) & 0x3F];
+            Output[OutputIndex + 1] = Base64Alphabet[(Value >> 12) & 0x3F];
+            Output[OutputIndex + 2] = '=';
+            Output[OutputIndex + 3] = '=';
+            if (InputIndex + 1 < LineEnd) {
+                Output[OutputIndex + 2] = Base64Alphabet[(Value >> 6) & 0x3F];
+            }
+            InputIndex = LineEnd;
+            OutputIndex = OutputIndex + 4;
+        }
 
-    if (!YoriLibIsSizeAllocatable(CharsRequired)) {
-        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("base64: supplied data too large\n"));
-        return FALSE;
+        Output[OutputIndex] = '\r';
+        Output[OutputIndex + 1] = '\n';
+        OutputIndex = OutputIndex + 2;
     }
 
-    //
-    //  Allocate buffer
-    //
-
-    if (!YoriLibAllocateString(&Buffer, (YORI_ALLOC_SIZE_T)CharsRequired)) {
-        Err = GetLastError();
-        ErrText = YoriLibGetWinErrorText(Err);
-        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("base64: allocation failure: %s"), ErrText);
-        YoriLibFreeWinErrorText(ErrText);
-        return FALSE;
-    }
+    return OutputIndex;
+}
 
-    //
-    //  Perform the encode
-    //
+/**
+ Perform base64 encode and output to the requested device.  The source is
+ processed in blocks so that memory use does not depend on its size.
 
-    if (!DllCrypt32.pCryptBinaryToStringW(SourceBuffer, BytesPopulated, CRYPT_STRING_BASE64, Buffer.StartOfString, &CharsRequired)) {
-        Err = GetLastError();
-        ErrText = YoriLibGetWinErrorText(Err);
-        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("base64: failure to encode in CryptBinaryToString: %s"), ErrText);
-        YoriLibFreeWinErrorText(ErrText);
-        YoriLibFreeStringContents(&Buffer);
-        return FALSE;
-    }
+ @param Base64Context Pointer to the context describing the source and
+        target.
 
-    Buffer.LengthInChars = (YORI_ALLOC_SIZE_T)CharsRequired;
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+Base64Encode(
+    __inout PBASE64_CONTEXT Base64Context
+    )
+{
+    DWORD BytesRead;
+    DWORD BytesEncoded;
 
-    //
-    //  Free the source buffer.  We're done with it by this point, and
-    //  output may need to double buffer for encoding.
-    //
+    while (TRUE) {
+        BytesRead = Base64Fill(Base64Context->hSource, Base64Context->InputBuffer, BASE64_BYTES_PER_LINE * BASE64_LINES_PER_BLOCK);
+        if (BytesRead == 0) {
+            break;
+        }
 
-    Base64FreeBuffer(ThisBuffer);
+        BytesEncoded = Base64EncodeBlock(Base64Context, Base64Context->InputBuffer, BytesRead, Base64Context->OutputBuffer);
+        if (!Base64Write(Base64Context->hTarget, Base64Context->OutputBuffer, BytesEncoded)) {
+            return FALSE;
+        }
 
-    //
-    //  Output the encoded form.
-    //
+        if (BytesRead < BASE64_BYTES_PER_LINE * BASE64_LINES_PER_BLOCK) {
+            break;
+        }
 
-    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y"), &Buffer);
-    YoriLibFreeStringContents(&Buffer);
+        if (YoriLibIsOperationCancelled()) {
+            return FALSE;
+        }
+    }
 
     return TRUE;
 }
 
 /**
- Perform base64 decode and output to the requested device.
+ Perform base64 decode and output to the requested device.  The source is
+ processed in blocks so that memory use does not depend on its size.  White
+ space within the source is ignored.
 
- @param ThisBuffer Pointer to the buffer to output.
+ @param Base64Context Pointer to the context describing the source and
+        target.
 
  @return TRUE to indicate success, FALSE to indicate failure.
  */
 BOOL
 Base64Decode(
-    __inout PBASE64_BUFFER ThisBuffer
+    __inout PBASE64_CONTEXT Base64Context
     )
 {
-    YORI_ALLOC_SIZE_T CharsRequired;
-    DWORD BytesRequired;
-    YORI_STRING Buffer;
-    PUCHAR BinaryBuffer;
-    DWORD Skip;
-    DWORD Flags;
-    DWORD BytesSent;
-    BOOL Result;
-    HANDLE hTarget;
-    DWORD Err;
-    LPTSTR ErrText;
-    PUCHAR SourceBuffer;
-    YORI_ALLOC_SIZE_T BytesPopulated;
+    PUCHAR Input;
+    PUCHAR Output;
+    PUCHAR DecodeTable;
+    DWORD BytesRead;
+    DWORD InputIndex;
+    DWORD OutputIndex;
+    DWORD Value;
+    DWORD Quantum;
+    DWORD QuantumChars;
+    BOOLEAN PadFound;
+    BOOLEAN FirstBlock;
+    UCHAR Decoded;
+    UCHAR Char0;
+    UCHAR Char1;
+    UCHAR Char2;
+    UCHAR Char3;
+
+    Input = Base64Context->InputBuffer;
+    Output = Base64Context->OutputBuffer;
+    DecodeTable = Base64Context->DecodeTable;
+    Quantum = 0;
+    QuantumChars = 0;
+    PadFound = FALSE;
+    FirstBlock = TRUE;
 
-    //
-    //  Convert the input buffer into a UTF16 string.
-    //
+    while (TRUE) {
+        BytesRead = Base64Fill(Base64Context->hSource, Input, BASE64_DECODE_BLOCK_SIZE);
+        if (BytesRead == 0) {
+            break;
+        }
 
-    SourceBuffer = YoriLibByteBufferGetPointerToValidData(&ThisBuffer->ByteBuffer, 0, &BytesPopulated);
-    if (SourceBuffer == NULL) {
-        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("base64: allocation failure\n"));
-        return FALSE;
-    }
-    CharsRequired = YoriLibGetMultibyteInputSizeNeeded(SourceBuffer, BytesPopulated);
-    if (!YoriLibAllocateString(&Buffer, CharsRequired + 1)) {
-        Err = GetLastError();
-        ErrText = YoriLibGetWinErrorText(Err);
-        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("base64: allocation failure: %s"), ErrText);
-        YoriLibFreeWinErrorText(ErrText);
-        return FALSE;
-    }
+        InputIndex = 0;
+        OutputIndex = 0;
+        if (FirstBlock) {
+            InputIndex = YoriLibBytesInBom(Input, BytesRead);
+            FirstBlock = FALSE;
+        }
 
-    YoriLibMultibyteInput(SourceBuffer, BytesPopulated, Buffer.StartOfString, CharsRequired);
-    Buffer.LengthInChars = CharsRequired;
-    Buffer.StartOfString[CharsRequired] = '\0';
+        while (InputIndex < BytesRead) {
+
+            //
+            //  When no partial group is pending, decode groups of four
+            //  characters directly.  This stops on anything other than
+            //  four characters from the alphabet, which are handled below.
+            //
+
+            if (QuantumChars == 0 && !PadFound) {
+                while (InputIndex + 4 <= BytesRead) {
+                    Char0 = DecodeTable[Input[InputIndex]];
+                    Char1 = DecodeTable[Input[InputIndex + 1]];
+                    Char2 = DecodeTable[Input[InputIndex + 2]];
+                    Char3 = DecodeTable[Input[InputIndex + 3]];
+                    if ((Char0 | Char1 | Char2 | Char3) & 0xC0) {
+                        break;
+                    }
+                    Value = ((DWORD)Char0 << 18) | ((DWORD)Char1 << 12) | ((DWORD)Char2 << 6) | Char3;
+                    Output[OutputIndex] = (UCHAR)(Value >> 16);
+                    Output[OutputIndex + 1] = (UCHAR)(Value >> 8);
+                    Output[OutputIndex + 2] = (UCHAR)Value;
+                    OutputIndex = OutputIndex + 3;
+                    InputIndex = InputIndex + 4;
+                }
+
+                if (InputIndex == BytesRead) {
+                    break;
+                }
+            }
 
-    //
-    //  Free the source buffer.  We're done with it by this point, and
-    //  output may need to double buffer for encoding.
-    //
+            Decoded = DecodeTable[Input[InputIndex]];
+            InputIndex++;
 
-    Base64FreeBuffer(ThisBuffer);
+            if (Decoded == BASE64_SKIP) {
+                continue;
+            }
 
-    //
-    //  Calculate the buffer size needed
-    //
+            if (Decoded == BASE64_PAD) {
+                if (QuantumChars < 2) {
+                    YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("base64: invalid padding in input\n"));
+                    return FALSE;
+                }
+                PadFound = TRUE;
+                continue;
+            }
 
-    if (!DllCrypt32.pCryptStringToBinaryW(Buffer.StartOfString, Buffer.LengthInChars, CRYPT_STRING_BASE64, NULL, &BytesRequired, NULL, NULL)) {
-        Err = GetLastError();
-        ErrText = YoriLibGetWinErrorText(Err);
-        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("base64: failure to calculate buffer length in CryptStringToBinary: %s"), ErrText);
-        YoriLibFreeWinErrorText(ErrText);
-        YoriLibFreeStringContents(&Buffer);
-        return FALSE;
-    }
+            if (Decoded == BASE64_INVALID || PadFound) {
+                YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("base64: invalid character in input\n"));
+                return FALSE;
+            }
 
-    //
-    //  Allocate binary buffer
-    //
+            Quantum = (Quantum << 6) | Decoded;
+            QuantumChars++;
+            if (QuantumChars == 4) {
+                Output[OutputIndex] = (UCHAR)(Quantum >> 16);
+                Output[OutputIndex + 1] = (UCHAR)(Quantum >> 8);
+                Output[OutputIndex + 2] = (UCHAR)Quantum;
+                OutputIndex = OutputIndex + 3;
+                Quantum = 0;
+                QuantumChars = 0;
+            }
+        }
 
-    BinaryBuffer = YoriLibMalloc((YORI_ALLOC_SIZE_T)BytesRequired);
-    if (BinaryBuffer == NULL) {
-        Err = GetLastError();
-        ErrText = YoriLibGetWinErrorText(Err);
-        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("base64: allocation failure: %s"), ErrText);
-        YoriLibFreeWinErrorText(ErrText);
-        YoriLibFreeStringContents(&Buffer);
-        return FALSE;
-    }
+        if (!Base64Write(Base64Context->hTarget, Output, OutputIndex)) {
+            return FALSE;
+        }
 
-    //
-    //  Perform the decode
-    //
+        if (BytesRead < BASE64_DECODE_BLOCK_SIZE) {
+            break;
+        }
 
-    if (!DllCrypt32.pCryptStringToBinaryW(Buffer.StartOfString, Buffer.LengthInChars, CRYPT_STRING_BASE64, BinaryBuffer, &BytesRequired, &Skip, &Flags)) {
-        Err = GetLastError();
-        ErrText = YoriLibGetWinErrorText(Err);
-        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("base64: failure to encode in CryptBinaryToString: %s"), ErrText);
-        YoriLibFreeWinErrorText(ErrText);
-        YoriLibFreeStringContents(&Buffer);
-        YoriLibFree(BinaryBuffer);
-        return FALSE;
+        if (YoriLibIsOperationCancelled()) {
+            return FALSE;
+        }
     }
 
     //
-    //  We're done with the string form of the source, deallocate it.
-    //
-
-    YoriLibFreeStringContents(&Buffer);
-
+    //  Output any final partial group.  Two characters encode one byte and
+    //  three characters encode two bytes.
     //
-    //  Output the decoded form.
-    //
-    BytesSent = 0;
-    Result = TRUE;
-    hTarget = GetStdHandle(STD_OUTPUT_HANDLE);
-
-    while (BytesSent < BytesRequired) {
-        DWORD BytesToWrite;
-        DWORD BytesWritten;
-        BytesToWrite = 4096;
-        if (BytesSent + BytesToWrite > BytesRequired) {
-            BytesToWrite = BytesRequired - BytesSent;
-        }
 
-        if (WriteFile(hTarget,
-                      YoriLibAddToPointer(BinaryBuffer, BytesSent),
-                      BytesToWrite,
-                      &BytesWritten,
-                      NULL)) {
-
-            BytesSent += BytesWritten;
-        } else {
-            Err = GetLastError();
-            ErrText = YoriLibGetWinErrorText(Err);
-            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("base64: failure to write to output: %s"), ErrText);
-            YoriLibFreeWinErrorText(ErrText);
-            Result = FALSE;
-        }
+    if (QuantumChars == 1) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("base64: input is truncated\n"));
+        return FALSE;
+    }
 
-        ASSERT(BytesSent <= BytesRequired);
+    OutputIndex = 0;
+    if (QuantumChars == 2) {
+        Output[0] = (UCHAR)(Quantum >> 4);
+        OutputIndex = 1;
+    } else if (QuantumChars == 3) {
+        Output[0] = (UCHAR)(Quantum >> 10);
+        Output[1] = (UCHAR)(Quantum >> 2);
+        OutputIndex = 2;
     }
-    YoriLibFree(BinaryBuffer);
 
-    return Result;
+    return Base64Write(Base64Context->hTarget, Output, OutputIndex);
 }
 
 #ifdef YORI_BUILTIN
@@ -401,12 +547,12 @@ ENTRYPOINT(
     YORI_ALLOC_SIZE_T StartArg = 0;
     YORI_STRING Arg;
     BOOLEAN Decode = FALSE;
-    BASE64_BUFFER Base64Buffer;
+    BOOL Result;
+    PBASE64_CONTEXT Base64Context;
     YORI_STRING FullFilePath;
     DWORD Err;
     LPTSTR ErrText;
 
-    ZeroMemory(&Base64Buffer, sizeof(Base64Buffer));
     YoriLibInitEmptyString(&FullFilePath);
 
     for (i = 1; i < ArgC; i++) {
@@ -441,28 +587,28 @@ ENTRYPOINT(
         }
     }
 
-    YoriLibLoadCrypt32Functions();
-    if (DllCrypt32.pCryptBinaryToStringW == NULL ||
-        DllCrypt32.pCryptStringToBinaryW == NULL) {
-
-        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("base64: operating system support not present\n"));
-        return EXIT_FAILURE;
-    }
-
 #if YORI_BUILTIN
     YoriLibCancelEnable(FALSE);
 #endif
 
+    Base64Context = YoriLibMalloc(sizeof(BASE64_CONTEXT));
+    if (Base64Context == NULL) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("base64: allocation failure\n"));
+        return EXIT_FAILURE;
+    }
+    ZeroMemory(Base64Context, sizeof(BASE64_CONTEXT));
+
     //
     //  If no file name is specified, use stdin; otherwise open
     //  the file and use that
     //
 
-    YoriLibInitEmptyString(&FullFilePath);
-    Base64Buffer.hSource = GetStdHandle(STD_INPUT_HANDLE);
+    Base64Context->hSource = GetStdHandle(STD_INPUT_HANDLE);
+    Base64Context->hTarget = GetStdHandle(STD_OUTPUT_HANDLE);
     if (StartArg == 0 || StartArg == ArgC) {
         if (YoriLibIsStdInConsole()) {
             YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("base64: no file or pipe for input\n"));
+            YoriLibFree(Base64Context);
             return EXIT_FAILURE;
         }
     } else {
@@ -471,66 +617,57 @@ ENTRYPOINT(
             ErrText = YoriLibGetWinErrorText(Err);
             YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("base64: resolving path failed: %s"), ErrText);
             YoriLibFreeWinErrorText(ErrText);
+            YoriLibFree(Base64Context);
             return EXIT_FAILURE;
         }
 
-        Base64Buffer.hSource = CreateFile(FullFilePath.StartOfString, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
-        if (Base64Buffer.hSource == INVALID_HANDLE_VALUE) {
+        Base64Context->hSource = CreateFile(FullFilePath.StartOfString, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+        if (Base64Context->hSource == INVALID_HANDLE_VALUE) {
             Err = GetLastError();
             ErrText = YoriLibGetWinErrorText(Err);
             YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("base64: opening file failed: %s"), ErrText);
             YoriLibFreeWinErrorText(ErrText);
             YoriLibFreeStringContents(&FullFilePath);
+            YoriLibFree(Base64Context);
             return EXIT_FAILURE;
         }
     }
 
-    if (!Base64AllocateBuffer(&Base64Buffer)) {
-        Err = GetLastError();
-        ErrText = YoriLibGetWinErrorText(Err);
-        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("base64: allocating buffer failed: %s"), ErrText);
-        YoriLibFreeWinErrorText(ErrText);
-        if (FullFilePath.LengthInChars > 0) {
-            CloseHandle(Base64Buffer.hSource);
-        }
-        YoriLibFreeStringContents(&FullFilePath);
-        return EXIT_FAILURE;
-    }
+    Base64InitializeTables(Base64Context);
 
-    if (!Base64BufferPump(&Base64Buffer)) {
-        if (FullFilePath.LengthInChars > 0) {
-            CloseHandle(Base64Buffer.hSource);
-        }
-        YoriLibFreeStringContents(&FullFilePath);
-        Base64FreeBuffer(&Base64Buffer);
-        return EXIT_FAILURE;
-    }
+    //
+    //  The input buffer is used for BASE64_LINES_PER_BLOCK lines of binary
+    //  data when encoding or BASE64_DECODE_BLOCK_SIZE bytes of text when
+    //  decoding.  The output buffer holds the encoded form of a block, which
+    //  is larger than the decoded form of a block.
+    //
 
-    if (!Decode) {
-        if (!Base64Encode(&Base64Buffer)) {
-            if (FullFilePath.LengthInChars > 0) {
-                CloseHandle(Base64Buffer.hSource);
-            }
-            YoriLibFreeStringContents(&FullFilePath);
-            Base64FreeBuffer(&Base64Buffer);
-            return EXIT_FAILURE;
-        }
+    Base64Context->InputBuffer = YoriLibMalloc(BASE64_DECODE_BLOCK_SIZE);
+    Base64Context->OutputBuffer = YoriLibMalloc(BASE64_LINES_PER_BLOCK * (BASE64_CHARS_PER_LINE + 2));
+    if (Base64Context->InputBuffer == NULL || Base64Context->OutputBuffer == NULL) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("base64: allocation failure\n"));
+        Result = FALSE;
+    } else if (!Decode) {
+        Result = Base64Encode(Base64Context);
     } else {
-        if (!Base64Decode(&Base64Buffer)) {
-            if (FullFilePath.LengthInChars > 0) {
-                CloseHandle(Base64Buffer.hSource);
-            }
-            YoriLibFreeStringContents(&FullFilePath);
-            Base64FreeBuffer(&Base64Buffer);
-            return EXIT_FAILURE;
-        }
+        Result = Base64Decode(Base64Context);
     }
 
+    if (Base64Context->InputBuffer != NULL) {
+        YoriLibFree(Base64Context->InputBuffer);
+    }
+    if (Base64Context->OutputBuffer != NULL) {
+        YoriLibFree(Base64Context->OutputBuffer);
+    }
     if (FullFilePath.LengthInChars > 0) {
-        CloseHandle(Base64Buffer.hSource);
+        CloseHandle(Base64Context->hSource);
     }
     YoriLibFreeStringContents(&FullFilePath);
-    Base64FreeBuffer(&Base64Buffer);
+    YoriLibFree(Base64Context);
+
+    if (!Result) {
+        return EXIT_FAILURE;
+    }
 
     return EXIT_SUCCESS;
 }
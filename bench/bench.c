@@ -0,0 +1,426 @@
+/**
+ * @file bench/bench.c
+ *
+ * Yori shell benchmark suite
+ *
+ * Copyright (c) 2026 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <yoripch.h>
+#include <yorilib.h>
+#include "bench.h"
+
+/**
+ Help text to display to the user.
+ */
+const
+CHAR strBenchHelpText[] =
+        "\n"
+        "Run benchmarks.\n"
+        "\n"
+        "YORIBENCH [-license] [-t <ms>] [-v Benchmark] [-x Benchmark]\n"
+        "YORIBENCH [-license] -corpus <directory>\n"
+        "YORIBENCH [-license] [-label <text>] [-n <count>] -tools <directory>\n"
+        "\n"
+        "   -corpus        Create a corpus of files for measuring tools\n"
+        "   -label         Text to include in tool results to identify the build\n"
+        "   -n             The number of measured runs of each tool, default 5\n"
+        "   -t             Minimum time in milliseconds to run each benchmark\n"
+        "   -tools         Measure tools operating on a corpus and output JSON.\n"
+        "                    Tools and timethis must be in the path\n"
+        "   -v             Benchmark to include\n"
+        "   -x             Benchmark to exclude\n"
+        "\n"
+        "Supported benchmarks:\n";
+
+/**
+ The default minimum time to run each benchmark, in milliseconds.
+ */
+#define BENCH_DEFAULT_TARGET_MS (200)
+
+/**
+ The maximum factor to increase the number of iterations by between runs
+ of a benchmark.
+ */
+#define BENCH_MAX_SCALE (100)
+
+/**
+ The default number of measured runs of each tool.
+ */
+#define BENCH_DEFAULT_TOOL_RUNS (5)
+
+/**
+ A structure to describe a benchmark.
+ */
+typedef struct _BENCH_VARIATION {
+
+    /**
+     The function to call to invoke the benchmark.
+     */
+    PYORI_BENCH_FN Fn;
+
+    /**
+     The name of the benchmark.
+     */
+    LPCTSTR Name;
+
+    /**
+     If TRUE, the execution status of this benchmark was set explicitly via
+     command line parameter.  If FALSE, default execution should apply.
+     */
+    BOOLEAN ExplicitlySpecified;
+
+    /**
+     If TRUE, the benchmark should execute.  If FALSE, it should not.  Only
+     meaningful when ExplicitlySpecified is TRUE.
+     */
+    BOOLEAN Execute;
+
+} BENCH_VARIATION, *PBENCH_VARIATION;
+
+
+/**
+ A list of benchmarks to execute.
+ */
+BENCH_VARIATION BenchVariations[] = {
+    {BenchMemcpy,                          _T("Memcpy")},
+    {BenchMemcpySmall,                     _T("MemcpySmall")},
+    {BenchMemmove,                         _T("Memmove")},
+    {BenchMemset,                          _T("Memset")},
+    {BenchMemcmp,                          _T("Memcmp")},
+    {BenchPeChecksum,                      _T("PeChecksum")},
+    {BenchCompareStringIns,                _T("CompareStringIns")},
+    {BenchFindFirstMatchSubstr,            _T("FindFirstMatchSubstr")},
+    {BenchYPrintf,                         _T("YPrintf")},
+    {BenchHashInsert,                      _T("HashInsert")},
+    {BenchHashLookup,                      _T("HashLookup")},
+    {BenchFullPathRelative,                _T("FullPathRelative")},
+    {BenchMultibyteInput,                  _T("MultibyteInput")},
+    {BenchReadLineAscii,                   _T("ReadLineAscii")},
+    {BenchReadLineUtf8,                    _T("ReadLineUtf8")},
+    {BenchReadLineUtf16,                   _T("ReadLineUtf16")},
+};
+
+
+/**
+ Display usage text to the user.
+ */
+BOOL
+BenchHelp(VOID)
+{
+    DWORD i;
+    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("YoriBench %i.%02i\n"), YORI_VER_MAJOR, YORI_VER_MINOR);
+#if YORI_BUILD_ID
+    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("  Build %i\n"), YORI_BUILD_ID);
+#endif
+    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%hs"), strBenchHelpText);
+    for (i = 0; i < sizeof(BenchVariations)/sizeof(BenchVariations[0]); i++) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("    %s\n"), BenchVariations[i].Name);
+    }
+    return TRUE;
+}
+
+/**
+ Start timing a benchmark.  This is called by the benchmark after any setup
+ is complete.
+
+ @param Bench Pointer to the benchmark state.
+ */
+VOID
+BenchStartTimer(
+    __inout PYORI_BENCH Bench
+    )
+{
+    QueryPerformanceCounter(&Bench->StartTime);
+}
+
+/**
+ Stop timing a benchmark.  This is called by the benchmark before any
+ cleanup.
+
+ @param Bench Pointer to the benchmark state.
+ */
+VOID
+BenchStopTimer(
+    __inout PYORI_BENCH Bench
+    )
+{
+    QueryPerformanceCounter(&Bench->EndTime);
+}
+
+/**
+ Run a benchmark repeatedly with an increasing number of iterations until
+ it takes at least the target time, and display the time per operation and
+ throughput of the final run.
+
+ @param Variation Pointer to the benchmark to run.
+
+ @param TargetTicks The minimum time for the final run, in performance
+        counter ticks.
+
+ @param Frequency The performance counter frequency.
+
+ @return TRUE if the benchmark ran successfully, FALSE if it failed.
+ */
+BOOLEAN
+BenchRunVariation(
+    __in PBENCH_VARIATION Variation,
+    __in LONGLONG TargetTicks,
+    __in LONGLONG Frequency
+    )
+{
+    YORI_BENCH Bench;
+    LONGLONG Elapsed;
+    DWORDLONG NewIterations;
+    DWORDLONG Operations;
+    LONGLONG TenthsOfNsPerOp;
+    LONGLONG MbPerSecond;
+
+    ZeroMemory(&Bench, sizeof(Bench));
+    Bench.Iterations = 1;
+
+    while (TRUE) {
+        Bench.OperationsPerIteration = 1;
+        Bench.BytesProcessed = 0;
+        Bench.StartTime.QuadPart = 0;
+        Bench.EndTime.QuadPart = 0;
+
+        if (!Variation->Fn(&Bench)) {
+            return FALSE;
+        }
+
+        Elapsed = Bench.EndTime.QuadPart - Bench.StartTime.QuadPart;
+        if (Elapsed >= TargetTicks) {
+            break;
+        }
+
+        //
+        //  Estimate the number of iterations needed to reach the target
+        //  with some margin, but grow by a bounded factor so that a
+        //  measurement distorted by timer resolution doesn't cause a very
+        //  long run.
+        //
+
+        if (Elapsed <= 0) {
+            NewIterations = Bench.Iterations * BENCH_MAX_SCALE;
+        } else {
+            NewIterations = (DWORDLONG)(Bench.Iterations * TargetTicks / Elapsed);
+            NewIterations = NewIterations + NewIterations / 5;
+            if (NewIterations < Bench.Iterations * 2) {
+                NewIterations = Bench.Iterations * 2;
+            } else if (NewIterations > Bench.Iterations * BENCH_MAX_SCALE) {
+                NewIterations = Bench.Iterations * BENCH_MAX_SCALE;
+            }
+        }
+        Bench.Iterations = NewIterations;
+    }
+
+    Operations = Bench.Iterations * Bench.OperationsPerIteration;
+    TenthsOfNsPerOp = (LONGLONG)(Elapsed * 10000 * 1000000 / Frequency / Operations);
+
+    if (Bench.BytesProcessed > 0) {
+        MbPerSecond = (LONGLONG)(Bench.BytesProcessed * Frequency / Elapsed / (1024 * 1024));
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT,
+                      _T("%-24s %10lli.%i ns/op %8lli MB/s\n"),
+                      Variation->Name,
+                      TenthsOfNsPerOp / 10,
+                      (int)(TenthsOfNsPerOp % 10),
+                      MbPerSecond);
+    } else {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT,
+                      _T("%-24s %10lli.%i ns/op\n"),
+                      Variation->Name,
+                      TenthsOfNsPerOp / 10,
+                      (int)(TenthsOfNsPerOp % 10));
+    }
+
+    return TRUE;
+}
+
+
+/**
+ The main entrypoint for the benchmark cmdlet.
+
+ @param ArgC The number of arguments.
+
+ @param ArgV An array of arguments.
+
+ @return Exit code of the process, zero indicating success or nonzero on
+         failure.
+ */
+DWORD
+ymain(
+    __in YORI_ALLOC_SIZE_T ArgC,
+    __in YORI_STRING ArgV[]
+    )
+{
+    YORI_ALLOC_SIZE_T i;
+    WORD Var;
+    WORD Failed;
+    YORI_STRING Arg;
+    BOOLEAN ArgumentUnderstood;
+    BOOLEAN RunAll;
+    BOOLEAN ExecuteVariation;
+    LARGE_INTEGER Frequency;
+    LONGLONG TargetMs;
+    LONGLONG TargetTicks;
+    PYORI_STRING CorpusDirectory;
+    PYORI_STRING ToolsDirectory;
+    PYORI_STRING Label;
+    DWORD ToolRuns;
+
+    RunAll = TRUE;
+    TargetMs = BENCH_DEFAULT_TARGET_MS;
+    CorpusDirectory = NULL;
+    ToolsDirectory = NULL;
+    Label = NULL;
+    ToolRuns = BENCH_DEFAULT_TOOL_RUNS;
+
+    for (i = 1; i < ArgC; i++) {
+
+        ArgumentUnderstood = FALSE;
+        ASSERT(YoriLibIsStringNullTerminated(&ArgV[i]));
+
+        if (YoriLibIsCommandLineOption(&ArgV[i], &Arg)) {
+
+            if (YoriLibCompareStringLitIns(&Arg, _T("?")) == 0) {
+                BenchHelp();
+                return EXIT_SUCCESS;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("license")) == 0) {
+                YoriLibDisplayMitLicense(_T("2026"));
+                return EXIT_SUCCESS;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("corpus")) == 0) {
+                if (ArgC > i + 1) {
+                    CorpusDirectory = &ArgV[i + 1];
+                    i++;
+                }
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("label")) == 0) {
+                if (ArgC > i + 1) {
+                    Label = &ArgV[i + 1];
+                    i++;
+                }
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("n")) == 0) {
+                if (ArgC > i + 1) {
+                    YORI_ALLOC_SIZE_T CharsConsumed;
+                    YORI_MAX_SIGNED_T llTemp;
+                    if (YoriLibStringToNumber(&ArgV[i + 1], TRUE, &llTemp, &CharsConsumed) &&
+                        CharsConsumed > 0 &&
+                        llTemp > 0 &&
+                        llTemp < 0x10000) {
+
+                        ToolRuns = (DWORD)llTemp;
+                        i++;
+                    }
+                }
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("t")) == 0) {
+                if (ArgC > i + 1) {
+                    YORI_ALLOC_SIZE_T CharsConsumed;
+                    YORI_MAX_SIGNED_T llTemp;
+                    if (YoriLibStringToNumber(&ArgV[i + 1], TRUE, &llTemp, &CharsConsumed) &&
+                        CharsConsumed > 0 &&
+                        llTemp > 0) {
+
+                        TargetMs = llTemp;
+                        i++;
+                    }
+                }
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("tools")) == 0) {
+                if (ArgC > i + 1) {
+                    ToolsDirectory = &ArgV[i + 1];
+                    i++;
+                }
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("v")) == 0) {
+                if (ArgC > i + 1) {
+                    for (Var = 0; Var < sizeof(BenchVariations)/sizeof(BenchVariations[0]); Var++) {
+                        if (YoriLibCompareStringLitIns(&ArgV[i + 1], BenchVariations[Var].Name) == 0) {
+                            BenchVariations[Var].ExplicitlySpecified = TRUE;
+                            BenchVariations[Var].Execute = TRUE;
+                            RunAll = FALSE;
+                        }
+                    }
+                }
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("x")) == 0) {
+                if (ArgC > i + 1) {
+                    for (Var = 0; Var < sizeof(BenchVariations)/sizeof(BenchVariations[0]); Var++) {
+                        if (YoriLibCompareStringLitIns(&ArgV[i + 1], BenchVariations[Var].Name) == 0) {
+                            BenchVariations[Var].ExplicitlySpecified = TRUE;
+                            BenchVariations[Var].Execute = FALSE;
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    if (CorpusDirectory != NULL) {
+        if (!BenchCreateCorpus(CorpusDirectory)) {
+            return EXIT_FAILURE;
+        }
+        return EXIT_SUCCESS;
+    }
+
+    if (ToolsDirectory != NULL) {
+        if (!BenchRunTools(ToolsDirectory, Label, ToolRuns)) {
+            return EXIT_FAILURE;
+        }
+        return EXIT_SUCCESS;
+    }
+
+    if (!QueryPerformanceFrequency(&Frequency) || Frequency.QuadPart == 0) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("yoribench: no performance counter available\n"));
+        return EXIT_FAILURE;
+    }
+
+    TargetTicks = Frequency.QuadPart * TargetMs / 1000;
+    Failed = 0;
+
+    for (i = 0; i < sizeof(BenchVariations)/sizeof(BenchVariations[0]); i++) {
+
+        ExecuteVariation = FALSE;
+        if (RunAll) {
+            if (!BenchVariations[i].ExplicitlySpecified ||
+                BenchVariations[i].Execute) {
+
+                ExecuteVariation = TRUE;
+            }
+        } else {
+            if (BenchVariations[i].ExplicitlySpecified &&
+                BenchVariations[i].Execute) {
+
+                ExecuteVariation = TRUE;
+            }
+        }
+
+        if (ExecuteVariation) {
+            if (!BenchRunVariation(&BenchVariations[i], TargetTicks, Frequency.QuadPart)) {
+                YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%s FAILED\n"), BenchVariations[i].Name);
+                Failed++;
+            }
+        }
+    }
+
+    if (Failed == 0) {
+        return EXIT_SUCCESS;
+    }
+    return EXIT_FAILURE;
+}
+
+// vim:sw=4:ts=4:et:
@@ -0,0 +1,183 @@
+/**
+ * @file bench/bench.h
+ *
+ * Yori shell benchmark header
+ *
+ * Copyright (c) 2026 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/**
+ The state of a single benchmark while it is running.
+ */
+typedef struct _YORI_BENCH {
+
+    /**
+     The number of iterations the benchmark should perform between starting
+     and stopping the timer.
+     */
+    DWORDLONG Iterations;
+
+    /**
+     The number of operations performed by each iteration.  This defaults
+     to one, and can be set by the benchmark when each iteration processes
+     a batch of items, so the time per item is reported.
+     */
+    DWORD OperationsPerIteration;
+
+    /**
+     The total number of bytes processed by all iterations.  This is set by
+     the benchmark if throughput is meaningful, and left as zero otherwise.
+     */
+    DWORDLONG BytesProcessed;
+
+    /**
+     The performance counter value when the timer was started.
+     */
+    LARGE_INTEGER StartTime;
+
+    /**
+     The performance counter value when the timer was stopped.
+     */
+    LARGE_INTEGER EndTime;
+
+} YORI_BENCH, *PYORI_BENCH;
+
+/**
+ Specifies the function signature for a benchmark.  The benchmark should
+ perform any setup, call BenchStartTimer, perform the requested number of
+ iterations, call BenchStopTimer, and clean up.
+ */
+typedef
+BOOLEAN
+YORI_BENCH_FN(
+    __inout PYORI_BENCH Bench
+    );
+
+/**
+ A pointer to a benchmark.
+ */
+typedef YORI_BENCH_FN *PYORI_BENCH_FN;
+
+VOID
+BenchStartTimer(
+    __inout PYORI_BENCH Bench
+    );
+
+VOID
+BenchStopTimer(
+    __inout PYORI_BENCH Bench
+    );
+
+/**
+ A benchmark to copy a large buffer with memcpy.
+ */
+YORI_BENCH_FN BenchMemcpy;
+
+/**
+ A benchmark to copy a small buffer with memcpy.
+ */
+YORI_BENCH_FN BenchMemcpySmall;
+
+/**
+ A benchmark to copy a large buffer to an overlapping destination with
+ memmove.
+ */
+YORI_BENCH_FN BenchMemmove;
+
+/**
+ A benchmark to fill a large buffer with memset.
+ */
+YORI_BENCH_FN BenchMemset;
+
+/**
+ A benchmark to compare two identical large buffers with memcmp.
+ */
+YORI_BENCH_FN BenchMemcmp;
+
+/**
+ A benchmark to calculate the PE checksum of a large buffer.
+ */
+YORI_BENCH_FN BenchPeChecksum;
+
+/**
+ A benchmark to insert keys into a hash table.
+ */
+YORI_BENCH_FN BenchHashInsert;
+
+/**
+ A benchmark to look up keys in a hash table.
+ */
+YORI_BENCH_FN BenchHashLookup;
+
+/**
+ A benchmark to read lines from a file containing ASCII text in UTF-8.
+ */
+YORI_BENCH_FN BenchReadLineAscii;
+
+/**
+ A benchmark to read lines from a file containing non-ASCII text in UTF-8.
+ */
+YORI_BENCH_FN BenchReadLineUtf8;
+
+/**
+ A benchmark to read lines from a file containing UTF-16 text.
+ */
+YORI_BENCH_FN BenchReadLineUtf16;
+
+/**
+ A benchmark to convert UTF-8 text to the native character set.
+ */
+YORI_BENCH_FN BenchMultibyteInput;
+
+/**
+ A benchmark to resolve a relative path against a directory.
+ */
+YORI_BENCH_FN BenchFullPathRelative;
+
+/**
+ A benchmark to format a string with several arguments.
+ */
+YORI_BENCH_FN BenchYPrintf;
+
+/**
+ A benchmark to search a string for several substrings that are not
+ present.
+ */
+YORI_BENCH_FN BenchFindFirstMatchSubstr;
+
+/**
+ A benchmark to compare two strings that differ only in case.
+ */
+YORI_BENCH_FN BenchCompareStringIns;
+
+BOOLEAN
+BenchCreateCorpus(
+    __in PYORI_STRING Directory
+    );
+
+BOOLEAN
+BenchRunTools(
+    __in PYORI_STRING Directory,
+    __in_opt PYORI_STRING Label,
+    __in DWORD RunCount
+    );
+
+// vim:sw=4:ts=4:et:
@@ -0,0 +1,707 @@
+/**
+ * @file bench/corpus.c
+ *
+ * Yori shell benchmark corpus generation
+ *
+ * Copyright (c) 2026 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <yoripch.h>
+#include <yorilib.h>
+#include "bench.h"
+
+/**
+ The number of nested directories in the deep part of the tree.
+ */
+#define BENCH_CORPUS_DEEP_LEVELS (32)
+
+/**
+ The number of files in each directory in the deep part of the tree.
+ */
+#define BENCH_CORPUS_DEEP_FILES (4)
+
+/**
+ The number of directories in the wide part of the tree.
+ */
+#define BENCH_CORPUS_WIDE_DIRS (16)
+
+/**
+ The number of files in each directory in the wide part of the tree.
+ */
+#define BENCH_CORPUS_WIDE_FILES (256)
+
+/**
+ The number of lines in each large log file.
+ */
+#define BENCH_CORPUS_LOG_LINES (200000)
+
+/**
+ The number of lines in the file containing VT colored output.
+ */
+#define BENCH_CORPUS_VT_LINES (50000)
+
+/**
+ The number of targets in the makefile used to measure a build where
+ everything is up to date.
+ */
+#define BENCH_CORPUS_MAKE_TARGETS (512)
+
+/**
+ The number of bytes buffered before writing to a file.
+ */
+#define BENCH_CORPUS_BUFFER_SIZE (256 * 1024)
+
+/**
+ State used while writing corpus files.  A single buffer is reused for each
+ file.
+ */
+typedef struct _BENCH_CORPUS_WRITER {
+
+    /**
+     A handle to the file currently being written.
+     */
+    HANDLE FileHandle;
+
+    /**
+     The encoding to write the file in, either CP_UTF8 or CP_UTF16.
+     */
+    DWORD Encoding;
+
+    /**
+     A buffer of data that has not yet been written to the file.
+     */
+    PUCHAR Buffer;
+
+    /**
+     The number of bytes in Buffer that contain data.
+     */
+    DWORD BytesInBuffer;
+
+    /**
+     A string used to format each line before it is encoded into Buffer.
+     */
+    YORI_STRING Line;
+
+    /**
+     State for the pseudo random number generator, so that every corpus is
+     identical.
+     */
+    DWORD Seed;
+
+    /**
+     Set to TRUE if any write has failed.
+     */
+    BOOLEAN Failed;
+} BENCH_CORPUS_WRITER, *PBENCH_CORPUS_WRITER;
+
+/**
+ Words used to build lines of text.
+ */
+CONST LPCTSTR BenchCorpusWords[] = {
+    _T("request"),
+    _T("completed"),
+    _T("connection"),
+    _T("timeout"),
+    _T("retrying"),
+    _T("cache"),
+    _T("miss"),
+    _T("allocated"),
+    _T("buffer"),
+    _T("r\x00e9sum\x00e9"),
+    _T("na\x00efve"),
+    _T("stra\x00df") _T("e"),
+    _T("\x20ac") _T("42"),
+    _T("worker"),
+    _T("queue"),
+    _T("flushed")
+};
+
+/**
+ Log levels used in log files.  The error level is used less often than
+ others so that searches for it find a small number of lines.
+ */
+CONST LPCTSTR BenchCorpusLevels[] = {
+    _T("INFO "),
+    _T("INFO "),
+    _T("DEBUG"),
+    _T("INFO "),
+    _T("WARN "),
+    _T("DEBUG"),
+    _T("INFO "),
+    _T("ERROR")
+};
+
+/**
+ Return the next number from a pseudo random sequence.
+
+ @param Writer Pointer to the writer containing the state of the sequence.
+
+ @return A pseudo random number.
+ */
+DWORD
+BenchCorpusRandom(
+    __inout PBENCH_CORPUS_WRITER Writer
+    )
+{
+    Writer->Seed = Writer->Seed * 1103515245 + 12345;
+    return (Writer->Seed >> 16) & 0x7FFF;
+}
+
+/**
+ Write any buffered data to the current file.
+
+ @param Writer Pointer to the writer.
+ */
+VOID
+BenchCorpusFlush(
+    __inout PBENCH_CORPUS_WRITER Writer
+    )
+{
+    DWORD BytesWritten;
+
+    if (Writer->BytesInBuffer > 0) {
+        if (!WriteFile(Writer->FileHandle, Writer->Buffer, Writer->BytesInBuffer, &BytesWritten, NULL) ||
+            BytesWritten != Writer->BytesInBuffer) {
+
+            Writer->Failed = TRUE;
+        }
+        Writer->BytesInBuffer = 0;
+    }
+}
+
+/**
+ Create a file and prepare to write lines to it.
+
+ @param Writer Pointer to the writer.
+
+ @param FileName The name of the file to create.  If it exists, it is
+        overwritten.
+
+ @param Encoding The encoding to write the file in, either CP_UTF8 or
+        CP_UTF16.  UTF16 files start with a byte order mark.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOLEAN
+BenchCorpusOpenFile(
+    __inout PBENCH_CORPUS_WRITER Writer,
+    __in PYORI_STRING FileName,
+    __in DWORD Encoding
+    )
+{
+    ASSERT(YoriLibIsStringNullTerminated(FileName));
+    Writer->FileHandle = CreateFile(FileName->StartOfString,
+                                    GENERIC_WRITE,
+                                    FILE_SHARE_READ | FILE_SHARE_DELETE,
+                                    NULL,
+                                    CREATE_ALWAYS,
+                                    FILE_ATTRIBUTE_NORMAL,
+                                    NULL);
+
+    if (Writer->FileHandle == INVALID_HANDLE_VALUE) {
+        Writer->FileHandle = NULL;
+        Writer->Failed = TRUE;
+        return FALSE;
+    }
+
+    Writer->Encoding = Encoding;
+    Writer->BytesInBuffer = 0;
+    if (Encoding == CP_UTF16) {
+        Writer->Buffer[0] = 0xFF;
+        Writer->Buffer[1] = 0xFE;
+        Writer->BytesInBuffer = 2;
+    }
+
+    return TRUE;
+}
+
+/**
+ Write any buffered data and close the current file.
+
+ @param Writer Pointer to the writer.
+ */
+VOID
+BenchCorpusCloseFile(
+    __inout PBENCH_CORPUS_WRITER Writer
+    )
+{
+    BenchCorpusFlush(Writer);
+    CloseHandle(Writer->FileHandle);
+    Writer->FileHandle = NULL;
+}
+
+/**
+ Encode the line in the writer's line buffer into the current file.
+
+ @param Writer Pointer to the writer.
+ */
+VOID
+BenchCorpusWriteLine(
+    __inout PBENCH_CORPUS_WRITER Writer
+    )
+{
+    DWORD BytesNeeded;
+
+    //
+    //  Each character can take at most three bytes in UTF-8 and two bytes
+    //  in UTF-16.
+    //
+
+    BytesNeeded = Writer->Line.LengthInChars * 3;
+    if (Writer->BytesInBuffer + BytesNeeded > BENCH_CORPUS_BUFFER_SIZE) {
+        BenchCorpusFlush(Writer);
+    }
+
+    if (Writer->Encoding == CP_UTF16) {
+        memcpy(&Writer->Buffer[Writer->BytesInBuffer], Writer->Line.StartOfString, Writer->Line.LengthInChars * sizeof(TCHAR));
+        Writer->BytesInBuffer += Writer->Line.LengthInChars * sizeof(TCHAR);
+    } else {
+        Writer->BytesInBuffer += WideCharToMultiByte(CP_UTF8,
+                                                     0,
+                                                     Writer->Line.StartOfString,
+                                                     Writer->Line.LengthInChars,
+                                                     (LPSTR)&Writer->Buffer[Writer->BytesInBuffer],
+                                                     BENCH_CORPUS_BUFFER_SIZE - Writer->BytesInBuffer,
+                                                     NULL,
+                                                     NULL);
+    }
+}
+
+/**
+ Format a line of text resembling prose into the writer's line buffer.
+
+ @param Writer Pointer to the writer.
+
+ @param WordCount The number of words to include in the line.
+ */
+VOID
+BenchCorpusFormatWords(
+    __inout PBENCH_CORPUS_WRITER Writer,
+    __in DWORD WordCount
+    )
+{
+    DWORD Index;
+    LPCTSTR Word;
+
+    Writer->Line.LengthInChars = 0;
+    for (Index = 0; Index < WordCount; Index++) {
+        Word = BenchCorpusWords[BenchCorpusRandom(Writer) % (sizeof(BenchCorpusWords)/sizeof(BenchCorpusWords[0]))];
+        Writer->Line.LengthInChars = Writer->Line.LengthInChars +
+            (YORI_ALLOC_SIZE_T)YoriLibSPrintfS(&Writer->Line.StartOfString[Writer->Line.LengthInChars],
+                                               Writer->Line.LengthAllocated - Writer->Line.LengthInChars,
+                                               (Index + 1 < WordCount)?_T("%s "):_T("%s\r\n"),
+                                               Word);
+    }
+}
+
+/**
+ Write a file containing lines of text resembling prose.
+
+ @param Writer Pointer to the writer.
+
+ @param FileName The name of the file to create.
+
+ @param LineCount The number of lines to write.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOLEAN
+BenchCorpusWriteTextFile(
+    __inout PBENCH_CORPUS_WRITER Writer,
+    __in PYORI_STRING FileName,
+    __in DWORD LineCount
+    )
+{
+    DWORD Index;
+
+    if (!BenchCorpusOpenFile(Writer, FileName, CP_UTF8)) {
+        return FALSE;
+    }
+
+    for (Index = 0; Index < LineCount; Index++) {
+        BenchCorpusFormatWords(Writer, 4 + BenchCorpusRandom(Writer) % 8);
+        BenchCorpusWriteLine(Writer);
+    }
+
+    BenchCorpusCloseFile(Writer);
+    return !Writer->Failed;
+}
+
+/**
+ Create directories containing many small files.  One set is nested deeply,
+ and another is wide with many files in each directory.
+
+ @param Writer Pointer to the writer.
+
+ @param Root The directory to create the tree in.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOLEAN
+BenchCorpusCreateTree(
+    __inout PBENCH_CORPUS_WRITER Writer,
+    __in PYORI_STRING Root
+    )
+{
+    YORI_STRING DirName;
+    YORI_STRING FileName;
+    DWORD Level;
+    DWORD DirIndex;
+    DWORD FileIndex;
+    BOOLEAN Result;
+
+    YoriLibInitEmptyString(&DirName);
+    YoriLibInitEmptyString(&FileName);
+    Result = FALSE;
+
+    //
+    //  Each level appends a component to the previous level's name, so
+    //  allocate enough space for the deepest level up front.
+    //
+
+    if (!YoriLibAllocateString(&DirName, Root->LengthInChars + sizeof("\\tree\\deep") + BENCH_CORPUS_DEEP_LEVELS * sizeof("\\d00"))) {
+        goto Exit;
+    }
+
+    DirName.LengthInChars = (YORI_ALLOC_SIZE_T)YoriLibSPrintfS(DirName.StartOfString, DirName.LengthAllocated, _T("%y\\tree\\deep"), Root);
+
+    for (Level = 0; Level < BENCH_CORPUS_DEEP_LEVELS; Level++) {
+        DirName.LengthInChars = DirName.LengthInChars +
+            (YORI_ALLOC_SIZE_T)YoriLibSPrintfS(&DirName.StartOfString[DirName.LengthInChars],
+                                               DirName.LengthAllocated - DirName.LengthInChars,
+                                               _T("\\d%02i"),
+                                               Level);
+        if (!YoriLibCreateDirectoryAndParents(&DirName)) {
+            goto Exit;
+        }
+
+        for (FileIndex = 0; FileIndex < BENCH_CORPUS_DEEP_FILES; FileIndex++) {
+            if (YoriLibYPrintf(&FileName, _T("%y\\file%i.txt"), &DirName, FileIndex) < 0 ||
+                !BenchCorpusWriteTextFile(Writer, &FileName, 4 + BenchCorpusRandom(Writer) % 16)) {
+                goto Exit;
+            }
+        }
+    }
+
+    for (DirIndex = 0; DirIndex < BENCH_CORPUS_WIDE_DIRS; DirIndex++) {
+        if (YoriLibYPrintf(&DirName, _T("%y\\tree\\wide\\w%02i"), Root, DirIndex) < 0 ||
+            !YoriLibCreateDirectoryAndParents(&DirName)) {
+            goto Exit;
+        }
+
+        for (FileIndex = 0; FileIndex < BENCH_CORPUS_WIDE_FILES; FileIndex++) {
+            if (YoriLibYPrintf(&FileName, _T("%y\\file%03i.txt"), &DirName, FileIndex) < 0 ||
+                !BenchCorpusWriteTextFile(Writer, &FileName, 4 + BenchCorpusRandom(Writer) % 64)) {
+                goto Exit;
+            }
+        }
+    }
+
+    Result = TRUE;
+
+Exit:
+    YoriLibFreeStringContents(&DirName);
+    YoriLibFreeStringContents(&FileName);
+    return Result;
+}
+
+/**
+ Write a large log file.
+
+ @param Writer Pointer to the writer.
+
+ @param FileName The name of the file to create.
+
+ @param Encoding The encoding of the file, either CP_UTF8 or CP_UTF16.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOLEAN
+BenchCorpusWriteLogFile(
+    __inout PBENCH_CORPUS_WRITER Writer,
+    __in PYORI_STRING FileName,
+    __in DWORD Encoding
+    )
+{
+    DWORD Index;
+    DWORD Level;
+    DWORD Milliseconds;
+    YORI_STRING Message;
+
+    if (!YoriLibAllocateString(&Message, Writer->Line.LengthAllocated)) {
+        return FALSE;
+    }
+
+    if (!BenchCorpusOpenFile(Writer, FileName, Encoding)) {
+        YoriLibFreeStringContents(&Message);
+        return FALSE;
+    }
+
+    //
+    //  Format the words into the line buffer, then move them aside so the
+    //  line can be formatted with a timestamp and level.
+    //
+
+    Milliseconds = 0;
+    for (Index = 0; Index < BENCH_CORPUS_LOG_LINES; Index++) {
+        BenchCorpusFormatWords(Writer, 6 + BenchCorpusRandom(Writer) % 10);
+        memcpy(Message.StartOfString, Writer->Line.StartOfString, Writer->Line.LengthInChars * sizeof(TCHAR));
+        Message.LengthInChars = Writer->Line.LengthInChars;
+
+        Milliseconds = Milliseconds + BenchCorpusRandom(Writer) % 50;
+        Level = BenchCorpusRandom(Writer) % (sizeof(BenchCorpusLevels)/sizeof(BenchCorpusLevels[0]));
+        Writer->Line.LengthInChars = (YORI_ALLOC_SIZE_T)
+            YoriLibSPrintfS(Writer->Line.StartOfString,
+                            Writer->Line.LengthAllocated,
+                            _T("2026-01-01 %02i:%02i:%02i.%03i [%s] thread %04x: %y"),
+                            (Milliseconds / 3600000) % 24,
+                            (Milliseconds / 60000) % 60,
+                            (Milliseconds / 1000) % 60,
+                            Milliseconds % 1000,
+                            BenchCorpusLevels[Level],
+                            BenchCorpusRandom(Writer) % 64,
+                            &Message);
+        BenchCorpusWriteLine(Writer);
+    }
+
+    BenchCorpusCloseFile(Writer);
+    YoriLibFreeStringContents(&Message);
+    return !Writer->Failed;
+}
+
+/**
+ Write a file containing text colored with VT escape sequences, resembling
+ the output of a build or test run.
+
+ @param Writer Pointer to the writer.
+
+ @param FileName The name of the file to create.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOLEAN
+BenchCorpusWriteVtFile(
+    __inout PBENCH_CORPUS_WRITER Writer,
+    __in PYORI_STRING FileName
+    )
+{
+    DWORD Index;
+    DWORD Color;
+
+    if (!BenchCorpusOpenFile(Writer, FileName, CP_UTF8)) {
+        return FALSE;
+    }
+
+    for (Index = 0; Index < BENCH_CORPUS_VT_LINES; Index++) {
+        Color = BenchCorpusRandom(Writer);
+        Writer->Line.LengthInChars = (YORI_ALLOC_SIZE_T)
+            YoriLibSPrintfS(Writer->Line.StartOfString,
+                            Writer->Line.LengthAllocated,
+                            _T("\x1b[0;%i;%im%05i\x1b[0m \x1b[1;%im%s\x1b[0m compiling module%03i.c \x1b[%im[%i%%]\x1b[0m\r\n"),
+                            30 + Color % 8,
+                            40 + (Color >> 3) % 8,
+                            Index,
+                            31 + (Color >> 6) % 7,
+                            (Color % 16 == 0)?_T("warning"):_T("ok"),
+                            Index % 512,
+                            32 + (Color >> 9) % 6,
+                            Index * 100 / BENCH_CORPUS_VT_LINES);
+        BenchCorpusWriteLine(Writer);
+    }
+
+    BenchCorpusCloseFile(Writer);
+    return !Writer->Failed;
+}
+
+/**
+ Create a makefile, its sources and its targets, such that all targets are
+ up to date and building does nothing.  Sources are written before targets
+ so targets are never older than their sources.
+
+ @param Writer Pointer to the writer.
+
+ @param Root The directory to create the build directory in.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOLEAN
+BenchCorpusCreateBuild(
+    __inout PBENCH_CORPUS_WRITER Writer,
+    __in PYORI_STRING Root
+    )
+{
+    YORI_STRING FileName;
+    DWORD Index;
+    BOOLEAN Result;
+
+    YoriLibInitEmptyString(&FileName);
+    Result = FALSE;
+
+    if (YoriLibYPrintf(&FileName, _T("%y\\build\\src"), Root) < 0 ||
+        !YoriLibCreateDirectoryAndParents(&FileName)) {
+        goto Exit;
+    }
+
+    if (YoriLibYPrintf(&FileName, _T("%y\\build\\obj"), Root) < 0 ||
+        !YoriLibCreateDirectoryAndParents(&FileName)) {
+        goto Exit;
+    }
+
+    for (Index = 0; Index < BENCH_CORPUS_MAKE_TARGETS; Index++) {
+        if (YoriLibYPrintf(&FileName, _T("%y\\build\\src\\mod%03i.c"), Root, Index) < 0 ||
+            !BenchCorpusWriteTextFile(Writer, &FileName, 16)) {
+            goto Exit;
+        }
+    }
+
+    for (Index = 0; Index < BENCH_CORPUS_MAKE_TARGETS; Index++) {
+        if (YoriLibYPrintf(&FileName, _T("%y\\build\\obj\\mod%03i.obj"), Root, Index) < 0 ||
+            !BenchCorpusWriteTextFile(Writer, &FileName, 4)) {
+            goto Exit;
+        }
+    }
+
+    if (YoriLibYPrintf(&FileName, _T("%y\\build\\YMkFile"), Root) < 0 ||
+        !BenchCorpusOpenFile(Writer, &FileName, CP_UTF8)) {
+        goto Exit;
+    }
+
+    YoriLibYPrintf(&Writer->Line, _T("\r\nOBJS=\\\r\n"));
+    BenchCorpusWriteLine(Writer);
+    for (Index = 0; Index < BENCH_CORPUS_MAKE_TARGETS; Index++) {
+        YoriLibYPrintf(&Writer->Line, _T("\t obj\\mod%03i.obj \\\r\n"), Index);
+        BenchCorpusWriteLine(Writer);
+    }
+
+    YoriLibYPrintf(&Writer->Line, _T("\r\nall: $(OBJS)\r\n"));
+    BenchCorpusWriteLine(Writer);
+    for (Index = 0; Index < BENCH_CORPUS_MAKE_TARGETS; Index++) {
+        YoriLibYPrintf(&Writer->Line, _T("\r\nobj\\mod%03i.obj: src\\mod%03i.c\r\n\t@copy src\\mod%03i.c obj\\mod%03i.obj\r\n"), Index, Index, Index, Index);
+        BenchCorpusWriteLine(Writer);
+    }
+
+    BenchCorpusCloseFile(Writer);
+    Result = !Writer->Failed;
+
+Exit:
+    YoriLibFreeStringContents(&FileName);
+    return Result;
+}
+
+/**
+ Create a corpus of files for measuring the performance of tools.  The
+ corpus contains:
+
+  - tree, containing deeply nested directories and wide directories with
+    many small files
+  - logs, containing large log files in UTF-8 and UTF-16
+  - vt, containing a file with text colored with VT escape sequences
+  - build, containing a makefile whose targets are all up to date
+
+ @param Directory The directory to create the corpus in.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOLEAN
+BenchCreateCorpus(
+    __in PYORI_STRING Directory
+    )
+{
+    BENCH_CORPUS_WRITER Writer;
+    YORI_STRING Root;
+    YORI_STRING FileName;
+    BOOLEAN Result;
+
+    ZeroMemory(&Writer, sizeof(Writer));
+    Writer.Seed = 1;
+
+    YoriLibInitEmptyString(&Root);
+    YoriLibInitEmptyString(&FileName);
+    Result = FALSE;
+
+    Writer.Buffer = YoriLibMalloc(BENCH_CORPUS_BUFFER_SIZE);
+    if (Writer.Buffer == NULL) {
+        return FALSE;
+    }
+
+    if (!YoriLibAllocateString(&Writer.Line, 1024)) {
+        goto Exit;
+    }
+
+    if (!YoriLibUserStringToSingleFilePath(Directory, TRUE, &Root)) {
+        goto Exit;
+    }
+
+    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("Creating tree...\n"));
+    if (!BenchCorpusCreateTree(&Writer, &Root)) {
+        goto Exit;
+    }
+
+    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("Creating logs...\n"));
+    if (YoriLibYPrintf(&FileName, _T("%y\\logs"), &Root) < 0 ||
+        !YoriLibCreateDirectoryAndParents(&FileName)) {
+        goto Exit;
+    }
+
+    if (YoriLibYPrintf(&FileName, _T("%y\\logs\\utf8.log"), &Root) < 0 ||
+        !BenchCorpusWriteLogFile(&Writer, &FileName, CP_UTF8)) {
+        goto Exit;
+    }
+
+    if (YoriLibYPrintf(&FileName, _T("%y\\logs\\utf16.log"), &Root) < 0 ||
+        !BenchCorpusWriteLogFile(&Writer, &FileName, CP_UTF16)) {
+        goto Exit;
+    }
+
+    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("Creating colored output...\n"));
+    if (YoriLibYPrintf(&FileName, _T("%y\\vt"), &Root) < 0 ||
+        !YoriLibCreateDirectoryAndParents(&FileName)) {
+        goto Exit;
+    }
+
+    if (YoriLibYPrintf(&FileName, _T("%y\\vt\\color.txt"), &Root) < 0 ||
+        !BenchCorpusWriteVtFile(&Writer, &FileName)) {
+        goto Exit;
+    }
+
+    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("Creating build...\n"));
+    if (!BenchCorpusCreateBuild(&Writer, &Root)) {
+        goto Exit;
+    }
+
+    Result = TRUE;
+
+Exit:
+    if (!Result) {
+        if (FileName.LengthInChars > 0) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("yoribench: failed to create %y\n"), &FileName);
+        } else {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("yoribench: failed to create corpus\n"));
+        }
+    }
+    YoriLibFreeStringContents(&FileName);
+    YoriLibFreeStringContents(&Root);
+    YoriLibFreeStringContents(&Writer.Line);
+    YoriLibFree(Writer.Buffer);
+    return Result;
+}
+
+// vim:sw=4:ts=4:et:
@@ -0,0 +1,291 @@
+/**
+ * @file bench/crt.c
+ *
+ * Yori shell benchmark memory routines
+ *
+ * Copyright (c) 2026 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <yoripch.h>
+#include <yorilib.h>
+#include "bench.h"
+
+/**
+ The number of bytes in each buffer used for large memory operations.
+ */
+#define BENCH_MEM_LARGE_SIZE (64 * 1024)
+
+/**
+ The number of bytes copied by the small memcpy benchmark.
+ */
+#define BENCH_MEM_SMALL_SIZE (32)
+
+/**
+ The result of the most recent memcmp, kept so that the comparisons can't
+ be optimized away.
+ */
+volatile int BenchMemcmpResult;
+
+/**
+ Allocate and initialize two buffers for memory benchmarks.
+
+ @param Source On successful completion, updated to point to a buffer
+        containing a pattern.
+
+ @param Dest On successful completion, updated to point to a buffer
+        containing the same pattern.  This is part of the same allocation
+        as Source and is not freed separately.
+
+ @return TRUE to indicate success, FALSE on allocation failure.
+ */
+BOOLEAN
+BenchMemAllocateBuffers(
+    __out PUCHAR *Source,
+    __out PUCHAR *Dest
+    )
+{
+    PUCHAR Buffer;
+    DWORD Index;
+
+    Buffer = YoriLibMalloc(BENCH_MEM_LARGE_SIZE * 2);
+    if (Buffer == NULL) {
+        return FALSE;
+    }
+
+    for (Index = 0; Index < BENCH_MEM_LARGE_SIZE; Index++) {
+        Buffer[Index] = (UCHAR)(Index * 7);
+        Buffer[BENCH_MEM_LARGE_SIZE + Index] = (UCHAR)(Index * 7);
+    }
+
+    *Source = Buffer;
+    *Dest = Buffer + BENCH_MEM_LARGE_SIZE;
+    return TRUE;
+}
+
+/**
+ A benchmark to copy a large buffer with memcpy.
+
+ @param Bench Pointer to the benchmark state.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOLEAN
+BenchMemcpy(
+    __inout PYORI_BENCH Bench
+    )
+{
+    PUCHAR Source;
+    PUCHAR Dest;
+    DWORDLONG Index;
+
+    if (!BenchMemAllocateBuffers(&Source, &Dest)) {
+        return FALSE;
+    }
+
+    BenchStartTimer(Bench);
+    for (Index = 0; Index < Bench->Iterations; Index++) {
+        memcpy(Dest, Source, BENCH_MEM_LARGE_SIZE);
+    }
+    BenchStopTimer(Bench);
+
+    Bench->BytesProcessed = Bench->Iterations * BENCH_MEM_LARGE_SIZE;
+    YoriLibFree(Source);
+    return TRUE;
+}
+
+/**
+ A benchmark to copy a small buffer with memcpy.  The source offset varies
+ so that unaligned copies are included.
+
+ @param Bench Pointer to the benchmark state.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOLEAN
+BenchMemcpySmall(
+    __inout PYORI_BENCH Bench
+    )
+{
+    PUCHAR Source;
+    PUCHAR Dest;
+    DWORDLONG Index;
+
+    if (!BenchMemAllocateBuffers(&Source, &Dest)) {
+        return FALSE;
+    }
+
+    BenchStartTimer(Bench);
+    for (Index = 0; Index < Bench->Iterations; Index++) {
+        memcpy(Dest, &Source[Index & 7], BENCH_MEM_SMALL_SIZE);
+    }
+    BenchStopTimer(Bench);
+
+    Bench->BytesProcessed = Bench->Iterations * BENCH_MEM_SMALL_SIZE;
+    YoriLibFree(Source);
+    return TRUE;
+}
+
+/**
+ A benchmark to copy a large buffer to an overlapping destination with
+ memmove.
+
+ @param Bench Pointer to the benchmark state.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOLEAN
+BenchMemmove(
+    __inout PYORI_BENCH Bench
+    )
+{
+    PUCHAR Source;
+    PUCHAR Dest;
+    DWORDLONG Index;
+
+    if (!BenchMemAllocateBuffers(&Source, &Dest)) {
+        return FALSE;
+    }
+
+    //
+    //  Alternate the direction of the move so that both overlapping cases
+    //  are measured.
+    //
+
+    BenchStartTimer(Bench);
+    for (Index = 0; Index < Bench->Iterations; Index++) {
+        if (Index & 1) {
+            memmove(Source, Source + 64, BENCH_MEM_LARGE_SIZE);
+        } else {
+            memmove(Source + 64, Source, BENCH_MEM_LARGE_SIZE);
+        }
+    }
+    BenchStopTimer(Bench);
+
+    Bench->BytesProcessed = Bench->Iterations * BENCH_MEM_LARGE_SIZE;
+    YoriLibFree(Source);
+    return TRUE;
+}
+
+/**
+ A benchmark to fill a large buffer with memset.
+
+ @param Bench Pointer to the benchmark state.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOLEAN
+BenchMemset(
+    __inout PYORI_BENCH Bench
+    )
+{
+    PUCHAR Source;
+    PUCHAR Dest;
+    DWORDLONG Index;
+
+    if (!BenchMemAllocateBuffers(&Source, &Dest)) {
+        return FALSE;
+    }
+
+    BenchStartTimer(Bench);
+    for (Index = 0; Index < Bench->Iterations; Index++) {
+        memset(Dest, (UCHAR)Index, BENCH_MEM_LARGE_SIZE);
+    }
+    BenchStopTimer(Bench);
+
+    Bench->BytesProcessed = Bench->Iterations * BENCH_MEM_LARGE_SIZE;
+    YoriLibFree(Source);
+    return TRUE;
+}
+
+/**
+ A benchmark to compare two identical large buffers with memcmp.
+
+ @param Bench Pointer to the benchmark state.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOLEAN
+BenchMemcmp(
+    __inout PYORI_BENCH Bench
+    )
+{
+    PUCHAR Source;
+    PUCHAR Dest;
+    DWORDLONG Index;
+
+    if (!BenchMemAllocateBuffers(&Source, &Dest)) {
+        return FALSE;
+    }
+
+    BenchStartTimer(Bench);
+    for (Index = 0; Index < Bench->Iterations; Index++) {
+        BenchMemcmpResult = memcmp(Dest, Source, BENCH_MEM_LARGE_SIZE);
+    }
+    BenchStopTimer(Bench);
+
+    Bench->BytesProcessed = Bench->Iterations * BENCH_MEM_LARGE_SIZE;
+    YoriLibFree(Source);
+    return (BOOLEAN)(BenchMemcmpResult == 0);
+}
+
+/**
+ A benchmark to calculate the PE checksum of a large buffer.  The buffer
+ does not contain a PE header, so every byte is included in the sum.
+
+ @param Bench Pointer to the benchmark state.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOLEAN
+BenchPeChecksum(
+    __inout PYORI_BENCH Bench
+    )
+{
+    PUCHAR Source;
+    PUCHAR Dest;
+    DWORD HeaderChecksum;
+    DWORD Checksum;
+    DWORD FirstChecksum;
+    DWORDLONG Index;
+    BOOLEAN Result;
+
+    if (!BenchMemAllocateBuffers(&Source, &Dest)) {
+        return FALSE;
+    }
+
+    Result = TRUE;
+    FirstChecksum = YoriLibPeChecksumBuffer(Source, BENCH_MEM_LARGE_SIZE, &HeaderChecksum);
+
+    BenchStartTimer(Bench);
+    for (Index = 0; Index < Bench->Iterations; Index++) {
+        Checksum = YoriLibPeChecksumBuffer(Source, BENCH_MEM_LARGE_SIZE, &HeaderChecksum);
+        if (Checksum != FirstChecksum) {
+            Result = FALSE;
+        }
+    }
+    BenchStopTimer(Bench);
+
+    Bench->BytesProcessed = Bench->Iterations * BENCH_MEM_LARGE_SIZE;
+    YoriLibFree(Source);
+    return Result;
+}
+
+// vim:sw=4:ts=4:et:
@@ -0,0 +1,246 @@
+/**
+ * @file bench/hash.c
+ *
+ * Yori shell benchmark hash table routines
+ *
+ * Copyright (c) 2026 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <yoripch.h>
+#include <yorilib.h>
+#include "bench.h"
+
+/**
+ The number of keys inserted into a hash table in each iteration.
+ */
+#define BENCH_HASH_KEY_COUNT (4096)
+
+/**
+ The number of characters allocated for each key.
+ */
+#define BENCH_HASH_KEY_CHARS (32)
+
+/**
+ The number of buckets that a hash table is created with.  This is small
+ so that inserting keys includes the cost of growing the table.
+ */
+#define BENCH_HASH_INITIAL_BUCKETS (16)
+
+/**
+ A set of keys and hash entries used by the hash table benchmarks.
+ */
+typedef struct _BENCH_HASH_KEYS {
+
+    /**
+     An array of BENCH_HASH_KEY_COUNT keys.  The hash table refers to these
+     strings rather than copying them.
+     */
+    PYORI_STRING Keys;
+
+    /**
+     An array of BENCH_HASH_KEY_COUNT hash entries.
+     */
+    PYORI_HASH_ENTRY Entries;
+
+    /**
+     The buffer containing the characters of every key.
+     */
+    LPTSTR KeyBuffer;
+} BENCH_HASH_KEYS, *PBENCH_HASH_KEYS;
+
+/**
+ Free a set of keys allocated with BenchHashAllocateKeys.
+
+ @param HashKeys Pointer to the keys to free.
+ */
+VOID
+BenchHashFreeKeys(
+    __inout PBENCH_HASH_KEYS HashKeys
+    )
+{
+    if (HashKeys->Keys != NULL) {
+        YoriLibFree(HashKeys->Keys);
+        HashKeys->Keys = NULL;
+    }
+    if (HashKeys->Entries != NULL) {
+        YoriLibFree(HashKeys->Entries);
+        HashKeys->Entries = NULL;
+    }
+    if (HashKeys->KeyBuffer != NULL) {
+        YoriLibFree(HashKeys->KeyBuffer);
+        HashKeys->KeyBuffer = NULL;
+    }
+}
+
+/**
+ Allocate a set of keys resembling file names, and hash entries for each.
+
+ @param HashKeys On successful completion, populated with the keys.
+
+ @return TRUE to indicate success, FALSE on allocation failure.
+ */
+BOOLEAN
+BenchHashAllocateKeys(
+    __out PBENCH_HASH_KEYS HashKeys
+    )
+{
+    YORI_ALLOC_SIZE_T Index;
+    PYORI_STRING Key;
+
+    ZeroMemory(HashKeys, sizeof(BENCH_HASH_KEYS));
+    HashKeys->Keys = YoriLibMalloc(BENCH_HASH_KEY_COUNT * sizeof(YORI_STRING));
+    HashKeys->Entries = YoriLibMalloc(BENCH_HASH_KEY_COUNT * sizeof(YORI_HASH_ENTRY));
+    HashKeys->KeyBuffer = YoriLibMalloc(BENCH_HASH_KEY_COUNT * BENCH_HASH_KEY_CHARS * sizeof(TCHAR));
+    if (HashKeys->Keys == NULL ||
+        HashKeys->Entries == NULL ||
+        HashKeys->KeyBuffer == NULL) {
+
+        BenchHashFreeKeys(HashKeys);
+        return FALSE;
+    }
+
+    for (Index = 0; Index < BENCH_HASH_KEY_COUNT; Index++) {
+        Key = &HashKeys->Keys[Index];
+        YoriLibInitEmptyString(Key);
+        Key->StartOfString = &HashKeys->KeyBuffer[Index * BENCH_HASH_KEY_CHARS];
+        Key->LengthAllocated = BENCH_HASH_KEY_CHARS;
+        Key->LengthInChars = YoriLibSPrintf(Key->StartOfString, _T("Source%i\\File%i.obj"), Index % 37, Index);
+    }
+
+    return TRUE;
+}
+
+/**
+ A benchmark to insert keys into a hash table, starting from a small table
+ so that growth is included.  Each operation inserts one key, and the cost
+ of removing the key afterwards is included.
+
+ @param Bench Pointer to the benchmark state.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOLEAN
+BenchHashInsert(
+    __inout PYORI_BENCH Bench
+    )
+{
+    BENCH_HASH_KEYS HashKeys;
+    PYORI_HASH_TABLE HashTable;
+    YORI_ALLOC_SIZE_T Index;
+    DWORDLONG Iteration;
+    BOOLEAN Result;
+
+    if (!BenchHashAllocateKeys(&HashKeys)) {
+        return FALSE;
+    }
+
+    Result = TRUE;
+    BenchStartTimer(Bench);
+    for (Iteration = 0; Iteration < Bench->Iterations; Iteration++) {
+        HashTable = YoriLibAllocateHashTable(BENCH_HASH_INITIAL_BUCKETS);
+        if (HashTable == NULL) {
+            Result = FALSE;
+            break;
+        }
+        for (Index = 0; Index < BENCH_HASH_KEY_COUNT; Index++) {
+            YoriLibHashInsertByKey(HashTable, &HashKeys.Keys[Index], NULL, &HashKeys.Entries[Index]);
+        }
+        for (Index = 0; Index < BENCH_HASH_KEY_COUNT; Index++) {
+            YoriLibHashRemoveByEntry(&HashKeys.Entries[Index]);
+        }
+        YoriLibFreeEmptyHashTable(HashTable);
+    }
+    BenchStopTimer(Bench);
+
+    Bench->OperationsPerIteration = BENCH_HASH_KEY_COUNT;
+    BenchHashFreeKeys(&HashKeys);
+    return Result;
+}
+
+/**
+ A benchmark to look up keys in a hash table.  Each operation looks up one
+ key that is present, using a differently cased copy of the key.
+
+ @param Bench Pointer to the benchmark state.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOLEAN
+BenchHashLookup(
+    __inout PYORI_BENCH Bench
+    )
+{
+    BENCH_HASH_KEYS HashKeys;
+    BENCH_HASH_KEYS LookupKeys;
+    PYORI_HASH_TABLE HashTable;
+    PYORI_STRING Key;
+    YORI_ALLOC_SIZE_T Index;
+    YORI_ALLOC_SIZE_T CharIndex;
+    DWORDLONG Iteration;
+    BOOLEAN Result;
+
+    if (!BenchHashAllocateKeys(&HashKeys)) {
+        return FALSE;
+    }
+
+    if (!BenchHashAllocateKeys(&LookupKeys)) {
+        BenchHashFreeKeys(&HashKeys);
+        return FALSE;
+    }
+
+    HashTable = YoriLibAllocateHashTable(BENCH_HASH_INITIAL_BUCKETS);
+    if (HashTable == NULL) {
+        BenchHashFreeKeys(&LookupKeys);
+        BenchHashFreeKeys(&HashKeys);
+        return FALSE;
+    }
+
+    for (Index = 0; Index < BENCH_HASH_KEY_COUNT; Index++) {
+        YoriLibHashInsertByKey(HashTable, &HashKeys.Keys[Index], NULL, &HashKeys.Entries[Index]);
+        Key = &LookupKeys.Keys[Index];
+        for (CharIndex = 0; CharIndex < Key->LengthInChars; CharIndex++) {
+            Key->StartOfString[CharIndex] = YoriLibUpcaseChar(Key->StartOfString[CharIndex]);
+        }
+    }
+
+    Result = TRUE;
+    BenchStartTimer(Bench);
+    for (Iteration = 0; Iteration < Bench->Iterations; Iteration++) {
+        for (Index = 0; Index < BENCH_HASH_KEY_COUNT; Index++) {
+            if (YoriLibHashLookupByKey(HashTable, &LookupKeys.Keys[Index]) != &HashKeys.Entries[Index]) {
+                Result = FALSE;
+            }
+        }
+    }
+    BenchStopTimer(Bench);
+
+    Bench->OperationsPerIteration = BENCH_HASH_KEY_COUNT;
+
+    for (Index = 0; Index < BENCH_HASH_KEY_COUNT; Index++) {
+        YoriLibHashRemoveByEntry(&HashKeys.Entries[Index]);
+    }
+    YoriLibFreeEmptyHashTable(HashTable);
+    BenchHashFreeKeys(&LookupKeys);
+    BenchHashFreeKeys(&HashKeys);
+    return Result;
+}
+
+// vim:sw=4:ts=4:et:
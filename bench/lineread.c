@@ -0,0 +1,327 @@
+/**
+ * @file bench/lineread.c
+ *
+ * Yori shell benchmark line reading and encoding routines
+ *
+ * Copyright (c) 2026 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <yoripch.h>
+#include <yorilib.h>
+#include "bench.h"
+
+/**
+ The number of lines written to the file used by line reading benchmarks.
+ */
+#define BENCH_LINE_COUNT (4096)
+
+/**
+ The number of bytes of input converted by the multibyte input benchmark.
+ */
+#define BENCH_MULTIBYTE_SIZE (64 * 1024)
+
+/**
+ A line of UTF-8 text containing characters that require two and three
+ bytes to encode.
+ */
+CONST CHAR BenchUtf8Line[] = "caf\xC3\xA9 na\xC3\xAFve r\xC3\xA9sum\xC3\xA9 \xE2\x82\xAC""5 \xE2\x80\x94 stra\xC3\x9F""e \xC3\xBC""ber";
+
+/**
+ Create a temporary file containing lines of text in the specified
+ encoding.
+
+ @param Encoding The encoding to write, either CP_UTF8 or CP_UTF16.
+
+ @param Ascii If TRUE, lines contain only ASCII characters.  If FALSE,
+        lines contain characters outside of ASCII.
+
+ @param FileHandle On successful completion, updated to contain a handle to
+        the file.
+
+ @param FileName On successful completion, updated to contain the name of
+        the file, which the caller should delete.
+
+ @param FileSize On successful completion, updated to contain the number
+        of bytes in the file.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOLEAN
+BenchReadLineCreateFile(
+    __in DWORD Encoding,
+    __in BOOLEAN Ascii,
+    __out PHANDLE FileHandle,
+    __out PYORI_STRING FileName,
+    __out PDWORD FileSize
+    )
+{
+    YORI_STRING TempPath;
+    YORI_STRING Prefix;
+    YORI_STRING Line;
+    YORI_STRING Text;
+    HANDLE Handle;
+    PUCHAR Buffer;
+    DWORD BufferSize;
+    DWORD Offset;
+    DWORD Index;
+    DWORD BytesWritten;
+    YORI_ALLOC_SIZE_T LineLength;
+    BOOLEAN Result;
+
+    YoriLibInitEmptyString(&Text);
+    if (!Ascii) {
+        Text.LengthAllocated = YoriLibGetMultibyteInputSizeNeeded(BenchUtf8Line, sizeof(BenchUtf8Line) - 1);
+        if (!YoriLibAllocateString(&Text, Text.LengthAllocated)) {
+            return FALSE;
+        }
+        Text.LengthInChars = YoriLibMultibyteInput(BenchUtf8Line, sizeof(BenchUtf8Line) - 1, Text.StartOfString, Text.LengthAllocated);
+    } else {
+        YoriLibConstantString(&Text, _T("cafe naive resume EUR5 - strasse uber"));
+    }
+
+    if (!YoriLibAllocateString(&Line, 128)) {
+        YoriLibFreeStringContents(&Text);
+        return FALSE;
+    }
+
+    //
+    //  Each line is at most 128 characters, which is at most 384 bytes in
+    //  UTF-8.
+    //
+
+    BufferSize = BENCH_LINE_COUNT * 128 * 3 + 2;
+    Buffer = YoriLibMalloc(BufferSize);
+    if (Buffer == NULL) {
+        YoriLibFreeStringContents(&Line);
+        YoriLibFreeStringContents(&Text);
+        return FALSE;
+    }
+
+    Offset = 0;
+    if (Encoding == CP_UTF16) {
+        Buffer[0] = 0xFF;
+        Buffer[1] = 0xFE;
+        Offset = 2;
+    }
+
+    for (Index = 0; Index < BENCH_LINE_COUNT; Index++) {
+        LineLength = (YORI_ALLOC_SIZE_T)YoriLibSPrintfS(Line.StartOfString, Line.LengthAllocated, _T("Line %05i of a text file, %y\r\n"), Index, &Text);
+        if (Encoding == CP_UTF16) {
+            memcpy(&Buffer[Offset], Line.StartOfString, LineLength * sizeof(TCHAR));
+            Offset += LineLength * sizeof(TCHAR);
+        } else {
+            Offset += WideCharToMultiByte(CP_UTF8, 0, Line.StartOfString, LineLength, (LPSTR)&Buffer[Offset], BufferSize - Offset, NULL, NULL);
+        }
+    }
+
+    YoriLibFreeStringContents(&Line);
+    YoriLibFreeStringContents(&Text);
+
+    Result = FALSE;
+    YoriLibInitEmptyString(FileName);
+    YoriLibConstantString(&Prefix, _T("ybench"));
+    if (YoriLibGetTempPath(&TempPath, 0)) {
+        if (YoriLibGetTempFileName(&TempPath, &Prefix, &Handle, FileName)) {
+            if (WriteFile(Handle, Buffer, Offset, &BytesWritten, NULL) &&
+                BytesWritten == Offset) {
+
+                *FileHandle = Handle;
+                *FileSize = Offset;
+                Result = TRUE;
+            } else {
+                CloseHandle(Handle);
+                DeleteFile(FileName->StartOfString);
+                YoriLibFreeStringContents(FileName);
+            }
+        }
+        YoriLibFreeStringContents(&TempPath);
+    }
+
+    YoriLibFree(Buffer);
+    return Result;
+}
+
+/**
+ Read every line from a temporary file in a specified encoding a number of
+ times.
+
+ @param Bench Pointer to the benchmark state.
+
+ @param Encoding The encoding of the file, either CP_UTF8 or CP_UTF16.
+
+ @param Ascii If TRUE, lines contain only ASCII characters.  If FALSE,
+        lines contain characters outside of ASCII.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOLEAN
+BenchReadLine(
+    __inout PYORI_BENCH Bench,
+    __in DWORD Encoding,
+    __in BOOLEAN Ascii
+    )
+{
+    HANDLE FileHandle;
+    YORI_STRING FileName;
+    YORI_STRING LineString;
+    YORI_LIB_LINE_ENDING LineEnding;
+    BOOL TimeoutReached;
+    PVOID LineContext;
+    DWORD FileSize;
+    DWORD LineCount;
+    DWORD OriginalEncoding;
+    DWORDLONG Index;
+    BOOLEAN Result;
+
+    OriginalEncoding = YoriLibGetMultibyteInputEncoding();
+    YoriLibSetMultibyteInputEncoding(CP_UTF8);
+    if (!BenchReadLineCreateFile(Encoding, Ascii, &FileHandle, &FileName, &FileSize)) {
+        YoriLibSetMultibyteInputEncoding(OriginalEncoding);
+        return FALSE;
+    }
+
+    YoriLibSetMultibyteInputEncoding(Encoding);
+    YoriLibInitEmptyString(&LineString);
+    Result = TRUE;
+
+    BenchStartTimer(Bench);
+    for (Index = 0; Index < Bench->Iterations; Index++) {
+        SetFilePointer(FileHandle, 0, NULL, FILE_BEGIN);
+        LineContext = NULL;
+        LineCount = 0;
+        while (YoriLibReadLineToStringEx(&LineString, &LineContext, TRUE, INFINITE, FileHandle, &LineEnding, &TimeoutReached)) {
+            LineCount++;
+        }
+        YoriLibLineReadClose(LineContext);
+        if (LineCount != BENCH_LINE_COUNT) {
+            Result = FALSE;
+            break;
+        }
+    }
+    BenchStopTimer(Bench);
+
+    Bench->OperationsPerIteration = BENCH_LINE_COUNT;
+    Bench->BytesProcessed = Bench->Iterations * FileSize;
+
+    YoriLibSetMultibyteInputEncoding(OriginalEncoding);
+    YoriLibFreeStringContents(&LineString);
+    CloseHandle(FileHandle);
+    DeleteFile(FileName.StartOfString);
+    YoriLibFreeStringContents(&FileName);
+    return Result;
+}
+
+/**
+ A benchmark to read lines from a file containing ASCII text in UTF-8.
+
+ @param Bench Pointer to the benchmark state.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOLEAN
+BenchReadLineAscii(
+    __inout PYORI_BENCH Bench
+    )
+{
+    return BenchReadLine(Bench, CP_UTF8, TRUE);
+}
+
+/**
+ A benchmark to read lines from a file containing non-ASCII text in UTF-8.
+
+ @param Bench Pointer to the benchmark state.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOLEAN
+BenchReadLineUtf8(
+    __inout PYORI_BENCH Bench
+    )
+{
+    return BenchReadLine(Bench, CP_UTF8, FALSE);
+}
+
+/**
+ A benchmark to read lines from a file containing UTF-16 text.
+
+ @param Bench Pointer to the benchmark state.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOLEAN
+BenchReadLineUtf16(
+    __inout PYORI_BENCH Bench
+    )
+{
+    return BenchReadLine(Bench, CP_UTF16, FALSE);
+}
+
+/**
+ A benchmark to convert UTF-8 text containing a mix of ASCII and non-ASCII
+ characters to the native character set.
+
+ @param Bench Pointer to the benchmark state.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOLEAN
+BenchMultibyteInput(
+    __inout PYORI_BENCH Bench
+    )
+{
+    PCHAR Input;
+    YORI_STRING Output;
+    DWORD OriginalEncoding;
+    DWORD Offset;
+    DWORDLONG Index;
+
+    Input = YoriLibMalloc(BENCH_MULTIBYTE_SIZE);
+    if (Input == NULL) {
+        return FALSE;
+    }
+
+    for (Offset = 0; Offset < BENCH_MULTIBYTE_SIZE; Offset++) {
+        Input[Offset] = BenchUtf8Line[Offset % (sizeof(BenchUtf8Line) - 1)];
+    }
+
+    if (!YoriLibAllocateString(&Output, BENCH_MULTIBYTE_SIZE)) {
+        YoriLibFree(Input);
+        return FALSE;
+    }
+
+    OriginalEncoding = YoriLibGetMultibyteInputEncoding();
+    YoriLibSetMultibyteInputEncoding(CP_UTF8);
+
+    BenchStartTimer(Bench);
+    for (Index = 0; Index < Bench->Iterations; Index++) {
+        Output.LengthInChars = YoriLibMultibyteInput(Input, BENCH_MULTIBYTE_SIZE, Output.StartOfString, Output.LengthAllocated);
+    }
+    BenchStopTimer(Bench);
+
+    Bench->BytesProcessed = Bench->Iterations * BENCH_MULTIBYTE_SIZE;
+
+    YoriLibSetMultibyteInputEncoding(OriginalEncoding);
+    YoriLibFreeStringContents(&Output);
+    YoriLibFree(Input);
+    return TRUE;
+}
+
+// vim:sw=4:ts=4:et:
@@ -0,0 +1,69 @@
+/**
+ * @file bench/path.c
+ *
+ * Yori shell benchmark path routines
+ *
+ * Copyright (c) 2026 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <yoripch.h>
+#include <yorilib.h>
+#include "bench.h"
+
+/**
+ A benchmark to resolve a relative path containing parent and current
+ directory components against a directory.  The buffer for the result is
+ reused between iterations.
+
+ @param Bench Pointer to the benchmark state.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOLEAN
+BenchFullPathRelative(
+    __inout PYORI_BENCH Bench
+    )
+{
+    YORI_STRING PrimaryDirectory;
+    YORI_STRING FileName;
+    YORI_STRING FullPath;
+    DWORDLONG Index;
+    BOOLEAN Result;
+
+    YoriLibConstantString(&PrimaryDirectory, _T("C:\\Users\\Build\\Source\\Yori\\sh"));
+    YoriLibConstantString(&FileName, _T("..\\lib\\.\\..\\libsh\\builtin.c"));
+    YoriLibInitEmptyString(&FullPath);
+
+    Result = TRUE;
+    BenchStartTimer(Bench);
+    for (Index = 0; Index < Bench->Iterations; Index++) {
+        if (!YoriLibGetFullPathNameRelativeTo(&PrimaryDirectory, &FileName, FALSE, &FullPath, NULL)) {
+            Result = FALSE;
+            break;
+        }
+    }
+    BenchStopTimer(Bench);
+
+    YoriLibFreeStringContents(&FullPath);
+    return Result;
+}
+
+// vim:sw=4:ts=4:et:
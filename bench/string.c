@@ -0,0 +1,161 @@
+/**
+ * @file bench/string.c
+ *
+ * Yori shell benchmark string routines
+ *
+ * Copyright (c) 2026 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <yoripch.h>
+#include <yorilib.h>
+#include "bench.h"
+
+/**
+ The number of characters in the string searched for substrings.
+ */
+#define BENCH_SEARCH_LENGTH (4096)
+
+/**
+ The result of the most recent comparison, kept so that the comparisons
+ can't be optimized away.
+ */
+volatile int BenchCompareResult;
+
+/**
+ A benchmark to compare two strings that differ only in case.
+
+ @param Bench Pointer to the benchmark state.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOLEAN
+BenchCompareStringIns(
+    __inout PYORI_BENCH Bench
+    )
+{
+    YORI_STRING Str1;
+    YORI_STRING Str2;
+    DWORDLONG Index;
+
+    YoriLibConstantString(&Str1, _T("C:\\Program Files\\Yori\\Modules\\Completion\\Commands\\Build.ys1"));
+    YoriLibConstantString(&Str2, _T("c:\\program files\\yori\\modules\\completion\\commands\\build.YS1"));
+
+    BenchStartTimer(Bench);
+    for (Index = 0; Index < Bench->Iterations; Index++) {
+        BenchCompareResult = YoriLibCompareStringIns(&Str1, &Str2);
+    }
+    BenchStopTimer(Bench);
+
+    Bench->BytesProcessed = Bench->Iterations * Str1.LengthInChars * sizeof(TCHAR);
+    return (BOOLEAN)(BenchCompareResult == 0);
+}
+
+/**
+ A benchmark to search a string for several substrings that are not
+ present, so every position in the string is checked.
+
+ @param Bench Pointer to the benchmark state.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOLEAN
+BenchFindFirstMatchSubstr(
+    __inout PYORI_BENCH Bench
+    )
+{
+    YORI_STRING Haystack;
+    YORI_STRING Needles[4];
+    LPCTSTR Text;
+    YORI_ALLOC_SIZE_T Index;
+    YORI_ALLOC_SIZE_T TextLength;
+    DWORDLONG Iteration;
+    BOOLEAN Result;
+
+    if (!YoriLibAllocateString(&Haystack, BENCH_SEARCH_LENGTH)) {
+        return FALSE;
+    }
+
+    Text = _T("The quick brown fox jumps over the lazy dog; ");
+    TextLength = (YORI_ALLOC_SIZE_T)_tcslen(Text);
+    for (Index = 0; Index < BENCH_SEARCH_LENGTH; Index++) {
+        Haystack.StartOfString[Index] = Text[Index % TextLength];
+    }
+    Haystack.LengthInChars = BENCH_SEARCH_LENGTH;
+
+    YoriLibConstantString(&Needles[0], _T("error"));
+    YoriLibConstantString(&Needles[1], _T("warning"));
+    YoriLibConstantString(&Needles[2], _T("the lazy cat"));
+    YoriLibConstantString(&Needles[3], _T("quick red"));
+
+    Result = TRUE;
+    BenchStartTimer(Bench);
+    for (Iteration = 0; Iteration < Bench->Iterations; Iteration++) {
+        if (YoriLibFindFirstMatchSubstr(&Haystack, sizeof(Needles)/sizeof(Needles[0]), Needles, NULL) != NULL) {
+            Result = FALSE;
+        }
+    }
+    BenchStopTimer(Bench);
+
+    Bench->BytesProcessed = Bench->Iterations * BENCH_SEARCH_LENGTH * sizeof(TCHAR);
+    YoriLibFreeStringContents(&Haystack);
+    return Result;
+}
+
+/**
+ A benchmark to format a string with several arguments into a buffer that
+ is already large enough.
+
+ @param Bench Pointer to the benchmark state.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOLEAN
+BenchYPrintf(
+    __inout PYORI_BENCH Bench
+    )
+{
+    YORI_STRING Dest;
+    YORI_STRING Name;
+    DWORDLONG Index;
+    DWORDLONG BytesProcessed;
+
+    if (!YoriLibAllocateString(&Dest, 256)) {
+        return FALSE;
+    }
+
+    YoriLibConstantString(&Name, _T("C:\\Windows\\System32\\kernel32.dll"));
+    BytesProcessed = 0;
+
+    BenchStartTimer(Bench);
+    for (Index = 0; Index < Bench->Iterations; Index++) {
+        if (YoriLibYPrintf(&Dest, _T("%y: %i bytes, attributes %08x, %s\n"), &Name, (DWORD)Index, 0x20, _T("archive")) < 0) {
+            break;
+        }
+        BytesProcessed += Dest.LengthInChars * sizeof(TCHAR);
+    }
+    BenchStopTimer(Bench);
+
+    Bench->BytesProcessed = BytesProcessed;
+    YoriLibFreeStringContents(&Dest);
+    return (BOOLEAN)(Index == Bench->Iterations);
+}
+
+// vim:sw=4:ts=4:et:
@@ -0,0 +1,333 @@
+/**
+ * @file bench/tools.c
+ *
+ * Yori shell benchmark of tools operating on a corpus
+ *
+ * Copyright (c) 2026 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <yoripch.h>
+#include <yorilib.h>
+#include "bench.h"
+
+/**
+ The number of times each command runs before measurement starts.
+ */
+#define BENCH_TOOLS_WARMUP_COUNT (1)
+
+/**
+ A description of a tool to measure.
+ */
+typedef struct _BENCH_TOOL {
+
+    /**
+     The name of the benchmark.
+     */
+    LPCTSTR Name;
+
+    /**
+     The directory within the corpus to run the command in, or NULL to run
+     it in the root of the corpus.
+     */
+    LPCTSTR Directory;
+
+    /**
+     A command to run before each run of the command without measuring it,
+     or NULL if no preparation is needed.
+     */
+    LPCTSTR Prepare;
+
+    /**
+     The command to measure.
+     */
+    LPCTSTR Command;
+} BENCH_TOOL, *PBENCH_TOOL;
+
+/**
+ The set of tools to measure.  Commands refer to the layout created by
+ BenchCreateCorpus.  Since more is interactive, its ingestion is not
+ included.
+ */
+CONST BENCH_TOOL BenchTools[] = {
+    {_T("sdir"),      NULL,        NULL,                      _T("sdir -r tree")},
+    {_T("du"),        NULL,        NULL,                      _T("ydu tree")},
+    {_T("hash"),      NULL,        NULL,                      _T("yhash -s tree\\*")},
+    {_T("copy"),      NULL,        _T("yrmdir -s copy"),      _T("ycopy -s tree copy")},
+    {_T("erase"),     NULL,        _T("ycopy -s tree erase"), _T("yerase -s erase\\*")},
+    {_T("lines"),     NULL,        NULL,                      _T("lines -s tree\\*")},
+    {_T("hilite"),    NULL,        NULL,                      _T("hilite -o -c ERROR red logs\\*")},
+    {_T("type-vt"),   NULL,        NULL,                      _T("ytype vt\\color.txt")},
+    {_T("cvtvt"),     NULL,        NULL,                      _T("cvtvt -html5 vt\\color.txt")},
+    {_T("make-noop"), _T("build"), NULL,                      _T("ymake")},
+};
+
+/**
+ Output a string as a quoted JSON string, escaping any characters that
+ cannot appear in one.
+
+ @param String The string to output.
+ */
+VOID
+BenchOutputJsonString(
+    __in LPCTSTR String
+    )
+{
+    YORI_STRING Escaped;
+    YORI_ALLOC_SIZE_T Length;
+    YORI_ALLOC_SIZE_T Index;
+
+    Length = (YORI_ALLOC_SIZE_T)_tcslen(String);
+    if (!YoriLibAllocateString(&Escaped, Length * 6 + 1)) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("null"));
+        return;
+    }
+
+    Escaped.LengthInChars = 0;
+    for (Index = 0; Index < Length; Index++) {
+        if (String[Index] == '"' || String[Index] == '\\') {
+            Escaped.StartOfString[Escaped.LengthInChars++] = '\\';
+            Escaped.StartOfString[Escaped.LengthInChars++] = String[Index];
+        } else if (String[Index] < 0x20) {
+            Escaped.LengthInChars = Escaped.LengthInChars +
+                (YORI_ALLOC_SIZE_T)YoriLibSPrintfS(&Escaped.StartOfString[Escaped.LengthInChars],
+                                                   Escaped.LengthAllocated - Escaped.LengthInChars,
+                                                   _T("\\u%04x"),
+                                                   String[Index]);
+        } else {
+            Escaped.StartOfString[Escaped.LengthInChars++] = String[Index];
+        }
+    }
+
+    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("\"%y\""), &Escaped);
+    YoriLibFreeStringContents(&Escaped);
+}
+
+/**
+ Run a single tool benchmark via timethis and output its results.  The
+ results from timethis are captured in a temporary file so that if timethis
+ fails, the output remains valid JSON.
+
+ @param Tool Pointer to the tool to measure.
+
+ @param Root The directory containing the corpus.
+
+ @param RunCount The number of measured runs.
+
+ @return TRUE to indicate the benchmark produced results, FALSE if it did
+         not.
+ */
+BOOLEAN
+BenchRunTool(
+    __in CONST BENCH_TOOL * Tool,
+    __in PYORI_STRING Root,
+    __in DWORD RunCount
+    )
+{
+    YORI_STRING CmdLine;
+    YORI_STRING Directory;
+    YORI_STRING TempPath;
+    YORI_STRING TempFileName;
+    YORI_STRING Prefix;
+    YORI_STRING Results;
+    PROCESS_INFORMATION ProcessInfo;
+    STARTUPINFO StartupInfo;
+    HANDLE TempHandle;
+    HANDLE ChildHandle;
+    PCHAR Buffer;
+    DWORD FileSize;
+    DWORD BytesRead;
+    BOOLEAN Result;
+
+    YoriLibInitEmptyString(&CmdLine);
+    YoriLibInitEmptyString(&Directory);
+    YoriLibInitEmptyString(&TempFileName);
+    YoriLibInitEmptyString(&Results);
+    TempHandle = NULL;
+    ChildHandle = NULL;
+    Buffer = NULL;
+    Result = FALSE;
+
+    if (Tool->Prepare != NULL) {
+        if (YoriLibYPrintf(&CmdLine, _T("timethis -json -q -n %i -warmup %i -prepare \"%s\" %s"), RunCount, BENCH_TOOLS_WARMUP_COUNT, Tool->Prepare, Tool->Command) < 0) {
+            goto Exit;
+        }
+    } else {
+        if (YoriLibYPrintf(&CmdLine, _T("timethis -json -q -n %i -warmup %i %s"), RunCount, BENCH_TOOLS_WARMUP_COUNT, Tool->Command) < 0) {
+            goto Exit;
+        }
+    }
+
+    if (Tool->Directory != NULL) {
+        if (YoriLibYPrintf(&Directory, _T("%y\\%s"), Root, Tool->Directory) < 0) {
+            goto Exit;
+        }
+    } else {
+        if (YoriLibYPrintf(&Directory, _T("%y"), Root) < 0) {
+            goto Exit;
+        }
+    }
+
+    YoriLibConstantString(&Prefix, _T("ybench"));
+    if (!YoriLibGetTempPath(&TempPath, 0)) {
+        goto Exit;
+    }
+
+    if (!YoriLibGetTempFileName(&TempPath, &Prefix, &TempHandle, &TempFileName)) {
+        YoriLibFreeStringContents(&TempPath);
+        TempHandle = NULL;
+        goto Exit;
+    }
+    YoriLibFreeStringContents(&TempPath);
+
+    if (!DuplicateHandle(GetCurrentProcess(), TempHandle, GetCurrentProcess(), &ChildHandle, 0, TRUE, DUPLICATE_SAME_ACCESS)) {
+        ChildHandle = NULL;
+        goto Exit;
+    }
+
+    ZeroMemory(&StartupInfo, sizeof(StartupInfo));
+    StartupInfo.cb = sizeof(StartupInfo);
+    StartupInfo.dwFlags = STARTF_USESTDHANDLES;
+    StartupInfo.hStdInput = GetStdHandle(STD_INPUT_HANDLE);
+    StartupInfo.hStdOutput = ChildHandle;
+    StartupInfo.hStdError = GetStdHandle(STD_ERROR_HANDLE);
+
+    if (!CreateProcess(NULL, CmdLine.StartOfString, NULL, NULL, TRUE, 0, NULL, Directory.StartOfString, &StartupInfo, &ProcessInfo)) {
+        goto Exit;
+    }
+
+    CloseHandle(ChildHandle);
+    ChildHandle = NULL;
+
+    WaitForSingleObject(ProcessInfo.hProcess, INFINITE);
+    CloseHandle(ProcessInfo.hProcess);
+    CloseHandle(ProcessInfo.hThread);
+
+    //
+    //  Read the results from timethis and convert them to display.
+    //
+
+    FileSize = GetFileSize(TempHandle, NULL);
+    if (FileSize == 0 || FileSize == INVALID_FILE_SIZE || FileSize > 1024 * 1024) {
+        goto Exit;
+    }
+
+    Buffer = YoriLibMalloc(FileSize);
+    if (Buffer == NULL) {
+        goto Exit;
+    }
+
+    SetFilePointer(TempHandle, 0, NULL, FILE_BEGIN);
+    if (!ReadFile(TempHandle, Buffer, FileSize, &BytesRead, NULL) ||
+        BytesRead != FileSize) {
+        goto Exit;
+    }
+
+    if (!YoriLibAllocateString(&Results, YoriLibGetMultibyteInputSizeNeeded(Buffer, FileSize))) {
+        goto Exit;
+    }
+
+    Results.LengthInChars = YoriLibMultibyteInput(Buffer, FileSize, Results.StartOfString, Results.LengthAllocated);
+    Result = TRUE;
+
+Exit:
+    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("    {\n      \"Name\": "));
+    BenchOutputJsonString(Tool->Name);
+    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T(",\n      \"Command\": "));
+    BenchOutputJsonString(Tool->Command);
+    if (Result) {
+        YoriLibTrimTrailingNewlines(&Results);
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T(",\n      \"Results\": %y\n    }"), &Results);
+    } else {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T(",\n      \"Results\": null\n    }"));
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("yoribench: %s produced no results\n"), Tool->Name);
+    }
+
+    if (Buffer != NULL) {
+        YoriLibFree(Buffer);
+    }
+    if (ChildHandle != NULL) {
+        CloseHandle(ChildHandle);
+    }
+    if (TempHandle != NULL) {
+        CloseHandle(TempHandle);
+        DeleteFile(TempFileName.StartOfString);
+    }
+    YoriLibFreeStringContents(&Results);
+    YoriLibFreeStringContents(&TempFileName);
+    YoriLibFreeStringContents(&Directory);
+    YoriLibFreeStringContents(&CmdLine);
+    return Result;
+}
+
+/**
+ Measure each tool operating on a corpus created with BenchCreateCorpus,
+ and output the results as JSON.  Each tool is run via timethis, which must
+ be in the path along with the tools.
+
+ @param Directory The directory containing the corpus.
+
+ @param Label Optionally points to a label to include in the results, such
+        as a description of the build being measured.
+
+ @param RunCount The number of measured runs of each tool.
+
+ @return TRUE if every tool produced results, FALSE if any did not.
+ */
+BOOLEAN
+BenchRunTools(
+    __in PYORI_STRING Directory,
+    __in_opt PYORI_STRING Label,
+    __in DWORD RunCount
+    )
+{
+    YORI_STRING Root;
+    DWORD Index;
+    BOOLEAN Result;
+
+    YoriLibInitEmptyString(&Root);
+    if (!YoriLibUserStringToSingleFilePath(Directory, FALSE, &Root)) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("yoribench: could not resolve %y\n"), Directory);
+        return FALSE;
+    }
+
+    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("{\n  \"Label\": "));
+    if (Label != NULL) {
+        ASSERT(YoriLibIsStringNullTerminated(Label));
+        BenchOutputJsonString(Label->StartOfString);
+    } else {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("null"));
+    }
+    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T(",\n  \"Runs\": %i,\n  \"Warmup\": %i,\n  \"Benchmarks\": [\n"), RunCount, BENCH_TOOLS_WARMUP_COUNT);
+
+    Result = TRUE;
+    for (Index = 0; Index < sizeof(BenchTools)/sizeof(BenchTools[0]); Index++) {
+        if (!BenchRunTool(&BenchTools[Index], &Root, RunCount)) {
+            Result = FALSE;
+        }
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, (Index + 1 < sizeof(BenchTools)/sizeof(BenchTools[0]))?_T(",\n"):_T("\n"));
+    }
+
+    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("  ]\n}\n"));
+    YoriLibFreeStringContents(&Root);
+    return Result;
+}
+
+// vim:sw=4:ts=4:et:
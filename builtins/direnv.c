@@ -41,7 +41,12 @@ CHAR strDirenvHelpText[] =
         "\n"
         "   -a             Apply changes based on the current directory\n"
         "   -i             Install directory change monitor\n"
-        "   -u             Uninstall directory change monitor\n";
+        "   -u             Uninstall directory change monitor\n"
+        "\n"
+        "Environment changes made by a script are remembered, and re-entering its\n"
+        "directory applies them again without running the script, unless the script\n"
+        "has changed, it altered anything other than the environment, or a variable\n"
+        "it changed has since been modified.\n";
 
 /**
  Display usage text to the user.
@@ -107,6 +112,953 @@ BOOLEAN DirenvInstalled;
  */
 BOOLEAN DirenvApplyInvoked;
 
+//
+//  Finding the script for the current directory probes each parent
+//  directory, which is slow on deep trees and network shares.  The result
+//  of each probe is cached per directory, including the absence of a
+//  script, and each cached directory has a change notification so it is
+//  probed again only when a file within it is created, deleted, renamed or
+//  written.  Directories which cannot be watched are probed again after a
+//  fixed interval.
+//
+//  Each cached directory also remembers the changes its script made to the
+//  environment when applied and undone.  Re-entering the directory applies
+//  those changes again without running the script, provided the script
+//  has not changed, the script did nothing other than alter the
+//  environment, and every variable it changed still has the value it had
+//  before the script last ran.  Otherwise the script is run and its
+//  changes recorded again.
+//
+
+/**
+ The maximum number of directories whose probe results are cached.  When
+ this is reached, the least recently used directory is discarded.
+ */
+#define DIRENV_MAX_CACHED_DIRECTORIES (64)
+
+/**
+ The number of milliseconds after which a directory that does not have a
+ change notification is probed again.
+ */
+#define DIRENV_UNWATCHED_LIFETIME (10 * 1000)
+
+/**
+ A single change made to an environment variable by a script.
+ */
+typedef struct _DIRENV_CHANGE {
+
+    /**
+     The list of changes made by the script.  Paired with
+     DIRENV_DELTA::Changes.
+     */
+    YORI_LIST_ENTRY ListEntry;
+
+    /**
+     The name of the variable, NULL terminated.
+     */
+    YORI_STRING Name;
+
+    /**
+     The value of the variable before the script ran, NULL terminated.
+     */
+    YORI_STRING OldValue;
+
+    /**
+     The value of the variable after the script ran, NULL terminated.
+     */
+    YORI_STRING NewValue;
+
+    /**
+     TRUE if the variable was defined before the script ran.
+     */
+    BOOLEAN OldDefined;
+
+    /**
+     TRUE if the variable was defined after the script ran.
+     */
+    BOOLEAN NewDefined;
+
+} DIRENV_CHANGE, *PDIRENV_CHANGE;
+
+/**
+ The set of changes made to the environment by one invocation of a script.
+ */
+typedef struct _DIRENV_DELTA {
+
+    /**
+     A list of DIRENV_CHANGE structures.
+     */
+    YORI_LIST_ENTRY Changes;
+
+    /**
+     TRUE if the changes describe everything the script did, so they can be
+     applied in place of running the script.
+     */
+    BOOLEAN Valid;
+
+} DIRENV_DELTA, *PDIRENV_DELTA;
+
+/**
+ A directory whose probe result is cached.
+ */
+typedef struct _DIRENV_DIRECTORY {
+
+    /**
+     The hash entry for the directory, keyed by the directory name.  Paired
+     with DirenvDirectories.
+     */
+    YORI_HASH_ENTRY HashEntry;
+
+    /**
+     The list of cached directories, most recently used first.  Paired with
+     DirenvDirectoryList.
+     */
+    YORI_LIST_ENTRY ListEntry;
+
+    /**
+     The name of the directory, NULL terminated.
+     */
+    YORI_STRING DirName;
+
+    /**
+     A change notification handle which is signalled when the contents of
+     the directory change.  NULL if the directory cannot be watched.
+     */
+    HANDLE ChangeNotification;
+
+    /**
+     The tick count when the directory was last probed.
+     */
+    DWORD ProbedTime;
+
+    /**
+     The last write time of the script when the directory was last probed.
+     */
+    FILETIME ScriptWriteTime;
+
+    /**
+     TRUE if the directory has been probed.
+     */
+    BOOLEAN Probed;
+
+    /**
+     TRUE if the directory contains a script.
+     */
+    BOOLEAN ScriptExists;
+
+    /**
+     The changes made to the environment when the script was last applied.
+     */
+    DIRENV_DELTA ApplyDelta;
+
+    /**
+     The changes made to the environment when the script was last undone.
+     */
+    DIRENV_DELTA UndoDelta;
+
+} DIRENV_DIRECTORY, *PDIRENV_DIRECTORY;
+
+/**
+ The state of the shell that is compared before and after running a script
+ to determine what the script changed.
+ */
+typedef struct _DIRENV_SNAPSHOT {
+
+    /**
+     The environment block.
+     */
+    YORI_STRING Environment;
+
+    /**
+     The set of user defined aliases.
+     */
+    YORI_STRING Aliases;
+
+    /**
+     The current directory.
+     */
+    YORI_STRING CurrentDirectory;
+
+} DIRENV_SNAPSHOT, *PDIRENV_SNAPSHOT;
+
+/**
+ An environment variable within a snapshot, used when comparing snapshots.
+ */
+typedef struct _DIRENV_VARIABLE {
+
+    /**
+     The hash entry for the variable, keyed by the variable name.
+     */
+    YORI_HASH_ENTRY HashEntry;
+
+    /**
+     The value of the variable.
+     */
+    YORI_STRING Value;
+
+    /**
+     Set to TRUE if the variable is found in the later snapshot.
+     */
+    BOOLEAN Matched;
+
+} DIRENV_VARIABLE, *PDIRENV_VARIABLE;
+
+/**
+ A hash table of cached directories.  NULL if no directories are cached.
+ */
+PYORI_HASH_TABLE DirenvDirectories;
+
+/**
+ A list of cached directories, most recently used first.
+ */
+YORI_LIST_ENTRY DirenvDirectoryList;
+
+/**
+ The number of cached directories.
+ */
+DWORD DirenvDirectoryCount;
+
+/**
+ Free all changes recorded within a delta and mark it invalid.
+
+ @param Delta Pointer to the delta.
+ */
+VOID
+DirenvFreeDelta(
+    __inout PDIRENV_DELTA Delta
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PDIRENV_CHANGE Change;
+
+    if (Delta->Changes.Next != NULL) {
+        ListEntry = YoriLibGetNextListEntry(&Delta->Changes, NULL);
+        while (ListEntry != NULL) {
+            Change = CONTAINING_RECORD(ListEntry, DIRENV_CHANGE, ListEntry);
+            ListEntry = YoriLibGetNextListEntry(&Delta->Changes, ListEntry);
+            YoriLibRemoveListItem(&Change->ListEntry);
+            YoriLibFree(Change);
+        }
+    }
+
+    YoriLibInitializeListHead(&Delta->Changes);
+    Delta->Valid = FALSE;
+}
+
+/**
+ Record a change to an environment variable within a delta.  On allocation
+ failure the delta is marked invalid.
+
+ @param Delta Pointer to the delta.
+
+ @param Name Pointer to the name of the variable.
+
+ @param OldValue Optionally points to the value before the script ran.  NULL
+        indicates the variable was not defined.
+
+ @param NewValue Optionally points to the value after the script ran.  NULL
+        indicates the variable is not defined.
+ */
+VOID
+DirenvAddChange(
+    __inout PDIRENV_DELTA Delta,
+    __in PYORI_STRING Name,
+    __in_opt PYORI_STRING OldValue,
+    __in_opt PYORI_STRING NewValue
+    )
+{
+    PDIRENV_CHANGE Change;
+    YORI_ALLOC_SIZE_T CharsNeeded;
+    LPTSTR Buffer;
+
+    CharsNeeded = Name->LengthInChars + 3;
+    if (OldValue != NULL) {
+        CharsNeeded = CharsNeeded + OldValue->LengthInChars;
+    }
+    if (NewValue != NULL) {
+        CharsNeeded = CharsNeeded + NewValue->LengthInChars;
+    }
+
+    Change = YoriLibMalloc(sizeof(DIRENV_CHANGE) + CharsNeeded * sizeof(TCHAR));
+    if (Change == NULL) {
+        Delta->Valid = FALSE;
+        return;
+    }
+
+    ZeroMemory(Change, sizeof(DIRENV_CHANGE));
+    Buffer = (LPTSTR)(Change + 1);
+
+    Change->Name.StartOfString = Buffer;
+    Change->Name.LengthInChars = YoriLibSPrintf(Buffer, _T("%y"), Name);
+    Change->Name.LengthAllocated = Change->Name.LengthInChars + 1;
+    Buffer = Buffer + Change->Name.LengthAllocated;
+
+    Change->OldValue.StartOfString = Buffer;
+    if (OldValue != NULL) {
+        Change->OldDefined = TRUE;
+        Change->OldValue.LengthInChars = YoriLibSPrintf(Buffer, _T("%y"), OldValue);
+    } else {
+        Buffer[0] = '\0';
+    }
+    Change->OldValue.LengthAllocated = Change->OldValue.LengthInChars + 1;
+    Buffer = Buffer + Change->OldValue.LengthAllocated;
+
+    Change->NewValue.StartOfString = Buffer;
+    if (NewValue != NULL) {
+        Change->NewDefined = TRUE;
+        Change->NewValue.LengthInChars = YoriLibSPrintf(Buffer, _T("%y"), NewValue);
+    } else {
+        Buffer[0] = '\0';
+    }
+    Change->NewValue.LengthAllocated = Change->NewValue.LengthInChars + 1;
+
+    YoriLibAppendList(&Delta->Changes, &Change->ListEntry);
+}
+
+/**
+ Split an entry from an environment block into its name and value.
+
+ @param Entry Pointer to the NULL terminated entry.
+
+ @param Name On successful completion, updated to refer to the name within
+        the entry.
+
+ @param Value On successful completion, updated to refer to the value
+        within the entry.
+
+ @return TRUE if the entry describes a regular variable, FALSE if it does
+         not, including entries describing the current directory of each
+         drive.
+ */
+__success(return)
+BOOLEAN
+DirenvSplitEnvironmentEntry(
+    __in LPTSTR Entry,
+    __out PYORI_STRING Name,
+    __out PYORI_STRING Value
+    )
+{
+    LPTSTR Equals;
+
+    if (Entry[0] == '=') {
+        return FALSE;
+    }
+
+    Equals = _tcschr(Entry, '=');
+    if (Equals == NULL) {
+        return FALSE;
+    }
+
+    YoriLibInitEmptyString(Name);
+    Name->StartOfString = Entry;
+    Name->LengthInChars = (YORI_ALLOC_SIZE_T)(Equals - Entry);
+
+    YoriLibInitEmptyString(Value);
+    Value->StartOfString = Equals + 1;
+    Value->LengthInChars = (YORI_ALLOC_SIZE_T)_tcslen(Value->StartOfString);
+    return TRUE;
+}
+
+/**
+ Return the number of characters in a set of NULL terminated strings that
+ is terminated by an additional NULL, including all terminators.
+
+ @param Strings Pointer to the set of strings.
+
+ @return The number of characters, including all terminators.
+ */
+YORI_ALLOC_SIZE_T
+DirenvMultiStringLength(
+    __in LPTSTR Strings
+    )
+{
+    YORI_ALLOC_SIZE_T Index;
+
+    Index = 0;
+    while (Strings[Index] != '\0') {
+        Index = Index + (YORI_ALLOC_SIZE_T)_tcslen(&Strings[Index]) + 1;
+    }
+    return Index + 1;
+}
+
+/**
+ Free a snapshot of shell state.
+
+ @param Snapshot Pointer to the snapshot to free.
+ */
+VOID
+DirenvFreeSnapshot(
+    __inout PDIRENV_SNAPSHOT Snapshot
+    )
+{
+    YoriLibFreeStringContents(&Snapshot->Environment);
+    if (Snapshot->Aliases.StartOfString != NULL) {
+        YoriCallFreeYoriString(&Snapshot->Aliases);
+        YoriLibInitEmptyString(&Snapshot->Aliases);
+    }
+    YoriLibFreeStringContents(&Snapshot->CurrentDirectory);
+}
+
+/**
+ Capture the parts of shell state that a script can change.
+
+ @param Snapshot On successful completion, populated with the shell state.
+        The caller should free this with @ref DirenvFreeSnapshot .
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+DirenvCaptureSnapshot(
+    __out PDIRENV_SNAPSHOT Snapshot
+    )
+{
+    YoriLibInitEmptyString(&Snapshot->Environment);
+    YoriLibInitEmptyString(&Snapshot->Aliases);
+    YoriLibInitEmptyString(&Snapshot->CurrentDirectory);
+
+    if (!YoriLibGetEnvironmentStrings(&Snapshot->Environment) ||
+        !YoriCallGetAliasStrings(&Snapshot->Aliases) ||
+        !YoriLibGetCurrentDirectory(&Snapshot->CurrentDirectory)) {
+
+        DirenvFreeSnapshot(Snapshot);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ Compare shell state from before and after running a script and record the
+ changes the script made to the environment.  If the script changed
+ anything other than the environment, the delta is left invalid so that the
+ script is always run.
+
+ @param Before Pointer to the state before the script ran.
+
+ @param After Pointer to the state after the script ran.
+
+ @param Delta Pointer to a delta, which should be empty and invalid on
+        entry.  On completion, populated with the changes.
+ */
+VOID
+DirenvComputeDelta(
+    __in PDIRENV_SNAPSHOT Before,
+    __in PDIRENV_SNAPSHOT After,
+    __inout PDIRENV_DELTA Delta
+    )
+{
+    YORI_ALLOC_SIZE_T AliasLength;
+    YORI_ALLOC_SIZE_T Count;
+    YORI_ALLOC_SIZE_T Index;
+    PYORI_HASH_TABLE Table;
+    PYORI_HASH_ENTRY HashEntry;
+    PDIRENV_VARIABLE Variables;
+    PDIRENV_VARIABLE Variable;
+    YORI_STRING Name;
+    YORI_STRING Value;
+    LPTSTR ThisEntry;
+
+    ASSERT(!Delta->Valid);
+
+    AliasLength = DirenvMultiStringLength(Before->Aliases.StartOfString);
+    if (AliasLength != DirenvMultiStringLength(After->Aliases.StartOfString) ||
+        memcmp(Before->Aliases.StartOfString, After->Aliases.StartOfString, AliasLength * sizeof(TCHAR)) != 0) {
+
+        return;
+    }
+
+    if (YoriLibCompareStringIns(&Before->CurrentDirectory, &After->CurrentDirectory) != 0) {
+        return;
+    }
+
+    Count = 0;
+    ThisEntry = Before->Environment.StartOfString;
+    while (*ThisEntry != '\0') {
+        Count++;
+        ThisEntry += _tcslen(ThisEntry) + 1;
+    }
+
+    Variables = YoriLibMalloc((Count + 1) * sizeof(DIRENV_VARIABLE));
+    if (Variables == NULL) {
+        return;
+    }
+
+    Table = YoriLibAllocateHashTable(Count);
+    if (Table == NULL) {
+        YoriLibFree(Variables);
+        return;
+    }
+
+    //
+    //  Index the variables from before the script ran.
+    //
+
+    Count = 0;
+    ThisEntry = Before->Environment.StartOfString;
+    while (*ThisEntry != '\0') {
+        if (DirenvSplitEnvironmentEntry(ThisEntry, &Name, &Value)) {
+            Variable = &Variables[Count];
+            memcpy(&Variable->Value, &Value, sizeof(YORI_STRING));
+            Variable->Matched = FALSE;
+            YoriLibHashInsertByKey(Table, &Name, Variable, &Variable->HashEntry);
+            Count++;
+        }
+        ThisEntry += _tcslen(ThisEntry) + 1;
+    }
+
+    //
+    //  Record each variable that was added or modified, then each variable
+    //  that was removed.
+    //
+
+    Delta->Valid = TRUE;
+    ThisEntry = After->Environment.StartOfString;
+    while (*ThisEntry != '\0') {
+        if (DirenvSplitEnvironmentEntry(ThisEntry, &Name, &Value)) {
+            HashEntry = YoriLibHashLookupByKey(Table, &Name);
+            if (HashEntry == NULL) {
+                DirenvAddChange(Delta, &Name, NULL, &Value);
+            } else {
+                Variable = HashEntry->Context;
+                Variable->Matched = TRUE;
+                if (YoriLibCompareString(&Variable->Value, &Value) != 0) {
+                    DirenvAddChange(Delta, &Name, &Variable->Value, &Value);
+                }
+            }
+        }
+        ThisEntry += _tcslen(ThisEntry) + 1;
+    }
+
+    for (Index = 0; Index < Count; Index++) {
+        Variable = &Variables[Index];
+        if (!Variable->Matched) {
+            DirenvAddChange(Delta, &Variable->HashEntry.Key, &Variable->Value, NULL);
+        }
+        YoriLibHashRemoveByEntry(&Variable->HashEntry);
+    }
+
+    YoriLibFreeEmptyHashTable(Table);
+    YoriLibFree(Variables);
+
+    if (!Delta->Valid) {
+        DirenvFreeDelta(Delta);
+    }
+}
+
+/**
+ Check whether an environment variable currently has a specified value.
+
+ @param Name Pointer to the NULL terminated name of the variable.
+
+ @param Defined TRUE if the variable is expected to be defined, FALSE if it
+        is expected to not be defined.
+
+ @param Value Pointer to the expected value of the variable, if it is
+        expected to be defined.
+
+ @return TRUE if the variable has the expected value, FALSE if it does not.
+ */
+BOOLEAN
+DirenvVariableMatches(
+    __in PYORI_STRING Name,
+    __in BOOLEAN Defined,
+    __in PYORI_STRING Value
+    )
+{
+    YORI_STRING Current;
+    YORI_ALLOC_SIZE_T LengthNeeded;
+    BOOLEAN Result;
+
+    LengthNeeded = (YORI_ALLOC_SIZE_T)GetEnvironmentVariable(Name->StartOfString, NULL, 0);
+    if (LengthNeeded == 0) {
+        return (BOOLEAN)(!Defined);
+    }
+
+    if (!Defined || LengthNeeded != Value->LengthInChars + 1) {
+        return FALSE;
+    }
+
+    if (!YoriLibAllocateString(&Current, LengthNeeded)) {
+        return FALSE;
+    }
+
+    Current.LengthInChars = (YORI_ALLOC_SIZE_T)GetEnvironmentVariable(Name->StartOfString, Current.StartOfString, Current.LengthAllocated);
+    Result = FALSE;
+    if (YoriLibCompareString(&Current, Value) == 0) {
+        Result = TRUE;
+    }
+    YoriLibFreeStringContents(&Current);
+    return Result;
+}
+
+/**
+ Apply a previously recorded delta in place of running a script.  This only
+ occurs if every variable the delta changes still has the value it had
+ before the script last ran.
+
+ @param Delta Pointer to the delta.
+
+ @return TRUE if the delta was applied, FALSE if the script should be run.
+ */
+BOOLEAN
+DirenvReplayDelta(
+    __in PDIRENV_DELTA Delta
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PDIRENV_CHANGE Change;
+
+    if (!Delta->Valid) {
+        return FALSE;
+    }
+
+    ListEntry = YoriLibGetNextListEntry(&Delta->Changes, NULL);
+    while (ListEntry != NULL) {
+        Change = CONTAINING_RECORD(ListEntry, DIRENV_CHANGE, ListEntry);
+        if (!DirenvVariableMatches(&Change->Name, Change->OldDefined, &Change->OldValue)) {
+            return FALSE;
+        }
+        ListEntry = YoriLibGetNextListEntry(&Delta->Changes, ListEntry);
+    }
+
+    ListEntry = YoriLibGetNextListEntry(&Delta->Changes, NULL);
+    while (ListEntry != NULL) {
+        Change = CONTAINING_RECORD(ListEntry, DIRENV_CHANGE, ListEntry);
+        if (Change->NewDefined) {
+            YoriCallSetEnvironmentVariable(&Change->Name, &Change->NewValue);
+        } else {
+            YoriCallSetEnvironmentVariable(&Change->Name, NULL);
+        }
+        ListEntry = YoriLibGetNextListEntry(&Delta->Changes, ListEntry);
+    }
+
+    return TRUE;
+}
+
+/**
+ Free a cached directory, removing it from the cache.
+
+ @param Directory Pointer to the directory.
+ */
+VOID
+DirenvFreeDirectory(
+    __in PDIRENV_DIRECTORY Directory
+    )
+{
+    DirenvFreeDelta(&Directory->ApplyDelta);
+    DirenvFreeDelta(&Directory->UndoDelta);
+    if (Directory->ChangeNotification != NULL) {
+        FindCloseChangeNotification(Directory->ChangeNotification);
+    }
+
+    YoriLibHashRemoveByEntry(&Directory->HashEntry);
+    YoriLibRemoveListItem(&Directory->ListEntry);
+    YoriLibFreeStringContents(&Directory->DirName);
+    YoriLibFree(Directory);
+    DirenvDirectoryCount--;
+}
+
+/**
+ Free all cached directories.
+ */
+VOID
+DirenvFreeDirectoryCache(VOID)
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PDIRENV_DIRECTORY Directory;
+
+    if (DirenvDirectories == NULL) {
+        return;
+    }
+
+    ListEntry = YoriLibGetNextListEntry(&DirenvDirectoryList, NULL);
+    while (ListEntry != NULL) {
+        Directory = CONTAINING_RECORD(ListEntry, DIRENV_DIRECTORY, ListEntry);
+        ListEntry = YoriLibGetNextListEntry(&DirenvDirectoryList, ListEntry);
+        DirenvFreeDirectory(Directory);
+    }
+
+    YoriLibFreeEmptyHashTable(DirenvDirectories);
+    DirenvDirectories = NULL;
+}
+
+/**
+ Probe for a script within a directory.
+
+ @param DirName Pointer to the name of the directory.
+
+ @param WriteTime On successful completion, updated to contain the last
+        write time of the script.
+
+ @return TRUE if the directory contains a script, FALSE if it does not.
+ */
+__success(return)
+BOOLEAN
+DirenvProbeDirectory(
+    __in PYORI_STRING DirName,
+    __out PFILETIME WriteTime
+    )
+{
+    YORI_STRING ScriptName;
+    WIN32_FIND_DATA FindData;
+    HANDLE FindHandle;
+
+    if (!YoriLibAllocateString(&ScriptName, DirName->LengthInChars + sizeof("\\envrc.ys1"))) {
+        return FALSE;
+    }
+
+    YoriLibSPrintf(ScriptName.StartOfString, _T("%y\\envrc.ys1"), DirName);
+    FindHandle = FindFirstFile(ScriptName.StartOfString, &FindData);
+    YoriLibFreeStringContents(&ScriptName);
+    if (FindHandle == INVALID_HANDLE_VALUE) {
+        return FALSE;
+    }
+
+    FindClose(FindHandle);
+    memcpy(WriteTime, &FindData.ftLastWriteTime, sizeof(FILETIME));
+    return TRUE;
+}
+
+/**
+ Ensure the probe result for a cached directory reflects the file system,
+ probing again if the directory has changed since it was last probed.  If
+ the script has changed, any recorded changes from running it are
+ discarded.
+
+ @param Directory Pointer to the directory.
+ */
+VOID
+DirenvRefreshDirectory(
+    __in PDIRENV_DIRECTORY Directory
+    )
+{
+    YORI_STRING WatchName;
+    FILETIME WriteTime;
+    BOOLEAN ScriptExists;
+
+    if (Directory->Probed) {
+        if (Directory->ChangeNotification != NULL) {
+            if (WaitForSingleObject(Directory->ChangeNotification, 0) != WAIT_OBJECT_0) {
+                return;
+            }
+
+            //
+            //  Rearm the notification before probing, so that any change
+            //  made after probing causes another probe on the next use.
+            //
+
+            if (!FindNextChangeNotification(Directory->ChangeNotification)) {
+                FindCloseChangeNotification(Directory->ChangeNotification);
+                Directory->ChangeNotification = NULL;
+            }
+        } else if (GetTickCount() - Directory->ProbedTime < DIRENV_UNWATCHED_LIFETIME) {
+            return;
+        }
+    }
+
+    //
+    //  A directory that could not be watched when it was first seen may be
+    //  watchable now.  A drive letter without a trailing separator refers
+    //  to the current directory on that drive, so watch its root instead.
+    //
+
+    if (Directory->ChangeNotification == NULL &&
+        YoriLibAllocateString(&WatchName, Directory->DirName.LengthInChars + 2)) {
+
+        if (Directory->DirName.LengthInChars == 2 &&
+            Directory->DirName.StartOfString[1] == ':') {
+
+            YoriLibSPrintf(WatchName.StartOfString, _T("%y\\"), &Directory->DirName);
+        } else {
+            YoriLibSPrintf(WatchName.StartOfString, _T("%y"), &Directory->DirName);
+        }
+
+        Directory->ChangeNotification = FindFirstChangeNotification(WatchName.StartOfString, FALSE, FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_LAST_WRITE);
+        if (Directory->ChangeNotification == INVALID_HANDLE_VALUE) {
+            Directory->ChangeNotification = NULL;
+        }
+        YoriLibFreeStringContents(&WatchName);
+    }
+
+    ZeroMemory(&WriteTime, sizeof(WriteTime));
+    ScriptExists = DirenvProbeDirectory(&Directory->DirName, &WriteTime);
+
+    if (!ScriptExists ||
+        !Directory->ScriptExists ||
+        CompareFileTime(&WriteTime, &Directory->ScriptWriteTime) != 0) {
+
+        DirenvFreeDelta(&Directory->ApplyDelta);
+        DirenvFreeDelta(&Directory->UndoDelta);
+    }
+
+    Directory->ScriptExists = ScriptExists;
+    memcpy(&Directory->ScriptWriteTime, &WriteTime, sizeof(FILETIME));
+    Directory->ProbedTime = GetTickCount();
+    Directory->Probed = TRUE;
+}
+
+/**
+ Find a directory within the cache, optionally inserting it if it is not
+ already present.  A directory that is found becomes the most recently
+ used directory.
+
+ @param DirName Pointer to the name of the directory.
+
+ @param Create If TRUE, the directory is inserted into the cache if it is
+        not present, discarding the least recently used directory if the
+        cache is full.
+
+ @return Pointer to the directory, or NULL if it is not cached.
+ */
+PDIRENV_DIRECTORY
+DirenvLookupDirectory(
+    __in PYORI_STRING DirName,
+    __in BOOLEAN Create
+    )
+{
+    PDIRENV_DIRECTORY Directory;
+    PYORI_HASH_ENTRY HashEntry;
+    PYORI_LIST_ENTRY ListEntry;
+
+    if (DirenvDirectories == NULL) {
+        if (!Create) {
+            return NULL;
+        }
+
+        DirenvDirectories = YoriLibAllocateHashTable(DIRENV_MAX_CACHED_DIRECTORIES);
+        if (DirenvDirectories == NULL) {
+            return NULL;
+        }
+        YoriLibInitializeListHead(&DirenvDirectoryList);
+        DirenvDirectoryCount = 0;
+    }
+
+    HashEntry = YoriLibHashLookupByKey(DirenvDirectories, DirName);
+    if (HashEntry != NULL) {
+        Directory = HashEntry->Context;
+        YoriLibRemoveListItem(&Directory->ListEntry);
+        YoriLibInsertList(&DirenvDirectoryList, &Directory->ListEntry);
+        return Directory;
+    }
+
+    if (!Create) {
+        return NULL;
+    }
+
+    if (DirenvDirectoryCount >= DIRENV_MAX_CACHED_DIRECTORIES) {
+        ListEntry = YoriLibGetPreviousListEntry(&DirenvDirectoryList, NULL);
+        Directory = CONTAINING_RECORD(ListEntry, DIRENV_DIRECTORY, ListEntry);
+        DirenvFreeDirectory(Directory);
+    }
+
+    Directory = YoriLibMalloc(sizeof(DIRENV_DIRECTORY));
+    if (Directory == NULL) {
+        return NULL;
+    }
+
+    ZeroMemory(Directory, sizeof(DIRENV_DIRECTORY));
+    if (!YoriLibAllocateString(&Directory->DirName, DirName->LengthInChars + 1)) {
+        YoriLibFree(Directory);
+        return NULL;
+    }
+
+    Directory->DirName.LengthInChars = YoriLibSPrintf(Directory->DirName.StartOfString, _T("%y"), DirName);
+    YoriLibInitializeListHead(&Directory->ApplyDelta.Changes);
+    YoriLibInitializeListHead(&Directory->UndoDelta.Changes);
+
+    YoriLibHashInsertByKey(DirenvDirectories, &Directory->DirName, Directory, &Directory->HashEntry);
+    YoriLibInsertList(&DirenvDirectoryList, &Directory->ListEntry);
+    DirenvDirectoryCount++;
+    return Directory;
+}
+
+/**
+ Check whether a directory contains a script, using the cached result if
+ the directory has not changed.
+
+ @param DirName Pointer to the name of the directory.
+
+ @param Directory On completion, updated to point to the cached directory,
+        or NULL if the directory could not be cached.
+
+ @return TRUE if the directory contains a script, FALSE if it does not.
+ */
+BOOLEAN
+DirenvDirectoryHasScript(
+    __in PYORI_STRING DirName,
+    __out PDIRENV_DIRECTORY *Directory
+    )
+{
+    FILETIME WriteTime;
+
+    *Directory = DirenvLookupDirectory(DirName, TRUE);
+    if (*Directory == NULL) {
+        return DirenvProbeDirectory(DirName, &WriteTime);
+    }
+
+    DirenvRefreshDirectory(*Directory);
+    return (*Directory)->ScriptExists;
+}
+
+/**
+ Run a script, or apply the changes recorded from the previous time it was
+ run if that is equivalent.  If the script is run, the changes it makes are
+ recorded.
+
+ @param Directory Optionally points to the cached directory containing the
+        script.  If NULL, the script is always run.
+
+ @param Expression Pointer to the expression to execute to run the script.
+
+ @param Undo TRUE if the script is being run to undo its changes, FALSE if
+        it is being run to apply them.
+ */
+VOID
+DirenvRunScript(
+    __in_opt PDIRENV_DIRECTORY Directory,
+    __in PYORI_STRING Expression,
+    __in BOOLEAN Undo
+    )
+{
+    PDIRENV_DELTA Delta;
+    DIRENV_SNAPSHOT Before;
+    DIRENV_SNAPSHOT After;
+    BOOLEAN Captured;
+
+    Delta = NULL;
+    if (Directory != NULL && Directory->ScriptExists) {
+        if (Undo) {
+            Delta = &Directory->UndoDelta;
+        } else {
+            Delta = &Directory->ApplyDelta;
+        }
+
+        if (DirenvReplayDelta(Delta)) {
+            return;
+        }
+
+        DirenvFreeDelta(Delta);
+    }
+
+    Captured = FALSE;
+    if (Delta != NULL) {
+        Captured = DirenvCaptureSnapshot(&Before);
+    }
+
+    DirenvApplyInvoked = TRUE;
+    YoriCallExecuteExpression(Expression);
+    DirenvApplyInvoked = FALSE;
+
+    if (Captured) {
+        if (DirenvCaptureSnapshot(&After)) {
+            DirenvComputeDelta(&Before, &After, Delta);
+            DirenvFreeSnapshot(&After);
+        }
+        DirenvFreeSnapshot(&Before);
+    }
+}
+
 /**
  Notification that the module is being unloaded or the shell is exiting,
  used to indicate any pending state should be cleaned up.
@@ -117,6 +1069,7 @@ DirenvNotifyUnload(VOID)
 {
     YoriLibFreeStringContents(&DirenvPreviousExecutedScript);
     YoriLibFreeStringContents(&DirenvPreviousCurrentDirectory);
+    DirenvFreeDirectoryCache();
 }
 
 /**
@@ -126,12 +1079,29 @@ DirenvNotifyUnload(VOID)
 VOID
 DirenvUndoPreviousScript(VOID)
 {
+    PDIRENV_DIRECTORY Directory;
+    YORI_STRING DirName;
+
+    //
+    //  Find the directory containing the script, if it is still cached, so
+    //  the changes from undoing it can be reused.
+    //
+
+    Directory = NULL;
+    if (DirenvPreviousExecutedScript.LengthInChars >= sizeof("\\envrc.ys1") - 1) {
+        YoriLibInitEmptyString(&DirName);
+        DirName.StartOfString = DirenvPreviousExecutedScript.StartOfString;
+        DirName.LengthInChars = DirenvPreviousExecutedScript.LengthInChars - sizeof("\\envrc.ys1") + 1;
+        Directory = DirenvLookupDirectory(&DirName, FALSE);
+        if (Directory != NULL) {
+            DirenvRefreshDirectory(Directory);
+        }
+    }
+
     YoriLibSPrintf(&DirenvPreviousExecutedScript.StartOfString[DirenvPreviousExecutedScript.LengthInChars], _T(" -undo"));
     DirenvPreviousExecutedScript.LengthInChars += sizeof(" -undo") - 1;
     ASSERT(DirenvPreviousExecutedScript.LengthInChars < DirenvPreviousExecutedScript.LengthAllocated);
-    DirenvApplyInvoked = TRUE;
-    YoriCallExecuteExpression(&DirenvPreviousExecutedScript);
-    DirenvApplyInvoked = FALSE;
+    DirenvRunScript(Directory, &DirenvPreviousExecutedScript, TRUE);
     YoriLibFreeStringContents(&DirenvPreviousExecutedScript);
 }
 
@@ -422,6 +1392,16 @@ DirenvApplyInternal(VOID)
     YORI_STRING NewScript;
     YORI_STRING CurrentDirectorySubset;
     YORI_STRING EnvName;
+    PDIRENV_DIRECTORY Directory;
+
+    //
+    //  If this is invoked from a script that it invokes, break the
+    //  recursion by not applying further updates
+    //
+
+    if (DirenvApplyInvoked) {
+        return EXIT_SUCCESS;
+    }
 
     //
     //  In the vast majority of cases, this module is already installed.
@@ -481,7 +1461,7 @@ DirenvApplyInternal(VOID)
     while (TRUE) {
         NewScript.LengthInChars = YoriLibSPrintf(NewScript.StartOfString, _T("%y\\envrc.ys1"), &CurrentDirectorySubset);
 
-        if (GetFileAttributes(NewScript.StartOfString) != (DWORD)-1) {
+        if (DirenvDirectoryHasScript(&CurrentDirectorySubset, &Directory)) {
 
             //
             //  If the script we found is the same one that's active, do
@@ -514,9 +1494,7 @@ DirenvApplyInternal(VOID)
             memcpy(&DirenvPreviousExecutedScript, &NewScript, sizeof(YORI_STRING));
             YoriLibInitEmptyString(&NewScript);
 
-            DirenvApplyInvoked = TRUE;
-            YoriCallExecuteExpression(&DirenvPreviousExecutedScript);
-            DirenvApplyInvoked = FALSE;
+            DirenvRunScript(Directory, &DirenvPreviousExecutedScript, FALSE);
             break;
         }
 
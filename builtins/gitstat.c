@@ -0,0 +1,295 @@
+/**
+ * @file builtins/gitstat.c
+ *
+ * Yori shell display git repository status without executing git
+ *
+ * Copyright (c) 2026 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <yoripch.h>
+#include <yorilib.h>
+
+/**
+ Help text to display to the user.
+ */
+const
+CHAR strGitStatHelpText[] =
+        "\n"
+        "Display the status of a git repository without executing git.\n"
+        "\n"
+        "GITSTAT [-license] [-f <fmt>] [-l [prefix]] [directory]\n"
+        "\n"
+        "   -f             Specify a custom format string\n"
+        "   -l             List local branches, optionally starting with prefix\n"
+        "\n"
+        "Format specifiers are:\n"
+        "   $BRANCH$       The current branch, or current commit if detached\n"
+        "   $HEAD$         The object name of the current commit\n"
+        "   $MODIFIED$     * if tracked files have been modified\n"
+        "   $UPSTREAM$     = if the branch matches its upstream, <> if it differs\n"
+        "   $WORKTREE$     The top level directory of the working tree\n";
+
+/**
+ Display usage text to the user.
+ */
+BOOL
+GitStatHelp(VOID)
+{
+    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("GitStat %i.%02i\n"), YORI_VER_MAJOR, YORI_VER_MINOR);
+#if YORI_BUILD_ID
+    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("  Build %i\n"), YORI_BUILD_ID);
+#endif
+    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%hs"), strGitStatHelpText);
+    return TRUE;
+}
+
+/**
+ Copy a string into a variable expansion buffer.
+
+ @param OutputBuffer The buffer to populate.
+
+ @param Value Pointer to the value to copy.
+
+ @return The number of characters populated, or the number of characters
+         required if the buffer is too small.
+ */
+YORI_ALLOC_SIZE_T
+GitStatOutputString(
+    __inout PYORI_STRING OutputBuffer,
+    __in PCYORI_STRING Value
+    )
+{
+    if (OutputBuffer->LengthAllocated >= Value->LengthInChars) {
+        memcpy(OutputBuffer->StartOfString, Value->StartOfString, Value->LengthInChars * sizeof(TCHAR));
+    }
+    return Value->LengthInChars;
+}
+
+/**
+ A callback function to expand any known variables found when parsing the
+ format string.
+
+ @param OutputBuffer A pointer to the output buffer to populate with data
+        if a known variable is found.
+
+ @param VariableName The variable name to expand.
+
+ @param Context Pointer to a YORI_LIB_GIT_STATUS structure containing
+        the data to populate.
+
+ @return The number of characters successfully populated, or the number
+         of characters required in order to successfully populate, or zero
+         on error.
+ */
+YORI_ALLOC_SIZE_T
+GitStatExpandVariables(
+    __inout PYORI_STRING OutputBuffer,
+    __in PYORI_STRING VariableName,
+    __in PVOID Context
+    )
+{
+    PYORI_LIB_GIT_STATUS Status = (PYORI_LIB_GIT_STATUS)Context;
+    YORI_STRING Value;
+
+    YoriLibInitEmptyString(&Value);
+    if (YoriLibCompareStringLit(VariableName, _T("BRANCH")) == 0) {
+        return GitStatOutputString(OutputBuffer, &Status->Branch);
+    } else if (YoriLibCompareStringLit(VariableName, _T("HEAD")) == 0) {
+        if (Status->ValidFields & YORI_LIB_GIT_STATUS_HEAD) {
+            YoriLibConstantString(&Value, Status->Head);
+        }
+    } else if (YoriLibCompareStringLit(VariableName, _T("MODIFIED")) == 0) {
+        if (Status->Modified) {
+            YoriLibConstantString(&Value, _T("*"));
+        }
+    } else if (YoriLibCompareStringLit(VariableName, _T("UPSTREAM")) == 0) {
+        if (Status->ValidFields & YORI_LIB_GIT_STATUS_UPSTREAM) {
+            if (Status->UpstreamMatches) {
+                YoriLibConstantString(&Value, _T("="));
+            } else {
+                YoriLibConstantString(&Value, _T("<>"));
+            }
+        }
+    } else if (YoriLibCompareStringLit(VariableName, _T("WORKTREE")) == 0) {
+        return GitStatOutputString(OutputBuffer, &Status->WorkTree);
+    } else {
+        return 0;
+    }
+
+    return GitStatOutputString(OutputBuffer, &Value);
+}
+
+/**
+ Display the local branches in a repository.
+
+ @param Directory Pointer to a directory within the repository.
+
+ @param Prefix Optionally points to a string that each branch displayed
+        should start with.  Comparison is case insensitive.
+
+ @return ExitCode, zero for success, nonzero for failure.
+ */
+DWORD
+GitStatListBranches(
+    __in PYORI_STRING Directory,
+    __in_opt PYORI_STRING Prefix
+    )
+{
+    YORI_STRING_ARRAY Branches;
+    YORI_ALLOC_SIZE_T Index;
+
+    YoriStringArrayInitialize(&Branches);
+    if (!YoriLibGitEnumerateBranches(Directory, &Branches)) {
+        YoriStringArrayCleanup(&Branches);
+        return EXIT_FAILURE;
+    }
+
+    for (Index = 0; Index < Branches.Count; Index++) {
+        if (Prefix == NULL ||
+            YoriLibCompareStringInsCnt(&Branches.Items[Index], Prefix, Prefix->LengthInChars) == 0) {
+
+            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y\n"), &Branches.Items[Index]);
+        }
+    }
+
+    YoriStringArrayCleanup(&Branches);
+    return EXIT_SUCCESS;
+}
+
+/**
+ Display git repository status.
+
+ @param ArgC The number of arguments.
+
+ @param ArgV The argument array.
+
+ @return ExitCode, zero for success, nonzero for failure.
+ */
+DWORD
+YORI_BUILTIN_FN
+YoriCmd_GITSTAT(
+    __in YORI_ALLOC_SIZE_T ArgC,
+    __in YORI_STRING ArgV[]
+    )
+{
+    BOOLEAN ArgumentUnderstood;
+    BOOLEAN ListBranches;
+    YORI_ALLOC_SIZE_T i;
+    YORI_ALLOC_SIZE_T StartArg;
+    YORI_STRING Arg;
+    YORI_STRING Directory;
+    YORI_STRING FormatString;
+    YORI_STRING DisplayString;
+    PYORI_STRING Prefix;
+    YORI_LIB_GIT_STATUS Status;
+    DWORD ExitCode;
+
+    YoriLibLoadNtDllFunctions();
+    YoriLibLoadKernel32Functions();
+
+    StartArg = 0;
+    ListBranches = FALSE;
+    Prefix = NULL;
+    YoriLibConstantString(&FormatString, _T("$BRANCH$ $UPSTREAM$$MODIFIED$\n"));
+
+    for (i = 1; i < ArgC; i++) {
+
+        ArgumentUnderstood = FALSE;
+        ASSERT(YoriLibIsStringNullTerminated(&ArgV[i]));
+
+        if (YoriLibIsCommandLineOption(&ArgV[i], &Arg)) {
+
+            if (YoriLibCompareStringLitIns(&Arg, _T("?")) == 0) {
+                GitStatHelp();
+                return EXIT_SUCCESS;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("license")) == 0) {
+                YoriLibDisplayMitLicense(_T("2026"));
+                return EXIT_SUCCESS;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("f")) == 0) {
+                if (ArgC > i + 1) {
+                    YoriLibCloneString(&FormatString, &ArgV[i + 1]);
+                    ArgumentUnderstood = TRUE;
+                    i++;
+                }
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("l")) == 0) {
+                ListBranches = TRUE;
+                ArgumentUnderstood = TRUE;
+                if (ArgC > i + 1) {
+                    Prefix = &ArgV[i + 1];
+                    i++;
+                }
+            }
+        } else {
+            ArgumentUnderstood = TRUE;
+            StartArg = i;
+            break;
+        }
+
+        if (!ArgumentUnderstood) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Argument not understood, ignored: %y\n"), &ArgV[i]);
+        }
+    }
+
+    YoriLibInitEmptyString(&Directory);
+    if (StartArg > 0) {
+        if (!YoriLibUserStringToSingleFilePath(&ArgV[StartArg], FALSE, &Directory)) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("gitstat: could not resolve %y\n"), &ArgV[StartArg]);
+            YoriLibFreeStringContents(&FormatString);
+            return EXIT_FAILURE;
+        }
+    } else if (!YoriLibGetCurrentDirectory(&Directory)) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("gitstat: could not query current directory\n"));
+        YoriLibFreeStringContents(&FormatString);
+        return EXIT_FAILURE;
+    }
+
+    if (ListBranches) {
+        ExitCode = GitStatListBranches(&Directory, Prefix);
+        YoriLibFreeStringContents(&Directory);
+        YoriLibFreeStringContents(&FormatString);
+        return ExitCode;
+    }
+
+    //
+    //  Outside of a repository, output nothing and fail, so scripts can
+    //  test whether a directory is in a repository.
+    //
+
+    if (!YoriLibGitGetStatus(&Directory, &Status)) {
+        YoriLibFreeStringContents(&Directory);
+        YoriLibFreeStringContents(&FormatString);
+        return EXIT_FAILURE;
+    }
+
+    YoriLibInitEmptyString(&DisplayString);
+    YoriLibExpandCommandVariables(&FormatString, '$', FALSE, GitStatExpandVariables, &Status, &DisplayString);
+    if (DisplayString.StartOfString != NULL) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y"), &DisplayString);
+        YoriLibFreeStringContents(&DisplayString);
+    }
+
+    YoriLibGitFreeStatus(&Status);
+    YoriLibFreeStringContents(&Directory);
+    YoriLibFreeStringContents(&FormatString);
+    return EXIT_SUCCESS;
+}
+
+// vim:sw=4:ts=4:et:
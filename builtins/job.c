@@ -37,11 +37,18 @@ CHAR strJobHelpText[] =
         "Displays or updates background job status.\n"
         "\n"
         "JOB [-license]\n"
+        "JOB ACCOUNTING <id>\n"
         "JOB ERRORS <id>\n"
         "JOB EXITCODE <id>\n"
         "JOB KILL <id>\n"
+        "JOB LIMIT [<count>]\n"
         "JOB NICE <id>\n"
-        "JOB OUTPUT <id>\n";
+        "JOB OUTPUT <id>\n"
+        "\n"
+        "JOB LIMIT sets the maximum number of background jobs that can execute at\n"
+        " once.  When this many are executing, starting another waits for one to\n"
+        " complete.  A count of zero removes the limit.  With no count, the current\n"
+        " limit is displayed.\n";
 
 /**
  Display usage text to the user.
@@ -139,7 +146,44 @@ YoriCmd_JOB(
 
     } else {
 
-        if (YoriLibCompareStringLitIns(&ArgV[1], _T("errors")) == 0) {
+        if (YoriLibCompareStringLitIns(&ArgV[1], _T("accounting")) == 0) {
+            YORI_LIB_JOB_ACCOUNTING Accounting;
+            if (ArgC < 3) {
+                YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Job not specified\n"));
+                return EXIT_FAILURE;
+            }
+            if (!YoriLibStringToNumber(&ArgV[2], TRUE, &llTemp, &CharsConsumed)) {
+                YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%y is not a valid job.\n"), &ArgV[2]);
+                return EXIT_FAILURE;
+            }
+            JobId = (DWORD)llTemp;
+            if (JobId == 0) {
+                YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%y is not a valid job.\n"), &ArgV[2]);
+                return EXIT_FAILURE;
+            }
+            if (!YoriCallGetJobAccounting(JobId, &Accounting)) {
+                YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%i could not return accounting information.\n"), JobId);
+                return EXIT_FAILURE;
+            }
+            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT,
+                          _T("User time (ms):    %lli\n")
+                          _T("Kernel time (ms):  %lli\n")
+                          _T("Processes:         %i (%i active)\n")
+                          _T("Page faults:       %i\n")
+                          _T("Peak commit:       %lli bytes\n")
+                          _T("Reads:             %lli (%lli bytes)\n")
+                          _T("Writes:            %lli (%lli bytes)\n"),
+                          Accounting.TotalUserTime.QuadPart / (10 * 1000),
+                          Accounting.TotalKernelTime.QuadPart / (10 * 1000),
+                          Accounting.TotalProcesses,
+                          Accounting.ActiveProcesses,
+                          Accounting.TotalPageFaultCount,
+                          Accounting.PeakJobCommit,
+                          Accounting.IoCounters.ReadOperations,
+                          Accounting.IoCounters.ReadBytes,
+                          Accounting.IoCounters.WriteOperations,
+                          Accounting.IoCounters.WriteBytes);
+        } else if (YoriLibCompareStringLitIns(&ArgV[1], _T("errors")) == 0) {
             YORI_STRING Output;
             YORI_STRING Errors;
             if (ArgC < 3) {
@@ -216,6 +260,22 @@ YoriCmd_JOB(
                 YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%i could not be terminated.\n"), JobId);
                 return EXIT_FAILURE;
             }
+        } else if (YoriLibCompareStringLitIns(&ArgV[1], _T("limit")) == 0) {
+            if (ArgC < 3) {
+                YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%i\n"), YoriCallGetJobLimit());
+                return EXIT_SUCCESS;
+            }
+            if (!YoriLibStringToNumber(&ArgV[2], TRUE, &llTemp, &CharsConsumed) ||
+                CharsConsumed == 0 ||
+                llTemp < 0) {
+
+                YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%y is not a valid limit.\n"), &ArgV[2]);
+                return EXIT_FAILURE;
+            }
+            if (!YoriCallSetJobLimit((DWORD)llTemp)) {
+                YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("job: could not set limit\n"));
+                return EXIT_FAILURE;
+            }
         } else if (YoriLibCompareStringLitIns(&ArgV[1], _T("nice")) == 0) {
             if (ArgC < 3) {
                 YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Job not specified\n"));
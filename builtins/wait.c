@@ -36,7 +36,9 @@ CHAR strWaitHelpText[] =
         "\n"
         "Wait for one job or all jobs to finish executing.\n"
         "\n"
-        "WAIT [-license] [<id>]\n";
+        "WAIT [-license] [-any] [<id>]\n"
+        "\n"
+        "   -any           Wait for any one executing job to finish\n";
 
 /**
  Display usage text to the user.
@@ -73,6 +75,7 @@ YoriCmd_WAIT(
     YORI_ALLOC_SIZE_T i;
     YORI_ALLOC_SIZE_T StartArg = 0;
     YORI_STRING Arg;
+    BOOLEAN WaitAny = FALSE;
 
     YoriLibLoadNtDllFunctions();
     YoriLibLoadKernel32Functions();
@@ -90,6 +93,9 @@ YoriCmd_WAIT(
             } else if (YoriLibCompareStringLitIns(&Arg, _T("license")) == 0) {
                 YoriLibDisplayMitLicense(_T("2017-2018"));
                 return EXIT_SUCCESS;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("any")) == 0) {
+                WaitAny = TRUE;
+                ArgumentUnderstood = TRUE;
             }
         } else {
             ArgumentUnderstood = TRUE;
@@ -102,7 +108,9 @@ YoriCmd_WAIT(
         }
     }
 
-    if (StartArg == 0) {
+    if (WaitAny) {
+        YoriCallWaitForAnyJob();
+    } else if (StartArg == 0) {
         JobId = YoriCallGetNextJobId(JobId);
         while (JobId != 0) {
             YoriCallWaitForJob(JobId);
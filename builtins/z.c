@@ -36,7 +36,14 @@ CHAR strZHelpText[] =
         "\n"
         "Changes the current directory based on a heuristic match.\n"
         "\n"
-        "Z [-license] <directory>\n";
+        "Z [-license] [-c [prefix]] [-l] [-u] <directory>\n"
+        "\n"
+        "   -c             List the names of remembered directories starting with prefix\n"
+        "   -l             List remembered directories\n"
+        "   -u             Unload remembered directories from the shell\n"
+        "\n"
+        "If YORIZFILE is set, directories are remembered in that file and shared\n"
+        "between processes.\n";
 
 /**
  Display usage text to the user.
@@ -53,9 +60,45 @@ ZHelp(VOID)
 }
 
 /**
- The number of recent directories to remember in memory.
+ The number of recent directories to remember.
+ */
+#define Z_MAX_RECENT_DIRS (4096)
+
+/**
+ The unit used to weight the different contributions to a directory's score.
+ */
+#define Z_SCORE_SCALE (64)
+
+/**
+ When the sum of the HitCount of all remembered directories exceeds this
+ value, each HitCount is reduced by one quarter.  This keeps HitCounts
+ relatively low while still maintaining a measurable difference between
+ entries hit a lot and entries rarely hit.
+ */
+#define Z_MAX_TOTAL_HITS (Z_MAX_RECENT_DIRS * 4)
+
+/**
+ The number of records that can be appended to the store before it is
+ considered for compaction.  The store is compacted once it contains more
+ than this many records and more than twice as many records as directories.
+ */
+#define Z_STORE_COMPACT_RECORDS (Z_MAX_RECENT_DIRS / 4)
+
+/**
+ The largest store file that will be read.
  */
-#define Z_MAX_RECENT_DIRS (64)
+#define Z_STORE_MAX_SIZE (64 * 1024 * 1024)
+
+/**
+ The number of seconds in an hour.
+ */
+#define Z_SECONDS_PER_HOUR (60 * 60)
+
+/**
+ The difference between the NT epoch of 1601 and the UNIX epoch of 1970,
+ in 100ns units.  Times in the store are recorded in seconds since 1970.
+ */
+#define Z_UNIX_EPOCH_OFFSET (116444736000000000)
 
 /**
  A linked list element corresponding to a remembered directory.
@@ -68,15 +111,32 @@ typedef struct _Z_RECENT_DIRECTORY {
      */
     YORI_LIST_ENTRY ListEntry;
 
+    /**
+     The entry for this directory within ZRecentDirectories.DirHash ,
+     indexed by directory name.
+     */
+    YORI_HASH_ENTRY HashEntry;
+
     /**
      The fully qualified name of the remembered directory.
      */
     YORI_STRING DirectoryName;
 
+    /**
+     The final component of DirectoryName.  This string refers to the same
+     buffer as DirectoryName and is not separately allocated.
+     */
+    YORI_STRING FinalComponent;
+
     /**
      The number of times the directory has been encountered.
      */
     DWORD HitCount;
+
+    /**
+     The time the directory was last encountered, in seconds since 1970.
+     */
+    LONGLONG LastAccessTime;
 } Z_RECENT_DIRECTORY, *PZ_RECENT_DIRECTORY;
 
 /**
@@ -88,6 +148,12 @@ typedef struct _Z_RECENT_DIRECTORIES {
      */
     YORI_LIST_ENTRY RecentDirList;
 
+    /**
+     A hash table of recent directories indexed by directory name, so that
+     a directory can be found without searching the list.
+     */
+    PYORI_HASH_TABLE DirHash;
+
     /**
      The number of items currently in the list of recent directories, so we
      can efficiently know when it's time to trim the list.
@@ -95,11 +161,46 @@ typedef struct _Z_RECENT_DIRECTORIES {
     DWORD RecentDirCount;
 
     /**
-     A monotonically increasing number corresponding to attempts to add items
-     into the recent list.  Periodically this will trigger logic to trim the
-     HitCount on all existing entries to prevent them counting to infinity.
+     The sum of the HitCount of all items in the list of recent directories,
+     so we can efficiently know when it's time to reduce them.
+     */
+    DWORD TotalHitCount;
+
+    /**
+     The fully qualified path to the store shared between processes, or an
+     empty string if directories are only remembered in this process.
+     */
+    YORI_STRING StorePath;
+
+    /**
+     The volume serial number of the store file whose contents have been
+     loaded.
+     */
+    DWORD StoreVolumeSerialNumber;
+
+    /**
+     The high 32 bits of the file index of the store file whose contents have
+     been loaded.
      */
-    DWORD MonotonicAddAttempt;
+    DWORD StoreFileIndexHigh;
+
+    /**
+     The low 32 bits of the file index of the store file whose contents have
+     been loaded.
+     */
+    DWORD StoreFileIndexLow;
+
+    /**
+     The number of bytes from the store file that have been loaded.  Records
+     appended after this point by any process are loaded on the next
+     invocation.
+     */
+    DWORD StoreBytesLoaded;
+
+    /**
+     The number of records that have been loaded from the store file.
+     */
+    DWORD StoreRecordsLoaded;
 
 } Z_RECENT_DIRECTORIES, *PZ_RECENT_DIRECTORIES;
 
@@ -111,6 +212,13 @@ typedef struct _Z_RECENT_DIRECTORIES {
  */
 typedef struct _Z_SCOREBOARD_ENTRY {
 
+    /**
+     The entry for this directory within the hash table of scoreboard
+     entries, so that a directory which is found more than once can have its
+     scores combined.
+     */
+    YORI_HASH_ENTRY HashEntry;
+
     /**
      The name of the directory.  Note that while the array is being
      constructed this string is not referenced, but still contains a
@@ -135,6 +243,121 @@ Z_RECENT_DIRECTORIES ZRecentDirectories;
  */
 BOOL ZCallbacksRegistered;
 
+/**
+ Return the current time in seconds since 1970.
+
+ @return The current time.
+ */
+LONGLONG
+ZGetCurrentTime(VOID)
+{
+    return (YoriLibGetSystemTimeAsInteger() - Z_UNIX_EPOCH_OFFSET) / (10 * 1000 * 1000);
+}
+
+/**
+ Calculate the score for a remembered directory based on how frequently and
+ how recently it has been used.
+
+ @param RecentDir Pointer to the remembered directory.
+
+ @param CurrentTime The current time, in seconds since 1970.
+
+ @return The score for the directory.
+ */
+DWORD
+ZFrecencyScore(
+    __in PZ_RECENT_DIRECTORY RecentDir,
+    __in LONGLONG CurrentTime
+    )
+{
+    LONGLONG Age;
+    DWORD Weight;
+
+    //
+    //  Weight each hit by how recently the directory was used, so a
+    //  directory used a lot last month can be displaced by one used a
+    //  few times today.
+    //
+
+    Age = CurrentTime - RecentDir->LastAccessTime;
+    if (Age < Z_SECONDS_PER_HOUR) {
+        Weight = 8;
+    } else if (Age < Z_SECONDS_PER_HOUR * 24) {
+        Weight = 4;
+    } else if (Age < Z_SECONDS_PER_HOUR * 24 * 7) {
+        Weight = 2;
+    } else {
+        Weight = 1;
+    }
+
+    return RecentDir->HitCount * Weight * (Z_SCORE_SCALE / 8);
+}
+
+/**
+ Allocate the hash table used to find remembered directories if it has not
+ already been allocated.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+ZInitializeRecent(VOID)
+{
+    if (ZRecentDirectories.RecentDirList.Next == NULL) {
+        YoriLibInitializeListHead(&ZRecentDirectories.RecentDirList);
+    }
+
+    if (ZRecentDirectories.DirHash == NULL) {
+        ZRecentDirectories.DirHash = YoriLibAllocateHashTable(256);
+        if (ZRecentDirectories.DirHash == NULL) {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+/**
+ Remove a remembered directory and free it.
+
+ @param RecentDir Pointer to the remembered directory.
+ */
+VOID
+ZFreeRecentDirectory(
+    __in PZ_RECENT_DIRECTORY RecentDir
+    )
+{
+    YoriLibRemoveListItem(&RecentDir->ListEntry);
+    YoriLibHashRemoveByEntry(&RecentDir->HashEntry);
+    ZRecentDirectories.RecentDirCount--;
+    ZRecentDirectories.TotalHitCount -= RecentDir->HitCount;
+    YoriLibFreeStringContents(&RecentDir->DirectoryName);
+    YoriLibDereference(RecentDir);
+}
+
+/**
+ Forget all remembered directories.
+ */
+VOID
+ZResetRecent(VOID)
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PZ_RECENT_DIRECTORY FoundRecentDir;
+
+    if (ZRecentDirectories.RecentDirList.Next == NULL) {
+        return;
+    }
+
+    ListEntry = YoriLibGetNextListEntry(&ZRecentDirectories.RecentDirList, NULL);
+    while (ListEntry != NULL) {
+        FoundRecentDir = CONTAINING_RECORD(ListEntry, Z_RECENT_DIRECTORY, ListEntry);
+        ListEntry = YoriLibGetNextListEntry(&ZRecentDirectories.RecentDirList, ListEntry);
+        ZFreeRecentDirectory(FoundRecentDir);
+    }
+
+    ASSERT(ZRecentDirectories.RecentDirCount == 0);
+    ASSERT(ZRecentDirectories.TotalHitCount == 0);
+}
+
 /**
  Display the current known list of recent directories in order of most
  recently used to least recently used with their corresponding hit count.
@@ -147,6 +370,10 @@ ZListStack(VOID)
     PYORI_LIST_ENTRY ListEntry;
     PZ_RECENT_DIRECTORY FoundRecentDir;
 
+    if (ZRecentDirectories.RecentDirCount == 0) {
+        return TRUE;
+    }
+
     ListEntry = YoriLibGetNextListEntry(&ZRecentDirectories.RecentDirList, NULL);
     while (ListEntry != NULL) {
         FoundRecentDir = CONTAINING_RECORD(ListEntry, Z_RECENT_DIRECTORY, ListEntry);
@@ -156,6 +383,136 @@ ZListStack(VOID)
     return TRUE;
 }
 
+/**
+ Display the final component of each remembered directory which starts with
+ a prefix, in order of score, for use by tab completion.  Each name is only
+ displayed once.
+
+ @param Prefix Optionally points to a string that each name displayed should
+        start with.  Comparison is case insensitive.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+ZListCompletions(
+    __in_opt PYORI_STRING Prefix
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PZ_RECENT_DIRECTORY FoundRecentDir;
+    PZ_SCOREBOARD_ENTRY Entries;
+    PYORI_HASH_TABLE NameHash;
+    PYORI_HASH_ENTRY HashEntry;
+    PZ_SCOREBOARD_ENTRY Existing;
+    Z_SCOREBOARD_ENTRY Swap;
+    DWORD EntriesPopulated;
+    DWORD Index;
+    DWORD SortIndex;
+    DWORD ScoreForThisEntry;
+    LONGLONG CurrentTime;
+
+    if (ZRecentDirectories.RecentDirCount == 0) {
+        return TRUE;
+    }
+
+    Entries = YoriLibMalloc(sizeof(Z_SCOREBOARD_ENTRY) * ZRecentDirectories.RecentDirCount);
+    if (Entries == NULL) {
+        return FALSE;
+    }
+
+    NameHash = YoriLibAllocateHashTable(256);
+    if (NameHash == NULL) {
+        YoriLibFree(Entries);
+        return FALSE;
+    }
+
+    //
+    //  Combine the scores of directories with the same final component,
+    //  since completing the name selects between them based on score.
+    //
+
+    CurrentTime = ZGetCurrentTime();
+    EntriesPopulated = 0;
+    ListEntry = YoriLibGetNextListEntry(&ZRecentDirectories.RecentDirList, NULL);
+    while (ListEntry != NULL) {
+        FoundRecentDir = CONTAINING_RECORD(ListEntry, Z_RECENT_DIRECTORY, ListEntry);
+        ListEntry = YoriLibGetNextListEntry(&ZRecentDirectories.RecentDirList, ListEntry);
+
+        if (FoundRecentDir->FinalComponent.LengthInChars == 0) {
+            continue;
+        }
+
+        if (Prefix != NULL &&
+            YoriLibCompareStringInsCnt(&FoundRecentDir->FinalComponent, Prefix, Prefix->LengthInChars) != 0) {
+
+            continue;
+        }
+
+        ScoreForThisEntry = ZFrecencyScore(FoundRecentDir, CurrentTime);
+        HashEntry = YoriLibHashLookupByKey(NameHash, &FoundRecentDir->FinalComponent);
+        if (HashEntry != NULL) {
+            Existing = HashEntry->Context;
+            Existing->Score += ScoreForThisEntry;
+            continue;
+        }
+
+        YoriLibCloneString(&Entries[EntriesPopulated].DirectoryName, &FoundRecentDir->FinalComponent);
+        Entries[EntriesPopulated].Score = ScoreForThisEntry;
+        YoriLibHashInsertByKey(NameHash, &Entries[EntriesPopulated].DirectoryName, &Entries[EntriesPopulated], &Entries[EntriesPopulated].HashEntry);
+        EntriesPopulated++;
+    }
+
+    for (Index = 0; Index < EntriesPopulated; Index++) {
+        YoriLibHashRemoveByEntry(&Entries[Index].HashEntry);
+    }
+    YoriLibFreeEmptyHashTable(NameHash);
+
+    //
+    //  Sort the names by score.  Entries are already in most recently used
+    //  order, so this is a stable insertion sort to preserve that order
+    //  between names with equal scores.
+    //
+
+    for (Index = 1; Index < EntriesPopulated; Index++) {
+        memcpy(&Swap, &Entries[Index], sizeof(Z_SCOREBOARD_ENTRY));
+        SortIndex = Index;
+        while (SortIndex > 0 && Entries[SortIndex - 1].Score < Swap.Score) {
+            memcpy(&Entries[SortIndex], &Entries[SortIndex - 1], sizeof(Z_SCOREBOARD_ENTRY));
+            SortIndex--;
+        }
+        memcpy(&Entries[SortIndex], &Swap, sizeof(Z_SCOREBOARD_ENTRY));
+    }
+
+    for (Index = 0; Index < EntriesPopulated; Index++) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y\n"), &Entries[Index].DirectoryName);
+        YoriLibFreeStringContents(&Entries[Index].DirectoryName);
+    }
+
+    YoriLibFree(Entries);
+    return TRUE;
+}
+
+/**
+ Reduce the HitCount of all remembered directories by one quarter of its
+ current value.
+ */
+VOID
+ZReduceHitCounts(VOID)
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PZ_RECENT_DIRECTORY FoundRecentDir;
+
+    ZRecentDirectories.TotalHitCount = 0;
+    ListEntry = YoriLibGetNextListEntry(&ZRecentDirectories.RecentDirList, NULL);
+    while (ListEntry != NULL) {
+        FoundRecentDir = CONTAINING_RECORD(ListEntry, Z_RECENT_DIRECTORY, ListEntry);
+        ListEntry = YoriLibGetNextListEntry(&ZRecentDirectories.RecentDirList, ListEntry);
+        FoundRecentDir->HitCount -= (FoundRecentDir->HitCount >> 2);
+        ASSERT(FoundRecentDir->HitCount > 0);
+        ZRecentDirectories.TotalHitCount += FoundRecentDir->HitCount;
+    }
+}
+
 /**
  Check the recent directories for a match to DirectoryName.  If a match is
  found, promote it to be the most recent entry and update its HitCount.
@@ -164,116 +521,530 @@ ZListStack(VOID)
 
  @param DirectoryName Pointer to the fully qualified directory name to add.
 
+ @param HitCount The number of times the directory has been encountered.
+
+ @param AccessTime The time the directory was most recently encountered, in
+        seconds since 1970.
+
  @return TRUE if the entry was successfully added, FALSE if it was not.
  */
 BOOL
 ZAddDirectoryToRecent(
-    __in PYORI_STRING DirectoryName
+    __in PYORI_STRING DirectoryName,
+    __in DWORD HitCount,
+    __in LONGLONG AccessTime
     )
 {
     PYORI_LIST_ENTRY ListEntry;
+    PYORI_HASH_ENTRY HashEntry;
     PZ_RECENT_DIRECTORY FoundRecentDir;
+    LPTSTR FinalSeperator;
 
-    if (ZRecentDirectories.RecentDirList.Next == NULL) {
-        YoriLibInitializeListHead(&ZRecentDirectories.RecentDirList);
+    if (DirectoryName->LengthInChars == 0 || HitCount == 0) {
+        return FALSE;
+    }
+
+    if (!ZInitializeRecent()) {
+        return FALSE;
     }
 
     //
-    //  If this attempt to add is a multiple of 1/4th of the size of the
-    //  list, decrease each HitCount by 1/4th of its current value.
-    //  This math isn't completely perfect, but it will tend to keep
-    //  HitCounts relatively low while still maintaining a measurable
-    //  difference between entries hit a lot and entries rarely hit.
+    //  Check if the new directory already exists in the recent directory
+    //  list, update its position to be head of the list, increase its
+    //  HitCount, and return.
     //
 
-    ZRecentDirectories.MonotonicAddAttempt++;
-    if ((ZRecentDirectories.MonotonicAddAttempt % (Z_MAX_RECENT_DIRS >> 2)) == 0) {
-        ListEntry = YoriLibGetNextListEntry(&ZRecentDirectories.RecentDirList, NULL);
-        while (ListEntry != NULL) {
+    HashEntry = YoriLibHashLookupByKey(ZRecentDirectories.DirHash, DirectoryName);
+    if (HashEntry != NULL) {
+        FoundRecentDir = HashEntry->Context;
+        YoriLibRemoveListItem(&FoundRecentDir->ListEntry);
+        YoriLibInsertList(&ZRecentDirectories.RecentDirList, &FoundRecentDir->ListEntry);
+        FoundRecentDir->HitCount += HitCount;
+        ZRecentDirectories.TotalHitCount += HitCount;
+        if (AccessTime > FoundRecentDir->LastAccessTime) {
+            FoundRecentDir->LastAccessTime = AccessTime;
+        }
+    } else {
+
+        //
+        //  Since it's not in the list, evict the oldest entry if the list
+        //  has reached its maximum size.
+        //
+
+        if (ZRecentDirectories.RecentDirCount >= Z_MAX_RECENT_DIRS) {
+            ListEntry = YoriLibGetPreviousListEntry(&ZRecentDirectories.RecentDirList, NULL);
             FoundRecentDir = CONTAINING_RECORD(ListEntry, Z_RECENT_DIRECTORY, ListEntry);
-            ListEntry = YoriLibGetNextListEntry(&ZRecentDirectories.RecentDirList, ListEntry);
-            FoundRecentDir->HitCount -= (FoundRecentDir->HitCount >> 2);
-            ASSERT(FoundRecentDir->HitCount > 0);
+            ZFreeRecentDirectory(FoundRecentDir);
         }
+
+        //
+        //  Attempt to insert a new entry corresponding to this directory.
+        //
+
+        FoundRecentDir = YoriLibReferencedMalloc(sizeof(Z_RECENT_DIRECTORY) + (DirectoryName->LengthInChars + 1) * sizeof(TCHAR));
+        if (FoundRecentDir == NULL) {
+            return FALSE;
+        }
+
+        YoriLibReference(FoundRecentDir);
+        FoundRecentDir->DirectoryName.MemoryToFree = FoundRecentDir;
+        FoundRecentDir->DirectoryName.StartOfString = (LPWSTR)(FoundRecentDir + 1);
+        FoundRecentDir->DirectoryName.LengthAllocated = DirectoryName->LengthInChars + 1;
+        FoundRecentDir->DirectoryName.LengthInChars = DirectoryName->LengthInChars;
+
+        memcpy(FoundRecentDir->DirectoryName.StartOfString, DirectoryName->StartOfString, DirectoryName->LengthInChars * sizeof(TCHAR));
+        FoundRecentDir->DirectoryName.StartOfString[DirectoryName->LengthInChars] = '\0';
+
+        YoriLibInitEmptyString(&FoundRecentDir->FinalComponent);
+        FinalSeperator = YoriLibFindRightMostCharacter(&FoundRecentDir->DirectoryName, '\\');
+        if (FinalSeperator != NULL) {
+            FoundRecentDir->FinalComponent.StartOfString = FinalSeperator + 1;
+            FoundRecentDir->FinalComponent.LengthInChars = FoundRecentDir->DirectoryName.LengthInChars - (YORI_ALLOC_SIZE_T)(FoundRecentDir->FinalComponent.StartOfString - FoundRecentDir->DirectoryName.StartOfString);
+        }
+
+        FoundRecentDir->HitCount = HitCount;
+        FoundRecentDir->LastAccessTime = AccessTime;
+
+        YoriLibInsertList(&ZRecentDirectories.RecentDirList, &FoundRecentDir->ListEntry);
+        YoriLibHashInsertByKey(ZRecentDirectories.DirHash, &FoundRecentDir->DirectoryName, FoundRecentDir, &FoundRecentDir->HashEntry);
+        ZRecentDirectories.RecentDirCount++;
+        ZRecentDirectories.TotalHitCount += HitCount;
+
+        ASSERT(ZRecentDirectories.RecentDirCount <= Z_MAX_RECENT_DIRS);
+    }
+
+    if (ZRecentDirectories.TotalHitCount > Z_MAX_TOTAL_HITS) {
+        ZReduceHitCounts();
     }
 
+    return TRUE;
+}
+
+/**
+ Parse a single record from the store.  Records are in the form
+ "directory|hitcount|time".
+
+ @param Line Pointer to the record.
+
+ @param DirectoryName On successful completion, updated to point to the
+        directory name within the record.
+
+ @param HitCount On successful completion, updated to contain the number of
+        times the directory was encountered.
+
+ @param AccessTime On successful completion, updated to contain the time the
+        directory was most recently encountered, in seconds since 1970.
+
+ @return TRUE to indicate the record was parsed, FALSE if it is malformed.
+ */
+__success(return)
+BOOL
+ZParseStoreRecord(
+    __in PYORI_STRING Line,
+    __out PYORI_STRING DirectoryName,
+    __out PDWORD HitCount,
+    __out PLONGLONG AccessTime
+    )
+{
+    YORI_STRING Field;
+    YORI_MAX_SIGNED_T Number;
+    YORI_ALLOC_SIZE_T CharsConsumed;
+    LPTSTR Seperator;
+
+    YoriLibInitEmptyString(DirectoryName);
+    DirectoryName->StartOfString = Line->StartOfString;
+    DirectoryName->LengthInChars = Line->LengthInChars;
+
     //
-    //  Check if the new directory already exists in the recent directory
-    //  list, update its position to be head of the list, increase its
-    //  HitCount, and return.
+    //  Parse fields from the right so the directory name is everything
+    //  before the second last seperator.
     //
 
-    ListEntry = YoriLibGetNextListEntry(&ZRecentDirectories.RecentDirList, NULL);
-    while (ListEntry != NULL) {
-        FoundRecentDir = CONTAINING_RECORD(ListEntry, Z_RECENT_DIRECTORY, ListEntry);
-        if (YoriLibCompareStringIns(DirectoryName, &FoundRecentDir->DirectoryName) == 0) {
-            YoriLibRemoveListItem(&FoundRecentDir->ListEntry);
-            YoriLibInsertList(&ZRecentDirectories.RecentDirList, &FoundRecentDir->ListEntry);
-            FoundRecentDir->HitCount++;
+    Seperator = YoriLibFindRightMostCharacter(DirectoryName, '|');
+    if (Seperator == NULL) {
+        return FALSE;
+    }
+
+    YoriLibInitEmptyString(&Field);
+    Field.StartOfString = Seperator + 1;
+    Field.LengthInChars = DirectoryName->LengthInChars - (YORI_ALLOC_SIZE_T)(Field.StartOfString - DirectoryName->StartOfString);
+    DirectoryName->LengthInChars = (YORI_ALLOC_SIZE_T)(Seperator - DirectoryName->StartOfString);
+    if (!YoriLibStringToNumber(&Field, FALSE, &Number, &CharsConsumed) || CharsConsumed == 0) {
+        return FALSE;
+    }
+    *AccessTime = Number;
+
+    Seperator = YoriLibFindRightMostCharacter(DirectoryName, '|');
+    if (Seperator == NULL) {
+        return FALSE;
+    }
+
+    Field.StartOfString = Seperator + 1;
+    Field.LengthInChars = DirectoryName->LengthInChars - (YORI_ALLOC_SIZE_T)(Field.StartOfString - DirectoryName->StartOfString);
+    DirectoryName->LengthInChars = (YORI_ALLOC_SIZE_T)(Seperator - DirectoryName->StartOfString);
+    if (!YoriLibStringToNumber(&Field, FALSE, &Number, &CharsConsumed) || CharsConsumed == 0 || Number <= 0) {
+        return FALSE;
+    }
+    *HitCount = (DWORD)Number;
+
+    if (DirectoryName->LengthInChars == 0) {
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ Determine the store shared between processes from the YORIZFILE
+ environment variable.  If the store has changed since the previous
+ invocation, forget any directories loaded from the previous store.
+
+ @return TRUE if a store is configured, FALSE if directories are only
+         remembered in this process.
+ */
+BOOL
+ZUpdateStorePath(VOID)
+{
+    YORI_STRING EnvValue;
+    YORI_STRING FullPath;
+
+    YoriLibInitEmptyString(&EnvValue);
+    YoriLibInitEmptyString(&FullPath);
+    if (YoriLibAllocateAndGetEnvVar(_T("YORIZFILE"), &EnvValue) &&
+        EnvValue.LengthInChars > 0) {
+
+        if (!YoriLibUserStringToSingleFilePath(&EnvValue, TRUE, &FullPath)) {
+            YoriLibInitEmptyString(&FullPath);
+        }
+    }
+    YoriLibFreeStringContents(&EnvValue);
+
+    if (YoriLibCompareStringIns(&FullPath, &ZRecentDirectories.StorePath) != 0) {
+        ZResetRecent();
+        YoriLibFreeStringContents(&ZRecentDirectories.StorePath);
+        memcpy(&ZRecentDirectories.StorePath, &FullPath, sizeof(YORI_STRING));
+        ZRecentDirectories.StoreVolumeSerialNumber = 0;
+        ZRecentDirectories.StoreFileIndexHigh = 0;
+        ZRecentDirectories.StoreFileIndexLow = 0;
+        ZRecentDirectories.StoreBytesLoaded = 0;
+        ZRecentDirectories.StoreRecordsLoaded = 0;
+    } else {
+        YoriLibFreeStringContents(&FullPath);
+    }
+
+    if (ZRecentDirectories.StorePath.LengthInChars == 0) {
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ Load any records from the store that have not yet been loaded into this
+ process.  Records are only appended to the store, so this normally only
+ reads records added since the previous invocation.  If the store has been
+ replaced by compaction, all records are reloaded.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+ZLoadStore(VOID)
+{
+    HANDLE FileHandle;
+    BY_HANDLE_FILE_INFORMATION FileInfo;
+    DWORD BytesToRead;
+    DWORD BytesRead;
+    DWORD LineStart;
+    DWORD Index;
+    DWORD HitCount;
+    LONGLONG AccessTime;
+    LPSTR Buffer;
+    YORI_STRING Line;
+    YORI_STRING DirectoryName;
+    YORI_ALLOC_SIZE_T CharsNeeded;
+
+    FileHandle = CreateFile(ZRecentDirectories.StorePath.StartOfString,
+                            GENERIC_READ,
+                            FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                            NULL,
+                            OPEN_EXISTING,
+                            FILE_ATTRIBUTE_NORMAL,
+                            NULL);
+
+    if (FileHandle == INVALID_HANDLE_VALUE) {
+        if (GetLastError() == ERROR_FILE_NOT_FOUND) {
             return TRUE;
         }
-        ListEntry = YoriLibGetNextListEntry(&ZRecentDirectories.RecentDirList, ListEntry);
+        return FALSE;
+    }
+
+    if (!GetFileInformationByHandle(FileHandle, &FileInfo) ||
+        FileInfo.nFileSizeHigh != 0 ||
+        FileInfo.nFileSizeLow > Z_STORE_MAX_SIZE) {
+
+        CloseHandle(FileHandle);
+        return FALSE;
     }
 
     //
-    //  Since it's not in the list, evict the oldest entry if the list has
-    //  reached its maximum size.
+    //  If this is a different file to the one previously loaded, or it has
+    //  been truncated, start again.
     //
 
-    if (ZRecentDirectories.RecentDirCount >= Z_MAX_RECENT_DIRS) {
-        ListEntry = YoriLibGetPreviousListEntry(&ZRecentDirectories.RecentDirList, NULL);
-        FoundRecentDir = CONTAINING_RECORD(ListEntry, Z_RECENT_DIRECTORY, ListEntry);
-        YoriLibRemoveListItem(&FoundRecentDir->ListEntry);
-        YoriLibFreeStringContents(&FoundRecentDir->DirectoryName);
-        YoriLibDereference(FoundRecentDir);
-        ZRecentDirectories.RecentDirCount--;
+    if (FileInfo.dwVolumeSerialNumber != ZRecentDirectories.StoreVolumeSerialNumber ||
+        FileInfo.nFileIndexHigh != ZRecentDirectories.StoreFileIndexHigh ||
+        FileInfo.nFileIndexLow != ZRecentDirectories.StoreFileIndexLow ||
+        FileInfo.nFileSizeLow < ZRecentDirectories.StoreBytesLoaded) {
+
+        ZResetRecent();
+        ZRecentDirectories.StoreVolumeSerialNumber = FileInfo.dwVolumeSerialNumber;
+        ZRecentDirectories.StoreFileIndexHigh = FileInfo.nFileIndexHigh;
+        ZRecentDirectories.StoreFileIndexLow = FileInfo.nFileIndexLow;
+        ZRecentDirectories.StoreBytesLoaded = 0;
+        ZRecentDirectories.StoreRecordsLoaded = 0;
+    }
+
+    BytesToRead = FileInfo.nFileSizeLow - ZRecentDirectories.StoreBytesLoaded;
+    if (BytesToRead == 0) {
+        CloseHandle(FileHandle);
+        return TRUE;
     }
 
+    Buffer = YoriLibMalloc(BytesToRead);
+    if (Buffer == NULL) {
+        CloseHandle(FileHandle);
+        return FALSE;
+    }
+
+    if (SetFilePointer(FileHandle, ZRecentDirectories.StoreBytesLoaded, NULL, FILE_BEGIN) == INVALID_SET_FILE_POINTER ||
+        !ReadFile(FileHandle, Buffer, BytesToRead, &BytesRead, NULL)) {
+
+        YoriLibFree(Buffer);
+        CloseHandle(FileHandle);
+        return FALSE;
+    }
+    CloseHandle(FileHandle);
+
     //
-    //  Attempt to insert a new entry corresponding to this directory.
+    //  Process each complete line.  A line without a terminator may still
+    //  be being written, so it is left to be processed next time.
     //
 
-    FoundRecentDir = YoriLibReferencedMalloc(sizeof(Z_RECENT_DIRECTORY) + (DirectoryName->LengthInChars + 1) * sizeof(TCHAR));
-    if (FoundRecentDir == NULL) {
+    YoriLibInitEmptyString(&Line);
+    LineStart = 0;
+    for (Index = 0; Index < BytesRead; Index++) {
+        if (Buffer[Index] != '\n') {
+            continue;
+        }
+
+        CharsNeeded = (YORI_ALLOC_SIZE_T)MultiByteToWideChar(CP_UTF8, 0, &Buffer[LineStart], (int)(Index - LineStart), NULL, 0);
+        if (CharsNeeded > 0 &&
+            (CharsNeeded <= Line.LengthAllocated || YoriLibReallocStringNoContents(&Line, CharsNeeded + 64))) {
+
+            Line.LengthInChars = (YORI_ALLOC_SIZE_T)MultiByteToWideChar(CP_UTF8, 0, &Buffer[LineStart], (int)(Index - LineStart), Line.StartOfString, (int)Line.LengthAllocated);
+            if (Line.LengthInChars > 0 && Line.StartOfString[Line.LengthInChars - 1] == '\r') {
+                Line.LengthInChars--;
+            }
+
+            if (ZParseStoreRecord(&Line, &DirectoryName, &HitCount, &AccessTime)) {
+                ZAddDirectoryToRecent(&DirectoryName, HitCount, AccessTime);
+            }
+        }
+
+        ZRecentDirectories.StoreRecordsLoaded++;
+        LineStart = Index + 1;
+    }
+
+    ZRecentDirectories.StoreBytesLoaded += LineStart;
+    YoriLibFreeStringContents(&Line);
+    YoriLibFree(Buffer);
+    return TRUE;
+}
+
+/**
+ Convert a string to UTF-8 and write it to a file with a single write, so
+ that records appended by concurrent processes are not interleaved.
+
+ @param FileHandle Handle to the file.
+
+ @param Text Pointer to the string to write.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+ZWriteStoreText(
+    __in HANDLE FileHandle,
+    __in PYORI_STRING Text
+    )
+{
+    LPSTR Buffer;
+    DWORD BytesNeeded;
+    DWORD BytesWritten;
+    BOOL Result;
+
+    BytesNeeded = (DWORD)WideCharToMultiByte(CP_UTF8, 0, Text->StartOfString, (int)Text->LengthInChars, NULL, 0, NULL, NULL);
+    if (BytesNeeded == 0) {
+        return FALSE;
+    }
+
+    Buffer = YoriLibMalloc(BytesNeeded);
+    if (Buffer == NULL) {
         return FALSE;
     }
 
-    YoriLibReference(FoundRecentDir);
-    FoundRecentDir->DirectoryName.MemoryToFree = FoundRecentDir;
-    FoundRecentDir->DirectoryName.StartOfString = (LPWSTR)(FoundRecentDir + 1);
-    FoundRecentDir->DirectoryName.LengthAllocated = DirectoryName->LengthInChars + 1;
-    FoundRecentDir->DirectoryName.LengthInChars = DirectoryName->LengthInChars;
+    WideCharToMultiByte(CP_UTF8, 0, Text->StartOfString, (int)Text->LengthInChars, Buffer, (int)BytesNeeded, NULL, NULL);
+    Result = WriteFile(FileHandle, Buffer, BytesNeeded, &BytesWritten, NULL);
+    if (BytesWritten != BytesNeeded) {
+        Result = FALSE;
+    }
 
-    memcpy(FoundRecentDir->DirectoryName.StartOfString, DirectoryName->StartOfString, (DirectoryName->LengthInChars + 1) * sizeof(TCHAR));
+    YoriLibFree(Buffer);
+    return Result;
+}
 
-    FoundRecentDir->HitCount = 1;
+/**
+ Append records to the store indicating that directories have been
+ encountered.  The records are not added to this process directly; they are
+ loaded from the store along with any records from other processes.  Each
+ record is written with a single append so records from concurrent processes
+ are not interleaved.
 
-    YoriLibInsertList(&ZRecentDirectories.RecentDirList, &FoundRecentDir->ListEntry);
-    ZRecentDirectories.RecentDirCount++;
+ @param DirectoryNames An array of fully qualified directory names.
 
-    ASSERT(ZRecentDirectories.RecentDirCount <= Z_MAX_RECENT_DIRS);
+ @param DirectoryCount The number of elements in DirectoryNames.
 
-    return TRUE;
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+ZAppendToStore(
+    __in PYORI_STRING DirectoryNames,
+    __in DWORD DirectoryCount
+    )
+{
+    HANDLE FileHandle;
+    YORI_STRING Record;
+    LONGLONG CurrentTime;
+    DWORD Index;
+    BOOL Result;
+
+    FileHandle = CreateFile(ZRecentDirectories.StorePath.StartOfString,
+                            FILE_APPEND_DATA,
+                            FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                            NULL,
+                            OPEN_ALWAYS,
+                            FILE_ATTRIBUTE_NORMAL,
+                            NULL);
+
+    if (FileHandle == INVALID_HANDLE_VALUE) {
+        return FALSE;
+    }
+
+    Result = TRUE;
+    CurrentTime = ZGetCurrentTime();
+    YoriLibInitEmptyString(&Record);
+    for (Index = 0; Index < DirectoryCount; Index++) {
+        if (YoriLibYPrintf(&Record, _T("%y|1|%lli\n"), &DirectoryNames[Index], CurrentTime) < 0 ||
+            !ZWriteStoreText(FileHandle, &Record)) {
+
+            Result = FALSE;
+            break;
+        }
+    }
+
+    YoriLibFreeStringContents(&Record);
+    CloseHandle(FileHandle);
+    return Result;
 }
 
 /**
- Called when the module is unloaded to clean up state.
+ If the store contains many more records than remembered directories,
+ replace it with one record per directory.  The new store is written to a
+ temporary file and renamed over the existing store, so processes reading
+ the store observe either the old or new contents.  If another process is
+ compacting the store concurrently, this process leaves it alone.
+
+ @return TRUE to indicate the store was compacted, FALSE if it was not.
  */
-VOID
-YORI_BUILTIN_FN
-ZNotifyUnload(VOID)
+BOOL
+ZCompactStore(VOID)
 {
+    HANDLE FileHandle;
+    YORI_STRING TempPath;
+    YORI_STRING Text;
     PYORI_LIST_ENTRY ListEntry;
     PZ_RECENT_DIRECTORY FoundRecentDir;
+    BOOL Result;
 
-    ListEntry = YoriLibGetNextListEntry(&ZRecentDirectories.RecentDirList, NULL);
+    if (ZRecentDirectories.StoreRecordsLoaded <= Z_STORE_COMPACT_RECORDS ||
+        ZRecentDirectories.StoreRecordsLoaded <= 2 * ZRecentDirectories.RecentDirCount) {
+
+        return FALSE;
+    }
+
+    YoriLibInitEmptyString(&TempPath);
+    if (YoriLibYPrintf(&TempPath, _T("%y.tmp"), &ZRecentDirectories.StorePath) < 0) {
+        return FALSE;
+    }
+
+    FileHandle = CreateFile(TempPath.StartOfString,
+                            GENERIC_WRITE,
+                            0,
+                            NULL,
+                            CREATE_ALWAYS,
+                            FILE_ATTRIBUTE_NORMAL,
+                            NULL);
+
+    if (FileHandle == INVALID_HANDLE_VALUE) {
+        YoriLibFreeStringContents(&TempPath);
+        return FALSE;
+    }
+
+    //
+    //  Write the least recently used directory first so that loading the
+    //  store reconstructs the same order.
+    //
+
+    Result = TRUE;
+    YoriLibInitEmptyString(&Text);
+    ListEntry = YoriLibGetPreviousListEntry(&ZRecentDirectories.RecentDirList, NULL);
     while (ListEntry != NULL) {
         FoundRecentDir = CONTAINING_RECORD(ListEntry, Z_RECENT_DIRECTORY, ListEntry);
-        ListEntry = YoriLibGetNextListEntry(&ZRecentDirectories.RecentDirList, ListEntry);
-        YoriLibRemoveListItem(&FoundRecentDir->ListEntry);
-        YoriLibFreeStringContents(&FoundRecentDir->DirectoryName);
-        YoriLibDereference(FoundRecentDir);
+        ListEntry = YoriLibGetPreviousListEntry(&ZRecentDirectories.RecentDirList, ListEntry);
+        if (YoriLibYPrintf(&Text, _T("%y|%i|%lli\n"), &FoundRecentDir->DirectoryName, FoundRecentDir->HitCount, FoundRecentDir->LastAccessTime) < 0 ||
+            !ZWriteStoreText(FileHandle, &Text)) {
+
+            Result = FALSE;
+            break;
+        }
     }
+    YoriLibFreeStringContents(&Text);
+    CloseHandle(FileHandle);
+
+    if (Result) {
+        Result = MoveFileEx(TempPath.StartOfString, ZRecentDirectories.StorePath.StartOfString, MOVEFILE_REPLACE_EXISTING);
+    }
+
+    if (!Result) {
+        DeleteFile(TempPath.StartOfString);
+    }
+
+    YoriLibFreeStringContents(&TempPath);
+    return Result;
+}
+
+/**
+ Called when the module is unloaded to clean up state.
+ */
+VOID
+YORI_BUILTIN_FN
+ZNotifyUnload(VOID)
+{
+    ZResetRecent();
+    if (ZRecentDirectories.DirHash != NULL) {
+        YoriLibFreeEmptyHashTable(ZRecentDirectories.DirHash);
+        ZRecentDirectories.DirHash = NULL;
+    }
+    YoriLibFreeStringContents(&ZRecentDirectories.StorePath);
 }
 
 /**
@@ -382,9 +1153,11 @@ ZBuildScoreboardAndSelectBest(
     )
 {
     PZ_SCOREBOARD_ENTRY Entries;
+    PYORI_HASH_TABLE EntryHash;
+    PYORI_HASH_ENTRY HashEntry;
+    PZ_SCOREBOARD_ENTRY Existing;
     PYORI_LIST_ENTRY ListEntry;
     PZ_RECENT_DIRECTORY FoundRecentDir;
-    YORI_STRING FinalComponent;
     YORI_STRING TrailingPortion;
     YORI_STRING StringToAdd;
     YORI_ALLOC_SIZE_T EntriesPopulated;
@@ -393,6 +1166,7 @@ ZBuildScoreboardAndSelectBest(
     DWORD BestScore;
     YORI_ALLOC_SIZE_T BestIndex;
     YORI_ALLOC_SIZE_T OffsetOfMatch;
+    LONGLONG CurrentTime;
     BOOLEAN SeperatorBefore;
     BOOLEAN SeperatorAfter;
     BOOLEAN AddThisEntry;
@@ -403,11 +1177,22 @@ ZBuildScoreboardAndSelectBest(
     //  history and the currently resolved full path
     //
 
-    Entries = YoriLibMalloc(sizeof(Z_SCOREBOARD_ENTRY) * (Z_MAX_RECENT_DIRS + 1));
+    Entries = YoriLibMalloc(sizeof(Z_SCOREBOARD_ENTRY) * (ZRecentDirectories.RecentDirCount + 1));
     if (Entries == NULL) {
         return FALSE;
     }
 
+    //
+    //  Many entries can match as the same parent directory, so keep a hash
+    //  of entries added to find an existing entry without searching.
+    //
+
+    EntryHash = YoriLibAllocateHashTable(256);
+    if (EntryHash == NULL) {
+        YoriLibFree(Entries);
+        return FALSE;
+    }
+
     EntriesPopulated = 0;
 
     //
@@ -419,11 +1204,12 @@ ZBuildScoreboardAndSelectBest(
 
     if (FullMatchToUserSpec->LengthInChars > 0) {
         memcpy(&Entries[EntriesPopulated].DirectoryName, FullMatchToUserSpec, sizeof(YORI_STRING));
-        Entries[EntriesPopulated].Score = Z_MAX_RECENT_DIRS * 16;
+        Entries[EntriesPopulated].Score = Z_SCORE_SCALE * 16;
+        YoriLibHashInsertByKey(EntryHash, &Entries[EntriesPopulated].DirectoryName, &Entries[EntriesPopulated], &Entries[EntriesPopulated].HashEntry);
         EntriesPopulated++;
     }
 
-    Index = Z_MAX_RECENT_DIRS;
+    CurrentTime = ZGetCurrentTime();
     ListEntry = YoriLibGetNextListEntry(&ZRecentDirectories.RecentDirList, NULL);
     while (ListEntry != NULL) {
         FoundRecentDir = CONTAINING_RECORD(ListEntry, Z_RECENT_DIRECTORY, ListEntry);
@@ -432,19 +1218,17 @@ ZBuildScoreboardAndSelectBest(
         FoundAsParentOnly = FALSE;
 
         //
-        //  Calculate a rough score for this entry.
+        //  Calculate a rough score for this entry based on how frequently
+        //  and recently it has been used.
         //
 
-        ScoreForThisEntry = Index * (Z_MAX_RECENT_DIRS / 8);
-        ScoreForThisEntry += FoundRecentDir->HitCount * (Z_MAX_RECENT_DIRS / 8);
+        ScoreForThisEntry = ZFrecencyScore(FoundRecentDir, CurrentTime);
 
         //
         //  Determine if it's a match and we should add it.
         //
 
-        YoriLibInitEmptyString(&FinalComponent);
         YoriLibInitEmptyString(&TrailingPortion);
-        FinalComponent.StartOfString = YoriLibFindRightMostCharacter(&FoundRecentDir->DirectoryName, '\\');
 
         if (FoundRecentDir->DirectoryName.LengthInChars >= UserSpecification->LengthInChars) {
             TrailingPortion.StartOfString = &FoundRecentDir->DirectoryName.StartOfString[FoundRecentDir->DirectoryName.LengthInChars - UserSpecification->LengthInChars];
@@ -458,20 +1242,18 @@ ZBuildScoreboardAndSelectBest(
         //  If it's somewhere in the final component, small bonus points.
         //
 
-        if (FinalComponent.StartOfString != NULL) {
-            FinalComponent.StartOfString++;
-            FinalComponent.LengthInChars = FoundRecentDir->DirectoryName.LengthInChars - (YORI_ALLOC_SIZE_T)(FinalComponent.StartOfString - FoundRecentDir->DirectoryName.StartOfString);
+        if (FoundRecentDir->FinalComponent.StartOfString != NULL) {
 
-            if (YoriLibCompareStringIns(&FinalComponent, UserSpecification) == 0) {
-                ScoreForThisEntry += Z_MAX_RECENT_DIRS * 4;
+            if (YoriLibCompareStringIns(&FoundRecentDir->FinalComponent, UserSpecification) == 0) {
+                ScoreForThisEntry += Z_SCORE_SCALE * 4;
                 AddThisEntry = TRUE;
             } else if (TrailingPortion.LengthInChars > 0 &&
                        YoriLibCompareStringIns(&TrailingPortion, UserSpecification) == 0) {
-                ScoreForThisEntry += Z_MAX_RECENT_DIRS * 2;
+                ScoreForThisEntry += Z_SCORE_SCALE * 2;
                 AddThisEntry = TRUE;
-            } else if (YoriLibFindFirstMatchSubstrIns(&FinalComponent, 1, UserSpecification, NULL) != NULL) {
+            } else if (YoriLibFindFirstMatchSubstrIns(&FoundRecentDir->FinalComponent, 1, UserSpecification, NULL) != NULL) {
 
-                ScoreForThisEntry += Z_MAX_RECENT_DIRS;
+                ScoreForThisEntry += Z_SCORE_SCALE;
                 AddThisEntry = TRUE;
             }
         }
@@ -529,15 +1311,13 @@ ZBuildScoreboardAndSelectBest(
         //
 
         if (AddThisEntry) {
-            for (BestIndex = 0; BestIndex < EntriesPopulated; BestIndex++) {
-                if (YoriLibCompareStringIns(&Entries[BestIndex].DirectoryName, &StringToAdd) == 0) {
-
-                    if (!FoundAsParentOnly) {
-                        Entries[BestIndex].Score += ScoreForThisEntry;
-                    }
-                    AddThisEntry = FALSE;
-                    break;
+            HashEntry = YoriLibHashLookupByKey(EntryHash, &StringToAdd);
+            if (HashEntry != NULL) {
+                Existing = HashEntry->Context;
+                if (!FoundAsParentOnly) {
+                    Existing->Score += ScoreForThisEntry;
                 }
+                AddThisEntry = FALSE;
             }
         }
 
@@ -548,13 +1328,16 @@ ZBuildScoreboardAndSelectBest(
         if (AddThisEntry) {
             memcpy(&Entries[EntriesPopulated].DirectoryName, &StringToAdd, sizeof(YORI_STRING));
             Entries[EntriesPopulated].Score = ScoreForThisEntry;
+            YoriLibHashInsertByKey(EntryHash, &Entries[EntriesPopulated].DirectoryName, &Entries[EntriesPopulated], &Entries[EntriesPopulated].HashEntry);
             EntriesPopulated++;
         }
-        if (Index > 0) {
-            Index--;
-        }
     }
 
+    for (Index = 0; Index < EntriesPopulated; Index++) {
+        YoriLibHashRemoveByEntry(&Entries[Index].HashEntry);
+    }
+    YoriLibFreeEmptyHashTable(EntryHash);
+
     //
     //  If we have no matches, then we can't find anything that the user
     //  would be happy with, so do nothing.
@@ -585,6 +1368,7 @@ ZBuildScoreboardAndSelectBest(
     //
 
     if (!YoriLibAllocateString(BestMatch, Entries[BestIndex].DirectoryName.LengthInChars + 1)) {
+        YoriLibFree(Entries);
         return FALSE;
     }
     memcpy(BestMatch->StartOfString, Entries[BestIndex].DirectoryName.StartOfString, Entries[BestIndex].DirectoryName.LengthInChars * sizeof(TCHAR));
@@ -620,9 +1404,13 @@ YoriCmd_Z(
     BOOLEAN ArgumentUnderstood;
     BOOLEAN Unload = FALSE;
     BOOLEAN ListStack = FALSE;
+    BOOLEAN ListCompletions = FALSE;
+    PYORI_STRING CompletionPrefix = NULL;
     YORI_ALLOC_SIZE_T i;
     YORI_ALLOC_SIZE_T StartArg = 0;
     YORI_STRING Arg;
+    YORI_STRING NewRecentDirs[2];
+    LONGLONG CurrentTime;
 
     YoriLibLoadNtDllFunctions();
     YoriLibLoadKernel32Functions();
@@ -640,6 +1428,13 @@ YoriCmd_Z(
             } else if (YoriLibCompareStringLitIns(&Arg, _T("license")) == 0) {
                 YoriLibDisplayMitLicense(_T("2017-2018"));
                 return EXIT_SUCCESS;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("c")) == 0) {
+                ListCompletions = TRUE;
+                ArgumentUnderstood = TRUE;
+                if (ArgC > i + 1) {
+                    CompletionPrefix = &ArgV[i + 1];
+                    i++;
+                }
             } else if (YoriLibCompareStringLitIns(&Arg, _T("l")) == 0) {
                 ListStack = TRUE;
                 ArgumentUnderstood = TRUE;
@@ -658,11 +1453,6 @@ YoriCmd_Z(
         }
     }
 
-    if (ListStack) {
-        ZListStack();
-        return EXIT_SUCCESS;
-    }
-
     if (Unload) {
         if (ZCallbacksRegistered) {
             YORI_STRING ZCmd;
@@ -673,6 +1463,25 @@ YoriCmd_Z(
         return EXIT_SUCCESS;
     }
 
+    //
+    //  If directories are shared between processes, load any that were
+    //  added since the previous invocation.
+    //
+
+    if (ZUpdateStorePath()) {
+        ZLoadStore();
+    }
+
+    if (ListStack) {
+        ZListStack();
+        return EXIT_SUCCESS;
+    }
+
+    if (ListCompletions) {
+        ZListCompletions(CompletionPrefix);
+        return EXIT_SUCCESS;
+    }
+
     if (StartArg == 0) {
         YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("z: missing argument\n"));
         return EXIT_FAILURE;
@@ -716,8 +1525,24 @@ YoriCmd_Z(
 
     YoriLibFreeStringContents(&FullyResolvedUserSpecification);
 
-    ZAddDirectoryToRecent(&OldCurrentDirectory);
-    ZAddDirectoryToRecent(&BestMatch);
+    //
+    //  Record both directories.  If there is a store, they are loaded back
+    //  from it along with any directories added by other processes.  If
+    //  the store can't be written, remember them in this process only.
+    //
+
+    memcpy(&NewRecentDirs[0], &OldCurrentDirectory, sizeof(YORI_STRING));
+    memcpy(&NewRecentDirs[1], &BestMatch, sizeof(YORI_STRING));
+    if (ZRecentDirectories.StorePath.LengthInChars > 0 &&
+        ZAppendToStore(NewRecentDirs, sizeof(NewRecentDirs)/sizeof(NewRecentDirs[0]))) {
+
+        ZLoadStore();
+        ZCompactStore();
+    } else {
+        CurrentTime = ZGetCurrentTime();
+        ZAddDirectoryToRecent(&OldCurrentDirectory, 1, CurrentTime);
+        ZAddDirectoryToRecent(&BestMatch, 1, CurrentTime);
+    }
 
     Result = YoriCallSetCurrentDirectory(&BestMatch);
     if (!Result) {
@@ -3,7 +3,7 @@
  *
  * Yori shell compress and uncompress archives
  *
- * Copyright (c) 2018-2019 Malcolm J. Smith
+ * Copyright (c) 2018-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -38,12 +38,18 @@ CHAR strCabHelpText[] =
         "CAB [-license] [-b] [-s] -c <cabfile> <files...>\n"
         "CAB [-license] [-b] [-s] -u <cabfiles...>\n"
         "CAB [-license] [-b] [-s] -f <files...>\n"
+        "CAB [-license] [-b] [-s] -l <cabfiles...>\n"
+        "CAB [-license] -p <cabfile> <file>\n"
+        "CAB [-license] -x <cabfile> <files...>\n"
         "\n"
         "   -b             Use basic search criteria for files only\n"
         "   -c             Compress files into an archive\n"
         "   -f             Compress each file into its own archive\n"
+        "   -l             List the files within archives\n"
+        "   -p             Write a single file from an archive to standard output\n"
         "   -s             Copy subdirectories as well as files\n"
-        "   -u             Uncompress files from an archive\n";
+        "   -u             Uncompress files from an archive\n"
+        "   -x             Uncompress specific files from an archive\n";
 
 /**
  Display usage text to the user.
@@ -121,6 +127,12 @@ typedef struct _CAB_EXPAND_CONTEXT {
      */
     YORI_STRING FullTargetDirectory;
 
+    /**
+     When listing archives, TRUE if the name of each archive should be
+     displayed before its contents.
+     */
+    BOOL DisplayCabName;
+
 } CAB_EXPAND_CONTEXT, *PCAB_EXPAND_CONTEXT;
 
 /**
@@ -451,6 +463,70 @@ CabCreateFileEnumerateErrorCallback(
     return Result;
 }
 
+/**
+ A callback that is invoked when a cab file is found and its contents should
+ be listed.  The list is read from the file entries within the cab, so no
+ data is decompressed.
+
+ @param FilePath Pointer to the file path of the CAB file that was found.
+
+ @param FileInfo Information about the file.
+
+ @param Depth Indicates the recursion depth.  Ignored in this application.
+
+ @param Context Pointer to a context block indicating whether to display
+        the name of the archive.
+
+ @return TRUE to continute enumerating, FALSE to abort.
+ */
+BOOL
+CabListFileFoundCallback(
+    __in PYORI_STRING FilePath,
+    __in PWIN32_FIND_DATA FileInfo,
+    __in DWORD Depth,
+    __in PVOID Context
+    )
+{
+    PCAB_EXPAND_CONTEXT ExpandContext = (PCAB_EXPAND_CONTEXT)Context;
+    YORI_LIB_CAB_INDEX Index;
+    PYORI_LIB_CAB_INDEX_ENTRY Entry;
+    LPTSTR ErrText;
+    DWORD ErrorCode;
+    DWORD Count;
+
+    UNREFERENCED_PARAMETER(FileInfo);
+    UNREFERENCED_PARAMETER(Depth);
+
+    ErrorCode = YoriLibCabReadIndex(FilePath, &Index);
+    if (ErrorCode != ERROR_SUCCESS) {
+        ErrText = YoriLibGetWinErrorText(ErrorCode);
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("cab: could not read %y: %s"), FilePath, ErrText);
+        YoriLibFreeWinErrorText(ErrText);
+        return TRUE;
+    }
+
+    if (ExpandContext->DisplayCabName) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y:\n"), FilePath);
+    }
+
+    for (Count = 0; Count < Index.FileCount; Count++) {
+        Entry = &Index.Files[Count];
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT,
+                      _T("%04i/%02i/%02i %02i:%02i:%02i %12u %y\n"),
+                      ((Entry->DosDate >> 9) & 0x7F) + 1980,
+                      (Entry->DosDate >> 5) & 0xF,
+                      Entry->DosDate & 0x1F,
+                      Entry->DosTime >> 11,
+                      (Entry->DosTime >> 5) & 0x3F,
+                      (Entry->DosTime & 0x1F) * 2,
+                      Entry->FileSize,
+                      &Entry->FileName);
+    }
+
+    YoriLibCabFreeIndex(&Index);
+    return TRUE;
+}
+
 /**
  A callback that is invoked when a directory cannot be successfully enumerated.
 
@@ -544,6 +620,9 @@ ENTRYPOINT(
     BOOLEAN Compress = FALSE;
     BOOLEAN CompressEachFile = FALSE;
     BOOLEAN Uncompress = FALSE;
+    BOOLEAN List = FALSE;
+    BOOLEAN UncompressSelected = FALSE;
+    BOOLEAN UncompressToOutput = FALSE;
     BOOLEAN Recursive = FALSE;
     BOOLEAN BasicEnumeration = FALSE;
     YORI_ALLOC_SIZE_T i;
@@ -563,7 +642,7 @@ ENTRYPOINT(
                 CabHelp();
                 return EXIT_SUCCESS;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("license")) == 0) {
-                YoriLibDisplayMitLicense(_T("2018-2019"));
+                YoriLibDisplayMitLicense(_T("2018-2026"));
                 return EXIT_SUCCESS;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("b")) == 0) {
                 BasicEnumeration = TRUE;
@@ -572,11 +651,33 @@ ENTRYPOINT(
                 Compress = TRUE;
                 CompressEachFile = FALSE;
                 Uncompress = FALSE;
+                List = FALSE;
+                UncompressSelected = FALSE;
+                UncompressToOutput = FALSE;
                 ArgumentUnderstood = TRUE;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("f")) == 0) {
                 Compress = FALSE;
                 CompressEachFile = TRUE;
                 Uncompress = FALSE;
+                List = FALSE;
+                UncompressSelected = FALSE;
+                UncompressToOutput = FALSE;
+                ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("l")) == 0) {
+                Compress = FALSE;
+                CompressEachFile = FALSE;
+                Uncompress = FALSE;
+                List = TRUE;
+                UncompressSelected = FALSE;
+                UncompressToOutput = FALSE;
+                ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("p")) == 0) {
+                Compress = FALSE;
+                CompressEachFile = FALSE;
+                Uncompress = FALSE;
+                List = FALSE;
+                UncompressSelected = FALSE;
+                UncompressToOutput = TRUE;
                 ArgumentUnderstood = TRUE;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("s")) == 0) {
                 Recursive = TRUE;
@@ -585,6 +686,17 @@ ENTRYPOINT(
                 Compress = FALSE;
                 CompressEachFile = FALSE;
                 Uncompress = TRUE;
+                List = FALSE;
+                UncompressSelected = FALSE;
+                UncompressToOutput = FALSE;
+                ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("x")) == 0) {
+                Compress = FALSE;
+                CompressEachFile = FALSE;
+                Uncompress = FALSE;
+                List = FALSE;
+                UncompressSelected = TRUE;
+                UncompressToOutput = FALSE;
                 ArgumentUnderstood = TRUE;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("-")) == 0) {
                 ArgumentUnderstood = TRUE;
@@ -610,7 +722,12 @@ ENTRYPOINT(
         return EXIT_FAILURE;
     }
 
-    if (!Compress && !Uncompress && !CompressEachFile) {
+    if (!Compress &&
+        !Uncompress &&
+        !CompressEachFile &&
+        !List &&
+        !UncompressSelected &&
+        !UncompressToOutput) {
         YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("cab: missing operation\n"));
         return EXIT_FAILURE;
     }
@@ -694,6 +811,78 @@ ENTRYPOINT(
         }
         YoriLibCloseCab(CreateContext.CabHandle);
         CabCreateFreeMatchLists(&CreateContext);
+    } else if (List) {
+        CAB_EXPAND_CONTEXT ExpandContext;
+
+        if (StartArg >= ArgC) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("cab: missing cab files\n"));
+            return EXIT_FAILURE;
+        }
+
+        ZeroMemory(&ExpandContext, sizeof(ExpandContext));
+
+        MatchFlags = YORILIB_FILEENUM_RETURN_FILES;
+        if (BasicEnumeration) {
+            MatchFlags |= YORILIB_FILEENUM_BASIC_EXPANSION;
+        }
+        if (Recursive) {
+            ExpandContext.Recursive = TRUE;
+            MatchFlags |= YORILIB_FILEENUM_RECURSE_AFTER_RETURN;
+        }
+        if (Recursive || StartArg + 1 < ArgC) {
+            ExpandContext.DisplayCabName = TRUE;
+        }
+
+        for (i = StartArg; i < ArgC; i++) {
+            YoriLibForEachFile(&ArgV[i],
+                               MatchFlags,
+                               0,
+                               CabListFileFoundCallback,
+                               CabExpandFileEnumerateErrorCallback,
+                               &ExpandContext);
+        }
+    } else if (UncompressToOutput) {
+        YORI_STRING ErrorString;
+        DWORD ErrorCode;
+
+        if (StartArg + 1 >= ArgC) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("cab: missing file to extract\n"));
+            return EXIT_FAILURE;
+        }
+
+        YoriLibInitEmptyString(&ErrorString);
+        ErrorCode = ERROR_SUCCESS;
+        if (!YoriLibExtractCabFileToHandle(&ArgV[StartArg], &ArgV[StartArg + 1], GetStdHandle(STD_OUTPUT_HANDLE), &ErrorCode, &ErrorString)) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("cab: could not extract %y from %y: %y\n"), &ArgV[StartArg + 1], &ArgV[StartArg], &ErrorString);
+            YoriLibFreeStringContents(&ErrorString);
+            return EXIT_FAILURE;
+        }
+    } else if (UncompressSelected) {
+        YORI_STRING TargetDirectory;
+        YORI_STRING FullTargetDirectory;
+        YORI_STRING ErrorString;
+        DWORD ErrorCode;
+
+        if (StartArg + 1 >= ArgC) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("cab: missing files to extract\n"));
+            return EXIT_FAILURE;
+        }
+
+        YoriLibConstantString(&TargetDirectory, _T("."));
+        YoriLibInitEmptyString(&FullTargetDirectory);
+        if (!YoriLibUserStringToSingleFilePath(&TargetDirectory, FALSE, &FullTargetDirectory)) {
+            return EXIT_FAILURE;
+        }
+
+        YoriLibInitEmptyString(&ErrorString);
+        ErrorCode = ERROR_SUCCESS;
+        if (!YoriLibExtractCab(&ArgV[StartArg], &FullTargetDirectory, FALSE, 0, NULL, ArgC - StartArg - 1, &ArgV[StartArg + 1], NULL, NULL, NULL, &ErrorCode, &ErrorString)) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("YoriLibExtractCab failed on %y: %y\n"), &ArgV[StartArg], &ErrorString);
+            YoriLibFreeStringContents(&ErrorString);
+            YoriLibFreeStringContents(&FullTargetDirectory);
+            return EXIT_FAILURE;
+        }
+        YoriLibFreeStringContents(&FullTargetDirectory);
     } else {
         YORI_STRING TargetDirectory;
         CAB_EXPAND_CONTEXT ExpandContext;
@@ -38,7 +38,16 @@ CHAR strHelpText[] =
         "\n"
         "CLMP [-license] [-MP[n]] <arguments to CL>\n"
         "\n"
-        "   -MP[n]         Use up to 'n' processes for compilation\n";
+        "   -MP[n]         Use up to 'n' processes for compilation\n"
+        "\n"
+        "If launched by a process sharing a job server, such as ymake, processes\n"
+        "beyond the first are only launched when the job server has capacity.\n"
+        "\n"
+        "If YORICLMPCACHE names a directory, objects are cached there, keyed on the\n"
+        "preprocessed source, options and compiler, and copied from the cache instead\n"
+        "of compiling.  YORICLMPCACHESHARED can name a second directory, such as a\n"
+        "network share, which is checked after the local cache and populated on a\n"
+        "miss.\n";
 
 /**
  Display the help and license information for this application.
@@ -67,168 +76,1475 @@ DWORD GlobalExitCode = 0;
  */
 HANDLE hOutputMutex;
 
+/**
+ A mutex held while creating inheritable pipes and launching child
+ processes, so that a child launched from one thread cannot inherit pipe
+ handles intended for a child launched from another thread.
+ */
+HANDLE hLaunchMutex;
+
+/**
+ The number of threads servicing the completion port.  These only copy
+ output and issue the next read, so a small number is sufficient.
+ */
+#define CLMP_COMPLETION_THREAD_COUNT (2)
+
+/**
+ The minimum number of bytes to read from a child's output pipe at a time.
+ */
+#define CLMP_PIPE_READ_SIZE (4096)
+
+/**
+ An I/O completion port which receives the completion of reads from the
+ output pipes of every child process, or NULL if each pipe is read by its
+ own pump thread.
+ */
+HANDLE hCompletionPort;
+
+/**
+ The threads servicing hCompletionPort.
+ */
+HANDLE hCompletionThreads[CLMP_COMPLETION_THREAD_COUNT];
+
+/**
+ A counter used to generate a unique name for each output pipe.
+ */
+LONG GlobalPipeCount;
+
+/**
+ The number of bytes in an MD5 digest, which identifies a cached object.
+ */
+#define CLMP_DIGEST_SIZE (16)
+
+/**
+ The number of bytes to read from the preprocessor at a time.
+ */
+#define CLMP_PREPROCESS_BUFFER_SIZE (64 * 1024)
+
+/**
+ Information about the cache of compiled objects.
+ */
+typedef struct _CLMP_CACHE {
+
+    /**
+     The directory containing cached objects on this machine.
+     */
+    YORI_STRING LocalDirectory;
+
+    /**
+     Optionally, a directory containing cached objects which is shared
+     between machines.  This is checked if an object is not found locally.
+     This is an empty string if no shared cache is in use.
+     */
+    YORI_STRING SharedDirectory;
+
+    /**
+     Points to the compiler command line common to all source files.
+     */
+    PYORI_STRING CommonString;
+
+    /**
+     The object file or directory specified with /Fo, or an empty string if
+     none was specified.  This points into the arguments and is not freed.
+     */
+    YORI_STRING ObjectOutputName;
+
+    /**
+     A string describing the compiler and its options, which is included in
+     the digest of every source file.
+     */
+    YORI_STRING KeyPrefix;
+
+    /**
+     The CryptoAPI provider used to calculate digests.
+     */
+    DWORD_PTR DigestProvider;
+
+    /**
+     Points to processor placement state used when launching the compiler.
+     This is only used while holding hLaunchMutex.
+     */
+    PYORI_LIB_PROCESSOR_PLACEMENT ProcessorPlacement;
+} CLMP_CACHE, *PCLMP_CACHE;
+
 /**
  Information about a pipe and a buffer attached to that pipe for reading
  data being output by a child process.
  */
 typedef struct _CLMP_PIPE_BUFFER {
 
-    /**
-     A handle to the pipe to read from the child process.
-     */
-    HANDLE Pipe;
+    /**
+     A handle to the pipe to read from the child process.
+     */
+    HANDLE Pipe;
+
+    /**
+     A handle to the thread processing this stream.
+     */
+    HANDLE hPumpThread;
+
+    /**
+     The flags to use when outputting anything from this stream.
+     */
+    WORD OutputFlags;
+
+    /**
+     The overlapped structure used to read from the pipe when a completion
+     port is in use.
+     */
+    OVERLAPPED Overlapped;
+
+    /**
+     When a completion port is in use, an event which is signalled once
+     the pipe has been read to completion.
+     */
+    HANDLE hDrained;
+
+    /**
+     When a completion port is in use, a buffer containing the output read
+     from the pipe so far.
+     */
+    PUCHAR Buffer;
+
+    /**
+     The number of bytes allocated in Buffer.
+     */
+    DWORD BufferSize;
+
+    /**
+     The number of bytes of output contained in Buffer.
+     */
+    DWORD BytesFilled;
+} CLMP_PIPE_BUFFER, *PCLMP_PIPE_BUFFER;
+
+/**
+ Information about a single outstanding child process.
+ */
+typedef struct _CLMP_PROCESS_INFO {
+
+    /**
+     Information as returned by Windows when launching the child process.
+     */
+    PROCESS_INFORMATION WindowsProcessInfo;
+
+    /**
+     Standard output and standard error pipe buffers to the child process.
+     */
+    CLMP_PIPE_BUFFER Pipes[2];
+
+    /**
+     A NULL terminated string corresponding to the file being processed
+     by this child process.
+     */
+    LPTSTR Filename;
+
+    /**
+     If TRUE, process launch was started.  If FALSE, the process has been
+     waited upon and no new process launch commenced.
+     */
+    BOOLEAN ProcessLaunchStarted;
+
+    /**
+     The command line to execute for this child process.
+     */
+    YORI_STRING CommandLine;
+
+    /**
+     Points to the source file being compiled by this child process.
+     */
+    PYORI_STRING SourceFile;
+
+    /**
+     Points to the cache of compiled objects, or NULL if the cache is not
+     in use.
+     */
+    PCLMP_CACHE Cache;
+
+    /**
+     If the cache is in use, a handle to the thread which checks the cache
+     and launches the compiler if the object is not found.  When present,
+     this is waited upon instead of the child process.
+     */
+    HANDLE hCacheThread;
+} CLMP_PROCESS_INFO, *PCLMP_PROCESS_INFO;
+
+/**
+ A worker thread function that fetches entire lines from an input stream,
+ and writes them to the current process output stream, with synchronization
+ to ensure that each line is written as a line.
+
+ @param Param Pointer to a CLMP_PIPE_BUFFER structure indicating a single
+        input stream to process.
+
+ @return Exit code for the thread.
+ */
+DWORD WINAPI
+ClmpPumpSingleStream(
+    __in LPVOID Param
+    )
+{
+    PCLMP_PIPE_BUFFER Buffer = (PCLMP_PIPE_BUFFER)Param;
+    PVOID LineContext = NULL;
+    YORI_STRING LineString;
+
+    YoriLibInitEmptyString(&LineString);
+
+    while (TRUE) {
+        if (!YoriLibReadLineToString(&LineString, &LineContext, Buffer->Pipe)) {
+            break;
+        }
+
+        //
+        //  Synchronize with other things writing to output
+        //
+
+        WaitForSingleObject(hOutputMutex, INFINITE);
+        YoriLibOutput(Buffer->OutputFlags, _T("%y\n"), &LineString);
+        ReleaseMutex(hOutputMutex);
+    }
+
+    YoriLibLineReadClose(LineContext);
+    YoriLibFreeStringContents(&LineString);
+
+    return 0;
+}
+
+/**
+ Issue a read from a child's output pipe into the remainder of its buffer,
+ growing the buffer as needed.  Completion is reported to the completion
+ port.
+
+ @param Buffer Pointer to the pipe buffer to read into.
+
+ @return TRUE to indicate a read was issued, FALSE if no further reads can
+         be issued, typically because the child has closed the pipe.
+ */
+BOOLEAN
+ClmpIssuePipeRead(
+    __inout PCLMP_PIPE_BUFFER Buffer
+    )
+{
+    PUCHAR NewBuffer;
+    DWORD NewBufferSize;
+
+    if (Buffer->BufferSize - Buffer->BytesFilled < CLMP_PIPE_READ_SIZE) {
+        NewBufferSize = Buffer->BufferSize * 2;
+        if (NewBufferSize < CLMP_PIPE_READ_SIZE * 4) {
+            NewBufferSize = CLMP_PIPE_READ_SIZE * 4;
+        }
+
+        NewBuffer = NULL;
+        if (YoriLibIsSizeAllocatable(NewBufferSize)) {
+            NewBuffer = YoriLibMalloc((YORI_ALLOC_SIZE_T)NewBufferSize);
+        }
+
+        if (NewBuffer != NULL) {
+            if (Buffer->Buffer != NULL) {
+                memcpy(NewBuffer, Buffer->Buffer, Buffer->BytesFilled);
+                YoriLibFree(Buffer->Buffer);
+            }
+            Buffer->Buffer = NewBuffer;
+            Buffer->BufferSize = NewBufferSize;
+        } else if (Buffer->Buffer != NULL) {
+
+            //
+            //  If the buffer can't grow, discard the output collected so
+            //  far rather than stop reading and leave the child blocked.
+            //
+
+            Buffer->BytesFilled = 0;
+        } else {
+            return FALSE;
+        }
+    }
+
+    ZeroMemory(&Buffer->Overlapped, sizeof(Buffer->Overlapped));
+    if (!ReadFile(Buffer->Pipe, Buffer->Buffer + Buffer->BytesFilled, Buffer->BufferSize - Buffer->BytesFilled, NULL, &Buffer->Overlapped) &&
+        GetLastError() != ERROR_IO_PENDING) {
+
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ A worker thread function that services the completion port, collecting
+ the output of child processes as reads complete and issuing the next read.
+
+ @param Param Unused.
+
+ @return Exit code for the thread.
+ */
+DWORD WINAPI
+ClmpServiceCompletionPort(
+    __in LPVOID Param
+    )
+{
+    PCLMP_PIPE_BUFFER Buffer;
+    LPOVERLAPPED Overlapped;
+    ULONG_PTR CompletionKey;
+    DWORD BytesTransferred;
+    BOOL Success;
+
+    UNREFERENCED_PARAMETER(Param);
+
+    while (TRUE) {
+        Overlapped = NULL;
+        Success = GetQueuedCompletionStatus(hCompletionPort, &BytesTransferred, &CompletionKey, &Overlapped, INFINITE);
+
+        //
+        //  A completion without an overlapped structure indicates the port
+        //  is being shut down.
+        //
+
+        if (Overlapped == NULL) {
+            break;
+        }
+
+        Buffer = CONTAINING_RECORD(Overlapped, CLMP_PIPE_BUFFER, Overlapped);
+        if (Success) {
+            Buffer->BytesFilled += BytesTransferred;
+            if (ClmpIssuePipeRead(Buffer)) {
+                continue;
+            }
+        }
+
+        //
+        //  The child has closed its end of the pipe, or no further reads
+        //  can be issued.  Close the pipe so a child that is still writing
+        //  fails rather than waiting for a reader.
+        //
+
+        CloseHandle(Buffer->Pipe);
+        Buffer->Pipe = NULL;
+        SetEvent(Buffer->hDrained);
+    }
+
+    return 0;
+}
+
+/**
+ Stop the threads servicing the completion port and close it.
+ */
+VOID
+ClmpStopCompletionPort(VOID)
+{
+    DWORD Index;
+
+    if (hCompletionPort == NULL) {
+        return;
+    }
+
+    for (Index = 0; Index < CLMP_COMPLETION_THREAD_COUNT; Index++) {
+        if (hCompletionThreads[Index] != NULL) {
+            PostQueuedCompletionStatus(hCompletionPort, 0, 0, NULL);
+        }
+    }
+
+    for (Index = 0; Index < CLMP_COMPLETION_THREAD_COUNT; Index++) {
+        if (hCompletionThreads[Index] != NULL) {
+            WaitForSingleObject(hCompletionThreads[Index], INFINITE);
+            CloseHandle(hCompletionThreads[Index]);
+            hCompletionThreads[Index] = NULL;
+        }
+    }
+
+    CloseHandle(hCompletionPort);
+    hCompletionPort = NULL;
+}
+
+/**
+ Create a completion port and the threads to service it, so that output
+ from all child processes can be collected without a thread per pipe.  If
+ this fails, each pipe is read by its own pump thread.
+
+ @return TRUE to indicate the completion port is in use, FALSE if it is
+         not.
+ */
+BOOLEAN
+ClmpStartCompletionPort(VOID)
+{
+    DWORD Index;
+    DWORD ThreadId;
+
+    hCompletionPort = CreateIoCompletionPort(INVALID_HANDLE_VALUE, NULL, 0, CLMP_COMPLETION_THREAD_COUNT);
+    if (hCompletionPort == NULL) {
+        return FALSE;
+    }
+
+    for (Index = 0; Index < CLMP_COMPLETION_THREAD_COUNT; Index++) {
+        hCompletionThreads[Index] = CreateThread(NULL, 0, ClmpServiceCompletionPort, NULL, 0, &ThreadId);
+        if (hCompletionThreads[Index] == NULL) {
+            ClmpStopCompletionPort();
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+/**
+ Create a pipe for a child process to write output to, where this process
+ reads the output via the completion port.  Anonymous pipes don't support
+ overlapped reads, so this uses a uniquely named pipe.
+
+ @param Buffer Pointer to the pipe buffer to populate with the read end of
+        the pipe.  On success, the first read has been issued.
+
+ @param SecurityAttributes Pointer to the security attributes to use for
+        the write end of the pipe, which indicate that it is inheritable.
+
+ @param WritePipe On successful completion, populated with the write end of
+        the pipe for the child process.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+ClmpCreateOverlappedPipe(
+    __inout PCLMP_PIPE_BUFFER Buffer,
+    __in PSECURITY_ATTRIBUTES SecurityAttributes,
+    __out PHANDLE WritePipe
+    )
+{
+    YORI_STRING PipeName;
+    HANDLE ReadPipe;
+    HANDLE WriteHandle;
+
+    YoriLibInitEmptyString(&PipeName);
+    if (YoriLibYPrintf(&PipeName, _T("\\\\.\\pipe\\clmp.%x.%x"), GetCurrentProcessId(), InterlockedIncrement(&GlobalPipeCount)) < 0) {
+        return FALSE;
+    }
+
+    ReadPipe = CreateNamedPipe(PipeName.StartOfString,
+                               PIPE_ACCESS_INBOUND | FILE_FLAG_OVERLAPPED,
+                               PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT,
+                               1,
+                               CLMP_PIPE_READ_SIZE,
+                               CLMP_PIPE_READ_SIZE,
+                               0,
+                               NULL);
+
+    if (ReadPipe == INVALID_HANDLE_VALUE) {
+        YoriLibFreeStringContents(&PipeName);
+        return FALSE;
+    }
+
+    WriteHandle = CreateFile(PipeName.StartOfString, GENERIC_WRITE, 0, SecurityAttributes, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    YoriLibFreeStringContents(&PipeName);
+    if (WriteHandle == INVALID_HANDLE_VALUE) {
+        CloseHandle(ReadPipe);
+        return FALSE;
+    }
+
+    Buffer->hDrained = CreateEvent(NULL, TRUE, FALSE, NULL);
+    if (Buffer->hDrained == NULL) {
+        CloseHandle(WriteHandle);
+        CloseHandle(ReadPipe);
+        return FALSE;
+    }
+
+    if (CreateIoCompletionPort(ReadPipe, hCompletionPort, 0, 0) == NULL) {
+        CloseHandle(Buffer->hDrained);
+        Buffer->hDrained = NULL;
+        CloseHandle(WriteHandle);
+        CloseHandle(ReadPipe);
+        return FALSE;
+    }
+
+    Buffer->Pipe = ReadPipe;
+    if (!ClmpIssuePipeRead(Buffer)) {
+        CloseHandle(Buffer->Pipe);
+        Buffer->Pipe = NULL;
+        SetEvent(Buffer->hDrained);
+    }
+
+    *WritePipe = WriteHandle;
+    return TRUE;
+}
+
+/**
+ Display the output collected from a pipe via the completion port, and free
+ the buffer that contained it.
+
+ @param Buffer Pointer to the pipe buffer.
+ */
+VOID
+ClmpOutputPipeBuffer(
+    __inout PCLMP_PIPE_BUFFER Buffer
+    )
+{
+    YORI_STRING Text;
+    YORI_ALLOC_SIZE_T Length;
+    YORI_ALLOC_SIZE_T Index;
+    YORI_ALLOC_SIZE_T DestIndex;
+
+    if (Buffer->Buffer == NULL) {
+        return;
+    }
+
+    if (Buffer->BytesFilled > 0) {
+        Length = YoriLibGetMultibyteInputSizeNeeded((LPCSTR)Buffer->Buffer, (YORI_ALLOC_SIZE_T)Buffer->BytesFilled);
+        if (YoriLibAllocateString(&Text, Length + 1)) {
+            Text.LengthInChars = YoriLibMultibyteInput((LPCSTR)Buffer->Buffer, (YORI_ALLOC_SIZE_T)Buffer->BytesFilled, Text.StartOfString, Length);
+
+            //
+            //  Remove carriage returns before line feeds and terminate the
+            //  final line, matching the output of the pump threads.
+            //
+
+            DestIndex = 0;
+            for (Index = 0; Index < Text.LengthInChars; Index++) {
+                if (Text.StartOfString[Index] == '\r' &&
+                    Index + 1 < Text.LengthInChars &&
+                    Text.StartOfString[Index + 1] == '\n') {
+
+                    continue;
+                }
+                Text.StartOfString[DestIndex] = Text.StartOfString[Index];
+                DestIndex++;
+            }
+
+            if (DestIndex > 0 && Text.StartOfString[DestIndex - 1] != '\n') {
+                Text.StartOfString[DestIndex] = '\n';
+                DestIndex++;
+            }
+            Text.LengthInChars = DestIndex;
+
+            YoriLibOutput(Buffer->OutputFlags, _T("%y"), &Text);
+            YoriLibFreeStringContents(&Text);
+        }
+    }
+
+    YoriLibFree(Buffer->Buffer);
+    Buffer->Buffer = NULL;
+    Buffer->BufferSize = 0;
+    Buffer->BytesFilled = 0;
+}
+
+/**
+ Launch a child process whose standard output and standard error are
+ forwarded to the output of this process by pump threads.  The caller is
+ expected to have marked the slot as having started launch, and to wait on
+ it with ClmpWaitOnProcess, which cleans up any partially launched state.
+
+ @param Process Pointer to the slot to launch the child process in.  The
+        command line is taken from this slot.
+
+ @param ProcessorPlacement Optionally points to processor placement state
+        used to select processors for the child process.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOLEAN
+ClmpLaunchProcess(
+    __inout PCLMP_PROCESS_INFO Process,
+    __inout_opt PYORI_LIB_PROCESSOR_PLACEMENT ProcessorPlacement
+    )
+{
+    STARTUPINFO StartupInfo;
+    SECURITY_ATTRIBUTES SecurityAttributes;
+    HANDLE WriteOutPipe;
+    HANDLE WriteErrPipe;
+    DWORD ThreadId;
+    BOOLEAN Result;
+
+    //
+    //  We need to specify security attributes because we want our
+    //  standard output and standard error handles to be inherited.
+    //
+
+    ZeroMemory(&SecurityAttributes, sizeof(SecurityAttributes));
+
+    SecurityAttributes.nLength = sizeof(SecurityAttributes);
+    SecurityAttributes.bInheritHandle = TRUE;
+
+    WriteOutPipe = NULL;
+    WriteErrPipe = NULL;
+    Result = FALSE;
+
+    //
+    //  Hold the launch mutex until the write handles are closed so no other
+    //  child can inherit them.
+    //
+
+    WaitForSingleObject(hLaunchMutex, INFINITE);
+
+    Process->Pipes[0].OutputFlags = YORI_LIB_OUTPUT_STDOUT;
+    Process->Pipes[1].OutputFlags = YORI_LIB_OUTPUT_STDERR;
+
+    //
+    //  Create the aforementioned handles.  If a completion port is in use,
+    //  its threads collect the output, which is displayed when the child
+    //  completes.  Otherwise each pipe is read by its own pump thread.
+    //
+
+    if (hCompletionPort != NULL) {
+        if (!ClmpCreateOverlappedPipe(&Process->Pipes[0], &SecurityAttributes, &WriteOutPipe)) {
+            WriteOutPipe = NULL;
+            goto Exit;
+        }
+
+        if (!ClmpCreateOverlappedPipe(&Process->Pipes[1], &SecurityAttributes, &WriteErrPipe)) {
+            WriteErrPipe = NULL;
+            goto Exit;
+        }
+    } else {
+        if (!CreatePipe(&Process->Pipes[0].Pipe, &WriteOutPipe, &SecurityAttributes, 0)) {
+            WriteOutPipe = NULL;
+            goto Exit;
+        }
+
+        if (!CreatePipe(&Process->Pipes[1].Pipe, &WriteErrPipe, &SecurityAttributes, 0)) {
+            WriteErrPipe = NULL;
+            goto Exit;
+        }
+
+        Process->Pipes[0].hPumpThread = CreateThread(NULL, 0, ClmpPumpSingleStream, &Process->Pipes[0], 0, &ThreadId);
+        if (Process->Pipes[0].hPumpThread == NULL) {
+            goto Exit;
+        }
+
+        Process->Pipes[1].hPumpThread = CreateThread(NULL, 0, ClmpPumpSingleStream, &Process->Pipes[1], 0, &ThreadId);
+        if (Process->Pipes[1].hPumpThread == NULL) {
+            goto Exit;
+        }
+    }
+
+    //
+    //  The child process should write to the write handles, but
+    //  this process doesn't want those, so we close them below.
+    //
+
+    ZeroMemory(&StartupInfo, sizeof(StartupInfo));
+    StartupInfo.cb = sizeof(StartupInfo);
+
+    StartupInfo.dwFlags = STARTF_USESTDHANDLES;
+    if (GetStdHandle(STD_OUTPUT_HANDLE) == GetStdHandle(STD_ERROR_HANDLE)) {
+        StartupInfo.hStdOutput = WriteOutPipe;
+        StartupInfo.hStdError = WriteOutPipe;
+    } else {
+        StartupInfo.hStdOutput = WriteOutPipe;
+        StartupInfo.hStdError = WriteErrPipe;
+    }
+
+    if (!CreateProcess(NULL, Process->CommandLine.StartOfString, NULL, NULL, TRUE, CREATE_SUSPENDED | CREATE_DEFAULT_ERROR_MODE, NULL, NULL, &StartupInfo, &Process->WindowsProcessInfo)) {
+        goto Exit;
+    }
+
+    if (ProcessorPlacement != NULL) {
+        YoriLibPlaceNextProcess(ProcessorPlacement, Process->WindowsProcessInfo.hThread);
+    }
+    ResumeThread(Process->WindowsProcessInfo.hThread);
+    Result = TRUE;
+
+Exit:
+
+    if (WriteOutPipe != NULL) {
+        CloseHandle(WriteOutPipe);
+    }
+
+    if (WriteErrPipe != NULL) {
+        CloseHandle(WriteErrPipe);
+    }
+
+    ReleaseMutex(hLaunchMutex);
+    return Result;
+}
+
+/**
+ Wait for a child process.  If it failed, we fail.  This function can be
+ called if a process failed to launch, or has already been waited upon,
+ so it must be willing to clean up whatever state exists.
+
+ @param Process The process to wait for.
+ */
+VOID
+ClmpWaitOnProcess (
+    __in PCLMP_PROCESS_INFO Process
+    )
+{
+    DWORD ExitCode;
+    DWORD PipeNum;
+    DWORD WaitResult;
+
+    ASSERT(Process->ProcessLaunchStarted);
+
+    if (Process->hCacheThread != NULL) {
+
+        //
+        //  The thread waits for any child process it launches, and returns
+        //  its exit code.
+        //
+
+        WaitResult = WaitForSingleObject(Process->hCacheThread, INFINITE);
+        ASSERT(WaitResult == WAIT_OBJECT_0);
+        if (!GetExitCodeThread(Process->hCacheThread, &ExitCode)) {
+            ExitCode = EXIT_FAILURE;
+        }
+        CloseHandle(Process->hCacheThread);
+        Process->hCacheThread = NULL;
+    } else if (Process->WindowsProcessInfo.hProcess != NULL) {
+        WaitResult = WaitForSingleObject(Process->WindowsProcessInfo.hProcess, INFINITE);
+        ASSERT(WaitResult == WAIT_OBJECT_0);
+        GetExitCodeProcess(Process->WindowsProcessInfo.hProcess, &ExitCode);
+    } else {
+
+        //
+        //  It's safe to use a failure as an exit code so long as the
+        //  process started to launch.
+        //
+
+        ExitCode = EXIT_FAILURE;
+    }
+
+    for (PipeNum = 0; PipeNum < sizeof(Process->Pipes)/sizeof(Process->Pipes[0]); PipeNum++) {
+        if (Process->Pipes[PipeNum].hPumpThread != NULL) {
+            WaitResult = WaitForSingleObject(Process->Pipes[PipeNum].hPumpThread, INFINITE);
+            ASSERT(WaitResult == WAIT_OBJECT_0);
+            CloseHandle(Process->Pipes[PipeNum].hPumpThread);
+            Process->Pipes[PipeNum].hPumpThread = NULL;
+        }
+
+        if (Process->Pipes[PipeNum].hDrained != NULL) {
+            WaitResult = WaitForSingleObject(Process->Pipes[PipeNum].hDrained, INFINITE);
+            ASSERT(WaitResult == WAIT_OBJECT_0);
+            CloseHandle(Process->Pipes[PipeNum].hDrained);
+            Process->Pipes[PipeNum].hDrained = NULL;
+        }
+
+        if (Process->Pipes[PipeNum].Pipe) {
+            CloseHandle(Process->Pipes[PipeNum].Pipe);
+            Process->Pipes[PipeNum].Pipe = NULL;
+        }
+    }
+
+    //
+    //  Output collected via the completion port is displayed once the
+    //  child has completed, so it isn't interleaved with output from other
+    //  children.
+    //
+
+    if (Process->Pipes[0].Buffer != NULL || Process->Pipes[1].Buffer != NULL) {
+        WaitForSingleObject(hOutputMutex, INFINITE);
+        for (PipeNum = 0; PipeNum < sizeof(Process->Pipes)/sizeof(Process->Pipes[0]); PipeNum++) {
+            ClmpOutputPipeBuffer(&Process->Pipes[PipeNum]);
+        }
+        ReleaseMutex(hOutputMutex);
+    }
+
+    //
+    //  If a child failed and the parent is still going, fail with
+    //  the same code.
+    //
+
+    if (ExitCode != 0 && GlobalExitCode == 0) {
+        GlobalExitCode = ExitCode;
+    }
+
+    //
+    //  Clean up and tear down so the process slot can be reused as
+    //  necessary.
+    //
+
+    if (Process->WindowsProcessInfo.hProcess != NULL) {
+        CloseHandle(Process->WindowsProcessInfo.hProcess);
+        Process->WindowsProcessInfo.hProcess = NULL;
+    }
+
+    if (Process->WindowsProcessInfo.hThread != NULL) {
+        CloseHandle(Process->WindowsProcessInfo.hThread);
+        Process->WindowsProcessInfo.hThread = NULL;
+    }
+
+    Process->ProcessLaunchStarted = FALSE;
+}
+
+/**
+ Find a slot to launch the next child process in.  If all slots are in use,
+ wait for a child to complete and reuse its slot.  If a job server is in use,
+ the first child uses the token implicitly granted to this process, and each
+ additional concurrent child requires a token from the job server; if none
+ is available, wait for either a token or a child to complete.
+
+ @param ProcessInfo Pointer to the array of child process slots.
+
+ @param NumberProcesses The number of elements in the ProcessInfo array.
+
+ @param hJobServer Optionally points to a job server handle.
+
+ @param TokensHeld On input, the number of job server tokens held by this
+        process.  This is updated if a token is acquired.
+
+ @param WaitHandles Pointer to an array of NumberProcesses + 1 handles to use
+        when waiting.
+
+ @param WaitSlots Pointer to an array of NumberProcesses slot indexes
+        corresponding to each handle in WaitHandles.
+
+ @return The slot to launch a child process in, or NumberProcesses if a child
+         process failed or the wait could not be performed.
+ */
+DWORD
+ClmpAcquireProcessSlot(
+    __in PCLMP_PROCESS_INFO ProcessInfo,
+    __in DWORD NumberProcesses,
+    __in_opt HANDLE hJobServer,
+    __inout PDWORD TokensHeld,
+    __in PHANDLE WaitHandles,
+    __in PDWORD WaitSlots
+    )
+{
+    DWORD Index;
+    DWORD NumberActive;
+    DWORD FreeSlot;
+    DWORD HandleCount;
+
+    NumberActive = 0;
+    FreeSlot = NumberProcesses;
+    for (Index = 0; Index < NumberProcesses; Index++) {
+        if (ProcessInfo[Index].ProcessLaunchStarted) {
+            if (ProcessInfo[Index].hCacheThread != NULL) {
+                WaitHandles[NumberActive] = ProcessInfo[Index].hCacheThread;
+            } else {
+                WaitHandles[NumberActive] = ProcessInfo[Index].WindowsProcessInfo.hProcess;
+            }
+            WaitSlots[NumberActive] = Index;
+            NumberActive++;
+        } else if (FreeSlot == NumberProcesses) {
+            FreeSlot = Index;
+        }
+    }
+
+    HandleCount = NumberActive;
+    if (FreeSlot < NumberProcesses) {
+        if (hJobServer == NULL || *TokensHeld >= NumberActive) {
+            return FreeSlot;
+        }
+
+        if (YoriLibTryAcquireJobServerToken(hJobServer)) {
+            (*TokensHeld)++;
+            return FreeSlot;
+        }
+
+        WaitHandles[HandleCount] = hJobServer;
+        HandleCount++;
+    }
+
+    Index = WaitForMultipleObjects(HandleCount, WaitHandles, FALSE, INFINITE);
+    Index = Index - WAIT_OBJECT_0;
+    if (Index >= HandleCount) {
+        return NumberProcesses;
+    }
+
+    if (Index == NumberActive) {
+        (*TokensHeld)++;
+        return FreeSlot;
+    }
+
+    //
+    //  A child completed, so its slot and any token it was using can be
+    //  used for the next child.
+    //
+
+    ClmpWaitOnProcess(&ProcessInfo[WaitSlots[Index]]);
+    if (GlobalExitCode) {
+        return NumberProcesses;
+    }
+
+    return WaitSlots[Index];
+}
+
+/**
+ Free any state allocated by ClmpInitializeCache.
+
+ @param Cache Pointer to the cache to clean up.
+ */
+VOID
+ClmpCleanupCache(
+    __inout PCLMP_CACHE Cache
+    )
+{
+    YoriLibFreeStringContents(&Cache->LocalDirectory);
+    YoriLibFreeStringContents(&Cache->SharedDirectory);
+    YoriLibFreeStringContents(&Cache->KeyPrefix);
+    if (Cache->DigestProvider != 0) {
+        DllAdvApi32.pCryptReleaseContext(Cache->DigestProvider, 0);
+        Cache->DigestProvider = 0;
+    }
+}
+
+/**
+ Prepare to cache compiled objects.  The cache is only used if the
+ YORICLMPCACHE environment variable names a directory, the compiler can be
+ found, and digests can be calculated on this system.
+
+ @param Cache On successful completion, populated with the cache state.
+
+ @param CommonString Pointer to the compiler command line common to all
+        source files.
+
+ @param ObjectOutputName Pointer to the object file or directory specified
+        with /Fo, or an empty string if none was specified.
+
+ @param ProcessorPlacement Pointer to processor placement state used when
+        launching the compiler.
+
+ @return TRUE to indicate the cache should be used, FALSE if it should not.
+ */
+BOOLEAN
+ClmpInitializeCache(
+    __out PCLMP_CACHE Cache,
+    __in PYORI_STRING CommonString,
+    __in PYORI_STRING ObjectOutputName,
+    __in PYORI_LIB_PROCESSOR_PLACEMENT ProcessorPlacement
+    )
+{
+    YORI_STRING CompilerName;
+    YORI_STRING CompilerPath;
+    YORI_STRING ClOptions;
+    YORI_STRING ClSuffixOptions;
+    WIN32_FILE_ATTRIBUTE_DATA CompilerAttributes;
+    LARGE_INTEGER CompilerWriteTime;
+    LARGE_INTEGER CompilerSize;
+    BOOLEAN Result;
+
+    ZeroMemory(Cache, sizeof(CLMP_CACHE));
+    YoriLibInitEmptyString(&Cache->LocalDirectory);
+    YoriLibInitEmptyString(&Cache->SharedDirectory);
+    YoriLibInitEmptyString(&Cache->KeyPrefix);
+    memcpy(&Cache->ObjectOutputName, ObjectOutputName, sizeof(YORI_STRING));
+    Cache->CommonString = CommonString;
+    Cache->ProcessorPlacement = ProcessorPlacement;
+
+    if (!YoriLibAllocateAndGetEnvVar(_T("YORICLMPCACHE"), &Cache->LocalDirectory) ||
+        Cache->LocalDirectory.LengthInChars == 0 ||
+        !YoriLibAllocateAndGetEnvVar(_T("YORICLMPCACHESHARED"), &Cache->SharedDirectory)) {
+
+        ClmpCleanupCache(Cache);
+        return FALSE;
+    }
+
+    YoriLibLoadAdvApi32Functions();
+    if (DllAdvApi32.pCryptAcquireContextW == NULL ||
+        DllAdvApi32.pCryptCreateHash == NULL ||
+        DllAdvApi32.pCryptDestroyHash == NULL ||
+        DllAdvApi32.pCryptGetHashParam == NULL ||
+        DllAdvApi32.pCryptHashData == NULL ||
+        DllAdvApi32.pCryptReleaseContext == NULL) {
+
+        ClmpCleanupCache(Cache);
+        return FALSE;
+    }
+
+    //
+    //  NT 4 RTM doesn't support CRYPT_VERIFYCONTEXT and may need a keyset
+    //  to be created.
+    //
+
+    if (!DllAdvApi32.pCryptAcquireContextW(&Cache->DigestProvider, NULL, MS_DEF_PROV, PROV_RSA_FULL, CRYPT_VERIFYCONTEXT) &&
+        !DllAdvApi32.pCryptAcquireContextW(&Cache->DigestProvider, NULL, MS_DEF_PROV, PROV_RSA_FULL, 0) &&
+        (GetLastError() != (DWORD)NTE_BAD_KEYSET ||
+         !DllAdvApi32.pCryptAcquireContextW(&Cache->DigestProvider, NULL, MS_DEF_PROV, PROV_RSA_FULL, CRYPT_NEWKEYSET))) {
+
+        Cache->DigestProvider = 0;
+        ClmpCleanupCache(Cache);
+        return FALSE;
+    }
+
+    //
+    //  The compiler is identified by its path, size and timestamp.  The CL
+    //  and _CL_ environment variables supply additional options, so these
+    //  are included alongside the options on the command line.
+    //
+
+    YoriLibConstantString(&CompilerName, _T("cl.exe"));
+    if (!YoriLibLocateExecutableInPath(&CompilerName, NULL, NULL, &CompilerPath)) {
+        YoriLibInitEmptyString(&CompilerPath);
+    }
+
+    if (CompilerPath.LengthInChars == 0 ||
+        !GetFileAttributesEx(CompilerPath.StartOfString, GetFileExInfoStandard, &CompilerAttributes)) {
+
+        YoriLibFreeStringContents(&CompilerPath);
+        ClmpCleanupCache(Cache);
+        return FALSE;
+    }
+
+    CompilerWriteTime.LowPart = CompilerAttributes.ftLastWriteTime.dwLowDateTime;
+    CompilerWriteTime.HighPart = (LONG)CompilerAttributes.ftLastWriteTime.dwHighDateTime;
+    CompilerSize.LowPart = CompilerAttributes.nFileSizeLow;
+    CompilerSize.HighPart = (LONG)CompilerAttributes.nFileSizeHigh;
+
+    YoriLibInitEmptyString(&ClOptions);
+    YoriLibInitEmptyString(&ClSuffixOptions);
+
+    Result = FALSE;
+    if (YoriLibAllocateAndGetEnvVar(_T("CL"), &ClOptions) &&
+        YoriLibAllocateAndGetEnvVar(_T("_CL_"), &ClSuffixOptions) &&
+        YoriLibYPrintf(&Cache->KeyPrefix, _T("%y|%llx|%llx|%y|%y|%y"), &CompilerPath, CompilerWriteTime.QuadPart, CompilerSize.QuadPart, &ClOptions, &ClSuffixOptions, CommonString) >= 0) {
+
+        Result = TRUE;
+    }
+
+    YoriLibFreeStringContents(&ClSuffixOptions);
+    YoriLibFreeStringContents(&ClOptions);
+    YoriLibFreeStringContents(&CompilerPath);
+
+    if (!Result) {
+        ClmpCleanupCache(Cache);
+    }
+
+    return Result;
+}
+
+/**
+ Determine the name of the object file that the compiler generates for a
+ source file.
+
+ @param Cache Pointer to the cache, which records any /Fo option.
+
+ @param SourceFile Pointer to the source file name.
+
+ @param ObjectFile On successful completion, populated with a newly
+        allocated string containing the object file name.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+ClmpGetObjectFileName(
+    __in PCLMP_CACHE Cache,
+    __in PYORI_STRING SourceFile,
+    __out PYORI_STRING ObjectFile
+    )
+{
+    YORI_STRING BaseName;
+    PYORI_STRING OutputName;
+    YORI_ALLOC_SIZE_T Index;
+    DWORD Attributes;
+    BOOLEAN HasExtension;
+
+    //
+    //  Find the file name of the source without its path or extension.
+    //
+
+    YoriLibInitEmptyString(&BaseName);
+    BaseName.StartOfString = SourceFile->StartOfString;
+    BaseName.LengthInChars = SourceFile->LengthInChars;
+    for (Index = SourceFile->LengthInChars; Index > 0; Index--) {
+        if (YoriLibIsSep(SourceFile->StartOfString[Index - 1]) ||
+            SourceFile->StartOfString[Index - 1] == ':') {
+
+            BaseName.StartOfString = &SourceFile->StartOfString[Index];
+            BaseName.LengthInChars = SourceFile->LengthInChars - Index;
+            break;
+        }
+    }
+
+    for (Index = BaseName.LengthInChars; Index > 0; Index--) {
+        if (BaseName.StartOfString[Index - 1] == '.') {
+            BaseName.LengthInChars = Index - 1;
+            break;
+        }
+    }
+
+    //
+    //  Without /Fo the object is placed in the current directory.  If /Fo
+    //  refers to a directory the object is placed there, and otherwise it
+    //  names the object, with a default extension of .obj.
+    //
+
+    YoriLibInitEmptyString(ObjectFile);
+    OutputName = &Cache->ObjectOutputName;
+    if (OutputName->LengthInChars == 0) {
+        return (BOOLEAN)(YoriLibYPrintf(ObjectFile, _T("%y.obj"), &BaseName) >= 0);
+    }
+
+    if (YoriLibIsSep(OutputName->StartOfString[OutputName->LengthInChars - 1])) {
+        return (BOOLEAN)(YoriLibYPrintf(ObjectFile, _T("%y%y.obj"), OutputName, &BaseName) >= 0);
+    }
+
+    Attributes = GetFileAttributes(OutputName->StartOfString);
+    if (Attributes != INVALID_FILE_ATTRIBUTES &&
+        (Attributes & FILE_ATTRIBUTE_DIRECTORY) != 0) {
+
+        return (BOOLEAN)(YoriLibYPrintf(ObjectFile, _T("%y\\%y.obj"), OutputName, &BaseName) >= 0);
+    }
+
+    HasExtension = FALSE;
+    for (Index = OutputName->LengthInChars; Index > 0; Index--) {
+        if (YoriLibIsSep(OutputName->StartOfString[Index - 1])) {
+            break;
+        }
+        if (OutputName->StartOfString[Index - 1] == '.') {
+            HasExtension = TRUE;
+            break;
+        }
+    }
+
+    if (HasExtension) {
+        return (BOOLEAN)(YoriLibYPrintf(ObjectFile, _T("%y"), OutputName) >= 0);
+    }
+
+    return (BOOLEAN)(YoriLibYPrintf(ObjectFile, _T("%y.obj"), OutputName) >= 0);
+}
+
+/**
+ Preprocess a source file and calculate a digest of the result, combined
+ with the compiler and its options.  Messages from the preprocessor are
+ included in the digest.
+
+ @param Cache Pointer to the cache.
+
+ @param SourceFile Pointer to the source file name.
+
+ @param Digest On successful completion, populated with the digest.
+
+ @return TRUE to indicate success, FALSE to indicate failure, including if
+         the preprocessor failed.
+ */
+__success(return)
+BOOLEAN
+ClmpHashPreprocessedSource(
+    __in PCLMP_CACHE Cache,
+    __in PYORI_STRING SourceFile,
+    __out_ecount(CLMP_DIGEST_SIZE) PUCHAR Digest
+    )
+{
+    YORI_STRING CommandLine;
+    SECURITY_ATTRIBUTES SecurityAttributes;
+    STARTUPINFO StartupInfo;
+    PROCESS_INFORMATION ProcessInfo;
+    HANDLE ReadPipe;
+    HANDLE WritePipe;
+    DWORD_PTR hHash;
+    PUCHAR ReadBuffer;
+    DWORD BytesRead;
+    DWORD ExitCode;
+    DWORD HashLength;
+    BOOL ProcessLaunched;
+    BOOLEAN Result;
+
+    YoriLibInitEmptyString(&CommandLine);
+    if (YoriLibYPrintf(&CommandLine, _T("%y /E %y"), Cache->CommonString, SourceFile) < 0) {
+        return FALSE;
+    }
+
+    ReadBuffer = YoriLibMalloc(CLMP_PREPROCESS_BUFFER_SIZE);
+    if (ReadBuffer == NULL) {
+        YoriLibFreeStringContents(&CommandLine);
+        return FALSE;
+    }
+
+    if (!DllAdvApi32.pCryptCreateHash(Cache->DigestProvider, CALG_MD5, 0, 0, &hHash)) {
+        YoriLibFree(ReadBuffer);
+        YoriLibFreeStringContents(&CommandLine);
+        return FALSE;
+    }
+
+    Result = FALSE;
+    if (!DllAdvApi32.pCryptHashData(hHash, (PUCHAR)Cache->KeyPrefix.StartOfString, Cache->KeyPrefix.LengthInChars * sizeof(TCHAR), 0)) {
+        goto Exit;
+    }
+
+    ZeroMemory(&SecurityAttributes, sizeof(SecurityAttributes));
+    SecurityAttributes.nLength = sizeof(SecurityAttributes);
+    SecurityAttributes.bInheritHandle = TRUE;
+
+    WaitForSingleObject(hLaunchMutex, INFINITE);
+    if (!CreatePipe(&ReadPipe, &WritePipe, &SecurityAttributes, 0)) {
+        ReleaseMutex(hLaunchMutex);
+        goto Exit;
+    }
+
+    ZeroMemory(&StartupInfo, sizeof(StartupInfo));
+    StartupInfo.cb = sizeof(StartupInfo);
+    StartupInfo.dwFlags = STARTF_USESTDHANDLES;
+    StartupInfo.hStdOutput = WritePipe;
+    StartupInfo.hStdError = WritePipe;
+
+    ProcessLaunched = CreateProcess(NULL, CommandLine.StartOfString, NULL, NULL, TRUE, CREATE_DEFAULT_ERROR_MODE, NULL, NULL, &StartupInfo, &ProcessInfo);
+    CloseHandle(WritePipe);
+    ReleaseMutex(hLaunchMutex);
+
+    if (!ProcessLaunched) {
+        CloseHandle(ReadPipe);
+        goto Exit;
+    }
+
+    //
+    //  Keep reading after any failure so the preprocessor isn't left
+    //  blocked writing to the pipe.
+    //
+
+    Result = TRUE;
+    while (ReadFile(ReadPipe, ReadBuffer, CLMP_PREPROCESS_BUFFER_SIZE, &BytesRead, NULL) && BytesRead > 0) {
+        if (Result && !DllAdvApi32.pCryptHashData(hHash, ReadBuffer, BytesRead, 0)) {
+            Result = FALSE;
+        }
+    }
+
+    CloseHandle(ReadPipe);
+    WaitForSingleObject(ProcessInfo.hProcess, INFINITE);
+    if (!GetExitCodeProcess(ProcessInfo.hProcess, &ExitCode) || ExitCode != 0) {
+        Result = FALSE;
+    }
+    CloseHandle(ProcessInfo.hProcess);
+    CloseHandle(ProcessInfo.hThread);
+
+    if (Result) {
+        HashLength = CLMP_DIGEST_SIZE;
+        if (!DllAdvApi32.pCryptGetHashParam(hHash, HP_HASHVAL, Digest, &HashLength, 0)) {
+            Result = FALSE;
+        }
+    }
+
+Exit:
+    DllAdvApi32.pCryptDestroyHash(hHash);
+    YoriLibFree(ReadBuffer);
+    YoriLibFreeStringContents(&CommandLine);
+    return Result;
+}
+
+/**
+ Build the name of a cache entry.  Entries are spread across subdirectories
+ named for the first two characters of the digest.
+
+ @param Directory Pointer to the cache directory.
+
+ @param DigestString Pointer to the digest in hex form.
+
+ @param EntryName On successful completion, populated with a newly allocated
+        string containing the name of the cache entry.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+ClmpGetCacheEntryName(
+    __in PYORI_STRING Directory,
+    __in PYORI_STRING DigestString,
+    __out PYORI_STRING EntryName
+    )
+{
+    YORI_STRING SubdirName;
+
+    YoriLibInitEmptyString(&SubdirName);
+    SubdirName.StartOfString = DigestString->StartOfString;
+    SubdirName.LengthInChars = 2;
 
-    /**
-     A handle to the thread processing this stream.
-     */
-    HANDLE hPumpThread;
+    YoriLibInitEmptyString(EntryName);
+    if (YoriLibYPrintf(EntryName, _T("%y\\%y\\%y.obj"), Directory, &SubdirName, DigestString) < 0) {
+        return FALSE;
+    }
 
-    /**
-     The flags to use when outputting anything from this stream.
-     */
-    WORD OutputFlags;
-} CLMP_PIPE_BUFFER, *PCLMP_PIPE_BUFFER;
+    return TRUE;
+}
 
 /**
- Information about a single outstanding child process.
+ Copy a cached object into place.
+
+ @param EntryName Pointer to the name of the cache entry.
+
+ @param ObjectFile Pointer to the object file to create.
+
+ @return TRUE to indicate the object was copied, FALSE if it was not.
  */
-typedef struct _CLMP_PROCESS_INFO {
+BOOLEAN
+ClmpCacheFetch(
+    __in PYORI_STRING EntryName,
+    __in PYORI_STRING ObjectFile
+    )
+{
+    HANDLE FileHandle;
+    FILETIME CurrentTime;
 
-    /**
-     Information as returned by Windows when launching the child process.
-     */
-    PROCESS_INFORMATION WindowsProcessInfo;
+    if (!CopyFile(EntryName->StartOfString, ObjectFile->StartOfString, FALSE)) {
+        return FALSE;
+    }
 
-    /**
-     Standard output and standard error pipe buffers to the child process.
-     */
-    CLMP_PIPE_BUFFER Pipes[2];
+    //
+    //  CopyFile preserves the timestamp of the cache entry.  Give the
+    //  object the current time, as it would have if it were compiled, so
+    //  it is newer than its source.
+    //
 
-    /**
-     A NULL terminated string corresponding to the file being processed
-     by this child process.
-     */
-    LPTSTR Filename;
+    FileHandle = CreateFile(ObjectFile->StartOfString, FILE_WRITE_ATTRIBUTES, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (FileHandle == INVALID_HANDLE_VALUE) {
+        DeleteFile(ObjectFile->StartOfString);
+        return FALSE;
+    }
 
-    /**
-     If TRUE, process launch was started.  If FALSE, the process has been
-     waited upon and no new process launch commenced.
-     */
-    BOOLEAN ProcessLaunchStarted;
-} CLMP_PROCESS_INFO, *PCLMP_PROCESS_INFO;
+    GetSystemTimeAsFileTime(&CurrentTime);
+    if (!SetFileTime(FileHandle, NULL, NULL, &CurrentTime)) {
+        CloseHandle(FileHandle);
+        DeleteFile(ObjectFile->StartOfString);
+        return FALSE;
+    }
+
+    CloseHandle(FileHandle);
+    return TRUE;
+}
 
 /**
- A worker thread function that fetches entire lines from an input stream,
- and writes them to the current process output stream, with synchronization
- to ensure that each line is written as a line.
+ Add a compiled object to the cache.  Failure is not reported, since the
+ object has been generated and will be compiled again on the next miss.
 
- @param Param Pointer to a CLMP_PIPE_BUFFER structure indicating a single
-        input stream to process.
+ @param ObjectFile Pointer to the object file to add.
 
- @return Exit code for the thread.
+ @param EntryName Pointer to the name of the cache entry.
  */
-DWORD WINAPI
-ClmpPumpSingleStream(
-    __in LPVOID Param
+VOID
+ClmpCacheStore(
+    __in PYORI_STRING ObjectFile,
+    __in PYORI_STRING EntryName
     )
 {
-    PCLMP_PIPE_BUFFER Buffer = (PCLMP_PIPE_BUFFER)Param;
-    PVOID LineContext = NULL;
-    YORI_STRING LineString;
-
-    YoriLibInitEmptyString(&LineString);
+    YORI_STRING ParentName;
+    YORI_STRING TempName;
+    YORI_ALLOC_SIZE_T Index;
 
-    while (TRUE) {
-        if (!YoriLibReadLineToString(&LineString, &LineContext, Buffer->Pipe)) {
+    for (Index = EntryName->LengthInChars; Index > 0; Index--) {
+        if (YoriLibIsSep(EntryName->StartOfString[Index - 1])) {
             break;
         }
+    }
 
-        //
-        //  Synchronize with other things writing to output
-        //
+    if (Index <= 1) {
+        return;
+    }
 
-        WaitForSingleObject(hOutputMutex, INFINITE);
-        YoriLibOutput(Buffer->OutputFlags, _T("%y\n"), &LineString);
-        ReleaseMutex(hOutputMutex);
+    //
+    //  Creating the directory modifies the buffer, so create it from a
+    //  copy.
+    //
+
+    if (!YoriLibCopyString(&ParentName, EntryName)) {
+        return;
     }
 
-    YoriLibLineReadClose(LineContext);
-    YoriLibFreeStringContents(&LineString);
+    ParentName.LengthInChars = Index - 1;
+    ParentName.StartOfString[ParentName.LengthInChars] = '\0';
+    if (!YoriLibCreateDirectoryAndParents(&ParentName)) {
+        YoriLibFreeStringContents(&ParentName);
+        return;
+    }
+    YoriLibFreeStringContents(&ParentName);
 
-    return 0;
+    //
+    //  Copy to a temporary name and rename it into place, so that a
+    //  concurrent lookup never finds a partially written entry.
+    //
+
+    YoriLibInitEmptyString(&TempName);
+    if (YoriLibYPrintf(&TempName, _T("%y.%x.%x.tmp"), EntryName, GetCurrentProcessId(), GetCurrentThreadId()) < 0) {
+        return;
+    }
+
+    if (CopyFile(ObjectFile->StartOfString, TempName.StartOfString, FALSE)) {
+        if (!MoveFileEx(TempName.StartOfString, EntryName->StartOfString, MOVEFILE_REPLACE_EXISTING)) {
+            DeleteFile(TempName.StartOfString);
+        }
+    }
+
+    YoriLibFreeStringContents(&TempName);
 }
 
 /**
- Wait for a child process.  If it failed, we fail.  This function can be
- called if a process failed to launch, or has already been waited upon,
- so it must be willing to clean up whatever state exists.
+ A worker thread function that compiles a single source file using the
+ cache.  The source is preprocessed and hashed along with the compiler and
+ its options.  If an object with that digest is in the local cache, or
+ failing that the shared cache, it is copied into place.  Otherwise the
+ compiler is launched and, if it succeeds, its object is added to the
+ caches.  If the cache cannot be used, the source is compiled normally.
 
- @param Process The process to wait for.
+ @param Param Pointer to a CLMP_PROCESS_INFO structure describing the
+        source file to compile.
+
+ @return The exit code of the compilation, which is zero for success.
  */
-VOID
-ClmpWaitOnProcess (
-    __in PCLMP_PROCESS_INFO Process
+DWORD WINAPI
+ClmpCompileWithCache(
+    __in LPVOID Param
     )
 {
+    PCLMP_PROCESS_INFO Process = (PCLMP_PROCESS_INFO)Param;
+    PCLMP_CACHE Cache = Process->Cache;
+    UCHAR Digest[CLMP_DIGEST_SIZE];
+    TCHAR DigestChars[CLMP_DIGEST_SIZE * 2 + 1];
+    YORI_STRING DigestString;
+    YORI_STRING ObjectFile;
+    YORI_STRING LocalEntry;
+    YORI_STRING SharedEntry;
+    BOOLEAN DigestValid;
+    BOOLEAN Found;
     DWORD ExitCode;
-    DWORD PipeNum;
-    DWORD WaitResult;
-
-    ASSERT(Process->ProcessLaunchStarted);
 
-    if (Process->WindowsProcessInfo.hProcess != NULL) {
-        WaitResult = WaitForSingleObject(Process->WindowsProcessInfo.hProcess, INFINITE);
-        ASSERT(WaitResult == WAIT_OBJECT_0);
-        GetExitCodeProcess(Process->WindowsProcessInfo.hProcess, &ExitCode);
-    } else {
+    YoriLibInitEmptyString(&DigestString);
+    DigestString.StartOfString = DigestChars;
+    DigestString.LengthAllocated = sizeof(DigestChars)/sizeof(DigestChars[0]);
+    YoriLibInitEmptyString(&ObjectFile);
+    YoriLibInitEmptyString(&LocalEntry);
+    YoriLibInitEmptyString(&SharedEntry);
 
-        //
-        //  It's safe to use a failure as an exit code so long as the
-        //  process started to launch.
-        //
+    DigestValid = FALSE;
+    if (ClmpGetObjectFileName(Cache, Process->SourceFile, &ObjectFile) &&
+        ClmpHashPreprocessedSource(Cache, Process->SourceFile, Digest) &&
+        YoriLibHexBufferToString(Digest, CLMP_DIGEST_SIZE, &DigestString) &&
+        ClmpGetCacheEntryName(&Cache->LocalDirectory, &DigestString, &LocalEntry)) {
 
-        ExitCode = EXIT_FAILURE;
-    }
+        DigestValid = TRUE;
+        if (Cache->SharedDirectory.LengthInChars > 0 &&
+            !ClmpGetCacheEntryName(&Cache->SharedDirectory, &DigestString, &SharedEntry)) {
 
-    for (PipeNum = 0; PipeNum < sizeof(Process->Pipes)/sizeof(Process->Pipes[0]); PipeNum++) {
-        if (Process->Pipes[PipeNum].hPumpThread != NULL) {
-            WaitResult = WaitForSingleObject(Process->Pipes[PipeNum].hPumpThread, INFINITE);
-            ASSERT(WaitResult == WAIT_OBJECT_0);
-            CloseHandle(Process->Pipes[PipeNum].hPumpThread);
-            Process->Pipes[PipeNum].hPumpThread = NULL;
+            YoriLibInitEmptyString(&SharedEntry);
         }
+    }
 
-        if (Process->Pipes[PipeNum].Pipe) {
-            CloseHandle(Process->Pipes[PipeNum].Pipe);
-            Process->Pipes[PipeNum].Pipe = NULL;
+    Found = FALSE;
+    if (DigestValid) {
+        if (ClmpCacheFetch(&LocalEntry, &ObjectFile)) {
+            Found = TRUE;
+        } else if (SharedEntry.LengthInChars > 0 &&
+                   ClmpCacheFetch(&SharedEntry, &ObjectFile)) {
+            Found = TRUE;
+            ClmpCacheStore(&ObjectFile, &LocalEntry);
         }
     }
 
-    //
-    //  If a child failed and the parent is still going, fail with
-    //  the same code.
-    //
-
-    if (ExitCode != 0 && GlobalExitCode == 0) {
-        GlobalExitCode = ExitCode;
-    }
+    if (Found) {
 
-    //
-    //  Clean up and tear down so the process slot can be reused as
-    //  necessary.
-    //
+        //
+        //  The compiler displays the name of each source file, so do the
+        //  same for objects found in the cache.
+        //
 
-    if (Process->WindowsProcessInfo.hProcess != NULL) {
-        CloseHandle(Process->WindowsProcessInfo.hProcess);
-        Process->WindowsProcessInfo.hProcess = NULL;
-    }
+        WaitForSingleObject(hOutputMutex, INFINITE);
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y\n"), Process->SourceFile);
+        ReleaseMutex(hOutputMutex);
+        ExitCode = EXIT_SUCCESS;
+    } else if (!ClmpLaunchProcess(Process, Cache->ProcessorPlacement)) {
+        ExitCode = EXIT_FAILURE;
+    } else {
+        WaitForSingleObject(Process->WindowsProcessInfo.hProcess, INFINITE);
+        if (!GetExitCodeProcess(Process->WindowsProcessInfo.hProcess, &ExitCode)) {
+            ExitCode = EXIT_FAILURE;
+        }
 
-    if (Process->WindowsProcessInfo.hThread != NULL) {
-        CloseHandle(Process->WindowsProcessInfo.hThread);
-        Process->WindowsProcessInfo.hThread = NULL;
+        if (ExitCode == 0 && DigestValid) {
+            ClmpCacheStore(&ObjectFile, &LocalEntry);
+            if (SharedEntry.LengthInChars > 0) {
+                ClmpCacheStore(&ObjectFile, &SharedEntry);
+            }
+        }
     }
 
-    Process->ProcessLaunchStarted = FALSE;
+    YoriLibFreeStringContents(&SharedEntry);
+    YoriLibFreeStringContents(&LocalEntry);
+    YoriLibFreeStringContents(&ObjectFile);
+    return ExitCode;
 }
 
 /**
@@ -248,20 +1564,29 @@ ymain(
     )
 {
     YORI_STRING CommonString;
-    YORI_STRING CompleteString;
+    YORI_STRING ObjectOutputName;
     YORI_ALLOC_SIZE_T i, j;
     PCLMP_PROCESS_INFO ProcessInfo;
     YORI_ALLOC_SIZE_T CurrentProcess = 0;
     YORI_ALLOC_SIZE_T NumberProcesses = 0;
+    HANDLE hJobServer = NULL;
+    DWORD TokensHeld = 0;
+    PHANDLE WaitHandles;
+    PDWORD WaitSlots;
     BOOLEAN MultiProcPossible = FALSE;
     BOOLEAN MultiProcNotPossible = FALSE;
+    BOOLEAN CacheNotPossible = FALSE;
+    BOOLEAN CacheEnabled = FALSE;
+    CLMP_CACHE Cache;
     YORI_STRING Arg;
-    SYSTEM_INFO SysInfo;
+    YORI_LIB_PROCESSOR_PLACEMENT ProcessorPlacement;
+    WORD PerformanceProcessors;
+    WORD EfficiencyProcessors;
 
-    GetSystemInfo(&SysInfo);
+    ZeroMemory(&ProcessorPlacement, sizeof(ProcessorPlacement));
 
     YoriLibInitEmptyString(&CommonString);
-    YoriLibInitEmptyString(&CompleteString);
+    YoriLibInitEmptyString(&ObjectOutputName);
 
     if (!YoriLibStringConcatWithLiteral(&CommonString, _T("cl "))) {
         return EXIT_FAILURE;
@@ -369,6 +1694,35 @@ ymain(
                     }
                 }
             }
+
+            //
+            //  Options that generate output other than the object, or
+            //  depend on state not captured by preprocessing, prevent
+            //  objects from being cached.  Record where the object is
+            //  written so a cached object can be placed there.
+            //
+
+            if (YoriLibCompareStringLitCnt(&Arg, _T("Fo"), 2) == 0) {
+                ObjectOutputName.StartOfString = &Arg.StartOfString[2];
+                ObjectOutputName.LengthInChars = Arg.LengthInChars - 2;
+                if (ObjectOutputName.LengthInChars > 0 &&
+                    ObjectOutputName.StartOfString[0] == ':') {
+
+                    ObjectOutputName.StartOfString++;
+                    ObjectOutputName.LengthInChars--;
+                }
+            } else if (YoriLibCompareStringLitCnt(&Arg, _T("F"), 1) == 0) {
+                if (YoriLibCompareStringLitCnt(&Arg, _T("FI"), 2) != 0 &&
+                    YoriLibCompareStringLitCnt(&Arg, _T("Fd"), 2) != 0) {
+
+                    CacheNotPossible = TRUE;
+                }
+            } else if (YoriLibCompareStringLitCnt(&Arg, _T("Y"), 1) == 0 ||
+                       YoriLibCompareStringLitCnt(&Arg, _T("P"), 1) == 0 ||
+                       YoriLibCompareStringLitIns(&Arg, _T("showIncludes")) == 0) {
+
+                CacheNotPossible = TRUE;
+            }
         }
     }
 
@@ -380,10 +1734,26 @@ ymain(
     if (!MultiProcPossible || MultiProcNotPossible) {
         NumberProcesses = 1;
     } else if (NumberProcesses == 0) {
-        NumberProcesses = (YORI_ALLOC_SIZE_T)SysInfo.dwNumberOfProcessors + 1;
+
+        //
+        //  Count processors in all processor groups, not just the group
+        //  this process is executing in.
+        //
+
+        YoriLibQueryCpuCount(&PerformanceProcessors, &EfficiencyProcessors);
+        NumberProcesses = (YORI_ALLOC_SIZE_T)(PerformanceProcessors + EfficiencyProcessors + 1);
     }
 
-    ProcessInfo = YoriLibMalloc(sizeof(CLMP_PROCESS_INFO) * NumberProcesses);
+    //
+    //  Waiting for a slot involves waiting for any child process or the job
+    //  server, which is limited by WaitForMultipleObjects.
+    //
+
+    if (NumberProcesses > MAXIMUM_WAIT_OBJECTS - 1) {
+        NumberProcesses = MAXIMUM_WAIT_OBJECTS - 1;
+    }
+
+    ProcessInfo = YoriLibMalloc((YORI_ALLOC_SIZE_T)((sizeof(CLMP_PROCESS_INFO) + sizeof(HANDLE) + sizeof(DWORD)) * NumberProcesses + sizeof(HANDLE)));
 
     if (ProcessInfo == NULL) {
         YoriLibFreeStringContents(&CommonString);
@@ -391,6 +1761,8 @@ ymain(
     }
 
     ZeroMemory(ProcessInfo, sizeof(CLMP_PROCESS_INFO) * NumberProcesses);
+    WaitHandles = (PHANDLE)(ProcessInfo + NumberProcesses);
+    WaitSlots = (PDWORD)(WaitHandles + NumberProcesses + 1);
 
     hOutputMutex = CreateMutex(NULL, FALSE, NULL);
     if (hOutputMutex == NULL) {
@@ -399,121 +1771,109 @@ ymain(
         return EXIT_FAILURE;
     }
 
+    hLaunchMutex = CreateMutex(NULL, FALSE, NULL);
+    if (hLaunchMutex == NULL) {
+        CloseHandle(hOutputMutex);
+        YoriLibFreeStringContents(&CommonString);
+        YoriLibFree(ProcessInfo);
+        return EXIT_FAILURE;
+    }
+
     //
-    //  Scan again looking for source files, and spawn one child
-    //  process per argument found, combined with the command
-    //  line we built earlier.
+    //  If a parent process is sharing a job server, only use as many
+    //  processes as it allows.
     //
 
-    for (i = 1; i < ArgC; i++) {
-        if (!YoriLibIsCommandLineOption(&ArgV[i], &Arg)) {
-
-            STARTUPINFO StartupInfo;
-            DWORD MyProcess = CurrentProcess;
-            SECURITY_ATTRIBUTES SecurityAttributes;
-            HANDLE WriteOutPipe, WriteErrPipe;
-            DWORD ThreadId;
-
-            CompleteString.LengthInChars = 0;
-            if (!YoriLibStringConcat(&CompleteString, &CommonString) ||
-                !YoriLibStringConcatWithLiteral(&CompleteString, _T(" ")) ||
-                !YoriLibStringConcat(&CompleteString, &ArgV[i])) {
-
-                GlobalExitCode = EXIT_FAILURE;
-                goto drain;
-            }
+    if (NumberProcesses > 1) {
+        hJobServer = YoriLibOpenJobServer();
 
-            ZeroMemory(&StartupInfo, sizeof(StartupInfo));
-            StartupInfo.cb = sizeof(StartupInfo);
+        //
+        //  Spread children across NUMA nodes and processor groups so they
+        //  aren't all placed within the group of this process.
+        //
 
-            MyProcess %= NumberProcesses;
+        YoriLibInitializeProcessorPlacement(&ProcessorPlacement, YoriLibPlacementByNumaNode);
 
-            //
-            //  If we've run out of processors, wait for the next child
-            //  process and reuse its slot.
-            //
+        //
+        //  Collect output from all children with a completion port rather
+        //  than two threads per child.
+        //
 
-            if (CurrentProcess >= NumberProcesses) {
-                ClmpWaitOnProcess(&ProcessInfo[MyProcess]);
-                if (GlobalExitCode) {
-                    goto drain;
-                }
-            }
+        ClmpStartCompletionPort();
+    }
 
-            //
-            //  We need to specify security attributes because we want our
-            //  standard output and standard error handles to be inherited.
-            //
+    //
+    //  Objects can only be cached when each source file is compiled to its
+    //  own object without linking.
+    //
 
-            ZeroMemory(&SecurityAttributes, sizeof(SecurityAttributes));
+    if (MultiProcPossible && !MultiProcNotPossible && !CacheNotPossible) {
+        CacheEnabled = ClmpInitializeCache(&Cache, &CommonString, &ObjectOutputName, &ProcessorPlacement);
+    }
 
-            SecurityAttributes.nLength = sizeof(SecurityAttributes);
-            SecurityAttributes.bInheritHandle = TRUE;
+    //
+    //  Scan again looking for source files, and spawn one child
+    //  process per argument found, combined with the command
+    //  line we built earlier.
+    //
 
-            //
-            //  Mark launch as having started.  Any failure after this point
-            //  is considered an error when this process exits.
-            //
+    for (i = 1; i < ArgC; i++) {
+        if (!YoriLibIsCommandLineOption(&ArgV[i], &Arg)) {
 
-            ProcessInfo[MyProcess].ProcessLaunchStarted = TRUE;
+            DWORD MyProcess;
+            DWORD ThreadId;
 
             //
-            //  Create the aforementioned handles.
+            //  Find a slot for the child, waiting for a child process to
+            //  complete if all are in use or the job server has no
+            //  capacity.
             //
 
-            if (!CreatePipe(&ProcessInfo[MyProcess].Pipes[0].Pipe, &WriteOutPipe, &SecurityAttributes, 0)) {
-
-                GlobalExitCode = EXIT_FAILURE;
-                goto drain;
-            }
-
-            if (!CreatePipe(&ProcessInfo[MyProcess].Pipes[1].Pipe, &WriteErrPipe, &SecurityAttributes, 0)) {
-
-                GlobalExitCode = EXIT_FAILURE;
+            MyProcess = ClmpAcquireProcessSlot(ProcessInfo, NumberProcesses, hJobServer, &TokensHeld, WaitHandles, WaitSlots);
+            if (MyProcess >= NumberProcesses) {
+                if (GlobalExitCode == 0) {
+                    GlobalExitCode = EXIT_FAILURE;
+                }
                 goto drain;
             }
 
-            ProcessInfo[MyProcess].Pipes[0].OutputFlags = YORI_LIB_OUTPUT_STDOUT;
+            ProcessInfo[MyProcess].CommandLine.LengthInChars = 0;
+            if (!YoriLibStringConcat(&ProcessInfo[MyProcess].CommandLine, &CommonString) ||
+                !YoriLibStringConcatWithLiteral(&ProcessInfo[MyProcess].CommandLine, _T(" ")) ||
+                !YoriLibStringConcat(&ProcessInfo[MyProcess].CommandLine, &ArgV[i])) {
 
-            ProcessInfo[MyProcess].Pipes[0].hPumpThread = CreateThread(NULL, 0, ClmpPumpSingleStream, &ProcessInfo[MyProcess].Pipes[0], 0, &ThreadId);
-            if (ProcessInfo[MyProcess].Pipes[0].hPumpThread == NULL) {
                 GlobalExitCode = EXIT_FAILURE;
                 goto drain;
             }
 
-            ProcessInfo[MyProcess].Pipes[1].OutputFlags = YORI_LIB_OUTPUT_STDERR;
-
-            ProcessInfo[MyProcess].Pipes[1].hPumpThread = CreateThread(NULL, 0, ClmpPumpSingleStream, &ProcessInfo[MyProcess].Pipes[1], 0, &ThreadId);
-            if (ProcessInfo[MyProcess].Pipes[1].hPumpThread == NULL) {
-                GlobalExitCode = EXIT_FAILURE;
-                goto drain;
-            }
+            //
+            //  Mark launch as having started.  Any failure after this point
+            //  is considered an error when this process exits.
+            //
 
+            ProcessInfo[MyProcess].ProcessLaunchStarted = TRUE;
             ProcessInfo[MyProcess].Filename = ArgV[i].StartOfString;
+            ProcessInfo[MyProcess].SourceFile = &ArgV[i];
 
-            //
-            //  The child process should write to the write handles, but
-            //  this process doesn't want those, so we close them immediately
-            //  below.
-            //
+            if (CacheEnabled) {
 
-            StartupInfo.dwFlags = STARTF_USESTDHANDLES;
-            if (GetStdHandle(STD_OUTPUT_HANDLE) == GetStdHandle(STD_ERROR_HANDLE)) {
-                StartupInfo.hStdOutput = WriteOutPipe;
-                StartupInfo.hStdError = WriteOutPipe;
-            } else {
-                StartupInfo.hStdOutput = WriteOutPipe;
-                StartupInfo.hStdError = WriteErrPipe;
-            }
+                //
+                //  Checking the cache requires preprocessing the source, so
+                //  do it on a thread per slot so sources are checked in
+                //  parallel.
+                //
 
-            if (!CreateProcess(NULL, CompleteString.StartOfString, NULL, NULL, TRUE, CREATE_DEFAULT_ERROR_MODE, NULL, NULL, &StartupInfo, &ProcessInfo[MyProcess].WindowsProcessInfo)) {
+                ProcessInfo[MyProcess].Cache = &Cache;
+                ProcessInfo[MyProcess].hCacheThread = CreateThread(NULL, 0, ClmpCompileWithCache, &ProcessInfo[MyProcess], 0, &ThreadId);
+                if (ProcessInfo[MyProcess].hCacheThread == NULL) {
+                    GlobalExitCode = EXIT_FAILURE;
+                    goto drain;
+                }
+            } else if (!ClmpLaunchProcess(&ProcessInfo[MyProcess], &ProcessorPlacement)) {
                 GlobalExitCode = EXIT_FAILURE;
                 goto drain;
             }
 
-            CloseHandle(WriteOutPipe);
-            CloseHandle(WriteErrPipe);
-
             CurrentProcess++;
         }
     }
@@ -545,22 +1905,38 @@ drain:
     //  fail we will also fail with the same error code.
     //
 
-    if (CurrentProcess > NumberProcesses) {
-        CurrentProcess = NumberProcesses;
-    }
-
-    do {
-        CurrentProcess--;
-
+    for (CurrentProcess = 0; CurrentProcess < NumberProcesses; CurrentProcess++) {
         if (ProcessInfo[CurrentProcess].ProcessLaunchStarted) {
             ClmpWaitOnProcess(&ProcessInfo[CurrentProcess]);
+
+            //
+            //  Each completed child reduces the number of tokens needed
+            //  by one.
+            //
+
+            if (TokensHeld > 0) {
+                YoriLibReleaseJobServerToken(hJobServer);
+                TokensHeld--;
+            }
         }
 
-    } while (CurrentProcess > 0);
+        YoriLibFreeStringContents(&ProcessInfo[CurrentProcess].CommandLine);
+    }
+
+    if (CacheEnabled) {
+        ClmpCleanupCache(&Cache);
+    }
+
+    ClmpStopCompletionPort();
+
+    if (hJobServer != NULL) {
+        CloseHandle(hJobServer);
+    }
 
+    YoriLibCleanupProcessorPlacement(&ProcessorPlacement);
     YoriLibFree(ProcessInfo);
     YoriLibFreeStringContents(&CommonString);
-    YoriLibFreeStringContents(&CompleteString);
+    CloseHandle(hLaunchMutex);
     CloseHandle(hOutputMutex);
 
     if (GlobalExitCode) {
@@ -35,11 +35,13 @@ CHAR strCompactHelpText[] =
         "\n"
         "Compress or decompress one or more files.\n"
         "\n"
-        "COMPACT [-license] [-b] [-c:algorithm | -u] [-s] [<file>...]\n"
+        "COMPACT [-license] [-b] [-bg] [-c:algorithm | -u] [-j <n>] [-s] [<file>...]\n"
         "\n"
         "   -b             Use basic search criteria for files only\n"
+        "   -bg            Compress files with background CPU and I/O priority\n"
         "   -c             Compress files with the specified algorithm.  Options are:\n"
         "                    lzx, ntfs, xp4k, xp8k, xp16k\n"
+        "   -j             Process at most the specified number of files concurrently\n"
         "   -s             Process files from all subdirectories\n"
         "   -u             Decompress files\n"
         "   -v             Verbose output\n";
@@ -243,6 +245,8 @@ ENTRYPOINT(
     YORI_ALLOC_SIZE_T StartArg = 0;
     WORD MatchFlags;
     BOOLEAN BasicEnumeration = FALSE;
+    BOOLEAN BackgroundPriority = FALSE;
+    DWORD ThreadCount = 0;
     COMPACT_CONTEXT CompactContext;
     YORILIB_COMPRESS_ALGORITHM CompressionAlgorithm;
     YORI_STRING Arg;
@@ -265,6 +269,9 @@ ENTRYPOINT(
             } else if (YoriLibCompareStringLitIns(&Arg, _T("b")) == 0) {
                 BasicEnumeration = TRUE;
                 ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("bg")) == 0) {
+                BackgroundPriority = TRUE;
+                ArgumentUnderstood = TRUE;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("c:lzx")) == 0) {
 
                 CompressionAlgorithm.EntireAlgorithm = 0;
@@ -294,6 +301,19 @@ ENTRYPOINT(
                 CompactContext.Compress = TRUE;
                 ArgumentUnderstood = TRUE;
 
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("j")) == 0) {
+                if (i + 1 < ArgC) {
+                    YORI_MAX_SIGNED_T LlThreadCount = 0;
+                    YORI_ALLOC_SIZE_T CharsConsumed = 0;
+                    if (YoriLibStringToNumber(&ArgV[i + 1], TRUE, &LlThreadCount, &CharsConsumed) &&
+                        CharsConsumed > 0 &&
+                        LlThreadCount > 0) {
+
+                        ThreadCount = (DWORD)LlThreadCount;
+                        ArgumentUnderstood = TRUE;
+                        i++;
+                    }
+                }
             } else if (YoriLibCompareStringLitIns(&Arg, _T("s")) == 0) {
                 CompactContext.Recursive = TRUE;
                 ArgumentUnderstood = TRUE;
@@ -338,6 +358,21 @@ ENTRYPOINT(
         CompactContext.CompressContext.Verbose = TRUE;
     }
 
+    if (BackgroundPriority) {
+        CompactContext.CompressContext.BackgroundPriority = TRUE;
+    }
+
+    //
+    //  Compression is CPU bound, so the pool is sized to the number of
+    //  processors.  A thread count can reduce this but not exceed it.
+    //
+
+    if (ThreadCount > 0 &&
+        ThreadCount < CompactContext.CompressContext.MaxThreads) {
+
+        CompactContext.CompressContext.MaxThreads = (YORI_ALLOC_SIZE_T)ThreadCount;
+    }
+
     //
     //  NTFS compression operates on directories and therefore this program
     //  really wants to see directories as well as files.  This unfortunately
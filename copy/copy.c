@@ -35,15 +35,18 @@ CHAR strCopyHelpText[] =
         "\n"
         "Copies one or more files.\n"
         "\n"
-        "COPY [-license] [-b] [-c:algorithm] [-ds size] [-l] [-n|-nt|-p] [-s] [-t] [-v]\n"
-        "      [-x exclude] <src>\n"
-        "COPY [-license] [-b] [-c:algorithm] [-ds size] [-l] [-n|-nt|-p] [-s] [-t] [-v]\n"
-        "      [-x exclude] <src> [<src> ...] <dest>\n"
+        "COPY [-license] [-b] [-c:algorithm] [-clone] [-delta] [-ds size] [-l]\n"
+        "      [-n|-nt|-p] [-s] [-t] [-v] [-j n] [-x exclude] <src>\n"
+        "COPY [-license] [-b] [-c:algorithm] [-clone] [-delta] [-ds size] [-l]\n"
+        "      [-n|-nt|-p] [-s] [-t] [-v] [-j n] [-x exclude] <src> [<src> ...] <dest>\n"
         "\n"
         "   -b             Use basic search criteria for files only\n"
         "   -c             Compress targets with specified algorithm.  Options are:\n"
         "                    lzx, ntfs, xp4k, xp8k, xp16k\n"
+        "   -clone         Require files to be cloned rather than copied\n"
+        "   -delta         Rewrite only changed blocks of existing files\n"
         "   -ds            The size of the device, ignored for files\n"
+        "   -j             Copy up to n files at the same time\n"
         "   -l             Copy links as links rather than contents\n"
         "   -n             Copy new or files whose size have changed only\n"
         "   -nt            Copy new or files whose size or timestamps have changed only\n"
@@ -67,6 +70,39 @@ CopyHelp(VOID)
     return TRUE;
 }
 
+/**
+ The maximum number of files that can be copied at the same time.
+ */
+#define COPY_MAX_WORKERS (64)
+
+/**
+ Files smaller than this size are considered small, and a worker will take
+ several of them from the queue at once.
+ */
+#define COPY_SMALL_FILE_SIZE (64 * 1024)
+
+/**
+ The maximum number of small files a worker takes from the queue at once.
+ */
+#define COPY_BATCH_COUNT (16)
+
+/**
+ The size of each buffer used when copying devices with overlapped I/O.
+ */
+#define COPY_PIPELINE_BUFFER_SIZE (4 * 1024 * 1024)
+
+/**
+ The number of buffers used when copying devices with overlapped I/O.  This
+ is the number of reads and writes that can be outstanding at once.
+ */
+#define COPY_PIPELINE_BUFFER_COUNT (4)
+
+/**
+ The size of each block compared when rewriting only the changed parts of
+ an existing file.
+ */
+#define COPY_DELTA_BLOCK_SIZE (1024 * 1024)
+
 /**
  A single item to exclude.  Note this can refer to multiple files.
  */
@@ -186,8 +222,106 @@ typedef struct _COPY_CONTEXT {
      If TRUE, output is generated for each object copied.
      */
     BOOLEAN Verbose;
+
+    /**
+     The number of files to copy at the same time.  If this is one, files
+     are copied on the main thread.
+     */
+    DWORD WorkerCount;
+
+    /**
+     The number of bytes of file data copied.  When worker threads are in
+     use, this is protected by Mutex.
+     */
+    LONGLONG BytesCopied;
+
+    /**
+     The number of bytes of file data cloned, meaning the destination shares
+     clusters with the source and no data was copied.  When worker threads
+     are in use, this is protected by Mutex.
+     */
+    LONGLONG BytesCloned;
+
+    /**
+     If TRUE, files must be cloned, and any file that cannot be cloned is
+     reported as an error rather than copied.
+     */
+    BOOLEAN RequireClone;
+
+    /**
+     Set to TRUE once the source volume has been found to be unable to
+     clone files, so that later files are copied without trying.
+     */
+    BOOLEAN CloneUnsupported;
+
+    /**
+     If TRUE, when the target file exists, it is compared with the source
+     and only blocks which differ are written.
+     */
+    BOOLEAN DeltaCopy;
+
+    /**
+     The number of bytes which were not written because the target already
+     contained the same data.  When worker threads are in use, this is
+     protected by Mutex.
+     */
+    LONGLONG BytesUnchanged;
+
+    /**
+     A mutex protecting statistics updated by worker threads.  This is NULL
+     if files are copied on the main thread.
+     */
+    HANDLE Mutex;
+
+    /**
+     A queue of files to copy on worker threads.  This is NULL if files are
+     copied on the main thread.
+     */
+    PYORILIB_WORK_QUEUE WorkQueue;
 } COPY_CONTEXT, *PCOPY_CONTEXT;
 
+/**
+ A single file to be copied by a worker thread.
+ */
+typedef struct _COPY_JOB {
+
+    /**
+     The work queue item for this job.  Small files are batchable, so a
+     worker takes several of them from the queue at once.
+     */
+    YORILIB_WORK_ITEM WorkItem;
+
+    /**
+     The fully qualified path to the source file.
+     */
+    YORI_STRING SourceFile;
+
+    /**
+     The fully qualified path to the destination file.
+     */
+    YORI_STRING DestFile;
+
+    /**
+     Information about the source file from enumeration.
+     */
+    WIN32_FIND_DATA FindData;
+
+    /**
+     TRUE if FindData is valid.
+     */
+    BOOLEAN FindDataValid;
+
+    /**
+     Set to TRUE if the file was copied successfully.
+     */
+    BOOLEAN Succeeded;
+
+    /**
+     Set to TRUE if the file was cloned rather than copied.
+     */
+    BOOLEAN Cloned;
+} COPY_JOB, *PCOPY_JOB;
+
 /**
  Add a new exclude criteria to the list.
 
@@ -553,6 +687,420 @@ CopyAsLink(
     return TRUE;
 }
 
+/**
+ A single buffer used when copying devices with overlapped I/O.  Each buffer
+ is read from the source and then written to the same offset in the
+ destination, and at most one operation is outstanding on it at a time.
+ */
+typedef struct _COPY_PIPELINE_BUFFER {
+
+    /**
+     The overlapped structure for the operation in progress.
+     */
+    OVERLAPPED Overlapped;
+
+    /**
+     Pointer to the data buffer, which is aligned for unbuffered I/O.
+     */
+    PVOID Buffer;
+
+    /**
+     The offset within the source and destination of this buffer.
+     */
+    LONGLONG FileOffset;
+
+    /**
+     The number of bytes of data in the buffer, excluding any padding used to
+     round the write up to a whole sector.
+     */
+    DWORD DataLength;
+
+    /**
+     TRUE if an operation is outstanding on this buffer.
+     */
+    BOOLEAN Pending;
+
+    /**
+     TRUE if the outstanding operation is a write, FALSE if it is a read.
+     */
+    BOOLEAN Writing;
+} COPY_PIPELINE_BUFFER, *PCOPY_PIPELINE_BUFFER;
+
+/**
+ Issue a read into a buffer from the next offset in the source.  If the end
+ of the source has already been reached, no read is issued.
+
+ @param CopyContext Pointer to the copy context, specifying device size.
+
+ @param SourceHandle Handle to the source, opened for overlapped I/O.
+
+ @param Buffer Pointer to the buffer to read into.
+
+ @param ReadOffset On input, the offset to read from.  On output, updated to
+        the offset for the next read.
+
+ @param EndOfSource On input, TRUE if the end of the source has been reached.
+        Updated to TRUE if this read finds the end of the source.
+
+ @return ERROR_SUCCESS to indicate the read was issued or not needed, or a
+         Win32 error code to indicate failure.
+ */
+DWORD
+CopyPipelineStartRead(
+    __in PCOPY_CONTEXT CopyContext,
+    __in HANDLE SourceHandle,
+    __in PCOPY_PIPELINE_BUFFER Buffer,
+    __inout PLONGLONG ReadOffset,
+    __inout PBOOLEAN EndOfSource
+    )
+{
+    DWORD BytesRead;
+    DWORD Err;
+
+    Buffer->Pending = FALSE;
+    if (*EndOfSource ||
+        (CopyContext->DeviceSize.QuadPart != 0 &&
+         *ReadOffset >= CopyContext->DeviceSize.QuadPart)) {
+
+        return ERROR_SUCCESS;
+    }
+
+    Buffer->FileOffset = *ReadOffset;
+    Buffer->Writing = FALSE;
+    Buffer->Overlapped.Offset = (DWORD)Buffer->FileOffset;
+    Buffer->Overlapped.OffsetHigh = (DWORD)(Buffer->FileOffset >> 32);
+    *ReadOffset = *ReadOffset + COPY_PIPELINE_BUFFER_SIZE;
+
+    if (!ReadFile(SourceHandle, Buffer->Buffer, COPY_PIPELINE_BUFFER_SIZE, &BytesRead, &Buffer->Overlapped)) {
+        Err = GetLastError();
+        if (Err == ERROR_HANDLE_EOF) {
+            *EndOfSource = TRUE;
+            return ERROR_SUCCESS;
+        }
+        if (Err != ERROR_IO_PENDING) {
+            return Err;
+        }
+    }
+
+    Buffer->Pending = TRUE;
+    return ERROR_SUCCESS;
+}
+
+/**
+ Copy data between two objects opened for unbuffered overlapped I/O.
+ Buffers are used in turn, so while one buffer is being written to the
+ destination, reads into the following buffers are in progress.
+
+ @param CopyContext Pointer to the copy context, specifying device size.
+
+ @param SourceFile Pointer to the source file/device name, used for errors.
+
+ @param DestFile Pointer to the destination file/device name, used for
+        errors.
+
+ @param SourceHandle Handle to the source, opened for unbuffered overlapped
+        I/O.
+
+ @param DestHandle Handle to the destination, opened for unbuffered
+        overlapped I/O.
+
+ @param BufferBase Pointer to COPY_PIPELINE_BUFFER_COUNT buffers of
+        COPY_PIPELINE_BUFFER_SIZE bytes, aligned for unbuffered I/O.
+
+ @param PadSize The size to round the final write up to.  This must divide
+        COPY_PIPELINE_BUFFER_SIZE.
+
+ @param DataCopied On successful completion, updated to the number of bytes
+        of data copied, excluding padding.
+
+ @param DataWritten On successful completion, updated to the number of bytes
+        written to the destination, including padding.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+CopyPipelinedDataMove(
+    __in PCOPY_CONTEXT CopyContext,
+    __in PYORI_STRING SourceFile,
+    __in PYORI_STRING DestFile,
+    __in HANDLE SourceHandle,
+    __in HANDLE DestHandle,
+    __in PVOID BufferBase,
+    __in DWORD PadSize,
+    __out PLONGLONG DataCopied,
+    __out PLONGLONG DataWritten
+    )
+{
+    COPY_PIPELINE_BUFFER Buffers[COPY_PIPELINE_BUFFER_COUNT];
+    PCOPY_PIPELINE_BUFFER Buffer;
+    LONGLONG ReadOffset;
+    LONGLONG TotalData;
+    LONGLONG TotalWritten;
+    DWORD BytesTransferred;
+    DWORD WriteLength;
+    DWORD PendingCount;
+    DWORD Index;
+    DWORD Err;
+    BOOLEAN EndOfSource;
+    BOOLEAN WriteFailed;
+    LPTSTR ErrText;
+
+    ZeroMemory(Buffers, sizeof(Buffers));
+    Err = ERROR_SUCCESS;
+    for (Index = 0; Index < COPY_PIPELINE_BUFFER_COUNT; Index++) {
+        Buffers[Index].Buffer = YoriLibAddToPointer(BufferBase, Index * COPY_PIPELINE_BUFFER_SIZE);
+        Buffers[Index].Overlapped.hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+        if (Buffers[Index].Overlapped.hEvent == NULL) {
+            Err = GetLastError();
+            break;
+        }
+    }
+
+    ReadOffset = 0;
+    TotalData = 0;
+    TotalWritten = 0;
+    PendingCount = 0;
+    EndOfSource = FALSE;
+    WriteFailed = FALSE;
+
+    if (Err == ERROR_SUCCESS) {
+        for (Index = 0; Index < COPY_PIPELINE_BUFFER_COUNT; Index++) {
+            Err = CopyPipelineStartRead(CopyContext, SourceHandle, &Buffers[Index], &ReadOffset, &EndOfSource);
+            if (Buffers[Index].Pending) {
+                PendingCount++;
+            }
+            if (Err != ERROR_SUCCESS) {
+                CancelIo(SourceHandle);
+                break;
+            }
+        }
+    }
+
+    //
+    //  Operations complete in the order buffers were issued, so process
+    //  buffers in turn.  A completed read is written to the destination at
+    //  the same offset, and a completed write means the buffer can be used
+    //  for the next read.  After a failure, keep going until all outstanding
+    //  operations have completed so the buffers can be freed.
+    //
+
+    Index = 0;
+    while (PendingCount > 0) {
+        Buffer = &Buffers[Index];
+        Index = (Index + 1) % COPY_PIPELINE_BUFFER_COUNT;
+        if (!Buffer->Pending) {
+            continue;
+        }
+
+        Buffer->Pending = FALSE;
+        PendingCount--;
+        if (!GetOverlappedResult(Buffer->Writing?DestHandle:SourceHandle, &Buffer->Overlapped, &BytesTransferred, TRUE)) {
+            if (Err != ERROR_SUCCESS) {
+                continue;
+            }
+            Err = GetLastError();
+            if (!Buffer->Writing && Err == ERROR_HANDLE_EOF) {
+                Err = ERROR_SUCCESS;
+                EndOfSource = TRUE;
+                continue;
+            }
+            WriteFailed = Buffer->Writing;
+            CancelIo(SourceHandle);
+            CancelIo(DestHandle);
+            continue;
+        }
+
+        if (Err != ERROR_SUCCESS) {
+            continue;
+        }
+
+        if (Buffer->Writing) {
+            TotalData = TotalData + Buffer->DataLength;
+            TotalWritten = TotalWritten + BytesTransferred;
+            Err = CopyPipelineStartRead(CopyContext, SourceHandle, Buffer, &ReadOffset, &EndOfSource);
+            if (Buffer->Pending) {
+                PendingCount++;
+            }
+            if (Err != ERROR_SUCCESS) {
+                CancelIo(SourceHandle);
+                CancelIo(DestHandle);
+            }
+            continue;
+        }
+
+        if (BytesTransferred < COPY_PIPELINE_BUFFER_SIZE) {
+            EndOfSource = TRUE;
+        }
+
+        if (CopyContext->DeviceSize.QuadPart != 0 &&
+            Buffer->FileOffset + BytesTransferred > CopyContext->DeviceSize.QuadPart) {
+
+            BytesTransferred = (DWORD)(CopyContext->DeviceSize.QuadPart - Buffer->FileOffset);
+        }
+
+        if (BytesTransferred == 0) {
+            continue;
+        }
+
+        //
+        //  Unbuffered writes must be a whole number of sectors, so round
+        //  up and zero fill.
+        //
+
+        Buffer->DataLength = BytesTransferred;
+        WriteLength = BytesTransferred;
+        if ((WriteLength % PadSize) != 0) {
+            WriteLength = WriteLength + PadSize - (WriteLength % PadSize);
+            ZeroMemory(YoriLibAddToPointer(Buffer->Buffer, BytesTransferred), WriteLength - BytesTransferred);
+        }
+
+        Buffer->Writing = TRUE;
+        if (!WriteFile(DestHandle, Buffer->Buffer, WriteLength, &BytesTransferred, &Buffer->Overlapped)) {
+            Err = GetLastError();
+            if (Err != ERROR_IO_PENDING) {
+                WriteFailed = TRUE;
+                CancelIo(SourceHandle);
+                continue;
+            }
+            Err = ERROR_SUCCESS;
+        }
+        Buffer->Pending = TRUE;
+        PendingCount++;
+    }
+
+    for (Index = 0; Index < COPY_PIPELINE_BUFFER_COUNT; Index++) {
+        if (Buffers[Index].Overlapped.hEvent != NULL) {
+            CloseHandle(Buffers[Index].Overlapped.hEvent);
+        }
+    }
+
+    if (Err != ERROR_SUCCESS) {
+        ErrText = YoriLibGetWinErrorText(Err);
+        if (WriteFailed) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Write to destination failed: %y: %s"), DestFile, ErrText);
+        } else {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Read from source failed: %y: %s"), SourceFile, ErrText);
+        }
+        YoriLibFreeWinErrorText(ErrText);
+        return FALSE;
+    }
+
+    *DataCopied = TotalData;
+    *DataWritten = TotalWritten;
+    return TRUE;
+}
+
+/**
+ Attempt to copy between two seekable objects using large unbuffered
+ overlapped I/O, so that reading from the source and writing to the
+ destination happen at the same time.  This requires opening additional
+ handles to the source and destination, which some objects may not allow.
+
+ @param CopyContext Pointer to the copy context, specifying device size.
+
+ @param SourceFile Pointer to the source file/device name.
+
+ @param DestFile Pointer to the destination file/device name.
+
+ @param DestHandle A synchronous handle to the destination, opened for write.
+        This is used to truncate padding from files after the copy.
+
+ @param SectorSize The sector size of the destination, or zero if it is not
+        known.
+
+ @param Result On return, if the copy was attempted, updated to TRUE to
+        indicate success or FALSE to indicate failure.
+
+ @return TRUE if the copy was attempted, FALSE if the objects could not be
+         opened for overlapped I/O and the caller should copy another way.
+ */
+__success(return)
+BOOL
+CopyTryPipelinedDataMove(
+    __in PCOPY_CONTEXT CopyContext,
+    __in PYORI_STRING SourceFile,
+    __in PYORI_STRING DestFile,
+    __in HANDLE DestHandle,
+    __in DWORD SectorSize,
+    __out PBOOL Result
+    )
+{
+    HANDLE PipeSourceHandle;
+    HANDLE PipeDestHandle;
+    PVOID BufferBase;
+    DWORD PadSize;
+    LONGLONG DataCopied;
+    LONGLONG DataWritten;
+    LARGE_INTEGER NewEnd;
+
+    //
+    //  Files have no sector size reported.  Round their writes up to a size
+    //  that satisfies any volume, and truncate afterwards.
+    //
+
+    PadSize = SectorSize;
+    if (PadSize == 0 || PadSize > COPY_PIPELINE_BUFFER_SIZE ||
+        (COPY_PIPELINE_BUFFER_SIZE % PadSize) != 0) {
+
+        PadSize = 4096;
+    }
+
+    PipeSourceHandle = CreateFile(SourceFile->StartOfString,
+                                  GENERIC_READ,
+                                  FILE_SHARE_READ|FILE_SHARE_WRITE|FILE_SHARE_DELETE,
+                                  NULL,
+                                  OPEN_EXISTING,
+                                  FILE_FLAG_OPEN_NO_RECALL|FILE_FLAG_BACKUP_SEMANTICS|FILE_FLAG_NO_BUFFERING|FILE_FLAG_OVERLAPPED,
+                                  NULL);
+
+    if (PipeSourceHandle == INVALID_HANDLE_VALUE) {
+        return FALSE;
+    }
+
+    PipeDestHandle = CreateFile(DestFile->StartOfString,
+                                GENERIC_WRITE,
+                                FILE_SHARE_READ|FILE_SHARE_WRITE|FILE_SHARE_DELETE,
+                                NULL,
+                                OPEN_EXISTING,
+                                FILE_FLAG_BACKUP_SEMANTICS|FILE_FLAG_NO_BUFFERING|FILE_FLAG_OVERLAPPED,
+                                NULL);
+
+    if (PipeDestHandle == INVALID_HANDLE_VALUE) {
+        CloseHandle(PipeSourceHandle);
+        return FALSE;
+    }
+
+    BufferBase = VirtualAlloc(NULL, COPY_PIPELINE_BUFFER_COUNT * COPY_PIPELINE_BUFFER_SIZE, MEM_COMMIT, PAGE_READWRITE);
+    if (BufferBase == NULL) {
+        CloseHandle(PipeSourceHandle);
+        CloseHandle(PipeDestHandle);
+        return FALSE;
+    }
+
+    *Result = CopyPipelinedDataMove(CopyContext, SourceFile, DestFile, PipeSourceHandle, PipeDestHandle, BufferBase, PadSize, &DataCopied, &DataWritten);
+
+    VirtualFree(BufferBase, 0, MEM_RELEASE);
+    CloseHandle(PipeSourceHandle);
+    CloseHandle(PipeDestHandle);
+
+    //
+    //  If the final write was padded, remove the padding.  This fails on
+    //  devices, which is fine, since they cannot be truncated anyway.
+    //
+
+    if (*Result && DataWritten > DataCopied && CopyContext->DeviceSize.QuadPart == 0) {
+        NewEnd.QuadPart = DataCopied;
+        if (SetFilePointer(DestHandle, NewEnd.LowPart, &NewEnd.HighPart, FILE_BEGIN) != INVALID_SET_FILE_POINTER ||
+            GetLastError() == NO_ERROR) {
+
+            SetEndOfFile(DestHandle);
+        }
+    }
+
+    return TRUE;
+}
+
 /**
  For objects that are not really files, copy can't use CopyFile, and instead
  falls back to this stupid thing of reading and writing.  Note this path
@@ -583,6 +1131,7 @@ CopyAsDumbDataMove(
     DWORD LastError;
     LPTSTR ErrText;
     LONGLONG TotalBytesCopied;
+    BOOL Result;
 
     SourceHandle = CreateFile(SourceFile->StartOfString,
                               GENERIC_READ,
@@ -630,13 +1179,28 @@ CopyAsDumbDataMove(
 
     SectorSize = YoriLibGetHandleSectorSize(DestHandle);
 
-    BufferSize = 64 * 1024;
-    if (!YoriLibIsSizeAllocatable(BufferSize)) {
-        BufferSize = 32 * 1024;
-    }
-    Buffer = YoriLibMalloc((YORI_ALLOC_SIZE_T)BufferSize);
-    if (Buffer == NULL) {
-        CloseHandle(SourceHandle);
+    //
+    //  If both objects are seekable, try to copy with large overlapped I/O
+    //  so reads and writes proceed in parallel.
+    //
+
+    Result = FALSE;
+    if (GetFileType(SourceHandle) == FILE_TYPE_DISK &&
+        GetFileType(DestHandle) == FILE_TYPE_DISK &&
+        CopyTryPipelinedDataMove(CopyContext, SourceFile, DestFile, DestHandle, SectorSize, &Result)) {
+
+        CloseHandle(SourceHandle);
+        CloseHandle(DestHandle);
+        return Result;
+    }
+
+    BufferSize = 64 * 1024;
+    if (!YoriLibIsSizeAllocatable(BufferSize)) {
+        BufferSize = 32 * 1024;
+    }
+    Buffer = YoriLibMalloc((YORI_ALLOC_SIZE_T)BufferSize);
+    if (Buffer == NULL) {
+        CloseHandle(SourceHandle);
         CloseHandle(DestHandle);
         return FALSE;
     }
@@ -748,6 +1312,634 @@ CopyTimestamps(
     return TRUE;
 }
 
+/**
+ Add a value to one of the statistics in the copy context.  If worker
+ threads are in use, this acquires the mutex protecting them.
+
+ @param CopyContext Pointer to the copy context.
+
+ @param Counter Pointer to the statistic within the copy context.
+
+ @param Value The value to add.
+ */
+VOID
+CopyAddToCounter(
+    __in PCOPY_CONTEXT CopyContext,
+    __inout PLONGLONG Counter,
+    __in LONGLONG Value
+    )
+{
+    if (CopyContext->Mutex != NULL) {
+        WaitForSingleObject(CopyContext->Mutex, INFINITE);
+        *Counter = *Counter + Value;
+        ReleaseMutex(CopyContext->Mutex);
+    } else {
+        *Counter = *Counter + Value;
+    }
+}
+
+/**
+ Wait for an overlapped operation to complete.
+
+ @param FileHandle Handle to the file the operation was issued on.
+
+ @param Overlapped Pointer to the overlapped structure for the operation.
+
+ @param IoStarted The result of the ReadFile or WriteFile call which started
+        the operation.
+
+ @param BytesTransferred On successful completion, updated to the number
+        of bytes transferred.  Reads at the end of the file complete
+        successfully with zero bytes.
+
+ @return ERROR_SUCCESS to indicate success, or a Win32 error code.
+ */
+DWORD
+CopyDeltaWaitForIo(
+    __in HANDLE FileHandle,
+    __in LPOVERLAPPED Overlapped,
+    __in BOOL IoStarted,
+    __out PDWORD BytesTransferred
+    )
+{
+    DWORD Err;
+
+    *BytesTransferred = 0;
+    if (!IoStarted) {
+        Err = GetLastError();
+        if (Err == ERROR_HANDLE_EOF) {
+            return ERROR_SUCCESS;
+        }
+        if (Err != ERROR_IO_PENDING) {
+            return Err;
+        }
+    }
+
+    if (!GetOverlappedResult(FileHandle, Overlapped, BytesTransferred, TRUE)) {
+        Err = GetLastError();
+        if (Err == ERROR_HANDLE_EOF) {
+            return ERROR_SUCCESS;
+        }
+        return Err;
+    }
+
+    return ERROR_SUCCESS;
+}
+
+/**
+ Update an existing target file to match the source by comparing each block
+ and writing only the blocks that differ.  Reads from the source and target
+ are issued together so they proceed in parallel.  On failure, the target
+ may be partially updated, and the caller is expected to copy the whole
+ file.
+
+ @param CopyContext Pointer to the copy context.
+
+ @param SourceFile Pointer to the fully qualified source file name.
+
+ @param DestFile Pointer to the fully qualified destination file name.
+
+ @return ERROR_SUCCESS to indicate success, or a Win32 error code.
+         ERROR_FILE_NOT_FOUND indicates that there is no target to update.
+ */
+DWORD
+CopyDeltaFile(
+    __in PCOPY_CONTEXT CopyContext,
+    __in PYORI_STRING SourceFile,
+    __in PYORI_STRING DestFile
+    )
+{
+    HANDLE SourceHandle;
+    HANDLE DestHandle;
+    OVERLAPPED SourceOverlapped;
+    OVERLAPPED DestOverlapped;
+    PUCHAR SourceBuffer;
+    PUCHAR DestBuffer;
+    FILETIME LastWriteTime;
+    LARGE_INTEGER SourceSize;
+    LARGE_INTEGER DestSize;
+    LARGE_INTEGER Offset;
+    LONGLONG BytesUnchanged;
+    DWORD SourceBytes;
+    DWORD DestBytes;
+    DWORD Err;
+    BOOL SourceStarted;
+    BOOL DestStarted;
+
+    SourceHandle = INVALID_HANDLE_VALUE;
+    DestHandle = INVALID_HANDLE_VALUE;
+    SourceBuffer = NULL;
+    ZeroMemory(&SourceOverlapped, sizeof(SourceOverlapped));
+    ZeroMemory(&DestOverlapped, sizeof(DestOverlapped));
+    BytesUnchanged = 0;
+
+    DestHandle = CreateFile(DestFile->StartOfString,
+                            GENERIC_READ | GENERIC_WRITE,
+                            FILE_SHARE_READ | FILE_SHARE_DELETE,
+                            NULL,
+                            OPEN_EXISTING,
+                            FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED,
+                            NULL);
+
+    if (DestHandle == INVALID_HANDLE_VALUE) {
+        Err = GetLastError();
+        goto Exit;
+    }
+
+    SourceHandle = CreateFile(SourceFile->StartOfString,
+                              GENERIC_READ,
+                              FILE_SHARE_READ | FILE_SHARE_DELETE,
+                              NULL,
+                              OPEN_EXISTING,
+                              FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OPEN_NO_RECALL | FILE_FLAG_OVERLAPPED | FILE_FLAG_SEQUENTIAL_SCAN,
+                              NULL);
+
+    if (SourceHandle == INVALID_HANDLE_VALUE) {
+        Err = GetLastError();
+        goto Exit;
+    }
+
+    SourceSize.LowPart = GetFileSize(SourceHandle, &SourceSize.HighPart);
+    if (SourceSize.LowPart == INVALID_FILE_SIZE && GetLastError() != NO_ERROR) {
+        Err = GetLastError();
+        goto Exit;
+    }
+
+    DestSize.LowPart = GetFileSize(DestHandle, &DestSize.HighPart);
+    if (DestSize.LowPart == INVALID_FILE_SIZE && GetLastError() != NO_ERROR) {
+        Err = GetLastError();
+        goto Exit;
+    }
+
+    if (!GetFileTime(SourceHandle, NULL, NULL, &LastWriteTime)) {
+        Err = GetLastError();
+        goto Exit;
+    }
+
+    SourceBuffer = YoriLibMalloc(2 * COPY_DELTA_BLOCK_SIZE);
+    if (SourceBuffer == NULL) {
+        Err = ERROR_NOT_ENOUGH_MEMORY;
+        goto Exit;
+    }
+    DestBuffer = SourceBuffer + COPY_DELTA_BLOCK_SIZE;
+
+    SourceOverlapped.hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+    DestOverlapped.hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+    if (SourceOverlapped.hEvent == NULL || DestOverlapped.hEvent == NULL) {
+        Err = GetLastError();
+        goto Exit;
+    }
+
+    Err = ERROR_SUCCESS;
+    Offset.QuadPart = 0;
+    while (Offset.QuadPart < SourceSize.QuadPart) {
+
+        SourceOverlapped.Offset = Offset.LowPart;
+        SourceOverlapped.OffsetHigh = Offset.HighPart;
+        SourceStarted = ReadFile(SourceHandle, SourceBuffer, COPY_DELTA_BLOCK_SIZE, &SourceBytes, &SourceOverlapped);
+
+        DestBytes = 0;
+        if (Offset.QuadPart < DestSize.QuadPart) {
+            DestOverlapped.Offset = Offset.LowPart;
+            DestOverlapped.OffsetHigh = Offset.HighPart;
+            DestStarted = ReadFile(DestHandle, DestBuffer, COPY_DELTA_BLOCK_SIZE, &DestBytes, &DestOverlapped);
+            Err = CopyDeltaWaitForIo(DestHandle, &DestOverlapped, DestStarted, &DestBytes);
+        }
+
+        //
+        //  Always wait for the source read, even if the target read failed,
+        //  so the buffer is not in use when it is freed.
+        //
+
+        if (Err == ERROR_SUCCESS) {
+            Err = CopyDeltaWaitForIo(SourceHandle, &SourceOverlapped, SourceStarted, &SourceBytes);
+        } else {
+            CopyDeltaWaitForIo(SourceHandle, &SourceOverlapped, SourceStarted, &SourceBytes);
+        }
+
+        if (Err != ERROR_SUCCESS || SourceBytes == 0) {
+            break;
+        }
+
+        if (SourceBytes == DestBytes &&
+            memcmp(SourceBuffer, DestBuffer, SourceBytes) == 0) {
+
+            BytesUnchanged = BytesUnchanged + SourceBytes;
+        } else {
+            DestOverlapped.Offset = Offset.LowPart;
+            DestOverlapped.OffsetHigh = Offset.HighPart;
+            DestStarted = WriteFile(DestHandle, SourceBuffer, SourceBytes, &DestBytes, &DestOverlapped);
+            Err = CopyDeltaWaitForIo(DestHandle, &DestOverlapped, DestStarted, &DestBytes);
+            if (Err != ERROR_SUCCESS) {
+                break;
+            }
+        }
+
+        Offset.QuadPart = Offset.QuadPart + SourceBytes;
+    }
+
+    if (Err != ERROR_SUCCESS) {
+        goto Exit;
+    }
+
+    //
+    //  Trim any data beyond the end of the source, and apply the source
+    //  timestamp as CopyFile would so that later runs of -n or -nt don't
+    //  consider the file changed.
+    //
+
+    if (DestSize.QuadPart != Offset.QuadPart) {
+        if (SetFilePointer(DestHandle, Offset.LowPart, &Offset.HighPart, FILE_BEGIN) == INVALID_SET_FILE_POINTER &&
+            GetLastError() != NO_ERROR) {
+
+            Err = GetLastError();
+            goto Exit;
+        }
+        if (!SetEndOfFile(DestHandle)) {
+            Err = GetLastError();
+            goto Exit;
+        }
+    }
+
+    SetFileTime(DestHandle, NULL, NULL, &LastWriteTime);
+    CopyAddToCounter(CopyContext, &CopyContext->BytesUnchanged, BytesUnchanged);
+
+Exit:
+    if (SourceOverlapped.hEvent != NULL) {
+        CloseHandle(SourceOverlapped.hEvent);
+    }
+    if (DestOverlapped.hEvent != NULL) {
+        CloseHandle(DestOverlapped.hEvent);
+    }
+    if (SourceBuffer != NULL) {
+        YoriLibFree(SourceBuffer);
+    }
+    if (SourceHandle != INVALID_HANDLE_VALUE) {
+        CloseHandle(SourceHandle);
+    }
+    if (DestHandle != INVALID_HANDLE_VALUE) {
+        CloseHandle(DestHandle);
+    }
+    return Err;
+}
+
+/**
+ Copy the contents of a file, and apply compression and timestamps as
+ requested by the user.  Where the file system allows, the file is cloned
+ so that no data is copied.  This may be called on the main thread or on a
+ worker thread.
+
+ @param CopyContext Pointer to the copy context.
+
+ @param SourceFile Pointer to the fully qualified source file name.
+
+ @param DestFile Pointer to the fully qualified destination file name.
+
+ @param FileInfo Optionally points to information about the source file from
+        enumeration.
+
+ @param Cloned On successful completion, set to TRUE if the file was cloned
+        rather than copied.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+CopyFileContents(
+    __in PCOPY_CONTEXT CopyContext,
+    __in PYORI_STRING SourceFile,
+    __in PYORI_STRING DestFile,
+    __in_opt PWIN32_FIND_DATA FileInfo,
+    __out PBOOLEAN Cloned
+    )
+{
+    YORI_STRING HumanSourcePath;
+    YORI_STRING HumanDestPath;
+    PYORI_STRING SourceNameToDisplay;
+    PYORI_STRING DestNameToDisplay;
+    DWORD LastError;
+    LPTSTR ErrText;
+    BOOL Result;
+
+    Result = TRUE;
+    *Cloned = FALSE;
+    LastError = ERROR_NOT_SUPPORTED;
+
+    //
+    //  If the target exists, try to update it in place.  If this fails for
+    //  any reason, copy the whole file.
+    //
+
+    if (CopyContext->DeltaCopy && !CopyContext->RequireClone) {
+        LastError = CopyDeltaFile(CopyContext, SourceFile, DestFile);
+    }
+
+    //
+    //  Compression isn't supported on volumes that can clone, so don't try.
+    //  If cloning is not required and the source volume can't clone, or
+    //  the destination is on a different volume, stop trying for later
+    //  files.
+    //
+
+    if (LastError != ERROR_SUCCESS &&
+        !CopyContext->CompressDest &&
+        (CopyContext->RequireClone || !CopyContext->CloneUnsupported)) {
+
+        LastError = YoriLibCloneFile(SourceFile, DestFile);
+        if (LastError == ERROR_SUCCESS) {
+            *Cloned = TRUE;
+        } else if (LastError == ERROR_NOT_SUPPORTED) {
+            CopyContext->CloneUnsupported = TRUE;
+        }
+    }
+
+    if (CopyContext->RequireClone) {
+        if (LastError != ERROR_SUCCESS) {
+            YoriLibInitEmptyString(&HumanSourcePath);
+            YoriLibInitEmptyString(&HumanDestPath);
+            SourceNameToDisplay = SourceFile;
+            DestNameToDisplay = DestFile;
+            if (YoriLibUnescapePath(SourceFile, &HumanSourcePath)) {
+                SourceNameToDisplay = &HumanSourcePath;
+            }
+            if (YoriLibUnescapePath(DestFile, &HumanDestPath)) {
+                DestNameToDisplay = &HumanDestPath;
+            }
+            ErrText = YoriLibGetWinErrorText(LastError);
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Clone failed: %y to %y: %s"), SourceNameToDisplay, DestNameToDisplay, ErrText);
+            YoriLibFreeWinErrorText(ErrText);
+            YoriLibFreeStringContents(&HumanSourcePath);
+            YoriLibFreeStringContents(&HumanDestPath);
+            return FALSE;
+        }
+    } else if (LastError != ERROR_SUCCESS) {
+        LastError = YoriLibCopyFile(SourceFile, DestFile);
+    }
+
+    if (LastError != ERROR_SUCCESS) {
+
+        //
+        //  If it failed with an error indicating CopyFile couldn't
+        //  handle it, fall back to dumb data copy.  Note that this
+        //  function will output its own errors, so from this point,
+        //  error handling is over.
+        //
+
+        if (LastError == ERROR_INVALID_PARAMETER) {
+            Result = CopyAsDumbDataMove(CopyContext, SourceFile, DestFile);
+        } else {
+            YoriLibInitEmptyString(&HumanSourcePath);
+            YoriLibInitEmptyString(&HumanDestPath);
+            SourceNameToDisplay = SourceFile;
+            DestNameToDisplay = DestFile;
+            if (YoriLibUnescapePath(SourceFile, &HumanSourcePath)) {
+                SourceNameToDisplay = &HumanSourcePath;
+            }
+            if (YoriLibUnescapePath(DestFile, &HumanDestPath)) {
+                DestNameToDisplay = &HumanDestPath;
+            }
+            ErrText = YoriLibGetWinErrorText(LastError);
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("CopyFile failed: %y to %y: %s"), SourceNameToDisplay, DestNameToDisplay, ErrText);
+            YoriLibFreeWinErrorText(ErrText);
+            YoriLibFreeStringContents(&HumanSourcePath);
+            YoriLibFreeStringContents(&HumanDestPath);
+            Result = FALSE;
+        }
+    }
+
+    if (CopyContext->CompressDest) {
+
+        YoriLibCompressFileInBackground(&CopyContext->CompressContext, DestFile);
+    }
+
+    if (CopyContext->CopyTimestamps && FileInfo != NULL) {
+        CopyTimestamps(FileInfo, DestFile);
+    }
+
+    return Result;
+}
+
+/**
+ Copy a file that has been found by the main thread.  This is invoked on a
+ worker thread.
+
+ @param Context Pointer to the copy context.
+
+ @param WorkerContext Unused.
+
+ @param Item Pointer to the work queue item within the job to process.
+
+ @return TRUE to indicate the worker should continue processing jobs.
+ */
+BOOLEAN
+CopyExecuteJob(
+    __in PVOID Context,
+    __in PVOID WorkerContext,
+    __in PYORILIB_WORK_ITEM Item
+    )
+{
+    PCOPY_CONTEXT CopyContext;
+    PCOPY_JOB Job;
+
+    UNREFERENCED_PARAMETER(WorkerContext);
+
+    CopyContext = (PCOPY_CONTEXT)Context;
+    Job = CONTAINING_RECORD(Item, COPY_JOB, WorkItem);
+
+    Job->Succeeded = (BOOLEAN)CopyFileContents(CopyContext, &Job->SourceFile, &Job->DestFile, Job->FindDataValid?&Job->FindData:NULL, &Job->Cloned);
+    return TRUE;
+}
+
+/**
+ Record the result of a job which has been completed by a worker thread and
+ free it.  This is invoked on the main thread.
+
+ @param Context Pointer to the copy context.
+
+ @param Item Pointer to the work queue item within the completed job.
+ */
+VOID
+CopyCompleteJob(
+    __in PVOID Context,
+    __in PYORILIB_WORK_ITEM Item
+    )
+{
+    PCOPY_CONTEXT CopyContext;
+    PCOPY_JOB Job;
+    LARGE_INTEGER FileSize;
+    PLONGLONG ByteCounter;
+
+    CopyContext = (PCOPY_CONTEXT)Context;
+    Job = CONTAINING_RECORD(Item, COPY_JOB, WorkItem);
+
+    if (Job->Succeeded && Job->FindDataValid) {
+        FileSize.LowPart = Job->FindData.nFileSizeLow;
+        FileSize.HighPart = Job->FindData.nFileSizeHigh;
+        ByteCounter = &CopyContext->BytesCopied;
+        if (Job->Cloned) {
+            ByteCounter = &CopyContext->BytesCloned;
+        }
+        CopyAddToCounter(CopyContext, ByteCounter, FileSize.QuadPart);
+    }
+
+    YoriLibFree(Job);
+}
+
+/**
+ Wait for jobs to complete until no more than a specified number remain
+ outstanding.
+
+ @param CopyContext Pointer to the copy context.
+
+ @param JobsToLeaveOutstanding The number of jobs which may remain incomplete
+        when this function returns.  Zero waits for all jobs to complete.
+ */
+VOID
+CopyCompleteJobs(
+    __in PCOPY_CONTEXT CopyContext,
+    __in DWORD JobsToLeaveOutstanding
+    )
+{
+    if (CopyContext->WorkQueue == NULL) {
+        return;
+    }
+
+    YoriLibWorkQueueComplete(CopyContext->WorkQueue, JobsToLeaveOutstanding, INFINITE);
+}
+
+/**
+ Queue a file to be copied by a worker thread.
+
+ @param CopyContext Pointer to the copy context.
+
+ @param SourceFile Pointer to the fully qualified source file name.
+
+ @param DestFile Pointer to the fully qualified destination file name.
+
+ @param FileInfo Optionally points to information about the source file from
+        enumeration.
+
+ @return TRUE to indicate the job was queued, FALSE if it could not be.
+ */
+BOOL
+CopyQueueFile(
+    __in PCOPY_CONTEXT CopyContext,
+    __in PYORI_STRING SourceFile,
+    __in PYORI_STRING DestFile,
+    __in_opt PWIN32_FIND_DATA FileInfo
+    )
+{
+    PCOPY_JOB Job;
+    YORI_MAX_UNSIGNED_T BytesNeeded;
+
+    BytesNeeded = sizeof(COPY_JOB);
+    BytesNeeded += ((YORI_MAX_UNSIGNED_T)SourceFile->LengthInChars + 1) * sizeof(TCHAR);
+    BytesNeeded += ((YORI_MAX_UNSIGNED_T)DestFile->LengthInChars + 1) * sizeof(TCHAR);
+
+    if (!YoriLibIsSizeAllocatable(BytesNeeded)) {
+        return FALSE;
+    }
+
+    Job = YoriLibMalloc((YORI_ALLOC_SIZE_T)BytesNeeded);
+    if (Job == NULL) {
+        return FALSE;
+    }
+
+    YoriLibInitEmptyString(&Job->SourceFile);
+    Job->SourceFile.StartOfString = (LPTSTR)(Job + 1);
+    Job->SourceFile.LengthInChars = SourceFile->LengthInChars;
+    Job->SourceFile.LengthAllocated = SourceFile->LengthInChars + 1;
+    memcpy(Job->SourceFile.StartOfString, SourceFile->StartOfString, SourceFile->LengthInChars * sizeof(TCHAR));
+    Job->SourceFile.StartOfString[Job->SourceFile.LengthInChars] = '\0';
+
+    YoriLibInitEmptyString(&Job->DestFile);
+    Job->DestFile.StartOfString = Job->SourceFile.StartOfString + Job->SourceFile.LengthAllocated;
+    Job->DestFile.LengthInChars = DestFile->LengthInChars;
+    Job->DestFile.LengthAllocated = DestFile->LengthInChars + 1;
+    memcpy(Job->DestFile.StartOfString, DestFile->StartOfString, DestFile->LengthInChars * sizeof(TCHAR));
+    Job->DestFile.StartOfString[Job->DestFile.LengthInChars] = '\0';
+
+    YoriLibWorkQueueInitializeItem(&Job->WorkItem);
+    Job->FindDataValid = FALSE;
+    Job->Succeeded = FALSE;
+    Job->Cloned = FALSE;
+    if (FileInfo != NULL) {
+        memcpy(&Job->FindData, FileInfo, sizeof(WIN32_FIND_DATA));
+        Job->FindDataValid = TRUE;
+        if (FileInfo->nFileSizeHigh == 0 &&
+            FileInfo->nFileSizeLow < COPY_SMALL_FILE_SIZE) {
+
+            Job->WorkItem.Batchable = TRUE;
+        }
+    }
+
+    YoriLibWorkQueueSubmit(CopyContext->WorkQueue, &Job->WorkItem);
+
+    //
+    //  Limit the amount of work that is queued so that memory use is
+    //  bounded when copying a large tree.
+    //
+
+    CopyCompleteJobs(CopyContext, CopyContext->WorkerCount * COPY_BATCH_COUNT * 2);
+    return TRUE;
+}
+
+/**
+ Create the worker threads used to copy files.
+
+ @param CopyContext Pointer to the copy context indicating the number of
+        workers to create.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+CopyStartWorkers(
+    __in PCOPY_CONTEXT CopyContext
+    )
+{
+    DWORD Index;
+
+    CopyContext->Mutex = CreateMutex(NULL, FALSE, NULL);
+    if (CopyContext->Mutex == NULL) {
+        return FALSE;
+    }
+
+    CopyContext->WorkQueue = YoriLibWorkQueueCreate(0, COPY_BATCH_COUNT, CopyExecuteJob, CopyCompleteJob, CopyContext);
+    if (CopyContext->WorkQueue == NULL) {
+        return FALSE;
+    }
+
+    for (Index = 0; Index < CopyContext->WorkerCount; Index++) {
+        if (!YoriLibWorkQueueAddWorker(CopyContext->WorkQueue, NULL)) {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+/**
+ Wait for all queued files to be copied, terminate worker threads, and free
+ the resources used to communicate with them.
+
+ @param CopyContext Pointer to the copy context.
+ */
+VOID
+CopyStopWorkers(
+    __in PCOPY_CONTEXT CopyContext
+    )
+{
+    if (CopyContext->WorkQueue != NULL) {
+        YoriLibWorkQueueDestroy(CopyContext->WorkQueue);
+        CopyContext->WorkQueue = NULL;
+    }
+
+    if (CopyContext->Mutex != NULL) {
+        CloseHandle(CopyContext->Mutex);
+        CopyContext->Mutex = NULL;
+    }
+}
+
 /**
  A callback that is invoked when a file is found that matches a search criteria
  specified in the set of strings to enumerate.
@@ -785,8 +1977,13 @@ CopyFileFoundCallback(
     YORI_ALLOC_SIZE_T SlashesFound;
     YORI_ALLOC_SIZE_T Index;
     DWORD LastError;
+    LARGE_INTEGER FileSize;
+    PLONGLONG ByteCounter;
+    BOOLEAN FileCopied;
+    BOOLEAN Cloned;
 
     CopyContext->FilesFoundThisArg++;
+    FileCopied = FALSE;
 
     ASSERT(YoriLibIsStringNullTerminated(FilePath));
 
@@ -882,43 +2079,33 @@ CopyFileFoundCallback(
         } else if (CopyContext->DestinationIsDevice || YoriLibIsFileNameDeviceName(FilePath)) {
             CopyAsDumbDataMove(CopyContext, FilePath, &FullDest);
         } else {
-            LastError = YoriLibCopyFile(FilePath, &FullDest);
-            if (LastError != ERROR_SUCCESS) {
-
-                //
-                //  If it failed with an error indicating CopyFile couldn't
-                //  handle it, fall back to dumb data copy.  Note that this
-                //  function will output its own errors, so from this point,
-                //  error handling is over.
-                //
-
-                if (LastError == ERROR_INVALID_PARAMETER) {
-                    CopyAsDumbDataMove(CopyContext, FilePath, &FullDest);
-                } else {
-                    LPTSTR ErrText = YoriLibGetWinErrorText(LastError);
-                    if (SourceNameToDisplay != &HumanSourcePath) {
-                        if (YoriLibUnescapePath(FilePath, &HumanSourcePath)) {
-                            SourceNameToDisplay = &HumanSourcePath;
-                        }
-                    }
-                    if (DestNameToDisplay != &HumanDestPath) {
-                        if (YoriLibUnescapePath(&FullDest, &HumanDestPath)) {
-                            DestNameToDisplay = &HumanDestPath;
-                        }
-                    }
-                    YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("CopyFile failed: %y to %y: %s"), SourceNameToDisplay, DestNameToDisplay, ErrText);
-                    YoriLibFreeWinErrorText(ErrText);
-                }
-            }
 
-            if (CopyContext->CompressDest) {
+            //
+            //  Copy files on worker threads if requested.  Directories are
+            //  returned before their contents and are created above, on
+            //  this thread, so the parent of any queued file exists.
+            //
+
+            FileCopied = TRUE;
+            if (CopyContext->WorkQueue == NULL ||
+                !CopyQueueFile(CopyContext, FilePath, &FullDest, FileInfo)) {
 
-                YoriLibCompressFileInBackground(&CopyContext->CompressContext, &FullDest);
+                if (CopyFileContents(CopyContext, FilePath, &FullDest, FileInfo, &Cloned) &&
+                    FileInfo != NULL) {
+
+                    FileSize.LowPart = FileInfo->nFileSizeLow;
+                    FileSize.HighPart = FileInfo->nFileSizeHigh;
+                    ByteCounter = &CopyContext->BytesCopied;
+                    if (Cloned) {
+                        ByteCounter = &CopyContext->BytesCloned;
+                    }
+                    CopyAddToCounter(CopyContext, ByteCounter, FileSize.QuadPart);
+                }
             }
         }
     }
 
-    if (CopyContext->CopyTimestamps && FileInfo != NULL) {
+    if (CopyContext->CopyTimestamps && FileInfo != NULL && !FileCopied) {
         CopyTimestamps(FileInfo, &FullDest);
     }
 
@@ -941,6 +2128,7 @@ CopyFreeCopyContext(
     __in PCOPY_CONTEXT CopyContext
     )
 {
+    CopyStopWorkers(CopyContext);
     YoriLibFreeCompressContext(&CopyContext->CompressContext);
     YoriLibFreeStringContents(&CopyContext->Dest);
     CopyFreeExcludes(CopyContext);
@@ -987,12 +2175,22 @@ ENTRYPOINT(
     COPY_CONTEXT CopyContext;
     YORILIB_COMPRESS_ALGORITHM CompressionAlgorithm;
     YORI_STRING Arg;
+    YORI_MAX_SIGNED_T Temp;
+    YORI_ALLOC_SIZE_T CharsConsumed;
+    LONGLONG StartTime;
+    LONGLONG ElapsedMs;
+    LARGE_INTEGER Rate;
+    YORI_STRING SizeString;
+    YORI_STRING RateString;
+    TCHAR SizeStringBuffer[6];
+    TCHAR RateStringBuffer[6];
 
     FileCount = 0;
     Recursive = FALSE;
     BasicEnumeration = FALSE;
     ZeroMemory(&CopyContext, sizeof(CopyContext));
     CompressionAlgorithm.EntireAlgorithm = 0;
+    CopyContext.WorkerCount = 1;
 
     YoriLibInitializeListHead(&CopyContext.ExcludeList);
 
@@ -1017,6 +2215,12 @@ ENTRYPOINT(
                 CompressionAlgorithm.WofAlgorithm = FILE_PROVIDER_COMPRESSION_XPRESS16K;
                 CopyContext.CompressDest = TRUE;
                 ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("clone")) == 0) {
+                CopyContext.RequireClone = TRUE;
+                ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("delta")) == 0) {
+                CopyContext.DeltaCopy = TRUE;
+                ArgumentUnderstood = TRUE;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("ds")) == 0) {
                 if (i + 1 < ArgC) {
                     CopyContext.DeviceSize = YoriLibStringToFileSize(&ArgV[i + 1]);
@@ -1050,6 +2254,21 @@ ENTRYPOINT(
                 CompressionAlgorithm.WofAlgorithm = FILE_PROVIDER_COMPRESSION_XPRESS16K;
                 CopyContext.CompressDest = TRUE;
                 ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("j")) == 0) {
+                if (i + 1 < ArgC) {
+                    if (YoriLibStringToNumber(&ArgV[i + 1], TRUE, &Temp, &CharsConsumed) &&
+                        CharsConsumed > 0) {
+
+                        if (Temp < 1) {
+                            Temp = 1;
+                        } else if (Temp > COPY_MAX_WORKERS) {
+                            Temp = COPY_MAX_WORKERS;
+                        }
+                        CopyContext.WorkerCount = (DWORD)Temp;
+                        ArgumentUnderstood = TRUE;
+                        i++;
+                    }
+                }
             } else if (YoriLibCompareStringLitIns(&Arg, _T("l")) == 0) {
                 CopyContext.CopyAsLinks = TRUE;
                 ArgumentUnderstood = TRUE;
@@ -1154,6 +2373,12 @@ ENTRYPOINT(
         }
     }
 
+    if (CopyContext.RequireClone && CopyContext.CompressDest) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("copy: cloned files cannot be compressed\n"));
+        CopyFreeCopyContext(&CopyContext);
+        return EXIT_FAILURE;
+    }
+
     if (CopyContext.CompressDest) {
         if (!YoriLibInitializeCompressContext(&CopyContext.CompressContext, CompressionAlgorithm)) {
             CopyFreeCopyContext(&CopyContext);
@@ -1168,8 +2393,17 @@ ENTRYPOINT(
     YoriLibCancelEnable(FALSE);
 #endif
 
+    if (CopyContext.WorkerCount > 1) {
+        if (!CopyStartWorkers(&CopyContext)) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("copy: could not create worker threads\n"));
+            CopyFreeCopyContext(&CopyContext);
+            return EXIT_FAILURE;
+        }
+    }
+
     CopyContext.FilesCopied = 0;
     FilesProcessed = 0;
+    StartTime = YoriLibGetSystemTimeAsInteger();
 
     for (i = FirstFileArg; i <= LastFileArg; i++) {
         if (!YoriLibIsCommandLineOption(&ArgV[i], &Arg)) {
@@ -1222,6 +2456,59 @@ ENTRYPOINT(
         }
     }
 
+    CopyStopWorkers(&CopyContext);
+
+    if ((CopyContext.Verbose || CopyContext.RequireClone) &&
+        CopyContext.BytesCloned > 0) {
+
+        YoriLibInitEmptyString(&SizeString);
+        SizeString.StartOfString = SizeStringBuffer;
+        SizeString.LengthAllocated = sizeof(SizeStringBuffer)/sizeof(SizeStringBuffer[0]);
+        YoriLibInitEmptyString(&RateString);
+        RateString.StartOfString = RateStringBuffer;
+        RateString.LengthAllocated = sizeof(RateStringBuffer)/sizeof(RateStringBuffer[0]);
+
+        Rate.QuadPart = CopyContext.BytesCloned;
+        YoriLibFileSizeToString(&SizeString, &Rate);
+        Rate.QuadPart = CopyContext.BytesCopied;
+        YoriLibFileSizeToString(&RateString, &Rate);
+
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("Cloned %y, copied %y\n"), &SizeString, &RateString);
+    }
+
+    if (CopyContext.Verbose && CopyContext.BytesUnchanged > 0) {
+
+        YoriLibInitEmptyString(&SizeString);
+        SizeString.StartOfString = SizeStringBuffer;
+        SizeString.LengthAllocated = sizeof(SizeStringBuffer)/sizeof(SizeStringBuffer[0]);
+
+        Rate.QuadPart = CopyContext.BytesUnchanged;
+        YoriLibFileSizeToString(&SizeString, &Rate);
+
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("Skipped writing %y of unchanged data\n"), &SizeString);
+    }
+
+    if (CopyContext.Verbose && CopyContext.BytesCopied > 0) {
+        ElapsedMs = (YoriLibGetSystemTimeAsInteger() - StartTime) / 10000;
+        if (ElapsedMs <= 0) {
+            ElapsedMs = 1;
+        }
+
+        YoriLibInitEmptyString(&SizeString);
+        SizeString.StartOfString = SizeStringBuffer;
+        SizeString.LengthAllocated = sizeof(SizeStringBuffer)/sizeof(SizeStringBuffer[0]);
+        YoriLibInitEmptyString(&RateString);
+        RateString.StartOfString = RateStringBuffer;
+        RateString.LengthAllocated = sizeof(RateStringBuffer)/sizeof(RateStringBuffer[0]);
+
+        Rate.QuadPart = CopyContext.BytesCopied;
+        YoriLibFileSizeToString(&SizeString, &Rate);
+        Rate.QuadPart = CopyContext.BytesCopied / ElapsedMs * 1000;
+        YoriLibFileSizeToString(&RateString, &Rate);
+
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("Copied %y in %lli.%03i seconds, %y per second\n"), &SizeString, ElapsedMs / 1000, (int)(ElapsedMs % 1000), &RateString);
+    }
+
     Result = EXIT_SUCCESS;
 
     if (CopyContext.FilesCopied == 0) {
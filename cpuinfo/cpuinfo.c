@@ -37,10 +37,15 @@ CHAR strCpuInfoHelpText[] =
         "Display cpu topology information.\n"
         "\n"
         "CPUINFO [-license] [-a] [-c] [-g] [-n] [-s] [-w ms] [<fmt>]\n"
+        "CPUINFO -i ms [-count n] [-csv]\n"
         "\n"
         "   -a             Display all information\n"
         "   -c             Display information about processor cores\n"
+        "   -count n       Stop after displaying n samples\n"
+        "   -csv           Display samples in CSV format\n"
         "   -g             Display information about processor groups\n"
+        "   -i ms          Continuously display utilization of each processor, group\n"
+        "                    and NUMA node, sampled at the specified interval\n"
         "   -n             Display information about NUMA nodes\n"
         "   -s             Display information about processor sockets\n"
         "   -w ms          Wait time to measure CPU utilization\n"
@@ -1027,6 +1032,590 @@ CpuInfoLoadAndUpconvertProcessorInfo(
     return TRUE;
 }
 
+/**
+ The maximum number of logical processors within a single processor group.
+ */
+#define CPUINFO_PROCESSORS_PER_GROUP (64)
+
+/**
+ The processors contained within a single NUMA node.
+ */
+typedef struct _CPUINFO_NUMA_NODE {
+
+    /**
+     The number of the NUMA node.
+     */
+    DWORD NodeNumber;
+
+    /**
+     The group and set of processors within the group that form this node.
+     */
+    YORI_PROCESSOR_GROUP_AFFINITY GroupMask;
+
+} CPUINFO_NUMA_NODE, *PCPUINFO_NUMA_NODE;
+
+/**
+ Context describing continuous sampling of processor utilization.
+ */
+typedef struct _CPUINFO_SAMPLE_CONTEXT {
+
+    /**
+     The time between samples, in milliseconds.
+     */
+    DWORD Interval;
+
+    /**
+     The number of samples to display, or zero to display samples until
+     the operation is cancelled.
+     */
+    DWORD SampleCount;
+
+    /**
+     TRUE if output should be in CSV form, FALSE if it should be in a form
+     intended for humans.
+     */
+    BOOLEAN CsvOutput;
+
+    /**
+     The number of processor groups in the system.
+     */
+    WORD GroupCount;
+
+    /**
+     An array of masks, one per processor group, describing the processors
+     that are active within each group.
+     */
+    PDWORD_PTR GroupMask;
+
+    /**
+     The number of NUMA nodes in the system.
+     */
+    DWORD NumaNodeCount;
+
+    /**
+     An array of NUMA nodes describing the processors within each node.
+     */
+    PCPUINFO_NUMA_NODE NumaNodes;
+
+    /**
+     Two arrays of processor times, each containing
+     CPUINFO_PROCESSORS_PER_GROUP entries for each processor group.  One
+     contains the most recent sample and the other the sample before it.
+     */
+    PYORI_SYSTEM_PROCESSOR_PERFORMANCE_INFORMATION Samples[2];
+
+    /**
+     The index within Samples of the most recent sample.
+     */
+    DWORD CurrentSample;
+
+    /**
+     A buffer used to construct each line of output, so that each sample is
+     written with a single call.
+     */
+    YORI_STRING Line;
+
+} CPUINFO_SAMPLE_CONTEXT, *PCPUINFO_SAMPLE_CONTEXT;
+
+//
+//  As above, older analyzers believe walking the group array is walking off
+//  the end of the buffer.
+//
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1500) && (_MSC_VER <= 1600)
+#pragma warning(push)
+#pragma warning(disable: 6385)
+#endif
+
+/**
+ Populate the sample context with the processor groups and NUMA nodes
+ described by the topology information, and allocate buffers used to
+ capture samples.
+
+ @param CpuInfoContext Pointer to the context containing processor layout.
+
+ @param SampleContext Pointer to the sample context to initialize.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+CpuInfoInitializeSampling(
+    __in PCPUINFO_CONTEXT CpuInfoContext,
+    __inout PCPUINFO_SAMPLE_CONTEXT SampleContext
+    )
+{
+    PYORI_SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX Entry;
+    DWORD CurrentOffset = 0;
+    DWORD NodeIndex;
+    WORD GroupIndex;
+    YORI_ALLOC_SIZE_T SampleBytes;
+    YORI_ALLOC_SIZE_T LineLength;
+
+    SampleContext->NumaNodeCount = (DWORD)CpuInfoContext->NumaNodeCount.QuadPart;
+    if (SampleContext->NumaNodeCount > 0) {
+        SampleContext->NumaNodes = YoriLibMalloc((YORI_ALLOC_SIZE_T)(SampleContext->NumaNodeCount * sizeof(CPUINFO_NUMA_NODE)));
+        if (SampleContext->NumaNodes == NULL) {
+            return FALSE;
+        }
+    }
+
+    NodeIndex = 0;
+    Entry = CpuInfoContext->ProcInfo;
+
+    while (Entry != NULL) {
+
+        if (Entry->Relationship == YoriProcessorRelationGroup &&
+            SampleContext->GroupMask == NULL &&
+            Entry->u.Group.ActiveGroupCount > 0) {
+
+            SampleContext->GroupCount = Entry->u.Group.ActiveGroupCount;
+            SampleContext->GroupMask = YoriLibMalloc((YORI_ALLOC_SIZE_T)(SampleContext->GroupCount * sizeof(DWORD_PTR)));
+            if (SampleContext->GroupMask == NULL) {
+                return FALSE;
+            }
+
+            for (GroupIndex = 0; GroupIndex < SampleContext->GroupCount; GroupIndex++) {
+                SampleContext->GroupMask[GroupIndex] = Entry->u.Group.GroupInfo[GroupIndex].ActiveProcessorMask;
+            }
+        } else if (Entry->Relationship == YoriProcessorRelationNumaNode &&
+                   NodeIndex < SampleContext->NumaNodeCount) {
+
+            SampleContext->NumaNodes[NodeIndex].NodeNumber = Entry->u.NumaNode.NodeNumber;
+            memcpy(&SampleContext->NumaNodes[NodeIndex].GroupMask, &Entry->u.NumaNode.GroupMask, sizeof(YORI_PROCESSOR_GROUP_AFFINITY));
+            NodeIndex++;
+        }
+
+        CurrentOffset += Entry->SizeInBytes;
+        if (CurrentOffset >= CpuInfoContext->BytesInBuffer) {
+            break;
+        }
+        Entry = YoriLibAddToPointer(CpuInfoContext->ProcInfo, CurrentOffset);
+    }
+
+    SampleContext->NumaNodeCount = NodeIndex;
+
+    if (SampleContext->GroupMask == NULL) {
+        return FALSE;
+    }
+
+    //
+    //  Before processor groups existed, all processors are in group zero
+    //  and can only be queried for that group.
+    //
+
+    if (DllNtDll.pNtQuerySystemInformationEx == NULL) {
+        SampleContext->GroupCount = 1;
+    }
+
+    SampleBytes = (YORI_ALLOC_SIZE_T)(SampleContext->GroupCount * CPUINFO_PROCESSORS_PER_GROUP * sizeof(YORI_SYSTEM_PROCESSOR_PERFORMANCE_INFORMATION));
+    SampleContext->Samples[0] = YoriLibMalloc(SampleBytes * 2);
+    if (SampleContext->Samples[0] == NULL) {
+        return FALSE;
+    }
+    SampleContext->Samples[1] = YoriLibAddToPointer(SampleContext->Samples[0], SampleBytes);
+
+    //
+    //  Each line contains a timestamp and total, a value for each group and
+    //  NUMA node, and a value for each processor.
+    //
+
+    LineLength = (YORI_ALLOC_SIZE_T)(64 + (SampleContext->GroupCount + SampleContext->NumaNodeCount) * 32 + SampleContext->GroupCount * CPUINFO_PROCESSORS_PER_GROUP * 16);
+    if (!YoriLibAllocateString(&SampleContext->Line, LineLength)) {
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1500) && (_MSC_VER <= 1600)
+#pragma warning(pop)
+#endif
+
+/**
+ Free all memory associated with the sample context.
+
+ @param SampleContext Pointer to the sample context to clean up.
+ */
+VOID
+CpuInfoCleanupSampling(
+    __in PCPUINFO_SAMPLE_CONTEXT SampleContext
+    )
+{
+    if (SampleContext->GroupMask != NULL) {
+        YoriLibFree(SampleContext->GroupMask);
+    }
+    if (SampleContext->NumaNodes != NULL) {
+        YoriLibFree(SampleContext->NumaNodes);
+    }
+    if (SampleContext->Samples[0] != NULL) {
+        YoriLibFree(SampleContext->Samples[0]);
+    }
+    YoriLibFreeStringContents(&SampleContext->Line);
+}
+
+/**
+ Capture the accumulated times of every logical processor in the system.
+ This is a single system call per processor group, so it is inexpensive
+ enough to perform frequently alongside other work.
+
+ @param SampleContext Pointer to the sample context.
+
+ @param Sample Pointer to an array to populate with processor times.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+CpuInfoCaptureSample(
+    __in PCPUINFO_SAMPLE_CONTEXT SampleContext,
+    __out PYORI_SYSTEM_PROCESSOR_PERFORMANCE_INFORMATION Sample
+    )
+{
+    USHORT GroupIndex;
+    DWORD BytesReturned;
+    LONG Status;
+
+    ZeroMemory(Sample, SampleContext->GroupCount * CPUINFO_PROCESSORS_PER_GROUP * sizeof(YORI_SYSTEM_PROCESSOR_PERFORMANCE_INFORMATION));
+
+    for (GroupIndex = 0; GroupIndex < SampleContext->GroupCount; GroupIndex++) {
+        if (DllNtDll.pNtQuerySystemInformationEx != NULL) {
+            Status = DllNtDll.pNtQuerySystemInformationEx(SystemProcessorPerformanceInformation,
+                                                          &GroupIndex,
+                                                          sizeof(GroupIndex),
+                                                          &Sample[GroupIndex * CPUINFO_PROCESSORS_PER_GROUP],
+                                                          CPUINFO_PROCESSORS_PER_GROUP * sizeof(YORI_SYSTEM_PROCESSOR_PERFORMANCE_INFORMATION),
+                                                          &BytesReturned);
+        } else {
+            Status = DllNtDll.pNtQuerySystemInformation(SystemProcessorPerformanceInformation,
+                                                        Sample,
+                                                        CPUINFO_PROCESSORS_PER_GROUP * sizeof(YORI_SYSTEM_PROCESSOR_PERFORMANCE_INFORMATION),
+                                                        &BytesReturned);
+        }
+
+        if (Status != 0) {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+/**
+ Calculate the utilization of a set of processors within a processor group
+ between the previous sample and the current sample.
+
+ @param SampleContext Pointer to the sample context.
+
+ @param GroupIndex The processor group containing the processors.
+
+ @param Mask The set of processors within the group to include.
+
+ @param TotalTime On input, the amount of processor time accumulated so far.
+        On output, updated to include the processor time of the specified
+        processors.
+
+ @param IdleTime On input, the amount of idle time accumulated so far.  On
+        output, updated to include the idle time of the specified processors.
+ */
+VOID
+CpuInfoAccumulateProcessorTimes(
+    __in PCPUINFO_SAMPLE_CONTEXT SampleContext,
+    __in WORD GroupIndex,
+    __in DWORD_PTR Mask,
+    __inout PDWORDLONG TotalTime,
+    __inout PDWORDLONG IdleTime
+    )
+{
+    PYORI_SYSTEM_PROCESSOR_PERFORMANCE_INFORMATION Current;
+    PYORI_SYSTEM_PROCESSOR_PERFORMANCE_INFORMATION Previous;
+    DWORD LogicalProcessorIndex;
+    DWORD_PTR LogicalProcessorMask;
+    DWORDLONG Total;
+    DWORDLONG Idle;
+
+    if (GroupIndex >= SampleContext->GroupCount) {
+        return;
+    }
+
+    Current = &SampleContext->Samples[SampleContext->CurrentSample][GroupIndex * CPUINFO_PROCESSORS_PER_GROUP];
+    Previous = &SampleContext->Samples[1 - SampleContext->CurrentSample][GroupIndex * CPUINFO_PROCESSORS_PER_GROUP];
+
+    for (LogicalProcessorIndex = 0; LogicalProcessorIndex < 8 * sizeof(DWORD_PTR); LogicalProcessorIndex++) {
+        LogicalProcessorMask = 1;
+        LogicalProcessorMask = LogicalProcessorMask<<LogicalProcessorIndex;
+        if ((Mask & LogicalProcessorMask) == 0) {
+            continue;
+        }
+
+        Total = (DWORDLONG)(Current[LogicalProcessorIndex].KernelTime.QuadPart + Current[LogicalProcessorIndex].UserTime.QuadPart) -
+                (DWORDLONG)(Previous[LogicalProcessorIndex].KernelTime.QuadPart + Previous[LogicalProcessorIndex].UserTime.QuadPart);
+        Idle = (DWORDLONG)(Current[LogicalProcessorIndex].IdleTime.QuadPart - Previous[LogicalProcessorIndex].IdleTime.QuadPart);
+        if (Idle > Total) {
+            Idle = Total;
+        }
+
+        *TotalTime = *TotalTime + Total;
+        *IdleTime = *IdleTime + Idle;
+    }
+}
+
+/**
+ Convert an amount of processor time and idle time into utilization.
+
+ @param TotalTime The amount of processor time.
+
+ @param IdleTime The amount of that processor time that was idle.
+
+ @return The utilization in hundredths of a percent.
+ */
+DWORD
+CpuInfoUtilizationFromTimes(
+    __in DWORDLONG TotalTime,
+    __in DWORDLONG IdleTime
+    )
+{
+    if (TotalTime == 0) {
+        return 0;
+    }
+
+    return (DWORD)((TotalTime - IdleTime) * 10000 / TotalTime);
+}
+
+/**
+ A value for CpuInfoAppendUtilization indicating that the utilization does
+ not refer to a numbered group, node or processor.
+ */
+#define CPUINFO_NO_NUMBER ((DWORD)-1)
+
+/**
+ Append a single utilization value to the line being constructed for a
+ sample.
+
+ @param SampleContext Pointer to the sample context, indicating the output
+        format.
+
+ @param Label Optionally points to a label describing the value.  If NULL,
+        the value is displayed briefly as a whole percentage.  This is not
+        used for CSV output.
+
+ @param Number The number of the group or node that the value describes, or
+        CPUINFO_NO_NUMBER if the label is not numbered.
+
+ @param Utilization The utilization in hundredths of a percent.
+ */
+VOID
+CpuInfoAppendUtilization(
+    __in PCPUINFO_SAMPLE_CONTEXT SampleContext,
+    __in_opt LPCTSTR Label,
+    __in DWORD Number,
+    __in DWORD Utilization
+    )
+{
+    PYORI_STRING Line;
+    LPTSTR Dest;
+    YORI_ALLOC_SIZE_T Remaining;
+
+    Line = &SampleContext->Line;
+    Dest = &Line->StartOfString[Line->LengthInChars];
+    Remaining = Line->LengthAllocated - Line->LengthInChars;
+
+    if (SampleContext->CsvOutput) {
+        Line->LengthInChars = Line->LengthInChars + YoriLibSPrintfS(Dest, Remaining, _T(",%i.%02i"), Utilization / 100, Utilization % 100);
+    } else if (Label == NULL) {
+        Line->LengthInChars = Line->LengthInChars + YoriLibSPrintfS(Dest, Remaining, _T(" %3i"), Utilization / 100);
+    } else if (Number == CPUINFO_NO_NUMBER) {
+        Line->LengthInChars = Line->LengthInChars + YoriLibSPrintfS(Dest, Remaining, _T(" %s %3i.%02i%%"), Label, Utilization / 100, Utilization % 100);
+    } else {
+        Line->LengthInChars = Line->LengthInChars + YoriLibSPrintfS(Dest, Remaining, _T(" %s %i %3i.%02i%%"), Label, Number, Utilization / 100, Utilization % 100);
+    }
+}
+
+/**
+ Display the header line for CSV output, naming each column that will be
+ displayed for each sample.
+
+ @param SampleContext Pointer to the sample context.
+ */
+VOID
+CpuInfoOutputCsvHeader(
+    __in PCPUINFO_SAMPLE_CONTEXT SampleContext
+    )
+{
+    WORD GroupIndex;
+    DWORD NodeIndex;
+    DWORD LogicalProcessorIndex;
+    DWORD_PTR LogicalProcessorMask;
+
+    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("Time,Total"));
+    for (GroupIndex = 0; GroupIndex < SampleContext->GroupCount; GroupIndex++) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T(",Group%i"), GroupIndex);
+    }
+    for (NodeIndex = 0; NodeIndex < SampleContext->NumaNodeCount; NodeIndex++) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T(",Node%i"), SampleContext->NumaNodes[NodeIndex].NodeNumber);
+    }
+    for (GroupIndex = 0; GroupIndex < SampleContext->GroupCount; GroupIndex++) {
+        for (LogicalProcessorIndex = 0; LogicalProcessorIndex < 8 * sizeof(DWORD_PTR); LogicalProcessorIndex++) {
+            LogicalProcessorMask = 1;
+            LogicalProcessorMask = LogicalProcessorMask<<LogicalProcessorIndex;
+            if (SampleContext->GroupMask[GroupIndex] & LogicalProcessorMask) {
+                YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T(",Cpu%i"), GroupIndex * CPUINFO_PROCESSORS_PER_GROUP + LogicalProcessorIndex);
+            }
+        }
+    }
+    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("\n"));
+}
+
+/**
+ Display the utilization of the system, each processor group, each NUMA
+ node and each logical processor between the previous sample and the
+ current sample.  Groups and nodes are only displayed in human readable
+ output when there is more than one of them.
+
+ @param SampleContext Pointer to the sample context.
+ */
+VOID
+CpuInfoOutputSample(
+    __in PCPUINFO_SAMPLE_CONTEXT SampleContext
+    )
+{
+    SYSTEMTIME Now;
+    DWORDLONG TotalTime;
+    DWORDLONG IdleTime;
+    WORD GroupIndex;
+    DWORD NodeIndex;
+    DWORD LogicalProcessorIndex;
+    DWORD_PTR LogicalProcessorMask;
+    PCPUINFO_NUMA_NODE Node;
+    PYORI_STRING Line;
+
+    Line = &SampleContext->Line;
+
+    GetLocalTime(&Now);
+    Line->LengthInChars = YoriLibSPrintfS(Line->StartOfString, Line->LengthAllocated, _T("%02i:%02i:%02i.%03i"), Now.wHour, Now.wMinute, Now.wSecond, Now.wMilliseconds);
+
+    TotalTime = 0;
+    IdleTime = 0;
+    for (GroupIndex = 0; GroupIndex < SampleContext->GroupCount; GroupIndex++) {
+        CpuInfoAccumulateProcessorTimes(SampleContext, GroupIndex, SampleContext->GroupMask[GroupIndex], &TotalTime, &IdleTime);
+    }
+    CpuInfoAppendUtilization(SampleContext, _T("Total"), CPUINFO_NO_NUMBER, CpuInfoUtilizationFromTimes(TotalTime, IdleTime));
+
+    if (SampleContext->CsvOutput || SampleContext->GroupCount > 1) {
+        for (GroupIndex = 0; GroupIndex < SampleContext->GroupCount; GroupIndex++) {
+            TotalTime = 0;
+            IdleTime = 0;
+            CpuInfoAccumulateProcessorTimes(SampleContext, GroupIndex, SampleContext->GroupMask[GroupIndex], &TotalTime, &IdleTime);
+            CpuInfoAppendUtilization(SampleContext, _T("Group"), GroupIndex, CpuInfoUtilizationFromTimes(TotalTime, IdleTime));
+        }
+    }
+
+    if (SampleContext->CsvOutput || SampleContext->NumaNodeCount > 1) {
+        for (NodeIndex = 0; NodeIndex < SampleContext->NumaNodeCount; NodeIndex++) {
+            Node = &SampleContext->NumaNodes[NodeIndex];
+            TotalTime = 0;
+            IdleTime = 0;
+            CpuInfoAccumulateProcessorTimes(SampleContext, Node->GroupMask.Group, Node->GroupMask.Mask, &TotalTime, &IdleTime);
+            CpuInfoAppendUtilization(SampleContext, _T("Node"), Node->NodeNumber, CpuInfoUtilizationFromTimes(TotalTime, IdleTime));
+        }
+    }
+
+    if (!SampleContext->CsvOutput) {
+        Line->LengthInChars = Line->LengthInChars + YoriLibSPrintfS(&Line->StartOfString[Line->LengthInChars], Line->LengthAllocated - Line->LengthInChars, _T("  |"));
+    }
+
+    for (GroupIndex = 0; GroupIndex < SampleContext->GroupCount; GroupIndex++) {
+        for (LogicalProcessorIndex = 0; LogicalProcessorIndex < 8 * sizeof(DWORD_PTR); LogicalProcessorIndex++) {
+            LogicalProcessorMask = 1;
+            LogicalProcessorMask = LogicalProcessorMask<<LogicalProcessorIndex;
+            if (SampleContext->GroupMask[GroupIndex] & LogicalProcessorMask) {
+                TotalTime = 0;
+                IdleTime = 0;
+                CpuInfoAccumulateProcessorTimes(SampleContext, GroupIndex, LogicalProcessorMask, &TotalTime, &IdleTime);
+                CpuInfoAppendUtilization(SampleContext, NULL, CPUINFO_NO_NUMBER, CpuInfoUtilizationFromTimes(TotalTime, IdleTime));
+            }
+        }
+    }
+
+    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y\n"), Line);
+}
+
+/**
+ Continuously display the utilization of each logical processor, processor
+ group and NUMA node at a fixed interval until the requested number of
+ samples have been displayed or the operation is cancelled.
+
+ @param CpuInfoContext Pointer to the context containing processor layout.
+
+ @param SampleContext Pointer to the sample context specifying the interval,
+        number of samples and output format.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+CpuInfoSampleUtilization(
+    __in PCPUINFO_CONTEXT CpuInfoContext,
+    __inout PCPUINFO_SAMPLE_CONTEXT SampleContext
+    )
+{
+    DWORD SampleIndex;
+    HANDLE CancelEvent;
+    BOOL Result;
+
+    if (DllNtDll.pNtQuerySystemInformation == NULL) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("OS support not present\n"));
+        return FALSE;
+    }
+
+    if (!CpuInfoInitializeSampling(CpuInfoContext, SampleContext)) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("cpuinfo: cannot initialize processor sampling\n"));
+        CpuInfoCleanupSampling(SampleContext);
+        return FALSE;
+    }
+
+    Result = FALSE;
+    SampleContext->CurrentSample = 0;
+    if (!CpuInfoCaptureSample(SampleContext, SampleContext->Samples[SampleContext->CurrentSample])) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("cpuinfo: cannot query processor times\n"));
+        goto Exit;
+    }
+
+    if (SampleContext->CsvOutput) {
+        CpuInfoOutputCsvHeader(SampleContext);
+    }
+
+    for (SampleIndex = 0; SampleContext->SampleCount == 0 || SampleIndex < SampleContext->SampleCount; SampleIndex++) {
+
+        CancelEvent = YoriLibCancelGetEvent();
+        if (CancelEvent != NULL) {
+            if (WaitForSingleObject(CancelEvent, SampleContext->Interval) == WAIT_OBJECT_0) {
+                break;
+            }
+        } else {
+            Sleep(SampleContext->Interval);
+        }
+
+        if (YoriLibIsOperationCancelled()) {
+            break;
+        }
+
+        SampleContext->CurrentSample = 1 - SampleContext->CurrentSample;
+        if (!CpuInfoCaptureSample(SampleContext, SampleContext->Samples[SampleContext->CurrentSample])) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("cpuinfo: cannot query processor times\n"));
+            goto Exit;
+        }
+
+        CpuInfoOutputSample(SampleContext);
+    }
+
+    Result = TRUE;
+
+Exit:
+    CpuInfoCleanupSampling(SampleContext);
+    return Result;
+}
+
 #ifdef YORI_BUILTIN
 /**
  The main entrypoint for the cpuinfo builtin command.
@@ -1067,6 +1656,7 @@ ENTRYPOINT(
     BOOLEAN DisplayGraph = TRUE;
     YORI_STRING Arg;
     CPUINFO_CONTEXT CpuInfoContext;
+    CPUINFO_SAMPLE_CONTEXT SampleContext;
     YORI_STRING DisplayString;
     YORI_STRING AllocatedFormatString;
     LPTSTR DefaultFormatString = _T("Core count: $CORECOUNT$\n")
@@ -1077,6 +1667,7 @@ ENTRYPOINT(
                                  _T("Numa nodes: $NUMANODECOUNT$\n");
 
     ZeroMemory(&CpuInfoContext, sizeof(CpuInfoContext));
+    ZeroMemory(&SampleContext, sizeof(SampleContext));
     CpuInfoContext.WaitTime = 300;
     for (i = 1; i < ArgC; i++) {
 
@@ -1101,10 +1692,43 @@ ENTRYPOINT(
                 DisplayCores = TRUE;
                 DisplayFormatString = FALSE;
                 ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("count")) == 0 &&
+                       i + 1 < ArgC) {
+
+                YORI_MAX_SIGNED_T llTemp;
+                YORI_ALLOC_SIZE_T CharsConsumed;
+
+                llTemp = 0;
+                if (YoriLibStringToNumber(&ArgV[i + 1], TRUE, &llTemp, &CharsConsumed) &&
+                    CharsConsumed > 0 &&
+                    llTemp > 0) {
+
+                    SampleContext.SampleCount = (DWORD)llTemp;
+                }
+                i = i + 1;
+                ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("csv")) == 0) {
+                SampleContext.CsvOutput = TRUE;
+                ArgumentUnderstood = TRUE;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("g")) == 0) {
                 DisplayGroups = TRUE;
                 DisplayFormatString = FALSE;
                 ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("i")) == 0 &&
+                       i + 1 < ArgC) {
+
+                YORI_MAX_SIGNED_T llTemp;
+                YORI_ALLOC_SIZE_T CharsConsumed;
+
+                llTemp = 0;
+                if (YoriLibStringToNumber(&ArgV[i + 1], TRUE, &llTemp, &CharsConsumed) &&
+                    CharsConsumed > 0 &&
+                    llTemp > 0) {
+
+                    SampleContext.Interval = (DWORD)llTemp;
+                }
+                i = i + 1;
+                ArgumentUnderstood = TRUE;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("n")) == 0) {
                 DisplayNuma = TRUE;
                 DisplayFormatString = FALSE;
@@ -1168,6 +1792,26 @@ ENTRYPOINT(
         return EXIT_FAILURE;
     }
 
+    if (SampleContext.Interval != 0) {
+        BOOL Result;
+
+        if (!CpuInfoContext.TopologyLoaded) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("OS support not present\n"));
+            return EXIT_FAILURE;
+        }
+
+#if YORI_BUILTIN
+        YoriLibCancelEnable(FALSE);
+#endif
+
+        Result = CpuInfoSampleUtilization(&CpuInfoContext, &SampleContext);
+        YoriLibFree(CpuInfoContext.ProcInfo);
+        if (!Result) {
+            return EXIT_FAILURE;
+        }
+        return EXIT_SUCCESS;
+    }
+
     if (DisplayCores) {
         CpuInfoDisplayCores(&CpuInfoContext);
         InsertNewline = TRUE;
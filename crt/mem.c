@@ -69,6 +69,21 @@
 #define MINICRT_BUILD
 #include "yoricrt.h"
 
+/**
+ An unsigned integer the size of a pointer, which is the largest unit that
+ can be copied efficiently on every supported processor.
+ */
+#if defined(_WIN64)
+typedef unsigned __int64 mini_word_t;
+#else
+typedef unsigned int mini_word_t;
+#endif
+
+/**
+ Return the offset of a pointer from the previous word aligned address.
+ */
+#define MINI_WORD_OFFSET(ptr) ((mini_word_t)(ptr) & (sizeof(mini_word_t) - 1))
+
 /**
  Copy the contents of one memory block into another memory block where the
  two memory blocks must be disjoint so no consideration is made for writing
@@ -85,10 +100,46 @@
 void *
 MCRT_FN
 mini_memcpy(void * dest, const void * src, unsigned int len)
+#ifdef __clang__
+__attribute__((no_builtin("memcpy")))
+#endif
 {
     unsigned int i;
+    unsigned int words;
     char * char_src = (char *)src;
     char * char_dest = (char *)dest;
+    mini_word_t * word_src;
+    mini_word_t * word_dest;
+
+    //
+    //  If both blocks have the same alignment, copy bytes until they are
+    //  aligned and then copy a word at a time.  Blocks with different
+    //  alignment are copied a byte at a time, since not every supported
+    //  processor can perform unaligned accesses.
+    //
+
+    if (len >= 2 * sizeof(mini_word_t) &&
+        MINI_WORD_OFFSET(char_dest) == MINI_WORD_OFFSET(char_src)) {
+
+        while (MINI_WORD_OFFSET(char_dest) != 0) {
+            *char_dest = *char_src;
+            char_dest++;
+            char_src++;
+            len--;
+        }
+
+        words = len / sizeof(mini_word_t);
+        word_src = (mini_word_t *)char_src;
+        word_dest = (mini_word_t *)char_dest;
+        for (i = 0; i < words; i++) {
+            word_dest[i] = word_src[i];
+        }
+
+        char_src = char_src + words * sizeof(mini_word_t);
+        char_dest = char_dest + words * sizeof(mini_word_t);
+        len = len - words * sizeof(mini_word_t);
+    }
+
     for (i = 0; i < len; i++) {
         char_dest[i] = char_src[i];
     }
@@ -111,22 +162,62 @@ mini_memcpy(void * dest, const void * src, unsigned int len)
 void *
 MCRT_FN
 mini_memmove(void * dest, const void * src, unsigned int len)
+#ifdef __clang__
+__attribute__((no_builtin("memmove")))
+#endif
 {
     unsigned int i;
+    unsigned int words;
     char * char_src = (char *)src;
     char * char_dest = (char *)dest;
-    if (char_dest > char_src) {
-        if (len == 0) {
-            return dest;
-        }
-        for (i = len - 1; ; i--) {
-            char_dest[i] = char_src[i];
-            if (i==0) break;
+    mini_word_t * word_src;
+    mini_word_t * word_dest;
+
+    //
+    //  Copying forward reads each word before any write can overwrite it,
+    //  so this is the same as a regular copy.
+    //
+
+    if (char_dest <= char_src) {
+        return mini_memcpy(dest, src, len);
+    }
+
+    //
+    //  Copy from the end of the block backwards, one word at a time if the
+    //  blocks have the same alignment.
+    //
+
+    char_src = char_src + len;
+    char_dest = char_dest + len;
+
+    if (len >= 2 * sizeof(mini_word_t) &&
+        MINI_WORD_OFFSET(char_dest) == MINI_WORD_OFFSET(char_src)) {
+
+        while (MINI_WORD_OFFSET(char_dest) != 0) {
+            char_dest--;
+            char_src--;
+            *char_dest = *char_src;
+            len--;
         }
-    } else {
-        for (i = 0; i < len; i++) {
-            char_dest[i] = char_src[i];
+
+        words = len / sizeof(mini_word_t);
+        word_src = (mini_word_t *)char_src;
+        word_dest = (mini_word_t *)char_dest;
+        for (i = words; i > 0; i--) {
+            word_dest--;
+            word_src--;
+            *word_dest = *word_src;
         }
+
+        char_src = (char *)word_src;
+        char_dest = (char *)word_dest;
+        len = len - words * sizeof(mini_word_t);
+    }
+
+    for (i = len; i > 0; i--) {
+        char_dest--;
+        char_src--;
+        *char_dest = *char_src;
     }
     return dest;
 }
@@ -208,7 +299,39 @@ mini_memcmp(const void * buf1, const void * buf2, unsigned int len)
     unsigned int i = 0;
     unsigned char * char_buf1 = (unsigned char *)buf1;
     unsigned char * char_buf2 = (unsigned char *)buf2;
-    for (i = 0; i < len; i++) {
+    mini_word_t * word_buf1;
+    mini_word_t * word_buf2;
+
+    //
+    //  If both blocks have the same alignment, skip over the words that
+    //  are equal.  The first difference is located a byte at a time below
+    //  so the result doesn't depend on the processor's byte order.
+    //
+
+    if (len >= 2 * sizeof(mini_word_t) &&
+        MINI_WORD_OFFSET(char_buf1) == MINI_WORD_OFFSET(char_buf2)) {
+
+        while (MINI_WORD_OFFSET(char_buf1 + i) != 0) {
+            if (char_buf1[i] != char_buf2[i]) {
+                break;
+            }
+            i++;
+        }
+
+        if (MINI_WORD_OFFSET(char_buf1 + i) == 0) {
+            word_buf1 = (mini_word_t *)(char_buf1 + i);
+            word_buf2 = (mini_word_t *)(char_buf2 + i);
+            while (i + sizeof(mini_word_t) <= len &&
+                   *word_buf1 == *word_buf2) {
+
+                word_buf1++;
+                word_buf2++;
+                i = i + sizeof(mini_word_t);
+            }
+        }
+    }
+
+    for (; i < len; i++) {
         if (char_buf1[i] < char_buf2[i]) {
             return -1;
         } else if (char_buf1[i] > char_buf2[i]) {
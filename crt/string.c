@@ -69,6 +69,49 @@
 #define MINICRT_BUILD
 #include "yoricrt.h"
 
+/**
+ A machine word used to inspect several characters of a string with a single
+ memory access.
+ */
+#if defined(_WIN64)
+typedef unsigned __int64 mini_word_t;
+#else
+typedef unsigned int mini_word_t;
+#endif
+
+/**
+ Return the offset of a pointer from the previous word aligned address.
+ */
+#define MINI_WORD_OFFSET(ptr) ((mini_word_t)(ptr) & (sizeof(mini_word_t) - 1))
+
+#ifdef UNICODE
+/**
+ A word containing the value one in each character position.
+ */
+#define MINI_WORD_CHAR_ONES ((mini_word_t)-1 / 0xFFFF)
+#else
+/**
+ A word containing the value one in each character position.
+ */
+#define MINI_WORD_CHAR_ONES ((mini_word_t)-1 / 0xFF)
+#endif
+
+/**
+ A word containing the highest bit of each character position.
+ */
+#define MINI_WORD_CHAR_HIGH_BITS (MINI_WORD_CHAR_ONES << (sizeof(TCHAR) * 8 - 1))
+
+/**
+ Returns nonzero if any character position within a word contains zero.
+ Subtracting one from a zero character borrows into its high bit, which is
+ only retained if the character did not have that bit set originally.  A
+ character above a zero character can be falsely reported due to the borrow,
+ but the lowest reported character is always correct, and callers rescan
+ the word one character at a time to find it.
+ */
+#define MINI_WORD_HAS_ZERO_CHAR(w) \
+    (((w) - MINI_WORD_CHAR_ONES) & ~(w) & MINI_WORD_CHAR_HIGH_BITS)
+
 
 #ifdef UNICODE
 /**
@@ -276,11 +319,32 @@ int
 MCRT_FN
 mini_tcslen(const TCHAR * str)
 {
-    int i = 0;
-    while (str[i] != '\0') {
-        i++;
+    const TCHAR * ptr = str;
+    const mini_word_t * word_ptr;
+
+    //
+    //  Check characters until the string is word aligned, then check a word
+    //  at a time.  An aligned word cannot span a page boundary, so reading
+    //  beyond the terminator within the same word is safe.
+    //
+
+    while (MINI_WORD_OFFSET(ptr) != 0) {
+        if (*ptr == '\0') {
+            return (int)(ptr - str);
+        }
+        ptr++;
+    }
+
+    word_ptr = (const mini_word_t *)ptr;
+    while (!MINI_WORD_HAS_ZERO_CHAR(*word_ptr)) {
+        word_ptr++;
+    }
+
+    ptr = (const TCHAR *)word_ptr;
+    while (*ptr != '\0') {
+        ptr++;
     }
-    return i;
+    return (int)(ptr - str);
 }
 
 #ifdef UNICODE
@@ -311,12 +375,25 @@ mini_tcsstr(const TCHAR * str, TCHAR * search)
 {
     const TCHAR * ptr = str;
     int i;
-    while (*ptr != '\0') {
-        for (i=0;ptr[i]==search[i]&&search[i]!='\0'&&ptr[i]!='\0';i++);
+
+    if (search[0] == '\0') {
+        return (TCHAR*)str;
+    }
+
+    //
+    //  Only attempt a full comparison at locations that match the first
+    //  character of the search string.
+    //
+
+    while (TRUE) {
+        ptr = mini_tcschr(ptr, search[0]);
+        if (ptr == NULL) {
+            return NULL;
+        }
+        for (i=1;ptr[i]==search[i]&&search[i]!='\0';i++);
         if (search[i]=='\0') return (TCHAR*)ptr;
         ptr++;
     }
-    return NULL;
 }
 
 #ifdef UNICODE
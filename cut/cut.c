@@ -35,12 +35,12 @@ CHAR strCutHelpText[] =
         "\n"
         "Outputs a portion of an input buffer of text.\n"
         "\n"
-        "CUT [-license] [-b] [-s] [-f n] [-d <delimiter chars>] [-o n] [-l n]\n"
+        "CUT [-license] [-b] [-s] [-f n[,n...]] [-d <delimiter chars>] [-o n] [-l n]\n"
         "    [[-i] -t <text>] [file]\n"
         "\n"
         "   -b             Use basic search criteria for files only\n"
         "   -d             The set of characters which delimit fields, default comma\n"
-        "   -f n           The field number to cut\n"
+        "   -f n[,n...]    The field number or numbers to cut\n"
         "   -i             Match text case insensitively\n"
         "   -l             The length in bytes to cut from the line or field\n"
         "   -o             The offset in bytes to cut from the line or field\n"
@@ -63,6 +63,17 @@ CutHelp(VOID)
     return TRUE;
 }
 
+/**
+ The maximum number of fields that can be specified with -f.
+ */
+#define CUT_MAX_FIELDS (64)
+
+/**
+ The number of characters whose delimiter status is recorded in a table.
+ Characters above this are compared against the delimiter string.
+ */
+#define CUT_DELIMITER_TABLE_SIZE (256)
+
 /**
  Context describing the operations to perform on each file found.
  */
@@ -98,12 +109,36 @@ typedef struct _CUT_CONTEXT {
      */
     YORI_STRING MatchText;
 
+    /**
+     TRUE if MatchTextMatcher has been initialized to search for MatchText.
+     FALSE if MatchText should be searched for directly.
+     */
+    BOOLEAN MatchTextMatcherValid;
+
+    /**
+     A matcher prepared to search for MatchText in each line.
+     */
+    YORI_LIB_SUBSTRING_MATCHER MatchTextMatcher;
+
+    /**
+     TRUE if any delimiter character is not within DelimiterTable, so
+     characters outside the table need to be compared against
+     FieldSeperator.
+     */
+    BOOLEAN WideDelimiters;
+
     /**
      For a field delimited stream, contains the NULL terminated string
      indicating one or more characters to interpret as delimiters.
      */
     LPTSTR FieldSeperator;
 
+    /**
+     For each character within the table, TRUE if the character is a
+     delimiter.  This is generated from FieldSeperator.
+     */
+    BOOLEAN DelimiterTable[CUT_DELIMITER_TABLE_SIZE];
+
     /**
      The first error encountered when enumerating objects from a single arg.
      This is used to preserve file not found/path not found errors so that
@@ -113,10 +148,35 @@ typedef struct _CUT_CONTEXT {
     DWORD SavedErrorThisArg;
 
     /**
-     For a field delimited stream, indicates the field number that should
-     be output.
+     For a field delimited stream, the number of fields that should be
+     output.
+     */
+    DWORD FieldCount;
+
+    /**
+     For a field delimited stream, the highest numbered field that should
+     be output.  Each line only needs to be parsed up to this field.
+     */
+    DWORD HighestField;
+
+    /**
+     For a field delimited stream, indicates the field numbers that should
+     be output, in the order they should be output.
+     */
+    DWORD FieldsOfInterest[CUT_MAX_FIELDS];
+
+    /**
+     An array of HighestField + 1 elements describing the location of each
+     field within the current line.  Fields which are not present in the
+     line have a length of zero.
      */
-    DWORD FieldOfInterest;
+    PYORI_STRING FieldRanges;
+
+    /**
+     A buffer used to combine multiple fields from a line for output.  This
+     is reused for each line.
+     */
+    YORI_STRING OutputLine;
 
     /**
      Indicates the offset of the line or field, in bytes, that is of interest.
@@ -141,6 +201,262 @@ typedef struct _CUT_CONTEXT {
 
 } CUT_CONTEXT, *PCUT_CONTEXT;
 
+/**
+ Populate the table of delimiter characters from the delimiter string.
+
+ @param CutContext Pointer to the context containing the delimiter string
+        and table.
+ */
+VOID
+CutBuildDelimiterTable(
+    __inout PCUT_CONTEXT CutContext
+    )
+{
+    YORI_ALLOC_SIZE_T Index;
+    TCHAR Char;
+
+    ZeroMemory(CutContext->DelimiterTable, sizeof(CutContext->DelimiterTable));
+    CutContext->WideDelimiters = FALSE;
+
+    for (Index = 0; CutContext->FieldSeperator[Index] != '\0'; Index++) {
+        Char = CutContext->FieldSeperator[Index];
+        if ((DWORD)Char < CUT_DELIMITER_TABLE_SIZE) {
+            CutContext->DelimiterTable[Char] = TRUE;
+        } else {
+            CutContext->WideDelimiters = TRUE;
+        }
+    }
+}
+
+/**
+ Determine if a character delimits fields.
+
+ @param CutContext Pointer to the context containing the delimiter table.
+
+ @param Char The character to check.
+
+ @return TRUE if the character is a delimiter, FALSE if it is not.
+ */
+BOOLEAN
+CutIsDelimiter(
+    __in PCUT_CONTEXT CutContext,
+    __in TCHAR Char
+    )
+{
+    YORI_ALLOC_SIZE_T Index;
+
+    if ((DWORD)Char < CUT_DELIMITER_TABLE_SIZE) {
+        return CutContext->DelimiterTable[Char];
+    }
+
+    if (CutContext->WideDelimiters) {
+        for (Index = 0; CutContext->FieldSeperator[Index] != '\0'; Index++) {
+            if (CutContext->FieldSeperator[Index] == Char) {
+                return TRUE;
+            }
+        }
+    }
+
+    return FALSE;
+}
+
+/**
+ Parse a comma delimited list of field numbers.
+
+ @param String Pointer to the string containing field numbers.
+
+ @param CutContext Pointer to the context to populate with the field
+        numbers.
+
+ @return TRUE to indicate the string was parsed successfully, FALSE if it
+         was not.
+ */
+__success(return)
+BOOLEAN
+CutParseFieldList(
+    __in PYORI_STRING String,
+    __inout PCUT_CONTEXT CutContext
+    )
+{
+    YORI_STRING Remaining;
+    YORI_MAX_SIGNED_T Temp;
+    YORI_ALLOC_SIZE_T CharsConsumed;
+    DWORD FieldCount;
+
+    YoriLibInitEmptyString(&Remaining);
+    Remaining.StartOfString = String->StartOfString;
+    Remaining.LengthInChars = String->LengthInChars;
+    FieldCount = 0;
+
+    while (TRUE) {
+        if (FieldCount == CUT_MAX_FIELDS) {
+            return FALSE;
+        }
+
+        if (!YoriLibStringToNumber(&Remaining, FALSE, &Temp, &CharsConsumed) ||
+            CharsConsumed == 0 ||
+            Temp < 0) {
+
+            return FALSE;
+        }
+
+        CutContext->FieldsOfInterest[FieldCount] = (DWORD)Temp;
+        FieldCount++;
+
+        Remaining.StartOfString = &Remaining.StartOfString[CharsConsumed];
+        Remaining.LengthInChars = Remaining.LengthInChars - CharsConsumed;
+        if (Remaining.LengthInChars == 0) {
+            break;
+        }
+
+        if (Remaining.StartOfString[0] != ',') {
+            return FALSE;
+        }
+        Remaining.StartOfString++;
+        Remaining.LengthInChars--;
+    }
+
+    CutContext->FieldCount = FieldCount;
+    return TRUE;
+}
+
+/**
+ Find the fields of interest within a line.  The line is scanned once, up to
+ the end of the highest numbered field of interest, and the location of
+ each field is recorded in the FieldRanges array.
+
+ @param CutContext Pointer to the context describing the fields of interest.
+
+ @param Line Pointer to the line to parse.
+ */
+VOID
+CutFindFields(
+    __in PCUT_CONTEXT CutContext,
+    __in PYORI_STRING Line
+    )
+{
+    YORI_ALLOC_SIZE_T Index;
+    YORI_ALLOC_SIZE_T FieldStart;
+    DWORD CurrentField;
+
+    for (CurrentField = 0; CurrentField <= CutContext->HighestField; CurrentField++) {
+        CutContext->FieldRanges[CurrentField].LengthInChars = 0;
+    }
+
+    CurrentField = 0;
+    FieldStart = 0;
+    for (Index = 0; Index <= Line->LengthInChars; Index++) {
+        if (Index < Line->LengthInChars &&
+            !CutIsDelimiter(CutContext, Line->StartOfString[Index])) {
+
+            continue;
+        }
+
+        CutContext->FieldRanges[CurrentField].StartOfString = &Line->StartOfString[FieldStart];
+        CutContext->FieldRanges[CurrentField].LengthInChars = Index - FieldStart;
+        if (CurrentField == CutContext->HighestField) {
+            break;
+        }
+        CurrentField++;
+        FieldStart = Index + 1;
+    }
+}
+
+/**
+ Apply the user's requested offset and length to a line or field.
+
+ @param String Pointer to the line or field.  On completion, this is updated
+        to refer to the requested range within it.
+
+ @param DesiredOffset The offset of the range, in characters.
+
+ @param DesiredLength The length of the range, in characters, or zero to
+        indicate the remainder of the line or field.
+ */
+VOID
+CutApplyRange(
+    __inout PYORI_STRING String,
+    __in YORI_ALLOC_SIZE_T DesiredOffset,
+    __in YORI_ALLOC_SIZE_T DesiredLength
+    )
+{
+    if (String->LengthInChars > DesiredOffset) {
+        String->StartOfString = &String->StartOfString[DesiredOffset];
+        String->LengthInChars = String->LengthInChars - DesiredOffset;
+
+        if (DesiredLength != 0 &&
+            String->LengthInChars > DesiredLength) {
+
+            String->LengthInChars = DesiredLength;
+        }
+    } else {
+        String->LengthInChars = 0;
+    }
+}
+
+/**
+ Combine multiple fields of interest from the current line into the output
+ buffer, seperated by the first delimiter character.  The user's requested
+ offset and length are applied to each field.
+
+ @param CutContext Pointer to the context containing the fields found in the
+        current line and the output buffer.
+
+ @param DesiredOffset The offset within each field, in characters.
+
+ @param DesiredLength The length within each field, in characters, or zero to
+        indicate the remainder of each field.
+
+ @return TRUE to indicate the output buffer contains text to display, FALSE
+         if no field contains any text or the buffer could not be
+         allocated.
+ */
+BOOLEAN
+CutProjectFields(
+    __inout PCUT_CONTEXT CutContext,
+    __in YORI_ALLOC_SIZE_T DesiredOffset,
+    __in YORI_ALLOC_SIZE_T DesiredLength
+    )
+{
+    YORI_STRING Field;
+    YORI_ALLOC_SIZE_T CharsNeeded;
+    YORI_ALLOC_SIZE_T FieldChars;
+    DWORD Index;
+
+    YoriLibInitEmptyString(&Field);
+    FieldChars = 0;
+    for (Index = 0; Index < CutContext->FieldCount; Index++) {
+        memcpy(&Field, &CutContext->FieldRanges[CutContext->FieldsOfInterest[Index]], sizeof(YORI_STRING));
+        CutApplyRange(&Field, DesiredOffset, DesiredLength);
+        FieldChars = FieldChars + Field.LengthInChars;
+    }
+
+    if (FieldChars == 0) {
+        return FALSE;
+    }
+
+    CharsNeeded = (YORI_ALLOC_SIZE_T)(FieldChars + CutContext->FieldCount - 1);
+    if (CharsNeeded > CutContext->OutputLine.LengthAllocated) {
+        if (!YoriLibReallocStringNoContents(&CutContext->OutputLine, (YORI_ALLOC_SIZE_T)(CharsNeeded + 256))) {
+            return FALSE;
+        }
+    }
+
+    CutContext->OutputLine.LengthInChars = 0;
+    for (Index = 0; Index < CutContext->FieldCount; Index++) {
+        if (Index > 0) {
+            CutContext->OutputLine.StartOfString[CutContext->OutputLine.LengthInChars] = CutContext->FieldSeperator[0];
+            CutContext->OutputLine.LengthInChars++;
+        }
+        memcpy(&Field, &CutContext->FieldRanges[CutContext->FieldsOfInterest[Index]], sizeof(YORI_STRING));
+        CutApplyRange(&Field, DesiredOffset, DesiredLength);
+        memcpy(&CutContext->OutputLine.StartOfString[CutContext->OutputLine.LengthInChars], Field.StartOfString, Field.LengthInChars * sizeof(TCHAR));
+        CutContext->OutputLine.LengthInChars = CutContext->OutputLine.LengthInChars + Field.LengthInChars;
+    }
+
+    return TRUE;
+}
+
 /**
  Process an incoming stream from a single handle in line mode, applying the
  user requested actions.
@@ -175,7 +491,7 @@ CutProcessHandleLines(
     YoriLibInitEmptyString(&LineString);
 
     while (TRUE) {
-        if (!YoriLibReadLineToString(&LineString, &LineContext, hSource)) {
+        if (!YoriLibReadLineToView(&LineString, &LineContext, hSource)) {
             break;
         }
 
@@ -188,7 +504,11 @@ CutProcessHandleLines(
             YORI_ALLOC_SIZE_T OffsetOfMatch;
             BOOLEAN MatchFound;
             MatchFound = FALSE;
-            if (CutContext->CaseInsensitive) {
+            if (CutContext->MatchTextMatcherValid) {
+                if (YoriLibSubstringMatcherFindFirst(&CutContext->MatchTextMatcher, &MatchingSubset, &OffsetOfMatch)) {
+                    MatchFound = TRUE;
+                }
+            } else if (CutContext->CaseInsensitive) {
                 if (YoriLibFindFirstMatchSubstrIns(&MatchingSubset, 1, &CutContext->MatchText, &OffsetOfMatch)) {
                     MatchFound = TRUE;
                 }
@@ -207,44 +527,31 @@ CutProcessHandleLines(
         }
 
         if (CutContext->FieldDelimited) {
-            YORI_ALLOC_SIZE_T CurrentField = 0;
+            CutFindFields(CutContext, &MatchingSubset);
 
-            for (CurrentField = 0; CurrentField <= CutContext->FieldOfInterest; CurrentField++) {
-                YORI_ALLOC_SIZE_T CharsBeforeSeperator;
+            //
+            //  When multiple fields are requested, combine them into the
+            //  output buffer, which is reused for every line.
+            //
 
-                CharsBeforeSeperator = YoriLibCntStringNotWithChars(&MatchingSubset, CutContext->FieldSeperator);
-                if (CurrentField == CutContext->FieldOfInterest) {
-                    MatchingSubset.LengthInChars = CharsBeforeSeperator;
-                } else {
-                    MatchingSubset.LengthInChars = MatchingSubset.LengthInChars - CharsBeforeSeperator;
-                    if (MatchingSubset.LengthInChars == 0) {
-                        break;
-                    }
-                    MatchingSubset.LengthInChars -= 1;
-                    MatchingSubset.StartOfString = &MatchingSubset.StartOfString[CharsBeforeSeperator + 1];
+            if (CutContext->FieldCount > 1) {
+                if (CutProjectFields(CutContext, DesiredOffset, DesiredLength)) {
+                    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y\n"), &CutContext->OutputLine);
                 }
+                continue;
             }
-        }
-        if (MatchingSubset.LengthInChars > DesiredOffset) {
-            MatchingSubset.StartOfString = &MatchingSubset.StartOfString[DesiredOffset];
-            MatchingSubset.LengthInChars = MatchingSubset.LengthInChars - DesiredOffset;
-
-            if (DesiredLength != 0 &&
-                MatchingSubset.LengthInChars > DesiredLength) {
 
-                MatchingSubset.LengthInChars = DesiredLength;
-            }
-        } else {
-            MatchingSubset.LengthInChars = 0;
+            memcpy(&MatchingSubset, &CutContext->FieldRanges[CutContext->FieldsOfInterest[0]], sizeof(YORI_STRING));
         }
 
+        CutApplyRange(&MatchingSubset, DesiredOffset, DesiredLength);
+
         if (MatchingSubset.LengthInChars > 0) {
             YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y\n"), &MatchingSubset);
         }
     }
 
     YoriLibLineReadCloseOrCache(LineContext);
-    YoriLibFreeStringContents(&LineString);
 
     return TRUE;
 }
@@ -598,15 +905,12 @@ ENTRYPOINT(
                 }
             } else if (YoriLibCompareStringLitIns(&Arg, _T("f")) == 0) {
                 if (ArgC > i + 1) {
-                    if (YoriLibStringToNumber(&ArgV[i + 1], TRUE, &Temp, &CharsConsumed)) {
-                        if (CutContext.RawFile) {
-                            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("cut: Field delimiting incompatible with raw file\n"));
-                        } else {
-                            CutContext.FieldDelimited = TRUE;
-                            CutContext.FieldOfInterest = (DWORD)Temp;
-                            ArgumentUnderstood = TRUE;
-                            i++;
-                        }
+                    if (CutContext.RawFile) {
+                        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("cut: Field delimiting incompatible with raw file\n"));
+                    } else if (CutParseFieldList(&ArgV[i + 1], &CutContext)) {
+                        CutContext.FieldDelimited = TRUE;
+                        ArgumentUnderstood = TRUE;
+                        i++;
                     }
                 }
             } else if (YoriLibCompareStringLitIns(&Arg, _T("d")) == 0) {
@@ -662,6 +966,34 @@ ENTRYPOINT(
         CutContext.FieldSeperator = _T(",");
     }
 
+    if (CutContext.FieldDelimited) {
+        if (CutContext.FieldCount == 0) {
+            CutContext.FieldCount = 1;
+        }
+        CutBuildDelimiterTable(&CutContext);
+        for (i = 0; i < CutContext.FieldCount; i++) {
+            if (CutContext.FieldsOfInterest[i] > CutContext.HighestField) {
+                CutContext.HighestField = CutContext.FieldsOfInterest[i];
+            }
+        }
+        CutContext.FieldRanges = NULL;
+        if (YoriLibIsSizeAllocatable(((YORI_MAX_UNSIGNED_T)CutContext.HighestField + 1) * sizeof(YORI_STRING))) {
+            CutContext.FieldRanges = YoriLibMalloc((YORI_ALLOC_SIZE_T)((CutContext.HighestField + 1) * sizeof(YORI_STRING)));
+        }
+        if (CutContext.FieldRanges == NULL) {
+            YoriLibFreeStringContents(&CutContext.MatchText);
+            return EXIT_FAILURE;
+        }
+        for (i = 0; i <= CutContext.HighestField; i++) {
+            YoriLibInitEmptyString(&CutContext.FieldRanges[i]);
+        }
+    }
+
+    if (CutContext.MatchText.LengthInChars > 0 &&
+        YoriLibSubstringMatcherInitialize(&CutContext.MatchTextMatcher, 1, &CutContext.MatchText, CutContext.CaseInsensitive)) {
+        CutContext.MatchTextMatcherValid = TRUE;
+    }
+
 #if YORI_BUILTIN
     YoriLibCancelEnable(FALSE);
 #endif
@@ -673,12 +1005,29 @@ ENTRYPOINT(
 
     YoriLibEnableBackupPrivilege();
 
+    //
+    //  Buffer output so that each line isn't written separately when output
+    //  is going to a file or pipe.  Raw files are written directly in large
+    //  blocks already.
+    //
+
+    if (!CutContext.RawFile) {
+        YoriLibOutputBufferEnable(GetStdHandle(STD_OUTPUT_HANDLE));
+    }
+
     Result = EXIT_SUCCESS;
 
     if (StartArg == 0 || StartArg == ArgC) {
         if (YoriLibIsStdInConsole()) {
+            YoriLibOutputBufferDisable(GetStdHandle(STD_OUTPUT_HANDLE));
             YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("cut: No file or pipe for input\n"));
+            if (CutContext.MatchTextMatcherValid) {
+                YoriLibSubstringMatcherCleanup(&CutContext.MatchTextMatcher);
+            }
             YoriLibFreeStringContents(&CutContext.MatchText);
+            if (CutContext.FieldRanges != NULL) {
+                YoriLibFree(CutContext.FieldRanges);
+            }
             return EXIT_FAILURE;
         }
         hSource = GetStdHandle(STD_INPUT_HANDLE);
@@ -723,10 +1072,19 @@ ENTRYPOINT(
         }
     }
 
+    YoriLibOutputBufferDisable(GetStdHandle(STD_OUTPUT_HANDLE));
+
 #if !YORI_BUILTIN
     YoriLibLineReadCleanupCache();
 #endif
+    if (CutContext.MatchTextMatcherValid) {
+        YoriLibSubstringMatcherCleanup(&CutContext.MatchTextMatcher);
+    }
     YoriLibFreeStringContents(&CutContext.MatchText);
+    YoriLibFreeStringContents(&CutContext.OutputLine);
+    if (CutContext.FieldRanges != NULL) {
+        YoriLibFree(CutContext.FieldRanges);
+    }
 
     return Result;
 }
@@ -32,6 +32,37 @@
  */
 YORILIB_HTML_GENERATE_CONTEXT CvtvtHtmlGenerateContext;
 
+/**
+ A buffer to generate each piece of HTML into before it is output.  This
+ is reused for the whole stream so that converting a large input doesn't
+ allocate for each piece of text.
+ */
+YORI_STRING CvtvtHtmlScratch;
+
+/**
+ Ensure the scratch buffer can hold a specified number of characters.  Any
+ existing contents are discarded.
+
+ @param LengthNeeded The number of characters needed.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+CvtvtHtmlGrowScratch(
+    __in YORI_ALLOC_SIZE_T LengthNeeded
+    )
+{
+    YORI_ALLOC_SIZE_T AllocSize;
+
+    YoriLibFreeStringContents(&CvtvtHtmlScratch);
+    AllocSize = YoriLibMaximumAllocationInRange(LengthNeeded, LengthNeeded * 2);
+    if (!YoriLibAllocateString(&CvtvtHtmlScratch, AllocSize)) {
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
 /**
  Indicate the beginning of a stream and perform any initial output.
 
@@ -88,6 +119,7 @@ CvtvtHtmlEndStream(
 
     YoriLibOutputTextToMbyteDev(hOutput, &OutputString);
     YoriLibFreeStringContents(&OutputString);
+    YoriLibFreeStringContents(&CvtvtHtmlScratch);
 
     return TRUE;
 }
@@ -113,30 +145,27 @@ CvtvtHtmlProcessAndOutputText(
     __inout PYORI_MAX_UNSIGNED_T Context
     )
 {
-    YORI_STRING TextString;
     YORI_ALLOC_SIZE_T BufferSizeNeeded;
 
     UNREFERENCED_PARAMETER(Context);
 
-    YoriLibInitEmptyString(&TextString);
     BufferSizeNeeded = 0;
-    if (!YoriLibHtmlGenerateTextString(&TextString, &BufferSizeNeeded, String)) {
+    if (!YoriLibHtmlGenerateTextString(&CvtvtHtmlScratch, &BufferSizeNeeded, String)) {
         return FALSE;
     }
 
-    if (!YoriLibAllocateString(&TextString, BufferSizeNeeded)) {
-        return FALSE;
-    }
+    if (BufferSizeNeeded > CvtvtHtmlScratch.LengthAllocated) {
+        if (!CvtvtHtmlGrowScratch(BufferSizeNeeded)) {
+            return FALSE;
+        }
 
-    BufferSizeNeeded = 0;
-    if (!YoriLibHtmlGenerateTextString(&TextString, &BufferSizeNeeded, String)) {
-        YoriLibFreeStringContents(&TextString);
-        return FALSE;
+        BufferSizeNeeded = 0;
+        if (!YoriLibHtmlGenerateTextString(&CvtvtHtmlScratch, &BufferSizeNeeded, String)) {
+            return FALSE;
+        }
     }
 
-    YoriLibOutputTextToMbyteDev(hOutput, &TextString);
-
-    YoriLibFreeStringContents(&TextString);
+    YoriLibOutputTextToMbyteDev(hOutput, &CvtvtHtmlScratch);
     return TRUE;
 }
 
@@ -161,32 +190,36 @@ CvtvtHtmlProcessAndOutputEscape(
     __inout PYORI_MAX_UNSIGNED_T Context
     )
 {
-    YORI_STRING TextString;
     YORI_ALLOC_SIZE_T BufferSizeNeeded;
     YORILIB_HTML_GENERATE_CONTEXT DummyGenerateContext;
 
     UNREFERENCED_PARAMETER(Context);
 
-    YoriLibInitEmptyString(&TextString);
+    //
+    //  Generation updates the state, so generate with a copy of the state.
+    //  If the buffer was large enough, the copy is the new state.
+    //
+
     BufferSizeNeeded = 0;
     memcpy(&DummyGenerateContext, &CvtvtHtmlGenerateContext, sizeof(YORILIB_HTML_GENERATE_CONTEXT));
-    if (!YoriLibHtmlGenerateEscapeString(&TextString, &BufferSizeNeeded, String, &DummyGenerateContext)) {
+    if (!YoriLibHtmlGenerateEscapeString(&CvtvtHtmlScratch, &BufferSizeNeeded, String, &DummyGenerateContext)) {
         return FALSE;
     }
 
-    if (!YoriLibAllocateString(&TextString, BufferSizeNeeded)) {
-        return FALSE;
+    if (BufferSizeNeeded <= CvtvtHtmlScratch.LengthAllocated) {
+        memcpy(&CvtvtHtmlGenerateContext, &DummyGenerateContext, sizeof(YORILIB_HTML_GENERATE_CONTEXT));
+    } else {
+        if (!CvtvtHtmlGrowScratch(BufferSizeNeeded)) {
+            return FALSE;
+        }
+
+        BufferSizeNeeded = 0;
+        if (!YoriLibHtmlGenerateEscapeString(&CvtvtHtmlScratch, &BufferSizeNeeded, String, &CvtvtHtmlGenerateContext)) {
+            return FALSE;
+        }
     }
 
-    BufferSizeNeeded = 0;
-    if (!YoriLibHtmlGenerateEscapeString(&TextString, &BufferSizeNeeded, String, &CvtvtHtmlGenerateContext)) {
-        YoriLibFreeStringContents(&TextString);
-        return FALSE;
-    }
-
-    YoriLibOutputTextToMbyteDev(hOutput, &TextString);
-
-    YoriLibFreeStringContents(&TextString);
+    YoriLibOutputTextToMbyteDev(hOutput, &CvtvtHtmlScratch);
     return TRUE;
 }
 
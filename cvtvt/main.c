@@ -427,6 +427,16 @@ ENTRYPOINT(
         }
     }
 
+    //
+    //  When converting a file or stdin, accumulate output and write it in
+    //  large blocks.  When running a child process, output is written as it
+    //  arrives so the user can see progress.
+    //
+
+    if (!ExecMode) {
+        YoriLibOutputBufferEnable(hOutput);
+    }
+
     YoriLibInitEmptyString(&LineString);
 
     Result = TRUE;
@@ -471,6 +481,10 @@ ENTRYPOINT(
         Callbacks.EndStream(hOutput, &Callbacks.Context);
     }
 
+    if (!YoriLibOutputBufferDisable(hOutput)) {
+        Result = FALSE;
+    }
+
     YoriLibLineReadCloseOrCache(LineReadContext);
     YoriLibFreeStringContents(&LineString);
     if (hSource != INVALID_HANDLE_VALUE && UserFileName != NULL) {
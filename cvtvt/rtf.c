@@ -32,6 +32,37 @@
  */
 BOOLEAN CvtvtRtfUnderlineOn = FALSE;
 
+/**
+ A buffer to generate each piece of RTF into before it is output.  This
+ is reused for the whole stream so that converting a large input doesn't
+ allocate for each piece of text.
+ */
+YORI_STRING CvtvtRtfScratch;
+
+/**
+ Ensure the scratch buffer can hold a specified number of characters.  Any
+ existing contents are discarded.
+
+ @param LengthNeeded The number of characters needed.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+CvtvtRtfGrowScratch(
+    __in YORI_ALLOC_SIZE_T LengthNeeded
+    )
+{
+    YORI_ALLOC_SIZE_T AllocSize;
+
+    YoriLibFreeStringContents(&CvtvtRtfScratch);
+    AllocSize = YoriLibMaximumAllocationInRange(LengthNeeded, LengthNeeded * 2);
+    if (!YoriLibAllocateString(&CvtvtRtfScratch, AllocSize)) {
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
 /**
  Indicate the beginning of a stream and perform any initial output.
 
@@ -87,6 +118,7 @@ CvtvtRtfEndStream(
 
     YoriLibOutputTextToMbyteDev(hOutput, &OutputString);
     YoriLibFreeStringContents(&OutputString);
+    YoriLibFreeStringContents(&CvtvtRtfScratch);
 
     return TRUE;
 }
@@ -112,31 +144,27 @@ CvtvtRtfProcessAndOutputText(
     __in PYORI_MAX_UNSIGNED_T Context
     )
 {
-
-    YORI_STRING TextString;
     YORI_ALLOC_SIZE_T BufferSizeNeeded;
 
     UNREFERENCED_PARAMETER(Context);
 
-    YoriLibInitEmptyString(&TextString);
     BufferSizeNeeded = 0;
-    if (!YoriLibRtfGenerateTextString(&TextString, &BufferSizeNeeded, String)) {
+    if (!YoriLibRtfGenerateTextString(&CvtvtRtfScratch, &BufferSizeNeeded, String)) {
         return FALSE;
     }
 
-    if (!YoriLibAllocateString(&TextString, BufferSizeNeeded)) {
-        return FALSE;
-    }
+    if (BufferSizeNeeded > CvtvtRtfScratch.LengthAllocated) {
+        if (!CvtvtRtfGrowScratch(BufferSizeNeeded)) {
+            return FALSE;
+        }
 
-    BufferSizeNeeded = 0;
-    if (!YoriLibRtfGenerateTextString(&TextString, &BufferSizeNeeded, String)) {
-        YoriLibFreeStringContents(&TextString);
-        return FALSE;
+        BufferSizeNeeded = 0;
+        if (!YoriLibRtfGenerateTextString(&CvtvtRtfScratch, &BufferSizeNeeded, String)) {
+            return FALSE;
+        }
     }
 
-    YoriLibOutputTextToMbyteDev(hOutput, &TextString);
-
-    YoriLibFreeStringContents(&TextString);
+    YoriLibOutputTextToMbyteDev(hOutput, &CvtvtRtfScratch);
     return TRUE;
 }
 
@@ -160,32 +188,37 @@ CvtvtRtfProcessAndOutputEscape(
     __in PYORI_MAX_UNSIGNED_T Context
     )
 {
-    YORI_STRING TextString;
     YORI_ALLOC_SIZE_T BufferSizeNeeded;
     BOOLEAN DummyUnderlineState;
 
     UNREFERENCED_PARAMETER(Context);
 
-    YoriLibInitEmptyString(&TextString);
+    //
+    //  Generation updates the underline state, so generate with a copy of
+    //  the state.  If the buffer was large enough, the copy is the new
+    //  state.
+    //
+
     BufferSizeNeeded = 0;
     DummyUnderlineState = CvtvtRtfUnderlineOn;
-    if (!YoriLibRtfGenerateEscapeString(&TextString, &BufferSizeNeeded, String, &DummyUnderlineState)) {
+    if (!YoriLibRtfGenerateEscapeString(&CvtvtRtfScratch, &BufferSizeNeeded, String, &DummyUnderlineState)) {
         return FALSE;
     }
 
-    if (!YoriLibAllocateString(&TextString, BufferSizeNeeded)) {
-        return FALSE;
+    if (BufferSizeNeeded <= CvtvtRtfScratch.LengthAllocated) {
+        CvtvtRtfUnderlineOn = DummyUnderlineState;
+    } else {
+        if (!CvtvtRtfGrowScratch(BufferSizeNeeded)) {
+            return FALSE;
+        }
+
+        BufferSizeNeeded = 0;
+        if (!YoriLibRtfGenerateEscapeString(&CvtvtRtfScratch, &BufferSizeNeeded, String, &CvtvtRtfUnderlineOn)) {
+            return FALSE;
+        }
     }
 
-    BufferSizeNeeded = 0;
-    if (!YoriLibRtfGenerateEscapeString(&TextString, &BufferSizeNeeded, String, &CvtvtRtfUnderlineOn)) {
-        YoriLibFreeStringContents(&TextString);
-        return FALSE;
-    }
-
-    YoriLibOutputTextToMbyteDev(hOutput, &TextString);
-
-    YoriLibFreeStringContents(&TextString);
+    YoriLibOutputTextToMbyteDev(hOutput, &CvtvtRtfScratch);
     return TRUE;
 }
 
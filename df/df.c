@@ -35,9 +35,39 @@ CHAR strDfHelpText[] =
         "\n"
         "Display disk free space.\n"
         "\n"
-        "DF [-license] [-m] [<drive>]\n"
+        "DF [-license] [-m] [-t <ms>] [<drive>...]\n"
         "\n"
-        "   -m             Minimal display, raw data only\n";
+        "   -m             Minimal display, raw data only\n"
+        "   -t             Time to wait for volumes to respond, in milliseconds\n";
+
+/**
+ The default number of milliseconds to wait for volumes to respond.  Volumes
+ are queried concurrently, so this bounds the total time taken.
+ */
+#define DF_DEFAULT_TIMEOUT (3 * 1000)
+
+/**
+ A volume whose free space is being queried.
+ */
+typedef struct _DF_VOLUME {
+
+    /**
+     The name of the volume, NULL terminated.
+     */
+    YORI_STRING VolName;
+
+    /**
+     The outstanding query of the free space on the volume, or NULL if it
+     could not be issued.
+     */
+    PVOID Query;
+
+    /**
+     TRUE if the volume was specified by the user, so failure to query it
+     should be reported.
+     */
+    BOOLEAN UserSpecified;
+} DF_VOLUME, *PDF_VOLUME;
 
 /**
  Display usage text to the user.
@@ -95,8 +125,153 @@ typedef struct _DF_CONTEXT {
      */
     YORI_LIB_FILE_FILTER ColorRules;
 
+    /**
+     An array of volumes being queried.
+     */
+    PDF_VOLUME Volumes;
+
+    /**
+     The number of elements in the Volumes array that are populated.
+     */
+    YORI_ALLOC_SIZE_T VolumeCount;
+
+    /**
+     The number of elements allocated in the Volumes array.
+     */
+    YORI_ALLOC_SIZE_T VolumesAllocated;
+
+    /**
+     The number of milliseconds to wait for volumes to respond.
+     */
+    DWORD Timeout;
+
 } DF_CONTEXT, *PDF_CONTEXT;
 
+/**
+ Add a volume to the set being queried and begin querying its free space.
+ The query proceeds in the background while further volumes are added.
+
+ @param DfContext Pointer to the context.
+
+ @param VolName Pointer to the name of the volume, NULL terminated.
+
+ @param UserSpecified TRUE if the volume was specified by the user.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+DfAddVolume(
+    __in PDF_CONTEXT DfContext,
+    __in PCYORI_STRING VolName,
+    __in BOOLEAN UserSpecified
+    )
+{
+    PDF_VOLUME NewVolumes;
+    PDF_VOLUME Volume;
+    YORI_ALLOC_SIZE_T NewAllocated;
+
+    if (DfContext->VolumeCount == DfContext->VolumesAllocated) {
+        NewAllocated = DfContext->VolumesAllocated * 2;
+        if (NewAllocated < 16) {
+            NewAllocated = 16;
+        }
+
+        NewVolumes = YoriLibMalloc(NewAllocated * sizeof(DF_VOLUME));
+        if (NewVolumes == NULL) {
+            return FALSE;
+        }
+
+        if (DfContext->Volumes != NULL) {
+            memcpy(NewVolumes, DfContext->Volumes, DfContext->VolumeCount * sizeof(DF_VOLUME));
+            YoriLibFree(DfContext->Volumes);
+        }
+
+        DfContext->Volumes = NewVolumes;
+        DfContext->VolumesAllocated = NewAllocated;
+    }
+
+    Volume = &DfContext->Volumes[DfContext->VolumeCount];
+    if (!YoriLibAllocateString(&Volume->VolName, VolName->LengthInChars + 1)) {
+        return FALSE;
+    }
+
+    memcpy(Volume->VolName.StartOfString, VolName->StartOfString, VolName->LengthInChars * sizeof(TCHAR));
+    Volume->VolName.StartOfString[VolName->LengthInChars] = '\0';
+    Volume->VolName.LengthInChars = VolName->LengthInChars;
+    Volume->UserSpecified = UserSpecified;
+    Volume->Query = YoriLibVolumeSpaceQuery(&Volume->VolName);
+    DfContext->VolumeCount++;
+
+    return TRUE;
+}
+
+/**
+ Return the name to display for a volume.  If the OS supports it, GUID
+ volume names are translated back into drive letters.
+
+ @param VolName The volume name.
+
+ @param MountPointName Pointer to a buffer of MAX_PATH characters which may
+        be populated with the name to display.
+
+ @return Pointer to the name to display, which is either VolName or
+         MountPointName.
+ */
+LPTSTR
+DfGetNameToReport(
+    __in LPTSTR VolName,
+    __out_ecount(MAX_PATH) LPTSTR MountPointName
+    )
+{
+    DWORD LengthNeeded;
+
+    if (DllKernel32.pGetVolumePathNamesForVolumeNameW) {
+        if (DllKernel32.pGetVolumePathNamesForVolumeNameW(VolName, MountPointName, MAX_PATH, &LengthNeeded)) {
+            return MountPointName;
+        }
+    }
+
+    return VolName;
+}
+
+/**
+ Report a volume that did not respond within the timeout.
+
+ @param VolName The volume name.
+
+ @param DfContext Pointer to the context used to indicate options for each
+        drive whose free space is being reported.
+ */
+VOID
+DfReportUnavailableVolume(
+    __in LPTSTR VolName,
+    __in PDF_CONTEXT DfContext
+    )
+{
+    TCHAR MountPointName[MAX_PATH];
+    LPTSTR NameToReport;
+
+    NameToReport = DfGetNameToReport(VolName, MountPointName);
+
+    //
+    //  Minimal output is intended to be parsed, so don't put anything
+    //  other than sizes in it.
+    //
+
+    if (DfContext->MinimalDisplay) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("df: %s unavailable\n"), NameToReport);
+        return;
+    }
+
+    if (DfContext->VolumesDisplayed > 0) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("\n"));
+    }
+
+    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("unavailable %s\n"), NameToReport);
+    DfContext->VolumesDisplayed++;
+}
+
 /**
  Report the space usage on a single volume.
 
@@ -104,25 +279,26 @@ typedef struct _DF_CONTEXT {
         returned from volume enumeration, or a user specified path to
         anything.
 
+ @param TotalBytes The total size of the volume.
+
+ @param FreeBytes The amount of free space on the volume.
+
  @param DfContext Pointer to the context used to indicate options for each
         drive whose free space is being reported.
-
- @return TRUE to indicate success, FALSE to indicate failure.
  */
-BOOL
+VOID
 DfReportSingleVolume(
     __in LPTSTR VolName,
+    __in LARGE_INTEGER TotalBytes,
+    __in LARGE_INTEGER FreeBytes,
     __in PDF_CONTEXT DfContext
     )
 {
-    LARGE_INTEGER TotalBytes;
-    LARGE_INTEGER FreeBytes;
     TCHAR TotalSizeBuffer[10];
     YORI_STRING StrTotalSize;
     TCHAR FreeSizeBuffer[10];
     YORI_STRING StrFreeSize;
     DWORD PercentageUsed;
-    BOOL Result = FALSE;
     WIN32_FIND_DATA FindData;
     YORI_STRING VtAttribute;
     TCHAR VtAttributeBuffer[YORI_MAX_VT_ESCAPE_CHARS];
@@ -144,81 +320,138 @@ DfReportSingleVolume(
     VtAttribute.StartOfString = VtAttributeBuffer;
     VtAttribute.LengthAllocated = sizeof(VtAttributeBuffer)/sizeof(VtAttributeBuffer[0]);
 
-    //
-    //  If the OS supports it, try to translate the GUID volume names back
-    //  into drive letters.
-    //
+    NameToReport = DfGetNameToReport(VolName, MountPointName);
 
-    NameToReport = VolName;
-    if (DllKernel32.pGetVolumePathNamesForVolumeNameW) {
-        if (DllKernel32.pGetVolumePathNamesForVolumeNameW(VolName, MountPointName, sizeof(MountPointName)/sizeof(MountPointName[0]), &PercentageUsed)) {
-            NameToReport = MountPointName;
-        }
-    }
+    YoriLibFileSizeToString(&StrTotalSize, &TotalBytes);
+    YoriLibFileSizeToString(&StrFreeSize, &FreeBytes);
 
-    //
-    //  Query free space and display the result.
-    //
+    if (DfContext->MinimalDisplay) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%lli %lli %s\n"), TotalBytes, FreeBytes, NameToReport, NameToReport);
+    } 
 
-    if (YoriLibGetDiskFreeSpace(VolName, &FreeBytes, &TotalBytes, NULL)) {
+    while (TotalBytes.HighPart != 0) {
+        TotalBytes.QuadPart = TotalBytes.QuadPart >> 1;
+        FreeBytes.QuadPart = FreeBytes.QuadPart >> 1;
+    }
+    PercentageUsed = 1000 - (DWORD)(FreeBytes.QuadPart * 1000 / TotalBytes.QuadPart);
 
-        YoriLibFileSizeToString(&StrTotalSize, &TotalBytes);
-        YoriLibFileSizeToString(&StrFreeSize, &FreeBytes);
+    if (!DfContext->MinimalDisplay) {
+        LPTSTR FinalComponent;
+        YORILIB_COLOR_ATTRIBUTES Attribute;
+        YORI_STRING YsVolName;
 
-        if (DfContext->MinimalDisplay) {
-            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%lli %lli %s\n"), TotalBytes, FreeBytes, NameToReport, NameToReport);
-        } 
+        if (DfContext->VolumesDisplayed > 0) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("\n"));
+        }
 
-        while (TotalBytes.HighPart != 0) {
-            TotalBytes.QuadPart = TotalBytes.QuadPart >> 1;
-            FreeBytes.QuadPart = FreeBytes.QuadPart >> 1;
+        YoriLibUpdateFindDataFromFileInformation(&FindData, VolName, FALSE);
+        FinalComponent = _tcsrchr(NameToReport, '\\');
+        if (FinalComponent != NULL) {
+            YoriLibSPrintfS(FindData.cFileName, MAX_PATH, _T("%s"), FinalComponent + 1);
+        } else {
+            YoriLibSPrintfS(FindData.cFileName, MAX_PATH, _T("%s"), NameToReport);
+        }
+        YoriLibConstantString(&YsVolName, VolName);
+        if (!YoriLibFileFiltCheckColorMatch(&DfContext->ColorRules, &YsVolName, &FindData, &Attribute)) {
+            Attribute.Ctrl = YORILIB_ATTRCTRL_WINDOW_BG | YORILIB_ATTRCTRL_WINDOW_FG;
+            Attribute.Win32Attr = (UCHAR)YoriLibVtGetDefaultColor();
         }
-        PercentageUsed = 1000 - (DWORD)(FreeBytes.QuadPart * 1000 / TotalBytes.QuadPart);
+        YoriLibVtStringForTextAttribute(&VtAttribute, Attribute.Ctrl, Attribute.Win32Attr);
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT,
+                      _T("%y%y%c[0m total %y%y%c[0m free %3i.%i%% used %y%s%c[0m\n"),
+                      &DfContext->FileSizeColorString,
+                      &StrTotalSize,
+                      27,
+                      &DfContext->FileSizeColorString,
+                      &StrFreeSize,
+                      27,
+                      PercentageUsed / 10, PercentageUsed % 10,
+                      &VtAttribute,
+                      NameToReport,
+                      27);
+    }
 
-        if (!DfContext->MinimalDisplay) {
-            LPTSTR FinalComponent;
-            YORILIB_COLOR_ATTRIBUTES Attribute;
-            YORI_STRING YsVolName;
+    if (DfContext->DisplayGraph) {
+        YoriLibDisplayBarGraph(GetStdHandle(STD_OUTPUT_HANDLE), PercentageUsed, 700, 850);
+    }
+    DfContext->VolumesDisplayed++;
+}
 
-            if (DfContext->VolumesDisplayed > 0) {
-                YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("\n"));
-            }
+/**
+ Wait for the queries of each volume to complete and report the results in
+ the order the volumes were added.  Queries were issued concurrently, so
+ all volumes share a single deadline; any volume that has not responded by
+ then is reported as unavailable.
+
+ @param DfContext Pointer to the context.
 
-            YoriLibUpdateFindDataFromFileInformation(&FindData, VolName, FALSE);
-            FinalComponent = _tcsrchr(NameToReport, '\\');
-            if (FinalComponent != NULL) {
-                YoriLibSPrintfS(FindData.cFileName, MAX_PATH, _T("%s"), FinalComponent + 1);
-            } else {
-                YoriLibSPrintfS(FindData.cFileName, MAX_PATH, _T("%s"), NameToReport);
+ @param StartTime The tick count when the first query was issued.
+ */
+VOID
+DfReportVolumes(
+    __in PDF_CONTEXT DfContext,
+    __in DWORD StartTime
+    )
+{
+    YORI_ALLOC_SIZE_T Index;
+    PDF_VOLUME Volume;
+    LARGE_INTEGER TotalBytes;
+    LARGE_INTEGER FreeBytes;
+    DWORD Elapsed;
+    DWORD Remaining;
+    DWORD Error;
+
+    for (Index = 0; Index < DfContext->VolumeCount; Index++) {
+        Volume = &DfContext->Volumes[Index];
+
+        Error = ERROR_NOT_ENOUGH_MEMORY;
+        if (Volume->Query != NULL) {
+            Elapsed = GetTickCount() - StartTime;
+            Remaining = 0;
+            if (Elapsed < DfContext->Timeout) {
+                Remaining = DfContext->Timeout - Elapsed;
             }
-            YoriLibConstantString(&YsVolName, VolName);
-            if (!YoriLibFileFiltCheckColorMatch(&DfContext->ColorRules, &YsVolName, &FindData, &Attribute)) {
-                Attribute.Ctrl = YORILIB_ATTRCTRL_WINDOW_BG | YORILIB_ATTRCTRL_WINDOW_FG;
-                Attribute.Win32Attr = (UCHAR)YoriLibVtGetDefaultColor();
+
+            if (YoriLibVolumeSpaceWait(Volume->Query, Remaining, NULL, &TotalBytes, &FreeBytes, &Error)) {
+                DfReportSingleVolume(Volume->VolName.StartOfString, TotalBytes, FreeBytes, DfContext);
+                continue;
             }
-            YoriLibVtStringForTextAttribute(&VtAttribute, Attribute.Ctrl, Attribute.Win32Attr);
-            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT,
-                          _T("%y%y%c[0m total %y%y%c[0m free %3i.%i%% used %y%s%c[0m\n"),
-                          &DfContext->FileSizeColorString,
-                          &StrTotalSize,
-                          27,
-                          &DfContext->FileSizeColorString,
-                          &StrFreeSize,
-                          27,
-                          PercentageUsed / 10, PercentageUsed % 10,
-                          &VtAttribute,
-                          NameToReport,
-                          27);
         }
 
-        if (DfContext->DisplayGraph) {
-            YoriLibDisplayBarGraph(GetStdHandle(STD_OUTPUT_HANDLE), PercentageUsed, 700, 850);
+        if (Error == ERROR_TIMEOUT) {
+            DfReportUnavailableVolume(Volume->VolName.StartOfString, DfContext);
+        } else if (Volume->UserSpecified) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("df: Could not query %y\n"), &Volume->VolName);
         }
-        Result = TRUE;
-        DfContext->VolumesDisplayed++;
     }
+}
+
+/**
+ Free the set of volumes being queried.  Queries that have not completed
+ continue in the background.
+
+ @param DfContext Pointer to the context.
+ */
+VOID
+DfFreeVolumes(
+    __in PDF_CONTEXT DfContext
+    )
+{
+    YORI_ALLOC_SIZE_T Index;
 
-    return Result;
+    for (Index = 0; Index < DfContext->VolumeCount; Index++) {
+        if (DfContext->Volumes[Index].Query != NULL) {
+            YoriLibVolumeSpaceRelease(DfContext->Volumes[Index].Query);
+        }
+        YoriLibFreeStringContents(&DfContext->Volumes[Index].VolName);
+    }
+
+    if (DfContext->Volumes != NULL) {
+        YoriLibFree(DfContext->Volumes);
+        DfContext->Volumes = NULL;
+    }
+    DfContext->VolumeCount = 0;
+    DfContext->VolumesAllocated = 0;
 }
 
 #ifdef YORI_BUILTIN
@@ -257,9 +490,13 @@ ENTRYPOINT(
     TCHAR VolName[512];
     DF_CONTEXT DfContext;
     YORI_STRING Combined;
+    YORI_ALLOC_SIZE_T CharsConsumed;
+    YORI_MAX_SIGNED_T llTemp;
+    DWORD StartTime;
 
     ZeroMemory(&DfContext, sizeof(DfContext));
     DfContext.DisplayGraph = TRUE;
+    DfContext.Timeout = DF_DEFAULT_TIMEOUT;
 
     for (i = 1; i < ArgC; i++) {
 
@@ -278,6 +515,18 @@ ENTRYPOINT(
                 DfContext.MinimalDisplay = TRUE;
                 DfContext.DisplayGraph = FALSE;
                 ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("t")) == 0) {
+                if (ArgC > i + 1) {
+                    if (YoriLibStringToNumber(&ArgV[i + 1], TRUE, &llTemp, &CharsConsumed) &&
+                        CharsConsumed > 0 &&
+                        llTemp >= 0 &&
+                        llTemp < INFINITE) {
+
+                        DfContext.Timeout = (DWORD)llTemp;
+                        ArgumentUnderstood = TRUE;
+                        i++;
+                    }
+                }
             } else if (YoriLibCompareStringLitIns(&Arg, _T("-")) == 0) {
                 StartArg = i;
                 ArgumentUnderstood = TRUE;
@@ -322,9 +571,15 @@ ENTRYPOINT(
 
     SetErrorMode(SEM_FAILCRITICALERRORS | SEM_NOOPENFILEERRORBOX);
 
+    //
+    //  Issue queries for every volume before waiting for any of them, so
+    //  one unresponsive volume does not delay the others.
+    //
+
+    StartTime = GetTickCount();
     if (StartArg != 0) {
         for (i = StartArg; i < ArgC; i++) {
-            if (!DfReportSingleVolume(ArgV[i].StartOfString, &DfContext)) {
+            if (!DfAddVolume(&DfContext, &ArgV[i], TRUE)) {
                 YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("df: Could not query %y\n"), &ArgV[i]);
             }
         }
@@ -332,12 +587,16 @@ ENTRYPOINT(
         FindHandle = YoriLibFindFirstVolume(VolName, sizeof(VolName)/sizeof(VolName[0]));
         if (FindHandle != INVALID_HANDLE_VALUE) {
             do {
-                DfReportSingleVolume(VolName, &DfContext);
+                YoriLibConstantString(&Combined, VolName);
+                DfAddVolume(&DfContext, &Combined, FALSE);
             } while(YoriLibFindNextVolume(FindHandle, VolName, sizeof(VolName)/sizeof(VolName[0])));
             YoriLibFindVolumeClose(FindHandle);
         }
     }
 
+    DfReportVolumes(&DfContext, StartTime);
+    DfFreeVolumes(&DfContext);
+
     YoriLibFileFiltFreeFilter(&DfContext.ColorRules);
 
     return EXIT_SUCCESS;
@@ -35,11 +35,12 @@ CHAR strDirCaseHelpText[] =
         "\n"
         "Mark directories for case sensitive or insensitive semantics.\n"
         "\n"
-        "DIRCASE [-license] [-b] <-ci|-cs> [-s] [<directory>...]\n"
+        "DIRCASE [-license] [-b] <-ci|-cs> [-j <n>] [-s] [<directory>...]\n"
         "\n"
         "   -b             Use basic search criteria for directories only\n"
         "   -ci            Set the directories to case insensitive behavior\n"
         "   -cs            Set the directories to case sensitive behavior\n"
+        "   -j             Update the specified number of directories concurrently\n"
         "   -s             Process directories from all subdirectories\n"
         "   -v             Verbose output\n";
 
@@ -80,6 +81,13 @@ typedef struct _DIRCASE_CONTEXT {
      */
     BOOLEAN Verbose;
 
+    /**
+     If directories are being updated concurrently, points to the pool of
+     threads performing the updates.  NULL if directories are updated as
+     they are found.
+     */
+    PYORILIB_FILE_UPDATE_QUEUE UpdateQueue;
+
     /**
      Records the total number of directories found.
      */
@@ -134,6 +142,11 @@ DirCaseFileFoundCallback(
         YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("Updating %y...\n"), FilePath);
     }
 
+    if (DirCaseContext->UpdateQueue != NULL) {
+        YoriLibFileUpdateQueueSubmit(DirCaseContext->UpdateQueue, FilePath);
+        return TRUE;
+    }
+
     AccessRequired = FILE_WRITE_ATTRIBUTES | SYNCHRONIZE;
 
     hDir = CreateFile(FilePath->StartOfString,
@@ -262,7 +275,10 @@ ENTRYPOINT(
     WORD MatchFlags;
     BOOLEAN BasicEnumeration = FALSE;
     BOOLEAN OperationFound;
+    DWORD ThreadCount = 1;
     DIRCASE_CONTEXT DirCaseContext;
+    YORILIB_FILE_UPDATE_OPERATION UpdateOperation;
+    YORILIB_FILE_UPDATE_STATS UpdateStats;
     YORI_STRING Arg;
     DWORD MajorVersion;
     DWORD MinorVersion;
@@ -294,7 +310,19 @@ ENTRYPOINT(
                 DirCaseContext.CaseSensitive = TRUE;
                 OperationFound = TRUE;
                 ArgumentUnderstood = TRUE;
-
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("j")) == 0) {
+                if (i + 1 < ArgC) {
+                    YORI_MAX_SIGNED_T LlThreadCount = 0;
+                    YORI_ALLOC_SIZE_T CharsConsumed = 0;
+                    if (YoriLibStringToNumber(&ArgV[i + 1], TRUE, &LlThreadCount, &CharsConsumed) &&
+                        CharsConsumed > 0 &&
+                        LlThreadCount > 0) {
+
+                        ThreadCount = (DWORD)LlThreadCount;
+                        ArgumentUnderstood = TRUE;
+                        i++;
+                    }
+                }
             } else if (YoriLibCompareStringLitIns(&Arg, _T("s")) == 0) {
                 DirCaseContext.Recursive = TRUE;
                 ArgumentUnderstood = TRUE;
@@ -348,6 +376,14 @@ ENTRYPOINT(
         MatchFlags |= YORILIB_FILEENUM_BASIC_EXPANSION;
     }
 
+    if (ThreadCount > 1) {
+        ZeroMemory(&UpdateOperation, sizeof(UpdateOperation));
+        UpdateOperation.Flags = YORILIB_FILE_UPDATE_SET_CASE_SENSITIVITY;
+        UpdateOperation.CaseSensitive = DirCaseContext.CaseSensitive;
+        UpdateOperation.ProgramName = _T("dircase");
+        DirCaseContext.UpdateQueue = YoriLibFileUpdateQueueCreate(&UpdateOperation, ThreadCount);
+    }
+
     for (i = StartArg; i < ArgC; i++) {
 
         YoriLibForEachFile(&ArgV[i],
@@ -358,6 +394,15 @@ ENTRYPOINT(
                            &DirCaseContext);
     }
 
+    if (DirCaseContext.UpdateQueue != NULL) {
+        if (DirCaseContext.Verbose) {
+            YoriLibFileUpdateQueueDisplayStats(DirCaseContext.UpdateQueue);
+        }
+        YoriLibFileUpdateQueueFlush(DirCaseContext.UpdateQueue, &UpdateStats);
+        DirCaseContext.DirsModified = (LONGLONG)UpdateStats.FilesUpdated;
+        YoriLibFileUpdateQueueDestroy(DirCaseContext.UpdateQueue);
+    }
+
     if (DirCaseContext.DirsFound == 0) {
         YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("dircase: no matching files found\n"));
     }
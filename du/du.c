@@ -35,8 +35,8 @@ CHAR strDuHelpText[] =
         "\n"
         "Display disk space used within directories.\n"
         "\n"
-        "DU [-license] [-a] [-b] [-c] [-color] [-d] [-h] [-r <num>] [-s <size>]\n"
-        "   [-w] [<spec>...]\n"
+        "DU [-license] [-a] [-b] [-c] [-color] [-d] [-h] [-k <file>] [-l] [-m]\n"
+        "   [-r <num>] [-s <size>] [-top <num>] [-u] [-w] [<spec>...]\n"
         "\n"
         "   -a             Enable all features for maximum accuracy\n"
         "   -b             Use basic search criteria for files only\n"
@@ -44,8 +44,12 @@ CHAR strDuHelpText[] =
         "   -color         Use file color highlighting\n"
         "   -d             Include space used by alternate data streams\n"
         "   -h             Average space used across multiple hard links\n"
+        "   -k <file>      Cache directory sizes in file and only rescan changed directories\n"
+        "   -l             Count files with multiple hard links once\n"
+        "   -m             Read the MFT of local NTFS volumes directly (requires admin)\n"
         "   -r <num>       The maximum recursion depth to display\n"
         "   -s <size>      Only display directories containing at least size bytes\n"
+        "   -top <num>     Only display the num largest directories, largest first\n"
         "   -u             Round space up to file allocation unit or cluster size\n"
         "   -w             Count files backed by a WIM archive as zero size\n";
 
@@ -120,8 +124,437 @@ typedef struct _DU_DIRECTORY_STACK {
      enabled.
      */
     LONGLONG AllocationSize;
+
+    /**
+     When scanning a volume, the next link to a child directory of this
+     directory which has not yet been processed.
+     */
+    DWORD ScanNextChildLink;
 } DU_DIRECTORY_STACK, *PDU_DIRECTORY_STACK;
 
+/**
+ The signature at the start of a du cache file, which is "YDUC".
+ */
+#define DU_CACHE_SIGNATURE 0x43554459
+
+/**
+ The version of the du cache file format.  This should be incremented if
+ the layout of the file changes so an older file is not misinterpreted.
+ */
+#define DU_CACHE_VERSION 1
+
+/**
+ Indicates the cache was generated with file sizes rounded to allocation
+ units.
+ */
+#define DU_CACHE_OPTION_ALLOCATION_SIZE      (0x00000001)
+
+/**
+ Indicates the cache was generated with compressed file sizes.
+ */
+#define DU_CACHE_OPTION_COMPRESSED_SIZE      (0x00000002)
+
+/**
+ Indicates the cache was generated with sizes averaged across hard links.
+ */
+#define DU_CACHE_OPTION_AVERAGE_HARD_LINKS   (0x00000004)
+
+/**
+ Indicates the cache was generated including named streams.
+ */
+#define DU_CACHE_OPTION_NAMED_STREAMS        (0x00000008)
+
+/**
+ Indicates the cache was generated with WIM backed files counted as zero.
+ */
+#define DU_CACHE_OPTION_WIM_AS_ZERO          (0x00000010)
+
+/**
+ Round a size in a du cache file up to the alignment of each record.
+ */
+#define DU_CACHE_ALIGN(x) (((x) + 7) & ~7)
+
+/**
+ The size of the buffer used to read records from the USN journal.
+ */
+#define DU_CACHE_USN_BUFFER_SIZE (64 * 1024)
+
+/**
+ The header at the start of a du cache file.  Volume records follow the
+ header, and directory records follow the volume records.
+ */
+typedef struct _DU_CACHE_FILE_HEADER {
+
+    /**
+     Set to DU_CACHE_SIGNATURE.
+     */
+    DWORD Signature;
+
+    /**
+     Set to DU_CACHE_VERSION.
+     */
+    DWORD Version;
+
+    /**
+     The size of the entire file in bytes.  This allows a file that was only
+     partially written to be detected and ignored.
+     */
+    DWORD FileSize;
+
+    /**
+     The set of DU_CACHE_OPTION flags describing how the sizes in the file
+     were calculated.  If these do not match the current options, the
+     cache is ignored.
+     */
+    DWORD Options;
+
+    /**
+     The number of volume records in the file.
+     */
+    DWORD VolumeCount;
+
+    /**
+     The number of directory records in the file.
+     */
+    DWORD DirectoryCount;
+} DU_CACHE_FILE_HEADER, *PDU_CACHE_FILE_HEADER;
+
+/**
+ A record in a du cache file describing the state of a volume when the
+ directories on it were scanned.  The volume name follows this structure.
+ */
+typedef struct _DU_CACHE_FILE_VOLUME {
+
+    /**
+     The identifier of the USN journal on the volume, or zero if the journal
+     could not be queried.
+     */
+    DWORDLONG UsnJournalId;
+
+    /**
+     The next USN in the journal when the volume was scanned.  Any change
+     to a directory after the scan has a USN at least this large.
+     */
+    LONGLONG NextUsn;
+
+    /**
+     The length of the volume name, in characters.
+     */
+    DWORD NameLength;
+
+    /**
+     Reserved for alignment.
+     */
+    DWORD Reserved;
+} DU_CACHE_FILE_VOLUME, *PDU_CACHE_FILE_VOLUME;
+
+/**
+ A record in a du cache file describing a single directory.  The full path
+ to the directory follows this structure.
+ */
+typedef struct _DU_CACHE_FILE_DIRECTORY {
+
+    /**
+     The file ID of the directory.
+     */
+    LARGE_INTEGER FileId;
+
+    /**
+     The last write time of the directory.
+     */
+    LARGE_INTEGER LastWriteTime;
+
+    /**
+     The number of bytes consumed by files within the directory, not
+     including any subdirectories.
+     */
+    LONGLONG SpaceConsumed;
+
+    /**
+     The length of the directory path, in characters.
+     */
+    DWORD NameLength;
+
+    /**
+     Reserved for alignment.
+     */
+    DWORD Reserved;
+} DU_CACHE_FILE_DIRECTORY, *PDU_CACHE_FILE_DIRECTORY;
+
+/**
+ A private definition of READ_USN_JOURNAL_DATA_V0.  Newer compilation
+ environments define READ_USN_JOURNAL_DATA as a later version which
+ requires additional fields.
+ */
+typedef struct _DU_READ_USN_JOURNAL_DATA {
+
+    /**
+     The first USN to return.
+     */
+    LONGLONG StartUsn;
+
+    /**
+     The set of change reasons to return.
+     */
+    DWORD ReasonMask;
+
+    /**
+     If TRUE, only return records generated when a file is closed.
+     */
+    DWORD ReturnOnlyOnClose;
+
+    /**
+     The amount of time to wait for records.
+     */
+    DWORDLONG Timeout;
+
+    /**
+     The number of bytes of records to wait for.
+     */
+    DWORDLONG BytesToWaitFor;
+
+    /**
+     The identifier of the journal to read from.
+     */
+    DWORDLONG UsnJournalId;
+} DU_READ_USN_JOURNAL_DATA, *PDU_READ_USN_JOURNAL_DATA;
+
+/**
+ The mechanism used to determine whether a directory has changed since it
+ was recorded in the cache.
+ */
+typedef enum _DU_CACHE_TRACKING {
+
+    /**
+     Changes cannot be determined, so every directory is scanned.
+     */
+    DuCacheTrackRescan = 0,
+
+    /**
+     A directory is considered changed if its last write time changed.
+     This detects files being added, removed or renamed, but not files
+     changing size.
+     */
+    DuCacheTrackLastWrite = 1,
+
+    /**
+     A directory is considered changed if the USN journal contains a record
+     for it or any object within it.
+     */
+    DuCacheTrackUsn = 2
+} DU_CACHE_TRACKING;
+
+/**
+ Information about a single volume within the cache.
+ */
+typedef struct _DU_CACHE_VOLUME {
+
+    /**
+     The links of this volume within the list of volumes in the cache.
+     */
+    YORI_LIST_ENTRY ListEntry;
+
+    /**
+     The name of the volume.  This points into the same allocation as this
+     structure.
+     */
+    YORI_STRING Name;
+
+    /**
+     The identifier of the USN journal on the volume, or zero if the journal
+     could not be queried.
+     */
+    DWORDLONG UsnJournalId;
+
+    /**
+     The next USN in the journal when the volume was scanned.
+     */
+    LONGLONG NextUsn;
+
+    /**
+     The mechanism used to detect changes to directories on this volume.
+     Only meaningful if Prepared is TRUE.
+     */
+    DU_CACHE_TRACKING Tracking;
+
+    /**
+     TRUE if changes on the volume have been determined in this invocation.
+     */
+    BOOLEAN Prepared;
+} DU_CACHE_VOLUME, *PDU_CACHE_VOLUME;
+
+/**
+ Information about a single directory within the cache.
+ */
+typedef struct _DU_CACHE_DIRECTORY {
+
+    /**
+     The entry for this directory within the hash table of paths.
+     */
+    YORI_HASH_ENTRY PathHashEntry;
+
+    /**
+     The entry for this directory within the hash table of file IDs.  This
+     is only inserted for directories loaded from the cache file.
+     */
+    YORI_HASH_ENTRY IdHashEntry;
+
+    /**
+     The first child directory of this directory, when loaded from the
+     cache file.
+     */
+    struct _DU_CACHE_DIRECTORY *FirstChild;
+
+    /**
+     The next child directory of this directory's parent, when loaded from
+     the cache file.
+     */
+    struct _DU_CACHE_DIRECTORY *NextSibling;
+
+    /**
+     The full path to the directory, in escaped form.  This points into the
+     same allocation as this structure.
+     */
+    YORI_STRING Path;
+
+    /**
+     The file ID of the directory.
+     */
+    LARGE_INTEGER FileId;
+
+    /**
+     The last write time of the directory.
+     */
+    LARGE_INTEGER LastWriteTime;
+
+    /**
+     The number of bytes consumed by files within the directory, not
+     including any subdirectories.
+     */
+    LONGLONG SpaceConsumed;
+
+    /**
+     TRUE if this directory was loaded from the cache file.
+     */
+    BOOLEAN Loaded;
+
+    /**
+     TRUE if the USN journal indicates this directory has changed.
+     */
+    BOOLEAN Changed;
+
+    /**
+     TRUE if this directory has been found in this invocation, so the
+     information above is current.
+     */
+    BOOLEAN Visited;
+
+    /**
+     A buffer for the file ID in string form, used as the key for the
+     hash table of file IDs.
+     */
+    TCHAR IdKeyBuffer[20];
+} DU_CACHE_DIRECTORY, *PDU_CACHE_DIRECTORY;
+
+/**
+ A cache of the space consumed by directories, allowing directories that
+ have not changed since a previous invocation to be reported without
+ enumerating them.
+ */
+typedef struct _DU_CACHE {
+
+    /**
+     The fully qualified name of the cache file.  Empty if no cache is in
+     use.
+     */
+    YORI_STRING FileName;
+
+    /**
+     A hash table of directories, indexed by full path.
+     */
+    PYORI_HASH_TABLE PathTable;
+
+    /**
+     A hash table of directories loaded from the cache file, indexed by
+     file ID.
+     */
+    PYORI_HASH_TABLE IdTable;
+
+    /**
+     A list of volumes containing directories in the cache.
+     */
+    YORI_LIST_ENTRY VolumeList;
+
+    /**
+     The set of DU_CACHE_OPTION flags describing the current options.
+     */
+    DWORD Options;
+
+    /**
+     The mechanism used to detect changes to directories on the volume that
+     is currently being scanned.
+     */
+    DU_CACHE_TRACKING Tracking;
+
+    /**
+     Set to TRUE if a scan did not complete, so the cache should not be
+     saved.
+     */
+    BOOLEAN Incomplete;
+} DU_CACHE, *PDU_CACHE;
+
+/**
+ The number of slots allocated when a set of file IDs is first created.
+ This must be a power of two.
+ */
+#define DU_LINK_SET_INITIAL_SLOTS (0x1000)
+
+/**
+ A set of file IDs on a single volume which have already been counted, so
+ that files with multiple hard links are only counted once.  This is an
+ open addressed hash table of file IDs, where a zero file ID indicates an
+ empty slot.  Only files with more than one link are inserted, so the set
+ remains small relative to the number of files found.
+ */
+typedef struct _DU_LINK_SET {
+
+    /**
+     The serial number of the volume containing the files.
+     */
+    DWORD VolumeSerialNumber;
+
+    /**
+     The number of slots in the table.  This is always a power of two.
+     */
+    DWORD SlotCount;
+
+    /**
+     The number of slots that contain a file ID.
+     */
+    DWORD ItemCount;
+
+    /**
+     The array of slots, each containing a file ID or zero.
+     */
+    PDWORDLONG Slots;
+} DU_LINK_SET, *PDU_LINK_SET;
+
+/**
+ A directory recorded for the report of the largest directories.
+ */
+typedef struct _DU_TOP_ENTRY {
+
+    /**
+     The name of the directory, in escaped form.
+     */
+    YORI_STRING DirectoryName;
+
+    /**
+     The amount of bytes consumed by the directory, including its children.
+     */
+    LARGE_INTEGER Size;
+} DU_TOP_ENTRY, *PDU_TOP_ENTRY;
+
 /**
  Context passed to the callback which is invoked for each file found.
  */
@@ -170,6 +603,18 @@ typedef struct _DU_CONTEXT {
      */
     BOOLEAN AverageHardLinkSize;
 
+    /**
+     Count the size of files with multiple hard links once, in the first
+     directory where they are found.
+     */
+    BOOLEAN CountHardLinksOnce;
+
+    /**
+     Set to TRUE if a file ID could not be recorded due to allocation
+     failure, so the user has been told that results may be inaccurate.
+     */
+    BOOLEAN LinkSetAllocationFailed;
+
     /**
      Count space used by alternate data streams on the file.
      */
@@ -181,6 +626,28 @@ typedef struct _DU_CONTEXT {
      */
     BOOLEAN WimBackedFilesAsZero;
 
+    /**
+     Read the MFT of NTFS volumes directly rather than enumerating files.
+     */
+    BOOLEAN VolumeScan;
+
+    /**
+     When scanning a volume, the number of bytes per cluster on the volume.
+     Zero when enumerating files.
+     */
+    DWORD VolumeScanClusterSize;
+
+    /**
+     The name of the volume described by VolumeScanResults, so that multiple
+     arguments on the same volume only scan it once.
+     */
+    YORI_STRING ScannedVolumeName;
+
+    /**
+     The results of the most recent volume scan.
+     */
+    YORILIB_NTFS_SCAN VolumeScanResults;
+
     /**
      The color to display file sizes in.
      */
@@ -206,13 +673,145 @@ typedef struct _DU_CONTEXT {
      */
     YORI_LIB_FILE_FILTER ColorRules;
 
-} DU_CONTEXT, *PDU_CONTEXT;
+    /**
+     Information about directories found in a previous invocation, which
+     is updated with directories found in this invocation.
+     */
+    DU_CACHE Cache;
 
-/**
- Deallocate all child allocations within a DU_CONTEXT structure.  The
- structure itself is typically stack allocated and will not be freed.
+    /**
+     An array of sets of file IDs that have been counted, one for each
+     volume that files with multiple hard links have been found on.
+     */
+    PDU_LINK_SET LinkSets;
 
- @param DuContext Pointer to the DuContext to clean up.
+    /**
+     The number of elements in the LinkSets array.
+     */
+    DWORD LinkSetCount;
+
+    /**
+     If nonzero, the number of largest directories to display once all
+     directories have been processed.  If zero, each directory is displayed
+     as it is processed.
+     */
+    DWORD TopCount;
+
+    /**
+     The number of elements in the TopEntries array which are populated.
+     */
+    DWORD TopEntriesPopulated;
+
+    /**
+     An array of TopCount elements describing the largest directories found
+     so far.  This is arranged as a heap where the smallest directory is the
+     first element, so each directory only needs to be compared against it
+     to determine whether the directory should be recorded.
+     */
+    PDU_TOP_ENTRY TopEntries;
+
+} DU_CONTEXT, *PDU_CONTEXT;
+
+/**
+ Free all directories and volumes within the cache, leaving the cache
+ empty.
+
+ @param Cache Pointer to the cache.
+ */
+VOID
+DuCacheFreeEntries(
+    __in PDU_CACHE Cache
+    )
+{
+    PYORI_HASH_ENTRY HashEntry;
+    PYORI_HASH_ENTRY NextHashEntry;
+    PYORI_LIST_ENTRY ListEntry;
+    PDU_CACHE_DIRECTORY Directory;
+    PDU_CACHE_VOLUME Volume;
+
+    if (Cache->PathTable != NULL) {
+        HashEntry = YoriLibHashGetNextEntry(Cache->PathTable, NULL);
+        while (HashEntry != NULL) {
+            NextHashEntry = YoriLibHashGetNextEntry(Cache->PathTable, HashEntry);
+            Directory = HashEntry->Context;
+            YoriLibHashRemoveByEntry(HashEntry);
+            if (Directory->Loaded) {
+                YoriLibHashRemoveByEntry(&Directory->IdHashEntry);
+            }
+            YoriLibFree(Directory);
+            HashEntry = NextHashEntry;
+        }
+    }
+
+    if (Cache->VolumeList.Next != NULL) {
+        ListEntry = YoriLibGetNextListEntry(&Cache->VolumeList, NULL);
+        while (ListEntry != NULL) {
+            Volume = CONTAINING_RECORD(ListEntry, DU_CACHE_VOLUME, ListEntry);
+            YoriLibRemoveListItem(ListEntry);
+            YoriLibFree(Volume);
+            ListEntry = YoriLibGetNextListEntry(&Cache->VolumeList, NULL);
+        }
+    }
+}
+
+/**
+ Deallocate all child allocations within a cache.  The structure itself is
+ part of the du context and will not be freed.
+
+ @param Cache Pointer to the cache to clean up.
+ */
+VOID
+DuCacheCleanup(
+    __in PDU_CACHE Cache
+    )
+{
+    DuCacheFreeEntries(Cache);
+
+    if (Cache->PathTable != NULL) {
+        YoriLibFreeEmptyHashTable(Cache->PathTable);
+        Cache->PathTable = NULL;
+    }
+
+    if (Cache->IdTable != NULL) {
+        YoriLibFreeEmptyHashTable(Cache->IdTable);
+        Cache->IdTable = NULL;
+    }
+
+    YoriLibFreeStringContents(&Cache->FileName);
+}
+
+/**
+ Free the sets of file IDs that have been counted, so that files with
+ multiple hard links are counted again when found within a later argument.
+
+ @param DuContext Pointer to the DuContext containing the sets to free.
+ */
+VOID
+DuFreeLinkSets(
+    __in PDU_CONTEXT DuContext
+    )
+{
+    DWORD Index;
+
+    for (Index = 0; Index < DuContext->LinkSetCount; Index++) {
+        if (DuContext->LinkSets[Index].Slots != NULL) {
+            YoriLibFree(DuContext->LinkSets[Index].Slots);
+        }
+    }
+
+    if (DuContext->LinkSets != NULL) {
+        YoriLibFree(DuContext->LinkSets);
+        DuContext->LinkSets = NULL;
+    }
+
+    DuContext->LinkSetCount = 0;
+}
+
+/**
+ Deallocate all child allocations within a DU_CONTEXT structure.  The
+ structure itself is typically stack allocated and will not be freed.
+
+ @param DuContext Pointer to the DuContext to clean up.
  */
 VOID
 DuCleanupContext(
@@ -233,6 +832,19 @@ DuCleanupContext(
     DuContext->StackAllocated = 0;
     DuContext->StackIndex = 0;
     YoriLibFileFiltFreeFilter(&DuContext->ColorRules);
+    YoriLibFreeStringContents(&DuContext->ScannedVolumeName);
+    YoriLibNtfsScanCleanup(&DuContext->VolumeScanResults);
+    DuCacheCleanup(&DuContext->Cache);
+    DuFreeLinkSets(DuContext);
+
+    if (DuContext->TopEntries != NULL) {
+        for (Index = 0; Index < DuContext->TopCount; Index++) {
+            YoriLibFreeStringContents(&DuContext->TopEntries[Index].DirectoryName);
+        }
+        YoriLibFree(DuContext->TopEntries);
+        DuContext->TopEntries = NULL;
+    }
+    DuContext->TopEntriesPopulated = 0;
 }
 
 /**
@@ -257,103 +869,305 @@ DuCloseStack(
 }
 
 /**
- Print the space consumed by a particular directory, and close out the
- directory's stack frame so it can be reused by the next directory.
+ Print the space consumed by a particular directory.
 
- @param DuContext Pointer to the DuContext which contains the directory to
-        display and close.
+ @param DuContext Pointer to the DuContext specifying display options.
 
- @param Depth Specifies the array index of the directory to display and close.
+ @param DirectoryName Pointer to the name of the directory, in escaped form.
 
- @return TRUE to indicate success, FALSE to indicate failure.
+ @param SizeToDisplay The amount of bytes consumed by the directory.
  */
-BOOL
-DuReportAndCloseStack(
+VOID
+DuDisplayDirectory(
     __in PDU_CONTEXT DuContext,
-    __in DWORD Depth
+    __in PYORI_STRING DirectoryName,
+    __in LARGE_INTEGER SizeToDisplay
     )
 {
     YORI_STRING UnescapedPath;
     PYORI_STRING StringToDisplay;
     YORI_STRING FileSizeString;
     TCHAR FileSizeStringBuffer[8];
-    LARGE_INTEGER SizeToDisplay;
     YORI_STRING VtAttribute;
     TCHAR VtAttributeBuffer[YORI_MAX_VT_ESCAPE_CHARS];
     YORILIB_COLOR_ATTRIBUTES Attribute;
 
-    PDU_DIRECTORY_STACK DirStack;
+    //
+    //  Convert the escaped path into a path for humans.
+    //
 
-    DirStack = &DuContext->DirStack[Depth];
+    YoriLibInitEmptyString(&UnescapedPath);
+    if (YoriLibUnescapePath(DirectoryName, &UnescapedPath)) {
+        StringToDisplay = &UnescapedPath;
+    } else {
+        StringToDisplay = DirectoryName;
+    }
 
-    if (DuContext->MaximumDepthToDisplay == 0 ||
-        Depth <= DuContext->MaximumDepthToDisplay) {
+    //
+    //  Convert the file size from a number of bytes to a short string
+    //  with a suffix
+    //
 
-        SizeToDisplay.QuadPart = DirStack->SpaceConsumedInChildren + DirStack->SpaceConsumedThisDirectory;
+    YoriLibInitEmptyString(&FileSizeString);
+    FileSizeString.StartOfString = FileSizeStringBuffer;
+    FileSizeString.LengthAllocated = sizeof(FileSizeStringBuffer)/sizeof(FileSizeStringBuffer[0]);
+    YoriLibFileSizeToString(&FileSizeString, &SizeToDisplay);
 
-        if (DuContext->MinimumDirectorySizeToDisplay.QuadPart == 0 ||
-            SizeToDisplay.QuadPart >= DuContext->MinimumDirectorySizeToDisplay.QuadPart) {
+    //
+    //  If the user requested it, determine the color to display with
+    //
 
-            //
-            //  Convert the escaped path into a path for humans.
-            //
+    YoriLibInitEmptyString(&VtAttribute);
+    if (DuContext->ColorRules.NumberCriteria) {
+        WIN32_FIND_DATA FileInfo;
 
-            YoriLibInitEmptyString(&UnescapedPath);
-            if (YoriLibUnescapePath(&DirStack->DirectoryName, &UnescapedPath)) {
-                StringToDisplay = &UnescapedPath;
-            } else {
-                StringToDisplay = &DirStack->DirectoryName;
-            }
+        VtAttribute.StartOfString = VtAttributeBuffer;
+        VtAttribute.LengthAllocated = sizeof(VtAttributeBuffer)/sizeof(VtAttributeBuffer[0]);
 
-            //
-            //  Convert the file size from a number of bytes to a short string
-            //  with a suffix
-            //
+        if (!YoriLibUpdateFindDataFromFileInformation(&FileInfo, DirectoryName->StartOfString, TRUE) || 
+            !YoriLibFileFiltCheckColorMatch(&DuContext->ColorRules, DirectoryName, &FileInfo, &Attribute)) {
+            Attribute.Ctrl = YORILIB_ATTRCTRL_WINDOW_BG | YORILIB_ATTRCTRL_WINDOW_FG;
+            Attribute.Win32Attr = (UCHAR)YoriLibVtGetDefaultColor();
+        }
+
+        YoriLibVtStringForTextAttribute(&VtAttribute, Attribute.Ctrl, Attribute.Win32Attr);
+    }
 
-            YoriLibInitEmptyString(&FileSizeString);
-            FileSizeString.StartOfString = FileSizeStringBuffer;
-            FileSizeString.LengthAllocated = sizeof(FileSizeStringBuffer)/sizeof(FileSizeStringBuffer[0]);
-            YoriLibFileSizeToString(&FileSizeString, &SizeToDisplay);
+    if (VtAttribute.LengthInChars > 0) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT,
+                      _T("%y%y%c[0m %y%y%c[0m\n"),
+                      &DuContext->FileSizeColorString,
+                      &FileSizeString,
+                      27,
+                      &VtAttribute,
+                      StringToDisplay,
+                      27);
+    } else {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y %y\n"), &FileSizeString, StringToDisplay);
+    }
 
-            //
-            //  If the user requested it, determine the color to display with
-            //
+    YoriLibFreeStringContents(&UnescapedPath);
+}
 
-            YoriLibInitEmptyString(&VtAttribute);
-            if (DuContext->ColorRules.NumberCriteria) {
-                WIN32_FIND_DATA FileInfo;
+/**
+ Exchange two elements in the array of largest directories.
 
-                VtAttribute.StartOfString = VtAttributeBuffer;
-                VtAttribute.LengthAllocated = sizeof(VtAttributeBuffer)/sizeof(VtAttributeBuffer[0]);
+ @param First Pointer to the first element.
 
-                if (!YoriLibUpdateFindDataFromFileInformation(&FileInfo, DirStack->DirectoryName.StartOfString, TRUE) || 
-                    !YoriLibFileFiltCheckColorMatch(&DuContext->ColorRules, &DirStack->DirectoryName, &FileInfo, &Attribute)) {
-                    Attribute.Ctrl = YORILIB_ATTRCTRL_WINDOW_BG | YORILIB_ATTRCTRL_WINDOW_FG;
-                    Attribute.Win32Attr = (UCHAR)YoriLibVtGetDefaultColor();
-                }
+ @param Second Pointer to the second element.
+ */
+VOID
+DuTopSwapEntries(
+    __inout PDU_TOP_ENTRY First,
+    __inout PDU_TOP_ENTRY Second
+    )
+{
+    DU_TOP_ENTRY Swap;
 
-                YoriLibVtStringForTextAttribute(&VtAttribute, Attribute.Ctrl, Attribute.Win32Attr);
-            }
+    memcpy(&Swap, First, sizeof(DU_TOP_ENTRY));
+    memcpy(First, Second, sizeof(DU_TOP_ENTRY));
+    memcpy(Second, &Swap, sizeof(DU_TOP_ENTRY));
+}
+
+/**
+ Move an element in the heap of largest directories towards the end of the
+ array until it is no larger than any of its children.
+
+ @param Entries Pointer to the array of largest directories.
+
+ @param Count The number of elements in the heap.
+
+ @param Index The index of the element to move.
+ */
+VOID
+DuTopSiftDown(
+    __inout_ecount(Count) PDU_TOP_ENTRY Entries,
+    __in DWORD Count,
+    __in DWORD Index
+    )
+{
+    DWORD Child;
+
+    while (TRUE) {
+        Child = Index * 2 + 1;
+        if (Child >= Count) {
+            break;
+        }
+
+        if (Child + 1 < Count &&
+            Entries[Child + 1].Size.QuadPart < Entries[Child].Size.QuadPart) {
+
+            Child++;
+        }
+
+        if (Entries[Index].Size.QuadPart <= Entries[Child].Size.QuadPart) {
+            break;
+        }
+
+        DuTopSwapEntries(&Entries[Index], &Entries[Child]);
+        Index = Child;
+    }
+}
+
+/**
+ Record a directory for the report of the largest directories if it is
+ larger than the smallest directory recorded so far, or if fewer than the
+ requested number of directories have been recorded.
+
+ @param DuContext Pointer to the DuContext containing the largest
+        directories found so far.
+
+ @param DirectoryName Pointer to the name of the directory, in escaped form.
+
+ @param Size The amount of bytes consumed by the directory.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+DuTopRecordDirectory(
+    __in PDU_CONTEXT DuContext,
+    __in PYORI_STRING DirectoryName,
+    __in LARGE_INTEGER Size
+    )
+{
+    PDU_TOP_ENTRY Entries;
+    PDU_TOP_ENTRY Entry;
+    DWORD Index;
+    DWORD Parent;
+
+    Entries = DuContext->TopEntries;
+
+    if (DuContext->TopEntriesPopulated < DuContext->TopCount) {
+        Index = DuContext->TopEntriesPopulated;
+    } else if (Size.QuadPart > Entries[0].Size.QuadPart) {
+        Index = 0;
+    } else {
+        return TRUE;
+    }
+
+    //
+    //  Keep the allocation for the name of any directory being replaced in
+    //  the hope that it is large enough for this one.  The name is NULL
+    //  terminated so that the directory can be opened when displayed.
+    //
+
+    Entry = &Entries[Index];
+    if (Entry->DirectoryName.LengthAllocated <= DirectoryName->LengthInChars) {
+        YoriLibFreeStringContents(&Entry->DirectoryName);
+        if (!YoriLibAllocateString(&Entry->DirectoryName, DirectoryName->LengthInChars + 80)) {
+            return FALSE;
+        }
+    }
+
+    memcpy(Entry->DirectoryName.StartOfString, DirectoryName->StartOfString, DirectoryName->LengthInChars * sizeof(TCHAR));
+    Entry->DirectoryName.StartOfString[DirectoryName->LengthInChars] = '\0';
+    Entry->DirectoryName.LengthInChars = DirectoryName->LengthInChars;
+    Entry->Size.QuadPart = Size.QuadPart;
+
+    //
+    //  If the smallest directory was replaced, move the new one down to
+    //  its place in the heap.  If the heap isn't full yet, add the new
+    //  directory to the end and move it up to its place.
+    //
+
+    if (Index == 0 && DuContext->TopEntriesPopulated == DuContext->TopCount) {
+        DuTopSiftDown(Entries, DuContext->TopEntriesPopulated, 0);
+        return TRUE;
+    }
+
+    DuContext->TopEntriesPopulated++;
+    while (Index > 0) {
+        Parent = (Index - 1) / 2;
+        if (Entries[Parent].Size.QuadPart <= Entries[Index].Size.QuadPart) {
+            break;
+        }
+        DuTopSwapEntries(&Entries[Parent], &Entries[Index]);
+        Index = Parent;
+    }
+
+    return TRUE;
+}
+
+/**
+ Display the largest directories found, largest first.
+
+ @param DuContext Pointer to the DuContext containing the largest
+        directories found.
+ */
+VOID
+DuTopDisplay(
+    __in PDU_CONTEXT DuContext
+    )
+{
+    PDU_TOP_ENTRY Entries;
+    DWORD Count;
+    DWORD Index;
+
+    //
+    //  Sort the heap by repeatedly moving the smallest remaining directory
+    //  to the end of the array, which leaves the largest directory first.
+    //
+
+    Entries = DuContext->TopEntries;
+    Count = DuContext->TopEntriesPopulated;
+    while (Count > 1) {
+        Count--;
+        DuTopSwapEntries(&Entries[0], &Entries[Count]);
+        DuTopSiftDown(Entries, Count, 0);
+    }
+
+    for (Index = 0; Index < DuContext->TopEntriesPopulated; Index++) {
+        if (YoriLibIsOperationCancelled()) {
+            break;
+        }
+        DuDisplayDirectory(DuContext, &Entries[Index].DirectoryName, Entries[Index].Size);
+    }
+}
+
+/**
+ Print the space consumed by a particular directory, and close out the
+ directory's stack frame so it can be reused by the next directory.  If only
+ the largest directories are being displayed, the directory is recorded
+ rather than displayed.
+
+ @param DuContext Pointer to the DuContext which contains the directory to
+        display and close.
+
+ @param Depth Specifies the array index of the directory to display and close.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+DuReportAndCloseStack(
+    __in PDU_CONTEXT DuContext,
+    __in DWORD Depth
+    )
+{
+    LARGE_INTEGER SizeToDisplay;
+    PDU_DIRECTORY_STACK DirStack;
+    BOOL Result;
+
+    DirStack = &DuContext->DirStack[Depth];
+    Result = TRUE;
+
+    if (DuContext->MaximumDepthToDisplay == 0 ||
+        Depth <= DuContext->MaximumDepthToDisplay) {
+
+        SizeToDisplay.QuadPart = DirStack->SpaceConsumedInChildren + DirStack->SpaceConsumedThisDirectory;
+
+        if (DuContext->MinimumDirectorySizeToDisplay.QuadPart == 0 ||
+            SizeToDisplay.QuadPart >= DuContext->MinimumDirectorySizeToDisplay.QuadPart) {
 
-            if (VtAttribute.LengthInChars > 0) {
-                YoriLibOutput(YORI_LIB_OUTPUT_STDOUT,
-                              _T("%y%y%c[0m %y%y%c[0m\n"),
-                              &DuContext->FileSizeColorString,
-                              &FileSizeString,
-                              27,
-                              &VtAttribute,
-                              StringToDisplay,
-                              27);
+            if (DuContext->TopCount > 0) {
+                Result = DuTopRecordDirectory(DuContext, &DirStack->DirectoryName, SizeToDisplay);
             } else {
-                YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y %y\n"), &FileSizeString, StringToDisplay);
+                DuDisplayDirectory(DuContext, &DirStack->DirectoryName, SizeToDisplay);
             }
-
-            YoriLibFreeStringContents(&UnescapedPath);
         }
     }
 
     DuCloseStack(DirStack);
-    return TRUE;
+    return Result;
 }
 
 /**
@@ -442,7 +1256,9 @@ DuInitializeDirectoryStack(
     //  fail when called on a directory.
     //
 
-    if (DuContext->AllocationSize) {
+    if (DuContext->AllocationSize && DuContext->VolumeScanClusterSize != 0) {
+        DirStack->AllocationSize = DuContext->VolumeScanClusterSize;
+    } else if (DuContext->AllocationSize) {
         if (!GetDiskFreeSpace(DirStack->DirectoryName.StartOfString, &SectorsPerCluster, &BytesPerSector, &NumberOfFreeClusters, &TotalNumberOfClusters)) {
             YORI_STRING EffectiveRoot;
 
@@ -471,37 +1287,250 @@ DuInitializeDirectoryStack(
 }
 
 /**
- Count the amount of disk space to attribute to a file given the user selected
- options.
+ Return the slot that a file ID should be placed in within a set of file
+ IDs, before accounting for collisions.  File IDs tend to be sequential,
+ so the bits are mixed to distribute them across the table.
 
- @param DuContext Context specifying the accounting options to apply.
+ @param LinkSet Pointer to the set.
 
- @param DirStack Pointer to the directory stack indicating the allocation size
-        used for the directory.
+ @param FileId The file ID.
 
- @param FilePath Pointer to a fully specified path to the file.
+ @return The index of the preferred slot for the file ID.
+ */
+DWORD
+DuLinkSetGetSlot(
+    __in PDU_LINK_SET LinkSet,
+    __in DWORDLONG FileId
+    )
+{
+    DWORDLONG Hash;
 
- @param FileInfo Pointer to the block of data returned from directory
-        enumerate.
+    Hash = FileId;
+    Hash = Hash ^ (Hash >> 33);
+    Hash = Hash * 0xff51afd7ed558ccdULL;
+    Hash = Hash ^ (Hash >> 33);
 
- @return The number of bytes attributable to the file.
+    return (DWORD)Hash & (LinkSet->SlotCount - 1);
+}
+
+/**
+ Double the number of slots in a set of file IDs, or allocate the initial
+ slots if none are present.
+
+ @param LinkSet Pointer to the set.
+
+ @return TRUE to indicate success, FALSE on allocation failure.
  */
-LARGE_INTEGER
-DuCalculateSpaceUsedByFile(
-    __in PDU_CONTEXT DuContext,
-    __in PDU_DIRECTORY_STACK DirStack,
-    __in PYORI_STRING FilePath,
-    __in PWIN32_FIND_DATA FileInfo
+BOOL
+DuLinkSetGrow(
+    __in PDU_LINK_SET LinkSet
     )
 {
-    LARGE_INTEGER FileSize;
-    HANDLE FileHandle = INVALID_HANDLE_VALUE;
-    BOOL ForceSizeZero = FALSE;
-    BOOL ReportedOpenError = FALSE;
+    PDWORDLONG OldSlots;
+    DWORD OldSlotCount;
+    DWORD NewSlotCount;
+    DWORD Index;
+    DWORD Slot;
+    YORI_MAX_UNSIGNED_T BytesRequired;
+
+    OldSlots = LinkSet->Slots;
+    OldSlotCount = LinkSet->SlotCount;
+    if (OldSlotCount == 0) {
+        NewSlotCount = DU_LINK_SET_INITIAL_SLOTS;
+    } else {
+        NewSlotCount = OldSlotCount * 2;
+        if (NewSlotCount < OldSlotCount) {
+            return FALSE;
+        }
+    }
 
-    FileSize.QuadPart = 0;
+    BytesRequired = (YORI_MAX_UNSIGNED_T)NewSlotCount * sizeof(DWORDLONG);
+    if (!YoriLibIsSizeAllocatable(BytesRequired)) {
+        return FALSE;
+    }
 
-    if (DuContext->AverageHardLinkSize || DuContext->WimBackedFilesAsZero) {
+    LinkSet->Slots = YoriLibMalloc((YORI_ALLOC_SIZE_T)BytesRequired);
+    if (LinkSet->Slots == NULL) {
+        LinkSet->Slots = OldSlots;
+        return FALSE;
+    }
+
+    ZeroMemory(LinkSet->Slots, (YORI_ALLOC_SIZE_T)BytesRequired);
+    LinkSet->SlotCount = NewSlotCount;
+
+    for (Index = 0; Index < OldSlotCount; Index++) {
+        if (OldSlots[Index] != 0) {
+            Slot = DuLinkSetGetSlot(LinkSet, OldSlots[Index]);
+            while (LinkSet->Slots[Slot] != 0) {
+                Slot = (Slot + 1) & (NewSlotCount - 1);
+            }
+            LinkSet->Slots[Slot] = OldSlots[Index];
+        }
+    }
+
+    if (OldSlots != NULL) {
+        YoriLibFree(OldSlots);
+    }
+
+    return TRUE;
+}
+
+/**
+ Insert a file ID into a set of file IDs if it is not already present.
+
+ @param LinkSet Pointer to the set.
+
+ @param FileId The file ID, which must not be zero.
+
+ @param Inserted On successful completion, set to TRUE if the file ID was
+        added to the set, or FALSE if it was already present.
+
+ @return TRUE to indicate success, FALSE on allocation failure.
+ */
+BOOL
+DuLinkSetInsert(
+    __in PDU_LINK_SET LinkSet,
+    __in DWORDLONG FileId,
+    __out PBOOLEAN Inserted
+    )
+{
+    DWORD Slot;
+
+    ASSERT(FileId != 0);
+
+    //
+    //  Keep the table at most three quarters full so that probe sequences
+    //  remain short.
+    //
+
+    if (LinkSet->SlotCount == 0 ||
+        LinkSet->ItemCount >= LinkSet->SlotCount - LinkSet->SlotCount / 4) {
+
+        if (!DuLinkSetGrow(LinkSet)) {
+            return FALSE;
+        }
+    }
+
+    Slot = DuLinkSetGetSlot(LinkSet, FileId);
+    while (LinkSet->Slots[Slot] != 0) {
+        if (LinkSet->Slots[Slot] == FileId) {
+            *Inserted = FALSE;
+            return TRUE;
+        }
+        Slot = (Slot + 1) & (LinkSet->SlotCount - 1);
+    }
+
+    LinkSet->Slots[Slot] = FileId;
+    LinkSet->ItemCount++;
+    *Inserted = TRUE;
+    return TRUE;
+}
+
+/**
+ Determine whether a file with multiple hard links has already been counted,
+ and record that it has been counted if not.
+
+ @param DuContext Pointer to the du context containing the sets of file IDs
+        that have been counted.
+
+ @param HandleFileInfo Pointer to information about the file.
+
+ @return TRUE if the file has already been counted, FALSE if it has not.
+ */
+BOOL
+DuHasHardLinkBeenCounted(
+    __in PDU_CONTEXT DuContext,
+    __in PBY_HANDLE_FILE_INFORMATION HandleFileInfo
+    )
+{
+    PDU_LINK_SET LinkSet;
+    PDU_LINK_SET NewLinkSets;
+    DWORDLONG FileId;
+    DWORD Index;
+    BOOLEAN Inserted;
+
+    FileId = HandleFileInfo->nFileIndexHigh;
+    FileId = (FileId << 32) | HandleFileInfo->nFileIndexLow;
+    if (FileId == 0) {
+        return FALSE;
+    }
+
+    LinkSet = NULL;
+    for (Index = 0; Index < DuContext->LinkSetCount; Index++) {
+        if (DuContext->LinkSets[Index].VolumeSerialNumber == HandleFileInfo->dwVolumeSerialNumber) {
+            LinkSet = &DuContext->LinkSets[Index];
+            break;
+        }
+    }
+
+    if (LinkSet == NULL) {
+        NewLinkSets = YoriLibMalloc((YORI_ALLOC_SIZE_T)((DuContext->LinkSetCount + 1) * sizeof(DU_LINK_SET)));
+        if (NewLinkSets != NULL) {
+            if (DuContext->LinkSetCount > 0) {
+                memcpy(NewLinkSets, DuContext->LinkSets, DuContext->LinkSetCount * sizeof(DU_LINK_SET));
+                YoriLibFree(DuContext->LinkSets);
+            }
+            DuContext->LinkSets = NewLinkSets;
+            LinkSet = &DuContext->LinkSets[DuContext->LinkSetCount];
+            DuContext->LinkSetCount++;
+            ZeroMemory(LinkSet, sizeof(DU_LINK_SET));
+            LinkSet->VolumeSerialNumber = HandleFileInfo->dwVolumeSerialNumber;
+        }
+    }
+
+    if (LinkSet != NULL &&
+        DuLinkSetInsert(LinkSet, FileId, &Inserted)) {
+
+        return !Inserted;
+    }
+
+    //
+    //  If the file can't be recorded, count it, and tell the user that
+    //  results may count it more than once.
+    //
+
+    if (!DuContext->LinkSetAllocationFailed) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("du: out of memory, files with hard links may be counted more than once\n"));
+        DuContext->LinkSetAllocationFailed = TRUE;
+    }
+
+    return FALSE;
+}
+
+/**
+ Count the amount of disk space to attribute to a file given the user selected
+ options.
+
+ @param DuContext Context specifying the accounting options to apply.
+
+ @param DirStack Pointer to the directory stack indicating the allocation size
+        used for the directory.
+
+ @param FilePath Pointer to a fully specified path to the file.
+
+ @param FileInfo Pointer to the block of data returned from directory
+        enumerate.
+
+ @return The number of bytes attributable to the file.
+ */
+LARGE_INTEGER
+DuCalculateSpaceUsedByFile(
+    __in PDU_CONTEXT DuContext,
+    __in PDU_DIRECTORY_STACK DirStack,
+    __in PYORI_STRING FilePath,
+    __in PWIN32_FIND_DATA FileInfo
+    )
+{
+    LARGE_INTEGER FileSize;
+    HANDLE FileHandle = INVALID_HANDLE_VALUE;
+    BOOL ForceSizeZero = FALSE;
+    BOOL ReportedOpenError = FALSE;
+
+    FileSize.QuadPart = 0;
+
+    if (DuContext->AverageHardLinkSize ||
+        DuContext->CountHardLinksOnce ||
+        DuContext->WimBackedFilesAsZero) {
 
         FileHandle = CreateFile(FilePath->StartOfString,
                                 FILE_READ_ATTRIBUTES|SYNCHRONIZE,
@@ -584,232 +1613,1723 @@ DuCalculateSpaceUsedByFile(
         HANDLE hFind;
         WIN32_FIND_STREAM_DATA FindStreamData;
 
-        hFind = DllKernel32.pFindFirstStreamW(FilePath->StartOfString, 0, &FindStreamData, 0);
-        if (hFind == INVALID_HANDLE_VALUE) {
-            if (!ReportedOpenError) {
-                DWORD ErrorCode = GetLastError();
-                LPTSTR ErrText = YoriLibGetWinErrorText(ErrorCode);
-                YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Open of %y failed, results inaccurate: %s"), FilePath, ErrText);
-                YoriLibFreeWinErrorText(ErrText);
-            }
-        } else {
-            do {
-                if (_tcscmp(FindStreamData.cStreamName, L"::$DATA") != 0) {
-                    FileSize.QuadPart += FindStreamData.StreamSize.QuadPart;
-                    if (DuContext->AllocationSize) {
-                        FileSize.QuadPart = (FileSize.QuadPart + DirStack->AllocationSize - 1) & (~(DirStack->AllocationSize - 1));
-                    }
-                }
-            } while (DllKernel32.pFindNextStreamW(hFind, &FindStreamData));
-            FindClose(hFind);
+        hFind = DllKernel32.pFindFirstStreamW(FilePath->StartOfString, 0, &FindStreamData, 0);
+        if (hFind == INVALID_HANDLE_VALUE) {
+            if (!ReportedOpenError) {
+                DWORD ErrorCode = GetLastError();
+                LPTSTR ErrText = YoriLibGetWinErrorText(ErrorCode);
+                YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Open of %y failed, results inaccurate: %s"), FilePath, ErrText);
+                YoriLibFreeWinErrorText(ErrText);
+            }
+        } else {
+            do {
+                if (_tcscmp(FindStreamData.cStreamName, L"::$DATA") != 0) {
+                    FileSize.QuadPart += FindStreamData.StreamSize.QuadPart;
+                    if (DuContext->AllocationSize) {
+                        FileSize.QuadPart = (FileSize.QuadPart + DirStack->AllocationSize - 1) & (~(DirStack->AllocationSize - 1));
+                    }
+                }
+            } while (DllKernel32.pFindNextStreamW(hFind, &FindStreamData));
+            FindClose(hFind);
+        }
+    }
+
+    //
+    //  If the file has a size and hardlink averaging is reuqested, divide the
+    //  size found by the number of hard links.  If each file should be
+    //  counted once, count the size for the first link found and zero for
+    //  any later link.
+    //
+
+    if ((DuContext->AverageHardLinkSize || DuContext->CountHardLinksOnce) &&
+        FileHandle != INVALID_HANDLE_VALUE &&
+        FileSize.QuadPart != 0) {
+
+        BY_HANDLE_FILE_INFORMATION HandleFileInfo;
+
+        if (GetFileInformationByHandle(FileHandle, &HandleFileInfo)) {
+            if (HandleFileInfo.nNumberOfLinks > 1) {
+                if (DuContext->CountHardLinksOnce) {
+                    if (DuHasHardLinkBeenCounted(DuContext, &HandleFileInfo)) {
+                        FileSize.QuadPart = 0;
+                    }
+                } else {
+                    FileSize.QuadPart = FileSize.QuadPart / HandleFileInfo.nNumberOfLinks;
+                }
+            }
+        }
+    }
+
+    if (FileHandle != INVALID_HANDLE_VALUE) {
+        CloseHandle(FileHandle);
+    }
+
+
+    return FileSize;
+}
+
+
+
+/**
+ Ensure the directory stack has space for a directory at the specified
+ depth, reallocating it if necessary.
+
+ @param DuContext Pointer to the DuContext containing the directory stack.
+
+ @param Depth The depth which is required to be present in the stack.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+DuEnsureStackDepth(
+    __in PDU_CONTEXT DuContext,
+    __in DWORD Depth
+    )
+{
+    PDU_DIRECTORY_STACK NewStack;
+    DWORD BytesRequested;
+    YORI_ALLOC_SIZE_T BytesToAllocate;
+    YORI_ALLOC_SIZE_T Index;
+
+    if (Depth < DuContext->StackAllocated) {
+        return TRUE;
+    }
+
+    BytesRequested = (Depth + 8) * sizeof(DU_DIRECTORY_STACK);
+    BytesToAllocate = YoriLibMaximumAllocationInRange(BytesRequested, BytesRequested);
+    if (BytesToAllocate == 0) {
+        return FALSE;
+    }
+    NewStack = YoriLibMalloc(BytesToAllocate);
+    if (NewStack == NULL) {
+        return FALSE;
+    }
+
+    if (DuContext->StackAllocated > 0) {
+        memcpy(NewStack, DuContext->DirStack, DuContext->StackAllocated * sizeof(DU_DIRECTORY_STACK));
+        YoriLibFree(DuContext->DirStack);
+    }
+
+    for (Index = DuContext->StackAllocated; Index < Depth + 8; Index++) {
+        YoriLibInitEmptyString(&NewStack[Index].DirectoryName);
+        NewStack[Index].ObjectsFoundThisDirectory = 0;
+        NewStack[Index].SpaceConsumedThisDirectory = 0;
+        NewStack[Index].SpaceConsumedInChildren = 0;
+        NewStack[Index].ScanNextChildLink = YORILIB_NTFS_SCAN_NO_LINK;
+    }
+
+    DuContext->DirStack = NewStack;
+    DuContext->StackAllocated = (YORI_ALLOC_SIZE_T)Depth + 8;
+    return TRUE;
+}
+
+/**
+ A callback that is invoked when a file is found that matches a search criteria
+ specified in the set of strings to enumerate.
+
+ @param FilePath Pointer to the file path that was found.
+
+ @param FileInfo Information about the file.
+
+ @param Depth Recursion depth, ignored in this application.
+
+ @param Context Pointer to the du context structure indicating the
+        action to perform and populated with the number of objects found.
+
+ @return TRUE to continute enumerating, FALSE to abort.
+ */
+BOOL
+DuFileFoundCallback(
+    __in PYORI_STRING FilePath,
+    __in PWIN32_FIND_DATA FileInfo,
+    __in DWORD Depth,
+    __in PVOID Context
+    )
+{
+    PDU_CONTEXT DuContext = (PDU_CONTEXT)Context;
+    LPTSTR FilePart;
+    YORI_ALLOC_SIZE_T Index;
+
+    //
+    //  Depth can only describe the number of path seperators in a single
+    //  string, so cannot exceed the allocation granularity of the system
+    //
+
+    ASSERT(Depth < YORI_MAX_ALLOC_SIZE);
+
+    if (!DuEnsureStackDepth(DuContext, Depth)) {
+        return FALSE;
+    }
+
+    //
+    //  StackIndex would normally be populated except for the first item at
+    //  Depth == 0
+    //
+
+    if (DuContext->StackIndex > 0 || DuContext->DirStack[0].DirectoryName.LengthInChars > 0) {
+        Index = DuContext->StackIndex;
+        while (TRUE) {
+            YORI_ALLOC_SIZE_T StackDirLength;
+            StackDirLength = DuContext->DirStack[Index].DirectoryName.LengthInChars;
+            if (Depth >= Index &&
+                YoriLibCompareStringCnt(FilePath, &DuContext->DirStack[Index].DirectoryName, StackDirLength) == 0 &&
+                (FilePath->LengthInChars == StackDirLength ||
+                 YoriLibIsSep(FilePath->StartOfString[StackDirLength]) ||
+                 YoriLibIsSep(DuContext->DirStack[Index].DirectoryName.StartOfString[StackDirLength - 1]))) {
+
+                break;
+            }
+
+            if (Index > 0) {
+                DuContext->DirStack[Index - 1].SpaceConsumedInChildren +=
+                    DuContext->DirStack[Index].SpaceConsumedInChildren +
+                    DuContext->DirStack[Index].SpaceConsumedThisDirectory;
+            }
+            DuReportAndCloseStack(DuContext, Index);
+            if (Index == 0) {
+                break;
+            }
+            Index--;
+            DuContext->StackIndex--;
+        }
+    }
+
+    FilePart = YoriLibFindRightMostCharacter(FilePath, '\\');
+    ASSERT(FilePart != NULL);
+    if (FilePart != NULL) {
+        YORI_STRING ThisDirName;
+        YoriLibInitEmptyString(&ThisDirName);
+        ThisDirName.StartOfString = FilePath->StartOfString;
+        ThisDirName.LengthInChars = (YORI_ALLOC_SIZE_T)(FilePart - FilePath->StartOfString);
+        if (ThisDirName.LengthInChars == 6) {
+            ThisDirName.LengthInChars++;
+            if (!YoriLibIsPrefixedDriveLetterWithColonAndSlash(&ThisDirName)) {
+                ThisDirName.LengthInChars--;
+            }
+        }
+
+        Index = (YORI_ALLOC_SIZE_T)Depth;
+        while (TRUE) {
+            if (DuContext->DirStack[Index].DirectoryName.LengthInChars > 0) {
+
+                ASSERT(Index == DuContext->StackIndex);
+                ASSERT(YoriLibCompareString(&DuContext->DirStack[Index].DirectoryName, &ThisDirName) == 0);
+                break;
+            }
+            if (!DuInitializeDirectoryStack(DuContext, &DuContext->DirStack[Index], &ThisDirName)) {
+                return FALSE;
+            }
+            ASSERT(DuContext->DirStack[Index].ObjectsFoundThisDirectory == 0);
+            ASSERT(DuContext->DirStack[Index].SpaceConsumedThisDirectory == 0);
+            ASSERT(DuContext->DirStack[Index].SpaceConsumedInChildren == 0);
+            if (Index == 0) {
+                break;
+            }
+            Index--;
+            FilePart = YoriLibFindRightMostCharacter(&ThisDirName, '\\');
+            ASSERT(FilePart != NULL);
+            ThisDirName.LengthInChars = (YORI_ALLOC_SIZE_T)(FilePart - ThisDirName.StartOfString);
+            if (ThisDirName.LengthInChars == 6) {
+                ThisDirName.LengthInChars++;
+                if (!YoriLibIsPrefixedDriveLetterWithColonAndSlash(&ThisDirName)) {
+                    ThisDirName.LengthInChars--;
+                }
+            }
+        }
+    }
+
+    DuContext->StackIndex = (YORI_ALLOC_SIZE_T)Depth;
+    DuContext->DirStack[Depth].ObjectsFoundThisDirectory++;
+
+    if ((FileInfo->dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == 0) {
+        LARGE_INTEGER FileSize;
+        FileSize = DuCalculateSpaceUsedByFile(DuContext, &DuContext->DirStack[Depth], FilePath, FileInfo);
+        DuContext->DirStack[Depth].SpaceConsumedThisDirectory += FileSize.QuadPart;
+    }
+
+    return TRUE;
+}
+
+/**
+ A callback that is invoked when a directory cannot be successfully enumerated.
+
+ @param FilePath Pointer to the file path that could not be enumerated.
+
+ @param ErrorCode The Win32 error code describing the failure.
+
+ @param Depth Recursion depth, ignored in this application.
+
+ @param Context Pointer to the du context structure indicating the
+        action to perform and populated with the number of objects found.
+
+ @return TRUE to continute enumerating, FALSE to abort.
+ */
+BOOL
+DuFileEnumerateErrorCallback(
+    __in PYORI_STRING FilePath,
+    __in DWORD ErrorCode,
+    __in DWORD Depth,
+    __in PVOID Context
+    )
+{
+    LPTSTR ErrText = YoriLibGetWinErrorText(ErrorCode);
+    UNREFERENCED_PARAMETER(Depth);
+    UNREFERENCED_PARAMETER(Context);
+    YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Enumerate of %y failed, results incomplete: %s"), FilePath, ErrText);
+    YoriLibFreeWinErrorText(ErrText);
+    return TRUE;
+}
+
+/**
+ Count the amount of disk space to attribute to a file found by scanning a
+ volume given the user selected options.  This is the equivalent of
+ @ref DuCalculateSpaceUsedByFile for volume scans, which can be calculated
+ without opening the file.
+
+ @param DuContext Context specifying the accounting options to apply.
+
+ @param Record Pointer to the information about the file from the scan.
+
+ @return The number of bytes attributable to the file.
+ */
+LARGE_INTEGER
+DuCalculateSpaceUsedByRecord(
+    __in PDU_CONTEXT DuContext,
+    __in PYORILIB_NTFS_SCAN_RECORD Record
+    )
+{
+    LARGE_INTEGER FileSize;
+    LONGLONG ClusterSize;
+
+    ClusterSize = DuContext->VolumeScanClusterSize;
+    FileSize.QuadPart = 0;
+
+    if (!DuContext->WimBackedFilesAsZero ||
+        (Record->Flags & YORILIB_NTFS_SCAN_RECORD_WIM_BACKED) == 0) {
+
+        if (DuContext->CompressedFileSize) {
+            FileSize.QuadPart = Record->CompressedSize;
+        } else {
+            FileSize.QuadPart = Record->FileSize;
+        }
+    }
+
+    if (DuContext->AllocationSize) {
+        FileSize.QuadPart = (FileSize.QuadPart + ClusterSize - 1) & (~(ClusterSize - 1));
+    }
+
+    if (DuContext->IncludeNamedStreams) {
+        if (DuContext->AllocationSize) {
+            FileSize.QuadPart += Record->NamedStreamAllocatedSize;
+        } else {
+            FileSize.QuadPart += Record->NamedStreamSize;
+        }
+    }
+
+    if (DuContext->AverageHardLinkSize &&
+        !DuContext->CountHardLinksOnce &&
+        FileSize.QuadPart != 0 &&
+        Record->LinkCount > 1) {
+
+        FileSize.QuadPart = FileSize.QuadPart / Record->LinkCount;
+    }
+
+    return FileSize;
+}
+
+/**
+ When counting files with multiple hard links once during a volume scan,
+ count the space used by files with multiple links in a directory that
+ have not been counted in a directory processed previously.
+
+ @param DuContext Context specifying the accounting options to apply.
+
+ @param Scan Pointer to the results of the volume scan.
+
+ @param FirstFileLink The index of the first link within the directory that
+        names a file with multiple links, or YORILIB_NTFS_SCAN_NO_LINK.
+
+ @param NextFileLink An array indexed by link containing the next link
+        within the same directory that names a file with multiple links.
+
+ @param CountedRecords A bitmap with one bit per record, which is set when
+        the record has been counted.
+
+ @return The number of bytes attributable to the directory.
+ */
+LONGLONG
+DuScanCountLinkedFiles(
+    __in PDU_CONTEXT DuContext,
+    __in PYORILIB_NTFS_SCAN Scan,
+    __in DWORD FirstFileLink,
+    __in PDWORD NextFileLink,
+    __inout PUCHAR CountedRecords
+    )
+{
+    LARGE_INTEGER FileSize;
+    LONGLONG SpaceConsumed;
+    DWORD LinkIndex;
+    DWORD RecordIndex;
+    UCHAR Mask;
+
+    SpaceConsumed = 0;
+    for (LinkIndex = FirstFileLink; LinkIndex != YORILIB_NTFS_SCAN_NO_LINK; LinkIndex = NextFileLink[LinkIndex]) {
+        RecordIndex = Scan->Links[LinkIndex].ChildIndex;
+        Mask = (UCHAR)(1 << (RecordIndex % 8));
+        if ((CountedRecords[RecordIndex / 8] & Mask) == 0) {
+            CountedRecords[RecordIndex / 8] = (UCHAR)(CountedRecords[RecordIndex / 8] | Mask);
+            FileSize = DuCalculateSpaceUsedByRecord(DuContext, &Scan->Records[RecordIndex]);
+            SpaceConsumed = SpaceConsumed + FileSize.QuadPart;
+        }
+    }
+
+    return SpaceConsumed;
+}
+
+/**
+ Calculate and display the space used within a directory by reading the MFT
+ of the volume containing it, rather than enumerating each file.  Results
+ are reported via the same directory stack as a file enumerate, and the
+ caller is expected to close any remaining stack frames.
+
+ @param DuContext Pointer to the du context specifying the options to apply.
+
+ @param FileSpec Pointer to the user specified directory to display.
+
+ @return TRUE if the directory was processed, FALSE if it could not be
+         processed via a volume scan and the caller should enumerate files
+         instead.
+ */
+BOOL
+DuScanVolumeForPath(
+    __in PDU_CONTEXT DuContext,
+    __in PYORI_STRING FileSpec
+    )
+{
+    YORI_STRING FullPath;
+    YORI_STRING VolumeName;
+    YORI_STRING ChildPath;
+    PYORILIB_NTFS_SCAN Scan;
+    PYORILIB_NTFS_SCAN_RECORD Record;
+    PYORILIB_NTFS_SCAN_LINK Link;
+    PDU_DIRECTORY_STACK DirStack;
+    PLONGLONG SpaceInDirectory;
+    PDWORD FirstChildLink;
+    PDWORD NextSiblingLink;
+    PDWORD FirstFileLink;
+    PUCHAR CountedRecords;
+    LARGE_INTEGER FileSize;
+    DWORD RootIndex;
+    DWORD Index;
+    DWORD LinkIndex;
+    YORI_ALLOC_SIZE_T StackIndex;
+    YORI_ALLOC_SIZE_T ParentLength;
+    YORI_MAX_UNSIGNED_T ChildLength;
+    BOOL Result;
+
+    YoriLibInitEmptyString(&FullPath);
+    YoriLibInitEmptyString(&VolumeName);
+
+    if (!YoriLibUserStringToSingleFilePath(FileSpec, TRUE, &FullPath)) {
+        return FALSE;
+    }
+
+    //
+    //  Only volumes with drive letters can currently be opened for a scan.
+    //
+
+    if (!YoriLibGetVolumePathName(&FullPath, &VolumeName) ||
+        VolumeName.LengthInChars != 6 ||
+        !YoriLibIsPrefixedDriveLetterWithColon(&VolumeName)) {
+
+        YoriLibFreeStringContents(&VolumeName);
+        YoriLibFreeStringContents(&FullPath);
+        return FALSE;
+    }
+
+    Scan = &DuContext->VolumeScanResults;
+    if (Scan->Records == NULL ||
+        YoriLibCompareStringIns(&DuContext->ScannedVolumeName, &VolumeName) != 0) {
+
+        YoriLibNtfsScanCleanup(Scan);
+        YoriLibFreeStringContents(&DuContext->ScannedVolumeName);
+
+        if (!YoriLibNtfsScanVolume(&VolumeName, Scan)) {
+            DWORD ErrorCode = GetLastError();
+            LPTSTR ErrText = YoriLibGetWinErrorText(ErrorCode);
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Scan of %y failed, enumerating files instead: %s"), &VolumeName, ErrText);
+            YoriLibFreeWinErrorText(ErrText);
+            YoriLibFreeStringContents(&VolumeName);
+            YoriLibFreeStringContents(&FullPath);
+            return FALSE;
+        }
+
+        YoriLibCloneString(&DuContext->ScannedVolumeName, &VolumeName);
+    }
+
+    YoriLibFreeStringContents(&VolumeName);
+
+    if (!YoriLibNtfsScanFindRecordForPath(Scan, &FullPath, &RootIndex) ||
+        (Scan->Records[RootIndex].Flags & YORILIB_NTFS_SCAN_RECORD_DIRECTORY) == 0) {
+
+        YoriLibFreeStringContents(&FullPath);
+        return FALSE;
+    }
+
+    if (!YoriLibIsSizeAllocatable((YORI_MAX_UNSIGNED_T)Scan->RecordCount * sizeof(LONGLONG)) ||
+        !YoriLibIsSizeAllocatable(((YORI_MAX_UNSIGNED_T)Scan->LinkCount + 1) * sizeof(DWORD))) {
+
+        YoriLibFreeStringContents(&FullPath);
+        return FALSE;
+    }
+
+    SpaceInDirectory = YoriLibMalloc((YORI_ALLOC_SIZE_T)(Scan->RecordCount * sizeof(LONGLONG)));
+    FirstChildLink = YoriLibMalloc((YORI_ALLOC_SIZE_T)(Scan->RecordCount * sizeof(DWORD)));
+    NextSiblingLink = YoriLibMalloc((YORI_ALLOC_SIZE_T)((Scan->LinkCount + 1) * sizeof(DWORD)));
+
+    //
+    //  When counting files with multiple links once, each directory has a
+    //  list of links to these files, which are counted when the directory
+    //  is first processed.  Links to files and links to directories are
+    //  never in the same list, so share NextSiblingLink.
+    //
+
+    FirstFileLink = NULL;
+    CountedRecords = NULL;
+    if (DuContext->CountHardLinksOnce) {
+        FirstFileLink = YoriLibMalloc((YORI_ALLOC_SIZE_T)(Scan->RecordCount * sizeof(DWORD)));
+        CountedRecords = YoriLibMalloc((YORI_ALLOC_SIZE_T)(Scan->RecordCount / 8 + 1));
+    }
+
+    if (SpaceInDirectory == NULL || FirstChildLink == NULL || NextSiblingLink == NULL ||
+        (DuContext->CountHardLinksOnce && (FirstFileLink == NULL || CountedRecords == NULL))) {
+
+        if (SpaceInDirectory != NULL) {
+            YoriLibFree(SpaceInDirectory);
+        }
+        if (FirstChildLink != NULL) {
+            YoriLibFree(FirstChildLink);
+        }
+        if (NextSiblingLink != NULL) {
+            YoriLibFree(NextSiblingLink);
+        }
+        if (FirstFileLink != NULL) {
+            YoriLibFree(FirstFileLink);
+        }
+        if (CountedRecords != NULL) {
+            YoriLibFree(CountedRecords);
+        }
+        YoriLibFreeStringContents(&FullPath);
+        return FALSE;
+    }
+
+    if (CountedRecords != NULL) {
+        ZeroMemory(CountedRecords, (YORI_ALLOC_SIZE_T)(Scan->RecordCount / 8 + 1));
+    }
+
+    DuContext->VolumeScanClusterSize = Scan->BytesPerCluster;
+
+    //
+    //  Attribute the space used by each file to every directory containing
+    //  a link to it, which is what enumerating the namespace would find.
+    //
+
+    for (Index = 0; Index < Scan->RecordCount; Index++) {
+        SpaceInDirectory[Index] = 0;
+        FirstChildLink[Index] = YORILIB_NTFS_SCAN_NO_LINK;
+        if (FirstFileLink != NULL) {
+            FirstFileLink[Index] = YORILIB_NTFS_SCAN_NO_LINK;
+        }
+    }
+
+    for (Index = 0; Index < Scan->RecordCount; Index++) {
+        Record = &Scan->Records[Index];
+        if ((Record->Flags & YORILIB_NTFS_SCAN_RECORD_IN_USE) == 0 ||
+            (Record->Flags & YORILIB_NTFS_SCAN_RECORD_DIRECTORY) != 0 ||
+            (DuContext->CountHardLinksOnce && Record->LinkCount > 1)) {
+
+            continue;
+        }
+
+        FileSize = DuCalculateSpaceUsedByRecord(DuContext, Record);
+        for (LinkIndex = Record->FirstLink; LinkIndex != YORILIB_NTFS_SCAN_NO_LINK; LinkIndex = Scan->Links[LinkIndex].NextLink) {
+            SpaceInDirectory[Scan->Links[LinkIndex].ParentIndex] += FileSize.QuadPart;
+        }
+    }
+
+    //
+    //  Build a list of child directories for each directory.
+    //
+
+    for (LinkIndex = 0; LinkIndex < Scan->LinkCount; LinkIndex++) {
+        Link = &Scan->Links[LinkIndex];
+        Record = &Scan->Records[Link->ChildIndex];
+        NextSiblingLink[LinkIndex] = YORILIB_NTFS_SCAN_NO_LINK;
+        if ((Record->Flags & YORILIB_NTFS_SCAN_RECORD_IN_USE) != 0 &&
+            (Record->Flags & YORILIB_NTFS_SCAN_RECORD_DIRECTORY) != 0 &&
+            Link->NameLength > 0) {
+
+            NextSiblingLink[LinkIndex] = FirstChildLink[Link->ParentIndex];
+            FirstChildLink[Link->ParentIndex] = LinkIndex;
+        } else if (FirstFileLink != NULL &&
+                   (Record->Flags & YORILIB_NTFS_SCAN_RECORD_IN_USE) != 0 &&
+                   (Record->Flags & YORILIB_NTFS_SCAN_RECORD_DIRECTORY) == 0 &&
+                   Record->LinkCount > 1) {
+
+            NextSiblingLink[LinkIndex] = FirstFileLink[Link->ParentIndex];
+            FirstFileLink[Link->ParentIndex] = LinkIndex;
+        }
+    }
+
+    //
+    //  Walk the directory tree, reporting each directory after all of its
+    //  children, as a recursive enumerate would.  The frame at depth zero
+    //  only accumulates the total and is not displayed, matching the frame
+    //  for the parent of the specified directory in a file enumerate.
+    //
+
+    Result = TRUE;
+    YoriLibInitEmptyString(&ChildPath);
+
+    if (!DuEnsureStackDepth(DuContext, 1) ||
+        !DuInitializeDirectoryStack(DuContext, &DuContext->DirStack[0], &FullPath) ||
+        !DuInitializeDirectoryStack(DuContext, &DuContext->DirStack[1], &FullPath)) {
+
+        Result = FALSE;
+        StackIndex = 0;
+    } else {
+        DuContext->DirStack[1].SpaceConsumedThisDirectory = SpaceInDirectory[RootIndex];
+        DuContext->DirStack[1].ScanNextChildLink = FirstChildLink[RootIndex];
+        if (FirstFileLink != NULL) {
+            DuContext->DirStack[1].SpaceConsumedThisDirectory += DuScanCountLinkedFiles(DuContext, Scan, FirstFileLink[RootIndex], NextSiblingLink, CountedRecords);
+        }
+        StackIndex = 1;
+        DuContext->StackIndex = StackIndex;
+    }
+
+    while (StackIndex > 0) {
+        DirStack = &DuContext->DirStack[StackIndex];
+        LinkIndex = DirStack->ScanNextChildLink;
+        if (LinkIndex == YORILIB_NTFS_SCAN_NO_LINK) {
+            DuContext->DirStack[StackIndex - 1].SpaceConsumedInChildren +=
+                DirStack->SpaceConsumedInChildren +
+                DirStack->SpaceConsumedThisDirectory;
+            DuReportAndCloseStack(DuContext, StackIndex);
+            StackIndex--;
+            DuContext->StackIndex = StackIndex;
+            continue;
+        }
+
+        Link = &Scan->Links[LinkIndex];
+        DirStack->ScanNextChildLink = NextSiblingLink[LinkIndex];
+
+        if (YoriLibIsOperationCancelled()) {
+            break;
+        }
+
+        //
+        //  Construct the full path to the child directory.  Paths longer
+        //  than the system allows indicate a corrupt volume and are not
+        //  followed.
+        //
+
+        ParentLength = DirStack->DirectoryName.LengthInChars;
+        ChildLength = ParentLength + Link->NameLength + 1;
+        if (ChildLength >= 0x8000) {
+            continue;
+        }
+
+        if (ChildPath.LengthAllocated <= ChildLength) {
+            YoriLibFreeStringContents(&ChildPath);
+            if (!YoriLibAllocateString(&ChildPath, (YORI_ALLOC_SIZE_T)ChildLength + 80)) {
+                Result = FALSE;
+                break;
+            }
+        }
+
+        memcpy(ChildPath.StartOfString, DirStack->DirectoryName.StartOfString, ParentLength * sizeof(TCHAR));
+        ChildPath.LengthInChars = ParentLength;
+        if (ParentLength == 0 || !YoriLibIsSep(ChildPath.StartOfString[ParentLength - 1])) {
+            ChildPath.StartOfString[ChildPath.LengthInChars] = '\\';
+            ChildPath.LengthInChars++;
+        }
+        memcpy(&ChildPath.StartOfString[ChildPath.LengthInChars], &Scan->Names[Link->NameOffset], Link->NameLength * sizeof(WCHAR));
+        ChildPath.LengthInChars = ChildPath.LengthInChars + (YORI_ALLOC_SIZE_T)Link->NameLength;
+        ChildPath.StartOfString[ChildPath.LengthInChars] = '\0';
+
+        if (!DuEnsureStackDepth(DuContext, StackIndex + 1) ||
+            !DuInitializeDirectoryStack(DuContext, &DuContext->DirStack[StackIndex + 1], &ChildPath)) {
+
+            Result = FALSE;
+            break;
+        }
+
+        StackIndex++;
+        DuContext->StackIndex = StackIndex;
+        DuContext->DirStack[StackIndex].SpaceConsumedThisDirectory = SpaceInDirectory[Link->ChildIndex];
+        DuContext->DirStack[StackIndex].ScanNextChildLink = FirstChildLink[Link->ChildIndex];
+        if (FirstFileLink != NULL) {
+            DuContext->DirStack[StackIndex].SpaceConsumedThisDirectory += DuScanCountLinkedFiles(DuContext, Scan, FirstFileLink[Link->ChildIndex], NextSiblingLink, CountedRecords);
+        }
+    }
+
+    if (!Result) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("du: out of memory, results incomplete\n"));
+    }
+
+    DuContext->VolumeScanClusterSize = 0;
+    YoriLibFreeStringContents(&ChildPath);
+    YoriLibFreeStringContents(&FullPath);
+    YoriLibFree(SpaceInDirectory);
+    YoriLibFree(FirstChildLink);
+    YoriLibFree(NextSiblingLink);
+    if (FirstFileLink != NULL) {
+        YoriLibFree(FirstFileLink);
+    }
+    if (CountedRecords != NULL) {
+        YoriLibFree(CountedRecords);
+    }
+
+    return TRUE;
+}
+
+/**
+ Find the parent of a directory path within the cache.
+
+ @param Path Pointer to the full path to a directory.
+
+ @param Parent On successful completion, updated to describe the parent of
+        the directory.  This points into the same buffer as Path.
+
+ @return TRUE if the directory has a parent, FALSE if it does not.
+ */
+BOOL
+DuCacheGetParentPath(
+    __in PYORI_STRING Path,
+    __out PYORI_STRING Parent
+    )
+{
+    LPTSTR FilePart;
+
+    YoriLibInitEmptyString(Parent);
+    FilePart = YoriLibFindRightMostCharacter(Path, '\\');
+    if (FilePart == NULL) {
+        return FALSE;
+    }
+
+    Parent->StartOfString = Path->StartOfString;
+    Parent->LengthInChars = (YORI_ALLOC_SIZE_T)(FilePart - Path->StartOfString);
+    if (Parent->LengthInChars == 6) {
+        Parent->LengthInChars++;
+        if (!YoriLibIsPrefixedDriveLetterWithColonAndSlash(Parent)) {
+            Parent->LengthInChars--;
+        }
+    }
+
+    if (Parent->LengthInChars == 0 ||
+        Parent->LengthInChars >= Path->LengthInChars) {
+
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ Find a directory within the cache by its full path.
+
+ @param Cache Pointer to the cache.
+
+ @param Path Pointer to the full path to the directory.
+
+ @return Pointer to the directory, or NULL if it is not in the cache.
+ */
+PDU_CACHE_DIRECTORY
+DuCacheLookupDirectory(
+    __in PDU_CACHE Cache,
+    __in PYORI_STRING Path
+    )
+{
+    PYORI_HASH_ENTRY HashEntry;
+
+    HashEntry = YoriLibHashLookupByKey(Cache->PathTable, Path);
+    if (HashEntry == NULL) {
+        return NULL;
+    }
+
+    return HashEntry->Context;
+}
+
+/**
+ Add a new directory to the cache.  The caller is expected to have checked
+ that the directory is not already present.
+
+ @param Cache Pointer to the cache.
+
+ @param Path Pointer to the full path to the directory.
+
+ @return Pointer to the new directory, or NULL on allocation failure.
+ */
+PDU_CACHE_DIRECTORY
+DuCacheAddDirectory(
+    __in PDU_CACHE Cache,
+    __in PYORI_STRING Path
+    )
+{
+    PDU_CACHE_DIRECTORY Directory;
+    YORI_MAX_UNSIGNED_T BytesRequired;
+
+    BytesRequired = sizeof(DU_CACHE_DIRECTORY) + ((YORI_MAX_UNSIGNED_T)Path->LengthInChars + 1) * sizeof(TCHAR);
+    if (!YoriLibIsSizeAllocatable(BytesRequired)) {
+        return NULL;
+    }
+
+    Directory = YoriLibMalloc((YORI_ALLOC_SIZE_T)BytesRequired);
+    if (Directory == NULL) {
+        return NULL;
+    }
+
+    ZeroMemory(Directory, sizeof(DU_CACHE_DIRECTORY));
+    YoriLibInitEmptyString(&Directory->Path);
+    Directory->Path.StartOfString = (LPTSTR)(Directory + 1);
+    Directory->Path.LengthInChars = Path->LengthInChars;
+    Directory->Path.LengthAllocated = Path->LengthInChars + 1;
+    memcpy(Directory->Path.StartOfString, Path->StartOfString, Path->LengthInChars * sizeof(TCHAR));
+    Directory->Path.StartOfString[Path->LengthInChars] = '\0';
+
+    YoriLibHashInsertByKey(Cache->PathTable, &Directory->Path, Directory, &Directory->PathHashEntry);
+    return Directory;
+}
+
+/**
+ Add a new volume to the cache.
+
+ @param Cache Pointer to the cache.
+
+ @param Name Pointer to the name of the volume.
+
+ @return Pointer to the new volume, or NULL on allocation failure.
+ */
+PDU_CACHE_VOLUME
+DuCacheAddVolume(
+    __in PDU_CACHE Cache,
+    __in PYORI_STRING Name
+    )
+{
+    PDU_CACHE_VOLUME Volume;
+    YORI_MAX_UNSIGNED_T BytesRequired;
+
+    BytesRequired = sizeof(DU_CACHE_VOLUME) + ((YORI_MAX_UNSIGNED_T)Name->LengthInChars + 1) * sizeof(TCHAR);
+    if (!YoriLibIsSizeAllocatable(BytesRequired)) {
+        return NULL;
+    }
+
+    Volume = YoriLibMalloc((YORI_ALLOC_SIZE_T)BytesRequired);
+    if (Volume == NULL) {
+        return NULL;
+    }
+
+    ZeroMemory(Volume, sizeof(DU_CACHE_VOLUME));
+    YoriLibInitEmptyString(&Volume->Name);
+    Volume->Name.StartOfString = (LPTSTR)(Volume + 1);
+    Volume->Name.LengthInChars = Name->LengthInChars;
+    Volume->Name.LengthAllocated = Name->LengthInChars + 1;
+    memcpy(Volume->Name.StartOfString, Name->StartOfString, Name->LengthInChars * sizeof(TCHAR));
+    Volume->Name.StartOfString[Name->LengthInChars] = '\0';
+    Volume->Tracking = DuCacheTrackRescan;
+
+    YoriLibAppendList(&Cache->VolumeList, &Volume->ListEntry);
+    return Volume;
+}
+
+/**
+ Load the cache file, if it exists, and link each directory loaded from it
+ to its parent.  A cache file that does not exist, was generated with
+ different options, or is not valid results in an empty cache, so every
+ directory is scanned.
+
+ @param Cache Pointer to the cache.  The FileName and Options fields are
+        expected to be initialized by the caller.
+
+ @return TRUE to indicate the cache is ready for use, FALSE if it could not
+         be initialized.
+ */
+BOOL
+DuCacheLoad(
+    __in PDU_CACHE Cache
+    )
+{
+    PDU_CACHE_FILE_HEADER Header;
+    PDU_CACHE_FILE_VOLUME FileVolume;
+    PDU_CACHE_FILE_DIRECTORY FileDirectory;
+    PDU_CACHE_VOLUME Volume;
+    PDU_CACHE_DIRECTORY Directory;
+    PDU_CACHE_DIRECTORY Parent;
+    PYORI_HASH_ENTRY HashEntry;
+    YORI_STRING Name;
+    YORI_STRING ParentPath;
+    HANDLE hFile;
+    HANDLE MapHandle;
+    PUCHAR View;
+    DWORD FileSize;
+    DWORD Offset;
+    DWORD RecordSize;
+    DWORD Index;
+    BOOL Valid;
+
+    YoriLibInitializeListHead(&Cache->VolumeList);
+    Cache->PathTable = YoriLibAllocateHashTable(4000);
+    Cache->IdTable = YoriLibAllocateHashTable(4000);
+    if (Cache->PathTable == NULL || Cache->IdTable == NULL) {
+        return FALSE;
+    }
+
+    hFile = CreateFile(Cache->FileName.StartOfString,
+                       GENERIC_READ,
+                       FILE_SHARE_READ | FILE_SHARE_DELETE,
+                       NULL,
+                       OPEN_EXISTING,
+                       FILE_ATTRIBUTE_NORMAL,
+                       NULL);
+
+    if (hFile == INVALID_HANDLE_VALUE) {
+        return TRUE;
+    }
+
+    FileSize = GetFileSize(hFile, NULL);
+    if (FileSize == INVALID_FILE_SIZE ||
+        FileSize < sizeof(DU_CACHE_FILE_HEADER)) {
+
+        CloseHandle(hFile);
+        return TRUE;
+    }
+
+    MapHandle = CreateFileMapping(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(hFile);
+    if (MapHandle == NULL) {
+        return TRUE;
+    }
+
+    View = MapViewOfFile(MapHandle, FILE_MAP_READ, 0, 0, FileSize);
+    CloseHandle(MapHandle);
+    if (View == NULL) {
+        return TRUE;
+    }
+
+    Header = (PDU_CACHE_FILE_HEADER)View;
+    if (Header->Signature != DU_CACHE_SIGNATURE ||
+        Header->Version != DU_CACHE_VERSION ||
+        Header->FileSize != FileSize ||
+        Header->Options != Cache->Options) {
+
+        UnmapViewOfFile(View);
+        return TRUE;
+    }
+
+    Valid = TRUE;
+    Offset = sizeof(DU_CACHE_FILE_HEADER);
+    YoriLibInitEmptyString(&Name);
+
+    for (Index = 0; Valid && Index < Header->VolumeCount; Index++) {
+        if (FileSize - Offset < sizeof(DU_CACHE_FILE_VOLUME)) {
+            Valid = FALSE;
+            break;
+        }
+
+        FileVolume = (PDU_CACHE_FILE_VOLUME)(View + Offset);
+        if (FileVolume->NameLength == 0 ||
+            FileVolume->NameLength >= 0x8000) {
+
+            Valid = FALSE;
+            break;
+        }
+
+        RecordSize = DU_CACHE_ALIGN(sizeof(DU_CACHE_FILE_VOLUME) + FileVolume->NameLength * sizeof(TCHAR));
+        if (FileSize - Offset < RecordSize) {
+            Valid = FALSE;
+            break;
+        }
+
+        Name.StartOfString = (LPTSTR)(FileVolume + 1);
+        Name.LengthInChars = (YORI_ALLOC_SIZE_T)FileVolume->NameLength;
+        Volume = DuCacheAddVolume(Cache, &Name);
+        if (Volume == NULL) {
+            Valid = FALSE;
+            break;
+        }
+
+        Volume->UsnJournalId = FileVolume->UsnJournalId;
+        Volume->NextUsn = FileVolume->NextUsn;
+        Offset = Offset + RecordSize;
+    }
+
+    for (Index = 0; Valid && Index < Header->DirectoryCount; Index++) {
+        if (FileSize - Offset < sizeof(DU_CACHE_FILE_DIRECTORY)) {
+            Valid = FALSE;
+            break;
+        }
+
+        FileDirectory = (PDU_CACHE_FILE_DIRECTORY)(View + Offset);
+        if (FileDirectory->NameLength == 0 ||
+            FileDirectory->NameLength >= 0x8000) {
+
+            Valid = FALSE;
+            break;
+        }
+
+        RecordSize = DU_CACHE_ALIGN(sizeof(DU_CACHE_FILE_DIRECTORY) + FileDirectory->NameLength * sizeof(TCHAR));
+        if (FileSize - Offset < RecordSize) {
+            Valid = FALSE;
+            break;
+        }
+
+        Name.StartOfString = (LPTSTR)(FileDirectory + 1);
+        Name.LengthInChars = (YORI_ALLOC_SIZE_T)FileDirectory->NameLength;
+        if (DuCacheLookupDirectory(Cache, &Name) != NULL) {
+            Valid = FALSE;
+            break;
+        }
+
+        Directory = DuCacheAddDirectory(Cache, &Name);
+        if (Directory == NULL) {
+            Valid = FALSE;
+            break;
+        }
+
+        Directory->FileId.QuadPart = FileDirectory->FileId.QuadPart;
+        Directory->LastWriteTime.QuadPart = FileDirectory->LastWriteTime.QuadPart;
+        Directory->SpaceConsumed = FileDirectory->SpaceConsumed;
+        Directory->Loaded = TRUE;
+
+        YoriLibInitEmptyString(&Name);
+        Name.StartOfString = Directory->IdKeyBuffer;
+        Name.LengthInChars = (YORI_ALLOC_SIZE_T)YoriLibSPrintf(Directory->IdKeyBuffer, _T("%llx"), Directory->FileId.QuadPart);
+        YoriLibHashInsertByKey(Cache->IdTable, &Name, Directory, &Directory->IdHashEntry);
+
+        Offset = Offset + RecordSize;
+    }
+
+    UnmapViewOfFile(View);
+
+    if (!Valid) {
+        DuCacheFreeEntries(Cache);
+        return TRUE;
+    }
+
+    //
+    //  Link each directory to its parent so that an unchanged directory can
+    //  find its children without enumerating.
+    //
+
+    HashEntry = YoriLibHashGetNextEntry(Cache->PathTable, NULL);
+    while (HashEntry != NULL) {
+        Directory = HashEntry->Context;
+        if (DuCacheGetParentPath(&Directory->Path, &ParentPath)) {
+            Parent = DuCacheLookupDirectory(Cache, &ParentPath);
+            if (Parent != NULL) {
+                Directory->NextSibling = Parent->FirstChild;
+                Parent->FirstChild = Directory;
+            }
+        }
+        HashEntry = YoriLibHashGetNextEntry(Cache->PathTable, HashEntry);
+    }
+
+    return TRUE;
+}
+
+/**
+ Indicate whether a directory should be written to the cache file.  A
+ directory found in this invocation is always written.  A directory that
+ was not found but whose parent was found has been deleted, and is not
+ written.  Other directories are outside of the areas scanned in this
+ invocation and are retained.
+
+ @param Cache Pointer to the cache.
+
+ @param Directory Pointer to the directory.
+
+ @return TRUE if the directory should be saved, FALSE if it should not.
+ */
+BOOL
+DuCacheShouldSaveDirectory(
+    __in PDU_CACHE Cache,
+    __in PDU_CACHE_DIRECTORY Directory
+    )
+{
+    YORI_STRING ParentPath;
+    PDU_CACHE_DIRECTORY Parent;
+
+    if (Directory->Visited) {
+        return TRUE;
+    }
+
+    if (DuCacheGetParentPath(&Directory->Path, &ParentPath)) {
+        Parent = DuCacheLookupDirectory(Cache, &ParentPath);
+        if (Parent != NULL && Parent->Visited) {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+/**
+ Write the cache to the cache file.  The file is constructed in memory and
+ written in a single operation.
+
+ @param Cache Pointer to the cache.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+DuCacheSave(
+    __in PDU_CACHE Cache
+    )
+{
+    PDU_CACHE_FILE_HEADER Header;
+    PDU_CACHE_FILE_VOLUME FileVolume;
+    PDU_CACHE_FILE_DIRECTORY FileDirectory;
+    PDU_CACHE_VOLUME Volume;
+    PDU_CACHE_DIRECTORY Directory;
+    PYORI_HASH_ENTRY HashEntry;
+    PYORI_LIST_ENTRY ListEntry;
+    YORI_MAX_UNSIGNED_T BufferSize;
+    PUCHAR Buffer;
+    DWORD Offset;
+    DWORD VolumeCount;
+    DWORD DirectoryCount;
+    DWORD BytesWritten;
+    HANDLE hFile;
+    BOOL Result;
+
+    BufferSize = sizeof(DU_CACHE_FILE_HEADER);
+    VolumeCount = 0;
+    DirectoryCount = 0;
+
+    ListEntry = YoriLibGetNextListEntry(&Cache->VolumeList, NULL);
+    while (ListEntry != NULL) {
+        Volume = CONTAINING_RECORD(ListEntry, DU_CACHE_VOLUME, ListEntry);
+        BufferSize = BufferSize + DU_CACHE_ALIGN(sizeof(DU_CACHE_FILE_VOLUME) + Volume->Name.LengthInChars * sizeof(TCHAR));
+        VolumeCount++;
+        ListEntry = YoriLibGetNextListEntry(&Cache->VolumeList, ListEntry);
+    }
+
+    HashEntry = YoriLibHashGetNextEntry(Cache->PathTable, NULL);
+    while (HashEntry != NULL) {
+        Directory = HashEntry->Context;
+        if (DuCacheShouldSaveDirectory(Cache, Directory)) {
+            BufferSize = BufferSize + DU_CACHE_ALIGN(sizeof(DU_CACHE_FILE_DIRECTORY) + Directory->Path.LengthInChars * sizeof(TCHAR));
+            DirectoryCount++;
+        }
+        HashEntry = YoriLibHashGetNextEntry(Cache->PathTable, HashEntry);
+    }
+
+    if (!YoriLibIsSizeAllocatable(BufferSize)) {
+        return FALSE;
+    }
+
+    Buffer = YoriLibMalloc((YORI_ALLOC_SIZE_T)BufferSize);
+    if (Buffer == NULL) {
+        return FALSE;
+    }
+
+    ZeroMemory(Buffer, (YORI_ALLOC_SIZE_T)BufferSize);
+    Header = (PDU_CACHE_FILE_HEADER)Buffer;
+    Header->Signature = DU_CACHE_SIGNATURE;
+    Header->Version = DU_CACHE_VERSION;
+    Header->FileSize = (DWORD)BufferSize;
+    Header->Options = Cache->Options;
+    Header->VolumeCount = VolumeCount;
+    Header->DirectoryCount = DirectoryCount;
+    Offset = sizeof(DU_CACHE_FILE_HEADER);
+
+    ListEntry = YoriLibGetNextListEntry(&Cache->VolumeList, NULL);
+    while (ListEntry != NULL) {
+        Volume = CONTAINING_RECORD(ListEntry, DU_CACHE_VOLUME, ListEntry);
+        FileVolume = (PDU_CACHE_FILE_VOLUME)(Buffer + Offset);
+        FileVolume->UsnJournalId = Volume->UsnJournalId;
+        FileVolume->NextUsn = Volume->NextUsn;
+        FileVolume->NameLength = Volume->Name.LengthInChars;
+        memcpy(FileVolume + 1, Volume->Name.StartOfString, Volume->Name.LengthInChars * sizeof(TCHAR));
+        Offset = Offset + DU_CACHE_ALIGN(sizeof(DU_CACHE_FILE_VOLUME) + Volume->Name.LengthInChars * sizeof(TCHAR));
+        ListEntry = YoriLibGetNextListEntry(&Cache->VolumeList, ListEntry);
+    }
+
+    HashEntry = YoriLibHashGetNextEntry(Cache->PathTable, NULL);
+    while (HashEntry != NULL) {
+        Directory = HashEntry->Context;
+        if (DuCacheShouldSaveDirectory(Cache, Directory)) {
+            FileDirectory = (PDU_CACHE_FILE_DIRECTORY)(Buffer + Offset);
+            FileDirectory->FileId.QuadPart = Directory->FileId.QuadPart;
+            FileDirectory->LastWriteTime.QuadPart = Directory->LastWriteTime.QuadPart;
+            FileDirectory->SpaceConsumed = Directory->SpaceConsumed;
+            FileDirectory->NameLength = Directory->Path.LengthInChars;
+            memcpy(FileDirectory + 1, Directory->Path.StartOfString, Directory->Path.LengthInChars * sizeof(TCHAR));
+            Offset = Offset + DU_CACHE_ALIGN(sizeof(DU_CACHE_FILE_DIRECTORY) + Directory->Path.LengthInChars * sizeof(TCHAR));
+        }
+        HashEntry = YoriLibHashGetNextEntry(Cache->PathTable, HashEntry);
+    }
+
+    ASSERT(Offset == BufferSize);
+
+    hFile = CreateFile(Cache->FileName.StartOfString,
+                       GENERIC_WRITE,
+                       FILE_SHARE_READ | FILE_SHARE_DELETE,
+                       NULL,
+                       CREATE_ALWAYS,
+                       FILE_ATTRIBUTE_NORMAL,
+                       NULL);
+
+    if (hFile == INVALID_HANDLE_VALUE) {
+        YoriLibFree(Buffer);
+        return FALSE;
+    }
+
+    Result = WriteFile(hFile, Buffer, Offset, &BytesWritten, NULL);
+    if (Result && BytesWritten != Offset) {
+        Result = FALSE;
+    }
+
+    CloseHandle(hFile);
+    YoriLibFree(Buffer);
+
+    if (!Result) {
+        DeleteFile(Cache->FileName.StartOfString);
+    }
+
+    return Result;
+}
+
+/**
+ Mark a directory in the cache as changed in response to a USN journal
+ record referring to it.
+
+ @param Cache Pointer to the cache.
+
+ @param FileId The file ID referred to by the USN journal record.
+ */
+VOID
+DuCacheMarkChanged(
+    __in PDU_CACHE Cache,
+    __in DWORDLONG FileId
+    )
+{
+    TCHAR KeyBuffer[20];
+    YORI_STRING Key;
+    PYORI_HASH_ENTRY HashEntry;
+    PDU_CACHE_DIRECTORY Directory;
+
+    YoriLibInitEmptyString(&Key);
+    Key.StartOfString = KeyBuffer;
+    Key.LengthInChars = (YORI_ALLOC_SIZE_T)YoriLibSPrintf(KeyBuffer, _T("%llx"), FileId);
+
+    HashEntry = YoriLibHashLookupByKey(Cache->IdTable, &Key);
+    if (HashEntry != NULL) {
+        Directory = HashEntry->Context;
+        Directory->Changed = TRUE;
+    }
+}
+
+/**
+ Read the USN journal on a volume and mark every directory in the cache
+ which has changed, or which contains an object that has changed.
+
+ @param Cache Pointer to the cache.
+
+ @param hVolume Handle to the volume.
+
+ @param UsnJournalId The identifier of the USN journal to read.
+
+ @param StartUsn The first USN to read, which is the next USN at the time
+        the cache was generated.
+
+ @param EndUsn The next USN at the time this scan started.  Records from
+        this point onward describe changes that happen during the scan and
+        are read in the next invocation.
+
+ @return TRUE if all changes were read, FALSE if changes could not be
+         determined.
+ */
+BOOL
+DuCacheReadVolumeChanges(
+    __in PDU_CACHE Cache,
+    __in HANDLE hVolume,
+    __in DWORDLONG UsnJournalId,
+    __in LONGLONG StartUsn,
+    __in LONGLONG EndUsn
+    )
+{
+    DU_READ_USN_JOURNAL_DATA ReadData;
+    PUSN_RECORD Record;
+    PUCHAR Buffer;
+    DWORD BytesReturned;
+    DWORD Offset;
+    LONGLONG NextUsn;
+    BOOL Result;
+
+    Buffer = YoriLibMalloc(DU_CACHE_USN_BUFFER_SIZE);
+    if (Buffer == NULL) {
+        return FALSE;
+    }
+
+    ZeroMemory(&ReadData, sizeof(ReadData));
+    ReadData.StartUsn = StartUsn;
+    ReadData.ReasonMask = 0xFFFFFFFF;
+    ReadData.UsnJournalId = UsnJournalId;
+
+    Result = TRUE;
+    while (ReadData.StartUsn < EndUsn) {
+        if (!DeviceIoControl(hVolume,
+                             FSCTL_READ_USN_JOURNAL,
+                             &ReadData,
+                             sizeof(ReadData),
+                             Buffer,
+                             DU_CACHE_USN_BUFFER_SIZE,
+                             &BytesReturned,
+                             NULL) ||
+            BytesReturned < sizeof(LONGLONG)) {
+
+            Result = FALSE;
+            break;
+        }
+
+        NextUsn = *(PLONGLONG)Buffer;
+        Offset = sizeof(LONGLONG);
+
+        while (BytesReturned - Offset >= (DWORD)FIELD_OFFSET(USN_RECORD, FileName)) {
+            Record = (PUSN_RECORD)(Buffer + Offset);
+            if (Record->RecordLength < (DWORD)FIELD_OFFSET(USN_RECORD, FileName) ||
+                Record->RecordLength > BytesReturned - Offset ||
+                Record->MajorVersion != 2) {
+
+                Result = FALSE;
+                break;
+            }
+
+            DuCacheMarkChanged(Cache, Record->ParentFileReferenceNumber);
+            DuCacheMarkChanged(Cache, Record->FileReferenceNumber);
+            Offset = Offset + Record->RecordLength;
+        }
+
+        //
+        //  If no records were returned, the end of the journal has been
+        //  reached.
+        //
+
+        if (!Result || Offset == sizeof(LONGLONG) || NextUsn <= ReadData.StartUsn) {
+            break;
+        }
+
+        ReadData.StartUsn = NextUsn;
+    }
+
+    YoriLibFree(Buffer);
+    return Result;
+}
+
+/**
+ Determine the mechanism to detect changed directories on the volume
+ containing a path.  If the volume's USN journal can be read, and the cache
+ describes a point in that journal that is still valid, changes since that
+ point are read and used to mark changed directories.  If the journal can
+ be read but the cache has no valid point in it, every directory is scanned
+ and the current point is recorded for the next invocation.  If the journal
+ cannot be read, the last write time of each directory is used.
+
+ @param Cache Pointer to the cache.
+
+ @param FullPath Pointer to the full path that is about to be scanned.
+
+ @return TRUE to indicate success, FALSE on allocation failure.
+ */
+BOOL
+DuCachePrepareVolume(
+    __in PDU_CACHE Cache,
+    __in PYORI_STRING FullPath
+    )
+{
+    YORI_STRING VolumeName;
+    PYORI_LIST_ENTRY ListEntry;
+    PDU_CACHE_VOLUME Volume;
+    USN_JOURNAL_DATA UsnData;
+    DWORD BytesReturned;
+    HANDLE hVolume;
+
+    YoriLibInitEmptyString(&VolumeName);
+    if (!YoriLibGetVolumePathName(FullPath, &VolumeName)) {
+        Cache->Tracking = DuCacheTrackLastWrite;
+        return TRUE;
+    }
+
+    Volume = NULL;
+    ListEntry = YoriLibGetNextListEntry(&Cache->VolumeList, NULL);
+    while (ListEntry != NULL) {
+        Volume = CONTAINING_RECORD(ListEntry, DU_CACHE_VOLUME, ListEntry);
+        if (YoriLibCompareStringIns(&Volume->Name, &VolumeName) == 0) {
+            break;
+        }
+        Volume = NULL;
+        ListEntry = YoriLibGetNextListEntry(&Cache->VolumeList, ListEntry);
+    }
+
+    if (Volume == NULL) {
+        Volume = DuCacheAddVolume(Cache, &VolumeName);
+        if (Volume == NULL) {
+            YoriLibFreeStringContents(&VolumeName);
+            return FALSE;
         }
     }
 
+    if (Volume->Prepared) {
+        Cache->Tracking = Volume->Tracking;
+        YoriLibFreeStringContents(&VolumeName);
+        return TRUE;
+    }
+
+    Volume->Prepared = TRUE;
+    Volume->Tracking = DuCacheTrackLastWrite;
+
     //
-    //  If the file has a size and hardlink averaging is reuqested, divide the
-    //  size found by the number of hard links.
+    //  Only volumes with drive letters can currently be opened to read the
+    //  journal.  If the journal can't be read, the previous point in it is
+    //  retained, since changes since that point are a superset of changes
+    //  since this scan.
     //
 
-    if (DuContext->AverageHardLinkSize && FileHandle != INVALID_HANDLE_VALUE && FileSize.QuadPart != 0) {
-        BY_HANDLE_FILE_INFORMATION HandleFileInfo;
+    if (VolumeName.LengthInChars == 6 &&
+        YoriLibIsPrefixedDriveLetterWithColon(&VolumeName)) {
 
-        if (GetFileInformationByHandle(FileHandle, &HandleFileInfo)) {
-            if (HandleFileInfo.nNumberOfLinks > 1) {
-                FileSize.QuadPart = FileSize.QuadPart / HandleFileInfo.nNumberOfLinks;
+        hVolume = CreateFile(VolumeName.StartOfString,
+                             GENERIC_READ,
+                             FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                             NULL,
+                             OPEN_EXISTING,
+                             0,
+                             NULL);
+
+        if (hVolume != INVALID_HANDLE_VALUE) {
+            if (DeviceIoControl(hVolume,
+                                FSCTL_QUERY_USN_JOURNAL,
+                                NULL,
+                                0,
+                                &UsnData,
+                                sizeof(UsnData),
+                                &BytesReturned,
+                                NULL)) {
+
+                Volume->Tracking = DuCacheTrackRescan;
+                if (Volume->UsnJournalId == UsnData.UsnJournalID &&
+                    Volume->NextUsn >= UsnData.FirstUsn &&
+                    Volume->NextUsn <= UsnData.NextUsn &&
+                    DuCacheReadVolumeChanges(Cache, hVolume, UsnData.UsnJournalID, Volume->NextUsn, UsnData.NextUsn)) {
+
+                    Volume->Tracking = DuCacheTrackUsn;
+                }
+
+                Volume->UsnJournalId = UsnData.UsnJournalID;
+                Volume->NextUsn = UsnData.NextUsn;
             }
+            CloseHandle(hVolume);
         }
     }
 
-    if (FileHandle != INVALID_HANDLE_VALUE) {
-        CloseHandle(FileHandle);
-    }
-
-
-    return FileSize;
+    Cache->Tracking = Volume->Tracking;
+    YoriLibFreeStringContents(&VolumeName);
+    return TRUE;
 }
 
-
+BOOL
+DuCacheScanDirectory(
+    __in PDU_CONTEXT DuContext,
+    __in PYORI_STRING DirPath,
+    __in YORI_ALLOC_SIZE_T Depth
+    );
 
 /**
- A callback that is invoked when a file is found that matches a search criteria
- specified in the set of strings to enumerate.
+ Enumerate the contents of a directory which has changed since it was
+ recorded in the cache, counting the space used by files and scanning each
+ child directory.
 
- @param FilePath Pointer to the file path that was found.
+ @param DuContext Pointer to the du context specifying the options to apply.
 
- @param FileInfo Information about the file.
+ @param DirPath Pointer to the full path to the directory.
 
- @param Depth Recursion depth, ignored in this application.
+ @param Depth The depth of the directory within the directory stack.
 
- @param Context Pointer to the du context structure indicating the
-        action to perform and populated with the number of objects found.
+ @param Complete On successful completion, set to TRUE if every object in
+        the directory was found, or FALSE if enumeration failed and results
+        are incomplete.
 
- @return TRUE to continute enumerating, FALSE to abort.
+ @return TRUE to continue scanning, FALSE to abort.
  */
 BOOL
-DuFileFoundCallback(
-    __in PYORI_STRING FilePath,
-    __in PWIN32_FIND_DATA FileInfo,
-    __in DWORD Depth,
-    __in PVOID Context
+DuCacheEnumerateDirectory(
+    __in PDU_CONTEXT DuContext,
+    __in PYORI_STRING DirPath,
+    __in YORI_ALLOC_SIZE_T Depth,
+    __out PBOOLEAN Complete
     )
 {
-    PDU_CONTEXT DuContext = (PDU_CONTEXT)Context;
-    LPTSTR FilePart;
-    YORI_ALLOC_SIZE_T Index;
+    YORI_STRING ChildPath;
+    YORI_ALLOC_SIZE_T ParentLength;
+    YORI_ALLOC_SIZE_T NameLength;
+    WIN32_FIND_DATA FindData;
+    LARGE_INTEGER FileSize;
+    HANDLE hFind;
+    DWORD ErrorCode;
+    BOOL Result;
 
-    //
-    //  Depth can only describe the number of path seperators in a single
-    //  string, so cannot exceed the allocation granularity of the system
-    //
+    *Complete = FALSE;
+    if (!YoriLibAllocateString(&ChildPath, DirPath->LengthInChars + MAX_PATH + 2)) {
+        return FALSE;
+    }
 
-    ASSERT(Depth < YORI_MAX_ALLOC_SIZE);
+    memcpy(ChildPath.StartOfString, DirPath->StartOfString, DirPath->LengthInChars * sizeof(TCHAR));
+    ParentLength = DirPath->LengthInChars;
+    if (ParentLength == 0 || !YoriLibIsSep(ChildPath.StartOfString[ParentLength - 1])) {
+        ChildPath.StartOfString[ParentLength] = '\\';
+        ParentLength++;
+    }
+    ChildPath.StartOfString[ParentLength] = '*';
+    ChildPath.StartOfString[ParentLength + 1] = '\0';
+    ChildPath.LengthInChars = ParentLength + 1;
+
+    hFind = FindFirstFile(ChildPath.StartOfString, &FindData);
+    if (hFind == INVALID_HANDLE_VALUE) {
+        DuFileEnumerateErrorCallback(DirPath, GetLastError(), Depth, DuContext);
+        YoriLibFreeStringContents(&ChildPath);
+        return TRUE;
+    }
 
-    if (Depth >= DuContext->StackAllocated) {
-        PDU_DIRECTORY_STACK NewStack;
-        DWORD BytesRequested;
-        YORI_ALLOC_SIZE_T BytesToAllocate;
-        BytesRequested = (Depth + 8) * sizeof(DU_DIRECTORY_STACK);
-        BytesToAllocate = YoriLibMaximumAllocationInRange(BytesRequested, BytesRequested);
-        if (BytesToAllocate == 0) {
-            return FALSE;
-        }
-        NewStack = YoriLibMalloc(BytesToAllocate);
-        if (NewStack == NULL) {
-            return FALSE;
+    Result = TRUE;
+    do {
+        if (_tcscmp(FindData.cFileName, _T(".")) == 0 ||
+            _tcscmp(FindData.cFileName, _T("..")) == 0) {
+
+            continue;
         }
 
-        if (DuContext->StackAllocated > 0) {
-            memcpy(NewStack, DuContext->DirStack, DuContext->StackAllocated * sizeof(DU_DIRECTORY_STACK));
-            YoriLibFree(DuContext->DirStack);
+        NameLength = (YORI_ALLOC_SIZE_T)_tcslen(FindData.cFileName);
+        memcpy(&ChildPath.StartOfString[ParentLength], FindData.cFileName, (NameLength + 1) * sizeof(TCHAR));
+        ChildPath.LengthInChars = ParentLength + NameLength;
+
+        if (FindData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+
+            //
+            //  Links to other directories are not traversed, matching a
+            //  file enumerate.
+            //
+
+            if ((FindData.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) == 0) {
+                if (!DuCacheScanDirectory(DuContext, &ChildPath, Depth + 1)) {
+                    Result = FALSE;
+                    break;
+                }
+            }
+        } else {
+            FileSize = DuCalculateSpaceUsedByFile(DuContext, &DuContext->DirStack[Depth], &ChildPath, &FindData);
+            DuContext->DirStack[Depth].SpaceConsumedThisDirectory += FileSize.QuadPart;
         }
+    } while (FindNextFile(hFind, &FindData));
 
-        for (Index = DuContext->StackAllocated; Index < Depth + 8; Index++) {
-            YoriLibInitEmptyString(&NewStack[Index].DirectoryName);
-            NewStack[Index].ObjectsFoundThisDirectory = 0;
-            NewStack[Index].SpaceConsumedThisDirectory = 0;
-            NewStack[Index].SpaceConsumedInChildren = 0;
+    if (Result) {
+        ErrorCode = GetLastError();
+        if (ErrorCode == ERROR_NO_MORE_FILES) {
+            *Complete = TRUE;
+        } else {
+            DuFileEnumerateErrorCallback(DirPath, ErrorCode, Depth, DuContext);
         }
+    }
+
+    FindClose(hFind);
+    YoriLibFreeStringContents(&ChildPath);
+    return Result;
+}
+
+/**
+ Calculate and display the space used within a directory and each of its
+ children, using the cache for any directory that has not changed since
+ the cache was generated, and updating the cache with the result.
+
+ @param DuContext Pointer to the du context specifying the options to apply.
+
+ @param DirPath Pointer to the full path to the directory.
+
+ @param Depth The depth of the directory within the directory stack.  The
+        parent of the directory is at Depth - 1 and accumulates the space
+        used by this directory.
+
+ @return TRUE to continue scanning, FALSE to abort.
+ */
+BOOL
+DuCacheScanDirectory(
+    __in PDU_CONTEXT DuContext,
+    __in PYORI_STRING DirPath,
+    __in YORI_ALLOC_SIZE_T Depth
+    )
+{
+    PDU_CACHE Cache;
+    PDU_CACHE_DIRECTORY Directory;
+    PDU_CACHE_DIRECTORY Child;
+    BY_HANDLE_FILE_INFORMATION HandleFileInfo;
+    LARGE_INTEGER FileId;
+    LARGE_INTEGER LastWriteTime;
+    HANDLE hDir;
+    BOOLEAN Unchanged;
+    BOOLEAN Complete;
+    BOOL Result;
+
+    ASSERT(Depth > 0);
+    Cache = &DuContext->Cache;
+
+    if (YoriLibIsOperationCancelled()) {
+        return FALSE;
+    }
+
+    if (!DuEnsureStackDepth(DuContext, Depth) ||
+        !DuInitializeDirectoryStack(DuContext, &DuContext->DirStack[Depth], DirPath)) {
 
-        DuContext->DirStack = NewStack;
-        DuContext->StackAllocated = (YORI_ALLOC_SIZE_T)Depth + 8;
+        return FALSE;
     }
 
-    //
-    //  StackIndex would normally be populated except for the first item at
-    //  Depth == 0
-    //
+    DuContext->StackIndex = Depth;
+    Result = TRUE;
 
-    if (DuContext->StackIndex > 0 || DuContext->DirStack[0].DirectoryName.LengthInChars > 0) {
-        Index = DuContext->StackIndex;
-        while (TRUE) {
-            YORI_ALLOC_SIZE_T StackDirLength;
-            StackDirLength = DuContext->DirStack[Index].DirectoryName.LengthInChars;
-            if (Depth >= Index &&
-                YoriLibCompareStringCnt(FilePath, &DuContext->DirStack[Index].DirectoryName, StackDirLength) == 0 &&
-                (FilePath->LengthInChars == StackDirLength ||
-                 YoriLibIsSep(FilePath->StartOfString[StackDirLength]) ||
-                 YoriLibIsSep(DuContext->DirStack[Index].DirectoryName.StartOfString[StackDirLength - 1]))) {
+    hDir = CreateFile(DirPath->StartOfString,
+                      FILE_READ_ATTRIBUTES,
+                      FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                      NULL,
+                      OPEN_EXISTING,
+                      FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OPEN_REPARSE_POINT | FILE_FLAG_OPEN_NO_RECALL,
+                      NULL);
 
-                break;
-            }
+    if (hDir == INVALID_HANDLE_VALUE ||
+        !GetFileInformationByHandle(hDir, &HandleFileInfo)) {
 
-            if (Index > 0) {
-                DuContext->DirStack[Index - 1].SpaceConsumedInChildren +=
-                    DuContext->DirStack[Index].SpaceConsumedInChildren +
-                    DuContext->DirStack[Index].SpaceConsumedThisDirectory;
-            }
-            DuReportAndCloseStack(DuContext, Index);
-            if (Index == 0) {
-                break;
+        DuFileEnumerateErrorCallback(DirPath, GetLastError(), Depth, DuContext);
+        if (hDir != INVALID_HANDLE_VALUE) {
+            CloseHandle(hDir);
+        }
+    } else {
+        CloseHandle(hDir);
+
+        FileId.HighPart = HandleFileInfo.nFileIndexHigh;
+        FileId.LowPart = HandleFileInfo.nFileIndexLow;
+        LastWriteTime.HighPart = HandleFileInfo.ftLastWriteTime.dwHighDateTime;
+        LastWriteTime.LowPart = HandleFileInfo.ftLastWriteTime.dwLowDateTime;
+
+        Directory = DuCacheLookupDirectory(Cache, DirPath);
+        Unchanged = FALSE;
+        if (Directory != NULL &&
+            Directory->Loaded &&
+            Directory->FileId.QuadPart == FileId.QuadPart) {
+
+            if (Cache->Tracking == DuCacheTrackUsn) {
+                Unchanged = (BOOLEAN)!Directory->Changed;
+            } else if (Cache->Tracking == DuCacheTrackLastWrite) {
+                Unchanged = (BOOLEAN)(Directory->LastWriteTime.QuadPart == LastWriteTime.QuadPart);
             }
-            Index--;
-            DuContext->StackIndex--;
         }
-    }
 
-    FilePart = YoriLibFindRightMostCharacter(FilePath, '\\');
-    ASSERT(FilePart != NULL);
-    if (FilePart != NULL) {
-        YORI_STRING ThisDirName;
-        YoriLibInitEmptyString(&ThisDirName);
-        ThisDirName.StartOfString = FilePath->StartOfString;
-        ThisDirName.LengthInChars = (YORI_ALLOC_SIZE_T)(FilePart - FilePath->StartOfString);
-        if (ThisDirName.LengthInChars == 6) {
-            ThisDirName.LengthInChars++;
-            if (!YoriLibIsPrefixedDriveLetterWithColonAndSlash(&ThisDirName)) {
-                ThisDirName.LengthInChars--;
+        if (Unchanged) {
+            Directory->Visited = TRUE;
+            DuContext->DirStack[Depth].SpaceConsumedThisDirectory = Directory->SpaceConsumed;
+            for (Child = Directory->FirstChild; Child != NULL; Child = Child->NextSibling) {
+                if (!DuCacheScanDirectory(DuContext, &Child->Path, Depth + 1)) {
+                    Result = FALSE;
+                    break;
+                }
             }
-        }
+        } else {
+            Result = DuCacheEnumerateDirectory(DuContext, DirPath, Depth, &Complete);
 
-        Index = (YORI_ALLOC_SIZE_T)Depth;
-        while (TRUE) {
-            if (DuContext->DirStack[Index].DirectoryName.LengthInChars > 0) {
+            //
+            //  If the directory could not be fully enumerated, record an
+            //  invalid file ID so it is enumerated again next time.
+            //
 
-                ASSERT(Index == DuContext->StackIndex);
-                ASSERT(YoriLibCompareString(&DuContext->DirStack[Index].DirectoryName, &ThisDirName) == 0);
-                break;
-            }
-            if (!DuInitializeDirectoryStack(DuContext, &DuContext->DirStack[Index], &ThisDirName)) {
-                return FALSE;
-            }
-            ASSERT(DuContext->DirStack[Index].ObjectsFoundThisDirectory == 0);
-            ASSERT(DuContext->DirStack[Index].SpaceConsumedThisDirectory == 0);
-            ASSERT(DuContext->DirStack[Index].SpaceConsumedInChildren == 0);
-            if (Index == 0) {
-                break;
-            }
-            Index--;
-            FilePart = YoriLibFindRightMostCharacter(&ThisDirName, '\\');
-            ASSERT(FilePart != NULL);
-            ThisDirName.LengthInChars = (YORI_ALLOC_SIZE_T)(FilePart - ThisDirName.StartOfString);
-            if (ThisDirName.LengthInChars == 6) {
-                ThisDirName.LengthInChars++;
-                if (!YoriLibIsPrefixedDriveLetterWithColonAndSlash(&ThisDirName)) {
-                    ThisDirName.LengthInChars--;
+            if (Result) {
+                if (Directory == NULL) {
+                    Directory = DuCacheAddDirectory(Cache, DirPath);
+                }
+                if (Directory == NULL) {
+                    Result = FALSE;
+                } else {
+                    if (!Complete) {
+                        FileId.QuadPart = 0;
+                    }
+                    Directory->FileId.QuadPart = FileId.QuadPart;
+                    Directory->LastWriteTime.QuadPart = LastWriteTime.QuadPart;
+                    Directory->SpaceConsumed = DuContext->DirStack[Depth].SpaceConsumedThisDirectory;
+                    Directory->Visited = TRUE;
                 }
             }
         }
     }
 
-    DuContext->StackIndex = (YORI_ALLOC_SIZE_T)Depth;
-    DuContext->DirStack[Depth].ObjectsFoundThisDirectory++;
-
-    if ((FileInfo->dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == 0) {
-        LARGE_INTEGER FileSize;
-        FileSize = DuCalculateSpaceUsedByFile(DuContext, &DuContext->DirStack[Depth], FilePath, FileInfo);
-        DuContext->DirStack[Depth].SpaceConsumedThisDirectory += FileSize.QuadPart;
-    }
+    DuContext->DirStack[Depth - 1].SpaceConsumedInChildren +=
+        DuContext->DirStack[Depth].SpaceConsumedInChildren +
+        DuContext->DirStack[Depth].SpaceConsumedThisDirectory;
+    DuReportAndCloseStack(DuContext, Depth);
+    DuContext->StackIndex = Depth - 1;
 
-    return TRUE;
+    return Result;
 }
 
 /**
- A callback that is invoked when a directory cannot be successfully enumerated.
-
- @param FilePath Pointer to the file path that could not be enumerated.
-
- @param ErrorCode The Win32 error code describing the failure.
+ Calculate and display the space used within a directory by using the
+ cache for directories that have not changed, and enumerating directories
+ that have.  Results are reported via the same directory stack as a file
+ enumerate, and the caller is expected to close any remaining stack frames.
 
- @param Depth Recursion depth, ignored in this application.
+ @param DuContext Pointer to the du context specifying the options to apply.
 
- @param Context Pointer to the du context structure indicating the
-        action to perform and populated with the number of objects found.
+ @param FileSpec Pointer to the user specified directory to display.
 
- @return TRUE to continute enumerating, FALSE to abort.
+ @return TRUE if the directory was processed, FALSE if it does not refer to
+         a single directory and the caller should enumerate files instead.
  */
 BOOL
-DuFileEnumerateErrorCallback(
-    __in PYORI_STRING FilePath,
-    __in DWORD ErrorCode,
-    __in DWORD Depth,
-    __in PVOID Context
+DuCacheScanForPath(
+    __in PDU_CONTEXT DuContext,
+    __in PYORI_STRING FileSpec
     )
 {
-    LPTSTR ErrText = YoriLibGetWinErrorText(ErrorCode);
-    UNREFERENCED_PARAMETER(Depth);
-    UNREFERENCED_PARAMETER(Context);
-    YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Enumerate of %y failed, results incomplete: %s"), FilePath, ErrText);
-    YoriLibFreeWinErrorText(ErrText);
+    YORI_STRING FullPath;
+    DWORD Attributes;
+
+    YoriLibInitEmptyString(&FullPath);
+
+    if (!YoriLibUserStringToSingleFilePath(FileSpec, TRUE, &FullPath)) {
+        return FALSE;
+    }
+
+    Attributes = GetFileAttributes(FullPath.StartOfString);
+    if (Attributes == INVALID_FILE_ATTRIBUTES ||
+        (Attributes & FILE_ATTRIBUTE_DIRECTORY) == 0) {
+
+        YoriLibFreeStringContents(&FullPath);
+        return FALSE;
+    }
+
+    //
+    //  The frame at depth zero only accumulates the total and is not
+    //  displayed, matching the frame for the parent of the specified
+    //  directory in a file enumerate.
+    //
+
+    if (!DuCachePrepareVolume(&DuContext->Cache, &FullPath) ||
+        !DuEnsureStackDepth(DuContext, 1) ||
+        !DuInitializeDirectoryStack(DuContext, &DuContext->DirStack[0], &FullPath) ||
+        !DuCacheScanDirectory(DuContext, &FullPath, 1)) {
+
+        DuContext->Cache.Incomplete = TRUE;
+        if (!YoriLibIsOperationCancelled()) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("du: out of memory, results incomplete\n"));
+        }
+    }
+
+    YoriLibFreeStringContents(&FullPath);
     return TRUE;
 }
 
@@ -884,6 +3404,20 @@ ENTRYPOINT(
             } else if (YoriLibCompareStringLitIns(&Arg, _T("h")) == 0) {
                 DuContext.AverageHardLinkSize = TRUE;
                 ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("k")) == 0) {
+                if (i + 1 < ArgC) {
+                    YoriLibFreeStringContents(&DuContext.Cache.FileName);
+                    if (YoriLibUserStringToSingleFilePath(&ArgV[i + 1], TRUE, &DuContext.Cache.FileName)) {
+                        ArgumentUnderstood = TRUE;
+                        i++;
+                    }
+                }
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("l")) == 0) {
+                DuContext.CountHardLinksOnce = TRUE;
+                ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("m")) == 0) {
+                DuContext.VolumeScan = TRUE;
+                ArgumentUnderstood = TRUE;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("r")) == 0) {
                 if (i + 1 < ArgC) {
                     YORI_MAX_SIGNED_T Depth;
@@ -901,6 +3435,17 @@ ENTRYPOINT(
                     ArgumentUnderstood = TRUE;
                     i++;
                 }
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("top")) == 0) {
+                if (i + 1 < ArgC) {
+                    YORI_MAX_SIGNED_T Count;
+                    YORI_ALLOC_SIZE_T CharsConsumed;
+                    YoriLibStringToNumber(&ArgV[i + 1], TRUE, &Count, &CharsConsumed);
+                    if (CharsConsumed > 0 && Count > 0) {
+                        DuContext.TopCount = (DWORD)Count;
+                    }
+                    ArgumentUnderstood = TRUE;
+                    i++;
+                }
             } else if (YoriLibCompareStringLitIns(&Arg, _T("u")) == 0) {
                 DuContext.AllocationSize = TRUE;
                 ArgumentUnderstood = TRUE;
@@ -942,8 +3487,65 @@ ENTRYPOINT(
 
     YoriLibVtStringForTextAttribute(&DuContext.FileSizeColorString, DuContext.FileSizeColor.Ctrl, DuContext.FileSizeColor.Win32Attr);
 
+    //
+    //  If only the largest directories are being displayed, allocate space
+    //  to record them.  Directories that are not among the largest are
+    //  discarded as they are found, so this is all the memory needed.
+    //
+
+    if (DuContext.TopCount > 0) {
+        DWORDLONG BytesRequired;
+
+        BytesRequired = DuContext.TopCount;
+        BytesRequired = BytesRequired * sizeof(DU_TOP_ENTRY);
+        if (YoriLibIsSizeAllocatable(BytesRequired)) {
+            DuContext.TopEntries = YoriLibMalloc((YORI_ALLOC_SIZE_T)BytesRequired);
+        }
+        if (DuContext.TopEntries == NULL) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("du: out of memory\n"));
+            DuCleanupContext(&DuContext);
+            return EXIT_FAILURE;
+        }
+        ZeroMemory(DuContext.TopEntries, (DWORD)BytesRequired);
+    }
+
     YoriLibEnableBackupPrivilege();
 
+    //
+    //  Sizes in the cache are only meaningful if they were calculated with
+    //  the same options.  When counting files with multiple links once, the
+    //  size of a directory depends on which directories were processed
+    //  before it, so it cannot be cached.
+    //
+
+    if (DuContext.Cache.FileName.LengthInChars > 0 && DuContext.CountHardLinksOnce) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("du: -k cannot be combined with -l, cache not used\n"));
+        YoriLibFreeStringContents(&DuContext.Cache.FileName);
+    }
+
+    if (DuContext.Cache.FileName.LengthInChars > 0) {
+        if (DuContext.AllocationSize) {
+            DuContext.Cache.Options |= DU_CACHE_OPTION_ALLOCATION_SIZE;
+        }
+        if (DuContext.CompressedFileSize) {
+            DuContext.Cache.Options |= DU_CACHE_OPTION_COMPRESSED_SIZE;
+        }
+        if (DuContext.AverageHardLinkSize) {
+            DuContext.Cache.Options |= DU_CACHE_OPTION_AVERAGE_HARD_LINKS;
+        }
+        if (DuContext.IncludeNamedStreams) {
+            DuContext.Cache.Options |= DU_CACHE_OPTION_NAMED_STREAMS;
+        }
+        if (DuContext.WimBackedFilesAsZero) {
+            DuContext.Cache.Options |= DU_CACHE_OPTION_WIM_AS_ZERO;
+        }
+
+        if (!DuCacheLoad(&DuContext.Cache)) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("du: out of memory, cache not used\n"));
+            DuCacheCleanup(&DuContext.Cache);
+        }
+    }
+
 #if YORI_BUILTIN
     YoriLibCancelEnable(FALSE);
 #endif
@@ -963,15 +3565,39 @@ ENTRYPOINT(
     if (StartArg == 0 || StartArg == ArgC) {
         YORI_STRING FilesInDirectorySpec;
         YoriLibConstantString(&FilesInDirectorySpec, _T("."));
-        YoriLibForEachFile(&FilesInDirectorySpec, MatchFlags, 0, DuFileFoundCallback, NULL, &DuContext);
+        if ((!DuContext.VolumeScan ||
+             !DuScanVolumeForPath(&DuContext, &FilesInDirectorySpec)) &&
+            (DuContext.Cache.FileName.LengthInChars == 0 ||
+             !DuCacheScanForPath(&DuContext, &FilesInDirectorySpec))) {
+
+            YoriLibForEachFile(&FilesInDirectorySpec, MatchFlags, 0, DuFileFoundCallback, NULL, &DuContext);
+        }
         DuReportAndCloseAllActiveStacks(&DuContext, 1);
     } else {
         for (i = StartArg; i < ArgC; i++) {
-            YoriLibForEachFile(&ArgV[i], MatchFlags, 0, DuFileFoundCallback, DuFileEnumerateErrorCallback, &DuContext);
+            if ((!DuContext.VolumeScan ||
+                 !DuScanVolumeForPath(&DuContext, &ArgV[i])) &&
+                (DuContext.Cache.FileName.LengthInChars == 0 ||
+                 !DuCacheScanForPath(&DuContext, &ArgV[i]))) {
+
+                YoriLibForEachFile(&ArgV[i], MatchFlags, 0, DuFileFoundCallback, DuFileEnumerateErrorCallback, &DuContext);
+            }
             DuReportAndCloseAllActiveStacks(&DuContext, 1);
+            DuFreeLinkSets(&DuContext);
         }
     }
 
+    if (DuContext.Cache.FileName.LengthInChars > 0 &&
+        !DuContext.Cache.Incomplete &&
+        !DuCacheSave(&DuContext.Cache)) {
+
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("du: could not write cache %y\n"), &DuContext.Cache.FileName);
+    }
+
+    if (DuContext.TopCount > 0) {
+        DuTopDisplay(&DuContext);
+    }
+
     DuCleanupContext(&DuContext);
 
     return EXIT_SUCCESS;
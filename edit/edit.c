@@ -65,6 +65,186 @@ EditHelp(VOID)
     return TRUE;
 }
 
+/**
+ The number of lines to collect on the loading thread before handing them
+ to the UI thread.
+ */
+#define EDIT_LOAD_BATCH_LINES (256)
+
+/**
+ The interval in milliseconds between checks for the progress of a
+ background load or save.
+ */
+#define EDIT_BACKGROUND_POLL_INTERVAL (100)
+
+/**
+ A buffer that lines are packed into, so that many lines can share a single
+ allocation.
+ */
+typedef struct _EDIT_LINE_BUFFER {
+
+    /**
+     Pointer to the current referenced allocation, or NULL if no allocation
+     has been made.
+     */
+    PUCHAR Buffer;
+
+    /**
+     The offset in bytes of the next unused byte in Buffer.
+     */
+    YORI_ALLOC_SIZE_T BufferOffset;
+
+    /**
+     The number of bytes remaining in Buffer.
+     */
+    YORI_ALLOC_SIZE_T BytesRemainingInBuffer;
+} EDIT_LINE_BUFFER, *PEDIT_LINE_BUFFER;
+
+/**
+ State describing a file being loaded on a background thread.  The thread
+ reads lines and queues them in PendingLines, and the UI thread periodically
+ moves them into the multiline edit control.
+ */
+typedef struct _EDIT_LOAD_STATE {
+
+    /**
+     Handle to the loading thread, or NULL if no load is in progress.
+     */
+    HANDLE Thread;
+
+    /**
+     A mutex synchronizing the pending lines and progress fields between the
+     loading thread and the UI thread.
+     */
+    HANDLE Mutex;
+
+    /**
+     Handle to the file being loaded.
+     */
+    HANDLE FileHandle;
+
+    /**
+     An array of lines which have been read but not yet added to the edit
+     control.  Protected by Mutex.
+     */
+    PYORI_STRING PendingLines;
+
+    /**
+     The number of lines in PendingLines.  Protected by Mutex.
+     */
+    YORI_ALLOC_SIZE_T PendingLineCount;
+
+    /**
+     The number of elements allocated in PendingLines.  Protected by Mutex.
+     */
+    YORI_ALLOC_SIZE_T PendingLinesAllocated;
+
+    /**
+     The total number of lines read from the file.  Protected by Mutex.
+     */
+    YORI_ALLOC_SIZE_T LinesLoaded;
+
+    /**
+     The size of the file being loaded, in bytes.
+     */
+    DWORDLONG FileSize;
+
+    /**
+     The number of bytes read from the file.  Protected by Mutex.
+     */
+    DWORDLONG BytesProcessed;
+
+    /**
+     The multibyte input encoding that was active before the load started,
+     to restore when it completes.
+     */
+    DWORD SavedEncoding;
+
+    /**
+     The line ending of the first line in the file.  This is written by the
+     loading thread and read by the UI thread after the loading thread has
+     terminated.
+     */
+    YORI_LIB_LINE_ENDING FirstLineEnding;
+
+    /**
+     Set to TRUE by the UI thread to indicate the loading thread should stop
+     reading.  Protected by Mutex.
+     */
+    BOOLEAN Cancel;
+
+    /**
+     Set to TRUE by the loading thread when it has finished reading.
+     Protected by Mutex.
+     */
+    BOOLEAN Complete;
+} EDIT_LOAD_STATE, *PEDIT_LOAD_STATE;
+
+/**
+ State describing a file being saved on a background thread.  The lines are
+ copied before the thread starts, so the user can continue editing while
+ the save is in progress.
+ */
+typedef struct _EDIT_SAVE_STATE {
+
+    /**
+     Handle to the saving thread, or NULL if no save is in progress.
+     */
+    HANDLE Thread;
+
+    /**
+     Handle to the temporary file being written.
+     */
+    HANDLE TempHandle;
+
+    /**
+     The name of the temporary file being written.
+     */
+    YORI_STRING TempFileName;
+
+    /**
+     The name of the file to replace with the temporary file once it has
+     been written.
+     */
+    YORI_STRING FileName;
+
+    /**
+     The newline string to write after each line.
+     */
+    YORI_STRING Newline;
+
+    /**
+     A copy of the lines to write.
+     */
+    PYORI_STRING Lines;
+
+    /**
+     The number of lines in Lines.
+     */
+    YORI_ALLOC_SIZE_T LineCount;
+
+    /**
+     The number of lines written so far.  This is updated by the saving
+     thread without synchronization and is only used to display progress.
+     */
+    YORI_ALLOC_SIZE_T LinesWritten;
+
+    /**
+     The encoding to write the file in.
+     */
+    DWORD Encoding;
+
+    /**
+     TRUE if a BOM should be written to the file.
+     */
+    BOOLEAN WriteBom;
+
+    /**
+     Set by the saving thread to TRUE if the file was written successfully.
+     */
+    BOOLEAN Result;
+} EDIT_SAVE_STATE, *PEDIT_SAVE_STATE;
+
 /**
  A context that records files found and being operated on in the current
  window.
@@ -101,6 +281,30 @@ typedef struct _EDIT_CONTEXT {
      */
     YORI_STRING SearchString;
 
+    /**
+     A prepared form of SearchString used to find it in each line, when the
+     search is not a regular expression.  This is valid if
+     SearchMatcherValid is TRUE.
+     */
+    YORI_LIB_SUBSTRING_MATCHER SearchMatcher;
+
+    /**
+     A compiled form of SearchString used to find it in each line, when the
+     search is a regular expression.  This is valid if SearchRegexValid is
+     TRUE.
+     */
+    YORI_LIB_REGEX SearchRegexCompiled;
+
+    /**
+     State for a file being loaded on a background thread.
+     */
+    EDIT_LOAD_STATE Load;
+
+    /**
+     State for a file being saved on a background thread.
+     */
+    EDIT_SAVE_STATE Save;
+
     /**
      The newline string to use.
      */
@@ -174,6 +378,13 @@ typedef struct _EDIT_CONTEXT {
      */
     YORI_ALLOC_SIZE_T TabWidth;
 
+    /**
+     The maximum amount of memory, in megabytes, that undo history should
+     consume, or zero for no limit.  This is initialized to -1 to indicate
+     the edit control should use a default value.
+     */
+    DWORD UndoLimitInMb;
+
     /**
      TRUE if a BOM should be written to the output stream, FALSE if not.
      */
@@ -185,6 +396,29 @@ typedef struct _EDIT_CONTEXT {
      */
     BOOLEAN SearchMatchCase;
 
+    /**
+     TRUE if the search string is a regular expression.  FALSE if it should
+     be searched for literally.
+     */
+    BOOLEAN SearchRegex;
+
+    /**
+     TRUE if SearchMatcher has been initialized for the current search.
+     */
+    BOOLEAN SearchMatcherValid;
+
+    /**
+     TRUE if SearchRegexCompiled has been compiled for the current search.
+     */
+    BOOLEAN SearchRegexValid;
+
+    /**
+     TRUE if the opened file is C style source code, so comments, strings,
+     keywords and preprocessor directives should be displayed in distinct
+     colors.
+     */
+    BOOLEAN HighlightSyntax;
+
     /**
      TRUE to enable auto indent, where a new line after a line containing
      white space starts with the same leading white space.  FALSE if a new
@@ -241,6 +475,14 @@ EditFreeEditContext(
     )
 {
     YoriLibFreeStringContents(&EditContext->OpenFileName);
+    if (EditContext->SearchMatcherValid) {
+        YoriLibSubstringMatcherCleanup(&EditContext->SearchMatcher);
+        EditContext->SearchMatcherValid = FALSE;
+    }
+    if (EditContext->SearchRegexValid) {
+        YoriLibRegexCleanup(&EditContext->SearchRegexCompiled);
+        EditContext->SearchRegexValid = FALSE;
+    }
     YoriLibFreeStringContents(&EditContext->SearchString);
 }
 
@@ -288,6 +530,12 @@ EditLoadDefaults(
         EditContext->TabWidth = (YORI_ALLOC_SIZE_T)Value;
     }
 
+    ValueSize = sizeof(Value);
+    Err = DllAdvApi32.pRegQueryValueExW(hKey, _T("UndoLimitInMb"), NULL, &Type, (LPBYTE)&Value, &ValueSize);
+    if (Err == ERROR_SUCCESS && Type == REG_DWORD && ValueSize == sizeof(DWORD)) {
+        EditContext->UndoLimitInMb = Value;
+    }
+
     ValueSize = sizeof(Value);
     Err = DllAdvApi32.pRegQueryValueExW(hKey, _T("AutoIndent"), NULL, &Type, (LPBYTE)&Value, &ValueSize);
     if (Err == ERROR_SUCCESS && Type == REG_DWORD && ValueSize == sizeof(DWORD)) {
@@ -322,6 +570,11 @@ EditLoadDefaults(
     return TRUE;
 }
 
+VOID
+EditUpdateHighlight(
+    __in PEDIT_CONTEXT EditContext
+    );
+
 /**
  Set the caption on the edit control to match the file name component of the
  currently opened file.
@@ -346,203 +599,492 @@ EditUpdateOpenedFileCaption(
     }
 
     YoriWinMultilineEditSetCaption(EditContext->MultilineEdit, &NewCaption);
+    EditUpdateHighlight(EditContext);
 }
 
 /**
- Process a single opened stream, enumerating through all lines and populating
- the multiline edit control with the contents.
+ Update the status bar to display the cursor location, along with the
+ progress of any background load or save.
 
  @param EditContext Pointer to the edit context.
 
- @param hSource The opened source stream.
+ @param CursorOffset The horizontal offset of the cursor in buffer
+        coordinates.
 
- @return TRUE to indicate success, FALSE to indicate failure.
+ @param CursorLine The vertical offset of the cursor in buffer coordinates.
  */
-BOOLEAN
-EditPopulateFromStream(
+VOID
+EditRefreshStatusBar(
     __in PEDIT_CONTEXT EditContext,
-    __in HANDLE hSource
+    __in DWORD CursorOffset,
+    __in DWORD CursorLine
     )
 {
-    PVOID LineContext = NULL;
-    YORI_STRING LineString;
-    PTCHAR NewLine;
-    YORI_ALLOC_SIZE_T BytesRequired;
-    YORI_ALLOC_SIZE_T BytesAfterAlignment;
-    PUCHAR Buffer = NULL;
-    YORI_ALLOC_SIZE_T BytesRemainingInBuffer = 0;
-    YORI_ALLOC_SIZE_T BufferOffset = 0;
-    YORI_ALLOC_SIZE_T Alignment;
-    BOOLEAN Result;
-    YORI_ALLOC_SIZE_T LinesAllocated;
-    YORI_ALLOC_SIZE_T LinesPopulated;
-    DWORD BytesDesired;
-    PYORI_STRING LineArray;
-    YORI_LIB_LINE_ENDING FirstLineEnding;
-    YORI_LIB_LINE_ENDING LineEnding;
-    BOOL TimeoutReached;
-
-    LineArray = NULL;
-    LinesAllocated = 0;
-    LinesPopulated = 0;
-
-    FirstLineEnding = YoriLibLineEndingNone;
-
-    YoriLibInitEmptyString(&LineString);
-    Result = TRUE;
-
-    while (TRUE) {
-
-        if (!YoriLibReadLineToStringEx(&LineString, &LineContext, TRUE, INFINITE, hSource, &LineEnding, &TimeoutReached)) {
-            break;
-        }
+    YORI_STRING NewStatus;
+    DWORDLONG BytesProcessed;
+    YORI_ALLOC_SIZE_T LinesLoaded;
+    DWORD Percent;
 
-        if (FirstLineEnding == YoriLibLineEndingNone && LineEnding != YoriLibLineEndingNone) {
-            FirstLineEnding = LineEnding;
+    YoriLibInitEmptyString(&NewStatus);
+    if (EditContext->Load.Thread != NULL) {
+        WaitForSingleObject(EditContext->Load.Mutex, INFINITE);
+        BytesProcessed = EditContext->Load.BytesProcessed;
+        LinesLoaded = EditContext->Load.LinesLoaded;
+        ReleaseMutex(EditContext->Load.Mutex);
+
+        Percent = 0;
+        if (EditContext->Load.FileSize > 0 && BytesProcessed <= EditContext->Load.FileSize) {
+            Percent = (DWORD)(BytesProcessed * 100 / EditContext->Load.FileSize);
         }
-
-        BytesRequired = (LineString.LengthInChars + 1) * sizeof(TCHAR);
-
-        //
-        //  Align to 8 bytes for the next line.
-        //
-
-        Alignment = (BufferOffset + BytesRequired) % 8;
-        if (Alignment > 0) {
-            Alignment = 8 - Alignment;
+        YoriLibYPrintf(&NewStatus, _T("Loading %i%% (%i lines)  %06i:%04i "), Percent, LinesLoaded, CursorLine + 1, CursorOffset + 1);
+    } else if (EditContext->Save.Thread != NULL) {
+        Percent = 0;
+        if (EditContext->Save.LineCount > 0) {
+            Percent = (DWORD)((DWORDLONG)EditContext->Save.LinesWritten * 100 / EditContext->Save.LineCount);
         }
-        BytesAfterAlignment = BytesRequired + Alignment;
-
-        //
-        //  If we need a buffer, allocate a buffer that typically has space for
-        //  multiple lines
-        //
+        YoriLibYPrintf(&NewStatus, _T("Saving %i%%  %06i:%04i "), Percent, CursorLine + 1, CursorOffset + 1);
+    } else {
+        YoriLibYPrintf(&NewStatus, _T("%06i:%04i "), CursorLine + 1, CursorOffset + 1);
+    }
 
-        if (Buffer == NULL || BytesAfterAlignment > BytesRemainingInBuffer) {
-            if (Buffer != NULL) {
-                YoriLibDereference(Buffer);
-            }
-            BytesDesired = 64 * 1024;
-            if (BytesAfterAlignment > BytesDesired) {
-                BytesDesired = BytesAfterAlignment;
-            }
-            BytesRemainingInBuffer = YoriLibMaximumAllocationInRange(BytesAfterAlignment, BytesDesired);
-            BufferOffset = 0;
+    YoriWinLabelSetCaption(EditContext->StatusBar, &NewStatus);
+    YoriLibFreeStringContents(&NewStatus);
 
-            Buffer = YoriLibReferencedMalloc(BytesRemainingInBuffer);
-            if (Buffer == NULL) {
-                Result = FALSE;
-                break;
-            }
-        }
+    //
+    //  In a strange optimization reversal, force a repaint after this update
+    //  in the hope that this console update is isolated to this without
+    //  needing to update piles of user text at the same time
+    //
 
-        //
-        //  See if more lines in the line array need to be allocated
-        //
+    YoriWinDisplayWindowContents(YoriWinGetControlParent(EditContext->StatusBar));
+}
 
-        if (LinesPopulated == LinesAllocated) {
-            PYORI_STRING NewLineArray;
-            YORI_ALLOC_SIZE_T BytesToAllocate;
-            DWORD RequiredBytes;
-            DWORD DesiredBytes;
+/**
+ Update the status bar using the current cursor location.
 
-            RequiredBytes = LinesAllocated;
-            RequiredBytes = RequiredBytes + 1;
-            RequiredBytes = RequiredBytes * sizeof(YORI_STRING);
+ @param EditContext Pointer to the edit context.
+ */
+VOID
+EditRefreshStatusBarAtCursor(
+    __in PEDIT_CONTEXT EditContext
+    )
+{
+    YORI_ALLOC_SIZE_T CursorOffset;
+    YORI_ALLOC_SIZE_T CursorLine;
 
-            DesiredBytes = LinesAllocated;
-            DesiredBytes = DesiredBytes * 2;
-            if (DesiredBytes < 0x1000) {
-                DesiredBytes = 0x1000;
-            }
-            DesiredBytes = DesiredBytes * sizeof(YORI_STRING);
+    YoriWinMultilineEditGetCursorLocation(EditContext->MultilineEdit, &CursorOffset, &CursorLine);
+    EditRefreshStatusBar(EditContext, CursorOffset, CursorLine);
+}
 
-            BytesToAllocate = YoriLibMaximumAllocationInRange(RequiredBytes, DesiredBytes);
-            if (BytesToAllocate == 0) {
-                Result = FALSE;
-                break;
-            }
+/**
+ Set the multiline edit control to be read only if the user requested it,
+ or if a file is still being loaded into it.
 
-            NewLineArray = YoriLibReferencedMalloc(BytesToAllocate);
-            if (NewLineArray == NULL) {
-                Result = FALSE;
-                break;
-            }
+ @param EditContext Pointer to the edit context.
+ */
+VOID
+EditApplyReadOnly(
+    __in PEDIT_CONTEXT EditContext
+    )
+{
+    BOOLEAN ReadOnly;
 
-            if (LinesPopulated > 0) {
-                memcpy(NewLineArray, LineArray, LinesPopulated * sizeof(YORI_STRING));
-            }
+    ReadOnly = EditContext->ReadOnly;
+    if (EditContext->Load.Thread != NULL) {
+        ReadOnly = TRUE;
+    }
 
-            if (LineArray != NULL) {
-                YoriLibDereference(LineArray);
-            }
-            LineArray = NewLineArray;
-            LinesAllocated = BytesToAllocate / sizeof(YORI_STRING);
-        }
+    YoriWinMultilineEditSetReadOnly(EditContext->MultilineEdit, ReadOnly);
+}
 
-        //
-        //  Write this line into the current buffer
-        //
+/**
+ Copy a line into a buffer shared by many lines, allocating a new buffer if
+ the current one does not have space.  On success, the copied line holds a
+ reference to the buffer.
 
-        NewLine = (PTCHAR)YoriLibAddToPointer(Buffer, BufferOffset);
-        YoriLibReference(Buffer);
+ @param LineBuffer Pointer to the shared buffer state.
 
-        LineArray[LinesPopulated].MemoryToFree = Buffer;
-        LineArray[LinesPopulated].StartOfString = NewLine;
-        LineArray[LinesPopulated].LengthAllocated = BytesRequired / sizeof(TCHAR);
-        LineArray[LinesPopulated].LengthInChars = LineArray[LinesPopulated].LengthAllocated - 1;
+ @param Source Pointer to the line to copy.
 
-        memcpy(NewLine, LineString.StartOfString, LineString.LengthInChars * sizeof(TCHAR));
-        NewLine[LineString.LengthInChars] = '\0';
+ @param Dest On successful completion, populated with the copied line.
 
-        LinesPopulated++;
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+EditCopyLineToBuffer(
+    __inout PEDIT_LINE_BUFFER LineBuffer,
+    __in PCYORI_STRING Source,
+    __out PYORI_STRING Dest
+    )
+{
+    PTCHAR NewLine;
+    YORI_ALLOC_SIZE_T BytesRequired;
+    YORI_ALLOC_SIZE_T BytesAfterAlignment;
+    YORI_ALLOC_SIZE_T Alignment;
+    DWORD BytesDesired;
 
-        //
-        //  Align to 8 bytes for the next line.
-        //
+    BytesRequired = (Source->LengthInChars + 1) * sizeof(TCHAR);
 
-        BufferOffset = BufferOffset + BytesAfterAlignment;
-        BytesRemainingInBuffer = BytesRemainingInBuffer - BytesAfterAlignment;
-    }
+    //
+    //  Align to 8 bytes for the next line.
+    //
 
-    if (Buffer != NULL) {
-        YoriLibDereference(Buffer);
+    Alignment = (LineBuffer->BufferOffset + BytesRequired) % 8;
+    if (Alignment > 0) {
+        Alignment = 8 - Alignment;
     }
+    BytesAfterAlignment = BytesRequired + Alignment;
 
-    YoriLibLineReadCloseOrCache(LineContext);
-    YoriLibFreeStringContents(&LineString);
+    //
+    //  If we need a buffer, allocate a buffer that typically has space for
+    //  multiple lines
+    //
 
-    if (Result == FALSE) {
-        while (LinesPopulated > 0) {
-            YoriLibFreeStringContents(&LineArray[LinesPopulated - 1]);
-            LinesPopulated--;
+    if (LineBuffer->Buffer == NULL || BytesAfterAlignment > LineBuffer->BytesRemainingInBuffer) {
+        if (LineBuffer->Buffer != NULL) {
+            YoriLibDereference(LineBuffer->Buffer);
+            LineBuffer->Buffer = NULL;
         }
-
-        if (LineArray != NULL) {
-            YoriLibDereference(LineArray);
+        BytesDesired = 64 * 1024;
+        if (BytesAfterAlignment > BytesDesired) {
+            BytesDesired = BytesAfterAlignment;
         }
+        LineBuffer->BytesRemainingInBuffer = YoriLibMaximumAllocationInRange(BytesAfterAlignment, BytesDesired);
+        LineBuffer->BufferOffset = 0;
 
-        return FALSE;
+        LineBuffer->Buffer = YoriLibReferencedMalloc(LineBuffer->BytesRemainingInBuffer);
+        if (LineBuffer->Buffer == NULL) {
+            return FALSE;
+        }
     }
 
-    if (LinesPopulated > 0) {
-        YoriWinMultilineEditAppendLinesNoDataCopy(EditContext->MultilineEdit, LineArray, LinesPopulated);
+    //
+    //  Write this line into the current buffer
+    //
 
-        YoriLibConstantString(&EditContext->Newline, _T("\r\n"));
-        if (FirstLineEnding == YoriLibLineEndingLF) {
-            YoriLibConstantString(&EditContext->Newline, _T("\n"));
-        } else if (FirstLineEnding == YoriLibLineEndingCR) {
-            YoriLibConstantString(&EditContext->Newline, _T("\r"));
+    NewLine = (PTCHAR)YoriLibAddToPointer(LineBuffer->Buffer, LineBuffer->BufferOffset);
+    YoriLibReference(LineBuffer->Buffer);
+
+    Dest->MemoryToFree = LineBuffer->Buffer;
+    Dest->StartOfString = NewLine;
+    Dest->LengthAllocated = BytesRequired / sizeof(TCHAR);
+    Dest->LengthInChars = Dest->LengthAllocated - 1;
+
+    memcpy(NewLine, Source->StartOfString, Source->LengthInChars * sizeof(TCHAR));
+    NewLine[Source->LengthInChars] = '\0';
+
+    LineBuffer->BufferOffset = LineBuffer->BufferOffset + BytesAfterAlignment;
+    LineBuffer->BytesRemainingInBuffer = LineBuffer->BytesRemainingInBuffer - BytesAfterAlignment;
+    return TRUE;
+}
+
+/**
+ Release the reference held by a line buffer on its current allocation.
+ Lines copied into the buffer retain their own references.
+
+ @param LineBuffer Pointer to the shared buffer state.
+ */
+VOID
+EditLineBufferCleanup(
+    __inout PEDIT_LINE_BUFFER LineBuffer
+    )
+{
+    if (LineBuffer->Buffer != NULL) {
+        YoriLibDereference(LineBuffer->Buffer);
+        LineBuffer->Buffer = NULL;
+    }
+    LineBuffer->BufferOffset = 0;
+    LineBuffer->BytesRemainingInBuffer = 0;
+}
+
+/**
+ Add a batch of lines read by the loading thread to the pending lines for
+ the UI thread to collect.  On success, the pending lines own the string
+ allocations; on failure, the caller retains them.
+
+ @param LoadState Pointer to the load state.
+
+ @param Lines Pointer to an array of lines to add.
+
+ @param LineCount The number of lines in the array.
+
+ @return TRUE to indicate success, FALSE to indicate failure or that the
+         load has been cancelled.
+ */
+__success(return)
+BOOLEAN
+EditLoadQueueLines(
+    __in PEDIT_LOAD_STATE LoadState,
+    __in PYORI_STRING Lines,
+    __in YORI_ALLOC_SIZE_T LineCount
+    )
+{
+    PYORI_STRING NewLineArray;
+    YORI_ALLOC_SIZE_T BytesToAllocate;
+    DWORD RequiredBytes;
+    DWORD DesiredBytes;
+    DWORD PositionLow;
+    LONG PositionHigh;
+    BOOLEAN PositionValid;
+    BOOLEAN Result;
+
+    //
+    //  Query the file position before taking the mutex.  This reflects
+    //  data that has been read but may still be buffered, which is close
+    //  enough for a progress indicator.
+    //
+
+    PositionHigh = 0;
+    PositionValid = TRUE;
+    PositionLow = SetFilePointer(LoadState->FileHandle, 0, &PositionHigh, FILE_CURRENT);
+    if (PositionLow == INVALID_SET_FILE_POINTER && GetLastError() != NO_ERROR) {
+        PositionValid = FALSE;
+    }
+
+    Result = FALSE;
+    WaitForSingleObject(LoadState->Mutex, INFINITE);
+    if (LoadState->Cancel) {
+        goto Exit;
+    }
+
+    //
+    //  See if more lines in the line array need to be allocated
+    //
+
+    if (LoadState->PendingLineCount + LineCount > LoadState->PendingLinesAllocated) {
+
+        RequiredBytes = LoadState->PendingLineCount;
+        RequiredBytes = RequiredBytes + LineCount;
+        RequiredBytes = RequiredBytes * sizeof(YORI_STRING);
+
+        DesiredBytes = LoadState->PendingLinesAllocated;
+        DesiredBytes = DesiredBytes * 2;
+        if (DesiredBytes < 0x1000) {
+            DesiredBytes = 0x1000;
+        }
+        DesiredBytes = DesiredBytes * sizeof(YORI_STRING);
+
+        BytesToAllocate = YoriLibMaximumAllocationInRange(RequiredBytes, DesiredBytes);
+        if (BytesToAllocate == 0) {
+            goto Exit;
         }
+
+        NewLineArray = YoriLibMalloc(BytesToAllocate);
+        if (NewLineArray == NULL) {
+            goto Exit;
+        }
+
+        if (LoadState->PendingLineCount > 0) {
+            memcpy(NewLineArray, LoadState->PendingLines, LoadState->PendingLineCount * sizeof(YORI_STRING));
+        }
+
+        if (LoadState->PendingLines != NULL) {
+            YoriLibFree(LoadState->PendingLines);
+        }
+        LoadState->PendingLines = NewLineArray;
+        LoadState->PendingLinesAllocated = BytesToAllocate / sizeof(YORI_STRING);
     }
 
-    if (LineArray != NULL) {
-        YoriLibDereference(LineArray);
+    memcpy(&LoadState->PendingLines[LoadState->PendingLineCount], Lines, LineCount * sizeof(YORI_STRING));
+    LoadState->PendingLineCount = LoadState->PendingLineCount + LineCount;
+    LoadState->LinesLoaded = LoadState->LinesLoaded + LineCount;
+
+    if (PositionValid) {
+        LoadState->BytesProcessed = ((DWORDLONG)(DWORD)PositionHigh << 32) | PositionLow;
     }
 
+    Result = TRUE;
+
+Exit:
+    ReleaseMutex(LoadState->Mutex);
     return Result;
 }
 
+/**
+ A background thread that reads lines from the file being loaded and queues
+ them in batches for the UI thread to add to the multiline edit control.
+
+ @param Context Pointer to the EDIT_LOAD_STATE.
+
+ @return DWORD, ignored.
+ */
+DWORD WINAPI
+EditLoadThread(
+    __in LPVOID Context
+    )
+{
+    PEDIT_LOAD_STATE LoadState;
+    PVOID LineContext = NULL;
+    YORI_STRING LineString;
+    YORI_STRING Batch[EDIT_LOAD_BATCH_LINES];
+    YORI_ALLOC_SIZE_T BatchCount;
+    EDIT_LINE_BUFFER LineBuffer;
+    YORI_LIB_LINE_ENDING LineEnding;
+    BOOL TimeoutReached;
+    BOOLEAN Result;
+
+    LoadState = (PEDIT_LOAD_STATE)Context;
+
+    ZeroMemory(&LineBuffer, sizeof(LineBuffer));
+    YoriLibInitEmptyString(&LineString);
+    BatchCount = 0;
+    Result = TRUE;
+
+    while (TRUE) {
+
+        if (!YoriLibReadLineToStringEx(&LineString, &LineContext, TRUE, INFINITE, LoadState->FileHandle, &LineEnding, &TimeoutReached)) {
+            break;
+        }
+
+        if (LoadState->FirstLineEnding == YoriLibLineEndingNone && LineEnding != YoriLibLineEndingNone) {
+            LoadState->FirstLineEnding = LineEnding;
+        }
+
+        if (!EditCopyLineToBuffer(&LineBuffer, &LineString, &Batch[BatchCount])) {
+            Result = FALSE;
+            break;
+        }
+
+        BatchCount++;
+
+        if (BatchCount == EDIT_LOAD_BATCH_LINES) {
+            if (!EditLoadQueueLines(LoadState, Batch, BatchCount)) {
+                Result = FALSE;
+                break;
+            }
+            BatchCount = 0;
+        }
+    }
+
+    if (Result && BatchCount > 0) {
+        if (EditLoadQueueLines(LoadState, Batch, BatchCount)) {
+            BatchCount = 0;
+        }
+    }
+
+    while (BatchCount > 0) {
+        YoriLibFreeStringContents(&Batch[BatchCount - 1]);
+        BatchCount--;
+    }
+
+    EditLineBufferCleanup(&LineBuffer);
+    YoriLibLineReadCloseOrCache(LineContext);
+    YoriLibFreeStringContents(&LineString);
+
+    WaitForSingleObject(LoadState->Mutex, INFINITE);
+    LoadState->Complete = TRUE;
+    ReleaseMutex(LoadState->Mutex);
+
+    return 0;
+}
+
+/**
+ Move any lines that the loading thread has read into the multiline edit
+ control.
+
+ @param EditContext Pointer to the edit context.
+
+ @param Discard If TRUE, pending lines are freed rather than added to the
+        multiline edit control.
+
+ @return TRUE if the loading thread has finished reading, FALSE if it is
+         still running.
+ */
+BOOLEAN
+EditLoadDrainPendingLines(
+    __in PEDIT_CONTEXT EditContext,
+    __in BOOLEAN Discard
+    )
+{
+    PEDIT_LOAD_STATE LoadState;
+    PYORI_STRING Lines;
+    YORI_ALLOC_SIZE_T LineCount;
+    BOOLEAN Complete;
+
+    LoadState = &EditContext->Load;
+
+    WaitForSingleObject(LoadState->Mutex, INFINITE);
+    Lines = LoadState->PendingLines;
+    LineCount = LoadState->PendingLineCount;
+    LoadState->PendingLines = NULL;
+    LoadState->PendingLineCount = 0;
+    LoadState->PendingLinesAllocated = 0;
+    Complete = LoadState->Complete;
+    ReleaseMutex(LoadState->Mutex);
+
+    if (LineCount > 0) {
+        if (Discard ||
+            !YoriWinMultilineEditAppendLinesNoDataCopy(EditContext->MultilineEdit, Lines, LineCount)) {
+
+            while (LineCount > 0) {
+                YoriLibFreeStringContents(&Lines[LineCount - 1]);
+                LineCount--;
+            }
+        }
+    }
+
+    if (Lines != NULL) {
+        YoriLibFree(Lines);
+    }
+
+    return Complete;
+}
+
+/**
+ Wait for a background load to finish, add any remaining lines to the
+ multiline edit control, and release the resources used by the load.  This
+ function does nothing if no load is in progress.
+
+ @param EditContext Pointer to the edit context.
+
+ @param Cancel If TRUE, the load is abandoned, and lines that have not yet
+        been added to the multiline edit control are discarded.
+ */
+VOID
+EditCompleteLoad(
+    __in PEDIT_CONTEXT EditContext,
+    __in BOOLEAN Cancel
+    )
+{
+    PEDIT_LOAD_STATE LoadState;
+
+    LoadState = &EditContext->Load;
+    if (LoadState->Thread == NULL) {
+        return;
+    }
+
+    if (Cancel) {
+        WaitForSingleObject(LoadState->Mutex, INFINITE);
+        LoadState->Cancel = TRUE;
+        ReleaseMutex(LoadState->Mutex);
+    }
+
+    WaitForSingleObject(LoadState->Thread, INFINITE);
+    CloseHandle(LoadState->Thread);
+    LoadState->Thread = NULL;
+
+    EditLoadDrainPendingLines(EditContext, Cancel);
+
+    YoriLibSetMultibyteInputEncoding(LoadState->SavedEncoding);
+    CloseHandle(LoadState->FileHandle);
+    LoadState->FileHandle = NULL;
+    CloseHandle(LoadState->Mutex);
+    LoadState->Mutex = NULL;
+
+    if (!Cancel && LoadState->LinesLoaded > 0) {
+        YoriLibConstantString(&EditContext->Newline, _T("\r\n"));
+        if (LoadState->FirstLineEnding == YoriLibLineEndingLF) {
+            YoriLibConstantString(&EditContext->Newline, _T("\n"));
+        } else if (LoadState->FirstLineEnding == YoriLibLineEndingCR) {
+            YoriLibConstantString(&EditContext->Newline, _T("\r"));
+        }
+    }
+
+    EditApplyReadOnly(EditContext);
+    EditRefreshStatusBarAtCursor(EditContext);
+}
+
 /**
  Check if a file has the read only bit set.  If it does, we won't be able to
  overwrite it.  Prompt the user to remove the read only bit, and if it can
@@ -623,8 +1165,16 @@ EditIsFileWriteProtected(
     return WriteProtected;
 }
 
+VOID
+EditStartBackgroundTimer(
+    __in PEDIT_CONTEXT EditContext
+    );
+
 /**
- Load the contents of the specified file into the edit window.
+ Load the contents of the specified file into the edit window.  The file is
+ read on a background thread, and lines are added to the edit window as they
+ are read, so the beginning of the file can be displayed before the end has
+ been read.
 
  @param EditContext Pointer to the edit context.
 
@@ -638,8 +1188,11 @@ EditLoadFile(
     __in PYORI_STRING FileName
     )
 {
+    PEDIT_LOAD_STATE LoadState;
     HANDLE hFile;
-    DWORD SavedEncoding;
+    DWORD FileSizeLow;
+    DWORD FileSizeHigh;
+    DWORD ThreadId;
 
     if (FileName->StartOfString == NULL) {
         return FALSE;
@@ -682,147 +1235,122 @@ EditLoadFile(
         EditContext->Encoding = NewEncoding;
     }
 
+    EditCompleteLoad(EditContext, TRUE);
     YoriWinMultilineEditClear(EditContext->MultilineEdit);
-    SavedEncoding = YoriLibGetMultibyteInputEncoding();
-    YoriLibSetMultibyteInputEncoding(EditContext->Encoding);
-    EditPopulateFromStream(EditContext, hFile);
-    YoriLibSetMultibyteInputEncoding(SavedEncoding);
-    CloseHandle(hFile);
-    return TRUE;
-}
-
-/**
- Save the contents of the opened window into a file.
-
- @param EditContext Pointer to the edit context.
-
- @param FileName Pointer to the name of the file to save.
-
- @return TRUE to indicate success, FALSE to indicate failure.
- */
-BOOLEAN
-EditSaveFile(
-    __in PEDIT_CONTEXT EditContext,
-    __in PYORI_STRING FileName
-    )
-{
-    BOOLEAN AutoIndentActive;
-    YORI_ALLOC_SIZE_T AutoIndentLine;
-    YORI_ALLOC_SIZE_T LineIndex;
-    YORI_ALLOC_SIZE_T LineCount;
-    DWORD SavedEncoding;
-    YORI_ALLOC_SIZE_T Index;
-    DWORD Attributes;
-    PYORI_STRING Line;
-    YORI_STRING ParentDirectory;
-    YORI_STRING Prefix;
-    YORI_STRING TempFileName;
-    HANDLE TempHandle;
-    BOOLEAN ReplaceSucceeded;
 
-    if (FileName->StartOfString == NULL) {
+    LoadState = &EditContext->Load;
+    ZeroMemory(LoadState, sizeof(EDIT_LOAD_STATE));
+    LoadState->Mutex = CreateMutex(NULL, FALSE, NULL);
+    if (LoadState->Mutex == NULL) {
+        CloseHandle(hFile);
         return FALSE;
     }
 
-    if (EditContext->Newline.StartOfString == NULL) {
-        YoriLibConstantString(&EditContext->Newline, _T("\r\n"));
-        __analysis_assume(EditContext->Newline.StartOfString != NULL);
+    FileSizeHigh = 0;
+    FileSizeLow = GetFileSize(hFile, &FileSizeHigh);
+    if (FileSizeLow != INVALID_FILE_SIZE || GetLastError() == NO_ERROR) {
+        LoadState->FileSize = ((DWORDLONG)FileSizeHigh << 32) | FileSizeLow;
     }
 
-    ASSERT(YoriLibIsStringNullTerminated(FileName));
+    LoadState->FileHandle = hFile;
+    LoadState->FirstLineEnding = YoriLibLineEndingNone;
 
     //
-    //  Find the parent directory of the user specified file so a temporary
-    //  file can be created in the same directory.  This is done to increase
-    //  the chance that the file is written to the same device as the final
-    //  location and to test that the user can write to the location.
+    //  The multibyte input encoding is process wide, so it remains set
+    //  until the loading thread has completed.
     //
 
-    YoriLibInitEmptyString(&ParentDirectory);
-    for (Index = FileName->LengthInChars; Index > 0; Index--) {
-        if (YoriLibIsSep(FileName->StartOfString[Index - 1])) {
-            ParentDirectory.StartOfString = FileName->StartOfString;
-            ParentDirectory.LengthInChars = Index - 1;
-            break;
-        }
-    }
-
-    if (Index == 0) {
-        YoriLibConstantString(&ParentDirectory, _T("."));
-    }
-
-    YoriLibConstantString(&Prefix, _T("YEDT"));
+    LoadState->SavedEncoding = YoriLibGetMultibyteInputEncoding();
+    YoriLibSetMultibyteInputEncoding(EditContext->Encoding);
 
-    if (!YoriLibGetTempFileName(&ParentDirectory, &Prefix, &TempHandle, &TempFileName)) {
+    LoadState->Thread = CreateThread(NULL, 0, EditLoadThread, LoadState, 0, &ThreadId);
+    if (LoadState->Thread == NULL) {
+        YoriLibSetMultibyteInputEncoding(LoadState->SavedEncoding);
+        CloseHandle(LoadState->Mutex);
+        LoadState->Mutex = NULL;
+        CloseHandle(hFile);
+        LoadState->FileHandle = NULL;
         return FALSE;
     }
 
-    YoriWinMultilineEditGetAutoIndent(EditContext->MultilineEdit, NULL, &AutoIndentActive, &AutoIndentLine, NULL);
+    EditApplyReadOnly(EditContext);
+    EditStartBackgroundTimer(EditContext);
+    return TRUE;
+}
 
-    //
-    //  Write all of the lines to the temporary file and abort on failure.
-    //
+/**
+ A background thread that writes a copy of the lines being saved to a
+ temporary file, and replaces the target file with it.
 
-    LineCount = YoriWinMultilineEditGetLineCount(EditContext->MultilineEdit);
+ @param Context Pointer to the EDIT_SAVE_STATE.
 
-    if (EditContext->Encoding == CP_UTF8_OR_16) {
-        EditContext->Encoding = CP_UTF8;
-    }
+ @return DWORD, ignored.
+ */
+DWORD WINAPI
+EditSaveThread(
+    __in LPVOID Context
+    )
+{
+    PEDIT_SAVE_STATE SaveState;
+    YORI_ALLOC_SIZE_T LineIndex;
+    DWORD SavedEncoding;
+    DWORD Attributes;
+    BOOLEAN ReplaceSucceeded;
+
+    SaveState = (PEDIT_SAVE_STATE)Context;
+    SaveState->Result = FALSE;
 
-    if (EditContext->WriteBom) {
+    if (SaveState->WriteBom) {
         UCHAR BomBuffer[3];
         DWORD BomLength;
         DWORD BytesWritten;
 
         BomLength = 0;
 
-        if (EditContext->Encoding == CP_UTF8) {
+        if (SaveState->Encoding == CP_UTF8) {
             BomBuffer[0] = 0xEF;
             BomBuffer[1] = 0xBB;
             BomBuffer[2] = 0xBF;
             BomLength = 3;
-        } else if (EditContext->Encoding == CP_UTF16) {
+        } else if (SaveState->Encoding == CP_UTF16) {
             BomBuffer[0] = 0xFF;
             BomBuffer[1] = 0xFE;
             BomLength = 2;
         }
 
         if (BomLength > 0) {
-            if (!WriteFile(TempHandle, BomBuffer, BomLength, &BytesWritten, NULL)) {
-                CloseHandle(TempHandle);
-                DeleteFile(TempFileName.StartOfString);
-                YoriLibFreeStringContents(&TempFileName);
-                return FALSE;
+            if (!WriteFile(SaveState->TempHandle, BomBuffer, BomLength, &BytesWritten, NULL)) {
+                CloseHandle(SaveState->TempHandle);
+                DeleteFile(SaveState->TempFileName.StartOfString);
+                return 0;
             }
         }
     }
 
-    SavedEncoding = YoriLibGetMultibyteOutputEncoding();
-    YoriLibSetMultibyteOutputEncoding(EditContext->Encoding);
-    for (LineIndex = 0; LineIndex < LineCount; LineIndex++) {
-        Line = YoriWinMultilineEditGetLineByIndex(EditContext->MultilineEdit, LineIndex);
-        //
-        //  We only need to write lines with contents.  If the line is only
-        //  auto indent, then pretend it's empty since the user hasn't
-        //  written anything there.
-        //
+    //
+    //  Write all of the lines to the temporary file and abort on failure.
+    //  The multibyte output encoding is process wide, but the UI thread
+    //  writes to the console using wide characters so is unaffected.
+    //
 
-        if (Line->LengthInChars > 0 && (!AutoIndentActive || LineIndex != AutoIndentLine)) {
-            if (!YoriLibOutputTextToMbyteDev(TempHandle, Line)) {
-                CloseHandle(TempHandle);
-                DeleteFile(TempFileName.StartOfString);
-                YoriLibFreeStringContents(&TempFileName);
+    SavedEncoding = YoriLibGetMultibyteOutputEncoding();
+    YoriLibSetMultibyteOutputEncoding(SaveState->Encoding);
+    for (LineIndex = 0; LineIndex < SaveState->LineCount; LineIndex++) {
+        if (SaveState->Lines[LineIndex].LengthInChars > 0) {
+            if (!YoriLibOutputTextToMbyteDev(SaveState->TempHandle, &SaveState->Lines[LineIndex])) {
+                CloseHandle(SaveState->TempHandle);
+                DeleteFile(SaveState->TempFileName.StartOfString);
                 YoriLibSetMultibyteOutputEncoding(SavedEncoding);
-                return FALSE;
+                return 0;
             }
         }
-        if (!YoriLibOutputTextToMbyteDev(TempHandle, &EditContext->Newline)) {
-            CloseHandle(TempHandle);
-            DeleteFile(TempFileName.StartOfString);
-            YoriLibFreeStringContents(&TempFileName);
+        if (!YoriLibOutputTextToMbyteDev(SaveState->TempHandle, &SaveState->Newline)) {
+            CloseHandle(SaveState->TempHandle);
+            DeleteFile(SaveState->TempFileName.StartOfString);
             YoriLibSetMultibyteOutputEncoding(SavedEncoding);
-            return FALSE;
+            return 0;
         }
+        SaveState->LinesWritten = LineIndex + 1;
     }
     YoriLibSetMultibyteOutputEncoding(SavedEncoding);
 
@@ -833,14 +1361,13 @@ EditSaveFile(
     //  successfully written.
     //
 
-    if (!FlushFileBuffers(TempHandle)) {
-        CloseHandle(TempHandle);
-        DeleteFile(TempFileName.StartOfString);
-        YoriLibFreeStringContents(&TempFileName);
-        return FALSE;
+    if (!FlushFileBuffers(SaveState->TempHandle)) {
+        CloseHandle(SaveState->TempHandle);
+        DeleteFile(SaveState->TempFileName.StartOfString);
+        return 0;
     }
 
-    CloseHandle(TempHandle);
+    CloseHandle(SaveState->TempHandle);
 
     //
     //  If the file exists and ReplaceFile is present, replace it. Without
@@ -851,39 +1378,336 @@ EditSaveFile(
     //
 
     ReplaceSucceeded = FALSE;
-    Attributes = GetFileAttributes(FileName->StartOfString);
+    Attributes = GetFileAttributes(SaveState->FileName.StartOfString);
     if (Attributes != (DWORD)-1 &&
         DllKernel32.pReplaceFileW != NULL) {
 
-        if (!DllKernel32.pReplaceFileW(FileName->StartOfString, TempFileName.StartOfString, NULL, 0, NULL, NULL)) {
-            DeleteFile(TempFileName.StartOfString);
-            YoriLibFreeStringContents(&TempFileName);
-            return FALSE;
+        if (!DllKernel32.pReplaceFileW(SaveState->FileName.StartOfString, SaveState->TempFileName.StartOfString, NULL, 0, NULL, NULL)) {
+            DeleteFile(SaveState->TempFileName.StartOfString);
+            return 0;
         }
         ReplaceSucceeded = TRUE;
     }
 
     if (!ReplaceSucceeded) {
-        if (!MoveFileEx(TempFileName.StartOfString, FileName->StartOfString, MOVEFILE_REPLACE_EXISTING)) {
-            DeleteFile(TempFileName.StartOfString);
-            YoriLibFreeStringContents(&TempFileName);
-            return FALSE;
+        if (!MoveFileEx(SaveState->TempFileName.StartOfString, SaveState->FileName.StartOfString, MOVEFILE_REPLACE_EXISTING)) {
+            DeleteFile(SaveState->TempFileName.StartOfString);
+            return 0;
         }
     }
 
-    YoriLibFreeStringContents(&TempFileName);
-    return TRUE;
+    SaveState->Result = TRUE;
+    return 0;
 }
 
-VOID
-EditSaveButtonClicked(
-    __in PYORI_WIN_CTRL_HANDLE Ctrl
-    );
+/**
+ Free the copy of the lines used by a save operation.
 
+ @param SaveState Pointer to the save state.
+ */
 VOID
-EditSaveAsButtonClicked(
-    __in PYORI_WIN_CTRL_HANDLE Ctrl
-    );
+EditSaveFreeLines(
+    __in PEDIT_SAVE_STATE SaveState
+    )
+{
+    YORI_ALLOC_SIZE_T LineIndex;
+
+    if (SaveState->Lines != NULL) {
+        for (LineIndex = 0; LineIndex < SaveState->LineCount; LineIndex++) {
+            YoriLibFreeStringContents(&SaveState->Lines[LineIndex]);
+        }
+        YoriLibFree(SaveState->Lines);
+        SaveState->Lines = NULL;
+    }
+    SaveState->LineCount = 0;
+}
+
+/**
+ Wait for a background save to finish and release the resources used by the
+ save.  If the save failed, the buffer is marked as modified and the user is
+ informed.  This function does nothing if no save is in progress.
+
+ @param EditContext Pointer to the edit context.
+
+ @return TRUE if no save was in progress or the save completed successfully,
+         FALSE if the save failed.
+ */
+BOOLEAN
+EditCompleteSave(
+    __in PEDIT_CONTEXT EditContext
+    )
+{
+    PEDIT_SAVE_STATE SaveState;
+    BOOLEAN Result;
+
+    SaveState = &EditContext->Save;
+    if (SaveState->Thread == NULL) {
+        return TRUE;
+    }
+
+    WaitForSingleObject(SaveState->Thread, INFINITE);
+    CloseHandle(SaveState->Thread);
+    SaveState->Thread = NULL;
+
+    Result = SaveState->Result;
+    EditSaveFreeLines(SaveState);
+    YoriLibFreeStringContents(&SaveState->TempFileName);
+    YoriLibFreeStringContents(&SaveState->FileName);
+
+    EditRefreshStatusBarAtCursor(EditContext);
+
+    if (!Result) {
+        PYORI_WIN_CTRL_HANDLE Parent;
+        YORI_STRING Title;
+        YORI_STRING Text;
+        YORI_STRING ButtonText;
+
+        YoriWinMultilineEditSetModifyState(EditContext->MultilineEdit, TRUE);
+
+        Parent = YoriWinGetControlParent(EditContext->MultilineEdit);
+        YoriLibConstantString(&Title, _T("Save"));
+        YoriLibConstantString(&Text, _T("Could not write file"));
+        YoriLibConstantString(&ButtonText, _T("Ok"));
+
+        YoriDlgMessageBox(YoriWinGetWindowManagerHandle(Parent),
+                          &Title,
+                          &Text,
+                          1,
+                          &ButtonText,
+                          0,
+                          0);
+    }
+
+    return Result;
+}
+
+/**
+ Save the contents of the opened window into a file.  A temporary file is
+ created in the target directory, then a copy of the lines is written to it
+ on a background thread, which replaces the target file when the write is
+ complete.  Failures that occur on the background thread are reported when
+ the save is completed by EditCompleteSave.
+
+ @param EditContext Pointer to the edit context.
+
+ @param FileName Pointer to the name of the file to save.
+
+ @return TRUE to indicate the save has started, FALSE to indicate failure.
+ */
+BOOLEAN
+EditSaveFile(
+    __in PEDIT_CONTEXT EditContext,
+    __in PYORI_STRING FileName
+    )
+{
+    PEDIT_SAVE_STATE SaveState;
+    BOOLEAN AutoIndentActive;
+    YORI_ALLOC_SIZE_T AutoIndentLine;
+    YORI_ALLOC_SIZE_T LineIndex;
+    YORI_ALLOC_SIZE_T LineCount;
+    YORI_ALLOC_SIZE_T Index;
+    PYORI_STRING Line;
+    YORI_STRING ParentDirectory;
+    YORI_STRING Prefix;
+    EDIT_LINE_BUFFER LineBuffer;
+    DWORD ThreadId;
+
+    if (FileName->StartOfString == NULL) {
+        return FALSE;
+    }
+
+    //
+    //  Any file being loaded needs to be fully loaded before it can be
+    //  saved, and only one save can be in progress at a time.
+    //
+
+    EditCompleteLoad(EditContext, FALSE);
+    EditCompleteSave(EditContext);
+
+    SaveState = &EditContext->Save;
+
+    if (EditContext->Newline.StartOfString == NULL) {
+        YoriLibConstantString(&EditContext->Newline, _T("\r\n"));
+        __analysis_assume(EditContext->Newline.StartOfString != NULL);
+    }
+
+    ASSERT(YoriLibIsStringNullTerminated(FileName));
+
+    //
+    //  Find the parent directory of the user specified file so a temporary
+    //  file can be created in the same directory.  This is done to increase
+    //  the chance that the file is written to the same device as the final
+    //  location and to test that the user can write to the location.
+    //
+
+    YoriLibInitEmptyString(&ParentDirectory);
+    for (Index = FileName->LengthInChars; Index > 0; Index--) {
+        if (YoriLibIsSep(FileName->StartOfString[Index - 1])) {
+            ParentDirectory.StartOfString = FileName->StartOfString;
+            ParentDirectory.LengthInChars = Index - 1;
+            break;
+        }
+    }
+
+    if (Index == 0) {
+        YoriLibConstantString(&ParentDirectory, _T("."));
+    }
+
+    YoriLibConstantString(&Prefix, _T("YEDT"));
+
+    if (!YoriLibGetTempFileName(&ParentDirectory, &Prefix, &SaveState->TempHandle, &SaveState->TempFileName)) {
+        return FALSE;
+    }
+
+    YoriWinMultilineEditGetAutoIndent(EditContext->MultilineEdit, NULL, &AutoIndentActive, &AutoIndentLine, NULL);
+
+    if (EditContext->Encoding == CP_UTF8_OR_16) {
+        EditContext->Encoding = CP_UTF8;
+    }
+
+    //
+    //  Copy all of the lines so the user can continue editing while the
+    //  save is in progress.
+    //
+
+    LineCount = YoriWinMultilineEditGetLineCount(EditContext->MultilineEdit);
+    if (!YoriLibIsSizeAllocatable((YORI_MAX_UNSIGNED_T)LineCount * sizeof(YORI_STRING))) {
+        goto Fail;
+    }
+
+    SaveState->Lines = YoriLibMalloc(LineCount * sizeof(YORI_STRING));
+    if (SaveState->Lines == NULL && LineCount > 0) {
+        goto Fail;
+    }
+
+    ZeroMemory(&LineBuffer, sizeof(LineBuffer));
+    SaveState->LineCount = 0;
+    for (LineIndex = 0; LineIndex < LineCount; LineIndex++) {
+        Line = YoriWinMultilineEditGetLineByIndex(EditContext->MultilineEdit, LineIndex);
+
+        //
+        //  We only need to write lines with contents.  If the line is only
+        //  auto indent, then pretend it's empty since the user hasn't
+        //  written anything there.
+        //
+
+        if (Line->LengthInChars > 0 && (!AutoIndentActive || LineIndex != AutoIndentLine)) {
+            if (!EditCopyLineToBuffer(&LineBuffer, Line, &SaveState->Lines[LineIndex])) {
+                EditLineBufferCleanup(&LineBuffer);
+                goto Fail;
+            }
+        } else {
+            YoriLibInitEmptyString(&SaveState->Lines[LineIndex]);
+        }
+        SaveState->LineCount++;
+    }
+    EditLineBufferCleanup(&LineBuffer);
+
+    YoriLibCloneString(&SaveState->FileName, FileName);
+    memcpy(&SaveState->Newline, &EditContext->Newline, sizeof(YORI_STRING));
+    SaveState->Encoding = EditContext->Encoding;
+    SaveState->WriteBom = EditContext->WriteBom;
+    SaveState->LinesWritten = 0;
+    SaveState->Result = FALSE;
+
+    SaveState->Thread = CreateThread(NULL, 0, EditSaveThread, SaveState, 0, &ThreadId);
+    if (SaveState->Thread == NULL) {
+        YoriLibFreeStringContents(&SaveState->FileName);
+        goto Fail;
+    }
+
+    EditStartBackgroundTimer(EditContext);
+    EditRefreshStatusBarAtCursor(EditContext);
+    return TRUE;
+
+Fail:
+    EditSaveFreeLines(SaveState);
+    CloseHandle(SaveState->TempHandle);
+    DeleteFile(SaveState->TempFileName.StartOfString);
+    YoriLibFreeStringContents(&SaveState->TempFileName);
+    return FALSE;
+}
+
+/**
+ A callback invoked periodically while a background load or save is in
+ progress.  This moves lines that have been loaded into the edit control,
+ updates the progress display, and completes operations that have
+ finished.
+
+ @param WindowHandle Handle to the main window.
+ */
+VOID
+EditBackgroundTimer(
+    __in PYORI_WIN_WINDOW_HANDLE WindowHandle
+    )
+{
+    PEDIT_CONTEXT EditContext;
+    PYORI_WIN_CTRL_HANDLE WindowCtrl;
+    BOOLEAN LoadComplete;
+    BOOLEAN SaveComplete;
+
+    WindowCtrl = YoriWinGetCtrlFromWindow(WindowHandle);
+    EditContext = YoriWinGetControlContext(WindowCtrl);
+
+    LoadComplete = TRUE;
+    if (EditContext->Load.Thread != NULL) {
+        LoadComplete = EditLoadDrainPendingLines(EditContext, FALSE);
+    }
+
+    SaveComplete = TRUE;
+    if (EditContext->Save.Thread != NULL &&
+        WaitForSingleObject(EditContext->Save.Thread, 0) != WAIT_OBJECT_0) {
+
+        SaveComplete = FALSE;
+    }
+
+    //
+    //  Stop the timer before completing operations, since completing a
+    //  failed save displays a dialog which processes its own input.
+    //
+
+    if (LoadComplete && SaveComplete) {
+        YoriWinSetWindowTimerCallback(WindowHandle, 0, NULL);
+    }
+
+    if (LoadComplete) {
+        EditCompleteLoad(EditContext, FALSE);
+    }
+
+    if (SaveComplete) {
+        EditCompleteSave(EditContext);
+    }
+
+    if (!LoadComplete || !SaveComplete) {
+        EditRefreshStatusBarAtCursor(EditContext);
+    }
+}
+
+/**
+ Start the timer used to monitor background loads and saves.
+
+ @param EditContext Pointer to the edit context.
+ */
+VOID
+EditStartBackgroundTimer(
+    __in PEDIT_CONTEXT EditContext
+    )
+{
+    PYORI_WIN_CTRL_HANDLE Parent;
+
+    Parent = YoriWinGetControlParent(EditContext->MultilineEdit);
+    YoriWinSetWindowTimerCallback(YoriWinGetWindowFromWindowCtrl(Parent), EDIT_BACKGROUND_POLL_INTERVAL, EditBackgroundTimer);
+}
+
+VOID
+EditSaveButtonClicked(
+    __in PYORI_WIN_CTRL_HANDLE Ctrl
+    );
+
+VOID
+EditSaveAsButtonClicked(
+    __in PYORI_WIN_CTRL_HANDLE Ctrl
+    );
 
 /**
  If the file has been modified, prompt the user to save it, and save it if
@@ -948,10 +1772,12 @@ EditPromptForSaveIfModified(
             }
 
             //
-            //  If the buffer is still modified, that implies the save didn't
-            //  happen, so cancel.
+            //  Wait for the save to finish.  If the buffer is still
+            //  modified, that implies the save didn't happen, so cancel.
             //
 
+            EditCompleteSave(EditContext);
+
             if (YoriWinMultilineEditGetModifyState(EditContext->MultilineEdit)) {
                 return FALSE;
             }
@@ -981,6 +1807,7 @@ EditNewButtonClicked(
         return;
     }
 
+    EditCompleteLoad(EditContext, TRUE);
     EditContext->WriteBom = FALSE;
     YoriWinMultilineEditClear(EditContext->MultilineEdit);
     YoriLibFreeStringContents(&EditContext->OpenFileName);
@@ -1288,7 +2115,7 @@ EditOpenButtonClicked(
         EditContext->ReadOnly = FALSE;
     }
 
-    YoriWinMultilineEditSetReadOnly(EditContext->MultilineEdit, EditContext->ReadOnly);
+    EditApplyReadOnly(EditContext);
 }
 
 VOID
@@ -1466,205 +2293,798 @@ EditSaveAsButtonClicked(
 /**
  A callback invoked when the exit button is clicked.
 
- @param Ctrl Pointer to the button that was clicked.
+ @param Ctrl Pointer to the button that was clicked.
+ */
+VOID
+EditExitButtonClicked(
+    __in PYORI_WIN_CTRL_HANDLE Ctrl
+    )
+{
+    PYORI_WIN_CTRL_HANDLE Parent;
+    PEDIT_CONTEXT EditContext;
+
+    Parent = YoriWinGetControlParent(Ctrl);
+    EditContext = YoriWinGetControlContext(Parent);
+
+    if (!EditPromptForSaveIfModified(Ctrl, EditContext)) {
+        return;
+    }
+
+    YoriWinCloseWindow(Parent, TRUE);
+}
+
+/**
+ A callback invoked when the edit menu is opened.
+
+ @param Ctrl Pointer to the menubar control.
+ */
+VOID
+EditEditButtonClicked(
+    __in PYORI_WIN_CTRL_HANDLE Ctrl
+    )
+{
+    PYORI_WIN_CTRL_HANDLE EditMenu;
+    PYORI_WIN_CTRL_HANDLE UndoItem;
+    PYORI_WIN_CTRL_HANDLE RedoItem;
+    PYORI_WIN_CTRL_HANDLE CutItem;
+    PYORI_WIN_CTRL_HANDLE CopyItem;
+    PYORI_WIN_CTRL_HANDLE PasteItem;
+    PYORI_WIN_CTRL_HANDLE ClearItem;
+    BOOLEAN TextSelected;
+    YORI_STRING ClipboardText;
+    PYORI_WIN_CTRL_HANDLE Parent;
+    PEDIT_CONTEXT EditContext;
+
+    Parent = YoriWinGetControlParent(Ctrl);
+    EditContext = YoriWinGetControlContext(Parent);
+
+    YoriLibInitEmptyString(&ClipboardText);
+    YoriLibPasteTextWithProcessFallback(&ClipboardText);
+
+    TextSelected = YoriWinMultilineEditSelectionActive(EditContext->MultilineEdit);
+    EditMenu = YoriWinMenuBarGetSubmenuHandle(Ctrl, NULL, EditContext->EditMenuIndex);
+    UndoItem = YoriWinMenuBarGetSubmenuHandle(Ctrl, EditMenu, EditContext->EditUndoMenuIndex);
+    RedoItem = YoriWinMenuBarGetSubmenuHandle(Ctrl, EditMenu, EditContext->EditRedoMenuIndex);
+    CutItem = YoriWinMenuBarGetSubmenuHandle(Ctrl, EditMenu, EditContext->EditCutMenuIndex);
+    CopyItem = YoriWinMenuBarGetSubmenuHandle(Ctrl, EditMenu, EditContext->EditCopyMenuIndex);
+    PasteItem = YoriWinMenuBarGetSubmenuHandle(Ctrl, EditMenu, EditContext->EditPasteMenuIndex);
+    ClearItem = YoriWinMenuBarGetSubmenuHandle(Ctrl, EditMenu, EditContext->EditClearMenuIndex);
+
+    if (YoriWinMultilineEditIsUndoAvailable(EditContext->MultilineEdit)) {
+        YoriWinMenuBarEnableMenuItem(UndoItem);
+    } else {
+        YoriWinMenuBarDisableMenuItem(UndoItem);
+    }
+
+    if (YoriWinMultilineEditIsRedoAvailable(EditContext->MultilineEdit)) {
+        YoriWinMenuBarEnableMenuItem(RedoItem);
+    } else {
+        YoriWinMenuBarDisableMenuItem(RedoItem);
+    }
+
+    if (TextSelected) {
+        YoriWinMenuBarEnableMenuItem(CutItem);
+        YoriWinMenuBarEnableMenuItem(CopyItem);
+    } else {
+        YoriWinMenuBarDisableMenuItem(CutItem);
+        YoriWinMenuBarDisableMenuItem(CopyItem);
+    }
+
+    if (TextSelected) {
+        YoriWinMenuBarEnableMenuItem(ClearItem);
+    } else {
+        YoriWinMenuBarDisableMenuItem(ClearItem);
+    }
+
+    if (ClipboardText.LengthInChars > 0) {
+        YoriWinMenuBarEnableMenuItem(PasteItem);
+    } else {
+        YoriWinMenuBarDisableMenuItem(PasteItem);
+    }
+
+    YoriLibFreeStringContents(&ClipboardText);
+}
+
+/**
+ A callback invoked when the undo button is clicked.
+
+ @param Ctrl Pointer to the button that was clicked.
+ */
+VOID
+EditUndoButtonClicked(
+    __in PYORI_WIN_CTRL_HANDLE Ctrl
+    )
+{
+    PYORI_WIN_CTRL_HANDLE Parent;
+    PEDIT_CONTEXT EditContext;
+
+    Parent = YoriWinGetControlParent(Ctrl);
+    EditContext = YoriWinGetControlContext(Parent);
+    YoriWinMultilineEditUndo(EditContext->MultilineEdit);
+}
+
+/**
+ A callback invoked when the redo button is clicked.
+
+ @param Ctrl Pointer to the button that was clicked.
+ */
+VOID
+EditRedoButtonClicked(
+    __in PYORI_WIN_CTRL_HANDLE Ctrl
+    )
+{
+    PYORI_WIN_CTRL_HANDLE Parent;
+    PEDIT_CONTEXT EditContext;
+
+    Parent = YoriWinGetControlParent(Ctrl);
+    EditContext = YoriWinGetControlContext(Parent);
+    YoriWinMultilineEditRedo(EditContext->MultilineEdit);
+}
+
+
+/**
+ A callback invoked when the cut button is clicked.
+
+ @param Ctrl Pointer to the button that was clicked.
+ */
+VOID
+EditCutButtonClicked(
+    __in PYORI_WIN_CTRL_HANDLE Ctrl
+    )
+{
+    PYORI_WIN_CTRL_HANDLE Parent;
+    PEDIT_CONTEXT EditContext;
+
+    Parent = YoriWinGetControlParent(Ctrl);
+    EditContext = YoriWinGetControlContext(Parent);
+    YoriWinMultilineEditCutSelectedText(EditContext->MultilineEdit);
+}
+
+/**
+ A callback invoked when the copy button is clicked.
+
+ @param Ctrl Pointer to the button that was clicked.
+ */
+VOID
+EditCopyButtonClicked(
+    __in PYORI_WIN_CTRL_HANDLE Ctrl
+    )
+{
+    PYORI_WIN_CTRL_HANDLE Parent;
+    PEDIT_CONTEXT EditContext;
+
+    Parent = YoriWinGetControlParent(Ctrl);
+    EditContext = YoriWinGetControlContext(Parent);
+    YoriWinMultilineEditCopySelectedText(EditContext->MultilineEdit);
+}
+
+/**
+ A callback invoked when the paste button is clicked.
+
+ @param Ctrl Pointer to the button that was clicked.
+ */
+VOID
+EditPasteButtonClicked(
+    __in PYORI_WIN_CTRL_HANDLE Ctrl
+    )
+{
+    PYORI_WIN_CTRL_HANDLE Parent;
+    PEDIT_CONTEXT EditContext;
+
+    Parent = YoriWinGetControlParent(Ctrl);
+    EditContext = YoriWinGetControlContext(Parent);
+    YoriWinMultilineEditPasteText(EditContext->MultilineEdit);
+}
+
+/**
+ A callback invoked when the clear button is clicked.
+
+ @param Ctrl Pointer to the button that was clicked.
+ */
+VOID
+EditClearButtonClicked(
+    __in PYORI_WIN_CTRL_HANDLE Ctrl
+    )
+{
+    PYORI_WIN_CTRL_HANDLE Parent;
+    PEDIT_CONTEXT EditContext;
+
+    Parent = YoriWinGetControlParent(Ctrl);
+    EditContext = YoriWinGetControlContext(Parent);
+    YoriWinMultilineEditDeleteSelection(EditContext->MultilineEdit);
+}
+
+/**
+ Search a line for the first nonempty match of a regular expression at or
+ after a specified offset.  Empty matches are skipped since there is no text
+ to select.
+
+ @param Regex Pointer to the compiled regular expression.
+
+ @param Line Pointer to the line to search.
+
+ @param StartOffset The zero based first character in the line to search.
+
+ @param MatchOffset On successful completion, populated with the zero based
+        character index of the match within the line.
+
+ @param MatchLength On successful completion, populated with the number of
+        characters in the match.
+
+ @return TRUE to indicate a match was found, FALSE to indicate it was not.
+ */
+__success(return)
+BOOLEAN
+EditFindNextRegexMatch(
+    __in PYORI_LIB_REGEX Regex,
+    __in PCYORI_STRING Line,
+    __in YORI_ALLOC_SIZE_T StartOffset,
+    __out PYORI_ALLOC_SIZE_T MatchOffset,
+    __out PYORI_ALLOC_SIZE_T MatchLength
+    )
+{
+    while (StartOffset <= Line->LengthInChars) {
+        if (!YoriLibRegexSearch(Regex, Line, StartOffset, MatchOffset, MatchLength)) {
+            return FALSE;
+        }
+        if (*MatchLength > 0) {
+            return TRUE;
+        }
+        StartOffset = *MatchOffset + 1;
+    }
+
+    return FALSE;
+}
+
+/**
+ Search a line for the last nonempty match of a regular expression which
+ starts at or before a specified offset.
+
+ @param Regex Pointer to the compiled regular expression.
+
+ @param Line Pointer to the line to search.
+
+ @param LastOffset The zero based last character in the line where a match
+        can start.
+
+ @param MatchOffset On successful completion, populated with the zero based
+        character index of the match within the line.
+
+ @param MatchLength On successful completion, populated with the number of
+        characters in the match.
+
+ @return TRUE to indicate a match was found, FALSE to indicate it was not.
+ */
+__success(return)
+BOOLEAN
+EditFindPreviousRegexMatch(
+    __in PYORI_LIB_REGEX Regex,
+    __in PCYORI_STRING Line,
+    __in YORI_ALLOC_SIZE_T LastOffset,
+    __out PYORI_ALLOC_SIZE_T MatchOffset,
+    __out PYORI_ALLOC_SIZE_T MatchLength
+    )
+{
+    YORI_ALLOC_SIZE_T Offset;
+    YORI_ALLOC_SIZE_T Length;
+    YORI_ALLOC_SIZE_T StartOffset;
+    BOOLEAN Found;
+
+    Found = FALSE;
+    StartOffset = 0;
+    while (EditFindNextRegexMatch(Regex, Line, StartOffset, &Offset, &Length)) {
+        if (Offset > LastOffset) {
+            break;
+        }
+        *MatchOffset = Offset;
+        *MatchLength = Length;
+        Found = TRUE;
+        StartOffset = Offset + 1;
+    }
+
+    return Found;
+}
+
+/**
+ The color to display comments in when highlighting syntax.
+ */
+#define EDIT_HIGHLIGHT_COMMENT_COLOR  (BACKGROUND_BLUE | FOREGROUND_GREEN | FOREGROUND_BLUE)
+
+/**
+ The color to display string and character literals in when highlighting
+ syntax.
+ */
+#define EDIT_HIGHLIGHT_STRING_COLOR   (BACKGROUND_BLUE | FOREGROUND_RED | FOREGROUND_GREEN | FOREGROUND_INTENSITY)
+
+/**
+ The color to display keywords in when highlighting syntax.
+ */
+#define EDIT_HIGHLIGHT_KEYWORD_COLOR  (BACKGROUND_BLUE | FOREGROUND_RED | FOREGROUND_GREEN | FOREGROUND_BLUE | FOREGROUND_INTENSITY)
+
+/**
+ The color to display preprocessor directives in when highlighting syntax.
+ */
+#define EDIT_HIGHLIGHT_PREPROC_COLOR  (BACKGROUND_BLUE | FOREGROUND_GREEN | FOREGROUND_INTENSITY)
+
+/**
+ The color to display matches of the search string in when using a color
+ display.
+ */
+#define EDIT_HIGHLIGHT_MATCH_COLOR    (BACKGROUND_RED | BACKGROUND_GREEN)
+
+/**
+ The color to display matches of the search string in when using a mono
+ display.
+ */
+#define EDIT_HIGHLIGHT_MATCH_MONO_COLOR (FOREGROUND_RED | FOREGROUND_GREEN | FOREGROUND_BLUE | FOREGROUND_INTENSITY)
+
+/**
+ The highlight state at the start of a line that is not within a block
+ comment.
+ */
+#define EDIT_HIGHLIGHT_STATE_NORMAL      (0)
+
+/**
+ The highlight state at the start of a line that is within a block comment.
+ */
+#define EDIT_HIGHLIGHT_STATE_IN_COMMENT  (1)
+
+/**
+ File extensions which are treated as C style source code.
+ */
+CONST LPTSTR EditSourceFileExtensions[] = {
+    _T("c"),
+    _T("cc"),
+    _T("cpp"),
+    _T("cs"),
+    _T("cxx"),
+    _T("h"),
+    _T("hpp"),
+    _T("hxx"),
+    _T("java"),
+    _T("js"),
+    _T("ts")
+};
+
+/**
+ Keywords to display in a distinct color within C style source code.
+ */
+CONST LPTSTR EditSourceKeywords[] = {
+    _T("break"),
+    _T("case"),
+    _T("char"),
+    _T("const"),
+    _T("continue"),
+    _T("default"),
+    _T("do"),
+    _T("double"),
+    _T("else"),
+    _T("enum"),
+    _T("extern"),
+    _T("float"),
+    _T("for"),
+    _T("goto"),
+    _T("if"),
+    _T("int"),
+    _T("long"),
+    _T("return"),
+    _T("short"),
+    _T("signed"),
+    _T("sizeof"),
+    _T("static"),
+    _T("struct"),
+    _T("switch"),
+    _T("typedef"),
+    _T("union"),
+    _T("unsigned"),
+    _T("void"),
+    _T("volatile"),
+    _T("while")
+};
+
+/**
+ Return TRUE if a file name refers to C style source code that should have
+ syntax highlighting applied.
+
+ @param FileName Pointer to the file name.
+
+ @return TRUE if the file is C style source code, FALSE if it is not.
+ */
+BOOLEAN
+EditIsSourceFileName(
+    __in PCYORI_STRING FileName
+    )
+{
+    YORI_STRING Extension;
+    LPTSTR Period;
+    YORI_ALLOC_SIZE_T Index;
+
+    Period = YoriLibFindRightMostCharacter(FileName, '.');
+    if (Period == NULL) {
+        return FALSE;
+    }
+
+    YoriLibInitEmptyString(&Extension);
+    Extension.StartOfString = Period + 1;
+    Extension.LengthInChars = FileName->LengthInChars - (YORI_ALLOC_SIZE_T)(Extension.StartOfString - FileName->StartOfString);
+
+    for (Index = 0; Index < sizeof(EditSourceFileExtensions)/sizeof(EditSourceFileExtensions[0]); Index++) {
+        if (YoriLibCompareStringLitIns(&Extension, EditSourceFileExtensions[Index]) == 0) {
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+/**
+ Return TRUE if a character can be part of a C style identifier.
+
+ @param Char The character to test.
+
+ @return TRUE if the character can be part of an identifier, FALSE if not.
+ */
+BOOLEAN
+EditIsIdentifierChar(
+    __in TCHAR Char
+    )
+{
+    if ((Char >= 'a' && Char <= 'z') ||
+        (Char >= 'A' && Char <= 'Z') ||
+        (Char >= '0' && Char <= '9') ||
+        Char == '_') {
+
+        return TRUE;
+    }
+    return FALSE;
+}
+
+/**
+ Apply a color to a range of characters within a line, if colors are being
+ generated.
+
+ @param Attributes Optionally points to an array of attributes, one per
+        character in the line.  If NULL, this function does nothing.
+
+ @param Offset The first character to color.
+
+ @param Length The number of characters to color.
+
+ @param Color The color to apply.
  */
 VOID
-EditExitButtonClicked(
-    __in PYORI_WIN_CTRL_HANDLE Ctrl
+EditHighlightRange(
+    __in_opt PWORD Attributes,
+    __in YORI_ALLOC_SIZE_T Offset,
+    __in YORI_ALLOC_SIZE_T Length,
+    __in WORD Color
     )
 {
-    PYORI_WIN_CTRL_HANDLE Parent;
-    PEDIT_CONTEXT EditContext;
-
-    Parent = YoriWinGetControlParent(Ctrl);
-    EditContext = YoriWinGetControlContext(Parent);
+    YORI_ALLOC_SIZE_T Index;
 
-    if (!EditPromptForSaveIfModified(Ctrl, EditContext)) {
+    if (Attributes == NULL) {
         return;
     }
 
-    YoriWinCloseWindow(Parent, TRUE);
+    for (Index = Offset; Index < Offset + Length; Index++) {
+        Attributes[Index] = Color;
+    }
 }
 
 /**
- A callback invoked when the edit menu is opened.
+ Apply C style syntax highlighting to a single line.  Block comments are the
+ only construct that spans lines, so the state indicates whether the line
+ begins within a block comment.
 
- @param Ctrl Pointer to the menubar control.
+ @param Line Pointer to the text of the line.
+
+ @param State The highlight state at the start of the line.
+
+ @param Attributes Optionally points to an array of attributes, one per
+        character in the line, to update.  If NULL, only the state at the
+        end of the line is calculated.
+
+ @return The highlight state at the end of the line.
  */
-VOID
-EditEditButtonClicked(
-    __in PYORI_WIN_CTRL_HANDLE Ctrl
+DWORD
+EditHighlightSourceLine(
+    __in PCYORI_STRING Line,
+    __in DWORD State,
+    __in_opt PWORD Attributes
     )
 {
-    PYORI_WIN_CTRL_HANDLE EditMenu;
-    PYORI_WIN_CTRL_HANDLE UndoItem;
-    PYORI_WIN_CTRL_HANDLE RedoItem;
-    PYORI_WIN_CTRL_HANDLE CutItem;
-    PYORI_WIN_CTRL_HANDLE CopyItem;
-    PYORI_WIN_CTRL_HANDLE PasteItem;
-    PYORI_WIN_CTRL_HANDLE ClearItem;
-    BOOLEAN TextSelected;
-    YORI_STRING ClipboardText;
-    PYORI_WIN_CTRL_HANDLE Parent;
-    PEDIT_CONTEXT EditContext;
+    YORI_ALLOC_SIZE_T Index;
+    YORI_ALLOC_SIZE_T Start;
+    YORI_ALLOC_SIZE_T KeywordIndex;
+    YORI_STRING Word;
+    TCHAR Char;
+    TCHAR Quote;
+    BOOLEAN LineStart;
 
-    Parent = YoriWinGetControlParent(Ctrl);
-    EditContext = YoriWinGetControlContext(Parent);
+    Index = 0;
+    LineStart = TRUE;
+    while (Index < Line->LengthInChars) {
 
-    YoriLibInitEmptyString(&ClipboardText);
-    YoriLibPasteTextWithProcessFallback(&ClipboardText);
+        //
+        //  Inside a block comment, the only thing of interest is the end
+        //  of it.
+        //
 
-    TextSelected = YoriWinMultilineEditSelectionActive(EditContext->MultilineEdit);
-    EditMenu = YoriWinMenuBarGetSubmenuHandle(Ctrl, NULL, EditContext->EditMenuIndex);
-    UndoItem = YoriWinMenuBarGetSubmenuHandle(Ctrl, EditMenu, EditContext->EditUndoMenuIndex);
-    RedoItem = YoriWinMenuBarGetSubmenuHandle(Ctrl, EditMenu, EditContext->EditRedoMenuIndex);
-    CutItem = YoriWinMenuBarGetSubmenuHandle(Ctrl, EditMenu, EditContext->EditCutMenuIndex);
-    CopyItem = YoriWinMenuBarGetSubmenuHandle(Ctrl, EditMenu, EditContext->EditCopyMenuIndex);
-    PasteItem = YoriWinMenuBarGetSubmenuHandle(Ctrl, EditMenu, EditContext->EditPasteMenuIndex);
-    ClearItem = YoriWinMenuBarGetSubmenuHandle(Ctrl, EditMenu, EditContext->EditClearMenuIndex);
+        if (State == EDIT_HIGHLIGHT_STATE_IN_COMMENT) {
+            Start = Index;
+            while (Index < Line->LengthInChars) {
+                if (Line->StartOfString[Index] == '*' &&
+                    Index + 1 < Line->LengthInChars &&
+                    Line->StartOfString[Index + 1] == '/') {
 
-    if (YoriWinMultilineEditIsUndoAvailable(EditContext->MultilineEdit)) {
-        YoriWinMenuBarEnableMenuItem(UndoItem);
-    } else {
-        YoriWinMenuBarDisableMenuItem(UndoItem);
-    }
+                    Index = Index + 2;
+                    State = EDIT_HIGHLIGHT_STATE_NORMAL;
+                    break;
+                }
+                Index++;
+            }
+            EditHighlightRange(Attributes, Start, Index - Start, EDIT_HIGHLIGHT_COMMENT_COLOR);
+            continue;
+        }
 
-    if (YoriWinMultilineEditIsRedoAvailable(EditContext->MultilineEdit)) {
-        YoriWinMenuBarEnableMenuItem(RedoItem);
-    } else {
-        YoriWinMenuBarDisableMenuItem(RedoItem);
-    }
+        Char = Line->StartOfString[Index];
 
-    if (TextSelected) {
-        YoriWinMenuBarEnableMenuItem(CutItem);
-        YoriWinMenuBarEnableMenuItem(CopyItem);
-    } else {
-        YoriWinMenuBarDisableMenuItem(CutItem);
-        YoriWinMenuBarDisableMenuItem(CopyItem);
-    }
+        if (Char == ' ' || Char == '\t') {
+            Index++;
+            continue;
+        }
 
-    if (TextSelected) {
-        YoriWinMenuBarEnableMenuItem(ClearItem);
-    } else {
-        YoriWinMenuBarDisableMenuItem(ClearItem);
-    }
+        if (Char == '/' && Index + 1 < Line->LengthInChars) {
+            if (Line->StartOfString[Index + 1] == '/') {
+                EditHighlightRange(Attributes, Index, Line->LengthInChars - Index, EDIT_HIGHLIGHT_COMMENT_COLOR);
+                break;
+            } else if (Line->StartOfString[Index + 1] == '*') {
+                State = EDIT_HIGHLIGHT_STATE_IN_COMMENT;
+                EditHighlightRange(Attributes, Index, 2, EDIT_HIGHLIGHT_COMMENT_COLOR);
+                Index = Index + 2;
+                continue;
+            }
+        }
 
-    if (ClipboardText.LengthInChars > 0) {
-        YoriWinMenuBarEnableMenuItem(PasteItem);
-    } else {
-        YoriWinMenuBarDisableMenuItem(PasteItem);
+        if (Char == '#' && LineStart) {
+            Start = Index;
+            Index++;
+            while (Index < Line->LengthInChars &&
+                   (Line->StartOfString[Index] == ' ' || EditIsIdentifierChar(Line->StartOfString[Index]))) {
+                Index++;
+            }
+            EditHighlightRange(Attributes, Start, Index - Start, EDIT_HIGHLIGHT_PREPROC_COLOR);
+            LineStart = FALSE;
+            continue;
+        }
+
+        LineStart = FALSE;
+
+        if (Char == '"' || Char == '\'') {
+            Quote = Char;
+            Start = Index;
+            Index++;
+            while (Index < Line->LengthInChars) {
+                if (Line->StartOfString[Index] == '\\') {
+                    Index = Index + 2;
+                    continue;
+                }
+                if (Line->StartOfString[Index] == Quote) {
+                    Index++;
+                    break;
+                }
+                Index++;
+            }
+            if (Index > Line->LengthInChars) {
+                Index = Line->LengthInChars;
+            }
+            EditHighlightRange(Attributes, Start, Index - Start, EDIT_HIGHLIGHT_STRING_COLOR);
+            continue;
+        }
+
+        if (EditIsIdentifierChar(Char)) {
+            Start = Index;
+            while (Index < Line->LengthInChars && EditIsIdentifierChar(Line->StartOfString[Index])) {
+                Index++;
+            }
+
+            //
+            //  Keywords do not change the state, so there is no need to look
+            //  for them if only the state is needed.
+            //
+
+            if (Attributes == NULL) {
+                continue;
+            }
+
+            YoriLibInitEmptyString(&Word);
+            Word.StartOfString = &Line->StartOfString[Start];
+            Word.LengthInChars = Index - Start;
+            for (KeywordIndex = 0; KeywordIndex < sizeof(EditSourceKeywords)/sizeof(EditSourceKeywords[0]); KeywordIndex++) {
+                if (YoriLibCompareStringLit(&Word, EditSourceKeywords[KeywordIndex]) == 0) {
+                    EditHighlightRange(Attributes, Start, Word.LengthInChars, EDIT_HIGHLIGHT_KEYWORD_COLOR);
+                    break;
+                }
+            }
+            continue;
+        }
+
+        Index++;
     }
 
-    YoriLibFreeStringContents(&ClipboardText);
+    return State;
 }
 
 /**
- A callback invoked when the undo button is clicked.
+ Highlight every match of the current search string within a line.
 
- @param Ctrl Pointer to the button that was clicked.
+ @param EditContext Pointer to the edit context specifying the search string.
+
+ @param Line Pointer to the text of the line.
+
+ @param Attributes Points to an array of attributes, one per character in the
+        line, to update.
  */
 VOID
-EditUndoButtonClicked(
-    __in PYORI_WIN_CTRL_HANDLE Ctrl
+EditHighlightSearchMatches(
+    __in PEDIT_CONTEXT EditContext,
+    __in PCYORI_STRING Line,
+    __in PWORD Attributes
     )
 {
-    PYORI_WIN_CTRL_HANDLE Parent;
-    PEDIT_CONTEXT EditContext;
+    YORI_ALLOC_SIZE_T StartOffset;
+    YORI_ALLOC_SIZE_T Offset;
+    YORI_ALLOC_SIZE_T Length;
+    YORI_STRING Substring;
+    PYORI_STRING Match;
+    WORD Color;
 
-    Parent = YoriWinGetControlParent(Ctrl);
-    EditContext = YoriWinGetControlContext(Parent);
-    YoriWinMultilineEditUndo(EditContext->MultilineEdit);
+    Color = EDIT_HIGHLIGHT_MATCH_COLOR;
+    if (EditContext->UseMonoDisplay) {
+        Color = EDIT_HIGHLIGHT_MATCH_MONO_COLOR;
+    }
+
+    StartOffset = 0;
+    while (StartOffset < Line->LengthInChars) {
+        if (EditContext->SearchRegexValid) {
+            if (!EditFindNextRegexMatch(&EditContext->SearchRegexCompiled, Line, StartOffset, &Offset, &Length)) {
+                break;
+            }
+        } else if (EditContext->SearchMatcherValid) {
+            YoriLibInitEmptyString(&Substring);
+            Substring.StartOfString = &Line->StartOfString[StartOffset];
+            Substring.LengthInChars = Line->LengthInChars - StartOffset;
+            Match = YoriLibSubstringMatcherFindFirst(&EditContext->SearchMatcher, &Substring, &Offset);
+            if (Match == NULL) {
+                break;
+            }
+            Offset = Offset + StartOffset;
+            Length = EditContext->SearchString.LengthInChars;
+        } else {
+            break;
+        }
+
+        if (Offset + Length > Line->LengthInChars) {
+            Length = Line->LengthInChars - Offset;
+        }
+        EditHighlightRange(Attributes, Offset, Length, Color);
+        StartOffset = Offset + Length;
+    }
 }
 
 /**
- A callback invoked when the redo button is clicked.
+ A callback invoked by the multiline edit control to determine the colors of
+ text on a line.
 
- @param Ctrl Pointer to the button that was clicked.
- */
-VOID
-EditRedoButtonClicked(
-    __in PYORI_WIN_CTRL_HANDLE Ctrl
-    )
-{
-    PYORI_WIN_CTRL_HANDLE Parent;
-    PEDIT_CONTEXT EditContext;
+ @param Ctrl Pointer to the multiline edit control.
 
-    Parent = YoriWinGetControlParent(Ctrl);
-    EditContext = YoriWinGetControlContext(Parent);
-    YoriWinMultilineEditRedo(EditContext->MultilineEdit);
-}
+ @param Line Pointer to the text of the line.
 
+ @param StateAtStart The highlight state at the start of the line.
 
-/**
- A callback invoked when the cut button is clicked.
+ @param Attributes Optionally points to an array of attributes, one per
+        character in the line, to update.  If NULL, only the state at the
+        end of the line is needed.
 
- @param Ctrl Pointer to the button that was clicked.
+ @param StateAtEnd On completion, updated with the highlight state at the end
+        of the line.
  */
 VOID
-EditCutButtonClicked(
-    __in PYORI_WIN_CTRL_HANDLE Ctrl
+EditHighlightLine(
+    __in PYORI_WIN_CTRL_HANDLE Ctrl,
+    __in PCYORI_STRING Line,
+    __in DWORD StateAtStart,
+    __in_opt PWORD Attributes,
+    __out PDWORD StateAtEnd
     )
 {
     PYORI_WIN_CTRL_HANDLE Parent;
     PEDIT_CONTEXT EditContext;
+    DWORD State;
 
     Parent = YoriWinGetControlParent(Ctrl);
     EditContext = YoriWinGetControlContext(Parent);
-    YoriWinMultilineEditCutSelectedText(EditContext->MultilineEdit);
-}
 
-/**
- A callback invoked when the copy button is clicked.
+    State = StateAtStart;
+    if (EditContext->HighlightSyntax) {
+        State = EditHighlightSourceLine(Line, State, Attributes);
+    }
 
- @param Ctrl Pointer to the button that was clicked.
- */
-VOID
-EditCopyButtonClicked(
-    __in PYORI_WIN_CTRL_HANDLE Ctrl
-    )
-{
-    PYORI_WIN_CTRL_HANDLE Parent;
-    PEDIT_CONTEXT EditContext;
+    if (Attributes != NULL && EditContext->SearchString.LengthInChars > 0) {
+        EditHighlightSearchMatches(EditContext, Line, Attributes);
+    }
 
-    Parent = YoriWinGetControlParent(Ctrl);
-    EditContext = YoriWinGetControlContext(Parent);
-    YoriWinMultilineEditCopySelectedText(EditContext->MultilineEdit);
+    *StateAtEnd = State;
 }
 
 /**
- A callback invoked when the paste button is clicked.
+ Determine whether any highlighting is needed for the currently opened file
+ and search, and register or remove the highlight callback accordingly.
 
- @param Ctrl Pointer to the button that was clicked.
+ @param EditContext Pointer to the edit context.
  */
 VOID
-EditPasteButtonClicked(
-    __in PYORI_WIN_CTRL_HANDLE Ctrl
+EditUpdateHighlight(
+    __in PEDIT_CONTEXT EditContext
     )
 {
-    PYORI_WIN_CTRL_HANDLE Parent;
-    PEDIT_CONTEXT EditContext;
+    EditContext->HighlightSyntax = FALSE;
+    if (!EditContext->UseMonoDisplay &&
+        EditContext->OpenFileName.LengthInChars > 0 &&
+        EditIsSourceFileName(&EditContext->OpenFileName)) {
 
-    Parent = YoriWinGetControlParent(Ctrl);
-    EditContext = YoriWinGetControlContext(Parent);
-    YoriWinMultilineEditPasteText(EditContext->MultilineEdit);
+        EditContext->HighlightSyntax = TRUE;
+    }
+
+    //
+    //  Highlight colors assume the control is using the colors set when it
+    //  is created, which requires background color support.
+    //
+
+    if (YoriLibDoesSystemSupportBackgroundColors() &&
+        (EditContext->HighlightSyntax || EditContext->SearchString.LengthInChars > 0)) {
+
+        YoriWinMultilineEditSetHighlightCallback(EditContext->MultilineEdit, EditHighlightLine);
+    } else {
+        YoriWinMultilineEditSetHighlightCallback(EditContext->MultilineEdit, NULL);
+    }
 }
 
 /**
- A callback invoked when the clear button is clicked.
+ Prepare to search for the current search string.  The search string is
+ compiled once here so that it can be used to find matches and to highlight
+ matches within each displayed line without preparing it again for every
+ line or every search.
 
- @param Ctrl Pointer to the button that was clicked.
+ @param EditContext Pointer to the edit context specifying the search string
+        and options.
  */
 VOID
-EditClearButtonClicked(
-    __in PYORI_WIN_CTRL_HANDLE Ctrl
+EditPrepareSearch(
+    __in PEDIT_CONTEXT EditContext
     )
 {
-    PYORI_WIN_CTRL_HANDLE Parent;
-    PEDIT_CONTEXT EditContext;
+    if (EditContext->SearchMatcherValid) {
+        YoriLibSubstringMatcherCleanup(&EditContext->SearchMatcher);
+        EditContext->SearchMatcherValid = FALSE;
+    }
 
-    Parent = YoriWinGetControlParent(Ctrl);
-    EditContext = YoriWinGetControlContext(Parent);
-    YoriWinMultilineEditDeleteSelection(EditContext->MultilineEdit);
+    if (EditContext->SearchRegexValid) {
+        YoriLibRegexCleanup(&EditContext->SearchRegexCompiled);
+        EditContext->SearchRegexValid = FALSE;
+    }
+
+    if (EditContext->SearchString.LengthInChars > 0) {
+        if (EditContext->SearchRegex) {
+            if (YoriLibRegexCompile(&EditContext->SearchRegexCompiled, &EditContext->SearchString, (BOOLEAN)!EditContext->SearchMatchCase, NULL)) {
+                EditContext->SearchRegexValid = TRUE;
+            }
+        } else if (YoriLibSubstringMatcherInitialize(&EditContext->SearchMatcher, 1, &EditContext->SearchString, (BOOLEAN)!EditContext->SearchMatchCase)) {
+            EditContext->SearchMatcherValid = TRUE;
+        }
+    }
+
+    EditUpdateHighlight(EditContext);
 }
 
 /**
@@ -1685,6 +3105,9 @@ EditClearButtonClicked(
  @param NextMatchOffset On successful completion, populated with the zero
         based character index of the next match.
 
+ @param NextMatchLength On successful completion, populated with the number
+        of characters in the next match.
+
  @return TRUE to indicate a match was found, FALSE to indicate it was not.
  */
 __success(return)
@@ -1694,15 +3117,20 @@ EditFindNextMatchingString(
     __in YORI_ALLOC_SIZE_T StartLine,
     __in YORI_ALLOC_SIZE_T StartOffset,
     __out PYORI_ALLOC_SIZE_T NextMatchLine,
-    __out PYORI_ALLOC_SIZE_T NextMatchOffset
+    __out PYORI_ALLOC_SIZE_T NextMatchOffset,
+    __out PYORI_ALLOC_SIZE_T NextMatchLength
     )
 {
     YORI_ALLOC_SIZE_T LineCount;
     YORI_ALLOC_SIZE_T LineIndex;
     YORI_ALLOC_SIZE_T Offset;
+    YORI_ALLOC_SIZE_T Length;
     YORI_STRING Substring;
     PYORI_STRING Line;
     PYORI_STRING Match;
+    PYORI_LIB_SUBSTRING_MATCHER Matcher;
+    PYORI_LIB_REGEX Regex;
+    BOOLEAN Found;
 
     if (EditContext->SearchString.LengthInChars == 0) {
         return FALSE;
@@ -1713,6 +3141,22 @@ EditFindNextMatchingString(
         return FALSE;
     }
 
+    //
+    //  The search string was prepared when it was specified.  A search
+    //  string which is not a valid regular expression matches nothing.
+    //
+
+    Matcher = NULL;
+    Regex = NULL;
+    if (EditContext->SearchRegex) {
+        if (!EditContext->SearchRegexValid) {
+            return FALSE;
+        }
+        Regex = &EditContext->SearchRegexCompiled;
+    } else if (EditContext->SearchMatcherValid) {
+        Matcher = &EditContext->SearchMatcher;
+    }
+
     //
     //  For the line that the cursor is on, extract the substring of text
     //  that follows the cursor and search in that.  If a match is found,
@@ -1720,13 +3164,25 @@ EditFindNextMatchingString(
     //  account for the substring offset.
     //
 
+    Found = FALSE;
     Line = YoriWinMultilineEditGetLineByIndex(EditContext->MultilineEdit, StartLine);
 
-    if (StartOffset < Line->LengthInChars) {
+    if (Regex != NULL) {
+        if (StartOffset < Line->LengthInChars &&
+            EditFindNextRegexMatch(Regex, Line, StartOffset, &Offset, &Length)) {
+
+            *NextMatchLine = StartLine;
+            *NextMatchOffset = Offset;
+            *NextMatchLength = Length;
+            Found = TRUE;
+        }
+    } else if (StartOffset < Line->LengthInChars) {
         YoriLibInitEmptyString(&Substring);
         Substring.StartOfString = Line->StartOfString + StartOffset;
         Substring.LengthInChars = Line->LengthInChars - StartOffset;
-        if (EditContext->SearchMatchCase) {
+        if (Matcher != NULL) {
+            Match = YoriLibSubstringMatcherFindFirst(Matcher, &Substring, &Offset);
+        } else if (EditContext->SearchMatchCase) {
             Match = YoriLibFindFirstMatchSubstr(&Substring, 1, &EditContext->SearchString, &Offset);
         } else {
             Match = YoriLibFindFirstMatchSubstrIns(&Substring, 1, &EditContext->SearchString, &Offset);
@@ -1735,7 +3191,8 @@ EditFindNextMatchingString(
         if (Match != NULL) {
             *NextMatchLine = StartLine;
             *NextMatchOffset = Offset + StartOffset;
-            return TRUE;
+            *NextMatchLength = EditContext->SearchString.LengthInChars;
+            Found = TRUE;
         }
     }
 
@@ -1743,9 +3200,21 @@ EditFindNextMatchingString(
     //  Do the rest of the lines the easy way
     //
 
-    for (LineIndex = StartLine + 1; LineIndex < LineCount; LineIndex++) {
+    for (LineIndex = StartLine + 1; !Found && LineIndex < LineCount; LineIndex++) {
         Line = YoriWinMultilineEditGetLineByIndex(EditContext->MultilineEdit, LineIndex);
-        if (EditContext->SearchMatchCase) {
+        if (Regex != NULL) {
+            if (EditFindNextRegexMatch(Regex, Line, 0, &Offset, &Length)) {
+                *NextMatchLine = LineIndex;
+                *NextMatchOffset = Offset;
+                *NextMatchLength = Length;
+                Found = TRUE;
+            }
+            continue;
+        }
+
+        if (Matcher != NULL) {
+            Match = YoriLibSubstringMatcherFindFirst(Matcher, Line, &Offset);
+        } else if (EditContext->SearchMatchCase) {
             Match = YoriLibFindFirstMatchSubstr(Line, 1, &EditContext->SearchString, &Offset);
         } else {
             Match = YoriLibFindFirstMatchSubstrIns(Line, 1, &EditContext->SearchString, &Offset);
@@ -1753,11 +3222,12 @@ EditFindNextMatchingString(
         if (Match != NULL) {
             *NextMatchLine = LineIndex;
             *NextMatchOffset = Offset;
-            return TRUE;
+            *NextMatchLength = EditContext->SearchString.LengthInChars;
+            Found = TRUE;
         }
     }
 
-    return FALSE;
+    return Found;
 }
 
 /**
@@ -1778,6 +3248,9 @@ EditFindNextMatchingString(
  @param NextMatchOffset On successful completion, populated with the zero
         based character index of the next match.
 
+ @param NextMatchLength On successful completion, populated with the number
+        of characters in the next match.
+
  @return TRUE to indicate a match was found, FALSE to indicate it was not.
  */
 __success(return)
@@ -1787,15 +3260,19 @@ EditFindPreviousMatchingString(
     __in YORI_ALLOC_SIZE_T StartLine,
     __in YORI_ALLOC_SIZE_T StartOffset,
     __out PYORI_ALLOC_SIZE_T NextMatchLine,
-    __out PYORI_ALLOC_SIZE_T NextMatchOffset
+    __out PYORI_ALLOC_SIZE_T NextMatchOffset,
+    __out PYORI_ALLOC_SIZE_T NextMatchLength
     )
 {
     YORI_ALLOC_SIZE_T LineCount;
     YORI_ALLOC_SIZE_T LineIndex;
     YORI_ALLOC_SIZE_T Offset;
+    YORI_ALLOC_SIZE_T Length;
     YORI_STRING Substring;
     PYORI_STRING Line;
     PYORI_STRING Match;
+    PYORI_LIB_REGEX Regex;
+    BOOLEAN Found;
 
     if (EditContext->SearchString.LengthInChars == 0) {
         return FALSE;
@@ -1806,6 +3283,34 @@ EditFindPreviousMatchingString(
         return FALSE;
     }
 
+    if (EditContext->SearchRegex) {
+        if (!EditContext->SearchRegexValid) {
+            return FALSE;
+        }
+
+        Regex = &EditContext->SearchRegexCompiled;
+        Found = FALSE;
+        Line = YoriWinMultilineEditGetLineByIndex(EditContext->MultilineEdit, StartLine);
+        if (EditFindPreviousRegexMatch(Regex, Line, StartOffset, &Offset, &Length)) {
+            *NextMatchLine = StartLine;
+            *NextMatchOffset = Offset;
+            *NextMatchLength = Length;
+            Found = TRUE;
+        }
+
+        for (LineIndex = StartLine; !Found && LineIndex > 0; LineIndex--) {
+            Line = YoriWinMultilineEditGetLineByIndex(EditContext->MultilineEdit, LineIndex - 1);
+            if (EditFindPreviousRegexMatch(Regex, Line, Line->LengthInChars, &Offset, &Length)) {
+                *NextMatchLine = LineIndex - 1;
+                *NextMatchOffset = Offset;
+                *NextMatchLength = Length;
+                Found = TRUE;
+            }
+        }
+
+        return Found;
+    }
+
     //
     //  For the line that the cursor is on, extract the substring of text
     //  that is before the cursor, plus the length of the search string.
@@ -1831,6 +3336,7 @@ EditFindPreviousMatchingString(
     if (Match != NULL) {
         *NextMatchLine = StartLine;
         *NextMatchOffset = Offset;
+        *NextMatchLength = EditContext->SearchString.LengthInChars;
         return TRUE;
     }
 
@@ -1848,6 +3354,7 @@ EditFindPreviousMatchingString(
         if (Match != NULL) {
             *NextMatchLine = LineIndex - 1;
             *NextMatchOffset = Offset;
+            *NextMatchLength = EditContext->SearchString.LengthInChars;
             return TRUE;
         }
     }
@@ -1872,6 +3379,7 @@ EditFindNextFromCurrentPosition(
     YORI_ALLOC_SIZE_T CursorLine;
     YORI_ALLOC_SIZE_T NextMatchLine;
     YORI_ALLOC_SIZE_T NextMatchOffset;
+    YORI_ALLOC_SIZE_T NextMatchLength;
 
     YORI_ALLOC_SIZE_T SelectionEndLine;
     YORI_ALLOC_SIZE_T SelectionEndOffset;
@@ -1892,9 +3400,9 @@ EditFindNextFromCurrentPosition(
         CursorOffset++;
     }
 
-    if (EditFindNextMatchingString(EditContext, CursorLine, CursorOffset, &NextMatchLine, &NextMatchOffset)) {
+    if (EditFindNextMatchingString(EditContext, CursorLine, CursorOffset, &NextMatchLine, &NextMatchOffset, &NextMatchLength)) {
 
-        YoriWinMultilineEditSetSelectionRange(EditContext->MultilineEdit, NextMatchLine, NextMatchOffset, NextMatchLine, NextMatchOffset + EditContext->SearchString.LengthInChars);
+        YoriWinMultilineEditSetSelectionRange(EditContext->MultilineEdit, NextMatchLine, NextMatchOffset, NextMatchLine, NextMatchOffset + NextMatchLength);
         return TRUE;
     }
 
@@ -1915,6 +3423,7 @@ EditFindButtonClicked(
     YORI_STRING Text;
     YORI_STRING InitialText;
     BOOLEAN MatchCase;
+    BOOLEAN Regex;
     PYORI_WIN_CTRL_HANDLE Parent;
     PEDIT_CONTEXT EditContext;
 
@@ -1942,6 +3451,7 @@ EditFindButtonClicked(
                          &Title,
                          &InitialText,
                          &MatchCase,
+                         &Regex,
                          &Text)) {
 
         YoriLibFreeStringContents(&InitialText);
@@ -1957,6 +3467,8 @@ EditFindButtonClicked(
     YoriLibFreeStringContents(&EditContext->SearchString);
     memcpy(&EditContext->SearchString, &Text, sizeof(YORI_STRING));
     EditContext->SearchMatchCase = MatchCase;
+    EditContext->SearchRegex = Regex;
+    EditPrepareSearch(EditContext);
 
     if (!EditFindNextFromCurrentPosition(EditContext)) {
         YORI_STRING ButtonText[1];
@@ -2028,6 +3540,7 @@ EditFindPreviousButtonClicked(
     YORI_ALLOC_SIZE_T CursorLine;
     YORI_ALLOC_SIZE_T NextMatchLine;
     YORI_ALLOC_SIZE_T NextMatchOffset;
+    YORI_ALLOC_SIZE_T NextMatchLength;
     PYORI_WIN_CTRL_HANDLE Parent;
     PEDIT_CONTEXT EditContext;
 
@@ -2062,9 +3575,9 @@ EditFindPreviousButtonClicked(
         }
     }
 
-    if (EditFindPreviousMatchingString(EditContext, CursorLine, CursorOffset, &NextMatchLine, &NextMatchOffset)) {
+    if (EditFindPreviousMatchingString(EditContext, CursorLine, CursorOffset, &NextMatchLine, &NextMatchOffset, &NextMatchLength)) {
 
-        YoriWinMultilineEditSetSelectionRange(EditContext->MultilineEdit, NextMatchLine, NextMatchOffset, NextMatchLine, NextMatchOffset + EditContext->SearchString.LengthInChars);
+        YoriWinMultilineEditSetSelectionRange(EditContext->MultilineEdit, NextMatchLine, NextMatchOffset, NextMatchLine, NextMatchOffset + NextMatchLength);
     } else {
         YORI_STRING Title;
         YORI_STRING Text;
@@ -2100,6 +3613,7 @@ EditChangeButtonClicked(
     YORI_STRING NewText;
     YORI_STRING InitialBeforeText;
     BOOLEAN MatchCase;
+    BOOLEAN Regex;
     BOOLEAN ReplaceAll;
     BOOLEAN MatchFound;
     PYORI_WIN_CTRL_HANDLE Parent;
@@ -2108,6 +3622,7 @@ EditChangeButtonClicked(
     YORI_ALLOC_SIZE_T StartOffset;
     YORI_ALLOC_SIZE_T NextMatchLine;
     YORI_ALLOC_SIZE_T NextMatchOffset;
+    YORI_ALLOC_SIZE_T NextMatchLength;
     WORD DialogTop;
 
     Parent = YoriWinGetControlParent(Ctrl);
@@ -2117,6 +3632,7 @@ EditChangeButtonClicked(
     YoriLibInitEmptyString(&NewText);
     ReplaceAll = FALSE;
     MatchCase = FALSE;
+    Regex = FALSE;
     MatchFound = FALSE;
 
     YoriWinMultilineEditGetCursorLocation(EditContext->MultilineEdit, &StartOffset, &StartLine);
@@ -2205,6 +3721,7 @@ EditChangeButtonClicked(
                                     &InitialBeforeText,
                                     &NewText,
                                     &MatchCase,
+                                    &Regex,
                                     &ReplaceAll,
                                     &OldText,
                                     &NewText)) {
@@ -2236,6 +3753,8 @@ EditChangeButtonClicked(
             }
 
             EditContext->SearchMatchCase = MatchCase;
+            EditContext->SearchRegex = Regex;
+            EditPrepareSearch(EditContext);
         }
 
         if (MatchFound) {
@@ -2244,7 +3763,7 @@ EditChangeButtonClicked(
             StartOffset = StartOffset + NewText.LengthInChars;
         }
 
-        if (!EditFindNextMatchingString(EditContext, StartLine, StartOffset, &NextMatchLine, &NextMatchOffset)) {
+        if (!EditFindNextMatchingString(EditContext, StartLine, StartOffset, &NextMatchLine, &NextMatchOffset, &NextMatchLength)) {
             break;
         }
 
@@ -2256,7 +3775,7 @@ EditChangeButtonClicked(
         //  it still needs to be updated once before returning to the user.
         //
 
-        YoriWinMultilineEditSetSelectionRange(EditContext->MultilineEdit, NextMatchLine, NextMatchOffset, NextMatchLine, NextMatchOffset + EditContext->SearchString.LengthInChars);
+        YoriWinMultilineEditSetSelectionRange(EditContext->MultilineEdit, NextMatchLine, NextMatchOffset, NextMatchLine, NextMatchOffset + NextMatchLength);
         StartLine = NextMatchLine;
         StartOffset = NextMatchOffset;
     }
@@ -2699,24 +4218,11 @@ EditNotifyCursorMove(
 {
     PYORI_WIN_CTRL_HANDLE Parent;
     PEDIT_CONTEXT EditContext;
-    YORI_STRING NewStatus;
 
     Parent = YoriWinGetControlParent(Ctrl);
     EditContext = YoriWinGetControlContext(Parent);
 
-    YoriLibInitEmptyString(&NewStatus);
-    YoriLibYPrintf(&NewStatus, _T("%06i:%04i "), CursorLine + 1, CursorOffset + 1);
-
-    YoriWinLabelSetCaption(EditContext->StatusBar, &NewStatus);
-    YoriLibFreeStringContents(&NewStatus);
-
-    //
-    //  In a strange optimization reversal, force a repaint after this update
-    //  in the hope that this console update is isolated to this without
-    //  needing to update piles of user text at the same time
-    //
-
-    YoriWinDisplayWindowContents(Parent);
+    EditRefreshStatusBar(EditContext, CursorOffset, CursorLine);
 }
 
 
@@ -3095,6 +4601,9 @@ EditCreateMainWindow(
     YoriWinMultilineEditSetAutoIndent(MultilineEdit, EditContext->AutoIndent);
     YoriWinMultilineEditSetTraditionalNavigation(MultilineEdit, EditContext->TraditionalNavigation);
     YoriWinMultilineEditSetExpandTab(MultilineEdit, EditContext->ExpandTab);
+    if (EditContext->UndoLimitInMb != (DWORD)-1) {
+        YoriWinMultilineEditSetUndoBudget(MultilineEdit, (DWORDLONG)EditContext->UndoLimitInMb * 1024 * 1024);
+    }
 
     Rect.Top = (SHORT)(Rect.Bottom + 1);
     Rect.Bottom = Rect.Top;
@@ -3135,7 +4644,7 @@ EditCreateMainWindow(
     if (EditContext->OpenFileName.StartOfString != NULL) {
         EditLoadFile(EditContext, &EditContext->OpenFileName);
         EditUpdateOpenedFileCaption(EditContext);
-        YoriWinMultilineEditSetReadOnly(EditContext->MultilineEdit, EditContext->ReadOnly);
+        EditApplyReadOnly(EditContext);
     }
 
     YoriWinSetControlContext(Parent, EditContext);
@@ -3146,6 +4655,9 @@ EditCreateMainWindow(
         Result = FALSE;
     }
 
+    EditCompleteLoad(EditContext, TRUE);
+    EditCompleteSave(EditContext);
+
     YoriWinDestroyWindow(Parent);
     YoriWinCloseWindowManager(WinMgr);
     return (BOOL)Result;
@@ -3218,6 +4730,7 @@ ENTRYPOINT(
     }
 
     GlobalEditContext.TabWidth = (DWORD)-1;
+    GlobalEditContext.UndoLimitInMb = (DWORD)-1;
     GlobalEditContext.TraditionalNavigation = TRUE;
     GlobalEditContext.AutoIndent = TRUE;
     GlobalEditContext.ExpandTab = FALSE;
@@ -263,10 +263,92 @@ EnvDiffOutputDifference(
     return TRUE;
 }
 
+/**
+ A variable within the base environment, used to find the variables that
+ have been added, removed or changed in the new environment.
+ */
+typedef struct _ENVDIFF_BASE_ENTRY {
+
+    /**
+     The hash entry for the variable, keyed by the variable name.
+     */
+    YORI_HASH_ENTRY HashEntry;
+
+    /**
+     The value of the variable.  This points into the base environment
+     block.
+     */
+    YORI_STRING Value;
+
+    /**
+     Set to TRUE if the new environment contains this variable, so it
+     should not be reported as removed.
+     */
+    BOOLEAN Retained;
+
+} ENVDIFF_BASE_ENTRY, *PENVDIFF_BASE_ENTRY;
+
+/**
+ Return the next variable within an environment block that describes user
+ state.  Variables whose name starts with "=" are used for per drive current
+ directories and exit code, and are skipped, as are any entries without a
+ name.
+
+ @param EnvironmentBlock Pointer to the environment block.
+
+ @param Offset On input, the offset within the environment block to start
+        searching from.  On successful completion, updated to the offset of
+        the following entry.
+
+ @param Key On successful completion, updated to point to the variable name
+        within the environment block.
+
+ @param Value On successful completion, updated to point to the variable
+        value within the environment block.
+
+ @return TRUE if a variable was found, FALSE if the end of the block has
+         been reached.
+ */
+__success(return)
+BOOLEAN
+EnvDiffGetNextVariable(
+    __in PYORI_STRING EnvironmentBlock,
+    __inout PYORI_ALLOC_SIZE_T Offset,
+    __out PYORI_STRING Key,
+    __out PYORI_STRING Value
+    )
+{
+    YORI_STRING KeyValue;
+
+    while (TRUE) {
+        EnvDiffKeyValueAtOffset(EnvironmentBlock, *Offset, &KeyValue);
+        if (KeyValue.LengthInChars == 0) {
+            return FALSE;
+        }
+
+        *Offset = EnvDiffGetNextKeyValueOffset(EnvironmentBlock, &KeyValue, *Offset);
+
+        EnvDiffGetKeyFromKeyValue(&KeyValue, Key);
+        if (Key->LengthInChars > 0 &&
+            Key->StartOfString[0] != '=') {
+
+            EnvDiffGetValueFromKeyValue(&KeyValue, Key, Value);
+            return TRUE;
+        }
+    }
+}
+
 /**
  Compare two environment blocks, and output the differences in the specified
  format.
 
+ The base environment is indexed by name in a hash table, and the new
+ environment is checked against it, so the blocks do not need to be sorted
+ in any particular order and the comparison takes linear time.  Variables
+ that are added or modified are output in the order of the new environment,
+ followed by variables that are removed in the order of the base
+ environment.
+
  @param BaseEnvironment Pointer to the original environment block.
 
  @param NewEnvironment Pointer to the new environment block.
@@ -275,6 +357,7 @@ EnvDiffOutputDifference(
 
  @return TRUE to indicate success, FALSE to indicate failure.
  */
+__success(return)
 BOOLEAN
 EnvDiffCompareEnvironments(
     __in PYORI_STRING BaseEnvironment,
@@ -282,103 +365,101 @@ EnvDiffCompareEnvironments(
     __in ENVDIFF_OUTPUT_FORMAT OutputFormat
     )
 {
-    YORI_STRING BaseKeyValue;
-    YORI_STRING NewKeyValue;
-    YORI_STRING BaseKey;
-    YORI_STRING NewKey;
-    YORI_STRING BaseValue;
-    YORI_STRING NewValue;
-    YORI_ALLOC_SIZE_T BaseStart;
-    YORI_ALLOC_SIZE_T NewStart;
-    int Compare;
-
-    YoriLibInitEmptyString(&BaseKeyValue);
-    YoriLibInitEmptyString(&NewKeyValue);
-
-    BaseStart = 0;
-    NewStart = 0;
-
-    while (TRUE) {
+    YORI_STRING Key;
+    YORI_STRING Value;
+    PYORI_HASH_TABLE BaseVariables;
+    PYORI_HASH_ENTRY HashEntry;
+    PENVDIFF_BASE_ENTRY Entries;
+    PENVDIFF_BASE_ENTRY Entry;
+    YORI_ALLOC_SIZE_T VarCount;
+    YORI_ALLOC_SIZE_T Index;
+    YORI_ALLOC_SIZE_T Offset;
 
-        EnvDiffKeyValueAtOffset(BaseEnvironment, BaseStart, &BaseKeyValue);
-        EnvDiffKeyValueAtOffset(NewEnvironment, NewStart, &NewKeyValue);
+    //
+    //  Count the variables in the base environment so a single allocation
+    //  can describe all of them.
+    //
 
-        if (BaseKeyValue.LengthInChars == 0 &&
-            NewKeyValue.LengthInChars == 0) {
+    VarCount = 0;
+    Offset = 0;
+    while (EnvDiffGetNextVariable(BaseEnvironment, &Offset, &Key, &Value)) {
+        VarCount++;
+    }
 
-            break;
+    BaseVariables = YoriLibAllocateHashTable(256);
+    Entries = YoriLibMalloc((VarCount + 1) * (YORI_ALLOC_SIZE_T)sizeof(ENVDIFF_BASE_ENTRY));
+    if (BaseVariables == NULL || Entries == NULL) {
+        if (BaseVariables != NULL) {
+            YoriLibFreeEmptyHashTable(BaseVariables);
         }
-
-        EnvDiffGetKeyFromKeyValue(&BaseKeyValue, &BaseKey);
-        EnvDiffGetKeyFromKeyValue(&NewKeyValue, &NewKey);
-        EnvDiffGetValueFromKeyValue(&BaseKeyValue, &BaseKey, &BaseValue);
-        EnvDiffGetValueFromKeyValue(&NewKeyValue, &NewKey, &NewValue);
-
-        //
-        //  Skip any variables whose name starts with "=".  These are used for
-        //  per drive current directories and exit code, and are not 
-        //  really user state.
-        //
-
-        if (BaseKey.LengthInChars > 0 &&
-            BaseKey.StartOfString[0] == '=') {
-
-            BaseStart = EnvDiffGetNextKeyValueOffset(BaseEnvironment, &BaseKeyValue, BaseStart);
-            continue;
+        if (Entries != NULL) {
+            YoriLibFree(Entries);
         }
+        return FALSE;
+    }
 
-        if (NewKey.LengthInChars > 0 &&
-            NewKey.StartOfString[0] == '=') {
+    //
+    //  Index the base environment by name.  Names are compared without
+    //  regard to case, as the system does.  If a file contains the same
+    //  name more than once, the final value is the one that applies.
+    //
 
-            NewStart = EnvDiffGetNextKeyValueOffset(NewEnvironment, &NewKeyValue, NewStart);
+    Index = 0;
+    Offset = 0;
+    while (EnvDiffGetNextVariable(BaseEnvironment, &Offset, &Key, &Value)) {
+        HashEntry = YoriLibHashLookupByKey(BaseVariables, &Key);
+        if (HashEntry != NULL) {
+            Entry = HashEntry->Context;
+            memcpy(&Entry->Value, &Value, sizeof(YORI_STRING));
             continue;
         }
 
-        //
-        //  If there is no base value, there is a new variable added that is
-        //  not in base.  If there is no new value, there is a value in base
-        //  that has been removed.
-        //
+        Entry = &Entries[Index];
+        memcpy(&Entry->Value, &Value, sizeof(YORI_STRING));
+        Entry->Retained = FALSE;
+        YoriLibHashInsertByKey(BaseVariables, &Key, Entry, &Entry->HashEntry);
+        Index++;
+    }
+    VarCount = Index;
 
-        if (BaseKeyValue.LengthInChars == 0) {
-            EnvDiffOutputDifference(&NewKey, NULL, &NewValue, OutputFormat, EnvDiffChangeAdd);
-            NewStart = EnvDiffGetNextKeyValueOffset(NewEnvironment, &NewKeyValue, NewStart);
-        } else if (NewKeyValue.LengthInChars == 0) {
-            EnvDiffOutputDifference(&BaseKey, &BaseValue, NULL, OutputFormat, EnvDiffChangeRemove);
-            BaseStart = EnvDiffGetNextKeyValueOffset(BaseEnvironment, &BaseKeyValue, BaseStart);
-        } else {
+    //
+    //  Report each variable in the new environment that is not in the base
+    //  environment or has a different value.
+    //
 
-            //
-            //  If both have variables, check to see if one is ahead of the
-            //  other.  Because environment blocks are sorted, if there's
-            //  a difference we know which one has a variable that the other
-            //  does not by lexicographic order.
-            //
-
-            Compare = YoriLibCompareStringIns(&BaseKey, &NewKey);
-            if (Compare < 0) {
-                EnvDiffOutputDifference(&BaseKey, &BaseValue, NULL, OutputFormat, EnvDiffChangeRemove);
-                BaseStart = EnvDiffGetNextKeyValueOffset(BaseEnvironment, &BaseKeyValue, BaseStart);
-            } else if (Compare > 0) {
-                EnvDiffOutputDifference(&NewKey, NULL, &NewValue, OutputFormat, EnvDiffChangeAdd);
-                NewStart = EnvDiffGetNextKeyValueOffset(NewEnvironment, &NewKeyValue, NewStart);
-            } else {
-
-                //
-                //  If the value is the same, nothing has happened.
-                //  Otherwise, indicate the modification.
-                //
-
-                if (YoriLibCompareString(&BaseValue, &NewValue) != 0) {
-                    EnvDiffOutputDifference(&NewKey, &BaseValue, &NewValue, OutputFormat, EnvDiffChangeModify);
-                }
-                BaseStart = EnvDiffGetNextKeyValueOffset(BaseEnvironment, &BaseKeyValue, BaseStart);
-                NewStart = EnvDiffGetNextKeyValueOffset(NewEnvironment, &NewKeyValue, NewStart);
+    Offset = 0;
+    while (EnvDiffGetNextVariable(NewEnvironment, &Offset, &Key, &Value)) {
+        HashEntry = YoriLibHashLookupByKey(BaseVariables, &Key);
+        if (HashEntry == NULL) {
+            EnvDiffOutputDifference(&Key, NULL, &Value, OutputFormat, EnvDiffChangeAdd);
+        } else {
+            Entry = HashEntry->Context;
+            Entry->Retained = TRUE;
+            if (YoriLibCompareString(&Entry->Value, &Value) != 0) {
+                EnvDiffOutputDifference(&Key, &Entry->Value, &Value, OutputFormat, EnvDiffChangeModify);
             }
         }
     }
 
-    return FALSE;
+    //
+    //  Anything in the base environment that was not found in the new
+    //  environment has been removed.
+    //
+
+    for (Index = 0; Index < VarCount; Index++) {
+        Entry = &Entries[Index];
+        if (!Entry->Retained) {
+            EnvDiffOutputDifference(&Entry->HashEntry.Key, &Entry->Value, NULL, OutputFormat, EnvDiffChangeRemove);
+        }
+    }
+
+    for (Index = 0; Index < VarCount; Index++) {
+        YoriLibHashRemoveByEntry(&Entries[Index].HashEntry);
+    }
+    YoriLibFreeEmptyHashTable(BaseVariables);
+    YoriLibFree(Entries);
+
+    return TRUE;
 }
 
 /**
@@ -609,10 +690,16 @@ ENTRYPOINT(
     }
 
     if (Result == EXIT_SUCCESS) {
+        BOOLEAN Compared;
         if (Reverse) {
-            EnvDiffCompareEnvironments(&CurrentEnvironment, &BaseEnvironment, EnvDiffOutputCmdBatch);
+            Compared = EnvDiffCompareEnvironments(&CurrentEnvironment, &BaseEnvironment, EnvDiffOutputCmdBatch);
         } else {
-            EnvDiffCompareEnvironments(&BaseEnvironment, &CurrentEnvironment, EnvDiffOutputCmdBatch);
+            Compared = EnvDiffCompareEnvironments(&BaseEnvironment, &CurrentEnvironment, EnvDiffOutputCmdBatch);
+        }
+
+        if (!Compared) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("envdiff: out of memory\n"));
+            Result = EXIT_FAILURE;
         }
     }
 
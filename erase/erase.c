@@ -35,10 +35,11 @@ CHAR strEraseHelpText[] =
         "\n"
         "Delete one or more files.\n"
         "\n"
-        "ERASE [-license] [-b] [-p | -r] [-s] <file> [<file>...]\n"
+        "ERASE [-license] [-b] [-j n] [-p | -r] [-s] <file> [<file>...]\n"
         "\n"
         "   --             Treat all further arguments as files to delete\n"
         "   -b             Use basic search criteria for files only\n"
+        "   -j             Delete up to n files at the same time\n"
         "   -p             Delete files with POSIX semantics\n"
         "   -r             Send files to the recycle bin\n"
         "   -s             Erase all files matching the pattern in all subdirectories\n";
@@ -57,58 +58,29 @@ EraseHelp(VOID)
     return TRUE;
 }
 
+/**
+ The maximum number of files that can be deleted at the same time.
+ */
+#define ERASE_MAX_WORKERS (64)
+
 /**
  A structure passed to each file found.
  */
 typedef struct _ERASE_CONTEXT {
 
     /**
-     TRUE if files should be deleted with POSIX semantics.
-     */
-    BOOLEAN PosixSemantics;
-
-    /**
-     TRUE if files should be sent to the recycle bin.
+     The state used to delete files, which deletes them on worker threads
+     if requested.
      */
-    BOOLEAN RecycleBin;
+    PYORILIB_DELETE_CONTEXT DeleteContext;
 
     /**
      The number of files found.
      */
     DWORDLONG FilesFound;
 
-    /**
-     The number of files successfully marked for delete.
-     */
-    DWORDLONG FilesMarkedForDelete;
-
 } ERASE_CONTEXT, *PERASE_CONTEXT;
 
-/**
- Delete a file via DeleteFile or via the POSIX delete API depending on which
- command line arguments were specified.
-
- @param EraseContext Pointer to the context indicating which delete mode to
-        use.
-
- @param FileName Pointer to the file name to delete.
-
- @return TRUE to indicate the file was marked for delete successfully, or
-         FALSE to indicate failure.
- */
-BOOL
-EraseDeleteFile(
-    __in PERASE_CONTEXT EraseContext,
-    __in PYORI_STRING FileName
-    )
-{
-    if (!EraseContext->PosixSemantics) {
-        return DeleteFile(FileName->StartOfString);
-    }
-
-    return YoriLibPosixDeleteFile(FileName);
-}
-
 /**
  A callback that is invoked when a file is found that matches a search criteria
  specified in the set of strings to enumerate.
@@ -132,70 +104,20 @@ EraseFileFoundCallback(
     __in PVOID Context
     )
 {
-    DWORD Err;
-    LPTSTR ErrText;
-    BOOLEAN FileDeleted;
     PERASE_CONTEXT EraseContext = (PERASE_CONTEXT)Context;
 
     UNREFERENCED_PARAMETER(Depth);
 
     ASSERT(YoriLibIsStringNullTerminated(FilePath));
 
-    FileDeleted = FALSE;
-    if ((FileInfo->dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == 0) {
+    //
+    //  Directories are not deleted, so no file is within a directory being
+    //  deleted, and files can be deleted in any order.
+    //
 
+    if ((FileInfo->dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == 0) {
         EraseContext->FilesFound++;
-
-        //
-        //  If the user wanted it deleted via the recycle bin, try that.
-        //
-
-        if (EraseContext->RecycleBin) {
-            if (YoriLibRecycleBinFile(FilePath)) {
-                FileDeleted = TRUE;
-            }
-        }
-
-        //
-        //  If the user didn't ask for recycle bin or if that failed, delete
-        //  directly.
-        //
-
-        if (!FileDeleted && !EraseDeleteFile(EraseContext, FilePath)) {
-            Err = GetLastError();
-            if (Err == ERROR_ACCESS_DENIED) {
-                DWORD OldAttributes = GetFileAttributes(FilePath->StartOfString);
-                DWORD NewAttributes = OldAttributes & ~(FILE_ATTRIBUTE_READONLY | FILE_ATTRIBUTE_HIDDEN | FILE_ATTRIBUTE_SYSTEM);
-
-                if (OldAttributes != NewAttributes) {
-                    SetFileAttributes(FilePath->StartOfString, NewAttributes);
-
-                    Err = NO_ERROR;
-
-                    if (!EraseDeleteFile(EraseContext, FilePath)) {
-                        Err = GetLastError();
-                    } else {
-                        FileDeleted = TRUE;
-                    }
-
-                    if (Err != NO_ERROR) {
-                        SetFileAttributes(FilePath->StartOfString, OldAttributes);
-                    }
-                }
-            }
-
-            if (Err != NO_ERROR) {
-                ErrText = YoriLibGetWinErrorText(Err);
-                YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("erase: delete of %y failed: %s"), FilePath, ErrText);
-                YoriLibFreeWinErrorText(ErrText);
-            }
-        } else {
-            FileDeleted = TRUE;
-        }
-
-        if (FileDeleted) {
-            EraseContext->FilesMarkedForDelete++;
-        }
+        YoriLibDeleteObject(EraseContext->DeleteContext, FilePath, FileInfo->dwFileAttributes, 0);
     }
     return TRUE;
 }
@@ -291,8 +213,15 @@ ENTRYPOINT(
     YORI_ALLOC_SIZE_T i;
     ERASE_CONTEXT Context;
     YORI_STRING Arg;
+    YORI_MAX_SIGNED_T Temp;
+    YORI_ALLOC_SIZE_T CharsConsumed;
+    DWORD DeleteFlags;
+    DWORD WorkerCount;
+    DWORDLONG FilesMarkedForDelete;
 
     ZeroMemory(&Context, sizeof(Context));
+    DeleteFlags = 0;
+    WorkerCount = 1;
     Recursive = FALSE;
     BasicEnumeration = FALSE;
 
@@ -312,11 +241,26 @@ ENTRYPOINT(
             } else if (YoriLibCompareStringLitIns(&Arg, _T("b")) == 0) {
                 BasicEnumeration = TRUE;
                 ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("j")) == 0) {
+                if (i + 1 < ArgC) {
+                    if (YoriLibStringToNumber(&ArgV[i + 1], TRUE, &Temp, &CharsConsumed) &&
+                        CharsConsumed > 0) {
+
+                        if (Temp < 1) {
+                            Temp = 1;
+                        } else if (Temp > ERASE_MAX_WORKERS) {
+                            Temp = ERASE_MAX_WORKERS;
+                        }
+                        WorkerCount = (DWORD)Temp;
+                        ArgumentUnderstood = TRUE;
+                        i++;
+                    }
+                }
             } else if (YoriLibCompareStringLitIns(&Arg, _T("p")) == 0) {
-                Context.PosixSemantics = TRUE;
+                DeleteFlags |= YORILIB_DELETE_POSIX_SEMANTICS;
                 ArgumentUnderstood = TRUE;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("r")) == 0) {
-                Context.RecycleBin = TRUE;
+                DeleteFlags |= YORILIB_DELETE_RECYCLE_BIN;
                 ArgumentUnderstood = TRUE;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("s")) == 0) {
                 Recursive = TRUE;
@@ -343,7 +287,7 @@ ENTRYPOINT(
         return EXIT_FAILURE;
     }
 
-    if (Context.PosixSemantics &&
+    if ((DeleteFlags & YORILIB_DELETE_POSIX_SEMANTICS) &&
         DllKernel32.pSetFileInformationByHandle == NULL) {
 
         YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("erase: OS support not present\n"));
@@ -361,9 +305,22 @@ ENTRYPOINT(
 
     YoriLibEnableBackupPrivilege();
 
+    Context.DeleteContext = YoriLibDeleteCreateContext(_T("erase"), DeleteFlags, WorkerCount);
+    if (Context.DeleteContext == NULL) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("erase: could not create worker threads\n"));
+        return EXIT_FAILURE;
+    }
+
     MatchFlags = YORILIB_FILEENUM_RETURN_FILES | YORILIB_FILEENUM_DIRECTORY_CONTENTS;
     if (Recursive) {
         MatchFlags |= YORILIB_FILEENUM_RECURSE_BEFORE_RETURN | YORILIB_FILEENUM_RECURSE_PRESERVE_WILD;
+
+        //
+        //  Files can be deleted in any order, so find them in parallel.
+        //  Callbacks are still serialized, as the delete context requires.
+        //
+
+        MatchFlags |= YORILIB_FILEENUM_PARALLEL;
     }
     if (BasicEnumeration) {
         MatchFlags |= YORILIB_FILEENUM_BASIC_EXPANSION;
@@ -379,12 +336,14 @@ ENTRYPOINT(
                              &Context);
     }
 
+    YoriLibDeleteFreeContext(Context.DeleteContext, &FilesMarkedForDelete, NULL);
+
     if (Context.FilesFound == 0) {
         YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("erase: no matching files found\n"));
-        ASSERT(Context.FilesMarkedForDelete == 0);
+        ASSERT(FilesMarkedForDelete == 0);
     }
 
-    if (Context.FilesMarkedForDelete == 0) {
+    if (FilesMarkedForDelete == 0) {
         return EXIT_FAILURE;
     }
 
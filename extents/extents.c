@@ -35,14 +35,42 @@ CHAR strExtentsHelpText[] =
         "\n"
         "Output location of files within a volume or disk and relocate files.\n"
         "\n"
-        "EXTENTS [-license] [-b] [-d] [-h] [-m vcn lcn cnt] [-s] <file>...\n"
+        "EXTENTS [-license] [-b] [-c] [-d] [-f] [-h] [-m vcn lcn cnt] [-s] <file>...\n"
         "\n"
         "   -b             Use basic search criteria for files only\n"
+        "   -c             Move files so each occupies a single contiguous range\n"
         "   -d             Return directories rather than directory contents\n"
+        "   -f             Display a summary of file and free space fragmentation\n"
         "   -h             Display output in hexadecimal\n"
         "   -m vcn lcn cnt Move a range of a file to a new position\n"
         "   -s             Process files from all subdirectories\n";
 
+/**
+ The size of the buffer used to query file extents, in bytes.  This is
+ allocated once and reused for every file.
+ */
+#define EXTENTS_RETRIEVAL_POINTER_SIZE (64 * 1024)
+
+/**
+ The number of bytes of volume bitmap to query at a time.
+ */
+#define EXTENTS_VOLUME_BITMAP_SIZE (64 * 1024)
+
+/**
+ The maximum number of clusters to move in a single request when making
+ files contiguous.  The file system holds locks for the duration of each
+ request, so this keeps each request reasonably short.
+ */
+#define EXTENTS_DEFRAGMENT_MAX_MOVE (0x10000)
+
+/**
+ The number of entries in the histogram of fragments per file.  The first
+ entries describe files with zero, one and two fragments, and each later
+ entry describes files with up to twice as many fragments as the entry
+ before it.  The final entry includes all files with more fragments.
+ */
+#define EXTENTS_FRAGMENT_BUCKETS (10)
+
 /**
  Context passed to the callback which is invoked for each file found.
  */
@@ -81,13 +109,92 @@ typedef struct _EXTENTS_CONTEXT {
      */
     LONGLONG FilesFoundThisArg;
 
+    /**
+     A buffer used to query file extents, reused for every file.
+     */
+    PRETRIEVAL_POINTERS_BUFFER RetrievalPointers;
+
+    /**
+     The name of the volume whose information is described below.  This is
+     used to avoid querying volume information again for each file on the
+     same volume.
+     */
+    YORI_STRING VolumeName;
+
+    /**
+     A handle to the volume described by VolumeName, or NULL if no volume
+     has been opened.
+     */
+    HANDLE VolumeHandle;
+
+    /**
+     The number of bytes per cluster on the volume.
+     */
+    DWORD BytesPerCluster;
+
+    /**
+     The offset of cluster zero from the start of the volume, in bytes.
+     */
+    DWORDLONG RetrievalPointerBase;
+
+    /**
+     The location of the volume on its disk or disks.
+     */
+    YORI_VOLUME_DISK_EXTENTS VolumeDiskExtents;
+
+    /**
+     The number of files found with each number of fragments.  See
+     EXTENTS_FRAGMENT_BUCKETS.
+     */
+    LONGLONG FragmentHistogram[EXTENTS_FRAGMENT_BUCKETS];
+
+    /**
+     The total number of fragments found in all files.
+     */
+    LONGLONG TotalFragments;
+
+    /**
+     When making files contiguous, the cluster on the current volume to
+     start searching for free space.  Each file is placed after the
+     previous one, so the moves proceed in ascending order across the
+     volume.
+     */
+    YORI_MAX_UNSIGNED_T DefragmentLcn;
+
     /**
      Output offsets in hex rather than decimal.
      */
     BOOLEAN DisplayHex;
 
+    /**
+     If TRUE, move files so that each occupies a single contiguous range.
+     */
+    BOOLEAN Defragment;
+
+    /**
+     If TRUE, summarize fragmentation rather than displaying the extents of
+     each file.
+     */
+    BOOLEAN FragmentReport;
+
 } EXTENTS_CONTEXT, *PEXTENTS_CONTEXT;
 
+/**
+ Descriptions of the number of fragments counted in each histogram entry.
+ */
+CONST LPTSTR ExtentsFragmentBucketNames[EXTENTS_FRAGMENT_BUCKETS] = {
+    _T("0"),
+    _T("1"),
+    _T("2"),
+    _T("3-4"),
+    _T("5-8"),
+    _T("9-16"),
+    _T("17-32"),
+    _T("33-64"),
+    _T("65-128"),
+    _T("129+")
+};
+
 /**
  Display usage text to the user.
  */
@@ -135,18 +242,13 @@ ExtentsDisplayExtents(
 {
     STARTING_VCN_INPUT_BUFFER StartingVcn;
     PRETRIEVAL_POINTERS_BUFFER RetrievalPointers;
-    YORI_ALLOC_SIZE_T RetrievalPointerSize;
     BOOLEAN MoreToGo;
     DWORD Index;
     DWORD BytesReturned;
     DWORD Error;
     LPTSTR ErrText;
 
-    RetrievalPointerSize = 4096;
-    RetrievalPointers = YoriLibMalloc(RetrievalPointerSize);
-    if (RetrievalPointers == NULL) {
-        return FALSE;
-    }
+    RetrievalPointers = ExtentsContext->RetrievalPointers;
 
     YoriLibLiAssignUnsigned(&StartingVcn.StartingVcn, 0);
 
@@ -159,7 +261,7 @@ ExtentsDisplayExtents(
                              &StartingVcn,
                              sizeof(StartingVcn),
                              RetrievalPointers,
-                             RetrievalPointerSize,
+                             EXTENTS_RETRIEVAL_POINTER_SIZE,
                              &BytesReturned,
                              NULL)) {
 
@@ -283,87 +385,531 @@ ExtentsDisplayExtents(
         }
     }
 
-    YoriLibFree(RetrievalPointers);
     return TRUE;
 }
 
 /**
- Move a range of a file to the specified target extents.
+ Count the number of fragments in a single file.  A fragment is a run of
+ allocated clusters that does not immediately follow the previous allocated
+ run on the volume.
 
  @param ExtentsContext Pointer to the application context.
 
- @param FilePath Specifies the full path of the file to move.
+ @param FilePath Specifies the full path to the file.
 
- @param VolumeHandle Specifies a handle to the volume that hosts the file.
+ @param FileHandle Specifies the handle to the file whose fragments should
+        be counted.
 
- @param FileHandle Specifies a handle to the file to move.
+ @param Fragments On successful completion, populated with the number of
+        fragments in the file.
+
+ @param AllocatedClusters On successful completion, populated with the
+        number of clusters allocated to the file.
+
+ @param HasHoles On successful completion, set to TRUE if any range of the
+        file has no clusters allocated, as occurs with sparse or compressed
+        files.
 
  @return TRUE to indicate success, FALSE to indicate failure.
  */
+__success(return)
 BOOLEAN
-ExtentsMoveFile(
+ExtentsQueryFragments(
     __in PEXTENTS_CONTEXT ExtentsContext,
     __in PYORI_STRING FilePath,
-    __in HANDLE VolumeHandle,
-    __in HANDLE FileHandle
+    __in HANDLE FileHandle,
+    __out PYORI_MAX_UNSIGNED_T Fragments,
+    __out PYORI_MAX_UNSIGNED_T AllocatedClusters,
+    __out PBOOLEAN HasHoles
     )
 {
-    MOVE_FILE_DATA MoveData;
+    STARTING_VCN_INPUT_BUFFER StartingVcn;
+    PRETRIEVAL_POINTERS_BUFFER RetrievalPointers;
+    BOOLEAN MoreToGo;
+    DWORD Index;
     DWORD BytesReturned;
     DWORD Error;
     LPTSTR ErrText;
+    YORI_MAX_SIGNED_T CurrentVcn;
+    YORI_MAX_UNSIGNED_T RunLength;
+    YORI_MAX_UNSIGNED_T Lcn;
+    YORI_MAX_UNSIGNED_T NextLcn;
 
-    MoveData.FileHandle = FileHandle;
-    MoveData.StartingVcn.QuadPart = ExtentsContext->StartingVcn;
-    MoveData.StartingLcn.QuadPart = ExtentsContext->StartingLcn;
-    MoveData.ClusterCount = ExtentsContext->ClusterCount;
+    RetrievalPointers = ExtentsContext->RetrievalPointers;
+    YoriLibLiAssignUnsigned(&StartingVcn.StartingVcn, 0);
+    NextLcn = INVALID_LCN;
+    *Fragments = 0;
+    *AllocatedClusters = 0;
+    *HasHoles = FALSE;
 
-    Error = ERROR_SUCCESS;
-    if (!DeviceIoControl(VolumeHandle,
-                         FSCTL_MOVE_FILE,
-                         &MoveData,
-                         sizeof(MoveData),
-                         NULL,
-                         0,
+    MoreToGo = TRUE;
+    while (MoreToGo) {
+        MoreToGo = FALSE;
+        if (!DeviceIoControl(FileHandle,
+                             FSCTL_GET_RETRIEVAL_POINTERS,
+                             &StartingVcn,
+                             sizeof(StartingVcn),
+                             RetrievalPointers,
+                             EXTENTS_RETRIEVAL_POINTER_SIZE,
+                             &BytesReturned,
+                             NULL)) {
+
+            Error = GetLastError();
+            if (Error == ERROR_HANDLE_EOF) {
+                break;
+            } else if (Error != ERROR_MORE_DATA) {
+                ErrText = YoriLibGetWinErrorText(Error);
+                YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("extents: get retrieval pointers of %y failed: %s"), FilePath, ErrText);
+                YoriLibFreeWinErrorText(ErrText);
+                return FALSE;
+            }
+            MoreToGo = TRUE;
+        }
+
+        CurrentVcn = RetrievalPointers->StartingVcn.QuadPart;
+        for (Index = 0; Index < RetrievalPointers->ExtentCount; Index++) {
+            Lcn = RetrievalPointers->Extents[Index].Lcn.QuadPart;
+            RunLength = RetrievalPointers->Extents[Index].NextVcn.QuadPart - CurrentVcn;
+            if (Lcn != INVALID_LCN) {
+                if (Lcn != NextLcn) {
+                    (*Fragments)++;
+                }
+                NextLcn = Lcn + RunLength;
+                *AllocatedClusters = *AllocatedClusters + RunLength;
+            } else {
+                *HasHoles = TRUE;
+            }
+            CurrentVcn = RetrievalPointers->Extents[Index].NextVcn.QuadPart;
+        }
+
+        if (MoreToGo) {
+            if (CurrentVcn <= StartingVcn.StartingVcn.QuadPart) {
+                break;
+            }
+            StartingVcn.StartingVcn.QuadPart = CurrentVcn;
+        }
+    }
+
+    return TRUE;
+}
+
+/**
+ Count the number of fragments in a single file and record it in the
+ fragmentation histogram.
+
+ @param ExtentsContext Pointer to the application context.
+
+ @param FilePath Specifies the full path to the file.
+
+ @param FileHandle Specifies the handle to the file whose fragments should
+        be counted.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOLEAN
+ExtentsCountFragments(
+    __in PEXTENTS_CONTEXT ExtentsContext,
+    __in PYORI_STRING FilePath,
+    __in HANDLE FileHandle
+    )
+{
+    YORI_MAX_UNSIGNED_T Fragments;
+    YORI_MAX_UNSIGNED_T AllocatedClusters;
+    YORI_MAX_UNSIGNED_T BucketLimit;
+    BOOLEAN HasHoles;
+    DWORD Bucket;
+
+    if (!ExtentsQueryFragments(ExtentsContext, FilePath, FileHandle, &Fragments, &AllocatedClusters, &HasHoles)) {
+        return FALSE;
+    }
+
+    if (Fragments <= 2) {
+        Bucket = (DWORD)Fragments;
+    } else {
+        Bucket = 2;
+        BucketLimit = 2;
+        while (Fragments > BucketLimit && Bucket < EXTENTS_FRAGMENT_BUCKETS - 1) {
+            BucketLimit = BucketLimit * 2;
+            Bucket++;
+        }
+    }
+
+    ExtentsContext->FragmentHistogram[Bucket]++;
+    ExtentsContext->TotalFragments = ExtentsContext->TotalFragments + Fragments;
+    return TRUE;
+}
+
+/**
+ Display the number of files with each number of fragments, collected by
+ @ref ExtentsCountFragments .
+
+ @param ExtentsContext Pointer to the application context.
+ */
+VOID
+ExtentsDisplayFragmentHistogram(
+    __in PEXTENTS_CONTEXT ExtentsContext
+    )
+{
+    DWORD Bucket;
+    LONGLONG Files;
+    LONGLONG Average;
+
+    Files = 0;
+    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("Fragments | Files\n"));
+    for (Bucket = 0; Bucket < EXTENTS_FRAGMENT_BUCKETS; Bucket++) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%9s | %lli\n"), ExtentsFragmentBucketNames[Bucket], ExtentsContext->FragmentHistogram[Bucket]);
+        Files = Files + ExtentsContext->FragmentHistogram[Bucket];
+    }
+
+    Average = 0;
+    if (Files > 0) {
+        Average = ExtentsContext->TotalFragments * 100 / Files;
+    }
+
+    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT,
+                  _T("%lli files, %lli fragments, %lli.%02lli fragments per file\n"),
+                  Files,
+                  ExtentsContext->TotalFragments,
+                  Average / 100,
+                  Average % 100);
+}
+
+/**
+ Query a portion of the allocation bitmap of the volume currently described
+ by the application context.
+
+ @param ExtentsContext Pointer to the application context.
+
+ @param StartingLcn The first cluster to describe.
+
+ @param Bitmap Pointer to a buffer to populate, which must be at least
+        EXTENTS_VOLUME_BITMAP_SIZE bytes beyond the header.
+
+ @param FirstLcn On successful completion, populated with the first cluster
+        described by the bitmap.  This can be earlier than StartingLcn.
+
+ @param ClusterCount On successful completion, populated with the number of
+        clusters described by the bitmap.
+
+ @param MoreToGo On successful completion, set to TRUE if the volume
+        contains clusters beyond those described by the bitmap.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+ExtentsQueryVolumeBitmap(
+    __in PEXTENTS_CONTEXT ExtentsContext,
+    __in YORI_MAX_UNSIGNED_T StartingLcn,
+    __out PVOLUME_BITMAP_BUFFER Bitmap,
+    __out PYORI_MAX_UNSIGNED_T FirstLcn,
+    __out PYORI_MAX_UNSIGNED_T ClusterCount,
+    __out PBOOLEAN MoreToGo
+    )
+{
+    STARTING_LCN_INPUT_BUFFER StartingLcnBuffer;
+    DWORD BytesReturned;
+    DWORD Error;
+    LPTSTR ErrText;
+
+    *MoreToGo = FALSE;
+    StartingLcnBuffer.StartingLcn.QuadPart = StartingLcn;
+    if (!DeviceIoControl(ExtentsContext->VolumeHandle,
+                         FSCTL_GET_VOLUME_BITMAP,
+                         &StartingLcnBuffer,
+                         sizeof(StartingLcnBuffer),
+                         Bitmap,
+                         FIELD_OFFSET(VOLUME_BITMAP_BUFFER, Buffer) + EXTENTS_VOLUME_BITMAP_SIZE,
                          &BytesReturned,
                          NULL)) {
 
         Error = GetLastError();
-        ErrText = YoriLibGetWinErrorText(Error);
-        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("extents: move extent 0x%llx of %y to 0x%llx failed: %s"), ExtentsContext->StartingVcn, FilePath, ExtentsContext->StartingLcn, ErrText);
-        YoriLibFreeWinErrorText(ErrText);
+        if (Error != ERROR_MORE_DATA) {
+            ErrText = YoriLibGetWinErrorText(Error);
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("extents: query free space of %y failed: %s"), &ExtentsContext->VolumeName, ErrText);
+            YoriLibFreeWinErrorText(ErrText);
+            return FALSE;
+        }
+        *MoreToGo = TRUE;
+    }
+
+    *FirstLcn = Bitmap->StartingLcn.QuadPart;
+    *ClusterCount = 0;
+    if (BytesReturned > FIELD_OFFSET(VOLUME_BITMAP_BUFFER, Buffer)) {
+        *ClusterCount = (BytesReturned - FIELD_OFFSET(VOLUME_BITMAP_BUFFER, Buffer)) * 8;
+        if (*ClusterCount > (YORI_MAX_UNSIGNED_T)Bitmap->BitmapSize.QuadPart) {
+            *ClusterCount = Bitmap->BitmapSize.QuadPart;
+        }
+    }
+
+    if (*ClusterCount == 0) {
+        *MoreToGo = FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ Display the fragmentation of free space on the volume currently described
+ by the application context.
+
+ @param ExtentsContext Pointer to the application context.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOLEAN
+ExtentsDisplayFreeSpace(
+    __in PEXTENTS_CONTEXT ExtentsContext
+    )
+{
+    PVOLUME_BITMAP_BUFFER Bitmap;
+    BOOLEAN MoreToGo;
+    BYTE BitmapByte;
+    YORI_MAX_UNSIGNED_T FirstLcn;
+    YORI_MAX_UNSIGNED_T ClusterCount;
+    YORI_MAX_UNSIGNED_T Index;
+    YORI_MAX_UNSIGNED_T RunLength;
+    YORI_MAX_UNSIGNED_T LargestRun;
+    YORI_MAX_UNSIGNED_T FreeClusters;
+    YORI_MAX_UNSIGNED_T FreeExtents;
+    LARGE_INTEGER Size;
+    YORI_STRING FreeString;
+    YORI_STRING LargestString;
+    TCHAR FreeBuffer[10];
+    TCHAR LargestBuffer[10];
+
+    Bitmap = YoriLibMalloc(FIELD_OFFSET(VOLUME_BITMAP_BUFFER, Buffer) + EXTENTS_VOLUME_BITMAP_SIZE);
+    if (Bitmap == NULL) {
+        return FALSE;
+    }
+
+    FirstLcn = 0;
+    ClusterCount = 0;
+    RunLength = 0;
+    LargestRun = 0;
+    FreeClusters = 0;
+    FreeExtents = 0;
+
+    MoreToGo = TRUE;
+    while (MoreToGo) {
+        if (!ExtentsQueryVolumeBitmap(ExtentsContext, FirstLcn + ClusterCount, Bitmap, &FirstLcn, &ClusterCount, &MoreToGo)) {
+            YoriLibFree(Bitmap);
+            return FALSE;
+        }
+
+        //
+        //  Walk the bitmap, handling a byte at a time where all of its
+        //  clusters are in the same state.
+        //
+
+        Index = 0;
+        while (Index < ClusterCount) {
+            if ((Index % 8) == 0 && Index + 8 <= ClusterCount) {
+                BitmapByte = Bitmap->Buffer[Index / 8];
+                if (BitmapByte == 0) {
+                    RunLength = RunLength + 8;
+                    Index = Index + 8;
+                    continue;
+                } else if (BitmapByte == 0xFF) {
+                    if (RunLength > 0) {
+                        FreeExtents++;
+                        FreeClusters = FreeClusters + RunLength;
+                        if (RunLength > LargestRun) {
+                            LargestRun = RunLength;
+                        }
+                        RunLength = 0;
+                    }
+                    Index = Index + 8;
+                    continue;
+                }
+            }
+
+            if (Bitmap->Buffer[Index / 8] & (1 << (Index % 8))) {
+                if (RunLength > 0) {
+                    FreeExtents++;
+                    FreeClusters = FreeClusters + RunLength;
+                    if (RunLength > LargestRun) {
+                        LargestRun = RunLength;
+                    }
+                    RunLength = 0;
+                }
+            } else {
+                RunLength++;
+            }
+            Index++;
+        }
     }
 
+    if (RunLength > 0) {
+        FreeExtents++;
+        FreeClusters = FreeClusters + RunLength;
+        if (RunLength > LargestRun) {
+            LargestRun = RunLength;
+        }
+    }
+
+    YoriLibFree(Bitmap);
+
+    YoriLibInitEmptyString(&FreeString);
+    FreeString.StartOfString = FreeBuffer;
+    FreeString.LengthAllocated = sizeof(FreeBuffer)/sizeof(FreeBuffer[0]);
+    Size.QuadPart = FreeClusters * ExtentsContext->BytesPerCluster;
+    YoriLibFileSizeToString(&FreeString, &Size);
+
+    YoriLibInitEmptyString(&LargestString);
+    LargestString.StartOfString = LargestBuffer;
+    LargestString.LengthAllocated = sizeof(LargestBuffer)/sizeof(LargestBuffer[0]);
+    Size.QuadPart = LargestRun * ExtentsContext->BytesPerCluster;
+    YoriLibFileSizeToString(&LargestString, &Size);
+
+    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT,
+                  _T("%y: %y free in %lli extents, largest free extent %y\n"),
+                  &ExtentsContext->VolumeName,
+                  &FreeString,
+                  FreeExtents,
+                  &LargestString);
+
     return TRUE;
 }
 
 /**
- A callback that is invoked when a file is found that matches a search criteria
- specified in the set of strings to enumerate.
-
- @param FilePath Pointer to the file path that was found.
+ Find a range of free clusters on the volume currently described by the
+ application context.
+
+ @param ExtentsContext Pointer to the application context.
+
+ @param Bitmap Pointer to a buffer to use when querying the volume bitmap,
+        which must be at least EXTENTS_VOLUME_BITMAP_SIZE bytes beyond the
+        header.
+
+ @param StartingLcn The first cluster to consider.
+
+ @param ClusterCount The number of contiguous free clusters required.
+
+ @param FoundLcn On successful completion, populated with the first cluster
+        of the lowest free range at or after StartingLcn that is large
+        enough.
+
+ @return TRUE to indicate a range was found, FALSE if no range was found.
+ */
+__success(return)
+BOOLEAN
+ExtentsFindFreeRange(
+    __in PEXTENTS_CONTEXT ExtentsContext,
+    __in PVOLUME_BITMAP_BUFFER Bitmap,
+    __in YORI_MAX_UNSIGNED_T StartingLcn,
+    __in YORI_MAX_UNSIGNED_T ClusterCount,
+    __out PYORI_MAX_UNSIGNED_T FoundLcn
+    )
+{
+    BOOLEAN MoreToGo;
+    YORI_MAX_UNSIGNED_T FirstLcn;
+    YORI_MAX_UNSIGNED_T BitmapClusters;
+    YORI_MAX_UNSIGNED_T Index;
+    YORI_MAX_UNSIGNED_T RunStart;
+    YORI_MAX_UNSIGNED_T RunLength;
+
+    FirstLcn = StartingLcn;
+    BitmapClusters = 0;
+    RunStart = 0;
+    RunLength = 0;
+
+    MoreToGo = TRUE;
+    while (MoreToGo) {
+        if (!ExtentsQueryVolumeBitmap(ExtentsContext, FirstLcn + BitmapClusters, Bitmap, &FirstLcn, &BitmapClusters, &MoreToGo)) {
+            return FALSE;
+        }
+
+        Index = 0;
+        if (FirstLcn < StartingLcn) {
+            Index = StartingLcn - FirstLcn;
+        }
+
+        while (Index < BitmapClusters) {
+
+            //
+            //  Skip over fully allocated bytes and accumulate fully free
+            //  bytes without checking each bit.
+            //
+
+            if ((Index % 8) == 0 && Index + 8 <= BitmapClusters) {
+                if (Bitmap->Buffer[Index / 8] == 0xFF) {
+                    RunLength = 0;
+                    Index = Index + 8;
+                    continue;
+                } else if (Bitmap->Buffer[Index / 8] == 0) {
+                    if (RunLength == 0) {
+                        RunStart = FirstLcn + Index;
+                    }
+                    RunLength = RunLength + 8;
+                    Index = Index + 8;
+                    if (RunLength >= ClusterCount) {
+                        *FoundLcn = RunStart;
+                        return TRUE;
+                    }
+                    continue;
+                }
+            }
+
+            if (Bitmap->Buffer[Index / 8] & (1 << (Index % 8))) {
+                RunLength = 0;
+            } else {
+                if (RunLength == 0) {
+                    RunStart = FirstLcn + Index;
+                }
+                RunLength++;
+                if (RunLength >= ClusterCount) {
+                    *FoundLcn = RunStart;
+                    return TRUE;
+                }
+            }
+            Index++;
+        }
+    }
+
+    return FALSE;
+}
+
+/**
+ Close the volume currently described by the application context.  If a
+ fragmentation report is being generated, the free space fragmentation of
+ the volume is displayed first.
+
+ @param ExtentsContext Pointer to the application context.
+ */
+VOID
+ExtentsCloseVolume(
+    __in PEXTENTS_CONTEXT ExtentsContext
+    )
+{
+    if (ExtentsContext->VolumeHandle != NULL) {
+        if (ExtentsContext->FragmentReport) {
+            ExtentsDisplayFreeSpace(ExtentsContext);
+        }
+        CloseHandle(ExtentsContext->VolumeHandle);
+        ExtentsContext->VolumeHandle = NULL;
+    }
+    YoriLibFreeStringContents(&ExtentsContext->VolumeName);
+}
+
+/**
+ Open the volume hosting a file and query the information about it needed
+ to display extents.  If the file is on the same volume as the previous
+ file, the information queried previously is reused.
 
- @param FileInfo Information about the file.
-
- @param Depth Specifies recursion depth.  Ignored in this application.
+ @param ExtentsContext Pointer to the application context.
 
- @param Context Pointer to the extents context structure indicating the
-        action to perform and populated with the file and line count found.
+ @param FilePath Specifies the full path to the file.
 
- @return TRUE to continute enumerating, FALSE to abort.
+ @return TRUE to indicate success, FALSE to indicate failure.
  */
-BOOL
-ExtentsFileFoundCallback(
-    __in PYORI_STRING FilePath,
-    __in_opt PWIN32_FIND_DATA FileInfo,
-    __in DWORD Depth,
-    __in PVOID Context
+BOOLEAN
+ExtentsOpenVolume(
+    __in PEXTENTS_CONTEXT ExtentsContext,
+    __in PYORI_STRING FilePath
     )
 {
     YORI_STRING VolRootName;
-    PEXTENTS_CONTEXT ExtentsContext;
-    HANDLE VolumeHandle;
-    HANDLE FileHandle;
     DWORD BytesReturned;
     DWORD Error;
     LPTSTR ErrText;
@@ -371,16 +917,9 @@ ExtentsFileFoundCallback(
     DWORD SectorSize;
     DWORD FreeClusters;
     DWORD TotalClusters;
-    DWORD BytesPerCluster;
     DWORD DesiredAccess;
     DWORDLONG RetrievalPointerBase;
-    YORI_VOLUME_DISK_EXTENTS VolumeDiskExtents;
-
-    UNREFERENCED_PARAMETER(FileInfo);
-    UNREFERENCED_PARAMETER(Depth);
-    ASSERT(YoriLibIsStringNullTerminated(FilePath));
-
-    ExtentsContext = (PEXTENTS_CONTEXT)Context;
+    HANDLE VolumeHandle;
 
     //
     //  Find the volume hosting this file.
@@ -389,7 +928,7 @@ ExtentsFileFoundCallback(
     YoriLibInitEmptyString(&VolRootName);
     if (!YoriLibGetVolumePathName(FilePath, &VolRootName)) {
         YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("extents: failed to find volume for file %y\n"), FilePath);
-        goto End;
+        return FALSE;
     }
 
     //
@@ -406,6 +945,21 @@ ExtentsFileFoundCallback(
         VolRootName.LengthInChars++;
     }
 
+    //
+    //  If this is the volume that is already open, there's nothing to do.
+    //  The cached name does not have a trailing backslash.
+    //
+
+    if (ExtentsContext->VolumeHandle != NULL &&
+        VolRootName.LengthInChars == ExtentsContext->VolumeName.LengthInChars + 1 &&
+        YoriLibCompareStringInsCnt(&VolRootName, &ExtentsContext->VolumeName, ExtentsContext->VolumeName.LengthInChars) == 0) {
+
+        YoriLibFreeStringContents(&VolRootName);
+        return TRUE;
+    }
+
+    ExtentsCloseVolume(ExtentsContext);
+
     //
     //  Determine the cluster size for the volume.
     //
@@ -420,11 +974,9 @@ ExtentsFileFoundCallback(
         YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("extents: GetDiskFreeSpace of %y failed: %s\n"), &VolRootName, ErrText);
         YoriLibFreeWinErrorText(ErrText);
         YoriLibFreeStringContents(&VolRootName);
-        goto End;
+        return FALSE;
     }
 
-    BytesPerCluster = SectorsPerCluster * SectorSize;
-
     //
     //  Truncate the trailing backslash so as to open the volume instead of
     //  root directory
@@ -443,7 +995,7 @@ ExtentsFileFoundCallback(
     //  or else it needs an administrative caller.
     //
     DesiredAccess = FILE_READ_ATTRIBUTES | FILE_TRAVERSE;
-    if (ExtentsContext->ClusterCount != 0) {
+    if (ExtentsContext->ClusterCount != 0 || ExtentsContext->Defragment) {
         DesiredAccess = FILE_READ_ATTRIBUTES | FILE_READ_DATA | FILE_WRITE_DATA;
     }
 
@@ -460,7 +1012,7 @@ ExtentsFileFoundCallback(
         YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("extents: open of %y failed: %s\n"), &VolRootName, ErrText);
         YoriLibFreeWinErrorText(ErrText);
         YoriLibFreeStringContents(&VolRootName);
-        goto End;
+        return FALSE;
     }
 
     //
@@ -497,19 +1049,300 @@ ExtentsFileFoundCallback(
     //  program can handle.
     //
 
-    VolumeDiskExtents.NumberOfDiskExtents = 0;
+    ExtentsContext->VolumeDiskExtents.NumberOfDiskExtents = 0;
     if (!DeviceIoControl(VolumeHandle,
                          IOCTL_VOLUME_GET_VOLUME_DISK_EXTENTS,
                          NULL,
                          0,
-                         &VolumeDiskExtents,
-                         sizeof(VolumeDiskExtents),
+                         &ExtentsContext->VolumeDiskExtents,
+                         sizeof(ExtentsContext->VolumeDiskExtents),
+                         &BytesReturned,
+                         NULL)) {
+
+        ExtentsContext->VolumeDiskExtents.NumberOfDiskExtents = 0;
+    }
+
+    ExtentsContext->VolumeHandle = VolumeHandle;
+    ExtentsContext->BytesPerCluster = SectorsPerCluster * SectorSize;
+    ExtentsContext->RetrievalPointerBase = RetrievalPointerBase;
+    ExtentsContext->DefragmentLcn = 0;
+    memcpy(&ExtentsContext->VolumeName, &VolRootName, sizeof(YORI_STRING));
+    return TRUE;
+}
+
+/**
+ Move a range of a file to the specified location on the volume.
+
+ @param FilePath Specifies the full path of the file to move.
+
+ @param VolumeHandle Specifies a handle to the volume that hosts the file.
+
+ @param FileHandle Specifies a handle to the file to move.
+
+ @param StartingVcn Specifies the offset within the file to move, in
+        clusters.
+
+ @param StartingLcn Specifies the target cluster on the volume.
+
+ @param ClusterCount Specifies the number of clusters to move.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOLEAN
+ExtentsMoveRange(
+    __in PYORI_STRING FilePath,
+    __in HANDLE VolumeHandle,
+    __in HANDLE FileHandle,
+    __in LONGLONG StartingVcn,
+    __in LONGLONG StartingLcn,
+    __in DWORD ClusterCount
+    )
+{
+    MOVE_FILE_DATA MoveData;
+    DWORD BytesReturned;
+    DWORD Error;
+    LPTSTR ErrText;
+
+    MoveData.FileHandle = FileHandle;
+    MoveData.StartingVcn.QuadPart = StartingVcn;
+    MoveData.StartingLcn.QuadPart = StartingLcn;
+    MoveData.ClusterCount = ClusterCount;
+
+    if (!DeviceIoControl(VolumeHandle,
+                         FSCTL_MOVE_FILE,
+                         &MoveData,
+                         sizeof(MoveData),
+                         NULL,
+                         0,
                          &BytesReturned,
                          NULL)) {
 
-        VolumeDiskExtents.NumberOfDiskExtents = 0;
+        Error = GetLastError();
+        ErrText = YoriLibGetWinErrorText(Error);
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("extents: move extent 0x%llx of %y to 0x%llx failed: %s"), StartingVcn, FilePath, StartingLcn, ErrText);
+        YoriLibFreeWinErrorText(ErrText);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ Move a range of a file to the specified target extents.
+
+ @param ExtentsContext Pointer to the application context.
+
+ @param FilePath Specifies the full path of the file to move.
+
+ @param VolumeHandle Specifies a handle to the volume that hosts the file.
+
+ @param FileHandle Specifies a handle to the file to move.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOLEAN
+ExtentsMoveFile(
+    __in PEXTENTS_CONTEXT ExtentsContext,
+    __in PYORI_STRING FilePath,
+    __in HANDLE VolumeHandle,
+    __in HANDLE FileHandle
+    )
+{
+    ExtentsMoveRange(FilePath,
+                     VolumeHandle,
+                     FileHandle,
+                     ExtentsContext->StartingVcn,
+                     ExtentsContext->StartingLcn,
+                     ExtentsContext->ClusterCount);
+
+    return TRUE;
+}
+
+/**
+ Move a file so that it occupies a single contiguous range on the volume.
+ The range is found by searching for free space after the range used by
+ the previous file, so that successive files are written in ascending order
+ across the volume.  The file is moved in ascending order of file offset,
+ so each file is also written sequentially.
+
+ @param ExtentsContext Pointer to the application context.
+
+ @param FilePath Specifies the full path of the file to move.
+
+ @param FileHandle Specifies a handle to the file to move.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOLEAN
+ExtentsDefragmentFile(
+    __in PEXTENTS_CONTEXT ExtentsContext,
+    __in PYORI_STRING FilePath,
+    __in HANDLE FileHandle
+    )
+{
+    STARTING_VCN_INPUT_BUFFER StartingVcn;
+    PRETRIEVAL_POINTERS_BUFFER RetrievalPointers;
+    PVOLUME_BITMAP_BUFFER Bitmap;
+    YORI_MAX_UNSIGNED_T Fragments;
+    YORI_MAX_UNSIGNED_T AllocatedClusters;
+    YORI_MAX_UNSIGNED_T TargetLcn;
+    YORI_MAX_UNSIGNED_T CurrentLcn;
+    YORI_MAX_UNSIGNED_T Lcn;
+    YORI_MAX_SIGNED_T Vcn;
+    YORI_MAX_SIGNED_T ExtentStartVcn;
+    YORI_MAX_SIGNED_T ExtentNextVcn;
+    YORI_MAX_SIGNED_T MoveCount;
+    BOOLEAN HasHoles;
+    BOOLEAN Found;
+    DWORD Index;
+    DWORD BytesReturned;
+    DWORD Error;
+    LPTSTR ErrText;
+
+    if (!ExtentsQueryFragments(ExtentsContext, FilePath, FileHandle, &Fragments, &AllocatedClusters, &HasHoles)) {
+        return FALSE;
+    }
+
+    if (Fragments <= 1) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y: already contiguous\n"), FilePath);
+        return TRUE;
+    }
+
+    if (HasHoles) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y: sparse or compressed, skipped\n"), FilePath);
+        return TRUE;
+    }
+
+    //
+    //  Look for space after the previous file first, and if that fails,
+    //  from the start of the volume.
+    //
+
+    Bitmap = YoriLibMalloc(FIELD_OFFSET(VOLUME_BITMAP_BUFFER, Buffer) + EXTENTS_VOLUME_BITMAP_SIZE);
+    if (Bitmap == NULL) {
+        return FALSE;
+    }
+
+    Found = ExtentsFindFreeRange(ExtentsContext, Bitmap, ExtentsContext->DefragmentLcn, AllocatedClusters, &TargetLcn);
+    if (!Found && ExtentsContext->DefragmentLcn > 0) {
+        Found = ExtentsFindFreeRange(ExtentsContext, Bitmap, 0, AllocatedClusters, &TargetLcn);
+    }
+    YoriLibFree(Bitmap);
+
+    if (!Found) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y: no free range of %lli clusters\n"), FilePath, AllocatedClusters);
+        return TRUE;
+    }
+
+    //
+    //  Since the file has no holes, each cluster's offset within the file
+    //  is its offset from the start of the target range.  Query the
+    //  location of each offset again after each move, since moving changes
+    //  the file's extents.
+    //
+
+    RetrievalPointers = ExtentsContext->RetrievalPointers;
+    Vcn = 0;
+    while ((YORI_MAX_UNSIGNED_T)Vcn < AllocatedClusters) {
+        StartingVcn.StartingVcn.QuadPart = Vcn;
+        if (!DeviceIoControl(FileHandle,
+                             FSCTL_GET_RETRIEVAL_POINTERS,
+                             &StartingVcn,
+                             sizeof(StartingVcn),
+                             RetrievalPointers,
+                             EXTENTS_RETRIEVAL_POINTER_SIZE,
+                             &BytesReturned,
+                             NULL)) {
+
+            Error = GetLastError();
+            if (Error != ERROR_MORE_DATA) {
+                ErrText = YoriLibGetWinErrorText(Error);
+                YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("extents: get retrieval pointers of %y failed: %s"), FilePath, ErrText);
+                YoriLibFreeWinErrorText(ErrText);
+                return FALSE;
+            }
+        }
+
+        //
+        //  The returned extents may start before the requested offset, so
+        //  find the one containing it.
+        //
+
+        CurrentLcn = INVALID_LCN;
+        ExtentNextVcn = Vcn;
+        ExtentStartVcn = RetrievalPointers->StartingVcn.QuadPart;
+        for (Index = 0; Index < RetrievalPointers->ExtentCount; Index++) {
+            ExtentNextVcn = RetrievalPointers->Extents[Index].NextVcn.QuadPart;
+            if (Vcn < ExtentNextVcn) {
+                Lcn = RetrievalPointers->Extents[Index].Lcn.QuadPart;
+                if (Lcn != INVALID_LCN) {
+                    CurrentLcn = Lcn + (Vcn - ExtentStartVcn);
+                }
+                break;
+            }
+            ExtentStartVcn = ExtentNextVcn;
+        }
+
+        if (ExtentNextVcn <= Vcn) {
+            break;
+        }
+
+        MoveCount = ExtentNextVcn - Vcn;
+        if (MoveCount > EXTENTS_DEFRAGMENT_MAX_MOVE) {
+            MoveCount = EXTENTS_DEFRAGMENT_MAX_MOVE;
+        }
+
+        if (CurrentLcn != INVALID_LCN && CurrentLcn != TargetLcn + Vcn) {
+            if (!ExtentsMoveRange(FilePath, ExtentsContext->VolumeHandle, FileHandle, Vcn, TargetLcn + Vcn, (DWORD)MoveCount)) {
+                return FALSE;
+            }
+        }
+
+        Vcn = Vcn + MoveCount;
     }
 
+    ExtentsContext->DefragmentLcn = TargetLcn + AllocatedClusters;
+    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y: %lli fragments moved to cluster %lli\n"), FilePath, Fragments, TargetLcn);
+    return TRUE;
+}
+
+/**
+ A callback that is invoked when a file is found that matches a search criteria
+ specified in the set of strings to enumerate.
+
+ @param FilePath Pointer to the file path that was found.
+
+ @param FileInfo Information about the file.
+
+ @param Depth Specifies recursion depth.  Ignored in this application.
+
+ @param Context Pointer to the extents context structure indicating the
+        action to perform and populated with the file and line count found.
+
+ @return TRUE to continute enumerating, FALSE to abort.
+ */
+BOOL
+ExtentsFileFoundCallback(
+    __in PYORI_STRING FilePath,
+    __in_opt PWIN32_FIND_DATA FileInfo,
+    __in DWORD Depth,
+    __in PVOID Context
+    )
+{
+    PEXTENTS_CONTEXT ExtentsContext;
+    HANDLE FileHandle;
+    DWORD Error;
+    LPTSTR ErrText;
+
+    UNREFERENCED_PARAMETER(FileInfo);
+    UNREFERENCED_PARAMETER(Depth);
+    ASSERT(YoriLibIsStringNullTerminated(FilePath));
+
+    ExtentsContext = (PEXTENTS_CONTEXT)Context;
+
+    if (!ExtentsOpenVolume(ExtentsContext, FilePath)) {
+        goto End;
+    }
 
     //
     //  Open the file and start querying its extents.
@@ -528,28 +1361,27 @@ ExtentsFileFoundCallback(
         ErrText = YoriLibGetWinErrorText(Error);
         YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("extents: open of %y failed: %s"), FilePath, ErrText);
         YoriLibFreeWinErrorText(ErrText);
-        YoriLibFreeStringContents(&VolRootName);
-        CloseHandle(VolumeHandle);
         return TRUE;
     }
 
-    if (ExtentsContext->ClusterCount == 0) {
+    if (ExtentsContext->FragmentReport) {
+        ExtentsCountFragments(ExtentsContext, FilePath, FileHandle);
+    } else if (ExtentsContext->Defragment) {
+        ExtentsDefragmentFile(ExtentsContext, FilePath, FileHandle);
+    } else if (ExtentsContext->ClusterCount == 0) {
         ExtentsDisplayExtents(ExtentsContext,
                               FilePath,
                               FileHandle,
-                              BytesPerCluster,
-                              RetrievalPointerBase,
-                              &VolumeDiskExtents);
+                              ExtentsContext->BytesPerCluster,
+                              ExtentsContext->RetrievalPointerBase,
+                              &ExtentsContext->VolumeDiskExtents);
     } else if (ExtentsContext->FilesFound == 0) {
-        ExtentsMoveFile(ExtentsContext, FilePath, VolumeHandle, FileHandle);
+        ExtentsMoveFile(ExtentsContext, FilePath, ExtentsContext->VolumeHandle, FileHandle);
     } else {
         YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("extents: cannot move multiple files to the same LCN"));
     }
 
-
     CloseHandle(FileHandle);
-    CloseHandle(VolumeHandle);
-    YoriLibFreeStringContents(&VolRootName);
 
 End:
 
@@ -613,9 +1445,15 @@ ENTRYPOINT(
             } else if (YoriLibCompareStringLitIns(&Arg, _T("b")) == 0) {
                 BasicEnumeration = TRUE;
                 ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("c")) == 0) {
+                ExtentsContext.Defragment = TRUE;
+                ArgumentUnderstood = TRUE;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("d")) == 0) {
                 ReturnDirectories = TRUE;
                 ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("f")) == 0) {
+                ExtentsContext.FragmentReport = TRUE;
+                ArgumentUnderstood = TRUE;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("h")) == 0) {
                 ExtentsContext.DisplayHex = TRUE;
                 ArgumentUnderstood = TRUE;
@@ -684,38 +1522,50 @@ ENTRYPOINT(
     if (StartArg == 0 || StartArg == ArgC) {
         YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("extents: missing argument\n"));
         return EXIT_FAILURE;
-    } else {
-        MatchFlags = YORILIB_FILEENUM_RETURN_FILES;
+    }
 
-        if (ReturnDirectories) {
-            MatchFlags |= YORILIB_FILEENUM_RETURN_DIRECTORIES;
-        } else {
-            MatchFlags |= YORILIB_FILEENUM_DIRECTORY_CONTENTS;
-        }
+    ExtentsContext.RetrievalPointers = YoriLibMalloc(EXTENTS_RETRIEVAL_POINTER_SIZE);
+    if (ExtentsContext.RetrievalPointers == NULL) {
+        return EXIT_FAILURE;
+    }
 
-        if (Recursive) {
-            MatchFlags |= YORILIB_FILEENUM_RECURSE_BEFORE_RETURN | YORILIB_FILEENUM_RECURSE_PRESERVE_WILD;
-        }
+    MatchFlags = YORILIB_FILEENUM_RETURN_FILES;
 
-        if (BasicEnumeration) {
-            MatchFlags |= YORILIB_FILEENUM_BASIC_EXPANSION;
-        }
+    if (ReturnDirectories) {
+        MatchFlags |= YORILIB_FILEENUM_RETURN_DIRECTORIES;
+    } else {
+        MatchFlags |= YORILIB_FILEENUM_DIRECTORY_CONTENTS;
+    }
 
-        for (i = StartArg; i < ArgC; i++) {
+    if (Recursive) {
+        MatchFlags |= YORILIB_FILEENUM_RECURSE_BEFORE_RETURN | YORILIB_FILEENUM_RECURSE_PRESERVE_WILD;
+    }
 
-            ExtentsContext.FilesFoundThisArg = 0;
-            YoriLibForEachStream(&ArgV[i], MatchFlags, 0, ExtentsFileFoundCallback, NULL, &ExtentsContext);
-            if (ExtentsContext.FilesFoundThisArg == 0) {
-                YORI_STRING FullPath;
-                YoriLibInitEmptyString(&FullPath);
-                if (YoriLibUserStringToSingleFilePath(&ArgV[i], TRUE, &FullPath)) {
-                    ExtentsFileFoundCallback(&FullPath, NULL, 0, &ExtentsContext);
-                    YoriLibFreeStringContents(&FullPath);
-                }
+    if (BasicEnumeration) {
+        MatchFlags |= YORILIB_FILEENUM_BASIC_EXPANSION;
+    }
+
+    for (i = StartArg; i < ArgC; i++) {
+
+        ExtentsContext.FilesFoundThisArg = 0;
+        YoriLibForEachStream(&ArgV[i], MatchFlags, 0, ExtentsFileFoundCallback, NULL, &ExtentsContext);
+        if (ExtentsContext.FilesFoundThisArg == 0) {
+            YORI_STRING FullPath;
+            YoriLibInitEmptyString(&FullPath);
+            if (YoriLibUserStringToSingleFilePath(&ArgV[i], TRUE, &FullPath)) {
+                ExtentsFileFoundCallback(&FullPath, NULL, 0, &ExtentsContext);
+                YoriLibFreeStringContents(&FullPath);
             }
         }
     }
 
+    if (ExtentsContext.FragmentReport && ExtentsContext.FilesFound > 0) {
+        ExtentsDisplayFragmentHistogram(&ExtentsContext);
+    }
+
+    ExtentsCloseVolume(&ExtentsContext);
+    YoriLibFree(ExtentsContext.RetrievalPointers);
+
     if (ExtentsContext.FilesFound == 0) {
         YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("extents: no matching files found\n"));
         return EXIT_FAILURE;
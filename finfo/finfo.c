@@ -27,6 +27,12 @@
 #include <yoripch.h>
 #include <yorilib.h>
 
+/**
+ The number of characters of output to collect before writing them when
+ output is not to a console.
+ */
+#define FINFO_OUTPUT_BLOCK_SIZE (64 * 1024)
+
 /**
  Help text to display to the user.
  */
@@ -78,6 +84,38 @@ typedef struct _FINFO_CONTEXT {
      */
     LONGLONG FilesFoundThisArg;
 
+    /**
+     An array of functions to collect the information referenced by the
+     format string.
+     */
+    YORI_LIB_FILE_FILT_COLLECT_FN * CollectFns;
+
+    /**
+     The number of elements in the CollectFns array.
+     */
+    YORI_ALLOC_SIZE_T CollectFnCount;
+
+    /**
+     If any information referenced by the format string requires opening
+     files, points to a pool of threads collecting it while enumeration
+     continues.  NULL if information is collected synchronously.
+     */
+    PYORILIB_FILE_INFO_QUEUE CollectQueue;
+
+    /**
+     When output is not to a console, a buffer of output for files which
+     has not yet been written.  When output is to a console, this is not
+     allocated and each file is written as it is displayed.
+     */
+    YORI_STRING OutputBlock;
+
+    /**
+     TRUE while the format string is being scanned to determine the
+     collection functions it requires.  When TRUE, variables are recorded
+     rather than expanded.
+     */
+    BOOLEAN ScanningFormat;
+
 } FINFO_CONTEXT, *PFINFO_CONTEXT;
 
 /**
@@ -1374,7 +1412,9 @@ FInfoHelp(VOID)
 
 /**
  Expand any variables in the format string of information to display for each
- file.
+ file.  The information for the file must already have been collected.  If
+ the format string is being scanned, the collection function for the variable
+ is recorded and nothing is expanded.
 
  @param OutputString The buffer to populate with the result of variable
         expansion.
@@ -1395,13 +1435,25 @@ FInfoExpandVariables(
     )
 {
     YORI_ALLOC_SIZE_T Index;
+    YORI_ALLOC_SIZE_T CollectIndex;
     YORI_ALLOC_SIZE_T CharsNeeded = 0;
     PFINFO_CONTEXT FInfoContext = (PFINFO_CONTEXT)Context;
 
     for (Index = 0; Index < sizeof(FInfoKnownVariables)/sizeof(FInfoKnownVariables[0]); Index++) {
         if (YoriLibCompareStringLit(VariableName, FInfoKnownVariables[Index].VariableName) == 0) {
-            FInfoKnownVariables[Index].CollectFn(&FInfoContext->Entry, FInfoContext->FileInfo, FInfoContext->FilePath);
-            CharsNeeded = FInfoKnownVariables[Index].OutputFn(FInfoContext, OutputString);
+            if (FInfoContext->ScanningFormat) {
+                for (CollectIndex = 0; CollectIndex < FInfoContext->CollectFnCount; CollectIndex++) {
+                    if (FInfoContext->CollectFns[CollectIndex] == FInfoKnownVariables[Index].CollectFn) {
+                        break;
+                    }
+                }
+                if (CollectIndex == FInfoContext->CollectFnCount) {
+                    FInfoContext->CollectFns[FInfoContext->CollectFnCount] = FInfoKnownVariables[Index].CollectFn;
+                    FInfoContext->CollectFnCount++;
+                }
+            } else {
+                CharsNeeded = FInfoKnownVariables[Index].OutputFn(FInfoContext, OutputString);
+            }
             break;
         }
     }
@@ -1409,6 +1461,154 @@ FInfoExpandVariables(
     return CharsNeeded;
 }
 
+/**
+ Write any output that has been collected but not yet written.
+
+ @param FInfoContext Pointer to the finfo context structure containing the
+        output to write.
+ */
+VOID
+FInfoFlushOutput(
+    __in PFINFO_CONTEXT FInfoContext
+    )
+{
+    if (FInfoContext->OutputBlock.LengthInChars > 0) {
+        YoriLibOutputString(GetStdHandle(STD_OUTPUT_HANDLE), 0, &FInfoContext->OutputBlock);
+        FInfoContext->OutputBlock.LengthInChars = 0;
+    }
+}
+
+/**
+ Display the collected information for a file according to the format
+ string.
+
+ @param FInfoContext Pointer to the finfo context structure, where Entry
+        contains the collected information for the file.
+ */
+VOID
+FInfoDisplayEntry(
+    __in PFINFO_CONTEXT FInfoContext
+    )
+{
+    YORI_STRING DisplayString;
+
+    FInfoContext->FilesFound++;
+
+    YoriLibInitEmptyString(&DisplayString);
+    YoriLibExpandCommandVariables(&FInfoContext->FormatString, '$', TRUE, FInfoExpandVariables, FInfoContext, &DisplayString);
+    if (DisplayString.StartOfString != NULL) {
+        PYORI_STRING Block;
+        YORI_ALLOC_SIZE_T CharsNeeded;
+
+        //
+        //  If output is being collected, append to it, writing previous
+        //  output first if there's no space.  Output that is larger than
+        //  the buffer is written directly.
+        //
+
+        Block = &FInfoContext->OutputBlock;
+        CharsNeeded = DisplayString.LengthInChars;
+        if (FInfoContext->FilesFound > 1) {
+            CharsNeeded++;
+        }
+
+        if (Block->LengthAllocated > 0 &&
+            Block->LengthInChars + CharsNeeded > Block->LengthAllocated) {
+
+            FInfoFlushOutput(FInfoContext);
+        }
+
+        if (CharsNeeded <= Block->LengthAllocated) {
+            if (FInfoContext->FilesFound > 1) {
+                Block->StartOfString[Block->LengthInChars] = '\n';
+                Block->LengthInChars++;
+            }
+            memcpy(&Block->StartOfString[Block->LengthInChars], DisplayString.StartOfString, DisplayString.LengthInChars * sizeof(TCHAR));
+            Block->LengthInChars = Block->LengthInChars + DisplayString.LengthInChars;
+        } else if (FInfoContext->FilesFound > 1) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("\n%y"), &DisplayString);
+        } else {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y"), &DisplayString);
+        }
+        YoriLibFreeStringContents(&DisplayString);
+    }
+}
+
+/**
+ A callback invoked when information about a file submitted to the
+ collection queue has been collected.  This is invoked on the enumerating
+ thread, in the order that files were found.
+
+ @param Entry Pointer to the collected information about the file.
+
+ @param FindData Pointer to the directory information for the file.
+
+ @param FullPath Pointer to the full path to the file.
+
+ @param Context Pointer to the finfo context structure.
+ */
+VOID
+FInfoQueuedEntryCollected(
+    __in PYORI_FILE_INFO Entry,
+    __in PWIN32_FIND_DATA FindData,
+    __in PYORI_STRING FullPath,
+    __in PVOID Context
+    )
+{
+    PFINFO_CONTEXT FInfoContext;
+
+    FInfoContext = (PFINFO_CONTEXT)Context;
+
+    memcpy(&FInfoContext->Entry, Entry, sizeof(YORI_FILE_INFO));
+    FInfoContext->FilePath = FullPath;
+    FInfoContext->FileInfo = FindData;
+    FInfoDisplayEntry(FInfoContext);
+}
+
+/**
+ Determine the information that the format string refers to, so that it can
+ be collected for each file before the format string is expanded.  If any of
+ this information requires opening files, attempt to collect it on a pool of
+ threads.
+
+ @param FInfoContext Pointer to the finfo context structure, which contains
+        the format string and is populated with the collection functions to
+        invoke.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+FInfoPrepareCollection(
+    __inout PFINFO_CONTEXT FInfoContext
+    )
+{
+    YORI_STRING DisplayString;
+    YORI_ALLOC_SIZE_T MaxCollectFns;
+
+    //
+    //  Each known variable has one collection function and repeats are
+    //  ignored when recording them, so there can be no more collection
+    //  functions than known variables.
+    //
+
+    MaxCollectFns = (YORI_ALLOC_SIZE_T)(sizeof(FInfoKnownVariables)/sizeof(FInfoKnownVariables[0]));
+    FInfoContext->CollectFns = YoriLibMalloc((YORI_ALLOC_SIZE_T)(MaxCollectFns * sizeof(YORI_LIB_FILE_FILT_COLLECT_FN)));
+    if (FInfoContext->CollectFns == NULL) {
+        return FALSE;
+    }
+
+    FInfoContext->CollectFnCount = 0;
+    FInfoContext->ScanningFormat = TRUE;
+    YoriLibInitEmptyString(&DisplayString);
+    YoriLibExpandCommandVariables(&FInfoContext->FormatString, '$', TRUE, FInfoExpandVariables, FInfoContext, &DisplayString);
+    YoriLibFreeStringContents(&DisplayString);
+    FInfoContext->ScanningFormat = FALSE;
+
+    FInfoContext->CollectQueue = YoriLibFileInfoQueueCreate(FInfoContext->CollectFns, FInfoContext->CollectFnCount, FInfoQueuedEntryCollected, FInfoContext);
+    return TRUE;
+}
+
 /**
  A callback that is invoked when a file is found that matches a search criteria
  specified in the set of strings to enumerate.
@@ -1432,7 +1632,6 @@ FInfoFileFoundCallback(
     __in PVOID Context
     )
 {
-    YORI_STRING DisplayString;
     WIN32_FIND_DATA LocalFileInfo;
     PWIN32_FIND_DATA FileInfoToUse;
     PFINFO_CONTEXT FInfoContext;
@@ -1450,22 +1649,26 @@ FInfoFileFoundCallback(
         FileInfoToUse = &LocalFileInfo;
     }
 
-    FInfoContext->FilePath = FilePath;
-    FInfoContext->FileInfo = FileInfoToUse;
-    FInfoContext->FilesFound++;
     FInfoContext->FilesFoundThisArg++;
 
-    YoriLibInitEmptyString(&DisplayString);
-    YoriLibExpandCommandVariables(&FInfoContext->FormatString, '$', TRUE, FInfoExpandVariables, FInfoContext, &DisplayString);
-    if (DisplayString.StartOfString != NULL) {
-        if (FInfoContext->FilesFound > 1) {
-            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("\n%y"), &DisplayString);
-        } else {
-            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y"), &DisplayString);
+    if (FInfoContext->CollectQueue != NULL) {
+        if (YoriLibFileInfoQueueSubmit(FInfoContext->CollectQueue, FileInfoToUse, NULL, FilePath)) {
+            return TRUE;
         }
-        YoriLibFreeStringContents(&DisplayString);
+
+        //
+        //  If the file can't be queued, display it here, after any files
+        //  found before it.
+        //
+
+        YoriLibFileInfoQueueFlush(FInfoContext->CollectQueue);
     }
 
+    YoriLibCollectFileInfoSet(&FInfoContext->Entry, FileInfoToUse, NULL, FilePath, FInfoContext->CollectFns, FInfoContext->CollectFnCount);
+    FInfoContext->FilePath = FilePath;
+    FInfoContext->FileInfo = FileInfoToUse;
+    FInfoDisplayEntry(FInfoContext);
+
     return TRUE;
 }
 
@@ -1592,6 +1795,34 @@ ENTRYPOINT(
         YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("finfo: missing argument\n"));
         return EXIT_FAILURE;
     } else {
+        if (!FInfoPrepareCollection(&FInfoContext)) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("finfo: out of memory\n"));
+            return EXIT_FAILURE;
+        }
+
+        //
+        //  When output is not to a console, collect the output for many
+        //  files and write it together.  If the buffer can't be allocated,
+        //  each file is written as it is displayed.
+        //
+
+        {
+            DWORD ConsoleMode;
+            if (!GetConsoleMode(GetStdHandle(STD_OUTPUT_HANDLE), &ConsoleMode)) {
+                YoriLibAllocateString(&FInfoContext.OutputBlock, FINFO_OUTPUT_BLOCK_SIZE);
+            }
+        }
+
+#if !YORI_BUILTIN
+        //
+        //  Executable headers and version resources are parsed together, so
+        //  remember each parse for the remaining fields of the same file.
+        //  The shell enables this cache for builtin commands.
+        //
+
+        YoriLibPeMetadataCacheEnable();
+#endif
+
         MatchFlags = YORILIB_FILEENUM_RETURN_FILES;
 
         if (ReturnDirectories) {
@@ -1612,15 +1843,31 @@ ENTRYPOINT(
 
             FInfoContext.FilesFoundThisArg = 0;
             YoriLibForEachFile(&ArgV[i], MatchFlags, 0, FInfoFileFoundCallback, NULL, &FInfoContext);
+            if (FInfoContext.CollectQueue != NULL) {
+                YoriLibFileInfoQueueFlush(FInfoContext.CollectQueue);
+            }
             if (FInfoContext.FilesFoundThisArg == 0) {
                 YORI_STRING FullPath;
                 YoriLibInitEmptyString(&FullPath);
                 if (YoriLibUserStringToSingleFilePath(&ArgV[i], TRUE, &FullPath)) {
                     FInfoFileFoundCallback(&FullPath, NULL, 0, &FInfoContext);
+                    if (FInfoContext.CollectQueue != NULL) {
+                        YoriLibFileInfoQueueFlush(FInfoContext.CollectQueue);
+                    }
                     YoriLibFreeStringContents(&FullPath);
                 }
             }
+            FInfoFlushOutput(&FInfoContext);
         }
+
+        if (FInfoContext.CollectQueue != NULL) {
+            YoriLibFileInfoQueueDestroy(FInfoContext.CollectQueue);
+        }
+        YoriLibFree(FInfoContext.CollectFns);
+        YoriLibFreeStringContents(&FInfoContext.OutputBlock);
+#if !YORI_BUILTIN
+        YoriLibPeMetadataCacheCleanup();
+#endif
     }
 
     if (FInfoContext.FilesFound == 0) {
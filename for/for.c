@@ -38,16 +38,20 @@ const
 CHAR strForHelpText[] =
         "Enumerates through a list of strings or files.\n"
         "\n"
-        "FOR [-license] [-b] [-c] [-d] [-i <criteria>] [-l] [-p n] [-r]\n"
-        "    <var> in (<list>) do <cmd>\n"
+        "FOR [-license] [-b] [-c] [-d] [-i <criteria>] [-k] [-l] [-p n] [-r] [-s]\n"
+        "    [-w] <var> in (<list>) do <cmd>\n"
         "\n"
         "   -b             Use basic search criteria for files only\n"
         "   -c             Use cmd as a subshell rather than Yori\n"
         "   -d             Match directories rather than files\n"
         "   -i <criteria>  Only treat match files if they meet criteria, see below\n"
+        "   -k             Display the output of each command in order, implies -w\n"
         "   -l             Use (start,step,end) notation for the list\n"
         "   -p <n>         Execute with <n> concurrent processes\n"
         "   -r             Look for matches in subdirectories under the current directory\n"
+        "   -s             Display progress and estimated time remaining, implies -w\n"
+        "   -w             Execute commands in long-lived worker shells, one for each\n"
+        "                  concurrent process, rather than a new shell for each match\n"
         "\n"
         " The -i option will match files only if they meet criteria.  This is a\n"
         " semicolon delimited list of entries matching the following form:\n"
@@ -75,6 +79,96 @@ ForHelp(VOID)
     return TRUE;
 }
 
+/**
+ The maximum number of bytes of output that a worker shell can return in a
+ single packet.
+ */
+#define FOR_MAX_OUTPUT_CHUNK (1024 * 1024)
+
+/**
+ The number of 100ns units between updates of the progress display.
+ */
+#define FOR_PROGRESS_INTERVAL (10 * 1000 * 1000)
+
+/**
+ A string of spaces used to erase the progress display.
+ */
+#define FOR_PROGRESS_BLANK _T("                                                                              ")
+
+/**
+ Output from a command executed in a worker shell which is being retained so
+ that it can be displayed in order.  The output data follows this structure.
+ */
+typedef struct _FOR_OUTPUT_CHUNK {
+
+    /**
+     The list of output chunks for a single job.
+     */
+    YORI_LIST_ENTRY ListEntry;
+
+    /**
+     The type of the output, either YORI_LIBSH_SERVER_RESPONSE_STDOUT or
+     YORI_LIBSH_SERVER_RESPONSE_STDERR.
+     */
+    DWORD Type;
+
+    /**
+     The number of bytes of output data.
+     */
+    DWORD Length;
+} FOR_OUTPUT_CHUNK, *PFOR_OUTPUT_CHUNK;
+
+/**
+ A single command to execute in a worker shell.
+ */
+typedef struct _FOR_JOB {
+
+    /**
+     The work queue item for this job.
+     */
+    YORILIB_WORK_ITEM WorkItem;
+
+    /**
+     The command to execute.  This is allocated as part of the job.
+     */
+    YORI_STRING CmdLine;
+
+    /**
+     A list of output chunks that have been returned by the command, if
+     output is being displayed in order.
+     */
+    YORI_LIST_ENTRY OutputList;
+
+    /**
+     Set to TRUE if the command was executed by a worker shell.
+     */
+    BOOLEAN Succeeded;
+} FOR_JOB, *PFOR_JOB;
+
+typedef struct _FOR_EXEC_CONTEXT *PFOR_EXEC_CONTEXT;
+
+/**
+ State for a single long-lived shell that executes commands, and the thread
+ feeding commands to it.
+ */
+typedef struct _FOR_WORKER {
+
+    /**
+     Pointer to the exec context that this worker is performing work for.
+     */
+    PFOR_EXEC_CONTEXT ExecContext;
+
+    /**
+     Handle to the shell process.
+     */
+    HANDLE hProcess;
+
+    /**
+     The name of the pipe that the shell accepts commands on.
+     */
+    YORI_STRING PipeName;
+} FOR_WORKER, *PFOR_WORKER;
+
 /**
  State about the currently running processes as well as information required
  to launch any new processes from this program.
@@ -126,7 +220,184 @@ typedef struct _FOR_EXEC_CONTEXT {
      */
     YORI_LIB_FILE_FILTER Filter;
 
-} FOR_EXEC_CONTEXT, *PFOR_EXEC_CONTEXT;
+    /**
+     If TRUE, commands are executed by long-lived worker shells rather than
+     a new process for each match.
+     */
+    BOOLEAN UseWorkers;
+
+    /**
+     If TRUE, the output of each command is retained and displayed in the
+     order that commands were queued.
+     */
+    BOOLEAN KeepOrder;
+
+    /**
+     If TRUE, the number of commands completed and the estimated time
+     remaining is displayed.
+     */
+    BOOLEAN DisplayProgress;
+
+    /**
+     If TRUE, standard error is a console, so the progress display can be
+     updated in place as commands complete.
+     */
+    BOOLEAN ProgressToConsole;
+
+    /**
+     Set to TRUE if the progress display is currently on the console, and
+     should be erased before displaying output.  Protected by Mutex.
+     */
+    BOOLEAN ProgressDisplayed;
+
+    /**
+     Set to TRUE once all matches have been queued as jobs.
+     */
+    BOOLEAN AllJobsQueued;
+
+    /**
+     An array of TargetConcurrentCount workers.
+     */
+    PFOR_WORKER Workers;
+
+    /**
+     A job object containing the worker shells, which terminates them when
+     it is closed.  This is NULL if job objects are not available.
+     */
+    HANDLE hJob;
+
+    /**
+     Describes the processor groups or NUMA nodes that child processes are
+     distributed across.  This is empty if the system has only one.
+     */
+    YORI_LIB_PROCESSOR_PLACEMENT ProcessorPlacement;
+
+    /**
+     A mutex protecting output and progress.
+     */
+    HANDLE Mutex;
+
+    /**
+     A queue of commands to execute on worker threads, each feeding a
+     worker shell.  If output is displayed in order, jobs are returned in
+     the order they were queued.
+     */
+    PYORILIB_WORK_QUEUE WorkQueue;
+
+    /**
+     The total number of jobs that have been queued.
+     */
+    DWORDLONG JobsQueued;
+
+    /**
+     The number of jobs that have been completed and displayed.  Protected
+     by Mutex.
+     */
+    DWORDLONG JobsCompleted;
+
+    /**
+     The system time when the first job was queued.
+     */
+    DWORDLONG StartTime;
+
+    /**
+     The system time when progress was last displayed.
+     */
+    DWORDLONG LastProgressTime;
+
+    /**
+     The current directory to execute commands in.
+     */
+    YORI_STRING CurrentDirectory;
+
+    /**
+     The environment block to execute commands with.
+     */
+    YORI_STRING Environment;
+
+} FOR_EXEC_CONTEXT;
+
+/**
+ The maximum number of matches which can be found by the enumeration thread
+ and not yet executed.  This allows enumeration to continue while commands
+ execute without consuming memory for every match in a large tree.
+ */
+#define FOR_MATCH_QUEUE_DEPTH (1024)
+
+/**
+ A single match found by the enumeration thread which has not yet been
+ executed.
+ */
+typedef struct _FOR_MATCH {
+
+    /**
+     The list of matches waiting to be executed.
+     */
+    YORI_LIST_ENTRY ListEntry;
+
+    /**
+     The match.  This is allocated as part of this structure.
+     */
+    YORI_STRING Match;
+} FOR_MATCH, *PFOR_MATCH;
+
+/**
+ State shared between a thread enumerating files and the thread executing
+ commands for the files that are found.
+ */
+typedef struct _FOR_MATCH_QUEUE {
+
+    /**
+     Pointer to the exec context, which describes the filter to apply to
+     files that are found.
+     */
+    PFOR_EXEC_CONTEXT ExecContext;
+
+    /**
+     The files to enumerate.
+     */
+    PYORI_STRING FileSpec;
+
+    /**
+     Flags to pass to the enumerate.
+     */
+    WORD MatchFlags;
+
+    /**
+     Set to TRUE once enumeration has completed and no more matches will be
+     added.  Protected by Mutex.
+     */
+    BOOLEAN EnumerateComplete;
+
+    /**
+     Set to TRUE if commands are no longer being executed, so enumeration
+     should stop.
+     */
+    BOOLEAN Abandon;
+
+    /**
+     A mutex protecting the list of matches.
+     */
+    HANDLE Mutex;
+
+    /**
+     A semaphore which is signalled once for each match added to the list,
+     and once when enumeration has completed.
+     */
+    HANDLE MatchAvailableSemaphore;
+
+    /**
+     A semaphore which is signalled once for each match that can be added to
+     the list without exceeding FOR_MATCH_QUEUE_DEPTH.
+     */
+    HANDLE SpaceAvailableSemaphore;
+
+    /**
+     A list of matches which have not yet been executed.  Protected by
+     Mutex.
+     */
+    YORI_LIST_ENTRY MatchList;
+} FOR_MATCH_QUEUE, *PFOR_MATCH_QUEUE;
 
 /**
  Wait for any single process to complete.
@@ -458,122 +729,867 @@ ForBreakArgumentsAsNeeded(
                                             &Char);
                     WhiteSpaceInSection = FALSE;
 
-                    //
-                    //  If the next arg is terminated but is already
-                    //  terminating, don't do it twice.
-                    //
+                    //
+                    //  If the next arg is terminated but is already
+                    //  terminating, don't do it twice.
+                    //
+
+                    if (TerminateNextArg && CharsToConsume == Char.LengthInChars) {
+                        TerminateNextArg = FALSE;
+                    }
+
+                    //
+                    //  At this point we need to reallocate the array to add
+                    //  either one or two new args.  The current arg ends at
+                    //  the current offset.  The next arg starts at the
+                    //  current offset.  If TerminateNextArg is TRUE, the
+                    //  next arg is CharsToConsume length and the next next
+                    //  arg starts after that.  We should advance the
+                    //  arg index to the final arg generated here, ensure
+                    //  Char.LengthInChars is zero, and continue.
+                    //
+
+
+                    //
+                    //  MSFIX This should probably use
+                    //  YoriLibShExpandCmdContext now it exists
+                    //
+
+                    if (TerminateNextArg) {
+                        NewArgCount = ArgCount + 2;
+                    } else {
+                        NewArgCount = ArgCount + 1;
+                    }
+
+                    if (!YoriLibShAllocateArgCount(&NewCmd, NewArgCount, 0, NULL)) {
+                        return FALSE;
+                    }
+
+                    for (ExistingArg = 0; ExistingArg <= ArgIndex; ExistingArg++) {
+                        YoriLibShCopyArg(CmdContext, ExistingArg, &NewCmd, ExistingArg);
+                    }
+
+                    NewCmd.ArgV[ArgIndex].LengthInChars = (YORI_ALLOC_SIZE_T)(Char.StartOfString - Arg[ArgIndex].StartOfString);
+                    YoriLibShCheckIfArgNeedsQuotes(&NewCmd, ArgIndex);
+                    YoriLibInitEmptyString(&NewCmd.ArgV[ArgIndex + 1]);
+                    NewCmd.ArgV[ArgIndex + 1].StartOfString = Char.StartOfString;
+
+                    if (TerminateNextArg) {
+                        NewCmd.ArgV[ArgIndex + 1].LengthInChars = CharsToConsume;
+                        YoriLibShCheckIfArgNeedsQuotes(&NewCmd, ArgIndex + 1);
+                        YoriLibInitEmptyString(&NewCmd.ArgV[ArgIndex + 2]);
+                        NewCmd.ArgV[ArgIndex + 2].StartOfString = &Char.StartOfString[CharsToConsume];
+                        NewCmd.ArgV[ArgIndex + 2].LengthInChars = Char.LengthInChars - CharsToConsume;
+                        YoriLibShCheckIfArgNeedsQuotes(&NewCmd, ArgIndex + 2);
+                         for (ExistingArg = ArgIndex + 1; ExistingArg < ArgCount; ExistingArg++) {
+                             YoriLibShCopyArg(CmdContext, ExistingArg, &NewCmd, ExistingArg + 2);
+                         }
+
+                        ArgIndex++;
+
+                    } else {
+                        NewCmd.ArgV[ArgIndex + 1].LengthInChars = Char.LengthInChars;
+                        YoriLibShCheckIfArgNeedsQuotes(&NewCmd, ArgIndex + 1);
+                        for (ExistingArg = ArgIndex + 1; ExistingArg < ArgCount; ExistingArg++) {
+                            YoriLibShCopyArg(CmdContext, ExistingArg, &NewCmd, ExistingArg + 1);
+                        }
+                        InitialArgOffset = CharsToConsume;
+                    }
+
+                    //
+                    //  MSFIX: Need to update Section and Char to refer to
+                    //  their respective locations in the new argument.  Note
+                    //  that the argument index may have changed, and the
+                    //  argument length may have changed.
+                    //
+                    //  The nightmare case is something like:
+                    //  %i>>foo
+                    //
+                    //  Where we want:
+                    //  "My File">>foo
+                    //
+                    //  Meaning that the section is being terminated by the
+                    //  argument seperator but the previous section needs to
+                    //  be resolved.
+                    //
+
+                    WhiteSpaceInSection = FALSE;
+
+                    YoriLibShFreeCmdContext(CmdContext);
+                    CmdContext->ArgC = NewArgCount;
+                    CmdContext->ArgV = NewCmd.ArgV;
+                    CmdContext->ArgContexts = NewCmd.ArgContexts;
+                    CmdContext->MemoryToFreeArgV = NewCmd.MemoryToFreeArgV;
+                    CmdContext->MemoryToFreeArgContexts = NewCmd.MemoryToFreeArgContexts;
+
+                    ArgCount = NewArgCount;
+                    Arg = NewCmd.ArgV;
+
+                    break;
+                }
+            }
+
+            Char.StartOfString++;
+            Char.LengthInChars--;
+        }
+
+        if (WhiteSpaceInSection) {
+            Section.LengthInChars = (YORI_ALLOC_SIZE_T)(Char.StartOfString - Section.StartOfString);
+            ForQuoteSectionIfNeeded(&CmdContext->ArgV[ArgIndex],
+                                    &CmdContext->ArgContexts[ArgIndex],
+                                    &Section,
+                                    WhiteSpaceInSection,
+                                    &Char);
+            WhiteSpaceInSection = FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+/**
+ A counter used to give each pool of worker shells started by this process a
+ unique name.
+ */
+DWORD ForWorkerPoolCount;
+
+/**
+ Write a buffer to a worker shell.
+
+ @param Pipe Handle to the pipe connected to the worker shell.
+
+ @param Buffer Pointer to the data to write.
+
+ @param Length The number of bytes to write.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+ForWorkerWrite(
+    __in HANDLE Pipe,
+    __in_bcount(Length) PVOID Buffer,
+    __in DWORD Length
+    )
+{
+    DWORD BytesWritten;
+
+    if (Length == 0) {
+        return TRUE;
+    }
+
+    if (!WriteFile(Pipe, Buffer, Length, &BytesWritten, NULL) ||
+        BytesWritten != Length) {
+
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ Read a specified number of bytes from a worker shell.
+
+ @param Pipe Handle to the pipe connected to the worker shell.
+
+ @param Buffer Pointer to the buffer to populate.
+
+ @param Length The number of bytes to read.
+
+ @return TRUE if the requested number of bytes were read, FALSE if the
+         worker shell disconnected or an error occurred.
+ */
+__success(return)
+BOOLEAN
+ForWorkerRead(
+    __in HANDLE Pipe,
+    __out_bcount(Length) PVOID Buffer,
+    __in DWORD Length
+    )
+{
+    DWORD BytesRead;
+    DWORD TotalRead;
+
+    TotalRead = 0;
+    while (TotalRead < Length) {
+        if (!ReadFile(Pipe, YoriLibAddToPointer(Buffer, TotalRead), Length - TotalRead, &BytesRead, NULL) ||
+            BytesRead == 0) {
+
+            return FALSE;
+        }
+        TotalRead = TotalRead + BytesRead;
+    }
+
+    return TRUE;
+}
+
+/**
+ Erase the progress display, if it is on the console, so that output can be
+ displayed.  The caller is expected to hold the exec context's Mutex.
+
+ @param ExecContext Pointer to the exec context.
+ */
+VOID
+ForEraseProgress(
+    __in PFOR_EXEC_CONTEXT ExecContext
+    )
+{
+    if (ExecContext->ProgressDisplayed) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("\r%s\r"), FOR_PROGRESS_BLANK);
+        ExecContext->ProgressDisplayed = FALSE;
+    }
+}
+
+/**
+ Display the number of commands that have completed and an estimate of the
+ time remaining.  While commands are executing this is only displayed on a
+ console, and is updated in place periodically.  Once all commands have
+ completed, a summary is displayed.  The caller is expected to hold the
+ exec context's Mutex.
+
+ @param ExecContext Pointer to the exec context.
+
+ @param Final If TRUE, all commands have completed and the summary should be
+        displayed.
+ */
+VOID
+ForDisplayProgress(
+    __in PFOR_EXEC_CONTEXT ExecContext,
+    __in BOOLEAN Final
+    )
+{
+    DWORDLONG Now;
+    DWORDLONG Elapsed;
+    DWORDLONG Remaining;
+
+    if (!ExecContext->DisplayProgress) {
+        return;
+    }
+
+    Now = YoriLibGetSystemTimeAsInteger();
+    if (!Final) {
+        if (!ExecContext->ProgressToConsole ||
+            Now - ExecContext->LastProgressTime < FOR_PROGRESS_INTERVAL) {
+
+            return;
+        }
+    }
+
+    ExecContext->LastProgressTime = Now;
+    Elapsed = (Now - ExecContext->StartTime) / (10 * 1000 * 1000);
+    ForEraseProgress(ExecContext);
+
+    if (Final) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR,
+                      _T("for: %lli commands completed in %02i:%02i:%02i\n"),
+                      ExecContext->JobsCompleted,
+                      (DWORD)(Elapsed / 3600),
+                      (DWORD)((Elapsed / 60) % 60),
+                      (DWORD)(Elapsed % 60));
+        return;
+    }
+
+    //
+    //  The time remaining is only known once all of the matches have been
+    //  found, and is based on the average time of commands completed so far.
+    //
+
+    if (ExecContext->AllJobsQueued && ExecContext->JobsCompleted > 0) {
+        Remaining = Elapsed * (ExecContext->JobsQueued - ExecContext->JobsCompleted) / ExecContext->JobsCompleted;
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR,
+                      _T("for: %lli of %lli complete, %02i:%02i:%02i remaining"),
+                      ExecContext->JobsCompleted,
+                      ExecContext->JobsQueued,
+                      (DWORD)(Remaining / 3600),
+                      (DWORD)((Remaining / 60) % 60),
+                      (DWORD)(Remaining % 60));
+    } else {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR,
+                      _T("for: %lli of %lli complete"),
+                      ExecContext->JobsCompleted,
+                      ExecContext->JobsQueued);
+    }
+    ExecContext->ProgressDisplayed = TRUE;
+}
+
+/**
+ Write output returned from a worker shell to this process' output.  The
+ caller is expected to hold the exec context's Mutex.
+
+ @param ExecContext Pointer to the exec context.
+
+ @param Type The type of the output, either YORI_LIBSH_SERVER_RESPONSE_STDOUT
+        or YORI_LIBSH_SERVER_RESPONSE_STDERR.
+
+ @param Buffer Pointer to the output data.
+
+ @param Length The number of bytes of output data.
+ */
+VOID
+ForWriteOutput(
+    __in PFOR_EXEC_CONTEXT ExecContext,
+    __in DWORD Type,
+    __in_bcount(Length) PVOID Buffer,
+    __in DWORD Length
+    )
+{
+    HANDLE OutputHandle;
+    DWORD BytesWritten;
+
+    ForEraseProgress(ExecContext);
+
+    if (Type == YORI_LIBSH_SERVER_RESPONSE_STDERR) {
+        OutputHandle = GetStdHandle(STD_ERROR_HANDLE);
+    } else {
+        OutputHandle = GetStdHandle(STD_OUTPUT_HANDLE);
+    }
+
+    WriteFile(OutputHandle, Buffer, Length, &BytesWritten, NULL);
+}
+
+/**
+ Connect to a worker shell.  The worker shell may still be starting, or may
+ be between commands, so this waits until the pipe is available or the
+ worker shell terminates.
+
+ @param Worker Pointer to the worker.
+
+ @return Handle to the pipe, or INVALID_HANDLE_VALUE on failure.
+ */
+HANDLE
+ForWorkerConnect(
+    __in PFOR_WORKER Worker
+    )
+{
+    HANDLE Pipe;
+    DWORD Err;
+
+    while (TRUE) {
+        Pipe = CreateFile(Worker->PipeName.StartOfString,
+                          GENERIC_READ | GENERIC_WRITE,
+                          0,
+                          NULL,
+                          OPEN_EXISTING,
+                          FILE_ATTRIBUTE_NORMAL,
+                          NULL);
+
+        if (Pipe != INVALID_HANDLE_VALUE) {
+            return Pipe;
+        }
+
+        Err = GetLastError();
+        if (Err != ERROR_FILE_NOT_FOUND && Err != ERROR_PIPE_BUSY) {
+            return INVALID_HANDLE_VALUE;
+        }
+
+        if (WaitForSingleObject(Worker->hProcess, 10) == WAIT_OBJECT_0) {
+            return INVALID_HANDLE_VALUE;
+        }
+    }
+}
+
+/**
+ Execute a single job in a worker shell, and either display its output or
+ retain it in the job so it can be displayed in order.
+
+ @param Worker Pointer to the worker.
+
+ @param Job Pointer to the job to execute.
+
+ @return TRUE to indicate the command was executed, FALSE if the worker shell
+         could not be contacted or disconnected before the command completed.
+ */
+__success(return)
+BOOLEAN
+ForWorkerExecuteJob(
+    __in PFOR_WORKER Worker,
+    __in PFOR_JOB Job
+    )
+{
+    PFOR_EXEC_CONTEXT ExecContext;
+    YORI_LIBSH_SERVER_REQUEST Request;
+    YORI_LIBSH_SERVER_RESPONSE Response;
+    PFOR_OUTPUT_CHUNK Chunk;
+    DWORD ExitCode;
+    HANDLE Pipe;
+    BOOLEAN Result;
+
+    ExecContext = Worker->ExecContext;
+
+    Pipe = ForWorkerConnect(Worker);
+    if (Pipe == INVALID_HANDLE_VALUE) {
+        return FALSE;
+    }
+
+    Request.Version = YORI_LIBSH_SERVER_VERSION;
+    Request.CurrentDirectoryLength = ExecContext->CurrentDirectory.LengthInChars;
+    Request.EnvironmentLength = ExecContext->Environment.LengthInChars;
+    Request.CommandLength = Job->CmdLine.LengthInChars;
+
+    if (!ForWorkerWrite(Pipe, &Request, sizeof(Request)) ||
+        !ForWorkerWrite(Pipe, ExecContext->CurrentDirectory.StartOfString, ExecContext->CurrentDirectory.LengthInChars * sizeof(TCHAR)) ||
+        !ForWorkerWrite(Pipe, ExecContext->Environment.StartOfString, ExecContext->Environment.LengthInChars * sizeof(TCHAR)) ||
+        !ForWorkerWrite(Pipe, Job->CmdLine.StartOfString, Job->CmdLine.LengthInChars * sizeof(TCHAR))) {
+
+        CloseHandle(Pipe);
+        return FALSE;
+    }
+
+    Result = FALSE;
+    while (ForWorkerRead(Pipe, &Response, sizeof(Response))) {
+        if (Response.Type == YORI_LIBSH_SERVER_RESPONSE_EXIT) {
+            if (Response.Length == sizeof(DWORD) &&
+                ForWorkerRead(Pipe, &ExitCode, sizeof(DWORD))) {
+
+                Result = TRUE;
+            }
+            break;
+        }
+
+        if (Response.Length > FOR_MAX_OUTPUT_CHUNK) {
+            break;
+        }
+
+        Chunk = YoriLibMalloc((YORI_ALLOC_SIZE_T)(sizeof(FOR_OUTPUT_CHUNK) + Response.Length));
+        if (Chunk == NULL) {
+            break;
+        }
+
+        if (!ForWorkerRead(Pipe, Chunk + 1, Response.Length)) {
+            YoriLibFree(Chunk);
+            break;
+        }
+
+        if (ExecContext->KeepOrder) {
+            Chunk->Type = Response.Type;
+            Chunk->Length = Response.Length;
+            YoriLibAppendList(&Job->OutputList, &Chunk->ListEntry);
+        } else {
+            WaitForSingleObject(ExecContext->Mutex, INFINITE);
+            ForWriteOutput(ExecContext, Response.Type, Chunk + 1, Response.Length);
+            ReleaseMutex(ExecContext->Mutex);
+            YoriLibFree(Chunk);
+        }
+    }
+
+    CloseHandle(Pipe);
+    return Result;
+}
+
+/**
+ Execute a command that has been queued by the main thread.  This is
+ invoked on the worker thread feeding a single worker shell.
+
+ @param Context Pointer to the exec context.
+
+ @param WorkerContext Pointer to the worker state for this thread.
+
+ @param Item Pointer to the work queue item within the job to execute.
+
+ @return TRUE to continue executing jobs, or FALSE if the worker shell has
+         terminated, so that other workers execute the remaining jobs.
+ */
+BOOLEAN
+ForExecuteJob(
+    __in PVOID Context,
+    __in PVOID WorkerContext,
+    __in PYORILIB_WORK_ITEM Item
+    )
+{
+    PFOR_WORKER Worker;
+    PFOR_JOB Job;
+
+    UNREFERENCED_PARAMETER(Context);
+
+    Worker = (PFOR_WORKER)WorkerContext;
+    Job = CONTAINING_RECORD(Item, FOR_JOB, WorkItem);
+
+    if (!YoriLibIsOperationCancelled()) {
+        Job->Succeeded = ForWorkerExecuteJob(Worker, Job);
+    }
+
+    if (WaitForSingleObject(Worker->hProcess, 0) == WAIT_OBJECT_0) {
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ Free a job, including any output that it has retained.
+
+ @param Job Pointer to the job to free.
+ */
+VOID
+ForFreeJob(
+    __in PFOR_JOB Job
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PFOR_OUTPUT_CHUNK Chunk;
+
+    ListEntry = YoriLibGetNextListEntry(&Job->OutputList, NULL);
+    while (ListEntry != NULL) {
+        Chunk = CONTAINING_RECORD(ListEntry, FOR_OUTPUT_CHUNK, ListEntry);
+        ListEntry = YoriLibGetNextListEntry(&Job->OutputList, ListEntry);
+        YoriLibRemoveListItem(&Chunk->ListEntry);
+        YoriLibFree(Chunk);
+    }
+
+    YoriLibFree(Job);
+}
+
+/**
+ Display the retained output of a job which has been completed by a worker
+ thread and free it.  This is invoked on the main thread.  If no worker
+ shells remain, jobs are completed without being executed and are reported
+ as failed.
+
+ @param Context Pointer to the exec context.
+
+ @param Item Pointer to the work queue item within the completed job.
+ */
+VOID
+ForCompleteJob(
+    __in PVOID Context,
+    __in PYORILIB_WORK_ITEM Item
+    )
+{
+    PFOR_EXEC_CONTEXT ExecContext;
+    PYORI_LIST_ENTRY ChunkEntry;
+    PFOR_OUTPUT_CHUNK Chunk;
+    PFOR_JOB Job;
+
+    ExecContext = (PFOR_EXEC_CONTEXT)Context;
+    Job = CONTAINING_RECORD(Item, FOR_JOB, WorkItem);
+
+    WaitForSingleObject(ExecContext->Mutex, INFINITE);
+    ExecContext->JobsCompleted++;
+
+    ChunkEntry = YoriLibGetNextListEntry(&Job->OutputList, NULL);
+    while (ChunkEntry != NULL) {
+        Chunk = CONTAINING_RECORD(ChunkEntry, FOR_OUTPUT_CHUNK, ListEntry);
+        ForWriteOutput(ExecContext, Chunk->Type, Chunk + 1, Chunk->Length);
+        ChunkEntry = YoriLibGetNextListEntry(&Job->OutputList, ChunkEntry);
+    }
+
+    if (!Job->Succeeded && !YoriLibIsOperationCancelled()) {
+        ForEraseProgress(ExecContext);
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("for: worker shell did not complete command: %y\n"), &Job->CmdLine);
+    }
+    ReleaseMutex(ExecContext->Mutex);
+
+    ForFreeJob(Job);
+}
+
+/**
+ Remove jobs which have been completed by worker threads, displaying their
+ output if it has been retained so that it is displayed in order, and wait
+ for jobs to complete until no more than a specified number remain
+ outstanding.  Progress is updated periodically while waiting.
+
+ @param ExecContext Pointer to the exec context.
+
+ @param JobsToLeaveOutstanding The number of jobs which may remain incomplete
+        when this function returns.  Zero waits for all jobs to complete.
+ */
+VOID
+ForCompleteJobs(
+    __in PFOR_EXEC_CONTEXT ExecContext,
+    __in DWORD JobsToLeaveOutstanding
+    )
+{
+    DWORD Timeout;
+    BOOLEAN Finished;
+
+    if (ExecContext->WorkQueue == NULL) {
+        return;
+    }
+
+    Timeout = INFINITE;
+    if (ExecContext->DisplayProgress && ExecContext->ProgressToConsole) {
+        Timeout = FOR_PROGRESS_INTERVAL / (10 * 1000);
+    }
+
+    do {
+        Finished = YoriLibWorkQueueComplete(ExecContext->WorkQueue, JobsToLeaveOutstanding, Timeout);
+
+        WaitForSingleObject(ExecContext->Mutex, INFINITE);
+        ForDisplayProgress(ExecContext, FALSE);
+        ReleaseMutex(ExecContext->Mutex);
+    } while (!Finished);
+}
+
+/**
+ Queue a command to be executed by a worker shell.
+
+ @param ExecContext Pointer to the exec context.
+
+ @param CmdLine Pointer to the command to execute.  This is copied into the
+        job.
+ */
+VOID
+ForQueueJob(
+    __in PFOR_EXEC_CONTEXT ExecContext,
+    __in PYORI_STRING CmdLine
+    )
+{
+    PFOR_JOB Job;
+    YORI_MAX_UNSIGNED_T BytesNeeded;
+
+    if (YoriLibIsOperationCancelled()) {
+        return;
+    }
+
+    BytesNeeded = sizeof(FOR_JOB);
+    BytesNeeded += ((YORI_MAX_UNSIGNED_T)CmdLine->LengthInChars + 1) * sizeof(TCHAR);
+
+    if (!YoriLibIsSizeAllocatable(BytesNeeded)) {
+        return;
+    }
+
+    Job = YoriLibMalloc((YORI_ALLOC_SIZE_T)BytesNeeded);
+    if (Job == NULL) {
+        return;
+    }
+
+    YoriLibWorkQueueInitializeItem(&Job->WorkItem);
+    Job->Succeeded = FALSE;
+    YoriLibInitializeListHead(&Job->OutputList);
+
+    YoriLibInitEmptyString(&Job->CmdLine);
+    Job->CmdLine.StartOfString = (LPTSTR)(Job + 1);
+    Job->CmdLine.LengthAllocated = CmdLine->LengthInChars + 1;
+    memcpy(Job->CmdLine.StartOfString, CmdLine->StartOfString, CmdLine->LengthInChars * sizeof(TCHAR));
+    Job->CmdLine.LengthInChars = CmdLine->LengthInChars;
+    Job->CmdLine.StartOfString[Job->CmdLine.LengthInChars] = '\0';
+
+    WaitForSingleObject(ExecContext->Mutex, INFINITE);
+    if (ExecContext->JobsQueued == 0) {
+        ExecContext->StartTime = YoriLibGetSystemTimeAsInteger();
+    }
+    ExecContext->JobsQueued++;
+    ReleaseMutex(ExecContext->Mutex);
+
+    YoriLibWorkQueueSubmit(ExecContext->WorkQueue, &Job->WorkItem);
+
+    //
+    //  Display anything that has completed, and limit the amount of work
+    //  that is queued so output is displayed promptly.  If progress is
+    //  being displayed, everything is queued so that the total is known
+    //  and the time remaining can be estimated.
+    //
+
+    if (ExecContext->DisplayProgress) {
+        ForCompleteJobs(ExecContext, (DWORD)-1);
+    } else {
+        ForCompleteJobs(ExecContext, ExecContext->TargetConcurrentCount * 4);
+    }
+}
+
+/**
+ Start the worker shells and the threads which feed commands to them.
+
+ @param ExecContext Pointer to the exec context.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+ForStartWorkers(
+    __in PFOR_EXEC_CONTEXT ExecContext
+    )
+{
+    YORI_STRING YoriSpec;
+    YORI_STRING CmdLine;
+    YORI_ALLOC_SIZE_T Index;
+    YORI_ALLOC_SIZE_T LengthNeeded;
+    PFOR_WORKER Worker;
+    PROCESS_INFORMATION ProcessInfo;
+    STARTUPINFO StartupInfo;
+    DWORD ConsoleMode;
+    DWORD PoolId;
+    DWORD Flags;
+    DWORD LastError;
+    LPTSTR ErrText;
+
+    ExecContext->ProgressToConsole = (BOOLEAN)GetConsoleMode(GetStdHandle(STD_ERROR_HANDLE), &ConsoleMode);
+
+    ExecContext->Mutex = CreateMutex(NULL, FALSE, NULL);
+    if (ExecContext->Mutex == NULL) {
+        return FALSE;
+    }
+
+    Flags = 0;
+    if (ExecContext->KeepOrder) {
+        Flags = YORILIB_WORK_QUEUE_KEEP_ORDER;
+    }
+
+    ExecContext->WorkQueue = YoriLibWorkQueueCreate(Flags, 1, ForExecuteJob, ForCompleteJob, ExecContext);
+    if (ExecContext->WorkQueue == NULL) {
+        return FALSE;
+    }
+
+    //
+    //  Commands are executed with the environment and current directory of
+    //  this process, which cannot change while commands are executing.
+    //
+
+    if (!YoriLibGetCurrentDirectory(&ExecContext->CurrentDirectory) ||
+        !YoriLibGetEnvironmentStrings(&ExecContext->Environment)) {
 
-                    if (TerminateNextArg && CharsToConsume == Char.LengthInChars) {
-                        TerminateNextArg = FALSE;
-                    }
+        return FALSE;
+    }
 
-                    //
-                    //  At this point we need to reallocate the array to add
-                    //  either one or two new args.  The current arg ends at
-                    //  the current offset.  The next arg starts at the
-                    //  current offset.  If TerminateNextArg is TRUE, the
-                    //  next arg is CharsToConsume length and the next next
-                    //  arg starts after that.  We should advance the
-                    //  arg index to the final arg generated here, ensure
-                    //  Char.LengthInChars is zero, and continue.
-                    //
+    if (ExecContext->CurrentDirectory.LengthInChars > YORI_LIBSH_SERVER_MAX_REQUEST_CHARS ||
+        ExecContext->Environment.LengthInChars > YORI_LIBSH_SERVER_MAX_REQUEST_CHARS) {
 
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("for: environment too large for worker shells\n"));
+        return FALSE;
+    }
 
-                    //
-                    //  MSFIX This should probably use
-                    //  YoriLibShExpandCmdContext now it exists
-                    //
+    ExecContext->Workers = YoriLibMalloc(ExecContext->TargetConcurrentCount * (YORI_ALLOC_SIZE_T)sizeof(FOR_WORKER));
+    if (ExecContext->Workers == NULL) {
+        return FALSE;
+    }
+    ZeroMemory(ExecContext->Workers, ExecContext->TargetConcurrentCount * sizeof(FOR_WORKER));
+
+    YoriLibInitEmptyString(&YoriSpec);
+    LengthNeeded = (YORI_ALLOC_SIZE_T)GetEnvironmentVariable(_T("YORISPEC"), NULL, 0);
+    if (LengthNeeded != 0) {
+        if (YoriLibAllocateString(&YoriSpec, LengthNeeded)) {
+            YoriSpec.LengthInChars = (YORI_ALLOC_SIZE_T)GetEnvironmentVariable(_T("YORISPEC"), YoriSpec.StartOfString, YoriSpec.LengthAllocated);
+            if (YoriSpec.LengthInChars == 0 || YoriSpec.LengthInChars >= YoriSpec.LengthAllocated) {
+                YoriLibFreeStringContents(&YoriSpec);
+            }
+        }
+    }
+    if (YoriSpec.LengthInChars == 0) {
+        YoriLibConstantString(&YoriSpec, _T("yori.exe"));
+    }
 
-                    if (TerminateNextArg) {
-                        NewArgCount = ArgCount + 2;
-                    } else {
-                        NewArgCount = ArgCount + 1;
-                    }
+    //
+    //  Place the worker shells in a job object so they are terminated if
+    //  this process is.
+    //
 
-                    if (!YoriLibShAllocateArgCount(&NewCmd, NewArgCount, 0, NULL)) {
-                        return FALSE;
-                    }
+    ExecContext->hJob = YoriLibCreateJobObject();
+    if (ExecContext->hJob != NULL &&
+        !YoriLibLimitJobObjectKillOnClose(ExecContext->hJob)) {
 
-                    for (ExistingArg = 0; ExistingArg <= ArgIndex; ExistingArg++) {
-                        YoriLibShCopyArg(CmdContext, ExistingArg, &NewCmd, ExistingArg);
-                    }
+        CloseHandle(ExecContext->hJob);
+        ExecContext->hJob = NULL;
+    }
 
-                    NewCmd.ArgV[ArgIndex].LengthInChars = (YORI_ALLOC_SIZE_T)(Char.StartOfString - Arg[ArgIndex].StartOfString);
-                    YoriLibShCheckIfArgNeedsQuotes(&NewCmd, ArgIndex);
-                    YoriLibInitEmptyString(&NewCmd.ArgV[ArgIndex + 1]);
-                    NewCmd.ArgV[ArgIndex + 1].StartOfString = Char.StartOfString;
+    PoolId = ForWorkerPoolCount;
+    ForWorkerPoolCount++;
+
+    for (Index = 0; Index < ExecContext->TargetConcurrentCount; Index++) {
+        Worker = &ExecContext->Workers[Index];
+        Worker->ExecContext = ExecContext;
+
+        YoriLibInitEmptyString(&Worker->PipeName);
+        YoriLibYPrintf(&Worker->PipeName, _T("%sfor-%i-%i-%i"), YORI_LIBSH_SERVER_PIPE_PREFIX, GetCurrentProcessId(), PoolId, Index);
+        YoriLibInitEmptyString(&CmdLine);
+        YoriLibYPrintf(&CmdLine, _T("\"%y\" -server for-%i-%i-%i"), &YoriSpec, GetCurrentProcessId(), PoolId, Index);
+        if (Worker->PipeName.StartOfString == NULL || CmdLine.StartOfString == NULL) {
+            YoriLibFreeStringContents(&CmdLine);
+            YoriLibFreeStringContents(&YoriSpec);
+            return FALSE;
+        }
 
-                    if (TerminateNextArg) {
-                        NewCmd.ArgV[ArgIndex + 1].LengthInChars = CharsToConsume;
-                        YoriLibShCheckIfArgNeedsQuotes(&NewCmd, ArgIndex + 1);
-                        YoriLibInitEmptyString(&NewCmd.ArgV[ArgIndex + 2]);
-                        NewCmd.ArgV[ArgIndex + 2].StartOfString = &Char.StartOfString[CharsToConsume];
-                        NewCmd.ArgV[ArgIndex + 2].LengthInChars = Char.LengthInChars - CharsToConsume;
-                        YoriLibShCheckIfArgNeedsQuotes(&NewCmd, ArgIndex + 2);
-                         for (ExistingArg = ArgIndex + 1; ExistingArg < ArgCount; ExistingArg++) {
-                             YoriLibShCopyArg(CmdContext, ExistingArg, &NewCmd, ExistingArg + 2);
-                         }
+        memset(&StartupInfo, 0, sizeof(StartupInfo));
+        StartupInfo.cb = sizeof(StartupInfo);
+
+        if (!CreateProcess(NULL, CmdLine.StartOfString, NULL, NULL, TRUE, CREATE_SUSPENDED | CREATE_DEFAULT_ERROR_MODE, NULL, NULL, &StartupInfo, &ProcessInfo)) {
+            LastError = GetLastError();
+            ErrText = YoriLibGetWinErrorText(LastError);
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("for: could not start worker shell: %s"), ErrText);
+            YoriLibFreeWinErrorText(ErrText);
+            YoriLibFreeStringContents(&CmdLine);
+            YoriLibFreeStringContents(&YoriSpec);
+            return FALSE;
+        }
+        YoriLibFreeStringContents(&CmdLine);
 
-                        ArgIndex++;
+        if (ExecContext->hJob != NULL) {
+            YoriLibAssignProcessToJobObject(ExecContext->hJob, ProcessInfo.hProcess);
+        }
 
-                    } else {
-                        NewCmd.ArgV[ArgIndex + 1].LengthInChars = Char.LengthInChars;
-                        YoriLibShCheckIfArgNeedsQuotes(&NewCmd, ArgIndex + 1);
-                        for (ExistingArg = ArgIndex + 1; ExistingArg < ArgCount; ExistingArg++) {
-                            YoriLibShCopyArg(CmdContext, ExistingArg, &NewCmd, ExistingArg + 1);
-                        }
-                        InitialArgOffset = CharsToConsume;
-                    }
+        YoriLibPlaceNextProcess(&ExecContext->ProcessorPlacement, ProcessInfo.hThread);
+        ResumeThread(ProcessInfo.hThread);
+        CloseHandle(ProcessInfo.hThread);
+        Worker->hProcess = ProcessInfo.hProcess;
 
-                    //
-                    //  MSFIX: Need to update Section and Char to refer to
-                    //  their respective locations in the new argument.  Note
-                    //  that the argument index may have changed, and the
-                    //  argument length may have changed.
-                    //
-                    //  The nightmare case is something like:
-                    //  %i>>foo
-                    //
-                    //  Where we want:
-                    //  "My File">>foo
-                    //
-                    //  Meaning that the section is being terminated by the
-                    //  argument seperator but the previous section needs to
-                    //  be resolved.
-                    //
+        if (!YoriLibWorkQueueAddWorker(ExecContext->WorkQueue, Worker)) {
+            YoriLibFreeStringContents(&YoriSpec);
+            return FALSE;
+        }
+    }
 
-                    WhiteSpaceInSection = FALSE;
+    YoriLibFreeStringContents(&YoriSpec);
+    return TRUE;
+}
 
-                    YoriLibShFreeCmdContext(CmdContext);
-                    CmdContext->ArgC = NewArgCount;
-                    CmdContext->ArgV = NewCmd.ArgV;
-                    CmdContext->ArgContexts = NewCmd.ArgContexts;
-                    CmdContext->MemoryToFreeArgV = NewCmd.MemoryToFreeArgV;
-                    CmdContext->MemoryToFreeArgContexts = NewCmd.MemoryToFreeArgContexts;
+/**
+ Wait for all queued jobs to complete, tell worker threads to exit, and
+ terminate the worker shells.  This can be called if the workers were
+ partially started.
 
-                    ArgCount = NewArgCount;
-                    Arg = NewCmd.ArgV;
+ @param ExecContext Pointer to the exec context.
+ */
+VOID
+ForCleanupWorkers(
+    __in PFOR_EXEC_CONTEXT ExecContext
+    )
+{
+    YORI_ALLOC_SIZE_T Index;
+    PFOR_WORKER Worker;
 
-                    break;
-                }
-            }
+    if (ExecContext->WorkQueue != NULL) {
+        YoriLibWorkQueueDestroy(ExecContext->WorkQueue);
+        ExecContext->WorkQueue = NULL;
+    }
 
-            Char.StartOfString++;
-            Char.LengthInChars--;
+    if (ExecContext->Workers != NULL) {
+        //
+        //  The worker shells only exit when terminated.  If they are in a
+        //  job object, closing it terminates them.
+        //
+
+        if (ExecContext->hJob != NULL) {
+            CloseHandle(ExecContext->hJob);
+            ExecContext->hJob = NULL;
         }
 
-        if (WhiteSpaceInSection) {
-            Section.LengthInChars = (YORI_ALLOC_SIZE_T)(Char.StartOfString - Section.StartOfString);
-            ForQuoteSectionIfNeeded(&CmdContext->ArgV[ArgIndex],
-                                    &CmdContext->ArgContexts[ArgIndex],
-                                    &Section,
-                                    WhiteSpaceInSection,
-                                    &Char);
-            WhiteSpaceInSection = FALSE;
+        for (Index = 0; Index < ExecContext->TargetConcurrentCount; Index++) {
+            Worker = &ExecContext->Workers[Index];
+            if (Worker->hProcess != NULL) {
+                TerminateProcess(Worker->hProcess, EXIT_SUCCESS);
+                CloseHandle(Worker->hProcess);
+                Worker->hProcess = NULL;
+            }
+            YoriLibFreeStringContents(&Worker->PipeName);
         }
+
+        YoriLibFree(ExecContext->Workers);
+        ExecContext->Workers = NULL;
     }
 
-    return TRUE;
+    if (ExecContext->hJob != NULL) {
+        CloseHandle(ExecContext->hJob);
+        ExecContext->hJob = NULL;
+    }
+
+    YoriLibCleanupProcessorPlacement(&ExecContext->ProcessorPlacement);
+
+    if (ExecContext->Mutex != NULL) {
+        CloseHandle(ExecContext->Mutex);
+        ExecContext->Mutex = NULL;
+    }
+
+    YoriLibFreeStringContents(&ExecContext->CurrentDirectory);
+    YoriLibFreeStringContents(&ExecContext->Environment);
 }
 
 /**
@@ -606,14 +1622,19 @@ ForExecuteCommand(
     YoriLibInitEmptyString(&CmdLine);
 
 #ifdef YORI_BUILTIN
-    if (!ExecContext->InvokeCmd &&
-        ExecContext->TargetConcurrentCount == 1) {
+    if (ExecContext->UseWorkers ||
+        (!ExecContext->InvokeCmd &&
+         ExecContext->TargetConcurrentCount == 1)) {
         PrefixArgCount = 0;
     } else {
         PrefixArgCount = 2;
     }
 #else
-    PrefixArgCount = 2;
+    if (ExecContext->UseWorkers) {
+        PrefixArgCount = 0;
+    } else {
+        PrefixArgCount = 2;
+    }
 #endif
 
     ArgsNeeded = ArgsNeeded + PrefixArgCount;
@@ -754,6 +1775,11 @@ ForExecuteCommand(
         goto Cleanup;
     }
 
+    if (ExecContext->UseWorkers) {
+        ForQueueJob(ExecContext, &CmdLine);
+        goto Cleanup;
+    }
+
 #ifdef YORI_BUILTIN
     if (PrefixArgCount == 0) {
         YoriCallExecuteExpression(&CmdLine);
@@ -764,7 +1790,7 @@ ForExecuteCommand(
     memset(&StartupInfo, 0, sizeof(StartupInfo));
     StartupInfo.cb = sizeof(StartupInfo);
 
-    if (!CreateProcess(NULL, CmdLine.StartOfString, NULL, NULL, TRUE, CREATE_DEFAULT_ERROR_MODE, NULL, NULL, &StartupInfo, &ProcessInfo)) {
+    if (!CreateProcess(NULL, CmdLine.StartOfString, NULL, NULL, TRUE, CREATE_SUSPENDED | CREATE_DEFAULT_ERROR_MODE, NULL, NULL, &StartupInfo, &ProcessInfo)) {
         DWORD LastError = GetLastError();
         LPTSTR ErrText = YoriLibGetWinErrorText(LastError);
         YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("for: execution failed: %s"), ErrText);
@@ -772,6 +1798,8 @@ ForExecuteCommand(
         goto Cleanup;
     }
 
+    YoriLibPlaceNextProcess(&ExecContext->ProcessorPlacement, ProcessInfo.hThread);
+    ResumeThread(ProcessInfo.hThread);
     CloseHandle(ProcessInfo.hThread);
 
     ExecContext->HandleArray[ExecContext->CurrentConcurrentCount] = ProcessInfo.hProcess;
@@ -800,7 +1828,7 @@ Cleanup:
  @param Context The current state of the program and information needed to
         launch new child processes.
 
- @return TRUE to continute enumerating, FALSE to abort.
+ @return TRUE to continue enumerating, FALSE to abort.
  */
 BOOL
 ForFileFoundCallback(
@@ -827,6 +1855,210 @@ ForFileFoundCallback(
     return TRUE;
 }
 
+/**
+ A callback that is invoked on the enumeration thread when a file is found
+ that matches a search criteria.  The file is added to the queue of matches
+ to execute, waiting for space in the queue if it is full.
+
+ @param FilePath Pointer to the file path that was found.
+
+ @param FileInfo Information about the file.
+
+ @param Depth Recursion depth, ignored in this application.
+
+ @param Context Pointer to the match queue.
+
+ @return TRUE to continue enumerating, FALSE to abort.
+ */
+BOOL
+ForMatchFoundCallback(
+    __in PYORI_STRING FilePath,
+    __in PWIN32_FIND_DATA FileInfo,
+    __in DWORD Depth,
+    __in PVOID Context
+    )
+{
+    PFOR_MATCH_QUEUE MatchQueue;
+    PFOR_MATCH Match;
+    YORI_MAX_UNSIGNED_T BytesNeeded;
+
+    UNREFERENCED_PARAMETER(Depth);
+
+    MatchQueue = (PFOR_MATCH_QUEUE)Context;
+
+    ASSERT(YoriLibIsStringNullTerminated(FilePath));
+
+    if (!YoriLibFileFiltCheckFilterMatch(&MatchQueue->ExecContext->Filter, FilePath, FileInfo)) {
+        return TRUE;
+    }
+
+    BytesNeeded = sizeof(FOR_MATCH);
+    BytesNeeded += ((YORI_MAX_UNSIGNED_T)FilePath->LengthInChars + 1) * sizeof(TCHAR);
+
+    if (!YoriLibIsSizeAllocatable(BytesNeeded)) {
+        return TRUE;
+    }
+
+    WaitForSingleObject(MatchQueue->SpaceAvailableSemaphore, INFINITE);
+
+    if (MatchQueue->Abandon || YoriLibIsOperationCancelled()) {
+        return FALSE;
+    }
+
+    Match = YoriLibMalloc((YORI_ALLOC_SIZE_T)BytesNeeded);
+    if (Match == NULL) {
+        ReleaseSemaphore(MatchQueue->SpaceAvailableSemaphore, 1, NULL);
+        return TRUE;
+    }
+
+    YoriLibInitEmptyString(&Match->Match);
+    Match->Match.StartOfString = (LPTSTR)(Match + 1);
+    Match->Match.LengthAllocated = FilePath->LengthInChars + 1;
+    memcpy(Match->Match.StartOfString, FilePath->StartOfString, FilePath->LengthInChars * sizeof(TCHAR));
+    Match->Match.LengthInChars = FilePath->LengthInChars;
+    Match->Match.StartOfString[Match->Match.LengthInChars] = '\0';
+
+    WaitForSingleObject(MatchQueue->Mutex, INFINITE);
+    YoriLibAppendList(&MatchQueue->MatchList, &Match->ListEntry);
+    ReleaseMutex(MatchQueue->Mutex);
+    ReleaseSemaphore(MatchQueue->MatchAvailableSemaphore, 1, NULL);
+
+    return TRUE;
+}
+
+/**
+ A thread which enumerates files and adds each match to the match queue.
+
+ @param Parameter Pointer to the match queue.
+
+ @return Exit code for the thread, currently always zero.
+ */
+DWORD WINAPI
+ForEnumerateThread(
+    __in LPVOID Parameter
+    )
+{
+    PFOR_MATCH_QUEUE MatchQueue;
+
+    MatchQueue = (PFOR_MATCH_QUEUE)Parameter;
+
+    YoriLibForEachFile(MatchQueue->FileSpec, MatchQueue->MatchFlags, 0, ForMatchFoundCallback, NULL, MatchQueue);
+
+    WaitForSingleObject(MatchQueue->Mutex, INFINITE);
+    MatchQueue->EnumerateComplete = TRUE;
+    ReleaseMutex(MatchQueue->Mutex);
+    ReleaseSemaphore(MatchQueue->MatchAvailableSemaphore, 1, NULL);
+
+    return 0;
+}
+
+/**
+ Enumerate files on a separate thread and execute a command for each match
+ on this thread, so that enumeration continues while commands are executing
+ and while waiting for a process to complete.  The number of matches found
+ but not yet executed is limited to FOR_MATCH_QUEUE_DEPTH.
+
+ @param FileSpec The files to enumerate.
+
+ @param MatchFlags Flags to pass to the enumerate.
+
+ @param ExecContext The current state of child processes and information
+        about the arguments for any new child process.
+
+ @return TRUE if the files were enumerated, FALSE if the enumeration thread
+         could not be started and the caller should enumerate files itself.
+ */
+BOOLEAN
+ForEnumerateAndExecute(
+    __in PYORI_STRING FileSpec,
+    __in WORD MatchFlags,
+    __in PFOR_EXEC_CONTEXT ExecContext
+    )
+{
+    FOR_MATCH_QUEUE MatchQueue;
+    PYORI_LIST_ENTRY ListEntry;
+    PFOR_MATCH Match;
+    HANDLE hThread;
+    DWORD ThreadId;
+    BOOLEAN Result;
+
+    ZeroMemory(&MatchQueue, sizeof(MatchQueue));
+    MatchQueue.ExecContext = ExecContext;
+    MatchQueue.FileSpec = FileSpec;
+    MatchQueue.MatchFlags = MatchFlags;
+    YoriLibInitializeListHead(&MatchQueue.MatchList);
+
+    Result = FALSE;
+    hThread = NULL;
+    MatchQueue.Mutex = CreateMutex(NULL, FALSE, NULL);
+    MatchQueue.MatchAvailableSemaphore = CreateSemaphore(NULL, 0, 0x7FFFFFFF, NULL);
+    MatchQueue.SpaceAvailableSemaphore = CreateSemaphore(NULL, FOR_MATCH_QUEUE_DEPTH, FOR_MATCH_QUEUE_DEPTH, NULL);
+
+    if (MatchQueue.Mutex == NULL ||
+        MatchQueue.MatchAvailableSemaphore == NULL ||
+        MatchQueue.SpaceAvailableSemaphore == NULL) {
+
+        goto Cleanup;
+    }
+
+    hThread = CreateThread(NULL, 0, ForEnumerateThread, &MatchQueue, 0, &ThreadId);
+    if (hThread == NULL) {
+        goto Cleanup;
+    }
+
+    Result = TRUE;
+
+    while (TRUE) {
+        WaitForSingleObject(MatchQueue.MatchAvailableSemaphore, INFINITE);
+
+        WaitForSingleObject(MatchQueue.Mutex, INFINITE);
+        ListEntry = YoriLibGetNextListEntry(&MatchQueue.MatchList, NULL);
+        if (ListEntry == NULL) {
+            if (MatchQueue.EnumerateComplete) {
+                ReleaseMutex(MatchQueue.Mutex);
+                break;
+            }
+            ReleaseMutex(MatchQueue.Mutex);
+            continue;
+        }
+        YoriLibRemoveListItem(ListEntry);
+        ReleaseMutex(MatchQueue.Mutex);
+        ReleaseSemaphore(MatchQueue.SpaceAvailableSemaphore, 1, NULL);
+
+        //
+        //  If the user has cancelled, tell the enumeration thread to stop,
+        //  and keep removing matches so it is not left waiting for space.
+        //
+
+        Match = CONTAINING_RECORD(ListEntry, FOR_MATCH, ListEntry);
+        if (YoriLibIsOperationCancelled()) {
+            MatchQueue.Abandon = TRUE;
+        } else {
+            ForExecuteCommand(&Match->Match, ExecContext);
+        }
+        YoriLibFree(Match);
+    }
+
+    WaitForSingleObject(hThread, INFINITE);
+
+Cleanup:
+
+    if (hThread != NULL) {
+        CloseHandle(hThread);
+    }
+    if (MatchQueue.Mutex != NULL) {
+        CloseHandle(MatchQueue.Mutex);
+    }
+    if (MatchQueue.MatchAvailableSemaphore != NULL) {
+        CloseHandle(MatchQueue.MatchAvailableSemaphore);
+    }
+    if (MatchQueue.SpaceAvailableSemaphore != NULL) {
+        CloseHandle(MatchQueue.SpaceAvailableSemaphore);
+    }
+
+    return Result;
+}
+
 #ifdef YORI_BUILTIN
 /**
  The main entrypoint for the for builtin command.
@@ -862,6 +2094,7 @@ ENTRYPOINT(
     BOOLEAN MatchDirectories;
     BOOLEAN Recurse;
     BOOLEAN BasicEnumeration;
+    BOOLEAN PipelineEnumeration;
     BOOLEAN StepMode;
     YORI_ALLOC_SIZE_T CharIndex;
     WORD MatchFlags;
@@ -921,6 +2154,10 @@ ENTRYPOINT(
                     i++;
                     ArgumentUnderstood = TRUE;
                 }
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("k")) == 0) {
+                ExecContext.KeepOrder = TRUE;
+                ExecContext.UseWorkers = TRUE;
+                ArgumentUnderstood = TRUE;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("l")) == 0) {
                 StepMode = TRUE;
                 ArgumentUnderstood = TRUE;
@@ -942,6 +2179,13 @@ ENTRYPOINT(
             } else if (YoriLibCompareStringLitIns(&Arg, _T("r")) == 0) {
                 Recurse = TRUE;
                 ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("s")) == 0) {
+                ExecContext.DisplayProgress = TRUE;
+                ExecContext.UseWorkers = TRUE;
+                ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("w")) == 0) {
+                ExecContext.UseWorkers = TRUE;
+                ArgumentUnderstood = TRUE;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("-")) == 0) {
                 ArgumentUnderstood = TRUE;
                 StartArg = i + 1;
@@ -963,6 +2207,11 @@ ENTRYPOINT(
         goto cleanup_and_exit;
     }
 
+    if (ExecContext.UseWorkers && ExecContext.InvokeCmd) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("for: worker shells cannot be used with -c\n"));
+        goto cleanup_and_exit;
+    }
+
     ExecContext.SubstituteVariable = &ArgV[StartArg];
 
     //
@@ -1028,6 +2277,19 @@ ENTRYPOINT(
         goto cleanup_and_exit;
     }
 
+    if (ExecContext.TargetConcurrentCount > 1) {
+        YoriLibInitializeProcessorPlacement(&ExecContext.ProcessorPlacement, YoriLibPlacementByNumaNode);
+    }
+
+    if (ExecContext.UseWorkers) {
+#if YORI_BUILTIN
+        YoriLibCancelEnable(FALSE);
+#endif
+        if (!ForStartWorkers(&ExecContext)) {
+            goto cleanup_and_exit;
+        }
+    }
+
     MatchFlags = 0;
     if (MatchDirectories) {
         MatchFlags = YORILIB_FILEENUM_RETURN_DIRECTORIES;
@@ -1042,6 +2304,24 @@ ENTRYPOINT(
         MatchFlags |= YORILIB_FILEENUM_BASIC_EXPANSION;
     }
 
+    //
+    //  Enumerate files on a separate thread so that commands can start
+    //  while enumeration is still in progress.  When the command is
+    //  executed within this process on this thread, it can change process
+    //  state such as the current directory, so enumerate inline to ensure
+    //  that state is not changed while enumerating.
+    //
+
+    PipelineEnumeration = TRUE;
+#ifdef YORI_BUILTIN
+    if (!ExecContext.UseWorkers &&
+        !ExecContext.InvokeCmd &&
+        ExecContext.TargetConcurrentCount == 1) {
+
+        PipelineEnumeration = FALSE;
+    }
+#endif
+
     if (StepMode) {
         YORI_MAX_SIGNED_T Start;
         YORI_MAX_SIGNED_T Step;
@@ -1204,7 +2484,11 @@ ENTRYPOINT(
             if (ThisMatch.LengthInChars > 0) {
 
                 if (RequiresExpansion) {
-                    YoriLibForEachFile(&ThisMatch, MatchFlags, 0, ForFileFoundCallback, NULL, &ExecContext);
+                    if (!PipelineEnumeration ||
+                        !ForEnumerateAndExecute(&ThisMatch, MatchFlags, &ExecContext)) {
+
+                        YoriLibForEachFile(&ThisMatch, MatchFlags, 0, ForFileFoundCallback, NULL, &ExecContext);
+                    }
                 } else {
                     ForExecuteCommand(&ThisMatch, &ExecContext);
                 }
@@ -1223,6 +2507,17 @@ ENTRYPOINT(
         ForWaitForProcessToComplete(&ExecContext);
     }
 
+    if (ExecContext.UseWorkers) {
+        ExecContext.AllJobsQueued = TRUE;
+        ForCompleteJobs(&ExecContext, 0);
+        if (ExecContext.Mutex != NULL) {
+            WaitForSingleObject(ExecContext.Mutex, INFINITE);
+            ForDisplayProgress(&ExecContext, TRUE);
+            ReleaseMutex(ExecContext.Mutex);
+        }
+        ForCleanupWorkers(&ExecContext);
+    }
+
     YoriLibFileFiltFreeFilter(&ExecContext.Filter);
     YoriLibFree(ExecContext.HandleArray);
 
@@ -1230,7 +2525,11 @@ ENTRYPOINT(
 
 cleanup_and_exit:
 
+    ForCleanupWorkers(&ExecContext);
     YoriLibFileFiltFreeFilter(&ExecContext.Filter);
+    if (ExecContext.HandleArray != NULL) {
+        YoriLibFree(ExecContext.HandleArray);
+    }
 
     return EXIT_FAILURE;
 }
@@ -40,11 +40,13 @@ CHAR strHashHelpText[] =
         "\n"
         "Hash a file.\n"
         "\n"
-        "HASH [-license] [-a <algorithm>] [-b] [-s] [<file>]\n"
+        "HASH [-license] [-a <algorithm>] [-b] [-c <file>] [-j <count>] [-s] [<file>]\n"
         "\n"
         "   -a <algorithm> Specify the hash algorithm. Supported algorithms:\n"
         "                    MD4, MD5, SHA1, SHA256, SHA384, or SHA512\n"
         "   -b             Use basic search criteria for files only\n"
+        "   -c <file>      Cache hashes in file and only hash files that changed\n"
+        "   -j <count>     Hash up to count files concurrently\n"
         "   -s             Hash files in subdirectories\n";
 
 /**
@@ -61,6 +63,215 @@ HashHelp(VOID)
     return TRUE;
 }
 
+/**
+ The maximum number of files that can be hashed concurrently.
+ */
+#define HASH_MAX_WORKERS 64
+
+/**
+ The number of reads that can be outstanding against a single file.  While
+ one buffer is being hashed, the next is being read.
+ */
+#define HASH_READ_BUFFERS 2
+
+/**
+ The signature at the start of a hash cache file.
+ */
+#define HASH_CACHE_SIGNATURE 0x43485959
+
+/**
+ The version of the hash cache file format.
+ */
+#define HASH_CACHE_VERSION 1
+
+/**
+ The header at the start of a hash cache file.
+ */
+typedef struct _HASH_CACHE_FILE_HEADER {
+
+    /**
+     Set to HASH_CACHE_SIGNATURE.
+     */
+    DWORD Signature;
+
+    /**
+     Set to HASH_CACHE_VERSION.
+     */
+    DWORD Version;
+
+    /**
+     The number of entries following the header.
+     */
+    DWORD EntryCount;
+} HASH_CACHE_FILE_HEADER, *PHASH_CACHE_FILE_HEADER;
+
+/**
+ The fields within a hash cache entry which are used to find a previously
+ calculated hash.
+ */
+typedef struct _HASH_CACHE_KEY {
+
+    /**
+     The serial number of the volume containing the file.
+     */
+    DWORD VolumeSerialNumber;
+
+    /**
+     The algorithm used to calculate the hash, in CALG_* format.
+     */
+    DWORD Algorithm;
+
+    /**
+     The file ID of the file within its volume.
+     */
+    LARGE_INTEGER FileId;
+} HASH_CACHE_KEY, *PHASH_CACHE_KEY;
+
+/**
+ A single entry within a hash cache file.  This is followed by HashLength
+ bytes of hash data.  Entries are not aligned within the file.
+ */
+typedef struct _HASH_CACHE_RECORD {
+
+    /**
+     The file and algorithm that this entry describes.
+     */
+    HASH_CACHE_KEY Key;
+
+    /**
+     The last write time of the file when the hash was calculated.
+     */
+    LARGE_INTEGER LastWriteTime;
+
+    /**
+     The size of the file when the hash was calculated.
+     */
+    LARGE_INTEGER FileSize;
+
+    /**
+     The USN of the file when the hash was calculated, or zero if the
+     volume has no change journal.
+     */
+    LARGE_INTEGER Usn;
+
+    /**
+     The number of bytes of hash data following this entry.
+     */
+    DWORD HashLength;
+} HASH_CACHE_RECORD, *PHASH_CACHE_RECORD;
+
+/**
+ In memory information about a previously calculated hash.
+ */
+typedef struct _HASH_CACHE_ENTRY {
+
+    /**
+     The list of all entries in the cache.
+     */
+    YORI_LIST_ENTRY ListEntry;
+
+    /**
+     The entry within the hash table, keyed by HASH_CACHE_KEY.
+     */
+    YORI_HASH_ENTRY HashEntry;
+
+    /**
+     The metadata describing the file and the hash.
+     */
+    HASH_CACHE_RECORD Record;
+
+    /**
+     Pointer to the hash data.  This is allocated as part of the entry.
+     */
+    PUCHAR Hash;
+
+    /**
+     The string form of the key used to find this entry in the hash table.
+     The hash table refers to this buffer rather than copying it.
+     */
+    TCHAR KeyBuffer[sizeof(HASH_CACHE_KEY) * 2 + 1];
+} HASH_CACHE_ENTRY, *PHASH_CACHE_ENTRY;
+
+typedef struct _HASH_CONTEXT *PHASH_CONTEXT;
+
+/**
+ State used by a single thread to hash a single file at a time.
+ */
+typedef struct _HASH_WORKER {
+
+    /**
+     Pointer to the hash context that this worker is performing work for.
+     */
+    PHASH_CONTEXT HashContext;
+
+    /**
+     Pointer to a blob of memory containing the result of the hash
+     calculation for each file.
+     */
+    PUCHAR HashBuffer;
+
+    /**
+     Pointers to buffers to read data from the file into.
+     */
+    PVOID ReadBuffer[HASH_READ_BUFFERS];
+
+    /**
+     Overlapped structures describing reads into each buffer.
+     */
+    OVERLAPPED Overlapped[HASH_READ_BUFFERS];
+} HASH_WORKER, *PHASH_WORKER;
+
+/**
+ A single file to hash on a worker thread.
+ */
+typedef struct _HASH_JOB {
+
+    /**
+     The work queue item for this job.  Results are displayed in the order
+     that jobs are queued.
+     */
+    YORILIB_WORK_ITEM WorkItem;
+
+    /**
+     A handle to the file to hash.
+     */
+    HANDLE FileHandle;
+
+    /**
+     The path to display for the file.  This is allocated as part of the
+     job.
+     */
+    YORI_STRING RelativePath;
+
+    /**
+     On completion, the hash of the file as a string.  This is allocated as
+     part of the job.
+     */
+    YORI_STRING HashString;
+
+    /**
+     On completion, the hash of the file in binary form.  This is allocated
+     as part of the job.
+     */
+    PUCHAR Hash;
+
+    /**
+     Information about the file used to update the hash cache.
+     */
+    HASH_CACHE_RECORD CacheRecord;
+
+    /**
+     Set to TRUE if CacheRecord is valid and the cache should be updated with
+     the result of this job.
+     */
+    BOOLEAN UpdateCache;
+
+    /**
+     Set to TRUE if the hash was calculated successfully.
+     */
+    BOOLEAN Succeeded;
+} HASH_JOB, *PHASH_JOB;
+
 /**
  Context passed to the callback which is invoked for each file found.
  */
@@ -92,68 +303,573 @@ typedef struct _HASH_CONTEXT {
     DWORD Algorithm;
 
     /**
-     Pointer to a blob of memory containing the result of the hash calculation
-     for each file.
+     Specifies the number of bytes in each worker's HashBuffer.
      */
-    PUCHAR HashBuffer;
+    YORI_ALLOC_SIZE_T HashLength;
 
     /**
-     Specifies the number of bytes in HashBuffer.
+     Specifies the number of bytes in each worker's ReadBuffer.
      */
-    YORI_ALLOC_SIZE_T HashLength;
+    YORI_ALLOC_SIZE_T ReadBufferLength;
 
     /**
-     Pointer to a buffer to read data from the file into.
+     A string which contains enough characters to contain the hex
+     representation of HashBuffer plus a NULL terminator.  This is used when
+     hashing on the main thread.
      */
-    PVOID ReadBuffer;
+    YORI_STRING HashString;
 
     /**
-     Specifies the number of bytes in ReadBuffer.
+     Records the total number of files processed.
      */
-    YORI_ALLOC_SIZE_T ReadBufferLength;
+    LONGLONG FilesFound;
 
     /**
-     A string which contains enough characters to contain the hex
-     representation of HashBuffer plus a NULL terminator.
+     Records the total number of files processed within a single command line
+     argument.
      */
-    YORI_STRING HashString;
+    LONGLONG FilesFoundThisArg;
+
+    /**
+     The number of elements in the Workers array.  If this is one, files are
+     hashed on the main thread.
+     */
+    DWORD WorkerCount;
+
+    /**
+     An array of workers.
+     */
+    PHASH_WORKER Workers;
+
+    /**
+     A queue of files to hash on worker threads.  This is NULL if files are
+     hashed on the main thread.
+     */
+    PYORILIB_WORK_QUEUE WorkQueue;
+
+    /**
+     The file to load previously calculated hashes from and save newly
+     calculated hashes to.  If empty, no cache is used.
+     */
+    YORI_STRING CacheFileName;
+
+    /**
+     A hash table of previously calculated hashes, keyed by file ID.  If NULL,
+     no cache is used.
+     */
+    PYORI_HASH_TABLE CacheTable;
+
+    /**
+     A list of all entries in CacheTable.
+     */
+    YORI_LIST_ENTRY CacheList;
+
+    /**
+     Set to TRUE if the cache has changed since it was loaded and should be
+     saved.
+     */
+    BOOLEAN CacheModified;
+
+} HASH_CONTEXT;
+
+/**
+ Generate a string form of a cache key so that it can be located within
+ a hash table.
+
+ @param Key Pointer to the cache key.
+
+ @param KeyString On input, points to a string which has been allocated
+        with space for sizeof(HASH_CACHE_KEY) * 2 + 1 characters.  On
+        successful completion, populated with the key in string form.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+HashCacheKeyToString(
+    __in PHASH_CACHE_KEY Key,
+    __inout PYORI_STRING KeyString
+    )
+{
+    return YoriLibHexBufferToString((PUCHAR)Key, sizeof(HASH_CACHE_KEY), KeyString);
+}
+
+/**
+ Find a previously calculated hash for a file in the cache.
+
+ @param HashContext Pointer to the hash context.
+
+ @param Record Pointer to information about the file as it currently exists.
+
+ @return Pointer to the cache entry if the file has a cached hash which is
+         still valid, or NULL if the file must be hashed.
+ */
+PHASH_CACHE_ENTRY
+HashCacheLookup(
+    __in PHASH_CONTEXT HashContext,
+    __in PHASH_CACHE_RECORD Record
+    )
+{
+    TCHAR KeyBuffer[sizeof(HASH_CACHE_KEY) * 2 + 1];
+    YORI_STRING KeyString;
+    PYORI_HASH_ENTRY HashEntry;
+    PHASH_CACHE_ENTRY CacheEntry;
+
+    if (HashContext->CacheTable == NULL) {
+        return NULL;
+    }
+
+    YoriLibInitEmptyString(&KeyString);
+    KeyString.StartOfString = KeyBuffer;
+    KeyString.LengthAllocated = sizeof(KeyBuffer)/sizeof(KeyBuffer[0]);
+    if (!HashCacheKeyToString(&Record->Key, &KeyString)) {
+        return NULL;
+    }
+
+    HashEntry = YoriLibHashLookupByKey(HashContext->CacheTable, &KeyString);
+    if (HashEntry == NULL) {
+        return NULL;
+    }
+
+    CacheEntry = HashEntry->Context;
+    if (CacheEntry->Record.LastWriteTime.QuadPart != Record->LastWriteTime.QuadPart ||
+        CacheEntry->Record.FileSize.QuadPart != Record->FileSize.QuadPart ||
+        CacheEntry->Record.Usn.QuadPart != Record->Usn.QuadPart ||
+        CacheEntry->Record.HashLength != HashContext->HashLength) {
+
+        return NULL;
+    }
+
+    return CacheEntry;
+}
+
+/**
+ Add a newly calculated hash to the cache, replacing any previous entry for
+ the same file.
+
+ @param HashContext Pointer to the hash context.
+
+ @param Record Pointer to information about the file.  The HashLength field
+        indicates the number of bytes in Hash.
+
+ @param Hash Pointer to the hash data.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+HashCacheUpdate(
+    __in PHASH_CONTEXT HashContext,
+    __in PHASH_CACHE_RECORD Record,
+    __in PUCHAR Hash
+    )
+{
+    TCHAR KeyBuffer[sizeof(HASH_CACHE_KEY) * 2 + 1];
+    YORI_STRING KeyString;
+    PYORI_HASH_ENTRY HashEntry;
+    PHASH_CACHE_ENTRY CacheEntry;
+
+    if (HashContext->CacheTable == NULL) {
+        return FALSE;
+    }
+
+    YoriLibInitEmptyString(&KeyString);
+    KeyString.StartOfString = KeyBuffer;
+    KeyString.LengthAllocated = sizeof(KeyBuffer)/sizeof(KeyBuffer[0]);
+    if (!HashCacheKeyToString(&Record->Key, &KeyString)) {
+        return FALSE;
+    }
+
+    HashEntry = YoriLibHashLookupByKey(HashContext->CacheTable, &KeyString);
+    if (HashEntry != NULL) {
+        CacheEntry = HashEntry->Context;
+        if (CacheEntry->Record.HashLength == Record->HashLength) {
+            memcpy(&CacheEntry->Record, Record, sizeof(HASH_CACHE_RECORD));
+            memcpy(CacheEntry->Hash, Hash, Record->HashLength);
+            HashContext->CacheModified = TRUE;
+            return TRUE;
+        }
+
+        YoriLibHashRemoveByEntry(&CacheEntry->HashEntry);
+        YoriLibRemoveListItem(&CacheEntry->ListEntry);
+        YoriLibFree(CacheEntry);
+    }
+
+    CacheEntry = YoriLibMalloc((YORI_ALLOC_SIZE_T)(sizeof(HASH_CACHE_ENTRY) + Record->HashLength));
+    if (CacheEntry == NULL) {
+        return FALSE;
+    }
+
+    memcpy(&CacheEntry->Record, Record, sizeof(HASH_CACHE_RECORD));
+    CacheEntry->Hash = (PUCHAR)(CacheEntry + 1);
+    memcpy(CacheEntry->Hash, Hash, Record->HashLength);
+    memcpy(CacheEntry->KeyBuffer, KeyBuffer, sizeof(KeyBuffer));
+    KeyString.StartOfString = CacheEntry->KeyBuffer;
+
+    YoriLibHashInsertByKey(HashContext->CacheTable, &KeyString, CacheEntry, &CacheEntry->HashEntry);
+    YoriLibAppendList(&HashContext->CacheList, &CacheEntry->ListEntry);
+    HashContext->CacheModified = TRUE;
+    return TRUE;
+}
+
+/**
+ Query the information used to determine whether a file has changed since
+ it was last hashed.
+
+ @param HashContext Pointer to the hash context.
+
+ @param FileHandle A handle to the file, opened for overlapped IO.
+
+ @param Record On successful completion, populated with information about
+        the file.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+HashCacheQueryFile(
+    __in PHASH_CONTEXT HashContext,
+    __in HANDLE FileHandle,
+    __out PHASH_CACHE_RECORD Record
+    )
+{
+    BY_HANDLE_FILE_INFORMATION FileInfo;
+    OVERLAPPED Overlapped;
+    DWORD BytesReturned;
+    BOOL Result;
+    struct {
+        USN_RECORD UsnRecord;
+        WCHAR FileName[YORI_LIB_MAX_FILE_NAME];
+    } UsnData;
+
+    if (!GetFileInformationByHandle(FileHandle, &FileInfo)) {
+        return FALSE;
+    }
+
+    //
+    //  Without a file ID there is nothing to key the cache with.
+    //
+
+    if (FileInfo.nFileIndexLow == 0 && FileInfo.nFileIndexHigh == 0) {
+        return FALSE;
+    }
+
+    ZeroMemory(Record, sizeof(HASH_CACHE_RECORD));
+    Record->Key.VolumeSerialNumber = FileInfo.dwVolumeSerialNumber;
+    Record->Key.Algorithm = HashContext->Algorithm;
+    Record->Key.FileId.LowPart = FileInfo.nFileIndexLow;
+    Record->Key.FileId.HighPart = FileInfo.nFileIndexHigh;
+    Record->LastWriteTime.LowPart = FileInfo.ftLastWriteTime.dwLowDateTime;
+    Record->LastWriteTime.HighPart = FileInfo.ftLastWriteTime.dwHighDateTime;
+    Record->FileSize.LowPart = FileInfo.nFileSizeLow;
+    Record->FileSize.HighPart = FileInfo.nFileSizeHigh;
+    Record->HashLength = HashContext->HashLength;
+
+    //
+    //  The handle is opened for overlapped IO, so wait for the result of
+    //  the request on the handle.  If the volume has no change journal,
+    //  the cache relies on the remaining fields.
+    //
+
+    ZeroMemory(&Overlapped, sizeof(Overlapped));
+    Result = DeviceIoControl(FileHandle, FSCTL_READ_FILE_USN_DATA, NULL, 0, &UsnData, sizeof(UsnData), &BytesReturned, &Overlapped);
+    if (!Result && GetLastError() == ERROR_IO_PENDING) {
+        Result = GetOverlappedResult(FileHandle, &Overlapped, &BytesReturned, TRUE);
+    }
+
+    if (Result) {
+        Record->Usn.QuadPart = UsnData.UsnRecord.Usn;
+    }
+
+    return TRUE;
+}
+
+/**
+ Load previously calculated hashes from the cache file.  If the file does
+ not exist, the cache starts empty.
+
+ @param HashContext Pointer to the hash context, where CacheFileName
+        specifies the file to load.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+HashCacheLoad(
+    __in PHASH_CONTEXT HashContext
+    )
+{
+    HANDLE FileHandle;
+    LARGE_INTEGER FileSize;
+    PUCHAR Buffer;
+    DWORD BytesRead;
+    DWORD Index;
+    YORI_ALLOC_SIZE_T Offset;
+    HASH_CACHE_FILE_HEADER Header;
+    HASH_CACHE_RECORD Record;
+    BOOL Result;
+
+    YoriLibInitializeListHead(&HashContext->CacheList);
+    HashContext->CacheTable = YoriLibAllocateHashTable(4093);
+    if (HashContext->CacheTable == NULL) {
+        return FALSE;
+    }
+
+    FileHandle = CreateFile(HashContext->CacheFileName.StartOfString,
+                            GENERIC_READ,
+                            FILE_SHARE_READ | FILE_SHARE_DELETE,
+                            NULL,
+                            OPEN_EXISTING,
+                            FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
+                            NULL);
+
+    if (FileHandle == INVALID_HANDLE_VALUE) {
+        if (GetLastError() == ERROR_FILE_NOT_FOUND) {
+            return TRUE;
+        }
+        return FALSE;
+    }
+
+    if (!GetFileSizeEx(FileHandle, &FileSize) ||
+        !YoriLibIsSizeAllocatable(FileSize.QuadPart)) {
+
+        CloseHandle(FileHandle);
+        return FALSE;
+    }
+
+    Buffer = YoriLibMalloc((YORI_ALLOC_SIZE_T)FileSize.QuadPart);
+    if (Buffer == NULL) {
+        CloseHandle(FileHandle);
+        return FALSE;
+    }
+
+    if (!ReadFile(FileHandle, Buffer, (DWORD)FileSize.QuadPart, &BytesRead, NULL) ||
+        BytesRead != (DWORD)FileSize.QuadPart) {
+
+        YoriLibFree(Buffer);
+        CloseHandle(FileHandle);
+        return FALSE;
+    }
+
+    CloseHandle(FileHandle);
+
+    //
+    //  A cache from a different version, or a damaged cache, is discarded
+    //  and rebuilt.
+    //
+
+    Result = TRUE;
+    if (BytesRead >= sizeof(Header)) {
+        memcpy(&Header, Buffer, sizeof(Header));
+        if (Header.Signature == HASH_CACHE_SIGNATURE &&
+            Header.Version == HASH_CACHE_VERSION) {
+
+            Offset = sizeof(Header);
+            for (Index = 0; Index < Header.EntryCount; Index++) {
+                if (BytesRead - Offset < sizeof(Record)) {
+                    break;
+                }
+                memcpy(&Record, &Buffer[Offset], sizeof(Record));
+                Offset = Offset + sizeof(Record);
+                if (BytesRead - Offset < Record.HashLength) {
+                    break;
+                }
+                if (!HashCacheUpdate(HashContext, &Record, &Buffer[Offset])) {
+                    Result = FALSE;
+                    break;
+                }
+                Offset = Offset + Record.HashLength;
+            }
+        }
+    }
+
+    HashContext->CacheModified = FALSE;
+    YoriLibFree(Buffer);
+    return Result;
+}
+
+/**
+ Write the contents of the cache to the cache file, if any entries have
+ changed since it was loaded.
+
+ @param HashContext Pointer to the hash context, where CacheFileName
+        specifies the file to write.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+HashCacheSave(
+    __in PHASH_CONTEXT HashContext
+    )
+{
+    HANDLE FileHandle;
+    PUCHAR Buffer;
+    DWORD BytesWritten;
+    YORI_MAX_UNSIGNED_T BytesNeeded;
+    YORI_ALLOC_SIZE_T Offset;
+    HASH_CACHE_FILE_HEADER Header;
+    PYORI_LIST_ENTRY ListEntry;
+    PHASH_CACHE_ENTRY CacheEntry;
+    BOOL Result;
+
+    if (HashContext->CacheTable == NULL || !HashContext->CacheModified) {
+        return TRUE;
+    }
+
+    Header.Signature = HASH_CACHE_SIGNATURE;
+    Header.Version = HASH_CACHE_VERSION;
+    Header.EntryCount = 0;
+    BytesNeeded = sizeof(Header);
+
+    ListEntry = YoriLibGetNextListEntry(&HashContext->CacheList, NULL);
+    while (ListEntry != NULL) {
+        CacheEntry = CONTAINING_RECORD(ListEntry, HASH_CACHE_ENTRY, ListEntry);
+        Header.EntryCount++;
+        BytesNeeded = BytesNeeded + sizeof(HASH_CACHE_RECORD) + CacheEntry->Record.HashLength;
+        ListEntry = YoriLibGetNextListEntry(&HashContext->CacheList, ListEntry);
+    }
+
+    if (!YoriLibIsSizeAllocatable(BytesNeeded)) {
+        return FALSE;
+    }
+
+    Buffer = YoriLibMalloc((YORI_ALLOC_SIZE_T)BytesNeeded);
+    if (Buffer == NULL) {
+        return FALSE;
+    }
+
+    memcpy(Buffer, &Header, sizeof(Header));
+    Offset = sizeof(Header);
+
+    ListEntry = YoriLibGetNextListEntry(&HashContext->CacheList, NULL);
+    while (ListEntry != NULL) {
+        CacheEntry = CONTAINING_RECORD(ListEntry, HASH_CACHE_ENTRY, ListEntry);
+        memcpy(&Buffer[Offset], &CacheEntry->Record, sizeof(HASH_CACHE_RECORD));
+        Offset = Offset + sizeof(HASH_CACHE_RECORD);
+        memcpy(&Buffer[Offset], CacheEntry->Hash, CacheEntry->Record.HashLength);
+        Offset = Offset + CacheEntry->Record.HashLength;
+        ListEntry = YoriLibGetNextListEntry(&HashContext->CacheList, ListEntry);
+    }
+
+    FileHandle = CreateFile(HashContext->CacheFileName.StartOfString,
+                            GENERIC_WRITE,
+                            0,
+                            NULL,
+                            CREATE_ALWAYS,
+                            FILE_ATTRIBUTE_NORMAL,
+                            NULL);
+
+    if (FileHandle == INVALID_HANDLE_VALUE) {
+        YoriLibFree(Buffer);
+        return FALSE;
+    }
+
+    Result = TRUE;
+    if (!WriteFile(FileHandle, Buffer, Offset, &BytesWritten, NULL) ||
+        BytesWritten != Offset) {
+
+        Result = FALSE;
+    }
+
+    CloseHandle(FileHandle);
+    YoriLibFree(Buffer);
+    if (Result) {
+        HashContext->CacheModified = FALSE;
+    }
+    return Result;
+}
+
+/**
+ Free all entries in the cache.
+
+ @param HashContext Pointer to the hash context.
+ */
+VOID
+HashCacheCleanup(
+    __in PHASH_CONTEXT HashContext
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PHASH_CACHE_ENTRY CacheEntry;
+
+    if (HashContext->CacheTable == NULL) {
+        return;
+    }
+
+    ListEntry = YoriLibGetNextListEntry(&HashContext->CacheList, NULL);
+    while (ListEntry != NULL) {
+        CacheEntry = CONTAINING_RECORD(ListEntry, HASH_CACHE_ENTRY, ListEntry);
+        ListEntry = YoriLibGetNextListEntry(&HashContext->CacheList, ListEntry);
+        YoriLibRemoveListItem(&CacheEntry->ListEntry);
+        YoriLibHashRemoveByEntry(&CacheEntry->HashEntry);
+        YoriLibFree(CacheEntry);
+    }
+
+    YoriLibFreeEmptyHashTable(HashContext->CacheTable);
+    HashContext->CacheTable = NULL;
+}
+
+/**
+ Complete a hash calculation and convert the result into a string.
+
+ @param HashContext Pointer to a context describing the actions to perform.
+
+ @param Worker Pointer to the worker state containing a buffer for the
+        result.
+
+ @param hHash Handle to the hash object.
+
+ @param HashString On successful completion, populated with the hash in
+        hex form.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+HashFinalize(
+    __in PHASH_CONTEXT HashContext,
+    __in PHASH_WORKER Worker,
+    __in DWORD_PTR hHash,
+    __inout PYORI_STRING HashString
+    )
+{
+    DWORD HashLength;
 
-    /**
-     Records the total number of files processed.
-     */
-    LONGLONG FilesFound;
+    HashLength = HashContext->HashLength;
+    if (!DllAdvApi32.pCryptGetHashParam(hHash, HP_HASHVAL, Worker->HashBuffer, &HashLength, 0)) {
+        return FALSE;
+    }
 
-    /**
-     Records the total number of files processed within a single command line
-     argument.
-     */
-    LONGLONG FilesFoundThisArg;
+    if (!YoriLibHexBufferToString(Worker->HashBuffer, HashContext->HashLength, HashString)) {
+        return FALSE;
+    }
 
-} HASH_CONTEXT, *PHASH_CONTEXT;
+    return TRUE;
+}
 
 /**
- Take a single incoming stream and break it into pieces.
+ Take a single incoming stream and hash it.  This is used for streams which
+ may be pipes, so each read is performed synchronously.
 
  @param hSource A handle to the incoming stream, which may be a file or a
         pipe.
  
  @param HashContext Pointer to a context describing the actions to perform.
 
+ @param Worker Pointer to the worker state containing buffers to use.
+
+ @param HashString On successful completion, populated with the hash in
+        hex form.
+
  @return TRUE to indicate success, FALSE to indicate failure.
  */
 BOOL
 HashProcessStream(
     __in HANDLE hSource,
-    __in PHASH_CONTEXT HashContext
+    __in PHASH_CONTEXT HashContext,
+    __in PHASH_WORKER Worker,
+    __inout PYORI_STRING HashString
     )
 {
     DWORD Err;
     DWORD_PTR hHash;
     DWORD BytesRead;
 
-    HashContext->FilesFound++;
-    HashContext->FilesFoundThisArg++;
-
     if (!DllAdvApi32.pCryptCreateHash(HashContext->Provider, HashContext->Algorithm, 0, 0, &hHash)) {
         return FALSE;
     }
@@ -161,7 +877,7 @@ HashProcessStream(
 
     Err = ERROR_SUCCESS;
     while (TRUE) {
-        if (!ReadFile(hSource, HashContext->ReadBuffer, HashContext->ReadBufferLength, &BytesRead, NULL)) {
+        if (!ReadFile(hSource, Worker->ReadBuffer[0], HashContext->ReadBufferLength, &BytesRead, NULL)) {
             // MSFIX: Distinguish errors here better? EOF means success,
             // read error means hash is wrong.  Could be reading from a pipe
             // etc though
@@ -172,7 +888,7 @@ HashProcessStream(
             break;
         }
 
-        if (!DllAdvApi32.pCryptHashData(hHash, HashContext->ReadBuffer, BytesRead, 0)) {
+        if (!DllAdvApi32.pCryptHashData(hHash, Worker->ReadBuffer[0], BytesRead, 0)) {
             Err = GetLastError();
             break;
         }
@@ -180,12 +896,152 @@ HashProcessStream(
     }
 
     if (Err == ERROR_SUCCESS) {
-        DWORD HashLength;
-        HashLength = HashContext->HashLength;
-        if (DllAdvApi32.pCryptGetHashParam(hHash, HP_HASHVAL, HashContext->HashBuffer, &HashLength, 0)) {
-            if (!YoriLibHexBufferToString(HashContext->HashBuffer, HashContext->HashLength, &HashContext->HashString)) {
-                Err = !(ERROR_SUCCESS);
-            }
+        if (!HashFinalize(HashContext, Worker, hHash, HashString)) {
+            Err = !(ERROR_SUCCESS);
+        }
+    }
+
+    DllAdvApi32.pCryptDestroyHash(hHash);
+
+    if (Err != STATUS_SUCCESS) {
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ Issue an asynchronous read from a file into one of a worker's buffers.
+
+ @param hSource A handle to the file, opened for overlapped IO.
+
+ @param HashContext Pointer to a context describing the actions to perform.
+
+ @param Worker Pointer to the worker state containing buffers to use.
+
+ @param BufferIndex Specifies which of the worker's buffers to read into.
+
+ @param Offset Specifies the offset within the file to read from.
+
+ @return TRUE if the read was issued and its result should be collected
+         with GetOverlappedResult, FALSE if the read could not be issued,
+         including if the offset is at the end of the file.
+ */
+BOOL
+HashIssueRead(
+    __in HANDLE hSource,
+    __in PHASH_CONTEXT HashContext,
+    __in PHASH_WORKER Worker,
+    __in DWORD BufferIndex,
+    __in PLARGE_INTEGER Offset
+    )
+{
+    LPOVERLAPPED Overlapped;
+
+    Overlapped = &Worker->Overlapped[BufferIndex];
+    Overlapped->Internal = 0;
+    Overlapped->InternalHigh = 0;
+    Overlapped->Offset = Offset->LowPart;
+    Overlapped->OffsetHigh = Offset->HighPart;
+
+    if (ReadFile(hSource, Worker->ReadBuffer[BufferIndex], HashContext->ReadBufferLength, NULL, Overlapped)) {
+        return TRUE;
+    }
+
+    if (GetLastError() == ERROR_IO_PENDING) {
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+/**
+ Hash a single file.  The next read from the file is issued before hashing
+ the data from the previous read, so the hash calculation and IO proceed
+ concurrently.
+
+ @param hSource A handle to the file, opened for overlapped IO.
+
+ @param HashContext Pointer to a context describing the actions to perform.
+
+ @param Worker Pointer to the worker state containing buffers to use.
+
+ @param HashString On successful completion, populated with the hash in
+        hex form.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+HashProcessFile(
+    __in HANDLE hSource,
+    __in PHASH_CONTEXT HashContext,
+    __in PHASH_WORKER Worker,
+    __inout PYORI_STRING HashString
+    )
+{
+    DWORD Err;
+    DWORD_PTR hHash;
+    DWORD BytesRead;
+    DWORD Current;
+    DWORD Next;
+    LARGE_INTEGER Offset;
+    BOOL ReadPending[HASH_READ_BUFFERS];
+
+    if (!DllAdvApi32.pCryptCreateHash(HashContext->Provider, HashContext->Algorithm, 0, 0, &hHash)) {
+        return FALSE;
+    }
+
+    Err = ERROR_SUCCESS;
+    Offset.QuadPart = 0;
+    Current = 0;
+    for (Next = 0; Next < HASH_READ_BUFFERS; Next++) {
+        ReadPending[Next] = FALSE;
+    }
+
+    ReadPending[Current] = HashIssueRead(hSource, HashContext, Worker, Current, &Offset);
+
+    while (ReadPending[Current]) {
+        ReadPending[Current] = FALSE;
+
+        //
+        //  As with streams, a read failure including reaching the end of
+        //  the file terminates the hash.
+        //
+
+        if (!GetOverlappedResult(hSource, &Worker->Overlapped[Current], &BytesRead, TRUE)) {
+            break;
+        }
+
+        if (BytesRead == 0) {
+            break;
+        }
+
+        Offset.QuadPart = Offset.QuadPart + BytesRead;
+        Next = (Current + 1) % HASH_READ_BUFFERS;
+        ReadPending[Next] = HashIssueRead(hSource, HashContext, Worker, Next, &Offset);
+
+        if (!DllAdvApi32.pCryptHashData(hHash, Worker->ReadBuffer[Current], BytesRead, 0)) {
+            Err = GetLastError();
+            break;
+        }
+
+        Current = Next;
+    }
+
+    //
+    //  Wait for any read that is still outstanding, since the buffer will
+    //  be reused for the next file.
+    //
+
+    for (Next = 0; Next < HASH_READ_BUFFERS; Next++) {
+        if (ReadPending[Next]) {
+            GetOverlappedResult(hSource, &Worker->Overlapped[Next], &BytesRead, TRUE);
+        }
+    }
+
+    if (Err == ERROR_SUCCESS) {
+        if (!HashFinalize(HashContext, Worker, hHash, HashString)) {
+            Err = !(ERROR_SUCCESS);
         }
     }
 
@@ -198,6 +1054,195 @@ HashProcessStream(
     return TRUE;
 }
 
+/**
+ Hash a file that has been found by the main thread.  This is invoked on a
+ worker thread.
+
+ @param Context Pointer to the hash context.
+
+ @param WorkerContext Pointer to the worker state for this thread.
+
+ @param Item Pointer to the work queue item within the job to process.
+
+ @return TRUE to indicate the worker should continue processing jobs.
+ */
+BOOLEAN
+HashExecuteJob(
+    __in PVOID Context,
+    __in PVOID WorkerContext,
+    __in PYORILIB_WORK_ITEM Item
+    )
+{
+    PHASH_CONTEXT HashContext;
+    PHASH_WORKER Worker;
+    PHASH_JOB Job;
+
+    HashContext = (PHASH_CONTEXT)Context;
+    Worker = (PHASH_WORKER)WorkerContext;
+    Job = CONTAINING_RECORD(Item, HASH_JOB, WorkItem);
+
+    Job->Succeeded = (BOOLEAN)HashProcessFile(Job->FileHandle, HashContext, Worker, &Job->HashString);
+    if (Job->Succeeded) {
+        memcpy(Job->Hash, Worker->HashBuffer, HashContext->HashLength);
+    }
+    CloseHandle(Job->FileHandle);
+    Job->FileHandle = NULL;
+
+    return TRUE;
+}
+
+/**
+ Display the result of a job which has been completed by a worker thread.
+ This is invoked on the main thread in the order the files were found.
+
+ @param Context Pointer to the hash context.
+
+ @param Item Pointer to the work queue item within the completed job.  The
+        job is freed by this function.
+ */
+VOID
+HashCompleteJob(
+    __in PVOID Context,
+    __in PYORILIB_WORK_ITEM Item
+    )
+{
+    PHASH_CONTEXT HashContext;
+    PHASH_JOB Job;
+
+    HashContext = (PHASH_CONTEXT)Context;
+    Job = CONTAINING_RECORD(Item, HASH_JOB, WorkItem);
+
+    if (Job->Succeeded) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y %y\n"), &Job->HashString, &Job->RelativePath);
+        if (Job->UpdateCache) {
+            HashCacheUpdate(HashContext, &Job->CacheRecord, Job->Hash);
+        }
+    }
+
+    if (Job->FileHandle != NULL) {
+        CloseHandle(Job->FileHandle);
+    }
+    YoriLibFree(Job);
+}
+
+/**
+ Display the results of jobs which have been completed by worker threads, in
+ the order the files were found, and wait for jobs to complete until no more
+ than a specified number remain outstanding.
+
+ @param HashContext Pointer to the hash context.
+
+ @param JobsToLeaveOutstanding The number of jobs which may remain incomplete
+        when this function returns.  Zero waits for all jobs to complete.
+ */
+VOID
+HashCompleteJobs(
+    __in PHASH_CONTEXT HashContext,
+    __in DWORD JobsToLeaveOutstanding
+    )
+{
+    if (HashContext->WorkQueue == NULL) {
+        return;
+    }
+
+    YoriLibWorkQueueComplete(HashContext->WorkQueue, JobsToLeaveOutstanding, INFINITE);
+}
+
+/**
+ Queue a file to be hashed by a worker thread.
+
+ @param HashContext Pointer to the hash context.
+
+ @param FileHandle A handle to the file to hash.  On success, the job owns
+        this handle and will close it.
+
+ @param RelativePath Pointer to the path to display for the file.
+
+ @param CacheRecord If specified, information about the file used to update
+        the hash cache when the hash is calculated.
+
+ @param CacheEntry If specified, a previously calculated hash for the file
+        which is still valid.  The file is not read and this hash is
+        displayed once preceding jobs have completed.
+
+ @return TRUE to indicate the job was queued, FALSE if it could not be.
+ */
+BOOL
+HashQueueFile(
+    __in PHASH_CONTEXT HashContext,
+    __in HANDLE FileHandle,
+    __in PYORI_STRING RelativePath,
+    __in_opt PHASH_CACHE_RECORD CacheRecord,
+    __in_opt PHASH_CACHE_ENTRY CacheEntry
+    )
+{
+    PHASH_JOB Job;
+    YORI_MAX_UNSIGNED_T BytesNeeded;
+
+    BytesNeeded = sizeof(HASH_JOB);
+    BytesNeeded += ((YORI_MAX_UNSIGNED_T)RelativePath->LengthInChars + 1) * sizeof(TCHAR);
+    BytesNeeded += ((YORI_MAX_UNSIGNED_T)HashContext->HashLength * 2 + 1) * sizeof(TCHAR);
+    BytesNeeded += HashContext->HashLength;
+
+    if (!YoriLibIsSizeAllocatable(BytesNeeded)) {
+        return FALSE;
+    }
+
+    Job = YoriLibMalloc((YORI_ALLOC_SIZE_T)BytesNeeded);
+    if (Job == NULL) {
+        return FALSE;
+    }
+
+    YoriLibWorkQueueInitializeItem(&Job->WorkItem);
+    Job->FileHandle = FileHandle;
+    Job->Succeeded = FALSE;
+
+    YoriLibInitEmptyString(&Job->RelativePath);
+    Job->RelativePath.StartOfString = (LPTSTR)(Job + 1);
+    Job->RelativePath.LengthAllocated = RelativePath->LengthInChars + 1;
+    memcpy(Job->RelativePath.StartOfString, RelativePath->StartOfString, RelativePath->LengthInChars * sizeof(TCHAR));
+    Job->RelativePath.LengthInChars = RelativePath->LengthInChars;
+    Job->RelativePath.StartOfString[Job->RelativePath.LengthInChars] = '\0';
+
+    YoriLibInitEmptyString(&Job->HashString);
+    Job->HashString.StartOfString = Job->RelativePath.StartOfString + Job->RelativePath.LengthAllocated;
+    Job->HashString.LengthAllocated = HashContext->HashLength * 2 + 1;
+
+    Job->Hash = (PUCHAR)(Job->HashString.StartOfString + Job->HashString.LengthAllocated);
+    Job->UpdateCache = FALSE;
+    if (CacheRecord != NULL) {
+        memcpy(&Job->CacheRecord, CacheRecord, sizeof(HASH_CACHE_RECORD));
+        Job->UpdateCache = TRUE;
+    }
+
+    //
+    //  If the hash is already known, the job is complete but still needs
+    //  to be displayed in order.
+    //
+
+    if (CacheEntry != NULL) {
+        if (!YoriLibHexBufferToString(CacheEntry->Hash, HashContext->HashLength, &Job->HashString)) {
+            YoriLibFree(Job);
+            return FALSE;
+        }
+        CloseHandle(FileHandle);
+        Job->FileHandle = NULL;
+        Job->UpdateCache = FALSE;
+        Job->Succeeded = TRUE;
+        Job->WorkItem.Complete = TRUE;
+    }
+
+    YoriLibWorkQueueSubmit(HashContext->WorkQueue, &Job->WorkItem);
+
+    //
+    //  Display anything that has completed, and limit the amount of work
+    //  that is queued so results are displayed promptly.
+    //
+
+    HashCompleteJobs(HashContext, HashContext->WorkerCount * 4);
+    return TRUE;
+}
+
 /**
  A callback that is invoked when a file is found within the tree root whose
  hash is requested.
@@ -226,6 +1271,9 @@ HashFileFoundCallback(
     HANDLE FileHandle;
     YORI_ALLOC_SIZE_T SlashesFound;
     YORI_ALLOC_SIZE_T Index;
+    HASH_CACHE_RECORD CacheRecord;
+    PHASH_CACHE_RECORD CacheRecordPtr;
+    PHASH_CACHE_ENTRY CacheEntry;
 
     UNREFERENCED_PARAMETER(FileInfo);
 
@@ -254,7 +1302,7 @@ HashFileFoundCallback(
                             FILE_SHARE_READ | FILE_SHARE_DELETE,
                             NULL,
                             OPEN_EXISTING,
-                            FILE_ATTRIBUTE_NORMAL | FILE_FLAG_BACKUP_SEMANTICS,
+                            FILE_ATTRIBUTE_NORMAL | FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED | FILE_FLAG_SEQUENTIAL_SCAN,
                             NULL);
 
     if (FileHandle == NULL || FileHandle == INVALID_HANDLE_VALUE) {
@@ -268,9 +1316,41 @@ HashFileFoundCallback(
     }
 
     HashContext->SavedErrorThisArg = ERROR_SUCCESS;
+    HashContext->FilesFound++;
+    HashContext->FilesFoundThisArg++;
+
+    CacheRecordPtr = NULL;
+    CacheEntry = NULL;
+    if (HashContext->CacheTable != NULL &&
+        HashCacheQueryFile(HashContext, FileHandle, &CacheRecord)) {
 
-    if (HashProcessStream(FileHandle, HashContext)) {
+        CacheRecordPtr = &CacheRecord;
+        CacheEntry = HashCacheLookup(HashContext, &CacheRecord);
+    }
+
+    if (HashContext->WorkerCount > 1 &&
+        HashQueueFile(HashContext, FileHandle, &RelativePathFrom, CacheRecordPtr, CacheEntry)) {
+
+        return TRUE;
+    }
+
+    //
+    //  If there is only one worker, or the file could not be queued, hash
+    //  it on this thread, after displaying the results of anything queued
+    //  previously.  Once all jobs are complete, worker threads are idle
+    //  so the first worker's buffers can be used here.
+    //
+
+    HashCompleteJobs(HashContext, 0);
+    if (CacheEntry != NULL) {
+        if (YoriLibHexBufferToString(CacheEntry->Hash, HashContext->HashLength, &HashContext->HashString)) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y %y\n"), &HashContext->HashString, &RelativePathFrom);
+        }
+    } else if (HashProcessFile(FileHandle, HashContext, &HashContext->Workers[0], &HashContext->HashString)) {
         YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y %y\n"), &HashContext->HashString, &RelativePathFrom);
+        if (CacheRecordPtr != NULL) {
+            HashCacheUpdate(HashContext, CacheRecordPtr, HashContext->Workers[0].HashBuffer);
+        }
     }
 
     CloseHandle(FileHandle);
@@ -290,18 +1370,47 @@ HashCleanupContext(
     )
 {
     BOOL Result;
+    DWORD Index;
+    DWORD BufferIndex;
+    PHASH_WORKER Worker;
 
-    if (HashContext->HashBuffer != NULL) {
-        YoriLibFree(HashContext->HashBuffer);
-        HashContext->HashBuffer = NULL;
+    //
+    //  Display anything outstanding and wait for worker threads to exit
+    //  before freeing their buffers.
+    //
+
+    if (HashContext->WorkQueue != NULL) {
+        YoriLibWorkQueueDestroy(HashContext->WorkQueue);
+        HashContext->WorkQueue = NULL;
     }
 
-    if (HashContext->ReadBuffer != NULL) {
-        YoriLibFree(HashContext->ReadBuffer);
-        HashContext->ReadBuffer = NULL;
+    if (HashContext->Workers != NULL) {
+        for (Index = 0; Index < HashContext->WorkerCount; Index++) {
+            Worker = &HashContext->Workers[Index];
+            if (Worker->HashBuffer != NULL) {
+                YoriLibFree(Worker->HashBuffer);
+                Worker->HashBuffer = NULL;
+            }
+
+            for (BufferIndex = 0; BufferIndex < HASH_READ_BUFFERS; BufferIndex++) {
+                if (Worker->ReadBuffer[BufferIndex] != NULL) {
+                    YoriLibFree(Worker->ReadBuffer[BufferIndex]);
+                    Worker->ReadBuffer[BufferIndex] = NULL;
+                }
+                if (Worker->Overlapped[BufferIndex].hEvent != NULL) {
+                    CloseHandle(Worker->Overlapped[BufferIndex].hEvent);
+                    Worker->Overlapped[BufferIndex].hEvent = NULL;
+                }
+            }
+        }
+
+        YoriLibFree(HashContext->Workers);
+        HashContext->Workers = NULL;
     }
 
     YoriLibFreeStringContents(&HashContext->HashString);
+    HashCacheCleanup(HashContext);
+    YoriLibFreeStringContents(&HashContext->CacheFileName);
 
     if (HashContext->Provider != 0) {
         Result = DllAdvApi32.pCryptReleaseContext(HashContext->Provider, 0);
@@ -365,7 +1474,9 @@ HashInitializeContext(
     DWORD LastError;
     LPTSTR ErrText;
     DWORD Index;
+    DWORD BufferIndex;
     DWORD HashLength;
+    PHASH_WORKER Worker;
 
     LastError = ERROR_SUCCESS;
 
@@ -443,24 +1554,72 @@ HashInitializeContext(
 
     HashContext->Algorithm = Algorithm;
 
-    HashContext->HashBuffer = YoriLibMalloc(HashContext->HashLength);
-    if (HashContext->HashBuffer == NULL) {
+    if (!YoriLibAllocateString(&HashContext->HashString, HashContext->HashLength * 2 + 1)) {
         HashCleanupContext(HashContext);
         return FALSE;
     }
 
-    if (!YoriLibAllocateString(&HashContext->HashString, HashContext->HashLength * 2 + 1)) {
-        HashCleanupContext(HashContext);
-        return FALSE;
+    //
+    //  Each worker has its own buffers, so when many workers are active,
+    //  use smaller buffers.
+    //
+
+    if (HashContext->WorkerCount == 0) {
+        HashContext->WorkerCount = 1;
     }
 
-    HashContext->ReadBufferLength = YoriLibMaximumAllocationInRange(60 * 1024, 1024 * 1024);
+    if (HashContext->WorkerCount > 1) {
+        HashContext->ReadBufferLength = YoriLibMaximumAllocationInRange(60 * 1024, 256 * 1024);
+    } else {
+        HashContext->ReadBufferLength = YoriLibMaximumAllocationInRange(60 * 1024, 1024 * 1024);
+    }
 
-    HashContext->ReadBuffer = YoriLibMalloc(HashContext->ReadBufferLength);
-    if (HashContext->ReadBuffer == NULL) {
+    HashContext->Workers = YoriLibMalloc((YORI_ALLOC_SIZE_T)(HashContext->WorkerCount * sizeof(HASH_WORKER)));
+    if (HashContext->Workers == NULL) {
+        HashContext->WorkerCount = 0;
         HashCleanupContext(HashContext);
         return FALSE;
     }
+    ZeroMemory(HashContext->Workers, HashContext->WorkerCount * sizeof(HASH_WORKER));
+
+    for (Index = 0; Index < HashContext->WorkerCount; Index++) {
+        Worker = &HashContext->Workers[Index];
+        Worker->HashContext = HashContext;
+        Worker->HashBuffer = YoriLibMalloc(HashContext->HashLength);
+        if (Worker->HashBuffer == NULL) {
+            HashCleanupContext(HashContext);
+            return FALSE;
+        }
+
+        for (BufferIndex = 0; BufferIndex < HASH_READ_BUFFERS; BufferIndex++) {
+            Worker->ReadBuffer[BufferIndex] = YoriLibMalloc(HashContext->ReadBufferLength);
+            if (Worker->ReadBuffer[BufferIndex] == NULL) {
+                HashCleanupContext(HashContext);
+                return FALSE;
+            }
+
+            Worker->Overlapped[BufferIndex].hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+            if (Worker->Overlapped[BufferIndex].hEvent == NULL) {
+                HashCleanupContext(HashContext);
+                return FALSE;
+            }
+        }
+    }
+
+    if (HashContext->WorkerCount > 1) {
+        HashContext->WorkQueue = YoriLibWorkQueueCreate(YORILIB_WORK_QUEUE_KEEP_ORDER, 1, HashExecuteJob, HashCompleteJob, HashContext);
+        if (HashContext->WorkQueue == NULL) {
+            HashCleanupContext(HashContext);
+            return FALSE;
+        }
+
+        for (Index = 0; Index < HashContext->WorkerCount; Index++) {
+            if (!YoriLibWorkQueueAddWorker(HashContext->WorkQueue, &HashContext->Workers[Index])) {
+                HashCleanupContext(HashContext);
+                return FALSE;
+            }
+        }
+    }
 
     return TRUE;
 }
@@ -574,9 +1733,11 @@ ENTRYPOINT(
 
             if (YoriLibCompareStringLitIns(&Arg, _T("?")) == 0) {
                 HashHelp();
+                YoriLibFreeStringContents(&HashContext.CacheFileName);
                 return EXIT_SUCCESS;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("license")) == 0) {
                 YoriLibDisplayMitLicense(_T("2019-2021"));
+                YoriLibFreeStringContents(&HashContext.CacheFileName);
                 return EXIT_SUCCESS;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("a")) == 0) {
                 if (i + 1 < ArgC) {
@@ -606,12 +1767,38 @@ ENTRYPOINT(
                         Algorithm = CALG_SHA_512;
                     } else {
                         YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("hash: algorithm not recognized.  Supported algorithms are MD4, MD5, SHA1, SHA256, SHA384, and SHA512\n"));
+                        YoriLibFreeStringContents(&HashContext.CacheFileName);
                         return EXIT_FAILURE;
                     }
                 }
             } else if (YoriLibCompareStringLitIns(&Arg, _T("b")) == 0) {
                 BasicEnumeration = TRUE;
                 ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("c")) == 0) {
+                if (ArgC > i + 1) {
+                    YoriLibFreeStringContents(&HashContext.CacheFileName);
+                    if (YoriLibUserStringToSingleFilePath(&ArgV[i + 1], TRUE, &HashContext.CacheFileName)) {
+                        ArgumentUnderstood = TRUE;
+                        i++;
+                    }
+                }
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("j")) == 0) {
+                if (ArgC > i + 1) {
+                    YORI_ALLOC_SIZE_T CharsConsumed;
+                    YORI_MAX_SIGNED_T llTemp;
+                    if (YoriLibStringToNumber(&ArgV[i + 1], TRUE, &llTemp, &CharsConsumed) &&
+                        CharsConsumed > 0) {
+
+                        if (llTemp < 1) {
+                            llTemp = 1;
+                        } else if (llTemp > HASH_MAX_WORKERS) {
+                            llTemp = HASH_MAX_WORKERS;
+                        }
+                        HashContext.WorkerCount = (DWORD)llTemp;
+                        ArgumentUnderstood = TRUE;
+                        i++;
+                    }
+                }
             } else if (YoriLibCompareStringLitIns(&Arg, _T("s")) == 0) {
                 HashContext.Recursive = TRUE;
                 ArgumentUnderstood = TRUE;
@@ -640,6 +1827,7 @@ ENTRYPOINT(
         DllAdvApi32.pCryptReleaseContext == NULL) {
 
         YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("hash: operating system support not present\n"));
+        YoriLibFreeStringContents(&HashContext.CacheFileName);
         return EXIT_FAILURE;
     }
 
@@ -647,6 +1835,14 @@ ENTRYPOINT(
         return EXIT_FAILURE;
     }
 
+    if (HashContext.CacheFileName.LengthInChars > 0 &&
+        !HashCacheLoad(&HashContext)) {
+
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("hash: could not load cache %y\n"), &HashContext.CacheFileName);
+        HashCleanupContext(&HashContext);
+        return EXIT_FAILURE;
+    }
+
 #if YORI_BUILTIN
     YoriLibCancelEnable(FALSE);
 #endif
@@ -670,10 +1866,11 @@ ENTRYPOINT(
             return EXIT_FAILURE;
         }
 
-        if (!HashProcessStream(GetStdHandle(STD_INPUT_HANDLE), &HashContext)) {
+        if (!HashProcessStream(GetStdHandle(STD_INPUT_HANDLE), &HashContext, &HashContext.Workers[0], &HashContext.HashString)) {
             HashCleanupContext(&HashContext);
             return EXIT_FAILURE;
         }
+        HashContext.FilesFound++;
         YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y\n"), &HashContext.HashString);
     } else {
         MatchFlags = YORILIB_FILEENUM_RETURN_FILES | YORILIB_FILEENUM_DIRECTORY_CONTENTS;
@@ -707,6 +1904,12 @@ ENTRYPOINT(
                     YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("File or directory not found: %y\n"), &ArgV[i]);
                 }
             }
+
+            HashCompleteJobs(&HashContext, 0);
+        }
+
+        if (!HashCacheSave(&HashContext)) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("hash: could not save cache %y\n"), &HashContext.CacheFileName);
         }
     }
 
@@ -110,6 +110,7 @@ CHAR strHelpHelpText2[] =
         "FG        Display the output of a background job in the foreground\n"
         "FOR       Enumerates through a list of strings or files\n"
         "FSCMP     Test for file system conditions\n"
+        "GITSTAT   Display the status of a git repository without executing git\n"
         "FTYPE     Display or edit file types used in file associations\n"
         "GET       Fetches objects from HTTP and stores them in local files\n"
         "GRPCMP    Returns true if the user is a member of the specified group\n"
@@ -172,6 +173,7 @@ CHAR strHelpHelpText4[] =
         "SHUTDN    Shutdown, reboot or logoff the system\n"
         "SLEEP     Waits for a specified number of seconds\n"
         "SLMENU    Display a menu of items from input and output the user selection\n"
+        "SORT      Sort lines of text\n"
         "SPEAK     Output text as speech\n"
         "SPLIT     Split a file into pieces\n"
         "SPONGE    Read input into memory then output, allowing rewrite of input\n"
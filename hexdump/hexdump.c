@@ -37,12 +37,13 @@ CHAR strHexDumpHelpText[] =
         "\n"
         "Output the contents of one or more files in hex.\n"
         "\n"
-        "HEXDUMP [-license] [-b] [-d] [-g1|-g2|-g4|-g8|-i] [-hc] [-ho]\n"
+        "HEXDUMP [-license] [-b] [-d|-dr] [-g1|-g2|-g4|-g8|-i] [-hc] [-ho]\n"
         "        [-l length] [-o offset] [-bin|-r] [-s] [-w] [<file>...]\n"
         "\n"
         "   -b             Use basic search criteria for files only\n"
         "   -bin           Process a stream of hex back into binary\n"
         "   -d             Display the differences between two files\n"
+        "   -dr            Display the ranges that differ between two files\n"
         "   -g             Number of bytes per display group\n"
         "   -hc            Hide character display\n"
         "   -ho            Hide offset within buffer\n"
@@ -134,6 +135,56 @@ typedef struct _HEXDUMP_CONTEXT {
 
 } HEXDUMP_CONTEXT, *PHEXDUMP_CONTEXT;
 
+/**
+ The value of each hex digit in the ASCII range, indexed by character.
+ Characters that are not hex digits have the value 0xFF.
+ */
+CONST UCHAR HexDumpDigitValues[128] = {
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff
+};
+
+/**
+ Convert two hex digits into the byte they describe.
+
+ @param String Pointer to the first of two characters to convert.
+
+ @param Value On successful completion, updated to contain the byte value.
+
+ @return TRUE if both characters are hex digits, FALSE if not.
+ */
+__success(return)
+BOOLEAN
+HexDumpParseHexByte(
+    __in_ecount(2) CONST TCHAR * String,
+    __out PUCHAR Value
+    )
+{
+    UCHAR High;
+    UCHAR Low;
+
+    if ((DWORD)String[0] >= sizeof(HexDumpDigitValues) ||
+        (DWORD)String[1] >= sizeof(HexDumpDigitValues)) {
+
+        return FALSE;
+    }
+
+    High = HexDumpDigitValues[String[0]];
+    Low = HexDumpDigitValues[String[1]];
+    if ((High | Low) & 0xF0) {
+        return FALSE;
+    }
+
+    *Value = (UCHAR)((High << 4) | Low);
+    return TRUE;
+}
+
 /**
  Check if a character is a valid hex digit.
 
@@ -399,29 +450,14 @@ HexDumpReverseParseByte(
     )
 {
     UCHAR Value = 0;
-    UCHAR ThisByte = 0;
-    TCHAR SourceChar;
-    DWORD BytePart;
 
     if (String->LengthInChars < (YORI_ALLOC_SIZE_T)ReverseContext->BytesPerWord * 2) {
         return FALSE;
     }
 
-    ThisByte = 0;
-    for (BytePart = 0; BytePart < 2; BytePart++) {
-        ThisByte = (UCHAR)(ThisByte << 4);
-        SourceChar = String->StartOfString[BytePart];
-        if (SourceChar >= 'a' && SourceChar <= 'f') {
-            ThisByte = (UCHAR)(ThisByte + SourceChar - 'a' + 10);
-        } else if (SourceChar >= 'A' && SourceChar <= 'F') {
-            ThisByte = (UCHAR)(ThisByte + SourceChar - 'A' + 10);
-        } else if (SourceChar >= '0' && SourceChar <= '9') {
-            ThisByte = (UCHAR)(ThisByte + SourceChar - '0');
-        } else {
-            return FALSE;
-        }
+    if (!HexDumpParseHexByte(String->StartOfString, &Value)) {
+        return FALSE;
     }
-    Value = ThisByte;
 
     ASSERT(ReverseContext->BytesThisLine + sizeof(Value) <= ReverseContext->BytesAllocated);
     memcpy(&ReverseContext->OutputBuffer[ReverseContext->BytesThisLine], &Value, sizeof(Value));
@@ -448,9 +484,7 @@ HexDumpReverseParseWord(
 {
     WORD Value = 0;
     UCHAR ThisByte = 0;
-    TCHAR SourceChar;
     DWORD Index;
-    DWORD BytePart;
 
     if (String->LengthInChars < (YORI_ALLOC_SIZE_T)ReverseContext->BytesPerWord * 2) {
         return FALSE;
@@ -458,19 +492,8 @@ HexDumpReverseParseWord(
 
     for (Index = 0; Index < ReverseContext->BytesPerWord; Index++) {
         Value = (WORD)(Value << 8);
-        ThisByte = 0;
-        for (BytePart = 0; BytePart < 2; BytePart++) {
-            ThisByte = (UCHAR)(ThisByte << 4);
-            SourceChar = String->StartOfString[Index * 2 + BytePart];
-            if (SourceChar >= 'a' && SourceChar <= 'f') {
-                ThisByte = (UCHAR)(ThisByte + SourceChar - 'a' + 10);
-            } else if (SourceChar >= 'A' && SourceChar <= 'F') {
-                ThisByte = (UCHAR)(ThisByte + SourceChar - 'A' + 10);
-            } else if (SourceChar >= '0' && SourceChar <= '9') {
-                ThisByte = (UCHAR)(ThisByte + SourceChar - '0');
-            } else {
-                return FALSE;
-            }
+        if (!HexDumpParseHexByte(&String->StartOfString[Index * 2], &ThisByte)) {
+            return FALSE;
         }
         Value = (WORD)(Value | ThisByte);
     }
@@ -500,9 +523,7 @@ HexDumpReverseParseDword(
 {
     DWORD Value = 0;
     UCHAR ThisByte = 0;
-    TCHAR SourceChar;
     DWORD Index;
-    DWORD BytePart;
 
     if (String->LengthInChars < (YORI_ALLOC_SIZE_T)ReverseContext->BytesPerWord * 2) {
         return FALSE;
@@ -510,19 +531,8 @@ HexDumpReverseParseDword(
 
     for (Index = 0; Index < ReverseContext->BytesPerWord; Index++) {
         Value = Value << 8;
-        ThisByte = 0;
-        for (BytePart = 0; BytePart < 2; BytePart++) {
-            ThisByte = (UCHAR)(ThisByte << 4);
-            SourceChar = String->StartOfString[Index * 2 + BytePart];
-            if (SourceChar >= 'a' && SourceChar <= 'f') {
-                ThisByte = (UCHAR)(ThisByte + SourceChar - 'a' + 10);
-            } else if (SourceChar >= 'A' && SourceChar <= 'F') {
-                ThisByte = (UCHAR)(ThisByte + SourceChar - 'A' + 10);
-            } else if (SourceChar >= '0' && SourceChar <= '9') {
-                ThisByte = (UCHAR)(ThisByte + SourceChar - '0');
-            } else {
-                return FALSE;
-            }
+        if (!HexDumpParseHexByte(&String->StartOfString[Index * 2], &ThisByte)) {
+            return FALSE;
         }
         Value = Value | ThisByte;
     }
@@ -552,9 +562,7 @@ HexDumpReverseParseDwordLong(
 {
     DWORDLONG Value = 0;
     UCHAR ThisByte = 0;
-    TCHAR SourceChar;
     UCHAR Index;
-    UCHAR BytePart;
     UCHAR ByteShift = 0;
 
     if (String->LengthInChars < (YORI_ALLOC_SIZE_T)ReverseContext->BytesPerWord * 2) {
@@ -567,19 +575,8 @@ HexDumpReverseParseDwordLong(
             continue;
         }
         Value = Value << 8;
-        ThisByte = 0;
-        for (BytePart = 0; BytePart < 2; BytePart++) {
-            ThisByte = (UCHAR)(ThisByte << 4);
-            SourceChar = String->StartOfString[Index * 2 + BytePart - ByteShift];
-            if (SourceChar >= 'a' && SourceChar <= 'f') {
-                ThisByte = (UCHAR)(ThisByte + SourceChar - 'a' + 10);
-            } else if (SourceChar >= 'A' && SourceChar <= 'F') {
-                ThisByte = (UCHAR)(ThisByte + SourceChar - 'A' + 10);
-            } else if (SourceChar >= '0' && SourceChar <= '9') {
-                ThisByte = (UCHAR)(ThisByte + SourceChar - '0');
-            } else {
-                return FALSE;
-            }
+        if (!HexDumpParseHexByte(&String->StartOfString[Index * 2 - ByteShift], &ThisByte)) {
+            return FALSE;
         }
         Value = Value | ThisByte;
     }
@@ -672,6 +669,127 @@ HexDumpReverseParseLine(
     return TRUE;
 }
 
+/**
+ The number of bytes of binary output to accumulate before writing.
+ */
+#define HEXDUMP_OUTPUT_BUFFER_SIZE (64 * 1024)
+
+/**
+ A buffer of binary output, so that output generated from many lines of
+ input can be written at once.
+ */
+typedef struct _HEXDUMP_OUTPUT_BUFFER {
+
+    /**
+     The handle to write output to.
+     */
+    HANDLE OutputHandle;
+
+    /**
+     The buffer of pending output.  If allocation failed, this is NULL and
+     output is written as it is generated.
+     */
+    PUCHAR Buffer;
+
+    /**
+     The number of bytes in Buffer that contain pending output.
+     */
+    DWORD BytesFilled;
+} HEXDUMP_OUTPUT_BUFFER, *PHEXDUMP_OUTPUT_BUFFER;
+
+/**
+ Initialize an output buffer.
+
+ @param OutputBuffer Pointer to the output buffer to initialize.
+
+ @param OutputHandle The handle to write output to.
+ */
+VOID
+HexDumpInitializeOutputBuffer(
+    __out PHEXDUMP_OUTPUT_BUFFER OutputBuffer,
+    __in HANDLE OutputHandle
+    )
+{
+    OutputBuffer->OutputHandle = OutputHandle;
+    OutputBuffer->Buffer = YoriLibMalloc(HEXDUMP_OUTPUT_BUFFER_SIZE);
+    OutputBuffer->BytesFilled = 0;
+}
+
+/**
+ Write any pending output.
+
+ @param OutputBuffer Pointer to the output buffer.
+ */
+VOID
+HexDumpFlushOutputBuffer(
+    __inout PHEXDUMP_OUTPUT_BUFFER OutputBuffer
+    )
+{
+    DWORD BytesWritten;
+
+    if (OutputBuffer->BytesFilled > 0) {
+        WriteFile(OutputBuffer->OutputHandle, OutputBuffer->Buffer, OutputBuffer->BytesFilled, &BytesWritten, NULL);
+        OutputBuffer->BytesFilled = 0;
+    }
+}
+
+/**
+ Add data to an output buffer, writing pending output if the buffer is
+ full.
+
+ @param OutputBuffer Pointer to the output buffer.
+
+ @param Data Pointer to the data to output.
+
+ @param Length The number of bytes of data to output.
+ */
+VOID
+HexDumpWriteOutputBuffer(
+    __inout PHEXDUMP_OUTPUT_BUFFER OutputBuffer,
+    __in_ecount(Length) PUCHAR Data,
+    __in DWORD Length
+    )
+{
+    DWORD BytesWritten;
+
+    if (OutputBuffer->Buffer != NULL &&
+        Length <= HEXDUMP_OUTPUT_BUFFER_SIZE - OutputBuffer->BytesFilled) {
+
+        memcpy(&OutputBuffer->Buffer[OutputBuffer->BytesFilled], Data, Length);
+        OutputBuffer->BytesFilled = OutputBuffer->BytesFilled + Length;
+        return;
+    }
+
+    HexDumpFlushOutputBuffer(OutputBuffer);
+
+    if (OutputBuffer->Buffer != NULL &&
+        Length < HEXDUMP_OUTPUT_BUFFER_SIZE) {
+
+        memcpy(OutputBuffer->Buffer, Data, Length);
+        OutputBuffer->BytesFilled = Length;
+        return;
+    }
+
+    WriteFile(OutputBuffer->OutputHandle, Data, Length, &BytesWritten, NULL);
+}
+
+/**
+ Write any pending output and free an output buffer.
+
+ @param OutputBuffer Pointer to the output buffer.
+ */
+VOID
+HexDumpCleanupOutputBuffer(
+    __inout PHEXDUMP_OUTPUT_BUFFER OutputBuffer
+    )
+{
+    HexDumpFlushOutputBuffer(OutputBuffer);
+    if (OutputBuffer->Buffer != NULL) {
+        YoriLibFree(OutputBuffer->Buffer);
+        OutputBuffer->Buffer = NULL;
+    }
+}
+
 /**
  Convert a single stream of hex encoded input into binary output.  The format
  of the input is detected heuristically, but is expected to be one that can
@@ -694,8 +812,7 @@ HexDumpReverseProcessStream(
 {
     PVOID LineContext = NULL;
     YORI_STRING LineString;
-    HANDLE OutputHandle;
-    DWORD BytesWritten;
+    HEXDUMP_OUTPUT_BUFFER OutputBuffer;
     HEXDUMP_REVERSE_CONTEXT ReverseContext;
 
     YoriLibInitEmptyString(&LineString);
@@ -715,7 +832,7 @@ HexDumpReverseProcessStream(
 
     ReverseContext.OutputBuffer = ReverseContext.StaticOutputBuffer;
     ReverseContext.BytesAllocated = sizeof(ReverseContext.StaticOutputBuffer);
-    OutputHandle = GetStdHandle(STD_OUTPUT_HANDLE);
+    HexDumpInitializeOutputBuffer(&OutputBuffer, GetStdHandle(STD_OUTPUT_HANDLE));
 
     while (TRUE) {
 
@@ -723,13 +840,14 @@ HexDumpReverseProcessStream(
             break;
         }
 
-        WriteFile(OutputHandle, ReverseContext.OutputBuffer, ReverseContext.BytesThisLine, &BytesWritten, NULL);
+        HexDumpWriteOutputBuffer(&OutputBuffer, ReverseContext.OutputBuffer, ReverseContext.BytesThisLine);
 
         if (!YoriLibReadLineToString(&LineString, &LineContext, hSource)) {
             break;
         }
     }
 
+    HexDumpCleanupOutputBuffer(&OutputBuffer);
     YoriLibLineReadCloseOrCache(LineContext);
     YoriLibFreeStringContents(&LineString);
 
@@ -927,8 +1045,7 @@ HexDumpBinaryProcessStream(
 {
     PVOID LineContext = NULL;
     YORI_STRING LineString;
-    HANDLE OutputHandle;
-    DWORD BytesWritten;
+    HEXDUMP_OUTPUT_BUFFER OutputBuffer;
     DWORDLONG LineNumber;
     HEXDUMP_REVERSE_CONTEXT ReverseContext;
     YORI_ALLOC_SIZE_T ErrorChar;
@@ -963,7 +1080,7 @@ HexDumpBinaryProcessStream(
     ReverseContext.OutputBuffer = ReverseContext.StaticOutputBuffer;
     ReverseContext.BytesAllocated = sizeof(ReverseContext.StaticOutputBuffer);
 
-    OutputHandle = GetStdHandle(STD_OUTPUT_HANDLE);
+    HexDumpInitializeOutputBuffer(&OutputBuffer, GetStdHandle(STD_OUTPUT_HANDLE));
 
     while (TRUE) {
 
@@ -994,7 +1111,7 @@ HexDumpBinaryProcessStream(
         }
 
         if (ReverseContext.BytesThisLine > 0) {
-            WriteFile(OutputHandle, ReverseContext.OutputBuffer, ReverseContext.BytesThisLine, &BytesWritten, NULL);
+            HexDumpWriteOutputBuffer(&OutputBuffer, ReverseContext.OutputBuffer, ReverseContext.BytesThisLine);
         }
 
         if (!YoriLibReadLineToString(&LineString, &LineContext, hSource)) {
@@ -1004,6 +1121,8 @@ HexDumpBinaryProcessStream(
         LineNumber++;
     }
 
+    HexDumpCleanupOutputBuffer(&OutputBuffer);
+
     if (ReverseContext.OutputBuffer != ReverseContext.StaticOutputBuffer) {
         YoriLibFree(ReverseContext.OutputBuffer);
         ReverseContext.OutputBuffer = NULL;
@@ -1715,6 +1834,477 @@ Exit:
     return Result;
 }
 
+/**
+ The number of buffers to use for each file when displaying the ranges that
+ differ between two files.  While one buffer is being compared, the next is
+ being read.
+ */
+#define HEXDUMP_RANGE_READ_BUFFERS (2)
+
+/**
+ Context corresponding to a single source when displaying the ranges that
+ differ between two sources.
+ */
+typedef struct _HEXDUMP_RANGE_OBJECT {
+
+    /**
+     A full path expanded for this source.
+     */
+    YORI_STRING FullFileName;
+
+    /**
+     A handle to the source of this data, opened for overlapped IO.
+     */
+    HANDLE FileHandle;
+
+    /**
+     Buffers to hold data read from this source.
+     */
+    PUCHAR Buffer[HEXDUMP_RANGE_READ_BUFFERS];
+
+    /**
+     Overlapped structures describing reads into each buffer.
+     */
+    OVERLAPPED Overlapped[HEXDUMP_RANGE_READ_BUFFERS];
+
+    /**
+     Set to TRUE if a read into the corresponding buffer has been issued and
+     its result has not yet been collected.
+     */
+    BOOL ReadPending[HEXDUMP_RANGE_READ_BUFFERS];
+
+    /**
+     The number of bytes read into the buffer currently being compared.
+     */
+    DWORD BytesReturned;
+} HEXDUMP_RANGE_OBJECT, *PHEXDUMP_RANGE_OBJECT;
+
+/**
+ Issue a read from a source into one of its buffers.
+
+ @param Object Pointer to the source to read from.
+
+ @param BufferIndex Specifies which of the source's buffers to read into.
+
+ @param BufferSize The number of bytes to read.
+
+ @param Offset Specifies the offset within the file to read from.
+
+ @return TRUE if the read was issued and its result should be collected
+         with GetOverlappedResult, FALSE if the read could not be issued,
+         including if the offset is at the end of the file.
+ */
+BOOL
+HexDumpIssueRangeRead(
+    __in PHEXDUMP_RANGE_OBJECT Object,
+    __in DWORD BufferIndex,
+    __in DWORD BufferSize,
+    __in DWORDLONG Offset
+    )
+{
+    LPOVERLAPPED Overlapped;
+    LARGE_INTEGER ReadOffset;
+
+    ReadOffset.QuadPart = Offset;
+    Overlapped = &Object->Overlapped[BufferIndex];
+    Overlapped->Internal = 0;
+    Overlapped->InternalHigh = 0;
+    Overlapped->Offset = ReadOffset.LowPart;
+    Overlapped->OffsetHigh = ReadOffset.HighPart;
+
+    if (ReadFile(Object->FileHandle, Object->Buffer[BufferIndex], BufferSize, NULL, Overlapped)) {
+        return TRUE;
+    }
+
+    if (GetLastError() == ERROR_IO_PENDING) {
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+/**
+ Find the first offset within two buffers where the contents differ.
+ Identical data is skipped a machine word at a time.
+
+ @param BufferA Pointer to the first buffer.
+
+ @param BufferB Pointer to the second buffer.
+
+ @param Start The offset within the buffers to start comparing from.
+
+ @param Length The number of bytes in each buffer.
+
+ @return The offset of the first byte that differs, or Length if the
+         buffers are identical from Start onwards.
+ */
+DWORD
+HexDumpFindDifference(
+    __in PUCHAR BufferA,
+    __in PUCHAR BufferB,
+    __in DWORD Start,
+    __in DWORD Length
+    )
+{
+    DWORD Index;
+
+    Index = Start;
+
+    //
+    //  Both buffers are allocated with the same alignment and compared at
+    //  the same offset, so once one is aligned, both are.
+    //
+
+    while (Index < Length && (((DWORD_PTR)&BufferA[Index]) % sizeof(DWORD_PTR)) != 0) {
+        if (BufferA[Index] != BufferB[Index]) {
+            return Index;
+        }
+        Index++;
+    }
+
+    while (Index + sizeof(DWORD_PTR) <= Length) {
+        if (*(PDWORD_PTR)&BufferA[Index] != *(PDWORD_PTR)&BufferB[Index]) {
+            break;
+        }
+        Index = Index + sizeof(DWORD_PTR);
+    }
+
+    while (Index < Length) {
+        if (BufferA[Index] != BufferB[Index]) {
+            return Index;
+        }
+        Index++;
+    }
+
+    return Length;
+}
+
+/**
+ Find the first offset within two buffers where the contents are the same.
+
+ @param BufferA Pointer to the first buffer.
+
+ @param BufferB Pointer to the second buffer.
+
+ @param Start The offset within the buffers to start comparing from.
+
+ @param Length The number of bytes in each buffer.
+
+ @return The offset of the first byte that matches, or Length if every
+         byte from Start onwards differs.
+ */
+DWORD
+HexDumpFindMatch(
+    __in PUCHAR BufferA,
+    __in PUCHAR BufferB,
+    __in DWORD Start,
+    __in DWORD Length
+    )
+{
+    DWORD Index;
+
+    for (Index = Start; Index < Length; Index++) {
+        if (BufferA[Index] == BufferB[Index]) {
+            return Index;
+        }
+    }
+
+    return Length;
+}
+
+/**
+ Display a single range of bytes that differ between two files.
+
+ @param RangeStart The offset of the first byte that differs.
+
+ @param RangeEnd The offset immediately after the last byte that differs.
+ */
+VOID
+HexDumpDisplayRange(
+    __in DWORDLONG RangeStart,
+    __in DWORDLONG RangeEnd
+    )
+{
+    LARGE_INTEGER First;
+    LARGE_INTEGER Last;
+
+    First.QuadPart = RangeStart;
+    Last.QuadPart = RangeEnd - 1;
+
+    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT,
+                  _T("%08x`%08x-%08x`%08x %lli bytes\n"),
+                  First.HighPart,
+                  First.LowPart,
+                  Last.HighPart,
+                  Last.LowPart,
+                  RangeEnd - RangeStart);
+}
+
+/**
+ Display the ranges of bytes that differ between two files, followed by a
+ summary.  Unlike HexDumpDisplayDiff, this does not display the contents of
+ the files, so it is suited to comparing very large files where few
+ regions are expected to differ.  Each file is read in large blocks using
+ overlapped IO, so the next block from both files is being read while the
+ current block is compared.
+
+ @param FileA The name of the first file, without any full path expansion.
+
+ @param FileB The name of the second file, without any full path expansion.
+
+ @param HexDumpContext Pointer to the context indicating the range of the
+        files to compare.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+HexDumpDisplayDiffRanges(
+    __in PYORI_STRING FileA,
+    __in PYORI_STRING FileB,
+    __in PHEXDUMP_CONTEXT HexDumpContext
+    )
+{
+    HEXDUMP_RANGE_OBJECT Objects[2];
+    YORI_ALLOC_SIZE_T BufferSize;
+    DWORDLONG StreamOffset;
+    DWORDLONG EndOffset;
+    DWORDLONG RangeStart;
+    DWORDLONG RangeCount;
+    DWORDLONG BytesDiffering;
+    DWORD BlockLength;
+    DWORD CommonLength;
+    DWORD Index;
+    DWORD Next;
+    DWORD Current;
+    DWORD NextBuffer;
+    DWORD Count;
+    BOOL Result = FALSE;
+    BOOL InRange;
+    BOOL AnyReadPending;
+
+    BufferSize = YoriLibMaximumAllocationInRange(64 * 1024, 1024 * 1024);
+    StreamOffset = (DWORDLONG)HexDumpContext->OffsetToDisplay;
+    EndOffset = (DWORDLONG)-1;
+    if (HexDumpContext->LengthToDisplay != 0) {
+        EndOffset = StreamOffset + (DWORDLONG)HexDumpContext->LengthToDisplay;
+    }
+
+    ZeroMemory(Objects, sizeof(Objects));
+
+    for (Count = 0; Count < sizeof(Objects)/sizeof(Objects[0]); Count++) {
+
+        //
+        //  Resolve the file to a full path
+        //
+
+        YoriLibInitEmptyString(&Objects[Count].FullFileName);
+        if (Count == 0) {
+            if (!YoriLibUserStringToSingleFilePath(FileA, TRUE, &Objects[Count].FullFileName)) {
+                YoriLibInitEmptyString(&Objects[Count].FullFileName);
+                goto Exit;
+            }
+        } else {
+            if (!YoriLibUserStringToSingleFilePath(FileB, TRUE, &Objects[Count].FullFileName)) {
+                YoriLibInitEmptyString(&Objects[Count].FullFileName);
+                goto Exit;
+            }
+        }
+
+        //
+        //  Open each file
+        //
+
+        Objects[Count].FileHandle = CreateFile(Objects[Count].FullFileName.StartOfString,
+                                               GENERIC_READ,
+                                               FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                                               NULL,
+                                               OPEN_EXISTING,
+                                               FILE_ATTRIBUTE_NORMAL | FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED | FILE_FLAG_SEQUENTIAL_SCAN,
+                                               NULL);
+
+        if (Objects[Count].FileHandle == NULL || Objects[Count].FileHandle == INVALID_HANDLE_VALUE) {
+            DWORD LastError = GetLastError();
+            LPTSTR ErrText = YoriLibGetWinErrorText(LastError);
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("hexdump: open of %y failed: %s"), &Objects[Count].FullFileName, ErrText);
+            YoriLibFreeWinErrorText(ErrText);
+            goto Exit;
+        }
+
+        //
+        //  Allocate read buffers and events for the file
+        //
+
+        for (Index = 0; Index < HEXDUMP_RANGE_READ_BUFFERS; Index++) {
+            Objects[Count].Buffer[Index] = YoriLibMalloc(BufferSize);
+            if (Objects[Count].Buffer[Index] == NULL) {
+                goto Exit;
+            }
+
+            Objects[Count].Overlapped[Index].hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+            if (Objects[Count].Overlapped[Index].hEvent == NULL) {
+                goto Exit;
+            }
+        }
+    }
+
+    InRange = FALSE;
+    RangeStart = 0;
+    RangeCount = 0;
+    BytesDiffering = 0;
+    Current = 0;
+
+    for (Count = 0; Count < sizeof(Objects)/sizeof(Objects[0]); Count++) {
+        Objects[Count].ReadPending[Current] = HexDumpIssueRangeRead(&Objects[Count], Current, BufferSize, StreamOffset);
+    }
+
+    while (StreamOffset < EndOffset) {
+
+        //
+        //  Collect the current block from each file.  A read failure,
+        //  including reaching the end of the file, is treated as the file
+        //  having no more data.
+        //
+
+        AnyReadPending = FALSE;
+        for (Count = 0; Count < sizeof(Objects)/sizeof(Objects[0]); Count++) {
+            Objects[Count].BytesReturned = 0;
+            if (Objects[Count].ReadPending[Current]) {
+                AnyReadPending = TRUE;
+                Objects[Count].ReadPending[Current] = FALSE;
+                if (!GetOverlappedResult(Objects[Count].FileHandle, &Objects[Count].Overlapped[Current], &Objects[Count].BytesReturned, TRUE)) {
+                    Objects[Count].BytesReturned = 0;
+                }
+            }
+        }
+
+        if (!AnyReadPending ||
+            (Objects[0].BytesReturned == 0 && Objects[1].BytesReturned == 0)) {
+
+            break;
+        }
+
+        //
+        //  Start reading the next block from each file before comparing
+        //  this one.  Every block except the last is full, so the next block
+        //  starts one buffer length later.
+        //
+
+        NextBuffer = (Current + 1) % HEXDUMP_RANGE_READ_BUFFERS;
+        for (Count = 0; Count < sizeof(Objects)/sizeof(Objects[0]); Count++) {
+            if (Objects[Count].BytesReturned == BufferSize) {
+                Objects[Count].ReadPending[NextBuffer] = HexDumpIssueRangeRead(&Objects[Count], NextBuffer, BufferSize, StreamOffset + BufferSize);
+            }
+        }
+
+        BlockLength = Objects[0].BytesReturned;
+        CommonLength = Objects[1].BytesReturned;
+        if (Objects[1].BytesReturned > BlockLength) {
+            BlockLength = Objects[1].BytesReturned;
+            CommonLength = Objects[0].BytesReturned;
+        }
+
+        //
+        //  Truncate the comparison to the range the user requested
+        //
+
+        if (StreamOffset + BlockLength > EndOffset) {
+            BlockLength = (DWORD)(EndOffset - StreamOffset);
+        }
+        if (CommonLength > BlockLength) {
+            CommonLength = BlockLength;
+        }
+
+        //
+        //  Walk the block alternately finding the start and end of
+        //  differing ranges.  Beyond the end of the shorter file, every
+        //  byte is considered to differ.  Ranges can span blocks.
+        //
+
+        Index = 0;
+        while (Index < BlockLength) {
+            if (!InRange) {
+                Next = Index;
+                if (Index < CommonLength) {
+                    Next = HexDumpFindDifference(Objects[0].Buffer[Current], Objects[1].Buffer[Current], Index, CommonLength);
+                }
+                if (Next >= BlockLength) {
+                    break;
+                }
+                InRange = TRUE;
+                RangeStart = StreamOffset + Next;
+                Index = Next;
+            } else {
+                Next = BlockLength;
+                if (Index < CommonLength) {
+                    Next = HexDumpFindMatch(Objects[0].Buffer[Current], Objects[1].Buffer[Current], Index, CommonLength);
+                    if (Next == CommonLength) {
+                        Next = BlockLength;
+                    }
+                }
+                if (Next >= BlockLength) {
+                    break;
+                }
+                InRange = FALSE;
+                HexDumpDisplayRange(RangeStart, StreamOffset + Next);
+                RangeCount++;
+                BytesDiffering = BytesDiffering + StreamOffset + Next - RangeStart;
+                Index = Next;
+            }
+        }
+
+        StreamOffset = StreamOffset + BlockLength;
+        Current = NextBuffer;
+
+        if (YoriLibIsOperationCancelled()) {
+            goto Exit;
+        }
+    }
+
+    if (InRange) {
+        HexDumpDisplayRange(RangeStart, StreamOffset);
+        RangeCount++;
+        BytesDiffering = BytesDiffering + StreamOffset - RangeStart;
+    }
+
+    if (RangeCount == 0) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("No differences found in %lli bytes\n"), StreamOffset - (DWORDLONG)HexDumpContext->OffsetToDisplay);
+    } else {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%lli ranges containing %lli bytes differ in %lli bytes\n"), RangeCount, BytesDiffering, StreamOffset - (DWORDLONG)HexDumpContext->OffsetToDisplay);
+    }
+
+    Result = TRUE;
+
+Exit:
+
+    //
+    //  Wait for any outstanding reads and clean up state from each source
+    //
+
+    for (Count = 0; Count < sizeof(Objects)/sizeof(Objects[0]); Count++) {
+        for (Index = 0; Index < HEXDUMP_RANGE_READ_BUFFERS; Index++) {
+            if (Objects[Count].ReadPending[Index]) {
+                GetOverlappedResult(Objects[Count].FileHandle, &Objects[Count].Overlapped[Index], &Objects[Count].BytesReturned, TRUE);
+            }
+            if (Objects[Count].Overlapped[Index].hEvent != NULL) {
+                CloseHandle(Objects[Count].Overlapped[Index].hEvent);
+            }
+            if (Objects[Count].Buffer[Index] != NULL) {
+                YoriLibFree(Objects[Count].Buffer[Index]);
+            }
+        }
+        if (Objects[Count].FileHandle != NULL && Objects[Count].FileHandle != INVALID_HANDLE_VALUE) {
+#if defined(_MSC_VER) && (_MSC_VER >= 1700)
+#pragma warning(suppress: 6001) // Analyze doesn't trust ZeroMemory, or
+                                // doesn't understand the array math
+#endif
+            CloseHandle(Objects[Count].FileHandle);
+        }
+        YoriLibFreeStringContents(&Objects[Count].FullFileName);
+    }
+
+    return Result;
+}
+
 #ifdef YORI_BUILTIN
 /**
  The main entrypoint for the hexdump builtin command.
@@ -1750,6 +2340,7 @@ ENTRYPOINT(
     YORI_ALLOC_SIZE_T CharsConsumed;
     BOOLEAN BasicEnumeration = FALSE;
     BOOLEAN DiffMode = FALSE;
+    BOOLEAN DiffRanges = FALSE;
     BOOLEAN BinaryEncode = FALSE;
     BOOLEAN Reverse = FALSE;
     HEXDUMP_CONTEXT HexDumpContext;
@@ -1781,6 +2372,12 @@ ENTRYPOINT(
                 ArgumentUnderstood = TRUE;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("d")) == 0) {
                 DiffMode = TRUE;
+                DiffRanges = FALSE;
+                HexDumpContext.CStyleInclude = FALSE;
+                ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("dr")) == 0) {
+                DiffMode = TRUE;
+                DiffRanges = TRUE;
                 HexDumpContext.CStyleInclude = FALSE;
                 ArgumentUnderstood = TRUE;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("g1")) == 0) {
@@ -1861,15 +2458,32 @@ ENTRYPOINT(
 
     YoriLibEnableBackupPrivilege();
 
+    //
+    //  Buffer output so that each line isn't written separately when output
+    //  is going to a file or pipe.  Binary output is written directly.
+    //
+
+    if (!BinaryEncode && !Reverse) {
+        YoriLibOutputBufferEnable(GetStdHandle(STD_OUTPUT_HANDLE));
+    }
+
     if (DiffMode) {
         if (StartArg == 0 || StartArg + 2 > ArgC) {
+            YoriLibOutputBufferDisable(GetStdHandle(STD_OUTPUT_HANDLE));
             YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("hexdump: insufficient arguments\n"));
             return EXIT_FAILURE;
         }
 
-        if (!HexDumpDisplayDiff(&ArgV[StartArg], &ArgV[StartArg + 1], &HexDumpContext)) {
+        if (DiffRanges) {
+            if (!HexDumpDisplayDiffRanges(&ArgV[StartArg], &ArgV[StartArg + 1], &HexDumpContext)) {
+                YoriLibOutputBufferDisable(GetStdHandle(STD_OUTPUT_HANDLE));
+                return EXIT_FAILURE;
+            }
+        } else if (!HexDumpDisplayDiff(&ArgV[StartArg], &ArgV[StartArg + 1], &HexDumpContext)) {
+            YoriLibOutputBufferDisable(GetStdHandle(STD_OUTPUT_HANDLE));
             return EXIT_FAILURE;
         }
+        YoriLibOutputBufferDisable(GetStdHandle(STD_OUTPUT_HANDLE));
         return EXIT_SUCCESS;
     }
 
@@ -1880,6 +2494,7 @@ ENTRYPOINT(
 
     if (StartArg == 0 || StartArg == ArgC) {
         if (YoriLibIsStdInConsole()) {
+            YoriLibOutputBufferDisable(GetStdHandle(STD_OUTPUT_HANDLE));
             YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("No file or pipe for input\n"));
             return EXIT_FAILURE;
         }
@@ -1948,6 +2563,8 @@ ENTRYPOINT(
         }
     }
 
+    YoriLibOutputBufferDisable(GetStdHandle(STD_OUTPUT_HANDLE));
+
 #if !YORI_BUILTIN
     YoriLibLineReadCleanupCache();
 #endif
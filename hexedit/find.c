@@ -0,0 +1,1359 @@
+/**
+ * @file hexedit/find.c
+ *
+ * Yori shell hex editor search engine
+ *
+ * Copyright (c) 2026 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <yoripch.h>
+#include <yorilib.h>
+#include <yoriwin.h>
+#include <yoridlg.h>
+#include "hexedit.h"
+
+/**
+ The number of possible match offsets searched by each work item.  This
+ determines how quickly a search responds to being cancelled and how often
+ its progress changes.
+ */
+#define HEXEDIT_FIND_CHUNK_SIZE (0x100000)
+
+/**
+ If the range to search contains fewer offsets than this, the search is
+ expected to complete quickly enough that no progress is displayed.
+ */
+#define HEXEDIT_FIND_PROGRESS_THRESHOLD (0x1000000)
+
+/**
+ The maximum number of threads to search with.  Searching is limited by
+ memory bandwidth, so more threads than this don't help.
+ */
+#define HEXEDIT_FIND_MAX_WORKERS (4)
+
+/**
+ The number of work items to keep outstanding for each worker thread.
+ */
+#define HEXEDIT_FIND_ITEMS_PER_WORKER (4)
+
+/**
+ The interval in milliseconds between updates of the progress displayed
+ while a search is in progress.
+ */
+#define HEXEDIT_FIND_REFRESH_INTERVAL (100)
+
+/**
+ A range of offsets to search, executed on a worker thread.
+ */
+typedef struct _HEXEDIT_FIND_CHUNK {
+
+    /**
+     The work queue item for this range.
+     */
+    YORILIB_WORK_ITEM WorkItem;
+
+    /**
+     The first offset in the range where a match could start.
+     */
+    YORI_ALLOC_SIZE_T Start;
+
+    /**
+     The offset after the last offset in the range where a match could start.
+     */
+    YORI_ALLOC_SIZE_T End;
+
+    /**
+     An array of offsets of matches within the range.  When searching for
+     a single match, this holds at most one offset, which is the match
+     closest to the start of the search.
+     */
+    PYORI_ALLOC_SIZE_T Matches;
+
+    /**
+     The number of elements in Matches.
+     */
+    YORI_ALLOC_SIZE_T MatchCount;
+
+    /**
+     The number of elements allocated in Matches.
+     */
+    YORI_ALLOC_SIZE_T MatchesAllocated;
+
+    /**
+     Set to TRUE once the range has been searched.  This remains FALSE if
+     the search was stopped before this range was reached.
+     */
+    BOOLEAN Searched;
+
+    /**
+     Set to TRUE if not every match could be recorded due to allocation
+     failure.
+     */
+    BOOLEAN Truncated;
+
+} HEXEDIT_FIND_CHUNK, *PHEXEDIT_FIND_CHUNK;
+
+/**
+ The state of a search.  The buffer and search buffer are not modified while
+ the search is in progress, because the window displaying progress is modal.
+ */
+typedef struct _HEXEDIT_FIND {
+
+    /**
+     The buffer to search.
+     */
+    PUCHAR Buffer;
+
+    /**
+     The length of the buffer to search, in bytes.
+     */
+    YORI_ALLOC_SIZE_T BufferLength;
+
+    /**
+     The data to search for.
+     */
+    PUCHAR SearchBuffer;
+
+    /**
+     The length of the data to search for, in bytes.
+     */
+    YORI_ALLOC_SIZE_T SearchBufferLength;
+
+    /**
+     The queue of ranges being searched by worker threads.  Only the thread
+     displaying the search submits and completes items, so state below that
+     is updated on completion does not need synchronization.
+     */
+    PYORILIB_WORK_QUEUE Queue;
+
+    /**
+     The maximum number of ranges to submit to the queue at once.
+     */
+    DWORD MaxOutstanding;
+
+    /**
+     For a forward search, the offset where the next range to submit
+     starts.  For a backward search, the offset after the end of the next
+     range to submit.
+     */
+    YORI_ALLOC_SIZE_T NextOffset;
+
+    /**
+     For a forward search, the offset after the last offset where a match
+     could start.  For a backward search, this is zero.
+     */
+    YORI_ALLOC_SIZE_T EndOffset;
+
+    /**
+     The number of offsets in the range to search.
+     */
+    YORI_ALLOC_SIZE_T TotalLength;
+
+    /**
+     The number of offsets which have been searched.
+     */
+    YORI_ALLOC_SIZE_T LengthSearched;
+
+    /**
+     An array of offsets of matches found so far, in the order they were
+     found.  This is only appended to while the search is in progress.
+     */
+    PYORI_ALLOC_SIZE_T Offsets;
+
+    /**
+     The number of elements in Offsets.
+     */
+    YORI_ALLOC_SIZE_T OffsetCount;
+
+    /**
+     The number of elements allocated in Offsets.
+     */
+    YORI_ALLOC_SIZE_T OffsetsAllocated;
+
+    /**
+     TRUE if the search is moving toward the start of the buffer.
+     */
+    BOOLEAN Backward;
+
+    /**
+     TRUE if every match should be found.  FALSE to stop after the match
+     closest to the start of the search.
+     */
+    BOOLEAN FindAll;
+
+    /**
+     Set to TRUE to indicate that worker threads should stop searching.
+     This is set when a single match has been found, when the user cancels
+     the search, or when matches can no longer be recorded.
+     */
+    BOOLEAN Stop;
+
+    /**
+     Set to TRUE if not every match could be recorded due to allocation
+     failure.
+     */
+    BOOLEAN Truncated;
+
+    /**
+     Set to TRUE once every range has been searched or the search has
+     stopped, and all ranges have been returned from the queue.
+     */
+    BOOLEAN Complete;
+
+    /**
+     The label control displaying search progress.
+     */
+    PYORI_WIN_CTRL_HANDLE StatusLabel;
+
+    /**
+     When finding every match, the list control displaying matches.
+     */
+    PYORI_WIN_CTRL_HANDLE ResultList;
+
+    /**
+     The number of matches displayed in ResultList.
+     */
+    YORI_ALLOC_SIZE_T OffsetsDisplayed;
+
+} HEXEDIT_FIND, *PHEXEDIT_FIND;
+
+/**
+ Search forward through a memory buffer looking for a matching sub-buffer.
+ Both are treated as opaque binary buffers.
+
+ This uses the Boyer-Moore-Horspool algorithm.  The byte in the buffer
+ aligned with the final byte of the search buffer determines how far the
+ search can advance, so most bytes of the buffer are never examined when
+ the search buffer is more than a few bytes long.
+
+ @param Buffer Pointer to the master buffer that may contain a match.
+
+ @param BufferLength The length of the master buffer, in bytes.
+
+ @param BufferOffset The initial offset to search within the master buffer,
+        in bytes.
+
+ @param SearchBuffer Pointer to the buffer to search for.
+
+ @param SearchBufferLength The length of the search buffer, in bytes.
+
+ @param FoundOffset On successful completion (ie., a match is found), updated
+        to point to the offset within the master buffer of the match.
+
+ @return TRUE to indicate a match was found, FALSE if no match was found.
+ */
+__success(return)
+BOOLEAN
+HexEditFindNextMemorySubset(
+    __in PUCHAR Buffer,
+    __in YORI_ALLOC_SIZE_T BufferLength,
+    __in YORI_ALLOC_SIZE_T BufferOffset,
+    __in PUCHAR SearchBuffer,
+    __in YORI_ALLOC_SIZE_T SearchBufferLength,
+    __out PYORI_ALLOC_SIZE_T FoundOffset
+    )
+{
+    YORI_ALLOC_SIZE_T Skip[256];
+    YORI_ALLOC_SIZE_T BufferIndex;
+    YORI_ALLOC_SIZE_T SearchBufferIndex;
+    YORI_ALLOC_SIZE_T LastIndex;
+    YORI_ALLOC_SIZE_T EndIndex;
+    UCHAR LastByte;
+    UCHAR Candidate;
+
+    if (SearchBufferLength == 0 ||
+        BufferOffset > BufferLength ||
+        BufferLength - BufferOffset < SearchBufferLength) {
+
+        return FALSE;
+    }
+
+    //
+    //  For each byte value, record the distance from its final occurrence
+    //  in the search buffer, excluding the last byte, to the end of the
+    //  search buffer.  Values that don't occur allow the search to skip
+    //  the entire length of the search buffer.
+    //
+
+    LastIndex = SearchBufferLength - 1;
+    for (SearchBufferIndex = 0; SearchBufferIndex < sizeof(Skip)/sizeof(Skip[0]); SearchBufferIndex++) {
+        Skip[SearchBufferIndex] = SearchBufferLength;
+    }
+    for (SearchBufferIndex = 0; SearchBufferIndex < LastIndex; SearchBufferIndex++) {
+        Skip[SearchBuffer[SearchBufferIndex]] = LastIndex - SearchBufferIndex;
+    }
+
+    LastByte = SearchBuffer[LastIndex];
+    EndIndex = BufferLength - SearchBufferLength;
+
+    BufferIndex = BufferOffset;
+    while (BufferIndex <= EndIndex) {
+        Candidate = Buffer[BufferIndex + LastIndex];
+        if (Candidate == LastByte &&
+            memcmp(&Buffer[BufferIndex], SearchBuffer, LastIndex) == 0) {
+
+            *FoundOffset = BufferIndex;
+            return TRUE;
+        }
+
+        if (EndIndex - BufferIndex < Skip[Candidate]) {
+            break;
+        }
+
+        BufferIndex = BufferIndex + Skip[Candidate];
+    }
+
+    return FALSE;
+}
+
+/**
+ Search backward through a memory buffer looking for a matching sub-buffer.
+ Both are treated as opaque binary buffers.
+
+ This is the mirror image of HexEditFindNextMemorySubset.  The byte in the
+ buffer aligned with the first byte of the search buffer determines how far
+ the search can move backwards.
+
+ @param Buffer Pointer to the master buffer that may contain a match.
+
+ @param BufferLength The length of the master buffer, in bytes.
+
+ @param BufferOffset The initial offset to search within the master buffer,
+        in bytes.  If a match at this offset would extend beyond the end of
+        the master buffer, searching starts from the last offset that could
+        contain a match.
+
+ @param SearchBuffer Pointer to the buffer to search for.
+
+ @param SearchBufferLength The length of the search buffer, in bytes.
+
+ @param FoundOffset On successful completion (ie., a match is found), updated
+        to point to the offset within the master buffer of the match.
+
+ @return TRUE to indicate a match was found, FALSE if no match was found.
+ */
+__success(return)
+BOOLEAN
+HexEditFindPreviousMemorySubset(
+    __in PUCHAR Buffer,
+    __in YORI_ALLOC_SIZE_T BufferLength,
+    __in YORI_ALLOC_SIZE_T BufferOffset,
+    __in PUCHAR SearchBuffer,
+    __in YORI_ALLOC_SIZE_T SearchBufferLength,
+    __out PYORI_ALLOC_SIZE_T FoundOffset
+    )
+{
+    YORI_ALLOC_SIZE_T Skip[256];
+    YORI_ALLOC_SIZE_T BufferIndex;
+    YORI_ALLOC_SIZE_T SearchBufferIndex;
+    UCHAR FirstByte;
+    UCHAR Candidate;
+
+    if (SearchBufferLength == 0 ||
+        BufferOffset > BufferLength ||
+        BufferLength < SearchBufferLength) {
+
+        return FALSE;
+    }
+
+    if (BufferOffset > BufferLength - SearchBufferLength) {
+        BufferOffset = BufferLength - SearchBufferLength;
+    }
+
+    //
+    //  For each byte value, record the distance from the start of the
+    //  search buffer to its first occurrence, excluding the first byte.
+    //  Populating from the end means earlier occurrences take precedence.
+    //
+
+    for (SearchBufferIndex = 0; SearchBufferIndex < sizeof(Skip)/sizeof(Skip[0]); SearchBufferIndex++) {
+        Skip[SearchBufferIndex] = SearchBufferLength;
+    }
+    for (SearchBufferIndex = SearchBufferLength - 1; SearchBufferIndex > 0; SearchBufferIndex--) {
+        Skip[SearchBuffer[SearchBufferIndex]] = SearchBufferIndex;
+    }
+
+    FirstByte = SearchBuffer[0];
+
+    BufferIndex = BufferOffset;
+    while (TRUE) {
+        Candidate = Buffer[BufferIndex];
+        if (Candidate == FirstByte &&
+            memcmp(&Buffer[BufferIndex + 1], &SearchBuffer[1], SearchBufferLength - 1) == 0) {
+
+            *FoundOffset = BufferIndex;
+            return TRUE;
+        }
+
+        if (BufferIndex < Skip[Candidate]) {
+            break;
+        }
+
+        BufferIndex = BufferIndex - Skip[Candidate];
+    }
+
+    return FALSE;
+}
+
+/**
+ Record a match found within a range.
+
+ @param Chunk Pointer to the range containing the match.
+
+ @param Offset The offset of the match within the buffer.
+
+ @return TRUE to indicate the match was recorded, FALSE if it could not be
+         recorded due to allocation failure.
+ */
+__success(return)
+BOOLEAN
+HexEditFindAddChunkMatch(
+    __in PHEXEDIT_FIND_CHUNK Chunk,
+    __in YORI_ALLOC_SIZE_T Offset
+    )
+{
+    PYORI_ALLOC_SIZE_T NewMatches;
+    DWORDLONG NewAllocated;
+
+    if (Chunk->MatchCount >= Chunk->MatchesAllocated) {
+        NewAllocated = Chunk->MatchesAllocated;
+        NewAllocated = NewAllocated * 2 + 16;
+        if (!YoriLibIsSizeAllocatable(NewAllocated * sizeof(YORI_ALLOC_SIZE_T))) {
+            return FALSE;
+        }
+
+        NewMatches = YoriLibMalloc((YORI_ALLOC_SIZE_T)(NewAllocated * sizeof(YORI_ALLOC_SIZE_T)));
+        if (NewMatches == NULL) {
+            return FALSE;
+        }
+
+        if (Chunk->Matches != NULL) {
+            memcpy(NewMatches, Chunk->Matches, Chunk->MatchCount * sizeof(YORI_ALLOC_SIZE_T));
+            YoriLibFree(Chunk->Matches);
+        }
+        Chunk->Matches = NewMatches;
+        Chunk->MatchesAllocated = (YORI_ALLOC_SIZE_T)NewAllocated;
+    }
+
+    Chunk->Matches[Chunk->MatchCount] = Offset;
+    Chunk->MatchCount++;
+    return TRUE;
+}
+
+/**
+ Search a range for matches.  This is invoked on a worker thread, or on the
+ thread displaying the search if no worker could execute it.
+
+ @param Find Pointer to the search state.
+
+ @param Chunk Pointer to the range to search.
+ */
+VOID
+HexEditFindSearchChunk(
+    __in PHEXEDIT_FIND Find,
+    __in PHEXEDIT_FIND_CHUNK Chunk
+    )
+{
+    YORI_ALLOC_SIZE_T Offset;
+    YORI_ALLOC_SIZE_T FoundOffset;
+    YORI_ALLOC_SIZE_T SearchLength;
+
+    if (Find->Stop) {
+        return;
+    }
+
+    if (Find->Backward) {
+
+        //
+        //  Search a buffer that starts at the beginning of the range, so
+        //  the search stops there rather than at the start of the buffer.
+        //
+
+        if (HexEditFindPreviousMemorySubset(&Find->Buffer[Chunk->Start],
+                                            Find->BufferLength - Chunk->Start,
+                                            Chunk->End - Chunk->Start - 1,
+                                            Find->SearchBuffer,
+                                            Find->SearchBufferLength,
+                                            &FoundOffset)) {
+
+            if (!HexEditFindAddChunkMatch(Chunk, Chunk->Start + FoundOffset)) {
+                Chunk->Truncated = TRUE;
+            }
+        }
+        Chunk->Searched = TRUE;
+        return;
+    }
+
+    //
+    //  Limit the buffer so that matches can only start within the range,
+    //  but can extend beyond it.
+    //
+
+    SearchLength = Chunk->End + Find->SearchBufferLength - 1;
+    Offset = Chunk->Start;
+    while (HexEditFindNextMemorySubset(Find->Buffer,
+                                       SearchLength,
+                                       Offset,
+                                       Find->SearchBuffer,
+                                       Find->SearchBufferLength,
+                                       &FoundOffset)) {
+
+        if (!HexEditFindAddChunkMatch(Chunk, FoundOffset)) {
+            Chunk->Truncated = TRUE;
+            break;
+        }
+
+        if (!Find->FindAll || Find->Stop) {
+            break;
+        }
+
+        Offset = FoundOffset + 1;
+    }
+
+    Chunk->Searched = TRUE;
+}
+
+/**
+ Search a range on a worker thread.
+
+ @param Context Pointer to the search state.
+
+ @param WorkerContext Not used.
+
+ @param Item Pointer to the work item within the range to search.
+
+ @return TRUE to indicate the worker can continue executing ranges.
+ */
+BOOLEAN
+HexEditFindExecute(
+    __in PVOID Context,
+    __in PVOID WorkerContext,
+    __in PYORILIB_WORK_ITEM Item
+    )
+{
+    PHEXEDIT_FIND Find;
+    PHEXEDIT_FIND_CHUNK Chunk;
+
+    UNREFERENCED_PARAMETER(WorkerContext);
+
+    Find = (PHEXEDIT_FIND)Context;
+    Chunk = CONTAINING_RECORD(Item, HEXEDIT_FIND_CHUNK, WorkItem);
+    HexEditFindSearchChunk(Find, Chunk);
+    return TRUE;
+}
+
+/**
+ Collect the matches from a range once it has been searched.  Ranges are
+ returned in the order they were submitted, so the first match returned
+ is the one closest to the start of the search.  This is invoked on the
+ thread displaying the search.
+
+ @param Context Pointer to the search state.
+
+ @param Item Pointer to the work item within the range that was searched.
+ */
+VOID
+HexEditFindComplete(
+    __in PVOID Context,
+    __in PYORILIB_WORK_ITEM Item
+    )
+{
+    PHEXEDIT_FIND Find;
+    PHEXEDIT_FIND_CHUNK Chunk;
+    PYORI_ALLOC_SIZE_T NewOffsets;
+    DWORDLONG NewAllocated;
+
+    Find = (PHEXEDIT_FIND)Context;
+    Chunk = CONTAINING_RECORD(Item, HEXEDIT_FIND_CHUNK, WorkItem);
+
+    //
+    //  If no worker remains to search the range, search it here.
+    //
+
+    if (!Item->Executed) {
+        HexEditFindSearchChunk(Find, Chunk);
+    }
+
+    if (Chunk->Searched) {
+        Find->LengthSearched = Find->LengthSearched + (Chunk->End - Chunk->Start);
+    }
+
+    if (Chunk->Truncated) {
+        Find->Truncated = TRUE;
+        Find->Stop = TRUE;
+    }
+
+    //
+    //  Once a single match has been found, later ranges may have been
+    //  searched already, but their matches are further away.
+    //
+
+    if (Chunk->MatchCount > 0 &&
+        (Find->FindAll || Find->OffsetCount == 0)) {
+
+        if (Find->OffsetCount + Chunk->MatchCount > Find->OffsetsAllocated) {
+            NewAllocated = Find->OffsetsAllocated;
+            NewAllocated = NewAllocated * 2 + Chunk->MatchCount;
+            if (!YoriLibIsSizeAllocatable(NewAllocated * sizeof(YORI_ALLOC_SIZE_T))) {
+                NewOffsets = NULL;
+            } else {
+                NewOffsets = YoriLibMalloc((YORI_ALLOC_SIZE_T)(NewAllocated * sizeof(YORI_ALLOC_SIZE_T)));
+            }
+
+            if (NewOffsets == NULL) {
+                Find->Truncated = TRUE;
+                Find->Stop = TRUE;
+            } else {
+                if (Find->Offsets != NULL) {
+                    memcpy(NewOffsets, Find->Offsets, Find->OffsetCount * sizeof(YORI_ALLOC_SIZE_T));
+                    YoriLibFree(Find->Offsets);
+                }
+                Find->Offsets = NewOffsets;
+                Find->OffsetsAllocated = (YORI_ALLOC_SIZE_T)NewAllocated;
+            }
+        }
+
+        if (Find->OffsetCount + Chunk->MatchCount <= Find->OffsetsAllocated) {
+            memcpy(&Find->Offsets[Find->OffsetCount], Chunk->Matches, Chunk->MatchCount * sizeof(YORI_ALLOC_SIZE_T));
+            Find->OffsetCount = Find->OffsetCount + Chunk->MatchCount;
+        }
+
+        if (!Find->FindAll) {
+            Find->Stop = TRUE;
+        }
+    }
+
+    if (Chunk->Matches != NULL) {
+        YoriLibFree(Chunk->Matches);
+    }
+    YoriLibFree(Chunk);
+}
+
+/**
+ Submit ranges to the queue and collect the results of ranges that have
+ been searched, until the search is complete or no range completes within
+ a timeout.
+
+ @param Find Pointer to the search state.
+
+ @param Timeout The maximum time to wait for a range to complete, in
+        milliseconds, or INFINITE to wait for the search to complete.
+
+ @return TRUE if the search is complete, FALSE if the timeout elapsed.
+ */
+BOOLEAN
+HexEditFindPump(
+    __in PHEXEDIT_FIND Find,
+    __in DWORD Timeout
+    )
+{
+    PHEXEDIT_FIND_CHUNK Chunk;
+    YORI_ALLOC_SIZE_T ChunkLength;
+
+    while (!Find->Stop) {
+        if (Find->Backward) {
+            if (Find->NextOffset == 0) {
+                break;
+            }
+        } else if (Find->NextOffset >= Find->EndOffset) {
+            break;
+        }
+
+        if (!YoriLibWorkQueueComplete(Find->Queue, Find->MaxOutstanding - 1, Timeout)) {
+            return FALSE;
+        }
+
+        //
+        //  Completing a range may have stopped the search.
+        //
+
+        if (Find->Stop) {
+            break;
+        }
+
+        Chunk = YoriLibMalloc(sizeof(HEXEDIT_FIND_CHUNK));
+        if (Chunk == NULL) {
+            Find->Stop = TRUE;
+            break;
+        }
+
+        ZeroMemory(Chunk, sizeof(HEXEDIT_FIND_CHUNK));
+        YoriLibWorkQueueInitializeItem(&Chunk->WorkItem);
+        if (Find->Backward) {
+            ChunkLength = HEXEDIT_FIND_CHUNK_SIZE;
+            if (ChunkLength > Find->NextOffset) {
+                ChunkLength = Find->NextOffset;
+            }
+            Chunk->End = Find->NextOffset;
+            Chunk->Start = Find->NextOffset - ChunkLength;
+            Find->NextOffset = Chunk->Start;
+        } else {
+            ChunkLength = HEXEDIT_FIND_CHUNK_SIZE;
+            if (ChunkLength > Find->EndOffset - Find->NextOffset) {
+                ChunkLength = Find->EndOffset - Find->NextOffset;
+            }
+            Chunk->Start = Find->NextOffset;
+            Chunk->End = Find->NextOffset + ChunkLength;
+            Find->NextOffset = Chunk->End;
+        }
+
+        YoriLibWorkQueueSubmit(Find->Queue, &Chunk->WorkItem);
+    }
+
+    if (!YoriLibWorkQueueComplete(Find->Queue, 0, Timeout)) {
+        return FALSE;
+    }
+
+    Find->Complete = TRUE;
+    return TRUE;
+}
+
+/**
+ Prepare to search a buffer and create the worker threads to search it.
+
+ @param Find Pointer to the search state to initialize.
+
+ @param Buffer Pointer to the buffer to search.
+
+ @param BufferLength The length of the buffer to search, in bytes.
+
+ @param StartOffset The offset to start searching from.  When searching
+        backward, if a match at this offset would extend beyond the end of
+        the buffer, searching starts from the last offset that could contain
+        a match.
+
+ @param SearchBuffer Pointer to the data to search for.
+
+ @param SearchBufferLength The length of the data to search for, in bytes.
+
+ @param Backward TRUE to search toward the start of the buffer.
+
+ @param FindAll TRUE to find every match, FALSE to stop after the match
+        closest to StartOffset.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+HexEditFindInitialize(
+    __out PHEXEDIT_FIND Find,
+    __in PUCHAR Buffer,
+    __in YORI_ALLOC_SIZE_T BufferLength,
+    __in YORI_ALLOC_SIZE_T StartOffset,
+    __in PUCHAR SearchBuffer,
+    __in YORI_ALLOC_SIZE_T SearchBufferLength,
+    __in BOOLEAN Backward,
+    __in BOOLEAN FindAll
+    )
+{
+    SYSTEM_INFO SystemInfo;
+    DWORD WorkerCount;
+    DWORD ChunkCount;
+    DWORD Index;
+
+    ZeroMemory(Find, sizeof(HEXEDIT_FIND));
+    Find->Buffer = Buffer;
+    Find->BufferLength = BufferLength;
+    Find->SearchBuffer = SearchBuffer;
+    Find->SearchBufferLength = SearchBufferLength;
+    Find->Backward = Backward;
+    Find->FindAll = FindAll;
+
+    //
+    //  Calculate the range of offsets where a match could start.  If there
+    //  are none, the search is complete before it starts.
+    //
+
+    if (SearchBufferLength > 0 && BufferLength >= SearchBufferLength) {
+        if (Backward) {
+            if (StartOffset > BufferLength - SearchBufferLength) {
+                StartOffset = BufferLength - SearchBufferLength;
+            }
+            Find->NextOffset = StartOffset + 1;
+            Find->TotalLength = Find->NextOffset;
+        } else if (StartOffset <= BufferLength - SearchBufferLength) {
+            Find->NextOffset = StartOffset;
+            Find->EndOffset = BufferLength - SearchBufferLength + 1;
+            Find->TotalLength = Find->EndOffset - StartOffset;
+        }
+    }
+
+    Find->Queue = YoriLibWorkQueueCreate(YORILIB_WORK_QUEUE_KEEP_ORDER, 1, HexEditFindExecute, HexEditFindComplete, Find);
+    if (Find->Queue == NULL) {
+        return FALSE;
+    }
+
+    //
+    //  If no worker can be created, ranges are searched on this thread as
+    //  they are returned from the queue.
+    //
+
+    GetSystemInfo(&SystemInfo);
+    WorkerCount = SystemInfo.dwNumberOfProcessors;
+    if (WorkerCount > HEXEDIT_FIND_MAX_WORKERS) {
+        WorkerCount = HEXEDIT_FIND_MAX_WORKERS;
+    }
+    ChunkCount = Find->TotalLength / HEXEDIT_FIND_CHUNK_SIZE + 1;
+    if (WorkerCount > ChunkCount) {
+        WorkerCount = ChunkCount;
+    }
+    if (WorkerCount < 1) {
+        WorkerCount = 1;
+    }
+
+    Find->MaxOutstanding = WorkerCount * HEXEDIT_FIND_ITEMS_PER_WORKER;
+
+    for (Index = 0; Index < WorkerCount; Index++) {
+        if (!YoriLibWorkQueueAddWorker(Find->Queue, NULL)) {
+            break;
+        }
+    }
+
+    return TRUE;
+}
+
+/**
+ Stop searching and free the search state.
+
+ @param Find Pointer to the search state.
+ */
+VOID
+HexEditFindCleanup(
+    __in PHEXEDIT_FIND Find
+    )
+{
+    Find->Stop = TRUE;
+    if (Find->Queue != NULL) {
+        YoriLibWorkQueueDestroy(Find->Queue);
+        Find->Queue = NULL;
+    }
+
+    if (Find->Offsets != NULL) {
+        YoriLibFree(Find->Offsets);
+        Find->Offsets = NULL;
+    }
+}
+
+/**
+ Return the percentage of the range that has been searched.
+
+ @param Find Pointer to the search state.
+
+ @return The percentage of the range that has been searched.
+ */
+DWORD
+HexEditFindPercentComplete(
+    __in PHEXEDIT_FIND Find
+    )
+{
+    DWORDLONG Percent;
+
+    if (Find->TotalLength == 0) {
+        return 100;
+    }
+
+    Percent = Find->LengthSearched;
+    Percent = Percent * 100 / Find->TotalLength;
+    return (DWORD)Percent;
+}
+
+/**
+ Update the status label, and the result list if one is displayed, to
+ reflect the progress of the search.
+
+ @param Find Pointer to the search state.
+ */
+VOID
+HexEditFindUpdateDisplay(
+    __in PHEXEDIT_FIND Find
+    )
+{
+    YORI_STRING Status;
+
+    if (Find->ResultList != NULL && Find->OffsetCount != Find->OffsetsDisplayed) {
+        YoriWinListSetVirtualItemCount(Find->ResultList, Find->OffsetCount);
+        if (Find->OffsetsDisplayed == 0) {
+            YoriWinListSetActiveOption(Find->ResultList, 0);
+        }
+        Find->OffsetsDisplayed = Find->OffsetCount;
+    }
+
+    YoriLibInitEmptyString(&Status);
+    if (Find->ResultList == NULL) {
+        YoriLibYPrintf(&Status, _T("Searching: %i%%"), HexEditFindPercentComplete(Find));
+    } else if (!Find->Complete) {
+        YoriLibYPrintf(&Status, _T("Searching: %i%%, %i found"), HexEditFindPercentComplete(Find), Find->OffsetCount);
+    } else if (Find->Truncated) {
+        YoriLibYPrintf(&Status, _T("Search stopped: %i found, out of memory"), Find->OffsetCount);
+    } else {
+        YoriLibYPrintf(&Status, _T("Search complete: %i found"), Find->OffsetCount);
+    }
+
+    if (Status.StartOfString != NULL) {
+        YoriWinLabelSetCaption(Find->StatusLabel, &Status);
+        YoriLibFreeStringContents(&Status);
+    }
+}
+
+/**
+ A callback invoked periodically while a search for a single match is
+ displaying progress.  This closes the window once the search completes.
+
+ @param WindowHandle Handle to the progress window.
+ */
+VOID
+HexEditFindProgressTimer(
+    __in PYORI_WIN_WINDOW_HANDLE WindowHandle
+    )
+{
+    PHEXEDIT_FIND Find;
+
+    Find = YoriWinGetControlContext(YoriWinGetCtrlFromWindow(WindowHandle));
+
+    if (HexEditFindPump(Find, 0)) {
+        YoriWinSetWindowTimerCallback(WindowHandle, 0, NULL);
+        YoriWinCloseWindow(WindowHandle, TRUE);
+        return;
+    }
+
+    HexEditFindUpdateDisplay(Find);
+}
+
+/**
+ A callback invoked periodically while a search for every match is
+ displaying results.  This displays matches found so far, and detects when
+ the search completes.
+
+ @param WindowHandle Handle to the result window.
+ */
+VOID
+HexEditFindAllTimer(
+    __in PYORI_WIN_WINDOW_HANDLE WindowHandle
+    )
+{
+    PHEXEDIT_FIND Find;
+
+    Find = YoriWinGetControlContext(YoriWinGetCtrlFromWindow(WindowHandle));
+
+    if (HexEditFindPump(Find, 0)) {
+        YoriWinSetWindowTimerCallback(WindowHandle, 0, NULL);
+    }
+
+    HexEditFindUpdateDisplay(Find);
+}
+
+/**
+ Callback invoked when the cancel button is clicked.  This closes the window
+ while indicating that the search should stop.
+
+ @param Ctrl Pointer to the cancel button control.
+ */
+VOID
+HexEditFindCancelButtonClicked(
+    __in PYORI_WIN_CTRL_HANDLE Ctrl
+    )
+{
+    PYORI_WIN_CTRL_HANDLE Parent;
+    Parent = YoriWinGetControlParent(Ctrl);
+    YoriWinCloseWindow(Parent, FALSE);
+}
+
+/**
+ Callback invoked when the go button is clicked.  This closes the window
+ while indicating that the selected match should be displayed.
+
+ @param Ctrl Pointer to the go button control.
+ */
+VOID
+HexEditFindGoButtonClicked(
+    __in PYORI_WIN_CTRL_HANDLE Ctrl
+    )
+{
+    PYORI_WIN_CTRL_HANDLE Parent;
+    Parent = YoriWinGetControlParent(Ctrl);
+    YoriWinCloseWindow(Parent, TRUE);
+}
+
+/**
+ Return the text of an item in the match list.
+
+ @param Ctrl Pointer to the match list control.
+
+ @param Index The index of the item within the list.
+
+ @param String On successful completion, populated with the item text.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOLEAN
+HexEditFindGetResultItem(
+    __in PYORI_WIN_CTRL_HANDLE Ctrl,
+    __in YORI_ALLOC_SIZE_T Index,
+    __inout PYORI_STRING String
+    )
+{
+    PHEXEDIT_FIND Find;
+
+    Find = YoriWinGetControlContext(YoriWinGetControlParent(Ctrl));
+    if (Index >= Find->OffsetCount) {
+        return FALSE;
+    }
+
+    YoriLibYPrintf(String, _T("%08x"), Find->Offsets[Index]);
+    if (String->StartOfString == NULL) {
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ Display a window showing the progress of a search for a single match,
+ allowing the user to cancel it, until the search completes.
+
+ @param WinMgr Pointer to the window manager.
+
+ @param Find Pointer to the search state.
+
+ @return TRUE if the search completed, FALSE if the user cancelled it or
+         the window could not be displayed.
+ */
+__success(return)
+BOOLEAN
+HexEditFindDisplayProgress(
+    __in PYORI_WIN_WINDOW_MANAGER_HANDLE WinMgr,
+    __in PHEXEDIT_FIND Find
+    )
+{
+    PYORI_WIN_WINDOW_HANDLE Parent;
+    PYORI_WIN_CTRL_HANDLE Ctrl;
+    COORD WindowSize;
+    SMALL_RECT Area;
+    YORI_STRING Caption;
+    DWORD_PTR WindowResult;
+    WORD ButtonWidth;
+
+    YoriLibConstantString(&Caption, _T("Find"));
+
+    if (!YoriWinCreateWindow(WinMgr, 40, 7, 40, 7, YORI_WIN_WINDOW_STYLE_BORDER_SINGLE | YORI_WIN_WINDOW_STYLE_SHADOW_SOLID, &Caption, &Parent)) {
+        return FALSE;
+    }
+
+    YoriWinSetControlContext(YoriWinGetCtrlFromWindow(Parent), Find);
+    YoriWinGetClientSize(Parent, &WindowSize);
+
+    YoriLibConstantString(&Caption, _T("Searching"));
+
+    Area.Left = 1;
+    Area.Top = 1;
+    Area.Right = (WORD)(WindowSize.X - 2);
+    Area.Bottom = Area.Top;
+
+    Find->StatusLabel = YoriWinLabelCreate(Parent, &Area, &Caption, YORI_WIN_LABEL_STYLE_CENTER);
+    if (Find->StatusLabel == NULL) {
+        YoriWinDestroyWindow(Parent);
+        return FALSE;
+    }
+
+    ButtonWidth = 10;
+
+    YoriLibConstantString(&Caption, _T("&Cancel"));
+
+    Area.Top = (WORD)(WindowSize.Y - 3);
+    Area.Bottom = (WORD)(Area.Top + 2);
+    Area.Left = (WORD)((WindowSize.X - ButtonWidth - 2) / 2);
+    Area.Right = (WORD)(Area.Left + 1 + ButtonWidth);
+
+    Ctrl = YoriWinButtonCreate(Parent, &Area, &Caption, YORI_WIN_BUTTON_STYLE_DEFAULT | YORI_WIN_BUTTON_STYLE_CANCEL, HexEditFindCancelButtonClicked);
+    if (Ctrl == NULL) {
+        YoriWinDestroyWindow(Parent);
+        return FALSE;
+    }
+
+    HexEditFindUpdateDisplay(Find);
+
+    if (!YoriWinSetWindowTimerCallback(Parent, HEXEDIT_FIND_REFRESH_INTERVAL, HexEditFindProgressTimer)) {
+        YoriWinDestroyWindow(Parent);
+        return FALSE;
+    }
+
+    WindowResult = FALSE;
+    if (!YoriWinProcessInputForWindow(Parent, &WindowResult)) {
+        WindowResult = FALSE;
+    }
+
+    YoriWinSetWindowTimerCallback(Parent, 0, NULL);
+    YoriWinDestroyWindow(Parent);
+    Find->StatusLabel = NULL;
+
+    return (BOOLEAN)WindowResult;
+}
+
+/**
+ Search a buffer for the match closest to a starting offset.  The buffer is
+ divided into ranges which are searched by a pool of threads.  If the range
+ to search is large, a window displays the progress of the search and
+ allows the user to cancel it.
+
+ @param WinMgr Pointer to the window manager.
+
+ @param Buffer Pointer to the buffer to search.
+
+ @param BufferLength The length of the buffer to search, in bytes.
+
+ @param StartOffset The offset to start searching from.  When searching
+        backward, if a match at this offset would extend beyond the end of
+        the buffer, searching starts from the last offset that could contain
+        a match.
+
+ @param SearchBuffer Pointer to the data to search for.
+
+ @param SearchBufferLength The length of the data to search for, in bytes.
+
+ @param Backward TRUE to search toward the start of the buffer, FALSE to
+        search toward the end.
+
+ @param FoundOffset On successful completion, updated to contain the offset
+        of the match.
+
+ @param Cancelled On completion, set to TRUE if the user cancelled the
+        search, or if it could not be performed.  In this case the caller
+        should not report that no match was found.
+
+ @return TRUE to indicate a match was found, FALSE if no match was found.
+ */
+__success(return)
+BOOLEAN
+HexEditFindData(
+    __in PYORI_WIN_WINDOW_MANAGER_HANDLE WinMgr,
+    __in PUCHAR Buffer,
+    __in YORI_ALLOC_SIZE_T BufferLength,
+    __in YORI_ALLOC_SIZE_T StartOffset,
+    __in PUCHAR SearchBuffer,
+    __in YORI_ALLOC_SIZE_T SearchBufferLength,
+    __in BOOLEAN Backward,
+    __out PYORI_ALLOC_SIZE_T FoundOffset,
+    __out PBOOLEAN Cancelled
+    )
+{
+    HEXEDIT_FIND Find;
+    BOOLEAN Result;
+
+    *Cancelled = FALSE;
+
+    if (!HexEditFindInitialize(&Find, Buffer, BufferLength, StartOffset, SearchBuffer, SearchBufferLength, Backward, FALSE)) {
+        HexEditFindCleanup(&Find);
+        *Cancelled = TRUE;
+        return FALSE;
+    }
+
+    if (Find.TotalLength < HEXEDIT_FIND_PROGRESS_THRESHOLD) {
+        HexEditFindPump(&Find, INFINITE);
+    } else if (!HexEditFindDisplayProgress(WinMgr, &Find)) {
+        *Cancelled = TRUE;
+    }
+
+    //
+    //  Stop searching before looking at results, so they are no longer
+    //  changing.
+    //
+
+    Find.Stop = TRUE;
+    YoriLibWorkQueueComplete(Find.Queue, 0, INFINITE);
+
+    Result = FALSE;
+    if (!*Cancelled && Find.OffsetCount > 0) {
+        *FoundOffset = Find.Offsets[0];
+        Result = TRUE;
+    }
+
+    if (!*Cancelled && !Result && Find.Truncated) {
+        *Cancelled = TRUE;
+    }
+
+    HexEditFindCleanup(&Find);
+    return Result;
+}
+
+/**
+ Search a buffer for every match and display the offsets of matches as they
+ are found.  The buffer is divided into ranges which are searched by a pool
+ of threads.  The user can select a match to display, or close the window,
+ which stops the search if it is still in progress.
+
+ @param WinMgr Pointer to the window manager.
+
+ @param Buffer Pointer to the buffer to search.
+
+ @param BufferLength The length of the buffer to search, in bytes.
+
+ @param SearchBuffer Pointer to the data to search for.
+
+ @param SearchBufferLength The length of the data to search for, in bytes.
+
+ @param SelectedOffset On successful completion, updated to contain the
+        offset of the match selected by the user.
+
+ @return TRUE to indicate that the user selected a match, FALSE to indicate
+         that a failure occurred or the user closed the window without
+         selecting a match.
+ */
+__success(return)
+BOOLEAN
+HexEditFindAllData(
+    __in PYORI_WIN_WINDOW_MANAGER_HANDLE WinMgr,
+    __in PUCHAR Buffer,
+    __in YORI_ALLOC_SIZE_T BufferLength,
+    __in PUCHAR SearchBuffer,
+    __in YORI_ALLOC_SIZE_T SearchBufferLength,
+    __out PYORI_ALLOC_SIZE_T SelectedOffset
+    )
+{
+    HEXEDIT_FIND Find;
+    PYORI_WIN_WINDOW_HANDLE Parent;
+    PYORI_WIN_CTRL_HANDLE Ctrl;
+    COORD WinMgrSize;
+    COORD WindowSize;
+    SMALL_RECT Area;
+    YORI_STRING Caption;
+    YORI_ALLOC_SIZE_T ActiveOption;
+    DWORD_PTR WindowResult;
+    WORD ButtonWidth;
+    BOOLEAN Success;
+
+    if (!YoriWinGetWinMgrDimensions(WinMgr, &WinMgrSize)) {
+        return FALSE;
+    }
+
+    if (WinMgrSize.X < 40 || WinMgrSize.Y < 12) {
+        return FALSE;
+    }
+
+    if (!HexEditFindInitialize(&Find, Buffer, BufferLength, 0, SearchBuffer, SearchBufferLength, FALSE, TRUE)) {
+        HexEditFindCleanup(&Find);
+        return FALSE;
+    }
+
+    WindowSize.X = 40;
+    WindowSize.Y = (WORD)(WinMgrSize.Y - 4);
+
+    YoriLibConstantString(&Caption, _T("Find All"));
+
+    if (!YoriWinCreateWindow(WinMgr, WindowSize.X, WindowSize.Y, WindowSize.X, WindowSize.Y, YORI_WIN_WINDOW_STYLE_BORDER_SINGLE | YORI_WIN_WINDOW_STYLE_SHADOW_SOLID, &Caption, &Parent)) {
+        HexEditFindCleanup(&Find);
+        return FALSE;
+    }
+
+    YoriWinSetControlContext(YoriWinGetCtrlFromWindow(Parent), &Find);
+    YoriWinGetClientSize(Parent, &WindowSize);
+
+    YoriLibConstantString(&Caption, _T("Searching"));
+
+    Area.Left = 1;
+    Area.Top = 0;
+    Area.Right = (WORD)(WindowSize.X - 2);
+    Area.Bottom = Area.Top;
+
+    Find.StatusLabel = YoriWinLabelCreate(Parent, &Area, &Caption, 0);
+    if (Find.StatusLabel == NULL) {
+        YoriWinDestroyWindow(Parent);
+        HexEditFindCleanup(&Find);
+        return FALSE;
+    }
+
+    Area.Left = 1;
+    Area.Top = 1;
+    Area.Right = (WORD)(WindowSize.X - 2);
+    Area.Bottom = (WORD)(WindowSize.Y - 4);
+
+    Find.ResultList = YoriWinListCreate(Parent, &Area, YORI_WIN_LIST_STYLE_VSCROLLBAR);
+    if (Find.ResultList == NULL ||
+        !YoriWinListSetVirtualItems(Find.ResultList, HexEditFindGetResultItem, 0)) {
+
+        YoriWinDestroyWindow(Parent);
+        HexEditFindCleanup(&Find);
+        return FALSE;
+    }
+
+    ButtonWidth = 8;
+
+    YoriLibConstantString(&Caption, _T("&Go"));
+
+    Area.Top = (WORD)(WindowSize.Y - 3);
+    Area.Left = 1;
+    Area.Bottom = (WORD)(Area.Top + 2);
+    Area.Right = (WORD)(Area.Left + 1 + ButtonWidth);
+
+    Ctrl = YoriWinButtonCreate(Parent, &Area, &Caption, YORI_WIN_BUTTON_STYLE_DEFAULT, HexEditFindGoButtonClicked);
+    if (Ctrl == NULL) {
+        YoriWinDestroyWindow(Parent);
+        HexEditFindCleanup(&Find);
+        return FALSE;
+    }
+
+    YoriLibConstantString(&Caption, _T("&Close"));
+
+    Area.Left = (WORD)(Area.Right + 2);
+    Area.Right = (WORD)(Area.Left + 1 + ButtonWidth);
+
+    Ctrl = YoriWinButtonCreate(Parent, &Area, &Caption, YORI_WIN_BUTTON_STYLE_CANCEL, HexEditFindCancelButtonClicked);
+    if (Ctrl == NULL) {
+        YoriWinDestroyWindow(Parent);
+        HexEditFindCleanup(&Find);
+        return FALSE;
+    }
+
+    YoriWinSetFocus(Parent, Find.ResultList);
+    HexEditFindUpdateDisplay(&Find);
+
+    if (!YoriWinSetWindowTimerCallback(Parent, HEXEDIT_FIND_REFRESH_INTERVAL, HexEditFindAllTimer)) {
+        YoriWinDestroyWindow(Parent);
+        HexEditFindCleanup(&Find);
+        return FALSE;
+    }
+
+    WindowResult = FALSE;
+    if (!YoriWinProcessInputForWindow(Parent, &WindowResult)) {
+        WindowResult = FALSE;
+    }
+
+    YoriWinSetWindowTimerCallback(Parent, 0, NULL);
+
+    //
+    //  Matches are only appended, so an index selected while the search
+    //  was running remains valid.
+    //
+
+    Success = FALSE;
+    if (WindowResult &&
+        YoriWinListGetActiveOption(Find.ResultList, &ActiveOption) &&
+        ActiveOption < Find.OffsetCount) {
+
+        *SelectedOffset = Find.Offsets[ActiveOption];
+        Success = TRUE;
+    }
+
+    YoriWinDestroyWindow(Parent);
+    HexEditFindCleanup(&Find);
+    return Success;
+}
+
+// vim:sw=4:ts=4:et:
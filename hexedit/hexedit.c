@@ -28,6 +28,7 @@
 #include <yorilib.h>
 #include <yoriwin.h>
 #include <yoridlg.h>
+#include "hexedit.h"
 
 /**
  Help text to display to the user.
@@ -210,6 +211,13 @@ typedef struct _HEXEDIT_CONTEXT {
      */
     BOOLEAN ReadOnly;
 
+    /**
+     TRUE if the current file was loaded as a copy on write view of the
+     file.  When saving to the same file without changing its length, only
+     the modified range is written back.
+     */
+    BOOLEAN DataMapped;
+
 } HEXEDIT_CONTEXT, *PHEXEDIT_CONTEXT;
 
 /**
@@ -284,6 +292,12 @@ HexEditUpdateOpenedFileCaption(
     YoriWinHexEditSetCaption(HexEditContext->HexEdit, &NewCaption);
 }
 
+/**
+ Files at least this large are mapped rather than read into memory, so only
+ the parts being viewed or edited are brought into memory.
+ */
+#define HEXEDIT_MAPPED_FILE_THRESHOLD (4 * 1024 * 1024)
+
 /**
  Load the contents of the specified file into the hexedit window.
 
@@ -321,7 +335,12 @@ HexEditLoadFile(
 
     ASSERT(YoriLibIsStringNullTerminated(FileName));
 
-    hFile = CreateFile(FileName->StartOfString, FILE_READ_DATA | FILE_READ_ATTRIBUTES, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    //
+    //  Write sharing is allowed so that if the file is mapped, modified
+    //  ranges can be written back while the mapping is still in use.
+    //
+
+    hFile = CreateFile(FileName->StartOfString, FILE_READ_DATA | FILE_READ_ATTRIBUTES, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
     if (hFile == INVALID_HANDLE_VALUE) {
         return GetLastError();
     }
@@ -350,6 +369,36 @@ HexEditLoadFile(
 
     ReadLength = (YORI_ALLOC_SIZE_T)FileSize.QuadPart;
 
+    //
+    //  For large files, map a copy on write view of the file.  Pages are
+    //  read as they are displayed, and edits are private to this process
+    //  until saved.  If the file cannot be mapped, fall back to reading
+    //  it.
+    //
+
+    if (DataOffset == 0 &&
+        DataLength == 0 &&
+        ReadLength >= HEXEDIT_MAPPED_FILE_THRESHOLD &&
+        !YoriLibIsFileNameDeviceName(FileName)) {
+
+        HANDLE hMap;
+
+        hMap = CreateFileMapping(hFile, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+        if (hMap != NULL) {
+            Buffer = MapViewOfFile(hMap, FILE_MAP_COPY, 0, 0, ReadLength);
+            CloseHandle(hMap);
+            if (Buffer != NULL) {
+                CloseHandle(hFile);
+                YoriWinHexEditClear(HexEditContext->HexEdit);
+                YoriWinHexEditSetDataMapped(HexEditContext->HexEdit, Buffer, ReadLength);
+                HexEditContext->DataOffset = DataOffset;
+                HexEditContext->DataLength = ReadLength;
+                HexEditContext->DataMapped = TRUE;
+                return ERROR_SUCCESS;
+            }
+        }
+    }
+
     FileOffset.QuadPart = DataOffset;
     if (FileOffset.QuadPart != 0) {
         if (!SetFilePointer(hFile, FileOffset.LowPart, &FileOffset.HighPart, FILE_BEGIN)) {
@@ -398,10 +447,76 @@ HexEditLoadFile(
 
     HexEditContext->DataOffset = DataOffset;
     HexEditContext->DataLength = ReadLength;
+    HexEditContext->DataMapped = FALSE;
 
     return ERROR_SUCCESS;
 }
 
+/**
+ Write the bytes that have been modified back to the file they were loaded
+ from, without rewriting the remainder of the file.  This is used for
+ mapped files whose length has not changed.
+
+ @param HexEditContext Pointer to the hexedit context.
+
+ @param FileName Pointer to the name of the file to update.
+
+ @param Buffer Pointer to the data in the hex edit control.
+
+ @return Win32 error code, including ERROR_SUCCESS to indicate success.
+ */
+DWORD
+HexEditSaveModifiedRange(
+    __in PHEXEDIT_CONTEXT HexEditContext,
+    __in PYORI_STRING FileName,
+    __in PUCHAR Buffer
+    )
+{
+    HANDLE WriteHandle;
+    LARGE_INTEGER FileOffset;
+    YORI_ALLOC_SIZE_T FirstOffset;
+    YORI_ALLOC_SIZE_T BeyondLastOffset;
+    DWORD BytesWritten;
+    DWORD Err;
+
+    if (!YoriWinHexEditGetModifiedRange(HexEditContext->HexEdit, &FirstOffset, &BeyondLastOffset)) {
+        return ERROR_SUCCESS;
+    }
+
+    WriteHandle = CreateFile(FileName->StartOfString,
+                             FILE_WRITE_DATA | SYNCHRONIZE,
+                             FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                             NULL,
+                             OPEN_EXISTING,
+                             FILE_ATTRIBUTE_NORMAL,
+                             NULL);
+
+    if (WriteHandle == INVALID_HANDLE_VALUE) {
+        return GetLastError();
+    }
+
+    Err = ERROR_SUCCESS;
+    FileOffset.QuadPart = HexEditContext->DataOffset + FirstOffset;
+    if (SetFilePointer(WriteHandle, FileOffset.LowPart, &FileOffset.HighPart, FILE_BEGIN) == INVALID_SET_FILE_POINTER &&
+        GetLastError() != NO_ERROR) {
+
+        Err = GetLastError();
+    }
+
+    if (Err == ERROR_SUCCESS &&
+        !WriteFile(WriteHandle, &Buffer[FirstOffset], BeyondLastOffset - FirstOffset, &BytesWritten, NULL)) {
+
+        Err = GetLastError();
+    }
+
+    if (Err == ERROR_SUCCESS && !FlushFileBuffers(WriteHandle)) {
+        Err = GetLastError();
+    }
+
+    CloseHandle(WriteHandle);
+    return Err;
+}
+
 /**
  Save the contents of the opened window into a file.
 
@@ -466,6 +581,31 @@ HexEditSaveFile(
 
     ASSERT(YoriLibIsStringNullTerminated(FileName));
 
+    //
+    //  If the data is a view of this file and the length is unchanged,
+    //  write back only the modified range.  The file cannot be replaced
+    //  while it is mapped, and rewriting a large file to save a small
+    //  change is what mapping it was intended to avoid.
+    //
+
+    YoriWinHexEditGetDataPointer(HexEditContext->HexEdit, &Buffer, &BufferLength);
+    if (HexEditContext->DataMapped &&
+        Buffer != NULL &&
+        DataOffset == HexEditContext->DataOffset &&
+        BufferLength == HexEditContext->DataLength &&
+        YoriLibCompareStringIns(FileName, &HexEditContext->OpenFileName) == 0) {
+
+        Err = HexEditSaveModifiedRange(HexEditContext, FileName, Buffer);
+        if (Err != ERROR_SUCCESS) {
+            ErrText = YoriLibGetWinErrorText(Err);
+            YoriLibYPrintf(&Text, _T("Could not write to file: %s"), ErrText);
+            YoriLibFreeWinErrorText(ErrText);
+            goto DisplayErrorAndFail;
+        }
+
+        return TRUE;
+    }
+
     if (!YoriLibIsFileNameDeviceName(FileName)) {
 
         //
@@ -515,8 +655,6 @@ HexEditSaveFile(
         }
     }
 
-    YoriWinHexEditGetDataNoCopy(HexEditContext->HexEdit, &Buffer, &BufferLength);
-
     if (EffectiveDataLength != 0 &&
         EffectiveDataLength != BufferLength) {
 
@@ -552,13 +690,10 @@ HexEditSaveFile(
                 DeleteFile(TempFileName.StartOfString);
             }
             YoriLibFreeStringContents(&TempFileName);
-            YoriLibDereference(Buffer);
             YoriLibYPrintf(&Text, _T("Could not write to device: %s"), ErrText);
             YoriLibFreeWinErrorText(ErrText);
             goto DisplayErrorAndFail;
         }
-
-        YoriLibDereference(Buffer);
     }
 
     if (TempFileName.LengthInChars > 0) {
@@ -616,6 +751,7 @@ HexEditSaveFile(
 
     HexEditContext->DataOffset = DataOffset;
     HexEditContext->DataLength = EffectiveDataLength;
+    HexEditContext->DataMapped = FALSE;
 
     YoriLibFreeStringContents(&TempFileName);
     return TRUE;
@@ -1200,125 +1336,6 @@ HexEditClearButtonClicked(
 }
 
 
-/**
- Search forward through a memory buffer looking for a matching sub-buffer.
- Both are treated as opaque binary buffers.
-
- @param Buffer Pointer to the master buffer that may contain a match.
-
- @param BufferLength The length of the master buffer, in bytes.
-
- @param BufferOffset The initial offset to search within the master buffer,
-        in bytes.
-
- @param SearchBuffer Pointer to the buffer to search for.
-
- @param SearchBufferLength The length of the search buffer, in bytes.
-
- @param FoundOffset On successful completion (ie., a match is found), updated
-        to point to the offset within the master buffer of the match.
-
- @return TRUE to indicate a match was found, FALSE if no match was found.
- */
-__success(return)
-BOOLEAN
-HexEditFindNextMemorySubset(
-    __in PUCHAR Buffer,
-    __in YORI_ALLOC_SIZE_T BufferLength,
-    __in YORI_ALLOC_SIZE_T BufferOffset,
-    __in PUCHAR SearchBuffer,
-    __in YORI_ALLOC_SIZE_T SearchBufferLength,
-    __out PYORI_ALLOC_SIZE_T FoundOffset
-    )
-{
-    YORI_ALLOC_SIZE_T BufferIndex;
-    YORI_ALLOC_SIZE_T SearchBufferIndex;
-    YORI_ALLOC_SIZE_T EndIndex;
-
-    if (BufferOffset > BufferLength ||
-        BufferLength - BufferOffset < SearchBufferLength) {
-
-        return FALSE;
-    }
-
-    EndIndex = BufferLength - SearchBufferLength + 1;
-
-    for (BufferIndex = BufferOffset; BufferIndex < EndIndex; BufferIndex++) {
-        for (SearchBufferIndex = 0; SearchBufferIndex < SearchBufferLength; SearchBufferIndex++) {
-            if (Buffer[BufferIndex + SearchBufferIndex] != SearchBuffer[SearchBufferIndex]) {
-                break;
-            }
-        }
-
-        if (SearchBufferIndex == SearchBufferLength) {
-            *FoundOffset = BufferIndex;
-            return TRUE;
-        }
-    }
-
-    return FALSE;
-}
-
-/**
- Search backward through a memory buffer looking for a matching sub-buffer.
- Both are treated as opaque binary buffers.
-
- @param Buffer Pointer to the master buffer that may contain a match.
-
- @param BufferLength The length of the master buffer, in bytes.
-
- @param BufferOffset The initial offset to search within the master buffer,
-        in bytes.
-
- @param SearchBuffer Pointer to the buffer to search for.
-
- @param SearchBufferLength The length of the search buffer, in bytes.
-
- @param FoundOffset On successful completion (ie., a match is found), updated
-        to point to the offset within the master buffer of the match.
-
- @return TRUE to indicate a match was found, FALSE if no match was found.
- */
-__success(return)
-BOOLEAN
-HexEditFindPreviousMemorySubset(
-    __in PUCHAR Buffer,
-    __in YORI_ALLOC_SIZE_T BufferLength,
-    __in YORI_ALLOC_SIZE_T BufferOffset,
-    __in PUCHAR SearchBuffer,
-    __in YORI_ALLOC_SIZE_T SearchBufferLength,
-    __out PYORI_ALLOC_SIZE_T FoundOffset
-    )
-{
-    YORI_ALLOC_SIZE_T BufferIndex;
-    YORI_ALLOC_SIZE_T SearchBufferIndex;
-
-    if (BufferOffset > BufferLength ||
-        BufferLength - BufferOffset < SearchBufferLength) {
-
-        return FALSE;
-    }
-
-    for (BufferIndex = BufferOffset; TRUE; BufferIndex--) {
-        for (SearchBufferIndex = 0; SearchBufferIndex < SearchBufferLength; SearchBufferIndex++) {
-            if (Buffer[BufferIndex + SearchBufferIndex] != SearchBuffer[SearchBufferIndex]) {
-                break;
-            }
-        }
-
-        if (SearchBufferIndex == SearchBufferLength) {
-            *FoundOffset = BufferIndex;
-            return TRUE;
-        }
-
-        if (BufferIndex == 0) {
-            break;
-        }
-    }
-
-    return FALSE;
-}
-
 /**
  Translate a byte aligned offset into a control buffer offset and bit shift.
  This is necessary because the control can display values of different word
@@ -1367,6 +1384,10 @@ HexEditByteOffsetToBufferOffsetAndShift(
  @param MatchOffset If a new match is found, updated to contain the offset of
         the newly found match.
 
+ @param Cancelled On completion, set to TRUE if the user cancelled the
+        search or it could not be performed, in which case the user should
+        not be told that no match exists.
+
  @return TRUE to indicate a match was found, FALSE if no match was found.
  */
 __success(return)
@@ -1374,14 +1395,16 @@ BOOLEAN
 HexEditFindNextFromPosition(
     __in PHEXEDIT_CONTEXT HexEditContext,
     __in YORI_ALLOC_SIZE_T StartOffset,
-    __out PYORI_ALLOC_SIZE_T MatchOffset
+    __out PYORI_ALLOC_SIZE_T MatchOffset,
+    __out PBOOLEAN Cancelled
     )
 {
     PUCHAR Buffer;
     YORI_ALLOC_SIZE_T BufferLength;
-    YORI_ALLOC_SIZE_T FindOffset;
 
-    YoriWinHexEditGetDataNoCopy(HexEditContext->HexEdit, &Buffer, &BufferLength);
+    *Cancelled = FALSE;
+
+    YoriWinHexEditGetDataPointer(HexEditContext->HexEdit, &Buffer, &BufferLength);
 
     //
     //  This can happen if the hex edit control contains no data.  In that
@@ -1393,18 +1416,39 @@ HexEditFindNextFromPosition(
     }
 
     if (StartOffset >= BufferLength) {
-        YoriLibDereference(Buffer);
         return FALSE;
     }
 
-    if (HexEditFindNextMemorySubset(Buffer, BufferLength, StartOffset, HexEditContext->SearchBuffer, HexEditContext->SearchBufferLength, &FindOffset)) {
-        *MatchOffset = FindOffset;
-        YoriLibDereference(Buffer);
-        return TRUE;
-    }
+    return HexEditFindData(HexEditContext->WinMgr,
+                           Buffer,
+                           BufferLength,
+                           StartOffset,
+                           HexEditContext->SearchBuffer,
+                           HexEditContext->SearchBufferLength,
+                           FALSE,
+                           MatchOffset,
+                           Cancelled);
+}
 
-    YoriLibDereference(Buffer);
-    return FALSE;
+/**
+ Move the cursor to a match and select it.
+
+ @param HexEditContext Pointer to the hexedit context.
+
+ @param FindOffset The byte offset of the match.
+ */
+VOID
+HexEditSelectMatch(
+    __in PHEXEDIT_CONTEXT HexEditContext,
+    __in YORI_ALLOC_SIZE_T FindOffset
+    )
+{
+    YORI_ALLOC_SIZE_T BufferOffset;
+    UCHAR BitShift;
+
+    HexEditByteOffsetToBufferOffsetAndShift(HexEditContext, FindOffset, &BufferOffset, &BitShift);
+    YoriWinHexEditSetCursorLocation(HexEditContext->HexEdit, FALSE, BufferOffset, BitShift);
+    YoriWinHexEditSetSelectionRange(HexEditContext->HexEdit, FindOffset, FindOffset + HexEditContext->SearchBufferLength - 1);
 }
 
 /**
@@ -1416,12 +1460,17 @@ HexEditFindNextFromPosition(
  @param StartAtNextByte TRUE to indicate searching should start from the byte
         after the cursor, FALSE if it should start at the cursor.
 
+ @param Cancelled On completion, set to TRUE if the user cancelled the
+        search or it could not be performed, in which case the user should
+        not be told that no match exists.
+
  @return TRUE to indicate a match was found, FALSE if no match was found.
  */
 BOOLEAN
 HexEditFindNextFromCurrentPosition(
     __in PHEXEDIT_CONTEXT HexEditContext,
-    __in BOOLEAN StartAtNextByte
+    __in BOOLEAN StartAtNextByte,
+    __out PBOOLEAN Cancelled
     )
 {
     YORI_ALLOC_SIZE_T BufferOffset;
@@ -1429,6 +1478,8 @@ HexEditFindNextFromCurrentPosition(
     UCHAR BitShift;
     BOOLEAN AsChar;
 
+    *Cancelled = FALSE;
+
     if (!YoriWinHexEditGetCursorLocation(HexEditContext->HexEdit, &AsChar, &BufferOffset, &BitShift)) {
         return FALSE;
     }
@@ -1438,10 +1489,8 @@ HexEditFindNextFromCurrentPosition(
         BufferOffset = BufferOffset + 1;
     }
 
-    if (HexEditFindNextFromPosition(HexEditContext, BufferOffset, &FindOffset)) {
-        HexEditByteOffsetToBufferOffsetAndShift(HexEditContext, FindOffset, &BufferOffset, &BitShift);
-        YoriWinHexEditSetCursorLocation(HexEditContext->HexEdit, FALSE, BufferOffset, BitShift);
-        YoriWinHexEditSetSelectionRange(HexEditContext->HexEdit, FindOffset, FindOffset + HexEditContext->SearchBufferLength - 1);
+    if (HexEditFindNextFromPosition(HexEditContext, BufferOffset, &FindOffset, Cancelled)) {
+        HexEditSelectMatch(HexEditContext, FindOffset);
         return TRUE;
     }
 
@@ -1454,11 +1503,16 @@ HexEditFindNextFromCurrentPosition(
  @param HexEditContext Pointer to the hexedit context, implicitly containing
         the buffer to search and a cursor offset.
 
+ @param Cancelled On completion, set to TRUE if the user cancelled the
+        search or it could not be performed, in which case the user should
+        not be told that no match exists.
+
  @return TRUE to indicate a match was found, FALSE if no match was found.
  */
 BOOLEAN
 HexEditFindPreviousFromCurrentPosition(
-    __in PHEXEDIT_CONTEXT HexEditContext
+    __in PHEXEDIT_CONTEXT HexEditContext,
+    __out PBOOLEAN Cancelled
     )
 {
     PUCHAR Buffer;
@@ -1468,7 +1522,9 @@ HexEditFindPreviousFromCurrentPosition(
     BOOLEAN AsChar;
     YORI_ALLOC_SIZE_T FindOffset;
 
-    YoriWinHexEditGetDataNoCopy(HexEditContext->HexEdit, &Buffer, &BufferLength);
+    *Cancelled = FALSE;
+
+    YoriWinHexEditGetDataPointer(HexEditContext->HexEdit, &Buffer, &BufferLength);
 
     //
     //  This can happen if the hex edit control contains no data.  In that
@@ -1480,65 +1536,97 @@ HexEditFindPreviousFromCurrentPosition(
     }
 
     if (!YoriWinHexEditGetCursorLocation(HexEditContext->HexEdit, &AsChar, &BufferOffset, &BitShift)) {
-        YoriLibDereference(Buffer);
         return FALSE;
     }
 
     BufferOffset = BufferOffset + (BitShift / 8);
 
     if (BufferOffset == 0) {
-        YoriLibDereference(Buffer);
         return FALSE;
     }
 
     BufferOffset = BufferOffset - 1;
 
-    if (HexEditFindPreviousMemorySubset(Buffer, BufferLength, BufferOffset, HexEditContext->SearchBuffer, HexEditContext->SearchBufferLength, &FindOffset)) {
-        HexEditByteOffsetToBufferOffsetAndShift(HexEditContext, FindOffset, &BufferOffset, &BitShift);
-        YoriWinHexEditSetCursorLocation(HexEditContext->HexEdit, FALSE, BufferOffset, BitShift);
-        YoriWinHexEditSetSelectionRange(HexEditContext->HexEdit, FindOffset, FindOffset + HexEditContext->SearchBufferLength - 1);
-        YoriLibDereference(Buffer);
+    if (HexEditFindData(HexEditContext->WinMgr,
+                        Buffer,
+                        BufferLength,
+                        BufferOffset,
+                        HexEditContext->SearchBuffer,
+                        HexEditContext->SearchBufferLength,
+                        TRUE,
+                        &FindOffset,
+                        Cancelled)) {
+
+        HexEditSelectMatch(HexEditContext, FindOffset);
         return TRUE;
     }
 
-    YoriLibDereference(Buffer);
     return FALSE;
 }
 
 /**
- A callback invoked when the find menu item is invoked.
+ Tell the user that no match was found.
 
- @param Ctrl Pointer to the menu bar control.
+ @param HexEditContext Pointer to the hexedit context.
+
+ @param Message Pointer to a NULL terminated message to display.
  */
 VOID
-HexEditFindButtonClicked(
-    __in PYORI_WIN_CTRL_HANDLE Ctrl
+HexEditDisplayFindFailure(
+    __in PHEXEDIT_CONTEXT HexEditContext,
+    __in LPCTSTR Message
     )
 {
     YORI_STRING Title;
-    PYORI_WIN_CTRL_HANDLE Parent;
-    PHEXEDIT_CONTEXT HexEditContext;
-    PUCHAR FindData;
-    YORI_ALLOC_SIZE_T FindDataLength;
-
-    Parent = YoriWinGetControlParent(Ctrl);
-    HexEditContext = YoriWinGetControlContext(Parent);
+    YORI_STRING Text;
+    YORI_STRING ButtonText[1];
 
     YoriLibConstantString(&Title, _T("Find"));
+    YoriLibConstantString(&Text, Message);
+    YoriLibConstantString(&ButtonText[0], _T("&Ok"));
+
+    YoriDlgMessageBox(HexEditContext->WinMgr,
+                      &Title,
+                      &Text,
+                      1,
+                      ButtonText,
+                      0,
+                      0);
+}
+
+/**
+ Prompt the user for data to search for, and record it as the data to use
+ for later searches.
+
+ @param HexEditContext Pointer to the hexedit context.
 
-    if (!YoriDlgFindHex(YoriWinGetWindowManagerHandle(Parent),
-                        &Title,
+ @param Title Pointer to the title of the dialog.
+
+ @return TRUE to indicate the user entered data to search for, FALSE if the
+         user cancelled the dialog.
+ */
+BOOLEAN
+HexEditPromptForSearchData(
+    __in PHEXEDIT_CONTEXT HexEditContext,
+    __in PYORI_STRING Title
+    )
+{
+    PUCHAR FindData;
+    YORI_ALLOC_SIZE_T FindDataLength;
+
+    if (!YoriDlgFindHex(HexEditContext->WinMgr,
+                        Title,
                         HexEditContext->SearchBuffer,
                         HexEditContext->SearchBufferLength,
                         HexEditContext->BytesPerWord,
                         &FindData,
                         &FindDataLength)) {
 
-        return;
+        return FALSE;
     }
 
     if (FindData == NULL) {
-        return;
+        return FALSE;
     }
 
     if (HexEditContext->SearchBuffer != NULL) {
@@ -1547,21 +1635,81 @@ HexEditFindButtonClicked(
 
     HexEditContext->SearchBuffer = FindData;
     HexEditContext->SearchBufferLength = FindDataLength;
-    if (!HexEditFindNextFromCurrentPosition(HexEditContext, FALSE)) {
-        YORI_STRING ButtonText[1];
-        YORI_STRING Text;
+    return TRUE;
+}
 
-        YoriLibConstantString(&Title, _T("Find"));
-        YoriLibConstantString(&Text, _T("Data not found."));
-        YoriLibConstantString(&ButtonText[0], _T("&Ok"));
+/**
+ A callback invoked when the find menu item is invoked.
 
-        YoriDlgMessageBox(YoriWinGetWindowManagerHandle(Parent),
-                          &Title,
-                          &Text,
-                          1,
-                          ButtonText,
-                          0,
-                          0);
+ @param Ctrl Pointer to the menu bar control.
+ */
+VOID
+HexEditFindButtonClicked(
+    __in PYORI_WIN_CTRL_HANDLE Ctrl
+    )
+{
+    YORI_STRING Title;
+    PYORI_WIN_CTRL_HANDLE Parent;
+    PHEXEDIT_CONTEXT HexEditContext;
+    BOOLEAN Cancelled;
+
+    Parent = YoriWinGetControlParent(Ctrl);
+    HexEditContext = YoriWinGetControlContext(Parent);
+
+    YoriLibConstantString(&Title, _T("Find"));
+
+    if (!HexEditPromptForSearchData(HexEditContext, &Title)) {
+        return;
+    }
+
+    if (!HexEditFindNextFromCurrentPosition(HexEditContext, FALSE, &Cancelled) &&
+        !Cancelled) {
+
+        HexEditDisplayFindFailure(HexEditContext, _T("Data not found."));
+    }
+}
+
+/**
+ A callback invoked when the find all menu item is invoked.  This displays
+ the offset of every match, allowing the user to move to one of them.
+
+ @param Ctrl Pointer to the menu bar control.
+ */
+VOID
+HexEditFindAllButtonClicked(
+    __in PYORI_WIN_CTRL_HANDLE Ctrl
+    )
+{
+    YORI_STRING Title;
+    PYORI_WIN_CTRL_HANDLE Parent;
+    PHEXEDIT_CONTEXT HexEditContext;
+    PUCHAR Buffer;
+    YORI_ALLOC_SIZE_T BufferLength;
+    YORI_ALLOC_SIZE_T FindOffset;
+
+    Parent = YoriWinGetControlParent(Ctrl);
+    HexEditContext = YoriWinGetControlContext(Parent);
+
+    YoriLibConstantString(&Title, _T("Find All"));
+
+    if (!HexEditPromptForSearchData(HexEditContext, &Title)) {
+        return;
+    }
+
+    YoriWinHexEditGetDataPointer(HexEditContext->HexEdit, &Buffer, &BufferLength);
+    if (Buffer == NULL) {
+        HexEditDisplayFindFailure(HexEditContext, _T("Data not found."));
+        return;
+    }
+
+    if (HexEditFindAllData(HexEditContext->WinMgr,
+                           Buffer,
+                           BufferLength,
+                           HexEditContext->SearchBuffer,
+                           HexEditContext->SearchBufferLength,
+                           &FindOffset)) {
+
+        HexEditSelectMatch(HexEditContext, FindOffset);
     }
 }
 
@@ -1577,6 +1725,7 @@ HexEditFindNextButtonClicked(
 {
     PYORI_WIN_CTRL_HANDLE Parent;
     PHEXEDIT_CONTEXT HexEditContext;
+    BOOLEAN Cancelled;
 
     Parent = YoriWinGetControlParent(Ctrl);
     HexEditContext = YoriWinGetControlContext(Parent);
@@ -1587,22 +1736,10 @@ HexEditFindNextButtonClicked(
         return;
     }
 
-    if (!HexEditFindNextFromCurrentPosition(HexEditContext, TRUE)) {
-        YORI_STRING Title;
-        YORI_STRING Text;
-        YORI_STRING ButtonText[1];
-
-        YoriLibConstantString(&Title, _T("Find"));
-        YoriLibConstantString(&Text, _T("No more matches found."));
-        YoriLibConstantString(&ButtonText[0], _T("&Ok"));
+    if (!HexEditFindNextFromCurrentPosition(HexEditContext, TRUE, &Cancelled) &&
+        !Cancelled) {
 
-        YoriDlgMessageBox(YoriWinGetWindowManagerHandle(Parent),
-                          &Title,
-                          &Text,
-                          1,
-                          ButtonText,
-                          0,
-                          0);
+        HexEditDisplayFindFailure(HexEditContext, _T("No more matches found."));
     }
 }
 
@@ -1618,6 +1755,7 @@ HexEditFindPreviousButtonClicked(
 {
     PYORI_WIN_CTRL_HANDLE Parent;
     PHEXEDIT_CONTEXT HexEditContext;
+    BOOLEAN Cancelled;
 
     Parent = YoriWinGetControlParent(Ctrl);
     HexEditContext = YoriWinGetControlContext(Parent);
@@ -1628,22 +1766,10 @@ HexEditFindPreviousButtonClicked(
         return;
     }
 
-    if (!HexEditFindPreviousFromCurrentPosition(HexEditContext)) {
-        YORI_STRING Title;
-        YORI_STRING Text;
-        YORI_STRING ButtonText[1];
+    if (!HexEditFindPreviousFromCurrentPosition(HexEditContext, &Cancelled) &&
+        !Cancelled) {
 
-        YoriLibConstantString(&Title, _T("Find"));
-        YoriLibConstantString(&Text, _T("No more matches found."));
-        YoriLibConstantString(&ButtonText[0], _T("&Ok"));
-
-        YoriDlgMessageBox(YoriWinGetWindowManagerHandle(Parent),
-                          &Title,
-                          &Text,
-                          1,
-                          ButtonText,
-                          0,
-                          0);
+        HexEditDisplayFindFailure(HexEditContext, _T("No more matches found."));
     }
 }
 
@@ -1661,6 +1787,7 @@ HexEditChangeButtonClicked(
     YORI_STRING Title;
     BOOLEAN ReplaceAll;
     BOOLEAN MatchFound;
+    BOOLEAN Cancelled;
     BOOLEAN AsChar;
     PYORI_WIN_CTRL_HANDLE Parent;
     PHEXEDIT_CONTEXT HexEditContext;
@@ -1821,7 +1948,7 @@ HexEditChangeButtonClicked(
             StartOffset = StartOffset + NewDataLength;
         }
 
-        if (!HexEditFindNextFromPosition(HexEditContext, StartOffset, &NextMatchOffset)) {
+        if (!HexEditFindNextFromPosition(HexEditContext, StartOffset, &NextMatchOffset, &Cancelled)) {
             break;
         }
 
@@ -2149,13 +2276,12 @@ HexEditCalculatePEChecksumButtonClicked(
         return;
     }
 
-    if (!YoriWinHexEditGetDataNoCopy(HexEditContext->HexEdit, &Buffer, &BufferLength)) {
+    if (!YoriWinHexEditGetDataPointer(HexEditContext->HexEdit, &Buffer, &BufferLength)) {
         return;
     }
 
     PeHeaders = DllImageHlp.pCheckSumMappedFile(Buffer, BufferLength, &CurrentChecksum, &NewChecksum);
     if (PeHeaders == NULL) {
-        YoriLibDereference(Buffer);
         YoriLibConstantString(&Title, _T("Error"));
         YoriLibConstantString(&Text, _T("Could not calculate checksum.  Possibly not PE file?"));
         YoriLibConstantString(&ButtonText[0], _T("&Ok"));
@@ -2173,7 +2299,6 @@ HexEditCalculatePEChecksumButtonClicked(
 
     DataOffset = (YORI_ALLOC_SIZE_T)((PUCHAR)PeHeaders - Buffer);
     DataOffset = DataOffset + FIELD_OFFSET(YORILIB_PE_HEADERS, OptionalHeader.CheckSum);
-    YoriLibDereference(Buffer);
     YoriWinHexEditReplaceData(HexEditContext->HexEdit, DataOffset, &NewChecksum, sizeof(NewChecksum));
 }
 
@@ -2359,7 +2484,7 @@ HexEditPopulateMenuBar(
 {
     YORI_WIN_MENU_ENTRY FileMenuEntries[8];
     YORI_WIN_MENU_ENTRY EditMenuEntries[4];
-    YORI_WIN_MENU_ENTRY SearchMenuEntries[6];
+    YORI_WIN_MENU_ENTRY SearchMenuEntries[7];
     YORI_WIN_MENU_ENTRY ViewMenuEntries[8];
     YORI_WIN_MENU_ENTRY ToolsMenuEntries[1];
     YORI_WIN_MENU_ENTRY HelpMenuEntries[1];
@@ -2441,6 +2566,10 @@ HexEditPopulateMenuBar(
     SearchMenuEntries[MenuIndex].NotifyCallback = HexEditFindButtonClicked;
     MenuIndex++;
 
+    YoriLibConstantString(&SearchMenuEntries[MenuIndex].Caption, _T("Find &All..."));
+    SearchMenuEntries[MenuIndex].NotifyCallback = HexEditFindAllButtonClicked;
+    MenuIndex++;
+
     YoriLibConstantString(&SearchMenuEntries[MenuIndex].Caption, _T("&Repeat Last Find"));
     YoriLibConstantString(&SearchMenuEntries[MenuIndex].Hotkey, _T("F3"));
     SearchMenuEntries[MenuIndex].NotifyCallback = HexEditFindNextButtonClicked;
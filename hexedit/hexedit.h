@@ -0,0 +1,74 @@
+/**
+ * @file hexedit/hexedit.h
+ *
+ * Yori shell hex editor shared function header
+ *
+ * Copyright (c) 2026 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+__success(return)
+BOOLEAN
+HexEditFindNextMemorySubset(
+    __in PUCHAR Buffer,
+    __in YORI_ALLOC_SIZE_T BufferLength,
+    __in YORI_ALLOC_SIZE_T BufferOffset,
+    __in PUCHAR SearchBuffer,
+    __in YORI_ALLOC_SIZE_T SearchBufferLength,
+    __out PYORI_ALLOC_SIZE_T FoundOffset
+    );
+
+__success(return)
+BOOLEAN
+HexEditFindPreviousMemorySubset(
+    __in PUCHAR Buffer,
+    __in YORI_ALLOC_SIZE_T BufferLength,
+    __in YORI_ALLOC_SIZE_T BufferOffset,
+    __in PUCHAR SearchBuffer,
+    __in YORI_ALLOC_SIZE_T SearchBufferLength,
+    __out PYORI_ALLOC_SIZE_T FoundOffset
+    );
+
+__success(return)
+BOOLEAN
+HexEditFindData(
+    __in PYORI_WIN_WINDOW_MANAGER_HANDLE WinMgr,
+    __in PUCHAR Buffer,
+    __in YORI_ALLOC_SIZE_T BufferLength,
+    __in YORI_ALLOC_SIZE_T StartOffset,
+    __in PUCHAR SearchBuffer,
+    __in YORI_ALLOC_SIZE_T SearchBufferLength,
+    __in BOOLEAN Backward,
+    __out PYORI_ALLOC_SIZE_T FoundOffset,
+    __out PBOOLEAN Cancelled
+    );
+
+__success(return)
+BOOLEAN
+HexEditFindAllData(
+    __in PYORI_WIN_WINDOW_MANAGER_HANDLE WinMgr,
+    __in PUCHAR Buffer,
+    __in YORI_ALLOC_SIZE_T BufferLength,
+    __in PUCHAR SearchBuffer,
+    __in YORI_ALLOC_SIZE_T SearchBufferLength,
+    __out PYORI_ALLOC_SIZE_T SelectedOffset
+    );
+
+// vim:sw=4:ts=4:et:
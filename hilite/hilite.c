@@ -37,15 +37,25 @@ CHAR strHiliteHelpText[] =
         "or text matching specified criteria.\n"
         "\n"
         "HILITE [-license] [-b] [-c <string> <color>] [-h <string> <color>]\n"
-        "       [-i] [-m] [-s] [-t <string> <color>] [<file>...]\n"
+        "       [-i] [-j <count>] [-l] [-m] [-o] [-r <regex> <color>] [-s]\n"
+        "       [-t <string> <color>] [<file>...]\n"
         "\n"
         "   -b             Use basic search criteria for files only\n"
         "   -c             Highlight lines containing <string> with <color>\n"
         "   -h             Highlight lines starting with <string> with <color>\n"
         "   -i             Match insensitively\n"
+        "   -j <count>     Process up to count files concurrently when output is\n"
+        "                    not to a console\n"
+        "   -l             Output only the names of files containing a match\n"
         "   -m             Highlight matching text (as opposed to matching lines)\n"
+        "   -o             Output only matching lines, preceded by file name and\n"
+        "                    line number\n"
+        "   -r             Highlight lines matching regular expression <regex> with\n"
+        "                    <color>\n"
         "   -s             Process files from all subdirectories\n"
-        "   -t             Highlight lines ending with <string> with <color>\n";
+        "   -t             Highlight lines ending with <string> with <color>\n"
+        "\n"
+        "With -l or -o, files that appear to be binary are skipped.\n";
 
 /**
  Display usage text to the user.
@@ -61,13 +71,30 @@ HiliteHelp(VOID)
     return TRUE;
 }
 
+/**
+ The maximum number of files that can be processed concurrently.
+ */
+#define HILITE_MAX_WORKERS (64)
+
+/**
+ The number of characters to grow a buffer containing the output for a file
+ by, beyond the amount immediately needed.
+ */
+#define HILITE_OUTPUT_GROW_CHARS (64 * 1024)
+
+/**
+ The number of bytes at the start of a file to check for binary data.
+ */
+#define HILITE_BINARY_CHECK_BYTES (4096)
+
 /**
  The types of matches this program supports.
  */
 typedef enum _HILITE_MATCH_TYPE {
     HiliteMatchTypeBeginsWith = 1,
     HiliteMatchTypeEndsWith = 2,
-    HiliteMatchTypeContains = 3
+    HiliteMatchTypeContains = 3,
+    HiliteMatchTypeRegex = 4
 } HILITE_MATCH_TYPE;
 
 /**
@@ -87,16 +114,60 @@ typedef struct _HILITE_MATCH_CRITERIA {
     HILITE_MATCH_TYPE MatchType;
 
     /**
-     A string to compare with to determine a match.
+     A string to compare with to determine a match.  For a regular
+     expression match, this is the text of the expression.
      */
     YORI_STRING MatchString;
 
+    /**
+     For a regular expression match, the compiled expression.
+     */
+    YORI_LIB_REGEX Regex;
+
+    /**
+     TRUE if Regex has been compiled and needs to be cleaned up.
+     */
+    BOOLEAN RegexCompiled;
+
     /**
      The color to apply to the line, in event of a match.
      */
     YORILIB_COLOR_ATTRIBUTES Color;
 } HILITE_MATCH_CRITERIA, *PHILITE_MATCH_CRITERIA;
 
+/**
+ A single file to process on a worker thread.
+ */
+typedef struct _HILITE_JOB {
+
+    /**
+     The work queue item for this job.  Output is displayed in the order
+     that jobs are queued.
+     */
+    YORILIB_WORK_ITEM WorkItem;
+
+    /**
+     A handle to the file to process.
+     */
+    HANDLE FileHandle;
+
+    /**
+     The path to the file.  This is allocated as part of the job.
+     */
+    YORI_STRING FilePath;
+
+    /**
+     On completion, the highlighted contents of the file, including VT
+     escapes to change color.
+     */
+    YORI_STRING Output;
+
+    /**
+     Set to TRUE if Output contains the complete output for the file.
+     */
+    BOOLEAN Succeeded;
+} HILITE_JOB, *PHILITE_JOB;
+
 /**
  Context passed to the callback which is invoked for each file found.
  */
@@ -119,6 +190,18 @@ typedef struct _HILITE_CONTEXT {
      */
     BOOLEAN HighlightMatchText;
 
+    /**
+     TRUE if only lines matching a criteria should be displayed, preceded
+     by the file name and line number.
+     */
+    BOOLEAN MatchingLinesOnly;
+
+    /**
+     TRUE if only the names of files containing a line matching a criteria
+     should be displayed.
+     */
+    BOOLEAN MatchingFilesOnly;
+
     /**
      TRUE if file enumeration is being performed recursively; FALSE if it is
      in one directory only.
@@ -145,6 +228,47 @@ typedef struct _HILITE_CONTEXT {
      */
     YORI_LIST_ENTRY EndMatches;
 
+    /**
+     TRUE if ContainsMatcher has been initialized and can be used to search
+     for all of the matches in MiddleMatches at once.  FALSE if each match
+     should be searched for individually.
+     */
+    BOOLEAN ContainsMatcherValid;
+
+    /**
+     The number of elements in ContainsStrings and ContainsCriteria.
+     */
+    YORI_ALLOC_SIZE_T ContainsCount;
+
+    /**
+     An array of the strings from MiddleMatches, in list order.
+     */
+    PYORI_STRING ContainsStrings;
+
+    /**
+     An array of the criteria corresponding to each element in
+     ContainsStrings.
+     */
+    PHILITE_MATCH_CRITERIA *ContainsCriteria;
+
+    /**
+     A matcher to search for every string in ContainsStrings in one pass
+     over a line.
+     */
+    YORI_LIB_SUBSTRING_MATCHER ContainsMatcher;
+
+    /**
+     The number of worker threads to process files on.  If this is one,
+     files are processed on the main thread.
+     */
+    DWORD WorkerCount;
+
+    /**
+     A queue of files to process on worker threads.  If NULL, files are
+     processed on the main thread.
+     */
+    PYORILIB_WORK_QUEUE WorkQueue;
+
 } HILITE_CONTEXT, *PHILITE_CONTEXT;
 
 /**
@@ -214,6 +338,319 @@ HiliteGetNextMatch(
     return NULL;
 }
 
+/**
+ Prepare to search for all of the matches that can be anywhere in a line in
+ a single pass.  If this fails, each match is searched for individually.
+
+ @param HiliteContext Pointer to the context.
+ */
+VOID
+HiliteBuildContainsMatcher(
+    __inout PHILITE_CONTEXT HiliteContext
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PHILITE_MATCH_CRITERIA MatchCriteria;
+    YORI_ALLOC_SIZE_T Count;
+
+    Count = 0;
+    ListEntry = YoriLibGetNextListEntry(&HiliteContext->MiddleMatches, NULL);
+    while (ListEntry != NULL) {
+        MatchCriteria = CONTAINING_RECORD(ListEntry, HILITE_MATCH_CRITERIA, ListEntry);
+        if (MatchCriteria->MatchType == HiliteMatchTypeContains) {
+            Count++;
+        }
+        ListEntry = YoriLibGetNextListEntry(&HiliteContext->MiddleMatches, ListEntry);
+    }
+
+    if (Count == 0) {
+        return;
+    }
+
+    HiliteContext->ContainsStrings = YoriLibMalloc((YORI_ALLOC_SIZE_T)(Count * (sizeof(YORI_STRING) + sizeof(PHILITE_MATCH_CRITERIA))));
+    if (HiliteContext->ContainsStrings == NULL) {
+        return;
+    }
+    HiliteContext->ContainsCriteria = (PHILITE_MATCH_CRITERIA *)(HiliteContext->ContainsStrings + Count);
+
+    //
+    //  When highlighting text, an empty string can never be the match that
+    //  is highlighted, so don't search for it.
+    //
+
+    Count = 0;
+    ListEntry = YoriLibGetNextListEntry(&HiliteContext->MiddleMatches, NULL);
+    while (ListEntry != NULL) {
+        MatchCriteria = CONTAINING_RECORD(ListEntry, HILITE_MATCH_CRITERIA, ListEntry);
+        if (MatchCriteria->MatchType == HiliteMatchTypeContains &&
+            (!HiliteContext->HighlightMatchText || MatchCriteria->MatchString.LengthInChars > 0)) {
+            HiliteContext->ContainsStrings[Count].StartOfString = MatchCriteria->MatchString.StartOfString;
+            HiliteContext->ContainsStrings[Count].LengthInChars = MatchCriteria->MatchString.LengthInChars;
+            HiliteContext->ContainsStrings[Count].LengthAllocated = 0;
+            HiliteContext->ContainsStrings[Count].MemoryToFree = NULL;
+            HiliteContext->ContainsCriteria[Count] = MatchCriteria;
+            Count++;
+        }
+        ListEntry = YoriLibGetNextListEntry(&HiliteContext->MiddleMatches, ListEntry);
+    }
+
+    HiliteContext->ContainsCount = Count;
+    if (YoriLibSubstringMatcherInitialize(&HiliteContext->ContainsMatcher,
+                                          HiliteContext->ContainsCount,
+                                          HiliteContext->ContainsStrings,
+                                          HiliteContext->Insensitive)) {
+        HiliteContext->ContainsMatcherValid = TRUE;
+    }
+}
+
+/**
+ Output a string, either to standard output or by appending it to a buffer.
+
+ @param OutputBuffer If specified, points to a buffer to append the string
+        to, which is reallocated if needed.  If NULL, the string is written
+        to standard output.
+
+ @param String Pointer to the string to output.
+
+ @return TRUE to indicate success, FALSE if the buffer could not be
+         reallocated.
+ */
+BOOLEAN
+HiliteOutputString(
+    __inout_opt PYORI_STRING OutputBuffer,
+    __in PYORI_STRING String
+    )
+{
+    YORI_MAX_UNSIGNED_T CharsNeeded;
+
+    if (OutputBuffer == NULL) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y"), String);
+        return TRUE;
+    }
+
+    CharsNeeded = (YORI_MAX_UNSIGNED_T)OutputBuffer->LengthInChars + String->LengthInChars;
+    if (CharsNeeded > OutputBuffer->LengthAllocated) {
+        CharsNeeded = CharsNeeded + OutputBuffer->LengthInChars / 2 + HILITE_OUTPUT_GROW_CHARS;
+        if (!YoriLibIsSizeAllocatable(CharsNeeded * sizeof(TCHAR)) ||
+            !YoriLibReallocString(OutputBuffer, (YORI_ALLOC_SIZE_T)CharsNeeded)) {
+
+            return FALSE;
+        }
+    }
+
+    memcpy(&OutputBuffer->StartOfString[OutputBuffer->LengthInChars], String->StartOfString, String->LengthInChars * sizeof(TCHAR));
+    OutputBuffer->LengthInChars = OutputBuffer->LengthInChars + String->LengthInChars;
+    return TRUE;
+}
+
+/**
+ Change the color of subsequent output, either on standard output or by
+ appending a VT escape to a buffer.
+
+ @param OutputBuffer If specified, points to a buffer to append the escape
+        to, which is reallocated if needed.  If NULL, the color is changed
+        on standard output.
+
+ @param Attribute The Win32 color code to make active.
+
+ @return TRUE to indicate success, FALSE if the buffer could not be
+         reallocated.
+ */
+BOOLEAN
+HiliteOutputColor(
+    __inout_opt PYORI_STRING OutputBuffer,
+    __in WORD Attribute
+    )
+{
+    TCHAR EscapeBuffer[YORI_MAX_VT_ESCAPE_CHARS];
+    YORI_STRING Escape;
+
+    if (OutputBuffer == NULL) {
+        YoriLibVtSetConsoleTextAttr(YORI_LIB_OUTPUT_STDOUT, Attribute);
+        return TRUE;
+    }
+
+    YoriLibInitEmptyString(&Escape);
+    Escape.StartOfString = EscapeBuffer;
+    Escape.LengthAllocated = sizeof(EscapeBuffer)/sizeof(EscapeBuffer[0]);
+    if (!YoriLibVtStringForTextAttribute(&Escape, 0, Attribute)) {
+        return FALSE;
+    }
+
+    return HiliteOutputString(OutputBuffer, &Escape);
+}
+
+/**
+ Determine whether a line matches any criteria, which means it would be
+ displayed with a color other than the default.
+
+ @param HiliteContext Pointer to the context.
+
+ @param LineString Pointer to the line.
+
+ @return TRUE if the line matches any criteria, FALSE if it does not.
+ */
+BOOLEAN
+HiliteLineMatches(
+    __in PHILITE_CONTEXT HiliteContext,
+    __in PYORI_STRING LineString
+    )
+{
+    PYORI_LIST_ENTRY ListHead;
+    PHILITE_MATCH_CRITERIA MatchCriteria;
+    YORI_STRING TailOfLine;
+    YORI_ALLOC_SIZE_T MatchOffset;
+    YORI_ALLOC_SIZE_T MatchLength;
+    BOOLEAN MatchFound;
+
+    if (HiliteContext->ContainsMatcherValid &&
+        YoriLibSubstringMatcherFindByPriority(&HiliteContext->ContainsMatcher, LineString, &MatchOffset) != NULL) {
+
+        return TRUE;
+    }
+
+    ListHead = NULL;
+    MatchCriteria = HiliteGetNextMatch(HiliteContext, &ListHead, NULL);
+    while (MatchCriteria != NULL) {
+
+        MatchFound = FALSE;
+        MatchLength = MatchCriteria->MatchString.LengthInChars;
+        if (MatchCriteria->MatchType == HiliteMatchTypeBeginsWith) {
+            if (HiliteContext->Insensitive) {
+                MatchFound = (BOOLEAN)(YoriLibCompareStringInsCnt(LineString, &MatchCriteria->MatchString, MatchCriteria->MatchString.LengthInChars) == 0);
+            } else {
+                MatchFound = (BOOLEAN)(YoriLibCompareStringCnt(LineString, &MatchCriteria->MatchString, MatchCriteria->MatchString.LengthInChars) == 0);
+            }
+        } else if (MatchCriteria->MatchType == HiliteMatchTypeEndsWith) {
+            if (LineString->LengthInChars >= MatchCriteria->MatchString.LengthInChars) {
+                YoriLibInitEmptyString(&TailOfLine);
+                TailOfLine.LengthInChars = MatchCriteria->MatchString.LengthInChars;
+                TailOfLine.StartOfString = &LineString->StartOfString[LineString->LengthInChars - MatchCriteria->MatchString.LengthInChars];
+                if (HiliteContext->Insensitive) {
+                    MatchFound = (BOOLEAN)(YoriLibCompareStringIns(&TailOfLine, &MatchCriteria->MatchString) == 0);
+                } else {
+                    MatchFound = (BOOLEAN)(YoriLibCompareString(&TailOfLine, &MatchCriteria->MatchString) == 0);
+                }
+            }
+        } else if (MatchCriteria->MatchType == HiliteMatchTypeContains &&
+                   !HiliteContext->ContainsMatcherValid) {
+            if (HiliteContext->Insensitive) {
+                MatchFound = (BOOLEAN)(YoriLibFindFirstMatchSubstrIns(LineString, 1, &MatchCriteria->MatchString, &MatchOffset) != NULL);
+            } else {
+                MatchFound = (BOOLEAN)(YoriLibFindFirstMatchSubstr(LineString, 1, &MatchCriteria->MatchString, &MatchOffset) != NULL);
+            }
+        } else if (MatchCriteria->MatchType == HiliteMatchTypeRegex) {
+            MatchFound = (BOOLEAN)YoriLibRegexSearch(&MatchCriteria->Regex, LineString, 0, &MatchOffset, &MatchLength);
+            while (MatchFound &&
+                   MatchLength == 0 &&
+                   HiliteContext->HighlightMatchText &&
+                   MatchOffset < LineString->LengthInChars) {
+
+                MatchFound = (BOOLEAN)YoriLibRegexSearch(&MatchCriteria->Regex, LineString, MatchOffset + 1, &MatchOffset, &MatchLength);
+            }
+        }
+
+        //
+        //  When highlighting text, an empty match is never highlighted.
+        //
+
+        if (MatchFound &&
+            (MatchLength > 0 || !HiliteContext->HighlightMatchText)) {
+
+            return TRUE;
+        }
+
+        MatchCriteria = HiliteGetNextMatch(HiliteContext, &ListHead, MatchCriteria);
+    }
+
+    return FALSE;
+}
+
+/**
+ Determine whether a file appears to contain binary data rather than text,
+ by checking for a NUL byte near the start of the file.  Files beginning
+ with a UTF-16 byte order mark are treated as text.  The file position is
+ restored to the start of the file.
+
+ @param hSource Handle to the file.
+
+ @return TRUE if the file appears to be binary, FALSE if it appears to be
+         text.
+ */
+BOOLEAN
+HiliteIsBinaryFile(
+    __in HANDLE hSource
+    )
+{
+    UCHAR Buffer[HILITE_BINARY_CHECK_BYTES];
+    DWORD BytesRead;
+    DWORD Index;
+    BOOLEAN Binary;
+
+    Binary = FALSE;
+    if (!ReadFile(hSource, Buffer, sizeof(Buffer), &BytesRead, NULL)) {
+        BytesRead = 0;
+    }
+
+    if (BytesRead >= 2 &&
+        ((Buffer[0] == 0xFF && Buffer[1] == 0xFE) ||
+         (Buffer[0] == 0xFE && Buffer[1] == 0xFF))) {
+
+        BytesRead = 0;
+    }
+
+    for (Index = 0; Index < BytesRead; Index++) {
+        if (Buffer[Index] == 0) {
+            Binary = TRUE;
+            break;
+        }
+    }
+
+    SetFilePointer(hSource, 0, NULL, FILE_BEGIN);
+    return Binary;
+}
+
+/**
+ Output the file name and line number preceding a matching line.
+
+ @param OutputBuffer If specified, points to a buffer to append the prefix
+        to.  If NULL, the prefix is written to standard output.
+
+ @param FileName If specified, points to the name of the file.  If NULL,
+        only the line number is output.
+
+ @param LineNumber The line number, starting from one.
+
+ @return TRUE to indicate success, FALSE if the buffer could not be
+         reallocated.
+ */
+BOOLEAN
+HiliteOutputLinePrefix(
+    __inout_opt PYORI_STRING OutputBuffer,
+    __in_opt PYORI_STRING FileName,
+    __in LONGLONG LineNumber
+    )
+{
+    TCHAR NumberBuffer[32];
+    YORI_STRING Prefix;
+
+    if (FileName != NULL) {
+        if (!HiliteOutputString(OutputBuffer, FileName)) {
+            return FALSE;
+        }
+        YoriLibConstantString(&Prefix, _T(":"));
+        if (!HiliteOutputString(OutputBuffer, &Prefix)) {
+            return FALSE;
+        }
+    }
+
+    YoriLibInitEmptyString(&Prefix);
+    Prefix.StartOfString = NumberBuffer;
+    Prefix.LengthAllocated = sizeof(NumberBuffer)/sizeof(NumberBuffer[0]);
+    Prefix.LengthInChars = YoriLibSPrintfS(Prefix.StartOfString, Prefix.LengthAllocated, _T("%lli:"), LineNumber);
+    return HiliteOutputString(OutputBuffer, &Prefix);
+}
+
 /**
  Process a stream and apply the hilite criteria before outputting to standard
  output.
@@ -223,12 +660,22 @@ HiliteGetNextMatch(
  @param HiliteContext Pointer to a set of criteria to apply to the stream
         before outputting.
 
+ @param FileName If specified, points to the name of the file being
+        processed.  If NULL, the stream is not a file and cannot be checked
+        for binary data.
+
+ @param OutputBuffer If specified, points to a buffer to append the output
+        to.  This is used when processing on a worker thread, and output is
+        not to a console.  If NULL, output is written to standard output.
+
  @return TRUE for success, FALSE on failure.
  */
 BOOL
 HiliteProcessStream(
     __in HANDLE hSource,
-    __in PHILITE_CONTEXT HiliteContext
+    __in PHILITE_CONTEXT HiliteContext,
+    __in_opt PYORI_STRING FileName,
+    __inout_opt PYORI_STRING OutputBuffer
     )
 {
     PVOID LineContext = NULL;
@@ -238,26 +685,84 @@ HiliteProcessStream(
     YORI_STRING DisplayString;
     PHILITE_MATCH_CRITERIA MatchCriteria;
     PHILITE_MATCH_CRITERIA BestMatchCriteria;
+    PHILITE_MATCH_CRITERIA ContainsMatchCriteria;
+    PYORI_STRING ContainsMatch;
     YORI_ALLOC_SIZE_T BestMatchOffset;
+    YORI_ALLOC_SIZE_T BestMatchLength;
+    YORI_ALLOC_SIZE_T ContainsMatchOffset;
+    YORI_ALLOC_SIZE_T SubstringOffset;
+    YORI_ALLOC_SIZE_T RegexOffset;
+    YORI_ALLOC_SIZE_T MatchLength;
     YORILIB_COLOR_ATTRIBUTES ColorToUse;
     PYORI_LIST_ENTRY ListHead;
     BOOLEAN MatchFound;
     BOOLEAN AnyMatchFound;
+    BOOLEAN Result;
     YORI_ALLOC_SIZE_T MatchOffset;
+    LONGLONG LineNumber;
+
+    //
+    //  When searching, skip files that aren't text.
+    //
+
+    if ((HiliteContext->MatchingLinesOnly || HiliteContext->MatchingFilesOnly) &&
+        FileName != NULL &&
+        HiliteIsBinaryFile(hSource)) {
+
+        return TRUE;
+    }
 
     YoriLibInitEmptyString(&LineString);
     YoriLibInitEmptyString(&Substring);
     YoriLibInitEmptyString(&DisplayString);
     MatchOffset = 0;
+    MatchLength = 0;
+    ContainsMatchOffset = 0;
+    LineNumber = 0;
+    Result = TRUE;
 
-    HiliteContext->FilesFound++;
+    while (Result) {
 
-    while (TRUE) {
-
-        if (!YoriLibReadLineToString(&LineString, &LineContext, hSource)) {
+        if (!YoriLibReadLineToView(&LineString, &LineContext, hSource)) {
             break;
         }
 
+        LineNumber++;
+
+        //
+        //  When searching, skip lines that don't match.  If only file
+        //  names are being displayed, the first match completes the file.
+        //
+
+        if (HiliteContext->MatchingLinesOnly || HiliteContext->MatchingFilesOnly) {
+            if (!HiliteLineMatches(HiliteContext, &LineString)) {
+                continue;
+            }
+
+            if (HiliteContext->MatchingFilesOnly) {
+                if (FileName != NULL) {
+                    DisplayString.StartOfString = FileName->StartOfString;
+                    DisplayString.LengthInChars = FileName->LengthInChars;
+                } else {
+                    YoriLibConstantString(&DisplayString, _T("-"));
+                }
+                if (!HiliteOutputString(OutputBuffer, &DisplayString)) {
+                    Result = FALSE;
+                    break;
+                }
+                YoriLibConstantString(&DisplayString, _T("\n"));
+                if (!HiliteOutputString(OutputBuffer, &DisplayString)) {
+                    Result = FALSE;
+                }
+                break;
+            }
+
+            if (!HiliteOutputLinePrefix(OutputBuffer, FileName, LineNumber)) {
+                Result = FALSE;
+                break;
+            }
+        }
+
         Substring.StartOfString = LineString.StartOfString;
         Substring.LengthInChars = LineString.LengthInChars;
         ColorToUse.Ctrl = HiliteContext->DefaultColor.Ctrl;
@@ -274,16 +779,40 @@ HiliteProcessStream(
 
             BestMatchCriteria = NULL;
             BestMatchOffset = 0;
+            BestMatchLength = 0;
             AnyMatchFound = FALSE;
+            SubstringOffset = (YORI_ALLOC_SIZE_T)(Substring.StartOfString - LineString.StartOfString);
             if (Substring.StartOfString == LineString.StartOfString) {
                 ListHead = &HiliteContext->StartMatches;
             } else {
                 ListHead = &HiliteContext->MiddleMatches;
             }
+
+            //
+            //  If all of the matches that can be in the middle of the line
+            //  can be searched for at once, find the one that would be
+            //  selected below.  When highlighting text, this is the earliest
+            //  match in the line; otherwise it is the first criteria that
+            //  matches anywhere.
+            //
+
+            ContainsMatchCriteria = NULL;
+            if (HiliteContext->ContainsMatcherValid) {
+                if (HiliteContext->HighlightMatchText) {
+                    ContainsMatch = YoriLibSubstringMatcherFindFirst(&HiliteContext->ContainsMatcher, &Substring, &ContainsMatchOffset);
+                } else {
+                    ContainsMatch = YoriLibSubstringMatcherFindByPriority(&HiliteContext->ContainsMatcher, &Substring, &ContainsMatchOffset);
+                }
+                if (ContainsMatch != NULL) {
+                    ContainsMatchCriteria = HiliteContext->ContainsCriteria[ContainsMatch - HiliteContext->ContainsStrings];
+                }
+            }
+
             MatchCriteria = NULL;
             MatchCriteria = HiliteGetNextMatch(HiliteContext, &ListHead, MatchCriteria);
             while (MatchCriteria != NULL) {
                 MatchFound = FALSE;
+                MatchLength = MatchCriteria->MatchString.LengthInChars;
                 if (MatchCriteria->MatchType == HiliteMatchTypeBeginsWith) {
                     if (HiliteContext->Insensitive) {
                         if (YoriLibCompareStringInsCnt(&Substring,
@@ -321,7 +850,12 @@ HiliteProcessStream(
                         }
                     }
                 } else if (MatchCriteria->MatchType == HiliteMatchTypeContains) {
-                    if (HiliteContext->Insensitive) {
+                    if (HiliteContext->ContainsMatcherValid) {
+                        if (MatchCriteria == ContainsMatchCriteria) {
+                            MatchFound = TRUE;
+                            MatchOffset = ContainsMatchOffset;
+                        }
+                    } else if (HiliteContext->Insensitive) {
                         if (YoriLibFindFirstMatchSubstrIns(&Substring, 1, &MatchCriteria->MatchString, &MatchOffset)) {
                             MatchFound = TRUE;
                         }
@@ -330,6 +864,26 @@ HiliteProcessStream(
                             MatchFound = TRUE;
                         }
                     }
+                } else if (MatchCriteria->MatchType == HiliteMatchTypeRegex) {
+
+                    //
+                    //  Search the whole line so that anchors refer to the
+                    //  line rather than the remaining text.  When
+                    //  highlighting text, an empty match can't be
+                    //  displayed, so look for a later nonempty one.
+                    //
+
+                    if (YoriLibRegexSearch(&MatchCriteria->Regex, &LineString, SubstringOffset, &RegexOffset, &MatchLength)) {
+                        MatchFound = TRUE;
+                        while (MatchFound &&
+                               MatchLength == 0 &&
+                               HiliteContext->HighlightMatchText &&
+                               RegexOffset < LineString.LengthInChars) {
+
+                            MatchFound = (BOOLEAN)YoriLibRegexSearch(&MatchCriteria->Regex, &LineString, RegexOffset + 1, &RegexOffset, &MatchLength);
+                        }
+                        MatchOffset = RegexOffset - SubstringOffset;
+                    }
                 }
 
 
@@ -345,13 +899,15 @@ HiliteProcessStream(
                     if (!HiliteContext->HighlightMatchText) {
                         BestMatchCriteria = MatchCriteria;
                         BestMatchOffset = MatchOffset;
+                        BestMatchLength = MatchLength;
                         break;
                     }
 
-                    if (MatchCriteria->MatchString.LengthInChars > 0 &&
+                    if (MatchLength > 0 &&
                         (BestMatchCriteria == NULL || MatchOffset < BestMatchOffset)) {
                         BestMatchCriteria = MatchCriteria;
                         BestMatchOffset = MatchOffset;
+                        BestMatchLength = MatchLength;
                     }
                 }
 
@@ -373,12 +929,15 @@ HiliteProcessStream(
                 if (HiliteContext->HighlightMatchText) {
                     if (BestMatchOffset > 0) {
                         DisplayString.LengthInChars = BestMatchOffset;
-                        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y"), &DisplayString);
+                        if (!HiliteOutputString(OutputBuffer, &DisplayString)) {
+                            Result = FALSE;
+                            break;
+                        }
                         DisplayString.StartOfString = &Substring.StartOfString[BestMatchOffset];
                         Substring.LengthInChars = Substring.LengthInChars - BestMatchOffset;
                         Substring.StartOfString = &Substring.StartOfString[BestMatchOffset];
                     }
-                    DisplayString.LengthInChars = BestMatchCriteria->MatchString.LengthInChars;
+                    DisplayString.LengthInChars = BestMatchLength;
                     //
                     //  If searching for an empty string, treat it as not
                     //  found and move to the next line.  This is only
@@ -399,9 +958,13 @@ HiliteProcessStream(
                     ColorToUse.Win32Attr = BestMatchCriteria->Color.Win32Attr;
                 }
 
-                YoriLibVtSetConsoleTextAttr(YORI_LIB_OUTPUT_STDOUT, ColorToUse.Win32Attr);
-                YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y"), &DisplayString);
-                YoriLibVtSetConsoleTextAttr(YORI_LIB_OUTPUT_STDOUT, HiliteContext->DefaultColor.Win32Attr);
+                if (!HiliteOutputColor(OutputBuffer, ColorToUse.Win32Attr) ||
+                    !HiliteOutputString(OutputBuffer, &DisplayString) ||
+                    !HiliteOutputColor(OutputBuffer, HiliteContext->DefaultColor.Win32Attr)) {
+
+                    Result = FALSE;
+                    break;
+                }
                 Substring.StartOfString = &Substring.StartOfString[DisplayString.LengthInChars];
                 Substring.LengthInChars = Substring.LengthInChars - DisplayString.LengthInChars;
             }
@@ -416,27 +979,243 @@ HiliteProcessStream(
             }
         }
 
+        if (!Result) {
+            break;
+        }
+
         //
         //  If no matches are found, display the line.
         //
 
-        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y"), &Substring);
+        if (!HiliteOutputString(OutputBuffer, &Substring)) {
+            Result = FALSE;
+            break;
+        }
 
         //
-        //  Apply a newline if needed.
+        //  Apply a newline if needed.  Buffered output is never to a
+        //  console, so always needs a newline.
         //
 
-        if (LineString.LengthInChars == 0 || !GetConsoleScreenBufferInfo(GetStdHandle(STD_OUTPUT_HANDLE), &ScreenInfo) || ScreenInfo.dwCursorPosition.X != 0) {
+        if (OutputBuffer != NULL) {
+            YoriLibConstantString(&DisplayString, _T("\n"));
+            if (!HiliteOutputString(OutputBuffer, &DisplayString)) {
+                Result = FALSE;
+                break;
+            }
+        } else if (LineString.LengthInChars == 0 || !GetConsoleScreenBufferInfo(GetStdHandle(STD_OUTPUT_HANDLE), &ScreenInfo) || ScreenInfo.dwCursorPosition.X != 0) {
             YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("\n"));
         }
     }
 
     YoriLibLineReadCloseOrCache(LineContext);
-    YoriLibFreeStringContents(&LineString);
 
+    return Result;
+}
+
+/**
+ Process a file that has been found by the main thread, buffering its
+ output.  This is invoked on a worker thread.
+
+ @param Context Pointer to the hilite context.
+
+ @param WorkerContext Unused.
+
+ @param Item Pointer to the work queue item within the job to process.
+
+ @return TRUE to indicate the worker should continue processing jobs.
+ */
+BOOLEAN
+HiliteExecuteJob(
+    __in PVOID Context,
+    __in PVOID WorkerContext,
+    __in PYORILIB_WORK_ITEM Item
+    )
+{
+    PHILITE_CONTEXT HiliteContext;
+    PHILITE_JOB Job;
+
+    UNREFERENCED_PARAMETER(WorkerContext);
+
+    HiliteContext = (PHILITE_CONTEXT)Context;
+    Job = CONTAINING_RECORD(Item, HILITE_JOB, WorkItem);
+
+    Job->Succeeded = (BOOLEAN)HiliteProcessStream(Job->FileHandle, HiliteContext, &Job->FilePath, &Job->Output);
     return TRUE;
 }
 
+/**
+ Display the output of a job which has been completed by a worker thread
+ and free it.  This is invoked on the main thread in the order the files
+ were found.
+
+ @param Context Pointer to the hilite context.
+
+ @param Item Pointer to the work queue item within the completed job.
+ */
+VOID
+HiliteCompleteJob(
+    __in PVOID Context,
+    __in PYORILIB_WORK_ITEM Item
+    )
+{
+    PHILITE_CONTEXT HiliteContext;
+    PHILITE_JOB Job;
+
+    HiliteContext = (PHILITE_CONTEXT)Context;
+    Job = CONTAINING_RECORD(Item, HILITE_JOB, WorkItem);
+
+    //
+    //  If the output could not be buffered, process the file again on this
+    //  thread, writing output as it is generated.
+    //
+
+    if (Job->Succeeded) {
+        YoriLibOutputString(GetStdHandle(STD_OUTPUT_HANDLE), 0, &Job->Output);
+    } else {
+        SetFilePointer(Job->FileHandle, 0, NULL, FILE_BEGIN);
+        HiliteProcessStream(Job->FileHandle, HiliteContext, &Job->FilePath, NULL);
+    }
+    CloseHandle(Job->FileHandle);
+    YoriLibFreeStringContents(&Job->Output);
+    YoriLibFree(Job);
+}
+
+/**
+ Display the output of jobs which have been completed by worker threads, in
+ the order the files were found, and wait for jobs to complete until no more
+ than a specified number remain outstanding.
+
+ @param HiliteContext Pointer to the hilite context.
+
+ @param JobsToLeaveOutstanding The number of jobs which may remain incomplete
+        when this function returns.  Zero waits for all jobs to complete.
+ */
+VOID
+HiliteCompleteJobs(
+    __in PHILITE_CONTEXT HiliteContext,
+    __in DWORD JobsToLeaveOutstanding
+    )
+{
+    if (HiliteContext->WorkQueue == NULL) {
+        return;
+    }
+
+    YoriLibWorkQueueComplete(HiliteContext->WorkQueue, JobsToLeaveOutstanding, INFINITE);
+}
+
+/**
+ Queue a file to be processed by a worker thread.
+
+ @param HiliteContext Pointer to the hilite context.
+
+ @param FileHandle A handle to the file to process.  On success, the job
+        owns this handle and will close it.
+
+ @param FilePath Pointer to the path to the file.
+
+ @return TRUE to indicate the job was queued, FALSE if it could not be.
+ */
+BOOL
+HiliteQueueFile(
+    __in PHILITE_CONTEXT HiliteContext,
+    __in HANDLE FileHandle,
+    __in PYORI_STRING FilePath
+    )
+{
+    PHILITE_JOB Job;
+    YORI_MAX_UNSIGNED_T BytesNeeded;
+
+    BytesNeeded = sizeof(HILITE_JOB);
+    BytesNeeded += ((YORI_MAX_UNSIGNED_T)FilePath->LengthInChars + 1) * sizeof(TCHAR);
+    if (!YoriLibIsSizeAllocatable(BytesNeeded)) {
+        return FALSE;
+    }
+
+    Job = YoriLibMalloc((YORI_ALLOC_SIZE_T)BytesNeeded);
+    if (Job == NULL) {
+        return FALSE;
+    }
+
+    Job->FileHandle = FileHandle;
+    YoriLibInitEmptyString(&Job->FilePath);
+    Job->FilePath.StartOfString = (LPTSTR)(Job + 1);
+    Job->FilePath.LengthAllocated = FilePath->LengthInChars + 1;
+    memcpy(Job->FilePath.StartOfString, FilePath->StartOfString, FilePath->LengthInChars * sizeof(TCHAR));
+    Job->FilePath.LengthInChars = FilePath->LengthInChars;
+    Job->FilePath.StartOfString[Job->FilePath.LengthInChars] = '\0';
+
+    YoriLibInitEmptyString(&Job->Output);
+    YoriLibWorkQueueInitializeItem(&Job->WorkItem);
+    Job->Succeeded = FALSE;
+
+    YoriLibWorkQueueSubmit(HiliteContext->WorkQueue, &Job->WorkItem);
+
+    //
+    //  Display anything that has completed.  Each outstanding job buffers
+    //  the output for an entire file, so limit the number of jobs to a
+    //  small multiple of the number of workers.
+    //
+
+    HiliteCompleteJobs(HiliteContext, HiliteContext->WorkerCount * 2);
+    return TRUE;
+}
+
+/**
+ Start worker threads to process files concurrently.  If this fails, files
+ are processed on the main thread.
+
+ @param HiliteContext Pointer to the hilite context.
+ */
+VOID
+HiliteStartWorkers(
+    __inout PHILITE_CONTEXT HiliteContext
+    )
+{
+    DWORD Index;
+
+    if (HiliteContext->WorkerCount <= 1) {
+        return;
+    }
+
+    HiliteContext->WorkQueue = YoriLibWorkQueueCreate(YORILIB_WORK_QUEUE_KEEP_ORDER, 1, HiliteExecuteJob, HiliteCompleteJob, HiliteContext);
+    if (HiliteContext->WorkQueue == NULL) {
+        return;
+    }
+
+    //
+    //  If fewer threads could be created than requested, use the ones that
+    //  were.
+    //
+
+    for (Index = 0; Index < HiliteContext->WorkerCount; Index++) {
+        if (!YoriLibWorkQueueAddWorker(HiliteContext->WorkQueue, NULL)) {
+            break;
+        }
+    }
+
+    if (Index == 0) {
+        YoriLibWorkQueueDestroy(HiliteContext->WorkQueue);
+        HiliteContext->WorkQueue = NULL;
+    }
+}
+
+/**
+ Display the output of any outstanding jobs and terminate worker threads.
+
+ @param HiliteContext Pointer to the hilite context.
+ */
+VOID
+HiliteStopWorkers(
+    __inout PHILITE_CONTEXT HiliteContext
+    )
+{
+    if (HiliteContext->WorkQueue != NULL) {
+        YoriLibWorkQueueDestroy(HiliteContext->WorkQueue);
+        HiliteContext->WorkQueue = NULL;
+    }
+}
+
 /**
  A callback that is invoked when a file is found that matches a search criteria
  specified in the set of strings to enumerate.
@@ -484,7 +1263,22 @@ HiliteFileFoundCallback(
             return TRUE;
         }
 
-        HiliteProcessStream(FileHandle, HiliteContext);
+        HiliteContext->FilesFound++;
+
+        if (HiliteContext->WorkQueue != NULL &&
+            HiliteQueueFile(HiliteContext, FileHandle, FilePath)) {
+
+            return TRUE;
+        }
+
+        //
+        //  If there are no workers, or the file could not be queued,
+        //  process it on this thread after displaying the output of
+        //  anything queued previously.
+        //
+
+        HiliteCompleteJobs(HiliteContext, 0);
+        HiliteProcessStream(FileHandle, HiliteContext, FilePath, NULL);
 
         CloseHandle(FileHandle);
     }
@@ -567,11 +1361,25 @@ HiliteCleanupContext(
     PHILITE_MATCH_CRITERIA NextMatchCriteria;
     PYORI_LIST_ENTRY ListHead;
 
+    if (HiliteContext->ContainsMatcherValid) {
+        YoriLibSubstringMatcherCleanup(&HiliteContext->ContainsMatcher);
+        HiliteContext->ContainsMatcherValid = FALSE;
+    }
+
+    if (HiliteContext->ContainsStrings != NULL) {
+        YoriLibFree(HiliteContext->ContainsStrings);
+        HiliteContext->ContainsStrings = NULL;
+        HiliteContext->ContainsCriteria = NULL;
+    }
+
     ListHead = &HiliteContext->StartMatches;
 
     MatchCriteria = HiliteGetNextMatch(HiliteContext, &ListHead, NULL);
     while (MatchCriteria != NULL) {
         NextMatchCriteria = HiliteGetNextMatch(HiliteContext, &ListHead, MatchCriteria);
+        if (MatchCriteria->RegexCompiled) {
+            YoriLibRegexCleanup(&MatchCriteria->Regex);
+        }
         YoriLibRemoveListItem(&MatchCriteria->ListEntry);
         YoriLibFree(MatchCriteria);
         MatchCriteria = NextMatchCriteria;
@@ -615,6 +1423,7 @@ ENTRYPOINT(
     HILITE_CONTEXT HiliteContext;
     CONSOLE_SCREEN_BUFFER_INFO ScreenInfo;
     PHILITE_MATCH_CRITERIA NewCriteria;
+    PYORI_LIST_ENTRY ListEntry;
     YORI_STRING Arg;
 
     ZeroMemory(&HiliteContext, sizeof(HiliteContext));
@@ -657,6 +1466,7 @@ ENTRYPOINT(
                         return EXIT_FAILURE;
                     }
                     NewCriteria->MatchType = HiliteMatchTypeContains;
+                    NewCriteria->RegexCompiled = FALSE;
                     YoriLibInitEmptyString(&NewCriteria->MatchString);
                     NewCriteria->MatchString.StartOfString = ArgV[i + 1].StartOfString;
                     NewCriteria->MatchString.LengthInChars = ArgV[i + 1].LengthInChars;
@@ -674,6 +1484,7 @@ ENTRYPOINT(
                         return EXIT_FAILURE;
                     }
                     NewCriteria->MatchType = HiliteMatchTypeBeginsWith;
+                    NewCriteria->RegexCompiled = FALSE;
                     YoriLibInitEmptyString(&NewCriteria->MatchString);
                     NewCriteria->MatchString.StartOfString = ArgV[i + 1].StartOfString;
                     NewCriteria->MatchString.LengthInChars = ArgV[i + 1].LengthInChars;
@@ -686,9 +1497,50 @@ ENTRYPOINT(
             } else if (YoriLibCompareStringLitIns(&Arg, _T("i")) == 0) {
                 HiliteContext.Insensitive = TRUE;
                 ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("j")) == 0) {
+                if (ArgC > i + 1) {
+                    YORI_ALLOC_SIZE_T CharsConsumed;
+                    YORI_MAX_SIGNED_T llTemp;
+                    if (YoriLibStringToNumber(&ArgV[i + 1], TRUE, &llTemp, &CharsConsumed) &&
+                        CharsConsumed > 0) {
+
+                        if (llTemp < 1) {
+                            llTemp = 1;
+                        } else if (llTemp > HILITE_MAX_WORKERS) {
+                            llTemp = HILITE_MAX_WORKERS;
+                        }
+                        HiliteContext.WorkerCount = (DWORD)llTemp;
+                        ArgumentUnderstood = TRUE;
+                        i++;
+                    }
+                }
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("l")) == 0) {
+                HiliteContext.MatchingFilesOnly = TRUE;
+                ArgumentUnderstood = TRUE;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("m")) == 0) {
                 HiliteContext.HighlightMatchText = TRUE;
                 ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("o")) == 0) {
+                HiliteContext.MatchingLinesOnly = TRUE;
+                ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("r")) == 0) {
+                if (i + 2 < ArgC) {
+                    NewCriteria = YoriLibMalloc(sizeof(HILITE_MATCH_CRITERIA));
+                    if (NewCriteria == NULL) {
+                        HiliteCleanupContext(&HiliteContext);
+                        return EXIT_FAILURE;
+                    }
+                    NewCriteria->MatchType = HiliteMatchTypeRegex;
+                    NewCriteria->RegexCompiled = FALSE;
+                    YoriLibInitEmptyString(&NewCriteria->MatchString);
+                    NewCriteria->MatchString.StartOfString = ArgV[i + 1].StartOfString;
+                    NewCriteria->MatchString.LengthInChars = ArgV[i + 1].LengthInChars;
+                    YoriLibAttributeFromLiteralString(ArgV[i + 2].StartOfString, &NewCriteria->Color);
+                    YoriLibResolveWindowColorComponents(NewCriteria->Color, HiliteContext.DefaultColor, FALSE, &NewCriteria->Color);
+                    YoriLibAppendList(&HiliteContext.MiddleMatches, &NewCriteria->ListEntry);
+                    ArgumentUnderstood = TRUE;
+                    i += 2;
+                }
             } else if (YoriLibCompareStringLitIns(&Arg, _T("s")) == 0) {
                 HiliteContext.Recursive = TRUE;
                 ArgumentUnderstood = TRUE;
@@ -700,6 +1552,7 @@ ENTRYPOINT(
                         return EXIT_FAILURE;
                     }
                     NewCriteria->MatchType = HiliteMatchTypeEndsWith;
+                    NewCriteria->RegexCompiled = FALSE;
                     YoriLibInitEmptyString(&NewCriteria->MatchString);
                     NewCriteria->MatchString.StartOfString = ArgV[i + 1].StartOfString;
                     NewCriteria->MatchString.LengthInChars = ArgV[i + 1].LengthInChars;
@@ -725,6 +1578,28 @@ ENTRYPOINT(
         }
     }
 
+    //
+    //  Compile any regular expressions now that it's known whether they
+    //  should match case insensitively.
+    //
+
+    ListEntry = YoriLibGetNextListEntry(&HiliteContext.MiddleMatches, NULL);
+    while (ListEntry != NULL) {
+        NewCriteria = CONTAINING_RECORD(ListEntry, HILITE_MATCH_CRITERIA, ListEntry);
+        ListEntry = YoriLibGetNextListEntry(&HiliteContext.MiddleMatches, ListEntry);
+        if (NewCriteria->MatchType != HiliteMatchTypeRegex) {
+            continue;
+        }
+        if (!YoriLibRegexCompile(&NewCriteria->Regex, &NewCriteria->MatchString, HiliteContext.Insensitive, NULL)) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("hilite: invalid regular expression: %y\n"), &NewCriteria->MatchString);
+            HiliteCleanupContext(&HiliteContext);
+            return EXIT_FAILURE;
+        }
+        NewCriteria->RegexCompiled = TRUE;
+    }
+
+    HiliteBuildContainsMatcher(&HiliteContext);
+
     //
     //  Attempt to enable backup privilege so an administrator can access more
     //  objects successfully.
@@ -744,16 +1619,46 @@ ENTRYPOINT(
             return EXIT_FAILURE;
         }
 
-        HiliteProcessStream(GetStdHandle(STD_INPUT_HANDLE), &HiliteContext);
+        HiliteContext.FilesFound++;
+        HiliteProcessStream(GetStdHandle(STD_INPUT_HANDLE), &HiliteContext, NULL, NULL);
     } else {
         MatchFlags = YORILIB_FILEENUM_RETURN_FILES | YORILIB_FILEENUM_DIRECTORY_CONTENTS;
         if (HiliteContext.Recursive) {
             MatchFlags |= YORILIB_FILEENUM_RECURSE_BEFORE_RETURN | YORILIB_FILEENUM_RECURSE_PRESERVE_WILD;
+
+            //
+            //  When searching, each match is displayed with its file name,
+            //  so files don't need to be processed in directory order.
+            //
+
+            if (HiliteContext.MatchingLinesOnly || HiliteContext.MatchingFilesOnly) {
+                MatchFlags |= YORILIB_FILEENUM_PARALLEL;
+            }
         }
         if (BasicEnumeration) {
             MatchFlags |= YORILIB_FILEENUM_BASIC_EXPANSION;
         }
 
+        //
+        //  Output to a console moves the cursor as each line is written,
+        //  which determines whether a newline is needed, so files are
+        //  processed in parallel only when output is to a file or pipe.
+        //  By default, use a worker for each processor.
+        //
+
+        if (GetConsoleScreenBufferInfo(GetStdHandle(STD_OUTPUT_HANDLE), &ScreenInfo)) {
+            HiliteContext.WorkerCount = 1;
+        } else if (HiliteContext.WorkerCount == 0) {
+            SYSTEM_INFO SystemInfo;
+            GetSystemInfo(&SystemInfo);
+            HiliteContext.WorkerCount = SystemInfo.dwNumberOfProcessors;
+            if (HiliteContext.WorkerCount > HILITE_MAX_WORKERS) {
+                HiliteContext.WorkerCount = HILITE_MAX_WORKERS;
+            }
+        }
+
+        HiliteStartWorkers(&HiliteContext);
+
         for (i = StartArg; i < ArgC; i++) {
 
             YoriLibForEachStream(&ArgV[i],
@@ -763,6 +1668,8 @@ ENTRYPOINT(
                                  HiliteFileEnumerateErrorCallback,
                                  &HiliteContext);
         }
+
+        HiliteStopWorkers(&HiliteContext);
     }
 
     HiliteCleanupContext(&HiliteContext);
@@ -35,12 +35,13 @@ CHAR strIconvHelpText[] =
         "\n"
         "Convert the character encoding of one or more files.\n"
         "\n"
-        "ICONV [-license] [-b] [-s] [-e <encoding>] [-i <encoding>] [<file>...]\n"
+        "ICONV [-license] [-b] [-p] [-s] [-e <encoding>] [-i <encoding>] [<file>...]\n"
         "\n"
         "   -b             Use basic search criteria for files only\n"
         "   -e <encoding>  Specifies the new encoding to use\n"
         "   -i <encoding>  Specifies the input (current) encoding\n"
         "   -m             Use traditional Mac line endings (CR)\n"
+        "   -p             Convert files in place rather than to standard output\n"
         "   -s             Process files from all subdirectories\n"
         "   -u             Use Unix line endings (LF)\n"
         "   -w             Use Windows line endings (CRLF)\n";
@@ -70,6 +71,12 @@ typedef struct _ICONV_CONTEXT {
      */
     BOOL Recursive;
 
+    /**
+     TRUE if each file should be replaced with its converted contents;
+     FALSE if converted contents should be written to standard output.
+     */
+    BOOL InPlace;
+
     /**
      The encoding to use when reading data.
      */
@@ -92,6 +99,38 @@ typedef struct _ICONV_CONTEXT {
 
 } ICONV_CONTEXT, *PICONV_CONTEXT;
 
+/**
+ The number of characters to accumulate before writing converted text to a
+ device that is not a console.
+ */
+#define ICONV_BLOCK_SIZE (64 * 1024)
+
+/**
+ Write any accumulated text in a block to the output device.
+
+ @param hTarget Handle to the output device.
+
+ @param Block Pointer to the accumulated text.  On completion, this is
+        emptied.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+IconvFlushBlock(
+    __in HANDLE hTarget,
+    __inout PYORI_STRING Block
+    )
+{
+    BOOL Result;
+
+    Result = TRUE;
+    if (Block->LengthInChars > 0) {
+        Result = YoriLibOutputString(hTarget, 0, Block);
+        Block->LengthInChars = 0;
+    }
+    return Result;
+}
+
 /**
  Convert the encoding of an opened stream by reading the source with the
  requested encoding, then writing to the destination with the requested
@@ -99,6 +138,8 @@ typedef struct _ICONV_CONTEXT {
 
  @param hSource Handle to the source.
 
+ @param hTarget Handle to the destination.
+
  @param IconvContext Specifies the encodings to apply.
 
  @return TRUE to indicate success, FALSE to indicate failure.
@@ -106,20 +147,41 @@ typedef struct _ICONV_CONTEXT {
 BOOL
 IconvProcessStream(
     __in HANDLE hSource,
+    __in HANDLE hTarget,
     __in PICONV_CONTEXT IconvContext
     )
 {
     PVOID LineContext = NULL;
     CONSOLE_SCREEN_BUFFER_INFO ScreenInfo;
     YORI_STRING LineString;
+    YORI_STRING Block;
     DWORD OriginalInputEncoding;
     DWORD OriginalOutputEncoding;
+    DWORD ConsoleMode;
     LPTSTR OriginalLineEnding;
     BOOL TimeoutReached;
+    BOOL TargetIsConsole;
+    BOOL Result;
     YORI_LIB_LINE_ENDING LineEnding;
 
     IconvContext->FilesFound++;
 
+    //
+    //  When writing to a console, each line is written individually so the
+    //  cursor position can be checked to see whether the line wrapped.
+    //  Otherwise, lines are accumulated into a block so that formatting,
+    //  encoding and writing is performed once per block rather than once
+    //  per line.
+    //
+
+    YoriLibInitEmptyString(&Block);
+    TargetIsConsole = GetConsoleMode(hTarget, &ConsoleMode);
+    if (!TargetIsConsole) {
+        if (!YoriLibAllocateString(&Block, ICONV_BLOCK_SIZE)) {
+            return FALSE;
+        }
+    }
+
     OriginalInputEncoding = YoriLibGetMultibyteInputEncoding();
     OriginalOutputEncoding = YoriLibGetMultibyteOutputEncoding();
     OriginalLineEnding = YoriLibVtGetLineEnding();
@@ -129,6 +191,7 @@ IconvProcessStream(
     YoriLibVtSetLineEnding(IconvContext->LineEnding);
 
     YoriLibInitEmptyString(&LineString);
+    Result = TRUE;
 
     while (TRUE) {
 
@@ -137,23 +200,166 @@ IconvProcessStream(
             break;
         }
 
-        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y"), &LineString);
+        if (!TargetIsConsole) {
+
+            //
+            //  If the line and its line ending don't fit in the remainder
+            //  of the block, write out the block.  If the line doesn't fit
+            //  in an empty block, write it directly.
+            //
+
+            if (Block.LengthInChars + LineString.LengthInChars + 1 > Block.LengthAllocated) {
+                if (!IconvFlushBlock(hTarget, &Block)) {
+                    Result = FALSE;
+                    break;
+                }
+
+                if (LineString.LengthInChars + 1 > Block.LengthAllocated) {
+                    if (!YoriLibOutputString(hTarget, 0, &LineString)) {
+                        Result = FALSE;
+                        break;
+                    }
+                    LineString.LengthInChars = 0;
+                }
+            }
+
+            memcpy(&Block.StartOfString[Block.LengthInChars], LineString.StartOfString, LineString.LengthInChars * sizeof(TCHAR));
+            Block.LengthInChars = Block.LengthInChars + LineString.LengthInChars;
+
+            //
+            //  A newline is converted into the requested line ending as the
+            //  block is written.
+            //
+
+            if (LineEnding != YoriLibLineEndingNone) {
+                Block.StartOfString[Block.LengthInChars] = '\n';
+                Block.LengthInChars++;
+            }
+
+            continue;
+        }
+
+        YoriLibOutputToDevice(hTarget, 0, _T("%y"), &LineString);
 
         if (LineEnding != YoriLibLineEndingNone) {
-            if (LineString.LengthInChars == 0 || !GetConsoleScreenBufferInfo(GetStdHandle(STD_OUTPUT_HANDLE), &ScreenInfo) || ScreenInfo.dwCursorPosition.X != 0) {
-                YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("\n"));
+            if (LineString.LengthInChars == 0 || !GetConsoleScreenBufferInfo(hTarget, &ScreenInfo) || ScreenInfo.dwCursorPosition.X != 0) {
+                YoriLibOutputToDevice(hTarget, 0, _T("\n"));
             }
         }
     }
 
+    if (Result && !TargetIsConsole) {
+        Result = IconvFlushBlock(hTarget, &Block);
+    }
+
     YoriLibSetMultibyteInputEncoding(OriginalInputEncoding);
     YoriLibSetMultibyteOutputEncoding(OriginalOutputEncoding);
     YoriLibVtSetLineEnding(OriginalLineEnding);
 
     YoriLibLineReadCloseOrCache(LineContext);
     YoriLibFreeStringContents(&LineString);
+    YoriLibFreeStringContents(&Block);
 
-    return TRUE;
+    return Result;
+}
+
+/**
+ Convert the encoding of a file, replacing its contents.  The converted data
+ is written to a temporary file in the same directory, which is renamed over
+ the original once conversion is complete, so the original contents are not
+ lost if conversion fails.
+
+ @param FilePath Pointer to the full path of the file to convert.
+
+ @param hSource Handle to the file, opened for read.  This is closed by this
+        function.
+
+ @param IconvContext Specifies the encodings to apply.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+IconvProcessFileInPlace(
+    __in PYORI_STRING FilePath,
+    __in HANDLE hSource,
+    __in PICONV_CONTEXT IconvContext
+    )
+{
+    YORI_STRING ParentDirectory;
+    YORI_STRING Prefix;
+    YORI_STRING TempFileName;
+    HANDLE hTemp;
+    YORI_ALLOC_SIZE_T Index;
+    BOOL Result;
+    DWORD LastError;
+    LPTSTR ErrText;
+
+    YoriLibInitEmptyString(&ParentDirectory);
+    for (Index = FilePath->LengthInChars; Index > 0; Index--) {
+        if (YoriLibIsSep(FilePath->StartOfString[Index - 1])) {
+            ParentDirectory.StartOfString = FilePath->StartOfString;
+            ParentDirectory.LengthInChars = Index - 1;
+            break;
+        }
+    }
+
+    if (Index == 0) {
+        YoriLibConstantString(&ParentDirectory, _T("."));
+    }
+
+    YoriLibConstantString(&Prefix, _T("ICNV"));
+    YoriLibInitEmptyString(&TempFileName);
+    if (!YoriLibGetTempFileName(&ParentDirectory, &Prefix, &hTemp, &TempFileName)) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("iconv: could not create temporary file in %y\n"), &ParentDirectory);
+        CloseHandle(hSource);
+        return FALSE;
+    }
+
+    Result = IconvProcessStream(hSource, hTemp, IconvContext);
+    CloseHandle(hSource);
+
+    if (!Result) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("iconv: could not write converted %y\n"), FilePath);
+    } else if (!FlushFileBuffers(hTemp)) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("iconv: could not flush converted %y\n"), FilePath);
+        Result = FALSE;
+    }
+
+    CloseHandle(hTemp);
+
+    //
+    //  If ReplaceFile is present, use it to retain the original file's
+    //  metadata.  If it is not present or fails, fall back to rename.
+    //
+
+    if (Result) {
+        Result = FALSE;
+        if (DllKernel32.pReplaceFileW != NULL &&
+            DllKernel32.pReplaceFileW(FilePath->StartOfString, TempFileName.StartOfString, NULL, 0, NULL, NULL)) {
+
+            Result = TRUE;
+        }
+
+        if (!Result &&
+            MoveFileEx(TempFileName.StartOfString, FilePath->StartOfString, MOVEFILE_REPLACE_EXISTING)) {
+
+            Result = TRUE;
+        }
+
+        if (!Result) {
+            LastError = GetLastError();
+            ErrText = YoriLibGetWinErrorText(LastError);
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("iconv: could not replace %y: %s"), FilePath, ErrText);
+            YoriLibFreeWinErrorText(ErrText);
+        }
+    }
+
+    if (!Result) {
+        DeleteFile(TempFileName.StartOfString);
+    }
+
+    YoriLibFreeStringContents(&TempFileName);
+    return Result;
 }
 
 /**
@@ -203,9 +409,12 @@ IconvFileFoundCallback(
             return TRUE;
         }
 
-        IconvProcessStream(FileHandle, IconvContext);
-
-        CloseHandle(FileHandle);
+        if (IconvContext->InPlace) {
+            IconvProcessFileInPlace(FilePath, FileHandle, IconvContext);
+        } else {
+            IconvProcessStream(FileHandle, GetStdHandle(STD_OUTPUT_HANDLE), IconvContext);
+            CloseHandle(FileHandle);
+        }
     }
 
     return TRUE;
@@ -376,6 +585,9 @@ ENTRYPOINT(
             } else if (YoriLibCompareStringLitIns(&Arg, _T("m")) == 0) {
                 IconvContext.LineEnding = _T("\r");
                 ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("p")) == 0) {
+                IconvContext.InPlace = TRUE;
+                ArgumentUnderstood = TRUE;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("u")) == 0) {
                 IconvContext.LineEnding = _T("\n");
                 ArgumentUnderstood = TRUE;
@@ -412,6 +624,13 @@ ENTRYPOINT(
 
     YoriLibEnableBackupPrivilege();
 
+    //
+    //  Buffer output so that each line isn't written separately when output
+    //  is going to a file or pipe.
+    //
+
+    YoriLibOutputBufferEnable(GetStdHandle(STD_OUTPUT_HANDLE));
+
     //
     //  If no file name is specified, use stdin; otherwise open
     //  the file and use that
@@ -419,11 +638,18 @@ ENTRYPOINT(
 
     if (StartArg == 0 || StartArg == ArgC) {
         if (YoriLibIsStdInConsole()) {
+            YoriLibOutputBufferDisable(GetStdHandle(STD_OUTPUT_HANDLE));
             YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("No file or pipe for input\n"));
             return EXIT_FAILURE;
         }
 
-        IconvProcessStream(GetStdHandle(STD_INPUT_HANDLE), &IconvContext);
+        if (IconvContext.InPlace) {
+            YoriLibOutputBufferDisable(GetStdHandle(STD_OUTPUT_HANDLE));
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("iconv: in place conversion requires a file\n"));
+            return EXIT_FAILURE;
+        }
+
+        IconvProcessStream(GetStdHandle(STD_INPUT_HANDLE), GetStdHandle(STD_OUTPUT_HANDLE), &IconvContext);
     } else {
         MatchFlags = YORILIB_FILEENUM_RETURN_FILES | YORILIB_FILEENUM_DIRECTORY_CONTENTS;
         if (IconvContext.Recursive) {
@@ -444,6 +670,8 @@ ENTRYPOINT(
         }
     }
 
+    YoriLibOutputBufferDisable(GetStdHandle(STD_OUTPUT_HANDLE));
+
 #if !YORI_BUILTIN
     YoriLibLineReadCleanupCache();
 #endif
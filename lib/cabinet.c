@@ -27,6 +27,65 @@
 #include <yoripch.h>
 #include <yorilib.h>
 
+/**
+ The number of compressed bytes to place in a single folder within a CAB
+ before starting a new folder.  Each folder is compressed as an independent
+ stream, so having multiple folders allows them to be expanded concurrently.
+ */
+#define YORI_LIB_CAB_FOLDER_THRESHOLD (1024 * 1024)
+
+/**
+ The maximum number of threads to use when expanding folders concurrently.
+ The thread that expands each folder is recorded in a UCHAR.
+ */
+#define YORI_LIB_CAB_MAX_EXPAND_THREADS (64)
+
+/**
+ The size of the fixed portion of a CAB header, before any optional fields.
+ */
+#define YORI_LIB_CAB_HEADER_SIZE (36)
+
+/**
+ The size of the fixed portion of each file entry in a CAB, before the
+ file name.
+ */
+#define YORI_LIB_CAB_FILE_ENTRY_SIZE (16)
+
+/**
+ The maximum length of a file name within a CAB, including the NULL
+ terminator.
+ */
+#define YORI_LIB_CAB_MAX_FILE_NAME (256)
+
+/**
+ A flag in the CAB header indicating the CAB continues from a previous CAB.
+ */
+#define YORI_LIB_CAB_FLAG_PREV_CABINET (0x0001)
+
+/**
+ A flag in the CAB header indicating the CAB continues into a following
+ CAB.
+ */
+#define YORI_LIB_CAB_FLAG_NEXT_CABINET (0x0002)
+
+/**
+ A folder index within a file entry indicating the file started in a
+ previous CAB.
+ */
+#define YORI_LIB_CAB_FOLDER_CONTINUED_FROM_PREV (0xFFFD)
+
+/**
+ A folder index within a file entry indicating the file continues into a
+ following CAB.
+ */
+#define YORI_LIB_CAB_FOLDER_CONTINUED_TO_NEXT (0xFFFE)
+
+/**
+ A folder index within a file entry indicating the file started in a
+ previous CAB and continues into a following CAB.
+ */
+#define YORI_LIB_CAB_FOLDER_CONTINUED_PREV_AND_NEXT (0xFFFF)
+
 /**
  Context information to pass around as files are being expanded.
  */
@@ -89,8 +148,78 @@ typedef struct _YORI_LIB_CAB_EXPAND_CONTEXT {
      */
     PYORI_STRING ErrorString;
 
+    /**
+     If more than one thread is expanding the CAB, a mutex to ensure that
+     the user specified callbacks are only invoked on one thread at a time.
+     NULL if only one thread is expanding the CAB.
+     */
+    HANDLE CallbackMutex;
+
+    /**
+     If more than one thread is expanding the CAB, an array indicating which
+     thread should expand each folder.  NULL if only one thread is expanding
+     the CAB.
+     */
+    PUCHAR FolderOwner;
+
+    /**
+     The number of elements in FolderOwner.
+     */
+    DWORD FolderCount;
+
+    /**
+     The index of the thread using this context.  Files in folders whose
+     FolderOwner entry does not match are skipped.
+     */
+    DWORD WorkerIndex;
+
+    /**
+     If not NULL, files are written to this handle rather than being
+     created in TargetDirectory.
+     */
+    HANDLE OutputHandle;
+
 } YORI_LIB_CAB_EXPAND_CONTEXT, *PYORI_LIB_CAB_EXPAND_CONTEXT;
 
+/**
+ State for a single thread expanding a subset of the folders within a CAB.
+ */
+typedef struct _YORI_LIB_CAB_EXPAND_WORKER {
+
+    /**
+     Context describing the files for this thread to expand.
+     */
+    YORI_LIB_CAB_EXPAND_CONTEXT ExpandContext;
+
+    /**
+     The name of the CAB file, without any path, in the encoding used by
+     FDI.
+     */
+    LPSTR AnsiCabFileName;
+
+    /**
+     The directory containing the CAB file, in the encoding used by FDI.
+     */
+    LPSTR AnsiCabParentDirectory;
+
+    /**
+     A string describing any error encountered by this thread.
+     */
+    YORI_STRING ErrorString;
+
+    /**
+     A handle to the thread, or NULL if the work was performed on the
+     calling thread.
+     */
+    HANDLE hThread;
+
+    /**
+     TRUE if this thread expanded its folders successfully.
+     */
+    BOOL Result;
+
+} YORI_LIB_CAB_EXPAND_WORKER, *PYORI_LIB_CAB_EXPAND_WORKER;
+
 /**
  Context passed when adding files during compression operations.  Used here
  to indicate which encoding to use to interpret file names.
@@ -1245,11 +1374,30 @@ YoriLibCabNotify(
     YORI_STRING FileName;
     DWORD_PTR Handle;
     DWORD Encoding;
+    BOOL Extract;
 
     switch(NotifyType) {
         case YoriLibCabNotifyCopyFile:
             ExpandContext = (PYORI_LIB_CAB_EXPAND_CONTEXT)Notification->Context;
 
+            //
+            //  If multiple threads are expanding the CAB, skip any file in
+            //  a folder that belongs to a different thread.  FDI does not
+            //  decompress folders that contain no requested files.  Any
+            //  folder index that is not recognized belongs to the first
+            //  thread.
+            //
+
+            if (ExpandContext->FolderOwner != NULL) {
+                if (Notification->CabinetFolderCount < ExpandContext->FolderCount) {
+                    if (ExpandContext->FolderOwner[Notification->CabinetFolderCount] != ExpandContext->WorkerIndex) {
+                        return 0;
+                    }
+                } else if (ExpandContext->WorkerIndex != 0) {
+                    return 0;
+                }
+            }
+
             Encoding = CP_ACP;
             if (Notification->HalfAttributes & YORI_CAB_NAME_IS_UTF) {
                 Encoding = CP_UTF8;
@@ -1263,9 +1411,34 @@ YoriLibCabNotify(
                 return (DWORD_PTR)INVALID_HANDLE_VALUE;
             }
             if (YoriLibCabShouldIncludeFile(&FileName, ExpandContext)) {
-                if (ExpandContext->CommenceExtractCallback == NULL ||
-                    ExpandContext->CommenceExtractCallback(&FullPath, &FileName, ExpandContext->UserContext)) {
+                Extract = TRUE;
+                if (ExpandContext->CommenceExtractCallback != NULL) {
+                    if (ExpandContext->CallbackMutex != NULL) {
+                        WaitForSingleObject(ExpandContext->CallbackMutex, INFINITE);
+                    }
+                    Extract = ExpandContext->CommenceExtractCallback(&FullPath, &FileName, ExpandContext->UserContext);
+                    if (ExpandContext->CallbackMutex != NULL) {
+                        ReleaseMutex(ExpandContext->CallbackMutex);
+                    }
+                }
 
+                if (Extract && ExpandContext->OutputHandle != NULL) {
+                    HANDLE OutputHandle;
+                    if (DuplicateHandle(GetCurrentProcess(),
+                                        ExpandContext->OutputHandle,
+                                        GetCurrentProcess(),
+                                        &OutputHandle,
+                                        0,
+                                        FALSE,
+                                        DUPLICATE_SAME_ACCESS)) {
+                        Handle = (DWORD_PTR)OutputHandle;
+                    } else {
+                        if (ExpandContext->ErrorCode == ERROR_SUCCESS) {
+                            ExpandContext->ErrorCode = GetLastError();
+                        }
+                        Handle = (DWORD_PTR)INVALID_HANDLE_VALUE;
+                    }
+                } else if (Extract) {
                     Handle = YoriLibCabFileOpenForExtract(&FullPath, &ExpandContext->ErrorCode, ExpandContext->ErrorString);
                 } else {
                     Handle = 0;
@@ -1277,6 +1450,18 @@ YoriLibCabNotify(
             YoriLibFreeStringContents(&FileName);
             return Handle;
         case YoriLibCabNotifyCloseFile:
+
+            //
+            //  If the file was written to a caller supplied handle, there is
+            //  no file to update.
+            //
+
+            ExpandContext = (PYORI_LIB_CAB_EXPAND_CONTEXT)Notification->Context;
+            if (ExpandContext->OutputHandle != NULL) {
+                YoriLibCabFdiFileClose(Notification->FileHandle);
+                return 1;
+            }
+
             if (GetTimeZoneInformation(&Tzi) == TIME_ZONE_ID_INVALID) {
                 Tzi.Bias = 0;
             }
@@ -1309,12 +1494,17 @@ YoriLibCabNotify(
                 Encoding = CP_UTF8;
             }
 
-            ExpandContext = (PYORI_LIB_CAB_EXPAND_CONTEXT)Notification->Context;
             if (YoriLibCabBuildFileNames(ExpandContext->TargetDirectory, Notification->String1, Encoding, &FullPath, &FileName)) {
                 SetFileAttributes(FullPath.StartOfString, Notification->HalfAttributes);
 
                 if (ExpandContext->CompleteExtractCallback != NULL) {
+                    if (ExpandContext->CallbackMutex != NULL) {
+                        WaitForSingleObject(ExpandContext->CallbackMutex, INFINITE);
+                    }
                     ExpandContext->CompleteExtractCallback(&FullPath, &FileName, ExpandContext->UserContext);
+                    if (ExpandContext->CallbackMutex != NULL) {
+                        ReleaseMutex(ExpandContext->CallbackMutex);
+                    }
                 }
                 YoriLibFreeStringContents(&FullPath);
                 YoriLibFreeStringContents(&FileName);
@@ -1329,12 +1519,464 @@ YoriLibCabNotify(
 }
 
 /**
- Extract a cabinet file into a specified directory.
+ Read a 16 bit little endian value from a CAB header.
+
+ @param Buffer Pointer to the value, which need not be aligned.
+
+ @return The value.
+ */
+WORD
+YoriLibCabReadWord(
+    __in PUCHAR Buffer
+    )
+{
+    return (WORD)(Buffer[0] | (Buffer[1] << 8));
+}
+
+/**
+ Read a 32 bit little endian value from a CAB header.
+
+ @param Buffer Pointer to the value, which need not be aligned.
+
+ @return The value.
+ */
+DWORD
+YoriLibCabReadDword(
+    __in PUCHAR Buffer
+    )
+{
+    return (DWORD)(Buffer[0] | (Buffer[1] << 8) | (Buffer[2] << 16) | ((DWORD)Buffer[3] << 24));
+}
+
+/**
+ Free an index of the files within a CAB that was populated with
+ @ref YoriLibCabReadIndex .
+
+ @param Index Pointer to the index to free.
+ */
+VOID
+YoriLibCabFreeIndex(
+    __inout PYORI_LIB_CAB_INDEX Index
+    )
+{
+    DWORD Count;
+
+    if (Index->Files != NULL) {
+        for (Count = 0; Count < Index->FileCount; Count++) {
+            YoriLibFreeStringContents(&Index->Files[Count].FileName);
+        }
+        YoriLibFree(Index->Files);
+    }
+    ZeroMemory(Index, sizeof(YORI_LIB_CAB_INDEX));
+}
+
+/**
+ Read the list of files within a CAB directly from the CAB's file headers.
+ This does not decompress any data, so it is much faster than walking the
+ CAB with FDI, and allows callers to determine which folders contain files
+ of interest before decompressing anything.
+
+ @param CabFileName Pointer to the full path to the CAB file.
+
+ @param Index On successful completion, populated with the files within the
+        CAB.  The caller should free this with @ref YoriLibCabFreeIndex .
+
+ @return Win32 error code, including ERROR_SUCCESS to indicate success.
+ */
+__success(return == ERROR_SUCCESS)
+DWORD
+YoriLibCabReadIndex(
+    __in PYORI_STRING CabFileName,
+    __out PYORI_LIB_CAB_INDEX Index
+    )
+{
+    HANDLE hFile;
+    UCHAR Header[YORI_LIB_CAB_HEADER_SIZE];
+    PUCHAR Buffer;
+    PYORI_LIB_CAB_INDEX_ENTRY Entry;
+    DWORD BytesRead;
+    DWORD FileSize;
+    DWORD FilesOffset;
+    DWORD BufferLength;
+    DWORD Offset;
+    DWORD NameLength;
+    DWORD FileCount;
+    DWORD Encoding;
+    DWORD Err;
+    WORD Flags;
+    WORD FolderIndex;
+
+    ASSERT(YoriLibIsStringNullTerminated(CabFileName));
+
+    ZeroMemory(Index, sizeof(YORI_LIB_CAB_INDEX));
+
+    hFile = CreateFile(CabFileName->StartOfString,
+                       GENERIC_READ,
+                       FILE_SHARE_READ | FILE_SHARE_DELETE,
+                       NULL,
+                       OPEN_EXISTING,
+                       FILE_ATTRIBUTE_NORMAL,
+                       NULL);
+
+    if (hFile == INVALID_HANDLE_VALUE) {
+        return GetLastError();
+    }
+
+    //
+    //  The header starts with "MSCF".  It contains the offset of the first
+    //  file entry, and the number of folders and files.
+    //
+
+    if (!ReadFile(hFile, Header, sizeof(Header), &BytesRead, NULL) ||
+        BytesRead != sizeof(Header) ||
+        Header[0] != 'M' ||
+        Header[1] != 'S' ||
+        Header[2] != 'C' ||
+        Header[3] != 'F') {
+
+        CloseHandle(hFile);
+        return ERROR_BAD_FORMAT;
+    }
+
+    FileSize = GetFileSize(hFile, NULL);
+    FilesOffset = YoriLibCabReadDword(&Header[16]);
+    Index->FolderCount = YoriLibCabReadWord(&Header[26]);
+    FileCount = YoriLibCabReadWord(&Header[28]);
+    Flags = YoriLibCabReadWord(&Header[30]);
+
+    if (Flags & (YORI_LIB_CAB_FLAG_PREV_CABINET | YORI_LIB_CAB_FLAG_NEXT_CABINET)) {
+        Index->SpansCabinets = TRUE;
+    }
+
+    if (FileSize == INVALID_FILE_SIZE ||
+        FilesOffset < sizeof(Header) ||
+        FilesOffset >= FileSize) {
+
+        CloseHandle(hFile);
+        return ERROR_BAD_FORMAT;
+    }
+
+    if (FileCount == 0) {
+        CloseHandle(hFile);
+        return ERROR_SUCCESS;
+    }
+
+    //
+    //  Read all of the file entries at once.  Each entry is a fixed size
+    //  followed by a name of bounded length, so this is an upper bound on
+    //  the size of the entries, which is further bounded by the file.
+    //
+
+    BufferLength = FileSize - FilesOffset;
+    if (BufferLength > FileCount * (YORI_LIB_CAB_FILE_ENTRY_SIZE + YORI_LIB_CAB_MAX_FILE_NAME)) {
+        BufferLength = FileCount * (YORI_LIB_CAB_FILE_ENTRY_SIZE + YORI_LIB_CAB_MAX_FILE_NAME);
+    }
+
+    if (!YoriLibIsSizeAllocatable(BufferLength)) {
+        CloseHandle(hFile);
+        return ERROR_NOT_ENOUGH_MEMORY;
+    }
+
+    Buffer = YoriLibMalloc((YORI_ALLOC_SIZE_T)BufferLength);
+    if (Buffer == NULL) {
+        CloseHandle(hFile);
+        return ERROR_NOT_ENOUGH_MEMORY;
+    }
+
+    if (SetFilePointer(hFile, FilesOffset, NULL, FILE_BEGIN) != FilesOffset ||
+        !ReadFile(hFile, Buffer, BufferLength, &BytesRead, NULL) ||
+        BytesRead != BufferLength) {
+
+        YoriLibFree(Buffer);
+        CloseHandle(hFile);
+        return ERROR_BAD_FORMAT;
+    }
+
+    CloseHandle(hFile);
+
+    Index->Files = YoriLibMalloc((YORI_ALLOC_SIZE_T)(FileCount * sizeof(YORI_LIB_CAB_INDEX_ENTRY)));
+    if (Index->Files == NULL) {
+        YoriLibFree(Buffer);
+        return ERROR_NOT_ENOUGH_MEMORY;
+    }
+
+    Err = ERROR_SUCCESS;
+    Offset = 0;
+    while (Index->FileCount < FileCount) {
+        if (BufferLength - Offset <= YORI_LIB_CAB_FILE_ENTRY_SIZE) {
+            Err = ERROR_BAD_FORMAT;
+            break;
+        }
+
+        Entry = &Index->Files[Index->FileCount];
+        Entry->FileSize = YoriLibCabReadDword(&Buffer[Offset]);
+        Entry->FolderOffset = YoriLibCabReadDword(&Buffer[Offset + 4]);
+        FolderIndex = YoriLibCabReadWord(&Buffer[Offset + 8]);
+        Entry->DosDate = YoriLibCabReadWord(&Buffer[Offset + 10]);
+        Entry->DosTime = YoriLibCabReadWord(&Buffer[Offset + 12]);
+        Entry->Attributes = YoriLibCabReadWord(&Buffer[Offset + 14]);
+        Offset += YORI_LIB_CAB_FILE_ENTRY_SIZE;
+
+        for (NameLength = 0; Offset + NameLength < BufferLength; NameLength++) {
+            if (Buffer[Offset + NameLength] == '\0') {
+                break;
+            }
+        }
+
+        if (Offset + NameLength >= BufferLength) {
+            Err = ERROR_BAD_FORMAT;
+            break;
+        }
+
+        //
+        //  Files that span CABs are described relative to the first or last
+        //  folder in this CAB.
+        //
+
+        if (FolderIndex == YORI_LIB_CAB_FOLDER_CONTINUED_FROM_PREV ||
+            FolderIndex == YORI_LIB_CAB_FOLDER_CONTINUED_PREV_AND_NEXT) {
+            FolderIndex = 0;
+        } else if (FolderIndex == YORI_LIB_CAB_FOLDER_CONTINUED_TO_NEXT &&
+                   Index->FolderCount > 0) {
+            FolderIndex = (WORD)(Index->FolderCount - 1);
+        }
+        Entry->FolderIndex = FolderIndex;
+
+        Encoding = CP_ACP;
+        if (Entry->Attributes & YORI_CAB_NAME_IS_UTF) {
+            Encoding = CP_UTF8;
+        }
+
+        Err = YoriLibCabNarrowToWide((LPSTR)&Buffer[Offset], Encoding, &Entry->FileName);
+        if (Err != ERROR_SUCCESS) {
+            break;
+        }
+
+        Offset += NameLength + 1;
+        Index->FileCount++;
+    }
+
+    YoriLibFree(Buffer);
+
+    if (Err != ERROR_SUCCESS) {
+        YoriLibCabFreeIndex(Index);
+    }
+
+    return Err;
+}
+
+/**
+ Expand the folders within a CAB file described by a single worker.  This is
+ invoked as a thread entry point when multiple threads are expanding a CAB,
+ or directly on the calling thread.
+
+ @param Context Pointer to the worker describing the folders to expand.
+
+ @return Zero.  The result is recorded in the worker.
+ */
+DWORD WINAPI
+YoriLibCabExpandWorker(
+    __in PVOID Context
+    )
+{
+    PYORI_LIB_CAB_EXPAND_WORKER Worker;
+    CAB_CB_ERROR CabErrors;
+    LPVOID hFdi;
+    DWORD Err;
+
+    Worker = (PYORI_LIB_CAB_EXPAND_WORKER)Context;
+
+    hFdi = DllCabinet.pFdiCreate(YoriLibCabAlloc,
+                                 YoriLibCabFree,
+                                 YoriLibCabFdiFileOpen,
+                                 YoriLibCabFdiFileRead,
+                                 YoriLibCabFdiFileWrite,
+                                 YoriLibCabFdiFileClose,
+                                 YoriLibCabFdiFileSeek,
+                                 -1,
+                                 &CabErrors);
+
+    if (hFdi == NULL) {
+        Err = GetLastError();
+        if (Worker->ExpandContext.ErrorCode == ERROR_SUCCESS) {
+            Worker->ExpandContext.ErrorCode = Err;
+        }
+        if (Worker->ExpandContext.ErrorString != NULL &&
+            Worker->ExpandContext.ErrorString->LengthInChars == 0) {
+
+            YoriLibYPrintf(Worker->ExpandContext.ErrorString, _T("Error %i in pFdiCreate"), Err);
+        }
+        return 0;
+    }
+
+    if (!DllCabinet.pFdiCopy(hFdi,
+                             Worker->AnsiCabFileName,
+                             Worker->AnsiCabParentDirectory,
+                             0,
+                             YoriLibCabNotify,
+                             NULL,
+                             &Worker->ExpandContext)) {
+        Err = GetLastError();
+        if (Worker->ExpandContext.ErrorCode == ERROR_SUCCESS) {
+            Worker->ExpandContext.ErrorCode = Err;
+        }
+        if (Worker->ExpandContext.ErrorString != NULL &&
+            Worker->ExpandContext.ErrorString->LengthInChars == 0) {
+
+            YoriLibYPrintf(Worker->ExpandContext.ErrorString, _T("Error %i in pFdiCopy"), Err);
+        }
+    } else {
+        Worker->Result = TRUE;
+    }
+
+    if (DllCabinet.pFdiDestroy != NULL) {
+        DllCabinet.pFdiDestroy(hFdi);
+    }
+
+    return 0;
+}
+
+/**
+ Determine which folders within a CAB contain files that should be
+ expanded, and assign those folders to threads so that each thread expands
+ a similar amount of data.
+
+ @param Index Pointer to the index of files within the CAB.
+
+ @param ExpandContext Pointer to the expand context describing the files to
+        expand.
+
+ @param MaximumWorkers The maximum number of threads to use.
+
+ @param FolderOwner On completion, updated to point to an array with one
+        element per folder indicating the thread that should expand it, or
+        NULL if only one thread is needed.  The caller should free this with
+        @ref YoriLibFree .
+
+ @param FoldersNeeded On completion, updated to contain the number of folders
+        that contain files to expand.
+
+ @return The number of threads to use.
+ */
+DWORD
+YoriLibCabAssignFolders(
+    __in PYORI_LIB_CAB_INDEX Index,
+    __in PYORI_LIB_CAB_EXPAND_CONTEXT ExpandContext,
+    __in DWORD MaximumWorkers,
+    __out PUCHAR *FolderOwner,
+    __out PDWORD FoldersNeeded
+    )
+{
+    DWORDLONG WorkerBytes[YORI_LIB_CAB_MAX_EXPAND_THREADS];
+    PDWORDLONG FolderBytes;
+    PUCHAR Owner;
+    PYORI_LIB_CAB_INDEX_ENTRY Entry;
+    DWORD Count;
+    DWORD Folder;
+    DWORD Worker;
+    DWORD WorkerCount;
+    DWORD BestWorker;
+    DWORD NeededCount;
+
+    *FolderOwner = NULL;
+    *FoldersNeeded = Index->FolderCount;
+
+    if (Index->FolderCount == 0) {
+        return 1;
+    }
+
+    FolderBytes = YoriLibMalloc((YORI_ALLOC_SIZE_T)(Index->FolderCount * sizeof(DWORDLONG)));
+    if (FolderBytes == NULL) {
+        return 1;
+    }
+    ZeroMemory(FolderBytes, Index->FolderCount * sizeof(DWORDLONG));
+
+    //
+    //  Count the bytes to expand from each folder.  Each file counts as at
+    //  least one byte so that folders containing only empty files are still
+    //  expanded.
+    //
+
+    for (Count = 0; Count < Index->FileCount; Count++) {
+        Entry = &Index->Files[Count];
+        if (Entry->FolderIndex < Index->FolderCount &&
+            YoriLibCabShouldIncludeFile(&Entry->FileName, ExpandContext)) {
+
+            FolderBytes[Entry->FolderIndex] += (DWORDLONG)Entry->FileSize + 1;
+        }
+    }
+
+    NeededCount = 0;
+    for (Folder = 0; Folder < Index->FolderCount; Folder++) {
+        if (FolderBytes[Folder] != 0) {
+            NeededCount++;
+        }
+    }
+    *FoldersNeeded = NeededCount;
+
+    WorkerCount = MaximumWorkers;
+    if (WorkerCount > YORI_LIB_CAB_MAX_EXPAND_THREADS) {
+        WorkerCount = YORI_LIB_CAB_MAX_EXPAND_THREADS;
+    }
+    if (WorkerCount > NeededCount) {
+        WorkerCount = NeededCount;
+    }
+
+    if (WorkerCount <= 1) {
+        YoriLibFree(FolderBytes);
+        return 1;
+    }
+
+    Owner = YoriLibMalloc((YORI_ALLOC_SIZE_T)Index->FolderCount);
+    if (Owner == NULL) {
+        YoriLibFree(FolderBytes);
+        return 1;
+    }
+    ZeroMemory(Owner, Index->FolderCount);
+    ZeroMemory(WorkerBytes, sizeof(WorkerBytes));
+
+    //
+    //  Assign each folder to the thread with the least data so far.
+    //  Folders containing nothing to expand are left with the first thread,
+    //  which skips every file in them.
+    //
+
+    for (Folder = 0; Folder < Index->FolderCount; Folder++) {
+        if (FolderBytes[Folder] == 0) {
+            continue;
+        }
+
+        BestWorker = 0;
+        for (Worker = 1; Worker < WorkerCount; Worker++) {
+            if (WorkerBytes[Worker] < WorkerBytes[BestWorker]) {
+                BestWorker = Worker;
+            }
+        }
+
+        Owner[Folder] = (UCHAR)BestWorker;
+        WorkerBytes[BestWorker] += FolderBytes[Folder];
+    }
+
+    YoriLibFree(FolderBytes);
+    *FolderOwner = Owner;
+    return WorkerCount;
+}
+
+/**
+ Extract files from a cabinet into a specified directory or a handle.  The
+ file entries in the cabinet are read first, so only folders containing
+ files to extract are expanded.  If more than one folder needs to be
+ expanded into a directory, folders are expanded concurrently on multiple
+ threads.  In this case the callbacks are invoked on different threads,
+ although never more than one at a time.
 
  @param CabFileName Pointer to the file name of the Cabinet to extract.
 
- @param TargetDirectory Pointer to the name of the directory to extract
-        into.
+ @param TargetDirectory Optionally points to the name of the directory to
+        extract into.  This is required if OutputHandle is NULL.
+
+ @param OutputHandle Optionally points to a handle to write the contents of
+        extracted files to, in the order they are found in the cabinet.
 
  @param IncludeAllByDefault If TRUE, files not listed in the below arrays
         are expanded.  If FALSE, only files explicitly listed are expanded.
@@ -1372,9 +2014,10 @@ YoriLibCabNotify(
  */
 __success(return)
 BOOL
-YoriLibExtractCab(
+YoriLibCabExpand(
     __in PYORI_STRING CabFileName,
-    __in PYORI_STRING TargetDirectory,
+    __in_opt PYORI_STRING TargetDirectory,
+    __in_opt HANDLE OutputHandle,
     __in BOOL IncludeAllByDefault,
     __in DWORD NumberFilesToExclude,
     __in_opt PYORI_STRING FilesToExclude,
@@ -1392,12 +2035,22 @@ YoriLibExtractCab(
     YORI_STRING CabFileNameOnly;
     YORI_STRING FullTargetDirectory;
     LPTSTR FinalBackslash;
-    LPVOID hFdi;
-    CAB_CB_ERROR CabErrors;
     LPSTR AnsiCabFileName;
     LPSTR AnsiCabParentDirectory;
     BOOL Result = FALSE;
     YORI_LIB_CAB_EXPAND_CONTEXT ExpandContext;
+    YORI_LIB_CAB_INDEX CabIndex;
+    PYORI_LIB_CAB_EXPAND_WORKER Workers;
+    PYORI_LIB_CAB_EXPAND_WORKER Worker;
+    SYSTEM_INFO SystemInfo;
+    HANDLE CallbackMutex;
+    PUCHAR FolderOwner;
+    DWORD WorkerCount;
+    DWORD MaximumWorkers;
+    DWORD FolderCount;
+    DWORD FoldersNeeded;
+    DWORD ThreadId;
+    DWORD Index;
     DWORD Encoding;
     DWORD Error;
 
@@ -1418,7 +2071,11 @@ YoriLibExtractCab(
     YoriLibInitEmptyString(&FullTargetDirectory);
     AnsiCabParentDirectory = NULL;
     AnsiCabFileName = NULL;
-    hFdi = NULL;
+    Workers = NULL;
+    WorkerCount = 0;
+    CallbackMutex = NULL;
+    FolderOwner = NULL;
+    FolderCount = 0;
     ZeroMemory(&ExpandContext, sizeof(ExpandContext));
     ExpandContext.DefaultInclude = IncludeAllByDefault;
     ExpandContext.NumberFilesToInclude = NumberFilesToInclude;
@@ -1430,6 +2087,7 @@ YoriLibExtractCab(
     ExpandContext.UserContext = UserContext;
     ExpandContext.ErrorCode = ERROR_SUCCESS;
     ExpandContext.ErrorString = ErrorString;
+    ExpandContext.OutputHandle = OutputHandle;
 
     if (!YoriLibUserStringToSingleFilePath(CabFileName, FALSE, &FullCabFileName)) {
         if (ErrorCode != NULL) {
@@ -1441,7 +2099,8 @@ YoriLibExtractCab(
         return FALSE;
     }
 
-    if (!YoriLibUserStringToSingleFilePath(TargetDirectory, FALSE, &FullTargetDirectory)) {
+    if (TargetDirectory != NULL &&
+        !YoriLibUserStringToSingleFilePath(TargetDirectory, FALSE, &FullTargetDirectory)) {
         if (ErrorCode != NULL) {
             *ErrorCode = GetLastError();
         }
@@ -1499,49 +2158,133 @@ YoriLibExtractCab(
         goto Exit;
     }
 
-    hFdi = DllCabinet.pFdiCreate(YoriLibCabAlloc,
-                                 YoriLibCabFree,
-                                 YoriLibCabFdiFileOpen,
-                                 YoriLibCabFdiFileRead,
-                                 YoriLibCabFdiFileWrite,
-                                 YoriLibCabFdiFileClose,
-                                 YoriLibCabFdiFileSeek,
-                                 -1,
-                                 &CabErrors);
+    ExpandContext.TargetDirectory = &FullTargetDirectory;
 
-    if (hFdi == NULL) {
-        if (ErrorCode != NULL && *ErrorCode == ERROR_SUCCESS) {
-            *ErrorCode = GetLastError();
+    //
+    //  Each folder within a CAB is an independent compressed stream.  Read
+    //  the file entries to find which folders contain files to expand.  If
+    //  more than one does, use one FDI instance per thread, each expanding
+    //  a subset of those folders.  Output to a handle is written in order
+    //  by a single instance.  If the file entries can't be read, or the CAB
+    //  spans multiple CABs, use a single instance and allow FDI to report
+    //  any problem.
+    //
+
+    WorkerCount = 1;
+    FoldersNeeded = 1;
+    if (YoriLibCabReadIndex(&FullCabFileName, &CabIndex) == ERROR_SUCCESS) {
+        if (!CabIndex.SpansCabinets) {
+            MaximumWorkers = 1;
+            if (OutputHandle == NULL) {
+                GetSystemInfo(&SystemInfo);
+                MaximumWorkers = SystemInfo.dwNumberOfProcessors;
+            }
+            FolderCount = CabIndex.FolderCount;
+            WorkerCount = YoriLibCabAssignFolders(&CabIndex, &ExpandContext, MaximumWorkers, &FolderOwner, &FoldersNeeded);
         }
-        if (ErrorString != NULL && ErrorString->LengthInChars == 0) {
-            YoriLibYPrintf(ErrorString, _T("Error %i in pFdiCreate"), GetLastError());
+        YoriLibCabFreeIndex(&CabIndex);
+    }
+
+    if (FoldersNeeded == 0) {
+        if (OutputHandle == NULL) {
+            Result = TRUE;
+        } else {
+            if (ErrorCode != NULL) {
+                *ErrorCode = ERROR_FILE_NOT_FOUND;
+            }
+            if (ErrorString != NULL) {
+                YoriLibYPrintf(ErrorString, _T("No matching files found in %y"), &FullCabFileName);
+            }
         }
         goto Exit;
     }
 
-    ExpandContext.TargetDirectory = &FullTargetDirectory;
-
-    if (!DllCabinet.pFdiCopy(hFdi,
-                             AnsiCabFileName,
-                             AnsiCabParentDirectory,
-                             0,
-                             YoriLibCabNotify,
-                             NULL,
-                             &ExpandContext)) {
-        if (ErrorCode != NULL && *ErrorCode == ERROR_SUCCESS) {
-            *ErrorCode = GetLastError();
+    if (WorkerCount > 1) {
+        CallbackMutex = CreateMutex(NULL, FALSE, NULL);
+        if (CallbackMutex == NULL) {
+            WorkerCount = 1;
         }
-        if (ErrorString != NULL && ErrorString->LengthInChars == 0) {
-            YoriLibYPrintf(ErrorString, _T("Error %i in pFdiCopy"), GetLastError());
+    }
+
+    if (WorkerCount == 1 && FolderOwner != NULL) {
+        YoriLibFree(FolderOwner);
+        FolderOwner = NULL;
+    }
+
+    Workers = YoriLibMalloc((YORI_ALLOC_SIZE_T)(WorkerCount * sizeof(YORI_LIB_CAB_EXPAND_WORKER)));
+    if (Workers == NULL) {
+        WorkerCount = 0;
+        if (ErrorCode != NULL) {
+            *ErrorCode = ERROR_NOT_ENOUGH_MEMORY;
         }
         goto Exit;
     }
 
+    ZeroMemory(Workers, WorkerCount * sizeof(YORI_LIB_CAB_EXPAND_WORKER));
+    for (Index = 0; Index < WorkerCount; Index++) {
+        Worker = &Workers[Index];
+        CopyMemory(&Worker->ExpandContext, &ExpandContext, sizeof(ExpandContext));
+        YoriLibInitEmptyString(&Worker->ErrorString);
+        if (ErrorString != NULL) {
+            Worker->ExpandContext.ErrorString = &Worker->ErrorString;
+        }
+        Worker->ExpandContext.CallbackMutex = CallbackMutex;
+        Worker->ExpandContext.FolderOwner = FolderOwner;
+        Worker->ExpandContext.FolderCount = FolderCount;
+        Worker->ExpandContext.WorkerIndex = Index;
+        Worker->AnsiCabFileName = AnsiCabFileName;
+        Worker->AnsiCabParentDirectory = AnsiCabParentDirectory;
+    }
+
+    //
+    //  Start a thread for each worker after the first, and process the
+    //  first on this thread.  If a thread can't be created, its folders are
+    //  processed on this thread instead.
+    //
+
+    for (Index = 1; Index < WorkerCount; Index++) {
+        Worker = &Workers[Index];
+        Worker->hThread = CreateThread(NULL, 0, YoriLibCabExpandWorker, Worker, 0, &ThreadId);
+        if (Worker->hThread == NULL) {
+            YoriLibCabExpandWorker(Worker);
+        }
+    }
+
+    YoriLibCabExpandWorker(&Workers[0]);
+
     Result = TRUE;
+    for (Index = 0; Index < WorkerCount; Index++) {
+        Worker = &Workers[Index];
+        if (Worker->hThread != NULL) {
+            WaitForSingleObject(Worker->hThread, INFINITE);
+            CloseHandle(Worker->hThread);
+            Worker->hThread = NULL;
+        }
+
+        if (!Worker->Result && Result) {
+            Result = FALSE;
+            if (ErrorCode != NULL && *ErrorCode == ERROR_SUCCESS) {
+                *ErrorCode = Worker->ExpandContext.ErrorCode;
+            }
+            if (ErrorString != NULL && ErrorString->LengthInChars == 0) {
+                YoriLibYPrintf(ErrorString, _T("%y"), &Worker->ErrorString);
+            }
+        }
+    }
+
 Exit:
 
-    if (DllCabinet.pFdiDestroy != NULL && hFdi != NULL) {
-        DllCabinet.pFdiDestroy(hFdi);
+    for (Index = 0; Index < WorkerCount; Index++) {
+        YoriLibFreeStringContents(&Workers[Index].ErrorString);
+    }
+    if (Workers != NULL) {
+        YoriLibFree(Workers);
+    }
+    if (CallbackMutex != NULL) {
+        CloseHandle(CallbackMutex);
+    }
+    if (FolderOwner != NULL) {
+        YoriLibFree(FolderOwner);
     }
 
     YoriLibFreeStringContents(&FullCabFileName);
@@ -1555,6 +2298,127 @@ Exit:
     return Result;
 }
 
+/**
+ Extract a cabinet file into a specified directory.  Only folders containing
+ files to extract are expanded, and if more than one folder needs to be
+ expanded, folders are expanded concurrently on multiple threads.  In this
+ case the callbacks are invoked on different threads, although never more
+ than one at a time.
+
+ @param CabFileName Pointer to the file name of the Cabinet to extract.
+
+ @param TargetDirectory Pointer to the name of the directory to extract
+        into.
+
+ @param IncludeAllByDefault If TRUE, files not listed in the below arrays
+        are expanded.  If FALSE, only files explicitly listed are expanded.
+
+ @param NumberFilesToInclude The number of files in the FilesToInclude array.
+
+ @param FilesToInclude An array of strings corresponding to files that should
+        be expanded.
+
+ @param NumberFilesToExclude The number of files in the FilesToExclude array.
+
+ @param FilesToExclude An array of strings corresponding to files that should
+        not be expanded.
+
+ @param CommenceExtractCallback Optionally points to a a function to invoke
+        for each file processed as part of extracting the CAB.  This function
+        is invoked before extract and gives the user a chance to skip
+        particular files.
+
+ @param CompleteExtractCallback Optionally points to a a function to invoke
+        for each file processed as part of extracting the CAB.  This function
+        is invoked after extract and gives the user a chance to make extra
+        changes to files.
+
+ @param UserContext Optionally points to context to pass to
+        CommenceExtractCallback and CompleteExtractCallback.
+
+ @param ErrorCode Optionally points to a value to populate with the error code
+        encountered in the extraction process.
+
+ @param ErrorString Optionally points to a string to populate with information
+        about any error encountered in the extraction process.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriLibExtractCab(
+    __in PYORI_STRING CabFileName,
+    __in PYORI_STRING TargetDirectory,
+    __in BOOL IncludeAllByDefault,
+    __in DWORD NumberFilesToExclude,
+    __in_opt PYORI_STRING FilesToExclude,
+    __in DWORD NumberFilesToInclude,
+    __in_opt PYORI_STRING FilesToInclude,
+    __in_opt PYORI_LIB_CAB_EXPAND_FILE_CALLBACK CommenceExtractCallback,
+    __in_opt PYORI_LIB_CAB_EXPAND_FILE_CALLBACK CompleteExtractCallback,
+    __in_opt PVOID UserContext,
+    __inout_opt PDWORD ErrorCode,
+    __inout_opt PYORI_STRING ErrorString
+    )
+{
+    return YoriLibCabExpand(CabFileName,
+                            TargetDirectory,
+                            NULL,
+                            IncludeAllByDefault,
+                            NumberFilesToExclude,
+                            FilesToExclude,
+                            NumberFilesToInclude,
+                            FilesToInclude,
+                            CommenceExtractCallback,
+                            CompleteExtractCallback,
+                            UserContext,
+                            ErrorCode,
+                            ErrorString);
+}
+
+/**
+ Extract a single file from a cabinet and write its contents to a handle,
+ such as standard output.  Only the folder containing the file is expanded.
+
+ @param CabFileName Pointer to the file name of the Cabinet to extract from.
+
+ @param FileName Pointer to the name of the file within the Cabinet.
+
+ @param OutputHandle The handle to write the file contents to.
+
+ @param ErrorCode Optionally points to a value to populate with the error code
+        encountered in the extraction process.
+
+ @param ErrorString Optionally points to a string to populate with information
+        about any error encountered in the extraction process.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriLibExtractCabFileToHandle(
+    __in PYORI_STRING CabFileName,
+    __in PYORI_STRING FileName,
+    __in HANDLE OutputHandle,
+    __inout_opt PDWORD ErrorCode,
+    __inout_opt PYORI_STRING ErrorString
+    )
+{
+    return YoriLibCabExpand(CabFileName,
+                            NULL,
+                            OutputHandle,
+                            FALSE,
+                            0,
+                            NULL,
+                            1,
+                            FileName,
+                            NULL,
+                            NULL,
+                            NULL,
+                            ErrorCode,
+                            ErrorString);
+}
+
 /**
  A structure owned by this module for each CAB file being created.  This is
  the nonopaque form of a handle returned from @ref YoriLibCreateCab .
@@ -1630,11 +2494,12 @@ YoriLibCreateCab(
     //
     //  We don't want to split data across multiple CABs.  This feature
     //  was for floppy disks.  Today, set the maximum size to as large
-    //  as is possible.
+    //  as is possible.  Data is split across multiple folders, since
+    //  each folder can be expanded on a separate thread.
     //
 
     CabHandle->CompressContext.SizeAvailable = 0x7FFFF000;
-    CabHandle->CompressContext.ThresholdForNextFolder = 0x7FFFF000;
+    CabHandle->CompressContext.ThresholdForNextFolder = YORI_LIB_CAB_FOLDER_THRESHOLD;
 
     CabHandle->AddContext.OnDiskNameIsUtf = FALSE;
     Encoding = CP_ACP;
@@ -847,6 +847,52 @@ YoriCallGetJobInformation(
     return pYoriApiGetJobInformation(JobId, HasCompleted, HasOutput, ExitCode, Command);
 }
 
+/**
+ Prototype for the @ref YoriApiGetJobAccounting function.
+ */
+typedef BOOL YORI_API_GET_JOB_ACCOUNTING(DWORD, PYORI_LIB_JOB_ACCOUNTING);
+
+/**
+ Prototype for a pointer to the @ref YoriApiGetJobAccounting function.
+ */
+typedef YORI_API_GET_JOB_ACCOUNTING *PYORI_API_GET_JOB_ACCOUNTING;
+
+/**
+ Pointer to the @ref YoriApiGetJobAccounting function.
+ */
+PYORI_API_GET_JOB_ACCOUNTING pYoriApiGetJobAccounting;
+
+/**
+ Returns the resources consumed by an executing or completed job ID,
+ including all processes launched by the job.
+
+ @param JobId The ID to query information for.
+
+ @param Accounting On successful completion, populated with the resources
+        consumed by the job's process tree.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriCallGetJobAccounting(
+    __in DWORD JobId,
+    __out PYORI_LIB_JOB_ACCOUNTING Accounting
+    )
+{
+    if (pYoriApiGetJobAccounting == NULL) {
+        HMODULE hYori;
+
+        hYori = GetModuleHandle(NULL);
+        __analysis_assume(hYori != NULL);
+        pYoriApiGetJobAccounting = (PYORI_API_GET_JOB_ACCOUNTING)GetProcAddress(hYori, "YoriApiGetJobAccounting");
+        if (pYoriApiGetJobAccounting == NULL) {
+            return FALSE;
+        }
+    }
+    return pYoriApiGetJobAccounting(JobId, Accounting);
+}
+
 /**
  Prototype for the @ref YoriApiGetJobOutput function.
  */
@@ -894,6 +940,44 @@ YoriCallGetJobOutput(
     return pYoriApiGetJobOutput(JobId, Output, Errors);
 }
 
+/**
+ Prototype for the @ref YoriApiGetJobLimit function.
+ */
+typedef DWORD YORI_API_GET_JOB_LIMIT(VOID);
+
+/**
+ Prototype for a pointer to the @ref YoriApiGetJobLimit function.
+ */
+typedef YORI_API_GET_JOB_LIMIT *PYORI_API_GET_JOB_LIMIT;
+
+/**
+ Pointer to the @ref YoriApiGetJobLimit function.
+ */
+PYORI_API_GET_JOB_LIMIT pYoriApiGetJobLimit;
+
+/**
+ Returns the maximum number of background jobs that can execute
+ concurrently.
+
+ @return The maximum number of concurrent jobs, or zero if there is no
+         limit.
+ */
+DWORD
+YoriCallGetJobLimit(VOID)
+{
+    if (pYoriApiGetJobLimit == NULL) {
+        HMODULE hYori;
+
+        hYori = GetModuleHandle(NULL);
+        __analysis_assume(hYori != NULL);
+        pYoriApiGetJobLimit = (PYORI_API_GET_JOB_LIMIT)GetProcAddress(hYori, "YoriApiGetJobLimit");
+        if (pYoriApiGetJobLimit == NULL) {
+            return 0;
+        }
+    }
+    return pYoriApiGetJobLimit();
+}
+
 /**
  Prototype for the @ref YoriApiGetNextJobId function.
  */
@@ -1278,6 +1362,49 @@ YoriCallSetEnvironmentVariable(
     return TRUE;
 }
 
+/**
+ Prototype for the @ref YoriApiSetJobLimit function.
+ */
+typedef BOOL YORI_API_SET_JOB_LIMIT(DWORD);
+
+/**
+ Prototype for a pointer to the @ref YoriApiSetJobLimit function.
+ */
+typedef YORI_API_SET_JOB_LIMIT *PYORI_API_SET_JOB_LIMIT;
+
+/**
+ Pointer to the @ref YoriApiSetJobLimit function.
+ */
+PYORI_API_SET_JOB_LIMIT pYoriApiSetJobLimit;
+
+/**
+ Sets the maximum number of background jobs that can execute concurrently.
+ Once this many jobs are executing, launching another job waits until one
+ completes.
+
+ @param JobLimit The maximum number of concurrent jobs, or zero to remove
+        any limit.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+YoriCallSetJobLimit(
+    __in DWORD JobLimit
+    )
+{
+    if (pYoriApiSetJobLimit == NULL) {
+        HMODULE hYori;
+
+        hYori = GetModuleHandle(NULL);
+        __analysis_assume(hYori != NULL);
+        pYoriApiSetJobLimit = (PYORI_API_SET_JOB_LIMIT)GetProcAddress(hYori, "YoriApiSetJobLimit");
+        if (pYoriApiSetJobLimit == NULL) {
+            return FALSE;
+        }
+    }
+    return pYoriApiSetJobLimit(JobLimit);
+}
+
 /**
  Prototype for the @ref YoriApiSetJobPriority function.
  */
@@ -1449,6 +1576,43 @@ YoriCallTerminateJob(
     return pYoriApiTerminateJob(JobId);
 }
 
+/**
+ Prototype for the @ref YoriApiWaitForAnyJob function.
+ */
+typedef DWORD YORI_API_WAIT_FOR_ANY_JOB(VOID);
+
+/**
+ Prototype for a pointer to the @ref YoriApiWaitForAnyJob function.
+ */
+typedef YORI_API_WAIT_FOR_ANY_JOB *PYORI_API_WAIT_FOR_ANY_JOB;
+
+/**
+ Pointer to the @ref YoriApiWaitForAnyJob function.
+ */
+PYORI_API_WAIT_FOR_ANY_JOB pYoriApiWaitForAnyJob;
+
+/**
+ Waits until any executing job completes.
+
+ @return The ID of the job that completed, or zero if no jobs are executing
+         or the wait was cancelled.
+ */
+DWORD
+YoriCallWaitForAnyJob(VOID)
+{
+    if (pYoriApiWaitForAnyJob == NULL) {
+        HMODULE hYori;
+
+        hYori = GetModuleHandle(NULL);
+        __analysis_assume(hYori != NULL);
+        pYoriApiWaitForAnyJob = (PYORI_API_WAIT_FOR_ANY_JOB)GetProcAddress(hYori, "YoriApiWaitForAnyJob");
+        if (pYoriApiWaitForAnyJob == NULL) {
+            return 0;
+        }
+    }
+    return pYoriApiWaitForAnyJob();
+}
+
 /**
  Prototype for the @ref YoriApiWaitForJob function.
  */
@@ -28,6 +28,72 @@
 #include "yorilib.h"
 
 
+/**
+ Query logical processor information from the system, allocating a buffer
+ large enough to contain it.  This requires GetLogicalProcessorInformationEx.
+
+ @param ProcInfo On successful completion, updated to point to an allocated
+        buffer describing the processors in the system.  The caller should
+        free this with YoriLibFree.
+
+ @param BytesInBuffer On successful completion, updated to contain the number
+        of bytes of information in ProcInfo.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriLibQueryLogicalProcessorInformation(
+    __out PYORI_SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX *ProcInfo,
+    __out PDWORD BytesInBuffer
+    )
+{
+    PYORI_SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX LocalProcInfo = NULL;
+    DWORD LocalBytesInBuffer = 0;
+    DWORD Err;
+
+    if (DllKernel32.pGetLogicalProcessorInformationEx == NULL) {
+        return FALSE;
+    }
+
+    //
+    //  Query processor information from the system.  This needs to allocate
+    //  memory as needed to populate, so loop while the buffer is too small
+    //  in order to allocate the correct amount.
+    //
+
+    while(TRUE) {
+        if (DllKernel32.pGetLogicalProcessorInformationEx(YoriProcessorRelationAll, LocalProcInfo, &LocalBytesInBuffer)) {
+            break;
+        }
+
+        Err = GetLastError();
+        if (LocalProcInfo != NULL) {
+            YoriLibFree(LocalProcInfo);
+            LocalProcInfo = NULL;
+        }
+
+        if (Err != ERROR_INSUFFICIENT_BUFFER ||
+            !YoriLibIsSizeAllocatable(LocalBytesInBuffer)) {
+
+            return FALSE;
+        }
+
+        LocalProcInfo = YoriLibMalloc((YORI_ALLOC_SIZE_T)LocalBytesInBuffer);
+        if (LocalProcInfo == NULL) {
+            return FALSE;
+        }
+    }
+
+    if (LocalProcInfo == NULL) {
+        return FALSE;
+    }
+
+    *ProcInfo = LocalProcInfo;
+    *BytesInBuffer = LocalBytesInBuffer;
+    return TRUE;
+}
+
 /**
  Query the system to find the number of high performance and high efficiency
  logical processors.  This is used when determining how many child tasks to
@@ -55,7 +121,6 @@ YoriLibQueryCpuCount(
     //
 
     if (DllKernel32.pGetLogicalProcessorInformationEx != NULL) {
-        DWORD Err;
         DWORD BytesInBuffer = 0;
         DWORD CurrentOffset = 0;
         DWORD GroupIndex;
@@ -67,43 +132,8 @@ YoriLibQueryCpuCount(
         PYORI_SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX ProcInfo = NULL;
         PYORI_SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX Entry;
         PYORI_PROCESSOR_GROUP_AFFINITY Group;
-    
-        //
-        //  Query processor information from the system.  This needs to allocate
-        //  memory as needed to populate, so loop while the buffer is too small
-        //  in order to allocate the correct amount.
-        //
-    
-        Err = ERROR_SUCCESS;
-        while(TRUE) {
-            if (DllKernel32.pGetLogicalProcessorInformationEx(YoriProcessorRelationAll, ProcInfo, &BytesInBuffer)) {
-                Err = ERROR_SUCCESS;
-                break;
-            }
-    
-            Err = GetLastError();
-            if (Err == ERROR_INSUFFICIENT_BUFFER) {
-                if (ProcInfo != NULL) {
-                    YoriLibFree(ProcInfo);
-                    ProcInfo = NULL;
-                }
 
-                if (!YoriLibIsSizeAllocatable(BytesInBuffer)) {
-                    Err = ERROR_NOT_ENOUGH_MEMORY;
-                    break;
-                }
-    
-                ProcInfo = YoriLibMalloc((YORI_ALLOC_SIZE_T)BytesInBuffer);
-                if (ProcInfo == NULL) {
-                    Err = ERROR_NOT_ENOUGH_MEMORY;
-                    break;
-                }
-            } else {
-                break;
-            }
-        }
-    
-        if (Err == ERROR_SUCCESS) {
+        if (YoriLibQueryLogicalProcessorInformation(&ProcInfo, &BytesInBuffer)) {
             LocalEfficiencyProcessorCount = 0;
             LocalPerformanceProcessorCount = 0;
             Entry = ProcInfo;
@@ -178,4 +208,203 @@ YoriLibQueryCpuCount(
     *EfficiencyLogicalProcessors = 0;
 }
 
+/**
+ Prepare to distribute child processes across the processors in the system.
+ On systems with more than one processor group, the system would otherwise
+ place children within a single group, and on systems with more than one
+ NUMA node, children can benefit from executing on a single node.
+
+ @param Placement Pointer to the placement structure to initialize.  This
+        should be cleaned up with YoriLibCleanupProcessorPlacement whether
+        or not this function succeeds.
+
+ @param PlacementType Specifies whether children should be distributed
+        across processor groups, or across NUMA nodes with each child
+        restricted to the processors of a single node.  If NUMA information
+        is unavailable, children are distributed across processor groups.
+
+ @return TRUE to indicate that children can be placed, FALSE if the system
+         cannot support placement.  If this returns FALSE, calls to place
+         processes have no effect.
+ */
+__success(return)
+BOOL
+YoriLibInitializeProcessorPlacement(
+    __out PYORI_LIB_PROCESSOR_PLACEMENT Placement,
+    __in YORI_LIB_PROCESSOR_PLACEMENT_TYPE PlacementType
+    )
+{
+    PYORI_SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX ProcInfo;
+    PYORI_SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX Entry;
+    DWORD BytesInBuffer;
+    DWORD CurrentOffset;
+    DWORD NodeCount;
+    DWORD GroupCount;
+    DWORD SetCount;
+    WORD GroupIndex;
+
+    ZeroMemory(Placement, sizeof(YORI_LIB_PROCESSOR_PLACEMENT));
+
+    if (DllKernel32.pSetThreadGroupAffinity == NULL) {
+        return FALSE;
+    }
+
+    if (!YoriLibQueryLogicalProcessorInformation(&ProcInfo, &BytesInBuffer)) {
+        return FALSE;
+    }
+
+    //
+    //  Count the nodes and groups, then select which to distribute across.
+    //
+
+    NodeCount = 0;
+    GroupCount = 0;
+    CurrentOffset = 0;
+    Entry = ProcInfo;
+    while (TRUE) {
+        if (Entry->Relationship == YoriProcessorRelationNumaNode) {
+            NodeCount++;
+        } else if (Entry->Relationship == YoriProcessorRelationGroup) {
+            GroupCount = GroupCount + Entry->u.Group.ActiveGroupCount;
+        }
+
+        CurrentOffset += Entry->SizeInBytes;
+        if (CurrentOffset >= BytesInBuffer) {
+            break;
+        }
+        Entry = YoriLibAddToPointer(ProcInfo, CurrentOffset);
+    }
+
+    if (PlacementType == YoriLibPlacementByNumaNode && NodeCount == 0) {
+        PlacementType = YoriLibPlacementByGroup;
+    }
+
+    SetCount = GroupCount;
+    if (PlacementType == YoriLibPlacementByNumaNode) {
+        SetCount = NodeCount;
+    }
+
+    if (SetCount == 0) {
+        YoriLibFree(ProcInfo);
+        return FALSE;
+    }
+
+    Placement->Sets = YoriLibMalloc((YORI_ALLOC_SIZE_T)(SetCount * sizeof(YORI_LIB_PROCESSOR_SET)));
+    if (Placement->Sets == NULL) {
+        YoriLibFree(ProcInfo);
+        return FALSE;
+    }
+    ZeroMemory(Placement->Sets, SetCount * sizeof(YORI_LIB_PROCESSOR_SET));
+
+    CurrentOffset = 0;
+    Entry = ProcInfo;
+    while (Placement->SetCount < SetCount) {
+        if (PlacementType == YoriLibPlacementByNumaNode &&
+            Entry->Relationship == YoriProcessorRelationNumaNode) {
+
+            Placement->Sets[Placement->SetCount].Number = Entry->u.NumaNode.NodeNumber;
+            Placement->Sets[Placement->SetCount].Affinity.Group = Entry->u.NumaNode.GroupMask.Group;
+            Placement->Sets[Placement->SetCount].Affinity.Mask = Entry->u.NumaNode.GroupMask.Mask;
+            Placement->SetCount++;
+        } else if (PlacementType == YoriLibPlacementByGroup &&
+                   Entry->Relationship == YoriProcessorRelationGroup) {
+
+            for (GroupIndex = 0; GroupIndex < Entry->u.Group.ActiveGroupCount && Placement->SetCount < SetCount; GroupIndex++) {
+                Placement->Sets[Placement->SetCount].Number = GroupIndex;
+                Placement->Sets[Placement->SetCount].Affinity.Group = GroupIndex;
+                Placement->Sets[Placement->SetCount].Affinity.Mask = Entry->u.Group.GroupInfo[GroupIndex].ActiveProcessorMask;
+                Placement->SetCount++;
+            }
+        }
+
+        CurrentOffset += Entry->SizeInBytes;
+        if (CurrentOffset >= BytesInBuffer) {
+            break;
+        }
+        Entry = YoriLibAddToPointer(ProcInfo, CurrentOffset);
+    }
+
+    YoriLibFree(ProcInfo);
+    return TRUE;
+}
+
+/**
+ Restrict the primary thread of a newly created, suspended child process to
+ the next set of processors in round-robin order.  This should be called
+ before the thread is resumed.  If the system has only one set of
+ processors, the thread is left unchanged.
+
+ @param Placement Pointer to the placement structure.
+
+ @param hThread Handle to the primary thread of the child process.
+
+ @return TRUE if the thread was placed, FALSE if it was not.
+ */
+__success(return)
+BOOL
+YoriLibPlaceNextProcess(
+    __in PYORI_LIB_PROCESSOR_PLACEMENT Placement,
+    __in HANDLE hThread
+    )
+{
+    DWORD SetIndex;
+
+    if (Placement->SetCount < 2) {
+        return FALSE;
+    }
+
+    SetIndex = (DWORD)(InterlockedIncrement(&Placement->NextSet) - 1) % Placement->SetCount;
+    return DllKernel32.pSetThreadGroupAffinity(hThread, &Placement->Sets[SetIndex].Affinity, NULL);
+}
+
+/**
+ Restrict the primary thread of a newly created, suspended child process to
+ a specific set of processors.  This should be called before the thread is
+ resumed.
+
+ @param Placement Pointer to the placement structure.
+
+ @param hThread Handle to the primary thread of the child process.
+
+ @param Number The NUMA node or processor group number, depending on the type
+        of placement, to restrict the thread to.
+
+ @return TRUE if the thread was placed, FALSE if it was not.
+ */
+__success(return)
+BOOL
+YoriLibPlaceProcessOnSet(
+    __in PYORI_LIB_PROCESSOR_PLACEMENT Placement,
+    __in HANDLE hThread,
+    __in DWORD Number
+    )
+{
+    DWORD SetIndex;
+
+    for (SetIndex = 0; SetIndex < Placement->SetCount; SetIndex++) {
+        if (Placement->Sets[SetIndex].Number == Number) {
+            return DllKernel32.pSetThreadGroupAffinity(hThread, &Placement->Sets[SetIndex].Affinity, NULL);
+        }
+    }
+
+    return FALSE;
+}
+
+/**
+ Free any memory associated with processor placement.
+
+ @param Placement Pointer to the placement structure.
+ */
+VOID
+YoriLibCleanupProcessorPlacement(
+    __in PYORI_LIB_PROCESSOR_PLACEMENT Placement
+    )
+{
+    if (Placement->Sets != NULL) {
+        YoriLibFree(Placement->Sets);
+        Placement->Sets = NULL;
+    }
+    Placement->SetCount = 0;
+}
+
 // vim:sw=4:ts=4:et:
@@ -28,6 +28,140 @@
 #include <yorilib.h>
 
 
+/**
+ Convert a two dimensional array of characters and attributes into a single
+ VT100 stream that describes the characters and attributes, with a specified
+ string following each line.
+
+ @param String On successful completion, updated to contain the VT100 string.
+        This string may be reallocated within this routine.
+
+ @param BufferSize Specifies the dimensions of the array.  Both buffers are
+        expected to contain X*Y elements.
+
+ @param CharBuffer Pointer to the buffer containing text.
+
+ @param AttrBuffer Pointer to the buffer containing attributes.
+
+ @param LineEnding Pointer to a string to append after each line.  This may
+        be empty if lines should not be separated.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+YoriLibGenerateVtStringWithLineEnding(
+    __inout PYORI_STRING String,
+    __in COORD BufferSize,
+    __in LPWSTR CharBuffer,
+    __in PWORD AttrBuffer,
+    __in PCYORI_STRING LineEnding
+    )
+{
+    DWORDLONG BufferSizeNeeded;
+    DWORD CellCount;
+    DWORD CellIndex;
+    DWORD LineStart;
+    SHORT LineIndex;
+    SHORT CharIndex;
+    SHORT RunEnd;
+    WORD LastAttribute;
+    TCHAR EscapeStringBuffer[YORI_MAX_VT_ESCAPE_CHARS];
+    YORI_STRING EscapeString;
+
+    //
+    //  A temporary string to hold a single Vt escape sequence
+    //
+
+    YoriLibInitEmptyString(&EscapeString);
+    EscapeString.StartOfString = EscapeStringBuffer;
+    EscapeString.LengthAllocated = sizeof(EscapeStringBuffer)/sizeof(EscapeStringBuffer[0]);
+
+    //
+    //  We'll need a buffer that's at least big enough to hold all the text
+    //  with line endings and a terminator
+    //
+
+    BufferSizeNeeded = BufferSize.X + LineEnding->LengthInChars;
+    BufferSizeNeeded = BufferSizeNeeded * BufferSize.Y + 1;
+
+    //
+    //  Now go through the attributes and add in the size of any escapes
+    //  needed.  Escapes only depend on attribute changes, so this doesn't
+    //  care where lines begin and end.
+    //
+
+    CellCount = BufferSize.X * BufferSize.Y;
+    LastAttribute = AttrBuffer[0];
+    YoriLibVtStringForTextAttribute(&EscapeString, 0, LastAttribute);
+    BufferSizeNeeded += EscapeString.LengthInChars;
+
+    for (CellIndex = 1; CellIndex < CellCount; CellIndex++) {
+        if (AttrBuffer[CellIndex] != LastAttribute) {
+            LastAttribute = AttrBuffer[CellIndex];
+            YoriLibVtStringForTextAttribute(&EscapeString, 0, LastAttribute);
+            BufferSizeNeeded += EscapeString.LengthInChars;
+        }
+    }
+
+    //
+    //  Allocate a buffer of sufficient size if it's not allocated already
+    //
+
+    if (!YoriLibIsSizeAllocatable(BufferSizeNeeded)) {
+        return FALSE;
+    }
+
+    if (String->LengthAllocated < (YORI_ALLOC_SIZE_T)BufferSizeNeeded) {
+        YoriLibFreeStringContents(String);
+        if (!YoriLibAllocateString(String, (YORI_ALLOC_SIZE_T)BufferSizeNeeded)) {
+            return FALSE;
+        }
+    }
+
+    //
+    //  Go through again populating both text and escapes into the output
+    //  buffer.  Each run of characters with the same attribute is copied
+    //  in one operation.
+    //
+
+    String->LengthInChars = 0;
+    LastAttribute = AttrBuffer[0];
+    YoriLibVtStringForTextAttribute(&EscapeString, 0, LastAttribute);
+
+    memcpy(&String->StartOfString[String->LengthInChars], EscapeString.StartOfString, EscapeString.LengthInChars * sizeof(TCHAR));
+    String->LengthInChars = String->LengthInChars + EscapeString.LengthInChars;
+
+    for (LineIndex = 0; LineIndex < BufferSize.Y; LineIndex++) {
+        LineStart = LineIndex * BufferSize.X;
+        CharIndex = 0;
+        while (CharIndex < BufferSize.X) {
+            if (AttrBuffer[LineStart + CharIndex] != LastAttribute) {
+                LastAttribute = AttrBuffer[LineStart + CharIndex];
+                YoriLibVtStringForTextAttribute(&EscapeString, 0, LastAttribute);
+                memcpy(&String->StartOfString[String->LengthInChars], EscapeString.StartOfString, EscapeString.LengthInChars * sizeof(TCHAR));
+                String->LengthInChars = String->LengthInChars + EscapeString.LengthInChars;
+            }
+
+            RunEnd = (SHORT)(CharIndex + 1);
+            while (RunEnd < BufferSize.X && AttrBuffer[LineStart + RunEnd] == LastAttribute) {
+                RunEnd++;
+            }
+
+            memcpy(&String->StartOfString[String->LengthInChars], &CharBuffer[LineStart + CharIndex], (RunEnd - CharIndex) * sizeof(TCHAR));
+            String->LengthInChars = String->LengthInChars + (YORI_ALLOC_SIZE_T)(RunEnd - CharIndex);
+            CharIndex = RunEnd;
+        }
+
+        memcpy(&String->StartOfString[String->LengthInChars], LineEnding->StartOfString, LineEnding->LengthInChars * sizeof(TCHAR));
+        String->LengthInChars = String->LengthInChars + LineEnding->LengthInChars;
+    }
+
+    ASSERT(EscapeString.StartOfString == EscapeStringBuffer);
+    ASSERT(String->LengthInChars < String->LengthAllocated);
+
+    return TRUE;
+}
+
 /**
  Read contents from the console window and send the contents to a device.
 
@@ -51,10 +185,19 @@ YoriLibRewriteConsoleContents(
     HANDLE hConsole;
     SMALL_RECT ReadWindow;
     PCHAR_INFO ReadBuffer;
+    LPWSTR CharBuffer;
+    PWORD AttrBuffer;
     COORD ReadBufferSize;
     COORD ReadBufferOffset;
-    DWORD LastAttribute;
+    YORI_STRING VtString;
+    YORI_STRING LineEnding;
+    DWORD CellCount;
+    DWORD CellIndex;
+    DWORD ChunkCellCount;
+    DWORD CurrentMode;
     WORD LineIndex;
+    WORD ChunkLines;
+    BOOL Result;
 
     hConsole = CreateFile(_T("CONOUT$"), GENERIC_READ|GENERIC_WRITE, FILE_SHARE_READ|FILE_SHARE_WRITE|FILE_SHARE_DELETE, NULL, OPEN_EXISTING, 0, NULL);
     if (hConsole == INVALID_HANDLE_VALUE) {
@@ -92,63 +235,103 @@ YoriLibRewriteConsoleContents(
     ReadBufferSize.X = (WORD)(ReadWindow.Right - ReadWindow.Left + 1);
     ReadBufferSize.Y = (WORD)(ReadWindow.Bottom - ReadWindow.Top + 1);
 
-    ReadBuffer = YoriLibMalloc(ReadBufferSize.X * ReadBufferSize.Y * sizeof(CHAR_INFO));
+    //
+    //  Allocate a buffer for the cells returned from the console, and
+    //  buffers to hold the text and attributes of those cells separately.
+    //
+
+    CellCount = ReadBufferSize.X * ReadBufferSize.Y;
+    ReadBuffer = YoriLibMalloc(CellCount * sizeof(CHAR_INFO));
     if (ReadBuffer == NULL) {
         CloseHandle(hConsole);
         return FALSE;
     }
 
+    CharBuffer = YoriLibMalloc(CellCount * (sizeof(WCHAR) + sizeof(WORD)));
+    if (CharBuffer == NULL) {
+        YoriLibFree(ReadBuffer);
+        CloseHandle(hConsole);
+        return FALSE;
+    }
+    AttrBuffer = (PWORD)(CharBuffer + CellCount);
+
     ReadBufferOffset.X = 0;
     ReadBufferOffset.Y = 0;
 
     //
-    //  ReadConsoleOutput fails if it's given a large request, so give it
-    //  a pile of small (one line) requests.
+    //  ReadConsoleOutput fails if it's given a request larger than the
+    //  console host is willing to process, and that limit varies between
+    //  versions.  Start by asking for everything, and if that fails, halve
+    //  the request until it succeeds.  Once a size succeeds, keep using it.
     //
 
-    for (LineIndex = 0; LineIndex < (WORD)ReadBufferSize.Y; LineIndex++) {
-        SMALL_RECT LineReadWindow;
-        COORD LineReadBufferSize;
+    ChunkLines = ReadBufferSize.Y;
+    LineIndex = 0;
+    while (LineIndex < (WORD)ReadBufferSize.Y) {
+        SMALL_RECT ChunkReadWindow;
+        COORD ChunkReadBufferSize;
 
-        LineReadWindow.Left = ReadWindow.Left;
-        LineReadWindow.Right = ReadWindow.Right;
-        LineReadWindow.Top = (WORD)(ReadWindow.Top + LineIndex);
-        LineReadWindow.Bottom = LineReadWindow.Top;
+        if (ChunkLines > (WORD)(ReadBufferSize.Y - LineIndex)) {
+            ChunkLines = (WORD)(ReadBufferSize.Y - LineIndex);
+        }
+
+        ChunkReadWindow.Left = ReadWindow.Left;
+        ChunkReadWindow.Right = ReadWindow.Right;
+        ChunkReadWindow.Top = (WORD)(ReadWindow.Top + LineIndex);
+        ChunkReadWindow.Bottom = (WORD)(ChunkReadWindow.Top + ChunkLines - 1);
 
-        LineReadBufferSize.X = ReadBufferSize.X;
-        LineReadBufferSize.Y = 1;
+        ChunkReadBufferSize.X = ReadBufferSize.X;
+        ChunkReadBufferSize.Y = ChunkLines;
 
-        if (!ReadConsoleOutput(hConsole, &ReadBuffer[LineIndex * ReadBufferSize.X], LineReadBufferSize, ReadBufferOffset, &LineReadWindow)) {
+        if (!ReadConsoleOutput(hConsole, &ReadBuffer[LineIndex * ReadBufferSize.X], ChunkReadBufferSize, ReadBufferOffset, &ChunkReadWindow)) {
+            if (ChunkLines > 1) {
+                ChunkLines = (WORD)(ChunkLines / 2);
+                continue;
+            }
             CloseHandle(hConsole);
+            YoriLibFree(CharBuffer);
             YoriLibFree(ReadBuffer);
             return FALSE;
         }
-    }
 
-    YoriLibVtSetConsoleTextAttrDev(hTarget, 0, 0, ReadBuffer[0].Attributes);
-    LastAttribute = ReadBuffer[0].Attributes;
+        //
+        //  Split the cells into text and attributes.
+        //
+
+        ChunkCellCount = ChunkLines * ReadBufferSize.X;
+        for (CellIndex = LineIndex * ReadBufferSize.X; ChunkCellCount > 0; CellIndex++, ChunkCellCount--) {
+            CharBuffer[CellIndex] = ReadBuffer[CellIndex].Char.UnicodeChar;
+            AttrBuffer[CellIndex] = ReadBuffer[CellIndex].Attributes;
+        }
+
+        LineIndex = (WORD)(LineIndex + ChunkLines);
+    }
 
-    for (ReadBufferOffset.Y = 0; ReadBufferOffset.Y < ReadBufferSize.Y; ReadBufferOffset.Y++) {
-        DWORD CurrentMode;
+    CloseHandle(hConsole);
+    YoriLibFree(ReadBuffer);
 
-        for (ReadBufferOffset.X = 0; ReadBufferOffset.X < ReadBufferSize.X; ReadBufferOffset.X++) {
-            DWORD CellIndex;
+    //
+    //  A console wraps each full line onto the next line, so only a file
+    //  needs line breaks.
+    //
 
-            CellIndex = ReadBufferOffset.Y * ReadBufferSize.X + ReadBufferOffset.X;
+    if (GetConsoleMode(hTarget, &CurrentMode)) {
+        YoriLibInitEmptyString(&LineEnding);
+    } else {
+        YoriLibConstantString(&LineEnding, _T("\n"));
+    }
 
-            if (ReadBuffer[CellIndex].Attributes != LastAttribute) {
-                YoriLibVtSetConsoleTextAttrDev(hTarget, 0, 0, ReadBuffer[CellIndex].Attributes);
-                LastAttribute = ReadBuffer[CellIndex].Attributes;
-            }
-            YoriLibOutputToDevice(hTarget, 0, _T("%c"), ReadBuffer[CellIndex].Char.UnicodeChar);
-        }
-        if (!GetConsoleMode(hTarget, &CurrentMode)) {
-            YoriLibOutputToDevice(hTarget, 0, _T("\n"));
-        }
+    YoriLibInitEmptyString(&VtString);
+    if (!YoriLibGenerateVtStringWithLineEnding(&VtString, ReadBufferSize, CharBuffer, AttrBuffer, &LineEnding)) {
+        YoriLibFree(CharBuffer);
+        return FALSE;
     }
 
-    YoriLibFree(ReadBuffer);
-    return TRUE;
+    YoriLibFree(CharBuffer);
+
+    Result = YoriLibOutputString(hTarget, 0, &VtString);
+    YoriLibFreeStringContents(&VtString);
+    return Result;
 }
 
 /**
@@ -175,94 +358,10 @@ YoriLibGenerateVtStringFromConsoleBuffers(
     __in PWORD AttrBuffer
     )
 {
-    DWORD BufferSizeNeeded;
-    SHORT LineIndex;
-    SHORT CharIndex;
-    WORD LastAttribute;
-    TCHAR EscapeStringBuffer[YORI_MAX_VT_ESCAPE_CHARS];
-    YORI_STRING EscapeString;
-
-    //
-    //  A temporary string to hold a single Vt escape sequence
-    //
-
-    YoriLibInitEmptyString(&EscapeString);
-    EscapeString.StartOfString = EscapeStringBuffer;
-    EscapeString.LengthAllocated = sizeof(EscapeStringBuffer)/sizeof(EscapeStringBuffer[0]);
-
-    //
-    //  We'll need a buffer that's at least big enough to hold all the text
-    //  with some newlines and a terminator
-    //
+    YORI_STRING LineEnding;
 
-    BufferSizeNeeded = (BufferSize.X + 2) * BufferSize.Y + 1;
-
-    //
-    //  Now go through the attributes and add in the size of any escapes
-    //  needed
-    //
-
-    LastAttribute = AttrBuffer[0];
-    YoriLibVtStringForTextAttribute(&EscapeString, 0, LastAttribute);
-    BufferSizeNeeded += EscapeString.LengthInChars;
-
-    for (LineIndex = 0; LineIndex < BufferSize.Y; LineIndex++) {
-        for (CharIndex = 0; CharIndex < BufferSize.X; CharIndex++) {
-            if (AttrBuffer[LineIndex * BufferSize.X + CharIndex] != LastAttribute) {
-                LastAttribute = AttrBuffer[LineIndex * BufferSize.X + CharIndex];
-                YoriLibVtStringForTextAttribute(&EscapeString, 0, LastAttribute);
-                BufferSizeNeeded += EscapeString.LengthInChars;
-            }
-        }
-    }
-
-    //
-    //  Allocate a buffer of sufficient size if it's not allocated already
-    //
-
-    if (!YoriLibIsSizeAllocatable(BufferSizeNeeded)) {
-        return FALSE;
-    }
-
-    if (String->LengthAllocated < (YORI_ALLOC_SIZE_T)BufferSizeNeeded) {
-        YoriLibFreeStringContents(String);
-        if (!YoriLibAllocateString(String, (YORI_ALLOC_SIZE_T)BufferSizeNeeded)) {
-            return FALSE;
-        }
-    }
-
-    //
-    //  Go through again populating both text and escapes into the output
-    //  buffer
-    //
-
-    String->LengthInChars = 0;
-    LastAttribute = AttrBuffer[0];
-    YoriLibVtStringForTextAttribute(&EscapeString, 0, LastAttribute);
-
-    memcpy(&String->StartOfString[String->LengthInChars], EscapeString.StartOfString, EscapeString.LengthInChars * sizeof(TCHAR));
-    String->LengthInChars = String->LengthInChars + EscapeString.LengthInChars;
-
-    for (LineIndex = 0; LineIndex < BufferSize.Y; LineIndex++) {
-        for (CharIndex = 0; CharIndex < BufferSize.X; CharIndex++) {
-            if (AttrBuffer[LineIndex * BufferSize.X + CharIndex] != LastAttribute) {
-                LastAttribute = AttrBuffer[LineIndex * BufferSize.X + CharIndex];
-                YoriLibVtStringForTextAttribute(&EscapeString, 0, LastAttribute);
-                memcpy(&String->StartOfString[String->LengthInChars], EscapeString.StartOfString, EscapeString.LengthInChars * sizeof(TCHAR));
-                String->LengthInChars = String->LengthInChars + EscapeString.LengthInChars;
-            }
-            String->StartOfString[String->LengthInChars] = CharBuffer[LineIndex * BufferSize.X + CharIndex];
-            String->LengthInChars++;
-        }
-
-        String->StartOfString[String->LengthInChars] = '\r';
-        String->StartOfString[String->LengthInChars + 1] = '\n';
-        String->LengthInChars += 2;
-    }
-
-    ASSERT(EscapeString.StartOfString == EscapeStringBuffer);
-
-    return TRUE;
+    YoriLibConstantString(&LineEnding, _T("\r\n"));
+    return YoriLibGenerateVtStringWithLineEnding(String, BufferSize, CharBuffer, AttrBuffer, &LineEnding);
 }
 
 // vim:sw=4:ts=4:et:
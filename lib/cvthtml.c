@@ -443,16 +443,11 @@ YoriLibHtmlGenerateEscapeStringInternal(
     __inout PYORILIB_HTML_GENERATE_CONTEXT GenerateContext
     )
 {
-    LPTSTR SrcPoint;
     YORI_ALLOC_SIZE_T SrcOffset;
     WORD NewColor = CVTVT_DEFAULT_COLOR;
-    YORI_ALLOC_SIZE_T RemainingLength;
     YORI_ALLOC_SIZE_T DestOffset;
     YORI_ALLOC_SIZE_T AddToDestOffset;
-    YORI_STRING SearchString;
-
-    SrcPoint = SrcString->StartOfString;
-    RemainingLength = SrcString->LengthInChars;
+    YORI_STRING Parameters;
 
     TextString->LengthInChars = 0;
     DestOffset = 0;
@@ -464,10 +459,10 @@ YoriLibHtmlGenerateEscapeStringInternal(
     //  is redundant.
     //
 
-    if (SrcString->LengthInChars >= 3 &&
-        SrcPoint[SrcString->LengthInChars - 1] == 'm') {
+    if (YoriLibVtGetSgrParameters(SrcString, &Parameters)) {
 
         DWORD code;
+        BOOLEAN MoreCodes;
         TCHAR NewTag[128];
         BOOLEAN NewUnderline = FALSE;
         PDWORD ColorTableToUse;
@@ -478,27 +473,13 @@ YoriLibHtmlGenerateEscapeStringInternal(
 
         AddToDestOffset = 0;
 
-        SrcPoint++;
-        RemainingLength--;
-
         //
         //  For something manipulating colors, go through the semicolon
         //  delimited list and apply the changes to the current color
         //
 
-        while (TRUE) {
-
-            //
-            //  Swallow either the ';' or '[' depending on whether we're
-            //  at the start or an intermediate component
-            //
-
-            SrcPoint++;
-            RemainingLength--;
-
-            SearchString.StartOfString = SrcPoint;
-            SearchString.LengthInChars = RemainingLength;
-            code = YoriLibDecimalStringToInt(&SearchString);
+        do {
+            MoreCodes = YoriLibVtGetNextSgrCode(&Parameters, &code);
             if (code == 0) {
                 NewColor = CVTVT_DEFAULT_COLOR;
                 NewUnderline = FALSE;
@@ -521,27 +502,7 @@ YoriLibHtmlGenerateEscapeStringInternal(
             } else if (code >= 100 && code <= 107) {
                 NewColor = (WORD)((NewColor & ~(0xf0)) | 0x80 | ((code - 100)<<4));
             }
-
-            //
-            //  We expect this to end with an 'm' at the end of the string, or
-            //  some other delimiter in the middle.  For paranoia maintain
-            //  length checking.
-            //
-
-            YoriLibInitEmptyString(&SearchString);
-            SearchString.StartOfString = SrcPoint;
-            SearchString.LengthInChars = RemainingLength;
-            SrcOffset = YoriLibCntStringWithChars(&SearchString, _T("0123456789"));
-
-            SrcPoint += SrcOffset;
-            RemainingLength = RemainingLength - SrcOffset;
-
-            if (RemainingLength == 0 ||
-                *SrcPoint != ';') {
-
-                break;
-            }
-        }
+        } while (MoreCodes);
 
         if (GenerateContext->TagOpen) {
             if (GenerateContext->UnderlineOn) {
@@ -681,8 +642,9 @@ YoriLibHtmlGenerateEscapeString(
 typedef struct _YORI_LIB_HTML_CONVERT_CONTEXT {
 
     /**
-     Pointer to the Html buffer generated thus far.  This may be periodically
-     reallocated.
+     Pointer to the Html buffer generated thus far.  When MeasureOnly is
+     FALSE, this is expected to have been allocated with sufficient space
+     for the output, but will be reallocated if it is not.
      */
     PYORI_STRING HtmlText;
 
@@ -692,6 +654,25 @@ typedef struct _YORI_LIB_HTML_CONVERT_CONTEXT {
      */
     PDWORD ColorTable;
 
+    /**
+     A buffer to generate each piece of text or escape into before it is
+     appended to HtmlText.  This is reused across calls and only grows, so
+     it is rarely reallocated.
+     */
+    YORI_STRING Scratch;
+
+    /**
+     The number of characters of output generated so far.  This is used to
+     determine the size of the buffer needed when MeasureOnly is TRUE.
+     */
+    YORI_MAX_UNSIGNED_T LengthNeeded;
+
+    /**
+     If TRUE, output is counted in LengthNeeded but not appended to
+     HtmlText.
+     */
+    BOOLEAN MeasureOnly;
+
     /**
      The context recording state while generation is in progress.
      */
@@ -737,6 +718,63 @@ YoriLibHtmlCvtAppendWithReallocate(
     return TRUE;
 }
 
+/**
+ Add a piece of generated HTML to the output.  If the context is only
+ measuring output, this records the length of the output without copying
+ it.
+
+ @param HtmlContext Pointer to the conversion context.
+
+ @param String Pointer to the generated HTML.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriLibHtmlCvtOutput(
+    __inout PYORI_LIB_HTML_CONVERT_CONTEXT HtmlContext,
+    __in PYORI_STRING String
+    )
+{
+    HtmlContext->LengthNeeded = HtmlContext->LengthNeeded + String->LengthInChars;
+    if (HtmlContext->MeasureOnly) {
+        if (!YoriLibIsSizeAllocatable(HtmlContext->LengthNeeded)) {
+            return FALSE;
+        }
+        return TRUE;
+    }
+
+    return YoriLibHtmlCvtAppendWithReallocate(HtmlContext->HtmlText, String);
+}
+
+/**
+ Ensure the scratch buffer within the conversion context can hold a
+ specified number of characters.  Any existing contents are discarded.
+
+ @param HtmlContext Pointer to the conversion context.
+
+ @param LengthNeeded The number of characters needed.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriLibHtmlCvtGrowScratch(
+    __inout PYORI_LIB_HTML_CONVERT_CONTEXT HtmlContext,
+    __in YORI_ALLOC_SIZE_T LengthNeeded
+    )
+{
+    YORI_ALLOC_SIZE_T AllocSize;
+
+    YoriLibFreeStringContents(&HtmlContext->Scratch);
+    AllocSize = YoriLibMaximumAllocationInRange(LengthNeeded, LengthNeeded * 2);
+    if (!YoriLibAllocateString(&HtmlContext->Scratch, AllocSize)) {
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
 /**
  Indicate the beginning of a stream and perform any initial output.
 
@@ -763,7 +801,7 @@ YoriLibHtmlCnvInitializeStream(
         return FALSE;
     }
 
-    if (!YoriLibHtmlCvtAppendWithReallocate(HtmlContext->HtmlText, &OutputString)) {
+    if (!YoriLibHtmlCvtOutput(HtmlContext, &OutputString)) {
         YoriLibFreeStringContents(&OutputString);
         return FALSE;
     }
@@ -800,7 +838,7 @@ YoriLibHtmlCnvEndStream(
         return FALSE;
     }
 
-    if (!YoriLibHtmlCvtAppendWithReallocate(HtmlContext->HtmlText, &OutputString)) {
+    if (!YoriLibHtmlCvtOutput(HtmlContext, &OutputString)) {
         YoriLibFreeStringContents(&OutputString);
         return FALSE;
     }
@@ -830,36 +868,33 @@ YoriLibHtmlCnvProcessAndOutputText(
     __inout PYORI_MAX_UNSIGNED_T Context
     )
 {
-
-    YORI_STRING TextString;
     YORI_ALLOC_SIZE_T BufferSizeNeeded;
     PYORI_LIB_HTML_CONVERT_CONTEXT HtmlContext = (PYORI_LIB_HTML_CONVERT_CONTEXT)hOutput;
 
     UNREFERENCED_PARAMETER(Context);
 
-    YoriLibInitEmptyString(&TextString);
-    BufferSizeNeeded = 0;
-    if (!YoriLibHtmlGenerateTextString(&TextString, &BufferSizeNeeded, String)) {
-        return FALSE;
-    }
-
-    if (!YoriLibAllocateString(&TextString, BufferSizeNeeded)) {
-        return FALSE;
-    }
+    //
+    //  Generate into the scratch buffer.  If it's not large enough, grow
+    //  it and try again.
+    //
 
     BufferSizeNeeded = 0;
-    if (!YoriLibHtmlGenerateTextString(&TextString, &BufferSizeNeeded, String)) {
-        YoriLibFreeStringContents(&TextString);
+    if (!YoriLibHtmlGenerateTextString(&HtmlContext->Scratch, &BufferSizeNeeded, String)) {
         return FALSE;
     }
 
-    if (!YoriLibHtmlCvtAppendWithReallocate(HtmlContext->HtmlText, &TextString)) {
-        YoriLibFreeStringContents(&TextString);
-        return FALSE;
+    if (BufferSizeNeeded > HtmlContext->Scratch.LengthAllocated) {
+        if (!YoriLibHtmlCvtGrowScratch(HtmlContext, BufferSizeNeeded)) {
+            return FALSE;
+        }
+
+        BufferSizeNeeded = 0;
+        if (!YoriLibHtmlGenerateTextString(&HtmlContext->Scratch, &BufferSizeNeeded, String)) {
+            return FALSE;
+        }
     }
 
-    YoriLibFreeStringContents(&TextString);
-    return TRUE;
+    return YoriLibHtmlCvtOutput(HtmlContext, &HtmlContext->Scratch);
 }
 
 
@@ -884,44 +919,90 @@ YoriLibHtmlCnvProcessAndOutputEscape(
     __inout PYORI_MAX_UNSIGNED_T Context
     )
 {
-    YORI_STRING TextString;
     YORI_ALLOC_SIZE_T BufferSizeNeeded;
     PYORI_LIB_HTML_CONVERT_CONTEXT HtmlContext = (PYORI_LIB_HTML_CONVERT_CONTEXT)hOutput;
     YORILIB_HTML_GENERATE_CONTEXT DummyGenerateContext;
 
     UNREFERENCED_PARAMETER(Context);
 
+    //
+    //  Generation updates the state, so generate with a copy of the state.
+    //  If the scratch buffer was large enough, the copy is the new state;
+    //  otherwise grow the buffer and generate again with the real state.
+    //
+
     memcpy(&DummyGenerateContext, &HtmlContext->GenerateContext, sizeof(YORILIB_HTML_GENERATE_CONTEXT));
 
-    YoriLibInitEmptyString(&TextString);
     BufferSizeNeeded = 0;
-    if (!YoriLibHtmlGenerateEscapeStringInternal(&TextString, &BufferSizeNeeded, HtmlContext->ColorTable, String, &DummyGenerateContext)) {
+    if (!YoriLibHtmlGenerateEscapeStringInternal(&HtmlContext->Scratch, &BufferSizeNeeded, HtmlContext->ColorTable, String, &DummyGenerateContext)) {
         return FALSE;
     }
 
-    if (!YoriLibAllocateString(&TextString, BufferSizeNeeded)) {
+    if (BufferSizeNeeded <= HtmlContext->Scratch.LengthAllocated) {
+        memcpy(&HtmlContext->GenerateContext, &DummyGenerateContext, sizeof(YORILIB_HTML_GENERATE_CONTEXT));
+    } else {
+        if (!YoriLibHtmlCvtGrowScratch(HtmlContext, BufferSizeNeeded)) {
+            return FALSE;
+        }
+
+        BufferSizeNeeded = 0;
+        if (!YoriLibHtmlGenerateEscapeStringInternal(&HtmlContext->Scratch, &BufferSizeNeeded, HtmlContext->ColorTable, String, &HtmlContext->GenerateContext)) {
+            return FALSE;
+        }
+    }
+
+    return YoriLibHtmlCvtOutput(HtmlContext, &HtmlContext->Scratch);
+}
+
+/**
+ Perform a single pass over VT100 text, generating HTML.
+
+ @param HtmlContext Pointer to the conversion context.
+
+ @param VtText Pointer to the string to convert.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriLibHtmlCvtPass(
+    __inout PYORI_LIB_HTML_CONVERT_CONTEXT HtmlContext,
+    __in PYORI_STRING VtText
+    )
+{
+    YORI_LIB_VT_CALLBACK_FUNCTIONS CallbackFunctions;
+
+    CallbackFunctions.InitializeStream = YoriLibHtmlCnvInitializeStream;
+    CallbackFunctions.EndStream = YoriLibHtmlCnvEndStream;
+    CallbackFunctions.ProcessAndOutputText = YoriLibHtmlCnvProcessAndOutputText;
+    CallbackFunctions.ProcessAndOutputEscape = YoriLibHtmlCnvProcessAndOutputEscape;
+    CallbackFunctions.Context = 0;
+
+    HtmlContext->LengthNeeded = 0;
+
+    if (!YoriLibHtmlCnvInitializeStream((HANDLE)HtmlContext, &CallbackFunctions.Context)) {
         return FALSE;
     }
 
-    BufferSizeNeeded = 0;
-    if (!YoriLibHtmlGenerateEscapeStringInternal(&TextString, &BufferSizeNeeded, HtmlContext->ColorTable, String, &HtmlContext->GenerateContext)) {
-        YoriLibFreeStringContents(&TextString);
+    if (!YoriLibProcVtEscOnOpenStream(VtText->StartOfString,
+                                      VtText->LengthInChars,
+                                      (HANDLE)HtmlContext,
+                                      &CallbackFunctions)) {
+
         return FALSE;
     }
 
-    if (!YoriLibHtmlCvtAppendWithReallocate(HtmlContext->HtmlText, &TextString)) {
-        YoriLibFreeStringContents(&TextString);
+    if (!YoriLibHtmlCnvEndStream((HANDLE)HtmlContext, &CallbackFunctions.Context)) {
         return FALSE;
     }
 
-    YoriLibFreeStringContents(&TextString);
     return TRUE;
 }
 
-
 /**
  Convert a Yori string containing VT100 text into HTML with the specified
- format.
+ format.  The conversion is performed twice: once to determine the size of
+ the output, and again to populate it, so the output is allocated once.
 
  @param VtText Pointer to the string to convert.
 
@@ -945,9 +1026,9 @@ YoriLibHtmlConvertToHtmlFromVt(
     __in DWORD HtmlVersion
     )
 {
-    YORI_LIB_VT_CALLBACK_FUNCTIONS CallbackFunctions;
     YORI_LIB_HTML_CONVERT_CONTEXT HtmlContext;
     BOOL FreeColorTable = FALSE;
+    BOOL Result;
 
     HtmlContext.HtmlText = HtmlText;
     HtmlContext.ColorTable = ColorTable;
@@ -958,44 +1039,39 @@ YoriLibHtmlConvertToHtmlFromVt(
             HtmlContext.ColorTable = YoriLibDefaultColorTable;
         }
     }
+    YoriLibInitEmptyString(&HtmlContext.Scratch);
     HtmlContext.GenerateContext.HtmlVersion = HtmlVersion;
 
-    CallbackFunctions.InitializeStream = YoriLibHtmlCnvInitializeStream;
-    CallbackFunctions.EndStream = YoriLibHtmlCnvEndStream;
-    CallbackFunctions.ProcessAndOutputText = YoriLibHtmlCnvProcessAndOutputText;
-    CallbackFunctions.ProcessAndOutputEscape = YoriLibHtmlCnvProcessAndOutputEscape;
-    CallbackFunctions.Context = 0;
-
-    if (!YoriLibHtmlCnvInitializeStream((HANDLE)&HtmlContext, &CallbackFunctions.Context)) {
-        if (FreeColorTable) {
-            YoriLibDereference(HtmlContext.ColorTable);
-        }
-        return FALSE;
-    }
+    //
+    //  Measure the output, allocate it, then generate it.  Each pass
+    //  starts the stream again, which resets the generation state.
+    //
 
-    if (!YoriLibProcVtEscOnOpenStream(VtText->StartOfString,
-                                      VtText->LengthInChars,
-                                      (HANDLE)&HtmlContext,
-                                      &CallbackFunctions)) {
+    HtmlContext.MeasureOnly = TRUE;
+    Result = YoriLibHtmlCvtPass(&HtmlContext, VtText);
 
-        if (FreeColorTable) {
-            YoriLibDereference(HtmlContext.ColorTable);
+    if (Result) {
+        HtmlContext.LengthNeeded = HtmlContext.LengthNeeded + HtmlText->LengthInChars;
+        if (!YoriLibIsSizeAllocatable(HtmlContext.LengthNeeded)) {
+            Result = FALSE;
+        } else if (HtmlContext.LengthNeeded > HtmlText->LengthAllocated) {
+            if (!YoriLibReallocString(HtmlText, (YORI_ALLOC_SIZE_T)HtmlContext.LengthNeeded)) {
+                Result = FALSE;
+            }
         }
-
-        return FALSE;
     }
 
-    if (!YoriLibHtmlCnvEndStream((HANDLE)&HtmlContext, &CallbackFunctions.Context)) {
-        if (FreeColorTable) {
-            YoriLibDereference(HtmlContext.ColorTable);
-        }
-        return FALSE;
+    if (Result) {
+        HtmlContext.MeasureOnly = FALSE;
+        Result = YoriLibHtmlCvtPass(&HtmlContext, VtText);
     }
+
+    YoriLibFreeStringContents(&HtmlContext.Scratch);
     if (FreeColorTable) {
         YoriLibDereference(HtmlContext.ColorTable);
     }
 
-    return TRUE;
+    return Result;
 }
 
 // vim:sw=4:ts=4:et:
@@ -384,20 +384,15 @@ YoriLibRtfGenerateEscapeString(
     __inout PBOOLEAN UnderlineState
     )
 {
-    LPTSTR SrcPoint;
     YORI_ALLOC_SIZE_T SrcOffset;
     WORD NewColor = CVTVT_DEFAULT_COLOR;
-    YORI_ALLOC_SIZE_T RemainingLength;
     YORI_ALLOC_SIZE_T DestOffset;
-    YORI_STRING SearchString;
+    YORI_STRING Parameters;
     LPTSTR UnderlineString;
     BOOLEAN PreviousUnderlineOn;
 
-    RemainingLength = SrcString->LengthInChars;
-
     TextString->LengthInChars = 0;
     DestOffset = 0;
-    SrcPoint = SrcString->StartOfString;
     SrcOffset = 0;
 
     //
@@ -406,34 +401,20 @@ YoriLibRtfGenerateEscapeString(
     //  is redundant.
     //
 
-    if (SrcString->LengthInChars >= 3 &&
-        SrcPoint[SrcString->LengthInChars - 1] == 'm') {
+    if (YoriLibVtGetSgrParameters(SrcString, &Parameters)) {
 
         DWORD code;
+        BOOLEAN MoreCodes;
         TCHAR NewTag[128];
         BOOLEAN NewUnderline = FALSE;
 
-        SrcPoint++;
-        RemainingLength--;
-
         //
         //  For something manipulating colors, go through the semicolon
         //  delimited list and apply the changes to the current color
         //
 
-        while (TRUE) {
-
-            //
-            //  Swallow either the ';' or '[' depending on whether we're
-            //  at the start or an intermediate component
-            //
-
-            SrcPoint++;
-            RemainingLength--;
-
-            SearchString.StartOfString = SrcPoint;
-            SearchString.LengthInChars = RemainingLength;
-            code = YoriLibDecimalStringToInt(&SearchString);
+        do {
+            MoreCodes = YoriLibVtGetNextSgrCode(&Parameters, &code);
             if (code == 0) {
                 NewColor = CVTVT_DEFAULT_COLOR;
                 NewUnderline = FALSE;
@@ -456,27 +437,7 @@ YoriLibRtfGenerateEscapeString(
             } else if (code >= 100 && code <= 107) {
                 NewColor = (WORD)((NewColor & ~(0xf0)) | 0x80 | ((code - 100)<<4));
             }
-
-            //
-            //  We expect this to end with an 'm' at the end of the string, or
-            //  some other delimiter in the middle.  For paranoia maintain
-            //  length checking.
-            //
-
-            YoriLibInitEmptyString(&SearchString);
-            SearchString.StartOfString = SrcPoint;
-            SearchString.LengthInChars = RemainingLength;
-            SrcOffset = YoriLibCntStringWithChars(&SearchString, _T("0123456789"));
-
-            SrcPoint += SrcOffset;
-            RemainingLength = RemainingLength - SrcOffset;
-
-            if (RemainingLength == 0 ||
-                *SrcPoint != ';') {
-
-                break;
-            }
-        }
+        } while (MoreCodes);
 
         PreviousUnderlineOn = *UnderlineState;
 
@@ -533,8 +494,9 @@ YoriLibRtfGenerateEscapeString(
 typedef struct _YORI_LIB_RTF_CONVERT_CONTEXT {
 
     /**
-     Pointer to the Rtf buffer generated thus far.  This may be periodically
-     reallocated.
+     Pointer to the Rtf buffer generated thus far.  When MeasureOnly is
+     FALSE, this is expected to have been allocated with sufficient space
+     for the output, but will be reallocated if it is not.
      */
     PYORI_STRING RtfText;
 
@@ -544,6 +506,25 @@ typedef struct _YORI_LIB_RTF_CONVERT_CONTEXT {
      */
     PDWORD ColorTable;
 
+    /**
+     A buffer to generate each piece of text or escape into before it is
+     appended to RtfText.  This is reused across calls and only grows, so
+     it is rarely reallocated.
+     */
+    YORI_STRING Scratch;
+
+    /**
+     The number of characters of output generated so far.  This is used to
+     determine the size of the buffer needed when MeasureOnly is TRUE.
+     */
+    YORI_MAX_UNSIGNED_T LengthNeeded;
+
+    /**
+     If TRUE, output is counted in LengthNeeded but not appended to
+     RtfText.
+     */
+    BOOLEAN MeasureOnly;
+
     /**
      The current state of underline.
      */
@@ -588,6 +569,63 @@ YoriLibRtfCvtAppendWithReallocate(
     return TRUE;
 }
 
+/**
+ Add a piece of generated RTF to the output.  If the context is only
+ measuring output, this records the length of the output without copying
+ it.
+
+ @param RtfContext Pointer to the conversion context.
+
+ @param String Pointer to the generated RTF.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriLibRtfCvtOutput(
+    __inout PYORI_LIB_RTF_CONVERT_CONTEXT RtfContext,
+    __in PYORI_STRING String
+    )
+{
+    RtfContext->LengthNeeded = RtfContext->LengthNeeded + String->LengthInChars;
+    if (RtfContext->MeasureOnly) {
+        if (!YoriLibIsSizeAllocatable(RtfContext->LengthNeeded)) {
+            return FALSE;
+        }
+        return TRUE;
+    }
+
+    return YoriLibRtfCvtAppendWithReallocate(RtfContext->RtfText, String);
+}
+
+/**
+ Ensure the scratch buffer within the conversion context can hold a
+ specified number of characters.  Any existing contents are discarded.
+
+ @param RtfContext Pointer to the conversion context.
+
+ @param LengthNeeded The number of characters needed.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriLibRtfCvtGrowScratch(
+    __inout PYORI_LIB_RTF_CONVERT_CONTEXT RtfContext,
+    __in YORI_ALLOC_SIZE_T LengthNeeded
+    )
+{
+    YORI_ALLOC_SIZE_T AllocSize;
+
+    YoriLibFreeStringContents(&RtfContext->Scratch);
+    AllocSize = YoriLibMaximumAllocationInRange(LengthNeeded, LengthNeeded * 2);
+    if (!YoriLibAllocateString(&RtfContext->Scratch, AllocSize)) {
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
 /**
  Indicate the beginning of a stream and perform any initial output.
 
@@ -614,7 +652,7 @@ YoriLibRtfCnvInitializeStream(
         return FALSE;
     }
 
-    if (!YoriLibRtfCvtAppendWithReallocate(RtfContext->RtfText, &OutputString)) {
+    if (!YoriLibRtfCvtOutput(RtfContext, &OutputString)) {
         YoriLibFreeStringContents(&OutputString);
         return FALSE;
     }
@@ -650,7 +688,7 @@ YoriLibRtfCnvEndStream(
         return FALSE;
     }
 
-    if (!YoriLibRtfCvtAppendWithReallocate(RtfContext->RtfText, &OutputString)) {
+    if (!YoriLibRtfCvtOutput(RtfContext, &OutputString)) {
         YoriLibFreeStringContents(&OutputString);
         return FALSE;
     }
@@ -680,36 +718,33 @@ YoriLibRtfCnvProcessAndOutputText(
     __inout PYORI_MAX_UNSIGNED_T Context
     )
 {
-
-    YORI_STRING TextString;
     YORI_ALLOC_SIZE_T BufferSizeNeeded;
     PYORI_LIB_RTF_CONVERT_CONTEXT RtfContext = (PYORI_LIB_RTF_CONVERT_CONTEXT)hOutput;
 
     UNREFERENCED_PARAMETER(Context);
 
-    YoriLibInitEmptyString(&TextString);
-    BufferSizeNeeded = 0;
-    if (!YoriLibRtfGenerateTextString(&TextString, &BufferSizeNeeded, String)) {
-        return FALSE;
-    }
-
-    if (!YoriLibAllocateString(&TextString, BufferSizeNeeded)) {
-        return FALSE;
-    }
+    //
+    //  Generate into the scratch buffer.  If it's not large enough, grow
+    //  it and try again.
+    //
 
     BufferSizeNeeded = 0;
-    if (!YoriLibRtfGenerateTextString(&TextString, &BufferSizeNeeded, String)) {
-        YoriLibFreeStringContents(&TextString);
+    if (!YoriLibRtfGenerateTextString(&RtfContext->Scratch, &BufferSizeNeeded, String)) {
         return FALSE;
     }
 
-    if (!YoriLibRtfCvtAppendWithReallocate(RtfContext->RtfText, &TextString)) {
-        YoriLibFreeStringContents(&TextString);
-        return FALSE;
+    if (BufferSizeNeeded > RtfContext->Scratch.LengthAllocated) {
+        if (!YoriLibRtfCvtGrowScratch(RtfContext, BufferSizeNeeded)) {
+            return FALSE;
+        }
+
+        BufferSizeNeeded = 0;
+        if (!YoriLibRtfGenerateTextString(&RtfContext->Scratch, &BufferSizeNeeded, String)) {
+            return FALSE;
+        }
     }
 
-    YoriLibFreeStringContents(&TextString);
-    return TRUE;
+    return YoriLibRtfCvtOutput(RtfContext, &RtfContext->Scratch);
 }
 
 
@@ -733,43 +768,91 @@ YoriLibRtfCnvProcessAndOutputEscape(
     __inout PYORI_MAX_UNSIGNED_T Context
     )
 {
-    YORI_STRING TextString;
     YORI_ALLOC_SIZE_T BufferSizeNeeded;
     PYORI_LIB_RTF_CONVERT_CONTEXT RtfContext = (PYORI_LIB_RTF_CONVERT_CONTEXT)hOutput;
     BOOLEAN DummyUnderlineState;
 
     UNREFERENCED_PARAMETER(Context);
 
-    YoriLibInitEmptyString(&TextString);
+    //
+    //  Generation updates the underline state, so generate with a copy of
+    //  the state.  If the scratch buffer was large enough, the copy is the
+    //  new state; otherwise grow the buffer and generate again with the
+    //  real state.
+    //
+
     BufferSizeNeeded = 0;
     DummyUnderlineState = RtfContext->UnderlineState;
-    if (!YoriLibRtfGenerateEscapeString(&TextString, &BufferSizeNeeded, String, &DummyUnderlineState)) {
+    if (!YoriLibRtfGenerateEscapeString(&RtfContext->Scratch, &BufferSizeNeeded, String, &DummyUnderlineState)) {
         return FALSE;
     }
 
-    if (!YoriLibAllocateString(&TextString, BufferSizeNeeded)) {
+    if (BufferSizeNeeded <= RtfContext->Scratch.LengthAllocated) {
+        RtfContext->UnderlineState = DummyUnderlineState;
+    } else {
+        if (!YoriLibRtfCvtGrowScratch(RtfContext, BufferSizeNeeded)) {
+            return FALSE;
+        }
+
+        BufferSizeNeeded = 0;
+        if (!YoriLibRtfGenerateEscapeString(&RtfContext->Scratch, &BufferSizeNeeded, String, &RtfContext->UnderlineState)) {
+            return FALSE;
+        }
+    }
+
+    return YoriLibRtfCvtOutput(RtfContext, &RtfContext->Scratch);
+}
+
+/**
+ Perform a single pass over VT100 text, generating RTF.
+
+ @param RtfContext Pointer to the conversion context.
+
+ @param VtText Pointer to the string to convert.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriLibRtfCvtPass(
+    __inout PYORI_LIB_RTF_CONVERT_CONTEXT RtfContext,
+    __in PYORI_STRING VtText
+    )
+{
+    YORI_LIB_VT_CALLBACK_FUNCTIONS CallbackFunctions;
+
+    CallbackFunctions.InitializeStream = YoriLibRtfCnvInitializeStream;
+    CallbackFunctions.EndStream = YoriLibRtfCnvEndStream;
+    CallbackFunctions.ProcessAndOutputText = YoriLibRtfCnvProcessAndOutputText;
+    CallbackFunctions.ProcessAndOutputEscape = YoriLibRtfCnvProcessAndOutputEscape;
+    CallbackFunctions.Context = 0;
+
+    RtfContext->LengthNeeded = 0;
+    RtfContext->UnderlineState = FALSE;
+
+    if (!YoriLibRtfCnvInitializeStream((HANDLE)RtfContext, &CallbackFunctions.Context)) {
         return FALSE;
     }
 
-    BufferSizeNeeded = 0;
-    if (!YoriLibRtfGenerateEscapeString(&TextString, &BufferSizeNeeded, String, &RtfContext->UnderlineState)) {
-        YoriLibFreeStringContents(&TextString);
+    if (!YoriLibProcVtEscOnOpenStream(VtText->StartOfString,
+                                      VtText->LengthInChars,
+                                      (HANDLE)RtfContext,
+                                      &CallbackFunctions)) {
+
         return FALSE;
     }
 
-    if (!YoriLibRtfCvtAppendWithReallocate(RtfContext->RtfText, &TextString)) {
-        YoriLibFreeStringContents(&TextString);
+    if (!YoriLibRtfCnvEndStream((HANDLE)RtfContext, &CallbackFunctions.Context)) {
         return FALSE;
     }
 
-    YoriLibFreeStringContents(&TextString);
     return TRUE;
 }
 
-
 /**
  Convert a Yori string containing VT100 text into RTF with the specified
- format.
+ format.  The conversion is performed twice: once to determine the size of
+ the output, and again to populate it, so the output is allocated once.
 
  @param VtText Pointer to the string to convert.
 
@@ -789,9 +872,9 @@ YoriLibRtfConvertToRtfFromVt(
     __in_opt PDWORD ColorTable
     )
 {
-    YORI_LIB_VT_CALLBACK_FUNCTIONS CallbackFunctions;
     YORI_LIB_RTF_CONVERT_CONTEXT RtfContext;
     BOOL FreeColorTable = FALSE;
+    BOOL Result;
 
     RtfContext.RtfText = RtfText;
     RtfContext.ColorTable = ColorTable;
@@ -802,43 +885,37 @@ YoriLibRtfConvertToRtfFromVt(
             RtfContext.ColorTable = YoriLibDefaultColorTable;
         }
     }
-    RtfContext.UnderlineState = FALSE;
-
-    CallbackFunctions.InitializeStream = YoriLibRtfCnvInitializeStream;
-    CallbackFunctions.EndStream = YoriLibRtfCnvEndStream;
-    CallbackFunctions.ProcessAndOutputText = YoriLibRtfCnvProcessAndOutputText;
-    CallbackFunctions.ProcessAndOutputEscape = YoriLibRtfCnvProcessAndOutputEscape;
-    CallbackFunctions.Context = 0;
+    YoriLibInitEmptyString(&RtfContext.Scratch);
 
-    if (!YoriLibRtfCnvInitializeStream((HANDLE)&RtfContext, &CallbackFunctions.Context)) {
-        if (FreeColorTable) {
-            YoriLibDereference(RtfContext.ColorTable);
-        }
-        return FALSE;
-    }
+    //
+    //  Measure the output, allocate it, then generate it.
+    //
 
-    if (!YoriLibProcVtEscOnOpenStream(VtText->StartOfString,
-                                      VtText->LengthInChars,
-                                      (HANDLE)&RtfContext,
-                                      &CallbackFunctions)) {
+    RtfContext.MeasureOnly = TRUE;
+    Result = YoriLibRtfCvtPass(&RtfContext, VtText);
 
-        if (FreeColorTable) {
-            YoriLibDereference(RtfContext.ColorTable);
+    if (Result) {
+        RtfContext.LengthNeeded = RtfContext.LengthNeeded + RtfText->LengthInChars;
+        if (!YoriLibIsSizeAllocatable(RtfContext.LengthNeeded)) {
+            Result = FALSE;
+        } else if (RtfContext.LengthNeeded > RtfText->LengthAllocated) {
+            if (!YoriLibReallocString(RtfText, (YORI_ALLOC_SIZE_T)RtfContext.LengthNeeded)) {
+                Result = FALSE;
+            }
         }
-        return FALSE;
     }
 
-    if (!YoriLibRtfCnvEndStream((HANDLE)&RtfContext, &CallbackFunctions.Context)) {
-        if (FreeColorTable) {
-            YoriLibDereference(RtfContext.ColorTable);
-        }
-        return FALSE;
+    if (Result) {
+        RtfContext.MeasureOnly = FALSE;
+        Result = YoriLibRtfCvtPass(&RtfContext, VtText);
     }
 
+    YoriLibFreeStringContents(&RtfContext.Scratch);
     if (FreeColorTable) {
         YoriLibDereference(RtfContext.ColorTable);
     }
-    return TRUE;
+
+    return Result;
 }
 
 // vim:sw=4:ts=4:et:
@@ -0,0 +1,674 @@
+/**
+ * @file lib/delobj.c
+ *
+ * Delete files and directories, optionally on a pool of threads
+ *
+ * This module contains routines which delete objects found by enumeration,
+ * sending them to the recycle bin or deleting them with POSIX semantics if
+ * requested, and clearing attributes which prevent deletion.  Objects can be
+ * deleted on worker threads, in which case a directory is only deleted once
+ * every object found within it has been processed.
+ *
+ * Copyright (c) 2026 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "yoripch.h"
+#include "yorilib.h"
+
+/**
+ A directory whose contents are being deleted.  The directory can only be
+ deleted once every object within it has been processed.
+ */
+typedef struct _YORILIB_DELETE_DIRECTORY {
+
+    /**
+     The link within the list of directories whose contents are being
+     found.
+     */
+    YORI_LIST_ENTRY StackEntry;
+
+    /**
+     The fully qualified path to the directory.
+     */
+    YORI_STRING Path;
+
+    /**
+     The number of objects within the directory which have been found but
+     not yet processed.
+     */
+    DWORD ChildrenOutstanding;
+
+    /**
+     The job to delete the directory itself, once the directory has been
+     found and while objects within it are outstanding.
+     */
+    struct _YORILIB_DELETE_JOB *DirectoryJob;
+
+} YORILIB_DELETE_DIRECTORY, *PYORILIB_DELETE_DIRECTORY;
+
+/**
+ A single object to be deleted by a worker thread.
+ */
+typedef struct _YORILIB_DELETE_JOB {
+
+    /**
+     The work queue item for this job.
+     */
+    YORILIB_WORK_ITEM WorkItem;
+
+    /**
+     The fully qualified path to the object to delete.  This is allocated
+     as part of the job.
+     */
+    YORI_STRING FilePath;
+
+    /**
+     The attributes of the object from enumeration.
+     */
+    DWORD FileAttributes;
+
+    /**
+     The directory containing this object, to be notified when this object
+     has been processed, or NULL if the object is not within a directory
+     being deleted.
+     */
+    PYORILIB_DELETE_DIRECTORY Parent;
+
+    /**
+     Set to TRUE if the object was deleted successfully.
+     */
+    BOOLEAN Deleted;
+
+} YORILIB_DELETE_JOB, *PYORILIB_DELETE_JOB;
+
+/**
+ State for deleting a set of objects.
+ */
+typedef struct _YORILIB_DELETE_CONTEXT {
+
+    /**
+     The name of the program, used as a prefix for error messages.
+     */
+    LPCTSTR AppName;
+
+    /**
+     A combination of YORILIB_DELETE_ flags.
+     */
+    DWORD Flags;
+
+    /**
+     The number of worker threads deleting objects.
+     */
+    DWORD WorkerCount;
+
+    /**
+     A queue of objects to delete on worker threads.  This is NULL if
+     objects are deleted on the calling thread.
+     */
+    PYORILIB_WORK_QUEUE WorkQueue;
+
+    /**
+     A list of directories whose contents are currently being found, with
+     the most recently found at the end.
+     */
+    YORI_LIST_ENTRY DirectoryStack;
+
+    /**
+     The number of objects deleted successfully.
+     */
+    DWORDLONG ObjectsDeleted;
+
+    /**
+     The number of directories deleted successfully.
+     */
+    DWORDLONG DirectoriesDeleted;
+
+} YORILIB_DELETE_CONTEXT;
+
+/**
+ Attempt to delete a single object in the way requested by the caller,
+ without displaying errors.
+
+ @param DeleteContext Pointer to the delete context indicating which delete
+        mode to use.
+
+ @param FilePath Pointer to the object to delete.
+
+ @param FileAttributes The attributes of the object from enumeration.
+
+ @return TRUE to indicate the object was deleted, FALSE to indicate failure.
+         On failure, the last error is set.
+ */
+__success(return)
+BOOL
+YoriLibDeleteObjectOnce(
+    __in PYORILIB_DELETE_CONTEXT DeleteContext,
+    __in PYORI_STRING FilePath,
+    __in DWORD FileAttributes
+    )
+{
+    if (DeleteContext->Flags & YORILIB_DELETE_POSIX_SEMANTICS) {
+        return YoriLibPosixDeleteFile(FilePath);
+    }
+
+    if (FileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+        return RemoveDirectory(FilePath->StartOfString);
+    }
+
+    return DeleteFile(FilePath->StartOfString);
+}
+
+/**
+ Delete a single object, sending it to the recycle bin if requested, and
+ clearing attributes which prevent deletion if needed.  Errors are displayed
+ to the user.  This may be called on the calling thread or on a worker
+ thread.
+
+ @param DeleteContext Pointer to the delete context indicating which delete
+        mode to use.
+
+ @param FilePath Pointer to the object to delete.
+
+ @param FileAttributes The attributes of the object from enumeration.
+
+ @return TRUE to indicate the object was deleted, FALSE to indicate failure.
+ */
+BOOLEAN
+YoriLibDeleteObjectNow(
+    __in PYORILIB_DELETE_CONTEXT DeleteContext,
+    __in PYORI_STRING FilePath,
+    __in DWORD FileAttributes
+    )
+{
+    DWORD Err;
+    LPTSTR ErrText;
+    DWORD OldAttributes;
+    DWORD NewAttributes;
+
+    if (DeleteContext->Flags & YORILIB_DELETE_RECYCLE_BIN) {
+        if (YoriLibRecycleBinFile(FilePath)) {
+            return TRUE;
+        }
+    }
+
+    if (YoriLibDeleteObjectOnce(DeleteContext, FilePath, FileAttributes)) {
+        return TRUE;
+    }
+
+    //
+    //  If it fails with access denied, try to remove any readonly, hidden or
+    //  system attributes which might be getting in the way, then try the
+    //  delete again.
+    //
+
+    Err = GetLastError();
+    if (Err == ERROR_ACCESS_DENIED) {
+        OldAttributes = GetFileAttributes(FilePath->StartOfString);
+        NewAttributes = OldAttributes & ~(FILE_ATTRIBUTE_READONLY | FILE_ATTRIBUTE_HIDDEN | FILE_ATTRIBUTE_SYSTEM);
+
+        if (OldAttributes != NewAttributes) {
+            SetFileAttributes(FilePath->StartOfString, NewAttributes);
+            if (YoriLibDeleteObjectOnce(DeleteContext, FilePath, FileAttributes)) {
+                return TRUE;
+            }
+            Err = GetLastError();
+            SetFileAttributes(FilePath->StartOfString, OldAttributes);
+        }
+    }
+
+    ErrText = YoriLibGetWinErrorText(Err);
+    if (FileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%s: rmdir of %y failed: %s"), DeleteContext->AppName, FilePath, ErrText);
+    } else {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%s: delete of %y failed: %s"), DeleteContext->AppName, FilePath, ErrText);
+    }
+    YoriLibFreeWinErrorText(ErrText);
+    return FALSE;
+}
+
+/**
+ Record the result of deleting an object.
+
+ @param DeleteContext Pointer to the delete context.
+
+ @param FileAttributes The attributes of the object from enumeration.
+
+ @param Deleted TRUE if the object was deleted successfully.
+ */
+VOID
+YoriLibDeleteRecordResult(
+    __in PYORILIB_DELETE_CONTEXT DeleteContext,
+    __in DWORD FileAttributes,
+    __in BOOLEAN Deleted
+    )
+{
+    if (Deleted) {
+        DeleteContext->ObjectsDeleted++;
+        if (FileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+            DeleteContext->DirectoriesDeleted++;
+        }
+    }
+}
+
+/**
+ Delete an object that has been queued.  This is invoked on a worker
+ thread.
+
+ @param Context Pointer to the delete context.
+
+ @param WorkerContext Unused.
+
+ @param Item Pointer to the work queue item within the job to process.
+
+ @return TRUE to indicate the worker should continue processing jobs.
+ */
+BOOLEAN
+YoriLibDeleteExecuteJob(
+    __in PVOID Context,
+    __in PVOID WorkerContext,
+    __in PYORILIB_WORK_ITEM Item
+    )
+{
+    PYORILIB_DELETE_JOB Job;
+
+    UNREFERENCED_PARAMETER(WorkerContext);
+
+    Job = CONTAINING_RECORD(Item, YORILIB_DELETE_JOB, WorkItem);
+    Job->Deleted = YoriLibDeleteObjectNow((PYORILIB_DELETE_CONTEXT)Context, &Job->FilePath, Job->FileAttributes);
+    return TRUE;
+}
+
+/**
+ Record the result of a job which has been completed by a worker thread and
+ free it.  If this was the last outstanding object within a directory which
+ has already been found, the directory is queued for deletion.
+
+ @param Context Pointer to the delete context.
+
+ @param Item Pointer to the work queue item within the completed job.
+ */
+VOID
+YoriLibDeleteCompleteJob(
+    __in PVOID Context,
+    __in PYORILIB_WORK_ITEM Item
+    )
+{
+    PYORILIB_DELETE_CONTEXT DeleteContext;
+    PYORILIB_DELETE_JOB Job;
+    PYORILIB_DELETE_DIRECTORY Parent;
+
+    DeleteContext = (PYORILIB_DELETE_CONTEXT)Context;
+    Job = CONTAINING_RECORD(Item, YORILIB_DELETE_JOB, WorkItem);
+
+    //
+    //  If the workers have exited, the job was never executed, so delete
+    //  the object on this thread instead.
+    //
+
+    if (!Job->WorkItem.Executed) {
+        Job->Deleted = YoriLibDeleteObjectNow(DeleteContext, &Job->FilePath, Job->FileAttributes);
+    }
+
+    YoriLibDeleteRecordResult(DeleteContext, Job->FileAttributes, Job->Deleted);
+
+    Parent = Job->Parent;
+    if (Parent != NULL) {
+        ASSERT(Parent->ChildrenOutstanding > 0);
+        Parent->ChildrenOutstanding--;
+        if (Parent->ChildrenOutstanding == 0 && Parent->DirectoryJob != NULL) {
+            YoriLibWorkQueueSubmit(DeleteContext->WorkQueue, &Parent->DirectoryJob->WorkItem);
+            YoriLibFree(Parent);
+        }
+    }
+
+    YoriLibFree(Job);
+}
+
+/**
+ Find the tracking structure for a directory whose contents are being
+ found, optionally creating it if it does not exist.  Because enumeration
+ is depth first, the directory is normally the most recently created one.
+
+ @param DeleteContext Pointer to the delete context.
+
+ @param DirPath Pointer to the full path of the directory.
+
+ @param Create If TRUE, a new structure is created if none exists.
+
+ @return Pointer to the directory structure, or NULL if it does not exist
+         and could not be created.
+ */
+PYORILIB_DELETE_DIRECTORY
+YoriLibDeleteFindDirectory(
+    __in PYORILIB_DELETE_CONTEXT DeleteContext,
+    __in PYORI_STRING DirPath,
+    __in BOOLEAN Create
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PYORILIB_DELETE_DIRECTORY Directory;
+    YORI_MAX_UNSIGNED_T BytesNeeded;
+
+    ListEntry = YoriLibGetPreviousListEntry(&DeleteContext->DirectoryStack, NULL);
+    while (ListEntry != NULL) {
+        Directory = CONTAINING_RECORD(ListEntry, YORILIB_DELETE_DIRECTORY, StackEntry);
+        if (YoriLibCompareStringIns(&Directory->Path, DirPath) == 0) {
+            return Directory;
+        }
+        ListEntry = YoriLibGetPreviousListEntry(&DeleteContext->DirectoryStack, ListEntry);
+    }
+
+    if (!Create) {
+        return NULL;
+    }
+
+    BytesNeeded = sizeof(YORILIB_DELETE_DIRECTORY);
+    BytesNeeded += ((YORI_MAX_UNSIGNED_T)DirPath->LengthInChars + 1) * sizeof(TCHAR);
+    if (!YoriLibIsSizeAllocatable(BytesNeeded)) {
+        return NULL;
+    }
+
+    Directory = YoriLibMalloc((YORI_ALLOC_SIZE_T)BytesNeeded);
+    if (Directory == NULL) {
+        return NULL;
+    }
+
+    YoriLibInitEmptyString(&Directory->Path);
+    Directory->Path.StartOfString = (LPTSTR)(Directory + 1);
+    Directory->Path.LengthInChars = DirPath->LengthInChars;
+    Directory->Path.LengthAllocated = DirPath->LengthInChars + 1;
+    memcpy(Directory->Path.StartOfString, DirPath->StartOfString, DirPath->LengthInChars * sizeof(TCHAR));
+    Directory->Path.StartOfString[Directory->Path.LengthInChars] = '\0';
+    Directory->ChildrenOutstanding = 0;
+    Directory->DirectoryJob = NULL;
+
+    YoriLibAppendList(&DeleteContext->DirectoryStack, &Directory->StackEntry);
+    return Directory;
+}
+
+/**
+ Queue an object to be deleted by a worker thread.  Files are queued
+ immediately.  Directories are queued once every object found within them
+ has been processed.  If too many deletes are outstanding, this waits for
+ some to complete, so the rate of requests sent to the file system is
+ bounded by the number of workers.
+
+ @param DeleteContext Pointer to the delete context.
+
+ @param FilePath Pointer to the object to delete.
+
+ @param FileAttributes The attributes of the object from enumeration.
+
+ @param Depth The recursion depth of the object.  Objects at depth zero are
+        not within a directory being deleted.
+
+ @return TRUE to indicate the job was queued, FALSE if it could not be.
+ */
+__success(return)
+BOOL
+YoriLibDeleteQueueObject(
+    __in PYORILIB_DELETE_CONTEXT DeleteContext,
+    __in PYORI_STRING FilePath,
+    __in DWORD FileAttributes,
+    __in DWORD Depth
+    )
+{
+    PYORILIB_DELETE_JOB Job;
+    PYORILIB_DELETE_DIRECTORY Parent;
+    PYORILIB_DELETE_DIRECTORY Directory;
+    YORI_STRING ParentPath;
+    LPTSTR FinalSeperator;
+    YORI_MAX_UNSIGNED_T BytesNeeded;
+
+    Parent = NULL;
+    if (Depth > 0) {
+        FinalSeperator = YoriLibFindRightMostCharacter(FilePath, '\\');
+        if (FinalSeperator != NULL) {
+            YoriLibInitEmptyString(&ParentPath);
+            ParentPath.StartOfString = FilePath->StartOfString;
+            ParentPath.LengthInChars = (YORI_ALLOC_SIZE_T)(FinalSeperator - FilePath->StartOfString);
+            Parent = YoriLibDeleteFindDirectory(DeleteContext, &ParentPath, TRUE);
+            if (Parent == NULL) {
+                return FALSE;
+            }
+        }
+    }
+
+    BytesNeeded = sizeof(YORILIB_DELETE_JOB);
+    BytesNeeded += ((YORI_MAX_UNSIGNED_T)FilePath->LengthInChars + 1) * sizeof(TCHAR);
+
+    if (!YoriLibIsSizeAllocatable(BytesNeeded)) {
+        return FALSE;
+    }
+
+    Job = YoriLibMalloc((YORI_ALLOC_SIZE_T)BytesNeeded);
+    if (Job == NULL) {
+        return FALSE;
+    }
+
+    YoriLibWorkQueueInitializeItem(&Job->WorkItem);
+    YoriLibInitEmptyString(&Job->FilePath);
+    Job->FilePath.StartOfString = (LPTSTR)(Job + 1);
+    Job->FilePath.LengthInChars = FilePath->LengthInChars;
+    Job->FilePath.LengthAllocated = FilePath->LengthInChars + 1;
+    memcpy(Job->FilePath.StartOfString, FilePath->StartOfString, FilePath->LengthInChars * sizeof(TCHAR));
+    Job->FilePath.StartOfString[Job->FilePath.LengthInChars] = '\0';
+    Job->FileAttributes = FileAttributes;
+    Job->Parent = Parent;
+    Job->Deleted = FALSE;
+
+    if (Parent != NULL) {
+        Parent->ChildrenOutstanding++;
+    }
+
+    //
+    //  Directories are returned after their contents.  If any contents are
+    //  still being deleted, attach this job to the directory so the last
+    //  one to complete queues it.  Once the directory has been found,
+    //  nothing more will be found within it, so stop tracking it here.
+    //
+
+    Directory = NULL;
+    if (FileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+        Directory = YoriLibDeleteFindDirectory(DeleteContext, FilePath, FALSE);
+        if (Directory != NULL) {
+            YoriLibRemoveListItem(&Directory->StackEntry);
+        }
+    }
+
+    if (Directory != NULL && Directory->ChildrenOutstanding > 0) {
+        Directory->DirectoryJob = Job;
+    } else {
+        YoriLibWorkQueueSubmit(DeleteContext->WorkQueue, &Job->WorkItem);
+        if (Directory != NULL) {
+            YoriLibFree(Directory);
+        }
+    }
+
+    YoriLibWorkQueueComplete(DeleteContext->WorkQueue, DeleteContext->WorkerCount * 4, INFINITE);
+    return TRUE;
+}
+
+/**
+ Allocate a context for deleting a set of objects.
+
+ @param AppName The name of the program, used as a prefix for error
+        messages.
+
+ @param Flags A combination of YORILIB_DELETE_ flags.
+
+ @param WorkerCount The number of objects to delete at the same time.  If
+        this is one, objects are deleted on the calling thread.  Objects
+        sent to the recycle bin are always deleted on the calling thread,
+        because the recycle bin is implemented by the shell, which is not
+        expected to be called from many threads at once.
+
+ @return Pointer to the delete context, or NULL on failure, including if
+         worker threads could not be created.
+ */
+PYORILIB_DELETE_CONTEXT
+YoriLibDeleteCreateContext(
+    __in LPCTSTR AppName,
+    __in DWORD Flags,
+    __in DWORD WorkerCount
+    )
+{
+    PYORILIB_DELETE_CONTEXT DeleteContext;
+    DWORD Index;
+
+    DeleteContext = YoriLibMalloc(sizeof(YORILIB_DELETE_CONTEXT));
+    if (DeleteContext == NULL) {
+        return NULL;
+    }
+
+    ZeroMemory(DeleteContext, sizeof(YORILIB_DELETE_CONTEXT));
+    DeleteContext->AppName = AppName;
+    DeleteContext->Flags = Flags;
+    DeleteContext->WorkerCount = WorkerCount;
+    YoriLibInitializeListHead(&DeleteContext->DirectoryStack);
+
+    if (Flags & YORILIB_DELETE_RECYCLE_BIN) {
+        DeleteContext->WorkerCount = 1;
+    }
+
+    if (DeleteContext->WorkerCount > 1) {
+        DeleteContext->WorkQueue = YoriLibWorkQueueCreate(0, 1, YoriLibDeleteExecuteJob, YoriLibDeleteCompleteJob, DeleteContext);
+        if (DeleteContext->WorkQueue == NULL) {
+            YoriLibDeleteFreeContext(DeleteContext, NULL, NULL);
+            return NULL;
+        }
+
+        for (Index = 0; Index < DeleteContext->WorkerCount; Index++) {
+            if (!YoriLibWorkQueueAddWorker(DeleteContext->WorkQueue, NULL)) {
+                YoriLibDeleteFreeContext(DeleteContext, NULL, NULL);
+                return NULL;
+            }
+        }
+    }
+
+    return DeleteContext;
+}
+
+/**
+ Delete an object found by enumeration.  If worker threads are in use, the
+ object is queued and may not be deleted until a later call.  Objects within
+ a directory must be supplied before the directory itself, which is what
+ enumeration with YORILIB_FILEENUM_RECURSE_BEFORE_RETURN provides when not
+ enumerating in parallel.  This function must not be called on more than one
+ thread at a time.
+
+ @param DeleteContext Pointer to the delete context.
+
+ @param FilePath Pointer to the fully qualified path of the object to delete.
+
+ @param FileAttributes The attributes of the object from enumeration.
+
+ @param Depth The recursion depth of the object.  Objects at depth zero are
+        not within a directory being deleted.  Callers which never delete
+        directories can always pass zero.
+ */
+VOID
+YoriLibDeleteObject(
+    __in PYORILIB_DELETE_CONTEXT DeleteContext,
+    __in PYORI_STRING FilePath,
+    __in DWORD FileAttributes,
+    __in DWORD Depth
+    )
+{
+    PYORILIB_DELETE_DIRECTORY Directory;
+    BOOLEAN Deleted;
+
+    if (DeleteContext->WorkQueue != NULL) {
+        if (YoriLibDeleteQueueObject(DeleteContext, FilePath, FileAttributes, Depth)) {
+            return;
+        }
+
+        //
+        //  If the object couldn't be queued, wait for everything queued so
+        //  far, so a directory isn't deleted ahead of its contents.
+        //
+
+        YoriLibWorkQueueComplete(DeleteContext->WorkQueue, 0, INFINITE);
+        if (FileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+            Directory = YoriLibDeleteFindDirectory(DeleteContext, FilePath, FALSE);
+            if (Directory != NULL) {
+                YoriLibRemoveListItem(&Directory->StackEntry);
+                YoriLibFree(Directory);
+            }
+        }
+    }
+
+    Deleted = YoriLibDeleteObjectNow(DeleteContext, FilePath, FileAttributes);
+    YoriLibDeleteRecordResult(DeleteContext, FileAttributes, Deleted);
+}
+
+/**
+ Wait for all queued objects to be deleted, terminate worker threads, and
+ free a delete context.
+
+ @param DeleteContext Pointer to the delete context.
+
+ @param ObjectsDeleted Optionally points to a value to receive the number of
+        objects deleted successfully.
+
+ @param DirectoriesDeleted Optionally points to a value to receive the
+        number of directories deleted successfully.
+ */
+VOID
+YoriLibDeleteFreeContext(
+    __in PYORILIB_DELETE_CONTEXT DeleteContext,
+    __out_opt PDWORDLONG ObjectsDeleted,
+    __out_opt PDWORDLONG DirectoriesDeleted
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PYORILIB_DELETE_DIRECTORY Directory;
+
+    if (DeleteContext->WorkQueue != NULL) {
+        YoriLibWorkQueueDestroy(DeleteContext->WorkQueue);
+        DeleteContext->WorkQueue = NULL;
+    }
+
+    //
+    //  Any directories still being tracked were not themselves found, so
+    //  there is no further work for them.
+    //
+
+    ListEntry = YoriLibGetNextListEntry(&DeleteContext->DirectoryStack, NULL);
+    while (ListEntry != NULL) {
+        YoriLibRemoveListItem(ListEntry);
+        Directory = CONTAINING_RECORD(ListEntry, YORILIB_DELETE_DIRECTORY, StackEntry);
+        YoriLibFree(Directory);
+        ListEntry = YoriLibGetNextListEntry(&DeleteContext->DirectoryStack, NULL);
+    }
+
+    if (ObjectsDeleted != NULL) {
+        *ObjectsDeleted = DeleteContext->ObjectsDeleted;
+    }
+
+    if (DirectoriesDeleted != NULL) {
+        *DirectoriesDeleted = DeleteContext->DirectoriesDeleted;
+    }
+
+    YoriLibFree(DeleteContext);
+}
+
+// vim:sw=4:ts=4:et:
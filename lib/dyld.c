@@ -138,6 +138,7 @@ YoriLibLoadNtDllFunctions(VOID)
     }
     DllNtDll.pNtOpenDirectoryObject = (PNT_OPEN_DIRECTORY_OBJECT)GetProcAddress(DllNtDll.hDll, "NtOpenDirectoryObject");
     DllNtDll.pNtOpenSymbolicLinkObject = (PNT_OPEN_SYMBOLIC_LINK_OBJECT)GetProcAddress(DllNtDll.hDll, "NtOpenSymbolicLinkObject");
+    DllNtDll.pNtQueryDirectoryFile = (PNT_QUERY_DIRECTORY_FILE)GetProcAddress(DllNtDll.hDll, "NtQueryDirectoryFile");
     DllNtDll.pNtQueryDirectoryObject = (PNT_QUERY_DIRECTORY_OBJECT)GetProcAddress(DllNtDll.hDll, "NtQueryDirectoryObject");
     DllNtDll.pNtQueryInformationFile = (PNT_QUERY_INFORMATION_FILE)GetProcAddress(DllNtDll.hDll, "NtQueryInformationFile");
     DllNtDll.pNtQueryInformationProcess = (PNT_QUERY_INFORMATION_PROCESS)GetProcAddress(DllNtDll.hDll, "NtQueryInformationProcess");
@@ -145,8 +146,13 @@ YoriLibLoadNtDllFunctions(VOID)
     DllNtDll.pNtQueryObject = (PNT_QUERY_OBJECT)GetProcAddress(DllNtDll.hDll, "NtQueryObject");
     DllNtDll.pNtQuerySymbolicLinkObject = (PNT_QUERY_SYMBOLIC_LINK_OBJECT)GetProcAddress(DllNtDll.hDll, "NtQuerySymbolicLinkObject");
     DllNtDll.pNtQuerySystemInformation = (PNT_QUERY_SYSTEM_INFORMATION)GetProcAddress(DllNtDll.hDll, "NtQuerySystemInformation");
+    DllNtDll.pNtQuerySystemInformationEx = (PNT_QUERY_SYSTEM_INFORMATION_EX)GetProcAddress(DllNtDll.hDll, "NtQuerySystemInformationEx");
     DllNtDll.pNtSetInformationFile = (PNT_SET_INFORMATION_FILE)GetProcAddress(DllNtDll.hDll, "NtSetInformationFile");
+    DllNtDll.pNtSetInformationProcess = (PNT_SET_INFORMATION_PROCESS)GetProcAddress(DllNtDll.hDll, "NtSetInformationProcess");
     DllNtDll.pNtSystemDebugControl = (PNT_SYSTEM_DEBUG_CONTROL)GetProcAddress(DllNtDll.hDll, "NtSystemDebugControl");
+    DllNtDll.pRtlCompressBuffer = (PRTL_COMPRESS_BUFFER)GetProcAddress(DllNtDll.hDll, "RtlCompressBuffer");
+    DllNtDll.pRtlDecompressBuffer = (PRTL_DECOMPRESS_BUFFER)GetProcAddress(DllNtDll.hDll, "RtlDecompressBuffer");
+    DllNtDll.pRtlGetCompressionWorkSpaceSize = (PRTL_GET_COMPRESSION_WORK_SPACE_SIZE)GetProcAddress(DllNtDll.hDll, "RtlGetCompressionWorkSpaceSize");
     DllNtDll.pRtlGetLastNtStatus = (PRTL_GET_LAST_NT_STATUS)GetProcAddress(DllNtDll.hDll, "RtlGetLastNtStatus");
     return TRUE;
 }
@@ -166,6 +172,7 @@ CONST YORI_DLL_NAME_MAP DllKernel32Symbols[] = {
     {(FARPROC *)&DllKernel32.pCopyFileW, "CopyFileW"},
     {(FARPROC *)&DllKernel32.pCopyFileExW, "CopyFileExW"},
     {(FARPROC *)&DllKernel32.pCreateHardLinkW, "CreateHardLinkW"},
+    {(FARPROC *)&DllKernel32.pCreateIoCompletionPort, "CreateIoCompletionPort"},
     {(FARPROC *)&DllKernel32.pCreateJobObjectW, "CreateJobObjectW"},
     {(FARPROC *)&DllKernel32.pCreateSymbolicLinkW, "CreateSymbolicLinkW"},
     {(FARPROC *)&DllKernel32.pFindFirstStreamW, "FindFirstStreamW"},
@@ -197,6 +204,7 @@ CONST YORI_DLL_NAME_MAP DllKernel32Symbols[] = {
     {(FARPROC *)&DllKernel32.pGetPrivateProfileStringW, "GetPrivateProfileStringW"},
     {(FARPROC *)&DllKernel32.pGetProcessIoCounters, "GetProcessIoCounters"},
     {(FARPROC *)&DllKernel32.pGetProductInfo, "GetProductInfo"},
+    {(FARPROC *)&DllKernel32.pGetQueuedCompletionStatus, "GetQueuedCompletionStatus"},
     {(FARPROC *)&DllKernel32.pGetSystemPowerStatus, "GetSystemPowerStatus"},
     {(FARPROC *)&DllKernel32.pGetTickCount64, "GetTickCount64"},
     {(FARPROC *)&DllKernel32.pGetVersionExW, "GetVersionExW"},
@@ -213,6 +221,8 @@ CONST YORI_DLL_NAME_MAP DllKernel32Symbols[] = {
     {(FARPROC *)&DllKernel32.pLoadLibraryW, "LoadLibraryW"},
     {(FARPROC *)&DllKernel32.pLoadLibraryExW, "LoadLibraryExW"},
     {(FARPROC *)&DllKernel32.pOpenThread, "OpenThread"},
+    {(FARPROC *)&DllKernel32.pPssCaptureSnapshot, "PssCaptureSnapshot"},
+    {(FARPROC *)&DllKernel32.pPssFreeSnapshot, "PssFreeSnapshot"},
     {(FARPROC *)&DllKernel32.pQueryFullProcessImageNameW, "QueryFullProcessImageNameW"},
     {(FARPROC *)&DllKernel32.pQueryInformationJobObject, "QueryInformationJobObject"},
     {(FARPROC *)&DllKernel32.pRegisterApplicationRestart, "RegisterApplicationRestart"},
@@ -225,6 +235,7 @@ CONST YORI_DLL_NAME_MAP DllKernel32Symbols[] = {
     {(FARPROC *)&DllKernel32.pSetFileInformationByHandle, "SetFileInformationByHandle"},
     {(FARPROC *)&DllKernel32.pSetInformationJobObject, "SetInformationJobObject"},
     {(FARPROC *)&DllKernel32.pSetSystemPowerState, "SetSystemPowerState"},
+    {(FARPROC *)&DllKernel32.pSetThreadGroupAffinity, "SetThreadGroupAffinity"},
     {(FARPROC *)&DllKernel32.pWritePrivateProfileStringW, "WritePrivateProfileStringW"},
     {(FARPROC *)&DllKernel32.pWow64DisableWow64FsRedirection, "Wow64DisableWow64FsRedirection"},
     {(FARPROC *)&DllKernel32.pWow64GetThreadContext, "Wow64GetThreadContext"},
@@ -510,6 +521,7 @@ YoriLibLoadPsapiFunctions(VOID)
     }
 
     DllPsapi.pGetModuleFileNameExW = (PGET_MODULE_FILE_NAME_EXW)GetProcAddress(DllPsapi.hDll, "GetModuleFileNameExW");
+    DllPsapi.pGetProcessMemoryInfo = (PGET_PROCESS_MEMORY_INFO)GetProcAddress(DllPsapi.hDll, "GetProcessMemoryInfo");
 
     return TRUE;
 }
@@ -58,7 +58,9 @@ CONST YORI_DLL_NAME_MAP DllAdvApi32Symbols[] = {
     {(FARPROC *)&DllAdvApi32.pAddAccessAllowedAce, "AddAccessAllowedAce"},
     {(FARPROC *)&DllAdvApi32.pAdjustTokenPrivileges, "AdjustTokenPrivileges"},
     {(FARPROC *)&DllAdvApi32.pAllocateAndInitializeSid, "AllocateAndInitializeSid"},
+    {(FARPROC *)&DllAdvApi32.pCloseTrace, "CloseTrace"},
     {(FARPROC *)&DllAdvApi32.pCommandLineFromMsiDescriptor, "CommandLineFromMsiDescriptor"},
+    {(FARPROC *)&DllAdvApi32.pControlTraceW, "ControlTraceW"},
     {(FARPROC *)&DllAdvApi32.pCryptAcquireContextW, "CryptAcquireContextW"},
     {(FARPROC *)&DllAdvApi32.pCryptCreateHash, "CryptCreateHash"},
     {(FARPROC *)&DllAdvApi32.pCryptDestroyHash, "CryptDestroyHash"},
@@ -66,6 +68,10 @@ CONST YORI_DLL_NAME_MAP DllAdvApi32Symbols[] = {
     {(FARPROC *)&DllAdvApi32.pCryptHashData, "CryptHashData"},
     {(FARPROC *)&DllAdvApi32.pCryptReleaseContext, "CryptReleaseContext"},
     {(FARPROC *)&DllAdvApi32.pEqualSid, "EqualSid"},
+    {(FARPROC *)&DllAdvApi32.pEventRegister, "EventRegister"},
+    {(FARPROC *)&DllAdvApi32.pEventSetInformation, "EventSetInformation"},
+    {(FARPROC *)&DllAdvApi32.pEventUnregister, "EventUnregister"},
+    {(FARPROC *)&DllAdvApi32.pEventWrite, "EventWrite"},
     {(FARPROC *)&DllAdvApi32.pFreeSid, "FreeSid"},
     {(FARPROC *)&DllAdvApi32.pGetFileSecurityW, "GetFileSecurityW"},
     {(FARPROC *)&DllAdvApi32.pGetLengthSid, "GetLengthSid"},
@@ -80,6 +86,8 @@ CONST YORI_DLL_NAME_MAP DllAdvApi32Symbols[] = {
     {(FARPROC *)&DllAdvApi32.pLookupPrivilegeValueW, "LookupPrivilegeValueW"},
     {(FARPROC *)&DllAdvApi32.pOpenProcessToken, "OpenProcessToken"},
     {(FARPROC *)&DllAdvApi32.pOpenThreadToken, "OpenThreadToken"},
+    {(FARPROC *)&DllAdvApi32.pOpenTraceW, "OpenTraceW"},
+    {(FARPROC *)&DllAdvApi32.pProcessTrace, "ProcessTrace"},
     {(FARPROC *)&DllAdvApi32.pRegCloseKey, "RegCloseKey"},
     {(FARPROC *)&DllAdvApi32.pRegCreateKeyExW, "RegCreateKeyExW"},
     {(FARPROC *)&DllAdvApi32.pRegDeleteKeyW, "RegDeleteKeyW"},
@@ -95,7 +103,8 @@ CONST YORI_DLL_NAME_MAP DllAdvApi32Symbols[] = {
     {(FARPROC *)&DllAdvApi32.pRevertToSelf, "RevertToSelf"},
     {(FARPROC *)&DllAdvApi32.pSetNamedSecurityInfoW, "SetNamedSecurityInfoW"},
     {(FARPROC *)&DllAdvApi32.pSetSecurityDescriptorDacl, "SetSecurityDescriptorDacl"},
-    {(FARPROC *)&DllAdvApi32.pSetSecurityDescriptorOwner, "SetSecurityDescriptorOwner"}
+    {(FARPROC *)&DllAdvApi32.pSetSecurityDescriptorOwner, "SetSecurityDescriptorOwner"},
+    {(FARPROC *)&DllAdvApi32.pStartTraceW, "StartTraceW"}
 };
 
 /**
@@ -56,6 +56,7 @@ VOID __cdecl CONSOLE_CRT_ENTRYPOINT(VOID)
 
     YoriLibLoadNtDllFunctions();
     YoriLibLoadKernel32Functions();
+    YoriLibEtwRegister();
 
     ArgV = YoriLibCmdlineToArgcArgv(GetCommandLine(), YORI_MAX_ALLOC_SIZE, FALSE, &ArgC);
     if (ArgV == NULL) {
@@ -68,6 +69,7 @@ VOID __cdecl CONSOLE_CRT_ENTRYPOINT(VOID)
     YoriLibDereference(ArgV);
 
     YoriLibDisplayMemoryUsage();
+    YoriLibEtwUnregister();
 
     ExitProcess(ExitCode);
 }
@@ -0,0 +1,366 @@
+/**
+ * @file lib/etw.c
+ *
+ * Yori event tracing provider
+ *
+ * Copyright (c) 2026 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "yoripch.h"
+#include "yorilib.h"
+
+/**
+ The GUID of the Yori event provider.  This is derived from the provider
+ name in the same way as other TraceLogging providers, so a session can
+ enable it as "*Yori" without knowing the GUID.
+
+ {8df02625-3572-5883-1792-1206059729db}
+ */
+CONST GUID YoriLibEtwProviderGuid = {0x8df02625, 0x3572, 0x5883, {0x17, 0x92, 0x12, 0x06, 0x05, 0x97, 0x29, 0xdb}};
+
+/**
+ The provider metadata included with every event, consisting of its size,
+ followed by the provider name.
+ */
+CONST UCHAR YoriLibEtwProviderMetadata[] = {7, 0, 'Y', 'o', 'r', 'i', '\0'};
+
+/**
+ The TraceLogging type of a string with a 16 bit byte count followed by
+ UTF-16 characters.
+ */
+#define YORI_LIB_ETW_TYPE_COUNTED_STRING (22)
+
+/**
+ The TraceLogging type of an unsigned 64 bit integer.
+ */
+#define YORI_LIB_ETW_TYPE_UINT64         (10)
+
+/**
+ The maximum size of the metadata describing a single event.
+ */
+#define YORI_LIB_ETW_MAX_METADATA        (256)
+
+/**
+ The handle to the registered provider, or zero if it is not registered.
+ */
+YORI_REGHANDLE YoriLibEtwRegHandle;
+
+/**
+ The keywords of events that any session has enabled.  This is zero if no
+ session is listening, which allows callers to check it cheaply before
+ collecting any information for an event.
+ */
+volatile DWORDLONG YoriLibEtwEnabledKeywords;
+
+/**
+ Called by the system when a session enables or disables the provider.
+
+ @param SourceId The GUID of the session's activity, ignored.
+
+ @param IsEnabled Nonzero if the provider is enabled, zero if it is
+        disabled.
+
+ @param Level The most verbose level of events that sessions want, ignored
+        since all events are informational.
+
+ @param MatchAnyKeyword Events with any of these keywords should be written.
+        If zero, all events should be written.
+
+ @param MatchAllKeyword Ignored.
+
+ @param FilterData Ignored.
+
+ @param CallbackContext Ignored.
+ */
+VOID WINAPI
+YoriLibEtwEnableCallback(
+    __in CONST GUID * SourceId,
+    __in ULONG IsEnabled,
+    __in UCHAR Level,
+    __in DWORDLONG MatchAnyKeyword,
+    __in DWORDLONG MatchAllKeyword,
+    __in_opt PVOID FilterData,
+    __in_opt PVOID CallbackContext
+    )
+{
+    UNREFERENCED_PARAMETER(SourceId);
+    UNREFERENCED_PARAMETER(Level);
+    UNREFERENCED_PARAMETER(MatchAllKeyword);
+    UNREFERENCED_PARAMETER(FilterData);
+    UNREFERENCED_PARAMETER(CallbackContext);
+
+    //
+    //  A value of 2 requests captured state, which this provider doesn't
+    //  have, and doesn't change whether the provider is enabled.
+    //
+
+    if (IsEnabled == 0) {
+        YoriLibEtwEnabledKeywords = 0;
+    } else if (IsEnabled == 1) {
+        if (MatchAnyKeyword == 0) {
+            YoriLibEtwEnabledKeywords = (DWORDLONG)-1;
+        } else {
+            YoriLibEtwEnabledKeywords = MatchAnyKeyword;
+        }
+    }
+}
+
+/**
+ Register the Yori event provider, so that tracing sessions can enable its
+ events.  On systems without event tracing support this does nothing, and
+ events are never enabled.
+ */
+VOID
+YoriLibEtwRegister(VOID)
+{
+    YORI_REGHANDLE RegHandle;
+
+    if (YoriLibEtwRegHandle != 0) {
+        return;
+    }
+
+    YoriLibLoadAdvApi32Functions();
+    if (DllAdvApi32.pEventRegister == NULL ||
+        DllAdvApi32.pEventUnregister == NULL ||
+        DllAdvApi32.pEventWrite == NULL) {
+
+        return;
+    }
+
+    RegHandle = 0;
+    if (DllAdvApi32.pEventRegister(&YoriLibEtwProviderGuid, YoriLibEtwEnableCallback, NULL, &RegHandle) != ERROR_SUCCESS) {
+        return;
+    }
+
+    //
+    //  Before Windows 10, the provider name is only known to decoders if it
+    //  is set as a provider trait.
+    //
+
+    if (DllAdvApi32.pEventSetInformation != NULL) {
+        DllAdvApi32.pEventSetInformation(RegHandle, YORI_EVENT_PROVIDER_SET_TRAITS, (PVOID)YoriLibEtwProviderMetadata, sizeof(YoriLibEtwProviderMetadata));
+    }
+
+    YoriLibEtwRegHandle = RegHandle;
+}
+
+/**
+ Unregister the Yori event provider.
+ */
+VOID
+YoriLibEtwUnregister(VOID)
+{
+    if (YoriLibEtwRegHandle != 0) {
+        YoriLibEtwEnabledKeywords = 0;
+        DllAdvApi32.pEventUnregister(YoriLibEtwRegHandle);
+        YoriLibEtwRegHandle = 0;
+    }
+}
+
+/**
+ Append a field to the metadata describing an event.
+
+ @param Metadata Pointer to the metadata buffer.
+
+ @param Offset Pointer to the current length of the metadata, updated on
+        completion.
+
+ @param Name The name of the field.
+
+ @param Type The TraceLogging type of the field.
+
+ @return TRUE if the field was added, FALSE if the metadata buffer is full.
+ */
+BOOLEAN
+YoriLibEtwAddMetadataField(
+    __inout_ecount(YORI_LIB_ETW_MAX_METADATA) PUCHAR Metadata,
+    __inout PDWORD Offset,
+    __in LPCSTR Name,
+    __in UCHAR Type
+    )
+{
+    DWORD Length;
+
+    Length = (DWORD)strlen(Name) + 1;
+    if (*Offset + Length + 1 > YORI_LIB_ETW_MAX_METADATA) {
+        return FALSE;
+    }
+
+    memcpy(&Metadata[*Offset], Name, Length);
+    Metadata[*Offset + Length] = Type;
+    *Offset = *Offset + Length + 1;
+    return TRUE;
+}
+
+/**
+ Write an event from the Yori event provider.  The event is self describing,
+ so it can be decoded without a manifest.  Each event contains an optional
+ string and up to two numbers.  Callers are expected to check
+ @ref YoriLibEtwIsEnabled before collecting information for the event, so
+ that there is no cost when no session is listening.
+
+ @param Keyword The keyword of the event, one of the YORI_LIB_ETW_KEYWORD
+        values.
+
+ @param EventName The name of the event.
+
+ @param StringName Optionally points to the name of a string field.
+
+ @param String Optionally points to the value of the string field.  This
+        is only meaningful if StringName is specified.
+
+ @param Value1Name Optionally points to the name of a numeric field.
+
+ @param Value1 The value of the first numeric field.  This is only
+        meaningful if Value1Name is specified.
+
+ @param Value2Name Optionally points to the name of a second numeric field.
+
+ @param Value2 The value of the second numeric field.  This is only
+        meaningful if Value2Name is specified.
+ */
+VOID
+YoriLibEtwWriteEvent(
+    __in DWORDLONG Keyword,
+    __in LPCSTR EventName,
+    __in_opt LPCSTR StringName,
+    __in_opt PCYORI_STRING String,
+    __in_opt LPCSTR Value1Name,
+    __in DWORDLONG Value1,
+    __in_opt LPCSTR Value2Name,
+    __in DWORDLONG Value2
+    )
+{
+    UCHAR Metadata[YORI_LIB_ETW_MAX_METADATA];
+    YORI_EVENT_DATA_DESCRIPTOR Data[7];
+    YORI_EVENT_DESCRIPTOR Descriptor;
+    DWORD MetadataLength;
+    DWORD DataCount;
+    USHORT StringBytes;
+
+    if (YoriLibEtwRegHandle == 0 ||
+        (YoriLibEtwEnabledKeywords & Keyword) == 0) {
+
+        return;
+    }
+
+    //
+    //  The metadata starts with its size, which is filled in at the end,
+    //  followed by tags which are not used, followed by the event name,
+    //  followed by the name and type of each field.
+    //
+
+    ZeroMemory(Data, sizeof(Data));
+    MetadataLength = 3;
+    Metadata[2] = 0;
+    if (!YoriLibEtwAddMetadataField(Metadata, &MetadataLength, EventName, 0)) {
+        return;
+    }
+
+    //
+    //  The event name is not followed by a type, so back up over it.
+    //
+
+    MetadataLength--;
+
+    DataCount = 2;
+    StringBytes = 0;
+    if (StringName != NULL) {
+        if (!YoriLibEtwAddMetadataField(Metadata, &MetadataLength, StringName, YORI_LIB_ETW_TYPE_COUNTED_STRING)) {
+            return;
+        }
+        if (String != NULL) {
+            if (String->LengthInChars > 0x7FFF) {
+                StringBytes = 0x7FFF * sizeof(TCHAR);
+            } else {
+                StringBytes = (USHORT)(String->LengthInChars * sizeof(TCHAR));
+            }
+        }
+        Data[DataCount].Ptr = (DWORDLONG)(DWORD_PTR)&StringBytes;
+        Data[DataCount].Size = sizeof(StringBytes);
+        DataCount++;
+        if (StringBytes > 0) {
+            Data[DataCount].Ptr = (DWORDLONG)(DWORD_PTR)String->StartOfString;
+            Data[DataCount].Size = StringBytes;
+            DataCount++;
+        }
+    }
+
+    if (Value1Name != NULL) {
+        if (!YoriLibEtwAddMetadataField(Metadata, &MetadataLength, Value1Name, YORI_LIB_ETW_TYPE_UINT64)) {
+            return;
+        }
+        Data[DataCount].Ptr = (DWORDLONG)(DWORD_PTR)&Value1;
+        Data[DataCount].Size = sizeof(Value1);
+        DataCount++;
+    }
+
+    if (Value2Name != NULL) {
+        if (!YoriLibEtwAddMetadataField(Metadata, &MetadataLength, Value2Name, YORI_LIB_ETW_TYPE_UINT64)) {
+            return;
+        }
+        Data[DataCount].Ptr = (DWORDLONG)(DWORD_PTR)&Value2;
+        Data[DataCount].Size = sizeof(Value2);
+        DataCount++;
+    }
+
+    Metadata[0] = (UCHAR)(MetadataLength & 0xFF);
+    Metadata[1] = (UCHAR)(MetadataLength >> 8);
+
+    Data[0].Ptr = (DWORDLONG)(DWORD_PTR)YoriLibEtwProviderMetadata;
+    Data[0].Size = sizeof(YoriLibEtwProviderMetadata);
+    Data[0].Type = YORI_EVENT_DATA_DESCRIPTOR_TYPE_PROVIDER_METADATA;
+    Data[1].Ptr = (DWORDLONG)(DWORD_PTR)Metadata;
+    Data[1].Size = MetadataLength;
+    Data[1].Type = YORI_EVENT_DATA_DESCRIPTOR_TYPE_EVENT_METADATA;
+
+    ZeroMemory(&Descriptor, sizeof(Descriptor));
+    Descriptor.Channel = YORI_WINEVENT_CHANNEL_TRACELOGGING;
+    Descriptor.Level = YORI_WINEVENT_LEVEL_INFO;
+    Descriptor.Keyword = Keyword;
+
+    DllAdvApi32.pEventWrite(YoriLibEtwRegHandle, &Descriptor, DataCount, Data);
+}
+
+/**
+ Return a timestamp for measuring the duration of an operation that is
+ reported in an event.
+
+ @return A timestamp in microseconds.
+ */
+DWORDLONG
+YoriLibEtwGetTimestamp(VOID)
+{
+    LARGE_INTEGER Counter;
+    LARGE_INTEGER Frequency;
+
+    if (!QueryPerformanceFrequency(&Frequency) ||
+        Frequency.QuadPart == 0 ||
+        !QueryPerformanceCounter(&Counter)) {
+
+        return (DWORDLONG)GetTickCount() * 1000;
+    }
+
+    return (DWORDLONG)(Counter.QuadPart / Frequency.QuadPart * 1000000 +
+                       Counter.QuadPart % Frequency.QuadPart * 1000000 / Frequency.QuadPart);
+}
+
+// vim:sw=4:ts=4:et:
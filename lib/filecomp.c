@@ -28,6 +28,12 @@
 #include <yoripch.h>
 #include <yorilib.h>
 
+/**
+ Files smaller than this size are not compressed, since they cannot reclaim
+ enough allocation units to justify the overhead.
+ */
+#define YORILIB_COMPRESS_MIN_FILE_SIZE (10 * 1024)
+
 /**
  A single item to compress or decompress.
  */
@@ -49,6 +55,18 @@ typedef struct _YORILIB_PENDING_ACTION {
      */
     BOOL Compress;
 
+    /**
+     The size of the file when it was queued.  The queue is ordered by this
+     value so that the largest files are started first and do not end up
+     running alone at the end of the operation.
+     */
+    LARGE_INTEGER FileSize;
+
+    /**
+     The attributes of the file when it was queued.
+     */
+    DWORD FileAttributes;
+
 } YORILIB_PENDING_ACTION, *PYORILIB_PENDING_ACTION;
 
 /**
@@ -105,11 +123,28 @@ YoriLibInitializeCompressContext(
         return FALSE;
     }
 
+    //
+    //  The queue holds two items per thread.  When it is full, the caller
+    //  waits for a compression thread to pick up an item rather than
+    //  continuing to enumerate files.
+    //
+
+    CompressContext->SlotsAvailableSemaphore = CreateSemaphore(NULL, CompressContext->MaxThreads * 2, CompressContext->MaxThreads * 2, NULL);
+    if (CompressContext->SlotsAvailableSemaphore == NULL) {
+        return FALSE;
+    }
+
     CompressContext->Threads = YoriLibMalloc(sizeof(HANDLE) * CompressContext->MaxThreads);
     if (CompressContext->Threads == NULL) {
         return FALSE;
     }
 
+    CompressContext->WorkerStats = YoriLibMalloc(sizeof(YORILIB_COMPRESS_WORKER_STATS) * CompressContext->MaxThreads);
+    if (CompressContext->WorkerStats == NULL) {
+        return FALSE;
+    }
+    ZeroMemory(CompressContext->WorkerStats, sizeof(YORILIB_COMPRESS_WORKER_STATS) * CompressContext->MaxThreads);
+
     return TRUE;
 }
 
@@ -128,11 +163,34 @@ YoriLibFreeCompressContext(
 {
     if (CompressContext->ThreadsAllocated > 0) {
         DWORD Index;
+        PYORILIB_COMPRESS_WORKER_STATS Stats;
+        YORI_STRING SizeString;
+        TCHAR SizeStringBuffer[10];
+        LARGE_INTEGER Size;
+        LONGLONG BusyMs;
+
         SetEvent(CompressContext->WorkerShutdownEvent);
         WaitForMultipleObjectsEx(CompressContext->ThreadsAllocated, CompressContext->Threads, TRUE, INFINITE, FALSE);
         for (Index = 0; Index < CompressContext->ThreadsAllocated; Index++) {
             CloseHandle(CompressContext->Threads[Index]);
             CompressContext->Threads[Index] = NULL;
+
+            if (CompressContext->Verbose) {
+                Stats = &CompressContext->WorkerStats[Index];
+                YoriLibInitEmptyString(&SizeString);
+                SizeString.StartOfString = SizeStringBuffer;
+                SizeString.LengthAllocated = sizeof(SizeStringBuffer)/sizeof(SizeStringBuffer[0]);
+                Size.QuadPart = Stats->BytesProcessed;
+                YoriLibFileSizeToString(&SizeString, &Size);
+                BusyMs = Stats->BusyTime / 10000;
+                YoriLibOutput(YORI_LIB_OUTPUT_STDOUT,
+                              _T("Compression thread %i: %lli files, %y, busy %lli.%03i seconds\n"),
+                              Index + 1,
+                              Stats->FilesProcessed,
+                              &SizeString,
+                              BusyMs / 1000,
+                              (int)(BusyMs % 1000));
+            }
         }
         ASSERT(YoriLibIsListEmpty(&CompressContext->PendingList));
     }
@@ -148,10 +206,18 @@ YoriLibFreeCompressContext(
         CloseHandle(CompressContext->Mutex);
         CompressContext->Mutex = NULL;
     }
+    if (CompressContext->SlotsAvailableSemaphore != NULL) {
+        CloseHandle(CompressContext->SlotsAvailableSemaphore);
+        CompressContext->SlotsAvailableSemaphore = NULL;
+    }
     if (CompressContext->Threads != NULL) {
         YoriLibFree(CompressContext->Threads);
         CompressContext->Threads = NULL;
     }
+    if (CompressContext->WorkerStats != NULL) {
+        YoriLibFree(CompressContext->WorkerStats);
+        CompressContext->WorkerStats = NULL;
+    }
 }
 
 /**
@@ -215,7 +281,7 @@ YoriLibCompressSingleFile(
     }
 
     if (FileInfo.nFileSizeHigh == 0 &&
-        FileInfo.nFileSizeLow < 10 * 1024) {
+        FileInfo.nFileSizeLow < YORILIB_COMPRESS_MIN_FILE_SIZE) {
 
         goto Exit;
     }
@@ -413,7 +479,8 @@ YoriLibDecompressSingleFile(
  A background thread which will attempt to compress any items that it finds on
  a list of files requiring compression.
 
- @param Context Pointer to the compress context.
+ @param Context Pointer to the statistics structure for this thread, which
+        refers to the compress context.
 
  @return TRUE to indicate success, FALSE to indicate one or more compression
          operations failed.
@@ -423,11 +490,33 @@ YoriLibCompressWorker(
     __in LPVOID Context
     )
 {
-    PYORILIB_COMPRESS_CONTEXT CompressContext = (PYORILIB_COMPRESS_CONTEXT)Context;
+    PYORILIB_COMPRESS_WORKER_STATS Stats = (PYORILIB_COMPRESS_WORKER_STATS)Context;
+    PYORILIB_COMPRESS_CONTEXT CompressContext = Stats->CompressContext;
     DWORD FoundEvent;
     PYORILIB_PENDING_ACTION PendingAction;
+    LONGLONG StartTime;
     BOOL Result = TRUE;
 
+    //
+    //  If requested, lower the priority of this thread.  On Vista and
+    //  above this includes I/O priority; on older systems, only CPU
+    //  priority can be changed.
+    //
+
+    if (CompressContext->BackgroundPriority) {
+        DWORD MajorVersion;
+        DWORD MinorVersion;
+        DWORD BuildNumber;
+
+        YoriLibGetOsVersion(&MajorVersion, &MinorVersion, &BuildNumber);
+
+        if (MajorVersion >= 6) {
+            SetThreadPriority(GetCurrentThread(), THREAD_MODE_BACKGROUND_BEGIN);
+        } else {
+            SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_LOWEST);
+        }
+    }
+
     while (TRUE) {
 
         //
@@ -448,6 +537,11 @@ YoriLibCompressWorker(
                 CompressContext->ItemsQueued--;
                 YoriLibRemoveListItem(&PendingAction->CompressList);
                 ReleaseMutex(CompressContext->Mutex);
+                ReleaseSemaphore(CompressContext->SlotsAvailableSemaphore, 1, NULL);
+
+                Stats->FilesProcessed++;
+                Stats->BytesProcessed += PendingAction->FileSize.QuadPart;
+                StartTime = YoriLibGetSystemTimeAsInteger();
 
                 if (PendingAction->Compress) {
                     if (!YoriLibCompressSingleFile(PendingAction, CompressContext->CompressionAlgorithm)) {
@@ -459,6 +553,8 @@ YoriLibCompressWorker(
                     }
                 }
 
+                Stats->BusyTime += YoriLibGetSystemTimeAsInteger() - StartTime;
+
             } else {
                 ASSERT(CompressContext->ItemsQueued == 0);
                 ReleaseMutex(CompressContext->Mutex);
@@ -480,9 +576,13 @@ YoriLibCompressWorker(
 
 /**
  Add a pending action to the queue of items to be performed by background
- threads.  If the background threads already have an excessively large
- queue of work, this function returns FALSE to indicate it should be
- completed by the foreground thread.
+ threads.  Items are ordered by file size, so the largest files queued are
+ processed first.  If the queue is full, this function waits for a
+ background thread to remove an item before inserting this one, which
+ prevents the caller from enumerating files faster than they can be
+ processed.  If no background threads could be created, this function
+ returns FALSE to indicate the action should be completed by the foreground
+ thread.
 
  @param CompressContext Pointer to the compress context describing the state
         of background threads.
@@ -498,15 +598,20 @@ YoriLibAddToBackgroundCompressQueue(
     __in PYORILIB_PENDING_ACTION PendingAction
     )
 {
-    BOOL Result = FALSE;
+    PYORI_LIST_ENTRY ListEntry;
+    PYORILIB_PENDING_ACTION Existing;
+    PYORILIB_COMPRESS_WORKER_STATS Stats;
     DWORD ThreadId;
+    BOOL ThreadsAvailable;
 
     WaitForSingleObject(CompressContext->Mutex, INFINITE);
     if (CompressContext->ThreadsAllocated == 0 ||
         (CompressContext->ItemsQueued > CompressContext->ThreadsAllocated * 2 &&
          CompressContext->ThreadsAllocated < CompressContext->MaxThreads)) {
 
-        CompressContext->Threads[CompressContext->ThreadsAllocated] = CreateThread(NULL, 0, YoriLibCompressWorker, CompressContext, 0, &ThreadId);
+        Stats = &CompressContext->WorkerStats[CompressContext->ThreadsAllocated];
+        Stats->CompressContext = CompressContext;
+        CompressContext->Threads[CompressContext->ThreadsAllocated] = CreateThread(NULL, 0, YoriLibCompressWorker, Stats, 0, &ThreadId);
         if (CompressContext->Threads[CompressContext->ThreadsAllocated] != NULL) {
             CompressContext->ThreadsAllocated++;
             if (CompressContext->Verbose) {
@@ -515,18 +620,98 @@ YoriLibAddToBackgroundCompressQueue(
         }
     }
 
-    if (CompressContext->ThreadsAllocated > 0 &&
-        CompressContext->ItemsQueued < CompressContext->MaxThreads * 2) {
+    ThreadsAvailable = (CompressContext->ThreadsAllocated > 0);
+    ReleaseMutex(CompressContext->Mutex);
+
+    if (!ThreadsAvailable) {
+        return FALSE;
+    }
+
+    //
+    //  Wait for space in the queue.  Threads are never terminated until the
+    //  context is freed, so once a thread exists, space will eventually
+    //  become available.
+    //
+
+    WaitForSingleObject(CompressContext->SlotsAvailableSemaphore, INFINITE);
+
+    WaitForSingleObject(CompressContext->Mutex, INFINITE);
+
+    //
+    //  Insert the item in front of the first item which is smaller than it.
+    //
+
+    ListEntry = YoriLibGetNextListEntry(&CompressContext->PendingList, NULL);
+    while (ListEntry != NULL) {
+        Existing = CONTAINING_RECORD(ListEntry, YORILIB_PENDING_ACTION, CompressList);
+        if (Existing->FileSize.QuadPart < PendingAction->FileSize.QuadPart) {
+            break;
+        }
+        ListEntry = YoriLibGetNextListEntry(&CompressContext->PendingList, ListEntry);
+    }
 
+    if (ListEntry != NULL) {
+        YoriLibAppendList(ListEntry, &PendingAction->CompressList);
+    } else {
         YoriLibAppendList(&CompressContext->PendingList, &PendingAction->CompressList);
-        CompressContext->ItemsQueued++;
-        Result = TRUE;
     }
+    CompressContext->ItemsQueued++;
 
     ReleaseMutex(CompressContext->Mutex);
 
     SetEvent(CompressContext->WorkerWaitEvent);
-    return Result;
+    return TRUE;
+}
+
+/**
+ Allocate a pending action describing a file to compress or decompress, and
+ capture the size of the file so that work can be ordered by size.
+
+ @param FileName Pointer to the file name to compress or decompress.
+
+ @param Compress TRUE if the file should be compressed, FALSE if it should be
+        decompressed.
+
+ @return Pointer to the pending action, or NULL on allocation failure.
+ */
+PYORILIB_PENDING_ACTION
+YoriLibAllocatePendingAction(
+    __in PYORI_STRING FileName,
+    __in BOOL Compress
+    )
+{
+    PYORILIB_PENDING_ACTION PendingAction;
+    WIN32_FIND_DATA FindData;
+    HANDLE FindHandle;
+
+    PendingAction = YoriLibMalloc(sizeof(YORILIB_PENDING_ACTION) + (FileName->LengthInChars + 1) * sizeof(TCHAR));
+    if (PendingAction == NULL) {
+        return NULL;
+    }
+    PendingAction->Compress = Compress;
+    YoriLibInitEmptyString(&PendingAction->FileName);
+    PendingAction->FileName.StartOfString = (LPTSTR)(PendingAction + 1);
+    PendingAction->FileName.LengthInChars = FileName->LengthInChars;
+    PendingAction->FileName.LengthAllocated = FileName->LengthInChars + 1;
+    memcpy(PendingAction->FileName.StartOfString, FileName->StartOfString, (FileName->LengthInChars + 1) * sizeof(TCHAR));
+
+    //
+    //  The directory entry is normally cached, since the caller has just
+    //  enumerated or written it.  If it can't be found, treat the file as
+    //  empty, which places it at the end of the queue.
+    //
+
+    PendingAction->FileSize.QuadPart = 0;
+    PendingAction->FileAttributes = 0;
+    FindHandle = FindFirstFile(PendingAction->FileName.StartOfString, &FindData);
+    if (FindHandle != INVALID_HANDLE_VALUE) {
+        PendingAction->FileSize.HighPart = FindData.nFileSizeHigh;
+        PendingAction->FileSize.LowPart = FindData.nFileSizeLow;
+        PendingAction->FileAttributes = FindData.dwFileAttributes;
+        FindClose(FindHandle);
+    }
+
+    return PendingAction;
 }
 
 /**
@@ -552,33 +737,38 @@ YoriLibCompressFileInBackground(
 
     ASSERT(YoriLibIsStringNullTerminated(FileName));
 
-    PendingAction = YoriLibMalloc(sizeof(YORILIB_PENDING_ACTION) + (FileName->LengthInChars + 1) * sizeof(TCHAR));
+    PendingAction = YoriLibAllocatePendingAction(FileName, TRUE);
     if (PendingAction == NULL) {
         goto Exit;
     }
-    PendingAction->Compress = TRUE;
-    YoriLibInitEmptyString(&PendingAction->FileName);
-    PendingAction->FileName.StartOfString = (LPTSTR)(PendingAction + 1);
-    PendingAction->FileName.LengthInChars = FileName->LengthInChars;
-    PendingAction->FileName.LengthAllocated = FileName->LengthInChars + 1;
-    memcpy(PendingAction->FileName.StartOfString, FileName->StartOfString, (FileName->LengthInChars + 1) * sizeof(TCHAR));
+
+    Result = TRUE;
+
+    //
+    //  Small files are skipped by the compression routine, so don't occupy
+    //  a slot in the queue with them.
+    //
+
+    if ((PendingAction->FileAttributes & FILE_ATTRIBUTE_DIRECTORY) == 0 &&
+        PendingAction->FileSize.QuadPart > 0 &&
+        PendingAction->FileSize.QuadPart < YORILIB_COMPRESS_MIN_FILE_SIZE) {
+
+        YoriLibFree(PendingAction);
+        goto Exit;
+    }
 
     if (YoriLibAddToBackgroundCompressQueue(CompressContext, PendingAction)) {
         PendingAction = NULL;
     }
 
-    Result = TRUE;
-
     //
-    //  If the threads in the pool are all busy (we have too many items
-    //  waiting) do the compression on the main thread.  This is mainly done to
-    //  prevent the main thread from continuing to pile in more items that the
-    //  pool can't get to.
+    //  If no background threads could be created, do the compression on the
+    //  main thread.
     //
 
     if (PendingAction != NULL) {
         if (CompressContext->Verbose) {
-            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("Compressing %y on main thread for back pressure\n"), FileName);
+            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("Compressing %y on main thread\n"), FileName);
         }
         if (!YoriLibCompressSingleFile(PendingAction, CompressContext->CompressionAlgorithm)) {
             Result = FALSE;
@@ -611,16 +801,10 @@ YoriLibDecompressFileInBackground(
 
     ASSERT(YoriLibIsStringNullTerminated(FileName));
 
-    PendingAction = YoriLibMalloc(sizeof(YORILIB_PENDING_ACTION) + (FileName->LengthInChars + 1) * sizeof(TCHAR));
+    PendingAction = YoriLibAllocatePendingAction(FileName, FALSE);
     if (PendingAction == NULL) {
         goto Exit;
     }
-    PendingAction->Compress = FALSE;
-    YoriLibInitEmptyString(&PendingAction->FileName);
-    PendingAction->FileName.StartOfString = (LPTSTR)(PendingAction + 1);
-    PendingAction->FileName.LengthInChars = FileName->LengthInChars;
-    PendingAction->FileName.LengthAllocated = FileName->LengthInChars + 1;
-    memcpy(PendingAction->FileName.StartOfString, FileName->StartOfString, (FileName->LengthInChars + 1) * sizeof(TCHAR));
 
     if (YoriLibAddToBackgroundCompressQueue(CompressContext, PendingAction)) {
         PendingAction = NULL;
@@ -629,15 +813,13 @@ YoriLibDecompressFileInBackground(
     Result = TRUE;
 
     //
-    //  If the threads in the pool are all busy (we have too many items
-    //  waiting) do the decompression on the main thread.  This is mainly done
-    //  to prevent the main thread from continuing to pile in more items that
-    //  the pool can't get to.
+    //  If no background threads could be created, do the decompression on
+    //  the main thread.
     //
 
     if (PendingAction != NULL) {
         if (CompressContext->Verbose) {
-            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("Decompressing %y on main thread for back pressure\n"), FileName);
+            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("Decompressing %y on main thread\n"), FileName);
         }
         if (!YoriLibDecompressSingleFile(PendingAction)) {
             Result = FALSE;
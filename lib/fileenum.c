@@ -85,12 +85,631 @@ typedef struct _YORILIB_FOREACHFILE_CONTEXT {
 
     /**
      The result of the Win32 FindFirstFile operation for the current
-     file.
+     file.  If a bulk query is in use, this also contains information
+     that FindFirstFile does not return.
      */
-    WIN32_FIND_DATA FileInfo;
+    YORILIB_FIND_DATA_EXTENDED FileInfo;
+
+    /**
+     If a bulk query is in use, a buffer containing the results most
+     recently returned by the file system.  This is allocated on first use
+     and is NULL otherwise.
+     */
+    PUCHAR BulkBuffer;
+
+    /**
+     The offset within BulkBuffer of the entry that is currently described
+     by FileInfo.
+     */
+    DWORD BulkBufferOffset;
+
+    /**
+     The information class being used for the bulk query.
+     */
+    DWORD BulkInfoClass;
+
+    /**
+     TRUE if the current find handle refers to a directory being queried
+     in bulk, FALSE if it is a FindFirstFile handle.
+     */
+    BOOLEAN BulkQueryActive;
 
 } YORILIB_FOREACHFILE_CONTEXT, *PYORILIB_FOREACHFILE_CONTEXT;
 
+/**
+ The size of the buffer to use when querying directory entries in bulk.
+ */
+#define YORILIB_FOREACHFILE_BULK_BUFFER_SIZE (64 * 1024)
+
+/**
+ The maximum number of threads to use for a parallel enumerate.
+ */
+#define YORILIB_FOREACHFILE_MAX_THREADS (32)
+
+/**
+ State shared between all threads that are performing a single parallel
+ enumerate.
+ */
+typedef struct _YORILIB_FOREACHFILE_PARALLEL_CONTEXT {
+
+    /**
+     The list of directories that have been found but not yet enumerated.
+     */
+    YORI_LIST_ENTRY PendingList;
+
+    /**
+     A mutex to synchronize the list of pending directories and the count
+     of outstanding directories.
+     */
+    HANDLE Mutex;
+
+    /**
+     A mutex held while invoking caller callbacks, unless the caller has
+     indicated that callbacks can be invoked concurrently.
+     */
+    HANDLE CallbackMutex;
+
+    /**
+     A semaphore which is released once for each directory inserted into
+     the pending list.
+     */
+    HANDLE WorkerWaitSemaphore;
+
+    /**
+     An event signalled once there are no directories pending or being
+     enumerated.
+     */
+    HANDLE CompleteEvent;
+
+    /**
+     An array of handles to threads enumerating directories.
+     */
+    HANDLE Threads[YORILIB_FOREACHFILE_MAX_THREADS];
+
+    /**
+     The number of threads in the Threads array.
+     */
+    DWORD ThreadCount;
+
+    /**
+     The number of directories which are either in the pending list or are
+     currently being enumerated.
+     */
+    DWORD Outstanding;
+
+    /**
+     The flags that were specified for the enumerate.
+     */
+    WORD MatchFlags;
+
+    /**
+     Set to TRUE if a callback has requested that the enumerate terminate,
+     or if any error prevents the enumerate from completing.
+     */
+    BOOLEAN Abort;
+
+    /**
+     The callback to invoke on each match.
+     */
+    PYORILIB_FILE_ENUM_FN Callback;
+
+    /**
+     Optionally points to a function to invoke if a directory cannot be
+     enumerated.
+     */
+    PYORILIB_FILE_ENUM_ERROR_FN ErrorCallback;
+
+    /**
+     Caller provided context to pass to the callback.
+     */
+    PVOID Context;
+
+} YORILIB_FOREACHFILE_PARALLEL_CONTEXT, *PYORILIB_FOREACHFILE_PARALLEL_CONTEXT;
+
+/**
+ A single directory that has been found during a parallel enumerate and is
+ waiting to be enumerated by a worker thread.
+ */
+typedef struct _YORILIB_FOREACHFILE_PENDING_DIR {
+
+    /**
+     The link within the list of pending directories.
+     */
+    YORI_LIST_ENTRY ListEntry;
+
+    /**
+     The enumeration criteria to apply to the directory.
+     */
+    YORI_STRING Criteria;
+
+    /**
+     The recursion depth of the directory.
+     */
+    DWORD Depth;
+
+} YORILIB_FOREACHFILE_PENDING_DIR, *PYORILIB_FOREACHFILE_PENDING_DIR;
+
+/**
+ Add a directory to the list of directories for worker threads to enumerate.
+
+ @param ParallelContext Pointer to the state of the parallel enumerate.
+
+ @param Criteria Pointer to the enumeration criteria for the directory.  On
+        success, ownership of this allocation is transferred to the pending
+        directory and the string is reinitialized.
+
+ @param Depth The recursion depth of the directory.
+
+ @return TRUE to indicate the directory was queued, FALSE if it was not.
+ */
+__success(return)
+BOOL
+YoriLibForEachFileQueueDirectory(
+    __in PYORILIB_FOREACHFILE_PARALLEL_CONTEXT ParallelContext,
+    __inout PYORI_STRING Criteria,
+    __in DWORD Depth
+    )
+{
+    PYORILIB_FOREACHFILE_PENDING_DIR PendingDir;
+
+    PendingDir = YoriLibMalloc(sizeof(YORILIB_FOREACHFILE_PENDING_DIR));
+    if (PendingDir == NULL) {
+        return FALSE;
+    }
+
+    memcpy(&PendingDir->Criteria, Criteria, sizeof(YORI_STRING));
+    YoriLibInitEmptyString(Criteria);
+    PendingDir->Depth = Depth;
+
+    WaitForSingleObject(ParallelContext->Mutex, INFINITE);
+    YoriLibAppendList(&ParallelContext->PendingList, &PendingDir->ListEntry);
+    ParallelContext->Outstanding++;
+    ReleaseMutex(ParallelContext->Mutex);
+
+    ReleaseSemaphore(ParallelContext->WorkerWaitSemaphore, 1, NULL);
+    return TRUE;
+}
+
+/**
+ Indicate that enumeration of a single directory has completed.  If there
+ are no more directories pending or being enumerated, the parallel enumerate
+ is complete.
+
+ @param ParallelContext Pointer to the state of the parallel enumerate.
+ */
+VOID
+YoriLibForEachFileCompleteDirectory(
+    __in PYORILIB_FOREACHFILE_PARALLEL_CONTEXT ParallelContext
+    )
+{
+    WaitForSingleObject(ParallelContext->Mutex, INFINITE);
+    ASSERT(ParallelContext->Outstanding > 0);
+    ParallelContext->Outstanding--;
+    if (ParallelContext->Outstanding == 0) {
+        SetEvent(ParallelContext->CompleteEvent);
+    }
+    ReleaseMutex(ParallelContext->Mutex);
+}
+
+/**
+ Populate the current find data from an entry returned from a bulk directory
+ query.
+
+ @param ForEachContext Pointer to the enumeration context.  The entry at
+        BulkBufferOffset within BulkBuffer is used to populate FileInfo.
+ */
+VOID
+YoriLibForEachFileCaptureBulkEntry(
+    __inout PYORILIB_FOREACHFILE_CONTEXT ForEachContext
+    )
+{
+    PWIN32_FIND_DATA FindData;
+    PYORI_FILE_ID_BOTH_DIR_INFORMATION IdBothInfo;
+    PYORI_FILE_ID_EXTD_BOTH_DIR_INFORMATION IdExtdBothInfo;
+    PLARGE_INTEGER CreationTime;
+    PLARGE_INTEGER LastAccessTime;
+    PLARGE_INTEGER LastWriteTime;
+    PLARGE_INTEGER EndOfFile;
+    LPWSTR FileName;
+    LPWSTR ShortName;
+    DWORD FileNameLength;
+    DWORD ShortNameLength;
+    DWORD ReparseTag;
+
+    FindData = &ForEachContext->FileInfo.FindData;
+
+    if (ForEachContext->BulkInfoClass == FileIdExtdBothDirectoryInformation) {
+        IdExtdBothInfo = (PYORI_FILE_ID_EXTD_BOTH_DIR_INFORMATION)(ForEachContext->BulkBuffer + ForEachContext->BulkBufferOffset);
+        CreationTime = &IdExtdBothInfo->CreationTime;
+        LastAccessTime = &IdExtdBothInfo->LastAccessTime;
+        LastWriteTime = &IdExtdBothInfo->LastWriteTime;
+        EndOfFile = &IdExtdBothInfo->EndOfFile;
+        FindData->dwFileAttributes = IdExtdBothInfo->FileAttributes;
+        FileName = IdExtdBothInfo->FileName;
+        FileNameLength = IdExtdBothInfo->FileNameLength / sizeof(WCHAR);
+        ShortName = IdExtdBothInfo->ShortName;
+        ShortNameLength = (UCHAR)IdExtdBothInfo->ShortNameLength / sizeof(WCHAR);
+        ReparseTag = IdExtdBothInfo->ReparsePointTag;
+        ForEachContext->FileInfo.AllocationSize.QuadPart = IdExtdBothInfo->AllocationSize.QuadPart;
+
+        //
+        //  The rest of Yori uses 64 bit file IDs, which is the low 64 bits
+        //  of the 128 bit file ID.
+        //
+
+        memcpy(&ForEachContext->FileInfo.FileId, IdExtdBothInfo->FileId, sizeof(LARGE_INTEGER));
+    } else {
+        IdBothInfo = (PYORI_FILE_ID_BOTH_DIR_INFORMATION)(ForEachContext->BulkBuffer + ForEachContext->BulkBufferOffset);
+        CreationTime = &IdBothInfo->CreationTime;
+        LastAccessTime = &IdBothInfo->LastAccessTime;
+        LastWriteTime = &IdBothInfo->LastWriteTime;
+        EndOfFile = &IdBothInfo->EndOfFile;
+        FindData->dwFileAttributes = IdBothInfo->FileAttributes;
+        FileName = IdBothInfo->FileName;
+        FileNameLength = IdBothInfo->FileNameLength / sizeof(WCHAR);
+        ShortName = IdBothInfo->ShortName;
+        ShortNameLength = (UCHAR)IdBothInfo->ShortNameLength / sizeof(WCHAR);
+        ReparseTag = IdBothInfo->EaSize;
+        ForEachContext->FileInfo.AllocationSize.QuadPart = IdBothInfo->AllocationSize.QuadPart;
+        ForEachContext->FileInfo.FileId.QuadPart = IdBothInfo->FileId.QuadPart;
+    }
+
+    FindData->ftCreationTime.dwLowDateTime = CreationTime->LowPart;
+    FindData->ftCreationTime.dwHighDateTime = CreationTime->HighPart;
+    FindData->ftLastAccessTime.dwLowDateTime = LastAccessTime->LowPart;
+    FindData->ftLastAccessTime.dwHighDateTime = LastAccessTime->HighPart;
+    FindData->ftLastWriteTime.dwLowDateTime = LastWriteTime->LowPart;
+    FindData->ftLastWriteTime.dwHighDateTime = LastWriteTime->HighPart;
+    FindData->nFileSizeLow = EndOfFile->LowPart;
+    FindData->nFileSizeHigh = EndOfFile->HighPart;
+
+    //
+    //  FindFirstFile returns the reparse tag in dwReserved0 for reparse
+    //  points only.
+    //
+
+    FindData->dwReserved0 = 0;
+    FindData->dwReserved1 = 0;
+    if (FindData->dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) {
+        FindData->dwReserved0 = ReparseTag;
+    }
+
+    if (FileNameLength >= sizeof(FindData->cFileName)/sizeof(FindData->cFileName[0])) {
+        FileNameLength = sizeof(FindData->cFileName)/sizeof(FindData->cFileName[0]) - 1;
+    }
+    memcpy(FindData->cFileName, FileName, FileNameLength * sizeof(WCHAR));
+    FindData->cFileName[FileNameLength] = '\0';
+
+    if (ShortNameLength >= sizeof(FindData->cAlternateFileName)/sizeof(FindData->cAlternateFileName[0])) {
+        ShortNameLength = sizeof(FindData->cAlternateFileName)/sizeof(FindData->cAlternateFileName[0]) - 1;
+    }
+    memcpy(FindData->cAlternateFileName, ShortName, ShortNameLength * sizeof(WCHAR));
+    FindData->cAlternateFileName[ShortNameLength] = '\0';
+
+    ForEachContext->FileInfo.ValidFields = YORILIB_FIND_DATA_VALID_FILE_ID | YORILIB_FIND_DATA_VALID_ALLOCATION_SIZE;
+}
+
+/**
+ Query the next set of entries from a directory being queried in bulk.
+
+ @param ForEachContext Pointer to the enumeration context.
+
+ @param hDir A handle to the directory being enumerated.
+
+ @param FileName Optionally points to the enumeration criteria to apply.
+        This is only meaningful on the first query.
+
+ @param RestartScan TRUE if this is the first query for the directory.
+
+ @return The NTSTATUS code from the query.
+ */
+LONG
+YoriLibForEachFileBulkQuery(
+    __inout PYORILIB_FOREACHFILE_CONTEXT ForEachContext,
+    __in HANDLE hDir,
+    __in_opt PYORI_UNICODE_STRING FileName,
+    __in BOOLEAN RestartScan
+    )
+{
+    IO_STATUS_BLOCK IoStatus;
+    LONG Status;
+    DWORDLONG StartTime;
+
+    StartTime = 0;
+    if (YoriLibEtwIsEnabled(YORI_LIB_ETW_KEYWORD_FILEENUM)) {
+        StartTime = YoriLibEtwGetTimestamp();
+    }
+
+    ForEachContext->BulkBufferOffset = 0;
+    IoStatus.Information = 0;
+    Status = DllNtDll.pNtQueryDirectoryFile(hDir,
+                                            NULL,
+                                            NULL,
+                                            NULL,
+                                            &IoStatus,
+                                            ForEachContext->BulkBuffer,
+                                            YORILIB_FOREACHFILE_BULK_BUFFER_SIZE,
+                                            ForEachContext->BulkInfoClass,
+                                            FALSE,
+                                            FileName,
+                                            RestartScan);
+
+    if (StartTime != 0) {
+        YoriLibEtwWriteEvent(YORI_LIB_ETW_KEYWORD_FILEENUM,
+                             "FileEnumBatch",
+                             "Path",
+                             &ForEachContext->FullPath,
+                             "Bytes",
+                             (Status < 0)?0:(DWORDLONG)IoStatus.Information,
+                             "DurationUs",
+                             YoriLibEtwGetTimestamp() - StartTime);
+    }
+
+    return Status;
+}
+
+/**
+ Attempt to start a bulk enumerate of the path in the context's FullPath.
+
+ @param ForEachContext Pointer to the enumeration context.
+
+ @param hFind On successful completion, updated to contain a handle to the
+        directory being enumerated, or INVALID_HANDLE_VALUE if no matching
+        objects were found.
+
+ @return TRUE if the bulk enumerate has been performed, and hFind contains
+         its result.  FALSE if the bulk enumerate could not be performed
+         and the caller should fall back to FindFirstFile.
+ */
+__success(return)
+BOOL
+YoriLibForEachFileBulkFindFirst(
+    __inout PYORILIB_FOREACHFILE_CONTEXT ForEachContext,
+    __out PHANDLE hFind
+    )
+{
+    YORI_STRING DirectoryPart;
+    YORI_STRING Criteria;
+    YORI_STRING TranslatedCriteria;
+    YORI_UNICODE_STRING NtCriteria;
+    PYORI_UNICODE_STRING NtCriteriaToUse;
+    LPTSTR FinalSeperator;
+    TCHAR SavedChar;
+    HANDLE hDir;
+    LONG Status;
+    YORI_ALLOC_SIZE_T Index;
+    YORI_ALLOC_SIZE_T SavedLength;
+    TCHAR NextChar;
+
+    if (DllNtDll.pNtQueryDirectoryFile == NULL) {
+        return FALSE;
+    }
+
+    FinalSeperator = YoriLibFindRightMostCharacter(&ForEachContext->FullPath, '\\');
+    if (FinalSeperator == NULL) {
+        return FALSE;
+    }
+
+    YoriLibInitEmptyString(&DirectoryPart);
+    DirectoryPart.StartOfString = ForEachContext->FullPath.StartOfString;
+    DirectoryPart.LengthInChars = (YORI_ALLOC_SIZE_T)(FinalSeperator - ForEachContext->FullPath.StartOfString);
+
+    YoriLibInitEmptyString(&Criteria);
+    Criteria.StartOfString = FinalSeperator + 1;
+    Criteria.LengthInChars = ForEachContext->FullPath.LengthInChars - DirectoryPart.LengthInChars - 1;
+
+    if (Criteria.LengthInChars == 0 || DirectoryPart.LengthInChars == 0) {
+        return FALSE;
+    }
+
+    if (ForEachContext->BulkBuffer == NULL) {
+        ForEachContext->BulkBuffer = YoriLibMalloc(YORILIB_FOREACHFILE_BULK_BUFFER_SIZE);
+        if (ForEachContext->BulkBuffer == NULL) {
+            return FALSE;
+        }
+    }
+
+    //
+    //  Open the directory.  If it's a volume root, the trailing seperator
+    //  needs to be included.
+    //
+
+    SavedLength = DirectoryPart.LengthInChars;
+    if (DirectoryPart.StartOfString[DirectoryPart.LengthInChars - 1] == ':') {
+        DirectoryPart.LengthInChars++;
+    }
+    SavedChar = DirectoryPart.StartOfString[DirectoryPart.LengthInChars];
+    DirectoryPart.StartOfString[DirectoryPart.LengthInChars] = '\0';
+
+    hDir = CreateFile(DirectoryPart.StartOfString,
+                      FILE_LIST_DIRECTORY | SYNCHRONIZE,
+                      FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                      NULL,
+                      OPEN_EXISTING,
+                      FILE_FLAG_BACKUP_SEMANTICS,
+                      NULL);
+
+    DirectoryPart.StartOfString[DirectoryPart.LengthInChars] = SavedChar;
+    DirectoryPart.LengthInChars = SavedLength;
+
+    if (hDir == INVALID_HANDLE_VALUE) {
+        return FALSE;
+    }
+
+    //
+    //  Convert Win32 wildcard rules into their NT equivalents, as
+    //  FindFirstFile would.  A criteria of "*" or "*.*" matches everything,
+    //  so no criteria needs to be supplied to the file system.
+    //
+
+    NtCriteriaToUse = NULL;
+    YoriLibInitEmptyString(&TranslatedCriteria);
+    if (YoriLibCompareStringLit(&Criteria, _T("*")) != 0 &&
+        YoriLibCompareStringLit(&Criteria, _T("*.*")) != 0) {
+
+        if (!YoriLibAllocateString(&TranslatedCriteria, Criteria.LengthInChars + 1)) {
+            CloseHandle(hDir);
+            return FALSE;
+        }
+
+        for (Index = 0; Index < Criteria.LengthInChars; Index++) {
+            NextChar = '\0';
+            if (Index + 1 < Criteria.LengthInChars) {
+                NextChar = Criteria.StartOfString[Index + 1];
+            }
+
+            TranslatedCriteria.StartOfString[Index] = Criteria.StartOfString[Index];
+            if (Criteria.StartOfString[Index] == '?') {
+                TranslatedCriteria.StartOfString[Index] = '>';
+            } else if (Criteria.StartOfString[Index] == '*' && NextChar == '.') {
+                TranslatedCriteria.StartOfString[Index] = '<';
+            } else if (Criteria.StartOfString[Index] == '.' && (NextChar == '?' || NextChar == '*')) {
+                TranslatedCriteria.StartOfString[Index] = '"';
+            }
+        }
+        TranslatedCriteria.LengthInChars = Criteria.LengthInChars;
+
+        NtCriteria.Buffer = TranslatedCriteria.StartOfString;
+        NtCriteria.LengthInBytes = (WORD)(Criteria.LengthInChars * sizeof(WCHAR));
+        NtCriteria.LengthAllocatedInBytes = NtCriteria.LengthInBytes;
+        NtCriteriaToUse = &NtCriteria;
+    }
+
+    //
+    //  Try the newest information class first, and fall back to the older
+    //  one if the operating system or file system doesn't support it.  Any
+    //  failure on the older class falls back to FindFirstFile.
+    //
+
+    ForEachContext->BulkInfoClass = FileIdExtdBothDirectoryInformation;
+    Status = YoriLibForEachFileBulkQuery(ForEachContext, hDir, NtCriteriaToUse, TRUE);
+    if (Status < 0 &&
+        Status != STATUS_NO_SUCH_FILE &&
+        Status != STATUS_NO_MORE_FILES) {
+
+        ForEachContext->BulkInfoClass = FileIdBothDirectoryInformation;
+        Status = YoriLibForEachFileBulkQuery(ForEachContext, hDir, NtCriteriaToUse, TRUE);
+    }
+
+    YoriLibFreeStringContents(&TranslatedCriteria);
+
+    if (Status == STATUS_NO_SUCH_FILE || Status == STATUS_NO_MORE_FILES) {
+        CloseHandle(hDir);
+        SetLastError(ERROR_FILE_NOT_FOUND);
+        *hFind = INVALID_HANDLE_VALUE;
+        return TRUE;
+    }
+
+    if (Status < 0) {
+        CloseHandle(hDir);
+        return FALSE;
+    }
+
+    YoriLibForEachFileCaptureBulkEntry(ForEachContext);
+    ForEachContext->BulkQueryActive = TRUE;
+    *hFind = hDir;
+    return TRUE;
+}
+
+/**
+ Find the first object matching the path in the context's FullPath.  This
+ uses a bulk query if requested and possible, and FindFirstFile otherwise.
+
+ @param ForEachContext Pointer to the enumeration context.
+
+ @param MatchFlags Specifies the behavior of the match.
+
+ @return A handle to the enumeration, or INVALID_HANDLE_VALUE on failure.
+ */
+HANDLE
+YoriLibForEachFileFindFirst(
+    __inout PYORILIB_FOREACHFILE_CONTEXT ForEachContext,
+    __in WORD MatchFlags
+    )
+{
+    HANDLE hFind;
+
+    ForEachContext->BulkQueryActive = FALSE;
+    ForEachContext->FileInfo.ValidFields = 0;
+
+    if ((MatchFlags & YORILIB_FILEENUM_BULK_QUERY) != 0 &&
+        YoriLibForEachFileBulkFindFirst(ForEachContext, &hFind)) {
+
+        return hFind;
+    }
+
+    if (YoriLibEtwIsEnabled(YORI_LIB_ETW_KEYWORD_FILEENUM)) {
+        YoriLibEtwWriteEvent(YORI_LIB_ETW_KEYWORD_FILEENUM, "FileEnumFindFirst", "Path", &ForEachContext->FullPath, NULL, 0, NULL, 0);
+    }
+
+    return FindFirstFile(ForEachContext->FullPath.StartOfString, &ForEachContext->FileInfo.FindData);
+}
+
+/**
+ Find the next object in an enumeration started with
+ @ref YoriLibForEachFileFindFirst .
+
+ @param ForEachContext Pointer to the enumeration context.
+
+ @param hFind The handle to the enumeration.
+
+ @return TRUE if another object was found, FALSE if it was not.
+ */
+BOOL
+YoriLibForEachFileFindNext(
+    __inout PYORILIB_FOREACHFILE_CONTEXT ForEachContext,
+    __in HANDLE hFind
+    )
+{
+    DWORD NextEntryOffset;
+    LONG Status;
+
+    if (!ForEachContext->BulkQueryActive) {
+        return FindNextFile(hFind, &ForEachContext->FileInfo.FindData);
+    }
+
+    //
+    //  NextEntryOffset is the first field of all of the supported classes.
+    //
+
+    NextEntryOffset = *(PDWORD)(ForEachContext->BulkBuffer + ForEachContext->BulkBufferOffset);
+    if (NextEntryOffset != 0) {
+        ForEachContext->BulkBufferOffset = ForEachContext->BulkBufferOffset + NextEntryOffset;
+        YoriLibForEachFileCaptureBulkEntry(ForEachContext);
+        return TRUE;
+    }
+
+    Status = YoriLibForEachFileBulkQuery(ForEachContext, hFind, NULL, FALSE);
+    if (Status < 0) {
+        SetLastError(ERROR_NO_MORE_FILES);
+        return FALSE;
+    }
+
+    YoriLibForEachFileCaptureBulkEntry(ForEachContext);
+    return TRUE;
+}
+
+/**
+ Close an enumeration started with @ref YoriLibForEachFileFindFirst .
+
+ @param ForEachContext Pointer to the enumeration context.
+
+ @param hFind The handle to the enumeration.
+ */
+VOID
+YoriLibForEachFileFindClose(
+    __inout PYORILIB_FOREACHFILE_CONTEXT ForEachContext,
+    __in HANDLE hFind
+    )
+{
+    if (ForEachContext->BulkQueryActive) {
+        CloseHandle(hFind);
+        ForEachContext->BulkQueryActive = FALSE;
+    } else {
+        FindClose(hFind);
+    }
+}
+
 /**
  If a string contains a directory that ends with a seperator, and it's not
  referring to a drive root, remove the seperator.
@@ -152,16 +771,25 @@ YoriLibTruncateTrailingSeperatorIfBenign(
         about failures and wants to silently continue.
 
  @param Context Caller provided context to pass to the callback.
+
+ @param ParallelContext If the enumerate is being performed on multiple
+        threads, points to the state shared by those threads.  In this case
+        child directories are queued for worker threads rather than being
+        enumerated recursively.  If NULL, the enumerate is performed on the
+        calling thread.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
  */
 __success(return)
 BOOL
-YoriLibForEachFileEnum(
+YoriLibForEachFileEnumInternal(
     __in PYORI_STRING FileSpec,
     __in WORD MatchFlags,
     __in DWORD Depth,
     __in PYORILIB_FILE_ENUM_FN Callback,
     __in_opt PYORILIB_FILE_ENUM_ERROR_FN ErrorCallback,
-    __in_opt PVOID Context
+    __in_opt PVOID Context,
+    __in_opt PYORILIB_FOREACHFILE_PARALLEL_CONTEXT ParallelContext
     )
 {
     HANDLE hFind;
@@ -186,6 +814,9 @@ YoriLibForEachFileEnum(
         return FALSE;
     }
     YoriLibInitEmptyString(&ForEachContext->RecurseCriteria);
+    ForEachContext->BulkBuffer = NULL;
+    ForEachContext->BulkQueryActive = FALSE;
+    ForEachContext->FileInfo.ValidFields = 0;
 
     //
     //  This is currently only needed for the GetFileAttributes call.  It may
@@ -350,7 +981,7 @@ YoriLibForEachFileEnum(
         TrailingSlashInParentComponent = TRUE;
     }
 
-    if (!YoriLibAllocateString(&ForEachContext->FullPath, ForEachContext->ParentFullPath.LengthInChars + 1 + sizeof(ForEachContext->FileInfo.cFileName) / sizeof(TCHAR) + 1)) {
+    if (!YoriLibAllocateString(&ForEachContext->FullPath, ForEachContext->ParentFullPath.LengthInChars + 1 + sizeof(ForEachContext->FileInfo.FindData.cFileName) / sizeof(TCHAR) + 1)) {
         YoriLibFreeStringContents(&ForEachContext->EffectiveFileSpec);
         YoriLibFree(ForEachContext);
         return FALSE;
@@ -388,7 +1019,7 @@ YoriLibForEachFileEnum(
                                 ForEachContext->FullPath.LengthAllocated,
                                 _T("%y\\*"),
                                 &ForEachContext->ParentFullPath);
-            hFind = FindFirstFile(ForEachContext->FullPath.StartOfString, &ForEachContext->FileInfo);
+            hFind = YoriLibForEachFileFindFirst(ForEachContext, MatchFlags);
         } else {
             if (FinalSlashFound) {
 
@@ -439,7 +1070,7 @@ YoriLibForEachFileEnum(
                                         &ForEachContext->EffectiveFileSpec);
                 }
             }
-            hFind = FindFirstFile(ForEachContext->FullPath.StartOfString, &ForEachContext->FileInfo);
+            hFind = YoriLibForEachFileFindFirst(ForEachContext, MatchFlags);
 
             //
             //  If we can't enumerate it because it's a volume root, cook up
@@ -451,9 +1082,9 @@ YoriLibForEachFileEnum(
                 if ((ForEachContext->FullPath.LengthInChars == 3 && YoriLibIsDriveLetterWithColonAndSlash(&ForEachContext->FullPath)) ||
                     (ForEachContext->FullPath.LengthInChars == 7 && YoriLibIsPrefixedDriveLetterWithColonAndSlash(&ForEachContext->FullPath))) {
 
-                    if (YoriLibUpdateFindDataFromFileInformation(&ForEachContext->FileInfo, ForEachContext->FullPath.StartOfString, FALSE)) {
-                        ForEachContext->FileInfo.cFileName[0] = '\0';
-                        ForEachContext->FileInfo.cAlternateFileName[0] = '\0';
+                    if (YoriLibUpdateFindDataFromFileInformation(&ForEachContext->FileInfo.FindData, ForEachContext->FullPath.StartOfString, FALSE)) {
+                        ForEachContext->FileInfo.FindData.cFileName[0] = '\0';
+                        ForEachContext->FileInfo.FindData.cAlternateFileName[0] = '\0';
                         hFind = NULL;
                     }
                 }
@@ -462,8 +1093,19 @@ YoriLibForEachFileEnum(
 
         if (hFind == INVALID_HANDLE_VALUE) {
             if (ErrorCallback != NULL) {
-                if (!ErrorCallback(&ForEachContext->FullPath, GetLastError(), Depth, Context)) {
-                    Result = FALSE;
+                DWORD Err = GetLastError();
+                if (ParallelContext != NULL &&
+                    (MatchFlags & YORILIB_FILEENUM_CONCURRENT_CALLBACKS) == 0) {
+
+                    WaitForSingleObject(ParallelContext->CallbackMutex, INFINITE);
+                    if (!ErrorCallback(&ForEachContext->FullPath, Err, Depth, Context)) {
+                        Result = FALSE;
+                    }
+                    ReleaseMutex(ParallelContext->CallbackMutex);
+                } else {
+                    if (!ErrorCallback(&ForEachContext->FullPath, Err, Depth, Context)) {
+                        Result = FALSE;
+                    }
                 }
                 break;
             }
@@ -479,8 +1121,8 @@ YoriLibForEachFileEnum(
                 //  recursing.
                 //
 
-                if (_tcscmp(ForEachContext->FileInfo.cFileName, _T(".")) == 0 ||
-                    _tcscmp(ForEachContext->FileInfo.cFileName, _T("..")) == 0) {
+                if (_tcscmp(ForEachContext->FileInfo.FindData.cFileName, _T(".")) == 0 ||
+                    _tcscmp(ForEachContext->FileInfo.FindData.cFileName, _T("..")) == 0) {
 
                     if ((MatchFlags & YORILIB_FILEENUM_INCLUDE_DOTFILES) == 0) {
                         ReportObject = FALSE;
@@ -493,7 +1135,7 @@ YoriLibForEachFileEnum(
                 //  status.
                 //
 
-                if ((ForEachContext->FileInfo.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0) {
+                if ((ForEachContext->FileInfo.FindData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0) {
                     if ((MatchFlags & YORILIB_FILEENUM_RETURN_DIRECTORIES) == 0) {
                         ReportObject = FALSE;
                     }
@@ -510,9 +1152,9 @@ YoriLibForEachFileEnum(
 
                 IsLink = FALSE;
                 if ((MatchFlags & YORILIB_FILEENUM_NO_LINK_TRAVERSE) != 0 &&
-                    (ForEachContext->FileInfo.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) != 0 &&
-                    (ForEachContext->FileInfo.dwReserved0 == IO_REPARSE_TAG_MOUNT_POINT ||
-                     ForEachContext->FileInfo.dwReserved0 == IO_REPARSE_TAG_SYMLINK)) {
+                    (ForEachContext->FileInfo.FindData.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) != 0 &&
+                    (ForEachContext->FileInfo.FindData.dwReserved0 == IO_REPARSE_TAG_MOUNT_POINT ||
+                     ForEachContext->FileInfo.FindData.dwReserved0 == IO_REPARSE_TAG_SYMLINK)) {
 
                     IsLink = TRUE;
                 }
@@ -522,11 +1164,11 @@ YoriLibForEachFileEnum(
                 //
 
                 if (!DotFile &&
-                    (ForEachContext->FileInfo.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0 &&
+                    (ForEachContext->FileInfo.FindData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0 &&
                     RecursePhase &&
                     !IsLink) {
 
-                    YORI_ALLOC_SIZE_T FileNameLen = (YORI_ALLOC_SIZE_T)_tcslen(ForEachContext->FileInfo.cFileName);
+                    YORI_ALLOC_SIZE_T FileNameLen = (YORI_ALLOC_SIZE_T)_tcslen(ForEachContext->FileInfo.FindData.cFileName);
                     YORI_ALLOC_SIZE_T WildLength = 2;
 
                     if ((MatchFlags & YORILIB_FILEENUM_RECURSE_PRESERVE_WILD) != 0) {
@@ -547,7 +1189,7 @@ YoriLibForEachFileEnum(
                         ForEachContext->RecurseCriteria.LengthInChars = ForEachContext->CharsToFinalSlash;
                     }
                     memcpy(&ForEachContext->RecurseCriteria.StartOfString[ForEachContext->RecurseCriteria.LengthInChars],
-                           ForEachContext->FileInfo.cFileName,
+                           ForEachContext->FileInfo.FindData.cFileName,
                            FileNameLen * sizeof(TCHAR));
                     ForEachContext->RecurseCriteria.LengthInChars = ForEachContext->RecurseCriteria.LengthInChars + FileNameLen;
                     ForEachContext->RecurseCriteria.StartOfString[ForEachContext->RecurseCriteria.LengthInChars] = '\\';
@@ -574,7 +1216,17 @@ YoriLibForEachFileEnum(
                         ForEachContext->RecurseCriteria.StartOfString[ForEachContext->RecurseCriteria.LengthInChars] = '\0';
                     }
 
-                    if (!YoriLibForEachFileEnum(&ForEachContext->RecurseCriteria, MatchFlags, Depth + 1, Callback, ErrorCallback, Context)) {
+                    //
+                    //  If other threads are enumerating, hand the directory
+                    //  to them rather than recursing on this thread.
+                    //
+
+                    if (ParallelContext != NULL) {
+                        if (!YoriLibForEachFileQueueDirectory(ParallelContext, &ForEachContext->RecurseCriteria, Depth + 1)) {
+                            Result = FALSE;
+                            break;
+                        }
+                    } else if (!YoriLibForEachFileEnumInternal(&ForEachContext->RecurseCriteria, MatchFlags, Depth + 1, Callback, ErrorCallback, Context, NULL)) {
                         Result = FALSE;
                         break;
                     }
@@ -607,18 +1259,29 @@ YoriLibForEachFileEnum(
                                                 ForEachContext->FullPath.LengthAllocated,
                                                 _T("%y%s"),
                                                 &ForEachContext->ParentFullPath,
-                                                ForEachContext->FileInfo.cFileName);
+                                                ForEachContext->FileInfo.FindData.cFileName);
                         } else {
                             ForEachContext->FullPath.LengthInChars =
                                 YoriLibSPrintfS(ForEachContext->FullPath.StartOfString,
                                                 ForEachContext->FullPath.LengthAllocated,
                                                 _T("%y\\%s"),
                                                 &ForEachContext->ParentFullPath,
-                                                ForEachContext->FileInfo.cFileName);
+                                                ForEachContext->FileInfo.FindData.cFileName);
                         }
                     }
 
-                    if (!Callback(&ForEachContext->FullPath, &ForEachContext->FileInfo, Depth, Context)) {
+                    if (ParallelContext != NULL &&
+                        (MatchFlags & YORILIB_FILEENUM_CONCURRENT_CALLBACKS) == 0) {
+
+                        WaitForSingleObject(ParallelContext->CallbackMutex, INFINITE);
+                        if (!Callback(&ForEachContext->FullPath, &ForEachContext->FileInfo.FindData, Depth, Context)) {
+                            Result = FALSE;
+                        }
+                        ReleaseMutex(ParallelContext->CallbackMutex);
+                        if (!Result) {
+                            break;
+                        }
+                    } else if (!Callback(&ForEachContext->FullPath, &ForEachContext->FileInfo.FindData, Depth, Context)) {
                         Result = FALSE;
                         break;
                     }
@@ -629,12 +1292,17 @@ YoriLibForEachFileEnum(
                     }
                 }
 
-            } while (hFind != INVALID_HANDLE_VALUE && hFind != NULL && FindNextFile(hFind, &ForEachContext->FileInfo));
+                if (ParallelContext != NULL && ParallelContext->Abort) {
+                    Result = FALSE;
+                    break;
+                }
+
+            } while (hFind != INVALID_HANDLE_VALUE && hFind != NULL && YoriLibForEachFileFindNext(ForEachContext, hFind));
 
             YoriLibFreeStringContents(&ForEachContext->RecurseCriteria);
 
             if (hFind != NULL && hFind != INVALID_HANDLE_VALUE) {
-                FindClose(hFind);
+                YoriLibForEachFileFindClose(ForEachContext, hFind);
             }
 
             if (Result == FALSE) {
@@ -646,11 +1314,234 @@ YoriLibForEachFileEnum(
     YoriLibFreeStringContents(&ForEachContext->EffectiveFileSpec);
     YoriLibFreeStringContents(&ForEachContext->ParentFullPath);
     YoriLibFreeStringContents(&ForEachContext->FullPath);
+    if (ForEachContext->BulkBuffer != NULL) {
+        YoriLibFree(ForEachContext->BulkBuffer);
+    }
     YoriLibFree(ForEachContext);
 
     return Result;
 }
 
+/**
+ A worker thread for a parallel enumerate.  This thread removes directories
+ from the pending list and enumerates them until the enumerate is complete.
+
+ @param Param Pointer to the state of the parallel enumerate.
+
+ @return Zero.
+ */
+DWORD WINAPI
+YoriLibForEachFileWorker(
+    __in LPVOID Param
+    )
+{
+    PYORILIB_FOREACHFILE_PARALLEL_CONTEXT ParallelContext;
+    PYORILIB_FOREACHFILE_PENDING_DIR PendingDir;
+    PYORI_LIST_ENTRY ListEntry;
+    HANDLE WaitHandles[2];
+    DWORD WaitResult;
+
+    ParallelContext = (PYORILIB_FOREACHFILE_PARALLEL_CONTEXT)Param;
+    WaitHandles[0] = ParallelContext->CompleteEvent;
+    WaitHandles[1] = ParallelContext->WorkerWaitSemaphore;
+
+    while (TRUE) {
+        WaitResult = WaitForMultipleObjects(2, WaitHandles, FALSE, INFINITE);
+        if (WaitResult != WAIT_OBJECT_0 + 1) {
+            break;
+        }
+
+        WaitForSingleObject(ParallelContext->Mutex, INFINITE);
+        ListEntry = YoriLibGetNextListEntry(&ParallelContext->PendingList, NULL);
+        if (ListEntry != NULL) {
+            YoriLibRemoveListItem(ListEntry);
+        }
+        ReleaseMutex(ParallelContext->Mutex);
+
+        if (ListEntry == NULL) {
+            continue;
+        }
+
+        PendingDir = CONTAINING_RECORD(ListEntry, YORILIB_FOREACHFILE_PENDING_DIR, ListEntry);
+
+        if (!ParallelContext->Abort) {
+            if (!YoriLibForEachFileEnumInternal(&PendingDir->Criteria,
+                                                ParallelContext->MatchFlags,
+                                                PendingDir->Depth,
+                                                ParallelContext->Callback,
+                                                ParallelContext->ErrorCallback,
+                                                ParallelContext->Context,
+                                                ParallelContext)) {
+
+                ParallelContext->Abort = TRUE;
+            }
+        }
+
+        YoriLibFreeStringContents(&PendingDir->Criteria);
+        YoriLibFree(PendingDir);
+        YoriLibForEachFileCompleteDirectory(ParallelContext);
+    }
+
+    return 0;
+}
+
+/**
+ Clean up the state used by a parallel enumerate.  Any worker threads are
+ waited upon before returning.
+
+ @param ParallelContext Pointer to the state of the parallel enumerate.
+ */
+VOID
+YoriLibForEachFileCleanupParallelContext(
+    __in PYORILIB_FOREACHFILE_PARALLEL_CONTEXT ParallelContext
+    )
+{
+    DWORD Index;
+
+    if (ParallelContext->ThreadCount > 0) {
+        SetEvent(ParallelContext->CompleteEvent);
+        WaitForMultipleObjects(ParallelContext->ThreadCount, ParallelContext->Threads, TRUE, INFINITE);
+        for (Index = 0; Index < ParallelContext->ThreadCount; Index++) {
+            CloseHandle(ParallelContext->Threads[Index]);
+        }
+        ParallelContext->ThreadCount = 0;
+    }
+
+    ASSERT(YoriLibIsListEmpty(&ParallelContext->PendingList));
+
+    if (ParallelContext->Mutex != NULL) {
+        CloseHandle(ParallelContext->Mutex);
+    }
+    if (ParallelContext->CallbackMutex != NULL) {
+        CloseHandle(ParallelContext->CallbackMutex);
+    }
+    if (ParallelContext->WorkerWaitSemaphore != NULL) {
+        CloseHandle(ParallelContext->WorkerWaitSemaphore);
+    }
+    if (ParallelContext->CompleteEvent != NULL) {
+        CloseHandle(ParallelContext->CompleteEvent);
+    }
+}
+
+/**
+ Call a callback for every file matching a specified file pattern.  If the
+ caller requested a parallel recursive enumerate, child directories are
+ distributed across a pool of worker threads.
+
+ @param FileSpec The pattern to match against.
+
+ @param MatchFlags Specifies the behavior of the match, including whether
+        it should be applied recursively and the recursing behavior.
+
+ @param Depth Indicates the current recursion depth.  If this function is
+        reentered, this value is incremented.
+
+ @param Callback The callback to invoke on each match.
+
+ @param ErrorCallback Optionally points to a function to invoke if a
+        directory cannot be enumerated.  If NULL, the caller does not care
+        about failures and wants to silently continue.
+
+ @param Context Caller provided context to pass to the callback.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriLibForEachFileEnum(
+    __in PYORI_STRING FileSpec,
+    __in WORD MatchFlags,
+    __in DWORD Depth,
+    __in PYORILIB_FILE_ENUM_FN Callback,
+    __in_opt PYORILIB_FILE_ENUM_ERROR_FN ErrorCallback,
+    __in_opt PVOID Context
+    )
+{
+    YORILIB_FOREACHFILE_PARALLEL_CONTEXT ParallelContext;
+    SYSTEM_INFO SystemInfo;
+    DWORD MaxThreads;
+    DWORD ThreadId;
+    BOOL Result;
+
+    if ((MatchFlags & YORILIB_FILEENUM_PARALLEL) == 0 ||
+        (MatchFlags & (YORILIB_FILEENUM_RECURSE_AFTER_RETURN | YORILIB_FILEENUM_RECURSE_BEFORE_RETURN)) == 0) {
+
+        return YoriLibForEachFileEnumInternal(FileSpec, MatchFlags, Depth, Callback, ErrorCallback, Context, NULL);
+    }
+
+    ZeroMemory(&ParallelContext, sizeof(ParallelContext));
+    YoriLibInitializeListHead(&ParallelContext.PendingList);
+    ParallelContext.MatchFlags = MatchFlags;
+    ParallelContext.Callback = Callback;
+    ParallelContext.ErrorCallback = ErrorCallback;
+    ParallelContext.Context = Context;
+
+    //
+    //  Directory enumeration is typically bound by latency rather than CPU,
+    //  so use more threads than processors.
+    //
+
+    GetSystemInfo(&SystemInfo);
+    MaxThreads = SystemInfo.dwNumberOfProcessors * 2;
+    if (MaxThreads < 2) {
+        MaxThreads = 2;
+    }
+    if (MaxThreads > YORILIB_FOREACHFILE_MAX_THREADS) {
+        MaxThreads = YORILIB_FOREACHFILE_MAX_THREADS;
+    }
+
+    ParallelContext.Mutex = CreateMutex(NULL, FALSE, NULL);
+    ParallelContext.CallbackMutex = CreateMutex(NULL, FALSE, NULL);
+    ParallelContext.WorkerWaitSemaphore = CreateSemaphore(NULL, 0, 0x7FFFFFFF, NULL);
+    ParallelContext.CompleteEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+
+    if (ParallelContext.Mutex == NULL ||
+        ParallelContext.CallbackMutex == NULL ||
+        ParallelContext.WorkerWaitSemaphore == NULL ||
+        ParallelContext.CompleteEvent == NULL) {
+
+        YoriLibForEachFileCleanupParallelContext(&ParallelContext);
+        return YoriLibForEachFileEnumInternal(FileSpec, MatchFlags, Depth, Callback, ErrorCallback, Context, NULL);
+    }
+
+    for (ParallelContext.ThreadCount = 0; ParallelContext.ThreadCount < MaxThreads; ParallelContext.ThreadCount++) {
+        ParallelContext.Threads[ParallelContext.ThreadCount] = CreateThread(NULL, 0, YoriLibForEachFileWorker, &ParallelContext, 0, &ThreadId);
+        if (ParallelContext.Threads[ParallelContext.ThreadCount] == NULL) {
+            break;
+        }
+    }
+
+    //
+    //  If no worker threads could be created, there's nobody to hand
+    //  directories to, so enumerate on this thread.
+    //
+
+    if (ParallelContext.ThreadCount == 0) {
+        YoriLibForEachFileCleanupParallelContext(&ParallelContext);
+        return YoriLibForEachFileEnumInternal(FileSpec, MatchFlags, Depth, Callback, ErrorCallback, Context, NULL);
+    }
+
+    //
+    //  The top level directory is enumerated on this thread, and counts
+    //  as outstanding work until it is complete.
+    //
+
+    ParallelContext.Outstanding = 1;
+    Result = YoriLibForEachFileEnumInternal(FileSpec, MatchFlags, Depth, Callback, ErrorCallback, Context, &ParallelContext);
+    if (!Result) {
+        ParallelContext.Abort = TRUE;
+    }
+    YoriLibForEachFileCompleteDirectory(&ParallelContext);
+
+    WaitForSingleObject(ParallelContext.CompleteEvent, INFINITE);
+    if (ParallelContext.Abort) {
+        Result = FALSE;
+    }
+
+    YoriLibForEachFileCleanupParallelContext(&ParallelContext);
+    return Result;
+}
+
 /**
  Enumerate the set of possible files matching a user specified pattern.
  This function is responsible for expanding Yori defined sequences, including
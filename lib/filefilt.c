@@ -48,6 +48,31 @@ CHAR strFileFiltHelpText[] =
         "\n"
         " Valid attributes are:\n";
 
+/**
+ The cost of collecting an attribute which is contained in the information
+ returned from directory enumeration.
+ */
+#define YORI_LIB_FILE_FILT_COST_FIND_DATA (0)
+
+/**
+ The cost of collecting an attribute which requires the file to be opened
+ and its metadata queried.
+ */
+#define YORI_LIB_FILE_FILT_COST_OPEN      (1)
+
+/**
+ The cost of collecting an attribute which requires the contents of the file
+ to be read and parsed.
+ */
+#define YORI_LIB_FILE_FILT_COST_READ      (2)
+
+/**
+ The maximum number of options.  Each filter evaluation tracks which
+ collection functions have been invoked in a 64 bit mask indexed by the
+ first option using each collection function.
+ */
+#define YORI_LIB_FILE_FILT_MAX_COLLECTORS (64)
+
 /**
  A single option that files can be filtered against.
  */
@@ -82,6 +107,12 @@ typedef struct _YORI_LIB_FILE_FILT_FILTER_OPT {
      */
     YORI_LIB_FILE_FILT_GENERATE_FROM_STRING_FN GenerateFromStringFn;
 
+    /**
+     The relative cost of collecting the data for the option, which is one
+     of the YORI_LIB_FILE_FILT_COST values.
+     */
+    DWORD Cost;
+
     /**
      A string containing a description for the option.
      */
@@ -102,131 +133,163 @@ CONST YORI_LIB_FILE_FILT_FILTER_OPT
 YoriLibFileFiltFilterOptions[] = {
     {_T("ac"),                               YoriLibCollectAllocatedRangeCount,
      YoriLibCompareAllocatedRangeCount,      NULL,
-     YoriLibGenerateAllocatedRangeCount,     "allocated range count"},
+     YoriLibGenerateAllocatedRangeCount,     YORI_LIB_FILE_FILT_COST_OPEN,
+     "allocated range count"},
 
     {_T("ad"),                               YoriLibCollectAccessTime,
      YoriLibCompareAccessDate,               NULL,
-     YoriLibGenerateAccessDate,              "access date"},
+     YoriLibGenerateAccessDate,              YORI_LIB_FILE_FILT_COST_FIND_DATA,
+     "access date"},
 
     {_T("ar"),                               YoriLibCollectArch,
      YoriLibCompareArch,                     NULL,
-     YoriLibGenerateArch,                    "CPU architecture"},
+     YoriLibGenerateArch,                    YORI_LIB_FILE_FILT_COST_READ,
+     "CPU architecture"},
 
     {_T("as"),                               YoriLibCollectAllocationSize,
      YoriLibCompareAllocationSize,           NULL,
-     YoriLibGenerateAllocationSize,          "allocation size"},
+     YoriLibGenerateAllocationSize,          YORI_LIB_FILE_FILT_COST_OPEN,
+     "allocation size"},
 
     {_T("at"),                               YoriLibCollectAccessTime,
      YoriLibCompareAccessTime,               NULL,
-     YoriLibGenerateAccessTime,              "access time"},
+     YoriLibGenerateAccessTime,              YORI_LIB_FILE_FILT_COST_FIND_DATA,
+     "access time"},
 
     {_T("ca"),                               YoriLibCollectCompressionAlgorithm,
      YoriLibCompareCompressionAlgorithm,     NULL,
-     YoriLibGenerateCompressionAlgorithm,    "compression algorithm"},
+     YoriLibGenerateCompressionAlgorithm,    YORI_LIB_FILE_FILT_COST_OPEN,
+     "compression algorithm"},
 
     {_T("cd"),                               YoriLibCollectCreateTime,
      YoriLibCompareCreateDate,               NULL,
-     YoriLibGenerateCreateDate,              "create date"},
+     YoriLibGenerateCreateDate,              YORI_LIB_FILE_FILT_COST_FIND_DATA,
+     "create date"},
 
     {_T("ci"),                               YoriLibCollectCaseSensitivity,
      YoriLibCompareCaseSensitivity,          NULL,
-     YoriLibGenerateCaseSensitivity,         "case insensitivity"},
+     YoriLibGenerateCaseSensitivity,         YORI_LIB_FILE_FILT_COST_OPEN,
+     "case insensitivity"},
 
     {_T("cs"),                               YoriLibCollectCompressedFileSize,
      YoriLibCompareCompressedFileSize,       NULL,
-     YoriLibGenerateCompressedFileSize,      "compressed size"},
+     YoriLibGenerateCompressedFileSize,      YORI_LIB_FILE_FILT_COST_OPEN,
+     "compressed size"},
 
     {_T("ct"),                               YoriLibCollectCreateTime,
      YoriLibCompareCreateTime,               NULL,
-     YoriLibGenerateCreateTime,              "create time"},
+     YoriLibGenerateCreateTime,              YORI_LIB_FILE_FILT_COST_FIND_DATA,
+     "create time"},
 
     {_T("de"),                               YoriLibCollectDescription,
      YoriLibCompareDescription,              NULL,
-     YoriLibGenerateDescription,             "description"},
+     YoriLibGenerateDescription,             YORI_LIB_FILE_FILT_COST_READ,
+     "description"},
 
     {_T("dr"),                               YoriLibCollectFileAttributes,
      YoriLibCompareDirectory,                NULL,
-     YoriLibGenerateDirectory,               "directory"},
+     YoriLibGenerateDirectory,               YORI_LIB_FILE_FILT_COST_FIND_DATA,
+     "directory"},
 
     {_T("ep"),                               YoriLibCollectEffectivePermissions,
      YoriLibCompareEffectivePermissions,     YoriLibBitwiseEffectivePermissions,
-     YoriLibGenerateEffectivePermissions,    "effective permissions"},
+     YoriLibGenerateEffectivePermissions,    YORI_LIB_FILE_FILT_COST_OPEN,
+     "effective permissions"},
 
     {_T("fa"),                               YoriLibCollectFileAttributes,
      YoriLibCompareFileAttributes,           YoriLibBitwiseFileAttributes,
-     YoriLibGenerateFileAttributes,          "file attributes"},
+     YoriLibGenerateFileAttributes,          YORI_LIB_FILE_FILT_COST_FIND_DATA,
+     "file attributes"},
 
     {_T("fc"),                               YoriLibCollectFragmentCount,
      YoriLibCompareFragmentCount,            NULL,
-     YoriLibGenerateFragmentCount,           "fragment count"},
+     YoriLibGenerateFragmentCount,           YORI_LIB_FILE_FILT_COST_OPEN,
+     "fragment count"},
 
     {_T("fe"),                               YoriLibCollectFileName,
      YoriLibCompareFileExtension,            NULL,
-     YoriLibGenerateFileExtension,           "file extension"},
+     YoriLibGenerateFileExtension,           YORI_LIB_FILE_FILT_COST_FIND_DATA,
+     "file extension"},
 
     {_T("fi"),                               YoriLibCollectFileId,
      YoriLibCompareFileId,                   NULL,
-     YoriLibGenerateFileId,                  "file id"},
+     YoriLibGenerateFileId,                  YORI_LIB_FILE_FILT_COST_OPEN,
+     "file id"},
 
     {_T("fn"),                               YoriLibCollectFileName,
      YoriLibCompareFileName,                 YoriLibBitwiseFileName,
-     YoriLibGenerateFileName,                "file name"},
+     YoriLibGenerateFileName,                YORI_LIB_FILE_FILT_COST_FIND_DATA,
+     "file name"},
 
     {_T("fs"),                               YoriLibCollectFileSize,
      YoriLibCompareFileSize,                 NULL,
-     YoriLibGenerateFileSize,                "file size"},
+     YoriLibGenerateFileSize,                YORI_LIB_FILE_FILT_COST_FIND_DATA,
+     "file size"},
 
     {_T("fv"),                               YoriLibCollectFileVersionString,
      YoriLibCompareFileVersionString,        NULL,
-     YoriLibGenerateFileVersionString,       "file version string"},
+     YoriLibGenerateFileVersionString,       YORI_LIB_FILE_FILT_COST_READ,
+     "file version string"},
 
     {_T("lc"),                               YoriLibCollectLinkCount,
      YoriLibCompareLinkCount,                NULL,
-     YoriLibGenerateLinkCount,               "link count"},
+     YoriLibGenerateLinkCount,               YORI_LIB_FILE_FILT_COST_OPEN,
+     "link count"},
 
     {_T("oi"),                               YoriLibCollectObjectId,
      YoriLibCompareObjectId,                 NULL,
-     YoriLibGenerateObjectId,                "object id"},
+     YoriLibGenerateObjectId,                YORI_LIB_FILE_FILT_COST_OPEN,
+     "object id"},
 
     {_T("os"),                               YoriLibCollectOsVersion,
      YoriLibCompareOsVersion,                NULL,
-     YoriLibGenerateOsVersion,               "minimum OS version"},
+     YoriLibGenerateOsVersion,               YORI_LIB_FILE_FILT_COST_READ,
+     "minimum OS version"},
 
     {_T("ow"),                               YoriLibCollectOwner,
      YoriLibCompareOwner,                    NULL,
-     YoriLibGenerateOwner,                   "owner"},
+     YoriLibGenerateOwner,                   YORI_LIB_FILE_FILT_COST_OPEN,
+     "owner"},
 
     {_T("rt"),                               YoriLibCollectReparseTag,
      YoriLibCompareReparseTag,               NULL,
-     YoriLibGenerateReparseTag,              "reparse tag"},
+     YoriLibGenerateReparseTag,              YORI_LIB_FILE_FILT_COST_FIND_DATA,
+     "reparse tag"},
 
     {_T("sc"),                               YoriLibCollectStreamCount,
      YoriLibCompareStreamCount,              NULL,
-     YoriLibGenerateStreamCount,             "stream count"},
+     YoriLibGenerateStreamCount,             YORI_LIB_FILE_FILT_COST_OPEN,
+     "stream count"},
 
     {_T("sn"),                               YoriLibCollectShortName,
      YoriLibCompareShortName,                NULL,
-     YoriLibGenerateShortName,               "short name"},
+     YoriLibGenerateShortName,               YORI_LIB_FILE_FILT_COST_FIND_DATA,
+     "short name"},
 
     {_T("ss"),                               YoriLibCollectSubsystem,
      YoriLibCompareSubsystem,                NULL,
-     YoriLibGenerateSubsystem,               "subsystem"},
+     YoriLibGenerateSubsystem,               YORI_LIB_FILE_FILT_COST_READ,
+     "subsystem"},
 
     {_T("us"),                               YoriLibCollectUsn,
      YoriLibCompareUsn,                      NULL,
-     YoriLibGenerateUsn,                     "USN"},
+     YoriLibGenerateUsn,                     YORI_LIB_FILE_FILT_COST_OPEN,
+     "USN"},
 
     {_T("vr"),                               YoriLibCollectVersion,
      YoriLibCompareVersion,                  NULL,
-     YoriLibGenerateVersion,                 "version"},
+     YoriLibGenerateVersion,                 YORI_LIB_FILE_FILT_COST_READ,
+     "version"},
 
     {_T("wd"),                               YoriLibCollectWriteTime,
      YoriLibCompareWriteDate,                NULL,
-     YoriLibGenerateWriteDate,               "write date"},
+     YoriLibGenerateWriteDate,               YORI_LIB_FILE_FILT_COST_FIND_DATA,
+     "write date"},
 
     {_T("wt"),                               YoriLibCollectWriteTime,
      YoriLibCompareWriteTime,                NULL,
-     YoriLibGenerateWriteTime,               "write time"},
+     YoriLibGenerateWriteTime,               YORI_LIB_FILE_FILT_COST_FIND_DATA,
+     "write time"},
 };
 
 /**
@@ -358,6 +421,20 @@ YoriLibFileFiltParseFilterOperator(
     }
 
     Criteria->CollectFn = MatchedOption->CollectFn;
+    Criteria->Cost = MatchedOption->Cost;
+
+    //
+    //  Several options share a collection function.  Identify the
+    //  collection function by the first option which uses it, so each
+    //  evaluation can collect it at most once however many criteria need
+    //  it.
+    //
+
+    Criteria->CollectorIndex = 0;
+    while (YoriLibFileFiltFilterOptions[Criteria->CollectorIndex].CollectFn != MatchedOption->CollectFn) {
+        Criteria->CollectorIndex++;
+    }
+    ASSERT(Criteria->CollectorIndex < YORI_LIB_FILE_FILT_MAX_COLLECTORS);
 
     //
     //  If we fail to capture this, ignore it and move on to the
@@ -603,7 +680,6 @@ YoriLibFileFiltParseFilterStringInternal(
     PYORI_LIB_FILE_FILT_MATCH_CRITERIA ThisElement;
     LPTSTR NextStart;
     YORI_ALLOC_SIZE_T ElementCount;
-    DWORD Index;
     DWORD Phase;
 
     ASSERT(AllocationSize >= sizeof(YORI_LIB_FILE_FILT_MATCH_CRITERIA));
@@ -635,26 +711,6 @@ YoriLibFileFiltParseFilterStringInternal(
                         YoriLibFree(Criteria);
                         return FALSE;
                     }
-
-                    //
-                    //  At the expense of being N^2, check if a previous
-                    //  item is already collecting the same data.  If it
-                    //  is, don't collect anything by this item.  The
-                    //  hope is this filter chain is executed across
-                    //  multiple files so the cost of this check will be
-                    //  outweighed by the operations it eliminates.
-                    //
-
-                    if (ThisElement->CollectFn != NULL) {
-                        PYORI_LIB_FILE_FILT_MATCH_CRITERIA PreviousElement;
-                        for (Index = 0; Index < ElementCount; Index++) {
-                            PreviousElement = (PYORI_LIB_FILE_FILT_MATCH_CRITERIA)YoriLibAddToPointer(Criteria, Index * AllocationSize);
-                            if (ThisElement->CollectFn == PreviousElement->CollectFn) {
-                                ThisElement->CollectFn = NULL;
-                                break;
-                            }
-                        }
-                    }
                 }
                 ElementCount++;
             }
@@ -716,7 +772,37 @@ YoriLibFileFiltParseFilterString(
     __out _On_failure_(_Post_valid_) PYORI_STRING ErrorSubstring
     )
 {
-    return YoriLibFileFiltParseFilterStringInternal(Filter, FilterString, YoriLibFileFiltParseFilterElement, sizeof(YORI_LIB_FILE_FILT_MATCH_CRITERIA), ErrorSubstring);
+    PYORI_LIB_FILE_FILT_MATCH_CRITERIA CriteriaArray;
+    YORI_LIB_FILE_FILT_MATCH_CRITERIA Swap;
+    DWORD Index;
+    DWORD Insert;
+
+    if (!YoriLibFileFiltParseFilterStringInternal(Filter, FilterString, YoriLibFileFiltParseFilterElement, sizeof(YORI_LIB_FILE_FILT_MATCH_CRITERIA), ErrorSubstring)) {
+        return FALSE;
+    }
+
+    //
+    //  A file must satisfy every criteria, so the order of evaluation does
+    //  not change the result.  Evaluate the criteria that are cheapest to
+    //  collect first, so a file that fails those is never opened or read.
+    //  This is an insertion sort so criteria of equal cost retain the order
+    //  the user specified.
+    //
+
+    CriteriaArray = (PYORI_LIB_FILE_FILT_MATCH_CRITERIA)Filter->Criteria;
+    for (Index = 1; Index < Filter->NumberCriteria; Index++) {
+        if (CriteriaArray[Index].Cost >= CriteriaArray[Index - 1].Cost) {
+            continue;
+        }
+
+        memcpy(&Swap, &CriteriaArray[Index], sizeof(Swap));
+        for (Insert = Index; Insert > 0 && CriteriaArray[Insert - 1].Cost > Swap.Cost; Insert--) {
+            memcpy(&CriteriaArray[Insert], &CriteriaArray[Insert - 1], sizeof(Swap));
+        }
+        memcpy(&CriteriaArray[Insert], &Swap, sizeof(Swap));
+    }
+
+    return TRUE;
 }
 
 /**
@@ -746,6 +832,57 @@ YoriLibFileFiltParseColorString(
     return YoriLibFileFiltParseFilterStringInternal(Filter, ColorString, YoriLibFileFiltParseColorElement, sizeof(YORI_LIB_FILE_FILT_COLOR_CRITERIA), ErrorSubstring);
 }
 
+/**
+ Collect the attribute needed to evaluate a criteria, unless an earlier
+ criteria in the same evaluation has already collected it.  Collection is
+ deferred until a criteria is evaluated so that expensive attributes are
+ only collected for files that reach a criteria which needs them.
+
+ @param Criteria Pointer to the criteria about to be evaluated.
+
+ @param Collected Pointer to a mask of the collection functions that have
+        already been invoked for this file.  Updated on successful
+        collection.
+
+ @param CompareEntry Pointer to the information collected for this file.
+
+ @param FileInfo Pointer to the information returned from directory
+        enumeration.
+
+ @param FilePath Pointer to a fully qualified file path.
+
+ @return TRUE to indicate the attribute is available, FALSE if it could not
+         be collected.
+ */
+__success(return)
+BOOL
+YoriLibFileFiltCollectForCriteria(
+    __in PYORI_LIB_FILE_FILT_MATCH_CRITERIA Criteria,
+    __inout PDWORDLONG Collected,
+    __inout PYORI_FILE_INFO CompareEntry,
+    __in PWIN32_FIND_DATA FileInfo,
+    __in PYORI_STRING FilePath
+    )
+{
+    DWORDLONG CollectorMask;
+
+    if (Criteria->CollectFn == NULL) {
+        return TRUE;
+    }
+
+    CollectorMask = ((DWORDLONG)1) << Criteria->CollectorIndex;
+    if (*Collected & CollectorMask) {
+        return TRUE;
+    }
+
+    if (!Criteria->CollectFn(CompareEntry, FileInfo, FilePath)) {
+        return FALSE;
+    }
+
+    *Collected = *Collected | CollectorMask;
+    return TRUE;
+}
+
 /**
  Evaluate whether a found file meets the criteria specified by the user
  supplied filter string.
@@ -771,6 +908,7 @@ YoriLibFileFiltCheckFilterMatch(
     )
 {
     DWORD Count;
+    DWORDLONG Collected;
     YORI_FILE_INFO CompareEntry;
     PYORI_LIB_FILE_FILT_MATCH_CRITERIA CriteriaArray;
     PYORI_LIB_FILE_FILT_MATCH_CRITERIA Criteria;
@@ -780,13 +918,12 @@ YoriLibFileFiltCheckFilterMatch(
     }
 
     ZeroMemory(&CompareEntry, sizeof(CompareEntry));
+    Collected = 0;
 
     CriteriaArray = (PYORI_LIB_FILE_FILT_MATCH_CRITERIA)Filter->Criteria;
     for (Count = 0; Count < Filter->NumberCriteria; Count++) {
         Criteria = &CriteriaArray[Count];
-        if (Criteria->CollectFn != NULL &&
-            !Criteria->CollectFn(&CompareEntry, FileInfo, FilePath)) {
-
+        if (!YoriLibFileFiltCollectForCriteria(Criteria, &Collected, &CompareEntry, FileInfo, FilePath)) {
             return FALSE;
         }
 
@@ -831,8 +968,10 @@ YoriLibFileFiltCheckColorMatch(
     PYORI_LIB_FILE_FILT_COLOR_CRITERIA ThisApply;
     PYORI_LIB_FILE_FILT_COLOR_CRITERIA ColorsToApply;
     YORI_FILE_INFO CompareEntry;
+    DWORDLONG Collected;
 
     ZeroMemory(&CompareEntry, sizeof(CompareEntry));
+    Collected = 0;
 
     ThisAttribute.Ctrl = YORILIB_ATTRCTRL_WINDOW_BG | YORILIB_ATTRCTRL_WINDOW_FG;
     ThisAttribute.Win32Attr = 0;
@@ -853,9 +992,7 @@ YoriLibFileFiltCheckColorMatch(
     for (Index = 0; Index < Filter->NumberCriteria; Index++) {
         ThisApply = &ColorsToApply[Index];
 
-        if (ThisApply->Match.CollectFn != NULL &&
-            !ThisApply->Match.CollectFn(&CompareEntry, FileInfo, FilePath)) {
-
+        if (!YoriLibFileFiltCollectForCriteria(&ThisApply->Match, &Collected, &CompareEntry, FileInfo, FilePath)) {
             return FALSE;
         }
 
@@ -192,6 +192,61 @@ YoriLibCopyFileName(
 }
 
 
+/**
+ A prototype for a collection function which operates on a handle that has
+ already been opened to the file.  This allows several attributes to be
+ collected from a single open of the file.
+ */
+typedef BOOL (* YORI_LIB_FILE_FILT_COLLECT_HANDLE_FN)(PYORI_FILE_INFO, PWIN32_FIND_DATA, PYORI_STRING, HANDLE);
+
+/**
+ Open a file for attribute level access and invoke a collection function
+ that operates on the resulting handle.  If the file cannot be opened, the
+ collection function is still invoked with INVALID_HANDLE_VALUE, so that it
+ can populate the entry with default values.
+
+ @param Entry The directory entry to populate.
+
+ @param FindData The directory enumeration information.
+
+ @param FullPath Pointer to a string to the full file name.
+
+ @param DesiredAccess The access to request when opening the file.
+
+ @param CollectFn The collection function to invoke with the handle.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+YoriLibCollectWithAttributeHandle(
+    __inout PYORI_FILE_INFO Entry,
+    __in PWIN32_FIND_DATA FindData,
+    __in PYORI_STRING FullPath,
+    __in DWORD DesiredAccess,
+    __in YORI_LIB_FILE_FILT_COLLECT_HANDLE_FN CollectFn
+    )
+{
+    HANDLE hFile;
+    BOOL Result;
+
+    ASSERT(YoriLibIsStringNullTerminated(FullPath));
+
+    hFile = CreateFile(FullPath->StartOfString,
+                       DesiredAccess,
+                       FILE_SHARE_READ|FILE_SHARE_WRITE|FILE_SHARE_DELETE,
+                       NULL,
+                       OPEN_EXISTING,
+                       FILE_FLAG_BACKUP_SEMANTICS|FILE_FLAG_OPEN_REPARSE_POINT|FILE_FLAG_OPEN_NO_RECALL,
+                       NULL);
+
+    Result = CollectFn(Entry, FindData, FullPath, hFile);
+
+    if (hFile != INVALID_HANDLE_VALUE) {
+        CloseHandle(hFile);
+    }
+    return Result;
+}
+
 /**
  Collect information from a directory enumerate and full file name relating
  to the file's access time.
@@ -221,7 +276,7 @@ YoriLibCollectAccessTime (
 }
 
 /**
- Collect information from a directory enumerate and full file name relating
+ Collect information from a directory enumerate and file handle relating
  to the file's allocated range count.
 
  @param Entry The directory entry to populate.
@@ -230,30 +285,24 @@ YoriLibCollectAccessTime (
 
  @param FullPath Pointer to a string to the full file name.
 
+ @param hFile A handle to the file opened with the access this collection
+        requires, or INVALID_HANDLE_VALUE if the file could not be opened.
+
  @return TRUE to indicate success, FALSE to indicate failure.
  */
 BOOL
-YoriLibCollectAllocatedRangeCount (
+YoriLibCollectAllocatedRangeCountFromHandle (
     __inout PYORI_FILE_INFO Entry,
     __in PWIN32_FIND_DATA FindData,
-    __in PYORI_STRING FullPath
+    __in PYORI_STRING FullPath,
+    __in HANDLE hFile
     )
 {
-    HANDLE hFile;
-
     ASSERT(YoriLibIsStringNullTerminated(FullPath));
 
     Entry->AllocatedRangeCount.HighPart = 0;
     Entry->AllocatedRangeCount.LowPart = 0;
 
-    hFile = CreateFile(FullPath->StartOfString,
-                       FILE_READ_ATTRIBUTES|FILE_READ_DATA,
-                       FILE_SHARE_READ|FILE_SHARE_WRITE|FILE_SHARE_DELETE,
-                       NULL,
-                       OPEN_EXISTING,
-                       FILE_FLAG_BACKUP_SEMANTICS|FILE_FLAG_OPEN_REPARSE_POINT|FILE_FLAG_OPEN_NO_RECALL,
-                       NULL);
-
     if (hFile != INVALID_HANDLE_VALUE) {
 
         FILE_ALLOCATED_RANGE_BUFFER StartBuffer;
@@ -309,15 +358,13 @@ YoriLibCollectAllocatedRangeCount (
                 break;
             }
         }
-
-        CloseHandle(hFile);
     }
     return TRUE;
 }
 
 /**
  Collect information from a directory enumerate and full file name relating
- to the allocation size.
+ to the file's allocated range count.
 
  @param Entry The directory entry to populate.
 
@@ -328,37 +375,51 @@ YoriLibCollectAllocatedRangeCount (
  @return TRUE to indicate success, FALSE to indicate failure.
  */
 BOOL
-YoriLibCollectAllocationSize (
+YoriLibCollectAllocatedRangeCount (
     __inout PYORI_FILE_INFO Entry,
     __in PWIN32_FIND_DATA FindData,
     __in PYORI_STRING FullPath
     )
 {
-    BOOL RealAllocSize = FALSE;
+    return YoriLibCollectWithAttributeHandle(Entry, FindData, FullPath, FILE_READ_ATTRIBUTES|FILE_READ_DATA, YoriLibCollectAllocatedRangeCountFromHandle);
+}
 
-    ASSERT(YoriLibIsStringNullTerminated(FullPath));
+/**
+ Collect information from a directory enumerate and file handle relating
+ to the allocation size.  If the handle cannot return the allocation size,
+ it is estimated by rounding the file size up to the volume's cluster size.
+
+ @param Entry The directory entry to populate.
 
-    if (DllKernel32.pGetFileInformationByHandleEx) {
+ @param FindData The directory enumeration information.
 
-        HANDLE hFile;
+ @param FullPath Pointer to a string to the full file name.
 
-        hFile = CreateFile(FullPath->StartOfString,
-                           FILE_READ_ATTRIBUTES,
-                           FILE_SHARE_READ|FILE_SHARE_WRITE|FILE_SHARE_DELETE,
-                           NULL,
-                           OPEN_EXISTING,
-                           FILE_FLAG_BACKUP_SEMANTICS|FILE_FLAG_OPEN_REPARSE_POINT|FILE_FLAG_OPEN_NO_RECALL,
-                           NULL);
+ @param hFile A handle to the file opened with the access this collection
+        requires, or INVALID_HANDLE_VALUE if the file could not be opened.
 
-        if (hFile != INVALID_HANDLE_VALUE) {
-            FILE_STANDARD_INFO StandardInfo;
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+YoriLibCollectAllocationSizeFromHandle (
+    __inout PYORI_FILE_INFO Entry,
+    __in PWIN32_FIND_DATA FindData,
+    __in PYORI_STRING FullPath,
+    __in HANDLE hFile
+    )
+{
+    BOOL RealAllocSize = FALSE;
 
-            if (DllKernel32.pGetFileInformationByHandleEx(hFile, FileStandardInfo, &StandardInfo, sizeof(StandardInfo))) {
-                Entry->AllocationSize = StandardInfo.AllocationSize;
-                RealAllocSize = TRUE;
-            }
+    ASSERT(YoriLibIsStringNullTerminated(FullPath));
+
+    if (DllKernel32.pGetFileInformationByHandleEx &&
+        hFile != INVALID_HANDLE_VALUE) {
 
-            CloseHandle(hFile);
+        FILE_STANDARD_INFO StandardInfo;
+
+        if (DllKernel32.pGetFileInformationByHandleEx(hFile, FileStandardInfo, &StandardInfo, sizeof(StandardInfo))) {
+            Entry->AllocationSize = StandardInfo.AllocationSize;
+            RealAllocSize = TRUE;
         }
     }
 
@@ -416,6 +477,31 @@ YoriLibCollectAllocationSize (
     return TRUE;
 }
 
+/**
+ Collect information from a directory enumerate and full file name relating
+ to the allocation size.
+
+ @param Entry The directory entry to populate.
+
+ @param FindData The directory enumeration information.
+
+ @param FullPath Pointer to a string to the full file name.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+YoriLibCollectAllocationSize (
+    __inout PYORI_FILE_INFO Entry,
+    __in PWIN32_FIND_DATA FindData,
+    __in PYORI_STRING FullPath
+    )
+{
+    if (DllKernel32.pGetFileInformationByHandleEx == NULL) {
+        return YoriLibCollectAllocationSizeFromHandle(Entry, FindData, FullPath, INVALID_HANDLE_VALUE);
+    }
+    return YoriLibCollectWithAttributeHandle(Entry, FindData, FullPath, FILE_READ_ATTRIBUTES, YoriLibCollectAllocationSizeFromHandle);
+}
+
 /**
  Helper function to load an executable's PE header for parsing.  This is used
  by multiple collection functions whose data comes from a PE header.
@@ -494,14 +580,31 @@ YoriLibIsExecutableGui(
     )
 {
     YORILIB_PE_HEADERS PeHeaders;
+    FILETIME LastWriteTime;
+    BOOLEAN LastWriteTimeValid;
+    WORD Subsystem;
 
     ASSERT(YoriLibIsStringNullTerminated(FullPath));
 
-    if (YoriLibCapturePeHeaders(FullPath, &PeHeaders)) {
-        if (PeHeaders.OptionalHeader.Subsystem == IMAGE_SUBSYSTEM_WINDOWS_GUI) {
-            return TRUE;
+    //
+    //  Processes which launch the same program repeatedly can avoid
+    //  reading its headers each time by consulting the path cache.
+    //
+
+    if (!YoriLibPathCacheLookupSubsystem(FullPath, &LastWriteTime, &LastWriteTimeValid, &Subsystem)) {
+        Subsystem = 0;
+        if (YoriLibCapturePeHeaders(FullPath, &PeHeaders)) {
+            Subsystem = PeHeaders.OptionalHeader.Subsystem;
+        }
+
+        if (LastWriteTimeValid) {
+            YoriLibPathCacheInsertSubsystem(FullPath, &LastWriteTime, Subsystem);
         }
     }
+
+    if (Subsystem == IMAGE_SUBSYSTEM_WINDOWS_GUI) {
+        return TRUE;
+    }
     return FALSE;
 }
 
@@ -524,25 +627,24 @@ YoriLibCollectArch (
     __in PYORI_STRING FullPath
     )
 {
-    YORILIB_PE_HEADERS PeHeaders;
-
-    ASSERT(YoriLibIsStringNullTerminated(FullPath));
+    YORILIB_PE_METADATA Metadata;
 
     UNREFERENCED_PARAMETER(FindData);
+    ASSERT(YoriLibIsStringNullTerminated(FullPath));
 
-    Entry->OsVersionHigh = 0;
-    Entry->OsVersionLow = 0;
+    Entry->Architecture = 0;
 
-    if (YoriLibCapturePeHeaders(FullPath, &PeHeaders)) {
+    if (YoriLibGetPeMetadata(FullPath, &Metadata) &&
+        (Metadata.ValidFields & YORILIB_PE_METADATA_HEADERS) != 0) {
 
-        Entry->Architecture = PeHeaders.ImageHeader.Machine;
+        Entry->Architecture = Metadata.Architecture;
     }
 
     return TRUE;
 }
 
 /**
- Collect information from a directory enumerate and full file name relating
+ Collect information from a directory enumerate and file handle relating
  to the directory's case sensitivity status.
 
  @param Entry The directory entry to populate.
@@ -551,17 +653,19 @@ YoriLibCollectArch (
 
  @param FullPath Pointer to a string to the full file name.
 
+ @param hFile A handle to the file opened with the access this collection
+        requires, or INVALID_HANDLE_VALUE if the file could not be opened.
+
  @return TRUE to indicate success, FALSE to indicate failure.
  */
 BOOL
-YoriLibCollectCaseSensitivity (
+YoriLibCollectCaseSensitivityFromHandle (
     __inout PYORI_FILE_INFO Entry,
     __in PWIN32_FIND_DATA FindData,
-    __in PYORI_STRING FullPath
+    __in PYORI_STRING FullPath,
+    __in HANDLE hFile
     )
 {
-    HANDLE hFile;
-
     UNREFERENCED_PARAMETER(FindData);
     ASSERT(YoriLibIsStringNullTerminated(FullPath));
 
@@ -570,14 +674,6 @@ YoriLibCollectCaseSensitivity (
         return TRUE;
     }
 
-    hFile = CreateFile(FullPath->StartOfString,
-                       FILE_READ_ATTRIBUTES,
-                       FILE_SHARE_READ|FILE_SHARE_WRITE|FILE_SHARE_DELETE,
-                       NULL,
-                       OPEN_EXISTING,
-                       FILE_FLAG_BACKUP_SEMANTICS|FILE_FLAG_OPEN_REPARSE_POINT|FILE_FLAG_OPEN_NO_RECALL,
-                       NULL);
-
     if (hFile != INVALID_HANDLE_VALUE) {
 
         IO_STATUS_BLOCK IoStatusBlock;
@@ -588,16 +684,13 @@ YoriLibCollectCaseSensitivity (
                 Entry->CaseSensitive = TRUE;
             }
         }
-
-        CloseHandle(hFile);
     }
     return TRUE;
 }
 
-
 /**
  Collect information from a directory enumerate and full file name relating
- to the file's compression algorithm.
+ to the directory's case sensitivity status.
 
  @param Entry The directory entry to populate.
 
@@ -608,28 +701,47 @@ YoriLibCollectCaseSensitivity (
  @return TRUE to indicate success, FALSE to indicate failure.
  */
 BOOL
-YoriLibCollectCompressionAlgorithm (
+YoriLibCollectCaseSensitivity (
     __inout PYORI_FILE_INFO Entry,
     __in PWIN32_FIND_DATA FindData,
     __in PYORI_STRING FullPath
     )
 {
-    HANDLE hFile;
+    if (DllNtDll.pNtQueryInformationFile == NULL) {
+        return YoriLibCollectCaseSensitivityFromHandle(Entry, FindData, FullPath, INVALID_HANDLE_VALUE);
+    }
+    return YoriLibCollectWithAttributeHandle(Entry, FindData, FullPath, FILE_READ_ATTRIBUTES, YoriLibCollectCaseSensitivityFromHandle);
+}
+
+/**
+ Collect information from a directory enumerate and file handle relating
+ to the file's compression algorithm.
+
+ @param Entry The directory entry to populate.
+
+ @param FindData The directory enumeration information.
 
+ @param FullPath Pointer to a string to the full file name.
+
+ @param hFile A handle to the file opened with the access this collection
+        requires, or INVALID_HANDLE_VALUE if the file could not be opened.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+YoriLibCollectCompressionAlgorithmFromHandle (
+    __inout PYORI_FILE_INFO Entry,
+    __in PWIN32_FIND_DATA FindData,
+    __in PYORI_STRING FullPath,
+    __in HANDLE hFile
+    )
+{
     UNREFERENCED_PARAMETER(FindData);
 
     ASSERT(YoriLibIsStringNullTerminated(FullPath));
 
     Entry->CompressionAlgorithm = YoriLibCompressionNone;
 
-    hFile = CreateFile(FullPath->StartOfString,
-                       FILE_READ_ATTRIBUTES,
-                       FILE_SHARE_READ|FILE_SHARE_WRITE|FILE_SHARE_DELETE,
-                       NULL,
-                       OPEN_EXISTING,
-                       FILE_FLAG_BACKUP_SEMANTICS|FILE_FLAG_OPEN_REPARSE_POINT|FILE_FLAG_OPEN_NO_RECALL,
-                       NULL);
-
     if (hFile != INVALID_HANDLE_VALUE) {
 
         USHORT NtfsCompressionAlgorithm;
@@ -673,12 +785,32 @@ YoriLibCollectCompressionAlgorithm (
                 }
             }
         }
-
-        CloseHandle(hFile);
     }
     return TRUE;
 }
 
+/**
+ Collect information from a directory enumerate and full file name relating
+ to the file's compression algorithm.
+
+ @param Entry The directory entry to populate.
+
+ @param FindData The directory enumeration information.
+
+ @param FullPath Pointer to a string to the full file name.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+YoriLibCollectCompressionAlgorithm (
+    __inout PYORI_FILE_INFO Entry,
+    __in PWIN32_FIND_DATA FindData,
+    __in PYORI_STRING FullPath
+    )
+{
+    return YoriLibCollectWithAttributeHandle(Entry, FindData, FullPath, FILE_READ_ATTRIBUTES, YoriLibCollectCompressionAlgorithmFromHandle);
+}
+
 /**
  Collect information from a directory enumerate and full file name relating
  to the file's compression size.
@@ -761,56 +893,17 @@ YoriLibCollectDescription (
     __in PYORI_STRING FullPath
     )
 {
-    DWORD Junk;
-    PVOID Buffer;
-    YORI_ALLOC_SIZE_T VerSize;
-    PWORD TranslationBlock;
+    YORILIB_PE_METADATA Metadata;
 
     UNREFERENCED_PARAMETER(FindData);
     ASSERT(YoriLibIsStringNullTerminated(FullPath));
 
     Entry->Description[0] = '\0';
 
-    YoriLibLoadVersionFunctions();
-
-    if (DllVersion.pGetFileVersionInfoSizeW == NULL ||
-        DllVersion.pGetFileVersionInfoW == NULL ||
-        DllVersion.pVerQueryValueW == NULL) {
-
-        return TRUE;
+    if (YoriLibGetPeMetadata(FullPath, &Metadata)) {
+        YoriLibSPrintfS(Entry->Description, sizeof(Entry->Description)/sizeof(Entry->Description[0]), _T("%s"), Metadata.Description);
     }
 
-    VerSize = (YORI_ALLOC_SIZE_T)DllVersion.pGetFileVersionInfoSizeW(FullPath->StartOfString, &Junk);
-
-    Buffer = YoriLibMalloc(VerSize);
-    if (Buffer != NULL) {
-        if (DllVersion.pGetFileVersionInfoW(FullPath->StartOfString, 0, VerSize, Buffer)) {
-            TCHAR TranslationBlockString[sizeof("\\VarFileInfo\\Translation")];
-
-            //
-            //  Old versions of version.dll modify this buffer while parsing
-            //  it, so we need to give them a writable stack based copy
-            //
-
-            YoriLibSPrintf(TranslationBlockString, _T("\\VarFileInfo\\Translation"));
-            if (DllVersion.pVerQueryValueW(Buffer, TranslationBlockString, (PVOID*)&TranslationBlock, (PUINT)&Junk) && Junk >= 2 * sizeof(WORD)) {
-
-                TCHAR LanguageBlockToFind[sizeof("\\StringFileInfo\\01234567\\FileDescription")];
-                LPTSTR Description;
-
-                YoriLibSPrintf(LanguageBlockToFind, _T("\\StringFileInfo\\%04x%04x\\FileDescription"), TranslationBlock[0], TranslationBlock[1]);
-                if (DllVersion.pVerQueryValueW(Buffer, LanguageBlockToFind, (PVOID*)&Description, (PUINT)&Junk)) {
-                    DWORD BytesToCopy = Junk * sizeof(TCHAR);
-                    if (BytesToCopy > sizeof(Entry->Description) - sizeof(TCHAR)) {
-                        BytesToCopy = sizeof(Entry->Description) - sizeof(TCHAR);
-                    }
-                    memcpy(Entry->Description, Description, BytesToCopy);
-                    Entry->Description[BytesToCopy / sizeof(TCHAR)] = '\0';
-                }
-            }
-        }
-        YoriLibFree(Buffer);
-    }
     return TRUE;
 }
 
@@ -1009,7 +1102,7 @@ YoriLibCollectFileExtension (
 }
 
 /**
- Collect information from a directory enumerate and full file name relating
+ Collect information from a directory enumerate and file handle relating
  to the file's ID.
 
  @param Entry The directory entry to populate.
@@ -1018,30 +1111,24 @@ YoriLibCollectFileExtension (
 
  @param FullPath Pointer to a string to the full file name.
 
+ @param hFile A handle to the file opened with the access this collection
+        requires, or INVALID_HANDLE_VALUE if the file could not be opened.
+
  @return TRUE to indicate success, FALSE to indicate failure.
  */
 BOOL
-YoriLibCollectFileId (
+YoriLibCollectFileIdFromHandle (
     __inout PYORI_FILE_INFO Entry,
     __in PWIN32_FIND_DATA FindData,
-    __in PYORI_STRING FullPath
+    __in PYORI_STRING FullPath,
+    __in HANDLE hFile
     )
 {
-    HANDLE hFile;
-
     UNREFERENCED_PARAMETER(FindData);
     ASSERT(YoriLibIsStringNullTerminated(FullPath));
 
     Entry->FileId.QuadPart = 0;
 
-    hFile = CreateFile(FullPath->StartOfString,
-                       FILE_READ_ATTRIBUTES,
-                       FILE_SHARE_READ|FILE_SHARE_WRITE|FILE_SHARE_DELETE,
-                       NULL,
-                       OPEN_EXISTING,
-                       FILE_FLAG_BACKUP_SEMANTICS|FILE_FLAG_OPEN_REPARSE_POINT|FILE_FLAG_OPEN_NO_RECALL,
-                       NULL);
-
     if (hFile != INVALID_HANDLE_VALUE) {
         BY_HANDLE_FILE_INFORMATION FileInfo;
 
@@ -1049,15 +1136,13 @@ YoriLibCollectFileId (
             Entry->FileId.LowPart = FileInfo.nFileIndexLow;
             Entry->FileId.HighPart = FileInfo.nFileIndexHigh;
         }
-
-        CloseHandle(hFile);
     }
     return TRUE;
 }
 
 /**
  Collect information from a directory enumerate and full file name relating
- to the file's name.
+ to the file's ID.
 
  @param Entry The directory entry to populate.
 
@@ -1068,61 +1153,58 @@ YoriLibCollectFileId (
  @return TRUE to indicate success, FALSE to indicate failure.
  */
 BOOL
-YoriLibCollectFileName (
+YoriLibCollectFileId (
     __inout PYORI_FILE_INFO Entry,
     __in PWIN32_FIND_DATA FindData,
     __in PYORI_STRING FullPath
     )
 {
-    UNREFERENCED_PARAMETER(FullPath);
-
-    YoriLibCopyFileName(Entry->FileName, FindData->cFileName, MAX_PATH - 1, &Entry->FileNameLengthInChars);
-
-    Entry->Extension = _tcsrchr(Entry->FileName, '.');
-
-    //
-    //  For simplicity's sake, if we have no extension set the field
-    //  to the end of string, so we'll see a valid pointer of nothing.
-    //
-
-    if (Entry->Extension == NULL) {
-        Entry->Extension = Entry->FileName + Entry->FileNameLengthInChars;
-    } else {
-        Entry->Extension++;
-    }
-
-    return TRUE;
+    return YoriLibCollectWithAttributeHandle(Entry, FindData, FullPath, FILE_READ_ATTRIBUTES, YoriLibCollectFileIdFromHandle);
 }
 
 /**
- Collect information from a directory enumerate and full file name relating
- to the file's size.
+ Populate a directory entry from information that was returned in bulk by a
+ directory enumerate, avoiding the need to open the file.  This is only
+ possible for collection functions whose result is contained within the
+ extended find data.
 
  @param Entry The directory entry to populate.
 
- @param FindData The directory enumeration information.
+ @param FindDataEx The extended directory enumeration information.
 
- @param FullPath Pointer to a string to the full file name.
+ @param CollectFn The collection function that would otherwise be invoked
+        to populate the entry.
 
- @return TRUE to indicate success, FALSE to indicate failure.
+ @return TRUE to indicate the entry was populated and CollectFn need not be
+         invoked, FALSE if CollectFn must be invoked.
  */
 BOOL
-YoriLibCollectFileSize (
+YoriLibCollectFromFindDataExtended(
     __inout PYORI_FILE_INFO Entry,
-    __in PWIN32_FIND_DATA FindData,
-    __in PYORI_STRING FullPath
+    __in PYORILIB_FIND_DATA_EXTENDED FindDataEx,
+    __in YORI_LIB_FILE_FILT_COLLECT_FN CollectFn
     )
 {
-    UNREFERENCED_PARAMETER(FullPath);
+    if (CollectFn == YoriLibCollectFileId &&
+        (FindDataEx->ValidFields & YORILIB_FIND_DATA_VALID_FILE_ID) != 0) {
 
-    Entry->FileSize.LowPart = FindData->nFileSizeLow;
-    Entry->FileSize.HighPart = FindData->nFileSizeHigh;
-    return TRUE;
+        Entry->FileId.QuadPart = FindDataEx->FileId.QuadPart;
+        return TRUE;
+    }
+
+    if (CollectFn == YoriLibCollectAllocationSize &&
+        (FindDataEx->ValidFields & YORILIB_FIND_DATA_VALID_ALLOCATION_SIZE) != 0) {
+
+        Entry->AllocationSize.QuadPart = FindDataEx->AllocationSize.QuadPart;
+        return TRUE;
+    }
+
+    return FALSE;
 }
 
 /**
  Collect information from a directory enumerate and full file name relating
- to the executable's version resource's file version string.
+ to the file's name.
 
  @param Entry The directory entry to populate.
 
@@ -1133,68 +1215,61 @@ YoriLibCollectFileSize (
  @return TRUE to indicate success, FALSE to indicate failure.
  */
 BOOL
-YoriLibCollectFileVersionString (
+YoriLibCollectFileName (
     __inout PYORI_FILE_INFO Entry,
     __in PWIN32_FIND_DATA FindData,
     __in PYORI_STRING FullPath
     )
 {
-    DWORD Junk;
-    PVOID Buffer;
-    YORI_ALLOC_SIZE_T VerSize;
-    PWORD TranslationBlock;
-
-    UNREFERENCED_PARAMETER(FindData);
-    ASSERT(YoriLibIsStringNullTerminated(FullPath));
+    UNREFERENCED_PARAMETER(FullPath);
 
-    Entry->FileVersionString[0] = '\0';
+    YoriLibCopyFileName(Entry->FileName, FindData->cFileName, MAX_PATH - 1, &Entry->FileNameLengthInChars);
 
-    YoriLibLoadVersionFunctions();
+    Entry->Extension = _tcsrchr(Entry->FileName, '.');
 
-    if (DllVersion.pGetFileVersionInfoSizeW == NULL ||
-        DllVersion.pGetFileVersionInfoW == NULL ||
-        DllVersion.pVerQueryValueW == NULL) {
+    //
+    //  For simplicity's sake, if we have no extension set the field
+    //  to the end of string, so we'll see a valid pointer of nothing.
+    //
 
-        return TRUE;
+    if (Entry->Extension == NULL) {
+        Entry->Extension = Entry->FileName + Entry->FileNameLengthInChars;
+    } else {
+        Entry->Extension++;
     }
 
-    VerSize = (YORI_ALLOC_SIZE_T)DllVersion.pGetFileVersionInfoSizeW(FullPath->StartOfString, &Junk);
+    return TRUE;
+}
 
-    Buffer = YoriLibMalloc(VerSize);
-    if (Buffer != NULL) {
-        if (DllVersion.pGetFileVersionInfoW(FullPath->StartOfString, 0, VerSize, Buffer)) {
-            TCHAR TranslationBlockString[sizeof("\\VarFileInfo\\Translation")];
+/**
+ Collect information from a directory enumerate and full file name relating
+ to the file's size.
 
-            //
-            //  Old versions of version.dll modify this buffer while parsing
-            //  it, so we need to give them a writable stack based copy
-            //
+ @param Entry The directory entry to populate.
 
-            YoriLibSPrintf(TranslationBlockString, _T("\\VarFileInfo\\Translation"));
-            if (DllVersion.pVerQueryValueW(Buffer, TranslationBlockString, (PVOID*)&TranslationBlock, (PUINT)&Junk) && Junk >= 2 * sizeof(WORD)) {
+ @param FindData The directory enumeration information.
 
-                TCHAR LanguageBlockToFind[sizeof("\\StringFileInfo\\01234567\\FileVersion")];
-                LPTSTR FileVersionString;
+ @param FullPath Pointer to a string to the full file name.
 
-                YoriLibSPrintf(LanguageBlockToFind, _T("\\StringFileInfo\\%04x%04x\\FileVersion"), TranslationBlock[0], TranslationBlock[1]);
-                if (DllVersion.pVerQueryValueW(Buffer, LanguageBlockToFind, (PVOID*)&FileVersionString, (PUINT)&Junk)) {
-                    DWORD BytesToCopy = Junk * sizeof(TCHAR);
-                    if (BytesToCopy > sizeof(Entry->FileVersionString) - sizeof(TCHAR)) {
-                        BytesToCopy = sizeof(Entry->FileVersionString) - sizeof(TCHAR);
-                    }
-                    memcpy(Entry->FileVersionString, FileVersionString, BytesToCopy);
-                    Entry->FileVersionString[BytesToCopy / sizeof(TCHAR)] = '\0';
-                }
-            }
-        }
-        YoriLibFree(Buffer);
-    }
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+YoriLibCollectFileSize (
+    __inout PYORI_FILE_INFO Entry,
+    __in PWIN32_FIND_DATA FindData,
+    __in PYORI_STRING FullPath
+    )
+{
+    UNREFERENCED_PARAMETER(FullPath);
+
+    Entry->FileSize.LowPart = FindData->nFileSizeLow;
+    Entry->FileSize.HighPart = FindData->nFileSizeHigh;
     return TRUE;
 }
 
 /**
  Collect information from a directory enumerate and full file name relating
- to the file's fragment count.
+ to the executable's version resource's file version string.
 
  @param Entry The directory entry to populate.
 
@@ -1205,14 +1280,49 @@ YoriLibCollectFileVersionString (
  @return TRUE to indicate success, FALSE to indicate failure.
  */
 BOOL
-YoriLibCollectFragmentCount (
+YoriLibCollectFileVersionString (
     __inout PYORI_FILE_INFO Entry,
     __in PWIN32_FIND_DATA FindData,
     __in PYORI_STRING FullPath
     )
 {
-    HANDLE hFile;
+    YORILIB_PE_METADATA Metadata;
 
+    UNREFERENCED_PARAMETER(FindData);
+    ASSERT(YoriLibIsStringNullTerminated(FullPath));
+
+    Entry->FileVersionString[0] = '\0';
+
+    if (YoriLibGetPeMetadata(FullPath, &Metadata)) {
+        YoriLibSPrintfS(Entry->FileVersionString, sizeof(Entry->FileVersionString)/sizeof(Entry->FileVersionString[0]), _T("%s"), Metadata.FileVersionString);
+    }
+
+    return TRUE;
+}
+
+/**
+ Collect information from a directory enumerate and file handle relating
+ to the file's fragment count.
+
+ @param Entry The directory entry to populate.
+
+ @param FindData The directory enumeration information.
+
+ @param FullPath Pointer to a string to the full file name.
+
+ @param hFile A handle to the file opened with the access this collection
+        requires, or INVALID_HANDLE_VALUE if the file could not be opened.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+YoriLibCollectFragmentCountFromHandle (
+    __inout PYORI_FILE_INFO Entry,
+    __in PWIN32_FIND_DATA FindData,
+    __in PYORI_STRING FullPath,
+    __in HANDLE hFile
+    )
+{
     UNREFERENCED_PARAMETER(FindData);
 
     ASSERT(YoriLibIsStringNullTerminated(FullPath));
@@ -1220,14 +1330,6 @@ YoriLibCollectFragmentCount (
     Entry->FragmentCount.HighPart = 0;
     Entry->FragmentCount.LowPart = 0;
 
-    hFile = CreateFile(FullPath->StartOfString,
-                       FILE_READ_ATTRIBUTES,
-                       FILE_SHARE_READ|FILE_SHARE_WRITE|FILE_SHARE_DELETE,
-                       NULL,
-                       OPEN_EXISTING,
-                       FILE_FLAG_BACKUP_SEMANTICS|FILE_FLAG_OPEN_REPARSE_POINT|FILE_FLAG_OPEN_NO_RECALL,
-                       NULL);
-
     if (hFile != INVALID_HANDLE_VALUE) {
 
         STARTING_VCN_INPUT_BUFFER StartBuffer;
@@ -1281,15 +1383,13 @@ YoriLibCollectFragmentCount (
 
             StartBuffer.StartingVcn.QuadPart = u.Extents.Extents[u.Extents.ExtentCount - 1].NextVcn.QuadPart;
         }
-
-        CloseHandle(hFile);
     }
     return TRUE;
 }
 
 /**
  Collect information from a directory enumerate and full file name relating
- to the file's link count.
+ to the file's fragment count.
 
  @param Entry The directory entry to populate.
 
@@ -1300,42 +1400,56 @@ YoriLibCollectFragmentCount (
  @return TRUE to indicate success, FALSE to indicate failure.
  */
 BOOL
-YoriLibCollectLinkCount (
+YoriLibCollectFragmentCount (
     __inout PYORI_FILE_INFO Entry,
     __in PWIN32_FIND_DATA FindData,
     __in PYORI_STRING FullPath
     )
 {
-    HANDLE hFile;
+    return YoriLibCollectWithAttributeHandle(Entry, FindData, FullPath, FILE_READ_ATTRIBUTES, YoriLibCollectFragmentCountFromHandle);
+}
+
+/**
+ Collect information from a directory enumerate and file handle relating
+ to the file's link count.
+
+ @param Entry The directory entry to populate.
+
+ @param FindData The directory enumeration information.
+
+ @param FullPath Pointer to a string to the full file name.
+
+ @param hFile A handle to the file opened with the access this collection
+        requires, or INVALID_HANDLE_VALUE if the file could not be opened.
 
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+YoriLibCollectLinkCountFromHandle (
+    __inout PYORI_FILE_INFO Entry,
+    __in PWIN32_FIND_DATA FindData,
+    __in PYORI_STRING FullPath,
+    __in HANDLE hFile
+    )
+{
     UNREFERENCED_PARAMETER(FindData);
     ASSERT(YoriLibIsStringNullTerminated(FullPath));
 
     Entry->LinkCount = 0;
 
-    hFile = CreateFile(FullPath->StartOfString,
-                       FILE_READ_ATTRIBUTES,
-                       FILE_SHARE_READ|FILE_SHARE_WRITE|FILE_SHARE_DELETE,
-                       NULL,
-                       OPEN_EXISTING,
-                       FILE_FLAG_BACKUP_SEMANTICS|FILE_FLAG_OPEN_REPARSE_POINT|FILE_FLAG_OPEN_NO_RECALL,
-                       NULL);
-
     if (hFile != INVALID_HANDLE_VALUE) {
         BY_HANDLE_FILE_INFORMATION FileInfo;
 
         if (GetFileInformationByHandle(hFile, &FileInfo)) {
             Entry->LinkCount = FileInfo.nNumberOfLinks;
         }
-
-        CloseHandle(hFile);
     }
     return TRUE;
 }
 
 /**
  Collect information from a directory enumerate and full file name relating
- to the file's object ID.
+ to the file's link count.
 
  @param Entry The directory entry to populate.
 
@@ -1346,13 +1460,38 @@ YoriLibCollectLinkCount (
  @return TRUE to indicate success, FALSE to indicate failure.
  */
 BOOL
-YoriLibCollectObjectId (
+YoriLibCollectLinkCount (
     __inout PYORI_FILE_INFO Entry,
     __in PWIN32_FIND_DATA FindData,
     __in PYORI_STRING FullPath
     )
 {
-    HANDLE hFile;
+    return YoriLibCollectWithAttributeHandle(Entry, FindData, FullPath, FILE_READ_ATTRIBUTES, YoriLibCollectLinkCountFromHandle);
+}
+
+/**
+ Collect information from a directory enumerate and file handle relating
+ to the file's object ID.
+
+ @param Entry The directory entry to populate.
+
+ @param FindData The directory enumeration information.
+
+ @param FullPath Pointer to a string to the full file name.
+
+ @param hFile A handle to the file opened with the access this collection
+        requires, or INVALID_HANDLE_VALUE if the file could not be opened.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+YoriLibCollectObjectIdFromHandle (
+    __inout PYORI_FILE_INFO Entry,
+    __in PWIN32_FIND_DATA FindData,
+    __in PYORI_STRING FullPath,
+    __in HANDLE hFile
+    )
+{
     FILE_OBJECTID_BUFFER Buffer;
     DWORD BytesReturned;
 
@@ -1361,23 +1500,36 @@ YoriLibCollectObjectId (
 
     ZeroMemory(&Entry->ObjectId, sizeof(Entry->ObjectId));
 
-    hFile = CreateFile(FullPath->StartOfString,
-                       FILE_READ_ATTRIBUTES,
-                       FILE_SHARE_READ|FILE_SHARE_WRITE|FILE_SHARE_DELETE,
-                       NULL,
-                       OPEN_EXISTING,
-                       FILE_FLAG_BACKUP_SEMANTICS|FILE_FLAG_OPEN_REPARSE_POINT|FILE_FLAG_OPEN_NO_RECALL,
-                       NULL);
-
     if (hFile != INVALID_HANDLE_VALUE) {
         if (DeviceIoControl(hFile, FSCTL_GET_OBJECT_ID, NULL, 0, &Buffer, sizeof(Buffer), &BytesReturned, NULL)) {
             memcpy(&Entry->ObjectId, &Buffer.ObjectId, sizeof(Buffer.ObjectId));
         }
-        CloseHandle(hFile);
     }
     return TRUE;
 }
 
+/**
+ Collect information from a directory enumerate and full file name relating
+ to the file's object ID.
+
+ @param Entry The directory entry to populate.
+
+ @param FindData The directory enumeration information.
+
+ @param FullPath Pointer to a string to the full file name.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+YoriLibCollectObjectId (
+    __inout PYORI_FILE_INFO Entry,
+    __in PWIN32_FIND_DATA FindData,
+    __in PYORI_STRING FullPath
+    )
+{
+    return YoriLibCollectWithAttributeHandle(Entry, FindData, FullPath, FILE_READ_ATTRIBUTES, YoriLibCollectObjectIdFromHandle);
+}
+
 /**
  Collect information from a directory enumerate and full file name relating
  to the executable's minimum OS version.
@@ -1397,7 +1549,7 @@ YoriLibCollectOsVersion (
     __in PYORI_STRING FullPath
     )
 {
-    YORILIB_PE_HEADERS PeHeaders;
+    YORILIB_PE_METADATA Metadata;
 
     UNREFERENCED_PARAMETER(FindData);
     ASSERT(YoriLibIsStringNullTerminated(FullPath));
@@ -1405,10 +1557,11 @@ YoriLibCollectOsVersion (
     Entry->OsVersionHigh = 0;
     Entry->OsVersionLow = 0;
 
-    if (YoriLibCapturePeHeaders(FullPath, &PeHeaders)) {
+    if (YoriLibGetPeMetadata(FullPath, &Metadata) &&
+        (Metadata.ValidFields & YORILIB_PE_METADATA_HEADERS) != 0) {
 
-        Entry->OsVersionHigh = PeHeaders.OptionalHeader.MajorSubsystemVersion;
-        Entry->OsVersionLow = PeHeaders.OptionalHeader.MinorSubsystemVersion;
+        Entry->OsVersionHigh = Metadata.OsVersionHigh;
+        Entry->OsVersionLow = Metadata.OsVersionLow;
     }
 
     return TRUE;
@@ -1563,16 +1716,17 @@ YoriLibCollectSubsystem (
     __in PYORI_STRING FullPath
     )
 {
-    YORILIB_PE_HEADERS PeHeaders;
+    YORILIB_PE_METADATA Metadata;
 
     UNREFERENCED_PARAMETER(FindData);
     ASSERT(YoriLibIsStringNullTerminated(FullPath));
 
     Entry->Subsystem = 0;
 
-    if (YoriLibCapturePeHeaders(FullPath, &PeHeaders)) {
+    if (YoriLibGetPeMetadata(FullPath, &Metadata) &&
+        (Metadata.ValidFields & YORILIB_PE_METADATA_HEADERS) != 0) {
 
-        Entry->Subsystem = PeHeaders.OptionalHeader.Subsystem;
+        Entry->Subsystem = Metadata.Subsystem;
     }
 
     return TRUE;
@@ -1625,7 +1779,7 @@ YoriLibCollectStreamCount (
 }
 
 /**
- Collect information from a directory enumerate and full file name relating
+ Collect information from a directory enumerate and file handle relating
  to the file's USN.
 
  @param Entry The directory entry to populate.
@@ -1634,28 +1788,23 @@ YoriLibCollectStreamCount (
 
  @param FullPath Pointer to a string to the full file name.
 
+ @param hFile A handle to the file opened with the access this collection
+        requires, or INVALID_HANDLE_VALUE if the file could not be opened.
+
  @return TRUE to indicate success, FALSE to indicate failure.
  */
 BOOL
-YoriLibCollectUsn (
+YoriLibCollectUsnFromHandle (
     __inout PYORI_FILE_INFO Entry,
     __in PWIN32_FIND_DATA FindData,
-    __in PYORI_STRING FullPath
+    __in PYORI_STRING FullPath,
+    __in HANDLE hFile
     )
 {
-    HANDLE hFile;
-
     UNREFERENCED_PARAMETER(FindData);
     ASSERT(YoriLibIsStringNullTerminated(FullPath));
 
     Entry->Usn.QuadPart = 0;
-    hFile = CreateFile(FullPath->StartOfString,
-                       FILE_READ_ATTRIBUTES,
-                       FILE_SHARE_READ|FILE_SHARE_WRITE|FILE_SHARE_DELETE,
-                       NULL,
-                       OPEN_EXISTING,
-                       FILE_FLAG_BACKUP_SEMANTICS|FILE_FLAG_OPEN_REPARSE_POINT|FILE_FLAG_OPEN_NO_RECALL,
-                       NULL);
 
     if (hFile != INVALID_HANDLE_VALUE) {
 
@@ -1668,12 +1817,32 @@ YoriLibCollectUsn (
         if (DeviceIoControl(hFile, FSCTL_READ_FILE_USN_DATA, NULL, 0, &s1, sizeof(s1), &BytesReturned, NULL)) {
             Entry->Usn.QuadPart = s1.UsnRecord.Usn;
         }
-
-        CloseHandle(hFile);
     }
     return TRUE;
 }
 
+/**
+ Collect information from a directory enumerate and full file name relating
+ to the file's USN.
+
+ @param Entry The directory entry to populate.
+
+ @param FindData The directory enumeration information.
+
+ @param FullPath Pointer to a string to the full file name.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+YoriLibCollectUsn (
+    __inout PYORI_FILE_INFO Entry,
+    __in PWIN32_FIND_DATA FindData,
+    __in PYORI_STRING FullPath
+    )
+{
+    return YoriLibCollectWithAttributeHandle(Entry, FindData, FullPath, FILE_READ_ATTRIBUTES, YoriLibCollectUsnFromHandle);
+}
+
 /**
  Collect information from a directory enumerate and full file name relating
  to the executable's version resource.
@@ -1693,10 +1862,7 @@ YoriLibCollectVersion (
     __in PYORI_STRING FullPath
     )
 {
-    DWORD Junk;
-    PVOID Buffer;
-    YORI_ALLOC_SIZE_T VerSize;
-    VS_FIXEDFILEINFO * RootBlock;
+    YORILIB_PE_METADATA Metadata;
 
     UNREFERENCED_PARAMETER(FindData);
     ASSERT(YoriLibIsStringNullTerminated(FullPath));
@@ -1704,36 +1870,13 @@ YoriLibCollectVersion (
     Entry->FileVersion.QuadPart = 0;
     Entry->FileVersionFlags = 0;
 
-    YoriLibLoadVersionFunctions();
+    if (YoriLibGetPeMetadata(FullPath, &Metadata) &&
+        (Metadata.ValidFields & YORILIB_PE_METADATA_VERSION) != 0) {
 
-    if (DllVersion.pGetFileVersionInfoSizeW == NULL ||
-        DllVersion.pGetFileVersionInfoW == NULL ||
-        DllVersion.pVerQueryValueW == NULL) {
-
-        return TRUE;
+        Entry->FileVersion.QuadPart = Metadata.FileVersion.QuadPart;
+        Entry->FileVersionFlags = Metadata.FileVersionFlags;
     }
 
-    VerSize = (YORI_ALLOC_SIZE_T)DllVersion.pGetFileVersionInfoSizeW(FullPath->StartOfString, &Junk);
-
-    Buffer = YoriLibMalloc(VerSize);
-    if (Buffer != NULL) {
-        if (DllVersion.pGetFileVersionInfoW(FullPath->StartOfString, 0, VerSize, Buffer)) {
-            TCHAR BlockString[sizeof("\\")];
-
-            //
-            //  Old versions of version.dll modify this buffer while parsing
-            //  it, so we need to give them a writable stack based copy
-            //
-
-            YoriLibSPrintf(BlockString, _T("\\"));
-            if (DllVersion.pVerQueryValueW(Buffer, BlockString, (PVOID*)&RootBlock, (PUINT)&Junk)) {
-                Entry->FileVersion.HighPart = RootBlock->dwFileVersionMS;
-                Entry->FileVersion.LowPart = RootBlock->dwFileVersionLS;
-                Entry->FileVersionFlags = RootBlock->dwFileFlags & RootBlock->dwFileFlagsMask;
-            }
-        }
-        YoriLibFree(Buffer);
-    }
     return TRUE;
 }
 
@@ -1765,6 +1908,242 @@ YoriLibCollectWriteTime(
     return TRUE;
 }
 
+/**
+ A table of collection functions which populate an entry purely from the
+ directory enumeration information and never need to open the file.
+ */
+const YORI_LIB_FILE_FILT_COLLECT_FN
+YoriLibFindDataCollectFns[] = {
+    YoriLibCollectAccessTime,
+    YoriLibCollectCreateTime,
+    YoriLibCollectFileAttributes,
+    YoriLibCollectFileExtension,
+    YoriLibCollectFileName,
+    YoriLibCollectFileSize,
+    YoriLibCollectReparseTag,
+    YoriLibCollectShortName,
+    YoriLibCollectWriteTime,
+};
+
+/**
+ Describes a collection function which can operate on a handle to the file
+ that is shared with other collection functions.
+ */
+typedef struct _YORI_LIB_FILE_HANDLE_COLLECTOR {
+
+    /**
+     The collection function that opens a handle of its own.
+     */
+    YORI_LIB_FILE_FILT_COLLECT_FN CollectFn;
+
+    /**
+     The equivalent collection function that operates on an existing handle.
+     */
+    YORI_LIB_FILE_FILT_COLLECT_HANDLE_FN HandleFn;
+
+    /**
+     The access that the handle needs to be opened with.
+     */
+    DWORD DesiredAccess;
+} YORI_LIB_FILE_HANDLE_COLLECTOR, *PYORI_LIB_FILE_HANDLE_COLLECTOR;
+
+/**
+ Pointer to a constant handle collector.
+ */
+typedef YORI_LIB_FILE_HANDLE_COLLECTOR CONST *PCYORI_LIB_FILE_HANDLE_COLLECTOR;
+
+/**
+ A table of collection functions which can share a single handle to the file.
+ */
+const YORI_LIB_FILE_HANDLE_COLLECTOR
+YoriLibFileHandleCollectors[] = {
+    {YoriLibCollectAllocatedRangeCount,  YoriLibCollectAllocatedRangeCountFromHandle,  FILE_READ_ATTRIBUTES|FILE_READ_DATA},
+    {YoriLibCollectAllocationSize,       YoriLibCollectAllocationSizeFromHandle,       FILE_READ_ATTRIBUTES},
+    {YoriLibCollectCaseSensitivity,      YoriLibCollectCaseSensitivityFromHandle,      FILE_READ_ATTRIBUTES},
+    {YoriLibCollectCompressionAlgorithm, YoriLibCollectCompressionAlgorithmFromHandle, FILE_READ_ATTRIBUTES},
+    {YoriLibCollectFileId,               YoriLibCollectFileIdFromHandle,               FILE_READ_ATTRIBUTES},
+    {YoriLibCollectFragmentCount,        YoriLibCollectFragmentCountFromHandle,        FILE_READ_ATTRIBUTES},
+    {YoriLibCollectLinkCount,            YoriLibCollectLinkCountFromHandle,            FILE_READ_ATTRIBUTES},
+    {YoriLibCollectObjectId,             YoriLibCollectObjectIdFromHandle,             FILE_READ_ATTRIBUTES},
+    {YoriLibCollectUsn,                  YoriLibCollectUsnFromHandle,                  FILE_READ_ATTRIBUTES},
+};
+
+/**
+ Returns TRUE if the collection function populates the entry purely from
+ directory enumeration information, meaning it never opens the file.
+
+ @param CollectFn The collection function to check.
+
+ @return TRUE if the collection function operates on enumeration data only,
+         FALSE if it may open the file.
+ */
+BOOL
+YoriLibIsCollectFnFromFindData(
+    __in YORI_LIB_FILE_FILT_COLLECT_FN CollectFn
+    )
+{
+    YORI_ALLOC_SIZE_T Index;
+
+    for (Index = 0; Index < sizeof(YoriLibFindDataCollectFns)/sizeof(YoriLibFindDataCollectFns[0]); Index++) {
+        if (YoriLibFindDataCollectFns[Index] == CollectFn) {
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+/**
+ Find the handle based equivalent of a collection function.
+
+ @param CollectFn The collection function to find.
+
+ @return Pointer to the handle collector, or NULL if the collection function
+         cannot operate on a shared handle.
+ */
+PCYORI_LIB_FILE_HANDLE_COLLECTOR
+YoriLibFindFileHandleCollector(
+    __in YORI_LIB_FILE_FILT_COLLECT_FN CollectFn
+    )
+{
+    YORI_ALLOC_SIZE_T Index;
+
+    for (Index = 0; Index < sizeof(YoriLibFileHandleCollectors)/sizeof(YoriLibFileHandleCollectors[0]); Index++) {
+        if (YoriLibFileHandleCollectors[Index].CollectFn == CollectFn) {
+            return &YoriLibFileHandleCollectors[Index];
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ Populate a directory entry by invoking a set of collection functions.  This
+ is equivalent to invoking each collection function in turn, except that
+ information already present in the extended find data is used directly,
+ repeated collection functions are only invoked once, and all collection
+ functions that query an open handle share a single open of the file.
+
+ @param Entry The directory entry to populate.
+
+ @param FindData The directory enumeration information.
+
+ @param FindDataEx Optionally points to extended directory enumeration
+        information.  If supplied, FindData must point to its FindData
+        member.
+
+ @param FullPath Pointer to a string to the full file name.
+
+ @param CollectFns Pointer to an array of collection functions to invoke.
+
+ @param CollectFnCount The number of elements in the CollectFns array.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+YoriLibCollectFileInfoSet(
+    __inout PYORI_FILE_INFO Entry,
+    __in PWIN32_FIND_DATA FindData,
+    __in_opt PYORILIB_FIND_DATA_EXTENDED FindDataEx,
+    __in PYORI_STRING FullPath,
+    __in_ecount(CollectFnCount) YORI_LIB_FILE_FILT_COLLECT_FN * CollectFns,
+    __in YORI_ALLOC_SIZE_T CollectFnCount
+    )
+{
+    YORI_ALLOC_SIZE_T Index;
+    YORI_ALLOC_SIZE_T Prior;
+    YORI_LIB_FILE_FILT_COLLECT_FN CollectFn;
+    PCYORI_LIB_FILE_HANDLE_COLLECTOR Collector;
+    DWORD DesiredAccess;
+    HANDLE hFile;
+    BOOL HandleOpened;
+    BOOL Result;
+
+    ASSERT(YoriLibIsStringNullTerminated(FullPath));
+
+    hFile = INVALID_HANDLE_VALUE;
+    HandleOpened = FALSE;
+    Result = TRUE;
+
+    for (Index = 0; Index < CollectFnCount; Index++) {
+        CollectFn = CollectFns[Index];
+
+        for (Prior = 0; Prior < Index; Prior++) {
+            if (CollectFns[Prior] == CollectFn) {
+                break;
+            }
+        }
+
+        if (Prior < Index) {
+            continue;
+        }
+
+        if (FindDataEx != NULL &&
+            YoriLibCollectFromFindDataExtended(Entry, FindDataEx, CollectFn)) {
+
+            continue;
+        }
+
+        Collector = YoriLibFindFileHandleCollector(CollectFn);
+        if (Collector == NULL) {
+            if (!CollectFn(Entry, FindData, FullPath)) {
+                Result = FALSE;
+            }
+            continue;
+        }
+
+        //
+        //  On the first collection function that needs a handle, open the
+        //  file once with the union of the access that any of them need.
+        //  If that fails, fall back to attribute access, which is all most
+        //  of them need.
+        //
+
+        if (!HandleOpened) {
+            YORI_ALLOC_SIZE_T Remaining;
+            PCYORI_LIB_FILE_HANDLE_COLLECTOR OtherCollector;
+
+            DesiredAccess = 0;
+            for (Remaining = Index; Remaining < CollectFnCount; Remaining++) {
+                OtherCollector = YoriLibFindFileHandleCollector(CollectFns[Remaining]);
+                if (OtherCollector != NULL) {
+                    DesiredAccess = DesiredAccess | OtherCollector->DesiredAccess;
+                }
+            }
+
+            hFile = CreateFile(FullPath->StartOfString,
+                               DesiredAccess,
+                               FILE_SHARE_READ|FILE_SHARE_WRITE|FILE_SHARE_DELETE,
+                               NULL,
+                               OPEN_EXISTING,
+                               FILE_FLAG_BACKUP_SEMANTICS|FILE_FLAG_OPEN_REPARSE_POINT|FILE_FLAG_OPEN_NO_RECALL,
+                               NULL);
+
+            if (hFile == INVALID_HANDLE_VALUE && DesiredAccess != FILE_READ_ATTRIBUTES) {
+                hFile = CreateFile(FullPath->StartOfString,
+                                   FILE_READ_ATTRIBUTES,
+                                   FILE_SHARE_READ|FILE_SHARE_WRITE|FILE_SHARE_DELETE,
+                                   NULL,
+                                   OPEN_EXISTING,
+                                   FILE_FLAG_BACKUP_SEMANTICS|FILE_FLAG_OPEN_REPARSE_POINT|FILE_FLAG_OPEN_NO_RECALL,
+                                   NULL);
+            }
+
+            HandleOpened = TRUE;
+        }
+
+        if (!Collector->HandleFn(Entry, FindData, FullPath, hFile)) {
+            Result = FALSE;
+        }
+    }
+
+    if (hFile != INVALID_HANDLE_VALUE) {
+        CloseHandle(hFile);
+    }
+
+    return Result;
+}
+
 //
 //  Sorting support
 //
@@ -0,0 +1,479 @@
+/**
+ * @file lib/fiqueue.c
+ *
+ * Collect information about files on a pool of worker threads
+ *
+ * This module allows a caller that is enumerating files to submit each file
+ * for collection of a set of attributes.  Collection occurs on worker
+ * threads while the caller continues enumerating, and the results are
+ * returned to the caller on its own thread in the order that files were
+ * submitted.
+ *
+ * Copyright (c) 2026 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "yoripch.h"
+#include "yorilib.h"
+
+/**
+ The maximum number of threads to use for collecting file information.
+ */
+#define YORILIB_FILE_INFO_QUEUE_MAX_THREADS (16)
+
+/**
+ The number of files that can be queued for each worker thread.  This allows
+ the caller to continue enumerating while workers are busy, and allows
+ workers to continue while the caller is waiting on a slow file to complete
+ so it can be returned in order.
+ */
+#define YORILIB_FILE_INFO_QUEUE_ITEMS_PER_THREAD (8)
+
+/**
+ A single file that has been submitted for collection.
+ */
+typedef struct _YORILIB_FILE_INFO_QUEUE_ITEM {
+
+    /**
+     The work queue item for this file.
+     */
+    YORILIB_WORK_ITEM WorkItem;
+
+    /**
+     The link for this item within the list of items available for reuse.
+     */
+    YORI_LIST_ENTRY FreeListEntry;
+
+    /**
+     The collected information about the file.
+     */
+    YORI_FILE_INFO Entry;
+
+    /**
+     The directory enumeration information for the file.  If the caller
+     did not provide extended information, only the FindData member is
+     valid.
+     */
+    YORILIB_FIND_DATA_EXTENDED FindDataEx;
+
+    /**
+     A full path to the file.  This allocation is reused for later files
+     submitted into the same item.
+     */
+    YORI_STRING FullPath;
+
+    /**
+     TRUE if the caller supplied extended directory enumeration information.
+     */
+    BOOLEAN FindDataExValid;
+
+} YORILIB_FILE_INFO_QUEUE_ITEM, *PYORILIB_FILE_INFO_QUEUE_ITEM;
+
+/**
+ State for a pool of threads collecting file information.
+ */
+typedef struct _YORILIB_FILE_INFO_QUEUE {
+
+    /**
+     The work queue which collects information on worker threads and
+     returns files in the order they were submitted.
+     */
+    PYORILIB_WORK_QUEUE WorkQueue;
+
+    /**
+     The number of elements in the Items array.  This is the maximum number
+     of files that can be submitted and not yet returned to the caller.
+     */
+    DWORD ItemCount;
+
+    /**
+     An array of items.  Each is either on FreeList or submitted to the work
+     queue.
+     */
+    PYORILIB_FILE_INFO_QUEUE_ITEM Items;
+
+    /**
+     A list of items which are not currently submitted.  This is only
+     accessed by the thread submitting files.
+     */
+    YORI_LIST_ENTRY FreeList;
+
+    /**
+     The number of elements in the CollectFns array.
+     */
+    YORI_ALLOC_SIZE_T CollectFnCount;
+
+    /**
+     An array of collection functions to invoke for each file.
+     */
+    YORI_LIB_FILE_FILT_COLLECT_FN * CollectFns;
+
+    /**
+     The function to invoke on the caller's thread as each file is
+     complete.
+     */
+    PYORILIB_FILE_INFO_QUEUE_COMPLETE_FN CompleteFn;
+
+    /**
+     Caller provided context to pass to CompleteFn.
+     */
+    PVOID Context;
+
+    /**
+     Set to TRUE when the queue is being destroyed, so any files not yet
+     returned to the caller are discarded.
+     */
+    BOOLEAN Discard;
+
+} YORILIB_FILE_INFO_QUEUE;
+
+/**
+ Collect information for a submitted file.
+
+ @param Queue Pointer to the queue.
+
+ @param Item Pointer to the file.
+ */
+VOID
+YoriLibFileInfoQueueCollect(
+    __in PYORILIB_FILE_INFO_QUEUE Queue,
+    __in PYORILIB_FILE_INFO_QUEUE_ITEM Item
+    )
+{
+    PYORILIB_FIND_DATA_EXTENDED FindDataEx;
+
+    FindDataEx = NULL;
+    if (Item->FindDataExValid) {
+        FindDataEx = &Item->FindDataEx;
+    }
+
+    ZeroMemory(&Item->Entry, sizeof(Item->Entry));
+    YoriLibCollectFileInfoSet(&Item->Entry, &Item->FindDataEx.FindData, FindDataEx, &Item->FullPath, Queue->CollectFns, Queue->CollectFnCount);
+}
+
+/**
+ Collect information for a submitted file on a worker thread.
+
+ @param Context Pointer to the queue.
+
+ @param WorkerContext Unused.
+
+ @param WorkItem Pointer to the work item within the file's item.
+
+ @return TRUE to indicate the worker can process further files.
+ */
+BOOLEAN
+YoriLibFileInfoQueueExecute(
+    __in PVOID Context,
+    __in PVOID WorkerContext,
+    __in PYORILIB_WORK_ITEM WorkItem
+    )
+{
+    PYORILIB_FILE_INFO_QUEUE_ITEM Item;
+
+    UNREFERENCED_PARAMETER(WorkerContext);
+
+    Item = CONTAINING_RECORD(WorkItem, YORILIB_FILE_INFO_QUEUE_ITEM, WorkItem);
+    YoriLibFileInfoQueueCollect((PYORILIB_FILE_INFO_QUEUE)Context, Item);
+    return TRUE;
+}
+
+/**
+ Return a completed file to the caller and make its item available for
+ reuse.  This is invoked on the thread submitting files, in the order that
+ files were submitted.
+
+ @param Context Pointer to the queue.
+
+ @param WorkItem Pointer to the work item within the file's item.
+ */
+VOID
+YoriLibFileInfoQueueComplete(
+    __in PVOID Context,
+    __in PYORILIB_WORK_ITEM WorkItem
+    )
+{
+    PYORILIB_FILE_INFO_QUEUE Queue;
+    PYORILIB_FILE_INFO_QUEUE_ITEM Item;
+
+    Queue = (PYORILIB_FILE_INFO_QUEUE)Context;
+    Item = CONTAINING_RECORD(WorkItem, YORILIB_FILE_INFO_QUEUE_ITEM, WorkItem);
+
+    if (!Queue->Discard) {
+
+        //
+        //  If no workers are running, collect the information here.
+        //
+
+        if (!WorkItem->Executed) {
+            YoriLibFileInfoQueueCollect(Queue, Item);
+        }
+
+        Queue->CompleteFn(&Item->Entry, &Item->FindDataEx.FindData, &Item->FullPath, Queue->Context);
+    }
+
+    YoriLibAppendList(&Queue->FreeList, &Item->FreeListEntry);
+}
+
+/**
+ Wait for all worker threads to terminate and free all state associated with
+ a queue.  Any files which have been submitted and not returned to the caller
+ are discarded.
+
+ @param Queue Pointer to the queue.
+ */
+VOID
+YoriLibFileInfoQueueDestroy(
+    __in PYORILIB_FILE_INFO_QUEUE Queue
+    )
+{
+    DWORD Index;
+
+    if (Queue->WorkQueue != NULL) {
+        Queue->Discard = TRUE;
+        YoriLibWorkQueueDestroy(Queue->WorkQueue);
+        Queue->WorkQueue = NULL;
+    }
+
+    if (Queue->Items != NULL) {
+        for (Index = 0; Index < Queue->ItemCount; Index++) {
+            YoriLibFreeStringContents(&Queue->Items[Index].FullPath);
+        }
+        YoriLibFree(Queue->Items);
+    }
+
+    YoriLibFree(Queue);
+}
+
+/**
+ Create a pool of threads to collect a set of information about files as
+ they are submitted.
+
+ @param CollectFns Pointer to an array of collection functions to invoke
+        for each file.  This array is copied and need not remain valid
+        after this function returns.
+
+ @param CollectFnCount The number of elements in the CollectFns array.
+
+ @param CompleteFn The function to invoke, on the thread submitting files,
+        with the collected information for each file.  Files are returned
+        in the order that they are submitted.
+
+ @param Context Caller provided context to pass to CompleteFn.
+
+ @return Pointer to the queue, or NULL if a queue could not be created.
+         NULL is also returned if every collection function operates on
+         directory enumeration information alone, since there is no benefit
+         to collecting that on other threads.  Callers are expected to
+         collect information synchronously if NULL is returned.
+ */
+PYORILIB_FILE_INFO_QUEUE
+YoriLibFileInfoQueueCreate(
+    __in_ecount(CollectFnCount) YORI_LIB_FILE_FILT_COLLECT_FN * CollectFns,
+    __in YORI_ALLOC_SIZE_T CollectFnCount,
+    __in PYORILIB_FILE_INFO_QUEUE_COMPLETE_FN CompleteFn,
+    __in_opt PVOID Context
+    )
+{
+    PYORILIB_FILE_INFO_QUEUE Queue;
+    SYSTEM_INFO SystemInfo;
+    YORI_ALLOC_SIZE_T Index;
+    DWORD MaxThreads;
+    DWORD ThreadCount;
+    BOOLEAN NeedFile;
+
+    NeedFile = FALSE;
+    for (Index = 0; Index < CollectFnCount; Index++) {
+        if (!YoriLibIsCollectFnFromFindData(CollectFns[Index])) {
+            NeedFile = TRUE;
+        }
+    }
+
+    if (!NeedFile) {
+        return NULL;
+    }
+
+    //
+    //  Collection is typically bound by the latency of opening files and
+    //  querying them rather than CPU, so use more threads than processors.
+    //
+
+    GetSystemInfo(&SystemInfo);
+    MaxThreads = SystemInfo.dwNumberOfProcessors * 2;
+    if (MaxThreads < 2) {
+        MaxThreads = 2;
+    }
+    if (MaxThreads > YORILIB_FILE_INFO_QUEUE_MAX_THREADS) {
+        MaxThreads = YORILIB_FILE_INFO_QUEUE_MAX_THREADS;
+    }
+
+    Queue = YoriLibMalloc((YORI_ALLOC_SIZE_T)(sizeof(YORILIB_FILE_INFO_QUEUE) + CollectFnCount * sizeof(YORI_LIB_FILE_FILT_COLLECT_FN)));
+    if (Queue == NULL) {
+        return NULL;
+    }
+
+    ZeroMemory(Queue, sizeof(YORILIB_FILE_INFO_QUEUE));
+    Queue->CollectFns = (YORI_LIB_FILE_FILT_COLLECT_FN *)(Queue + 1);
+    Queue->CollectFnCount = CollectFnCount;
+    memcpy(Queue->CollectFns, CollectFns, CollectFnCount * sizeof(YORI_LIB_FILE_FILT_COLLECT_FN));
+    Queue->CompleteFn = CompleteFn;
+    Queue->Context = Context;
+    YoriLibInitializeListHead(&Queue->FreeList);
+
+    Queue->ItemCount = MaxThreads * YORILIB_FILE_INFO_QUEUE_ITEMS_PER_THREAD;
+    Queue->Items = YoriLibMalloc((YORI_ALLOC_SIZE_T)(Queue->ItemCount * sizeof(YORILIB_FILE_INFO_QUEUE_ITEM)));
+    if (Queue->Items == NULL) {
+        YoriLibFileInfoQueueDestroy(Queue);
+        return NULL;
+    }
+    ZeroMemory(Queue->Items, Queue->ItemCount * sizeof(YORILIB_FILE_INFO_QUEUE_ITEM));
+    for (Index = 0; Index < Queue->ItemCount; Index++) {
+        YoriLibAppendList(&Queue->FreeList, &Queue->Items[Index].FreeListEntry);
+    }
+
+    Queue->WorkQueue = YoriLibWorkQueueCreate(YORILIB_WORK_QUEUE_KEEP_ORDER, 1, YoriLibFileInfoQueueExecute, YoriLibFileInfoQueueComplete, Queue);
+    if (Queue->WorkQueue == NULL) {
+        YoriLibFileInfoQueueDestroy(Queue);
+        return NULL;
+    }
+
+    //
+    //  Dynamically loaded functions are resolved on first use, which is
+    //  not safe to perform on multiple threads concurrently, so resolve
+    //  them here before any worker can use them.
+    //
+
+    for (Index = 0; Index < CollectFnCount; Index++) {
+        if (CollectFns[Index] == YoriLibCollectOwner ||
+            CollectFns[Index] == YoriLibCollectEffectivePermissions) {
+
+            YoriLibLoadAdvApi32Functions();
+        } else if (CollectFns[Index] == YoriLibCollectDescription ||
+                   CollectFns[Index] == YoriLibCollectFileVersionString ||
+                   CollectFns[Index] == YoriLibCollectVersion) {
+
+            YoriLibLoadVersionFunctions();
+        }
+    }
+
+    for (ThreadCount = 0; ThreadCount < MaxThreads; ThreadCount++) {
+        if (!YoriLibWorkQueueAddWorker(Queue->WorkQueue, NULL)) {
+            break;
+        }
+    }
+
+    if (ThreadCount == 0) {
+        YoriLibFileInfoQueueDestroy(Queue);
+        return NULL;
+    }
+
+    return Queue;
+}
+
+/**
+ Submit a file for collection.  Any files that are already complete are
+ returned to the caller via the queue's completion function before this
+ function returns, which may include the file being submitted.  If the queue
+ is full, this function waits for the oldest file to complete.
+
+ @param Queue Pointer to the queue.
+
+ @param FindData The directory enumeration information for the file.
+
+ @param FindDataEx Optionally points to extended directory enumeration
+        information for the file.  If supplied, FindData must point to its
+        FindData member.
+
+ @param FullPath Pointer to a string to the full file name.
+
+ @return TRUE to indicate the file was submitted, FALSE if it could not be
+         submitted due to allocation failure.
+ */
+__success(return)
+BOOL
+YoriLibFileInfoQueueSubmit(
+    __in PYORILIB_FILE_INFO_QUEUE Queue,
+    __in PWIN32_FIND_DATA FindData,
+    __in_opt PYORILIB_FIND_DATA_EXTENDED FindDataEx,
+    __in PYORI_STRING FullPath
+    )
+{
+    PYORILIB_FILE_INFO_QUEUE_ITEM Item;
+    PYORI_LIST_ENTRY ListEntry;
+
+    //
+    //  Ensure there is a free item.  Only this thread submits or returns
+    //  files, so once an item is free it remains free.
+    //
+
+    YoriLibWorkQueueComplete(Queue->WorkQueue, Queue->ItemCount - 1, INFINITE);
+
+    ListEntry = YoriLibGetNextListEntry(&Queue->FreeList, NULL);
+    ASSERT(ListEntry != NULL);
+    Item = CONTAINING_RECORD(ListEntry, YORILIB_FILE_INFO_QUEUE_ITEM, FreeListEntry);
+
+    if (Item->FullPath.LengthAllocated <= FullPath->LengthInChars) {
+        YoriLibFreeStringContents(&Item->FullPath);
+        if (!YoriLibAllocateString(&Item->FullPath, FullPath->LengthInChars + 1)) {
+            return FALSE;
+        }
+    }
+
+    memcpy(Item->FullPath.StartOfString, FullPath->StartOfString, FullPath->LengthInChars * sizeof(TCHAR));
+    Item->FullPath.StartOfString[FullPath->LengthInChars] = '\0';
+    Item->FullPath.LengthInChars = FullPath->LengthInChars;
+
+    if (FindDataEx != NULL) {
+        ASSERT(FindData == &FindDataEx->FindData);
+        memcpy(&Item->FindDataEx, FindDataEx, sizeof(YORILIB_FIND_DATA_EXTENDED));
+        Item->FindDataExValid = TRUE;
+    } else {
+        memcpy(&Item->FindDataEx.FindData, FindData, sizeof(WIN32_FIND_DATA));
+        Item->FindDataExValid = FALSE;
+    }
+
+    YoriLibRemoveListItem(&Item->FreeListEntry);
+    YoriLibWorkQueueInitializeItem(&Item->WorkItem);
+    YoriLibWorkQueueSubmit(Queue->WorkQueue, &Item->WorkItem);
+
+    //
+    //  Return any files that are already complete without waiting.
+    //
+
+    YoriLibWorkQueueComplete(Queue->WorkQueue, Queue->ItemCount, INFINITE);
+    return TRUE;
+}
+
+/**
+ Wait for all submitted files to complete and return them to the caller via
+ the queue's completion function.  The queue remains usable for further
+ files after this call.
+
+ @param Queue Pointer to the queue.
+ */
+VOID
+YoriLibFileInfoQueueFlush(
+    __in PYORILIB_FILE_INFO_QUEUE Queue
+    )
+{
+    YoriLibWorkQueueComplete(Queue->WorkQueue, 0, INFINITE);
+}
+
+// vim:sw=4:ts=4:et:
@@ -0,0 +1,540 @@
+/**
+ * @file lib/fiupdate.c
+ *
+ * Apply metadata changes to files on a pool of worker threads
+ *
+ * This module allows a caller that is enumerating files to submit each file
+ * for a change to its timestamps, attributes or case sensitivity.  Changes
+ * are applied on worker threads while the caller continues enumerating, so
+ * that many files can be opened and updated concurrently.  This matters most
+ * on network file systems, where each update is bound by latency.
+ *
+ * Copyright (c) 2026 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "yoripch.h"
+#include "yorilib.h"
+
+/**
+ The maximum number of threads to use for updating files.
+ */
+#define YORILIB_FILE_UPDATE_QUEUE_MAX_THREADS (64)
+
+/**
+ The number of files that can be outstanding for each worker thread.  When
+ this many files have been submitted and not yet updated, the caller waits
+ for files to complete before submitting more, so memory usage remains
+ bounded.
+ */
+#define YORILIB_FILE_UPDATE_QUEUE_ITEMS_PER_THREAD (8)
+
+/**
+ A single file that has been submitted for update.
+ */
+typedef struct _YORILIB_FILE_UPDATE_QUEUE_ITEM {
+
+    /**
+     The work queue item for this file.
+     */
+    YORILIB_WORK_ITEM WorkItem;
+
+    /**
+     A full path to the file.  This is allocated as part of this structure.
+     */
+    YORI_STRING FilePath;
+
+    /**
+     Set to TRUE once the file has been updated successfully.
+     */
+    BOOL Updated;
+
+} YORILIB_FILE_UPDATE_QUEUE_ITEM, *PYORILIB_FILE_UPDATE_QUEUE_ITEM;
+
+/**
+ State for a pool of threads applying changes to files.
+ */
+typedef struct _YORILIB_FILE_UPDATE_QUEUE {
+
+    /**
+     A copy of the change to apply to each file.
+     */
+    YORILIB_FILE_UPDATE_OPERATION Operation;
+
+    /**
+     The work queue which updates files on worker threads.
+     */
+    PYORILIB_WORK_QUEUE WorkQueue;
+
+    /**
+     The maximum number of files which can be submitted and not yet
+     complete.
+     */
+    DWORD MaximumOutstanding;
+
+    /**
+     The time the queue was created, used to report elapsed time.
+     */
+    LONGLONG StartTime;
+
+    /**
+     The number of files successfully updated.  This is only updated on
+     the caller's thread as files complete.
+     */
+    DWORDLONG FilesUpdated;
+
+    /**
+     The number of files that could not be updated.  This is only updated
+     on the caller's thread as files complete.
+     */
+    DWORDLONG FilesFailed;
+
+} YORILIB_FILE_UPDATE_QUEUE;
+
+/**
+ Display an error encountered when updating a file.
+
+ @param Operation Pointer to the operation being performed.
+
+ @param Action Pointer to a string describing the step that failed.
+
+ @param FilePath Pointer to the file being updated.
+
+ @param ErrText Pointer to the error text to display.
+ */
+VOID
+YoriLibFileUpdateReportError(
+    __in PYORILIB_FILE_UPDATE_OPERATION Operation,
+    __in LPCTSTR Action,
+    __in PYORI_STRING FilePath,
+    __in LPTSTR ErrText
+    )
+{
+    YORI_STRING UnescapedPath;
+    PYORI_STRING DisplayPath;
+
+    YoriLibInitEmptyString(&UnescapedPath);
+    DisplayPath = FilePath;
+    if (YoriLibUnescapePath(FilePath, &UnescapedPath)) {
+        DisplayPath = &UnescapedPath;
+    }
+
+    YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%s: %s of %y failed: %s"), Operation->ProgramName, Action, DisplayPath, ErrText);
+    YoriLibFreeStringContents(&UnescapedPath);
+}
+
+/**
+ Apply a change to the metadata of a single file on the calling thread.  The
+ file is opened once, and any timestamp and attribute changes are applied
+ with a single request where the system supports it.
+
+ @param Operation Pointer to the change to apply.
+
+ @param FilePath Pointer to a NULL terminated full path to the file.
+
+ @return TRUE to indicate the file was updated, FALSE if it was not.  Any
+         error is displayed before returning.
+ */
+BOOL
+YoriLibFileUpdateApply(
+    __in PYORILIB_FILE_UPDATE_OPERATION Operation,
+    __in PYORI_STRING FilePath
+    )
+{
+    HANDLE FileHandle;
+    DWORD OpenFlags;
+    BY_HANDLE_FILE_INFORMATION FileInfo;
+    FILE_BASIC_INFO BasicInfo;
+    YORI_FILE_CASE_SENSITIVE_INFORMATION CaseSensitiveInfo;
+    IO_STATUS_BLOCK IoStatusBlock;
+    DWORD NewAttributes;
+    LONG NtStatus;
+    LPTSTR ErrText;
+    BOOLEAN SetBasicInfo;
+    BOOL Result;
+
+    ASSERT(YoriLibIsStringNullTerminated(FilePath));
+
+    OpenFlags = FILE_FLAG_BACKUP_SEMANTICS;
+    if (Operation->Flags & YORILIB_FILE_UPDATE_NO_FOLLOW_LINKS) {
+        OpenFlags = OpenFlags | FILE_FLAG_OPEN_REPARSE_POINT;
+    }
+
+    FileHandle = CreateFile(FilePath->StartOfString,
+                            FILE_READ_ATTRIBUTES | FILE_WRITE_ATTRIBUTES | SYNCHRONIZE,
+                            FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                            NULL,
+                            OPEN_EXISTING,
+                            OpenFlags,
+                            NULL);
+
+    if (FileHandle == INVALID_HANDLE_VALUE) {
+        ErrText = YoriLibGetWinErrorText(GetLastError());
+        YoriLibFileUpdateReportError(Operation, _T("open"), FilePath, ErrText);
+        YoriLibFreeWinErrorText(ErrText);
+        return FALSE;
+    }
+
+    Result = TRUE;
+    SetBasicInfo = FALSE;
+    NewAttributes = 0;
+    ZeroMemory(&BasicInfo, sizeof(BasicInfo));
+
+    if (Operation->Flags & YORILIB_FILE_UPDATE_SET_TIMES) {
+        BasicInfo.CreationTime.LowPart = Operation->CreationTime.dwLowDateTime;
+        BasicInfo.CreationTime.HighPart = (LONG)Operation->CreationTime.dwHighDateTime;
+        BasicInfo.LastAccessTime.LowPart = Operation->LastAccessTime.dwLowDateTime;
+        BasicInfo.LastAccessTime.HighPart = (LONG)Operation->LastAccessTime.dwHighDateTime;
+        BasicInfo.LastWriteTime.LowPart = Operation->LastWriteTime.dwLowDateTime;
+        BasicInfo.LastWriteTime.HighPart = (LONG)Operation->LastWriteTime.dwHighDateTime;
+        SetBasicInfo = TRUE;
+    }
+
+    if (Operation->Flags & YORILIB_FILE_UPDATE_SET_ATTRIBUTES) {
+        if (!GetFileInformationByHandle(FileHandle, &FileInfo)) {
+            ErrText = YoriLibGetWinErrorText(GetLastError());
+            YoriLibFileUpdateReportError(Operation, _T("query of attributes"), FilePath, ErrText);
+            YoriLibFreeWinErrorText(ErrText);
+            CloseHandle(FileHandle);
+            return FALSE;
+        }
+
+        NewAttributes = FileInfo.dwFileAttributes & ~(Operation->AttributesToClear);
+        NewAttributes = NewAttributes | Operation->AttributesToSet;
+
+        //
+        //  Attributes which are changed by other requests are not accepted
+        //  here.  Like SetFileAttributes, include FILE_ATTRIBUTE_NORMAL so
+        //  that clearing every attribute is not interpreted as no change.
+        //
+
+        if (NewAttributes != FileInfo.dwFileAttributes) {
+            NewAttributes = NewAttributes & ~(FILE_ATTRIBUTE_DIRECTORY |
+                                              FILE_ATTRIBUTE_REPARSE_POINT |
+                                              FILE_ATTRIBUTE_COMPRESSED |
+                                              FILE_ATTRIBUTE_ENCRYPTED |
+                                              FILE_ATTRIBUTE_SPARSE_FILE);
+            BasicInfo.FileAttributes = NewAttributes | FILE_ATTRIBUTE_NORMAL;
+            SetBasicInfo = TRUE;
+        }
+    }
+
+    if (SetBasicInfo) {
+        if (DllKernel32.pSetFileInformationByHandle != NULL) {
+            if (!DllKernel32.pSetFileInformationByHandle(FileHandle, FileBasicInfo, &BasicInfo, sizeof(BasicInfo))) {
+                Result = FALSE;
+            }
+        } else {
+
+            //
+            //  Before Vista, apply timestamps via the handle and attributes
+            //  via the path.
+            //
+
+            if (Operation->Flags & YORILIB_FILE_UPDATE_SET_TIMES) {
+                if (!SetFileTime(FileHandle, &Operation->CreationTime, &Operation->LastAccessTime, &Operation->LastWriteTime)) {
+                    Result = FALSE;
+                }
+            }
+            if (Result && BasicInfo.FileAttributes != 0) {
+                if (!SetFileAttributes(FilePath->StartOfString, NewAttributes)) {
+                    Result = FALSE;
+                }
+            }
+        }
+
+        if (!Result) {
+            ErrText = YoriLibGetWinErrorText(GetLastError());
+            YoriLibFileUpdateReportError(Operation, _T("update"), FilePath, ErrText);
+            YoriLibFreeWinErrorText(ErrText);
+        }
+    }
+
+    if (Result && (Operation->Flags & YORILIB_FILE_UPDATE_SET_CASE_SENSITIVITY)) {
+        if (DllNtDll.pNtSetInformationFile == NULL) {
+            ErrText = YoriLibGetWinErrorText(ERROR_PROC_NOT_FOUND);
+            YoriLibFileUpdateReportError(Operation, _T("update"), FilePath, ErrText);
+            YoriLibFreeWinErrorText(ErrText);
+            Result = FALSE;
+        } else {
+            CaseSensitiveInfo.Flags = 0;
+            if (Operation->CaseSensitive) {
+                CaseSensitiveInfo.Flags = 1;
+            }
+
+            NtStatus = DllNtDll.pNtSetInformationFile(FileHandle, &IoStatusBlock, &CaseSensitiveInfo, sizeof(CaseSensitiveInfo), FileCaseSensitiveInformation);
+            if (NtStatus != 0) {
+                ErrText = YoriLibGetNtErrorText(NtStatus);
+                YoriLibFileUpdateReportError(Operation, _T("update"), FilePath, ErrText);
+                YoriLibFreeWinErrorText(ErrText);
+                Result = FALSE;
+            }
+        }
+    }
+
+    CloseHandle(FileHandle);
+    return Result;
+}
+
+/**
+ Apply the change to a submitted file on a worker thread.
+
+ @param Context Pointer to the queue.
+
+ @param WorkerContext Unused.
+
+ @param WorkItem Pointer to the work item within the file's item.
+
+ @return TRUE to indicate the worker can process further files.
+ */
+BOOLEAN
+YoriLibFileUpdateQueueExecute(
+    __in PVOID Context,
+    __in PVOID WorkerContext,
+    __in PYORILIB_WORK_ITEM WorkItem
+    )
+{
+    PYORILIB_FILE_UPDATE_QUEUE Queue;
+    PYORILIB_FILE_UPDATE_QUEUE_ITEM Item;
+
+    UNREFERENCED_PARAMETER(WorkerContext);
+
+    Queue = (PYORILIB_FILE_UPDATE_QUEUE)Context;
+    Item = CONTAINING_RECORD(WorkItem, YORILIB_FILE_UPDATE_QUEUE_ITEM, WorkItem);
+    Item->Updated = YoriLibFileUpdateApply(&Queue->Operation, &Item->FilePath);
+    return TRUE;
+}
+
+/**
+ Record the result of a file once it has been updated, and free it.  This
+ is invoked on the caller's thread.
+
+ @param Context Pointer to the queue.
+
+ @param WorkItem Pointer to the work item within the file's item.
+ */
+VOID
+YoriLibFileUpdateQueueComplete(
+    __in PVOID Context,
+    __in PYORILIB_WORK_ITEM WorkItem
+    )
+{
+    PYORILIB_FILE_UPDATE_QUEUE Queue;
+    PYORILIB_FILE_UPDATE_QUEUE_ITEM Item;
+
+    Queue = (PYORILIB_FILE_UPDATE_QUEUE)Context;
+    Item = CONTAINING_RECORD(WorkItem, YORILIB_FILE_UPDATE_QUEUE_ITEM, WorkItem);
+
+    //
+    //  If no workers are running, update the file here.
+    //
+
+    if (!WorkItem->Executed) {
+        Item->Updated = YoriLibFileUpdateApply(&Queue->Operation, &Item->FilePath);
+    }
+
+    if (Item->Updated) {
+        Queue->FilesUpdated++;
+    } else {
+        Queue->FilesFailed++;
+    }
+
+    YoriLibFree(Item);
+}
+
+/**
+ Wait for all submitted files to be updated, and optionally return a summary
+ of the files processed since the queue was created.  The queue remains
+ usable for further files after this call.
+
+ @param Queue Pointer to the queue.
+
+ @param Stats Optionally points to a structure to populate with the number
+        of files processed and the time taken.
+ */
+VOID
+YoriLibFileUpdateQueueFlush(
+    __in PYORILIB_FILE_UPDATE_QUEUE Queue,
+    __out_opt PYORILIB_FILE_UPDATE_STATS Stats
+    )
+{
+    YoriLibWorkQueueComplete(Queue->WorkQueue, 0, INFINITE);
+
+    if (Stats != NULL) {
+        Stats->FilesUpdated = Queue->FilesUpdated;
+        Stats->FilesFailed = Queue->FilesFailed;
+        Stats->ElapsedTime = (DWORDLONG)(YoriLibGetSystemTimeAsInteger() - Queue->StartTime);
+    }
+}
+
+/**
+ Wait for all submitted files to be updated, then display the number of
+ files processed and the rate at which they were processed.
+
+ @param Queue Pointer to the queue.
+ */
+VOID
+YoriLibFileUpdateQueueDisplayStats(
+    __in PYORILIB_FILE_UPDATE_QUEUE Queue
+    )
+{
+    YORILIB_FILE_UPDATE_STATS Stats;
+    DWORDLONG ElapsedMs;
+    DWORDLONG FilesPerSecond;
+
+    YoriLibFileUpdateQueueFlush(Queue, &Stats);
+
+    ElapsedMs = Stats.ElapsedTime / (10 * 1000);
+    FilesPerSecond = 0;
+    if (ElapsedMs > 0) {
+        FilesPerSecond = (Stats.FilesUpdated + Stats.FilesFailed) * 1000 / ElapsedMs;
+    }
+
+    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT,
+                  _T("%s: %lli files updated, %lli failed, %lli.%03i seconds, %lli files per second\n"),
+                  Queue->Operation.ProgramName,
+                  Stats.FilesUpdated,
+                  Stats.FilesFailed,
+                  ElapsedMs / 1000,
+                  (DWORD)(ElapsedMs % 1000),
+                  FilesPerSecond);
+}
+
+/**
+ Wait for all submitted files to be updated, then terminate worker threads
+ and free all state associated with a queue.
+
+ @param Queue Pointer to the queue.
+ */
+VOID
+YoriLibFileUpdateQueueDestroy(
+    __in PYORILIB_FILE_UPDATE_QUEUE Queue
+    )
+{
+    if (Queue->WorkQueue != NULL) {
+        YoriLibWorkQueueDestroy(Queue->WorkQueue);
+        Queue->WorkQueue = NULL;
+    }
+
+    YoriLibFree(Queue);
+}
+
+/**
+ Create a pool of threads to apply a change to files as they are submitted.
+
+ @param Operation Pointer to the change to apply to each file.  This is
+        copied and need not remain valid after this function returns,
+        although the ProgramName string it refers to must.
+
+ @param ThreadCount The number of files to update concurrently.  This is
+        limited to YORILIB_FILE_UPDATE_QUEUE_MAX_THREADS.
+
+ @return Pointer to the queue, or NULL if a queue could not be created.
+         Callers are expected to update files synchronously with
+         YoriLibFileUpdateApply if NULL is returned.
+ */
+PYORILIB_FILE_UPDATE_QUEUE
+YoriLibFileUpdateQueueCreate(
+    __in PYORILIB_FILE_UPDATE_OPERATION Operation,
+    __in DWORD ThreadCount
+    )
+{
+    PYORILIB_FILE_UPDATE_QUEUE Queue;
+    DWORD WorkerCount;
+
+    if (ThreadCount < 1) {
+        ThreadCount = 1;
+    }
+    if (ThreadCount > YORILIB_FILE_UPDATE_QUEUE_MAX_THREADS) {
+        ThreadCount = YORILIB_FILE_UPDATE_QUEUE_MAX_THREADS;
+    }
+
+    Queue = YoriLibMalloc(sizeof(YORILIB_FILE_UPDATE_QUEUE));
+    if (Queue == NULL) {
+        return NULL;
+    }
+
+    ZeroMemory(Queue, sizeof(YORILIB_FILE_UPDATE_QUEUE));
+    memcpy(&Queue->Operation, Operation, sizeof(YORILIB_FILE_UPDATE_OPERATION));
+    Queue->StartTime = YoriLibGetSystemTimeAsInteger();
+    Queue->MaximumOutstanding = ThreadCount * YORILIB_FILE_UPDATE_QUEUE_ITEMS_PER_THREAD;
+
+    Queue->WorkQueue = YoriLibWorkQueueCreate(0, 1, YoriLibFileUpdateQueueExecute, YoriLibFileUpdateQueueComplete, Queue);
+    if (Queue->WorkQueue == NULL) {
+        YoriLibFileUpdateQueueDestroy(Queue);
+        return NULL;
+    }
+
+    for (WorkerCount = 0; WorkerCount < ThreadCount; WorkerCount++) {
+        if (!YoriLibWorkQueueAddWorker(Queue->WorkQueue, NULL)) {
+            break;
+        }
+    }
+
+    if (WorkerCount == 0) {
+        YoriLibFileUpdateQueueDestroy(Queue);
+        return NULL;
+    }
+
+    return Queue;
+}
+
+/**
+ Submit a file to be updated by a worker thread.  If the maximum number of
+ files are already outstanding, this function waits for earlier files to
+ complete.  If the file cannot be queued due to allocation failure, it is
+ updated on the calling thread before this function returns.
+
+ @param Queue Pointer to the queue.
+
+ @param FilePath Pointer to a NULL terminated full path to the file.
+ */
+VOID
+YoriLibFileUpdateQueueSubmit(
+    __in PYORILIB_FILE_UPDATE_QUEUE Queue,
+    __in PYORI_STRING FilePath
+    )
+{
+    PYORILIB_FILE_UPDATE_QUEUE_ITEM Item;
+
+    Item = YoriLibMalloc((YORI_ALLOC_SIZE_T)(sizeof(YORILIB_FILE_UPDATE_QUEUE_ITEM) + (FilePath->LengthInChars + 1) * sizeof(TCHAR)));
+    if (Item == NULL) {
+        if (YoriLibFileUpdateApply(&Queue->Operation, FilePath)) {
+            Queue->FilesUpdated++;
+        } else {
+            Queue->FilesFailed++;
+        }
+        return;
+    }
+
+    YoriLibWorkQueueInitializeItem(&Item->WorkItem);
+    Item->Updated = FALSE;
+    YoriLibInitEmptyString(&Item->FilePath);
+    Item->FilePath.StartOfString = (LPTSTR)(Item + 1);
+    Item->FilePath.LengthAllocated = FilePath->LengthInChars + 1;
+    memcpy(Item->FilePath.StartOfString, FilePath->StartOfString, FilePath->LengthInChars * sizeof(TCHAR));
+    Item->FilePath.StartOfString[FilePath->LengthInChars] = '\0';
+    Item->FilePath.LengthInChars = FilePath->LengthInChars;
+
+    YoriLibWorkQueueSubmit(Queue->WorkQueue, &Item->WorkItem);
+    YoriLibWorkQueueComplete(Queue->WorkQueue, Queue->MaximumOutstanding, INFINITE);
+}
+
+// vim:sw=4:ts=4:et:
@@ -0,0 +1,595 @@
+/**
+ * @file lib/fpcache.c
+ *
+ * Yori cache of recently resolved full path names
+ *
+ * Copyright (c) 2026 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "yoripch.h"
+#include "yorilib.h"
+
+//
+//  Resolving a full path is a purely textual operation: the result depends
+//  only on the directory that a name is relative to, the name itself, and
+//  whether an escaped path was requested.  Programs such as ymake resolve
+//  the same names against the same directories many times, so the result
+//  of each resolution is remembered here and copied out on later requests.
+//
+//  Entries are keyed by all three inputs.  Since the hash table compares
+//  keys without regard to case but the result preserves the case of its
+//  input, a matching entry is only used if its key also matches exactly.
+//  Names that are resolved against the process current directory are
+//  marked as such, and are discarded when the current directory changes,
+//  since they are unlikely to be requested again.  The cache holds a fixed
+//  number of entries, discarding the least recently used entry to make
+//  room for a new one.
+//
+//  The cache is only used once a process opts into it by calling
+//  YoriLibFullPathCacheEnable.
+//
+
+/**
+ The maximum number of full paths that can be cached.
+ */
+#define YORI_LIB_FULL_PATH_CACHE_MAX_ENTRIES (1024)
+
+/**
+ The maximum length of a key, in characters.  Resolutions whose directory
+ and name together exceed this are not cached.
+ */
+#define YORI_LIB_FULL_PATH_CACHE_MAX_KEY (1024)
+
+/**
+ A full path within the cache.
+ */
+typedef struct _YORI_LIB_FULL_PATH_CACHE_ENTRY {
+
+    /**
+     The hash entry for the path.  The key is a character indicating whether
+     the path is escaped, followed by the directory the name is relative to,
+     a seperator, and the name.  The key is stored immediately following this
+     structure.  Paired with YORI_LIB_FULL_PATH_CACHE::Entries.
+     */
+    YORI_HASH_ENTRY HashEntry;
+
+    /**
+     The list of all cached paths, ordered from least recently used to most
+     recently used.  Paired with YORI_LIB_FULL_PATH_CACHE::EntryList.
+     */
+    YORI_LIST_ENTRY ListEntry;
+
+    /**
+     The resolved full path, NULL terminated.  This is stored following the
+     key.
+     */
+    YORI_STRING FullPath;
+
+    /**
+     The length of the directory within the key, in characters.  This is
+     compared so that a seperator within the directory or name cannot cause
+     two different requests to match.
+     */
+    YORI_ALLOC_SIZE_T PrimaryLength;
+
+    /**
+     The offset of the file name component within FullPath, in characters.
+     */
+    YORI_ALLOC_SIZE_T FilePartOffset;
+
+    /**
+     TRUE if the path has a file name component, and FilePartOffset is
+     meaningful.
+     */
+    BOOLEAN HasFilePart;
+
+    /**
+     TRUE if the name was resolved against the process current directory,
+     so the entry should be discarded if that changes.
+     */
+    BOOLEAN KeyedByCurrentDirectory;
+
+} YORI_LIB_FULL_PATH_CACHE_ENTRY, *PYORI_LIB_FULL_PATH_CACHE_ENTRY;
+
+/**
+ Global state for the full path cache.
+ */
+typedef struct _YORI_LIB_FULL_PATH_CACHE {
+
+    /**
+     A mutex synchronizing access to the cache.
+     */
+    HANDLE Mutex;
+
+    /**
+     A hash table of cached paths.  NULL if the cache is not enabled.
+     */
+    PYORI_HASH_TABLE Entries;
+
+    /**
+     A list of cached paths, ordered from least recently used to most
+     recently used.
+     */
+    YORI_LIST_ENTRY EntryList;
+
+    /**
+     The number of cached paths.
+     */
+    DWORD EntryCount;
+
+    /**
+     The process current directory that entries marked as
+     KeyedByCurrentDirectory were resolved against.
+     */
+    YORI_STRING CurrentDirectory;
+
+} YORI_LIB_FULL_PATH_CACHE, *PYORI_LIB_FULL_PATH_CACHE;
+
+/**
+ Global state for the full path cache.
+ */
+YORI_LIB_FULL_PATH_CACHE YoriLibFullPathCache;
+
+/**
+ Enable the full path cache for the remainder of this process.  Any failure
+ here leaves the cache disabled, which means each path is resolved again.
+
+ @return TRUE to indicate the cache is enabled, FALSE if it is not.
+ */
+BOOLEAN
+YoriLibFullPathCacheEnable(VOID)
+{
+    if (YoriLibFullPathCache.Entries != NULL) {
+        return TRUE;
+    }
+
+    YoriLibFullPathCache.Mutex = CreateMutex(NULL, FALSE, NULL);
+    if (YoriLibFullPathCache.Mutex == NULL) {
+        return FALSE;
+    }
+
+    YoriLibInitializeListHead(&YoriLibFullPathCache.EntryList);
+    YoriLibInitEmptyString(&YoriLibFullPathCache.CurrentDirectory);
+    YoriLibFullPathCache.EntryCount = 0;
+    YoriLibFullPathCache.Entries = YoriLibAllocateHashTable(256);
+    if (YoriLibFullPathCache.Entries == NULL) {
+        CloseHandle(YoriLibFullPathCache.Mutex);
+        YoriLibFullPathCache.Mutex = NULL;
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ Remove an entry from the cache and free it.  The caller is expected to hold
+ the cache mutex.
+
+ @param Entry Pointer to the entry to free.
+ */
+VOID
+YoriLibFullPathCacheFreeEntry(
+    __in PYORI_LIB_FULL_PATH_CACHE_ENTRY Entry
+    )
+{
+    YoriLibHashRemoveByEntry(&Entry->HashEntry);
+    YoriLibRemoveListItem(&Entry->ListEntry);
+    YoriLibFullPathCache.EntryCount--;
+    YoriLibFree(Entry);
+}
+
+/**
+ Construct the key describing a request to resolve a full path.
+
+ @param PrimaryDirectory Pointer to the directory that the name is relative
+        to.  If NULL, the name is fully specified and does not depend on
+        any directory.
+
+ @param FileName Pointer to the name to resolve.
+
+ @param ReturnEscapedPath TRUE if the path is to be returned in \\?\ form.
+
+ @param KeyBuffer Pointer to a buffer of YORI_LIB_FULL_PATH_CACHE_MAX_KEY
+        characters to contain the key.
+
+ @param Key On successful completion, populated to refer to the key within
+        KeyBuffer.
+
+ @param PrimaryLength On successful completion, populated with the length of
+        the directory within the key.
+
+ @return TRUE to indicate the key was constructed, FALSE if the request is
+         too long to be cached.
+ */
+__success(return)
+BOOLEAN
+YoriLibFullPathCacheBuildKey(
+    __in_opt PCYORI_STRING PrimaryDirectory,
+    __in PCYORI_STRING FileName,
+    __in BOOL ReturnEscapedPath,
+    __out_ecount(YORI_LIB_FULL_PATH_CACHE_MAX_KEY) LPTSTR KeyBuffer,
+    __out PYORI_STRING Key,
+    __out PYORI_ALLOC_SIZE_T PrimaryLength
+    )
+{
+    YORI_ALLOC_SIZE_T Length;
+
+    Length = 0;
+    if (PrimaryDirectory != NULL) {
+        Length = PrimaryDirectory->LengthInChars;
+    }
+
+    if (Length + FileName->LengthInChars + 2 > YORI_LIB_FULL_PATH_CACHE_MAX_KEY) {
+        return FALSE;
+    }
+
+    YoriLibInitEmptyString(Key);
+    Key->StartOfString = KeyBuffer;
+    Key->LengthAllocated = YORI_LIB_FULL_PATH_CACHE_MAX_KEY;
+
+    if (ReturnEscapedPath) {
+        KeyBuffer[0] = 'E';
+    } else {
+        KeyBuffer[0] = 'W';
+    }
+
+    if (Length > 0) {
+        memcpy(&KeyBuffer[1], PrimaryDirectory->StartOfString, Length * sizeof(TCHAR));
+    }
+    KeyBuffer[Length + 1] = '|';
+    memcpy(&KeyBuffer[Length + 2], FileName->StartOfString, FileName->LengthInChars * sizeof(TCHAR));
+    Key->LengthInChars = Length + FileName->LengthInChars + 2;
+    *PrimaryLength = Length;
+    return TRUE;
+}
+
+/**
+ Check whether the process current directory differs from the one that
+ entries keyed by the current directory were resolved against, and if so,
+ discard those entries and record the new current directory.  The caller is
+ expected to hold the cache mutex.
+
+ @param CurrentDirectory Pointer to the process current directory.
+ */
+VOID
+YoriLibFullPathCacheCheckCurrentDirectory(
+    __in PCYORI_STRING CurrentDirectory
+    )
+{
+    PYORI_LIB_FULL_PATH_CACHE_ENTRY Entry;
+    PYORI_LIST_ENTRY ListEntry;
+
+    if (YoriLibCompareString(&YoriLibFullPathCache.CurrentDirectory, CurrentDirectory) == 0) {
+        return;
+    }
+
+    ListEntry = YoriLibGetNextListEntry(&YoriLibFullPathCache.EntryList, NULL);
+    while (ListEntry != NULL) {
+        Entry = CONTAINING_RECORD(ListEntry, YORI_LIB_FULL_PATH_CACHE_ENTRY, ListEntry);
+        ListEntry = YoriLibGetNextListEntry(&YoriLibFullPathCache.EntryList, ListEntry);
+        if (Entry->KeyedByCurrentDirectory) {
+            YoriLibFullPathCacheFreeEntry(Entry);
+        }
+    }
+
+    //
+    //  If the new directory cannot be recorded, leave no directory recorded
+    //  so that no entries are inserted relative to it.
+    //
+
+    if (YoriLibFullPathCache.CurrentDirectory.LengthAllocated <= CurrentDirectory->LengthInChars) {
+        YoriLibFreeStringContents(&YoriLibFullPathCache.CurrentDirectory);
+        if (!YoriLibAllocateString(&YoriLibFullPathCache.CurrentDirectory, CurrentDirectory->LengthInChars + MAX_PATH)) {
+            return;
+        }
+    }
+
+    memcpy(YoriLibFullPathCache.CurrentDirectory.StartOfString, CurrentDirectory->StartOfString, CurrentDirectory->LengthInChars * sizeof(TCHAR));
+    YoriLibFullPathCache.CurrentDirectory.StartOfString[CurrentDirectory->LengthInChars] = '\0';
+    YoriLibFullPathCache.CurrentDirectory.LengthInChars = CurrentDirectory->LengthInChars;
+}
+
+/**
+ Find a cached entry matching a key.  The caller is expected to hold the
+ cache mutex.
+
+ @param Key Pointer to the key to find.
+
+ @param Hash The hash of the key.
+
+ @param PrimaryLength The length of the directory within the key.
+
+ @return Pointer to the entry, or NULL if no exactly matching entry is
+         cached.
+ */
+PYORI_LIB_FULL_PATH_CACHE_ENTRY
+YoriLibFullPathCacheFindEntry(
+    __in PCYORI_STRING Key,
+    __in DWORD Hash,
+    __in YORI_ALLOC_SIZE_T PrimaryLength
+    )
+{
+    PYORI_LIB_FULL_PATH_CACHE_ENTRY Entry;
+    PYORI_HASH_ENTRY HashEntry;
+
+    HashEntry = YoriLibHashLookupByKeyWithHash(YoriLibFullPathCache.Entries, Key, Hash);
+    if (HashEntry == NULL) {
+        return NULL;
+    }
+
+    Entry = HashEntry->Context;
+    if (Entry->PrimaryLength != PrimaryLength ||
+        YoriLibCompareString(&HashEntry->Key, Key) != 0) {
+
+        return NULL;
+    }
+
+    return Entry;
+}
+
+/**
+ Look for a previously resolved full path in the cache, and if it is found,
+ copy it into a caller's buffer.
+
+ @param PrimaryDirectory Pointer to the directory that the name is relative
+        to.  If NULL, the name is fully specified and does not depend on
+        any directory.
+
+ @param KeyedByCurrentDirectory TRUE if PrimaryDirectory is the process
+        current directory.
+
+ @param FileName Pointer to the name to resolve.
+
+ @param ReturnEscapedPath TRUE if the path is to be returned in \\?\ form.
+
+ @param AllowAllocation TRUE if Buffer can be reallocated if it is too small
+        to contain the path.  If FALSE, a buffer that is too small causes
+        this function to fail.
+
+ @param Buffer On successful completion, populated with the full path.
+
+ @param lpFilePart If specified, on successful completion, updated to point
+        to the beginning of the file name component of the path within
+        Buffer.
+
+ @return ERROR_SUCCESS to indicate the path was found and copied,
+         ERROR_FILE_NOT_FOUND if the path is not cached, or another Win32
+         error code if the path could not be copied.
+ */
+DWORD
+YoriLibFullPathCacheLookup(
+    __in_opt PCYORI_STRING PrimaryDirectory,
+    __in BOOLEAN KeyedByCurrentDirectory,
+    __in PCYORI_STRING FileName,
+    __in BOOL ReturnEscapedPath,
+    __in BOOLEAN AllowAllocation,
+    __inout PYORI_STRING Buffer,
+    __deref_opt_out_opt LPTSTR* lpFilePart
+    )
+{
+    PYORI_LIB_FULL_PATH_CACHE_ENTRY Entry;
+    TCHAR KeyBuffer[YORI_LIB_FULL_PATH_CACHE_MAX_KEY];
+    YORI_STRING Key;
+    YORI_ALLOC_SIZE_T PrimaryLength;
+    DWORD Hash;
+    DWORD Result;
+
+    if (YoriLibFullPathCache.Entries == NULL) {
+        return ERROR_FILE_NOT_FOUND;
+    }
+
+    if (!YoriLibFullPathCacheBuildKey(PrimaryDirectory, FileName, ReturnEscapedPath, KeyBuffer, &Key, &PrimaryLength)) {
+        return ERROR_FILE_NOT_FOUND;
+    }
+
+    Hash = YoriLibHashKey(&Key);
+
+    WaitForSingleObject(YoriLibFullPathCache.Mutex, INFINITE);
+
+    if (KeyedByCurrentDirectory) {
+        ASSERT(PrimaryDirectory != NULL);
+        YoriLibFullPathCacheCheckCurrentDirectory(PrimaryDirectory);
+    }
+
+    Entry = YoriLibFullPathCacheFindEntry(&Key, Hash, PrimaryLength);
+    if (Entry == NULL) {
+        ReleaseMutex(YoriLibFullPathCache.Mutex);
+        return ERROR_FILE_NOT_FOUND;
+    }
+
+    if (Buffer->LengthAllocated <= Entry->FullPath.LengthInChars) {
+        if (!AllowAllocation) {
+            Result = ERROR_INSUFFICIENT_BUFFER;
+            goto Exit;
+        }
+
+        YoriLibFreeStringContents(Buffer);
+        if (!YoriLibAllocateString(Buffer, Entry->FullPath.LengthInChars + 1)) {
+            Result = ERROR_NOT_ENOUGH_MEMORY;
+            goto Exit;
+        }
+    }
+
+    memcpy(Buffer->StartOfString, Entry->FullPath.StartOfString, (Entry->FullPath.LengthInChars + 1) * sizeof(TCHAR));
+    Buffer->LengthInChars = Entry->FullPath.LengthInChars;
+    if (lpFilePart != NULL) {
+        if (Entry->HasFilePart) {
+            *lpFilePart = &Buffer->StartOfString[Entry->FilePartOffset];
+        } else {
+            *lpFilePart = NULL;
+        }
+    }
+
+    Result = ERROR_SUCCESS;
+
+Exit:
+
+    //
+    //  Move the entry to the end of the list so it is the last to be
+    //  discarded.
+    //
+
+    YoriLibRemoveListItem(&Entry->ListEntry);
+    YoriLibAppendList(&YoriLibFullPathCache.EntryList, &Entry->ListEntry);
+
+    ReleaseMutex(YoriLibFullPathCache.Mutex);
+    return Result;
+}
+
+/**
+ Record a resolved full path in the cache.  Failure to record the path is
+ not reported, since the path can always be resolved again.
+
+ @param PrimaryDirectory Pointer to the directory that the name is relative
+        to.  If NULL, the name is fully specified and does not depend on
+        any directory.
+
+ @param KeyedByCurrentDirectory TRUE if PrimaryDirectory is the process
+        current directory.
+
+ @param FileName Pointer to the name that was resolved.
+
+ @param ReturnEscapedPath TRUE if the path was resolved in \\?\ form.
+
+ @param FullPath Pointer to the resolved full path.
+
+ @param FilePart If specified, points to the beginning of the file name
+        component within FullPath.
+ */
+VOID
+YoriLibFullPathCacheInsert(
+    __in_opt PCYORI_STRING PrimaryDirectory,
+    __in BOOLEAN KeyedByCurrentDirectory,
+    __in PCYORI_STRING FileName,
+    __in BOOL ReturnEscapedPath,
+    __in PCYORI_STRING FullPath,
+    __in_opt LPTSTR FilePart
+    )
+{
+    PYORI_LIB_FULL_PATH_CACHE_ENTRY Entry;
+    PYORI_HASH_ENTRY HashEntry;
+    PYORI_LIST_ENTRY ListEntry;
+    TCHAR KeyBuffer[YORI_LIB_FULL_PATH_CACHE_MAX_KEY];
+    YORI_STRING Key;
+    YORI_ALLOC_SIZE_T PrimaryLength;
+    DWORD Hash;
+
+    if (YoriLibFullPathCache.Entries == NULL) {
+        return;
+    }
+
+    if (!YoriLibFullPathCacheBuildKey(PrimaryDirectory, FileName, ReturnEscapedPath, KeyBuffer, &Key, &PrimaryLength)) {
+        return;
+    }
+
+    Hash = YoriLibHashKey(&Key);
+
+    WaitForSingleObject(YoriLibFullPathCache.Mutex, INFINITE);
+
+    //
+    //  If the current directory has changed since this path was resolved,
+    //  the path is unlikely to be requested again.
+    //
+
+    if (KeyedByCurrentDirectory &&
+        YoriLibCompareString(&YoriLibFullPathCache.CurrentDirectory, PrimaryDirectory) != 0) {
+
+        goto Exit;
+    }
+
+    //
+    //  The hash table can only find one entry for keys that differ only in
+    //  case, so replace any such entry with this one.
+    //
+
+    HashEntry = YoriLibHashLookupByKeyWithHash(YoriLibFullPathCache.Entries, &Key, Hash);
+    if (HashEntry != NULL) {
+        YoriLibFullPathCacheFreeEntry(HashEntry->Context);
+    }
+
+    if (YoriLibFullPathCache.EntryCount >= YORI_LIB_FULL_PATH_CACHE_MAX_ENTRIES) {
+        ListEntry = YoriLibGetNextListEntry(&YoriLibFullPathCache.EntryList, NULL);
+        ASSERT(ListEntry != NULL);
+        YoriLibFullPathCacheFreeEntry(CONTAINING_RECORD(ListEntry, YORI_LIB_FULL_PATH_CACHE_ENTRY, ListEntry));
+    }
+
+    Entry = YoriLibMalloc(sizeof(YORI_LIB_FULL_PATH_CACHE_ENTRY) + (Key.LengthInChars + FullPath->LengthInChars + 1) * sizeof(TCHAR));
+    if (Entry == NULL) {
+        goto Exit;
+    }
+
+    Key.StartOfString = (LPTSTR)(Entry + 1);
+    Key.LengthAllocated = Key.LengthInChars;
+    memcpy(Key.StartOfString, KeyBuffer, Key.LengthInChars * sizeof(TCHAR));
+
+    YoriLibInitEmptyString(&Entry->FullPath);
+    Entry->FullPath.StartOfString = Key.StartOfString + Key.LengthInChars;
+    Entry->FullPath.LengthInChars = FullPath->LengthInChars;
+    Entry->FullPath.LengthAllocated = FullPath->LengthInChars + 1;
+    memcpy(Entry->FullPath.StartOfString, FullPath->StartOfString, FullPath->LengthInChars * sizeof(TCHAR));
+    Entry->FullPath.StartOfString[FullPath->LengthInChars] = '\0';
+
+    Entry->PrimaryLength = PrimaryLength;
+    Entry->KeyedByCurrentDirectory = KeyedByCurrentDirectory;
+    Entry->HasFilePart = FALSE;
+    Entry->FilePartOffset = 0;
+    if (FilePart != NULL) {
+        Entry->HasFilePart = TRUE;
+        Entry->FilePartOffset = (YORI_ALLOC_SIZE_T)(FilePart - FullPath->StartOfString);
+    }
+
+    YoriLibHashInsertByKeyWithHash(YoriLibFullPathCache.Entries, &Key, Hash, Entry, &Entry->HashEntry);
+    YoriLibAppendList(&YoriLibFullPathCache.EntryList, &Entry->ListEntry);
+    YoriLibFullPathCache.EntryCount++;
+
+Exit:
+    ReleaseMutex(YoriLibFullPathCache.Mutex);
+}
+
+/**
+ Free all state associated with the full path cache and disable it.
+ */
+VOID
+YoriLibFullPathCacheCleanup(VOID)
+{
+    PYORI_LIB_FULL_PATH_CACHE_ENTRY Entry;
+    PYORI_LIST_ENTRY ListEntry;
+
+    if (YoriLibFullPathCache.Entries == NULL) {
+        return;
+    }
+
+    ListEntry = YoriLibGetNextListEntry(&YoriLibFullPathCache.EntryList, NULL);
+    while (ListEntry != NULL) {
+        Entry = CONTAINING_RECORD(ListEntry, YORI_LIB_FULL_PATH_CACHE_ENTRY, ListEntry);
+        ListEntry = YoriLibGetNextListEntry(&YoriLibFullPathCache.EntryList, ListEntry);
+        YoriLibFullPathCacheFreeEntry(Entry);
+    }
+
+    ASSERT(YoriLibFullPathCache.EntryCount == 0);
+    YoriLibFreeEmptyHashTable(YoriLibFullPathCache.Entries);
+    YoriLibFullPathCache.Entries = NULL;
+    YoriLibFreeStringContents(&YoriLibFullPathCache.CurrentDirectory);
+    CloseHandle(YoriLibFullPathCache.Mutex);
+    YoriLibFullPathCache.Mutex = NULL;
+}
+
+// vim:sw=4:ts=4:et:
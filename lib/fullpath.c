@@ -587,6 +587,10 @@ YoriLibGetFullPathDeterminePathType(
         output, the UncPath member may be updated to conform to the type of
         PrimaryDirectory.
 
+ @param AllowAllocation If TRUE, Buffer can be reallocated if it is too
+        small.  If FALSE, a buffer that is too small causes this function to
+        fail with ERROR_INSUFFICIENT_BUFFER.
+
  @param Buffer An initialized buffer to populate with the concatenated string.
         This can be reallocated in this function if it is insufficient to
         hold the result; if this occurs, FreeOnFailure is set to TRUE.
@@ -606,6 +610,7 @@ YoriLibFullPathMergeRootWithRelative(
     __in PYORI_STRING RelativePath,
     __in BOOL ReturnEscapedPath,
     __inout PYORI_LIB_FULL_PATH_TYPE PathType,
+    __in BOOLEAN AllowAllocation,
     __inout PYORI_STRING Buffer,
     __inout PBOOLEAN FreeOnFailure
     )
@@ -722,6 +727,9 @@ YoriLibFullPathMergeRootWithRelative(
     }
 
     if (Result > Buffer->LengthAllocated) {
+        if (!AllowAllocation) {
+            return ERROR_INSUFFICIENT_BUFFER;
+        }
         YoriLibFreeStringContents(Buffer);
         if (!YoriLibAllocateString(Buffer, Result)) {
             YoriLibFreeStringContents(&CurrentDirectory);
@@ -826,6 +834,10 @@ YoriLibFullPathMergeRootWithRelative(
         whether it currently has a "\\?\" prefix, and whether it is currently
         a UNC path.
 
+ @param AllowAllocation If TRUE, Buffer can be reallocated if it is too
+        small.  If FALSE, a buffer that is too small causes this function to
+        fail with ERROR_INSUFFICIENT_BUFFER.
+
  @param Buffer An initialized buffer to populate with the concatenated string.
         This can be reallocated in this function if it is insufficient to
         hold the result; if this occurs, FreeOnFailure is set to TRUE.
@@ -844,6 +856,7 @@ YoriLibFullPathNormalize(
     __in PYORI_STRING FileName,
     __in BOOL ReturnEscapedPath,
     __inout PYORI_LIB_FULL_PATH_TYPE PathType,
+    __in BOOLEAN AllowAllocation,
     __inout PYORI_STRING Buffer,
     __inout PBOOLEAN FreeOnFailure
     )
@@ -866,6 +879,9 @@ YoriLibFullPathNormalize(
     }
 
     if (Result > Buffer->LengthAllocated) {
+        if (!AllowAllocation) {
+            return ERROR_INSUFFICIENT_BUFFER;
+        }
         YoriLibFreeStringContents(Buffer);
         if (!YoriLibAllocateString(Buffer, Result)) {
             return ERROR_NOT_ENOUGH_MEMORY;
@@ -1260,8 +1276,14 @@ YoriLibGetFullPathNameReturnAllocation(
 
     YORI_LIB_FULL_PATH_TYPE PathType;
     BOOLEAN FreeOnFailure = FALSE;
+    BOOLEAN KeyedByCurrentDirectory;
+    BOOLEAN UseCache;
 
     YORI_STRING StartOfRelativePath;
+    YORI_STRING CurrentDirectory;
+    TCHAR CurrentDirectoryBuffer[MAX_PATH];
+    PYORI_STRING KeyDirectory;
+    LPTSTR FilePart;
 
     DWORD Result;
 
@@ -1273,6 +1295,12 @@ YoriLibGetFullPathNameReturnAllocation(
         return FALSE;
     }
 
+    YoriLibInitEmptyString(&CurrentDirectory);
+    KeyedByCurrentDirectory = FALSE;
+    KeyDirectory = NULL;
+    FilePart = NULL;
+    UseCache = TRUE;
+
     //
     //  If it's a relative case, get the current directory, and generate an
     //  "absolute" form of the name.  If it's an absolute case, prepend
@@ -1283,26 +1311,36 @@ YoriLibGetFullPathNameReturnAllocation(
         PathType.Flags.RelativePath ||
         PathType.Flags.AbsoluteWithoutDrive) {
 
-        YORI_STRING CurrentDirectory;
-        YORI_ALLOC_SIZE_T CurrentDirectoryLength;
+        //
+        //  Most current directories fit in MAX_PATH, so try a stack buffer
+        //  before allocating one.
+        //
 
-        CurrentDirectoryLength = (YORI_ALLOC_SIZE_T)GetCurrentDirectory(0, NULL);
-        if (!YoriLibAllocateString(&CurrentDirectory, CurrentDirectoryLength)) {
-            SetLastError(ERROR_NOT_ENOUGH_MEMORY);
-            return FALSE;
-        }
+        CurrentDirectory.StartOfString = CurrentDirectoryBuffer;
+        CurrentDirectory.LengthAllocated = MAX_PATH;
 
         Result = GetCurrentDirectory(CurrentDirectory.LengthAllocated, CurrentDirectory.StartOfString);
+        if (Result >= CurrentDirectory.LengthAllocated) {
+            if (!YoriLibAllocateString(&CurrentDirectory, (YORI_ALLOC_SIZE_T)Result)) {
+                SetLastError(ERROR_NOT_ENOUGH_MEMORY);
+                return FALSE;
+            }
+            Result = GetCurrentDirectory(CurrentDirectory.LengthAllocated, CurrentDirectory.StartOfString);
+        }
+
         if (Result == 0 || Result >= CurrentDirectory.LengthAllocated) {
             YoriLibFreeStringContents(&CurrentDirectory);
             return FALSE;
         }
 
         CurrentDirectory.LengthInChars = (YORI_ALLOC_SIZE_T)Result;
+        KeyedByCurrentDirectory = TRUE;
+        KeyDirectory = &CurrentDirectory;
 
         //
         //  If it's drive relative, and it's relative to a different drive,
-        //  get the current directory of the requested drive.
+        //  get the current directory of the requested drive.  This is not
+        //  cached since changes to it are not observed.
         //
 
         if (PathType.Flags.DriveRelativePath) {
@@ -1310,6 +1348,7 @@ YoriLibGetFullPathNameReturnAllocation(
                 YoriLibUpcaseChar(CurrentDirectory.StartOfString[0]) != YoriLibUpcaseChar(FileName->StartOfString[0])) {
 
                 YoriLibFreeStringContents(&CurrentDirectory);
+                UseCache = FALSE;
                 if (!YoriLibGetCurrentDirectoryOnDrive(FileName->StartOfString[0], &CurrentDirectory)) {
                     SetLastError(ERROR_NOT_ENOUGH_MEMORY);
                     return FALSE;
@@ -1317,34 +1356,60 @@ YoriLibGetFullPathNameReturnAllocation(
             }
         }
 
+        //
+        //  Merging a path without a drive with a UNC current directory
+        //  modifies the current directory, so the key would not be
+        //  reproduced.
+        //
+
+        if (PathType.Flags.AbsoluteWithoutDrive) {
+            UseCache = FALSE;
+        }
+    }
+
+    if (UseCache) {
+        Result = YoriLibFullPathCacheLookup(KeyDirectory,
+                                            KeyedByCurrentDirectory,
+                                            FileName,
+                                            ReturnEscapedPath,
+                                            TRUE,
+                                            Buffer,
+                                            lpFilePart);
+        if (Result != ERROR_FILE_NOT_FOUND) {
+            YoriLibFreeStringContents(&CurrentDirectory);
+            SetLastError(Result);
+            if (Result != ERROR_SUCCESS) {
+                return FALSE;
+            }
+            return TRUE;
+        }
+    }
+
+    if (KeyedByCurrentDirectory) {
         Result = YoriLibFullPathMergeRootWithRelative(&CurrentDirectory,
                                                       &StartOfRelativePath,
                                                       ReturnEscapedPath,
                                                       &PathType,
+                                                      TRUE,
                                                       Buffer,
                                                       &FreeOnFailure);
-        YoriLibFreeStringContents(&CurrentDirectory);
-
     } else {
 
         Result = YoriLibFullPathNormalize(FileName,
                                           ReturnEscapedPath,
                                           &PathType,
+                                          TRUE,
                                           Buffer,
                                           &FreeOnFailure);
 
     }
 
-    if (Result != ERROR_SUCCESS) {
-        if (FreeOnFailure) {
-            YoriLibFreeStringContents(Buffer);
-        }
-        SetLastError(Result);
-        return FALSE;
+    if (Result == ERROR_SUCCESS) {
+        Result = YoriLibGetFullPathSquashRelativeComponents(Buffer, &PathType, ReturnEscapedPath, &FilePart);
     }
 
-    Result = YoriLibGetFullPathSquashRelativeComponents(Buffer, &PathType, ReturnEscapedPath, lpFilePart);
     if (Result != ERROR_SUCCESS) {
+        YoriLibFreeStringContents(&CurrentDirectory);
         if (FreeOnFailure) {
             YoriLibFreeStringContents(Buffer);
         }
@@ -1352,19 +1417,28 @@ YoriLibGetFullPathNameReturnAllocation(
         return FALSE;
     }
 
+    if (UseCache) {
+        YoriLibFullPathCacheInsert(KeyDirectory,
+                                   KeyedByCurrentDirectory,
+                                   FileName,
+                                   ReturnEscapedPath,
+                                   Buffer,
+                                   FilePart);
+    }
+
+    YoriLibFreeStringContents(&CurrentDirectory);
+
+    if (lpFilePart != NULL) {
+        *lpFilePart = FilePart;
+    }
+
     SetLastError(0);
     return TRUE;
 }
 
 /**
- GetFullPathName where the "current" directory is specified.  Note that this
- version cannot traverse across drives without looking at the current
- directory for each drive, which the function does not take as input, so
- traversing drives is only possible with a fully formed path.
- This function will update a YORI_STRING, including allocating if necessary,
- to contain a buffer containing the path.  If this function allocates the
- buffer, the caller is expected to free this by calling
- @ref YoriLibFreeStringContents.
+ Implementation of GetFullPathName where the "current" directory is
+ specified, optionally without allocating.
 
  @param PrimaryDirectory The directory to use as a "current" directory.
 
@@ -1374,31 +1448,38 @@ YoriLibGetFullPathNameReturnAllocation(
  @param ReturnEscapedPath If TRUE, the returned path is in \\?\ form.
         If FALSE, it is in regular Win32 form.
 
- @param Buffer On successful completion, updated to point to a newly
-        allocated buffer containing the full path form of the file name.
-        Note this is returned as a NULL terminated YORI_STRING, suitable
-        for use in YORI_STRING or NULL terminated functions.
+ @param AllowAllocation If TRUE, Buffer can be reallocated if it is too
+        small to contain the path.  If FALSE, a buffer that is too small
+        causes this function to fail with ERROR_INSUFFICIENT_BUFFER.
+
+ @param Buffer On successful completion, updated to contain the full path
+        form of the file name.
 
  @param lpFilePart If specified, on successful completion, updated to point
         to the beginning of the file name component of the path, in the same
         allocation as lpBuffer.
 
- @return TRUE to indicate success, FALSE to indicate failure.
+ @return A win32 error code, including ERROR_SUCCESS to indicate successful
+         completion.
  */
-__success(return)
-BOOL
-YoriLibGetFullPathNameRelativeTo(
+__success(return == ERROR_SUCCESS)
+DWORD
+YoriLibGetFullPathNameRelativeToInternal(
     __in PYORI_STRING PrimaryDirectory,
     __in PYORI_STRING FileName,
     __in BOOL ReturnEscapedPath,
+    __in BOOLEAN AllowAllocation,
     __inout PYORI_STRING Buffer,
     __deref_opt_out_opt LPTSTR* lpFilePart
     )
 {
     YORI_LIB_FULL_PATH_TYPE PathType;
     BOOLEAN FreeOnFailure = FALSE;
+    BOOLEAN UseCache;
 
     YORI_STRING StartOfRelativePath;
+    PYORI_STRING KeyDirectory;
+    LPTSTR FilePart;
 
     DWORD Result;
 
@@ -1406,29 +1487,57 @@ YoriLibGetFullPathNameRelativeTo(
                                                  &PathType,
                                                  &StartOfRelativePath);
     if (Result != ERROR_SUCCESS) {
-        SetLastError(Result);
-        return FALSE;
+        return Result;
+    }
+
+    if (PathType.Flags.DriveRelativePath) {
+        return ERROR_BAD_PATHNAME;
     }
 
     //
-    //  If it's a relative case, get the current directory, and generate an
-    //  "absolute" form of the name.  If it's an absolute case, prepend
+    //  A fully specified name does not depend on the primary directory, so
+    //  it can be found in the cache regardless of the directory.  Merging a
+    //  path without a drive with a UNC primary directory modifies the
+    //  primary directory, so the key would not be reproduced.
+    //
+
+    UseCache = TRUE;
+    KeyDirectory = NULL;
+    FilePart = NULL;
+    if (PathType.Flags.RelativePath) {
+        KeyDirectory = PrimaryDirectory;
+    } else if (PathType.Flags.AbsoluteWithoutDrive) {
+        UseCache = FALSE;
+    }
+
+    if (UseCache) {
+        Result = YoriLibFullPathCacheLookup(KeyDirectory,
+                                            FALSE,
+                                            FileName,
+                                            ReturnEscapedPath,
+                                            AllowAllocation,
+                                            Buffer,
+                                            lpFilePart);
+        if (Result != ERROR_FILE_NOT_FOUND) {
+            return Result;
+        }
+    }
+
+    //
+    //  If it's a relative case, generate an "absolute" form of the name
+    //  from the primary directory.  If it's an absolute case, prepend
     //  \\?\ and have a buffer we allocate for subsequent munging.
     //
 
-    if (PathType.Flags.DriveRelativePath) {
-        SetLastError(ERROR_BAD_PATHNAME);
-        return FALSE;
-    } else if (PathType.Flags.RelativePath ||
-               PathType.Flags.AbsoluteWithoutDrive) {
+    if (PathType.Flags.RelativePath ||
+        PathType.Flags.AbsoluteWithoutDrive) {
 
         YORI_LIB_FULL_PATH_TYPE PrimaryDirPathType;
         Result = YoriLibGetFullPathDeterminePathType(PrimaryDirectory,
                                                      &PrimaryDirPathType,
                                                      NULL);
         if (Result != ERROR_SUCCESS) {
-            SetLastError(Result);
-            return FALSE;
+            return Result;
         }
 
         //
@@ -1441,14 +1550,14 @@ YoriLibGetFullPathNameRelativeTo(
             PrimaryDirPathType.Flags.AbsoluteWithoutDrive ||
             PrimaryDirPathType.Flags.DriveRelativePath) {
 
-            SetLastError(ERROR_BAD_PATHNAME);
-            return FALSE;
+            return ERROR_BAD_PATHNAME;
         }
 
         Result = YoriLibFullPathMergeRootWithRelative(PrimaryDirectory,
                                                       &StartOfRelativePath,
                                                       ReturnEscapedPath,
                                                       &PathType,
+                                                      AllowAllocation,
                                                       Buffer,
                                                       &FreeOnFailure);
     } else {
@@ -1456,29 +1565,132 @@ YoriLibGetFullPathNameRelativeTo(
         Result = YoriLibFullPathNormalize(FileName,
                                           ReturnEscapedPath,
                                           &PathType,
+                                          AllowAllocation,
                                           Buffer,
                                           &FreeOnFailure);
 
     }
 
+    if (Result == ERROR_SUCCESS) {
+        Result = YoriLibGetFullPathSquashRelativeComponents(Buffer, &PathType, ReturnEscapedPath, &FilePart);
+    }
+
     if (Result != ERROR_SUCCESS) {
         if (FreeOnFailure) {
             YoriLibFreeStringContents(Buffer);
         }
-        SetLastError(Result);
+        return Result;
+    }
+
+    if (UseCache) {
+        YoriLibFullPathCacheInsert(KeyDirectory,
+                                   FALSE,
+                                   FileName,
+                                   ReturnEscapedPath,
+                                   Buffer,
+                                   FilePart);
+    }
+
+    if (lpFilePart != NULL) {
+        *lpFilePart = FilePart;
+    }
+
+    return ERROR_SUCCESS;
+}
+
+/**
+ GetFullPathName where the "current" directory is specified.  Note that this
+ version cannot traverse across drives without looking at the current
+ directory for each drive, which the function does not take as input, so
+ traversing drives is only possible with a fully formed path.
+ This function will update a YORI_STRING, including allocating if necessary,
+ to contain a buffer containing the path.  If this function allocates the
+ buffer, the caller is expected to free this by calling
+ @ref YoriLibFreeStringContents.
+
+ @param PrimaryDirectory The directory to use as a "current" directory.
+
+ @param FileName A file name, which may be fully specified or may be relative
+        to PrimaryDirectory.
+
+ @param ReturnEscapedPath If TRUE, the returned path is in \\?\ form.
+        If FALSE, it is in regular Win32 form.
+
+ @param Buffer On successful completion, updated to point to a newly
+        allocated buffer containing the full path form of the file name.
+        Note this is returned as a NULL terminated YORI_STRING, suitable
+        for use in YORI_STRING or NULL terminated functions.
+
+ @param lpFilePart If specified, on successful completion, updated to point
+        to the beginning of the file name component of the path, in the same
+        allocation as lpBuffer.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriLibGetFullPathNameRelativeTo(
+    __in PYORI_STRING PrimaryDirectory,
+    __in PYORI_STRING FileName,
+    __in BOOL ReturnEscapedPath,
+    __inout PYORI_STRING Buffer,
+    __deref_opt_out_opt LPTSTR* lpFilePart
+    )
+{
+    DWORD Result;
+
+    Result = YoriLibGetFullPathNameRelativeToInternal(PrimaryDirectory, FileName, ReturnEscapedPath, TRUE, Buffer, lpFilePart);
+    SetLastError(Result);
+    if (Result != ERROR_SUCCESS) {
         return FALSE;
     }
 
-    Result = YoriLibGetFullPathSquashRelativeComponents(Buffer, &PathType, ReturnEscapedPath, lpFilePart);
+    return TRUE;
+}
+
+/**
+ GetFullPathName where the "current" directory is specified, writing the
+ result into a caller supplied buffer without allocating.  This behaves the
+ same as @ref YoriLibGetFullPathNameRelativeTo except that if Buffer is too
+ small to contain the result, the function fails and GetLastError returns
+ ERROR_INSUFFICIENT_BUFFER.  Callers can use a stack buffer for the common
+ case and fall back to @ref YoriLibGetFullPathNameRelativeTo .
+
+ @param PrimaryDirectory The directory to use as a "current" directory.
+
+ @param FileName A file name, which may be fully specified or may be relative
+        to PrimaryDirectory.
+
+ @param ReturnEscapedPath If TRUE, the returned path is in \\?\ form.
+        If FALSE, it is in regular Win32 form.
+
+ @param Buffer Pointer to a string whose existing buffer is populated with
+        the full path form of the file name, NULL terminated.
+
+ @param lpFilePart If specified, on successful completion, updated to point
+        to the beginning of the file name component of the path within
+        Buffer.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriLibGetFullPathNameRelativeToBuffer(
+    __in PYORI_STRING PrimaryDirectory,
+    __in PYORI_STRING FileName,
+    __in BOOL ReturnEscapedPath,
+    __inout PYORI_STRING Buffer,
+    __deref_opt_out_opt LPTSTR* lpFilePart
+    )
+{
+    DWORD Result;
+
+    Result = YoriLibGetFullPathNameRelativeToInternal(PrimaryDirectory, FileName, ReturnEscapedPath, FALSE, Buffer, lpFilePart);
+    SetLastError(Result);
     if (Result != ERROR_SUCCESS) {
-        if (FreeOnFailure) {
-            YoriLibFreeStringContents(Buffer);
-        }
-        SetLastError(Result);
         return FALSE;
     }
 
-    SetLastError(0);
     return TRUE;
 }
 
@@ -0,0 +1,2075 @@
+/**
+ * @file lib/gitstat.c
+ *
+ * Yori native query of git repository status
+ *
+ * This module reports the branch, upstream state and whether tracked files
+ * are modified for a git repository by reading the repository's files
+ * directly, so that prompts and completion scripts can display this without
+ * executing git.  The index is mapped and each tracked file's size and
+ * timestamp are compared against the working tree, which is the same check
+ * git performs before hashing file contents.  The most recent result is
+ * cached and remains valid until a change notification indicates that the
+ * working tree or repository has changed or the index is rewritten.
+ *
+ * Copyright (c) 2026 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "yoripch.h"
+#include "yorilib.h"
+
+/**
+ The largest HEAD, ref, config or gitdir file that will be read.  These are
+ normally tiny; anything larger is not something this module understands.
+ */
+#define YORILIB_GIT_MAX_SMALL_FILE (256 * 1024)
+
+/**
+ The number of bytes in a SHA-1 object name.
+ */
+#define YORILIB_GIT_SHA1_LENGTH (20)
+
+/**
+ The number of bytes in a SHA-256 object name.
+ */
+#define YORILIB_GIT_SHA256_LENGTH (32)
+
+/**
+ The number of characters of an object name to display for a detached HEAD.
+ */
+#define YORILIB_GIT_ABBREV_LENGTH (7)
+
+/**
+ The maximum number of symbolic references to follow when resolving a ref.
+ */
+#define YORILIB_GIT_MAX_SYMREF_DEPTH (5)
+
+/**
+ The maximum number of directory levels to descend when enumerating loose
+ branches.
+ */
+#define YORILIB_GIT_MAX_REF_DEPTH (32)
+
+/**
+ The maximum length, in bytes, of a path stored in the index.
+ */
+#define YORILIB_GIT_MAX_INDEX_PATH (4096)
+
+/**
+ The size of the fixed portion of an index entry that precedes the object
+ name.  This consists of ctime, mtime, dev, ino, mode, uid, gid and size.
+ */
+#define YORILIB_GIT_INDEX_STAT_LENGTH (40)
+
+/**
+ The index entry flag indicating the entry should be assumed unchanged.
+ */
+#define YORILIB_GIT_INDEX_ASSUME_VALID (0x8000)
+
+/**
+ The index entry flag indicating a second flags field follows.
+ */
+#define YORILIB_GIT_INDEX_EXTENDED (0x4000)
+
+/**
+ The mask of the index entry flags describing the merge stage.
+ */
+#define YORILIB_GIT_INDEX_STAGE_MASK (0x3000)
+
+/**
+ The extended index entry flag indicating the file is not checked out.
+ */
+#define YORILIB_GIT_INDEX_SKIP_WORKTREE (0x4000)
+
+/**
+ The extended index entry flag indicating a file was added with intent to
+ add, which git status reports as a new file.
+ */
+#define YORILIB_GIT_INDEX_INTENT_TO_ADD (0x2000)
+
+/**
+ The mask of the index entry mode describing the object type.
+ */
+#define YORILIB_GIT_MODE_TYPE_MASK (0170000)
+
+/**
+ The index entry mode type of a symbolic link.
+ */
+#define YORILIB_GIT_MODE_SYMLINK (0120000)
+
+/**
+ The index entry mode type of a submodule.
+ */
+#define YORILIB_GIT_MODE_GITLINK (0160000)
+
+/**
+ The difference between the NT epoch of 1601 and the UNIX epoch of 1970,
+ in 100ns units.
+ */
+#define YORILIB_GIT_UNIX_EPOCH_OFFSET (116444736000000000)
+
+/**
+ The changes within a working tree or repository which invalidate cached
+ status.
+ */
+#define YORILIB_GIT_NOTIFY_FILTER (FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_DIR_NAME | FILE_NOTIFY_CHANGE_SIZE | FILE_NOTIFY_CHANGE_LAST_WRITE)
+
+/**
+ Read a big endian 32 bit value from a byte buffer.
+ */
+#define YORILIB_GIT_READ_BE32(p) \
+    (((DWORD)(p)[0] << 24) | ((DWORD)(p)[1] << 16) | ((DWORD)(p)[2] << 8) | (DWORD)(p)[3])
+
+/**
+ Read a big endian 16 bit value from a byte buffer.
+ */
+#define YORILIB_GIT_READ_BE16(p) \
+    (WORD)(((WORD)(p)[0] << 8) | (WORD)(p)[1])
+
+/**
+ The locations of a repository's files.
+ */
+typedef struct _YORILIB_GIT_REPOSITORY {
+
+    /**
+     The top level directory of the working tree.
+     */
+    YORI_STRING WorkTree;
+
+    /**
+     The directory containing HEAD and the index for this working tree.
+     */
+    YORI_STRING GitDir;
+
+    /**
+     The directory containing refs, packed-refs and config.  For the main
+     working tree this is the same as GitDir; for additional working trees
+     it is the repository they were created from.
+     */
+    YORI_STRING CommonDir;
+
+    /**
+     The contents of the repository's config file, or an empty string if it
+     could not be read.
+     */
+    YORI_STRING Config;
+
+    /**
+     The number of bytes in an object name in this repository.
+     */
+    DWORD HashLength;
+} YORILIB_GIT_REPOSITORY, *PYORILIB_GIT_REPOSITORY;
+
+/**
+ A read only mapped view of a file.
+ */
+typedef struct _YORILIB_GIT_MAPPED_FILE {
+
+    /**
+     The base of the view.  NULL if the file is empty.
+     */
+    PUCHAR Base;
+
+    /**
+     The number of bytes in the view.
+     */
+    DWORD Length;
+
+    /**
+     The last write time of the file when it was opened.
+     */
+    FILETIME LastWriteTime;
+} YORILIB_GIT_MAPPED_FILE, *PYORILIB_GIT_MAPPED_FILE;
+
+/**
+ The most recently returned status, along with the information needed to
+ determine whether it is still current.
+ */
+typedef struct _YORILIB_GIT_STATUS_CACHE {
+
+    /**
+     A mutex synchronizing access to the cache.  NULL if the cache is not
+     enabled.
+     */
+    HANDLE Mutex;
+
+    /**
+     TRUE if the remaining fields describe a cached result.
+     */
+    BOOLEAN Valid;
+
+    /**
+     The directory that the cached result was requested for.
+     */
+    YORI_STRING Directory;
+
+    /**
+     The full path to the index of the repository.
+     */
+    YORI_STRING IndexPath;
+
+    /**
+     The last write time of the index when the result was generated.
+     */
+    FILETIME IndexWriteTime;
+
+    /**
+     A change notification for the working tree.
+     */
+    HANDLE WorkTreeNotify;
+
+    /**
+     A change notification for the repository, if it is not contained
+     within the working tree.  NULL if the repository is within the
+     working tree.
+     */
+    HANDLE CommonDirNotify;
+
+    /**
+     The cached result.
+     */
+    YORI_LIB_GIT_STATUS Status;
+
+} YORILIB_GIT_STATUS_CACHE, *PYORILIB_GIT_STATUS_CACHE;
+
+/**
+ Global state for the git status cache.
+ */
+YORILIB_GIT_STATUS_CACHE YoriLibGitStatusCache;
+
+/**
+ Remove spaces, tabs and newlines from the beginning and end of a string.
+
+ @param String Pointer to the string to trim.
+ */
+VOID
+YoriLibGitTrimWhitespace(
+    __inout PYORI_STRING String
+    )
+{
+    TCHAR Char;
+
+    while (String->LengthInChars > 0) {
+        Char = String->StartOfString[0];
+        if (Char != ' ' && Char != '\t' && Char != '\r' && Char != '\n') {
+            break;
+        }
+        String->StartOfString++;
+        String->LengthInChars--;
+    }
+
+    while (String->LengthInChars > 0) {
+        Char = String->StartOfString[String->LengthInChars - 1];
+        if (Char != ' ' && Char != '\t' && Char != '\r' && Char != '\n') {
+            break;
+        }
+        String->LengthInChars--;
+    }
+}
+
+/**
+ Query the size and timestamps of a file.
+
+ @param FilePath Pointer to the NULL terminated path of the file.
+
+ @param FindData On successful completion, populated with information about
+        the file.
+
+ @return TRUE to indicate the file exists, FALSE if it does not.
+ */
+__success(return)
+BOOLEAN
+YoriLibGitQueryFile(
+    __in PCYORI_STRING FilePath,
+    __out PWIN32_FIND_DATA FindData
+    )
+{
+    HANDLE FindHandle;
+
+    FindHandle = FindFirstFile(FilePath->StartOfString, FindData);
+    if (FindHandle == INVALID_HANDLE_VALUE) {
+        return FALSE;
+    }
+    FindClose(FindHandle);
+    return TRUE;
+}
+
+/**
+ Read a small file and convert its contents from UTF-8.
+
+ @param FilePath Pointer to the NULL terminated path of the file to read.
+
+ @param Contents On successful completion, updated to contain the contents
+        of the file.  The string is NULL terminated.
+
+ @return TRUE to indicate success, FALSE if the file does not exist or could
+         not be read.
+ */
+__success(return)
+BOOLEAN
+YoriLibGitReadFile(
+    __in PCYORI_STRING FilePath,
+    __out PYORI_STRING Contents
+    )
+{
+    HANDLE hFile;
+    DWORD FileSizeLow;
+    DWORD FileSizeHigh;
+    DWORD BytesRead;
+    LPSTR Buffer;
+    YORI_ALLOC_SIZE_T CharsNeeded;
+
+    hFile = CreateFile(FilePath->StartOfString,
+                       GENERIC_READ,
+                       FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                       NULL,
+                       OPEN_EXISTING,
+                       FILE_ATTRIBUTE_NORMAL,
+                       NULL);
+    if (hFile == INVALID_HANDLE_VALUE) {
+        return FALSE;
+    }
+
+    FileSizeLow = GetFileSize(hFile, &FileSizeHigh);
+    if ((FileSizeLow == INVALID_FILE_SIZE && GetLastError() != NO_ERROR) ||
+        FileSizeHigh != 0 ||
+        FileSizeLow > YORILIB_GIT_MAX_SMALL_FILE) {
+
+        CloseHandle(hFile);
+        return FALSE;
+    }
+
+    Buffer = YoriLibMalloc(FileSizeLow + 1);
+    if (Buffer == NULL) {
+        CloseHandle(hFile);
+        return FALSE;
+    }
+
+    if (!ReadFile(hFile, Buffer, FileSizeLow, &BytesRead, NULL)) {
+        YoriLibFree(Buffer);
+        CloseHandle(hFile);
+        return FALSE;
+    }
+    CloseHandle(hFile);
+
+    CharsNeeded = 0;
+    if (BytesRead > 0) {
+        CharsNeeded = (YORI_ALLOC_SIZE_T)MultiByteToWideChar(CP_UTF8, 0, Buffer, BytesRead, NULL, 0);
+    }
+
+    if (!YoriLibAllocateString(Contents, CharsNeeded + 1)) {
+        YoriLibFree(Buffer);
+        return FALSE;
+    }
+
+    if (CharsNeeded > 0) {
+        MultiByteToWideChar(CP_UTF8, 0, Buffer, BytesRead, Contents->StartOfString, CharsNeeded);
+    }
+    Contents->LengthInChars = CharsNeeded;
+    Contents->StartOfString[CharsNeeded] = '\0';
+    YoriLibFree(Buffer);
+    return TRUE;
+}
+
+/**
+ Map a file into memory for reading.
+
+ @param FilePath Pointer to the NULL terminated path of the file to map.
+
+ @param MappedFile On successful completion, updated to describe the view of
+        the file.  The caller should unmap this with
+        @ref YoriLibGitUnmapFile .
+
+ @return TRUE to indicate success, FALSE if the file does not exist or could
+         not be mapped.
+ */
+__success(return)
+BOOLEAN
+YoriLibGitMapFile(
+    __in PCYORI_STRING FilePath,
+    __out PYORILIB_GIT_MAPPED_FILE MappedFile
+    )
+{
+    HANDLE hFile;
+    HANDLE MapHandle;
+    BY_HANDLE_FILE_INFORMATION FileInfo;
+
+    MappedFile->Base = NULL;
+    MappedFile->Length = 0;
+
+    hFile = CreateFile(FilePath->StartOfString,
+                       GENERIC_READ,
+                       FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                       NULL,
+                       OPEN_EXISTING,
+                       FILE_ATTRIBUTE_NORMAL,
+                       NULL);
+    if (hFile == INVALID_HANDLE_VALUE) {
+        return FALSE;
+    }
+
+    if (!GetFileInformationByHandle(hFile, &FileInfo) ||
+        FileInfo.nFileSizeHigh != 0) {
+
+        CloseHandle(hFile);
+        return FALSE;
+    }
+
+    MappedFile->LastWriteTime = FileInfo.ftLastWriteTime;
+
+    //
+    //  Empty files cannot be mapped.
+    //
+
+    if (FileInfo.nFileSizeLow == 0) {
+        CloseHandle(hFile);
+        return TRUE;
+    }
+
+    MapHandle = CreateFileMapping(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(hFile);
+    if (MapHandle == NULL) {
+        return FALSE;
+    }
+
+    MappedFile->Base = MapViewOfFile(MapHandle, FILE_MAP_READ, 0, 0, FileInfo.nFileSizeLow);
+    CloseHandle(MapHandle);
+    if (MappedFile->Base == NULL) {
+        return FALSE;
+    }
+
+    MappedFile->Length = FileInfo.nFileSizeLow;
+    return TRUE;
+}
+
+/**
+ Unmap a file previously mapped with @ref YoriLibGitMapFile .
+
+ @param MappedFile Pointer to the mapped file.
+ */
+VOID
+YoriLibGitUnmapFile(
+    __inout PYORILIB_GIT_MAPPED_FILE MappedFile
+    )
+{
+    if (MappedFile->Base != NULL) {
+        UnmapViewOfFile(MappedFile->Base);
+        MappedFile->Base = NULL;
+    }
+    MappedFile->Length = 0;
+}
+
+/**
+ Construct the path to a file within a directory.  Any forward slashes in
+ the relative name are converted to backslashes.
+
+ @param Directory Pointer to the directory.
+
+ @param RelativeName Pointer to the name of the file within the directory.
+
+ @param FilePath On successful completion, updated to contain the NULL
+        terminated path to the file.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+YoriLibGitBuildPath(
+    __in PCYORI_STRING Directory,
+    __in PCYORI_STRING RelativeName,
+    __out PYORI_STRING FilePath
+    )
+{
+    YORI_ALLOC_SIZE_T Index;
+
+    YoriLibInitEmptyString(FilePath);
+    if (YoriLibYPrintf(FilePath, _T("%y\\%y"), Directory, RelativeName) < 0) {
+        return FALSE;
+    }
+
+    for (Index = Directory->LengthInChars; Index < FilePath->LengthInChars; Index++) {
+        if (FilePath->StartOfString[Index] == '/') {
+            FilePath->StartOfString[Index] = '\\';
+        }
+    }
+
+    return TRUE;
+}
+
+/**
+ Read a small file within a directory.
+
+ @param Directory Pointer to the directory.
+
+ @param RelativeName Pointer to a NULL terminated name of the file within the
+        directory.
+
+ @param Contents On successful completion, updated to contain the contents
+        of the file with any trailing whitespace removed.
+
+ @return TRUE to indicate success, FALSE if the file does not exist or could
+         not be read.
+ */
+__success(return)
+BOOLEAN
+YoriLibGitReadFileInDirectory(
+    __in PCYORI_STRING Directory,
+    __in LPCTSTR RelativeName,
+    __out PYORI_STRING Contents
+    )
+{
+    YORI_STRING Relative;
+    YORI_STRING FilePath;
+    BOOLEAN Result;
+
+    YoriLibConstantString(&Relative, RelativeName);
+    if (!YoriLibGitBuildPath(Directory, &Relative, &FilePath)) {
+        return FALSE;
+    }
+
+    Result = YoriLibGitReadFile(&FilePath, Contents);
+    YoriLibFreeStringContents(&FilePath);
+
+    if (Result) {
+        YoriLibGitTrimWhitespace(Contents);
+    }
+
+    return Result;
+}
+
+/**
+ Resolve a path found in a git metadata file, which may be relative to the
+ directory containing that file, into a path that can be opened.
+
+ @param BaseDirectory Pointer to the directory that a relative path is
+        relative to.
+
+ @param Path Pointer to the path found in the file.
+
+ @param ResolvedPath On successful completion, updated to contain the
+        resolved path.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+YoriLibGitResolveRelativePath(
+    __in PCYORI_STRING BaseDirectory,
+    __in PCYORI_STRING Path,
+    __out PYORI_STRING ResolvedPath
+    )
+{
+    YORI_ALLOC_SIZE_T Index;
+
+    if (Path->LengthInChars == 0) {
+        return FALSE;
+    }
+
+    if ((Path->LengthInChars >= 2 && Path->StartOfString[1] == ':') ||
+        Path->StartOfString[0] == '/' ||
+        Path->StartOfString[0] == '\\') {
+
+        if (!YoriLibCopyString(ResolvedPath, Path)) {
+            return FALSE;
+        }
+
+        for (Index = 0; Index < ResolvedPath->LengthInChars; Index++) {
+            if (ResolvedPath->StartOfString[Index] == '/') {
+                ResolvedPath->StartOfString[Index] = '\\';
+            }
+        }
+
+        return TRUE;
+    }
+
+    return YoriLibGitBuildPath(BaseDirectory, Path, ResolvedPath);
+}
+
+/**
+ Free the locations of a repository's files.
+
+ @param Repository Pointer to the repository to free.
+ */
+VOID
+YoriLibGitFreeRepository(
+    __inout PYORILIB_GIT_REPOSITORY Repository
+    )
+{
+    YoriLibFreeStringContents(&Repository->WorkTree);
+    YoriLibFreeStringContents(&Repository->GitDir);
+    YoriLibFreeStringContents(&Repository->CommonDir);
+    YoriLibFreeStringContents(&Repository->Config);
+}
+
+/**
+ Find the value of a single valued key in a repository's config file.
+ Section and key names are compared case insensitively and subsection names
+ case sensitively, as git does.  If the key is specified more than once,
+ the last value is returned.
+
+ @param Repository Pointer to the repository whose config should be
+        searched.
+
+ @param Section Pointer to the NULL terminated name of the section.
+
+ @param Subsection Optionally points to the name of the subsection.  If
+        NULL, only keys in a section without a subsection are returned.
+
+ @param Key Pointer to the NULL terminated name of the key.
+
+ @param Value On successful completion, updated to point to the value within
+        the config contents.  This string is not allocated and is only valid
+        as long as the repository is.
+
+ @return TRUE if the key was found, FALSE if it was not.
+ */
+__success(return)
+BOOLEAN
+YoriLibGitGetConfigValue(
+    __in PYORILIB_GIT_REPOSITORY Repository,
+    __in LPCTSTR Section,
+    __in_opt PCYORI_STRING Subsection,
+    __in LPCTSTR Key,
+    __out PYORI_STRING Value
+    )
+{
+    YORI_STRING Remaining;
+    YORI_STRING Line;
+    YORI_STRING Name;
+    YORI_STRING ThisSubsection;
+    YORI_ALLOC_SIZE_T Index;
+    BOOLEAN InSection;
+    BOOLEAN Found;
+    BOOLEAN InQuotes;
+
+    YoriLibInitEmptyString(&Remaining);
+    Remaining.StartOfString = Repository->Config.StartOfString;
+    Remaining.LengthInChars = Repository->Config.LengthInChars;
+    InSection = FALSE;
+    Found = FALSE;
+
+    while (Remaining.LengthInChars > 0) {
+
+        //
+        //  Find the next line and advance past it.
+        //
+
+        YoriLibInitEmptyString(&Line);
+        Line.StartOfString = Remaining.StartOfString;
+        for (Index = 0; Index < Remaining.LengthInChars; Index++) {
+            if (Remaining.StartOfString[Index] == '\n') {
+                break;
+            }
+        }
+        Line.LengthInChars = Index;
+        if (Index < Remaining.LengthInChars) {
+            Index++;
+        }
+        Remaining.StartOfString = Remaining.StartOfString + Index;
+        Remaining.LengthInChars = Remaining.LengthInChars - Index;
+
+        YoriLibGitTrimWhitespace(&Line);
+        if (Line.LengthInChars == 0 ||
+            Line.StartOfString[0] == '#' ||
+            Line.StartOfString[0] == ';') {
+
+            continue;
+        }
+
+        //
+        //  Section headers are either [section "subsection"] or the older
+        //  [section.subsection].
+        //
+
+        if (Line.StartOfString[0] == '[') {
+            InSection = FALSE;
+            Line.StartOfString++;
+            Line.LengthInChars--;
+
+            YoriLibInitEmptyString(&Name);
+            Name.StartOfString = Line.StartOfString;
+            for (Index = 0; Index < Line.LengthInChars; Index++) {
+                if (Line.StartOfString[Index] == ']' ||
+                    Line.StartOfString[Index] == ' ' ||
+                    Line.StartOfString[Index] == '\t' ||
+                    Line.StartOfString[Index] == '.') {
+
+                    break;
+                }
+            }
+            Name.LengthInChars = Index;
+
+            YoriLibInitEmptyString(&ThisSubsection);
+            if (Index < Line.LengthInChars && Line.StartOfString[Index] == '.') {
+                Index++;
+                ThisSubsection.StartOfString = &Line.StartOfString[Index];
+                while (Index < Line.LengthInChars && Line.StartOfString[Index] != ']') {
+                    Index++;
+                    ThisSubsection.LengthInChars++;
+                }
+            } else {
+                while (Index < Line.LengthInChars && Line.StartOfString[Index] != '"' && Line.StartOfString[Index] != ']') {
+                    Index++;
+                }
+                if (Index < Line.LengthInChars && Line.StartOfString[Index] == '"') {
+                    Index++;
+                    ThisSubsection.StartOfString = &Line.StartOfString[Index];
+                    while (Index < Line.LengthInChars && Line.StartOfString[Index] != '"') {
+                        if (Line.StartOfString[Index] == '\\' && Index + 1 < Line.LengthInChars) {
+                            Index++;
+                            ThisSubsection.LengthInChars++;
+                        }
+                        Index++;
+                        ThisSubsection.LengthInChars++;
+                    }
+                }
+            }
+
+            if (YoriLibCompareStringLitIns(&Name, Section) == 0) {
+                if (Subsection == NULL) {
+                    if (ThisSubsection.StartOfString == NULL) {
+                        InSection = TRUE;
+                    }
+                } else if (YoriLibCompareString(&ThisSubsection, Subsection) == 0) {
+                    InSection = TRUE;
+                }
+            }
+            continue;
+        }
+
+        if (!InSection) {
+            continue;
+        }
+
+        //
+        //  Keys are of the form name = value.
+        //
+
+        YoriLibInitEmptyString(&Name);
+        Name.StartOfString = Line.StartOfString;
+        for (Index = 0; Index < Line.LengthInChars; Index++) {
+            if (Line.StartOfString[Index] == '=' ||
+                Line.StartOfString[Index] == ' ' ||
+                Line.StartOfString[Index] == '\t') {
+
+                break;
+            }
+        }
+        Name.LengthInChars = Index;
+
+        if (YoriLibCompareStringLitIns(&Name, Key) != 0) {
+            continue;
+        }
+
+        while (Index < Line.LengthInChars && Line.StartOfString[Index] != '=') {
+            Index++;
+        }
+        if (Index < Line.LengthInChars) {
+            Index++;
+        }
+
+        YoriLibInitEmptyString(Value);
+        Value->StartOfString = &Line.StartOfString[Index];
+        Value->LengthInChars = Line.LengthInChars - Index;
+
+        //
+        //  Remove any trailing comment, and surrounding quotes.
+        //
+
+        InQuotes = FALSE;
+        for (Index = 0; Index < Value->LengthInChars; Index++) {
+            if (Value->StartOfString[Index] == '"') {
+                InQuotes = (BOOLEAN)!InQuotes;
+            } else if (!InQuotes &&
+                       (Value->StartOfString[Index] == '#' || Value->StartOfString[Index] == ';')) {
+                Value->LengthInChars = Index;
+                break;
+            }
+        }
+
+        YoriLibGitTrimWhitespace(Value);
+        if (Value->LengthInChars >= 2 &&
+            Value->StartOfString[0] == '"' &&
+            Value->StartOfString[Value->LengthInChars - 1] == '"') {
+
+            Value->StartOfString++;
+            Value->LengthInChars = Value->LengthInChars - 2;
+        }
+
+        Found = TRUE;
+    }
+
+    return Found;
+}
+
+/**
+ Find the git repository containing a directory.
+
+ @param Directory Pointer to a fully qualified directory.
+
+ @param Repository On successful completion, updated to contain the
+        locations of the repository's files.
+
+ @return TRUE to indicate a repository was found, FALSE if the directory is
+         not within a repository.
+ */
+__success(return)
+BOOLEAN
+YoriLibGitFindRepository(
+    __in PCYORI_STRING Directory,
+    __out PYORILIB_GIT_REPOSITORY Repository
+    )
+{
+    YORI_STRING Current;
+    YORI_STRING DotGit;
+    YORI_STRING Contents;
+    YORI_STRING Relative;
+    YORI_STRING Value;
+    YORI_ALLOC_SIZE_T Index;
+    DWORD Attributes;
+    BOOLEAN Found;
+
+    ZeroMemory(Repository, sizeof(YORILIB_GIT_REPOSITORY));
+    Repository->HashLength = YORILIB_GIT_SHA1_LENGTH;
+
+    if (!YoriLibCopyString(&Current, Directory)) {
+        return FALSE;
+    }
+
+    while (Current.LengthInChars > 0 &&
+           Current.StartOfString[Current.LengthInChars - 1] == '\\') {
+        Current.LengthInChars--;
+    }
+
+    //
+    //  Walk up from the directory looking for a .git directory, or a .git
+    //  file pointing to the repository used by this working tree.
+    //
+
+    Found = FALSE;
+    YoriLibInitEmptyString(&DotGit);
+    while (Current.LengthInChars > 0) {
+        YoriLibConstantString(&Relative, _T(".git"));
+        if (!YoriLibGitBuildPath(&Current, &Relative, &DotGit)) {
+            break;
+        }
+
+        Attributes = GetFileAttributes(DotGit.StartOfString);
+        if (Attributes != INVALID_FILE_ATTRIBUTES) {
+            if (Attributes & FILE_ATTRIBUTE_DIRECTORY) {
+                memcpy(&Repository->GitDir, &DotGit, sizeof(YORI_STRING));
+                YoriLibInitEmptyString(&DotGit);
+                Found = TRUE;
+                break;
+            }
+
+            if (YoriLibGitReadFile(&DotGit, &Contents)) {
+                YoriLibGitTrimWhitespace(&Contents);
+                if (YoriLibCompareStringLitCnt(&Contents, _T("gitdir:"), sizeof("gitdir:") - 1) == 0) {
+                    YoriLibInitEmptyString(&Value);
+                    Value.StartOfString = &Contents.StartOfString[sizeof("gitdir:") - 1];
+                    Value.LengthInChars = Contents.LengthInChars - (sizeof("gitdir:") - 1);
+                    YoriLibGitTrimWhitespace(&Value);
+                    if (YoriLibGitResolveRelativePath(&Current, &Value, &Repository->GitDir)) {
+                        Found = TRUE;
+                    }
+                }
+                YoriLibFreeStringContents(&Contents);
+                if (Found) {
+                    break;
+                }
+            }
+        }
+
+        YoriLibFreeStringContents(&DotGit);
+
+        //
+        //  Move to the parent, stopping when there is no parent.
+        //
+
+        for (Index = Current.LengthInChars; Index > 0; Index--) {
+            if (Current.StartOfString[Index - 1] == '\\') {
+                break;
+            }
+        }
+
+        if (Index <= 1) {
+            break;
+        }
+
+        Current.LengthInChars = Index - 1;
+    }
+
+    YoriLibFreeStringContents(&DotGit);
+
+    if (!Found) {
+        YoriLibFreeStringContents(&Current);
+        return FALSE;
+    }
+
+    while (Current.LengthInChars > 0 &&
+           Current.StartOfString[Current.LengthInChars - 1] == '\\') {
+        Current.LengthInChars--;
+    }
+
+    if (!YoriLibCopyString(&Repository->WorkTree, &Current)) {
+        YoriLibFreeStringContents(&Current);
+        YoriLibGitFreeRepository(Repository);
+        return FALSE;
+    }
+    YoriLibFreeStringContents(&Current);
+
+    //
+    //  Additional working trees refer to the repository they were created
+    //  from, which contains refs and config.
+    //
+
+    if (YoriLibGitReadFileInDirectory(&Repository->GitDir, _T("commondir"), &Contents)) {
+        if (!YoriLibGitResolveRelativePath(&Repository->GitDir, &Contents, &Repository->CommonDir)) {
+            YoriLibInitEmptyString(&Repository->CommonDir);
+        }
+        YoriLibFreeStringContents(&Contents);
+    }
+
+    if (Repository->CommonDir.LengthInChars == 0) {
+        if (!YoriLibCopyString(&Repository->CommonDir, &Repository->GitDir)) {
+            YoriLibGitFreeRepository(Repository);
+            return FALSE;
+        }
+    }
+
+    YoriLibConstantString(&Relative, _T("config"));
+    if (YoriLibGitBuildPath(&Repository->CommonDir, &Relative, &DotGit)) {
+        if (!YoriLibGitReadFile(&DotGit, &Repository->Config)) {
+            YoriLibInitEmptyString(&Repository->Config);
+        }
+        YoriLibFreeStringContents(&DotGit);
+    }
+
+    if (YoriLibGitGetConfigValue(Repository, _T("extensions"), NULL, _T("objectformat"), &Value) &&
+        YoriLibCompareStringLitIns(&Value, _T("sha256")) == 0) {
+
+        Repository->HashLength = YORILIB_GIT_SHA256_LENGTH;
+    }
+
+    return TRUE;
+}
+
+/**
+ Check whether a string contains a hex object name, and if so, copy it.
+
+ @param Repository Pointer to the repository, which defines the length of
+        object names.
+
+ @param String Pointer to the string which may start with an object name.
+
+ @param Hash On successful completion, populated with the NULL terminated
+        object name.  This must be YORI_LIB_GIT_MAX_HASH_CHARS in length.
+
+ @return TRUE if the string starts with an object name, FALSE if it does
+         not.
+ */
+__success(return)
+BOOLEAN
+YoriLibGitCopyHash(
+    __in PYORILIB_GIT_REPOSITORY Repository,
+    __in PCYORI_STRING String,
+    __out_ecount(YORI_LIB_GIT_MAX_HASH_CHARS) LPTSTR Hash
+    )
+{
+    DWORD Index;
+    DWORD HexLength;
+    TCHAR Char;
+
+    HexLength = Repository->HashLength * 2;
+    if (String->LengthInChars < HexLength) {
+        return FALSE;
+    }
+
+    for (Index = 0; Index < HexLength; Index++) {
+        Char = String->StartOfString[Index];
+        if (!((Char >= '0' && Char <= '9') ||
+              (Char >= 'a' && Char <= 'f') ||
+              (Char >= 'A' && Char <= 'F'))) {
+            return FALSE;
+        }
+        Hash[Index] = Char;
+    }
+    Hash[HexLength] = '\0';
+    return TRUE;
+}
+
+/**
+ Look for a ref in the repository's packed-refs file.
+
+ @param Repository Pointer to the repository.
+
+ @param RefName Pointer to the full name of the ref, such as
+        refs/heads/main.
+
+ @param Hash On successful completion, populated with the NULL terminated
+        object name that the ref refers to.
+
+ @return TRUE if the ref was found, FALSE if it was not.
+ */
+__success(return)
+BOOLEAN
+YoriLibGitResolvePackedRef(
+    __in PYORILIB_GIT_REPOSITORY Repository,
+    __in PCYORI_STRING RefName,
+    __out_ecount(YORI_LIB_GIT_MAX_HASH_CHARS) LPTSTR Hash
+    )
+{
+    YORILIB_GIT_MAPPED_FILE MappedFile;
+    YORI_STRING Relative;
+    YORI_STRING FilePath;
+    LPSTR NarrowRefName;
+    DWORD NarrowLength;
+    DWORD HexLength;
+    DWORD Offset;
+    DWORD LineEnd;
+    DWORD Index;
+    BOOLEAN Found;
+
+    YoriLibConstantString(&Relative, _T("packed-refs"));
+    if (!YoriLibGitBuildPath(&Repository->CommonDir, &Relative, &FilePath)) {
+        return FALSE;
+    }
+
+    if (!YoriLibGitMapFile(&FilePath, &MappedFile)) {
+        YoriLibFreeStringContents(&FilePath);
+        return FALSE;
+    }
+    YoriLibFreeStringContents(&FilePath);
+
+    //
+    //  The file is searched as bytes, so convert the ref name to UTF-8 to
+    //  compare against it.
+    //
+
+    NarrowLength = (DWORD)WideCharToMultiByte(CP_UTF8, 0, RefName->StartOfString, RefName->LengthInChars, NULL, 0, NULL, NULL);
+    NarrowRefName = YoriLibMalloc(NarrowLength + 1);
+    if (NarrowRefName == NULL) {
+        YoriLibGitUnmapFile(&MappedFile);
+        return FALSE;
+    }
+    WideCharToMultiByte(CP_UTF8, 0, RefName->StartOfString, RefName->LengthInChars, NarrowRefName, NarrowLength, NULL, NULL);
+
+    //
+    //  Each line is an object name, a space, and the ref name.  Lines
+    //  starting with # are comments and lines starting with ^ are the
+    //  target of the previous annotated tag.
+    //
+
+    HexLength = Repository->HashLength * 2;
+    Found = FALSE;
+    Offset = 0;
+    while (Offset < MappedFile.Length) {
+        for (LineEnd = Offset; LineEnd < MappedFile.Length; LineEnd++) {
+            if (MappedFile.Base[LineEnd] == '\n') {
+                break;
+            }
+        }
+
+        if (MappedFile.Base[Offset] != '#' &&
+            MappedFile.Base[Offset] != '^' &&
+            LineEnd - Offset >= HexLength + 1 + NarrowLength &&
+            MappedFile.Base[Offset + HexLength] == ' ') {
+
+            Index = LineEnd - Offset - HexLength - 1;
+            if (Index > NarrowLength && MappedFile.Base[LineEnd - 1] == '\r') {
+                Index--;
+            }
+
+            if (Index == NarrowLength &&
+                memcmp(&MappedFile.Base[Offset + HexLength + 1], NarrowRefName, NarrowLength) == 0) {
+
+                for (Index = 0; Index < HexLength; Index++) {
+                    Hash[Index] = MappedFile.Base[Offset + Index];
+                }
+                Hash[HexLength] = '\0';
+                Found = TRUE;
+                break;
+            }
+        }
+
+        Offset = LineEnd + 1;
+    }
+
+    YoriLibFree(NarrowRefName);
+    YoriLibGitUnmapFile(&MappedFile);
+    return Found;
+}
+
+/**
+ Resolve a ref to the object it refers to.  Loose refs are checked first,
+ followed by packed refs.  Symbolic refs are followed.
+
+ @param Repository Pointer to the repository.
+
+ @param RefName Pointer to the full name of the ref, such as
+        refs/heads/main.
+
+ @param Hash On successful completion, populated with the NULL terminated
+        object name that the ref refers to.
+
+ @return TRUE if the ref was resolved, FALSE if it was not.
+ */
+__success(return)
+BOOLEAN
+YoriLibGitResolveRef(
+    __in PYORILIB_GIT_REPOSITORY Repository,
+    __in PCYORI_STRING RefName,
+    __out_ecount(YORI_LIB_GIT_MAX_HASH_CHARS) LPTSTR Hash
+    )
+{
+    YORI_STRING CurrentRef;
+    YORI_STRING FilePath;
+    YORI_STRING Contents;
+    DWORD Depth;
+    BOOLEAN Result;
+
+    YoriLibInitEmptyString(&CurrentRef);
+    CurrentRef.StartOfString = RefName->StartOfString;
+    CurrentRef.LengthInChars = RefName->LengthInChars;
+    YoriLibInitEmptyString(&Contents);
+    Result = FALSE;
+
+    for (Depth = 0; Depth < YORILIB_GIT_MAX_SYMREF_DEPTH; Depth++) {
+        if (!YoriLibGitBuildPath(&Repository->CommonDir, &CurrentRef, &FilePath)) {
+            break;
+        }
+
+        if (!YoriLibGitReadFile(&FilePath, &Contents)) {
+            YoriLibFreeStringContents(&FilePath);
+            Result = YoriLibGitResolvePackedRef(Repository, &CurrentRef, Hash);
+            break;
+        }
+        YoriLibFreeStringContents(&FilePath);
+
+        YoriLibGitTrimWhitespace(&Contents);
+
+        if (YoriLibCompareStringLitCnt(&Contents, _T("ref:"), sizeof("ref:") - 1) != 0) {
+            Result = YoriLibGitCopyHash(Repository, &Contents, Hash);
+            break;
+        }
+
+        //
+        //  Follow the symbolic ref.  The new name is within Contents, which
+        //  is retained until the next iteration has finished with it.
+        //
+
+        YoriLibFreeStringContents(&CurrentRef);
+        memcpy(&CurrentRef, &Contents, sizeof(YORI_STRING));
+        CurrentRef.StartOfString = CurrentRef.StartOfString + sizeof("ref:") - 1;
+        CurrentRef.LengthInChars = CurrentRef.LengthInChars - (sizeof("ref:") - 1);
+        YoriLibGitTrimWhitespace(&CurrentRef);
+        YoriLibInitEmptyString(&Contents);
+    }
+
+    YoriLibFreeStringContents(&Contents);
+    YoriLibFreeStringContents(&CurrentRef);
+    return Result;
+}
+
+/**
+ Determine whether any tracked file in the working tree differs from the
+ index.  This compares the size and modification time recorded in the index
+ against each file, which is the same check git performs before hashing
+ file contents.  Untracked files are not considered.
+
+ @param Repository Pointer to the repository.
+
+ @param IndexWriteTime On successful completion, updated to contain the
+        last write time of the index.
+
+ @param Modified On successful completion, set to TRUE if any tracked file
+        appears to be modified, missing or unmerged.
+
+ @return TRUE to indicate the index was examined, FALSE if it does not exist
+         or could not be parsed.
+ */
+__success(return)
+BOOLEAN
+YoriLibGitCheckIndex(
+    __in PYORILIB_GIT_REPOSITORY Repository,
+    __out PFILETIME IndexWriteTime,
+    __out PBOOLEAN Modified
+    )
+{
+    YORILIB_GIT_MAPPED_FILE MappedFile;
+    YORI_STRING Relative;
+    YORI_STRING FilePath;
+    WIN32_FIND_DATA FileData;
+    LARGE_INTEGER WriteTime;
+    PUCHAR Entry;
+    PUCHAR PathBuffer;
+    DWORD Version;
+    DWORD EntryCount;
+    DWORD EntryIndex;
+    DWORD Offset;
+    DWORD EndOfEntries;
+    DWORD FixedLength;
+    DWORD PathLength;
+    DWORD PreviousPathLength;
+    DWORD SuffixLength;
+    DWORD Strip;
+    DWORD Mode;
+    DWORD Size;
+    DWORD MtimeSeconds;
+    DWORD MtimeNanoseconds;
+    DWORD Index;
+    WORD Flags;
+    WORD ExtendedFlags;
+    UCHAR Byte;
+    YORI_ALLOC_SIZE_T CharsConverted;
+    BOOLEAN Result;
+
+    *Modified = FALSE;
+
+    YoriLibConstantString(&Relative, _T("index"));
+    if (!YoriLibGitBuildPath(&Repository->GitDir, &Relative, &FilePath)) {
+        return FALSE;
+    }
+
+    if (!YoriLibGitMapFile(&FilePath, &MappedFile)) {
+        YoriLibFreeStringContents(&FilePath);
+        return FALSE;
+    }
+    YoriLibFreeStringContents(&FilePath);
+
+    *IndexWriteTime = MappedFile.LastWriteTime;
+
+    //
+    //  The index consists of a header, entries, extensions, and a trailing
+    //  checksum.
+    //
+
+    if (MappedFile.Length < 12 + Repository->HashLength ||
+        memcmp(MappedFile.Base, "DIRC", 4) != 0) {
+
+        YoriLibGitUnmapFile(&MappedFile);
+        return FALSE;
+    }
+
+    Version = YORILIB_GIT_READ_BE32(&MappedFile.Base[4]);
+    EntryCount = YORILIB_GIT_READ_BE32(&MappedFile.Base[8]);
+    if (Version < 2 || Version > 4) {
+        YoriLibGitUnmapFile(&MappedFile);
+        return FALSE;
+    }
+
+    //
+    //  Allocate a buffer for each path in UTF-8, which is needed because
+    //  version 4 stores each path relative to the previous one, and a buffer
+    //  for the full path to each file.
+    //
+
+    PathBuffer = YoriLibMalloc(YORILIB_GIT_MAX_INDEX_PATH);
+    if (PathBuffer == NULL) {
+        YoriLibGitUnmapFile(&MappedFile);
+        return FALSE;
+    }
+
+    if (!YoriLibAllocateString(&FilePath, Repository->WorkTree.LengthInChars + 1 + YORILIB_GIT_MAX_INDEX_PATH + 1)) {
+        YoriLibFree(PathBuffer);
+        YoriLibGitUnmapFile(&MappedFile);
+        return FALSE;
+    }
+
+    memcpy(FilePath.StartOfString, Repository->WorkTree.StartOfString, Repository->WorkTree.LengthInChars * sizeof(TCHAR));
+    FilePath.StartOfString[Repository->WorkTree.LengthInChars] = '\\';
+
+    Result = TRUE;
+    FixedLength = YORILIB_GIT_INDEX_STAT_LENGTH + Repository->HashLength + sizeof(WORD);
+    EndOfEntries = MappedFile.Length - Repository->HashLength;
+    Offset = 12;
+    PreviousPathLength = 0;
+
+    for (EntryIndex = 0; EntryIndex < EntryCount; EntryIndex++) {
+
+        if (Offset + FixedLength > EndOfEntries) {
+            Result = FALSE;
+            break;
+        }
+
+        Entry = &MappedFile.Base[Offset];
+        MtimeSeconds = YORILIB_GIT_READ_BE32(&Entry[8]);
+        MtimeNanoseconds = YORILIB_GIT_READ_BE32(&Entry[12]);
+        Mode = YORILIB_GIT_READ_BE32(&Entry[24]);
+        Size = YORILIB_GIT_READ_BE32(&Entry[36]);
+        Flags = YORILIB_GIT_READ_BE16(&Entry[YORILIB_GIT_INDEX_STAT_LENGTH + Repository->HashLength]);
+        Offset = Offset + FixedLength;
+
+        ExtendedFlags = 0;
+        if (Flags & YORILIB_GIT_INDEX_EXTENDED) {
+            if (Version < 3 || Offset + sizeof(WORD) > EndOfEntries) {
+                Result = FALSE;
+                break;
+            }
+            ExtendedFlags = YORILIB_GIT_READ_BE16(&MappedFile.Base[Offset]);
+            Offset = Offset + sizeof(WORD);
+        }
+
+        //
+        //  Version 4 paths start with a number of bytes to remove from the
+        //  previous path, followed by a NULL terminated suffix.  Earlier
+        //  versions contain the full NULL terminated path, padded so each
+        //  entry is a multiple of 8 bytes.
+        //
+
+        if (Version == 4) {
+            if (Offset >= EndOfEntries) {
+                Result = FALSE;
+                break;
+            }
+            Byte = MappedFile.Base[Offset++];
+            Strip = Byte & 0x7f;
+            while ((Byte & 0x80) && Offset < EndOfEntries) {
+                Byte = MappedFile.Base[Offset++];
+                Strip = ((Strip + 1) << 7) | (Byte & 0x7f);
+            }
+
+            if (Strip > PreviousPathLength) {
+                Result = FALSE;
+                break;
+            }
+            PathLength = PreviousPathLength - Strip;
+
+            for (SuffixLength = 0; Offset + SuffixLength < EndOfEntries; SuffixLength++) {
+                if (MappedFile.Base[Offset + SuffixLength] == '\0') {
+                    break;
+                }
+            }
+
+            if (Offset + SuffixLength >= EndOfEntries ||
+                PathLength + SuffixLength >= YORILIB_GIT_MAX_INDEX_PATH) {
+                Result = FALSE;
+                break;
+            }
+
+            memcpy(&PathBuffer[PathLength], &MappedFile.Base[Offset], SuffixLength);
+            PathLength = PathLength + SuffixLength;
+            Offset = Offset + SuffixLength + 1;
+        } else {
+            for (PathLength = 0; Offset + PathLength < EndOfEntries; PathLength++) {
+                if (MappedFile.Base[Offset + PathLength] == '\0') {
+                    break;
+                }
+            }
+
+            if (Offset + PathLength >= EndOfEntries ||
+                PathLength >= YORILIB_GIT_MAX_INDEX_PATH) {
+                Result = FALSE;
+                break;
+            }
+
+            memcpy(PathBuffer, &MappedFile.Base[Offset], PathLength);
+            Offset = (DWORD)(Entry - MappedFile.Base) + ((Offset - (DWORD)(Entry - MappedFile.Base) + PathLength + 8) & ~7);
+        }
+        PreviousPathLength = PathLength;
+
+        //
+        //  Unmerged entries and new files added with intent to add are
+        //  reported by git status, so count them as modifications.  Entries
+        //  the user asked git not to check, and submodules, are skipped.
+        //
+
+        if ((Flags & YORILIB_GIT_INDEX_STAGE_MASK) != 0 ||
+            (ExtendedFlags & YORILIB_GIT_INDEX_INTENT_TO_ADD) != 0) {
+
+            *Modified = TRUE;
+            break;
+        }
+
+        if ((Flags & YORILIB_GIT_INDEX_ASSUME_VALID) != 0 ||
+            (ExtendedFlags & YORILIB_GIT_INDEX_SKIP_WORKTREE) != 0 ||
+            (Mode & YORILIB_GIT_MODE_TYPE_MASK) == YORILIB_GIT_MODE_GITLINK) {
+
+            continue;
+        }
+
+        CharsConverted = 0;
+        if (PathLength > 0) {
+            CharsConverted = (YORI_ALLOC_SIZE_T)MultiByteToWideChar(CP_UTF8,
+                                                                    0,
+                                                                    (LPCSTR)PathBuffer,
+                                                                    PathLength,
+                                                                    &FilePath.StartOfString[Repository->WorkTree.LengthInChars + 1],
+                                                                    YORILIB_GIT_MAX_INDEX_PATH);
+            if (CharsConverted == 0) {
+                Result = FALSE;
+                break;
+            }
+        }
+
+        FilePath.LengthInChars = Repository->WorkTree.LengthInChars + 1 + CharsConverted;
+        FilePath.StartOfString[FilePath.LengthInChars] = '\0';
+        for (Index = Repository->WorkTree.LengthInChars + 1; Index < FilePath.LengthInChars; Index++) {
+            if (FilePath.StartOfString[Index] == '/') {
+                FilePath.StartOfString[Index] = '\\';
+            }
+        }
+
+        if (!YoriLibGitQueryFile(&FilePath, &FileData) ||
+            (FileData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0) {
+
+            *Modified = TRUE;
+            break;
+        }
+
+        if ((Mode & YORILIB_GIT_MODE_TYPE_MASK) == YORILIB_GIT_MODE_SYMLINK) {
+            continue;
+        }
+
+        //
+        //  The index records the low 32 bits of the size, and the
+        //  modification time as seconds and nanoseconds since 1970.
+        //  Nanoseconds are only compared if they were recorded.
+        //
+
+        WriteTime.LowPart = FileData.ftLastWriteTime.dwLowDateTime;
+        WriteTime.HighPart = FileData.ftLastWriteTime.dwHighDateTime;
+        WriteTime.QuadPart = WriteTime.QuadPart - YORILIB_GIT_UNIX_EPOCH_OFFSET;
+
+        if (FileData.nFileSizeLow != Size ||
+            (DWORD)(WriteTime.QuadPart / 10000000) != MtimeSeconds ||
+            (MtimeNanoseconds != 0 && (DWORD)(WriteTime.QuadPart % 10000000) * 100 != MtimeNanoseconds)) {
+
+            *Modified = TRUE;
+            break;
+        }
+    }
+
+    YoriLibFreeStringContents(&FilePath);
+    YoriLibFree(PathBuffer);
+    YoriLibGitUnmapFile(&MappedFile);
+    return Result;
+}
+
+/**
+ Generate the status of a repository.
+
+ @param Repository Pointer to the repository.
+
+ @param IndexWriteTime On successful completion, updated to contain the last
+        write time of the index, or zero if the index could not be read.
+
+ @param Status On successful completion, populated with the status of the
+        repository.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+YoriLibGitGenerateStatus(
+    __in PYORILIB_GIT_REPOSITORY Repository,
+    __out PFILETIME IndexWriteTime,
+    __out PYORI_LIB_GIT_STATUS Status
+    )
+{
+    YORI_STRING Head;
+    YORI_STRING RefName;
+    YORI_STRING Remote;
+    YORI_STRING Merge;
+    YORI_STRING UpstreamRef;
+    TCHAR UpstreamHash[YORI_LIB_GIT_MAX_HASH_CHARS];
+    BOOLEAN Modified;
+
+    ZeroMemory(Status, sizeof(YORI_LIB_GIT_STATUS));
+    IndexWriteTime->dwLowDateTime = 0;
+    IndexWriteTime->dwHighDateTime = 0;
+
+    if (!YoriLibCopyString(&Status->WorkTree, &Repository->WorkTree)) {
+        return FALSE;
+    }
+
+    if (!YoriLibGitReadFileInDirectory(&Repository->GitDir, _T("HEAD"), &Head)) {
+        YoriLibGitFreeStatus(Status);
+        return FALSE;
+    }
+
+    //
+    //  HEAD either refers to a branch, or when detached, contains the
+    //  object name of a commit.
+    //
+
+    if (YoriLibCompareStringLitCnt(&Head, _T("ref:"), sizeof("ref:") - 1) == 0) {
+        YoriLibInitEmptyString(&RefName);
+        RefName.StartOfString = &Head.StartOfString[sizeof("ref:") - 1];
+        RefName.LengthInChars = Head.LengthInChars - (sizeof("ref:") - 1);
+        YoriLibGitTrimWhitespace(&RefName);
+
+        if (YoriLibGitResolveRef(Repository, &RefName, Status->Head)) {
+            Status->ValidFields = Status->ValidFields | YORI_LIB_GIT_STATUS_HEAD;
+        }
+
+        if (YoriLibCompareStringLitCnt(&RefName, _T("refs/heads/"), sizeof("refs/heads/") - 1) == 0) {
+            RefName.StartOfString = RefName.StartOfString + sizeof("refs/heads/") - 1;
+            RefName.LengthInChars = RefName.LengthInChars - (sizeof("refs/heads/") - 1);
+        }
+
+        YoriLibCloneSubstring(&Status->Branch, &Head, (YORI_ALLOC_SIZE_T)(RefName.StartOfString - Head.StartOfString), RefName.LengthInChars);
+    } else {
+        if (!YoriLibGitCopyHash(Repository, &Head, Status->Head)) {
+            YoriLibFreeStringContents(&Head);
+            YoriLibGitFreeStatus(Status);
+            return FALSE;
+        }
+        Status->ValidFields = Status->ValidFields | YORI_LIB_GIT_STATUS_HEAD;
+        Status->Detached = TRUE;
+        YoriLibCloneSubstring(&Status->Branch, &Head, 0, YORILIB_GIT_ABBREV_LENGTH);
+    }
+
+    //
+    //  If the branch tracks an upstream branch, determine whether they
+    //  refer to the same commit.
+    //
+
+    if (!Status->Detached &&
+        (Status->ValidFields & YORI_LIB_GIT_STATUS_HEAD) != 0 &&
+        YoriLibGitGetConfigValue(Repository, _T("branch"), &Status->Branch, _T("remote"), &Remote) &&
+        YoriLibGitGetConfigValue(Repository, _T("branch"), &Status->Branch, _T("merge"), &Merge)) {
+
+        if (YoriLibCompareStringLitCnt(&Merge, _T("refs/heads/"), sizeof("refs/heads/") - 1) == 0) {
+            Merge.StartOfString = Merge.StartOfString + sizeof("refs/heads/") - 1;
+            Merge.LengthInChars = Merge.LengthInChars - (sizeof("refs/heads/") - 1);
+        }
+
+        YoriLibInitEmptyString(&UpstreamRef);
+        if (YoriLibCompareStringLit(&Remote, _T(".")) == 0) {
+            YoriLibYPrintf(&UpstreamRef, _T("refs/heads/%y"), &Merge);
+        } else {
+            YoriLibYPrintf(&UpstreamRef, _T("refs/remotes/%y/%y"), &Remote, &Merge);
+        }
+
+        if (UpstreamRef.LengthInChars > 0 &&
+            YoriLibGitResolveRef(Repository, &UpstreamRef, UpstreamHash)) {
+
+            Status->ValidFields = Status->ValidFields | YORI_LIB_GIT_STATUS_UPSTREAM;
+            if (_tcsicmp(UpstreamHash, Status->Head) == 0) {
+                Status->UpstreamMatches = TRUE;
+            }
+        }
+        YoriLibFreeStringContents(&UpstreamRef);
+    }
+
+    YoriLibFreeStringContents(&Head);
+
+    if (YoriLibGitCheckIndex(Repository, IndexWriteTime, &Modified)) {
+        Status->ValidFields = Status->ValidFields | YORI_LIB_GIT_STATUS_INDEX;
+        Status->Modified = Modified;
+    }
+
+    return TRUE;
+}
+
+/**
+ Free the strings within a git status structure.
+
+ @param Status Pointer to the status to free.
+ */
+VOID
+YoriLibGitFreeStatus(
+    __inout PYORI_LIB_GIT_STATUS Status
+    )
+{
+    YoriLibFreeStringContents(&Status->WorkTree);
+    YoriLibFreeStringContents(&Status->Branch);
+}
+
+/**
+ Copy a git status structure.  Strings are shared with the source.
+
+ @param Dest Pointer to the status to populate.
+
+ @param Src Pointer to the status to copy.
+ */
+VOID
+YoriLibGitCopyStatus(
+    __out PYORI_LIB_GIT_STATUS Dest,
+    __in PYORI_LIB_GIT_STATUS Src
+    )
+{
+    memcpy(Dest, Src, sizeof(YORI_LIB_GIT_STATUS));
+    YoriLibCloneString(&Dest->WorkTree, &Src->WorkTree);
+    YoriLibCloneString(&Dest->Branch, &Src->Branch);
+}
+
+/**
+ Discard the cached result.  The caller is expected to hold the cache
+ mutex.
+ */
+VOID
+YoriLibGitStatusCacheInvalidate(VOID)
+{
+    if (!YoriLibGitStatusCache.Valid) {
+        return;
+    }
+
+    YoriLibFreeStringContents(&YoriLibGitStatusCache.Directory);
+    YoriLibFreeStringContents(&YoriLibGitStatusCache.IndexPath);
+    YoriLibGitFreeStatus(&YoriLibGitStatusCache.Status);
+    if (YoriLibGitStatusCache.WorkTreeNotify != NULL) {
+        FindCloseChangeNotification(YoriLibGitStatusCache.WorkTreeNotify);
+        YoriLibGitStatusCache.WorkTreeNotify = NULL;
+    }
+    if (YoriLibGitStatusCache.CommonDirNotify != NULL) {
+        FindCloseChangeNotification(YoriLibGitStatusCache.CommonDirNotify);
+        YoriLibGitStatusCache.CommonDirNotify = NULL;
+    }
+    YoriLibGitStatusCache.Valid = FALSE;
+}
+
+/**
+ Check whether the cached result is still current for a directory.  The
+ caller is expected to hold the cache mutex.
+
+ @param Directory Pointer to the directory being queried.
+
+ @return TRUE if the cached result can be returned, FALSE if it must be
+         regenerated.
+ */
+BOOLEAN
+YoriLibGitStatusCacheIsCurrent(
+    __in PCYORI_STRING Directory
+    )
+{
+    WIN32_FIND_DATA FileData;
+
+    if (!YoriLibGitStatusCache.Valid ||
+        YoriLibCompareStringIns(&YoriLibGitStatusCache.Directory, Directory) != 0) {
+
+        return FALSE;
+    }
+
+    if (WaitForSingleObject(YoriLibGitStatusCache.WorkTreeNotify, 0) != WAIT_TIMEOUT) {
+        return FALSE;
+    }
+
+    if (YoriLibGitStatusCache.CommonDirNotify != NULL &&
+        WaitForSingleObject(YoriLibGitStatusCache.CommonDirNotify, 0) != WAIT_TIMEOUT) {
+
+        return FALSE;
+    }
+
+    //
+    //  The notifications should indicate an index update, but since git
+    //  replaces the index by renaming a new file over it, check its time
+    //  explicitly too.  This is cheap compared to scanning it.
+    //
+
+    if (!YoriLibGitQueryFile(&YoriLibGitStatusCache.IndexPath, &FileData)) {
+        FileData.ftLastWriteTime.dwLowDateTime = 0;
+        FileData.ftLastWriteTime.dwHighDateTime = 0;
+    }
+
+    if (CompareFileTime(&FileData.ftLastWriteTime, &YoriLibGitStatusCache.IndexWriteTime) != 0) {
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ Enable caching of git status for the remainder of this process.  Any
+ failure here leaves the cache disabled, which means each query reads the
+ repository again.
+
+ @return TRUE to indicate the cache is enabled, FALSE if it is not.
+ */
+BOOLEAN
+YoriLibGitStatusCacheEnable(VOID)
+{
+    if (YoriLibGitStatusCache.Mutex != NULL) {
+        return TRUE;
+    }
+
+    YoriLibGitStatusCache.Mutex = CreateMutex(NULL, FALSE, NULL);
+    if (YoriLibGitStatusCache.Mutex == NULL) {
+        return FALSE;
+    }
+
+    YoriLibGitStatusCache.Valid = FALSE;
+    return TRUE;
+}
+
+/**
+ Free all state associated with the git status cache and disable it.
+ */
+VOID
+YoriLibGitStatusCacheCleanup(VOID)
+{
+    if (YoriLibGitStatusCache.Mutex == NULL) {
+        return;
+    }
+
+    YoriLibGitStatusCacheInvalidate();
+    CloseHandle(YoriLibGitStatusCache.Mutex);
+    YoriLibGitStatusCache.Mutex = NULL;
+}
+
+/**
+ Obtain the status of the git repository containing a directory.
+
+ @param Directory Pointer to a fully qualified directory.
+
+ @param Status On successful completion, populated with the status of the
+        repository.  The caller should free this with
+        @ref YoriLibGitFreeStatus .
+
+ @return TRUE to indicate the directory is within a repository and Status
+         has been populated, FALSE if the directory is not within a
+         repository or its status could not be determined.
+ */
+__success(return)
+BOOLEAN
+YoriLibGitGetStatus(
+    __in PCYORI_STRING Directory,
+    __out PYORI_LIB_GIT_STATUS Status
+    )
+{
+    YORILIB_GIT_REPOSITORY Repository;
+    YORI_STRING Relative;
+    FILETIME IndexWriteTime;
+    HANDLE WorkTreeNotify;
+    HANDLE CommonDirNotify;
+    BOOLEAN Result;
+
+    if (YoriLibGitStatusCache.Mutex != NULL) {
+        WaitForSingleObject(YoriLibGitStatusCache.Mutex, INFINITE);
+        if (YoriLibGitStatusCacheIsCurrent(Directory)) {
+            YoriLibGitCopyStatus(Status, &YoriLibGitStatusCache.Status);
+            ReleaseMutex(YoriLibGitStatusCache.Mutex);
+            return TRUE;
+        }
+        YoriLibGitStatusCacheInvalidate();
+    }
+
+    if (!YoriLibGitFindRepository(Directory, &Repository)) {
+        if (YoriLibGitStatusCache.Mutex != NULL) {
+            ReleaseMutex(YoriLibGitStatusCache.Mutex);
+        }
+        return FALSE;
+    }
+
+    //
+    //  If caching, start watching for changes before reading anything, so
+    //  that any change made while the status is being generated causes it
+    //  to be generated again next time.
+    //
+
+    WorkTreeNotify = NULL;
+    CommonDirNotify = NULL;
+    if (YoriLibGitStatusCache.Mutex != NULL) {
+        WorkTreeNotify = FindFirstChangeNotification(Repository.WorkTree.StartOfString, TRUE, YORILIB_GIT_NOTIFY_FILTER);
+        if (WorkTreeNotify == INVALID_HANDLE_VALUE) {
+            WorkTreeNotify = NULL;
+        }
+
+        if (WorkTreeNotify != NULL &&
+            (Repository.CommonDir.LengthInChars <= Repository.WorkTree.LengthInChars ||
+             YoriLibCompareStringInsCnt(&Repository.CommonDir, &Repository.WorkTree, Repository.WorkTree.LengthInChars) != 0 ||
+             Repository.CommonDir.StartOfString[Repository.WorkTree.LengthInChars] != '\\')) {
+
+            CommonDirNotify = FindFirstChangeNotification(Repository.CommonDir.StartOfString, TRUE, YORILIB_GIT_NOTIFY_FILTER);
+            if (CommonDirNotify == INVALID_HANDLE_VALUE) {
+                FindCloseChangeNotification(WorkTreeNotify);
+                WorkTreeNotify = NULL;
+                CommonDirNotify = NULL;
+            }
+        }
+    }
+
+    Result = YoriLibGitGenerateStatus(&Repository, &IndexWriteTime, Status);
+
+    if (WorkTreeNotify != NULL) {
+        if (Result &&
+            YoriLibCopyString(&YoriLibGitStatusCache.Directory, Directory)) {
+
+            YoriLibConstantString(&Relative, _T("index"));
+            if (YoriLibGitBuildPath(&Repository.GitDir, &Relative, &YoriLibGitStatusCache.IndexPath)) {
+                YoriLibGitStatusCache.IndexWriteTime = IndexWriteTime;
+                YoriLibGitStatusCache.WorkTreeNotify = WorkTreeNotify;
+                YoriLibGitStatusCache.CommonDirNotify = CommonDirNotify;
+                YoriLibGitCopyStatus(&YoriLibGitStatusCache.Status, Status);
+                YoriLibGitStatusCache.Valid = TRUE;
+                WorkTreeNotify = NULL;
+                CommonDirNotify = NULL;
+            } else {
+                YoriLibFreeStringContents(&YoriLibGitStatusCache.Directory);
+            }
+        }
+
+        if (WorkTreeNotify != NULL) {
+            FindCloseChangeNotification(WorkTreeNotify);
+        }
+        if (CommonDirNotify != NULL) {
+            FindCloseChangeNotification(CommonDirNotify);
+        }
+    }
+
+    if (YoriLibGitStatusCache.Mutex != NULL) {
+        ReleaseMutex(YoriLibGitStatusCache.Mutex);
+    }
+
+    YoriLibGitFreeRepository(&Repository);
+    return Result;
+}
+
+/**
+ Add each loose branch within a directory of refs, and its subdirectories,
+ to an array.
+
+ @param Directory Pointer to the NULL terminated directory to enumerate.
+
+ @param Prefix Pointer to the branch name corresponding to the directory,
+        including a trailing forward slash, or an empty string for the top
+        level.
+
+ @param Depth The number of directory levels already descended.
+
+ @param Branches Pointer to the array of branches to update.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+YoriLibGitEnumerateLooseBranches(
+    __in PCYORI_STRING Directory,
+    __in PCYORI_STRING Prefix,
+    __in DWORD Depth,
+    __inout PYORI_STRING_ARRAY Branches
+    )
+{
+    YORI_STRING SearchSpec;
+    YORI_STRING Child;
+    YORI_STRING Name;
+    WIN32_FIND_DATA FindData;
+    HANDLE FindHandle;
+    BOOLEAN Result;
+
+    if (Depth > YORILIB_GIT_MAX_REF_DEPTH) {
+        return TRUE;
+    }
+
+    YoriLibInitEmptyString(&SearchSpec);
+    if (YoriLibYPrintf(&SearchSpec, _T("%y\\*"), Directory) < 0) {
+        return FALSE;
+    }
+
+    FindHandle = FindFirstFile(SearchSpec.StartOfString, &FindData);
+    YoriLibFreeStringContents(&SearchSpec);
+    if (FindHandle == INVALID_HANDLE_VALUE) {
+        return TRUE;
+    }
+
+    Result = TRUE;
+    do {
+        if (_tcscmp(FindData.cFileName, _T(".")) == 0 ||
+            _tcscmp(FindData.cFileName, _T("..")) == 0) {
+
+            continue;
+        }
+
+        YoriLibInitEmptyString(&Name);
+        if (FindData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+            YoriLibInitEmptyString(&Child);
+            if (YoriLibYPrintf(&Child, _T("%y\\%s"), Directory, FindData.cFileName) < 0 ||
+                YoriLibYPrintf(&Name, _T("%y%s/"), Prefix, FindData.cFileName) < 0) {
+
+                YoriLibFreeStringContents(&Child);
+                Result = FALSE;
+                break;
+            }
+
+            Result = YoriLibGitEnumerateLooseBranches(&Child, &Name, Depth + 1, Branches);
+            YoriLibFreeStringContents(&Child);
+        } else {
+            if (YoriLibYPrintf(&Name, _T("%y%s"), Prefix, FindData.cFileName) < 0) {
+                Result = FALSE;
+                break;
+            }
+            Result = YoriStringArrayAddItems(Branches, &Name, 1);
+        }
+        YoriLibFreeStringContents(&Name);
+
+        if (!Result) {
+            break;
+        }
+
+    } while (FindNextFile(FindHandle, &FindData));
+
+    FindClose(FindHandle);
+    return Result;
+}
+
+/**
+ Add each branch in a repository's packed-refs file which is not already
+ present in an array to the array.
+
+ @param Repository Pointer to the repository.
+
+ @param Branches Pointer to the array of branches to update.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+YoriLibGitEnumeratePackedBranches(
+    __in PYORILIB_GIT_REPOSITORY Repository,
+    __inout PYORI_STRING_ARRAY Branches
+    )
+{
+    YORILIB_GIT_MAPPED_FILE MappedFile;
+    YORI_STRING Relative;
+    YORI_STRING FilePath;
+    YORI_STRING Name;
+    DWORD HexLength;
+    DWORD Offset;
+    DWORD LineEnd;
+    DWORD NameStart;
+    DWORD NameLength;
+    YORI_ALLOC_SIZE_T CharsNeeded;
+    YORI_ALLOC_SIZE_T LooseCount;
+    YORI_ALLOC_SIZE_T Index;
+    BOOLEAN Result;
+
+    YoriLibConstantString(&Relative, _T("packed-refs"));
+    if (!YoriLibGitBuildPath(&Repository->CommonDir, &Relative, &FilePath)) {
+        return FALSE;
+    }
+
+    if (!YoriLibGitMapFile(&FilePath, &MappedFile)) {
+        YoriLibFreeStringContents(&FilePath);
+        return TRUE;
+    }
+    YoriLibFreeStringContents(&FilePath);
+
+    HexLength = Repository->HashLength * 2;
+    LooseCount = Branches->Count;
+    Result = TRUE;
+    Offset = 0;
+    while (Offset < MappedFile.Length) {
+        for (LineEnd = Offset; LineEnd < MappedFile.Length; LineEnd++) {
+            if (MappedFile.Base[LineEnd] == '\n') {
+                break;
+            }
+        }
+
+        NameStart = Offset + HexLength + 1 + sizeof("refs/heads/") - 1;
+        if (MappedFile.Base[Offset] != '#' &&
+            MappedFile.Base[Offset] != '^' &&
+            NameStart < LineEnd &&
+            memcmp(&MappedFile.Base[Offset + HexLength + 1], "refs/heads/", sizeof("refs/heads/") - 1) == 0) {
+
+            NameLength = LineEnd - NameStart;
+            if (MappedFile.Base[LineEnd - 1] == '\r') {
+                NameLength--;
+            }
+
+            CharsNeeded = (YORI_ALLOC_SIZE_T)MultiByteToWideChar(CP_UTF8, 0, (LPCSTR)&MappedFile.Base[NameStart], NameLength, NULL, 0);
+            if (!YoriLibAllocateString(&Name, CharsNeeded + 1)) {
+                Result = FALSE;
+                break;
+            }
+            MultiByteToWideChar(CP_UTF8, 0, (LPCSTR)&MappedFile.Base[NameStart], NameLength, Name.StartOfString, CharsNeeded);
+            Name.LengthInChars = CharsNeeded;
+
+            //
+            //  A loose ref takes precedence over a packed one with the same
+            //  name.
+            //
+
+            for (Index = 0; Index < LooseCount; Index++) {
+                if (YoriLibCompareString(&Branches->Items[Index], &Name) == 0) {
+                    break;
+                }
+            }
+
+            if (Index == LooseCount) {
+                Result = YoriStringArrayAddItems(Branches, &Name, 1);
+            }
+            YoriLibFreeStringContents(&Name);
+            if (!Result) {
+                break;
+            }
+        }
+
+        Offset = LineEnd + 1;
+    }
+
+    YoriLibGitUnmapFile(&MappedFile);
+    return Result;
+}
+
+/**
+ Obtain the names of the local branches in the git repository containing a
+ directory.
+
+ @param Directory Pointer to a fully qualified directory.
+
+ @param Branches Pointer to an initialized array to populate with the names
+        of branches, in sorted order.
+
+ @return TRUE to indicate success, FALSE if the directory is not within a
+         repository or branches could not be enumerated.
+ */
+__success(return)
+BOOLEAN
+YoriLibGitEnumerateBranches(
+    __in PCYORI_STRING Directory,
+    __inout PYORI_STRING_ARRAY Branches
+    )
+{
+    YORILIB_GIT_REPOSITORY Repository;
+    YORI_STRING Relative;
+    YORI_STRING HeadsDirectory;
+    YORI_STRING Prefix;
+    BOOLEAN Result;
+
+    if (!YoriLibGitFindRepository(Directory, &Repository)) {
+        return FALSE;
+    }
+
+    YoriLibConstantString(&Relative, _T("refs/heads"));
+    if (!YoriLibGitBuildPath(&Repository.CommonDir, &Relative, &HeadsDirectory)) {
+        YoriLibGitFreeRepository(&Repository);
+        return FALSE;
+    }
+
+    YoriLibInitEmptyString(&Prefix);
+    Result = YoriLibGitEnumerateLooseBranches(&HeadsDirectory, &Prefix, 0, Branches);
+    YoriLibFreeStringContents(&HeadsDirectory);
+
+    if (Result) {
+        Result = YoriLibGitEnumeratePackedBranches(&Repository, Branches);
+    }
+
+    if (Result) {
+        YoriLibSortStringArray(Branches->Items, Branches->Count);
+    }
+
+    YoriLibGitFreeRepository(&Repository);
+    return Result;
+}
+
+// vim:sw=4:ts=4:et:
@@ -27,11 +27,94 @@
 #include "yoripch.h"
 #include "yorilib.h"
 
+/**
+ The number of entries per bucket that a hash table is allowed to reach
+ before a bucket is split.
+ */
+#define YORI_HASH_MAX_LOAD (2)
+
+/**
+ The largest value that the split mask of a hash table can reach.  Beyond
+ this point the table stops growing, which only means chains get longer.
+ */
+#define YORI_HASH_MAX_SPLIT_MASK (YORI_MAX_ALLOC_SIZE >> 2)
+
+/**
+ Return a bucket within a hash table.
+
+ @param HashTable Pointer to the hash table.
+
+ @param BucketIndex The index of the bucket.  This must be less than the
+        number of buckets in use.
+
+ @return Pointer to the bucket.
+ */
+PYORI_HASH_BUCKET
+YoriLibHashGetBucket(
+    __in PYORI_HASH_TABLE HashTable,
+    __in YORI_ALLOC_SIZE_T BucketIndex
+    )
+{
+    ASSERT(BucketIndex < HashTable->NumberBuckets);
+    return &HashTable->Segments[BucketIndex / YORI_HASH_SEGMENT_SIZE][BucketIndex % YORI_HASH_SEGMENT_SIZE];
+}
+
+/**
+ Determine the bucket that an entry with a specified hash belongs in.
+ Buckets below the split index have already been split during this round
+ of growth, so they are addressed with one more bit of the hash.
+
+ @param HashTable Pointer to the hash table.
+
+ @param Hash The hash of the key.
+
+ @return The index of the bucket.
+ */
+YORI_ALLOC_SIZE_T
+YoriLibHashGetBucketIndex(
+    __in PYORI_HASH_TABLE HashTable,
+    __in DWORD Hash
+    )
+{
+    YORI_ALLOC_SIZE_T BucketIndex;
+
+    BucketIndex = Hash & HashTable->SplitMask;
+    if (BucketIndex < HashTable->SplitIndex) {
+        BucketIndex = Hash & (HashTable->SplitMask * 2 + 1);
+    }
+
+    return BucketIndex;
+}
+
+/**
+ Allocate a segment of buckets and initialize each bucket as empty.
+
+ @return Pointer to the segment, or NULL on allocation failure.
+ */
+PYORI_HASH_BUCKET
+YoriLibHashAllocateSegment(VOID)
+{
+    PYORI_HASH_BUCKET Segment;
+    YORI_ALLOC_SIZE_T BucketIndex;
+
+    Segment = YoriLibMalloc((YORI_ALLOC_SIZE_T)(YORI_HASH_SEGMENT_SIZE * sizeof(YORI_HASH_BUCKET)));
+    if (Segment == NULL) {
+        return NULL;
+    }
+
+    for (BucketIndex = 0; BucketIndex < YORI_HASH_SEGMENT_SIZE; BucketIndex++) {
+        YoriLibInitializeListHead(&Segment[BucketIndex].ListHead);
+    }
+
+    return Segment;
+}
 
 /**
  Allocate an empty hash table.
 
  @param NumberBuckets The number of buckets to allocate into the hash table.
+        This is rounded up to a power of two.  The table grows as entries
+        are inserted, so this only needs to be an estimate.
 
  @return On successful completion, points to the resulting hash table.
          On allocation failure, returns NULL.
@@ -41,26 +124,51 @@ YoriLibAllocateHashTable(
     __in YORI_ALLOC_SIZE_T NumberBuckets
     )
 {
-    DWORD SizeNeeded = sizeof(YORI_HASH_TABLE) + NumberBuckets * sizeof(YORI_HASH_BUCKET);
     PYORI_HASH_TABLE HashTable;
-    DWORD BucketIndex;
+    YORI_ALLOC_SIZE_T InitialBuckets;
+    YORI_ALLOC_SIZE_T NumberSegments;
+    YORI_ALLOC_SIZE_T SegmentIndex;
 
-    if (!YoriLibIsSizeAllocatable(SizeNeeded)) {
+    InitialBuckets = 1;
+    while (InitialBuckets < NumberBuckets && InitialBuckets <= YORI_HASH_MAX_SPLIT_MASK) {
+        InitialBuckets = InitialBuckets * 2;
+    }
+
+    NumberSegments = (InitialBuckets + YORI_HASH_SEGMENT_SIZE - 1) / YORI_HASH_SEGMENT_SIZE;
+    if (!YoriLibIsSizeAllocatable(NumberSegments * sizeof(PYORI_HASH_BUCKET))) {
         return NULL;
     }
 
-    HashTable = YoriLibReferencedMalloc((YORI_ALLOC_SIZE_T)SizeNeeded);
+    HashTable = YoriLibReferencedMalloc(sizeof(YORI_HASH_TABLE));
     if (HashTable == NULL) {
         return NULL;
     }
 
-    HashTable->NumberBuckets = NumberBuckets;
-    HashTable->Buckets = (PYORI_HASH_BUCKET)(HashTable + 1);
+    HashTable->Segments = YoriLibMalloc((YORI_ALLOC_SIZE_T)(NumberSegments * sizeof(PYORI_HASH_BUCKET)));
+    if (HashTable->Segments == NULL) {
+        YoriLibDereference(HashTable);
+        return NULL;
+    }
 
-    for (BucketIndex = 0; BucketIndex < NumberBuckets; BucketIndex++) {
-        YoriLibInitializeListHead(&HashTable->Buckets[BucketIndex].ListHead);
+    for (SegmentIndex = 0; SegmentIndex < NumberSegments; SegmentIndex++) {
+        HashTable->Segments[SegmentIndex] = YoriLibHashAllocateSegment();
+        if (HashTable->Segments[SegmentIndex] == NULL) {
+            while (SegmentIndex > 0) {
+                SegmentIndex--;
+                YoriLibFree(HashTable->Segments[SegmentIndex]);
+            }
+            YoriLibFree(HashTable->Segments);
+            YoriLibDereference(HashTable);
+            return NULL;
+        }
     }
 
+    HashTable->NumberBuckets = InitialBuckets;
+    HashTable->NumberEntries = 0;
+    HashTable->SplitMask = InitialBuckets - 1;
+    HashTable->SplitIndex = 0;
+    HashTable->NumberSegments = NumberSegments;
+
     return HashTable;
 }
 
@@ -75,17 +183,102 @@ YoriLibFreeEmptyHashTable(
     __in PYORI_HASH_TABLE HashTable
     )
 {
-#if DBG
-    DWORD BucketIndex;
+    YORI_ALLOC_SIZE_T SegmentIndex;
+
+    ASSERT(HashTable->NumberEntries == 0);
 
-    for (BucketIndex = 0; BucketIndex < HashTable->NumberBuckets; BucketIndex++) {
-        ASSERT(YoriLibGetNextListEntry(&HashTable->Buckets[BucketIndex].ListHead, NULL) == NULL);
+    for (SegmentIndex = 0; SegmentIndex < HashTable->NumberSegments; SegmentIndex++) {
+        if (HashTable->Segments[SegmentIndex] != NULL) {
+            YoriLibFree(HashTable->Segments[SegmentIndex]);
+        }
     }
-#endif
 
+    YoriLibFree(HashTable->Segments);
     YoriLibDereference(HashTable);
 }
 
+/**
+ Add one bucket to a hash table by splitting the next bucket in the current
+ round of growth.  Entries in the bucket being split are divided between it
+ and the new bucket.  Growing one bucket at a time means no single insert
+ needs to rehash the entire table.  If memory cannot be allocated, the
+ table is left unchanged, which is harmless.
+
+ @param HashTable Pointer to the hash table.
+ */
+VOID
+YoriLibHashSplitBucket(
+    __in PYORI_HASH_TABLE HashTable
+    )
+{
+    YORI_ALLOC_SIZE_T NewIndex;
+    YORI_ALLOC_SIZE_T SegmentIndex;
+    YORI_ALLOC_SIZE_T NewNumberSegments;
+    YORI_ALLOC_SIZE_T NewMask;
+    PYORI_HASH_BUCKET *NewSegments;
+    PYORI_HASH_BUCKET OldBucket;
+    PYORI_HASH_BUCKET NewBucket;
+    PYORI_LIST_ENTRY ListEntry;
+    PYORI_LIST_ENTRY NextEntry;
+    PYORI_HASH_ENTRY HashEntry;
+
+    if (HashTable->SplitMask > YORI_HASH_MAX_SPLIT_MASK) {
+        return;
+    }
+
+    NewIndex = HashTable->NumberBuckets;
+    ASSERT(NewIndex == HashTable->SplitMask + 1 + HashTable->SplitIndex);
+    SegmentIndex = NewIndex / YORI_HASH_SEGMENT_SIZE;
+
+    //
+    //  If the directory of segments is full, double it.  Only the array of
+    //  pointers moves; the buckets themselves stay where they are.
+    //
+
+    if (SegmentIndex >= HashTable->NumberSegments) {
+        NewNumberSegments = HashTable->NumberSegments * 2;
+        NewSegments = YoriLibMalloc((YORI_ALLOC_SIZE_T)(NewNumberSegments * sizeof(PYORI_HASH_BUCKET)));
+        if (NewSegments == NULL) {
+            return;
+        }
+
+        memcpy(NewSegments, HashTable->Segments, HashTable->NumberSegments * sizeof(PYORI_HASH_BUCKET));
+        ZeroMemory(&NewSegments[HashTable->NumberSegments], (NewNumberSegments - HashTable->NumberSegments) * sizeof(PYORI_HASH_BUCKET));
+        YoriLibFree(HashTable->Segments);
+        HashTable->Segments = NewSegments;
+        HashTable->NumberSegments = NewNumberSegments;
+    }
+
+    if (HashTable->Segments[SegmentIndex] == NULL) {
+        HashTable->Segments[SegmentIndex] = YoriLibHashAllocateSegment();
+        if (HashTable->Segments[SegmentIndex] == NULL) {
+            return;
+        }
+    }
+
+    HashTable->NumberBuckets++;
+    OldBucket = YoriLibHashGetBucket(HashTable, HashTable->SplitIndex);
+    NewBucket = YoriLibHashGetBucket(HashTable, NewIndex);
+    NewMask = HashTable->SplitMask * 2 + 1;
+
+    ListEntry = YoriLibGetNextListEntry(&OldBucket->ListHead, NULL);
+    while (ListEntry != NULL) {
+        NextEntry = YoriLibGetNextListEntry(&OldBucket->ListHead, ListEntry);
+        HashEntry = CONTAINING_RECORD(ListEntry, YORI_HASH_ENTRY, ListEntry);
+        if ((HashEntry->Hash & NewMask) == NewIndex) {
+            YoriLibRemoveListItem(ListEntry);
+            YoriLibInsertList(&NewBucket->ListHead, ListEntry);
+        }
+        ListEntry = NextEntry;
+    }
+
+    HashTable->SplitIndex++;
+    if (HashTable->SplitIndex > HashTable->SplitMask) {
+        HashTable->SplitMask = NewMask;
+        HashTable->SplitIndex = 0;
+    }
+}
+
 /**
  Hash a yori string into a 32 bit hash value.
 
@@ -150,67 +343,288 @@ YoriLibHashString(
 }
 
 /**
- Insert an object with a string based key into the hash table.
+ Rotate a 32 bit value left by a specified number of bits.
+ */
+#define YORI_HASH_ROTL32(Value, Bits) (((Value) << (Bits)) | ((Value) >> (32 - (Bits))))
+
+/**
+ Combine a 32 bit block of key data into a running hash.  This is the block
+ step of MurmurHash3.
+
+ @param Hash The hash of all previous blocks.
+
+ @param Block The next block of key data.
+
+ @return The updated hash.
+ */
+DWORD
+YoriLibHashMixBlock(
+    __in DWORD Hash,
+    __in DWORD Block
+    )
+{
+    Block = Block * 0xcc9e2d51;
+    Block = YORI_HASH_ROTL32(Block, 15);
+    Block = Block * 0x1b873593;
+
+    Hash = Hash ^ Block;
+    Hash = YORI_HASH_ROTL32(Hash, 13);
+    Hash = Hash * 5 + 0xe6546b64;
+
+    return Hash;
+}
+
+/**
+ Hash a key for a hash table without regard to case.  Unlike
+ @ref YoriLibHashString32, whose values are persisted by some callers and
+ cannot change, this hash is only used in memory, so it is free to favor
+ speed and distribution.  Keys are consumed two characters at a time, and
+ when both are ASCII, both are upcased at once without a branch per
+ character.  Each block is mixed so that every character affects every bit,
+ which keeps keys with common prefixes or suffixes in different buckets.
+
+ A caller which looks up, inserts or removes the same key more than once
+ can calculate this once and pass it to @ref YoriLibHashLookupByKeyWithHash,
+ @ref YoriLibHashInsertByKeyWithHash or @ref YoriLibHashRemoveByKeyWithHash.
+
+ @param String The string to generate a hash for.
+
+ @return A 32 bit hash value for the string.
+ */
+DWORD
+YoriLibHashKey(
+    __in PCYORI_STRING String
+    )
+{
+    DWORD Hash;
+    DWORD Block;
+    DWORD Lower;
+    YORI_ALLOC_SIZE_T Index;
+    YORI_ALLOC_SIZE_T PairCount;
+    LPTSTR Chars;
+
+    Hash = 0;
+    Chars = String->StartOfString;
+    PairCount = String->LengthInChars / 2;
+
+    for (Index = 0; Index < PairCount; Index++) {
+        Block = (DWORD)(WORD)Chars[Index * 2] | ((DWORD)(WORD)Chars[Index * 2 + 1] << 16);
+
+        //
+        //  If both characters are below 0x80, adding 0x1F sets bit 7 of each
+        //  character at or above 'a', and adding 0x05 sets bit 7 of each
+        //  character above 'z', without carrying into the other character.
+        //  The characters with only the first bit set are lowercase, and
+        //  moving that bit to 0x20 gives the amount to subtract.
+        //
+
+        if ((Block & 0xFF80FF80) == 0) {
+            Lower = (Block + 0x001F001F) & ~(Block + 0x00050005) & 0x00800080;
+            Block = Block - (Lower >> 2);
+        } else {
+            Block = (DWORD)(WORD)YoriLibUpcaseChar(Chars[Index * 2]) |
+                    ((DWORD)(WORD)YoriLibUpcaseChar(Chars[Index * 2 + 1]) << 16);
+        }
+
+        Hash = YoriLibHashMixBlock(Hash, Block);
+    }
+
+    if (String->LengthInChars % 2 != 0) {
+        Block = (DWORD)(WORD)YoriLibUpcaseChar(Chars[String->LengthInChars - 1]);
+        Hash = YoriLibHashMixBlock(Hash, Block);
+    }
+
+    //
+    //  Apply the MurmurHash3 finalizer.  Buckets are selected from the low
+    //  bits of the hash, so these must depend on every block.
+    //
+
+    Hash = Hash ^ String->LengthInChars;
+    Hash = Hash ^ (Hash >> 16);
+    Hash = Hash * 0x85ebca6b;
+    Hash = Hash ^ (Hash >> 13);
+    Hash = Hash * 0xc2b2ae35;
+    Hash = Hash ^ (Hash >> 16);
+
+    return Hash;
+}
+
+/**
+ Insert an object with a string based key and a previously calculated hash
+ into the hash table.  This may grow the table, which moves entries between
+ buckets.
 
  @param HashTable The hash table to insert the object into.
 
  @param KeyString Pointer to a Yori string describing the key for the
         entry.
 
+ @param Hash The hash of KeyString, as returned by @ref YoriLibHashKey.
+
  @param Context Pointer to a blob of data which is meaningful to the caller.
 
  @param HashEntry On successful completion, populated with structures
         describing the entry within the hash table.
  */
 VOID
-YoriLibHashInsertByKey(
+YoriLibHashInsertByKeyWithHash(
     __in PYORI_HASH_TABLE HashTable,
     __in PYORI_STRING KeyString,
+    __in DWORD Hash,
     __in PVOID Context,
     __out PYORI_HASH_ENTRY HashEntry
     )
 {
-    DWORD BucketIndex = YoriLibHashString(KeyString) % HashTable->NumberBuckets;
+    YORI_ALLOC_SIZE_T BucketIndex;
+
+    ASSERT(Hash == YoriLibHashKey(KeyString));
+
+    if (HashTable->NumberEntries >= HashTable->NumberBuckets * YORI_HASH_MAX_LOAD) {
+        YoriLibHashSplitBucket(HashTable);
+    }
 
     YoriLibCloneString(&HashEntry->Key, KeyString);
     HashEntry->Context = Context;
-    YoriLibInsertList(&HashTable->Buckets[BucketIndex].ListHead, &HashEntry->ListEntry);
+    HashEntry->HashTable = HashTable;
+    HashEntry->Hash = Hash;
+
+    BucketIndex = YoriLibHashGetBucketIndex(HashTable, HashEntry->Hash);
+    YoriLibInsertList(&YoriLibHashGetBucket(HashTable, BucketIndex)->ListHead, &HashEntry->ListEntry);
+    HashTable->NumberEntries++;
 }
 
 /**
- Locate an object within the hash table by a specified key.
+ Insert an object with a string based key into the hash table.  This may
+ grow the table, which moves entries between buckets.
+
+ @param HashTable The hash table to insert the object into.
+
+ @param KeyString Pointer to a Yori string describing the key for the
+        entry.
+
+ @param Context Pointer to a blob of data which is meaningful to the caller.
+
+ @param HashEntry On successful completion, populated with structures
+        describing the entry within the hash table.
+ */
+VOID
+YoriLibHashInsertByKey(
+    __in PYORI_HASH_TABLE HashTable,
+    __in PYORI_STRING KeyString,
+    __in PVOID Context,
+    __out PYORI_HASH_ENTRY HashEntry
+    )
+{
+    YoriLibHashInsertByKeyWithHash(HashTable, KeyString, YoriLibHashKey(KeyString), Context, HashEntry);
+}
+
+/**
+ Locate an object within the hash table by a specified key and a previously
+ calculated hash.  Entries whose hash differs are rejected without comparing
+ their keys.
 
  @param HashTable Pointer to the hash table to search for the object.
 
  @param KeyString Pointer to the key to identify the object.
 
+ @param Hash The hash of KeyString, as returned by @ref YoriLibHashKey.
+
  @return Pointer to the entry within the hash table if a match is found.
          If no match is found, returns NULL.
  */
 PYORI_HASH_ENTRY
-YoriLibHashLookupByKey(
+YoriLibHashLookupByKeyWithHash(
     __in PYORI_HASH_TABLE HashTable,
-    __in PCYORI_STRING KeyString
+    __in PCYORI_STRING KeyString,
+    __in DWORD Hash
     )
 {
-    DWORD BucketIndex = YoriLibHashString(KeyString) % HashTable->NumberBuckets;
+    PYORI_HASH_BUCKET Bucket;
     PYORI_LIST_ENTRY ListEntry;
     PYORI_HASH_ENTRY HashEntry;
 
+    ASSERT(Hash == YoriLibHashKey(KeyString));
+    Bucket = YoriLibHashGetBucket(HashTable, YoriLibHashGetBucketIndex(HashTable, Hash));
+
     HashEntry = NULL;
-    ListEntry = YoriLibGetNextListEntry(&HashTable->Buckets[BucketIndex].ListHead, NULL);
+    ListEntry = YoriLibGetNextListEntry(&Bucket->ListHead, NULL);
     while (ListEntry != NULL) {
         HashEntry = CONTAINING_RECORD(ListEntry, YORI_HASH_ENTRY, ListEntry);
-        if (YoriLibCompareStringIns(KeyString, &HashEntry->Key) == 0) {
+        if (HashEntry->Hash == Hash &&
+            YoriLibCompareStringIns(KeyString, &HashEntry->Key) == 0) {
             break;
         }
         HashEntry = NULL;
-        ListEntry = YoriLibGetNextListEntry(&HashTable->Buckets[BucketIndex].ListHead, ListEntry);
+        ListEntry = YoriLibGetNextListEntry(&Bucket->ListHead, ListEntry);
     }
 
     return HashEntry;
 }
 
+/**
+ Locate an object within the hash table by a specified key.
+
+ @param HashTable Pointer to the hash table to search for the object.
+
+ @param KeyString Pointer to the key to identify the object.
+
+ @return Pointer to the entry within the hash table if a match is found.
+         If no match is found, returns NULL.
+ */
+PYORI_HASH_ENTRY
+YoriLibHashLookupByKey(
+    __in PYORI_HASH_TABLE HashTable,
+    __in PCYORI_STRING KeyString
+    )
+{
+    return YoriLibHashLookupByKeyWithHash(HashTable, KeyString, YoriLibHashKey(KeyString));
+}
+
+/**
+ Enumerate the entries in a hash table.  The order of entries is arbitrary.
+ The previously returned entry may be removed before calling this function
+ again, but the table must not have entries inserted while it is being
+ enumerated.
+
+ @param HashTable Pointer to the hash table to enumerate.
+
+ @param PreviousEntry Pointer to the entry returned by the previous call, or
+        NULL to return the first entry.
+
+ @return Pointer to the next entry, or NULL if all entries have been
+         returned.
+ */
+PYORI_HASH_ENTRY
+YoriLibHashGetNextEntry(
+    __in PYORI_HASH_TABLE HashTable,
+    __in_opt PYORI_HASH_ENTRY PreviousEntry
+    )
+{
+    YORI_ALLOC_SIZE_T BucketIndex;
+    PYORI_HASH_BUCKET Bucket;
+    PYORI_LIST_ENTRY ListEntry;
+
+    if (PreviousEntry == NULL) {
+        BucketIndex = 0;
+        ListEntry = NULL;
+    } else {
+        BucketIndex = YoriLibHashGetBucketIndex(HashTable, PreviousEntry->Hash);
+        ListEntry = &PreviousEntry->ListEntry;
+    }
+
+    while (BucketIndex < HashTable->NumberBuckets) {
+        Bucket = YoriLibHashGetBucket(HashTable, BucketIndex);
+        ListEntry = YoriLibGetNextListEntry(&Bucket->ListHead, ListEntry);
+        if (ListEntry != NULL) {
+            return CONTAINING_RECORD(ListEntry, YORI_HASH_ENTRY, ListEntry);
+        }
+        BucketIndex++;
+        ListEntry = NULL;
+    }
+
+    return NULL;
+}
+
 /**
  Remove an entry from a hash table.  This routine assumes the entry must
  already be inserted into a hash table.
@@ -222,28 +636,34 @@ YoriLibHashRemoveByEntry(
     __in PYORI_HASH_ENTRY HashEntry
     )
 {
+    ASSERT(HashEntry->HashTable->NumberEntries > 0);
+    HashEntry->HashTable->NumberEntries--;
     YoriLibRemoveListItem(&HashEntry->ListEntry);
     YoriLibFreeStringContents(&HashEntry->Key);
 }
 
 /**
- Remove a hash entry from a hash table by performing a lookup by key.
+ Remove a hash entry from a hash table by performing a lookup by key with a
+ previously calculated hash.
 
  @param HashTable The hash table to remove the entry from.
 
  @param KeyString The key matching the object to remove.
 
+ @param Hash The hash of KeyString, as returned by @ref YoriLibHashKey.
+
  @return Pointer to the entry if one was removed, or NULL if no match was
          found.
  */
 PYORI_HASH_ENTRY
-YoriLibHashRemoveByKey(
+YoriLibHashRemoveByKeyWithHash(
     __in PYORI_HASH_TABLE HashTable,
-    __in PYORI_STRING KeyString
+    __in PCYORI_STRING KeyString,
+    __in DWORD Hash
     )
 {
     PYORI_HASH_ENTRY Entry;
-    Entry = YoriLibHashLookupByKey(HashTable, KeyString);
+    Entry = YoriLibHashLookupByKeyWithHash(HashTable, KeyString, Hash);
     if (Entry != NULL) {
         YoriLibHashRemoveByEntry(Entry);
     }
@@ -251,4 +671,23 @@ YoriLibHashRemoveByKey(
     return Entry;
 }
 
+/**
+ Remove a hash entry from a hash table by performing a lookup by key.
+
+ @param HashTable The hash table to remove the entry from.
+
+ @param KeyString The key matching the object to remove.
+
+ @return Pointer to the entry if one was removed, or NULL if no match was
+         found.
+ */
+PYORI_HASH_ENTRY
+YoriLibHashRemoveByKey(
+    __in PYORI_HASH_TABLE HashTable,
+    __in PYORI_STRING KeyString
+    )
+{
+    return YoriLibHashRemoveByKeyWithHash(HashTable, KeyString, YoriLibHashKey(KeyString));
+}
+
 // vim:sw=4:ts=4:et:
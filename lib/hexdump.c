@@ -37,6 +37,38 @@ static UCHAR HexDigits[] = { '0', '1', '2', '3', '4', '5', '6', '7', '8', '9', '
  */
 #define HEX_DIGIT_FROM_VALUE(x) HexDigits[x & 0x0F];
 
+/**
+ Generate the sixteen entries of HexBytePairs whose high digit is the
+ specified character.
+ */
+#define HEX_PAIR_ROW(h) \
+    {h, '0'}, {h, '1'}, {h, '2'}, {h, '3'}, {h, '4'}, {h, '5'}, {h, '6'}, {h, '7'}, \
+    {h, '8'}, {h, '9'}, {h, 'a'}, {h, 'b'}, {h, 'c'}, {h, 'd'}, {h, 'e'}, {h, 'f'}
+
+/**
+ A lookup table of the two hex digits for every byte value, so a byte can
+ be formatted with a single table index rather than shifting and masking
+ each digit.
+ */
+static CONST UCHAR HexBytePairs[256][2] = {
+    HEX_PAIR_ROW('0'),
+    HEX_PAIR_ROW('1'),
+    HEX_PAIR_ROW('2'),
+    HEX_PAIR_ROW('3'),
+    HEX_PAIR_ROW('4'),
+    HEX_PAIR_ROW('5'),
+    HEX_PAIR_ROW('6'),
+    HEX_PAIR_ROW('7'),
+    HEX_PAIR_ROW('8'),
+    HEX_PAIR_ROW('9'),
+    HEX_PAIR_ROW('a'),
+    HEX_PAIR_ROW('b'),
+    HEX_PAIR_ROW('c'),
+    HEX_PAIR_ROW('d'),
+    HEX_PAIR_ROW('e'),
+    HEX_PAIR_ROW('f')
+};
+
 /**
  Return the string representation for a hex digit (in the range 0-15.)
 
@@ -52,6 +84,36 @@ YoriLibHexDigitFromValue(
     return HEX_DIGIT_FROM_VALUE(Value);
 }
 
+/**
+ Write the hex representation of the low order bytes of a value into a
+ buffer, most significant byte first.
+
+ @param Dest Pointer to the buffer to write into.  This must have space
+        for ByteCount * 2 characters.
+
+ @param Value The value to write.
+
+ @param ByteCount The number of low order bytes of Value to write, between
+        1 and 4.
+ */
+VOID
+YoriLibHexWriteValue(
+    __out_ecount(ByteCount * 2) LPTSTR Dest,
+    __in DWORD Value,
+    __in DWORD ByteCount
+    )
+{
+    CONST UCHAR * Pair;
+    DWORD Shift;
+
+    for (Shift = ByteCount * 8; Shift > 0; Shift = Shift - 8) {
+        Pair = HexBytePairs[(UCHAR)(Value >> (Shift - 8))];
+        Dest[0] = Pair[0];
+        Dest[1] = Pair[1];
+        Dest = Dest + 2;
+    }
+}
+
 /**
  Generate a line of up to YORI_LIB_HEXDUMP_BYTES_PER_LINE in of bytes to
  include into a C file.
@@ -77,49 +139,37 @@ YoriLibHexByteCStyle(
     __in BOOLEAN MoreFollowing
     )
 {
-    UCHAR WordToDisplay = 0;
     DWORD WordIndex;
-    BOOL DisplayWord;
-    YORI_ALLOC_SIZE_T OutputIndex = 0;
-    YORI_STRING Subset;
+    YORI_ALLOC_SIZE_T OutputIndex;
+    LPTSTR Dest;
 
     if (BytesToDisplay > YORI_LIB_HEXDUMP_BYTES_PER_LINE) {
         return FALSE;
     }
 
-    Subset.StartOfString = &Output->StartOfString[OutputIndex];
-    Subset.LengthAllocated = Output->LengthAllocated - OutputIndex;
-    Subset.LengthInChars = YoriLibSPrintfS(Subset.StartOfString,
-                                           Subset.LengthAllocated,
-                                           _T("        "));
-    OutputIndex = OutputIndex + Subset.LengthInChars;
-
-    for (WordIndex = 0; WordIndex < YORI_LIB_HEXDUMP_BYTES_PER_LINE / sizeof(WordToDisplay); WordIndex++) {
+    //
+    //  Each line is eight spaces followed by up to four characters per
+    //  byte.
+    //
 
-        WordToDisplay = 0;
-        DisplayWord = FALSE;
+    if (Output->LengthAllocated < 8 + BytesToDisplay * 4) {
+        return FALSE;
+    }
 
-        if (WordIndex * sizeof(WordToDisplay) < BytesToDisplay) {
-            DisplayWord = TRUE;
-            WordToDisplay = (UCHAR)Buffer[WordIndex];
-        }
+    Dest = Output->StartOfString;
+    for (OutputIndex = 0; OutputIndex < 8; OutputIndex++) {
+        Dest[OutputIndex] = ' ';
+    }
 
-        if (DisplayWord) {
-            Subset.StartOfString = &Output->StartOfString[OutputIndex];
-            Subset.LengthAllocated = Output->LengthAllocated - OutputIndex;
+    for (WordIndex = 0; WordIndex < BytesToDisplay; WordIndex++) {
+        Dest[OutputIndex] = HexBytePairs[Buffer[WordIndex]][0];
+        Dest[OutputIndex + 1] = HexBytePairs[Buffer[WordIndex]][1];
+        OutputIndex = OutputIndex + 2;
 
-            if (WordIndex + 1 == BytesToDisplay && !MoreFollowing) {
-                Subset.LengthInChars = YoriLibSPrintfS(Subset.StartOfString,
-                                                       Subset.LengthAllocated,
-                                                       _T("%02x"),
-                                                       WordToDisplay);
-            } else {
-                Subset.LengthInChars = YoriLibSPrintfS(Subset.StartOfString,
-                                                       Subset.LengthAllocated,
-                                                       _T("%02x, "),
-                                                       WordToDisplay);
-            }
-            OutputIndex = OutputIndex + Subset.LengthInChars;
+        if (WordIndex + 1 < BytesToDisplay || MoreFollowing) {
+            Dest[OutputIndex] = ',';
+            Dest[OutputIndex + 1] = ' ';
+            OutputIndex = OutputIndex + 2;
         }
     }
     Output->LengthInChars = OutputIndex;
@@ -202,8 +252,8 @@ YoriLibHexByteLine(
                 }
                 Subset.StartOfString[Subset.LengthInChars++] = 'm';
             }
-            Subset.StartOfString[Subset.LengthInChars++] = HEX_DIGIT_FROM_VALUE(WordToDisplay >> 4);
-            Subset.StartOfString[Subset.LengthInChars++] = HEX_DIGIT_FROM_VALUE(WordToDisplay & 0x0f);
+            YoriLibHexWriteValue(&Subset.StartOfString[Subset.LengthInChars], WordToDisplay, sizeof(WordToDisplay));
+            Subset.LengthInChars = Subset.LengthInChars + sizeof(WordToDisplay) * 2;
             if (HilightBits) {
                 Subset.StartOfString[Subset.LengthInChars++] = 0x1b;
                 Subset.StartOfString[Subset.LengthInChars++] = '[';
@@ -304,10 +354,8 @@ YoriLibHexWordLine(
                 }
                 Subset.StartOfString[Subset.LengthInChars++] = 'm';
             }
-            Subset.StartOfString[Subset.LengthInChars++] = HEX_DIGIT_FROM_VALUE(WordToDisplay >> 12);
-            Subset.StartOfString[Subset.LengthInChars++] = HEX_DIGIT_FROM_VALUE(WordToDisplay >> 8);
-            Subset.StartOfString[Subset.LengthInChars++] = HEX_DIGIT_FROM_VALUE(WordToDisplay >> 4);
-            Subset.StartOfString[Subset.LengthInChars++] = HEX_DIGIT_FROM_VALUE(WordToDisplay);
+            YoriLibHexWriteValue(&Subset.StartOfString[Subset.LengthInChars], WordToDisplay, sizeof(WordToDisplay));
+            Subset.LengthInChars = Subset.LengthInChars + sizeof(WordToDisplay) * 2;
             if (HilightBits) {
                 Subset.StartOfString[Subset.LengthInChars++] = 0x1b;
                 Subset.StartOfString[Subset.LengthInChars++] = '[';
@@ -409,14 +457,8 @@ YoriLibHexDwordLine(
                 }
                 Subset.StartOfString[Subset.LengthInChars++] = 'm';
             }
-            Subset.StartOfString[Subset.LengthInChars++] = HEX_DIGIT_FROM_VALUE(WordToDisplay >> 28);
-            Subset.StartOfString[Subset.LengthInChars++] = HEX_DIGIT_FROM_VALUE(WordToDisplay >> 24);
-            Subset.StartOfString[Subset.LengthInChars++] = HEX_DIGIT_FROM_VALUE(WordToDisplay >> 20);
-            Subset.StartOfString[Subset.LengthInChars++] = HEX_DIGIT_FROM_VALUE(WordToDisplay >> 16);
-            Subset.StartOfString[Subset.LengthInChars++] = HEX_DIGIT_FROM_VALUE(WordToDisplay >> 12);
-            Subset.StartOfString[Subset.LengthInChars++] = HEX_DIGIT_FROM_VALUE(WordToDisplay >> 8);
-            Subset.StartOfString[Subset.LengthInChars++] = HEX_DIGIT_FROM_VALUE(WordToDisplay >> 4);
-            Subset.StartOfString[Subset.LengthInChars++] = HEX_DIGIT_FROM_VALUE(WordToDisplay);
+            YoriLibHexWriteValue(&Subset.StartOfString[Subset.LengthInChars], WordToDisplay, sizeof(WordToDisplay));
+            Subset.LengthInChars = Subset.LengthInChars + sizeof(WordToDisplay) * 2;
             if (HilightBits) {
                 Subset.StartOfString[Subset.LengthInChars++] = 0x1b;
                 Subset.StartOfString[Subset.LengthInChars++] = '[';
@@ -519,23 +561,11 @@ YoriLibHexDwordLongLine(
                 }
                 Subset.StartOfString[Subset.LengthInChars++] = 'm';
             }
-            Subset.StartOfString[Subset.LengthInChars++] = HEX_DIGIT_FROM_VALUE(DisplayValue.HighPart >> 28);
-            Subset.StartOfString[Subset.LengthInChars++] = HEX_DIGIT_FROM_VALUE(DisplayValue.HighPart >> 24);
-            Subset.StartOfString[Subset.LengthInChars++] = HEX_DIGIT_FROM_VALUE(DisplayValue.HighPart >> 20);
-            Subset.StartOfString[Subset.LengthInChars++] = HEX_DIGIT_FROM_VALUE(DisplayValue.HighPart >> 16);
-            Subset.StartOfString[Subset.LengthInChars++] = HEX_DIGIT_FROM_VALUE(DisplayValue.HighPart >> 12);
-            Subset.StartOfString[Subset.LengthInChars++] = HEX_DIGIT_FROM_VALUE(DisplayValue.HighPart >> 8);
-            Subset.StartOfString[Subset.LengthInChars++] = HEX_DIGIT_FROM_VALUE(DisplayValue.HighPart >> 4);
-            Subset.StartOfString[Subset.LengthInChars++] = HEX_DIGIT_FROM_VALUE(DisplayValue.HighPart);
+            YoriLibHexWriteValue(&Subset.StartOfString[Subset.LengthInChars], DisplayValue.HighPart, sizeof(DisplayValue.HighPart));
+            Subset.LengthInChars = Subset.LengthInChars + sizeof(DisplayValue.HighPart) * 2;
             Subset.StartOfString[Subset.LengthInChars++] = '`';
-            Subset.StartOfString[Subset.LengthInChars++] = HEX_DIGIT_FROM_VALUE(DisplayValue.LowPart >> 28);
-            Subset.StartOfString[Subset.LengthInChars++] = HEX_DIGIT_FROM_VALUE(DisplayValue.LowPart >> 24);
-            Subset.StartOfString[Subset.LengthInChars++] = HEX_DIGIT_FROM_VALUE(DisplayValue.LowPart >> 20);
-            Subset.StartOfString[Subset.LengthInChars++] = HEX_DIGIT_FROM_VALUE(DisplayValue.LowPart >> 16);
-            Subset.StartOfString[Subset.LengthInChars++] = HEX_DIGIT_FROM_VALUE(DisplayValue.LowPart >> 12);
-            Subset.StartOfString[Subset.LengthInChars++] = HEX_DIGIT_FROM_VALUE(DisplayValue.LowPart >> 8);
-            Subset.StartOfString[Subset.LengthInChars++] = HEX_DIGIT_FROM_VALUE(DisplayValue.LowPart >> 4);
-            Subset.StartOfString[Subset.LengthInChars++] = HEX_DIGIT_FROM_VALUE(DisplayValue.LowPart);
+            YoriLibHexWriteValue(&Subset.StartOfString[Subset.LengthInChars], DisplayValue.LowPart, sizeof(DisplayValue.LowPart));
+            Subset.LengthInChars = Subset.LengthInChars + sizeof(DisplayValue.LowPart) * 2;
             if (HilightBits) {
                 Subset.StartOfString[Subset.LengthInChars++] = 0x1b;
                 Subset.StartOfString[Subset.LengthInChars++] = '[';
@@ -586,36 +616,18 @@ YoriLibHexDumpWriteOffset(
 
     if (DumpFlags & YORI_LIB_HEX_FLAG_DISPLAY_LARGE_OFFSET) {
         if (String->LengthAllocated >= sizeof(Offset) * 2 + 3) {
-            String->StartOfString[String->LengthInChars++] = HEX_DIGIT_FROM_VALUE(Offset.HighPart >> 28);
-            String->StartOfString[String->LengthInChars++] = HEX_DIGIT_FROM_VALUE(Offset.HighPart >> 24);
-            String->StartOfString[String->LengthInChars++] = HEX_DIGIT_FROM_VALUE(Offset.HighPart >> 20);
-            String->StartOfString[String->LengthInChars++] = HEX_DIGIT_FROM_VALUE(Offset.HighPart >> 16);
-            String->StartOfString[String->LengthInChars++] = HEX_DIGIT_FROM_VALUE(Offset.HighPart >> 12);
-            String->StartOfString[String->LengthInChars++] = HEX_DIGIT_FROM_VALUE(Offset.HighPart >> 8);
-            String->StartOfString[String->LengthInChars++] = HEX_DIGIT_FROM_VALUE(Offset.HighPart >> 4);
-            String->StartOfString[String->LengthInChars++] = HEX_DIGIT_FROM_VALUE(Offset.HighPart);
+            YoriLibHexWriteValue(&String->StartOfString[String->LengthInChars], Offset.HighPart, sizeof(Offset.HighPart));
+            String->LengthInChars = String->LengthInChars + sizeof(Offset.HighPart) * 2;
             String->StartOfString[String->LengthInChars++] = '`';
-            String->StartOfString[String->LengthInChars++] = HEX_DIGIT_FROM_VALUE(Offset.LowPart >> 28);
-            String->StartOfString[String->LengthInChars++] = HEX_DIGIT_FROM_VALUE(Offset.LowPart >> 24);
-            String->StartOfString[String->LengthInChars++] = HEX_DIGIT_FROM_VALUE(Offset.LowPart >> 20);
-            String->StartOfString[String->LengthInChars++] = HEX_DIGIT_FROM_VALUE(Offset.LowPart >> 16);
-            String->StartOfString[String->LengthInChars++] = HEX_DIGIT_FROM_VALUE(Offset.LowPart >> 12);
-            String->StartOfString[String->LengthInChars++] = HEX_DIGIT_FROM_VALUE(Offset.LowPart >> 8);
-            String->StartOfString[String->LengthInChars++] = HEX_DIGIT_FROM_VALUE(Offset.LowPart >> 4);
-            String->StartOfString[String->LengthInChars++] = HEX_DIGIT_FROM_VALUE(Offset.LowPart);
+            YoriLibHexWriteValue(&String->StartOfString[String->LengthInChars], Offset.LowPart, sizeof(Offset.LowPart));
+            String->LengthInChars = String->LengthInChars + sizeof(Offset.LowPart) * 2;
             String->StartOfString[String->LengthInChars++] = ':';
             String->StartOfString[String->LengthInChars++] = ' ';
         }
     } else if (DumpFlags & YORI_LIB_HEX_FLAG_DISPLAY_OFFSET) {
         if (String->LengthAllocated >= sizeof(Offset.LowPart) * 2 + 2) {
-            String->StartOfString[String->LengthInChars++] = HEX_DIGIT_FROM_VALUE(Offset.LowPart >> 28);
-            String->StartOfString[String->LengthInChars++] = HEX_DIGIT_FROM_VALUE(Offset.LowPart >> 24);
-            String->StartOfString[String->LengthInChars++] = HEX_DIGIT_FROM_VALUE(Offset.LowPart >> 20);
-            String->StartOfString[String->LengthInChars++] = HEX_DIGIT_FROM_VALUE(Offset.LowPart >> 16);
-            String->StartOfString[String->LengthInChars++] = HEX_DIGIT_FROM_VALUE(Offset.LowPart >> 12);
-            String->StartOfString[String->LengthInChars++] = HEX_DIGIT_FROM_VALUE(Offset.LowPart >> 8);
-            String->StartOfString[String->LengthInChars++] = HEX_DIGIT_FROM_VALUE(Offset.LowPart >> 4);
-            String->StartOfString[String->LengthInChars++] = HEX_DIGIT_FROM_VALUE(Offset.LowPart);
+            YoriLibHexWriteValue(&String->StartOfString[String->LengthInChars], Offset.LowPart, sizeof(Offset.LowPart));
+            String->LengthInChars = String->LengthInChars + sizeof(Offset.LowPart) * 2;
             String->StartOfString[String->LengthInChars++] = ':';
             String->StartOfString[String->LengthInChars++] = ' ';
         }
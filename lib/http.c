@@ -37,6 +37,54 @@ typedef enum _YORI_LIB_INTERNET_HANDLE_TYPE {
     YoriLibUrlHandle = 2
 } YORI_LIB_INTERNET_HANDLE_TYPE;
 
+/**
+ The maximum number of idle connections to retain for reuse on each handle
+ opened with @ref YoriLibInternetOpen .
+ */
+#define YORI_LIB_HTTP_MAX_IDLE_CONNECTIONS 4
+
+/**
+ The maximum size of the response headers, in bytes.  This exists so that a
+ malicious server cannot consume unbounded memory before returning a body.
+ */
+#define YORI_LIB_HTTP_MAX_HEADER_SIZE (64 * 1024)
+
+/**
+ The maximum length of a line describing a chunk in a chunked response, in
+ characters.
+ */
+#define YORI_LIB_HTTP_MAX_CHUNK_LINE 256
+
+/**
+ The amount of buffer space to make available for each receive from the
+ server.
+ */
+#define YORI_LIB_HTTP_RECEIVE_SIZE (64 * 1024)
+
+/**
+ Information describing a TCP connection to an HTTP server.  Once a response
+ has been completely received, the connection can be retained and reused for
+ a later request to the same host.
+ */
+typedef struct _YORI_LIB_HTTP_CONNECTION {
+
+    /**
+     The list of idle connections associated with an Internet handle.
+     */
+    YORI_LIST_ENTRY ListEntry;
+
+    /**
+     The socket connected to the server.
+     */
+    SOCKET Socket;
+
+    /**
+     The host that the socket is connected to.
+     */
+    YORI_STRING Host;
+
+} YORI_LIB_HTTP_CONNECTION, *PYORI_LIB_HTTP_CONNECTION;
+
 /**
  Information describing each response header in an HTTP response.
  */
@@ -84,6 +132,18 @@ typedef struct _YORI_LIB_INTERNET_HANDLE {
              agent, being the only value supported with YoriLibInternetOpen.
              */
             YORI_STRING UserAgent;
+
+            /**
+             A list of connections which have completed a request and can be
+             reused for a later request to the same host.  The most recently
+             used connection is at the head of the list.
+             */
+            YORI_LIST_ENTRY IdleConnections;
+
+            /**
+             The number of connections in IdleConnections.
+             */
+            DWORD IdleConnectionCount;
         } Internet;
         struct {
 
@@ -106,7 +166,14 @@ typedef struct _YORI_LIB_INTERNET_HANDLE {
             YORI_STRING UserRequestHeaders;
 
             /**
-             The byte buffer containing the response from the server.
+             The connection used to issue the request and receive its
+             response.  NULL if no connection is associated with the request.
+             */
+            PYORI_LIB_HTTP_CONNECTION Connection;
+
+            /**
+             The byte buffer containing data received from the server which
+             has not yet been returned to the caller.
              */
             YORI_LIB_BYTE_BUFFER ByteBuffer;
 
@@ -116,15 +183,25 @@ typedef struct _YORI_LIB_INTERNET_HANDLE {
             YORI_LIST_ENTRY HttpResponseHeaders;
 
             /**
-             The current offset within the buffer for InternetRead requests.
+             The offset within ByteBuffer of the next byte which has been
+             received and not yet consumed.
              */
             DWORDLONG CurrentReadOffset;
 
             /**
-             The offset within ByteBuffer containing the HTTP payload.
+             The offset within ByteBuffer where the HTTP payload started
+             once the response headers were received.
              */
             DWORD HttpBodyOffset;
 
+            /**
+             If the length of the body is known, the number of bytes of the
+             body that have not yet been returned to the caller.  For a
+             chunked response, the number of bytes remaining in the current
+             chunk.
+             */
+            DWORDLONG BodyBytesRemaining;
+
             /**
              Once the response has been processed, the major version of the
              HTTP response.
@@ -143,6 +220,34 @@ typedef struct _YORI_LIB_INTERNET_HANDLE {
              */
             DWORD HttpStatusCode;
 
+            /**
+             TRUE if the server indicated the length of the body with a
+             Content-Length header.
+             */
+            BOOLEAN LengthKnown;
+
+            /**
+             TRUE if the body is sent with a chunked transfer encoding.
+             */
+            BOOLEAN Chunked;
+
+            /**
+             TRUE if the data for a chunk has been returned to the caller but
+             the line break which follows it has not yet been consumed.
+             */
+            BOOLEAN ChunkEndPending;
+
+            /**
+             TRUE once the entire body has been returned to the caller.
+             */
+            BOOLEAN BodyComplete;
+
+            /**
+             TRUE if the server allows the connection to be used for another
+             request once this response is complete.
+             */
+            BOOLEAN KeepAlive;
+
         } Url;
     } u;
 } YORI_LIB_INTERNET_HANDLE, *PYORI_LIB_INTERNET_HANDLE;
@@ -221,6 +326,7 @@ YoriLibInternetOpen(
 
     ZeroMemory(Handle, sizeof(YORI_LIB_INTERNET_HANDLE));
     Handle->HandleType = YoriLibInternetHandle;
+    YoriLibInitializeListHead(&Handle->u.Internet.IdleConnections);
 
     if (UserAgent != NULL) {
         Length = (YORI_ALLOC_SIZE_T)_tcslen(UserAgent);
@@ -265,6 +371,75 @@ YoriLibHttpResetUrlRequest(
         YoriLibDereference(ResponseLine);
         ListEntry = YoriLibGetNextListEntry(&UrlRequest->u.Url.HttpResponseHeaders, NULL);
     }
+
+    UrlRequest->u.Url.CurrentReadOffset = 0;
+    UrlRequest->u.Url.HttpBodyOffset = 0;
+    UrlRequest->u.Url.BodyBytesRemaining = 0;
+    UrlRequest->u.Url.LengthKnown = FALSE;
+    UrlRequest->u.Url.Chunked = FALSE;
+    UrlRequest->u.Url.ChunkEndPending = FALSE;
+    UrlRequest->u.Url.BodyComplete = FALSE;
+    UrlRequest->u.Url.KeepAlive = FALSE;
+}
+
+/**
+ Close a connection to an HTTP server and free its allocation.
+
+ @param Connection Pointer to the connection to close.
+ */
+VOID
+YoriLibHttpCloseConnection(
+    __in PYORI_LIB_HTTP_CONNECTION Connection
+    )
+{
+    if (Connection->Socket != INVALID_SOCKET) {
+        DllWsock32.pclosesocket(Connection->Socket);
+    }
+    YoriLibFreeStringContents(&Connection->Host);
+    YoriLibDereference(Connection);
+}
+
+/**
+ Detach the connection from a Url handle.  If the response has been
+ completely received and the server allows the connection to persist, the
+ connection is retained on the Internet handle for reuse; otherwise it is
+ closed.
+
+ @param UrlRequest Pointer to the URL handle.
+ */
+VOID
+YoriLibHttpReleaseConnection(
+    __inout PYORI_LIB_INTERNET_HANDLE UrlRequest
+    )
+{
+    PYORI_LIB_HTTP_CONNECTION Connection;
+    PYORI_LIB_INTERNET_HANDLE InternetHandle;
+
+    Connection = UrlRequest->u.Url.Connection;
+    if (Connection == NULL) {
+        return;
+    }
+
+    UrlRequest->u.Url.Connection = NULL;
+    InternetHandle = UrlRequest->u.Url.InternetHandle;
+
+    //
+    //  The connection can only be reused if the server is waiting for a
+    //  new request, meaning the entire response has been consumed and
+    //  nothing was sent beyond it.
+    //
+
+    if (UrlRequest->u.Url.BodyComplete &&
+        UrlRequest->u.Url.KeepAlive &&
+        UrlRequest->u.Url.CurrentReadOffset == UrlRequest->u.Url.ByteBuffer.BytesPopulated &&
+        InternetHandle->u.Internet.IdleConnectionCount < YORI_LIB_HTTP_MAX_IDLE_CONNECTIONS) {
+
+        YoriLibInsertList(&InternetHandle->u.Internet.IdleConnections, &Connection->ListEntry);
+        InternetHandle->u.Internet.IdleConnectionCount++;
+        return;
+    }
+
+    YoriLibHttpCloseConnection(Connection);
 }
 
 /**
@@ -280,6 +455,8 @@ YoriLibInternetCloseHandle(
     )
 {
     PYORI_LIB_INTERNET_HANDLE Handle;
+    PYORI_LIB_HTTP_CONNECTION Connection;
+    PYORI_LIST_ENTRY ListEntry;
 
     if (hInternet == NULL) {
         return FALSE;
@@ -296,9 +473,18 @@ YoriLibInternetCloseHandle(
     }
 
     if (Handle->HandleType == YoriLibInternetHandle) {
+        ListEntry = YoriLibGetNextListEntry(&Handle->u.Internet.IdleConnections, NULL);
+        while (ListEntry != NULL) {
+            Connection = CONTAINING_RECORD(ListEntry, YORI_LIB_HTTP_CONNECTION, ListEntry);
+            YoriLibRemoveListItem(ListEntry);
+            YoriLibHttpCloseConnection(Connection);
+            ListEntry = YoriLibGetNextListEntry(&Handle->u.Internet.IdleConnections, NULL);
+        }
+        Handle->u.Internet.IdleConnectionCount = 0;
         YoriLibFreeStringContents(&Handle->u.Internet.UserAgent);
         DllWsock32.pWSACleanup();
     } else if (Handle->HandleType == YoriLibUrlHandle) {
+        YoriLibHttpReleaseConnection(Handle);
         YoriLibHttpResetUrlRequest(Handle);
         YoriLibFreeStringContents(&Handle->u.Url.Url);
         YoriLibInitEmptyString(&Handle->u.Url.UserRequestHeaders);
@@ -344,7 +530,7 @@ YoriLibHttpFindResponseHeader(
 
 
 /**
- Once the HTTP response payload has been received, parse the response into
+ Once the HTTP response headers have been received, parse the response into
  a series of headers, and parse the status line into major/minor versions and
  HTTP status code.  If the status code is a redirect code, construct a new
  redirect URL and prepare the request to be reissued to a new URL.
@@ -382,13 +568,6 @@ YoriLibHttpProcessResponseHeaders(
     LineStart = AnsiBuffer;
     LineLengthInChars = 0;
 
-    //
-    //  MSFIX: Should impose some fairly arbitrary limit on the maximum
-    //  size of headers.  This is because we don't want to limit the size
-    //  of the HTTP payload needlessly, but still want to be robust to
-    //  malicious input trying to cause this to overflow or degrade.
-    //
-
     for (Index = 0; Index < UrlRequest->u.Url.ByteBuffer.BytesPopulated; Index++) {
         if (AnsiBuffer[Index] == '\r' || AnsiBuffer[Index] == '\n') {
 
@@ -468,7 +647,7 @@ YoriLibHttpProcessResponseHeaders(
     ASSERT(Index >= UrlRequest->u.Url.ByteBuffer.BytesPopulated ||
            (UrlRequest->u.Url.ByteBuffer.Buffer[Index] != '\n' &&
             UrlRequest->u.Url.ByteBuffer.Buffer[Index] != '\r'));
-    UrlRequest->u.Url.CurrentReadOffset = 0;
+    UrlRequest->u.Url.CurrentReadOffset = Index;
 
     ListEntry = YoriLibGetNextListEntry(&UrlRequest->u.Url.HttpResponseHeaders, NULL);
     if (ListEntry == NULL) {
@@ -548,8 +727,332 @@ YoriLibHttpProcessResponseHeaders(
 }
 
 /**
- Connect to a specified URL, download contents, parse headers, and redirect as
- necessary.
+ Determine how the end of the body of a response is indicated, and whether
+ the connection can be reused once the response is complete.
+
+ @param UrlRequest Pointer to the request whose response headers have been
+        parsed.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+YoriLibHttpPrepareResponseBody(
+    __inout PYORI_LIB_INTERNET_HANDLE UrlRequest
+    )
+{
+    PYORI_LIB_HTTP_HEADER_LINE ResponseLine;
+    YORI_MAX_SIGNED_T llTemp;
+    YORI_ALLOC_SIZE_T CharsConsumed;
+
+    //
+    //  HTTP 1.1 connections persist by default.  HTTP 1.0 connections only
+    //  persist if the server explicitly indicates it.
+    //
+
+    UrlRequest->u.Url.KeepAlive = FALSE;
+    if (UrlRequest->u.Url.HttpMinorVersion >= 1) {
+        UrlRequest->u.Url.KeepAlive = TRUE;
+    }
+
+    ResponseLine = YoriLibHttpFindResponseHeader(UrlRequest, _T("Connection"));
+    if (ResponseLine != NULL) {
+        if (YoriLibCompareStringLitIns(&ResponseLine->Value, _T("close")) == 0) {
+            UrlRequest->u.Url.KeepAlive = FALSE;
+        } else if (YoriLibCompareStringLitIns(&ResponseLine->Value, _T("keep-alive")) == 0) {
+            UrlRequest->u.Url.KeepAlive = TRUE;
+        }
+    }
+
+    //
+    //  Some responses never have a body, regardless of any headers.
+    //
+
+    if (UrlRequest->u.Url.HttpStatusCode == 204 ||
+        UrlRequest->u.Url.HttpStatusCode == 304) {
+
+        UrlRequest->u.Url.BodyComplete = TRUE;
+        return TRUE;
+    }
+
+    //
+    //  This library can remove a chunked encoding but doesn't know about
+    //  any other encoding.
+    //
+
+    ResponseLine = YoriLibHttpFindResponseHeader(UrlRequest, _T("Transfer-Encoding"));
+    if (ResponseLine != NULL) {
+        if (YoriLibCompareStringLitIns(&ResponseLine->Value, _T("chunked")) != 0) {
+            return FALSE;
+        }
+        UrlRequest->u.Url.Chunked = TRUE;
+        UrlRequest->u.Url.BodyBytesRemaining = 0;
+        return TRUE;
+    }
+
+    ResponseLine = YoriLibHttpFindResponseHeader(UrlRequest, _T("Content-Length"));
+    if (ResponseLine != NULL) {
+        if (!YoriLibStringToNumber(&ResponseLine->Value, FALSE, &llTemp, &CharsConsumed) ||
+            CharsConsumed == 0 ||
+            llTemp < 0) {
+
+            return FALSE;
+        }
+
+        UrlRequest->u.Url.LengthKnown = TRUE;
+        UrlRequest->u.Url.BodyBytesRemaining = (DWORDLONG)llTemp;
+        if (llTemp == 0) {
+            UrlRequest->u.Url.BodyComplete = TRUE;
+        }
+        return TRUE;
+    }
+
+    //
+    //  With no indication of length, the body ends when the server closes
+    //  the connection, so it can't be reused.
+    //
+
+    UrlRequest->u.Url.KeepAlive = FALSE;
+    return TRUE;
+}
+
+/**
+ Obtain a connection to a host, either by reusing an idle connection that
+ was retained from an earlier request or by establishing a new one.
+
+ @param UrlRequest Pointer to the URL handle.  On successful completion, the
+        connection is associated with this handle.
+
+ @param Host The host to connect to.
+
+ @param AllowReuse If TRUE, an idle connection to the host can be used.  If
+        FALSE, a new connection is always established.
+
+ @param Reused On successful completion, set to TRUE if an idle connection
+        was used, or FALSE if a new connection was established.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+YoriLibHttpConnect(
+    __inout PYORI_LIB_INTERNET_HANDLE UrlRequest,
+    __in PYORI_STRING Host,
+    __in BOOLEAN AllowReuse,
+    __out PBOOLEAN Reused
+    )
+{
+    PYORI_LIB_INTERNET_HANDLE InternetHandle;
+    PYORI_LIB_HTTP_CONNECTION Connection;
+    PYORI_LIST_ENTRY ListEntry;
+    struct hostent * addr;
+    struct sockaddr_in sin;
+    UCHAR * AnsiBuffer;
+
+    InternetHandle = UrlRequest->u.Url.InternetHandle;
+
+    if (AllowReuse) {
+        ListEntry = YoriLibGetNextListEntry(&InternetHandle->u.Internet.IdleConnections, NULL);
+        while (ListEntry != NULL) {
+            Connection = CONTAINING_RECORD(ListEntry, YORI_LIB_HTTP_CONNECTION, ListEntry);
+            if (YoriLibCompareStringIns(&Connection->Host, Host) == 0) {
+                YoriLibRemoveListItem(ListEntry);
+                InternetHandle->u.Internet.IdleConnectionCount--;
+                UrlRequest->u.Url.Connection = Connection;
+                *Reused = TRUE;
+                return TRUE;
+            }
+            ListEntry = YoriLibGetNextListEntry(&InternetHandle->u.Internet.IdleConnections, ListEntry);
+        }
+    }
+
+    Connection = YoriLibReferencedMalloc(sizeof(YORI_LIB_HTTP_CONNECTION) + (Host->LengthInChars + 1) * sizeof(TCHAR));
+    if (Connection == NULL) {
+        return FALSE;
+    }
+
+    ZeroMemory(Connection, sizeof(YORI_LIB_HTTP_CONNECTION));
+    Connection->Socket = INVALID_SOCKET;
+    Connection->Host.StartOfString = (LPTSTR)(Connection + 1);
+    Connection->Host.MemoryToFree = Connection;
+    YoriLibReference(Connection);
+    memcpy(Connection->Host.StartOfString, Host->StartOfString, Host->LengthInChars * sizeof(TCHAR));
+    Connection->Host.StartOfString[Host->LengthInChars] = '\0';
+    Connection->Host.LengthInChars = Host->LengthInChars;
+
+    AnsiBuffer = YoriLibMalloc(Host->LengthInChars + 1);
+    if (AnsiBuffer == NULL) {
+        YoriLibHttpCloseConnection(Connection);
+        return FALSE;
+    }
+
+    YoriLibSPrintfA(AnsiBuffer, "%y", Host);
+    addr = DllWsock32.pgethostbyname(AnsiBuffer);
+    YoriLibFree(AnsiBuffer);
+    if (addr == NULL || addr->h_addrtype != AF_INET || addr->h_length != sizeof(DWORD)) {
+        YoriLibHttpCloseConnection(Connection);
+        return FALSE;
+    }
+
+    Connection->Socket = DllWsock32.psocket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (Connection->Socket == INVALID_SOCKET) {
+        YoriLibHttpCloseConnection(Connection);
+        return FALSE;
+    }
+
+    ZeroMemory(&sin, sizeof(sin));
+
+    // MSFIX Probably should parse the port from the host name
+    sin.sin_family = AF_INET;
+    sin.sin_port = 0x5000; // 80, in hex, in big endian
+    memcpy(&sin.sin_addr.s_addr, addr->h_addr, addr->h_length);
+
+    if (DllWsock32.pconnect(Connection->Socket, &sin, sizeof(sin)) != 0) {
+        YoriLibHttpCloseConnection(Connection);
+        return FALSE;
+    }
+
+    UrlRequest->u.Url.Connection = Connection;
+    *Reused = FALSE;
+    return TRUE;
+}
+
+/**
+ Send a buffer to the server, continuing until the entire buffer has been
+ sent.
+
+ @param Socket The socket to send on.
+
+ @param Buffer Pointer to the data to send.
+
+ @param Length The number of bytes to send.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+YoriLibHttpSend(
+    __in SOCKET Socket,
+    __in_bcount(Length) PUCHAR Buffer,
+    __in DWORD Length
+    )
+{
+    DWORD BytesSent;
+    INT Result;
+
+    BytesSent = 0;
+    while (BytesSent < Length) {
+        Result = DllWsock32.psend(Socket, &Buffer[BytesSent], (INT)(Length - BytesSent), 0);
+        if (Result <= 0) {
+            return FALSE;
+        }
+        BytesSent = BytesSent + (DWORD)Result;
+    }
+
+    return TRUE;
+}
+
+/**
+ Receive more data from the server into the buffer of a URL handle.  If all
+ data in the buffer has been consumed, the buffer is emptied first so that
+ its size does not grow with the size of the response.
+
+ @param UrlRequest Pointer to the URL handle.
+
+ @param BytesReceived On successful completion, updated to contain the number
+        of bytes received.  Zero indicates the server closed the connection.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+YoriLibHttpReceive(
+    __inout PYORI_LIB_INTERNET_HANDLE UrlRequest,
+    __out PDWORD BytesReceived
+    )
+{
+    PUCHAR Buffer;
+    YORI_ALLOC_SIZE_T BytesAvailable;
+    INT Length;
+
+    if (UrlRequest->u.Url.CurrentReadOffset == UrlRequest->u.Url.ByteBuffer.BytesPopulated) {
+        YoriLibByteBufferReset(&UrlRequest->u.Url.ByteBuffer);
+        UrlRequest->u.Url.CurrentReadOffset = 0;
+    }
+
+    Buffer = YoriLibByteBufferGetPointerToEnd(&UrlRequest->u.Url.ByteBuffer, YORI_LIB_HTTP_RECEIVE_SIZE, &BytesAvailable);
+    if (Buffer == NULL) {
+        return FALSE;
+    }
+
+    Length = DllWsock32.precv(UrlRequest->u.Url.Connection->Socket, Buffer, (INT)BytesAvailable, 0);
+    if (Length < 0) {
+        return FALSE;
+    }
+
+    YoriLibByteBufferAddToPopulatedLength(&UrlRequest->u.Url.ByteBuffer, (DWORD)Length);
+    *BytesReceived = (DWORD)Length;
+    return TRUE;
+}
+
+/**
+ Receive data from the server until the complete set of response headers
+ has been received.  Any part of the body received along with the headers
+ is retained in the buffer.
+
+ @param UrlRequest Pointer to the URL handle.
+
+ @return TRUE to indicate the response headers were received, FALSE to
+         indicate failure.
+ */
+__success(return)
+BOOLEAN
+YoriLibHttpReceiveResponseHeaders(
+    __inout PYORI_LIB_INTERNET_HANDLE UrlRequest
+    )
+{
+    UCHAR * AnsiBuffer;
+    YORI_MAX_UNSIGNED_T Index;
+    DWORD BytesReceived;
+
+    YoriLibByteBufferReset(&UrlRequest->u.Url.ByteBuffer);
+    UrlRequest->u.Url.CurrentReadOffset = 0;
+    Index = 0;
+
+    while (TRUE) {
+        if (!YoriLibHttpReceive(UrlRequest, &BytesReceived) || BytesReceived == 0) {
+            return FALSE;
+        }
+
+        //
+        //  The headers are terminated by an empty line.  Only newly
+        //  received data needs to be checked.
+        //
+
+        AnsiBuffer = UrlRequest->u.Url.ByteBuffer.Buffer;
+        for (; Index < UrlRequest->u.Url.ByteBuffer.BytesPopulated; Index++) {
+            if (AnsiBuffer[Index] != '\n') {
+                continue;
+            }
+
+            if (Index >= 1 && AnsiBuffer[Index - 1] == '\n') {
+                return TRUE;
+            }
+
+            if (Index >= 2 && AnsiBuffer[Index - 1] == '\r' && AnsiBuffer[Index - 2] == '\n') {
+                return TRUE;
+            }
+        }
+
+        if (UrlRequest->u.Url.ByteBuffer.BytesPopulated > YORI_LIB_HTTP_MAX_HEADER_SIZE) {
+            return FALSE;
+        }
+    }
+}
+
+/**
+ Connect to a specified URL, send the request, and receive and parse the
+ response headers.  The body is received as the caller reads it.
 
  @param UrlRequest Pointer to a URL handle containing a URL to connect to.
 
@@ -566,19 +1069,14 @@ YoriLibHttpProcessUrlRequest(
     )
 {
     YORI_STRING HostSubset;
+    YORI_STRING HostHeader;
+    YORI_STRING HostMatch;
     YORI_STRING Request;
     LPCTSTR EndOfHost;
-    struct hostent * addr;
-    struct sockaddr_in sin;
     UCHAR * AnsiBuffer;
-    SOCKET s;
-    DWORD Length;
-    DWORD TotalLength;
-    YORI_ALLOC_SIZE_T BytesRemaining;
-
-    //
-    //  MSFIX Implement this
-    //
+    DWORD Attempt;
+    BOOLEAN Reused;
+    BOOLEAN Result;
 
     YoriLibInitEmptyString(RedirectUrl);
 
@@ -601,89 +1099,85 @@ YoriLibHttpProcessUrlRequest(
         return FALSE;
     }
 
+    //
+    //  HTTP 1.1 requires a Host header.  Callers typically supply one, so
+    //  only add it if they haven't.
+    //
+
+    YoriLibInitEmptyString(&HostHeader);
+    YoriLibConstantString(&HostMatch, _T("Host:"));
+    if (YoriLibFindFirstMatchSubstrIns(&UrlRequest->u.Url.UserRequestHeaders, 1, &HostMatch, NULL) == NULL) {
+        YoriLibYPrintf(&HostHeader, _T("Host: %y\r\n"), &HostSubset);
+        if (HostHeader.StartOfString == NULL) {
+            return FALSE;
+        }
+    }
+
     YoriLibInitEmptyString(&Request);
     YoriLibYPrintf(&Request,
-                   _T("GET %s HTTP/1.0\r\n%y\r\nUser-Agent: %y(YoriWinInet %i.%02i)\r\n\r\n"),
+                   _T("GET %s HTTP/1.1\r\n%y%y%sUser-Agent: %y(YoriWinInet %i.%02i)\r\n\r\n"),
                    EndOfHost,
+                   &HostHeader,
                    &UrlRequest->u.Url.UserRequestHeaders,
+                   UrlRequest->u.Url.UserRequestHeaders.LengthInChars > 0?_T("\r\n"):_T(""),
                    &UrlRequest->u.Url.InternetHandle->u.Internet.UserAgent,
                    YORI_VER_MAJOR, YORI_VER_MINOR);
 
+    YoriLibFreeStringContents(&HostHeader);
     if (Request.StartOfString == NULL) {
         return FALSE;
     }
 
-    AnsiBuffer = YoriLibMalloc(HostSubset.LengthInChars + 1);
+    AnsiBuffer = YoriLibMalloc(Request.LengthInChars + 1);
     if (AnsiBuffer == NULL) {
         YoriLibFreeStringContents(&Request);
         return FALSE;
     }
 
-    YoriLibSPrintfA(AnsiBuffer, "%y", &HostSubset);
-    addr = DllWsock32.pgethostbyname(AnsiBuffer);
-    if (addr == NULL || addr->h_addrtype != AF_INET || addr->h_length != sizeof(DWORD)) {
-        YoriLibFree(AnsiBuffer);
-        YoriLibFreeStringContents(&Request);
-        return FALSE;
-    }
-
-    YoriLibFree(AnsiBuffer);
+    YoriLibSPrintfA(AnsiBuffer, "%y", &Request);
 
-    s = DllWsock32.psocket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
-    if (s == INVALID_SOCKET) {
-        YoriLibFreeStringContents(&Request);
-        return FALSE;
-    }
+    //
+    //  The server may have closed an idle connection while it was idle,
+    //  which is evident from the request failing before any response is
+    //  received.  In that case, retry once on a new connection.
+    //
 
-    ZeroMemory(&sin, sizeof(sin));
+    Result = FALSE;
+    for (Attempt = 0; Attempt < 2; Attempt++) {
+        Reused = FALSE;
+        if (!YoriLibHttpConnect(UrlRequest, &HostSubset, (BOOLEAN)(Attempt == 0), &Reused)) {
+            break;
+        }
 
-    // MSFIX Probably should parse the port from the host name
-    sin.sin_family = AF_INET;
-    sin.sin_port = 0x5000; // 80, in hex, in big endian
-    memcpy(&sin.sin_addr.s_addr, addr->h_addr, addr->h_length);
+        if (YoriLibHttpSend(UrlRequest->u.Url.Connection->Socket, AnsiBuffer, Request.LengthInChars) &&
+            YoriLibHttpReceiveResponseHeaders(UrlRequest)) {
 
-    if (DllWsock32.pconnect(s, &sin, sizeof(sin)) != 0) {
-        YoriLibFreeStringContents(&Request);
-        DllWsock32.pclosesocket(s);
-        return FALSE;
-    }
+            Result = TRUE;
+            break;
+        }
 
-    AnsiBuffer = YoriLibMalloc(Request.LengthInChars + 1);
-    if (AnsiBuffer == NULL) {
-        YoriLibFreeStringContents(&Request);
-        DllWsock32.pclosesocket(s);
-        return FALSE;
-    }
+        YoriLibHttpCloseConnection(UrlRequest->u.Url.Connection);
+        UrlRequest->u.Url.Connection = NULL;
 
-    YoriLibSPrintfA(AnsiBuffer, "%y", &Request);
-    if (DllWsock32.psend(s, AnsiBuffer, Request.LengthInChars, 0) != (int)Request.LengthInChars) {
-        YoriLibFree(AnsiBuffer);
-        YoriLibFreeStringContents(&Request);
-        DllWsock32.pclosesocket(s);
-        return FALSE;
+        if (!Reused || UrlRequest->u.Url.ByteBuffer.BytesPopulated > 0) {
+            break;
+        }
     }
 
-    YoriLibFreeStringContents(&Request);
     YoriLibFree(AnsiBuffer);
+    YoriLibFreeStringContents(&Request);
 
-    YoriLibByteBufferReset(&UrlRequest->u.Url.ByteBuffer);
-    TotalLength = 0;
-    while(TRUE) {
-        AnsiBuffer = YoriLibByteBufferGetPointerToEnd(&UrlRequest->u.Url.ByteBuffer, 256 * 1024, &BytesRemaining);
-        Length = DllWsock32.precv(s, AnsiBuffer, (DWORD)BytesRemaining, 0);
-        if (Length == 0) {
-            break;
-        }
-        YoriLibByteBufferAddToPopulatedLength(&UrlRequest->u.Url.ByteBuffer, Length);
+    if (!Result) {
+        return FALSE;
     }
 
-    DllWsock32.pclosesocket(s);
-
     if (!YoriLibHttpProcessResponseHeaders(UrlRequest, RedirectUrl)) {
         return FALSE;
     }
 
-    // YoriLibHttpOutputUrlResponse(UrlRequest);
+    if (!YoriLibHttpPrepareResponseBody(UrlRequest)) {
+        return FALSE;
+    }
 
     return TRUE;
 }
@@ -854,7 +1348,11 @@ YoriLibHttpMergeRedirectUrl(
 }
 
 /**
- Opens a specified URL resource.  This includes downloading all contents.
+ Opens a specified URL resource.  This sends the request, follows any
+ redirects, and receives the response headers.  The body is received as it is
+ read with @ref YoriLibInternetReadFile .  Connections are retained on the
+ Internet handle once a response is complete so that later requests to the
+ same host can reuse them.
 
  @param hInternet Handle to an internet resource opened with
         @ref YoriLibInternetOpen .
@@ -945,6 +1443,8 @@ YoriLibInternetOpenUrl(
             break;
         }
 
+        YoriLibHttpReleaseConnection(UrlHandle);
+
         YoriLibInitEmptyString(&RedirectUrl);
         if (!YoriLibHttpMergeRedirectUrl(&UrlHandle->u.Url.Url, &LocationHeader, &RedirectUrl)) {
             YoriLibFreeStringContents(&LocationHeader);
@@ -962,8 +1462,133 @@ YoriLibInternetOpenUrl(
 }
 
 
+/**
+ Read a single line from the server, as used to delimit chunks in a chunked
+ response.  The line break is consumed and not returned.
+
+ @param UrlRequest Pointer to the URL handle.
+
+ @param Line Pointer to a string with an existing allocation to populate
+        with the line.  A line longer than this allocation is treated as a
+        failure.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+YoriLibHttpReadLine(
+    __inout PYORI_LIB_INTERNET_HANDLE UrlRequest,
+    __inout PYORI_STRING Line
+    )
+{
+    PUCHAR Source;
+    DWORD BytesReceived;
+
+    Line->LengthInChars = 0;
+    while (TRUE) {
+        if (UrlRequest->u.Url.CurrentReadOffset == UrlRequest->u.Url.ByteBuffer.BytesPopulated) {
+            if (!YoriLibHttpReceive(UrlRequest, &BytesReceived) || BytesReceived == 0) {
+                return FALSE;
+            }
+        }
+
+        Source = YoriLibAddToPointer(UrlRequest->u.Url.ByteBuffer.Buffer, UrlRequest->u.Url.CurrentReadOffset);
+        UrlRequest->u.Url.CurrentReadOffset++;
+
+        if (*Source == '\n') {
+            if (Line->LengthInChars > 0 &&
+                Line->StartOfString[Line->LengthInChars - 1] == '\r') {
+
+                Line->LengthInChars--;
+            }
+            return TRUE;
+        }
+
+        if (Line->LengthInChars >= Line->LengthAllocated) {
+            return FALSE;
+        }
+
+        Line->StartOfString[Line->LengthInChars] = *Source;
+        Line->LengthInChars++;
+    }
+}
+
+/**
+ Read the line describing the next chunk in a chunked response.  On
+ successful completion, BodyBytesRemaining describes the size of the chunk,
+ or BodyComplete is set if the final chunk has been reached.
+
+ @param UrlRequest Pointer to the URL handle.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+YoriLibHttpReadChunkHeader(
+    __inout PYORI_LIB_INTERNET_HANDLE UrlRequest
+    )
+{
+    TCHAR LineBuffer[YORI_LIB_HTTP_MAX_CHUNK_LINE];
+    YORI_STRING Line;
+    YORI_MAX_SIGNED_T llTemp;
+    YORI_ALLOC_SIZE_T CharsConsumed;
+
+    YoriLibInitEmptyString(&Line);
+    Line.StartOfString = LineBuffer;
+    Line.LengthAllocated = sizeof(LineBuffer)/sizeof(LineBuffer[0]);
+
+    //
+    //  The data for each chunk is followed by a line break.
+    //
+
+    if (UrlRequest->u.Url.ChunkEndPending) {
+        if (!YoriLibHttpReadLine(UrlRequest, &Line) || Line.LengthInChars != 0) {
+            return FALSE;
+        }
+        UrlRequest->u.Url.ChunkEndPending = FALSE;
+    }
+
+    //
+    //  The size is in hex, and may be followed by extensions which are
+    //  ignored.  Limit the number of digits so the size can't overflow.
+    //
+
+    if (!YoriLibHttpReadLine(UrlRequest, &Line)) {
+        return FALSE;
+    }
+
+    if (!YoriLibStringToNumberBase(&Line, 16, FALSE, &llTemp, &CharsConsumed) ||
+        CharsConsumed == 0 ||
+        CharsConsumed > 15 ||
+        llTemp < 0) {
+
+        return FALSE;
+    }
+
+    if (llTemp > 0) {
+        UrlRequest->u.Url.BodyBytesRemaining = (DWORDLONG)llTemp;
+        return TRUE;
+    }
+
+    //
+    //  A zero sized chunk ends the body.  It is followed by any trailing
+    //  headers, which are ignored, and an empty line.
+    //
+
+    do {
+        if (!YoriLibHttpReadLine(UrlRequest, &Line)) {
+            return FALSE;
+        }
+    } while (Line.LengthInChars > 0);
+
+    UrlRequest->u.Url.BodyComplete = TRUE;
+    return TRUE;
+}
+
 /**
  Reads data from a successful handle opened via @ref YoriLibInternetOpenUrl .
+ The body is received from the server as it is read, and any chunked
+ encoding is removed.
 
  @param hRequest A handle returned from @ref YoriLibInternetOpenUrl .
 
@@ -974,7 +1599,7 @@ YoriLibInternetOpenUrl(
 
  @param BytesRead On successful completion, updated to contain the number of
         bytes successfully read into Buffer.  This may be less than
-        BytesToRead .
+        BytesToRead .  Zero indicates the entire body has been read.
 
  @return TRUE to indicate success, FALSE to indicate failure.
  */
@@ -988,9 +1613,13 @@ YoriLibInternetReadFile(
     )
 {
     PYORI_LIB_INTERNET_HANDLE UrlHandle;
-    DWORDLONG BufferOffset;
+    DWORDLONG BytesBuffered;
+    DWORD BytesCopied;
     DWORD BytesToCopy;
     PUCHAR Source;
+    PUCHAR Target;
+    INT Received;
+    BOOLEAN LengthLimited;
 
     UrlHandle = (PYORI_LIB_INTERNET_HANDLE)hRequest;
 
@@ -998,24 +1627,78 @@ YoriLibInternetReadFile(
         return FALSE;
     }
 
-    BufferOffset = UrlHandle->u.Url.HttpBodyOffset;
-    BufferOffset = BufferOffset + UrlHandle->u.Url.CurrentReadOffset;
+    Target = (PUCHAR)Buffer;
+    BytesCopied = 0;
+    LengthLimited = (BOOLEAN)(UrlHandle->u.Url.LengthKnown || UrlHandle->u.Url.Chunked);
 
-    BytesToCopy = BytesToRead;
-    if (BufferOffset + BytesToCopy > UrlHandle->u.Url.ByteBuffer.BytesPopulated) {
-        BytesToCopy = (DWORD)(UrlHandle->u.Url.ByteBuffer.BytesPopulated - BufferOffset);
-    }
+    while (BytesCopied < BytesToRead && !UrlHandle->u.Url.BodyComplete) {
 
-    if (BytesToCopy == 0) {
-        *BytesRead = 0;
-        return TRUE;
-    }
+        if (UrlHandle->u.Url.Chunked && UrlHandle->u.Url.BodyBytesRemaining == 0) {
+            if (!YoriLibHttpReadChunkHeader(UrlHandle)) {
+                return FALSE;
+            }
+            continue;
+        }
+
+        BytesToCopy = BytesToRead - BytesCopied;
+        if (LengthLimited && BytesToCopy > UrlHandle->u.Url.BodyBytesRemaining) {
+            BytesToCopy = (DWORD)UrlHandle->u.Url.BodyBytesRemaining;
+        }
+
+        //
+        //  Return any data which has already been received.  Otherwise,
+        //  receive directly into the caller's buffer.  Since this never
+        //  exceeds the extent of the body, data for a later response on the
+        //  same connection is never consumed here.
+        //
+
+        BytesBuffered = UrlHandle->u.Url.ByteBuffer.BytesPopulated - UrlHandle->u.Url.CurrentReadOffset;
+        if (BytesBuffered > 0) {
+            if (BytesToCopy > BytesBuffered) {
+                BytesToCopy = (DWORD)BytesBuffered;
+            }
+            Source = YoriLibAddToPointer(UrlHandle->u.Url.ByteBuffer.Buffer, UrlHandle->u.Url.CurrentReadOffset);
+            memcpy(&Target[BytesCopied], Source, BytesToCopy);
+            UrlHandle->u.Url.CurrentReadOffset = UrlHandle->u.Url.CurrentReadOffset + BytesToCopy;
+        } else {
+            Received = DllWsock32.precv(UrlHandle->u.Url.Connection->Socket, &Target[BytesCopied], (INT)BytesToCopy, 0);
+            if (Received < 0) {
+                return FALSE;
+            }
+
+            //
+            //  If the server indicated the length of the body, closing the
+            //  connection early means the body is truncated.  Otherwise
+            //  closing the connection is how the end of the body is
+            //  indicated.
+            //
+
+            if (Received == 0) {
+                if (LengthLimited) {
+                    return FALSE;
+                }
+                UrlHandle->u.Url.BodyComplete = TRUE;
+                break;
+            }
+
+            BytesToCopy = (DWORD)Received;
+        }
+
+        BytesCopied = BytesCopied + BytesToCopy;
 
-    Source = YoriLibAddToPointer(UrlHandle->u.Url.ByteBuffer.Buffer, BufferOffset);
-    memcpy(Buffer, Source, BytesToCopy);
-    *BytesRead = BytesToCopy;
+        if (LengthLimited) {
+            UrlHandle->u.Url.BodyBytesRemaining = UrlHandle->u.Url.BodyBytesRemaining - BytesToCopy;
+            if (UrlHandle->u.Url.BodyBytesRemaining == 0) {
+                if (UrlHandle->u.Url.Chunked) {
+                    UrlHandle->u.Url.ChunkEndPending = TRUE;
+                } else {
+                    UrlHandle->u.Url.BodyComplete = TRUE;
+                }
+            }
+        }
+    }
 
-    UrlHandle->u.Url.CurrentReadOffset = UrlHandle->u.Url.CurrentReadOffset + BytesToCopy;
+    *BytesRead = BytesCopied;
     return TRUE;
 }
 
@@ -1024,14 +1707,17 @@ YoriLibInternetReadFile(
 
  @param hRequest A handle returned from @ref YoriLibInternetOpenUrl .
 
- @param InfoLevel The type of information requested.
+ @param InfoLevel The type of information requested.  This library supports
+        the status code as a number, and the ETag and Last-Modified headers
+        as strings.
 
  @param Buffer On successful completion, populated with the requested
         information.
 
  @param BufferLength Specifies the length of Buffer, in bytes.  On successful
         completion, updated to indicate the number of bytes copied into
-        Buffer.
+        Buffer, not including any NULL terminator.  If the buffer is too
+        small, updated to indicate the number of bytes required.
 
  @param Index Pointer to a zero based header index for repeated queries.  Not
         supported by this library.
@@ -1050,7 +1736,11 @@ YoriLibHttpQueryInfo(
 {
     DWORD InfoLevelModifier;
     DWORD InfoLevelIndex;
+    DWORD LengthRequired;
     PYORI_LIB_INTERNET_HANDLE UrlHandle;
+    PYORI_LIB_HTTP_HEADER_LINE ResponseLine;
+    LPCTSTR HeaderName;
+    LPTSTR OutputString;
     PDWORD OutputNumber;
 
     UrlHandle = (PYORI_LIB_INTERNET_HANDLE)hRequest;
@@ -1062,26 +1752,55 @@ YoriLibHttpQueryInfo(
     InfoLevelModifier = (InfoLevel & 0xF0000000);
     InfoLevelIndex = (InfoLevel & 0x0000FFFF);
 
-    if (InfoLevelModifier != HTTP_QUERY_FLAG_NUMBER ||
-        InfoLevelIndex != HTTP_QUERY_STATUS_CODE) {
+    if (Buffer == NULL || BufferLength == NULL) {
+        return FALSE;
+    }
+
+    if (Index != NULL) {
+        *Index = 0;
+    }
+
+    if (InfoLevelModifier == HTTP_QUERY_FLAG_NUMBER &&
+        InfoLevelIndex == HTTP_QUERY_STATUS_CODE) {
+
+        if ((*BufferLength) < sizeof(DWORD)) {
+            return FALSE;
+        }
+
+        OutputNumber = (PDWORD)Buffer;
+        *OutputNumber = UrlHandle->u.Url.HttpStatusCode;
+        *BufferLength = sizeof(DWORD);
+        return TRUE;
+    }
 
+    if (InfoLevelModifier != 0) {
         return FALSE;
     }
 
-    if (Buffer == NULL ||
-        BufferLength == NULL ||
-        (*BufferLength) < sizeof(DWORD)) {
+    if (InfoLevelIndex == HTTP_QUERY_ETAG) {
+        HeaderName = _T("ETag");
+    } else if (InfoLevelIndex == HTTP_QUERY_LAST_MODIFIED) {
+        HeaderName = _T("Last-Modified");
+    } else {
+        return FALSE;
+    }
 
+    ResponseLine = YoriLibHttpFindResponseHeader(UrlHandle, HeaderName);
+    if (ResponseLine == NULL) {
         return FALSE;
     }
 
-    if (Index != NULL) {
-        *Index = 0;
+    LengthRequired = (ResponseLine->Value.LengthInChars + 1) * sizeof(TCHAR);
+    if ((*BufferLength) < LengthRequired) {
+        *BufferLength = LengthRequired;
+        SetLastError(ERROR_INSUFFICIENT_BUFFER);
+        return FALSE;
     }
 
-    OutputNumber = (PDWORD)Buffer;
-    *OutputNumber = UrlHandle->u.Url.HttpStatusCode;
-    *BufferLength = sizeof(DWORD);
+    OutputString = (LPTSTR)Buffer;
+    memcpy(OutputString, ResponseLine->Value.StartOfString, ResponseLine->Value.LengthInChars * sizeof(TCHAR));
+    OutputString[ResponseLine->Value.LengthInChars] = '\0';
+    *BufferLength = ResponseLine->Value.LengthInChars * sizeof(TCHAR);
 
     return TRUE;
 }
@@ -135,6 +135,346 @@ YoriLibSetMultibyteInputEncoding(
     YoriLibActiveInputEncodingInitialized = TRUE;
 }
 
+/**
+ Returns TRUE if the specified encoding represents every character below
+ 0x80 as the same single byte, and never uses a byte below 0x80 to begin a
+ multibyte character.  For these encodings a run of ASCII text converts
+ trivially, and a string can be split before any byte which is not ASCII
+ without changing the result of converting it.  Note that double byte
+ encodings meet this requirement, because although a trail byte may be
+ below 0x80, the lead byte is not.
+
+ @param Encoding The encoding to check.
+
+ @return TRUE if the encoding is compatible with ASCII, FALSE if it is not,
+         or if it is not known to be.
+ */
+BOOLEAN
+YoriLibIsEncodingAsciiCompatible(
+    __in DWORD Encoding
+    )
+{
+    switch(Encoding) {
+        case CP_UTF8:
+        case CP_ACP:
+        case CP_OEMCP:
+        case 437:
+        case 850:
+        case 1250:
+        case 1251:
+        case 1252:
+        case 1253:
+        case 1254:
+        case 1255:
+        case 1256:
+        case 1257:
+        case 1258:
+        case 28591:
+            return TRUE;
+    }
+
+    return FALSE;
+}
+
+/**
+ Convert as much of a UTF16 string as possible into UTF8 or another ASCII
+ compatible encoding without calling the system.  For UTF8, this converts
+ everything up to the first unpaired surrogate; for other encodings, it
+ converts everything up to the first character which is not ASCII.  ASCII
+ text is converted several characters at a time.  The caller is expected
+ to convert anything that remains via the system.
+
+ @param Utf8 TRUE if the output encoding is UTF8, FALSE if it is another
+        ASCII compatible encoding.
+
+ @param InputStringBuffer Pointer to a UTF16 string.
+
+ @param InputBufferLength The size of InputStringBuffer, in characters.
+
+ @param OutputStringBuffer Optionally points to a buffer to be populated with
+        the converted string.  If NULL, the number of bytes needed is
+        calculated without converting.
+
+ @param OutputBufferLength The length of the output buffer, in bytes.
+
+ @param CharsConsumed On completion, populated with the number of characters
+        from InputStringBuffer that have been converted.
+
+ @return The number of bytes written to OutputStringBuffer, or needed if
+         OutputStringBuffer is NULL.
+ */
+YORI_ALLOC_SIZE_T
+YoriLibMultibyteOutputFast(
+    __in BOOLEAN Utf8,
+    __in_ecount(InputBufferLength) LPCTSTR InputStringBuffer,
+    __in YORI_ALLOC_SIZE_T InputBufferLength,
+    __out_ecount_opt(OutputBufferLength) LPSTR OutputStringBuffer,
+    __in YORI_ALLOC_SIZE_T OutputBufferLength,
+    __out PYORI_ALLOC_SIZE_T CharsConsumed
+    )
+{
+    YORI_ALLOC_SIZE_T InIndex;
+    YORI_ALLOC_SIZE_T OutIndex;
+    YORI_ALLOC_SIZE_T BytesThisChar;
+    DWORD Char;
+    PUCHAR Output;
+
+    Output = (PUCHAR)OutputStringBuffer;
+    InIndex = 0;
+    OutIndex = 0;
+
+    while (InIndex < InputBufferLength) {
+
+        //
+        //  Check for a run of four ASCII characters, and if found, copy
+        //  them without any further checks.
+        //
+
+        if (InIndex + 4 <= InputBufferLength &&
+            ((InputStringBuffer[InIndex] |
+              InputStringBuffer[InIndex + 1] |
+              InputStringBuffer[InIndex + 2] |
+              InputStringBuffer[InIndex + 3]) & 0xFF80) == 0) {
+
+            if (Output != NULL) {
+                if (OutIndex + 4 > OutputBufferLength) {
+                    break;
+                }
+                Output[OutIndex] = (UCHAR)InputStringBuffer[InIndex];
+                Output[OutIndex + 1] = (UCHAR)InputStringBuffer[InIndex + 1];
+                Output[OutIndex + 2] = (UCHAR)InputStringBuffer[InIndex + 2];
+                Output[OutIndex + 3] = (UCHAR)InputStringBuffer[InIndex + 3];
+            }
+            InIndex = InIndex + 4;
+            OutIndex = OutIndex + 4;
+            continue;
+        }
+
+        Char = InputStringBuffer[InIndex];
+        if (Char < 0x80) {
+            BytesThisChar = 1;
+        } else if (!Utf8) {
+            break;
+        } else if (Char < 0x800) {
+            BytesThisChar = 2;
+        } else if (Char >= 0xD800 && Char <= 0xDBFF) {
+            if (InIndex + 1 >= InputBufferLength ||
+                InputStringBuffer[InIndex + 1] < 0xDC00 ||
+                InputStringBuffer[InIndex + 1] > 0xDFFF) {
+
+                break;
+            }
+            Char = 0x10000 + ((Char - 0xD800) << 10) + (InputStringBuffer[InIndex + 1] - 0xDC00);
+            BytesThisChar = 4;
+        } else if (Char >= 0xDC00 && Char <= 0xDFFF) {
+            break;
+        } else {
+            BytesThisChar = 3;
+        }
+
+        if (Output != NULL) {
+            if (OutIndex + BytesThisChar > OutputBufferLength) {
+                break;
+            }
+            switch(BytesThisChar) {
+                case 1:
+                    Output[OutIndex] = (UCHAR)Char;
+                    break;
+                case 2:
+                    Output[OutIndex] = (UCHAR)(0xC0 | (Char >> 6));
+                    Output[OutIndex + 1] = (UCHAR)(0x80 | (Char & 0x3F));
+                    break;
+                case 3:
+                    Output[OutIndex] = (UCHAR)(0xE0 | (Char >> 12));
+                    Output[OutIndex + 1] = (UCHAR)(0x80 | ((Char >> 6) & 0x3F));
+                    Output[OutIndex + 2] = (UCHAR)(0x80 | (Char & 0x3F));
+                    break;
+                default:
+                    Output[OutIndex] = (UCHAR)(0xF0 | (Char >> 18));
+                    Output[OutIndex + 1] = (UCHAR)(0x80 | ((Char >> 12) & 0x3F));
+                    Output[OutIndex + 2] = (UCHAR)(0x80 | ((Char >> 6) & 0x3F));
+                    Output[OutIndex + 3] = (UCHAR)(0x80 | (Char & 0x3F));
+                    break;
+            }
+        }
+
+        if (BytesThisChar == 4) {
+            InIndex = InIndex + 2;
+        } else {
+            InIndex++;
+        }
+        OutIndex = OutIndex + BytesThisChar;
+    }
+
+    *CharsConsumed = InIndex;
+    return OutIndex;
+}
+
+/**
+ Convert as much of a string in UTF8 or another ASCII compatible encoding
+ as possible into UTF16 without calling the system.  For UTF8, this converts
+ everything up to the first invalid or incomplete sequence; for other
+ encodings, it converts everything up to the first byte which is not ASCII.
+ ASCII text is converted several bytes at a time.  The caller is expected to
+ convert anything that remains via the system, which defines how invalid
+ input is handled.
+
+ @param Utf8 TRUE if the input encoding is UTF8, FALSE if it is another
+        ASCII compatible encoding.
+
+ @param InputStringBuffer Pointer to a string in the input encoding.
+
+ @param InputBufferLength The size of InputStringBuffer, in bytes.
+
+ @param OutputStringBuffer Optionally points to a buffer to be populated with
+        the converted string.  If NULL, the number of characters needed is
+        calculated without converting.
+
+ @param OutputBufferLength The length of the output buffer, in characters.
+
+ @param BytesConsumed On completion, populated with the number of bytes from
+        InputStringBuffer that have been converted.
+
+ @return The number of characters written to OutputStringBuffer, or needed
+         if OutputStringBuffer is NULL.
+ */
+YORI_ALLOC_SIZE_T
+YoriLibMultibyteInputFast(
+    __in BOOLEAN Utf8,
+    __in_ecount(InputBufferLength) LPCSTR InputStringBuffer,
+    __in YORI_ALLOC_SIZE_T InputBufferLength,
+    __out_ecount_opt(OutputBufferLength) LPTSTR OutputStringBuffer,
+    __in YORI_ALLOC_SIZE_T OutputBufferLength,
+    __out PYORI_ALLOC_SIZE_T BytesConsumed
+    )
+{
+    YORI_ALLOC_SIZE_T InIndex;
+    YORI_ALLOC_SIZE_T OutIndex;
+    YORI_ALLOC_SIZE_T BytesThisChar;
+    DWORD Char;
+    UCHAR Lead;
+    UCHAR Low;
+    UCHAR High;
+    PUCHAR Input;
+
+    Input = (PUCHAR)InputStringBuffer;
+    InIndex = 0;
+    OutIndex = 0;
+
+    while (InIndex < InputBufferLength) {
+
+        //
+        //  Check for a run of four ASCII bytes, and if found, widen them
+        //  without any further checks.
+        //
+
+        if (InIndex + 4 <= InputBufferLength &&
+            ((Input[InIndex] |
+              Input[InIndex + 1] |
+              Input[InIndex + 2] |
+              Input[InIndex + 3]) & 0x80) == 0) {
+
+            if (OutputStringBuffer != NULL) {
+                if (OutIndex + 4 > OutputBufferLength) {
+                    break;
+                }
+                OutputStringBuffer[OutIndex] = Input[InIndex];
+                OutputStringBuffer[OutIndex + 1] = Input[InIndex + 1];
+                OutputStringBuffer[OutIndex + 2] = Input[InIndex + 2];
+                OutputStringBuffer[OutIndex + 3] = Input[InIndex + 3];
+            }
+            InIndex = InIndex + 4;
+            OutIndex = OutIndex + 4;
+            continue;
+        }
+
+        Lead = Input[InIndex];
+        if (Lead < 0x80) {
+            Char = Lead;
+            BytesThisChar = 1;
+        } else if (!Utf8) {
+            break;
+        } else {
+
+            //
+            //  Determine the length of the sequence and the valid range of
+            //  the second byte, which excludes overlong forms, surrogates,
+            //  and values above 0x10FFFF.
+            //
+
+            Low = 0x80;
+            High = 0xBF;
+            if (Lead >= 0xC2 && Lead <= 0xDF) {
+                BytesThisChar = 2;
+                Char = Lead & 0x1F;
+            } else if (Lead >= 0xE0 && Lead <= 0xEF) {
+                BytesThisChar = 3;
+                Char = Lead & 0x0F;
+                if (Lead == 0xE0) {
+                    Low = 0xA0;
+                } else if (Lead == 0xED) {
+                    High = 0x9F;
+                }
+            } else if (Lead >= 0xF0 && Lead <= 0xF4) {
+                BytesThisChar = 4;
+                Char = Lead & 0x07;
+                if (Lead == 0xF0) {
+                    Low = 0x90;
+                } else if (Lead == 0xF4) {
+                    High = 0x8F;
+                }
+            } else {
+                break;
+            }
+
+            if (InIndex + BytesThisChar > InputBufferLength ||
+                Input[InIndex + 1] < Low ||
+                Input[InIndex + 1] > High) {
+
+                break;
+            }
+
+            Char = (Char << 6) | (Input[InIndex + 1] & 0x3F);
+            if (BytesThisChar >= 3) {
+                if ((Input[InIndex + 2] & 0xC0) != 0x80) {
+                    break;
+                }
+                Char = (Char << 6) | (Input[InIndex + 2] & 0x3F);
+            }
+            if (BytesThisChar == 4) {
+                if ((Input[InIndex + 3] & 0xC0) != 0x80) {
+                    break;
+                }
+                Char = (Char << 6) | (Input[InIndex + 3] & 0x3F);
+            }
+        }
+
+        if (Char >= 0x10000) {
+            if (OutputStringBuffer != NULL) {
+                if (OutIndex + 2 > OutputBufferLength) {
+                    break;
+                }
+                Char = Char - 0x10000;
+                OutputStringBuffer[OutIndex] = (TCHAR)(0xD800 + (Char >> 10));
+                OutputStringBuffer[OutIndex + 1] = (TCHAR)(0xDC00 + (Char & 0x3FF));
+            }
+            OutIndex = OutIndex + 2;
+        } else {
+            if (OutputStringBuffer != NULL) {
+                if (OutIndex + 1 > OutputBufferLength) {
+                    break;
+                }
+                OutputStringBuffer[OutIndex] = (TCHAR)Char;
+            }
+            OutIndex++;
+        }
+        InIndex = InIndex + BytesThisChar;
+    }
+
+    *BytesConsumed = InIndex;
+    return OutIndex;
+}
+
 /**
  Returns the number of bytes needed to store a specified UTF16 string in
  the current output encoding.
@@ -152,14 +492,27 @@ YoriLibGetMbyteOutputSizeNeeded(
     )
 {
     DWORD Return;
+    YORI_ALLOC_SIZE_T FastLength;
+    YORI_ALLOC_SIZE_T CharsConsumed;
     DWORD Encoding = YoriLibGetMultibyteOutputEncoding();
     if (Encoding == CP_UTF16) {
         return BufferLength * sizeof(WCHAR);
     }
+
+    FastLength = 0;
+    if (YoriLibIsEncodingAsciiCompatible(Encoding)) {
+        FastLength = YoriLibMultibyteOutputFast((BOOLEAN)(Encoding == CP_UTF8), StringBuffer, BufferLength, NULL, 0, &CharsConsumed);
+        if (CharsConsumed == BufferLength) {
+            return FastLength;
+        }
+        StringBuffer = StringBuffer + CharsConsumed;
+        BufferLength = BufferLength - CharsConsumed;
+    }
+
     Return = WideCharToMultiByte(Encoding, 0, StringBuffer, BufferLength, NULL, 0, NULL, NULL);
     ASSERT(Return > 0 || BufferLength == 0);
-    ASSERT(YoriLibIsSizeAllocatable(Return));
-    return (YORI_ALLOC_SIZE_T)Return;
+    ASSERT(YoriLibIsSizeAllocatable(FastLength + Return));
+    return (YORI_ALLOC_SIZE_T)(FastLength + Return);
 }
 
 #if defined(_MSC_VER) && (_MSC_VER >= 1700)
@@ -180,8 +533,10 @@ YoriLibGetMbyteOutputSizeNeeded(
         in the current output encoding.
 
  @param OutputBufferLength The length of the output buffer, in bytes.
+
+ @return The number of bytes written to OutputStringBuffer.
  */
-VOID
+YORI_ALLOC_SIZE_T
 YoriLibMultibyteOutput(
     __in_ecount(InputBufferLength) LPCTSTR InputStringBuffer,
     __in YORI_ALLOC_SIZE_T InputBufferLength,
@@ -190,20 +545,33 @@ YoriLibMultibyteOutput(
     )
 {
     DWORD Return;
+    YORI_ALLOC_SIZE_T FastLength;
+    YORI_ALLOC_SIZE_T CharsConsumed;
     DWORD Encoding = YoriLibGetMultibyteOutputEncoding();
     if (Encoding == CP_UTF16) {
         ASSERT(OutputBufferLength >= InputBufferLength * sizeof(WCHAR));
         if (OutputBufferLength >= InputBufferLength * sizeof(WCHAR)) {
             memcpy(OutputStringBuffer, InputStringBuffer, InputBufferLength * sizeof(WCHAR));
+            return InputBufferLength * sizeof(WCHAR);
         }
-        return;
+        return 0;
     }
+
+    FastLength = 0;
+    CharsConsumed = 0;
+    if (YoriLibIsEncodingAsciiCompatible(Encoding)) {
+        FastLength = YoriLibMultibyteOutputFast((BOOLEAN)(Encoding == CP_UTF8), InputStringBuffer, InputBufferLength, OutputStringBuffer, OutputBufferLength, &CharsConsumed);
+        if (CharsConsumed == InputBufferLength) {
+            return FastLength;
+        }
+    }
+
     Return = WideCharToMultiByte(Encoding,
                                  0,
-                                 InputStringBuffer,
-                                 InputBufferLength,
-                                 OutputStringBuffer,
-                                 OutputBufferLength,
+                                 &InputStringBuffer[CharsConsumed],
+                                 InputBufferLength - CharsConsumed,
+                                 &OutputStringBuffer[FastLength],
+                                 OutputBufferLength - FastLength,
                                  NULL,
                                  NULL);
 
@@ -211,6 +579,8 @@ YoriLibMultibyteOutput(
         YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("InputBufferLength %i OutputBufferLength %i\n"), InputBufferLength, OutputBufferLength);
         ASSERT(Return != 0);
     }
+
+    return (YORI_ALLOC_SIZE_T)(FastLength + Return);
 }
 
 /**
@@ -231,12 +601,25 @@ YoriLibGetMultibyteInputSizeNeeded(
 {
     DWORD Encoding = YoriLibGetMultibyteInputEncoding();
     DWORD Return;
+    YORI_ALLOC_SIZE_T FastLength;
+    YORI_ALLOC_SIZE_T BytesConsumed;
     if (Encoding == CP_UTF16) {
         return BufferLength;
     }
+
+    FastLength = 0;
+    if (YoriLibIsEncodingAsciiCompatible(Encoding)) {
+        FastLength = YoriLibMultibyteInputFast((BOOLEAN)(Encoding == CP_UTF8), StringBuffer, BufferLength, NULL, 0, &BytesConsumed);
+        if (BytesConsumed == BufferLength) {
+            return FastLength;
+        }
+        StringBuffer = StringBuffer + BytesConsumed;
+        BufferLength = BufferLength - BytesConsumed;
+    }
+
     Return = MultiByteToWideChar(Encoding, 0, StringBuffer, BufferLength, NULL, 0);
-    ASSERT(YoriLibIsSizeAllocatable(Return));
-    return (YORI_ALLOC_SIZE_T)Return;
+    ASSERT(YoriLibIsSizeAllocatable(FastLength + Return));
+    return (YORI_ALLOC_SIZE_T)(FastLength + Return);
 }
 
 /**
@@ -250,8 +633,13 @@ YoriLibGetMultibyteInputSizeNeeded(
         in UTF16 format.
 
  @param OutputBufferLength The length of the output buffer, in characters.
+        Note that no encoding generates more characters than the number of
+        bytes in its input, so a buffer of InputBufferLength characters is
+        always sufficient.
+
+ @return The number of characters written to OutputStringBuffer.
  */
-VOID
+YORI_ALLOC_SIZE_T
 YoriLibMultibyteInput(
     __in_ecount(InputBufferLength) LPCSTR InputStringBuffer,
     __in YORI_ALLOC_SIZE_T InputBufferLength,
@@ -260,22 +648,36 @@ YoriLibMultibyteInput(
     )
 {
     DWORD Return;
+    YORI_ALLOC_SIZE_T FastLength;
+    YORI_ALLOC_SIZE_T BytesConsumed;
     DWORD Encoding = YoriLibGetMultibyteInputEncoding();
     if (Encoding == CP_UTF16) {
         ASSERT(OutputBufferLength >= InputBufferLength);
         if (OutputBufferLength >= InputBufferLength) {
             memcpy(OutputStringBuffer, InputStringBuffer, InputBufferLength * sizeof(WCHAR));
+            return InputBufferLength;
         }
-        return;
+        return 0;
     }
+
+    FastLength = 0;
+    BytesConsumed = 0;
+    if (YoriLibIsEncodingAsciiCompatible(Encoding)) {
+        FastLength = YoriLibMultibyteInputFast((BOOLEAN)(Encoding == CP_UTF8), InputStringBuffer, InputBufferLength, OutputStringBuffer, OutputBufferLength, &BytesConsumed);
+        if (BytesConsumed == InputBufferLength) {
+            return FastLength;
+        }
+    }
+
     Return = MultiByteToWideChar(Encoding,
                                  0,
-                                 InputStringBuffer,
-                                 InputBufferLength,
-                                 OutputStringBuffer,
-                                 OutputBufferLength);
+                                 &InputStringBuffer[BytesConsumed],
+                                 InputBufferLength - BytesConsumed,
+                                 &OutputStringBuffer[FastLength],
+                                 OutputBufferLength - FastLength);
 
     ASSERT(Return != 0);
+    return (YORI_ALLOC_SIZE_T)(FastLength + Return);
 }
 
 // vim:sw=4:ts=4:et:
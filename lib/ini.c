@@ -0,0 +1,1255 @@
+/**
+ * @file lib/ini.c
+ *
+ * Yori in memory INI file support
+ *
+ * Copyright (c) 2026 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "yoripch.h"
+#include "yorilib.h"
+
+//
+//  GetPrivateProfileString and WritePrivateProfileString open and parse the
+//  INI file on every call, so code that reads or writes many values spends
+//  most of its time reparsing the same file.  These routines instead parse
+//  the file once into memory, answer queries and apply changes against the
+//  in memory copy, and write the result back with a single operation.
+//
+//  The routines follow the semantics of the profile APIs so callers can be
+//  converted without changing their logic: names are compared case
+//  insensitively, the first of any duplicate section or key is used,
+//  comments and other lines that are not values are preserved, and the file
+//  is written back in the encoding it was read in.
+//
+
+/**
+ The number of hash buckets to allocate for the sections in an INI file.
+ */
+#define YORI_LIB_INI_SECTION_BUCKETS (16)
+
+/**
+ The number of hash buckets to allocate for the keys in a section.
+ */
+#define YORI_LIB_INI_KEY_BUCKETS (8)
+
+/**
+ A single line within a section of an INI file.  Most lines are values,
+ which have a key name and a value.  Lines that are not values, such as
+ comments, are retained so they can be written back, but are never found by
+ a query.
+ */
+typedef struct _YORI_LIB_INI_KEY {
+
+    /**
+     The list of lines within the section.  Paired with
+     YORI_LIB_INI_SECTION::KeyList.
+     */
+    YORI_LIST_ENTRY ListEntry;
+
+    /**
+     The entry for this key within the section's hash table.  Only valid if
+     Hashed is TRUE.
+     */
+    YORI_HASH_ENTRY HashEntry;
+
+    /**
+     The name of the key.  For lines that are not values, this contains the
+     entire line.
+     */
+    YORI_STRING Name;
+
+    /**
+     The value of the key.
+     */
+    YORI_STRING Value;
+
+    /**
+     TRUE if the line is a value.  FALSE if the line is a comment or other
+     text that should be preserved but not interpreted.
+     */
+    BOOLEAN IsValue;
+
+    /**
+     TRUE if the key has been inserted into the section's hash table.  This
+     is FALSE for lines that are not values and for duplicate keys.
+     */
+    BOOLEAN Hashed;
+
+} YORI_LIB_INI_KEY, *PYORI_LIB_INI_KEY;
+
+/**
+ A single section within an INI file.
+ */
+typedef struct _YORI_LIB_INI_SECTION {
+
+    /**
+     The list of sections within the INI file.  Paired with
+     YORI_LIB_INI::SectionList.
+     */
+    YORI_LIST_ENTRY ListEntry;
+
+    /**
+     The entry for this section within the INI file's hash table.  Only
+     valid if Hashed is TRUE.
+     */
+    YORI_HASH_ENTRY HashEntry;
+
+    /**
+     The name of the section.
+     */
+    YORI_STRING Name;
+
+    /**
+     The list of lines within the section.
+     */
+    YORI_LIST_ENTRY KeyList;
+
+    /**
+     A hash table of the keys within the section.
+     */
+    PYORI_HASH_TABLE KeyHash;
+
+    /**
+     TRUE if the section has a header.  This is FALSE for any text that
+     precedes the first section in the file.
+     */
+    BOOLEAN HasHeader;
+
+    /**
+     TRUE if the section has been inserted into the INI file's hash table.
+     */
+    BOOLEAN Hashed;
+
+} YORI_LIB_INI_SECTION, *PYORI_LIB_INI_SECTION;
+
+/**
+ Initialize an INI file in memory so that it contains no sections.
+
+ @param Ini Pointer to the INI file to initialize.
+ */
+VOID
+YoriLibIniInitialize(
+    __out PYORI_LIB_INI Ini
+    )
+{
+    YoriLibInitEmptyString(&Ini->FileName);
+    YoriLibInitializeListHead(&Ini->SectionList);
+    Ini->SectionHash = NULL;
+    Ini->Unicode = FALSE;
+    Ini->Dirty = FALSE;
+}
+
+/**
+ Free a single line within a section.
+
+ @param Key Pointer to the line to free.
+ */
+VOID
+YoriLibIniFreeKey(
+    __in PYORI_LIB_INI_KEY Key
+    )
+{
+    if (Key->Hashed) {
+        YoriLibHashRemoveByEntry(&Key->HashEntry);
+    }
+    YoriLibRemoveListItem(&Key->ListEntry);
+    YoriLibFreeStringContents(&Key->Name);
+    YoriLibFreeStringContents(&Key->Value);
+    YoriLibFree(Key);
+}
+
+/**
+ Free a section and all of the lines within it.
+
+ @param Section Pointer to the section to free.
+ */
+VOID
+YoriLibIniFreeSection(
+    __in PYORI_LIB_INI_SECTION Section
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PYORI_LIB_INI_KEY Key;
+
+    ListEntry = YoriLibGetNextListEntry(&Section->KeyList, NULL);
+    while (ListEntry != NULL) {
+        Key = CONTAINING_RECORD(ListEntry, YORI_LIB_INI_KEY, ListEntry);
+        ListEntry = YoriLibGetNextListEntry(&Section->KeyList, ListEntry);
+        YoriLibIniFreeKey(Key);
+    }
+
+    if (Section->KeyHash != NULL) {
+        YoriLibFreeEmptyHashTable(Section->KeyHash);
+    }
+
+    if (Section->Hashed) {
+        YoriLibHashRemoveByEntry(&Section->HashEntry);
+    }
+    YoriLibRemoveListItem(&Section->ListEntry);
+    YoriLibFreeStringContents(&Section->Name);
+    YoriLibFree(Section);
+}
+
+/**
+ Free all of the sections in an INI file in memory.  Any changes that have
+ not been written with @ref YoriLibIniFlush are discarded.
+
+ @param Ini Pointer to the INI file to free.
+ */
+VOID
+YoriLibIniCleanup(
+    __inout PYORI_LIB_INI Ini
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PYORI_LIB_INI_SECTION Section;
+
+    ListEntry = YoriLibGetNextListEntry(&Ini->SectionList, NULL);
+    while (ListEntry != NULL) {
+        Section = CONTAINING_RECORD(ListEntry, YORI_LIB_INI_SECTION, ListEntry);
+        ListEntry = YoriLibGetNextListEntry(&Ini->SectionList, ListEntry);
+        YoriLibIniFreeSection(Section);
+    }
+
+    if (Ini->SectionHash != NULL) {
+        YoriLibFreeEmptyHashTable(Ini->SectionHash);
+        Ini->SectionHash = NULL;
+    }
+
+    YoriLibFreeStringContents(&Ini->FileName);
+    Ini->Dirty = FALSE;
+}
+
+/**
+ Add a new section to the end of an INI file in memory.
+
+ @param Ini Pointer to the INI file.
+
+ @param Name Pointer to the name of the section.  If NULL, the section has
+        no header, which is used for text preceding the first section.
+
+ @return Pointer to the new section, or NULL on allocation failure.
+ */
+PYORI_LIB_INI_SECTION
+YoriLibIniAddSection(
+    __in PYORI_LIB_INI Ini,
+    __in_opt PCYORI_STRING Name
+    )
+{
+    PYORI_LIB_INI_SECTION Section;
+
+    Section = YoriLibMalloc(sizeof(YORI_LIB_INI_SECTION));
+    if (Section == NULL) {
+        return NULL;
+    }
+
+    ZeroMemory(Section, sizeof(YORI_LIB_INI_SECTION));
+    YoriLibInitializeListHead(&Section->KeyList);
+    YoriLibInitEmptyString(&Section->Name);
+
+    Section->KeyHash = YoriLibAllocateHashTable(YORI_LIB_INI_KEY_BUCKETS);
+    if (Section->KeyHash == NULL) {
+        YoriLibFree(Section);
+        return NULL;
+    }
+
+    if (Name != NULL) {
+        if (!YoriLibCopyString(&Section->Name, Name)) {
+            YoriLibFreeEmptyHashTable(Section->KeyHash);
+            YoriLibFree(Section);
+            return NULL;
+        }
+        Section->HasHeader = TRUE;
+        if (YoriLibHashLookupByKey(Ini->SectionHash, &Section->Name) == NULL) {
+            YoriLibHashInsertByKey(Ini->SectionHash, &Section->Name, Section, &Section->HashEntry);
+            Section->Hashed = TRUE;
+        }
+    }
+
+    YoriLibAppendList(&Ini->SectionList, &Section->ListEntry);
+    return Section;
+}
+
+/**
+ Add a new line to the end of a section.
+
+ @param Section Pointer to the section.
+
+ @param Name Pointer to the name of the key, or for lines that are not
+        values, the text of the line.
+
+ @param Value Pointer to the value of the key.  If NULL, the line is not a
+        value.
+
+ @return Pointer to the new line, or NULL on allocation failure.
+ */
+PYORI_LIB_INI_KEY
+YoriLibIniAddKey(
+    __in PYORI_LIB_INI_SECTION Section,
+    __in PCYORI_STRING Name,
+    __in_opt PCYORI_STRING Value
+    )
+{
+    PYORI_LIB_INI_KEY Key;
+
+    Key = YoriLibMalloc(sizeof(YORI_LIB_INI_KEY));
+    if (Key == NULL) {
+        return NULL;
+    }
+
+    ZeroMemory(Key, sizeof(YORI_LIB_INI_KEY));
+    YoriLibInitEmptyString(&Key->Value);
+    if (!YoriLibCopyString(&Key->Name, Name)) {
+        YoriLibFree(Key);
+        return NULL;
+    }
+
+    if (Value != NULL) {
+        if (!YoriLibCopyString(&Key->Value, Value)) {
+            YoriLibFreeStringContents(&Key->Name);
+            YoriLibFree(Key);
+            return NULL;
+        }
+        Key->IsValue = TRUE;
+        if (YoriLibHashLookupByKey(Section->KeyHash, &Key->Name) == NULL) {
+            YoriLibHashInsertByKey(Section->KeyHash, &Key->Name, Key, &Key->HashEntry);
+            Key->Hashed = TRUE;
+        }
+    }
+
+    YoriLibAppendList(&Section->KeyList, &Key->ListEntry);
+    return Key;
+}
+
+/**
+ Find a section within an INI file in memory.
+
+ @param Ini Pointer to the INI file.
+
+ @param SectionName Pointer to the name of the section to find.
+
+ @return Pointer to the section, or NULL if it is not present.
+ */
+PYORI_LIB_INI_SECTION
+YoriLibIniFindSection(
+    __in PYORI_LIB_INI Ini,
+    __in LPCTSTR SectionName
+    )
+{
+    YORI_STRING Name;
+    PYORI_HASH_ENTRY HashEntry;
+
+    if (Ini->SectionHash == NULL) {
+        return NULL;
+    }
+
+    YoriLibConstantString(&Name, SectionName);
+    HashEntry = YoriLibHashLookupByKey(Ini->SectionHash, &Name);
+    if (HashEntry == NULL) {
+        return NULL;
+    }
+
+    return HashEntry->Context;
+}
+
+/**
+ Find a key within a section of an INI file in memory.
+
+ @param Ini Pointer to the INI file.
+
+ @param SectionName Pointer to the name of the section containing the key.
+
+ @param KeyName Pointer to the name of the key to find.
+
+ @return Pointer to the key, or NULL if it is not present.
+ */
+PYORI_LIB_INI_KEY
+YoriLibIniFindKey(
+    __in PYORI_LIB_INI Ini,
+    __in LPCTSTR SectionName,
+    __in LPCTSTR KeyName
+    )
+{
+    PYORI_LIB_INI_SECTION Section;
+    YORI_STRING Name;
+    PYORI_HASH_ENTRY HashEntry;
+
+    Section = YoriLibIniFindSection(Ini, SectionName);
+    if (Section == NULL) {
+        return NULL;
+    }
+
+    YoriLibConstantString(&Name, KeyName);
+    HashEntry = YoriLibHashLookupByKey(Section->KeyHash, &Name);
+    if (HashEntry == NULL) {
+        return NULL;
+    }
+
+    return HashEntry->Context;
+}
+
+/**
+ Parse the text of an INI file into sections and keys.
+
+ @param Ini Pointer to the INI file, which is expected to contain no
+        sections.
+
+ @param Text Pointer to the text of the INI file.
+
+ @return TRUE to indicate success, FALSE to indicate allocation failure.
+ */
+__success(return)
+BOOL
+YoriLibIniParse(
+    __in PYORI_LIB_INI Ini,
+    __in PCYORI_STRING Text
+    )
+{
+    YORI_STRING Line;
+    YORI_STRING Name;
+    YORI_STRING Value;
+    PYORI_LIB_INI_SECTION Section;
+    YORI_ALLOC_SIZE_T Index;
+    YORI_ALLOC_SIZE_T LineStart;
+    YORI_ALLOC_SIZE_T Equals;
+
+    Section = NULL;
+    LineStart = 0;
+    YoriLibInitEmptyString(&Line);
+
+    while (LineStart < Text->LengthInChars) {
+        for (Index = LineStart; Index < Text->LengthInChars; Index++) {
+            if (Text->StartOfString[Index] == '\n') {
+                break;
+            }
+        }
+
+        Line.StartOfString = &Text->StartOfString[LineStart];
+        Line.LengthInChars = Index - LineStart;
+        LineStart = Index + 1;
+
+        if (Line.LengthInChars > 0 && Line.StartOfString[Line.LengthInChars - 1] == '\r') {
+            Line.LengthInChars--;
+        }
+
+        YoriLibInitEmptyString(&Name);
+        Name.StartOfString = Line.StartOfString;
+        Name.LengthInChars = Line.LengthInChars;
+        YoriLibTrimSpaces(&Name);
+
+        //
+        //  A section header starts a new section.  Anything following the
+        //  closing bracket is ignored.
+        //
+
+        if (Name.LengthInChars > 0 && Name.StartOfString[0] == '[') {
+            Name.StartOfString++;
+            Name.LengthInChars--;
+            for (Index = 0; Index < Name.LengthInChars; Index++) {
+                if (Name.StartOfString[Index] == ']') {
+                    break;
+                }
+            }
+            Name.LengthInChars = Index;
+            YoriLibTrimSpaces(&Name);
+            Section = YoriLibIniAddSection(Ini, &Name);
+            if (Section == NULL) {
+                return FALSE;
+            }
+            continue;
+        }
+
+        if (Section == NULL) {
+            Section = YoriLibIniAddSection(Ini, NULL);
+            if (Section == NULL) {
+                return FALSE;
+            }
+        }
+
+        //
+        //  A line with an equals sign within a section is a value, unless
+        //  it's a comment.  Anything else is retained as text.
+        //
+
+        Equals = Name.LengthInChars;
+        if (Section->HasHeader && Name.LengthInChars > 0 && Name.StartOfString[0] != ';') {
+            for (Equals = 0; Equals < Name.LengthInChars; Equals++) {
+                if (Name.StartOfString[Equals] == '=') {
+                    break;
+                }
+            }
+        }
+
+        if (Equals < Name.LengthInChars) {
+            YoriLibInitEmptyString(&Value);
+            Value.StartOfString = &Name.StartOfString[Equals + 1];
+            Value.LengthInChars = Name.LengthInChars - Equals - 1;
+            YoriLibTrimSpaces(&Value);
+            Name.LengthInChars = Equals;
+            YoriLibTrimSpaces(&Name);
+            if (YoriLibIniAddKey(Section, &Name, &Value) == NULL) {
+                return FALSE;
+            }
+        } else {
+            if (YoriLibIniAddKey(Section, &Line, NULL) == NULL) {
+                return FALSE;
+            }
+        }
+    }
+
+    return TRUE;
+}
+
+/**
+ Load an INI file into memory.  If the file does not exist, the INI file is
+ empty, and will be created when changes are written to it.  The caller
+ should free the INI file with @ref YoriLibIniCleanup .
+
+ @param Ini Pointer to the INI file to load.  This is initialized by this
+        routine.
+
+ @param FileName Pointer to the name of the INI file.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriLibIniLoad(
+    __out PYORI_LIB_INI Ini,
+    __in PCYORI_STRING FileName
+    )
+{
+    HANDLE FileHandle;
+    DWORD FileSize;
+    DWORD BytesRead;
+    DWORD Err;
+    PUCHAR Buffer;
+    YORI_STRING Text;
+    BOOL Result;
+    DWORD Encoding;
+    DWORD Offset;
+
+    YoriLibIniInitialize(Ini);
+
+    Ini->SectionHash = YoriLibAllocateHashTable(YORI_LIB_INI_SECTION_BUCKETS);
+    if (Ini->SectionHash == NULL) {
+        return FALSE;
+    }
+
+    if (!YoriLibCopyString(&Ini->FileName, FileName)) {
+        YoriLibIniCleanup(Ini);
+        return FALSE;
+    }
+
+    FileHandle = CreateFile(Ini->FileName.StartOfString,
+                            GENERIC_READ,
+                            FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                            NULL,
+                            OPEN_EXISTING,
+                            FILE_ATTRIBUTE_NORMAL,
+                            NULL);
+
+    if (FileHandle == INVALID_HANDLE_VALUE) {
+        Err = GetLastError();
+        if (Err == ERROR_FILE_NOT_FOUND || Err == ERROR_PATH_NOT_FOUND) {
+            return TRUE;
+        }
+        YoriLibIniCleanup(Ini);
+        return FALSE;
+    }
+
+    FileSize = GetFileSize(FileHandle, NULL);
+    if (FileSize == INVALID_FILE_SIZE || !YoriLibIsSizeAllocatable(FileSize)) {
+        CloseHandle(FileHandle);
+        YoriLibIniCleanup(Ini);
+        return FALSE;
+    }
+
+    if (FileSize == 0) {
+        CloseHandle(FileHandle);
+        return TRUE;
+    }
+
+    Buffer = YoriLibMalloc((YORI_ALLOC_SIZE_T)FileSize);
+    if (Buffer == NULL) {
+        CloseHandle(FileHandle);
+        YoriLibIniCleanup(Ini);
+        return FALSE;
+    }
+
+    if (!ReadFile(FileHandle, Buffer, FileSize, &BytesRead, NULL) ||
+        BytesRead != FileSize) {
+
+        YoriLibFree(Buffer);
+        CloseHandle(FileHandle);
+        YoriLibIniCleanup(Ini);
+        return FALSE;
+    }
+
+    CloseHandle(FileHandle);
+    YoriLibInitEmptyString(&Text);
+
+    //
+    //  The profile APIs treat a file starting with a UTF-16 byte order mark
+    //  as Unicode, and anything else as being in the ANSI code page.
+    //
+
+    if (FileSize >= 2 && Buffer[0] == 0xFF && Buffer[1] == 0xFE) {
+        Ini->Unicode = TRUE;
+        if (!YoriLibAllocateString(&Text, (YORI_ALLOC_SIZE_T)(FileSize / sizeof(TCHAR)))) {
+            YoriLibFree(Buffer);
+            YoriLibIniCleanup(Ini);
+            return FALSE;
+        }
+        Text.LengthInChars = (YORI_ALLOC_SIZE_T)((FileSize - 2) / sizeof(TCHAR));
+        memcpy(Text.StartOfString, &Buffer[2], Text.LengthInChars * sizeof(TCHAR));
+    } else {
+        Encoding = CP_ACP;
+        Offset = 0;
+        if (FileSize >= 3 && Buffer[0] == 0xEF && Buffer[1] == 0xBB && Buffer[2] == 0xBF) {
+            Encoding = CP_UTF8;
+            Offset = 3;
+        }
+
+        if (FileSize > Offset) {
+            if (!YoriLibAllocateString(&Text, (YORI_ALLOC_SIZE_T)(FileSize - Offset))) {
+                YoriLibFree(Buffer);
+                YoriLibIniCleanup(Ini);
+                return FALSE;
+            }
+            Text.LengthInChars = (YORI_ALLOC_SIZE_T)
+                MultiByteToWideChar(Encoding,
+                                    0,
+                                    (LPCSTR)&Buffer[Offset],
+                                    (INT)(FileSize - Offset),
+                                    Text.StartOfString,
+                                    (INT)Text.LengthAllocated);
+        }
+    }
+
+    YoriLibFree(Buffer);
+
+    Result = YoriLibIniParse(Ini, &Text);
+    YoriLibFreeStringContents(&Text);
+    if (!Result) {
+        YoriLibIniCleanup(Ini);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ Copy a string into a caller supplied buffer with the conventions of
+ GetPrivateProfileString, so the string is truncated if the buffer is too
+ small and the buffer is always NULL terminated.
+
+ @param Source Pointer to the string to copy.
+
+ @param Buffer Pointer to the buffer to copy into.
+
+ @param BufferLength The length of Buffer, in characters.
+
+ @return The number of characters copied, not including the NULL
+         terminator.
+ */
+DWORD
+YoriLibIniCopyToBuffer(
+    __in PCYORI_STRING Source,
+    __out_ecount(BufferLength) LPTSTR Buffer,
+    __in DWORD BufferLength
+    )
+{
+    DWORD Length;
+
+    if (BufferLength == 0) {
+        return 0;
+    }
+
+    Length = Source->LengthInChars;
+    if (Length > BufferLength - 1) {
+        Length = BufferLength - 1;
+    }
+
+    memcpy(Buffer, Source->StartOfString, Length * sizeof(TCHAR));
+    Buffer[Length] = '\0';
+    return Length;
+}
+
+/**
+ Query a value from an INI file in memory.  This follows the conventions of
+ GetPrivateProfileString.
+
+ @param Ini Pointer to the INI file.
+
+ @param SectionName Pointer to the name of the section containing the value.
+
+ @param KeyName Pointer to the name of the value.
+
+ @param Default Optionally points to a string to return if the value is not
+        present.  If NULL, an empty string is returned.
+
+ @param Buffer Pointer to a buffer to receive the value.
+
+ @param BufferLength The length of Buffer, in characters.
+
+ @return The number of characters copied into Buffer, not including the
+         NULL terminator.
+ */
+DWORD
+YoriLibIniGetString(
+    __in PYORI_LIB_INI Ini,
+    __in LPCTSTR SectionName,
+    __in LPCTSTR KeyName,
+    __in_opt LPCTSTR Default,
+    __out_ecount(BufferLength) LPTSTR Buffer,
+    __in DWORD BufferLength
+    )
+{
+    PYORI_LIB_INI_KEY Key;
+    YORI_STRING Value;
+
+    Key = YoriLibIniFindKey(Ini, SectionName, KeyName);
+    if (Key == NULL) {
+        if (Default == NULL) {
+            Default = _T("");
+        }
+        YoriLibConstantString(&Value, Default);
+        return YoriLibIniCopyToBuffer(&Value, Buffer, BufferLength);
+    }
+
+    //
+    //  If the value is enclosed in matching quotes, the quotes are removed.
+    //
+
+    YoriLibInitEmptyString(&Value);
+    Value.StartOfString = Key->Value.StartOfString;
+    Value.LengthInChars = Key->Value.LengthInChars;
+    if (Value.LengthInChars >= 2 &&
+        (Value.StartOfString[0] == '"' || Value.StartOfString[0] == '\'') &&
+        Value.StartOfString[Value.LengthInChars - 1] == Value.StartOfString[0]) {
+
+        Value.StartOfString++;
+        Value.LengthInChars = Value.LengthInChars - 2;
+    }
+
+    return YoriLibIniCopyToBuffer(&Value, Buffer, BufferLength);
+}
+
+/**
+ Query a numeric value from an INI file in memory.  This follows the
+ conventions of GetPrivateProfileInt.
+
+ @param Ini Pointer to the INI file.
+
+ @param SectionName Pointer to the name of the section containing the value.
+
+ @param KeyName Pointer to the name of the value.
+
+ @param Default The value to return if the value is not present.
+
+ @return The numeric value.
+ */
+UINT
+YoriLibIniGetInt(
+    __in PYORI_LIB_INI Ini,
+    __in LPCTSTR SectionName,
+    __in LPCTSTR KeyName,
+    __in INT Default
+    )
+{
+    PYORI_LIB_INI_KEY Key;
+    YORI_MAX_SIGNED_T Number;
+    YORI_ALLOC_SIZE_T CharsConsumed;
+
+    Key = YoriLibIniFindKey(Ini, SectionName, KeyName);
+    if (Key == NULL) {
+        return (UINT)Default;
+    }
+
+    if (!YoriLibStringToNumber(&Key->Value, FALSE, &Number, &CharsConsumed) ||
+        CharsConsumed == 0) {
+
+        return 0;
+    }
+
+    return (UINT)Number;
+}
+
+/**
+ Query all of the values within a section of an INI file in memory.  This
+ follows the conventions of GetPrivateProfileSection, so each value is
+ returned as a NULL terminated Key=Value string, and the final string is
+ followed by an additional NULL terminator.
+
+ @param Ini Pointer to the INI file.
+
+ @param SectionName Pointer to the name of the section.
+
+ @param Buffer Pointer to a buffer to receive the values.
+
+ @param BufferLength The length of Buffer, in characters.
+
+ @return The number of characters copied into Buffer, not including the
+         final NULL terminator.  If the buffer is too small, this is
+         BufferLength - 2.
+ */
+DWORD
+YoriLibIniGetSection(
+    __in PYORI_LIB_INI Ini,
+    __in LPCTSTR SectionName,
+    __out_ecount(BufferLength) LPTSTR Buffer,
+    __in DWORD BufferLength
+    )
+{
+    PYORI_LIB_INI_SECTION Section;
+    PYORI_LIB_INI_KEY Key;
+    PYORI_LIST_ENTRY ListEntry;
+    DWORD Offset;
+    DWORD LengthNeeded;
+
+    if (BufferLength < 2) {
+        if (BufferLength > 0) {
+            Buffer[0] = '\0';
+        }
+        return 0;
+    }
+
+    Offset = 0;
+    Section = YoriLibIniFindSection(Ini, SectionName);
+    if (Section != NULL) {
+        ListEntry = YoriLibGetNextListEntry(&Section->KeyList, NULL);
+        while (ListEntry != NULL) {
+            Key = CONTAINING_RECORD(ListEntry, YORI_LIB_INI_KEY, ListEntry);
+            ListEntry = YoriLibGetNextListEntry(&Section->KeyList, ListEntry);
+            if (!Key->IsValue) {
+                continue;
+            }
+
+            LengthNeeded = Key->Name.LengthInChars + 1 + Key->Value.LengthInChars + 1;
+            if (Offset + LengthNeeded + 1 > BufferLength) {
+                Buffer[BufferLength - 2] = '\0';
+                Buffer[BufferLength - 1] = '\0';
+                return BufferLength - 2;
+            }
+
+            memcpy(&Buffer[Offset], Key->Name.StartOfString, Key->Name.LengthInChars * sizeof(TCHAR));
+            Offset = Offset + Key->Name.LengthInChars;
+            Buffer[Offset] = '=';
+            Offset++;
+            memcpy(&Buffer[Offset], Key->Value.StartOfString, Key->Value.LengthInChars * sizeof(TCHAR));
+            Offset = Offset + Key->Value.LengthInChars;
+            Buffer[Offset] = '\0';
+            Offset++;
+        }
+    }
+
+    Buffer[Offset] = '\0';
+    if (Offset == 0) {
+        Buffer[1] = '\0';
+    }
+    return Offset;
+}
+
+/**
+ Change a value within an INI file in memory.  This follows the conventions
+ of WritePrivateProfileString.  The change is not written to disk until
+ @ref YoriLibIniFlush is called.
+
+ @param Ini Pointer to the INI file.
+
+ @param SectionName Pointer to the name of the section containing the value.
+        The section is created if it does not exist.
+
+ @param KeyName Optionally points to the name of the value.  If NULL, the
+        entire section is deleted.
+
+ @param Value Optionally points to the new value.  If NULL, the value is
+        deleted.
+
+ @return TRUE to indicate success, FALSE to indicate allocation failure.
+ */
+__success(return)
+BOOL
+YoriLibIniSetString(
+    __in PYORI_LIB_INI Ini,
+    __in LPCTSTR SectionName,
+    __in_opt LPCTSTR KeyName,
+    __in_opt LPCTSTR Value
+    )
+{
+    PYORI_LIB_INI_SECTION Section;
+    PYORI_LIB_INI_KEY Key;
+    YORI_STRING Name;
+    YORI_STRING NewValue;
+    PYORI_HASH_ENTRY HashEntry;
+
+    if (Ini->SectionHash == NULL) {
+        return FALSE;
+    }
+
+    Section = YoriLibIniFindSection(Ini, SectionName);
+    if (KeyName == NULL) {
+        if (Section != NULL) {
+            YoriLibIniFreeSection(Section);
+            Ini->Dirty = TRUE;
+        }
+        return TRUE;
+    }
+
+    YoriLibConstantString(&Name, KeyName);
+    Key = NULL;
+    if (Section != NULL) {
+        HashEntry = YoriLibHashLookupByKey(Section->KeyHash, &Name);
+        if (HashEntry != NULL) {
+            Key = HashEntry->Context;
+        }
+    }
+
+    if (Value == NULL) {
+        if (Key != NULL) {
+            YoriLibIniFreeKey(Key);
+            Ini->Dirty = TRUE;
+        }
+        return TRUE;
+    }
+
+    YoriLibConstantString(&NewValue, Value);
+
+    if (Key != NULL) {
+        if (YoriLibCompareString(&Key->Value, &NewValue) == 0) {
+            return TRUE;
+        }
+
+        if (Key->Value.LengthAllocated <= NewValue.LengthInChars) {
+            YoriLibFreeStringContents(&Key->Value);
+            if (!YoriLibCopyString(&Key->Value, &NewValue)) {
+                YoriLibIniFreeKey(Key);
+                Ini->Dirty = TRUE;
+                return FALSE;
+            }
+        } else {
+            memcpy(Key->Value.StartOfString, NewValue.StartOfString, NewValue.LengthInChars * sizeof(TCHAR));
+            Key->Value.LengthInChars = NewValue.LengthInChars;
+            Key->Value.StartOfString[Key->Value.LengthInChars] = '\0';
+        }
+        Ini->Dirty = TRUE;
+        return TRUE;
+    }
+
+    if (Section == NULL) {
+        YoriLibConstantString(&Name, SectionName);
+        Section = YoriLibIniAddSection(Ini, &Name);
+        if (Section == NULL) {
+            return FALSE;
+        }
+        YoriLibConstantString(&Name, KeyName);
+    }
+
+    if (YoriLibIniAddKey(Section, &Name, &NewValue) == NULL) {
+        return FALSE;
+    }
+
+    Ini->Dirty = TRUE;
+    return TRUE;
+}
+
+/**
+ Append a string to the text of an INI file being generated, reallocating
+ the buffer as needed.
+
+ @param Text Pointer to the text being generated.
+
+ @param String Pointer to the string to append.
+
+ @return TRUE to indicate success, FALSE to indicate allocation failure.
+ */
+__success(return)
+BOOL
+YoriLibIniAppendText(
+    __inout PYORI_STRING Text,
+    __in PCYORI_STRING String
+    )
+{
+    YORI_ALLOC_SIZE_T LengthNeeded;
+
+    LengthNeeded = Text->LengthInChars + String->LengthInChars + 1;
+    if (LengthNeeded > Text->LengthAllocated) {
+        if (!YoriLibIsSizeAllocatable(LengthNeeded * 2)) {
+            return FALSE;
+        }
+        if (!YoriLibReallocString(Text, LengthNeeded * 2)) {
+            return FALSE;
+        }
+    }
+
+    memcpy(&Text->StartOfString[Text->LengthInChars], String->StartOfString, String->LengthInChars * sizeof(TCHAR));
+    Text->LengthInChars = Text->LengthInChars + String->LengthInChars;
+    return TRUE;
+}
+
+/**
+ Generate the text of an INI file from its sections and keys.
+
+ @param Ini Pointer to the INI file.
+
+ @param Text On successful completion, populated with the text of the INI
+        file.  The caller should free this with
+        @ref YoriLibFreeStringContents .
+
+ @return TRUE to indicate success, FALSE to indicate allocation failure.
+ */
+__success(return)
+BOOL
+YoriLibIniGenerateText(
+    __in PYORI_LIB_INI Ini,
+    __out PYORI_STRING Text
+    )
+{
+    PYORI_LIST_ENTRY SectionEntry;
+    PYORI_LIST_ENTRY KeyEntry;
+    PYORI_LIB_INI_SECTION Section;
+    PYORI_LIB_INI_KEY Key;
+    YORI_STRING OpenBracket;
+    YORI_STRING CloseBracket;
+    YORI_STRING Equals;
+    YORI_STRING Newline;
+
+    YoriLibConstantString(&OpenBracket, _T("["));
+    YoriLibConstantString(&CloseBracket, _T("]\r\n"));
+    YoriLibConstantString(&Equals, _T("="));
+    YoriLibConstantString(&Newline, _T("\r\n"));
+
+    if (!YoriLibAllocateString(Text, 4096)) {
+        return FALSE;
+    }
+
+    SectionEntry = YoriLibGetNextListEntry(&Ini->SectionList, NULL);
+    while (SectionEntry != NULL) {
+        Section = CONTAINING_RECORD(SectionEntry, YORI_LIB_INI_SECTION, ListEntry);
+        SectionEntry = YoriLibGetNextListEntry(&Ini->SectionList, SectionEntry);
+
+        if (Section->HasHeader) {
+            if (!YoriLibIniAppendText(Text, &OpenBracket) ||
+                !YoriLibIniAppendText(Text, &Section->Name) ||
+                !YoriLibIniAppendText(Text, &CloseBracket)) {
+
+                YoriLibFreeStringContents(Text);
+                return FALSE;
+            }
+        }
+
+        KeyEntry = YoriLibGetNextListEntry(&Section->KeyList, NULL);
+        while (KeyEntry != NULL) {
+            Key = CONTAINING_RECORD(KeyEntry, YORI_LIB_INI_KEY, ListEntry);
+            KeyEntry = YoriLibGetNextListEntry(&Section->KeyList, KeyEntry);
+
+            if (!YoriLibIniAppendText(Text, &Key->Name)) {
+                YoriLibFreeStringContents(Text);
+                return FALSE;
+            }
+
+            if (Key->IsValue) {
+                if (!YoriLibIniAppendText(Text, &Equals) ||
+                    !YoriLibIniAppendText(Text, &Key->Value)) {
+
+                    YoriLibFreeStringContents(Text);
+                    return FALSE;
+                }
+            }
+
+            if (!YoriLibIniAppendText(Text, &Newline)) {
+                YoriLibFreeStringContents(Text);
+                return FALSE;
+            }
+        }
+    }
+
+    return TRUE;
+}
+
+/**
+ Write any changes to an INI file in memory back to disk.  The new contents
+ are written to a temporary file which then replaces the INI file, so a
+ reader never observes a partially written file.
+
+ @param Ini Pointer to the INI file.
+
+ @return TRUE to indicate success, FALSE to indicate failure.  On failure,
+         the reason is available from GetLastError.
+ */
+__success(return)
+BOOL
+YoriLibIniFlush(
+    __in PYORI_LIB_INI Ini
+    )
+{
+    YORI_STRING Text;
+    YORI_STRING TempFileName;
+    HANDLE FileHandle;
+    PUCHAR Buffer;
+    DWORD BufferLength;
+    DWORD BytesWritten;
+    DWORD Err;
+
+    if (!Ini->Dirty) {
+        return TRUE;
+    }
+
+    YoriLibInitEmptyString(&Text);
+    YoriLibInitEmptyString(&TempFileName);
+    FileHandle = INVALID_HANDLE_VALUE;
+    Buffer = NULL;
+    Err = ERROR_SUCCESS;
+
+    if (!YoriLibIniGenerateText(Ini, &Text)) {
+        Err = ERROR_NOT_ENOUGH_MEMORY;
+        goto Exit;
+    }
+
+    //
+    //  Convert the text into the encoding of the file.  Unicode files start
+    //  with a byte order mark.
+    //
+
+    if (Ini->Unicode) {
+        BufferLength = (Text.LengthInChars + 1) * sizeof(TCHAR);
+    } else {
+        BufferLength = (DWORD)WideCharToMultiByte(CP_ACP, 0, Text.StartOfString, (INT)Text.LengthInChars, NULL, 0, NULL, NULL);
+        if (BufferLength == 0 && Text.LengthInChars > 0) {
+            Err = GetLastError();
+            goto Exit;
+        }
+    }
+
+    if (BufferLength > 0) {
+        if (!YoriLibIsSizeAllocatable(BufferLength)) {
+            Err = ERROR_NOT_ENOUGH_MEMORY;
+            goto Exit;
+        }
+        Buffer = YoriLibMalloc((YORI_ALLOC_SIZE_T)BufferLength);
+        if (Buffer == NULL) {
+            Err = ERROR_NOT_ENOUGH_MEMORY;
+            goto Exit;
+        }
+
+        if (Ini->Unicode) {
+            Buffer[0] = 0xFF;
+            Buffer[1] = 0xFE;
+            memcpy(&Buffer[2], Text.StartOfString, Text.LengthInChars * sizeof(TCHAR));
+        } else {
+            WideCharToMultiByte(CP_ACP, 0, Text.StartOfString, (INT)Text.LengthInChars, (LPSTR)Buffer, (INT)BufferLength, NULL, NULL);
+        }
+    }
+
+    YoriLibYPrintf(&TempFileName, _T("%y.new"), &Ini->FileName);
+    if (TempFileName.LengthInChars == 0) {
+        Err = ERROR_NOT_ENOUGH_MEMORY;
+        goto Exit;
+    }
+
+    FileHandle = CreateFile(TempFileName.StartOfString,
+                            GENERIC_WRITE,
+                            0,
+                            NULL,
+                            CREATE_ALWAYS,
+                            FILE_ATTRIBUTE_NORMAL,
+                            NULL);
+
+    if (FileHandle == INVALID_HANDLE_VALUE) {
+        Err = GetLastError();
+        goto Exit;
+    }
+
+    if (BufferLength > 0) {
+        if (!WriteFile(FileHandle, Buffer, BufferLength, &BytesWritten, NULL)) {
+            Err = GetLastError();
+            goto Exit;
+        }
+        if (BytesWritten != BufferLength) {
+            Err = ERROR_WRITE_FAULT;
+            goto Exit;
+        }
+    }
+
+    if (!FlushFileBuffers(FileHandle)) {
+        Err = GetLastError();
+        goto Exit;
+    }
+
+    CloseHandle(FileHandle);
+    FileHandle = INVALID_HANDLE_VALUE;
+
+    //
+    //  Replace the INI file with the new contents.  Systems without
+    //  MoveFileEx need the existing file to be deleted first.
+    //
+
+    if (!MoveFileEx(TempFileName.StartOfString, Ini->FileName.StartOfString, MOVEFILE_REPLACE_EXISTING)) {
+        Err = GetLastError();
+        if (Err == ERROR_CALL_NOT_IMPLEMENTED) {
+            DeleteFile(Ini->FileName.StartOfString);
+            if (MoveFile(TempFileName.StartOfString, Ini->FileName.StartOfString)) {
+                Err = ERROR_SUCCESS;
+            } else {
+
+                //
+                //  The original file is gone, so leave the new contents in
+                //  the temporary file rather than losing both.
+                //
+
+                Err = GetLastError();
+                TempFileName.LengthInChars = 0;
+            }
+        }
+    }
+
+    if (Err == ERROR_SUCCESS) {
+        Ini->Dirty = FALSE;
+    }
+
+Exit:
+
+    if (FileHandle != INVALID_HANDLE_VALUE) {
+        CloseHandle(FileHandle);
+    }
+
+    if (Err != ERROR_SUCCESS && TempFileName.LengthInChars > 0) {
+        DeleteFile(TempFileName.StartOfString);
+    }
+
+    if (Buffer != NULL) {
+        YoriLibFree(Buffer);
+    }
+
+    YoriLibFreeStringContents(&TempFileName);
+    YoriLibFreeStringContents(&Text);
+
+    if (Err != ERROR_SUCCESS) {
+        SetLastError(Err);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+// vim:sw=4:ts=4:et:
@@ -83,4 +83,370 @@ YoriLibLimitJobObjectPriority(
     return DllKernel32.pSetInformationJobObject(hJob, 2, &LimitInfo, sizeof(LimitInfo));
 }
 
+/**
+ Indicate that all processes in a job object should be terminated when the
+ last handle to the job object is closed.  If this functionality is not
+ supported by the host OS, returns FALSE.
+
+ @param hJob Handle to the job object.
+
+ @return TRUE on success, FALSE on failure.
+ */
+BOOL
+YoriLibLimitJobObjectKillOnClose(
+    __in HANDLE hJob
+    )
+{
+    YORI_JOB_EXTENDED_LIMIT_INFORMATION LimitInfo;
+    if (DllKernel32.pSetInformationJobObject == NULL) {
+        return FALSE;
+    }
+    ZeroMemory(&LimitInfo, sizeof(LimitInfo));
+    LimitInfo.BasicLimitInformation.Flags = 0x2000;
+    return DllKernel32.pSetInformationJobObject(hJob, 9, &LimitInfo, sizeof(LimitInfo));
+}
+
+/**
+ Query the resources consumed by all processes within a job object.  If this
+ functionality is not supported by the host OS, returns FALSE.
+
+ @param hJob Handle to the job object.
+
+ @param Accounting On successful completion, populated with the resources
+        consumed by processes within the job.
+
+ @return TRUE on success, FALSE on failure.
+ */
+__success(return)
+BOOL
+YoriLibQueryJobObjectAccounting(
+    __in HANDLE hJob,
+    __out PYORI_LIB_JOB_ACCOUNTING Accounting
+    )
+{
+    YORI_JOB_BASIC_ACCOUNTING_INFORMATION BasicInfo;
+    YORI_JOB_EXTENDED_LIMIT_INFORMATION LimitInfo;
+    DWORD BytesReturned;
+
+    if (DllKernel32.pQueryInformationJobObject == NULL) {
+        return FALSE;
+    }
+
+    if (!DllKernel32.pQueryInformationJobObject(hJob, 1, &BasicInfo, sizeof(BasicInfo), &BytesReturned)) {
+        return FALSE;
+    }
+
+    ZeroMemory(Accounting, sizeof(YORI_LIB_JOB_ACCOUNTING));
+    Accounting->TotalUserTime.QuadPart = BasicInfo.TotalUserTime.QuadPart;
+    Accounting->TotalKernelTime.QuadPart = BasicInfo.TotalKernelTime.QuadPart;
+    Accounting->TotalPageFaultCount = BasicInfo.TotalPageFaultCount;
+    Accounting->TotalProcesses = BasicInfo.TotalProcesses;
+    Accounting->ActiveProcesses = BasicInfo.ActiveProcesses;
+
+    //
+    //  IO and memory counters are only available from the extended limit
+    //  information.  If this fails, return the basic information alone.
+    //
+
+    if (DllKernel32.pQueryInformationJobObject(hJob, 9, &LimitInfo, sizeof(LimitInfo), &BytesReturned)) {
+        memcpy(&Accounting->IoCounters, &LimitInfo.IoInfo, sizeof(YORI_IO_COUNTERS));
+        Accounting->PeakProcessCommit = LimitInfo.PeakProcessMemoryUsed;
+        Accounting->PeakJobCommit = LimitInfo.PeakJobMemoryUsed;
+    }
+
+    return TRUE;
+}
+
+/**
+ Limit the processor time that all processes in a job object can consume.
+ If this functionality is not supported by the host OS, returns FALSE.
+
+ @param hJob Handle to the job object.
+
+ @param CpuRate The percentage of total processor time that processes in
+        the job can consume, between 1 and 100.
+
+ @return TRUE on success, FALSE on failure.
+ */
+BOOL
+YoriLibLimitJobObjectCpuRate(
+    __in HANDLE hJob,
+    __in DWORD CpuRate
+    )
+{
+    YORI_JOB_CPU_RATE_CONTROL_INFORMATION RateInfo;
+    if (DllKernel32.pSetInformationJobObject == NULL) {
+        return FALSE;
+    }
+    ZeroMemory(&RateInfo, sizeof(RateInfo));
+    RateInfo.ControlFlags = JOB_OBJECT_CPU_RATE_CONTROL_ENABLE | JOB_OBJECT_CPU_RATE_CONTROL_HARD_CAP;
+    RateInfo.CpuRate = CpuRate * 100;
+    return DllKernel32.pSetInformationJobObject(hJob, 15, &RateInfo, sizeof(RateInfo));
+}
+
+/**
+ Create a completion port which receives notifications about processes in
+ a job object, including when processes are added to the job and when they
+ exit.  If this functionality is not supported by the host OS, returns NULL.
+
+ @param hJob Handle to the job object.
+
+ @return Handle to the completion port, or NULL on failure.  The caller
+         should close this handle with CloseHandle.
+ */
+HANDLE
+YoriLibCreateJobObjectCompletionPort(
+    __in HANDLE hJob
+    )
+{
+    YORI_JOB_ASSOCIATE_COMPLETION_PORT AssociateInfo;
+    HANDLE hPort;
+
+    if (DllKernel32.pCreateIoCompletionPort == NULL ||
+        DllKernel32.pSetInformationJobObject == NULL) {
+
+        return NULL;
+    }
+
+    hPort = DllKernel32.pCreateIoCompletionPort(INVALID_HANDLE_VALUE, NULL, 0, 1);
+    if (hPort == NULL) {
+        return NULL;
+    }
+
+    AssociateInfo.Key = hJob;
+    AssociateInfo.Port = hPort;
+    if (!DllKernel32.pSetInformationJobObject(hJob, 7, &AssociateInfo, sizeof(AssociateInfo))) {
+        CloseHandle(hPort);
+        return NULL;
+    }
+
+    return hPort;
+}
+
+/**
+ Set the priority of I/O issued by a process.  Processes created by the
+ process inherit this priority.  If this functionality is not supported by
+ the host OS, returns FALSE.
+
+ @param hProcess Handle to the process.
+
+ @param IoPriority The new I/O priority, for example
+        YORI_LIB_IO_PRIORITY_LOW.
+
+ @return TRUE on success, FALSE on failure.
+ */
+BOOL
+YoriLibSetProcessIoPriority(
+    __in HANDLE hProcess,
+    __in DWORD IoPriority
+    )
+{
+    ULONG Priority;
+    LONG NtStatus;
+
+    if (DllNtDll.pNtSetInformationProcess == NULL) {
+        return FALSE;
+    }
+
+    Priority = IoPriority;
+    NtStatus = DllNtDll.pNtSetInformationProcess(hProcess, 33, &Priority, sizeof(Priority));
+    if (NtStatus < 0) {
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/**
+ Set the priority of memory used by a process, which determines how quickly
+ its pages are removed from memory when the system needs memory.  Processes
+ created by the process inherit this priority.  If this functionality is not
+ supported by the host OS, returns FALSE.
+
+ @param hProcess Handle to the process.
+
+ @param MemoryPriority The new memory priority, for example
+        YORI_LIB_MEMORY_PRIORITY_LOW.
+
+ @return TRUE on success, FALSE on failure.
+ */
+BOOL
+YoriLibSetProcessMemoryPriority(
+    __in HANDLE hProcess,
+    __in DWORD MemoryPriority
+    )
+{
+    ULONG Priority;
+    LONG NtStatus;
+
+    if (DllNtDll.pNtSetInformationProcess == NULL) {
+        return FALSE;
+    }
+
+    Priority = MemoryPriority;
+    NtStatus = DllNtDll.pNtSetInformationProcess(hProcess, 39, &Priority, sizeof(Priority));
+    if (NtStatus < 0) {
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/**
+ Initialize a set of process limits to indicate that nothing should be
+ limited.
+
+ @param Limits Pointer to the limits to initialize.
+ */
+VOID
+YoriLibInitializeProcessLimits(
+    __out PYORI_LIB_PROCESS_LIMITS Limits
+    )
+{
+    Limits->PriorityClass = 0;
+    Limits->CpuRate = 0;
+    Limits->IoPriority = YORI_LIB_PRIORITY_UNCHANGED;
+    Limits->MemoryPriority = YORI_LIB_PRIORITY_UNCHANGED;
+}
+
+/**
+ Parse a command line argument which specifies a limit to apply to a child
+ process.  The supported arguments are "cpu n", "io low", "io verylow",
+ "mem low" and "mem verylow".
+
+ @param Arg Pointer to the argument, without any leading option character.
+
+ @param ArgC The number of arguments.
+
+ @param ArgV An array of arguments.
+
+ @param Index The index of the argument within ArgV.  The argument following
+        it specifies the value of the limit.
+
+ @param Limits Pointer to the limits to update.
+
+ @param ArgsConsumed On successful completion, updated to indicate the
+        number of arguments following Index which were consumed.
+
+ @return TRUE to indicate the argument specified a limit, FALSE if it did
+         not.
+ */
+__success(return)
+BOOLEAN
+YoriLibParseProcessLimitArgument(
+    __in PYORI_STRING Arg,
+    __in YORI_ALLOC_SIZE_T ArgC,
+    __in YORI_STRING ArgV[],
+    __in YORI_ALLOC_SIZE_T Index,
+    __inout PYORI_LIB_PROCESS_LIMITS Limits,
+    __out PYORI_ALLOC_SIZE_T ArgsConsumed
+    )
+{
+    PYORI_STRING Value;
+    YORI_MAX_SIGNED_T Number;
+    YORI_ALLOC_SIZE_T CharsConsumed;
+
+    if (Index + 1 >= ArgC) {
+        return FALSE;
+    }
+
+    Value = &ArgV[Index + 1];
+    if (YoriLibCompareStringLitIns(Arg, _T("cpu")) == 0) {
+        if (YoriLibStringToNumber(Value, TRUE, &Number, &CharsConsumed) &&
+            CharsConsumed > 0 &&
+            Number > 0 &&
+            Number <= 100) {
+
+            Limits->CpuRate = (DWORD)Number;
+            *ArgsConsumed = 1;
+            return TRUE;
+        }
+    } else if (YoriLibCompareStringLitIns(Arg, _T("io")) == 0) {
+        if (YoriLibCompareStringLitIns(Value, _T("low")) == 0) {
+            Limits->IoPriority = YORI_LIB_IO_PRIORITY_LOW;
+            *ArgsConsumed = 1;
+            return TRUE;
+        } else if (YoriLibCompareStringLitIns(Value, _T("verylow")) == 0) {
+            Limits->IoPriority = YORI_LIB_IO_PRIORITY_VERY_LOW;
+            *ArgsConsumed = 1;
+            return TRUE;
+        }
+    } else if (YoriLibCompareStringLitIns(Arg, _T("mem")) == 0) {
+        if (YoriLibCompareStringLitIns(Value, _T("low")) == 0) {
+            Limits->MemoryPriority = YORI_LIB_MEMORY_PRIORITY_LOW;
+            *ArgsConsumed = 1;
+            return TRUE;
+        } else if (YoriLibCompareStringLitIns(Value, _T("verylow")) == 0) {
+            Limits->MemoryPriority = YORI_LIB_MEMORY_PRIORITY_VERY_LOW;
+            *ArgsConsumed = 1;
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+/**
+ Apply a set of limits to a process.  The I/O and memory priority are
+ applied to the process, and are inherited by processes it creates.  If a
+ job object is specified, the priority class and processor rate are applied
+ to the job so that they are enforced on every process within it; otherwise
+ the priority class is applied to the process, and the processor rate cannot
+ be limited.
+
+ @param hProcess Handle to the process.
+
+ @param hJob Optionally points to a job object containing the process.
+
+ @param Limits Pointer to the limits to apply.
+
+ @return TRUE if all limits were applied, FALSE if any could not be applied.
+ */
+BOOL
+YoriLibApplyProcessLimits(
+    __in HANDLE hProcess,
+    __in_opt HANDLE hJob,
+    __in PYORI_LIB_PROCESS_LIMITS Limits
+    )
+{
+    BOOL Result;
+
+    Result = TRUE;
+    if (hJob != NULL) {
+        if (Limits->PriorityClass != 0 &&
+            !YoriLibLimitJobObjectPriority(hJob, Limits->PriorityClass)) {
+
+            Result = FALSE;
+        }
+
+        if (Limits->CpuRate != 0 &&
+            !YoriLibLimitJobObjectCpuRate(hJob, Limits->CpuRate)) {
+
+            Result = FALSE;
+        }
+    } else {
+        if (Limits->PriorityClass != 0 &&
+            !SetPriorityClass(hProcess, Limits->PriorityClass)) {
+
+            Result = FALSE;
+        }
+
+        if (Limits->CpuRate != 0) {
+            Result = FALSE;
+        }
+    }
+
+    if (Limits->IoPriority != YORI_LIB_PRIORITY_UNCHANGED &&
+        !YoriLibSetProcessIoPriority(hProcess, Limits->IoPriority)) {
+
+        Result = FALSE;
+    }
+
+    if (Limits->MemoryPriority != YORI_LIB_PRIORITY_UNCHANGED &&
+        !YoriLibSetProcessMemoryPriority(hProcess, Limits->MemoryPriority)) {
+
+        Result = FALSE;
+    }
+
+    return Result;
+}
+
 // vim:sw=4:ts=4:et:
@@ -0,0 +1,177 @@
+/**
+ * @file lib/jobsrv.c
+ *
+ * Yori job server support, allowing cooperating processes to share a
+ * limit on the number of concurrent child processes.
+ *
+ * Copyright (c) 2026 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "yoripch.h"
+#include "yorilib.h"
+
+//
+//  A job server is a named semaphore whose count is the number of
+//  additional child processes that may be launched.  Every process that
+//  participates has one implicit token, which it received from its parent
+//  when it was launched, so it may always execute one child without
+//  acquiring a token from the job server.  Each child beyond the first
+//  requires a token, which is returned to the semaphore when the child
+//  completes.  The name of the semaphore is passed to child processes via
+//  the YORI_JOBSERVER environment variable.
+//
+
+/**
+ The name of the environment variable used to communicate the job server to
+ child processes.
+ */
+#define YORI_JOBSERVER_ENV_VAR _T("YORI_JOBSERVER")
+
+/**
+ Create a new job server and record its name in the environment so that
+ child processes launched from this point can find it.
+
+ @param TokenCount The number of tokens in the job server.  This is
+        typically one fewer than the total number of concurrent processes,
+        since the creating process already has an implicit token.
+
+ @return Handle to the job server, or NULL on failure.  The caller should
+         close this with CloseHandle.
+ */
+HANDLE
+YoriLibCreateJobServer(
+    __in DWORD TokenCount
+    )
+{
+    TCHAR Name[sizeof("YoriJobServer.12345678.12345678")];
+    HANDLE hSemaphore;
+
+    if (TokenCount == 0) {
+        return NULL;
+    }
+
+    YoriLibSPrintfS(Name, sizeof(Name)/sizeof(Name[0]), _T("YoriJobServer.%08x.%08x"), GetCurrentProcessId(), GetTickCount());
+
+    hSemaphore = CreateSemaphore(NULL, (LONG)TokenCount, (LONG)TokenCount, Name);
+    if (hSemaphore == NULL) {
+        return NULL;
+    }
+
+    if (!SetEnvironmentVariable(YORI_JOBSERVER_ENV_VAR, Name)) {
+        CloseHandle(hSemaphore);
+        return NULL;
+    }
+
+    return hSemaphore;
+}
+
+/**
+ Open a job server that was created by a parent process, if one exists.
+
+ @return Handle to the job server, or NULL if this process was not launched
+         with a job server or it could not be opened.  The caller should
+         close this with CloseHandle.
+ */
+HANDLE
+YoriLibOpenJobServer(VOID)
+{
+    YORI_STRING Name;
+    HANDLE hSemaphore;
+
+    YoriLibInitEmptyString(&Name);
+    if (!YoriLibAllocateAndGetEnvVar(YORI_JOBSERVER_ENV_VAR, &Name)) {
+        return NULL;
+    }
+
+    if (Name.LengthInChars == 0) {
+        YoriLibFreeStringContents(&Name);
+        return NULL;
+    }
+
+    hSemaphore = OpenSemaphore(SYNCHRONIZE | SEMAPHORE_MODIFY_STATE, FALSE, Name.StartOfString);
+    YoriLibFreeStringContents(&Name);
+    return hSemaphore;
+}
+
+/**
+ Open the job server created by a parent process, or if none exists, create
+ a new one sized to allow the specified number of concurrent processes.
+
+ @param NumberProcesses The number of concurrent child processes that this
+        process intends to execute.
+
+ @return Handle to the job server, or NULL if no job server is needed or it
+         could not be created.  The caller should close this with
+         CloseHandle.
+ */
+HANDLE
+YoriLibOpenOrCreateJobServer(
+    __in DWORD NumberProcesses
+    )
+{
+    HANDLE hJobServer;
+
+    hJobServer = YoriLibOpenJobServer();
+    if (hJobServer != NULL) {
+        return hJobServer;
+    }
+
+    if (NumberProcesses <= 1) {
+        return NULL;
+    }
+
+    return YoriLibCreateJobServer(NumberProcesses - 1);
+}
+
+/**
+ Attempt to acquire a token from a job server without waiting.
+
+ @param hJobServer Handle to the job server.
+
+ @return TRUE if a token was acquired, FALSE if no token is available.
+ */
+BOOLEAN
+YoriLibTryAcquireJobServerToken(
+    __in HANDLE hJobServer
+    )
+{
+    if (WaitForSingleObject(hJobServer, 0) == WAIT_OBJECT_0) {
+        return TRUE;
+    }
+    return FALSE;
+}
+
+/**
+ Return a token that was previously acquired to a job server.  A token can
+ be acquired by @ref YoriLibTryAcquireJobServerToken or by waiting on the
+ job server handle.
+
+ @param hJobServer Handle to the job server.
+ */
+VOID
+YoriLibReleaseJobServerToken(
+    __in HANDLE hJobServer
+    )
+{
+    ReleaseSemaphore(hJobServer, 1, NULL);
+}
+
+// vim:sw=4:ts=4:et:
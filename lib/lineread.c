@@ -83,8 +83,133 @@ typedef struct _YORI_LIB_LINE_READ_CONTEXT {
      */
     BOOLEAN Terminated;
 
+    /**
+     TRUE if an attempt has been made to create ChangeNotification.  This is
+     only attempted once per stream.
+     */
+    BOOLEAN ChangeNotificationAttempted;
+
+    /**
+     A change notification handle for the directory containing the file
+     being read, used to wait for the file to grow.  NULL if the stream is
+     not a local file or notification could not be established, in which
+     case waiting falls back to polling.
+     */
+    HANDLE ChangeNotification;
+
+    /**
+     When lines are being returned as views, a handle to a mapping of the
+     file being read.  NULL if lines are not returned from a mapping.
+     */
+    HANDLE MapHandle;
+
+    /**
+     When lines are being returned as views, a mapped view of the entire
+     file being read.  NULL if lines are not returned from a mapping.
+     */
+    PUCHAR MapView;
+
+    /**
+     The number of bytes in MapView.
+     */
+    YORI_ALLOC_SIZE_T MapLength;
+
+    /**
+     The offset within MapView, in bytes, of the data that has not yet been
+     returned or converted.
+     */
+    YORI_ALLOC_SIZE_T MapOffset;
+
+    /**
+     When lines are being returned as views from 8 bit input, a buffer
+     containing a range of lines converted to UTF16.
+     */
+    LPTSTR DecodeBuffer;
+
+    /**
+     The size of the DecodeBuffer allocation, in characters.
+     */
+    YORI_ALLOC_SIZE_T DecodeBufferLength;
+
+    /**
+     The number of characters of converted text in DecodeBuffer.
+     */
+    YORI_ALLOC_SIZE_T DecodeChars;
+
+    /**
+     The offset within DecodeBuffer, in characters, of the data that has
+     not yet been returned.
+     */
+    YORI_ALLOC_SIZE_T DecodeOffset;
+
+    /**
+     A string used to return lines as views when the stream cannot be
+     mapped, and lines are read through the line read buffer.
+     */
+    YORI_STRING ViewString;
+
 } YORI_LIB_LINE_READ_CONTEXT, *PYORI_LIB_LINE_READ_CONTEXT;
 
+/**
+ The interval in milliseconds to poll a stream for more data when change
+ notification is not available.
+ */
+#define YORI_LIB_LINE_READ_POLL_INTERVAL (200)
+
+/**
+ The maximum interval in milliseconds to wait for a change notification
+ before checking a stream for data anyway.  The file system can defer
+ updating the directory entry for a file that is still being written via
+ another handle, so notifications are not guaranteed to arrive for every
+ write.
+ */
+#define YORI_LIB_LINE_READ_NOTIFY_INTERVAL (1000)
+
+/**
+ The largest file that will be mapped in its entirety to return lines as
+ views.  Larger files are read through the line read buffer.  This is
+ smaller on 32 bit systems to avoid exhausting address space.
+ */
+#ifdef _WIN64
+#define YORI_LIB_LINE_VIEW_MAX_MAP (0x40000000)
+#else
+#define YORI_LIB_LINE_VIEW_MAX_MAP (0x4000000)
+#endif
+
+/**
+ The number of bytes of 8 bit input to convert to UTF16 at a time when
+ returning lines as views.  Each conversion is extended to the end of the
+ line that contains this offset.
+ */
+#define YORI_LIB_LINE_VIEW_CHUNK_SIZE (64 * 1024)
+
+/**
+ Release any file mapping, decode buffer, or fallback string that has been
+ allocated to return lines as views.
+
+ @param ReadContext Pointer to the line read context.
+ */
+VOID
+YoriLibLineReadReleaseView(
+    __in PYORI_LIB_LINE_READ_CONTEXT ReadContext
+    )
+{
+    if (ReadContext->MapView != NULL) {
+        UnmapViewOfFile(ReadContext->MapView);
+        ReadContext->MapView = NULL;
+    }
+    if (ReadContext->MapHandle != NULL) {
+        CloseHandle(ReadContext->MapHandle);
+        ReadContext->MapHandle = NULL;
+    }
+    if (ReadContext->DecodeBuffer != NULL) {
+        YoriLibFree(ReadContext->DecodeBuffer);
+        ReadContext->DecodeBuffer = NULL;
+    }
+    ReadContext->DecodeBufferLength = 0;
+    YoriLibFreeStringContents(&ReadContext->ViewString);
+}
+
 /**
  Copy the contents of a line into a user specified buffer.  If the buffer
  is not large enough, it is reallocated.  This function performs encoding
@@ -108,12 +233,15 @@ YoriLibCopyLineToUserBufferW(
     )
 {
     YORI_ALLOC_SIZE_T CharsNeeded;
+    YORI_ALLOC_SIZE_T CharsCopied;
 
-    if (CharsToCopy == 0) {
-        CharsNeeded = 1;
-    } else {
-        CharsNeeded = (YORI_ALLOC_SIZE_T)YoriLibGetMultibyteInputSizeNeeded(SourceBuffer, CharsToCopy) + 1;
-    }
+    //
+    //  No input encoding generates more characters than its input length,
+    //  so allocate for that and convert once rather than scanning the line
+    //  to calculate the exact size first.
+    //
+
+    CharsNeeded = CharsToCopy + 1;
 
     if (CharsNeeded > UserString->LengthAllocated) {
         UserString->LengthInChars = 0;
@@ -122,14 +250,15 @@ YoriLibCopyLineToUserBufferW(
         }
     }
 
+    CharsCopied = 0;
     if (CharsToCopy > 0) {
-        YoriLibMultibyteInput(SourceBuffer,
-                              CharsToCopy,
-                              UserString->StartOfString,
-                              UserString->LengthAllocated);
+        CharsCopied = YoriLibMultibyteInput(SourceBuffer,
+                                            CharsToCopy,
+                                            UserString->StartOfString,
+                                            UserString->LengthAllocated - 1);
     }
 
-    UserString->LengthInChars = CharsNeeded - 1;
+    UserString->LengthInChars = CharsCopied;
     UserString->StartOfString[UserString->LengthInChars] = '\0';
     return TRUE;
 }
@@ -314,9 +443,47 @@ YoriLibReadLineAllocateContext(VOID)
     }
     ReadContext->PreviousBuffer = NULL;
     ReadContext->LengthOfBuffer = 0;
+    ReadContext->ChangeNotification = NULL;
+    ReadContext->MapHandle = NULL;
+    ReadContext->MapView = NULL;
+    ReadContext->DecodeBuffer = NULL;
+    ReadContext->DecodeBufferLength = 0;
+    YoriLibInitEmptyString(&ReadContext->ViewString);
     return ReadContext;
 }
 
+/**
+ Initialize a newly allocated line read context to read from a stream.
+
+ @param ReadContext Pointer to the line read context.
+
+ @param FileHandle Specifies the handle to the file to read lines from.
+ */
+VOID
+YoriLibReadLineInitializeContext(
+    __in PYORI_LIB_LINE_READ_CONTEXT ReadContext,
+    __in HANDLE FileHandle
+    )
+{
+    ReadContext->BytesInBuffer = 0;
+    ReadContext->CurrentBufferOffset = 0;
+    ReadContext->LinesRead = 0;
+    ReadContext->FileType = GetFileType(FileHandle);
+    if (YoriLibGetMultibyteInputEncoding() == CP_UTF16) {
+        ReadContext->ReadWChars = TRUE;
+    } else {
+        ReadContext->ReadWChars = FALSE;
+    }
+    ReadContext->Terminated = FALSE;
+    ReadContext->ChangeNotificationAttempted = FALSE;
+    ReadContext->MapLength = 0;
+    ReadContext->MapOffset = 0;
+    ReadContext->DecodeChars = 0;
+    ReadContext->DecodeOffset = 0;
+    ASSERT(ReadContext->ChangeNotification == NULL);
+    ASSERT(ReadContext->MapView == NULL);
+}
+
 /**
  Close a line read context, and store it in the cache if there is an
  available slot for it.  After using this routine, a caller is expected to
@@ -334,6 +501,20 @@ YoriLibLineReadCloseOrCache(
         PYORI_LIB_LINE_READ_CONTEXT OldContext;
         DWORD ProbeIndex;
 
+        //
+        //  A change notification refers to the stream being read, so it
+        //  cannot be reused with a cached context.
+        //
+
+        if (ReadContext != NULL && ReadContext->ChangeNotification != NULL) {
+            FindCloseChangeNotification(ReadContext->ChangeNotification);
+            ReadContext->ChangeNotification = NULL;
+        }
+
+        if (ReadContext != NULL) {
+            YoriLibLineReadReleaseView(ReadContext);
+        }
+
         OldContext = NULL;
         for (ProbeIndex = 0;
              ProbeIndex < YORI_LIB_READ_LINE_CACHE_ENTRIES;
@@ -442,6 +623,7 @@ YoriLibReadLineToStringEx(
     YORI_ALLOC_SIZE_T CharsRemaining;
     DWORD CumulativeDelay;
     YORI_LIB_LINE_ENDING LocalLineEnding;
+    DWORDLONG StartTime;
 
     *TimeoutReached = FALSE;
 
@@ -457,16 +639,7 @@ YoriLibReadLineToStringEx(
             return NULL;
         }
         *Context = ReadContext;
-        ReadContext->BytesInBuffer = 0;
-        ReadContext->CurrentBufferOffset = 0;
-        ReadContext->LinesRead = 0;
-        ReadContext->FileType = GetFileType(FileHandle);
-        if (YoriLibGetMultibyteInputEncoding() == CP_UTF16) {
-            ReadContext->ReadWChars = TRUE;
-        } else {
-            ReadContext->ReadWChars = FALSE;
-        }
-        ReadContext->Terminated = FALSE;
+        YoriLibReadLineInitializeContext(ReadContext, FileHandle);
     } else {
         ReadContext = *Context;
         if (ReadContext->Terminated) {
@@ -739,6 +912,11 @@ YoriLibReadLineToStringEx(
             BytesToRead = ReadContext->LengthOfBuffer - ReadContext->BytesInBuffer;
             LastError = ERROR_SUCCESS;
 
+            StartTime = 0;
+            if (YoriLibEtwIsEnabled(YORI_LIB_ETW_KEYWORD_LINEREAD)) {
+                StartTime = YoriLibEtwGetTimestamp();
+            }
+
             while(TRUE) {
                 if (ReadFile(FileHandle, YoriLibAddToPointer(ReadContext->PreviousBuffer, ReadContext->BytesInBuffer), BytesToRead, &BytesRead, NULL)) {
                     LastError = ERROR_SUCCESS;
@@ -760,6 +938,17 @@ YoriLibReadLineToStringEx(
                 break;
             }
 
+            if (StartTime != 0) {
+                YoriLibEtwWriteEvent(YORI_LIB_ETW_KEYWORD_LINEREAD,
+                                     "LineReadFill",
+                                     NULL,
+                                     NULL,
+                                     "Bytes",
+                                     BytesRead,
+                                     "DurationUs",
+                                     YoriLibEtwGetTimestamp() - StartTime);
+            }
+
             if (LastError != ERROR_SUCCESS) {
 #if DBG
                 //
@@ -865,6 +1054,488 @@ YoriLibReadLineToString(
     return YoriLibReadLineToStringEx(UserString, Context, TRUE, INFINITE, FileHandle, &LineEnding, &TimeoutReached);
 }
 
+/**
+ Attempt to map a file so that lines can be returned as views into it.  This
+ is only possible for files on disk that are small enough to map in their
+ entirety.  Lines are returned starting from the current file position.
+
+ @param ReadContext Pointer to the line read context.
+
+ @param FileHandle Specifies the handle to the file to read lines from.
+
+ @return TRUE if the file was mapped, FALSE if lines should be read through
+         the line read buffer.
+ */
+__success(return)
+BOOL
+YoriLibLineReadMapFile(
+    __in PYORI_LIB_LINE_READ_CONTEXT ReadContext,
+    __in HANDLE FileHandle
+    )
+{
+    DWORD FileSizeLow;
+    DWORD FileSizeHigh;
+    DWORD OffsetLow;
+    LONG OffsetHigh;
+
+    if (ReadContext->FileType != FILE_TYPE_DISK) {
+        return FALSE;
+    }
+
+    FileSizeHigh = 0;
+    FileSizeLow = GetFileSize(FileHandle, &FileSizeHigh);
+    if (FileSizeHigh != 0 ||
+        FileSizeLow == 0 ||
+        FileSizeLow > YORI_LIB_LINE_VIEW_MAX_MAP) {
+
+        return FALSE;
+    }
+
+    OffsetHigh = 0;
+    OffsetLow = SetFilePointer(FileHandle, 0, &OffsetHigh, FILE_CURRENT);
+    if (OffsetHigh != 0 || OffsetLow > FileSizeLow) {
+        return FALSE;
+    }
+
+    if (ReadContext->ReadWChars && (OffsetLow % sizeof(WCHAR)) != 0) {
+        return FALSE;
+    }
+
+    ReadContext->MapHandle = CreateFileMapping(FileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (ReadContext->MapHandle == NULL) {
+        return FALSE;
+    }
+
+    ReadContext->MapView = MapViewOfFile(ReadContext->MapHandle, FILE_MAP_READ, 0, 0, FileSizeLow);
+    if (ReadContext->MapView == NULL) {
+        CloseHandle(ReadContext->MapHandle);
+        ReadContext->MapHandle = NULL;
+        return FALSE;
+    }
+
+    ReadContext->MapLength = FileSizeLow;
+    ReadContext->MapOffset = OffsetLow;
+    ReadContext->MapOffset = ReadContext->MapOffset + YoriLibBytesInBom(&ReadContext->MapView[OffsetLow], FileSizeLow - OffsetLow);
+    return TRUE;
+}
+
+/**
+ Convert the next range of lines from a mapped file containing 8 bit input
+ into the decode buffer.  The range is approximately
+ YORI_LIB_LINE_VIEW_CHUNK_SIZE bytes, and ends at a line break, so lines
+ never span two ranges.
+
+ @param ReadContext Pointer to the line read context.
+
+ @return TRUE if more text was converted, FALSE if the end of the file has
+         been reached or memory could not be allocated.
+ */
+__success(return)
+BOOL
+YoriLibLineReadDecodeChunk(
+    __in PYORI_LIB_LINE_READ_CONTEXT ReadContext
+    )
+{
+    PUCHAR Buffer;
+    YORI_ALLOC_SIZE_T Remaining;
+    YORI_ALLOC_SIZE_T ChunkLength;
+
+    Buffer = &ReadContext->MapView[ReadContext->MapOffset];
+    Remaining = ReadContext->MapLength - ReadContext->MapOffset;
+    if (Remaining == 0) {
+        return FALSE;
+    }
+
+    if (Remaining <= YORI_LIB_LINE_VIEW_CHUNK_SIZE) {
+        ChunkLength = Remaining;
+    } else {
+
+        //
+        //  End the range after the last line break within the chunk size,
+        //  or if there isn't one, after the first line break beyond it.
+        //  Don't separate a CR from the LF that follows it.
+        //
+
+        for (ChunkLength = YORI_LIB_LINE_VIEW_CHUNK_SIZE; ChunkLength > 0; ChunkLength--) {
+            if (Buffer[ChunkLength - 1] == 0xD || Buffer[ChunkLength - 1] == 0xA) {
+                break;
+            }
+        }
+
+        if (ChunkLength == 0) {
+            for (ChunkLength = YORI_LIB_LINE_VIEW_CHUNK_SIZE; ChunkLength < Remaining; ChunkLength++) {
+                if (Buffer[ChunkLength] == 0xD || Buffer[ChunkLength] == 0xA) {
+                    ChunkLength++;
+                    break;
+                }
+            }
+        }
+
+        if (ChunkLength < Remaining &&
+            Buffer[ChunkLength - 1] == 0xD &&
+            Buffer[ChunkLength] == 0xA) {
+
+            ChunkLength++;
+        }
+    }
+
+    //
+    //  No encoding generates more characters than bytes, so a buffer with
+    //  as many characters as the range has bytes is sufficient.
+    //
+
+    if (ChunkLength > ReadContext->DecodeBufferLength) {
+        if (!YoriLibIsSizeAllocatable((YORI_MAX_UNSIGNED_T)ChunkLength * sizeof(TCHAR))) {
+            return FALSE;
+        }
+        if (ReadContext->DecodeBuffer != NULL) {
+            YoriLibFree(ReadContext->DecodeBuffer);
+        }
+        ReadContext->DecodeBufferLength = 0;
+        ReadContext->DecodeBuffer = YoriLibMalloc(ChunkLength * sizeof(TCHAR));
+        if (ReadContext->DecodeBuffer == NULL) {
+            return FALSE;
+        }
+        ReadContext->DecodeBufferLength = ChunkLength;
+    }
+
+    ReadContext->DecodeChars = YoriLibMultibyteInput((LPCSTR)Buffer,
+                                                     ChunkLength,
+                                                     ReadContext->DecodeBuffer,
+                                                     ReadContext->DecodeBufferLength);
+    ReadContext->DecodeOffset = 0;
+    ReadContext->MapOffset = ReadContext->MapOffset + ChunkLength;
+    return TRUE;
+}
+
+/**
+ Read a line from an input stream and return it as a view into a buffer
+ owned by the line read context, avoiding a copy of each line into a caller
+ allocated string.  For files on disk, the file is mapped, and UTF16 lines
+ are returned directly from the mapping, while lines in other encodings are
+ converted a range at a time and returned from the converted range.  For
+ other streams, lines are read into a buffer within the context.  Any line
+ at the end of the stream without a line ending is returned as a line.
+
+ Because the returned view refers to memory owned by the context, it is only
+ valid until the next line is read or the context is closed, and must not
+ be modified.  This is intended for callers which process each line before
+ reading the next.  The caller should not expect a file being read to be
+ truncated concurrently.
+
+ @param View On successful completion, updated to refer to the line, without
+        any line ending characters.  This string does not need to be freed.
+
+ @param Context Pointer to a PVOID sized block of memory that should be
+        initialized to NULL for the first line read, and will be updated by
+        this function.  This should be freed with
+        YoriLibLineReadCloseOrCache or YoriLibLineReadClose.
+
+ @param FileHandle Specifies the handle to the file to read the line from.
+
+ @return TRUE if a line was returned, FALSE if the end of the stream was
+         reached or an error occurred.
+ */
+__success(return)
+BOOL
+YoriLibReadLineToView(
+    __out PYORI_STRING View,
+    __inout PVOID * Context,
+    __in HANDLE FileHandle
+    )
+{
+    PYORI_LIB_LINE_READ_CONTEXT ReadContext;
+    LPTSTR Buffer;
+    YORI_ALLOC_SIZE_T CharsRemaining;
+    YORI_ALLOC_SIZE_T LineLength;
+    YORI_ALLOC_SIZE_T Index;
+
+    if (*Context == NULL) {
+        ReadContext = YoriLibReadLineAllocateContext();
+        if (ReadContext == NULL) {
+            return FALSE;
+        }
+        *Context = ReadContext;
+        YoriLibReadLineInitializeContext(ReadContext, FileHandle);
+        YoriLibLineReadMapFile(ReadContext, FileHandle);
+    } else {
+        ReadContext = *Context;
+    }
+
+    //
+    //  If the file couldn't be mapped, read the line into the context's
+    //  string and return a view of that.
+    //
+
+    if (ReadContext->MapView == NULL) {
+        if (!YoriLibReadLineToString(&ReadContext->ViewString, Context, FileHandle)) {
+            return FALSE;
+        }
+        YoriLibInitEmptyString(View);
+        View->StartOfString = ReadContext->ViewString.StartOfString;
+        View->LengthInChars = ReadContext->ViewString.LengthInChars;
+        View->LengthAllocated = View->LengthInChars;
+        return TRUE;
+    }
+
+    if (ReadContext->Terminated) {
+        return FALSE;
+    }
+
+    if (ReadContext->ReadWChars) {
+        Buffer = (LPTSTR)&ReadContext->MapView[ReadContext->MapOffset];
+        CharsRemaining = (ReadContext->MapLength - ReadContext->MapOffset) / sizeof(WCHAR);
+    } else {
+        while (ReadContext->DecodeOffset == ReadContext->DecodeChars) {
+            if (!YoriLibLineReadDecodeChunk(ReadContext)) {
+                break;
+            }
+        }
+        Buffer = &ReadContext->DecodeBuffer[ReadContext->DecodeOffset];
+        CharsRemaining = ReadContext->DecodeChars - ReadContext->DecodeOffset;
+    }
+
+    //
+    //  When the end of the file is reached, leave the file position after
+    //  the data that has been returned, as reading it would have done.
+    //
+
+    if (CharsRemaining == 0) {
+        ReadContext->Terminated = TRUE;
+        SetFilePointer(FileHandle, (LONG)ReadContext->MapLength, NULL, FILE_BEGIN);
+        return FALSE;
+    }
+
+    for (Index = 0; Index < CharsRemaining; Index++) {
+        if (Buffer[Index] == 0xD || Buffer[Index] == 0xA) {
+            break;
+        }
+    }
+
+    LineLength = Index;
+    if (Index < CharsRemaining) {
+        if (Buffer[Index] == 0xD &&
+            Index + 1 < CharsRemaining &&
+            Buffer[Index + 1] == 0xA) {
+
+            Index++;
+        }
+        Index++;
+    }
+
+    if (ReadContext->ReadWChars) {
+        ReadContext->MapOffset = ReadContext->MapOffset + Index * sizeof(WCHAR);
+    } else {
+        ReadContext->DecodeOffset = ReadContext->DecodeOffset + Index;
+    }
+
+    YoriLibInitEmptyString(View);
+    View->StartOfString = Buffer;
+    View->LengthInChars = LineLength;
+    View->LengthAllocated = LineLength;
+    ReadContext->LinesRead++;
+    return TRUE;
+}
+
+/**
+ Attempt to create a change notification for the directory containing a
+ file, so that a caller can wait for the file to change rather than polling
+ it.  This is only possible for local files on systems that can resolve a
+ handle into a path.
+
+ @param ReadContext Pointer to the line read context to populate with a
+        change notification handle.
+
+ @param FileHandle Specifies the handle to the file being read.
+ */
+VOID
+YoriLibLineReadCreateChangeNotification(
+    __in PYORI_LIB_LINE_READ_CONTEXT ReadContext,
+    __in HANDLE FileHandle
+    )
+{
+    YORI_STRING FilePath;
+    YORI_STRING UncPrefix;
+    YORI_ALLOC_SIZE_T Index;
+    DWORD LengthNeeded;
+    HANDLE ChangeNotification;
+
+    ReadContext->ChangeNotificationAttempted = TRUE;
+    ReadContext->ChangeNotification = NULL;
+
+    if (ReadContext->FileType != FILE_TYPE_DISK) {
+        return;
+    }
+
+    if (DllKernel32.pGetFinalPathNameByHandleW == NULL) {
+        return;
+    }
+
+    LengthNeeded = DllKernel32.pGetFinalPathNameByHandleW(FileHandle, NULL, 0, 0);
+    if (LengthNeeded == 0) {
+        return;
+    }
+
+    if (!YoriLibAllocateString(&FilePath, (YORI_ALLOC_SIZE_T)LengthNeeded + 1)) {
+        return;
+    }
+
+    LengthNeeded = DllKernel32.pGetFinalPathNameByHandleW(FileHandle, FilePath.StartOfString, FilePath.LengthAllocated, 0);
+    if (LengthNeeded == 0 || LengthNeeded >= FilePath.LengthAllocated) {
+        YoriLibFreeStringContents(&FilePath);
+        return;
+    }
+    FilePath.LengthInChars = (YORI_ALLOC_SIZE_T)LengthNeeded;
+
+    //
+    //  Network file systems may not report changes made by other clients,
+    //  so continue to poll these.
+    //
+
+    YoriLibConstantString(&UncPrefix, _T("\\\\?\\UNC\\"));
+    if (YoriLibCompareStringInsCnt(&FilePath, &UncPrefix, UncPrefix.LengthInChars) == 0) {
+        YoriLibFreeStringContents(&FilePath);
+        return;
+    }
+
+    for (Index = FilePath.LengthInChars; Index > 0; Index--) {
+        if (YoriLibIsSep(FilePath.StartOfString[Index - 1])) {
+            break;
+        }
+    }
+
+    if (Index == 0) {
+        YoriLibFreeStringContents(&FilePath);
+        return;
+    }
+
+    FilePath.LengthInChars = Index;
+    FilePath.StartOfString[FilePath.LengthInChars] = '\0';
+
+    ChangeNotification = FindFirstChangeNotification(FilePath.StartOfString,
+                                                     FALSE,
+                                                     FILE_NOTIFY_CHANGE_SIZE | FILE_NOTIFY_CHANGE_LAST_WRITE);
+
+    YoriLibFreeStringContents(&FilePath);
+
+    if (ChangeNotification == INVALID_HANDLE_VALUE) {
+        return;
+    }
+
+    ReadContext->ChangeNotification = ChangeNotification;
+}
+
+/**
+ Return a change notification handle that is signalled when the file being
+ read by a line read context may have changed.  This allows a caller that
+ is following multiple streams to wait on all of them at once.  When the
+ handle is signalled, the caller should call FindNextChangeNotification to
+ rearm it and attempt to read more data.  The handle remains owned by the
+ line read context and is closed when the context is closed.
+
+ @param Context Pointer to the line read context used when reading from the
+        stream.
+
+ @param FileHandle Specifies the handle to the file being read.
+
+ @return The change notification handle, or NULL if the stream cannot be
+         monitored for changes and should be polled.
+ */
+HANDLE
+YoriLibLineReadGetChangeNotification(
+    __in_opt PVOID Context,
+    __in HANDLE FileHandle
+    )
+{
+    PYORI_LIB_LINE_READ_CONTEXT ReadContext = (PYORI_LIB_LINE_READ_CONTEXT)Context;
+
+    if (ReadContext == NULL) {
+        return NULL;
+    }
+
+    if (!ReadContext->ChangeNotificationAttempted) {
+        YoriLibLineReadCreateChangeNotification(ReadContext, FileHandle);
+    }
+
+    return ReadContext->ChangeNotification;
+}
+
+/**
+ Wait for more data to arrive on a stream after YoriLibReadLineToStringEx
+ has indicated that no complete line is available.  For local files, this
+ waits for a change notification on the directory containing the file.  For
+ other streams, or where change notification is not available, this waits
+ for a polling interval.  This routine may return before the stream has
+ changed, so the caller is expected to attempt another read and call this
+ function again if no more data is found.
+
+ @param Context Pointer to the line read context used when reading from the
+        stream.  This can be NULL if no line read context exists, in which
+        case this routine polls.
+
+ @param FileHandle Specifies the handle to the file being read.
+
+ @param AdditionalEvent Optionally specifies an event that should terminate
+        the wait when signalled.
+
+ @return TRUE to indicate the caller should attempt to read more data, or
+         FALSE if the wait was terminated due to cancellation or
+         AdditionalEvent.
+ */
+BOOL
+YoriLibLineReadWaitForMore(
+    __in_opt PVOID Context,
+    __in HANDLE FileHandle,
+    __in_opt HANDLE AdditionalEvent
+    )
+{
+    HANDLE HandleArray[3];
+    HANDLE ChangeNotification;
+    DWORD HandleCount;
+    DWORD WaitResult;
+    DWORD Timeout;
+
+    ChangeNotification = YoriLibLineReadGetChangeNotification(Context, FileHandle);
+
+    HandleCount = 0;
+    if (YoriLibCancelGetEvent() != NULL) {
+        HandleArray[HandleCount] = YoriLibCancelGetEvent();
+        HandleCount++;
+    }
+
+    if (AdditionalEvent != NULL) {
+        HandleArray[HandleCount] = AdditionalEvent;
+        HandleCount++;
+    }
+
+    Timeout = YORI_LIB_LINE_READ_POLL_INTERVAL;
+    if (ChangeNotification != NULL) {
+        HandleArray[HandleCount] = ChangeNotification;
+        HandleCount++;
+        Timeout = YORI_LIB_LINE_READ_NOTIFY_INTERVAL;
+    }
+
+    if (HandleCount == 0) {
+        Sleep(Timeout);
+        return TRUE;
+    }
+
+    WaitResult = WaitForMultipleObjectsEx(HandleCount, HandleArray, FALSE, Timeout, FALSE);
+    if (WaitResult == WAIT_TIMEOUT) {
+        return TRUE;
+    }
+
+    if (WaitResult >= WAIT_OBJECT_0 &&
+        WaitResult < WAIT_OBJECT_0 + HandleCount &&
+        HandleArray[WaitResult - WAIT_OBJECT_0] == ChangeNotification) {
+
+        FindNextChangeNotification(ChangeNotification);
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
 /**
  Free any context allocated by YoriLibReadLineFromFile .
 
@@ -880,6 +1551,10 @@ YoriLibLineReadClose(
         if (ReadContext->PreviousBuffer != NULL) {
             YoriLibFree(ReadContext->PreviousBuffer);
         }
+        if (ReadContext->ChangeNotification != NULL) {
+            FindCloseChangeNotification(ReadContext->ChangeNotification);
+        }
+        YoriLibLineReadReleaseView(ReadContext);
         YoriLibFree(ReadContext);
     }
 }
@@ -45,6 +45,66 @@ typedef YORI_ALLOC_SIZE_T YORI_SPECIAL_ALLOC_SIZE_T;
  */
 #define YORI_SPECIAL_HEAP_STACK_FRAMES (10)
 
+/**
+ The maximum number of distinct call sites that allocation profiling can
+ record.  This must be a power of two.
+ */
+#define YORI_SPECIAL_HEAP_CALL_SITE_TABLE_SIZE (4096)
+
+/**
+ Aggregated allocation statistics for a single call site, recorded when
+ allocation profiling is enabled.
+ */
+typedef struct _YORI_SPECIAL_HEAP_CALL_SITE {
+
+    /**
+     The function that allocated the memory.  NULL if this entry is unused.
+     */
+    LPCSTR Function;
+
+    /**
+     The source file that allocated the memory.
+     */
+    LPCSTR File;
+
+    /**
+     The line number that allocated the memory.
+     */
+    DWORD Line;
+
+    /**
+     The number of allocations from this call site which have not been
+     freed.
+     */
+    DWORD LiveAllocations;
+
+    /**
+     The number of allocations made from this call site.
+     */
+    DWORDLONG Allocations;
+
+    /**
+     The number of bytes allocated from this call site.
+     */
+    DWORDLONG BytesAllocated;
+
+    /**
+     The number of allocations from this call site which have been freed.
+     */
+    DWORDLONG Frees;
+
+    /**
+     The sum of the lifetime, in milliseconds, of each freed allocation.
+     */
+    DWORDLONG TotalLifetime;
+
+    /**
+     The longest lifetime, in milliseconds, of any freed allocation.
+     */
+    DWORD MaximumLifetime;
+
+} YORI_SPECIAL_HEAP_CALL_SITE, *PYORI_SPECIAL_HEAP_CALL_SITE;
+
 /**
  A structure embedded at the top of special heap allocations.
  */
@@ -76,17 +136,24 @@ typedef struct _YORI_SPECIAL_HEAP_HEADER {
      */
     LPCSTR File;
 
+    /**
+     The call site statistics for this allocation, or NULL if allocation
+     profiling is not enabled or the call site could not be recorded.
+     */
+    PYORI_SPECIAL_HEAP_CALL_SITE CallSite;
+
     /**
      The line number that allocated the memory.
      */
     DWORD Line;
 
     /**
-     An extra 32 bits that does nothing to ensure 64 bit alignment of this
-     structure so that 64 bit builds will capture pointer values on 64 bit
-     boundaries.
+     The tick count when the allocation was made, used to calculate its
+     lifetime for allocation profiling.  Along with Line, this ensures 64
+     bit alignment of this structure so that 64 bit builds will capture
+     pointer values on 64 bit boundaries.
      */
-    DWORD ReservedForAlignment;
+    DWORD AllocationTick;
 
     /**
      This structure may be followed by the stack that allocated this
@@ -133,6 +200,29 @@ typedef struct _YORI_SPECIAL_HEAP_GLOBAL {
      */
     HANDLE Mutex;
 
+    /**
+     A hash table of call sites, allocated when allocation profiling is
+     enabled.
+     */
+    PYORI_SPECIAL_HEAP_CALL_SITE CallSites;
+
+    /**
+     The number of entries in use within CallSites.
+     */
+    DWORD CallSiteCount;
+
+    /**
+     The number of allocations which could not be attributed to a call site
+     because the call site table is full.
+     */
+    DWORD UnrecordedAllocations;
+
+    /**
+     TRUE once the YORIHEAPPROFILE environment variable has been checked to
+     determine whether allocation profiling should be enabled.
+     */
+    BOOLEAN ProfileChecked;
+
 } YORI_SPECIAL_HEAP_GLOBAL, PYORI_SPECIAL_HEAP_GLOBAL;
 
 /**
@@ -140,6 +230,84 @@ typedef struct _YORI_SPECIAL_HEAP_GLOBAL {
  */
 YORI_SPECIAL_HEAP_GLOBAL YoriLibSpecialHeap;
 
+/**
+ Check whether allocation profiling has been requested by setting the
+ YORIHEAPPROFILE environment variable, and if so, allocate the table of
+ call sites.  This is called with the special heap mutex held.  The table
+ is allocated directly from the system since it cannot be allocated from
+ the heap that it describes.
+ */
+VOID
+YoriLibSpecialHeapCheckProfile(VOID)
+{
+    YoriLibSpecialHeap.ProfileChecked = TRUE;
+    if (GetEnvironmentVariable(_T("YORIHEAPPROFILE"), NULL, 0) == 0) {
+        return;
+    }
+
+    YoriLibSpecialHeap.CallSites = VirtualAlloc(NULL,
+                                                YORI_SPECIAL_HEAP_CALL_SITE_TABLE_SIZE * sizeof(YORI_SPECIAL_HEAP_CALL_SITE),
+                                                MEM_RESERVE | MEM_COMMIT,
+                                                PAGE_READWRITE);
+}
+
+/**
+ Find the statistics for an allocation call site, creating them if this
+ call site has not allocated before.  This is called with the special heap
+ mutex held.
+
+ @param Function Pointer to a constant string indicating the function that is
+        allocating the memory.
+
+ @param File Pointer to a constant string indicating the source file that is
+        allocating the memory.
+
+ @param Line Specifies the line number within the source file that is
+        allocating the memory.
+
+ @return Pointer to the call site statistics, or NULL if the call site table
+         is full.
+ */
+PYORI_SPECIAL_HEAP_CALL_SITE
+YoriLibSpecialHeapFindCallSite(
+    __in LPCSTR Function,
+    __in LPCSTR File,
+    __in DWORD Line
+    )
+{
+    PYORI_SPECIAL_HEAP_CALL_SITE CallSite;
+    DWORD Index;
+
+    //
+    //  The file name is a constant string, so compare the pointer rather
+    //  than the string.  Leave a quarter of the table empty so that probe
+    //  sequences remain short.
+    //
+
+    Index = (DWORD)(((DWORD_PTR)File >> 3) ^ (Line * 2654435761));
+    Index = Index & (YORI_SPECIAL_HEAP_CALL_SITE_TABLE_SIZE - 1);
+    while (TRUE) {
+        CallSite = &YoriLibSpecialHeap.CallSites[Index];
+        if (CallSite->Function == NULL) {
+            break;
+        }
+        if (CallSite->File == File && CallSite->Line == Line) {
+            return CallSite;
+        }
+        Index = (Index + 1) & (YORI_SPECIAL_HEAP_CALL_SITE_TABLE_SIZE - 1);
+    }
+
+    if (YoriLibSpecialHeap.CallSiteCount >= YORI_SPECIAL_HEAP_CALL_SITE_TABLE_SIZE / 4 * 3) {
+        return NULL;
+    }
+
+    CallSite->Function = Function;
+    CallSite->File = File;
+    CallSite->Line = Line;
+    YoriLibSpecialHeap.CallSiteCount++;
+    return CallSite;
+}
+
 #endif
 
 #if !YORI_SPECIAL_HEAP
@@ -157,6 +325,10 @@ YoriLibMalloc(
     )
 {
     PVOID Alloc;
+    Alloc = YoriLibPoolMalloc(Bytes);
+    if (Alloc != NULL) {
+        return Alloc;
+    }
     Alloc = HeapAlloc(GetProcessHeap(), 0, Bytes);
     return Alloc;
 }
@@ -261,6 +433,23 @@ YoriLibMallocSpecialHeap(
     YoriLibSpecialHeap.NumberAllocated++;
     YoriLibSpecialHeap.BytesCurrentlyAllocated += (Bytes + Alignment - 1) & ~(Alignment - 1);
     YoriLibAppendList(&YoriLibSpecialHeap.ActiveAllocationsList, &Header->ListEntry);
+
+    if (!YoriLibSpecialHeap.ProfileChecked) {
+        YoriLibSpecialHeapCheckProfile();
+    }
+
+    Header->CallSite = NULL;
+    if (YoriLibSpecialHeap.CallSites != NULL) {
+        Header->CallSite = YoriLibSpecialHeapFindCallSite(Function, File, Line);
+        if (Header->CallSite != NULL) {
+            Header->AllocationTick = GetTickCount();
+            Header->CallSite->Allocations++;
+            Header->CallSite->BytesAllocated += Bytes;
+            Header->CallSite->LiveAllocations++;
+        } else {
+            YoriLibSpecialHeap.UnrecordedAllocations++;
+        }
+    }
     ReleaseMutex(YoriLibSpecialHeap.Mutex);
 
     return (PUCHAR)Header + Header->OffsetToData;
@@ -278,6 +467,9 @@ YoriLibFree(
     )
 {
 #if !YORI_SPECIAL_HEAP
+    if (YoriLibPoolFree(Ptr)) {
+        return;
+    }
     HeapFree(GetProcessHeap(), 0, Ptr);
 #else
     PYORI_SPECIAL_HEAP_HEADER Header;
@@ -316,6 +508,18 @@ YoriLibFree(
     YoriLibSpecialHeap.BytesCurrentlyAllocated -= BytesToFree;
     YoriLibRemoveListItem(&Header->ListEntry);
 
+    if (Header->CallSite != NULL) {
+        DWORD Lifetime;
+
+        Lifetime = GetTickCount() - Header->AllocationTick;
+        Header->CallSite->Frees++;
+        Header->CallSite->LiveAllocations--;
+        Header->CallSite->TotalLifetime += Lifetime;
+        if (Lifetime > Header->CallSite->MaximumLifetime) {
+            Header->CallSite->MaximumLifetime = Lifetime;
+        }
+    }
+
     if (YoriLibSpecialHeap.RecentlyFreed[MyEntry] != NULL) {
 
         PYORI_SPECIAL_HEAP_HEADER OldHeader;
@@ -344,10 +548,186 @@ YoriLibFree(
 #endif
 }
 
+#if YORI_SPECIAL_HEAP
+/**
+ Return TRUE if the first call site should be reported before the second.
+ Call sites are reported in descending order of allocation count, and then
+ of bytes allocated.
+
+ @param First Pointer to the first call site.
+
+ @param Second Pointer to the second call site.
+
+ @return TRUE if First should be reported before Second.
+ */
+BOOLEAN
+YoriLibSpecialHeapCallSiteBefore(
+    __in PYORI_SPECIAL_HEAP_CALL_SITE First,
+    __in PYORI_SPECIAL_HEAP_CALL_SITE Second
+    )
+{
+    if (First->Allocations != Second->Allocations) {
+        return (BOOLEAN)(First->Allocations > Second->Allocations);
+    }
+    return (BOOLEAN)(First->BytesAllocated > Second->BytesAllocated);
+}
+
+/**
+ Move an element down a heap of call sites until the heap property is
+ restored.  The heap places the call site that should be reported last at
+ the root.
+
+ @param Sites Pointer to the array of call sites.
+
+ @param Index The index of the element to move.
+
+ @param Count The number of elements in the heap.
+ */
+VOID
+YoriLibSpecialHeapSiftDown(
+    __inout PYORI_SPECIAL_HEAP_CALL_SITE *Sites,
+    __in DWORD Index,
+    __in DWORD Count
+    )
+{
+    PYORI_SPECIAL_HEAP_CALL_SITE Swap;
+    DWORD Child;
+
+    while (Index * 2 + 1 < Count) {
+        Child = Index * 2 + 1;
+        if (Child + 1 < Count &&
+            YoriLibSpecialHeapCallSiteBefore(Sites[Child], Sites[Child + 1])) {
+            Child++;
+        }
+        if (!YoriLibSpecialHeapCallSiteBefore(Sites[Index], Sites[Child])) {
+            break;
+        }
+        Swap = Sites[Index];
+        Sites[Index] = Sites[Child];
+        Sites[Child] = Swap;
+        Index = Child;
+    }
+}
+#endif
+
+/**
+ Indicate whether allocation profiling is active.  Profiling is only
+ available when using memory debugging and is enabled by setting the
+ YORIHEAPPROFILE environment variable before the process starts.
+
+ @return TRUE if allocation profiling is active, FALSE if it is not.
+ */
+__success(return)
+BOOL
+YoriLibIsAllocationProfileEnabled(VOID)
+{
+#if YORI_SPECIAL_HEAP
+    if (YoriLibSpecialHeap.CallSites != NULL) {
+        return TRUE;
+    }
+#endif
+    return FALSE;
+}
+
+/**
+ When allocation profiling is active, display the call sites which have
+ allocated memory, ordered by the number of allocations made, along with
+ the bytes allocated, the number of allocations still outstanding, and the
+ average and longest lifetime of allocations that have been freed.  When
+ profiling is not active, does nothing.
+
+ @param MaximumEntries The maximum number of call sites to display.  If
+        zero, all call sites are displayed.
+ */
+VOID
+YoriLibDisplayAllocationProfile(
+    __in DWORD MaximumEntries
+    )
+{
+#if YORI_SPECIAL_HEAP
+    PYORI_SPECIAL_HEAP_CALL_SITE *Sites;
+    PYORI_SPECIAL_HEAP_CALL_SITE CallSite;
+    PYORI_SPECIAL_HEAP_CALL_SITE Swap;
+    DWORDLONG AverageLifetime;
+    DWORD Count;
+    DWORD Index;
+
+    if (YoriLibSpecialHeap.CallSites == NULL) {
+        return;
+    }
+
+    //
+    //  The array used for sorting is allocated directly from the process
+    //  heap so that displaying the profile does not alter it.
+    //
+
+    WaitForSingleObject(YoriLibSpecialHeap.Mutex, INFINITE);
+    Sites = HeapAlloc(GetProcessHeap(), 0, YoriLibSpecialHeap.CallSiteCount * sizeof(PYORI_SPECIAL_HEAP_CALL_SITE) + 1);
+    if (Sites == NULL) {
+        ReleaseMutex(YoriLibSpecialHeap.Mutex);
+        return;
+    }
+
+    Count = 0;
+    for (Index = 0; Index < YORI_SPECIAL_HEAP_CALL_SITE_TABLE_SIZE; Index++) {
+        CallSite = &YoriLibSpecialHeap.CallSites[Index];
+        if (CallSite->Function != NULL && Count < YoriLibSpecialHeap.CallSiteCount) {
+            Sites[Count] = CallSite;
+            Count++;
+        }
+    }
+
+    for (Index = Count / 2; Index > 0; Index--) {
+        YoriLibSpecialHeapSiftDown(Sites, Index - 1, Count);
+    }
+
+    for (Index = Count; Index > 1; Index--) {
+        Swap = Sites[0];
+        Sites[0] = Sites[Index - 1];
+        Sites[Index - 1] = Swap;
+        YoriLibSpecialHeapSiftDown(Sites, 0, Index - 1);
+    }
+
+    if (MaximumEntries != 0 && Count > MaximumEntries) {
+        Count = MaximumEntries;
+    }
+
+    YoriLibOutput(YORI_LIB_OUTPUT_STDERR,
+                  _T("%i call sites, %i allocations not attributed\n")
+                  _T("    Allocs        Bytes   Live  AvgLife  MaxLife  Site\n"),
+                  YoriLibSpecialHeap.CallSiteCount,
+                  YoriLibSpecialHeap.UnrecordedAllocations);
+
+    for (Index = 0; Index < Count; Index++) {
+        CallSite = Sites[Index];
+        AverageLifetime = 0;
+        if (CallSite->Frees > 0) {
+            AverageLifetime = CallSite->TotalLifetime / CallSite->Frees;
+        }
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR,
+                      _T("%10lli %12lli %6i %8lli %8i  %hs (%hs:%i)\n"),
+                      CallSite->Allocations,
+                      CallSite->BytesAllocated,
+                      CallSite->LiveAllocations,
+                      AverageLifetime,
+                      CallSite->MaximumLifetime,
+                      CallSite->Function,
+                      CallSite->File,
+                      CallSite->Line);
+    }
+
+    HeapFree(GetProcessHeap(), 0, Sites);
+    ReleaseMutex(YoriLibSpecialHeap.Mutex);
+#else
+    UNREFERENCED_PARAMETER(MaximumEntries);
+#endif
+}
+
 /**
  When using memory debugging, display the number of bytes of allocation and
- number of allocations currently in use.  When memory debugging is not present,
- does nothing.
+ number of allocations currently in use.  When the pool is enabled and
+ statistics were requested, display statistics for each size class and
+ arena.  Otherwise, does nothing.
  */
 VOID
 YoriLibDisplayMemoryUsage(VOID)
@@ -355,6 +735,7 @@ YoriLibDisplayMemoryUsage(VOID)
 #if YORI_SPECIAL_HEAP
     YORI_ALLOC_SIZE_T PageSize;
     PageSize = YoriLibGetPageSize();
+    YoriLibDisplayAllocationProfile(0);
     if (YoriLibSpecialHeap.BytesCurrentlyAllocated > 0 ||
         (YoriLibSpecialHeap.NumberAllocated - YoriLibSpecialHeap.NumberFreed > 0)) {
 
@@ -383,6 +764,7 @@ YoriLibDisplayMemoryUsage(VOID)
         DebugBreak();
     }
 #endif
+    YoriLibPoolDisplayStatistics();
 }
 
 
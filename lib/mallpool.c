@@ -0,0 +1,982 @@
+/**
+ * @file lib/mallpool.c
+ *
+ * Yori pooled small allocations and bulk arenas
+ *
+ * Copyright (c) 2017-2026 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "yoripch.h"
+#include "yorilib.h"
+
+//
+//  A long running process such as the shell performs a very large number of
+//  small allocations for strings, parsed arguments and the like, and each of
+//  these is a trip through the process heap and its lock.  A process can opt
+//  into servicing small allocations from a pool by calling
+//  YoriLibPoolEnable, after which YoriLibMalloc and YoriLibFree use it
+//  transparently.
+//
+//  The pool reserves a single range of address space and commits it in
+//  slabs, each of which is dedicated to one size class.  Since every pooled
+//  allocation is within the range, YoriLibFree can determine whether an
+//  allocation came from the pool with a single comparison, and the size
+//  class of an allocation is found from its slab without any per-allocation
+//  header.  Each thread keeps its own free list for every size class,
+//  so most allocations and frees do not need any lock.  Blocks move between
+//  a thread's list and a process wide list in batches, and the cached
+//  blocks of threads that have exited are returned to the process wide list
+//  before committing another slab.  Slabs are never decommitted.
+//
+//  Separately, an arena allows a caller to make many allocations with a
+//  common lifetime and release them all at once.  Arenas are owned by the
+//  caller, are not synchronized, and are available whether or not the pool
+//  is enabled.
+//
+
+/**
+ The size of each slab within the pool.  Each slab contains allocations of
+ a single size class.
+ */
+#define YORI_LIB_POOL_SLAB_SIZE (64 * 1024)
+
+/**
+ The amount of address space to reserve for the pool.  Once this is
+ exhausted, further small allocations are serviced from the process heap.
+ */
+#ifdef _WIN64
+#define YORI_LIB_POOL_REGION_SIZE (256 * 1024 * 1024)
+#else
+#define YORI_LIB_POOL_REGION_SIZE (32 * 1024 * 1024)
+#endif
+
+/**
+ The number of slabs within the pool.
+ */
+#define YORI_LIB_POOL_SLAB_COUNT (YORI_LIB_POOL_REGION_SIZE / YORI_LIB_POOL_SLAB_SIZE)
+
+/**
+ The granularity of size classes.  Every size class is a multiple of this,
+ which ensures pooled allocations have the same alignment as the process
+ heap.
+ */
+#define YORI_LIB_POOL_GRANULARITY (16)
+
+/**
+ The number of size classes.
+ */
+#define YORI_LIB_POOL_CLASS_COUNT (10)
+
+/**
+ The largest allocation that can be serviced from the pool.
+ */
+#define YORI_LIB_POOL_MAX_BLOCK_SIZE (512)
+
+/**
+ The number of free blocks of a single size class that a thread can cache
+ before returning some to the process wide list.
+ */
+#define YORI_LIB_POOL_THREAD_CACHE_LIMIT (64)
+
+/**
+ The number of blocks moved between a thread's cache and the process wide
+ list at a time.
+ */
+#define YORI_LIB_POOL_TRANSFER_BATCH (32)
+
+/**
+ The alignment of allocations returned from an arena.
+ */
+#define YORI_LIB_ARENA_ALIGNMENT (2 * sizeof(PVOID))
+
+/**
+ The size of each chunk allocated by an arena if the caller does not
+ specify one.
+ */
+#define YORI_LIB_ARENA_DEFAULT_CHUNK_SIZE (64 * 1024)
+
+/**
+ The size in bytes of each size class.
+ */
+CONST YORI_ALLOC_SIZE_T
+YoriLibPoolClassSizes[YORI_LIB_POOL_CLASS_COUNT] = {
+    16, 32, 48, 64, 96, 128, 192, 256, 384, 512
+};
+
+/**
+ A lookup table from an allocation size, divided by the granularity and
+ rounded up, to the size class that services it.
+ */
+CONST UCHAR
+YoriLibPoolClassForGranule[YORI_LIB_POOL_MAX_BLOCK_SIZE / YORI_LIB_POOL_GRANULARITY + 1] = {
+    0, 0, 1, 2, 3, 4, 4, 5, 5, 6, 6, 6, 6, 7, 7, 7,
+    7, 8, 8, 8, 8, 8, 8, 8, 8, 9, 9, 9, 9, 9, 9, 9,
+    9
+};
+
+/**
+ A free block within the pool.  The first bytes of a free block link it to
+ the next free block of the same size class.
+ */
+typedef struct _YORI_LIB_POOL_FREE_BLOCK {
+
+    /**
+     The next free block of the same size class.
+     */
+    struct _YORI_LIB_POOL_FREE_BLOCK *Next;
+} YORI_LIB_POOL_FREE_BLOCK, *PYORI_LIB_POOL_FREE_BLOCK;
+
+/**
+ Counters describing the use of a single size class.
+ */
+typedef struct _YORI_LIB_POOL_CLASS_STATS {
+
+    /**
+     The number of allocations serviced from the size class.
+     */
+    DWORDLONG Allocations;
+
+    /**
+     The number of allocations returned to the size class.
+     */
+    DWORDLONG Frees;
+} YORI_LIB_POOL_CLASS_STATS, *PYORI_LIB_POOL_CLASS_STATS;
+
+/**
+ The state of the pool for a single thread.  This is only modified by its
+ thread, except once the thread has exited, when it is reclaimed with the
+ pool mutex held.
+ */
+typedef struct _YORI_LIB_POOL_THREAD {
+
+    /**
+     The list of all threads which have used the pool.  Paired with
+     YORI_LIB_POOL_GLOBAL::ThreadList.
+     */
+    YORI_LIST_ENTRY ListEntry;
+
+    /**
+     A handle to the thread, used to determine when it has exited.
+     */
+    HANDLE ThreadHandle;
+
+    /**
+     The free blocks cached by this thread for each size class.
+     */
+    PYORI_LIB_POOL_FREE_BLOCK FreeList[YORI_LIB_POOL_CLASS_COUNT];
+
+    /**
+     The number of blocks in each FreeList.
+     */
+    DWORD FreeCount[YORI_LIB_POOL_CLASS_COUNT];
+
+    /**
+     Counters for allocations and frees performed by this thread.
+     */
+    YORI_LIB_POOL_CLASS_STATS Stats[YORI_LIB_POOL_CLASS_COUNT];
+} YORI_LIB_POOL_THREAD, *PYORI_LIB_POOL_THREAD;
+
+/**
+ The process wide state of a single size class.  This is protected by the
+ pool mutex.
+ */
+typedef struct _YORI_LIB_POOL_CLASS {
+
+    /**
+     Free blocks which are not cached by any thread.
+     */
+    PYORI_LIB_POOL_FREE_BLOCK FreeList;
+
+    /**
+     The number of blocks in FreeList.
+     */
+    DWORD FreeCount;
+
+    /**
+     The number of slabs committed for this size class.
+     */
+    DWORD SlabCount;
+
+    /**
+     The next block within the most recently committed slab which has never
+     been allocated.
+     */
+    PUCHAR CarveNext;
+
+    /**
+     The number of blocks following CarveNext which have never been
+     allocated.
+     */
+    DWORD CarveRemaining;
+} YORI_LIB_POOL_CLASS, *PYORI_LIB_POOL_CLASS;
+
+/**
+ A structure containing process global state for the pool.
+ */
+typedef struct _YORI_LIB_POOL_GLOBAL {
+
+    /**
+     The base of the address range reserved for the pool.
+     */
+    PUCHAR RegionBase;
+
+    /**
+     A handle to a mutex to synchronize the process wide lists.
+     */
+    HANDLE Mutex;
+
+    /**
+     The TLS index used to find the state of the current thread.
+     */
+    DWORD TlsIndex;
+
+    /**
+     The number of slabs which have been committed.  Slabs are committed in
+     order from the base of the region.
+     */
+    DWORD SlabsCommitted;
+
+    /**
+     The number of allocations which could have been serviced from the pool
+     but were serviced from the process heap, because the region is
+     exhausted or thread state could not be allocated.
+     */
+    DWORDLONG FallbackAllocations;
+
+    /**
+     The size class of each committed slab.
+     */
+    UCHAR SlabClass[YORI_LIB_POOL_SLAB_COUNT];
+
+    /**
+     The process wide state of each size class.
+     */
+    YORI_LIB_POOL_CLASS Classes[YORI_LIB_POOL_CLASS_COUNT];
+
+    /**
+     Counters inherited from threads which have exited, and frees performed
+     without any thread state.
+     */
+    YORI_LIB_POOL_CLASS_STATS RetiredStats[YORI_LIB_POOL_CLASS_COUNT];
+
+    /**
+     A list of all threads which have used the pool.
+     */
+    YORI_LIST_ENTRY ThreadList;
+
+    /**
+     A list of arenas which are currently initialized.
+     */
+    YORI_LIST_ENTRY ArenaList;
+
+    /**
+     The number of arenas which have been initialized.
+     */
+    DWORD ArenasInitialized;
+
+    /**
+     The largest number of bytes allocated from any single arena.
+     */
+    DWORDLONG ArenaPeakBytes;
+
+    /**
+     TRUE once the pool has been initialized and should service
+     allocations.
+     */
+    BOOLEAN Enabled;
+
+    /**
+     TRUE if pool statistics should be displayed by
+     YoriLibDisplayMemoryUsage.
+     */
+    BOOLEAN DisplayStatistics;
+
+} YORI_LIB_POOL_GLOBAL, *PYORI_LIB_POOL_GLOBAL;
+
+/**
+ Process global state for the pool.
+ */
+YORI_LIB_POOL_GLOBAL YoriLibPool;
+
+/**
+ Enable servicing small allocations from the pool.  This should be called
+ early in process execution, before any other threads are created.  Once
+ enabled, the pool cannot be disabled, since outstanding allocations depend
+ on it.  If the YORIPOOLSTATS environment variable is set, pool statistics
+ are displayed by @ref YoriLibDisplayMemoryUsage.
+
+ @return TRUE to indicate the pool is in use, FALSE if it is not.
+ */
+__success(return)
+BOOL
+YoriLibPoolEnable(VOID)
+{
+#if YORI_SPECIAL_HEAP
+
+    //
+    //  The special heap places every allocation against a guard page to
+    //  find overruns and use after free.  Pooling would defeat this.
+    //
+
+    return FALSE;
+#else
+    if (YoriLibPool.Enabled) {
+        return TRUE;
+    }
+
+    YoriLibPool.Mutex = CreateMutex(NULL, FALSE, NULL);
+    if (YoriLibPool.Mutex == NULL) {
+        return FALSE;
+    }
+
+    YoriLibPool.TlsIndex = TlsAlloc();
+    if (YoriLibPool.TlsIndex == TLS_OUT_OF_INDEXES) {
+        CloseHandle(YoriLibPool.Mutex);
+        YoriLibPool.Mutex = NULL;
+        return FALSE;
+    }
+
+    YoriLibPool.RegionBase = VirtualAlloc(NULL, YORI_LIB_POOL_REGION_SIZE, MEM_RESERVE, PAGE_READWRITE);
+    if (YoriLibPool.RegionBase == NULL) {
+        TlsFree(YoriLibPool.TlsIndex);
+        CloseHandle(YoriLibPool.Mutex);
+        YoriLibPool.Mutex = NULL;
+        return FALSE;
+    }
+
+    YoriLibInitializeListHead(&YoriLibPool.ThreadList);
+    YoriLibInitializeListHead(&YoriLibPool.ArenaList);
+
+    if (GetEnvironmentVariable(_T("YORIPOOLSTATS"), NULL, 0) > 0) {
+        YoriLibPool.DisplayStatistics = TRUE;
+    }
+
+    YoriLibPool.Enabled = TRUE;
+    return TRUE;
+#endif
+}
+
+/**
+ Return the cached blocks and counters of a thread to the process wide
+ state and free the thread's state.  This is called with the pool mutex
+ held once the thread has exited.
+
+ @param Thread Pointer to the thread state to reclaim.
+ */
+VOID
+YoriLibPoolReclaimThread(
+    __in PYORI_LIB_POOL_THREAD Thread
+    )
+{
+    DWORD Index;
+    PYORI_LIB_POOL_FREE_BLOCK Block;
+    PYORI_LIB_POOL_FREE_BLOCK Next;
+    PYORI_LIB_POOL_CLASS Class;
+
+    for (Index = 0; Index < YORI_LIB_POOL_CLASS_COUNT; Index++) {
+        Class = &YoriLibPool.Classes[Index];
+        Block = Thread->FreeList[Index];
+        while (Block != NULL) {
+            Next = Block->Next;
+            Block->Next = Class->FreeList;
+            Class->FreeList = Block;
+            Class->FreeCount++;
+            Block = Next;
+        }
+
+        YoriLibPool.RetiredStats[Index].Allocations += Thread->Stats[Index].Allocations;
+        YoriLibPool.RetiredStats[Index].Frees += Thread->Stats[Index].Frees;
+    }
+
+    YoriLibRemoveListItem(&Thread->ListEntry);
+    CloseHandle(Thread->ThreadHandle);
+    HeapFree(GetProcessHeap(), 0, Thread);
+}
+
+/**
+ Reclaim the state of every thread that has exited.  This is called with
+ the pool mutex held.
+ */
+VOID
+YoriLibPoolReclaimExitedThreads(VOID)
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PYORI_LIST_ENTRY NextEntry;
+    PYORI_LIB_POOL_THREAD Thread;
+
+    ListEntry = YoriLibGetNextListEntry(&YoriLibPool.ThreadList, NULL);
+    while (ListEntry != NULL) {
+        NextEntry = YoriLibGetNextListEntry(&YoriLibPool.ThreadList, ListEntry);
+        Thread = CONTAINING_RECORD(ListEntry, YORI_LIB_POOL_THREAD, ListEntry);
+        if (WaitForSingleObject(Thread->ThreadHandle, 0) == WAIT_OBJECT_0) {
+            YoriLibPoolReclaimThread(Thread);
+        }
+        ListEntry = NextEntry;
+    }
+}
+
+/**
+ Return the pool state for the current thread, allocating it if this thread
+ has not used the pool before.
+
+ @return Pointer to the thread state, or NULL if it could not be allocated.
+ */
+PYORI_LIB_POOL_THREAD
+YoriLibPoolGetThread(VOID)
+{
+    PYORI_LIB_POOL_THREAD Thread;
+
+    Thread = TlsGetValue(YoriLibPool.TlsIndex);
+    if (Thread != NULL) {
+        return Thread;
+    }
+
+    //
+    //  This state is allocated from the process heap directly since it is
+    //  needed in order to allocate from the pool.
+    //
+
+    Thread = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(YORI_LIB_POOL_THREAD));
+    if (Thread == NULL) {
+        return NULL;
+    }
+
+    if (!DuplicateHandle(GetCurrentProcess(),
+                         GetCurrentThread(),
+                         GetCurrentProcess(),
+                         &Thread->ThreadHandle,
+                         SYNCHRONIZE,
+                         FALSE,
+                         0)) {
+
+        HeapFree(GetProcessHeap(), 0, Thread);
+        return NULL;
+    }
+
+    if (!TlsSetValue(YoriLibPool.TlsIndex, Thread)) {
+        CloseHandle(Thread->ThreadHandle);
+        HeapFree(GetProcessHeap(), 0, Thread);
+        return NULL;
+    }
+
+    WaitForSingleObject(YoriLibPool.Mutex, INFINITE);
+    YoriLibAppendList(&YoriLibPool.ThreadList, &Thread->ListEntry);
+    ReleaseMutex(YoriLibPool.Mutex);
+
+    return Thread;
+}
+
+/**
+ Commit the next slab within the region for use by a size class.  This is
+ called with the pool mutex held.
+
+ @param ClassIndex The size class that the slab should contain.
+
+ @return TRUE to indicate a slab was committed, FALSE if the region is
+         exhausted or memory could not be committed.
+ */
+__success(return)
+BOOL
+YoriLibPoolCommitSlab(
+    __in DWORD ClassIndex
+    )
+{
+    PUCHAR Slab;
+    PYORI_LIB_POOL_CLASS Class;
+
+    if (YoriLibPool.SlabsCommitted >= YORI_LIB_POOL_SLAB_COUNT) {
+        return FALSE;
+    }
+
+    Slab = YoriLibPool.RegionBase + YoriLibPool.SlabsCommitted * YORI_LIB_POOL_SLAB_SIZE;
+    if (VirtualAlloc(Slab, YORI_LIB_POOL_SLAB_SIZE, MEM_COMMIT, PAGE_READWRITE) == NULL) {
+        return FALSE;
+    }
+
+    Class = &YoriLibPool.Classes[ClassIndex];
+    YoriLibPool.SlabClass[YoriLibPool.SlabsCommitted] = (UCHAR)ClassIndex;
+    YoriLibPool.SlabsCommitted++;
+    Class->SlabCount++;
+    Class->CarveNext = Slab;
+    Class->CarveRemaining = YORI_LIB_POOL_SLAB_SIZE / YoriLibPoolClassSizes[ClassIndex];
+
+    return TRUE;
+}
+
+/**
+ Move a batch of free blocks into a thread's cache for a size class.  Blocks
+ are taken from the process wide list where possible, then from the cached
+ blocks of exited threads, and finally from never allocated blocks in the
+ most recent slab or a new slab.
+
+ @param Thread Pointer to the current thread's state.
+
+ @param ClassIndex The size class to refill.
+
+ @return TRUE to indicate at least one block was added to the thread's
+         cache, FALSE if no blocks are available.
+ */
+__success(return)
+BOOL
+YoriLibPoolRefill(
+    __in PYORI_LIB_POOL_THREAD Thread,
+    __in DWORD ClassIndex
+    )
+{
+    PYORI_LIB_POOL_CLASS Class;
+    PYORI_LIB_POOL_FREE_BLOCK Block;
+    DWORD Moved;
+
+    Class = &YoriLibPool.Classes[ClassIndex];
+    Moved = 0;
+
+    WaitForSingleObject(YoriLibPool.Mutex, INFINITE);
+
+    if (Class->FreeList == NULL && Class->CarveRemaining == 0) {
+        YoriLibPoolReclaimExitedThreads();
+    }
+
+    while (Moved < YORI_LIB_POOL_TRANSFER_BATCH && Class->FreeList != NULL) {
+        Block = Class->FreeList;
+        Class->FreeList = Block->Next;
+        Class->FreeCount--;
+        Block->Next = Thread->FreeList[ClassIndex];
+        Thread->FreeList[ClassIndex] = Block;
+        Moved++;
+    }
+
+    while (Moved < YORI_LIB_POOL_TRANSFER_BATCH) {
+        if (Class->CarveRemaining == 0) {
+            if (Moved > 0 || !YoriLibPoolCommitSlab(ClassIndex)) {
+                break;
+            }
+        }
+
+        Block = (PYORI_LIB_POOL_FREE_BLOCK)Class->CarveNext;
+        Class->CarveNext = Class->CarveNext + YoriLibPoolClassSizes[ClassIndex];
+        Class->CarveRemaining--;
+        Block->Next = Thread->FreeList[ClassIndex];
+        Thread->FreeList[ClassIndex] = Block;
+        Moved++;
+    }
+
+    ReleaseMutex(YoriLibPool.Mutex);
+
+    Thread->FreeCount[ClassIndex] += Moved;
+    if (Moved == 0) {
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/**
+ Allocate memory from the pool.  This is called by @ref YoriLibMalloc and
+ should not be called directly.
+
+ @param Bytes The number of bytes to allocate.
+
+ @return A pointer to the allocation, or NULL if the pool is not enabled,
+         the allocation is too large for the pool, or the pool has no
+         memory available.  The caller should allocate from the process
+         heap in this case.
+ */
+PVOID
+YoriLibPoolMalloc(
+    __in YORI_ALLOC_SIZE_T Bytes
+    )
+{
+    PYORI_LIB_POOL_THREAD Thread;
+    PYORI_LIB_POOL_FREE_BLOCK Block;
+    DWORD ClassIndex;
+
+    if (!YoriLibPool.Enabled || Bytes > YORI_LIB_POOL_MAX_BLOCK_SIZE) {
+        return NULL;
+    }
+
+    ClassIndex = YoriLibPoolClassForGranule[(Bytes + YORI_LIB_POOL_GRANULARITY - 1) / YORI_LIB_POOL_GRANULARITY];
+
+    Thread = YoriLibPoolGetThread();
+    if (Thread == NULL) {
+        YoriLibPool.FallbackAllocations++;
+        return NULL;
+    }
+
+    Block = Thread->FreeList[ClassIndex];
+    if (Block == NULL) {
+        if (!YoriLibPoolRefill(Thread, ClassIndex)) {
+            YoriLibPool.FallbackAllocations++;
+            return NULL;
+        }
+        Block = Thread->FreeList[ClassIndex];
+    }
+
+    Thread->FreeList[ClassIndex] = Block->Next;
+    Thread->FreeCount[ClassIndex]--;
+    Thread->Stats[ClassIndex].Allocations++;
+
+    return Block;
+}
+
+/**
+ Free memory if it was allocated from the pool.  This is called by
+ @ref YoriLibFree and should not be called directly.
+
+ @param Ptr The memory to free.
+
+ @return TRUE to indicate the memory was allocated from the pool and has been
+         freed, FALSE if the memory was not allocated from the pool.
+ */
+__success(return)
+BOOL
+YoriLibPoolFree(
+    __in PVOID Ptr
+    )
+{
+    PYORI_LIB_POOL_THREAD Thread;
+    PYORI_LIB_POOL_FREE_BLOCK Block;
+    PYORI_LIB_POOL_CLASS Class;
+    DWORD_PTR Offset;
+    DWORD ClassIndex;
+    DWORD Moved;
+
+    if (!YoriLibPool.Enabled) {
+        return FALSE;
+    }
+
+    //
+    //  If Ptr is below the region this wraps to a large value, so a single
+    //  comparison checks both bounds.
+    //
+
+    Offset = (DWORD_PTR)Ptr - (DWORD_PTR)YoriLibPool.RegionBase;
+    if (Offset >= YORI_LIB_POOL_REGION_SIZE) {
+        return FALSE;
+    }
+
+    ClassIndex = YoriLibPool.SlabClass[Offset / YORI_LIB_POOL_SLAB_SIZE];
+    ASSERT((Offset % YORI_LIB_POOL_SLAB_SIZE) % YoriLibPoolClassSizes[ClassIndex] == 0);
+
+    Block = (PYORI_LIB_POOL_FREE_BLOCK)Ptr;
+    Class = &YoriLibPool.Classes[ClassIndex];
+
+    Thread = YoriLibPoolGetThread();
+    if (Thread == NULL) {
+        WaitForSingleObject(YoriLibPool.Mutex, INFINITE);
+        Block->Next = Class->FreeList;
+        Class->FreeList = Block;
+        Class->FreeCount++;
+        YoriLibPool.RetiredStats[ClassIndex].Frees++;
+        ReleaseMutex(YoriLibPool.Mutex);
+        return TRUE;
+    }
+
+    Block->Next = Thread->FreeList[ClassIndex];
+    Thread->FreeList[ClassIndex] = Block;
+    Thread->FreeCount[ClassIndex]++;
+    Thread->Stats[ClassIndex].Frees++;
+
+    //
+    //  If this thread is freeing blocks allocated elsewhere, its cache grows
+    //  without bound, so return a batch for other threads to use.
+    //
+
+    if (Thread->FreeCount[ClassIndex] > YORI_LIB_POOL_THREAD_CACHE_LIMIT) {
+        WaitForSingleObject(YoriLibPool.Mutex, INFINITE);
+        for (Moved = 0; Moved < YORI_LIB_POOL_TRANSFER_BATCH; Moved++) {
+            Block = Thread->FreeList[ClassIndex];
+            Thread->FreeList[ClassIndex] = Block->Next;
+            Block->Next = Class->FreeList;
+            Class->FreeList = Block;
+        }
+        Class->FreeCount += YORI_LIB_POOL_TRANSFER_BATCH;
+        ReleaseMutex(YoriLibPool.Mutex);
+        Thread->FreeCount[ClassIndex] -= YORI_LIB_POOL_TRANSFER_BATCH;
+    }
+
+    return TRUE;
+}
+
+/**
+ Display statistics for each size class of the pool and each arena that is
+ currently initialized.  This is called by @ref YoriLibDisplayMemoryUsage
+ and only displays output if the pool is enabled and the YORIPOOLSTATS
+ environment variable was set when it was enabled.
+ */
+VOID
+YoriLibPoolDisplayStatistics(VOID)
+{
+    YORI_LIB_POOL_CLASS_STATS Stats;
+    PYORI_LIST_ENTRY ListEntry;
+    PYORI_LIB_POOL_THREAD Thread;
+    PYORI_LIB_ARENA Arena;
+    DWORD Index;
+
+    if (!YoriLibPool.Enabled || !YoriLibPool.DisplayStatistics) {
+        return;
+    }
+
+    WaitForSingleObject(YoriLibPool.Mutex, INFINITE);
+
+    YoriLibOutput(YORI_LIB_OUTPUT_STDERR,
+                  _T("Pool: %i of %i slabs committed, %lli heap fallbacks\n"),
+                  YoriLibPool.SlabsCommitted,
+                  YORI_LIB_POOL_SLAB_COUNT,
+                  YoriLibPool.FallbackAllocations);
+
+    for (Index = 0; Index < YORI_LIB_POOL_CLASS_COUNT; Index++) {
+        Stats.Allocations = YoriLibPool.RetiredStats[Index].Allocations;
+        Stats.Frees = YoriLibPool.RetiredStats[Index].Frees;
+
+        //
+        //  Other threads may be updating their counters while these are
+        //  read, so the result is approximate while they are running.
+        //
+
+        ListEntry = YoriLibGetNextListEntry(&YoriLibPool.ThreadList, NULL);
+        while (ListEntry != NULL) {
+            Thread = CONTAINING_RECORD(ListEntry, YORI_LIB_POOL_THREAD, ListEntry);
+            Stats.Allocations += Thread->Stats[Index].Allocations;
+            Stats.Frees += Thread->Stats[Index].Frees;
+            ListEntry = YoriLibGetNextListEntry(&YoriLibPool.ThreadList, ListEntry);
+        }
+
+        if (Stats.Allocations == 0 && YoriLibPool.Classes[Index].SlabCount == 0) {
+            continue;
+        }
+
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR,
+                      _T("Pool %i bytes: %i slabs, %lli allocations, %lli frees, %lli in use\n"),
+                      YoriLibPoolClassSizes[Index],
+                      YoriLibPool.Classes[Index].SlabCount,
+                      Stats.Allocations,
+                      Stats.Frees,
+                      Stats.Allocations - Stats.Frees);
+    }
+
+    YoriLibOutput(YORI_LIB_OUTPUT_STDERR,
+                  _T("Arenas: %i initialized, largest %lli bytes\n"),
+                  YoriLibPool.ArenasInitialized,
+                  YoriLibPool.ArenaPeakBytes);
+
+    ListEntry = YoriLibGetNextListEntry(&YoriLibPool.ArenaList, NULL);
+    while (ListEntry != NULL) {
+        Arena = CONTAINING_RECORD(ListEntry, YORI_LIB_ARENA, ArenaListEntry);
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR,
+                      _T("Arena %hs: %i chunks, %lli allocations, %lli bytes, peak %lli bytes\n"),
+                      Arena->Name,
+                      Arena->ChunkCount,
+                      Arena->Allocations,
+                      Arena->BytesAllocated,
+                      Arena->PeakBytesAllocated);
+        ListEntry = YoriLibGetNextListEntry(&YoriLibPool.ArenaList, ListEntry);
+    }
+
+    ReleaseMutex(YoriLibPool.Mutex);
+}
+
+/**
+ A structure preceding each chunk of memory allocated by an arena.
+ */
+typedef struct _YORI_LIB_ARENA_CHUNK {
+
+    /**
+     The list of chunks within the arena.  Paired with
+     YORI_LIB_ARENA::ChunkList.
+     */
+    YORI_LIST_ENTRY ListEntry;
+
+    /**
+     Ensure the data following the header is aligned for any type, since
+     the list entry alone may not be a multiple of the alignment.
+     */
+    PVOID ReservedForAlignment[2];
+} YORI_LIB_ARENA_CHUNK, *PYORI_LIB_ARENA_CHUNK;
+
+/**
+ The size of the header preceding each arena chunk, rounded up to the
+ arena alignment.
+ */
+#define YORI_LIB_ARENA_CHUNK_HEADER_SIZE \
+    ((sizeof(YORI_LIB_ARENA_CHUNK) + YORI_LIB_ARENA_ALIGNMENT - 1) & ~(YORI_LIB_ARENA_ALIGNMENT - 1))
+
+/**
+ Initialize an arena.  Allocations from the arena are released together by
+ @ref YoriLibArenaReset or @ref YoriLibArenaCleanup.  The arena is not
+ synchronized, so a caller using it from multiple threads must provide its
+ own synchronization.
+
+ @param Arena Pointer to the arena to initialize.
+
+ @param Name Pointer to a constant string describing the arena, used when
+        displaying statistics.
+
+ @param ChunkSize The number of bytes to allocate from the heap at a time.
+        If zero, a default is used.
+ */
+VOID
+YoriLibArenaInitialize(
+    __out PYORI_LIB_ARENA Arena,
+    __in LPCSTR Name,
+    __in YORI_ALLOC_SIZE_T ChunkSize
+    )
+{
+    ZeroMemory(Arena, sizeof(YORI_LIB_ARENA));
+    YoriLibInitializeListHead(&Arena->ChunkList);
+    YoriLibInitializeListHead(&Arena->ArenaListEntry);
+    Arena->Name = Name;
+    if (ChunkSize == 0) {
+        ChunkSize = YORI_LIB_ARENA_DEFAULT_CHUNK_SIZE;
+    }
+    if (ChunkSize < YORI_LIB_ARENA_CHUNK_HEADER_SIZE + YORI_LIB_ARENA_ALIGNMENT) {
+        ChunkSize = (YORI_ALLOC_SIZE_T)(YORI_LIB_ARENA_CHUNK_HEADER_SIZE + YORI_LIB_ARENA_ALIGNMENT);
+    }
+    Arena->ChunkSize = ChunkSize;
+
+    if (YoriLibPool.Enabled) {
+        WaitForSingleObject(YoriLibPool.Mutex, INFINITE);
+        YoriLibAppendList(&YoriLibPool.ArenaList, &Arena->ArenaListEntry);
+        YoriLibPool.ArenasInitialized++;
+        ReleaseMutex(YoriLibPool.Mutex);
+    }
+}
+
+/**
+ Allocate memory from an arena.  The memory is released when the arena is
+ reset or cleaned up and must not be passed to @ref YoriLibFree.
+
+ @param Arena Pointer to the arena to allocate from.
+
+ @param Bytes The number of bytes to allocate.
+
+ @return Pointer to the allocation, or NULL on failure.
+ */
+PVOID
+YoriLibArenaAlloc(
+    __inout PYORI_LIB_ARENA Arena,
+    __in YORI_ALLOC_SIZE_T Bytes
+    )
+{
+    PYORI_LIB_ARENA_CHUNK Chunk;
+    YORI_ALLOC_SIZE_T AlignedBytes;
+    PUCHAR Alloc;
+
+    AlignedBytes = (YORI_ALLOC_SIZE_T)((Bytes + YORI_LIB_ARENA_ALIGNMENT - 1) & ~(YORI_LIB_ARENA_ALIGNMENT - 1));
+    if (AlignedBytes < Bytes ||
+        AlignedBytes > YORI_MAX_ALLOC_SIZE - YORI_LIB_ARENA_CHUNK_HEADER_SIZE) {
+
+        return NULL;
+    }
+
+    if (AlignedBytes > Arena->BytesRemaining) {
+
+        //
+        //  Large allocations get a chunk of their own so the remainder of
+        //  the current chunk is not wasted.
+        //
+
+        if (AlignedBytes > (Arena->ChunkSize - YORI_LIB_ARENA_CHUNK_HEADER_SIZE) / 4) {
+            Chunk = YoriLibMalloc((YORI_ALLOC_SIZE_T)(YORI_LIB_ARENA_CHUNK_HEADER_SIZE + AlignedBytes));
+            if (Chunk == NULL) {
+                return NULL;
+            }
+            YoriLibAppendList(&Arena->ChunkList, &Chunk->ListEntry);
+            Arena->ChunkCount++;
+            Alloc = (PUCHAR)Chunk + YORI_LIB_ARENA_CHUNK_HEADER_SIZE;
+            goto Allocated;
+        }
+
+        Chunk = YoriLibMalloc(Arena->ChunkSize);
+        if (Chunk == NULL) {
+            return NULL;
+        }
+        YoriLibAppendList(&Arena->ChunkList, &Chunk->ListEntry);
+        Arena->ChunkCount++;
+        Arena->Next = (PUCHAR)Chunk + YORI_LIB_ARENA_CHUNK_HEADER_SIZE;
+        Arena->BytesRemaining = (YORI_ALLOC_SIZE_T)(Arena->ChunkSize - YORI_LIB_ARENA_CHUNK_HEADER_SIZE);
+    }
+
+    Alloc = Arena->Next;
+    Arena->Next = Arena->Next + AlignedBytes;
+    Arena->BytesRemaining = Arena->BytesRemaining - AlignedBytes;
+
+Allocated:
+
+    Arena->Allocations++;
+    Arena->BytesAllocated += Bytes;
+    if (Arena->BytesAllocated > Arena->PeakBytesAllocated) {
+        Arena->PeakBytesAllocated = Arena->BytesAllocated;
+    }
+
+    return Alloc;
+}
+
+/**
+ Release every allocation made from an arena, leaving the arena ready for
+ further allocations.
+
+ @param Arena Pointer to the arena to reset.
+ */
+VOID
+YoriLibArenaReset(
+    __inout PYORI_LIB_ARENA Arena
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PYORI_LIB_ARENA_CHUNK Chunk;
+
+    ListEntry = YoriLibGetNextListEntry(&Arena->ChunkList, NULL);
+    while (ListEntry != NULL) {
+        Chunk = CONTAINING_RECORD(ListEntry, YORI_LIB_ARENA_CHUNK, ListEntry);
+        ListEntry = YoriLibGetNextListEntry(&Arena->ChunkList, ListEntry);
+        YoriLibRemoveListItem(&Chunk->ListEntry);
+        YoriLibFree(Chunk);
+    }
+
+    Arena->Next = NULL;
+    Arena->BytesRemaining = 0;
+    Arena->ChunkCount = 0;
+    Arena->BytesAllocated = 0;
+}
+
+/**
+ Release every allocation made from an arena and stop tracking its
+ statistics.  The arena must be initialized again before further use.
+
+ @param Arena Pointer to the arena to clean up.
+ */
+VOID
+YoriLibArenaCleanup(
+    __inout PYORI_LIB_ARENA Arena
+    )
+{
+    YoriLibArenaReset(Arena);
+
+    if (YoriLibPool.Enabled) {
+        WaitForSingleObject(YoriLibPool.Mutex, INFINITE);
+        YoriLibRemoveListItem(&Arena->ArenaListEntry);
+        if (Arena->PeakBytesAllocated > YoriLibPool.ArenaPeakBytes) {
+            YoriLibPool.ArenaPeakBytes = Arena->PeakBytesAllocated;
+        }
+        ReleaseMutex(YoriLibPool.Mutex);
+    }
+}
+
+// vim:sw=4:ts=4:et:
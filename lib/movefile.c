@@ -271,5 +271,242 @@ YoriLibCopyFile(
     return Error;
 }
 
+/**
+ The largest range to clone in a single request.  This is a multiple of any
+ cluster size.
+ */
+#define YORI_LIB_CLONE_CHUNK_SIZE (1024 * 1024 * 1024)
+
+/**
+ Create a copy of a file by sharing its clusters with the new file, so no
+ data is read or written.  This requires the source and destination to be
+ on the same ReFS volume.  Only the default data stream, attributes and
+ last write time are copied.  The clone is created under a temporary name
+ in the destination directory and renamed over the destination once it is
+ complete, so an existing destination is not modified if cloning fails.
+
+ @param SourceFile The source file name, expected to be NULL terminated.
+
+ @param DestFile The fully qualified destination file name, expected to be
+        NULL terminated.
+
+ @return The Win32 error code, possibly ERROR_SUCCESS or appropriate error
+         on failure.  ERROR_NOT_SUPPORTED indicates the source volume cannot
+         clone files, or that the destination is on a different volume.
+ */
+DWORD
+YoriLibCloneFile(
+    __in PYORI_STRING SourceFile,
+    __in PYORI_STRING DestFile
+    )
+{
+    HANDLE SourceHandle;
+    HANDLE DestHandle;
+    HANDLE DestDirHandle;
+    BY_HANDLE_FILE_INFORMATION SourceInfo;
+    BY_HANDLE_FILE_INFORMATION DestDirInfo;
+    REFS_VOLUME_DATA_BUFFER VolumeData;
+    YORI_STRING DestDir;
+    YORI_STRING TempPrefix;
+    YORI_STRING TempFile;
+    LPTSTR FinalSeperator;
+    DUPLICATE_EXTENTS_DATA Extents;
+    LARGE_INTEGER FileSize;
+    LONGLONG BytesRemaining;
+    DWORD BytesReturned;
+    DWORD Error;
+
+    ASSERT(YoriLibIsStringNullTerminated(SourceFile));
+    ASSERT(YoriLibIsStringNullTerminated(DestFile));
+
+    SourceHandle = CreateFile(SourceFile->StartOfString,
+                              GENERIC_READ,
+                              FILE_SHARE_READ | FILE_SHARE_DELETE,
+                              NULL,
+                              OPEN_EXISTING,
+                              FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OPEN_NO_RECALL,
+                              NULL);
+
+    if (SourceHandle == INVALID_HANDLE_VALUE) {
+        return GetLastError();
+    }
+
+    if (!GetFileInformationByHandle(SourceHandle, &SourceInfo)) {
+        Error = GetLastError();
+        CloseHandle(SourceHandle);
+        return Error;
+    }
+
+    //
+    //  Only ReFS can clone, so if this isn't ReFS, fail before touching the
+    //  destination.  The cluster size is needed to align clone requests.
+    //
+
+    if ((SourceInfo.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0 ||
+        !DeviceIoControl(SourceHandle, FSCTL_GET_REFS_VOLUME_DATA, NULL, 0, &VolumeData, sizeof(VolumeData), &BytesReturned, NULL) ||
+        VolumeData.BytesPerCluster == 0 ||
+        (YORI_LIB_CLONE_CHUNK_SIZE % VolumeData.BytesPerCluster) != 0) {
+
+        CloseHandle(SourceHandle);
+        return ERROR_NOT_SUPPORTED;
+    }
+
+    //
+    //  Clusters can only be shared within a volume.  Check that the
+    //  destination directory is on the same volume as the source before
+    //  creating anything there.
+    //
+
+    FinalSeperator = YoriLibFindRightMostCharacter(DestFile, '\\');
+    if (FinalSeperator == NULL) {
+        CloseHandle(SourceHandle);
+        return ERROR_NOT_SUPPORTED;
+    }
+
+    YoriLibInitEmptyString(&DestDir);
+    if (!YoriLibAllocateString(&DestDir, (YORI_ALLOC_SIZE_T)(FinalSeperator - DestFile->StartOfString) + 2)) {
+        CloseHandle(SourceHandle);
+        return ERROR_NOT_ENOUGH_MEMORY;
+    }
+
+    DestDir.LengthInChars = (YORI_ALLOC_SIZE_T)(FinalSeperator - DestFile->StartOfString);
+    memcpy(DestDir.StartOfString, DestFile->StartOfString, DestDir.LengthInChars * sizeof(TCHAR));
+
+    //
+    //  If the directory is the root, its name requires a trailing
+    //  seperator to open it, but the temporary name adds its own.
+    //
+
+    DestDir.StartOfString[DestDir.LengthInChars] = '\\';
+    DestDir.StartOfString[DestDir.LengthInChars + 1] = '\0';
+
+    DestDirHandle = CreateFile(DestDir.StartOfString,
+                               FILE_READ_ATTRIBUTES,
+                               FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                               NULL,
+                               OPEN_EXISTING,
+                               FILE_FLAG_BACKUP_SEMANTICS,
+                               NULL);
+
+    DestDir.StartOfString[DestDir.LengthInChars] = '\0';
+
+    if (DestDirHandle == INVALID_HANDLE_VALUE) {
+        Error = GetLastError();
+        YoriLibFreeStringContents(&DestDir);
+        CloseHandle(SourceHandle);
+        return Error;
+    }
+
+    if (!GetFileInformationByHandle(DestDirHandle, &DestDirInfo)) {
+        Error = GetLastError();
+        CloseHandle(DestDirHandle);
+        YoriLibFreeStringContents(&DestDir);
+        CloseHandle(SourceHandle);
+        return Error;
+    }
+
+    CloseHandle(DestDirHandle);
+
+    if (DestDirInfo.dwVolumeSerialNumber != SourceInfo.dwVolumeSerialNumber) {
+        YoriLibFreeStringContents(&DestDir);
+        CloseHandle(SourceHandle);
+        return ERROR_NOT_SUPPORTED;
+    }
+
+    YoriLibConstantString(&TempPrefix, _T("YCLN"));
+    YoriLibInitEmptyString(&TempFile);
+    if (!YoriLibGetTempFileName(&DestDir, &TempPrefix, &DestHandle, &TempFile)) {
+        Error = GetLastError();
+        YoriLibFreeStringContents(&DestDir);
+        CloseHandle(SourceHandle);
+        if (Error == ERROR_SUCCESS) {
+            Error = ERROR_FILE_EXISTS;
+        }
+        return Error;
+    }
+
+    YoriLibFreeStringContents(&DestDir);
+
+    Error = ERROR_SUCCESS;
+    if (SourceInfo.dwFileAttributes & FILE_ATTRIBUTE_SPARSE_FILE) {
+        if (!DeviceIoControl(DestHandle, FSCTL_SET_SPARSE, NULL, 0, NULL, 0, &BytesReturned, NULL)) {
+            Error = GetLastError();
+        }
+    }
+
+    //
+    //  The target must be large enough to contain the cloned range before
+    //  the clone is requested.
+    //
+
+    FileSize.LowPart = SourceInfo.nFileSizeLow;
+    FileSize.HighPart = SourceInfo.nFileSizeHigh;
+    if (Error == ERROR_SUCCESS) {
+        if (SetFilePointer(DestHandle, FileSize.LowPart, &FileSize.HighPart, FILE_BEGIN) == INVALID_SET_FILE_POINTER &&
+            GetLastError() != NO_ERROR) {
+
+            Error = GetLastError();
+        } else if (!SetEndOfFile(DestHandle)) {
+            Error = GetLastError();
+        }
+    }
+
+    //
+    //  Clone ranges must be cluster aligned, so round the final range up.
+    //  The file system only shares clusters up to the end of the file.
+    //
+
+    ZeroMemory(&Extents, sizeof(Extents));
+    Extents.FileHandle = SourceHandle;
+    BytesRemaining = FileSize.QuadPart + VolumeData.BytesPerCluster - 1;
+    BytesRemaining = BytesRemaining - (BytesRemaining % VolumeData.BytesPerCluster);
+
+    while (Error == ERROR_SUCCESS && BytesRemaining > 0) {
+        Extents.ByteCount.QuadPart = BytesRemaining;
+        if (Extents.ByteCount.QuadPart > YORI_LIB_CLONE_CHUNK_SIZE) {
+            Extents.ByteCount.QuadPart = YORI_LIB_CLONE_CHUNK_SIZE;
+        }
+
+        if (!DeviceIoControl(DestHandle, FSCTL_DUPLICATE_EXTENTS_TO_FILE, &Extents, sizeof(Extents), NULL, 0, &BytesReturned, NULL)) {
+            Error = GetLastError();
+            break;
+        }
+
+        Extents.SourceFileOffset.QuadPart = Extents.SourceFileOffset.QuadPart + Extents.ByteCount.QuadPart;
+        Extents.TargetFileOffset.QuadPart = Extents.TargetFileOffset.QuadPart + Extents.ByteCount.QuadPart;
+        BytesRemaining = BytesRemaining - Extents.ByteCount.QuadPart;
+    }
+
+    if (Error == ERROR_SUCCESS) {
+        SetFileTime(DestHandle, NULL, NULL, &SourceInfo.ftLastWriteTime);
+    }
+
+    CloseHandle(SourceHandle);
+    CloseHandle(DestHandle);
+
+    //
+    //  Only the temporary file created above is ever deleted, so a
+    //  failure leaves any existing destination untouched.
+    //
+
+    if (Error == ERROR_SUCCESS &&
+        !MoveFileEx(TempFile.StartOfString, DestFile->StartOfString, MOVEFILE_REPLACE_EXISTING)) {
+
+        Error = GetLastError();
+    }
+
+    if (Error != ERROR_SUCCESS) {
+        DeleteFile(TempFile.StartOfString);
+        YoriLibFreeStringContents(&TempFile);
+        return Error;
+    }
+
+    YoriLibFreeStringContents(&TempFile);
+
+    SetFileAttributes(DestFile->StartOfString, SourceInfo.dwFileAttributes & (FILE_ATTRIBUTE_READONLY | FILE_ATTRIBUTE_HIDDEN | FILE_ATTRIBUTE_SYSTEM | FILE_ATTRIBUTE_ARCHIVE | FILE_ATTRIBUTE_NOT_CONTENT_INDEXED));
+
+    return ERROR_SUCCESS;
+}
+
 
 // vim:sw=4:ts=4:et:
@@ -0,0 +1,1286 @@
+/**
+ * @file lib/ntfsscan.c
+ *
+ * Yori routines to load the contents of an NTFS volume by reading its MFT
+ * directly
+ *
+ * Copyright (c) 2026 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "yoripch.h"
+#include "yorilib.h"
+
+/**
+ The signature at the start of each file record, "FILE".
+ */
+#define YORILIB_NTFS_FILE_SIGNATURE           0x454C4946
+
+/**
+ Set in a file record header if the record is allocated.
+ */
+#define YORILIB_NTFS_FILE_RECORD_IN_USE       0x0001
+
+/**
+ Set in a file record header if the record contains a file name index,
+ meaning it describes a directory.
+ */
+#define YORILIB_NTFS_FILE_RECORD_DIRECTORY    0x0002
+
+/**
+ The attribute type code for $FILE_NAME.
+ */
+#define YORILIB_NTFS_ATTR_FILE_NAME           0x30
+
+/**
+ The attribute type code for $DATA.
+ */
+#define YORILIB_NTFS_ATTR_DATA                0x80
+
+/**
+ The attribute type code for $REPARSE_POINT.
+ */
+#define YORILIB_NTFS_ATTR_REPARSE_POINT       0xC0
+
+/**
+ The attribute type code indicating the end of the attributes in a record.
+ */
+#define YORILIB_NTFS_ATTR_END                 0xFFFFFFFF
+
+/**
+ Attribute flags indicating the attribute is compressed.
+ */
+#define YORILIB_NTFS_ATTR_FLAG_COMPRESSED     0x00FF
+
+/**
+ Attribute flag indicating the attribute is sparse.
+ */
+#define YORILIB_NTFS_ATTR_FLAG_SPARSE         0x8000
+
+/**
+ A $FILE_NAME namespace value indicating the name is only a short name.
+ These are skipped since the long name is also present.
+ */
+#define YORILIB_NTFS_FILE_NAME_DOS_ONLY       0x02
+
+/**
+ A flag within the file attributes of a $FILE_NAME indicating the file is
+ a directory.
+ */
+#define YORILIB_NTFS_FILE_NAME_INDEX_PRESENT  0x10000000
+
+/**
+ The record number of the root directory.
+ */
+#define YORILIB_NTFS_ROOT_RECORD              5
+
+/**
+ The number of bytes protected by each entry in a record's update sequence
+ array.
+ */
+#define YORILIB_NTFS_SEQUENCE_STRIDE          512
+
+/**
+ The number of bytes to read from the MFT in each I/O.
+ */
+#define YORILIB_NTFS_SCAN_READ_SIZE           (1024 * 1024)
+
+/**
+ The first file record number which describes user data.  Records below
+ this are NTFS metadata files or reserved, other than the root directory.
+ */
+#define YORILIB_NTFS_FIRST_USER_RECORD        24
+
+/**
+ The on disk header of an NTFS file record.
+ */
+typedef struct _YORILIB_NTFS_FILE_RECORD_HEADER {
+
+    /**
+     The signature, which should be YORILIB_NTFS_FILE_SIGNATURE.
+     */
+    DWORD Signature;
+
+    /**
+     The offset in bytes from the start of the record to the update
+     sequence array.
+     */
+    WORD UpdateSequenceOffset;
+
+    /**
+     The number of elements in the update sequence array, including the
+     sequence number itself.
+     */
+    WORD UpdateSequenceCount;
+
+    /**
+     The log sequence number of the last change to the record.
+     */
+    LONGLONG Lsn;
+
+    /**
+     The number of times this record has been reused.
+     */
+    WORD SequenceNumber;
+
+    /**
+     The number of references to this record from directory indexes.
+     */
+    WORD ReferenceCount;
+
+    /**
+     The offset in bytes from the start of the record to the first
+     attribute.
+     */
+    WORD FirstAttributeOffset;
+
+    /**
+     Flags for the record, including YORILIB_NTFS_FILE_RECORD_IN_USE.
+     */
+    WORD Flags;
+
+    /**
+     The number of bytes of the record which are in use.
+     */
+    DWORD FirstFreeByte;
+
+    /**
+     The number of bytes in the record.
+     */
+    DWORD BytesAvailable;
+
+    /**
+     If this record is an extension of another record, refers to the base
+     record.  Zero for base records.
+     */
+    LONGLONG BaseFileRecordSegment;
+} YORILIB_NTFS_FILE_RECORD_HEADER, *PYORILIB_NTFS_FILE_RECORD_HEADER;
+
+/**
+ The on disk header of an attribute within an NTFS file record.
+ */
+typedef struct _YORILIB_NTFS_ATTRIBUTE_HEADER {
+
+    /**
+     The type of the attribute.
+     */
+    DWORD TypeCode;
+
+    /**
+     The length of the attribute in bytes, including this header.
+     */
+    DWORD RecordLength;
+
+    /**
+     Zero if the attribute is resident, one if it is nonresident.
+     */
+    UCHAR FormCode;
+
+    /**
+     The length of the attribute name, in characters.
+     */
+    UCHAR NameLength;
+
+    /**
+     The offset from the start of the attribute to its name, in bytes.
+     */
+    WORD NameOffset;
+
+    /**
+     Attribute flags, including compression and sparse state.
+     */
+    WORD Flags;
+
+    /**
+     A unique identifier for the attribute within the file.
+     */
+    WORD Instance;
+
+    /**
+     Information that depends on whether the attribute is resident.
+     */
+    union {
+
+        /**
+         Information for a resident attribute.
+         */
+        struct {
+
+            /**
+             The length of the attribute value in bytes.
+             */
+            DWORD ValueLength;
+
+            /**
+             The offset from the start of the attribute to its value.
+             */
+            WORD ValueOffset;
+        } Resident;
+
+        /**
+         Information for a nonresident attribute.
+         */
+        struct {
+
+            /**
+             The first cluster of the attribute described by this extent.
+             */
+            LONGLONG LowestVcn;
+
+            /**
+             The last cluster of the attribute described by this extent.
+             */
+            LONGLONG HighestVcn;
+
+            /**
+             The offset from the start of the attribute to its mapping
+             pairs.
+             */
+            WORD MappingPairsOffset;
+
+            /**
+             The log base two of the number of clusters in a compression
+             unit.
+             */
+            UCHAR CompressionUnit;
+
+            /**
+             Reserved.
+             */
+            UCHAR Reserved[5];
+
+            /**
+             The number of bytes allocated for the attribute.
+             */
+            LONGLONG AllocatedLength;
+
+            /**
+             The logical size of the attribute in bytes.
+             */
+            LONGLONG FileSize;
+
+            /**
+             The number of bytes of valid data in the attribute.
+             */
+            LONGLONG ValidDataLength;
+
+            /**
+             The number of bytes actually allocated on disk.  Only present
+             for compressed or sparse attributes.
+             */
+            LONGLONG TotalAllocated;
+        } Nonresident;
+    } Form;
+} YORILIB_NTFS_ATTRIBUTE_HEADER, *PYORILIB_NTFS_ATTRIBUTE_HEADER;
+
+/**
+ The on disk value of a $FILE_NAME attribute.
+ */
+typedef struct _YORILIB_NTFS_FILE_NAME {
+
+    /**
+     The file reference of the parent directory.
+     */
+    LONGLONG ParentDirectory;
+
+    /**
+     Timestamps, which are only updated when the name changes and are not
+     used here.
+     */
+    LONGLONG Times[4];
+
+    /**
+     The allocation size, which is only updated when the name changes.
+     */
+    LONGLONG AllocatedLength;
+
+    /**
+     The file size, which is only updated when the name changes.
+     */
+    LONGLONG FileSize;
+
+    /**
+     File attributes, including YORILIB_NTFS_FILE_NAME_INDEX_PRESENT.
+     */
+    DWORD FileAttributes;
+
+    /**
+     The EA size or reparse tag.
+     */
+    DWORD PackedEaSize;
+
+    /**
+     The length of the name in characters.
+     */
+    UCHAR FileNameLength;
+
+    /**
+     The namespace of the name.
+     */
+    UCHAR Flags;
+
+    /**
+     The name itself.  This is not NULL terminated.
+     */
+    WCHAR FileName[1];
+} YORILIB_NTFS_FILE_NAME, *PYORILIB_NTFS_FILE_NAME;
+
+/**
+ A single contiguous range of the MFT on disk.
+ */
+typedef struct _YORILIB_NTFS_SCAN_EXTENT {
+
+    /**
+     The first cluster on the volume of this range.
+     */
+    LONGLONG Lcn;
+
+    /**
+     The number of clusters in this range.
+     */
+    LONGLONG ClusterCount;
+} YORILIB_NTFS_SCAN_EXTENT, *PYORILIB_NTFS_SCAN_EXTENT;
+
+/**
+ Ensure an array has space for at least the specified number of elements,
+ reallocating it if necessary.
+
+ @param Array On input, points to the existing array.  On successful
+        completion, updated to point to the array which may have been
+        reallocated.
+
+ @param ElementsAllocated On input, the number of elements in the array.  On
+        successful completion, updated to the number of elements in the
+        possibly reallocated array.
+
+ @param ElementsInUse The number of elements currently populated in the array.
+
+ @param ElementsRequired The number of elements required.
+
+ @param ElementSize The size of each element, in bytes.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriLibNtfsScanGrowArray(
+    __inout PVOID * Array,
+    __inout PDWORD ElementsAllocated,
+    __in DWORD ElementsInUse,
+    __in DWORD ElementsRequired,
+    __in DWORD ElementSize
+    )
+{
+    YORI_MAX_UNSIGNED_T Desired;
+    YORI_ALLOC_SIZE_T BytesToAllocate;
+    PVOID NewArray;
+
+    if (ElementsRequired <= *ElementsAllocated) {
+        return TRUE;
+    }
+
+    Desired = *ElementsAllocated;
+    Desired = Desired * 2;
+    if (Desired < 0x1000) {
+        Desired = 0x1000;
+    }
+    if (Desired < ElementsRequired) {
+        Desired = ElementsRequired;
+    }
+    if (Desired > (DWORD)-1) {
+        Desired = (DWORD)-1;
+    }
+
+    BytesToAllocate = YoriLibMaximumAllocationInRange((YORI_MAX_UNSIGNED_T)ElementsRequired * ElementSize, Desired * ElementSize);
+    if (BytesToAllocate == 0) {
+        return FALSE;
+    }
+
+    NewArray = YoriLibMalloc(BytesToAllocate);
+    if (NewArray == NULL) {
+        return FALSE;
+    }
+
+    if (*Array != NULL) {
+        if (ElementsInUse > 0) {
+            memcpy(NewArray, *Array, ElementsInUse * ElementSize);
+        }
+        YoriLibFree(*Array);
+    }
+
+    *Array = NewArray;
+    *ElementsAllocated = BytesToAllocate / ElementSize;
+    return TRUE;
+}
+
+/**
+ Read from a volume at a specified offset.
+
+ @param hVolume Handle to the volume.
+
+ @param Offset The offset, in bytes, to read from.  This must be sector
+        aligned.
+
+ @param Buffer Pointer to the buffer to read into.
+
+ @param Length The number of bytes to read.  This must be a multiple of the
+        sector size.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriLibNtfsScanReadVolume(
+    __in HANDLE hVolume,
+    __in LONGLONG Offset,
+    __out_bcount(Length) PUCHAR Buffer,
+    __in DWORD Length
+    )
+{
+    LARGE_INTEGER FilePosition;
+    DWORD BytesRead;
+
+    FilePosition.QuadPart = Offset;
+    if (SetFilePointer(hVolume, FilePosition.LowPart, &FilePosition.HighPart, FILE_BEGIN) == INVALID_SET_FILE_POINTER &&
+        GetLastError() != NO_ERROR) {
+
+        return FALSE;
+    }
+
+    if (!ReadFile(hVolume, Buffer, Length, &BytesRead, NULL)) {
+        return FALSE;
+    }
+
+    if (BytesRead != Length) {
+        SetLastError(ERROR_HANDLE_EOF);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ Validate a file record's update sequence array and restore the bytes it
+ protects.
+
+ @param Record Pointer to the file record.
+
+ @param BytesPerRecord The number of bytes in each file record.
+
+ @return TRUE if the record is intact, FALSE if it is not a file record or
+         was not completely written.
+ */
+BOOL
+YoriLibNtfsScanApplyFixups(
+    __inout PUCHAR Record,
+    __in DWORD BytesPerRecord
+    )
+{
+    PYORILIB_NTFS_FILE_RECORD_HEADER Header;
+    PWORD UpdateSequence;
+    PWORD SectorEnd;
+    DWORD Index;
+
+    Header = (PYORILIB_NTFS_FILE_RECORD_HEADER)Record;
+    if (Header->Signature != YORILIB_NTFS_FILE_SIGNATURE) {
+        return FALSE;
+    }
+
+    if (Header->UpdateSequenceCount == 0 ||
+        (DWORD)(Header->UpdateSequenceCount - 1) * YORILIB_NTFS_SEQUENCE_STRIDE > BytesPerRecord ||
+        (DWORD)Header->UpdateSequenceOffset + Header->UpdateSequenceCount * sizeof(WORD) > BytesPerRecord) {
+
+        return FALSE;
+    }
+
+    UpdateSequence = (PWORD)(Record + Header->UpdateSequenceOffset);
+
+    for (Index = 1; Index < (DWORD)Header->UpdateSequenceCount; Index++) {
+        SectorEnd = (PWORD)(Record + Index * YORILIB_NTFS_SEQUENCE_STRIDE - sizeof(WORD));
+        if (*SectorEnd != UpdateSequence[0]) {
+            return FALSE;
+        }
+        *SectorEnd = UpdateSequence[Index];
+    }
+
+    return TRUE;
+}
+
+/**
+ Add a name of a file to the scan results.
+
+ @param Scan Pointer to the scan results.
+
+ @param ChildIndex The record number of the file that has the name.
+
+ @param FileName Pointer to the $FILE_NAME attribute value.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriLibNtfsScanAddLink(
+    __inout PYORILIB_NTFS_SCAN Scan,
+    __in DWORD ChildIndex,
+    __in PYORILIB_NTFS_FILE_NAME FileName
+    )
+{
+    PYORILIB_NTFS_SCAN_LINK Link;
+    PYORILIB_NTFS_SCAN_RECORD Record;
+    LONGLONG ParentIndex;
+
+    ParentIndex = FileName->ParentDirectory & 0xFFFFFFFFFFFF;
+    if (ParentIndex >= Scan->RecordCount ||
+        ParentIndex == ChildIndex) {
+
+        return TRUE;
+    }
+
+    if (Scan->LinkCount == (DWORD)-1 ||
+        !YoriLibNtfsScanGrowArray((PVOID *)&Scan->Links, &Scan->LinksAllocated, Scan->LinkCount, Scan->LinkCount + 1, sizeof(YORILIB_NTFS_SCAN_LINK))) {
+        return FALSE;
+    }
+
+    Record = &Scan->Records[ChildIndex];
+    Link = &Scan->Links[Scan->LinkCount];
+    Link->ParentIndex = (DWORD)ParentIndex;
+    Link->ChildIndex = ChildIndex;
+    Link->NameOffset = 0;
+    Link->NameLength = 0;
+
+    //
+    //  Names are only retained for directories, which is sufficient to
+    //  construct the path to any directory while keeping memory usage
+    //  proportional to the number of directories on large volumes.
+    //
+
+    if (FileName->FileAttributes & YORILIB_NTFS_FILE_NAME_INDEX_PRESENT) {
+        if (Scan->NamesLength + FileName->FileNameLength < Scan->NamesLength ||
+            !YoriLibNtfsScanGrowArray((PVOID *)&Scan->Names, &Scan->NamesAllocated, Scan->NamesLength, Scan->NamesLength + FileName->FileNameLength, sizeof(WCHAR))) {
+            return FALSE;
+        }
+
+        memcpy(&Scan->Names[Scan->NamesLength], FileName->FileName, FileName->FileNameLength * sizeof(WCHAR));
+        Link->NameOffset = Scan->NamesLength;
+        Link->NameLength = FileName->FileNameLength;
+        Scan->NamesLength += FileName->FileNameLength;
+    }
+
+    Link->NextLink = Record->FirstLink;
+    Record->FirstLink = Scan->LinkCount;
+    if (Record->LinkCount < (WORD)-1) {
+        Record->LinkCount++;
+    }
+    Scan->LinkCount++;
+
+    return TRUE;
+}
+
+/**
+ Capture the sizes of a $DATA attribute into the record for its file.
+
+ @param Scan Pointer to the scan results.
+
+ @param Record Pointer to the record describing the file.
+
+ @param Attribute Pointer to the $DATA attribute.
+
+ @param Name Pointer to the name of the attribute.  This is not NULL
+        terminated; its length is in the attribute header.
+ */
+VOID
+YoriLibNtfsScanCaptureData(
+    __in PYORILIB_NTFS_SCAN Scan,
+    __inout PYORILIB_NTFS_SCAN_RECORD Record,
+    __in PYORILIB_NTFS_ATTRIBUTE_HEADER Attribute,
+    __in LPCWSTR Name
+    )
+{
+    LONGLONG FileSize;
+    LONGLONG CompressedSize;
+    YORI_STRING StreamName;
+
+    if (Attribute->FormCode == 0) {
+        FileSize = Attribute->Form.Resident.ValueLength;
+        CompressedSize = FileSize;
+    } else {
+
+        //
+        //  Only the first extent of an attribute describes its size.
+        //
+
+        if (Attribute->Form.Nonresident.LowestVcn != 0) {
+            return;
+        }
+
+        FileSize = Attribute->Form.Nonresident.FileSize;
+        CompressedSize = FileSize;
+        if ((Attribute->Flags & (YORILIB_NTFS_ATTR_FLAG_COMPRESSED | YORILIB_NTFS_ATTR_FLAG_SPARSE)) != 0 &&
+            (DWORD)Attribute->Form.Nonresident.MappingPairsOffset >= (DWORD)FIELD_OFFSET(YORILIB_NTFS_ATTRIBUTE_HEADER, Form.Nonresident.TotalAllocated) + sizeof(LONGLONG)) {
+
+            CompressedSize = Attribute->Form.Nonresident.TotalAllocated;
+        }
+    }
+
+    if (Attribute->NameLength == 0) {
+        Record->FileSize = FileSize;
+        if ((Record->Flags & YORILIB_NTFS_SCAN_RECORD_WOF_COMPRESSED) == 0) {
+            Record->CompressedSize = CompressedSize;
+        }
+        return;
+    }
+
+    //
+    //  WOF stores compressed file contents in a named stream, which is
+    //  not visible to applications, so report its size as the compressed
+    //  size of the file rather than as a stream.
+    //
+
+    YoriLibInitEmptyString(&StreamName);
+    StreamName.StartOfString = (LPWSTR)Name;
+    StreamName.LengthInChars = Attribute->NameLength;
+    if (YoriLibCompareStringLit(&StreamName, _T("WofCompressedData")) == 0) {
+        Record->Flags = (WORD)(Record->Flags | YORILIB_NTFS_SCAN_RECORD_WOF_COMPRESSED);
+        Record->CompressedSize = FileSize;
+        return;
+    }
+
+    Record->NamedStreamSize += FileSize;
+    Record->NamedStreamAllocatedSize += (FileSize + Scan->BytesPerCluster - 1) & ~((LONGLONG)Scan->BytesPerCluster - 1);
+}
+
+/**
+ Parse a single file record from the MFT and merge its contents into the
+ scan results.
+
+ @param Scan Pointer to the scan results.
+
+ @param Buffer Pointer to the file record.  This is modified to remove the
+        update sequence array.
+
+ @param RecordIndex The record number of this record.
+
+ @return TRUE to indicate success, FALSE to indicate a fatal failure.
+         Records which are corrupt or unused are skipped and do not
+         result in failure.
+ */
+__success(return)
+BOOL
+YoriLibNtfsScanProcessRecord(
+    __inout PYORILIB_NTFS_SCAN Scan,
+    __inout PUCHAR Buffer,
+    __in DWORD RecordIndex
+    )
+{
+    PYORILIB_NTFS_FILE_RECORD_HEADER Header;
+    PYORILIB_NTFS_ATTRIBUTE_HEADER Attribute;
+    PYORILIB_NTFS_SCAN_RECORD Record;
+    LONGLONG BaseIndex;
+    DWORD Offset;
+    DWORD EndOffset;
+    PUCHAR Value;
+    DWORD ValueLength;
+
+    Header = (PYORILIB_NTFS_FILE_RECORD_HEADER)Buffer;
+    if (Header->Signature != YORILIB_NTFS_FILE_SIGNATURE ||
+        (Header->Flags & YORILIB_NTFS_FILE_RECORD_IN_USE) == 0) {
+
+        return TRUE;
+    }
+
+    if (!YoriLibNtfsScanApplyFixups(Buffer, Scan->BytesPerRecord)) {
+        return TRUE;
+    }
+
+    //
+    //  Attributes in extension records belong to the base record.
+    //
+
+    BaseIndex = Header->BaseFileRecordSegment & 0xFFFFFFFFFFFF;
+    if (BaseIndex == 0) {
+        BaseIndex = RecordIndex;
+    } else if (BaseIndex >= Scan->RecordCount) {
+        return TRUE;
+    }
+
+    Record = &Scan->Records[BaseIndex];
+    if (BaseIndex == RecordIndex) {
+        Record->Flags = (WORD)(Record->Flags | YORILIB_NTFS_SCAN_RECORD_IN_USE);
+        if (Header->Flags & YORILIB_NTFS_FILE_RECORD_DIRECTORY) {
+            Record->Flags = (WORD)(Record->Flags | YORILIB_NTFS_SCAN_RECORD_DIRECTORY);
+        }
+    }
+
+    //
+    //  Metadata files are not visible in the namespace, so don't describe
+    //  them.
+    //
+
+    if (BaseIndex < YORILIB_NTFS_FIRST_USER_RECORD && BaseIndex != YORILIB_NTFS_ROOT_RECORD) {
+        return TRUE;
+    }
+
+    EndOffset = Header->FirstFreeByte;
+    if (EndOffset > Scan->BytesPerRecord) {
+        EndOffset = Scan->BytesPerRecord;
+    }
+
+    Offset = Header->FirstAttributeOffset;
+    while (Offset + (DWORD)FIELD_OFFSET(YORILIB_NTFS_ATTRIBUTE_HEADER, Form) <= EndOffset) {
+        Attribute = (PYORILIB_NTFS_ATTRIBUTE_HEADER)(Buffer + Offset);
+        if (Attribute->TypeCode == YORILIB_NTFS_ATTR_END ||
+            Attribute->RecordLength < (DWORD)FIELD_OFFSET(YORILIB_NTFS_ATTRIBUTE_HEADER, Form) ||
+            Attribute->RecordLength > EndOffset - Offset) {
+
+            break;
+        }
+
+        if ((DWORD)Attribute->NameOffset + Attribute->NameLength * sizeof(WCHAR) > Attribute->RecordLength) {
+            break;
+        }
+
+        Value = NULL;
+        ValueLength = 0;
+        if (Attribute->FormCode == 0) {
+            if ((DWORD)Attribute->Form.Resident.ValueOffset + Attribute->Form.Resident.ValueLength > Attribute->RecordLength) {
+                break;
+            }
+            Value = (PUCHAR)Attribute + Attribute->Form.Resident.ValueOffset;
+            ValueLength = Attribute->Form.Resident.ValueLength;
+        } else if (Attribute->RecordLength < (DWORD)FIELD_OFFSET(YORILIB_NTFS_ATTRIBUTE_HEADER, Form.Nonresident.TotalAllocated)) {
+            break;
+        }
+
+        switch(Attribute->TypeCode) {
+            case YORILIB_NTFS_ATTR_FILE_NAME:
+                if (Value != NULL &&
+                    ValueLength >= (DWORD)FIELD_OFFSET(YORILIB_NTFS_FILE_NAME, FileName)) {
+
+                    PYORILIB_NTFS_FILE_NAME FileName;
+                    FileName = (PYORILIB_NTFS_FILE_NAME)Value;
+                    if (FileName->Flags != YORILIB_NTFS_FILE_NAME_DOS_ONLY &&
+                        (DWORD)FIELD_OFFSET(YORILIB_NTFS_FILE_NAME, FileName) + FileName->FileNameLength * sizeof(WCHAR) <= ValueLength) {
+
+                        if (!YoriLibNtfsScanAddLink(Scan, (DWORD)BaseIndex, FileName)) {
+                            return FALSE;
+                        }
+                    }
+                }
+                break;
+            case YORILIB_NTFS_ATTR_DATA:
+                YoriLibNtfsScanCaptureData(Scan, Record, Attribute, (LPCWSTR)((PUCHAR)Attribute + Attribute->NameOffset));
+                break;
+            case YORILIB_NTFS_ATTR_REPARSE_POINT:
+                Record->Flags = (WORD)(Record->Flags | YORILIB_NTFS_SCAN_RECORD_REPARSE);
+                if (Value != NULL && ValueLength >= 8 + sizeof(WOF_EXTERNAL_INFO)) {
+                    PWOF_EXTERNAL_INFO WofInfo;
+                    if (*(PDWORD)Value == IO_REPARSE_TAG_WOF) {
+                        WofInfo = (PWOF_EXTERNAL_INFO)(Value + 8);
+                        if (WofInfo->Provider == WOF_PROVIDER_WIM) {
+                            Record->Flags = (WORD)(Record->Flags | YORILIB_NTFS_SCAN_RECORD_WIM_BACKED);
+                        }
+                    }
+                }
+                break;
+        }
+
+        Offset += Attribute->RecordLength;
+    }
+
+    return TRUE;
+}
+
+/**
+ Decode the location of the MFT from the $DATA attribute of its own file
+ record.
+
+ @param Scan Pointer to the scan results, which describes record sizes.
+
+ @param Buffer Pointer to the first file record in the MFT, which describes
+        the MFT itself.
+
+ @param Extents On successful completion, updated to point to an allocated
+        array of extents describing the MFT.  The caller should free this
+        with YoriLibFree.
+
+ @param ExtentCount On successful completion, updated to contain the number
+        of elements in the Extents array.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriLibNtfsScanGetMftExtents(
+    __in PYORILIB_NTFS_SCAN Scan,
+    __inout PUCHAR Buffer,
+    __out PYORILIB_NTFS_SCAN_EXTENT * Extents,
+    __out PDWORD ExtentCount
+    )
+{
+    PYORILIB_NTFS_FILE_RECORD_HEADER Header;
+    PYORILIB_NTFS_ATTRIBUTE_HEADER Attribute;
+    PYORILIB_NTFS_SCAN_EXTENT ExtentArray;
+    DWORD ExtentsAllocated;
+    DWORD ExtentsFound;
+    DWORD Offset;
+    DWORD EndOffset;
+    PUCHAR Pairs;
+    PUCHAR PairsEnd;
+    LONGLONG Lcn;
+    LONGLONG Length;
+    LONGLONG Delta;
+    UCHAR LengthBytes;
+    UCHAR OffsetBytes;
+    UCHAR Index;
+
+    if (!YoriLibNtfsScanApplyFixups(Buffer, Scan->BytesPerRecord)) {
+        SetLastError(ERROR_FILE_CORRUPT);
+        return FALSE;
+    }
+
+    Header = (PYORILIB_NTFS_FILE_RECORD_HEADER)Buffer;
+    EndOffset = Header->FirstFreeByte;
+    if (EndOffset > Scan->BytesPerRecord) {
+        EndOffset = Scan->BytesPerRecord;
+    }
+
+    //
+    //  Find the unnamed, nonresident $DATA attribute.  If the MFT is so
+    //  fragmented that its extents are described by an attribute list, fail
+    //  and let the caller use a different mechanism.
+    //
+
+    Attribute = NULL;
+    Offset = Header->FirstAttributeOffset;
+    while (Offset + (DWORD)FIELD_OFFSET(YORILIB_NTFS_ATTRIBUTE_HEADER, Form) <= EndOffset) {
+        Attribute = (PYORILIB_NTFS_ATTRIBUTE_HEADER)(Buffer + Offset);
+        if (Attribute->TypeCode == YORILIB_NTFS_ATTR_END ||
+            Attribute->RecordLength < (DWORD)FIELD_OFFSET(YORILIB_NTFS_ATTRIBUTE_HEADER, Form) ||
+            Attribute->RecordLength > EndOffset - Offset) {
+
+            Attribute = NULL;
+            break;
+        }
+
+        if (Attribute->TypeCode == YORILIB_NTFS_ATTR_DATA &&
+            Attribute->NameLength == 0 &&
+            Attribute->FormCode == 1 &&
+            Attribute->Form.Nonresident.LowestVcn == 0 &&
+            Attribute->RecordLength >= (DWORD)FIELD_OFFSET(YORILIB_NTFS_ATTRIBUTE_HEADER, Form.Nonresident.TotalAllocated) &&
+            (DWORD)Attribute->Form.Nonresident.MappingPairsOffset < Attribute->RecordLength) {
+
+            break;
+        }
+
+        Offset += Attribute->RecordLength;
+        Attribute = NULL;
+    }
+
+    if (Attribute == NULL) {
+        SetLastError(ERROR_NOT_SUPPORTED);
+        return FALSE;
+    }
+
+    ExtentArray = NULL;
+    ExtentsAllocated = 0;
+    ExtentsFound = 0;
+    Lcn = 0;
+
+    Pairs = (PUCHAR)Attribute + Attribute->Form.Nonresident.MappingPairsOffset;
+    PairsEnd = (PUCHAR)Attribute + Attribute->RecordLength;
+
+    while (Pairs < PairsEnd && *Pairs != 0) {
+        LengthBytes = (UCHAR)(*Pairs & 0xF);
+        OffsetBytes = (UCHAR)(*Pairs >> 4);
+        if (LengthBytes == 0 || LengthBytes > 8 || OffsetBytes == 0 || OffsetBytes > 8 ||
+            Pairs + 1 + LengthBytes + OffsetBytes > PairsEnd) {
+
+            break;
+        }
+        Pairs++;
+
+        Length = 0;
+        for (Index = 0; Index < LengthBytes; Index++) {
+            Length = Length | ((LONGLONG)Pairs[Index] << (Index * 8));
+        }
+        Pairs += LengthBytes;
+
+        //
+        //  The offset is signed and relative to the previous extent.
+        //
+
+        Delta = 0;
+        for (Index = 0; Index < OffsetBytes; Index++) {
+            Delta = Delta | ((LONGLONG)Pairs[Index] << (Index * 8));
+        }
+        if (OffsetBytes < 8 && (Pairs[OffsetBytes - 1] & 0x80) != 0) {
+            Delta = Delta | ((LONGLONG)-1 << (OffsetBytes * 8));
+        }
+        Pairs += OffsetBytes;
+        Lcn = Lcn + Delta;
+
+        if (!YoriLibNtfsScanGrowArray((PVOID *)&ExtentArray, &ExtentsAllocated, ExtentsFound, ExtentsFound + 1, sizeof(YORILIB_NTFS_SCAN_EXTENT))) {
+            if (ExtentArray != NULL) {
+                YoriLibFree(ExtentArray);
+            }
+            SetLastError(ERROR_NOT_ENOUGH_MEMORY);
+            return FALSE;
+        }
+
+        ExtentArray[ExtentsFound].Lcn = Lcn;
+        ExtentArray[ExtentsFound].ClusterCount = Length;
+        ExtentsFound++;
+    }
+
+    if (ExtentsFound == 0) {
+        if (ExtentArray != NULL) {
+            YoriLibFree(ExtentArray);
+        }
+        SetLastError(ERROR_FILE_CORRUPT);
+        return FALSE;
+    }
+
+    *Extents = ExtentArray;
+    *ExtentCount = ExtentsFound;
+    return TRUE;
+}
+
+/**
+ Free all memory associated with the results of a volume scan.
+
+ @param Scan Pointer to the scan results to free.  The structure itself is
+        not freed.
+ */
+VOID
+YoriLibNtfsScanCleanup(
+    __inout PYORILIB_NTFS_SCAN Scan
+    )
+{
+    if (Scan->Records != NULL) {
+        YoriLibFree(Scan->Records);
+        Scan->Records = NULL;
+    }
+    if (Scan->Links != NULL) {
+        YoriLibFree(Scan->Links);
+        Scan->Links = NULL;
+    }
+    if (Scan->Names != NULL) {
+        YoriLibFree(Scan->Names);
+        Scan->Names = NULL;
+    }
+    Scan->RecordCount = 0;
+    Scan->LinkCount = 0;
+    Scan->LinksAllocated = 0;
+    Scan->NamesLength = 0;
+    Scan->NamesAllocated = 0;
+}
+
+/**
+ Load a description of every file on an NTFS volume by reading its MFT
+ directly.  This is much faster than enumerating the namespace when
+ information about a large number of files is needed, but requires the
+ caller to have access to read the volume, which typically requires
+ administrative privilege.
+
+ @param VolumeName Pointer to the name of the volume, in a form that can
+        be opened to access the volume device, for example "\\?\C:".
+
+ @param Scan On successful completion, populated with the records, links
+        and directory names found on the volume.  The caller should free
+        this with @ref YoriLibNtfsScanCleanup .
+
+ @return TRUE to indicate success, FALSE to indicate failure.  On failure,
+         GetLastError indicates the reason.
+ */
+__success(return)
+BOOL
+YoriLibNtfsScanVolume(
+    __in PYORI_STRING VolumeName,
+    __out PYORILIB_NTFS_SCAN Scan
+    )
+{
+    HANDLE hVolume;
+    NTFS_VOLUME_DATA_BUFFER NtfsData;
+    PYORILIB_NTFS_SCAN_EXTENT Extents;
+    DWORD ExtentCount;
+    DWORD ExtentIndex;
+    PUCHAR Buffer;
+    DWORD BufferSize;
+    DWORD ReadSize;
+    DWORD BytesInBuffer;
+    DWORD BufferOffset;
+    DWORD RecordIndex;
+    DWORD Index;
+    DWORD BytesReturned;
+    DWORD Err;
+    LONGLONG RecordCount;
+    LONGLONG ExtentOffset;
+    LONGLONG ExtentLength;
+    LONGLONG BytesRemaining;
+
+    ASSERT(YoriLibIsStringNullTerminated(VolumeName));
+
+    ZeroMemory(Scan, sizeof(YORILIB_NTFS_SCAN));
+
+    hVolume = CreateFile(VolumeName->StartOfString,
+                         GENERIC_READ,
+                         FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                         NULL,
+                         OPEN_EXISTING,
+                         FILE_FLAG_SEQUENTIAL_SCAN,
+                         NULL);
+
+    if (hVolume == INVALID_HANDLE_VALUE) {
+        return FALSE;
+    }
+
+    if (!DeviceIoControl(hVolume,
+                         FSCTL_GET_NTFS_VOLUME_DATA,
+                         NULL,
+                         0,
+                         &NtfsData,
+                         sizeof(NtfsData),
+                         &BytesReturned,
+                         NULL)) {
+
+        Err = GetLastError();
+        CloseHandle(hVolume);
+        SetLastError(Err);
+        return FALSE;
+    }
+
+    //
+    //  Records must be a multiple of the update sequence stride, and
+    //  clusters a power of two.
+    //
+
+    if (NtfsData.BytesPerFileRecordSegment < YORILIB_NTFS_SEQUENCE_STRIDE ||
+        (NtfsData.BytesPerFileRecordSegment % YORILIB_NTFS_SEQUENCE_STRIDE) != 0 ||
+        NtfsData.BytesPerFileRecordSegment > YORILIB_NTFS_SCAN_READ_SIZE ||
+        NtfsData.BytesPerCluster == 0 ||
+        (NtfsData.BytesPerCluster & (NtfsData.BytesPerCluster - 1)) != 0) {
+
+        CloseHandle(hVolume);
+        SetLastError(ERROR_NOT_SUPPORTED);
+        return FALSE;
+    }
+
+    Scan->BytesPerCluster = NtfsData.BytesPerCluster;
+    Scan->BytesPerRecord = NtfsData.BytesPerFileRecordSegment;
+
+    RecordCount = NtfsData.MftValidDataLength.QuadPart / Scan->BytesPerRecord;
+    if (RecordCount >= (DWORD)-1 ||
+        !YoriLibIsSizeAllocatable(RecordCount * sizeof(YORILIB_NTFS_SCAN_RECORD))) {
+
+        CloseHandle(hVolume);
+        SetLastError(ERROR_NOT_ENOUGH_MEMORY);
+        return FALSE;
+    }
+
+    Scan->Records = YoriLibMalloc((YORI_ALLOC_SIZE_T)(RecordCount * sizeof(YORILIB_NTFS_SCAN_RECORD)));
+    if (Scan->Records == NULL) {
+        CloseHandle(hVolume);
+        SetLastError(ERROR_NOT_ENOUGH_MEMORY);
+        return FALSE;
+    }
+    Scan->RecordCount = (DWORD)RecordCount;
+
+    ZeroMemory(Scan->Records, Scan->RecordCount * sizeof(YORILIB_NTFS_SCAN_RECORD));
+    for (Index = 0; Index < Scan->RecordCount; Index++) {
+        Scan->Records[Index].FirstLink = YORILIB_NTFS_SCAN_NO_LINK;
+    }
+
+    //
+    //  Each read is a multiple of the cluster size.  The buffer has space
+    //  for an extra record so a partial record at the end of one read can
+    //  be combined with the remainder in the next.
+    //
+
+    ReadSize = YORILIB_NTFS_SCAN_READ_SIZE;
+    if (ReadSize < Scan->BytesPerCluster) {
+        ReadSize = Scan->BytesPerCluster;
+    }
+    if (ReadSize < Scan->BytesPerRecord) {
+        ReadSize = Scan->BytesPerRecord;
+    }
+    BufferSize = ReadSize + Scan->BytesPerRecord;
+
+    Buffer = YoriLibMalloc(BufferSize);
+    if (Buffer == NULL) {
+        CloseHandle(hVolume);
+        YoriLibNtfsScanCleanup(Scan);
+        SetLastError(ERROR_NOT_ENOUGH_MEMORY);
+        return FALSE;
+    }
+
+    //
+    //  Read the first record of the MFT, which describes where the rest of
+    //  the MFT is.
+    //
+
+    BytesInBuffer = Scan->BytesPerRecord;
+    if (BytesInBuffer < Scan->BytesPerCluster) {
+        BytesInBuffer = Scan->BytesPerCluster;
+    }
+
+    if (!YoriLibNtfsScanReadVolume(hVolume, NtfsData.MftStartLcn.QuadPart * Scan->BytesPerCluster, Buffer, BytesInBuffer) ||
+        !YoriLibNtfsScanGetMftExtents(Scan, Buffer, &Extents, &ExtentCount)) {
+
+        Err = GetLastError();
+        YoriLibFree(Buffer);
+        CloseHandle(hVolume);
+        YoriLibNtfsScanCleanup(Scan);
+        SetLastError(Err);
+        return FALSE;
+    }
+
+    RecordIndex = 0;
+    BytesInBuffer = 0;
+    Err = ERROR_SUCCESS;
+
+    for (ExtentIndex = 0; ExtentIndex < ExtentCount && RecordIndex < Scan->RecordCount; ExtentIndex++) {
+        ExtentOffset = Extents[ExtentIndex].Lcn * Scan->BytesPerCluster;
+        ExtentLength = Extents[ExtentIndex].ClusterCount * Scan->BytesPerCluster;
+
+        for (BytesRemaining = ExtentLength; BytesRemaining > 0 && RecordIndex < Scan->RecordCount; ) {
+
+            if (YoriLibIsOperationCancelled()) {
+                Err = ERROR_CANCELLED;
+                break;
+            }
+
+            Index = ReadSize;
+            if (Index > BytesRemaining) {
+                Index = (DWORD)BytesRemaining;
+            }
+
+            if (!YoriLibNtfsScanReadVolume(hVolume, ExtentOffset, Buffer + BytesInBuffer, Index)) {
+                Err = GetLastError();
+                break;
+            }
+
+            ExtentOffset += Index;
+            BytesRemaining -= Index;
+            BytesInBuffer += Index;
+
+            for (BufferOffset = 0;
+                 BufferOffset + Scan->BytesPerRecord <= BytesInBuffer && RecordIndex < Scan->RecordCount;
+                 BufferOffset += Scan->BytesPerRecord) {
+
+                if (!YoriLibNtfsScanProcessRecord(Scan, Buffer + BufferOffset, RecordIndex)) {
+                    Err = ERROR_NOT_ENOUGH_MEMORY;
+                    break;
+                }
+                RecordIndex++;
+            }
+
+            if (Err != ERROR_SUCCESS) {
+                break;
+            }
+
+            //
+            //  Move any partial record to the start of the buffer.
+            //
+
+            BytesInBuffer = BytesInBuffer - BufferOffset;
+            if (BytesInBuffer > 0) {
+                memmove(Buffer, Buffer + BufferOffset, BytesInBuffer);
+            }
+        }
+
+        if (Err != ERROR_SUCCESS) {
+            break;
+        }
+    }
+
+    YoriLibFree(Extents);
+    YoriLibFree(Buffer);
+    CloseHandle(hVolume);
+
+    if (Err != ERROR_SUCCESS) {
+        YoriLibNtfsScanCleanup(Scan);
+        SetLastError(Err);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ Find the record number within a volume scan which describes a particular
+ file or directory.
+
+ @param Scan Pointer to the scan results.
+
+ @param FullPath Pointer to the path of the object to find.
+
+ @param RecordIndex On successful completion, updated to contain the record
+        number of the object.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriLibNtfsScanFindRecordForPath(
+    __in PYORILIB_NTFS_SCAN Scan,
+    __in PYORI_STRING FullPath,
+    __out PDWORD RecordIndex
+    )
+{
+    HANDLE hFile;
+    BY_HANDLE_FILE_INFORMATION FileInfo;
+    LARGE_INTEGER FileId;
+
+    ASSERT(YoriLibIsStringNullTerminated(FullPath));
+
+    hFile = CreateFile(FullPath->StartOfString,
+                       FILE_READ_ATTRIBUTES,
+                       FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                       NULL,
+                       OPEN_EXISTING,
+                       FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OPEN_REPARSE_POINT | FILE_FLAG_OPEN_NO_RECALL,
+                       NULL);
+
+    if (hFile == INVALID_HANDLE_VALUE) {
+        return FALSE;
+    }
+
+    if (!GetFileInformationByHandle(hFile, &FileInfo)) {
+        CloseHandle(hFile);
+        return FALSE;
+    }
+
+    CloseHandle(hFile);
+
+    FileId.LowPart = FileInfo.nFileIndexLow;
+    FileId.HighPart = FileInfo.nFileIndexHigh & 0xFFFF;
+
+    if (FileId.QuadPart >= Scan->RecordCount ||
+        (Scan->Records[FileId.LowPart].Flags & YORILIB_NTFS_SCAN_RECORD_IN_USE) == 0) {
+
+        SetLastError(ERROR_FILE_NOT_FOUND);
+        return FALSE;
+    }
+
+    *RecordIndex = FileId.LowPart;
+    return TRUE;
+}
+
+// vim:sw=4:ts=4:et:
@@ -84,65 +84,177 @@ typedef struct _YORI_OBJECT_DIRECTORY_INFORMATION {
 } YORI_OBJECT_DIRECTORY_INFORMATION, *PYORI_OBJECT_DIRECTORY_INFORMATION;
 
 /**
- Enumerate all entries within an object manager directory and call a callback
- function for each entry found.
+ State that is common to all directories visited by a single call to
+ @ref YoriLibForEachObjectEnum .
+ */
+typedef struct _YORI_OBJECT_ENUM_CONTEXT {
 
- @param DirectoryName Pointer to the object manager directory to enumerate.
+    /**
+     Flags to apply to the enumeration.
+     */
+    DWORD MatchFlags;
 
- @param MatchFlags Flags to apply to the enumeration.
+    /**
+     A buffer to receive directory entries.  Child directories are only
+     enumerated once their parent is complete, so a single buffer is used
+     for every directory.
+     */
+    PYORI_OBJECT_DIRECTORY_INFORMATION Buffer;
 
- @param Callback Pointer to a callback function to invoke for each entry.
- 
- @param ErrorCallback Pointer to a callback to invoke if any errors are
-        encountered.
+    /**
+     The size of Buffer, in bytes.
+     */
+    YORI_ALLOC_SIZE_T BufferSize;
 
- @param Context An opaque context pointer that will be supplied to the
-        callback functions.
+    /**
+     Pointer to a callback function to invoke for each entry.
+     */
+    PYORILIB_OBJECT_ENUM_FN Callback;
+
+    /**
+     Pointer to a callback to invoke if any errors are encountered.
+     */
+    PYORILIB_OBJECT_ENUM_ERROR_FN ErrorCallback;
+
+    /**
+     An opaque context pointer that will be supplied to the callback
+     functions.
+     */
+    PVOID Context;
+
+    /**
+     Set to TRUE if a callback has indicated that enumeration should stop.
+     */
+    BOOLEAN Aborted;
+} YORI_OBJECT_ENUM_CONTEXT, *PYORI_OBJECT_ENUM_CONTEXT;
+
+/**
+ Report an error encountered when enumerating an object manager directory.
+
+ @param EnumContext Pointer to the state of the enumeration.
+
+ @param DirectoryName Pointer to the directory that could not be enumerated.
+
+ @param NtStatus The status describing the failure.
+ */
+VOID
+YoriLibObjectEnumError(
+    __in PYORI_OBJECT_ENUM_CONTEXT EnumContext,
+    __in PCYORI_STRING DirectoryName,
+    __in LONG NtStatus
+    )
+{
+    if (EnumContext->ErrorCallback != NULL) {
+        if (!EnumContext->ErrorCallback(DirectoryName, NtStatus, EnumContext->Context)) {
+            EnumContext->Aborted = TRUE;
+        }
+    }
+}
+
+/**
+ Construct the full name of an object within an object manager directory.
+
+ @param DirectoryName Pointer to the directory containing the object.
+
+ @param ObjectName Pointer to the name of the object within the directory.
+
+ @param FullObjectName Pointer to a string to populate with the full name.
+        This allocation is reused across calls so long as it is large enough.
+
+ @param NameOnlyOffset On input, the offset within FullObjectName where the
+        object name begins, or zero if FullObjectName does not contain the
+        directory name yet.  Updated if the directory name is written.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriLibObjectEnumBuildFullName(
+    __in PCYORI_STRING DirectoryName,
+    __in PCYORI_STRING ObjectName,
+    __inout PYORI_STRING FullObjectName,
+    __inout PYORI_ALLOC_SIZE_T NameOnlyOffset
+    )
+{
+    //
+    //  Construct a buffer for a full path name if necessary.  This can be
+    //  reused across entries so long as the name component fits.  Keep the
+    //  directory component unchanged across new name components.
+    //
+
+    if (*NameOnlyOffset == 0 ||
+        FullObjectName->LengthAllocated < DirectoryName->LengthInChars + 1 + ObjectName->LengthInChars + 1) {
+
+        if (FullObjectName->LengthAllocated < DirectoryName->LengthInChars + 1 + ObjectName->LengthInChars + 1) {
+            YoriLibFreeStringContents(FullObjectName);
+            if (!YoriLibAllocateString(FullObjectName, DirectoryName->LengthInChars + 1 + ObjectName->LengthInChars + 1 + 100)) {
+                return FALSE;
+            }
+        }
+
+        FullObjectName->LengthInChars = YoriLibSPrintfS(FullObjectName->StartOfString, FullObjectName->LengthAllocated, _T("%y"), DirectoryName);
+        if (FullObjectName->LengthInChars > 0 &&
+            !YoriLibIsSep(FullObjectName->StartOfString[FullObjectName->LengthInChars - 1])) {
+            FullObjectName->StartOfString[FullObjectName->LengthInChars] = '\\';
+            FullObjectName->LengthInChars = FullObjectName->LengthInChars + 1;
+        }
+
+        *NameOnlyOffset = FullObjectName->LengthInChars;
+    }
+
+    memcpy(&FullObjectName->StartOfString[*NameOnlyOffset], ObjectName->StartOfString, ObjectName->LengthInChars * sizeof(TCHAR));
+    FullObjectName->LengthInChars = *NameOnlyOffset + ObjectName->LengthInChars;
+    FullObjectName->StartOfString[FullObjectName->LengthInChars] = '\0';
+    return TRUE;
+}
+
+/**
+ Enumerate all entries within a single object manager directory, and if
+ requested, any child directories once all entries have been returned.
+
+ @param EnumContext Pointer to the state of the enumeration.
+
+ @param ParentHandle Optionally points to a handle to the parent directory.
+        If specified, OpenName is relative to this directory.
+
+ @param OpenName Pointer to the name to open.
+
+ @param DirectoryName Pointer to the full name of the directory, used to
+        construct full names of objects and to report errors.
 
  @return TRUE to indicate all objects were successfully enumerated, FALSE to
          indicate that not all entries could be enumerated.
  */
 __success(return)
 BOOL
-YoriLibForEachObjectEnum(
-    __in PCYORI_STRING DirectoryName,
-    __in DWORD MatchFlags,
-    __in PYORILIB_OBJECT_ENUM_FN Callback,
-    __in_opt PYORILIB_OBJECT_ENUM_ERROR_FN ErrorCallback,
-    __in_opt PVOID Context
+YoriLibForEachObjectEnumDirectory(
+    __in PYORI_OBJECT_ENUM_CONTEXT EnumContext,
+    __in_opt HANDLE ParentHandle,
+    __in PCYORI_STRING OpenName,
+    __in PCYORI_STRING DirectoryName
     )
 {
     LONG NtStatus;
     HANDLE DirHandle;
     YORI_OBJECT_ATTRIBUTES ObjectAttributes;
-    PYORI_OBJECT_DIRECTORY_INFORMATION Buffer;
     PYORI_OBJECT_DIRECTORY_INFORMATION Entry;
     YORI_ALLOC_SIZE_T NameOnlyOffset;
-    YORI_ALLOC_SIZE_T BufferSize;
-    DWORD EnumContext;
+    YORI_ALLOC_SIZE_T Index;
+    DWORD QueryContext;
     DWORD BytesReturned;
     BOOLEAN Restart;
+    BOOL Result;
+    YORI_STRING_ARRAY ChildDirectories;
 
     YORI_STRING FullObjectName;
     YORI_STRING ObjectName;
     YORI_STRING ObjectType;
 
-    UNREFERENCED_PARAMETER(Callback);
-    UNREFERENCED_PARAMETER(MatchFlags);
-
-    if (DllNtDll.pNtOpenDirectoryObject == NULL ||
-        DllNtDll.pNtQueryDirectoryObject == NULL) {
-
-        return FALSE;
-    }
-
-    YoriLibInitializeObjectAttributes(&ObjectAttributes, NULL, DirectoryName, 0);
+    YoriLibInitializeObjectAttributes(&ObjectAttributes, ParentHandle, OpenName, 0);
 
     NtStatus = DllNtDll.pNtOpenDirectoryObject(&DirHandle, DIRECTORY_QUERY, &ObjectAttributes);
     if (NtStatus != 0) {
-        if (ErrorCallback != NULL) {
-            ErrorCallback(DirectoryName, NtStatus, Context);
-        }
+        YoriLibObjectEnumError(EnumContext, DirectoryName, NtStatus);
         return FALSE;
     }
 
@@ -153,29 +265,21 @@ YoriLibForEachObjectEnum(
 
     __analysis_assume(DirHandle != NULL);
 
-    BufferSize = 60 * 1024;
-    Buffer = YoriLibMalloc(BufferSize);
-    if (Buffer == NULL) {
-        CloseHandle(DirHandle);
-        if (ErrorCallback != NULL) {
-            ErrorCallback(DirectoryName, STATUS_INSUFFICIENT_RESOURCES, Context);
-        }
-        return FALSE;
-    }
-
-    EnumContext = 0;
+    QueryContext = 0;
     Restart = TRUE;
+    Result = TRUE;
     YoriLibInitEmptyString(&FullObjectName);
     YoriLibInitEmptyString(&ObjectName);
     YoriLibInitEmptyString(&ObjectType);
+    YoriStringArrayInitialize(&ChildDirectories);
     NameOnlyOffset = 0;
 
     //
     //  Loop filling a buffer with entries, then processing the entries
     //
 
-    while (TRUE) {
-        NtStatus = DllNtDll.pNtQueryDirectoryObject(DirHandle, Buffer, BufferSize, FALSE, Restart, &EnumContext, &BytesReturned);
+    while (!EnumContext->Aborted) {
+        NtStatus = DllNtDll.pNtQueryDirectoryObject(DirHandle, EnumContext->Buffer, EnumContext->BufferSize, FALSE, Restart, &QueryContext, &BytesReturned);
 
         //
         //  If there are no more entries, enumeration is complete
@@ -191,13 +295,9 @@ YoriLibForEachObjectEnum(
         //
 
         if (NtStatus != 0 && NtStatus != STATUS_MORE_ENTRIES) {
-            if (ErrorCallback != NULL) {
-                ErrorCallback(DirectoryName, NtStatus, Context);
-            }
-            YoriLibFreeStringContents(&FullObjectName);
-            YoriLibFree(Buffer);
-            CloseHandle(DirHandle);
-            return FALSE;
+            YoriLibObjectEnumError(EnumContext, DirectoryName, NtStatus);
+            Result = FALSE;
+            break;
         }
 
         Restart = FALSE;
@@ -210,56 +310,126 @@ YoriLibForEachObjectEnum(
         //  of empty strings.
         //
 
-        Entry = Buffer;
+        Entry = EnumContext->Buffer;
         while (Entry->ObjectName.LengthInBytes != 0) {
             ObjectName.StartOfString = Entry->ObjectName.Buffer;
             ObjectName.LengthInChars = Entry->ObjectName.LengthInBytes / sizeof(TCHAR);
             ObjectType.StartOfString = Entry->ObjectType.Buffer;
             ObjectType.LengthInChars = Entry->ObjectType.LengthInBytes / sizeof(TCHAR);
 
+            if (!YoriLibObjectEnumBuildFullName(DirectoryName, &ObjectName, &FullObjectName, &NameOnlyOffset)) {
+                YoriLibObjectEnumError(EnumContext, DirectoryName, STATUS_INSUFFICIENT_RESOURCES);
+                EnumContext->Aborted = TRUE;
+                Result = FALSE;
+                break;
+            }
+
+            if (!EnumContext->Callback(&FullObjectName, &ObjectName, &ObjectType, EnumContext->Context)) {
+                EnumContext->Aborted = TRUE;
+                break;
+            }
+
             //
-            //  Construct a buffer for a full path name if necessary.  This
-            //  can be reused across entries so long as the name component
-            //  fits.  Keep the directory component unchanged across new
-            //  name components.
+            //  Remember child directories to enumerate once this directory
+            //  is complete, since the query buffer is still in use.
             //
 
-            if (FullObjectName.LengthAllocated < DirectoryName->LengthInChars + 1 + ObjectName.LengthInChars + 1) {
-                YoriLibFreeStringContents(&FullObjectName);
-                if (!YoriLibAllocateString(&FullObjectName, DirectoryName->LengthInChars + 1 + ObjectName.LengthInChars + 1 + 100)) {
-                    YoriLibFree(Buffer);
-                    CloseHandle(DirHandle);
-                    if (ErrorCallback != NULL) {
-                        ErrorCallback(DirectoryName, STATUS_INSUFFICIENT_RESOURCES, Context);
-                    }
-                    return FALSE;
-                }
+            if ((EnumContext->MatchFlags & YORILIB_OBJENUM_RECURSE_AFTER_RETURN) != 0 &&
+                YoriLibCompareStringLit(&ObjectType, _T("Directory")) == 0) {
 
-                FullObjectName.LengthInChars = YoriLibSPrintfS(FullObjectName.StartOfString, FullObjectName.LengthAllocated, _T("%y"), DirectoryName);
-                if (FullObjectName.LengthInChars > 0 &&
-                    !YoriLibIsSep(FullObjectName.StartOfString[FullObjectName.LengthInChars - 1])) {
-                    FullObjectName.StartOfString[FullObjectName.LengthInChars] = '\\';
-                    FullObjectName.LengthInChars = FullObjectName.LengthInChars + 1;
+                if (!YoriStringArrayAddItems(&ChildDirectories, &ObjectName, 1)) {
+                    YoriLibObjectEnumError(EnumContext, DirectoryName, STATUS_INSUFFICIENT_RESOURCES);
+                    EnumContext->Aborted = TRUE;
+                    Result = FALSE;
+                    break;
                 }
-
-                NameOnlyOffset = FullObjectName.LengthInChars;
             }
 
-            memcpy(&FullObjectName.StartOfString[NameOnlyOffset], ObjectName.StartOfString, ObjectName.LengthInChars * sizeof(TCHAR));
-            FullObjectName.LengthInChars = NameOnlyOffset + ObjectName.LengthInChars;
-            FullObjectName.StartOfString[FullObjectName.LengthInChars] = '\0';
-
-            if (!Callback(&FullObjectName, &ObjectName, &ObjectType, Context)) {
-                break;
-            }
             Entry++;
-        } 
+        }
+    }
+
+    //
+    //  Child directories are opened relative to this directory, so the
+    //  object manager doesn't need to parse the full path for each.
+    //
+
+    for (Index = 0; Index < ChildDirectories.Count && !EnumContext->Aborted; Index++) {
+        if (!YoriLibObjectEnumBuildFullName(DirectoryName, &ChildDirectories.Items[Index], &FullObjectName, &NameOnlyOffset)) {
+            YoriLibObjectEnumError(EnumContext, DirectoryName, STATUS_INSUFFICIENT_RESOURCES);
+            Result = FALSE;
+            break;
+        }
+
+        if (!YoriLibForEachObjectEnumDirectory(EnumContext, DirHandle, &ChildDirectories.Items[Index], &FullObjectName)) {
+            Result = FALSE;
+        }
     }
 
+    YoriStringArrayCleanup(&ChildDirectories);
     YoriLibFreeStringContents(&FullObjectName);
-    YoriLibFree(Buffer);
     CloseHandle(DirHandle);
-    return TRUE;
+    return Result;
+}
+
+/**
+ Enumerate all entries within an object manager directory and call a callback
+ function for each entry found.
+
+ @param DirectoryName Pointer to the object manager directory to enumerate.
+
+ @param MatchFlags Flags to apply to the enumeration.  If
+        YORILIB_OBJENUM_RECURSE_AFTER_RETURN is specified, child directories
+        are enumerated after all entries in their parent have been returned.
+
+ @param Callback Pointer to a callback function to invoke for each entry.
+ 
+ @param ErrorCallback Pointer to a callback to invoke if any errors are
+        encountered.
+
+ @param Context An opaque context pointer that will be supplied to the
+        callback functions.
+
+ @return TRUE to indicate all objects were successfully enumerated, FALSE to
+         indicate that not all entries could be enumerated.
+ */
+__success(return)
+BOOL
+YoriLibForEachObjectEnum(
+    __in PCYORI_STRING DirectoryName,
+    __in DWORD MatchFlags,
+    __in PYORILIB_OBJECT_ENUM_FN Callback,
+    __in_opt PYORILIB_OBJECT_ENUM_ERROR_FN ErrorCallback,
+    __in_opt PVOID Context
+    )
+{
+    YORI_OBJECT_ENUM_CONTEXT EnumContext;
+    BOOL Result;
+
+    if (DllNtDll.pNtOpenDirectoryObject == NULL ||
+        DllNtDll.pNtQueryDirectoryObject == NULL) {
+
+        return FALSE;
+    }
+
+    EnumContext.MatchFlags = MatchFlags;
+    EnumContext.Callback = Callback;
+    EnumContext.ErrorCallback = ErrorCallback;
+    EnumContext.Context = Context;
+    EnumContext.Aborted = FALSE;
+    EnumContext.BufferSize = 60 * 1024;
+    EnumContext.Buffer = YoriLibMalloc(EnumContext.BufferSize);
+    if (EnumContext.Buffer == NULL) {
+        if (ErrorCallback != NULL) {
+            ErrorCallback(DirectoryName, STATUS_INSUFFICIENT_RESOURCES, Context);
+        }
+        return FALSE;
+    }
+
+    Result = YoriLibForEachObjectEnumDirectory(&EnumContext, NULL, DirectoryName, DirectoryName);
+
+    YoriLibFree(EnumContext.Buffer);
+    return Result;
 }
 
 // vim:sw=4:ts=4:et:
@@ -92,6 +92,33 @@ FindFirstNonDirectoryFile(
     return Handle;
 }
 
+/**
+ Return TRUE if a file name contains any wildcard characters.  Searches for
+ these cannot be resolved from the path cache, which only matches names
+ literally.
+
+ @param FileName Pointer to the file name to check.
+
+ @return TRUE if the file name contains a wildcard, FALSE if it does not.
+ */
+BOOLEAN
+YoriLibPathHasWildcard(
+    __in PYORI_STRING FileName
+    )
+{
+    YORI_ALLOC_SIZE_T Index;
+
+    for (Index = 0; Index < FileName->LengthInChars; Index++) {
+        if (FileName->StartOfString[Index] == '*' ||
+            FileName->StartOfString[Index] == '?') {
+
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
 /**
  Searches an environment variable with semicolon delimited elements for a file
  name match.
@@ -132,6 +159,10 @@ YoriLibSearchEnv(
     HANDLE hFind;
     WIN32_FIND_DATA FindData;
     LPTSTR fn;
+    PVOID CacheDirectory;
+    YORI_STRING Component;
+    YORI_STRING NoExtension;
+    BOOLEAN Found;
 
     ASSERT(YoriLibIsStringNullTerminated(FileName));
     ASSERT(YoriLibIsStringNullTerminated(EnvVarData));
@@ -201,10 +232,33 @@ YoriLibSearchEnv(
             YoriLibSPrintf(ScratchArea->StartOfString + componentlen + 1, _T("%y"), FileName);
             ScratchArea->LengthInChars = componentlen + 1 + FileName->LengthInChars;
 
-            hFind = FindFirstNonDirectoryFile(ScratchArea->StartOfString, &FindData);
+            //
+            //  If the directory is described by the path cache and the file
+            //  name is not a wildcard, resolve the file from the cache.
+            //
 
-            if (hFind != INVALID_HANDLE_VALUE) {
-                FindClose(hFind);
+            CacheDirectory = NULL;
+            if (!YoriLibPathHasWildcard(FileName)) {
+                YoriLibInitEmptyString(&Component);
+                Component.StartOfString = (LPTSTR)begin;
+                Component.LengthInChars = componentlen;
+                CacheDirectory = YoriLibPathCacheAcquireDirectory(&Component);
+            }
+
+            if (CacheDirectory != NULL) {
+                YoriLibInitEmptyString(&NoExtension);
+                Found = YoriLibPathCacheFindFile(CacheDirectory, FileName, &NoExtension, &FindData);
+                YoriLibPathCacheReleaseDirectory(CacheDirectory);
+            } else {
+                Found = FALSE;
+                hFind = FindFirstNonDirectoryFile(ScratchArea->StartOfString, &FindData);
+                if (hFind != INVALID_HANDLE_VALUE) {
+                    FindClose(hFind);
+                    Found = TRUE;
+                }
+            }
+
+            if (Found) {
                 if (!YoriLibGetFullPathNameReturnAllocation(ScratchArea, FullPath, Out, &fn) || fn == NULL) {
                     Out->LengthInChars = 0;
                     Out->StartOfString[0] = '\0';
@@ -461,6 +515,91 @@ YoriLibPathFreePathExtComponents(
     YoriLibFree(PathExtComponents);
 }
 
+/**
+ Report the matches found when searching a single path, either by invoking
+ a callback for every match, or returning the highest priority match.
+
+ @param SearchPath The directory that was searched.
+
+ @param PathExtData Points to an array of file name extensions, indicating
+        which were found.
+
+ @param PathExtCount The number of elements in PathExtData.
+
+ @param PathExtMatches Points to an array of find results, with one element
+        for each element in PathExtData.
+
+ @param MatchAllCallback Optionally points to a callback function to be invoked
+       on every match found.  If not specified, the first match is returned
+       in Out.
+
+ @param MatchAllContext Optionally points to context to supply to
+        MatchAllCallback .
+
+ @param Out Points to a buffer to populate with the first match if
+        MatchAllCallback is not specified.
+
+ @param FullPath If TRUE, return an escaped form of the path; if FALSE, return
+        a Win32 path without any escape.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriLibLocateReportExtensionMatches(
+    __in PYORI_STRING SearchPath,
+    __in PYORI_PATHEXT_COMPONENT PathExtData,
+    __in YORI_ALLOC_SIZE_T PathExtCount,
+    __in PWIN32_FIND_DATA PathExtMatches,
+    __in_opt PYORI_LIB_PATH_MATCH_FN MatchAllCallback,
+    __in_opt PVOID MatchAllContext,
+    __inout PYORI_STRING Out,
+    __in BOOL FullPath
+    )
+{
+    YORI_ALLOC_SIZE_T Count;
+
+    if (MatchAllCallback != NULL) {
+        for (Count = 0; Count < PathExtCount; Count++) {
+            if (PathExtData[Count].Found) {
+                if (!YoriLibLocateBuildFullName(SearchPath,
+                                                &PathExtMatches[Count],
+                                                Out,
+                                                FullPath)) {
+                    return FALSE;
+                }
+                if (!MatchAllCallback(Out, MatchAllContext)) {
+                    return FALSE;
+                }
+                Out->StartOfString[0] = '\0';
+            }
+        }
+        Out->StartOfString[0] = '\0';
+        return TRUE;
+    }
+
+    //
+    //  Based on the initial search criteria, decide what if anything to
+    //  return
+    //
+
+    for (Count = 0; Count < PathExtCount; Count++) {
+        if (PathExtData[Count].Found) {
+
+            if (!YoriLibLocateBuildFullName(SearchPath,
+                                            &PathExtMatches[Count],
+                                            Out,
+                                            FullPath)) {
+                return FALSE;
+            }
+
+            break;
+        }
+    }
+
+    return TRUE;
+}
+
 /**
  Search through a single path matching against desired file extensions.
 
@@ -515,7 +654,11 @@ YoriLibLocateFileExtensionsInOnePath(
     YORI_STRING SearchName;
     BOOLEAN PartialMatchOkay;
     BOOLEAN NeedsSeperator;
+    BOOLEAN MoreFiles;
     YORI_ALLOC_SIZE_T Count;
+    YORI_STRING BaseName;
+    PVOID CacheDirectory;
+    PVOID CacheFile;
 
     //
     //  If we can't possibly do anything, stop.
@@ -614,13 +757,61 @@ YoriLibLocateFileExtensionsInOnePath(
         PathExtData[Count].Found = FALSE;
     }
 
+    //
+    //  If the directory is described by the path cache, resolve the search
+    //  from the cache.  An exact match only needs to check whether each
+    //  extension exists.  A partial match walks the cached files with the
+    //  specified prefix in the same way as enumerating the directory.
+    //
+
+    YoriLibInitEmptyString(&BaseName);
+    BaseName.StartOfString = FileName->StartOfString;
+    BaseName.LengthInChars = FileName->LengthInChars;
+    if (PartialMatchOkay) {
+        BaseName.LengthInChars--;
+    }
+
+    CacheDirectory = NULL;
+    CacheFile = NULL;
+    hFind = INVALID_HANDLE_VALUE;
+    if (!YoriLibPathHasWildcard(&BaseName)) {
+        CacheDirectory = YoriLibPathCacheAcquireDirectory(SearchPath);
+    }
+
+    if (CacheDirectory != NULL && !PartialMatchOkay) {
+        for (Count = 0; Count < PathExtCount; Count++) {
+            if (YoriLibPathCacheFindFile(CacheDirectory, &BaseName, &PathExtData[Count].Extension, &PathExtMatches[Count])) {
+                PathExtData[Count].Found = TRUE;
+            }
+        }
+
+        YoriLibPathCacheReleaseDirectory(CacheDirectory);
+
+        return YoriLibLocateReportExtensionMatches(SearchPath,
+                                                   PathExtData,
+                                                   PathExtCount,
+                                                   PathExtMatches,
+                                                   MatchAllCallback,
+                                                   MatchAllContext,
+                                                   Out,
+                                                   FullPath);
+    }
+
     //
     //  Search the directory for all files with this prefix.
     //
 
-    hFind = FindFirstNonDirectoryFile(SearchName.StartOfString, &FindData);
-    if (hFind == INVALID_HANDLE_VALUE) {
-        return TRUE;
+    if (CacheDirectory != NULL) {
+        CacheFile = YoriLibPathCacheGetNextFile(CacheDirectory, NULL, &BaseName, &FindData);
+        if (CacheFile == NULL) {
+            YoriLibPathCacheReleaseDirectory(CacheDirectory);
+            return TRUE;
+        }
+    } else {
+        hFind = FindFirstNonDirectoryFile(SearchName.StartOfString, &FindData);
+        if (hFind == INVALID_HANDLE_VALUE) {
+            return TRUE;
+        }
     }
 
     //
@@ -652,7 +843,11 @@ YoriLibLocateFileExtensionsInOnePath(
 
                         ChildPathExtComponents = YoriLibPathBuildPathExtComponentList(&ChildPathExtCount);
                         if (ChildPathExtComponents == NULL) {
-                            FindClose(hFind);
+                            if (CacheDirectory != NULL) {
+                                YoriLibPathCacheReleaseDirectory(CacheDirectory);
+                            } else {
+                                FindClose(hFind);
+                            }
                             return FALSE;
                         }
 
@@ -673,7 +868,11 @@ YoriLibLocateFileExtensionsInOnePath(
 
                             YoriLibPathFreePathExtComponents(ChildPathExtComponents, ChildPathExtCount);
                             YoriLibFreeStringContents(&ChildScratchArea);
-                            FindClose(hFind);
+                            if (CacheDirectory != NULL) {
+                                YoriLibPathCacheReleaseDirectory(CacheDirectory);
+                            } else {
+                                FindClose(hFind);
+                            }
                             return FALSE;
                         }
 
@@ -689,49 +888,29 @@ YoriLibLocateFileExtensionsInOnePath(
             }
         }
 
-    } while(FindNextNonDirectoryFile(hFind, &FindData));
-
-    FindClose(hFind);
-
-    if (MatchAllCallback != NULL) {
-        for (Count = 0; Count < PathExtCount; Count++) {
-            if (PathExtData[Count].Found) {
-                if (!YoriLibLocateBuildFullName(SearchPath,
-                                                &PathExtMatches[Count],
-                                                Out,
-                                                FullPath)) {
-                    return FALSE;
-                }
-                if (!MatchAllCallback(Out, MatchAllContext)) {
-                    return FALSE;
-                }
-                Out->StartOfString[0] = '\0';
-            }
+        if (CacheDirectory != NULL) {
+            CacheFile = YoriLibPathCacheGetNextFile(CacheDirectory, CacheFile, &BaseName, &FindData);
+            MoreFiles = (BOOLEAN)(CacheFile != NULL);
+        } else {
+            MoreFiles = (BOOLEAN)FindNextNonDirectoryFile(hFind, &FindData);
         }
-        Out->StartOfString[0] = '\0';
-        return TRUE;
-    }
 
-    //
-    //  Based on the initial search criteria, decide what if anything to
-    //  return
-    //
-
-    for (Count = 0; Count < PathExtCount; Count++) {
-        if (PathExtData[Count].Found) {
+    } while(MoreFiles);
 
-            if (!YoriLibLocateBuildFullName(SearchPath,
-                                            &PathExtMatches[Count],
-                                            Out,
-                                            FullPath)) {
-                return FALSE;
-            }
-
-            break;
-        }
+    if (CacheDirectory != NULL) {
+        YoriLibPathCacheReleaseDirectory(CacheDirectory);
+    } else {
+        FindClose(hFind);
     }
 
-    return TRUE;
+    return YoriLibLocateReportExtensionMatches(SearchPath,
+                                               PathExtData,
+                                               PathExtCount,
+                                               PathExtMatches,
+                                               MatchAllCallback,
+                                               MatchAllContext,
+                                               Out,
+                                               FullPath);
 }
 
 /**
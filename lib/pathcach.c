@@ -0,0 +1,907 @@
+/**
+ * @file lib/pathcach.c
+ *
+ * Yori cache of the files within directories searched for executables
+ *
+ * Copyright (c) 2026 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "yoripch.h"
+#include "yorilib.h"
+
+//
+//  Searching the path for an executable probes each directory in the path
+//  for each extension in PATHEXT.  A long running process such as the shell
+//  can instead enumerate each directory once and resolve later searches
+//  from memory.  Each cached directory has a change notification which is
+//  signalled when a file is created, deleted or renamed within it, at which
+//  point the directory is enumerated again on its next use.  Directories
+//  which cannot be watched, such as ones that do not exist or some network
+//  shares, are enumerated again after a fixed interval.
+//
+//  Entries are keyed by directory rather than by path, so changing the path
+//  does not require any entry to be discarded; a directory that is no
+//  longer in the path is simply no longer consulted.  Relative directories
+//  are never cached, since their meaning depends on the current directory.
+//
+//  The cache also records the subsystem of executables that have been
+//  launched, so that repeated launches of the same program do not need to
+//  open it and read its headers.  These are keyed by full path and are
+//  only used while the file's last write time is unchanged.  Where the
+//  file is within a cached directory, the last write time is known from
+//  enumeration, which is why directories are also watched for writes.
+//
+//  The cache is only used once a process opts into it by calling
+//  YoriLibPathCacheEnable.
+//
+
+/**
+ The maximum number of directories that can be cached.  Directories beyond
+ this limit are searched without the cache.
+ */
+#define YORI_LIB_PATH_CACHE_MAX_DIRECTORIES (256)
+
+/**
+ The number of milliseconds after which a directory that does not have a
+ change notification is enumerated again.
+ */
+#define YORI_LIB_PATH_CACHE_UNWATCHED_LIFETIME (30 * 1000)
+
+/**
+ The maximum number of executables whose subsystem can be cached.
+ Executables beyond this limit have their headers read on each launch.
+ */
+#define YORI_LIB_PATH_CACHE_MAX_EXECUTABLES (256)
+
+/**
+ A file found when enumerating a directory within the path cache.
+ */
+typedef struct _YORI_LIB_PATH_CACHE_FILE {
+
+    /**
+     The hash entry for the file.  The key is the file name within the
+     directory, which is stored immediately following this structure.
+     Paired with YORI_LIB_PATH_CACHE_DIRECTORY::Files.
+     */
+    YORI_HASH_ENTRY HashEntry;
+
+    /**
+     The list of all files found within the directory.  Paired with
+     YORI_LIB_PATH_CACHE_DIRECTORY::FileList.
+     */
+    YORI_LIST_ENTRY ListEntry;
+
+    /**
+     The last write time of the file when the directory was enumerated.
+     */
+    FILETIME LastWriteTime;
+
+} YORI_LIB_PATH_CACHE_FILE, *PYORI_LIB_PATH_CACHE_FILE;
+
+/**
+ An executable whose subsystem has been recorded in the path cache.
+ */
+typedef struct _YORI_LIB_PATH_CACHE_EXECUTABLE {
+
+    /**
+     The hash entry for the executable.  The key is the full path to the
+     executable, which is stored immediately following this structure.
+     Paired with YORI_LIB_PATH_CACHE::Executables.
+     */
+    YORI_HASH_ENTRY HashEntry;
+
+    /**
+     The list of all cached executables.  Paired with
+     YORI_LIB_PATH_CACHE::ExecutableList.
+     */
+    YORI_LIST_ENTRY ListEntry;
+
+    /**
+     The last write time of the executable when its headers were read.
+     */
+    FILETIME LastWriteTime;
+
+    /**
+     The subsystem of the executable, or zero if it could not be
+     determined.
+     */
+    WORD Subsystem;
+
+} YORI_LIB_PATH_CACHE_EXECUTABLE, *PYORI_LIB_PATH_CACHE_EXECUTABLE;
+
+/**
+ A directory whose files are described by the path cache.
+ */
+typedef struct _YORI_LIB_PATH_CACHE_DIRECTORY {
+
+    /**
+     The hash entry for the directory.  The key is the directory name as
+     it was specified in the path.  Paired with
+     YORI_LIB_PATH_CACHE::Directories.
+     */
+    YORI_HASH_ENTRY HashEntry;
+
+    /**
+     The list of all cached directories.  Paired with
+     YORI_LIB_PATH_CACHE::DirectoryList.
+     */
+    YORI_LIST_ENTRY ListEntry;
+
+    /**
+     The name of the directory, NULL terminated.
+     */
+    YORI_STRING DirName;
+
+    /**
+     A hash table of files found within the directory.
+     */
+    PYORI_HASH_TABLE Files;
+
+    /**
+     A list of files found within the directory, in enumeration order.
+     */
+    YORI_LIST_ENTRY FileList;
+
+    /**
+     A change notification handle which is signalled when a file is
+     created, deleted or renamed within the directory.  NULL if the
+     directory cannot be watched.
+     */
+    HANDLE ChangeNotification;
+
+    /**
+     The tick count when the directory was last enumerated.
+     */
+    DWORD EnumeratedTime;
+
+    /**
+     The number of times the directory has been acquired and not yet
+     released.  The directory is only enumerated again when this is zero,
+     so that a caller iterating over files is not affected by a nested
+     search.
+     */
+    DWORD AcquireCount;
+
+    /**
+     TRUE if the directory has been enumerated successfully, so the list of
+     files can be used to resolve searches.
+     */
+    BOOLEAN Enumerated;
+
+} YORI_LIB_PATH_CACHE_DIRECTORY, *PYORI_LIB_PATH_CACHE_DIRECTORY;
+
+/**
+ Global state for the path cache.
+ */
+typedef struct _YORI_LIB_PATH_CACHE {
+
+    /**
+     A mutex synchronizing access to the cache.
+     */
+    HANDLE Mutex;
+
+    /**
+     A hash table of cached directories.  NULL if the cache is not enabled.
+     */
+    PYORI_HASH_TABLE Directories;
+
+    /**
+     A list of cached directories.
+     */
+    YORI_LIST_ENTRY DirectoryList;
+
+    /**
+     The number of cached directories.
+     */
+    DWORD DirectoryCount;
+
+    /**
+     A hash table of executables whose subsystem is known.
+     */
+    PYORI_HASH_TABLE Executables;
+
+    /**
+     A list of executables whose subsystem is known.
+     */
+    YORI_LIST_ENTRY ExecutableList;
+
+    /**
+     The number of executables whose subsystem is known.
+     */
+    DWORD ExecutableCount;
+
+} YORI_LIB_PATH_CACHE, *PYORI_LIB_PATH_CACHE;
+
+/**
+ Global state for the path cache.
+ */
+YORI_LIB_PATH_CACHE YoriLibPathCache;
+
+/**
+ Enable the path cache for the remainder of this process.  Any failure here
+ leaves the cache disabled, which means searches continue to probe the
+ file system.
+
+ @return TRUE to indicate the cache is enabled, FALSE if it is not.
+ */
+BOOLEAN
+YoriLibPathCacheEnable(VOID)
+{
+    if (YoriLibPathCache.Directories != NULL) {
+        return TRUE;
+    }
+
+    YoriLibPathCache.Mutex = CreateMutex(NULL, FALSE, NULL);
+    if (YoriLibPathCache.Mutex == NULL) {
+        return FALSE;
+    }
+
+    YoriLibInitializeListHead(&YoriLibPathCache.DirectoryList);
+    YoriLibPathCache.DirectoryCount = 0;
+    YoriLibPathCache.Directories = YoriLibAllocateHashTable(64);
+    if (YoriLibPathCache.Directories == NULL) {
+        CloseHandle(YoriLibPathCache.Mutex);
+        YoriLibPathCache.Mutex = NULL;
+        return FALSE;
+    }
+
+    YoriLibInitializeListHead(&YoriLibPathCache.ExecutableList);
+    YoriLibPathCache.ExecutableCount = 0;
+    YoriLibPathCache.Executables = YoriLibAllocateHashTable(64);
+    if (YoriLibPathCache.Executables == NULL) {
+        YoriLibFreeEmptyHashTable(YoriLibPathCache.Directories);
+        YoriLibPathCache.Directories = NULL;
+        CloseHandle(YoriLibPathCache.Mutex);
+        YoriLibPathCache.Mutex = NULL;
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ Free all files recorded within a cached directory.
+
+ @param Directory Pointer to the directory.
+ */
+VOID
+YoriLibPathCacheFreeFiles(
+    __in PYORI_LIB_PATH_CACHE_DIRECTORY Directory
+    )
+{
+    PYORI_LIB_PATH_CACHE_FILE File;
+    PYORI_LIST_ENTRY ListEntry;
+
+    ListEntry = YoriLibGetNextListEntry(&Directory->FileList, NULL);
+    while (ListEntry != NULL) {
+        File = CONTAINING_RECORD(ListEntry, YORI_LIB_PATH_CACHE_FILE, ListEntry);
+        ListEntry = YoriLibGetNextListEntry(&Directory->FileList, ListEntry);
+        YoriLibHashRemoveByEntry(&File->HashEntry);
+        YoriLibRemoveListItem(&File->ListEntry);
+        YoriLibFree(File);
+    }
+
+    Directory->Enumerated = FALSE;
+}
+
+/**
+ Enumerate a cached directory and record each file within it.  If the
+ directory does not exist, it is recorded as enumerated and empty.  If
+ enumeration fails for any other reason, the directory is left
+ unenumerated and searches within it probe the file system.
+
+ @param Directory Pointer to the directory.
+ */
+VOID
+YoriLibPathCacheEnumerateDirectory(
+    __in PYORI_LIB_PATH_CACHE_DIRECTORY Directory
+    )
+{
+    PYORI_LIB_PATH_CACHE_FILE File;
+    YORI_STRING SearchString;
+    WIN32_FIND_DATA FindData;
+    HANDLE FindHandle;
+    YORI_ALLOC_SIZE_T NameLength;
+    DWORD Err;
+
+    YoriLibPathCacheFreeFiles(Directory);
+    Directory->EnumeratedTime = GetTickCount();
+
+    if (!YoriLibAllocateString(&SearchString, Directory->DirName.LengthInChars + 3)) {
+        return;
+    }
+
+    if (YoriLibIsSep(Directory->DirName.StartOfString[Directory->DirName.LengthInChars - 1])) {
+        SearchString.LengthInChars = YoriLibSPrintf(SearchString.StartOfString, _T("%y*"), &Directory->DirName);
+    } else {
+        SearchString.LengthInChars = YoriLibSPrintf(SearchString.StartOfString, _T("%y\\*"), &Directory->DirName);
+    }
+
+    FindHandle = FindFirstFile(SearchString.StartOfString, &FindData);
+    YoriLibFreeStringContents(&SearchString);
+
+    if (FindHandle == INVALID_HANDLE_VALUE) {
+        Err = GetLastError();
+        if (Err == ERROR_PATH_NOT_FOUND || Err == ERROR_FILE_NOT_FOUND) {
+            Directory->Enumerated = TRUE;
+        }
+        return;
+    }
+
+    do {
+        if (FindData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+            continue;
+        }
+
+        NameLength = (YORI_ALLOC_SIZE_T)_tcslen(FindData.cFileName);
+        File = YoriLibMalloc(sizeof(YORI_LIB_PATH_CACHE_FILE) + (NameLength + 1) * sizeof(TCHAR));
+        if (File == NULL) {
+            FindClose(FindHandle);
+            YoriLibPathCacheFreeFiles(Directory);
+            return;
+        }
+
+        YoriLibInitEmptyString(&SearchString);
+        SearchString.StartOfString = (LPTSTR)(File + 1);
+        SearchString.LengthInChars = NameLength;
+        SearchString.LengthAllocated = NameLength + 1;
+        memcpy(SearchString.StartOfString, FindData.cFileName, (NameLength + 1) * sizeof(TCHAR));
+        File->LastWriteTime = FindData.ftLastWriteTime;
+
+        YoriLibHashInsertByKey(Directory->Files, &SearchString, File, &File->HashEntry);
+        YoriLibAppendList(&Directory->FileList, &File->ListEntry);
+
+    } while (FindNextFile(FindHandle, &FindData));
+
+    FindClose(FindHandle);
+    Directory->Enumerated = TRUE;
+}
+
+/**
+ Ensure the contents of a cached directory reflect the file system,
+ enumerating the directory again if it has changed since it was last
+ enumerated.
+
+ @param Directory Pointer to the directory.
+ */
+VOID
+YoriLibPathCacheRefreshDirectory(
+    __in PYORI_LIB_PATH_CACHE_DIRECTORY Directory
+    )
+{
+    if (Directory->Enumerated) {
+        if (Directory->ChangeNotification != NULL) {
+            if (WaitForSingleObject(Directory->ChangeNotification, 0) != WAIT_OBJECT_0) {
+                return;
+            }
+
+            //
+            //  Rearm the notification before enumerating, so that any
+            //  change made during enumeration causes another enumeration
+            //  on the next use.
+            //
+
+            if (!FindNextChangeNotification(Directory->ChangeNotification)) {
+                FindCloseChangeNotification(Directory->ChangeNotification);
+                Directory->ChangeNotification = NULL;
+            }
+        } else if (GetTickCount() - Directory->EnumeratedTime < YORI_LIB_PATH_CACHE_UNWATCHED_LIFETIME) {
+            return;
+        }
+    }
+
+    //
+    //  A directory that did not exist when it was first seen may exist now,
+    //  so attempt to watch it each time it is enumerated.  Writes are
+    //  watched so that the last write time of each file remains current.
+    //
+
+    if (Directory->ChangeNotification == NULL) {
+        Directory->ChangeNotification = FindFirstChangeNotification(Directory->DirName.StartOfString, FALSE, FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_LAST_WRITE);
+        if (Directory->ChangeNotification == INVALID_HANDLE_VALUE) {
+            Directory->ChangeNotification = NULL;
+        }
+    }
+
+    YoriLibPathCacheEnumerateDirectory(Directory);
+}
+
+/**
+ Allocate a new cached directory and insert it into the cache.
+
+ @param DirName Pointer to the name of the directory.
+
+ @return Pointer to the directory, or NULL on failure.
+ */
+PYORI_LIB_PATH_CACHE_DIRECTORY
+YoriLibPathCacheCreateDirectory(
+    __in PYORI_STRING DirName
+    )
+{
+    PYORI_LIB_PATH_CACHE_DIRECTORY Directory;
+
+    Directory = YoriLibMalloc(sizeof(YORI_LIB_PATH_CACHE_DIRECTORY));
+    if (Directory == NULL) {
+        return NULL;
+    }
+
+    ZeroMemory(Directory, sizeof(YORI_LIB_PATH_CACHE_DIRECTORY));
+    if (!YoriLibAllocateString(&Directory->DirName, DirName->LengthInChars + 1)) {
+        YoriLibFree(Directory);
+        return NULL;
+    }
+
+    Directory->DirName.LengthInChars = YoriLibSPrintf(Directory->DirName.StartOfString, _T("%y"), DirName);
+
+    Directory->Files = YoriLibAllocateHashTable(64);
+    if (Directory->Files == NULL) {
+        YoriLibFreeStringContents(&Directory->DirName);
+        YoriLibFree(Directory);
+        return NULL;
+    }
+
+    YoriLibInitializeListHead(&Directory->FileList);
+    YoriLibHashInsertByKey(YoriLibPathCache.Directories, &Directory->DirName, Directory, &Directory->HashEntry);
+    YoriLibAppendList(&YoriLibPathCache.DirectoryList, &Directory->ListEntry);
+    YoriLibPathCache.DirectoryCount++;
+    return Directory;
+}
+
+/**
+ Find a directory within the path cache, and prevent it from changing until
+ it is released with @ref YoriLibPathCacheReleaseDirectory .  The contents
+ of the directory are refreshed if it has changed since it was last
+ enumerated.
+
+ @param DirName Pointer to the name of the directory.
+
+ @return An opaque pointer to the directory, or NULL if the directory cannot
+         be resolved from the cache, in which case the caller should probe
+         the file system.
+ */
+PVOID
+YoriLibPathCacheAcquireDirectory(
+    __in PYORI_STRING DirName
+    )
+{
+    PYORI_LIB_PATH_CACHE_DIRECTORY Directory;
+    PYORI_HASH_ENTRY HashEntry;
+
+    if (YoriLibPathCache.Directories == NULL) {
+        return NULL;
+    }
+
+    //
+    //  Only cache fully specified directories.
+    //
+
+    if (DirName->LengthInChars < 3) {
+        return NULL;
+    }
+
+    if (!YoriLibIsDriveLetterWithColonAndSlash(DirName) &&
+        (!YoriLibIsSep(DirName->StartOfString[0]) || !YoriLibIsSep(DirName->StartOfString[1]))) {
+
+        return NULL;
+    }
+
+    WaitForSingleObject(YoriLibPathCache.Mutex, INFINITE);
+
+    HashEntry = YoriLibHashLookupByKey(YoriLibPathCache.Directories, DirName);
+    if (HashEntry != NULL) {
+        Directory = HashEntry->Context;
+    } else if (YoriLibPathCache.DirectoryCount < YORI_LIB_PATH_CACHE_MAX_DIRECTORIES) {
+        Directory = YoriLibPathCacheCreateDirectory(DirName);
+    } else {
+        Directory = NULL;
+    }
+
+    if (Directory == NULL) {
+        ReleaseMutex(YoriLibPathCache.Mutex);
+        return NULL;
+    }
+
+    if (Directory->AcquireCount == 0) {
+        YoriLibPathCacheRefreshDirectory(Directory);
+    }
+
+    if (!Directory->Enumerated) {
+        ReleaseMutex(YoriLibPathCache.Mutex);
+        return NULL;
+    }
+
+    Directory->AcquireCount++;
+    return Directory;
+}
+
+/**
+ Release a directory previously acquired with
+ @ref YoriLibPathCacheAcquireDirectory .
+
+ @param Context The opaque pointer to the directory.
+ */
+VOID
+YoriLibPathCacheReleaseDirectory(
+    __in PVOID Context
+    )
+{
+    PYORI_LIB_PATH_CACHE_DIRECTORY Directory;
+
+    Directory = (PYORI_LIB_PATH_CACHE_DIRECTORY)Context;
+    ASSERT(Directory->AcquireCount > 0);
+    Directory->AcquireCount--;
+    ReleaseMutex(YoriLibPathCache.Mutex);
+}
+
+/**
+ Check whether a file consisting of a base name and extension exists within
+ an acquired directory.
+
+ @param Context The opaque pointer to the directory.
+
+ @param BaseName Pointer to the base name of the file.
+
+ @param Extension Pointer to the extension of the file, including its
+        period.
+
+ @param FindData On successful completion, the file name is populated with
+        the name of the file, in the case that it was found on disk.  Other
+        fields are zeroed.
+
+ @return TRUE if the file exists, FALSE if it does not.
+ */
+__success(return)
+BOOLEAN
+YoriLibPathCacheFindFile(
+    __in PVOID Context,
+    __in PYORI_STRING BaseName,
+    __in PYORI_STRING Extension,
+    __out PWIN32_FIND_DATA FindData
+    )
+{
+    PYORI_LIB_PATH_CACHE_DIRECTORY Directory;
+    PYORI_HASH_ENTRY HashEntry;
+    TCHAR KeyBuffer[MAX_PATH];
+    YORI_STRING Key;
+
+    Directory = (PYORI_LIB_PATH_CACHE_DIRECTORY)Context;
+
+    //
+    //  A file name component cannot exceed MAX_PATH, so a longer name
+    //  cannot exist.
+    //
+
+    if (BaseName->LengthInChars + Extension->LengthInChars >= MAX_PATH) {
+        return FALSE;
+    }
+
+    YoriLibInitEmptyString(&Key);
+    Key.StartOfString = KeyBuffer;
+    Key.LengthAllocated = MAX_PATH;
+    Key.LengthInChars = YoriLibSPrintf(Key.StartOfString, _T("%y%y"), BaseName, Extension);
+
+    HashEntry = YoriLibHashLookupByKey(Directory->Files, &Key);
+    if (HashEntry == NULL) {
+        return FALSE;
+    }
+
+    ZeroMemory(FindData, sizeof(WIN32_FIND_DATA));
+    memcpy(FindData->cFileName, HashEntry->Key.StartOfString, HashEntry->Key.LengthInChars * sizeof(TCHAR));
+    FindData->cFileName[HashEntry->Key.LengthInChars] = '\0';
+    return TRUE;
+}
+
+/**
+ Return the next file within an acquired directory whose name starts with a
+ specified prefix.
+
+ @param Context The opaque pointer to the directory.
+
+ @param PreviousFile The value returned from the previous call to this
+        function, or NULL to return the first matching file.
+
+ @param Prefix Pointer to the prefix that file names must start with.
+
+ @param FindData On successful completion, the file name is populated with
+        the name of the file.  Other fields are zeroed.
+
+ @return An opaque pointer to pass to the next call to this function, or
+         NULL if there are no more matching files.
+ */
+PVOID
+YoriLibPathCacheGetNextFile(
+    __in PVOID Context,
+    __in_opt PVOID PreviousFile,
+    __in PYORI_STRING Prefix,
+    __out PWIN32_FIND_DATA FindData
+    )
+{
+    PYORI_LIB_PATH_CACHE_DIRECTORY Directory;
+    PYORI_LIB_PATH_CACHE_FILE File;
+    PYORI_LIST_ENTRY ListEntry;
+
+    Directory = (PYORI_LIB_PATH_CACHE_DIRECTORY)Context;
+
+    if (PreviousFile == NULL) {
+        ListEntry = YoriLibGetNextListEntry(&Directory->FileList, NULL);
+    } else {
+        File = (PYORI_LIB_PATH_CACHE_FILE)PreviousFile;
+        ListEntry = YoriLibGetNextListEntry(&Directory->FileList, &File->ListEntry);
+    }
+
+    while (ListEntry != NULL) {
+        File = CONTAINING_RECORD(ListEntry, YORI_LIB_PATH_CACHE_FILE, ListEntry);
+        if (YoriLibCompareStringInsCnt(&File->HashEntry.Key, Prefix, Prefix->LengthInChars) == 0) {
+            ZeroMemory(FindData, sizeof(WIN32_FIND_DATA));
+            memcpy(FindData->cFileName, File->HashEntry.Key.StartOfString, File->HashEntry.Key.LengthInChars * sizeof(TCHAR));
+            FindData->cFileName[File->HashEntry.Key.LengthInChars] = '\0';
+            return File;
+        }
+        ListEntry = YoriLibGetNextListEntry(&Directory->FileList, ListEntry);
+    }
+
+    return NULL;
+}
+
+/**
+ Find the last write time of a file.  If the file is within a directory
+ that is already cached, this is resolved from the cache.  Otherwise the
+ file system is queried.  The caller must hold the path cache mutex.
+
+ @param FullPath Pointer to the NULL terminated full path to the file.
+
+ @param LastWriteTime On successful completion, updated to contain the last
+        write time of the file.
+
+ @return TRUE to indicate success, FALSE if the file could not be found.
+ */
+__success(return)
+BOOLEAN
+YoriLibPathCacheGetLastWriteTime(
+    __in PYORI_STRING FullPath,
+    __out PFILETIME LastWriteTime
+    )
+{
+    PYORI_LIB_PATH_CACHE_DIRECTORY Directory;
+    PYORI_LIB_PATH_CACHE_FILE File;
+    PYORI_HASH_ENTRY HashEntry;
+    WIN32_FILE_ATTRIBUTE_DATA FileAttributeData;
+    YORI_STRING DirName;
+    YORI_STRING FileName;
+    LPTSTR FinalSep;
+
+    FinalSep = YoriLibFindRightMostCharacter(FullPath, '\\');
+    if (FinalSep != NULL) {
+        YoriLibInitEmptyString(&DirName);
+        DirName.StartOfString = FullPath->StartOfString;
+        DirName.LengthInChars = (YORI_ALLOC_SIZE_T)(FinalSep - FullPath->StartOfString);
+
+        YoriLibInitEmptyString(&FileName);
+        FileName.StartOfString = FinalSep + 1;
+        FileName.LengthInChars = FullPath->LengthInChars - DirName.LengthInChars - 1;
+
+        HashEntry = YoriLibHashLookupByKey(YoriLibPathCache.Directories, &DirName);
+        if (HashEntry != NULL) {
+            Directory = HashEntry->Context;
+            if (Directory->AcquireCount == 0) {
+                YoriLibPathCacheRefreshDirectory(Directory);
+            }
+
+            if (Directory->Enumerated) {
+                HashEntry = YoriLibHashLookupByKey(Directory->Files, &FileName);
+                if (HashEntry == NULL) {
+                    return FALSE;
+                }
+                File = HashEntry->Context;
+                *LastWriteTime = File->LastWriteTime;
+                return TRUE;
+            }
+        }
+    }
+
+    if (!GetFileAttributesEx(FullPath->StartOfString, GetFileExInfoStandard, &FileAttributeData)) {
+        return FALSE;
+    }
+
+    *LastWriteTime = FileAttributeData.ftLastWriteTime;
+    return TRUE;
+}
+
+/**
+ Look up the subsystem of an executable from the path cache.
+
+ @param FullPath Pointer to the NULL terminated full path to the executable.
+
+ @param LastWriteTime On successful completion, updated to contain the
+        current last write time of the executable.  This is populated if
+        the subsystem is not known, so that the caller can record the
+        subsystem with @ref YoriLibPathCacheInsertSubsystem .
+
+ @param LastWriteTimeValid On completion, set to TRUE if LastWriteTime was
+        populated, and FALSE if the cache is not enabled or the file could
+        not be found.
+
+ @param Subsystem On successful completion, updated to contain the
+        subsystem of the executable, or zero if it is not an executable.
+
+ @return TRUE if the subsystem was found in the cache, FALSE if the caller
+         should read the executable's headers.
+ */
+__success(return)
+BOOLEAN
+YoriLibPathCacheLookupSubsystem(
+    __in PYORI_STRING FullPath,
+    __out PFILETIME LastWriteTime,
+    __out PBOOLEAN LastWriteTimeValid,
+    __out PWORD Subsystem
+    )
+{
+    PYORI_LIB_PATH_CACHE_EXECUTABLE Executable;
+    PYORI_HASH_ENTRY HashEntry;
+    BOOLEAN Result;
+
+    *LastWriteTimeValid = FALSE;
+    if (YoriLibPathCache.Executables == NULL) {
+        return FALSE;
+    }
+
+    WaitForSingleObject(YoriLibPathCache.Mutex, INFINITE);
+
+    if (!YoriLibPathCacheGetLastWriteTime(FullPath, LastWriteTime)) {
+        ReleaseMutex(YoriLibPathCache.Mutex);
+        return FALSE;
+    }
+
+    *LastWriteTimeValid = TRUE;
+    Result = FALSE;
+    HashEntry = YoriLibHashLookupByKey(YoriLibPathCache.Executables, FullPath);
+    if (HashEntry != NULL) {
+        Executable = HashEntry->Context;
+        if (CompareFileTime(&Executable->LastWriteTime, LastWriteTime) == 0) {
+            *Subsystem = Executable->Subsystem;
+            Result = TRUE;
+        }
+    }
+
+    ReleaseMutex(YoriLibPathCache.Mutex);
+    return Result;
+}
+
+/**
+ Record the subsystem of an executable in the path cache.  If the cache is
+ full, the subsystem is not recorded.
+
+ @param FullPath Pointer to the full path to the executable.
+
+ @param LastWriteTime Pointer to the last write time of the executable,
+        obtained from @ref YoriLibPathCacheLookupSubsystem before its
+        headers were read.
+
+ @param Subsystem The subsystem of the executable, or zero if it is not an
+        executable.
+ */
+VOID
+YoriLibPathCacheInsertSubsystem(
+    __in PYORI_STRING FullPath,
+    __in PFILETIME LastWriteTime,
+    __in WORD Subsystem
+    )
+{
+    PYORI_LIB_PATH_CACHE_EXECUTABLE Executable;
+    PYORI_HASH_ENTRY HashEntry;
+    YORI_STRING Key;
+
+    if (YoriLibPathCache.Executables == NULL) {
+        return;
+    }
+
+    WaitForSingleObject(YoriLibPathCache.Mutex, INFINITE);
+
+    HashEntry = YoriLibHashLookupByKey(YoriLibPathCache.Executables, FullPath);
+    if (HashEntry != NULL) {
+        Executable = HashEntry->Context;
+        Executable->LastWriteTime = *LastWriteTime;
+        Executable->Subsystem = Subsystem;
+        ReleaseMutex(YoriLibPathCache.Mutex);
+        return;
+    }
+
+    if (YoriLibPathCache.ExecutableCount >= YORI_LIB_PATH_CACHE_MAX_EXECUTABLES) {
+        ReleaseMutex(YoriLibPathCache.Mutex);
+        return;
+    }
+
+    Executable = YoriLibMalloc(sizeof(YORI_LIB_PATH_CACHE_EXECUTABLE) + (FullPath->LengthInChars + 1) * sizeof(TCHAR));
+    if (Executable == NULL) {
+        ReleaseMutex(YoriLibPathCache.Mutex);
+        return;
+    }
+
+    YoriLibInitEmptyString(&Key);
+    Key.StartOfString = (LPTSTR)(Executable + 1);
+    Key.LengthInChars = FullPath->LengthInChars;
+    Key.LengthAllocated = FullPath->LengthInChars + 1;
+    memcpy(Key.StartOfString, FullPath->StartOfString, FullPath->LengthInChars * sizeof(TCHAR));
+    Key.StartOfString[Key.LengthInChars] = '\0';
+
+    Executable->LastWriteTime = *LastWriteTime;
+    Executable->Subsystem = Subsystem;
+    YoriLibHashInsertByKey(YoriLibPathCache.Executables, &Key, Executable, &Executable->HashEntry);
+    YoriLibAppendList(&YoriLibPathCache.ExecutableList, &Executable->ListEntry);
+    YoriLibPathCache.ExecutableCount++;
+
+    ReleaseMutex(YoriLibPathCache.Mutex);
+}
+
+/**
+ Free all state associated with the path cache and disable it.
+ */
+VOID
+YoriLibPathCacheCleanup(VOID)
+{
+    PYORI_LIB_PATH_CACHE_DIRECTORY Directory;
+    PYORI_LIB_PATH_CACHE_EXECUTABLE Executable;
+    PYORI_LIST_ENTRY ListEntry;
+
+    if (YoriLibPathCache.Directories == NULL) {
+        return;
+    }
+
+    ListEntry = YoriLibGetNextListEntry(&YoriLibPathCache.DirectoryList, NULL);
+    while (ListEntry != NULL) {
+        Directory = CONTAINING_RECORD(ListEntry, YORI_LIB_PATH_CACHE_DIRECTORY, ListEntry);
+        ListEntry = YoriLibGetNextListEntry(&YoriLibPathCache.DirectoryList, ListEntry);
+
+        ASSERT(Directory->AcquireCount == 0);
+        YoriLibPathCacheFreeFiles(Directory);
+        YoriLibFreeEmptyHashTable(Directory->Files);
+        if (Directory->ChangeNotification != NULL) {
+            FindCloseChangeNotification(Directory->ChangeNotification);
+        }
+
+        YoriLibHashRemoveByEntry(&Directory->HashEntry);
+        YoriLibRemoveListItem(&Directory->ListEntry);
+        YoriLibFreeStringContents(&Directory->DirName);
+        YoriLibFree(Directory);
+    }
+
+    ListEntry = YoriLibGetNextListEntry(&YoriLibPathCache.ExecutableList, NULL);
+    while (ListEntry != NULL) {
+        Executable = CONTAINING_RECORD(ListEntry, YORI_LIB_PATH_CACHE_EXECUTABLE, ListEntry);
+        ListEntry = YoriLibGetNextListEntry(&YoriLibPathCache.ExecutableList, ListEntry);
+
+        YoriLibHashRemoveByEntry(&Executable->HashEntry);
+        YoriLibRemoveListItem(&Executable->ListEntry);
+        YoriLibFree(Executable);
+    }
+
+    YoriLibFreeEmptyHashTable(YoriLibPathCache.Executables);
+    YoriLibPathCache.Executables = NULL;
+    YoriLibPathCache.ExecutableCount = 0;
+
+    YoriLibFreeEmptyHashTable(YoriLibPathCache.Directories);
+    YoriLibPathCache.Directories = NULL;
+    YoriLibPathCache.DirectoryCount = 0;
+    CloseHandle(YoriLibPathCache.Mutex);
+    YoriLibPathCache.Mutex = NULL;
+}
+
+// vim:sw=4:ts=4:et:
@@ -0,0 +1,1550 @@
+/**
+ * @file lib/peinfo.c
+ *
+ * Yori parsing and caching of executable metadata
+ *
+ * Copyright (c) 2026 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "yoripch.h"
+#include "yorilib.h"
+
+//
+//  Directory listings can display an executable's architecture, subsystem,
+//  version and description, which are found in its PE headers and version
+//  resource.  Loading a version resource through version.dll loads the
+//  image as a data file, locates the resource, and copies it before it can
+//  be queried, and this is repeated for each field that is displayed.
+//
+//  Instead, the file is mapped read only and the headers and version
+//  resource are parsed from the view directly, so all fields are obtained
+//  from a single open of the file.  If the file has an MZ header but is not
+//  a PE image that can be parsed here, such as a 16 bit executable, the
+//  version resource is loaded through version.dll as before.
+//
+//  The result is optionally cached for the remainder of the process, keyed
+//  by the volume serial number, file index and last write time, so listing
+//  the same directories repeatedly within a shell does not reparse the same
+//  executables.  Modifying a file updates its last write time, so the cache
+//  does not return stale information for a file that has changed.  The
+//  cache is only used once a process opts into it by calling
+//  YoriLibPeMetadataCacheEnable.
+//
+
+/**
+ The value of the magic field in the optional header of a 32 bit image.
+ */
+#define YORILIB_PE_MAGIC_PE32 (0x10b)
+
+/**
+ The value of the magic field in the optional header of a 64 bit image.
+ */
+#define YORILIB_PE_MAGIC_PE32PLUS (0x20b)
+
+/**
+ The offset of the NumberOfRvaAndSizes field within a 32 bit optional header.
+ The data directories follow immediately afterwards.
+ */
+#define YORILIB_PE32_RVA_AND_SIZES_OFFSET (92)
+
+/**
+ The offset of the NumberOfRvaAndSizes field within a 64 bit optional header.
+ The data directories follow immediately afterwards.
+ */
+#define YORILIB_PE32PLUS_RVA_AND_SIZES_OFFSET (108)
+
+/**
+ The index of the resource directory within the data directories.
+ */
+#define YORILIB_PE_RESOURCE_DATA_DIRECTORY (2)
+
+/**
+ The resource type of a version resource.
+ */
+#define YORILIB_PE_RESOURCE_TYPE_VERSION (16)
+
+/**
+ A flag within a resource directory entry indicating that it refers to a
+ further directory rather than to data.
+ */
+#define YORILIB_PE_RESOURCE_SUBDIRECTORY (0x80000000)
+
+/**
+ A flag within a resource directory entry indicating that it is identified
+ by a name rather than a numeric identifier.
+ */
+#define YORILIB_PE_RESOURCE_NAMED (0x80000000)
+
+/**
+ The type of a version block whose value is text.
+ */
+#define YORILIB_PE_VERSION_BLOCK_TEXT (1)
+
+/**
+ The maximum number of executables whose metadata can be cached.
+ */
+#define YORILIB_PE_METADATA_CACHE_MAX_ENTRIES (4096)
+
+/**
+ The length of a cache key, in characters, excluding the NULL terminator.
+ This consists of five 32 bit values in hex.
+ */
+#define YORILIB_PE_METADATA_CACHE_KEY_LENGTH (40)
+
+/**
+ A resource directory entry.  This is declared here rather than using the
+ SDK definition because the SDK definition expresses these fields as
+ bitfields within unions whose names vary between SDK versions.
+ */
+typedef struct _YORILIB_PE_RESOURCE_ENTRY {
+
+    /**
+     The numeric identifier of the entry, or an offset to its name if
+     YORILIB_PE_RESOURCE_NAMED is set.
+     */
+    DWORD Name;
+
+    /**
+     The offset from the beginning of the resource directory to the data
+     entry, or to a further directory if YORILIB_PE_RESOURCE_SUBDIRECTORY is
+     set.
+     */
+    DWORD OffsetToData;
+} YORILIB_PE_RESOURCE_ENTRY, *PYORILIB_PE_RESOURCE_ENTRY;
+
+/**
+ A view of a mapped executable being parsed.
+ */
+typedef struct _YORILIB_PE_IMAGE_VIEW {
+
+    /**
+     The base of the mapped file.
+     */
+    PUCHAR Base;
+
+    /**
+     The length of the mapped file, in bytes.
+     */
+    DWORD Length;
+
+    /**
+     Pointer to the section table within the mapped file.
+     */
+    PIMAGE_SECTION_HEADER Sections;
+
+    /**
+     The number of entries in the section table.
+     */
+    DWORD SectionCount;
+} YORILIB_PE_IMAGE_VIEW, *PYORILIB_PE_IMAGE_VIEW;
+
+/**
+ A block within a version resource, after its header has been validated.
+ All offsets are relative to the beginning of the version resource.
+ */
+typedef struct _YORILIB_PE_VERSION_BLOCK {
+
+    /**
+     The name of the block.  This points into the version resource and is not
+     NULL terminated.
+     */
+    YORI_STRING Key;
+
+    /**
+     The type of the value, which is YORILIB_PE_VERSION_BLOCK_TEXT if the
+     value is a string.
+     */
+    WORD Type;
+
+    /**
+     The offset of the value.
+     */
+    DWORD ValueOffset;
+
+    /**
+     The length of the value, in bytes.
+     */
+    DWORD ValueLength;
+
+    /**
+     The offset of the first child block.
+     */
+    DWORD ChildOffset;
+
+    /**
+     The offset of the end of this block, which is also the end of its
+     children.
+     */
+    DWORD EndOffset;
+
+    /**
+     The offset of the next sibling block.
+     */
+    DWORD NextOffset;
+} YORILIB_PE_VERSION_BLOCK, *PYORILIB_PE_VERSION_BLOCK;
+
+/**
+ Cached metadata for an executable.
+ */
+typedef struct _YORILIB_PE_METADATA_CACHE_ENTRY {
+
+    /**
+     The hash entry for the file.  The key describes the volume serial number,
+     file index and last write time of the file, and is stored immediately
+     following this structure.  Paired with
+     YORILIB_PE_METADATA_CACHE::Entries.
+     */
+    YORI_HASH_ENTRY HashEntry;
+
+    /**
+     The list of all cached files, ordered from least recently used to most
+     recently used.  Paired with YORILIB_PE_METADATA_CACHE::EntryList.
+     */
+    YORI_LIST_ENTRY ListEntry;
+
+    /**
+     The metadata of the file.
+     */
+    YORILIB_PE_METADATA Metadata;
+
+} YORILIB_PE_METADATA_CACHE_ENTRY, *PYORILIB_PE_METADATA_CACHE_ENTRY;
+
+/**
+ Global state for the executable metadata cache.
+ */
+typedef struct _YORILIB_PE_METADATA_CACHE {
+
+    /**
+     A mutex synchronizing access to the cache.
+     */
+    HANDLE Mutex;
+
+    /**
+     A hash table of cached files.  NULL if the cache is not enabled.
+     */
+    PYORI_HASH_TABLE Entries;
+
+    /**
+     A list of cached files, ordered from least recently used to most
+     recently used.
+     */
+    YORI_LIST_ENTRY EntryList;
+
+    /**
+     The number of cached files.
+     */
+    DWORD EntryCount;
+
+} YORILIB_PE_METADATA_CACHE, *PYORILIB_PE_METADATA_CACHE;
+
+/**
+ Global state for the executable metadata cache.
+ */
+YORILIB_PE_METADATA_CACHE YoriLibPeMetadataCache;
+
+/**
+ Return a pointer to a range within a mapped file, if the range is entirely
+ contained within the file.
+
+ @param Base Pointer to the beginning of the mapped region.
+
+ @param Length The length of the mapped region, in bytes.
+
+ @param Offset The offset of the range within the mapped region.
+
+ @param RangeLength The length of the range, in bytes.
+
+ @return Pointer to the range, or NULL if it is not contained within the
+         mapped region.
+ */
+PVOID
+YoriLibPeGetRange(
+    __in PUCHAR Base,
+    __in DWORD Length,
+    __in DWORD Offset,
+    __in DWORD RangeLength
+    )
+{
+    if (Offset > Length || RangeLength > Length - Offset) {
+        return NULL;
+    }
+
+    return Base + Offset;
+}
+
+/**
+ Locate the data corresponding to a relative virtual address within the
+ mapped file.
+
+ @param View Pointer to the mapped executable.
+
+ @param Rva The relative virtual address to locate.
+
+ @param Offset On successful completion, populated with the offset within
+        the file corresponding to the address.
+
+ @param AvailableLength On successful completion, populated with the number
+        of bytes that are present in the file following this offset within
+        the same section.
+
+ @return TRUE to indicate the address was found, FALSE if it is not backed by
+         data within the file.
+ */
+__success(return)
+BOOLEAN
+YoriLibPeRvaToOffset(
+    __in PYORILIB_PE_IMAGE_VIEW View,
+    __in DWORD Rva,
+    __out PDWORD Offset,
+    __out PDWORD AvailableLength
+    )
+{
+    PIMAGE_SECTION_HEADER Section;
+    DWORD Index;
+    DWORD SectionOffset;
+    DWORD RawLength;
+
+    for (Index = 0; Index < View->SectionCount; Index++) {
+        Section = &View->Sections[Index];
+        if (Rva < Section->VirtualAddress) {
+            continue;
+        }
+
+        SectionOffset = Rva - Section->VirtualAddress;
+        RawLength = Section->SizeOfRawData;
+        if (Section->Misc.VirtualSize != 0 && Section->Misc.VirtualSize < RawLength) {
+            RawLength = Section->Misc.VirtualSize;
+        }
+
+        if (SectionOffset >= RawLength ||
+            Section->PointerToRawData > View->Length ||
+            SectionOffset >= View->Length - Section->PointerToRawData) {
+
+            continue;
+        }
+
+        *Offset = Section->PointerToRawData + SectionOffset;
+        *AvailableLength = RawLength - SectionOffset;
+        if (*AvailableLength > View->Length - *Offset) {
+            *AvailableLength = View->Length - *Offset;
+        }
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+/**
+ Find an entry within a resource directory.
+
+ @param Resources Pointer to the beginning of the resource directory.
+
+ @param ResourcesLength The length of the resource directory, in bytes.
+
+ @param DirectoryOffset The offset of the directory to search within the
+        resource directory.
+
+ @param FindFirst If TRUE, the first entry in the directory is returned.  If
+        FALSE, the entry with a numeric identifier of Id is returned.
+
+ @param Id The numeric identifier to find if FindFirst is FALSE.
+
+ @param OffsetToData On successful completion, populated with the entry's
+        offset to its data or subdirectory, including the
+        YORILIB_PE_RESOURCE_SUBDIRECTORY flag.
+
+ @return TRUE to indicate an entry was found, FALSE if it was not.
+ */
+__success(return)
+BOOLEAN
+YoriLibPeFindResourceEntry(
+    __in PUCHAR Resources,
+    __in DWORD ResourcesLength,
+    __in DWORD DirectoryOffset,
+    __in BOOLEAN FindFirst,
+    __in DWORD Id,
+    __out PDWORD OffsetToData
+    )
+{
+    PIMAGE_RESOURCE_DIRECTORY Directory;
+    PYORILIB_PE_RESOURCE_ENTRY Entries;
+    DWORD EntryCount;
+    DWORD Index;
+
+    Directory = YoriLibPeGetRange(Resources, ResourcesLength, DirectoryOffset, sizeof(IMAGE_RESOURCE_DIRECTORY));
+    if (Directory == NULL) {
+        return FALSE;
+    }
+
+    EntryCount = Directory->NumberOfNamedEntries + Directory->NumberOfIdEntries;
+    Entries = YoriLibPeGetRange(Resources,
+                                ResourcesLength,
+                                (DWORD)(DirectoryOffset + sizeof(IMAGE_RESOURCE_DIRECTORY)),
+                                (DWORD)(EntryCount * sizeof(YORILIB_PE_RESOURCE_ENTRY)));
+    if (Entries == NULL || EntryCount == 0) {
+        return FALSE;
+    }
+
+    if (FindFirst) {
+        *OffsetToData = Entries[0].OffsetToData;
+        return TRUE;
+    }
+
+    for (Index = 0; Index < EntryCount; Index++) {
+        if ((Entries[Index].Name & YORILIB_PE_RESOURCE_NAMED) == 0 &&
+            Entries[Index].Name == Id) {
+
+            *OffsetToData = Entries[Index].OffsetToData;
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+/**
+ Round an offset within a version resource up to the next 32 bit boundary.
+
+ @param Offset The offset to align.
+
+ @return The aligned offset.
+ */
+DWORD
+YoriLibPeAlignVersionOffset(
+    __in DWORD Offset
+    )
+{
+    return (Offset + 3) & ~((DWORD)3);
+}
+
+/**
+ Parse the header of a block within a version resource.  Each block consists
+ of its length, the length of its value, its type, a NULL terminated name,
+ the value, and any child blocks, with the value and each child aligned to a
+ 32 bit boundary.
+
+ @param Resource Pointer to the beginning of the version resource.
+
+ @param Offset The offset of the block to parse.
+
+ @param EndOffset The offset of the end of the region that the block must be
+        contained within, which is the end of the parent block.
+
+ @param Block On successful completion, populated with the location of the
+        block's components.
+
+ @return TRUE to indicate the block was parsed, FALSE if it is malformed or
+         there are no further blocks.
+ */
+__success(return)
+BOOLEAN
+YoriLibPeParseVersionBlock(
+    __in PUCHAR Resource,
+    __in DWORD Offset,
+    __in DWORD EndOffset,
+    __out PYORILIB_PE_VERSION_BLOCK Block
+    )
+{
+    PWORD Header;
+    LPWSTR Key;
+    DWORD BlockLength;
+    DWORD KeyLength;
+    DWORD MaxKeyLength;
+
+    if (Offset > EndOffset || EndOffset - Offset < 3 * sizeof(WORD)) {
+        return FALSE;
+    }
+
+    Header = (PWORD)(Resource + Offset);
+    BlockLength = Header[0];
+    if (BlockLength < 3 * sizeof(WORD) || BlockLength > EndOffset - Offset) {
+        return FALSE;
+    }
+
+    Block->EndOffset = Offset + BlockLength;
+    Block->NextOffset = YoriLibPeAlignVersionOffset(Block->EndOffset);
+    Block->Type = Header[2];
+
+    Key = (LPWSTR)(Header + 3);
+    MaxKeyLength = (DWORD)((BlockLength - 3 * sizeof(WORD)) / sizeof(WCHAR));
+    for (KeyLength = 0; KeyLength < MaxKeyLength; KeyLength++) {
+        if (Key[KeyLength] == '\0') {
+            break;
+        }
+    }
+
+    if (KeyLength == MaxKeyLength) {
+        return FALSE;
+    }
+
+    YoriLibInitEmptyString(&Block->Key);
+    Block->Key.StartOfString = Key;
+    Block->Key.LengthInChars = (YORI_ALLOC_SIZE_T)KeyLength;
+
+    //
+    //  Text values are recorded in characters, although some tools record
+    //  them in bytes, so the value is truncated to the end of the block.
+    //
+
+    Block->ValueOffset = YoriLibPeAlignVersionOffset((DWORD)(Offset + 3 * sizeof(WORD) + (KeyLength + 1) * sizeof(WCHAR)));
+    if (Block->ValueOffset > Block->EndOffset) {
+        Block->ValueOffset = Block->EndOffset;
+    }
+
+    Block->ValueLength = Header[1];
+    if (Block->Type == YORILIB_PE_VERSION_BLOCK_TEXT) {
+        Block->ValueLength = (DWORD)(Block->ValueLength * sizeof(WCHAR));
+    }
+
+    if (Block->ValueLength > Block->EndOffset - Block->ValueOffset) {
+        Block->ValueLength = Block->EndOffset - Block->ValueOffset;
+    }
+
+    Block->ChildOffset = YoriLibPeAlignVersionOffset(Block->ValueOffset + Block->ValueLength);
+    if (Block->ChildOffset > Block->EndOffset) {
+        Block->ChildOffset = Block->EndOffset;
+    }
+
+    return TRUE;
+}
+
+/**
+ Find a child block with a specified name within a version resource.
+
+ @param Resource Pointer to the beginning of the version resource.
+
+ @param Parent Pointer to the block whose children should be searched.
+
+ @param Key The name of the child to find.  If NULL, the first child is
+        returned.
+
+ @param Child On successful completion, populated with the child block.
+
+ @return TRUE to indicate the child was found, FALSE if it was not.
+ */
+__success(return)
+BOOLEAN
+YoriLibPeFindVersionChild(
+    __in PUCHAR Resource,
+    __in PYORILIB_PE_VERSION_BLOCK Parent,
+    __in_opt LPCTSTR Key,
+    __out PYORILIB_PE_VERSION_BLOCK Child
+    )
+{
+    DWORD Offset;
+
+    Offset = Parent->ChildOffset;
+    while (YoriLibPeParseVersionBlock(Resource, Offset, Parent->EndOffset, Child)) {
+        if (Key == NULL || YoriLibCompareStringLitIns(&Child->Key, Key) == 0) {
+            return TRUE;
+        }
+        Offset = Child->NextOffset;
+    }
+
+    return FALSE;
+}
+
+/**
+ Copy a text value from a version resource into a buffer, truncating it if
+ the buffer is too small.
+
+ @param Resource Pointer to the beginning of the version resource.
+
+ @param Block Pointer to the block whose value should be copied.
+
+ @param Buffer Pointer to the buffer to populate.
+
+ @param BufferLength The length of the buffer, in characters.
+ */
+VOID
+YoriLibPeCopyVersionString(
+    __in PUCHAR Resource,
+    __in PYORILIB_PE_VERSION_BLOCK Block,
+    __out_ecount(BufferLength) LPTSTR Buffer,
+    __in DWORD BufferLength
+    )
+{
+    LPWSTR Value;
+    DWORD ValueLength;
+    DWORD Index;
+
+    Value = (LPWSTR)(Resource + Block->ValueOffset);
+    ValueLength = Block->ValueLength / sizeof(WCHAR);
+
+    for (Index = 0; Index < ValueLength && Index + 1 < BufferLength; Index++) {
+        if (Value[Index] == '\0') {
+            break;
+        }
+        Buffer[Index] = Value[Index];
+    }
+
+    Buffer[Index] = '\0';
+}
+
+/**
+ Parse a version resource, populating the version, description and version
+ string of an executable.
+
+ @param Resource Pointer to the beginning of the version resource.
+
+ @param ResourceLength The length of the version resource, in bytes.
+
+ @param Metadata Pointer to the metadata to update.
+
+ @return TRUE to indicate the version resource was parsed, FALSE if it is
+         malformed.
+ */
+__success(return)
+BOOLEAN
+YoriLibPeParseVersionResource(
+    __in PUCHAR Resource,
+    __in DWORD ResourceLength,
+    __inout PYORILIB_PE_METADATA Metadata
+    )
+{
+    YORILIB_PE_VERSION_BLOCK Root;
+    YORILIB_PE_VERSION_BLOCK FileInfo;
+    YORILIB_PE_VERSION_BLOCK Table;
+    YORILIB_PE_VERSION_BLOCK Value;
+    VS_FIXEDFILEINFO * FixedInfo;
+    PWORD Translation;
+    TCHAR TableName[sizeof("01234567")];
+    BOOLEAN HaveTable;
+    DWORD Offset;
+
+    if (!YoriLibPeParseVersionBlock(Resource, 0, ResourceLength, &Root)) {
+        return FALSE;
+    }
+
+    if (Root.ValueLength >= sizeof(VS_FIXEDFILEINFO)) {
+        FixedInfo = (VS_FIXEDFILEINFO *)(Resource + Root.ValueOffset);
+        if (FixedInfo->dwSignature == VS_FFI_SIGNATURE) {
+            Metadata->FileVersion.HighPart = FixedInfo->dwFileVersionMS;
+            Metadata->FileVersion.LowPart = FixedInfo->dwFileVersionLS;
+            Metadata->FileVersionFlags = FixedInfo->dwFileFlags & FixedInfo->dwFileFlagsMask;
+            Metadata->ValidFields |= YORILIB_PE_METADATA_VERSION;
+        }
+    }
+
+    //
+    //  Find the string table for the first translation.  If there is no
+    //  translation, or no string table for it, use the first string table.
+    //
+
+    TableName[0] = '\0';
+    if (YoriLibPeFindVersionChild(Resource, &Root, _T("VarFileInfo"), &FileInfo) &&
+        YoriLibPeFindVersionChild(Resource, &FileInfo, _T("Translation"), &Value) &&
+        Value.ValueLength >= 2 * sizeof(WORD)) {
+
+        Translation = (PWORD)(Resource + Value.ValueOffset);
+        YoriLibSPrintf(TableName, _T("%04x%04x"), Translation[0], Translation[1]);
+    }
+
+    if (!YoriLibPeFindVersionChild(Resource, &Root, _T("StringFileInfo"), &FileInfo)) {
+        return TRUE;
+    }
+
+    HaveTable = FALSE;
+    if (TableName[0] != '\0') {
+        HaveTable = YoriLibPeFindVersionChild(Resource, &FileInfo, TableName, &Table);
+    }
+
+    if (!HaveTable) {
+        HaveTable = YoriLibPeFindVersionChild(Resource, &FileInfo, NULL, &Table);
+    }
+
+    if (!HaveTable) {
+        return TRUE;
+    }
+
+    Offset = Table.ChildOffset;
+    while (YoriLibPeParseVersionBlock(Resource, Offset, Table.EndOffset, &Value)) {
+        if (YoriLibCompareStringLitIns(&Value.Key, _T("FileDescription")) == 0) {
+            YoriLibPeCopyVersionString(Resource, &Value, Metadata->Description, (DWORD)(sizeof(Metadata->Description)/sizeof(Metadata->Description[0])));
+        } else if (YoriLibCompareStringLitIns(&Value.Key, _T("FileVersion")) == 0) {
+            YoriLibPeCopyVersionString(Resource, &Value, Metadata->FileVersionString, (DWORD)(sizeof(Metadata->FileVersionString)/sizeof(Metadata->FileVersionString[0])));
+        }
+        Offset = Value.NextOffset;
+    }
+
+    return TRUE;
+}
+
+/**
+ Parse the headers and version resource of a mapped executable.
+
+ @param View Pointer to the mapped file.  On successful completion, the
+        section table within the view is populated.
+
+ @param Metadata Pointer to the metadata to populate.
+
+ @return TRUE to indicate the file has been fully parsed, including if it is
+         not an executable and has no metadata.  FALSE if the file has an MZ
+         header but its version resource could not be parsed here, and
+         should be loaded through version.dll instead.
+ */
+__success(return)
+BOOLEAN
+YoriLibPeParseImage(
+    __inout PYORILIB_PE_IMAGE_VIEW View,
+    __inout PYORILIB_PE_METADATA Metadata
+    )
+{
+    PIMAGE_DOS_HEADER DosHeader;
+    PYORILIB_PE_HEADERS PeHeaders;
+    PUCHAR OptionalHeader;
+    PIMAGE_DATA_DIRECTORY DataDirectory;
+    PUCHAR Resources;
+    DWORD ResourcesOffset;
+    DWORD ResourcesLength;
+    DWORD HeaderOffset;
+    DWORD OptionalHeaderLength;
+    DWORD RvaAndSizesOffset;
+    DWORD RvaAndSizes;
+    DWORD OffsetToData;
+    DWORD DataOffset;
+    DWORD DataLength;
+    PIMAGE_RESOURCE_DATA_ENTRY DataEntry;
+    WORD Magic;
+
+    DosHeader = YoriLibPeGetRange(View->Base, View->Length, 0, sizeof(IMAGE_DOS_HEADER));
+    if (DosHeader == NULL ||
+        DosHeader->e_magic != IMAGE_DOS_SIGNATURE) {
+
+        return TRUE;
+    }
+
+    if (DosHeader->e_lfanew <= 0) {
+        return FALSE;
+    }
+
+    HeaderOffset = (DWORD)DosHeader->e_lfanew;
+    PeHeaders = YoriLibPeGetRange(View->Base, View->Length, HeaderOffset, FIELD_OFFSET(YORILIB_PE_HEADERS, OptionalHeader));
+    if (PeHeaders == NULL ||
+        PeHeaders->Signature != IMAGE_NT_SIGNATURE) {
+
+        return FALSE;
+    }
+
+    OptionalHeaderLength = PeHeaders->ImageHeader.SizeOfOptionalHeader;
+    OptionalHeader = YoriLibPeGetRange(View->Base,
+                                       View->Length,
+                                       HeaderOffset + FIELD_OFFSET(YORILIB_PE_HEADERS, OptionalHeader),
+                                       OptionalHeaderLength);
+    if (OptionalHeader == NULL ||
+        OptionalHeaderLength < FIELD_OFFSET(IMAGE_OPTIONAL_HEADER, Subsystem) + sizeof(WORD)) {
+
+        return FALSE;
+    }
+
+    //
+    //  The subsystem fields are at the same offset in 32 and 64 bit optional
+    //  headers.
+    //
+
+    Metadata->Architecture = PeHeaders->ImageHeader.Machine;
+    Metadata->Subsystem = ((PIMAGE_OPTIONAL_HEADER)OptionalHeader)->Subsystem;
+    Metadata->OsVersionHigh = ((PIMAGE_OPTIONAL_HEADER)OptionalHeader)->MajorSubsystemVersion;
+    Metadata->OsVersionLow = ((PIMAGE_OPTIONAL_HEADER)OptionalHeader)->MinorSubsystemVersion;
+    Metadata->ValidFields |= YORILIB_PE_METADATA_HEADERS;
+
+    Magic = *(PWORD)OptionalHeader;
+    if (Magic == YORILIB_PE_MAGIC_PE32) {
+        RvaAndSizesOffset = YORILIB_PE32_RVA_AND_SIZES_OFFSET;
+    } else if (Magic == YORILIB_PE_MAGIC_PE32PLUS) {
+        RvaAndSizesOffset = YORILIB_PE32PLUS_RVA_AND_SIZES_OFFSET;
+    } else {
+        return FALSE;
+    }
+
+    if (OptionalHeaderLength < RvaAndSizesOffset + sizeof(DWORD)) {
+        return TRUE;
+    }
+
+    RvaAndSizes = *(PDWORD)(OptionalHeader + RvaAndSizesOffset);
+    if (RvaAndSizes <= YORILIB_PE_RESOURCE_DATA_DIRECTORY ||
+        OptionalHeaderLength < RvaAndSizesOffset + sizeof(DWORD) + (YORILIB_PE_RESOURCE_DATA_DIRECTORY + 1) * sizeof(IMAGE_DATA_DIRECTORY)) {
+
+        return TRUE;
+    }
+
+    DataDirectory = (PIMAGE_DATA_DIRECTORY)(OptionalHeader + RvaAndSizesOffset + sizeof(DWORD));
+    DataDirectory = &DataDirectory[YORILIB_PE_RESOURCE_DATA_DIRECTORY];
+    if (DataDirectory->VirtualAddress == 0 || DataDirectory->Size == 0) {
+        return TRUE;
+    }
+
+    View->SectionCount = PeHeaders->ImageHeader.NumberOfSections;
+    View->Sections = YoriLibPeGetRange(View->Base,
+                                       View->Length,
+                                       HeaderOffset + FIELD_OFFSET(YORILIB_PE_HEADERS, OptionalHeader) + OptionalHeaderLength,
+                                       (DWORD)(View->SectionCount * sizeof(IMAGE_SECTION_HEADER)));
+    if (View->Sections == NULL) {
+        return FALSE;
+    }
+
+    if (!YoriLibPeRvaToOffset(View, DataDirectory->VirtualAddress, &ResourcesOffset, &ResourcesLength)) {
+        return FALSE;
+    }
+
+    if (ResourcesLength > DataDirectory->Size) {
+        ResourcesLength = DataDirectory->Size;
+    }
+    Resources = View->Base + ResourcesOffset;
+
+    //
+    //  Version resources are found by type, then by name, then by language.
+    //  An image has at most one version resource, so the first name and
+    //  language are used.
+    //
+
+    if (!YoriLibPeFindResourceEntry(Resources, ResourcesLength, 0, FALSE, YORILIB_PE_RESOURCE_TYPE_VERSION, &OffsetToData)) {
+        return TRUE;
+    }
+
+    if ((OffsetToData & YORILIB_PE_RESOURCE_SUBDIRECTORY) == 0 ||
+        !YoriLibPeFindResourceEntry(Resources, ResourcesLength, OffsetToData & ~(YORILIB_PE_RESOURCE_SUBDIRECTORY), TRUE, 0, &OffsetToData)) {
+
+        return FALSE;
+    }
+
+    if ((OffsetToData & YORILIB_PE_RESOURCE_SUBDIRECTORY) == 0 ||
+        !YoriLibPeFindResourceEntry(Resources, ResourcesLength, OffsetToData & ~(YORILIB_PE_RESOURCE_SUBDIRECTORY), TRUE, 0, &OffsetToData)) {
+
+        return FALSE;
+    }
+
+    if ((OffsetToData & YORILIB_PE_RESOURCE_SUBDIRECTORY) != 0) {
+        return FALSE;
+    }
+
+    DataEntry = YoriLibPeGetRange(Resources, ResourcesLength, OffsetToData, sizeof(IMAGE_RESOURCE_DATA_ENTRY));
+    if (DataEntry == NULL ||
+        !YoriLibPeRvaToOffset(View, DataEntry->OffsetToData, &DataOffset, &DataLength)) {
+
+        return FALSE;
+    }
+
+    if (DataLength > DataEntry->Size) {
+        DataLength = DataEntry->Size;
+    }
+
+    return YoriLibPeParseVersionResource(View->Base + DataOffset, DataLength, Metadata);
+}
+
+/**
+ Parse the headers and version resource of an executable by mapping it.
+
+ @param hFile A handle to the file opened for read data.
+
+ @param Metadata Pointer to the metadata to populate.
+
+ @return TRUE to indicate the file has been fully parsed, including if it is
+         not an executable and has no metadata.  FALSE if the file could not
+         be mapped or parsed here, and its metadata should be obtained from
+         version.dll instead.
+ */
+__success(return)
+BOOLEAN
+YoriLibPeParseFile(
+    __in HANDLE hFile,
+    __inout PYORILIB_PE_METADATA Metadata
+    )
+{
+    YORILIB_PE_IMAGE_VIEW View;
+    HANDLE MapHandle;
+    DWORD FileSizeLow;
+    DWORD FileSizeHigh;
+    BOOLEAN Result;
+
+    FileSizeLow = GetFileSize(hFile, &FileSizeHigh);
+    if (FileSizeLow == INVALID_FILE_SIZE && GetLastError() != NO_ERROR) {
+        return FALSE;
+    }
+
+    if (FileSizeHigh != 0) {
+        return FALSE;
+    }
+
+    //
+    //  Empty files cannot be mapped, and files too small for a DOS header
+    //  cannot be executables.
+    //
+
+    if (FileSizeLow < sizeof(IMAGE_DOS_HEADER)) {
+        return TRUE;
+    }
+
+    MapHandle = CreateFileMapping(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (MapHandle == NULL) {
+        return FALSE;
+    }
+
+    View.Base = MapViewOfFile(MapHandle, FILE_MAP_READ, 0, 0, FileSizeLow);
+    if (View.Base == NULL) {
+        CloseHandle(MapHandle);
+        return FALSE;
+    }
+
+    View.Length = FileSizeLow;
+    View.Sections = NULL;
+    View.SectionCount = 0;
+
+    Result = YoriLibPeParseImage(&View, Metadata);
+
+    UnmapViewOfFile(View.Base);
+    CloseHandle(MapHandle);
+    return Result;
+}
+
+/**
+ Load an executable's version resource through version.dll, populating the
+ version, description and version string.  This is used for executables
+ that cannot be parsed directly, which includes 16 bit executables.
+
+ @param FullPath Pointer to the full path to the executable.
+
+ @param Metadata Pointer to the metadata to update.
+ */
+VOID
+YoriLibPeQueryVersionDll(
+    __in PYORI_STRING FullPath,
+    __inout PYORILIB_PE_METADATA Metadata
+    )
+{
+    DWORD Junk;
+    PVOID Buffer;
+    YORI_ALLOC_SIZE_T VerSize;
+    VS_FIXEDFILEINFO * RootBlock;
+    PWORD TranslationBlock;
+    LPTSTR Value;
+    DWORD CharsToCopy;
+    TCHAR BlockString[sizeof("\\StringFileInfo\\01234567\\FileDescription")];
+
+    YoriLibLoadVersionFunctions();
+
+    if (DllVersion.pGetFileVersionInfoSizeW == NULL ||
+        DllVersion.pGetFileVersionInfoW == NULL ||
+        DllVersion.pVerQueryValueW == NULL) {
+
+        return;
+    }
+
+    VerSize = (YORI_ALLOC_SIZE_T)DllVersion.pGetFileVersionInfoSizeW(FullPath->StartOfString, &Junk);
+    if (VerSize == 0) {
+        return;
+    }
+
+    Buffer = YoriLibMalloc(VerSize);
+    if (Buffer == NULL) {
+        return;
+    }
+
+    if (!DllVersion.pGetFileVersionInfoW(FullPath->StartOfString, 0, VerSize, Buffer)) {
+        YoriLibFree(Buffer);
+        return;
+    }
+
+    //
+    //  Old versions of version.dll modify this buffer while parsing
+    //  it, so we need to give them a writable stack based copy
+    //
+
+    YoriLibSPrintf(BlockString, _T("\\"));
+    if (DllVersion.pVerQueryValueW(Buffer, BlockString, (PVOID*)&RootBlock, (PUINT)&Junk)) {
+        Metadata->FileVersion.HighPart = RootBlock->dwFileVersionMS;
+        Metadata->FileVersion.LowPart = RootBlock->dwFileVersionLS;
+        Metadata->FileVersionFlags = RootBlock->dwFileFlags & RootBlock->dwFileFlagsMask;
+        Metadata->ValidFields |= YORILIB_PE_METADATA_VERSION;
+    }
+
+    YoriLibSPrintf(BlockString, _T("\\VarFileInfo\\Translation"));
+    if (DllVersion.pVerQueryValueW(Buffer, BlockString, (PVOID*)&TranslationBlock, (PUINT)&Junk) && Junk >= 2 * sizeof(WORD)) {
+
+        YoriLibSPrintf(BlockString, _T("\\StringFileInfo\\%04x%04x\\FileDescription"), TranslationBlock[0], TranslationBlock[1]);
+        if (DllVersion.pVerQueryValueW(Buffer, BlockString, (PVOID*)&Value, (PUINT)&Junk)) {
+            CharsToCopy = Junk;
+            if (CharsToCopy > sizeof(Metadata->Description)/sizeof(TCHAR) - 1) {
+                CharsToCopy = (DWORD)(sizeof(Metadata->Description)/sizeof(TCHAR) - 1);
+            }
+            memcpy(Metadata->Description, Value, CharsToCopy * sizeof(TCHAR));
+            Metadata->Description[CharsToCopy] = '\0';
+        }
+
+        YoriLibSPrintf(BlockString, _T("\\StringFileInfo\\%04x%04x\\FileVersion"), TranslationBlock[0], TranslationBlock[1]);
+        if (DllVersion.pVerQueryValueW(Buffer, BlockString, (PVOID*)&Value, (PUINT)&Junk)) {
+            CharsToCopy = Junk;
+            if (CharsToCopy > sizeof(Metadata->FileVersionString)/sizeof(TCHAR) - 1) {
+                CharsToCopy = (DWORD)(sizeof(Metadata->FileVersionString)/sizeof(TCHAR) - 1);
+            }
+            memcpy(Metadata->FileVersionString, Value, CharsToCopy * sizeof(TCHAR));
+            Metadata->FileVersionString[CharsToCopy] = '\0';
+        }
+    }
+
+    YoriLibFree(Buffer);
+}
+
+/**
+ Enable the executable metadata cache for the remainder of this process.  Any
+ failure here leaves the cache disabled, which means each executable is
+ parsed each time its metadata is requested.
+
+ @return TRUE to indicate the cache is enabled, FALSE if it is not.
+ */
+BOOLEAN
+YoriLibPeMetadataCacheEnable(VOID)
+{
+    if (YoriLibPeMetadataCache.Entries != NULL) {
+        return TRUE;
+    }
+
+    YoriLibPeMetadataCache.Mutex = CreateMutex(NULL, FALSE, NULL);
+    if (YoriLibPeMetadataCache.Mutex == NULL) {
+        return FALSE;
+    }
+
+    YoriLibInitializeListHead(&YoriLibPeMetadataCache.EntryList);
+    YoriLibPeMetadataCache.EntryCount = 0;
+    YoriLibPeMetadataCache.Entries = YoriLibAllocateHashTable(256);
+    if (YoriLibPeMetadataCache.Entries == NULL) {
+        CloseHandle(YoriLibPeMetadataCache.Mutex);
+        YoriLibPeMetadataCache.Mutex = NULL;
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ Remove an entry from the cache and free it.  The caller is expected to hold
+ the cache mutex.
+
+ @param Entry Pointer to the entry to free.
+ */
+VOID
+YoriLibPeMetadataCacheFreeEntry(
+    __in PYORILIB_PE_METADATA_CACHE_ENTRY Entry
+    )
+{
+    YoriLibHashRemoveByEntry(&Entry->HashEntry);
+    YoriLibRemoveListItem(&Entry->ListEntry);
+    YoriLibPeMetadataCache.EntryCount--;
+    YoriLibFree(Entry);
+}
+
+/**
+ Construct the key identifying a particular version of a file.
+
+ @param FileInfo Pointer to information about the file.
+
+ @param KeyBuffer Pointer to a buffer of
+        YORILIB_PE_METADATA_CACHE_KEY_LENGTH + 1 characters to contain the
+        key.
+
+ @param Key On completion, populated to refer to the key within KeyBuffer.
+ */
+VOID
+YoriLibPeMetadataCacheBuildKey(
+    __in LPBY_HANDLE_FILE_INFORMATION FileInfo,
+    __out_ecount(YORILIB_PE_METADATA_CACHE_KEY_LENGTH + 1) LPTSTR KeyBuffer,
+    __out PYORI_STRING Key
+    )
+{
+    YoriLibInitEmptyString(Key);
+    Key->StartOfString = KeyBuffer;
+    Key->LengthAllocated = YORILIB_PE_METADATA_CACHE_KEY_LENGTH + 1;
+    Key->LengthInChars = (YORI_ALLOC_SIZE_T)YoriLibSPrintfS(KeyBuffer,
+                                                            YORILIB_PE_METADATA_CACHE_KEY_LENGTH + 1,
+                                                            _T("%08x%08x%08x%08x%08x"),
+                                                            FileInfo->dwVolumeSerialNumber,
+                                                            FileInfo->nFileIndexHigh,
+                                                            FileInfo->nFileIndexLow,
+                                                            FileInfo->ftLastWriteTime.dwHighDateTime,
+                                                            FileInfo->ftLastWriteTime.dwLowDateTime);
+}
+
+/**
+ Look for previously parsed metadata in the cache, and if it is found, copy
+ it into a caller's buffer.
+
+ @param Key Pointer to the key identifying the file.
+
+ @param Metadata On successful completion, populated with the metadata of
+        the file.
+
+ @return TRUE to indicate the metadata was found, FALSE if it was not.
+ */
+__success(return)
+BOOLEAN
+YoriLibPeMetadataCacheLookup(
+    __in PYORI_STRING Key,
+    __out PYORILIB_PE_METADATA Metadata
+    )
+{
+    PYORILIB_PE_METADATA_CACHE_ENTRY Entry;
+    PYORI_HASH_ENTRY HashEntry;
+
+    WaitForSingleObject(YoriLibPeMetadataCache.Mutex, INFINITE);
+
+    HashEntry = YoriLibHashLookupByKey(YoriLibPeMetadataCache.Entries, Key);
+    if (HashEntry == NULL) {
+        ReleaseMutex(YoriLibPeMetadataCache.Mutex);
+        return FALSE;
+    }
+
+    Entry = HashEntry->Context;
+    memcpy(Metadata, &Entry->Metadata, sizeof(YORILIB_PE_METADATA));
+
+    //
+    //  Move the entry to the end of the list so it is the last to be
+    //  discarded.
+    //
+
+    YoriLibRemoveListItem(&Entry->ListEntry);
+    YoriLibAppendList(&YoriLibPeMetadataCache.EntryList, &Entry->ListEntry);
+
+    ReleaseMutex(YoriLibPeMetadataCache.Mutex);
+    return TRUE;
+}
+
+/**
+ Record the metadata of a file in the cache.  Failure to record the metadata
+ is not reported, since the file can always be parsed again.
+
+ @param Key Pointer to the key identifying the file.
+
+ @param Metadata Pointer to the metadata of the file.
+ */
+VOID
+YoriLibPeMetadataCacheInsert(
+    __in PYORI_STRING Key,
+    __in PYORILIB_PE_METADATA Metadata
+    )
+{
+    PYORILIB_PE_METADATA_CACHE_ENTRY Entry;
+    PYORI_HASH_ENTRY HashEntry;
+    PYORI_LIST_ENTRY ListEntry;
+    YORI_STRING EntryKey;
+
+    WaitForSingleObject(YoriLibPeMetadataCache.Mutex, INFINITE);
+
+    //
+    //  Another thread may have parsed the same file concurrently.
+    //
+
+    HashEntry = YoriLibHashLookupByKey(YoriLibPeMetadataCache.Entries, Key);
+    if (HashEntry != NULL) {
+        goto Exit;
+    }
+
+    if (YoriLibPeMetadataCache.EntryCount >= YORILIB_PE_METADATA_CACHE_MAX_ENTRIES) {
+        ListEntry = YoriLibGetNextListEntry(&YoriLibPeMetadataCache.EntryList, NULL);
+        ASSERT(ListEntry != NULL);
+        YoriLibPeMetadataCacheFreeEntry(CONTAINING_RECORD(ListEntry, YORILIB_PE_METADATA_CACHE_ENTRY, ListEntry));
+    }
+
+    Entry = YoriLibMalloc((YORI_ALLOC_SIZE_T)(sizeof(YORILIB_PE_METADATA_CACHE_ENTRY) + Key->LengthInChars * sizeof(TCHAR)));
+    if (Entry == NULL) {
+        goto Exit;
+    }
+
+    YoriLibInitEmptyString(&EntryKey);
+    EntryKey.StartOfString = (LPTSTR)(Entry + 1);
+    EntryKey.LengthInChars = Key->LengthInChars;
+    EntryKey.LengthAllocated = Key->LengthInChars;
+    memcpy(EntryKey.StartOfString, Key->StartOfString, Key->LengthInChars * sizeof(TCHAR));
+
+    memcpy(&Entry->Metadata, Metadata, sizeof(YORILIB_PE_METADATA));
+
+    YoriLibHashInsertByKey(YoriLibPeMetadataCache.Entries, &EntryKey, Entry, &Entry->HashEntry);
+    YoriLibAppendList(&YoriLibPeMetadataCache.EntryList, &Entry->ListEntry);
+    YoriLibPeMetadataCache.EntryCount++;
+
+Exit:
+    ReleaseMutex(YoriLibPeMetadataCache.Mutex);
+}
+
+/**
+ Free all state associated with the executable metadata cache and disable
+ it.
+ */
+VOID
+YoriLibPeMetadataCacheCleanup(VOID)
+{
+    PYORILIB_PE_METADATA_CACHE_ENTRY Entry;
+    PYORI_LIST_ENTRY ListEntry;
+
+    if (YoriLibPeMetadataCache.Entries == NULL) {
+        return;
+    }
+
+    ListEntry = YoriLibGetNextListEntry(&YoriLibPeMetadataCache.EntryList, NULL);
+    while (ListEntry != NULL) {
+        Entry = CONTAINING_RECORD(ListEntry, YORILIB_PE_METADATA_CACHE_ENTRY, ListEntry);
+        ListEntry = YoriLibGetNextListEntry(&YoriLibPeMetadataCache.EntryList, ListEntry);
+        YoriLibPeMetadataCacheFreeEntry(Entry);
+    }
+
+    ASSERT(YoriLibPeMetadataCache.EntryCount == 0);
+    YoriLibFreeEmptyHashTable(YoriLibPeMetadataCache.Entries);
+    YoriLibPeMetadataCache.Entries = NULL;
+    CloseHandle(YoriLibPeMetadataCache.Mutex);
+    YoriLibPeMetadataCache.Mutex = NULL;
+}
+
+/**
+ Obtain the architecture, subsystem, version and description of an
+ executable.  Files that are not executables, or have no version resource,
+ are not an error; the corresponding fields are reported as not valid.
+
+ @param FullPath Pointer to the full path to the file.
+
+ @param Metadata On successful completion, populated with the metadata of
+        the file.
+
+ @return TRUE to indicate the file was examined, FALSE if it could not be
+         opened.
+ */
+__success(return)
+BOOL
+YoriLibGetPeMetadata(
+    __in PYORI_STRING FullPath,
+    __out PYORILIB_PE_METADATA Metadata
+    )
+{
+    HANDLE hFile;
+    BY_HANDLE_FILE_INFORMATION FileInfo;
+    YORILIB_PE_HEADERS PeHeaders;
+    TCHAR KeyBuffer[YORILIB_PE_METADATA_CACHE_KEY_LENGTH + 1];
+    YORI_STRING Key;
+    BOOLEAN UseCache;
+
+    ASSERT(YoriLibIsStringNullTerminated(FullPath));
+
+    ZeroMemory(Metadata, sizeof(YORILIB_PE_METADATA));
+    YoriLibInitEmptyString(&Key);
+
+    hFile = CreateFile(FullPath->StartOfString,
+                       FILE_READ_ATTRIBUTES|FILE_READ_DATA,
+                       FILE_SHARE_READ|FILE_SHARE_WRITE|FILE_SHARE_DELETE,
+                       NULL,
+                       OPEN_EXISTING,
+                       FILE_FLAG_BACKUP_SEMANTICS,
+                       NULL);
+
+    if (hFile == INVALID_HANDLE_VALUE) {
+        return FALSE;
+    }
+
+    UseCache = FALSE;
+    if (YoriLibPeMetadataCache.Entries != NULL &&
+        GetFileInformationByHandle(hFile, &FileInfo)) {
+
+        if ((FileInfo.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0) {
+            CloseHandle(hFile);
+            return TRUE;
+        }
+
+        YoriLibPeMetadataCacheBuildKey(&FileInfo, KeyBuffer, &Key);
+        if (YoriLibPeMetadataCacheLookup(&Key, Metadata)) {
+            CloseHandle(hFile);
+            return TRUE;
+        }
+        UseCache = TRUE;
+    }
+
+    if (!YoriLibPeParseFile(hFile, Metadata)) {
+        CloseHandle(hFile);
+
+        if ((Metadata->ValidFields & YORILIB_PE_METADATA_HEADERS) == 0 &&
+            YoriLibCapturePeHeaders(FullPath, &PeHeaders)) {
+
+            Metadata->Architecture = PeHeaders.ImageHeader.Machine;
+            Metadata->Subsystem = PeHeaders.OptionalHeader.Subsystem;
+            Metadata->OsVersionHigh = PeHeaders.OptionalHeader.MajorSubsystemVersion;
+            Metadata->OsVersionLow = PeHeaders.OptionalHeader.MinorSubsystemVersion;
+            Metadata->ValidFields |= YORILIB_PE_METADATA_HEADERS;
+        }
+
+        YoriLibPeQueryVersionDll(FullPath, Metadata);
+    } else {
+        CloseHandle(hFile);
+    }
+
+    if (UseCache) {
+        YoriLibPeMetadataCacheInsert(&Key, Metadata);
+    }
+
+    return TRUE;
+}
+
+/**
+ Calculate the 16 bit ones' complement sum of a buffer, as used by the PE
+ checksum.  If the buffer has an odd length, the final byte is summed as a
+ word whose high byte is zero.
+
+ Because 0x10000 is congruent to 1 modulo 0xFFFF, summing 32 bit values and
+ folding the carries at the end gives the same result as summing 16 bit
+ values and folding after each addition, so aligned buffers are summed a
+ DWORD at a time into several independent 64 bit accumulators.  Each
+ accumulator can absorb more additions than a buffer described by a DWORD
+ length can supply, so no carries are lost.
+
+ @param Buffer Pointer to the buffer to sum.
+
+ @param Length The length of the buffer, in bytes.
+
+ @return The folded 16 bit sum.
+ */
+WORD
+YoriLibPeChecksumSum(
+    __in_bcount(Length) CONST UCHAR * Buffer,
+    __in DWORD Length
+    )
+{
+    CONST DWORD * Dwords;
+    DWORDLONG Sum0;
+    DWORDLONG Sum1;
+    DWORDLONG Sum2;
+    DWORDLONG Sum3;
+    DWORD DwordCount;
+    DWORD Index;
+    DWORD Offset;
+
+    Sum0 = 0;
+    Sum1 = 0;
+    Sum2 = 0;
+    Sum3 = 0;
+    Offset = 0;
+
+    if ((((DWORD_PTR)Buffer) & (sizeof(DWORD) - 1)) == 0) {
+        Dwords = (CONST DWORD *)Buffer;
+        DwordCount = Length / sizeof(DWORD);
+
+        for (Index = 0; Index + 4 <= DwordCount; Index += 4) {
+            Sum0 += Dwords[Index];
+            Sum1 += Dwords[Index + 1];
+            Sum2 += Dwords[Index + 2];
+            Sum3 += Dwords[Index + 3];
+        }
+
+        for (; Index < DwordCount; Index++) {
+            Sum0 += Dwords[Index];
+        }
+
+        Offset = DwordCount * sizeof(DWORD);
+    }
+
+    //
+    //  Sum any remaining words.  This is also used for the entire buffer if
+    //  it is not aligned.
+    //
+
+    for (; Offset + 1 < Length; Offset += 2) {
+        Sum1 += (DWORD)Buffer[Offset] | ((DWORD)Buffer[Offset + 1] << 8);
+    }
+
+    if (Offset < Length) {
+        Sum2 += Buffer[Offset];
+    }
+
+    //
+    //  Fold each accumulator before combining them so the combined value
+    //  cannot overflow.
+    //
+
+    Sum0 = (Sum0 & 0xFFFFFFFF) + (Sum0 >> 32);
+    Sum1 = (Sum1 & 0xFFFFFFFF) + (Sum1 >> 32);
+    Sum2 = (Sum2 & 0xFFFFFFFF) + (Sum2 >> 32);
+    Sum3 = (Sum3 & 0xFFFFFFFF) + (Sum3 >> 32);
+    Sum0 = Sum0 + Sum1 + Sum2 + Sum3;
+
+    while ((Sum0 >> 16) != 0) {
+        Sum0 = (Sum0 & 0xFFFF) + (Sum0 >> 16);
+    }
+
+    return (WORD)Sum0;
+}
+
+/**
+ Calculate the PE checksum of an image in memory.  This is the same
+ checksum as CheckSumMappedFile in imagehlp.dll: the 16 bit ones'
+ complement sum of the image, excluding the checksum field in the PE
+ header, plus the length of the image.
+
+ @param Buffer Pointer to the image.
+
+ @param Length The length of the image, in bytes.
+
+ @param HeaderChecksum On completion, updated to contain the checksum
+        recorded in the PE header, or zero if the buffer does not contain a
+        PE header.
+
+ @return The checksum of the image contents.
+ */
+DWORD
+YoriLibPeChecksumBuffer(
+    __in_bcount(Length) CONST UCHAR * Buffer,
+    __in DWORD Length,
+    __out PDWORD HeaderChecksum
+    )
+{
+    IMAGE_DOS_HEADER DosHeader;
+    DWORD Signature;
+    DWORD ChecksumOffset;
+    DWORD RecordedChecksum;
+    WORD PartialSum;
+    WORD AdjustSum;
+
+    PartialSum = YoriLibPeChecksumSum(Buffer, Length);
+    RecordedChecksum = 0;
+
+    //
+    //  Locate the checksum field, which is at the same offset in the
+    //  optional header of 32 and 64 bit images.  The headers may not be
+    //  aligned, so they are copied before use.
+    //
+
+    if (Length >= sizeof(IMAGE_DOS_HEADER)) {
+        memcpy(&DosHeader, Buffer, sizeof(IMAGE_DOS_HEADER));
+        ChecksumOffset = (DWORD)DosHeader.e_lfanew + sizeof(DWORD) + sizeof(IMAGE_FILE_HEADER) + FIELD_OFFSET(IMAGE_OPTIONAL_HEADER, CheckSum);
+        if (DosHeader.e_magic == IMAGE_DOS_SIGNATURE &&
+            DosHeader.e_lfanew > 0 &&
+            ChecksumOffset > (DWORD)DosHeader.e_lfanew &&
+            ChecksumOffset + sizeof(DWORD) <= Length) {
+
+            memcpy(&Signature, Buffer + DosHeader.e_lfanew, sizeof(DWORD));
+            if (Signature == IMAGE_NT_SIGNATURE) {
+                memcpy(&RecordedChecksum, Buffer + ChecksumOffset, sizeof(DWORD));
+
+                //
+                //  Subtract each word of the recorded checksum, borrowing
+                //  from the sum as ones' complement arithmetic requires.
+                //
+
+                AdjustSum = LOWORD(RecordedChecksum);
+                PartialSum = (WORD)(PartialSum - (PartialSum < AdjustSum));
+                PartialSum = (WORD)(PartialSum - AdjustSum);
+                AdjustSum = HIWORD(RecordedChecksum);
+                PartialSum = (WORD)(PartialSum - (PartialSum < AdjustSum));
+                PartialSum = (WORD)(PartialSum - AdjustSum);
+            }
+        }
+    }
+
+    *HeaderChecksum = RecordedChecksum;
+    return (DWORD)PartialSum + Length;
+}
+
+/**
+ Calculate the PE checksum of a file by mapping it.  This does not depend
+ on imagehlp.dll, which is not present on all editions of Windows.
+
+ @param FullPath Pointer to the full path to the file.
+
+ @param HeaderChecksum On successful completion, updated to contain the
+        checksum recorded in the PE header, or zero if the file does not
+        contain a PE header.
+
+ @param DataChecksum On successful completion, updated to contain the
+        checksum of the file contents.
+
+ @return Win32 error code, including ERROR_SUCCESS to indicate success.
+ */
+__success(return == ERROR_SUCCESS)
+DWORD
+YoriLibPeChecksumFile(
+    __in PYORI_STRING FullPath,
+    __out PDWORD HeaderChecksum,
+    __out PDWORD DataChecksum
+    )
+{
+    HANDLE hFile;
+    HANDLE MapHandle;
+    PUCHAR Base;
+    DWORD FileSizeLow;
+    DWORD FileSizeHigh;
+    DWORD Err;
+
+    ASSERT(YoriLibIsStringNullTerminated(FullPath));
+
+    hFile = CreateFile(FullPath->StartOfString,
+                       FILE_READ_DATA,
+                       FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                       NULL,
+                       OPEN_EXISTING,
+                       FILE_FLAG_SEQUENTIAL_SCAN,
+                       NULL);
+
+    if (hFile == INVALID_HANDLE_VALUE) {
+        return GetLastError();
+    }
+
+    FileSizeLow = GetFileSize(hFile, &FileSizeHigh);
+    if (FileSizeLow == INVALID_FILE_SIZE) {
+        Err = GetLastError();
+        if (Err != NO_ERROR) {
+            CloseHandle(hFile);
+            return Err;
+        }
+    }
+
+    if (FileSizeHigh != 0) {
+        CloseHandle(hFile);
+        return ERROR_BAD_EXE_FORMAT;
+    }
+
+    //
+    //  Empty files cannot be mapped, and have a checksum of zero.
+    //
+
+    if (FileSizeLow == 0) {
+        CloseHandle(hFile);
+        *HeaderChecksum = 0;
+        *DataChecksum = 0;
+        return ERROR_SUCCESS;
+    }
+
+    MapHandle = CreateFileMapping(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (MapHandle == NULL) {
+        Err = GetLastError();
+        CloseHandle(hFile);
+        return Err;
+    }
+
+    Base = MapViewOfFile(MapHandle, FILE_MAP_READ, 0, 0, FileSizeLow);
+    if (Base == NULL) {
+        Err = GetLastError();
+        CloseHandle(MapHandle);
+        CloseHandle(hFile);
+        return Err;
+    }
+
+    *DataChecksum = YoriLibPeChecksumBuffer(Base, FileSizeLow, HeaderChecksum);
+
+    UnmapViewOfFile(Base);
+    CloseHandle(MapHandle);
+    CloseHandle(hFile);
+    return ERROR_SUCCESS;
+}
+
+// vim:sw=4:ts=4:et:
@@ -53,11 +53,27 @@
 #include "printf.inc"
 
 /**
- Indicate that the printf routine should generate YoriLibVSPrintfSize.
+ Indicate that the printf routine should generate YoriLibVSPrintfCompiled,
+ which processes a format string that has already been parsed.
+ */
+#define PRINTF_COMPILED 1
+#include "printf.inc"
+
+/**
+ Indicate that the printf routine should generate
+ YoriLibVSPrintfCompiledSize.
  */
 #define PRINTF_SIZEONLY 1
 #include "printf.inc"
 
+//
+//  Generate YoriLibVSPrintfSize, which processes a format string that has
+//  not been parsed.
+//
+
+#undef PRINTF_COMPILED
+#include "printf.inc"
+
 /**
  Process a printf format string and output the result into a NULL terminated
  buffer of specified size.
@@ -146,9 +162,33 @@ YoriLibYPrintfInternal(
     __in va_list marker
     )
 {
+#ifdef __WATCOMC__
+    va_list savedmarker;
+#else
+    va_list savedmarker = marker;
+#endif
     YORI_SIGNED_ALLOC_SIZE_T required_len;
     YORI_SIGNED_ALLOC_SIZE_T out_len;
 
+#ifdef __WATCOMC__
+    savedmarker[0] = marker[0];
+#endif
+
+    //
+    //  If the string already has a buffer, try to format into it directly.
+    //  Callers that format repeatedly into the same string will normally
+    //  succeed here and never need to calculate the size.
+    //
+
+    if (Dest->LengthAllocated > 0) {
+        out_len = YoriLibVSPrintf(Dest->StartOfString, Dest->LengthAllocated, szFmt, marker);
+        if (out_len >= 0) {
+            Dest->LengthInChars = out_len;
+            return out_len;
+        }
+        marker = savedmarker;
+    }
+
     required_len = YoriLibVSPrintfSize(szFmt, marker);
     if (required_len < 0) {
         return required_len;
@@ -165,6 +205,7 @@ YoriLibYPrintfInternal(
         Dest->LengthAllocated = required_len;
     }
 
+    marker = savedmarker;
     out_len = YoriLibVSPrintf(Dest->StartOfString, Dest->LengthAllocated, szFmt, marker);
     if (out_len >= 0) {
         Dest->LengthInChars = out_len;
@@ -225,4 +266,137 @@ YoriLibSPrintfSize(
     return out_len;
 }
 
+/**
+ Parse a printf format string once so that it can be used to format many
+ strings without parsing it each time.
+
+ @param szFmt The format string to parse.  This string is referenced by the
+        compiled format, so it must remain valid until the compiled format is
+        freed.
+
+ @param Format On successful completion, populated with the compiled format.
+        The caller should free this with @ref YoriLibFreePrintfFormat .
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriLibCompilePrintfFormat(
+    __in LPCTSTR szFmt,
+    __out PYORI_LIB_PRINTF_FORMAT Format
+    )
+{
+    YORI_LIB_PRINTF_ELEMENT Element;
+    YORI_ALLOC_SIZE_T ElementCount;
+    YORI_ALLOC_SIZE_T Offset;
+
+    Format->Format = szFmt;
+    Format->ElementCount = 0;
+    Format->Elements = NULL;
+
+    ElementCount = 0;
+    Offset = 0;
+    while (szFmt[Offset] != '\0') {
+        Offset = PrintfParseElement(szFmt, Offset, &Element);
+        ElementCount++;
+    }
+
+    if (ElementCount == 0) {
+        return TRUE;
+    }
+
+    Format->Elements = YoriLibMalloc(ElementCount * sizeof(YORI_LIB_PRINTF_ELEMENT));
+    if (Format->Elements == NULL) {
+        return FALSE;
+    }
+
+    Offset = 0;
+    while (szFmt[Offset] != '\0') {
+        ASSERT(Format->ElementCount < ElementCount);
+        Offset = PrintfParseElement(szFmt, Offset, &Format->Elements[Format->ElementCount]);
+        Format->ElementCount++;
+    }
+
+    return TRUE;
+}
+
+/**
+ Free a compiled printf format.
+
+ @param Format The compiled format to free.
+ */
+VOID
+YoriLibFreePrintfFormat(
+    __inout PYORI_LIB_PRINTF_FORMAT Format
+    )
+{
+    if (Format->Elements != NULL) {
+        YoriLibFree(Format->Elements);
+        Format->Elements = NULL;
+    }
+    Format->ElementCount = 0;
+}
+
+/**
+ Process a compiled printf format and output the result into a Yori string.
+ If the string is not large enough to contain the result, it is reallocated
+ internally.
+
+ @param Dest The string to populate with the result.
+
+ @param Format The compiled format to process.
+
+ @return The number of characters successfully populated into the buffer, or
+         -1 on error.
+ */
+__success(return >= 0)
+YORI_SIGNED_ALLOC_SIZE_T
+YoriLibYPrintfCompiled(
+    __inout PYORI_STRING Dest,
+    __in PYORI_LIB_PRINTF_FORMAT Format,
+    ...
+    )
+{
+    va_list marker;
+    YORI_SIGNED_ALLOC_SIZE_T required_len;
+    YORI_SIGNED_ALLOC_SIZE_T out_len;
+
+    if (Dest->LengthAllocated > 0) {
+        va_start( marker, Format );
+        out_len = YoriLibVSPrintfCompiled(Dest->StartOfString, Dest->LengthAllocated, Format, marker);
+        va_end( marker );
+        if (out_len >= 0) {
+            Dest->LengthInChars = out_len;
+            return out_len;
+        }
+    }
+
+    va_start( marker, Format );
+    required_len = YoriLibVSPrintfCompiledSize(Format, marker);
+    va_end( marker );
+    if (required_len < 0) {
+        return required_len;
+    }
+
+    if ((YORI_ALLOC_SIZE_T)required_len > Dest->LengthAllocated) {
+        YoriLibFreeStringContents(Dest);
+
+        Dest->MemoryToFree = YoriLibReferencedMalloc(required_len * sizeof(TCHAR));
+        if (Dest->MemoryToFree == NULL) {
+            return -1;
+        }
+
+        Dest->StartOfString = Dest->MemoryToFree;
+        Dest->LengthAllocated = required_len;
+    }
+
+    va_start( marker, Format );
+    out_len = YoriLibVSPrintfCompiled(Dest->StartOfString, Dest->LengthAllocated, Format, marker);
+    va_end( marker );
+    if (out_len >= 0) {
+        Dest->LengthInChars = out_len;
+    }
+    return out_len;
+}
+
 // vim:sw=4:ts=4:et:
@@ -43,6 +43,46 @@ YoriLibGetSystemProcessList(
     )
 {
     PYORI_SYSTEM_PROCESS_INFORMATION LocalProcessInfo = NULL;
+    YORI_ALLOC_SIZE_T BytesAllocated;
+
+    BytesAllocated = 0;
+    if (!YoriLibRefreshSystemProcessList(&LocalProcessInfo, &BytesAllocated)) {
+        if (LocalProcessInfo != NULL) {
+            YoriLibFree(LocalProcessInfo);
+        }
+        return FALSE;
+    }
+
+    *ProcessInfo = LocalProcessInfo;
+    return TRUE;
+}
+
+/**
+ Load information about all processes currently executing in the system into
+ a buffer that may have been returned from a previous call.  The buffer is
+ only reallocated if the process list no longer fits, so a caller that
+ queries the process list repeatedly does not need to allocate and grow a
+ new buffer each time.
+
+ @param ProcessInfo On input, points to a buffer from a previous call to this
+        function, or NULL if no buffer has been allocated.  On output, points
+        to the buffer containing the list of processes, which may have been
+        reallocated.  The caller is expected to free this with YoriLibFree
+        when it is not NULL, including when this function fails.
+
+ @param BufferSize On input, specifies the size of the buffer in bytes.  On
+        output, updated to contain the size of any reallocated buffer.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriLibRefreshSystemProcessList(
+    __inout PYORI_SYSTEM_PROCESS_INFORMATION *ProcessInfo,
+    __inout PYORI_ALLOC_SIZE_T BufferSize
+    )
+{
+    PYORI_SYSTEM_PROCESS_INFORMATION LocalProcessInfo;
     DWORD BytesReturned;
     YORI_ALLOC_SIZE_T BytesAllocated;
     LONG Status;
@@ -51,42 +91,49 @@ YoriLibGetSystemProcessList(
         return FALSE;
     }
 
-    BytesAllocated = 0;
+    LocalProcessInfo = *ProcessInfo;
+    BytesAllocated = *BufferSize;
+    if (LocalProcessInfo == NULL) {
+        BytesAllocated = 0;
+    }
 
     do {
 
-        if (LocalProcessInfo != NULL) {
-            YoriLibFree(LocalProcessInfo);
-        }
-
-        if (BytesAllocated == 0) {
-            BytesAllocated = 60 * 1024;
-        } else if (BytesAllocated <= 15 * 1024 * 1024 && YoriLibIsSizeAllocatable(BytesAllocated * 4)) {
-            BytesAllocated = BytesAllocated * 4;
-        } else {
-            return FALSE;
-        }
-
-        LocalProcessInfo = YoriLibMalloc(BytesAllocated);
         if (LocalProcessInfo == NULL) {
-            return FALSE;
+            if (BytesAllocated == 0) {
+                BytesAllocated = 60 * 1024;
+            } else if (BytesAllocated <= 15 * 1024 * 1024 && YoriLibIsSizeAllocatable(BytesAllocated * 4)) {
+                BytesAllocated = BytesAllocated * 4;
+            } else {
+                *BufferSize = 0;
+                return FALSE;
+            }
+
+            LocalProcessInfo = YoriLibMalloc(BytesAllocated);
+            *ProcessInfo = LocalProcessInfo;
+            if (LocalProcessInfo == NULL) {
+                *BufferSize = 0;
+                return FALSE;
+            }
+            *BufferSize = BytesAllocated;
         }
 
         Status = DllNtDll.pNtQuerySystemInformation(SystemProcessInformation, LocalProcessInfo, BytesAllocated, &BytesReturned);
+        if (Status == STATUS_INFO_LENGTH_MISMATCH) {
+            YoriLibFree(LocalProcessInfo);
+            LocalProcessInfo = NULL;
+            *ProcessInfo = NULL;
+        }
     } while (Status == STATUS_INFO_LENGTH_MISMATCH);
 
-
     if (Status != 0) {
-        YoriLibFree(LocalProcessInfo);
         return FALSE;
     }
 
     if (BytesReturned == 0) {
-        YoriLibFree(LocalProcessInfo);
         return FALSE;
     }
 
-    *ProcessInfo = LocalProcessInfo;
     return TRUE;
 }
 
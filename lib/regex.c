@@ -0,0 +1,1724 @@
+/**
+ * @file lib/regex.c
+ *
+ * Yori regular expression support
+ *
+ * Copyright (c) 2026 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "yoripch.h"
+#include "yorilib.h"
+
+//
+//  A regular expression is compiled into a nondeterministic automaton, where
+//  each state either consumes one character or is an epsilon transition
+//  (a split, an anchor, or an unconditional jump.)  A search follows every
+//  path through the automaton at once, advancing each by one character at a
+//  time, so the time taken is proportional to the length of the string
+//  multiplied by the number of states, and no pattern can cause
+//  backtracking.
+//
+//  Each path remembers where in the string it started.  When more than one
+//  path reaches the same state, the one that started earliest is kept, so
+//  the result is the leftmost match, and of the matches starting there, the
+//  longest.
+//
+//  The supported syntax is:
+//
+//   c        A literal character
+//   .        Any character
+//   [abc]    Any character in the set, which may include ranges such as a-z
+//            and the classes below
+//   [^abc]   Any character not in the set
+//   \d \w \s A digit, word character, or white space
+//   \D \W \S A character that is not a digit, word character, or white space
+//   \b \B    A word boundary, or a position that is not a word boundary
+//   \n \r \t A newline, carriage return, or tab
+//   \xHH     A character specified in hex
+//   \c       Any other nonalphanumeric character, literally
+//   ^ $      The beginning or end of the string
+//   (...)    A group.  (?:...) is accepted as a synonym.
+//   a|b      Either a or b
+//   * + ?    Zero or more, one or more, or zero or one of the preceeding item
+//   {m,n}    Between m and n of the preceeding item.  {m} and {m,} are also
+//            accepted.
+//
+
+/**
+ A value indicating no state.
+ */
+#define YORI_LIB_REGEX_NONE ((YORI_ALLOC_SIZE_T)-1)
+
+/**
+ The maximum number of states in a compiled expression.  This bounds the
+ expansion of counted repetition, and the cost of a search.
+ */
+#define YORI_LIB_REGEX_MAX_STATES (0x10000)
+
+/**
+ The maximum number of repetitions that can be specified with {m,n}.
+ */
+#define YORI_LIB_REGEX_MAX_REPEAT (1000)
+
+/**
+ The maximum depth of nested groups.
+ */
+#define YORI_LIB_REGEX_MAX_DEPTH (256)
+
+/**
+ The number of states that can be searched without allocating memory.
+ */
+#define YORI_LIB_REGEX_STACK_STATES (64)
+
+/**
+ A portion of an automaton that is being constructed.
+ */
+typedef struct _YORI_LIB_REGEX_FRAGMENT {
+
+    /**
+     The state to enter the fragment.
+     */
+    YORI_ALLOC_SIZE_T Start;
+
+    /**
+     A list of transitions out of the fragment which have not yet been
+     connected to a following state.  Each entry is encoded as one more
+     than twice the state index, plus one if the transition is Out1.  Zero
+     terminates the list, which is linked through the unconnected
+     transitions themselves.
+     */
+    YORI_ALLOC_SIZE_T Dangling;
+} YORI_LIB_REGEX_FRAGMENT, *PYORI_LIB_REGEX_FRAGMENT;
+
+/**
+ Context used while compiling an expression.
+ */
+typedef struct _YORI_LIB_REGEX_PARSE {
+
+    /**
+     The expression being compiled.
+     */
+    PYORI_LIB_REGEX Regex;
+
+    /**
+     The text of the expression.
+     */
+    PCYORI_STRING Pattern;
+
+    /**
+     The current offset within Pattern.
+     */
+    YORI_ALLOC_SIZE_T Offset;
+
+    /**
+     The number of elements allocated in the States array.
+     */
+    YORI_ALLOC_SIZE_T StatesAllocated;
+
+    /**
+     The number of elements allocated in the Ranges array.
+     */
+    YORI_ALLOC_SIZE_T RangesAllocated;
+
+    /**
+     The current depth of nested groups.
+     */
+    YORI_ALLOC_SIZE_T Depth;
+
+    /**
+     Set to TRUE if the expression is invalid or memory could not be
+     allocated.
+     */
+    BOOLEAN Error;
+} YORI_LIB_REGEX_PARSE, *PYORI_LIB_REGEX_PARSE;
+
+/**
+ Return TRUE if a character is considered a word character for \w and \b.
+
+ @param Char The character to check.
+
+ @return TRUE if the character is a word character, FALSE if not.
+ */
+BOOLEAN
+YoriLibRegexIsWordChar(
+    __in TCHAR Char
+    )
+{
+    if ((Char >= '0' && Char <= '9') ||
+        (Char >= 'A' && Char <= 'Z') ||
+        (Char >= 'a' && Char <= 'z') ||
+        Char == '_') {
+
+        return TRUE;
+    }
+    return FALSE;
+}
+
+/**
+ Allocate a new state in the automaton being compiled.
+
+ @param Parse Pointer to the compile context.
+
+ @param Type The type of the new state.
+
+ @return The index of the new state, or YORI_LIB_REGEX_NONE on failure.
+ */
+YORI_ALLOC_SIZE_T
+YoriLibRegexNewState(
+    __inout PYORI_LIB_REGEX_PARSE Parse,
+    __in YORI_LIB_REGEX_STATE_TYPE Type
+    )
+{
+    PYORI_LIB_REGEX Regex;
+    PYORI_LIB_REGEX_STATE NewStates;
+    PYORI_LIB_REGEX_STATE State;
+    YORI_ALLOC_SIZE_T NewAllocated;
+
+    Regex = Parse->Regex;
+    if (Regex->StateCount >= Parse->StatesAllocated) {
+        if (Parse->StatesAllocated >= YORI_LIB_REGEX_MAX_STATES) {
+            Parse->Error = TRUE;
+            return YORI_LIB_REGEX_NONE;
+        }
+        NewAllocated = Parse->StatesAllocated * 2;
+        if (NewAllocated < 16) {
+            NewAllocated = 16;
+        }
+        if (NewAllocated > YORI_LIB_REGEX_MAX_STATES) {
+            NewAllocated = YORI_LIB_REGEX_MAX_STATES;
+        }
+        NewStates = YoriLibMalloc((YORI_ALLOC_SIZE_T)(NewAllocated * sizeof(YORI_LIB_REGEX_STATE)));
+        if (NewStates == NULL) {
+            Parse->Error = TRUE;
+            return YORI_LIB_REGEX_NONE;
+        }
+        if (Regex->States != NULL) {
+            memcpy(NewStates, Regex->States, Regex->StateCount * sizeof(YORI_LIB_REGEX_STATE));
+            YoriLibFree(Regex->States);
+        }
+        Regex->States = NewStates;
+        Parse->StatesAllocated = NewAllocated;
+    }
+
+    State = &Regex->States[Regex->StateCount];
+    ZeroMemory(State, sizeof(YORI_LIB_REGEX_STATE));
+    State->Type = Type;
+    Regex->StateCount++;
+    return Regex->StateCount - 1;
+}
+
+/**
+ Add a range of characters to the set being compiled for a class.
+
+ @param Parse Pointer to the compile context.
+
+ @param Low The lowest character in the range.
+
+ @param High The highest character in the range.
+ */
+VOID
+YoriLibRegexAddRange(
+    __inout PYORI_LIB_REGEX_PARSE Parse,
+    __in TCHAR Low,
+    __in TCHAR High
+    )
+{
+    PYORI_LIB_REGEX Regex;
+    PYORI_LIB_REGEX_RANGE NewRanges;
+    YORI_ALLOC_SIZE_T NewAllocated;
+
+    Regex = Parse->Regex;
+    if (Regex->RangeCount >= Parse->RangesAllocated) {
+        NewAllocated = Parse->RangesAllocated * 2;
+        if (NewAllocated < 16) {
+            NewAllocated = 16;
+        }
+        if (!YoriLibIsSizeAllocatable((YORI_MAX_UNSIGNED_T)NewAllocated * sizeof(YORI_LIB_REGEX_RANGE))) {
+            Parse->Error = TRUE;
+            return;
+        }
+        NewRanges = YoriLibMalloc((YORI_ALLOC_SIZE_T)(NewAllocated * sizeof(YORI_LIB_REGEX_RANGE)));
+        if (NewRanges == NULL) {
+            Parse->Error = TRUE;
+            return;
+        }
+        if (Regex->Ranges != NULL) {
+            memcpy(NewRanges, Regex->Ranges, Regex->RangeCount * sizeof(YORI_LIB_REGEX_RANGE));
+            YoriLibFree(Regex->Ranges);
+        }
+        Regex->Ranges = NewRanges;
+        Parse->RangesAllocated = NewAllocated;
+    }
+
+    Regex->Ranges[Regex->RangeCount].Low = Low;
+    Regex->Ranges[Regex->RangeCount].High = High;
+    Regex->RangeCount++;
+}
+
+/**
+ Add the ranges for a \d, \w or \s class.
+
+ @param Parse Pointer to the compile context.
+
+ @param Class The character following the backslash, in lower case.
+ */
+VOID
+YoriLibRegexAddShorthandRanges(
+    __inout PYORI_LIB_REGEX_PARSE Parse,
+    __in TCHAR Class
+    )
+{
+    if (Class == 'd') {
+        YoriLibRegexAddRange(Parse, '0', '9');
+    } else if (Class == 'w') {
+        YoriLibRegexAddRange(Parse, '0', '9');
+        YoriLibRegexAddRange(Parse, 'A', 'Z');
+        YoriLibRegexAddRange(Parse, 'a', 'z');
+        YoriLibRegexAddRange(Parse, '_', '_');
+    } else if (Class == 's') {
+        YoriLibRegexAddRange(Parse, ' ', ' ');
+        YoriLibRegexAddRange(Parse, '\t', '\r');
+    }
+}
+
+/**
+ Return the address of a transition that has not yet been connected.
+
+ @param Parse Pointer to the compile context.
+
+ @param Entry An encoded entry from a dangling list.
+
+ @return Pointer to the transition.
+ */
+PYORI_ALLOC_SIZE_T
+YoriLibRegexDanglingTransition(
+    __in PYORI_LIB_REGEX_PARSE Parse,
+    __in YORI_ALLOC_SIZE_T Entry
+    )
+{
+    PYORI_LIB_REGEX_STATE State;
+
+    State = &Parse->Regex->States[(Entry - 1) / 2];
+    if (((Entry - 1) % 2) == 0) {
+        return &State->Out;
+    }
+    return &State->Out1;
+}
+
+/**
+ Connect every transition in a dangling list to a state.
+
+ @param Parse Pointer to the compile context.
+
+ @param Dangling The list of transitions to connect.
+
+ @param Target The state to connect them to.
+ */
+VOID
+YoriLibRegexPatch(
+    __in PYORI_LIB_REGEX_PARSE Parse,
+    __in YORI_ALLOC_SIZE_T Dangling,
+    __in YORI_ALLOC_SIZE_T Target
+    )
+{
+    PYORI_ALLOC_SIZE_T Transition;
+
+    while (Dangling != 0) {
+        Transition = YoriLibRegexDanglingTransition(Parse, Dangling);
+        Dangling = *Transition;
+        *Transition = Target;
+    }
+}
+
+/**
+ Combine two dangling lists.
+
+ @param Parse Pointer to the compile context.
+
+ @param First The first list.
+
+ @param Second The second list.
+
+ @return The combined list.
+ */
+YORI_ALLOC_SIZE_T
+YoriLibRegexAppendDangling(
+    __in PYORI_LIB_REGEX_PARSE Parse,
+    __in YORI_ALLOC_SIZE_T First,
+    __in YORI_ALLOC_SIZE_T Second
+    )
+{
+    PYORI_ALLOC_SIZE_T Transition;
+    YORI_ALLOC_SIZE_T Entry;
+
+    if (First == 0) {
+        return Second;
+    }
+
+    Entry = First;
+    while (TRUE) {
+        Transition = YoriLibRegexDanglingTransition(Parse, Entry);
+        if (*Transition == 0) {
+            break;
+        }
+        Entry = *Transition;
+    }
+    *Transition = Second;
+    return First;
+}
+
+/**
+ Generate a fragment which consists of a single state with one transition
+ out of it.
+
+ @param Parse Pointer to the compile context.
+
+ @param Type The type of the state.
+
+ @param Fragment On successful completion, populated with the fragment.
+
+ @return The index of the new state, or YORI_LIB_REGEX_NONE on failure.
+ */
+YORI_ALLOC_SIZE_T
+YoriLibRegexSingleStateFragment(
+    __inout PYORI_LIB_REGEX_PARSE Parse,
+    __in YORI_LIB_REGEX_STATE_TYPE Type,
+    __out PYORI_LIB_REGEX_FRAGMENT Fragment
+    )
+{
+    YORI_ALLOC_SIZE_T State;
+
+    State = YoriLibRegexNewState(Parse, Type);
+    if (State == YORI_LIB_REGEX_NONE) {
+        Fragment->Start = 0;
+        Fragment->Dangling = 0;
+        return State;
+    }
+
+    Fragment->Start = State;
+    Fragment->Dangling = State * 2 + 1;
+    return State;
+}
+
+/**
+ Connect one fragment to follow another.
+
+ @param Parse Pointer to the compile context.
+
+ @param First On input, the first fragment.  On output, the combined
+        fragment.
+
+ @param Second The fragment to follow First.
+ */
+VOID
+YoriLibRegexConcatenate(
+    __in PYORI_LIB_REGEX_PARSE Parse,
+    __inout PYORI_LIB_REGEX_FRAGMENT First,
+    __in PYORI_LIB_REGEX_FRAGMENT Second
+    )
+{
+    YoriLibRegexPatch(Parse, First->Dangling, Second->Start);
+    First->Dangling = Second->Dangling;
+}
+
+/**
+ Parse a hex digit.
+
+ @param Char The character to parse.
+
+ @return The value of the digit, or -1 if the character is not a hex digit.
+ */
+INT
+YoriLibRegexHexDigit(
+    __in TCHAR Char
+    )
+{
+    if (Char >= '0' && Char <= '9') {
+        return Char - '0';
+    } else if (Char >= 'a' && Char <= 'f') {
+        return Char - 'a' + 10;
+    } else if (Char >= 'A' && Char <= 'F') {
+        return Char - 'A' + 10;
+    }
+    return -1;
+}
+
+/**
+ Parse an escaped literal character.  The backslash has already been
+ consumed.
+
+ @param Parse Pointer to the compile context.
+
+ @param Char On successful completion, populated with the character.
+
+ @return TRUE to indicate success, FALSE to indicate an invalid escape.
+ */
+__success(return)
+BOOLEAN
+YoriLibRegexParseEscapedChar(
+    __inout PYORI_LIB_REGEX_PARSE Parse,
+    __out PTCHAR Char
+    )
+{
+    PCYORI_STRING Pattern;
+    TCHAR Escaped;
+    INT High;
+    INT Low;
+
+    Pattern = Parse->Pattern;
+    if (Parse->Offset >= Pattern->LengthInChars) {
+        return FALSE;
+    }
+
+    Escaped = Pattern->StartOfString[Parse->Offset];
+    Parse->Offset++;
+
+    if (Escaped == 'n') {
+        *Char = '\n';
+    } else if (Escaped == 'r') {
+        *Char = '\r';
+    } else if (Escaped == 't') {
+        *Char = '\t';
+    } else if (Escaped == 'x') {
+        if (Parse->Offset + 2 > Pattern->LengthInChars) {
+            return FALSE;
+        }
+        High = YoriLibRegexHexDigit(Pattern->StartOfString[Parse->Offset]);
+        Low = YoriLibRegexHexDigit(Pattern->StartOfString[Parse->Offset + 1]);
+        if (High < 0 || Low < 0) {
+            return FALSE;
+        }
+        Parse->Offset = Parse->Offset + 2;
+        *Char = (TCHAR)(High * 16 + Low);
+    } else if (YoriLibRegexIsWordChar(Escaped)) {
+        return FALSE;
+    } else {
+        *Char = Escaped;
+    }
+
+    return TRUE;
+}
+
+/**
+ When matching case insensitively, add the upper case form of each
+ character in the ranges of a class, so that the class matches if either a
+ character or its upper case form is in the class.
+
+ @param Parse Pointer to the compile context.
+
+ @param FirstRange The index of the first range in the class.
+ */
+VOID
+YoriLibRegexFoldRanges(
+    __inout PYORI_LIB_REGEX_PARSE Parse,
+    __in YORI_ALLOC_SIZE_T FirstRange
+    )
+{
+    YORI_ALLOC_SIZE_T Index;
+    YORI_ALLOC_SIZE_T LastRange;
+    YORI_LIB_REGEX_RANGE Range;
+    TCHAR Char;
+    TCHAR Upcased;
+    PYORI_LIB_REGEX_RANGE NewRange;
+
+    LastRange = Parse->Regex->RangeCount;
+    for (Index = FirstRange; Index < LastRange && !Parse->Error; Index++) {
+        Range = Parse->Regex->Ranges[Index];
+
+        //
+        //  Very large ranges typically already contain their upper case
+        //  forms, and would take too long to fold one at a time.
+        //
+
+        if (Range.High - Range.Low > 0x800) {
+            continue;
+        }
+
+        Char = Range.Low;
+        while (TRUE) {
+            Upcased = YoriLibUpcaseChar(Char);
+            if (Upcased != Char) {
+                NewRange = &Parse->Regex->Ranges[Parse->Regex->RangeCount - 1];
+                if (Parse->Regex->RangeCount > LastRange && NewRange->High + 1 == Upcased) {
+                    NewRange->High = Upcased;
+                } else {
+                    YoriLibRegexAddRange(Parse, Upcased, Upcased);
+                    if (Parse->Error) {
+                        return;
+                    }
+                }
+            }
+            if (Char == Range.High) {
+                break;
+            }
+            Char++;
+        }
+    }
+}
+
+/**
+ Parse a character class, such as [a-z].  The opening bracket has already
+ been consumed.
+
+ @param Parse Pointer to the compile context.
+
+ @param Fragment On successful completion, populated with the fragment that
+        matches the class.
+ */
+VOID
+YoriLibRegexParseClass(
+    __inout PYORI_LIB_REGEX_PARSE Parse,
+    __out PYORI_LIB_REGEX_FRAGMENT Fragment
+    )
+{
+    PCYORI_STRING Pattern;
+    PYORI_LIB_REGEX_STATE State;
+    YORI_ALLOC_SIZE_T StateIndex;
+    YORI_ALLOC_SIZE_T FirstRange;
+    BOOLEAN Negate;
+    BOOLEAN First;
+    TCHAR Low;
+    TCHAR High;
+    TCHAR Char;
+
+    Pattern = Parse->Pattern;
+    Negate = FALSE;
+    if (Parse->Offset < Pattern->LengthInChars && Pattern->StartOfString[Parse->Offset] == '^') {
+        Negate = TRUE;
+        Parse->Offset++;
+    }
+
+    FirstRange = Parse->Regex->RangeCount;
+    First = TRUE;
+    while (TRUE) {
+        if (Parse->Offset >= Pattern->LengthInChars) {
+            Parse->Error = TRUE;
+            return;
+        }
+
+        Char = Pattern->StartOfString[Parse->Offset];
+        Parse->Offset++;
+
+        //
+        //  A closing bracket immediately after the opening bracket is
+        //  treated as a literal.
+        //
+
+        if (Char == ']' && !First) {
+            break;
+        }
+        First = FALSE;
+
+        if (Char == '\\') {
+            if (Parse->Offset < Pattern->LengthInChars) {
+                Char = Pattern->StartOfString[Parse->Offset];
+                if (Char == 'd' || Char == 'w' || Char == 's') {
+                    Parse->Offset++;
+                    YoriLibRegexAddShorthandRanges(Parse, Char);
+                    continue;
+                }
+            }
+            if (!YoriLibRegexParseEscapedChar(Parse, &Low)) {
+                Parse->Error = TRUE;
+                return;
+            }
+        } else {
+            Low = Char;
+        }
+
+        High = Low;
+        if (Parse->Offset + 1 < Pattern->LengthInChars &&
+            Pattern->StartOfString[Parse->Offset] == '-' &&
+            Pattern->StartOfString[Parse->Offset + 1] != ']') {
+
+            Parse->Offset++;
+            Char = Pattern->StartOfString[Parse->Offset];
+            Parse->Offset++;
+            if (Char == '\\') {
+                if (!YoriLibRegexParseEscapedChar(Parse, &High)) {
+                    Parse->Error = TRUE;
+                    return;
+                }
+            } else {
+                High = Char;
+            }
+            if (High < Low) {
+                Parse->Error = TRUE;
+                return;
+            }
+        }
+
+        YoriLibRegexAddRange(Parse, Low, High);
+        if (Parse->Error) {
+            return;
+        }
+    }
+
+    if (Parse->Regex->Insensitive) {
+        YoriLibRegexFoldRanges(Parse, FirstRange);
+    }
+
+    StateIndex = YoriLibRegexSingleStateFragment(Parse, YoriLibRegexStateClass, Fragment);
+    if (StateIndex == YORI_LIB_REGEX_NONE) {
+        return;
+    }
+    State = &Parse->Regex->States[StateIndex];
+    State->Negate = Negate;
+    State->FirstRange = FirstRange;
+    State->RangeCount = Parse->Regex->RangeCount - FirstRange;
+}
+
+VOID
+YoriLibRegexParseAlternation(
+    __inout PYORI_LIB_REGEX_PARSE Parse,
+    __out PYORI_LIB_REGEX_FRAGMENT Fragment
+    );
+
+/**
+ Parse a single item in an expression, such as a character, class or group.
+
+ @param Parse Pointer to the compile context.
+
+ @param Fragment On successful completion, populated with the fragment for
+        the item.
+ */
+VOID
+YoriLibRegexParseAtom(
+    __inout PYORI_LIB_REGEX_PARSE Parse,
+    __out PYORI_LIB_REGEX_FRAGMENT Fragment
+    )
+{
+    PCYORI_STRING Pattern;
+    PYORI_LIB_REGEX_STATE State;
+    YORI_ALLOC_SIZE_T StateIndex;
+    YORI_LIB_REGEX_STATE_TYPE Type;
+    TCHAR Char;
+
+    Pattern = Parse->Pattern;
+    Fragment->Start = 0;
+    Fragment->Dangling = 0;
+
+    Char = Pattern->StartOfString[Parse->Offset];
+    Parse->Offset++;
+
+    if (Char == '(') {
+        if (Parse->Depth >= YORI_LIB_REGEX_MAX_DEPTH) {
+            Parse->Error = TRUE;
+            return;
+        }
+        if (Parse->Offset + 1 < Pattern->LengthInChars &&
+            Pattern->StartOfString[Parse->Offset] == '?' &&
+            Pattern->StartOfString[Parse->Offset + 1] == ':') {
+
+            Parse->Offset = Parse->Offset + 2;
+        }
+        Parse->Depth++;
+        YoriLibRegexParseAlternation(Parse, Fragment);
+        Parse->Depth--;
+        if (Parse->Error) {
+            return;
+        }
+        if (Parse->Offset >= Pattern->LengthInChars ||
+            Pattern->StartOfString[Parse->Offset] != ')') {
+
+            Parse->Error = TRUE;
+            return;
+        }
+        Parse->Offset++;
+        return;
+    }
+
+    if (Char == '[') {
+        YoriLibRegexParseClass(Parse, Fragment);
+        return;
+    }
+
+    if (Char == '.') {
+        YoriLibRegexSingleStateFragment(Parse, YoriLibRegexStateAny, Fragment);
+        return;
+    }
+
+    if (Char == '^' || Char == '$') {
+        if (Char == '^') {
+            Type = YoriLibRegexStateBeginLine;
+        } else {
+            Type = YoriLibRegexStateEndLine;
+        }
+        YoriLibRegexSingleStateFragment(Parse, Type, Fragment);
+        return;
+    }
+
+    if (Char == '*' || Char == '+' || Char == '?' || Char == ')') {
+        Parse->Error = TRUE;
+        return;
+    }
+
+    if (Char == '\\') {
+        if (Parse->Offset < Pattern->LengthInChars) {
+            Char = Pattern->StartOfString[Parse->Offset];
+            if (Char == 'b' || Char == 'B') {
+                Parse->Offset++;
+                if (Char == 'b') {
+                    Type = YoriLibRegexStateWordBoundary;
+                } else {
+                    Type = YoriLibRegexStateNotWordBoundary;
+                }
+                YoriLibRegexSingleStateFragment(Parse, Type, Fragment);
+                return;
+            }
+            if (Char == 'd' || Char == 'w' || Char == 's' ||
+                Char == 'D' || Char == 'W' || Char == 'S') {
+
+                Parse->Offset++;
+                StateIndex = YoriLibRegexSingleStateFragment(Parse, YoriLibRegexStateClass, Fragment);
+                if (StateIndex == YORI_LIB_REGEX_NONE) {
+                    return;
+                }
+                State = &Parse->Regex->States[StateIndex];
+                State->FirstRange = Parse->Regex->RangeCount;
+                if (Char == 'D' || Char == 'W' || Char == 'S') {
+                    State->Negate = TRUE;
+                    Char = (TCHAR)(Char - 'A' + 'a');
+                }
+                YoriLibRegexAddShorthandRanges(Parse, Char);
+                State = &Parse->Regex->States[StateIndex];
+                State->RangeCount = Parse->Regex->RangeCount - State->FirstRange;
+                return;
+            }
+        }
+
+        if (!YoriLibRegexParseEscapedChar(Parse, &Char)) {
+            Parse->Error = TRUE;
+            return;
+        }
+    }
+
+    StateIndex = YoriLibRegexSingleStateFragment(Parse, YoriLibRegexStateChar, Fragment);
+    if (StateIndex == YORI_LIB_REGEX_NONE) {
+        return;
+    }
+    if (Parse->Regex->Insensitive) {
+        Char = YoriLibUpcaseChar(Char);
+    }
+    Parse->Regex->States[StateIndex].Char = Char;
+}
+
+/**
+ Parse a decimal number within a counted repetition.
+
+ @param Parse Pointer to the compile context.
+
+ @param Value On successful completion, populated with the number.
+
+ @return TRUE if a number was found, FALSE if not.
+ */
+__success(return)
+BOOLEAN
+YoriLibRegexParseCount(
+    __inout PYORI_LIB_REGEX_PARSE Parse,
+    __out PYORI_ALLOC_SIZE_T Value
+    )
+{
+    PCYORI_STRING Pattern;
+    YORI_ALLOC_SIZE_T Result;
+    BOOLEAN Found;
+    TCHAR Char;
+
+    Pattern = Parse->Pattern;
+    Result = 0;
+    Found = FALSE;
+    while (Parse->Offset < Pattern->LengthInChars) {
+        Char = Pattern->StartOfString[Parse->Offset];
+        if (Char < '0' || Char > '9') {
+            break;
+        }
+        Result = Result * 10 + Char - '0';
+        if (Result > YORI_LIB_REGEX_MAX_REPEAT) {
+            return FALSE;
+        }
+        Found = TRUE;
+        Parse->Offset++;
+    }
+
+    *Value = Result;
+    return Found;
+}
+
+/**
+ Check whether the pattern at the current offset is a counted repetition,
+ and if so, parse it.  If the text is not a valid repetition, the offset is
+ not changed, and the brace is treated as a literal.
+
+ @param Parse Pointer to the compile context.
+
+ @param Minimum On successful completion, populated with the minimum number
+        of repetitions.
+
+ @param Maximum On successful completion, populated with the maximum number
+        of repetitions, or YORI_LIB_REGEX_NONE if there is no maximum.
+
+ @return TRUE if a counted repetition was parsed, FALSE if not.
+ */
+__success(return)
+BOOLEAN
+YoriLibRegexParseCountedRepeat(
+    __inout PYORI_LIB_REGEX_PARSE Parse,
+    __out PYORI_ALLOC_SIZE_T Minimum,
+    __out PYORI_ALLOC_SIZE_T Maximum
+    )
+{
+    PCYORI_STRING Pattern;
+    YORI_ALLOC_SIZE_T SavedOffset;
+
+    Pattern = Parse->Pattern;
+    SavedOffset = Parse->Offset;
+
+    Parse->Offset++;
+    if (!YoriLibRegexParseCount(Parse, Minimum)) {
+        Parse->Offset = SavedOffset;
+        return FALSE;
+    }
+
+    *Maximum = *Minimum;
+    if (Parse->Offset < Pattern->LengthInChars && Pattern->StartOfString[Parse->Offset] == ',') {
+        Parse->Offset++;
+        if (!YoriLibRegexParseCount(Parse, Maximum)) {
+            *Maximum = YORI_LIB_REGEX_NONE;
+        }
+    }
+
+    if (Parse->Offset >= Pattern->LengthInChars ||
+        Pattern->StartOfString[Parse->Offset] != '}' ||
+        (*Maximum != YORI_LIB_REGEX_NONE && *Maximum < *Minimum)) {
+
+        Parse->Offset = SavedOffset;
+        return FALSE;
+    }
+
+    Parse->Offset++;
+    return TRUE;
+}
+
+/**
+ Apply a *, + or ? operator to a fragment.
+
+ @param Parse Pointer to the compile context.
+
+ @param Fragment On input, the fragment to repeat.  On output, the repeated
+        fragment.
+
+ @param Operator The operator to apply.
+ */
+VOID
+YoriLibRegexApplyOperator(
+    __inout PYORI_LIB_REGEX_PARSE Parse,
+    __inout PYORI_LIB_REGEX_FRAGMENT Fragment,
+    __in TCHAR Operator
+    )
+{
+    PYORI_LIB_REGEX_STATE State;
+    YORI_ALLOC_SIZE_T Split;
+
+    Split = YoriLibRegexNewState(Parse, YoriLibRegexStateSplit);
+    if (Split == YORI_LIB_REGEX_NONE) {
+        return;
+    }
+
+    State = &Parse->Regex->States[Split];
+    State->Out = Fragment->Start;
+    State->Out1 = 0;
+
+    if (Operator == '?') {
+        Fragment->Start = Split;
+        Fragment->Dangling = YoriLibRegexAppendDangling(Parse, Fragment->Dangling, Split * 2 + 2);
+    } else if (Operator == '*') {
+        YoriLibRegexPatch(Parse, Fragment->Dangling, Split);
+        Fragment->Start = Split;
+        Fragment->Dangling = Split * 2 + 2;
+    } else {
+        YoriLibRegexPatch(Parse, Fragment->Dangling, Split);
+        Fragment->Dangling = Split * 2 + 2;
+    }
+}
+
+/**
+ Parse an item followed by any repetition operator.
+
+ @param Parse Pointer to the compile context.
+
+ @param Fragment On successful completion, populated with the fragment.
+ */
+VOID
+YoriLibRegexParseRepeat(
+    __inout PYORI_LIB_REGEX_PARSE Parse,
+    __out PYORI_LIB_REGEX_FRAGMENT Fragment
+    )
+{
+    PCYORI_STRING Pattern;
+    YORI_LIB_REGEX_FRAGMENT Copy;
+    YORI_ALLOC_SIZE_T AtomOffset;
+    YORI_ALLOC_SIZE_T EndOffset;
+    YORI_ALLOC_SIZE_T Minimum;
+    YORI_ALLOC_SIZE_T Maximum;
+    YORI_ALLOC_SIZE_T CopyCount;
+    YORI_ALLOC_SIZE_T Index;
+    BOOLEAN HaveFragment;
+    TCHAR Char;
+
+    Pattern = Parse->Pattern;
+    AtomOffset = Parse->Offset;
+    YoriLibRegexParseAtom(Parse, Fragment);
+    if (Parse->Error || Parse->Offset >= Pattern->LengthInChars) {
+        return;
+    }
+
+    Char = Pattern->StartOfString[Parse->Offset];
+    if (Char == '*' || Char == '+' || Char == '?') {
+        Parse->Offset++;
+        YoriLibRegexApplyOperator(Parse, Fragment, Char);
+    } else if (Char == '{' && YoriLibRegexParseCountedRepeat(Parse, &Minimum, &Maximum)) {
+
+        //
+        //  A counted repetition requires a separate copy of the item for
+        //  each repetition, which is generated by parsing the item again.
+        //  The first copy has already been generated.
+        //
+
+        EndOffset = Parse->Offset;
+        HaveFragment = FALSE;
+        if (Maximum == YORI_LIB_REGEX_NONE) {
+            CopyCount = Minimum + 1;
+        } else {
+            CopyCount = Maximum;
+        }
+        for (Index = 0; Index < CopyCount; Index++) {
+            if (Index == 0) {
+                Copy = *Fragment;
+            } else {
+                Parse->Offset = AtomOffset;
+                YoriLibRegexParseAtom(Parse, &Copy);
+                if (Parse->Error) {
+                    return;
+                }
+            }
+
+            if (Index >= Minimum) {
+                if (Maximum == YORI_LIB_REGEX_NONE) {
+                    YoriLibRegexApplyOperator(Parse, &Copy, '*');
+                } else {
+                    YoriLibRegexApplyOperator(Parse, &Copy, '?');
+                }
+                if (Parse->Error) {
+                    return;
+                }
+            }
+
+            if (HaveFragment) {
+                YoriLibRegexConcatenate(Parse, Fragment, &Copy);
+            } else {
+                *Fragment = Copy;
+                HaveFragment = TRUE;
+            }
+        }
+
+        Parse->Offset = EndOffset;
+
+        //
+        //  If the item can occur zero times, it matches nothing.
+        //
+
+        if (!HaveFragment) {
+            YoriLibRegexSingleStateFragment(Parse, YoriLibRegexStateEmpty, Fragment);
+        }
+    } else {
+        return;
+    }
+
+    if (Parse->Error) {
+        return;
+    }
+
+    //
+    //  A following ? would make the repetition nongreedy, which has no
+    //  effect when finding the longest match.  Anything else that repeats
+    //  a repetition is an error.
+    //
+
+    if (Parse->Offset < Pattern->LengthInChars) {
+        Char = Pattern->StartOfString[Parse->Offset];
+        if (Char == '?') {
+            Parse->Offset++;
+            if (Parse->Offset < Pattern->LengthInChars) {
+                Char = Pattern->StartOfString[Parse->Offset];
+            }
+        }
+        if (Parse->Offset < Pattern->LengthInChars &&
+            (Char == '*' || Char == '+' || Char == '?')) {
+            Parse->Error = TRUE;
+        }
+    }
+}
+
+/**
+ Parse a sequence of items which must match one after another.
+
+ @param Parse Pointer to the compile context.
+
+ @param Fragment On successful completion, populated with the fragment.
+ */
+VOID
+YoriLibRegexParseConcatenation(
+    __inout PYORI_LIB_REGEX_PARSE Parse,
+    __out PYORI_LIB_REGEX_FRAGMENT Fragment
+    )
+{
+    PCYORI_STRING Pattern;
+    YORI_LIB_REGEX_FRAGMENT Next;
+    BOOLEAN HaveFragment;
+    TCHAR Char;
+
+    Pattern = Parse->Pattern;
+    HaveFragment = FALSE;
+    Fragment->Start = 0;
+    Fragment->Dangling = 0;
+
+    while (Parse->Offset < Pattern->LengthInChars) {
+        Char = Pattern->StartOfString[Parse->Offset];
+        if (Char == '|' || Char == ')') {
+            break;
+        }
+
+        YoriLibRegexParseRepeat(Parse, &Next);
+        if (Parse->Error) {
+            return;
+        }
+
+        if (HaveFragment) {
+            YoriLibRegexConcatenate(Parse, Fragment, &Next);
+        } else {
+            *Fragment = Next;
+            HaveFragment = TRUE;
+        }
+    }
+
+    if (!HaveFragment) {
+        YoriLibRegexSingleStateFragment(Parse, YoriLibRegexStateEmpty, Fragment);
+    }
+}
+
+/**
+ Parse a set of alternatives separated by |.
+
+ @param Parse Pointer to the compile context.
+
+ @param Fragment On successful completion, populated with the fragment.
+ */
+VOID
+YoriLibRegexParseAlternation(
+    __inout PYORI_LIB_REGEX_PARSE Parse,
+    __out PYORI_LIB_REGEX_FRAGMENT Fragment
+    )
+{
+    PCYORI_STRING Pattern;
+    PYORI_LIB_REGEX_STATE State;
+    YORI_LIB_REGEX_FRAGMENT Next;
+    YORI_ALLOC_SIZE_T Split;
+
+    Pattern = Parse->Pattern;
+    YoriLibRegexParseConcatenation(Parse, Fragment);
+
+    while (!Parse->Error &&
+           Parse->Offset < Pattern->LengthInChars &&
+           Pattern->StartOfString[Parse->Offset] == '|') {
+
+        Parse->Offset++;
+        YoriLibRegexParseConcatenation(Parse, &Next);
+        if (Parse->Error) {
+            return;
+        }
+
+        Split = YoriLibRegexNewState(Parse, YoriLibRegexStateSplit);
+        if (Split == YORI_LIB_REGEX_NONE) {
+            return;
+        }
+        State = &Parse->Regex->States[Split];
+        State->Out = Fragment->Start;
+        State->Out1 = Next.Start;
+        Fragment->Start = Split;
+        Fragment->Dangling = YoriLibRegexAppendDangling(Parse, Fragment->Dangling, Next.Dangling);
+    }
+}
+
+/**
+ If every match of the expression must begin with a specific character,
+ record it, so that searches can skip quickly to the places where a match
+ could start.
+
+ @param Regex Pointer to the compiled expression.
+
+ @param Stack Pointer to an array of twice StateCount elements to use while
+        traversing the automaton.
+
+ @param Visited Pointer to an array of StateCount elements to use while
+        traversing the automaton.  These should be initialized to zero.
+ */
+VOID
+YoriLibRegexFindFirstChar(
+    __inout PYORI_LIB_REGEX Regex,
+    __in PYORI_ALLOC_SIZE_T Stack,
+    __in PYORI_ALLOC_SIZE_T Visited
+    )
+{
+    PYORI_LIB_REGEX_STATE State;
+    YORI_ALLOC_SIZE_T StackCount;
+    YORI_ALLOC_SIZE_T StateIndex;
+    BOOLEAN Found;
+    TCHAR Char;
+
+    Found = FALSE;
+    Char = 0;
+    StackCount = 0;
+    Stack[StackCount] = Regex->StartState;
+    StackCount++;
+
+    while (StackCount > 0) {
+        StackCount--;
+        StateIndex = Stack[StackCount];
+        if (Visited[StateIndex]) {
+            continue;
+        }
+        Visited[StateIndex] = 1;
+        State = &Regex->States[StateIndex];
+
+        switch(State->Type) {
+            case YoriLibRegexStateSplit:
+                Stack[StackCount] = State->Out1;
+                StackCount++;
+                Stack[StackCount] = State->Out;
+                StackCount++;
+                break;
+            case YoriLibRegexStateEmpty:
+                Stack[StackCount] = State->Out;
+                StackCount++;
+                break;
+            case YoriLibRegexStateChar:
+                if (Found && Char != State->Char) {
+                    return;
+                }
+                Found = TRUE;
+                Char = State->Char;
+                break;
+            default:
+                return;
+        }
+    }
+
+    if (Found) {
+        Regex->HasFirstChar = TRUE;
+        Regex->FirstChar = Char;
+    }
+}
+
+/**
+ Free any allocations within a compiled regular expression.  The structure
+ itself is typically a stack or embedded allocation and is not freed.
+
+ @param Regex Pointer to the compiled expression.
+ */
+VOID
+YoriLibRegexCleanup(
+    __inout PYORI_LIB_REGEX Regex
+    )
+{
+    if (Regex->States != NULL) {
+        YoriLibFree(Regex->States);
+        Regex->States = NULL;
+    }
+    if (Regex->Ranges != NULL) {
+        YoriLibFree(Regex->Ranges);
+        Regex->Ranges = NULL;
+    }
+    Regex->StateCount = 0;
+    Regex->RangeCount = 0;
+}
+
+/**
+ Compile a regular expression so that it can be used to search strings.
+
+ @param Regex Pointer to a structure to populate with the compiled
+        expression.  On success, the caller should call
+        @ref YoriLibRegexCleanup when it is no longer needed.
+
+ @param Pattern The regular expression.
+
+ @param Insensitive If TRUE, the expression matches case insensitively.
+
+ @param ErrorOffset Optionally points to a value which is populated with the
+        offset within Pattern where an error was detected, if the pattern is
+        not a valid regular expression.
+
+ @return TRUE to indicate success, FALSE to indicate the expression is not
+         valid or memory could not be allocated.
+ */
+__success(return)
+BOOL
+YoriLibRegexCompile(
+    __out PYORI_LIB_REGEX Regex,
+    __in PCYORI_STRING Pattern,
+    __in BOOLEAN Insensitive,
+    __out_opt PYORI_ALLOC_SIZE_T ErrorOffset
+    )
+{
+    YORI_LIB_REGEX_PARSE Parse;
+    YORI_LIB_REGEX_FRAGMENT Fragment;
+    YORI_ALLOC_SIZE_T MatchState;
+    PYORI_ALLOC_SIZE_T Scratch;
+
+    ZeroMemory(Regex, sizeof(YORI_LIB_REGEX));
+    Regex->Insensitive = Insensitive;
+
+    ZeroMemory(&Parse, sizeof(Parse));
+    Parse.Regex = Regex;
+    Parse.Pattern = Pattern;
+
+    YoriLibRegexParseAlternation(&Parse, &Fragment);
+
+    //
+    //  The only thing that can terminate parsing before the end of the
+    //  pattern is an unmatched closing parenthesis.
+    //
+
+    if (!Parse.Error && Parse.Offset < Pattern->LengthInChars) {
+        Parse.Error = TRUE;
+    }
+
+    if (!Parse.Error) {
+        MatchState = YoriLibRegexNewState(&Parse, YoriLibRegexStateMatch);
+        if (MatchState != YORI_LIB_REGEX_NONE) {
+            YoriLibRegexPatch(&Parse, Fragment.Dangling, MatchState);
+            Regex->StartState = Fragment.Start;
+        }
+    }
+
+    if (Parse.Error) {
+        if (ErrorOffset != NULL) {
+            *ErrorOffset = Parse.Offset;
+        }
+        YoriLibRegexCleanup(Regex);
+        return FALSE;
+    }
+
+    Scratch = YoriLibMalloc((YORI_ALLOC_SIZE_T)(Regex->StateCount * 3 * sizeof(YORI_ALLOC_SIZE_T)));
+    if (Scratch != NULL) {
+        ZeroMemory(Scratch, Regex->StateCount * 3 * sizeof(YORI_ALLOC_SIZE_T));
+        YoriLibRegexFindFirstChar(Regex, Scratch, &Scratch[Regex->StateCount * 2]);
+        YoriLibFree(Scratch);
+    }
+
+    return TRUE;
+}
+
+/**
+ Working state used while searching.
+ */
+typedef struct _YORI_LIB_REGEX_SEARCH {
+
+    /**
+     The expression being searched for.
+     */
+    PYORI_LIB_REGEX Regex;
+
+    /**
+     The string being searched.
+     */
+    PCYORI_STRING String;
+
+    /**
+     An array of states to follow when examining the current character.
+     */
+    PYORI_ALLOC_SIZE_T CurrentStates;
+
+    /**
+     For each element in CurrentStates, the offset where the match began.
+     */
+    PYORI_ALLOC_SIZE_T CurrentStarts;
+
+    /**
+     An array of states to follow when examining the next character.
+     */
+    PYORI_ALLOC_SIZE_T NextStates;
+
+    /**
+     For each element in NextStates, the offset where the match began.
+     */
+    PYORI_ALLOC_SIZE_T NextStarts;
+
+    /**
+     For each state, the generation of the list it was most recently added
+     to, used to add each state to a list once.
+     */
+    PYORI_ALLOC_SIZE_T Generation;
+
+    /**
+     An array of states whose epsilon transitions need to be followed.  Each
+     state pushes at most two more, so this can contain at most one more
+     element than the number of states, and is allocated with twice that.
+     */
+    PYORI_ALLOC_SIZE_T Stack;
+
+    /**
+     The number of elements in CurrentStates.
+     */
+    YORI_ALLOC_SIZE_T CurrentCount;
+
+    /**
+     The number of elements in NextStates.
+     */
+    YORI_ALLOC_SIZE_T NextCount;
+
+    /**
+     The generation of the list that states are currently being added to.
+     */
+    YORI_ALLOC_SIZE_T CurrentGeneration;
+} YORI_LIB_REGEX_SEARCH, *PYORI_LIB_REGEX_SEARCH;
+
+/**
+ Add a state to the list of states for the next character, following any
+ epsilon transitions.
+
+ @param Search Pointer to the search context.
+
+ @param StateIndex The state to add.
+
+ @param Start The offset in the string where the match that reached this
+        state began.
+
+ @param Offset The offset in the string of the next character to examine,
+        used to evaluate anchors.
+ */
+VOID
+YoriLibRegexAddState(
+    __inout PYORI_LIB_REGEX_SEARCH Search,
+    __in YORI_ALLOC_SIZE_T StateIndex,
+    __in YORI_ALLOC_SIZE_T Start,
+    __in YORI_ALLOC_SIZE_T Offset
+    )
+{
+    PYORI_LIB_REGEX_STATE State;
+    PCYORI_STRING String;
+    YORI_ALLOC_SIZE_T StackCount;
+    BOOLEAN PreviousWord;
+    BOOLEAN NextWord;
+
+    String = Search->String;
+    StackCount = 0;
+    Search->Stack[StackCount] = StateIndex;
+    StackCount++;
+
+    while (StackCount > 0) {
+        StackCount--;
+        StateIndex = Search->Stack[StackCount];
+        if (Search->Generation[StateIndex] == Search->CurrentGeneration) {
+            continue;
+        }
+        Search->Generation[StateIndex] = Search->CurrentGeneration;
+        State = &Search->Regex->States[StateIndex];
+
+        switch(State->Type) {
+            case YoriLibRegexStateSplit:
+                Search->Stack[StackCount] = State->Out1;
+                StackCount++;
+                Search->Stack[StackCount] = State->Out;
+                StackCount++;
+                break;
+            case YoriLibRegexStateEmpty:
+                Search->Stack[StackCount] = State->Out;
+                StackCount++;
+                break;
+            case YoriLibRegexStateBeginLine:
+                if (Offset == 0) {
+                    Search->Stack[StackCount] = State->Out;
+                    StackCount++;
+                }
+                break;
+            case YoriLibRegexStateEndLine:
+                if (Offset == String->LengthInChars) {
+                    Search->Stack[StackCount] = State->Out;
+                    StackCount++;
+                }
+                break;
+            case YoriLibRegexStateWordBoundary:
+            case YoriLibRegexStateNotWordBoundary:
+                PreviousWord = FALSE;
+                NextWord = FALSE;
+                if (Offset > 0) {
+                    PreviousWord = YoriLibRegexIsWordChar(String->StartOfString[Offset - 1]);
+                }
+                if (Offset < String->LengthInChars) {
+                    NextWord = YoriLibRegexIsWordChar(String->StartOfString[Offset]);
+                }
+                if ((PreviousWord != NextWord) == (State->Type == YoriLibRegexStateWordBoundary)) {
+                    Search->Stack[StackCount] = State->Out;
+                    StackCount++;
+                }
+                break;
+            default:
+                Search->NextStates[Search->NextCount] = StateIndex;
+                Search->NextStarts[Search->NextCount] = Start;
+                Search->NextCount++;
+                break;
+        }
+    }
+}
+
+/**
+ Return TRUE if a state that consumes a character matches the character.
+
+ @param Regex Pointer to the compiled expression.
+
+ @param State Pointer to the state.
+
+ @param Char The character to check.
+
+ @return TRUE if the state matches the character, FALSE if it does not.
+ */
+BOOLEAN
+YoriLibRegexStateMatchesChar(
+    __in PYORI_LIB_REGEX Regex,
+    __in PYORI_LIB_REGEX_STATE State,
+    __in TCHAR Char
+    )
+{
+    PYORI_LIB_REGEX_RANGE Range;
+    YORI_ALLOC_SIZE_T Index;
+    TCHAR Upcased;
+    BOOLEAN Found;
+
+    switch(State->Type) {
+        case YoriLibRegexStateChar:
+            if (Regex->Insensitive) {
+                Char = YoriLibUpcaseChar(Char);
+            }
+            return (BOOLEAN)(Char == State->Char);
+        case YoriLibRegexStateAny:
+            return TRUE;
+        case YoriLibRegexStateClass:
+            Found = FALSE;
+            Upcased = Char;
+            if (Regex->Insensitive) {
+                Upcased = YoriLibUpcaseChar(Char);
+            }
+            for (Index = 0; Index < State->RangeCount; Index++) {
+                Range = &Regex->Ranges[State->FirstRange + Index];
+                if ((Char >= Range->Low && Char <= Range->High) ||
+                    (Upcased >= Range->Low && Upcased <= Range->High)) {
+                    Found = TRUE;
+                    break;
+                }
+            }
+            return (BOOLEAN)(Found != State->Negate);
+        default:
+            break;
+    }
+
+    return FALSE;
+}
+
+/**
+ Search a string for the leftmost, longest, match of a regular expression.
+
+ @param Regex Pointer to the compiled expression.
+
+ @param String The string to search.  Anchors are evaluated relative to this
+        string.
+
+ @param StartOffset The offset within String to start searching from.  This
+        allows a string to be searched for successive matches while still
+        evaluating ^ and \b relative to the entire string.
+
+ @param MatchOffset On successful completion, populated with the offset
+        within String where the match begins.
+
+ @param MatchLength On successful completion, populated with the number of
+        characters in the match.  Note this may be zero if the expression
+        can match an empty string.
+
+ @return TRUE if a match was found, FALSE if it was not.
+ */
+__success(return)
+BOOL
+YoriLibRegexSearch(
+    __in PYORI_LIB_REGEX Regex,
+    __in PCYORI_STRING String,
+    __in YORI_ALLOC_SIZE_T StartOffset,
+    __out PYORI_ALLOC_SIZE_T MatchOffset,
+    __out PYORI_ALLOC_SIZE_T MatchLength
+    )
+{
+    YORI_LIB_REGEX_SEARCH Search;
+    YORI_ALLOC_SIZE_T StackBuffer[YORI_LIB_REGEX_STACK_STATES * 7];
+    PYORI_ALLOC_SIZE_T Buffer;
+    PYORI_ALLOC_SIZE_T Swap;
+    PYORI_ALLOC_SIZE_T SavedStates;
+    PYORI_ALLOC_SIZE_T SavedStarts;
+    PYORI_LIB_REGEX_STATE State;
+    YORI_ALLOC_SIZE_T StateCount;
+    YORI_ALLOC_SIZE_T Offset;
+    YORI_ALLOC_SIZE_T Index;
+    YORI_ALLOC_SIZE_T MatchStart;
+    YORI_ALLOC_SIZE_T MatchEnd;
+    TCHAR Char;
+
+    StateCount = Regex->StateCount;
+    if (StateCount == 0 || StartOffset > String->LengthInChars) {
+        return FALSE;
+    }
+
+    if (StateCount <= YORI_LIB_REGEX_STACK_STATES) {
+        Buffer = StackBuffer;
+    } else {
+        Buffer = YoriLibMalloc((YORI_ALLOC_SIZE_T)(StateCount * 7 * sizeof(YORI_ALLOC_SIZE_T)));
+        if (Buffer == NULL) {
+            return FALSE;
+        }
+    }
+
+    Search.Regex = Regex;
+    Search.String = String;
+    Search.CurrentStates = Buffer;
+    Search.CurrentStarts = &Buffer[StateCount];
+    Search.NextStates = &Buffer[StateCount * 2];
+    Search.NextStarts = &Buffer[StateCount * 3];
+    Search.Generation = &Buffer[StateCount * 4];
+    Search.Stack = &Buffer[StateCount * 5];
+    ZeroMemory(Search.Generation, StateCount * sizeof(YORI_ALLOC_SIZE_T));
+    Search.CurrentCount = 0;
+    Search.CurrentGeneration = 1;
+
+    MatchStart = YORI_LIB_REGEX_NONE;
+    MatchEnd = 0;
+    Offset = StartOffset;
+
+    while (TRUE) {
+
+        //
+        //  Until a match is found, start a new match at each offset.  Since
+        //  these start later than any match already in progress, they are
+        //  added after them, so the list remains ordered by where each
+        //  match started.  If no match is in progress and every match must
+        //  begin with a particular character, skip ahead to it.
+        //
+
+        if (MatchStart == YORI_LIB_REGEX_NONE) {
+            if (Search.CurrentCount == 0 && Regex->HasFirstChar) {
+                while (Offset < String->LengthInChars) {
+                    Char = String->StartOfString[Offset];
+                    if (Regex->Insensitive) {
+                        Char = YoriLibUpcaseChar(Char);
+                    }
+                    if (Char == Regex->FirstChar) {
+                        break;
+                    }
+                    Offset++;
+                }
+                if (Offset >= String->LengthInChars) {
+                    break;
+                }
+            }
+
+            SavedStates = Search.NextStates;
+            SavedStarts = Search.NextStarts;
+            Search.NextStates = Search.CurrentStates;
+            Search.NextStarts = Search.CurrentStarts;
+            Search.NextCount = Search.CurrentCount;
+            YoriLibRegexAddState(&Search, Regex->StartState, Offset, Offset);
+            Search.CurrentCount = Search.NextCount;
+            Search.NextStates = SavedStates;
+            Search.NextStarts = SavedStarts;
+        }
+
+        Search.CurrentGeneration++;
+        Search.NextCount = 0;
+
+        for (Index = 0; Index < Search.CurrentCount; Index++) {
+
+            //
+            //  Once a match is found, matches that start later can't be
+            //  used.
+            //
+
+            if (MatchStart != YORI_LIB_REGEX_NONE &&
+                Search.CurrentStarts[Index] > MatchStart) {
+
+                continue;
+            }
+
+            State = &Regex->States[Search.CurrentStates[Index]];
+            if (State->Type == YoriLibRegexStateMatch) {
+                if (MatchStart == YORI_LIB_REGEX_NONE ||
+                    Search.CurrentStarts[Index] < MatchStart ||
+                    Offset > MatchEnd) {
+
+                    MatchStart = Search.CurrentStarts[Index];
+                    MatchEnd = Offset;
+                }
+                continue;
+            }
+
+            if (Offset < String->LengthInChars &&
+                YoriLibRegexStateMatchesChar(Regex, State, String->StartOfString[Offset])) {
+
+                YoriLibRegexAddState(&Search, State->Out, Search.CurrentStarts[Index], Offset + 1);
+            }
+        }
+
+        Swap = Search.CurrentStates;
+        Search.CurrentStates = Search.NextStates;
+        Search.NextStates = Swap;
+        Swap = Search.CurrentStarts;
+        Search.CurrentStarts = Search.NextStarts;
+        Search.NextStarts = Swap;
+        Search.CurrentCount = Search.NextCount;
+
+        if (Offset >= String->LengthInChars) {
+            break;
+        }
+        Offset++;
+
+        if (Search.CurrentCount == 0 && MatchStart != YORI_LIB_REGEX_NONE) {
+            break;
+        }
+    }
+
+    if (Buffer != StackBuffer) {
+        YoriLibFree(Buffer);
+    }
+
+    if (MatchStart == YORI_LIB_REGEX_NONE) {
+        return FALSE;
+    }
+
+    *MatchOffset = MatchStart;
+    *MatchLength = MatchEnd - MatchStart;
+    return TRUE;
+}
+
+// vim:sw=4:ts=4:et:
@@ -156,77 +156,20 @@ YoriLibReallocateAttributeArray(
 }
 
 /**
- Redraw any cells covered by a previous selection, restoring their original
- character attributes.
-
- @param Selection The selection to clear the displayed selection for.
+ The maximum number of cells to read from the console in a single call.
+ Older consoles fail requests whose buffer exceeds 64Kb, so larger regions
+ are read in groups of lines.
  */
-VOID
-YoriLibClearPreviousSelectionDisplay(
-    __in PYORILIB_SELECTION Selection
-    )
-{
-    SHORT LineIndex;
-    SHORT LineLength;
-    HANDLE ConsoleHandle;
-    COORD StartPoint;
-    DWORD CharsWritten;
-    PWORD AttributeReadPoint;
-    PYORILIB_PREVIOUS_SELECTION_BUFFER ActiveAttributes;
-
-    //
-    //  If there was no previous selection, clearing it is easy
-    //
-
-    if (!YoriLibIsPreviousSelectionActive(Selection)) {
-        return;
-    }
-
-    ConsoleHandle = GetStdHandle(STD_OUTPUT_HANDLE);
-
-    //
-    //  Grab a pointer to the previous selection attributes.  Note the
-    //  actual buffer can be NULL if there was an allocation failure
-    //  when selecting.  In that case attributes are restored to a
-    //  default color.
-    //
-
-    ActiveAttributes = &Selection->PreviousBuffer[Selection->CurrentPreviousIndex];
-    AttributeReadPoint = ActiveAttributes->AttributeArray;
-
-    LineLength = (SHORT)(Selection->PreviouslyDisplayed.Right - Selection->PreviouslyDisplayed.Left + 1);
-
-    for (LineIndex = Selection->PreviouslyDisplayed.Top; LineIndex <= Selection->PreviouslyDisplayed.Bottom; LineIndex++) {
-        StartPoint.X = Selection->PreviouslyDisplayed.Left;
-        StartPoint.Y = LineIndex;
-
-        YoriLibDisplayAttributes(ConsoleHandle, AttributeReadPoint, 0x07, LineLength, StartPoint, &CharsWritten);
-
-        if (AttributeReadPoint) {
-            AttributeReadPoint += LineLength;
-        }
-    }
-
-    Selection->CurrentlyDisplayed.Left = 0;
-    Selection->CurrentlyDisplayed.Right = 0;
-    Selection->CurrentlyDisplayed.Top = 0;
-    Selection->CurrentlyDisplayed.Bottom = 0;
-
-    Selection->PreviouslyDisplayed.Left = Selection->CurrentlyDisplayed.Left;
-    Selection->PreviouslyDisplayed.Top = Selection->CurrentlyDisplayed.Top;
-    Selection->PreviouslyDisplayed.Right = Selection->CurrentlyDisplayed.Right;
-    Selection->PreviouslyDisplayed.Bottom = Selection->CurrentlyDisplayed.Bottom;
-
-    Selection->SelectionPreviouslyActive = FALSE;
-}
+#define YORILIB_SELECTION_MAX_READ_CELLS (0x2000)
 
 /**
  Windows 10 consoles have a nasty bug where ReadConsoleOutputAttribute
  doesn't return correct colors when the console has previously displayed
  colors that are not describable in 16 color form.  ReadConsoleOutput does
  return the correct value though, so this routine uses that instead and
- reformats the result to provide the same interface as
- ReadConsoleOutputAttribute.  This needs a larger allocation though, so any
+ extracts the attributes from the result.  Because ReadConsoleOutput
+ operates on rectangles, a block of cells spanning many lines can be read
+ with a single call.  This needs a larger allocation though, so any
  allocation is kept on the Selection in the hope it can be used here for
  a subsequent operation.
 
@@ -236,40 +179,56 @@ YoriLibClearPreviousSelectionDisplay(
 
  @param hConsole Handle to the console output.
 
- @param lpAttribute Pointer to an array of WORDs that is populated with
-        attributes inside this routine.
+ @param Region The region of the console to read attributes from.
 
- @param nLength The number of console cells and attributes to populate.
+ @param AttributeBuffer Pointer to an array of attributes describing
+        BufferRegion.  The attributes for cells within Region are populated
+        inside this routine.
 
- @param dwReadCoord The console buffer coordinates to start reading
-        attributes from.
-
- @param lpNumberOfAttrsRead On successful completion, updated to contain the
-        number of attributes successfully read.
+ @param BufferRegion The region of the console described by AttributeBuffer.
+        Region must be contained within this region.
 
  @return TRUE to indicate success, FALSE to indicate failure.
  */
 __success(return)
 BOOL
-YoriLibReadConsoleOutputAttributeForSelection(
+YoriLibReadConsoleAttributeRegionForSelection(
     __in PYORILIB_SELECTION Selection,
     __in HANDLE hConsole,
-    __out_ecount(nLength) LPWORD lpAttribute,
-    __in DWORD nLength,
-    __in COORD dwReadCoord,
-    __out LPDWORD lpNumberOfAttrsRead
+    __in PSMALL_RECT Region,
+    __inout PWORD AttributeBuffer,
+    __in PSMALL_RECT BufferRegion
     )
 {
-
     PCHAR_INFO CharInfo;
+    PCHAR_INFO CharInfoReadPoint;
     SMALL_RECT ReadRegion;
     COORD dwBufferSize;
     COORD dwBufferCoord;
-    DWORD dwIndex;
     DWORD dwAllocSize;
+    DWORD LineLength;
+    DWORD LinesPerRead;
+    DWORD BufferLineLength;
+    DWORD RequiredLength;
+    DWORD Index;
+    SHORT LineIndex;
+    SHORT LinesThisRead;
+    SHORT LineOffset;
+    PWORD AttributeWritePoint;
 
-    if (nLength > Selection->TempCharInfoBufferSize) {
-        dwAllocSize = nLength * 2;
+    LineLength = Region->Right - Region->Left + 1;
+    BufferLineLength = BufferRegion->Right - BufferRegion->Left + 1;
+    LinesPerRead = YORILIB_SELECTION_MAX_READ_CELLS / LineLength;
+    if (LinesPerRead == 0) {
+        LinesPerRead = 1;
+    }
+    if (LinesPerRead > (DWORD)(Region->Bottom - Region->Top + 1)) {
+        LinesPerRead = Region->Bottom - Region->Top + 1;
+    }
+
+    RequiredLength = LineLength * LinesPerRead;
+    if (RequiredLength > Selection->TempCharInfoBufferSize) {
+        dwAllocSize = RequiredLength * 2;
         if (dwAllocSize < 0x100) {
             dwAllocSize = 0x100;
         }
@@ -293,28 +252,280 @@ YoriLibReadConsoleOutputAttributeForSelection(
 
     CharInfo = Selection->TempCharInfoBuffer;
 
-    dwBufferSize.X = (SHORT)nLength;
-    dwBufferSize.Y = 1;
-    dwBufferCoord.X = 0;
-    dwBufferCoord.Y = 0;
-    ReadRegion.Left = dwReadCoord.X;
-    ReadRegion.Top = dwReadCoord.Y;
-    ReadRegion.Right = (SHORT)(dwReadCoord.X + nLength - 1);
-    ReadRegion.Bottom = dwReadCoord.Y;
+    for (LineIndex = Region->Top; LineIndex <= Region->Bottom; LineIndex = (SHORT)(LineIndex + LinesThisRead)) {
 
-    if (!ReadConsoleOutput(hConsole, CharInfo, dwBufferSize, dwBufferCoord, &ReadRegion)) {
-        return FALSE;
+        LinesThisRead = (SHORT)LinesPerRead;
+        if (LinesThisRead > Region->Bottom - LineIndex + 1) {
+            LinesThisRead = (SHORT)(Region->Bottom - LineIndex + 1);
+        }
+
+        dwBufferSize.X = (SHORT)LineLength;
+        dwBufferSize.Y = LinesThisRead;
+        dwBufferCoord.X = 0;
+        dwBufferCoord.Y = 0;
+        ReadRegion.Left = Region->Left;
+        ReadRegion.Top = LineIndex;
+        ReadRegion.Right = Region->Right;
+        ReadRegion.Bottom = (SHORT)(LineIndex + LinesThisRead - 1);
+
+        if (!ReadConsoleOutput(hConsole, CharInfo, dwBufferSize, dwBufferCoord, &ReadRegion)) {
+            return FALSE;
+        }
+
+        AttributeWritePoint = &AttributeBuffer[(LineIndex - BufferRegion->Top) * BufferLineLength + (Region->Left - BufferRegion->Left)];
+        CharInfoReadPoint = CharInfo;
+        for (LineOffset = 0; LineOffset < LinesThisRead; LineOffset++) {
+            for (Index = 0; Index < LineLength; Index++) {
+                AttributeWritePoint[Index] = CharInfoReadPoint[Index].Attributes;
+            }
+            AttributeWritePoint += BufferLineLength;
+            CharInfoReadPoint += LineLength;
+        }
     }
 
-    for (dwIndex = 0; dwIndex < nLength; dwIndex++) {
-        lpAttribute[dwIndex] = CharInfo[dwIndex].Attributes;
+    return TRUE;
+}
+
+/**
+ Determine the cells within one region that are not within another region.
+ The result is described as up to four rectangles: lines above the excluded
+ region, lines below it, and cells to its left and right on the lines that
+ both regions share.
+
+ @param Region The region to find cells within.
+
+ @param Exclude The region whose cells should not be returned.
+
+ @param Remaining On completion, populated with up to four rectangles that
+        describe the cells in Region which are not in Exclude.
+
+ @return The number of rectangles populated in Remaining.
+ */
+DWORD
+YoriLibSubtractSelectionRegion(
+    __in PSMALL_RECT Region,
+    __in PSMALL_RECT Exclude,
+    __out_ecount(4) PSMALL_RECT Remaining
+    )
+{
+    DWORD Count;
+    SHORT SharedTop;
+    SHORT SharedBottom;
+
+    Count = 0;
+
+    //
+    //  Lines above the excluded region
+    //
+
+    if (Region->Top < Exclude->Top) {
+        Remaining[Count].Left = Region->Left;
+        Remaining[Count].Right = Region->Right;
+        Remaining[Count].Top = Region->Top;
+        Remaining[Count].Bottom = Region->Bottom;
+        if (Remaining[Count].Bottom >= Exclude->Top) {
+            Remaining[Count].Bottom = (SHORT)(Exclude->Top - 1);
+        }
+        Count++;
+    }
+
+    //
+    //  Lines below the excluded region
+    //
+
+    if (Region->Bottom > Exclude->Bottom) {
+        Remaining[Count].Left = Region->Left;
+        Remaining[Count].Right = Region->Right;
+        Remaining[Count].Top = Region->Top;
+        Remaining[Count].Bottom = Region->Bottom;
+        if (Remaining[Count].Top <= Exclude->Bottom) {
+            Remaining[Count].Top = (SHORT)(Exclude->Bottom + 1);
+        }
+        Count++;
     }
 
-    if (lpNumberOfAttrsRead != NULL) {
-        *lpNumberOfAttrsRead = ReadRegion.Right - ReadRegion.Left + 1;
+    //
+    //  Cells to the left and right of the excluded region on lines that
+    //  contain both
+    //
+
+    SharedTop = Region->Top;
+    if (SharedTop < Exclude->Top) {
+        SharedTop = Exclude->Top;
+    }
+    SharedBottom = Region->Bottom;
+    if (SharedBottom > Exclude->Bottom) {
+        SharedBottom = Exclude->Bottom;
     }
 
-    return TRUE;
+    if (SharedTop <= SharedBottom) {
+        if (Region->Left < Exclude->Left) {
+            Remaining[Count].Left = Region->Left;
+            Remaining[Count].Right = Region->Right;
+            if (Remaining[Count].Right >= Exclude->Left) {
+                Remaining[Count].Right = (SHORT)(Exclude->Left - 1);
+            }
+            Remaining[Count].Top = SharedTop;
+            Remaining[Count].Bottom = SharedBottom;
+            Count++;
+        }
+
+        if (Region->Right > Exclude->Right) {
+            Remaining[Count].Left = Region->Left;
+            if (Remaining[Count].Left <= Exclude->Right) {
+                Remaining[Count].Left = (SHORT)(Exclude->Right + 1);
+            }
+            Remaining[Count].Right = Region->Right;
+            Remaining[Count].Top = SharedTop;
+            Remaining[Count].Bottom = SharedBottom;
+            Count++;
+        }
+    }
+
+    return Count;
+}
+
+/**
+ Save the attributes of a region of the console which is becoming selected,
+ and optionally display the region as selected.
+
+ @param Selection Pointer to the selection, which is used purely as an
+        allocation cache if temporary scratch space is needed.
+
+ @param ConsoleHandle Handle to the console.
+
+ @param Region The region of the console which is becoming selected.
+
+ @param AttributeBuffer Optionally points to an array of attributes
+        describing BufferRegion, which is populated with the attributes of
+        cells within Region.  This can be NULL on allocation failure.
+
+ @param BufferRegion The region of the console described by AttributeBuffer.
+
+ @param UpdateDisplay If TRUE, the region should be marked as selected within
+        the console.
+
+ @param SelectionColor Specifies the color of the selection to apply within
+        the console.  Only meaningful if UpdateDisplay is TRUE.
+ */
+VOID
+YoriLibCaptureSelectionRegion(
+    __inout PYORILIB_SELECTION Selection,
+    __in HANDLE ConsoleHandle,
+    __in PSMALL_RECT Region,
+    __inout_opt PWORD AttributeBuffer,
+    __in PSMALL_RECT BufferRegion,
+    __in BOOL UpdateDisplay,
+    __in WORD SelectionColor
+    )
+{
+    SHORT LineIndex;
+    COORD StartPoint;
+    DWORD CharsWritten;
+
+    if (AttributeBuffer != NULL) {
+        YoriLibReadConsoleAttributeRegionForSelection(Selection, ConsoleHandle, Region, AttributeBuffer, BufferRegion);
+    }
+
+    if (UpdateDisplay) {
+        StartPoint.X = Region->Left;
+        for (LineIndex = Region->Top; LineIndex <= Region->Bottom; LineIndex++) {
+            StartPoint.Y = LineIndex;
+            FillConsoleOutputAttribute(ConsoleHandle, SelectionColor, Region->Right - Region->Left + 1, StartPoint, &CharsWritten);
+        }
+    }
+}
+
+/**
+ Restore the saved attributes of a region of the console which is no longer
+ selected.
+
+ @param ConsoleHandle Handle to the console.
+
+ @param Region The region of the console which is no longer selected.
+
+ @param AttributeBuffer Optionally points to an array of attributes
+        describing BufferRegion.  If NULL, a default attribute is used.
+
+ @param BufferRegion The region of the console described by AttributeBuffer.
+ */
+VOID
+YoriLibRestoreSelectionRegion(
+    __in HANDLE ConsoleHandle,
+    __in PSMALL_RECT Region,
+    __in_opt PWORD AttributeBuffer,
+    __in PSMALL_RECT BufferRegion
+    )
+{
+    SHORT LineIndex;
+    COORD StartPoint;
+    DWORD CharsWritten;
+    DWORD BufferLineLength;
+    PWORD AttributeReadPoint;
+
+    BufferLineLength = BufferRegion->Right - BufferRegion->Left + 1;
+    AttributeReadPoint = NULL;
+    StartPoint.X = Region->Left;
+
+    for (LineIndex = Region->Top; LineIndex <= Region->Bottom; LineIndex++) {
+        StartPoint.Y = LineIndex;
+        if (AttributeBuffer != NULL) {
+            AttributeReadPoint = &AttributeBuffer[(LineIndex - BufferRegion->Top) * BufferLineLength + (Region->Left - BufferRegion->Left)];
+        }
+
+        YoriLibDisplayAttributes(ConsoleHandle, AttributeReadPoint, 0x07, Region->Right - Region->Left + 1, StartPoint, &CharsWritten);
+    }
+}
+
+/**
+ Redraw any cells covered by a previous selection, restoring their original
+ character attributes.
+
+ @param Selection The selection to clear the displayed selection for.
+ */
+VOID
+YoriLibClearPreviousSelectionDisplay(
+    __in PYORILIB_SELECTION Selection
+    )
+{
+    HANDLE ConsoleHandle;
+    PYORILIB_PREVIOUS_SELECTION_BUFFER ActiveAttributes;
+
+    //
+    //  If there was no previous selection, clearing it is easy
+    //
+
+    if (!YoriLibIsPreviousSelectionActive(Selection)) {
+        return;
+    }
+
+    ConsoleHandle = GetStdHandle(STD_OUTPUT_HANDLE);
+
+    //
+    //  Grab a pointer to the previous selection attributes.  Note the
+    //  actual buffer can be NULL if there was an allocation failure
+    //  when selecting.  In that case attributes are restored to a
+    //  default color.
+    //
+
+    ActiveAttributes = &Selection->PreviousBuffer[Selection->CurrentPreviousIndex];
+
+    YoriLibRestoreSelectionRegion(ConsoleHandle,
+                                  &Selection->PreviouslyDisplayed,
+                                  ActiveAttributes->AttributeArray,
+                                  &Selection->PreviouslyDisplayed);
+
+    Selection->CurrentlyDisplayed.Left = 0;
+    Selection->CurrentlyDisplayed.Right = 0;
+    Selection->CurrentlyDisplayed.Top = 0;
+    Selection->CurrentlyDisplayed.Bottom = 0;
+
+    Selection->PreviouslyDisplayed.Left = Selection->CurrentlyDisplayed.Left;
+    Selection->PreviouslyDisplayed.Top = Selection->CurrentlyDisplayed.Top;
+    Selection->PreviouslyDisplayed.Right = Selection->CurrentlyDisplayed.Right;
+    Selection->PreviouslyDisplayed.Bottom = Selection->CurrentlyDisplayed.Bottom;
+
+    Selection->SelectionPreviouslyActive = FALSE;
 }
 
 /**
@@ -488,13 +699,8 @@ YoriLibDrawCurrentSelectionDisplay(
     __in PYORILIB_SELECTION Selection
     )
 {
-    SHORT LineIndex;
-    SHORT LineLength;
     HANDLE ConsoleHandle;
-    COORD StartPoint;
-    DWORD CharsWritten;
     DWORD RequiredLength;
-    PWORD AttributeWritePoint;
     PYORILIB_PREVIOUS_SELECTION_BUFFER ActiveAttributes;
 
     //
@@ -524,29 +730,22 @@ YoriLibDrawCurrentSelectionDisplay(
         YoriLibReallocateAttributeArray(ActiveAttributes, RequiredLength);
     }
 
-    //
-    //  Note this can be NULL on allocation failure
-    //
-
-    AttributeWritePoint = ActiveAttributes->AttributeArray;
-    LineLength = (SHORT)(Selection->CurrentlyDisplayed.Right - Selection->CurrentlyDisplayed.Left + 1);
-
     if (!Selection->SelectionColorSet) {
         Selection->SelectionColor = YoriLibGetSelectionColor(ConsoleHandle);
         Selection->SelectionColorSet = TRUE;
     }
 
-    for (LineIndex = Selection->CurrentlyDisplayed.Top; LineIndex <= Selection->CurrentlyDisplayed.Bottom; LineIndex++) {
-        StartPoint.X = Selection->CurrentlyDisplayed.Left;
-        StartPoint.Y = LineIndex;
-
-        if (AttributeWritePoint != NULL) {
-            YoriLibReadConsoleOutputAttributeForSelection(Selection, ConsoleHandle, AttributeWritePoint, LineLength, StartPoint, &CharsWritten);
-            AttributeWritePoint += LineLength;
-        }
+    //
+    //  Note the attribute array can be NULL on allocation failure
+    //
 
-        FillConsoleOutputAttribute(ConsoleHandle, Selection->SelectionColor, LineLength, StartPoint, &CharsWritten);
-    }
+    YoriLibCaptureSelectionRegion(Selection,
+                                  ConsoleHandle,
+                                  &Selection->CurrentlyDisplayed,
+                                  ActiveAttributes->AttributeArray,
+                                  &Selection->CurrentlyDisplayed,
+                                  TRUE,
+                                  Selection->SelectionColor);
 
     Selection->PreviouslyDisplayed.Left = Selection->CurrentlyDisplayed.Left;
     Selection->PreviouslyDisplayed.Top = Selection->CurrentlyDisplayed.Top;
@@ -597,15 +796,16 @@ YoriLibCreateNewAttributeBufferFromPreviousBuffer(
     )
 {
     SHORT LineIndex;
-    SHORT LineLength;
-    SHORT RunLength;
+    SHORT OldLineLength;
+    SHORT NewLineLength;
+    SMALL_RECT Shared;
+    SMALL_RECT Remaining[4];
+    DWORD RemainingCount;
+    DWORD Index;
     HANDLE ConsoleHandle;
-    COORD StartPoint;
-    DWORD BufferOffset;
-    PWORD BufferPointer;
-    DWORD CharsWritten;
     DWORD RequiredLength;
     PWORD AttributeWritePoint;
+    PWORD AttributeReadPoint;
 
     ConsoleHandle = GetStdHandle(STD_OUTPUT_HANDLE);
 
@@ -615,121 +815,57 @@ YoriLibCreateNewAttributeBufferFromPreviousBuffer(
         YoriLibReallocateAttributeArray(NewAttributes, RequiredLength * 2);
     }
 
-    LineLength = (SHORT)(NewRegion->Right - NewRegion->Left + 1);
+    NewLineLength = (SHORT)(NewRegion->Right - NewRegion->Left + 1);
+    OldLineLength = (SHORT)(OldRegion->Right - OldRegion->Left + 1);
 
     //
-    //  Walk through all of the new selection to save off attributes for it,
-    //  and update the console to have selection color
+    //  Cells that were previously selected need their attributes migrated
+    //  to the new buffer, but the console state is already correct
     //
 
-    AttributeWritePoint = NewAttributes->AttributeArray;
-    for (LineIndex = NewRegion->Top; LineIndex <= NewRegion->Bottom; LineIndex++) {
-
-        //
-        //  An entire line wasn't previously selected
-        //
-
-        if (LineIndex < OldRegion->Top ||
-            LineIndex > OldRegion->Bottom) {
-
-            StartPoint.X = NewRegion->Left;
-            StartPoint.Y = LineIndex;
-
-            if (AttributeWritePoint != NULL) {
-                YoriLibReadConsoleOutputAttributeForSelection(Selection, ConsoleHandle, AttributeWritePoint, LineLength, StartPoint, &CharsWritten);
-                AttributeWritePoint += LineLength;
-            }
-
-            if (UpdateNewRegionDisplay) {
-                FillConsoleOutputAttribute(ConsoleHandle, SelectionColor, LineLength, StartPoint, &CharsWritten);
-            }
-
-        } else {
-
-            //
-            //  A set of characters to the left of the previous selection
-            //  that are now selected
-            //
-
-            if (NewRegion->Left < OldRegion->Left) {
-
-                StartPoint.X = NewRegion->Left;
-                StartPoint.Y = LineIndex;
-
-                RunLength = (SHORT)(OldRegion->Left - NewRegion->Left);
-                if (LineLength < RunLength) {
-                    RunLength = LineLength;
-                }
-
-                if (AttributeWritePoint != NULL) {
-                    YoriLibReadConsoleOutputAttributeForSelection(Selection, ConsoleHandle, AttributeWritePoint, RunLength, StartPoint, &CharsWritten);
-                    AttributeWritePoint += RunLength;
-                }
-
-                if (UpdateNewRegionDisplay) {
-                    FillConsoleOutputAttribute(ConsoleHandle, SelectionColor, RunLength, StartPoint, &CharsWritten);
-                }
-
-            }
-
-            //
-            //  A set of characters were previously selected.  These
-            //  attributes need to be migrated to the new buffer, but
-            //  the console state is already correct
-            //
-
-            if (NewRegion->Right >= OldRegion->Left &&
-                NewRegion->Left <= OldRegion->Right) {
-
-                StartPoint.X = (SHORT)(NewRegion->Left - OldRegion->Left);
-                RunLength = LineLength;
-                if (StartPoint.X < 0) {
-                    RunLength = (SHORT)(RunLength + StartPoint.X);
-                    StartPoint.X = 0;
-                }
-                if (StartPoint.X + RunLength > OldRegion->Right - OldRegion->Left + 1) {
-                    RunLength = (SHORT)(OldRegion->Right - OldRegion->Left + 1 - StartPoint.X);
-                }
-
-                StartPoint.Y = (SHORT)(LineIndex - OldRegion->Top);
-
-                BufferOffset = (OldRegion->Right - OldRegion->Left + 1) * StartPoint.Y + StartPoint.X;
+    Shared.Left = NewRegion->Left;
+    if (Shared.Left < OldRegion->Left) {
+        Shared.Left = OldRegion->Left;
+    }
+    Shared.Right = NewRegion->Right;
+    if (Shared.Right > OldRegion->Right) {
+        Shared.Right = OldRegion->Right;
+    }
+    Shared.Top = NewRegion->Top;
+    if (Shared.Top < OldRegion->Top) {
+        Shared.Top = OldRegion->Top;
+    }
+    Shared.Bottom = NewRegion->Bottom;
+    if (Shared.Bottom > OldRegion->Bottom) {
+        Shared.Bottom = OldRegion->Bottom;
+    }
 
-                if (AttributeWritePoint != NULL) {
-                    if (OldAttributes->AttributeArray != NULL) {
-                        memcpy(AttributeWritePoint, &OldAttributes->AttributeArray[BufferOffset], RunLength * sizeof(WORD));
-                    }
+    if (NewAttributes->AttributeArray != NULL &&
+        OldAttributes->AttributeArray != NULL &&
+        Shared.Left <= Shared.Right &&
+        Shared.Top <= Shared.Bottom) {
 
-                    AttributeWritePoint += RunLength;
-                }
-            }
+        for (LineIndex = Shared.Top; LineIndex <= Shared.Bottom; LineIndex++) {
+            AttributeWritePoint = &NewAttributes->AttributeArray[(LineIndex - NewRegion->Top) * NewLineLength + (Shared.Left - NewRegion->Left)];
+            AttributeReadPoint = &OldAttributes->AttributeArray[(LineIndex - OldRegion->Top) * OldLineLength + (Shared.Left - OldRegion->Left)];
+            memcpy(AttributeWritePoint, AttributeReadPoint, (Shared.Right - Shared.Left + 1) * sizeof(WORD));
+        }
+    }
 
-            //
-            //  A set of characters to the right of the previous selection
-            //  that are now selected
-            //
+    //
+    //  Cells that were not previously selected need their attributes read
+    //  from the console, and the console updated to have selection color
+    //
 
-            if (NewRegion->Right > OldRegion->Right) {
-
-                StartPoint.X = (SHORT)(OldRegion->Right + 1);
-                if (NewRegion->Left > StartPoint.X) {
-                    StartPoint.X = NewRegion->Left;
-                    RunLength = LineLength;
-                } else {
-                    RunLength = (SHORT)(NewRegion->Right - StartPoint.X + 1);
-                }
-                StartPoint.Y = LineIndex;
-
-                if (AttributeWritePoint != NULL) {
-                    YoriLibReadConsoleOutputAttributeForSelection(Selection, ConsoleHandle, AttributeWritePoint, RunLength, StartPoint, &CharsWritten);
-                    AttributeWritePoint += RunLength;
-                }
-
-                if (UpdateNewRegionDisplay) {
-                    FillConsoleOutputAttribute(ConsoleHandle, SelectionColor, RunLength, StartPoint, &CharsWritten);
-                }
-            }
-        }
+    RemainingCount = YoriLibSubtractSelectionRegion(NewRegion, OldRegion, Remaining);
+    for (Index = 0; Index < RemainingCount; Index++) {
+        YoriLibCaptureSelectionRegion(Selection,
+                                      ConsoleHandle,
+                                      &Remaining[Index],
+                                      NewAttributes->AttributeArray,
+                                      NewRegion,
+                                      UpdateNewRegionDisplay,
+                                      SelectionColor);
     }
 
     //
@@ -738,86 +874,12 @@ YoriLibCreateNewAttributeBufferFromPreviousBuffer(
     //
 
     if (UpdateNewRegionDisplay) {
-        LineLength = (SHORT)(OldRegion->Right - OldRegion->Left + 1);
-
-        for (LineIndex = OldRegion->Top; LineIndex <= OldRegion->Bottom; LineIndex++) {
-
-            //
-            //  A line was previously selected and no longer is.  Restore the
-            //  saved attributes.
-            //
-
-            if (LineIndex < NewRegion->Top ||
-                LineIndex > NewRegion->Bottom) {
-
-                StartPoint.X = OldRegion->Left;
-                StartPoint.Y = LineIndex;
-                RunLength = LineLength;
-
-                if (OldAttributes->AttributeArray != NULL) {
-                    BufferOffset = LineLength * (LineIndex - OldRegion->Top);
-                    BufferPointer = &OldAttributes->AttributeArray[BufferOffset];
-                } else {
-                    BufferPointer = NULL;
-                }
-
-                YoriLibDisplayAttributes(ConsoleHandle, BufferPointer, 0x07, RunLength, StartPoint, &CharsWritten);
-
-            } else {
-
-                //
-                //  A region to the left of the currently selected region was
-                //  previously selected.  Restore the saved attributes.
-                //
-
-                if (OldRegion->Left < NewRegion->Left) {
-
-                    StartPoint.X = OldRegion->Left;
-                    StartPoint.Y = LineIndex;
-                    RunLength = LineLength;
-                    if (NewRegion->Left - OldRegion->Left < RunLength) {
-                        RunLength = (SHORT)(NewRegion->Left - OldRegion->Left);
-                    }
-
-                    if (OldAttributes->AttributeArray != NULL) {
-                        BufferOffset = LineLength * (LineIndex - OldRegion->Top);
-                        BufferPointer = &OldAttributes->AttributeArray[BufferOffset];
-                    } else {
-                        BufferPointer = NULL;
-                    }
-
-                    YoriLibDisplayAttributes(ConsoleHandle, BufferPointer, 0x07, RunLength, StartPoint, &CharsWritten);
-
-                }
-
-                //
-                //  A region to the right of the current selection was previously
-                //  selected.  Restore the saved attributes.
-                //
-
-                if (OldRegion->Right > NewRegion->Right) {
-
-                    BufferOffset = LineLength * (LineIndex - OldRegion->Top);
-                    StartPoint.Y = LineIndex;
-
-                    if (OldRegion->Left > NewRegion->Right) {
-                        StartPoint.X = OldRegion->Left;
-                        RunLength = LineLength;
-                    } else {
-                        RunLength = (SHORT)(OldRegion->Right - NewRegion->Right);
-                        StartPoint.X = (SHORT)(NewRegion->Right + 1);
-                        BufferOffset += NewRegion->Right - OldRegion->Left + 1;
-                    }
-
-                    if (OldAttributes->AttributeArray != NULL) {
-                        BufferPointer = &OldAttributes->AttributeArray[BufferOffset];
-                    } else {
-                        BufferPointer = NULL;
-                    }
-
-                    YoriLibDisplayAttributes(ConsoleHandle, BufferPointer, 0x07, RunLength, StartPoint, &CharsWritten);
-                }
-            }
+        RemainingCount = YoriLibSubtractSelectionRegion(OldRegion, NewRegion, Remaining);
+        for (Index = 0; Index < RemainingCount; Index++) {
+            YoriLibRestoreSelectionRegion(ConsoleHandle,
+                                          &Remaining[Index],
+                                          OldAttributes->AttributeArray,
+                                          OldRegion);
         }
     }
 }
@@ -840,6 +902,20 @@ YoriLibDrawCurrentSelectionOverPreviousSelection(
     ASSERT(YoriLibIsPreviousSelectionActive(Selection) &&
            YoriLibIsSelectionActive(Selection));
 
+    //
+    //  If the selection has not moved, the console and the saved attributes
+    //  are already correct.  This is common when the mouse moves within a
+    //  cell or periodic scrolling reaches the edge of the buffer.
+    //
+
+    if (Selection->CurrentlyDisplayed.Left == Selection->PreviouslyDisplayed.Left &&
+        Selection->CurrentlyDisplayed.Right == Selection->PreviouslyDisplayed.Right &&
+        Selection->CurrentlyDisplayed.Top == Selection->PreviouslyDisplayed.Top &&
+        Selection->CurrentlyDisplayed.Bottom == Selection->PreviouslyDisplayed.Bottom) {
+
+        return;
+    }
+
     //
     //  Find the buffers that are not the ones that currently contain the
     //  attributes of selected cells.  We'll fill that buffer with updated
@@ -1376,6 +1452,84 @@ YoriLibClearPeriodicScroll(
     Selection->PeriodicScrollAmount.Y = 0;
 }
 
+/**
+ Construct the plain text form of a selection from a buffer containing the
+ text of every cell in the selected region.  Trailing spaces are removed
+ from each line, and lines are separated by CRLF with no CRLF after the
+ final line.  The result is allocated at its exact size.
+
+ @param CellText Pointer to the text of each cell in the selected region.
+
+ @param LineLength The number of cells in each line.
+
+ @param LineCount The number of lines.
+
+ @param PlainText On successful completion, populated with a newly allocated
+        string containing the plain text form.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriLibBuildPlainTextForSelection(
+    __in LPTSTR CellText,
+    __in SHORT LineLength,
+    __in SHORT LineCount,
+    __out PYORI_STRING PlainText
+    )
+{
+    LPTSTR LineStart;
+    LPTSTR WritePoint;
+    YORI_ALLOC_SIZE_T CharsNeeded;
+    SHORT LineIndex;
+    SHORT CharsInLine;
+
+    //
+    //  Count the characters in each line excluding trailing spaces, plus
+    //  a CRLF between lines.
+    //
+
+    CharsNeeded = 0;
+    LineStart = CellText;
+    for (LineIndex = 0; LineIndex < LineCount; LineIndex++) {
+        CharsInLine = LineLength;
+        while (CharsInLine > 0 && LineStart[CharsInLine - 1] == ' ') {
+            CharsInLine--;
+        }
+        CharsNeeded = CharsNeeded + CharsInLine;
+        if (LineIndex + 1 < LineCount) {
+            CharsNeeded = CharsNeeded + 2;
+        }
+        LineStart += LineLength;
+    }
+
+    if (!YoriLibAllocateString(PlainText, CharsNeeded + 1)) {
+        return FALSE;
+    }
+
+    WritePoint = PlainText->StartOfString;
+    LineStart = CellText;
+    for (LineIndex = 0; LineIndex < LineCount; LineIndex++) {
+        CharsInLine = LineLength;
+        while (CharsInLine > 0 && LineStart[CharsInLine - 1] == ' ') {
+            CharsInLine--;
+        }
+        memcpy(WritePoint, LineStart, CharsInLine * sizeof(TCHAR));
+        WritePoint += CharsInLine;
+        if (LineIndex + 1 < LineCount) {
+            WritePoint[0] = '\r';
+            WritePoint[1] = '\n';
+            WritePoint += 2;
+        }
+        LineStart += LineLength;
+    }
+
+    WritePoint[0] = '\0';
+    PlainText->LengthInChars = (YORI_ALLOC_SIZE_T)(WritePoint - PlainText->StartOfString);
+    ASSERT(PlainText->LengthInChars == CharsNeeded);
+    return TRUE;
+}
+
 /**
  If a selection region is active, copy the region as text to the clipboard.
 
@@ -1390,6 +1544,7 @@ YoriLibCopySelectionIfPresent(
     )
 {
     YORI_STRING TextToCopy;
+    YORI_STRING PlainText;
     YORI_STRING VtText;
     YORI_STRING HtmlText;
     YORI_STRING RtfText;
@@ -1511,39 +1666,20 @@ YoriLibCopySelectionIfPresent(
         YoriLibFree(Attributes.AttributeArray);
 
         //
-        //  In the second pass, copy all of the text, truncating trailing spaces.
-        //  This version will be used to construct the plain text form.
+        //  Construct the plain text form from the text that has already been
+        //  captured, truncating trailing spaces, rather than reading each
+        //  line from the console again.
         //
 
-        TextWritePoint = TextToCopy.StartOfString;
-        for (LineIndex = Selection->CurrentlySelected.Top; LineIndex <= Selection->CurrentlySelected.Bottom; LineIndex++) {
-            StartPoint.X = Selection->CurrentlySelected.Left;
-            StartPoint.Y = LineIndex;
-
-            YoriLibReadConsoleOutputCharacterForSelection(Selection, ConsoleHandle, TextWritePoint, LineLength, StartPoint, &CharsWritten);
-            while (CharsWritten > 0) {
-                if (TextWritePoint[CharsWritten - 1] != ' ') {
-                    break;
-                }
-                CharsWritten--;
-            }
-            TextWritePoint += CharsWritten;
-
-            TextWritePoint[0] = '\r';
-            TextWritePoint++;
-            TextWritePoint[0] = '\n';
-            TextWritePoint++;
+        if (!YoriLibBuildPlainTextForSelection(TextToCopy.StartOfString, LineLength, LineCount, &PlainText)) {
+            YoriLibFreeStringContents(&VtText);
+            YoriLibFreeStringContents(&TextToCopy);
+            return FALSE;
         }
 
-        TextToCopy.LengthInChars = (YORI_ALLOC_SIZE_T)(TextWritePoint - TextToCopy.StartOfString);
-
-        //
-        //  Remove the final CRLF
-        //
-
-        if (TextToCopy.LengthInChars >= 2) {
-            TextToCopy.LengthInChars -= 2;
-        }
+        YoriLibFreeStringContents(&TextToCopy);
+        YoriLibCloneString(&TextToCopy, &PlainText);
+        YoriLibFreeStringContents(&PlainText);
 
         //
         //  Convert the VT100 form into HTML and RTF, and free it
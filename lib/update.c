@@ -229,6 +229,63 @@ LPCSTR YoriLibMonthNames[] = {
 #define UPDATE_READ_SIZE (60 * 1024)
 #endif
 
+/**
+ The number of times to resume or retry a download after the connection to
+ the server fails while data is being received.
+ */
+#define UPDATE_MAX_RETRIES (5)
+
+/**
+ The delay before the first retry of a failed download, in milliseconds.
+ Each subsequent retry waits proportionally longer.
+ */
+#define UPDATE_RETRY_DELAY (1000)
+
+/**
+ The maximum length of an ETag or Last-Modified value used to check that an
+ object has not changed before resuming a download, in characters.
+ */
+#define UPDATE_VALIDATOR_LENGTH (256)
+
+/**
+ A session which can be used to download multiple files.  Reusing a session
+ allows the network stack to reuse connections to the same server.  This is
+ the nonopaque form of a handle returned from @ref YoriLibUpdateOpenSession .
+ */
+typedef struct _YORI_LIB_UPDATE_SESSION {
+
+    /**
+     Pointer to the WinInet function table to use, or NULL if the session
+     is using WinHttp.
+     */
+    PYORI_WININET_FUNCTIONS WinInet;
+
+    /**
+     A function table for the mini-HTTP client, used if neither WinInet or
+     WinHttp are available.
+     */
+    YORI_WININET_FUNCTIONS StubWinInet;
+
+    /**
+     The WinInet or WinHttp handle for the session.
+     */
+    PVOID hInternet;
+
+    /**
+     TRUE if WinInet exports Unicode functions that are not implemented, so
+     ANSI functions must be used instead.
+     */
+    BOOL WinInetOnlySupportsAnsi;
+
+    /**
+     The total number of bytes received by requests within this session.
+     This is updated by the thread performing requests and may be read by
+     other threads for display purposes.
+     */
+    DWORDLONG BytesReceived;
+
+} YORI_LIB_UPDATE_SESSION, *PYORI_LIB_UPDATE_SESSION;
+
 /**
  Construct the HTTP headers to attach to the request.  This code is shared
  between WinInet and WinHttp.
@@ -238,6 +295,14 @@ LPCSTR YoriLibMonthNames[] = {
  @param IfModifiedSince Optionally points to a timestamp where only newer
         resources should be downloaded.
 
+ @param RangeStart If nonzero, the offset within the object to resume
+        downloading from.
+
+ @param RangeValidator Optionally points to the ETag or Last-Modified value
+        of the object when the earlier part was downloaded.  The range is
+        only requested if this is specified, and the server will return the
+        complete object if it has changed.
+
  @param OutputHeader On successful completion, populated with a newly
         allocated string containing all of the necessary HTTP headers.
 
@@ -256,6 +321,8 @@ BOOLEAN
 YoriLibUpdateBuildHttpHeaders(
     __in PCYORI_STRING Url,
     __in_opt PSYSTEMTIME IfModifiedSince,
+    __in DWORDLONG RangeStart,
+    __in_opt PCYORI_STRING RangeValidator,
     __out PYORI_STRING OutputHeader,
     __out PYORI_STRING HostSubset,
     __out LPTSTR *ObjectSubset
@@ -264,6 +331,7 @@ YoriLibUpdateBuildHttpHeaders(
     LPTSTR EndOfHost;
     YORI_STRING HostHeader;
     YORI_STRING IfModifiedSinceHeader;
+    YORI_STRING RangeHeader;
     YORI_STRING CombinedHeader;
     YORI_STRING ProtocolDelimiter;
     YORI_ALLOC_SIZE_T StartOfHost;
@@ -312,15 +380,28 @@ YoriLibUpdateBuildHttpHeaders(
                        IfModifiedSince->wSecond);
     }
 
+    //
+    //  If resuming an earlier download, request the remainder of the object
+    //  provided it hasn't changed since the earlier part was received.
+    //
+
+    YoriLibInitEmptyString(&RangeHeader);
+    if (RangeStart > 0 && RangeValidator != NULL && RangeValidator->LengthInChars > 0) {
+        YoriLibYPrintf(&RangeHeader,
+                       _T("Range: bytes=%lli-\r\nIf-Range: %y\r\n"),
+                       RangeStart,
+                       RangeValidator);
+    }
 
     //
-    //  Merge headers.  If we have only one or the other, this is just a
-    //  reference with no allocation.
+    //  Merge headers.  If we have only one, this is just a reference with no
+    //  allocation.
     //
 
     YoriLibInitEmptyString(&CombinedHeader);
-    if (IfModifiedSinceHeader.LengthInChars > 0 && HostHeader.LengthInChars > 0) {
-        YoriLibYPrintf(&CombinedHeader, _T("%y%y"), &HostHeader, &IfModifiedSinceHeader);
+    if (RangeHeader.LengthInChars > 0 ||
+        (IfModifiedSinceHeader.LengthInChars > 0 && HostHeader.LengthInChars > 0)) {
+        YoriLibYPrintf(&CombinedHeader, _T("%y%y%y"), &HostHeader, &IfModifiedSinceHeader, &RangeHeader);
     } else if (IfModifiedSinceHeader.LengthInChars > 0) {
         YoriLibCloneString(&CombinedHeader, &IfModifiedSinceHeader);
     } else if (HostHeader.LengthInChars > 0) {
@@ -333,64 +414,34 @@ YoriLibUpdateBuildHttpHeaders(
 
     YoriLibFreeStringContents(&HostHeader);
     YoriLibFreeStringContents(&IfModifiedSinceHeader);
+    YoriLibFreeStringContents(&RangeHeader);
 
     memcpy(OutputHeader, &CombinedHeader, sizeof(YORI_STRING));
     return TRUE;
 }
 
 /**
- Download a file from the internet and store it in a local location using
- WinInet.dll.  This function is only used once WinInet is loaded.
+ Open a WinInet session for a session structure which has been initialized
+ with a WinInet function table.
 
- @param Dll Pointer to the Dll function table to use.  This allows this
-        function to operate against WinInet.dll or a different structure
-        with the same function signatures, which is used by the mini-HTTP
-        client.
-
- @param Url The Url to download the file from.
-
- @param TargetName If specified, the local location to store the file.
-        If not specified, the current executable name is used.
+ @param Session Pointer to the session structure.  On successful completion,
+        the hInternet handle is populated.
 
  @param Agent The user agent to report to the remote web server.
 
- @param IfModifiedSince If specified, indicates a timestamp where a new
-        object should only be downloaded if it is newer.
-
- @return An update error code indicating success or appropriate error.
+ @return TRUE to indicate success, FALSE to indicate failure.
  */
-YORI_LIB_UPDATE_ERROR
-YoriLibUpdateBinaryFromUrlWinInet(
-    __in PYORI_WININET_FUNCTIONS Dll,
-    __in PCYORI_STRING Url,
-    __in_opt PCYORI_STRING TargetName,
-    __in PCYORI_STRING Agent,
-    __in_opt PSYSTEMTIME IfModifiedSince
+__success(return)
+BOOL
+YoriLibUpdateOpenWinInetSession(
+    __inout PYORI_LIB_UPDATE_SESSION Session,
+    __in PCYORI_STRING Agent
     )
 {
-    PVOID hInternet = NULL;
-    PVOID NewBinary = NULL;
-    PUCHAR NewBinaryData = NULL;
-    DWORD ErrorBufferSize = 0;
-    DWORD ActualBinarySize;
-    YORI_STRING TempName;
-    YORI_STRING TempPath;
-    YORI_STRING PrefixString;
-    HANDLE hTempFile = INVALID_HANDLE_VALUE;
-    BOOL SuccessfullyComplete = FALSE;
-    BOOL WinInetOnlySupportsAnsi = FALSE;
-    DWORD dwError;
-    YORI_LIB_UPDATE_ERROR Return = YoriLibUpdErrorSuccess;
-    YORI_STRING CombinedHeader;
-    YORI_STRING HostSubset;
-    LPTSTR ObjectName;
+    PYORI_WININET_FUNCTIONS Dll;
+    PVOID hInternet;
 
-    ASSERT(YoriLibIsStringNullTerminated(Url));
-    ASSERT(YoriLibIsStringNullTerminated(Agent));
-    ASSERT(TargetName == NULL || YoriLibIsStringNullTerminated(TargetName));
-
-    YoriLibInitEmptyString(&TempName);
-    YoriLibInitEmptyString(&TempPath);
+    Dll = Session->WinInet;
 
     //
     //  Open an internet connection with default proxy settings.
@@ -421,11 +472,10 @@ YoriLibUpdateBinaryFromUrlWinInet(
             if (Dll->pInternetOpenA == NULL ||
                 Dll->pInternetOpenUrlA == NULL) {
 
-                Return = YoriLibUpdErrorInetInit;
-                goto Exit;
+                return FALSE;
             }
 
-            WinInetOnlySupportsAnsi = TRUE;
+            Session->WinInetOnlySupportsAnsi = TRUE;
 
             BytesForAnsiAgent = (YORI_ALLOC_SIZE_T)WideCharToMultiByte(CP_ACP,
                     0,
@@ -438,7 +488,6 @@ YoriLibUpdateBinaryFromUrlWinInet(
 
             AnsiAgent = YoriLibMalloc(BytesForAnsiAgent + 1);
             if (AnsiAgent == NULL) {
-                Return = YoriLibUpdErrorInetInit;
                 return FALSE;
             }
 
@@ -463,20 +512,210 @@ YoriLibUpdateBinaryFromUrlWinInet(
     }
 
     if (hInternet == NULL) {
-        Return = YoriLibUpdErrorInetInit;
-        goto Exit;
+        return FALSE;
     }
 
-    if (!YoriLibUpdateBuildHttpHeaders(Url, IfModifiedSince, &CombinedHeader, &HostSubset, &ObjectName)) {
-        Return = YoriLibUpdErrorInetInit;
-        goto Exit;
+    Session->hInternet = hInternet;
+    return TRUE;
+}
+
+/**
+ Discard any data that has been written to the temporary file for a
+ download, so that the download can start again from the beginning.
+
+ @param hTempFile Handle to the temporary file.
+
+ @param BytesWritten On successful completion, set to zero.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriLibUpdateDiscardPartialFile(
+    __in HANDLE hTempFile,
+    __out PDWORDLONG BytesWritten
+    )
+{
+    if (SetFilePointer(hTempFile, 0, NULL, FILE_BEGIN) == INVALID_SET_FILE_POINTER ||
+        !SetEndOfFile(hTempFile)) {
+
+        return FALSE;
     }
 
-    //
-    //  Request the desired URL and check the status is HTTP success.
-    //
+    *BytesWritten = 0;
+    return TRUE;
+}
+
+/**
+ Prepare to retry a download after the connection to the server failed.  If
+ the object has a validator, the download resumes from the data already
+ received; otherwise any data already received is discarded.  This waits
+ before returning, for longer on each successive retry, to give an
+ unreliable network a chance to recover.
+
+ @param Attempt On input, the number of retries already performed.  On
+        successful completion, incremented.
+
+ @param hTempFile Handle to the temporary file containing any data received
+        so far.
+
+ @param Validator Pointer to the ETag or Last-Modified value of the object.
+        This may be empty if the server did not provide one.
+
+ @param BytesWritten Points to the number of bytes received so far.  This is
+        set to zero if the download must restart from the beginning.
+
+ @return TRUE to indicate the download should be retried, FALSE if it
+         should fail.
+ */
+__success(return)
+BOOL
+YoriLibUpdatePrepareRetry(
+    __inout PDWORD Attempt,
+    __in HANDLE hTempFile,
+    __in PCYORI_STRING Validator,
+    __inout PDWORDLONG BytesWritten
+    )
+{
+    if (*Attempt >= UPDATE_MAX_RETRIES) {
+        return FALSE;
+    }
+
+    if (Validator->LengthInChars == 0 && *BytesWritten > 0) {
+        if (!YoriLibUpdateDiscardPartialFile(hTempFile, BytesWritten)) {
+            return FALSE;
+        }
+    }
+
+    (*Attempt)++;
+    Sleep(UPDATE_RETRY_DELAY * (*Attempt));
+    return TRUE;
+}
+
+/**
+ Check whether a validator returned by a server can be used to resume a
+ download.  Resuming requires a strong validator, so weak ETags cannot be
+ used.
+
+ @param Validator Pointer to the ETag or Last-Modified value.
+
+ @return TRUE if the validator can be used, FALSE if it cannot.
+ */
+BOOL
+YoriLibUpdateIsValidatorUsable(
+    __in PCYORI_STRING Validator
+    )
+{
+    if (Validator->LengthInChars == 0 ||
+        YoriLibCompareStringLitCnt(Validator, _T("W/"), 2) == 0) {
+
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ The HTTP headers which can identify a version of an object, in order of
+ preference.
+ */
+CONST DWORD
+YoriLibUpdateValidatorQueries[] = {
+    HTTP_QUERY_ETAG,
+    HTTP_QUERY_LAST_MODIFIED
+};
+
+/**
+ Query the ETag or Last-Modified value of an object being downloaded with
+ WinInet, so that an interrupted download can be resumed if the object has
+ not changed.  The mini-HTTP client does not support these queries, so
+ downloads using it restart from the beginning.
+
+ @param Session Pointer to the session.
+
+ @param hRequest The request handle.
+
+ @param Validator On input, points to a string which may contain a previous
+        validator.  On completion, updated to contain the validator for this
+        request, or an empty string if there is no usable validator.
+ */
+VOID
+YoriLibUpdateQueryValidatorWinInet(
+    __in PYORI_LIB_UPDATE_SESSION Session,
+    __in PVOID hRequest,
+    __inout PYORI_STRING Validator
+    )
+{
+    PYORI_WININET_FUNCTIONS Dll;
+    CHAR AnsiValidator[UPDATE_VALIDATOR_LENGTH];
+    DWORD BufferLength;
+    DWORD Index;
+    BOOL Result;
+
+    YoriLibFreeStringContents(Validator);
+    if (!YoriLibAllocateString(Validator, UPDATE_VALIDATOR_LENGTH)) {
+        return;
+    }
+
+    Dll = Session->WinInet;
+    for (Index = 0; Index < sizeof(YoriLibUpdateValidatorQueries)/sizeof(YoriLibUpdateValidatorQueries[0]); Index++) {
+        if (Session->WinInetOnlySupportsAnsi) {
+            BufferLength = sizeof(AnsiValidator) - 1;
+            Result = Dll->pHttpQueryInfoA(hRequest, YoriLibUpdateValidatorQueries[Index], AnsiValidator, &BufferLength, NULL);
+            if (Result) {
+                Validator->LengthInChars = (YORI_ALLOC_SIZE_T)
+                    MultiByteToWideChar(CP_ACP,
+                                        0,
+                                        AnsiValidator,
+                                        BufferLength,
+                                        Validator->StartOfString,
+                                        Validator->LengthAllocated - 1);
+            }
+        } else {
+            BufferLength = (Validator->LengthAllocated - 1) * sizeof(TCHAR);
+            Result = Dll->pHttpQueryInfoW(hRequest, YoriLibUpdateValidatorQueries[Index], Validator->StartOfString, &BufferLength, NULL);
+            if (Result) {
+                Validator->LengthInChars = (YORI_ALLOC_SIZE_T)(BufferLength / sizeof(TCHAR));
+            }
+        }
+
+        if (Result) {
+            Validator->StartOfString[Validator->LengthInChars] = '\0';
+            if (YoriLibUpdateIsValidatorUsable(Validator)) {
+                return;
+            }
+        }
+        Validator->LengthInChars = 0;
+    }
+
+    YoriLibFreeStringContents(Validator);
+}
+
+/**
+ Open a Url using WinInet, converting the Url and headers to ANSI if
+ WinInet does not support Unicode.
+
+ @param Session Pointer to the session.
+
+ @param Url The Url to open.
 
-    if (WinInetOnlySupportsAnsi) {
+ @param Headers Pointer to the HTTP headers to send.
+
+ @return The request handle, or NULL on failure.
+ */
+PVOID
+YoriLibUpdateOpenUrlWinInet(
+    __in PYORI_LIB_UPDATE_SESSION Session,
+    __in PCYORI_STRING Url,
+    __in PYORI_STRING Headers
+    )
+{
+    PYORI_WININET_FUNCTIONS Dll;
+    PVOID NewBinary;
+
+    Dll = Session->WinInet;
+
+    if (Session->WinInetOnlySupportsAnsi) {
         YORI_ALLOC_SIZE_T AnsiCombinedHeaderLength;
         LPSTR AnsiCombinedHeader;
         YORI_ALLOC_SIZE_T AnsiUrlLength;
@@ -484,8 +723,8 @@ YoriLibUpdateBinaryFromUrlWinInet(
 
         AnsiCombinedHeaderLength = (YORI_ALLOC_SIZE_T)WideCharToMultiByte(CP_ACP,
                0,
-               CombinedHeader.StartOfString,
-               CombinedHeader.LengthInChars,
+               Headers->StartOfString,
+               Headers->LengthInChars,
                NULL,
                0,
                NULL,
@@ -501,23 +740,19 @@ YoriLibUpdateBinaryFromUrlWinInet(
 
         AnsiCombinedHeader = YoriLibMalloc(AnsiCombinedHeaderLength + 1);
         if (AnsiCombinedHeader == NULL) {
-            YoriLibFreeStringContents(&CombinedHeader);
-            Return = YoriLibUpdErrorInetInit;
-            goto Exit;
+            return NULL;
         }
 
         AnsiUrl = YoriLibMalloc(AnsiUrlLength + 1);
         if (AnsiUrl == NULL) {
             YoriLibFree(AnsiCombinedHeader);
-            YoriLibFreeStringContents(&CombinedHeader);
-            Return = YoriLibUpdErrorInetInit;
-            goto Exit;
+            return NULL;
         }
 
         WideCharToMultiByte(CP_ACP,
                             0,
-                            CombinedHeader.StartOfString,
-                            CombinedHeader.LengthInChars,
+                            Headers->StartOfString,
+                            Headers->LengthInChars,
                             AnsiCombinedHeader,
                             AnsiCombinedHeaderLength,
                             NULL,
@@ -534,7 +769,7 @@ YoriLibUpdateBinaryFromUrlWinInet(
                             NULL);
         AnsiUrl[AnsiUrlLength] = '\0';
 
-        NewBinary = Dll->pInternetOpenUrlA(hInternet,
+        NewBinary = Dll->pInternetOpenUrlA(Session->hInternet,
                                            AnsiUrl,
                                            AnsiCombinedHeader,
                                            AnsiCombinedHeaderLength,
@@ -545,67 +780,74 @@ YoriLibUpdateBinaryFromUrlWinInet(
 
     } else {
 
-        NewBinary = Dll->pInternetOpenUrlW(hInternet,
+        NewBinary = Dll->pInternetOpenUrlW(Session->hInternet,
                                            Url->StartOfString,
-                                           CombinedHeader.StartOfString,
-                                           CombinedHeader.LengthInChars,
+                                           Headers->StartOfString,
+                                           Headers->LengthInChars,
                                            0,
                                            0);
     }
 
-    if (NewBinary == NULL) {
-        YoriLibFreeStringContents(&CombinedHeader);
-        Return = YoriLibUpdErrorInetConnect;
-        goto Exit;
-    }
+    return NewBinary;
+}
 
-    YoriLibFreeStringContents(&CombinedHeader);
+/**
+ Download a file from the internet and store it in a local location using
+ WinInet.dll.  This function is only used once WinInet is loaded.  If the
+ connection fails while data is being received, the download is retried,
+ resuming from the data already received if the server indicates the object
+ has not changed.
 
-    ErrorBufferSize = sizeof(dwError);
-    ActualBinarySize = 0;
-    dwError = 0;
+ @param Session Pointer to the session to use.  The session refers to the
+        function table to use.  This allows this function to operate against
+        WinInet.dll or a different structure with the same function
+        signatures, which is used by the mini-HTTP client.
 
-    if (WinInetOnlySupportsAnsi) {
-        if (!Dll->pHttpQueryInfoA(NewBinary,
-                                  HTTP_QUERY_FLAG_NUMBER | HTTP_QUERY_STATUS_CODE,
-                                  &dwError,
-                                  &ErrorBufferSize,
-                                  &ActualBinarySize)) {
-            Return = YoriLibUpdErrorInetConnect;
-            goto Exit;
-        }
-    } else {
-        if (!Dll->pHttpQueryInfoW(NewBinary,
-                                  HTTP_QUERY_FLAG_NUMBER | HTTP_QUERY_STATUS_CODE,
-                                  &dwError,
-                                  &ErrorBufferSize,
-                                  &ActualBinarySize)) {
-            Return = YoriLibUpdErrorInetConnect;
-            goto Exit;
-        }
-    }
+ @param Url The Url to download the file from.
 
-    if (dwError != 200) {
-        if (dwError != 304 || IfModifiedSince == NULL) {
-            Return = YoriLibUpdErrorInetConnect;
-        }
-        goto Exit;
-    }
+ @param TargetName If specified, the local location to store the file.
+        If not specified, the current executable name is used.
 
-    //
-    //  Create a temporary file to hold the contents.
-    //
+ @param IfModifiedSince If specified, indicates a timestamp where a new
+        object should only be downloaded if it is newer.
 
-    if (!YoriLibGetTempPath(&TempPath, 0)) {
-        Return = YoriLibUpdErrorFileWrite;
-        goto Exit;
-    }
+ @return An update error code indicating success or appropriate error.
+ */
+YORI_LIB_UPDATE_ERROR
+YoriLibUpdateBinaryFromUrlWinInet(
+    __in PYORI_LIB_UPDATE_SESSION Session,
+    __in PCYORI_STRING Url,
+    __in_opt PCYORI_STRING TargetName,
+    __in_opt PSYSTEMTIME IfModifiedSince
+    )
+{
+    PYORI_WININET_FUNCTIONS Dll;
+    PVOID NewBinary = NULL;
+    PUCHAR NewBinaryData = NULL;
+    DWORD ErrorBufferSize = 0;
+    DWORD ActualBinarySize;
+    DWORDLONG BytesWritten;
+    DWORD Attempt;
+    YORI_STRING TempName;
+    YORI_STRING TempPath;
+    YORI_STRING PrefixString;
+    YORI_STRING Validator;
+    HANDLE hTempFile = INVALID_HANDLE_VALUE;
+    BOOL SuccessfullyComplete = FALSE;
+    DWORD dwError;
+    YORI_LIB_UPDATE_ERROR Return = YoriLibUpdErrorSuccess;
+    YORI_STRING CombinedHeader;
+    YORI_STRING HostSubset;
+    LPTSTR ObjectName;
 
-    YoriLibConstantString(&PrefixString, _T("UPD"));
-    if (!YoriLibGetTempFileName(&TempPath, &PrefixString, &hTempFile, &TempName)) {
-        Return = YoriLibUpdErrorFileWrite;
-        goto Exit;
-    }
+    ASSERT(YoriLibIsStringNullTerminated(Url));
+    ASSERT(TargetName == NULL || YoriLibIsStringNullTerminated(TargetName));
+
+    YoriLibInitEmptyString(&TempName);
+    YoriLibInitEmptyString(&TempPath);
+    YoriLibInitEmptyString(&Validator);
+
+    Dll = Session->WinInet;
 
     NewBinaryData = YoriLibMalloc(UPDATE_READ_SIZE);
     if (NewBinaryData == NULL) {
@@ -613,53 +855,169 @@ YoriLibUpdateBinaryFromUrlWinInet(
         goto Exit;
     }
 
-    //
-    //  Read from the internet location and save to the temporary file.
-    //
-
-    while (Dll->pInternetReadFile(NewBinary, NewBinaryData, UPDATE_READ_SIZE, &ActualBinarySize)) {
-
-        DWORD DataWritten;
+    BytesWritten = 0;
+    Attempt = 0;
 
-        if (ActualBinarySize == 0) {
-            SuccessfullyComplete = TRUE;
-            break;
-        }
+    while (TRUE) {
 
-        if (!WriteFile(hTempFile, NewBinaryData, ActualBinarySize, &DataWritten, NULL) ||
-            DataWritten != ActualBinarySize) {
+        //
+        //  Request the desired URL.  If part of the object has already been
+        //  received, request the remainder.
+        //
 
-            Return = YoriLibUpdErrorFileWrite;
+        if (!YoriLibUpdateBuildHttpHeaders(Url,
+                                           (BytesWritten > 0)?NULL:IfModifiedSince,
+                                           BytesWritten,
+                                           &Validator,
+                                           &CombinedHeader,
+                                           &HostSubset,
+                                           &ObjectName)) {
+            Return = YoriLibUpdErrorInetInit;
             goto Exit;
         }
-    }
-
-    //
-    //  The only acceptable reason to fail is all the data has been
-    //  received.
-    //
 
-    if (!SuccessfullyComplete) {
-        Return = YoriLibUpdErrorInetRead;
-        goto Exit;
-    }
+        NewBinary = YoriLibUpdateOpenUrlWinInet(Session, Url, &CombinedHeader);
+        YoriLibFreeStringContents(&CombinedHeader);
 
-    //
-    //  For validation, if the request is to modify the current executable
-    //  check that the result is an executable.
-    //
+        if (NewBinary == NULL) {
 
-    if (TargetName == NULL) {
-        SetFilePointer(hTempFile, 0, NULL, FILE_BEGIN);
-        if (!ReadFile(hTempFile, NewBinaryData, 2, &ActualBinarySize, NULL) ||
-            ActualBinarySize != 2 ||
-            NewBinaryData[0] != 'M' ||
-            NewBinaryData[1] != 'Z' ) {
+            //
+            //  If the server was reachable earlier in this download, the
+            //  network may be unreliable, so try again.
+            //
 
-            Return = YoriLibUpdErrorInetContents;
+            if ((Attempt > 0 || BytesWritten > 0) &&
+                YoriLibUpdatePrepareRetry(&Attempt, hTempFile, &Validator, &BytesWritten)) {
+                continue;
+            }
+            Return = YoriLibUpdErrorInetConnect;
             goto Exit;
         }
-    }
+
+        //
+        //  Check the status is HTTP success.
+        //
+
+        ErrorBufferSize = sizeof(dwError);
+        ActualBinarySize = 0;
+        dwError = 0;
+
+        if (Session->WinInetOnlySupportsAnsi) {
+            if (!Dll->pHttpQueryInfoA(NewBinary,
+                                      HTTP_QUERY_FLAG_NUMBER | HTTP_QUERY_STATUS_CODE,
+                                      &dwError,
+                                      &ErrorBufferSize,
+                                      &ActualBinarySize)) {
+                Return = YoriLibUpdErrorInetConnect;
+                goto Exit;
+            }
+        } else {
+            if (!Dll->pHttpQueryInfoW(NewBinary,
+                                      HTTP_QUERY_FLAG_NUMBER | HTTP_QUERY_STATUS_CODE,
+                                      &dwError,
+                                      &ErrorBufferSize,
+                                      &ActualBinarySize)) {
+                Return = YoriLibUpdErrorInetConnect;
+                goto Exit;
+            }
+        }
+
+        //
+        //  A partial response continues the existing data.  A complete
+        //  response, which is returned when the object has changed,
+        //  replaces it.
+        //
+
+        if (dwError == 200) {
+            if (BytesWritten > 0 &&
+                !YoriLibUpdateDiscardPartialFile(hTempFile, &BytesWritten)) {
+                Return = YoriLibUpdErrorFileWrite;
+                goto Exit;
+            }
+            YoriLibUpdateQueryValidatorWinInet(Session, NewBinary, &Validator);
+        } else if (dwError != 206 || BytesWritten == 0) {
+            if (dwError != 304 || IfModifiedSince == NULL || BytesWritten > 0) {
+                Return = YoriLibUpdErrorInetConnect;
+            }
+            goto Exit;
+        }
+
+        //
+        //  Create a temporary file to hold the contents.
+        //
+
+        if (hTempFile == INVALID_HANDLE_VALUE) {
+            if (!YoriLibGetTempPath(&TempPath, 0)) {
+                Return = YoriLibUpdErrorFileWrite;
+                goto Exit;
+            }
+
+            YoriLibConstantString(&PrefixString, _T("UPD"));
+            if (!YoriLibGetTempFileName(&TempPath, &PrefixString, &hTempFile, &TempName)) {
+                Return = YoriLibUpdErrorFileWrite;
+                goto Exit;
+            }
+        }
+
+        //
+        //  Read from the internet location and save to the temporary file.
+        //
+
+        while (Dll->pInternetReadFile(NewBinary, NewBinaryData, UPDATE_READ_SIZE, &ActualBinarySize)) {
+
+            DWORD DataWritten;
+
+            if (ActualBinarySize == 0) {
+                SuccessfullyComplete = TRUE;
+                break;
+            }
+
+            Session->BytesReceived = Session->BytesReceived + ActualBinarySize;
+
+            if (!WriteFile(hTempFile, NewBinaryData, ActualBinarySize, &DataWritten, NULL) ||
+                DataWritten != ActualBinarySize) {
+
+                Return = YoriLibUpdErrorFileWrite;
+                goto Exit;
+            }
+
+            BytesWritten = BytesWritten + ActualBinarySize;
+        }
+
+        if (SuccessfullyComplete) {
+            break;
+        }
+
+        //
+        //  The only acceptable reason to fail is all the data has been
+        //  received.  Otherwise the connection failed, so try again.
+        //
+
+        Dll->pInternetCloseHandle(NewBinary);
+        NewBinary = NULL;
+
+        if (!YoriLibUpdatePrepareRetry(&Attempt, hTempFile, &Validator, &BytesWritten)) {
+            Return = YoriLibUpdErrorInetRead;
+            goto Exit;
+        }
+    }
+
+    //
+    //  For validation, if the request is to modify the current executable
+    //  check that the result is an executable.
+    //
+
+    if (TargetName == NULL) {
+        SetFilePointer(hTempFile, 0, NULL, FILE_BEGIN);
+        if (!ReadFile(hTempFile, NewBinaryData, 2, &ActualBinarySize, NULL) ||
+            ActualBinarySize != 2 ||
+            NewBinaryData[0] != 'M' ||
+            NewBinaryData[1] != 'Z' ) {
+
+            Return = YoriLibUpdErrorInetContents;
+            goto Exit;
+        }
+    }
 
     //
     //  Now update the binary with the local file.
@@ -689,29 +1047,75 @@ Exit:
 
     YoriLibFreeStringContents(&TempPath);
     YoriLibFreeStringContents(&TempName);
+    YoriLibFreeStringContents(&Validator);
 
     if (NewBinary != NULL) {
         Dll->pInternetCloseHandle(NewBinary);
     }
 
-    if (hInternet != NULL) {
-        Dll->pInternetCloseHandle(hInternet);
+    return Return;
+}
+
+/**
+ Query the ETag or Last-Modified value of an object being downloaded with
+ WinHttp, so that an interrupted download can be resumed if the object has
+ not changed.
+
+ @param hRequest The request handle.
+
+ @param Validator On input, points to a string which may contain a previous
+        validator.  On completion, updated to contain the validator for this
+        request, or an empty string if there is no usable validator.
+ */
+VOID
+YoriLibUpdateQueryValidatorWinHttp(
+    __in PVOID hRequest,
+    __inout PYORI_STRING Validator
+    )
+{
+    DWORD BufferLength;
+    DWORD Index;
+
+    YoriLibFreeStringContents(Validator);
+    if (!YoriLibAllocateString(Validator, UPDATE_VALIDATOR_LENGTH)) {
+        return;
     }
 
-    return Return;
+    for (Index = 0; Index < sizeof(YoriLibUpdateValidatorQueries)/sizeof(YoriLibUpdateValidatorQueries[0]); Index++) {
+        BufferLength = (Validator->LengthAllocated - 1) * sizeof(TCHAR);
+        if (DllWinHttp.pWinHttpQueryHeaders(hRequest,
+                                            YoriLibUpdateValidatorQueries[Index],
+                                            NULL,
+                                            Validator->StartOfString,
+                                            &BufferLength,
+                                            NULL)) {
+
+            Validator->LengthInChars = (YORI_ALLOC_SIZE_T)(BufferLength / sizeof(TCHAR));
+            Validator->StartOfString[Validator->LengthInChars] = '\0';
+            if (YoriLibUpdateIsValidatorUsable(Validator)) {
+                return;
+            }
+        }
+        Validator->LengthInChars = 0;
+    }
+
+    YoriLibFreeStringContents(Validator);
 }
 
 /**
  Download a file from the internet and store it in a local location using
- WinHttp.dll.  This function is only used once WinHttp is loaded.
+ WinHttp.dll.  This function is only used once WinHttp is loaded.  If the
+ connection fails while data is being received, the download is retried,
+ resuming from the data already received if the server indicates the object
+ has not changed.
+
+ @param Session Pointer to the session to use.
 
  @param Url The Url to download the file from.
 
  @param TargetName If specified, the local location to store the file.
         If not specified, the current executable name is used.
 
- @param Agent The user agent to report to the remote web server.
-
  @param IfModifiedSince If specified, indicates a timestamp where a new
         object should only be downloaded if it is newer.
 
@@ -719,18 +1123,19 @@ Exit:
  */
 YORI_LIB_UPDATE_ERROR
 YoriLibUpdateBinaryFromUrlWinHttp(
+    __in PYORI_LIB_UPDATE_SESSION Session,
     __in PCYORI_STRING Url,
     __in_opt PCYORI_STRING TargetName,
-    __in PCYORI_STRING Agent,
     __in_opt PSYSTEMTIME IfModifiedSince
     )
 {
-    PVOID hInternet = NULL;
+    PVOID hInternet;
     PVOID hConnect = NULL;
     PVOID hRequest = NULL;
     YORI_LIB_UPDATE_ERROR Return = YoriLibUpdErrorSuccess;
     YORI_STRING HostSubset;
     YORI_STRING CombinedHeader;
+    YORI_STRING Validator;
     LPTSTR HostName;
     LPTSTR ObjectName;
     DWORD dwError;
@@ -740,143 +1145,185 @@ YoriLibUpdateBinaryFromUrlWinHttp(
     HANDLE hTempFile = INVALID_HANDLE_VALUE;
     PUCHAR NewBinaryData = NULL;
     DWORD ActualBinarySize;
+    DWORDLONG BytesWritten;
+    DWORD Attempt;
     DWORD ErrorBufferSize = 0;
     BOOL SuccessfullyComplete = FALSE;
 
     ASSERT(YoriLibIsStringNullTerminated(Url));
-    ASSERT(YoriLibIsStringNullTerminated(Agent));
     ASSERT(TargetName == NULL || YoriLibIsStringNullTerminated(TargetName));
 
     YoriLibInitEmptyString(&CombinedHeader);
     YoriLibInitEmptyString(&TempName);
     YoriLibInitEmptyString(&TempPath);
+    YoriLibInitEmptyString(&Validator);
 
-    //
-    //  Open an internet connection with default proxy settings.
-    //
-
-    hInternet = DllWinHttp.pWinHttpOpen(Agent->StartOfString,
-                                        0,
-                                        NULL,
-                                        NULL,
-                                        0);
+    hInternet = Session->hInternet;
 
-    if (hInternet == NULL) {
-        Return = YoriLibUpdErrorInetInit;
+    NewBinaryData = YoriLibMalloc(UPDATE_READ_SIZE);
+    if (NewBinaryData == NULL) {
+        Return = YoriLibUpdErrorFileWrite;
         goto Exit;
     }
 
-    YoriLibInitEmptyString(&CombinedHeader);
-    if (!YoriLibUpdateBuildHttpHeaders(Url, IfModifiedSince, &CombinedHeader, &HostSubset, &ObjectName)) {
-        Return = YoriLibUpdErrorInetInit;
-        goto Exit;
-    }
+    BytesWritten = 0;
+    Attempt = 0;
 
-    HostName = YoriLibCStringFromYoriString(&HostSubset);
-    if (HostName == NULL) {
-        Return = YoriLibUpdErrorInetInit;
-        goto Exit;
-    }
+    while (TRUE) {
 
-    hConnect = DllWinHttp.pWinHttpConnect(hInternet, HostName, 0, 0);
-    YoriLibDereference(HostName);
-    if (hConnect == NULL) {
-        Return = YoriLibUpdErrorInetInit;
-        goto Exit;
-    }
+        //
+        //  Request the desired URL.  If part of the object has already been
+        //  received, request the remainder.
+        //
 
-    hRequest = DllWinHttp.pWinHttpOpenRequest(hConnect, _T("GET"), ObjectName, NULL, NULL, NULL, 0);
-    if (hRequest == NULL) {
-        Return = YoriLibUpdErrorInetInit;
-        goto Exit;
-    }
+        YoriLibFreeStringContents(&CombinedHeader);
+        if (!YoriLibUpdateBuildHttpHeaders(Url,
+                                           (BytesWritten > 0)?NULL:IfModifiedSince,
+                                           BytesWritten,
+                                           &Validator,
+                                           &CombinedHeader,
+                                           &HostSubset,
+                                           &ObjectName)) {
+            Return = YoriLibUpdErrorInetInit;
+            goto Exit;
+        }
 
-    if (!DllWinHttp.pWinHttpSendRequest(hRequest,
-                                        CombinedHeader.StartOfString,
-                                        CombinedHeader.LengthInChars,
-                                        NULL,
-                                        0,
-                                        0,
-                                        0)) {
-        Return = YoriLibUpdErrorInetConnect;
-        goto Exit;
-    }
+        if (hConnect == NULL) {
+            HostName = YoriLibCStringFromYoriString(&HostSubset);
+            if (HostName == NULL) {
+                Return = YoriLibUpdErrorInetInit;
+                goto Exit;
+            }
 
-    if (!DllWinHttp.pWinHttpReceiveResponse(hRequest, NULL)) {
-        Return = YoriLibUpdErrorInetConnect;
-        goto Exit;
-    }
+            hConnect = DllWinHttp.pWinHttpConnect(hInternet, HostName, 0, 0);
+            YoriLibDereference(HostName);
+            if (hConnect == NULL) {
+                Return = YoriLibUpdErrorInetInit;
+                goto Exit;
+            }
+        }
 
-    ErrorBufferSize = sizeof(dwError);
-    if (!DllWinHttp.pWinHttpQueryHeaders(hRequest,
-                                         HTTP_QUERY_FLAG_NUMBER | HTTP_QUERY_STATUS_CODE,
-                                         NULL,
-                                         &dwError,
-                                         &ErrorBufferSize,
-                                         NULL)) {
-        Return = YoriLibUpdErrorInetConnect;
-        goto Exit;
-    }
+        hRequest = DllWinHttp.pWinHttpOpenRequest(hConnect, _T("GET"), ObjectName, NULL, NULL, NULL, 0);
+        if (hRequest == NULL) {
+            Return = YoriLibUpdErrorInetInit;
+            goto Exit;
+        }
+
+        if (!DllWinHttp.pWinHttpSendRequest(hRequest,
+                                            CombinedHeader.StartOfString,
+                                            CombinedHeader.LengthInChars,
+                                            NULL,
+                                            0,
+                                            0,
+                                            0) ||
+            !DllWinHttp.pWinHttpReceiveResponse(hRequest, NULL)) {
 
-    if (dwError != 200) {
-        if (dwError != 304 || IfModifiedSince == NULL) {
+            //
+            //  If the server was reachable earlier in this download, the
+            //  network may be unreliable, so try again.
+            //
+
+            DllWinHttp.pWinHttpCloseHandle(hRequest);
+            hRequest = NULL;
+            if ((Attempt > 0 || BytesWritten > 0) &&
+                YoriLibUpdatePrepareRetry(&Attempt, hTempFile, &Validator, &BytesWritten)) {
+                continue;
+            }
             Return = YoriLibUpdErrorInetConnect;
+            goto Exit;
         }
-        goto Exit;
-    }
 
-    //
-    //  Create a temporary file to hold the contents.
-    //
+        ErrorBufferSize = sizeof(dwError);
+        if (!DllWinHttp.pWinHttpQueryHeaders(hRequest,
+                                             HTTP_QUERY_FLAG_NUMBER | HTTP_QUERY_STATUS_CODE,
+                                             NULL,
+                                             &dwError,
+                                             &ErrorBufferSize,
+                                             NULL)) {
+            Return = YoriLibUpdErrorInetConnect;
+            goto Exit;
+        }
 
-    if (!YoriLibGetTempPath(&TempPath, 0)) {
-        Return = YoriLibUpdErrorFileWrite;
-        goto Exit;
-    }
+        //
+        //  A partial response continues the existing data.  A complete
+        //  response, which is returned when the object has changed,
+        //  replaces it.
+        //
 
-    YoriLibConstantString(&PrefixString, _T("UPD"));
-    if (!YoriLibGetTempFileName(&TempPath, &PrefixString, &hTempFile, &TempName)) {
-        Return = YoriLibUpdErrorFileWrite;
-        goto Exit;
-    }
+        if (dwError == 200) {
+            if (BytesWritten > 0 &&
+                !YoriLibUpdateDiscardPartialFile(hTempFile, &BytesWritten)) {
+                Return = YoriLibUpdErrorFileWrite;
+                goto Exit;
+            }
+            YoriLibUpdateQueryValidatorWinHttp(hRequest, &Validator);
+        } else if (dwError != 206 || BytesWritten == 0) {
+            if (dwError != 304 || IfModifiedSince == NULL || BytesWritten > 0) {
+                Return = YoriLibUpdErrorInetConnect;
+            }
+            goto Exit;
+        }
 
-    NewBinaryData = YoriLibMalloc(UPDATE_READ_SIZE);
-    if (NewBinaryData == NULL) {
-        Return = YoriLibUpdErrorFileWrite;
-        goto Exit;
-    }
+        //
+        //  Create a temporary file to hold the contents.
+        //
 
-    //
-    //  Read from the internet location and save to the temporary file.
-    //
+        if (hTempFile == INVALID_HANDLE_VALUE) {
+            if (!YoriLibGetTempPath(&TempPath, 0)) {
+                Return = YoriLibUpdErrorFileWrite;
+                goto Exit;
+            }
+
+            YoriLibConstantString(&PrefixString, _T("UPD"));
+            if (!YoriLibGetTempFileName(&TempPath, &PrefixString, &hTempFile, &TempName)) {
+                Return = YoriLibUpdErrorFileWrite;
+                goto Exit;
+            }
+        }
 
-    while (DllWinHttp.pWinHttpReadData(hRequest, NewBinaryData, UPDATE_READ_SIZE, &ActualBinarySize)) {
+        //
+        //  Read from the internet location and save to the temporary file.
+        //
+
+        while (DllWinHttp.pWinHttpReadData(hRequest, NewBinaryData, UPDATE_READ_SIZE, &ActualBinarySize)) {
 
-        DWORD DataWritten;
+            DWORD DataWritten;
+
+            if (ActualBinarySize == 0) {
+                SuccessfullyComplete = TRUE;
+                break;
+            }
 
-        if (ActualBinarySize == 0) {
-            SuccessfullyComplete = TRUE;
+            Session->BytesReceived = Session->BytesReceived + ActualBinarySize;
+
+            if (!WriteFile(hTempFile, NewBinaryData, ActualBinarySize, &DataWritten, NULL) ||
+                DataWritten != ActualBinarySize) {
+
+                Return = YoriLibUpdErrorFileWrite;
+                goto Exit;
+            }
+
+            BytesWritten = BytesWritten + ActualBinarySize;
+        }
+
+        if (SuccessfullyComplete) {
             break;
         }
 
-        if (!WriteFile(hTempFile, NewBinaryData, ActualBinarySize, &DataWritten, NULL) ||
-            DataWritten != ActualBinarySize) {
+        //
+        //  The only acceptable reason to fail is all the data has been
+        //  received.  Otherwise the connection failed, so try again.
+        //
+
+        DllWinHttp.pWinHttpCloseHandle(hRequest);
+        hRequest = NULL;
 
-            Return = YoriLibUpdErrorFileWrite;
+        if (!YoriLibUpdatePrepareRetry(&Attempt, hTempFile, &Validator, &BytesWritten)) {
+            Return = YoriLibUpdErrorInetRead;
             goto Exit;
         }
     }
 
-    //
-    //  The only acceptable reason to fail is all the data has been
-    //  received.
-    //
-
-    if (!SuccessfullyComplete) {
-        Return = YoriLibUpdErrorInetRead;
-        goto Exit;
-    }
-
     //
     //  For validation, if the request is to modify the current executable
     //  check that the result is an executable.
@@ -919,50 +1366,50 @@ Exit:
     YoriLibFreeStringContents(&CombinedHeader);
     YoriLibFreeStringContents(&TempPath);
     YoriLibFreeStringContents(&TempName);
-
-    if (hConnect != NULL) {
-        DllWinHttp.pWinHttpCloseHandle(hConnect);
-    }
+    YoriLibFreeStringContents(&Validator);
 
     if (hRequest != NULL) {
         DllWinHttp.pWinHttpCloseHandle(hRequest);
     }
 
-    if (hInternet != NULL) {
-        DllWinHttp.pWinHttpCloseHandle(hInternet);
+    if (hConnect != NULL) {
+        DllWinHttp.pWinHttpCloseHandle(hConnect);
     }
 
     return Return;
 }
 
 /**
- Download a file from the internet and store it in a local location.
-
- @param Url The Url to download the file from.
-
- @param TargetName If specified, the local location to store the file.
-        If not specified, the current executable name is used.
+ Open a session which can be used to download one or more files.  Files
+ downloaded within a single session can reuse connections to the same
+ server.  A session should only be used by one thread at a time.
 
  @param Agent The user agent to report to the remote web server.
 
- @param IfModifiedSince If specified, indicates a timestamp where a new
-        object should only be downloaded if it is newer.
+ @param Session On successful completion, populated with an opaque handle
+        to the session.  This should be closed with
+        @ref YoriLibUpdateCloseSession .
 
- @return An update error code indicating success or appropriate error.
+ @return TRUE to indicate success, FALSE to indicate failure.
  */
-YORI_LIB_UPDATE_ERROR
-YoriLibUpdateBinaryFromUrl(
-    __in PCYORI_STRING Url,
-    __in_opt PCYORI_STRING TargetName,
+__success(return)
+BOOL
+YoriLibUpdateOpenSession(
     __in PCYORI_STRING Agent,
-    __in_opt PSYSTEMTIME IfModifiedSince
+    __out PVOID * Session
     )
 {
-    YORI_WININET_FUNCTIONS StubWinInet;
+    PYORI_LIB_UPDATE_SESSION NewSession;
 
-    ASSERT(YoriLibIsStringNullTerminated(Url));
     ASSERT(YoriLibIsStringNullTerminated(Agent));
 
+    NewSession = YoriLibMalloc(sizeof(YORI_LIB_UPDATE_SESSION));
+    if (NewSession == NULL) {
+        return FALSE;
+    }
+
+    ZeroMemory(NewSession, sizeof(YORI_LIB_UPDATE_SESSION));
+
     //
     //  Dynamically load WinInet.  This means we don't have to resolve
     //  imports unless we're really using it for something, and we can
@@ -977,42 +1424,180 @@ YoriLibUpdateBinaryFromUrl(
         DllWinInet.pInternetReadFile != NULL &&
         DllWinInet.pInternetCloseHandle != NULL) {
 
-        return YoriLibUpdateBinaryFromUrlWinInet(&DllWinInet, Url, TargetName, Agent, IfModifiedSince);
+        NewSession->WinInet = &DllWinInet;
+    } else {
+
+        //
+        //  If WinInet isn't present, load WinHttp.  This path is taken on
+        //  Nano server.
+        //
+
+        YoriLibLoadWinHttpFunctions();
+
+        if (DllWinHttp.pWinHttpCloseHandle != NULL &&
+            DllWinHttp.pWinHttpConnect != NULL &&
+            DllWinHttp.pWinHttpOpen != NULL &&
+            DllWinHttp.pWinHttpOpenRequest != NULL &&
+            DllWinHttp.pWinHttpQueryHeaders != NULL &&
+            DllWinHttp.pWinHttpReadData != NULL &&
+            DllWinHttp.pWinHttpReceiveResponse != NULL &&
+            DllWinHttp.pWinHttpSendRequest != NULL) {
+
+            //
+            //  Open an internet connection with default proxy settings.
+            //
+
+            NewSession->hInternet = DllWinHttp.pWinHttpOpen(Agent->StartOfString,
+                                                            0,
+                                                            NULL,
+                                                            NULL,
+                                                            0);
+            if (NewSession->hInternet == NULL) {
+                YoriLibFree(NewSession);
+                return FALSE;
+            }
+
+            *Session = NewSession;
+            return TRUE;
+        }
+
+        //
+        //  If neither of the above work, use our hard coded fallback.  This
+        //  is really intended for NT 3.1 or other HTTP-less environments.
+        //
+
+        NewSession->StubWinInet.pInternetOpenW = YoriLibInternetOpen;
+        NewSession->StubWinInet.pInternetOpenUrlW = YoriLibInternetOpenUrl;
+        NewSession->StubWinInet.pHttpQueryInfoW = YoriLibHttpQueryInfo;
+        NewSession->StubWinInet.pInternetReadFile = YoriLibInternetReadFile;
+        NewSession->StubWinInet.pInternetCloseHandle = YoriLibInternetCloseHandle;
+        NewSession->WinInet = &NewSession->StubWinInet;
     }
 
-    //
-    //  If WinInet isn't present, load WinHttp.  This path is taken on
-    //  Nano server.
-    //
+    if (!YoriLibUpdateOpenWinInetSession(NewSession, Agent)) {
+        YoriLibFree(NewSession);
+        return FALSE;
+    }
 
-    YoriLibLoadWinHttpFunctions();
+    *Session = NewSession;
+    return TRUE;
+}
 
-    if (DllWinHttp.pWinHttpCloseHandle != NULL &&
-        DllWinHttp.pWinHttpConnect != NULL &&
-        DllWinHttp.pWinHttpOpen != NULL &&
-        DllWinHttp.pWinHttpOpenRequest != NULL &&
-        DllWinHttp.pWinHttpQueryHeaders != NULL &&
-        DllWinHttp.pWinHttpReadData != NULL &&
-        DllWinHttp.pWinHttpReceiveResponse != NULL &&
-        DllWinHttp.pWinHttpSendRequest != NULL) {
+/**
+ Close a session opened with @ref YoriLibUpdateOpenSession .
 
-        return YoriLibUpdateBinaryFromUrlWinHttp(Url, TargetName, Agent, IfModifiedSince);
+ @param Session The opaque session handle.
+ */
+VOID
+YoriLibUpdateCloseSession(
+    __in PVOID Session
+    )
+{
+    PYORI_LIB_UPDATE_SESSION UpdateSession;
+
+    UpdateSession = (PYORI_LIB_UPDATE_SESSION)Session;
+    if (UpdateSession->hInternet != NULL) {
+        if (UpdateSession->WinInet != NULL) {
+            UpdateSession->WinInet->pInternetCloseHandle(UpdateSession->hInternet);
+        } else {
+            DllWinHttp.pWinHttpCloseHandle(UpdateSession->hInternet);
+        }
     }
 
-    //
-    //  If neither of the above work, use our hard coded fallback.  This is
-    //  really intended for NT 3.1 or other HTTP-less environments.
-    //
+    YoriLibFree(UpdateSession);
+}
 
-    ZeroMemory(&StubWinInet, sizeof(StubWinInet));
+/**
+ Return the number of bytes received by all requests within a session.  This
+ can be called from a different thread to the one performing requests, in
+ which case the value is only suitable for display.
 
-    StubWinInet.pInternetOpenW = YoriLibInternetOpen;
-    StubWinInet.pInternetOpenUrlW = YoriLibInternetOpenUrl;
-    StubWinInet.pHttpQueryInfoW = YoriLibHttpQueryInfo;
-    StubWinInet.pInternetReadFile = YoriLibInternetReadFile;
-    StubWinInet.pInternetCloseHandle = YoriLibInternetCloseHandle;
+ @param Session The opaque session handle.
 
-    return YoriLibUpdateBinaryFromUrlWinInet(&StubWinInet, Url, TargetName, Agent, IfModifiedSince);
+ @return The number of bytes received.
+ */
+DWORDLONG
+YoriLibUpdateGetSessionBytesReceived(
+    __in PVOID Session
+    )
+{
+    PYORI_LIB_UPDATE_SESSION UpdateSession;
+
+    UpdateSession = (PYORI_LIB_UPDATE_SESSION)Session;
+    return UpdateSession->BytesReceived;
+}
+
+/**
+ Download a file from the internet within an existing session and store it
+ in a local location.
+
+ @param Session The opaque session handle returned from
+        @ref YoriLibUpdateOpenSession .
+
+ @param Url The Url to download the file from.
+
+ @param TargetName If specified, the local location to store the file.
+        If not specified, the current executable name is used.
+
+ @param IfModifiedSince If specified, indicates a timestamp where a new
+        object should only be downloaded if it is newer.
+
+ @return An update error code indicating success or appropriate error.
+ */
+YORI_LIB_UPDATE_ERROR
+YoriLibUpdateBinaryFromUrlWithSession(
+    __in PVOID Session,
+    __in PCYORI_STRING Url,
+    __in_opt PCYORI_STRING TargetName,
+    __in_opt PSYSTEMTIME IfModifiedSince
+    )
+{
+    PYORI_LIB_UPDATE_SESSION UpdateSession;
+
+    UpdateSession = (PYORI_LIB_UPDATE_SESSION)Session;
+    if (UpdateSession->WinInet != NULL) {
+        return YoriLibUpdateBinaryFromUrlWinInet(UpdateSession, Url, TargetName, IfModifiedSince);
+    }
+
+    return YoriLibUpdateBinaryFromUrlWinHttp(UpdateSession, Url, TargetName, IfModifiedSince);
+}
+
+/**
+ Download a file from the internet and store it in a local location.
+
+ @param Url The Url to download the file from.
+
+ @param TargetName If specified, the local location to store the file.
+        If not specified, the current executable name is used.
+
+ @param Agent The user agent to report to the remote web server.
+
+ @param IfModifiedSince If specified, indicates a timestamp where a new
+        object should only be downloaded if it is newer.
+
+ @return An update error code indicating success or appropriate error.
+ */
+YORI_LIB_UPDATE_ERROR
+YoriLibUpdateBinaryFromUrl(
+    __in PCYORI_STRING Url,
+    __in_opt PCYORI_STRING TargetName,
+    __in PCYORI_STRING Agent,
+    __in_opt PSYSTEMTIME IfModifiedSince
+    )
+{
+    PVOID Session;
+    YORI_LIB_UPDATE_ERROR Return;
+
+    ASSERT(YoriLibIsStringNullTerminated(Url));
+    ASSERT(YoriLibIsStringNullTerminated(Agent));
+
+    if (!YoriLibUpdateOpenSession(Agent, &Session)) {
+        return YoriLibUpdErrorInetInit;
+    }
+
+    Return = YoriLibUpdateBinaryFromUrlWithSession(Session, Url, TargetName, IfModifiedSince);
+    YoriLibUpdateCloseSession(Session);
+    return Return;
 }
 
 /**
@@ -0,0 +1,571 @@
+/**
+ * @file lib/volspace.c
+ *
+ * Yori concurrent and cached queries of volume free space
+ *
+ * Copyright (c) 2026 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "yoripch.h"
+#include "yorilib.h"
+
+//
+//  Querying free space on a volume can block for a long time, most notably
+//  when a network drive is disconnected and the redirector waits for its
+//  timeout.  Each query is therefore issued on its own thread, allowing a
+//  caller to issue queries for many volumes at once and stop waiting for
+//  any that take too long.  A query that is abandoned continues in the
+//  background and releases its own reference when it completes.
+//
+//  A long running process such as the shell can opt into retaining query
+//  results by calling YoriLibVolumeSpaceCacheEnable.  Results, including
+//  failures, are then reused for a short period, and a query that is still
+//  outstanding is shared by later callers rather than being issued again.
+//
+
+/**
+ The number of milliseconds that a completed query is reused for.
+ */
+#define YORI_LIB_VOLUME_SPACE_CACHE_LIFETIME (5 * 1000)
+
+/**
+ The maximum number of volumes that can be cached.  Queries beyond this
+ limit are issued without the cache.
+ */
+#define YORI_LIB_VOLUME_SPACE_CACHE_MAX_VOLUMES (64)
+
+/**
+ A query of free space on a single volume, which may be outstanding or
+ complete.
+ */
+typedef struct _YORI_LIB_VOLUME_SPACE_QUERY {
+
+    /**
+     The hash entry for the query.  The key is the volume name.  Paired
+     with YORI_LIB_VOLUME_SPACE_CACHE::Volumes.
+     */
+    YORI_HASH_ENTRY HashEntry;
+
+    /**
+     The list of all cached queries.  Paired with
+     YORI_LIB_VOLUME_SPACE_CACHE::VolumeList.
+     */
+    YORI_LIST_ENTRY ListEntry;
+
+    /**
+     The name of the volume, NULL terminated.
+     */
+    YORI_STRING VolumeName;
+
+    /**
+     An event which is signalled when the query completes.  The fields
+     below are only meaningful once this is signalled.
+     */
+    HANDLE CompleteEvent;
+
+    /**
+     The number of references to the query.  The cache, the thread issuing
+     the query, and each caller waiting on the query hold a reference.
+     */
+    LONG ReferenceCount;
+
+    /**
+     TRUE if the query is currently within the cache.  Protected by the
+     cache mutex.
+     */
+    BOOLEAN Cached;
+
+    /**
+     The tick count when the query completed.
+     */
+    DWORD CompletedTime;
+
+    /**
+     The result of the query.  ERROR_SUCCESS indicates the sizes below are
+     valid.
+     */
+    DWORD Error;
+
+    /**
+     The amount of allocatable space on the volume.
+     */
+    LARGE_INTEGER BytesAvailable;
+
+    /**
+     The total size of the volume.
+     */
+    LARGE_INTEGER TotalBytes;
+
+    /**
+     The amount of unused space on the volume.
+     */
+    LARGE_INTEGER FreeBytes;
+
+} YORI_LIB_VOLUME_SPACE_QUERY, *PYORI_LIB_VOLUME_SPACE_QUERY;
+
+/**
+ Global state for the volume space cache.
+ */
+typedef struct _YORI_LIB_VOLUME_SPACE_CACHE {
+
+    /**
+     A mutex synchronizing access to the cache.
+     */
+    HANDLE Mutex;
+
+    /**
+     A hash table of cached queries.  NULL if the cache is not enabled.
+     */
+    PYORI_HASH_TABLE Volumes;
+
+    /**
+     A list of cached queries.
+     */
+    YORI_LIST_ENTRY VolumeList;
+
+    /**
+     The number of cached queries.
+     */
+    DWORD VolumeCount;
+
+} YORI_LIB_VOLUME_SPACE_CACHE, *PYORI_LIB_VOLUME_SPACE_CACHE;
+
+/**
+ Global state for the volume space cache.
+ */
+YORI_LIB_VOLUME_SPACE_CACHE YoriLibVolumeSpaceCache;
+
+/**
+ Enable the volume space cache for the remainder of this process.  Any
+ failure here leaves the cache disabled, which means every query is issued
+ to the file system.
+
+ @return TRUE to indicate the cache is enabled, FALSE if it is not.
+ */
+BOOLEAN
+YoriLibVolumeSpaceCacheEnable(VOID)
+{
+    if (YoriLibVolumeSpaceCache.Volumes != NULL) {
+        return TRUE;
+    }
+
+    YoriLibVolumeSpaceCache.Mutex = CreateMutex(NULL, FALSE, NULL);
+    if (YoriLibVolumeSpaceCache.Mutex == NULL) {
+        return FALSE;
+    }
+
+    YoriLibInitializeListHead(&YoriLibVolumeSpaceCache.VolumeList);
+    YoriLibVolumeSpaceCache.VolumeCount = 0;
+    YoriLibVolumeSpaceCache.Volumes = YoriLibAllocateHashTable(16);
+    if (YoriLibVolumeSpaceCache.Volumes == NULL) {
+        CloseHandle(YoriLibVolumeSpaceCache.Mutex);
+        YoriLibVolumeSpaceCache.Mutex = NULL;
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ Release a reference on a query, freeing it when the last reference is
+ released.
+
+ @param Query Pointer to the query.
+ */
+VOID
+YoriLibVolumeSpaceDereferenceQuery(
+    __in PYORI_LIB_VOLUME_SPACE_QUERY Query
+    )
+{
+    if (InterlockedDecrement(&Query->ReferenceCount) == 0) {
+        ASSERT(!Query->Cached);
+        CloseHandle(Query->CompleteEvent);
+        YoriLibFreeStringContents(&Query->VolumeName);
+        YoriLibFree(Query);
+    }
+}
+
+/**
+ Remove a query from the cache, releasing the reference held by the cache.
+ This must be called with the cache mutex held.
+
+ @param Query Pointer to the query.
+ */
+VOID
+YoriLibVolumeSpaceUncacheQuery(
+    __in PYORI_LIB_VOLUME_SPACE_QUERY Query
+    )
+{
+    ASSERT(Query->Cached);
+    YoriLibHashRemoveByEntry(&Query->HashEntry);
+    YoriLibRemoveListItem(&Query->ListEntry);
+    YoriLibVolumeSpaceCache.VolumeCount--;
+    Query->Cached = FALSE;
+    YoriLibVolumeSpaceDereferenceQuery(Query);
+}
+
+/**
+ Return TRUE if a query has completed and its result is too old to be
+ reused.
+
+ @param Query Pointer to the query.
+
+ @return TRUE if the query should be issued again, FALSE if it is
+         outstanding or recent enough to reuse.
+ */
+BOOLEAN
+YoriLibVolumeSpaceIsQueryStale(
+    __in PYORI_LIB_VOLUME_SPACE_QUERY Query
+    )
+{
+    if (WaitForSingleObject(Query->CompleteEvent, 0) != WAIT_OBJECT_0) {
+        return FALSE;
+    }
+
+    if (GetTickCount() - Query->CompletedTime < YORI_LIB_VOLUME_SPACE_CACHE_LIFETIME) {
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ Perform a query and record its result.
+
+ @param Query Pointer to the query.
+ */
+VOID
+YoriLibVolumeSpaceExecuteQuery(
+    __in PYORI_LIB_VOLUME_SPACE_QUERY Query
+    )
+{
+    if (YoriLibGetDiskFreeSpace(Query->VolumeName.StartOfString,
+                                &Query->BytesAvailable,
+                                &Query->TotalBytes,
+                                &Query->FreeBytes)) {
+
+        Query->Error = ERROR_SUCCESS;
+    } else {
+        Query->Error = GetLastError();
+        if (Query->Error == ERROR_SUCCESS) {
+            Query->Error = ERROR_GEN_FAILURE;
+        }
+    }
+
+    Query->CompletedTime = GetTickCount();
+    SetEvent(Query->CompleteEvent);
+}
+
+/**
+ A thread which performs a single query and releases its reference to it.
+
+ @param Context Pointer to the query.
+
+ @return Zero.
+ */
+DWORD WINAPI
+YoriLibVolumeSpaceQueryThread(
+    __in LPVOID Context
+    )
+{
+    PYORI_LIB_VOLUME_SPACE_QUERY Query;
+
+    Query = (PYORI_LIB_VOLUME_SPACE_QUERY)Context;
+    YoriLibVolumeSpaceExecuteQuery(Query);
+    YoriLibVolumeSpaceDereferenceQuery(Query);
+    return 0;
+}
+
+/**
+ Allocate a new query and issue it on a background thread.  If a thread
+ cannot be created, the query is performed synchronously.
+
+ @param VolumeName The volume to query, NULL terminated.
+
+ @return Pointer to the query with a reference held for the caller, or NULL
+         on allocation failure.
+ */
+PYORI_LIB_VOLUME_SPACE_QUERY
+YoriLibVolumeSpaceIssueQuery(
+    __in PCYORI_STRING VolumeName
+    )
+{
+    PYORI_LIB_VOLUME_SPACE_QUERY Query;
+    HANDLE ThreadHandle;
+    DWORD ThreadId;
+
+    Query = YoriLibMalloc(sizeof(YORI_LIB_VOLUME_SPACE_QUERY));
+    if (Query == NULL) {
+        return NULL;
+    }
+
+    ZeroMemory(Query, sizeof(YORI_LIB_VOLUME_SPACE_QUERY));
+    if (!YoriLibAllocateString(&Query->VolumeName, VolumeName->LengthInChars + 1)) {
+        YoriLibFree(Query);
+        return NULL;
+    }
+
+    memcpy(Query->VolumeName.StartOfString, VolumeName->StartOfString, VolumeName->LengthInChars * sizeof(TCHAR));
+    Query->VolumeName.StartOfString[VolumeName->LengthInChars] = '\0';
+    Query->VolumeName.LengthInChars = VolumeName->LengthInChars;
+
+    Query->CompleteEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+    if (Query->CompleteEvent == NULL) {
+        YoriLibFreeStringContents(&Query->VolumeName);
+        YoriLibFree(Query);
+        return NULL;
+    }
+
+    //
+    //  One reference for the caller and one for the thread.
+    //
+
+    Query->ReferenceCount = 2;
+    ThreadHandle = CreateThread(NULL, 0, YoriLibVolumeSpaceQueryThread, Query, 0, &ThreadId);
+    if (ThreadHandle == NULL) {
+        YoriLibVolumeSpaceQueryThread(Query);
+    } else {
+        CloseHandle(ThreadHandle);
+    }
+
+    return Query;
+}
+
+/**
+ Begin querying the free space on a volume.  This returns without waiting
+ for the query to complete.  If the cache is enabled and has a recent
+ result or an outstanding query for the volume, that is returned instead
+ of issuing a new query.
+
+ @param VolumeName The volume or directory to query, NULL terminated.
+
+ @return An opaque handle to the query, which should be passed to
+         YoriLibVolumeSpaceWait to obtain the result and to
+         YoriLibVolumeSpaceRelease when it is no longer needed.  NULL if
+         the query could not be issued.
+ */
+PVOID
+YoriLibVolumeSpaceQuery(
+    __in PCYORI_STRING VolumeName
+    )
+{
+    PYORI_LIB_VOLUME_SPACE_QUERY Query;
+    PYORI_HASH_ENTRY HashEntry;
+
+    ASSERT(YoriLibIsStringNullTerminated(VolumeName));
+
+    if (YoriLibVolumeSpaceCache.Volumes == NULL) {
+        return YoriLibVolumeSpaceIssueQuery(VolumeName);
+    }
+
+    WaitForSingleObject(YoriLibVolumeSpaceCache.Mutex, INFINITE);
+
+    HashEntry = YoriLibHashLookupByKey(YoriLibVolumeSpaceCache.Volumes, VolumeName);
+    if (HashEntry != NULL) {
+        Query = HashEntry->Context;
+        if (!YoriLibVolumeSpaceIsQueryStale(Query)) {
+            InterlockedIncrement(&Query->ReferenceCount);
+            ReleaseMutex(YoriLibVolumeSpaceCache.Mutex);
+            return Query;
+        }
+
+        YoriLibVolumeSpaceUncacheQuery(Query);
+    }
+
+    Query = YoriLibVolumeSpaceIssueQuery(VolumeName);
+    if (Query != NULL &&
+        YoriLibVolumeSpaceCache.VolumeCount < YORI_LIB_VOLUME_SPACE_CACHE_MAX_VOLUMES) {
+
+        InterlockedIncrement(&Query->ReferenceCount);
+        YoriLibHashInsertByKey(YoriLibVolumeSpaceCache.Volumes, &Query->VolumeName, Query, &Query->HashEntry);
+        YoriLibInsertList(&YoriLibVolumeSpaceCache.VolumeList, &Query->ListEntry);
+        YoriLibVolumeSpaceCache.VolumeCount++;
+        Query->Cached = TRUE;
+    }
+
+    ReleaseMutex(YoriLibVolumeSpaceCache.Mutex);
+    return Query;
+}
+
+/**
+ Wait for a query of free space on a volume to complete and return its
+ result.
+
+ @param Handle The handle to the query returned from
+        YoriLibVolumeSpaceQuery.
+
+ @param Timeout The maximum number of milliseconds to wait.  This can be
+        zero to check whether the query has completed, or INFINITE.
+
+ @param BytesAvailable Optionally points to a location to receive the amount
+        of allocatable space on successful completion.
+
+ @param TotalBytes Optionally points to a location to receive the amount
+        of total space on successful completion.
+
+ @param FreeBytes Optionally points to a location to receive the amount
+        of unused space on successful completion.
+
+ @param Error Optionally points to a location to receive the error from the
+        query on failure.  This is ERROR_TIMEOUT if the query did not
+        complete within the timeout.
+
+ @return TRUE to indicate the query completed successfully, FALSE if it
+         failed or did not complete within the timeout.
+ */
+__success(return)
+BOOL
+YoriLibVolumeSpaceWait(
+    __in PVOID Handle,
+    __in DWORD Timeout,
+    __out_opt PLARGE_INTEGER BytesAvailable,
+    __out_opt PLARGE_INTEGER TotalBytes,
+    __out_opt PLARGE_INTEGER FreeBytes,
+    __out_opt PDWORD Error
+    )
+{
+    PYORI_LIB_VOLUME_SPACE_QUERY Query;
+
+    Query = (PYORI_LIB_VOLUME_SPACE_QUERY)Handle;
+
+    if (WaitForSingleObject(Query->CompleteEvent, Timeout) != WAIT_OBJECT_0) {
+        if (Error != NULL) {
+            *Error = ERROR_TIMEOUT;
+        }
+        return FALSE;
+    }
+
+    if (Query->Error != ERROR_SUCCESS) {
+        if (Error != NULL) {
+            *Error = Query->Error;
+        }
+        return FALSE;
+    }
+
+    if (BytesAvailable != NULL) {
+        BytesAvailable->QuadPart = Query->BytesAvailable.QuadPart;
+    }
+    if (TotalBytes != NULL) {
+        TotalBytes->QuadPart = Query->TotalBytes.QuadPart;
+    }
+    if (FreeBytes != NULL) {
+        FreeBytes->QuadPart = Query->FreeBytes.QuadPart;
+    }
+    if (Error != NULL) {
+        *Error = ERROR_SUCCESS;
+    }
+
+    return TRUE;
+}
+
+/**
+ Release a handle to a query of free space on a volume.  If the query has
+ not completed, it continues in the background.
+
+ @param Handle The handle to the query returned from
+        YoriLibVolumeSpaceQuery.
+ */
+VOID
+YoriLibVolumeSpaceRelease(
+    __in PVOID Handle
+    )
+{
+    YoriLibVolumeSpaceDereferenceQuery((PYORI_LIB_VOLUME_SPACE_QUERY)Handle);
+}
+
+/**
+ Query the free space on a volume, waiting no longer than a specified
+ timeout.  This is equivalent to YoriLibGetDiskFreeSpace except that it
+ will not block indefinitely on an unresponsive volume, and will use the
+ cache if it is enabled.
+
+ @param DirectoryName Specifies the drive or directory to calculate free
+        space for, NULL terminated.
+
+ @param Timeout The maximum number of milliseconds to wait.
+
+ @param BytesAvailable Optionally points to a location to receive the amount
+        of allocatable space on successful completion.
+
+ @param TotalBytes Optionally points to a location to receive the amount
+        of total space on successful completion.
+
+ @param FreeBytes Optionally points to a location to receive the amount
+        of unused space on successful completion.
+
+ @return TRUE to indicate successful completion, FALSE to indicate failure
+         or that the query did not complete within the timeout.
+ */
+__success(return)
+BOOL
+YoriLibGetDiskFreeSpaceWithTimeout(
+    __in PCYORI_STRING DirectoryName,
+    __in DWORD Timeout,
+    __out_opt PLARGE_INTEGER BytesAvailable,
+    __out_opt PLARGE_INTEGER TotalBytes,
+    __out_opt PLARGE_INTEGER FreeBytes
+    )
+{
+    PVOID Handle;
+    BOOL Result;
+    DWORD Error;
+
+    Handle = YoriLibVolumeSpaceQuery(DirectoryName);
+    if (Handle == NULL) {
+        return FALSE;
+    }
+
+    Result = YoriLibVolumeSpaceWait(Handle, Timeout, BytesAvailable, TotalBytes, FreeBytes, &Error);
+    YoriLibVolumeSpaceRelease(Handle);
+    if (!Result) {
+        SetLastError(Error);
+    }
+    return Result;
+}
+
+/**
+ Free all state associated with the volume space cache and disable it.
+ Queries that are still outstanding are freed when they complete.
+ */
+VOID
+YoriLibVolumeSpaceCacheCleanup(VOID)
+{
+    PYORI_LIB_VOLUME_SPACE_QUERY Query;
+    PYORI_LIST_ENTRY ListEntry;
+
+    if (YoriLibVolumeSpaceCache.Volumes == NULL) {
+        return;
+    }
+
+    ListEntry = YoriLibGetNextListEntry(&YoriLibVolumeSpaceCache.VolumeList, NULL);
+    while (ListEntry != NULL) {
+        Query = CONTAINING_RECORD(ListEntry, YORI_LIB_VOLUME_SPACE_QUERY, ListEntry);
+        ListEntry = YoriLibGetNextListEntry(&YoriLibVolumeSpaceCache.VolumeList, ListEntry);
+        YoriLibVolumeSpaceUncacheQuery(Query);
+    }
+
+    YoriLibFreeEmptyHashTable(YoriLibVolumeSpaceCache.Volumes);
+    YoriLibVolumeSpaceCache.Volumes = NULL;
+    CloseHandle(YoriLibVolumeSpaceCache.Mutex);
+    YoriLibVolumeSpaceCache.Mutex = NULL;
+}
+
+// vim:sw=4:ts=4:et:
@@ -130,6 +130,242 @@ YoriLibVtGetLineEnding(VOID)
     return YoriLibVtLineEnding;
 }
 
+/**
+ The number of output devices which can be buffered concurrently.  Typically
+ a program will buffer standard output and nothing else.
+ */
+#define YORI_LIB_OUTPUT_BUFFER_COUNT 2
+
+/**
+ The number of bytes of output to accumulate before writing to a buffered
+ device.
+ */
+#define YORI_LIB_OUTPUT_BUFFER_SIZE (64 * 1024)
+
+/**
+ A buffer of encoded output which has not yet been written to a file or
+ pipe.
+ */
+typedef struct _YORI_LIB_OUTPUT_BUFFER {
+
+    /**
+     The device which output is being buffered for, or NULL if this buffer
+     is not in use.
+     */
+    HANDLE hOutput;
+
+    /**
+     The thread which enabled buffering.  Output from other threads is
+     written directly, since the buffer is not synchronized.
+     */
+    DWORD ThreadId;
+
+    /**
+     The number of bytes in Buffer which have not yet been written.
+     */
+    DWORD BytesPopulated;
+
+    /**
+     Encoded output which has not yet been written to the device.  This is
+     YORI_LIB_OUTPUT_BUFFER_SIZE bytes.
+     */
+    PUCHAR Buffer;
+
+    /**
+     A buffer that is reused to format strings before encoding them, to
+     avoid allocating for each line.
+     */
+    LPTSTR FormatBuffer;
+
+    /**
+     The size of FormatBuffer, in characters.
+     */
+    YORI_ALLOC_SIZE_T FormatBufferLength;
+
+} YORI_LIB_OUTPUT_BUFFER, *PYORI_LIB_OUTPUT_BUFFER;
+
+/**
+ The set of devices whose output is being buffered.
+ */
+YORI_LIB_OUTPUT_BUFFER YoriLibOutputBuffers[YORI_LIB_OUTPUT_BUFFER_COUNT];
+
+/**
+ The number of entries in YoriLibOutputBuffers which are in use.  This allows
+ unbuffered output to skip looking for a buffer.
+ */
+DWORD YoriLibOutputBuffersActive;
+
+/**
+ Find the output buffer for a device, if output to that device is being
+ buffered by the current thread.
+
+ @param hOutput Handle to the output device.
+
+ @return Pointer to the output buffer, or NULL if output to the device is
+         not buffered.
+ */
+PYORI_LIB_OUTPUT_BUFFER
+YoriLibOutputBufferFind(
+    __in HANDLE hOutput
+    )
+{
+    DWORD Index;
+    DWORD ThreadId;
+
+    if (YoriLibOutputBuffersActive == 0) {
+        return NULL;
+    }
+
+    ThreadId = GetCurrentThreadId();
+    for (Index = 0; Index < YORI_LIB_OUTPUT_BUFFER_COUNT; Index++) {
+        if (YoriLibOutputBuffers[Index].hOutput == hOutput &&
+            YoriLibOutputBuffers[Index].ThreadId == ThreadId) {
+
+            return &YoriLibOutputBuffers[Index];
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ Write any buffered output to its device.
+
+ @param OutputBuffer Pointer to the output buffer.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+YoriLibOutputBufferWrite(
+    __in PYORI_LIB_OUTPUT_BUFFER OutputBuffer
+    )
+{
+    DWORD BytesTransferred;
+    DWORD BytesPopulated;
+
+    BytesPopulated = OutputBuffer->BytesPopulated;
+    OutputBuffer->BytesPopulated = 0;
+
+    if (BytesPopulated == 0) {
+        return TRUE;
+    }
+
+    return WriteFile(OutputBuffer->hOutput, OutputBuffer->Buffer, BytesPopulated, &BytesTransferred, NULL);
+}
+
+/**
+ Begin buffering output to a device.  Output is accumulated in memory and
+ written in large blocks, which is much faster than writing each line when
+ the device is a file or pipe.  Consoles are not buffered, since the user
+ expects to see output as it is generated, and console output already
+ interleaves text with attribute changes.  Only output generated by the
+ calling thread is buffered.  The caller must call
+ @ref YoriLibOutputBufferDisable before exiting or writing to the device
+ by other means.
+
+ @param hOutput Handle to the output device.
+
+ @return TRUE to indicate that output is being buffered, FALSE if it is not.
+         Output is written correctly either way.
+ */
+__success(return)
+BOOL
+YoriLibOutputBufferEnable(
+    __in HANDLE hOutput
+    )
+{
+    DWORD Index;
+    DWORD CurrentMode;
+    PYORI_LIB_OUTPUT_BUFFER OutputBuffer;
+
+    if (hOutput == NULL ||
+        hOutput == INVALID_HANDLE_VALUE ||
+        hOutput == YORI_LIB_DEBUGGER_HANDLE ||
+        GetConsoleMode(hOutput, &CurrentMode)) {
+
+        return FALSE;
+    }
+
+    if (YoriLibOutputBufferFind(hOutput) != NULL) {
+        return TRUE;
+    }
+
+    for (Index = 0; Index < YORI_LIB_OUTPUT_BUFFER_COUNT; Index++) {
+        OutputBuffer = &YoriLibOutputBuffers[Index];
+        if (OutputBuffer->hOutput == NULL) {
+            OutputBuffer->Buffer = YoriLibMalloc(YORI_LIB_OUTPUT_BUFFER_SIZE);
+            if (OutputBuffer->Buffer == NULL) {
+                return FALSE;
+            }
+            OutputBuffer->hOutput = hOutput;
+            OutputBuffer->ThreadId = GetCurrentThreadId();
+            OutputBuffer->BytesPopulated = 0;
+            OutputBuffer->FormatBuffer = NULL;
+            OutputBuffer->FormatBufferLength = 0;
+            YoriLibOutputBuffersActive++;
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+/**
+ Write any output which has been buffered for a device by the current
+ thread.
+
+ @param hOutput Handle to the output device.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+YoriLibOutputBufferFlush(
+    __in HANDLE hOutput
+    )
+{
+    PYORI_LIB_OUTPUT_BUFFER OutputBuffer;
+
+    OutputBuffer = YoriLibOutputBufferFind(hOutput);
+    if (OutputBuffer == NULL) {
+        return TRUE;
+    }
+
+    return YoriLibOutputBufferWrite(OutputBuffer);
+}
+
+/**
+ Write any output which has been buffered for a device by the current
+ thread and stop buffering output to the device.
+
+ @param hOutput Handle to the output device.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+YoriLibOutputBufferDisable(
+    __in HANDLE hOutput
+    )
+{
+    PYORI_LIB_OUTPUT_BUFFER OutputBuffer;
+    BOOL Result;
+
+    OutputBuffer = YoriLibOutputBufferFind(hOutput);
+    if (OutputBuffer == NULL) {
+        return TRUE;
+    }
+
+    Result = YoriLibOutputBufferWrite(OutputBuffer);
+
+    YoriLibFree(OutputBuffer->Buffer);
+    if (OutputBuffer->FormatBuffer != NULL) {
+        YoriLibFree(OutputBuffer->FormatBuffer);
+    }
+    ZeroMemory(OutputBuffer, sizeof(YORI_LIB_OUTPUT_BUFFER));
+    YoriLibOutputBuffersActive--;
+
+    return Result;
+}
+
 /**
  Convert any incoming string to the active output encoding, and send it to
  the output device.
@@ -149,6 +385,9 @@ YoriLibOutputTextToMbyteDev(
 {
     DWORD BytesTransferred;
     BOOL Result;
+    PYORI_LIB_OUTPUT_BUFFER OutputBuffer;
+
+    OutputBuffer = YoriLibOutputBufferFind(hOutput);
 
 #ifdef UNICODE
     {
@@ -158,6 +397,29 @@ YoriLibOutputTextToMbyteDev(
 
         AnsiBytesNeeded = (YORI_ALLOC_SIZE_T)YoriLibGetMbyteOutputSizeNeeded(String->StartOfString, String->LengthInChars);
 
+        //
+        //  If output is buffered, encode directly into the buffer, writing
+        //  the buffer first if it doesn't have space.  Output that is larger
+        //  than the buffer is written directly.
+        //
+
+        if (OutputBuffer != NULL) {
+            if (OutputBuffer->BytesPopulated + AnsiBytesNeeded > YORI_LIB_OUTPUT_BUFFER_SIZE) {
+                if (!YoriLibOutputBufferWrite(OutputBuffer)) {
+                    return FALSE;
+                }
+            }
+
+            if (AnsiBytesNeeded <= YORI_LIB_OUTPUT_BUFFER_SIZE) {
+                YoriLibMultibyteOutput(String->StartOfString,
+                                       String->LengthInChars,
+                                       (LPSTR)&OutputBuffer->Buffer[OutputBuffer->BytesPopulated],
+                                       AnsiBytesNeeded);
+                OutputBuffer->BytesPopulated = OutputBuffer->BytesPopulated + AnsiBytesNeeded;
+                return TRUE;
+            }
+        }
+
         if (AnsiBytesNeeded > (int)sizeof(AnsiStackBuf)) {
             AnsiBuf = YoriLibMalloc(AnsiBytesNeeded);
         } else {
@@ -180,6 +442,20 @@ YoriLibOutputTextToMbyteDev(
         }
     }
 #else
+    if (OutputBuffer != NULL) {
+        if (OutputBuffer->BytesPopulated + String->LengthInChars * sizeof(TCHAR) > YORI_LIB_OUTPUT_BUFFER_SIZE) {
+            if (!YoriLibOutputBufferWrite(OutputBuffer)) {
+                return FALSE;
+            }
+        }
+
+        if (String->LengthInChars * sizeof(TCHAR) <= YORI_LIB_OUTPUT_BUFFER_SIZE) {
+            memcpy(&OutputBuffer->Buffer[OutputBuffer->BytesPopulated], String->StartOfString, String->LengthInChars * sizeof(TCHAR));
+            OutputBuffer->BytesPopulated = OutputBuffer->BytesPopulated + (DWORD)(String->LengthInChars * sizeof(TCHAR));
+            return TRUE;
+        }
+    }
+
     Result = WriteFile(hOutput,
                        String->StartOfString,
                        String->LengthInChars*sizeof(TCHAR),
@@ -401,6 +677,180 @@ YoriLibColorTable[] = {0,
  */
 #define INITIAL_COMPONENT_UNDERLINE  0x0004
 
+/**
+ Find the next escape character in a string.  This is called for every
+ character written through the VT layer, and the overwhelming majority of
+ characters are text, so it checks several characters per iteration before
+ falling back to checking one character at a time.
+
+ @param String Pointer to the string to search.
+
+ @return The offset of the first escape character within the string, or
+         the length of the string if no escape character is present.
+ */
+YORI_ALLOC_SIZE_T
+YoriLibVtFindEscape(
+    __in PCYORI_STRING String
+    )
+{
+    LPCTSTR Char;
+    YORI_ALLOC_SIZE_T Index;
+    YORI_ALLOC_SIZE_T Length;
+
+    Char = String->StartOfString;
+    Length = String->LengthInChars;
+    Index = 0;
+
+    while (Index + 4 <= Length) {
+        if (Char[Index] == 27 ||
+            Char[Index + 1] == 27 ||
+            Char[Index + 2] == 27 ||
+            Char[Index + 3] == 27) {
+
+            break;
+        }
+        Index = Index + 4;
+    }
+
+    while (Index < Length && Char[Index] != 27) {
+        Index++;
+    }
+
+    return Index;
+}
+
+/**
+ Determine the length of a VT100 escape sequence at the start of a string.
+ An escape consists of an escape character, a '[' character, any number of
+ digits and semicolons, and a single final character.
+
+ @param String Pointer to the string, which is expected to start with an
+        escape character.
+
+ @param EscapeLength On completion, updated to contain the number of
+        characters in the escape including its final character.  If the
+        escape is incomplete, this contains the number of characters in the
+        string, all of which are part of the escape.  If the string does not
+        start with an escape, this is zero.
+
+ @return TRUE if the string starts with a complete escape, FALSE if it does
+         not start with an escape or the escape is incomplete.
+ */
+BOOLEAN
+YoriLibVtGetEscapeLength(
+    __in PCYORI_STRING String,
+    __out PYORI_ALLOC_SIZE_T EscapeLength
+    )
+{
+    YORI_ALLOC_SIZE_T Index;
+    TCHAR Char;
+
+    if (String->LengthInChars < 3 ||
+        String->StartOfString[0] != 27 ||
+        String->StartOfString[1] != '[') {
+
+        *EscapeLength = 0;
+        return FALSE;
+    }
+
+    for (Index = 2; Index < String->LengthInChars; Index++) {
+        Char = String->StartOfString[Index];
+        if ((Char < '0' || Char > '9') && Char != ';') {
+            *EscapeLength = Index + 1;
+            return TRUE;
+        }
+    }
+
+    *EscapeLength = String->LengthInChars;
+    return FALSE;
+}
+
+/**
+ Check whether an escape sequence is a select graphic rendition sequence,
+ and if so, return the semicolon delimited parameters within it.
+
+ @param EscapeSequence Pointer to a complete escape sequence.
+
+ @param Parameters On successful completion, updated to point to the
+        parameters within the escape sequence.  This is not a separate
+        allocation, and is only valid while EscapeSequence is.
+
+ @return TRUE if the escape is a graphic rendition sequence, FALSE if it
+         is not.
+ */
+__success(return)
+BOOLEAN
+YoriLibVtGetSgrParameters(
+    __in PCYORI_STRING EscapeSequence,
+    __out PYORI_STRING Parameters
+    )
+{
+    //
+    //  We expect an escape initiator (two chars) and a 'm' for color
+    //  formatting.
+    //
+
+    if (EscapeSequence->LengthInChars < 3 ||
+        EscapeSequence->StartOfString[EscapeSequence->LengthInChars - 1] != 'm') {
+
+        return FALSE;
+    }
+
+    YoriLibInitEmptyString(Parameters);
+    Parameters->StartOfString = &EscapeSequence->StartOfString[2];
+    Parameters->LengthInChars = EscapeSequence->LengthInChars - 3;
+    return TRUE;
+}
+
+/**
+ Parse the next code from the parameters of a select graphic rendition
+ sequence.  An empty parameter is treated as zero, so this always returns
+ a code, and the caller should continue calling it while it indicates more
+ codes follow.
+
+ @param Parameters Pointer to the remaining parameters.  On completion this
+        is updated to refer to the parameters following the code that was
+        returned.
+
+ @param Code On completion, updated to contain the code.
+
+ @return TRUE if more codes follow this one, FALSE if this is the final
+         code.
+ */
+BOOLEAN
+YoriLibVtGetNextSgrCode(
+    __inout PYORI_STRING Parameters,
+    __out PDWORD Code
+    )
+{
+    YORI_ALLOC_SIZE_T Index;
+    DWORD Value;
+    TCHAR Char;
+    BOOLEAN MoreCodes;
+
+    Value = 0;
+    for (Index = 0; Index < Parameters->LengthInChars; Index++) {
+        Char = Parameters->StartOfString[Index];
+        if (Char < '0' || Char > '9') {
+            break;
+        }
+        Value = Value * 10 + (Char - '0');
+    }
+
+    MoreCodes = FALSE;
+    if (Index < Parameters->LengthInChars &&
+        Parameters->StartOfString[Index] == ';') {
+
+        Index++;
+        MoreCodes = TRUE;
+    }
+
+    Parameters->StartOfString = Parameters->StartOfString + Index;
+    Parameters->LengthInChars = Parameters->LengthInChars - Index;
+    *Code = Value;
+    return MoreCodes;
+}
+
 /**
  Given a starting color and a VT sequence which may change it, generate the
  final color.  Both colors are in Win32 attribute form.
@@ -426,48 +876,25 @@ YoriLibVtFinalColorFromEscEx(
     __out PWORD InitialComponentsUsed
     )
 {
-    LPTSTR CurrentPoint = EscapeSequence->StartOfString;
-    YORI_ALLOC_SIZE_T CurrentOffset = 0;
-    YORI_ALLOC_SIZE_T RemainingLength;
     WORD  ComponentsUsed = INITIAL_COMPONENT_FOREGROUND | INITIAL_COMPONENT_BACKGROUND | INITIAL_COMPONENT_UNDERLINE;
     WORD  NewColor;
-    YORI_STRING SearchString;
+    YORI_STRING Parameters;
 
-    RemainingLength = EscapeSequence->LengthInChars;
     NewColor = InitialColor;
 
-    //
-    //  We expect an escape initiator (two chars) and a 'm' for color
-    //  formatting.  This should already be validated, the check here
-    //  is redundant.
-    //
-
-    if (EscapeSequence->LengthInChars >= 3 &&
-        CurrentPoint[EscapeSequence->LengthInChars - 1] == 'm') {
+    if (YoriLibVtGetSgrParameters(EscapeSequence, &Parameters)) {
 
         DWORD Code;
+        BOOLEAN MoreCodes;
         BOOLEAN NewUnderline = FALSE;
-        CurrentPoint++;
-        RemainingLength--;
 
         //
         //  For something manipulating colors, go through the semicolon
         //  delimited list and apply the changes to the current color
         //
 
-        while (TRUE) {
-
-            //
-            //  Swallow either the ';' or '[' depending on whether we're
-            //  at the start or an intermediate component
-            //
-
-            CurrentPoint++;
-            RemainingLength--;
-
-            SearchString.StartOfString = CurrentPoint;
-            SearchString.LengthInChars = RemainingLength;
-            Code = YoriLibDecimalStringToInt(&SearchString);
+        do {
+            MoreCodes = YoriLibVtGetNextSgrCode(&Parameters, &Code);
             if (Code == 0) {
                 ComponentsUsed = 0;
                 NewColor = YoriLibVtResetColor;
@@ -498,26 +925,7 @@ YoriLibVtFinalColorFromEscEx(
                 ComponentsUsed = (WORD)(ComponentsUsed & ~(INITIAL_COMPONENT_BACKGROUND));
                 NewColor = (WORD)((NewColor & ~(0xf0)) | BACKGROUND_INTENSITY | (YoriLibColorTable[Code - 100]<<4));
             }
-
-            //
-            //  We expect this to end with an 'm' at the end of the string, or
-            //  some other delimiter in the middle.  For paranoia maintain
-            //  length checking.
-            //
-
-            YoriLibInitEmptyString(&SearchString);
-            SearchString.StartOfString = CurrentPoint;
-            SearchString.LengthInChars = RemainingLength;
-            CurrentOffset = YoriLibCntStringWithChars(&SearchString, _T("0123456789"));
-            CurrentPoint += CurrentOffset;
-            RemainingLength = RemainingLength - CurrentOffset;
-
-            if (RemainingLength == 0 ||
-                *CurrentPoint != ';') {
-
-                break;
-            }
-        }
+        } while (MoreCodes);
 
         if (NewUnderline) {
             NewColor |= COMMON_LVB_UNDERSCORE;
@@ -828,12 +1236,6 @@ YoriLibUtf8TextWithEscSetFn(
     return TRUE;
 }
 
-/**
- A list of break characters that indicate a range of text up to this char
- should be processed as text.
- */
-CONST TCHAR YoriLibVtEscape[] = {27, '\0'};
-
 /**
  Walk through an input string and process any VT100/ANSI escapes by invoking
  a device specific callback function to perform the requested action.
@@ -860,23 +1262,25 @@ YoriLibProcVtEscOnOpenStream(
     LPTSTR CurrentPoint;
     YORI_ALLOC_SIZE_T CurrentOffset;
     YORI_ALLOC_SIZE_T PreviouslyConsumed;
+    YORI_ALLOC_SIZE_T EscapeLength;
     YORI_STRING SearchString;
     YORI_STRING DisplayString;
 
     CurrentPoint = String;
     YoriLibInitEmptyString(&SearchString);
     YoriLibInitEmptyString(&DisplayString);
-    SearchString.StartOfString = CurrentPoint;
-    SearchString.LengthInChars = StringLength;
-    CurrentOffset = YoriLibCntStringNotWithChars(&SearchString, YoriLibVtEscape);
     PreviouslyConsumed = 0;
 
-    while (TRUE) {
+    while (PreviouslyConsumed < StringLength) {
 
         //
         //  If we have any text, perform required processing and output the text
         //
 
+        SearchString.StartOfString = CurrentPoint;
+        SearchString.LengthInChars = StringLength - PreviouslyConsumed;
+        CurrentOffset = YoriLibVtFindEscape(&SearchString);
+
         if (CurrentOffset > 0) {
             DisplayString.StartOfString = CurrentPoint;
             DisplayString.LengthInChars = CurrentOffset;
@@ -893,70 +1297,55 @@ YoriLibProcVtEscOnOpenStream(
         }
 
         //
-        //  Locate VT100 escapes and process those
+        //  Process the VT100 escape
         //
 
-        if (*CurrentPoint == 27) {
-
-            if (PreviouslyConsumed + 2 < StringLength &&
-                CurrentPoint[1] == '[') {
+        SearchString.StartOfString = CurrentPoint;
+        SearchString.LengthInChars = StringLength - PreviouslyConsumed;
+        if (YoriLibVtGetEscapeLength(&SearchString, &EscapeLength)) {
 
-                YORI_ALLOC_SIZE_T EndOfEscape;
-                SearchString.StartOfString = &CurrentPoint[2];
-                SearchString.LengthInChars = StringLength - PreviouslyConsumed - 2;
-                EndOfEscape = YoriLibCntStringWithChars(&SearchString, _T("0123456789;"));
+            DisplayString.StartOfString = CurrentPoint;
+            DisplayString.LengthInChars = EscapeLength;
 
-                //
-                //  If our buffer is full and we still have an incomplete escape,
-                //  there's no more processing we can perform.  This input is
-                //  bogus.
-                //
+            if (!Callbacks->ProcessAndOutputEscape(hOutput, &DisplayString, &Callbacks->Context)) {
+                return FALSE;
+            }
+            CurrentPoint = CurrentPoint + EscapeLength;
+            PreviouslyConsumed = PreviouslyConsumed + EscapeLength;
 
-                if (PreviouslyConsumed == 0 && EndOfEscape == StringLength - 2) {
-                    return FALSE;
-                }
+        } else if (EscapeLength > 0) {
 
-                //
-                //  If we have an incomplete escape for this chunk, stop
-                //  processing here, loop back and read more data.
-                //
+            //
+            //  If our buffer is full and we still have an incomplete escape,
+            //  there's no more processing we can perform.  This input is
+            //  bogus.
+            //
 
-                if (EndOfEscape == StringLength - PreviouslyConsumed - 2) {
-                    break;
-                }
+            if (PreviouslyConsumed == 0) {
+                return FALSE;
+            }
 
-                DisplayString.StartOfString = CurrentPoint;
-                DisplayString.LengthInChars = EndOfEscape + 3;
+            //
+            //  If we have an incomplete escape for this chunk, stop
+            //  processing here, loop back and read more data.
+            //
 
-                if (!Callbacks->ProcessAndOutputEscape(hOutput, &DisplayString, &Callbacks->Context)) {
-                    return FALSE;
-                }
-                CurrentPoint = CurrentPoint + EndOfEscape + 3;
-                PreviouslyConsumed = PreviouslyConsumed + EndOfEscape + 3;
-            } else {
+            break;
+        } else {
 
-                //
-                //  Output just the escape character and move to the next
-                //  match
-                //
+            //
+            //  Output just the escape character and move to the next
+            //  match
+            //
 
-                DisplayString.StartOfString = CurrentPoint;
-                DisplayString.LengthInChars = 1;
-                if (!Callbacks->ProcessAndOutputText(hOutput, &DisplayString, &Callbacks->Context)) {
-                    return FALSE;
-                }
-                CurrentPoint++;
-                PreviouslyConsumed++;
+            DisplayString.StartOfString = CurrentPoint;
+            DisplayString.LengthInChars = 1;
+            if (!Callbacks->ProcessAndOutputText(hOutput, &DisplayString, &Callbacks->Context)) {
+                return FALSE;
             }
+            CurrentPoint++;
+            PreviouslyConsumed++;
         }
-
-        if (PreviouslyConsumed >= StringLength) {
-            break;
-        }
-
-        SearchString.StartOfString = CurrentPoint;
-        SearchString.LengthInChars = StringLength - PreviouslyConsumed;
-        CurrentOffset = YoriLibCntStringNotWithChars(&SearchString, YoriLibVtEscape);
     }
 
     return TRUE;
@@ -1027,6 +1416,7 @@ YoriLibOutputInternal(
     TCHAR stack_buf[64];
     TCHAR * buf;
     YORI_LIB_VT_CALLBACK_FUNCTIONS Callbacks;
+    PYORI_LIB_OUTPUT_BUFFER OutputBuffer;
     DWORD CurrentMode;
     BOOL Result;
 
@@ -1039,9 +1429,11 @@ YoriLibOutputInternal(
     //  that doesn't
     //
 
+    OutputBuffer = YoriLibOutputBufferFind(hOut);
+
     if (hOut == YORI_LIB_DEBUGGER_HANDLE) {
         YoriLibDbgSetFn(&Callbacks);
-    } else if (GetConsoleMode(hOut, &CurrentMode)) {
+    } else if (OutputBuffer == NULL && GetConsoleMode(hOut, &CurrentMode)) {
         if ((Flags & YORI_LIB_OUTPUT_STRIP_VT) != 0) {
             YoriLibConsoleNoEscSetFn(&Callbacks);
         } else if ((Flags & YORI_LIB_OUTPUT_PASSTHROUGH_VT) != 0) {
@@ -1055,12 +1447,53 @@ YoriLibOutputInternal(
         YoriLibUtf8TextWithEscSetFn(&Callbacks);
     }
 
+    //
+    //  Try to format into the buffer that is already available, which is
+    //  either the output buffer's format buffer or the stack buffer.  Most
+    //  output fits, so the size of the output only needs to be calculated if
+    //  this fails.
+    //
+
+    if (OutputBuffer != NULL && OutputBuffer->FormatBuffer != NULL) {
+        buf = OutputBuffer->FormatBuffer;
+        len = YoriLibVSPrintf(buf, OutputBuffer->FormatBufferLength, szFmt, marker);
+    } else {
+        buf = stack_buf;
+        len = YoriLibVSPrintf(buf, sizeof(stack_buf)/sizeof(stack_buf[0]), szFmt, marker);
+    }
+
+    if (len >= 0) {
+        __analysis_assume(hOut != 0);
+        return YoriLibProcVtEscOnNewStream(buf, len, hOut, &Callbacks);
+    }
+
+    marker = savedmarker;
     len = YoriLibVSPrintfSize(szFmt, marker);
 
+    //
+    //  If output is buffered, reuse a single allocation for formatting
+    //  rather than allocating on each call.
+    //
+
     if (len>(YORI_SIGNED_ALLOC_SIZE_T)(sizeof(stack_buf)/sizeof(stack_buf[0]))) {
-        buf = YoriLibMalloc(len * sizeof(TCHAR));
-        if (buf == NULL) {
-            return 0;
+        if (OutputBuffer != NULL) {
+            if ((YORI_ALLOC_SIZE_T)len > OutputBuffer->FormatBufferLength) {
+                if (OutputBuffer->FormatBuffer != NULL) {
+                    YoriLibFree(OutputBuffer->FormatBuffer);
+                    OutputBuffer->FormatBufferLength = 0;
+                }
+                OutputBuffer->FormatBuffer = YoriLibMalloc((YORI_ALLOC_SIZE_T)(len * 2 * sizeof(TCHAR)));
+                if (OutputBuffer->FormatBuffer == NULL) {
+                    return 0;
+                }
+                OutputBuffer->FormatBufferLength = (YORI_ALLOC_SIZE_T)(len * 2);
+            }
+            buf = OutputBuffer->FormatBuffer;
+        } else {
+            buf = YoriLibMalloc(len * sizeof(TCHAR));
+            if (buf == NULL) {
+                return 0;
+            }
         }
     } else {
         buf = stack_buf;
@@ -1072,7 +1505,7 @@ YoriLibOutputInternal(
     __analysis_assume(hOut != 0);
     Result = YoriLibProcVtEscOnNewStream(buf, len, hOut, &Callbacks);
 
-    if (buf != stack_buf) {
+    if (buf != stack_buf && OutputBuffer == NULL) {
         YoriLibFree(buf);
     }
     return Result;
@@ -1141,10 +1574,10 @@ YoriLibOutputString(
 
     //
     //  Check if we're writing to a console supporting color or a file
-    //  that doesn't
+    //  that doesn't.  A buffered device is known not to be a console.
     //
 
-    if (GetConsoleMode(hOut, &CurrentMode)) {
+    if (YoriLibOutputBufferFind(hOut) == NULL && GetConsoleMode(hOut, &CurrentMode)) {
         if ((Flags & YORI_LIB_OUTPUT_STRIP_VT) != 0) {
             YoriLibConsoleNoEscSetFn(&Callbacks);
         } else if ((Flags & YORI_LIB_OUTPUT_PASSTHROUGH_VT) != 0) {
@@ -1352,24 +1785,33 @@ YoriLibStripVtEscapes(
     YORI_ALLOC_SIZE_T CharIndex;
     YORI_ALLOC_SIZE_T DestIndex;
     YORI_ALLOC_SIZE_T EscapeChars;
-    YORI_ALLOC_SIZE_T EndOfEscape;
+    YORI_ALLOC_SIZE_T EscapeLength;
+    YORI_ALLOC_SIZE_T TextLength;
     YORI_STRING EscapeSubset;
 
+    //
+    //  Count the characters in escapes so the result can be allocated.
+    //  An incomplete escape is treated as text.
+    //
+
+    YoriLibInitEmptyString(&EscapeSubset);
     EscapeChars = 0;
+    CharIndex = 0;
+    while (CharIndex < VtText->LengthInChars) {
+        EscapeSubset.StartOfString = &VtText->StartOfString[CharIndex];
+        EscapeSubset.LengthInChars = VtText->LengthInChars - CharIndex;
+        CharIndex = CharIndex + YoriLibVtFindEscape(&EscapeSubset);
+        if (CharIndex >= VtText->LengthInChars) {
+            break;
+        }
 
-    for (CharIndex = 0; CharIndex < VtText->LengthInChars; CharIndex++) {
-        if (VtText->LengthInChars > CharIndex + 2 &&
-            VtText->StartOfString[CharIndex] == 27 &&
-            VtText->StartOfString[CharIndex + 1] == '[') {
-
-            YoriLibInitEmptyString(&EscapeSubset);
-            EscapeSubset.StartOfString = &VtText->StartOfString[CharIndex + 2];
-            EscapeSubset.LengthInChars = VtText->LengthInChars - CharIndex - 2;
-            EndOfEscape = YoriLibCntStringWithChars(&EscapeSubset, _T("0123456789;"));
-            if (VtText->LengthInChars > CharIndex + 2 + EndOfEscape) {
-                EscapeChars += 3 + EndOfEscape;
-                CharIndex += 2 + EndOfEscape;
-            }
+        EscapeSubset.StartOfString = &VtText->StartOfString[CharIndex];
+        EscapeSubset.LengthInChars = VtText->LengthInChars - CharIndex;
+        if (YoriLibVtGetEscapeLength(&EscapeSubset, &EscapeLength)) {
+            EscapeChars = EscapeChars + EscapeLength;
+            CharIndex = CharIndex + EscapeLength;
+        } else {
+            CharIndex++;
         }
     }
 
@@ -1380,23 +1822,34 @@ YoriLibStripVtEscapes(
         }
     }
 
+    //
+    //  Copy each range of text between escapes.
+    //
+
     DestIndex = 0;
-    for (CharIndex = 0; CharIndex < VtText->LengthInChars; CharIndex++) {
-        if (VtText->LengthInChars > CharIndex + 2 &&
-            VtText->StartOfString[CharIndex] == 27 &&
-            VtText->StartOfString[CharIndex + 1] == '[') {
-
-            YoriLibInitEmptyString(&EscapeSubset);
-            EscapeSubset.StartOfString = &VtText->StartOfString[CharIndex + 2];
-            EscapeSubset.LengthInChars = VtText->LengthInChars - CharIndex - 2;
-            EndOfEscape = YoriLibCntStringWithChars(&EscapeSubset, _T("0123456789;"));
-            if (VtText->LengthInChars > CharIndex + 2 + EndOfEscape) {
-                EscapeChars += 3 + EndOfEscape;
-                CharIndex += 2 + EndOfEscape;
-            }
+    CharIndex = 0;
+    while (CharIndex < VtText->LengthInChars) {
+        EscapeSubset.StartOfString = &VtText->StartOfString[CharIndex];
+        EscapeSubset.LengthInChars = VtText->LengthInChars - CharIndex;
+        TextLength = YoriLibVtFindEscape(&EscapeSubset);
+        if (TextLength > 0) {
+            memcpy(&PlainText->StartOfString[DestIndex], &VtText->StartOfString[CharIndex], TextLength * sizeof(TCHAR));
+            DestIndex = DestIndex + TextLength;
+            CharIndex = CharIndex + TextLength;
+        }
+
+        if (CharIndex >= VtText->LengthInChars) {
+            break;
+        }
+
+        EscapeSubset.StartOfString = &VtText->StartOfString[CharIndex];
+        EscapeSubset.LengthInChars = VtText->LengthInChars - CharIndex;
+        if (YoriLibVtGetEscapeLength(&EscapeSubset, &EscapeLength)) {
+            CharIndex = CharIndex + EscapeLength;
         } else {
             PlainText->StartOfString[DestIndex] = VtText->StartOfString[CharIndex];
             DestIndex++;
+            CharIndex++;
         }
     }
 
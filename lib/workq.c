@@ -0,0 +1,723 @@
+/**
+ * @file lib/workq.c
+ *
+ * Distribute work across a pool of threads
+ *
+ * This module contains routines which allow a program to perform a set of
+ * independent operations on multiple threads without each program needing
+ * to create, synchronize and tear down its own threads.  A fixed set of
+ * items can be processed by index, or a program that discovers work as it
+ * goes, such as while enumerating files, can submit items to a queue and
+ * have each completed item returned to it, optionally in the order it was
+ * submitted.
+ *
+ * Copyright (c) 2026 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "yoripch.h"
+#include "yorilib.h"
+
+/**
+ State shared between threads processing a fixed set of items in parallel.
+ */
+typedef struct _YORILIB_PARALLEL_ITEMS {
+
+    /**
+     The function to invoke for each item.
+     */
+    PYORILIB_PARALLEL_ITEM_FN ItemFn;
+
+    /**
+     Caller supplied context to pass to ItemFn.
+     */
+    PVOID Context;
+
+    /**
+     The number of items to process.
+     */
+    DWORD ItemCount;
+
+    /**
+     The index of the next item to be claimed by a thread.  This is updated
+     with interlocked operations.
+     */
+    DWORD NextItem;
+
+} YORILIB_PARALLEL_ITEMS, *PYORILIB_PARALLEL_ITEMS;
+
+/**
+ Claim items and process them until none remain.  This is executed on each
+ worker thread and on the thread that requested the work.
+
+ @param Param Pointer to the YORILIB_PARALLEL_ITEMS structure.
+
+ @return Zero.
+ */
+DWORD WINAPI
+YoriLibParallelItemWorker(
+    __in LPVOID Param
+    )
+{
+    PYORILIB_PARALLEL_ITEMS Items;
+    DWORD Index;
+
+    Items = (PYORILIB_PARALLEL_ITEMS)Param;
+
+    while (TRUE) {
+        Index = InterlockedIncrement((INTERLOCKED_VOLATILE LONG *)&Items->NextItem) - 1;
+        if (Index >= Items->ItemCount) {
+            break;
+        }
+
+        Items->ItemFn(Items->Context, Index);
+    }
+
+    return 0;
+}
+
+/**
+ Invoke a function once for each index in a range, using a pool of threads.
+ Items are claimed in increasing order but may complete in any order, so
+ the function must be able to operate on different items concurrently.  The
+ calling thread processes items too, and this function returns once every
+ item has been processed.  If threads cannot be created, the remaining
+ items are processed by fewer threads.
+
+ @param ItemCount The number of items to process.  The function is invoked
+        with each index from zero to ItemCount - 1.
+
+ @param ThreadCount The number of threads to use, including the calling
+        thread.  This is limited to the number of items and to the number
+        of threads that can be waited on.
+
+ @param ItemFn The function to invoke for each item.
+
+ @param Context Caller supplied context to pass to ItemFn.
+ */
+VOID
+YoriLibProcessItemsInParallel(
+    __in DWORD ItemCount,
+    __in DWORD ThreadCount,
+    __in PYORILIB_PARALLEL_ITEM_FN ItemFn,
+    __in_opt PVOID Context
+    )
+{
+    YORILIB_PARALLEL_ITEMS Items;
+    HANDLE Threads[MAXIMUM_WAIT_OBJECTS];
+    DWORD ThreadId;
+    DWORD Index;
+
+    Items.ItemFn = ItemFn;
+    Items.Context = Context;
+    Items.ItemCount = ItemCount;
+    Items.NextItem = 0;
+
+    //
+    //  The caller's thread processes items too, so only create threads for
+    //  the remainder.
+    //
+
+    if (ThreadCount > 0) {
+        ThreadCount--;
+    }
+    if (ThreadCount > sizeof(Threads)/sizeof(Threads[0])) {
+        ThreadCount = sizeof(Threads)/sizeof(Threads[0]);
+    }
+    if (ThreadCount >= ItemCount) {
+        ThreadCount = 0;
+        if (ItemCount > 0) {
+            ThreadCount = ItemCount - 1;
+        }
+    }
+
+    for (Index = 0; Index < ThreadCount; Index++) {
+        Threads[Index] = CreateThread(NULL, 0, YoriLibParallelItemWorker, &Items, 0, &ThreadId);
+        if (Threads[Index] == NULL) {
+            break;
+        }
+    }
+    ThreadCount = Index;
+
+    YoriLibParallelItemWorker(&Items);
+
+    if (ThreadCount > 0) {
+        WaitForMultipleObjects(ThreadCount, Threads, TRUE, INFINITE);
+        for (Index = 0; Index < ThreadCount; Index++) {
+            CloseHandle(Threads[Index]);
+        }
+    }
+}
+
+/**
+ A worker thread servicing a work queue.
+ */
+typedef struct _YORILIB_WORK_QUEUE_WORKER {
+
+    /**
+     The link within the list of workers servicing the queue.  This is only
+     used by the thread that owns the queue.
+     */
+    YORI_LIST_ENTRY ListEntry;
+
+    /**
+     Pointer to the queue that this worker takes items from.
+     */
+    PYORILIB_WORK_QUEUE Queue;
+
+    /**
+     Caller supplied context for this worker, passed to each invocation of
+     the execute function on this worker.
+     */
+    PVOID WorkerContext;
+
+    /**
+     Handle to the thread executing this worker.
+     */
+    HANDLE hThread;
+
+} YORILIB_WORK_QUEUE_WORKER, *PYORILIB_WORK_QUEUE_WORKER;
+
+/**
+ A queue of items to be executed by a pool of worker threads and returned
+ to the thread that submitted them.
+ */
+typedef struct _YORILIB_WORK_QUEUE {
+
+    /**
+     The function to invoke on a worker thread for each item.
+     */
+    PYORILIB_WORK_QUEUE_EXECUTE_FN ExecuteFn;
+
+    /**
+     The function to invoke on the submitting thread for each item once it
+     has been executed.
+     */
+    PYORILIB_WORK_QUEUE_COMPLETE_FN CompleteFn;
+
+    /**
+     Caller supplied context to pass to ExecuteFn and CompleteFn.
+     */
+    PVOID Context;
+
+    /**
+     A combination of YORILIB_WORK_QUEUE_ flags.
+     */
+    DWORD Flags;
+
+    /**
+     The maximum number of batchable items a worker takes from the queue at
+     once.
+     */
+    DWORD MaxBatch;
+
+    /**
+     A mutex protecting the pending list, the completion state of each item,
+     and the number of workers running.
+     */
+    HANDLE Mutex;
+
+    /**
+     A semaphore which is signalled once for each item added to the pending
+     list, and once for each worker when terminating.
+     */
+    HANDLE WorkAvailableSemaphore;
+
+    /**
+     An event which is signalled whenever a worker completes items or exits.
+     */
+    HANDLE ItemCompleteEvent;
+
+    /**
+     A list of items which have not yet been picked up by a worker.
+     Protected by Mutex.
+     */
+    YORI_LIST_ENTRY PendingList;
+
+    /**
+     A list of items which have not yet been returned to the caller, in the
+     order they were submitted.  This is only used by the thread that owns
+     the queue.
+     */
+    YORI_LIST_ENTRY OrderList;
+
+    /**
+     A list of worker threads servicing the queue.  This is only used by the
+     thread that owns the queue.
+     */
+    YORI_LIST_ENTRY WorkerList;
+
+    /**
+     The number of items in OrderList.
+     */
+    DWORD ItemsOutstanding;
+
+    /**
+     The number of worker threads in WorkerList.
+     */
+    DWORD WorkerCount;
+
+    /**
+     The number of worker threads which are still able to execute items.
+     Protected by Mutex.
+     */
+    DWORD WorkersRunning;
+
+    /**
+     Set to TRUE to indicate that worker threads should terminate once no
+     more work is pending.  Protected by Mutex.
+     */
+    BOOLEAN Terminate;
+
+} YORILIB_WORK_QUEUE;
+
+/**
+ Prepare an item to be submitted to a work queue.  The caller may mark the
+ item as batchable after this call, or as complete if no work is needed and
+ the item only needs to be returned in order.
+
+ @param Item Pointer to the item to initialize.
+ */
+VOID
+YoriLibWorkQueueInitializeItem(
+    __out PYORILIB_WORK_ITEM Item
+    )
+{
+    YoriLibInitializeListHead(&Item->PendingListEntry);
+    YoriLibInitializeListHead(&Item->OrderListEntry);
+    Item->Complete = FALSE;
+    Item->Executed = FALSE;
+    Item->Batchable = FALSE;
+}
+
+/**
+ Mark every item which has not been picked up by a worker as complete
+ without executing it.  This is used once no workers remain, since nothing
+ else would complete these items.  The caller must hold the queue's Mutex.
+
+ @param Queue Pointer to the work queue.
+ */
+VOID
+YoriLibWorkQueueAbandonPendingLocked(
+    __in PYORILIB_WORK_QUEUE Queue
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PYORILIB_WORK_ITEM Item;
+
+    while (TRUE) {
+        ListEntry = YoriLibGetNextListEntry(&Queue->PendingList, NULL);
+        if (ListEntry == NULL) {
+            break;
+        }
+        YoriLibRemoveListItem(ListEntry);
+        Item = CONTAINING_RECORD(ListEntry, YORILIB_WORK_ITEM, PendingListEntry);
+        Item->Complete = TRUE;
+    }
+}
+
+/**
+ A worker thread which executes items submitted to a work queue.  When the
+ first pending item is batchable, any batchable items which immediately
+ follow it are taken too, up to the queue's batch limit.
+
+ @param Parameter Pointer to the worker state for this thread.
+
+ @return Exit code for the thread, currently always zero.
+ */
+DWORD WINAPI
+YoriLibWorkQueueWorkerThread(
+    __in LPVOID Parameter
+    )
+{
+    PYORILIB_WORK_QUEUE_WORKER Worker;
+    PYORILIB_WORK_QUEUE Queue;
+    PYORI_LIST_ENTRY ListEntry;
+    PYORILIB_WORK_ITEM Item;
+    YORI_LIST_ENTRY Batch;
+    DWORD BatchCount;
+    BOOLEAN KeepRunning;
+    BOOLEAN Terminate;
+
+    Worker = (PYORILIB_WORK_QUEUE_WORKER)Parameter;
+    Queue = Worker->Queue;
+    KeepRunning = TRUE;
+
+    while (KeepRunning) {
+        WaitForSingleObject(Queue->WorkAvailableSemaphore, INFINITE);
+
+        WaitForSingleObject(Queue->Mutex, INFINITE);
+        ListEntry = YoriLibGetNextListEntry(&Queue->PendingList, NULL);
+        if (ListEntry == NULL) {
+            Terminate = Queue->Terminate;
+            ReleaseMutex(Queue->Mutex);
+            if (Terminate) {
+                break;
+            }
+            continue;
+        }
+
+        //
+        //  Other workers woken for items taken as part of a batch will find
+        //  them gone and wait again.
+        //
+
+        YoriLibInitializeListHead(&Batch);
+        BatchCount = 0;
+        while (ListEntry != NULL && BatchCount < Queue->MaxBatch) {
+            Item = CONTAINING_RECORD(ListEntry, YORILIB_WORK_ITEM, PendingListEntry);
+            if (BatchCount > 0 && !Item->Batchable) {
+                break;
+            }
+            YoriLibRemoveListItem(ListEntry);
+            YoriLibAppendList(&Batch, ListEntry);
+            BatchCount++;
+            if (!Item->Batchable) {
+                break;
+            }
+            ListEntry = YoriLibGetNextListEntry(&Queue->PendingList, NULL);
+        }
+        ReleaseMutex(Queue->Mutex);
+
+        //
+        //  If the execute function indicates this worker can't continue,
+        //  the rest of its batch is completed without being executed.
+        //
+
+        ListEntry = YoriLibGetNextListEntry(&Batch, NULL);
+        while (ListEntry != NULL) {
+            Item = CONTAINING_RECORD(ListEntry, YORILIB_WORK_ITEM, PendingListEntry);
+            if (KeepRunning) {
+                Item->Executed = TRUE;
+                KeepRunning = Queue->ExecuteFn(Queue->Context, Worker->WorkerContext, Item);
+            }
+            ListEntry = YoriLibGetNextListEntry(&Batch, ListEntry);
+        }
+
+        WaitForSingleObject(Queue->Mutex, INFINITE);
+        while (TRUE) {
+            ListEntry = YoriLibGetNextListEntry(&Batch, NULL);
+            if (ListEntry == NULL) {
+                break;
+            }
+            YoriLibRemoveListItem(ListEntry);
+            Item = CONTAINING_RECORD(ListEntry, YORILIB_WORK_ITEM, PendingListEntry);
+            Item->Complete = TRUE;
+        }
+        ReleaseMutex(Queue->Mutex);
+        SetEvent(Queue->ItemCompleteEvent);
+    }
+
+    WaitForSingleObject(Queue->Mutex, INFINITE);
+    Queue->WorkersRunning--;
+    if (Queue->WorkersRunning == 0) {
+        YoriLibWorkQueueAbandonPendingLocked(Queue);
+    }
+    ReleaseMutex(Queue->Mutex);
+    SetEvent(Queue->ItemCompleteEvent);
+
+    return 0;
+}
+
+/**
+ Create a work queue.  The queue has no workers until they are added with
+ YoriLibWorkQueueAddWorker.  Items are submitted and returned by the owner
+ of the queue, which may call from more than one thread provided the calls
+ are not made at the same time.
+
+ @param Flags A combination of YORILIB_WORK_QUEUE_ flags.
+
+ @param MaxBatch The maximum number of batchable items a worker takes from
+        the queue at once.  Zero or one disables batching.
+
+ @param ExecuteFn The function to invoke on a worker thread for each item.
+
+ @param CompleteFn The function to invoke on the owning thread for each item
+        once it is complete.  This function takes ownership of the item, and
+        may submit further items to the queue.
+
+ @param Context Caller supplied context to pass to ExecuteFn and
+        CompleteFn.
+
+ @return Pointer to the work queue, or NULL on failure.
+ */
+PYORILIB_WORK_QUEUE
+YoriLibWorkQueueCreate(
+    __in DWORD Flags,
+    __in DWORD MaxBatch,
+    __in PYORILIB_WORK_QUEUE_EXECUTE_FN ExecuteFn,
+    __in PYORILIB_WORK_QUEUE_COMPLETE_FN CompleteFn,
+    __in_opt PVOID Context
+    )
+{
+    PYORILIB_WORK_QUEUE Queue;
+
+    Queue = YoriLibMalloc(sizeof(YORILIB_WORK_QUEUE));
+    if (Queue == NULL) {
+        return NULL;
+    }
+
+    ZeroMemory(Queue, sizeof(YORILIB_WORK_QUEUE));
+    Queue->ExecuteFn = ExecuteFn;
+    Queue->CompleteFn = CompleteFn;
+    Queue->Context = Context;
+    Queue->Flags = Flags;
+    Queue->MaxBatch = MaxBatch;
+    if (Queue->MaxBatch == 0) {
+        Queue->MaxBatch = 1;
+    }
+
+    YoriLibInitializeListHead(&Queue->PendingList);
+    YoriLibInitializeListHead(&Queue->OrderList);
+    YoriLibInitializeListHead(&Queue->WorkerList);
+
+    Queue->Mutex = CreateMutex(NULL, FALSE, NULL);
+    Queue->WorkAvailableSemaphore = CreateSemaphore(NULL, 0, 0x7FFFFFFF, NULL);
+    Queue->ItemCompleteEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+    if (Queue->Mutex == NULL ||
+        Queue->WorkAvailableSemaphore == NULL ||
+        Queue->ItemCompleteEvent == NULL) {
+
+        YoriLibWorkQueueDestroy(Queue);
+        return NULL;
+    }
+
+    return Queue;
+}
+
+/**
+ Add a worker thread to a work queue.
+
+ @param Queue Pointer to the work queue.
+
+ @param WorkerContext Caller supplied context for this worker, passed to
+        each invocation of the execute function on this worker.  This
+        allows each worker to have its own buffers or resources.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriLibWorkQueueAddWorker(
+    __in PYORILIB_WORK_QUEUE Queue,
+    __in_opt PVOID WorkerContext
+    )
+{
+    PYORILIB_WORK_QUEUE_WORKER Worker;
+    DWORD ThreadId;
+
+    Worker = YoriLibMalloc(sizeof(YORILIB_WORK_QUEUE_WORKER));
+    if (Worker == NULL) {
+        return FALSE;
+    }
+
+    Worker->Queue = Queue;
+    Worker->WorkerContext = WorkerContext;
+
+    //
+    //  Count the worker as running before it starts, so that it can't
+    //  exit and find no workers remaining before it has been counted.
+    //
+
+    WaitForSingleObject(Queue->Mutex, INFINITE);
+    Queue->WorkersRunning++;
+    ReleaseMutex(Queue->Mutex);
+
+    Worker->hThread = CreateThread(NULL, 0, YoriLibWorkQueueWorkerThread, Worker, 0, &ThreadId);
+    if (Worker->hThread == NULL) {
+        WaitForSingleObject(Queue->Mutex, INFINITE);
+        Queue->WorkersRunning--;
+        ReleaseMutex(Queue->Mutex);
+        YoriLibFree(Worker);
+        return FALSE;
+    }
+
+    YoriLibAppendList(&Queue->WorkerList, &Worker->ListEntry);
+    Queue->WorkerCount++;
+    return TRUE;
+}
+
+/**
+ Submit an item to a work queue.  The item is executed by a worker thread
+ and returned to the caller's complete function from a later call to
+ YoriLibWorkQueueComplete.  If the item is already marked complete, it is
+ not executed, but is still returned in order.  This does not wait, so
+ callers are expected to call YoriLibWorkQueueComplete to bound the number
+ of items outstanding.
+
+ @param Queue Pointer to the work queue.
+
+ @param Item Pointer to the item to submit, initialized with
+        YoriLibWorkQueueInitializeItem.  The queue refers to the item until
+        it is passed to the complete function.
+ */
+VOID
+YoriLibWorkQueueSubmit(
+    __in PYORILIB_WORK_QUEUE Queue,
+    __in PYORILIB_WORK_ITEM Item
+    )
+{
+    BOOLEAN Pending;
+
+    Pending = FALSE;
+    YoriLibAppendList(&Queue->OrderList, &Item->OrderListEntry);
+    Queue->ItemsOutstanding++;
+
+    if (!Item->Complete) {
+        Pending = TRUE;
+        WaitForSingleObject(Queue->Mutex, INFINITE);
+        YoriLibAppendList(&Queue->PendingList, &Item->PendingListEntry);
+        ReleaseMutex(Queue->Mutex);
+    }
+
+    if (Pending) {
+        ReleaseSemaphore(Queue->WorkAvailableSemaphore, 1, NULL);
+    }
+}
+
+/**
+ Return items which have been completed by worker threads to the complete
+ function, and wait for items to complete until no more than a specified
+ number remain outstanding.  If the queue was created with
+ YORILIB_WORK_QUEUE_KEEP_ORDER, items are returned in the order they were
+ submitted, otherwise they are returned as soon as they are complete.  If
+ no workers are running, items which have not been executed are returned
+ with their Executed field set to FALSE.
+
+ @param Queue Pointer to the work queue.
+
+ @param ItemsToLeaveOutstanding The number of items which may remain
+        incomplete when this function returns.  Zero waits for all items to
+        complete.
+
+ @param Timeout The maximum time to wait for an item to complete, in
+        milliseconds, or INFINITE.  This allows the caller to perform
+        periodic work, such as displaying progress, while waiting.
+
+ @return TRUE if no more than ItemsToLeaveOutstanding items remain, or FALSE
+         if the timeout elapsed without an item completing.
+ */
+BOOLEAN
+YoriLibWorkQueueComplete(
+    __in PYORILIB_WORK_QUEUE Queue,
+    __in DWORD ItemsToLeaveOutstanding,
+    __in DWORD Timeout
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PYORILIB_WORK_ITEM Item;
+
+    while (TRUE) {
+        WaitForSingleObject(Queue->Mutex, INFINITE);
+        if (Queue->WorkersRunning == 0) {
+            YoriLibWorkQueueAbandonPendingLocked(Queue);
+        }
+
+        //
+        //  Only this thread changes the order list, so the next entry
+        //  remains valid while the mutex is released to return an item.
+        //
+
+        ListEntry = YoriLibGetNextListEntry(&Queue->OrderList, NULL);
+        while (ListEntry != NULL) {
+            Item = CONTAINING_RECORD(ListEntry, YORILIB_WORK_ITEM, OrderListEntry);
+            ListEntry = YoriLibGetNextListEntry(&Queue->OrderList, ListEntry);
+
+            if (!Item->Complete) {
+                if (Queue->Flags & YORILIB_WORK_QUEUE_KEEP_ORDER) {
+                    break;
+                }
+                continue;
+            }
+
+            YoriLibRemoveListItem(&Item->OrderListEntry);
+            Queue->ItemsOutstanding--;
+            ReleaseMutex(Queue->Mutex);
+            Queue->CompleteFn(Queue->Context, Item);
+            WaitForSingleObject(Queue->Mutex, INFINITE);
+        }
+        ReleaseMutex(Queue->Mutex);
+
+        if (Queue->ItemsOutstanding <= ItemsToLeaveOutstanding) {
+            return TRUE;
+        }
+
+        if (WaitForSingleObject(Queue->ItemCompleteEvent, Timeout) == WAIT_TIMEOUT) {
+            return FALSE;
+        }
+    }
+}
+
+/**
+ Wait for all items submitted to a work queue to complete and be returned,
+ terminate its worker threads, and free it.
+
+ @param Queue Pointer to the work queue.
+ */
+VOID
+YoriLibWorkQueueDestroy(
+    __in PYORILIB_WORK_QUEUE Queue
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PYORILIB_WORK_QUEUE_WORKER Worker;
+
+    if (Queue->Mutex != NULL &&
+        Queue->WorkAvailableSemaphore != NULL &&
+        Queue->ItemCompleteEvent != NULL) {
+
+        YoriLibWorkQueueComplete(Queue, 0, INFINITE);
+
+        WaitForSingleObject(Queue->Mutex, INFINITE);
+        Queue->Terminate = TRUE;
+        ReleaseMutex(Queue->Mutex);
+        if (Queue->WorkerCount > 0) {
+            ReleaseSemaphore(Queue->WorkAvailableSemaphore, Queue->WorkerCount, NULL);
+        }
+    }
+
+    while (TRUE) {
+        ListEntry = YoriLibGetNextListEntry(&Queue->WorkerList, NULL);
+        if (ListEntry == NULL) {
+            break;
+        }
+        YoriLibRemoveListItem(ListEntry);
+        Worker = CONTAINING_RECORD(ListEntry, YORILIB_WORK_QUEUE_WORKER, ListEntry);
+        WaitForSingleObject(Worker->hThread, INFINITE);
+        CloseHandle(Worker->hThread);
+        YoriLibFree(Worker);
+    }
+
+    if (Queue->ItemCompleteEvent != NULL) {
+        CloseHandle(Queue->ItemCompleteEvent);
+    }
+
+    if (Queue->WorkAvailableSemaphore != NULL) {
+        CloseHandle(Queue->WorkAvailableSemaphore);
+    }
+
+    if (Queue->Mutex != NULL) {
+        CloseHandle(Queue->Mutex);
+    }
+
+    YoriLibFree(Queue);
+}
+
+// vim:sw=4:ts=4:et:
@@ -243,6 +243,54 @@ YoriLibCloneString(
     memcpy(Dest, Src, sizeof(YORI_STRING));
 }
 
+/**
+ Initialize a Yori string to describe a range of characters within another
+ Yori string by referencing any existing allocation.  No characters are
+ copied, so the new string shares the buffer of the source string and
+ should not be modified while the buffer is shared.
+
+ @param Dest The Yori string to be populated with the range of characters.
+        This string will be reinitialized, and this function makes no attempt
+        to free or preserve previous contents.
+
+ @param Src The string that contains the range of characters.
+
+ @param Offset The offset, in characters, of the start of the range within
+        Src.
+
+ @param Length The number of characters in the range.
+ */
+VOID
+YoriLibCloneSubstring(
+    __out PYORI_STRING Dest,
+    __in PYORI_STRING Src,
+    __in YORI_ALLOC_SIZE_T Offset,
+    __in YORI_ALLOC_SIZE_T Length
+    )
+{
+    ASSERT(Offset + Length <= Src->LengthInChars);
+
+    if (Src->MemoryToFree != NULL) {
+        YoriLibReference(Src->MemoryToFree);
+    }
+
+    Dest->MemoryToFree = Src->MemoryToFree;
+    Dest->StartOfString = &Src->StartOfString[Offset];
+    Dest->LengthInChars = Length;
+
+    //
+    //  If the range extends to the end of the source string, any remaining
+    //  allocation (including a NULL terminator) is still valid.  Otherwise
+    //  the string is followed by other characters from the source.
+    //
+
+    if (Offset + Length == Src->LengthInChars) {
+        Dest->LengthAllocated = Src->LengthAllocated - Offset;
+    } else {
+        Dest->LengthAllocated = Length;
+    }
+}
+
 /**
  Copy the contents of one Yori string to another by deep copying the string
  contents.
@@ -147,6 +147,8 @@ YoriLibCompareStringLitInsCnt(
     )
 {
     YORI_ALLOC_SIZE_T Index = 0;
+    TCHAR Char1;
+    TCHAR Char2;
 
     if (count == 0) {
         return 0;
@@ -164,10 +166,16 @@ YoriLibCompareStringLitInsCnt(
             return 1;
         }
 
-        if (YoriLibUpcaseChar(Str1->StartOfString[Index]) < YoriLibUpcaseChar(str2[Index])) {
-            return -1;
-        } else if (YoriLibUpcaseChar(Str1->StartOfString[Index]) > YoriLibUpcaseChar(str2[Index])) {
-            return 1;
+        Char1 = Str1->StartOfString[Index];
+        Char2 = str2[Index];
+        if (Char1 != Char2) {
+            Char1 = YoriLibUpcaseChar(Char1);
+            Char2 = YoriLibUpcaseChar(Char2);
+            if (Char1 < Char2) {
+                return -1;
+            } else if (Char1 > Char2) {
+                return 1;
+            }
         }
 
         Index++;
@@ -223,37 +231,44 @@ YoriLibCompareStringCnt(
     __in YORI_ALLOC_SIZE_T count
     )
 {
-    YORI_ALLOC_SIZE_T Index = 0;
-
-    if (count == 0) {
-        return 0;
+    YORI_ALLOC_SIZE_T Index;
+    YORI_ALLOC_SIZE_T Limit;
+
+    //
+    //  Determine the number of characters which are present in both strings
+    //  and are within the count to compare, so the loop only needs to check
+    //  one limit per character.
+    //
+
+    Limit = count;
+    if (Limit > Str1->LengthInChars) {
+        Limit = Str1->LengthInChars;
+    }
+    if (Limit > Str2->LengthInChars) {
+        Limit = Str2->LengthInChars;
     }
 
-    while(TRUE) {
-
-        if (Index == Str1->LengthInChars) {
-            if (Index == Str2->LengthInChars) {
-                return 0;
-            } else {
-                return -1;
-            }
-        } else if (Index == Str2->LengthInChars) {
-            return 1;
-        }
-
+    for (Index = 0; Index < Limit; Index++) {
         if (Str1->StartOfString[Index] < Str2->StartOfString[Index]) {
             return -1;
         } else if (Str1->StartOfString[Index] > Str2->StartOfString[Index]) {
             return 1;
         }
+    }
 
-        Index++;
+    if (Index == count) {
+        return 0;
+    }
 
-        if (Index == count) {
+    if (Index == Str1->LengthInChars) {
+        if (Index == Str2->LengthInChars) {
             return 0;
+        } else {
+            return -1;
         }
     }
-    return 0;
+
+    return 1;
 }
 
 /**
@@ -301,37 +316,52 @@ YoriLibCompareStringInsCnt(
     __in YORI_ALLOC_SIZE_T count
     )
 {
-    YORI_ALLOC_SIZE_T Index = 0;
-
-    if (count == 0) {
-        return 0;
+    YORI_ALLOC_SIZE_T Index;
+    YORI_ALLOC_SIZE_T Limit;
+    TCHAR Char1;
+    TCHAR Char2;
+
+    //
+    //  Determine the number of characters which are present in both strings
+    //  and are within the count to compare, so the loop only needs to check
+    //  one limit per character.
+    //
+
+    Limit = count;
+    if (Limit > Str1->LengthInChars) {
+        Limit = Str1->LengthInChars;
+    }
+    if (Limit > Str2->LengthInChars) {
+        Limit = Str2->LengthInChars;
     }
 
-    while(TRUE) {
-
-        if (Index == Str1->LengthInChars) {
-            if (Index == Str2->LengthInChars) {
-                return 0;
-            } else {
+    for (Index = 0; Index < Limit; Index++) {
+        Char1 = Str1->StartOfString[Index];
+        Char2 = Str2->StartOfString[Index];
+        if (Char1 != Char2) {
+            Char1 = YoriLibUpcaseChar(Char1);
+            Char2 = YoriLibUpcaseChar(Char2);
+            if (Char1 < Char2) {
                 return -1;
+            } else if (Char1 > Char2) {
+                return 1;
             }
-        } else if (Index == Str2->LengthInChars) {
-            return 1;
-        }
-
-        if (YoriLibUpcaseChar(Str1->StartOfString[Index]) < YoriLibUpcaseChar(Str2->StartOfString[Index])) {
-            return -1;
-        } else if (YoriLibUpcaseChar(Str1->StartOfString[Index]) > YoriLibUpcaseChar(Str2->StartOfString[Index])) {
-            return 1;
         }
+    }
 
-        Index++;
+    if (Index == count) {
+        return 0;
+    }
 
-        if (Index == count) {
+    if (Index == Str1->LengthInChars) {
+        if (Index == Str2->LengthInChars) {
             return 0;
+        } else {
+            return -1;
         }
     }
-    return 0;
+
+    return 1;
 }
 
 /**
@@ -0,0 +1,732 @@
+/**
+ * @file lib/ylstrmch.c
+ *
+ * Yori search for many substrings in a single pass
+ *
+ * Copyright (c) 2026 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "yoripch.h"
+#include "yorilib.h"
+
+//
+//  A substring matcher is an Aho-Corasick automaton built from a set of
+//  strings, which allows a string to be searched for all of them by
+//  examining each character once.
+//
+//  Characters which occur in any of the strings are assigned a class number,
+//  starting from one.  Class zero refers to any character that is not in any
+//  of the strings, which always returns the automaton to its initial state.
+//  Each state has a transition for each class, so the automaton is a table
+//  of StateCount * ClassCount entries.  Characters below 256 are classified
+//  with a table; other characters are classified with a binary search of
+//  the sorted characters that occur in the strings.
+//
+//  If only one non-empty string is being searched for, no automaton is
+//  built, and the search scans for the first character of the string before
+//  comparing the remainder.
+//
+
+/**
+ A value indicating no state or no match string.
+ */
+#define YORI_LIB_SUBSTRING_MATCHER_NONE ((YORI_ALLOC_SIZE_T)-1)
+
+/**
+ Return the character to use for matching, which is the upcased form of the
+ character if the matcher is case insensitive.
+
+ @param Matcher Pointer to the matcher.
+
+ @param Char The character from a string.
+
+ @return The character to use for matching.
+ */
+TCHAR
+YoriLibSubstringMatcherFoldChar(
+    __in PYORI_LIB_SUBSTRING_MATCHER Matcher,
+    __in TCHAR Char
+    )
+{
+    if (Matcher->Insensitive) {
+        return YoriLibUpcaseChar(Char);
+    }
+    return Char;
+}
+
+/**
+ Return the class of a character which has already been folded.
+
+ @param Matcher Pointer to the matcher.
+
+ @param Char The character to classify.
+
+ @return The class of the character, or zero if the character does not occur
+         in any match string.
+ */
+YORI_ALLOC_SIZE_T
+YoriLibSubstringMatcherClassifyChar(
+    __in PYORI_LIB_SUBSTRING_MATCHER Matcher,
+    __in TCHAR Char
+    )
+{
+    YORI_ALLOC_SIZE_T Start;
+    YORI_ALLOC_SIZE_T End;
+    YORI_ALLOC_SIZE_T Middle;
+
+    if (Char < 256) {
+        return Matcher->LowClass[Char];
+    }
+
+    Start = 0;
+    End = Matcher->HighCharCount;
+    while (Start < End) {
+        Middle = Start + (End - Start) / 2;
+        if (Matcher->HighChars[Middle] == Char) {
+            return Matcher->HighClass[Middle];
+        } else if (Matcher->HighChars[Middle] < Char) {
+            Start = Middle + 1;
+        } else {
+            End = Middle;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ Free any allocations within a substring matcher.  The matcher itself is
+ typically a stack or embedded allocation and is not freed.
+
+ @param Matcher Pointer to the matcher to clean up.
+ */
+VOID
+YoriLibSubstringMatcherCleanup(
+    __inout PYORI_LIB_SUBSTRING_MATCHER Matcher
+    )
+{
+    if (Matcher->HighChars != NULL) {
+        YoriLibFree(Matcher->HighChars);
+        Matcher->HighChars = NULL;
+    }
+    if (Matcher->HighClass != NULL) {
+        YoriLibFree(Matcher->HighClass);
+        Matcher->HighClass = NULL;
+    }
+    if (Matcher->Transitions != NULL) {
+        YoriLibFree(Matcher->Transitions);
+        Matcher->Transitions = NULL;
+    }
+    if (Matcher->StateMatch != NULL) {
+        YoriLibFree(Matcher->StateMatch);
+        Matcher->StateMatch = NULL;
+    }
+    if (Matcher->OutputLink != NULL) {
+        YoriLibFree(Matcher->OutputLink);
+        Matcher->OutputLink = NULL;
+    }
+    Matcher->StateCount = 0;
+    Matcher->ClassCount = 0;
+    Matcher->HighCharCount = 0;
+}
+
+/**
+ Assign a class number to every distinct character in the match strings.
+
+ @param Matcher Pointer to the matcher.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+YoriLibSubstringMatcherBuildClasses(
+    __inout PYORI_LIB_SUBSTRING_MATCHER Matcher
+    )
+{
+    YORI_ALLOC_SIZE_T MatchIndex;
+    YORI_ALLOC_SIZE_T CharIndex;
+    YORI_ALLOC_SIZE_T Index;
+    YORI_ALLOC_SIZE_T HighCount;
+    YORI_ALLOC_SIZE_T TotalChars;
+    PYORI_STRING MatchString;
+    TCHAR Char;
+
+    //
+    //  Count the characters that can't be classified with the table.
+    //
+
+    TotalChars = 0;
+    for (MatchIndex = 0; MatchIndex < Matcher->NumberMatches; MatchIndex++) {
+        MatchString = &Matcher->MatchArray[MatchIndex];
+        for (CharIndex = 0; CharIndex < MatchString->LengthInChars; CharIndex++) {
+            Char = YoriLibSubstringMatcherFoldChar(Matcher, MatchString->StartOfString[CharIndex]);
+            if (Char >= 256) {
+                TotalChars++;
+            }
+        }
+    }
+
+    if (TotalChars > 0) {
+        Matcher->HighChars = YoriLibMalloc((YORI_ALLOC_SIZE_T)(TotalChars * sizeof(TCHAR)));
+        Matcher->HighClass = YoriLibMalloc((YORI_ALLOC_SIZE_T)(TotalChars * sizeof(YORI_ALLOC_SIZE_T)));
+        if (Matcher->HighChars == NULL || Matcher->HighClass == NULL) {
+            return FALSE;
+        }
+    }
+
+    //
+    //  Classify characters below 256 directly, and insert other characters
+    //  into a sorted array without duplicates.
+    //
+
+    HighCount = 0;
+    for (MatchIndex = 0; MatchIndex < Matcher->NumberMatches; MatchIndex++) {
+        MatchString = &Matcher->MatchArray[MatchIndex];
+        for (CharIndex = 0; CharIndex < MatchString->LengthInChars; CharIndex++) {
+            Char = YoriLibSubstringMatcherFoldChar(Matcher, MatchString->StartOfString[CharIndex]);
+            if (Char < 256) {
+                if (Matcher->LowClass[Char] == 0) {
+                    Matcher->ClassCount++;
+                    Matcher->LowClass[Char] = Matcher->ClassCount;
+                }
+                continue;
+            }
+
+            for (Index = HighCount; Index > 0; Index--) {
+                if (Matcher->HighChars[Index - 1] <= Char) {
+                    break;
+                }
+            }
+
+            if (Index > 0 && Matcher->HighChars[Index - 1] == Char) {
+                continue;
+            }
+
+            memmove(&Matcher->HighChars[Index + 1], &Matcher->HighChars[Index], (HighCount - Index) * sizeof(TCHAR));
+            memmove(&Matcher->HighClass[Index + 1], &Matcher->HighClass[Index], (HighCount - Index) * sizeof(YORI_ALLOC_SIZE_T));
+            Matcher->ClassCount++;
+            Matcher->HighChars[Index] = Char;
+            Matcher->HighClass[Index] = Matcher->ClassCount;
+            HighCount++;
+        }
+    }
+
+    Matcher->HighCharCount = HighCount;
+    return TRUE;
+}
+
+/**
+ Build the automaton for a set of match strings.  This constructs a trie of
+ the match strings, then performs a breadth first traversal of the trie to
+ find, for each state, the state representing its longest proper suffix.
+ Missing transitions are replaced with the transition from that state, and
+ each state is linked to the nearest suffix state which completes a match.
+
+ @param Matcher Pointer to the matcher.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+YoriLibSubstringMatcherBuildAutomaton(
+    __inout PYORI_LIB_SUBSTRING_MATCHER Matcher
+    )
+{
+    YORI_ALLOC_SIZE_T MatchIndex;
+    YORI_ALLOC_SIZE_T CharIndex;
+    YORI_ALLOC_SIZE_T StatesAllocated;
+    YORI_ALLOC_SIZE_T State;
+    YORI_ALLOC_SIZE_T NextState;
+    YORI_ALLOC_SIZE_T FailState;
+    YORI_ALLOC_SIZE_T Class;
+    YORI_ALLOC_SIZE_T QueueHead;
+    YORI_ALLOC_SIZE_T QueueTail;
+    YORI_MAX_UNSIGNED_T BytesNeeded;
+    PYORI_ALLOC_SIZE_T Transitions;
+    PYORI_ALLOC_SIZE_T Fail;
+    PYORI_ALLOC_SIZE_T Queue;
+    PYORI_STRING MatchString;
+    TCHAR Char;
+
+    StatesAllocated = 1;
+    for (MatchIndex = 0; MatchIndex < Matcher->NumberMatches; MatchIndex++) {
+        StatesAllocated = StatesAllocated + Matcher->MatchArray[MatchIndex].LengthInChars;
+    }
+
+    BytesNeeded = (YORI_MAX_UNSIGNED_T)StatesAllocated * Matcher->ClassCount * sizeof(YORI_ALLOC_SIZE_T);
+    if (!YoriLibIsSizeAllocatable(BytesNeeded)) {
+        return FALSE;
+    }
+
+    Matcher->Transitions = YoriLibMalloc((YORI_ALLOC_SIZE_T)BytesNeeded);
+    Matcher->StateMatch = YoriLibMalloc((YORI_ALLOC_SIZE_T)(StatesAllocated * sizeof(YORI_ALLOC_SIZE_T)));
+    Matcher->OutputLink = YoriLibMalloc((YORI_ALLOC_SIZE_T)(StatesAllocated * sizeof(YORI_ALLOC_SIZE_T)));
+    Fail = YoriLibMalloc((YORI_ALLOC_SIZE_T)(StatesAllocated * sizeof(YORI_ALLOC_SIZE_T)));
+    Queue = YoriLibMalloc((YORI_ALLOC_SIZE_T)(StatesAllocated * sizeof(YORI_ALLOC_SIZE_T)));
+    if (Matcher->Transitions == NULL ||
+        Matcher->StateMatch == NULL ||
+        Matcher->OutputLink == NULL ||
+        Fail == NULL ||
+        Queue == NULL) {
+
+        if (Fail != NULL) {
+            YoriLibFree(Fail);
+        }
+        if (Queue != NULL) {
+            YoriLibFree(Queue);
+        }
+        return FALSE;
+    }
+
+    Transitions = Matcher->Transitions;
+    for (State = 0; State < StatesAllocated; State++) {
+        for (Class = 0; Class < Matcher->ClassCount; Class++) {
+            Transitions[State * Matcher->ClassCount + Class] = YORI_LIB_SUBSTRING_MATCHER_NONE;
+        }
+        Matcher->StateMatch[State] = YORI_LIB_SUBSTRING_MATCHER_NONE;
+        Matcher->OutputLink[State] = 0;
+    }
+
+    //
+    //  Build the trie.  If a match string is specified more than once, the
+    //  first is reported.
+    //
+
+    Matcher->StateCount = 1;
+    for (MatchIndex = 0; MatchIndex < Matcher->NumberMatches; MatchIndex++) {
+        MatchString = &Matcher->MatchArray[MatchIndex];
+        if (MatchString->LengthInChars == 0) {
+            continue;
+        }
+
+        State = 0;
+        for (CharIndex = 0; CharIndex < MatchString->LengthInChars; CharIndex++) {
+            Char = YoriLibSubstringMatcherFoldChar(Matcher, MatchString->StartOfString[CharIndex]);
+            Class = YoriLibSubstringMatcherClassifyChar(Matcher, Char) - 1;
+            NextState = Transitions[State * Matcher->ClassCount + Class];
+            if (NextState == YORI_LIB_SUBSTRING_MATCHER_NONE) {
+                NextState = Matcher->StateCount;
+                Matcher->StateCount++;
+                Transitions[State * Matcher->ClassCount + Class] = NextState;
+            }
+            State = NextState;
+        }
+
+        if (Matcher->StateMatch[State] == YORI_LIB_SUBSTRING_MATCHER_NONE) {
+            Matcher->StateMatch[State] = MatchIndex;
+        }
+    }
+
+    //
+    //  Traverse the trie breadth first, so that the suffix state of every
+    //  state is complete before the states below it are processed.
+    //
+
+    QueueHead = 0;
+    QueueTail = 0;
+    for (Class = 0; Class < Matcher->ClassCount; Class++) {
+        NextState = Transitions[Class];
+        if (NextState == YORI_LIB_SUBSTRING_MATCHER_NONE) {
+            Transitions[Class] = 0;
+        } else {
+            Fail[NextState] = 0;
+            Queue[QueueTail] = NextState;
+            QueueTail++;
+        }
+    }
+
+    while (QueueHead < QueueTail) {
+        State = Queue[QueueHead];
+        QueueHead++;
+
+        for (Class = 0; Class < Matcher->ClassCount; Class++) {
+            NextState = Transitions[State * Matcher->ClassCount + Class];
+            FailState = Transitions[Fail[State] * Matcher->ClassCount + Class];
+            if (NextState == YORI_LIB_SUBSTRING_MATCHER_NONE) {
+                Transitions[State * Matcher->ClassCount + Class] = FailState;
+                continue;
+            }
+
+            Fail[NextState] = FailState;
+            if (Matcher->StateMatch[FailState] != YORI_LIB_SUBSTRING_MATCHER_NONE) {
+                Matcher->OutputLink[NextState] = FailState;
+            } else {
+                Matcher->OutputLink[NextState] = Matcher->OutputLink[FailState];
+            }
+            Queue[QueueTail] = NextState;
+            QueueTail++;
+        }
+    }
+
+    YoriLibFree(Fail);
+    YoriLibFree(Queue);
+    return TRUE;
+}
+
+/**
+ Prepare a substring matcher to search for a set of strings.  Once prepared,
+ the matcher can be used to search any number of strings, and is typically
+ prepared once before searching many lines.  The match strings are
+ referenced by the matcher and must remain valid until it is cleaned up.
+
+ @param Matcher Pointer to the matcher to initialize.  On success, the caller
+        should call @ref YoriLibSubstringMatcherCleanup when it is no longer
+        needed.
+
+ @param NumberMatches The number of substrings to look for.
+
+ @param MatchArray An array of strings corresponding to the matches to look
+        for.
+
+ @param Insensitive If TRUE, strings are matched case insensitively.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriLibSubstringMatcherInitialize(
+    __out PYORI_LIB_SUBSTRING_MATCHER Matcher,
+    __in YORI_ALLOC_SIZE_T NumberMatches,
+    __in PYORI_STRING MatchArray,
+    __in BOOLEAN Insensitive
+    )
+{
+    YORI_ALLOC_SIZE_T MatchIndex;
+    YORI_ALLOC_SIZE_T NonEmptyCount;
+
+    ZeroMemory(Matcher, sizeof(YORI_LIB_SUBSTRING_MATCHER));
+    Matcher->NumberMatches = NumberMatches;
+    Matcher->MatchArray = MatchArray;
+    Matcher->Insensitive = Insensitive;
+    Matcher->EmptyMatchIndex = YORI_LIB_SUBSTRING_MATCHER_NONE;
+    Matcher->SingleMatchIndex = YORI_LIB_SUBSTRING_MATCHER_NONE;
+
+    NonEmptyCount = 0;
+    for (MatchIndex = 0; MatchIndex < NumberMatches; MatchIndex++) {
+        if (MatchArray[MatchIndex].LengthInChars == 0) {
+            if (Matcher->EmptyMatchIndex == YORI_LIB_SUBSTRING_MATCHER_NONE) {
+                Matcher->EmptyMatchIndex = MatchIndex;
+            }
+            continue;
+        }
+
+        NonEmptyCount++;
+        Matcher->SingleMatchIndex = MatchIndex;
+        if (MatchArray[MatchIndex].LengthInChars > Matcher->MaximumLength) {
+            Matcher->MaximumLength = MatchArray[MatchIndex].LengthInChars;
+        }
+    }
+
+    if (NonEmptyCount <= 1) {
+        return TRUE;
+    }
+
+    Matcher->SingleMatchIndex = YORI_LIB_SUBSTRING_MATCHER_NONE;
+
+    if (!YoriLibSubstringMatcherBuildClasses(Matcher) ||
+        !YoriLibSubstringMatcherBuildAutomaton(Matcher)) {
+
+        YoriLibSubstringMatcherCleanup(Matcher);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ Search for a single match string by looking for its first character and
+ comparing the remainder where it is found.
+
+ @param Matcher Pointer to the matcher.
+
+ @param String The string to search through.
+
+ @param StringOffsetOfMatch On successful completion, set to the offset of
+        the first match.
+
+ @return TRUE if the match string was found, FALSE if it was not.
+ */
+__success(return)
+BOOLEAN
+YoriLibSubstringMatcherSearchSingle(
+    __in PYORI_LIB_SUBSTRING_MATCHER Matcher,
+    __in PCYORI_STRING String,
+    __out PYORI_ALLOC_SIZE_T StringOffsetOfMatch
+    )
+{
+    PYORI_STRING MatchString;
+    YORI_STRING RemainingString;
+    YORI_ALLOC_SIZE_T Index;
+    YORI_ALLOC_SIZE_T LastStart;
+    TCHAR FirstChar;
+
+    MatchString = &Matcher->MatchArray[Matcher->SingleMatchIndex];
+    if (String->LengthInChars < MatchString->LengthInChars) {
+        return FALSE;
+    }
+
+    FirstChar = YoriLibSubstringMatcherFoldChar(Matcher, MatchString->StartOfString[0]);
+    LastStart = String->LengthInChars - MatchString->LengthInChars;
+
+    YoriLibInitEmptyString(&RemainingString);
+    for (Index = 0; Index <= LastStart; Index++) {
+        if (YoriLibSubstringMatcherFoldChar(Matcher, String->StartOfString[Index]) != FirstChar) {
+            continue;
+        }
+
+        RemainingString.StartOfString = &String->StartOfString[Index];
+        RemainingString.LengthInChars = String->LengthInChars - Index;
+        if (Matcher->Insensitive) {
+            if (YoriLibCompareStringInsCnt(&RemainingString, MatchString, MatchString->LengthInChars) == 0) {
+                *StringOffsetOfMatch = Index;
+                return TRUE;
+            }
+        } else {
+            if (YoriLibCompareStringCnt(&RemainingString, MatchString, MatchString->LengthInChars) == 0) {
+                *StringOffsetOfMatch = Index;
+                return TRUE;
+            }
+        }
+    }
+
+    return FALSE;
+}
+
+/**
+ Search through a string for the match strings in a matcher.
+
+ @param Matcher Pointer to the matcher.
+
+ @param String The string to search through.
+
+ @param ByPriority If TRUE, find the match string earliest in the match array
+        which occurs anywhere in the string.  If FALSE, find the match which
+        starts earliest in the string, and if more than one match string
+        starts at that offset, the one earliest in the match array.
+
+ @param StringOffsetOfMatch On successful completion, returns the offset
+        within the string of the match.
+
+ @return If a match is found, returns a pointer to the entry in the match
+         array corresponding to the substring that was matched.  If no match
+         is found, returns NULL.
+ */
+PYORI_STRING
+YoriLibSubstringMatcherSearch(
+    __in PYORI_LIB_SUBSTRING_MATCHER Matcher,
+    __in PCYORI_STRING String,
+    __in BOOLEAN ByPriority,
+    __out_opt PYORI_ALLOC_SIZE_T StringOffsetOfMatch
+    )
+{
+    YORI_ALLOC_SIZE_T BestMatch;
+    YORI_ALLOC_SIZE_T BestOffset;
+    YORI_ALLOC_SIZE_T MatchIndex;
+    YORI_ALLOC_SIZE_T MatchOffset;
+    YORI_ALLOC_SIZE_T Index;
+    YORI_ALLOC_SIZE_T State;
+    YORI_ALLOC_SIZE_T OutputState;
+    YORI_ALLOC_SIZE_T Class;
+    YORI_STRING RemainingString;
+    PYORI_STRING MatchString;
+
+    BestMatch = YORI_LIB_SUBSTRING_MATCHER_NONE;
+    BestOffset = 0;
+
+    if (String->LengthInChars == 0) {
+        goto Done;
+    }
+
+    //
+    //  An empty match string matches at the start of any nonempty string.
+    //  When searching for the earliest match, the only thing that could be
+    //  preferred is an earlier entry in the array matching at the start.
+    //
+
+    if (Matcher->EmptyMatchIndex != YORI_LIB_SUBSTRING_MATCHER_NONE) {
+        BestMatch = Matcher->EmptyMatchIndex;
+        if (!ByPriority) {
+            YoriLibInitEmptyString(&RemainingString);
+            RemainingString.StartOfString = String->StartOfString;
+            RemainingString.LengthInChars = String->LengthInChars;
+            for (MatchIndex = 0; MatchIndex < Matcher->EmptyMatchIndex; MatchIndex++) {
+                MatchString = &Matcher->MatchArray[MatchIndex];
+                if (Matcher->Insensitive) {
+                    if (YoriLibCompareStringInsCnt(&RemainingString, MatchString, MatchString->LengthInChars) == 0) {
+                        BestMatch = MatchIndex;
+                        break;
+                    }
+                } else {
+                    if (YoriLibCompareStringCnt(&RemainingString, MatchString, MatchString->LengthInChars) == 0) {
+                        BestMatch = MatchIndex;
+                        break;
+                    }
+                }
+            }
+            goto Done;
+        }
+    }
+
+    if (Matcher->SingleMatchIndex != YORI_LIB_SUBSTRING_MATCHER_NONE) {
+        if (BestMatch != YORI_LIB_SUBSTRING_MATCHER_NONE &&
+            BestMatch < Matcher->SingleMatchIndex) {
+
+            goto Done;
+        }
+        if (YoriLibSubstringMatcherSearchSingle(Matcher, String, &MatchOffset)) {
+            BestMatch = Matcher->SingleMatchIndex;
+            BestOffset = MatchOffset;
+        }
+        goto Done;
+    }
+
+    if (Matcher->StateCount == 0) {
+        goto Done;
+    }
+
+    State = 0;
+    for (Index = 0; Index < String->LengthInChars; Index++) {
+        Class = YoriLibSubstringMatcherClassifyChar(Matcher, YoriLibSubstringMatcherFoldChar(Matcher, String->StartOfString[Index]));
+        if (Class == 0) {
+            State = 0;
+            continue;
+        }
+
+        State = Matcher->Transitions[State * Matcher->ClassCount + Class - 1];
+
+        //
+        //  Check every match string ending at this character.
+        //
+
+        OutputState = State;
+        if (Matcher->StateMatch[OutputState] == YORI_LIB_SUBSTRING_MATCHER_NONE) {
+            OutputState = Matcher->OutputLink[OutputState];
+        }
+
+        while (OutputState != 0) {
+            MatchIndex = Matcher->StateMatch[OutputState];
+            MatchOffset = Index + 1 - Matcher->MatchArray[MatchIndex].LengthInChars;
+            if (BestMatch == YORI_LIB_SUBSTRING_MATCHER_NONE) {
+                BestMatch = MatchIndex;
+                BestOffset = MatchOffset;
+            } else if (ByPriority) {
+                if (MatchIndex < BestMatch) {
+                    BestMatch = MatchIndex;
+                    BestOffset = MatchOffset;
+                }
+            } else {
+                if (MatchOffset < BestOffset ||
+                    (MatchOffset == BestOffset && MatchIndex < BestMatch)) {
+                    BestMatch = MatchIndex;
+                    BestOffset = MatchOffset;
+                }
+            }
+            OutputState = Matcher->OutputLink[OutputState];
+        }
+
+        //
+        //  Stop once nothing later in the string could be preferred.
+        //
+
+        if (BestMatch != YORI_LIB_SUBSTRING_MATCHER_NONE) {
+            if (ByPriority) {
+                if (BestMatch == 0) {
+                    break;
+                }
+            } else if (Index + 1 >= BestOffset + Matcher->MaximumLength) {
+                break;
+            }
+        }
+    }
+
+Done:
+
+    if (BestMatch == YORI_LIB_SUBSTRING_MATCHER_NONE) {
+        if (StringOffsetOfMatch != NULL) {
+            *StringOffsetOfMatch = 0;
+        }
+        return NULL;
+    }
+
+    if (StringOffsetOfMatch != NULL) {
+        *StringOffsetOfMatch = BestOffset;
+    }
+    return &Matcher->MatchArray[BestMatch];
+}
+
+/**
+ Search through a string looking to see if any of the substrings in a
+ matcher can be located.  Returns the first match in offset from the
+ beginning of the string order.  If more than one substring matches at the
+ same offset, the one earliest in the match array is returned.  This returns
+ the same result as @ref YoriLibFindFirstMatchSubstr or
+ @ref YoriLibFindFirstMatchSubstrIns, but examines each character of the
+ string once regardless of the number of substrings.
+
+ @param Matcher Pointer to the matcher.
+
+ @param String The string to search through.
+
+ @param StringOffsetOfMatch On successful completion, returns the offset
+        within the string of the match.
+
+ @return If a match is found, returns a pointer to the entry in the match
+         array corresponding to the substring that was matched.  If no match
+         is found, returns NULL.
+ */
+PYORI_STRING
+YoriLibSubstringMatcherFindFirst(
+    __in PYORI_LIB_SUBSTRING_MATCHER Matcher,
+    __in PCYORI_STRING String,
+    __out_opt PYORI_ALLOC_SIZE_T StringOffsetOfMatch
+    )
+{
+    return YoriLibSubstringMatcherSearch(Matcher, String, FALSE, StringOffsetOfMatch);
+}
+
+/**
+ Search through a string looking to see if any of the substrings in a
+ matcher can be located.  Returns the substring earliest in the match array
+ which occurs anywhere in the string, which is the result of searching for
+ each substring in turn and stopping at the first that is found.
+
+ @param Matcher Pointer to the matcher.
+
+ @param String The string to search through.
+
+ @param StringOffsetOfMatch On successful completion, returns the offset
+        within the string of the first occurrence of the substring.
+
+ @return If a match is found, returns a pointer to the entry in the match
+         array corresponding to the substring that was matched.  If no match
+         is found, returns NULL.
+ */
+PYORI_STRING
+YoriLibSubstringMatcherFindByPriority(
+    __in PYORI_LIB_SUBSTRING_MATCHER Matcher,
+    __in PCYORI_STRING String,
+    __out_opt PYORI_ALLOC_SIZE_T StringOffsetOfMatch
+    )
+{
+    return YoriLibSubstringMatcherSearch(Matcher, String, TRUE, StringOffsetOfMatch);
+}
+
+// vim:sw=4:ts=4:et:
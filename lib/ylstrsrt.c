@@ -175,4 +175,148 @@ YoriLibSortStringArray(
     ASSERT (Index == Count - 1);
 }
 
+/**
+ The number of strings in each range that is sorted by insertion before
+ ranges are merged by YoriLibStableSortStringArray.
+ */
+#define YORI_LIB_STABLE_SORT_RUN_LENGTH (16)
+
+/**
+ Sort an array of strings using a caller supplied comparison.  Unlike
+ YoriLibSortStringArray, this sort is stable, so strings which compare as
+ equal remain in the order they were in the array.  This is implemented as
+ a merge sort of ranges which are first sorted by insertion, and requires
+ a temporary array as large as the array being sorted.
+
+ @param StringArray Pointer to an array of strings.
+
+ @param Count The number of elements in the array.
+
+ @param CompareFn Pointer to a function to compare two strings.
+
+ @param Context Optionally points to context to pass to CompareFn.
+
+ @return TRUE to indicate the array was sorted, FALSE if memory could not be
+         allocated, in which case the array is partially sorted.
+ */
+__success(return)
+BOOL
+YoriLibStableSortStringArray(
+    __in_ecount(Count) PYORI_STRING StringArray,
+    __in YORI_ALLOC_SIZE_T Count,
+    __in PYORILIB_STRING_COMPARE_FN CompareFn,
+    __in_opt PVOID Context
+    )
+{
+    YORI_ALLOC_SIZE_T RunStart;
+    YORI_ALLOC_SIZE_T RunEnd;
+    YORI_ALLOC_SIZE_T Index;
+    YORI_ALLOC_SIZE_T InsertIndex;
+    YORI_ALLOC_SIZE_T Width;
+    YORI_ALLOC_SIZE_T Left;
+    YORI_ALLOC_SIZE_T Middle;
+    YORI_ALLOC_SIZE_T Right;
+    YORI_ALLOC_SIZE_T LeftIndex;
+    YORI_ALLOC_SIZE_T RightIndex;
+    YORI_ALLOC_SIZE_T DestIndex;
+    PYORI_STRING Scratch;
+    PYORI_STRING Source;
+    PYORI_STRING Dest;
+    PYORI_STRING Swap;
+    YORI_STRING Entry;
+
+    if (Count <= 1) {
+        return TRUE;
+    }
+
+    //
+    //  Sort small ranges by insertion.
+    //
+
+    for (RunStart = 0; RunStart < Count; RunStart = RunEnd) {
+        RunEnd = Count;
+        if (Count - RunStart > YORI_LIB_STABLE_SORT_RUN_LENGTH) {
+            RunEnd = RunStart + YORI_LIB_STABLE_SORT_RUN_LENGTH;
+        }
+
+        for (Index = RunStart + 1; Index < RunEnd; Index++) {
+            memcpy(&Entry, &StringArray[Index], sizeof(YORI_STRING));
+            for (InsertIndex = Index; InsertIndex > RunStart; InsertIndex--) {
+                if (CompareFn(&StringArray[InsertIndex - 1], &Entry, Context) <= 0) {
+                    break;
+                }
+                memcpy(&StringArray[InsertIndex], &StringArray[InsertIndex - 1], sizeof(YORI_STRING));
+            }
+            memcpy(&StringArray[InsertIndex], &Entry, sizeof(YORI_STRING));
+        }
+    }
+
+    if (Count <= YORI_LIB_STABLE_SORT_RUN_LENGTH) {
+        return TRUE;
+    }
+
+    if (!YoriLibIsSizeAllocatable((YORI_MAX_UNSIGNED_T)Count * sizeof(YORI_STRING))) {
+        return FALSE;
+    }
+
+    Scratch = YoriLibMalloc((YORI_ALLOC_SIZE_T)(Count * sizeof(YORI_STRING)));
+    if (Scratch == NULL) {
+        return FALSE;
+    }
+
+    //
+    //  Merge pairs of adjacent ranges, alternating between the array and
+    //  the temporary array, doubling the size of the ranges each pass.
+    //  When two strings are equal, the one from the earlier range is
+    //  taken first, which preserves the original order.
+    //
+
+    Source = StringArray;
+    Dest = Scratch;
+
+    for (Width = YORI_LIB_STABLE_SORT_RUN_LENGTH; Width < Count; ) {
+        for (Left = 0; Left < Count; Left = Right) {
+            Middle = Count;
+            if (Count - Left > Width) {
+                Middle = Left + Width;
+            }
+            Right = Count;
+            if (Count - Middle > Width) {
+                Right = Middle + Width;
+            }
+
+            LeftIndex = Left;
+            RightIndex = Middle;
+            for (DestIndex = Left; DestIndex < Right; DestIndex++) {
+                if (RightIndex >= Right ||
+                    (LeftIndex < Middle &&
+                     CompareFn(&Source[LeftIndex], &Source[RightIndex], Context) <= 0)) {
+
+                    memcpy(&Dest[DestIndex], &Source[LeftIndex], sizeof(YORI_STRING));
+                    LeftIndex++;
+                } else {
+                    memcpy(&Dest[DestIndex], &Source[RightIndex], sizeof(YORI_STRING));
+                    RightIndex++;
+                }
+            }
+        }
+
+        Swap = Source;
+        Source = Dest;
+        Dest = Swap;
+
+        if (Width > Count / 2) {
+            break;
+        }
+        Width = Width * 2;
+    }
+
+    if (Source != StringArray) {
+        memcpy(StringArray, Source, Count * sizeof(YORI_STRING));
+    }
+
+    YoriLibFree(Scratch);
+    return TRUE;
+}
+
 // vim:sw=4:ts=4:et:
@@ -116,6 +116,12 @@ YoriCallGetHistoryStrings(
     __out PYORI_STRING HistoryStrings
     );
 
+BOOL
+YoriCallGetJobAccounting(
+    __in DWORD JobId,
+    __out PYORI_LIB_JOB_ACCOUNTING Accounting
+    );
+
 BOOL
 YoriCallGetJobInformation(
     __in DWORD JobId,
@@ -125,6 +131,9 @@ YoriCallGetJobInformation(
     __inout PYORI_STRING Command
     );
 
+DWORD
+YoriCallGetJobLimit(VOID);
+
 BOOL
 YoriCallGetJobOutput(
     __in DWORD JobId,
@@ -178,6 +187,11 @@ YoriCallSetEnvironmentVariable(
     __in_opt PYORI_STRING Value
     );
 
+BOOL
+YoriCallSetJobLimit(
+    __in DWORD JobLimit
+    );
+
 BOOL
 YoriCallSetJobPriority(
     __in DWORD JobId,
@@ -199,6 +213,9 @@ YoriCallTerminateJob(
     __in DWORD JobId
     );
 
+DWORD
+YoriCallWaitForAnyJob(VOID);
+
 VOID
 YoriCallWaitForJob(
     __in DWORD JobId
@@ -247,6 +247,14 @@ typedef _Return_type_success_(return >= 0) long HRESULT;
 #define STATUS_NO_MORE_ENTRIES ((LONG)0x8000001A)
 #endif
 
+#ifndef STATUS_NO_MORE_FILES
+/**
+ If not defined by the current compilation environment, the NTSTATUS code
+ indicating no more files were found in a directory enumerate.
+ */
+#define STATUS_NO_MORE_FILES ((LONG)0x80000006)
+#endif
+
 #ifndef STATUS_NOT_IMPLEMENTED
 /**
  If not defined by the current compilation environment, the NTSTATUS code
@@ -271,6 +279,14 @@ typedef _Return_type_success_(return >= 0) long HRESULT;
 #define STATUS_INFO_LENGTH_MISMATCH ((LONG)0xC0000004)
 #endif
 
+#ifndef STATUS_NO_SUCH_FILE
+/**
+ If not defined by the current compilation environment, the NTSTATUS code
+ indicating no file matched a directory enumerate.
+ */
+#define STATUS_NO_SUCH_FILE ((LONG)0xC000000F)
+#endif
+
 #ifndef STATUS_DELETE_PENDING
 /**
  If not defined by the current compilation environment, the NTSTATUS code
@@ -395,6 +411,195 @@ typedef struct _YORI_OBJECT_ATTRIBUTES {
 
 } YORI_OBJECT_ATTRIBUTES, *PYORI_OBJECT_ATTRIBUTES;
 
+/**
+ Definition of the information class to enumerate directory entries
+ including file IDs for compilation environments that don't define it.
+ */
+#define FileIdBothDirectoryInformation (37)
+
+/**
+ A structure that is returned by NtQueryDirectoryFile for each entry when
+ using FileIdBothDirectoryInformation.
+ */
+typedef struct _YORI_FILE_ID_BOTH_DIR_INFORMATION {
+
+    /**
+     The offset in bytes from the start of this entry to the next entry,
+     or zero if this is the final entry.
+     */
+    DWORD NextEntryOffset;
+
+    /**
+     The byte offset of the file within the parent directory.  This is not
+     meaningful on many file systems.
+     */
+    DWORD FileIndex;
+
+    /**
+     The time the file was created.
+     */
+    LARGE_INTEGER CreationTime;
+
+    /**
+     The time the file was last accessed.
+     */
+    LARGE_INTEGER LastAccessTime;
+
+    /**
+     The time the file was last written to.
+     */
+    LARGE_INTEGER LastWriteTime;
+
+    /**
+     The time the file metadata was last changed.
+     */
+    LARGE_INTEGER ChangeTime;
+
+    /**
+     The logical length of the file.
+     */
+    LARGE_INTEGER EndOfFile;
+
+    /**
+     The amount of space allocated to the file.
+     */
+    LARGE_INTEGER AllocationSize;
+
+    /**
+     The file's attributes.
+     */
+    DWORD FileAttributes;
+
+    /**
+     The length of FileName, in bytes.
+     */
+    DWORD FileNameLength;
+
+    /**
+     The size of the file's extended attributes.  For reparse points, this
+     field contains the reparse tag instead.
+     */
+    DWORD EaSize;
+
+    /**
+     The length of ShortName, in bytes.
+     */
+    CHAR ShortNameLength;
+
+    /**
+     The short name of the file.  This is not NULL terminated.
+     */
+    WCHAR ShortName[12];
+
+    /**
+     The file system's identifier for the file.
+     */
+    LARGE_INTEGER FileId;
+
+    /**
+     The name of the file.  This is not NULL terminated.
+     */
+    WCHAR FileName[1];
+
+} YORI_FILE_ID_BOTH_DIR_INFORMATION, *PYORI_FILE_ID_BOTH_DIR_INFORMATION;
+
+/**
+ Definition of the information class to enumerate directory entries
+ including 128 bit file IDs and reparse tags for compilation environments
+ that don't define it.
+ */
+#define FileIdExtdBothDirectoryInformation (63)
+
+/**
+ A structure that is returned by NtQueryDirectoryFile for each entry when
+ using FileIdExtdBothDirectoryInformation.
+ */
+typedef struct _YORI_FILE_ID_EXTD_BOTH_DIR_INFORMATION {
+
+    /**
+     The offset in bytes from the start of this entry to the next entry,
+     or zero if this is the final entry.
+     */
+    DWORD NextEntryOffset;
+
+    /**
+     The byte offset of the file within the parent directory.  This is not
+     meaningful on many file systems.
+     */
+    DWORD FileIndex;
+
+    /**
+     The time the file was created.
+     */
+    LARGE_INTEGER CreationTime;
+
+    /**
+     The time the file was last accessed.
+     */
+    LARGE_INTEGER LastAccessTime;
+
+    /**
+     The time the file was last written to.
+     */
+    LARGE_INTEGER LastWriteTime;
+
+    /**
+     The time the file metadata was last changed.
+     */
+    LARGE_INTEGER ChangeTime;
+
+    /**
+     The logical length of the file.
+     */
+    LARGE_INTEGER EndOfFile;
+
+    /**
+     The amount of space allocated to the file.
+     */
+    LARGE_INTEGER AllocationSize;
+
+    /**
+     The file's attributes.
+     */
+    DWORD FileAttributes;
+
+    /**
+     The length of FileName, in bytes.
+     */
+    DWORD FileNameLength;
+
+    /**
+     The size of the file's extended attributes.
+     */
+    DWORD EaSize;
+
+    /**
+     The reparse tag of the file, if it is a reparse point.
+     */
+    DWORD ReparsePointTag;
+
+    /**
+     The 128 bit file system identifier for the file.
+     */
+    BYTE FileId[16];
+
+    /**
+     The length of ShortName, in bytes.
+     */
+    CHAR ShortNameLength;
+
+    /**
+     The short name of the file.  This is not NULL terminated.
+     */
+    WCHAR ShortName[12];
+
+    /**
+     The name of the file.  This is not NULL terminated.
+     */
+    WCHAR FileName[1];
+
+} YORI_FILE_ID_EXTD_BOTH_DIR_INFORMATION, *PYORI_FILE_ID_EXTD_BOTH_DIR_INFORMATION;
+
 /**
  Definition of the information class to enumerate process IDs using a file
  for compilation environments that don't define it.
@@ -439,6 +644,43 @@ typedef struct _YORI_FILE_CASE_SENSITIVE_INFORMATION {
 
 } YORI_FILE_CASE_SENSITIVE_INFORMATION, *PYORI_FILE_CASE_SENSITIVE_INFORMATION;
 
+/**
+ Definition of the information class to set the allocation size of a file
+ for compilation environments that don't define it.
+ */
+#define FileAllocationInformation (19)
+
+/**
+ Information about the space allocated to a file.
+ */
+typedef struct _YORI_FILE_ALLOCATION_INFORMATION {
+
+    /**
+     The number of bytes to allocate to the file.
+     */
+    LARGE_INTEGER AllocationSize;
+
+} YORI_FILE_ALLOCATION_INFORMATION, *PYORI_FILE_ALLOCATION_INFORMATION;
+
+/**
+ Definition of the information class to set the valid data length of a file
+ for compilation environments that don't define it.
+ */
+#define FileValidDataLengthInformation (39)
+
+/**
+ Information about the valid data length of a file.  Data beyond this point
+ is returned as zero without being read from disk.
+ */
+typedef struct _YORI_FILE_VALID_DATA_LENGTH_INFORMATION {
+
+    /**
+     The offset in bytes of the end of the valid data in the file.
+     */
+    LARGE_INTEGER ValidDataLength;
+
+} YORI_FILE_VALID_DATA_LENGTH_INFORMATION, *PYORI_FILE_VALID_DATA_LENGTH_INFORMATION;
+
 /**
  Definition of the information class to query memory usage of a process for
  compilation environments that don't define it.
@@ -1041,6 +1283,12 @@ typedef struct _YORI_LIB_PEB64 {
  */
 #define SystemProcessInformation (5)
 
+/**
+ Definition of the system processor performance information enumeration
+ class for NtQuerySystemInformation .
+ */
+#define SystemProcessorPerformanceInformation (8)
+
 /**
  Definition of the system handle information enumeration class for
  NtQuerySystemInformation .
@@ -1150,12 +1398,72 @@ typedef struct _YORI_SYSTEM_PROCESS_INFORMATION {
     PVOID Reserved6[2];
 
     /**
-     Ignored in this application.
+     The number of read operations performed by the process.
+     */
+    LARGE_INTEGER ReadOperationCount;
+
+    /**
+     The number of write operations performed by the process.
+     */
+    LARGE_INTEGER WriteOperationCount;
+
+    /**
+     The number of operations other than reads and writes performed by the
+     process.
+     */
+    LARGE_INTEGER OtherOperationCount;
+
+    /**
+     The number of bytes read by the process.
+     */
+    LARGE_INTEGER ReadTransferCount;
+
+    /**
+     The number of bytes written by the process.
+     */
+    LARGE_INTEGER WriteTransferCount;
+
+    /**
+     The number of bytes transferred by operations other than reads and
+     writes.
      */
-    LARGE_INTEGER Reserved7[6];
+    LARGE_INTEGER OtherTransferCount;
 
 } YORI_SYSTEM_PROCESS_INFORMATION, *PYORI_SYSTEM_PROCESS_INFORMATION;
 
+/**
+ Information returned about every logical processor in a processor group.
+ */
+typedef struct _YORI_SYSTEM_PROCESSOR_PERFORMANCE_INFORMATION {
+
+    /**
+     The amount of time the processor has spent idle.
+     */
+    LARGE_INTEGER IdleTime;
+
+    /**
+     The amount of time the processor has spent executing in kernel mode.
+     This includes the time the processor has spent idle.
+     */
+    LARGE_INTEGER KernelTime;
+
+    /**
+     The amount of time the processor has spent executing in user mode.
+     */
+    LARGE_INTEGER UserTime;
+
+    /**
+     Ignored in this application.
+     */
+    LARGE_INTEGER Reserved1[2];
+
+    /**
+     Ignored in this application.
+     */
+    ULONG Reserved2;
+
+} YORI_SYSTEM_PROCESSOR_PERFORMANCE_INFORMATION, *PYORI_SYSTEM_PROCESSOR_PERFORMANCE_INFORMATION;
+
 /**
  Information returned about every thread in the process.
  */
@@ -2234,6 +2542,14 @@ typedef struct _YORI_SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX {
 #define PROCESS_MODE_BACKGROUND_BEGIN 0x00100000
 #endif
 
+#ifndef THREAD_MODE_BACKGROUND_BEGIN
+/**
+ Define the value for low CPU, disk and memory priority for a single thread
+ for compilation environments that don't define it.
+ */
+#define THREAD_MODE_BACKGROUND_BEGIN 0x00010000
+#endif
+
 #ifndef INVALID_LCN
 /**
  A value describing an invalid LCN (region not allocated) for compilation
@@ -2343,6 +2659,13 @@ typedef struct _YORI_VOLUME_DISK_EXTENTS {
 #define IO_REPARSE_TAG_APPEXECLINK (0x8000001B)
 #endif
 
+#ifndef IO_REPARSE_TAG_WOF
+/**
+ The reparse tag indicating a file whose contents are provided by WOF.
+ */
+#define IO_REPARSE_TAG_WOF         (0x80000017)
+#endif
+
 /**
  A structure recording reparse data on a file.
  */
@@ -2577,6 +2900,22 @@ typedef struct _YORI_REPARSE_DATA_BUFFER {
 #define COMPRESSION_FORMAT_LZNT1        (0x0002)
 #endif
 
+#ifndef COMPRESSION_FORMAT_XPRESS
+/**
+ Specifies the identifier for the Xpress compression algorithm when
+ compressing buffers in memory.
+ */
+#define COMPRESSION_FORMAT_XPRESS       (0x0003)
+#endif
+
+#ifndef COMPRESSION_ENGINE_STANDARD
+/**
+ Specifies that buffers should be compressed with the standard engine,
+ favoring speed over compression ratio.
+ */
+#define COMPRESSION_ENGINE_STANDARD     (0x0000)
+#endif
+
 #ifndef FSCTL_GET_NTFS_VOLUME_DATA
 /**
  Specifies the FSCTL_GET_NTFS_VOLUME_DATA numerical representation if the
@@ -2853,6 +3192,66 @@ typedef struct _MOVE_FILE_DATA {
 } MOVE_FILE_DATA, *PMOVE_FILE_DATA;
 #endif
 
+#ifndef FSCTL_GET_VOLUME_BITMAP
+/**
+ Specifies the FSCTL_GET_VOLUME_BITMAP numerical representation if the
+ compilation environment doesn't provide it.
+ */
+#define FSCTL_GET_VOLUME_BITMAP          CTL_CODE(FILE_DEVICE_FILE_SYSTEM, 27,  METHOD_NEITHER, FILE_ANY_ACCESS)
+
+/**
+ Specifies information required to request the allocation state of clusters
+ on a volume.
+ */
+typedef struct {
+
+    /**
+     Specifies the first cluster on the volume whose allocation state is
+     requested.
+     */
+    LARGE_INTEGER StartingLcn;
+
+} STARTING_LCN_INPUT_BUFFER;
+
+/**
+ Pointer to information required to request the allocation state of clusters
+ on a volume.
+ */
+typedef STARTING_LCN_INPUT_BUFFER *PSTARTING_LCN_INPUT_BUFFER;
+
+/**
+ A buffer returned when querying the allocation state of clusters on a
+ volume.  Defined here for when the compilation environment doesn't define
+ it.
+ */
+typedef struct {
+
+    /**
+     The first cluster described by this buffer.  This can be earlier than
+     the cluster that was requested.
+     */
+    LARGE_INTEGER StartingLcn;
+
+    /**
+     The number of clusters from StartingLcn to the end of the volume.
+     */
+    LARGE_INTEGER BitmapSize;
+
+    /**
+     A bitmap containing one bit per cluster, set if the cluster is in use.
+     The IOCTL result indicates how many bytes are present.
+     */
+    BYTE Buffer[1];
+
+} VOLUME_BITMAP_BUFFER;
+
+/**
+ Pointer to a buffer returned when querying the allocation state of clusters
+ on a volume.
+ */
+typedef VOLUME_BITMAP_BUFFER *PVOLUME_BITMAP_BUFFER;
+#endif
+
 #ifndef FSCTL_QUERY_ALLOCATED_RANGES
 /**
  Specifies the FSCTL_QUERY_ALLOCATED_RANGES numerical representation if the
@@ -2879,20 +3278,65 @@ typedef struct _FILE_ALLOCATED_RANGE_BUFFER {
 
 #endif
 
-#ifndef FSCTL_GET_OBJECT_ID
+#ifndef FSCTL_SET_SPARSE
 /**
- Specifies the FSCTL_GET_OBJECT_ID numerical representation if the
- compilation environment doesn't provide it.
+ Specifies the FSCTL_SET_SPARSE numerical representation if the compilation
+ environment doesn't provide it.
  */
-#define FSCTL_GET_OBJECT_ID             CTL_CODE(FILE_DEVICE_FILE_SYSTEM, 39, METHOD_BUFFERED, FILE_ANY_ACCESS)
+#define FSCTL_SET_SPARSE                CTL_CODE(FILE_DEVICE_FILE_SYSTEM, 49, METHOD_BUFFERED, FILE_ANY_ACCESS)
+#endif
 
+#ifndef FSCTL_DUPLICATE_EXTENTS_TO_FILE
 /**
- Information about a file's object ID if the compilation environment doesn't
- provide it.
+ Specifies the FSCTL_DUPLICATE_EXTENTS_TO_FILE numerical representation if
+ the compilation environment doesn't provide it.
  */
-typedef struct _FILE_OBJECTID_BUFFER {
+#define FSCTL_DUPLICATE_EXTENTS_TO_FILE CTL_CODE(FILE_DEVICE_FILE_SYSTEM, 209, METHOD_BUFFERED, FILE_WRITE_DATA)
 
-    /**
+/**
+ Specifies a range of a source file to share with a range of the target
+ file.
+ */
+typedef struct _DUPLICATE_EXTENTS_DATA {
+
+    /**
+     Handle to the source file.
+     */
+    HANDLE FileHandle;
+
+    /**
+     The offset of the range within the source file, in bytes.
+     */
+    LARGE_INTEGER SourceFileOffset;
+
+    /**
+     The offset of the range within the target file, in bytes.
+     */
+    LARGE_INTEGER TargetFileOffset;
+
+    /**
+     The length of the range, in bytes.
+     */
+    LARGE_INTEGER ByteCount;
+
+} DUPLICATE_EXTENTS_DATA, *PDUPLICATE_EXTENTS_DATA;
+
+#endif
+
+#ifndef FSCTL_GET_OBJECT_ID
+/**
+ Specifies the FSCTL_GET_OBJECT_ID numerical representation if the
+ compilation environment doesn't provide it.
+ */
+#define FSCTL_GET_OBJECT_ID             CTL_CODE(FILE_DEVICE_FILE_SYSTEM, 39, METHOD_BUFFERED, FILE_ANY_ACCESS)
+
+/**
+ Information about a file's object ID if the compilation environment doesn't
+ provide it.
+ */
+typedef struct _FILE_OBJECTID_BUFFER {
+
+    /**
      The object ID of the file (really a GUID.)
      */
     BYTE  ObjectId[16];
@@ -3066,6 +3510,15 @@ typedef USN_JOURNAL_DATA *PUSN_JOURNAL_DATA;
 
 #endif
 
+#ifndef FSCTL_READ_USN_JOURNAL
+
+/**
+ Specifies the FSCTL_READ_USN_JOURNAL numerical representation if the
+ compilation environment doesn't provide it.
+ */
+#define FSCTL_READ_USN_JOURNAL          CTL_CODE(FILE_DEVICE_FILE_SYSTEM, 46,  METHOD_NEITHER, FILE_ANY_ACCESS)
+#endif
+
 
 #ifndef FSCTL_GET_EXTERNAL_BACKING
 
@@ -3219,6 +3672,46 @@ typedef struct _FILE_PROVIDER_EXTERNAL_INFO {
 
 #ifndef GetFinalPathNameByHandle
 
+/**
+ A structure describing file timestamps and attributes, provided here for
+ when the compilation environment doesn't provide it.
+ */
+typedef struct _FILE_BASIC_INFO {
+
+    /**
+     The time the file was created.  Zero indicates no change when setting.
+     */
+    LARGE_INTEGER CreationTime;
+
+    /**
+     The time the file was last accessed.  Zero indicates no change when
+     setting.
+     */
+    LARGE_INTEGER LastAccessTime;
+
+    /**
+     The time the file was last written.  Zero indicates no change when
+     setting.
+     */
+    LARGE_INTEGER LastWriteTime;
+
+    /**
+     The time the file's metadata last changed.  Zero indicates no change
+     when setting.
+     */
+    LARGE_INTEGER ChangeTime;
+
+    /**
+     The file attributes.  Zero indicates no change when setting.
+     */
+    DWORD FileAttributes;
+} FILE_BASIC_INFO, *PFILE_BASIC_INFO;
+
+/**
+ The identifier of the request type that uses the above structure.
+ */
+#define FileBasicInfo       (0x000000000)
+
 /**
  A structure describing file information, provided here for when the
  compilation environment doesn't provide it.
@@ -3932,9 +4425,9 @@ typedef struct _YORI_JOB_BASIC_ACCOUNTING_INFORMATION {
     LARGE_INTEGER Unused2;
 
     /**
-     Field not needed/supported by YoriLib.
+     The total number of page faults incurred by processes in the job.
      */
-    DWORD Unused3;
+    DWORD TotalPageFaultCount;
 
     /**
      The total number of processes that have been initiated.
@@ -4005,6 +4498,42 @@ typedef struct _YORI_JOB_BASIC_LIMIT_INFORMATION {
     DWORD Unused7;
 } YORI_JOB_BASIC_LIMIT_INFORMATION, *PYORI_JOB_BASIC_LIMIT_INFORMATION;
 
+/**
+ Structure to change extended information about a job.
+ */
+typedef struct _YORI_JOB_EXTENDED_LIMIT_INFORMATION {
+
+    /**
+     Basic information about the job.
+     */
+    YORI_JOB_BASIC_LIMIT_INFORMATION BasicLimitInformation;
+
+    /**
+     The IO performed by all processes in the job.
+     */
+    YORI_IO_COUNTERS IoInfo;
+
+    /**
+     Field not needed/supported by YoriLib.
+     */
+    SIZE_T Unused2;
+
+    /**
+     Field not needed/supported by YoriLib.
+     */
+    SIZE_T Unused3;
+
+    /**
+     The largest amount of memory committed by any process in the job.
+     */
+    SIZE_T PeakProcessMemoryUsed;
+
+    /**
+     The largest amount of memory committed by all processes in the job.
+     */
+    SIZE_T PeakJobMemoryUsed;
+} YORI_JOB_EXTENDED_LIMIT_INFORMATION, *PYORI_JOB_EXTENDED_LIMIT_INFORMATION;
+
 /**
  Information specifying how to associate a job object handle with a completion
  port.
@@ -4023,6 +4552,63 @@ typedef struct _YORI_JOB_ASSOCIATE_COMPLETION_PORT {
     HANDLE Port;
 } YORI_JOB_ASSOCIATE_COMPLETION_PORT, *PYORI_JOB_ASSOCIATE_COMPLETION_PORT;
 
+/**
+ Structure to limit the processor time consumed by processes in a job.
+ */
+typedef struct _YORI_JOB_CPU_RATE_CONTROL_INFORMATION {
+
+    /**
+     Indicates how the processor rate should be controlled.
+     */
+    DWORD ControlFlags;
+
+    /**
+     The portion of processor time that the job can consume, in hundredths
+     of a percent of all processors in the system.
+     */
+    DWORD CpuRate;
+} YORI_JOB_CPU_RATE_CONTROL_INFORMATION, *PYORI_JOB_CPU_RATE_CONTROL_INFORMATION;
+
+#ifndef JOB_OBJECT_CPU_RATE_CONTROL_ENABLE
+/**
+ A definition for JOB_OBJECT_CPU_RATE_CONTROL_ENABLE if it is not defined by
+ the current compilation environment.
+ */
+#define JOB_OBJECT_CPU_RATE_CONTROL_ENABLE 0x1
+#endif
+
+#ifndef JOB_OBJECT_CPU_RATE_CONTROL_HARD_CAP
+/**
+ A definition for JOB_OBJECT_CPU_RATE_CONTROL_HARD_CAP if it is not defined
+ by the current compilation environment.
+ */
+#define JOB_OBJECT_CPU_RATE_CONTROL_HARD_CAP 0x4
+#endif
+
+#ifndef JOB_OBJECT_MSG_NEW_PROCESS
+/**
+ A definition for JOB_OBJECT_MSG_NEW_PROCESS if it is not defined by the
+ current compilation environment.
+ */
+#define JOB_OBJECT_MSG_NEW_PROCESS 6
+#endif
+
+#ifndef JOB_OBJECT_MSG_EXIT_PROCESS
+/**
+ A definition for JOB_OBJECT_MSG_EXIT_PROCESS if it is not defined by the
+ current compilation environment.
+ */
+#define JOB_OBJECT_MSG_EXIT_PROCESS 7
+#endif
+
+#ifndef JOB_OBJECT_MSG_ABNORMAL_EXIT_PROCESS
+/**
+ A definition for JOB_OBJECT_MSG_ABNORMAL_EXIT_PROCESS if it is not defined
+ by the current compilation environment.
+ */
+#define JOB_OBJECT_MSG_ABNORMAL_EXIT_PROCESS 8
+#endif
+
 
 #ifndef SYMBOLIC_LINK_FLAG_DIRECTORY
 /**
@@ -6953,6 +7539,22 @@ typedef struct _RESIZE_VIRTUAL_DISK_PARAMETERS {
 #define HTTP_QUERY_STATUS_CODE (0x13)
 #endif
 
+#ifndef HTTP_QUERY_LAST_MODIFIED
+/**
+ The flag indicating an HTTP query wants the Last-Modified header, if not
+ defined by the current compilation environment.
+ */
+#define HTTP_QUERY_LAST_MODIFIED (0xB)
+#endif
+
+#ifndef HTTP_QUERY_ETAG
+/**
+ The flag indicating an HTTP query wants the ETag header, if not defined by
+ the current compilation environment.
+ */
+#define HTTP_QUERY_ETAG (0x36)
+#endif
+
 /**
  The maximum number of PHY types that can be returned for a single network.
  */
@@ -7315,6 +7917,18 @@ NT_OPEN_SYMBOLIC_LINK_OBJECT(PHANDLE, DWORD, PYORI_OBJECT_ATTRIBUTES);
  */
 typedef NT_OPEN_SYMBOLIC_LINK_OBJECT *PNT_OPEN_SYMBOLIC_LINK_OBJECT;
 
+/**
+ A prototype for the NtQueryDirectoryFile function.
+ */
+typedef
+LONG WINAPI
+NT_QUERY_DIRECTORY_FILE(HANDLE, HANDLE, PVOID, PVOID, PIO_STATUS_BLOCK, PVOID, DWORD, DWORD, BOOLEAN, PYORI_UNICODE_STRING, BOOLEAN);
+
+/**
+ A prototype for a pointer to the NtQueryDirectoryFile function.
+ */
+typedef NT_QUERY_DIRECTORY_FILE *PNT_QUERY_DIRECTORY_FILE;
+
 /**
  A prototype for the NtQueryDirectoryObject function.
  */
@@ -7399,6 +8013,18 @@ NT_QUERY_SYSTEM_INFORMATION(DWORD, PVOID, DWORD, PDWORD);
  */
 typedef NT_QUERY_SYSTEM_INFORMATION *PNT_QUERY_SYSTEM_INFORMATION;
 
+/**
+ A prototype for the NtQuerySystemInformationEx function.
+ */
+typedef
+LONG WINAPI
+NT_QUERY_SYSTEM_INFORMATION_EX(DWORD, PVOID, DWORD, PVOID, DWORD, PDWORD);
+
+/**
+ A prototype for a pointer to the NtQuerySystemInformationEx function.
+ */
+typedef NT_QUERY_SYSTEM_INFORMATION_EX *PNT_QUERY_SYSTEM_INFORMATION_EX;
+
 /**
  A prototype for the NtSetInformationFile function.
  */
@@ -7411,6 +8037,18 @@ NT_SET_INFORMATION_FILE(HANDLE, PIO_STATUS_BLOCK, PVOID, DWORD, DWORD);
  */
 typedef NT_SET_INFORMATION_FILE *PNT_SET_INFORMATION_FILE;
 
+/**
+ A prototype for the NtSetInformationProcess function.
+ */
+typedef
+LONG WINAPI
+NT_SET_INFORMATION_PROCESS(HANDLE, DWORD, PVOID, DWORD);
+
+/**
+ A prototype for a pointer to the NtSetInformationProcess function.
+ */
+typedef NT_SET_INFORMATION_PROCESS *PNT_SET_INFORMATION_PROCESS;
+
 /**
  A prototype for the NtSystemDebugControl function.
  */
@@ -7423,6 +8061,42 @@ NT_SYSTEM_DEBUG_CONTROL(DWORD, PVOID, DWORD, PVOID, DWORD, PDWORD);
  */
 typedef NT_SYSTEM_DEBUG_CONTROL *PNT_SYSTEM_DEBUG_CONTROL;
 
+/**
+ A prototype for the RtlCompressBuffer function.
+ */
+typedef
+LONG WINAPI
+RTL_COMPRESS_BUFFER(WORD, PUCHAR, DWORD, PUCHAR, DWORD, DWORD, PDWORD, PVOID);
+
+/**
+ A prototype for a pointer to the RtlCompressBuffer function.
+ */
+typedef RTL_COMPRESS_BUFFER *PRTL_COMPRESS_BUFFER;
+
+/**
+ A prototype for the RtlDecompressBuffer function.
+ */
+typedef
+LONG WINAPI
+RTL_DECOMPRESS_BUFFER(WORD, PUCHAR, DWORD, PUCHAR, DWORD, PDWORD);
+
+/**
+ A prototype for a pointer to the RtlDecompressBuffer function.
+ */
+typedef RTL_DECOMPRESS_BUFFER *PRTL_DECOMPRESS_BUFFER;
+
+/**
+ A prototype for the RtlGetCompressionWorkSpaceSize function.
+ */
+typedef
+LONG WINAPI
+RTL_GET_COMPRESSION_WORK_SPACE_SIZE(WORD, PDWORD, PDWORD);
+
+/**
+ A prototype for a pointer to the RtlGetCompressionWorkSpaceSize function.
+ */
+typedef RTL_GET_COMPRESSION_WORK_SPACE_SIZE *PRTL_GET_COMPRESSION_WORK_SPACE_SIZE;
+
 /**
  A prototype for the RtlGetLastNtStatus function.
  */
@@ -7458,6 +8132,12 @@ typedef struct _YORI_NTDLL_FUNCTIONS {
      */
     PNT_OPEN_SYMBOLIC_LINK_OBJECT pNtOpenSymbolicLinkObject;
 
+    /**
+     If it's available on the current system, a pointer to
+     NtQueryDirectoryFile.
+     */
+    PNT_QUERY_DIRECTORY_FILE pNtQueryDirectoryFile;
+
     /**
      If it's available on the current system, a pointer to
      NtQueryDirectoryObject.
@@ -7500,18 +8180,48 @@ typedef struct _YORI_NTDLL_FUNCTIONS {
      */
     PNT_QUERY_SYSTEM_INFORMATION pNtQuerySystemInformation;
 
+    /**
+     If it's available on the current system, a pointer to
+     NtQuerySystemInformationEx.
+     */
+    PNT_QUERY_SYSTEM_INFORMATION_EX pNtQuerySystemInformationEx;
+
     /**
      If it's available on the current system, a pointer to
      NtSetInformationFile.
      */
     PNT_SET_INFORMATION_FILE pNtSetInformationFile;
 
+    /**
+     If it's available on the current system, a pointer to
+     NtSetInformationProcess.
+     */
+    PNT_SET_INFORMATION_PROCESS pNtSetInformationProcess;
+
     /**
      If it's available on the current system, a pointer to
      NtSystemDebugControl.
      */
     PNT_SYSTEM_DEBUG_CONTROL pNtSystemDebugControl;
 
+    /**
+     If it's available on the current system, a pointer to
+     RtlCompressBuffer.
+     */
+    PRTL_COMPRESS_BUFFER pRtlCompressBuffer;
+
+    /**
+     If it's available on the current system, a pointer to
+     RtlDecompressBuffer.
+     */
+    PRTL_DECOMPRESS_BUFFER pRtlDecompressBuffer;
+
+    /**
+     If it's available on the current system, a pointer to
+     RtlGetCompressionWorkSpaceSize.
+     */
+    PRTL_GET_COMPRESSION_WORK_SPACE_SIZE pRtlGetCompressionWorkSpaceSize;
+
     /**
      If it's available on the current system, a pointer to
      RtlGetLastNtStatus.
@@ -7585,6 +8295,18 @@ CREATE_HARD_LINKW(LPWSTR, LPWSTR, PVOID);
  */
 typedef CREATE_HARD_LINKW *PCREATE_HARD_LINKW;
 
+/**
+ A prototype for the CreateIoCompletionPort function.
+ */
+typedef
+HANDLE WINAPI
+CREATE_IO_COMPLETION_PORT(HANDLE, HANDLE, ULONG_PTR, DWORD);
+
+/**
+ A prototype for a pointer to the CreateIoCompletionPort function.
+ */
+typedef CREATE_IO_COMPLETION_PORT *PCREATE_IO_COMPLETION_PORT;
+
 /**
  A prototype for the CreateJobObjectW function.
  */
@@ -7957,6 +8679,18 @@ GET_PRODUCT_INFO(DWORD, DWORD, DWORD, DWORD, PDWORD);
  */
 typedef GET_PRODUCT_INFO *PGET_PRODUCT_INFO;
 
+/**
+ A prototype for the GetQueuedCompletionStatus function.
+ */
+typedef
+BOOL WINAPI
+GET_QUEUED_COMPLETION_STATUS(HANDLE, LPDWORD, ULONG_PTR *, LPOVERLAPPED *, DWORD);
+
+/**
+ A prototype for a pointer to the GetQueuedCompletionStatus function.
+ */
+typedef GET_QUEUED_COMPLETION_STATUS *PGET_QUEUED_COMPLETION_STATUS;
+
 /**
  A prototype for the GetSystemPowerStatus function.
  */
@@ -8150,81 +8884,180 @@ OPEN_THREAD(DWORD, BOOL, DWORD);
 typedef OPEN_THREAD *POPEN_THREAD;
 
 /**
- A prototype for the QueryFullProcessImageNameW function.
+ Capture a clone of the process address space rather than reading from the
+ live process.
  */
-typedef
-BOOL WINAPI
-QUERY_FULL_PROCESS_IMAGE_NAMEW(HANDLE, DWORD, LPTSTR, PDWORD);
+#define YORI_PSS_CAPTURE_VA_CLONE                      0x00000001
 
 /**
- A prototype for a pointer to the the QueryFullProcessImageNameW function.
+ Capture the handles opened by the process.
  */
-typedef QUERY_FULL_PROCESS_IMAGE_NAMEW *PQUERY_FULL_PROCESS_IMAGE_NAMEW;
+#define YORI_PSS_CAPTURE_HANDLES                       0x00000004
 
 /**
- A prototype for the QueryInformationJobObject function.
+ Capture the names of handles opened by the process.
  */
-typedef
-BOOL WINAPI
-QUERY_INFORMATION_JOB_OBJECT(HANDLE, DWORD, PVOID, DWORD, LPDWORD);
+#define YORI_PSS_CAPTURE_HANDLE_NAME_INFORMATION       0x00000008
 
 /**
- A prototype for a pointer to the QueryInformationJobObject function.
+ Capture basic information about handles opened by the process.
  */
-typedef QUERY_INFORMATION_JOB_OBJECT *PQUERY_INFORMATION_JOB_OBJECT;
+#define YORI_PSS_CAPTURE_HANDLE_BASIC_INFORMATION      0x00000010
 
 /**
- A prototype for the RegisterApplicationRestart function.
+ Capture type specific information about handles opened by the process.
  */
-typedef
-LONG WINAPI
-REGISTER_APPLICATION_RESTART(LPCWSTR, DWORD);
+#define YORI_PSS_CAPTURE_HANDLE_TYPE_SPECIFIC_INFORMATION 0x00000020
 
 /**
- A prototype for a pointer to the RegisterApplicationRestart function.
+ Capture the handle trace for the process.
  */
-typedef REGISTER_APPLICATION_RESTART *PREGISTER_APPLICATION_RESTART;
+#define YORI_PSS_CAPTURE_HANDLE_TRACE                  0x00000040
 
 /**
- A prototype for the ReplaceFileW function.
+ Capture the threads in the process.
  */
-typedef
-BOOL WINAPI
-REPLACE_FILEW(LPCWSTR, LPCWSTR, LPCWSTR, DWORD, LPVOID, LPVOID);
+#define YORI_PSS_CAPTURE_THREADS                       0x00000080
 
 /**
- A prototype for a pointer to the ReplaceFileW function.
+ Capture the register context of threads in the process.
  */
-typedef REPLACE_FILEW *PREPLACE_FILEW;
+#define YORI_PSS_CAPTURE_THREAD_CONTEXT                0x00000100
 
 /**
- A prototype for the RtlCaptureStackBackTrace function.
+ Capture the extended register context of threads in the process.
  */
-typedef
-WORD WINAPI
-RTL_CAPTURE_STACK_BACK_TRACE(DWORD, DWORD, PVOID *, PDWORD);
+#define YORI_PSS_CAPTURE_THREAD_CONTEXT_EXTENDED       0x00000200
 
 /**
- A prototype for a pointer to the RtlCaptureStackBackTrace function.
+ Allow the clone process to be created outside of any job if the job does
+ not allow breakaway.
  */
-typedef RTL_CAPTURE_STACK_BACK_TRACE *PRTL_CAPTURE_STACK_BACK_TRACE;
+#define YORI_PSS_CREATE_BREAKAWAY_OPTIONAL             0x04000000
 
 /**
- A prototype for the SetConsoleDisplayMode function.
+ Create the clone process outside of any job containing the process.
  */
-typedef
-BOOL WINAPI
-SET_CONSOLE_DISPLAY_MODE(HANDLE, DWORD, PCOORD);
+#define YORI_PSS_CREATE_BREAKAWAY                      0x08000000
 
 /**
- A prototype for a pointer to the the SetConsoleDisplayMode function.
+ Allocate the snapshot's internal buffers with virtual memory.
  */
-typedef SET_CONSOLE_DISPLAY_MODE *PSET_CONSOLE_DISPLAY_MODE;
+#define YORI_PSS_CREATE_USE_VM_ALLOCATIONS             0x20000000
 
 /**
- A prototype for the SetConsoleScreenBufferEx function.
+ Release the section used to clone the address space as soon as possible.
  */
-typedef
+#define YORI_PSS_CREATE_RELEASE_SECTION                0x80000000
+
+#ifndef CONTEXT_ALL
+/**
+ Definition for capturing all thread register state for compilers that don't
+ contain it.  Older compilers can only describe the full context.
+ */
+#define CONTEXT_ALL CONTEXT_FULL
+#endif
+
+/**
+ A prototype for the PssCaptureSnapshot function.
+ */
+typedef
+DWORD WINAPI
+PSS_CAPTURE_SNAPSHOT(HANDLE, DWORD, DWORD, HANDLE *);
+
+/**
+ A prototype for a pointer to the PssCaptureSnapshot function.
+ */
+typedef PSS_CAPTURE_SNAPSHOT *PPSS_CAPTURE_SNAPSHOT;
+
+/**
+ A prototype for the PssFreeSnapshot function.
+ */
+typedef
+DWORD WINAPI
+PSS_FREE_SNAPSHOT(HANDLE, HANDLE);
+
+/**
+ A prototype for a pointer to the PssFreeSnapshot function.
+ */
+typedef PSS_FREE_SNAPSHOT *PPSS_FREE_SNAPSHOT;
+
+/**
+ A prototype for the QueryFullProcessImageNameW function.
+ */
+typedef
+BOOL WINAPI
+QUERY_FULL_PROCESS_IMAGE_NAMEW(HANDLE, DWORD, LPTSTR, PDWORD);
+
+/**
+ A prototype for a pointer to the the QueryFullProcessImageNameW function.
+ */
+typedef QUERY_FULL_PROCESS_IMAGE_NAMEW *PQUERY_FULL_PROCESS_IMAGE_NAMEW;
+
+/**
+ A prototype for the QueryInformationJobObject function.
+ */
+typedef
+BOOL WINAPI
+QUERY_INFORMATION_JOB_OBJECT(HANDLE, DWORD, PVOID, DWORD, LPDWORD);
+
+/**
+ A prototype for a pointer to the QueryInformationJobObject function.
+ */
+typedef QUERY_INFORMATION_JOB_OBJECT *PQUERY_INFORMATION_JOB_OBJECT;
+
+/**
+ A prototype for the RegisterApplicationRestart function.
+ */
+typedef
+LONG WINAPI
+REGISTER_APPLICATION_RESTART(LPCWSTR, DWORD);
+
+/**
+ A prototype for a pointer to the RegisterApplicationRestart function.
+ */
+typedef REGISTER_APPLICATION_RESTART *PREGISTER_APPLICATION_RESTART;
+
+/**
+ A prototype for the ReplaceFileW function.
+ */
+typedef
+BOOL WINAPI
+REPLACE_FILEW(LPCWSTR, LPCWSTR, LPCWSTR, DWORD, LPVOID, LPVOID);
+
+/**
+ A prototype for a pointer to the ReplaceFileW function.
+ */
+typedef REPLACE_FILEW *PREPLACE_FILEW;
+
+/**
+ A prototype for the RtlCaptureStackBackTrace function.
+ */
+typedef
+WORD WINAPI
+RTL_CAPTURE_STACK_BACK_TRACE(DWORD, DWORD, PVOID *, PDWORD);
+
+/**
+ A prototype for a pointer to the RtlCaptureStackBackTrace function.
+ */
+typedef RTL_CAPTURE_STACK_BACK_TRACE *PRTL_CAPTURE_STACK_BACK_TRACE;
+
+/**
+ A prototype for the SetConsoleDisplayMode function.
+ */
+typedef
+BOOL WINAPI
+SET_CONSOLE_DISPLAY_MODE(HANDLE, DWORD, PCOORD);
+
+/**
+ A prototype for a pointer to the the SetConsoleDisplayMode function.
+ */
+typedef SET_CONSOLE_DISPLAY_MODE *PSET_CONSOLE_DISPLAY_MODE;
+
+/**
+ A prototype for the SetConsoleScreenBufferEx function.
+ */
+typedef
 BOOL WINAPI
 SET_CONSOLE_SCREEN_BUFFER_INFO_EX(HANDLE, PYORI_CONSOLE_SCREEN_BUFFER_INFOEX);
 
@@ -8293,6 +9126,18 @@ SET_SYSTEM_POWER_STATE(BOOL, BOOL);
  */
 typedef SET_SYSTEM_POWER_STATE *PSET_SYSTEM_POWER_STATE;
 
+/**
+ A prototype for the SetThreadGroupAffinity function.
+ */
+typedef
+BOOL WINAPI
+SET_THREAD_GROUP_AFFINITY(HANDLE, PYORI_PROCESSOR_GROUP_AFFINITY, PYORI_PROCESSOR_GROUP_AFFINITY);
+
+/**
+ A prototype for a pointer to the SetThreadGroupAffinity function.
+ */
+typedef SET_THREAD_GROUP_AFFINITY *PSET_THREAD_GROUP_AFFINITY;
+
 /**
  A prototype for the WritePrivateProfileStringW function.
  */
@@ -8387,6 +9232,12 @@ typedef struct _YORI_KERNEL32_FUNCTIONS {
      */
     PCREATE_HARD_LINKW pCreateHardLinkW;
 
+    /**
+     If it's available on the current system, a pointer to
+     CreateIoCompletionPort.
+     */
+    PCREATE_IO_COMPLETION_PORT pCreateIoCompletionPort;
+
     /**
      If it's available on the current system, a pointer to CreateJobObjectW.
      */
@@ -8542,6 +9393,12 @@ typedef struct _YORI_KERNEL32_FUNCTIONS {
      */
     PGET_PRODUCT_INFO pGetProductInfo;
 
+    /**
+     If it's available on the current system, a pointer to
+     GetQueuedCompletionStatus.
+     */
+    PGET_QUEUED_COMPLETION_STATUS pGetQueuedCompletionStatus;
+
     /**
      If it's available on the current system, a pointer to GetSystemPowerStatus.
      */
@@ -8622,88 +9479,866 @@ typedef struct _YORI_KERNEL32_FUNCTIONS {
      */
     POPEN_THREAD pOpenThread;
 
+    /**
+     If it's available on the current system, a pointer to PssCaptureSnapshot.
+     */
+    PPSS_CAPTURE_SNAPSHOT pPssCaptureSnapshot;
+
+    /**
+     If it's available on the current system, a pointer to PssFreeSnapshot.
+     */
+    PPSS_FREE_SNAPSHOT pPssFreeSnapshot;
+
     /**
      If it's available on the current system, a pointer to QueryFullProcessImageNameW.
      */
     PQUERY_FULL_PROCESS_IMAGE_NAMEW pQueryFullProcessImageNameW;
 
     /**
-     If it's available on the current system, a pointer to QueryInformationJobObject.
+     If it's available on the current system, a pointer to QueryInformationJobObject.
+     */
+    PQUERY_INFORMATION_JOB_OBJECT pQueryInformationJobObject;
+
+    /**
+     If it's available on the current system, a pointer to RegisterApplicationRestart.
+     */
+    PREGISTER_APPLICATION_RESTART pRegisterApplicationRestart;
+
+    /**
+     If it's available on the current system, a pointer to ReplaceFileW.
+     */
+    PREPLACE_FILEW pReplaceFileW;
+
+    /**
+     If it's available on the current system, a pointer to RtlCaptureStackBackTrace.
+     */
+    PRTL_CAPTURE_STACK_BACK_TRACE pRtlCaptureStackBackTrace;
+
+    /**
+     If it's available on the current system, a pointer to SetConsoleDisplayMode.
+     */
+    PSET_CONSOLE_DISPLAY_MODE pSetConsoleDisplayMode;
+
+    /**
+     If it's available on the current system, a pointer to SetConsoleScreenBufferInfoEx.
+     */
+    PSET_CONSOLE_SCREEN_BUFFER_INFO_EX pSetConsoleScreenBufferInfoEx;
+
+    /**
+     If it's available on the current system, a pointer to SetConsoleScreenBufferSize.
+     */
+    PSET_CONSOLE_SCREEN_BUFFER_SIZE pSetConsoleScreenBufferSize;
+
+    /**
+     If it's available on the current system, a pointer to SetCurrentConsoleFontEx.
+     */
+    PSET_CURRENT_CONSOLE_FONT_EX pSetCurrentConsoleFontEx;
+
+    /**
+     If it's available on the current system, a pointer to SetFileInformationByHandle.
+     */
+    PSET_FILE_INFORMATION_BY_HANDLE pSetFileInformationByHandle;
+
+    /**
+     If it's available on the current system, a pointer to SetInformationJobObject.
+     */
+    PSET_INFORMATION_JOB_OBJECT pSetInformationJobObject;
+
+    /**
+     If it's available on the current system, a pointer to GetSystemPowerState.
+     */
+    PSET_SYSTEM_POWER_STATE pSetSystemPowerState;
+
+    /**
+     If it's available on the current system, a pointer to SetThreadGroupAffinity.
+     */
+    PSET_THREAD_GROUP_AFFINITY pSetThreadGroupAffinity;
+
+    /**
+     If it's available on the current system, a pointer to WritePrivateProfileStringW.
+     */
+    PWRITE_PRIVATE_PROFILE_STRINGW pWritePrivateProfileStringW;
+
+    /**
+     If it's available on the current system, a pointer to Wow64DisableWow64FsRedirection.
+     */
+    PWOW64_DISABLE_WOW64_FS_REDIRECTION pWow64DisableWow64FsRedirection;
+
+    /**
+     If it's available on the current system, a pointer to Wow64GetThreadContext.
+     */
+    PWOW64_GET_THREAD_CONTEXT pWow64GetThreadContext;
+
+    /**
+     If it's available on the current system, a pointer to Wow64SetThreadContext.
+     */
+    PWOW64_SET_THREAD_CONTEXT pWow64SetThreadContext;
+} YORI_KERNEL32_FUNCTIONS, *PYORI_KERNEL32_FUNCTIONS;
+
+extern YORI_KERNEL32_FUNCTIONS DllKernel32;
+
+/**
+ A handle to an event tracing session or to a consumer of one.
+ */
+typedef DWORDLONG YORI_TRACEHANDLE;
+
+/**
+ A pointer to a handle to an event tracing session or to a consumer of one.
+ */
+typedef YORI_TRACEHANDLE *PYORI_TRACEHANDLE;
+
+/**
+ The value returned from OpenTrace on failure.
+ */
+#define YORI_INVALID_PROCESSTRACE_HANDLE ((YORI_TRACEHANDLE)INVALID_HANDLE_VALUE)
+
+/**
+ The name of the session that receives events from the kernel.
+ */
+#define YORI_KERNEL_LOGGER_NAME _T("NT Kernel Logger")
+
+/**
+ Indicates that a WNODE_HEADER describes an event tracing session.
+ */
+#define YORI_WNODE_FLAG_TRACED_GUID           0x00020000
+
+/**
+ Indicates that a session delivers events to a consumer as they occur rather
+ than to a file.
+ */
+#define YORI_EVENT_TRACE_REAL_TIME_MODE       0x00000100
+
+/**
+ The control code to stop an event tracing session.
+ */
+#define YORI_EVENT_TRACE_CONTROL_STOP         1
+
+/**
+ Enable kernel events for process creation and termination.
+ */
+#define YORI_EVENT_TRACE_FLAG_PROCESS         0x00000001
+
+/**
+ Enable kernel events for image loads.
+ */
+#define YORI_EVENT_TRACE_FLAG_IMAGE_LOAD      0x00000004
+
+/**
+ Enable kernel events for file I/O completion.
+ */
+#define YORI_EVENT_TRACE_FLAG_FILE_IO         0x02000000
+
+/**
+ Enable kernel events for file I/O initiation.
+ */
+#define YORI_EVENT_TRACE_FLAG_FILE_IO_INIT    0x04000000
+
+/**
+ Indicates that a consumer should receive events from a session as they
+ occur.
+ */
+#define YORI_PROCESS_TRACE_MODE_REAL_TIME     0x00000100
+
+/**
+ Indicates that a consumer should receive events as EVENT_RECORD structures.
+ */
+#define YORI_PROCESS_TRACE_MODE_EVENT_RECORD  0x10000000
+
+/**
+ Indicates that pointers within an event are 32 bit.
+ */
+#define YORI_EVENT_HEADER_FLAG_32_BIT_HEADER  0x0020
+
+/**
+ Indicates that pointers within an event are 64 bit.
+ */
+#define YORI_EVENT_HEADER_FLAG_64_BIT_HEADER  0x0040
+
+/**
+ The header common to WMI structures, used to describe an event tracing
+ session.
+ */
+typedef struct _YORI_WNODE_HEADER {
+
+    /**
+     The size of the structure and any data following it, in bytes.
+     */
+    ULONG BufferSize;
+
+    /**
+     Reserved for use by the system.
+     */
+    ULONG ProviderId;
+
+    /**
+     On output, the handle to the session.
+     */
+    ULONG64 HistoricalContext;
+
+    /**
+     Reserved for use by the system.
+     */
+    LARGE_INTEGER TimeStamp;
+
+    /**
+     The provider or session being described.
+     */
+    GUID Guid;
+
+    /**
+     The clock resolution to use for timestamps in the session.
+     */
+    ULONG ClientContext;
+
+    /**
+     Flags, including YORI_WNODE_FLAG_TRACED_GUID.
+     */
+    ULONG Flags;
+} YORI_WNODE_HEADER, *PYORI_WNODE_HEADER;
+
+/**
+ Information describing an event tracing session.
+ */
+typedef struct _YORI_EVENT_TRACE_PROPERTIES {
+
+    /**
+     The common WMI header.
+     */
+    YORI_WNODE_HEADER Wnode;
+
+    /**
+     The size of each buffer, in kilobytes.
+     */
+    ULONG BufferSize;
+
+    /**
+     The minimum number of buffers to allocate.
+     */
+    ULONG MinimumBuffers;
+
+    /**
+     The maximum number of buffers to allocate.
+     */
+    ULONG MaximumBuffers;
+
+    /**
+     The maximum size of a log file, in megabytes.
+     */
+    ULONG MaximumFileSize;
+
+    /**
+     The mode of the session, such as YORI_EVENT_TRACE_REAL_TIME_MODE.
+     */
+    ULONG LogFileMode;
+
+    /**
+     How often buffers are flushed to consumers, in seconds.
+     */
+    ULONG FlushTimer;
+
+    /**
+     For the kernel session, the set of kernel events to enable.
+     */
+    ULONG EnableFlags;
+
+    /**
+     Not used.
+     */
+    LONG AgeLimit;
+
+    /**
+     On output, the number of buffers allocated.
+     */
+    ULONG NumberOfBuffers;
+
+    /**
+     On output, the number of buffers that are free.
+     */
+    ULONG FreeBuffers;
+
+    /**
+     On output, the number of events that could not be recorded.
+     */
+    ULONG EventsLost;
+
+    /**
+     On output, the number of buffers written.
+     */
+    ULONG BuffersWritten;
+
+    /**
+     On output, the number of buffers that could not be written to a file.
+     */
+    ULONG LogBuffersLost;
+
+    /**
+     On output, the number of buffers that could not be delivered to a
+     consumer.
+     */
+    ULONG RealTimeBuffersLost;
+
+    /**
+     On output, the thread that is logging events.
+     */
+    HANDLE LoggerThreadId;
+
+    /**
+     The offset from the beginning of this structure to the log file name.
+     */
+    ULONG LogFileNameOffset;
+
+    /**
+     The offset from the beginning of this structure to the session name.
+     */
+    ULONG LoggerNameOffset;
+} YORI_EVENT_TRACE_PROPERTIES, *PYORI_EVENT_TRACE_PROPERTIES;
+
+/**
+ The header of an event in the form used by older event consumers.
+ */
+typedef struct _YORI_EVENT_TRACE_HEADER {
+
+    /**
+     The size of the event, in bytes.
+     */
+    USHORT Size;
+
+    /**
+     Reserved for use by the system.
+     */
+    USHORT FieldTypeFlags;
+
+    /**
+     The type, level and version of the event.
+     */
+    ULONG Version;
+
+    /**
+     The thread that generated the event.
+     */
+    ULONG ThreadId;
+
+    /**
+     The process that generated the event.
+     */
+    ULONG ProcessId;
+
+    /**
+     The time the event occurred.
+     */
+    LARGE_INTEGER TimeStamp;
+
+    /**
+     The class of the event.
+     */
+    GUID Guid;
+
+    /**
+     The processor time used by the thread that generated the event.
+     */
+    ULONG64 ProcessorTime;
+} YORI_EVENT_TRACE_HEADER, *PYORI_EVENT_TRACE_HEADER;
+
+/**
+ An event in the form used by older event consumers.
+ */
+typedef struct _YORI_EVENT_TRACE {
+
+    /**
+     The header of the event.
+     */
+    YORI_EVENT_TRACE_HEADER Header;
+
+    /**
+     Reserved for use by the system.
+     */
+    ULONG InstanceId;
+
+    /**
+     Reserved for use by the system.
+     */
+    ULONG ParentInstanceId;
+
+    /**
+     Reserved for use by the system.
+     */
+    GUID ParentGuid;
+
+    /**
+     The data associated with the event.
+     */
+    PVOID MofData;
+
+    /**
+     The number of bytes in MofData.
+     */
+    ULONG MofLength;
+
+    /**
+     The processor and session that generated the event.
+     */
+    ULONG BufferContext;
+} YORI_EVENT_TRACE, *PYORI_EVENT_TRACE;
+
+/**
+ Information describing the session that a consumer is receiving events
+ from.
+ */
+typedef struct _YORI_TRACE_LOGFILE_HEADER {
+
+    /**
+     The size of each buffer, in bytes.
+     */
+    ULONG BufferSize;
+
+    /**
+     The version of the operating system that generated the events.
+     */
+    ULONG Version;
+
+    /**
+     The build number of the operating system that generated the events.
+     */
+    ULONG ProviderVersion;
+
+    /**
+     The number of processors on the system that generated the events.
+     */
+    ULONG NumberOfProcessors;
+
+    /**
+     The time the session stopped.
+     */
+    LARGE_INTEGER EndTime;
+
+    /**
+     The resolution of the timer, in 100ns units.
+     */
+    ULONG TimerResolution;
+
+    /**
+     The maximum size of the log file, in megabytes.
+     */
+    ULONG MaximumFileSize;
+
+    /**
+     The mode of the session.
+     */
+    ULONG LogFileMode;
+
+    /**
+     The number of buffers written.
+     */
+    ULONG BuffersWritten;
+
+    /**
+     Information about the session, including the size of pointers and
+     the number of events lost.
+     */
+    GUID LogInstanceGuid;
+
+    /**
+     Not used.
+     */
+    LPWSTR LoggerName;
+
+    /**
+     Not used.
+     */
+    LPWSTR LogFileName;
+
+    /**
+     The time zone of the system that generated the events.
+     */
+    TIME_ZONE_INFORMATION TimeZone;
+
+    /**
+     The time the system that generated the events was started.
+     */
+    LARGE_INTEGER BootTime;
+
+    /**
+     The frequency of the high resolution performance counter.
+     */
+    LARGE_INTEGER PerfFreq;
+
+    /**
+     The time the session started.
+     */
+    LARGE_INTEGER StartTime;
+
+    /**
+     The clock resolution used for timestamps.
+     */
+    ULONG ReservedFlags;
+
+    /**
+     The number of buffers lost.
+     */
+    ULONG BuffersLost;
+} YORI_TRACE_LOGFILE_HEADER, *PYORI_TRACE_LOGFILE_HEADER;
+
+/**
+ Information describing the type of an event.
+ */
+typedef struct _YORI_EVENT_DESCRIPTOR {
+
+    /**
+     The identifier of the event.
+     */
+    USHORT Id;
+
+    /**
+     The version of the event, which describes the layout of its data.
+     */
+    UCHAR Version;
+
+    /**
+     The channel the event was logged to.
+     */
+    UCHAR Channel;
+
+    /**
+     The severity of the event.
+     */
+    UCHAR Level;
+
+    /**
+     The operation the event describes.  For kernel events, this indicates
+     the type of the event within its class.
+     */
+    UCHAR Opcode;
+
+    /**
+     The task the event describes.
+     */
+    USHORT Task;
+
+    /**
+     The set of keywords associated with the event.
+     */
+    ULONGLONG Keyword;
+} YORI_EVENT_DESCRIPTOR, *PYORI_EVENT_DESCRIPTOR;
+
+/**
+ The header of an event.
+ */
+typedef struct _YORI_EVENT_HEADER {
+
+    /**
+     The size of the event record, in bytes.
+     */
+    USHORT Size;
+
+    /**
+     Reserved for use by the system.
+     */
+    USHORT HeaderType;
+
+    /**
+     Flags describing the event, including the size of pointers in its data.
+     */
+    USHORT Flags;
+
+    /**
+     Flags describing the data of the event.
+     */
+    USHORT EventProperty;
+
+    /**
+     The thread that generated the event.
+     */
+    ULONG ThreadId;
+
+    /**
+     The process that generated the event.
+     */
+    ULONG ProcessId;
+
+    /**
+     The time the event occurred.  Unless the consumer requested raw
+     timestamps, this is in system time format.
+     */
+    LARGE_INTEGER TimeStamp;
+
+    /**
+     The provider of the event.  For kernel events, this is the class of the
+     event.
+     */
+    GUID ProviderId;
+
+    /**
+     The type of the event.
+     */
+    YORI_EVENT_DESCRIPTOR EventDescriptor;
+
+    /**
+     The processor time used by the thread that generated the event.
+     */
+    ULONG64 ProcessorTime;
+
+    /**
+     The activity that the event is associated with.
+     */
+    GUID ActivityId;
+} YORI_EVENT_HEADER, *PYORI_EVENT_HEADER;
+
+/**
+ An event delivered to a consumer.
+ */
+typedef struct _YORI_EVENT_RECORD {
+
+    /**
+     The header of the event.
+     */
+    YORI_EVENT_HEADER EventHeader;
+
+    /**
+     The processor that generated the event.
+     */
+    USHORT ProcessorIndex;
+
+    /**
+     The session that generated the event.
+     */
+    USHORT LoggerId;
+
+    /**
+     The number of extended data items.
+     */
+    USHORT ExtendedDataCount;
+
+    /**
+     The number of bytes in UserData.
+     */
+    USHORT UserDataLength;
+
+    /**
+     Extended data items associated with the event.
+     */
+    PVOID ExtendedData;
+
+    /**
+     The data associated with the event.
+     */
+    PVOID UserData;
+
+    /**
+     The context specified by the consumer when opening the session.
+     */
+    PVOID UserContext;
+} YORI_EVENT_RECORD, *PYORI_EVENT_RECORD;
+
+/**
+ A prototype for a function invoked for each event delivered to a consumer.
+ */
+typedef
+VOID WINAPI
+YORI_EVENT_RECORD_CALLBACK(PYORI_EVENT_RECORD);
+
+/**
+ A pointer to a function invoked for each event delivered to a consumer.
+ */
+typedef YORI_EVENT_RECORD_CALLBACK *PYORI_EVENT_RECORD_CALLBACK;
+
+/**
+ Information describing how a consumer receives events from a session.
+ */
+typedef struct _YORI_EVENT_TRACE_LOGFILEW {
+
+    /**
+     The log file to read events from, or NULL for a real time session.
+     */
+    LPWSTR LogFileName;
+
+    /**
+     The real time session to receive events from.
+     */
+    LPWSTR LoggerName;
+
+    /**
+     On output, the time of the most recent event.
+     */
+    LONGLONG CurrentTime;
+
+    /**
+     On output, the number of buffers processed.
+     */
+    ULONG BuffersRead;
+
+    /**
+     The mode of the consumer, such as YORI_PROCESS_TRACE_MODE_REAL_TIME.
+     */
+    ULONG ProcessTraceMode;
+
+    /**
+     On output, the most recent event in its older form.
+     */
+    YORI_EVENT_TRACE CurrentEvent;
+
+    /**
+     On output, information about the session.
+     */
+    YORI_TRACE_LOGFILE_HEADER LogfileHeader;
+
+    /**
+     A function invoked after each buffer is processed.
+     */
+    PVOID BufferCallback;
+
+    /**
+     On output, the size of each buffer, in bytes.
+     */
+    ULONG BufferSize;
+
+    /**
+     On output, the number of bytes in the buffer being processed.
+     */
+    ULONG Filled;
+
+    /**
+     Not used.
+     */
+    ULONG EventsLost;
+
+    /**
+     The function to invoke for each event.
      */
-    PQUERY_INFORMATION_JOB_OBJECT pQueryInformationJobObject;
+    PYORI_EVENT_RECORD_CALLBACK EventRecordCallback;
 
     /**
-     If it's available on the current system, a pointer to RegisterApplicationRestart.
+     On output, nonzero if the session is receiving kernel events.
      */
-    PREGISTER_APPLICATION_RESTART pRegisterApplicationRestart;
+    ULONG IsKernelTrace;
 
     /**
-     If it's available on the current system, a pointer to ReplaceFileW.
+     A context to pass to the event callback in the UserContext field.
      */
-    PREPLACE_FILEW pReplaceFileW;
+    PVOID Context;
+} YORI_EVENT_TRACE_LOGFILEW, *PYORI_EVENT_TRACE_LOGFILEW;
+
+/**
+ A handle to a registered event provider.
+ */
+typedef DWORDLONG YORI_REGHANDLE;
+
+/**
+ A pointer to a handle to a registered event provider.
+ */
+typedef YORI_REGHANDLE *PYORI_REGHANDLE;
+
+/**
+ The channel used by events whose metadata is contained within the event,
+ known as TraceLogging events.
+ */
+#define YORI_WINEVENT_CHANNEL_TRACELOGGING    11
+
+/**
+ The level of an informational event.
+ */
+#define YORI_WINEVENT_LEVEL_INFO              4
+
+/**
+ Indicates that an event data descriptor contains provider metadata.
+ */
+#define YORI_EVENT_DATA_DESCRIPTOR_TYPE_PROVIDER_METADATA 2
+
+/**
+ Indicates that an event data descriptor contains event metadata.
+ */
+#define YORI_EVENT_DATA_DESCRIPTOR_TYPE_EVENT_METADATA 1
+
+/**
+ The information class to set provider traits with EventSetInformation.
+ */
+#define YORI_EVENT_PROVIDER_SET_TRAITS        2
+
+/**
+ Describes an event written by an event provider.
+ */
+typedef struct _YORI_EVENT_DESCRIPTOR {
 
     /**
-     If it's available on the current system, a pointer to RtlCaptureStackBackTrace.
+     The identifier of the event.
      */
-    PRTL_CAPTURE_STACK_BACK_TRACE pRtlCaptureStackBackTrace;
+    USHORT Id;
 
     /**
-     If it's available on the current system, a pointer to SetConsoleDisplayMode.
+     The version of the event.
      */
-    PSET_CONSOLE_DISPLAY_MODE pSetConsoleDisplayMode;
+    UCHAR Version;
 
     /**
-     If it's available on the current system, a pointer to SetConsoleScreenBufferInfoEx.
+     The channel of the event.
      */
-    PSET_CONSOLE_SCREEN_BUFFER_INFO_EX pSetConsoleScreenBufferInfoEx;
+    UCHAR Channel;
 
     /**
-     If it's available on the current system, a pointer to SetConsoleScreenBufferSize.
+     The level of the event.
      */
-    PSET_CONSOLE_SCREEN_BUFFER_SIZE pSetConsoleScreenBufferSize;
+    UCHAR Level;
 
     /**
-     If it's available on the current system, a pointer to SetCurrentConsoleFontEx.
+     The opcode of the event.
      */
-    PSET_CURRENT_CONSOLE_FONT_EX pSetCurrentConsoleFontEx;
+    UCHAR Opcode;
 
     /**
-     If it's available on the current system, a pointer to SetFileInformationByHandle.
+     The task of the event.
      */
-    PSET_FILE_INFORMATION_BY_HANDLE pSetFileInformationByHandle;
+    USHORT Task;
 
     /**
-     If it's available on the current system, a pointer to SetInformationJobObject.
+     The keywords of the event, used by sessions to select events.
      */
-    PSET_INFORMATION_JOB_OBJECT pSetInformationJobObject;
+    DWORDLONG Keyword;
+} YORI_EVENT_DESCRIPTOR, *PYORI_EVENT_DESCRIPTOR;
+
+/**
+ Describes a block of data included in an event.
+ */
+typedef struct _YORI_EVENT_DATA_DESCRIPTOR {
 
     /**
-     If it's available on the current system, a pointer to GetSystemPowerState.
+     Pointer to the data, extended to 64 bits.
      */
-    PSET_SYSTEM_POWER_STATE pSetSystemPowerState;
+    DWORDLONG Ptr;
 
     /**
-     If it's available on the current system, a pointer to WritePrivateProfileStringW.
+     The size of the data, in bytes.
      */
-    PWRITE_PRIVATE_PROFILE_STRINGW pWritePrivateProfileStringW;
+    ULONG Size;
 
     /**
-     If it's available on the current system, a pointer to Wow64DisableWow64FsRedirection.
+     The type of the data, such as
+     YORI_EVENT_DATA_DESCRIPTOR_TYPE_EVENT_METADATA, or zero for event data.
      */
-    PWOW64_DISABLE_WOW64_FS_REDIRECTION pWow64DisableWow64FsRedirection;
+    UCHAR Type;
 
     /**
-     If it's available on the current system, a pointer to Wow64GetThreadContext.
+     Reserved.
      */
-    PWOW64_GET_THREAD_CONTEXT pWow64GetThreadContext;
+    UCHAR Reserved1;
 
     /**
-     If it's available on the current system, a pointer to Wow64SetThreadContext.
+     Reserved.
      */
-    PWOW64_SET_THREAD_CONTEXT pWow64SetThreadContext;
-} YORI_KERNEL32_FUNCTIONS, *PYORI_KERNEL32_FUNCTIONS;
+    USHORT Reserved2;
+} YORI_EVENT_DATA_DESCRIPTOR, *PYORI_EVENT_DATA_DESCRIPTOR;
 
-extern YORI_KERNEL32_FUNCTIONS DllKernel32;
+/**
+ A prototype for a function called when a session enables or disables an
+ event provider.
+ */
+typedef
+VOID WINAPI
+YORI_ETW_ENABLE_CALLBACK(CONST GUID *, ULONG, UCHAR, DWORDLONG, DWORDLONG, PVOID, PVOID);
+
+/**
+ A prototype for a pointer to a function called when a session enables or
+ disables an event provider.
+ */
+typedef YORI_ETW_ENABLE_CALLBACK *PYORI_ETW_ENABLE_CALLBACK;
 
 /**
  A prototype for the AccessCheck function.
@@ -8753,6 +10388,18 @@ ALLOCATE_AND_INITIALIZE_SID(PSID_IDENTIFIER_AUTHORITY, BYTE, DWORD, DWORD, DWORD
  */
 typedef ALLOCATE_AND_INITIALIZE_SID *PALLOCATE_AND_INITIALIZE_SID;
 
+/**
+ A prototype for the CloseTrace function.
+ */
+typedef
+ULONG WINAPI
+CLOSE_TRACE(YORI_TRACEHANDLE);
+
+/**
+ A prototype for a pointer to the CloseTrace function.
+ */
+typedef CLOSE_TRACE *PCLOSE_TRACE;
+
 /**
  Prototype for the CommandLineFromMsiDescriptor function.
  */
@@ -8765,6 +10412,18 @@ COMMAND_LINE_FROM_MSI_DESCRIPTOR(LPWSTR, LPWSTR, PDWORD);
  */
 typedef COMMAND_LINE_FROM_MSI_DESCRIPTOR *PCOMMAND_LINE_FROM_MSI_DESCRIPTOR;
 
+/**
+ A prototype for the ControlTraceW function.
+ */
+typedef
+ULONG WINAPI
+CONTROL_TRACEW(YORI_TRACEHANDLE, LPCWSTR, PYORI_EVENT_TRACE_PROPERTIES, ULONG);
+
+/**
+ A prototype for a pointer to the ControlTraceW function.
+ */
+typedef CONTROL_TRACEW *PCONTROL_TRACEW;
+
 /**
  Prototype for the CryptAcquireContext function.
  */
@@ -8849,6 +10508,54 @@ EQUAL_SID(PSID, PSID);
  */
 typedef EQUAL_SID *PEQUAL_SID;
 
+/**
+ A prototype for the EventRegister function.
+ */
+typedef
+ULONG WINAPI
+EVENT_REGISTER(CONST GUID *, PYORI_ETW_ENABLE_CALLBACK, PVOID, PYORI_REGHANDLE);
+
+/**
+ A prototype for a pointer to the EventRegister function.
+ */
+typedef EVENT_REGISTER *PEVENT_REGISTER;
+
+/**
+ A prototype for the EventSetInformation function.
+ */
+typedef
+ULONG WINAPI
+EVENT_SET_INFORMATION(YORI_REGHANDLE, DWORD, PVOID, ULONG);
+
+/**
+ A prototype for a pointer to the EventSetInformation function.
+ */
+typedef EVENT_SET_INFORMATION *PEVENT_SET_INFORMATION;
+
+/**
+ A prototype for the EventUnregister function.
+ */
+typedef
+ULONG WINAPI
+EVENT_UNREGISTER(YORI_REGHANDLE);
+
+/**
+ A prototype for a pointer to the EventUnregister function.
+ */
+typedef EVENT_UNREGISTER *PEVENT_UNREGISTER;
+
+/**
+ A prototype for the EventWrite function.
+ */
+typedef
+ULONG WINAPI
+EVENT_WRITE(YORI_REGHANDLE, CONST YORI_EVENT_DESCRIPTOR *, ULONG, PYORI_EVENT_DATA_DESCRIPTOR);
+
+/**
+ A prototype for a pointer to the EventWrite function.
+ */
+typedef EVENT_WRITE *PEVENT_WRITE;
+
 /**
  Prototype for the FreeSid function.
  */
@@ -9017,6 +10724,30 @@ OPEN_THREAD_TOKEN(HANDLE, DWORD, BOOL, PHANDLE);
  */
 typedef OPEN_THREAD_TOKEN *POPEN_THREAD_TOKEN;
 
+/**
+ A prototype for the OpenTraceW function.
+ */
+typedef
+YORI_TRACEHANDLE WINAPI
+OPEN_TRACEW(PYORI_EVENT_TRACE_LOGFILEW);
+
+/**
+ A prototype for a pointer to the OpenTraceW function.
+ */
+typedef OPEN_TRACEW *POPEN_TRACEW;
+
+/**
+ A prototype for the ProcessTrace function.
+ */
+typedef
+ULONG WINAPI
+PROCESS_TRACE(PYORI_TRACEHANDLE, ULONG, LPFILETIME, LPFILETIME);
+
+/**
+ A prototype for a pointer to the ProcessTrace function.
+ */
+typedef PROCESS_TRACE *PPROCESS_TRACE;
+
 /**
  A prototype for the RegCloseKey function.
  */
@@ -9209,6 +10940,18 @@ SET_SECURITY_DESCRIPTOR_OWNER(PSECURITY_DESCRIPTOR, PSID, BOOL);
  */
 typedef SET_SECURITY_DESCRIPTOR_OWNER *PSET_SECURITY_DESCRIPTOR_OWNER;
 
+/**
+ A prototype for the StartTraceW function.
+ */
+typedef
+ULONG WINAPI
+START_TRACEW(PYORI_TRACEHANDLE, LPCWSTR, PYORI_EVENT_TRACE_PROPERTIES);
+
+/**
+ A prototype for a pointer to the StartTraceW function.
+ */
+typedef START_TRACEW *PSTART_TRACEW;
+
 /**
  A structure containing optional function pointers to advapi32.dll exported
  functions which programs can operate without having hard dependencies on.
@@ -9251,11 +10994,21 @@ typedef struct _YORI_ADVAPI32_FUNCTIONS {
      */
     PALLOCATE_AND_INITIALIZE_SID pAllocateAndInitializeSid;
 
+    /**
+     If it's available on the current system, a pointer to CloseTrace.
+     */
+    PCLOSE_TRACE pCloseTrace;
+
     /**
      If it's available on the current system, a pointer to CommandLineFromMsiDescriptor.
      */
     PCOMMAND_LINE_FROM_MSI_DESCRIPTOR pCommandLineFromMsiDescriptor;
 
+    /**
+     If it's available on the current system, a pointer to ControlTraceW.
+     */
+    PCONTROL_TRACEW pControlTraceW;
+
     /**
      If it's available on the current system, a pointer to CryptAcquireContextW.
      */
@@ -9291,6 +11044,27 @@ typedef struct _YORI_ADVAPI32_FUNCTIONS {
      */
     PEQUAL_SID pEqualSid;
 
+    /**
+     If it's available on the current system, a pointer to EventRegister.
+     */
+    PEVENT_REGISTER pEventRegister;
+
+    /**
+     If it's available on the current system, a pointer to
+     EventSetInformation.
+     */
+    PEVENT_SET_INFORMATION pEventSetInformation;
+
+    /**
+     If it's available on the current system, a pointer to EventUnregister.
+     */
+    PEVENT_UNREGISTER pEventUnregister;
+
+    /**
+     If it's available on the current system, a pointer to EventWrite.
+     */
+    PEVENT_WRITE pEventWrite;
+
     /**
      If it's available on the current system, a pointer to FreeSid.
      */
@@ -9361,6 +11135,16 @@ typedef struct _YORI_ADVAPI32_FUNCTIONS {
      */
     POPEN_THREAD_TOKEN pOpenThreadToken;
 
+    /**
+     If it's available on the current system, a pointer to OpenTraceW.
+     */
+    POPEN_TRACEW pOpenTraceW;
+
+    /**
+     If it's available on the current system, a pointer to ProcessTrace.
+     */
+    PPROCESS_TRACE pProcessTrace;
+
     /**
      If it's available on the current system, a pointer to RegCloseKey.
      */
@@ -9443,6 +11227,11 @@ typedef struct _YORI_ADVAPI32_FUNCTIONS {
      */
     PSET_SECURITY_DESCRIPTOR_OWNER pSetSecurityDescriptorOwner;
 
+    /**
+     If it's available on the current system, a pointer to StartTraceW.
+     */
+    PSTART_TRACEW pStartTraceW;
+
 } YORI_ADVAPI32_FUNCTIONS, *PYORI_ADVAPI32_FUNCTIONS;
 
 extern YORI_ADVAPI32_FUNCTIONS DllAdvApi32;
@@ -9713,6 +11502,86 @@ typedef struct _YORI_CTL3D_FUNCTIONS {
 
 extern YORI_CTL3D_FUNCTIONS DllCtl3d;
 
+/**
+ The callback type indicating that dbghelp is asking whether the handle it
+ was given refers to a process snapshot.
+ */
+#define YORI_MINIDUMP_IS_PROCESS_SNAPSHOT_CALLBACK 16
+
+#pragma pack(push, 4)
+
+/**
+ The header of the information passed to a MiniDumpWriteDump callback.  The
+ type specific information that follows is not used by this program.
+ */
+typedef struct _YORI_MINIDUMP_CALLBACK_INPUT {
+
+    /**
+     The process identifier of the process being dumped.
+     */
+    ULONG ProcessId;
+
+    /**
+     The handle to the process being dumped.
+     */
+    HANDLE ProcessHandle;
+
+    /**
+     The type of the callback.
+     */
+    ULONG CallbackType;
+} YORI_MINIDUMP_CALLBACK_INPUT, *PYORI_MINIDUMP_CALLBACK_INPUT;
+
+/**
+ The information returned from a MiniDumpWriteDump callback.  This is a
+ union whose interpretation depends on the callback type.  Only the form
+ used by this program is described here, and space is reserved for the
+ largest form.
+ */
+typedef union _YORI_MINIDUMP_CALLBACK_OUTPUT {
+
+    /**
+     The result of the callback, used by callbacks including
+     YORI_MINIDUMP_IS_PROCESS_SNAPSHOT_CALLBACK.
+     */
+    HRESULT Status;
+
+    /**
+     Space for the other forms of the output.
+     */
+    BYTE Reserved[32];
+} YORI_MINIDUMP_CALLBACK_OUTPUT, *PYORI_MINIDUMP_CALLBACK_OUTPUT;
+
+#pragma pack(pop)
+
+/**
+ A prototype for a callback function invoked while writing a minidump.
+ */
+typedef
+BOOL CALLBACK
+YORI_MINIDUMP_CALLBACK_ROUTINE(PVOID, PYORI_MINIDUMP_CALLBACK_INPUT, PYORI_MINIDUMP_CALLBACK_OUTPUT);
+
+/**
+ A pointer to a callback function invoked while writing a minidump.
+ */
+typedef YORI_MINIDUMP_CALLBACK_ROUTINE *PYORI_MINIDUMP_CALLBACK_ROUTINE;
+
+/**
+ Specifies a callback function to invoke while writing a minidump.
+ */
+typedef struct _YORI_MINIDUMP_CALLBACK_INFORMATION {
+
+    /**
+     The function to invoke.
+     */
+    PYORI_MINIDUMP_CALLBACK_ROUTINE CallbackRoutine;
+
+    /**
+     A context to pass to the function.
+     */
+    PVOID CallbackParam;
+} YORI_MINIDUMP_CALLBACK_INFORMATION, *PYORI_MINIDUMP_CALLBACK_INFORMATION;
+
 /**
  A prototype for the MiniDumpWriteDump function.
  */
@@ -10022,6 +11891,74 @@ GET_MODULE_FILE_NAME_EXW(HANDLE, HANDLE, LPTSTR, DWORD);
  */
 typedef GET_MODULE_FILE_NAME_EXW *PGET_MODULE_FILE_NAME_EXW;
 
+/**
+ Information about the memory used by a process.
+ */
+typedef struct _YORI_PROCESS_MEMORY_COUNTERS {
+
+    /**
+     The size of this structure, in bytes.
+     */
+    DWORD cb;
+
+    /**
+     The number of page faults incurred by the process.
+     */
+    DWORD PageFaultCount;
+
+    /**
+     The largest working set of the process, in bytes.
+     */
+    SIZE_T PeakWorkingSetSize;
+
+    /**
+     The current working set of the process, in bytes.
+     */
+    SIZE_T WorkingSetSize;
+
+    /**
+     Field not needed/supported by YoriLib.
+     */
+    SIZE_T Unused1;
+
+    /**
+     Field not needed/supported by YoriLib.
+     */
+    SIZE_T Unused2;
+
+    /**
+     Field not needed/supported by YoriLib.
+     */
+    SIZE_T Unused3;
+
+    /**
+     Field not needed/supported by YoriLib.
+     */
+    SIZE_T Unused4;
+
+    /**
+     The current amount of memory committed by the process, in bytes.
+     */
+    SIZE_T PagefileUsage;
+
+    /**
+     The largest amount of memory committed by the process, in bytes.
+     */
+    SIZE_T PeakPagefileUsage;
+} YORI_PROCESS_MEMORY_COUNTERS, *PYORI_PROCESS_MEMORY_COUNTERS;
+
+/**
+ A prototype for the GetProcessMemoryInfo function.
+ */
+typedef
+BOOL WINAPI
+GET_PROCESS_MEMORY_INFO(HANDLE, PYORI_PROCESS_MEMORY_COUNTERS, DWORD);
+
+/**
+ A prototype for a pointer to the GetProcessMemoryInfo function.
+ */
+typedef GET_PROCESS_MEMORY_INFO *PGET_PROCESS_MEMORY_INFO;
+
 /**
  A structure containing optional function pointers to psapi.dll exported
  functions which programs can operate without having hard dependencies on.
@@ -10038,6 +11975,12 @@ typedef struct _YORI_PSAPI_FUNCTIONS {
      */
     PGET_MODULE_FILE_NAME_EXW pGetModuleFileNameExW;
 
+    /**
+     If it's available on the current system, a pointer to
+     GetProcessMemoryInfo.
+     */
+    PGET_PROCESS_MEMORY_INFO pGetProcessMemoryInfo;
+
 } YORI_PSAPI_FUNCTIONS, *PYORI_PSAPI_FUNCTIONS;
 
 extern YORI_PSAPI_FUNCTIONS DllPsapi;
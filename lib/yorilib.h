@@ -172,6 +172,95 @@ typedef struct _YORI_STRING_ARRAY {
 
 } YORI_STRING_ARRAY, *PYORI_STRING_ARRAY;
 
+/**
+ A compiled set of substrings that can be searched for in a single pass over
+ a string.  This is used when the same substrings are searched for in many
+ strings.
+ */
+typedef struct _YORI_LIB_SUBSTRING_MATCHER {
+
+    /**
+     The number of substrings in MatchArray.
+     */
+    YORI_ALLOC_SIZE_T NumberMatches;
+
+    /**
+     The substrings to search for.  Searches return pointers into this
+     array, which is owned by the caller.
+     */
+    PYORI_STRING MatchArray;
+
+    /**
+     TRUE if substrings are matched case insensitively.
+     */
+    BOOLEAN Insensitive;
+
+    /**
+     The index of the first empty substring, or -1 if there are none.
+     */
+    YORI_ALLOC_SIZE_T EmptyMatchIndex;
+
+    /**
+     If only one substring is not empty, its index, which is searched for
+     without building an automaton.  Otherwise -1.
+     */
+    YORI_ALLOC_SIZE_T SingleMatchIndex;
+
+    /**
+     The length of the longest substring.
+     */
+    YORI_ALLOC_SIZE_T MaximumLength;
+
+    /**
+     The number of distinct characters in the substrings.
+     */
+    YORI_ALLOC_SIZE_T ClassCount;
+
+    /**
+     The number of states in the automaton.
+     */
+    YORI_ALLOC_SIZE_T StateCount;
+
+    /**
+     The number of elements in HighChars and HighClass.
+     */
+    YORI_ALLOC_SIZE_T HighCharCount;
+
+    /**
+     The class of each character below 256, or zero if the character does
+     not occur in any substring.
+     */
+    YORI_ALLOC_SIZE_T LowClass[256];
+
+    /**
+     A sorted array of characters 256 and above that occur in a substring.
+     */
+    LPTSTR HighChars;
+
+    /**
+     The class of each character in HighChars.
+     */
+    PYORI_ALLOC_SIZE_T HighClass;
+
+    /**
+     The state to move to from each state for each class of character.
+     */
+    PYORI_ALLOC_SIZE_T Transitions;
+
+    /**
+     For each state, the index of the substring that ends at that state, or
+     -1 if no substring ends at that state.
+     */
+    PYORI_ALLOC_SIZE_T StateMatch;
+
+    /**
+     For each state, the next shorter state which ends a substring, or zero
+     if there is none.
+     */
+    PYORI_ALLOC_SIZE_T OutputLink;
+
+} YORI_LIB_SUBSTRING_MATCHER, *PYORI_LIB_SUBSTRING_MATCHER;
+
 /**
  A buffer for a single data stream.
  */
@@ -214,8 +303,26 @@ typedef struct _YORI_HASH_ENTRY {
      table to identify the entry.
      */
     PVOID Context;
+
+    /**
+     The hash table that contains this entry.
+     */
+    struct _YORI_HASH_TABLE *HashTable;
+
+    /**
+     The hash of the key.  This is retained so entries can be moved between
+     buckets as the table grows without hashing the key again.
+     */
+    DWORD Hash;
 } YORI_HASH_ENTRY, *PYORI_HASH_ENTRY;
 
+/**
+ The number of buckets in each segment of a hash table.  Buckets are
+ allocated in segments so the table can grow without moving existing
+ buckets.
+ */
+#define YORI_HASH_SEGMENT_SIZE (64)
+
 /**
  A structure describing a hash bucket in a hash table.
  */
@@ -228,19 +335,49 @@ typedef struct _YORI_HASH_BUCKET {
 } YORI_HASH_BUCKET, *PYORI_HASH_BUCKET;
 
 /**
- A structure describing a hash table.
+ A structure describing a hash table.  The table grows using linear
+ hashing: when the table becomes too full, one bucket is split into two,
+ so growth is spread across many inserts rather than rehashing the entire
+ table at once.  Callers that access a table from multiple threads must
+ provide their own synchronization.
  */
 typedef struct _YORI_HASH_TABLE {
 
     /**
-     The number of buckets in the hash table.
+     The number of buckets currently in use in the hash table.
      */
     YORI_ALLOC_SIZE_T NumberBuckets;
 
     /**
-     An array of hash buckets.
+     The number of entries in the hash table.
+     */
+    YORI_ALLOC_SIZE_T NumberEntries;
+
+    /**
+     A mask to apply to a hash to find its bucket, if the bucket has not
+     been split during the current round of growth.  This is one less than
+     the number of buckets at the start of the round, which is a power of
+     two.
+     */
+    YORI_ALLOC_SIZE_T SplitMask;
+
+    /**
+     The index of the next bucket to split.  Buckets below this index have
+     been split during the current round of growth.
      */
-    PYORI_HASH_BUCKET Buckets;
+    YORI_ALLOC_SIZE_T SplitIndex;
+
+    /**
+     The number of elements in the Segments array.
+     */
+    YORI_ALLOC_SIZE_T NumberSegments;
+
+    /**
+     An array of pointers to segments, each containing
+     YORI_HASH_SEGMENT_SIZE buckets.  Segments beyond those needed for the
+     buckets in use may be NULL.
+     */
+    PYORI_HASH_BUCKET *Segments;
 } YORI_HASH_TABLE, *PYORI_HASH_TABLE;
 
 #pragma pack(push, 1)
@@ -638,6 +775,90 @@ YORI_LIB_CAB_EXPAND_FILE_CALLBACK(
  */
 typedef YORI_LIB_CAB_EXPAND_FILE_CALLBACK *PYORI_LIB_CAB_EXPAND_FILE_CALLBACK;
 
+/**
+ Information about a single file within a CAB, read from the CAB's file
+ entries without decompressing any data.
+ */
+typedef struct _YORI_LIB_CAB_INDEX_ENTRY {
+
+    /**
+     The name of the file within the CAB.
+     */
+    YORI_STRING FileName;
+
+    /**
+     The uncompressed size of the file, in bytes.
+     */
+    DWORD FileSize;
+
+    /**
+     The offset of the file within the uncompressed data of its folder.
+     */
+    DWORD FolderOffset;
+
+    /**
+     The index of the folder containing the file.
+     */
+    WORD FolderIndex;
+
+    /**
+     The attributes of the file.
+     */
+    WORD Attributes;
+
+    /**
+     The date the file was last written, in DOS format.
+     */
+    WORD DosDate;
+
+    /**
+     The time the file was last written, in DOS format.
+     */
+    WORD DosTime;
+
+} YORI_LIB_CAB_INDEX_ENTRY, *PYORI_LIB_CAB_INDEX_ENTRY;
+
+/**
+ A list of the files within a CAB.
+ */
+typedef struct _YORI_LIB_CAB_INDEX {
+
+    /**
+     The number of folders within the CAB.  Each folder is an independently
+     compressed stream.
+     */
+    DWORD FolderCount;
+
+    /**
+     The number of elements in the Files array.
+     */
+    DWORD FileCount;
+
+    /**
+     An array of files within the CAB, in the order they are stored.
+     */
+    PYORI_LIB_CAB_INDEX_ENTRY Files;
+
+    /**
+     TRUE if the CAB is part of a set of CABs, meaning some files may start
+     or end in a different CAB.
+     */
+    BOOLEAN SpansCabinets;
+
+} YORI_LIB_CAB_INDEX, *PYORI_LIB_CAB_INDEX;
+
+VOID
+YoriLibCabFreeIndex(
+    __inout PYORI_LIB_CAB_INDEX Index
+    );
+
+__success(return == ERROR_SUCCESS)
+DWORD
+YoriLibCabReadIndex(
+    __in PYORI_STRING CabFileName,
+    __out PYORI_LIB_CAB_INDEX Index
+    );
+
 __success(return)
 BOOL
 YoriLibExtractCab(
@@ -655,6 +876,16 @@ YoriLibExtractCab(
     __inout_opt PYORI_STRING ErrorString
     );
 
+__success(return)
+BOOL
+YoriLibExtractCabFileToHandle(
+    __in PYORI_STRING CabFileName,
+    __in PYORI_STRING FileName,
+    __in HANDLE OutputHandle,
+    __inout_opt PDWORD ErrorCode,
+    __inout_opt PYORI_STRING ErrorString
+    );
+
 __success(return)
 BOOL
 YoriLibCreateCab(
@@ -980,12 +1211,93 @@ YoriLibSetConsoleDisplayMode(
 
 // *** CPUINFO.C ***
 
+/**
+ The ways that child processes can be distributed across processors.
+ */
+typedef enum _YORI_LIB_PROCESSOR_PLACEMENT_TYPE {
+    YoriLibPlacementByGroup = 0,
+    YoriLibPlacementByNumaNode = 1
+} YORI_LIB_PROCESSOR_PLACEMENT_TYPE;
+
+/**
+ A set of processors that a child process can be restricted to.
+ */
+typedef struct _YORI_LIB_PROCESSOR_SET {
+
+    /**
+     The NUMA node number or processor group number that this set describes.
+     */
+    DWORD Number;
+
+    /**
+     The processor group and processors within the group in this set.
+     */
+    YORI_PROCESSOR_GROUP_AFFINITY Affinity;
+
+} YORI_LIB_PROCESSOR_SET, *PYORI_LIB_PROCESSOR_SET;
+
+/**
+ State used to distribute child processes across sets of processors.
+ */
+typedef struct _YORI_LIB_PROCESSOR_PLACEMENT {
+
+    /**
+     An array of processor sets that children can be placed on.
+     */
+    PYORI_LIB_PROCESSOR_SET Sets;
+
+    /**
+     The number of elements in Sets.
+     */
+    DWORD SetCount;
+
+    /**
+     A counter used to select the next set in round-robin order.
+     */
+    LONG NextSet;
+
+} YORI_LIB_PROCESSOR_PLACEMENT, *PYORI_LIB_PROCESSOR_PLACEMENT;
+
+__success(return)
+BOOL
+YoriLibQueryLogicalProcessorInformation(
+    __out PYORI_SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX *ProcInfo,
+    __out PDWORD BytesInBuffer
+    );
+
 VOID
 YoriLibQueryCpuCount(
     __out PWORD PerformanceLogicalProcessors,
     __out PWORD EfficiencyLogicalProcessors
     );
 
+__success(return)
+BOOL
+YoriLibInitializeProcessorPlacement(
+    __out PYORI_LIB_PROCESSOR_PLACEMENT Placement,
+    __in YORI_LIB_PROCESSOR_PLACEMENT_TYPE PlacementType
+    );
+
+__success(return)
+BOOL
+YoriLibPlaceNextProcess(
+    __in PYORI_LIB_PROCESSOR_PLACEMENT Placement,
+    __in HANDLE hThread
+    );
+
+__success(return)
+BOOL
+YoriLibPlaceProcessOnSet(
+    __in PYORI_LIB_PROCESSOR_PLACEMENT Placement,
+    __in HANDLE hThread,
+    __in DWORD Number
+    );
+
+VOID
+YoriLibCleanupProcessorPlacement(
+    __in PYORI_LIB_PROCESSOR_PLACEMENT Placement
+    );
+
 // *** CSHOT.C ***
 
 BOOL
@@ -995,6 +1307,15 @@ YoriLibRewriteConsoleContents(
     __in DWORD SkipCount
     );
 
+BOOL
+YoriLibGenerateVtStringWithLineEnding(
+    __inout PYORI_STRING String,
+    __in COORD BufferSize,
+    __in LPWSTR CharBuffer,
+    __in PWORD AttrBuffer,
+    __in PCYORI_STRING LineEnding
+    );
+
 BOOL
 YoriLibGenerateVtStringFromConsoleBuffers(
     __inout PYORI_STRING String,
@@ -1246,6 +1567,46 @@ YoriLibDbgRealAssert(
 #define ASSERT(x)
 #endif
 
+// *** DELOBJ.C ***
+
+/**
+ Delete objects with POSIX semantics, so the name is released as soon as
+ the object is deleted.
+ */
+#define YORILIB_DELETE_POSIX_SEMANTICS (0x0001)
+
+/**
+ Send objects to the recycle bin where possible.
+ */
+#define YORILIB_DELETE_RECYCLE_BIN     (0x0002)
+
+/**
+ An opaque pointer to the state used to delete a set of objects.
+ */
+typedef struct _YORILIB_DELETE_CONTEXT *PYORILIB_DELETE_CONTEXT;
+
+PYORILIB_DELETE_CONTEXT
+YoriLibDeleteCreateContext(
+    __in LPCTSTR AppName,
+    __in DWORD Flags,
+    __in DWORD WorkerCount
+    );
+
+VOID
+YoriLibDeleteObject(
+    __in PYORILIB_DELETE_CONTEXT DeleteContext,
+    __in PYORI_STRING FilePath,
+    __in DWORD FileAttributes,
+    __in DWORD Depth
+    );
+
+VOID
+YoriLibDeleteFreeContext(
+    __in PYORILIB_DELETE_CONTEXT DeleteContext,
+    __out_opt PDWORDLONG ObjectsDeleted,
+    __out_opt PDWORDLONG DirectoriesDeleted
+    );
+
 // *** DYLD.C ***
 
 __success(return)
@@ -1417,6 +1778,69 @@ YoriLibRemoveEnvComponent(
     __in PYORI_STRING ComponentToRemove
     );
 
+// *** ETW.C ***
+
+/**
+ The keyword of events describing each batch of directory entries returned
+ while enumerating files.
+ */
+#define YORI_LIB_ETW_KEYWORD_FILEENUM       0x0000000000000001
+
+/**
+ The keyword of events describing each buffer read while reading lines.
+ */
+#define YORI_LIB_ETW_KEYWORD_LINEREAD       0x0000000000000002
+
+/**
+ The keyword of events describing child processes being launched.
+ */
+#define YORI_LIB_ETW_KEYWORD_PROCESS        0x0000000000000004
+
+/**
+ The keyword of events describing jobs completing.
+ */
+#define YORI_LIB_ETW_KEYWORD_JOB            0x0000000000000008
+
+/**
+ The keyword of events describing tab completion.
+ */
+#define YORI_LIB_ETW_KEYWORD_COMPLETE       0x0000000000000010
+
+/**
+ The keyword of events describing the prompt being displayed.
+ */
+#define YORI_LIB_ETW_KEYWORD_PROMPT         0x0000000000000020
+
+extern volatile DWORDLONG YoriLibEtwEnabledKeywords;
+
+/**
+ Returns TRUE if a tracing session wants events with the specified keyword.
+ This is cheap enough to call on hot paths before collecting information
+ for an event.
+ */
+#define YoriLibEtwIsEnabled(Keyword) ((YoriLibEtwEnabledKeywords & (Keyword)) != 0)
+
+VOID
+YoriLibEtwRegister(VOID);
+
+VOID
+YoriLibEtwUnregister(VOID);
+
+VOID
+YoriLibEtwWriteEvent(
+    __in DWORDLONG Keyword,
+    __in LPCSTR EventName,
+    __in_opt LPCSTR StringName,
+    __in_opt PCYORI_STRING String,
+    __in_opt LPCSTR Value1Name,
+    __in DWORDLONG Value1,
+    __in_opt LPCSTR Value2Name,
+    __in DWORDLONG Value2
+    );
+
+DWORDLONG
+YoriLibEtwGetTimestamp(VOID);
+
 // *** FILECOMP.C ***
 
 /**
@@ -1440,6 +1864,39 @@ typedef union _YORILIB_COMPRESS_ALGORITHM {
     DWORD EntireAlgorithm;
 } YORILIB_COMPRESS_ALGORITHM;
 
+/**
+ Forward declaration of the context describing a background pool of threads
+ that can compress individual files.
+ */
+typedef struct _YORILIB_COMPRESS_CONTEXT *PYORILIB_COMPRESS_CONTEXT;
+
+/**
+ Statistics describing the work performed by a single compression thread.
+ */
+typedef struct _YORILIB_COMPRESS_WORKER_STATS {
+
+    /**
+     Pointer to the compress context that this thread is processing work
+     for.
+     */
+    PYORILIB_COMPRESS_CONTEXT CompressContext;
+
+    /**
+     The number of files processed by this thread.
+     */
+    LONGLONG FilesProcessed;
+
+    /**
+     The number of bytes of file data processed by this thread.
+     */
+    LONGLONG BytesProcessed;
+
+    /**
+     The amount of time this thread spent processing files, in 100ns units.
+     */
+    LONGLONG BusyTime;
+} YORILIB_COMPRESS_WORKER_STATS, *PYORILIB_COMPRESS_WORKER_STATS;
+
 /**
  Context describing a background pool of threads and list of work that can
  compress individual files.
@@ -1467,11 +1924,25 @@ typedef struct _YORILIB_COMPRESS_CONTEXT {
      */
     HANDLE WorkerShutdownEvent;
 
+    /**
+     A semaphore whose count indicates the number of items which can be
+     inserted into the list before the queue is full.  Callers queueing
+     work wait on this semaphore, so a full queue blocks enumeration until
+     a compression thread removes an item.
+     */
+    HANDLE SlotsAvailableSemaphore;
+
     /**
      An array of handles to threads allocated to compress file contents.
      */
     PHANDLE Threads;
 
+    /**
+     An array of statistics, one per thread, describing the work performed
+     by each thread.
+     */
+    PYORILIB_COMPRESS_WORKER_STATS WorkerStats;
+
     /**
      If the target should be written as compressed, this specifies the
      compression algorithm.
@@ -1496,12 +1967,18 @@ typedef struct _YORILIB_COMPRESS_CONTEXT {
     YORI_ALLOC_SIZE_T ItemsQueued;
 
     /**
-     If TRUE, output is generated describing thread creation and throttling.
+     If TRUE, output is generated describing thread creation and throttling,
+     and statistics for each thread are displayed when the threads complete.
      */
     BOOL Verbose;
 
-} YORILIB_COMPRESS_CONTEXT, *PYORILIB_COMPRESS_CONTEXT;
-
+    /**
+     If TRUE, compression threads run with background CPU and I/O priority.
+     */
+    BOOL BackgroundPriority;
+
+} YORILIB_COMPRESS_CONTEXT;
+
 BOOL
 YoriLibInitializeCompressContext(
     __in PYORILIB_COMPRESS_CONTEXT CompressContext,
@@ -1604,6 +2081,75 @@ typedef YORILIB_FILE_ENUM_FN *PYORILIB_FILE_ENUM_FN;
  */
 #define YORILIB_FILEENUM_DIRECTORY_CONTENTS      0x00000100
 
+/**
+ When recursing, enumerate child directories concurrently on a pool of
+ worker threads.  Objects from different directories are returned in no
+ particular order, so RECURSE_BEFORE_RETURN and RECURSE_AFTER_RETURN only
+ indicate that recursion should occur.  Unless
+ YORILIB_FILEENUM_CONCURRENT_CALLBACKS is also specified, callbacks are
+ serialized so only one is executing at any time.
+ */
+#define YORILIB_FILEENUM_PARALLEL                0x00000200
+
+/**
+ When combined with YORILIB_FILEENUM_PARALLEL, indicates that the caller's
+ callbacks are safe to invoke on multiple threads simultaneously.
+ */
+#define YORILIB_FILEENUM_CONCURRENT_CALLBACKS    0x00000400
+
+/**
+ Query directory contents in bulk from the file system where possible,
+ rather than via FindFirstFile.  When specified, the find data passed to
+ callbacks is always contained within a @ref YORILIB_FIND_DATA_EXTENDED
+ structure, which may supply information that would otherwise require
+ opening each file.
+ */
+#define YORILIB_FILEENUM_BULK_QUERY              0x00000800
+
+/**
+ Indicates the FileId member of YORILIB_FIND_DATA_EXTENDED is valid.
+ */
+#define YORILIB_FIND_DATA_VALID_FILE_ID          0x00000001
+
+/**
+ Indicates the AllocationSize member of YORILIB_FIND_DATA_EXTENDED is
+ valid.
+ */
+#define YORILIB_FIND_DATA_VALID_ALLOCATION_SIZE  0x00000002
+
+/**
+ Information returned for each file by an enumerate that specified
+ YORILIB_FILEENUM_BULK_QUERY.  Callbacks receive a pointer to the FindData
+ member, which can be converted to this structure with CONTAINING_RECORD.
+ */
+typedef struct _YORILIB_FIND_DATA_EXTENDED {
+
+    /**
+     The information that FindFirstFile would return.  This element must
+     be first so callbacks which are unaware of the extended information
+     can use it directly.
+     */
+    WIN32_FIND_DATA FindData;
+
+    /**
+     The file system's identifier for the file.
+     */
+    LARGE_INTEGER FileId;
+
+    /**
+     The amount of space allocated to the file.
+     */
+    LARGE_INTEGER AllocationSize;
+
+    /**
+     A combination of YORILIB_FIND_DATA_VALID_* flags indicating which of
+     the above fields contain valid information.  This can be zero if the
+     file system could not be queried in bulk.
+     */
+    DWORD ValidFields;
+
+} YORILIB_FIND_DATA_EXTENDED, *PYORILIB_FIND_DATA_EXTENDED;
+
 __success(return)
 BOOL
 YoriLibForEachFile(
@@ -1682,6 +2228,17 @@ typedef struct _YORI_LIB_FILE_FILT_MATCH_CRITERIA {
      */
     YORI_LIB_FILE_FILT_COMPARE_FN CompareFn;
 
+    /**
+     Identifies the collection function within the filter, so that criteria
+     sharing a collection function only collect it once per file.
+     */
+    DWORD CollectorIndex;
+
+    /**
+     The relative cost of collecting the data needed by this criteria.
+     */
+    DWORD Cost;
+
     /**
      An array indicating whether a match is found if the comparison returns
      less than, greater than, or equal.
@@ -1835,6 +2392,13 @@ YoriLibGetFilePermissionPairs(
     __out PCYORI_LIB_CHAR_TO_DWORD_FLAG * Pairs
     );
 
+__success(return)
+BOOL
+YoriLibCapturePeHeaders (
+    __in PYORI_STRING FullPath,
+    __out PYORILIB_PE_HEADERS PeHeaders
+    );
+
 BOOL
 YoriLibIsExecutableGui(
     __in PYORI_STRING FullPath
@@ -1931,6 +2495,28 @@ YoriLibCollectFileId (
     __in PYORI_STRING FullPath
     );
 
+BOOL
+YoriLibCollectFromFindDataExtended(
+    __inout PYORI_FILE_INFO Entry,
+    __in PYORILIB_FIND_DATA_EXTENDED FindDataEx,
+    __in YORI_LIB_FILE_FILT_COLLECT_FN CollectFn
+    );
+
+BOOL
+YoriLibIsCollectFnFromFindData(
+    __in YORI_LIB_FILE_FILT_COLLECT_FN CollectFn
+    );
+
+BOOL
+YoriLibCollectFileInfoSet(
+    __inout PYORI_FILE_INFO Entry,
+    __in PWIN32_FIND_DATA FindData,
+    __in_opt PYORILIB_FIND_DATA_EXTENDED FindDataEx,
+    __in PYORI_STRING FullPath,
+    __in_ecount(CollectFnCount) YORI_LIB_FILE_FILT_COLLECT_FN * CollectFns,
+    __in YORI_ALLOC_SIZE_T CollectFnCount
+    );
+
 BOOL
 YoriLibCollectFileName (
     __inout PYORI_FILE_INFO Entry,
@@ -2462,6 +3048,216 @@ YoriLibGenerateWriteTime(
     __in PYORI_STRING String
     );
 
+// *** FIQUEUE.C ***
+
+/**
+ An opaque pointer to a pool of threads collecting file information.
+ */
+typedef struct _YORILIB_FILE_INFO_QUEUE *PYORILIB_FILE_INFO_QUEUE;
+
+/**
+ A prototype for a function invoked when information about a file submitted
+ to a file information queue has been collected.  This is invoked on the
+ thread that submitted the file, in the order that files were submitted.
+ */
+typedef VOID YORILIB_FILE_INFO_QUEUE_COMPLETE_FN(PYORI_FILE_INFO Entry, PWIN32_FIND_DATA FindData, PYORI_STRING FullPath, PVOID Context);
+
+/**
+ A pointer to a function invoked when information about a file submitted to
+ a file information queue has been collected.
+ */
+typedef YORILIB_FILE_INFO_QUEUE_COMPLETE_FN *PYORILIB_FILE_INFO_QUEUE_COMPLETE_FN;
+
+PYORILIB_FILE_INFO_QUEUE
+YoriLibFileInfoQueueCreate(
+    __in_ecount(CollectFnCount) YORI_LIB_FILE_FILT_COLLECT_FN * CollectFns,
+    __in YORI_ALLOC_SIZE_T CollectFnCount,
+    __in PYORILIB_FILE_INFO_QUEUE_COMPLETE_FN CompleteFn,
+    __in_opt PVOID Context
+    );
+
+__success(return)
+BOOL
+YoriLibFileInfoQueueSubmit(
+    __in PYORILIB_FILE_INFO_QUEUE Queue,
+    __in PWIN32_FIND_DATA FindData,
+    __in_opt PYORILIB_FIND_DATA_EXTENDED FindDataEx,
+    __in PYORI_STRING FullPath
+    );
+
+VOID
+YoriLibFileInfoQueueFlush(
+    __in PYORILIB_FILE_INFO_QUEUE Queue
+    );
+
+VOID
+YoriLibFileInfoQueueDestroy(
+    __in PYORILIB_FILE_INFO_QUEUE Queue
+    );
+
+// *** FIUPDATE.C ***
+
+/**
+ Set the timestamps described in a file update operation.
+ */
+#define YORILIB_FILE_UPDATE_SET_TIMES            (0x0001)
+
+/**
+ Set and clear the attributes described in a file update operation.
+ */
+#define YORILIB_FILE_UPDATE_SET_ATTRIBUTES       (0x0002)
+
+/**
+ Set the case sensitivity described in a file update operation.  This is
+ only meaningful for directories.
+ */
+#define YORILIB_FILE_UPDATE_SET_CASE_SENSITIVITY (0x0004)
+
+/**
+ Apply the update to links as opposed to link targets.
+ */
+#define YORILIB_FILE_UPDATE_NO_FOLLOW_LINKS      (0x0008)
+
+/**
+ A description of a change to apply to the metadata of a set of files.
+ */
+typedef struct _YORILIB_FILE_UPDATE_OPERATION {
+
+    /**
+     A combination of YORILIB_FILE_UPDATE_ flags indicating the changes to
+     apply.
+     */
+    DWORD Flags;
+
+    /**
+     The new creation time.  Zero leaves the time unchanged.  These follow
+     the conventions of SetFileTime.
+     */
+    FILETIME CreationTime;
+
+    /**
+     The new access time.  Zero leaves the time unchanged.
+     */
+    FILETIME LastAccessTime;
+
+    /**
+     The new write time.  Zero leaves the time unchanged.
+     */
+    FILETIME LastWriteTime;
+
+    /**
+     The set of attribute flags to set on each file.
+     */
+    DWORD AttributesToSet;
+
+    /**
+     The set of attribute flags to clear on each file.
+     */
+    DWORD AttributesToClear;
+
+    /**
+     TRUE if directories should be case sensitive, FALSE if they should be
+     case insensitive.
+     */
+    BOOLEAN CaseSensitive;
+
+    /**
+     The name of the program, used as a prefix for error messages.
+     */
+    LPCTSTR ProgramName;
+
+} YORILIB_FILE_UPDATE_OPERATION, *PYORILIB_FILE_UPDATE_OPERATION;
+
+/**
+ A summary of the files processed by a file update queue.
+ */
+typedef struct _YORILIB_FILE_UPDATE_STATS {
+
+    /**
+     The number of files successfully updated.
+     */
+    DWORDLONG FilesUpdated;
+
+    /**
+     The number of files that could not be updated.
+     */
+    DWORDLONG FilesFailed;
+
+    /**
+     The time elapsed since the queue was created, in 100ns units.
+     */
+    DWORDLONG ElapsedTime;
+
+} YORILIB_FILE_UPDATE_STATS, *PYORILIB_FILE_UPDATE_STATS;
+
+/**
+ An opaque pointer to a pool of threads applying a change to files.
+ */
+typedef struct _YORILIB_FILE_UPDATE_QUEUE *PYORILIB_FILE_UPDATE_QUEUE;
+
+BOOL
+YoriLibFileUpdateApply(
+    __in PYORILIB_FILE_UPDATE_OPERATION Operation,
+    __in PYORI_STRING FilePath
+    );
+
+PYORILIB_FILE_UPDATE_QUEUE
+YoriLibFileUpdateQueueCreate(
+    __in PYORILIB_FILE_UPDATE_OPERATION Operation,
+    __in DWORD ThreadCount
+    );
+
+VOID
+YoriLibFileUpdateQueueSubmit(
+    __in PYORILIB_FILE_UPDATE_QUEUE Queue,
+    __in PYORI_STRING FilePath
+    );
+
+VOID
+YoriLibFileUpdateQueueFlush(
+    __in PYORILIB_FILE_UPDATE_QUEUE Queue,
+    __out_opt PYORILIB_FILE_UPDATE_STATS Stats
+    );
+
+VOID
+YoriLibFileUpdateQueueDisplayStats(
+    __in PYORILIB_FILE_UPDATE_QUEUE Queue
+    );
+
+VOID
+YoriLibFileUpdateQueueDestroy(
+    __in PYORILIB_FILE_UPDATE_QUEUE Queue
+    );
+
+// *** FPCACHE.C ***
+
+BOOLEAN
+YoriLibFullPathCacheEnable(VOID);
+
+DWORD
+YoriLibFullPathCacheLookup(
+    __in_opt PCYORI_STRING PrimaryDirectory,
+    __in BOOLEAN KeyedByCurrentDirectory,
+    __in PCYORI_STRING FileName,
+    __in BOOL ReturnEscapedPath,
+    __in BOOLEAN AllowAllocation,
+    __inout PYORI_STRING Buffer,
+    __deref_opt_out_opt LPTSTR* lpFilePart
+    );
+
+VOID
+YoriLibFullPathCacheInsert(
+    __in_opt PCYORI_STRING PrimaryDirectory,
+    __in BOOLEAN KeyedByCurrentDirectory,
+    __in PCYORI_STRING FileName,
+    __in BOOL ReturnEscapedPath,
+    __in PCYORI_STRING FullPath,
+    __in_opt LPTSTR FilePart
+    );
+
+VOID
+YoriLibFullPathCacheCleanup(VOID);
+
 // *** FULLPATH.C ***
 
 /**
@@ -2525,6 +3321,16 @@ YoriLibGetFullPathNameRelativeTo(
     __deref_opt_out_opt LPTSTR* lpFilePart
     );
 
+__success(return)
+BOOL
+YoriLibGetFullPathNameRelativeToBuffer(
+    __in PYORI_STRING PrimaryDirectory,
+    __in PYORI_STRING FileName,
+    __in BOOL ReturnEscapedPath,
+    __inout PYORI_STRING Buffer,
+    __deref_opt_out_opt LPTSTR* lpFilePart
+    );
+
 __success(return)
 BOOL
 YoriLibExpandHomeDirectories(
@@ -2604,6 +3410,104 @@ YoriLibGetDiskFreeSpace(
     __out_opt PLARGE_INTEGER FreeBytes
     );
 
+// *** GITSTAT.C ***
+
+/**
+ The number of characters needed to hold the longest supported object name
+ in hex, including a NULL terminator.
+ */
+#define YORI_LIB_GIT_MAX_HASH_CHARS (65)
+
+/**
+ Indicates that the Head field of YORI_LIB_GIT_STATUS contains the object
+ name of the commit HEAD refers to.  This is not set for a branch with no
+ commits.
+ */
+#define YORI_LIB_GIT_STATUS_HEAD     (0x00000001)
+
+/**
+ Indicates that the branch has an upstream branch and the UpstreamMatches
+ field of YORI_LIB_GIT_STATUS is meaningful.
+ */
+#define YORI_LIB_GIT_STATUS_UPSTREAM (0x00000002)
+
+/**
+ Indicates that the index was read and the Modified field of
+ YORI_LIB_GIT_STATUS is meaningful.
+ */
+#define YORI_LIB_GIT_STATUS_INDEX    (0x00000004)
+
+/**
+ The status of a git repository.
+ */
+typedef struct _YORI_LIB_GIT_STATUS {
+
+    /**
+     A combination of YORI_LIB_GIT_STATUS_* flags indicating which fields
+     are meaningful.
+     */
+    DWORD ValidFields;
+
+    /**
+     The top level directory of the working tree.
+     */
+    YORI_STRING WorkTree;
+
+    /**
+     The name of the current branch, or if HEAD is detached, an abbreviated
+     object name of the current commit.
+     */
+    YORI_STRING Branch;
+
+    /**
+     The object name of the current commit, in hex.
+     */
+    TCHAR Head[YORI_LIB_GIT_MAX_HASH_CHARS];
+
+    /**
+     TRUE if HEAD refers to a commit rather than a branch.
+     */
+    BOOLEAN Detached;
+
+    /**
+     TRUE if the upstream branch refers to the same commit as HEAD.  If
+     FALSE, the branch is ahead of, behind, or has diverged from its
+     upstream.
+     */
+    BOOLEAN UpstreamMatches;
+
+    /**
+     TRUE if any tracked file appears to differ from the index.
+     */
+    BOOLEAN Modified;
+
+} YORI_LIB_GIT_STATUS, *PYORI_LIB_GIT_STATUS;
+
+VOID
+YoriLibGitFreeStatus(
+    __inout PYORI_LIB_GIT_STATUS Status
+    );
+
+BOOLEAN
+YoriLibGitStatusCacheEnable(VOID);
+
+VOID
+YoriLibGitStatusCacheCleanup(VOID);
+
+__success(return)
+BOOLEAN
+YoriLibGitGetStatus(
+    __in PCYORI_STRING Directory,
+    __out PYORI_LIB_GIT_STATUS Status
+    );
+
+__success(return)
+BOOLEAN
+YoriLibGitEnumerateBranches(
+    __in PCYORI_STRING Directory,
+    __inout PYORI_STRING_ARRAY Branches
+    );
+
 // *** GROUP.C ***
 
 __success(return)
@@ -2636,6 +3540,11 @@ YoriLibHashString32(
     __in PCYORI_STRING String
     );
 
+DWORD
+YoriLibHashKey(
+    __in PCYORI_STRING String
+    );
+
 PYORI_HASH_TABLE
 YoriLibAllocateHashTable(
     __in YORI_ALLOC_SIZE_T NumberBuckets
@@ -2646,6 +3555,15 @@ YoriLibFreeEmptyHashTable(
     __in PYORI_HASH_TABLE HashTable
     );
 
+VOID
+YoriLibHashInsertByKeyWithHash(
+    __in PYORI_HASH_TABLE HashTable,
+    __in PYORI_STRING KeyString,
+    __in DWORD Hash,
+    __in PVOID Context,
+    __out PYORI_HASH_ENTRY HashEntry
+    );
+
 VOID
 YoriLibHashInsertByKey(
     __in PYORI_HASH_TABLE HashTable,
@@ -2654,17 +3572,37 @@ YoriLibHashInsertByKey(
     __out PYORI_HASH_ENTRY HashEntry
     );
 
+PYORI_HASH_ENTRY
+YoriLibHashLookupByKeyWithHash(
+    __in PYORI_HASH_TABLE HashTable,
+    __in PCYORI_STRING KeyString,
+    __in DWORD Hash
+    );
+
 PYORI_HASH_ENTRY
 YoriLibHashLookupByKey(
     __in PYORI_HASH_TABLE HashTable,
     __in PCYORI_STRING KeyString
     );
 
+PYORI_HASH_ENTRY
+YoriLibHashGetNextEntry(
+    __in PYORI_HASH_TABLE HashTable,
+    __in_opt PYORI_HASH_ENTRY PreviousEntry
+    );
+
 VOID
 YoriLibHashRemoveByEntry(
     __in PYORI_HASH_ENTRY HashEntry
     );
 
+PYORI_HASH_ENTRY
+YoriLibHashRemoveByKeyWithHash(
+    __in PYORI_HASH_TABLE HashTable,
+    __in PCYORI_STRING KeyString,
+    __in DWORD Hash
+    );
+
 PYORI_HASH_ENTRY
 YoriLibHashRemoveByKey(
     __in PYORI_HASH_TABLE HashTable,
@@ -2839,7 +3777,7 @@ YoriLibGetMbyteOutputSizeNeeded(
     __in YORI_ALLOC_SIZE_T BufferLength
     );
 
-VOID
+YORI_ALLOC_SIZE_T
 YoriLibMultibyteOutput(
     __in_ecount(InputBufferLength) LPCTSTR InputStringBuffer,
     __in YORI_ALLOC_SIZE_T InputBufferLength,
@@ -2853,7 +3791,7 @@ YoriLibGetMultibyteInputSizeNeeded(
     __in YORI_ALLOC_SIZE_T BufferLength
     );
 
-VOID
+YORI_ALLOC_SIZE_T
 YoriLibMultibyteInput(
     __in_ecount(InputBufferLength) LPCSTR InputStringBuffer,
     __in YORI_ALLOC_SIZE_T InputBufferLength,
@@ -2861,8 +3799,220 @@ YoriLibMultibyteInput(
     __in YORI_ALLOC_SIZE_T OutputBufferLength
     );
 
+// *** INI.C ***
+
+/**
+ An INI file which has been loaded into memory.
+ */
+typedef struct _YORI_LIB_INI {
+
+    /**
+     The name of the INI file on disk.
+     */
+    YORI_STRING FileName;
+
+    /**
+     The list of sections within the INI file, in the order they are found
+     in the file.
+     */
+    YORI_LIST_ENTRY SectionList;
+
+    /**
+     A hash table of the sections within the INI file.
+     */
+    PYORI_HASH_TABLE SectionHash;
+
+    /**
+     TRUE if the INI file is stored as UTF-16.  FALSE if it is stored in
+     the ANSI code page.
+     */
+    BOOLEAN Unicode;
+
+    /**
+     TRUE if the INI file has been modified in memory and has not been
+     written back to disk.
+     */
+    BOOLEAN Dirty;
+
+} YORI_LIB_INI, *PYORI_LIB_INI;
+
+VOID
+YoriLibIniInitialize(
+    __out PYORI_LIB_INI Ini
+    );
+
+VOID
+YoriLibIniCleanup(
+    __inout PYORI_LIB_INI Ini
+    );
+
+__success(return)
+BOOL
+YoriLibIniLoad(
+    __out PYORI_LIB_INI Ini,
+    __in PCYORI_STRING FileName
+    );
+
+DWORD
+YoriLibIniGetString(
+    __in PYORI_LIB_INI Ini,
+    __in LPCTSTR SectionName,
+    __in LPCTSTR KeyName,
+    __in_opt LPCTSTR Default,
+    __out_ecount(BufferLength) LPTSTR Buffer,
+    __in DWORD BufferLength
+    );
+
+UINT
+YoriLibIniGetInt(
+    __in PYORI_LIB_INI Ini,
+    __in LPCTSTR SectionName,
+    __in LPCTSTR KeyName,
+    __in INT Default
+    );
+
+DWORD
+YoriLibIniGetSection(
+    __in PYORI_LIB_INI Ini,
+    __in LPCTSTR SectionName,
+    __out_ecount(BufferLength) LPTSTR Buffer,
+    __in DWORD BufferLength
+    );
+
+__success(return)
+BOOL
+YoriLibIniSetString(
+    __in PYORI_LIB_INI Ini,
+    __in LPCTSTR SectionName,
+    __in_opt LPCTSTR KeyName,
+    __in_opt LPCTSTR Value
+    );
+
+__success(return)
+BOOL
+YoriLibIniFlush(
+    __in PYORI_LIB_INI Ini
+    );
+
 // *** JOBOBJ.C ***
 
+/**
+ The resources consumed by all processes within a job object.
+ */
+typedef struct _YORI_LIB_JOB_ACCOUNTING {
+
+    /**
+     The total amount of user mode processing consumed by the job, in 100ns
+     units.
+     */
+    LARGE_INTEGER TotalUserTime;
+
+    /**
+     The total amount of kernel mode processing consumed by the job, in 100ns
+     units.
+     */
+    LARGE_INTEGER TotalKernelTime;
+
+    /**
+     The IO performed by all processes in the job.
+     */
+    YORI_IO_COUNTERS IoCounters;
+
+    /**
+     The largest amount of memory committed by any single process in the
+     job, in bytes.
+     */
+    DWORDLONG PeakProcessCommit;
+
+    /**
+     The largest amount of memory committed by all processes in the job at
+     one time, in bytes.
+     */
+    DWORDLONG PeakJobCommit;
+
+    /**
+     The total number of page faults incurred by processes in the job.
+     */
+    DWORD TotalPageFaultCount;
+
+    /**
+     The total number of processes that have been part of the job.
+     */
+    DWORD TotalProcesses;
+
+    /**
+     The number of processes currently executing in the job.
+     */
+    DWORD ActiveProcesses;
+} YORI_LIB_JOB_ACCOUNTING, *PYORI_LIB_JOB_ACCOUNTING;
+
+/**
+ A value for an I/O or memory priority indicating the priority should not be
+ changed.
+ */
+#define YORI_LIB_PRIORITY_UNCHANGED ((DWORD)-1)
+
+/**
+ An I/O priority for processes which should only perform I/O when the system
+ is otherwise idle.
+ */
+#define YORI_LIB_IO_PRIORITY_VERY_LOW (0)
+
+/**
+ An I/O priority for background processes.
+ */
+#define YORI_LIB_IO_PRIORITY_LOW      (1)
+
+/**
+ The I/O priority for ordinary processes.
+ */
+#define YORI_LIB_IO_PRIORITY_NORMAL   (2)
+
+/**
+ A memory priority for processes whose pages should be the first removed
+ from memory when the system needs memory.
+ */
+#define YORI_LIB_MEMORY_PRIORITY_VERY_LOW (1)
+
+/**
+ A memory priority for background processes.
+ */
+#define YORI_LIB_MEMORY_PRIORITY_LOW      (2)
+
+/**
+ The memory priority for ordinary processes.
+ */
+#define YORI_LIB_MEMORY_PRIORITY_NORMAL   (5)
+
+/**
+ Limits to apply to a child process so that it has less effect on other work
+ on the system.
+ */
+typedef struct _YORI_LIB_PROCESS_LIMITS {
+
+    /**
+     The priority class that processes in the job should run at, or zero to
+     leave it unchanged.
+     */
+    DWORD PriorityClass;
+
+    /**
+     The percentage of total processor time that processes in the job can
+     consume, or zero for no limit.
+     */
+    DWORD CpuRate;
+
+    /**
+     The I/O priority for the process, or YORI_LIB_PRIORITY_UNCHANGED.
+     */
+    DWORD IoPriority;
+
+    /**
+     The memory priority for the process, or YORI_LIB_PRIORITY_UNCHANGED.
+     */
+    DWORD MemoryPriority;
+} YORI_LIB_PROCESS_LIMITS, *PYORI_LIB_PROCESS_LIMITS;
+
 HANDLE
 YoriLibCreateJobObject(VOID);
 
@@ -2878,6 +4028,89 @@ YoriLibLimitJobObjectPriority(
     __in DWORD Priority
     );
 
+BOOL
+YoriLibLimitJobObjectKillOnClose(
+    __in HANDLE hJob
+    );
+
+__success(return)
+BOOL
+YoriLibQueryJobObjectAccounting(
+    __in HANDLE hJob,
+    __out PYORI_LIB_JOB_ACCOUNTING Accounting
+    );
+
+BOOL
+YoriLibLimitJobObjectCpuRate(
+    __in HANDLE hJob,
+    __in DWORD CpuRate
+    );
+
+HANDLE
+YoriLibCreateJobObjectCompletionPort(
+    __in HANDLE hJob
+    );
+
+BOOL
+YoriLibSetProcessIoPriority(
+    __in HANDLE hProcess,
+    __in DWORD IoPriority
+    );
+
+BOOL
+YoriLibSetProcessMemoryPriority(
+    __in HANDLE hProcess,
+    __in DWORD MemoryPriority
+    );
+
+VOID
+YoriLibInitializeProcessLimits(
+    __out PYORI_LIB_PROCESS_LIMITS Limits
+    );
+
+__success(return)
+BOOLEAN
+YoriLibParseProcessLimitArgument(
+    __in PYORI_STRING Arg,
+    __in YORI_ALLOC_SIZE_T ArgC,
+    __in YORI_STRING ArgV[],
+    __in YORI_ALLOC_SIZE_T Index,
+    __inout PYORI_LIB_PROCESS_LIMITS Limits,
+    __out PYORI_ALLOC_SIZE_T ArgsConsumed
+    );
+
+BOOL
+YoriLibApplyProcessLimits(
+    __in HANDLE hProcess,
+    __in_opt HANDLE hJob,
+    __in PYORI_LIB_PROCESS_LIMITS Limits
+    );
+
+// *** JOBSRV.C ***
+
+HANDLE
+YoriLibCreateJobServer(
+    __in DWORD TokenCount
+    );
+
+HANDLE
+YoriLibOpenJobServer(VOID);
+
+HANDLE
+YoriLibOpenOrCreateJobServer(
+    __in DWORD NumberProcesses
+    );
+
+BOOLEAN
+YoriLibTryAcquireJobServerToken(
+    __in HANDLE hJobServer
+    );
+
+VOID
+YoriLibReleaseJobServerToken(
+    __in HANDLE hJobServer
+    );
+
 // *** LICENSE.C ***
 
 BOOL
@@ -2908,6 +4141,12 @@ typedef enum _YORI_LIB_LINE_ENDING {
  */
 typedef YORI_LIB_LINE_ENDING *PYORI_LIB_LINE_ENDING;
 
+UCHAR
+YoriLibBytesInBom(
+    __in PUCHAR StringToCheck,
+    __in DWORD BytesInString
+    );
+
 PVOID
 YoriLibReadLineToString(
     __in PYORI_STRING UserString,
@@ -2926,6 +4165,27 @@ YoriLibReadLineToStringEx(
     __out PBOOL TimeoutReached
     );
 
+__success(return)
+BOOL
+YoriLibReadLineToView(
+    __out PYORI_STRING View,
+    __inout PVOID * Context,
+    __in HANDLE FileHandle
+    );
+
+HANDLE
+YoriLibLineReadGetChangeNotification(
+    __in_opt PVOID Context,
+    __in HANDLE FileHandle
+    );
+
+BOOL
+YoriLibLineReadWaitForMore(
+    __in_opt PVOID Context,
+    __in HANDLE FileHandle,
+    __in_opt HANDLE AdditionalEvent
+    );
+
 VOID
 YoriLibLineReadClose(
     __in_opt PVOID Context
@@ -3036,6 +4296,15 @@ YoriLibFree(
 VOID
 YoriLibDisplayMemoryUsage(VOID);
 
+__success(return)
+BOOL
+YoriLibIsAllocationProfileEnabled(VOID);
+
+VOID
+YoriLibDisplayAllocationProfile(
+    __in DWORD MaximumEntries
+    );
+
 
 VOID
 YoriLibReference(
@@ -3065,6 +4334,106 @@ YoriLibIsAllocationExtendable(
     __in YORI_ALLOC_SIZE_T DesiredExtraSize
     );
 
+// *** MALLPOOL.C ***
+
+/**
+ A set of allocations with a common lifetime which are released together.
+ */
+typedef struct _YORI_LIB_ARENA {
+
+    /**
+     The list of chunks allocated from the heap to service the arena.
+     */
+    YORI_LIST_ENTRY ChunkList;
+
+    /**
+     The list of arenas which are currently initialized, used to display
+     statistics.
+     */
+    YORI_LIST_ENTRY ArenaListEntry;
+
+    /**
+     A constant string describing the arena.
+     */
+    LPCSTR Name;
+
+    /**
+     The next unused byte within the current chunk.
+     */
+    PUCHAR Next;
+
+    /**
+     The number of unused bytes within the current chunk.
+     */
+    YORI_ALLOC_SIZE_T BytesRemaining;
+
+    /**
+     The number of bytes to allocate from the heap at a time.
+     */
+    YORI_ALLOC_SIZE_T ChunkSize;
+
+    /**
+     The number of chunks currently allocated.
+     */
+    DWORD ChunkCount;
+
+    /**
+     The number of allocations made from the arena.
+     */
+    DWORDLONG Allocations;
+
+    /**
+     The number of bytes currently allocated from the arena.
+     */
+    DWORDLONG BytesAllocated;
+
+    /**
+     The largest number of bytes allocated from the arena at any time.
+     */
+    DWORDLONG PeakBytesAllocated;
+} YORI_LIB_ARENA, *PYORI_LIB_ARENA;
+
+__success(return)
+BOOL
+YoriLibPoolEnable(VOID);
+
+PVOID
+YoriLibPoolMalloc(
+    __in YORI_ALLOC_SIZE_T Bytes
+    );
+
+__success(return)
+BOOL
+YoriLibPoolFree(
+    __in PVOID Ptr
+    );
+
+VOID
+YoriLibPoolDisplayStatistics(VOID);
+
+VOID
+YoriLibArenaInitialize(
+    __out PYORI_LIB_ARENA Arena,
+    __in LPCSTR Name,
+    __in YORI_ALLOC_SIZE_T ChunkSize
+    );
+
+PVOID
+YoriLibArenaAlloc(
+    __inout PYORI_LIB_ARENA Arena,
+    __in YORI_ALLOC_SIZE_T Bytes
+    );
+
+VOID
+YoriLibArenaReset(
+    __inout PYORI_LIB_ARENA Arena
+    );
+
+VOID
+YoriLibArenaCleanup(
+    __inout PYORI_LIB_ARENA Arena
+    );
+
 // *** MOVEFILE.C ***
 
 DWORD
@@ -3081,6 +4450,202 @@ YoriLibCopyFile(
     __in PYORI_STRING DestFile
     );
 
+DWORD
+YoriLibCloneFile(
+    __in PYORI_STRING SourceFile,
+    __in PYORI_STRING DestFile
+    );
+
+// *** NTFSSCAN.C ***
+
+/**
+ Set on a scan record that describes an allocated file or directory.
+ */
+#define YORILIB_NTFS_SCAN_RECORD_IN_USE          0x0001
+
+/**
+ Set on a scan record that describes a directory.
+ */
+#define YORILIB_NTFS_SCAN_RECORD_DIRECTORY       0x0002
+
+/**
+ Set on a scan record that describes a reparse point.
+ */
+#define YORILIB_NTFS_SCAN_RECORD_REPARSE         0x0004
+
+/**
+ Set on a scan record whose contents are provided by a WIM via WOF.
+ */
+#define YORILIB_NTFS_SCAN_RECORD_WIM_BACKED      0x0008
+
+/**
+ Set on a scan record whose contents are compressed by WOF.
+ */
+#define YORILIB_NTFS_SCAN_RECORD_WOF_COMPRESSED  0x0010
+
+/**
+ A link index indicating there are no further links.
+ */
+#define YORILIB_NTFS_SCAN_NO_LINK                ((DWORD)-1)
+
+/**
+ Information about a single file or directory found by scanning an NTFS
+ volume.  These are indexed by the file's record number, which is the low
+ part of its file ID.
+ */
+typedef struct _YORILIB_NTFS_SCAN_RECORD {
+
+    /**
+     The logical size of the file's default stream.
+     */
+    LONGLONG FileSize;
+
+    /**
+     The size of the file's default stream that GetCompressedFileSize would
+     return, which is the allocated size for compressed or sparse files.
+     */
+    LONGLONG CompressedSize;
+
+    /**
+     The sum of the logical sizes of the file's named streams.
+     */
+    LONGLONG NamedStreamSize;
+
+    /**
+     The sum of the sizes of the file's named streams, with each stream
+     rounded up to the volume's cluster size.
+     */
+    LONGLONG NamedStreamAllocatedSize;
+
+    /**
+     The index of the first link naming this file, or
+     YORILIB_NTFS_SCAN_NO_LINK if the file has no names.
+     */
+    DWORD FirstLink;
+
+    /**
+     The number of links naming this file, excluding short names.
+     */
+    WORD LinkCount;
+
+    /**
+     YORILIB_NTFS_SCAN_RECORD_* flags.
+     */
+    WORD Flags;
+} YORILIB_NTFS_SCAN_RECORD, *PYORILIB_NTFS_SCAN_RECORD;
+
+/**
+ A single name of a file within a parent directory found by scanning an
+ NTFS volume.
+ */
+typedef struct _YORILIB_NTFS_SCAN_LINK {
+
+    /**
+     The record number of the parent directory.
+     */
+    DWORD ParentIndex;
+
+    /**
+     The record number of the file that this link names.
+     */
+    DWORD ChildIndex;
+
+    /**
+     The index of the next link naming the same file, or
+     YORILIB_NTFS_SCAN_NO_LINK.
+     */
+    DWORD NextLink;
+
+    /**
+     The offset in characters of the name within the scan's Names buffer.
+     Names are only retained for directories.
+     */
+    DWORD NameOffset;
+
+    /**
+     The length of the name, in characters.  Zero for links to files which
+     are not directories.
+     */
+    DWORD NameLength;
+} YORILIB_NTFS_SCAN_LINK, *PYORILIB_NTFS_SCAN_LINK;
+
+/**
+ The results of scanning an NTFS volume.
+ */
+typedef struct _YORILIB_NTFS_SCAN {
+
+    /**
+     An array of records, indexed by record number.
+     */
+    PYORILIB_NTFS_SCAN_RECORD Records;
+
+    /**
+     An array of links between files and their parent directories.
+     */
+    PYORILIB_NTFS_SCAN_LINK Links;
+
+    /**
+     A buffer containing the names of directories, referenced by links.
+     These are not NULL terminated.
+     */
+    LPWSTR Names;
+
+    /**
+     The number of elements in the Records array.
+     */
+    DWORD RecordCount;
+
+    /**
+     The number of populated elements in the Links array.
+     */
+    DWORD LinkCount;
+
+    /**
+     The number of allocated elements in the Links array.
+     */
+    DWORD LinksAllocated;
+
+    /**
+     The number of characters populated in the Names buffer.
+     */
+    DWORD NamesLength;
+
+    /**
+     The number of characters allocated in the Names buffer.
+     */
+    DWORD NamesAllocated;
+
+    /**
+     The number of bytes in each cluster on the volume.
+     */
+    DWORD BytesPerCluster;
+
+    /**
+     The number of bytes in each file record on the volume.
+     */
+    DWORD BytesPerRecord;
+} YORILIB_NTFS_SCAN, *PYORILIB_NTFS_SCAN;
+
+VOID
+YoriLibNtfsScanCleanup(
+    __inout PYORILIB_NTFS_SCAN Scan
+    );
+
+__success(return)
+BOOL
+YoriLibNtfsScanVolume(
+    __in PYORI_STRING VolumeName,
+    __out PYORILIB_NTFS_SCAN Scan
+    );
+
+__success(return)
+BOOL
+YoriLibNtfsScanFindRecordForPath(
+    __in PYORILIB_NTFS_SCAN Scan,
+    __in PYORI_STRING FullPath,
+    __out PDWORD RecordIndex
+    );
+
 // *** NUMKEY.C ***
 
 /**
@@ -3116,6 +4681,12 @@ YoriLibTranslateNumericKeyToChar(
 
 // *** OBENUM.C ***
 
+/**
+ Indicates any child directories should be traversed after returning all
+ results from a given directory.
+ */
+#define YORILIB_OBJENUM_RECURSE_AFTER_RETURN     0x00000001
+
 /**
  A definition for a callback function to invoke for each object enumerated in
  an object manager directory.
@@ -3260,8 +4831,255 @@ YoriLibLocateExecutableInPath(
     __out _When_(MatchAllCallback != NULL, _Post_invalid_) PYORI_STRING PathName
     );
 
+// *** PATHCACH.C ***
+
+BOOLEAN
+YoriLibPathCacheEnable(VOID);
+
+PVOID
+YoriLibPathCacheAcquireDirectory(
+    __in PYORI_STRING DirName
+    );
+
+VOID
+YoriLibPathCacheReleaseDirectory(
+    __in PVOID Context
+    );
+
+__success(return)
+BOOLEAN
+YoriLibPathCacheFindFile(
+    __in PVOID Context,
+    __in PYORI_STRING BaseName,
+    __in PYORI_STRING Extension,
+    __out PWIN32_FIND_DATA FindData
+    );
+
+PVOID
+YoriLibPathCacheGetNextFile(
+    __in PVOID Context,
+    __in_opt PVOID PreviousFile,
+    __in PYORI_STRING Prefix,
+    __out PWIN32_FIND_DATA FindData
+    );
+
+__success(return)
+BOOLEAN
+YoriLibPathCacheLookupSubsystem(
+    __in PYORI_STRING FullPath,
+    __out PFILETIME LastWriteTime,
+    __out PBOOLEAN LastWriteTimeValid,
+    __out PWORD Subsystem
+    );
+
+VOID
+YoriLibPathCacheInsertSubsystem(
+    __in PYORI_STRING FullPath,
+    __in PFILETIME LastWriteTime,
+    __in WORD Subsystem
+    );
+
+VOID
+YoriLibPathCacheCleanup(VOID);
+
+// *** PEINFO.C ***
+
+/**
+ Indicates that the architecture, subsystem and subsystem version fields of
+ YORILIB_PE_METADATA were found in the executable's headers.
+ */
+#define YORILIB_PE_METADATA_HEADERS (0x00000001)
+
+/**
+ Indicates that the FileVersion and FileVersionFlags fields of
+ YORILIB_PE_METADATA were found in the executable's version resource.
+ */
+#define YORILIB_PE_METADATA_VERSION (0x00000002)
+
+/**
+ Information about an executable found in its headers and version resource.
+ */
+typedef struct _YORILIB_PE_METADATA {
+
+    /**
+     A combination of YORILIB_PE_METADATA_* flags indicating which fields
+     were found.
+     */
+    DWORD ValidFields;
+
+    /**
+     The machine type of the executable.
+     */
+    WORD Architecture;
+
+    /**
+     The subsystem of the executable.
+     */
+    WORD Subsystem;
+
+    /**
+     The major subsystem version of the executable.
+     */
+    WORD OsVersionHigh;
+
+    /**
+     The minor subsystem version of the executable.
+     */
+    WORD OsVersionLow;
+
+    /**
+     The version of the executable from its version resource.
+     */
+    LARGE_INTEGER FileVersion;
+
+    /**
+     The flags from the executable's version resource.
+     */
+    DWORD FileVersionFlags;
+
+    /**
+     The file description string from the executable's version resource.
+     This is an empty string if the executable has no description.
+     */
+    TCHAR Description[65];
+
+    /**
+     The file version string from the executable's version resource.  This
+     is an empty string if the executable has no version string.
+     */
+    TCHAR FileVersionString[33];
+
+} YORILIB_PE_METADATA, *PYORILIB_PE_METADATA;
+
+BOOLEAN
+YoriLibPeMetadataCacheEnable(VOID);
+
+VOID
+YoriLibPeMetadataCacheCleanup(VOID);
+
+__success(return)
+BOOL
+YoriLibGetPeMetadata(
+    __in PYORI_STRING FullPath,
+    __out PYORILIB_PE_METADATA Metadata
+    );
+
+WORD
+YoriLibPeChecksumSum(
+    __in_bcount(Length) CONST UCHAR * Buffer,
+    __in DWORD Length
+    );
+
+DWORD
+YoriLibPeChecksumBuffer(
+    __in_bcount(Length) CONST UCHAR * Buffer,
+    __in DWORD Length,
+    __out PDWORD HeaderChecksum
+    );
+
+__success(return == ERROR_SUCCESS)
+DWORD
+YoriLibPeChecksumFile(
+    __in PYORI_STRING FullPath,
+    __out PDWORD HeaderChecksum,
+    __out PDWORD DataChecksum
+    );
+
 // *** PRINTF.C ***
 
+/**
+ The element should be left aligned within its field.
+ */
+#define YORI_LIB_PRINTF_LEFT_ALIGN    (0x01)
+
+/**
+ The element should be padded with leading zeroes rather than spaces.
+ */
+#define YORI_LIB_PRINTF_LEADING_ZERO  (0x02)
+
+/**
+ The element has a short (h) size prefix.
+ */
+#define YORI_LIB_PRINTF_SHORT         (0x04)
+
+/**
+ The element has a long (l) size prefix.
+ */
+#define YORI_LIB_PRINTF_LONG          (0x08)
+
+/**
+ The element has a long long (ll) size prefix.
+ */
+#define YORI_LIB_PRINTF_LONGLONG      (0x10)
+
+/**
+ A single parsed element of a printf format string.  This is either a run of
+ literal text or a single format specifier.
+ */
+typedef struct _YORI_LIB_PRINTF_ELEMENT {
+
+    /**
+     The offset within the format string of literal text.  Only meaningful
+     if Conversion is zero.
+     */
+    YORI_ALLOC_SIZE_T LiteralOffset;
+
+    /**
+     The number of characters of literal text.  Only meaningful if
+     Conversion is zero.
+     */
+    YORI_ALLOC_SIZE_T LiteralLength;
+
+    /**
+     The field width of the specifier, or -1 if no width was specified.
+     */
+    YORI_ALLOC_SIZE_T Width;
+
+    /**
+     The conversion character of the specifier, for example 'i' or 'y', or
+     zero if this element is literal text.
+     */
+    UCHAR Conversion;
+
+    /**
+     A combination of YORI_LIB_PRINTF_* flags describing the specifier.
+     */
+    UCHAR Flags;
+} YORI_LIB_PRINTF_ELEMENT;
+
+/**
+ Pointer to a parsed element of a printf format string.
+ */
+typedef YORI_LIB_PRINTF_ELEMENT *PYORI_LIB_PRINTF_ELEMENT;
+
+/**
+ A printf format string that has been parsed once so that it can be used to
+ format many rows without parsing it again.
+ */
+typedef struct _YORI_LIB_PRINTF_FORMAT {
+
+    /**
+     The format string.  This is not copied, so it must remain valid for as
+     long as the compiled format is used.
+     */
+    LPCTSTR Format;
+
+    /**
+     The number of elements in the Elements array.
+     */
+    YORI_ALLOC_SIZE_T ElementCount;
+
+    /**
+     An array of parsed elements that make up the format string.
+     */
+    PYORI_LIB_PRINTF_ELEMENT Elements;
+} YORI_LIB_PRINTF_FORMAT;
+
+/**
+ Pointer to a compiled printf format string.
+ */
+typedef YORI_LIB_PRINTF_FORMAT *PYORI_LIB_PRINTF_FORMAT;
+
 YORI_SIGNED_ALLOC_SIZE_T
 YoriLibSPrintf(
     __out LPTSTR szDest,
@@ -3342,9 +5160,71 @@ YoriLibVSPrintf(
 
 __success(return >= 0)
 YORI_SIGNED_ALLOC_SIZE_T
-YoriLibYPrintf(
+YoriLibYPrintf(
+    __inout PYORI_STRING Dest,
+    __in LPCTSTR szFmt,
+    ...
+    );
+
+/**
+ Process a compiled printf format and determine the size of a buffer that
+ would be required to contain the result.
+
+ @param Format The compiled format to process.
+
+ @param marker The existing va_args context to use to find variables to 
+        substitute in the format string.
+
+ @return The number of characters that the buffer would require, or -1 on
+         error.
+ */
+YORI_SIGNED_ALLOC_SIZE_T
+YoriLibVSPrintfCompiledSize(
+    __in PYORI_LIB_PRINTF_FORMAT Format,
+    __in va_list marker
+    );
+
+/**
+ Process a compiled printf format and output the result into a NULL
+ terminated buffer of specified size.
+
+ @param szDest The buffer to populate with the result.
+
+ @param len The number of characters in the buffer.
+
+ @param Format The compiled format to process.
+
+ @param marker The existing va_args context to use to find variables to 
+        substitute in the format string.
+
+ @return The number of characters successfully populated into the buffer, or
+         -1 on error.
+ */
+YORI_SIGNED_ALLOC_SIZE_T
+YoriLibVSPrintfCompiled(
+    __out_ecount(len) LPTSTR szDest,
+    __in YORI_ALLOC_SIZE_T len,
+    __in PYORI_LIB_PRINTF_FORMAT Format,
+    __in va_list marker
+    );
+
+__success(return)
+BOOL
+YoriLibCompilePrintfFormat(
+    __in LPCTSTR szFmt,
+    __out PYORI_LIB_PRINTF_FORMAT Format
+    );
+
+VOID
+YoriLibFreePrintfFormat(
+    __inout PYORI_LIB_PRINTF_FORMAT Format
+    );
+
+__success(return >= 0)
+YORI_SIGNED_ALLOC_SIZE_T
+YoriLibYPrintfCompiled(
     __inout PYORI_STRING Dest,
-    __in LPCTSTR szFmt,
+    __in PYORI_LIB_PRINTF_FORMAT Format,
     ...
     );
 
@@ -3379,6 +5259,13 @@ YoriLibGetSystemProcessList(
     __out PYORI_SYSTEM_PROCESS_INFORMATION *ProcessInfo
     );
 
+__success(return)
+BOOL
+YoriLibRefreshSystemProcessList(
+    __inout PYORI_SYSTEM_PROCESS_INFORMATION *ProcessInfo,
+    __inout PYORI_ALLOC_SIZE_T BufferSize
+    );
+
 __success(return)
 BOOL
 YoriLibGetSystemHandlesList(
@@ -3405,6 +5292,154 @@ YoriLibRecycleBinFile(
     __in PYORI_STRING FilePath
     );
 
+// *** REGEX.C ***
+
+/**
+ The types of state within a compiled regular expression.
+ */
+typedef enum _YORI_LIB_REGEX_STATE_TYPE {
+    YoriLibRegexStateChar = 0,
+    YoriLibRegexStateAny = 1,
+    YoriLibRegexStateClass = 2,
+    YoriLibRegexStateSplit = 3,
+    YoriLibRegexStateEmpty = 4,
+    YoriLibRegexStateBeginLine = 5,
+    YoriLibRegexStateEndLine = 6,
+    YoriLibRegexStateWordBoundary = 7,
+    YoriLibRegexStateNotWordBoundary = 8,
+    YoriLibRegexStateMatch = 9
+} YORI_LIB_REGEX_STATE_TYPE;
+
+/**
+ A single state within a compiled regular expression.
+ */
+typedef struct _YORI_LIB_REGEX_STATE {
+
+    /**
+     The type of the state.
+     */
+    YORI_LIB_REGEX_STATE_TYPE Type;
+
+    /**
+     For a class, TRUE if the state matches characters that are not in the
+     ranges.
+     */
+    BOOLEAN Negate;
+
+    /**
+     For a character, the character to match.  If the expression is case
+     insensitive, this is in upper case.
+     */
+    TCHAR Char;
+
+    /**
+     The state to move to after this one.
+     */
+    YORI_ALLOC_SIZE_T Out;
+
+    /**
+     For a split, the alternate state to move to after this one.
+     */
+    YORI_ALLOC_SIZE_T Out1;
+
+    /**
+     For a class, the index of the first range in the class.
+     */
+    YORI_ALLOC_SIZE_T FirstRange;
+
+    /**
+     For a class, the number of ranges in the class.
+     */
+    YORI_ALLOC_SIZE_T RangeCount;
+} YORI_LIB_REGEX_STATE, *PYORI_LIB_REGEX_STATE;
+
+/**
+ A range of characters within a class in a regular expression.
+ */
+typedef struct _YORI_LIB_REGEX_RANGE {
+
+    /**
+     The lowest character in the range.
+     */
+    TCHAR Low;
+
+    /**
+     The highest character in the range.
+     */
+    TCHAR High;
+} YORI_LIB_REGEX_RANGE, *PYORI_LIB_REGEX_RANGE;
+
+/**
+ A compiled regular expression.
+ */
+typedef struct _YORI_LIB_REGEX {
+
+    /**
+     An array of states.
+     */
+    PYORI_LIB_REGEX_STATE States;
+
+    /**
+     An array of ranges referenced by class states.
+     */
+    PYORI_LIB_REGEX_RANGE Ranges;
+
+    /**
+     The number of elements in States.
+     */
+    YORI_ALLOC_SIZE_T StateCount;
+
+    /**
+     The number of elements in Ranges.
+     */
+    YORI_ALLOC_SIZE_T RangeCount;
+
+    /**
+     The state to begin matching from.
+     */
+    YORI_ALLOC_SIZE_T StartState;
+
+    /**
+     TRUE if the expression matches case insensitively.
+     */
+    BOOLEAN Insensitive;
+
+    /**
+     TRUE if every match must begin with FirstChar.
+     */
+    BOOLEAN HasFirstChar;
+
+    /**
+     If HasFirstChar is TRUE, the character that every match begins with.
+     If the expression is case insensitive, this is in upper case.
+     */
+    TCHAR FirstChar;
+} YORI_LIB_REGEX, *PYORI_LIB_REGEX;
+
+VOID
+YoriLibRegexCleanup(
+    __inout PYORI_LIB_REGEX Regex
+    );
+
+__success(return)
+BOOL
+YoriLibRegexCompile(
+    __out PYORI_LIB_REGEX Regex,
+    __in PCYORI_STRING Pattern,
+    __in BOOLEAN Insensitive,
+    __out_opt PYORI_ALLOC_SIZE_T ErrorOffset
+    );
+
+__success(return)
+BOOL
+YoriLibRegexSearch(
+    __in PYORI_LIB_REGEX Regex,
+    __in PCYORI_STRING String,
+    __in YORI_ALLOC_SIZE_T StartOffset,
+    __out PYORI_ALLOC_SIZE_T MatchOffset,
+    __out PYORI_ALLOC_SIZE_T MatchLength
+    );
+
 // *** RSRC.C ***
 
 __success(return)
@@ -3595,7 +5630,7 @@ typedef struct _YORILIB_SELECTION {
 
     /**
      Pointer to a temporary allocation that can be used by
-     YoriLibReadConsoleOutputAttributeForSelection when reading from the
+     YoriLibReadConsoleAttributeRegionForSelection when reading from the
      console before returning only the attribute components.  This is saved
      here to avoid repeated reallocations.
      */
@@ -3776,6 +5811,14 @@ YoriLibCloneString(
     __in PYORI_STRING Src
     );
 
+VOID
+YoriLibCloneSubstring(
+    __out PYORI_STRING Dest,
+    __in PYORI_STRING Src,
+    __in YORI_ALLOC_SIZE_T Offset,
+    __in YORI_ALLOC_SIZE_T Length
+    );
+
 BOOLEAN
 YoriLibCopyString(
     __out PYORI_STRING Dest,
@@ -3973,6 +6016,34 @@ YoriLibFindRightMostCharacter(
     __in TCHAR CharToFind
     );
 
+VOID
+YoriLibSubstringMatcherCleanup(
+    __inout PYORI_LIB_SUBSTRING_MATCHER Matcher
+    );
+
+__success(return)
+BOOL
+YoriLibSubstringMatcherInitialize(
+    __out PYORI_LIB_SUBSTRING_MATCHER Matcher,
+    __in YORI_ALLOC_SIZE_T NumberMatches,
+    __in PYORI_STRING MatchArray,
+    __in BOOLEAN Insensitive
+    );
+
+PYORI_STRING
+YoriLibSubstringMatcherFindFirst(
+    __in PYORI_LIB_SUBSTRING_MATCHER Matcher,
+    __in PCYORI_STRING String,
+    __out_opt PYORI_ALLOC_SIZE_T StringOffsetOfMatch
+    );
+
+PYORI_STRING
+YoriLibSubstringMatcherFindByPriority(
+    __in PYORI_LIB_SUBSTRING_MATCHER Matcher,
+    __in PCYORI_STRING String,
+    __out_opt PYORI_ALLOC_SIZE_T StringOffsetOfMatch
+    );
+
 __success(return)
 BOOL
 YoriLibStringToHexBuffer(
@@ -4029,6 +6100,28 @@ YoriLibSortStringArray(
     __in YORI_ALLOC_SIZE_T Count
     );
 
+/**
+ A prototype for a callback function to compare two strings when sorting.
+ The function returns less than zero if the first string should be sorted
+ before the second, zero if they are equal, and greater than zero if the
+ first string should be sorted after the second.
+ */
+typedef INT YORILIB_STRING_COMPARE_FN(PYORI_STRING Str1, PYORI_STRING Str2, PVOID Context);
+
+/**
+ A pointer to a callback function to compare two strings when sorting.
+ */
+typedef YORILIB_STRING_COMPARE_FN *PYORILIB_STRING_COMPARE_FN;
+
+__success(return)
+BOOL
+YoriLibStableSortStringArray(
+    __in_ecount(Count) PYORI_STRING StringArray,
+    __in YORI_ALLOC_SIZE_T Count,
+    __in PYORILIB_STRING_COMPARE_FN CompareFn,
+    __in_opt PVOID Context
+    );
+
 BOOLEAN
 YoriLibStringConcat(
     __inout PYORI_STRING String,
@@ -4104,6 +6197,31 @@ typedef enum {
     YoriLibUpdErrorMax
 } YORI_LIB_UPDATE_ERROR;
 
+__success(return)
+BOOL
+YoriLibUpdateOpenSession(
+    __in PCYORI_STRING Agent,
+    __out PVOID * Session
+    );
+
+VOID
+YoriLibUpdateCloseSession(
+    __in PVOID Session
+    );
+
+DWORDLONG
+YoriLibUpdateGetSessionBytesReceived(
+    __in PVOID Session
+    );
+
+YORI_LIB_UPDATE_ERROR
+YoriLibUpdateBinaryFromUrlWithSession(
+    __in PVOID Session,
+    __in PCYORI_STRING Url,
+    __in_opt PCYORI_STRING TargetName,
+    __in_opt PSYSTEMTIME IfModifiedSince
+    );
+
 YORI_LIB_UPDATE_ERROR
 YoriLibUpdateBinaryFromUrl(
     __in PCYORI_STRING Url,
@@ -4236,6 +6354,45 @@ YoriLibShellExecuteInstanceToError(
     __in_opt HINSTANCE hInst
     );
 
+// *** VOLSPACE.C ***
+
+BOOLEAN
+YoriLibVolumeSpaceCacheEnable(VOID);
+
+PVOID
+YoriLibVolumeSpaceQuery(
+    __in PCYORI_STRING VolumeName
+    );
+
+__success(return)
+BOOL
+YoriLibVolumeSpaceWait(
+    __in PVOID Handle,
+    __in DWORD Timeout,
+    __out_opt PLARGE_INTEGER BytesAvailable,
+    __out_opt PLARGE_INTEGER TotalBytes,
+    __out_opt PLARGE_INTEGER FreeBytes,
+    __out_opt PDWORD Error
+    );
+
+VOID
+YoriLibVolumeSpaceRelease(
+    __in PVOID Handle
+    );
+
+__success(return)
+BOOL
+YoriLibGetDiskFreeSpaceWithTimeout(
+    __in PCYORI_STRING DirectoryName,
+    __in DWORD Timeout,
+    __out_opt PLARGE_INTEGER BytesAvailable,
+    __out_opt PLARGE_INTEGER TotalBytes,
+    __out_opt PLARGE_INTEGER FreeBytes
+    );
+
+VOID
+YoriLibVolumeSpaceCacheCleanup(VOID);
+
 // *** VT.C ***
 
 /**
@@ -4270,6 +6427,22 @@ YoriLibShellExecuteInstanceToError(
  */
 #define YORI_MAX_VT_ESCAPE_CHARS sizeof("E[0;999;999;1m")
 
+__success(return)
+BOOL
+YoriLibOutputBufferEnable(
+    __in HANDLE hOutput
+    );
+
+BOOL
+YoriLibOutputBufferFlush(
+    __in HANDLE hOutput
+    );
+
+BOOL
+YoriLibOutputBufferDisable(
+    __in HANDLE hOutput
+    );
+
 BOOL
 YoriLibOutputTextToMbyteDev(
     __in HANDLE hOutput,
@@ -4449,6 +6622,30 @@ YoriLibVtSetDefaultColor(
 WORD
 YoriLibVtGetDefaultColor(VOID);
 
+YORI_ALLOC_SIZE_T
+YoriLibVtFindEscape(
+    __in PCYORI_STRING String
+    );
+
+BOOLEAN
+YoriLibVtGetEscapeLength(
+    __in PCYORI_STRING String,
+    __out PYORI_ALLOC_SIZE_T EscapeLength
+    );
+
+__success(return)
+BOOLEAN
+YoriLibVtGetSgrParameters(
+    __in PCYORI_STRING EscapeSequence,
+    __out PYORI_STRING Parameters
+    );
+
+BOOLEAN
+YoriLibVtGetNextSgrCode(
+    __inout PYORI_STRING Parameters,
+    __out PDWORD Code
+    );
+
 BOOL
 YoriLibVtFinalColorFromEsc(
     __in WORD InitialColor,
@@ -4477,6 +6674,140 @@ YoriLibQueryConsoleCapabilities(
     __out_opt PBOOL SupportsAutoLineWrap
     );
 
+// *** WORKQ.C ***
+
+/**
+ A prototype for a function invoked for each item processed by
+ YoriLibProcessItemsInParallel.  This may be invoked on multiple threads
+ concurrently, each with a different item index.
+ */
+typedef VOID YORILIB_PARALLEL_ITEM_FN(PVOID Context, DWORD Index);
+
+/**
+ A pointer to a function invoked for each item processed by
+ YoriLibProcessItemsInParallel.
+ */
+typedef YORILIB_PARALLEL_ITEM_FN *PYORILIB_PARALLEL_ITEM_FN;
+
+VOID
+YoriLibProcessItemsInParallel(
+    __in DWORD ItemCount,
+    __in DWORD ThreadCount,
+    __in PYORILIB_PARALLEL_ITEM_FN ItemFn,
+    __in_opt PVOID Context
+    );
+
+/**
+ Return items from a work queue in the order they were submitted, rather
+ than as soon as each is complete.
+ */
+#define YORILIB_WORK_QUEUE_KEEP_ORDER (0x0001)
+
+/**
+ An item of work submitted to a work queue.  Callers embed this within their
+ own structure describing the work.
+ */
+typedef struct _YORILIB_WORK_ITEM {
+
+    /**
+     The link within the list of items waiting for a worker.
+     */
+    YORI_LIST_ENTRY PendingListEntry;
+
+    /**
+     The link within the list of items not yet returned to the caller.
+     */
+    YORI_LIST_ENTRY OrderListEntry;
+
+    /**
+     Set to TRUE once the item requires no further work.  An item can be
+     submitted already complete so that it is returned in order.
+     */
+    BOOLEAN Complete;
+
+    /**
+     Set to TRUE once the item has been passed to the execute function.
+     Items can be completed without executing if no workers remain.
+     */
+    BOOLEAN Executed;
+
+    /**
+     Set to TRUE if the item is cheap enough that a worker can take several
+     consecutive batchable items from the queue at once.
+     */
+    BOOLEAN Batchable;
+
+} YORILIB_WORK_ITEM, *PYORILIB_WORK_ITEM;
+
+/**
+ An opaque pointer to a queue of work executed by a pool of threads.
+ */
+typedef struct _YORILIB_WORK_QUEUE *PYORILIB_WORK_QUEUE;
+
+/**
+ A prototype for a function invoked on a worker thread to execute an item.
+ This returns FALSE if the worker can execute no further items, in which
+ case the worker exits.  Once no workers remain, items which have not been
+ executed are completed without executing them.
+ */
+typedef BOOLEAN YORILIB_WORK_QUEUE_EXECUTE_FN(PVOID Context, PVOID WorkerContext, PYORILIB_WORK_ITEM Item);
+
+/**
+ A pointer to a function invoked on a worker thread to execute an item.
+ */
+typedef YORILIB_WORK_QUEUE_EXECUTE_FN *PYORILIB_WORK_QUEUE_EXECUTE_FN;
+
+/**
+ A prototype for a function invoked on the thread that owns a work queue
+ when an item is complete.  This function takes ownership of the item.
+ */
+typedef VOID YORILIB_WORK_QUEUE_COMPLETE_FN(PVOID Context, PYORILIB_WORK_ITEM Item);
+
+/**
+ A pointer to a function invoked on the thread that owns a work queue when
+ an item is complete.
+ */
+typedef YORILIB_WORK_QUEUE_COMPLETE_FN *PYORILIB_WORK_QUEUE_COMPLETE_FN;
+
+VOID
+YoriLibWorkQueueInitializeItem(
+    __out PYORILIB_WORK_ITEM Item
+    );
+
+PYORILIB_WORK_QUEUE
+YoriLibWorkQueueCreate(
+    __in DWORD Flags,
+    __in DWORD MaxBatch,
+    __in PYORILIB_WORK_QUEUE_EXECUTE_FN ExecuteFn,
+    __in PYORILIB_WORK_QUEUE_COMPLETE_FN CompleteFn,
+    __in_opt PVOID Context
+    );
+
+__success(return)
+BOOL
+YoriLibWorkQueueAddWorker(
+    __in PYORILIB_WORK_QUEUE Queue,
+    __in_opt PVOID WorkerContext
+    );
+
+VOID
+YoriLibWorkQueueSubmit(
+    __in PYORILIB_WORK_QUEUE Queue,
+    __in PYORILIB_WORK_ITEM Item
+    );
+
+BOOLEAN
+YoriLibWorkQueueComplete(
+    __in PYORILIB_WORK_QUEUE Queue,
+    __in DWORD ItemsToLeaveOutstanding,
+    __in DWORD Timeout
+    );
+
+VOID
+YoriLibWorkQueueDestroy(
+    __in PYORILIB_WORK_QUEUE Queue
+    );
+
 
 // MSFIX Out of order here
 
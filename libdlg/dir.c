@@ -28,6 +28,7 @@
 #include <yorilib.h>
 #include <yoriwin.h>
 #include <yoridlg.h>
+#include "dlgpriv.h"
 
 /**
  A set of well known control IDs so the dialog can manipulate its elements.
@@ -64,6 +65,30 @@ typedef struct _YORI_DLG_DIR_STATE {
      */
     DWORD NumberDirectories;
 
+    /**
+     The enumeration of the current directory which is in progress, or NULL
+     if no enumeration is in progress.
+     */
+    PYORI_DLG_DIR_ENUM ActiveEnum;
+
+    /**
+     The completed enumeration whose results are displayed, or NULL if the
+     results of ActiveEnum are being displayed as they are found.
+     */
+    PYORI_DLG_DIR_ENUM DisplayedEnum;
+
+    /**
+     The number of directories from ActiveEnum which have been added to the
+     directory list.
+     */
+    YORI_ALLOC_SIZE_T DirectoriesDisplayed;
+
+    /**
+     Completed enumerations of directories that have been displayed, so
+     that returning to one can display its contents immediately.
+     */
+    YORI_DLG_DIR_CACHE Cache;
+
 } YORI_DLG_DIR_STATE, *PYORI_DLG_DIR_STATE;
 
 
@@ -445,65 +470,131 @@ YoriDlgDirDirectorySelectionChanged(
 }
 
 /**
- A callback that is invoked when a directory is found that matches a search
- criteria and should be added to the directory list.
+ Display the results of a completed enumeration in the directory list,
+ followed by the drives present on the system.
+
+ @param Dialog Pointer to the dialog window.
+
+ @param Enum Pointer to the completed enumeration.
+ */
+VOID
+YoriDlgDirDisplayResults(
+    __in PYORI_WIN_CTRL_HANDLE Dialog,
+    __in PYORI_DLG_DIR_ENUM Enum
+    )
+{
+    PYORI_WIN_CTRL_HANDLE DirList;
+    PYORI_DLG_DIR_STATE State;
+
+    State = YoriWinGetControlContext(Dialog);
+    DirList = YoriWinFindControlById(Dialog, YoriDlgDirControlDirectoryList);
+    ASSERT(DirList != NULL);
+    __analysis_assume(DirList != NULL);
+
+    YoriDlgDirEnumPopulateList(DirList, &Enum->Directories);
+    State->NumberDirectories = Enum->Directories.Count;
+    YoriDlgDirEnumAddDrivesToList(DirList);
+}
+
+/**
+ Process the completion of the active enumeration.  If the dialog is
+ displaying partial results, or results from the cache which are now stale,
+ the list is repopulated with the sorted results.  The enumeration is then
+ retained in the cache.
+
+ @param Dialog Pointer to the dialog window.
+ */
+VOID
+YoriDlgDirSearchComplete(
+    __in PYORI_WIN_CTRL_HANDLE Dialog
+    )
+{
+    PYORI_DLG_DIR_STATE State;
+    PYORI_DLG_DIR_ENUM Enum;
+
+    State = YoriWinGetControlContext(Dialog);
+    Enum = State->ActiveEnum;
+    State->ActiveEnum = NULL;
 
- @param FilePath Pointer to the file path that was found.
+    YoriDlgDirEnumWaitForCompletion(Enum, INFINITE);
 
- @param FileInfo Information about the directory.  This can be NULL if the
-        file was not found from enumeration, since the file may not be a file
-        system object (ie., it may be a device.)
+    if (State->DisplayedEnum == NULL ||
+        !YoriDlgDirEnumIsEqual(State->DisplayedEnum, Enum)) {
+
+        YoriDlgDirDisplayResults(Dialog, Enum);
+    }
 
- @param Depth Indicates the recursion depth.
+    YoriDlgDirCacheInsert(&State->Cache, Enum);
+    if (State->DisplayedEnum != NULL) {
+        YoriDlgDirEnumDereference(State->DisplayedEnum);
+    }
+    State->DisplayedEnum = Enum;
+}
 
- @param Context Pointer to a the control to add the found directories to.
+/**
+ A callback invoked periodically while a directory is being enumerated.
+ This displays any results found so far, and detects when the enumeration
+ completes.
 
- @return TRUE to continute enumerating, FALSE to abort.
+ @param WindowHandle Handle to the dialog window.
  */
-BOOL 
-YoriDlgDirDirFoundCallback(
-    __in PYORI_STRING FilePath,
-    __in PWIN32_FIND_DATA FileInfo,
-    __in DWORD Depth,
-    __in PVOID Context
+VOID
+YoriDlgDirTimer(
+    __in PYORI_WIN_WINDOW_HANDLE WindowHandle
     )
 {
-    YORI_STRING FileNameOnly;
-    PYORI_STRING_ARRAY StringArray;
+    PYORI_WIN_CTRL_HANDLE Dialog;
+    PYORI_WIN_CTRL_HANDLE DirList;
+    PYORI_DLG_DIR_STATE State;
 
-    UNREFERENCED_PARAMETER(FilePath);
-    UNREFERENCED_PARAMETER(Depth);
+    Dialog = YoriWinGetCtrlFromWindow(WindowHandle);
+    State = YoriWinGetControlContext(Dialog);
 
-    if (FileInfo == NULL) {
-        return TRUE;
+    if (State->ActiveEnum == NULL) {
+        YoriWinSetWindowTimerCallback(WindowHandle, 0, NULL);
+        return;
+    }
+
+    if (YoriDlgDirEnumWaitForCompletion(State->ActiveEnum, 0)) {
+        YoriWinSetWindowTimerCallback(WindowHandle, 0, NULL);
+        YoriDlgDirSearchComplete(Dialog);
+        return;
     }
 
     //
-    //  Don't include "." since it's a no-op
+    //  If results from the cache are displayed, leave them in place until
+    //  the enumeration completes, since they are probably still accurate.
     //
 
-    if (FileInfo->cFileName[0] == '.' && FileInfo->cFileName[1] == '\0') {
-        return TRUE;
+    if (State->DisplayedEnum != NULL) {
+        return;
     }
 
-    StringArray = (PYORI_STRING_ARRAY)Context;
-    YoriLibConstantString(&FileNameOnly, FileInfo->cFileName);
+    DirList = YoriWinFindControlById(Dialog, YoriDlgDirControlDirectoryList);
+    ASSERT(DirList != NULL);
+    __analysis_assume(DirList != NULL);
 
-    YoriStringArrayAddItems(StringArray, &FileNameOnly, 1);
-    return TRUE;
+    YoriDlgDirEnumAddNewItemsToList(State->ActiveEnum, TRUE, DirList, &State->DirectoriesDisplayed);
+    State->NumberDirectories = State->DirectoriesDisplayed;
 }
 
 /**
- Refresh the dialog by searching a specified directory for files and
- subdirectories, populating the UI elements with those items, and updating
- the current directory string within the dialog.
+ Refresh the dialog by searching a specified directory for subdirectories,
+ populating the UI elements with those items, and updating the current
+ directory string within the dialog.
+
+ The search is performed on a background thread.  If it completes quickly
+ the results are displayed immediately; otherwise results are displayed
+ as they are found, and sorted once the search completes.  If the directory
+ was displayed previously, its previous contents are displayed while it is
+ searched again.
 
  @param Dialog Pointer to the dialog window.
 
  @param Directory Pointer to a string containing the directory to search.
 
- @param Wildcard Pointer to a filter string to determine the files to find
-        within the directory.
+ @param Wildcard Pointer to a filter string to determine the directories to
+        find within the directory.
  */
 VOID
 YoriDlgDirRefreshView(
@@ -514,15 +605,10 @@ YoriDlgDirRefreshView(
 {
     YORI_STRING FullDir;
     YORI_STRING UnescapedPath;
-    YORI_STRING SearchString;
+    YORI_STRING FileWildcard;
     PYORI_WIN_CTRL_HANDLE CurDirLabel;
     PYORI_WIN_CTRL_HANDLE DirList;
     PYORI_DLG_DIR_STATE State;
-    YORI_STRING DriveDisplay;
-    TCHAR DriveProbeString[sizeof("A:\\")];
-    TCHAR DriveDisplayString[sizeof("[-A-]")];
-    UINT DriveProbeResult;
-    YORI_STRING_ARRAY NewListItems;
 
     if (!YoriLibUserStringToSingleFilePath(Directory, TRUE, &FullDir)) {
         return;
@@ -548,52 +634,52 @@ YoriDlgDirRefreshView(
     YoriLibFreeStringContents(&State->CurrentDirectory);
     memcpy(&State->CurrentDirectory, &FullDir, sizeof(YORI_STRING));
 
-    YoriLibInitEmptyString(&SearchString);
-
     //
-    //  Populate directory list.  This should match the specified wildcard.
+    //  Abandon any search of the previous directory.  The search thread
+    //  will notice and exit without the dialog waiting for it.
     //
 
-    YoriLibYPrintf(&SearchString, _T("%y\\%y"), &FullDir, Wildcard);
-    if (SearchString.StartOfString == NULL) {
-        return;
+    if (State->ActiveEnum != NULL) {
+        YoriDlgDirEnumCancel(State->ActiveEnum);
+        State->ActiveEnum = NULL;
     }
 
-    YoriWinListClearAllItems(DirList);
-    YoriStringArrayInitialize(&NewListItems);
-    YoriLibForEachFile(&SearchString, YORILIB_FILEENUM_RETURN_DIRECTORIES | YORILIB_FILEENUM_INCLUDE_DOTFILES | YORILIB_FILEENUM_BASIC_EXPANSION, 0, YoriDlgDirDirFoundCallback, NULL, &NewListItems);
-    YoriLibSortStringArray(NewListItems.Items, NewListItems.Count);
-    YoriWinListAddItems(DirList, NewListItems.Items, NewListItems.Count);
-    YoriStringArrayCleanup(&NewListItems);
-    State->NumberDirectories = YoriWinListGetItemCount(DirList);
+    if (State->DisplayedEnum != NULL) {
+        YoriDlgDirEnumDereference(State->DisplayedEnum);
+        State->DisplayedEnum = NULL;
+    }
 
     //
-    //  Add drives to the directory list.
+    //  Only directories matching the wildcard are displayed, so no file
+    //  wildcard is supplied.  If this directory has been displayed before,
+    //  display its previous contents while it is searched again.
     //
 
-    YoriLibInitEmptyString(&DriveDisplay);
-    DriveDisplayString[0] = '[';
-    DriveDisplayString[1] = '-';
-    DriveDisplayString[3] = '-';
-    DriveDisplayString[4] = ']';
-    DriveDisplay.StartOfString = DriveDisplayString;
-    DriveDisplay.LengthInChars = sizeof("[-A-]") - 1;
-
-    DriveProbeString[1] = ':';
-    DriveProbeString[2] = '\\';
-    DriveProbeString[3] = '\0';
-
-    for (DriveProbeString[0] = 'A'; DriveProbeString[0] <= 'Z'; DriveProbeString[0]++) {
-        DriveProbeResult = GetDriveType(DriveProbeString);
-        if (DriveProbeResult != DRIVE_UNKNOWN &&
-            DriveProbeResult != DRIVE_NO_ROOT_DIR) {
-
-            DriveDisplayString[2] = DriveProbeString[0];
-            YoriWinListAddItems(DirList, &DriveDisplay, 1);
-        }
+    YoriLibInitEmptyString(&FileWildcard);
+    State->DisplayedEnum = YoriDlgDirCacheLookup(&State->Cache, &FullDir, &FileWildcard, Wildcard);
+    if (State->DisplayedEnum != NULL) {
+        YoriDlgDirDisplayResults(Dialog, State->DisplayedEnum);
+    } else {
+        YoriWinListClearAllItems(DirList);
+        State->NumberDirectories = 0;
+    }
+    State->DirectoriesDisplayed = 0;
+
+    if (!YoriDlgDirEnumStart(&FullDir, &FileWildcard, Wildcard, &State->ActiveEnum)) {
+        return;
     }
 
-    YoriLibFreeStringContents(&SearchString);
+    //
+    //  Give the search a brief time to complete so that most directories
+    //  are displayed once, in sorted order.  If it takes longer, display
+    //  results periodically as they are found.
+    //
+
+    if (YoriDlgDirEnumWaitForCompletion(State->ActiveEnum, YORI_DLG_DIR_ENUM_SYNC_WAIT) ||
+        !YoriWinSetWindowTimerCallback(YoriWinGetWindowFromWindowCtrl(Dialog), YORI_DLG_DIR_ENUM_REFRESH_INTERVAL, YoriDlgDirTimer)) {
+
+        YoriDlgDirSearchComplete(Dialog);
+    }
 }
 
 /**
@@ -670,6 +756,9 @@ YoriDlgDir(
 
     YoriLibInitEmptyString(&State.CurrentDirectory);
     YoriLibInitEmptyString(&State.FileToReturn);
+    State.ActiveEnum = NULL;
+    State.DisplayedEnum = NULL;
+    ZeroMemory(&State.Cache, sizeof(State.Cache));
     if (!YoriWinCreateWindow(WinMgrHandle, 50, (WORD)(13 + OptionCount), WinMgrSize.X, WinMgrSize.Y, YORI_WIN_WINDOW_STYLE_BORDER_SINGLE | YORI_WIN_WINDOW_STYLE_SHADOW_SOLID, Title, &Parent)) {
         return FALSE;
     }
@@ -847,6 +936,14 @@ YoriDlgDir(
     }
 
     YoriLibFreeStringContents(&State.CurrentDirectory);
+    YoriWinSetWindowTimerCallback(Parent, 0, NULL);
+    if (State.ActiveEnum != NULL) {
+        YoriDlgDirEnumCancel(State.ActiveEnum);
+    }
+    if (State.DisplayedEnum != NULL) {
+        YoriDlgDirEnumDereference(State.DisplayedEnum);
+    }
+    YoriDlgDirCacheCleanup(&State.Cache);
     YoriLibFreeStringContents(&State.FileToReturn);
     YoriWinDestroyWindow(Parent);
     return (BOOLEAN)Result;
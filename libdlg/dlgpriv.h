@@ -0,0 +1,200 @@
+/**
+ * @file libdlg/dlgpriv.h
+ *
+ * Private header for routines shared between dialog boxes
+ *
+ * Copyright (c) 2019-2020 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/**
+ The number of completed directory enumerations that a dialog retains so
+ that returning to a directory can display its contents immediately.
+ */
+#define YORI_DLG_DIR_CACHE_ENTRIES (8)
+
+/**
+ The time in milliseconds to wait for an enumeration to complete before
+ displaying partial results.  Most directories are enumerated within this
+ time, so their contents are displayed once and sorted.
+ */
+#define YORI_DLG_DIR_ENUM_SYNC_WAIT (50)
+
+/**
+ The interval in milliseconds at which a dialog displays further results
+ from an enumeration which is still in progress.
+ */
+#define YORI_DLG_DIR_ENUM_REFRESH_INTERVAL (100)
+
+/**
+ The results of enumerating a directory for a file or directory dialog.  The
+ enumeration is performed on a background thread, which holds a reference
+ to this structure.  A dialog which navigates elsewhere cancels the
+ enumeration and releases its reference without waiting, so a slow
+ directory does not prevent the dialog from responding.
+ */
+typedef struct _YORI_DLG_DIR_ENUM {
+
+    /**
+     The number of references to this structure.  It is freed when this
+     reaches zero.
+     */
+    DWORD ReferenceCount;
+
+    /**
+     Synchronizes access to Files and Directories while the enumeration is
+     in progress.
+     */
+    CRITICAL_SECTION Lock;
+
+    /**
+     The full escaped path to the directory being enumerated.
+     */
+    YORI_STRING Directory;
+
+    /**
+     The wildcard to apply to files.  If empty, files are not enumerated.
+     */
+    YORI_STRING FileWildcard;
+
+    /**
+     The wildcard to apply to directories.
+     */
+    YORI_STRING DirectoryWildcard;
+
+    /**
+     The names of files found.  These are sorted once the enumeration
+     completes.
+     */
+    YORI_STRING_ARRAY Files;
+
+    /**
+     The names of directories found.  These are sorted once the enumeration
+     completes.
+     */
+    YORI_STRING_ARRAY Directories;
+
+    /**
+     Handle to the thread performing the enumeration, or NULL if the
+     enumeration was performed synchronously.
+     */
+    HANDLE Thread;
+
+    /**
+     Set to TRUE to indicate that the thread should stop enumerating because
+     the results are no longer needed.
+     */
+    BOOLEAN Cancelled;
+
+    /**
+     TRUE once the results have been sorted after the enumeration
+     completed.  This is only accessed by the dialog's thread.
+     */
+    BOOLEAN Sorted;
+} YORI_DLG_DIR_ENUM, *PYORI_DLG_DIR_ENUM;
+
+/**
+ A set of completed directory enumerations retained by a dialog.
+ */
+typedef struct _YORI_DLG_DIR_CACHE {
+
+    /**
+     Referenced pointers to completed enumerations, or NULL for unused
+     entries.
+     */
+    PYORI_DLG_DIR_ENUM Entries[YORI_DLG_DIR_CACHE_ENTRIES];
+
+    /**
+     The index of the entry to replace when a new enumeration is added and
+     no entry is unused.
+     */
+    DWORD NextEntry;
+} YORI_DLG_DIR_CACHE, *PYORI_DLG_DIR_CACHE;
+
+VOID
+YoriDlgDirEnumDereference(
+    __in PYORI_DLG_DIR_ENUM Enum
+    );
+
+__success(return)
+BOOLEAN
+YoriDlgDirEnumStart(
+    __in PYORI_STRING Directory,
+    __in PYORI_STRING FileWildcard,
+    __in PYORI_STRING DirectoryWildcard,
+    __out PYORI_DLG_DIR_ENUM *Enum
+    );
+
+VOID
+YoriDlgDirEnumCancel(
+    __in PYORI_DLG_DIR_ENUM Enum
+    );
+
+BOOLEAN
+YoriDlgDirEnumWaitForCompletion(
+    __in PYORI_DLG_DIR_ENUM Enum,
+    __in DWORD Timeout
+    );
+
+VOID
+YoriDlgDirEnumAddNewItemsToList(
+    __in PYORI_DLG_DIR_ENUM Enum,
+    __in BOOLEAN Directories,
+    __in PYORI_WIN_CTRL_HANDLE List,
+    __inout PYORI_ALLOC_SIZE_T ItemsDisplayed
+    );
+
+BOOLEAN
+YoriDlgDirEnumIsEqual(
+    __in PYORI_DLG_DIR_ENUM First,
+    __in PYORI_DLG_DIR_ENUM Second
+    );
+
+VOID
+YoriDlgDirEnumPopulateList(
+    __in PYORI_WIN_CTRL_HANDLE List,
+    __in PYORI_STRING_ARRAY Items
+    );
+
+VOID
+YoriDlgDirEnumAddDrivesToList(
+    __in PYORI_WIN_CTRL_HANDLE List
+    );
+
+PYORI_DLG_DIR_ENUM
+YoriDlgDirCacheLookup(
+    __in PYORI_DLG_DIR_CACHE Cache,
+    __in PYORI_STRING Directory,
+    __in PYORI_STRING FileWildcard,
+    __in PYORI_STRING DirectoryWildcard
+    );
+
+VOID
+YoriDlgDirCacheInsert(
+    __inout PYORI_DLG_DIR_CACHE Cache,
+    __in PYORI_DLG_DIR_ENUM Enum
+    );
+
+VOID
+YoriDlgDirCacheCleanup(
+    __inout PYORI_DLG_DIR_CACHE Cache
+    );
+
+// vim:sw=4:ts=4:et:
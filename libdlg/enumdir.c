@@ -0,0 +1,616 @@
+/**
+ * @file libdlg/enumdir.c
+ *
+ * Yori shell background directory enumeration for file and directory dialogs
+ *
+ * Copyright (c) 2019-2020 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <yoripch.h>
+#include <yorilib.h>
+#include <yoriwin.h>
+#include <yoridlg.h>
+#include "dlgpriv.h"
+
+/**
+ Release a reference on a directory enumeration, freeing it if this is the
+ final reference.
+
+ @param Enum Pointer to the enumeration.
+ */
+VOID
+YoriDlgDirEnumDereference(
+    __in PYORI_DLG_DIR_ENUM Enum
+    )
+{
+    if (InterlockedDecrement((INTERLOCKED_VOLATILE LONG *)&Enum->ReferenceCount) != 0) {
+        return;
+    }
+
+    if (Enum->Thread != NULL) {
+        CloseHandle(Enum->Thread);
+    }
+
+    YoriStringArrayCleanup(&Enum->Files);
+    YoriStringArrayCleanup(&Enum->Directories);
+    YoriLibFreeStringContents(&Enum->Directory);
+    YoriLibFreeStringContents(&Enum->FileWildcard);
+    YoriLibFreeStringContents(&Enum->DirectoryWildcard);
+    DeleteCriticalSection(&Enum->Lock);
+    YoriLibFree(Enum);
+}
+
+/**
+ A callback that is invoked when a file is found that matches a search
+ criteria and should be added to the file list.
+
+ @param FilePath Pointer to the file path that was found.
+
+ @param FileInfo Information about the file.  This can be NULL if the file was
+        not found from enumeration, since the file may not be a file system
+        object (ie., it may be a device.)
+
+ @param Depth Indicates the recursion depth.
+
+ @param Context Pointer to the enumeration to add the found file to.
+
+ @return TRUE to continute enumerating, FALSE to abort.
+ */
+BOOL
+YoriDlgDirEnumFileFoundCallback(
+    __in PYORI_STRING FilePath,
+    __in PWIN32_FIND_DATA FileInfo,
+    __in DWORD Depth,
+    __in PVOID Context
+    )
+{
+    YORI_STRING FileNameOnly;
+    PYORI_DLG_DIR_ENUM Enum;
+
+    UNREFERENCED_PARAMETER(FilePath);
+    UNREFERENCED_PARAMETER(Depth);
+
+    Enum = (PYORI_DLG_DIR_ENUM)Context;
+    if (Enum->Cancelled) {
+        return FALSE;
+    }
+
+    if (FileInfo == NULL) {
+        return TRUE;
+    }
+
+    YoriLibConstantString(&FileNameOnly, FileInfo->cFileName);
+
+    EnterCriticalSection(&Enum->Lock);
+    YoriStringArrayAddItems(&Enum->Files, &FileNameOnly, 1);
+    LeaveCriticalSection(&Enum->Lock);
+    return TRUE;
+}
+
+/**
+ A callback that is invoked when a directory is found that matches a search
+ criteria and should be added to the directory list.
+
+ @param FilePath Pointer to the file path that was found.
+
+ @param FileInfo Information about the directory.  This can be NULL if the
+        file was not found from enumeration, since the file may not be a file
+        system object (ie., it may be a device.)
+
+ @param Depth Indicates the recursion depth.
+
+ @param Context Pointer to the enumeration to add the found directory to.
+
+ @return TRUE to continute enumerating, FALSE to abort.
+ */
+BOOL
+YoriDlgDirEnumDirFoundCallback(
+    __in PYORI_STRING FilePath,
+    __in PWIN32_FIND_DATA FileInfo,
+    __in DWORD Depth,
+    __in PVOID Context
+    )
+{
+    YORI_STRING FileNameOnly;
+    PYORI_DLG_DIR_ENUM Enum;
+
+    UNREFERENCED_PARAMETER(FilePath);
+    UNREFERENCED_PARAMETER(Depth);
+
+    Enum = (PYORI_DLG_DIR_ENUM)Context;
+    if (Enum->Cancelled) {
+        return FALSE;
+    }
+
+    if (FileInfo == NULL) {
+        return TRUE;
+    }
+
+    //
+    //  Don't include "." since it's a no-op
+    //
+
+    if (FileInfo->cFileName[0] == '.' && FileInfo->cFileName[1] == '\0') {
+        return TRUE;
+    }
+
+    YoriLibConstantString(&FileNameOnly, FileInfo->cFileName);
+
+    EnterCriticalSection(&Enum->Lock);
+    YoriStringArrayAddItems(&Enum->Directories, &FileNameOnly, 1);
+    LeaveCriticalSection(&Enum->Lock);
+    return TRUE;
+}
+
+/**
+ Enumerate the files and directories requested by an enumeration.
+
+ @param Enum Pointer to the enumeration.
+ */
+VOID
+YoriDlgDirEnumEnumerate(
+    __in PYORI_DLG_DIR_ENUM Enum
+    )
+{
+    YORI_STRING SearchString;
+
+    YoriLibInitEmptyString(&SearchString);
+
+    if (Enum->FileWildcard.LengthInChars > 0) {
+        YoriLibYPrintf(&SearchString, _T("%y\\%y"), &Enum->Directory, &Enum->FileWildcard);
+        if (SearchString.StartOfString != NULL) {
+            YoriLibForEachFile(&SearchString, YORILIB_FILEENUM_RETURN_FILES | YORILIB_FILEENUM_BASIC_EXPANSION, 0, YoriDlgDirEnumFileFoundCallback, NULL, Enum);
+        }
+    }
+
+    if (!Enum->Cancelled) {
+        YoriLibYPrintf(&SearchString, _T("%y\\%y"), &Enum->Directory, &Enum->DirectoryWildcard);
+        if (SearchString.StartOfString != NULL) {
+            YoriLibForEachFile(&SearchString, YORILIB_FILEENUM_RETURN_DIRECTORIES | YORILIB_FILEENUM_INCLUDE_DOTFILES | YORILIB_FILEENUM_BASIC_EXPANSION, 0, YoriDlgDirEnumDirFoundCallback, NULL, Enum);
+        }
+    }
+
+    YoriLibFreeStringContents(&SearchString);
+}
+
+/**
+ A background thread which enumerates a directory.
+
+ @param Context Pointer to the enumeration.  The thread owns a reference to
+        this which it releases when complete.
+
+ @return Thread exit code, currently always zero.
+ */
+DWORD WINAPI
+YoriDlgDirEnumWorker(
+    __in PVOID Context
+    )
+{
+    PYORI_DLG_DIR_ENUM Enum;
+
+    Enum = (PYORI_DLG_DIR_ENUM)Context;
+    YoriDlgDirEnumEnumerate(Enum);
+    YoriDlgDirEnumDereference(Enum);
+    return 0;
+}
+
+/**
+ Begin enumerating a directory on a background thread.  If a thread cannot
+ be created, the directory is enumerated before this function returns.
+
+ @param Directory Pointer to the full escaped path to the directory.
+
+ @param FileWildcard Pointer to the wildcard to apply to files.  If this is
+        empty, files are not enumerated.
+
+ @param DirectoryWildcard Pointer to the wildcard to apply to directories.
+
+ @param Enum On successful completion, updated to point to a referenced
+        enumeration.  The caller should release this with
+        @ref YoriDlgDirEnumDereference .
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+YoriDlgDirEnumStart(
+    __in PYORI_STRING Directory,
+    __in PYORI_STRING FileWildcard,
+    __in PYORI_STRING DirectoryWildcard,
+    __out PYORI_DLG_DIR_ENUM *Enum
+    )
+{
+    PYORI_DLG_DIR_ENUM NewEnum;
+    DWORD ThreadId;
+
+    NewEnum = YoriLibMalloc(sizeof(YORI_DLG_DIR_ENUM));
+    if (NewEnum == NULL) {
+        return FALSE;
+    }
+
+    ZeroMemory(NewEnum, sizeof(YORI_DLG_DIR_ENUM));
+    NewEnum->ReferenceCount = 1;
+    InitializeCriticalSection(&NewEnum->Lock);
+    YoriStringArrayInitialize(&NewEnum->Files);
+    YoriStringArrayInitialize(&NewEnum->Directories);
+
+    if (!YoriLibCopyString(&NewEnum->Directory, Directory) ||
+        !YoriLibCopyString(&NewEnum->FileWildcard, FileWildcard) ||
+        !YoriLibCopyString(&NewEnum->DirectoryWildcard, DirectoryWildcard)) {
+
+        YoriDlgDirEnumDereference(NewEnum);
+        return FALSE;
+    }
+
+    //
+    //  The thread holds its own reference, so the caller can abandon the
+    //  enumeration without waiting for the thread to notice.
+    //
+
+    NewEnum->ReferenceCount++;
+    NewEnum->Thread = CreateThread(NULL, 0, YoriDlgDirEnumWorker, NewEnum, 0, &ThreadId);
+    if (NewEnum->Thread == NULL) {
+        NewEnum->ReferenceCount--;
+        YoriDlgDirEnumEnumerate(NewEnum);
+    }
+
+    *Enum = NewEnum;
+    return TRUE;
+}
+
+/**
+ Indicate that the results of an enumeration are no longer needed and
+ release the caller's reference to it.  This does not wait for the thread
+ to terminate, since it may be blocked on a slow device.
+
+ @param Enum Pointer to the enumeration.
+ */
+VOID
+YoriDlgDirEnumCancel(
+    __in PYORI_DLG_DIR_ENUM Enum
+    )
+{
+    Enum->Cancelled = TRUE;
+    YoriDlgDirEnumDereference(Enum);
+}
+
+/**
+ Check whether an enumeration has completed.  When it is first found to be
+ complete, its results are sorted.  This is only called from the dialog's
+ thread.
+
+ @param Enum Pointer to the enumeration.
+
+ @param Timeout The maximum time to wait for the enumeration to complete, in
+        milliseconds.
+
+ @return TRUE if the enumeration has completed, FALSE if it has not.
+ */
+BOOLEAN
+YoriDlgDirEnumWaitForCompletion(
+    __in PYORI_DLG_DIR_ENUM Enum,
+    __in DWORD Timeout
+    )
+{
+    if (Enum->Thread != NULL &&
+        WaitForSingleObject(Enum->Thread, Timeout) != WAIT_OBJECT_0) {
+
+        return FALSE;
+    }
+
+    if (!Enum->Sorted) {
+        YoriLibSortStringArray(Enum->Files.Items, Enum->Files.Count);
+        YoriLibSortStringArray(Enum->Directories.Items, Enum->Directories.Count);
+        Enum->Sorted = TRUE;
+    }
+
+    return TRUE;
+}
+
+/**
+ Add any items found by an enumeration in progress which have not yet been
+ displayed to a list control.  These are added in the order they were found,
+ and the list is expected to be repopulated with sorted results once the
+ enumeration completes.
+
+ @param Enum Pointer to the enumeration.
+
+ @param Directories TRUE to add directories, FALSE to add files.
+
+ @param List Pointer to the list control.
+
+ @param ItemsDisplayed On input, specifies the number of items that have
+        been added to the list.  On output, updated to include the items
+        added by this call.
+ */
+VOID
+YoriDlgDirEnumAddNewItemsToList(
+    __in PYORI_DLG_DIR_ENUM Enum,
+    __in BOOLEAN Directories,
+    __in PYORI_WIN_CTRL_HANDLE List,
+    __inout PYORI_ALLOC_SIZE_T ItemsDisplayed
+    )
+{
+    PYORI_STRING_ARRAY Items;
+
+    if (Directories) {
+        Items = &Enum->Directories;
+    } else {
+        Items = &Enum->Files;
+    }
+
+    EnterCriticalSection(&Enum->Lock);
+    if (Items->Count > *ItemsDisplayed) {
+        YoriWinListAddItems(List, &Items->Items[*ItemsDisplayed], Items->Count - *ItemsDisplayed);
+        *ItemsDisplayed = Items->Count;
+    }
+    LeaveCriticalSection(&Enum->Lock);
+}
+
+/**
+ Check whether two string arrays contain the same strings in the same order.
+
+ @param First Pointer to the first array.
+
+ @param Second Pointer to the second array.
+
+ @return TRUE if the arrays are equal, FALSE if they are not.
+ */
+BOOLEAN
+YoriDlgDirEnumIsArrayEqual(
+    __in PYORI_STRING_ARRAY First,
+    __in PYORI_STRING_ARRAY Second
+    )
+{
+    YORI_ALLOC_SIZE_T Index;
+
+    if (First->Count != Second->Count) {
+        return FALSE;
+    }
+
+    for (Index = 0; Index < First->Count; Index++) {
+        if (YoriLibCompareString(&First->Items[Index], &Second->Items[Index]) != 0) {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+/**
+ Check whether two completed enumerations found the same files and
+ directories.  This is used to avoid repopulating a dialog which displayed
+ cached results that are still accurate.
+
+ @param First Pointer to the first enumeration.
+
+ @param Second Pointer to the second enumeration.
+
+ @return TRUE if the enumerations found the same items, FALSE if they did
+         not.
+ */
+BOOLEAN
+YoriDlgDirEnumIsEqual(
+    __in PYORI_DLG_DIR_ENUM First,
+    __in PYORI_DLG_DIR_ENUM Second
+    )
+{
+    if (!YoriDlgDirEnumIsArrayEqual(&First->Files, &Second->Files) ||
+        !YoriDlgDirEnumIsArrayEqual(&First->Directories, &Second->Directories)) {
+
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ Replace the contents of a list control with a set of items.  If the list
+ had an active item which is also in the new set, it remains active.
+
+ @param List Pointer to the list control.
+
+ @param Items Pointer to the items to display.
+ */
+VOID
+YoriDlgDirEnumPopulateList(
+    __in PYORI_WIN_CTRL_HANDLE List,
+    __in PYORI_STRING_ARRAY Items
+    )
+{
+    YORI_STRING ActiveText;
+    YORI_ALLOC_SIZE_T ActiveOption;
+    YORI_ALLOC_SIZE_T Index;
+    BOOLEAN RestoreActive;
+
+    YoriLibInitEmptyString(&ActiveText);
+    RestoreActive = FALSE;
+    if (YoriWinListGetActiveOption(List, &ActiveOption) &&
+        YoriWinListGetItemText(List, ActiveOption, &ActiveText)) {
+
+        RestoreActive = TRUE;
+    }
+
+    YoriWinListClearAllItems(List);
+    YoriWinListAddItems(List, Items->Items, Items->Count);
+
+    if (RestoreActive) {
+        for (Index = 0; Index < Items->Count; Index++) {
+            if (YoriLibCompareString(&Items->Items[Index], &ActiveText) == 0) {
+                YoriWinListSetActiveOption(List, Index);
+                break;
+            }
+        }
+    }
+
+    YoriLibFreeStringContents(&ActiveText);
+}
+
+/**
+ Add the drives present on the system to a directory list control, in the
+ form [-X-].
+
+ @param List Pointer to the list control.
+ */
+VOID
+YoriDlgDirEnumAddDrivesToList(
+    __in PYORI_WIN_CTRL_HANDLE List
+    )
+{
+    YORI_STRING DriveDisplay;
+    TCHAR DriveProbeString[sizeof("A:\\")];
+    TCHAR DriveDisplayString[sizeof("[-A-]")];
+    UINT DriveProbeResult;
+
+    YoriLibInitEmptyString(&DriveDisplay);
+    DriveDisplayString[0] = '[';
+    DriveDisplayString[1] = '-';
+    DriveDisplayString[3] = '-';
+    DriveDisplayString[4] = ']';
+    DriveDisplay.StartOfString = DriveDisplayString;
+    DriveDisplay.LengthInChars = sizeof("[-A-]") - 1;
+
+    DriveProbeString[1] = ':';
+    DriveProbeString[2] = '\\';
+    DriveProbeString[3] = '\0';
+
+    for (DriveProbeString[0] = 'A'; DriveProbeString[0] <= 'Z'; DriveProbeString[0]++) {
+        DriveProbeResult = GetDriveType(DriveProbeString);
+        if (DriveProbeResult != DRIVE_UNKNOWN &&
+            DriveProbeResult != DRIVE_NO_ROOT_DIR) {
+
+            DriveDisplayString[2] = DriveProbeString[0];
+            YoriWinListAddItems(List, &DriveDisplay, 1);
+        }
+    }
+}
+
+/**
+ Find a completed enumeration of a directory in a dialog's cache.
+
+ @param Cache Pointer to the cache.
+
+ @param Directory Pointer to the full escaped path to the directory.
+
+ @param FileWildcard Pointer to the wildcard applied to files.
+
+ @param DirectoryWildcard Pointer to the wildcard applied to directories.
+
+ @return A referenced pointer to the enumeration, which the caller should
+         release with @ref YoriDlgDirEnumDereference , or NULL if the
+         directory is not in the cache.
+ */
+PYORI_DLG_DIR_ENUM
+YoriDlgDirCacheLookup(
+    __in PYORI_DLG_DIR_CACHE Cache,
+    __in PYORI_STRING Directory,
+    __in PYORI_STRING FileWildcard,
+    __in PYORI_STRING DirectoryWildcard
+    )
+{
+    PYORI_DLG_DIR_ENUM Enum;
+    DWORD Index;
+
+    for (Index = 0; Index < YORI_DLG_DIR_CACHE_ENTRIES; Index++) {
+        Enum = Cache->Entries[Index];
+        if (Enum != NULL &&
+            YoriLibCompareStringIns(&Enum->Directory, Directory) == 0 &&
+            YoriLibCompareStringIns(&Enum->FileWildcard, FileWildcard) == 0 &&
+            YoriLibCompareStringIns(&Enum->DirectoryWildcard, DirectoryWildcard) == 0) {
+
+            InterlockedIncrement((INTERLOCKED_VOLATILE LONG *)&Enum->ReferenceCount);
+            return Enum;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ Add a completed enumeration to a dialog's cache, replacing any previous
+ enumeration of the same directory.  If the cache is full, the oldest entry
+ is replaced.
+
+ @param Cache Pointer to the cache.
+
+ @param Enum Pointer to the completed enumeration.  The cache acquires its
+        own reference.
+ */
+VOID
+YoriDlgDirCacheInsert(
+    __inout PYORI_DLG_DIR_CACHE Cache,
+    __in PYORI_DLG_DIR_ENUM Enum
+    )
+{
+    PYORI_DLG_DIR_ENUM Existing;
+    DWORD Index;
+    DWORD FreeIndex;
+
+    FreeIndex = YORI_DLG_DIR_CACHE_ENTRIES;
+    for (Index = 0; Index < YORI_DLG_DIR_CACHE_ENTRIES; Index++) {
+        Existing = Cache->Entries[Index];
+        if (Existing == NULL) {
+            if (FreeIndex == YORI_DLG_DIR_CACHE_ENTRIES) {
+                FreeIndex = Index;
+            }
+        } else if (YoriLibCompareStringIns(&Existing->Directory, &Enum->Directory) == 0 &&
+                   YoriLibCompareStringIns(&Existing->FileWildcard, &Enum->FileWildcard) == 0 &&
+                   YoriLibCompareStringIns(&Existing->DirectoryWildcard, &Enum->DirectoryWildcard) == 0) {
+
+            YoriDlgDirEnumDereference(Existing);
+            Cache->Entries[Index] = NULL;
+            FreeIndex = Index;
+            break;
+        }
+    }
+
+    if (FreeIndex == YORI_DLG_DIR_CACHE_ENTRIES) {
+        FreeIndex = Cache->NextEntry;
+        Cache->NextEntry = (Cache->NextEntry + 1) % YORI_DLG_DIR_CACHE_ENTRIES;
+        YoriDlgDirEnumDereference(Cache->Entries[FreeIndex]);
+    }
+
+    InterlockedIncrement((INTERLOCKED_VOLATILE LONG *)&Enum->ReferenceCount);
+    Cache->Entries[FreeIndex] = Enum;
+}
+
+/**
+ Release all enumerations held by a dialog's cache.
+
+ @param Cache Pointer to the cache.
+ */
+VOID
+YoriDlgDirCacheCleanup(
+    __inout PYORI_DLG_DIR_CACHE Cache
+    )
+{
+    DWORD Index;
+
+    for (Index = 0; Index < YORI_DLG_DIR_CACHE_ENTRIES; Index++) {
+        if (Cache->Entries[Index] != NULL) {
+            YoriDlgDirEnumDereference(Cache->Entries[Index]);
+            Cache->Entries[Index] = NULL;
+        }
+    }
+    Cache->NextEntry = 0;
+}
+
+// vim:sw=4:ts=4:et:
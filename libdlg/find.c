@@ -71,6 +71,11 @@ YoriDlgFindCancelButtonClicked(
         that the search should be case sensitive, or FALSE to indicate the
         search should be case insensitive.
 
+ @param Regex Optionally points to a value which, if present, causes the
+        dialog to offer searching for a regular expression.  On successful
+        completion, populated with TRUE to indicate that the text is a
+        regular expression, or FALSE to indicate it is a literal string.
+
  @param Text On input, specifies an initialized string.  On output, populated
         with the contents of the text that the user entered.
 
@@ -84,6 +89,7 @@ YoriDlgFindText(
     __in PYORI_STRING Title,
     __in PYORI_STRING InitialText,
     __out PBOOLEAN MatchCase,
+    __out_opt PBOOLEAN Regex,
     __inout PYORI_STRING Text
     )
 {
@@ -94,6 +100,7 @@ YoriDlgFindText(
     WORD ButtonWidth;
     PYORI_WIN_CTRL_HANDLE Ctrl;
     PYORI_WIN_CTRL_HANDLE MatchCaseCheckbox;
+    PYORI_WIN_CTRL_HANDLE RegexCheckbox;
     PYORI_WIN_CTRL_HANDLE Edit;
     DWORD_PTR Result;
 
@@ -140,12 +147,30 @@ YoriDlgFindText(
 
     YoriLibConstantString(&Caption, _T("&Match Case"));
 
+    if (Regex != NULL) {
+        Area.Right = (WORD)(Area.Left + Caption.LengthInChars + 4);
+    }
+
     MatchCaseCheckbox = YoriWinCheckboxCreate(Parent, &Area, &Caption, 0, NULL);
     if (MatchCaseCheckbox == NULL) {
         YoriWinDestroyWindow(Parent);
         return FALSE;
     }
 
+    RegexCheckbox = NULL;
+    if (Regex != NULL) {
+        Area.Left = (SHORT)(Area.Right + 3);
+        Area.Right = (WORD)(WindowSize.X - 2);
+
+        YoriLibConstantString(&Caption, _T("Regular e&xpression"));
+
+        RegexCheckbox = YoriWinCheckboxCreate(Parent, &Area, &Caption, 0, NULL);
+        if (RegexCheckbox == NULL) {
+            YoriWinDestroyWindow(Parent);
+            return FALSE;
+        }
+    }
+
     ButtonWidth = (WORD)(8);
 
     Area.Top = (SHORT)(8);
@@ -185,6 +210,9 @@ YoriDlgFindText(
         }
 
         *MatchCase = YoriWinCheckboxIsChecked(MatchCaseCheckbox);
+        if (Regex != NULL) {
+            *Regex = YoriWinCheckboxIsChecked(RegexCheckbox);
+        }
 
         YoriWinDestroyWindow(Parent);
         return TRUE;
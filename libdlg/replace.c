@@ -169,6 +169,11 @@ YoriDlgReplaceGetDialogHeight(
         that the search should be case sensitive, or FALSE to indicate the
         search should be case insensitive.
 
+ @param Regex Optionally points to a value which, if present, causes the
+        dialog to offer searching for a regular expression.  On successful
+        completion, populated with TRUE to indicate that BeforeText is a
+        regular expression, or FALSE to indicate it is a literal string.
+
  @param ReplaceAll On successful completion, populated with TRUE to indicate
         that all instances should be replaced, FALSE if the selected text
         should be replaced if it matches, and if it doesn't, the next match
@@ -197,6 +202,7 @@ YoriDlgReplaceText(
     __in PYORI_STRING InitialBeforeText,
     __in PYORI_STRING InitialAfterText,
     __out PBOOLEAN MatchCase,
+    __out_opt PBOOLEAN Regex,
     __out PBOOLEAN ReplaceAll,
     __inout PYORI_STRING BeforeText,
     __inout PYORI_STRING AfterText
@@ -209,6 +215,7 @@ YoriDlgReplaceText(
     WORD ButtonWidth;
     PYORI_WIN_CTRL_HANDLE Ctrl;
     PYORI_WIN_CTRL_HANDLE MatchCaseCheckbox;
+    PYORI_WIN_CTRL_HANDLE RegexCheckbox;
     PYORI_WIN_CTRL_HANDLE BeforeEdit;
     PYORI_WIN_CTRL_HANDLE AfterEdit;
     DWORD_PTR Result;
@@ -312,12 +319,30 @@ YoriDlgReplaceText(
 
     YoriLibConstantString(&Caption, _T("&Match Case"));
 
+    if (Regex != NULL) {
+        Area.Right = (WORD)(Area.Left + Caption.LengthInChars + 4);
+    }
+
     MatchCaseCheckbox = YoriWinCheckboxCreate(Parent, &Area, &Caption, 0, NULL);
     if (MatchCaseCheckbox == NULL) {
         YoriWinDestroyWindow(Parent);
         return FALSE;
     }
 
+    RegexCheckbox = NULL;
+    if (Regex != NULL) {
+        Area.Left = (SHORT)(Area.Right + 3);
+        Area.Right = (WORD)(WindowSize.X - 2);
+
+        YoriLibConstantString(&Caption, _T("Regular e&xpression"));
+
+        RegexCheckbox = YoriWinCheckboxCreate(Parent, &Area, &Caption, 0, NULL);
+        if (RegexCheckbox == NULL) {
+            YoriWinDestroyWindow(Parent);
+            return FALSE;
+        }
+    }
+
     ButtonWidth = (WORD)(12);
 
     Area.Top = (SHORT)(Area.Bottom + 1);
@@ -382,6 +407,9 @@ YoriDlgReplaceText(
         }
 
         *MatchCase = YoriWinCheckboxIsChecked(MatchCaseCheckbox);
+        if (Regex != NULL) {
+            *Regex = YoriWinCheckboxIsChecked(RegexCheckbox);
+        }
 
         YoriWinDestroyWindow(Parent);
         return TRUE;
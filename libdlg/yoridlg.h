@@ -115,6 +115,7 @@ YoriDlgFindText(
     __in PYORI_STRING Title,
     __in PYORI_STRING InitialText,
     __out PBOOLEAN MatchCase,
+    __out_opt PBOOLEAN Regex,
     __inout PYORI_STRING Text
     );
 
@@ -190,6 +191,7 @@ YoriDlgReplaceText(
     __in PYORI_STRING InitialBeforeText,
     __in PYORI_STRING InitialAfterText,
     __out PBOOLEAN MatchCase,
+    __out_opt PBOOLEAN Regex,
     __out PBOOLEAN ReplaceAll,
     __inout PYORI_STRING BeforeText,
     __inout PYORI_STRING AfterText
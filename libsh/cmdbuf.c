@@ -28,21 +28,105 @@
 #include <yorilib.h>
 #include <yorish.h>
 
+/**
+ The size of the first chunk allocated for a data stream.  Each later chunk
+ is twice the size of the one before it until it reaches
+ YORI_LIBSH_PROCESS_BUFFER_MAX_CHUNK_SIZE.
+ */
+#define YORI_LIBSH_PROCESS_BUFFER_MIN_CHUNK_SIZE (4 * 1024)
+
+/**
+ The largest size of a chunk allocated for a data stream.
+ */
+#define YORI_LIBSH_PROCESS_BUFFER_MAX_CHUNK_SIZE (64 * 1024)
+
+/**
+ The environment variable which specifies the number of megabytes of output
+ from a single stream to retain in memory before older output is moved to a
+ temporary file.  If not set, all output is retained in memory.
+ */
+#define YORI_LIBSH_PROCESS_BUFFER_LIMIT_VAR _T("YORIJOBBUFFERLIMIT")
+
+/**
+ A single chunk of data within a data stream.  Chunks are never moved or
+ resized once allocated, so data is read directly into the chunk from the
+ process and can be written directly from the chunk to any consumer.  The
+ data follows this structure.
+ */
+typedef struct _YORI_LIBSH_PROCESS_BUFFER_CHUNK {
+
+    /**
+     The link into the list of chunks within the buffer.  Paired with
+     YORI_LIBSH_PROCESS_BUFFER::ChunkList.
+     */
+    YORI_LIST_ENTRY ListEntry;
+
+    /**
+     The number of bytes of data that this chunk can contain.
+     */
+    DWORD BytesAllocated;
+
+    /**
+     The number of bytes populated with data in this chunk.
+     */
+    DWORD BytesPopulated;
+
+} YORI_LIBSH_PROCESS_BUFFER_CHUNK, *PYORI_LIBSH_PROCESS_BUFFER_CHUNK;
+
 /**
  A buffer for a single data stream.  A process may have a different buffered
  data stream for stdout as well as stderr.
+
+ The stream consists of any data that has been moved to a temporary file,
+ followed by the data in each chunk in memory.
  */
 typedef struct _YORI_LIBSH_PROCESS_BUFFER {
 
     /**
-     The number of bytes currently allocated to this buffer.
+     The list of chunks in memory, from oldest to newest.
      */
-    YORI_ALLOC_SIZE_T BytesAllocated;
+    YORI_LIST_ENTRY ChunkList;
 
     /**
-     The number of bytes populated with data in this buffer.
+     The total number of bytes of data in the stream, including data that
+     has been moved to the temporary file.
      */
-    YORI_ALLOC_SIZE_T BytesPopulated;
+    DWORDLONG BytesPopulated;
+
+    /**
+     The number of bytes of data at the start of the stream which have been
+     moved to the temporary file.
+     */
+    DWORDLONG BytesSpilled;
+
+    /**
+     The number of bytes allocated to chunks in memory.
+     */
+    DWORDLONG BytesInMemory;
+
+    /**
+     The number of bytes that chunks may occupy in memory before the oldest
+     chunks are moved to the temporary file.  Zero indicates no limit.
+     */
+    DWORDLONG MemoryLimit;
+
+    /**
+     A handle to the temporary file containing the start of the stream, or
+     NULL if no data has been moved to a temporary file.
+     */
+    HANDLE hSpillFile;
+
+    /**
+     The name of the temporary file, so that it can be deleted when the
+     buffer is freed.
+     */
+    YORI_STRING SpillFileName;
+
+    /**
+     A buffer used to read data from the temporary file before sending it
+     to a consumer.  This is allocated on first use.
+     */
+    PCHAR SpillReadBuffer;
 
     /**
      A handle to the buffer processing thread.
@@ -68,12 +152,7 @@ typedef struct _YORI_LIBSH_PROCESS_BUFFER {
     /**
      The number of bytes which have been sent to hMirror.
      */
-    DWORD BytesSent;
-
-    /**
-     The data buffer.
-     */
-    PCHAR Buffer;
+    DWORDLONG BytesSent;
 
 } YORI_LIBSH_PROCESS_BUFFER, *PYORI_LIBSH_PROCESS_BUFFER;
 
@@ -151,8 +230,25 @@ YoriLibShFreeProcessBuffer(
     __in PYORI_LIBSH_PROCESS_BUFFER ThisBuffer
     )
 {
-    if (ThisBuffer->Buffer != NULL) {
-        YoriLibFree(ThisBuffer->Buffer);
+    PYORI_LIBSH_PROCESS_BUFFER_CHUNK Chunk;
+    PYORI_LIST_ENTRY ListEntry;
+
+    if (ThisBuffer->ChunkList.Next != NULL) {
+        ListEntry = YoriLibGetNextListEntry(&ThisBuffer->ChunkList, NULL);
+        while (ListEntry != NULL) {
+            Chunk = CONTAINING_RECORD(ListEntry, YORI_LIBSH_PROCESS_BUFFER_CHUNK, ListEntry);
+            ListEntry = YoriLibGetNextListEntry(&ThisBuffer->ChunkList, ListEntry);
+            YoriLibRemoveListItem(&Chunk->ListEntry);
+            YoriLibFree(Chunk);
+        }
+    }
+    if (ThisBuffer->hSpillFile != NULL) {
+        CloseHandle(ThisBuffer->hSpillFile);
+        DeleteFile(ThisBuffer->SpillFileName.StartOfString);
+    }
+    YoriLibFreeStringContents(&ThisBuffer->SpillFileName);
+    if (ThisBuffer->SpillReadBuffer != NULL) {
+        YoriLibFree(ThisBuffer->SpillReadBuffer);
     }
     if (ThisBuffer->hMirror != NULL) {
         CloseHandle(ThisBuffer->hMirror);
@@ -184,6 +280,294 @@ YoriLibShFreeProcessBuffers(
     YoriLibFree(ThisBuffer);
 }
 
+/**
+ Move the oldest chunk in memory to the temporary file, creating the
+ temporary file if it does not exist yet.  This is called with the buffer
+ mutex held.
+
+ @param ThisBuffer Pointer to the buffer.
+
+ @return TRUE to indicate a chunk was moved, FALSE if it was not.
+ */
+__success(return)
+BOOLEAN
+YoriLibShSpillOldestChunk(
+    __in PYORI_LIBSH_PROCESS_BUFFER ThisBuffer
+    )
+{
+    PYORI_LIBSH_PROCESS_BUFFER_CHUNK Chunk;
+    PYORI_LIST_ENTRY ListEntry;
+    YORI_STRING TempPath;
+    YORI_STRING Prefix;
+    LARGE_INTEGER Offset;
+    DWORD BytesWritten;
+
+    ListEntry = YoriLibGetNextListEntry(&ThisBuffer->ChunkList, NULL);
+    if (ListEntry == NULL) {
+        return FALSE;
+    }
+
+    Chunk = CONTAINING_RECORD(ListEntry, YORI_LIBSH_PROCESS_BUFFER_CHUNK, ListEntry);
+
+    if (ThisBuffer->hSpillFile == NULL) {
+        if (!YoriLibGetTempPath(&TempPath, 0)) {
+            return FALSE;
+        }
+
+        if (TempPath.LengthInChars > 0 &&
+            YoriLibIsSep(TempPath.StartOfString[TempPath.LengthInChars - 1])) {
+
+            TempPath.LengthInChars--;
+            TempPath.StartOfString[TempPath.LengthInChars] = '\0';
+        }
+
+        YoriLibConstantString(&Prefix, _T("yjob"));
+        if (!YoriLibGetTempFileName(&TempPath, &Prefix, &ThisBuffer->hSpillFile, &ThisBuffer->SpillFileName)) {
+            ThisBuffer->hSpillFile = NULL;
+            YoriLibFreeStringContents(&TempPath);
+            return FALSE;
+        }
+        YoriLibFreeStringContents(&TempPath);
+    }
+
+    //
+    //  The file pointer is also moved when reading from the file, so
+    //  position it at the end of the spilled data before each write.
+    //
+
+    Offset.QuadPart = ThisBuffer->BytesSpilled;
+    if (SetFilePointer(ThisBuffer->hSpillFile, (LONG)Offset.LowPart, &Offset.HighPart, FILE_BEGIN) == INVALID_SET_FILE_POINTER &&
+        GetLastError() != NO_ERROR) {
+
+        return FALSE;
+    }
+
+    if (!WriteFile(ThisBuffer->hSpillFile, Chunk + 1, Chunk->BytesPopulated, &BytesWritten, NULL) ||
+        BytesWritten != Chunk->BytesPopulated) {
+
+        return FALSE;
+    }
+
+    ThisBuffer->BytesSpilled = ThisBuffer->BytesSpilled + Chunk->BytesPopulated;
+    ThisBuffer->BytesInMemory = ThisBuffer->BytesInMemory - Chunk->BytesAllocated;
+    YoriLibRemoveListItem(&Chunk->ListEntry);
+    YoriLibFree(Chunk);
+    return TRUE;
+}
+
+/**
+ Return a chunk with space to receive more data from a process.  If the
+ newest chunk is full, a new chunk is allocated, and if this exceeds the
+ memory limit of the buffer, older chunks are moved to the temporary file.
+ This is called by the pump thread without the buffer mutex held, and
+ acquires the mutex if the list of chunks needs to change.
+
+ @param ThisBuffer Pointer to the buffer.
+
+ @return Pointer to a chunk with space available, or NULL on allocation
+         failure.
+ */
+PYORI_LIBSH_PROCESS_BUFFER_CHUNK
+YoriLibShGetProcessBufferWriteChunk(
+    __in PYORI_LIBSH_PROCESS_BUFFER ThisBuffer
+    )
+{
+    PYORI_LIBSH_PROCESS_BUFFER_CHUNK Chunk;
+    PYORI_LIST_ENTRY ListEntry;
+    DWORD ChunkSize;
+
+    ChunkSize = YORI_LIBSH_PROCESS_BUFFER_MIN_CHUNK_SIZE;
+    ListEntry = YoriLibGetPreviousListEntry(&ThisBuffer->ChunkList, NULL);
+    if (ListEntry != NULL) {
+        Chunk = CONTAINING_RECORD(ListEntry, YORI_LIBSH_PROCESS_BUFFER_CHUNK, ListEntry);
+        if (Chunk->BytesPopulated < Chunk->BytesAllocated) {
+            return Chunk;
+        }
+
+        ChunkSize = Chunk->BytesAllocated * 2;
+        if (ChunkSize > YORI_LIBSH_PROCESS_BUFFER_MAX_CHUNK_SIZE) {
+            ChunkSize = YORI_LIBSH_PROCESS_BUFFER_MAX_CHUNK_SIZE;
+        }
+    }
+
+    Chunk = YoriLibMalloc(sizeof(YORI_LIBSH_PROCESS_BUFFER_CHUNK) + ChunkSize);
+    if (Chunk == NULL) {
+        return NULL;
+    }
+
+    Chunk->BytesAllocated = ChunkSize;
+    Chunk->BytesPopulated = 0;
+
+    AcquireMutex(ThisBuffer->Mutex);
+
+    //
+    //  If the temporary file cannot be written, keep the data in memory.
+    //
+
+    if (ThisBuffer->MemoryLimit != 0) {
+        while (ThisBuffer->BytesInMemory + ChunkSize > ThisBuffer->MemoryLimit) {
+            if (!YoriLibShSpillOldestChunk(ThisBuffer)) {
+                break;
+            }
+        }
+    }
+
+    YoriLibAppendList(&ThisBuffer->ChunkList, &Chunk->ListEntry);
+    ThisBuffer->BytesInMemory = ThisBuffer->BytesInMemory + ChunkSize;
+    ReleaseMutex(ThisBuffer->Mutex);
+
+    return Chunk;
+}
+
+/**
+ Locate the data within a buffer at a specified offset.  Data in memory can
+ be returned directly; data in the temporary file is read into a bounce
+ buffer.  At most one chunk's worth of data is returned, so callers can
+ release the buffer mutex between calls.  This is called with the buffer
+ mutex held, and the returned data remains valid until it is released.
+
+ @param ThisBuffer Pointer to the buffer.
+
+ @param Offset The offset within the stream of the data to return.  This
+        must be less than the number of bytes populated.
+
+ @param Data On successful completion, updated to point to the data.
+
+ @param Length On successful completion, updated to contain the number of
+        bytes of data returned.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+YoriLibShGetProcessBufferData(
+    __in PYORI_LIBSH_PROCESS_BUFFER ThisBuffer,
+    __in DWORDLONG Offset,
+    __out PVOID *Data,
+    __out PDWORD Length
+    )
+{
+    PYORI_LIBSH_PROCESS_BUFFER_CHUNK Chunk;
+    PYORI_LIST_ENTRY ListEntry;
+    DWORDLONG ChunkStart;
+    LARGE_INTEGER FileOffset;
+    DWORD BytesToRead;
+    DWORD BytesRead;
+
+    ASSERT(Offset < ThisBuffer->BytesPopulated);
+
+    if (Offset < ThisBuffer->BytesSpilled) {
+        if (ThisBuffer->SpillReadBuffer == NULL) {
+            ThisBuffer->SpillReadBuffer = YoriLibMalloc(YORI_LIBSH_PROCESS_BUFFER_MAX_CHUNK_SIZE);
+            if (ThisBuffer->SpillReadBuffer == NULL) {
+                return FALSE;
+            }
+        }
+
+        BytesToRead = YORI_LIBSH_PROCESS_BUFFER_MAX_CHUNK_SIZE;
+        if (Offset + BytesToRead > ThisBuffer->BytesSpilled) {
+            BytesToRead = (DWORD)(ThisBuffer->BytesSpilled - Offset);
+        }
+
+        FileOffset.QuadPart = Offset;
+        if (SetFilePointer(ThisBuffer->hSpillFile, (LONG)FileOffset.LowPart, &FileOffset.HighPart, FILE_BEGIN) == INVALID_SET_FILE_POINTER &&
+            GetLastError() != NO_ERROR) {
+
+            return FALSE;
+        }
+
+        if (!ReadFile(ThisBuffer->hSpillFile, ThisBuffer->SpillReadBuffer, BytesToRead, &BytesRead, NULL) ||
+            BytesRead == 0) {
+
+            return FALSE;
+        }
+
+        *Data = ThisBuffer->SpillReadBuffer;
+        *Length = BytesRead;
+        return TRUE;
+    }
+
+    //
+    //  Consumers generally want either the oldest data, when replaying the
+    //  stream, or the newest data, when mirroring it as it arrives, so
+    //  search from whichever end of the list is closer.
+    //
+
+    if (Offset - ThisBuffer->BytesSpilled < ThisBuffer->BytesPopulated - Offset) {
+        ChunkStart = ThisBuffer->BytesSpilled;
+        ListEntry = YoriLibGetNextListEntry(&ThisBuffer->ChunkList, NULL);
+        while (ListEntry != NULL) {
+            Chunk = CONTAINING_RECORD(ListEntry, YORI_LIBSH_PROCESS_BUFFER_CHUNK, ListEntry);
+            if (Offset < ChunkStart + Chunk->BytesPopulated) {
+                break;
+            }
+            ChunkStart = ChunkStart + Chunk->BytesPopulated;
+            ListEntry = YoriLibGetNextListEntry(&ThisBuffer->ChunkList, ListEntry);
+        }
+    } else {
+        ChunkStart = ThisBuffer->BytesPopulated;
+        ListEntry = YoriLibGetPreviousListEntry(&ThisBuffer->ChunkList, NULL);
+        while (ListEntry != NULL) {
+            Chunk = CONTAINING_RECORD(ListEntry, YORI_LIBSH_PROCESS_BUFFER_CHUNK, ListEntry);
+            ChunkStart = ChunkStart - Chunk->BytesPopulated;
+            if (Offset >= ChunkStart) {
+                break;
+            }
+            ListEntry = YoriLibGetPreviousListEntry(&ThisBuffer->ChunkList, ListEntry);
+        }
+    }
+
+    if (ListEntry == NULL) {
+        ASSERT(ListEntry != NULL);
+        return FALSE;
+    }
+
+    Chunk = CONTAINING_RECORD(ListEntry, YORI_LIBSH_PROCESS_BUFFER_CHUNK, ListEntry);
+    *Data = YoriLibAddToPointer(Chunk + 1, (DWORD)(Offset - ChunkStart));
+    *Length = Chunk->BytesPopulated - (DWORD)(Offset - ChunkStart);
+    return TRUE;
+}
+
+/**
+ Write the next range of data from a buffer to a handle.  At most one
+ chunk's worth of data is written, so callers can release the buffer mutex
+ between calls.  This is called with the buffer mutex held.
+
+ @param ThisBuffer Pointer to the buffer.
+
+ @param hTarget The handle to write data to.
+
+ @param BytesSent On input, the offset within the stream of the data to
+        write.  On successful completion, updated to include the data that
+        was written.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+YoriLibShSendProcessBufferData(
+    __in PYORI_LIBSH_PROCESS_BUFFER ThisBuffer,
+    __in HANDLE hTarget,
+    __inout PDWORDLONG BytesSent
+    )
+{
+    PVOID Data;
+    DWORD BytesToWrite;
+    DWORD BytesWritten;
+
+    if (!YoriLibShGetProcessBufferData(ThisBuffer, *BytesSent, &Data, &BytesToWrite)) {
+        return FALSE;
+    }
+
+    if (!WriteFile(hTarget, Data, BytesToWrite, &BytesWritten, NULL)) {
+        return FALSE;
+    }
+
+    *BytesSent = *BytesSent + BytesWritten;
+    ASSERT(*BytesSent <= ThisBuffer->BytesPopulated);
+    return TRUE;
+}
+
 /**
  Code running on a dedicated thread for the duration of an outstanding process
  to populate data into its pipe.
@@ -198,35 +582,21 @@ YoriLibShCmdBufferPumpToNextProcess(
     )
 {
     PYORI_LIBSH_PROCESS_BUFFER ThisBuffer = (PYORI_LIBSH_PROCESS_BUFFER)Param;
-    DWORD BytesSent = 0;
-    DWORD BytesWritten;
-    DWORD BytesToWrite;
+    DWORDLONG BytesSent = 0;
 
     while (TRUE) {
 
-        BytesToWrite = 4096;
         AcquireMutex(ThisBuffer->Mutex);
-        if (BytesSent + BytesToWrite > ThisBuffer->BytesPopulated) {
-            BytesToWrite = ThisBuffer->BytesPopulated - BytesSent;
-        }
-
-        if (WriteFile(ThisBuffer->hSource,
-                      YoriLibAddToPointer(ThisBuffer->Buffer, BytesSent),
-                      BytesToWrite,
-                      &BytesWritten,
-                      NULL)) {
-
-            BytesSent += BytesWritten;
-        } else {
+        if (BytesSent >= ThisBuffer->BytesPopulated) {
             ReleaseMutex(ThisBuffer->Mutex);
             break;
         }
-        ReleaseMutex(ThisBuffer->Mutex);
 
-        ASSERT(BytesSent <= ThisBuffer->BytesPopulated);
-        if (BytesSent >= ThisBuffer->BytesPopulated) {
+        if (!YoriLibShSendProcessBufferData(ThisBuffer, ThisBuffer->hSource, &BytesSent)) {
+            ReleaseMutex(ThisBuffer->Mutex);
             break;
         }
+        ReleaseMutex(ThisBuffer->Mutex);
     }
 
     CloseHandle(ThisBuffer->hSource);
@@ -250,14 +620,26 @@ YoriLibShCmdBufferPump(
     )
 {
     PYORI_LIBSH_PROCESS_BUFFER ThisBuffer = (PYORI_LIBSH_PROCESS_BUFFER)Param;
+    PYORI_LIBSH_PROCESS_BUFFER_CHUNK Chunk;
     DWORD BytesRead;
     HANDLE hTemp;
 
     while (ThisBuffer->hSource != NULL) {
 
+        //
+        //  Data is read directly into the newest chunk.  Only this thread
+        //  adds data to chunks, so this does not require the mutex.
+        //
+
+        Chunk = YoriLibShGetProcessBufferWriteChunk(ThisBuffer);
+        if (Chunk == NULL) {
+            AcquireMutex(ThisBuffer->Mutex);
+            break;
+        }
+
         if (ReadFile(ThisBuffer->hSource,
-                     YoriLibAddToPointer(ThisBuffer->Buffer, ThisBuffer->BytesPopulated),
-                     ThisBuffer->BytesAllocated - ThisBuffer->BytesPopulated,
+                     YoriLibAddToPointer(Chunk + 1, Chunk->BytesPopulated),
+                     Chunk->BytesAllocated - Chunk->BytesPopulated,
                      &BytesRead,
                      NULL)) {
 
@@ -267,28 +649,9 @@ YoriLibShCmdBufferPump(
                 break;
             }
 
-            ThisBuffer->BytesPopulated = ThisBuffer->BytesPopulated + (YORI_ALLOC_SIZE_T)BytesRead;
-            ASSERT(ThisBuffer->BytesPopulated <= ThisBuffer->BytesAllocated);
-            if (ThisBuffer->BytesPopulated >= ThisBuffer->BytesAllocated) {
-                YORI_ALLOC_SIZE_T NewBytesAllocated;
-                PCHAR NewBuffer;
-
-                if (ThisBuffer->BytesAllocated >= YORI_MAX_ALLOC_SIZE) {
-                    break;
-                }
-
-                NewBytesAllocated = ThisBuffer->BytesAllocated * 4;
-
-                NewBuffer = YoriLibMalloc(NewBytesAllocated);
-                if (NewBuffer == NULL) {
-                    break;
-                }
-
-                memcpy(NewBuffer, ThisBuffer->Buffer, ThisBuffer->BytesAllocated);
-                YoriLibFree(ThisBuffer->Buffer);
-                ThisBuffer->Buffer = NewBuffer;
-                ThisBuffer->BytesAllocated = NewBytesAllocated;
-            }
+            Chunk->BytesPopulated = Chunk->BytesPopulated + BytesRead;
+            ASSERT(Chunk->BytesPopulated <= Chunk->BytesAllocated);
+            ThisBuffer->BytesPopulated = ThisBuffer->BytesPopulated + BytesRead;
         } else {
             DWORD LastError = GetLastError();
 
@@ -309,29 +672,13 @@ YoriLibShCmdBufferPump(
 
         if (ThisBuffer->hMirror != NULL) {
             while (ThisBuffer->BytesSent < ThisBuffer->BytesPopulated) {
-                DWORD BytesToWrite;
-                DWORD BytesWritten;
-                BytesToWrite = 4096;
-                if (ThisBuffer->BytesSent + BytesToWrite > ThisBuffer->BytesPopulated) {
-                    BytesToWrite = ThisBuffer->BytesPopulated - ThisBuffer->BytesSent;
-                }
-
-                if (WriteFile(ThisBuffer->hMirror,
-                              YoriLibAddToPointer(ThisBuffer->Buffer, ThisBuffer->BytesSent),
-                              BytesToWrite,
-                              &BytesWritten,
-                              NULL)) {
-
-                    ThisBuffer->BytesSent += BytesWritten;
-                } else {
+                if (!YoriLibShSendProcessBufferData(ThisBuffer, ThisBuffer->hMirror, &ThisBuffer->BytesSent)) {
                     hTemp = ThisBuffer->hMirror;
                     ThisBuffer->hMirror = NULL;
                     CloseHandle(hTemp);
                     ThisBuffer->BytesSent = 0;
                     break;
                 }
-
-                ASSERT(ThisBuffer->BytesSent <= ThisBuffer->BytesPopulated);
             }
 
         }
@@ -368,10 +715,14 @@ YoriLibShAllocateSingleProcessBuffer(
     __out PYORI_LIBSH_PROCESS_BUFFER Buffer
     )
 {
-    Buffer->BytesAllocated = 1024;
-    Buffer->Buffer = YoriLibMalloc(Buffer->BytesAllocated);
-    if (Buffer->Buffer == NULL) {
-        return FALSE;
+    YORI_MAX_SIGNED_T LimitInMb;
+
+    YoriLibInitializeListHead(&Buffer->ChunkList);
+
+    if (YoriLibGetEnvVarAsNumber(YORI_LIBSH_PROCESS_BUFFER_LIMIT_VAR, &LimitInMb) &&
+        LimitInMb > 0) {
+
+        Buffer->MemoryLimit = (DWORDLONG)LimitInMb * 1024 * 1024;
     }
 
     Buffer->Mutex = CreateMutex(NULL, FALSE, NULL);
@@ -518,11 +869,76 @@ YoriLibShAppendToExistingProcessBuffer(
 }
 
 /**
- Create a background thread and pipes so that the next process will
- receive its stdin from a background thread pushing data from a buffer
- created by the previous process.  This is used on builtin commands which
- execute on the primary thread but want to output a lot of data to the
- next process.
+ If the data in a buffer has been moved to a temporary file, move any
+ remaining data to the file and open a new handle to read the file from the
+ beginning.  This allows the data to be consumed directly from the file
+ without being copied through this process.
+
+ @param ThisBuffer Pointer to the buffer.
+
+ @param FileHandle On successful completion, updated to contain a handle to
+        the temporary file, opened for read.
+
+ @return TRUE to indicate success, FALSE if the data is not in a temporary
+         file or could not be moved to it.
+ */
+__success(return)
+BOOLEAN
+YoriLibShOpenProcessBufferAsFile(
+    __in PYORI_LIBSH_PROCESS_BUFFER ThisBuffer,
+    __out PHANDLE FileHandle
+    )
+{
+    HANDLE Handle;
+
+    if (ThisBuffer->hSpillFile == NULL) {
+        return FALSE;
+    }
+
+    AcquireMutex(ThisBuffer->Mutex);
+
+    while (!YoriLibIsListEmpty(&ThisBuffer->ChunkList)) {
+        if (!YoriLibShSpillOldestChunk(ThisBuffer)) {
+            ReleaseMutex(ThisBuffer->Mutex);
+            return FALSE;
+        }
+    }
+
+    ASSERT(ThisBuffer->BytesSpilled == ThisBuffer->BytesPopulated);
+
+    //
+    //  The temporary file is deleted when the buffer is freed, which may
+    //  happen while the handle returned here is still in use, so the file
+    //  is opened allowing deletion.
+    //
+
+    Handle = CreateFile(ThisBuffer->SpillFileName.StartOfString,
+                        GENERIC_READ,
+                        FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                        NULL,
+                        OPEN_EXISTING,
+                        FILE_ATTRIBUTE_NORMAL,
+                        NULL);
+
+    ReleaseMutex(ThisBuffer->Mutex);
+
+    if (Handle == INVALID_HANDLE_VALUE) {
+        return FALSE;
+    }
+
+    *FileHandle = Handle;
+    return TRUE;
+}
+
+/**
+ Arrange for the next process to receive its stdin from a buffer created by
+ the previous process.  This is used on builtin commands which execute on
+ the primary thread but want to output a lot of data to the next process.
+
+ Where possible the next process is given a handle that it can read directly.
+ If the buffer is empty, this is a pipe with no data, and if the buffer has
+ been moved to a temporary file, this is a handle to that file.  Otherwise a
+ background thread pushes data from the buffer into a pipe.
 
  @param ExecContext The process whose output requires pushing to the next
         process in the chain.
@@ -543,39 +959,63 @@ YoriLibShForwardProcessBufferToNextProcess(
     ASSERT(ExecContext->StdOutType == StdOutTypeBuffer);
     ASSERT(ExecContext->StdErrType != StdErrTypeBuffer);
 
-    if (ExecContext->NextProgram != NULL &&
-        ExecContext->NextProgram->StdInType == StdInTypePipe &&
-        CreatePipe(&ReadHandle, &WriteHandle, NULL, 0)) {
+    if (ExecContext->NextProgram == NULL ||
+        ExecContext->NextProgram->StdInType != StdInTypePipe) {
 
-        ExecContext->NextProgram->StdIn.Pipe.PipeFromPriorProcess = ReadHandle;
+        return FALSE;
+    }
 
-        //
-        //  If we're forwarding to the next process, the previous one
-        //  should be finished
-        //
+    //
+    //  If we're forwarding to the next process, the previous one
+    //  should be finished
+    //
 
-        if (ThisBuffer->OutputBuffer.hPumpThread != NULL) {
-            if (WaitForSingleObject(ThisBuffer->OutputBuffer.hPumpThread, INFINITE) == WAIT_OBJECT_0) {
-                CloseHandle(ThisBuffer->OutputBuffer.hPumpThread);
-                ThisBuffer->OutputBuffer.hPumpThread = NULL;
-            }
+    if (ThisBuffer->OutputBuffer.hPumpThread != NULL) {
+        if (WaitForSingleObject(ThisBuffer->OutputBuffer.hPumpThread, INFINITE) == WAIT_OBJECT_0) {
+            CloseHandle(ThisBuffer->OutputBuffer.hPumpThread);
+            ThisBuffer->OutputBuffer.hPumpThread = NULL;
         }
+    }
 
-        //
-        //  Reverse the flow and create a thread to pump data out
-        //
+    //
+    //  If no data needs to be pushed by a thread, drop the reference that
+    //  the pump thread would have held, which would otherwise be released
+    //  when the thread terminates.
+    //
 
-        ThisBuffer->OutputBuffer.hSource = WriteHandle;
-        ThisBuffer->OutputBuffer.hPumpThread = CreateThread(NULL, 0, YoriLibShCmdBufferPumpToNextProcess, &ThisBuffer->OutputBuffer, 0, &ThreadId);
-        if (ThisBuffer->OutputBuffer.hPumpThread == NULL) {
-            return FALSE;
-        }
+    if (ThisBuffer->OutputBuffer.hPumpThread == NULL &&
+        YoriLibShOpenProcessBufferAsFile(&ThisBuffer->OutputBuffer, &ReadHandle)) {
+
+        ExecContext->NextProgram->StdIn.Pipe.PipeFromPriorProcess = ReadHandle;
+        YoriLibShDereferenceProcessBuffer(ThisBuffer);
+        return TRUE;
+    }
+
+    if (!CreatePipe(&ReadHandle, &WriteHandle, NULL, 0)) {
+        return FALSE;
+    }
 
+    ExecContext->NextProgram->StdIn.Pipe.PipeFromPriorProcess = ReadHandle;
+
+    if (ThisBuffer->OutputBuffer.hPumpThread == NULL &&
+        ThisBuffer->OutputBuffer.BytesPopulated == 0) {
+
+        CloseHandle(WriteHandle);
+        YoriLibShDereferenceProcessBuffer(ThisBuffer);
         return TRUE;
+    }
 
-    } else {
+    //
+    //  Reverse the flow and create a thread to pump data out
+    //
+
+    ThisBuffer->OutputBuffer.hSource = WriteHandle;
+    ThisBuffer->OutputBuffer.hPumpThread = CreateThread(NULL, 0, YoriLibShCmdBufferPumpToNextProcess, &ThisBuffer->OutputBuffer, 0, &ThreadId);
+    if (ThisBuffer->OutputBuffer.hPumpThread == NULL) {
         return FALSE;
     }
+
+    return TRUE;
 }
 
 /**
@@ -613,7 +1053,8 @@ YoriLibShReferenceProcessBuffer(
 }
 
 /**
- Return contents of a process buffer.
+ Return contents of a process buffer.  If the contents are not contiguous in
+ memory, they are copied into a single allocation once before conversion.
 
  @param ThisBuffer Pointer to the buffer to any output from.
 
@@ -631,27 +1072,77 @@ YoriLibShGetProcessBuffer(
     )
 {
     YORI_ALLOC_SIZE_T LengthNeeded;
+    YORI_ALLOC_SIZE_T BytesPopulated;
+    YORI_ALLOC_SIZE_T BytesCopied;
+    PCHAR FlatBuffer;
+    PVOID Data;
+    DWORD Length;
 
-    if (ThisBuffer->Buffer == NULL) {
+    if (ThisBuffer->Mutex == NULL) {
         return FALSE;
     }
 
     AcquireMutex(ThisBuffer->Mutex);
 
-    LengthNeeded = YoriLibGetMultibyteInputSizeNeeded(ThisBuffer->Buffer, ThisBuffer->BytesPopulated);
-    if (LengthNeeded == 0 && ThisBuffer->BytesPopulated == 0) {
+    if (ThisBuffer->BytesPopulated == 0) {
         ReleaseMutex(ThisBuffer->Mutex);
         YoriLibInitEmptyString(String);
         return TRUE;
     }
 
+    if (ThisBuffer->BytesPopulated > YORI_MAX_ALLOC_SIZE) {
+        ReleaseMutex(ThisBuffer->Mutex);
+        return FALSE;
+    }
+
+    BytesPopulated = (YORI_ALLOC_SIZE_T)ThisBuffer->BytesPopulated;
+
+    if (!YoriLibShGetProcessBufferData(ThisBuffer, 0, &Data, &Length)) {
+        ReleaseMutex(ThisBuffer->Mutex);
+        return FALSE;
+    }
+
+    FlatBuffer = NULL;
+    if (Length < BytesPopulated) {
+        FlatBuffer = YoriLibMalloc(BytesPopulated);
+        if (FlatBuffer == NULL) {
+            ReleaseMutex(ThisBuffer->Mutex);
+            return FALSE;
+        }
+
+        BytesCopied = 0;
+        while (TRUE) {
+            memcpy(&FlatBuffer[BytesCopied], Data, Length);
+            BytesCopied = BytesCopied + Length;
+            if (BytesCopied >= BytesPopulated) {
+                break;
+            }
+
+            if (!YoriLibShGetProcessBufferData(ThisBuffer, BytesCopied, &Data, &Length)) {
+                YoriLibFree(FlatBuffer);
+                ReleaseMutex(ThisBuffer->Mutex);
+                return FALSE;
+            }
+        }
+
+        Data = FlatBuffer;
+    }
+
+    LengthNeeded = YoriLibGetMultibyteInputSizeNeeded(Data, BytesPopulated);
+
     if (!YoriLibAllocateString(String, LengthNeeded)) {
+        if (FlatBuffer != NULL) {
+            YoriLibFree(FlatBuffer);
+        }
         ReleaseMutex(ThisBuffer->Mutex);
         return FALSE;
     }
 
-    YoriLibMultibyteInput(ThisBuffer->Buffer, ThisBuffer->BytesPopulated, String->StartOfString, String->LengthAllocated);
+    YoriLibMultibyteInput(Data, BytesPopulated, String->StartOfString, String->LengthAllocated);
     String->LengthInChars = LengthNeeded;
+    if (FlatBuffer != NULL) {
+        YoriLibFree(FlatBuffer);
+    }
     ReleaseMutex(ThisBuffer->Mutex);
 
     return TRUE;
@@ -924,7 +1415,7 @@ YoriLibShPipeProcessBuffers(
     //
 
     if (hPipeOutput != NULL) {
-        if (ThisBufferNonOpaque->OutputBuffer.Buffer != NULL) {
+        if (ThisBufferNonOpaque->OutputBuffer.Mutex != NULL) {
             HaveOutput = TRUE;
         } else {
             return FALSE;
@@ -932,7 +1423,7 @@ YoriLibShPipeProcessBuffers(
     }
 
     if (hPipeErrors != NULL) {
-        if (ThisBufferNonOpaque->ErrorBuffer.Buffer != NULL) {
+        if (ThisBufferNonOpaque->ErrorBuffer.Mutex != NULL) {
             HaveErrors = TRUE;
         } else {
             return FALSE;
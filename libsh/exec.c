@@ -583,6 +583,37 @@ YoriLibShCreateProcess(
         }
     }
 
+    //
+    //  If the process will become a background job, place it in a job
+    //  object before it starts executing so the resources consumed by it
+    //  and everything it launches can be reported later.  This is best
+    //  effort, since older systems cannot nest job objects.
+    //
+
+    ASSERT(ExecContext->hJob == NULL);
+    if (!ExecContext->WaitForCompletion &&
+        !ExecContext->CaptureEnvironmentOnExit &&
+        ExecContext->StdOutType != StdOutTypePipe) {
+
+        ExecContext->hJob = YoriLibCreateJobObject();
+        if (ExecContext->hJob != NULL &&
+            !YoriLibAssignProcessToJobObject(ExecContext->hJob, ProcessInfo.hProcess)) {
+
+            CloseHandle(ExecContext->hJob);
+            ExecContext->hJob = NULL;
+        }
+    }
+
+    //
+    //  If the caller is distributing children across processor groups or
+    //  NUMA nodes, select processors for this child before it starts
+    //  executing.
+    //
+
+    if (ExecContext->ProcessorPlacement != NULL) {
+        YoriLibPlaceNextProcess(ExecContext->ProcessorPlacement, ProcessInfo.hThread);
+    }
+
     ResumeThread(ProcessInfo.hThread);
 
     ASSERT(ExecContext->hProcess == NULL);
@@ -590,6 +621,10 @@ YoriLibShCreateProcess(
     ExecContext->hPrimaryThread = ProcessInfo.hThread;
     ExecContext->dwProcessId = ProcessInfo.dwProcessId;
 
+    if (YoriLibEtwIsEnabled(YORI_LIB_ETW_KEYWORD_PROCESS)) {
+        YoriLibEtwWriteEvent(YORI_LIB_ETW_KEYWORD_PROCESS, "ProcessLaunch", "CmdLine", &CmdLine, "ProcessId", ProcessInfo.dwProcessId, NULL, 0);
+    }
+
     YoriLibFreeStringContents(&CmdLine);
 
     return ERROR_SUCCESS;
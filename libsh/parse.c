@@ -995,6 +995,7 @@ YoriLibShParseCmdlineToCmdContext(
     Char.LengthInChars = CmdLine->LengthInChars;
 
     YoriLibShTrimSpacesAndAtsFromBeginning(&Char);
+    CmdContext->ArgContexts[ArgCount].SourceOffset = (YORI_ALLOC_SIZE_T)(Char.StartOfString - CmdLine->StartOfString);
 
     if (Char.LengthInChars > 0 && Char.StartOfString[0] == '"') {
         LookingForFirstQuote = TRUE;
@@ -1129,6 +1130,7 @@ YoriLibShParseCmdlineToCmdContext(
 
             if (Char.LengthInChars > 0) {
                 YoriLibParseMoveToNextArgumentPopulate(CmdContext, &ArgCount, &Char, OutputString, &PreviousCharWasQuote, &LookingForFirstQuote, &FirstQuoteEndOffset);
+                CmdContext->ArgContexts[ArgCount].SourceOffset = (YORI_ALLOC_SIZE_T)(Char.StartOfString - CmdLine->StartOfString);
 
                 //
                 //  If we were processing a space but the next argument is a
@@ -1170,6 +1172,7 @@ YoriLibShParseCmdlineToCmdContext(
                     YoriLibParseTerminateCurrentArgument(&OutputString, &CmdContext->ArgV[ArgCount], PreviousCharWasQuote, FirstQuoteEndOffset);
                     if (Char.LengthInChars > 0) {
                         YoriLibParseMoveToNextArgumentPopulate(CmdContext, &ArgCount, &Char, OutputString, &PreviousCharWasQuote, &LookingForFirstQuote, &FirstQuoteEndOffset);
+                        CmdContext->ArgContexts[ArgCount].SourceOffset = (YORI_ALLOC_SIZE_T)(Char.StartOfString - CmdLine->StartOfString);
                     }
                 }
             }
@@ -1449,6 +1452,7 @@ YoriLibShCopyArg(
 {
     DestCmdContext->ArgContexts[DestArgument].Quoted = SrcCmdContext->ArgContexts[SrcArgument].Quoted;
     DestCmdContext->ArgContexts[DestArgument].QuoteTerminated = SrcCmdContext->ArgContexts[SrcArgument].QuoteTerminated;
+    DestCmdContext->ArgContexts[DestArgument].SourceOffset = SrcCmdContext->ArgContexts[SrcArgument].SourceOffset;
     if (SrcCmdContext->ArgV[SrcArgument].MemoryToFree != NULL) {
         YoriLibReference(SrcCmdContext->ArgV[SrcArgument].MemoryToFree);
     }
@@ -2089,6 +2093,10 @@ YoriLibShFreeExecContext(
         CloseHandle(ExecContext->hPrimaryThread);
         ExecContext->hPrimaryThread = NULL;
     }
+    if (ExecContext->hJob != NULL) {
+        CloseHandle(ExecContext->hJob);
+        ExecContext->hJob = NULL;
+    }
 }
 
 /**
@@ -2850,6 +2858,80 @@ YoriLibShFindNextBackquoteSubstring(
     return FALSE;
 }
 
+/**
+ Search through a string and return the set of backquote substrings which
+ can be executed next.  These are the substrings at the deepest level of
+ nesting, so none of them contain another, and executing one does not
+ change the text of another.  This allows the caller to execute them
+ concurrently.  If no backquote substrings requiring execution are found,
+ this function returns FALSE.
+
+ @param String Pointer to the string to process.
+
+ @param MaxSubsets The number of elements in the CurrentSubsets and
+        CharsInPrefix arrays.  If more substrings can be executed, only the
+        first MaxSubsets are returned.
+
+ @param CurrentSubsets On successful completion, updated to point to the
+        substrings to execute, in the order they occur in String.
+
+ @param CharsInPrefix On successful completion, updated to indicate the
+        number of characters before each CurrentSubset that were used to
+        indicate its commencement.
+
+ @param SubsetCount On successful completion, updated to indicate the number
+        of substrings returned.
+
+ @return TRUE if there is at least one substring to execute, FALSE if there
+         is not.
+ */
+__success(return)
+BOOL
+YoriLibShFindNextBackquoteSubstrings(
+    __in PYORI_STRING String,
+    __in YORI_ALLOC_SIZE_T MaxSubsets,
+    __out_ecount(MaxSubsets) PYORI_STRING CurrentSubsets,
+    __out_ecount(MaxSubsets) PYORI_ALLOC_SIZE_T CharsInPrefix,
+    __out PYORI_ALLOC_SIZE_T SubsetCount
+    )
+{
+    YORI_LIBSH_BACKQUOTE_CONTEXT BackquoteContext;
+    PYORI_LIST_ENTRY ListEntry;
+    PYORI_LIBSH_BACKQUOTE_ENTRY BackquoteEntry;
+    YORI_ALLOC_SIZE_T SeekingDepth;
+    YORI_ALLOC_SIZE_T Count;
+
+    if (!YoriLibShParseBackquoteSubstrings(String, &BackquoteContext)) {
+        return FALSE;
+    }
+
+    Count = 0;
+    for (SeekingDepth = BackquoteContext.MaxDepth; SeekingDepth > 0 && Count == 0; SeekingDepth--) {
+
+        ListEntry = YoriLibGetNextListEntry(&BackquoteContext.MatchList, NULL);
+        while (ListEntry != NULL && Count < MaxSubsets) {
+            BackquoteEntry = CONTAINING_RECORD(ListEntry, YORI_LIBSH_BACKQUOTE_ENTRY, MatchList);
+            if (BackquoteEntry->Terminated && BackquoteEntry->TreeDepth == SeekingDepth) {
+                memcpy(&CurrentSubsets[Count], &BackquoteEntry->String, sizeof(YORI_STRING));
+                if (BackquoteEntry->NewStyleMatch) {
+                    CharsInPrefix[Count] = 2;
+                } else {
+                    CharsInPrefix[Count] = 1;
+                }
+                Count++;
+            }
+            ListEntry = YoriLibGetNextListEntry(&BackquoteContext.MatchList, ListEntry);
+        }
+    }
+
+    YoriLibShFreeBackquoteContext(&BackquoteContext);
+    *SubsetCount = Count;
+    if (Count == 0) {
+        return FALSE;
+    }
+    return TRUE;
+}
+
 /**
  Given a string and a current selected offset within the string, find the
  "best" backquote substring for tab completion.  This means the innermost
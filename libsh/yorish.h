@@ -46,6 +46,13 @@ typedef struct _YORI_LIBSH_ARG_CONTEXT {
      */
     BOOLEAN QuoteTerminated;
 
+    /**
+     The offset, in characters, within the parsed string where this argument
+     begins.  This is populated when parsing a string into arguments, and is
+     zero for arguments that were not parsed from a string.
+     */
+    YORI_ALLOC_SIZE_T SourceOffset;
+
 } YORI_LIBSH_ARG_CONTEXT, *PYORI_LIBSH_ARG_CONTEXT;
 
 /**
@@ -289,6 +296,21 @@ typedef struct _YORI_LIBSH_SINGLE_EXEC_CONTEXT {
      */
     HANDLE hDebuggerThread;
 
+    /**
+     Handle to a job object containing the child process and its
+     descendants, if the process is executing in the background.  This is
+     used to report the resources consumed by the process tree.
+     */
+    HANDLE hJob;
+
+    /**
+     If the caller is distributing child processes across processor groups
+     or NUMA nodes, points to the placement state used to select processors
+     for this process.  This is owned by the caller and is NULL if the
+     process should execute wherever the system places it.
+     */
+    PYORI_LIB_PROCESSOR_PLACEMENT ProcessorPlacement;
+
     /**
      The process identifier of the child process if it has been launched.
      For some reason some APIs want this and others want the handle.
@@ -512,6 +534,90 @@ typedef struct _YORI_LIBSH_BUILTIN_CALLBACK {
 
 } YORI_LIBSH_BUILTIN_CALLBACK, *PYORI_LIBSH_BUILTIN_CALLBACK;
 
+/**
+ The prefix of the name of the pipe used to communicate with a shell
+ running as a server.  The name of the server follows this prefix.
+ */
+#define YORI_LIBSH_SERVER_PIPE_PREFIX _T("\\\\.\\pipe\\yori-server-")
+
+/**
+ The version of the protocol used to communicate with a shell running as a
+ server.
+ */
+#define YORI_LIBSH_SERVER_VERSION (1)
+
+/**
+ The maximum number of characters in each string within a request to a
+ shell running as a server.
+ */
+#define YORI_LIBSH_SERVER_MAX_REQUEST_CHARS (0x100000)
+
+/**
+ A request sent to a shell running as a server.  This structure is followed
+ by the current directory, environment block, and command line, in that
+ order, each of which is a TCHAR string without NULL terminators.  The
+ environment block is NULL separated and may be empty, in which case the
+ server's environment is used.
+ */
+typedef struct _YORI_LIBSH_SERVER_REQUEST {
+
+    /**
+     The version of the protocol, set to @ref YORI_LIBSH_SERVER_VERSION .
+     */
+    DWORD Version;
+
+    /**
+     The number of characters in the current directory.
+     */
+    DWORD CurrentDirectoryLength;
+
+    /**
+     The number of characters in the environment block.
+     */
+    DWORD EnvironmentLength;
+
+    /**
+     The number of characters in the command line.
+     */
+    DWORD CommandLength;
+} YORI_LIBSH_SERVER_REQUEST, *PYORI_LIBSH_SERVER_REQUEST;
+
+/**
+ A response packet containing output written to standard output.
+ */
+#define YORI_LIBSH_SERVER_RESPONSE_STDOUT (1)
+
+/**
+ A response packet containing output written to standard error.
+ */
+#define YORI_LIBSH_SERVER_RESPONSE_STDERR (2)
+
+/**
+ A response packet indicating the command has completed.  The payload
+ contains the DWORD exit code of the command.  This is the final packet for
+ a request.
+ */
+#define YORI_LIBSH_SERVER_RESPONSE_EXIT   (3)
+
+/**
+ The header of each response packet sent from a shell running as a server.
+ This is followed by Length bytes of payload.  Output is sent as the bytes
+ that the command wrote, without any conversion.
+ */
+typedef struct _YORI_LIBSH_SERVER_RESPONSE {
+
+    /**
+     The type of the packet, one of the YORI_LIBSH_SERVER_RESPONSE_*
+     values.
+     */
+    DWORD Type;
+
+    /**
+     The number of bytes of payload following this header.
+     */
+    DWORD Length;
+} YORI_LIBSH_SERVER_RESPONSE, *PYORI_LIBSH_SERVER_RESPONSE;
+
 // *** BUILTIN.C ***
 
 PYORI_LIBSH_LOADED_MODULE
@@ -748,6 +854,16 @@ YoriLibShFindNextBackquoteSubstring(
     __out PYORI_ALLOC_SIZE_T CharsInPrefix
     );
 
+__success(return)
+BOOL
+YoriLibShFindNextBackquoteSubstrings(
+    __in PYORI_STRING String,
+    __in YORI_ALLOC_SIZE_T MaxSubsets,
+    __out_ecount(MaxSubsets) PYORI_STRING CurrentSubsets,
+    __out_ecount(MaxSubsets) PYORI_ALLOC_SIZE_T CharsInPrefix,
+    __out PYORI_ALLOC_SIZE_T SubsetCount
+    );
+
 VOID
 YoriLibShFreeCmdContext(
     __in PYORI_LIBSH_CMD_CONTEXT CmdContext
@@ -103,6 +103,19 @@ typedef struct _YORI_WIN_CTRL_HEX_EDIT {
      */
     YORI_ALLOC_SIZE_T BufferValid;
 
+    /**
+     The offset of the first byte that has been modified since the modify
+     state was last reset.
+     */
+    YORI_ALLOC_SIZE_T FirstModifiedOffset;
+
+    /**
+     The offset beyond the last byte that has been modified since the modify
+     state was last reset.  If this is not greater than FirstModifiedOffset,
+     no bytes have been modified.
+     */
+    YORI_ALLOC_SIZE_T BeyondLastModifiedOffset;
+
     /**
      The number of bytes that will be displayed in a single line of the
      control.
@@ -247,6 +260,15 @@ typedef struct _YORI_WIN_CTRL_HEX_EDIT {
      */
     BOOLEAN MouseButtonDown;
 
+    /**
+     TRUE if Buffer refers to a copy on write view of a file which should be
+     released with UnmapViewOfFile.  FALSE if Buffer was allocated with
+     @ref YoriLibReferencedMalloc .  A mapped buffer is never resized; any
+     operation which changes the length of the data copies it into an
+     allocation first.
+     */
+    BOOLEAN BufferMapped;
+
 } YORI_WIN_CTRL_HEX_EDIT, *PYORI_WIN_CTRL_HEX_EDIT;
 
 /**
@@ -1688,6 +1710,98 @@ YoriWinHexEditExpandDirtyRange(
     }
 }
 
+/**
+ Record that a range of bytes in the buffer has been modified.  The range
+ can only be reset by resetting the modify state, so use any new range to
+ extend but not contract the range.
+
+ @param HexEdit Pointer to the hex edit control.
+
+ @param FirstOffset Specifies the first byte that has been modified.
+
+ @param BeyondLastOffset Specifies the offset beyond the last byte that has
+        been modified.
+ */
+VOID
+YoriWinHexEditExpandModifiedRange(
+    __in PYORI_WIN_CTRL_HEX_EDIT HexEdit,
+    __in YORI_ALLOC_SIZE_T FirstOffset,
+    __in YORI_ALLOC_SIZE_T BeyondLastOffset
+    )
+{
+    if (BeyondLastOffset <= FirstOffset) {
+        return;
+    }
+
+    if (HexEdit->BeyondLastModifiedOffset <= HexEdit->FirstModifiedOffset) {
+        HexEdit->FirstModifiedOffset = FirstOffset;
+        HexEdit->BeyondLastModifiedOffset = BeyondLastOffset;
+        return;
+    }
+
+    if (FirstOffset < HexEdit->FirstModifiedOffset) {
+        HexEdit->FirstModifiedOffset = FirstOffset;
+    }
+
+    if (BeyondLastOffset > HexEdit->BeyondLastModifiedOffset) {
+        HexEdit->BeyondLastModifiedOffset = BeyondLastOffset;
+    }
+}
+
+/**
+ Release the data buffer underlying the hex edit control.
+
+ @param HexEdit Pointer to the hex edit control.
+ */
+VOID
+YoriWinHexEditFreeBuffer(
+    __in PYORI_WIN_CTRL_HEX_EDIT HexEdit
+    )
+{
+    if (HexEdit->Buffer != NULL) {
+        if (HexEdit->BufferMapped) {
+            UnmapViewOfFile(HexEdit->Buffer);
+        } else {
+            YoriLibDereference(HexEdit->Buffer);
+        }
+        HexEdit->Buffer = NULL;
+    }
+    HexEdit->BufferMapped = FALSE;
+}
+
+/**
+ If the buffer is a view of a file, copy it into an allocation so that its
+ length can be changed.  This brings the entire contents into memory, so it
+ is only performed when the length must change.
+
+ @param HexEdit Pointer to the hex edit control.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOLEAN
+YoriWinHexEditUnmapBuffer(
+    __in PYORI_WIN_CTRL_HEX_EDIT HexEdit
+    )
+{
+    PUCHAR NewBuffer;
+
+    if (!HexEdit->BufferMapped) {
+        return TRUE;
+    }
+
+    NewBuffer = YoriLibReferencedMalloc(HexEdit->BufferValid);
+    if (NewBuffer == NULL) {
+        return FALSE;
+    }
+
+    memcpy(NewBuffer, HexEdit->Buffer, HexEdit->BufferValid);
+    YoriWinHexEditFreeBuffer(HexEdit);
+    HexEdit->Buffer = NewBuffer;
+    HexEdit->BufferAllocated = HexEdit->BufferValid;
+
+    return TRUE;
+}
+
 /**
  Modify the cursor location within the hex edit control.
 
@@ -1972,6 +2086,11 @@ YoriWinHexEditDeleteCell(
             break;
         case YoriWinHexEditCellTypeHexDigit:
             if (BitShift == 0) {
+                if (!YoriWinHexEditUnmapBuffer(HexEdit)) {
+                    return FALSE;
+                }
+                Cell = YoriLibAddToPointer(HexEdit->Buffer, BufferOffset);
+                YoriWinHexEditExpandModifiedRange(HexEdit, BufferOffset, HexEdit->BufferValid);
                 if (BufferOffset < HexEdit->BufferValid) {
                     BytesToCopy = HexEdit->BufferValid - BufferOffset;
                     if (BytesToCopy > HexEdit->BytesPerWord) {
@@ -1999,6 +2118,7 @@ YoriWinHexEditDeleteCell(
                 InputChar = *Cell;
                 InputChar = (UCHAR)(InputChar & ~(BitMask));
                 *Cell = InputChar;
+                YoriWinHexEditExpandModifiedRange(HexEdit, BufferOffset, BufferOffset + 1);
 
                 YoriWinHexEditNextCellSameType(HexEdit, CellType, BufferOffset, BitShift, &CurrentLine, &CurrentCharOffset);
             }
@@ -2006,6 +2126,11 @@ YoriWinHexEditDeleteCell(
             break;
         case YoriWinHexEditCellTypeCharValue:
             if (BufferOffset < HexEdit->BufferValid) {
+                if (!YoriWinHexEditUnmapBuffer(HexEdit)) {
+                    return FALSE;
+                }
+                Cell = YoriLibAddToPointer(HexEdit->Buffer, BufferOffset);
+                YoriWinHexEditExpandModifiedRange(HexEdit, BufferOffset, HexEdit->BufferValid);
                 BytesToCopy = HexEdit->BufferValid - BufferOffset;
                 if (BytesToCopy > 1) {
                     BytesToCopy = BytesToCopy - 1;
@@ -2079,9 +2204,7 @@ YoriWinHexEditEnsureBufferLength(
         memcpy(NewBuffer, HexEdit->Buffer, (YORI_ALLOC_SIZE_T)HexEdit->BufferValid);
     }
 
-    if (HexEdit->Buffer != NULL) {
-        YoriLibDereference(HexEdit->Buffer);
-    }
+    YoriWinHexEditFreeBuffer(HexEdit);
     HexEdit->Buffer = NewBuffer;
     HexEdit->BufferAllocated = (YORI_ALLOC_SIZE_T)PaddedBufferLength;
 
@@ -2112,6 +2235,7 @@ YoriWinHexEditEnsureBufferValid(
         return FALSE;
     }
     ZeroMemory(YoriLibAddToPointer(HexEdit->Buffer, HexEdit->BufferValid), (DWORD)(NewBufferLength - HexEdit->BufferValid));
+    YoriWinHexEditExpandModifiedRange(HexEdit, HexEdit->BufferValid, NewBufferLength);
     HexEdit->BufferValid = NewBufferLength;
     return TRUE;
 }
@@ -2157,6 +2281,7 @@ YoriWinHexEditInsertSpaceInBuffer(
     ZeroMemory(&HexEdit->Buffer[BufferOffset], BytesToInsert);
     HexEdit->BufferValid = HexEdit->BufferValid + BytesToInsert;
     ASSERT(HexEdit->BufferValid <= HexEdit->BufferAllocated);
+    YoriWinHexEditExpandModifiedRange(HexEdit, BufferOffset, HexEdit->BufferValid);
 
     return TRUE;
 }
@@ -2292,6 +2417,7 @@ YoriWinHexEditInsertCell(
     if (CellUpdated) {
         ASSERT(CellType == YoriWinHexEditCellTypeHexDigit || CellType == YoriWinHexEditCellTypeCharValue);
         YoriWinHexEditNextCellSameType(HexEdit, CellType, BufferOffset, BitShift, &CurrentLine, &CurrentCharOffset);
+        YoriWinHexEditExpandModifiedRange(HexEdit, EditBufferOffset, EditBufferOffset + 1);
         HexEdit->UserModified = TRUE;
     }
 
@@ -2423,6 +2549,7 @@ YoriWinHexEditOverwriteCell(
         ASSERT(CellType == YoriWinHexEditCellTypeHexDigit || CellType == YoriWinHexEditCellTypeCharValue);
         YoriWinHexEditNextCellSameType(HexEdit, CellType, BufferOffset, BitShift, &CurrentLine, &CurrentCharOffset);
         YoriWinHexEditExpandDirtyRange(HexEdit, FirstLine, CurrentLine);
+        YoriWinHexEditExpandModifiedRange(HexEdit, EditBufferOffset, EditBufferOffset + 1);
         HexEdit->UserModified = TRUE;
     }
 
@@ -2463,14 +2590,14 @@ YoriWinHexEditSetDataNoCopy(
     Ctrl = (PYORI_WIN_CTRL)CtrlHandle;
     HexEdit = CONTAINING_RECORD(Ctrl, YORI_WIN_CTRL_HEX_EDIT, Ctrl);
 
-    if (HexEdit->Buffer != NULL) {
-        YoriLibDereference(HexEdit->Buffer);
-    }
+    YoriWinHexEditFreeBuffer(HexEdit);
 
     YoriLibReference(NewBuffer);
     HexEdit->Buffer = NewBuffer;
     HexEdit->BufferAllocated = NewBufferAllocated;
     HexEdit->BufferValid = NewBufferValid;
+    HexEdit->FirstModifiedOffset = 0;
+    HexEdit->BeyondLastModifiedOffset = 0;
 
     //
     //  Mark the whole range as dirty.  We didn't bother to count how many
@@ -2484,10 +2611,132 @@ YoriWinHexEditSetDataNoCopy(
     return TRUE;
 }
 
+/**
+ Assign a copy on write view of a file to a hex edit control.  The control
+ takes ownership of the view and will release it with UnmapViewOfFile.
+ Pages of the file are only brought into memory as they are displayed or
+ modified, and modifications are private to this process until they are
+ written back to the file by the caller.
+
+ @param CtrlHandle Pointer to the hex edit control.
+
+ @param MappedView Pointer to a view of a file mapped with FILE_MAP_COPY.
+
+ @param ViewLength Specifies the number of bytes in the view.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOLEAN
+YoriWinHexEditSetDataMapped(
+    __in PYORI_WIN_CTRL_HANDLE CtrlHandle,
+    __in PUCHAR MappedView,
+    __in YORI_ALLOC_SIZE_T ViewLength
+    )
+{
+    PYORI_WIN_CTRL_HEX_EDIT HexEdit;
+    PYORI_WIN_CTRL Ctrl;
+
+    Ctrl = (PYORI_WIN_CTRL)CtrlHandle;
+    HexEdit = CONTAINING_RECORD(Ctrl, YORI_WIN_CTRL_HEX_EDIT, Ctrl);
+
+    YoriWinHexEditFreeBuffer(HexEdit);
+
+    HexEdit->Buffer = MappedView;
+    HexEdit->BufferMapped = TRUE;
+    HexEdit->BufferAllocated = ViewLength;
+    HexEdit->BufferValid = ViewLength;
+    HexEdit->FirstModifiedOffset = 0;
+    HexEdit->BeyondLastModifiedOffset = 0;
+
+    YoriWinHexEditExpandDirtyRange(HexEdit, 0, (YORI_ALLOC_SIZE_T)-1);
+    YoriWinHexEditPaint(HexEdit);
+
+    return TRUE;
+}
+
+/**
+ Obtain a pointer to the data underlying the control without taking a
+ reference.  This works for both allocated and mapped buffers, but the
+ pointer is only valid until the control next processes events.
+
+ @param CtrlHandle Pointer to the hex edit control.
+
+ @param Buffer On successful completion, updated to point to the data behind
+        the hex edit control.
+
+ @param BufferLength On successful completion, updated to point to the number
+        of bytes in the Buffer allocation.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOLEAN
+YoriWinHexEditGetDataPointer(
+    __in PYORI_WIN_CTRL_HANDLE CtrlHandle,
+    __out PUCHAR *Buffer,
+    __out PYORI_ALLOC_SIZE_T BufferLength
+    )
+{
+    PYORI_WIN_CTRL_HEX_EDIT HexEdit;
+    PYORI_WIN_CTRL Ctrl;
+
+    Ctrl = (PYORI_WIN_CTRL)CtrlHandle;
+    HexEdit = CONTAINING_RECORD(Ctrl, YORI_WIN_CTRL_HEX_EDIT, Ctrl);
+
+    *Buffer = HexEdit->Buffer;
+    *BufferLength = HexEdit->BufferValid;
+
+    return TRUE;
+}
+
+/**
+ Return the range of bytes which have been modified since the data was
+ assigned to the control or the modify state was last reset.  This allows a
+ caller to write back only the modified range.  Note that operations which
+ change the length of the data report all bytes following the change as
+ modified.
+
+ @param CtrlHandle Pointer to the hex edit control.
+
+ @param FirstOffset On successful completion, updated to the offset of the
+        first modified byte.
+
+ @param BeyondLastOffset On successful completion, updated to the offset
+        beyond the last modified byte.
+
+ @return TRUE if any bytes have been modified, FALSE if none have.
+ */
+BOOLEAN
+YoriWinHexEditGetModifiedRange(
+    __in PYORI_WIN_CTRL_HANDLE CtrlHandle,
+    __out PYORI_ALLOC_SIZE_T FirstOffset,
+    __out PYORI_ALLOC_SIZE_T BeyondLastOffset
+    )
+{
+    PYORI_WIN_CTRL_HEX_EDIT HexEdit;
+    PYORI_WIN_CTRL Ctrl;
+
+    Ctrl = (PYORI_WIN_CTRL)CtrlHandle;
+    HexEdit = CONTAINING_RECORD(Ctrl, YORI_WIN_CTRL_HEX_EDIT, Ctrl);
+
+    *FirstOffset = HexEdit->FirstModifiedOffset;
+    *BeyondLastOffset = HexEdit->BeyondLastModifiedOffset;
+    if (HexEdit->BeyondLastModifiedOffset > HexEdit->BufferValid) {
+        *BeyondLastOffset = HexEdit->BufferValid;
+    }
+
+    if (*BeyondLastOffset <= *FirstOffset) {
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
 /**
  Obtain a referenced buffer to the data underlying the control.  Note that
  this buffer can be subsequently modified by the control, so this data is
- only stable until events are processed.
+ only stable until events are processed.  This fails if the control is
+ displaying a mapped view, which cannot be referenced; callers which can
+ tolerate this should use @ref YoriWinHexEditGetDataPointer .
 
  @param CtrlHandle Pointer to the hex edit control.
 
@@ -2514,6 +2763,10 @@ YoriWinHexEditGetDataNoCopy(
     Ctrl = (PYORI_WIN_CTRL)CtrlHandle;
     HexEdit = CONTAINING_RECORD(Ctrl, YORI_WIN_CTRL_HEX_EDIT, Ctrl);
 
+    if (HexEdit->BufferMapped) {
+        return FALSE;
+    }
+
     if (HexEdit->Buffer) {
         YoriLibReference(HexEdit->Buffer);
     }
@@ -3269,12 +3522,11 @@ YoriWinHexEditClear(
     Ctrl = (PYORI_WIN_CTRL)CtrlHandle;
     HexEdit = CONTAINING_RECORD(Ctrl, YORI_WIN_CTRL_HEX_EDIT, Ctrl);
 
-    if (HexEdit->Buffer != NULL) {
-        YoriLibDereference(HexEdit->Buffer);
-        HexEdit->Buffer = NULL;
-    }
+    YoriWinHexEditFreeBuffer(HexEdit);
     HexEdit->BufferAllocated = 0;
     HexEdit->BufferValid = 0;
+    HexEdit->FirstModifiedOffset = 0;
+    HexEdit->BeyondLastModifiedOffset = 0;
 
     HexEdit->ViewportTop = 0;
     HexEdit->ViewportLeft = 0;
@@ -3356,6 +3608,10 @@ YoriWinHexEditSetModifyState(
 
     PreviousValue = HexEdit->UserModified;
     HexEdit->UserModified = ModifyState;
+    if (!ModifyState) {
+        HexEdit->FirstModifiedOffset = 0;
+        HexEdit->BeyondLastModifiedOffset = 0;
+    }
     return PreviousValue;
 }
 
@@ -3685,6 +3941,12 @@ YoriWinHexEditDeleteData(
         LengthToRemove = HexEdit->BufferValid - DataOffset;
     }
 
+    if (!YoriWinHexEditUnmapBuffer(HexEdit)) {
+        return FALSE;
+    }
+
+    YoriWinHexEditExpandModifiedRange(HexEdit, DataOffset, HexEdit->BufferValid);
+
     if (HexEdit->BufferValid > DataOffset + LengthToRemove) {
         memmove(&HexEdit->Buffer[DataOffset],
                 &HexEdit->Buffer[DataOffset + LengthToRemove],
@@ -3781,6 +4043,7 @@ YoriWinHexEditReplaceData(
     memmove(&HexEdit->Buffer[DataOffset],
             Data,
             (DWORD)Length);
+    YoriWinHexEditExpandModifiedRange(HexEdit, DataOffset, DataOffset + Length);
 
     FirstDirtyLine = (YORI_ALLOC_SIZE_T)(DataOffset / HexEdit->BytesPerLine);
     LastDirtyLine = (YORI_ALLOC_SIZE_T)((DataOffset + Length) / HexEdit->BytesPerLine);
@@ -4903,10 +5166,7 @@ YoriWinHexEditEventHandler(
     HexEdit = CONTAINING_RECORD(Ctrl, YORI_WIN_CTRL_HEX_EDIT, Ctrl);
     switch(Event->EventType) {
         case YoriWinEventParentDestroyed:
-            if (HexEdit->Buffer != NULL) {
-                YoriLibDereference(HexEdit->Buffer);
-                HexEdit->Buffer = NULL;
-            }
+            YoriWinHexEditFreeBuffer(HexEdit);
             YoriLibFreeStringContents(&HexEdit->Caption);
             YoriWinDestroyControl(Ctrl);
             YoriLibDereference(HexEdit);
@@ -60,6 +60,20 @@ typedef struct _YORI_WIN_CTRL_LIST {
      */
     YORI_WIN_ITEM_ARRAY ItemArray;
 
+    /**
+     If non-NULL, the list is in virtual mode.  Items are not stored in
+     ItemArray; instead this callback is invoked to obtain the text of each
+     item when it is needed, which is typically only for the visible rows.
+     */
+    PYORI_WIN_LIST_GET_VIRTUAL_ITEM GetVirtualItemCallback;
+
+    /**
+     The number of items in the list.  For a list populated from ItemArray
+     this is the number of elements in the array.  For a virtual list this is
+     the count most recently supplied by the owner.
+     */
+    YORI_ALLOC_SIZE_T ItemCount;
+
     /**
      A string of keystrokes that the user has entered indicating the item to
      find.
@@ -174,8 +188,8 @@ YoriWinListEnsureActiveItemVisible(
         ElementCountToDisplay = ClientSize.Y;
     }
 
-    if (List->ItemArray.Count < ElementCountToDisplay) {
-        ElementCountToDisplay = (WORD)List->ItemArray.Count;
+    if (List->ItemCount < ElementCountToDisplay) {
+        ElementCountToDisplay = (WORD)List->ItemCount;
     }
 
     if (List->ActiveOption < List->FirstDisplayedOption) {
@@ -183,12 +197,12 @@ YoriWinListEnsureActiveItemVisible(
     }
 
     if (List->FirstDisplayedOption > 0 &&
-        List->FirstDisplayedOption + ElementCountToDisplay > List->ItemArray.Count) {
+        List->FirstDisplayedOption + ElementCountToDisplay > List->ItemCount) {
 
-        if (List->ItemArray.Count < ElementCountToDisplay) {
+        if (List->ItemCount < ElementCountToDisplay) {
             List->FirstDisplayedOption = 0;
         } else {
-            List->FirstDisplayedOption = (WORD)(List->ItemArray.Count - ElementCountToDisplay);
+            List->FirstDisplayedOption = (WORD)(List->ItemCount - ElementCountToDisplay);
         }
     }
 
@@ -285,6 +299,69 @@ YoriWinListGetVisibleCellCountPerItem(
     return CharsToDisplay;
 }
 
+/**
+ Return the text of an item within the list.  For a list populated from an
+ item array, the returned string refers to the array's buffer.  For a
+ virtual list, the owner's callback is invoked to supply the string.  In
+ either case the caller should free the string with
+ YoriLibFreeStringContents when it is no longer needed.
+
+ @param List Pointer to the list control.
+
+ @param Index Specifies the index of the item to return.
+
+ @param String On successful completion, populated with the text of the item.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+YoriWinListGetItemString(
+    __in PYORI_WIN_CTRL_LIST List,
+    __in YORI_ALLOC_SIZE_T Index,
+    __out PYORI_STRING String
+    )
+{
+    YoriLibInitEmptyString(String);
+    if (Index >= List->ItemCount) {
+        return FALSE;
+    }
+
+    if (List->GetVirtualItemCallback != NULL) {
+        if (!List->GetVirtualItemCallback(&List->Ctrl, Index, String)) {
+            YoriLibFreeStringContents(String);
+            return FALSE;
+        }
+        return TRUE;
+    }
+
+    String->StartOfString = List->ItemArray.Items[Index].String.StartOfString;
+    String->LengthInChars = List->ItemArray.Items[Index].String.LengthInChars;
+    return TRUE;
+}
+
+/**
+ Return the number of display cells needed to render an item, including
+ padding.
+
+ @param WinMgrHandle Pointer to the window manager.
+
+ @param Text Pointer to the text of the item.
+
+ @return The number of display cells needed to render the item.
+ */
+YORI_ALLOC_SIZE_T
+YoriWinListGetItemDisplayLength(
+    __in PYORI_WIN_WINDOW_MANAGER_HANDLE WinMgrHandle,
+    __in PYORI_STRING Text
+    )
+{
+    YORI_ALLOC_SIZE_T ThisLength;
+
+    YoriWinTextDisplayCellOffsetFromBufferOffset(WinMgrHandle, Text, 1, Text->LengthInChars - 1, &ThisLength);
+    return ThisLength + 2;
+}
+
 /**
  Render the current set of visible options into the window buffer when the
  list is configured to display each option on a seperate line.  This function
@@ -307,8 +384,10 @@ YoriWinListPaintVerticalList(
     WORD ElementCountToDisplay;
     WORD Attributes;
     WORD WindowAttributes;
-    PYORI_WIN_ITEM_ENTRY Element;
+    YORI_ALLOC_SIZE_T ItemIndex;
+    YORI_ALLOC_SIZE_T ItemLength;
     COORD ClientSize;
+    YORI_STRING ItemText;
     YORI_STRING DisplayCells;
     YORI_STRING VisibleString;
     PYORI_WIN_WINDOW TopLevelWindow;
@@ -323,23 +402,39 @@ YoriWinListPaintVerticalList(
     YoriWinGetControlClientSize(&List->Ctrl, &ClientSize);
     ElementCountToDisplay = ClientSize.Y;
 
-    if (List->ItemArray.Count < ElementCountToDisplay) {
-        ElementCountToDisplay = (WORD)List->ItemArray.Count;
+    if (List->ItemCount < ElementCountToDisplay) {
+        ElementCountToDisplay = (WORD)List->ItemCount;
     }
 
     MaxCharsToDisplay = YoriWinListGetVisibleCellCountPerItem(List);
 
     for (RowIndex = 0; RowIndex < ElementCountToDisplay; RowIndex++) {
-        Element = &List->ItemArray.Items[List->FirstDisplayedOption + RowIndex];
+        ItemIndex = List->FirstDisplayedOption + RowIndex;
+        if (!YoriWinListGetItemString(List, ItemIndex, &ItemText)) {
+            YoriLibInitEmptyString(&ItemText);
+        }
+
+        //
+        //  A virtual list cannot measure every item without fetching it, so
+        //  the longest item is the longest one that has been displayed
+        //
+
+        if (List->GetVirtualItemCallback != NULL) {
+            ItemLength = YoriWinListGetItemDisplayLength(WinMgrHandle, &ItemText);
+            if (ItemLength > List->LongestItemLength) {
+                List->LongestItemLength = ItemLength;
+            }
+        }
+
         Attributes = WindowAttributes;
         if (List->ItemActive &&
-            RowIndex + List->FirstDisplayedOption == List->ActiveOption) {
+            ItemIndex == List->ActiveOption) {
 
             Attributes = List->ActiveAttributes;
         }
 
         YoriWinTextBufferOffsetFromDisplayCellOffset(WinMgrHandle,
-                                                     &Element->String,
+                                                     &ItemText,
                                                      1,
                                                      List->DisplayOffset,
                                                      FALSE,
@@ -347,8 +442,8 @@ YoriWinListPaintVerticalList(
                                                      &Remainder);
 
         YoriLibInitEmptyString(&VisibleString);
-        VisibleString.StartOfString = &Element->String.StartOfString[ViewportBufferOffset];
-        VisibleString.LengthInChars = Element->String.LengthInChars - ViewportBufferOffset;
+        VisibleString.StartOfString = &ItemText.StartOfString[ViewportBufferOffset];
+        VisibleString.LengthInChars = ItemText.LengthInChars - ViewportBufferOffset;
 
         YoriLibInitEmptyString(&DisplayCells);
         if (!YoriWinTextStringToDisplayCells(WinMgrHandle,
@@ -357,8 +452,8 @@ YoriWinListPaintVerticalList(
                                              1,
                                              ClientSize.X,
                                              &DisplayCells)) {
-            DisplayCells.StartOfString = Element->String.StartOfString;
-            DisplayCells.LengthInChars = Element->String.LengthInChars;
+            DisplayCells.StartOfString = ItemText.StartOfString;
+            DisplayCells.LengthInChars = ItemText.LengthInChars;
         }
 
         CharsToDisplay = MaxCharsToDisplay;
@@ -366,7 +461,7 @@ YoriWinListPaintVerticalList(
             CharsToDisplay = (WORD)DisplayCells.LengthInChars;
         }
         if (List->MultiSelect) {
-            if (Element->Flags & YORI_WIN_ITEM_SELECTED) {
+            if (List->ItemArray.Items[ItemIndex].Flags & YORI_WIN_ITEM_SELECTED) {
                 YoriWinSetControlClientCell(&List->Ctrl, 0, RowIndex, '*', Attributes);
             } else {
                 YoriWinSetControlClientCell(&List->Ctrl, 0, RowIndex, ' ', Attributes);
@@ -388,6 +483,7 @@ YoriWinListPaintVerticalList(
             }
         }
         YoriLibFreeStringContents(&DisplayCells);
+        YoriLibFreeStringContents(&ItemText);
     }
 
     //
@@ -426,8 +522,8 @@ YoriWinListPaintVerticalList(
 
     if (List->VScrollCtrl) {
         DWORD MaximumTopValue;
-        if (List->ItemArray.Count > (DWORD)ClientSize.Y) {
-            MaximumTopValue = List->ItemArray.Count - ClientSize.Y;
+        if (List->ItemCount > (DWORD)ClientSize.Y) {
+            MaximumTopValue = List->ItemCount - ClientSize.Y;
         } else {
             MaximumTopValue = 0;
         }
@@ -488,8 +584,9 @@ YoriWinListPaintHorizontalList(
     WORD ElementCountToDisplay;
     WORD Attributes;
     WORD WindowAttributes;
-    PYORI_WIN_ITEM_ENTRY Element;
+    YORI_ALLOC_SIZE_T ItemIndex;
     COORD ClientSize;
+    YORI_STRING ItemText;
     YORI_STRING DisplayLine;
     PYORI_WIN_WINDOW TopLevelWindow;
     PYORI_WIN_WINDOW_MANAGER_HANDLE WinMgrHandle;
@@ -501,23 +598,26 @@ YoriWinListPaintHorizontalList(
     YoriWinGetControlClientSize(&List->Ctrl, &ClientSize);
     ElementCountToDisplay = (WORD)(ClientSize.X / List->HorizontalItemWidth);
 
-    if (List->ItemArray.Count < ElementCountToDisplay) {
-        ElementCountToDisplay = (WORD)List->ItemArray.Count;
+    if (List->ItemCount < ElementCountToDisplay) {
+        ElementCountToDisplay = (WORD)List->ItemCount;
     }
 
     for (RowIndex = 0; RowIndex < ElementCountToDisplay; RowIndex++) {
-        Element = &List->ItemArray.Items[List->FirstDisplayedOption + RowIndex];
+        ItemIndex = List->FirstDisplayedOption + RowIndex;
+        if (!YoriWinListGetItemString(List, ItemIndex, &ItemText)) {
+            YoriLibInitEmptyString(&ItemText);
+        }
         CellOffset = (WORD)(List->HorizontalItemWidth * RowIndex);
         Attributes = WindowAttributes;
         if (List->ItemActive &&
-            RowIndex + List->FirstDisplayedOption == List->ActiveOption) {
+            ItemIndex == List->ActiveOption) {
 
             Attributes = (WORD)(((Attributes & 0xf0) >> 4) | ((Attributes & 0x0f) << 4));
         }
         YoriLibInitEmptyString(&DisplayLine);
-        if (!YoriWinTextStringToDisplayCells(WinMgrHandle, &Element->String, 0, 3, List->HorizontalItemWidth, &DisplayLine)) {
-            DisplayLine.StartOfString = Element->String.StartOfString;
-            DisplayLine.LengthInChars = Element->String.LengthInChars;
+        if (!YoriWinTextStringToDisplayCells(WinMgrHandle, &ItemText, 0, 3, List->HorizontalItemWidth, &DisplayLine)) {
+            DisplayLine.StartOfString = ItemText.StartOfString;
+            DisplayLine.LengthInChars = ItemText.LengthInChars;
         }
         if (List->MultiSelect) {
             CharsToDisplay = (WORD)(List->HorizontalItemWidth - 4);
@@ -525,7 +625,7 @@ YoriWinListPaintHorizontalList(
                 CharsToDisplay = (WORD)DisplayLine.LengthInChars;
             }
             YoriWinSetControlClientCell(&List->Ctrl, CellOffset, 0, ' ', Attributes);
-            if (Element->Flags & YORI_WIN_ITEM_SELECTED) {
+            if (List->ItemArray.Items[ItemIndex].Flags & YORI_WIN_ITEM_SELECTED) {
                 YoriWinSetControlClientCell(&List->Ctrl, (WORD)(CellOffset + 1), 0, '*', Attributes);
             } else {
                 YoriWinSetControlClientCell(&List->Ctrl, (WORD)(CellOffset + 1), 0, ' ', Attributes);
@@ -552,6 +652,7 @@ YoriWinListPaintHorizontalList(
             }
         }
         YoriLibFreeStringContents(&DisplayLine);
+        YoriLibFreeStringContents(&ItemText);
     }
 
     //
@@ -601,20 +702,26 @@ YoriWinListPaint(
 }
 
 /**
- Scan through all items in the list to determine the length of the longest
- item.
+ Scan through items in the list to determine the length of the longest
+ item.  When items are appended, only the new items need to be measured,
+ since the existing items are already reflected in the longest item length.
+ This is not used for a virtual list, where the longest item is updated as
+ items are displayed.
 
  @param List Pointer to the list control.
+
+ @param FirstIndex Specifies the first item to measure.  If zero, the length
+        is recalculated from scratch.
  */
 VOID
 YoriWinListRecalculateLongestItem(
-    __in PYORI_WIN_CTRL_LIST List
+    __in PYORI_WIN_CTRL_LIST List,
+    __in YORI_ALLOC_SIZE_T FirstIndex
     )
 {
     YORI_ALLOC_SIZE_T Index;
     YORI_ALLOC_SIZE_T LongestItemLength;
     YORI_ALLOC_SIZE_T ThisLength;
-    PYORI_STRING Text;
     PYORI_WIN_WINDOW TopLevelWindow;
     PYORI_WIN_WINDOW_MANAGER_HANDLE WinMgrHandle;
 
@@ -622,10 +729,12 @@ YoriWinListRecalculateLongestItem(
     WinMgrHandle = YoriWinGetWindowManagerHandle(TopLevelWindow);
 
     LongestItemLength = 0;
-    for (Index = 0; Index < List->ItemArray.Count; Index++) {
-        Text = &List->ItemArray.Items[Index].String;
-        YoriWinTextDisplayCellOffsetFromBufferOffset(WinMgrHandle, Text, 1, Text->LengthInChars - 1, &ThisLength);
-        ThisLength = ThisLength + 2;
+    if (FirstIndex > 0) {
+        LongestItemLength = List->LongestItemLength;
+    }
+
+    for (Index = FirstIndex; Index < List->ItemCount; Index++) {
+        ThisLength = YoriWinListGetItemDisplayLength(WinMgrHandle, &List->ItemArray.Items[Index].String);
         if (ThisLength > LongestItemLength) {
             LongestItemLength = ThisLength;
         }
@@ -654,6 +763,8 @@ YoriWinListClearAllItems(
     List = CONTAINING_RECORD(Ctrl, YORI_WIN_CTRL_LIST, Ctrl);
 
     YoriWinItemArrayCleanup(&List->ItemArray);
+    List->GetVirtualItemCallback = NULL;
+    List->ItemCount = 0;
     List->FirstDisplayedOption = 0;
     List->ActiveOption = 0;
     if (List->ItemActive) {
@@ -663,7 +774,7 @@ YoriWinListClearAllItems(
         }
     }
     List->DisplayOffset = 0;
-    YoriWinListRecalculateLongestItem(List);
+    YoriWinListRecalculateLongestItem(List, 0);
     YoriWinListPaint(List);
     return TRUE;
 }
@@ -722,16 +833,16 @@ YoriWinListNotifyVScrollChange(
     ElementCountToDisplay = ClientSize.Y;
 
     ScrollValue = YoriWinScrollBarGetPosition(ScrollCtrl);
-    ASSERT(ScrollValue <= List->ItemArray.Count);
-    if (ScrollValue + ElementCountToDisplay > List->ItemArray.Count) {
-        if (List->ItemArray.Count >= ElementCountToDisplay) {
-            List->FirstDisplayedOption = List->ItemArray.Count - ElementCountToDisplay;
+    ASSERT(ScrollValue <= List->ItemCount);
+    if (ScrollValue + ElementCountToDisplay > List->ItemCount) {
+        if (List->ItemCount >= ElementCountToDisplay) {
+            List->FirstDisplayedOption = List->ItemCount - ElementCountToDisplay;
         } else {
             List->FirstDisplayedOption = 0;
         }
     } else {
 
-        if (ScrollValue < List->ItemArray.Count) {
+        if (ScrollValue < List->ItemCount) {
             List->FirstDisplayedOption = (YORI_ALLOC_SIZE_T)ScrollValue;
         }
     }
@@ -769,9 +880,9 @@ YoriWinListNotifyMouseWheel(
             List->FirstDisplayedOption = List->FirstDisplayedOption - LinesToMove;
         }
     } else {
-        if (List->FirstDisplayedOption + LinesToMove + ElementCountToDisplay > List->ItemArray.Count) {
-            if (List->ItemArray.Count >= ElementCountToDisplay) {
-                List->FirstDisplayedOption = List->ItemArray.Count - ElementCountToDisplay;
+        if (List->FirstDisplayedOption + LinesToMove + ElementCountToDisplay > List->ItemCount) {
+            if (List->ItemCount >= ElementCountToDisplay) {
+                List->FirstDisplayedOption = List->ItemCount - ElementCountToDisplay;
             } else {
                 List->FirstDisplayedOption = 0;
             }
@@ -814,7 +925,7 @@ YoriWinListGetItemSelectedByMouseLocation(
         ItemRelativeToFirstDisplayed = MousePos.Y;
     }
 
-    if (ItemRelativeToFirstDisplayed + List->FirstDisplayedOption < List->ItemArray.Count) {
+    if (ItemRelativeToFirstDisplayed + List->FirstDisplayedOption < List->ItemCount) {
         *SelectedItem = ItemRelativeToFirstDisplayed + List->FirstDisplayedOption;
         return TRUE;
     }
@@ -822,6 +933,40 @@ YoriWinListGetItemSelectedByMouseLocation(
     return FALSE;
 }
 
+/**
+ Indicate whether an item in the list begins with the search string that the
+ user has typed.
+
+ @param List Pointer to the list control.
+
+ @param Index Specifies the index of the item to test.
+
+ @return TRUE if the item matches the search string, FALSE if it does not.
+ */
+BOOLEAN
+YoriWinListItemMatchesSearch(
+    __in PYORI_WIN_CTRL_LIST List,
+    __in YORI_ALLOC_SIZE_T Index
+    )
+{
+    YORI_STRING ItemText;
+    BOOLEAN Result;
+
+    if (!YoriWinListGetItemString(List, Index, &ItemText)) {
+        return FALSE;
+    }
+
+    Result = FALSE;
+    if (ItemText.LengthInChars > 0 &&
+        YoriLibCompareStringInsCnt(&List->SearchString, &ItemText, List->SearchString.LengthInChars) == 0) {
+
+        Result = TRUE;
+    }
+
+    YoriLibFreeStringContents(&ItemText);
+    return Result;
+}
+
 /**
  Given a user pressed character, look for an item in the list that starts with
  the character.  This might get smarter for consecutive characters someday.
@@ -840,7 +985,6 @@ YoriWinListFindItemByChar(
     )
 {
     YORI_ALLOC_SIZE_T Index;
-    PYORI_WIN_ITEM_ENTRY Element;
     DWORD CurrentTick;
 
     //
@@ -875,11 +1019,8 @@ YoriWinListFindItemByChar(
 
     if (!List->ItemActive) {
 
-        for (Index = 0; Index < List->ItemArray.Count; Index++) {
-            Element = &List->ItemArray.Items[Index];
-            if (Element->String.LengthInChars > 0 &&
-                YoriLibCompareStringInsCnt(&List->SearchString, &Element->String, List->SearchString.LengthInChars) == 0) {
-
+        for (Index = 0; Index < List->ItemCount; Index++) {
+            if (YoriWinListItemMatchesSearch(List, Index)) {
                 List->ItemActive = TRUE;
                 List->ActiveOption = Index;
                 return TRUE;
@@ -888,21 +1029,15 @@ YoriWinListFindItemByChar(
 
     } else {
 
-        for (Index = List->ActiveOption; Index < List->ItemArray.Count; Index++) {
-            Element = &List->ItemArray.Items[Index];
-            if (Element->String.LengthInChars > 0 &&
-                YoriLibCompareStringInsCnt(&List->SearchString, &Element->String, List->SearchString.LengthInChars) == 0) {
-
+        for (Index = List->ActiveOption; Index < List->ItemCount; Index++) {
+            if (YoriWinListItemMatchesSearch(List, Index)) {
                 List->ActiveOption = Index;
                 return TRUE;
             }
         }
 
         for (Index = 0; Index < List->ActiveOption; Index++) {
-            Element = &List->ItemArray.Items[Index];
-            if (Element->String.LengthInChars > 0 &&
-                YoriLibCompareStringInsCnt(&List->SearchString, &Element->String, List->SearchString.LengthInChars) == 0) {
-
+            if (YoriWinListItemMatchesSearch(List, Index)) {
                 List->ActiveOption = Index;
                 return TRUE;
             }
@@ -951,7 +1086,7 @@ YoriWinListEventHandler(
                             }
                             YoriWinListPaint(List);
                         }
-                    } else if (List->ItemArray.Count > 0) {
+                    } else if (List->ItemCount > 0) {
                         List->ItemActive = TRUE;
                         List->ActiveOption = 0;
                         YoriWinListEnsureActiveItemVisible(List);
@@ -963,7 +1098,7 @@ YoriWinListEventHandler(
                 } else if (Event->KeyDown.VirtualKeyCode == VK_DOWN ||
                     (List->HorizontalDisplay && Event->KeyDown.VirtualKeyCode == VK_RIGHT)) {
                     if (List->ItemActive) {
-                        if (List->ActiveOption + 1 < List->ItemArray.Count) {
+                        if (List->ActiveOption + 1 < List->ItemCount) {
                             List->ActiveOption++;
                             YoriWinListEnsureActiveItemVisible(List);
                             if (List->SelectionChangeCallback) {
@@ -971,7 +1106,7 @@ YoriWinListEventHandler(
                             }
                             YoriWinListPaint(List);
                         }
-                    } else if (List->ItemArray.Count > 0) {
+                    } else if (List->ItemCount > 0) {
                         List->ItemActive = TRUE;
                         List->ActiveOption = 0;
                         YoriWinListEnsureActiveItemVisible(List);
@@ -993,7 +1128,7 @@ YoriWinListEventHandler(
                         } else {
                             List->ActiveOption = 0;
                         }
-                    } else if (List->ItemArray.Count > 0) {
+                    } else if (List->ItemCount > 0) {
                         List->ItemActive = TRUE;
                         List->ActiveOption = 0;
                     }
@@ -1009,14 +1144,14 @@ YoriWinListEventHandler(
                         YoriWinGetControlClientSize(&List->Ctrl, &ClientSize);
                         ElementCountToDisplay = ClientSize.Y;
                         if (List->ActiveOption < List->FirstDisplayedOption + ElementCountToDisplay - 1 &&
-                            List->FirstDisplayedOption + ElementCountToDisplay - 1 < List->ItemArray.Count) {
+                            List->FirstDisplayedOption + ElementCountToDisplay - 1 < List->ItemCount) {
                             List->ActiveOption = List->FirstDisplayedOption + ElementCountToDisplay - 1;
-                        } else if (List->ActiveOption + ElementCountToDisplay < List->ItemArray.Count) {
+                        } else if (List->ActiveOption + ElementCountToDisplay < List->ItemCount) {
                             List->ActiveOption = List->ActiveOption + ElementCountToDisplay;
                         } else {
-                            List->ActiveOption = List->ItemArray.Count - 1;
+                            List->ActiveOption = List->ItemCount - 1;
                         }
-                    } else if (List->ItemArray.Count > 0) {
+                    } else if (List->ItemCount > 0) {
                         List->ItemActive = TRUE;
                         List->ActiveOption = 0;
                     }
@@ -1044,7 +1179,7 @@ YoriWinListEventHandler(
                            List->MultiSelect) {
                     PYORI_WIN_ITEM_ENTRY Element;
 
-                    ASSERT(List->ActiveOption < List->ItemArray.Count);
+                    ASSERT(List->ActiveOption < List->ItemCount);
                     Element = &List->ItemArray.Items[List->ActiveOption];
                     Element->Flags = Element->Flags ^ YORI_WIN_ITEM_SELECTED;
                     if (List->SelectionChangeCallback) {
@@ -1181,7 +1316,7 @@ YoriWinListGetItemCount(
     PYORI_WIN_CTRL_LIST List;
     Ctrl = (PYORI_WIN_CTRL)CtrlHandle;
     List = CONTAINING_RECORD(Ctrl, YORI_WIN_CTRL_LIST, Ctrl);
-    return List->ItemArray.Count;
+    return List->ItemCount;
 }
 
 /**
@@ -1233,7 +1368,7 @@ YoriWinListSetActiveOption(
     Ctrl = (PYORI_WIN_CTRL)CtrlHandle;
     List = CONTAINING_RECORD(Ctrl, YORI_WIN_CTRL_LIST, Ctrl);
 
-    if (ActiveOption < List->ItemArray.Count) {
+    if (ActiveOption < List->ItemCount) {
         List->ItemActive = TRUE;
         List->ActiveOption = ActiveOption;
         YoriWinListEnsureActiveItemVisible(List);
@@ -1269,7 +1404,7 @@ YoriWinListIsOptionSelected(
     Ctrl = (PYORI_WIN_CTRL)CtrlHandle;
     List = CONTAINING_RECORD(Ctrl, YORI_WIN_CTRL_LIST, Ctrl);
 
-    if (Index < List->ItemArray.Count) {
+    if (Index < List->ItemCount) {
         if (List->MultiSelect) {
             if (List->ItemArray.Items[Index].Flags & YORI_WIN_ITEM_SELECTED) {
                 return TRUE;
@@ -1306,17 +1441,24 @@ YoriWinListAddItems(
 {
     PYORI_WIN_CTRL Ctrl;
     PYORI_WIN_CTRL_LIST List;
+    YORI_ALLOC_SIZE_T FirstNewItem;
 
     Ctrl = (PYORI_WIN_CTRL)CtrlHandle;
     List = CONTAINING_RECORD(Ctrl, YORI_WIN_CTRL_LIST, Ctrl);
 
+    if (List->GetVirtualItemCallback != NULL) {
+        return FALSE;
+    }
+
+    FirstNewItem = List->ItemCount;
     if (!YoriWinItemArrayAddItems(&List->ItemArray, ListOptions, NumberOptions)) {
         return FALSE;
     }
+    List->ItemCount = List->ItemArray.Count;
 
     YoriWinListEnsureActiveItemVisible(List);
     List->DisplayOffset = 0;
-    YoriWinListRecalculateLongestItem(List);
+    YoriWinListRecalculateLongestItem(List, FirstNewItem);
     YoriWinListPaint(List);
     return TRUE;
 }
@@ -1339,17 +1481,24 @@ YoriWinListAddItemArray(
 {
     PYORI_WIN_CTRL Ctrl;
     PYORI_WIN_CTRL_LIST List;
+    YORI_ALLOC_SIZE_T FirstNewItem;
 
     Ctrl = (PYORI_WIN_CTRL)CtrlHandle;
     List = CONTAINING_RECORD(Ctrl, YORI_WIN_CTRL_LIST, Ctrl);
 
+    if (List->GetVirtualItemCallback != NULL) {
+        return FALSE;
+    }
+
+    FirstNewItem = List->ItemCount;
     if (!YoriWinItemArrayAddItemArray(&List->ItemArray, NewItems)) {
         return FALSE;
     }
+    List->ItemCount = List->ItemArray.Count;
 
     YoriWinListEnsureActiveItemVisible(List);
     List->DisplayOffset = 0;
-    YoriWinListRecalculateLongestItem(List);
+    YoriWinListRecalculateLongestItem(List, FirstNewItem);
     YoriWinListPaint(List);
     return TRUE;
 }
@@ -1376,20 +1525,19 @@ YoriWinListGetItemText(
 {
     PYORI_WIN_CTRL Ctrl;
     PYORI_WIN_CTRL_LIST List;
-    PYORI_STRING Source;
+    YORI_STRING Source;
 
     Ctrl = (PYORI_WIN_CTRL)CtrlHandle;
     List = CONTAINING_RECORD(Ctrl, YORI_WIN_CTRL_LIST, Ctrl);
 
-    if (Index >= List->ItemArray.Count) {
+    if (!YoriWinListGetItemString(List, Index, &Source)) {
         return FALSE;
     }
 
-    Source = &List->ItemArray.Items[Index].String;
-
-    if (Text->LengthAllocated < Source->LengthInChars + 1) {
+    if (Text->LengthAllocated < Source.LengthInChars + 1) {
         YORI_STRING NewString;
-        if (!YoriLibAllocateString(&NewString, Source->LengthInChars + 1)) {
+        if (!YoriLibAllocateString(&NewString, Source.LengthInChars + 1)) {
+            YoriLibFreeStringContents(&Source);
             return FALSE;
         }
 
@@ -1397,9 +1545,113 @@ YoriWinListGetItemText(
         memcpy(Text, &NewString, sizeof(YORI_STRING));
     }
 
-    memcpy(Text->StartOfString, Source->StartOfString, Source->LengthInChars * sizeof(TCHAR));
-    Text->LengthInChars = Source->LengthInChars;
-    Text->StartOfString[Source->LengthInChars] = '\0';
+    memcpy(Text->StartOfString, Source.StartOfString, Source.LengthInChars * sizeof(TCHAR));
+    Text->LengthInChars = Source.LengthInChars;
+    Text->StartOfString[Source.LengthInChars] = '\0';
+    YoriLibFreeStringContents(&Source);
+    return TRUE;
+}
+
+/**
+ Configure the list control to display items supplied on demand by a
+ callback rather than items copied into the control.  The callback is only
+ invoked for items that are displayed, searched, or requested via
+ YoriWinListGetItemText, so a very large list can be displayed without
+ constructing a string for every item in advance.  Any existing items are
+ removed.  Virtual lists do not support multiple selection.
+
+ @param CtrlHandle Pointer to the list control.
+
+ @param GetItemCallback Pointer to a function to invoke to obtain the text of
+        an item.
+
+ @param ItemCount Specifies the number of items in the list.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+YoriWinListSetVirtualItems(
+    __in PYORI_WIN_CTRL_HANDLE CtrlHandle,
+    __in PYORI_WIN_LIST_GET_VIRTUAL_ITEM GetItemCallback,
+    __in YORI_ALLOC_SIZE_T ItemCount
+    )
+{
+    PYORI_WIN_CTRL Ctrl;
+    PYORI_WIN_CTRL_LIST List;
+
+    Ctrl = (PYORI_WIN_CTRL)CtrlHandle;
+    List = CONTAINING_RECORD(Ctrl, YORI_WIN_CTRL_LIST, Ctrl);
+
+    if (List->MultiSelect) {
+        return FALSE;
+    }
+
+    YoriWinItemArrayCleanup(&List->ItemArray);
+    List->GetVirtualItemCallback = GetItemCallback;
+    List->ItemCount = ItemCount;
+    List->FirstDisplayedOption = 0;
+    List->ActiveOption = 0;
+    if (List->ItemActive) {
+        List->ItemActive = FALSE;
+        if (List->SelectionChangeCallback) {
+            List->SelectionChangeCallback(&List->Ctrl);
+        }
+    }
+    List->DisplayOffset = 0;
+    List->LongestItemLength = 0;
+    YoriWinListPaint(List);
+    return TRUE;
+}
+
+/**
+ Update the number of items in a virtual list control.  This allows an owner
+ that is still enumerating items to display the items found so far and
+ extend the list as more are found, without rebuilding the list.  The active
+ item and scroll position are retained where they remain valid.  This
+ function also causes displayed items to be requested again, so it can be
+ used to refresh the list after the owner's items change.
+
+ @param CtrlHandle Pointer to the list control.
+
+ @param ItemCount Specifies the new number of items in the list.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+YoriWinListSetVirtualItemCount(
+    __in PYORI_WIN_CTRL_HANDLE CtrlHandle,
+    __in YORI_ALLOC_SIZE_T ItemCount
+    )
+{
+    PYORI_WIN_CTRL Ctrl;
+    PYORI_WIN_CTRL_LIST List;
+
+    Ctrl = (PYORI_WIN_CTRL)CtrlHandle;
+    List = CONTAINING_RECORD(Ctrl, YORI_WIN_CTRL_LIST, Ctrl);
+
+    if (List->GetVirtualItemCallback == NULL) {
+        return FALSE;
+    }
+
+    List->ItemCount = ItemCount;
+    if (List->FirstDisplayedOption >= ItemCount) {
+        List->FirstDisplayedOption = 0;
+    }
+
+    if (List->ActiveOption >= ItemCount) {
+        List->ActiveOption = 0;
+        if (List->ItemActive) {
+            List->ItemActive = FALSE;
+            if (List->SelectionChangeCallback) {
+                List->SelectionChangeCallback(&List->Ctrl);
+            }
+        }
+    }
+
+    YoriWinListEnsureActiveItemVisible(List);
+    YoriWinListPaint(List);
     return TRUE;
 }
 
@@ -45,6 +45,12 @@
 #define YORI_WIN_MULTILINE_EDIT_LINE_PADDING (0x40)
 #endif
 
+/**
+ The default maximum amount of memory, in bytes, that undo history can
+ consume before the oldest changes are discarded.
+ */
+#define YORI_WIN_MULTILINE_EDIT_DEFAULT_UNDO_BUDGET (64 * 1024 * 1024)
+
 /**
  Information about the selection region within a multiline edit control.
  */
@@ -119,6 +125,12 @@ typedef struct _YORI_WIN_CTRL_MULTILINE_EDIT_UNDO {
      */
     BOOLEAN ChainWithNext;
 
+    /**
+     The number of bytes of memory this record was charged against the undo
+     budget when it was last measured.
+     */
+    YORI_ALLOC_SIZE_T BytesCharged;
+
     /**
      Information specific to each type of operation.
      */
@@ -255,13 +267,57 @@ typedef struct _YORI_WIN_CTRL_MULTILINE_EDIT {
      */
     PYORI_WIN_NOTIFY_MULTILINE_EDIT_CURSOR_MOVE CursorMoveCallback;
 
+    /**
+     Optional pointer to a callback to invoke to determine the colors of
+     text on each displayed line.
+     */
+    PYORI_WIN_NOTIFY_MULTILINE_EDIT_HIGHLIGHT_LINE HighlightCallback;
+
+    /**
+     An array of highlight states, indexed by line, recording the state
+     returned by HighlightCallback at the end of each line.  Since the state
+     at the end of one line is the state at the start of the next, this
+     allows constructs such as block comments to span lines without
+     evaluating the entire buffer each time a line is displayed.
+     */
+    PDWORD HighlightStates;
+
+    /**
+     The number of elements allocated in HighlightStates.
+     */
+    YORI_ALLOC_SIZE_T HighlightStatesAllocated;
+
+    /**
+     The number of lines, from the top of the buffer, which have a valid
+     entry in HighlightStates.  Modifying a line reduces this to the
+     modified line, and later states are recalculated only as far as is
+     needed to display lines.
+     */
+    YORI_ALLOC_SIZE_T HighlightStatesValid;
+
+    /**
+     A buffer used when displaying a line which contains the attributes of
+     each character in the line followed by the attributes of each visible
+     display cell.
+     */
+    PWORD HighlightAttributes;
+
+    /**
+     The number of elements allocated in HighlightAttributes.
+     */
+    YORI_ALLOC_SIZE_T HighlightAttributesAllocated;
+
     /**
      The caption to display above the edit control.
      */
     YORI_STRING Caption;
 
     /**
-     An array of lines corresponding to lines within a file.
+     An array of lines corresponding to lines within a file.  This is
+     maintained as a gap buffer: lines before GapStart are stored at their
+     index, and lines at or after GapStart are stored after a gap of
+     unpopulated entries.  Lines should be accessed via
+     YoriWinMultilineEditGetLine rather than indexing this array directly.
      */
     PYORI_STRING LineArray;
 
@@ -275,6 +331,15 @@ typedef struct _YORI_WIN_CTRL_MULTILINE_EDIT {
      */
     YORI_ALLOC_SIZE_T LinesPopulated;
 
+    /**
+     The logical line index where the gap of unpopulated entries within
+     LineArray begins.  The gap is LinesAllocated - LinesPopulated entries
+     long.  Inserting or deleting lines moves the gap to the point of the
+     change, so repeated edits in one area only move the lines between the
+     previous and current edit rather than every line after the edit.
+     */
+    YORI_ALLOC_SIZE_T GapStart;
+
     /**
      A stack of changes which can be undone.
      */
@@ -285,6 +350,19 @@ typedef struct _YORI_WIN_CTRL_MULTILINE_EDIT {
      */
     YORI_LIST_ENTRY Redo;
 
+    /**
+     The number of bytes of memory consumed by records on the undo and redo
+     stacks.
+     */
+    DWORDLONG UndoBytesCharged;
+
+    /**
+     The maximum number of bytes of memory that records on the undo stack
+     should consume.  When this is exceeded, the oldest records are
+     discarded.  Zero indicates no limit.
+     */
+    DWORDLONG UndoBudget;
+
     /**
      The index within LineArray that is displayed at the top of the control.
      */
@@ -481,6 +559,71 @@ typedef struct _YORI_WIN_CTRL_MULTILINE_EDIT {
 
 } YORI_WIN_CTRL_MULTILINE_EDIT, *PYORI_WIN_CTRL_MULTILINE_EDIT;
 
+//
+//  =========================================
+//  LINE ARRAY FUNCTIONS
+//  =========================================
+//
+
+/**
+ Return the string for a line within the multiline edit control.
+
+ @param MultilineEdit Pointer to the multiline edit control.
+
+ @param LineIndex Specifies the logical index of the line to return.
+
+ @return Pointer to the line.  This pointer is only valid until lines are
+         inserted or deleted.
+ */
+PYORI_STRING
+YoriWinMultilineEditGetLine(
+    __in PYORI_WIN_CTRL_MULTILINE_EDIT MultilineEdit,
+    __in YORI_ALLOC_SIZE_T LineIndex
+    )
+{
+    if (LineIndex < MultilineEdit->GapStart) {
+        return &MultilineEdit->LineArray[LineIndex];
+    }
+
+    return &MultilineEdit->LineArray[LineIndex + MultilineEdit->LinesAllocated - MultilineEdit->LinesPopulated];
+}
+
+/**
+ Move the gap within the line array so that it begins at the specified
+ logical line.  This moves only the lines between the current gap location
+ and the new one.
+
+ @param MultilineEdit Pointer to the multiline edit control.
+
+ @param NewGapStart Specifies the logical line index that the gap should
+        begin at.
+ */
+VOID
+YoriWinMultilineEditMoveGap(
+    __in PYORI_WIN_CTRL_MULTILINE_EDIT MultilineEdit,
+    __in YORI_ALLOC_SIZE_T NewGapStart
+    )
+{
+    YORI_ALLOC_SIZE_T GapLength;
+
+    ASSERT(NewGapStart <= MultilineEdit->LinesPopulated);
+
+    GapLength = MultilineEdit->LinesAllocated - MultilineEdit->LinesPopulated;
+    if (GapLength > 0) {
+        if (NewGapStart < MultilineEdit->GapStart) {
+            memmove(&MultilineEdit->LineArray[NewGapStart + GapLength],
+                    &MultilineEdit->LineArray[NewGapStart],
+                    (MultilineEdit->GapStart - NewGapStart) * sizeof(YORI_STRING));
+        } else if (NewGapStart > MultilineEdit->GapStart) {
+            memmove(&MultilineEdit->LineArray[MultilineEdit->GapStart],
+                    &MultilineEdit->LineArray[MultilineEdit->GapStart + GapLength],
+                    (NewGapStart - MultilineEdit->GapStart) * sizeof(YORI_STRING));
+        }
+    }
+
+    MultilineEdit->GapStart = NewGapStart;
+}
+
 //
 //  =========================================
 //  DISPLAY FUNCTIONS
@@ -555,7 +698,7 @@ YoriWinMultilineEditFindCursorCharFromDisplayChar(
         return;
     }
 
-    Line = &MultilineEdit->LineArray[LineIndex];
+    Line = YoriWinMultilineEditGetLine(MultilineEdit, LineIndex);
 
     YoriWinTextBufferOffsetFromDisplayCellOffset(WinMgrHandle,
                                                  Line,
@@ -600,7 +743,7 @@ YoriWinMultilineEditFindDisplayCharFromCursorChar(
         return;
     }
 
-    Line = &MultilineEdit->LineArray[LineIndex];
+    Line = YoriWinMultilineEditGetLine(MultilineEdit, LineIndex);
 
     YoriWinTextDisplayCellOffsetFromBufferOffset(WinMgrHandle,
                                                  Line,
@@ -851,7 +994,7 @@ YoriWinMultilineEditGenerateDisplayLine(
 
     TopLevelWindow = YoriWinGetTopLevelWindow(&MultilineEdit->Ctrl);
     WinMgrHandle = YoriWinGetWindowManagerHandle(TopLevelWindow);
-    SourceLine = &MultilineEdit->LineArray[LineIndex];
+    SourceLine = YoriWinMultilineEditGetLine(MultilineEdit, LineIndex);
 
     //
     //  Create a string that corresponds to the current position in the
@@ -890,6 +1033,210 @@ YoriWinMultilineEditGenerateDisplayLine(
                                            DisplayLine);
 }
 
+/**
+ Ensure the array of highlight states can describe every line within the
+ control.
+
+ @param MultilineEdit Pointer to the multiline edit control.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+YoriWinMultilineEditEnsureHighlightStates(
+    __in PYORI_WIN_CTRL_MULTILINE_EDIT MultilineEdit
+    )
+{
+    PDWORD NewStates;
+    YORI_ALLOC_SIZE_T NewCount;
+
+    if (MultilineEdit->HighlightStatesAllocated >= MultilineEdit->LinesPopulated) {
+        return TRUE;
+    }
+
+    //
+    //  The line array is allocated with space for growth, so sizing to
+    //  match it avoids reallocating this array on every new line.
+    //
+
+    NewCount = MultilineEdit->LinesAllocated;
+    NewStates = YoriLibMalloc(NewCount * sizeof(DWORD));
+    if (NewStates == NULL) {
+        return FALSE;
+    }
+
+    if (MultilineEdit->HighlightStatesValid > 0) {
+        memcpy(NewStates, MultilineEdit->HighlightStates, MultilineEdit->HighlightStatesValid * sizeof(DWORD));
+    }
+
+    if (MultilineEdit->HighlightStates != NULL) {
+        YoriLibFree(MultilineEdit->HighlightStates);
+    }
+
+    MultilineEdit->HighlightStates = NewStates;
+    MultilineEdit->HighlightStatesAllocated = NewCount;
+    return TRUE;
+}
+
+/**
+ Return the highlight state at the start of a line.  Any earlier lines whose
+ state is not known are evaluated, without generating attributes, and their
+ states are retained for later use.
+
+ @param MultilineEdit Pointer to the multiline edit control.
+
+ @param LineIndex Specifies the line to return the starting state for.
+
+ @return The highlight state at the start of the line.
+ */
+DWORD
+YoriWinMultilineEditGetHighlightStartState(
+    __in PYORI_WIN_CTRL_MULTILINE_EDIT MultilineEdit,
+    __in YORI_ALLOC_SIZE_T LineIndex
+    )
+{
+    YORI_ALLOC_SIZE_T Index;
+    DWORD State;
+
+    if (LineIndex == 0) {
+        return 0;
+    }
+
+    ASSERT(MultilineEdit->HighlightStatesAllocated >= LineIndex);
+
+    State = 0;
+    if (MultilineEdit->HighlightStatesValid > 0) {
+        State = MultilineEdit->HighlightStates[MultilineEdit->HighlightStatesValid - 1];
+    }
+
+    for (Index = MultilineEdit->HighlightStatesValid; Index < LineIndex; Index++) {
+        MultilineEdit->HighlightCallback(&MultilineEdit->Ctrl,
+                                         YoriWinMultilineEditGetLine(MultilineEdit, Index),
+                                         State,
+                                         NULL,
+                                         &State);
+        MultilineEdit->HighlightStates[Index] = State;
+    }
+
+    if (MultilineEdit->HighlightStatesValid < LineIndex) {
+        MultilineEdit->HighlightStatesValid = LineIndex;
+    }
+
+    return MultilineEdit->HighlightStates[LineIndex - 1];
+}
+
+/**
+ Determine the attributes of each visible display cell on a line by invoking
+ the highlight callback.
+
+ @param MultilineEdit Pointer to the multiline edit control.
+
+ @param LineIndex Specifies the line to generate attributes for.
+
+ @param ClientWidth Specifies the number of cells that will be displayed
+        within the control.
+
+ @param CellAttributes On successful completion, updated to point to an
+        array of ClientWidth attributes for the visible cells of the line.
+        This array is owned by the control and is only valid until the next
+        line is generated.
+
+ @return TRUE to indicate success, FALSE to indicate failure.  On failure
+         the line should be displayed in the default text color.
+ */
+__success(return)
+BOOLEAN
+YoriWinMultilineEditGenerateDisplayAttributes(
+    __in PYORI_WIN_CTRL_MULTILINE_EDIT MultilineEdit,
+    __in YORI_ALLOC_SIZE_T LineIndex,
+    __in YORI_ALLOC_SIZE_T ClientWidth,
+    __out PWORD *CellAttributes
+    )
+{
+    PYORI_STRING Line;
+    PWORD CharAttributes;
+    PWORD Cells;
+    YORI_ALLOC_SIZE_T Required;
+    YORI_ALLOC_SIZE_T CharIndex;
+    YORI_ALLOC_SIZE_T CellIndex;
+    YORI_ALLOC_SIZE_T CharCells;
+    YORI_ALLOC_SIZE_T DisplayIndex;
+    DWORD State;
+    TCHAR Char;
+    BOOLEAN DoubleWideCharSupported;
+
+    ASSERT(MultilineEdit->HighlightCallback != NULL);
+    ASSERT(LineIndex < MultilineEdit->LinesPopulated);
+
+    if (!YoriWinMultilineEditEnsureHighlightStates(MultilineEdit)) {
+        return FALSE;
+    }
+
+    Line = YoriWinMultilineEditGetLine(MultilineEdit, LineIndex);
+    Required = Line->LengthInChars + ClientWidth;
+    if (Required > MultilineEdit->HighlightAttributesAllocated) {
+        PWORD NewAttributes;
+        NewAttributes = YoriLibMalloc((Required + 256) * sizeof(WORD));
+        if (NewAttributes == NULL) {
+            return FALSE;
+        }
+        if (MultilineEdit->HighlightAttributes != NULL) {
+            YoriLibFree(MultilineEdit->HighlightAttributes);
+        }
+        MultilineEdit->HighlightAttributes = NewAttributes;
+        MultilineEdit->HighlightAttributesAllocated = Required + 256;
+    }
+
+    CharAttributes = MultilineEdit->HighlightAttributes;
+    Cells = &MultilineEdit->HighlightAttributes[Line->LengthInChars];
+
+    for (CharIndex = 0; CharIndex < Line->LengthInChars; CharIndex++) {
+        CharAttributes[CharIndex] = MultilineEdit->TextAttributes;
+    }
+
+    State = YoriWinMultilineEditGetHighlightStartState(MultilineEdit, LineIndex);
+    MultilineEdit->HighlightCallback(&MultilineEdit->Ctrl, Line, State, CharAttributes, &State);
+    MultilineEdit->HighlightStates[LineIndex] = State;
+    if (MultilineEdit->HighlightStatesValid == LineIndex) {
+        MultilineEdit->HighlightStatesValid = LineIndex + 1;
+    }
+
+    //
+    //  Translate character attributes into cell attributes, following the
+    //  same rules for tabs and wide characters used to generate the display
+    //  cells.
+    //
+
+    DoubleWideCharSupported = YoriWinMultilineEditIsDoubleWideCharSupported(MultilineEdit);
+    CellIndex = 0;
+    DisplayIndex = 0;
+    for (CharIndex = 0; CharIndex < Line->LengthInChars && CellIndex < ClientWidth; CharIndex++) {
+        Char = Line->StartOfString[CharIndex];
+        if (Char == '\t') {
+            CharCells = MultilineEdit->TabWidth;
+        } else if (DoubleWideCharSupported && YoriLibIsDoubleWideChar(Char)) {
+            CharCells = 2;
+        } else {
+            CharCells = 1;
+        }
+
+        for (; CharCells > 0 && CellIndex < ClientWidth; CharCells--) {
+            if (DisplayIndex >= MultilineEdit->ViewportLeft) {
+                Cells[CellIndex] = CharAttributes[CharIndex];
+                CellIndex++;
+            }
+            DisplayIndex++;
+        }
+    }
+
+    for (; CellIndex < ClientWidth; CellIndex++) {
+        Cells[CellIndex] = MultilineEdit->TextAttributes;
+    }
+
+    *CellAttributes = Cells;
+    return TRUE;
+}
+
 /**
  Draw a single line of text within the client area of a multiline edit
  control.
@@ -911,12 +1258,15 @@ YoriWinMultilineEditPaintSingleLine(
 {
     WORD ColumnIndex;
     WORD WindowAttributes;
+    WORD CellDefaultAttributes;
     WORD TextAttributes;
     WORD RowIndex;
     BOOLEAN SelectionActive;
+    BOOLEAN EntireLineSelected;
     YORI_STRING Line;
     TCHAR Char;
     YORI_ALLOC_SIZE_T ClientWidth;
+    PWORD CellAttributes;
 
     ColumnIndex = 0;
     RowIndex = (WORD)(LineIndex - MultilineEdit->ViewportTop);
@@ -925,16 +1275,28 @@ YoriWinMultilineEditPaintSingleLine(
     ClientWidth = (YORI_ALLOC_SIZE_T)ClientSize->X;
 
     if (LineIndex < MultilineEdit->LinesPopulated) {
-        TextAttributes = WindowAttributes;
 
         //
         //  If the entire line is selected, indicate that.
         //
 
+        EntireLineSelected = FALSE;
         if (SelectionActive &&
             LineIndex > MultilineEdit->Selection.FirstLine &&
             LineIndex < MultilineEdit->Selection.LastLine) {
-            TextAttributes = MultilineEdit->SelectedAttributes;
+            EntireLineSelected = TRUE;
+        }
+
+        //
+        //  If a highlight callback is registered and the line is not
+        //  entirely selected, find the color of each cell.
+        //
+
+        CellAttributes = NULL;
+        if (MultilineEdit->HighlightCallback != NULL && !EntireLineSelected) {
+            if (!YoriWinMultilineEditGenerateDisplayAttributes(MultilineEdit, LineIndex, ClientWidth, &CellAttributes)) {
+                CellAttributes = NULL;
+            }
         }
 
         //
@@ -949,6 +1311,16 @@ YoriWinMultilineEditPaintSingleLine(
 
         for (; ColumnIndex < ClientSize->X && ColumnIndex < Line.LengthInChars; ColumnIndex++) {
 
+            CellDefaultAttributes = WindowAttributes;
+            if (CellAttributes != NULL) {
+                CellDefaultAttributes = CellAttributes[ColumnIndex];
+            }
+
+            TextAttributes = CellDefaultAttributes;
+            if (EntireLineSelected) {
+                TextAttributes = MultilineEdit->SelectedAttributes;
+            }
+
             //
             //  If a selection is active, calculate which display cells
             //  should be selected.
@@ -971,18 +1343,18 @@ YoriWinMultilineEditPaintSingleLine(
                 DisplayCurrentOffset = MultilineEdit->ViewportLeft + ColumnIndex;
                 if (LineIndex == MultilineEdit->Selection.FirstLine &&
                     LineIndex == MultilineEdit->Selection.LastLine) {
-                    TextAttributes = WindowAttributes;
+                    TextAttributes = CellDefaultAttributes;
                     if (DisplayCurrentOffset >= DisplayFirstCharOffset &&
                         DisplayCurrentOffset < DisplayLastCharOffset) {
                         TextAttributes = MultilineEdit->SelectedAttributes;
                     }
                 } else if (LineIndex == MultilineEdit->Selection.FirstLine) {
-                    TextAttributes = WindowAttributes;
+                    TextAttributes = CellDefaultAttributes;
                     if (DisplayCurrentOffset >= DisplayFirstCharOffset) {
                         TextAttributes = MultilineEdit->SelectedAttributes;
                     }
                 } else if (LineIndex == MultilineEdit->Selection.LastLine) {
-                    TextAttributes = WindowAttributes;
+                    TextAttributes = CellDefaultAttributes;
                     if (DisplayCurrentOffset < DisplayLastCharOffset) {
                         TextAttributes = MultilineEdit->SelectedAttributes;
                     }
@@ -1024,6 +1396,31 @@ YoriWinMultilineEditPaint(
 
     YoriWinGetControlClientSize(&MultilineEdit->Ctrl, &ClientSize);
 
+    //
+    //  A modification can change the highlight state at the end of a line,
+    //  which changes the display of the lines that follow it.  Redraw any
+    //  visible lines whose starting state is no longer known.
+    //
+
+    if (MultilineEdit->HighlightCallback != NULL) {
+        YORI_ALLOC_SIZE_T FirstStaleLine;
+        YORI_ALLOC_SIZE_T LastVisibleLine;
+
+        LastVisibleLine = MultilineEdit->ViewportTop + ClientSize.Y;
+        if (LastVisibleLine > MultilineEdit->LinesPopulated) {
+            LastVisibleLine = MultilineEdit->LinesPopulated;
+        }
+
+        FirstStaleLine = MultilineEdit->HighlightStatesValid + 1;
+        if (FirstStaleLine < MultilineEdit->ViewportTop) {
+            FirstStaleLine = MultilineEdit->ViewportTop;
+        }
+
+        if (FirstStaleLine < LastVisibleLine) {
+            YoriWinMultilineEditExpandDirtyRange(MultilineEdit, FirstStaleLine, LastVisibleLine - 1);
+        }
+    }
+
     if (MultilineEdit->FirstDirtyLine <= MultilineEdit->LastDirtyLine) {
 
         for (RowIndex = 0; RowIndex < ClientSize.Y; RowIndex++) {
@@ -1144,6 +1541,25 @@ YoriWinMultilineEditExpandDirtyRange(
     }
 }
 
+/**
+ Indicate that the text of a line has changed, so any cached highlight state
+ for the line and for the lines that follow it is no longer valid.
+
+ @param MultilineEdit Pointer to the multiline edit control.
+
+ @param LineIndex Specifies the first line that has changed.
+ */
+VOID
+YoriWinMultilineEditInvalidateHighlightFromLine(
+    __in PYORI_WIN_CTRL_MULTILINE_EDIT MultilineEdit,
+    __in YORI_ALLOC_SIZE_T LineIndex
+    )
+{
+    if (LineIndex < MultilineEdit->HighlightStatesValid) {
+        MultilineEdit->HighlightStatesValid = LineIndex;
+    }
+}
+
 /**
  Clear any selection if it is active and indicate that the region it covered
  needs to be redrawn.
@@ -1308,17 +1724,54 @@ YoriWinMultilineEditToggleInsert(
 //  =========================================
 //
 
+/**
+ Update the amount of memory that an undo entry is charged against the undo
+ budget to reflect its current contents.  Entries can grow after they are
+ created as later modifications are merged into them, so this can be called
+ repeatedly on the same entry.
+
+ @param MultilineEdit Pointer to the multiline edit control.
+
+ @param Undo Pointer to the undo entry to measure.
+ */
+VOID
+YoriWinMultilineEditChargeUndo(
+    __in PYORI_WIN_CTRL_MULTILINE_EDIT MultilineEdit,
+    __in PYORI_WIN_CTRL_MULTILINE_EDIT_UNDO Undo
+    )
+{
+    YORI_ALLOC_SIZE_T BytesRequired;
+
+    BytesRequired = sizeof(YORI_WIN_CTRL_MULTILINE_EDIT_UNDO);
+    switch(Undo->Op) {
+        case YoriWinMultilineEditUndoOverwriteText:
+            BytesRequired = BytesRequired + Undo->u.OverwriteText.Text.LengthAllocated * sizeof(TCHAR);
+            break;
+        case YoriWinMultilineEditUndoDeleteText:
+            BytesRequired = BytesRequired + Undo->u.DeleteText.Text.LengthAllocated * sizeof(TCHAR);
+            break;
+    }
+
+    MultilineEdit->UndoBytesCharged = MultilineEdit->UndoBytesCharged - Undo->BytesCharged + BytesRequired;
+    Undo->BytesCharged = BytesRequired;
+}
+
 /**
  Free a single undo entry.  This entry is expected to be unlinked from the
  chain.
 
+ @param MultilineEdit Pointer to the multiline edit control.
+
  @param Undo Pointer to the undo entry to free.
  */
 VOID
 YoriWinMultilineEditFreeSingleUndo(
+    __in PYORI_WIN_CTRL_MULTILINE_EDIT MultilineEdit,
     __in PYORI_WIN_CTRL_MULTILINE_EDIT_UNDO Undo
     )
 {
+    MultilineEdit->UndoBytesCharged = MultilineEdit->UndoBytesCharged - Undo->BytesCharged;
+
     switch(Undo->Op) {
         case YoriWinMultilineEditUndoOverwriteText:
             YoriLibFreeStringContents(&Undo->u.OverwriteText.Text);
@@ -1352,7 +1805,7 @@ YoriWinMultilineEditClearUndo(
         while (ListEntry != NULL) {
             YoriLibRemoveListItem(ListEntry);
             Undo = CONTAINING_RECORD(ListEntry, YORI_WIN_CTRL_MULTILINE_EDIT_UNDO, ListEntry);
-            YoriWinMultilineEditFreeSingleUndo(Undo);
+            YoriWinMultilineEditFreeSingleUndo(MultilineEdit, Undo);
             ListEntry = YoriLibGetNextListEntry(ListHead, NULL);
         }
 
@@ -1381,11 +1834,70 @@ YoriWinMultilineEditClearRedo(
     while (ListEntry != NULL) {
         YoriLibRemoveListItem(ListEntry);
         Undo = CONTAINING_RECORD(ListEntry, YORI_WIN_CTRL_MULTILINE_EDIT_UNDO, ListEntry);
-        YoriWinMultilineEditFreeSingleUndo(Undo);
+        YoriWinMultilineEditFreeSingleUndo(MultilineEdit, Undo);
         ListEntry = YoriLibGetNextListEntry(&MultilineEdit->Redo, NULL);
     }
 }
 
+/**
+ Discard the oldest undo entries until the memory consumed by undo history
+ is within the budget for the control.  The most recent entry is always
+ retained, since it may still be being extended by the current operation,
+ and entries that are applied together as a group are discarded together so
+ that a partial group is never undone.  The most recent entry is measured
+ first, since it may have grown since it was last measured.
+
+ @param MultilineEdit Pointer to the multiline edit control.
+ */
+VOID
+YoriWinMultilineEditTrimUndo(
+    __in PYORI_WIN_CTRL_MULTILINE_EDIT MultilineEdit
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PYORI_WIN_CTRL_MULTILINE_EDIT_UNDO Undo;
+    PYORI_WIN_CTRL_MULTILINE_EDIT_UNDO Newest;
+
+    ListEntry = YoriLibGetNextListEntry(&MultilineEdit->Undo, NULL);
+    if (ListEntry == NULL) {
+        return;
+    }
+
+    Newest = CONTAINING_RECORD(ListEntry, YORI_WIN_CTRL_MULTILINE_EDIT_UNDO, ListEntry);
+    YoriWinMultilineEditChargeUndo(MultilineEdit, Newest);
+
+    if (MultilineEdit->UndoBudget == 0) {
+        return;
+    }
+
+    while (MultilineEdit->UndoBytesCharged > MultilineEdit->UndoBudget) {
+        ListEntry = YoriLibGetPreviousListEntry(&MultilineEdit->Undo, NULL);
+        Undo = CONTAINING_RECORD(ListEntry, YORI_WIN_CTRL_MULTILINE_EDIT_UNDO, ListEntry);
+        if (Undo == Newest) {
+            break;
+        }
+
+        YoriLibRemoveListItem(ListEntry);
+        YoriWinMultilineEditFreeSingleUndo(MultilineEdit, Undo);
+
+        //
+        //  If the entry that is now oldest was applied together with the
+        //  entry that was just discarded, it can't be undone on its own.
+        //
+
+        ListEntry = YoriLibGetPreviousListEntry(&MultilineEdit->Undo, NULL);
+        while (ListEntry != NULL) {
+            Undo = CONTAINING_RECORD(ListEntry, YORI_WIN_CTRL_MULTILINE_EDIT_UNDO, ListEntry);
+            if (!Undo->ChainWithNext || Undo == Newest) {
+                break;
+            }
+            YoriLibRemoveListItem(ListEntry);
+            YoriWinMultilineEditFreeSingleUndo(MultilineEdit, Undo);
+            ListEntry = YoriLibGetPreviousListEntry(&MultilineEdit->Undo, NULL);
+        }
+    }
+}
+
 /**
  Check if a new modification should be included in a previous undo entry
  because the new modification is immediately before the range in the previous
@@ -1518,6 +2030,7 @@ YoriWinMultilineEditGetUndoRecordForOperation(
     PYORI_WIN_CTRL_MULTILINE_EDIT_UNDO Undo = NULL;
 
     YoriWinMultilineEditClearRedo(MultilineEdit);
+    YoriWinMultilineEditTrimUndo(MultilineEdit);
 
     *NewRangeBeforeExistingRange = FALSE;
 
@@ -1906,6 +2419,7 @@ YoriWinMultilineEditGenerateRedoRecordForUndo(
             break;
     }
 
+    YoriWinMultilineEditChargeUndo(MultilineEdit, Redo);
     return Redo;
 }
 
@@ -2038,16 +2552,17 @@ YoriWinMultilineEditUndo(
 
         if (Success) {
             YoriLibRemoveListItem(&Undo->ListEntry);
-            YoriWinMultilineEditFreeSingleUndo(Undo);
+            YoriWinMultilineEditFreeSingleUndo(MultilineEdit, Undo);
         } else {
             YoriLibRemoveListItem(&Redo->ListEntry);
-            YoriWinMultilineEditFreeSingleUndo(Redo);
+            YoriWinMultilineEditFreeSingleUndo(MultilineEdit, Redo);
         }
 
         ChainWithPrevious = TRUE;
 
     } while (Success && ChainWithNext);
 
+    YoriWinMultilineEditTrimUndo(MultilineEdit);
     return Success;
 }
 
@@ -2099,16 +2614,17 @@ YoriWinMultilineEditRedo(
 
         if (Success) {
             YoriLibRemoveListItem(&Undo->ListEntry);
-            YoriWinMultilineEditFreeSingleUndo(Undo);
+            YoriWinMultilineEditFreeSingleUndo(MultilineEdit, Undo);
         } else {
             YoriLibRemoveListItem(&Redo->ListEntry);
-            YoriWinMultilineEditFreeSingleUndo(Redo);
+            YoriWinMultilineEditFreeSingleUndo(MultilineEdit, Redo);
         }
 
         ChainWithPrevious = TRUE;
 
     } while (Success && ChainWithNext);
 
+    YoriWinMultilineEditTrimUndo(MultilineEdit);
     return Success;
 }
 
@@ -2158,26 +2674,26 @@ YoriWinMultilineEditGetTextRangeLength(
     if (FirstLine == LastLine) {
         ASSERT(LastCharOffset >= FirstCharOffset);
         CharsInRange = 0;
-        if (FirstCharOffset >= MultilineEdit->LineArray[FirstLine].LengthInChars) {
+        if (FirstCharOffset >= YoriWinMultilineEditGetLine(MultilineEdit, FirstLine)->LengthInChars) {
             CharsInRange = 0;
-        } else if (LastCharOffset >= MultilineEdit->LineArray[FirstLine].LengthInChars) {
-            CharsInRange = MultilineEdit->LineArray[FirstLine].LengthInChars - FirstCharOffset;
+        } else if (LastCharOffset >= YoriWinMultilineEditGetLine(MultilineEdit, FirstLine)->LengthInChars) {
+            CharsInRange = YoriWinMultilineEditGetLine(MultilineEdit, FirstLine)->LengthInChars - FirstCharOffset;
         } else {
             CharsInRange = LastCharOffset - FirstCharOffset;
         }
     } else {
         LinesInRange = LastLine - FirstLine;
         CharsInRange = 0;
-        if (FirstCharOffset < MultilineEdit->LineArray[FirstLine].LengthInChars) {
-            CharsInRange += MultilineEdit->LineArray[FirstLine].LengthInChars - FirstCharOffset;
+        if (FirstCharOffset < YoriWinMultilineEditGetLine(MultilineEdit, FirstLine)->LengthInChars) {
+            CharsInRange += YoriWinMultilineEditGetLine(MultilineEdit, FirstLine)->LengthInChars - FirstCharOffset;
         }
         for (LineIndex = FirstLine + 1; LineIndex < LastLine; LineIndex++) {
-            CharsInRange += MultilineEdit->LineArray[LineIndex].LengthInChars;
+            CharsInRange += YoriWinMultilineEditGetLine(MultilineEdit, LineIndex)->LengthInChars;
         }
-        if (LastCharOffset < MultilineEdit->LineArray[LineIndex].LengthInChars) {
+        if (LastCharOffset < YoriWinMultilineEditGetLine(MultilineEdit, LineIndex)->LengthInChars) {
             CharsInRange += LastCharOffset;
         } else {
-            CharsInRange += MultilineEdit->LineArray[LineIndex].LengthInChars;
+            CharsInRange += YoriWinMultilineEditGetLine(MultilineEdit, LineIndex)->LengthInChars;
         }
         CharsInRange += LinesInRange * NewlineLength;
     }
@@ -2239,7 +2755,7 @@ YoriWinMultilineEditGetIndentationOnLine(
 {
     PCYORI_STRING Line;
 
-    Line = &MultilineEdit->LineArray[LineIndex];
+    Line = YoriWinMultilineEditGetLine(MultilineEdit, LineIndex);
     YoriWinMultilineEditGetIndentationOnString(Line, Indent);
 }
 
@@ -2284,7 +2800,7 @@ YoriWinMultilineEditFindPreviousIndentLine(
     //
 
     for (ProbeLine = MultilineEdit->AutoIndentAppliedLine; ProbeLine > 0; ProbeLine--) {
-        ProbeLineString = &MultilineEdit->LineArray[ProbeLine - 1];
+        ProbeLineString = YoriWinMultilineEditGetLine(MultilineEdit, ProbeLine - 1);
         if (ProbeLineString->LengthInChars > 0) {
             YoriWinMultilineEditGetIndentationOnString(ProbeLineString, &ProbeIndent);
             MatchingLength = YoriLibCntStringMatchChars(&CurrentIndent, &ProbeIndent);
@@ -2344,7 +2860,7 @@ YoriWinMultilineEditPopulateTextRange(
     PYORI_STRING Line;
     LPTSTR Ptr;
 
-    Line = &MultilineEdit->LineArray[FirstLine];
+    Line = YoriWinMultilineEditGetLine(MultilineEdit, FirstLine);
 
     if (FirstLine == LastLine) {
         if (FirstCharOffset > Line->LengthInChars) {
@@ -2369,18 +2885,18 @@ YoriWinMultilineEditPopulateTextRange(
             memcpy(Ptr, NewlineString->StartOfString, NewlineString->LengthInChars * sizeof(TCHAR));
             Ptr += NewlineString->LengthInChars;
             memcpy(Ptr,
-                   MultilineEdit->LineArray[LineIndex].StartOfString,
-                   MultilineEdit->LineArray[LineIndex].LengthInChars * sizeof(TCHAR));
-            Ptr += MultilineEdit->LineArray[LineIndex].LengthInChars;
+                   YoriWinMultilineEditGetLine(MultilineEdit, LineIndex)->StartOfString,
+                   YoriWinMultilineEditGetLine(MultilineEdit, LineIndex)->LengthInChars * sizeof(TCHAR));
+            Ptr += YoriWinMultilineEditGetLine(MultilineEdit, LineIndex)->LengthInChars;
         }
         memcpy(Ptr, NewlineString->StartOfString, NewlineString->LengthInChars * sizeof(TCHAR));
         Ptr += NewlineString->LengthInChars;
-        if (LastCharOffset < MultilineEdit->LineArray[LastLine].LengthInChars) {
+        if (LastCharOffset < YoriWinMultilineEditGetLine(MultilineEdit, LastLine)->LengthInChars) {
             CharsInRange = LastCharOffset;
         } else {
-            CharsInRange = MultilineEdit->LineArray[LastLine].LengthInChars;
+            CharsInRange = YoriWinMultilineEditGetLine(MultilineEdit, LastLine)->LengthInChars;
         }
-        memcpy(Ptr, MultilineEdit->LineArray[LastLine].StartOfString, CharsInRange * sizeof(TCHAR));
+        memcpy(Ptr, YoriWinMultilineEditGetLine(MultilineEdit, LastLine)->StartOfString, CharsInRange * sizeof(TCHAR));
         Ptr += LastCharOffset;
 
         SelectedText->LengthInChars = (YORI_ALLOC_SIZE_T)(Ptr - SelectedText->StartOfString);
@@ -2513,8 +3029,6 @@ YoriWinMultilineEditDeleteTextRange(
     YORI_ALLOC_SIZE_T CharsToCopy;
     YORI_ALLOC_SIZE_T CharsToDelete;
     YORI_ALLOC_SIZE_T LinesToDelete;
-    YORI_ALLOC_SIZE_T LinesToCopy;
-    YORI_ALLOC_SIZE_T FirstLineIndexToKeep;
     YORI_ALLOC_SIZE_T LineIndexToDelete;
     PYORI_STRING Line;
     PYORI_STRING FinalLine;
@@ -2588,7 +3102,7 @@ YoriWinMultilineEditDeleteTextRange(
         }
     }
 
-    Line = &MultilineEdit->LineArray[FirstLine];
+    Line = YoriWinMultilineEditGetLine(MultilineEdit, FirstLine);
 
     //
     //  If the selection is one line, this is a simple case, because no
@@ -2617,6 +3131,7 @@ YoriWinMultilineEditDeleteTextRange(
 
         Line->LengthInChars = Line->LengthInChars - CharsToDelete;
         YoriWinMultilineEditExpandDirtyRange(MultilineEdit, FirstLine, FirstLine);
+        YoriWinMultilineEditInvalidateHighlightFromLine(MultilineEdit, FirstLine);
         MultilineEdit->UserModified = TRUE;
         return TRUE;
     }
@@ -2625,7 +3140,7 @@ YoriWinMultilineEditDeleteTextRange(
     ASSERT(LastLine < MultilineEdit->LinesPopulated ||
            (LastLine == MultilineEdit->LinesPopulated && LastCharOffset == 0));
     if (LastLine < MultilineEdit->LinesPopulated) {
-        FinalLine = &MultilineEdit->LineArray[LastLine];
+        FinalLine = YoriWinMultilineEditGetLine(MultilineEdit, LastLine);
     } else {
         FinalLine = NULL;
     }
@@ -2694,23 +3209,21 @@ YoriWinMultilineEditDeleteTextRange(
     }
 
     for (LineIndexToDelete = 0; LineIndexToDelete < LinesToDelete; LineIndexToDelete++) {
-        YoriLibFreeStringContents(&MultilineEdit->LineArray[FirstLine + 1 + LineIndexToDelete]);
+        YoriLibFreeStringContents(YoriWinMultilineEditGetLine(MultilineEdit, FirstLine + 1 + LineIndexToDelete));
     }
 
-    FirstLineIndexToKeep = FirstLine + 1 + LinesToDelete;
-    if (FirstLineIndexToKeep < MultilineEdit->LinesPopulated) {
-        LinesToCopy = MultilineEdit->LinesPopulated - FirstLineIndexToKeep;
-    } else {
-        LinesToCopy = 0;
-    }
+    //
+    //  Move the gap to the first deleted line.  The deleted lines are then
+    //  the first lines following the gap, so the gap can be extended over
+    //  them without moving any other lines.
+    //
 
-    if (LinesToCopy > 0) {
-        memmove(&MultilineEdit->LineArray[FirstLine + 1],
-                &MultilineEdit->LineArray[FirstLine + 1 + LinesToDelete],
-                LinesToCopy * sizeof(YORI_STRING));
+    if (LinesToDelete > 0) {
+        YoriWinMultilineEditMoveGap(MultilineEdit, FirstLine + 1);
     }
 
     YoriWinMultilineEditExpandDirtyRange(MultilineEdit, FirstLine, MultilineEdit->LinesPopulated);
+    YoriWinMultilineEditInvalidateHighlightFromLine(MultilineEdit, FirstLine);
     MultilineEdit->UserModified = TRUE;
 
     MultilineEdit->LinesPopulated = MultilineEdit->LinesPopulated - LinesToDelete;
@@ -2821,8 +3334,27 @@ YoriWinMultilineEditReallocateLineArray(
         return FALSE;
     }
 
+    //
+    //  Copy the lines before the gap to the start of the new array, and
+    //  the lines after the gap to the end of it, so the new allocation
+    //  extends the gap.
+    //
+
     if (MultilineEdit->LinesPopulated > 0) {
-        memcpy(NewLineArray, MultilineEdit->LineArray, MultilineEdit->LinesPopulated * sizeof(YORI_STRING));
+        YORI_ALLOC_SIZE_T LinesAfterGap;
+
+        LinesAfterGap = MultilineEdit->LinesPopulated - MultilineEdit->GapStart;
+        if (MultilineEdit->GapStart > 0) {
+            memcpy(NewLineArray, MultilineEdit->LineArray, MultilineEdit->GapStart * sizeof(YORI_STRING));
+        }
+        if (LinesAfterGap > 0) {
+            memcpy(&NewLineArray[NewLineCount - LinesAfterGap],
+                   &MultilineEdit->LineArray[MultilineEdit->LinesAllocated - LinesAfterGap],
+                   LinesAfterGap * sizeof(YORI_STRING));
+        }
+    }
+
+    if (MultilineEdit->LineArray != NULL) {
         YoriLibDereference(MultilineEdit->LineArray);
     }
 
@@ -2867,7 +3399,7 @@ YoriWinMultilineEditTrimAutoIndent(
         return FALSE;
     }
 
-    Line = &MultilineEdit->LineArray[LineIndex];
+    Line = YoriWinMultilineEditGetLine(MultilineEdit, LineIndex);
 
     ASSERT(Line->LengthInChars == MultilineEdit->AutoIndentSourceLength);
     ASSERT(Line->LengthInChars != 0);
@@ -2959,18 +3491,19 @@ YoriWinMultilineEditInsertLines(
         SourceLine = FirstLine;
         TargetLine = SourceLine + LineCount + 1;
     }
-    if (SourceLine < MultilineEdit->LinesPopulated) {
-        DWORD LinesToMove;
-        LinesToMove = MultilineEdit->LinesPopulated - SourceLine;
-        memmove(&MultilineEdit->LineArray[TargetLine],
-                &MultilineEdit->LineArray[SourceLine],
-                LinesToMove * sizeof(YORI_STRING));
-    }
+
+    //
+    //  Move the gap to the insertion point and consume the new lines from
+    //  the front of it.
+    //
+
+    YoriWinMultilineEditMoveGap(MultilineEdit, SourceLine);
 
     for (Index = SourceLine; Index < TargetLine; Index++) {
         YoriLibInitEmptyString(&MultilineEdit->LineArray[Index]);
     }
 
+    MultilineEdit->GapStart = TargetLine;
     MultilineEdit->LinesPopulated = (YORI_ALLOC_SIZE_T)LinesRequired;
     return TRUE;
 }
@@ -3073,7 +3606,7 @@ YoriWinMultilineEditInsertTextRange(
 
         if (AutoIndentLeadingString.LengthInChars > 0 && Text->LengthInChars > 0) {
             TCHAR FirstChar;
-            Line = &MultilineEdit->LineArray[FirstLine];
+            Line = YoriWinMultilineEditGetLine(MultilineEdit, FirstLine);
             FirstChar = Text->StartOfString[0];
             if (AutoIndentLeadingString.LengthInChars == Line->LengthInChars &&
                 (FirstChar == '\n' || FirstChar == '\r')) {
@@ -3106,7 +3639,7 @@ YoriWinMultilineEditInsertTextRange(
 
     YoriLibInitEmptyString(&TrailingPortionOfFirstLine);
     if (FirstLine < MultilineEdit->LinesPopulated) {
-        Line = &MultilineEdit->LineArray[FirstLine];
+        Line = YoriWinMultilineEditGetLine(MultilineEdit, FirstLine);
         if (FirstCharOffset < Line->LengthInChars) {
             ASSERT(Line->MemoryToFree != NULL);
             YoriLibReference(Line->MemoryToFree);
@@ -3158,7 +3691,7 @@ YoriWinMultilineEditInsertTextRange(
                     CharsLastLine = CharsThisLine;
                 }
             } else {
-                Line = &MultilineEdit->LineArray[FirstLine + LineIndex];
+                Line = YoriWinMultilineEditGetLine(MultilineEdit, FirstLine + LineIndex);
                 ASSERT(Line->LengthInChars == 0);
                 CharsNeeded = CharsThisLine;
                 if (LineIndex == LineCount) {
@@ -3266,7 +3799,7 @@ YoriWinMultilineEditInsertTextRange(
         ASSERT(AutoIndentLeadingString.StartOfString == NULL);
     }
 
-    Line = &MultilineEdit->LineArray[FirstLine];
+    Line = YoriWinMultilineEditGetLine(MultilineEdit, FirstLine);
     if (FirstCharOffset + CharsFirstLine + TrailingPortionOfFirstLine.LengthInChars > Line->LengthAllocated) {
         if (!YoriLibReallocString(Line, FirstCharOffset + CharsFirstLine + TrailingPortionOfFirstLine.LengthInChars + YORI_WIN_MULTILINE_EDIT_LINE_PADDING)) {
             YoriLibFreeStringContents(&TrailingPortionOfFirstLine);
@@ -3320,7 +3853,7 @@ YoriWinMultilineEditInsertTextRange(
         //
 
         if (TruncateFirstLine) {
-            Line = &MultilineEdit->LineArray[FirstLine];
+            Line = YoriWinMultilineEditGetLine(MultilineEdit, FirstLine);
             YoriWinMultilineEditDeleteTextRange(MultilineEdit,
                                                 TRUE,
                                                 FALSE,
@@ -3338,6 +3871,7 @@ YoriWinMultilineEditInsertTextRange(
 
     *LastLine = LocalLastLine;
     *LastCharOffset = LocalLastCharOffset;
+    YoriWinMultilineEditInvalidateHighlightFromLine(MultilineEdit, FirstLine);
     MultilineEdit->UserModified = TRUE;
 
     return TRUE;
@@ -3426,7 +3960,7 @@ YoriWinMultilineEditOverwriteTextRange(
             //
 
             if (Undo->u.OverwriteText.Text.StartOfString == NULL) {
-                Line = &MultilineEdit->LineArray[FirstLine];
+                Line = YoriWinMultilineEditGetLine(MultilineEdit, FirstLine);
                 if (!YoriLibCopyString(&Undo->u.OverwriteText.Text, Line)) {
                     return FALSE;
                 }
@@ -3504,7 +4038,7 @@ YoriWinMultilineEditOverwriteTextRange(
                 StartOffsetThisLine = FirstCharOffset;
             }
 
-            Line = &MultilineEdit->LineArray[FirstLine + LineIndex];
+            Line = YoriWinMultilineEditGetLine(MultilineEdit, FirstLine + LineIndex);
             CharsNeeded = StartOffsetThisLine + CharsThisLine;
             if (Line->LengthAllocated < CharsNeeded) {
                 YoriLibFreeStringContents(Line);
@@ -3532,7 +4066,7 @@ YoriWinMultilineEditOverwriteTextRange(
                 Line->LengthInChars = StartOffsetThisLine + CharsThisLine;
             } else if (MoveTrailingTextToNextLine && Line->LengthInChars > StartOffsetThisLine + CharsThisLine) {
                 PYORI_STRING NextLine;
-                NextLine = &MultilineEdit->LineArray[FirstLine + LineIndex + 1];
+                NextLine = YoriWinMultilineEditGetLine(MultilineEdit, FirstLine + LineIndex + 1);
                 ASSERT(NextLine->LengthInChars == 0);
                 CharsNeeded = Line->LengthInChars - (StartOffsetThisLine + CharsThisLine);
                 if (NextLine->LengthAllocated < CharsNeeded) {
@@ -3607,6 +4141,7 @@ YoriWinMultilineEditOverwriteTextRange(
         ASSERT(LocalLastLine == FirstLine + LineCount);
         ASSERT(LocalLastCharOffset == FirstCharOffset + CharsLastLine);
     }
+    YoriWinMultilineEditInvalidateHighlightFromLine(MultilineEdit, FirstLine);
     MultilineEdit->UserModified = TRUE;
 
     return TRUE;
@@ -3664,9 +4199,11 @@ YoriWinMultilineEditAppendLinesNoDataCopy(
         }
     }
 
+    YoriWinMultilineEditMoveGap(MultilineEdit, MultilineEdit->LinesPopulated);
     memcpy(&MultilineEdit->LineArray[MultilineEdit->LinesPopulated], NewLines, NewLineCount * sizeof(YORI_STRING));
     YoriWinMultilineEditExpandDirtyRange(MultilineEdit, MultilineEdit->LinesPopulated, MultilineEdit->LinesPopulated + NewLineCount);
     MultilineEdit->LinesPopulated = MultilineEdit->LinesPopulated + NewLineCount;
+    MultilineEdit->GapStart = MultilineEdit->LinesPopulated;
 
     YoriWinMultilineEditPaint(MultilineEdit);
     return TRUE;
@@ -3799,8 +4336,8 @@ YoriWinMultilineEditCheckSelectionState(
     } else {
         ASSERT(Selection->LastLine != Selection->FirstLine || Selection->FirstCharOffset < Selection->LastCharOffset);
     }
-    ASSERT(Selection->FirstCharOffset <= MultilineEdit->LineArray[Selection->FirstLine].LengthInChars);
-    ASSERT(Selection->LastCharOffset <= MultilineEdit->LineArray[Selection->LastLine].LengthInChars);
+    ASSERT(Selection->FirstCharOffset <= YoriWinMultilineEditGetLine(MultilineEdit, Selection->FirstLine)->LengthInChars);
+    ASSERT(Selection->LastCharOffset <= YoriWinMultilineEditGetLine(MultilineEdit, Selection->LastLine)->LengthInChars);
 }
 
 /**
@@ -3859,13 +4396,13 @@ YoriWinMultilineEditStartSelectionAtCursor(
         } else if (EffectiveCursorLine >= MultilineEdit->LinesPopulated) {
 
             EffectiveCursorLine = MultilineEdit->LinesPopulated - 1;
-            EffectiveCursorOffset = MultilineEdit->LineArray[EffectiveCursorLine].LengthInChars;
+            EffectiveCursorOffset = YoriWinMultilineEditGetLine(MultilineEdit, EffectiveCursorLine)->LengthInChars;
 
         }
 
         if (EffectiveCursorLine < MultilineEdit->LinesPopulated) {
-            if (EffectiveCursorOffset > MultilineEdit->LineArray[EffectiveCursorLine].LengthInChars) {
-                EffectiveCursorOffset = MultilineEdit->LineArray[EffectiveCursorLine].LengthInChars;
+            if (EffectiveCursorOffset > YoriWinMultilineEditGetLine(MultilineEdit, EffectiveCursorLine)->LengthInChars) {
+                EffectiveCursorOffset = YoriWinMultilineEditGetLine(MultilineEdit, EffectiveCursorLine)->LengthInChars;
             }
         }
 
@@ -3976,11 +4513,11 @@ YoriWinMultilineEditExtendSelectionToCursor(
     EffectiveCursorOffset = MultilineEdit->CursorOffset;
     if (EffectiveCursorLine >= MultilineEdit->LinesPopulated) {
         EffectiveCursorLine = MultilineEdit->LinesPopulated - 1;
-        EffectiveCursorOffset = MultilineEdit->LineArray[EffectiveCursorLine].LengthInChars;
+        EffectiveCursorOffset = YoriWinMultilineEditGetLine(MultilineEdit, EffectiveCursorLine)->LengthInChars;
     }
 
-    if (EffectiveCursorOffset > MultilineEdit->LineArray[EffectiveCursorLine].LengthInChars) {
-        EffectiveCursorOffset = MultilineEdit->LineArray[EffectiveCursorLine].LengthInChars;
+    if (EffectiveCursorOffset > YoriWinMultilineEditGetLine(MultilineEdit, EffectiveCursorLine)->LengthInChars) {
+        EffectiveCursorOffset = YoriWinMultilineEditGetLine(MultilineEdit, EffectiveCursorLine)->LengthInChars;
     }
 
     if (EffectiveCursorLine < AnchorLine) {
@@ -4245,6 +4782,63 @@ YoriWinMultilineEditCopySelectedText(
     return TRUE;
 }
 
+/**
+ Insert a block of pasted text at the current cursor location, replacing
+ any selection.  The block is inserted as a single operation, so it is
+ undone as a single operation.  If auto indent has just been applied to the
+ cursor line, any leading indentation in the pasted text that duplicates it
+ is skipped, since the text already contains its own indentation.
+
+ @param MultilineEdit Pointer to the multiline edit control.
+
+ @param Text Pointer to the text to insert.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+YoriWinMultilineEditInsertPastedText(
+    __in PYORI_WIN_CTRL_MULTILINE_EDIT MultilineEdit,
+    __in PYORI_STRING Text
+    )
+{
+    YORI_STRING Substring;
+    PYORI_STRING Line;
+    YORI_ALLOC_SIZE_T Index;
+
+    if (YoriWinMultilineEditSelectionActive(MultilineEdit)) {
+        YoriWinMultilineEditDeleteSelection(MultilineEdit);
+    }
+
+    YoriWinMultilineEditClearDesiredDisplayOffset(MultilineEdit);
+
+    YoriLibInitEmptyString(&Substring);
+    Substring.StartOfString = Text->StartOfString;
+    Substring.LengthInChars = Text->LengthInChars;
+
+    if (MultilineEdit->AutoIndentApplied &&
+        MultilineEdit->CursorLine == MultilineEdit->AutoIndentAppliedLine) {
+
+        Line = YoriWinMultilineEditGetLine(MultilineEdit, MultilineEdit->CursorLine);
+
+        for (Index = 0;
+             Index < Line->LengthInChars &&
+             Index < Substring.LengthInChars &&
+             Index < MultilineEdit->AutoIndentSourceLength &&
+             Line->StartOfString[Index] == Substring.StartOfString[Index];
+             Index++);
+
+        Substring.StartOfString = Substring.StartOfString + Index;
+        Substring.LengthInChars = Substring.LengthInChars - Index;
+    }
+
+    if (!YoriWinMultilineEditInsertTextAtCursor(&MultilineEdit->Ctrl, &Substring)) {
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
 /**
  Paste the text that is currently in the clipboard at the current cursor
  location.  Note this can update the cursor location.
@@ -4259,10 +4853,8 @@ YoriWinMultilineEditPasteText(
     )
 {
     YORI_STRING Text;
-    PYORI_STRING Line;
     PYORI_WIN_CTRL_MULTILINE_EDIT MultilineEdit;
     PYORI_WIN_CTRL Ctrl;
-    YORI_ALLOC_SIZE_T Index;
 
     Ctrl = (PYORI_WIN_CTRL)CtrlHandle;
     MultilineEdit = CONTAINING_RECORD(Ctrl, YORI_WIN_CTRL_MULTILINE_EDIT, Ctrl);
@@ -4275,23 +4867,8 @@ YoriWinMultilineEditPasteText(
     if (!YoriLibPasteTextWithProcessFallback(&Text)) {
         return FALSE;
     }
-    if (MultilineEdit->AutoIndentApplied &&
-        MultilineEdit->CursorLine == MultilineEdit->AutoIndentAppliedLine) {
-
-        Line = &MultilineEdit->LineArray[MultilineEdit->CursorLine];
-
-        for (Index = 0;
-             Index < Line->LengthInChars &&
-             Index < Text.LengthInChars &&
-             Index < MultilineEdit->AutoIndentSourceLength &&
-             Line->StartOfString[Index] == Text.StartOfString[Index];
-             Index++);
-
-        Text.StartOfString = Text.StartOfString + Index;
-        Text.LengthInChars = Text.LengthInChars - Index;
-    }
 
-    if (!YoriWinMultilineEditInsertTextAtCursor(CtrlHandle, &Text)) {
+    if (!YoriWinMultilineEditInsertPastedText(MultilineEdit, &Text)) {
         YoriLibFreeStringContents(&Text);
         return FALSE;
     }
@@ -4547,11 +5124,13 @@ YoriWinMultilineEditClear(
     YoriWinMultilineEditClearSelection(MultilineEdit);
 
     for (Index = 0; Index < MultilineEdit->LinesPopulated; Index++) {
-        YoriLibFreeStringContents(&MultilineEdit->LineArray[Index]);
+        YoriLibFreeStringContents(YoriWinMultilineEditGetLine(MultilineEdit, Index));
     }
     YoriWinMultilineEditClearUndo(MultilineEdit);
 
     MultilineEdit->LinesPopulated = 0;
+    MultilineEdit->GapStart = 0;
+    MultilineEdit->HighlightStatesValid = 0;
     MultilineEdit->ViewportTop = 0;
     MultilineEdit->ViewportLeft = 0;
 
@@ -4688,7 +5267,7 @@ YoriWinMultilineEditGetLineByIndex(
         return NULL;
     }
 
-    return &MultilineEdit->LineArray[Index];
+    return YoriWinMultilineEditGetLine(MultilineEdit, Index);
 }
 
 /**
@@ -4845,9 +5424,9 @@ YoriWinMultilineEditSetTraditionalNavigation(
     YoriWinMultilineEditClearDesiredDisplayOffset(MultilineEdit);
     if (!MultilineEdit->TraditionalEditNavigation) {
         if (MultilineEdit->CursorLine < MultilineEdit->LinesPopulated) {
-            if (MultilineEdit->CursorOffset > MultilineEdit->LineArray[MultilineEdit->CursorLine].LengthInChars) {
+            if (MultilineEdit->CursorOffset > YoriWinMultilineEditGetLine(MultilineEdit, MultilineEdit->CursorLine)->LengthInChars) {
                 YoriWinMultilineEditSetCursorLocationInternal(MultilineEdit,
-                                                              MultilineEdit->LineArray[MultilineEdit->CursorLine].LengthInChars,
+                                                              YoriWinMultilineEditGetLine(MultilineEdit, MultilineEdit->CursorLine)->LengthInChars,
                                                               MultilineEdit->CursorLine);
             }
         }
@@ -4915,6 +5494,31 @@ YoriWinMultilineEditSetExpandTab(
     MultilineEdit->ExpandTab = ExpandTabEnabled;
 }
 
+/**
+ Set the maximum amount of memory that undo history for the multiline edit
+ control should consume.  When the history exceeds this amount, the oldest
+ changes are discarded and can no longer be undone.
+
+ @param CtrlHandle Pointer to the multiline edit control.
+
+ @param UndoBudget The maximum number of bytes of undo history to retain.
+        Zero indicates that undo history should not be limited.
+ */
+VOID
+YoriWinMultilineEditSetUndoBudget(
+    __in PYORI_WIN_CTRL_HANDLE CtrlHandle,
+    __in DWORDLONG UndoBudget
+    )
+{
+    PYORI_WIN_CTRL Ctrl;
+    PYORI_WIN_CTRL_MULTILINE_EDIT MultilineEdit;
+
+    Ctrl = (PYORI_WIN_CTRL)CtrlHandle;
+    MultilineEdit = CONTAINING_RECORD(Ctrl, YORI_WIN_CTRL_MULTILINE_EDIT, Ctrl);
+    MultilineEdit->UndoBudget = UndoBudget;
+    YoriWinMultilineEditTrimUndo(MultilineEdit);
+}
+
 /**
  Returns TRUE if the multiline edit control has been modified by the user
  since the last time @ref YoriWinMultilineEditSetModifyState indicated that
@@ -4971,6 +5575,59 @@ YoriWinMultilineEditSetCursorMoveNotifyCallback(
     return TRUE;
 }
 
+/**
+ Set a callback to invoke to determine the colors of text within the
+ control.  Lines are only evaluated when they are displayed, and the state
+ at the end of each line is retained so later lines can be displayed without
+ evaluating the buffer again.  Modifying a line discards the retained state
+ for that line and the lines following it.
+
+ @param CtrlHandle Pointer to the multiline edit control.
+
+ @param HighlightCallback Pointer to a function to invoke to determine the
+        colors of text on a line.  If NULL, all text is displayed in the
+        control's text color.
+ */
+VOID
+YoriWinMultilineEditSetHighlightCallback(
+    __in PYORI_WIN_CTRL_HANDLE CtrlHandle,
+    __in_opt PYORI_WIN_NOTIFY_MULTILINE_EDIT_HIGHLIGHT_LINE HighlightCallback
+    )
+{
+    PYORI_WIN_CTRL Ctrl;
+    PYORI_WIN_CTRL_MULTILINE_EDIT MultilineEdit;
+
+    Ctrl = (PYORI_WIN_CTRL)CtrlHandle;
+    MultilineEdit = CONTAINING_RECORD(Ctrl, YORI_WIN_CTRL_MULTILINE_EDIT, Ctrl);
+
+    MultilineEdit->HighlightCallback = HighlightCallback;
+    MultilineEdit->HighlightStatesValid = 0;
+    YoriWinMultilineEditExpandDirtyRange(MultilineEdit, 0, (YORI_ALLOC_SIZE_T)-1);
+    YoriWinMultilineEditPaint(MultilineEdit);
+}
+
+/**
+ Indicate that the rules applied by the highlight callback have changed, so
+ any retained state should be discarded and the visible text redrawn.
+
+ @param CtrlHandle Pointer to the multiline edit control.
+ */
+VOID
+YoriWinMultilineEditInvalidateHighlight(
+    __in PYORI_WIN_CTRL_HANDLE CtrlHandle
+    )
+{
+    PYORI_WIN_CTRL Ctrl;
+    PYORI_WIN_CTRL_MULTILINE_EDIT MultilineEdit;
+
+    Ctrl = (PYORI_WIN_CTRL)CtrlHandle;
+    MultilineEdit = CONTAINING_RECORD(Ctrl, YORI_WIN_CTRL_MULTILINE_EDIT, Ctrl);
+
+    MultilineEdit->HighlightStatesValid = 0;
+    YoriWinMultilineEditExpandDirtyRange(MultilineEdit, 0, (YORI_ALLOC_SIZE_T)-1);
+    YoriWinMultilineEditPaint(MultilineEdit);
+}
+
 //
 //  =========================================
 //  INPUT HANDLING FUNCTIONS
@@ -5007,7 +5664,7 @@ YoriWinMultilineEditBackspace(
         return YoriWinMultilineEditDeleteSelection(&MultilineEdit->Ctrl);
     }
 
-    Line = &MultilineEdit->LineArray[MultilineEdit->CursorLine];
+    Line = YoriWinMultilineEditGetLine(MultilineEdit, MultilineEdit->CursorLine);
 
     LastLine = MultilineEdit->CursorLine;
     LastCharOffset = MultilineEdit->CursorOffset;
@@ -5040,7 +5697,7 @@ YoriWinMultilineEditBackspace(
         }
 
         FirstLine = MultilineEdit->CursorLine - 1;
-        FirstCharOffset = MultilineEdit->LineArray[FirstLine].LengthInChars;
+        FirstCharOffset = YoriWinMultilineEditGetLine(MultilineEdit, FirstLine)->LengthInChars;
     } else {
         FirstLine = LastLine;
         FirstCharOffset = LastCharOffset - 1;
@@ -5088,7 +5745,7 @@ YoriWinMultilineEditDelete(
         return YoriWinMultilineEditDeleteSelection(&MultilineEdit->Ctrl);
     }
 
-    Line = &MultilineEdit->LineArray[MultilineEdit->CursorLine];
+    Line = YoriWinMultilineEditGetLine(MultilineEdit, MultilineEdit->CursorLine);
 
     FirstLine = MultilineEdit->CursorLine;
     FirstCharOffset = MultilineEdit->CursorOffset;
@@ -5351,7 +6008,7 @@ YoriWinMultilineEditNotifyDoubleClick(
         //  If it's beyond the end of the line, there's nothing to select.
         //
 
-        Line = &MultilineEdit->LineArray[NewCursorLine];
+        Line = YoriWinMultilineEditGetLine(MultilineEdit, NewCursorLine);
         if (NewCursorChar >= Line->LengthInChars) {
             return;
         }
@@ -5527,8 +6184,8 @@ YoriWinMultilineEditScrollForMouseSelect(
     if (!MultilineEdit->TraditionalEditNavigation) {
         if (MultilineEdit->LinesPopulated > 0) {
             ASSERT(NewCursorLine < MultilineEdit->LinesPopulated);
-            if (NewCursorOffset > MultilineEdit->LineArray[NewCursorLine].LengthInChars) {
-                NewCursorOffset = MultilineEdit->LineArray[NewCursorLine].LengthInChars;
+            if (NewCursorOffset > YoriWinMultilineEditGetLine(MultilineEdit, NewCursorLine)->LengthInChars) {
+                NewCursorOffset = YoriWinMultilineEditGetLine(MultilineEdit, NewCursorLine)->LengthInChars;
             }
         }
     }
@@ -5665,7 +6322,7 @@ YoriWinMultilineEditProcessPossiblyEnhancedKey(
             if (MultilineEdit->CursorOffset == 0) {
                 ASSERT(!MultilineEdit->TraditionalEditNavigation);
                 NewCursorLine = NewCursorLine - 1;
-                NewCursorOffset = MultilineEdit->LineArray[NewCursorLine].LengthInChars;
+                NewCursorOffset = YoriWinMultilineEditGetLine(MultilineEdit, NewCursorLine)->LengthInChars;
                 YoriWinMultilineEditTrimAutoIndent(MultilineEdit, MultilineEdit->CursorLine, 0);
             } else {
                 NewCursorOffset = MultilineEdit->CursorOffset - 1;
@@ -5683,7 +6340,7 @@ YoriWinMultilineEditProcessPossiblyEnhancedKey(
     } else if (Event->KeyDown.VirtualKeyCode == VK_RIGHT) {
         if (MultilineEdit->TraditionalEditNavigation ||
             (MultilineEdit->CursorLine < MultilineEdit->LinesPopulated &&
-             MultilineEdit->CursorOffset < MultilineEdit->LineArray[MultilineEdit->CursorLine].LengthInChars) ||
+             MultilineEdit->CursorOffset < YoriWinMultilineEditGetLine(MultilineEdit, MultilineEdit->CursorLine)->LengthInChars) ||
             MultilineEdit->CursorLine + 1 < MultilineEdit->LinesPopulated) {
 
             if (Event->KeyDown.CtrlMask & SHIFT_PRESSED) {
@@ -5695,7 +6352,7 @@ YoriWinMultilineEditProcessPossiblyEnhancedKey(
             NewCursorOffset = MultilineEdit->CursorOffset + 1;
             if (!MultilineEdit->TraditionalEditNavigation) {
                 if ((NewCursorLine < MultilineEdit->LinesPopulated &&
-                     NewCursorOffset > MultilineEdit->LineArray[NewCursorLine].LengthInChars)) {
+                     NewCursorOffset > YoriWinMultilineEditGetLine(MultilineEdit, NewCursorLine)->LengthInChars)) {
 
                     NewCursorLine = NewCursorLine + 1;
                     NewCursorOffset = 0;
@@ -5737,7 +6394,7 @@ YoriWinMultilineEditProcessPossiblyEnhancedKey(
             YoriWinMultilineEditClearSelection(MultilineEdit);
         }
         if (MultilineEdit->CursorLine < MultilineEdit->LinesPopulated) {
-            FinalChar = MultilineEdit->LineArray[MultilineEdit->CursorLine].LengthInChars;
+            FinalChar = YoriWinMultilineEditGetLine(MultilineEdit, MultilineEdit->CursorLine)->LengthInChars;
         }
         if (MultilineEdit->CursorOffset != FinalChar) {
             YoriWinMultilineEditSetCursorLocationInternal(MultilineEdit, FinalChar, MultilineEdit->CursorLine);
@@ -5907,7 +6564,7 @@ YoriWinMultilineEditProcessPossiblyEnhancedCtrlKey(
             YoriWinMultilineEditClearSelection(MultilineEdit);
         }
         if (MultilineEdit->LinesPopulated > 0) {
-            FinalChar = MultilineEdit->LineArray[MultilineEdit->LinesPopulated - 1].LengthInChars;
+            FinalChar = YoriWinMultilineEditGetLine(MultilineEdit, MultilineEdit->LinesPopulated - 1)->LengthInChars;
             if (MultilineEdit->CursorLine != MultilineEdit->LinesPopulated - 1 ||
                 MultilineEdit->CursorOffset != FinalChar) {
 
@@ -5936,7 +6593,7 @@ YoriWinMultilineEditProcessPossiblyEnhancedCtrlKey(
                 YORI_STRING WhitespaceChars = YORILIB_CONSTANT_STRING(_T(" -\t"));
                 PYORI_STRING Line;
 
-                Line = &MultilineEdit->LineArray[ProbeLine];
+                Line = YoriWinMultilineEditGetLine(MultilineEdit, ProbeLine);
                 Index = ProbeOffset;
                 if (Index > Line->LengthInChars) {
                     Index = Line->LengthInChars;
@@ -5948,7 +6605,7 @@ YoriWinMultilineEditProcessPossiblyEnhancedCtrlKey(
                 }
                 if (Index == 0 && ProbeLine > 0) {
                     ProbeLine--;
-                    ProbeOffset = MultilineEdit->LineArray[ProbeLine].LengthInChars;
+                    ProbeOffset = YoriWinMultilineEditGetLine(MultilineEdit, ProbeLine)->LengthInChars;
                     continue;
                 }
                 while(Index > 0 &&
@@ -5985,7 +6642,7 @@ YoriWinMultilineEditProcessPossiblyEnhancedCtrlKey(
                 YORI_STRING WhitespaceChars = YORILIB_CONSTANT_STRING(_T(" -\t"));
                 PYORI_STRING Line;
 
-                Line = &MultilineEdit->LineArray[ProbeLine];
+                Line = YoriWinMultilineEditGetLine(MultilineEdit, ProbeLine);
                 Index = ProbeOffset;
                 if (Index > Line->LengthInChars) {
                     Index = Line->LengthInChars;
@@ -6049,12 +6706,20 @@ YoriWinMultilineEditEventHandler(
         case YoriWinEventParentDestroyed:
             YoriWinMultilineEditClearUndo(MultilineEdit);
             for (Index = 0; Index < MultilineEdit->LinesPopulated; Index++) {
-                YoriLibFreeStringContents(&MultilineEdit->LineArray[Index]);
+                YoriLibFreeStringContents(YoriWinMultilineEditGetLine(MultilineEdit, Index));
             }
             if (MultilineEdit->LineArray != NULL) {
                 YoriLibDereference(MultilineEdit->LineArray);
                 MultilineEdit->LineArray = NULL;
             }
+            if (MultilineEdit->HighlightStates != NULL) {
+                YoriLibFree(MultilineEdit->HighlightStates);
+                MultilineEdit->HighlightStates = NULL;
+            }
+            if (MultilineEdit->HighlightAttributes != NULL) {
+                YoriLibFree(MultilineEdit->HighlightAttributes);
+                MultilineEdit->HighlightAttributes = NULL;
+            }
             YoriLibFreeStringContents(&MultilineEdit->Caption);
             YoriWinDestroyControl(Ctrl);
             YoriLibDereference(MultilineEdit);
@@ -6107,7 +6772,7 @@ YoriWinMultilineEditEventHandler(
                                                                   0,
                                                                   0,
                                                                   MultilineEdit->LinesPopulated - 1,
-                                                                  MultilineEdit->LineArray[MultilineEdit->LinesPopulated - 1].LengthInChars);
+                                                                  YoriWinMultilineEditGetLine(MultilineEdit, MultilineEdit->LinesPopulated - 1)->LengthInChars);
                         }
                         return TRUE;
                     } else if (Event->KeyDown.VirtualKeyCode == 'C') {
@@ -6307,6 +6972,23 @@ YoriWinMultilineEditEventHandler(
                 YoriWinMultilineEditScrollForMouseSelect(MultilineEdit, &ClientPos);
             }
             break;
+        case YoriWinEventInsertText:
+
+            //
+            //  Text arriving from the console faster than it could be typed
+            //  is inserted as a block.  Overwrite mode has different
+            //  semantics, so is left to process each key press.
+            //
+
+            if (MultilineEdit->ReadOnly || !MultilineEdit->InsertMode) {
+                return FALSE;
+            }
+
+            if (YoriWinMultilineEditInsertPastedText(MultilineEdit, Event->InsertText.Text)) {
+                YoriWinMultilineEditEnsureCursorVisible(MultilineEdit);
+                YoriWinMultilineEditPaint(MultilineEdit);
+            }
+            return TRUE;
         case YoriWinEventTimer:
             ASSERT(MultilineEdit->MouseButtonDown);
             ASSERT(MultilineEdit->Selection.Active == YoriWinMultilineEditSelectMouseFromTopDown ||
@@ -6499,6 +7181,7 @@ YoriWinMultilineEditCreate(
 
     YoriLibInitializeListHead(&MultilineEdit->Undo);
     YoriLibInitializeListHead(&MultilineEdit->Redo);
+    MultilineEdit->UndoBudget = YORI_WIN_MULTILINE_EDIT_DEFAULT_UNDO_BUDGET;
 
     MultilineEdit->Ctrl.NotifyEventFn = YoriWinMultilineEditEventHandler;
     if (!YoriWinCreateControl(Parent, Size, TRUE, TRUE, &MultilineEdit->Ctrl)) {
@@ -111,6 +111,18 @@ typedef struct _YORI_WIN_WINDOW {
      */
     PYORI_WIN_NOTIFY_WINDOW_MANAGER_RESIZE WindowManagerResizeNotifyCallback;
 
+    /**
+     Optionally points to a callback function to invoke periodically while
+     the window is displayed.
+     */
+    PYORI_WIN_NOTIFY_WINDOW_TIMER TimerNotifyCallback;
+
+    /**
+     The timer used to invoke TimerNotifyCallback.  This is NULL if no
+     callback is registered.
+     */
+    PYORI_WIN_CTRL_HANDLE Timer;
+
     /**
      An array of callbacks that can be invoked when particular events occur
      in the window, which were not processed by any control on the window.
@@ -734,6 +746,11 @@ YoriWinDestroyWindow(
         Window->Contents = NULL;
     }
 
+    if (Window->Timer != NULL) {
+        YoriWinMgrFreeTimer(Window->Timer);
+        Window->Timer = NULL;
+    }
+
     YoriWinDestroyControl(&Window->Ctrl);
 
     if (Window->CustomNotifications) {
@@ -1987,6 +2004,53 @@ YoriWinSetWindowManagerResizeNotifyCallback(
     return TRUE;
 }
 
+/**
+ Set a callback to invoke periodically while the window is displayed.  This
+ allows an application to poll for the results of work performed outside of
+ the input loop, such as on a background thread, and update the display
+ with its progress.  Only one callback can be registered per window;
+ registering a new callback replaces any previous one.  This function may be
+ called from within the callback to stop further notifications.
+
+ @param WindowHandle Pointer to the window to invoke a callback from.
+
+ @param PeriodicInterval The time in milliseconds between each invocation of
+        the callback.
+
+ @param NotifyCallback A function to invoke when the interval elapses.  If
+        NULL, any existing callback is removed.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+YoriWinSetWindowTimerCallback(
+    __in PYORI_WIN_WINDOW_HANDLE WindowHandle,
+    __in DWORD PeriodicInterval,
+    __in_opt PYORI_WIN_NOTIFY_WINDOW_TIMER NotifyCallback
+    )
+{
+    PYORI_WIN_WINDOW Window;
+    PYORI_WIN_CTRL_HANDLE Timer;
+    Window = (PYORI_WIN_WINDOW)WindowHandle;
+
+    Timer = NULL;
+    if (NotifyCallback != NULL) {
+        Timer = YoriWinMgrAllocateRecurringTimer(Window->WinMgrHandle, &Window->Ctrl, PeriodicInterval);
+        if (Timer == NULL) {
+            return FALSE;
+        }
+    }
+
+    if (Window->Timer != NULL) {
+        YoriWinMgrFreeTimer(Window->Timer);
+    }
+
+    Window->Timer = Timer;
+    Window->TimerNotifyCallback = NotifyCallback;
+    return TRUE;
+}
+
 /**
  Set a callback to be invoked when an event occurs on the window that is not
  explicitly handled by a control.  As of this writing, only one callback can
@@ -2429,6 +2493,22 @@ YoriWinNotifyEvent(
             return TRUE;
         }
 
+    } else if (Event->EventType == YoriWinEventInsertText) {
+
+        //
+        //  Text can only be inserted into the control with focus.  If it
+        //  doesn't handle the insertion, the window manager will deliver the
+        //  text as key presses.
+        //
+
+        if (Window->KeyboardFocusCtrl != NULL &&
+            Window->KeyboardFocusCtrl->NotifyEventFn != NULL) {
+
+            Terminate = Window->KeyboardFocusCtrl->NotifyEventFn(Window->KeyboardFocusCtrl, Event);
+            if (Terminate) {
+                return TRUE;
+            }
+        }
     } else if (Event->EventType == YoriWinEventExecute) {
         if (Window->GeneralDefaultCtrl != NULL &&
             !Window->DefaultControlSuppressed) {
@@ -2467,6 +2547,12 @@ YoriWinNotifyEvent(
         if (Window->WindowManagerResizeNotifyCallback != NULL) {
             Window->WindowManagerResizeNotifyCallback(Window, &Event->WindowManagerResize.OldWinMgrDimensions, &Event->WindowManagerResize.NewWinMgrDimensions);
         }
+    } else if (Event->EventType == YoriWinEventTimer) {
+        if (Window->TimerNotifyCallback != NULL &&
+            Event->Timer.Timer == Window->Timer) {
+
+            Window->TimerNotifyCallback(Window);
+        }
     }
 
     if (Window->CustomNotifications != NULL &&
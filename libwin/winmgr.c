@@ -40,6 +40,58 @@
  */
 #define YORI_WIN_SHADOW_HEIGHT (1)
 
+/**
+ The number of unchanged cells that can separate two changed cells on the
+ same line while still sending both to the console in a single update.
+ Each update has a fixed cost, which is far larger than the cost of
+ rewriting a few cells, and when rendering with VT sequences each update
+ requires a cursor positioning sequence of around this length anyway.
+ */
+#define YORI_WIN_MAX_COALESCE_GAP (8)
+
+/**
+ The number of characters to buffer when rendering with VT sequences before
+ sending them to the console.
+ */
+#define YORI_WIN_VT_BUFFER_CHARS (4096)
+
+/**
+ The default maximum number of times per second to update the console while
+ input is arriving faster than it can be displayed.
+ */
+#define YORI_WIN_DEFAULT_FRAME_RATE (60)
+
+/**
+ The minimum number of consecutive characters within a batch of input to
+ deliver to a control as a single insertion rather than as individual key
+ presses.  People don't type this quickly, so this implies text is being
+ pasted into the console.
+ */
+#define YORI_WIN_MIN_INSERT_TEXT_CHARS (16)
+
+/**
+ The number of input records to read from the console at a time.
+ */
+#define YORI_WIN_INPUT_RECORDS_PER_READ (128)
+
+/**
+ The range of cells on a single line of the window manager that may differ
+ from what the console is displaying.  If Left is greater than Right, no
+ cells on the line have changed.
+ */
+typedef struct _YORI_WIN_DIRTY_SPAN {
+
+    /**
+     The leftmost cell on the line that may have changed.
+     */
+    SHORT Left;
+
+    /**
+     The rightmost cell on the line that may have changed.
+     */
+    SHORT Right;
+} YORI_WIN_DIRTY_SPAN, *PYORI_WIN_DIRTY_SPAN;
+
 /**
  A timer that can be attached to the window manager.
  */
@@ -160,10 +212,30 @@ typedef struct _YORI_WIN_WINDOW_MANAGER {
     /**
      An array of cells describing the current display.  This is updated before
      the console, so the contents here describe what is or what will be
-     displayed.
+     displayed.  This allocation also contains DisplayedContents and
+     DirtyLines.
      */
     PCHAR_INFO Contents;
 
+    /**
+     An array of cells describing what has been sent to the console.  Cells
+     that match between Contents and DisplayedContents do not need to be
+     sent again.  This is only meaningful if DisplayedContentsValid is TRUE.
+     */
+    PCHAR_INFO DisplayedContents;
+
+    /**
+     An array with one entry per line of the window manager describing the
+     range of cells which may differ between Contents and the console.
+     */
+    PYORI_WIN_DIRTY_SPAN DirtyLines;
+
+    /**
+     A buffer of VT sequences which have been generated and not yet sent to
+     the console.  This is only allocated if UseVtRendering is TRUE.
+     */
+    YORI_STRING VtBuffer;
+
     /**
      A single character which is repeated many times during rendering.  This
      is used to generate window shadows, where each character is the same,
@@ -171,13 +243,6 @@ typedef struct _YORI_WIN_WINDOW_MANAGER {
      */
     CHAR_INFO RepeatingCell;
 
-    /**
-     If DirtyRect above is TRUE, this contains the region of the Contents
-     buffer which needs to be displayed.  If DisplayDirty above is FALSE,
-     the values in DirtyRect are not meaningful.
-     */
-    SMALL_RECT DirtyRect;
-
     /**
      The current state of the cursor on the display.  If the active window
      changes or if it moves the cursor, this will be compared to the new
@@ -219,6 +284,18 @@ typedef struct _YORI_WIN_WINDOW_MANAGER {
      */
     DWORD SavedConsoleInputMode;
 
+    /**
+     The minimum time between updates to the console while more input is
+     waiting to be processed, in milliseconds.  Zero indicates the console
+     should be updated after every batch of input.
+     */
+    DWORD MinimumFrameIntervalInMs;
+
+    /**
+     The system time when the console was last updated.
+     */
+    LONGLONG LastFrameTime;
+
     /**
      Set to TRUE to indicate all mouse press events should be sent to one
      specific window (MouseButtonOwningWindow) regardless of the mouse
@@ -234,11 +311,27 @@ typedef struct _YORI_WIN_WINDOW_MANAGER {
 
     /**
      TRUE if some region of the display buffer has been regenerated and needs
-     to be pushed to the console.  When this occurs, DirtyRect below indicates
-     the range.  Contents in the Contents buffer above have been updated.
+     to be pushed to the console.  When this occurs, DirtyLines above
+     indicates the range.  Contents in the Contents buffer above have been
+     updated.
      */
     BOOLEAN DisplayDirty;
 
+    /**
+     TRUE if DisplayedContents describes what the console is displaying.
+     This is FALSE after the console is resized, since the console may have
+     moved text in response, until every cell has been sent to it again.
+     */
+    BOOLEAN DisplayedContentsValid;
+
+    /**
+     TRUE if changes should be sent to the console as VT sequences rather
+     than cell arrays.  This is much faster when the console is being
+     relayed to a remote terminal, since that relay would otherwise need to
+     translate each cell array update.
+     */
+    BOOLEAN UseVtRendering;
+
     /**
      Set to TRUE if the console is a v2 console.  These appear to have fixed
      bugs relating to the coordinates of mouse wheel events.  As of this
@@ -323,6 +416,63 @@ YoriWinTransparentAttributesFromAttributes(
                   (YoriWinTransparentColorFromColor((WORD)((Attributes >> 4) & 0xF)) << 4));
 }
 
+/**
+ Allocate the buffers needed to compose and display a window manager of a
+ specified size, and free any previous buffers.  Since the contents of the
+ console are not known to the new buffers, every cell is marked as needing
+ to be sent to the console.
+
+ @param WinMgr Pointer to the window manager.
+
+ @param Size The dimensions of the window manager.
+
+ @return TRUE to indicate success, FALSE to indicate failure.  On failure,
+         the previous buffers remain in place.
+ */
+__success(return)
+BOOLEAN
+YoriWinMgrAllocateContents(
+    __in PYORI_WIN_WINDOW_MANAGER WinMgr,
+    __in COORD Size
+    )
+{
+    PCHAR_INFO NewAllocation;
+    YORI_ALLOC_SIZE_T CellCount;
+    YORI_ALLOC_SIZE_T CellIndex;
+    SHORT LineIndex;
+
+    CellCount = Size.Y;
+    CellCount = CellCount * Size.X;
+
+    NewAllocation = YoriLibMalloc(CellCount * 2 * sizeof(CHAR_INFO) + Size.Y * sizeof(YORI_WIN_DIRTY_SPAN));
+    if (NewAllocation == NULL) {
+        return FALSE;
+    }
+
+    if (WinMgr->Contents != NULL) {
+        YoriLibFree(WinMgr->Contents);
+    }
+
+    WinMgr->Contents = NewAllocation;
+    WinMgr->DisplayedContents = &NewAllocation[CellCount];
+    WinMgr->DirtyLines = (PYORI_WIN_DIRTY_SPAN)&NewAllocation[CellCount * 2];
+
+    for (CellIndex = 0; CellIndex < CellCount; CellIndex++) {
+        WinMgr->Contents[CellIndex].Char.UnicodeChar = ' ';
+        WinMgr->Contents[CellIndex].Attributes = YoriLibVtGetDefaultColor();
+    }
+
+    for (LineIndex = 0; LineIndex < Size.Y; LineIndex++) {
+        WinMgr->DirtyLines[LineIndex].Left = 0;
+        WinMgr->DirtyLines[LineIndex].Right = (SHORT)(Size.X - 1);
+    }
+
+    WinMgr->DisplayDirty = TRUE;
+    WinMgr->DisplayedContentsValid = FALSE;
+
+    return TRUE;
+}
+
 /**
  Record the contents of the console that are in the range that the window
  will display over.
@@ -455,6 +605,10 @@ YoriWinCloseWindowManager(
         WinMgr->SavedContents = NULL;
     }
 
+    if (WinMgr->UseVtRendering) {
+        YoriWinMgrSetVtRendering(WinMgr, FALSE);
+    }
+
     if (WinMgr->Contents != NULL) {
         YoriLibFree(WinMgr->Contents);
         WinMgr->Contents = NULL;
@@ -554,9 +708,16 @@ YoriWinOpenWindowManager(
     WinMgr->hConOriginal = NULL;
     WinMgr->SavedContents = NULL;
     WinMgr->Contents = NULL;
+    WinMgr->DisplayedContents = NULL;
+    WinMgr->DirtyLines = NULL;
+    YoriLibInitEmptyString(&WinMgr->VtBuffer);
     YoriLibInitializeListHead(&WinMgr->TimerList);
     YoriLibInitializeListHead(&WinMgr->ZOrderList);
     WinMgr->DisplayDirty = FALSE;
+    WinMgr->DisplayedContentsValid = FALSE;
+    WinMgr->UseVtRendering = FALSE;
+    WinMgr->MinimumFrameIntervalInMs = 1000 / YORI_WIN_DEFAULT_FRAME_RATE;
+    WinMgr->LastFrameTime = 0;
     WinMgr->UpdateCursor = FALSE;
     WinMgr->SavedCursorPosition.X = 0;
     WinMgr->SavedCursorPosition.Y = 0;
@@ -651,17 +812,31 @@ YoriWinOpenWindowManager(
     YoriWinGetWinMgrDimensions(WinMgr, &BufferSize);
     CellCount = BufferSize.X * BufferSize.Y;
 
-    WinMgr->Contents = YoriLibMalloc(CellCount * sizeof(CHAR_INFO));
-    if (WinMgr->Contents == NULL) {
+    if (!YoriWinMgrAllocateContents(WinMgr, BufferSize)) {
         YoriWinCloseWindowManager(WinMgr);
         return FALSE;
     }
 
+    //
+    //  The console is currently displaying the saved contents, so nothing
+    //  needs to be sent to it until a window changes something.
+    //
+
     for (CellIndex = 0; CellIndex < CellCount; CellIndex++) {
         WinMgr->Contents[CellIndex].Attributes = WinMgr->SavedContents[CellIndex].Attributes;
         WinMgr->Contents[CellIndex].Char.UnicodeChar = WinMgr->SavedContents[CellIndex].Char.UnicodeChar;
+        WinMgr->DisplayedContents[CellIndex].Attributes = WinMgr->SavedContents[CellIndex].Attributes;
+        WinMgr->DisplayedContents[CellIndex].Char.UnicodeChar = WinMgr->SavedContents[CellIndex].Char.UnicodeChar;
+    }
+
+    for (CellIndex = 0; CellIndex < (YORI_ALLOC_SIZE_T)BufferSize.Y; CellIndex++) {
+        WinMgr->DirtyLines[CellIndex].Left = BufferSize.X;
+        WinMgr->DirtyLines[CellIndex].Right = -1;
     }
 
+    WinMgr->DisplayDirty = FALSE;
+    WinMgr->DisplayedContentsValid = TRUE;
+
     //
     //  Probe for Conhostv2 by asking for a flag that only it supports.
     //  Conhostv2 reports coordinates differently (correctly) for mouse
@@ -696,6 +871,17 @@ YoriWinOpenWindowManager(
         WinMgr->UseAsciiDrawing = TRUE;
     }
 
+    //
+    //  When running under SSH, every cell array written to the console is
+    //  translated into VT sequences to send to the remote terminal, so
+    //  generate VT sequences directly.  This is best effort; if it fails,
+    //  cell arrays are used.
+    //
+
+    if (WinMgr->IsConhostv2 && YoriLibIsRunningUnderSsh()) {
+        YoriWinMgrSetVtRendering(WinMgr, TRUE);
+    }
+
     *WinMgrHandle = WinMgr;
     return TRUE;
 }
@@ -735,6 +921,82 @@ YoriWinMgrSetAsciiDrawing(
     WinMgr->UseAsciiDrawing = UseAsciiDrawing;
 }
 
+/**
+ Change if the window manager should send changes to the console as VT
+ sequences or as arrays of cells.  VT sequences are faster when the console
+ is being relayed to a remote terminal.
+
+ @param WinMgrHandle Pointer to the window manager.
+
+ @param UseVtRendering If TRUE, changes should be sent as VT sequences.  If
+        FALSE, changes should be sent as arrays of cells.
+
+ @return TRUE to indicate success, FALSE to indicate failure.  Failure
+         indicates the console cannot process VT sequences, and arrays of
+         cells will continue to be used.
+ */
+__success(return)
+BOOLEAN
+YoriWinMgrSetVtRendering(
+    __in PYORI_WIN_WINDOW_MANAGER_HANDLE WinMgrHandle,
+    __in BOOLEAN UseVtRendering
+    )
+{
+    PYORI_WIN_WINDOW_MANAGER WinMgr = (PYORI_WIN_WINDOW_MANAGER)WinMgrHandle;
+
+    if (UseVtRendering == WinMgr->UseVtRendering) {
+        return TRUE;
+    }
+
+    if (UseVtRendering) {
+        if (!YoriLibAllocateString(&WinMgr->VtBuffer, YORI_WIN_VT_BUFFER_CHARS)) {
+            return FALSE;
+        }
+
+        //
+        //  Wrapping is disabled so that writing the final cell of the final
+        //  line does not scroll the display.
+        //
+
+        if (!SetConsoleMode(WinMgr->hConOut, ENABLE_PROCESSED_OUTPUT | ENABLE_VIRTUAL_TERMINAL_PROCESSING)) {
+            YoriLibFreeStringContents(&WinMgr->VtBuffer);
+            return FALSE;
+        }
+    } else {
+        SetConsoleMode(WinMgr->hConOut, ENABLE_PROCESSED_OUTPUT | ENABLE_WRAP_AT_EOL_OUTPUT);
+        YoriLibFreeStringContents(&WinMgr->VtBuffer);
+    }
+
+    WinMgr->UseVtRendering = UseVtRendering;
+    return TRUE;
+}
+
+/**
+ Change the maximum number of times per second that the window manager will
+ update the console while input is arriving.  Input that arrives between
+ updates is processed and the result displayed in the next update.  When no
+ input is waiting, the console is always updated immediately.
+
+ @param WinMgrHandle Pointer to the window manager.
+
+ @param FramesPerSecond The maximum number of updates per second.  If zero,
+        the console is updated after every batch of input.
+ */
+VOID
+YoriWinMgrSetMaximumFrameRate(
+    __in PYORI_WIN_WINDOW_MANAGER_HANDLE WinMgrHandle,
+    __in DWORD FramesPerSecond
+    )
+{
+    PYORI_WIN_WINDOW_MANAGER WinMgr = (PYORI_WIN_WINDOW_MANAGER)WinMgrHandle;
+
+    if (FramesPerSecond == 0) {
+        WinMgr->MinimumFrameIntervalInMs = 0;
+    } else {
+        WinMgr->MinimumFrameIntervalInMs = 1000 / FramesPerSecond;
+    }
+}
+
 /**
  Characters forming a single line rectangle border, in order of appearance:
  Top left corner, top line, top right corner, left line, right line,
@@ -1524,8 +1786,8 @@ YoriWinMgrGetNextDisplayRangeFromWindowBuffers(
 }
 
 /**
- Indicate that a particular cell has changed so the dirty region needs to
- be expanded to include it.
+ Indicate that a particular cell has changed so the dirty region for its
+ line needs to be expanded to include it.
 
  @param WinMgr Pointer to the window manager.
 
@@ -1537,25 +1799,16 @@ YoriWinMgrExpandDirtyToPoint(
     __in COORD Point
     )
 {
-    if (!WinMgr->DisplayDirty) {
-        WinMgr->DisplayDirty = TRUE;
-        WinMgr->DirtyRect.Left = Point.X;
-        WinMgr->DirtyRect.Top = Point.Y;
-        WinMgr->DirtyRect.Right = Point.X;
-        WinMgr->DirtyRect.Bottom = Point.Y;
-    } else {
-        if (Point.X < WinMgr->DirtyRect.Left) {
-            WinMgr->DirtyRect.Left = Point.X;
-        } else if (Point.X > WinMgr->DirtyRect.Right) {
-            WinMgr->DirtyRect.Right = Point.X;
-        }
+    PYORI_WIN_DIRTY_SPAN Span;
 
-        if (Point.Y < WinMgr->DirtyRect.Top) {
-            WinMgr->DirtyRect.Top = Point.Y;
-        } else if (Point.Y > WinMgr->DirtyRect.Bottom) {
-            WinMgr->DirtyRect.Bottom = Point.Y;
-        }
+    Span = &WinMgr->DirtyLines[Point.Y];
+    if (Point.X < Span->Left) {
+        Span->Left = Point.X;
+    }
+    if (Point.X > Span->Right) {
+        Span->Right = Point.X;
     }
+    WinMgr->DisplayDirty = TRUE;
 }
 
 /**
@@ -1734,6 +1987,348 @@ YoriWinMgrRegenerateRegion(
     }
 }
 
+/**
+ Send any buffered VT sequences to the console.
+
+ @param WinMgr Pointer to the window manager.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+YoriWinMgrVtFlush(
+    __in PYORI_WIN_WINDOW_MANAGER WinMgr
+    )
+{
+    DWORD CharsWritten;
+    DWORD CharsRemaining;
+    LPTSTR Next;
+
+    Next = WinMgr->VtBuffer.StartOfString;
+    CharsRemaining = WinMgr->VtBuffer.LengthInChars;
+    WinMgr->VtBuffer.LengthInChars = 0;
+
+    while (CharsRemaining > 0) {
+        if (!WriteConsole(WinMgr->hConOut, Next, CharsRemaining, &CharsWritten, NULL)) {
+            return FALSE;
+        }
+        if (CharsWritten == 0) {
+            return FALSE;
+        }
+        Next = Next + CharsWritten;
+        CharsRemaining = CharsRemaining - CharsWritten;
+    }
+
+    return TRUE;
+}
+
+/**
+ Add characters to the buffer of VT sequences to send to the console,
+ sending earlier characters if the buffer is full.
+
+ @param WinMgr Pointer to the window manager.
+
+ @param Text Pointer to the characters to add.
+
+ @param Length Specifies the number of characters to add.  This must not
+        exceed YORI_WIN_VT_BUFFER_CHARS.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+YoriWinMgrVtAppend(
+    __in PYORI_WIN_WINDOW_MANAGER WinMgr,
+    __in_ecount(Length) LPCTSTR Text,
+    __in YORI_ALLOC_SIZE_T Length
+    )
+{
+    ASSERT(Length <= WinMgr->VtBuffer.LengthAllocated);
+
+    if (WinMgr->VtBuffer.LengthInChars + Length > WinMgr->VtBuffer.LengthAllocated) {
+        if (!YoriWinMgrVtFlush(WinMgr)) {
+            return FALSE;
+        }
+    }
+
+    memcpy(&WinMgr->VtBuffer.StartOfString[WinMgr->VtBuffer.LengthInChars], Text, Length * sizeof(TCHAR));
+    WinMgr->VtBuffer.LengthInChars = WinMgr->VtBuffer.LengthInChars + Length;
+    return TRUE;
+}
+
+/**
+ Add a VT sequence to move the cursor to a specified location to the buffer
+ of VT sequences to send to the console.
+
+ @param WinMgr Pointer to the window manager.
+
+ @param Point The location to move the cursor to, in window manager
+        coordinates.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+YoriWinMgrVtAppendCursorPosition(
+    __in PYORI_WIN_WINDOW_MANAGER WinMgr,
+    __in COORD Point
+    )
+{
+    TCHAR Escape[sizeof("E[99999;99999H")];
+    YORI_SIGNED_ALLOC_SIZE_T Length;
+
+    Length = YoriLibSPrintfS(Escape, sizeof(Escape)/sizeof(Escape[0]), _T("%c[%i;%iH"), 27, Point.Y + 1, Point.X + 1);
+    if (Length < 0) {
+        return FALSE;
+    }
+
+    return YoriWinMgrVtAppend(WinMgr, Escape, (YORI_ALLOC_SIZE_T)Length);
+}
+
+/**
+ Add VT sequences to display a horizontal run of cells from the window
+ manager to the buffer of VT sequences to send to the console.
+
+ @param WinMgr Pointer to the window manager.
+
+ @param LineIndex The line within the window manager containing the cells.
+
+ @param RunStart The first cell on the line to display.
+
+ @param RunEnd The last cell on the line to display.
+
+ @param CurrentAttributes On input, points to the color that the terminal
+        is currently using to display text, or to a value that is not a
+        valid color if it is not known.  On output, updated to contain the
+        color the terminal is using after this run is displayed.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+YoriWinMgrVtAppendRun(
+    __in PYORI_WIN_WINDOW_MANAGER WinMgr,
+    __in SHORT LineIndex,
+    __in SHORT RunStart,
+    __in SHORT RunEnd,
+    __inout PDWORD CurrentAttributes
+    )
+{
+    TCHAR AttributeBuffer[YORI_MAX_VT_ESCAPE_CHARS];
+    YORI_STRING AttributeString;
+    COORD BufferSize;
+    COORD Point;
+    PCHAR_INFO Cell;
+    TCHAR Char;
+    SHORT Index;
+
+    YoriWinGetWinMgrDimensions(WinMgr, &BufferSize);
+
+    Point.X = RunStart;
+    Point.Y = LineIndex;
+    if (!YoriWinMgrVtAppendCursorPosition(WinMgr, Point)) {
+        return FALSE;
+    }
+
+    YoriLibInitEmptyString(&AttributeString);
+    AttributeString.StartOfString = AttributeBuffer;
+    AttributeString.LengthAllocated = sizeof(AttributeBuffer)/sizeof(AttributeBuffer[0]);
+
+    Cell = &WinMgr->Contents[LineIndex * BufferSize.X];
+    for (Index = RunStart; Index <= RunEnd; Index++) {
+        if (Cell[Index].Attributes != *CurrentAttributes) {
+            if (!YoriLibVtStringForTextAttribute(&AttributeString, 0, Cell[Index].Attributes)) {
+                return FALSE;
+            }
+            if (!YoriWinMgrVtAppend(WinMgr, AttributeString.StartOfString, AttributeString.LengthInChars)) {
+                return FALSE;
+            }
+            *CurrentAttributes = Cell[Index].Attributes;
+        }
+
+        Char = Cell[Index].Char.UnicodeChar;
+        if (Char < ' ') {
+            Char = ' ';
+        }
+
+        if (!YoriWinMgrVtAppend(WinMgr, &Char, 1)) {
+            return FALSE;
+        }
+
+        //
+        //  A double wide character is followed by a padding cell, which the
+        //  terminal fills when displaying the character.
+        //
+
+        if (WinMgr->IsDoubleWideSupported && YoriLibIsDoubleWideChar(Char)) {
+            Index++;
+        }
+    }
+
+    return TRUE;
+}
+
+/**
+ Send any cells which have changed since the console was last updated to
+ the console.  Within each line, only the range which may have changed is
+ examined, and within that range only cells which differ from what the
+ console is displaying are sent, with nearby changes combined into a single
+ update.
+
+ @param WinMgr Pointer to the window manager.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+YoriWinMgrWriteChangedCells(
+    __in PYORI_WIN_WINDOW_MANAGER WinMgr
+    )
+{
+    COORD BufferPosition;
+    COORD BufferSize;
+    COORD CursorPosition;
+    SMALL_RECT WinMgrPos;
+    SMALL_RECT RedrawWindow;
+    PYORI_WIN_DIRTY_SPAN Span;
+    PCHAR_INFO Cell;
+    PCHAR_INFO DisplayedCell;
+    DWORD CurrentAttributes;
+    SHORT LineIndex;
+    SHORT Index;
+    SHORT RunStart;
+    SHORT RunEnd;
+    BOOLEAN ContentsValid;
+
+    YoriWinGetWinMgrDimensions(WinMgr, &BufferSize);
+    YoriWinGetWinMgrLocation(WinMgr, &WinMgrPos);
+
+    ContentsValid = WinMgr->DisplayedContentsValid;
+
+    //
+    //  When using VT sequences, hide the cursor while it moves around the
+    //  display.  Any value above a WORD indicates the terminal's current
+    //  color is not known.
+    //
+
+    CurrentAttributes = (DWORD)-1;
+    if (WinMgr->UseVtRendering) {
+        WinMgr->VtBuffer.LengthInChars = 0;
+        if (WinMgr->DisplayedCursorState.Visible) {
+            if (!YoriWinMgrVtAppend(WinMgr, _T("\x1b[?25l"), sizeof("\x1b[?25l") - 1)) {
+                return FALSE;
+            }
+        }
+    }
+
+    for (LineIndex = 0; LineIndex < BufferSize.Y; LineIndex++) {
+        Span = &WinMgr->DirtyLines[LineIndex];
+        Cell = &WinMgr->Contents[LineIndex * BufferSize.X];
+        DisplayedCell = &WinMgr->DisplayedContents[LineIndex * BufferSize.X];
+
+        Index = Span->Left;
+        while (Index <= Span->Right) {
+
+            if (ContentsValid &&
+                Cell[Index].Char.UnicodeChar == DisplayedCell[Index].Char.UnicodeChar &&
+                Cell[Index].Attributes == DisplayedCell[Index].Attributes) {
+
+                Index++;
+                continue;
+            }
+
+            //
+            //  Find the end of this run of changes, allowing small gaps of
+            //  unchanged cells within it.
+            //
+
+            RunStart = Index;
+            RunEnd = Index;
+            for (Index = (SHORT)(RunStart + 1);
+                 Index <= Span->Right && Index - RunEnd <= YORI_WIN_MAX_COALESCE_GAP;
+                 Index++) {
+
+                if (!ContentsValid ||
+                    Cell[Index].Char.UnicodeChar != DisplayedCell[Index].Char.UnicodeChar ||
+                    Cell[Index].Attributes != DisplayedCell[Index].Attributes) {
+
+                    RunEnd = Index;
+                }
+            }
+
+            if (WinMgr->UseVtRendering) {
+
+                //
+                //  If the run starts on the padding cell following a double
+                //  wide character, the character needs to be displayed
+                //  again to display the padding cell.
+                //
+
+                if (RunStart > 0 &&
+                    WinMgr->IsDoubleWideSupported &&
+                    YoriLibIsDoubleWideChar(Cell[RunStart - 1].Char.UnicodeChar)) {
+
+                    RunStart--;
+                }
+
+                if (!YoriWinMgrVtAppendRun(WinMgr, LineIndex, RunStart, RunEnd, &CurrentAttributes)) {
+                    return FALSE;
+                }
+            } else {
+                BufferPosition.X = RunStart;
+                BufferPosition.Y = LineIndex;
+
+                RedrawWindow.Left = (SHORT)(RunStart + WinMgrPos.Left);
+                RedrawWindow.Right = (SHORT)(RunEnd + WinMgrPos.Left);
+                RedrawWindow.Top = (SHORT)(LineIndex + WinMgrPos.Top);
+                RedrawWindow.Bottom = RedrawWindow.Top;
+
+                if (!WriteConsoleOutput(WinMgr->hConOut, WinMgr->Contents, BufferSize, BufferPosition, &RedrawWindow)) {
+                    return FALSE;
+                }
+            }
+
+            memcpy(&DisplayedCell[RunStart], &Cell[RunStart], (RunEnd - RunStart + 1) * sizeof(CHAR_INFO));
+            Index = (SHORT)(RunEnd + 1);
+        }
+
+        Span->Left = BufferSize.X;
+        Span->Right = -1;
+    }
+
+    //
+    //  When using VT sequences, return the cursor to where it was before
+    //  drawing, reset the color, and display the cursor if it was visible.
+    //
+
+    if (WinMgr->UseVtRendering) {
+        CursorPosition.X = (SHORT)(WinMgr->DisplayedCursorState.Pos.X - WinMgrPos.Left);
+        CursorPosition.Y = (SHORT)(WinMgr->DisplayedCursorState.Pos.Y - WinMgrPos.Top);
+        if (CursorPosition.X < 0 || CursorPosition.Y < 0) {
+            CursorPosition.X = 0;
+            CursorPosition.Y = 0;
+        }
+        if (!YoriWinMgrVtAppendCursorPosition(WinMgr, CursorPosition)) {
+            return FALSE;
+        }
+        if (!YoriWinMgrVtAppend(WinMgr, _T("\x1b[0m"), sizeof("\x1b[0m") - 1)) {
+            return FALSE;
+        }
+        if (WinMgr->DisplayedCursorState.Visible) {
+            if (!YoriWinMgrVtAppend(WinMgr, _T("\x1b[?25h"), sizeof("\x1b[?25h") - 1)) {
+                return FALSE;
+            }
+        }
+        if (!YoriWinMgrVtFlush(WinMgr)) {
+            return FALSE;
+        }
+    }
+
+    WinMgr->DisplayDirty = FALSE;
+    WinMgr->DisplayedContentsValid = TRUE;
+    return TRUE;
+}
+
 /**
  Display the contents of the staged display into the console.  Generating
  this display is done via @ref YoriWinMgrRegenerateRegion .
@@ -1748,10 +2343,8 @@ YoriWinMgrDisplayContents(
     )
 {
     PYORI_WIN_WINDOW_MANAGER WinMgr = (PYORI_WIN_WINDOW_MANAGER)WinMgrHandle;
-    COORD BufferPosition;
     COORD BufferSize;
     SMALL_RECT WinMgrPos;
-    SMALL_RECT RedrawWindow;
     PYORI_LIST_ENTRY ListEntry;
     PYORI_WIN_WINDOW_HANDLE WindowHandle;
     YORI_WIN_CURSOR_STATE NewCursorState;
@@ -1768,25 +2361,13 @@ YoriWinMgrDisplayContents(
 
     if (WinMgr->DisplayDirty && YoriLibIsNanoServer()) {
 
-        YoriWinGetWinMgrLocation(WinMgr, &WinMgrPos);
-
-        BufferPosition.X = WinMgr->DirtyRect.Left;
-        BufferPosition.Y = WinMgr->DirtyRect.Top;
-
-        RedrawWindow.Left = (SHORT)(WinMgr->DirtyRect.Left + WinMgrPos.Left);
-        RedrawWindow.Right = (SHORT)(WinMgr->DirtyRect.Right + WinMgrPos.Left);
-        RedrawWindow.Top = (SHORT)(WinMgr->DirtyRect.Top + WinMgrPos.Top);
-        RedrawWindow.Bottom = (SHORT)(WinMgr->DirtyRect.Bottom + WinMgrPos.Top);
-
-        if (!WriteConsoleOutput(WinMgr->hConOut, WinMgr->Contents, BufferSize, BufferPosition, &RedrawWindow)) {
+        if (!YoriWinMgrWriteChangedCells(WinMgr)) {
             return FALSE;
         }
 
         if (YoriLibIsNanoServer() && WinMgr->DisplayedCursorState.Visible) {
             WinMgr->UpdateCursor = TRUE;
         }
-
-        WinMgr->DisplayDirty = FALSE;
     }
 
     //
@@ -1877,22 +2458,9 @@ YoriWinMgrDisplayContents(
     //
 
     if (WinMgr->DisplayDirty) {
-
-        YoriWinGetWinMgrLocation(WinMgr, &WinMgrPos);
-
-        BufferPosition.X = WinMgr->DirtyRect.Left;
-        BufferPosition.Y = WinMgr->DirtyRect.Top;
-
-        RedrawWindow.Left = (SHORT)(WinMgr->DirtyRect.Left + WinMgrPos.Left);
-        RedrawWindow.Right = (SHORT)(WinMgr->DirtyRect.Right + WinMgrPos.Left);
-        RedrawWindow.Top = (SHORT)(WinMgr->DirtyRect.Top + WinMgrPos.Top);
-        RedrawWindow.Bottom = (SHORT)(WinMgr->DirtyRect.Bottom + WinMgrPos.Top);
-
-        if (!WriteConsoleOutput(WinMgr->hConOut, WinMgr->Contents, BufferSize, BufferPosition, &RedrawWindow)) {
+        if (!YoriWinMgrWriteChangedCells(WinMgr)) {
             return FALSE;
         }
-
-        WinMgr->DisplayDirty = FALSE;
     }
 
     return TRUE;
@@ -2487,11 +3055,17 @@ YoriWinMgrProcessExpiredTimers(
             Timer = CONTAINING_RECORD(ListEntry, YORI_WIN_TIMER, ListEntry);
             ListEntry = YoriLibGetNextListEntry(&WinMgr->TimerList, ListEntry);
             if (Timer->ExpirationTime < CurrentTime) {
+
+                //
+                //  Update the timer before notifying the control, since the
+                //  control may choose to free the timer in response.
+                //
+
+                Timer->PeriodsExpired++;
+                YoriWinMgrCalculateNextExpiration(Timer);
                 Event.EventType = YoriWinEventTimer;
                 Event.Timer.Timer = Timer;
                 Timer->NotifyCtrl->NotifyEventFn(Timer->NotifyCtrl, &Event);
-                Timer->PeriodsExpired++;
-                YoriWinMgrCalculateNextExpiration(Timer);
             }
         }
     }
@@ -2553,9 +3127,144 @@ YoriWinMgrProcessPostedEvents(
 }
 
 
+/**
+ Return TRUE if an input record describes a key press or release that only
+ generates text, without Ctrl or Alt, and which could therefore be combined
+ with neighboring records into a single insertion of text.  Shift key
+ transitions are included since they are generated around upper case
+ characters.
+
+ @param InputRecord Pointer to the input record.
+
+ @return TRUE if the record describes text input, FALSE if not.
+ */
+BOOLEAN
+YoriWinMgrIsTextInputRecord(
+    __in PINPUT_RECORD InputRecord
+    )
+{
+    PKEY_EVENT_RECORD KeyEvent;
+    TCHAR Char;
+
+    if (InputRecord->EventType != KEY_EVENT) {
+        return FALSE;
+    }
+
+    KeyEvent = &InputRecord->Event.KeyEvent;
+    if (KeyEvent->wRepeatCount > 1) {
+        return FALSE;
+    }
+
+    if (KeyEvent->dwControlKeyState & (RIGHT_ALT_PRESSED | LEFT_ALT_PRESSED | RIGHT_CTRL_PRESSED | LEFT_CTRL_PRESSED)) {
+        return FALSE;
+    }
+
+    Char = KeyEvent->uChar.UnicodeChar;
+    if (Char == '\0') {
+        if (KeyEvent->wVirtualKeyCode == VK_SHIFT) {
+            return TRUE;
+        }
+        return FALSE;
+    }
+
+    if (Char == '\r') {
+        if (KeyEvent->wVirtualKeyCode == VK_RETURN) {
+            return TRUE;
+        }
+        return FALSE;
+    }
+
+    if (Char < ' ' || Char == 0x7f) {
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ Check whether a batch of input records begins with a long run of text, as
+ happens when text is pasted into the console, and if so deliver that text
+ to the window with focus as a single insertion.  If the window does not
+ process the insertion, the records should be processed as individual key
+ presses.
+
+ @param WinMgr Pointer to the window manager.
+
+ @param InputRecords Pointer to an array of input records.
+
+ @param RecordCount The number of elements in the InputRecords array.
+
+ @return The number of input records that have been processed.  Zero
+         indicates the records should be processed individually.
+ */
+DWORD
+YoriWinMgrProcessTextInputRecords(
+    __in PYORI_WIN_WINDOW_MANAGER WinMgr,
+    __in_ecount(RecordCount) PINPUT_RECORD InputRecords,
+    __in DWORD RecordCount
+    )
+{
+    PYORI_WIN_CTRL KeyFocusWindow;
+    PKEY_EVENT_RECORD KeyEvent;
+    YORI_WIN_EVENT Event;
+    YORI_STRING Text;
+    DWORD Index;
+    DWORD RecordsInRun;
+    YORI_ALLOC_SIZE_T CharCount;
+    BOOLEAN Processed;
+
+    CharCount = 0;
+    for (Index = 0; Index < RecordCount; Index++) {
+        if (!YoriWinMgrIsTextInputRecord(&InputRecords[Index])) {
+            break;
+        }
+        KeyEvent = &InputRecords[Index].Event.KeyEvent;
+        if (KeyEvent->bKeyDown && KeyEvent->uChar.UnicodeChar != '\0') {
+            CharCount++;
+        }
+    }
+    RecordsInRun = Index;
+
+    if (CharCount < YORI_WIN_MIN_INSERT_TEXT_CHARS) {
+        return 0;
+    }
+
+    KeyFocusWindow = YoriWinMgrTopMostWindow(WinMgr, FALSE);
+    if (KeyFocusWindow == NULL ||
+        !YoriWinIsWindowEnabled(YoriWinGetWindowFromWindowCtrl(KeyFocusWindow))) {
+
+        return 0;
+    }
+
+    if (!YoriLibAllocateString(&Text, CharCount)) {
+        return 0;
+    }
+
+    for (Index = 0; Index < RecordsInRun; Index++) {
+        KeyEvent = &InputRecords[Index].Event.KeyEvent;
+        if (KeyEvent->bKeyDown && KeyEvent->uChar.UnicodeChar != '\0') {
+            Text.StartOfString[Text.LengthInChars] = KeyEvent->uChar.UnicodeChar;
+            Text.LengthInChars++;
+        }
+    }
+
+    ZeroMemory(&Event, sizeof(Event));
+    Event.EventType = YoriWinEventInsertText;
+    Event.InsertText.Text = &Text;
+
+    Processed = KeyFocusWindow->NotifyEventFn(KeyFocusWindow, &Event);
+    YoriLibFreeStringContents(&Text);
+
+    if (!Processed) {
+        return 0;
+    }
+
+    YoriWinFlushWindowContents(YoriWinGetWindowFromWindowCtrl(KeyFocusWindow));
+    return RecordsInRun;
+}
+
 /**
  Notify windows as necessary for key press and release events.
- click events.
 
  @param WinMgr Pointer to the window manager.
 
@@ -2993,10 +3702,8 @@ YoriWinMgrProcessBufferSizeEvent(
     PYORI_WIN_CTRL CurrentWinCtrl;
     CONSOLE_SCREEN_BUFFER_INFO OldScreenBufferInfo;
     CONSOLE_SCREEN_BUFFER_INFO NewScreenBufferInfo;
-    PCHAR_INFO NewAllocation;
     PSMALL_RECT Rect;
     SMALL_RECT NewRect;
-    YORI_ALLOC_SIZE_T CellCount;
     COORD NewSize;
     COORD OldSize;
     HANDLE hConOut;
@@ -3013,8 +3720,6 @@ YoriWinMgrProcessBufferSizeEvent(
     Rect = &NewScreenBufferInfo.srWindow;
     NewSize.X = (SHORT)(Rect->Right - Rect->Left + 1);
     NewSize.Y = (SHORT)(Rect->Bottom - Rect->Top + 1);
-    CellCount = NewSize.Y;
-    CellCount = CellCount * NewSize.X;
 
     //
     //  If this allocation fails, the console will reflow text, so we
@@ -3026,8 +3731,7 @@ YoriWinMgrProcessBufferSizeEvent(
     //  to the size of the actual console.
     //
 
-    NewAllocation = YoriLibMalloc(CellCount * sizeof(CHAR_INFO));
-    if (NewAllocation != NULL) {
+    if (YoriWinMgrAllocateContents(WinMgr, NewSize)) {
 
         //
         //  The new screen buffer info contains a cursor at whatever position
@@ -3050,11 +3754,6 @@ YoriWinMgrProcessBufferSizeEvent(
 
         memcpy(&WinMgr->SavedScreenBufferInfo, &NewScreenBufferInfo, sizeof(CONSOLE_SCREEN_BUFFER_INFO));
 
-        if (WinMgr->Contents != NULL) {
-            YoriLibFree(WinMgr->Contents);
-        }
-        WinMgr->Contents = NewAllocation;
-
         //
         //  From the bottom of the stack to the top of the stack, show all
         //  windows again, capturing the new contents of what is underneath.
@@ -3132,13 +3831,17 @@ YoriWinMgrProcessAllEvents(
 {
     HANDLE hConIn;
     HANDLE hConOut;
-    INPUT_RECORD InputRecords[10];
+    INPUT_RECORD InputRecords[YORI_WIN_INPUT_RECORDS_PER_READ];
     PINPUT_RECORD InputRecord;
     PYORI_WIN_WINDOW_MANAGER WinMgr;
     DWORD ActuallyRead;
     DWORD Index;
+    DWORD RecordsProcessed;
+    DWORD PendingEvents;
+    LONGLONG CurrentTime;
     PYORI_WIN_CTRL WindowCtrl;
     BOOLEAN Result;
+    BOOLEAN FrameDue;
 
     WinMgr = (PYORI_WIN_WINDOW_MANAGER)WinMgrHandle;
 
@@ -3186,11 +3889,28 @@ YoriWinMgrProcessAllEvents(
         YoriWinMgrProcessPostedEvents(WinMgr);
 
         //
-        //  Display window manager contents if they have changed.
+        //  Display window manager contents if they have changed.  If more
+        //  input is already waiting and the console was updated recently,
+        //  process that input first, so a burst of input is displayed in a
+        //  single update.
         //
 
-        if (!YoriWinMgrDisplayContents(WinMgr)) {
-            break;
+        FrameDue = TRUE;
+        if (WinMgr->MinimumFrameIntervalInMs > 0 &&
+            GetNumberOfConsoleInputEvents(hConIn, &PendingEvents) &&
+            PendingEvents > 0) {
+
+            CurrentTime = YoriLibGetSystemTimeAsInteger();
+            if (CurrentTime - WinMgr->LastFrameTime < (LONGLONG)WinMgr->MinimumFrameIntervalInMs * 1000 * 10) {
+                FrameDue = FALSE;
+            }
+        }
+
+        if (FrameDue) {
+            if (!YoriWinMgrDisplayContents(WinMgr)) {
+                break;
+            }
+            WinMgr->LastFrameTime = YoriLibGetSystemTimeAsInteger();
         }
 
         //
@@ -3204,6 +3924,11 @@ YoriWinMgrProcessAllEvents(
         for (Index = 0; Index < ActuallyRead; Index++) {
             InputRecord = &InputRecords[Index];
             if (InputRecord->EventType == KEY_EVENT) {
+                RecordsProcessed = YoriWinMgrProcessTextInputRecords(WinMgr, InputRecord, ActuallyRead - Index);
+                if (RecordsProcessed > 0) {
+                    Index = Index + RecordsProcessed - 1;
+                    continue;
+                }
                 YoriWinMgrProcessKeyEvent(WinMgr, InputRecord);
             } else if (InputRecord->EventType == MOUSE_EVENT) {
                 YoriWinMgrProcessMouseEvent(WinMgr, InputRecord);
@@ -131,7 +131,8 @@ typedef struct _YORI_WIN_EVENT {
         YoriWinEventParentResize                = 33,
         YoriWinEventMouseMoveOutsideWindow      = 34,
         YoriWinEventTimer                       = 35,
-        YoriWinEventBeyondMax                   = 36
+        YoriWinEventInsertText                  = 36,
+        YoriWinEventBeyondMax                   = 37
     } EventType;
 
     /**
@@ -192,6 +193,10 @@ typedef struct _YORI_WIN_EVENT {
         struct {
             PYORI_WIN_CTRL_HANDLE Timer;
         } Timer;
+
+        struct {
+            PYORI_STRING Text;
+        } InsertText;
     };
 } YORI_WIN_EVENT, *PYORI_WIN_EVENT;
 
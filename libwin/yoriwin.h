@@ -331,6 +331,20 @@ YoriWinHexEditGetDataNoCopy(
     __out PYORI_ALLOC_SIZE_T BufferLength
     );
 
+BOOLEAN
+YoriWinHexEditGetDataPointer(
+    __in PYORI_WIN_CTRL_HANDLE CtrlHandle,
+    __out PUCHAR *Buffer,
+    __out PYORI_ALLOC_SIZE_T BufferLength
+    );
+
+BOOLEAN
+YoriWinHexEditGetModifiedRange(
+    __in PYORI_WIN_CTRL_HANDLE CtrlHandle,
+    __out PYORI_ALLOC_SIZE_T FirstOffset,
+    __out PYORI_ALLOC_SIZE_T BeyondLastOffset
+    );
+
 __success(return)
 BOOLEAN
 YoriWinHexEditGetSelectedData(
@@ -386,6 +400,13 @@ YoriWinHexEditSetCursorMoveNotifyCallback(
     __in PYORI_WIN_NOTIFY_HEX_EDIT_CURSOR_MOVE NotifyCallback
     );
 
+BOOLEAN
+YoriWinHexEditSetDataMapped(
+    __in PYORI_WIN_CTRL_HANDLE CtrlHandle,
+    __in PUCHAR MappedView,
+    __in YORI_ALLOC_SIZE_T ViewLength
+    );
+
 BOOLEAN
 YoriWinHexEditSetDataNoCopy(
     __in PYORI_WIN_CTRL_HANDLE CtrlHandle,
@@ -633,6 +654,22 @@ YoriWinLabelReposition(
  */
 #define YORI_WIN_LIST_STYLE_AUTO_HSCROLLBAR  (0x0040)
 
+/**
+ A function prototype that is invoked to obtain the text of an item in a
+ virtual list control.  The first parameter is the list control, the second
+ is the index of the item, and the third is an initialized empty string to
+ populate.  The string can refer to memory owned by the caller or can be
+ allocated; the list frees it with YoriLibFreeStringContents when it is no
+ longer needed.
+ */
+typedef BOOLEAN YORI_WIN_LIST_GET_VIRTUAL_ITEM(PYORI_WIN_CTRL_HANDLE, YORI_ALLOC_SIZE_T, PYORI_STRING);
+
+/**
+ A pointer to a function that is invoked to obtain the text of an item in a
+ virtual list control.
+ */
+typedef YORI_WIN_LIST_GET_VIRTUAL_ITEM *PYORI_WIN_LIST_GET_VIRTUAL_ITEM;
+
 PYORI_WIN_CTRL_HANDLE
 YoriWinListCreate(
     __in PYORI_WIN_WINDOW_HANDLE Parent,
@@ -685,6 +722,21 @@ YoriWinListGetItemText(
     __inout PYORI_STRING Text
     );
 
+__success(return)
+BOOLEAN
+YoriWinListSetVirtualItems(
+    __in PYORI_WIN_CTRL_HANDLE CtrlHandle,
+    __in PYORI_WIN_LIST_GET_VIRTUAL_ITEM GetItemCallback,
+    __in YORI_ALLOC_SIZE_T ItemCount
+    );
+
+__success(return)
+BOOLEAN
+YoriWinListSetVirtualItemCount(
+    __in PYORI_WIN_CTRL_HANDLE CtrlHandle,
+    __in YORI_ALLOC_SIZE_T ItemCount
+    );
+
 BOOLEAN
 YoriWinListReposition(
     __in PYORI_WIN_CTRL_HANDLE CtrlHandle,
@@ -830,6 +882,25 @@ typedef VOID YORI_WIN_NOTIFY_MULTILINE_EDIT_CURSOR_MOVE(PYORI_WIN_CTRL_HANDLE, D
  */
 typedef YORI_WIN_NOTIFY_MULTILINE_EDIT_CURSOR_MOVE *PYORI_WIN_NOTIFY_MULTILINE_EDIT_CURSOR_MOVE;
 
+/**
+ A function prototype that can be invoked to determine the colors of text on
+ a line.  The parameters are the control, the text of the line, the state at
+ the start of the line, an optional array of attributes containing one
+ element per character of the line, and on completion, the state at the end
+ of the line.  The attribute array is initialized to the control's text
+ color.  If the attribute array is NULL, only the state at the end of the
+ line is needed.  The state is interpreted only by the callback; it is zero
+ at the start of the buffer, and the state at the end of each line is the
+ state at the start of the next.
+ */
+typedef VOID YORI_WIN_NOTIFY_MULTILINE_EDIT_HIGHLIGHT_LINE(PYORI_WIN_CTRL_HANDLE, PCYORI_STRING, DWORD, PWORD, PDWORD);
+
+/**
+ A pointer to a function that can be invoked to determine the colors of text
+ on a line.
+ */
+typedef YORI_WIN_NOTIFY_MULTILINE_EDIT_HIGHLIGHT_LINE *PYORI_WIN_NOTIFY_MULTILINE_EDIT_HIGHLIGHT_LINE;
+
 /**
  The multiline edit should display a vertical scroll bar.
  */
@@ -1003,6 +1074,12 @@ YoriWinMultilineEditSetExpandTab(
     __in BOOLEAN ExpandTabEnabled
     );
 
+VOID
+YoriWinMultilineEditSetUndoBudget(
+    __in PYORI_WIN_CTRL_HANDLE CtrlHandle,
+    __in DWORDLONG UndoBudget
+    );
+
 VOID
 YoriWinMultilineEditSetTraditionalNavigation(
     __in PYORI_WIN_CTRL_HANDLE CtrlHandle,
@@ -1020,6 +1097,17 @@ YoriWinMultilineEditSetCursorMoveNotifyCallback(
     __in PYORI_WIN_NOTIFY_MULTILINE_EDIT_CURSOR_MOVE NotifyCallback
     );
 
+VOID
+YoriWinMultilineEditSetHighlightCallback(
+    __in PYORI_WIN_CTRL_HANDLE CtrlHandle,
+    __in_opt PYORI_WIN_NOTIFY_MULTILINE_EDIT_HIGHLIGHT_LINE HighlightCallback
+    );
+
+VOID
+YoriWinMultilineEditInvalidateHighlight(
+    __in PYORI_WIN_CTRL_HANDLE CtrlHandle
+    );
+
 BOOLEAN
 YoriWinMultilineEditIsUndoAvailable(
     __in PYORI_WIN_CTRL_HANDLE CtrlHandle
@@ -1102,6 +1190,18 @@ typedef VOID YORI_WIN_NOTIFY_WINDOW_MANAGER_RESIZE(PYORI_WIN_WINDOW_HANDLE, PSMA
  */
 typedef YORI_WIN_NOTIFY_WINDOW_MANAGER_RESIZE *PYORI_WIN_NOTIFY_WINDOW_MANAGER_RESIZE;
 
+/**
+ A function prototype that can be invoked periodically while a window is
+ displayed.
+ */
+typedef VOID YORI_WIN_NOTIFY_WINDOW_TIMER(PYORI_WIN_WINDOW_HANDLE);
+
+/**
+ A pointer to a function that can be invoked periodically while a window is
+ displayed.
+ */
+typedef YORI_WIN_NOTIFY_WINDOW_TIMER *PYORI_WIN_NOTIFY_WINDOW_TIMER;
+
 VOID
 YoriWinCloseWindow(
     __in PYORI_WIN_WINDOW_HANDLE WindowHandle,
@@ -1130,6 +1230,14 @@ YoriWinSetWindowManagerResizeNotifyCallback(
     __in PYORI_WIN_NOTIFY_WINDOW_MANAGER_RESIZE NotifyCallback
     );
 
+__success(return)
+BOOLEAN
+YoriWinSetWindowTimerCallback(
+    __in PYORI_WIN_WINDOW_HANDLE WindowHandle,
+    __in DWORD PeriodicInterval,
+    __in_opt PYORI_WIN_NOTIFY_WINDOW_TIMER NotifyCallback
+    );
+
 PYORI_WIN_WINDOW_MANAGER_HANDLE
 YoriWinGetWindowManagerHandle(
     __in PYORI_WIN_WINDOW_HANDLE WindowHandle
@@ -1243,6 +1351,19 @@ YoriWinMgrSetAsciiDrawing(
     __in BOOLEAN UseAsciiDrawing
     );
 
+__success(return)
+BOOLEAN
+YoriWinMgrSetVtRendering(
+    __in PYORI_WIN_WINDOW_MANAGER_HANDLE WinMgrHandle,
+    __in BOOLEAN UseVtRendering
+    );
+
+VOID
+YoriWinMgrSetMaximumFrameRate(
+    __in PYORI_WIN_WINDOW_MANAGER_HANDLE WinMgrHandle,
+    __in DWORD FramesPerSecond
+    );
+
 __success(return)
 BOOLEAN
 YoriWinGetWinMgrDimensions(
@@ -35,9 +35,10 @@ CHAR strLinesHelpText[] =
         "\n"
         "Count the number of lines in one or more files.\n"
         "\n"
-        "LINES [-license] [-b] [-l] [-s] [-t] [<file>...]\n"
+        "LINES [-license] [-b] [-j <count>] [-l] [-s] [-t] [<file>...]\n"
         "\n"
         "   -b             Use basic search criteria for files only\n"
+        "   -j <count>     Count lines in large files using count threads\n"
         "   -l             Display line length statistics\n"
         "   -s             Process files from all subdirectories\n"
         "   -t             Display total line count of all files\n";
@@ -122,6 +123,11 @@ typedef struct _LINES_CONTEXT {
      Records the total number of lines processed for all files.
      */
     YORI_MAX_SIGNED_T TotalLinesFound;
+
+    /**
+     The number of threads to use to count lines in a large file.
+     */
+    DWORD WorkerCount;
 } LINES_CONTEXT, *PLINES_CONTEXT;
 
 /**
@@ -155,7 +161,7 @@ LinesProcessStream(
 
     while (TRUE) {
 
-        if (!YoriLibReadLineToString(&LineString, &LineContext, hSource)) {
+        if (!YoriLibReadLineToView(&LineString, &LineContext, hSource)) {
             break;
         }
 
@@ -172,12 +178,495 @@ LinesProcessStream(
     }
 
     YoriLibLineReadCloseOrCache(LineContext);
-    YoriLibFreeStringContents(&LineString);
 
     LinesContext->TotalLinesFound += LinesContext->FileLinesFound;
     return TRUE;
 }
 
+/**
+ The maximum number of threads that can be used to count lines in a file.
+ */
+#define LINES_MAX_WORKERS 64
+
+/**
+ The smallest file that will be divided between threads.  Smaller files are
+ counted on a single thread.
+ */
+#define LINES_PARALLEL_MINIMUM_SIZE (4 * 1024 * 1024)
+
+/**
+ The number of bytes to read at a time when counting lines in a range of a
+ file.
+ */
+#define LINES_CHUNK_READ_SIZE (256 * 1024)
+
+/**
+ A range of a file to count lines within, and the result of counting them.
+ Lines are attributed to the range which contains their first character.
+ */
+typedef struct _LINES_CHUNK {
+
+    /**
+     The full path to the file, which is opened separately by each thread.
+     */
+    PYORI_STRING FilePath;
+
+    /**
+     The offset of the beginning of the range, in bytes.
+     */
+    DWORDLONG StartOffset;
+
+    /**
+     The offset of the end of the range, in bytes.  Lines beginning before
+     this offset are counted.
+     */
+    DWORDLONG EndOffset;
+
+    /**
+     The size of each character in the file, in bytes.  This is two if the
+     input is UTF16, and one otherwise.
+     */
+    DWORD CharSize;
+
+    /**
+     A buffer used to hold the contents of a line which spans more than one
+     read.
+     */
+    PUCHAR CarryBuffer;
+
+    /**
+     The number of bytes in CarryBuffer.
+     */
+    YORI_ALLOC_SIZE_T CarryBytes;
+
+    /**
+     The size of the CarryBuffer allocation, in bytes.
+     */
+    YORI_ALLOC_SIZE_T CarryAllocated;
+
+    /**
+     The number of lines found within the range.
+     */
+    YORI_MAX_SIGNED_T LinesFound;
+
+    /**
+     The shortest line found within the range.  Only meaningful if
+     LinesFound is nonzero.
+     */
+    YORI_MAX_UNSIGNED_T ShortestLine;
+
+    /**
+     The longest line found within the range.
+     */
+    YORI_MAX_UNSIGNED_T LongestLine;
+
+    /**
+     The total number of characters within all lines in the range.
+     */
+    YORI_MAX_SIGNED_T TotalChars;
+
+    /**
+     TRUE if the range was counted successfully.
+     */
+    BOOLEAN Succeeded;
+
+} LINES_CHUNK, *PLINES_CHUNK;
+
+/**
+ Record a line found within a range of a file.
+
+ @param Chunk Pointer to the range.
+
+ @param Line Pointer to the contents of the line in the input encoding,
+        excluding any line ending.
+
+ @param LineBytes The number of bytes in the line.
+ */
+VOID
+LinesChunkRecordLine(
+    __in PLINES_CHUNK Chunk,
+    __in PUCHAR Line,
+    __in YORI_ALLOC_SIZE_T LineBytes
+    )
+{
+    YORI_ALLOC_SIZE_T LineChars;
+
+    //
+    //  The line reader removes a byte order mark from the first line of a
+    //  file, so do the same here.
+    //
+
+    if (Chunk->StartOffset == 0 && Chunk->LinesFound == 0) {
+        UCHAR BomLength;
+        BomLength = YoriLibBytesInBom(Line, LineBytes);
+        Line = Line + BomLength;
+        LineBytes = LineBytes - BomLength;
+    }
+
+    if (Chunk->CharSize == sizeof(WCHAR)) {
+        LineChars = LineBytes / sizeof(WCHAR);
+    } else if (LineBytes > 0) {
+        LineChars = YoriLibGetMultibyteInputSizeNeeded((LPCSTR)Line, LineBytes);
+    } else {
+        LineChars = 0;
+    }
+
+    if (Chunk->LinesFound == 0 || LineChars < Chunk->ShortestLine) {
+        Chunk->ShortestLine = LineChars;
+    }
+    if (LineChars > Chunk->LongestLine) {
+        Chunk->LongestLine = LineChars;
+    }
+    Chunk->TotalChars = Chunk->TotalChars + LineChars;
+    Chunk->LinesFound++;
+}
+
+/**
+ Append part of a line to the carry buffer of a range, because the line
+ continues beyond the data that has been read.
+
+ @param Chunk Pointer to the range.
+
+ @param Data Pointer to the part of the line to append.
+
+ @param Length The number of bytes to append.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+LinesChunkCarry(
+    __in PLINES_CHUNK Chunk,
+    __in PUCHAR Data,
+    __in YORI_ALLOC_SIZE_T Length
+    )
+{
+    YORI_MAX_UNSIGNED_T BytesNeeded;
+    PUCHAR NewBuffer;
+
+    BytesNeeded = Chunk->CarryBytes;
+    BytesNeeded = BytesNeeded + Length;
+
+    if (BytesNeeded > Chunk->CarryAllocated) {
+        BytesNeeded = BytesNeeded + LINES_CHUNK_READ_SIZE;
+        if (!YoriLibIsSizeAllocatable(BytesNeeded)) {
+            return FALSE;
+        }
+        NewBuffer = YoriLibMalloc((YORI_ALLOC_SIZE_T)BytesNeeded);
+        if (NewBuffer == NULL) {
+            return FALSE;
+        }
+        if (Chunk->CarryBuffer != NULL) {
+            memcpy(NewBuffer, Chunk->CarryBuffer, Chunk->CarryBytes);
+            YoriLibFree(Chunk->CarryBuffer);
+        }
+        Chunk->CarryBuffer = NewBuffer;
+        Chunk->CarryAllocated = (YORI_ALLOC_SIZE_T)BytesNeeded;
+    }
+
+    memcpy(&Chunk->CarryBuffer[Chunk->CarryBytes], Data, Length);
+    Chunk->CarryBytes = Chunk->CarryBytes + Length;
+    return TRUE;
+}
+
+/**
+ Count the lines within a range of a file.  This opens its own handle to
+ the file so that many ranges can be read concurrently.
+
+ @param Context Pointer to the array of LINES_CHUNK structures describing
+        each range.
+
+ @param ChunkIndex The index of the range to count within the array.
+ */
+VOID
+LinesCountChunk(
+    __in PVOID Context,
+    __in DWORD ChunkIndex
+    )
+{
+    PLINES_CHUNK Chunk = &((PLINES_CHUNK)Context)[ChunkIndex];
+    HANDLE FileHandle;
+    PUCHAR Buffer;
+    LARGE_INTEGER ReadOffset;
+    DWORDLONG Position;
+    DWORDLONG LineStart;
+    DWORD BytesRead;
+    DWORD Index;
+    DWORD Char;
+    DWORD PreviousChar;
+    DWORD CharSize;
+    YORI_ALLOC_SIZE_T ContentStartIndex;
+    BOOLEAN LineActive;
+    BOOLEAN ContentEnded;
+    BOOLEAN LineStarts;
+    BOOLEAN Done;
+    BOOLEAN SkipFirstChar;
+
+    Chunk->Succeeded = FALSE;
+    CharSize = Chunk->CharSize;
+
+    FileHandle = CreateFile(Chunk->FilePath->StartOfString,
+                            GENERIC_READ,
+                            FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                            NULL,
+                            OPEN_EXISTING,
+                            FILE_ATTRIBUTE_NORMAL | FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_SEQUENTIAL_SCAN,
+                            NULL);
+
+    if (FileHandle == INVALID_HANDLE_VALUE) {
+        return;
+    }
+
+    Buffer = YoriLibMalloc(LINES_CHUNK_READ_SIZE);
+    if (Buffer == NULL) {
+        CloseHandle(FileHandle);
+        return;
+    }
+
+    //
+    //  Whether a line begins at the start of the range depends on the
+    //  character before it, so read from one character earlier.
+    //
+
+    ReadOffset.QuadPart = Chunk->StartOffset;
+    SkipFirstChar = FALSE;
+    if (Chunk->StartOffset > 0) {
+        ReadOffset.QuadPart = ReadOffset.QuadPart - CharSize;
+        SkipFirstChar = TRUE;
+    }
+
+    if (SetFilePointer(FileHandle, ReadOffset.LowPart, &ReadOffset.HighPart, FILE_BEGIN) == INVALID_SET_FILE_POINTER &&
+        GetLastError() != NO_ERROR) {
+
+        YoriLibFree(Buffer);
+        CloseHandle(FileHandle);
+        return;
+    }
+
+    Position = ReadOffset.QuadPart;
+    LineStart = 0;
+    PreviousChar = 0;
+    LineActive = FALSE;
+    ContentEnded = FALSE;
+    Done = FALSE;
+
+    while (!Done) {
+        if (!ReadFile(FileHandle, Buffer, LINES_CHUNK_READ_SIZE, &BytesRead, NULL)) {
+            break;
+        }
+
+        BytesRead = BytesRead - (BytesRead % CharSize);
+        if (BytesRead == 0) {
+
+            //
+            //  At the end of the file, the line being processed ends too.
+            //
+
+            if (LineActive && !ContentEnded) {
+                LinesChunkRecordLine(Chunk, Chunk->CarryBuffer, Chunk->CarryBytes);
+            }
+            Chunk->Succeeded = TRUE;
+            break;
+        }
+
+        if (YoriLibIsOperationCancelled()) {
+            break;
+        }
+
+        ContentStartIndex = 0;
+
+        for (Index = 0; Index < BytesRead; Index = Index + CharSize, Position = Position + CharSize) {
+            if (CharSize == sizeof(WCHAR)) {
+                Char = *(PWCHAR)(&Buffer[Index]);
+            } else {
+                Char = Buffer[Index];
+            }
+
+            if (SkipFirstChar) {
+                SkipFirstChar = FALSE;
+                PreviousChar = Char;
+                continue;
+            }
+
+            //
+            //  A line starts at the beginning of the file, after an LF, or
+            //  after a CR that is not followed by an LF.
+            //
+
+            LineStarts = FALSE;
+            if (Position == 0 ||
+                PreviousChar == '\n' ||
+                (PreviousChar == '\r' && Char != '\n')) {
+
+                LineStarts = TRUE;
+            }
+            PreviousChar = Char;
+
+            if (LineStarts) {
+                LineActive = TRUE;
+                ContentEnded = FALSE;
+                LineStart = Position;
+                ContentStartIndex = Index;
+                Chunk->CarryBytes = 0;
+                if (LineStart >= Chunk->EndOffset) {
+                    LineActive = FALSE;
+                    Done = TRUE;
+                    break;
+                }
+            }
+
+            if (LineActive && !ContentEnded && (Char == '\r' || Char == '\n')) {
+                ContentEnded = TRUE;
+                if (Chunk->CarryBytes > 0) {
+                    if (!LinesChunkCarry(Chunk, &Buffer[ContentStartIndex], Index - ContentStartIndex)) {
+                        Done = TRUE;
+                        break;
+                    }
+                    LinesChunkRecordLine(Chunk, Chunk->CarryBuffer, Chunk->CarryBytes);
+                } else {
+                    LinesChunkRecordLine(Chunk, &Buffer[ContentStartIndex], Index - ContentStartIndex);
+                }
+                Chunk->CarryBytes = 0;
+            }
+        }
+
+        if (Done) {
+            if (!LineActive) {
+                Chunk->Succeeded = TRUE;
+            }
+            break;
+        }
+
+        //
+        //  If the line continues into the next read, save the part of it
+        //  in this buffer.
+        //
+
+        if (LineActive && !ContentEnded) {
+            if (!LinesChunkCarry(Chunk, &Buffer[ContentStartIndex], BytesRead - ContentStartIndex)) {
+                break;
+            }
+        }
+    }
+
+    YoriLibFree(Buffer);
+    if (Chunk->CarryBuffer != NULL) {
+        YoriLibFree(Chunk->CarryBuffer);
+        Chunk->CarryBuffer = NULL;
+    }
+    CloseHandle(FileHandle);
+}
+
+/**
+ Count the lines in a large file by dividing it into ranges which are
+ counted concurrently.
+
+ @param FilePath Pointer to the full path to the file.
+
+ @param hSource Handle to the opened file.
+
+ @param LinesContext Specifies the context to record line count information.
+
+ @return TRUE to indicate the file was counted, FALSE if it could not be
+         divided between threads, in which case the caller should count it
+         on a single thread.
+ */
+__success(return)
+BOOL
+LinesProcessFileParallel(
+    __in PYORI_STRING FilePath,
+    __in HANDLE hSource,
+    __in PLINES_CONTEXT LinesContext
+    )
+{
+    LARGE_INTEGER FileSize;
+    PLINES_CHUNK Chunks;
+    DWORDLONG ChunkLength;
+    DWORD CharSize;
+    DWORD Index;
+    DWORD ChunkCount;
+    BOOLEAN Succeeded;
+
+    if (LinesContext->WorkerCount <= 1 ||
+        (GetFileType(hSource) & ~(FILE_TYPE_REMOTE)) != FILE_TYPE_DISK) {
+
+        return FALSE;
+    }
+
+    FileSize.LowPart = GetFileSize(hSource, (LPDWORD)&FileSize.HighPart);
+    if (FileSize.LowPart == INVALID_FILE_SIZE && GetLastError() != NO_ERROR) {
+        return FALSE;
+    }
+
+    if (FileSize.QuadPart < LINES_PARALLEL_MINIMUM_SIZE) {
+        return FALSE;
+    }
+
+    CharSize = 1;
+    if (YoriLibGetMultibyteInputEncoding() == CP_UTF16) {
+        CharSize = sizeof(WCHAR);
+    }
+
+    ChunkCount = LinesContext->WorkerCount;
+    Chunks = YoriLibMalloc((YORI_ALLOC_SIZE_T)(ChunkCount * sizeof(LINES_CHUNK)));
+    if (Chunks == NULL) {
+        return FALSE;
+    }
+    ZeroMemory(Chunks, ChunkCount * sizeof(LINES_CHUNK));
+
+    ChunkLength = FileSize.QuadPart / ChunkCount;
+    ChunkLength = ChunkLength - (ChunkLength % CharSize);
+
+    for (Index = 0; Index < ChunkCount; Index++) {
+        Chunks[Index].FilePath = FilePath;
+        Chunks[Index].CharSize = CharSize;
+        Chunks[Index].StartOffset = Index * ChunkLength;
+        Chunks[Index].EndOffset = (Index + 1) * ChunkLength;
+    }
+    Chunks[ChunkCount - 1].EndOffset = FileSize.QuadPart;
+
+    YoriLibProcessItemsInParallel(ChunkCount, ChunkCount, LinesCountChunk, Chunks);
+
+    Succeeded = TRUE;
+    for (Index = 0; Index < ChunkCount; Index++) {
+        if (!Chunks[Index].Succeeded) {
+            Succeeded = FALSE;
+        }
+    }
+
+    if (!Succeeded) {
+        YoriLibFree(Chunks);
+        return FALSE;
+    }
+
+    LinesContext->FilesFound++;
+    LinesContext->FilesFoundThisArg++;
+    LinesContext->FileLinesFound = 0;
+    LinesContext->FileShortestLine = 0;
+    LinesContext->FileLongestLine = 0;
+    LinesContext->FileTotalChars = 0;
+
+    for (Index = 0; Index < ChunkCount; Index++) {
+        if (Chunks[Index].LinesFound == 0) {
+            continue;
+        }
+        if (LinesContext->FileLinesFound == 0 ||
+            Chunks[Index].ShortestLine < LinesContext->FileShortestLine) {
+
+            LinesContext->FileShortestLine = Chunks[Index].ShortestLine;
+        }
+        if (Chunks[Index].LongestLine > LinesContext->FileLongestLine) {
+            LinesContext->FileLongestLine = Chunks[Index].LongestLine;
+        }
+        LinesContext->FileLinesFound = LinesContext->FileLinesFound + Chunks[Index].LinesFound;
+        LinesContext->FileTotalChars = LinesContext->FileTotalChars + Chunks[Index].TotalChars;
+    }
+
+    LinesContext->TotalLinesFound += LinesContext->FileLinesFound;
+    YoriLibFree(Chunks);
+    return TRUE;
+}
+
 /**
  A callback that is invoked when a file is found that matches a search criteria
  specified in the set of strings to enumerate.
@@ -231,7 +720,9 @@ LinesFileFoundCallback(
         }
 
         LinesContext->SavedErrorThisArg = ERROR_SUCCESS;
-        LinesProcessStream(FileHandle, LinesContext);
+        if (!LinesProcessFileParallel(FilePath, FileHandle, LinesContext)) {
+            LinesProcessStream(FileHandle, LinesContext);
+        }
 
         if (!LinesContext->SummaryOnly) {
             YORI_STRING StringFormOfLineCount;
@@ -380,6 +871,23 @@ ENTRYPOINT(
             } else if (YoriLibCompareStringLitIns(&Arg, _T("b")) == 0) {
                 BasicEnumeration = TRUE;
                 ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("j")) == 0) {
+                if (ArgC > i + 1) {
+                    YORI_ALLOC_SIZE_T CharsConsumed;
+                    YORI_MAX_SIGNED_T llTemp;
+                    if (YoriLibStringToNumber(&ArgV[i + 1], TRUE, &llTemp, &CharsConsumed) &&
+                        CharsConsumed > 0) {
+
+                        if (llTemp < 1) {
+                            llTemp = 1;
+                        } else if (llTemp > LINES_MAX_WORKERS) {
+                            llTemp = LINES_MAX_WORKERS;
+                        }
+                        LinesContext.WorkerCount = (DWORD)llTemp;
+                        ArgumentUnderstood = TRUE;
+                        i++;
+                    }
+                }
             } else if (YoriLibCompareStringLitIns(&Arg, _T("l")) == 0) {
                 LinesContext.DisplayLengthStats = TRUE;
                 ArgumentUnderstood = TRUE;
@@ -416,6 +924,13 @@ ENTRYPOINT(
 
     YoriLibEnableBackupPrivilege();
 
+    //
+    //  Buffer output so that each line isn't written separately when output
+    //  is going to a file or pipe.
+    //
+
+    YoriLibOutputBufferEnable(GetStdHandle(STD_OUTPUT_HANDLE));
+
     //
     //  If no file name is specified, use stdin; otherwise open
     //  the file and use that
@@ -423,6 +938,7 @@ ENTRYPOINT(
 
     if (StartArg == 0 || StartArg == ArgC) {
         if (YoriLibIsStdInConsole()) {
+            YoriLibOutputBufferDisable(GetStdHandle(STD_OUTPUT_HANDLE));
             YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("lines: No file or pipe for input\n"));
             return EXIT_FAILURE;
         }
@@ -465,6 +981,8 @@ ENTRYPOINT(
         }
     }
 
+    YoriLibOutputBufferDisable(GetStdHandle(STD_OUTPUT_HANDLE));
+
 #if !YORI_BUILTIN
     YoriLibLineReadCleanupCache();
 #endif
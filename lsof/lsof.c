@@ -161,183 +161,965 @@ LsofFileFoundCallback(
 }
 
 /**
- Display information about handles opened for all processes.
+ The state of an object type index whose type has not yet been determined.
+ */
+#define LSOF_TYPE_UNKNOWN     (0)
+
+/**
+ The state of an object type index which refers to file objects.
+ */
+#define LSOF_TYPE_FILE        (1)
+
+/**
+ The state of an object type index which refers to something other than
+ file objects.
+ */
+#define LSOF_TYPE_OTHER       (2)
+
+/**
+ The number of object type indexes that can be described by a handle entry.
+ */
+#define LSOF_TYPE_COUNT       (0x10000)
+
+/**
+ A value indicating no object index.
+ */
+#define LSOF_NO_OBJECT        ((DWORD)-1)
+
+/**
+ The maximum number of threads to use to resolve object names.
+ */
+#define LSOF_MAX_WORKERS      (16)
+
+/**
+ The number of milliseconds to allow a single object name query to take
+ before abandoning it.  Queries on files opened for synchronous IO can wait
+ behind an outstanding operation indefinitely, which is commonly seen on
+ pipes.
+ */
+#define LSOF_QUERY_TIMEOUT    (1000)
+
+/**
+ The number of milliseconds between checks for queries that have exceeded
+ their timeout.
+ */
+#define LSOF_POLL_INTERVAL    (100)
+
+/**
+ A worker state indicating the worker is not currently querying an object.
+ */
+#define LSOF_WORKER_IDLE      (0)
+
+/**
+ A worker state indicating the worker is querying an object name and can
+ be terminated if the query exceeds its timeout.
+ */
+#define LSOF_WORKER_QUERYING  (1)
+
+/**
+ A worker state indicating the main thread has decided to terminate the
+ worker.
+ */
+#define LSOF_WORKER_ABANDONED (2)
+
+/**
+ Information about a process found in the system handle list.
+ */
+typedef struct _LSOF_PROCESS {
+
+    /**
+     The process identifier.
+     */
+    DWORD ProcessId;
+
+    /**
+     A handle to the process, or NULL if the process could not be opened.
+     */
+    HANDLE ProcessHandle;
+} LSOF_PROCESS, *PLSOF_PROCESS;
+
+/**
+ Information about a single file object, which may be referenced by many
+ handles in many processes.  The name for each object is resolved once.
+ */
+typedef struct _LSOF_OBJECT {
+
+    /**
+     The kernel address of the object.
+     */
+    PVOID Object;
+
+    /**
+     The index of a process which has a handle to the object.
+     */
+    DWORD ProcessIndex;
+
+    /**
+     The handle to the object within the process above.
+     */
+    DWORD_PTR HandleValue;
+
+    /**
+     The name of the object, populated by a worker thread.
+     */
+    YORI_STRING Name;
+
+    /**
+     Set to TRUE if querying the name of the object exceeded its timeout.
+     */
+    BOOLEAN TimedOut;
+} LSOF_OBJECT, *PLSOF_OBJECT;
+
+/**
+ State used when displaying the handles opened by all processes.
+ */
+typedef struct _LSOF_HANDLE_CONTEXT {
+
+    /**
+     The list of handles in the system.
+     */
+    PYORI_SYSTEM_HANDLE_INFORMATION_EX Handles;
+
+    /**
+     An array of processes, with one entry for each run of handles opened by
+     the same process.
+     */
+    PLSOF_PROCESS Processes;
+
+    /**
+     The number of elements in the Processes array.
+     */
+    DWORD ProcessCount;
+
+    /**
+     An array of unique file objects.
+     */
+    PLSOF_OBJECT Objects;
+
+    /**
+     The number of elements populated in the Objects array.
+     */
+    DWORD ObjectCount;
+
+    /**
+     The number of elements allocated in the Objects array.
+     */
+    DWORD ObjectsAllocated;
+
+    /**
+     An open addressed hash table of indexes into the Objects array, keyed
+     by object address.  Unused entries contain LSOF_NO_OBJECT.
+     */
+    PDWORD ObjectTable;
+
+    /**
+     The number of entries in ObjectTable.  This is always a power of two.
+     */
+    DWORD ObjectTableSize;
+
+    /**
+     An array of LSOF_TYPE_COUNT elements indicating whether each object
+     type index refers to file objects.
+     */
+    PUCHAR TypeState;
+
+    /**
+     The index of the next object to be resolved by a worker thread.
+     */
+    volatile LONG NextObject;
+} LSOF_HANDLE_CONTEXT, *PLSOF_HANDLE_CONTEXT;
+
+/**
+ State for a single thread resolving object names.
+ */
+typedef struct _LSOF_WORKER {
+
+    /**
+     Pointer to the shared context describing the objects to resolve.
+     */
+    PLSOF_HANDLE_CONTEXT HandleContext;
+
+    /**
+     A handle to the worker thread.
+     */
+    HANDLE Thread;
+
+    /**
+     A buffer to receive object names from NtQueryObject.
+     */
+    PYORI_OBJECT_NAME_INFORMATION ObjectName;
+
+    /**
+     The number of bytes in the ObjectName buffer.
+     */
+    YORI_ALLOC_SIZE_T ObjectNameLength;
+
+    /**
+     A buffer to receive Win32 path names.
+     */
+    YORI_STRING PathBuffer;
+
+    /**
+     One of the LSOF_WORKER_ values.  Transitions out of
+     LSOF_WORKER_QUERYING are performed with an interlocked compare so that
+     the worker and the main thread agree on whether the query completed or
+     the worker is being terminated.
+     */
+    volatile LONG State;
+
+    /**
+     The index of the object currently being queried.
+     */
+    volatile DWORD CurrentObject;
+
+    /**
+     The tick count when the current query started.
+     */
+    volatile DWORD QueryStartTick;
+} LSOF_WORKER, *PLSOF_WORKER;
+
+/**
+ Calculate the hash of an object address.
+
+ @param Object The address of the object.
+
+ @return The hash of the object address.
+ */
+DWORD
+LsofHashObject(
+    __in PVOID Object
+    )
+{
+    DWORDLONG Value;
+    DWORD Hash;
+
+    //
+    //  Objects are aligned, so the low bits carry no information
+    //
+
+    Value = (DWORDLONG)(DWORD_PTR)Object;
+    Hash = (DWORD)(Value >> 4) ^ (DWORD)(Value >> 32);
+    return Hash * 0x9E3779B1;
+}
+
+/**
+ Find the entry in the object hash table for an object address.  This is
+ either the entry that refers to the object, or the empty entry where the
+ object should be inserted.
+
+ @param HandleContext Pointer to the context containing the hash table.
+
+ @param Object The address of the object to find.
+
+ @return Pointer to the hash table entry.
+ */
+PDWORD
+LsofFindObjectEntry(
+    __in PLSOF_HANDLE_CONTEXT HandleContext,
+    __in PVOID Object
+    )
+{
+    DWORD Mask;
+    DWORD Slot;
+
+    Mask = HandleContext->ObjectTableSize - 1;
+    Slot = LsofHashObject(Object) & Mask;
+    while (HandleContext->ObjectTable[Slot] != LSOF_NO_OBJECT &&
+           HandleContext->Objects[HandleContext->ObjectTable[Slot]].Object != Object) {
+
+        Slot = (Slot + 1) & Mask;
+    }
+
+    return &HandleContext->ObjectTable[Slot];
+}
+
+/**
+ Ensure there is space to record one more object, reallocating the object
+ array and hash table if required.
+
+ @param HandleContext Pointer to the context containing the objects.
+
+ @return TRUE to indicate space is available, FALSE to indicate allocation
+         failure.
+ */
+__success(return)
+BOOLEAN
+LsofGrowObjects(
+    __in PLSOF_HANDLE_CONTEXT HandleContext
+    )
+{
+    PLSOF_OBJECT NewObjects;
+    PDWORD NewTable;
+    PDWORD OldTable;
+    DWORD NewCount;
+    DWORD Index;
+
+    if (HandleContext->ObjectCount >= HandleContext->ObjectsAllocated) {
+        NewCount = HandleContext->ObjectsAllocated * 2;
+        if (NewCount == 0) {
+            NewCount = 0x1000;
+        }
+        if (!YoriLibIsSizeAllocatable((YORI_MAX_UNSIGNED_T)NewCount * sizeof(LSOF_OBJECT))) {
+            return FALSE;
+        }
+        NewObjects = YoriLibMalloc(NewCount * sizeof(LSOF_OBJECT));
+        if (NewObjects == NULL) {
+            return FALSE;
+        }
+        if (HandleContext->ObjectCount > 0) {
+            memcpy(NewObjects, HandleContext->Objects, HandleContext->ObjectCount * sizeof(LSOF_OBJECT));
+        }
+        if (HandleContext->Objects != NULL) {
+            YoriLibFree(HandleContext->Objects);
+        }
+        HandleContext->Objects = NewObjects;
+        HandleContext->ObjectsAllocated = NewCount;
+    }
+
+    //
+    //  Keep the hash table no more than half full so probe sequences stay
+    //  short
+    //
+
+    if ((HandleContext->ObjectCount + 1) * 2 > HandleContext->ObjectTableSize) {
+        NewCount = HandleContext->ObjectTableSize * 2;
+        if (NewCount == 0) {
+            NewCount = 0x2000;
+        }
+        if (!YoriLibIsSizeAllocatable((YORI_MAX_UNSIGNED_T)NewCount * sizeof(DWORD))) {
+            return FALSE;
+        }
+        NewTable = YoriLibMalloc(NewCount * sizeof(DWORD));
+        if (NewTable == NULL) {
+            return FALSE;
+        }
+        for (Index = 0; Index < NewCount; Index++) {
+            NewTable[Index] = LSOF_NO_OBJECT;
+        }
+
+        OldTable = HandleContext->ObjectTable;
+        HandleContext->ObjectTable = NewTable;
+        HandleContext->ObjectTableSize = NewCount;
+        for (Index = 0; Index < HandleContext->ObjectCount; Index++) {
+            *LsofFindObjectEntry(HandleContext, HandleContext->Objects[Index].Object) = Index;
+        }
+        if (OldTable != NULL) {
+            YoriLibFree(OldTable);
+        }
+    }
+
+    return TRUE;
+}
+
+/**
+ Determine whether an object type index refers to file objects by querying
+ the type of a handle of that type.
+
+ @param ProcessHandle A handle to the process containing the handle.
+
+ @param HandleValue The handle within the process.
+
+ @param ObjectType A buffer to receive the object type.
+
+ @param ObjectTypeLength The number of bytes in the ObjectType buffer.
+
+ @return The LSOF_TYPE_ value for this type index.  This is
+         LSOF_TYPE_UNKNOWN if the handle could not be queried.
+ */
+UCHAR
+LsofQueryObjectType(
+    __in HANDLE ProcessHandle,
+    __in DWORD_PTR HandleValue,
+    __in PYORI_OBJECT_TYPE_INFORMATION ObjectType,
+    __in YORI_ALLOC_SIZE_T ObjectTypeLength
+    )
+{
+    HANDLE LocalHandle;
+    YORI_STRING ObjectTypeString;
+    DWORD LengthReturned;
+    LONG Status;
+
+    if (!DuplicateHandle(ProcessHandle, (HANDLE)HandleValue, GetCurrentProcess(), &LocalHandle, 0, FALSE, DUPLICATE_SAME_ACCESS)) {
+        return LSOF_TYPE_UNKNOWN;
+    }
+
+    ObjectType->TypeName.LengthInBytes = 0;
+    Status = DllNtDll.pNtQueryObject(LocalHandle, 2, ObjectType, ObjectTypeLength, &LengthReturned);
+    CloseHandle(LocalHandle);
+
+    if (Status != 0) {
+        return LSOF_TYPE_UNKNOWN;
+    }
+
+    YoriLibInitEmptyString(&ObjectTypeString);
+    ObjectTypeString.LengthInChars = ObjectType->TypeName.LengthInBytes / sizeof(WCHAR);
+    ObjectTypeString.StartOfString = ObjectType->TypeName.Buffer;
+
+    if (YoriLibCompareStringLitIns(&ObjectTypeString, _T("File")) == 0) {
+        return LSOF_TYPE_FILE;
+    }
+
+    return LSOF_TYPE_OTHER;
+}
+
+/**
+ Walk the system handle list, opening each process, determining which
+ handles refer to files, and recording each unique file object once.
+
+ @param HandleContext Pointer to the context containing the handle list,
+        which is populated with processes and objects.
 
  @return TRUE to indicate success, FALSE to indicate failure.
  */
+__success(return)
 BOOLEAN
-LsofDumpHandles(VOID)
+LsofCollectObjects(
+    __in PLSOF_HANDLE_CONTEXT HandleContext
+    )
 {
     PYORI_SYSTEM_HANDLE_INFORMATION_EX Handles;
-    DWORD_PTR Index;
     PYORI_SYSTEM_HANDLE_ENTRY_EX ThisHandle;
-    HANDLE LocalProcessHandle;
-    PYORI_OBJECT_NAME_INFORMATION ObjectName;
     PYORI_OBJECT_TYPE_INFORMATION ObjectType;
-    YORI_STRING ModuleNameString;
-    YORI_STRING ObjectNameString;
-    YORI_STRING ObjectTypeString;
-    YORI_ALLOC_SIZE_T ObjectNameLength;
     YORI_ALLOC_SIZE_T ObjectTypeLength;
-    DWORD LengthReturned;
-    HANDLE ProcessHandle;
-    DWORD LastPid;
+    PLSOF_PROCESS Process;
+    PLSOF_OBJECT Object;
+    PDWORD Entry;
+    DWORD_PTR Index;
+    DWORD ProcessCount;
 
-    ProcessHandle = INVALID_HANDLE_VALUE;
-    LastPid = 0;
+    Handles = HandleContext->Handles;
 
-    YoriLibLoadPsapiFunctions();
+    //
+    //  Count the runs of handles belonging to the same process so the
+    //  process array can be allocated once
+    //
 
-    if (!YoriLibGetSystemHandlesList(&Handles)) {
-        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("lsof: Error getting system handle list\n"));
-        return FALSE;
+    ProcessCount = 0;
+    for (Index = 0; Index < Handles->NumberOfHandles; Index++) {
+        if (Index == 0 ||
+            Handles->Handles[Index].ProcessId != Handles->Handles[Index - 1].ProcessId) {
+
+            ProcessCount++;
+        }
     }
 
-    ObjectNameLength = YoriLibMaximumAllocationInRange(0x4000, 0x10000);
-    ObjectName = YoriLibMalloc(ObjectNameLength);
-    if (ObjectName == NULL) {
-        YoriLibFree(Handles);
-        return FALSE;
+    if (ProcessCount > 0) {
+        if (!YoriLibIsSizeAllocatable((YORI_MAX_UNSIGNED_T)ProcessCount * sizeof(LSOF_PROCESS))) {
+            return FALSE;
+        }
+        HandleContext->Processes = YoriLibMalloc(ProcessCount * sizeof(LSOF_PROCESS));
+        if (HandleContext->Processes == NULL) {
+            return FALSE;
+        }
     }
 
     ObjectTypeLength = 0x1000;
     ObjectType = YoriLibMalloc(ObjectTypeLength);
-    if (ObjectName == NULL) {
-        YoriLibFree(ObjectName);
-        YoriLibFree(Handles);
-        return FALSE;
-    }
-
-    if (!YoriLibAllocateString(&ModuleNameString, 0x8000)) {
-        YoriLibFree(ObjectType);
-        YoriLibFree(ObjectName);
-        YoriLibFree(Handles);
+    if (ObjectType == NULL) {
         return FALSE;
     }
 
+    Process = NULL;
     for (Index = 0; Index < Handles->NumberOfHandles; Index++) {
         ThisHandle = &Handles->Handles[Index];
-        if (ProcessHandle == INVALID_HANDLE_VALUE ||
-            LastPid != ThisHandle->ProcessId) {
-
-            if (ProcessHandle != INVALID_HANDLE_VALUE &&
-                ProcessHandle != NULL) {
-
-                CloseHandle(ProcessHandle);
-            }
+        if (Process == NULL || Process->ProcessId != ThisHandle->ProcessId) {
 
             //
             //  This open may fail.  If it does, we can't get information
-            //  about this process, which makes displaying numeric values
-            //  pointless.  Leaving this value as NULL is used to suppress
-            //  processing this process, but when we get to the next
-            //  process (LastPid != ThisHandle->ProcessId), the next
-            //  process will be opened.
+            //  about this process, and a NULL handle is used to suppress
+            //  processing its handles.
             //
 
-            ProcessHandle = OpenProcess(PROCESS_DUP_HANDLE | PROCESS_QUERY_INFORMATION | PROCESS_VM_READ, FALSE, (DWORD)ThisHandle->ProcessId);
-            if (ProcessHandle == NULL) {
-                ProcessHandle = OpenProcess(PROCESS_DUP_HANDLE, FALSE, (DWORD)ThisHandle->ProcessId);
+            Process = &HandleContext->Processes[HandleContext->ProcessCount];
+            HandleContext->ProcessCount++;
+            Process->ProcessId = (DWORD)ThisHandle->ProcessId;
+            Process->ProcessHandle = OpenProcess(PROCESS_DUP_HANDLE | PROCESS_QUERY_INFORMATION | PROCESS_VM_READ, FALSE, Process->ProcessId);
+            if (Process->ProcessHandle == NULL) {
+                Process->ProcessHandle = OpenProcess(PROCESS_DUP_HANDLE, FALSE, Process->ProcessId);
             }
-            LastPid = (DWORD)ThisHandle->ProcessId;
+        }
 
-            ModuleNameString.LengthInChars = 0;
-            if (DllPsapi.pGetModuleFileNameExW != NULL &&
-                ProcessHandle != NULL) {
+        if (Process->ProcessHandle == NULL) {
+            continue;
+        }
 
-                ModuleNameString.LengthInChars =
-                    (YORI_ALLOC_SIZE_T)DllPsapi.pGetModuleFileNameExW(ProcessHandle,
-                                                                      NULL,
-                                                                      ModuleNameString.StartOfString,
-                                                                      ModuleNameString.LengthAllocated);
-            }
+        //
+        //  The handle list describes the type of each handle as an index.
+        //  Only duplicate a handle to learn the type of an index that has
+        //  not been seen before, so handles that are not files are skipped
+        //  without being duplicated.
+        //
 
-            if (ProcessHandle == NULL) {
-                YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("Process %i ** NO ACCESS **\n"), LastPid);
-            } else {
-                YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("Process %i %y\n"), LastPid, &ModuleNameString);
+        if (HandleContext->TypeState[ThisHandle->ObjectType] == LSOF_TYPE_UNKNOWN) {
+            HandleContext->TypeState[ThisHandle->ObjectType] =
+                LsofQueryObjectType(Process->ProcessHandle, ThisHandle->HandleValue, ObjectType, ObjectTypeLength);
+        }
+
+        if (HandleContext->TypeState[ThisHandle->ObjectType] != LSOF_TYPE_FILE) {
+            continue;
+        }
+
+        if (!LsofGrowObjects(HandleContext)) {
+            YoriLibFree(ObjectType);
+            return FALSE;
+        }
+
+        Entry = LsofFindObjectEntry(HandleContext, ThisHandle->Object);
+        if (*Entry == LSOF_NO_OBJECT) {
+            *Entry = HandleContext->ObjectCount;
+            Object = &HandleContext->Objects[HandleContext->ObjectCount];
+            HandleContext->ObjectCount++;
+            Object->Object = ThisHandle->Object;
+            Object->ProcessIndex = HandleContext->ProcessCount - 1;
+            Object->HandleValue = ThisHandle->HandleValue;
+            YoriLibInitEmptyString(&Object->Name);
+            Object->TimedOut = FALSE;
+        }
+    }
+
+    YoriLibFree(ObjectType);
+    return TRUE;
+}
+
+/**
+ Resolve the name of a single object.  This is invoked on a worker thread.
+
+ @param Worker Pointer to the worker state.
+
+ @param ObjectIndex The index of the object to resolve.
+ */
+VOID
+LsofResolveObject(
+    __in PLSOF_WORKER Worker,
+    __in DWORD ObjectIndex
+    )
+{
+    PLSOF_HANDLE_CONTEXT HandleContext;
+    PLSOF_OBJECT Object;
+    HANDLE ProcessHandle;
+    HANDLE LocalHandle;
+    YORI_STRING NameString;
+    DWORD LengthReturned;
+    LONG Status;
+
+    HandleContext = Worker->HandleContext;
+    Object = &HandleContext->Objects[ObjectIndex];
+    ProcessHandle = HandleContext->Processes[Object->ProcessIndex].ProcessHandle;
+
+    if (!DuplicateHandle(ProcessHandle, (HANDLE)Object->HandleValue, GetCurrentProcess(), &LocalHandle, 0, FALSE, DUPLICATE_SAME_ACCESS)) {
+        return;
+    }
+
+    //
+    //  Query the native name of the object.  This is the query that can
+    //  block indefinitely, so the main thread may terminate this thread
+    //  while it is in progress.  NtQueryObject is a system call that does
+    //  not acquire any user mode locks, so terminating it is safe.  If the
+    //  main thread decided to terminate this thread, wait for that to
+    //  happen rather than racing with it.
+    //
+
+    Worker->CurrentObject = ObjectIndex;
+    Worker->QueryStartTick = GetTickCount();
+    InterlockedExchange(&Worker->State, LSOF_WORKER_QUERYING);
+
+    Worker->ObjectName->Name.LengthInBytes = 0;
+    Status = DllNtDll.pNtQueryObject(LocalHandle, 1, Worker->ObjectName, Worker->ObjectNameLength, &LengthReturned);
+
+    if (InterlockedCompareExchange(&Worker->State, LSOF_WORKER_IDLE, LSOF_WORKER_QUERYING) != LSOF_WORKER_QUERYING) {
+        Sleep(INFINITE);
+    }
+
+    YoriLibInitEmptyString(&NameString);
+    if (Status == 0 && Worker->ObjectName->Name.LengthInBytes > 0) {
+        NameString.LengthInChars = Worker->ObjectName->Name.LengthInBytes / sizeof(WCHAR);
+        NameString.StartOfString = Worker->ObjectName->Name.Buffer;
+
+        //
+        //  The native name query completed promptly, so this is not a file
+        //  that blocks queries.  If it's possible to get a Win32 path name,
+        //  use that.  Otherwise, use what we have.
+        //
+
+        if (DllKernel32.pGetFinalPathNameByHandleW != NULL) {
+            Worker->PathBuffer.LengthInChars =
+                (YORI_ALLOC_SIZE_T)DllKernel32.pGetFinalPathNameByHandleW(LocalHandle,
+                                                                          Worker->PathBuffer.StartOfString,
+                                                                          Worker->PathBuffer.LengthAllocated,
+                                                                          0);
+
+            if (Worker->PathBuffer.LengthInChars > 0 &&
+                Worker->PathBuffer.LengthInChars < Worker->PathBuffer.LengthAllocated) {
+                NameString.LengthInChars = Worker->PathBuffer.LengthInChars;
+                NameString.StartOfString = Worker->PathBuffer.StartOfString;
             }
         }
+    }
 
-        if (ProcessHandle != NULL) {
+    CloseHandle(LocalHandle);
 
-            ObjectName->Name.LengthInBytes = 0;
-            ObjectType->TypeName.LengthInBytes = 0;
+    if (NameString.LengthInChars > 0 &&
+        YoriLibAllocateString(&Object->Name, NameString.LengthInChars + 1)) {
 
-            //
-            //  Get a local instance of the handle and see what information
-            //  can be extracted from them
-            //
+        memcpy(Object->Name.StartOfString, NameString.StartOfString, NameString.LengthInChars * sizeof(TCHAR));
+        Object->Name.LengthInChars = NameString.LengthInChars;
+        Object->Name.StartOfString[Object->Name.LengthInChars] = '\0';
+    }
+}
 
-            LocalProcessHandle = INVALID_HANDLE_VALUE;
-            if (DuplicateHandle(ProcessHandle, (HANDLE)ThisHandle->HandleValue, GetCurrentProcess(), &LocalProcessHandle, 0, FALSE, DUPLICATE_SAME_ACCESS)) {
-                DllNtDll.pNtQueryObject(LocalProcessHandle, 1, ObjectName, ObjectNameLength, &LengthReturned);
-                DllNtDll.pNtQueryObject(LocalProcessHandle, 2, ObjectType, ObjectTypeLength, &LengthReturned);
-            } else {
-                LocalProcessHandle = INVALID_HANDLE_VALUE;
+/**
+ A worker thread that resolves object names until no objects remain.
+
+ @param Context Pointer to the worker state.
+
+ @return Zero.
+ */
+DWORD WINAPI
+LsofResolveWorker(
+    __in LPVOID Context
+    )
+{
+    PLSOF_WORKER Worker;
+    DWORD ObjectIndex;
+
+    Worker = (PLSOF_WORKER)Context;
+
+    while (TRUE) {
+        ObjectIndex = (DWORD)(InterlockedIncrement(&Worker->HandleContext->NextObject) - 1);
+        if (ObjectIndex >= Worker->HandleContext->ObjectCount) {
+            break;
+        }
+        LsofResolveObject(Worker, ObjectIndex);
+    }
+
+    return 0;
+}
+
+/**
+ Allocate buffers for a worker and start its thread.
+
+ @param Worker Pointer to the worker state.  HandleContext is expected to be
+        initialized by the caller.
+
+ @return TRUE to indicate the worker was started, FALSE if it was not.
+ */
+__success(return)
+BOOLEAN
+LsofStartWorker(
+    __in PLSOF_WORKER Worker
+    )
+{
+    DWORD ThreadId;
+
+    Worker->State = LSOF_WORKER_IDLE;
+    Worker->CurrentObject = LSOF_NO_OBJECT;
+    Worker->ObjectNameLength = YoriLibMaximumAllocationInRange(0x4000, 0x10000);
+    Worker->ObjectName = YoriLibMalloc(Worker->ObjectNameLength);
+    if (Worker->ObjectName == NULL) {
+        return FALSE;
+    }
+
+    if (!YoriLibAllocateString(&Worker->PathBuffer, 0x8000)) {
+        YoriLibFree(Worker->ObjectName);
+        Worker->ObjectName = NULL;
+        return FALSE;
+    }
+
+    Worker->Thread = CreateThread(NULL, 0, LsofResolveWorker, Worker, 0, &ThreadId);
+    if (Worker->Thread == NULL) {
+        YoriLibFreeStringContents(&Worker->PathBuffer);
+        YoriLibFree(Worker->ObjectName);
+        Worker->ObjectName = NULL;
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ Resolve the names of all objects found in the handle list on a pool of
+ worker threads.  Any query that exceeds LSOF_QUERY_TIMEOUT causes its
+ worker to be terminated, the object to be marked as timed out, and a
+ replacement worker to be started.
+
+ @param HandleContext Pointer to the context containing the objects.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+LsofResolveObjectNames(
+    __in PLSOF_HANDLE_CONTEXT HandleContext
+    )
+{
+    LSOF_WORKER Workers[LSOF_MAX_WORKERS];
+    HANDLE ThreadHandles[LSOF_MAX_WORKERS];
+    SYSTEM_INFO SystemInfo;
+    PLSOF_WORKER Worker;
+    DWORD WorkerCount;
+    DWORD ActiveCount;
+    DWORD Index;
+    DWORD ObjectIndex;
+    DWORD WaitResult;
+
+    if (HandleContext->ObjectCount == 0) {
+        return TRUE;
+    }
+
+    GetSystemInfo(&SystemInfo);
+    WorkerCount = SystemInfo.dwNumberOfProcessors;
+    if (WorkerCount > LSOF_MAX_WORKERS) {
+        WorkerCount = LSOF_MAX_WORKERS;
+    }
+    if (WorkerCount > HandleContext->ObjectCount) {
+        WorkerCount = HandleContext->ObjectCount;
+    }
+    if (WorkerCount < 1) {
+        WorkerCount = 1;
+    }
+
+    ZeroMemory(Workers, sizeof(Workers));
+    HandleContext->NextObject = 0;
+
+    ActiveCount = 0;
+    for (Index = 0; Index < WorkerCount; Index++) {
+        Workers[Index].HandleContext = HandleContext;
+        if (LsofStartWorker(&Workers[Index])) {
+            ActiveCount++;
+        }
+    }
+
+    if (ActiveCount == 0) {
+        return FALSE;
+    }
+
+    while (TRUE) {
+        ActiveCount = 0;
+        for (Index = 0; Index < WorkerCount; Index++) {
+            if (Workers[Index].Thread != NULL) {
+                ThreadHandles[ActiveCount] = Workers[Index].Thread;
+                ActiveCount++;
             }
+        }
 
-            //
-            //  Convert any output into strings for display
-            //
+        if (ActiveCount == 0) {
+            break;
+        }
+
+        WaitResult = WaitForMultipleObjects(ActiveCount, ThreadHandles, TRUE, LSOF_POLL_INTERVAL);
+        if (WaitResult != WAIT_TIMEOUT) {
+            break;
+        }
 
-            YoriLibInitEmptyString(&ObjectNameString);
-            if (ObjectName->Name.LengthInBytes > 0) {
-                ObjectNameString.LengthInChars = ObjectName->Name.LengthInBytes / sizeof(WCHAR);
-                ObjectNameString.StartOfString = ObjectName->Name.Buffer;
+        //
+        //  Look for any worker whose query has run for too long.  If the
+        //  worker completes its query concurrently, the interlocked compare
+        //  determines whether it continues or is terminated.  A terminated
+        //  worker may still have a system call writing into its buffers, so
+        //  those buffers and its duplicated handle are deliberately leaked
+        //  and the replacement worker allocates its own.
+        //
+
+        for (Index = 0; Index < WorkerCount; Index++) {
+            Worker = &Workers[Index];
+            if (Worker->Thread == NULL ||
+                Worker->State != LSOF_WORKER_QUERYING ||
+                GetTickCount() - Worker->QueryStartTick < LSOF_QUERY_TIMEOUT) {
+
+                continue;
             }
-            YoriLibInitEmptyString(&ObjectTypeString);
-            if (ObjectType->TypeName.LengthInBytes > 0) {
-                ObjectTypeString.LengthInChars = ObjectType->TypeName.LengthInBytes / sizeof(WCHAR);
-                ObjectTypeString.StartOfString = ObjectType->TypeName.Buffer;
+
+            ObjectIndex = Worker->CurrentObject;
+            if (InterlockedCompareExchange(&Worker->State, LSOF_WORKER_ABANDONED, LSOF_WORKER_QUERYING) != LSOF_WORKER_QUERYING) {
+                continue;
             }
 
             //
-            //  Only display files, since that's part of the point of the
-            //  program.
+            //  TerminateThread is inherently evil, but there is no other
+            //  way to abandon a query that is waiting on an IO that may
+            //  never complete.
             //
 
-            if (YoriLibCompareStringLitIns(&ObjectTypeString, _T("File")) == 0) {
+            TerminateThread(Worker->Thread, 0);
+            CloseHandle(Worker->Thread);
+            Worker->Thread = NULL;
+            HandleContext->Objects[ObjectIndex].TimedOut = TRUE;
 
-                PYORI_STRING NameToDisplay;
+            ZeroMemory(&Worker->PathBuffer, sizeof(Worker->PathBuffer));
+            Worker->ObjectName = NULL;
+            LsofStartWorker(Worker);
+        }
+    }
+
+    for (Index = 0; Index < WorkerCount; Index++) {
+        Worker = &Workers[Index];
+        if (Worker->Thread != NULL) {
+            WaitForSingleObject(Worker->Thread, INFINITE);
+            CloseHandle(Worker->Thread);
+        }
+        if (Worker->ObjectName != NULL) {
+            YoriLibFree(Worker->ObjectName);
+        }
+        YoriLibFreeStringContents(&Worker->PathBuffer);
+    }
+
+    return TRUE;
+}
 
-                NameToDisplay = &ObjectNameString;
+/**
+ Free the state used to display handles.
 
-                //
-                //  If it's possible to get a Win32 path name, display that.
-                //  Otherwise, use what we have.
-                //
+ @param HandleContext Pointer to the context to free.
+ */
+VOID
+LsofCleanupHandleContext(
+    __in PLSOF_HANDLE_CONTEXT HandleContext
+    )
+{
+    DWORD Index;
 
-                ModuleNameString.LengthInChars = 0;
-                if (DllKernel32.pGetFinalPathNameByHandleW != NULL) {
+    for (Index = 0; Index < HandleContext->ObjectCount; Index++) {
+        YoriLibFreeStringContents(&HandleContext->Objects[Index].Name);
+    }
 
-                    ModuleNameString.LengthInChars =
-                        (YORI_ALLOC_SIZE_T)DllKernel32.pGetFinalPathNameByHandleW(LocalProcessHandle,
-                                                                                  ModuleNameString.StartOfString,
-                                                                                  ModuleNameString.LengthAllocated,
-                                                                                  0);
+    for (Index = 0; Index < HandleContext->ProcessCount; Index++) {
+        if (HandleContext->Processes[Index].ProcessHandle != NULL) {
+            CloseHandle(HandleContext->Processes[Index].ProcessHandle);
+        }
+    }
 
-                    if (ModuleNameString.LengthInChars > 0 &&
-                        ModuleNameString.LengthInChars < ModuleNameString.LengthAllocated) {
-                        NameToDisplay = &ModuleNameString;
-                    }
-                }
+    if (HandleContext->Objects != NULL) {
+        YoriLibFree(HandleContext->Objects);
+    }
+    if (HandleContext->ObjectTable != NULL) {
+        YoriLibFree(HandleContext->ObjectTable);
+    }
+    if (HandleContext->Processes != NULL) {
+        YoriLibFree(HandleContext->Processes);
+    }
+    if (HandleContext->TypeState != NULL) {
+        YoriLibFree(HandleContext->TypeState);
+    }
+    if (HandleContext->Handles != NULL) {
+        YoriLibFree(HandleContext->Handles);
+    }
+}
+
+/**
+ Display information about handles opened for all processes.  File objects
+ are identified by their type index so other handles are not duplicated,
+ and each unique file object is queried once, on a pool of worker threads
+ with a timeout for each query.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOLEAN
+LsofDumpHandles(VOID)
+{
+    LSOF_HANDLE_CONTEXT HandleContext;
+    PYORI_SYSTEM_HANDLE_ENTRY_EX ThisHandle;
+    PLSOF_PROCESS Process;
+    PLSOF_OBJECT Object;
+    PYORI_STRING NameToDisplay;
+    YORI_STRING ModuleNameString;
+    YORI_STRING TimedOutString;
+    DWORD_PTR Index;
+    DWORD ProcessIndex;
+    DWORD ObjectIndex;
+    BOOLEAN Result = FALSE;
 
+    ZeroMemory(&HandleContext, sizeof(HandleContext));
+    YoriLibInitEmptyString(&ModuleNameString);
+    YoriLibConstantString(&TimedOutString, _T("** QUERY TIMED OUT **"));
+
+    YoriLibLoadPsapiFunctions();
+
+    if (!YoriLibGetSystemHandlesList(&HandleContext.Handles)) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("lsof: Error getting system handle list\n"));
+        return FALSE;
+    }
+
+    HandleContext.TypeState = YoriLibMalloc(LSOF_TYPE_COUNT * sizeof(UCHAR));
+    if (HandleContext.TypeState == NULL) {
+        goto Exit;
+    }
+    ZeroMemory(HandleContext.TypeState, LSOF_TYPE_COUNT * sizeof(UCHAR));
+
+    if (!YoriLibAllocateString(&ModuleNameString, 0x8000)) {
+        goto Exit;
+    }
+
+    if (!LsofCollectObjects(&HandleContext)) {
+        goto Exit;
+    }
 
-                YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("  Handle %lli Object %p  %y\n"), ThisHandle->HandleValue, ThisHandle->Object, NameToDisplay);
+    if (!LsofResolveObjectNames(&HandleContext)) {
+        goto Exit;
+    }
+
+    //
+    //  Walk the handle list in the same order as when collecting objects,
+    //  so each run of handles corresponds to the next process entry.
+    //
+
+    ProcessIndex = 0;
+    Process = NULL;
+    for (Index = 0; Index < HandleContext.Handles->NumberOfHandles; Index++) {
+        ThisHandle = &HandleContext.Handles->Handles[Index];
+        if (Process == NULL || Process->ProcessId != ThisHandle->ProcessId) {
+            Process = &HandleContext.Processes[ProcessIndex];
+            ProcessIndex++;
+
+            ModuleNameString.LengthInChars = 0;
+            if (DllPsapi.pGetModuleFileNameExW != NULL &&
+                Process->ProcessHandle != NULL) {
+
+                ModuleNameString.LengthInChars =
+                    (YORI_ALLOC_SIZE_T)DllPsapi.pGetModuleFileNameExW(Process->ProcessHandle,
+                                                                      NULL,
+                                                                      ModuleNameString.StartOfString,
+                                                                      ModuleNameString.LengthAllocated);
             }
 
-            if (LocalProcessHandle != INVALID_HANDLE_VALUE) {
-                CloseHandle(LocalProcessHandle);
+            if (Process->ProcessHandle == NULL) {
+                YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("Process %i ** NO ACCESS **\n"), Process->ProcessId);
+            } else {
+                YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("Process %i %y\n"), Process->ProcessId, &ModuleNameString);
             }
         }
+
+        //
+        //  Only display files, since that's part of the point of the
+        //  program.
+        //
+
+        if (Process->ProcessHandle == NULL ||
+            HandleContext.ObjectCount == 0 ||
+            HandleContext.TypeState[ThisHandle->ObjectType] != LSOF_TYPE_FILE) {
+
+            continue;
+        }
+
+        ObjectIndex = *LsofFindObjectEntry(&HandleContext, ThisHandle->Object);
+        if (ObjectIndex == LSOF_NO_OBJECT) {
+            continue;
+        }
+
+        Object = &HandleContext.Objects[ObjectIndex];
+        NameToDisplay = &Object->Name;
+        if (Object->TimedOut) {
+            NameToDisplay = &TimedOutString;
+        }
+
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("  Handle %lli Object %p  %y\n"), ThisHandle->HandleValue, ThisHandle->Object, NameToDisplay);
     }
 
+    Result = TRUE;
+
+Exit:
     YoriLibFreeStringContents(&ModuleNameString);
-    YoriLibFree(ObjectType);
-    YoriLibFree(ObjectName);
-    YoriLibFree(Handles);
-    return TRUE;
+    LsofCleanupHandleContext(&HandleContext);
+    return Result;
 }
 
 #ifdef YORI_BUILTIN
@@ -153,5 +153,180 @@ MakeSlabCleanup(
     Alloc->ElementSize = 0;
 }
 
+/**
+ The number of bytes to allocate from the system for each arena chunk,
+ unless a single allocation requires more.
+ */
+#define MAKE_ARENA_CHUNK_SIZE (64 * 1024)
+
+/**
+ Round a number of bytes up so that allocations from an arena remain
+ aligned for any structure.
+ */
+#define MAKE_ARENA_ALIGN(x) (((x) + sizeof(PVOID) - 1) & ~(sizeof(PVOID) - 1))
+
+/**
+ Allocate memory from an arena.  Memory allocated from an arena is not freed
+ individually; it is released when the arena is reset to a mark taken before
+ the allocation, or when the arena is cleaned up.
+
+ @param Arena Pointer to the arena.
+
+ @param SizeInBytes The number of bytes to allocate.
+
+ @return Pointer to the newly allocated memory or NULL on allocation failure.
+ */
+PVOID
+MakeArenaAlloc(
+    __in PMAKE_ARENA Arena,
+    __in YORI_ALLOC_SIZE_T SizeInBytes
+    )
+{
+    PMAKE_ARENA_CHUNK Chunk;
+    YORI_ALLOC_SIZE_T BytesRequired;
+    YORI_ALLOC_SIZE_T BytesToAllocate;
+    PVOID Result;
+
+    if (SizeInBytes > YORI_MAX_ALLOC_SIZE - sizeof(MAKE_ARENA_CHUNK) - sizeof(PVOID)) {
+        return NULL;
+    }
+
+    BytesRequired = (YORI_ALLOC_SIZE_T)MAKE_ARENA_ALIGN(SizeInBytes);
+
+    Chunk = Arena->Chunk;
+    if (Chunk == NULL ||
+        Chunk->BytesAllocated - Chunk->BytesUsed < BytesRequired) {
+
+        BytesToAllocate = MAKE_ARENA_CHUNK_SIZE;
+        if (BytesRequired + sizeof(MAKE_ARENA_CHUNK) > BytesToAllocate) {
+            BytesToAllocate = (YORI_ALLOC_SIZE_T)(BytesRequired + sizeof(MAKE_ARENA_CHUNK));
+        }
+
+        Chunk = YoriLibMalloc(BytesToAllocate);
+        if (Chunk == NULL) {
+            return NULL;
+        }
+
+        Chunk->Previous = Arena->Chunk;
+        Chunk->BytesAllocated = (YORI_ALLOC_SIZE_T)(BytesToAllocate - sizeof(MAKE_ARENA_CHUNK));
+        Chunk->BytesUsed = 0;
+        Arena->Chunk = Chunk;
+    }
+
+    Result = YoriLibAddToPointer(Chunk + 1, Chunk->BytesUsed);
+    Chunk->BytesUsed = Chunk->BytesUsed + BytesRequired;
+    Arena->NumberAllocations++;
+    return Result;
+}
+
+/**
+ Allocate a string from an arena.  The string has no memory to free, so
+ calling YoriLibFreeStringContents on it does nothing.
+
+ @param Arena Pointer to the arena.
+
+ @param String On successful completion, updated to refer to the newly
+        allocated string.
+
+ @param CharsToAllocate The number of characters to allocate.
+
+ @return TRUE to indicate success, FALSE to indicate allocation failure.
+ */
+__success(return)
+BOOLEAN
+MakeArenaAllocateString(
+    __in PMAKE_ARENA Arena,
+    __out PYORI_STRING String,
+    __in YORI_ALLOC_SIZE_T CharsToAllocate
+    )
+{
+    YoriLibInitEmptyString(String);
+    if (!YoriLibIsSizeAllocatable((YORI_MAX_UNSIGNED_T)CharsToAllocate * sizeof(TCHAR))) {
+        return FALSE;
+    }
+
+    String->StartOfString = MakeArenaAlloc(Arena, (YORI_ALLOC_SIZE_T)(CharsToAllocate * sizeof(TCHAR)));
+    if (String->StartOfString == NULL) {
+        return FALSE;
+    }
+
+    String->LengthAllocated = CharsToAllocate;
+    return TRUE;
+}
+
+/**
+ Record the current position within an arena so that later allocations can
+ be released by resetting the arena to this position.
+
+ @param Arena Pointer to the arena.
+
+ @param Mark On completion, populated with the current position.
+ */
+VOID
+MakeArenaGetMark(
+    __in PMAKE_ARENA Arena,
+    __out PMAKE_ARENA_MARK Mark
+    )
+{
+    Mark->Chunk = Arena->Chunk;
+    Mark->BytesUsed = 0;
+    if (Arena->Chunk != NULL) {
+        Mark->BytesUsed = Arena->Chunk->BytesUsed;
+    }
+}
+
+/**
+ Release all allocations made from an arena since a mark was taken.  Marks
+ must be reset in the reverse order to the order they were taken.  The
+ oldest chunk is retained for reuse, so an arena used for transient
+ allocations does not return to the system on each use.
+
+ @param Arena Pointer to the arena.
+
+ @param Mark Pointer to a position previously returned from
+        MakeArenaGetMark.
+ */
+VOID
+MakeArenaResetToMark(
+    __in PMAKE_ARENA Arena,
+    __in PMAKE_ARENA_MARK Mark
+    )
+{
+    PMAKE_ARENA_CHUNK Chunk;
+
+    while (Arena->Chunk != Mark->Chunk) {
+        Chunk = Arena->Chunk;
+        if (Mark->Chunk == NULL && Chunk->Previous == NULL) {
+            Chunk->BytesUsed = 0;
+            return;
+        }
+        Arena->Chunk = Chunk->Previous;
+        YoriLibFree(Chunk);
+    }
+
+    if (Arena->Chunk != NULL) {
+        Arena->Chunk->BytesUsed = Mark->BytesUsed;
+    }
+}
+
+/**
+ Free all memory allocated from an arena.
+
+ @param Arena Pointer to the arena.
+ */
+VOID
+MakeArenaCleanup(
+    __in PMAKE_ARENA Arena
+    )
+{
+    PMAKE_ARENA_CHUNK Chunk;
+
+    while (Arena->Chunk != NULL) {
+        Chunk = Arena->Chunk;
+        Arena->Chunk = Chunk->Previous;
+        YoriLibFree(Chunk);
+    }
+}
+
 
 // vim:sw=4:ts=4:et:
@@ -0,0 +1,604 @@
+/**
+ * @file make/digest.c
+ *
+ * Yori shell make content digests for rebuild decisions
+ *
+ * Copyright (c) 2026 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <yoripch.h>
+#include <yorilib.h>
+#include <yorish.h>
+#include "make.h"
+
+/**
+ The size of the buffer used to read files when calculating their digest.
+ */
+#define MAKE_DIGEST_READ_BUFFER_SIZE (64 * 1024)
+
+/**
+ Generate the name of the digest database from the name of the makefile.
+
+ @param MakeFileName Pointer to the file name of the makefile.
+
+ @param DigestFileName On successful completion, updated to contain a newly
+        allocated string referring to the file name of the digest database.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+MakeGetDigestFileName(
+    __in PYORI_STRING MakeFileName,
+    __out PYORI_STRING DigestFileName
+    )
+{
+    YoriLibInitEmptyString(DigestFileName);
+    if (MakeFileName->LengthInChars > 0) {
+        if (YoriLibAllocateString(DigestFileName, MakeFileName->LengthInChars + sizeof(".hash"))) {
+            DigestFileName->LengthInChars = YoriLibSPrintf(DigestFileName->StartOfString, _T("%y.hash"), MakeFileName);
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+/**
+ Add or update the digests recorded for a target.
+
+ @param MakeContext Pointer to the context.
+
+ @param TargetName Pointer to the fully qualified name of the target.
+
+ @param InputDigest Pointer to the digest of the commands and inputs used to
+        build the target.
+
+ @param OutputDigest Pointer to the digest of the target's contents after
+        it was built.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOLEAN
+MakeUpdateDigestEntry(
+    __in PMAKE_CONTEXT MakeContext,
+    __in PYORI_STRING TargetName,
+    __in PUCHAR InputDigest,
+    __in PUCHAR OutputDigest
+    )
+{
+    PYORI_HASH_ENTRY HashEntry;
+    PMAKE_DIGEST_ENTRY Entry;
+    YORI_STRING Key;
+
+    HashEntry = YoriLibHashLookupByKey(MakeContext->DigestTable, TargetName);
+    if (HashEntry != NULL) {
+        Entry = HashEntry->Context;
+        memcpy(Entry->InputDigest, InputDigest, MAKE_DIGEST_SIZE);
+        memcpy(Entry->OutputDigest, OutputDigest, MAKE_DIGEST_SIZE);
+        return TRUE;
+    }
+
+    Entry = YoriLibMalloc(sizeof(MAKE_DIGEST_ENTRY));
+    if (Entry == NULL) {
+        return FALSE;
+    }
+
+    if (!YoriLibCopyString(&Key, TargetName)) {
+        YoriLibFree(Entry);
+        return FALSE;
+    }
+
+    memcpy(Entry->InputDigest, InputDigest, MAKE_DIGEST_SIZE);
+    memcpy(Entry->OutputDigest, OutputDigest, MAKE_DIGEST_SIZE);
+    YoriLibHashInsertByKey(MakeContext->DigestTable, &Key, Entry, &Entry->HashEntry);
+    YoriLibAppendList(&MakeContext->DigestList, &Entry->ListEntry);
+    YoriLibFreeStringContents(&Key);
+    return TRUE;
+}
+
+/**
+ Open a cryptographic provider capable of calculating MD5 digests.
+
+ @param MakeContext Pointer to the context.  On successful completion, the
+        provider is stored in this context.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOLEAN
+MakeAcquireDigestProvider(
+    __inout PMAKE_CONTEXT MakeContext
+    )
+{
+    YoriLibLoadAdvApi32Functions();
+    if (DllAdvApi32.pCryptAcquireContextW == NULL ||
+        DllAdvApi32.pCryptCreateHash == NULL ||
+        DllAdvApi32.pCryptDestroyHash == NULL ||
+        DllAdvApi32.pCryptGetHashParam == NULL ||
+        DllAdvApi32.pCryptHashData == NULL ||
+        DllAdvApi32.pCryptReleaseContext == NULL) {
+
+        return FALSE;
+    }
+
+    //
+    //  MD5 is implemented by the base provider, so this is available on
+    //  every system with CryptoAPI.  NT 4 RTM doesn't support
+    //  CRYPT_VERIFYCONTEXT and may need a keyset to be created.
+    //
+
+    if (DllAdvApi32.pCryptAcquireContextW(&MakeContext->DigestProvider, NULL, MS_DEF_PROV, PROV_RSA_FULL, CRYPT_VERIFYCONTEXT)) {
+        return TRUE;
+    }
+
+    if (DllAdvApi32.pCryptAcquireContextW(&MakeContext->DigestProvider, NULL, MS_DEF_PROV, PROV_RSA_FULL, 0)) {
+        return TRUE;
+    }
+
+    if (GetLastError() == (DWORD)NTE_BAD_KEYSET &&
+        DllAdvApi32.pCryptAcquireContextW(&MakeContext->DigestProvider, NULL, MS_DEF_PROV, PROV_RSA_FULL, CRYPT_NEWKEYSET)) {
+        return TRUE;
+    }
+
+    MakeContext->DigestProvider = 0;
+    return FALSE;
+}
+
+/**
+ Load the digests recorded by previous executions.  The digest table must
+ have been allocated by the caller.  If digests cannot be calculated on this
+ system, the table is deallocated and rebuild decisions are made using
+ timestamps only.
+
+ @param MakeContext Pointer to the context.
+
+ @param MakeFileName Pointer to the file name of the makefile.  If this
+        contains a string, it will be used as the base name for the digest
+        database.
+ */
+VOID
+MakeLoadDigests(
+    __inout PMAKE_CONTEXT MakeContext,
+    __in PYORI_STRING MakeFileName
+    )
+{
+    YORI_STRING DigestFileName;
+    YORI_STRING LineString;
+    YORI_STRING Substring;
+    UCHAR InputDigest[MAKE_DIGEST_SIZE];
+    UCHAR OutputDigest[MAKE_DIGEST_SIZE];
+    HANDLE hDigest;
+    PVOID LineContext = NULL;
+
+    if (MakeContext->DigestTable == NULL) {
+        return;
+    }
+
+    if (!MakeAcquireDigestProvider(MakeContext)) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Content hashing not available, using timestamps\n"));
+        YoriLibFreeEmptyHashTable(MakeContext->DigestTable);
+        MakeContext->DigestTable = NULL;
+        return;
+    }
+
+    if (!MakeGetDigestFileName(MakeFileName, &DigestFileName)) {
+        return;
+    }
+
+    hDigest = CreateFile(DigestFileName.StartOfString, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    YoriLibFreeStringContents(&DigestFileName);
+    if (hDigest == INVALID_HANDLE_VALUE) {
+        return;
+    }
+
+    YoriLibInitEmptyString(&LineString);
+    YoriLibInitEmptyString(&Substring);
+
+    while (TRUE) {
+        if (!YoriLibReadLineToString(&LineString, &LineContext, hDigest)) {
+            break;
+        }
+
+        //
+        //  The format of each line is expected to be:
+        //  InputDigest:OutputDigest:TargetName
+        //
+
+        if (LineString.LengthInChars <= 4 * MAKE_DIGEST_SIZE + 2 ||
+            LineString.StartOfString[2 * MAKE_DIGEST_SIZE] != ':' ||
+            LineString.StartOfString[4 * MAKE_DIGEST_SIZE + 1] != ':') {
+
+            break;
+        }
+
+        Substring.StartOfString = LineString.StartOfString;
+        Substring.LengthInChars = 2 * MAKE_DIGEST_SIZE;
+        if (!YoriLibStringToHexBuffer(&Substring, InputDigest, MAKE_DIGEST_SIZE)) {
+            break;
+        }
+
+        Substring.StartOfString = &LineString.StartOfString[2 * MAKE_DIGEST_SIZE + 1];
+        if (!YoriLibStringToHexBuffer(&Substring, OutputDigest, MAKE_DIGEST_SIZE)) {
+            break;
+        }
+
+        Substring.StartOfString = &LineString.StartOfString[4 * MAKE_DIGEST_SIZE + 2];
+        Substring.LengthInChars = LineString.LengthInChars - 4 * MAKE_DIGEST_SIZE - 2;
+
+        if (!MakeUpdateDigestEntry(MakeContext, &Substring, InputDigest, OutputDigest)) {
+            break;
+        }
+    }
+
+    YoriLibLineReadCloseOrCache(LineContext);
+    YoriLibFreeStringContents(&LineString);
+    CloseHandle(hDigest);
+}
+
+/**
+ Deallocate all digest entries and write them to a file.
+
+ @param MakeContext Pointer to the context.
+
+ @param MakeFileName Pointer to the file name of the makefile.  If this
+        contains a string, it will be used as the base name for the digest
+        database.
+ */
+VOID
+MakeSaveAndDeleteDigests(
+    __inout PMAKE_CONTEXT MakeContext,
+    __in PYORI_STRING MakeFileName
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PMAKE_DIGEST_ENTRY Entry;
+    YORI_STRING DigestFileName;
+    YORI_STRING InputString;
+    YORI_STRING OutputString;
+    TCHAR InputBuffer[2 * MAKE_DIGEST_SIZE + 1];
+    TCHAR OutputBuffer[2 * MAKE_DIGEST_SIZE + 1];
+    HANDLE hDigest;
+
+    if (MakeContext->DigestTable == NULL) {
+        return;
+    }
+
+    YoriLibInitEmptyString(&InputString);
+    InputString.StartOfString = InputBuffer;
+    InputString.LengthAllocated = sizeof(InputBuffer)/sizeof(InputBuffer[0]);
+    InputString.LengthInChars = 2 * MAKE_DIGEST_SIZE;
+    InputBuffer[2 * MAKE_DIGEST_SIZE] = '\0';
+
+    YoriLibInitEmptyString(&OutputString);
+    OutputString.StartOfString = OutputBuffer;
+    OutputString.LengthAllocated = sizeof(OutputBuffer)/sizeof(OutputBuffer[0]);
+    OutputString.LengthInChars = 2 * MAKE_DIGEST_SIZE;
+    OutputBuffer[2 * MAKE_DIGEST_SIZE] = '\0';
+
+    hDigest = NULL;
+    if (MakeGetDigestFileName(MakeFileName, &DigestFileName)) {
+        hDigest = CreateFile(DigestFileName.StartOfString, GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (hDigest == INVALID_HANDLE_VALUE) {
+            hDigest = NULL;
+        }
+        YoriLibFreeStringContents(&DigestFileName);
+    }
+
+    ListEntry = YoriLibGetNextListEntry(&MakeContext->DigestList, NULL);
+    while (ListEntry != NULL) {
+        Entry = CONTAINING_RECORD(ListEntry, MAKE_DIGEST_ENTRY, ListEntry);
+
+        if (hDigest != NULL) {
+            YoriLibHexBufferToString(Entry->InputDigest, MAKE_DIGEST_SIZE, &InputString);
+            YoriLibHexBufferToString(Entry->OutputDigest, MAKE_DIGEST_SIZE, &OutputString);
+            YoriLibOutputToDevice(hDigest, 0, _T("%y:%y:%y\n"), &InputString, &OutputString, &Entry->HashEntry.Key);
+        }
+        YoriLibRemoveListItem(&Entry->ListEntry);
+        YoriLibHashRemoveByEntry(&Entry->HashEntry);
+        YoriLibFree(Entry);
+        ListEntry = YoriLibGetNextListEntry(&MakeContext->DigestList, NULL);
+    }
+    YoriLibFreeEmptyHashTable(MakeContext->DigestTable);
+    MakeContext->DigestTable = NULL;
+
+    if (hDigest != NULL) {
+        CloseHandle(hDigest);
+    }
+
+    if (MakeContext->DigestProvider != 0) {
+        DllAdvApi32.pCryptReleaseContext(MakeContext->DigestProvider, 0);
+        MakeContext->DigestProvider = 0;
+    }
+}
+
+/**
+ Return the digest of the contents of a target's file, calculating it if it
+ has not been calculated since the file last changed.  A directory has a
+ digest of no data, since its timestamp is not considered when evaluating
+ dependencies either.
+
+ @param MakeContext Pointer to the context.
+
+ @param Target Pointer to the target.  On successful completion,
+        Target->ContentDigest contains the digest of the file.
+
+ @return TRUE to indicate a digest was calculated, FALSE if the file does not
+         exist or could not be read.
+ */
+BOOLEAN
+MakeGetTargetContentDigest(
+    __in PMAKE_CONTEXT MakeContext,
+    __in PMAKE_TARGET Target
+    )
+{
+    HANDLE FileHandle;
+    BY_HANDLE_FILE_INFORMATION FileInfo;
+    DWORD_PTR hHash;
+    PUCHAR ReadBuffer;
+    DWORD BytesRead;
+    DWORD HashLength;
+    BOOLEAN Result;
+
+    if (Target->ContentDigestValid) {
+        return TRUE;
+    }
+
+    ASSERT(YoriLibIsStringNullTerminated(&Target->HashEntry.Key));
+    FileHandle = CreateFile(Target->HashEntry.Key.StartOfString,
+                            FILE_READ_ATTRIBUTES | FILE_READ_DATA,
+                            FILE_SHARE_READ | FILE_SHARE_DELETE,
+                            NULL,
+                            OPEN_EXISTING,
+                            FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_SEQUENTIAL_SCAN,
+                            NULL);
+    if (FileHandle == INVALID_HANDLE_VALUE) {
+        return FALSE;
+    }
+
+    if (!GetFileInformationByHandle(FileHandle, &FileInfo)) {
+        CloseHandle(FileHandle);
+        return FALSE;
+    }
+
+    ReadBuffer = YoriLibMalloc(MAKE_DIGEST_READ_BUFFER_SIZE);
+    if (ReadBuffer == NULL) {
+        CloseHandle(FileHandle);
+        return FALSE;
+    }
+
+    if (!DllAdvApi32.pCryptCreateHash(MakeContext->DigestProvider, CALG_MD5, 0, 0, &hHash)) {
+        YoriLibFree(ReadBuffer);
+        CloseHandle(FileHandle);
+        return FALSE;
+    }
+
+    Result = TRUE;
+    if ((FileInfo.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == 0) {
+        while (TRUE) {
+            if (!ReadFile(FileHandle, ReadBuffer, MAKE_DIGEST_READ_BUFFER_SIZE, &BytesRead, NULL)) {
+                Result = FALSE;
+                break;
+            }
+
+            if (BytesRead == 0) {
+                break;
+            }
+
+            if (!DllAdvApi32.pCryptHashData(hHash, ReadBuffer, BytesRead, 0)) {
+                Result = FALSE;
+                break;
+            }
+        }
+    }
+
+    if (Result) {
+        HashLength = MAKE_DIGEST_SIZE;
+        if (DllAdvApi32.pCryptGetHashParam(hHash, HP_HASHVAL, Target->ContentDigest, &HashLength, 0)) {
+            Target->ContentDigestValid = TRUE;
+        } else {
+            Result = FALSE;
+        }
+    }
+
+    DllAdvApi32.pCryptDestroyHash(hHash);
+    YoriLibFree(ReadBuffer);
+    CloseHandle(FileHandle);
+
+    return Result;
+}
+
+/**
+ Calculate the digest of everything used to build a target.  This consists
+ of the expanded commands to execute and the name and contents of every
+ target it depends upon.
+
+ @param MakeContext Pointer to the context.
+
+ @param Target Pointer to the target.  The commands to execute for the
+        target must have been generated.
+
+ @param InputDigest On successful completion, populated with the digest.
+
+ @return TRUE to indicate a digest was calculated, FALSE if any input could
+         not be read.
+ */
+BOOLEAN
+MakeCalculateInputDigest(
+    __in PMAKE_CONTEXT MakeContext,
+    __in PMAKE_TARGET Target,
+    __out_ecount(MAKE_DIGEST_SIZE) PUCHAR InputDigest
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PMAKE_CMD_TO_EXEC CmdToExec;
+    PMAKE_TARGET_DEPENDENCY Dependency;
+    PMAKE_TARGET Parent;
+    DWORD_PTR hHash;
+    DWORD HashLength;
+    UCHAR Flags[2];
+    BOOLEAN Result;
+
+    if (!DllAdvApi32.pCryptCreateHash(MakeContext->DigestProvider, CALG_MD5, 0, 0, &hHash)) {
+        return FALSE;
+    }
+
+    Result = TRUE;
+
+    //
+    //  Each command is terminated with a newline, which cannot occur within
+    //  a command.  Each dependency is terminated with a NULL, which cannot
+    //  occur within a file name, followed by a fixed size digest.
+    //
+
+    ListEntry = YoriLibGetNextListEntry(&Target->ExecCmds, NULL);
+    while (ListEntry != NULL) {
+        CmdToExec = CONTAINING_RECORD(ListEntry, MAKE_CMD_TO_EXEC, ListEntry);
+        Flags[0] = CmdToExec->DisplayCmd;
+        Flags[1] = CmdToExec->IgnoreErrors;
+        if (!DllAdvApi32.pCryptHashData(hHash, Flags, sizeof(Flags), 0) ||
+            !DllAdvApi32.pCryptHashData(hHash, (PUCHAR)CmdToExec->Cmd.StartOfString, (DWORD)(CmdToExec->Cmd.LengthInChars * sizeof(TCHAR)), 0) ||
+            !DllAdvApi32.pCryptHashData(hHash, (PUCHAR)_T("\n"), sizeof(TCHAR), 0)) {
+
+            Result = FALSE;
+            break;
+        }
+        ListEntry = YoriLibGetNextListEntry(&Target->ExecCmds, ListEntry);
+    }
+
+    if (Result) {
+        ListEntry = YoriLibGetNextListEntry(&Target->ParentDependents, NULL);
+        while (ListEntry != NULL) {
+            Dependency = CONTAINING_RECORD(ListEntry, MAKE_TARGET_DEPENDENCY, ChildDependents);
+            Parent = Dependency->Parent;
+            if (!MakeGetTargetContentDigest(MakeContext, Parent) ||
+                !DllAdvApi32.pCryptHashData(hHash, (PUCHAR)Parent->HashEntry.Key.StartOfString, (DWORD)((Parent->HashEntry.Key.LengthInChars + 1) * sizeof(TCHAR)), 0) ||
+                !DllAdvApi32.pCryptHashData(hHash, Parent->ContentDigest, MAKE_DIGEST_SIZE, 0)) {
+
+                Result = FALSE;
+                break;
+            }
+            ListEntry = YoriLibGetNextListEntry(&Target->ParentDependents, ListEntry);
+        }
+    }
+
+    if (Result) {
+        HashLength = MAKE_DIGEST_SIZE;
+        if (!DllAdvApi32.pCryptGetHashParam(hHash, HP_HASHVAL, InputDigest, &HashLength, 0)) {
+            Result = FALSE;
+        }
+    }
+
+    DllAdvApi32.pCryptDestroyHash(hHash);
+    return Result;
+}
+
+/**
+ Check whether a target which appears out of date based on timestamps was
+ previously built from identical commands and inputs, and still contains the
+ result of that build.  If so, there is no need to rebuild it.
+
+ @param MakeContext Pointer to the context.
+
+ @param Target Pointer to the target.  The commands to execute for the
+        target must have been generated.
+
+ @return TRUE to indicate the target is current and does not need to be
+         rebuilt, FALSE if it should be rebuilt.
+ */
+BOOLEAN
+MakeIsTargetCurrentByDigest(
+    __in PMAKE_CONTEXT MakeContext,
+    __in PMAKE_TARGET Target
+    )
+{
+    PYORI_HASH_ENTRY HashEntry;
+    PMAKE_DIGEST_ENTRY Entry;
+    UCHAR InputDigest[MAKE_DIGEST_SIZE];
+
+    if (MakeContext->DigestTable == NULL) {
+        return FALSE;
+    }
+
+    HashEntry = YoriLibHashLookupByKey(MakeContext->DigestTable, &Target->HashEntry.Key);
+    if (HashEntry == NULL) {
+        return FALSE;
+    }
+    Entry = HashEntry->Context;
+
+    //
+    //  Check the output first since it's normally smaller than the inputs.
+    //  If the output doesn't match, it was modified by something else or
+    //  a later build failed partway through.
+    //
+
+    if (!MakeGetTargetContentDigest(MakeContext, Target) ||
+        memcmp(Target->ContentDigest, Entry->OutputDigest, MAKE_DIGEST_SIZE) != 0) {
+
+        return FALSE;
+    }
+
+    if (!MakeCalculateInputDigest(MakeContext, Target, InputDigest) ||
+        memcmp(InputDigest, Entry->InputDigest, MAKE_DIGEST_SIZE) != 0) {
+
+        return FALSE;
+    }
+
+    MakeContext->TargetsSkippedByDigest++;
+    return TRUE;
+}
+
+/**
+ Record the digests of a target whose recipe has completed successfully, so
+ a later execution can determine whether it needs to be rebuilt.
+
+ @param MakeContext Pointer to the context.
+
+ @param Target Pointer to the target that has completed.
+ */
+VOID
+MakeRecordTargetDigest(
+    __in PMAKE_CONTEXT MakeContext,
+    __in PMAKE_TARGET Target
+    )
+{
+    UCHAR InputDigest[MAKE_DIGEST_SIZE];
+
+    if (MakeContext->DigestTable == NULL) {
+        return;
+    }
+
+    //
+    //  The recipe may have rewritten the file, so any digest calculated
+    //  while evaluating dependencies is stale.
+    //
+
+    Target->ContentDigestValid = FALSE;
+
+    if (!MakeCalculateInputDigest(MakeContext, Target, InputDigest) ||
+        !MakeGetTargetContentDigest(MakeContext, Target)) {
+
+        return;
+    }
+
+    MakeUpdateDigestEntry(MakeContext, &Target->HashEntry.Key, InputDigest, Target->ContentDigest);
+}
+
+// vim:sw=4:ts=4:et:
@@ -42,6 +42,12 @@ typedef struct _MAKE_CHILD_RECIPE {
      */
     BOOLEAN CmdContextPresent;
 
+    /**
+     Set to TRUE to indicate that the commands for this target are being
+     executed via the remote launcher.
+     */
+    BOOLEAN Remote;
+
     /**
      Indicates the job identifier.
      */
@@ -78,6 +84,16 @@ typedef struct _MAKE_CHILD_RECIPE {
      An execution plan.  Should be deallocated if CmdContextPresent is TRUE.
      */
     YORI_LIBSH_EXEC_PLAN ExecPlan;
+
+    /**
+     The time that the recipe for the target was launched.
+     */
+    LARGE_INTEGER StartTime;
+
+    /**
+     The time that the current command was launched.
+     */
+    LARGE_INTEGER CmdStartTime;
 } MAKE_CHILD_RECIPE, *PMAKE_CHILD_RECIPE;
 
 /**
@@ -102,7 +118,7 @@ MakeSetTemporaryDirectory(
     DWORDLONG TestMask;
     YORI_STRING JobTempPath;
 
-    ASSERT(JobId < MakeContext->NumberProcesses);
+    ASSERT(JobId < MakeContext->NumberProcesses + MakeContext->NumberRemoteProcesses);
     TestMask = 1;
     TestMask = TestMask << JobId;
 
@@ -155,7 +171,7 @@ MakeCleanupTemporaryDirectories(
         return;
     }
 
-    for (Probe = 0; Probe < MakeContext->NumberProcesses; Probe++) {
+    for (Probe = 0; Probe < MakeContext->NumberProcesses + MakeContext->NumberRemoteProcesses; Probe++) {
         TestMask = 1;
         TestMask = TestMask << Probe;
         if ((MakeContext->TempDirectoriesCreated & TestMask) != 0) {
@@ -185,7 +201,7 @@ MakeAllocateJobId(
     DWORD Probe;
     DWORDLONG TestMask;
 
-    for (Probe = 0; Probe < MakeContext->NumberProcesses; Probe++) {
+    for (Probe = 0; Probe < MakeContext->NumberProcesses + MakeContext->NumberRemoteProcesses; Probe++) {
         TestMask = 1;
         TestMask = TestMask << Probe;
         if ((MakeContext->JobIdsAllocated & TestMask) == 0) {
@@ -195,7 +211,7 @@ MakeAllocateJobId(
         }
     }
 
-    ASSERT(Probe < MakeContext->NumberProcesses);
+    ASSERT(Probe < MakeContext->NumberProcesses + MakeContext->NumberRemoteProcesses);
     return Probe;
 }
 
@@ -214,7 +230,7 @@ MakeFreeJobId(
 {
     DWORDLONG TestMask;
 
-    ASSERT(JobId < MakeContext->NumberProcesses);
+    ASSERT(JobId < MakeContext->NumberProcesses + MakeContext->NumberRemoteProcesses);
 
     TestMask = 1;
     TestMask = TestMask << JobId;
@@ -500,9 +516,12 @@ MakeLaunchNextCmd(
     BOOLEAN ExecutedBuiltin;
     BOOLEAN PuntToCmd;
     BOOLEAN Reparse;
+    LARGE_INTEGER LaunchStartTime;
+    LARGE_INTEGER LaunchEndTime;
 
     ASSERT(!ChildRecipe->CmdContextPresent);
 
+    QueryPerformanceCounter(&LaunchStartTime);
     Target = ChildRecipe->Target;
 
     //
@@ -635,7 +654,7 @@ MakeLaunchNextCmd(
     //  or otherwise execute multi-command plans (|, ||, &&, &.)
     //
 
-    if (!PuntToCmd) {
+    if (!PuntToCmd && !ChildRecipe->Remote) {
         ASSERT(ChildRecipe->CmdContextPresent);
         if (ChildRecipe->ExecPlan.NumberCommands > 1) {
             PuntToCmd = TRUE;
@@ -643,12 +662,31 @@ MakeLaunchNextCmd(
     }
 
     //
-    //  If it's not a known builtin, execute the command.  When punting to cmd
+    //  If it's not a known builtin, execute the command.  When executing
+    //  remotely, the entire command is handed to the remote launcher, which
+    //  is responsible for interpreting any operators.  When punting to cmd
     //  this involves creating a string for it (which performs path lookup
     //  internally), but for anything else we perform path lookup below.
     //
 
-    if (PuntToCmd) {
+    if (ChildRecipe->Remote) {
+
+        MakeFreeCmdContextIfNecessary(ChildRecipe);
+
+        if (!MakeBuildCmdContextForRemoteLaunch(MakeContext, &ChildRecipe->CmdContext, &ChildRecipe->CurrentDirectory, &CmdToParse)) {
+            YoriLibFreeStringContents(&CmdToParse);
+            return FALSE;
+        }
+
+        if (!YoriLibShParseCmdContextToExecPlan(&ChildRecipe->CmdContext, &ChildRecipe->ExecPlan, NULL, NULL, NULL, NULL)) {
+            YoriLibShFreeCmdContext(&ChildRecipe->CmdContext);
+            YoriLibFreeStringContents(&CmdToParse);
+            return FALSE;
+        }
+
+        ChildRecipe->CmdContextPresent = TRUE;
+
+    } else if (PuntToCmd) {
 
         MakeFreeCmdContextIfNecessary(ChildRecipe);
 
@@ -690,11 +728,17 @@ MakeLaunchNextCmd(
     }
 
     ChildRecipe->JobId = MakeAllocateJobId(MakeContext);
+    QueryPerformanceCounter(&ChildRecipe->CmdStartTime);
 
+    ExecContext->ProcessorPlacement = &MakeContext->ProcessorPlacement;
     Error = YoriLibShCreateProcess(ExecContext,
                                    ChildRecipe->CurrentDirectory.StartOfString,
                                    &FailedInRedirection);
 
+    QueryPerformanceCounter(&LaunchEndTime);
+    MakeContext->TimeLaunchingProcesses = MakeContext->TimeLaunchingProcesses + LaunchEndTime.QuadPart - LaunchStartTime.QuadPart;
+    MakeContext->ProcessesLaunched++;
+
     if (Error != ERROR_SUCCESS) {
         MakeFreeJobId(MakeContext, ChildRecipe->JobId);
         ChildRecipe->ProcessHandle = NULL;
@@ -740,46 +784,553 @@ MakeRecipeCompletion(
 }
 
 /**
- Launch the recipe for the next ready target.
+ Generate the name of the recipe history file from the specified make file
+ name.
 
- @param MakeContext Pointer to the context.
+ @param MakeFileName Pointer to the make file name.
 
- @param ChildRecipe Pointer to the child process structure to populate with
-        information about the child process that has been initiated.
+ @param HistoryFileName On successful completion, updated to contain a newly
+        allocated string referring to the file name of the history file.
 
  @return TRUE to indicate success, FALSE to indicate failure.
  */
 __success(return)
 BOOLEAN
-MakeLaunchNextTarget(
+MakeGetRecipeHistoryFileName(
+    __in PYORI_STRING MakeFileName,
+    __out PYORI_STRING HistoryFileName
+    )
+{
+    YoriLibInitEmptyString(HistoryFileName);
+    if (MakeFileName->LengthInChars > 0) {
+        if (YoriLibAllocateString(HistoryFileName, MakeFileName->LengthInChars + sizeof(".hist"))) {
+            HistoryFileName->LengthInChars = YoriLibSPrintf(HistoryFileName->StartOfString, _T("%y.hist"), MakeFileName);
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+/**
+ Add or update the recorded duration of the recipe for a target.
+
+ @param MakeContext Pointer to the context.
+
+ @param TargetName Pointer to the fully qualified name of the target.
+
+ @param DurationInMs The time taken to execute the recipe, in milliseconds.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOLEAN
+MakeUpdateRecipeHistory(
     __in PMAKE_CONTEXT MakeContext,
-    __inout PMAKE_CHILD_RECIPE ChildRecipe
+    __in PYORI_STRING TargetName,
+    __in DWORD DurationInMs
+    )
+{
+    PYORI_HASH_ENTRY HashEntry;
+    PMAKE_RECIPE_HISTORY_ENTRY Entry;
+    YORI_STRING Key;
+
+    HashEntry = YoriLibHashLookupByKey(MakeContext->RecipeHistory, TargetName);
+    if (HashEntry != NULL) {
+        Entry = HashEntry->Context;
+        Entry->DurationInMs = DurationInMs;
+        return TRUE;
+    }
+
+    Entry = YoriLibMalloc(sizeof(MAKE_RECIPE_HISTORY_ENTRY));
+    if (Entry == NULL) {
+        return FALSE;
+    }
+
+    if (!YoriLibCopyString(&Key, TargetName)) {
+        YoriLibFree(Entry);
+        return FALSE;
+    }
+
+    Entry->DurationInMs = DurationInMs;
+    YoriLibHashInsertByKey(MakeContext->RecipeHistory, &Key, Entry, &Entry->HashEntry);
+    YoriLibAppendList(&MakeContext->RecipeHistoryList, &Entry->ListEntry);
+    YoriLibFreeStringContents(&Key);
+    return TRUE;
+}
+
+/**
+ Load the durations of recipes from previous executions.  These are used
+ to estimate which targets are on the longest path so they can be started
+ as early as possible.  The history table must have been allocated by the
+ caller.
+
+ @param MakeContext Pointer to the context.
+
+ @param MakeFileName Pointer to the file name of the makefile.  If this
+        contains a string, it will be used as the base name for the history.
+ */
+VOID
+MakeLoadRecipeHistory(
+    __inout PMAKE_CONTEXT MakeContext,
+    __in PYORI_STRING MakeFileName
+    )
+{
+    YORI_STRING HistoryFileName;
+    YORI_STRING LineString;
+    YORI_STRING TargetName;
+    YORI_ALLOC_SIZE_T CharsConsumed;
+    YORI_MAX_SIGNED_T llTemp;
+    DWORDLONG TotalDuration;
+    DWORD EntryCount;
+    HANDLE hHistory;
+    PVOID LineContext = NULL;
+
+    if (!MakeGetRecipeHistoryFileName(MakeFileName, &HistoryFileName)) {
+        return;
+    }
+
+    hHistory = CreateFile(HistoryFileName.StartOfString, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    YoriLibFreeStringContents(&HistoryFileName);
+    if (hHistory == INVALID_HANDLE_VALUE) {
+        return;
+    }
+
+    YoriLibInitEmptyString(&LineString);
+    YoriLibInitEmptyString(&TargetName);
+    TotalDuration = 0;
+    EntryCount = 0;
+
+    while (TRUE) {
+        if (!YoriLibReadLineToString(&LineString, &LineContext, hHistory)) {
+            break;
+        }
+
+        //
+        //  The format of each line is expected to be:
+        //  DurationInMs:TargetName
+        //
+
+        if (!YoriLibStringToNumber(&LineString, FALSE, &llTemp, &CharsConsumed) ||
+            CharsConsumed == 0 ||
+            llTemp < 0 ||
+            CharsConsumed + 1 >= LineString.LengthInChars ||
+            LineString.StartOfString[CharsConsumed] != ':') {
+
+            break;
+        }
+
+        TargetName.StartOfString = &LineString.StartOfString[CharsConsumed + 1];
+        TargetName.LengthInChars = LineString.LengthInChars - CharsConsumed - 1;
+
+        if (!MakeUpdateRecipeHistory(MakeContext, &TargetName, (DWORD)llTemp)) {
+            break;
+        }
+
+        TotalDuration = TotalDuration + (DWORD)llTemp;
+        EntryCount++;
+    }
+
+    if (EntryCount > 0) {
+        MakeContext->DefaultRecipeDuration = (DWORD)(TotalDuration / EntryCount);
+    }
+
+    YoriLibLineReadCloseOrCache(LineContext);
+    YoriLibFreeStringContents(&LineString);
+    CloseHandle(hHistory);
+}
+
+/**
+ Deallocate all recipe history entries and write them to a file.
+
+ @param MakeContext Pointer to the context.
+
+ @param MakeFileName Pointer to the file name of the makefile.  If this
+        contains a string, it will be used as the base name for the history.
+ */
+VOID
+MakeSaveAndDeleteRecipeHistory(
+    __inout PMAKE_CONTEXT MakeContext,
+    __in PYORI_STRING MakeFileName
     )
 {
-    PMAKE_TARGET Target;
     PYORI_LIST_ENTRY ListEntry;
-    BOOLEAN Result;
+    PMAKE_RECIPE_HISTORY_ENTRY Entry;
+    YORI_STRING HistoryFileName;
+    HANDLE hHistory;
+
+    if (MakeContext->RecipeHistory == NULL) {
+        return;
+    }
+
+    hHistory = NULL;
+    if (MakeGetRecipeHistoryFileName(MakeFileName, &HistoryFileName)) {
+        hHistory = CreateFile(HistoryFileName.StartOfString, GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (hHistory == INVALID_HANDLE_VALUE) {
+            hHistory = NULL;
+        }
+        YoriLibFreeStringContents(&HistoryFileName);
+    }
+
+    ListEntry = YoriLibGetNextListEntry(&MakeContext->RecipeHistoryList, NULL);
+    while (ListEntry != NULL) {
+        Entry = CONTAINING_RECORD(ListEntry, MAKE_RECIPE_HISTORY_ENTRY, ListEntry);
+
+        if (hHistory != NULL) {
+            YoriLibOutputToDevice(hHistory, 0, _T("%i:%y\n"), Entry->DurationInMs, &Entry->HashEntry.Key);
+        }
+        YoriLibRemoveListItem(&Entry->ListEntry);
+        YoriLibHashRemoveByEntry(&Entry->HashEntry);
+        YoriLibFree(Entry);
+        ListEntry = YoriLibGetNextListEntry(&MakeContext->RecipeHistoryList, NULL);
+    }
+    YoriLibFreeEmptyHashTable(MakeContext->RecipeHistory);
+    MakeContext->RecipeHistory = NULL;
+
+    if (hHistory != NULL) {
+        CloseHandle(hHistory);
+    }
+}
+
+/**
+ Record the time taken to execute the recipe for a target that has
+ completed successfully.
+
+ @param MakeContext Pointer to the context.
+
+ @param ChildRecipe Pointer to the recipe that has completed.
+ */
+VOID
+MakeRecordRecipeDuration(
+    __in PMAKE_CONTEXT MakeContext,
+    __in PMAKE_CHILD_RECIPE ChildRecipe
+    )
+{
+    LARGE_INTEGER EndTime;
+    LARGE_INTEGER Frequency;
+    DWORDLONG DurationInMs;
+
+    if (MakeContext->RecipeHistory == NULL) {
+        return;
+    }
+
+    QueryPerformanceCounter(&EndTime);
+    QueryPerformanceFrequency(&Frequency);
+
+    DurationInMs = (DWORDLONG)(EndTime.QuadPart - ChildRecipe->StartTime.QuadPart) * 1000 / Frequency.QuadPart;
+    if (DurationInMs > (DWORD)-1) {
+        DurationInMs = (DWORD)-1;
+    }
+
+    MakeUpdateRecipeHistory(MakeContext, &ChildRecipe->Target->HashEntry.Key, (DWORD)DurationInMs);
+}
+
+/**
+ Calculate the estimated cost of building a target and every target along
+ the longest chain of targets that depend on it.  Targets that are not
+ being rebuilt do not contribute.
+
+ @param MakeContext Pointer to the context.
+
+ @param Target Pointer to the target.
+
+ @return The critical path cost of the target.
+ */
+DWORDLONG
+MakeCalculateCriticalPathCost(
+    __in PMAKE_CONTEXT MakeContext,
+    __in PMAKE_TARGET Target
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PMAKE_TARGET_DEPENDENCY Dependency;
+    PYORI_HASH_ENTRY HashEntry;
+    PMAKE_RECIPE_HISTORY_ENTRY HistoryEntry;
+    DWORDLONG ChildCost;
+    DWORDLONG MaxChildCost;
+    DWORDLONG OwnCost;
+
+    if (Target->CriticalPathCostCalculated) {
+        return Target->CriticalPathCost;
+    }
 
     //
-    //  This recipe structure should be available for use.
+    //  Without history, assume every recipe takes the same time, so the
+    //  cost is the number of recipes on the longest chain.
     //
 
-    ASSERT(!ChildRecipe->CmdContextPresent);
+    OwnCost = 0;
+    if (!YoriLibIsListEmpty(&Target->ExecCmds)) {
+        OwnCost = 1;
+        if (MakeContext->RecipeHistory != NULL) {
+            if (MakeContext->DefaultRecipeDuration > 0) {
+                OwnCost = MakeContext->DefaultRecipeDuration;
+            }
+            HashEntry = YoriLibHashLookupByKey(MakeContext->RecipeHistory, &Target->HashEntry.Key);
+            if (HashEntry != NULL) {
+                HistoryEntry = HashEntry->Context;
+                OwnCost = HistoryEntry->DurationInMs;
+            }
+        }
+    }
+
+    MaxChildCost = 0;
+    ListEntry = YoriLibGetNextListEntry(&Target->ChildDependents, NULL);
+    while (ListEntry != NULL) {
+        Dependency = CONTAINING_RECORD(ListEntry, MAKE_TARGET_DEPENDENCY, ParentDependents);
+        if (Dependency->Child->RebuildRequired) {
+            ChildCost = MakeCalculateCriticalPathCost(MakeContext, Dependency->Child);
+            if (ChildCost > MaxChildCost) {
+                MaxChildCost = ChildCost;
+            }
+        }
+        ListEntry = YoriLibGetNextListEntry(&Target->ChildDependents, ListEntry);
+    }
+
+    Target->CriticalPathCost = OwnCost + MaxChildCost;
+    Target->CriticalPathCostCalculated = TRUE;
+    return Target->CriticalPathCost;
+}
+
+/**
+ Insert a target into the list of ready targets.  If targets are being
+ prioritized, the list is kept sorted so targets with the highest critical
+ path cost are launched first, and targets with equal cost are launched in
+ the order they became ready.
+
+ @param MakeContext Pointer to the context.
+
+ @param Target Pointer to the target which is ready to execute.
+ */
+VOID
+MakeInsertReadyTarget(
+    __in PMAKE_CONTEXT MakeContext,
+    __in PMAKE_TARGET Target
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PMAKE_TARGET ExistingTarget;
+
+    if (!MakeContext->PrioritizeTargets) {
+        YoriLibAppendList(&MakeContext->TargetsReady, &Target->RebuildList);
+        return;
+    }
+
+    ListEntry = YoriLibGetNextListEntry(&MakeContext->TargetsReady, NULL);
+    while (ListEntry != NULL) {
+        ExistingTarget = CONTAINING_RECORD(ListEntry, MAKE_TARGET, RebuildList);
+        if (ExistingTarget->CriticalPathCost < Target->CriticalPathCost) {
+
+            //
+            //  Appending to an entry inserts before it.
+            //
+
+            YoriLibAppendList(ListEntry, &Target->RebuildList);
+            return;
+        }
+        ListEntry = YoriLibGetNextListEntry(&MakeContext->TargetsReady, ListEntry);
+    }
+
+    YoriLibAppendList(&MakeContext->TargetsReady, &Target->RebuildList);
+}
+
+/**
+ Calculate the critical path cost of every target that needs to be rebuilt
+ and order the ready targets so that those on the longest path are launched
+ first.  This only occurs when more than one child process can execute,
+ since with a single process the order doesn't change the total time and
+ the original order is more predictable.
+
+ @param MakeContext Pointer to the context.
+ */
+VOID
+MakePrioritizeTargets(
+    __in PMAKE_CONTEXT MakeContext
+    )
+{
+    YORI_LIST_ENTRY ReadyList;
+    PYORI_LIST_ENTRY ListEntry;
+    PMAKE_TARGET Target;
+
+    if (MakeContext->NumberProcesses + MakeContext->NumberRemoteProcesses <= 1) {
+        return;
+    }
+
+    ListEntry = YoriLibGetNextListEntry(&MakeContext->TargetsWaiting, NULL);
+    while (ListEntry != NULL) {
+        Target = CONTAINING_RECORD(ListEntry, MAKE_TARGET, RebuildList);
+        MakeCalculateCriticalPathCost(MakeContext, Target);
+        ListEntry = YoriLibGetNextListEntry(&MakeContext->TargetsWaiting, ListEntry);
+    }
 
     //
-    //  Get the next target.
+    //  Move the ready targets to a temporary list, then reinsert them in
+    //  priority order.
     //
 
+    YoriLibInitializeListHead(&ReadyList);
     ListEntry = YoriLibGetNextListEntry(&MakeContext->TargetsReady, NULL);
+    while (ListEntry != NULL) {
+        Target = CONTAINING_RECORD(ListEntry, MAKE_TARGET, RebuildList);
+        MakeCalculateCriticalPathCost(MakeContext, Target);
+        YoriLibRemoveListItem(ListEntry);
+        YoriLibAppendList(&ReadyList, ListEntry);
+        ListEntry = YoriLibGetNextListEntry(&MakeContext->TargetsReady, NULL);
+    }
+
+    MakeContext->PrioritizeTargets = TRUE;
+
+    ListEntry = YoriLibGetNextListEntry(&ReadyList, NULL);
+    while (ListEntry != NULL) {
+        Target = CONTAINING_RECORD(ListEntry, MAKE_TARGET, RebuildList);
+        YoriLibRemoveListItem(ListEntry);
+        MakeInsertReadyTarget(MakeContext, Target);
+        ListEntry = YoriLibGetNextListEntry(&ReadyList, NULL);
+    }
+}
+
+/**
+ Ensure a job server token is held for a new local process.  The first
+ local process uses the token implicitly granted to this process, and each
+ additional local process requires a token from the job server.
+
+ @param MakeContext Pointer to the context.
+
+ @param NumberActiveLocal The number of local processes currently executing,
+        not including the one about to be launched.
+
+ @return TRUE if the process can be launched, FALSE if a token is needed
+         and none is currently available.
+ */
+BOOLEAN
+MakeAcquireJobServerToken(
+    __in PMAKE_CONTEXT MakeContext,
+    __in DWORD NumberActiveLocal
+    )
+{
+    if (MakeContext->JobServer == NULL ||
+        MakeContext->JobServerTokensHeld >= NumberActiveLocal) {
+
+        return TRUE;
+    }
+
+    if (YoriLibTryAcquireJobServerToken(MakeContext->JobServer)) {
+        MakeContext->JobServerTokensHeld++;
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+/**
+ Return any job server tokens that are no longer needed for the number of
+ local processes that are executing, so other processes sharing the job
+ server can use them.
+
+ @param MakeContext Pointer to the context.
+
+ @param NumberActiveLocal The number of local processes currently executing.
+ */
+VOID
+MakeReleaseJobServerTokens(
+    __in PMAKE_CONTEXT MakeContext,
+    __in DWORD NumberActiveLocal
+    )
+{
+    DWORD TokensNeeded;
+
+    TokensNeeded = 0;
+    if (NumberActiveLocal > 0) {
+        TokensNeeded = NumberActiveLocal - 1;
+    }
+
+    while (MakeContext->JobServerTokensHeld > TokensNeeded) {
+        YoriLibReleaseJobServerToken(MakeContext->JobServer);
+        MakeContext->JobServerTokensHeld--;
+    }
+}
+
+/**
+ Find the next ready target that can be launched given the available local
+ and remote capacity.  When a local process can be launched, this is the
+ first ready target.  Targets that are eligible for remote execution are
+ preferentially launched remotely so that local processes remain available
+ for targets that must execute locally.
+
+ @param MakeContext Pointer to the context.
+
+ @param LocalAvailable TRUE if another local process can be launched.
+
+ @param RemoteAvailable TRUE if another remote launcher can be launched.
+
+ @param Remote On successful completion, set to TRUE to indicate the target
+        should be launched remotely, or FALSE to launch it locally.
+
+ @return Pointer to the list entry of the target to launch, or NULL if no
+         ready target can be launched with the available capacity.
+ */
+PYORI_LIST_ENTRY
+MakeFindLaunchableTarget(
+    __in PMAKE_CONTEXT MakeContext,
+    __in BOOLEAN LocalAvailable,
+    __in BOOLEAN RemoteAvailable,
+    __out PBOOLEAN Remote
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PMAKE_TARGET Target;
+
+    *Remote = FALSE;
+    ListEntry = YoriLibGetNextListEntry(&MakeContext->TargetsReady, NULL);
+    while (ListEntry != NULL) {
+        Target = CONTAINING_RECORD(ListEntry, MAKE_TARGET, RebuildList);
+        if (RemoteAvailable && Target->RemoteEligible) {
+            *Remote = TRUE;
+            return ListEntry;
+        }
+        if (LocalAvailable) {
+            return ListEntry;
+        }
+        if (!RemoteAvailable) {
+            break;
+        }
+        ListEntry = YoriLibGetNextListEntry(&MakeContext->TargetsReady, ListEntry);
+    }
+
+    return NULL;
+}
+
+/**
+ Launch the recipe for a ready target.
+
+ @param MakeContext Pointer to the context.
+
+ @param ChildRecipe Pointer to the child process structure to populate with
+        information about the child process that has been initiated.
+
+ @param ListEntry Pointer to the list entry of the ready target to launch.
+
+ @param Remote TRUE if the commands for the target should be executed via
+        the remote launcher, FALSE if they should be executed locally.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+MakeLaunchNextTarget(
+    __in PMAKE_CONTEXT MakeContext,
+    __inout PMAKE_CHILD_RECIPE ChildRecipe,
+    __in PYORI_LIST_ENTRY ListEntry,
+    __in BOOLEAN Remote
+    )
+{
+    PMAKE_TARGET Target;
+    BOOLEAN Result;
 
     //
-    //  The caller should have checked that there is a target.
+    //  This recipe structure should be available for use.
     //
 
-    ASSERT(ListEntry != NULL);
-    if (ListEntry == NULL) {
-        return FALSE;
-    }
+    ASSERT(!ChildRecipe->CmdContextPresent);
 
     YoriLibRemoveListItem(ListEntry);
     YoriLibAppendList(&MakeContext->TargetsRunning, ListEntry);
@@ -787,6 +1338,11 @@ MakeLaunchNextTarget(
 
     ChildRecipe->Target = Target;
     ChildRecipe->Cmd = NULL;
+    ChildRecipe->Remote = Remote;
+    if (Remote) {
+        MakeContext->TargetsLaunchedRemotely++;
+    }
+    QueryPerformanceCounter(&ChildRecipe->StartTime);
 
     //
     //  The previous recipe should have been cleaned up.
@@ -844,7 +1400,8 @@ MakeUpdateDependenciesForTarget(
             Dependency->Child->NumberParentsToBuild--;
             if (Dependency->Child->NumberParentsToBuild == 0) {
                 YoriLibRemoveListItem(&Dependency->Child->RebuildList);
-                YoriLibAppendList(&MakeContext->TargetsReady, &Dependency->Child->RebuildList);
+                MakeInsertReadyTarget(MakeContext, Dependency->Child);
+                MakeTraceTargetReady(MakeContext, Dependency->Child);
             }
         }
         ListEntry = YoriLibGetNextListEntry(&Target->ChildDependents, ListEntry);
@@ -893,6 +1450,10 @@ MakeProcessCompletion(
         GetExitCodeProcess(ChildRecipe->ProcessHandle, &ExitCode);
         ASSERT(ChildRecipe->CmdContextPresent);
 
+        if (YoriLibEtwIsEnabled(YORI_LIB_ETW_KEYWORD_JOB)) {
+            YoriLibEtwWriteEvent(YORI_LIB_ETW_KEYWORD_JOB, "MakeJobComplete", "Target", &ChildRecipe->Target->HashEntry.Key, "JobId", ChildRecipe->JobId, "ExitCode", ExitCode);
+        }
+
         DefaultColor = YoriLibVtGetDefaultColor();
         RestoreColor = FALSE;
 
@@ -946,6 +1507,7 @@ MakeProcessCompletion(
 
         ASSERT(ChildRecipe->CmdContextPresent);
         ChildRecipe->ProcessHandle = NULL;
+        MakeTraceCommand(MakeContext, ChildRecipe->Target, &ChildRecipe->Cmd->Cmd, ChildRecipe->JobId, &ChildRecipe->CmdStartTime, ExitCode);
         MakeFreeJobId(MakeContext, ChildRecipe->JobId);
     }
 
@@ -985,6 +1547,7 @@ MakeCompleteReadyWithNoRecipe(
         Target = CONTAINING_RECORD(ListEntry, MAKE_TARGET, RebuildList);
         if (YoriLibIsListEmpty(&Target->ExecCmds)) {
             RemovedItem = TRUE;
+            MakeRecordTargetDigest(MakeContext, Target);
             MakeUpdateDependenciesForTarget(MakeContext, Target);
         } else {
             break;
@@ -1009,45 +1572,106 @@ MakeExecuteRequiredTargets(
 {
 
     YORI_ALLOC_SIZE_T NumberActiveProcesses;
+    YORI_ALLOC_SIZE_T NumberActiveRemote;
+    YORI_ALLOC_SIZE_T NumberSlots;
     DWORD Index;
     HANDLE *ProcessHandleArray;
     PMAKE_CHILD_RECIPE ChildRecipeArray;
+    PYORI_LIST_ENTRY ListEntry;
+    PMAKE_TARGET Target;
     BOOLEAN Result;
     BOOLEAN MoveToNextTarget;
     BOOLEAN TargetFailureObserved;
+    BOOLEAN Remote;
+    BOOLEAN WaitingForToken;
+    LARGE_INTEGER WaitStartTime;
+    LARGE_INTEGER WaitEndTime;
 
     NumberActiveProcesses = 0;
+    NumberActiveRemote = 0;
     TargetFailureObserved = FALSE;
+    WaitingForToken = FALSE;
+
+    //
+    //  Local processes and remote launchers are tracked in the same arrays,
+    //  but the number of each is limited independently.  The handle array
+    //  has an extra entry for the job server.
+    //
+
+    NumberSlots = MakeContext->NumberProcesses + MakeContext->NumberRemoteProcesses;
 
-    ProcessHandleArray = YoriLibMalloc(MakeContext->NumberProcesses * sizeof(HANDLE));
+    ProcessHandleArray = YoriLibMalloc((NumberSlots + 1) * sizeof(HANDLE));
     if (ProcessHandleArray == NULL) {
         return FALSE;
     }
 
-    ZeroMemory(ProcessHandleArray, MakeContext->NumberProcesses * sizeof(HANDLE));
+    ZeroMemory(ProcessHandleArray, (NumberSlots + 1) * sizeof(HANDLE));
 
-    ChildRecipeArray = YoriLibMalloc(MakeContext->NumberProcesses * sizeof(MAKE_CHILD_RECIPE));
+    ChildRecipeArray = YoriLibMalloc(NumberSlots * sizeof(MAKE_CHILD_RECIPE));
     if (ChildRecipeArray == NULL) {
         YoriLibFree(ProcessHandleArray);
         return FALSE;
     }
 
-    ZeroMemory(ChildRecipeArray, MakeContext->NumberProcesses * sizeof(MAKE_CHILD_RECIPE));
+    ZeroMemory(ChildRecipeArray, NumberSlots * sizeof(MAKE_CHILD_RECIPE));
     Result = TRUE;
 
+    MakePrioritizeTargets(MakeContext);
+
     while (TRUE) {
 
-        while (NumberActiveProcesses < MakeContext->NumberProcesses && !YoriLibIsListEmpty(&MakeContext->TargetsReady)) {
+        while (NumberActiveProcesses < NumberSlots && !YoriLibIsListEmpty(&MakeContext->TargetsReady)) {
             if (!MakeCompleteReadyWithNoRecipe(MakeContext)) {
-                if (!MakeLaunchNextTarget(MakeContext, &ChildRecipeArray[NumberActiveProcesses])) {
+                ListEntry = MakeFindLaunchableTarget(MakeContext,
+                                                     (BOOLEAN)(NumberActiveProcesses - NumberActiveRemote < MakeContext->NumberProcesses),
+                                                     (BOOLEAN)(NumberActiveRemote < MakeContext->NumberRemoteProcesses),
+                                                     &Remote);
+                if (ListEntry == NULL) {
+                    break;
+                }
+
+                //
+                //  A target found beyond the front of the queue may have no
+                //  recipe, and it can complete immediately.
+                //
+
+                Target = CONTAINING_RECORD(ListEntry, MAKE_TARGET, RebuildList);
+                if (YoriLibIsListEmpty(&Target->ExecCmds)) {
+                    MakeRecordTargetDigest(MakeContext, Target);
+                    MakeUpdateDependenciesForTarget(MakeContext, Target);
+                    continue;
+                }
+
+                //
+                //  If a local process needs a token from the job server and
+                //  none is available, wait for either a token or for a
+                //  process to complete.
+                //
+
+                if (!Remote &&
+                    !MakeAcquireJobServerToken(MakeContext, NumberActiveProcesses - NumberActiveRemote)) {
+
+                    WaitingForToken = TRUE;
+                    break;
+                }
+
+                if (!MakeLaunchNextTarget(MakeContext, &ChildRecipeArray[NumberActiveProcesses], ListEntry, Remote)) {
                     Result = FALSE;
                     goto Drain;
                 }
                 NumberActiveProcesses++;
+                if (Remote) {
+                    NumberActiveRemote++;
+                }
             }
         }
 
-        while (NumberActiveProcesses == MakeContext->NumberProcesses || YoriLibIsListEmpty(&MakeContext->TargetsReady)) {
+        while (NumberActiveProcesses == NumberSlots ||
+               WaitingForToken ||
+               MakeFindLaunchableTarget(MakeContext,
+                                        (BOOLEAN)(NumberActiveProcesses - NumberActiveRemote < MakeContext->NumberProcesses),
+                                        (BOOLEAN)(NumberActiveRemote < MakeContext->NumberRemoteProcesses),
+                                        &Remote) == NULL) {
 
             if (NumberActiveProcesses == 0) {
                 break;
@@ -1070,8 +1694,41 @@ MakeExecuteRequiredTargets(
             }
 
             if (Index == NumberActiveProcesses) {
-                Index = WaitForMultipleObjectsEx(NumberActiveProcesses, ProcessHandleArray, FALSE, INFINITE, FALSE);
+                DWORD HandleCount;
+
+                HandleCount = NumberActiveProcesses;
+                if (WaitingForToken && HandleCount < MAXIMUM_WAIT_OBJECTS) {
+                    ProcessHandleArray[HandleCount] = MakeContext->JobServer;
+                    HandleCount++;
+                }
+
+                QueryPerformanceCounter(&WaitStartTime);
+                Index = WaitForMultipleObjectsEx(HandleCount, ProcessHandleArray, FALSE, INFINITE, FALSE);
                 Index = Index - WAIT_OBJECT_0;
+
+                //
+                //  Record how long job slots were left unused while waiting,
+                //  which indicates how much parallelism was unavailable due
+                //  to dependencies or job server limits.
+                //
+
+                if (NumberActiveProcesses < NumberSlots) {
+                    QueryPerformanceCounter(&WaitEndTime);
+                    MakeContext->TimeWithIdleSlots = MakeContext->TimeWithIdleSlots + WaitEndTime.QuadPart - WaitStartTime.QuadPart;
+                    MakeContext->IdleSlotTime = MakeContext->IdleSlotTime + (WaitEndTime.QuadPart - WaitStartTime.QuadPart) * (NumberSlots - NumberActiveProcesses);
+                }
+
+                //
+                //  If the job server was signalled, a token has been
+                //  acquired, so go back and launch the target that was
+                //  waiting for it.
+                //
+
+                if (Index == NumberActiveProcesses) {
+                    MakeContext->JobServerTokensHeld++;
+                    WaitingForToken = FALSE;
+                    continue;
+                }
             }
 
             //
@@ -1079,6 +1736,7 @@ MakeExecuteRequiredTargets(
             //  commands for the target, try to launch those.
             //
 
+            WaitingForToken = FALSE;
             MoveToNextTarget = TRUE;
             Result = MakeProcessCompletion(MakeContext, &ChildRecipeArray[Index]);
             if (Result) {
@@ -1102,11 +1760,17 @@ MakeExecuteRequiredTargets(
 
             if (MoveToNextTarget) {
                 if (Result) {
+                    MakeRecordRecipeDuration(MakeContext, &ChildRecipeArray[Index]);
+                    MakeRecordTargetDigest(MakeContext, ChildRecipeArray[Index].Target);
                     MakeUpdateDependenciesForTarget(MakeContext, ChildRecipeArray[Index].Target);
                 } else {
                     MakeRecipeCompletion(MakeContext, &ChildRecipeArray[Index]);
                 }
 
+                if (ChildRecipeArray[Index].Remote) {
+                    NumberActiveRemote--;
+                }
+
                 if (NumberActiveProcesses > (YORI_ALLOC_SIZE_T)(Index + 1)) {
                     memmove(&ChildRecipeArray[Index],
                             &ChildRecipeArray[Index + 1],
@@ -1114,6 +1778,7 @@ MakeExecuteRequiredTargets(
                 }
 
                 NumberActiveProcesses--;
+                MakeReleaseJobServerTokens(MakeContext, NumberActiveProcesses - NumberActiveRemote);
 
                 //
                 //  Everything in the final entry has been moved to earlier
@@ -1173,6 +1838,10 @@ Drain:
         MakeProcessCompletion(MakeContext, &ChildRecipeArray[Index]);
         MakeRecipeCompletion(MakeContext, &ChildRecipeArray[Index]);
 
+        if (ChildRecipeArray[Index].Remote) {
+            NumberActiveRemote--;
+        }
+
         if (NumberActiveProcesses > Index + 1) {
             memmove(&ChildRecipeArray[Index],
                     &ChildRecipeArray[Index + 1],
@@ -1180,8 +1849,15 @@ Drain:
         }
 
         NumberActiveProcesses--;
+        MakeReleaseJobServerTokens(MakeContext, NumberActiveProcesses - NumberActiveRemote);
     }
 
+    //
+    //  A token may have been acquired for a target that was never launched.
+    //
+
+    MakeReleaseJobServerTokens(MakeContext, 0);
+
     YoriLibFree(ChildRecipeArray);
     YoriLibFree(ProcessHandleArray);
 
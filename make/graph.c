@@ -0,0 +1,1160 @@
+/**
+ * @file make/graph.c
+ *
+ * Yori shell make parsed makefile cache
+ *
+ * Copyright (c) 2026 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <yoripch.h>
+#include <yorilib.h>
+#include <yorish.h>
+#include "make.h"
+
+/**
+ The version of the parsed makefile cache format.  A cache with a different
+ version is ignored.
+ */
+#define MAKE_GRAPH_CACHE_VERSION (2)
+
+/**
+ An index value indicating that no object is referenced.
+ */
+#define MAKE_GRAPH_CACHE_NO_INDEX ((DWORD)-1)
+
+/**
+ A target flag indicating that an explicit recipe was found for the target.
+ */
+#define MAKE_GRAPH_CACHE_EXPLICIT_RECIPE     (0x1)
+
+/**
+ A target flag indicating that the target is the pseudo target for an
+ inference rule.
+ */
+#define MAKE_GRAPH_CACHE_INFERENCE_RULE      (0x2)
+
+/**
+ A target flag indicating that the target was listed in a .REMOTE pseudo
+ target.
+ */
+#define MAKE_GRAPH_CACHE_REMOTE_ELIGIBLE     (0x4)
+
+/**
+ Generate the name of a parsed makefile cache file from the name of the
+ makefile.
+
+ @param MakeFileName Pointer to the file name of the makefile.
+
+ @param Extension Pointer to the extension to append to the makefile name.
+
+ @param CacheFileName On successful completion, updated to contain a newly
+        allocated string referring to the file name of the cache file.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+MakeGetGraphCacheFileName(
+    __in PYORI_STRING MakeFileName,
+    __in LPCTSTR Extension,
+    __out PYORI_STRING CacheFileName
+    )
+{
+    YoriLibInitEmptyString(CacheFileName);
+    if (MakeFileName->LengthInChars > 0) {
+        if (YoriLibAllocateString(CacheFileName, MakeFileName->LengthInChars + (YORI_ALLOC_SIZE_T)_tcslen(Extension) + 1)) {
+            CacheFileName->LengthInChars = YoriLibSPrintf(CacheFileName->StartOfString, _T("%y%s"), MakeFileName, Extension);
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+/**
+ Record a makefile that is being processed, so that a parsed makefile cache
+ can be discarded if the makefile changes.
+
+ @param MakeContext Pointer to the context.
+
+ @param hSource Handle to the opened makefile.
+
+ @param FileName Pointer to the fully qualified name of the makefile.
+ */
+VOID
+MakeGraphCacheRecordMakefile(
+    __inout PMAKE_CONTEXT MakeContext,
+    __in HANDLE hSource,
+    __in PYORI_STRING FileName
+    )
+{
+    PMAKE_GRAPH_CACHE_FILE CacheFile;
+    BY_HANDLE_FILE_INFORMATION FileInfo;
+
+    if (!MakeContext->GraphCacheEnabled) {
+        return;
+    }
+
+    //
+    //  If the makefile can't be recorded, a later execution has no way to
+    //  tell whether it changed, so the cache can't be saved.
+    //
+
+    if (!GetFileInformationByHandle(hSource, &FileInfo)) {
+        MakeContext->GraphCacheIncomplete = TRUE;
+        return;
+    }
+
+    CacheFile = YoriLibMalloc(sizeof(MAKE_GRAPH_CACHE_FILE) + (FileName->LengthInChars + 1) * sizeof(TCHAR));
+    if (CacheFile == NULL) {
+        MakeContext->GraphCacheIncomplete = TRUE;
+        return;
+    }
+
+    CacheFile->ModifiedTime.LowPart = FileInfo.ftLastWriteTime.dwLowDateTime;
+    CacheFile->ModifiedTime.HighPart = FileInfo.ftLastWriteTime.dwHighDateTime;
+
+    YoriLibInitEmptyString(&CacheFile->FileName);
+    CacheFile->FileName.StartOfString = (LPTSTR)(CacheFile + 1);
+    CacheFile->FileName.LengthInChars = FileName->LengthInChars;
+    CacheFile->FileName.LengthAllocated = FileName->LengthInChars + 1;
+    memcpy(CacheFile->FileName.StartOfString, FileName->StartOfString, FileName->LengthInChars * sizeof(TCHAR));
+    CacheFile->FileName.StartOfString[FileName->LengthInChars] = '\0';
+
+    YoriLibAppendList(&MakeContext->GraphCacheFileList, &CacheFile->ListEntry);
+}
+
+/**
+ Deallocate the list of makefiles processed while parsing.
+
+ @param MakeContext Pointer to the context.
+ */
+VOID
+MakeDeleteGraphCacheFiles(
+    __inout PMAKE_CONTEXT MakeContext
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PMAKE_GRAPH_CACHE_FILE CacheFile;
+
+    ListEntry = YoriLibGetNextListEntry(&MakeContext->GraphCacheFileList, NULL);
+    while (ListEntry != NULL) {
+        CacheFile = CONTAINING_RECORD(ListEntry, MAKE_GRAPH_CACHE_FILE, ListEntry);
+        YoriLibRemoveListItem(&CacheFile->ListEntry);
+        YoriLibFree(CacheFile);
+        ListEntry = YoriLibGetNextListEntry(&MakeContext->GraphCacheFileList, NULL);
+    }
+}
+
+/**
+ Parse a numeric field from a line in the parsed makefile cache.  The number
+ is followed by a seperator or the end of the line.  On success, the line is
+ updated to refer to the text following the seperator.
+
+ @param Line Pointer to the remaining portion of the line.
+
+ @param Value On successful completion, updated to contain the number.
+
+ @return TRUE to indicate success, FALSE if the line is not in the expected
+         format.
+ */
+__success(return)
+BOOLEAN
+MakeGraphCacheParseNumber(
+    __inout PYORI_STRING Line,
+    __out PYORI_MAX_SIGNED_T Value
+    )
+{
+    YORI_ALLOC_SIZE_T CharsConsumed;
+
+    if (!YoriLibStringToNumber(Line, FALSE, Value, &CharsConsumed) ||
+        CharsConsumed == 0) {
+
+        return FALSE;
+    }
+
+    if (CharsConsumed < Line->LengthInChars) {
+        if (Line->StartOfString[CharsConsumed] != ':') {
+            return FALSE;
+        }
+        CharsConsumed++;
+    }
+
+    Line->StartOfString = Line->StartOfString + CharsConsumed;
+    Line->LengthInChars = Line->LengthInChars - CharsConsumed;
+    return TRUE;
+}
+
+/**
+ Parse an index field from a line in the parsed makefile cache and check
+ that it refers to an object that has already been loaded.
+
+ @param Line Pointer to the remaining portion of the line.
+
+ @param Count The number of objects that have been loaded.  The index must
+        be less than this value.
+
+ @param AllowNone If TRUE, the index may indicate that no object is
+        referenced, in which case MAKE_GRAPH_CACHE_NO_INDEX is returned.
+
+ @param Index On successful completion, updated to contain the index.
+
+ @return TRUE to indicate success, FALSE if the line is not in the expected
+         format.
+ */
+__success(return)
+BOOLEAN
+MakeGraphCacheParseIndex(
+    __inout PYORI_STRING Line,
+    __in DWORD Count,
+    __in BOOLEAN AllowNone,
+    __out PDWORD Index
+    )
+{
+    YORI_MAX_SIGNED_T llTemp;
+
+    if (!MakeGraphCacheParseNumber(Line, &llTemp)) {
+        return FALSE;
+    }
+
+    if (llTemp == -1 && AllowNone) {
+        *Index = MAKE_GRAPH_CACHE_NO_INDEX;
+        return TRUE;
+    }
+
+    if (llTemp < 0 || llTemp >= Count) {
+        return FALSE;
+    }
+
+    *Index = (DWORD)llTemp;
+    return TRUE;
+}
+
+/**
+ Check whether a makefile recorded in the parsed makefile cache still has
+ the timestamp it had when the cache was saved.
+
+ @param FileName Pointer to the fully qualified name of the makefile.
+
+ @param ModifiedTime The timestamp recorded in the cache.
+
+ @return TRUE if the makefile is unchanged, FALSE if it has changed or
+         cannot be found.
+ */
+BOOLEAN
+MakeGraphCacheIsFileCurrent(
+    __in PYORI_STRING FileName,
+    __in YORI_MAX_SIGNED_T ModifiedTime
+    )
+{
+    YORI_STRING NullTerminatedName;
+    BY_HANDLE_FILE_INFORMATION FileInfo;
+    LARGE_INTEGER FileTime;
+    HANDLE FileHandle;
+    BOOLEAN Result;
+
+    if (!YoriLibCopyString(&NullTerminatedName, FileName)) {
+        return FALSE;
+    }
+
+    Result = FALSE;
+    FileHandle = CreateFile(NullTerminatedName.StartOfString,
+                            FILE_READ_ATTRIBUTES | FILE_READ_DATA,
+                            FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                            NULL,
+                            OPEN_EXISTING,
+                            0,
+                            NULL);
+    YoriLibFreeStringContents(&NullTerminatedName);
+
+    if (FileHandle != INVALID_HANDLE_VALUE) {
+        if (GetFileInformationByHandle(FileHandle, &FileInfo)) {
+            FileTime.LowPart = FileInfo.ftLastWriteTime.dwLowDateTime;
+            FileTime.HighPart = FileInfo.ftLastWriteTime.dwHighDateTime;
+            if (FileTime.QuadPart == ModifiedTime) {
+                Result = TRUE;
+            }
+        }
+        CloseHandle(FileHandle);
+    }
+
+    return Result;
+}
+
+/**
+ Append a line loaded from the parsed makefile cache to the recipe of a
+ target.
+
+ @param Target Pointer to the target.
+
+ @param Line Pointer to the recipe line, without its line terminator.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOLEAN
+MakeGraphCacheAddRecipeLine(
+    __in PMAKE_TARGET Target,
+    __in PYORI_STRING Line
+    )
+{
+    YORI_ALLOC_SIZE_T CharsNeeded;
+
+    CharsNeeded = Target->Recipe.LengthInChars + Line->LengthInChars + 2;
+    if (CharsNeeded > Target->Recipe.LengthAllocated) {
+        if (!YoriLibReallocString(&Target->Recipe, CharsNeeded * 2)) {
+            return FALSE;
+        }
+    }
+
+    memcpy(&Target->Recipe.StartOfString[Target->Recipe.LengthInChars], Line->StartOfString, Line->LengthInChars * sizeof(TCHAR));
+    Target->Recipe.LengthInChars = Target->Recipe.LengthInChars + Line->LengthInChars;
+    Target->Recipe.StartOfString[Target->Recipe.LengthInChars] = '\n';
+    Target->Recipe.StartOfString[Target->Recipe.LengthInChars + 1] = '\0';
+    Target->Recipe.LengthInChars = Target->Recipe.LengthInChars + 1;
+
+    return TRUE;
+}
+
+/**
+ Load the parsed makefile graph from a cache file, if every makefile used to
+ generate it is unchanged, and the environment and command line variables
+ are the same as when it was saved.  On success, the scopes, variables,
+ targets, inference rules and dependencies are in the same state as they
+ would be after preprocessing the makefile, so preprocessing can be skipped.
+
+ If the cache file is valid but cannot be loaded, the graph is partially
+ constructed, so this function indicates the failure by setting
+ ErrorTermination in the context and deleting the cache file.
+
+ @param MakeContext Pointer to the context.  The root scope must have been
+        created, and any command line variables defined.
+
+ @param MakeFileName Pointer to the fully qualified file name of the
+        makefile.
+
+ @return TRUE if the graph was loaded from the cache, FALSE if the makefile
+         needs to be preprocessed.
+ */
+BOOLEAN
+MakeLoadGraphCache(
+    __inout PMAKE_CONTEXT MakeContext,
+    __in PYORI_STRING MakeFileName
+    )
+{
+    YORI_STRING CacheFileName;
+    YORI_STRING LineString;
+    YORI_STRING Line;
+    YORI_STRING Name;
+    YORI_STRING Value;
+    YORI_STRING RuleStrings[4];
+    YORI_MAX_SIGNED_T llTemp;
+    YORI_MAX_SIGNED_T Fields[4];
+    PMAKE_SCOPE_CONTEXT *Scopes;
+    PMAKE_TARGET *Targets;
+    PMAKE_INFERENCE_RULE *Rules;
+    PMAKE_SCOPE_CONTEXT ScopeContext;
+    PMAKE_TARGET Target;
+    PMAKE_TARGET Parent;
+    PMAKE_INFERENCE_RULE InferenceRule;
+    DWORD ScopeCount;
+    DWORD TargetCount;
+    DWORD RuleCount;
+    DWORD ScopesFound;
+    DWORD TargetsFound;
+    DWORD RulesFound;
+    DWORD Index;
+    DWORD ParentIndex;
+    DWORD RuleIndex;
+    DWORD EnvHash;
+    YORI_ALLOC_SIZE_T CharsNeeded;
+    YORI_ALLOC_SIZE_T StringIndex;
+    TCHAR RecordType;
+    BOOLEAN HeaderComplete;
+    BOOLEAN Loaded;
+    HANDLE hCache;
+    PVOID LineContext = NULL;
+    LPTSTR Equals;
+
+    //
+    //  The hash of variables is captured before any makefile is parsed so
+    //  it can be saved with the cache if the cache is not usable.
+    //
+
+    if (!MakeGetEnvironmentHash(MakeContext, &EnvHash)) {
+        MakeContext->GraphCacheIncomplete = TRUE;
+        return FALSE;
+    }
+    MakeContext->GraphCacheVarHash = MakeHashAllVariables(MakeContext->RootScope);
+
+    if (!MakeGetGraphCacheFileName(MakeFileName, _T(".pgc"), &CacheFileName)) {
+        return FALSE;
+    }
+
+    hCache = CreateFile(CacheFileName.StartOfString, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hCache == INVALID_HANDLE_VALUE) {
+        YoriLibFreeStringContents(&CacheFileName);
+        return FALSE;
+    }
+
+    YoriLibInitEmptyString(&LineString);
+    YoriLibInitEmptyString(&Line);
+    YoriLibInitEmptyString(&Name);
+    YoriLibInitEmptyString(&Value);
+    Scopes = NULL;
+    Targets = NULL;
+    Rules = NULL;
+    ScopeContext = NULL;
+    Target = NULL;
+    ScopeCount = 0;
+    TargetCount = 0;
+    RuleCount = 0;
+    ScopesFound = 0;
+    TargetsFound = 0;
+    RulesFound = 0;
+    HeaderComplete = FALSE;
+    Loaded = FALSE;
+
+    //
+    //  The header consists of the version, the hash of the environment and
+    //  variables, each makefile that was parsed, and the number of objects
+    //  in the cache.  Nothing is modified until the header has been found
+    //  to match the current state.
+    //
+
+    if (!YoriLibReadLineToString(&LineString, &LineContext, hCache) ||
+        YoriLibCompareStringLitCnt(&LineString, _T("V:"), 2) != 0) {
+
+        goto Exit;
+    }
+
+    Line.StartOfString = &LineString.StartOfString[2];
+    Line.LengthInChars = LineString.LengthInChars - 2;
+    if (!MakeGraphCacheParseNumber(&Line, &llTemp) ||
+        llTemp != MAKE_GRAPH_CACHE_VERSION) {
+
+        goto Exit;
+    }
+
+    if (!YoriLibReadLineToString(&LineString, &LineContext, hCache) ||
+        YoriLibCompareStringLitCnt(&LineString, _T("E:"), 2) != 0) {
+
+        goto Exit;
+    }
+
+    Line.StartOfString = &LineString.StartOfString[2];
+    Line.LengthInChars = LineString.LengthInChars - 2;
+    if (!MakeGraphCacheParseNumber(&Line, &Fields[0]) ||
+        !MakeGraphCacheParseNumber(&Line, &Fields[1]) ||
+        (DWORD)Fields[0] != EnvHash ||
+        (DWORD)Fields[1] != MakeContext->GraphCacheVarHash) {
+
+        goto Exit;
+    }
+
+    while (TRUE) {
+        if (!YoriLibReadLineToString(&LineString, &LineContext, hCache) ||
+            LineString.LengthInChars < 2 ||
+            LineString.StartOfString[1] != ':') {
+
+            goto Exit;
+        }
+
+        Line.StartOfString = &LineString.StartOfString[2];
+        Line.LengthInChars = LineString.LengthInChars - 2;
+
+        if (LineString.StartOfString[0] == 'F') {
+            if (!MakeGraphCacheParseNumber(&Line, &llTemp) ||
+                Line.LengthInChars == 0 ||
+                !MakeGraphCacheIsFileCurrent(&Line, llTemp)) {
+
+                goto Exit;
+            }
+        } else if (LineString.StartOfString[0] == 'N') {
+            if (!MakeGraphCacheParseNumber(&Line, &Fields[0]) ||
+                !MakeGraphCacheParseNumber(&Line, &Fields[1]) ||
+                !MakeGraphCacheParseNumber(&Line, &Fields[2]) ||
+                Fields[0] <= 0 ||
+                Fields[1] <= 0 ||
+                Fields[2] < 0 ||
+                Fields[0] > MAXLONG ||
+                Fields[1] > MAXLONG ||
+                Fields[2] > MAXLONG ||
+                !YoriLibIsSizeAllocatable((Fields[0] + Fields[1] + Fields[2]) * sizeof(PVOID))) {
+
+                goto Exit;
+            }
+            ScopeCount = (DWORD)Fields[0];
+            TargetCount = (DWORD)Fields[1];
+            RuleCount = (DWORD)Fields[2];
+            break;
+        } else {
+            goto Exit;
+        }
+    }
+
+    //
+    //  From this point, the graph is being modified, so any failure leaves
+    //  it in an inconsistent state and preprocessing cannot occur.
+    //
+
+    HeaderComplete = TRUE;
+
+    Scopes = YoriLibMalloc((YORI_ALLOC_SIZE_T)((ScopeCount + TargetCount + RuleCount) * sizeof(PVOID)));
+    if (Scopes == NULL) {
+        goto Exit;
+    }
+    Targets = (PMAKE_TARGET *)(Scopes + ScopeCount);
+    Rules = (PMAKE_INFERENCE_RULE *)(Targets + TargetCount);
+
+    while (TRUE) {
+        if (!YoriLibReadLineToString(&LineString, &LineContext, hCache) ||
+            LineString.LengthInChars < 1) {
+
+            goto Exit;
+        }
+
+        RecordType = LineString.StartOfString[0];
+        if (RecordType == 'Z') {
+            break;
+        }
+
+        if (LineString.LengthInChars < 2 || LineString.StartOfString[1] != ':') {
+            goto Exit;
+        }
+
+        Line.StartOfString = &LineString.StartOfString[2];
+        Line.LengthInChars = LineString.LengthInChars - 2;
+
+        if (RecordType == 'S') {
+
+            //
+            //  S:ParentScope:Directory
+            //
+
+            if (ScopesFound >= ScopeCount ||
+                !MakeGraphCacheParseIndex(&Line, ScopesFound, TRUE, &ParentIndex) ||
+                Line.LengthInChars == 0) {
+
+                goto Exit;
+            }
+
+            if (ScopesFound == 0) {
+                if (ParentIndex != MAKE_GRAPH_CACHE_NO_INDEX ||
+                    YoriLibCompareStringIns(&Line, &MakeContext->RootScope->HashEntry.Key) != 0) {
+
+                    goto Exit;
+                }
+                ScopeContext = MakeContext->RootScope;
+            } else {
+                if (ParentIndex == MAKE_GRAPH_CACHE_NO_INDEX ||
+                    YoriLibHashLookupByKey(MakeContext->Scopes, &Line) != NULL) {
+
+                    goto Exit;
+                }
+
+                ScopeContext = MakeAllocateNewScope(MakeContext, &Line);
+                if (ScopeContext == NULL) {
+                    goto Exit;
+                }
+
+                //
+                //  The scope remains referenced by the hash table, as it
+                //  would be after being deactivated following parsing.
+                //
+
+                ScopeContext->ParentScope = Scopes[ParentIndex];
+                MakeDereferenceScope(ScopeContext);
+            }
+
+            Scopes[ScopesFound] = ScopeContext;
+            ScopesFound++;
+
+        } else if (RecordType == 'A') {
+
+            //
+            //  A:Precedence:Undefined:Name=Value
+            //
+
+            if (ScopeContext == NULL ||
+                !MakeGraphCacheParseNumber(&Line, &Fields[0]) ||
+                !MakeGraphCacheParseNumber(&Line, &Fields[1]) ||
+                Fields[0] < MakeVariablePrecedencePredefined ||
+                Fields[0] > MakeVariablePrecedenceCommandLine) {
+
+                goto Exit;
+            }
+
+            Equals = YoriLibFindLeftMostCharacter(&Line, '=');
+            if (Equals == NULL) {
+                goto Exit;
+            }
+
+            Name.StartOfString = Line.StartOfString;
+            Name.LengthInChars = (YORI_ALLOC_SIZE_T)(Equals - Line.StartOfString);
+            Value.StartOfString = Equals + 1;
+            Value.LengthInChars = Line.LengthInChars - Name.LengthInChars - 1;
+
+            if (!MakeSetVariable(ScopeContext, &Name, &Value, (BOOLEAN)(Fields[1] == 0), (MAKE_VARIABLE_PRECEDENCE)Fields[0])) {
+                goto Exit;
+            }
+
+        } else if (RecordType == 'T') {
+
+            //
+            //  T:Flags:Scope:TargetName
+            //
+
+            if (TargetsFound >= TargetCount ||
+                !MakeGraphCacheParseNumber(&Line, &llTemp) ||
+                !MakeGraphCacheParseIndex(&Line, ScopesFound, TRUE, &Index) ||
+                Line.LengthInChars == 0) {
+
+                goto Exit;
+            }
+
+            //
+            //  The name is already fully qualified, so resolving it against
+            //  the root scope leaves it unchanged.  Indicating that the
+            //  target is an inference rule prevents it from being attached
+            //  to the default target of the root scope.  Any such attachment
+            //  is described by a dependency record.
+            //
+
+            Target = MakeLookupOrCreateTarget(MakeContext->RootScope, &Line, TRUE);
+            if (Target == NULL) {
+                goto Exit;
+            }
+
+            if (llTemp & MAKE_GRAPH_CACHE_EXPLICIT_RECIPE) {
+                Target->ExplicitRecipeFound = TRUE;
+            }
+
+            if (llTemp & MAKE_GRAPH_CACHE_INFERENCE_RULE) {
+                Target->InferenceRulePseudoTarget = TRUE;
+            }
+
+            if (llTemp & MAKE_GRAPH_CACHE_REMOTE_ELIGIBLE) {
+                Target->RemoteEligible = TRUE;
+            }
+
+            if (Index != MAKE_GRAPH_CACHE_NO_INDEX && Target->ScopeContext == NULL) {
+                MakeReferenceScope(Scopes[Index]);
+                Target->ScopeContext = Scopes[Index];
+            }
+
+            Targets[TargetsFound] = Target;
+            TargetsFound++;
+
+        } else if (RecordType == 'R') {
+
+            //
+            //  R:RecipeLine
+            //
+
+            if (Target == NULL ||
+                !MakeGraphCacheAddRecipeLine(Target, &Line)) {
+
+                goto Exit;
+            }
+
+        } else if (RecordType == 'I') {
+
+            //
+            //  I:Scope:Target:Active:Length:Length:Length:Length:Strings
+            //
+
+            if (RulesFound >= RuleCount ||
+                !MakeGraphCacheParseIndex(&Line, ScopesFound, FALSE, &Index) ||
+                !MakeGraphCacheParseIndex(&Line, TargetsFound, FALSE, &ParentIndex) ||
+                !MakeGraphCacheParseNumber(&Line, &llTemp)) {
+
+                goto Exit;
+            }
+
+            CharsNeeded = 0;
+            for (StringIndex = 0; StringIndex < sizeof(RuleStrings)/sizeof(RuleStrings[0]); StringIndex++) {
+                if (!MakeGraphCacheParseNumber(&Line, &Fields[StringIndex]) ||
+                    Fields[StringIndex] < 0 ||
+                    Fields[StringIndex] > Line.LengthInChars) {
+
+                    goto Exit;
+                }
+                CharsNeeded = CharsNeeded + (YORI_ALLOC_SIZE_T)Fields[StringIndex];
+            }
+
+            if (CharsNeeded != Line.LengthInChars) {
+                goto Exit;
+            }
+
+            CharsNeeded = 0;
+            for (StringIndex = 0; StringIndex < sizeof(RuleStrings)/sizeof(RuleStrings[0]); StringIndex++) {
+                YoriLibInitEmptyString(&RuleStrings[StringIndex]);
+                RuleStrings[StringIndex].StartOfString = &Line.StartOfString[CharsNeeded];
+                RuleStrings[StringIndex].LengthInChars = (YORI_ALLOC_SIZE_T)Fields[StringIndex];
+                CharsNeeded = CharsNeeded + (YORI_ALLOC_SIZE_T)Fields[StringIndex];
+            }
+
+            InferenceRule = MakeCreateInferenceRule(Scopes[Index], &RuleStrings[0], &RuleStrings[1], &RuleStrings[2], &RuleStrings[3], Targets[ParentIndex]);
+            if (InferenceRule == NULL) {
+                goto Exit;
+            }
+
+            //
+            //  Creating a rule inserts it at the head of the list, but the
+            //  cache describes active rules in list order.  Rules that
+            //  are no longer active retain their initial reference until
+            //  all targets referring to them have been loaded.
+            //
+
+            MakeDeactivateInferenceRule(InferenceRule);
+            Rules[RulesFound] = InferenceRule;
+            RulesFound++;
+
+            if (llTemp != 0 &&
+                !MakeActivateInferenceRule(Scopes[Index], InferenceRule, TRUE)) {
+
+                goto Exit;
+            }
+
+        } else if (RecordType == 'M') {
+
+            //
+            //  M:Target:Rule:RuleParentTarget
+            //
+
+            if (!MakeGraphCacheParseIndex(&Line, TargetsFound, FALSE, &Index) ||
+                !MakeGraphCacheParseIndex(&Line, RulesFound, FALSE, &RuleIndex) ||
+                !MakeGraphCacheParseIndex(&Line, TargetsFound, FALSE, &ParentIndex) ||
+                Targets[Index]->InferenceRule != NULL) {
+
+                goto Exit;
+            }
+
+            Target = Targets[Index];
+            Parent = Targets[ParentIndex];
+            InterlockedIncrement((INTERLOCKED_VOLATILE LONG *)&Parent->ReferenceCount);
+            Target->InferenceRuleParentTarget = Parent;
+            MakeReferenceInferenceRule(Rules[RuleIndex]);
+            Target->InferenceRule = Rules[RuleIndex];
+
+        } else if (RecordType == 'D') {
+
+            //
+            //  D:Child:Parent
+            //
+
+            if (!MakeGraphCacheParseIndex(&Line, TargetsFound, FALSE, &Index) ||
+                !MakeGraphCacheParseIndex(&Line, TargetsFound, FALSE, &ParentIndex) ||
+                !MakeCreateParentChildDependency(MakeContext, Targets[ParentIndex], Targets[Index])) {
+
+                goto Exit;
+            }
+
+        } else if (RecordType == 'U') {
+
+            //
+            //  U:Scope:FirstUserTarget
+            //
+
+            if (!MakeGraphCacheParseIndex(&Line, ScopesFound, FALSE, &Index) ||
+                !MakeGraphCacheParseIndex(&Line, TargetsFound, FALSE, &ParentIndex)) {
+
+                goto Exit;
+            }
+
+            Scopes[Index]->FirstUserTarget = Targets[ParentIndex];
+
+        } else {
+            goto Exit;
+        }
+    }
+
+    if (ScopesFound != ScopeCount ||
+        TargetsFound != TargetCount ||
+        RulesFound != RuleCount) {
+
+        goto Exit;
+    }
+
+    Loaded = TRUE;
+
+Exit:
+
+    //
+    //  Rules that are not active are now only referenced by the targets
+    //  that may use them.
+    //
+
+    for (Index = 0; Index < RulesFound; Index++) {
+        if (YoriLibIsListEmpty(&Rules[Index]->ListEntry)) {
+            MakeDereferenceInferenceRule(Rules[Index]);
+        }
+    }
+
+    if (Scopes != NULL) {
+        YoriLibFree(Scopes);
+    }
+
+    YoriLibLineReadCloseOrCache(LineContext);
+    YoriLibFreeStringContents(&LineString);
+    CloseHandle(hCache);
+
+    if (HeaderComplete && !Loaded) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Parsed makefile cache %y is corrupt\n"), &CacheFileName);
+        DeleteFile(CacheFileName.StartOfString);
+        MakeContext->ErrorTermination = TRUE;
+    }
+
+    YoriLibFreeStringContents(&CacheFileName);
+    return Loaded;
+}
+
+/**
+ Write an inference rule to the parsed makefile cache.
+
+ @param hCache Handle to the cache file.
+
+ @param InferenceRule Pointer to the inference rule.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+MakeGraphCacheWriteInferenceRule(
+    __in HANDLE hCache,
+    __in PMAKE_INFERENCE_RULE InferenceRule
+    )
+{
+    return YoriLibOutputToDevice(hCache,
+                                 0,
+                                 _T("I:%i:%i:%i:%i:%i:%i:%i:%y%y%y%y\n"),
+                                 InferenceRule->ScopeContext->GraphCacheIndex,
+                                 InferenceRule->Target->GraphCacheIndex,
+                                 YoriLibIsListEmpty(&InferenceRule->ListEntry)?0:1,
+                                 InferenceRule->RelativeSourceDirectory.LengthInChars,
+                                 InferenceRule->SourceExtension.LengthInChars,
+                                 InferenceRule->RelativeTargetDirectory.LengthInChars,
+                                 InferenceRule->TargetExtension.LengthInChars,
+                                 &InferenceRule->RelativeSourceDirectory,
+                                 &InferenceRule->SourceExtension,
+                                 &InferenceRule->RelativeTargetDirectory,
+                                 &InferenceRule->TargetExtension);
+}
+
+/**
+ Save the parsed makefile graph to a cache file, so that a later execution
+ with unchanged makefiles can skip preprocessing.  This must be called after
+ parsing is complete and before any dependencies are evaluated.  The cache
+ is written to a temporary file and renamed into place, so a partially
+ written cache is never used.
+
+ @param MakeContext Pointer to the context.
+
+ @param MakeFileName Pointer to the fully qualified file name of the
+        makefile.
+ */
+VOID
+MakeSaveGraphCache(
+    __inout PMAKE_CONTEXT MakeContext,
+    __in PYORI_STRING MakeFileName
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PYORI_LIST_ENTRY ChildListEntry;
+    PMAKE_GRAPH_CACHE_FILE CacheFile;
+    PMAKE_SCOPE_CONTEXT ScopeContext;
+    PMAKE_VARIABLE Variable;
+    PMAKE_TARGET Target;
+    PMAKE_INFERENCE_RULE InferenceRule;
+    PMAKE_TARGET_DEPENDENCY Dependency;
+    YORI_STRING CacheFileName;
+    YORI_STRING TempFileName;
+    YORI_STRING RecipeLine;
+    YORI_ALLOC_SIZE_T Index;
+    YORI_ALLOC_SIZE_T StartLineIndex;
+    DWORD ScopeCount;
+    DWORD TargetCount;
+    DWORD RuleCount;
+    DWORD RulesWritten;
+    DWORD EnvHash;
+    DWORD Flags;
+    BOOL Success;
+    HANDLE hCache;
+
+    if (!MakeContext->GraphCacheEnabled ||
+        MakeContext->GraphCacheIncomplete ||
+        MakeContext->ErrorTermination) {
+
+        return;
+    }
+
+    //
+    //  Inline files are generated while parsing and deleted on exit, so a
+    //  recipe referring to one cannot be used by a later execution.
+    //
+
+    if (!YoriLibIsListEmpty(&MakeContext->InlineFileList)) {
+        return;
+    }
+
+    if (!MakeGetEnvironmentHash(MakeContext, &EnvHash)) {
+        return;
+    }
+
+    //
+    //  Assign an index to each object.  Active inference rules are numbered
+    //  in the order they are found on their scope, followed by rules which
+    //  are no longer active but are referenced by a target.
+    //
+
+    ScopeCount = 0;
+    RuleCount = 0;
+    ListEntry = YoriLibGetNextListEntry(&MakeContext->ScopesList, NULL);
+    while (ListEntry != NULL) {
+        ScopeContext = CONTAINING_RECORD(ListEntry, MAKE_SCOPE_CONTEXT, ListEntry);
+        ScopeContext->GraphCacheIndex = ScopeCount;
+        ScopeCount++;
+
+        ChildListEntry = YoriLibGetNextListEntry(&ScopeContext->InferenceRuleList, NULL);
+        while (ChildListEntry != NULL) {
+            InferenceRule = CONTAINING_RECORD(ChildListEntry, MAKE_INFERENCE_RULE, ListEntry);
+            InferenceRule->GraphCacheIndex = RuleCount;
+            RuleCount++;
+            ChildListEntry = YoriLibGetNextListEntry(&ScopeContext->InferenceRuleList, ChildListEntry);
+        }
+
+        ListEntry = YoriLibGetNextListEntry(&MakeContext->ScopesList, ListEntry);
+    }
+
+    TargetCount = 0;
+    ListEntry = YoriLibGetNextListEntry(&MakeContext->TargetsList, NULL);
+    while (ListEntry != NULL) {
+        Target = CONTAINING_RECORD(ListEntry, MAKE_TARGET, ListEntry);
+        Target->GraphCacheIndex = TargetCount;
+        TargetCount++;
+        if (Target->InferenceRule != NULL &&
+            YoriLibIsListEmpty(&Target->InferenceRule->ListEntry)) {
+
+            Target->InferenceRule->GraphCacheIndex = MAKE_GRAPH_CACHE_NO_INDEX;
+        }
+        ListEntry = YoriLibGetNextListEntry(&MakeContext->TargetsList, ListEntry);
+    }
+
+    ListEntry = YoriLibGetNextListEntry(&MakeContext->TargetsList, NULL);
+    while (ListEntry != NULL) {
+        Target = CONTAINING_RECORD(ListEntry, MAKE_TARGET, ListEntry);
+        if (Target->InferenceRule != NULL &&
+            Target->InferenceRule->GraphCacheIndex == MAKE_GRAPH_CACHE_NO_INDEX) {
+
+            Target->InferenceRule->GraphCacheIndex = RuleCount;
+            RuleCount++;
+        }
+        ListEntry = YoriLibGetNextListEntry(&MakeContext->TargetsList, ListEntry);
+    }
+
+    if (!MakeGetGraphCacheFileName(MakeFileName, _T(".pgc"), &CacheFileName)) {
+        return;
+    }
+
+    if (!MakeGetGraphCacheFileName(MakeFileName, _T(".pgc.tmp"), &TempFileName)) {
+        YoriLibFreeStringContents(&CacheFileName);
+        return;
+    }
+
+    hCache = CreateFile(TempFileName.StartOfString, GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hCache == INVALID_HANDLE_VALUE) {
+        YoriLibFreeStringContents(&TempFileName);
+        YoriLibFreeStringContents(&CacheFileName);
+        return;
+    }
+
+    //
+    //  Write the header.
+    //
+
+    Success = YoriLibOutputToDevice(hCache, 0, _T("V:%i\nE:%i:%i\n"), MAKE_GRAPH_CACHE_VERSION, EnvHash, MakeContext->GraphCacheVarHash);
+
+    ListEntry = YoriLibGetNextListEntry(&MakeContext->GraphCacheFileList, NULL);
+    while (ListEntry != NULL && Success) {
+        CacheFile = CONTAINING_RECORD(ListEntry, MAKE_GRAPH_CACHE_FILE, ListEntry);
+        Success = YoriLibOutputToDevice(hCache, 0, _T("F:%lli:%y\n"), CacheFile->ModifiedTime.QuadPart, &CacheFile->FileName);
+        ListEntry = YoriLibGetNextListEntry(&MakeContext->GraphCacheFileList, ListEntry);
+    }
+
+    if (Success) {
+        Success = YoriLibOutputToDevice(hCache, 0, _T("N:%i:%i:%i\n"), ScopeCount, TargetCount, RuleCount);
+    }
+
+    //
+    //  Write each scope and its variables.  Variables are inserted at the
+    //  head of the list when loaded, so they are written in reverse order.
+    //
+
+    ListEntry = YoriLibGetNextListEntry(&MakeContext->ScopesList, NULL);
+    while (ListEntry != NULL && Success) {
+        ScopeContext = CONTAINING_RECORD(ListEntry, MAKE_SCOPE_CONTEXT, ListEntry);
+        Success = YoriLibOutputToDevice(hCache,
+                                        0,
+                                        _T("S:%i:%y\n"),
+                                        ScopeContext->ParentScope == NULL?MAKE_GRAPH_CACHE_NO_INDEX:ScopeContext->ParentScope->GraphCacheIndex,
+                                        &ScopeContext->HashEntry.Key);
+
+        ChildListEntry = YoriLibGetPreviousListEntry(&ScopeContext->VariableList, NULL);
+        while (ChildListEntry != NULL && Success) {
+            Variable = CONTAINING_RECORD(ChildListEntry, MAKE_VARIABLE, ListEntry);
+            Success = YoriLibOutputToDevice(hCache, 0, _T("A:%i:%i:%y=%y\n"), Variable->Precedence, Variable->Undefined, &Variable->HashEntry.Key, &Variable->Value);
+            ChildListEntry = YoriLibGetPreviousListEntry(&ScopeContext->VariableList, ChildListEntry);
+        }
+
+        ListEntry = YoriLibGetNextListEntry(&MakeContext->ScopesList, ListEntry);
+    }
+
+    //
+    //  Write each target and its recipe, one record per line.
+    //
+
+    ListEntry = YoriLibGetNextListEntry(&MakeContext->TargetsList, NULL);
+    while (ListEntry != NULL && Success) {
+        Target = CONTAINING_RECORD(ListEntry, MAKE_TARGET, ListEntry);
+        Flags = 0;
+        if (Target->ExplicitRecipeFound) {
+            Flags = Flags | MAKE_GRAPH_CACHE_EXPLICIT_RECIPE;
+        }
+        if (Target->InferenceRulePseudoTarget) {
+            Flags = Flags | MAKE_GRAPH_CACHE_INFERENCE_RULE;
+        }
+        if (Target->RemoteEligible) {
+            Flags = Flags | MAKE_GRAPH_CACHE_REMOTE_ELIGIBLE;
+        }
+
+        Success = YoriLibOutputToDevice(hCache,
+                                        0,
+                                        _T("T:%i:%i:%y\n"),
+                                        Flags,
+                                        Target->ScopeContext == NULL?MAKE_GRAPH_CACHE_NO_INDEX:Target->ScopeContext->GraphCacheIndex,
+                                        &Target->HashEntry.Key);
+
+        YoriLibInitEmptyString(&RecipeLine);
+        StartLineIndex = 0;
+        for (Index = 0; Index < Target->Recipe.LengthInChars && Success; Index++) {
+            if (Target->Recipe.StartOfString[Index] == '\n') {
+                RecipeLine.StartOfString = &Target->Recipe.StartOfString[StartLineIndex];
+                RecipeLine.LengthInChars = Index - StartLineIndex;
+                StartLineIndex = Index + 1;
+                Success = YoriLibOutputToDevice(hCache, 0, _T("R:%y\n"), &RecipeLine);
+            }
+        }
+
+        ListEntry = YoriLibGetNextListEntry(&MakeContext->TargetsList, ListEntry);
+    }
+
+    //
+    //  Write each inference rule in index order.
+    //
+
+    RulesWritten = 0;
+    ListEntry = YoriLibGetNextListEntry(&MakeContext->ScopesList, NULL);
+    while (ListEntry != NULL && Success) {
+        ScopeContext = CONTAINING_RECORD(ListEntry, MAKE_SCOPE_CONTEXT, ListEntry);
+        ChildListEntry = YoriLibGetNextListEntry(&ScopeContext->InferenceRuleList, NULL);
+        while (ChildListEntry != NULL && Success) {
+            InferenceRule = CONTAINING_RECORD(ChildListEntry, MAKE_INFERENCE_RULE, ListEntry);
+            ASSERT(InferenceRule->GraphCacheIndex == RulesWritten);
+            Success = MakeGraphCacheWriteInferenceRule(hCache, InferenceRule);
+            RulesWritten++;
+            ChildListEntry = YoriLibGetNextListEntry(&ScopeContext->InferenceRuleList, ChildListEntry);
+        }
+        ListEntry = YoriLibGetNextListEntry(&MakeContext->ScopesList, ListEntry);
+    }
+
+    ListEntry = YoriLibGetNextListEntry(&MakeContext->TargetsList, NULL);
+    while (ListEntry != NULL && Success) {
+        Target = CONTAINING_RECORD(ListEntry, MAKE_TARGET, ListEntry);
+        if (Target->InferenceRule != NULL &&
+            Target->InferenceRule->GraphCacheIndex == RulesWritten) {
+
+            Success = MakeGraphCacheWriteInferenceRule(hCache, Target->InferenceRule);
+            RulesWritten++;
+        }
+        ListEntry = YoriLibGetNextListEntry(&MakeContext->TargetsList, ListEntry);
+    }
+
+    ASSERT(!Success || RulesWritten == RuleCount);
+
+    //
+    //  Write the inference rule assignments and dependencies of each
+    //  target.  Dependencies are written in the order of the child's
+    //  parent list, which is the order they are evaluated.
+    //
+
+    ListEntry = YoriLibGetNextListEntry(&MakeContext->TargetsList, NULL);
+    while (ListEntry != NULL && Success) {
+        Target = CONTAINING_RECORD(ListEntry, MAKE_TARGET, ListEntry);
+        if (Target->InferenceRule != NULL) {
+            ASSERT(Target->InferenceRuleParentTarget != NULL);
+            Success = YoriLibOutputToDevice(hCache,
+                                            0,
+                                            _T("M:%i:%i:%i\n"),
+                                            Target->GraphCacheIndex,
+                                            Target->InferenceRule->GraphCacheIndex,
+                                            Target->InferenceRuleParentTarget->GraphCacheIndex);
+        }
+
+        ChildListEntry = YoriLibGetNextListEntry(&Target->ParentDependents, NULL);
+        while (ChildListEntry != NULL && Success) {
+            Dependency = CONTAINING_RECORD(ChildListEntry, MAKE_TARGET_DEPENDENCY, ChildDependents);
+            Success = YoriLibOutputToDevice(hCache, 0, _T("D:%i:%i\n"), Target->GraphCacheIndex, Dependency->Parent->GraphCacheIndex);
+            ChildListEntry = YoriLibGetNextListEntry(&Target->ParentDependents, ChildListEntry);
+        }
+
+        ListEntry = YoriLibGetNextListEntry(&MakeContext->TargetsList, ListEntry);
+    }
+
+    //
+    //  Write the first user target of each scope, which is needed if a
+    //  target is created in the scope when applying inference rules.
+    //
+
+    ListEntry = YoriLibGetNextListEntry(&MakeContext->ScopesList, NULL);
+    while (ListEntry != NULL && Success) {
+        ScopeContext = CONTAINING_RECORD(ListEntry, MAKE_SCOPE_CONTEXT, ListEntry);
+        if (ScopeContext->FirstUserTarget != NULL) {
+            Success = YoriLibOutputToDevice(hCache, 0, _T("U:%i:%i\n"), ScopeContext->GraphCacheIndex, ScopeContext->FirstUserTarget->GraphCacheIndex);
+        }
+        ListEntry = YoriLibGetNextListEntry(&MakeContext->ScopesList, ListEntry);
+    }
+
+    if (Success) {
+        Success = YoriLibOutputToDevice(hCache, 0, _T("Z\n"));
+    }
+
+    CloseHandle(hCache);
+
+    if (!Success ||
+        !MoveFileEx(TempFileName.StartOfString, CacheFileName.StartOfString, MOVEFILE_REPLACE_EXISTING)) {
+
+        DeleteFile(TempFileName.StartOfString);
+    }
+
+    YoriLibFreeStringContents(&TempFileName);
+    YoriLibFreeStringContents(&CacheFileName);
+}
+
+// vim:sw=4:ts=4:et:
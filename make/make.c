@@ -37,17 +37,28 @@ CHAR strMakeHelpText[] =
         "\n"
         "Execute makefiles.\n"
         "\n"
-        "YMAKE [-license] [-f file] [-j n] [-m] [-perf] [-pru] [-s] [var=value] [target]\n"
+        "YMAKE [-license] [-cpu n] [-f file] [-hash] [-hist] [-io low|verylow] [-j n]\n"
+        "      [-m] [-mem low|verylow] [-perf] [-pgc] [-pru] [-remote launcher [-rj n]]\n"
+        "      [-s] [-trace file] [var=value] [target]\n"
         "\n"
         "   --             Treat all further arguments as display parameters\n"
+        "   -cpu n         Limit the build to n percent of processor time\n"
         "   -f             Name of the makefile to use, default YMkFile or Makefile\n"
+        "   -hash          Skip recipes whose commands and input contents are unchanged\n"
+        "   -hist          Record recipe durations to launch the longest paths first\n"
+        "   -io            Perform tasks with low or very low I/O priority\n"
         "   -j             The number of child processes, default number of processors+1\n"
         "   -k             Keep executing jobs after errors\n"
         "   -m             Perform tasks at low priority\n"
+        "   -mem           Perform tasks with low or very low memory priority\n"
         "   -mm            Perform tasks at very low priority\n"
         "   -perf          Display how much time was spent in each phase of processing\n"
+        "   -pgc           Cache the parsed makefile and reuse it when unchanged\n"
         "   -pru           Keep a cache of preprocessor recently executed results\n"
-        "   -s             Silently launch child processes\n";
+        "   -remote        Execute recipes of targets listed in .REMOTE via a launcher\n"
+        "   -rj            The number of remote launchers, default same as -j\n"
+        "   -s             Silently launch child processes\n"
+        "   -trace         Write a trace of the build in Chrome trace event format\n";
 
 
 /**
@@ -87,7 +98,10 @@ typedef struct _MAKE_DEFAULT_MACRO {
  */
 CONST YORI_STRING MakeArgsWithParameter[] = {
     YORILIB_CONSTANT_STRING(_T("f")),
-    YORILIB_CONSTANT_STRING(_T("j"))
+    YORILIB_CONSTANT_STRING(_T("j")),
+    YORILIB_CONSTANT_STRING(_T("remote")),
+    YORILIB_CONSTANT_STRING(_T("rj")),
+    YORILIB_CONSTANT_STRING(_T("trace"))
 };
 
 /**
@@ -355,6 +369,7 @@ ENTRYPOINT(
     YORI_ALLOC_SIZE_T StartArg = 0;
     MAKE_CONTEXT MakeContext;
     PYORI_STRING FileName;
+    PYORI_STRING TraceFileName;
     PMAKE_TARGET RootTarget;
     YORI_STRING FullFileName;
     LARGE_INTEGER StartTime;
@@ -365,12 +380,16 @@ ENTRYPOINT(
     YORI_MAX_SIGNED_T llTemp;
     DWORD Result;
     YORI_ALLOC_SIZE_T CharsConsumed;
+    YORI_ALLOC_SIZE_T ArgsConsumed;
     MAKE_PRIORITY Priority;
+    YORI_LIB_PROCESS_LIMITS Limits;
     BOOLEAN ExplicitTargetFound;
+    BOOLEAN GraphCacheLoaded;
     WORD PerformanceProcessors;
     WORD EfficiencyProcessors;
 
     FileName = NULL;
+    TraceFileName = NULL;
     RootTarget = NULL;
     ZeroMemory(&MakeContext, sizeof(MakeContext));
     YoriLibInitializeListHead(&MakeContext.ScopesList);
@@ -381,9 +400,19 @@ ENTRYPOINT(
     YoriLibInitializeListHead(&MakeContext.TargetsReady);
     YoriLibInitializeListHead(&MakeContext.TargetsWaiting);
     YoriLibInitializeListHead(&MakeContext.PreprocessorCacheList);
+    YoriLibInitializeListHead(&MakeContext.RecipeHistoryList);
+    YoriLibInitializeListHead(&MakeContext.DigestList);
+    YoriLibInitializeListHead(&MakeContext.DirectoryCacheList);
+    YoriLibInitializeListHead(&MakeContext.InferenceProbeCacheList);
+    YoriLibInitializeListHead(&MakeContext.SpeculationList);
+    YoriLibInitializeListHead(&MakeContext.SpeculationPendingList);
+    YoriLibInitializeListHead(&MakeContext.GraphCacheFileList);
+    YoriLibInitializeListHead(&MakeContext.PerfMakefileList);
     YoriLibInitEmptyString(&FullFileName);
     Priority = MakePriorityNormal;
+    YoriLibInitializeProcessLimits(&Limits);
     ExplicitTargetFound = FALSE;
+    GraphCacheLoaded = FALSE;
 
     {
         MAKE_BUILTIN_NAME_MAPPING CONST *BuiltinNameMapping = MakeBuiltinCmds;
@@ -468,6 +497,24 @@ ENTRYPOINT(
                     FileName = &ArgV[i + 1];
                     ArgumentUnderstood = TRUE;
                 }
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("hash")) == 0) {
+                if (MakeContext.DigestTable == NULL) {
+                    MakeContext.DigestTable = YoriLibAllocateHashTable(1000);
+                    if (MakeContext.DigestTable == NULL) {
+                        Result = EXIT_FAILURE;
+                        goto Cleanup;
+                    }
+                }
+                ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("hist")) == 0) {
+                if (MakeContext.RecipeHistory == NULL) {
+                    MakeContext.RecipeHistory = YoriLibAllocateHashTable(1000);
+                    if (MakeContext.RecipeHistory == NULL) {
+                        Result = EXIT_FAILURE;
+                        goto Cleanup;
+                    }
+                }
+                ArgumentUnderstood = TRUE;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("j")) == 0) {
                 if (i + 1 < ArgC) {
                     if (YoriLibStringToNumber(&ArgV[i + 1], FALSE, &llTemp, &CharsConsumed) && CharsConsumed > 0) {
@@ -478,6 +525,9 @@ ENTRYPOINT(
             } else if (YoriLibCompareStringLitIns(&Arg, _T("k")) == 0) {
                 MakeContext.KeepGoing = TRUE;
                 ArgumentUnderstood = TRUE;
+            } else if (YoriLibParseProcessLimitArgument(&Arg, ArgC, ArgV, i, &Limits, &ArgsConsumed)) {
+                i = i + ArgsConsumed;
+                ArgumentUnderstood = TRUE;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("m")) == 0) {
                 Priority = MakePriorityLow;
                 ArgumentUnderstood = TRUE;
@@ -489,6 +539,9 @@ ENTRYPOINT(
             } else if (YoriLibCompareStringLitIns(&Arg, _T("perf")) == 0) {
                 MakeContext.PerfDisplay = TRUE;
                 ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("pgc")) == 0) {
+                MakeContext.GraphCacheEnabled = TRUE;
+                ArgumentUnderstood = TRUE;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("pru")) == 0) {
                 if (MakeContext.PreprocessorCache == NULL) {
                     MakeContext.PreprocessorCache = YoriLibAllocateHashTable(100);
@@ -499,9 +552,27 @@ ENTRYPOINT(
                 }
                 ArgumentUnderstood = TRUE;
 
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("remote")) == 0) {
+                if (i + 1 < ArgC) {
+                    YoriLibFreeStringContents(&MakeContext.RemoteLauncher);
+                    YoriLibCloneString(&MakeContext.RemoteLauncher, &ArgV[i + 1]);
+                    ArgumentUnderstood = TRUE;
+                }
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("rj")) == 0) {
+                if (i + 1 < ArgC) {
+                    if (YoriLibStringToNumber(&ArgV[i + 1], FALSE, &llTemp, &CharsConsumed) && CharsConsumed > 0) {
+                        MakeContext.NumberRemoteProcesses = (YORI_ALLOC_SIZE_T)llTemp;
+                        ArgumentUnderstood = TRUE;
+                    }
+                }
             } else if (YoriLibCompareStringLitIns(&Arg, _T("s")) == 0) {
                 MakeContext.SilentCommandLaunching = TRUE;
                 ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("trace")) == 0) {
+                if (i + 1 < ArgC) {
+                    TraceFileName = &ArgV[i + 1];
+                    ArgumentUnderstood = TRUE;
+                }
             } else if (YoriLibCompareStringLitIns(&Arg, _T("wundef")) == 0) {
                 MakeContext.WarnOnUndefinedVariable = TRUE;
                 ArgumentUnderstood = TRUE;
@@ -577,6 +648,38 @@ ENTRYPOINT(
         }
     }
 
+    //
+    //  Apply any explicit limits to this process.  I/O and memory priority
+    //  are inherited by child processes.  A processor rate limit requires
+    //  a job object, which child processes are also placed in.
+    //
+
+    if (Limits.CpuRate != 0 ||
+        Limits.IoPriority != YORI_LIB_PRIORITY_UNCHANGED ||
+        Limits.MemoryPriority != YORI_LIB_PRIORITY_UNCHANGED) {
+
+        HANDLE hJob;
+
+        hJob = NULL;
+        if (Limits.CpuRate != 0) {
+            hJob = YoriLibCreateJobObject();
+            if (hJob != NULL &&
+                !YoriLibAssignProcessToJobObject(hJob, GetCurrentProcess())) {
+
+                CloseHandle(hJob);
+                hJob = NULL;
+            }
+        }
+
+        if (!YoriLibApplyProcessLimits(GetCurrentProcess(), hJob, &Limits)) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("ymake: some limits are not supported on this system\n"));
+        }
+
+        if (hJob != NULL) {
+            CloseHandle(hJob);
+        }
+    }
+
     YoriLibQueryCpuCount(&PerformanceProcessors, &EfficiencyProcessors);
 
     if (Priority == MakePriorityLow) {
@@ -617,6 +720,54 @@ ENTRYPOINT(
         MakeContext.NumberProcesses = 64;
     }
 
+    //
+    //  Remote launchers are local processes too, so they share the same
+    //  limit.  If a launcher is specified without a count, assume remote
+    //  workers can sustain as many commands as this machine.
+    //
+
+    if (MakeContext.RemoteLauncher.LengthInChars == 0) {
+        MakeContext.NumberRemoteProcesses = 0;
+    } else if (MakeContext.NumberRemoteProcesses == 0) {
+        MakeContext.NumberRemoteProcesses = MakeContext.NumberProcesses;
+    }
+
+    if (MakeContext.NumberRemoteProcesses > 64 - MakeContext.NumberProcesses) {
+        MakeContext.NumberRemoteProcesses = 64 - MakeContext.NumberProcesses;
+    }
+
+    //
+    //  If this process was launched by a process with a job server, share
+    //  its budget so nested builds don't oversubscribe the machine.
+    //  Otherwise create one sized to fit the local process limit, which
+    //  child processes such as clmp or a nested ymake will share.
+    //
+
+    MakeContext.JobServer = YoriLibOpenOrCreateJobServer(MakeContext.NumberProcesses);
+
+    //
+    //  Spread children across NUMA nodes, keeping each child within a
+    //  single node.  On systems with one node and one group this has no
+    //  effect.
+    //
+
+    YoriLibInitializeProcessorPlacement(&MakeContext.ProcessorPlacement, YoriLibPlacementByNumaNode);
+
+    //
+    //  Every target name is resolved against its scope directory each time
+    //  it is referenced, so remember recent resolutions.
+    //
+
+    YoriLibFullPathCacheEnable();
+
+    if (TraceFileName != NULL) {
+        if (!MakeTraceOpen(&MakeContext, TraceFileName)) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Could not create trace file %y\n"), TraceFileName);
+            Result = EXIT_FAILURE;
+            goto Cleanup;
+        }
+    }
+
     //
     //  Find the directory containing the makefile and populate it as the
     //  initial scope.
@@ -730,37 +881,91 @@ ENTRYPOINT(
         MakeLoadPreprocessorCacheEntries(&MakeContext, &FullFileName);
     }
 
-    hStream = CreateFile(FullFileName.StartOfString, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, 0, NULL);
-    if (hStream == INVALID_HANDLE_VALUE) {
-        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("No makefile found\n"));
-        Result = EXIT_FAILURE;
-        goto Cleanup;
+    //
+    //  When recording recipe history, load durations from previous
+    //  executions to estimate which targets should be launched first.
+    //
+
+    if (MakeContext.RecipeHistory != NULL) {
+        MakeLoadRecipeHistory(&MakeContext, &FullFileName);
     }
 
     //
-    //  Preprocess the makefile
+    //  When making rebuild decisions from content, load the digests of
+    //  targets built by previous executions.
     //
 
-    QueryPerformanceCounter(&StartTime);
-    MakeProcessStream(hStream, &MakeContext, &FullFileName);
-    QueryPerformanceCounter(&EndTime);
+    if (MakeContext.DigestTable != NULL) {
+        MakeLoadDigests(&MakeContext, &FullFileName);
+    }
 
-    MakeContext.TimeInPreprocessor = EndTime.QuadPart - StartTime.QuadPart;
+    //
+    //  When caching the parsed makefile, try to load the graph generated by
+    //  a previous execution.  If this succeeds, no makefile has changed, so
+    //  preprocessing is not needed.
+    //
 
-    CloseHandle(hStream);
+    if (MakeContext.GraphCacheEnabled) {
+        QueryPerformanceCounter(&StartTime);
+        GraphCacheLoaded = MakeLoadGraphCache(&MakeContext, &FullFileName);
+        QueryPerformanceCounter(&EndTime);
 
-    if (MakeContext.ErrorTermination) {
-        Result = EXIT_FAILURE;
-        goto Cleanup;
+        if (MakeContext.ErrorTermination) {
+            Result = EXIT_FAILURE;
+            goto Cleanup;
+        }
+
+        if (GraphCacheLoaded) {
+            MakeContext.TimeInPreprocessor = EndTime.QuadPart - StartTime.QuadPart;
+            MakeTracePhase(&MakeContext, _T("Load parsed makefile cache"), &FullFileName, &StartTime, &EndTime);
+        }
     }
 
-    MakeFindInferenceRulesForScope(MakeContext.RootScope);
+    if (!GraphCacheLoaded) {
+        hStream = CreateFile(FullFileName.StartOfString, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, 0, NULL);
+        if (hStream == INVALID_HANDLE_VALUE) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("No makefile found\n"));
+            Result = EXIT_FAILURE;
+            goto Cleanup;
+        }
+
+        //
+        //  Preprocess the makefile
+        //
+
+        QueryPerformanceCounter(&StartTime);
+        MakeProcessStream(hStream, &MakeContext, &FullFileName);
+        MakeCleanupPreprocessorSpeculation(&MakeContext);
+        QueryPerformanceCounter(&EndTime);
+
+        MakeContext.TimeInPreprocessor = EndTime.QuadPart - StartTime.QuadPart;
+
+        CloseHandle(hStream);
+
+        if (MakeContext.ErrorTermination) {
+            Result = EXIT_FAILURE;
+            goto Cleanup;
+        }
+
+        MakeFindInferenceRulesForScope(MakeContext.RootScope);
+        MakeDeleteInferenceProbeCache(&MakeContext);
+
+        //
+        //  Save the parsed graph before any dependencies are evaluated,
+        //  since evaluation modifies it.
+        //
+
+        if (MakeContext.GraphCacheEnabled) {
+            MakeSaveGraphCache(&MakeContext, &FullFileName);
+        }
+    }
 
     //
     //  Determine the tasks to execute
     //
 
     QueryPerformanceCounter(&StartTime);
+    MakePopulateDirectoryCache(&MakeContext);
 
     //
     //  Scan through command line arguments again, this time looking for
@@ -812,8 +1017,10 @@ ENTRYPOINT(
         }
     }
 
+    MakeDeleteDirectoryCache(&MakeContext);
     QueryPerformanceCounter(&EndTime);
     MakeContext.TimeBuildingGraph = EndTime.QuadPart - StartTime.QuadPart;
+    MakeTracePhase(&MakeContext, _T("Evaluate dependencies"), NULL, &StartTime, &EndTime);
 
     //
     //  Execute the tasks
@@ -827,6 +1034,7 @@ ENTRYPOINT(
     }
     QueryPerformanceCounter(&EndTime);
     MakeContext.TimeInExecute = EndTime.QuadPart - StartTime.QuadPart;
+    MakeTracePhase(&MakeContext, _T("Execute"), NULL, &StartTime, &EndTime);
 
 
     Result = EXIT_SUCCESS;
@@ -848,24 +1056,40 @@ Cleanup:
     MakeSlabCleanup(&MakeContext.TargetAllocator);
     MakeSlabCleanup(&MakeContext.DependencyAllocator);
 
+    MakeDeleteDirectoryCache(&MakeContext);
+    MakeDeleteInferenceProbeCache(&MakeContext);
     MakeDeleteAllTargets(&MakeContext);
 
     if (MakeContext.Targets != NULL) {
         YoriLibFreeEmptyHashTable(MakeContext.Targets);
     }
 
+    MakeCleanupPreprocessorSpeculation(&MakeContext);
     MakeDeleteAllScopes(&MakeContext);
+    MakeArenaCleanup(&MakeContext.StringArena);
+    MakeArenaCleanup(&MakeContext.ExpansionArena);
     MakeSaveAndDeleteAllPreprocessorCacheEntries(&MakeContext, &FullFileName);
+    MakeSaveAndDeleteRecipeHistory(&MakeContext, &FullFileName);
+    MakeSaveAndDeleteDigests(&MakeContext, &FullFileName);
+    MakeDeleteGraphCacheFiles(&MakeContext);
+    MakeTraceCounters(&MakeContext);
+    MakeTraceClose(&MakeContext);
 
     YoriLibFreeStringContents(&FullFileName);
 
     YoriLibFreeStringContents(&MakeContext.TempPath);
+    YoriLibFreeStringContents(&MakeContext.RemoteLauncher);
+    if (MakeContext.JobServer != NULL) {
+        CloseHandle(MakeContext.JobServer);
+    }
+    YoriLibCleanupProcessorPlacement(&MakeContext.ProcessorPlacement);
     YoriLibFreeStringContents(&MakeContext.ProcessCurrentDirectory);
     YoriLibFreeStringContents(&MakeContext.FilesToProbe[0]);
     YoriLibFreeStringContents(&MakeContext.FilesToProbe[1]);
     YoriLibShBuiltinUnregisterAll();
 
     YoriLibLineReadCleanupCache();
+    YoriLibFullPathCacheCleanup();
 
     if (MakeContext.ErrorTermination) {
         YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Parse error!!\n"));
@@ -876,31 +1100,9 @@ Cleanup:
     MakeContext.TimeInCleanup = EndTime.QuadPart - StartTime.QuadPart;
 
     if (MakeContext.PerfDisplay && Result == EXIT_SUCCESS) {
-        LARGE_INTEGER Frequency;
-        QueryPerformanceFrequency(&Frequency);
-        MakeContext.TimeInPreprocessor = MakeContext.TimeInPreprocessor - MakeContext.TimeInPreprocessorCreateProcess;
-
-        MakeContext.TimeInPreprocessorCreateProcess = MakeContext.TimeInPreprocessorCreateProcess * 1000 / Frequency.QuadPart;
-        MakeContext.TimeInPreprocessor = MakeContext.TimeInPreprocessor * 1000 / Frequency.QuadPart;
-        MakeContext.TimeBuildingGraph = MakeContext.TimeBuildingGraph * 1000 / Frequency.QuadPart;
-        MakeContext.TimeInExecute = MakeContext.TimeInExecute * 1000 / Frequency.QuadPart;
-        MakeContext.TimeInCleanup = MakeContext.TimeInCleanup * 1000 / Frequency.QuadPart;
-        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("\n"));
-        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Time in preprocessor child processes: %lli ms\n"), MakeContext.TimeInPreprocessorCreateProcess);
-        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Time in preprocessor: %lli ms\n"), MakeContext.TimeInPreprocessor);
-        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Time building graph: %lli ms\n"), MakeContext.TimeBuildingGraph);
-        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Time executing commands: %lli ms\n"), MakeContext.TimeInExecute);
-        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Time cleaning up: %lli ms\n"), MakeContext.TimeInCleanup);
-
-#if MAKE_DEBUG_PERF
-        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Number dependency allocs: %i\n"), MakeContext.AllocDependency);
-        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Number inference rule allocs: %i\n"), MakeContext.AllocInferenceRule);
-        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Number target allocs: %i\n"), MakeContext.AllocTarget);
-        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Number variable allocs: %i\n"), MakeContext.AllocVariable);
-        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Number variable data allocs: %i\n"), MakeContext.AllocVariableData);
-        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Number expanded line allocs: %i\n"), MakeContext.AllocExpandedLine);
-#endif
+        MakePerfDisplay(&MakeContext);
     }
+    MakePerfCleanup(&MakeContext);
 
     return Result;
 }
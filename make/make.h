@@ -52,12 +52,6 @@
  */
 #define MAKE_DEBUG_TARGETS      0
 
-/**
- Set to nonzero to output extra information about time spent in different
- parts of the build process.
- */
-#define MAKE_DEBUG_PERF         0
-
 
 /**
  A structure to record information about how to allocate fixed sized
@@ -87,6 +81,65 @@ typedef struct _MAKE_SLAB_ALLOC {
     PVOID Buffer;
 } MAKE_SLAB_ALLOC, *PMAKE_SLAB_ALLOC;
 
+/**
+ A block of memory from which arena allocations are made.  The memory to
+ allocate from immediately follows this structure.
+ */
+typedef struct _MAKE_ARENA_CHUNK {
+
+    /**
+     The chunk that was in use before this one was allocated, or NULL if
+     this is the first chunk.
+     */
+    struct _MAKE_ARENA_CHUNK *Previous;
+
+    /**
+     The number of bytes following this structure that can be allocated.
+     */
+    YORI_ALLOC_SIZE_T BytesAllocated;
+
+    /**
+     The number of bytes following this structure that have been allocated.
+     */
+    YORI_ALLOC_SIZE_T BytesUsed;
+} MAKE_ARENA_CHUNK, *PMAKE_ARENA_CHUNK;
+
+/**
+ A structure to record information about how to allocate variable sized
+ objects which are freed together rather than individually.
+ */
+typedef struct _MAKE_ARENA {
+
+    /**
+     The chunk that allocations are currently being made from, or NULL if
+     no memory has been allocated.
+     */
+    PMAKE_ARENA_CHUNK Chunk;
+
+    /**
+     The number of allocations made from this arena.  Each of these is an
+     allocation that did not need to be made from the heap.
+     */
+    DWORD NumberAllocations;
+} MAKE_ARENA, *PMAKE_ARENA;
+
+/**
+ A position within an arena that the arena can be reset to, releasing all
+ later allocations.
+ */
+typedef struct _MAKE_ARENA_MARK {
+
+    /**
+     The chunk that was in use when the mark was taken.
+     */
+    PMAKE_ARENA_CHUNK Chunk;
+
+    /**
+     The number of bytes used in the chunk when the mark was taken.
+     */
+    YORI_ALLOC_SIZE_T BytesUsed;
+} MAKE_ARENA_MARK, *PMAKE_ARENA_MARK;
+
 /**
  A record of the exitcode of a preprocessor command.  These can be recorded
  to save time on a subsequent compilation.
@@ -113,6 +166,132 @@ typedef struct _MAKE_PREPROC_EXEC_CACHE_ENTRY {
 
 } MAKE_PREPROC_EXEC_CACHE_ENTRY, *PMAKE_PREPROC_EXEC_CACHE_ENTRY;
 
+/**
+ A preprocessor command which is executed speculatively, before the
+ preprocessor reaches the line that requires its result.  This allows
+ independent commands to execute concurrently.
+ */
+typedef struct _MAKE_PREPROC_SPECULATION {
+
+    /**
+     The hash entry of the preprocessor command.  The key is the command
+     string after variable expansion.
+     */
+    YORI_HASH_ENTRY HashEntry;
+
+    /**
+     A list of all entries to facilitate efficient teardown.  Paired with
+     MAKE_CONTEXT::SpeculationList.
+     */
+    YORI_LIST_ENTRY ListEntry;
+
+    /**
+     The entry on the list of commands which have not yet been started by a
+     worker thread.  Paired with MAKE_CONTEXT::SpeculationPendingList.
+     */
+    YORI_LIST_ENTRY PendingListEntry;
+
+    /**
+     The command to execute.  This is the memory backing the hash key.
+     */
+    YORI_STRING Cmd;
+
+    /**
+     The parsed command.
+     */
+    YORI_LIBSH_CMD_CONTEXT CmdContext;
+
+    /**
+     The plan to execute the command.
+     */
+    YORI_LIBSH_EXEC_PLAN ExecPlan;
+
+    /**
+     An event signalled when the command has completed.
+     */
+    HANDLE CompleteEvent;
+
+    /**
+     The exit code of the command, valid once CompleteEvent is signalled.
+     */
+    DWORD ExitCode;
+
+    /**
+     TRUE once a thread has commenced executing the command.  Protected by
+     MAKE_CONTEXT::SpeculationMutex.
+     */
+    BOOLEAN Started;
+
+    /**
+     TRUE if the entry is in MAKE_CONTEXT::SpeculationTable and its result
+     can be used.
+     */
+    BOOLEAN InHashTable;
+
+} MAKE_PREPROC_SPECULATION, *PMAKE_PREPROC_SPECULATION;
+
+/**
+ Information about a makefile stream which is currently being processed.
+ This is used to look ahead in the stream for preprocessor commands that
+ can be executed speculatively.
+ */
+typedef struct _MAKE_PREPROC_STREAM {
+
+    /**
+     The stream which contained this stream via !INCLUDE, or NULL if this
+     is the initial makefile.
+     */
+    struct _MAKE_PREPROC_STREAM *Parent;
+
+    /**
+     A handle to the stream.
+     */
+    HANDLE hSource;
+
+    /**
+     The number of physical lines that have been read from the stream.
+     */
+    DWORD LineNumber;
+
+    /**
+     The time spent processing streams nested within this stream, in
+     performance counter units.  This allows the time spent in each
+     makefile to exclude the makefiles it includes.
+     */
+    DWORDLONG NestedTime;
+
+} MAKE_PREPROC_STREAM, *PMAKE_PREPROC_STREAM;
+
+/**
+ A record of the time taken to preprocess a single makefile, used to
+ display the most expensive makefiles when performance information is
+ requested.
+ */
+typedef struct _MAKE_PERF_MAKEFILE {
+
+    /**
+     The list of makefiles that have been preprocessed.  Paired with
+     MAKE_CONTEXT::PerfMakefileList.
+     */
+    YORI_LIST_ENTRY ListEntry;
+
+    /**
+     The full path to the makefile.
+     */
+    YORI_STRING FileName;
+
+    /**
+     The time spent preprocessing this makefile, excluding any makefiles it
+     includes, in performance counter units.
+     */
+    DWORDLONG Time;
+
+    /**
+     The number of physical lines in the makefile.
+     */
+    DWORD LineCount;
+} MAKE_PERF_MAKEFILE, *PMAKE_PERF_MAKEFILE;
+
 /**
  The name of the default target within a scope.  This refers to the first
  user defined target within the scope.  Note this name is chosen to be an
@@ -121,6 +300,12 @@ typedef struct _MAKE_PREPROC_EXEC_CACHE_ENTRY {
  */
 #define MAKE_DEFAULT_SCOPE_TARGET_NAME _T(":Default")
 
+/**
+ The size of a digest used to detect changes to the contents of a target,
+ in bytes.  Digests are calculated with MD5.
+ */
+#define MAKE_DIGEST_SIZE (16)
+
 /**
  Indicates the state of parsing, indicating whether the next line corresponds
  to an inline file, a recipe, or only rules are acceptable.
@@ -215,6 +400,26 @@ typedef struct _MAKE_SCOPE_CONTEXT {
      */
     YORI_LIST_ENTRY InferenceRuleList;
 
+    /**
+     A hash table of target extensions that inference rules in this scope
+     can generate, used to find the rules for a target without scanning
+     every rule.  This is NULL until a rule is added.  Each entry is a
+     MAKE_INFERENCE_RULE_EXTENSION.
+     */
+    PYORI_HASH_TABLE InferenceRuleExtensions;
+
+    /**
+     A list of MAKE_INFERENCE_RULE_EXTENSION structures in this scope, used
+     to facilitate bulk delete.
+     */
+    YORI_LIST_ENTRY InferenceRuleExtensionList;
+
+    /**
+     The largest number of characters that any inference rule added to this
+     scope would add to a target name to generate its source name.
+     */
+    YORI_ALLOC_SIZE_T InferenceRuleExtraChars;
+
     /**
      A list of targets that have not had inference rules located yet.
      This is paired with the scope context so that targets accessed by a
@@ -259,6 +464,12 @@ typedef struct _MAKE_SCOPE_CONTEXT {
      */
     BOOLEAN ActiveConditionalNestingLevelExecutionOccurred;
 
+    /**
+     The index of this scope within the parsed makefile cache.  This is only
+     meaningful while the cache is being saved.
+     */
+    DWORD GraphCacheIndex;
+
 } MAKE_SCOPE_CONTEXT, *PMAKE_SCOPE_CONTEXT;
 
 
@@ -328,6 +539,19 @@ typedef struct _MAKE_INFERENCE_RULE {
      */
     YORI_LIST_ENTRY ListEntry;
 
+    /**
+     The list of active inference rules that generate the same target
+     extension, in the same order as ListEntry.  This is paired with
+     MAKE_INFERENCE_RULE_EXTENSION::RuleList.
+     */
+    YORI_LIST_ENTRY ExtensionListEntry;
+
+    /**
+     Pointer to the set of rules within the owning scope that generate the
+     same target extension, or NULL if the rule is not active.
+     */
+    struct _MAKE_INFERENCE_RULE_EXTENSION *Extension;
+
     /**
      Pointer to the ScopeContext owning this inference rule.  Note this is
      not referenced.
@@ -365,8 +589,40 @@ typedef struct _MAKE_INFERENCE_RULE {
      */
     struct _MAKE_TARGET *Target;
 
+    /**
+     The index of this rule within the parsed makefile cache.  This is only
+     meaningful while the cache is being saved.
+     */
+    DWORD GraphCacheIndex;
+
 } MAKE_INFERENCE_RULE, *PMAKE_INFERENCE_RULE;
 
+/**
+ The set of active inference rules within a scope that generate a single
+ target extension.  The extension is stored immediately following this
+ structure.
+ */
+typedef struct _MAKE_INFERENCE_RULE_EXTENSION {
+
+    /**
+     The hash entry for the extension.  The key is the target extension.
+     Paired with MAKE_SCOPE_CONTEXT::InferenceRuleExtensions.
+     */
+    YORI_HASH_ENTRY HashEntry;
+
+    /**
+     The list of all extensions within the scope.  Paired with
+     MAKE_SCOPE_CONTEXT::InferenceRuleExtensionList.
+     */
+    YORI_LIST_ENTRY ListEntry;
+
+    /**
+     The list of active rules generating this extension.  Paired with
+     MAKE_INFERENCE_RULE::ExtensionListEntry.
+     */
+    YORI_LIST_ENTRY RuleList;
+} MAKE_INFERENCE_RULE_EXTENSION, *PMAKE_INFERENCE_RULE_EXTENSION;
+
 /**
  A dependency structure to describe the relationship between an object that
  requires something to be built first and the object being built first and
@@ -431,6 +687,87 @@ typedef struct _MAKE_CMD_TO_EXEC {
 
 } MAKE_CMD_TO_EXEC, *PMAKE_CMD_TO_EXEC;
 
+/**
+ A file found when enumerating a directory to populate the directory cache.
+ */
+typedef struct _MAKE_DIRECTORY_CACHE_FILE {
+
+    /**
+     The hash entry for the file.  The key is the file name within the
+     directory, which is stored immediately following this structure.
+     Paired with MAKE_DIRECTORY_CACHE_ENTRY::Files.
+     */
+    YORI_HASH_ENTRY HashEntry;
+
+    /**
+     The list of all files found within the directory.  Paired with
+     MAKE_DIRECTORY_CACHE_ENTRY::FileList.
+     */
+    YORI_LIST_ENTRY ListEntry;
+
+    /**
+     The timestamp of the file, or zero if the entry is a directory.
+     */
+    LARGE_INTEGER ModifiedTime;
+
+    /**
+     TRUE if the timestamp returned from enumeration may not describe the
+     target, such as for a reparse point, so the file must be opened.
+     */
+    BOOLEAN ProbeRequired;
+
+} MAKE_DIRECTORY_CACHE_FILE, *PMAKE_DIRECTORY_CACHE_FILE;
+
+/**
+ A directory containing targets whose existence and timestamp are resolved
+ by enumerating the directory once rather than opening each target.
+ */
+typedef struct _MAKE_DIRECTORY_CACHE_ENTRY {
+
+    /**
+     The hash entry for the directory.  The key is the fully qualified path
+     to the directory, including a trailing seperator.  Paired with
+     MAKE_CONTEXT::DirectoryCache.
+     */
+    YORI_HASH_ENTRY HashEntry;
+
+    /**
+     The list of all directory cache entries.  Paired with
+     MAKE_CONTEXT::DirectoryCacheList.
+     */
+    YORI_LIST_ENTRY ListEntry;
+
+    /**
+     The fully qualified path to the directory.  This is the memory backing
+     the hash key.
+     */
+    YORI_STRING DirName;
+
+    /**
+     A hash table of files found within the directory.
+     */
+    PYORI_HASH_TABLE Files;
+
+    /**
+     A list of files found within the directory, used to facilitate bulk
+     delete.
+     */
+    YORI_LIST_ENTRY FileList;
+
+    /**
+     The number of targets which refer to files within this directory.
+     */
+    DWORD TargetCount;
+
+    /**
+     TRUE if the directory has been enumerated and Files describes its
+     contents.  If FALSE, targets within the directory are probed
+     individually.
+     */
+    BOOLEAN Enumerated;
+
+} MAKE_DIRECTORY_CACHE_ENTRY, *PMAKE_DIRECTORY_CACHE_ENTRY;
+
 /**
  Information describing a make target.  Note that a target is something that
  we might want to build, or may not be part of the current build process, or
@@ -495,6 +832,12 @@ typedef struct _MAKE_TARGET {
      */
     DWORD NumberParentsToBuild;
 
+    /**
+     The index of this target within the parsed makefile cache.  This is
+     only meaningful while the cache is being saved.
+     */
+    DWORD GraphCacheIndex;
+
     /**
      TRUE if an explicit recipe has been found.  That line may list
      dependencies only (ie., the recipe may have no tasks to perform) but
@@ -535,6 +878,12 @@ typedef struct _MAKE_TARGET {
      */
     BOOLEAN EvaluatingDependencies;
 
+    /**
+     TRUE if this target and everything it depends upon have been collected
+     so their evaluation can be prepared concurrently.
+     */
+    BOOLEAN DependenciesCollected;
+
     /**
      TRUE if the commands to execute require a shell.  This occurs if the
      commands include any redirection operator, or there are multiple
@@ -555,12 +904,55 @@ typedef struct _MAKE_TARGET {
      */
     BOOLEAN InferenceRulePseudoTarget;
 
+    /**
+     TRUE if CriticalPathCost has been calculated for this target.
+     */
+    BOOLEAN CriticalPathCostCalculated;
+
+    /**
+     TRUE if ContentDigest contains the digest of the file's contents.  This
+     is cleared when the target's recipe is executed.
+     */
+    BOOLEAN ContentDigestValid;
+
+    /**
+     TRUE if this target has been selected to have its content digest
+     calculated concurrently before dependencies are evaluated.
+     */
+    BOOLEAN ContentDigestPrefetched;
+
+    /**
+     TRUE if this target was listed in a .REMOTE pseudo target, indicating
+     its recipe may be executed by the remote launcher.
+     */
+    BOOLEAN RemoteEligible;
+
+    /**
+     The digest of the file's contents.  This is only meaningful if
+     ContentDigestValid is TRUE.
+     */
+    UCHAR ContentDigest[MAKE_DIGEST_SIZE];
+
     /**
      The timestamp of the file.  This is only meaningful if FileExists is
      TRUE (implying FileProbed is also TRUE.)
      */
     LARGE_INTEGER ModifiedTime;
 
+    /**
+     The estimated time to build this target and every target that is
+     waiting for it along the longest chain of dependents.  Ready targets
+     with a higher cost are launched first.  This is only meaningful if
+     CriticalPathCostCalculated is TRUE.
+     */
+    DWORDLONG CriticalPathCost;
+
+    /**
+     The time that this target became ready to execute.  This is only
+     recorded when a trace is being generated.
+     */
+    LARGE_INTEGER ReadyTime;
+
     /**
      Pointer to the best matching inference rule in effect at the time the
      target was referenced.  This may be superseded by a later explicit
@@ -592,69 +984,162 @@ typedef struct _MAKE_TARGET {
 } MAKE_TARGET, *PMAKE_TARGET;
 
 /**
- Information about an inline file.  An inline file is one generated by <<
- operators in a makefile.
+ The duration of a recipe the last time it was executed, used to estimate
+ its cost when scheduling targets.
  */
-typedef struct _MAKE_INLINE_FILE {
+typedef struct _MAKE_RECIPE_HISTORY_ENTRY {
 
     /**
-     The entry for this file within the global list.  Paired with
-     MAKE_CONTEXT::InlineFileList.
+     The hash entry for the recipe.  The key is the fully qualified path of
+     the target.  Paired with MAKE_CONTEXT::RecipeHistory.
      */
-    YORI_LIST_ENTRY InlineFileList;
+    YORI_HASH_ENTRY HashEntry;
 
     /**
-     The name of this inline file.
+     The list of all history entries, used to facilitate bulk delete and to
+     save the history.  Paired with MAKE_CONTEXT::RecipeHistoryList.
      */
-    YORI_STRING FileName;
+    YORI_LIST_ENTRY ListEntry;
 
     /**
-     A handle to this inline file.  This is only used while the file is being
-     populated with data, and must be closed to allow build tools to consume
-     the file.  INVALID_HANDLE_VALUE indicates the handle is closed.
+     The time taken to execute the recipe, in milliseconds.
      */
-    HANDLE FileHandle;
-} MAKE_INLINE_FILE, *PMAKE_INLINE_FILE;
+    DWORD DurationInMs;
+
+} MAKE_RECIPE_HISTORY_ENTRY, *PMAKE_RECIPE_HISTORY_ENTRY;
 
 /**
- Current state of the operation.
+ The digests of the inputs and output of a target the last time its recipe
+ was executed, used to skip recipes whose inputs have not changed.
  */
-typedef struct _MAKE_CONTEXT {
+typedef struct _MAKE_DIGEST_ENTRY {
 
     /**
-     Pointer to the currently active scope.
+     The hash entry for the target.  The key is the fully qualified path of
+     the target.  Paired with MAKE_CONTEXT::DigestTable.
      */
-    PMAKE_SCOPE_CONTEXT ActiveScope;
+    YORI_HASH_ENTRY HashEntry;
 
     /**
-     Pointer to the initial scope of the first makefile to execute.
+     The list of all digest entries, used to facilitate bulk delete and to
+     save the digests.  Paired with MAKE_CONTEXT::DigestList.
      */
-    PMAKE_SCOPE_CONTEXT RootScope;
+    YORI_LIST_ENTRY ListEntry;
 
     /**
-     The current directory at the time the process was launched.
+     The digest of the commands used to build the target and the contents
+     of every target it depends upon.
      */
-    YORI_STRING ProcessCurrentDirectory;
+    UCHAR InputDigest[MAKE_DIGEST_SIZE];
 
     /**
-     An allocator used to preallocate and suballocate target structures.
+     The digest of the contents of the target after its recipe completed.
      */
-    MAKE_SLAB_ALLOC TargetAllocator;
+    UCHAR OutputDigest[MAKE_DIGEST_SIZE];
+
+} MAKE_DIGEST_ENTRY, *PMAKE_DIGEST_ENTRY;
+
+/**
+ A makefile that was processed while parsing, recorded so that a parsed
+ makefile cache can be discarded when any makefile changes.
+ */
+typedef struct _MAKE_GRAPH_CACHE_FILE {
 
     /**
-     An allocator used to preallocate and suballocate dependency structures.
+     The list of all processed makefiles.  Paired with
+     MAKE_CONTEXT::GraphCacheFileList.
      */
-    MAKE_SLAB_ALLOC DependencyAllocator;
+    YORI_LIST_ENTRY ListEntry;
 
     /**
-     A hash table of scopes whose key is their directory.
+     The timestamp of the makefile when it was processed.
      */
-    PYORI_HASH_TABLE Scopes;
+    LARGE_INTEGER ModifiedTime;
 
     /**
-     A list of known scopes, used to facilitate bulk delete.
+     The fully qualified name of the makefile.  This refers to memory
+     allocated as part of this structure.
      */
-    YORI_LIST_ENTRY ScopesList;
+    YORI_STRING FileName;
+
+} MAKE_GRAPH_CACHE_FILE, *PMAKE_GRAPH_CACHE_FILE;
+
+/**
+ Information about an inline file.  An inline file is one generated by <<
+ operators in a makefile.
+ */
+typedef struct _MAKE_INLINE_FILE {
+
+    /**
+     The entry for this file within the global list.  Paired with
+     MAKE_CONTEXT::InlineFileList.
+     */
+    YORI_LIST_ENTRY InlineFileList;
+
+    /**
+     The name of this inline file.
+     */
+    YORI_STRING FileName;
+
+    /**
+     A handle to this inline file.  This is only used while the file is being
+     populated with data, and must be closed to allow build tools to consume
+     the file.  INVALID_HANDLE_VALUE indicates the handle is closed.
+     */
+    HANDLE FileHandle;
+} MAKE_INLINE_FILE, *PMAKE_INLINE_FILE;
+
+/**
+ Current state of the operation.
+ */
+typedef struct _MAKE_CONTEXT {
+
+    /**
+     Pointer to the currently active scope.
+     */
+    PMAKE_SCOPE_CONTEXT ActiveScope;
+
+    /**
+     Pointer to the initial scope of the first makefile to execute.
+     */
+    PMAKE_SCOPE_CONTEXT RootScope;
+
+    /**
+     The current directory at the time the process was launched.
+     */
+    YORI_STRING ProcessCurrentDirectory;
+
+    /**
+     An allocator used to preallocate and suballocate target structures.
+     */
+    MAKE_SLAB_ALLOC TargetAllocator;
+
+    /**
+     An allocator used to preallocate and suballocate dependency structures.
+     */
+    MAKE_SLAB_ALLOC DependencyAllocator;
+
+    /**
+     An arena used for temporary strings generated while expanding
+     variables.  These are released when the expansion completes.
+     */
+    MAKE_ARENA ExpansionArena;
+
+    /**
+     An arena used for strings that are retained until the program exits,
+     such as the commands to execute for each target.
+     */
+    MAKE_ARENA StringArena;
+
+    /**
+     A hash table of scopes whose key is their directory.
+     */
+    PYORI_HASH_TABLE Scopes;
+
+    /**
+     A list of known scopes, used to facilitate bulk delete.
+     */
+    YORI_LIST_ENTRY ScopesList;
 
     /**
      A list of inline files created, used to allow them to be deleted on
@@ -675,6 +1160,34 @@ typedef struct _MAKE_CONTEXT {
      */
     YORI_LIST_ENTRY TargetsList;
 
+    /**
+     A hash table of directories containing targets, used to determine file
+     existence and timestamps while evaluating dependencies.  This is NULL
+     when not evaluating dependencies.
+     */
+    PYORI_HASH_TABLE DirectoryCache;
+
+    /**
+     A list of directories in the directory cache, used to facilitate bulk
+     delete.
+     */
+    YORI_LIST_ENTRY DirectoryCacheList;
+
+    /**
+     A hash table of directories containing files probed while searching
+     for inference rules.  A directory is enumerated once enough files
+     within it have been probed, so later probes are answered without
+     querying the file system.  This is discarded whenever a preprocessor
+     command executes, since the command may create files.
+     */
+    PYORI_HASH_TABLE InferenceProbeCache;
+
+    /**
+     A list of directories in the inference probe cache, used to facilitate
+     bulk delete.
+     */
+    YORI_LIST_ENTRY InferenceProbeCacheList;
+
     /**
      A list of targets that have finished being built.
      */
@@ -707,6 +1220,141 @@ typedef struct _MAKE_CONTEXT {
      */
     YORI_LIST_ENTRY PreprocessorCacheList;
 
+    /**
+     A hash table of recipe durations from previous executions, or NULL if
+     recipe history is not being recorded.
+     */
+    PYORI_HASH_TABLE RecipeHistory;
+
+    /**
+     A list of recipe history entries, used to facilitate bulk delete.
+     */
+    YORI_LIST_ENTRY RecipeHistoryList;
+
+    /**
+     The duration in milliseconds to assume for a recipe that has no
+     history.  This is the average of all durations in the history.
+     */
+    DWORD DefaultRecipeDuration;
+
+    /**
+     A hash table of target digests from previous executions, or NULL if
+     rebuild decisions are based on timestamps only.
+     */
+    PYORI_HASH_TABLE DigestTable;
+
+    /**
+     A list of target digest entries, used to facilitate bulk delete.
+     */
+    YORI_LIST_ENTRY DigestList;
+
+    /**
+     The CryptoAPI provider used to calculate digests.  This is only
+     meaningful if DigestTable is not NULL.
+     */
+    DWORD_PTR DigestProvider;
+
+    /**
+     The number of targets that appeared out of date based on timestamps
+     but were not rebuilt because their inputs were unchanged.
+     */
+    DWORD TargetsSkippedByDigest;
+
+    /**
+     The program to invoke to execute commands for remote eligible targets
+     on a remote worker.  If empty, all commands are executed locally.
+     */
+    YORI_STRING RemoteLauncher;
+
+    /**
+     The number of targets whose recipes were executed via the remote
+     launcher.
+     */
+    DWORD TargetsLaunchedRemotely;
+
+    /**
+     A list of makefiles processed while parsing, used to validate a parsed
+     makefile cache.  Paired with MAKE_GRAPH_CACHE_FILE::ListEntry.
+     */
+    YORI_LIST_ENTRY GraphCacheFileList;
+
+    /**
+     A hash of the variables defined before any makefile is parsed, which
+     includes any variables specified on the command line.  A parsed
+     makefile cache is only used if this matches.
+     */
+    DWORD GraphCacheVarHash;
+
+    /**
+     A handle to a file recording a trace of the build, or NULL if no trace
+     is being recorded.
+     */
+    HANDLE TraceHandle;
+
+    /**
+     The performance counter value when the trace was opened.  Events in
+     the trace are relative to this time.
+     */
+    LARGE_INTEGER TraceStartTime;
+
+    /**
+     The performance counter frequency, used to convert times in the trace
+     to microseconds.
+     */
+    LARGE_INTEGER TraceFrequency;
+
+    /**
+     The makefile stream currently being processed.
+     */
+    PMAKE_PREPROC_STREAM ActiveStream;
+
+    /**
+     A hash table of preprocessor commands executing speculatively, or NULL
+     if no commands have been executed speculatively.
+     */
+    PYORI_HASH_TABLE SpeculationTable;
+
+    /**
+     A list of all speculative preprocessor commands.  Paired with
+     MAKE_PREPROC_SPECULATION::ListEntry.
+     */
+    YORI_LIST_ENTRY SpeculationList;
+
+    /**
+     A list of speculative preprocessor commands that have not yet been
+     started.  Paired with MAKE_PREPROC_SPECULATION::PendingListEntry.
+     */
+    YORI_LIST_ENTRY SpeculationPendingList;
+
+    /**
+     A mutex protecting SpeculationPendingList and
+     MAKE_PREPROC_SPECULATION::Started.
+     */
+    HANDLE SpeculationMutex;
+
+    /**
+     A semaphore signalled once for each command added to
+     SpeculationPendingList, and used to wake worker threads.
+     */
+    HANDLE SpeculationSemaphore;
+
+    /**
+     An array of worker threads executing speculative preprocessor commands.
+     */
+    PHANDLE SpeculationThreads;
+
+    /**
+     The number of elements in SpeculationThreads.
+     */
+    DWORD SpeculationThreadCount;
+
+    /**
+     A space delimited list of programs listed in a .SPECULATE pseudo
+     target.  Preprocessor commands are only executed speculatively if
+     every program they invoke is in this list.
+     */
+    YORI_STRING SpeculationPrograms;
+
     /**
      Allocations used to generate files to look for when determining which
      inference rules to apply.  Because these are very temporary, they are
@@ -758,6 +1406,85 @@ typedef struct _MAKE_CONTEXT {
      */
     DWORDLONG TimeInCleanup;
 
+    /**
+     The time spent preprocessing makefiles reached via !INCLUDE, including
+     any makefiles they include.
+     */
+    DWORDLONG TimeInInclude;
+
+    /**
+     The time spent searching for inference rules for targets without an
+     explicit recipe.
+     */
+    DWORDLONG TimeInInferenceRules;
+
+    /**
+     The time spent launching child processes for recipes, from the point
+     the command is ready to execute until the process has been created.
+     */
+    DWORDLONG TimeLaunchingProcesses;
+
+    /**
+     The elapsed time spent waiting for a child process while at least one
+     job slot was not executing anything.
+     */
+    DWORDLONG TimeWithIdleSlots;
+
+    /**
+     The time that job slots were idle while waiting for a child process,
+     summed across all idle slots.  This is the capacity that was available
+     but could not be used due to dependencies.
+     */
+    DWORDLONG IdleSlotTime;
+
+    /**
+     A list of makefiles that have been preprocessed, recorded when
+     PerfDisplay is TRUE.  Paired with MAKE_PERF_MAKEFILE::ListEntry.
+     */
+    YORI_LIST_ENTRY PerfMakefileList;
+
+    /**
+     The number of makefiles that have been preprocessed.
+     */
+    DWORD MakefilesProcessed;
+
+    /**
+     The number of physical lines read from all makefiles.
+     */
+    DWORD LinesProcessed;
+
+    /**
+     The number of nested !INCLUDE directives currently being processed.
+     This is used to avoid counting time in nested includes twice.
+     */
+    DWORD IncludeDepth;
+
+    /**
+     The number of targets for which an inference rule was searched.
+     */
+    DWORD InferenceRuleSearches;
+
+    /**
+     The number of files probed to determine whether an inference rule
+     applies.
+     */
+    DWORD InferenceRuleProbes;
+
+    /**
+     The number of strings that have had variables expanded.
+     */
+    DWORD VariableExpansions;
+
+    /**
+     The number of variable references encountered while expanding strings.
+     */
+    DWORD VariableReferences;
+
+    /**
+     The number of child processes launched for recipes.
+     */
+    DWORD ProcessesLaunched;
+
     /**
      The number of inference rule allocations.
      */
@@ -795,6 +1522,34 @@ typedef struct _MAKE_CONTEXT {
      */
     YORI_ALLOC_SIZE_T NumberProcesses;
 
+    /**
+     The number of remote launchers to execute concurrently, in addition to
+     NumberProcesses.  This is zero if no remote launcher is specified.  The
+     sum of this and NumberProcesses is limited to 64 due to
+     WaitForMultipleObjects.
+     */
+    YORI_ALLOC_SIZE_T NumberRemoteProcesses;
+
+    /**
+     A job server shared with parent and child processes that limits the
+     total number of concurrent processes, or NULL if there is none.
+     */
+    HANDLE JobServer;
+
+    /**
+     State used to distribute child processes across NUMA nodes and
+     processor groups.  Without this, children on a system with more than
+     one processor group are likely to all execute within a single group.
+     */
+    YORI_LIB_PROCESSOR_PLACEMENT ProcessorPlacement;
+
+    /**
+     The number of tokens currently acquired from JobServer.  Executing one
+     local process requires no token, and each additional local process
+     requires one.
+     */
+    DWORD JobServerTokensHeld;
+
     /**
      The 32 bit hash of the environment block. This process does not modify
      its own environment, so this can be calculated once for the lifetime
@@ -836,6 +1591,42 @@ typedef struct _MAKE_CONTEXT {
      */
     BOOLEAN WarnOnUndefinedVariable;
 
+    /**
+     TRUE if ready targets are ordered by their critical path cost.  If
+     FALSE, ready targets are executed in the order they become ready.
+     */
+    BOOLEAN PrioritizeTargets;
+
+    /**
+     TRUE if an event has been written to the trace, so later events need
+     to be preceded by a seperator.
+     */
+    BOOLEAN TraceEventWritten;
+
+    /**
+     TRUE if speculative preprocessor worker threads should terminate.
+     Protected by SpeculationMutex.
+     */
+    BOOLEAN SpeculationTerminate;
+
+    /**
+     TRUE if an attempt to create speculative preprocessor worker threads
+     has been made.
+     */
+    BOOLEAN SpeculationInitialized;
+
+    /**
+     TRUE if the parsed makefile graph should be loaded from a cache when
+     no makefile has changed, and saved to the cache after parsing.
+     */
+    BOOLEAN GraphCacheEnabled;
+
+    /**
+     TRUE if the parsed makefile graph cannot be saved because a makefile
+     could not be recorded.
+     */
+    BOOLEAN GraphCacheIncomplete;
+
 } MAKE_CONTEXT, *PMAKE_CONTEXT;
 
 // *** ALLOC.C ***
@@ -856,6 +1647,37 @@ MakeSlabCleanup(
     __in PMAKE_SLAB_ALLOC Alloc
     );
 
+PVOID
+MakeArenaAlloc(
+    __in PMAKE_ARENA Arena,
+    __in YORI_ALLOC_SIZE_T SizeInBytes
+    );
+
+__success(return)
+BOOLEAN
+MakeArenaAllocateString(
+    __in PMAKE_ARENA Arena,
+    __out PYORI_STRING String,
+    __in YORI_ALLOC_SIZE_T CharsToAllocate
+    );
+
+VOID
+MakeArenaGetMark(
+    __in PMAKE_ARENA Arena,
+    __out PMAKE_ARENA_MARK Mark
+    );
+
+VOID
+MakeArenaResetToMark(
+    __in PMAKE_ARENA Arena,
+    __in PMAKE_ARENA_MARK Mark
+    );
+
+VOID
+MakeArenaCleanup(
+    __in PMAKE_ARENA Arena
+    );
+
 // *** VAR.C ***
 
 BOOLEAN
@@ -914,6 +1736,13 @@ MakeShExecExecPlan(
 
 // *** PREPROC.C ***
 
+__success(return)
+BOOLEAN
+MakeGetEnvironmentHash(
+    __inout PMAKE_CONTEXT MakeContext,
+    __out PDWORD EnvHash
+    );
+
 VOID
 MakeTrimWhitespace(
     __in PYORI_STRING String
@@ -933,6 +1762,18 @@ MakeProcessStream(
     __in PYORI_STRING FileName
     );
 
+__success(return)
+BOOLEAN
+MakeAddSpeculationPrograms(
+    __in PMAKE_CONTEXT MakeContext,
+    __in PYORI_STRING ProgramList
+    );
+
+VOID
+MakeCleanupPreprocessorSpeculation(
+    __inout PMAKE_CONTEXT MakeContext
+    );
+
 VOID
 MakeLoadPreprocessorCacheEntries(
     __inout PMAKE_CONTEXT MakeContext,
@@ -993,11 +1834,43 @@ MakeDeleteAllTargets(
     __inout PMAKE_CONTEXT MakeContext
     );
 
+VOID
+MakePopulateDirectoryCache(
+    __inout PMAKE_CONTEXT MakeContext
+    );
+
+VOID
+MakeDeleteDirectoryCache(
+    __inout PMAKE_CONTEXT MakeContext
+    );
+
+VOID
+MakeDeleteInferenceProbeCache(
+    __inout PMAKE_CONTEXT MakeContext
+    );
+
 VOID
 MakeDeactivateAllInferenceRules(
     __in PMAKE_SCOPE_CONTEXT ScopeContext
     );
 
+VOID
+MakeDeleteInferenceRuleExtensions(
+    __in PMAKE_SCOPE_CONTEXT ScopeContext
+    );
+
+BOOLEAN
+MakeActivateInferenceRule(
+    __in PMAKE_SCOPE_CONTEXT ScopeContext,
+    __in PMAKE_INFERENCE_RULE InferenceRule,
+    __in BOOLEAN Append
+    );
+
+VOID
+MakeDeactivateInferenceRule(
+    __in PMAKE_INFERENCE_RULE InferenceRule
+    );
+
 PMAKE_TARGET
 MakeLookupTarget(
     __in PMAKE_SCOPE_CONTEXT ScopeContext,
@@ -1021,6 +1894,16 @@ MakeCreateInferenceRule(
     __in PMAKE_TARGET Target
     );
 
+VOID
+MakeReferenceInferenceRule(
+    __in PMAKE_INFERENCE_RULE InferenceRule
+    );
+
+VOID
+MakeDereferenceInferenceRule(
+    __in PMAKE_INFERENCE_RULE InferenceRule
+    );
+
 VOID
 MakeMarkTargetInferenceRuleNeededIfNeeded(
     __in PMAKE_SCOPE_CONTEXT ScopeContext,
@@ -1070,3 +1953,154 @@ BOOLEAN
 MakeExecuteRequiredTargets(
     __in PMAKE_CONTEXT MakeContext
     );
+
+VOID
+MakeLoadRecipeHistory(
+    __inout PMAKE_CONTEXT MakeContext,
+    __in PYORI_STRING MakeFileName
+    );
+
+VOID
+MakeSaveAndDeleteRecipeHistory(
+    __inout PMAKE_CONTEXT MakeContext,
+    __in PYORI_STRING MakeFileName
+    );
+
+// *** PERF.C ***
+
+VOID
+MakePerfRecordMakefile(
+    __in PMAKE_CONTEXT MakeContext,
+    __in PCYORI_STRING FileName,
+    __in DWORD LineCount,
+    __in DWORDLONG Time
+    );
+
+VOID
+MakePerfDisplay(
+    __in PMAKE_CONTEXT MakeContext
+    );
+
+VOID
+MakePerfCleanup(
+    __in PMAKE_CONTEXT MakeContext
+    );
+
+// *** TRACE.C ***
+
+BOOLEAN
+MakeTraceOpen(
+    __in PMAKE_CONTEXT MakeContext,
+    __in PYORI_STRING FileName
+    );
+
+VOID
+MakeTraceClose(
+    __in PMAKE_CONTEXT MakeContext
+    );
+
+VOID
+MakeTracePhase(
+    __in PMAKE_CONTEXT MakeContext,
+    __in LPCTSTR PhaseName,
+    __in_opt PCYORI_STRING FileName,
+    __in PLARGE_INTEGER StartTime,
+    __in PLARGE_INTEGER EndTime
+    );
+
+VOID
+MakeTraceTargetReady(
+    __in PMAKE_CONTEXT MakeContext,
+    __in PMAKE_TARGET Target
+    );
+
+VOID
+MakeTraceCommand(
+    __in PMAKE_CONTEXT MakeContext,
+    __in PMAKE_TARGET Target,
+    __in PYORI_STRING Cmd,
+    __in DWORD JobId,
+    __in PLARGE_INTEGER StartTime,
+    __in DWORD ExitCode
+    );
+
+VOID
+MakeTraceCounters(
+    __in PMAKE_CONTEXT MakeContext
+    );
+
+// *** GRAPH.C ***
+
+VOID
+MakeGraphCacheRecordMakefile(
+    __inout PMAKE_CONTEXT MakeContext,
+    __in HANDLE hSource,
+    __in PYORI_STRING FileName
+    );
+
+BOOLEAN
+MakeLoadGraphCache(
+    __inout PMAKE_CONTEXT MakeContext,
+    __in PYORI_STRING MakeFileName
+    );
+
+VOID
+MakeSaveGraphCache(
+    __inout PMAKE_CONTEXT MakeContext,
+    __in PYORI_STRING MakeFileName
+    );
+
+VOID
+MakeDeleteGraphCacheFiles(
+    __inout PMAKE_CONTEXT MakeContext
+    );
+
+// *** DIGEST.C ***
+
+VOID
+MakeLoadDigests(
+    __inout PMAKE_CONTEXT MakeContext,
+    __in PYORI_STRING MakeFileName
+    );
+
+VOID
+MakeSaveAndDeleteDigests(
+    __inout PMAKE_CONTEXT MakeContext,
+    __in PYORI_STRING MakeFileName
+    );
+
+BOOLEAN
+MakeGetTargetContentDigest(
+    __in PMAKE_CONTEXT MakeContext,
+    __in PMAKE_TARGET Target
+    );
+
+BOOLEAN
+MakeIsTargetCurrentByDigest(
+    __in PMAKE_CONTEXT MakeContext,
+    __in PMAKE_TARGET Target
+    );
+
+VOID
+MakeRecordTargetDigest(
+    __in PMAKE_CONTEXT MakeContext,
+    __in PMAKE_TARGET Target
+    );
+
+// *** REMOTE.C ***
+
+__success(return)
+BOOLEAN
+MakeMarkRemoteTargets(
+    __in PMAKE_SCOPE_CONTEXT ScopeContext,
+    __in PYORI_STRING TargetList
+    );
+
+__success(return)
+BOOLEAN
+MakeBuildCmdContextForRemoteLaunch(
+    __in PMAKE_CONTEXT MakeContext,
+    __out PYORI_LIBSH_CMD_CONTEXT CmdContext,
+    __in PYORI_STRING CurrentDirectory,
+    __in PYORI_STRING CmdLine
+    );
@@ -0,0 +1,224 @@
+/**
+ * @file make/perf.c
+ *
+ * Yori shell make performance counter reporting
+ *
+ * Copyright (c) 2026 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <yoripch.h>
+#include <yorilib.h>
+#include <yorish.h>
+#include "make.h"
+
+/**
+ The number of makefiles to display when reporting the makefiles which took
+ the longest to preprocess.
+ */
+#define MAKE_PERF_MAKEFILES_DISPLAYED (10)
+
+/**
+ Record the time taken to preprocess a single makefile.  This is only
+ retained if performance information will be displayed.
+
+ @param MakeContext Pointer to the context.
+
+ @param FileName Pointer to the name of the makefile.
+
+ @param LineCount The number of physical lines in the makefile.
+
+ @param Time The time spent preprocessing the makefile, excluding any
+        makefiles it includes, in performance counter units.
+ */
+VOID
+MakePerfRecordMakefile(
+    __in PMAKE_CONTEXT MakeContext,
+    __in PCYORI_STRING FileName,
+    __in DWORD LineCount,
+    __in DWORDLONG Time
+    )
+{
+    PMAKE_PERF_MAKEFILE PerfMakefile;
+
+    MakeContext->MakefilesProcessed++;
+    MakeContext->LinesProcessed = MakeContext->LinesProcessed + LineCount;
+
+    if (!MakeContext->PerfDisplay) {
+        return;
+    }
+
+    PerfMakefile = YoriLibMalloc(sizeof(MAKE_PERF_MAKEFILE));
+    if (PerfMakefile == NULL) {
+        return;
+    }
+
+    if (!YoriLibCopyString(&PerfMakefile->FileName, FileName)) {
+        YoriLibFree(PerfMakefile);
+        return;
+    }
+
+    PerfMakefile->Time = Time;
+    PerfMakefile->LineCount = LineCount;
+    YoriLibAppendList(&MakeContext->PerfMakefileList, &PerfMakefile->ListEntry);
+}
+
+/**
+ Convert a time in performance counter units into milliseconds.
+
+ @param Time The time in performance counter units.
+
+ @param Frequency The performance counter frequency.
+
+ @return The time in milliseconds.
+ */
+DWORDLONG
+MakePerfToMs(
+    __in DWORDLONG Time,
+    __in DWORDLONG Frequency
+    )
+{
+    return (Time / Frequency) * 1000 + (Time % Frequency) * 1000 / Frequency;
+}
+
+/**
+ Display the makefiles which took the longest to preprocess, most expensive
+ first.  Entries are removed from the list as they are displayed.
+
+ @param MakeContext Pointer to the context.
+
+ @param Frequency The performance counter frequency.
+ */
+VOID
+MakePerfDisplayMakefiles(
+    __in PMAKE_CONTEXT MakeContext,
+    __in DWORDLONG Frequency
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PMAKE_PERF_MAKEFILE PerfMakefile;
+    PMAKE_PERF_MAKEFILE Slowest;
+    DWORD Index;
+
+    if (YoriLibIsListEmpty(&MakeContext->PerfMakefileList)) {
+        return;
+    }
+
+    YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("\nSlowest makefiles to preprocess:\n"));
+    for (Index = 0; Index < MAKE_PERF_MAKEFILES_DISPLAYED; Index++) {
+        Slowest = NULL;
+        ListEntry = YoriLibGetNextListEntry(&MakeContext->PerfMakefileList, NULL);
+        while (ListEntry != NULL) {
+            PerfMakefile = CONTAINING_RECORD(ListEntry, MAKE_PERF_MAKEFILE, ListEntry);
+            if (Slowest == NULL || PerfMakefile->Time > Slowest->Time) {
+                Slowest = PerfMakefile;
+            }
+            ListEntry = YoriLibGetNextListEntry(&MakeContext->PerfMakefileList, ListEntry);
+        }
+
+        if (Slowest == NULL) {
+            break;
+        }
+
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%8lli ms %8i lines  %y\n"), MakePerfToMs(Slowest->Time, Frequency), Slowest->LineCount, &Slowest->FileName);
+        YoriLibRemoveListItem(&Slowest->ListEntry);
+        YoriLibFreeStringContents(&Slowest->FileName);
+        YoriLibFree(Slowest);
+    }
+}
+
+/**
+ Display the time spent in each phase of the build, and counters describing
+ the work performed in each phase.
+
+ @param MakeContext Pointer to the context.
+ */
+VOID
+MakePerfDisplay(
+    __in PMAKE_CONTEXT MakeContext
+    )
+{
+    LARGE_INTEGER Frequency;
+    DWORDLONG Freq;
+    DWORDLONG TimeInPreprocessor;
+
+    QueryPerformanceFrequency(&Frequency);
+    Freq = (DWORDLONG)Frequency.QuadPart;
+
+    TimeInPreprocessor = MakeContext->TimeInPreprocessor - MakeContext->TimeInPreprocessorCreateProcess;
+
+    YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("\n"));
+    YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Time in preprocessor child processes: %lli ms\n"), MakePerfToMs(MakeContext->TimeInPreprocessorCreateProcess, Freq));
+    YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Time in preprocessor: %lli ms\n"), MakePerfToMs(TimeInPreprocessor, Freq));
+    YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Time in included makefiles: %lli ms\n"), MakePerfToMs(MakeContext->TimeInInclude, Freq));
+    YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Time matching inference rules: %lli ms\n"), MakePerfToMs(MakeContext->TimeInInferenceRules, Freq));
+    YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Time building graph: %lli ms\n"), MakePerfToMs(MakeContext->TimeBuildingGraph, Freq));
+    YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Time executing commands: %lli ms\n"), MakePerfToMs(MakeContext->TimeInExecute, Freq));
+    YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Time launching processes: %lli ms\n"), MakePerfToMs(MakeContext->TimeLaunchingProcesses, Freq));
+    YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Time with idle job slots: %lli ms\n"), MakePerfToMs(MakeContext->TimeWithIdleSlots, Freq));
+    YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Idle job slot time: %lli ms\n"), MakePerfToMs(MakeContext->IdleSlotTime, Freq));
+    YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Time cleaning up: %lli ms\n"), MakePerfToMs(MakeContext->TimeInCleanup, Freq));
+
+    YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("\n"));
+    YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Makefiles preprocessed: %i (%i lines)\n"), MakeContext->MakefilesProcessed, MakeContext->LinesProcessed);
+    YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Variable expansions: %i (%i variable references)\n"), MakeContext->VariableExpansions, MakeContext->VariableReferences);
+    YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Inference rule searches: %i (%i files probed)\n"), MakeContext->InferenceRuleSearches, MakeContext->InferenceRuleProbes);
+    YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Processes launched: %i\n"), MakeContext->ProcessesLaunched);
+    YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Heap allocations avoided by arenas: %i\n"), MakeContext->ExpansionArena.NumberAllocations + MakeContext->StringArena.NumberAllocations);
+    if (MakeContext->TargetsSkippedByDigest > 0) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Targets with unchanged content: %i\n"), MakeContext->TargetsSkippedByDigest);
+    }
+    if (MakeContext->TargetsLaunchedRemotely > 0) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Targets launched remotely: %i\n"), MakeContext->TargetsLaunchedRemotely);
+    }
+    YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Number dependency allocs: %i\n"), MakeContext->AllocDependency);
+    YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Number inference rule allocs: %i\n"), MakeContext->AllocInferenceRule);
+    YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Number target allocs: %i\n"), MakeContext->AllocTarget);
+    YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Number variable allocs: %i\n"), MakeContext->AllocVariable);
+    YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Number variable data allocs: %i\n"), MakeContext->AllocVariableData);
+    YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Number expanded line allocs: %i\n"), MakeContext->AllocExpandedLine);
+
+    MakePerfDisplayMakefiles(MakeContext, Freq);
+}
+
+/**
+ Free any makefile performance records.
+
+ @param MakeContext Pointer to the context.
+ */
+VOID
+MakePerfCleanup(
+    __in PMAKE_CONTEXT MakeContext
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PMAKE_PERF_MAKEFILE PerfMakefile;
+
+    ListEntry = YoriLibGetNextListEntry(&MakeContext->PerfMakefileList, NULL);
+    while (ListEntry != NULL) {
+        PerfMakefile = CONTAINING_RECORD(ListEntry, MAKE_PERF_MAKEFILE, ListEntry);
+        ListEntry = YoriLibGetNextListEntry(&MakeContext->PerfMakefileList, ListEntry);
+        YoriLibRemoveListItem(&PerfMakefile->ListEntry);
+        YoriLibFreeStringContents(&PerfMakefile->FileName);
+        YoriLibFree(PerfMakefile);
+    }
+}
+
+// vim:sw=4:ts=4:et:
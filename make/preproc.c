@@ -858,169 +858,1145 @@ MakeSaveAndDeleteAllPreprocessorCacheEntries(
     }
 }
 
+/**
+ Return a hash of the environment block of this process.  The hash is
+ calculated on first use and retained, since this process does not modify
+ its own environment.
+
+ @param MakeContext Pointer to the context.
+
+ @param EnvHash On successful completion, updated to contain the hash of the
+        environment block.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+MakeGetEnvironmentHash(
+    __inout PMAKE_CONTEXT MakeContext,
+    __out PDWORD EnvHash
+    )
+{
+    YORI_STRING Env;
+
+    if (!MakeContext->EnvHashCalculated) {
+        if (!YoriLibGetEnvironmentStrings(&Env)) {
+            return FALSE;
+        }
+
+        MakeContext->EnvHash = YoriLibHashString32(0, &Env);
+        MakeContext->EnvHashCalculated = TRUE;
+
+        YoriLibFreeStringContents(&Env);
+    }
+
+    *EnvHash = MakeContext->EnvHash;
+    return TRUE;
+}
+
 /**
  Given a command and a point in time in execution, calculate the cache key
  for the command.  The key consists of a hash of the environment, a hash of
  all makefile variables at this point in execution, and the command itself.
 
- @param ScopeContext Pointer to the scope context containing all currently
-        in scope variables.
+ @param ScopeContext Pointer to the scope context containing all currently
+        in scope variables.
+
+ @param Cmd Pointer to the command to execute.
+
+ @param Key On successful completion, updated to contain a newly allocated
+        string containing the key.  The caller is expected to free this
+        with YoriLibFreeStringContents.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+MakeBuildKeyForCacheCmd(
+    __in PMAKE_SCOPE_CONTEXT ScopeContext,
+    __in PYORI_STRING Cmd,
+    __out PYORI_STRING Key
+    )
+{
+    YORI_STRING Substring;
+    PMAKE_CONTEXT MakeContext;
+    DWORD EnvHash;
+    DWORD VarHash;
+
+    MakeContext = ScopeContext->MakeContext;
+
+    if (!MakeGetEnvironmentHash(MakeContext, &EnvHash)) {
+        return FALSE;
+    }
+
+    VarHash = MakeHashAllVariables(ScopeContext);
+
+    if (!YoriLibAllocateString(Key, (sizeof(EnvHash) + sizeof(VarHash)) * 2 + Cmd->LengthInChars + 1)) {
+        return FALSE;
+    }
+
+    YoriLibInitEmptyString(&Substring);
+    Substring.StartOfString = Key->StartOfString;
+    Substring.LengthAllocated = Key->LengthAllocated;
+    YoriLibHexBufferToString((PUCHAR)&EnvHash, sizeof(EnvHash), &Substring);
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1500)
+
+    //
+    //  "Potential" mismatch between sizeof and countof.  I meant sizeof.
+    //
+
+#pragma warning(push)
+#pragma warning(disable: 6305)
+#endif
+
+    Substring.StartOfString = Substring.StartOfString + sizeof(EnvHash) * 2;
+    Substring.LengthInChars = Substring.LengthInChars - sizeof(EnvHash) * 2;
+
+    YoriLibHexBufferToString((PUCHAR)&VarHash, sizeof(VarHash), &Substring);
+
+    Substring.StartOfString = Substring.StartOfString + sizeof(VarHash) * 2;
+    Substring.LengthInChars = Substring.LengthInChars - sizeof(VarHash) * 2;
+
+    memcpy(Substring.StartOfString, Cmd->StartOfString, Cmd->LengthInChars * sizeof(TCHAR));
+    Key->LengthInChars = (sizeof(EnvHash) + sizeof(VarHash)) * 2 + Cmd->LengthInChars;
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1500)
+#pragma warning(pop)
+#endif
+
+    return TRUE;
+}
+
+/**
+ Look for a matching entry in the cache for the specified preprocessor
+ command.
+
+ @param ScopeContext Pointer to the scope context.
+
+ @param Cmd Pointer to the command to execute.
+
+ @return Pointer to the cache entry if one was found, or NULL if no match
+         was found.
+ */
+PMAKE_PREPROC_EXEC_CACHE_ENTRY
+MakeLookupPreprocessorCache(
+    __in PMAKE_SCOPE_CONTEXT ScopeContext,
+    __in PYORI_STRING Cmd
+    )
+{
+    PYORI_HASH_ENTRY HashEntry;
+    PMAKE_PREPROC_EXEC_CACHE_ENTRY Entry;
+    YORI_STRING Key;
+
+    if (!MakeBuildKeyForCacheCmd(ScopeContext, Cmd, &Key)) {
+        return NULL;
+    }
+
+    HashEntry = YoriLibHashLookupByKey(ScopeContext->MakeContext->PreprocessorCache, &Key);
+    YoriLibFreeStringContents(&Key);
+    if (HashEntry == NULL) {
+        return NULL;
+    }
+
+    Entry = CONTAINING_RECORD(HashEntry, MAKE_PREPROC_EXEC_CACHE_ENTRY, HashEntry);
+    return Entry;
+}
+
+/**
+ Add an entry to the preprocessor cache.  This occurs after the child process
+ has completed to record its result.
+
+ @param ScopeContext Pointer to the scope context.
+
+ @param Cmd Pointer to the command string.
+
+ @param ExitCode Indicates the result of the command.
+ */
+VOID
+MakeAddToPreprocessorCache(
+    __in PMAKE_SCOPE_CONTEXT ScopeContext,
+    __in PYORI_STRING Cmd,
+    __in DWORD ExitCode
+    )
+{
+    PMAKE_PREPROC_EXEC_CACHE_ENTRY Entry;
+    PYORI_HASH_ENTRY HashEntry;
+    YORI_STRING Key;
+
+    if (!MakeBuildKeyForCacheCmd(ScopeContext, Cmd, &Key)) {
+        return;
+    }
+
+    HashEntry = YoriLibHashLookupByKey(ScopeContext->MakeContext->PreprocessorCache, &Key);
+    if (HashEntry != NULL) {
+        YoriLibFreeStringContents(&Key);
+        return;
+    }
+
+    Entry = YoriLibMalloc(sizeof(MAKE_PREPROC_EXEC_CACHE_ENTRY));
+    if (Entry == NULL) {
+        YoriLibFreeStringContents(&Key);
+        return;
+    }
+
+    ZeroMemory(Entry, sizeof(MAKE_PREPROC_EXEC_CACHE_ENTRY));
+    Entry->ExitCode = ExitCode;
+
+    YoriLibHashInsertByKey(ScopeContext->MakeContext->PreprocessorCache, &Key, Entry, &Entry->HashEntry);
+
+    YoriLibAppendList(&ScopeContext->MakeContext->PreprocessorCacheList, &Entry->ListEntry);
+    YoriLibFreeStringContents(&Key);
+}
+
+/**
+ Add programs listed in a .SPECULATE pseudo target to the set of programs
+ whose preprocessor commands can be executed speculatively.  Whether a
+ program alters state cannot be determined by looking at the command, so
+ the makefile author must list programs that are only used to probe state.
+
+ @param MakeContext Pointer to the make context.
+
+ @param ProgramList Pointer to a string containing whitespace delimited
+        program names, each of which may be quoted.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+MakeAddSpeculationPrograms(
+    __in PMAKE_CONTEXT MakeContext,
+    __in PYORI_STRING ProgramList
+    )
+{
+    YORI_STRING ProgramName;
+    YORI_STRING NewPrograms;
+    YORI_ALLOC_SIZE_T ReadIndex;
+    YORI_ALLOC_SIZE_T StartIndex;
+    BOOLEAN QuoteOpen;
+
+    ReadIndex = 0;
+    while (ReadIndex < ProgramList->LengthInChars) {
+
+        if (MakeIsCharWhitespace(ProgramList->StartOfString[ReadIndex])) {
+            ReadIndex++;
+            continue;
+        }
+
+        StartIndex = ReadIndex;
+        QuoteOpen = FALSE;
+        for (; ReadIndex < ProgramList->LengthInChars; ReadIndex++) {
+            if (ProgramList->StartOfString[ReadIndex] == '"') {
+                QuoteOpen = (BOOLEAN)!QuoteOpen;
+            } else if (!QuoteOpen &&
+                       MakeIsCharWhitespace(ProgramList->StartOfString[ReadIndex])) {
+                break;
+            }
+        }
+
+        YoriLibInitEmptyString(&ProgramName);
+        ProgramName.StartOfString = &ProgramList->StartOfString[StartIndex];
+        ProgramName.LengthInChars = ReadIndex - StartIndex;
+
+        if (ProgramName.LengthInChars >= 3 &&
+            ProgramName.StartOfString[0] == '"' &&
+            ProgramName.StartOfString[ProgramName.LengthInChars - 1] == '"') {
+
+            ProgramName.StartOfString++;
+            ProgramName.LengthInChars = ProgramName.LengthInChars - 2;
+        }
+
+        //
+        //  Names are stored delimited by semicolons, which cannot be part
+        //  of a program name that is invoked without quotes.
+        //
+
+        YoriLibInitEmptyString(&NewPrograms);
+        if (MakeContext->SpeculationPrograms.LengthInChars > 0) {
+            YoriLibYPrintf(&NewPrograms, _T("%y;%y"), &MakeContext->SpeculationPrograms, &ProgramName);
+        } else {
+            YoriLibYPrintf(&NewPrograms, _T("%y"), &ProgramName);
+        }
+
+        if (NewPrograms.StartOfString == NULL) {
+            return FALSE;
+        }
+
+        YoriLibFreeStringContents(&MakeContext->SpeculationPrograms);
+        memcpy(&MakeContext->SpeculationPrograms, &NewPrograms, sizeof(YORI_STRING));
+    }
+
+    return TRUE;
+}
+
+/**
+ Return TRUE if a program was listed in a .SPECULATE pseudo target.  The
+ program may be invoked by full path and with or without an extension, so
+ the comparison is against the final path component, with and without its
+ extension.
+
+ @param MakeContext Pointer to the make context.
+
+ @param Program Pointer to the program name as it is invoked.
+
+ @return TRUE if the program can be executed speculatively, FALSE if it
+         cannot.
+ */
+BOOLEAN
+MakeIsProgramAllowedToSpeculate(
+    __in PMAKE_CONTEXT MakeContext,
+    __in PYORI_STRING Program
+    )
+{
+    YORI_STRING BaseName;
+    YORI_STRING BaseNameNoExt;
+    YORI_STRING Entry;
+    YORI_ALLOC_SIZE_T Index;
+    YORI_ALLOC_SIZE_T StartIndex;
+    LPTSTR Char;
+
+    YoriLibInitEmptyString(&BaseName);
+    BaseName.StartOfString = Program->StartOfString;
+    BaseName.LengthInChars = Program->LengthInChars;
+    for (Index = Program->LengthInChars; Index > 0; Index--) {
+        if (Program->StartOfString[Index - 1] == '\\' ||
+            Program->StartOfString[Index - 1] == '/' ||
+            Program->StartOfString[Index - 1] == ':') {
+
+            BaseName.StartOfString = &Program->StartOfString[Index];
+            BaseName.LengthInChars = Program->LengthInChars - Index;
+            break;
+        }
+    }
+
+    YoriLibInitEmptyString(&BaseNameNoExt);
+    BaseNameNoExt.StartOfString = BaseName.StartOfString;
+    BaseNameNoExt.LengthInChars = BaseName.LengthInChars;
+    Char = YoriLibFindRightMostCharacter(&BaseName, '.');
+    if (Char != NULL) {
+        BaseNameNoExt.LengthInChars = (YORI_ALLOC_SIZE_T)(Char - BaseName.StartOfString);
+    }
+
+    if (BaseName.LengthInChars == 0) {
+        return FALSE;
+    }
+
+    YoriLibInitEmptyString(&Entry);
+    StartIndex = 0;
+    for (Index = 0; Index <= MakeContext->SpeculationPrograms.LengthInChars; Index++) {
+        if (Index < MakeContext->SpeculationPrograms.LengthInChars &&
+            MakeContext->SpeculationPrograms.StartOfString[Index] != ';') {
+
+            continue;
+        }
+
+        Entry.StartOfString = &MakeContext->SpeculationPrograms.StartOfString[StartIndex];
+        Entry.LengthInChars = Index - StartIndex;
+        StartIndex = Index + 1;
+
+        if (YoriLibCompareStringIns(&Entry, &BaseName) == 0 ||
+            YoriLibCompareStringIns(&Entry, &BaseNameNoExt) == 0) {
+
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+/**
+ Return TRUE if a preprocessor command can be executed speculatively, in
+ parallel with other commands and before the preprocessor reaches the line
+ containing it.  Whether a program alters state cannot be inferred from the
+ command line, so every program in the command must be listed in a
+ .SPECULATE pseudo target, and builtin commands are never speculated.  In
+ addition, output must be discarded to NUL so it is not displayed out of
+ order, no input redirection or output redirection to files can occur, and
+ commands cannot be chained conditionally.  This is the form used to probe
+ tools, such as "$(CC) -? 2>&1 | find "/MP" >NUL".  Commands which cannot
+ be speculated are executed in order, and act as a barrier for speculation.
+
+ @param MakeContext Pointer to the make context.
+
+ @param Cmd Pointer to the command, after variable expansion.
+
+ @return TRUE if the command can be executed speculatively, FALSE if it
+         cannot.
+ */
+BOOLEAN
+MakeIsPreprocessorCommandSafeToSpeculate(
+    __in PMAKE_CONTEXT MakeContext,
+    __in PYORI_STRING Cmd
+    )
+{
+    YORI_STRING Remaining;
+    YORI_STRING Target;
+    YORI_LIBSH_CMD_CONTEXT CmdContext;
+    YORI_LIBSH_EXEC_PLAN ExecPlan;
+    PYORI_LIBSH_SINGLE_EXEC_CONTEXT ExecContext;
+    YORI_ALLOC_SIZE_T Index;
+    BOOLEAN QuoteOpen;
+    BOOLEAN StdOutToNul;
+
+    if (MakeContext->SpeculationPrograms.LengthInChars == 0) {
+        return FALSE;
+    }
+
+    QuoteOpen = FALSE;
+    StdOutToNul = FALSE;
+    YoriLibInitEmptyString(&Remaining);
+    YoriLibInitEmptyString(&Target);
+
+    for (Index = 0; Index < Cmd->LengthInChars; Index++) {
+        if (Cmd->StartOfString[Index] == '"') {
+            QuoteOpen = (BOOLEAN)!QuoteOpen;
+            continue;
+        }
+
+        if (QuoteOpen) {
+            continue;
+        }
+
+        if (Cmd->StartOfString[Index] == '<') {
+            return FALSE;
+        }
+
+        if (Cmd->StartOfString[Index] == '&') {
+            return FALSE;
+        }
+
+        if (Cmd->StartOfString[Index] == '|') {
+            if (Index + 1 < Cmd->LengthInChars && Cmd->StartOfString[Index + 1] == '|') {
+                return FALSE;
+            }
+
+            //
+            //  Output from earlier in a pipeline goes to the next program,
+            //  so only the final program's output redirection matters.
+            //
+
+            StdOutToNul = FALSE;
+            continue;
+        }
+
+        if (Cmd->StartOfString[Index] == '>') {
+
+            //
+            //  Look at the target of the redirection, which must be NUL or
+            //  a duplicate of stdout.
+            //
+
+            Remaining.StartOfString = &Cmd->StartOfString[Index + 1];
+            Remaining.LengthInChars = Cmd->LengthInChars - Index - 1;
+            if (Remaining.LengthInChars > 0 && Remaining.StartOfString[0] == '>') {
+                return FALSE;
+            }
+
+            if (Remaining.LengthInChars >= 2 &&
+                Remaining.StartOfString[0] == '&' &&
+                Remaining.StartOfString[1] == '1' &&
+                Index > 0 &&
+                Cmd->StartOfString[Index - 1] == '2') {
+
+                Index = Index + 2;
+                continue;
+            }
+
+            while (Remaining.LengthInChars > 0 && MakeIsCharWhitespace(Remaining.StartOfString[0])) {
+                Remaining.StartOfString++;
+                Remaining.LengthInChars--;
+            }
+
+            Target.StartOfString = Remaining.StartOfString;
+            Target.LengthInChars = 0;
+            while (Target.LengthInChars < Remaining.LengthInChars &&
+                   !MakeIsCharWhitespace(Target.StartOfString[Target.LengthInChars]) &&
+                   Target.StartOfString[Target.LengthInChars] != '|') {
+
+                Target.LengthInChars++;
+            }
+
+            if (YoriLibCompareStringLitIns(&Target, _T("NUL")) != 0) {
+                return FALSE;
+            }
+
+            if (Index == 0 || Cmd->StartOfString[Index - 1] != '2') {
+                StdOutToNul = TRUE;
+            }
+
+            Index = (YORI_ALLOC_SIZE_T)(Target.StartOfString - Cmd->StartOfString) + Target.LengthInChars - 1;
+        }
+    }
+
+    if (!StdOutToNul) {
+        return FALSE;
+    }
+
+    if (!YoriLibShParseCmdlineToCmdContext(Cmd, 0, &CmdContext)) {
+        return FALSE;
+    }
+
+    if (!YoriLibShParseCmdContextToExecPlan(&CmdContext, &ExecPlan, NULL, NULL, NULL, NULL)) {
+        YoriLibShFreeCmdContext(&CmdContext);
+        return FALSE;
+    }
+
+    //
+    //  Builtin commands execute in this process and redirect its standard
+    //  handles, so they cannot execute on another thread.
+    //
+
+    ExecContext = ExecPlan.FirstCmd;
+    while (ExecContext != NULL) {
+        if (ExecContext->CmdToExec.ArgC == 0 ||
+            YoriLibShLookupBuiltinByName(&ExecContext->CmdToExec.ArgV[0]) != NULL ||
+            !MakeIsProgramAllowedToSpeculate(MakeContext, &ExecContext->CmdToExec.ArgV[0])) {
+
+            break;
+        }
+        ExecContext = ExecContext->NextProgram;
+    }
+
+    YoriLibShFreeExecPlan(&ExecPlan);
+    YoriLibShFreeCmdContext(&CmdContext);
+
+    if (ExecContext != NULL) {
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ A worker thread which executes speculative preprocessor commands.
+
+ @param Context Pointer to the make context.
+
+ @return Thread exit code, currently always zero.
+ */
+DWORD WINAPI
+MakePreprocessorSpeculationWorker(
+    __in PVOID Context
+    )
+{
+    PMAKE_CONTEXT MakeContext;
+    PMAKE_PREPROC_SPECULATION Speculation;
+    PYORI_LIST_ENTRY ListEntry;
+
+    MakeContext = (PMAKE_CONTEXT)Context;
+
+    while (TRUE) {
+        WaitForSingleObject(MakeContext->SpeculationSemaphore, INFINITE);
+        WaitForSingleObject(MakeContext->SpeculationMutex, INFINITE);
+        if (MakeContext->SpeculationTerminate) {
+            ReleaseMutex(MakeContext->SpeculationMutex);
+            break;
+        }
+
+        //
+        //  The main thread may have consumed the command already, in which
+        //  case there's nothing to do.
+        //
+
+        ListEntry = YoriLibGetNextListEntry(&MakeContext->SpeculationPendingList, NULL);
+        if (ListEntry == NULL) {
+            ReleaseMutex(MakeContext->SpeculationMutex);
+            continue;
+        }
+
+        Speculation = CONTAINING_RECORD(ListEntry, MAKE_PREPROC_SPECULATION, PendingListEntry);
+        YoriLibRemoveListItem(ListEntry);
+        Speculation->Started = TRUE;
+        ReleaseMutex(MakeContext->SpeculationMutex);
+
+        Speculation->ExitCode = MakeShExecExecPlan(&Speculation->ExecPlan, NULL);
+        SetEvent(Speculation->CompleteEvent);
+    }
+
+    return 0;
+}
+
+/**
+ Create worker threads to execute speculative preprocessor commands.  This
+ uses one fewer thread than the number of child processes requested, since
+ the main thread will also execute commands.
+
+ @param MakeContext Pointer to the make context.
+
+ @return TRUE if worker threads are available, FALSE if they are not.
+ */
+BOOLEAN
+MakeInitializePreprocessorSpeculation(
+    __inout PMAKE_CONTEXT MakeContext
+    )
+{
+    DWORD ThreadCount;
+    DWORD Index;
+    DWORD ThreadId;
+
+    if (MakeContext->SpeculationInitialized) {
+        if (MakeContext->SpeculationThreadCount > 0) {
+            return TRUE;
+        }
+        return FALSE;
+    }
+
+    MakeContext->SpeculationInitialized = TRUE;
+
+    if (MakeContext->NumberProcesses <= 1) {
+        return FALSE;
+    }
+
+    ThreadCount = MakeContext->NumberProcesses - 1;
+
+    MakeContext->SpeculationTable = YoriLibAllocateHashTable(100);
+    if (MakeContext->SpeculationTable == NULL) {
+        return FALSE;
+    }
+
+    MakeContext->SpeculationMutex = CreateMutex(NULL, FALSE, NULL);
+    if (MakeContext->SpeculationMutex == NULL) {
+        return FALSE;
+    }
+
+    MakeContext->SpeculationSemaphore = CreateSemaphore(NULL, 0, 0x7FFFFFFF, NULL);
+    if (MakeContext->SpeculationSemaphore == NULL) {
+        return FALSE;
+    }
+
+    MakeContext->SpeculationThreads = YoriLibMalloc(ThreadCount * sizeof(HANDLE));
+    if (MakeContext->SpeculationThreads == NULL) {
+        return FALSE;
+    }
+
+    for (Index = 0; Index < ThreadCount; Index++) {
+        MakeContext->SpeculationThreads[Index] = CreateThread(NULL, 0, MakePreprocessorSpeculationWorker, MakeContext, 0, &ThreadId);
+        if (MakeContext->SpeculationThreads[Index] == NULL) {
+            break;
+        }
+        MakeContext->SpeculationThreadCount++;
+    }
+
+    if (MakeContext->SpeculationThreadCount == 0) {
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ Stop any speculative commands which have not yet started, and ensure that
+ no speculative results will be used.  This occurs when a command executes
+ which may change the result of later commands.
+
+ @param MakeContext Pointer to the make context.
+ */
+VOID
+MakeDiscardPreprocessorSpeculation(
+    __inout PMAKE_CONTEXT MakeContext
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PMAKE_PREPROC_SPECULATION Speculation;
+
+    if (MakeContext->SpeculationThreadCount == 0) {
+        return;
+    }
+
+    WaitForSingleObject(MakeContext->SpeculationMutex, INFINITE);
+    ListEntry = YoriLibGetNextListEntry(&MakeContext->SpeculationPendingList, NULL);
+    while (ListEntry != NULL) {
+        Speculation = CONTAINING_RECORD(ListEntry, MAKE_PREPROC_SPECULATION, PendingListEntry);
+        YoriLibRemoveListItem(ListEntry);
+        Speculation->Started = TRUE;
+        ListEntry = YoriLibGetNextListEntry(&MakeContext->SpeculationPendingList, NULL);
+    }
+    ReleaseMutex(MakeContext->SpeculationMutex);
+
+    ListEntry = YoriLibGetNextListEntry(&MakeContext->SpeculationList, NULL);
+    while (ListEntry != NULL) {
+        Speculation = CONTAINING_RECORD(ListEntry, MAKE_PREPROC_SPECULATION, ListEntry);
+        if (Speculation->InHashTable) {
+            YoriLibHashRemoveByEntry(&Speculation->HashEntry);
+            Speculation->InHashTable = FALSE;
+        }
+        ListEntry = YoriLibGetNextListEntry(&MakeContext->SpeculationList, ListEntry);
+    }
+}
+
+/**
+ Free a speculative preprocessor command.  The command must not be executing
+ on a worker thread.
+
+ @param Speculation Pointer to the speculative command to free.
+ */
+VOID
+MakeFreePreprocessorSpeculation(
+    __in PMAKE_PREPROC_SPECULATION Speculation
+    )
+{
+    if (Speculation->InHashTable) {
+        YoriLibHashRemoveByEntry(&Speculation->HashEntry);
+        Speculation->InHashTable = FALSE;
+    }
+    YoriLibRemoveListItem(&Speculation->ListEntry);
+    YoriLibShFreeExecPlan(&Speculation->ExecPlan);
+    YoriLibShFreeCmdContext(&Speculation->CmdContext);
+    if (Speculation->CompleteEvent != NULL) {
+        CloseHandle(Speculation->CompleteEvent);
+    }
+    YoriLibFreeStringContents(&Speculation->Cmd);
+    YoriLibFree(Speculation);
+}
+
+/**
+ Terminate all speculative preprocessor worker threads, waiting for any
+ executing commands to complete, and free all speculative commands.  This
+ is called once preprocessing is complete.
+
+ @param MakeContext Pointer to the make context.
+ */
+VOID
+MakeCleanupPreprocessorSpeculation(
+    __inout PMAKE_CONTEXT MakeContext
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PMAKE_PREPROC_SPECULATION Speculation;
+    DWORD Index;
+
+    if (MakeContext->SpeculationThreadCount > 0) {
+        MakeDiscardPreprocessorSpeculation(MakeContext);
+
+        WaitForSingleObject(MakeContext->SpeculationMutex, INFINITE);
+        MakeContext->SpeculationTerminate = TRUE;
+        ReleaseMutex(MakeContext->SpeculationMutex);
+        ReleaseSemaphore(MakeContext->SpeculationSemaphore, (LONG)MakeContext->SpeculationThreadCount, NULL);
+
+        for (Index = 0; Index < MakeContext->SpeculationThreadCount; Index++) {
+            WaitForSingleObject(MakeContext->SpeculationThreads[Index], INFINITE);
+            CloseHandle(MakeContext->SpeculationThreads[Index]);
+        }
+        MakeContext->SpeculationThreadCount = 0;
+    }
+
+    ListEntry = YoriLibGetNextListEntry(&MakeContext->SpeculationList, NULL);
+    while (ListEntry != NULL) {
+        Speculation = CONTAINING_RECORD(ListEntry, MAKE_PREPROC_SPECULATION, ListEntry);
+        MakeFreePreprocessorSpeculation(Speculation);
+        ListEntry = YoriLibGetNextListEntry(&MakeContext->SpeculationList, NULL);
+    }
+
+    if (MakeContext->SpeculationThreads != NULL) {
+        YoriLibFree(MakeContext->SpeculationThreads);
+        MakeContext->SpeculationThreads = NULL;
+    }
+
+    if (MakeContext->SpeculationSemaphore != NULL) {
+        CloseHandle(MakeContext->SpeculationSemaphore);
+        MakeContext->SpeculationSemaphore = NULL;
+    }
+
+    if (MakeContext->SpeculationMutex != NULL) {
+        CloseHandle(MakeContext->SpeculationMutex);
+        MakeContext->SpeculationMutex = NULL;
+    }
+
+    if (MakeContext->SpeculationTable != NULL) {
+        YoriLibFreeEmptyHashTable(MakeContext->SpeculationTable);
+        MakeContext->SpeculationTable = NULL;
+    }
+
+    YoriLibFreeStringContents(&MakeContext->SpeculationPrograms);
+}
+
+/**
+ Queue a preprocessor command for speculative execution on a worker thread.
+ The caller is expected to have checked that the command is safe to execute
+ speculatively.  The command is not queued if it is already queued, or if
+ its result is already known from the preprocessor cache.
+
+ @param ScopeContext Pointer to the scope context.
+
+ @param Cmd Pointer to the command, after variable expansion.
+ */
+VOID
+MakeSpeculatePreprocessorCommand(
+    __in PMAKE_SCOPE_CONTEXT ScopeContext,
+    __in PYORI_STRING Cmd
+    )
+{
+    PMAKE_CONTEXT MakeContext;
+    PMAKE_PREPROC_SPECULATION Speculation;
+
+    MakeContext = ScopeContext->MakeContext;
+
+    if (YoriLibHashLookupByKey(MakeContext->SpeculationTable, Cmd) != NULL) {
+        return;
+    }
+
+    if (MakeContext->PreprocessorCache != NULL &&
+        MakeLookupPreprocessorCache(ScopeContext, Cmd) != NULL) {
+
+        return;
+    }
+
+    Speculation = YoriLibMalloc(sizeof(MAKE_PREPROC_SPECULATION));
+    if (Speculation == NULL) {
+        return;
+    }
+
+    ZeroMemory(Speculation, sizeof(MAKE_PREPROC_SPECULATION));
+
+    if (!YoriLibShParseCmdlineToCmdContext(Cmd, 0, &Speculation->CmdContext)) {
+        YoriLibFree(Speculation);
+        return;
+    }
+
+    if (!YoriLibShParseCmdContextToExecPlan(&Speculation->CmdContext, &Speculation->ExecPlan, NULL, NULL, NULL, NULL)) {
+        YoriLibShFreeCmdContext(&Speculation->CmdContext);
+        YoriLibFree(Speculation);
+        return;
+    }
+
+    if (!YoriLibCopyString(&Speculation->Cmd, Cmd)) {
+
+        YoriLibShFreeExecPlan(&Speculation->ExecPlan);
+        YoriLibShFreeCmdContext(&Speculation->CmdContext);
+        YoriLibFree(Speculation);
+        return;
+    }
+
+    Speculation->CompleteEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+    if (Speculation->CompleteEvent == NULL) {
+        YoriLibInitializeListHead(&Speculation->ListEntry);
+        MakeFreePreprocessorSpeculation(Speculation);
+        return;
+    }
+
+    YoriLibHashInsertByKey(MakeContext->SpeculationTable, &Speculation->Cmd, Speculation, &Speculation->HashEntry);
+    Speculation->InHashTable = TRUE;
+    YoriLibAppendList(&MakeContext->SpeculationList, &Speculation->ListEntry);
+
+    WaitForSingleObject(MakeContext->SpeculationMutex, INFINITE);
+    YoriLibAppendList(&MakeContext->SpeculationPendingList, &Speculation->PendingListEntry);
+    ReleaseMutex(MakeContext->SpeculationMutex);
+
+    ReleaseSemaphore(MakeContext->SpeculationSemaphore, 1, NULL);
+}
+
+/**
+ Look ahead in the makefile stream currently being processed for !IF
+ conditions containing commands that can be executed speculatively, and
+ queue them for execution.  Only conditions that the preprocessor will
+ certainly evaluate are speculated, which are !IF lines that are not within
+ a conditional whose result is not yet known.  The lines following the
+ current command belong to the condition being evaluated, so are skipped
+ along with the body and any !ELSEIF conditions of every later conditional.
+ Variables are expanded based on their current values, so if a variable
+ changes before the line is reached, the speculative result will not match
+ and will not be used.  The scan stops at any command that is not safe to
+ execute speculatively, even in a skipped branch, or at an !INCLUDE, since
+ these may alter the result of later commands.
+
+ @param ScopeContext Pointer to the scope context.
+ */
+VOID
+MakeSpeculateAheadInStream(
+    __in PMAKE_SCOPE_CONTEXT ScopeContext
+    )
+{
+    PMAKE_CONTEXT MakeContext;
+    PMAKE_PREPROC_STREAM Stream;
+    MAKE_PREPROCESSOR_LINE_TYPE PreprocessorLineType;
+    PVOID LineContext;
+    YORI_STRING LineString;
+    YORI_STRING JoinedLine;
+    YORI_STRING LineToProcess;
+    YORI_STRING ExpandedLine;
+    YORI_STRING VariableNotFound;
+    YORI_STRING Cmd;
+    YORI_ALLOC_SIZE_T Index;
+    YORI_ALLOC_SIZE_T CmdStart;
+    LONG SavedPositionHigh;
+    DWORD SavedPositionLow;
+    DWORD LineNumber;
+    DWORD NestingLevel;
+    BOOLEAN MoreLinesNeeded;
+    BOOLEAN BarrierFound;
+    BOOLEAN BranchEnded;
+    BOOLEAN Live;
+
+    MakeContext = ScopeContext->MakeContext;
+    Stream = MakeContext->ActiveStream;
+    if (Stream == NULL) {
+        return;
+    }
+
+    if (GetFileType(Stream->hSource) != FILE_TYPE_DISK) {
+        return;
+    }
+
+    if (!MakeInitializePreprocessorSpeculation(MakeContext)) {
+        return;
+    }
+
+    //
+    //  The stream is being read by the preprocessor, which buffers data
+    //  beyond the current line.  Record the current position, read from the
+    //  beginning, and restore the position when done.
+    //
+
+    SavedPositionHigh = 0;
+    SavedPositionLow = SetFilePointer(Stream->hSource, 0, &SavedPositionHigh, FILE_CURRENT);
+    if (SavedPositionLow == INVALID_SET_FILE_POINTER && GetLastError() != NO_ERROR) {
+        return;
+    }
+
+    if (SetFilePointer(Stream->hSource, 0, NULL, FILE_BEGIN) == INVALID_SET_FILE_POINTER) {
+        return;
+    }
+
+    LineContext = NULL;
+    YoriLibInitEmptyString(&LineString);
+    YoriLibInitEmptyString(&JoinedLine);
+    YoriLibInitEmptyString(&LineToProcess);
+    YoriLibInitEmptyString(&ExpandedLine);
+    YoriLibInitEmptyString(&Cmd);
+    LineNumber = 0;
+    BarrierFound = FALSE;
 
- @param Cmd Pointer to the command to execute.
+    //
+    //  The current line is the !IF or !ELSEIF whose condition is being
+    //  evaluated, so the lines that follow are within a conditional whose
+    //  result is not known.  BranchEnded indicates that the branch
+    //  containing the current line has been completed by an !ELSE or
+    //  !ELSEIF, so the remainder of that conditional is not executed.
+    //
 
- @param Key On successful completion, updated to contain a newly allocated
-        string containing the key.  The caller is expected to free this
-        with YoriLibFreeStringContents.
+    NestingLevel = 1;
+    BranchEnded = FALSE;
 
- @return TRUE to indicate success, FALSE to indicate failure.
- */
-__success(return)
-BOOLEAN
-MakeBuildKeyForCacheCmd(
-    __in PMAKE_SCOPE_CONTEXT ScopeContext,
-    __in PYORI_STRING Cmd,
-    __out PYORI_STRING Key
-    )
-{
-    YORI_STRING Env;
-    YORI_STRING Substring;
-    PMAKE_CONTEXT MakeContext;
-    DWORD EnvHash;
-    DWORD VarHash;
+    while (!BarrierFound) {
 
-    MakeContext = ScopeContext->MakeContext;
+        if (!YoriLibReadLineToString(&LineString, &LineContext, Stream->hSource)) {
+            break;
+        }
+        LineNumber++;
 
-    if (!MakeContext->EnvHashCalculated) {
-        if (!YoriLibGetEnvironmentStrings(&Env)) {
-            return FALSE;
+        if (LineNumber <= Stream->LineNumber) {
+            continue;
         }
 
-        MakeContext->EnvHash = YoriLibHashString32(0, &Env);
-        MakeContext->EnvHashCalculated = TRUE;
+        LineToProcess.StartOfString = LineString.StartOfString;
+        LineToProcess.LengthInChars = LineString.LengthInChars;
+        MakeTruncateComments(&LineToProcess);
 
-        YoriLibFreeStringContents(&Env);
-    }
+        MoreLinesNeeded = FALSE;
 
-    EnvHash = MakeContext->EnvHash;
+        if (LineToProcess.LengthInChars > 0 && LineToProcess.StartOfString[LineToProcess.LengthInChars - 1] == '\\') {
+            MoreLinesNeeded = TRUE;
+        }
 
-    VarHash = MakeHashAllVariables(ScopeContext);
+        if (JoinedLine.LengthInChars > 0 || MoreLinesNeeded) {
+            MakeTrimWhitespace(&LineToProcess);
+            MakeJoinLines(&JoinedLine, &LineToProcess);
+            if (MoreLinesNeeded) {
+                continue;
+            }
+            LineToProcess.StartOfString = JoinedLine.StartOfString;
+            LineToProcess.LengthInChars = JoinedLine.LengthInChars;
+        }
 
-    if (!YoriLibAllocateString(Key, (sizeof(EnvHash) + sizeof(VarHash)) * 2 + Cmd->LengthInChars + 1)) {
-        return FALSE;
-    }
+        MakeTrimWhitespace(&LineToProcess);
 
-    YoriLibInitEmptyString(&Substring);
-    Substring.StartOfString = Key->StartOfString;
-    Substring.LengthAllocated = Key->LengthAllocated;
-    YoriLibHexBufferToString((PUCHAR)&EnvHash, sizeof(EnvHash), &Substring);
+        if (LineToProcess.LengthInChars == 0 || LineToProcess.StartOfString[0] != '!') {
+            JoinedLine.LengthInChars = 0;
+            continue;
+        }
 
-#if defined(_MSC_VER) && (_MSC_VER >= 1500)
+        PreprocessorLineType = MakeDeterminePreprocessorLineType(&LineToProcess, NULL);
+        if (PreprocessorLineType == MakePreprocessorLineTypeInclude) {
+            break;
+        }
 
-    //
-    //  "Potential" mismatch between sizeof and countof.  I meant sizeof.
-    //
+        if (PreprocessorLineType == MakePreprocessorLineTypeIfDef ||
+            PreprocessorLineType == MakePreprocessorLineTypeIfNDef) {
 
-#pragma warning(push)
-#pragma warning(disable: 6305)
-#endif
+            NestingLevel++;
+            JoinedLine.LengthInChars = 0;
+            continue;
+        }
 
-    Substring.StartOfString = Substring.StartOfString + sizeof(EnvHash) * 2;
-    Substring.LengthInChars = Substring.LengthInChars - sizeof(EnvHash) * 2;
+        if (PreprocessorLineType == MakePreprocessorLineTypeElse ||
+            PreprocessorLineType == MakePreprocessorLineTypeElseIfDef ||
+            PreprocessorLineType == MakePreprocessorLineTypeElseIfNDef) {
 
-    YoriLibHexBufferToString((PUCHAR)&VarHash, sizeof(VarHash), &Substring);
+            if (NestingLevel == 0) {
+                BranchEnded = TRUE;
+            }
+            JoinedLine.LengthInChars = 0;
+            continue;
+        }
 
-    Substring.StartOfString = Substring.StartOfString + sizeof(VarHash) * 2;
-    Substring.LengthInChars = Substring.LengthInChars - sizeof(VarHash) * 2;
+        if (PreprocessorLineType == MakePreprocessorLineTypeEndIf) {
+            if (NestingLevel > 0) {
+                NestingLevel--;
+            } else {
+                BranchEnded = FALSE;
+            }
+            JoinedLine.LengthInChars = 0;
+            continue;
+        }
 
-    memcpy(Substring.StartOfString, Cmd->StartOfString, Cmd->LengthInChars * sizeof(TCHAR));
-    Key->LengthInChars = (sizeof(EnvHash) + sizeof(VarHash)) * 2 + Cmd->LengthInChars;
+        //
+        //  An !IF outside of any unresolved conditional will be evaluated,
+        //  but its body depends on the result.  Commands in an !ELSEIF, or
+        //  in an !IF within an unresolved conditional, may never execute,
+        //  so they are only checked for safety.
+        //
 
-#if defined(_MSC_VER) && (_MSC_VER >= 1500)
-#pragma warning(pop)
-#endif
+        Live = FALSE;
+        if (PreprocessorLineType == MakePreprocessorLineTypeIf) {
+            if (NestingLevel == 0 && !BranchEnded) {
+                Live = TRUE;
+            }
+            NestingLevel++;
+        } else if (PreprocessorLineType == MakePreprocessorLineTypeElseIf) {
+            if (NestingLevel == 0) {
+                BranchEnded = TRUE;
+            }
+        } else {
+            JoinedLine.LengthInChars = 0;
+            continue;
+        }
 
-    return TRUE;
-}
+        YoriLibInitEmptyString(&VariableNotFound);
+        if (!MakeExpandVariables(ScopeContext, NULL, &ExpandedLine, &LineToProcess, &VariableNotFound) ||
+            VariableNotFound.LengthInChars > 0) {
 
-/**
- Look for a matching entry in the cache for the specified preprocessor
- command.
+            //
+            //  If the command cannot be determined it cannot be checked,
+            //  so it may alter the result of later commands.
+            //
 
- @param ScopeContext Pointer to the scope context.
+            if (YoriLibFindLeftMostCharacter(&LineToProcess, '[') != NULL) {
+                break;
+            }
 
- @param Cmd Pointer to the command to execute.
+            JoinedLine.LengthInChars = 0;
+            continue;
+        }
 
- @return Pointer to the cache entry if one was found, or NULL if no match
-         was found.
- */
-PMAKE_PREPROC_EXEC_CACHE_ENTRY
-MakeLookupPreprocessorCache(
-    __in PMAKE_SCOPE_CONTEXT ScopeContext,
-    __in PYORI_STRING Cmd
-    )
-{
-    PYORI_HASH_ENTRY HashEntry;
-    PMAKE_PREPROC_EXEC_CACHE_ENTRY Entry;
-    YORI_STRING Key;
+        //
+        //  Find each bracketed command in the condition.
+        //
 
-    if (!MakeBuildKeyForCacheCmd(ScopeContext, Cmd, &Key)) {
-        return NULL;
-    }
+        for (Index = 0; Index < ExpandedLine.LengthInChars; Index++) {
+            if (ExpandedLine.StartOfString[Index] != '[') {
+                continue;
+            }
 
-    HashEntry = YoriLibHashLookupByKey(ScopeContext->MakeContext->PreprocessorCache, &Key);
-    YoriLibFreeStringContents(&Key);
-    if (HashEntry == NULL) {
-        return NULL;
+            CmdStart = Index + 1;
+            for (Index = CmdStart; Index < ExpandedLine.LengthInChars; Index++) {
+                if (ExpandedLine.StartOfString[Index] == ']') {
+                    break;
+                }
+            }
+
+            if (Index == ExpandedLine.LengthInChars) {
+                break;
+            }
+
+            Cmd.StartOfString = &ExpandedLine.StartOfString[CmdStart];
+            Cmd.LengthInChars = Index - CmdStart;
+
+            if (!MakeIsPreprocessorCommandSafeToSpeculate(MakeContext, &Cmd)) {
+                BarrierFound = TRUE;
+                break;
+            }
+
+            if (Live) {
+                MakeSpeculatePreprocessorCommand(ScopeContext, &Cmd);
+            }
+        }
+
+        JoinedLine.LengthInChars = 0;
     }
 
-    Entry = CONTAINING_RECORD(HashEntry, MAKE_PREPROC_EXEC_CACHE_ENTRY, HashEntry);
-    return Entry;
+    YoriLibLineReadClose(LineContext);
+    YoriLibFreeStringContents(&LineString);
+    YoriLibFreeStringContents(&JoinedLine);
+    YoriLibFreeStringContents(&ExpandedLine);
+
+    SetFilePointer(Stream->hSource, (LONG)SavedPositionLow, &SavedPositionHigh, FILE_BEGIN);
 }
 
 /**
- Add an entry to the preprocessor cache.  This occurs after the child process
- has completed to record its result.
+ If a preprocessor command has been executed speculatively, return its
+ result, waiting for it to complete if necessary.  If the command has been
+ queued but not yet started by a worker thread, it is executed here.
 
  @param ScopeContext Pointer to the scope context.
 
- @param Cmd Pointer to the command string.
+ @param Cmd Pointer to the command to execute.
 
- @param ExitCode Indicates the result of the command.
+ @param ExitCode On successful completion, updated to contain the exit code
+        of the command.
+
+ @return TRUE if the command was executed speculatively and ExitCode has
+         been populated, FALSE if it was not.
  */
-VOID
-MakeAddToPreprocessorCache(
+__success(return)
+BOOLEAN
+MakeConsumePreprocessorSpeculation(
     __in PMAKE_SCOPE_CONTEXT ScopeContext,
     __in PYORI_STRING Cmd,
-    __in DWORD ExitCode
+    __out PDWORD ExitCode
     )
 {
-    PMAKE_PREPROC_EXEC_CACHE_ENTRY Entry;
+    PMAKE_CONTEXT MakeContext;
     PYORI_HASH_ENTRY HashEntry;
-    YORI_STRING Key;
+    PMAKE_PREPROC_SPECULATION Speculation;
+    BOOLEAN ExecuteHere;
 
-    if (!MakeBuildKeyForCacheCmd(ScopeContext, Cmd, &Key)) {
-        return;
+    MakeContext = ScopeContext->MakeContext;
+    if (MakeContext->SpeculationTable == NULL) {
+        return FALSE;
     }
 
-    HashEntry = YoriLibHashLookupByKey(ScopeContext->MakeContext->PreprocessorCache, &Key);
-    if (HashEntry != NULL) {
-        YoriLibFreeStringContents(&Key);
-        return;
+    HashEntry = YoriLibHashLookupByKey(MakeContext->SpeculationTable, Cmd);
+    if (HashEntry == NULL) {
+        return FALSE;
     }
 
-    Entry = YoriLibMalloc(sizeof(MAKE_PREPROC_EXEC_CACHE_ENTRY));
-    if (Entry == NULL) {
-        YoriLibFreeStringContents(&Key);
-        return;
+    //
+    //  The hash table is case insensitive, but commands may not be.
+    //
+
+    Speculation = CONTAINING_RECORD(HashEntry, MAKE_PREPROC_SPECULATION, HashEntry);
+    if (YoriLibCompareString(&Speculation->Cmd, Cmd) != 0) {
+        return FALSE;
     }
 
-    ZeroMemory(Entry, sizeof(MAKE_PREPROC_EXEC_CACHE_ENTRY));
-    Entry->ExitCode = ExitCode;
+    ExecuteHere = FALSE;
+    WaitForSingleObject(MakeContext->SpeculationMutex, INFINITE);
+    if (!Speculation->Started) {
+        YoriLibRemoveListItem(&Speculation->PendingListEntry);
+        Speculation->Started = TRUE;
+        ExecuteHere = TRUE;
+    }
+    ReleaseMutex(MakeContext->SpeculationMutex);
 
-    YoriLibHashInsertByKey(ScopeContext->MakeContext->PreprocessorCache, &Key, Entry, &Entry->HashEntry);
+    if (ExecuteHere) {
+        Speculation->ExitCode = MakeShExecExecPlan(&Speculation->ExecPlan, NULL);
+    } else {
+        WaitForSingleObject(Speculation->CompleteEvent, INFINITE);
+    }
 
-    YoriLibAppendList(&ScopeContext->MakeContext->PreprocessorCacheList, &Entry->ListEntry);
-    YoriLibFreeStringContents(&Key);
+    *ExitCode = Speculation->ExitCode;
+    MakeFreePreprocessorSpeculation(Speculation);
+    return TRUE;
 }
 
 /**
@@ -1067,6 +2043,23 @@ MakeExecuteCommandCaptureExitCode(
         }
     }
 
+    //
+    //  If the command was executed speculatively, use its result.  If not,
+    //  and it's safe to execute speculatively, look for later commands
+    //  which can execute in parallel with it.  If it's not safe, it may
+    //  alter the result of any speculative commands, so discard them.
+    //
+
+    if (MakeConsumePreprocessorSpeculation(ScopeContext, Cmd, &ExitCode)) {
+        goto AddToCache;
+    }
+
+    if (MakeIsPreprocessorCommandSafeToSpeculate(ScopeContext->MakeContext, Cmd)) {
+        MakeSpeculateAheadInStream(ScopeContext);
+    } else {
+        MakeDiscardPreprocessorSpeculation(ScopeContext->MakeContext);
+    }
+
     if (!YoriLibShParseCmdlineToCmdContext(Cmd, 0, &CmdContext)) {
         goto Complete;
     }
@@ -1081,6 +2074,15 @@ MakeExecuteCommandCaptureExitCode(
     YoriLibShFreeExecPlan(&ExecPlan);
     YoriLibShFreeCmdContext(&CmdContext);
 
+AddToCache:
+
+    //
+    //  The command may have created files, so directories enumerated to
+    //  resolve inference rules can no longer be trusted.
+    //
+
+    MakeDeleteInferenceProbeCache(ScopeContext->MakeContext);
+
     if (ScopeContext->MakeContext->PreprocessorCache != NULL) {
         MakeAddToPreprocessorCache(ScopeContext, Cmd, ExitCode);
     }
@@ -1535,6 +2537,9 @@ MakeInclude(
 {
     YORI_STRING FullPath;
     YORI_STRING SavedCurrentIncludeDirectory;
+    PMAKE_CONTEXT MakeContext;
+    LARGE_INTEGER StartTime;
+    LARGE_INTEGER EndTime;
     LPTSTR FilePart;
     HANDLE hStream;
 
@@ -1566,11 +2571,24 @@ MakeInclude(
     YoriLibCloneString(&ScopeContext->CurrentIncludeDirectory, &FullPath);
     ScopeContext->CurrentIncludeDirectory.LengthInChars = (YORI_ALLOC_SIZE_T)((FilePart - ScopeContext->CurrentIncludeDirectory.StartOfString) - 1);
 
-    if (!MakeProcessStream(hStream, ScopeContext->MakeContext, &FullPath)) {
+    MakeContext = ScopeContext->MakeContext;
+    QueryPerformanceCounter(&StartTime);
+    MakeContext->IncludeDepth++;
+    if (!MakeProcessStream(hStream, MakeContext, &FullPath)) {
 #if MAKE_DEBUG_PREPROCESSOR
         YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("ERROR: MakeProcessStream failed: %y\n"), &FullPath);
 #endif
     }
+    MakeContext->IncludeDepth--;
+    QueryPerformanceCounter(&EndTime);
+
+    //
+    //  Nested includes are already counted by the outermost include.
+    //
+
+    if (MakeContext->IncludeDepth == 0) {
+        MakeContext->TimeInInclude = MakeContext->TimeInInclude + EndTime.QuadPart - StartTime.QuadPart;
+    }
     CloseHandle(hStream);
 
     YoriLibFreeStringContents(&ScopeContext->CurrentIncludeDirectory);
@@ -2280,6 +3298,40 @@ MakeAddRule(
         return NULL;
     }
 
+    //
+    //  .REMOTE lists targets whose inputs and outputs are fully declared,
+    //  so their recipes can be executed by a remote launcher.  Like
+    //  .SUFFIXES it has no recipe and is not a target itself.
+    //
+
+    if (YoriLibCompareStringLitIns(&Substring, _T(".REMOTE")) == 0) {
+        YORI_STRING TargetList;
+
+        YoriLibInitEmptyString(&TargetList);
+        TargetList.StartOfString = Colon + 1;
+        TargetList.LengthInChars = Line->LengthInChars - (YORI_ALLOC_SIZE_T)(TargetList.StartOfString - Line->StartOfString);
+        MakeMarkRemoteTargets(ScopeContext, &TargetList);
+        ScopeContext->ParserState = MakeParserDefault;
+        return NULL;
+    }
+
+    //
+    //  .SPECULATE lists programs which do not alter state, so preprocessor
+    //  commands invoking them can be executed ahead of the line that needs
+    //  their result.
+    //
+
+    if (YoriLibCompareStringLitIns(&Substring, _T(".SPECULATE")) == 0) {
+        YORI_STRING ProgramList;
+
+        YoriLibInitEmptyString(&ProgramList);
+        ProgramList.StartOfString = Colon + 1;
+        ProgramList.LengthInChars = Line->LengthInChars - (YORI_ALLOC_SIZE_T)(ProgramList.StartOfString - Line->StartOfString);
+        MakeAddSpeculationPrograms(ScopeContext->MakeContext, &ProgramList);
+        ScopeContext->ParserState = MakeParserDefault;
+        return NULL;
+    }
+
     //
     //  If a target is found, NMAKE preserves any existing recipe, to support
     //  having lines specify dependencies that are different to the ones
@@ -2700,9 +3752,20 @@ MakeProcessStream(
     LPTSTR PrefixString;
     PMAKE_TARGET ActiveRecipeTarget = NULL;
     PMAKE_SCOPE_CONTEXT ScopeContext;
+    MAKE_PREPROC_STREAM Stream;
+    LARGE_INTEGER StartTime;
+    LARGE_INTEGER EndTime;
     DWORD LineNumber;
 
     ScopeContext = MakeContext->ActiveScope;
+    QueryPerformanceCounter(&StartTime);
+    MakeGraphCacheRecordMakefile(MakeContext, hSource, FileName);
+
+    Stream.Parent = MakeContext->ActiveStream;
+    Stream.hSource = hSource;
+    Stream.LineNumber = 0;
+    Stream.NestedTime = 0;
+    MakeContext->ActiveStream = &Stream;
 
     YoriLibInitEmptyString(&LineString);
     YoriLibInitEmptyString(&JoinedLine);
@@ -2720,6 +3783,7 @@ MakeProcessStream(
             break;
         }
         LineNumber++;
+        Stream.LineNumber = LineNumber;
 
         //
         //  Line might be:
@@ -2880,6 +3944,21 @@ MakeProcessStream(
     YoriLibFreeStringContents(&JoinedLine);
     YoriLibFreeStringContents(&ExpandedLine);
 
+    MakeContext->ActiveStream = Stream.Parent;
+
+    QueryPerformanceCounter(&EndTime);
+    MakeTracePhase(MakeContext, _T("Preprocess"), FileName, &StartTime, &EndTime);
+
+    //
+    //  Record the time spent in this makefile excluding any makefiles it
+    //  included, and tell the parent how long it spent in this one.
+    //
+
+    MakePerfRecordMakefile(MakeContext, FileName, Stream.LineNumber, EndTime.QuadPart - StartTime.QuadPart - Stream.NestedTime);
+    if (Stream.Parent != NULL) {
+        Stream.Parent->NestedTime = Stream.Parent->NestedTime + EndTime.QuadPart - StartTime.QuadPart;
+    }
+
     return TRUE;
 }
 
@@ -0,0 +1,223 @@
+/**
+ * @file make/remote.c
+ *
+ * Yori shell make remote execution backend
+ *
+ * Copyright (c) 2026 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <yoripch.h>
+#include <yorilib.h>
+#include <yorish.h>
+#include "make.h"
+
+//
+//  Recipes for targets listed in a .REMOTE pseudo target can be executed by
+//  a remote launcher rather than locally.  The launcher is an external
+//  program specified with -remote, and is invoked once per command as:
+//
+//      launcher "directory" "command"
+//
+//  The launcher is responsible for transporting the command to a worker,
+//  typically via a share that both machines can see at the same path,
+//  executing it in the specified directory, relaying its output to stdout,
+//  and exiting with the exit code of the command.  Because the launcher is
+//  a local process, ymake waits for and buffers its output in exactly the
+//  same way as any other command, and the number of concurrent launchers
+//  is specified independently of the number of local child processes.
+//
+//  Builtin commands, including CD and IF, are still processed locally for
+//  remote targets, since these update state within ymake.
+//
+
+/**
+ Mark each target in a .REMOTE pseudo target as being eligible for remote
+ execution.  A makefile author should only list targets whose inputs and
+ outputs are fully declared, since the remote worker will only observe the
+ state of the shared file system.
+
+ @param ScopeContext Pointer to the scope context that contains the rule.
+
+ @param TargetList Pointer to a string containing whitespace delimited target
+        names, each of which may be quoted.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+MakeMarkRemoteTargets(
+    __in PMAKE_SCOPE_CONTEXT ScopeContext,
+    __in PYORI_STRING TargetList
+    )
+{
+    YORI_STRING TargetName;
+    YORI_ALLOC_SIZE_T ReadIndex;
+    YORI_ALLOC_SIZE_T StartIndex;
+    BOOLEAN QuoteOpen;
+    PMAKE_TARGET Target;
+
+    ReadIndex = 0;
+    while (ReadIndex < TargetList->LengthInChars) {
+
+        if (TargetList->StartOfString[ReadIndex] == ' ' ||
+            TargetList->StartOfString[ReadIndex] == '\t') {
+
+            ReadIndex++;
+            continue;
+        }
+
+        StartIndex = ReadIndex;
+        QuoteOpen = FALSE;
+        for (; ReadIndex < TargetList->LengthInChars; ReadIndex++) {
+            if (TargetList->StartOfString[ReadIndex] == '"') {
+                QuoteOpen = (BOOLEAN)!QuoteOpen;
+            } else if (!QuoteOpen &&
+                       (TargetList->StartOfString[ReadIndex] == ' ' ||
+                        TargetList->StartOfString[ReadIndex] == '\t')) {
+                break;
+            }
+        }
+
+        YoriLibInitEmptyString(&TargetName);
+        TargetName.StartOfString = &TargetList->StartOfString[StartIndex];
+        TargetName.LengthInChars = ReadIndex - StartIndex;
+
+        if (TargetName.LengthInChars >= 3 &&
+            TargetName.StartOfString[0] == '"' &&
+            TargetName.StartOfString[TargetName.LengthInChars - 1] == '"') {
+
+            TargetName.StartOfString++;
+            TargetName.LengthInChars = TargetName.LengthInChars - 2;
+        }
+
+        //
+        //  Indicating that the target is an inference rule prevents it
+        //  from being attached to the default target of the scope if the
+        //  .REMOTE line precedes any other rule.  If a rule is found later
+        //  it will be attached at that point.
+        //
+
+        Target = MakeLookupOrCreateTarget(ScopeContext, &TargetName, TRUE);
+        if (Target == NULL) {
+            return FALSE;
+        }
+
+        Target->RemoteEligible = TRUE;
+    }
+
+    return TRUE;
+}
+
+/**
+ Construct a CmdContext that invokes the remote launcher to execute a
+ command.  On success, the caller is expected to free this with
+ @ref YoriLibShFreeCmdContext .
+
+ @param MakeContext Pointer to the make context, which specifies the remote
+        launcher.
+
+ @param CmdContext Pointer to a CmdContext to be populated within this
+        routine.
+
+ @param CurrentDirectory Pointer to the directory that the command should
+        execute in.  This is cloned (not copied) within this routine.
+
+ @param CmdLine Pointer to the command to execute remotely.  This is cloned
+        (not copied) within this routine, so the caller is expected to not
+        modify it or copy it if necessary.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+MakeBuildCmdContextForRemoteLaunch(
+    __in PMAKE_CONTEXT MakeContext,
+    __out PYORI_LIBSH_CMD_CONTEXT CmdContext,
+    __in PYORI_STRING CurrentDirectory,
+    __in PYORI_STRING CmdLine
+    )
+{
+    YORI_STRING FoundInPath;
+    PVOID MemoryToFree;
+
+    //
+    //  Allocate three components, for the launcher, the directory and the
+    //  command
+    //
+
+    CmdContext->ArgC = 3;
+    MemoryToFree = YoriLibReferencedMalloc(CmdContext->ArgC * (sizeof(YORI_STRING) + sizeof(YORI_LIBSH_ARG_CONTEXT)));
+    if (MemoryToFree == NULL) {
+        return FALSE;
+    }
+
+    CmdContext->ArgV = MemoryToFree;
+    CmdContext->MemoryToFreeArgV = MemoryToFree;
+
+    CmdContext->ArgContexts = (PYORI_LIBSH_ARG_CONTEXT)YoriLibAddToPointer(CmdContext->ArgV, sizeof(YORI_STRING) * CmdContext->ArgC);
+    ZeroMemory(CmdContext->ArgContexts, sizeof(YORI_LIBSH_ARG_CONTEXT) * CmdContext->ArgC);
+
+    YoriLibReference(MemoryToFree);
+    CmdContext->MemoryToFreeArgContexts = MemoryToFree;
+
+    //
+    //  Locate the launcher in PATH
+    //
+
+    YoriLibInitEmptyString(&FoundInPath);
+    if (YoriLibLocateExecutableInPath(&MakeContext->RemoteLauncher, NULL, NULL, &FoundInPath) && FoundInPath.LengthInChars > 0) {
+        memcpy(&CmdContext->ArgV[0], &FoundInPath, sizeof(YORI_STRING));
+        ASSERT(YoriLibIsStringNullTerminated(&CmdContext->ArgV[0]));
+        YoriLibInitEmptyString(&FoundInPath);
+    } else {
+        YoriLibCloneString(&CmdContext->ArgV[0], &MakeContext->RemoteLauncher);
+    }
+
+    YoriLibFreeStringContents(&FoundInPath);
+
+    //
+    //  The directory and command are always quoted so the launcher can
+    //  find the boundary between them.  The command is passed in the same
+    //  form as cmd /c, so any quotes within it are preserved.
+    //
+
+    YoriLibCloneString(&CmdContext->ArgV[1], CurrentDirectory);
+    CmdContext->ArgContexts[1].Quoted = TRUE;
+    CmdContext->ArgContexts[1].QuoteTerminated = TRUE;
+
+    YoriLibCloneString(&CmdContext->ArgV[2], CmdLine);
+    CmdContext->ArgContexts[2].Quoted = TRUE;
+    CmdContext->ArgContexts[2].QuoteTerminated = TRUE;
+
+    //
+    //  Initialize unused fields
+    //
+
+    CmdContext->CurrentArg = 0;
+    CmdContext->CurrentArgOffset = 0;
+    CmdContext->TrailingChars = FALSE;
+
+    YoriLibShCheckIfArgNeedsQuotes(CmdContext, 0);
+
+    return TRUE;
+}
+
+// vim:sw=4:ts=4:et:
@@ -59,7 +59,7 @@ MakeAllocateNewScope(
     ScopeContext->MakeContext = MakeContext;
     ScopeContext->ReferenceCount = 2; // One for the caller, one for the hash
 
-    ScopeContext->Variables = YoriLibAllocateHashTable(1000);
+    ScopeContext->Variables = YoriLibAllocateHashTable(64);
     if (ScopeContext->Variables == NULL) {
         YoriLibDereference(ScopeContext);
         return NULL;
@@ -83,6 +83,9 @@ MakeAllocateNewScope(
 
     YoriLibInitializeListHead(&ScopeContext->VariableList);
     YoriLibInitializeListHead(&ScopeContext->InferenceRuleList);
+    YoriLibInitializeListHead(&ScopeContext->InferenceRuleExtensionList);
+    ScopeContext->InferenceRuleExtensions = NULL;
+    ScopeContext->InferenceRuleExtraChars = 0;
     YoriLibInitializeListHead(&ScopeContext->InferenceRuleNeededList);
     YoriLibAppendList(&MakeContext->ScopesList, &ScopeContext->ListEntry);
 
@@ -144,6 +147,7 @@ MakeDereferenceScope(
         if (ScopeContext->Variables != NULL) {
             YoriLibFreeEmptyHashTable(ScopeContext->Variables);
         }
+        MakeDeleteInferenceRuleExtensions(ScopeContext);
 
         YoriLibDereference(ScopeContext);
     }
@@ -29,11 +29,6 @@
 #include <yorish.h>
 #include "make.h"
 
-VOID
-MakeDereferenceInferenceRule(
-    __in PMAKE_INFERENCE_RULE InferenceRule
-    );
-
 /**
  Dereference and potentially free a target.
 
@@ -44,9 +39,6 @@ MakeDereferenceTarget(
     __in PMAKE_TARGET Target
     )
 {
-    PYORI_LIST_ENTRY ListEntry;
-    PMAKE_CMD_TO_EXEC CmdToExec;
-
     if (InterlockedDecrement((INTERLOCKED_VOLATILE LONG *)&Target->ReferenceCount) == 0) {
 
         YoriLibFreeStringContents(&Target->Recipe);
@@ -61,14 +53,10 @@ MakeDereferenceTarget(
             Target->ScopeContext = NULL;
         }
 
-        ListEntry = YoriLibGetNextListEntry(&Target->ExecCmds, NULL);
-        while (ListEntry != NULL) {
-            CmdToExec = CONTAINING_RECORD(ListEntry, MAKE_CMD_TO_EXEC, ListEntry);
-            ListEntry = YoriLibGetNextListEntry(&Target->ExecCmds, ListEntry);
-
-            YoriLibFreeStringContents(&CmdToExec->Cmd);
-            YoriLibFree(CmdToExec);
-        }
+        //
+        //  Commands to execute are allocated from the string arena, which
+        //  is freed when the program exits.
+        //
 
         if (Target->InferenceRuleParentTarget != NULL) {
             MakeDereferenceTarget(Target->InferenceRuleParentTarget);
@@ -158,14 +146,617 @@ MakeDeleteAllTargets(
 
 }
 
+/**
+ The minimum number of targets within a directory for the directory to be
+ enumerated, rather than probing each target individually.
+ */
+#define MAKE_DIRECTORY_CACHE_MIN_TARGETS (2)
+
+/**
+ Split a target name into the directory containing it and the file name
+ within the directory.  The directory includes its trailing seperator.
+ Both strings refer to the memory of the target name.
+
+ @param Target Pointer to the target.
+
+ @param DirName On successful completion, updated to point to the directory
+        portion of the target name.
+
+ @param FileName On successful completion, updated to point to the file
+        name portion of the target name.
+
+ @return TRUE to indicate success, FALSE if the target name does not
+         contain a directory.
+ */
+__success(return)
+BOOLEAN
+MakeSplitTargetDirectory(
+    __in PMAKE_TARGET Target,
+    __out PYORI_STRING DirName,
+    __out PYORI_STRING FileName
+    )
+{
+    LPTSTR FinalSep;
+    YORI_ALLOC_SIZE_T DirChars;
+
+    FinalSep = YoriLibFindRightMostCharacter(&Target->HashEntry.Key, '\\');
+    if (FinalSep == NULL) {
+        return FALSE;
+    }
+
+    DirChars = (YORI_ALLOC_SIZE_T)(FinalSep - Target->HashEntry.Key.StartOfString + 1);
+    if (DirChars == Target->HashEntry.Key.LengthInChars) {
+        return FALSE;
+    }
+
+    YoriLibInitEmptyString(DirName);
+    DirName->StartOfString = Target->HashEntry.Key.StartOfString;
+    DirName->LengthInChars = DirChars;
+
+    YoriLibInitEmptyString(FileName);
+    FileName->StartOfString = &Target->HashEntry.Key.StartOfString[DirChars];
+    FileName->LengthInChars = Target->HashEntry.Key.LengthInChars - DirChars;
+
+    return TRUE;
+}
+
+/**
+ Add a file found during enumeration to a directory cache entry.
+
+ @param DirEntry Pointer to the directory cache entry.
+
+ @param FileName Pointer to a NULL terminated file name.
+
+ @param FindData Pointer to the information returned from enumeration.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOLEAN
+MakeAddDirectoryCacheFile(
+    __in PMAKE_DIRECTORY_CACHE_ENTRY DirEntry,
+    __in LPCTSTR FileName,
+    __in PWIN32_FIND_DATA FindData
+    )
+{
+    PMAKE_DIRECTORY_CACHE_FILE File;
+    YORI_STRING Key;
+    YORI_ALLOC_SIZE_T NameLength;
+
+    NameLength = (YORI_ALLOC_SIZE_T)_tcslen(FileName);
+    File = YoriLibMalloc(sizeof(MAKE_DIRECTORY_CACHE_FILE) + (NameLength + 1) * sizeof(TCHAR));
+    if (File == NULL) {
+        return FALSE;
+    }
+
+    YoriLibInitEmptyString(&Key);
+    Key.StartOfString = (LPTSTR)(File + 1);
+    Key.LengthInChars = NameLength;
+    Key.LengthAllocated = NameLength + 1;
+    memcpy(Key.StartOfString, FileName, (NameLength + 1) * sizeof(TCHAR));
+
+    File->ProbeRequired = FALSE;
+    if (FindData->dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) {
+        File->ProbeRequired = TRUE;
+    }
+
+    if (FindData->dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+        File->ModifiedTime.QuadPart = 0;
+    } else {
+        File->ModifiedTime.LowPart = FindData->ftLastWriteTime.dwLowDateTime;
+        File->ModifiedTime.HighPart = FindData->ftLastWriteTime.dwHighDateTime;
+    }
+
+    YoriLibHashInsertByKey(DirEntry->Files, &Key, File, &File->HashEntry);
+    YoriLibAppendList(&DirEntry->FileList, &File->ListEntry);
+    return TRUE;
+}
+
+/**
+ Enumerate a single directory and record the timestamp of each file within
+ it.  If the directory does not exist, it is recorded as enumerated and
+ empty, so every target within it is known not to exist.  If enumeration
+ fails for any other reason, targets within it are probed individually.
+
+ @param DirEntry Pointer to the directory cache entry to populate.
+ */
+VOID
+MakeEnumerateDirectoryCacheEntry(
+    __in PMAKE_DIRECTORY_CACHE_ENTRY DirEntry
+    )
+{
+    YORI_STRING SearchString;
+    WIN32_FIND_DATA FindData;
+    HANDLE FindHandle;
+    DWORD Err;
+
+    if (!YoriLibAllocateString(&SearchString, DirEntry->DirName.LengthInChars + 2)) {
+        return;
+    }
+
+    SearchString.LengthInChars = YoriLibSPrintf(SearchString.StartOfString, _T("%y*"), &DirEntry->DirName);
+
+    FindHandle = FindFirstFile(SearchString.StartOfString, &FindData);
+    YoriLibFreeStringContents(&SearchString);
+
+    if (FindHandle == INVALID_HANDLE_VALUE) {
+        Err = GetLastError();
+        if (Err == ERROR_PATH_NOT_FOUND || Err == ERROR_FILE_NOT_FOUND) {
+            DirEntry->Enumerated = TRUE;
+        }
+        return;
+    }
+
+    do {
+        if (!MakeAddDirectoryCacheFile(DirEntry, FindData.cFileName, &FindData)) {
+            FindClose(FindHandle);
+            return;
+        }
+
+        //
+        //  Targets may be referred to by short name, so record this name too
+        //  if it exists.
+        //
+
+        if (FindData.cAlternateFileName[0] != '\0' &&
+            _tcsicmp(FindData.cAlternateFileName, FindData.cFileName) != 0) {
+
+            if (!MakeAddDirectoryCacheFile(DirEntry, FindData.cAlternateFileName, &FindData)) {
+                FindClose(FindHandle);
+                return;
+            }
+        }
+    } while (FindNextFile(FindHandle, &FindData));
+
+    FindClose(FindHandle);
+    DirEntry->Enumerated = TRUE;
+}
+
+/**
+ Context shared between threads enumerating directories to populate the
+ directory cache.
+ */
+typedef struct _MAKE_DIRECTORY_CACHE_POPULATE_CONTEXT {
+
+    /**
+     An array of directories to enumerate.
+     */
+    PMAKE_DIRECTORY_CACHE_ENTRY *Entries;
+
+    /**
+     The number of elements in Entries.
+     */
+    DWORD EntryCount;
+
+    /**
+     The index of the next element in Entries to enumerate.  This is updated
+     with interlocked operations.
+     */
+    DWORD NextEntry;
+
+} MAKE_DIRECTORY_CACHE_POPULATE_CONTEXT, *PMAKE_DIRECTORY_CACHE_POPULATE_CONTEXT;
+
+/**
+ A worker thread which enumerates directories to populate the directory
+ cache.  Each directory has its own table of files, so threads do not need
+ to synchronize beyond selecting the next directory.
+
+ @param Context Pointer to the populate context.
+
+ @return Thread exit code, currently always zero.
+ */
+DWORD WINAPI
+MakePopulateDirectoryCacheWorker(
+    __in PVOID Context
+    )
+{
+    PMAKE_DIRECTORY_CACHE_POPULATE_CONTEXT PopulateContext;
+    DWORD Index;
+
+    PopulateContext = (PMAKE_DIRECTORY_CACHE_POPULATE_CONTEXT)Context;
+
+    while (TRUE) {
+        Index = InterlockedIncrement((INTERLOCKED_VOLATILE LONG *)&PopulateContext->NextEntry) - 1;
+        if (Index >= PopulateContext->EntryCount) {
+            break;
+        }
+
+        MakeEnumerateDirectoryCacheEntry(PopulateContext->Entries[Index]);
+    }
+
+    return 0;
+}
+
+/**
+ Find the directories containing targets whose files have not been probed
+ and enumerate each directory once, so that probing targets can be resolved
+ without opening each target.  Directories are enumerated concurrently,
+ using up to the number of child processes requested.  The cache is only
+ valid until targets start executing, so it must be deleted with
+ MakeDeleteDirectoryCache once dependencies have been evaluated.
+
+ @param MakeContext Pointer to the context.
+ */
+VOID
+MakePopulateDirectoryCache(
+    __inout PMAKE_CONTEXT MakeContext
+    )
+{
+    MAKE_DIRECTORY_CACHE_POPULATE_CONTEXT PopulateContext;
+    PMAKE_DIRECTORY_CACHE_ENTRY DirEntry;
+    PYORI_HASH_ENTRY HashEntry;
+    PYORI_LIST_ENTRY ListEntry;
+    PMAKE_TARGET Target;
+    YORI_STRING DirName;
+    YORI_STRING FileName;
+    HANDLE Threads[64];
+    DWORD ThreadCount;
+    DWORD ThreadId;
+    DWORD Index;
+
+    ASSERT(MakeContext->DirectoryCache == NULL);
+    MakeContext->DirectoryCache = YoriLibAllocateHashTable(1000);
+    if (MakeContext->DirectoryCache == NULL) {
+        return;
+    }
+
+    //
+    //  Count the number of targets within each directory.
+    //
+
+    PopulateContext.EntryCount = 0;
+    ListEntry = YoriLibGetNextListEntry(&MakeContext->TargetsList, NULL);
+    while (ListEntry != NULL) {
+        Target = CONTAINING_RECORD(ListEntry, MAKE_TARGET, ListEntry);
+        ListEntry = YoriLibGetNextListEntry(&MakeContext->TargetsList, ListEntry);
+
+        if (Target->InferenceRulePseudoTarget ||
+            Target->FileProbed ||
+            !MakeSplitTargetDirectory(Target, &DirName, &FileName)) {
+
+            continue;
+        }
+
+        HashEntry = YoriLibHashLookupByKey(MakeContext->DirectoryCache, &DirName);
+        if (HashEntry != NULL) {
+            DirEntry = HashEntry->Context;
+            DirEntry->TargetCount++;
+            if (DirEntry->TargetCount == MAKE_DIRECTORY_CACHE_MIN_TARGETS) {
+                PopulateContext.EntryCount++;
+            }
+            continue;
+        }
+
+        DirEntry = YoriLibMalloc(sizeof(MAKE_DIRECTORY_CACHE_ENTRY));
+        if (DirEntry == NULL) {
+            continue;
+        }
+
+        ZeroMemory(DirEntry, sizeof(MAKE_DIRECTORY_CACHE_ENTRY));
+        if (!YoriLibCopyString(&DirEntry->DirName, &DirName)) {
+            YoriLibFree(DirEntry);
+            continue;
+        }
+
+        YoriLibInitializeListHead(&DirEntry->FileList);
+        DirEntry->TargetCount = 1;
+        YoriLibHashInsertByKey(MakeContext->DirectoryCache, &DirEntry->DirName, DirEntry, &DirEntry->HashEntry);
+        YoriLibAppendList(&MakeContext->DirectoryCacheList, &DirEntry->ListEntry);
+    }
+
+    if (PopulateContext.EntryCount == 0) {
+        return;
+    }
+
+    PopulateContext.Entries = YoriLibMalloc(PopulateContext.EntryCount * sizeof(PMAKE_DIRECTORY_CACHE_ENTRY));
+    if (PopulateContext.Entries == NULL) {
+        return;
+    }
+
+    Index = 0;
+    ListEntry = YoriLibGetNextListEntry(&MakeContext->DirectoryCacheList, NULL);
+    while (ListEntry != NULL) {
+        DirEntry = CONTAINING_RECORD(ListEntry, MAKE_DIRECTORY_CACHE_ENTRY, ListEntry);
+        ListEntry = YoriLibGetNextListEntry(&MakeContext->DirectoryCacheList, ListEntry);
+        if (DirEntry->TargetCount < MAKE_DIRECTORY_CACHE_MIN_TARGETS) {
+            continue;
+        }
+
+        DirEntry->Files = YoriLibAllocateHashTable(64);
+        if (DirEntry->Files == NULL) {
+            continue;
+        }
+
+        ASSERT(Index < PopulateContext.EntryCount);
+        PopulateContext.Entries[Index] = DirEntry;
+        Index++;
+    }
+
+    PopulateContext.EntryCount = Index;
+    PopulateContext.NextEntry = 0;
+
+    //
+    //  Enumerating directories is dominated by latency, particularly on
+    //  network file systems, so use a thread per requested child process.
+    //  If no threads can be created, enumerate on this thread.
+    //
+
+    ThreadCount = MakeContext->NumberProcesses;
+    if (ThreadCount > sizeof(Threads)/sizeof(Threads[0])) {
+        ThreadCount = sizeof(Threads)/sizeof(Threads[0]);
+    }
+    if (ThreadCount > PopulateContext.EntryCount) {
+        ThreadCount = PopulateContext.EntryCount;
+    }
+
+    for (Index = 0; Index < ThreadCount; Index++) {
+        Threads[Index] = CreateThread(NULL, 0, MakePopulateDirectoryCacheWorker, &PopulateContext, 0, &ThreadId);
+        if (Threads[Index] == NULL) {
+            break;
+        }
+    }
+    ThreadCount = Index;
+
+    MakePopulateDirectoryCacheWorker(&PopulateContext);
+
+    if (ThreadCount > 0) {
+        WaitForMultipleObjects(ThreadCount, Threads, TRUE, INFINITE);
+        for (Index = 0; Index < ThreadCount; Index++) {
+            CloseHandle(Threads[Index]);
+        }
+    }
+
+    YoriLibFree(PopulateContext.Entries);
+}
+
+/**
+ Delete a table of directory cache entries and the files within them.
+
+ @param Cache Pointer to the hash table of directories.  On completion this
+        is updated to NULL.
+
+ @param CacheList Pointer to the list of directories within the table.
+ */
+VOID
+MakeDeleteDirectoryCacheTable(
+    __inout PYORI_HASH_TABLE *Cache,
+    __inout PYORI_LIST_ENTRY CacheList
+    )
+{
+    PMAKE_DIRECTORY_CACHE_ENTRY DirEntry;
+    PMAKE_DIRECTORY_CACHE_FILE File;
+    PYORI_LIST_ENTRY ListEntry;
+    PYORI_LIST_ENTRY FileListEntry;
+
+    ListEntry = YoriLibGetNextListEntry(CacheList, NULL);
+    while (ListEntry != NULL) {
+        DirEntry = CONTAINING_RECORD(ListEntry, MAKE_DIRECTORY_CACHE_ENTRY, ListEntry);
+        ListEntry = YoriLibGetNextListEntry(CacheList, ListEntry);
+
+        FileListEntry = YoriLibGetNextListEntry(&DirEntry->FileList, NULL);
+        while (FileListEntry != NULL) {
+            File = CONTAINING_RECORD(FileListEntry, MAKE_DIRECTORY_CACHE_FILE, ListEntry);
+            FileListEntry = YoriLibGetNextListEntry(&DirEntry->FileList, FileListEntry);
+            YoriLibHashRemoveByEntry(&File->HashEntry);
+            YoriLibFree(File);
+        }
+
+        if (DirEntry->Files != NULL) {
+            YoriLibFreeEmptyHashTable(DirEntry->Files);
+        }
+
+        YoriLibHashRemoveByEntry(&DirEntry->HashEntry);
+        YoriLibRemoveListItem(&DirEntry->ListEntry);
+        YoriLibFreeStringContents(&DirEntry->DirName);
+        YoriLibFree(DirEntry);
+    }
+
+    if (*Cache != NULL) {
+        YoriLibFreeEmptyHashTable(*Cache);
+        *Cache = NULL;
+    }
+}
+
+/**
+ Delete the directory cache.  This must be called before targets are
+ executed, since executing targets modifies the files that the cache
+ describes.
+
+ @param MakeContext Pointer to the context.
+ */
+VOID
+MakeDeleteDirectoryCache(
+    __inout PMAKE_CONTEXT MakeContext
+    )
+{
+    MakeDeleteDirectoryCacheTable(&MakeContext->DirectoryCache, &MakeContext->DirectoryCacheList);
+}
+
+/**
+ Delete the cache of directories used to answer probes for inference rule
+ source files.  This must be called whenever files may have been created,
+ such as after a preprocessor command executes.
+
+ @param MakeContext Pointer to the context.
+ */
+VOID
+MakeDeleteInferenceProbeCache(
+    __inout PMAKE_CONTEXT MakeContext
+    )
+{
+    MakeDeleteDirectoryCacheTable(&MakeContext->InferenceProbeCache, &MakeContext->InferenceProbeCacheList);
+}
+
+/**
+ Determine whether a file that would be the source of an inference rule
+ exists.  Probes within each directory are counted, and once a directory
+ has been probed several times it is enumerated so that later probes are
+ resolved with a hash lookup rather than a file system query.
+
+ @param MakeContext Pointer to the context.
+
+ @param FileToProbe Pointer to the fully qualified, NULL terminated name of
+        the file to probe.  The length of this string is not used.
+
+ @return TRUE if the file exists, FALSE if it does not.
+ */
+BOOLEAN
+MakeInferenceProbeFile(
+    __in PMAKE_CONTEXT MakeContext,
+    __in PYORI_STRING FileToProbe
+    )
+{
+    PMAKE_DIRECTORY_CACHE_ENTRY DirEntry;
+    PYORI_HASH_ENTRY HashEntry;
+    YORI_STRING DirName;
+    YORI_STRING FileName;
+    YORI_ALLOC_SIZE_T Length;
+    YORI_ALLOC_SIZE_T Index;
+
+    MakeContext->InferenceRuleProbes++;
+
+    //
+    //  The caller's length describes the file name without the source
+    //  extension, so find the full length from the NULL terminator.
+    //
+
+    Length = (YORI_ALLOC_SIZE_T)_tcslen(FileToProbe->StartOfString);
+    for (Index = Length; Index > 0; Index--) {
+        if (YoriLibIsSep(FileToProbe->StartOfString[Index - 1])) {
+            break;
+        }
+    }
+
+    if (Index == 0) {
+        return (BOOLEAN)(GetFileAttributes(FileToProbe->StartOfString) != (DWORD)-1);
+    }
+
+    YoriLibInitEmptyString(&DirName);
+    DirName.StartOfString = FileToProbe->StartOfString;
+    DirName.LengthInChars = Index;
+
+    YoriLibInitEmptyString(&FileName);
+    FileName.StartOfString = &FileToProbe->StartOfString[Index];
+    FileName.LengthInChars = Length - Index;
+
+    if (MakeContext->InferenceProbeCache == NULL) {
+        MakeContext->InferenceProbeCache = YoriLibAllocateHashTable(250);
+        if (MakeContext->InferenceProbeCache == NULL) {
+            return (BOOLEAN)(GetFileAttributes(FileToProbe->StartOfString) != (DWORD)-1);
+        }
+    }
+
+    HashEntry = YoriLibHashLookupByKey(MakeContext->InferenceProbeCache, &DirName);
+    if (HashEntry != NULL) {
+        DirEntry = HashEntry->Context;
+    } else {
+        DirEntry = YoriLibMalloc(sizeof(MAKE_DIRECTORY_CACHE_ENTRY));
+        if (DirEntry == NULL) {
+            return (BOOLEAN)(GetFileAttributes(FileToProbe->StartOfString) != (DWORD)-1);
+        }
+
+        ZeroMemory(DirEntry, sizeof(MAKE_DIRECTORY_CACHE_ENTRY));
+        if (!YoriLibCopyString(&DirEntry->DirName, &DirName)) {
+            YoriLibFree(DirEntry);
+            return (BOOLEAN)(GetFileAttributes(FileToProbe->StartOfString) != (DWORD)-1);
+        }
+
+        YoriLibInitializeListHead(&DirEntry->FileList);
+        YoriLibHashInsertByKey(MakeContext->InferenceProbeCache, &DirEntry->DirName, DirEntry, &DirEntry->HashEntry);
+        YoriLibAppendList(&MakeContext->InferenceProbeCacheList, &DirEntry->ListEntry);
+    }
+
+    //
+    //  Enumerate the directory once when it has been probed enough times
+    //  to suggest more probes will follow.  If enumeration fails, continue
+    //  probing individual files.
+    //
+
+    DirEntry->TargetCount++;
+    if (DirEntry->TargetCount == MAKE_DIRECTORY_CACHE_MIN_TARGETS) {
+        DirEntry->Files = YoriLibAllocateHashTable(64);
+        if (DirEntry->Files != NULL) {
+            MakeEnumerateDirectoryCacheEntry(DirEntry);
+        }
+    }
+
+    if (DirEntry->Enumerated) {
+        if (YoriLibHashLookupByKey(DirEntry->Files, &FileName) != NULL) {
+            return TRUE;
+        }
+        return FALSE;
+    }
+
+    return (BOOLEAN)(GetFileAttributes(FileToProbe->StartOfString) != (DWORD)-1);
+}
+
+/**
+ Attempt to determine the existence and timestamp of a target from the
+ directory cache.
+
+ @param MakeContext Pointer to the context.
+
+ @param Target Pointer to the target to query.
+
+ @return TRUE if the target has been probed from the directory cache, FALSE
+         if the target should be probed by opening it.
+ */
+BOOLEAN
+MakeProbeTargetFileFromDirectoryCache(
+    __in PMAKE_CONTEXT MakeContext,
+    __in PMAKE_TARGET Target
+    )
+{
+    PMAKE_DIRECTORY_CACHE_ENTRY DirEntry;
+    PMAKE_DIRECTORY_CACHE_FILE File;
+    PYORI_HASH_ENTRY HashEntry;
+    YORI_STRING DirName;
+    YORI_STRING FileName;
+
+    if (MakeContext->DirectoryCache == NULL ||
+        !MakeSplitTargetDirectory(Target, &DirName, &FileName)) {
+
+        return FALSE;
+    }
+
+    HashEntry = YoriLibHashLookupByKey(MakeContext->DirectoryCache, &DirName);
+    if (HashEntry == NULL) {
+        return FALSE;
+    }
+
+    DirEntry = HashEntry->Context;
+    if (!DirEntry->Enumerated) {
+        return FALSE;
+    }
+
+    HashEntry = YoriLibHashLookupByKey(DirEntry->Files, &FileName);
+    if (HashEntry == NULL) {
+        Target->FileProbed = TRUE;
+        return TRUE;
+    }
+
+    File = HashEntry->Context;
+    if (File->ProbeRequired) {
+        return FALSE;
+    }
+
+    Target->FileExists = TRUE;
+    Target->ModifiedTime.QuadPart = File->ModifiedTime.QuadPart;
+    Target->FileProbed = TRUE;
+    return TRUE;
+}
+
 /**
  Open the target and query its timestamp.  The target may not exist (implying
- it needs to be rebuilt.)
+ it needs to be rebuilt.)  While dependencies are being evaluated, this is
+ answered from the directory cache where possible.
+
+ @param MakeContext Pointer to the context.
 
  @param Target Pointer to the target to query.
  */
 VOID
 MakeProbeTargetFile(
+    __in PMAKE_CONTEXT MakeContext,
     __in PMAKE_TARGET Target
     )
 {
@@ -178,6 +769,10 @@ MakeProbeTargetFile(
 
     ASSERT(!Target->FileExists);
 
+    if (MakeProbeTargetFileFromDirectoryCache(MakeContext, Target)) {
+        return;
+    }
+
     //
     //  Check if the object already exists, and if so, when it was last
     //  modified.  Normally this would only need FILE_READ_ATTRIBUTES,
@@ -231,8 +826,10 @@ MakeProbeTargetFile(
  @param TargetNoQuotes On successful completion, points to the subset of the
         user specified name that is between quotes.
 
- @param FullPath On successful completion, updated to contain the full path
-        to this target.  The caller is expected to free this with
+ @param FullPath On input, an initialized string, which may refer to a caller
+        supplied buffer.  On successful completion, updated to contain the
+        full path to this target, which is only allocated if the supplied
+        buffer is too small.  The caller is expected to free this with
         @ref YoriLibFreeStringContents .
 
  @return TRUE to indicate success, FALSE to indicate failure.
@@ -242,7 +839,7 @@ MakeResolveFullTargetName(
     __in PMAKE_SCOPE_CONTEXT ScopeContext,
     __in PYORI_STRING TargetName,
     __out PYORI_STRING TargetNoQuotes,
-    __out PYORI_STRING FullPath
+    __inout PYORI_STRING FullPath
     )
 {
     YoriLibInitEmptyString(TargetNoQuotes);
@@ -255,7 +852,6 @@ MakeResolveFullTargetName(
         TargetNoQuotes->StartOfString++;
         TargetNoQuotes->LengthInChars = TargetNoQuotes->LengthInChars - 2;
     }
-    YoriLibInitEmptyString(FullPath);
     if (!YoriLibGetFullPathNameRelativeTo(&ScopeContext->HashEntry.Key, TargetNoQuotes, FALSE, FullPath, NULL)) {
         return FALSE;
     }
@@ -282,6 +878,11 @@ MakeLookupTarget(
     PMAKE_TARGET Target;
     PYORI_HASH_ENTRY HashEntry;
     PMAKE_CONTEXT MakeContext;
+    TCHAR FullPathBuffer[MAX_PATH];
+
+    YoriLibInitEmptyString(&FullPath);
+    FullPath.StartOfString = FullPathBuffer;
+    FullPath.LengthAllocated = MAX_PATH;
 
     if (!MakeResolveFullTargetName(ScopeContext, TargetName, &TargetNoQuotes, &FullPath)) {
         return FALSE;
@@ -326,6 +927,12 @@ MakeLookupOrCreateTarget(
     PMAKE_TARGET Target;
     PYORI_HASH_ENTRY HashEntry;
     PMAKE_CONTEXT MakeContext;
+    TCHAR FullPathBuffer[MAX_PATH];
+    DWORD Hash;
+
+    YoriLibInitEmptyString(&FullPath);
+    FullPath.StartOfString = FullPathBuffer;
+    FullPath.LengthAllocated = MAX_PATH;
 
     if (!MakeResolveFullTargetName(ScopeContext, TargetName, &TargetNoQuotes, &FullPath)) {
         return FALSE;
@@ -333,12 +940,26 @@ MakeLookupOrCreateTarget(
 
     MakeContext = ScopeContext->MakeContext;
 
-    HashEntry = YoriLibHashLookupByKey(MakeContext->Targets, &FullPath);
+    Hash = YoriLibHashKey(&FullPath);
+    HashEntry = YoriLibHashLookupByKeyWithHash(MakeContext->Targets, &FullPath, Hash);
     if (HashEntry != NULL) {
         Target = HashEntry->Context;
         YoriLibFreeStringContents(&FullPath);
     } else {
 
+        //
+        //  The target retains its name as the key, so if the name was
+        //  resolved into the stack buffer, it needs to be copied.
+        //
+
+        if (FullPath.MemoryToFree == NULL) {
+            YORI_STRING StackPath;
+            memcpy(&StackPath, &FullPath, sizeof(YORI_STRING));
+            if (!YoriLibCopyString(&FullPath, &StackPath)) {
+                return NULL;
+            }
+        }
+
         Target = MakeSlabAlloc(&ScopeContext->MakeContext->TargetAllocator, sizeof(MAKE_TARGET));
         if (Target == NULL) {
             YoriLibFreeStringContents(&FullPath);
@@ -363,12 +984,15 @@ MakeLookupOrCreateTarget(
         Target->DependenciesEvaluated = FALSE;
         Target->EvaluatingDependencies = FALSE;
         Target->InferenceRulePseudoTarget = FALSE;
+        Target->CriticalPathCostCalculated = FALSE;
+        Target->ContentDigestValid = FALSE;
+        Target->RemoteEligible = FALSE;
         Target->ModifiedTime.QuadPart = 0;
         Target->InferenceRule = NULL;
         Target->InferenceRuleParentTarget = NULL;
         YoriLibInitEmptyString(&Target->Recipe);
         YoriLibInitializeListHead(&Target->ExecCmds);
-        YoriLibHashInsertByKey(MakeContext->Targets, &FullPath, Target, &Target->HashEntry);
+        YoriLibHashInsertByKeyWithHash(MakeContext->Targets, &FullPath, Hash, Target, &Target->HashEntry);
         YoriLibAppendList(&MakeContext->TargetsList, &Target->ListEntry);
 
         YoriLibFreeStringContents(&FullPath);
@@ -480,6 +1104,9 @@ MakeCreateInferenceRule(
     ScopeContext->MakeContext->AllocInferenceRule++;
 
     InferenceRule->ReferenceCount = 1;
+    YoriLibInitializeListHead(&InferenceRule->ListEntry);
+    YoriLibInitializeListHead(&InferenceRule->ExtensionListEntry);
+    InferenceRule->Extension = NULL;
     YoriLibInitEmptyString(&InferenceRule->RelativeSourceDirectory);
     YoriLibInitEmptyString(&InferenceRule->SourceExtension);
     YoriLibInitEmptyString(&InferenceRule->RelativeTargetDirectory);
@@ -501,10 +1128,14 @@ MakeCreateInferenceRule(
                   &InferenceRule->TargetExtension);
 #endif
 
+    InferenceRule->ScopeContext = ScopeContext;
+    if (!MakeActivateInferenceRule(ScopeContext, InferenceRule, FALSE)) {
+        YoriLibFree(InferenceRule);
+        return NULL;
+    }
+
     InterlockedIncrement((INTERLOCKED_VOLATILE LONG *)&Target->ReferenceCount);
     InferenceRule->Target = Target;
-    InferenceRule->ScopeContext = ScopeContext;
-    YoriLibInsertList(&ScopeContext->InferenceRuleList, &InferenceRule->ListEntry);
 
     return InferenceRule;
 }
@@ -534,10 +1165,7 @@ MakeDereferenceInferenceRule(
 {
     InferenceRule->ReferenceCount--;
     if (InferenceRule->ReferenceCount == 0) {
-        if (!YoriLibIsListEmpty(&InferenceRule->ListEntry)) {
-            YoriLibRemoveListItem(&InferenceRule->ListEntry);
-            YoriLibInitializeListHead(&InferenceRule->ListEntry);
-        }
+        MakeDeactivateInferenceRule(InferenceRule);
         if (InferenceRule->Target != NULL) {
             ASSERT(InferenceRule->Target->InferenceRule == NULL);
             MakeDereferenceTarget(InferenceRule->Target);
@@ -564,10 +1192,11 @@ MakeDeactivateAllInferenceRules(
     while (ListEntry != NULL) {
         InferenceRule = CONTAINING_RECORD(ListEntry, MAKE_INFERENCE_RULE, ListEntry);
         ListEntry = YoriLibGetNextListEntry(&ScopeContext->InferenceRuleList, ListEntry);
-        YoriLibRemoveListItem(&InferenceRule->ListEntry);
-        YoriLibInitializeListHead(&InferenceRule->ListEntry);
+        MakeDeactivateInferenceRule(InferenceRule);
         MakeDereferenceInferenceRule(InferenceRule);
     }
+
+    MakeDeleteInferenceRuleExtensions(ScopeContext);
 }
 
 /**
@@ -647,14 +1276,46 @@ MakeGetNextInferenceRuleTargetExtension(
     __in_opt PMAKE_INFERENCE_RULE PreviousRule
     )
 {
-    PMAKE_INFERENCE_RULE NextRule;
+    PYORI_LIST_ENTRY ListEntry;
+    PYORI_HASH_ENTRY HashEntry;
+    PMAKE_SCOPE_CONTEXT CurrentScope;
+    PMAKE_INFERENCE_RULE_EXTENSION Extension;
 
-    NextRule = MakeGetNextInferenceRule(TopScope, PreviousRule);
-    while (NextRule != NULL) {
-        if (YoriLibCompareStringIns(TargetExt, &NextRule->TargetExtension) == 0) {
-            return NextRule;
+    //
+    //  If starting from the top, use the top scope and look up the
+    //  extension.  If resuming, use the scope and extension of the
+    //  previous entry and the list position of it.
+    //
+
+    if (PreviousRule == NULL) {
+        CurrentScope = TopScope;
+        Extension = NULL;
+        ListEntry = NULL;
+    } else {
+        ASSERT(PreviousRule->Extension != NULL);
+        CurrentScope = PreviousRule->ScopeContext;
+        Extension = PreviousRule->Extension;
+        ListEntry = &PreviousRule->ExtensionListEntry;
+    }
+
+    while (CurrentScope != NULL) {
+        if (Extension == NULL && CurrentScope->InferenceRuleExtensions != NULL) {
+            HashEntry = YoriLibHashLookupByKey(CurrentScope->InferenceRuleExtensions, TargetExt);
+            if (HashEntry != NULL) {
+                Extension = HashEntry->Context;
+            }
         }
-        NextRule = MakeGetNextInferenceRule(TopScope, NextRule);
+
+        if (Extension != NULL) {
+            ListEntry = YoriLibGetNextListEntry(&Extension->RuleList, ListEntry);
+            if (ListEntry != NULL) {
+                return CONTAINING_RECORD(ListEntry, MAKE_INFERENCE_RULE, ExtensionListEntry);
+            }
+        }
+
+        CurrentScope = CurrentScope->ParentScope;
+        Extension = NULL;
+        ListEntry = NULL;
     }
 
     return NULL;
@@ -703,11 +1364,151 @@ MakeCountExtraInferenceRuleChars(
         CharsAdded++;
     }
 
-    if (CharsAdded > CharsRemoved) {
-        return CharsAdded - CharsRemoved;
+    if (CharsAdded > CharsRemoved) {
+        return CharsAdded - CharsRemoved;
+    }
+
+    return 0;
+}
+
+/**
+ Make an inference rule available for resolving targets within a scope.
+ The rule is added to the list of all rules in the scope and to the list of
+ rules that generate its target extension.
+
+ @param ScopeContext Pointer to the scope context.
+
+ @param InferenceRule Pointer to the inference rule, which must not currently
+        be active.
+
+ @param Append If TRUE, the rule is added after existing rules so that it
+        has the lowest precedence.  If FALSE, the rule is added before
+        existing rules so that it has the highest precedence.
+
+ @return TRUE to indicate success, FALSE on allocation failure.
+ */
+BOOLEAN
+MakeActivateInferenceRule(
+    __in PMAKE_SCOPE_CONTEXT ScopeContext,
+    __in PMAKE_INFERENCE_RULE InferenceRule,
+    __in BOOLEAN Append
+    )
+{
+    PMAKE_INFERENCE_RULE_EXTENSION Extension;
+    PYORI_HASH_ENTRY HashEntry;
+    YORI_STRING Key;
+    YORI_ALLOC_SIZE_T CharsNeeded;
+
+    ASSERT(InferenceRule->Extension == NULL);
+    ASSERT(InferenceRule->ScopeContext == ScopeContext);
+
+    if (ScopeContext->InferenceRuleExtensions == NULL) {
+        ScopeContext->InferenceRuleExtensions = YoriLibAllocateHashTable(32);
+        if (ScopeContext->InferenceRuleExtensions == NULL) {
+            return FALSE;
+        }
+    }
+
+    HashEntry = YoriLibHashLookupByKey(ScopeContext->InferenceRuleExtensions, &InferenceRule->TargetExtension);
+    if (HashEntry != NULL) {
+        Extension = HashEntry->Context;
+    } else {
+        Extension = YoriLibMalloc(sizeof(MAKE_INFERENCE_RULE_EXTENSION) + (InferenceRule->TargetExtension.LengthInChars + 1) * sizeof(TCHAR));
+        if (Extension == NULL) {
+            return FALSE;
+        }
+
+        YoriLibInitEmptyString(&Key);
+        Key.StartOfString = (LPTSTR)(Extension + 1);
+        Key.LengthInChars = InferenceRule->TargetExtension.LengthInChars;
+        Key.LengthAllocated = Key.LengthInChars + 1;
+        memcpy(Key.StartOfString, InferenceRule->TargetExtension.StartOfString, Key.LengthInChars * sizeof(TCHAR));
+        Key.StartOfString[Key.LengthInChars] = '\0';
+
+        YoriLibInitializeListHead(&Extension->RuleList);
+        YoriLibHashInsertByKey(ScopeContext->InferenceRuleExtensions, &Key, Extension, &Extension->HashEntry);
+        YoriLibAppendList(&ScopeContext->InferenceRuleExtensionList, &Extension->ListEntry);
+    }
+
+    InferenceRule->Extension = Extension;
+    if (Append) {
+        YoriLibAppendList(&ScopeContext->InferenceRuleList, &InferenceRule->ListEntry);
+        YoriLibAppendList(&Extension->RuleList, &InferenceRule->ExtensionListEntry);
+    } else {
+        YoriLibInsertList(&ScopeContext->InferenceRuleList, &InferenceRule->ListEntry);
+        YoriLibInsertList(&Extension->RuleList, &InferenceRule->ExtensionListEntry);
+    }
+
+    CharsNeeded = MakeCountExtraInferenceRuleChars(InferenceRule);
+    if (CharsNeeded > ScopeContext->InferenceRuleExtraChars) {
+        ScopeContext->InferenceRuleExtraChars = CharsNeeded;
+    }
+
+    return TRUE;
+}
+
+/**
+ Indicate that an inference rule can no longer be used to resolve new
+ targets.  This does not change the reference count of the rule.
+
+ @param InferenceRule Pointer to the inference rule.
+ */
+VOID
+MakeDeactivateInferenceRule(
+    __in PMAKE_INFERENCE_RULE InferenceRule
+    )
+{
+    if (!YoriLibIsListEmpty(&InferenceRule->ListEntry)) {
+        YoriLibRemoveListItem(&InferenceRule->ListEntry);
+        YoriLibInitializeListHead(&InferenceRule->ListEntry);
+    }
+
+    if (InferenceRule->Extension != NULL) {
+        YoriLibRemoveListItem(&InferenceRule->ExtensionListEntry);
+        YoriLibInitializeListHead(&InferenceRule->ExtensionListEntry);
+        InferenceRule->Extension = NULL;
+    }
+}
+
+/**
+ Free the index of inference rules by target extension for a scope.  Any
+ rules still in the index are removed from it.
+
+ @param ScopeContext Pointer to the scope context.
+ */
+VOID
+MakeDeleteInferenceRuleExtensions(
+    __in PMAKE_SCOPE_CONTEXT ScopeContext
+    )
+{
+    PMAKE_INFERENCE_RULE_EXTENSION Extension;
+    PMAKE_INFERENCE_RULE InferenceRule;
+    PYORI_LIST_ENTRY ListEntry;
+    PYORI_LIST_ENTRY RuleListEntry;
+
+    ListEntry = YoriLibGetNextListEntry(&ScopeContext->InferenceRuleExtensionList, NULL);
+    while (ListEntry != NULL) {
+        Extension = CONTAINING_RECORD(ListEntry, MAKE_INFERENCE_RULE_EXTENSION, ListEntry);
+        ListEntry = YoriLibGetNextListEntry(&ScopeContext->InferenceRuleExtensionList, ListEntry);
+
+        RuleListEntry = YoriLibGetNextListEntry(&Extension->RuleList, NULL);
+        while (RuleListEntry != NULL) {
+            InferenceRule = CONTAINING_RECORD(RuleListEntry, MAKE_INFERENCE_RULE, ExtensionListEntry);
+            RuleListEntry = YoriLibGetNextListEntry(&Extension->RuleList, RuleListEntry);
+            YoriLibRemoveListItem(&InferenceRule->ExtensionListEntry);
+            YoriLibInitializeListHead(&InferenceRule->ExtensionListEntry);
+            InferenceRule->Extension = NULL;
+        }
+
+        YoriLibHashRemoveByEntry(&Extension->HashEntry);
+        YoriLibRemoveListItem(&Extension->ListEntry);
+        YoriLibFree(Extension);
     }
 
-    return 0;
+    if (ScopeContext->InferenceRuleExtensions != NULL) {
+        YoriLibFreeEmptyHashTable(ScopeContext->InferenceRuleExtensions);
+        ScopeContext->InferenceRuleExtensions = NULL;
+    }
 }
 
 /**
@@ -892,6 +1693,7 @@ MakeFindInferenceRuleForTarget(
 {
     PMAKE_INFERENCE_RULE InferenceRule;
     PMAKE_INFERENCE_RULE NestedRule;
+    PMAKE_SCOPE_CONTEXT CurrentScope;
     YORI_STRING TargetExt;
     YORI_STRING TargetNoExt;
     PYORI_STRING FileToProbe;
@@ -933,28 +1735,28 @@ MakeFindInferenceRuleForTarget(
         return TRUE;
     }
 
+    //
+    //  If no rule can generate this extension, there's nothing to probe.
+    //
+
+    if (MakeGetNextInferenceRuleTargetExtension(ScopeContext, &TargetExt, NULL) == NULL) {
+        return TRUE;
+    }
+
     //
     //  Find the longest source extension from the known set of inference
     //  rules.  This is used to size the full path name allocation when
     //  probing for existing files.  Note this considers all rules, not just
     //  those matching extensions, so that it can correctly allocate buffers
-    //  for the recursive inference rule search below.
+    //  for the recursive inference rule search below.  Each scope tracks
+    //  the largest value for any rule added to it.
     //
 
     LongestCharsNeeded = 0;
-    FoundRuleWithTargetExtension = FALSE;
-    InferenceRule = MakeGetNextInferenceRule(ScopeContext, NULL);
-    while (InferenceRule != NULL) {
-        FoundRuleWithTargetExtension = TRUE;
-        CharsNeeded = MakeCountExtraInferenceRuleChars(InferenceRule);
-        if (CharsNeeded > LongestCharsNeeded) {
-            LongestCharsNeeded = CharsNeeded;
+    for (CurrentScope = ScopeContext; CurrentScope != NULL; CurrentScope = CurrentScope->ParentScope) {
+        if (CurrentScope->InferenceRuleExtraChars > LongestCharsNeeded) {
+            LongestCharsNeeded = CurrentScope->InferenceRuleExtraChars;
         }
-        InferenceRule = MakeGetNextInferenceRule(ScopeContext, InferenceRule);
-    }
-
-    if (!FoundRuleWithTargetExtension) {
-        return TRUE;
     }
 
     FileToProbe = &ScopeContext->MakeContext->FilesToProbe[0];
@@ -987,7 +1789,7 @@ MakeFindInferenceRuleForTarget(
 #if MAKE_DEBUG_TARGETS
             YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("GetFileAttributes for: %s\n"), FileToProbe->StartOfString);
 #endif
-            if (GetFileAttributes(FileToProbe->StartOfString) != (DWORD)-1) {
+            if (MakeInferenceProbeFile(ScopeContext->MakeContext, FileToProbe)) {
                 FileToProbe->LengthInChars = FileToProbe->LengthInChars + InferenceRule->SourceExtension.LengthInChars;
                 if (!MakeAssignInferenceRuleToTarget(ScopeContext, Target, InferenceRule, FileToProbe)) {
                     return FALSE;
@@ -1041,7 +1843,7 @@ MakeFindInferenceRuleForTarget(
 #if MAKE_DEBUG_TARGETS
                     YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Nested GetFileAttributes for: %s\n"), NestedFileToProbe->StartOfString);
 #endif
-                    if (GetFileAttributes(NestedFileToProbe->StartOfString) != (DWORD)-1) {
+                    if (MakeInferenceProbeFile(ScopeContext->MakeContext, NestedFileToProbe)) {
 
                         //
                         //  First, generate the outer rule, assigning the
@@ -1147,6 +1949,14 @@ MakeFindInferenceRulesForScope(
     )
 {
     PMAKE_TARGET Target;
+    PMAKE_CONTEXT MakeContext;
+    LARGE_INTEGER StartTime;
+    LARGE_INTEGER EndTime;
+    BOOLEAN Result;
+
+    MakeContext = ScopeContext->MakeContext;
+    QueryPerformanceCounter(&StartTime);
+    Result = TRUE;
 
     while (TRUE) {
         if (YoriLibIsListEmpty(&ScopeContext->InferenceRuleNeededList)) {
@@ -1161,15 +1971,20 @@ MakeFindInferenceRulesForScope(
             continue;
         }
 
+        MakeContext->InferenceRuleSearches++;
         if (!MakeFindInferenceRuleForTarget(ScopeContext, Target)) {
 #if MAKE_DEBUG_TARGETS
             YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Search for inference rule failed for: %y\n"), &Target->HashEntry.Key);
 #endif
-            return FALSE;
+            Result = FALSE;
+            break;
         }
     }
 
-    return TRUE;
+    QueryPerformanceCounter(&EndTime);
+    MakeContext->TimeInInferenceRules = MakeContext->TimeInInferenceRules + EndTime.QuadPart - StartTime.QuadPart;
+
+    return Result;
 }
 
 
@@ -1224,9 +2039,9 @@ MakeCreateParentChildDependency(
 
  @param VariableData On successful completion, updated to contain the
         variable contents.  This may point directly at previously generated
-        data, or may be allocated and generated as part of this call.  The
-        caller should call YoriLibFreeStringContents on this string which
-        may or may not have any data to free.
+        data, or may be allocated from the expansion arena as part of this
+        call.  The caller should call YoriLibFreeStringContents on this
+        string which may or may not have any data to free.
 
  @return TRUE to indicate success, FALSE to indicate failure.
  */
@@ -1257,7 +2072,7 @@ MakeExpandTargetVariable(
     if (SymbolChars == 0) {
         return FALSE;
     }
-    MakeProbeTargetFile(Target);
+    MakeProbeTargetFile(MakeContext, Target);
 
     YoriLibInitEmptyString(&BaseVariableName);
     BaseVariableName.StartOfString = VariableName->StartOfString;
@@ -1305,7 +2120,7 @@ MakeExpandTargetVariable(
         ListEntry = YoriLibGetNextListEntry(&Target->ParentDependents, NULL);
         while (ListEntry != NULL) {
             DependentTarget = CONTAINING_RECORD(ListEntry, MAKE_TARGET_DEPENDENCY, ChildDependents);
-            MakeProbeTargetFile(DependentTarget->Parent);
+            MakeProbeTargetFile(MakeContext, DependentTarget->Parent);
             if (!Target->FileExists ||
                 !DependentTarget->Parent->FileExists ||
                 DependentTarget->Parent->ModifiedTime.QuadPart > Target->ModifiedTime.QuadPart) {
@@ -1315,7 +2130,7 @@ MakeExpandTargetVariable(
             ListEntry = YoriLibGetNextListEntry(&Target->ParentDependents, ListEntry);
         }
 
-        if (!YoriLibAllocateString(VariableData, Index + 1)) {
+        if (!MakeArenaAllocateString(&MakeContext->ExpansionArena, VariableData, Index + 1)) {
             return FALSE;
         }
         MakeContext->AllocVariableData++;
@@ -1324,7 +2139,7 @@ MakeExpandTargetVariable(
         ListEntry = YoriLibGetNextListEntry(&Target->ParentDependents, NULL);
         while (ListEntry != NULL) {
             DependentTarget = CONTAINING_RECORD(ListEntry, MAKE_TARGET_DEPENDENCY, ChildDependents);
-            MakeProbeTargetFile(DependentTarget->Parent);
+            MakeProbeTargetFile(MakeContext, DependentTarget->Parent);
             if (!Target->FileExists ||
                 !DependentTarget->Parent->FileExists ||
                 DependentTarget->Parent->ModifiedTime.QuadPart > Target->ModifiedTime.QuadPart) {
@@ -1350,7 +2165,7 @@ MakeExpandTargetVariable(
             ListEntry = YoriLibGetNextListEntry(&Target->ParentDependents, ListEntry);
         }
 
-        if (!YoriLibAllocateString(VariableData, Index + 1)) {
+        if (!MakeArenaAllocateString(&MakeContext->ExpansionArena, VariableData, Index + 1)) {
             return FALSE;
         }
         MakeContext->AllocVariableData++;
@@ -1383,7 +2198,7 @@ MakeExpandTargetVariable(
         BOOLEAN PathMatch;
 
         CharsNeeded = MakeCountExtraInferenceRuleChars(Target->InferenceRule);
-        if (!YoriLibAllocateString(VariableData, Target->HashEntry.Key.LengthInChars + CharsNeeded + 1)) {
+        if (!MakeArenaAllocateString(&MakeContext->ExpansionArena, VariableData, Target->HashEntry.Key.LengthInChars + CharsNeeded + 1)) {
             return FALSE;
         }
         MakeContext->AllocVariableData++;
@@ -1542,13 +2357,12 @@ MakeGenerateExecScriptForTarget(
     )
 {
     YORI_STRING Line;
+    YORI_STRING ExpandedLine;
     YORI_ALLOC_SIZE_T StartLineIndex;
     YORI_ALLOC_SIZE_T Index;
     PYORI_STRING SourceString;
     PMAKE_CMD_TO_EXEC CmdToExec;
 
-    UNREFERENCED_PARAMETER(MakeContext);
-
     //
     //  NMAKE will use the inference rule if the target's recipe is empty and
     //  an inference rule exists.  This allows a makefile to specify
@@ -1579,7 +2393,14 @@ MakeGenerateExecScriptForTarget(
     ASSERT(Target->ScopeContext != NULL);
     __analysis_assume(Target->ScopeContext != NULL);
 
+    //
+    //  Commands are retained until the program exits, so they are allocated
+    //  from the string arena.  Each command is expanded into a reusable
+    //  buffer first so the arena allocation can be an exact size.
+    //
+
     YoriLibInitEmptyString(&Line);
+    YoriLibInitEmptyString(&ExpandedLine);
     StartLineIndex = 0;
     for (Index = 0; Index < SourceString->LengthInChars; Index++) {
         if (SourceString->StartOfString[Index] == '\n') {
@@ -1588,8 +2409,9 @@ MakeGenerateExecScriptForTarget(
 
             StartLineIndex = Index + 1;
 
-            CmdToExec = YoriLibMalloc(sizeof(MAKE_CMD_TO_EXEC));
+            CmdToExec = MakeArenaAlloc(&MakeContext->StringArena, sizeof(MAKE_CMD_TO_EXEC));
             if (CmdToExec == NULL) {
+                YoriLibFreeStringContents(&ExpandedLine);
                 return FALSE;
             }
 
@@ -1615,15 +2437,25 @@ MakeGenerateExecScriptForTarget(
             }
 
 
-            YoriLibInitEmptyString(&CmdToExec->Cmd);
-            if (!MakeExpandVariables(Target->ScopeContext, Target, &CmdToExec->Cmd, &Line, NULL)) {
+            if (!MakeExpandVariables(Target->ScopeContext, Target, &ExpandedLine, &Line, NULL)) {
+                YoriLibFreeStringContents(&ExpandedLine);
+                return FALSE;
+            }
+
+            if (!MakeArenaAllocateString(&MakeContext->StringArena, &CmdToExec->Cmd, ExpandedLine.LengthInChars + 1)) {
+                YoriLibFreeStringContents(&ExpandedLine);
                 return FALSE;
             }
 
+            memcpy(CmdToExec->Cmd.StartOfString, ExpandedLine.StartOfString, ExpandedLine.LengthInChars * sizeof(TCHAR));
+            CmdToExec->Cmd.StartOfString[ExpandedLine.LengthInChars] = '\0';
+            CmdToExec->Cmd.LengthInChars = ExpandedLine.LengthInChars;
+
             YoriLibAppendList(&Target->ExecCmds, &CmdToExec->ListEntry);
         }
     }
 
+    YoriLibFreeStringContents(&ExpandedLine);
     return TRUE;
 }
 
@@ -1659,23 +2491,28 @@ MakeMarkTargetForRebuild(
         return FALSE;
     }
 
-    if (!MakeGenerateExecScriptForTarget(MakeContext, Target)) {
-        return FALSE;
+    //
+    //  The commands may have already been generated to check whether the
+    //  target's inputs have changed.
+    //
+
+    if (YoriLibIsListEmpty(&Target->ExecCmds)) {
+        if (!MakeGenerateExecScriptForTarget(MakeContext, Target)) {
+            return FALSE;
+        }
     }
 
     //
-    //  MSFIX Ideally these lists would be sorted or approximately sorted
-    //  where the targets that have the most dependencies are done before
-    //  those with fewer dependencies.  Doing this intelligently really
-    //  requires knowledge of all ancestors.  Appending to the end means
-    //  that depth first traversal should ensure that all dependencies are
-    //  satisfied, and if many targets depend on one target that target
-    //  should be uncovered relatively early.
+    //  Appending to the end means that depth first traversal should ensure
+    //  that all dependencies are satisfied.  Once all targets are known,
+    //  MakePrioritizeTargets reorders ready targets by the cost of the
+    //  chain of targets that depend on them.
     //
 
     Target->RebuildRequired = TRUE;
     if (Target->NumberParentsToBuild == 0) {
         YoriLibAppendList(&MakeContext->TargetsReady, &Target->RebuildList);
+        MakeTraceTargetReady(MakeContext, Target);
     } else {
         YoriLibAppendList(&MakeContext->TargetsWaiting, &Target->RebuildList);
     }
@@ -1730,6 +2567,400 @@ MakeApplyInferenceRuleDependencyToTarget(
     return TRUE;
 }
 
+/**
+ A list of targets whose evaluation can be prepared concurrently, shared
+ between the threads performing that work.
+ */
+typedef struct _MAKE_EVALUATE_CONTEXT {
+
+    /**
+     Pointer to the context.
+     */
+    PMAKE_CONTEXT MakeContext;
+
+    /**
+     An array of targets.
+     */
+    PMAKE_TARGET *Targets;
+
+    /**
+     The number of elements in Targets that are populated.
+     */
+    DWORD TargetCount;
+
+    /**
+     The number of elements allocated in Targets.
+     */
+    DWORD TargetsAllocated;
+
+    /**
+     The index of the next element in Targets to process.  This is updated
+     with interlocked operations.
+     */
+    DWORD NextEntry;
+
+} MAKE_EVALUATE_CONTEXT, *PMAKE_EVALUATE_CONTEXT;
+
+/**
+ Add a target to a list of targets to prepare concurrently.  If the list
+ cannot be extended, the target is not added, and its preparation occurs
+ when dependencies are evaluated.
+
+ @param EvaluateContext Pointer to the list of targets.
+
+ @param Target Pointer to the target to add.
+ */
+VOID
+MakeAppendEvaluateTarget(
+    __inout PMAKE_EVALUATE_CONTEXT EvaluateContext,
+    __in PMAKE_TARGET Target
+    )
+{
+    PMAKE_TARGET *NewTargets;
+    DWORD NewAllocated;
+
+    if (EvaluateContext->TargetCount >= EvaluateContext->TargetsAllocated) {
+        NewAllocated = EvaluateContext->TargetsAllocated * 2;
+        if (NewAllocated < 1024) {
+            NewAllocated = 1024;
+        }
+
+        if (!YoriLibIsSizeAllocatable(NewAllocated * sizeof(PMAKE_TARGET))) {
+            return;
+        }
+
+        NewTargets = YoriLibMalloc((YORI_ALLOC_SIZE_T)(NewAllocated * sizeof(PMAKE_TARGET)));
+        if (NewTargets == NULL) {
+            return;
+        }
+
+        if (EvaluateContext->Targets != NULL) {
+            memcpy(NewTargets, EvaluateContext->Targets, EvaluateContext->TargetCount * sizeof(PMAKE_TARGET));
+            YoriLibFree(EvaluateContext->Targets);
+        }
+
+        EvaluateContext->Targets = NewTargets;
+        EvaluateContext->TargetsAllocated = NewAllocated;
+    }
+
+    EvaluateContext->Targets[EvaluateContext->TargetCount] = Target;
+    EvaluateContext->TargetCount++;
+}
+
+/**
+ Find every target that a target depends upon, directly or indirectly,
+ which has not had its dependencies evaluated.  This applies inference rule
+ dependencies and detects circular dependencies, which modify the graph and
+ therefore occur on a single thread, so that the remaining preparation can
+ occur concurrently.  Targets are added to the list after the targets they
+ depend upon.
+
+ @param EvaluateContext Pointer to the list of targets to populate.
+
+ @param Target Pointer to the target to collect.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOLEAN
+MakeCollectTargetsForEvaluation(
+    __inout PMAKE_EVALUATE_CONTEXT EvaluateContext,
+    __in PMAKE_TARGET Target
+    )
+{
+    PMAKE_TARGET_DEPENDENCY Dependency;
+    PMAKE_TARGET Parent;
+    PYORI_LIST_ENTRY ListEntry;
+
+    if (Target->DependenciesCollected || Target->DependenciesEvaluated) {
+        return TRUE;
+    }
+
+    if (Target->EvaluatingDependencies) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Circular dependency encountered on %y\n"), &Target->HashEntry.Key);
+        return FALSE;
+    }
+
+    Target->EvaluatingDependencies = TRUE;
+
+    ListEntry = YoriLibGetNextListEntry(&Target->ParentDependents, NULL);
+    while (ListEntry != NULL) {
+        Dependency = CONTAINING_RECORD(ListEntry, MAKE_TARGET_DEPENDENCY, ChildDependents);
+        ASSERT(Dependency->Child == Target);
+        Parent = Dependency->Parent;
+
+        if (YoriLibIsListEmpty(&Parent->ParentDependents) &&
+            !Parent->ExplicitRecipeFound &&
+            Parent->InferenceRuleParentTarget != NULL) {
+
+            if (!MakeApplyInferenceRuleDependencyToTarget(EvaluateContext->MakeContext, Parent)) {
+                Target->EvaluatingDependencies = FALSE;
+                return FALSE;
+            }
+        }
+
+        if (!MakeCollectTargetsForEvaluation(EvaluateContext, Parent)) {
+            Target->EvaluatingDependencies = FALSE;
+            return FALSE;
+        }
+
+        ListEntry = YoriLibGetNextListEntry(&Target->ParentDependents, ListEntry);
+    }
+
+    Target->EvaluatingDependencies = FALSE;
+    Target->DependenciesCollected = TRUE;
+    MakeAppendEvaluateTarget(EvaluateContext, Target);
+    return TRUE;
+}
+
+/**
+ A worker thread which probes the files of targets in a list.  Each target
+ is probed by one thread, and the directory cache is not modified while
+ dependencies are evaluated, so threads do not need to synchronize beyond
+ selecting the next target.
+
+ @param Context Pointer to the evaluate context.
+
+ @return Thread exit code, currently always zero.
+ */
+DWORD WINAPI
+MakeProbeTargetsWorker(
+    __in PVOID Context
+    )
+{
+    PMAKE_EVALUATE_CONTEXT EvaluateContext;
+    DWORD Index;
+
+    EvaluateContext = (PMAKE_EVALUATE_CONTEXT)Context;
+
+    while (TRUE) {
+        Index = InterlockedIncrement((INTERLOCKED_VOLATILE LONG *)&EvaluateContext->NextEntry) - 1;
+        if (Index >= EvaluateContext->TargetCount) {
+            break;
+        }
+
+        MakeProbeTargetFile(EvaluateContext->MakeContext, EvaluateContext->Targets[Index]);
+    }
+
+    return 0;
+}
+
+/**
+ A worker thread which calculates the digests of the contents of targets in
+ a list.  Each target occurs in the list once, so threads do not need to
+ synchronize beyond selecting the next target.
+
+ @param Context Pointer to the evaluate context.
+
+ @return Thread exit code, currently always zero.
+ */
+DWORD WINAPI
+MakeDigestTargetsWorker(
+    __in PVOID Context
+    )
+{
+    PMAKE_EVALUATE_CONTEXT EvaluateContext;
+    DWORD Index;
+
+    EvaluateContext = (PMAKE_EVALUATE_CONTEXT)Context;
+
+    while (TRUE) {
+        Index = InterlockedIncrement((INTERLOCKED_VOLATILE LONG *)&EvaluateContext->NextEntry) - 1;
+        if (Index >= EvaluateContext->TargetCount) {
+            break;
+        }
+
+        MakeGetTargetContentDigest(EvaluateContext->MakeContext, EvaluateContext->Targets[Index]);
+    }
+
+    return 0;
+}
+
+/**
+ Process every target in a list using a thread per requested child process,
+ including the current thread.  If no threads can be created, the list is
+ processed on the current thread.
+
+ @param EvaluateContext Pointer to the list of targets.
+
+ @param Worker The worker thread function to process the list.
+ */
+VOID
+MakeRunEvaluateWorkers(
+    __inout PMAKE_EVALUATE_CONTEXT EvaluateContext,
+    __in LPTHREAD_START_ROUTINE Worker
+    )
+{
+    HANDLE Threads[64];
+    DWORD ThreadCount;
+    DWORD ThreadId;
+    DWORD Index;
+
+    EvaluateContext->NextEntry = 0;
+
+    ThreadCount = EvaluateContext->MakeContext->NumberProcesses;
+    if (ThreadCount > sizeof(Threads)/sizeof(Threads[0])) {
+        ThreadCount = sizeof(Threads)/sizeof(Threads[0]);
+    }
+    if (ThreadCount > EvaluateContext->TargetCount) {
+        ThreadCount = EvaluateContext->TargetCount;
+    }
+
+    //
+    //  The current thread is also a worker.
+    //
+
+    if (ThreadCount > 0) {
+        ThreadCount--;
+    }
+
+    for (Index = 0; Index < ThreadCount; Index++) {
+        Threads[Index] = CreateThread(NULL, 0, Worker, EvaluateContext, 0, &ThreadId);
+        if (Threads[Index] == NULL) {
+            break;
+        }
+    }
+    ThreadCount = Index;
+
+    Worker(EvaluateContext);
+
+    if (ThreadCount > 0) {
+        WaitForMultipleObjects(ThreadCount, Threads, TRUE, INFINITE);
+        for (Index = 0; Index < ThreadCount; Index++) {
+            CloseHandle(Threads[Index]);
+        }
+    }
+}
+
+/**
+ Add a target to a list of targets whose content digest should be
+ calculated, unless it has already been added or calculated.
+
+ @param DigestContext Pointer to the list of targets.
+
+ @param Target Pointer to the target.
+ */
+VOID
+MakeAppendDigestTarget(
+    __inout PMAKE_EVALUATE_CONTEXT DigestContext,
+    __in PMAKE_TARGET Target
+    )
+{
+    if (Target->ContentDigestValid ||
+        Target->ContentDigestPrefetched ||
+        !Target->FileExists) {
+
+        return;
+    }
+
+    Target->ContentDigestPrefetched = TRUE;
+    MakeAppendEvaluateTarget(DigestContext, Target);
+}
+
+/**
+ Perform the work needed to evaluate the dependencies of a target which
+ does not modify the graph, concurrently across worker threads.  This
+ consists of probing the file of every target that needs evaluation and,
+ for targets which appear out of date by timestamp but may be found to be
+ current from their digests, calculating the digests of the target and
+ its inputs.  Once complete, evaluating dependencies only needs to compare
+ results that are already available.
+
+ @param MakeContext Pointer to the context.
+
+ @param Target Pointer to the target whose dependencies will be evaluated.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOLEAN
+MakePrepareDependenciesForTarget(
+    __in PMAKE_CONTEXT MakeContext,
+    __in PMAKE_TARGET Target
+    )
+{
+    MAKE_EVALUATE_CONTEXT EvaluateContext;
+    MAKE_EVALUATE_CONTEXT DigestContext;
+    PMAKE_TARGET_DEPENDENCY Dependency;
+    PMAKE_TARGET Parent;
+    PMAKE_TARGET Child;
+    PYORI_LIST_ENTRY ListEntry;
+    BOOLEAN ParentNewer;
+    DWORD Index;
+
+    ZeroMemory(&EvaluateContext, sizeof(EvaluateContext));
+    EvaluateContext.MakeContext = MakeContext;
+
+    if (!MakeCollectTargetsForEvaluation(&EvaluateContext, Target)) {
+        if (EvaluateContext.Targets != NULL) {
+            YoriLibFree(EvaluateContext.Targets);
+        }
+        return FALSE;
+    }
+
+    MakeRunEvaluateWorkers(&EvaluateContext, MakeProbeTargetsWorker);
+
+    //
+    //  A target is checked by digest if a file it depends on is newer than
+    //  it and nothing it depends on is rebuilt.  Which targets are rebuilt
+    //  isn't known yet, so this calculates digests for every target with a
+    //  newer input and a recorded digest, some of which may not be needed.
+    //
+
+    if (MakeContext->DigestTable != NULL) {
+        ZeroMemory(&DigestContext, sizeof(DigestContext));
+        DigestContext.MakeContext = MakeContext;
+
+        for (Index = 0; Index < EvaluateContext.TargetCount; Index++) {
+            Child = EvaluateContext.Targets[Index];
+            if (!Child->FileExists ||
+                YoriLibHashLookupByKey(MakeContext->DigestTable, &Child->HashEntry.Key) == NULL) {
+
+                continue;
+            }
+
+            ParentNewer = FALSE;
+            ListEntry = YoriLibGetNextListEntry(&Child->ParentDependents, NULL);
+            while (ListEntry != NULL) {
+                Dependency = CONTAINING_RECORD(ListEntry, MAKE_TARGET_DEPENDENCY, ChildDependents);
+                Parent = Dependency->Parent;
+                if (Parent->FileProbed &&
+                    Parent->FileExists &&
+                    Parent->ModifiedTime.QuadPart > Child->ModifiedTime.QuadPart) {
+
+                    ParentNewer = TRUE;
+                    break;
+                }
+                ListEntry = YoriLibGetNextListEntry(&Child->ParentDependents, ListEntry);
+            }
+
+            if (!ParentNewer) {
+                continue;
+            }
+
+            MakeAppendDigestTarget(&DigestContext, Child);
+            ListEntry = YoriLibGetNextListEntry(&Child->ParentDependents, NULL);
+            while (ListEntry != NULL) {
+                Dependency = CONTAINING_RECORD(ListEntry, MAKE_TARGET_DEPENDENCY, ChildDependents);
+                MakeAppendDigestTarget(&DigestContext, Dependency->Parent);
+                ListEntry = YoriLibGetNextListEntry(&Child->ParentDependents, ListEntry);
+            }
+        }
+
+        if (DigestContext.TargetCount > 0) {
+            MakeRunEvaluateWorkers(&DigestContext, MakeDigestTargetsWorker);
+        }
+
+        if (DigestContext.Targets != NULL) {
+            YoriLibFree(DigestContext.Targets);
+        }
+    }
+
+    if (EvaluateContext.Targets != NULL) {
+        YoriLibFree(EvaluateContext.Targets);
+    }
+
+    return TRUE;
+}
+
 /**
  For a specified target, check whether anything it depends up requires
  rebuilding, and if so, indicate that this target requires rebuilding also.
@@ -1760,7 +2991,7 @@ MakeDetermineDependenciesForTarget(
         return FALSE;
     }
 
-    MakeProbeTargetFile(Target);
+    MakeProbeTargetFile(MakeContext, Target);
 
     Target->EvaluatingDependencies = TRUE;
 
@@ -1802,7 +3033,7 @@ MakeDetermineDependenciesForTarget(
             Target->NumberParentsToBuild = Target->NumberParentsToBuild + 1;
             SetRebuildRequired = TRUE;
         }
-        MakeProbeTargetFile(Parent);
+        MakeProbeTargetFile(MakeContext, Parent);
         if (Parent->FileExists && Target->FileExists && Parent->ModifiedTime.QuadPart > Target->ModifiedTime.QuadPart) {
             SetRebuildRequired = TRUE;
         }
@@ -1816,6 +3047,29 @@ MakeDetermineDependenciesForTarget(
         SetRebuildRequired = TRUE;
     }
 
+    //
+    //  If the target appears out of date based on timestamps but nothing
+    //  it depends on needs to be rebuilt, check whether the commands and
+    //  the contents of its inputs are identical to when it was last built.
+    //  This avoids rebuilding when timestamps change without the contents
+    //  changing, such as when switching between source control branches.
+    //
+
+    if (SetRebuildRequired &&
+        !Target->RebuildRequired &&
+        Target->FileExists &&
+        Target->NumberParentsToBuild == 0 &&
+        MakeContext->DigestTable != NULL) {
+
+        if (!MakeGenerateExecScriptForTarget(MakeContext, Target)) {
+            return FALSE;
+        }
+
+        if (MakeIsTargetCurrentByDigest(MakeContext, Target)) {
+            SetRebuildRequired = FALSE;
+        }
+    }
+
     if (SetRebuildRequired && !Target->RebuildRequired) {
 #if MAKE_DEBUG_TARGETS
         YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("RebuildRequired on %y\n"), &Target->HashEntry.Key);
@@ -1899,7 +3153,8 @@ MakeMarkCommandLineTargetForBuild(
     }
 
     MakeMarkTargetInferenceRuleNeededIfNeeded(ScopeContext, RequiredTarget);
-    if (!MakeDetermineDependenciesForTarget(MakeContext, RequiredTarget)) {
+    if (!MakePrepareDependenciesForTarget(MakeContext, RequiredTarget) ||
+        !MakeDetermineDependenciesForTarget(MakeContext, RequiredTarget)) {
         return FALSE;
     }
 
@@ -1939,6 +3194,10 @@ MakeDetermineDependencies(
         ListEntry = YoriLibGetNextListEntry(&MakeContext->TargetsList, ListEntry);
     }
 
+    if (!MakePrepareDependenciesForTarget(MakeContext, Target)) {
+        return FALSE;
+    }
+
     return MakeDetermineDependenciesForTarget(MakeContext, Target);
 }
 
@@ -0,0 +1,421 @@
+/**
+ * @file make/trace.c
+ *
+ * Yori shell make build trace generation
+ *
+ * Copyright (c) 2026 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <yoripch.h>
+#include <yorilib.h>
+#include <yorish.h>
+#include "make.h"
+
+/**
+ Convert a performance counter value into the number of microseconds since
+ the trace was opened.
+
+ @param MakeContext Pointer to the context.
+
+ @param Time Pointer to the performance counter value.
+
+ @return The number of microseconds since the trace was opened.
+ */
+DWORDLONG
+MakeTraceTimestamp(
+    __in PMAKE_CONTEXT MakeContext,
+    __in PLARGE_INTEGER Time
+    )
+{
+    DWORDLONG Delta;
+    DWORDLONG Frequency;
+
+    if (Time->QuadPart < MakeContext->TraceStartTime.QuadPart) {
+        return 0;
+    }
+
+    //
+    //  Divide before multiplying to avoid overflowing on long builds.
+    //
+
+    Delta = (DWORDLONG)(Time->QuadPart - MakeContext->TraceStartTime.QuadPart);
+    Frequency = (DWORDLONG)MakeContext->TraceFrequency.QuadPart;
+    return (Delta / Frequency) * 1000000 + (Delta % Frequency) * 1000000 / Frequency;
+}
+
+/**
+ Generate a copy of a string which is suitable for inclusion within a JSON
+ string.
+
+ @param String Pointer to the string to escape.
+
+ @param Escaped On successful completion, updated to contain the escaped
+        string.  The caller should free this with YoriLibFreeStringContents.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+MakeTraceEscapeString(
+    __in PCYORI_STRING String,
+    __out PYORI_STRING Escaped
+    )
+{
+    YORI_ALLOC_SIZE_T Index;
+    YORI_ALLOC_SIZE_T Length;
+    TCHAR Char;
+
+    Length = 0;
+    for (Index = 0; Index < String->LengthInChars; Index++) {
+        Char = String->StartOfString[Index];
+        if (Char == '\\' || Char == '"') {
+            Length = Length + 2;
+        } else if (Char < ' ') {
+            Length = Length + sizeof("\\u0000") - 1;
+        } else {
+            Length++;
+        }
+    }
+
+    if (!YoriLibAllocateString(Escaped, Length + 1)) {
+        return FALSE;
+    }
+
+    Length = 0;
+    for (Index = 0; Index < String->LengthInChars; Index++) {
+        Char = String->StartOfString[Index];
+        if (Char == '\\' || Char == '"') {
+            Escaped->StartOfString[Length] = '\\';
+            Escaped->StartOfString[Length + 1] = Char;
+            Length = Length + 2;
+        } else if (Char < ' ') {
+            Length = Length + YoriLibSPrintf(&Escaped->StartOfString[Length], _T("\\u%04x"), Char);
+        } else {
+            Escaped->StartOfString[Length] = Char;
+            Length++;
+        }
+    }
+
+    Escaped->StartOfString[Length] = '\0';
+    Escaped->LengthInChars = Length;
+    return TRUE;
+}
+
+/**
+ Write the seperator before a new event in the trace.
+
+ @param MakeContext Pointer to the context.
+ */
+VOID
+MakeTraceBeginEvent(
+    __in PMAKE_CONTEXT MakeContext
+    )
+{
+    if (MakeContext->TraceEventWritten) {
+        YoriLibOutputToDevice(MakeContext->TraceHandle, 0, _T(",\n"));
+    }
+    MakeContext->TraceEventWritten = TRUE;
+}
+
+/**
+ Open a file to record a trace of the build.  The trace is written in the
+ Chrome trace event format, which is a JSON array of events.  Each event has
+ a timestamp in microseconds, and the thread identifier describes which job
+ slot executed a command.  Thread zero describes the make process itself.
+
+ @param MakeContext Pointer to the context.
+
+ @param FileName Pointer to the name of the file to create.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOLEAN
+MakeTraceOpen(
+    __in PMAKE_CONTEXT MakeContext,
+    __in PYORI_STRING FileName
+    )
+{
+    YORI_STRING FullFileName;
+    DWORD Index;
+
+    ASSERT(MakeContext->TraceHandle == NULL);
+
+    YoriLibInitEmptyString(&FullFileName);
+    if (!YoriLibUserStringToSingleFilePath(FileName, TRUE, &FullFileName)) {
+        return FALSE;
+    }
+
+    MakeContext->TraceHandle = CreateFile(FullFileName.StartOfString, GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    YoriLibFreeStringContents(&FullFileName);
+    if (MakeContext->TraceHandle == INVALID_HANDLE_VALUE) {
+        MakeContext->TraceHandle = NULL;
+        return FALSE;
+    }
+
+    QueryPerformanceFrequency(&MakeContext->TraceFrequency);
+    QueryPerformanceCounter(&MakeContext->TraceStartTime);
+    MakeContext->TraceEventWritten = FALSE;
+
+    YoriLibOutputToDevice(MakeContext->TraceHandle, 0, _T("[\n"));
+
+    //
+    //  Name each thread so the viewer describes the job slots.
+    //
+
+    MakeTraceBeginEvent(MakeContext);
+    YoriLibOutputToDevice(MakeContext->TraceHandle, 0, _T("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"ymake\"}}"));
+    for (Index = 0; Index < MakeContext->NumberProcesses + MakeContext->NumberRemoteProcesses; Index++) {
+        MakeTraceBeginEvent(MakeContext);
+        YoriLibOutputToDevice(MakeContext->TraceHandle, 0, _T("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%i,\"args\":{\"name\":\"Job %i\"}}"), Index + 1, Index);
+    }
+
+    return TRUE;
+}
+
+/**
+ Complete and close the trace file, if one is open.
+
+ @param MakeContext Pointer to the context.
+ */
+VOID
+MakeTraceClose(
+    __in PMAKE_CONTEXT MakeContext
+    )
+{
+    if (MakeContext->TraceHandle == NULL) {
+        return;
+    }
+
+    YoriLibOutputToDevice(MakeContext->TraceHandle, 0, _T("\n]\n"));
+    CloseHandle(MakeContext->TraceHandle);
+    MakeContext->TraceHandle = NULL;
+}
+
+/**
+ Record a phase of processing performed by the make process, such as
+ preprocessing a makefile or evaluating dependencies.
+
+ @param MakeContext Pointer to the context.
+
+ @param PhaseName Pointer to a NULL terminated name of the phase.
+
+ @param FileName Optionally points to the name of the makefile that the
+        phase applies to.
+
+ @param StartTime Pointer to the performance counter value when the phase
+        started.
+
+ @param EndTime Pointer to the performance counter value when the phase
+        completed.
+ */
+VOID
+MakeTracePhase(
+    __in PMAKE_CONTEXT MakeContext,
+    __in LPCTSTR PhaseName,
+    __in_opt PCYORI_STRING FileName,
+    __in PLARGE_INTEGER StartTime,
+    __in PLARGE_INTEGER EndTime
+    )
+{
+    YORI_STRING Escaped;
+    DWORDLONG Start;
+    DWORDLONG End;
+
+    if (MakeContext->TraceHandle == NULL) {
+        return;
+    }
+
+    Start = MakeTraceTimestamp(MakeContext, StartTime);
+    End = MakeTraceTimestamp(MakeContext, EndTime);
+
+    MakeTraceBeginEvent(MakeContext);
+    if (FileName != NULL && MakeTraceEscapeString(FileName, &Escaped)) {
+        YoriLibOutputToDevice(MakeContext->TraceHandle, 0, _T("{\"name\":\"%s\",\"cat\":\"phase\",\"ph\":\"X\",\"pid\":1,\"tid\":0,\"ts\":%lli,\"dur\":%lli,\"args\":{\"file\":\"%y\"}}"), PhaseName, Start, End - Start, &Escaped);
+        YoriLibFreeStringContents(&Escaped);
+    } else {
+        YoriLibOutputToDevice(MakeContext->TraceHandle, 0, _T("{\"name\":\"%s\",\"cat\":\"phase\",\"ph\":\"X\",\"pid\":1,\"tid\":0,\"ts\":%lli,\"dur\":%lli}"), PhaseName, Start, End - Start);
+    }
+}
+
+/**
+ Record that a target has become ready to execute because all of the
+ targets it depends on have been built.
+
+ @param MakeContext Pointer to the context.
+
+ @param Target Pointer to the target which is ready.
+ */
+VOID
+MakeTraceTargetReady(
+    __in PMAKE_CONTEXT MakeContext,
+    __in PMAKE_TARGET Target
+    )
+{
+    YORI_STRING Escaped;
+
+    if (MakeContext->TraceHandle == NULL) {
+        return;
+    }
+
+    QueryPerformanceCounter(&Target->ReadyTime);
+    if (!MakeTraceEscapeString(&Target->HashEntry.Key, &Escaped)) {
+        return;
+    }
+
+    MakeTraceBeginEvent(MakeContext);
+    YoriLibOutputToDevice(MakeContext->TraceHandle, 0, _T("{\"name\":\"%y\",\"cat\":\"ready\",\"ph\":\"i\",\"s\":\"t\",\"pid\":1,\"tid\":0,\"ts\":%lli}"), &Escaped, MakeTraceTimestamp(MakeContext, &Target->ReadyTime));
+    YoriLibFreeStringContents(&Escaped);
+}
+
+/**
+ Record a command executed as part of the recipe for a target.
+
+ @param MakeContext Pointer to the context.
+
+ @param Target Pointer to the target whose recipe contains the command.
+
+ @param Cmd Pointer to the command that was executed.
+
+ @param JobId The job slot that the command executed in.
+
+ @param StartTime Pointer to the performance counter value when the command
+        was launched.
+
+ @param ExitCode The exit code of the command.
+ */
+VOID
+MakeTraceCommand(
+    __in PMAKE_CONTEXT MakeContext,
+    __in PMAKE_TARGET Target,
+    __in PYORI_STRING Cmd,
+    __in DWORD JobId,
+    __in PLARGE_INTEGER StartTime,
+    __in DWORD ExitCode
+    )
+{
+    YORI_STRING EscapedTarget;
+    YORI_STRING EscapedCmd;
+    LARGE_INTEGER EndTime;
+    DWORDLONG Start;
+    DWORDLONG End;
+
+    if (MakeContext->TraceHandle == NULL) {
+        return;
+    }
+
+    QueryPerformanceCounter(&EndTime);
+    Start = MakeTraceTimestamp(MakeContext, StartTime);
+    End = MakeTraceTimestamp(MakeContext, &EndTime);
+
+    if (!MakeTraceEscapeString(&Target->HashEntry.Key, &EscapedTarget)) {
+        return;
+    }
+
+    if (!MakeTraceEscapeString(Cmd, &EscapedCmd)) {
+        YoriLibFreeStringContents(&EscapedTarget);
+        return;
+    }
+
+    MakeTraceBeginEvent(MakeContext);
+    YoriLibOutputToDevice(MakeContext->TraceHandle,
+                          0,
+                          _T("{\"name\":\"%y\",\"cat\":\"command\",\"ph\":\"X\",\"pid\":1,\"tid\":%i,\"ts\":%lli,\"dur\":%lli,\"args\":{\"cmd\":\"%y\",\"exitCode\":%i,\"readyTs\":%lli}}"),
+                          &EscapedTarget,
+                          JobId + 1,
+                          Start,
+                          End - Start,
+                          &EscapedCmd,
+                          ExitCode,
+                          MakeTraceTimestamp(MakeContext, &Target->ReadyTime));
+
+    YoriLibFreeStringContents(&EscapedTarget);
+    YoriLibFreeStringContents(&EscapedCmd);
+}
+
+/**
+ Convert a duration in performance counter units into microseconds.
+
+ @param MakeContext Pointer to the context.
+
+ @param Duration The duration in performance counter units.
+
+ @return The duration in microseconds.
+ */
+DWORDLONG
+MakeTraceDuration(
+    __in PMAKE_CONTEXT MakeContext,
+    __in DWORDLONG Duration
+    )
+{
+    DWORDLONG Frequency;
+
+    Frequency = (DWORDLONG)MakeContext->TraceFrequency.QuadPart;
+    return (Duration / Frequency) * 1000000 + (Duration % Frequency) * 1000000 / Frequency;
+}
+
+/**
+ Record the performance counters accumulated during the build.  These are
+ written as a single event at the end of the trace, with times in
+ microseconds.
+
+ @param MakeContext Pointer to the context.
+ */
+VOID
+MakeTraceCounters(
+    __in PMAKE_CONTEXT MakeContext
+    )
+{
+    LARGE_INTEGER Now;
+
+    if (MakeContext->TraceHandle == NULL) {
+        return;
+    }
+
+    QueryPerformanceCounter(&Now);
+
+    MakeTraceBeginEvent(MakeContext);
+    YoriLibOutputToDevice(MakeContext->TraceHandle,
+                          0,
+                          _T("{\"name\":\"Counters\",\"cat\":\"perf\",\"ph\":\"i\",\"s\":\"g\",\"pid\":1,\"tid\":0,\"ts\":%lli,\"args\":{")
+                          _T("\"preprocessorProcessUs\":%lli,\"preprocessorUs\":%lli,\"includeUs\":%lli,\"inferenceRuleUs\":%lli,")
+                          _T("\"graphUs\":%lli,\"executeUs\":%lli,\"launchUs\":%lli,\"idleSlotsWallUs\":%lli,\"idleSlotUs\":%lli,")
+                          _T("\"makefiles\":%i,\"lines\":%i,\"variableExpansions\":%i,\"variableReferences\":%i,")
+                          _T("\"inferenceRuleSearches\":%i,\"inferenceRuleProbes\":%i,\"processesLaunched\":%i}}"),
+                          MakeTraceTimestamp(MakeContext, &Now),
+                          MakeTraceDuration(MakeContext, MakeContext->TimeInPreprocessorCreateProcess),
+                          MakeTraceDuration(MakeContext, MakeContext->TimeInPreprocessor - MakeContext->TimeInPreprocessorCreateProcess),
+                          MakeTraceDuration(MakeContext, MakeContext->TimeInInclude),
+                          MakeTraceDuration(MakeContext, MakeContext->TimeInInferenceRules),
+                          MakeTraceDuration(MakeContext, MakeContext->TimeBuildingGraph),
+                          MakeTraceDuration(MakeContext, MakeContext->TimeInExecute),
+                          MakeTraceDuration(MakeContext, MakeContext->TimeLaunchingProcesses),
+                          MakeTraceDuration(MakeContext, MakeContext->TimeWithIdleSlots),
+                          MakeTraceDuration(MakeContext, MakeContext->IdleSlotTime),
+                          MakeContext->MakefilesProcessed,
+                          MakeContext->LinesProcessed,
+                          MakeContext->VariableExpansions,
+                          MakeContext->VariableReferences,
+                          MakeContext->InferenceRuleSearches,
+                          MakeContext->InferenceRuleProbes,
+                          MakeContext->ProcessesLaunched);
+}
+
+// vim:sw=4:ts=4:et:
@@ -135,12 +135,19 @@ MakeLookupVariable(
     PYORI_HASH_ENTRY FoundVariableEntry;
     PMAKE_SCOPE_CONTEXT SearchScopeContext;
     PMAKE_VARIABLE FoundVariable;
+    DWORD Hash;
 
     SearchScopeContext = ScopeContext;
     FoundVariable = NULL;
 
+    //
+    //  Hash the name once, since it may be looked up in each parent scope.
+    //
+
+    Hash = YoriLibHashKey(Variable);
+
     do {
-        FoundVariableEntry = YoriLibHashLookupByKey(SearchScopeContext->Variables, Variable);
+        FoundVariableEntry = YoriLibHashLookupByKeyWithHash(SearchScopeContext->Variables, Variable, Hash);
         if (FoundVariableEntry != NULL) {
             FoundVariable = FoundVariableEntry->Context;
             break;
@@ -202,7 +209,9 @@ MakeIsVariableTargetSpecific(
  @param VariableData On successful completion, populated with the contents of
         the variable.  Typically this is just pointing to data stored in the
         variable hashtable.  For target specific variables, it may be
-        dynamically generated.  The caller should free this with
+        dynamically generated, in which case it is allocated from the
+        expansion arena and remains valid until the enclosing call to
+        MakeExpandVariables completes.  The caller should free this with
         YoriLibFreeStringContents, although most of the time this does
         nothing.
 
@@ -228,11 +237,15 @@ MakeSubstituteNamedVariable(
     LPTSTR Ptr;
 
     if (YoriLibCompareStringLitCnt(VariableName, _T("$"), 1) == 0) {
-        YoriLibYPrintf(VariableData, _T("$"));
+        VariableData->StartOfString = VariableName->StartOfString;
+        VariableData->LengthInChars = 1;
         return TRUE;
     } else if (MakeIsVariableTargetSpecific(VariableName)) {
         if (Target == NULL) {
-            YoriLibYPrintf(VariableData, _T("$(%y)"), VariableName);
+            if (!MakeArenaAllocateString(&ScopeContext->MakeContext->ExpansionArena, VariableData, VariableName->LengthInChars + sizeof("$()"))) {
+                return FALSE;
+            }
+            VariableData->LengthInChars = YoriLibSPrintf(VariableData->StartOfString, _T("$(%y)"), VariableName);
             return TRUE;
         } else {
             return MakeExpandTargetVariable(ScopeContext->MakeContext, Target, VariableName, VariableData);
@@ -307,7 +320,7 @@ MakeSubstituteNamedVariable(
     //  Allocate space for the text after replacement.
     //
 
-    if (!YoriLibAllocateString(VariableData, LengthNeeded)) {
+    if (!MakeArenaAllocateString(&ScopeContext->MakeContext->ExpansionArena, VariableData, LengthNeeded)) {
         return FALSE;
     }
     ScopeContext->MakeContext->AllocVariableData++;
@@ -384,6 +397,7 @@ MakeExpandVariables(
 {
     YORI_STRING VariableName;
     YORI_STRING VariableContents;
+    MAKE_ARENA_MARK ArenaMark;
     BOOLEAN BraceDelimited;
 
     YORI_ALLOC_SIZE_T StartVariableNameIndex;
@@ -397,6 +411,14 @@ MakeExpandVariables(
         YoriLibInitEmptyString(VariableNotFound);
     }
 
+    //
+    //  Any strings generated for variables are only needed until the
+    //  expanded line has been constructed.
+    //
+
+    MakeArenaGetMark(&ScopeContext->MakeContext->ExpansionArena, &ArenaMark);
+    ScopeContext->MakeContext->VariableExpansions++;
+
     LengthNeeded = 0;
     for (ReadIndex = 0; ReadIndex < Line->LengthInChars; ReadIndex++) {
         if (Line->StartOfString[ReadIndex] == '$' &&
@@ -433,6 +455,7 @@ MakeExpandVariables(
             }
 
             if (VariableName.LengthInChars > 0) {
+                ScopeContext->MakeContext->VariableReferences++;
                 if (MakeSubstituteNamedVariable(ScopeContext, Target, &VariableName, &VariableContents)) {
                     LengthNeeded = LengthNeeded + VariableContents.LengthInChars;
                     YoriLibFreeStringContents(&VariableContents);
@@ -457,6 +480,7 @@ MakeExpandVariables(
         LengthNeeded = LengthNeeded + 1024;
         YoriLibFreeStringContents(ExpandedLine);
         if (!YoriLibAllocateString(ExpandedLine, LengthNeeded)) {
+            MakeArenaResetToMark(&ScopeContext->MakeContext->ExpansionArena, &ArenaMark);
             return FALSE;
         }
         ScopeContext->MakeContext->AllocExpandedLine++;
@@ -518,6 +542,7 @@ MakeExpandVariables(
 
     ExpandedLine->StartOfString[WriteIndex] = '\0';
     ExpandedLine->LengthInChars = WriteIndex;
+    MakeArenaResetToMark(&ScopeContext->MakeContext->ExpansionArena, &ArenaMark);
     return TRUE;
 }
 
@@ -551,8 +576,10 @@ MakeSetVariable(
 {
     PYORI_HASH_ENTRY FoundVariableEntry;
     PMAKE_VARIABLE FoundVariable;
+    DWORD Hash;
 
-    FoundVariableEntry = YoriLibHashLookupByKey(ScopeContext->Variables, Variable);
+    Hash = YoriLibHashKey(Variable);
+    FoundVariableEntry = YoriLibHashLookupByKeyWithHash(ScopeContext->Variables, Variable, Hash);
     if (FoundVariableEntry != NULL) {
         FoundVariable = FoundVariableEntry->Context;
 
@@ -628,7 +655,7 @@ MakeSetVariable(
 
         FoundVariable->Precedence = Precedence;
 
-        YoriLibHashInsertByKey(ScopeContext->Variables, &VariableNameCopy, FoundVariable, &FoundVariable->HashEntry);
+        YoriLibHashInsertByKeyWithHash(ScopeContext->Variables, &VariableNameCopy, Hash, FoundVariable, &FoundVariable->HashEntry);
         YoriLibInsertList(&ScopeContext->VariableList, &FoundVariable->ListEntry);
     }
 
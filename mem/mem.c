@@ -35,10 +35,12 @@ CHAR strMemHelpText[] =
         "\n"
         "Display memory usage.\n"
         "\n"
-        "MEM [-license] [-c [-g]] [<fmt>]\n"
+        "MEM [-license] [-c [-g]] [-i ms [-count n] [-g]] [<fmt>]\n"
         "\n"
         "   -c             Display memory usage of processes the user has access to\n"
+        "   -count n       Stop watching after n samples\n"
         "   -g             Count all processes with the same name together\n"
+        "   -i ms          Watch process memory usage, sampling every ms milliseconds\n"
         "\n"
         "Format specifiers are:\n"
         "   $AVAILABLECOMMIT$      The amount of memory that the system has available\n"
@@ -487,6 +489,803 @@ MemDisplayProcessMemoryUsage(
     return TRUE;
 }
 
+/**
+ The number of characters of a process name to retain between samples.
+ */
+#define MEM_WATCH_NAME_LENGTH 64
+
+/**
+ The number of consecutive samples in which a process must grow its commit,
+ without any sample shrinking it, before it is reported as a leak suspect.
+ */
+#define MEM_WATCH_SUSPECT_SAMPLES 3
+
+/**
+ Information about a single process, or group of processes with the same
+ name, retained between samples.
+ */
+typedef struct _MEM_WATCH_ENTRY {
+
+    /**
+     The process identifier, or the number of processes if processes are
+     grouped by name.
+     */
+    DWORD_PTR ProcessId;
+
+    /**
+     The time the process was launched.  This is used to distinguish a
+     process from a later one that reuses its identifier.
+     */
+    LARGE_INTEGER CreateTime;
+
+    /**
+     The number of bytes in the working set.
+     */
+    DWORDLONG WorkingSet;
+
+    /**
+     The number of bytes committed.
+     */
+    DWORDLONG Commit;
+
+    /**
+     The change in the working set since the previous sample.
+     */
+    LONGLONG WorkingSetDelta;
+
+    /**
+     The change in commit since the previous sample.
+     */
+    LONGLONG CommitDelta;
+
+    /**
+     The number of bytes committed when the entry was first observed.
+     */
+    DWORDLONG FirstCommit;
+
+    /**
+     The system time when the entry was first observed.
+     */
+    LONGLONG FirstTime;
+
+    /**
+     The largest number of bytes committed in any sample.
+     */
+    DWORDLONG PeakCommit;
+
+    /**
+     The number of consecutive samples in which commit has grown without
+     shrinking.
+     */
+    DWORD GrowthSamples;
+
+    /**
+     The number of characters in Name.
+     */
+    YORI_ALLOC_SIZE_T NameLength;
+
+    /**
+     The image name of the process.  This is copied because the process list
+     buffer is overwritten by each sample.
+     */
+    TCHAR Name[MEM_WATCH_NAME_LENGTH];
+
+} MEM_WATCH_ENTRY, *PMEM_WATCH_ENTRY;
+
+/**
+ The state of the system captured in a single sample.
+ */
+typedef struct _MEM_WATCH_SNAPSHOT {
+
+    /**
+     An array of entries, one per process or group of processes.
+     */
+    PMEM_WATCH_ENTRY Entries;
+
+    /**
+     An array of pointers to Entries, sorted by process identifier, or by
+     name if processes are grouped.
+     */
+    PMEM_WATCH_ENTRY *Order;
+
+    /**
+     The number of valid entries.
+     */
+    YORI_ALLOC_SIZE_T EntryCount;
+
+    /**
+     The number of entries that Entries and Order have space for.
+     */
+    YORI_ALLOC_SIZE_T EntriesAllocated;
+
+    /**
+     The system time when the sample was captured.
+     */
+    LONGLONG Time;
+
+    /**
+     The number of bytes committed across the system.
+     */
+    DWORDLONG SystemCommit;
+
+} MEM_WATCH_SNAPSHOT, *PMEM_WATCH_SNAPSHOT;
+
+/**
+ Context describing an ongoing watch of process memory usage.
+ */
+typedef struct _MEM_WATCH_CONTEXT {
+
+    /**
+     The buffer containing the process list.  This is reused by each sample.
+     */
+    PYORI_SYSTEM_PROCESS_INFORMATION ProcessInfo;
+
+    /**
+     The size of the ProcessInfo buffer, in bytes.
+     */
+    YORI_ALLOC_SIZE_T BufferSize;
+
+    /**
+     The two most recent samples.  Each new sample overwrites the older one.
+     */
+    MEM_WATCH_SNAPSHOT Snapshots[2];
+
+    /**
+     The index of the snapshot containing the most recent sample.
+     */
+    DWORD CurrentSnapshot;
+
+    /**
+     The number of milliseconds between samples.
+     */
+    DWORD Interval;
+
+    /**
+     The number of samples to take, or zero to continue until cancelled.
+     */
+    DWORD SampleCount;
+
+    /**
+     TRUE if processes with the same name should be counted together.
+     */
+    BOOLEAN GroupProcesses;
+
+    /**
+     The system time when the first sample was captured.
+     */
+    LONGLONG StartTime;
+
+    /**
+     The number of bytes committed across the system in the first sample.
+     */
+    DWORDLONG FirstSystemCommit;
+
+    /**
+     The largest number of bytes committed across the system in any sample.
+     */
+    DWORDLONG PeakSystemCommit;
+
+} MEM_WATCH_CONTEXT, *PMEM_WATCH_CONTEXT;
+
+/**
+ Compare two entries by the key used to match them across samples.
+
+ @param WatchContext Pointer to the watch context, which indicates whether
+        entries are matched by process or by name.
+
+ @param Left Pointer to the first entry.
+
+ @param Right Pointer to the second entry.
+
+ @return Less than zero if Left sorts before Right, zero if they refer to
+         the same process or group, greater than zero if Left sorts after
+         Right.
+ */
+int
+MemWatchCompareEntries(
+    __in PMEM_WATCH_CONTEXT WatchContext,
+    __in PMEM_WATCH_ENTRY Left,
+    __in PMEM_WATCH_ENTRY Right
+    )
+{
+    YORI_STRING LeftName;
+    YORI_STRING RightName;
+
+    if (WatchContext->GroupProcesses) {
+        YoriLibInitEmptyString(&LeftName);
+        YoriLibInitEmptyString(&RightName);
+        LeftName.StartOfString = Left->Name;
+        LeftName.LengthInChars = Left->NameLength;
+        RightName.StartOfString = Right->Name;
+        RightName.LengthInChars = Right->NameLength;
+        return YoriLibCompareStringIns(&LeftName, &RightName);
+    }
+
+    if (Left->ProcessId < Right->ProcessId) {
+        return -1;
+    } else if (Left->ProcessId > Right->ProcessId) {
+        return 1;
+    }
+
+    if (Left->CreateTime.QuadPart < Right->CreateTime.QuadPart) {
+        return -1;
+    } else if (Left->CreateTime.QuadPart > Right->CreateTime.QuadPart) {
+        return 1;
+    }
+
+    return 0;
+}
+
+/**
+ Move an element down a heap until it is not before either of its children.
+
+ @param WatchContext Pointer to the watch context.
+
+ @param Array Pointer to the array of entries forming the heap.
+
+ @param Index The index of the element to move.
+
+ @param Count The number of elements in the heap.
+ */
+VOID
+MemWatchSiftDown(
+    __in PMEM_WATCH_CONTEXT WatchContext,
+    __inout PMEM_WATCH_ENTRY *Array,
+    __in YORI_ALLOC_SIZE_T Index,
+    __in YORI_ALLOC_SIZE_T Count
+    )
+{
+    YORI_ALLOC_SIZE_T Child;
+    PMEM_WATCH_ENTRY Swap;
+
+    while (Index < Count / 2) {
+        Child = Index * 2 + 1;
+        if (Child + 1 < Count && MemWatchCompareEntries(WatchContext, Array[Child], Array[Child + 1]) < 0) {
+            Child++;
+        }
+
+        if (MemWatchCompareEntries(WatchContext, Array[Index], Array[Child]) >= 0) {
+            break;
+        }
+
+        Swap = Array[Index];
+        Array[Index] = Array[Child];
+        Array[Child] = Swap;
+        Index = Child;
+    }
+}
+
+/**
+ Sort an array of entries by the key used to match them across samples.
+
+ @param WatchContext Pointer to the watch context.
+
+ @param Array Pointer to the array of entries to sort.
+
+ @param Count The number of elements in the array.
+ */
+VOID
+MemWatchSortEntries(
+    __in PMEM_WATCH_CONTEXT WatchContext,
+    __inout PMEM_WATCH_ENTRY *Array,
+    __in YORI_ALLOC_SIZE_T Count
+    )
+{
+    YORI_ALLOC_SIZE_T Index;
+    PMEM_WATCH_ENTRY Swap;
+
+    if (Count < 2) {
+        return;
+    }
+
+    for (Index = Count / 2; Index > 0; Index--) {
+        MemWatchSiftDown(WatchContext, Array, Index - 1, Count);
+    }
+
+    for (Index = Count - 1; Index > 0; Index--) {
+        Swap = Array[0];
+        Array[0] = Array[Index];
+        Array[Index] = Swap;
+        MemWatchSiftDown(WatchContext, Array, 0, Index);
+    }
+}
+
+/**
+ Query the number of bytes committed across the system.
+
+ @return The number of bytes committed, or zero if it cannot be determined.
+ */
+DWORDLONG
+MemWatchGetSystemCommit(VOID)
+{
+    if (DllKernel32.pGlobalMemoryStatusEx != NULL) {
+        YORI_MEMORYSTATUSEX MemStatusEx;
+        MemStatusEx.dwLength = sizeof(MemStatusEx);
+        if (DllKernel32.pGlobalMemoryStatusEx(&MemStatusEx)) {
+            return MemStatusEx.ullTotalPageFile - MemStatusEx.ullAvailPageFile;
+        }
+    } else if (DllKernel32.pGlobalMemoryStatus != NULL) {
+        MEMORYSTATUS MemStatus;
+        DllKernel32.pGlobalMemoryStatus(&MemStatus);
+        return MemStatus.dwTotalPageFile - MemStatus.dwAvailPageFile;
+    }
+
+    return 0;
+}
+
+/**
+ Capture the memory usage of all processes into a snapshot.  The process
+ list buffer and the snapshot's arrays are reused from earlier samples and
+ only reallocated if the number of processes has grown beyond them.
+
+ @param WatchContext Pointer to the watch context.
+
+ @param Snapshot Pointer to the snapshot to populate.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+MemWatchCaptureSnapshot(
+    __in PMEM_WATCH_CONTEXT WatchContext,
+    __inout PMEM_WATCH_SNAPSHOT Snapshot
+    )
+{
+    PYORI_SYSTEM_PROCESS_INFORMATION CurrentEntry;
+    PMEM_WATCH_ENTRY Entry;
+    YORI_ALLOC_SIZE_T NumberOfProcesses;
+    YORI_ALLOC_SIZE_T Index;
+    YORI_ALLOC_SIZE_T EntriesAllocated;
+
+    if (!YoriLibRefreshSystemProcessList(&WatchContext->ProcessInfo, &WatchContext->BufferSize)) {
+        return FALSE;
+    }
+
+    Snapshot->Time = YoriLibGetSystemTimeAsInteger();
+    Snapshot->SystemCommit = MemWatchGetSystemCommit();
+
+    NumberOfProcesses = 0;
+    CurrentEntry = WatchContext->ProcessInfo;
+    do {
+        NumberOfProcesses++;
+        if (CurrentEntry->NextEntryOffset == 0) {
+            break;
+        }
+        CurrentEntry = YoriLibAddToPointer(CurrentEntry, CurrentEntry->NextEntryOffset);
+    } while(TRUE);
+
+    if (WatchContext->GroupProcesses) {
+        MemGroupProcessNames(WatchContext->ProcessInfo, &NumberOfProcesses);
+    }
+
+    //
+    //  Allocate the entries and their sort order in a single allocation,
+    //  leaving some room for processes to be created before the next
+    //  sample.
+    //
+
+    if (Snapshot->EntriesAllocated < NumberOfProcesses) {
+        if (Snapshot->Entries != NULL) {
+            YoriLibFree(Snapshot->Entries);
+            Snapshot->Entries = NULL;
+            Snapshot->Order = NULL;
+            Snapshot->EntriesAllocated = 0;
+        }
+
+        EntriesAllocated = NumberOfProcesses + 64;
+        Snapshot->Entries = YoriLibMalloc((YORI_ALLOC_SIZE_T)(EntriesAllocated * (sizeof(MEM_WATCH_ENTRY) + sizeof(PMEM_WATCH_ENTRY))));
+        if (Snapshot->Entries == NULL) {
+            return FALSE;
+        }
+        Snapshot->Order = (PMEM_WATCH_ENTRY *)(Snapshot->Entries + EntriesAllocated);
+        Snapshot->EntriesAllocated = EntriesAllocated;
+    }
+
+    Index = 0;
+    CurrentEntry = WatchContext->ProcessInfo;
+    do {
+        Entry = &Snapshot->Entries[Index];
+        Entry->ProcessId = CurrentEntry->ProcessId;
+        Entry->CreateTime.QuadPart = CurrentEntry->CreateTime.QuadPart;
+        Entry->WorkingSet = CurrentEntry->WorkingSetSize;
+        Entry->Commit = CurrentEntry->CommitSize;
+        Entry->NameLength = (YORI_ALLOC_SIZE_T)(CurrentEntry->ImageNameLengthInBytes / sizeof(WCHAR));
+        if (Entry->NameLength > MEM_WATCH_NAME_LENGTH) {
+            Entry->NameLength = MEM_WATCH_NAME_LENGTH;
+        }
+        memcpy(Entry->Name, CurrentEntry->ImageName, Entry->NameLength * sizeof(TCHAR));
+        Snapshot->Order[Index] = Entry;
+
+        Index++;
+        if (CurrentEntry->NextEntryOffset == 0 || Index == NumberOfProcesses) {
+            break;
+        }
+        CurrentEntry = YoriLibAddToPointer(CurrentEntry, CurrentEntry->NextEntryOffset);
+    } while(TRUE);
+
+    Snapshot->EntryCount = Index;
+    MemWatchSortEntries(WatchContext, Snapshot->Order, Snapshot->EntryCount);
+
+    return TRUE;
+}
+
+/**
+ Match entries in the current sample with the previous sample, and carry
+ forward the history of each process so that deltas, peaks and sustained
+ growth can be reported.  Since both samples are sorted by the same key,
+ this is a single pass over each.
+
+ @param WatchContext Pointer to the watch context.
+
+ @param Current Pointer to the most recent sample.
+
+ @param Previous Pointer to the sample before it, or NULL if this is the
+        first sample.
+ */
+VOID
+MemWatchCalculateDeltas(
+    __in PMEM_WATCH_CONTEXT WatchContext,
+    __inout PMEM_WATCH_SNAPSHOT Current,
+    __in_opt PMEM_WATCH_SNAPSHOT Previous
+    )
+{
+    YORI_ALLOC_SIZE_T CurrentIndex;
+    YORI_ALLOC_SIZE_T PreviousIndex;
+    PMEM_WATCH_ENTRY Entry;
+    PMEM_WATCH_ENTRY PreviousEntry;
+    int CompareResult;
+
+    PreviousIndex = 0;
+    for (CurrentIndex = 0; CurrentIndex < Current->EntryCount; CurrentIndex++) {
+        Entry = Current->Order[CurrentIndex];
+
+        PreviousEntry = NULL;
+        if (Previous != NULL) {
+            while (PreviousIndex < Previous->EntryCount) {
+                CompareResult = MemWatchCompareEntries(WatchContext, Previous->Order[PreviousIndex], Entry);
+                if (CompareResult == 0) {
+                    PreviousEntry = Previous->Order[PreviousIndex];
+                    break;
+                } else if (CompareResult > 0) {
+                    break;
+                }
+                PreviousIndex++;
+            }
+        }
+
+        //
+        //  A process that was not present in the previous sample is
+        //  reported as having grown from nothing, except in the first
+        //  sample where everything is new.
+        //
+
+        if (PreviousEntry == NULL) {
+            Entry->FirstCommit = Entry->Commit;
+            Entry->FirstTime = Current->Time;
+            Entry->PeakCommit = Entry->Commit;
+            Entry->GrowthSamples = 0;
+            Entry->WorkingSetDelta = 0;
+            Entry->CommitDelta = 0;
+            if (Previous != NULL) {
+                Entry->WorkingSetDelta = (LONGLONG)Entry->WorkingSet;
+                Entry->CommitDelta = (LONGLONG)Entry->Commit;
+            }
+            continue;
+        }
+
+        Entry->FirstCommit = PreviousEntry->FirstCommit;
+        Entry->FirstTime = PreviousEntry->FirstTime;
+        Entry->PeakCommit = PreviousEntry->PeakCommit;
+        if (Entry->Commit > Entry->PeakCommit) {
+            Entry->PeakCommit = Entry->Commit;
+        }
+
+        Entry->WorkingSetDelta = (LONGLONG)Entry->WorkingSet - (LONGLONG)PreviousEntry->WorkingSet;
+        Entry->CommitDelta = (LONGLONG)Entry->Commit - (LONGLONG)PreviousEntry->Commit;
+
+        Entry->GrowthSamples = PreviousEntry->GrowthSamples;
+        if (Entry->CommitDelta > 0) {
+            Entry->GrowthSamples++;
+        } else if (Entry->CommitDelta < 0) {
+            Entry->GrowthSamples = 0;
+        }
+    }
+}
+
+/**
+ Format a signed change in size into a string, with a leading sign
+ character followed by the size in human friendly form.
+
+ @param String Pointer to the string to populate.  This must have space for
+        at least six characters.
+
+ @param Delta The change in bytes.
+ */
+VOID
+MemWatchFormatDelta(
+    __inout PYORI_STRING String,
+    __in LONGLONG Delta
+    )
+{
+    YORI_STRING SizeString;
+    LARGE_INTEGER Size;
+
+    if (Delta < 0) {
+        String->StartOfString[0] = '-';
+        Size.QuadPart = -Delta;
+    } else {
+        String->StartOfString[0] = '+';
+        Size.QuadPart = Delta;
+    }
+
+    YoriLibInitEmptyString(&SizeString);
+    SizeString.StartOfString = &String->StartOfString[1];
+    SizeString.LengthAllocated = String->LengthAllocated - 1;
+    YoriLibFileSizeToString(&SizeString, &Size);
+    String->LengthInChars = SizeString.LengthInChars + 1;
+}
+
+/**
+ Display the changes observed in the most recent sample.  Only processes
+ whose memory usage changed since the previous sample are displayed, so a
+ long soak test produces output proportional to activity rather than the
+ number of processes.
+
+ @param WatchContext Pointer to the watch context.
+
+ @param Current Pointer to the most recent sample.
+
+ @param SampleIndex The number of samples taken before this one.
+ */
+VOID
+MemWatchOutputSample(
+    __in PMEM_WATCH_CONTEXT WatchContext,
+    __in PMEM_WATCH_SNAPSHOT Current,
+    __in DWORD SampleIndex
+    )
+{
+    YORI_ALLOC_SIZE_T Index;
+    YORI_ALLOC_SIZE_T SuspectCount;
+    PMEM_WATCH_ENTRY Entry;
+    LONGLONG ElapsedSeconds;
+    LONGLONG Rate;
+    LARGE_INTEGER Size;
+    YORI_STRING BaseName;
+    YORI_STRING SystemCommitString;
+    YORI_STRING SystemDeltaString;
+    YORI_STRING PeakString;
+    YORI_STRING WorkingSetString;
+    YORI_STRING WorkingSetDeltaString;
+    YORI_STRING CommitString;
+    YORI_STRING CommitDeltaString;
+    YORI_STRING RateString;
+    TCHAR SystemCommitBuffer[8];
+    TCHAR SystemDeltaBuffer[8];
+    TCHAR PeakBuffer[8];
+    TCHAR WorkingSetBuffer[8];
+    TCHAR WorkingSetDeltaBuffer[8];
+    TCHAR CommitBuffer[8];
+    TCHAR CommitDeltaBuffer[8];
+    TCHAR RateBuffer[8];
+    BOOLEAN HeaderDisplayed;
+
+    YoriLibInitEmptyString(&BaseName);
+    YoriLibInitEmptyString(&SystemCommitString);
+    SystemCommitString.StartOfString = SystemCommitBuffer;
+    SystemCommitString.LengthAllocated = sizeof(SystemCommitBuffer)/sizeof(SystemCommitBuffer[0]);
+    YoriLibInitEmptyString(&SystemDeltaString);
+    SystemDeltaString.StartOfString = SystemDeltaBuffer;
+    SystemDeltaString.LengthAllocated = sizeof(SystemDeltaBuffer)/sizeof(SystemDeltaBuffer[0]);
+    YoriLibInitEmptyString(&PeakString);
+    PeakString.StartOfString = PeakBuffer;
+    PeakString.LengthAllocated = sizeof(PeakBuffer)/sizeof(PeakBuffer[0]);
+    YoriLibInitEmptyString(&WorkingSetString);
+    WorkingSetString.StartOfString = WorkingSetBuffer;
+    WorkingSetString.LengthAllocated = sizeof(WorkingSetBuffer)/sizeof(WorkingSetBuffer[0]);
+    YoriLibInitEmptyString(&WorkingSetDeltaString);
+    WorkingSetDeltaString.StartOfString = WorkingSetDeltaBuffer;
+    WorkingSetDeltaString.LengthAllocated = sizeof(WorkingSetDeltaBuffer)/sizeof(WorkingSetDeltaBuffer[0]);
+    YoriLibInitEmptyString(&CommitString);
+    CommitString.StartOfString = CommitBuffer;
+    CommitString.LengthAllocated = sizeof(CommitBuffer)/sizeof(CommitBuffer[0]);
+    YoriLibInitEmptyString(&CommitDeltaString);
+    CommitDeltaString.StartOfString = CommitDeltaBuffer;
+    CommitDeltaString.LengthAllocated = sizeof(CommitDeltaBuffer)/sizeof(CommitDeltaBuffer[0]);
+    YoriLibInitEmptyString(&RateString);
+    RateString.StartOfString = RateBuffer;
+    RateString.LengthAllocated = sizeof(RateBuffer)/sizeof(RateBuffer[0]);
+
+    //
+    //  Display the system wide commit, its change since watching started,
+    //  and the highest commit observed.
+    //
+
+    ElapsedSeconds = (Current->Time - WatchContext->StartTime) / (10 * 1000 * 1000);
+    Size.QuadPart = Current->SystemCommit;
+    YoriLibFileSizeToString(&SystemCommitString, &Size);
+    MemWatchFormatDelta(&SystemDeltaString, (LONGLONG)Current->SystemCommit - (LONGLONG)WatchContext->FirstSystemCommit);
+    Size.QuadPart = WatchContext->PeakSystemCommit;
+    YoriLibFileSizeToString(&PeakString, &Size);
+
+    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT,
+                  _T("Sample %i at %llis: system commit %y (%y), peak %y\n"),
+                  SampleIndex,
+                  ElapsedSeconds,
+                  &SystemCommitString,
+                  &SystemDeltaString,
+                  &PeakString);
+
+    HeaderDisplayed = FALSE;
+    SuspectCount = 0;
+    for (Index = 0; Index < Current->EntryCount; Index++) {
+        Entry = Current->Order[Index];
+
+        if (Entry->GrowthSamples >= MEM_WATCH_SUSPECT_SAMPLES) {
+            SuspectCount++;
+        }
+
+        if (Entry->CommitDelta == 0 && Entry->WorkingSetDelta == 0) {
+            continue;
+        }
+
+        if (!HeaderDisplayed) {
+            if (WatchContext->GroupProcesses) {
+                YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T(" Count | Process         | WorkingSet       | Commit           | Rate/min | Peak\n"));
+            } else {
+                YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("  Pid  | Process         | WorkingSet       | Commit           | Rate/min | Peak\n"));
+            }
+            HeaderDisplayed = TRUE;
+        }
+
+        //
+        //  The rate is the average growth in commit since the process was
+        //  first observed, which smooths out the noise of any single
+        //  interval.
+        //
+
+        Rate = 0;
+        ElapsedSeconds = (Current->Time - Entry->FirstTime) / (10 * 1000 * 1000);
+        if (ElapsedSeconds > 0) {
+            Rate = ((LONGLONG)Entry->Commit - (LONGLONG)Entry->FirstCommit) * 60 / ElapsedSeconds;
+        }
+
+        Size.QuadPart = Entry->WorkingSet;
+        YoriLibFileSizeToString(&WorkingSetString, &Size);
+        MemWatchFormatDelta(&WorkingSetDeltaString, Entry->WorkingSetDelta);
+        Size.QuadPart = Entry->Commit;
+        YoriLibFileSizeToString(&CommitString, &Size);
+        MemWatchFormatDelta(&CommitDeltaString, Entry->CommitDelta);
+        MemWatchFormatDelta(&RateString, Rate);
+        Size.QuadPart = Entry->PeakCommit;
+        YoriLibFileSizeToString(&PeakString, &Size);
+
+        BaseName.StartOfString = Entry->Name;
+        BaseName.LengthInChars = Entry->NameLength;
+
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT,
+                      _T("%-6i | %-15y | %-5y %-10y | %-5y %-10y | %-8y | %-5y%s\n"),
+                      Entry->ProcessId,
+                      &BaseName,
+                      &WorkingSetString,
+                      &WorkingSetDeltaString,
+                      &CommitString,
+                      &CommitDeltaString,
+                      &RateString,
+                      &PeakString,
+                      (Entry->GrowthSamples >= MEM_WATCH_SUSPECT_SAMPLES)?_T(" growing"):_T(""));
+    }
+
+    if (SuspectCount > 0) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%i growing for %i or more samples without shrinking\n"), SuspectCount, MEM_WATCH_SUSPECT_SAMPLES);
+    }
+
+    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("\n"));
+}
+
+/**
+ Free the resources associated with watching process memory usage.
+
+ @param WatchContext Pointer to the watch context.
+ */
+VOID
+MemWatchCleanup(
+    __in PMEM_WATCH_CONTEXT WatchContext
+    )
+{
+    DWORD Index;
+
+    for (Index = 0; Index < sizeof(WatchContext->Snapshots)/sizeof(WatchContext->Snapshots[0]); Index++) {
+        if (WatchContext->Snapshots[Index].Entries != NULL) {
+            YoriLibFree(WatchContext->Snapshots[Index].Entries);
+            WatchContext->Snapshots[Index].Entries = NULL;
+            WatchContext->Snapshots[Index].Order = NULL;
+        }
+    }
+
+    if (WatchContext->ProcessInfo != NULL) {
+        YoriLibFree(WatchContext->ProcessInfo);
+        WatchContext->ProcessInfo = NULL;
+    }
+}
+
+/**
+ Repeatedly sample the memory used by all processes that the current user
+ has access to, displaying how it changes over time.
+
+ @param WatchContext Pointer to the watch context, which specifies the
+        sampling interval and count.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+MemWatchProcessMemoryUsage(
+    __inout PMEM_WATCH_CONTEXT WatchContext
+    )
+{
+    PMEM_WATCH_SNAPSHOT Current;
+    PMEM_WATCH_SNAPSHOT Previous;
+    DWORD SampleIndex;
+    HANDLE CancelEvent;
+    BOOL Result;
+
+    if (DllNtDll.pNtQuerySystemInformation == NULL) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("OS support not present\n"));
+        return FALSE;
+    }
+
+    Result = FALSE;
+    WatchContext->CurrentSnapshot = 0;
+    Current = &WatchContext->Snapshots[WatchContext->CurrentSnapshot];
+    if (!MemWatchCaptureSnapshot(WatchContext, Current)) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("mem: cannot query processes\n"));
+        goto Exit;
+    }
+
+    WatchContext->StartTime = Current->Time;
+    WatchContext->FirstSystemCommit = Current->SystemCommit;
+    WatchContext->PeakSystemCommit = Current->SystemCommit;
+    MemWatchCalculateDeltas(WatchContext, Current, NULL);
+    MemWatchOutputSample(WatchContext, Current, 0);
+
+    for (SampleIndex = 1; WatchContext->SampleCount == 0 || SampleIndex < WatchContext->SampleCount; SampleIndex++) {
+
+        CancelEvent = YoriLibCancelGetEvent();
+        if (CancelEvent != NULL) {
+            if (WaitForSingleObject(CancelEvent, WatchContext->Interval) == WAIT_OBJECT_0) {
+                break;
+            }
+        } else {
+            Sleep(WatchContext->Interval);
+        }
+
+        if (YoriLibIsOperationCancelled()) {
+            break;
+        }
+
+        Previous = Current;
+        WatchContext->CurrentSnapshot = 1 - WatchContext->CurrentSnapshot;
+        Current = &WatchContext->Snapshots[WatchContext->CurrentSnapshot];
+        if (!MemWatchCaptureSnapshot(WatchContext, Current)) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("mem: cannot query processes\n"));
+            goto Exit;
+        }
+
+        if (Current->SystemCommit > WatchContext->PeakSystemCommit) {
+            WatchContext->PeakSystemCommit = Current->SystemCommit;
+        }
+
+        MemWatchCalculateDeltas(WatchContext, Current, Previous);
+        MemWatchOutputSample(WatchContext, Current, SampleIndex);
+    }
+
+    Result = TRUE;
+
+Exit:
+    MemWatchCleanup(WatchContext);
+    return Result;
+}
+
 #ifdef YORI_BUILTIN
 /**
  The main entrypoint for the mem builtin command.
@@ -523,6 +1322,7 @@ ENTRYPOINT(
     BOOLEAN DisplayGraph = TRUE;
     YORI_STRING Arg;
     MEM_CONTEXT MemContext;
+    MEM_WATCH_CONTEXT WatchContext;
     YORI_STRING DisplayString;
     YORI_STRING AllocatedFormatString;
     LPTSTR DefaultFormatString = _T("Total Physical: $TOTALMEM$\n")
@@ -531,6 +1331,7 @@ ENTRYPOINT(
                                  _T("Available Commit: $AVAILABLECOMMIT$\n");
 
     ZeroMemory(&MemContext, sizeof(MemContext));
+    ZeroMemory(&WatchContext, sizeof(WatchContext));
 
     for (i = 1; i < ArgC; i++) {
 
@@ -548,9 +1349,39 @@ ENTRYPOINT(
             } else if (YoriLibCompareStringLitIns(&Arg, _T("c")) == 0) {
                 DisplayProcesses = TRUE;
                 ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("count")) == 0 &&
+                       i + 1 < ArgC) {
+
+                YORI_MAX_SIGNED_T llTemp;
+                YORI_ALLOC_SIZE_T CharsConsumed;
+
+                llTemp = 0;
+                if (YoriLibStringToNumber(&ArgV[i + 1], TRUE, &llTemp, &CharsConsumed) &&
+                    CharsConsumed > 0 &&
+                    llTemp > 0) {
+
+                    WatchContext.SampleCount = (DWORD)llTemp;
+                }
+                i = i + 1;
+                ArgumentUnderstood = TRUE;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("g")) == 0) {
                 GroupProcesses = TRUE;
                 ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("i")) == 0 &&
+                       i + 1 < ArgC) {
+
+                YORI_MAX_SIGNED_T llTemp;
+                YORI_ALLOC_SIZE_T CharsConsumed;
+
+                llTemp = 0;
+                if (YoriLibStringToNumber(&ArgV[i + 1], TRUE, &llTemp, &CharsConsumed) &&
+                    CharsConsumed > 0 &&
+                    llTemp > 0) {
+
+                    WatchContext.Interval = (DWORD)llTemp;
+                }
+                i = i + 1;
+                ArgumentUnderstood = TRUE;
             }
         } else {
             ArgumentUnderstood = TRUE;
@@ -563,6 +1394,17 @@ ENTRYPOINT(
         }
     }
 
+    if (WatchContext.Interval != 0) {
+#if YORI_BUILTIN
+        YoriLibCancelEnable(FALSE);
+#endif
+        WatchContext.GroupProcesses = GroupProcesses;
+        if (!MemWatchProcessMemoryUsage(&WatchContext)) {
+            return EXIT_FAILURE;
+        }
+        return EXIT_SUCCESS;
+    }
+
     if (StartArg > 0) {
         DisplayGraph = FALSE;
         if (!YoriLibBuildCmdlineFromArgcArgv(ArgC - StartArg, &ArgV[StartArg], TRUE, FALSE, &AllocatedFormatString)) {
@@ -84,6 +84,9 @@ MoreAddPhysicalLineToBuffer(
     YORI_ALLOC_SIZE_T TabIndex;
     YORI_ALLOC_SIZE_T Alignment;
     YORI_ALLOC_SIZE_T BytesRequired;
+    YORI_ALLOC_SIZE_T CharsRequired;
+    YORI_STRING LineContents;
+    LPTSTR LineText;
 
     //
     //  Count the number of tabs.  These are replaced at ingestion time, 
@@ -100,12 +103,15 @@ MoreAddPhysicalLineToBuffer(
     }
 
     //
-    //  We need space for the structure, all characters in the source, a NULL,
-    //  and since tabs will be replaced with spaces the number of spaces per
-    //  tab minus one (for the tab character being removed.)
+    //  The text needs space for all characters in the source, and since tabs
+    //  will be replaced with spaces the number of spaces per tab minus one
+    //  (for the tab character being removed.)  The text is held in the line
+    //  store, which may move it out of memory, so the structure is allocated
+    //  seperately.
     //
 
-    BytesRequired = sizeof(MORE_PHYSICAL_LINE) + (LineString->LengthInChars + TabCount * (MoreContext->TabWidth - 1) + 1) * sizeof(TCHAR);
+    CharsRequired = LineString->LengthInChars + TabCount * (MoreContext->TabWidth - 1);
+    BytesRequired = sizeof(MORE_PHYSICAL_LINE);
 
     //
     //  If we need a buffer, allocate a buffer that typically has space for
@@ -143,9 +149,16 @@ MoreAddPhysicalLineToBuffer(
     NewLine->InitialColor = AllocContext->PreviousColor;
     NewLine->LineNumber = MoreContext->LineCount + 1;
     NewLine->FilteredLineNumber = NewLine->LineNumber;
-    YoriLibReference(AllocContext->Buffer);
-    NewLine->LineContents.MemoryToFree = AllocContext->Buffer;
-    NewLine->LineContents.StartOfString = (LPTSTR)(NewLine + 1);
+    NewLine->WrapWidth = 0;
+    NewLine->WrapLogicalLineCount = 0;
+    NewLine->WrapBreaks = NULL;
+
+    LineText = MoreAllocateLineText(MoreContext, NewLine, CharsRequired);
+    if (LineText == NULL) {
+        YoriLibDereference(AllocContext->Buffer);
+        MoreContext->OutOfMemory = TRUE;
+        return FALSE;
+    }
 
     for (CharIndex = 0, DestIndex = 0; CharIndex < LineString->LengthInChars; CharIndex++) {
         //
@@ -153,42 +166,37 @@ MoreAddPhysicalLineToBuffer(
         //  Look for the final letter after any numbers or semicolon.
         //
 
-        if (LineString->LengthInChars > CharIndex + 2 &&
-            LineString->StartOfString[CharIndex] == 27 &&
-            LineString->StartOfString[CharIndex + 1] == '[') {
+        if (LineString->StartOfString[CharIndex] == 27) {
 
             YORI_STRING EscapeSubset;
-            YORI_ALLOC_SIZE_T EndOfEscape;
+            YORI_ALLOC_SIZE_T EscapeLength;
 
             YoriLibInitEmptyString(&EscapeSubset);
-            EscapeSubset.StartOfString = &LineString->StartOfString[CharIndex + 2];
-            EscapeSubset.LengthInChars = LineString->LengthInChars - CharIndex - 2;
-            EndOfEscape = YoriLibCntStringWithChars(&EscapeSubset, _T("0123456789;"));
+            EscapeSubset.StartOfString = &LineString->StartOfString[CharIndex];
+            EscapeSubset.LengthInChars = LineString->LengthInChars - CharIndex;
 
             //
             //  Look for color changes so any later line can be marked as
             //  starting with this color.
             //
 
-            if (LineString->LengthInChars > CharIndex + 2 + EndOfEscape) {
-                EscapeSubset.StartOfString -= 2;
-                EscapeSubset.LengthInChars = EndOfEscape + 3;
+            if (YoriLibVtGetEscapeLength(&EscapeSubset, &EscapeLength)) {
+                EscapeSubset.LengthInChars = EscapeLength;
                 YoriLibVtFinalColorFromEsc(AllocContext->PreviousColor, &EscapeSubset, &AllocContext->PreviousColor);
             }
         }
         if (LineString->StartOfString[CharIndex] == '\t') {
             for (TabIndex = 0; TabIndex < MoreContext->TabWidth; TabIndex++) {
-                NewLine->LineContents.StartOfString[DestIndex] = ' ';
+                LineText[DestIndex] = ' ';
                 DestIndex++;
             }
         } else {
-            NewLine->LineContents.StartOfString[DestIndex] = LineString->StartOfString[CharIndex];
+            LineText[DestIndex] = LineString->StartOfString[CharIndex];
             DestIndex++;
         }
     }
-    NewLine->LineContents.StartOfString[DestIndex] = '\0';
-    NewLine->LineContents.LengthInChars = DestIndex;
-    NewLine->LineContents.LengthAllocated = DestIndex + 1;
+    LineText[DestIndex] = '\0';
+    NewLine->ContentsLength = DestIndex;
 
     AllocContext->BufferOffset = AllocContext->BufferOffset + BytesRequired;
     AllocContext->BytesRemainingInBuffer = AllocContext->BytesRemainingInBuffer - BytesRequired;
@@ -206,14 +214,21 @@ MoreAddPhysicalLineToBuffer(
     }
 
     //
-    //  Insert the new line into the list
+    //  Insert the new line into the list.  The text was just populated by
+    //  this thread into the block being ingested, which cannot be discarded
+    //  until this thread moves to a new block, so it can be searched
+    //  directly.
     //
 
+    YoriLibInitEmptyString(&LineContents);
+    LineContents.StartOfString = LineText;
+    LineContents.LengthInChars = NewLine->ContentsLength;
+
     WaitForSingleObject(MoreContext->PhysicalLineMutex, INFINITE);
     MoreContext->LineCount++;
     YoriLibAppendList(&MoreContext->PhysicalLineList, &NewLine->LineList);
     if (!MoreContext->FilterToSearch ||
-        MoreFindNextSearchMatch(MoreContext, &NewLine->LineContents, NULL, NULL)) {
+        MoreFindNextSearchMatch(MoreContext, &LineContents, NULL, NULL, NULL)) {
 
         YoriLibAppendList(&MoreContext->FilteredPhysicalLineList, &NewLine->FilteredLineList);
         MoreContext->FilteredLineCount++;
@@ -280,8 +295,8 @@ MoreProcessStream(
 
     //
     //  If waiting for more, try to read another line.  If there's not
-    //  enough data for an entire line, sleep for a bit and try again. If
-    //  there is enough for another line, add it.
+    //  enough data for an entire line, wait for the stream to change and
+    //  try again. If there is enough for another line, add it.
     //
 
     if (MoreContext->WaitForMore && !Terminate) {
@@ -292,7 +307,10 @@ MoreProcessStream(
                     break;
                 }
 
-                Sleep(200);
+                if (!YoriLibLineReadWaitForMore(LineContext, hSource, MoreContext->ShutdownEvent)) {
+                    Terminate = TRUE;
+                    break;
+                }
                 continue;
             }
 
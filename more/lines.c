@@ -79,6 +79,65 @@ MoreSearchCountActive(
     return CountFound;
 }
 
+/**
+ Find the first match of a single search string within a physical line.
+ When searching for regular expressions, empty matches are skipped, since
+ they have nothing to display.
+
+ @param MoreContext Pointer to the context indicating the strings to search
+        for.
+
+ @param StringToSearch Pointer to the string to search within, which is
+        typically a physical line or subset of one.
+
+ @param SearchIndex Specifies the index of the search string to look for.
+
+ @param MatchOffset On successful completion, updated to indicate the offset
+        within StringToSearch where a match was found.
+
+ @param MatchLength On successful completion, updated to indicate the number
+        of characters within StringToSearch that matched.
+
+ @return TRUE to indicate a search match was found, FALSE if it was not.
+ */
+__success(return)
+BOOLEAN
+MoreFindSearchStringMatch(
+    __in PMORE_CONTEXT MoreContext,
+    __in PCYORI_STRING StringToSearch,
+    __in UCHAR SearchIndex,
+    __out PYORI_ALLOC_SIZE_T MatchOffset,
+    __out PYORI_ALLOC_SIZE_T MatchLength
+    )
+{
+    YORI_ALLOC_SIZE_T StartOffset;
+
+    if (!MoreContext->RegexSearch) {
+        if (YoriLibFindFirstMatchSubstrIns(StringToSearch, 1, &MoreContext->SearchStrings[SearchIndex], MatchOffset) == NULL) {
+            return FALSE;
+        }
+        *MatchLength = MoreContext->SearchStrings[SearchIndex].LengthInChars;
+        return TRUE;
+    }
+
+    if (!MoreContext->SearchRegexValid[SearchIndex]) {
+        return FALSE;
+    }
+
+    StartOffset = 0;
+    while (StartOffset <= StringToSearch->LengthInChars) {
+        if (!YoriLibRegexSearch(&MoreContext->SearchRegex[SearchIndex], StringToSearch, StartOffset, MatchOffset, MatchLength)) {
+            return FALSE;
+        }
+        if (*MatchLength > 0) {
+            return TRUE;
+        }
+        StartOffset = *MatchOffset + 1;
+    }
+
+    return FALSE;
+}
+
 /**
  Find the next search match within a physical line.
 
@@ -92,6 +151,9 @@ MoreSearchCountActive(
         completion indicating the offset within StringToSearch where a match
         was found.
 
+ @param MatchLength Optionally points to a value to update on successful
+        completion indicating the number of characters that matched.
+
  @param MatchIndex Optionally points to a value to update on successful
         completion indicating which matching string was located.
 
@@ -103,17 +165,66 @@ MoreFindNextSearchMatch(
     __in PMORE_CONTEXT MoreContext,
     __in PCYORI_STRING StringToSearch,
     __out_opt PYORI_ALLOC_SIZE_T MatchOffset,
+    __out_opt PYORI_ALLOC_SIZE_T MatchLength,
     __out_opt PUCHAR MatchIndex
     )
 {
     PYORI_STRING Found;
     UCHAR Index;
     UCHAR CountFound;
+    UCHAR BestIndex;
+    YORI_ALLOC_SIZE_T BestOffset;
+    YORI_ALLOC_SIZE_T BestLength;
+    YORI_ALLOC_SIZE_T ThisOffset;
+    YORI_ALLOC_SIZE_T ThisLength;
 
     CountFound = MoreSearchCountActive(MoreContext);
 
-    Found = YoriLibFindFirstMatchSubstrIns(StringToSearch, CountFound, MoreContext->SearchStrings, MatchOffset);
+    //
+    //  Regular expressions are evaluated one at a time, and the earliest
+    //  match wins.  If two match at the same offset, the earlier search
+    //  string wins.
+    //
+
+    if (MoreContext->RegexSearch) {
+        BestIndex = CountFound;
+        BestOffset = 0;
+        BestLength = 0;
+        for (Index = 0; Index < CountFound; Index++) {
+            if (MoreFindSearchStringMatch(MoreContext, StringToSearch, Index, &ThisOffset, &ThisLength)) {
+                if (BestIndex == CountFound || ThisOffset < BestOffset) {
+                    BestIndex = Index;
+                    BestOffset = ThisOffset;
+                    BestLength = ThisLength;
+                }
+            }
+        }
+
+        if (BestIndex == CountFound) {
+            return FALSE;
+        }
+
+        if (MatchOffset != NULL) {
+            *MatchOffset = BestOffset;
+        }
+        if (MatchLength != NULL) {
+            *MatchLength = BestLength;
+        }
+        if (MatchIndex != NULL) {
+            *MatchIndex = BestIndex;
+        }
+        return TRUE;
+    }
+
+    if (MoreContext->SearchMatcherValid) {
+        Found = YoriLibSubstringMatcherFindFirst(&MoreContext->SearchMatcher, StringToSearch, MatchOffset);
+    } else {
+        Found = YoriLibFindFirstMatchSubstrIns(StringToSearch, CountFound, MoreContext->SearchStrings, MatchOffset);
+    }
     if (Found != NULL) {
+        if (MatchLength != NULL) {
+            *MatchLength = Found->LengthInChars;
+        }
         if (MatchIndex != NULL) {
 
             for (Index = 0; Index < CountFound; Index++) {
@@ -238,6 +349,55 @@ MoreSearchIndexFree(
 
     YoriLibInitEmptyString(&MoreContext->SearchStrings[Index]);
     MoreContext->SearchContext[Index].ColorIndex = (UCHAR)-1;
+
+    MoreSearchStringsChanged(MoreContext);
+}
+
+/**
+ Indicate that the set of search strings, or the contents of a search
+ string, has changed.  This prepares a matcher to search for all of the
+ active search strings in a single pass over each line.  If the matcher
+ cannot be prepared, the strings are searched for directly.  When searching
+ for regular expressions, each search string is compiled instead.
+
+ @param MoreContext Pointer to the more context including search strings.
+ */
+VOID
+MoreSearchStringsChanged(
+    __in PMORE_CONTEXT MoreContext
+    )
+{
+    UCHAR CountFound;
+    UCHAR Index;
+
+    WaitForSingleObject(MoreContext->PhysicalLineMutex, INFINITE);
+
+    if (MoreContext->SearchMatcherValid) {
+        YoriLibSubstringMatcherCleanup(&MoreContext->SearchMatcher);
+        MoreContext->SearchMatcherValid = FALSE;
+    }
+
+    for (Index = 0; Index < MORE_MAX_SEARCHES; Index++) {
+        if (MoreContext->SearchRegexValid[Index]) {
+            YoriLibRegexCleanup(&MoreContext->SearchRegex[Index]);
+            MoreContext->SearchRegexValid[Index] = FALSE;
+        }
+    }
+
+    CountFound = MoreSearchCountActive(MoreContext);
+    if (MoreContext->RegexSearch) {
+        for (Index = 0; Index < CountFound; Index++) {
+            if (YoriLibRegexCompile(&MoreContext->SearchRegex[Index], &MoreContext->SearchStrings[Index], TRUE, NULL)) {
+                MoreContext->SearchRegexValid[Index] = TRUE;
+            }
+        }
+    } else if (CountFound > 0 &&
+        YoriLibSubstringMatcherInitialize(&MoreContext->SearchMatcher, CountFound, MoreContext->SearchStrings, TRUE)) {
+
+        MoreContext->SearchMatcherValid = TRUE;
+    }
+
+    ReleaseMutex(MoreContext->PhysicalLineMutex);
 }
 
 /**
@@ -258,7 +418,7 @@ MoreTruncateStringToVisibleChars(
     )
 {
     YORI_STRING EscapeSubset;
-    YORI_ALLOC_SIZE_T EndOfEscape;
+    YORI_ALLOC_SIZE_T EscapeLength;
     YORI_ALLOC_SIZE_T VisibleCharsFound;
     YORI_ALLOC_SIZE_T Index;
 
@@ -271,20 +431,18 @@ MoreTruncateStringToVisibleChars(
         //  Look for the final letter after any numbers or semicolon.
         //
 
-        if (String->LengthInChars > Index + 2 &&
-            String->StartOfString[Index] == 27 &&
-            String->StartOfString[Index + 1] == '[') {
+        YoriLibInitEmptyString(&EscapeSubset);
+        EscapeSubset.StartOfString = &String->StartOfString[Index];
+        EscapeSubset.LengthInChars = String->LengthInChars - Index;
+        YoriLibVtGetEscapeLength(&EscapeSubset, &EscapeLength);
+        if (EscapeLength > 0) {
 
-            YoriLibInitEmptyString(&EscapeSubset);
-            EscapeSubset.StartOfString = &String->StartOfString[Index + 2];
-            EscapeSubset.LengthInChars = String->LengthInChars - Index - 2;
-            EndOfEscape = YoriLibCntStringWithChars(&EscapeSubset, _T("0123456789;"));
             //
             //  Note the trailing char is a letter.  This points index to that
             //  char.
             //
 
-            Index = Index + 2 + EndOfEscape;
+            Index = Index + EscapeLength - 1;
         } else if (VisibleCharsFound < VisibleChars) {
             VisibleCharsFound++;
         } else {
@@ -383,13 +541,93 @@ MoreGetPreviousFilteredPhysicalLine(
     return ThisLine;
 }
 
+/**
+ State carried from one physical line to the next while applying a new
+ search criteria to the set of filtered lines.
+ */
+typedef struct _MORE_FILTER_UPDATE_STATE {
+
+    /**
+     The most recent physical line found to match the filter.
+     */
+    PMORE_PHYSICAL_LINE PreviousFilteredLine;
+
+    /**
+     The number of physical lines found to match the filter so far.
+     */
+    DWORDLONG FilteredLineNumber;
+
+    /**
+     The line number of the physical line which was previously displayed at
+     the top of the viewport, or zero if none was displayed.
+     */
+    DWORDLONG PreviousStartLineNumber;
+
+    /**
+     The physical line to display at the top of the viewport once the
+     filter has been applied.
+     */
+    PMORE_PHYSICAL_LINE NewStartPoint;
+} MORE_FILTER_UPDATE_STATE, *PMORE_FILTER_UPDATE_STATE;
+
+/**
+ Update the filtered line list to account for whether a single physical line
+ matches the filter.  Physical lines must be processed in order.  This must
+ be called with PhysicalLineMutex held.
+
+ @param MoreContext Pointer to the more context.
+
+ @param State Pointer to state carried from the previous physical line.
+
+ @param ThisLine Pointer to the physical line to apply.
+
+ @param MatchFound TRUE if the line matches the filter, FALSE if it does
+        not.
+ */
+VOID
+MoreApplyFilterToLine(
+    __in PMORE_CONTEXT MoreContext,
+    __inout PMORE_FILTER_UPDATE_STATE State,
+    __in PMORE_PHYSICAL_LINE ThisLine,
+    __in BOOLEAN MatchFound
+    )
+{
+    if (!MatchFound) {
+        if (ThisLine->FilteredLineList.Next != NULL) {
+            ASSERT(MoreContext->FilteredLineCount > 0);
+            MoreContext->FilteredLineCount--;
+            YoriLibRemoveListItem(&ThisLine->FilteredLineList);
+            ThisLine->FilteredLineList.Next = NULL;
+        }
+    } else {
+        if (ThisLine->FilteredLineList.Next == NULL) {
+            if (State->PreviousFilteredLine != NULL) {
+                ASSERT(ThisLine->LineNumber > State->PreviousFilteredLine->LineNumber);
+                YoriLibInsertList(&State->PreviousFilteredLine->FilteredLineList, &ThisLine->FilteredLineList);
+            } else {
+                YoriLibInsertList(&MoreContext->FilteredPhysicalLineList, &ThisLine->FilteredLineList);
+            }
+            MoreContext->FilteredLineCount++;
+            ASSERT(MoreContext->FilteredLineCount <= MoreContext->LineCount);
+        }
+        State->FilteredLineNumber++;
+        ThisLine->FilteredLineNumber = State->FilteredLineNumber;
+        State->PreviousFilteredLine = ThisLine;
+        if (State->NewStartPoint == NULL && ThisLine->LineNumber >= State->PreviousStartLineNumber) {
+            State->NewStartPoint = ThisLine;
+        }
+    }
+}
+
 /**
  Apply a new search criteria to update the set of filtered lines.
 
- MSFIX This routine wants to be much smarter.  Ideally it would initiate an
- asynchronous process that gets synchronized when next/previous lines are
- needed.  This would allow the display to rapidly update while the number of
- filtered lines is updated in the background (refreshing the status line.)
+ Lines are collected in windows and the search criteria is evaluated on
+ multiple threads without holding PhysicalLineMutex, so ingestion can
+ continue, and lines added during this time are evaluated against the new
+ criteria by the ingest thread.  Progress is displayed in the status line.
+ If the user cancels, any lines which have not been evaluated retain their
+ previous filter state.
 
  @param MoreContext Pointer to the more context, indicating the current search
         terms.
@@ -409,69 +647,104 @@ MoreUpdateFilteredLines(
     )
 {
     PYORI_LIST_ENTRY ListEntry;
-    PMORE_PHYSICAL_LINE PreviousFilteredLine;
     PMORE_PHYSICAL_LINE ThisLine;
     BOOLEAN MatchFound;
-    DWORDLONG FilteredLineNumber;
-    DWORDLONG PreviousStartLineNumber;
-    PMORE_PHYSICAL_LINE NewStartPoint;
+    BOOLEAN ParallelSearch;
+    MORE_FILTER_UPDATE_STATE State;
+    MORE_PARALLEL_SEARCH Search;
+    YORI_STRING LineContents;
+    YORI_ALLOC_SIZE_T Index;
 
-    PreviousStartLineNumber = 0;
-    NewStartPoint = NULL;
+    State.PreviousStartLineNumber = 0;
+    State.NewStartPoint = NULL;
+    State.PreviousFilteredLine = NULL;
+    State.FilteredLineNumber = 0;
     if (PreviousStartPoint != NULL) {
-        PreviousStartLineNumber = PreviousStartPoint->LineNumber;
+        State.PreviousStartLineNumber = PreviousStartPoint->LineNumber;
     }
 
     WaitForSingleObject(MoreContext->PhysicalLineMutex, INFINITE);
 
-    PreviousFilteredLine = NULL;
-    FilteredLineNumber = 0;
+    ParallelSearch = FALSE;
+    if (MoreContext->FilterToSearch &&
+        MoreInitializeParallelSearch(MoreContext, FALSE, TRUE, MoreContext->LineCount, &Search)) {
+
+        ParallelSearch = TRUE;
+    }
+
     ListEntry = YoriLibGetNextListEntry(&MoreContext->PhysicalLineList, NULL);
 
     while (ListEntry != NULL) {
 
-        ThisLine = CONTAINING_RECORD(ListEntry, MORE_PHYSICAL_LINE, LineList);
-        if (MoreContext->FilterToSearch) {
-            MatchFound = MoreFindNextSearchMatch(MoreContext, &ThisLine->LineContents, NULL, NULL);
-        } else {
-            MatchFound = TRUE;
-        }
+        if (ParallelSearch && !Search.Cancelled) {
 
-        if (!MatchFound) {
-            if (ThisLine->FilteredLineList.Next != NULL) {
-                ASSERT(MoreContext->FilteredLineCount > 0);
-                MoreContext->FilteredLineCount--;
-                YoriLibRemoveListItem(&ThisLine->FilteredLineList);
-                ThisLine->FilteredLineList.Next = NULL;
+            //
+            //  Collect the next window of lines and search them without
+            //  holding the lock.  The lines themselves are immutable, and
+            //  any concurrent change is limited to appending new lines.
+            //
+
+            Search.LineCount = 0;
+            while (ListEntry != NULL && Search.LineCount < MORE_SEARCH_WINDOW_LINES) {
+                Search.Lines[Search.LineCount] = CONTAINING_RECORD(ListEntry, MORE_PHYSICAL_LINE, LineList);
+                Search.LineCount++;
+                ListEntry = YoriLibGetNextListEntry(&MoreContext->PhysicalLineList, ListEntry);
             }
-        } else {
-            if (ThisLine->FilteredLineList.Next == NULL) {
-                if (PreviousFilteredLine != NULL) {
-                    ASSERT(ThisLine->LineNumber > PreviousFilteredLine->LineNumber);
-                    YoriLibInsertList(&PreviousFilteredLine->FilteredLineList, &ThisLine->FilteredLineList);
+
+            ReleaseMutex(MoreContext->PhysicalLineMutex);
+            MoreExecuteParallelSearch(&Search);
+            WaitForSingleObject(MoreContext->PhysicalLineMutex, INFINITE);
+
+            for (Index = 0; Index < Search.LineCount; Index++) {
+                ThisLine = Search.Lines[Index];
+                if (Search.Results[Index] == MoreSearchResultMatch) {
+                    MatchFound = TRUE;
+                } else if (Search.Results[Index] == MoreSearchResultNoMatch) {
+                    MatchFound = FALSE;
                 } else {
-                    YoriLibInsertList(&MoreContext->FilteredPhysicalLineList, &ThisLine->FilteredLineList);
+                    MatchFound = (BOOLEAN)(ThisLine->FilteredLineList.Next != NULL);
                 }
-                MoreContext->FilteredLineCount++;
-                ASSERT(MoreContext->FilteredLineCount <= MoreContext->LineCount);
+                MoreApplyFilterToLine(MoreContext, &State, ThisLine, MatchFound);
             }
-            FilteredLineNumber++;
-            ThisLine->FilteredLineNumber = FilteredLineNumber;
-            PreviousFilteredLine = ThisLine;
-            if (NewStartPoint == NULL && ThisLine->LineNumber >= PreviousStartLineNumber) {
-                NewStartPoint = ThisLine;
+
+            ThisLine = Search.Lines[Search.LineCount - 1];
+            ListEntry = YoriLibGetNextListEntry(&MoreContext->PhysicalLineList, &ThisLine->LineList);
+            continue;
+        }
+
+        ThisLine = CONTAINING_RECORD(ListEntry, MORE_PHYSICAL_LINE, LineList);
+        if (ParallelSearch) {
+
+            //
+            //  The search was cancelled.  Leave the line as it was, but
+            //  keep walking so filtered line numbers remain consistent.
+            //
+
+            MatchFound = (BOOLEAN)(ThisLine->FilteredLineList.Next != NULL);
+        } else if (MoreContext->FilterToSearch) {
+            MatchFound = FALSE;
+            if (MoreAcquirePhysicalLineContents(MoreContext, ThisLine, &LineContents)) {
+                MatchFound = MoreFindNextSearchMatch(MoreContext, &LineContents, NULL, NULL, NULL);
+                YoriLibFreeStringContents(&LineContents);
             }
+        } else {
+            MatchFound = TRUE;
         }
 
+        MoreApplyFilterToLine(MoreContext, &State, ThisLine, MatchFound);
 
         ListEntry = YoriLibGetNextListEntry(&MoreContext->PhysicalLineList, &ThisLine->LineList);
     }
 
-    ASSERT(MoreContext->FilteredLineCount == FilteredLineNumber);
+    ASSERT(MoreContext->FilteredLineCount == State.FilteredLineNumber);
 
     ReleaseMutex(MoreContext->PhysicalLineMutex);
 
-    return NewStartPoint;
+    if (ParallelSearch) {
+        MoreCleanupParallelSearch(&Search);
+    }
+
+    return State.NewStartPoint;
 }
 
 
@@ -531,7 +804,8 @@ MoreGetLogicalLineLength(
     YORI_ALLOC_SIZE_T CharsInOutputBuffer;
     YORI_ALLOC_SIZE_T CellsDisplayed;
     YORI_STRING EscapeSubset;
-    YORI_ALLOC_SIZE_T EndOfEscape;
+    YORI_ALLOC_SIZE_T EscapeLength;
+    BOOLEAN EscapeComplete;
     WORD CurrentColor = InitialDisplayColor;
     WORD CurrentUserColor = InitialUserColor;
     YORI_STRING MatchEscapeChars;
@@ -580,9 +854,8 @@ MoreGetLogicalLineLength(
             YoriLibInitEmptyString(&StringForNextMatch);
             StringForNextMatch.StartOfString = &PhysicalLineSubset->StartOfString[SourceIndex];
             StringForNextMatch.LengthInChars = PhysicalLineSubset->LengthInChars - SourceIndex;
-            MatchFound = MoreFindNextSearchMatch(MoreContext, &StringForNextMatch, &MatchOffset, &MatchIndex);
+            MatchFound = MoreFindNextSearchMatch(MoreContext, &StringForNextMatch, &MatchOffset, &MatchLength, &MatchIndex);
             if (MatchFound) {
-                MatchLength = MoreContext->SearchStrings[MatchIndex].LengthInChars;
                 SearchColor = MoreContext->SearchColors[MoreContext->SearchContext[MatchIndex].ColorIndex];
                 MatchOffset = MatchOffset + SourceIndex;
             }
@@ -593,14 +866,12 @@ MoreGetLogicalLineLength(
         //  Look for the final letter after any numbers or semicolon.
         //
 
-        if (PhysicalLineSubset->LengthInChars > SourceIndex + 2 &&
-            PhysicalLineSubset->StartOfString[SourceIndex] == 27 &&
-            PhysicalLineSubset->StartOfString[SourceIndex + 1] == '[') {
+        YoriLibInitEmptyString(&EscapeSubset);
+        EscapeSubset.StartOfString = &PhysicalLineSubset->StartOfString[SourceIndex];
+        EscapeSubset.LengthInChars = PhysicalLineSubset->LengthInChars - SourceIndex;
+        EscapeComplete = YoriLibVtGetEscapeLength(&EscapeSubset, &EscapeLength);
 
-            YoriLibInitEmptyString(&EscapeSubset);
-            EscapeSubset.StartOfString = &PhysicalLineSubset->StartOfString[SourceIndex + 2];
-            EscapeSubset.LengthInChars = PhysicalLineSubset->LengthInChars - SourceIndex - 2;
-            EndOfEscape = YoriLibCntStringWithChars(&EscapeSubset, _T("0123456789;"));
+        if (EscapeLength > 0) {
 
             //
             //  Count everything as consuming the source and needing buffer
@@ -608,19 +879,18 @@ MoreGetLogicalLineLength(
             //  may include the final letter, if we found one.
             //
 
-            if (PhysicalLineSubset->LengthInChars > SourceIndex + 2 + EndOfEscape) {
-                CharsInOutputBuffer += 3 + EndOfEscape;
-                SourceIndex += 3 + EndOfEscape;
+            if (EscapeComplete) {
+                CharsInOutputBuffer += EscapeLength;
+                SourceIndex += EscapeLength;
 
-                EscapeSubset.StartOfString -= 2;
-                EscapeSubset.LengthInChars = EndOfEscape + 3;
+                EscapeSubset.LengthInChars = EscapeLength;
                 YoriLibVtFinalColorFromEsc(CurrentUserColor, &EscapeSubset, &CurrentUserColor);
                 if (!MatchFound || SourceIndex < MatchOffset) {
                     CurrentColor = CurrentUserColor;
                 }
             } else {
-                CharsInOutputBuffer += 2 + EndOfEscape;
-                SourceIndex += 2 + EndOfEscape;
+                CharsInOutputBuffer += EscapeLength;
+                SourceIndex += EscapeLength;
             }
         } else {
             if (MatchFound) {
@@ -694,9 +964,11 @@ MoreGetLogicalLineLength(
 }
 
 /**
- Return the number of logical lines that can be derived from a single
- physical line.  Note that each physical line must have at least one logical
- line, because an empty physical line translates to an empty logical line.
+ Calculate where each logical line begins within a physical line at the
+ current viewport width, and record this on the physical line so it does
+ not need to be recalculated until the viewport width changes.  Wrapping
+ does not depend on search criteria, since search highlights consume no
+ display cells.
 
  @param MoreContext Pointer to the more context containing the data to
         display.
@@ -704,31 +976,127 @@ MoreGetLogicalLineLength(
  @param PhysicalLine Pointer to the physical line to decompose into one or
         more logical lines.
 
+ @param LineContents Pointer to the text of the physical line.
+
  @return The number of logical lines within the physical line.
  */
 YORI_ALLOC_SIZE_T
-MoreCountLogicalLinesOnPhysicalLine(
+MoreBuildWrapBreaks(
     __in PMORE_CONTEXT MoreContext,
-    __in PMORE_PHYSICAL_LINE PhysicalLine
+    __in PMORE_PHYSICAL_LINE PhysicalLine,
+    __in PYORI_STRING LineContents
     )
 {
     YORI_ALLOC_SIZE_T Count = 0;
+    YORI_ALLOC_SIZE_T CharIndex = 0;
     YORI_ALLOC_SIZE_T LogicalLineLength;
+    YORI_ALLOC_SIZE_T MaximumBreaks;
     YORI_STRING Subset;
+    PMORE_WRAP_BREAK Breaks;
+    MORE_LINE_END_CONTEXT LineEndContext;
+    WORD UserColor;
+
+    if (PhysicalLine->WrapBreaks != NULL) {
+        YoriLibFree(PhysicalLine->WrapBreaks);
+        PhysicalLine->WrapBreaks = NULL;
+    }
+    PhysicalLine->WrapWidth = 0;
 
+    //
+    //  Each logical line except the last contains ViewportWidth visible
+    //  characters, and there are no more visible characters than characters,
+    //  which bounds the number of breaks.  Lines that can't wrap don't need
+    //  an array.
+    //
+
+    Breaks = NULL;
+    if (LineContents->LengthInChars > MoreContext->ViewportWidth) {
+        MaximumBreaks = LineContents->LengthInChars / MoreContext->ViewportWidth + 1;
+        Breaks = YoriLibMalloc(MaximumBreaks * sizeof(MORE_WRAP_BREAK));
+    } else {
+        MaximumBreaks = 1;
+    }
+
+    UserColor = PhysicalLine->InitialColor;
     YoriLibInitEmptyString(&Subset);
-    Subset.StartOfString = PhysicalLine->LineContents.StartOfString;
-    Subset.LengthInChars = PhysicalLine->LineContents.LengthInChars;
+    Subset.StartOfString = LineContents->StartOfString;
+    Subset.LengthInChars = LineContents->LengthInChars;
     while(TRUE) {
-        LogicalLineLength = MoreGetLogicalLineLength(MoreContext, &Subset, MoreContext->ViewportWidth, 0, 0, 0, NULL);
+        ASSERT(Count < MaximumBreaks);
+        if (Breaks != NULL && Count < MaximumBreaks) {
+            Breaks[Count].Offset = CharIndex;
+            Breaks[Count].UserColor = UserColor;
+        }
+        LogicalLineLength = MoreGetLogicalLineLength(MoreContext, &Subset, MoreContext->ViewportWidth, UserColor, UserColor, 0, &LineEndContext);
+        UserColor = LineEndContext.FinalUserColor;
         Subset.StartOfString += LogicalLineLength;
         Subset.LengthInChars = Subset.LengthInChars - LogicalLineLength;
+        CharIndex = CharIndex + LogicalLineLength;
         Count++;
         if (Subset.LengthInChars == 0) {
             break;
         }
     }
 
+    //
+    //  If the line wrapped but there was no memory to describe where, the
+    //  count is still correct but is not retained.
+    //
+
+    if (Count > 1 && Breaks == NULL) {
+        return Count;
+    }
+
+    if (Count == 1 && Breaks != NULL) {
+        YoriLibFree(Breaks);
+        Breaks = NULL;
+    }
+
+    PhysicalLine->WrapBreaks = Breaks;
+    PhysicalLine->WrapLogicalLineCount = Count;
+    PhysicalLine->WrapWidth = MoreContext->ViewportWidth;
+
+    return Count;
+}
+
+/**
+ Return the number of logical lines that can be derived from a single
+ physical line.  Note that each physical line must have at least one logical
+ line, because an empty physical line translates to an empty logical line.
+
+ @param MoreContext Pointer to the more context containing the data to
+        display.
+
+ @param PhysicalLine Pointer to the physical line to decompose into one or
+        more logical lines.
+
+ @return The number of logical lines within the physical line.
+ */
+YORI_ALLOC_SIZE_T
+MoreCountLogicalLinesOnPhysicalLine(
+    __in PMORE_CONTEXT MoreContext,
+    __in PMORE_PHYSICAL_LINE PhysicalLine
+    )
+{
+    YORI_ALLOC_SIZE_T Count;
+    YORI_STRING LineContents;
+
+    if (PhysicalLine->WrapWidth == MoreContext->ViewportWidth) {
+        return PhysicalLine->WrapLogicalLineCount;
+    }
+
+    //
+    //  If the text can't be loaded, the line is displayed as empty, which
+    //  is still one logical line.
+    //
+
+    if (!MoreAcquirePhysicalLineContents(MoreContext, PhysicalLine, &LineContents)) {
+        return 1;
+    }
+
+    Count = MoreBuildWrapBreaks(MoreContext, PhysicalLine, &LineContents);
+
+    YoriLibFreeStringContents(&LineContents);
     return Count;
 }
 
@@ -792,6 +1160,11 @@ MoreCloneLogicalLine(
  @param LogicalLine Pointer to the logical line, describing its state but
         not yet containing the string representation of the logical line.
 
+ @param PhysicalLineContents Pointer to the text of the physical line, as
+        returned from @ref MoreAcquirePhysicalLineContents .  If the logical
+        line is a substring of the physical line, it references this
+        allocation.
+
  @param RegenerationRequired TRUE if the logical line string needs to be
         allocated and generated manually.  FALSE if the logical line will
         just be a referenced substring from the physical line.
@@ -808,6 +1181,7 @@ BOOLEAN
 MoreCopyRangeIntoLogicalLine(
     __in PMORE_CONTEXT MoreContext,
     __in PMORE_LOGICAL_LINE LogicalLine,
+    __in PYORI_STRING PhysicalLineContents,
     __in BOOLEAN RegenerationRequired,
     __in YORI_ALLOC_SIZE_T SourceCharsToConsume,
     __in YORI_ALLOC_SIZE_T AllocationLengthRequired
@@ -821,7 +1195,8 @@ MoreCopyRangeIntoLogicalLine(
         YORI_ALLOC_SIZE_T CharsInOutputBuffer;
         YORI_STRING MatchEscapeChars;
         YORI_STRING EscapeSubset;
-        YORI_ALLOC_SIZE_T EndOfEscape;
+        YORI_ALLOC_SIZE_T EscapeLength;
+        BOOLEAN EscapeComplete;
         TCHAR MatchEscapeCharsBuf[YORI_MAX_VT_ESCAPE_CHARS];
         YORI_ALLOC_SIZE_T MatchOffset;
         YORI_ALLOC_SIZE_T MatchLength;
@@ -831,7 +1206,7 @@ MoreCopyRangeIntoLogicalLine(
         UCHAR MatchIndex;
 
         YoriLibInitEmptyString(&PhysicalLineSubset);
-        PhysicalLineSubset.StartOfString = &LogicalLine->PhysicalLine->LineContents.StartOfString[LogicalLine->PhysicalLineCharacterOffset]; 
+        PhysicalLineSubset.StartOfString = &PhysicalLineContents->StartOfString[LogicalLine->PhysicalLineCharacterOffset]; 
         PhysicalLineSubset.LengthInChars = SourceCharsToConsume;
 
         if (!YoriLibAllocateString(&LogicalLine->Line, AllocationLengthRequired)) {
@@ -869,10 +1244,9 @@ MoreCopyRangeIntoLogicalLine(
 
                 YoriLibInitEmptyString(&StringForNextMatch);
                 StringForNextMatch.StartOfString = &PhysicalLineSubset.StartOfString[SourceIndex];
-                StringForNextMatch.LengthInChars = LogicalLine->PhysicalLine->LineContents.LengthInChars - LogicalLine->PhysicalLineCharacterOffset - SourceIndex;
-                MatchFound = MoreFindNextSearchMatch(MoreContext, &StringForNextMatch, &MatchOffset, &MatchIndex);
+                StringForNextMatch.LengthInChars = PhysicalLineContents->LengthInChars - LogicalLine->PhysicalLineCharacterOffset - SourceIndex;
+                MatchFound = MoreFindNextSearchMatch(MoreContext, &StringForNextMatch, &MatchOffset, &MatchLength, &MatchIndex);
                 if (MatchFound) {
-                    MatchLength = MoreContext->SearchStrings[MatchIndex].LengthInChars;
                     SearchColor = MoreContext->SearchColors[MoreContext->SearchContext[MatchIndex].ColorIndex];
                     MatchOffset = MatchOffset + SourceIndex;
                 }
@@ -883,14 +1257,12 @@ MoreCopyRangeIntoLogicalLine(
             //  Look for the final letter after any numbers or semicolon.
             //
 
-            if (PhysicalLineSubset.LengthInChars > SourceIndex + 2 &&
-                PhysicalLineSubset.StartOfString[SourceIndex] == 27 &&
-                PhysicalLineSubset.StartOfString[SourceIndex + 1] == '[') {
+            YoriLibInitEmptyString(&EscapeSubset);
+            EscapeSubset.StartOfString = &PhysicalLineSubset.StartOfString[SourceIndex];
+            EscapeSubset.LengthInChars = PhysicalLineSubset.LengthInChars - SourceIndex;
+            EscapeComplete = YoriLibVtGetEscapeLength(&EscapeSubset, &EscapeLength);
 
-                YoriLibInitEmptyString(&EscapeSubset);
-                EscapeSubset.StartOfString = &PhysicalLineSubset.StartOfString[SourceIndex + 2];
-                EscapeSubset.LengthInChars = PhysicalLineSubset.LengthInChars - SourceIndex - 2;
-                EndOfEscape = YoriLibCntStringWithChars(&EscapeSubset, _T("0123456789;"));
+            if (EscapeLength > 0) {
 
                 //
                 //  Count everything as consuming the source and needing buffer
@@ -898,18 +1270,17 @@ MoreCopyRangeIntoLogicalLine(
                 //  may include the final letter, if we found one.
                 //
 
-                if (PhysicalLineSubset.LengthInChars > SourceIndex + 2 + EndOfEscape) {
-                    memcpy(&LogicalLine->Line.StartOfString[CharsInOutputBuffer], &PhysicalLineSubset.StartOfString[SourceIndex], (3 + EndOfEscape) * sizeof(TCHAR));
-                    CharsInOutputBuffer += 3 + EndOfEscape;
-                    SourceIndex += 3 + EndOfEscape;
+                if (EscapeComplete) {
+                    memcpy(&LogicalLine->Line.StartOfString[CharsInOutputBuffer], &PhysicalLineSubset.StartOfString[SourceIndex], EscapeLength * sizeof(TCHAR));
+                    CharsInOutputBuffer += EscapeLength;
+                    SourceIndex += EscapeLength;
 
-                    EscapeSubset.StartOfString -= 2;
-                    EscapeSubset.LengthInChars = EndOfEscape + 3;
+                    EscapeSubset.LengthInChars = EscapeLength;
                     YoriLibVtFinalColorFromEsc(CurrentUserColor, &EscapeSubset, &CurrentUserColor);
                 } else {
-                    memcpy(&LogicalLine->Line.StartOfString[CharsInOutputBuffer], &PhysicalLineSubset.StartOfString[SourceIndex], (2 + EndOfEscape) * sizeof(TCHAR));
-                    CharsInOutputBuffer += 2 + EndOfEscape;
-                    SourceIndex += 2 + EndOfEscape;
+                    memcpy(&LogicalLine->Line.StartOfString[CharsInOutputBuffer], &PhysicalLineSubset.StartOfString[SourceIndex], EscapeLength * sizeof(TCHAR));
+                    CharsInOutputBuffer += EscapeLength;
+                    SourceIndex += EscapeLength;
                 }
             } else {
 
@@ -942,11 +1313,11 @@ MoreCopyRangeIntoLogicalLine(
     } else {
         ASSERT(SourceCharsToConsume == AllocationLengthRequired);
         YoriLibInitEmptyString(&LogicalLine->Line);
-        LogicalLine->Line.StartOfString = &LogicalLine->PhysicalLine->LineContents.StartOfString[LogicalLine->PhysicalLineCharacterOffset];
+        LogicalLine->Line.StartOfString = &PhysicalLineContents->StartOfString[LogicalLine->PhysicalLineCharacterOffset];
         LogicalLine->Line.LengthInChars = SourceCharsToConsume;
 
-        YoriLibReference(LogicalLine->PhysicalLine->MemoryToFree);
-        LogicalLine->Line.MemoryToFree = LogicalLine->PhysicalLine->MemoryToFree;
+        YoriLibReference(PhysicalLineContents->MemoryToFree);
+        LogicalLine->Line.MemoryToFree = PhysicalLineContents->MemoryToFree;
     }
 
     return TRUE;
@@ -990,10 +1361,41 @@ MoreGenerateLogicalLinesFromPhysicalLine(
     WORD InitialUserColor = PhysicalLine->InitialColor;
     WORD InitialDisplayColor = PhysicalLine->InitialColor;
     MORE_LINE_END_CONTEXT LineEndContext;
+    YORI_STRING LineContents;
+
+    if (!MoreAcquirePhysicalLineContents(MoreContext, PhysicalLine, &LineContents)) {
+        MoreContext->OutOfMemory = TRUE;
+        return FALSE;
+    }
+
+    //
+    //  If the logical lines being requested are not the first within the
+    //  physical line, skip directly to the first one requested.  This is
+    //  only possible when no search is active, since otherwise a search
+    //  match could span from an earlier logical line and alter its display.
+    //
+
+    if (FirstLogicalLineIndex > 0 &&
+        !MoreIsAnySearchActive(MoreContext)) {
+
+        if (PhysicalLine->WrapWidth != MoreContext->ViewportWidth) {
+            MoreBuildWrapBreaks(MoreContext, PhysicalLine, &LineContents);
+        }
+
+        if (PhysicalLine->WrapWidth == MoreContext->ViewportWidth &&
+            PhysicalLine->WrapBreaks != NULL &&
+            FirstLogicalLineIndex < PhysicalLine->WrapLogicalLineCount) {
+
+            Count = FirstLogicalLineIndex;
+            CharIndex = PhysicalLine->WrapBreaks[Count].Offset;
+            InitialUserColor = PhysicalLine->WrapBreaks[Count].UserColor;
+            InitialDisplayColor = InitialUserColor;
+        }
+    }
 
     YoriLibInitEmptyString(&Subset);
-    Subset.StartOfString = PhysicalLine->LineContents.StartOfString;
-    Subset.LengthInChars = PhysicalLine->LineContents.LengthInChars;
+    Subset.StartOfString = &LineContents.StartOfString[CharIndex];
+    Subset.LengthInChars = LineContents.LengthInChars - CharIndex;
     while(TRUE) {
         if (Count >= FirstLogicalLineIndex + NumberLogicalLines) {
             break;
@@ -1016,7 +1418,8 @@ MoreGenerateLogicalLinesFromPhysicalLine(
 
             ASSERT(ThisLine->CharactersRemainingInMatch == 0 || ThisLine->InitialUserColor != ThisLine->InitialDisplayColor);
 
-            if (!MoreCopyRangeIntoLogicalLine(MoreContext, ThisLine, LineEndContext.RequiresGeneration, LogicalLineLength, LineEndContext.CharactersNeededInAllocation)) {
+            if (!MoreCopyRangeIntoLogicalLine(MoreContext, ThisLine, &LineContents, LineEndContext.RequiresGeneration, LogicalLineLength, LineEndContext.CharactersNeededInAllocation)) {
+                YoriLibFreeStringContents(&LineContents);
                 return FALSE;
             }
 
@@ -1034,6 +1437,7 @@ MoreGenerateLogicalLinesFromPhysicalLine(
         }
     }
 
+    YoriLibFreeStringContents(&LineContents);
     return TRUE;
 }
 
@@ -1290,6 +1694,163 @@ MoreGetNextLogicalLines(
     return Result;
 }
 
+/**
+ Return TRUE if a physical line matches the current search criteria.
+
+ @param MoreContext Pointer to the more context containing the search
+        criteria.
+
+ @param PhysicalLine Pointer to the physical line to check.
+
+ @param MatchAny If TRUE, match against any search string.  If FALSE, match
+        against the current search string only.
+
+ @return TRUE if the line matches, FALSE if it does not or its text could
+         not be loaded.
+ */
+BOOLEAN
+MoreDoesPhysicalLineMatchSearch(
+    __in PMORE_CONTEXT MoreContext,
+    __in PMORE_PHYSICAL_LINE PhysicalLine,
+    __in BOOLEAN MatchAny
+    )
+{
+    YORI_STRING LineContents;
+    YORI_ALLOC_SIZE_T MatchOffset;
+    YORI_ALLOC_SIZE_T MatchLength;
+    BOOLEAN MatchFound;
+
+    if (!MoreAcquirePhysicalLineContents(MoreContext, PhysicalLine, &LineContents)) {
+        return FALSE;
+    }
+
+    if (MatchAny) {
+        MatchFound = MoreFindNextSearchMatch(MoreContext, &LineContents, NULL, NULL, NULL);
+    } else {
+        MatchFound = MoreFindSearchStringMatch(MoreContext, &LineContents, MoreContext->SearchColorIndex, &MatchOffset, &MatchLength);
+    }
+
+    YoriLibFreeStringContents(&LineContents);
+    return MatchFound;
+}
+
+/**
+ Walk the filtered physical lines from a starting point looking for the
+ first line that matches the search criteria.  Where possible, lines are
+ collected in windows and searched on multiple threads, with progress in
+ the status line; PhysicalLineMutex is released while each window is being
+ searched.  This must be called with PhysicalLineMutex held.
+
+ @param MoreContext Pointer to the more context.
+
+ @param SearchLine Optionally points to the physical line to start searching
+        after (or before, if searching backwards.)  If NULL, the search
+        starts from the first (or last) filtered line.
+
+ @param Forward TRUE to search forwards, FALSE to search backwards.
+
+ @param MatchAny If TRUE, match against any search string.  If FALSE, match
+        against the current search string only.
+
+ @param MaxLogicalLinesMoved Specifies the maximum number of logical lines
+        to count.
+
+ @param LogicalLinesMoved Optionally points to a count of logical lines
+        which is incremented by the number of logical lines in each line
+        that does not match, until MaxLogicalLinesMoved is reached.
+
+ @return Pointer to the matching physical line, or NULL if no line matched
+         or the user cancelled the search.
+ */
+PMORE_PHYSICAL_LINE
+MoreSearchFilteredLines(
+    __in PMORE_CONTEXT MoreContext,
+    __in_opt PMORE_PHYSICAL_LINE SearchLine,
+    __in BOOLEAN Forward,
+    __in BOOLEAN MatchAny,
+    __in YORI_ALLOC_SIZE_T MaxLogicalLinesMoved,
+    __inout_opt PYORI_ALLOC_SIZE_T LogicalLinesMoved
+    )
+{
+    MORE_PARALLEL_SEARCH Search;
+    YORI_ALLOC_SIZE_T Index;
+
+    if (!MoreInitializeParallelSearch(MoreContext, TRUE, MatchAny, 0, &Search)) {
+        while (TRUE) {
+            if (Forward) {
+                SearchLine = MoreGetNextFilteredPhysicalLine(MoreContext, SearchLine);
+            } else {
+                SearchLine = MoreGetPreviousFilteredPhysicalLine(MoreContext, SearchLine);
+            }
+            if (SearchLine == NULL) {
+                break;
+            }
+
+            if (MoreDoesPhysicalLineMatchSearch(MoreContext, SearchLine, MatchAny)) {
+                break;
+            }
+
+            if (LogicalLinesMoved != NULL && *LogicalLinesMoved < MaxLogicalLinesMoved) {
+                *LogicalLinesMoved = *LogicalLinesMoved + MoreCountLogicalLinesOnPhysicalLine(MoreContext, SearchLine);
+            }
+        }
+
+        return SearchLine;
+    }
+
+    while (TRUE) {
+
+        //
+        //  Collect the next window of lines.  Lines are only removed from
+        //  the filtered list by this thread, so the final line of the
+        //  window remains a valid place to continue from.
+        //
+
+        Search.LineCount = 0;
+        while (Search.LineCount < MORE_SEARCH_WINDOW_LINES) {
+            if (Forward) {
+                SearchLine = MoreGetNextFilteredPhysicalLine(MoreContext, SearchLine);
+            } else {
+                SearchLine = MoreGetPreviousFilteredPhysicalLine(MoreContext, SearchLine);
+            }
+            if (SearchLine == NULL) {
+                break;
+            }
+            Search.Lines[Search.LineCount] = SearchLine;
+            Search.LineCount++;
+        }
+
+        if (Search.LineCount == 0) {
+            SearchLine = NULL;
+            break;
+        }
+
+        ReleaseMutex(MoreContext->PhysicalLineMutex);
+        if (!MoreExecuteParallelSearch(&Search)) {
+            WaitForSingleObject(MoreContext->PhysicalLineMutex, INFINITE);
+            SearchLine = NULL;
+            break;
+        }
+        WaitForSingleObject(MoreContext->PhysicalLineMutex, INFINITE);
+
+        if (LogicalLinesMoved != NULL) {
+            for (Index = 0; Index < Search.FirstMatch && *LogicalLinesMoved < MaxLogicalLinesMoved; Index++) {
+                *LogicalLinesMoved = *LogicalLinesMoved + MoreCountLogicalLinesOnPhysicalLine(MoreContext, Search.Lines[Index]);
+            }
+        }
+
+        if (Search.FirstMatch < Search.LineCount) {
+            SearchLine = Search.Lines[Search.FirstMatch];
+            break;
+        }
+
+        SearchLine = Search.Lines[Search.LineCount - 1];
+    }
+
+    MoreCleanupParallelSearch(&Search);
+    return SearchLine;
+}
+
 /**
  Find the next physical line that contains a match for the current search
  string, or for any search string.
@@ -1330,7 +1891,6 @@ MoreFindNextLineWithSearchMatch(
 {
     PMORE_PHYSICAL_LINE SearchLine;
     PYORI_STRING SearchString;
-    YORI_ALLOC_SIZE_T MatchOffset;
     YORI_ALLOC_SIZE_T Count;
     YORI_ALLOC_SIZE_T LogicalLinesThisPhysicalLine;
 
@@ -1363,26 +1923,10 @@ MoreFindNextLineWithSearchMatch(
 
     WaitForSingleObject(MoreContext->PhysicalLineMutex, INFINITE);
 
-    while (TRUE) {
-        SearchLine = MoreGetNextFilteredPhysicalLine(MoreContext, SearchLine);
-        if (SearchLine == NULL) {
-            break;
-        }
-
-        if (MatchAny) {
-            if (MoreFindNextSearchMatch(MoreContext, &SearchLine->LineContents, NULL, NULL)) {
-                break;
-            }
-        } else {
-            if (YoriLibFindFirstMatchSubstrIns(&SearchLine->LineContents, 1, SearchString, &MatchOffset)) {
-                break;
-            }
-        }
-
-        if (LogicalLinesMoved != NULL && Count < MaxLogicalLinesMoved) {
-            LogicalLinesThisPhysicalLine = MoreCountLogicalLinesOnPhysicalLine(MoreContext, SearchLine);
-            Count = Count + LogicalLinesThisPhysicalLine;
-        }
+    if (LogicalLinesMoved != NULL) {
+        SearchLine = MoreSearchFilteredLines(MoreContext, SearchLine, TRUE, MatchAny, MaxLogicalLinesMoved, &Count);
+    } else {
+        SearchLine = MoreSearchFilteredLines(MoreContext, SearchLine, TRUE, MatchAny, MaxLogicalLinesMoved, NULL);
     }
 
     if (LogicalLinesMoved != NULL) {
@@ -1437,9 +1981,7 @@ MoreFindPreviousLineWithSearchMatch(
 {
     PMORE_PHYSICAL_LINE SearchLine;
     PYORI_STRING SearchString;
-    YORI_ALLOC_SIZE_T MatchOffset;
     YORI_ALLOC_SIZE_T Count;
-    YORI_ALLOC_SIZE_T LogicalLinesThisPhysicalLine;
 
     Count = 0;
 
@@ -1458,26 +2000,10 @@ MoreFindPreviousLineWithSearchMatch(
 
     WaitForSingleObject(MoreContext->PhysicalLineMutex, INFINITE);
 
-    while (TRUE) {
-        SearchLine = MoreGetPreviousFilteredPhysicalLine(MoreContext, SearchLine);
-        if (SearchLine == NULL) {
-            break;
-        }
-
-        if (MatchAny) {
-            if (MoreFindNextSearchMatch(MoreContext, &SearchLine->LineContents, NULL, NULL)) {
-                break;
-            }
-        } else {
-            if (YoriLibFindFirstMatchSubstrIns(&SearchLine->LineContents, 1, SearchString, &MatchOffset)) {
-                break;
-            }
-        }
-
-        if (LogicalLinesMoved != NULL && Count < MaxLogicalLinesMoved) {
-            LogicalLinesThisPhysicalLine = MoreCountLogicalLinesOnPhysicalLine(MoreContext, SearchLine);
-            Count = Count + LogicalLinesThisPhysicalLine;
-        }
+    if (LogicalLinesMoved != NULL) {
+        SearchLine = MoreSearchFilteredLines(MoreContext, SearchLine, FALSE, MatchAny, MaxLogicalLinesMoved, &Count);
+    } else {
+        SearchLine = MoreSearchFilteredLines(MoreContext, SearchLine, FALSE, MatchAny, MaxLogicalLinesMoved, NULL);
     }
 
     if (LogicalLinesMoved != NULL) {
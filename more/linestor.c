@@ -0,0 +1,649 @@
+/**
+ * @file more/linestor.c
+ *
+ * Yori shell more storage of physical line text with bounded memory
+ *
+ * Copyright (c) 2017-2021 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "more.h"
+
+/**
+ Create the spill file used to hold line blocks which are not in memory.  The
+ file is opened for delete on close so it is removed when the process exits,
+ however that occurs.
+
+ @param MoreContext Pointer to the more context.  On successful completion,
+        SpillFile is populated with a handle to the file.
+
+ @return TRUE to indicate the file was created, FALSE if it was not.
+ */
+__success(return)
+BOOLEAN
+MoreCreateSpillFile(
+    __inout PMORE_CONTEXT MoreContext
+    )
+{
+    YORI_STRING TempPath;
+    YORI_STRING PrefixString;
+    YORI_STRING TempName;
+    HANDLE TempHandle;
+
+    if (!YoriLibGetTempPath(&TempPath, 0)) {
+        return FALSE;
+    }
+
+    YoriLibConstantString(&PrefixString, _T("MORE"));
+    if (!YoriLibGetTempFileName(&TempPath, &PrefixString, &TempHandle, &TempName)) {
+        YoriLibFreeStringContents(&TempPath);
+        return FALSE;
+    }
+
+    YoriLibFreeStringContents(&TempPath);
+
+    //
+    //  The name has been reserved by creating the file.  Reopen it so that
+    //  it will be deleted when the handle is closed.
+    //
+
+    CloseHandle(TempHandle);
+    TempHandle = CreateFile(TempName.StartOfString,
+                            GENERIC_READ | GENERIC_WRITE,
+                            FILE_SHARE_READ | FILE_SHARE_DELETE,
+                            NULL,
+                            OPEN_EXISTING,
+                            FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE,
+                            NULL);
+
+    if (TempHandle == INVALID_HANDLE_VALUE) {
+        DeleteFile(TempName.StartOfString);
+        YoriLibFreeStringContents(&TempName);
+        return FALSE;
+    }
+
+    YoriLibFreeStringContents(&TempName);
+    MoreContext->SpillFile = TempHandle;
+    MoreContext->SpillFileSize = 0;
+    return TRUE;
+}
+
+/**
+ Select a compression format for line blocks and allocate the memory needed
+ to compress with it.  Xpress is preferred since it is faster, but requires
+ Windows 8; LZNT1 is used on older systems.  If neither is available, line
+ blocks are not compressed.
+
+ @param MoreContext Pointer to the more context.  On successful completion,
+        CompressWorkspace and CompressionFormat are populated.
+
+ @return TRUE to indicate compression is available, FALSE if it is not.
+ */
+__success(return)
+BOOLEAN
+MoreInitializeLineCompression(
+    __inout PMORE_CONTEXT MoreContext
+    )
+{
+    WORD Formats[2];
+    DWORD Index;
+    DWORD WorkspaceSize;
+    DWORD FragmentWorkspaceSize;
+
+    YoriLibLoadNtDllFunctions();
+    if (DllNtDll.pRtlCompressBuffer == NULL ||
+        DllNtDll.pRtlDecompressBuffer == NULL ||
+        DllNtDll.pRtlGetCompressionWorkSpaceSize == NULL) {
+
+        return FALSE;
+    }
+
+    Formats[0] = COMPRESSION_FORMAT_XPRESS;
+    Formats[1] = COMPRESSION_FORMAT_LZNT1;
+
+    for (Index = 0; Index < sizeof(Formats)/sizeof(Formats[0]); Index++) {
+        if (DllNtDll.pRtlGetCompressionWorkSpaceSize(Formats[Index] | COMPRESSION_ENGINE_STANDARD, &WorkspaceSize, &FragmentWorkspaceSize) != 0) {
+            continue;
+        }
+
+        if (!YoriLibIsSizeAllocatable(WorkspaceSize)) {
+            continue;
+        }
+
+        MoreContext->CompressWorkspace = YoriLibMalloc((YORI_ALLOC_SIZE_T)WorkspaceSize);
+        if (MoreContext->CompressWorkspace == NULL) {
+            return FALSE;
+        }
+
+        MoreContext->CompressionFormat = Formats[Index];
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+/**
+ Prepare the line store for use.  Failure to create the spill file is not
+ fatal; it implies line text will remain in memory.
+
+ @param MoreContext Pointer to the more context.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOLEAN
+MoreInitializeLineStore(
+    __inout PMORE_CONTEXT MoreContext
+    )
+{
+    YoriLibInitializeListHead(&MoreContext->LineBlockList);
+    YoriLibInitializeListHead(&MoreContext->ResidentBlockList);
+    MoreContext->ResidentBlockCount = 0;
+    MoreContext->IngestBlock = NULL;
+    MoreContext->SpillFile = NULL;
+    MoreContext->SpillFileSize = 0;
+    MoreContext->CompressWorkspace = NULL;
+    MoreContext->CompressedBytesInMemory = 0;
+    MoreContext->CompressionFormat = COMPRESSION_FORMAT_NONE;
+
+    MoreContext->LineStoreMutex = CreateMutex(NULL, FALSE, NULL);
+    if (MoreContext->LineStoreMutex == NULL) {
+        return FALSE;
+    }
+
+    MoreInitializeLineCompression(MoreContext);
+    MoreCreateSpillFile(MoreContext);
+    return TRUE;
+}
+
+/**
+ Free all line blocks and close the spill file.  This is called after the
+ ingest thread has terminated and all physical lines have been removed.
+
+ @param MoreContext Pointer to the more context.
+ */
+VOID
+MoreCleanupLineStore(
+    __inout PMORE_CONTEXT MoreContext
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PMORE_LINE_BLOCK Block;
+
+    if (MoreContext->LineStoreMutex != NULL) {
+        ListEntry = YoriLibGetNextListEntry(&MoreContext->LineBlockList, NULL);
+        while (ListEntry != NULL) {
+            Block = CONTAINING_RECORD(ListEntry, MORE_LINE_BLOCK, BlockList);
+            YoriLibRemoveListItem(ListEntry);
+            if (Block->Buffer != NULL) {
+                YoriLibDereference(Block->Buffer);
+            }
+            if (Block->CompressedBuffer != NULL) {
+                YoriLibFree(Block->CompressedBuffer);
+            }
+            YoriLibFree(Block);
+            ListEntry = YoriLibGetNextListEntry(&MoreContext->LineBlockList, NULL);
+        }
+
+        YoriLibInitializeListHead(&MoreContext->ResidentBlockList);
+        MoreContext->ResidentBlockCount = 0;
+        MoreContext->IngestBlock = NULL;
+        MoreContext->CompressedBytesInMemory = 0;
+
+        CloseHandle(MoreContext->LineStoreMutex);
+        MoreContext->LineStoreMutex = NULL;
+    }
+
+    if (MoreContext->SpillFile != NULL) {
+        CloseHandle(MoreContext->SpillFile);
+        MoreContext->SpillFile = NULL;
+    }
+
+    if (MoreContext->CompressWorkspace != NULL) {
+        YoriLibFree(MoreContext->CompressWorkspace);
+        MoreContext->CompressWorkspace = NULL;
+    }
+}
+
+/**
+ Discard the least recently used blocks from memory until no more than
+ MORE_MAX_RESIDENT_BLOCKS remain.  This must be called with LineStoreMutex
+ held.
+
+ @param MoreContext Pointer to the more context.
+ */
+VOID
+MoreTrimResidentBlocks(
+    __in PMORE_CONTEXT MoreContext
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PMORE_LINE_BLOCK Block;
+
+    while (MoreContext->ResidentBlockCount > MORE_MAX_RESIDENT_BLOCKS) {
+        ListEntry = YoriLibGetNextListEntry(&MoreContext->ResidentBlockList, NULL);
+        ASSERT(ListEntry != NULL);
+        if (ListEntry == NULL) {
+            break;
+        }
+
+        Block = CONTAINING_RECORD(ListEntry, MORE_LINE_BLOCK, ResidentList);
+        ASSERT(Block->Sealed && Block->Buffer != NULL);
+        YoriLibRemoveListItem(ListEntry);
+        MoreContext->ResidentBlockCount--;
+
+        //
+        //  Any logical line still displaying text from this block holds its
+        //  own reference, so the memory remains valid until that is released.
+        //
+
+        YoriLibDereference(Block->Buffer);
+        Block->Buffer = NULL;
+    }
+}
+
+/**
+ Compress the text of a full line block.  This is called from the ingest
+ thread before the block is sealed, so the block's buffer is not accessed
+ by any other thread.
+
+ @param MoreContext Pointer to the more context.
+
+ @param Block Pointer to the block to compress.
+
+ @param CompressedBuffer On successful completion, updated to point to an
+        allocation containing the compressed text.  The caller should free
+        this with YoriLibFree.
+
+ @param CompressedSize On successful completion, updated to contain the
+        number of bytes in CompressedBuffer.
+
+ @return TRUE to indicate the block was compressed, FALSE if compression is
+         not available, failed, or would not save memory.
+ */
+__success(return)
+BOOLEAN
+MoreCompressLineBlock(
+    __in PMORE_CONTEXT MoreContext,
+    __in PMORE_LINE_BLOCK Block,
+    __out PUCHAR *CompressedBuffer,
+    __out PDWORD CompressedSize
+    )
+{
+    PUCHAR ScratchBuffer;
+    PUCHAR Buffer;
+    DWORD UncompressedSize;
+    DWORD FinalSize;
+    LONG Status;
+
+    if (MoreContext->CompressWorkspace == NULL) {
+        return FALSE;
+    }
+
+    UncompressedSize = Block->CharsPopulated * sizeof(TCHAR);
+    ScratchBuffer = YoriLibMalloc((YORI_ALLOC_SIZE_T)UncompressedSize);
+    if (ScratchBuffer == NULL) {
+        return FALSE;
+    }
+
+    Status = DllNtDll.pRtlCompressBuffer(MoreContext->CompressionFormat | COMPRESSION_ENGINE_STANDARD,
+                                         (PUCHAR)Block->Buffer,
+                                         UncompressedSize,
+                                         ScratchBuffer,
+                                         UncompressedSize,
+                                         4096,
+                                         &FinalSize,
+                                         MoreContext->CompressWorkspace);
+
+    if (Status != 0 || FinalSize == 0 || FinalSize >= UncompressedSize) {
+        YoriLibFree(ScratchBuffer);
+        return FALSE;
+    }
+
+    //
+    //  Copy the result into an allocation of the compressed size, so that
+    //  the memory for the uncompressed size is not retained.
+    //
+
+    Buffer = YoriLibMalloc((YORI_ALLOC_SIZE_T)FinalSize);
+    if (Buffer == NULL) {
+        YoriLibFree(ScratchBuffer);
+        return FALSE;
+    }
+
+    memcpy(Buffer, ScratchBuffer, FinalSize);
+    YoriLibFree(ScratchBuffer);
+
+    *CompressedBuffer = Buffer;
+    *CompressedSize = FinalSize;
+    return TRUE;
+}
+
+/**
+ Preserve the text of a full line block so that its buffer can be discarded
+ from memory.  The text is compressed if possible.  Compressed text is
+ retained in memory until MORE_MAX_COMPRESSED_BYTES are held, after which
+ it is written to the spill file.  If the text cannot be compressed or
+ written, the block remains in memory indefinitely.
+
+ @param MoreContext Pointer to the more context.
+
+ @param Block Pointer to the block to seal.  This must not be modified after
+        this call.
+ */
+VOID
+MoreSealLineBlock(
+    __in PMORE_CONTEXT MoreContext,
+    __in PMORE_LINE_BLOCK Block
+    )
+{
+    LARGE_INTEGER WriteOffset;
+    PUCHAR CompressedBuffer;
+    PUCHAR WriteBuffer;
+    DWORD CompressedSize;
+    DWORD BytesToWrite;
+    DWORD BytesWritten;
+    BOOLEAN Written;
+
+    CompressedBuffer = NULL;
+    CompressedSize = 0;
+    if (!MoreCompressLineBlock(MoreContext, Block, &CompressedBuffer, &CompressedSize)) {
+        if (MoreContext->SpillFile == NULL) {
+            return;
+        }
+    }
+
+    WaitForSingleObject(MoreContext->LineStoreMutex, INFINITE);
+
+    Written = FALSE;
+    if (MoreContext->SpillFile != NULL &&
+        (CompressedBuffer == NULL ||
+         MoreContext->CompressedBytesInMemory + CompressedSize > MORE_MAX_COMPRESSED_BYTES)) {
+
+        if (CompressedBuffer != NULL) {
+            WriteBuffer = CompressedBuffer;
+            BytesToWrite = CompressedSize;
+        } else {
+            WriteBuffer = (PUCHAR)Block->Buffer;
+            BytesToWrite = Block->CharsPopulated * sizeof(TCHAR);
+        }
+        WriteOffset.QuadPart = MoreContext->SpillFileSize;
+
+        if ((SetFilePointer(MoreContext->SpillFile, WriteOffset.LowPart, &WriteOffset.HighPart, FILE_BEGIN) != INVALID_SET_FILE_POINTER ||
+             GetLastError() == NO_ERROR) &&
+            WriteFile(MoreContext->SpillFile, WriteBuffer, BytesToWrite, &BytesWritten, NULL) &&
+            BytesWritten == BytesToWrite) {
+
+            Block->FileOffset = MoreContext->SpillFileSize;
+            MoreContext->SpillFileSize = MoreContext->SpillFileSize + BytesToWrite;
+            Written = TRUE;
+        }
+    }
+
+    //
+    //  If the text was written to the spill file, the compressed copy is
+    //  not needed.  If it wasn't, the compressed copy is the only way to
+    //  recover the text, so keep it regardless of how much memory is used
+    //  by compressed blocks.  If there's no compressed copy either, the
+    //  block must stay in memory.
+    //
+
+    if (Written) {
+        if (CompressedBuffer != NULL) {
+            YoriLibFree(CompressedBuffer);
+        }
+    } else if (CompressedBuffer != NULL) {
+        Block->CompressedBuffer = CompressedBuffer;
+        MoreContext->CompressedBytesInMemory = MoreContext->CompressedBytesInMemory + CompressedSize;
+    } else {
+        ReleaseMutex(MoreContext->LineStoreMutex);
+        return;
+    }
+
+    Block->CompressedSize = CompressedSize;
+    Block->Sealed = TRUE;
+
+    YoriLibAppendList(&MoreContext->ResidentBlockList, &Block->ResidentList);
+    MoreContext->ResidentBlockCount++;
+    MoreTrimResidentBlocks(MoreContext);
+
+    ReleaseMutex(MoreContext->LineStoreMutex);
+}
+
+/**
+ Allocate space for the text of a new physical line.  This is called from the
+ ingest thread only, and the returned buffer must be fully populated before
+ the physical line is made visible to other threads.
+
+ @param MoreContext Pointer to the more context.
+
+ @param PhysicalLine Pointer to the physical line whose text is being
+        allocated.  On successful completion, its Block and ContentsOffset
+        are updated to describe the location of the text.  The caller is
+        expected to set ContentsLength once the text is known.
+
+ @param CharsRequired The number of characters to allocate, not including
+        a NULL terminator, which is also allocated.
+
+ @return Pointer to the buffer to populate with line text, or NULL on
+         allocation failure.
+ */
+LPTSTR
+MoreAllocateLineText(
+    __in PMORE_CONTEXT MoreContext,
+    __inout PMORE_PHYSICAL_LINE PhysicalLine,
+    __in YORI_ALLOC_SIZE_T CharsRequired
+    )
+{
+    PMORE_LINE_BLOCK Block;
+    YORI_ALLOC_SIZE_T CharsToAllocate;
+
+    Block = MoreContext->IngestBlock;
+    if (Block == NULL ||
+        Block->CharsAllocated - Block->CharsPopulated < CharsRequired + 1) {
+
+        CharsToAllocate = MORE_LINE_BLOCK_CHARS;
+        if (CharsToAllocate < CharsRequired + 1) {
+            CharsToAllocate = CharsRequired + 1;
+        }
+
+        Block = YoriLibMalloc(sizeof(MORE_LINE_BLOCK));
+        if (Block == NULL) {
+            return NULL;
+        }
+
+        ZeroMemory(Block, sizeof(MORE_LINE_BLOCK));
+        Block->Buffer = YoriLibReferencedMalloc(CharsToAllocate * sizeof(TCHAR));
+        if (Block->Buffer == NULL) {
+            YoriLibFree(Block);
+            return NULL;
+        }
+        Block->CharsAllocated = CharsToAllocate;
+
+        if (MoreContext->IngestBlock != NULL) {
+            MoreSealLineBlock(MoreContext, MoreContext->IngestBlock);
+        }
+
+        WaitForSingleObject(MoreContext->LineStoreMutex, INFINITE);
+        YoriLibAppendList(&MoreContext->LineBlockList, &Block->BlockList);
+        ReleaseMutex(MoreContext->LineStoreMutex);
+
+        MoreContext->IngestBlock = Block;
+    }
+
+    PhysicalLine->Block = Block;
+    PhysicalLine->ContentsOffset = Block->CharsPopulated;
+    PhysicalLine->ContentsLength = 0;
+    Block->CharsPopulated = Block->CharsPopulated + CharsRequired + 1;
+
+    return &Block->Buffer[PhysicalLine->ContentsOffset];
+}
+
+/**
+ Reload a discarded line block from its compressed text in memory or from
+ the spill file.  This must be called with LineStoreMutex held.
+
+ @param MoreContext Pointer to the more context.
+
+ @param Block Pointer to the block to reload.
+
+ @return TRUE to indicate the block is now in memory, FALSE if it could not
+         be reloaded.
+ */
+__success(return)
+BOOLEAN
+MoreLoadLineBlock(
+    __in PMORE_CONTEXT MoreContext,
+    __in PMORE_LINE_BLOCK Block
+    )
+{
+    LARGE_INTEGER ReadOffset;
+    LPTSTR Buffer;
+    PUCHAR ReadBuffer;
+    DWORD UncompressedSize;
+    DWORD BytesToRead;
+    DWORD BytesRead;
+    DWORD FinalSize;
+    LONG Status;
+
+    ASSERT(Block->Sealed && Block->Buffer == NULL);
+
+    UncompressedSize = Block->CharsPopulated * sizeof(TCHAR);
+    Buffer = YoriLibReferencedMalloc((YORI_ALLOC_SIZE_T)UncompressedSize);
+    if (Buffer == NULL) {
+        return FALSE;
+    }
+
+    //
+    //  If the block is compressed and held in memory, it can be
+    //  decompressed directly.  Otherwise read it from the spill file,
+    //  either into the final buffer if it is not compressed, or into a
+    //  temporary buffer to decompress from.
+    //
+
+    ReadBuffer = Block->CompressedBuffer;
+    if (ReadBuffer == NULL) {
+        if (Block->CompressedSize != 0) {
+            BytesToRead = Block->CompressedSize;
+            ReadBuffer = YoriLibMalloc((YORI_ALLOC_SIZE_T)BytesToRead);
+            if (ReadBuffer == NULL) {
+                YoriLibDereference(Buffer);
+                return FALSE;
+            }
+        } else {
+            BytesToRead = UncompressedSize;
+            ReadBuffer = (PUCHAR)Buffer;
+        }
+
+        ReadOffset.QuadPart = Block->FileOffset;
+
+        if ((SetFilePointer(MoreContext->SpillFile, ReadOffset.LowPart, &ReadOffset.HighPart, FILE_BEGIN) == INVALID_SET_FILE_POINTER &&
+             GetLastError() != NO_ERROR) ||
+            !ReadFile(MoreContext->SpillFile, ReadBuffer, BytesToRead, &BytesRead, NULL) ||
+            BytesRead != BytesToRead) {
+
+            if (ReadBuffer != (PUCHAR)Buffer) {
+                YoriLibFree(ReadBuffer);
+            }
+            YoriLibDereference(Buffer);
+            return FALSE;
+        }
+    }
+
+    if (Block->CompressedSize != 0) {
+        Status = DllNtDll.pRtlDecompressBuffer(MoreContext->CompressionFormat,
+                                               (PUCHAR)Buffer,
+                                               UncompressedSize,
+                                               ReadBuffer,
+                                               Block->CompressedSize,
+                                               &FinalSize);
+
+        if (ReadBuffer != Block->CompressedBuffer) {
+            YoriLibFree(ReadBuffer);
+        }
+
+        if (Status != 0 || FinalSize != UncompressedSize) {
+            YoriLibDereference(Buffer);
+            return FALSE;
+        }
+    }
+
+    Block->Buffer = Buffer;
+    YoriLibAppendList(&MoreContext->ResidentBlockList, &Block->ResidentList);
+    MoreContext->ResidentBlockCount++;
+    MoreTrimResidentBlocks(MoreContext);
+
+    return TRUE;
+}
+
+/**
+ Return the text of a physical line, reloading it from the spill file if it
+ is not currently in memory.
+
+ @param MoreContext Pointer to the more context.
+
+ @param PhysicalLine Pointer to the physical line whose text is requested.
+
+ @param Contents On successful completion, populated with a referenced
+        string containing the line text.  The caller should free this with
+        YoriLibFreeStringContents.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+MoreAcquirePhysicalLineContents(
+    __in PMORE_CONTEXT MoreContext,
+    __in PMORE_PHYSICAL_LINE PhysicalLine,
+    __out PYORI_STRING Contents
+    )
+{
+    PMORE_LINE_BLOCK Block;
+
+    Block = PhysicalLine->Block;
+    YoriLibInitEmptyString(Contents);
+
+    WaitForSingleObject(MoreContext->LineStoreMutex, INFINITE);
+    if (Block->Buffer == NULL) {
+        if (!MoreLoadLineBlock(MoreContext, Block)) {
+            ReleaseMutex(MoreContext->LineStoreMutex);
+            return FALSE;
+        }
+    } else if (Block->Sealed) {
+
+        //
+        //  Move the block to the end of the list so it is the last to be
+        //  discarded.
+        //
+
+        YoriLibRemoveListItem(&Block->ResidentList);
+        YoriLibAppendList(&MoreContext->ResidentBlockList, &Block->ResidentList);
+    }
+
+    YoriLibReference(Block->Buffer);
+    Contents->MemoryToFree = Block->Buffer;
+    Contents->StartOfString = &Block->Buffer[PhysicalLine->ContentsOffset];
+    Contents->LengthInChars = PhysicalLine->ContentsLength;
+    Contents->LengthAllocated = PhysicalLine->ContentsLength + 1;
+    ReleaseMutex(MoreContext->LineStoreMutex);
+
+    return TRUE;
+}
+
+// vim:sw=4:ts=4:et:
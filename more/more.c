@@ -34,12 +34,13 @@ CHAR strMoreHelpText[] =
         "\n"
         "Output the contents of one or more files with paging and scrolling.\n"
         "\n"
-        "MORE [-license] [-b] [-dd] [-f] [-s] [<file>...]\n"
+        "MORE [-license] [-b] [-dd] [-f] [-l] [-r] [-s] [<file>...]\n"
         "\n"
         "   -b             Use basic search criteria for files only\n"
         "   -dd            Use the debug display\n"
         "   -f             Wait for more contents to be added to the file\n"
         "   -l             Display until Ctrl+Q, Scroll Lock, or pause\n"
+        "   -r             Treat search strings as regular expressions\n"
         "   -s             Process files from all subdirectories\n";
 
 /**
@@ -94,6 +95,7 @@ ENTRYPOINT(
     BOOLEAN DebugDisplay = FALSE;
     BOOLEAN SuspendPagination = FALSE;
     BOOLEAN WaitForMore = FALSE;
+    BOOLEAN RegexSearch = FALSE;
     MORE_CONTEXT MoreContext;
     YORI_STRING Arg;
 
@@ -123,6 +125,9 @@ ENTRYPOINT(
             } else if (YoriLibCompareStringLitIns(&Arg, _T("l")) == 0) {
                 SuspendPagination = TRUE;
                 ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("r")) == 0) {
+                RegexSearch = TRUE;
+                ArgumentUnderstood = TRUE;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("s")) == 0) {
                 Recursive = TRUE;
                 ArgumentUnderstood = TRUE;
@@ -172,6 +177,14 @@ ENTRYPOINT(
     if (!InitComplete) {
         MoreCleanupContext(&MoreContext);
         Result = EXIT_FAILURE;
+    } else {
+
+        //
+        //  No search strings exist yet, so this can be set without
+        //  synchronizing with the ingest thread.
+        //
+
+        MoreContext.RegexSearch = RegexSearch;
     }
 
     if (Result == EXIT_SUCCESS) {
@@ -35,6 +35,130 @@
  */
 #define MORE_MAX_SEARCHES 10
 
+/**
+ The number of characters of physical line text to pack into each line
+ block.  Lines longer than this are given a block of their own.
+ */
+#define MORE_LINE_BLOCK_CHARS (32 * 1024)
+
+/**
+ The maximum number of line blocks which have been written to the spill file
+ to retain in memory.  Beyond this, the least recently used block is
+ discarded and will be reread from the spill file if it is needed again.
+ */
+#define MORE_MAX_RESIDENT_BLOCKS 256
+
+/**
+ The maximum number of bytes of compressed line blocks to retain in memory.
+ Beyond this, full blocks are compressed and written to the spill file.
+ */
+#define MORE_MAX_COMPRESSED_BYTES (256 * 1024 * 1024)
+
+/**
+ A block of physical line text.  Text is packed into blocks as it is
+ ingested.  Once a block is full it is compressed and retained in memory or
+ written to the spill file, after which its buffer can be discarded and
+ reloaded on demand.
+ */
+typedef struct _MORE_LINE_BLOCK {
+
+    /**
+     A list of all line blocks.  Paired with MORE_CONTEXT::LineBlockList and
+     synchronized with MORE_CONTEXT::LineStoreMutex .
+     */
+    YORI_LIST_ENTRY BlockList;
+
+    /**
+     A list of blocks which are in memory and could be discarded, in least
+     recently used order.  Paired with MORE_CONTEXT::ResidentBlockList and
+     synchronized with MORE_CONTEXT::LineStoreMutex .
+     */
+    YORI_LIST_ENTRY ResidentList;
+
+    /**
+     A referenced allocation containing the text of the block, or NULL if
+     the block has been discarded from memory.
+     */
+    LPTSTR Buffer;
+
+    /**
+     An allocation containing the compressed text of the block, or NULL if
+     the compressed text is not held in memory.
+     */
+    PUCHAR CompressedBuffer;
+
+    /**
+     The offset within the spill file of this block's text, in bytes.
+     */
+    DWORDLONG FileOffset;
+
+    /**
+     The number of bytes of compressed text, whether held in
+     CompressedBuffer or in the spill file.  Zero if the block's text is
+     not compressed.
+     */
+    DWORD CompressedSize;
+
+    /**
+     The number of characters within Buffer that contain line text.
+     */
+    YORI_ALLOC_SIZE_T CharsPopulated;
+
+    /**
+     The number of characters allocated in Buffer.
+     */
+    YORI_ALLOC_SIZE_T CharsAllocated;
+
+    /**
+     TRUE if the block has been compressed or written to the spill file and
+     its buffer can be discarded.  FALSE if the buffer must remain in memory,
+     because the block is still being populated or could not be preserved.
+     */
+    BOOLEAN Sealed;
+} MORE_LINE_BLOCK, *PMORE_LINE_BLOCK;
+
+/**
+ The number of physical lines to search at a time when searching in parallel.
+ Each window is searched by all threads before the next is collected.
+ */
+#define MORE_SEARCH_WINDOW_LINES (64 * 1024)
+
+/**
+ The number of physical lines each search thread claims at a time.
+ */
+#define MORE_SEARCH_CHUNK_LINES 1024
+
+/**
+ The maximum number of threads to use when searching in parallel.
+ */
+#define MORE_SEARCH_MAX_THREADS 16
+
+/**
+ The interval, in milliseconds, at which to refresh search progress and
+ check for the user cancelling a search.
+ */
+#define MORE_SEARCH_PROGRESS_INTERVAL 100
+
+/**
+ The location where a logical line begins within a physical line, recorded
+ so that repeated display of a wrapped physical line does not need to
+ reparse the text preceeding it.
+ */
+typedef struct _MORE_WRAP_BREAK {
+
+    /**
+     The offset in characters from the beginning of the physical line to the
+     beginning of the logical line.
+     */
+    YORI_ALLOC_SIZE_T Offset;
+
+    /**
+     The color attribute in effect at the beginning of the logical line as
+     indicated by the input stream.
+     */
+    WORD UserColor;
+} MORE_WRAP_BREAK, *PMORE_WRAP_BREAK;
+
 /**
  Data describing a physical line.  A physical line is a line of text from the
  data source, which may take more characters than fit on a viewport line.
@@ -78,9 +202,41 @@ typedef struct _MORE_PHYSICAL_LINE {
     DWORDLONG FilteredLineNumber;
 
     /**
-     The contents of the physical line.
+     The line block containing the text of the physical line.  The text
+     should be accessed via @ref MoreAcquirePhysicalLineContents since the
+     block may not currently be in memory.
+     */
+    PMORE_LINE_BLOCK Block;
+
+    /**
+     The offset in characters of this line's text within Block.
+     */
+    YORI_ALLOC_SIZE_T ContentsOffset;
+
+    /**
+     The length of this line's text, in characters.
+     */
+    YORI_ALLOC_SIZE_T ContentsLength;
+
+    /**
+     The viewport width that WrapLogicalLineCount and WrapBreaks describe,
+     or zero if they have not been calculated.  These are only accessed from
+     the viewport thread.
+     */
+    YORI_ALLOC_SIZE_T WrapWidth;
+
+    /**
+     The number of logical lines this physical line forms when displayed at
+     WrapWidth.
+     */
+    YORI_ALLOC_SIZE_T WrapLogicalLineCount;
+
+    /**
+     Optionally points to an array of WrapLogicalLineCount entries describing
+     where each logical line begins.  This is NULL if the physical line forms
+     a single logical line.
      */
-    YORI_STRING LineContents;
+    PMORE_WRAP_BREAK WrapBreaks;
 } MORE_PHYSICAL_LINE, *PMORE_PHYSICAL_LINE;
 
 /**
@@ -216,6 +372,16 @@ typedef struct _MORE_SEARCH_CONTEXT {
 
 } MORE_SEARCH_CONTEXT, *PMORE_SEARCH_CONTEXT;
 
+/**
+ The outcome of evaluating search criteria against a single line as part of
+ a parallel search.
+ */
+typedef enum _MORE_SEARCH_RESULT {
+    MoreSearchResultUnknown = 0,
+    MoreSearchResultNoMatch = 1,
+    MoreSearchResultMatch = 2
+} MORE_SEARCH_RESULT;
+
 /**
  Context passed to the callback which is invoked for each file found.
  */
@@ -249,6 +415,66 @@ typedef struct _MORE_CONTEXT {
      */
     HANDLE ShutdownEvent;
 
+    /**
+     A linked list of all line blocks containing physical line text.
+     */
+    YORI_LIST_ENTRY LineBlockList;
+
+    /**
+     A linked list of line blocks which are in memory and can be discarded,
+     with the least recently used first.
+     */
+    YORI_LIST_ENTRY ResidentBlockList;
+
+    /**
+     Synchronization around LineBlockList, ResidentBlockList, and the
+     contents of the spill file.  If PhysicalLineMutex is also needed, it
+     must be acquired first.
+     */
+    HANDLE LineStoreMutex;
+
+    /**
+     Handle to a temporary file which contains the text of line blocks that
+     are full.  This can be NULL if no file could be created, in which case
+     all line text is kept in memory, compressed where possible.
+     */
+    HANDLE SpillFile;
+
+    /**
+     The number of bytes written to SpillFile.
+     */
+    DWORDLONG SpillFileSize;
+
+    /**
+     Scratch memory used to compress line blocks.  This can be NULL if
+     compression is not available, in which case line blocks are written
+     to the spill file uncompressed.  This is only used by the ingest
+     thread.
+     */
+    PVOID CompressWorkspace;
+
+    /**
+     The number of bytes of compressed line blocks currently held in memory.
+     Synchronized with LineStoreMutex .
+     */
+    DWORDLONG CompressedBytesInMemory;
+
+    /**
+     The compression format used to compress line blocks.
+     */
+    WORD CompressionFormat;
+
+    /**
+     The line block that the ingest thread is currently populating.  This is
+     only accessed by the ingest thread.
+     */
+    PMORE_LINE_BLOCK IngestBlock;
+
+    /**
+     The number of elements in ResidentBlockList.
+     */
+    YORI_ALLOC_SIZE_T ResidentBlockCount;
+
 
     /**
      The current width of the window, in characters.
@@ -337,6 +563,39 @@ typedef struct _MORE_CONTEXT {
      */
     MORE_SEARCH_CONTEXT SearchContext[MORE_MAX_SEARCHES];
 
+    /**
+     A matcher prepared to search for all of the active search strings at
+     once.  This is rebuilt whenever the search strings change, while
+     holding PhysicalLineMutex, since the ingest thread searches new lines
+     when filtering.
+     */
+    YORI_LIB_SUBSTRING_MATCHER SearchMatcher;
+
+    /**
+     TRUE if SearchMatcher has been initialized for the current search
+     strings.  FALSE if the search strings should be searched for directly.
+     */
+    BOOLEAN SearchMatcherValid;
+
+    /**
+     TRUE if search strings should be interpreted as regular expressions.
+     FALSE if they are searched for as literal strings.
+     */
+    BOOLEAN RegexSearch;
+
+    /**
+     A compiled regular expression for each search string, when RegexSearch
+     is TRUE.  These are rebuilt along with SearchMatcher.
+     */
+    YORI_LIB_REGEX SearchRegex[MORE_MAX_SEARCHES];
+
+    /**
+     TRUE if the corresponding entry in SearchRegex has been compiled.  A
+     search string which is not a valid regular expression, typically
+     because the user is still typing it, matches nothing.
+     */
+    BOOLEAN SearchRegexValid[MORE_MAX_SEARCHES];
+
     /**
      An array of colors to use to display search matches.
      */
@@ -440,8 +699,120 @@ typedef struct _MORE_CONTEXT {
      */
     DWORDLONG FilteredLineCount;
 
+    /**
+     Handle to console input while the viewport is active.  This is used to
+     allow a long running search to be cancelled.  NULL if the viewport is
+     not active.
+     */
+    HANDLE ConsoleInput;
+
 } MORE_CONTEXT, *PMORE_CONTEXT;
 
+/**
+ State for evaluating search criteria against windows of physical lines on
+ multiple threads.
+ */
+typedef struct _MORE_PARALLEL_SEARCH {
+
+    /**
+     Pointer to the more context containing the search criteria.
+     */
+    PMORE_CONTEXT MoreContext;
+
+    /**
+     An array of MORE_SEARCH_WINDOW_LINES physical lines to search.  The
+     caller populates this before each window is searched.
+     */
+    PMORE_PHYSICAL_LINE *Lines;
+
+    /**
+     An array of MORE_SEARCH_WINDOW_LINES results, each a MORE_SEARCH_RESULT
+     for the corresponding entry in Lines.  Lines which were not evaluated,
+     because the search was cancelled or a prior match was found, are
+     MoreSearchResultUnknown.
+     */
+    PUCHAR Results;
+
+    /**
+     The number of entries in Lines to search in the current window.
+     */
+    YORI_ALLOC_SIZE_T LineCount;
+
+    /**
+     The number of threads to search with.
+     */
+    YORI_ALLOC_SIZE_T ThreadCount;
+
+    /**
+     The index of the earliest matching line in the current window, or
+     LineCount if none has been found.  This is only maintained if
+     StopAtFirstMatch is TRUE, and is updated with interlocked operations.
+     */
+    YORI_ALLOC_SIZE_T FirstMatch;
+
+    /**
+     The number of lines matched in the current window.  This is updated
+     with interlocked operations.
+     */
+    YORI_ALLOC_SIZE_T MatchCount;
+
+    /**
+     The number of lines evaluated in the current window.  This is updated
+     with interlocked operations.
+     */
+    YORI_ALLOC_SIZE_T LinesSearched;
+
+    /**
+     The number of lines evaluated in previous windows.
+     */
+    DWORDLONG PreviousLinesSearched;
+
+    /**
+     The number of lines matched in previous windows.
+     */
+    DWORDLONG PreviousMatchCount;
+
+    /**
+     The number of lines expected to be searched across all windows, for
+     display purposes, or zero if not known.
+     */
+    DWORDLONG TotalLines;
+
+    /**
+     The tick count when progress was last displayed, or when the current
+     window started being searched.
+     */
+    DWORD LastProgressTime;
+
+    /**
+     Nonzero while a thread is displaying progress or checking for the user
+     cancelling the search.  This is updated with interlocked operations.
+     */
+    DWORD ProgressActive;
+
+    /**
+     TRUE if only the earliest match in each window is needed.
+     */
+    BOOLEAN StopAtFirstMatch;
+
+    /**
+     TRUE to match against any search string, FALSE to match against the
+     current search string only.
+     */
+    BOOLEAN MatchAny;
+
+    /**
+     TRUE if progress has been written to the status line, implying the
+     status line needs to be redrawn once the search is complete.
+     */
+    BOOLEAN ProgressDisplayed;
+
+    /**
+     TRUE if the user cancelled the search.
+     */
+    BOOLEAN Cancelled;
+} MORE_PARALLEL_SEARCH, *PMORE_PARALLEL_SEARCH;
+
 VOID
 MoreGetViewportDimensions(
     __in PCONSOLE_SCREEN_BUFFER_INFO ScreenInfo,
@@ -485,6 +856,56 @@ MoreIngestThread(
     __in LPVOID Context
     );
 
+BOOLEAN
+MoreInitializeLineStore(
+    __inout PMORE_CONTEXT MoreContext
+    );
+
+VOID
+MoreCleanupLineStore(
+    __inout PMORE_CONTEXT MoreContext
+    );
+
+LPTSTR
+MoreAllocateLineText(
+    __in PMORE_CONTEXT MoreContext,
+    __inout PMORE_PHYSICAL_LINE PhysicalLine,
+    __in YORI_ALLOC_SIZE_T CharsRequired
+    );
+
+__success(return)
+BOOLEAN
+MoreAcquirePhysicalLineContents(
+    __in PMORE_CONTEXT MoreContext,
+    __in PMORE_PHYSICAL_LINE PhysicalLine,
+    __out PYORI_STRING Contents
+    );
+
+__success(return)
+BOOLEAN
+MoreInitializeParallelSearch(
+    __in PMORE_CONTEXT MoreContext,
+    __in BOOLEAN StopAtFirstMatch,
+    __in BOOLEAN MatchAny,
+    __in DWORDLONG TotalLines,
+    __out PMORE_PARALLEL_SEARCH Search
+    );
+
+VOID
+MoreCleanupParallelSearch(
+    __in PMORE_PARALLEL_SEARCH Search
+    );
+
+BOOLEAN
+MoreExecuteParallelSearch(
+    __in PMORE_PARALLEL_SEARCH Search
+    );
+
+VOID
+MoreClearStatusLine(
+    __in PMORE_CONTEXT MoreContext
+    );
+
 BOOL
 MoreViewportDisplay(
     __inout PMORE_CONTEXT MoreContext
@@ -507,15 +928,31 @@ MoreSearchIndexFree(
     __in UCHAR SearchIndex
     );
 
+VOID
+MoreSearchStringsChanged(
+    __in PMORE_CONTEXT MoreContext
+    );
+
 __success(return)
 BOOLEAN
 MoreFindNextSearchMatch(
     __in PMORE_CONTEXT MoreContext,
     __in PCYORI_STRING StringToSearch,
     __out_opt PYORI_ALLOC_SIZE_T MatchOffset,
+    __out_opt PYORI_ALLOC_SIZE_T MatchLength,
     __out_opt PUCHAR MatchIndex
     );
 
+__success(return)
+BOOLEAN
+MoreFindSearchStringMatch(
+    __in PMORE_CONTEXT MoreContext,
+    __in PCYORI_STRING StringToSearch,
+    __in UCHAR SearchIndex,
+    __out PYORI_ALLOC_SIZE_T MatchOffset,
+    __out PYORI_ALLOC_SIZE_T MatchLength
+    );
+
 VOID
 MoreTruncateStringToVisibleChars(
     __in PYORI_STRING String,
@@ -567,6 +1004,13 @@ MoreGetPreviousLogicalLines(
     );
 
 __success(return != NULL)
+BOOLEAN
+MoreDoesPhysicalLineMatchSearch(
+    __in PMORE_CONTEXT MoreContext,
+    __in PMORE_PHYSICAL_LINE PhysicalLine,
+    __in BOOLEAN MatchAny
+    );
+
 PMORE_PHYSICAL_LINE
 MoreFindNextLineWithSearchMatch(
     __in PMORE_CONTEXT MoreContext,
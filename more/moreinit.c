@@ -185,6 +185,10 @@ MoreInitContext(
         return FALSE;
     }
 
+    if (!MoreInitializeLineStore(MoreContext)) {
+        return FALSE;
+    }
+
     if (!GetConsoleScreenBufferInfo(GetStdHandle(STD_OUTPUT_HANDLE), &ScreenInfo)) {
         return FALSE;
     }
@@ -274,7 +278,18 @@ MoreCleanupContext(
         MoreContext->IngestThread = NULL;
     }
 
+    MoreCleanupLineStore(MoreContext);
+
+    if (MoreContext->SearchMatcherValid) {
+        YoriLibSubstringMatcherCleanup(&MoreContext->SearchMatcher);
+        MoreContext->SearchMatcherValid = FALSE;
+    }
+
     for (Index = 0; Index < MORE_MAX_SEARCHES; Index++) {
+        if (MoreContext->SearchRegexValid[Index]) {
+            YoriLibRegexCleanup(&MoreContext->SearchRegex[Index]);
+            MoreContext->SearchRegexValid[Index] = FALSE;
+        }
         YoriLibFreeStringContents(&MoreContext->SearchStrings[Index]);
         MoreContext->SearchContext[Index].ColorIndex = (UCHAR)-1;
     }
@@ -316,7 +331,9 @@ MoreGracefulExit(
     while (ListEntry != NULL) {
         PhysicalLine = CONTAINING_RECORD(ListEntry, MORE_PHYSICAL_LINE, LineList);
         YoriLibRemoveListItem(ListEntry);
-        YoriLibFreeStringContents(&PhysicalLine->LineContents);
+        if (PhysicalLine->WrapBreaks != NULL) {
+            YoriLibFree(PhysicalLine->WrapBreaks);
+        }
         YoriLibDereference(PhysicalLine->MemoryToFree);
         ListEntry = YoriLibGetNextListEntry(&MoreContext->PhysicalLineList, NULL);
     }
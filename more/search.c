@@ -0,0 +1,334 @@
+/**
+ * @file more/search.c
+ *
+ * Yori shell more evaluate search criteria across many lines in parallel
+ *
+ * Copyright (c) 2017-2021 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "more.h"
+
+/**
+ Prepare to search windows of physical lines in parallel.
+
+ @param MoreContext Pointer to the more context, indicating the current
+        search terms.
+
+ @param StopAtFirstMatch If TRUE, the caller only needs the earliest match
+        within each window, and lines after it need not be evaluated.  If
+        FALSE, every line in each window is evaluated.
+
+ @param MatchAny If TRUE, match against any search string.  If FALSE, match
+        against the current search string only.
+
+ @param TotalLines The number of lines expected to be searched across all
+        windows, used to display progress.  This can be zero if not known.
+
+ @param Search On successful completion, populated with a search context.
+        This should be freed with @ref MoreCleanupParallelSearch .
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+MoreInitializeParallelSearch(
+    __in PMORE_CONTEXT MoreContext,
+    __in BOOLEAN StopAtFirstMatch,
+    __in BOOLEAN MatchAny,
+    __in DWORDLONG TotalLines,
+    __out PMORE_PARALLEL_SEARCH Search
+    )
+{
+    SYSTEM_INFO SystemInfo;
+
+    ZeroMemory(Search, sizeof(MORE_PARALLEL_SEARCH));
+    Search->MoreContext = MoreContext;
+    Search->StopAtFirstMatch = StopAtFirstMatch;
+    Search->MatchAny = MatchAny;
+    Search->TotalLines = TotalLines;
+
+    GetSystemInfo(&SystemInfo);
+    Search->ThreadCount = (YORI_ALLOC_SIZE_T)SystemInfo.dwNumberOfProcessors;
+    if (Search->ThreadCount > MORE_SEARCH_MAX_THREADS) {
+        Search->ThreadCount = MORE_SEARCH_MAX_THREADS;
+    }
+    if (Search->ThreadCount < 1) {
+        Search->ThreadCount = 1;
+    }
+
+    Search->Lines = YoriLibMalloc(MORE_SEARCH_WINDOW_LINES * (sizeof(PMORE_PHYSICAL_LINE) + sizeof(UCHAR)));
+    if (Search->Lines == NULL) {
+        return FALSE;
+    }
+    Search->Results = (PUCHAR)&Search->Lines[MORE_SEARCH_WINDOW_LINES];
+
+    return TRUE;
+}
+
+/**
+ Free resources associated with a parallel search.
+
+ @param Search Pointer to the search context.
+ */
+VOID
+MoreCleanupParallelSearch(
+    __in PMORE_PARALLEL_SEARCH Search
+    )
+{
+    //
+    //  If progress was written over the status line, it needs to be redrawn.
+    //
+
+    if (Search->ProgressDisplayed) {
+        Search->MoreContext->SearchDirty = TRUE;
+    }
+
+    if (Search->Lines != NULL) {
+        YoriLibFree(Search->Lines);
+        Search->Lines = NULL;
+        Search->Results = NULL;
+    }
+}
+
+/**
+ Display the progress of a search in the status line.
+
+ @param Search Pointer to the search context.
+ */
+VOID
+MoreDisplayParallelSearchProgress(
+    __in PMORE_PARALLEL_SEARCH Search
+    )
+{
+    DWORDLONG LinesSearched;
+    DWORDLONG MatchCount;
+
+    LinesSearched = Search->PreviousLinesSearched + Search->LinesSearched;
+    MatchCount = Search->PreviousMatchCount + Search->MatchCount;
+
+    MoreClearStatusLine(Search->MoreContext);
+    YoriLibVtSetConsoleTextAttr(YORI_LIB_OUTPUT_STDOUT, FOREGROUND_RED | FOREGROUND_GREEN | FOREGROUND_BLUE | FOREGROUND_INTENSITY);
+    if (Search->StopAtFirstMatch) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T(" --- Searching --- (%lli lines searched, Esc to cancel)"), LinesSearched);
+    } else if (Search->TotalLines > 0) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T(" --- Filtering --- (%lli of %lli lines, %lli matches, Esc to cancel)"), LinesSearched, Search->TotalLines, MatchCount);
+    } else {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T(" --- Filtering --- (%lli lines, %lli matches, Esc to cancel)"), LinesSearched, MatchCount);
+    }
+    YoriLibVtSetConsoleTextAttr(YORI_LIB_OUTPUT_STDOUT, YoriLibVtGetDefaultColor());
+    Search->ProgressDisplayed = TRUE;
+}
+
+/**
+ Check whether the user has pressed Escape to cancel a search.  Input events
+ up to and including the Escape are consumed, so it is not interpreted as a
+ request to exit once the search completes.  Other input is left for the
+ viewport to process.
+
+ @param MoreContext Pointer to the more context.
+
+ @return TRUE if the user has requested the search be cancelled.
+ */
+BOOLEAN
+MoreCheckForSearchCancel(
+    __in PMORE_CONTEXT MoreContext
+    )
+{
+    INPUT_RECORD InputRecords[20];
+    DWORD ActuallyRead;
+    DWORD Index;
+
+    if (MoreContext->ConsoleInput == NULL) {
+        return FALSE;
+    }
+
+    if (!PeekConsoleInput(MoreContext->ConsoleInput, InputRecords, sizeof(InputRecords)/sizeof(InputRecords[0]), &ActuallyRead)) {
+        return FALSE;
+    }
+
+    for (Index = 0; Index < ActuallyRead; Index++) {
+        if (InputRecords[Index].EventType == KEY_EVENT &&
+            InputRecords[Index].Event.KeyEvent.bKeyDown &&
+            InputRecords[Index].Event.KeyEvent.wVirtualKeyCode == VK_ESCAPE) {
+
+            ReadConsoleInput(MoreContext->ConsoleInput, InputRecords, Index + 1, &ActuallyRead);
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+/**
+ If enough time has passed since progress was last displayed, check whether
+ the user has cancelled the search and display progress.  This can be called
+ from any thread searching, and only one thread performs this at a time.
+
+ @param Search Pointer to the search context.
+ */
+VOID
+MoreUpdateParallelSearchProgress(
+    __in PMORE_PARALLEL_SEARCH Search
+    )
+{
+    DWORD Now;
+
+    Now = GetTickCount();
+    if (Now - Search->LastProgressTime < MORE_SEARCH_PROGRESS_INTERVAL) {
+        return;
+    }
+
+    if (InterlockedCompareExchange((INTERLOCKED_VOLATILE LONG *)&Search->ProgressActive, 1, 0) != 0) {
+        return;
+    }
+
+    if (Now - Search->LastProgressTime >= MORE_SEARCH_PROGRESS_INTERVAL) {
+        if (!Search->Cancelled && MoreCheckForSearchCancel(Search->MoreContext)) {
+            Search->Cancelled = TRUE;
+        }
+        MoreDisplayParallelSearchProgress(Search);
+        Search->LastProgressTime = GetTickCount();
+    }
+
+    InterlockedExchange((INTERLOCKED_VOLATILE LONG *)&Search->ProgressActive, 0);
+}
+
+/**
+ Evaluate the search criteria against a chunk of physical lines.  Chunks are
+ claimed in ascending order, so when looking for the first match a chunk can
+ be skipped if it starts after a match that has already been found.
+
+ @param Context Pointer to the MORE_PARALLEL_SEARCH.
+
+ @param Chunk The index of the chunk to search, in units of
+        MORE_SEARCH_CHUNK_LINES lines.
+ */
+VOID
+MoreParallelSearchChunk(
+    __in PVOID Context,
+    __in DWORD Chunk
+    )
+{
+    PMORE_PARALLEL_SEARCH Search;
+    PMORE_CONTEXT MoreContext;
+    YORI_ALLOC_SIZE_T Index;
+    YORI_ALLOC_SIZE_T StartIndex;
+    YORI_ALLOC_SIZE_T EndIndex;
+    YORI_ALLOC_SIZE_T FirstMatch;
+    BOOLEAN MatchFound;
+
+    Search = (PMORE_PARALLEL_SEARCH)Context;
+    MoreContext = Search->MoreContext;
+
+    if (Search->Cancelled) {
+        return;
+    }
+
+    StartIndex = (YORI_ALLOC_SIZE_T)(Chunk * MORE_SEARCH_CHUNK_LINES);
+    if (Search->StopAtFirstMatch && StartIndex > Search->FirstMatch) {
+        return;
+    }
+
+    EndIndex = StartIndex + MORE_SEARCH_CHUNK_LINES;
+    if (EndIndex > Search->LineCount) {
+        EndIndex = Search->LineCount;
+    }
+
+    for (Index = StartIndex; Index < EndIndex; Index++) {
+        MatchFound = MoreDoesPhysicalLineMatchSearch(MoreContext, Search->Lines[Index], Search->MatchAny);
+        if (MatchFound) {
+            Search->Results[Index] = MoreSearchResultMatch;
+            InterlockedIncrement((INTERLOCKED_VOLATILE LONG *)&Search->MatchCount);
+        } else {
+            Search->Results[Index] = MoreSearchResultNoMatch;
+        }
+
+        if (MatchFound && Search->StopAtFirstMatch) {
+
+            //
+            //  Record this match if it is earlier than any other found
+            //  so far.  Nothing after it in this chunk is needed.
+            //
+
+            while (TRUE) {
+                FirstMatch = Search->FirstMatch;
+                if (Index >= FirstMatch) {
+                    break;
+                }
+                if (InterlockedCompareExchange((INTERLOCKED_VOLATILE LONG *)&Search->FirstMatch, (LONG)Index, (LONG)FirstMatch) == (LONG)FirstMatch) {
+                    break;
+                }
+            }
+            Index++;
+            break;
+        }
+    }
+
+    InterlockedExchangeAdd((INTERLOCKED_VOLATILE LONG *)&Search->LinesSearched, (LONG)(Index - StartIndex));
+
+    MoreUpdateParallelSearchProgress(Search);
+}
+
+/**
+ Evaluate the search criteria against the window of lines in Search->Lines,
+ using as many threads as there are processors.  While this is occurring,
+ progress is displayed in the status line, and the user can press Escape to
+ cancel the search.  The lines must not be modified while the search is in
+ progress, but PhysicalLineMutex does not need to be held, so new lines can
+ continue to be ingested.
+
+ @param Search Pointer to the search context.  On entry, Lines and LineCount
+        describe the lines to search.  On exit, Results indicates the outcome
+        for each line, and if StopAtFirstMatch is set, FirstMatch indicates
+        the earliest matching line, or LineCount if no line matched.
+
+ @return TRUE if the search completed, FALSE if it was cancelled.
+ */
+BOOLEAN
+MoreExecuteParallelSearch(
+    __in PMORE_PARALLEL_SEARCH Search
+    )
+{
+    YORI_ALLOC_SIZE_T ChunkCount;
+
+    ASSERT(Search->LineCount <= MORE_SEARCH_WINDOW_LINES);
+
+    ZeroMemory(Search->Results, Search->LineCount * sizeof(UCHAR));
+    Search->FirstMatch = Search->LineCount;
+    Search->MatchCount = 0;
+    Search->LinesSearched = 0;
+    Search->LastProgressTime = GetTickCount();
+
+    ChunkCount = (Search->LineCount + MORE_SEARCH_CHUNK_LINES - 1) / MORE_SEARCH_CHUNK_LINES;
+
+    YoriLibProcessItemsInParallel(ChunkCount, Search->ThreadCount, MoreParallelSearchChunk, Search);
+
+    Search->PreviousLinesSearched = Search->PreviousLinesSearched + Search->LinesSearched;
+    Search->PreviousMatchCount = Search->PreviousMatchCount + Search->MatchCount;
+
+    if (Search->Cancelled) {
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+// vim:sw=4:ts=4:et:
@@ -1793,6 +1793,7 @@ MoreAppendToSearchString(
         SearchString->LengthInChars = SearchString->LengthInChars + String->LengthInChars;
     }
     MoreContext->SearchContext[SearchIndex].ColorIndex = MoreContext->SearchColorIndex;
+    MoreSearchStringsChanged(MoreContext);
     MoreContext->SearchDirty = TRUE;
     return TRUE;
 }
@@ -1957,6 +1958,7 @@ MoreProcessKeyDown(
                     }
                 } else {
                     SearchString->LengthInChars = SearchString->LengthInChars - InputRecord->Event.KeyEvent.wRepeatCount;
+                    MoreSearchStringsChanged(MoreContext);
                 }
                 MoreContext->SearchDirty = TRUE;
             } else if (Char == '\r') {
@@ -2707,6 +2709,8 @@ MoreViewportDisplay(
         return FALSE;
     }
 
+    MoreContext->ConsoleInput = InHandle;
+
     //
     //  If YoriQuickEdit is enabled, set the extended flags, which indicates
     //  an intention to clear the console's quickedit functionality.  Note
@@ -2938,6 +2942,7 @@ MoreViewportDisplay(
     }
 
     YoriLibCleanupSelection(&MoreContext->Selection);
+    MoreContext->ConsoleInput = NULL;
     CloseHandle(InHandle);
     return TRUE;
 }
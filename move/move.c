@@ -3,7 +3,7 @@
  *
  * Yori shell move or rename files
  *
- * Copyright (c) 2017-2021 Malcolm J. Smith
+ * Copyright (c) 2017-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -40,7 +40,11 @@ CHAR strMoveHelpText[] =
         "\n"
         "   -b             Use basic search criteria for files only\n"
         "   -p             Move with POSIX semantics\n"
-        "   -k             Keep existing files, do not overwrite\n";
+        "   -k             Keep existing files, do not overwrite\n"
+        "\n"
+        "When moving to a different volume, all files are copied concurrently and\n"
+        "their sizes verified before any are placed in the destination, and the\n"
+        "sources are only deleted once every file is in place.\n";
 
 /**
  Display usage text to the user.
@@ -57,6 +61,76 @@ MoveHelp(VOID)
 }
 
 
+/**
+ A file or directory to be moved to a different volume.  These are
+ collected during enumeration and moved once all arguments are processed.
+ */
+typedef struct _MOVE_CROSS_VOLUME_ENTRY {
+
+    /**
+     The full path to the source object.
+     */
+    YORI_STRING Source;
+
+    /**
+     The full path to the destination object.
+     */
+    YORI_STRING Dest;
+
+    /**
+     For files, the full path to a uniquely named temporary file in the
+     destination directory which the data is copied to before the move is
+     committed.
+     */
+    YORI_STRING TempDest;
+
+    /**
+     The size of the source file when it was enumerated.
+     */
+    LARGE_INTEGER FileSize;
+
+    /**
+     The attributes of the source object when it was enumerated.
+     */
+    DWORD FileAttributes;
+
+    /**
+     The result of the most recent step applied to this entry.
+     */
+    DWORD Error;
+
+    /**
+     TRUE if the entry is a directory.
+     */
+    BOOLEAN IsDirectory;
+
+    /**
+     TRUE if the entry is a directory which did not exist and was created
+     by this move, so should be removed if the move fails.
+     */
+    BOOLEAN DirectoryCreated;
+
+    /**
+     TRUE if the temporary file has been created by this move for this
+     entry.  Only files created by this move are deleted on rollback.
+     */
+    BOOLEAN TempCreated;
+
+    /**
+     TRUE if the temporary file has been renamed into place at the
+     destination.
+     */
+    BOOLEAN Renamed;
+
+    /**
+     TRUE if an object existed at the destination before the temporary file
+     was renamed over it.  Such a file cannot be restored on rollback, but
+     a file which did not previously exist is deleted.
+     */
+    BOOLEAN DestExisted;
+
+} MOVE_CROSS_VOLUME_ENTRY, *PMOVE_CROSS_VOLUME_ENTRY;
+
 /**
  A context passed between each source file match when moving multiple
  files.
@@ -92,8 +166,803 @@ typedef struct _MOVE_CONTEXT {
      */
     BOOLEAN PosixSemantics;
 
+    /**
+     TRUE if a cross volume move cannot be performed, because an object
+     could not be enumerated or already exists and should be kept.  If set,
+     no cross volume objects are moved.
+     */
+    BOOLEAN CrossVolumeFailed;
+
+    /**
+     TRUE if memory could not be allocated to record an object to move.
+     */
+    BOOLEAN OutOfMemory;
+
+    /**
+     An array of objects to move to a different volume.  Directories are
+     recorded before their contents.
+     */
+    PMOVE_CROSS_VOLUME_ENTRY Entries;
+
+    /**
+     The number of entries in the Entries array.
+     */
+    DWORD EntryCount;
+
+    /**
+     The number of entries allocated in the Entries array.
+     */
+    DWORD EntriesAllocated;
+
+    /**
+     When enumerating the contents of a directory being moved to a different
+     volume, the full path to the destination of the directory.
+     */
+    PYORI_STRING CurrentDirectoryDest;
+
 } MOVE_CONTEXT, *PMOVE_CONTEXT;
 
+/**
+ Display an error encountered when moving an object.
+
+ @param Action Pointer to a string describing the step that failed.
+
+ @param FilePath Pointer to the object being moved.
+
+ @param Error The Win32 error code describing the failure.
+ */
+VOID
+MoveReportError(
+    __in LPCTSTR Action,
+    __in PYORI_STRING FilePath,
+    __in DWORD Error
+    )
+{
+    LPTSTR ErrText = YoriLibGetWinErrorText(Error);
+    YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("move: %s of %y failed: %s"), Action, FilePath, ErrText);
+    YoriLibFreeWinErrorText(ErrText);
+}
+
+/**
+ Determine whether a source object and its destination are on different
+ volumes, so the move cannot be performed with a rename.
+
+ @param Source Pointer to the full path to the source.
+
+ @param FullDest Pointer to the full path to the destination.
+
+ @return TRUE if the objects are known to be on different volumes, FALSE if
+         they are on the same volume or the volumes could not be determined.
+ */
+BOOLEAN
+MoveIsCrossVolume(
+    __in PYORI_STRING Source,
+    __in PYORI_STRING FullDest
+    )
+{
+    YORI_STRING SourceVolume;
+    YORI_STRING DestVolume;
+    BOOLEAN CrossVolume;
+
+    YoriLibInitEmptyString(&SourceVolume);
+    YoriLibInitEmptyString(&DestVolume);
+    CrossVolume = FALSE;
+
+    if (YoriLibGetVolumePathName(Source, &SourceVolume) &&
+        YoriLibGetVolumePathName(FullDest, &DestVolume)) {
+
+        if (YoriLibCompareStringIns(&SourceVolume, &DestVolume) != 0) {
+            CrossVolume = TRUE;
+        }
+    }
+
+    YoriLibFreeStringContents(&SourceVolume);
+    YoriLibFreeStringContents(&DestVolume);
+    return CrossVolume;
+}
+
+/**
+ Record an object to move to a different volume.
+
+ @param MoveContext Pointer to the move context.
+
+ @param Source Pointer to the full path to the source object.
+
+ @param FileInfo Information about the source object.
+
+ @param FullDest Pointer to the full path to the destination object.
+
+ @return Pointer to the new entry, or NULL on allocation failure.
+ */
+PMOVE_CROSS_VOLUME_ENTRY
+MoveAddCrossVolumeEntry(
+    __inout PMOVE_CONTEXT MoveContext,
+    __in PYORI_STRING Source,
+    __in PWIN32_FIND_DATA FileInfo,
+    __in PYORI_STRING FullDest
+    )
+{
+    PMOVE_CROSS_VOLUME_ENTRY NewEntries;
+    PMOVE_CROSS_VOLUME_ENTRY Entry;
+    DWORD NewAllocated;
+
+    if (MoveContext->EntryCount >= MoveContext->EntriesAllocated) {
+        NewAllocated = MoveContext->EntriesAllocated * 2;
+        if (NewAllocated < 64) {
+            NewAllocated = 64;
+        }
+        if (!YoriLibIsSizeAllocatable(NewAllocated * sizeof(MOVE_CROSS_VOLUME_ENTRY))) {
+            MoveContext->OutOfMemory = TRUE;
+            return NULL;
+        }
+        NewEntries = YoriLibMalloc((YORI_ALLOC_SIZE_T)(NewAllocated * sizeof(MOVE_CROSS_VOLUME_ENTRY)));
+        if (NewEntries == NULL) {
+            MoveContext->OutOfMemory = TRUE;
+            return NULL;
+        }
+        if (MoveContext->Entries != NULL) {
+            memcpy(NewEntries, MoveContext->Entries, MoveContext->EntryCount * sizeof(MOVE_CROSS_VOLUME_ENTRY));
+            YoriLibFree(MoveContext->Entries);
+        }
+        MoveContext->Entries = NewEntries;
+        MoveContext->EntriesAllocated = NewAllocated;
+    }
+
+    Entry = &MoveContext->Entries[MoveContext->EntryCount];
+    ZeroMemory(Entry, sizeof(MOVE_CROSS_VOLUME_ENTRY));
+    if (!YoriLibCopyString(&Entry->Source, Source)) {
+        MoveContext->OutOfMemory = TRUE;
+        return NULL;
+    }
+    if (!YoriLibCopyString(&Entry->Dest, FullDest)) {
+        YoriLibFreeStringContents(&Entry->Source);
+        MoveContext->OutOfMemory = TRUE;
+        return NULL;
+    }
+
+    Entry->FileAttributes = FileInfo->dwFileAttributes;
+    Entry->FileSize.LowPart = FileInfo->nFileSizeLow;
+    Entry->FileSize.HighPart = (LONG)FileInfo->nFileSizeHigh;
+    if (FileInfo->dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+        Entry->IsDirectory = TRUE;
+    }
+    MoveContext->EntryCount++;
+
+    return Entry;
+}
+
+/**
+ A callback that is invoked for each object within a directory which is
+ being moved to a different volume.
+
+ @param FilePath Pointer to the file path that was found.
+
+ @param FileInfo Information about the file.
+
+ @param Depth Specifies the recursion depth, used to determine the path of
+        the object relative to the directory being moved.
+
+ @param Context Pointer to the move context.
+
+ @return TRUE to continute enumerating, FALSE to abort.
+ */
+BOOL
+MoveCrossVolumeChildFoundCallback(
+    __in PYORI_STRING FilePath,
+    __in PWIN32_FIND_DATA FileInfo,
+    __in DWORD Depth,
+    __in PVOID Context
+    )
+{
+    PMOVE_CONTEXT MoveContext = (PMOVE_CONTEXT)Context;
+    YORI_STRING RelativePathFromSource;
+    YORI_STRING FullDest;
+    YORI_ALLOC_SIZE_T SlashesFound;
+    YORI_ALLOC_SIZE_T Index;
+    PYORI_STRING DirectoryDest;
+
+    ASSERT(YoriLibIsStringNullTerminated(FilePath));
+
+    SlashesFound = 0;
+    for (Index = FilePath->LengthInChars; Index > 0; Index--) {
+        if (FilePath->StartOfString[Index - 1] == '\\') {
+            SlashesFound++;
+            if (SlashesFound == Depth + 1) {
+                break;
+            }
+        }
+    }
+
+    ASSERT(Index > 0);
+    ASSERT(SlashesFound == Depth + 1);
+
+    YoriLibInitEmptyString(&RelativePathFromSource);
+    RelativePathFromSource.StartOfString = &FilePath->StartOfString[Index];
+    RelativePathFromSource.LengthInChars = FilePath->LengthInChars - Index;
+
+    DirectoryDest = MoveContext->CurrentDirectoryDest;
+    YoriLibInitEmptyString(&FullDest);
+    if (YoriLibYPrintf(&FullDest, _T("%y\\%y"), DirectoryDest, &RelativePathFromSource) < 0) {
+        MoveContext->OutOfMemory = TRUE;
+        return FALSE;
+    }
+
+    if (!MoveContext->ReplaceExisting &&
+        (FileInfo->dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == 0 &&
+        GetFileAttributes(FullDest.StartOfString) != (DWORD)-1) {
+
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("move: %y already exists\n"), &FullDest);
+        MoveContext->CrossVolumeFailed = TRUE;
+    }
+
+    MoveAddCrossVolumeEntry(MoveContext, FilePath, FileInfo, &FullDest);
+    YoriLibFreeStringContents(&FullDest);
+    if (MoveContext->OutOfMemory) {
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ A callback that is invoked when a directory being moved to a different
+ volume cannot be enumerated.  Since its contents cannot be moved, no
+ objects are moved to a different volume.
+
+ @param FilePath Pointer to the file path that could not be enumerated.
+
+ @param ErrorCode The Win32 error code describing the failure.
+
+ @param Depth Recursion depth, ignored in this application.
+
+ @param Context Pointer to the move context.
+
+ @return TRUE to continute enumerating, FALSE to abort.
+ */
+BOOL
+MoveCrossVolumeEnumerateErrorCallback(
+    __in PYORI_STRING FilePath,
+    __in DWORD ErrorCode,
+    __in DWORD Depth,
+    __in PVOID Context
+    )
+{
+    PMOVE_CONTEXT MoveContext = (PMOVE_CONTEXT)Context;
+
+    UNREFERENCED_PARAMETER(Depth);
+
+    //
+    //  An empty directory has no children to find.
+    //
+
+    if (ErrorCode == ERROR_FILE_NOT_FOUND) {
+        return TRUE;
+    }
+
+    MoveReportError(_T("enumerate"), FilePath, ErrorCode);
+    MoveContext->CrossVolumeFailed = TRUE;
+    return FALSE;
+}
+
+/**
+ Record an object, and if it is a directory, all of its contents, to be
+ moved to a different volume once all arguments have been processed.
+
+ @param MoveContext Pointer to the move context.
+
+ @param Source Pointer to the full path to the source object.
+
+ @param FileInfo Information about the source object.
+
+ @param FullDest Pointer to the full path to the destination object.
+ */
+VOID
+MoveQueueCrossVolume(
+    __inout PMOVE_CONTEXT MoveContext,
+    __in PYORI_STRING Source,
+    __in PWIN32_FIND_DATA FileInfo,
+    __in PYORI_STRING FullDest
+    )
+{
+    PMOVE_CROSS_VOLUME_ENTRY Entry;
+    YORI_STRING ChildSpec;
+    YORI_STRING DirectoryDest;
+
+    if (!MoveContext->ReplaceExisting &&
+        (FileInfo->dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == 0 &&
+        GetFileAttributes(FullDest->StartOfString) != (DWORD)-1) {
+
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("move: %y already exists\n"), FullDest);
+        MoveContext->CrossVolumeFailed = TRUE;
+        return;
+    }
+
+    Entry = MoveAddCrossVolumeEntry(MoveContext, Source, FileInfo, FullDest);
+    if (Entry == NULL || !Entry->IsDirectory) {
+        return;
+    }
+
+    //
+    //  The entry array may be reallocated while enumerating, so keep a
+    //  separate copy of the directory's destination.
+    //
+
+    YoriLibInitEmptyString(&ChildSpec);
+    if (YoriLibYPrintf(&ChildSpec, _T("%y\\*"), Source) < 0) {
+        MoveContext->OutOfMemory = TRUE;
+        return;
+    }
+
+    if (!YoriLibCopyString(&DirectoryDest, FullDest)) {
+        YoriLibFreeStringContents(&ChildSpec);
+        MoveContext->OutOfMemory = TRUE;
+        return;
+    }
+
+    MoveContext->CurrentDirectoryDest = &DirectoryDest;
+    YoriLibForEachFile(&ChildSpec,
+                       YORILIB_FILEENUM_RETURN_FILES |
+                           YORILIB_FILEENUM_RETURN_DIRECTORIES |
+                           YORILIB_FILEENUM_RECURSE_AFTER_RETURN |
+                           YORILIB_FILEENUM_NO_LINK_TRAVERSE |
+                           YORILIB_FILEENUM_BASIC_EXPANSION,
+                       0,
+                       MoveCrossVolumeChildFoundCallback,
+                       MoveCrossVolumeEnumerateErrorCallback,
+                       MoveContext);
+    MoveContext->CurrentDirectoryDest = NULL;
+
+    YoriLibFreeStringContents(&DirectoryDest);
+    YoriLibFreeStringContents(&ChildSpec);
+}
+
+/**
+ Query the size of a file.
+
+ @param FilePath Pointer to a NULL terminated full path to the file.
+
+ @param FileSize On successful completion, updated to contain the size of
+        the file.
+
+ @return ERROR_SUCCESS to indicate success, or a Win32 error code on failure.
+ */
+DWORD
+MoveGetFileSize(
+    __in PYORI_STRING FilePath,
+    __out PLARGE_INTEGER FileSize
+    )
+{
+    HANDLE FileHandle;
+    BY_HANDLE_FILE_INFORMATION FileInfo;
+    DWORD Error;
+
+    FileHandle = CreateFile(FilePath->StartOfString,
+                            FILE_READ_ATTRIBUTES,
+                            FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                            NULL,
+                            OPEN_EXISTING,
+                            FILE_FLAG_BACKUP_SEMANTICS,
+                            NULL);
+
+    if (FileHandle == INVALID_HANDLE_VALUE) {
+        return GetLastError();
+    }
+
+    Error = ERROR_SUCCESS;
+    if (!GetFileInformationByHandle(FileHandle, &FileInfo)) {
+        Error = GetLastError();
+    } else {
+        FileSize->LowPart = FileInfo.nFileSizeLow;
+        FileSize->HighPart = (LONG)FileInfo.nFileSizeHigh;
+    }
+
+    CloseHandle(FileHandle);
+    return Error;
+}
+
+/**
+ Copy a file to its temporary destination and verify that the size of the
+ copy matches the source.  This is invoked on multiple threads concurrently,
+ each with a different entry.
+
+ @param Context Pointer to the move context.
+
+ @param Index The index of the entry to copy.
+ */
+VOID
+MoveCopyEntry(
+    __in PVOID Context,
+    __in DWORD Index
+    )
+{
+    PMOVE_CONTEXT MoveContext;
+    PMOVE_CROSS_VOLUME_ENTRY Entry;
+    LARGE_INTEGER CopiedSize;
+    YORI_STRING DestDir;
+    YORI_STRING TempPrefix;
+    LPTSTR FinalSeperator;
+
+    MoveContext = (PMOVE_CONTEXT)Context;
+    YoriLibConstantString(&TempPrefix, _T("YMV"));
+
+    Entry = &MoveContext->Entries[Index];
+    if (Entry->IsDirectory) {
+        return;
+    }
+
+    if (YoriLibIsOperationCancelled()) {
+        Entry->Error = ERROR_CANCELLED;
+        return;
+    }
+
+    //
+    //  Reserve a name in the destination directory that nothing else
+    //  is using.  The file is created here, so the copy below only
+    //  ever overwrites a file that belongs to this move.
+    //
+
+    FinalSeperator = YoriLibFindRightMostCharacter(&Entry->Dest, '\\');
+    if (FinalSeperator == NULL) {
+        Entry->Error = ERROR_INVALID_NAME;
+        return;
+    }
+
+    YoriLibInitEmptyString(&DestDir);
+    DestDir.StartOfString = Entry->Dest.StartOfString;
+    DestDir.LengthInChars = (YORI_ALLOC_SIZE_T)(FinalSeperator - Entry->Dest.StartOfString);
+
+    if (!YoriLibGetTempFileName(&DestDir, &TempPrefix, NULL, &Entry->TempDest)) {
+        Entry->Error = GetLastError();
+        if (Entry->Error == ERROR_SUCCESS) {
+            Entry->Error = ERROR_FILE_EXISTS;
+        }
+        return;
+    }
+    Entry->TempCreated = TRUE;
+
+    //
+    //  CopyFile uses offloaded copies where the storage supports them.
+    //
+
+    Entry->Error = YoriLibCopyFile(&Entry->Source, &Entry->TempDest);
+    if (Entry->Error != ERROR_SUCCESS) {
+        return;
+    }
+
+    Entry->Error = MoveGetFileSize(&Entry->TempDest, &CopiedSize);
+    if (Entry->Error == ERROR_SUCCESS &&
+        CopiedSize.QuadPart != Entry->FileSize.QuadPart) {
+
+        Entry->Error = ERROR_FILE_INVALID;
+    }
+}
+
+/**
+ Delete a file, clearing any attributes which prevent deletion if needed.
+
+ @param FilePath Pointer to a NULL terminated full path to the file.
+
+ @param IsDirectory TRUE if the object is a directory.
+
+ @return ERROR_SUCCESS to indicate success, or a Win32 error code on failure.
+ */
+DWORD
+MoveDeleteObject(
+    __in PYORI_STRING FilePath,
+    __in BOOLEAN IsDirectory
+    )
+{
+    DWORD Attributes;
+    DWORD Error;
+    BOOL Result;
+
+    if (IsDirectory) {
+        Result = RemoveDirectory(FilePath->StartOfString);
+    } else {
+        Result = DeleteFile(FilePath->StartOfString);
+    }
+
+    if (Result) {
+        return ERROR_SUCCESS;
+    }
+
+    Error = GetLastError();
+    if (Error == ERROR_ACCESS_DENIED) {
+        Attributes = GetFileAttributes(FilePath->StartOfString);
+        if (Attributes != (DWORD)-1 &&
+            (Attributes & FILE_ATTRIBUTE_READONLY) != 0 &&
+            SetFileAttributes(FilePath->StartOfString, Attributes & ~(FILE_ATTRIBUTE_READONLY))) {
+
+            if (IsDirectory) {
+                Result = RemoveDirectory(FilePath->StartOfString);
+            } else {
+                Result = DeleteFile(FilePath->StartOfString);
+            }
+
+            if (Result) {
+                return ERROR_SUCCESS;
+            }
+            Error = GetLastError();
+            SetFileAttributes(FilePath->StartOfString, Attributes);
+        }
+    }
+
+    return Error;
+}
+
+/**
+ Delete a source file once every file has been placed in its destination.
+ This is invoked on multiple threads concurrently, each with a different
+ entry.  Directories are removed later, once their contents are gone.
+
+ @param Context Pointer to the move context.
+
+ @param Index The index of the entry to delete.
+ */
+VOID
+MoveDeleteEntry(
+    __in PVOID Context,
+    __in DWORD Index
+    )
+{
+    PMOVE_CONTEXT MoveContext;
+    PMOVE_CROSS_VOLUME_ENTRY Entry;
+
+    MoveContext = (PMOVE_CONTEXT)Context;
+    Entry = &MoveContext->Entries[Index];
+    if (!Entry->IsDirectory) {
+        Entry->Error = MoveDeleteObject(&Entry->Source, FALSE);
+    }
+}
+
+/**
+ Apply a function to every cross volume entry using a pool of threads.
+
+ @param MoveContext Pointer to the move context.
+
+ @param EntryFn The function to invoke for each entry.
+ */
+VOID
+MoveRunWorkers(
+    __inout PMOVE_CONTEXT MoveContext,
+    __in PYORILIB_PARALLEL_ITEM_FN EntryFn
+    )
+{
+    WORD PerformanceProcessors;
+    WORD EfficiencyProcessors;
+    DWORD ThreadCount;
+
+    //
+    //  Copies spend much of their time waiting for the device, so use at
+    //  least a few threads even on a small system.
+    //
+
+    YoriLibQueryCpuCount(&PerformanceProcessors, &EfficiencyProcessors);
+    ThreadCount = PerformanceProcessors + EfficiencyProcessors;
+    if (ThreadCount < 4) {
+        ThreadCount = 4;
+    }
+
+    YoriLibProcessItemsInParallel(MoveContext->EntryCount, ThreadCount, EntryFn, MoveContext);
+}
+
+/**
+ Undo a cross volume move which could not be completed.  Temporary files
+ are deleted, files renamed into place where nothing previously existed are
+ deleted, and directories created by the move are removed.  Sources have not
+ been modified.
+
+ @param MoveContext Pointer to the move context.
+
+ @return The number of files which remain at the destination because they
+         replaced an existing file or could not be deleted.  If zero, the
+         destination is left as it was.
+ */
+DWORD
+MoveRollbackCrossVolume(
+    __inout PMOVE_CONTEXT MoveContext
+    )
+{
+    PMOVE_CROSS_VOLUME_ENTRY Entry;
+    DWORD Index;
+    DWORD FilesRemaining;
+
+    FilesRemaining = 0;
+    for (Index = MoveContext->EntryCount; Index > 0; Index--) {
+        Entry = &MoveContext->Entries[Index - 1];
+        if (Entry->TempCreated) {
+            MoveDeleteObject(&Entry->TempDest, FALSE);
+            Entry->TempCreated = FALSE;
+        }
+        if (Entry->Renamed) {
+            if (Entry->DestExisted ||
+                MoveDeleteObject(&Entry->Dest, FALSE) != ERROR_SUCCESS) {
+
+                FilesRemaining++;
+            }
+            Entry->Renamed = FALSE;
+        }
+        if (Entry->DirectoryCreated) {
+            RemoveDirectory(Entry->Dest.StartOfString);
+            Entry->DirectoryCreated = FALSE;
+        }
+    }
+
+    return FilesRemaining;
+}
+
+/**
+ Move every recorded object to a different volume.  Directories are
+ created, then all files are copied concurrently to temporary names beside
+ their destinations and their sizes verified.  If any copy fails, the
+ temporary files and new directories are removed and the sources are left
+ untouched.  Otherwise each temporary file is renamed into place, and only
+ once every file is in place are the sources deleted, concurrently.  If a
+ rename fails, files already renamed are removed where nothing previously
+ existed at the destination, and the sources are left untouched.
+
+ @param MoveContext Pointer to the move context.
+
+ @return TRUE to indicate every object was moved, FALSE if the move failed.
+ */
+BOOLEAN
+MoveCommitCrossVolume(
+    __inout PMOVE_CONTEXT MoveContext
+    )
+{
+    PMOVE_CROSS_VOLUME_ENTRY Entry;
+    LONGLONG StartTime;
+    LONGLONG ElapsedMs;
+    DWORDLONG BytesMoved;
+    DWORDLONG FilesMoved;
+    DWORD Attributes;
+    DWORD Index;
+    DWORD Error;
+    DWORD FilesRemaining;
+    BOOLEAN Result;
+
+    StartTime = YoriLibGetSystemTimeAsInteger();
+    BytesMoved = 0;
+    FilesMoved = 0;
+
+    //
+    //  Create directories in order, so parents exist before their
+    //  children.  A directory which already exists is merged into.
+    //
+
+    Error = ERROR_SUCCESS;
+    for (Index = 0; Index < MoveContext->EntryCount; Index++) {
+        Entry = &MoveContext->Entries[Index];
+        if (!Entry->IsDirectory) {
+            FilesMoved++;
+            BytesMoved += Entry->FileSize.QuadPart;
+            continue;
+        }
+
+        Attributes = GetFileAttributes(Entry->Dest.StartOfString);
+        if (Attributes != (DWORD)-1 && (Attributes & FILE_ATTRIBUTE_DIRECTORY) != 0) {
+            continue;
+        }
+
+        if (!CreateDirectory(Entry->Dest.StartOfString, NULL)) {
+            Error = GetLastError();
+            MoveReportError(_T("create directory"), &Entry->Dest, Error);
+            break;
+        }
+        Entry->DirectoryCreated = TRUE;
+        SetFileAttributes(Entry->Dest.StartOfString, Entry->FileAttributes & (FILE_ATTRIBUTE_READONLY | FILE_ATTRIBUTE_HIDDEN | FILE_ATTRIBUTE_SYSTEM | FILE_ATTRIBUTE_ARCHIVE | FILE_ATTRIBUTE_NOT_CONTENT_INDEXED));
+    }
+
+    if (Error == ERROR_SUCCESS) {
+        MoveRunWorkers(MoveContext, MoveCopyEntry);
+        for (Index = 0; Index < MoveContext->EntryCount; Index++) {
+            Entry = &MoveContext->Entries[Index];
+            if (!Entry->IsDirectory && Entry->Error != ERROR_SUCCESS) {
+                Error = Entry->Error;
+                MoveReportError(_T("copy"), &Entry->Source, Error);
+            }
+        }
+    }
+
+    //
+    //  Commit each file by renaming it into place.  This is on the
+    //  destination volume so it doesn't move any data.
+    //
+
+    if (Error == ERROR_SUCCESS) {
+        for (Index = 0; Index < MoveContext->EntryCount; Index++) {
+            Entry = &MoveContext->Entries[Index];
+            if (Entry->IsDirectory) {
+                continue;
+            }
+            Entry->DestExisted = (BOOLEAN)(GetFileAttributes(Entry->Dest.StartOfString) != (DWORD)-1);
+            Error = YoriLibMoveFile(&Entry->TempDest, &Entry->Dest, MoveContext->ReplaceExisting, FALSE);
+            if (Error != ERROR_SUCCESS) {
+                MoveReportError(_T("rename"), &Entry->Dest, Error);
+                break;
+            }
+            Entry->TempCreated = FALSE;
+            Entry->Renamed = TRUE;
+        }
+    }
+
+    //
+    //  Files already renamed into place can't be rolled back if they
+    //  replaced an existing file, but since no source has been deleted,
+    //  no data is lost.
+    //
+
+    if (Error != ERROR_SUCCESS) {
+        FilesRemaining = MoveRollbackCrossVolume(MoveContext);
+        if (FilesRemaining == 0) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("move: no files were moved\n"));
+        } else {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("move: failed partway, %i files remain at the destination and no source files were deleted\n"), FilesRemaining);
+        }
+        return FALSE;
+    }
+
+    //
+    //  Every file is in place, so remove the sources.  Files are deleted
+    //  concurrently, then directories are removed in reverse order so
+    //  children are removed before their parents.
+    //
+
+    Result = TRUE;
+    MoveRunWorkers(MoveContext, MoveDeleteEntry);
+    for (Index = MoveContext->EntryCount; Index > 0; Index--) {
+        Entry = &MoveContext->Entries[Index - 1];
+        if (Entry->IsDirectory) {
+            Entry->Error = MoveDeleteObject(&Entry->Source, TRUE);
+        }
+        if (Entry->Error != ERROR_SUCCESS) {
+            MoveReportError(_T("delete"), &Entry->Source, Entry->Error);
+            Result = FALSE;
+        }
+    }
+
+    ElapsedMs = (YoriLibGetSystemTimeAsInteger() - StartTime) / 10000;
+    if (ElapsedMs == 0) {
+        ElapsedMs = 1;
+    }
+    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT,
+                  _T("Moved %lli files, %lli bytes in %lli ms (%lli KB/s)\n"),
+                  FilesMoved,
+                  BytesMoved,
+                  ElapsedMs,
+                  (LONGLONG)(BytesMoved * 1000 / 1024 / ElapsedMs));
+
+    return Result;
+}
+
+/**
+ Free the objects recorded for a cross volume move.
+
+ @param MoveContext Pointer to the move context.
+ */
+VOID
+MoveCleanupCrossVolume(
+    __inout PMOVE_CONTEXT MoveContext
+    )
+{
+    PMOVE_CROSS_VOLUME_ENTRY Entry;
+    DWORD Index;
+
+    for (Index = 0; Index < MoveContext->EntryCount; Index++) {
+        Entry = &MoveContext->Entries[Index];
+        YoriLibFreeStringContents(&Entry->Source);
+        YoriLibFreeStringContents(&Entry->Dest);
+        YoriLibFreeStringContents(&Entry->TempDest);
+    }
+
+    if (MoveContext->Entries != NULL) {
+        YoriLibFree(MoveContext->Entries);
+    }
+    MoveContext->Entries = NULL;
+    MoveContext->EntryCount = 0;
+    MoveContext->EntriesAllocated = 0;
+}
+
 /**
  A callback that is invoked when a file is found that matches a search criteria
  specified in the set of strings to enumerate.
@@ -176,6 +1045,21 @@ MoveFileFoundCallback(
         }
     }
 
+    //
+    //  Moves to a different volume are recorded and performed together
+    //  once all arguments are processed.
+    //
+
+    if (MoveIsCrossVolume(FilePath, &FullDest)) {
+        MoveQueueCrossVolume(MoveContext, FilePath, FileInfo, &FullDest);
+        MoveContext->FilesMoved++;
+        YoriLibDereference(FullDest.StartOfString);
+        if (MoveContext->OutOfMemory) {
+            return FALSE;
+        }
+        return TRUE;
+    }
+
     LastError = YoriLibMoveFile(FilePath, &FullDest, MoveContext->ReplaceExisting, MoveContext->PosixSemantics);
     if (LastError != ERROR_SUCCESS) {
         LPTSTR ErrText = YoriLibGetWinErrorText(LastError);
@@ -282,10 +1166,12 @@ ENTRYPOINT(
     BOOLEAN AllocatedDest;
     BOOLEAN BasicEnumeration;
     YORI_STRING Arg;
+    DWORD Result;
 
     FileCount = 0;
     AllocatedDest = FALSE;
     BasicEnumeration = FALSE;
+    ZeroMemory(&MoveContext, sizeof(MoveContext));
     MoveContext.ReplaceExisting = TRUE;
     MoveContext.PosixSemantics = FALSE;
 
@@ -300,7 +1186,7 @@ ENTRYPOINT(
                 MoveHelp();
                 return EXIT_SUCCESS;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("license")) == 0) {
-                YoriLibDisplayMitLicense(_T("2017-2021"));
+                YoriLibDisplayMitLicense(_T("2017-2026"));
                 return EXIT_SUCCESS;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("b")) == 0) {
                 BasicEnumeration = TRUE;
@@ -369,6 +1255,20 @@ ENTRYPOINT(
         }
     }
 
+    Result = EXIT_SUCCESS;
+    if (MoveContext.EntryCount > 0 || MoveContext.CrossVolumeFailed || MoveContext.OutOfMemory) {
+        if (MoveContext.OutOfMemory) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("move: out of memory\n"));
+            Result = EXIT_FAILURE;
+        } else if (MoveContext.CrossVolumeFailed) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("move: no files were moved to a different volume\n"));
+            Result = EXIT_FAILURE;
+        } else if (!MoveCommitCrossVolume(&MoveContext)) {
+            Result = EXIT_FAILURE;
+        }
+        MoveCleanupCrossVolume(&MoveContext);
+    }
+
     if (AllocatedDest) {
         YoriLibFreeStringContents(&MoveContext.Dest);
     }
@@ -377,7 +1277,7 @@ ENTRYPOINT(
         return EXIT_FAILURE;
     }
 
-    return EXIT_SUCCESS;
+    return Result;
 }
 
 // vim:sw=4:ts=4:et:
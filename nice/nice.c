@@ -38,7 +38,14 @@ CHAR strNiceHelpText[] =
         "\n"
         "Runs a child program at low priority.\n"
         "\n"
-        "NICE [-license] <command>\n";
+        "NICE [-license] [-cpu n] [-io low|verylow] [-mem low|verylow] [-tree]\n"
+        "     <command>\n"
+        "\n"
+        "   -cpu n         Limit the program to n percent of processor time\n"
+        "   -io            Run the program with low or very low I/O priority\n"
+        "   -mem           Run the program with low or very low memory priority\n"
+        "   -tree          Apply I/O and memory priority to each process the program\n"
+        "                    launches, even if it would not inherit them\n";
 
 /**
  Display usage text to the user.
@@ -54,6 +61,65 @@ NiceHelp(VOID)
     return TRUE;
 }
 
+#ifndef YORI_BUILTIN
+/**
+ Wait for a child process to complete.  While waiting, apply I/O and memory
+ priority to each process that is added to its job object, so that limits
+ apply to the entire process tree even if a process would not inherit them.
+
+ @param hPort Handle to a completion port associated with the job object.
+
+ @param ProcessInfo Pointer to information about the child process.
+
+ @param Limits Pointer to the limits to apply.
+ */
+VOID
+NiceWaitForProcessTree(
+    __in HANDLE hPort,
+    __in PPROCESS_INFORMATION ProcessInfo,
+    __in PYORI_LIB_PROCESS_LIMITS Limits
+    )
+{
+    DWORD Message;
+    ULONG_PTR Key;
+    LPOVERLAPPED Overlapped;
+    DWORD ProcessId;
+    HANDLE hProcess;
+
+    while (DllKernel32.pGetQueuedCompletionStatus(hPort, &Message, &Key, &Overlapped, INFINITE)) {
+
+        //
+        //  For process notifications, the process ID is supplied in place
+        //  of the overlapped structure.
+        //
+
+        ProcessId = (DWORD)(DWORD_PTR)Overlapped;
+        if (Message == JOB_OBJECT_MSG_NEW_PROCESS) {
+            if (ProcessId != ProcessInfo->dwProcessId) {
+                hProcess = OpenProcess(PROCESS_SET_INFORMATION, FALSE, ProcessId);
+                if (hProcess != NULL) {
+                    if (Limits->IoPriority != YORI_LIB_PRIORITY_UNCHANGED) {
+                        YoriLibSetProcessIoPriority(hProcess, Limits->IoPriority);
+                    }
+                    if (Limits->MemoryPriority != YORI_LIB_PRIORITY_UNCHANGED) {
+                        YoriLibSetProcessMemoryPriority(hProcess, Limits->MemoryPriority);
+                    }
+                    CloseHandle(hProcess);
+                }
+            }
+        } else if (Message == JOB_OBJECT_MSG_EXIT_PROCESS ||
+                   Message == JOB_OBJECT_MSG_ABNORMAL_EXIT_PROCESS) {
+
+            if (ProcessId == ProcessInfo->dwProcessId) {
+                break;
+            }
+        }
+    }
+
+    WaitForSingleObject(ProcessInfo->hProcess, INFINITE);
+}
+#endif
+
 #ifdef YORI_BUILTIN
 /**
  The main entrypoint for the nice builtin command.
@@ -87,7 +153,13 @@ ENTRYPOINT(
     BOOL ArgumentUnderstood;
     YORI_ALLOC_SIZE_T StartArg = 1;
     YORI_ALLOC_SIZE_T i;
+    YORI_ALLOC_SIZE_T ArgsConsumed;
     YORI_STRING Arg;
+    YORI_LIB_PROCESS_LIMITS Limits;
+    BOOLEAN ApplyToTree = FALSE;
+
+    YoriLibInitializeProcessLimits(&Limits);
+    Limits.PriorityClass = IDLE_PRIORITY_CLASS;
 
     for (i = 1; i < ArgC; i++) {
 
@@ -102,6 +174,12 @@ ENTRYPOINT(
             } else if (YoriLibCompareStringLitIns(&Arg, _T("license")) == 0) {
                 YoriLibDisplayMitLicense(_T("2017-2018"));
                 return EXIT_SUCCESS;
+            } else if (YoriLibParseProcessLimitArgument(&Arg, ArgC, ArgV, i, &Limits, &ArgsConsumed)) {
+                i = i + ArgsConsumed;
+                ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("tree")) == 0) {
+                ApplyToTree = TRUE;
+                ArgumentUnderstood = TRUE;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("-")) == 0) {
                 StartArg = i + 1;
                 ArgumentUnderstood = TRUE;
@@ -129,15 +207,34 @@ ENTRYPOINT(
     {
         DWORD OldPriority;
 
+        //
+        //  The shell process cannot be placed in a job object, so processor
+        //  rate limits cannot be applied here.  Other limits are applied to
+        //  the shell while the command executes, and are assumed to have
+        //  been normal beforehand.
+        //
+
+        UNREFERENCED_PARAMETER(ApplyToTree);
+        if (Limits.CpuRate != 0) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("nice: processor rate limits not supported within the shell\n"));
+            Limits.CpuRate = 0;
+        }
+
         OldPriority = GetPriorityClass(GetCurrentProcess());
 
         if (!YoriLibBuildCmdlineFromArgcArgv(ArgC - StartArg, &ArgV[StartArg], TRUE, TRUE, &CmdLine)) {
             return EXIT_FAILURE;
         }
 
-        SetPriorityClass(GetCurrentProcess(), IDLE_PRIORITY_CLASS);
+        YoriLibApplyProcessLimits(GetCurrentProcess(), NULL, &Limits);
         YoriCallExecuteExpression(&CmdLine);
         SetPriorityClass(GetCurrentProcess(), OldPriority);
+        if (Limits.IoPriority != YORI_LIB_PRIORITY_UNCHANGED) {
+            YoriLibSetProcessIoPriority(GetCurrentProcess(), YORI_LIB_IO_PRIORITY_NORMAL);
+        }
+        if (Limits.MemoryPriority != YORI_LIB_PRIORITY_UNCHANGED) {
+            YoriLibSetProcessMemoryPriority(GetCurrentProcess(), YORI_LIB_MEMORY_PRIORITY_NORMAL);
+        }
         YoriLibFreeStringContents(&CmdLine);
 
         ExitCode = YoriCallGetErrorLevel();
@@ -149,6 +246,7 @@ ENTRYPOINT(
         PROCESS_INFORMATION ProcessInfo;
         STARTUPINFO StartupInfo;
         HANDLE hJob;
+        HANDLE hPort;
 
         ChildArgs = YoriLibMalloc((YORI_ALLOC_SIZE_T)((ArgC - StartArg) * sizeof(YORI_STRING)));
         if (ChildArgs == NULL) {
@@ -181,6 +279,22 @@ ENTRYPOINT(
 
         hJob = YoriLibCreateJobObject();
 
+        //
+        //  If limits should be applied to every process in the tree, watch
+        //  for processes being added to the job.  This must be configured
+        //  before the child is added to the job.
+        //
+
+        hPort = NULL;
+        if (hJob != NULL &&
+            ApplyToTree &&
+            DllKernel32.pGetQueuedCompletionStatus != NULL &&
+            (Limits.IoPriority != YORI_LIB_PRIORITY_UNCHANGED ||
+             Limits.MemoryPriority != YORI_LIB_PRIORITY_UNCHANGED)) {
+
+            hPort = YoriLibCreateJobObjectCompletionPort(hJob);
+        }
+
         memset(&StartupInfo, 0, sizeof(StartupInfo));
         StartupInfo.cb = sizeof(StartupInfo);
 
@@ -192,16 +306,37 @@ ENTRYPOINT(
             YoriLibFree(ChildArgs);
             YoriLibFreeStringContents(&CmdLine);
             YoriLibFreeStringContents(&Executable);
+            if (hPort != NULL) {
+                CloseHandle(hPort);
+            }
+            if (hJob != NULL) {
+                CloseHandle(hJob);
+            }
             return EXIT_FAILURE;
         }
 
-        if (hJob != NULL) {
-            YoriLibAssignProcessToJobObject(hJob, ProcessInfo.hProcess);
-            YoriLibLimitJobObjectPriority(hJob, IDLE_PRIORITY_CLASS);
+        if (hJob != NULL &&
+            !YoriLibAssignProcessToJobObject(hJob, ProcessInfo.hProcess)) {
+
+            CloseHandle(hJob);
+            hJob = NULL;
+            if (hPort != NULL) {
+                CloseHandle(hPort);
+                hPort = NULL;
+            }
+        }
+
+        if (!YoriLibApplyProcessLimits(ProcessInfo.hProcess, hJob, &Limits)) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("nice: some limits are not supported on this system\n"));
         }
 
         ResumeThread(ProcessInfo.hThread);
-        WaitForSingleObject(ProcessInfo.hProcess, INFINITE);
+        if (hPort != NULL) {
+            NiceWaitForProcessTree(hPort, &ProcessInfo, &Limits);
+            CloseHandle(hPort);
+        } else {
+            WaitForSingleObject(ProcessInfo.hProcess, INFINITE);
+        }
         GetExitCodeProcess(ProcessInfo.hProcess, &ExitCode);
         CloseHandle(ProcessInfo.hProcess);
         CloseHandle(ProcessInfo.hThread);
@@ -35,9 +35,10 @@ CHAR strObjDirHelpText[] =
         "\n"
         "Enumerate the contents of the object manager.\n"
         "\n"
-        "OBJDIR [-license] [-m] [<spec>...]\n"
+        "OBJDIR [-license] [-m] [-s] [<spec>...]\n"
         "\n"
-        "   -m             Minimal display, file names only\n";
+        "   -m             Minimal display, file names only\n"
+        "   -s             Recurse into child directories\n";
 
 /**
  Display usage text to the user.
@@ -63,6 +64,18 @@ typedef struct _OBJDIR_CONTEXT {
      */
     BOOLEAN MinimalDisplay;
 
+    /**
+     TRUE if child directories should be enumerated.
+     */
+    BOOLEAN Recursive;
+
+    /**
+     The directory whose header was most recently displayed.  When
+     enumerating recursively, a new header is displayed whenever an object
+     is found in a different directory.
+     */
+    YORI_STRING CurrentDirectory;
+
     /**
      Records the total number of objects processed.
      */
@@ -116,6 +129,73 @@ ObjDirOutputBeginningOfDirectorySummary(
     return TRUE;
 }
 
+/**
+ Return the parent directory of an object, without any trailing separator
+ unless the parent is the root.
+
+ @param FullPath Pointer to the full path of the object.
+
+ @param NameOnly Pointer to the final component of the object's path.
+
+ @param Parent On successful completion, updated to point to the parent
+        component of FullPath.  This does not allocate memory.
+ */
+VOID
+ObjDirGetParentDirectory(
+    __in PCYORI_STRING FullPath,
+    __in PCYORI_STRING NameOnly,
+    __out PYORI_STRING Parent
+    )
+{
+    YoriLibInitEmptyString(Parent);
+    Parent->StartOfString = FullPath->StartOfString;
+    Parent->LengthInChars = FullPath->LengthInChars - NameOnly->LengthInChars;
+    if (Parent->LengthInChars > 1 &&
+        YoriLibIsSep(Parent->StartOfString[Parent->LengthInChars - 1])) {
+
+        Parent->LengthInChars--;
+    }
+}
+
+/**
+ Display a directory header if the object being displayed is in a different
+ directory to the previous object.
+
+ @param ObjDirContext Pointer to the context for the application, which
+        records the directory whose header was most recently displayed.
+
+ @param Directory Pointer to the directory containing the object about to
+        be displayed.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+ObjDirUpdateCurrentDirectory(
+    __inout POBJDIR_CONTEXT ObjDirContext,
+    __in PCYORI_STRING Directory
+    )
+{
+    if (YoriLibCompareStringIns(&ObjDirContext->CurrentDirectory, Directory) == 0) {
+        return TRUE;
+    }
+
+    if (ObjDirContext->CurrentDirectory.LengthAllocated <= Directory->LengthInChars) {
+        YoriLibFreeStringContents(&ObjDirContext->CurrentDirectory);
+        if (!YoriLibAllocateString(&ObjDirContext->CurrentDirectory, Directory->LengthInChars + 100)) {
+            return FALSE;
+        }
+    }
+
+    memcpy(ObjDirContext->CurrentDirectory.StartOfString, Directory->StartOfString, Directory->LengthInChars * sizeof(TCHAR));
+    ObjDirContext->CurrentDirectory.LengthInChars = Directory->LengthInChars;
+    ObjDirContext->CurrentDirectory.StartOfString[Directory->LengthInChars] = '\0';
+
+    if (!ObjDirContext->MinimalDisplay) {
+        ObjDirOutputBeginningOfDirectorySummary(&ObjDirContext->CurrentDirectory);
+    }
+    return TRUE;
+}
+
 /**
  After displaying the contents of a directory, this function displays any
  directory level footer information.
@@ -269,9 +349,19 @@ ObjDirFileFoundCallback(
     YoriLibInitEmptyString(&TypeString);
     YoriLibInitEmptyString(&ReparseString);
 
+    if (ObjDirContext->Recursive) {
+        YORI_STRING Parent;
+        ObjDirGetParentDirectory(FullPath, NameOnly, &Parent);
+        ObjDirUpdateCurrentDirectory(ObjDirContext, &Parent);
+    }
+
     if (ObjDirContext->MinimalDisplay) {
 
-        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y\n"), NameOnly);
+        if (ObjDirContext->Recursive) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y\n"), FullPath);
+        } else {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y\n"), NameOnly);
+        }
 
     } else {
 
@@ -352,8 +442,16 @@ ObjDirFileEnumerateErrorCallback(
 {
     BOOL Result = FALSE;
     LPTSTR ErrText;
+    POBJDIR_CONTEXT ObjDirContext = (POBJDIR_CONTEXT)Context;
+
+    //
+    //  When recursing, many directories can only be opened by privileged
+    //  users.  Report these and keep going with the rest of the tree.
+    //
 
-    UNREFERENCED_PARAMETER(Context);
+    if (ObjDirContext->Recursive) {
+        Result = TRUE;
+    }
 
     ErrText = YoriLibGetNtErrorText(NtStatus);
     YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Enumerate of %y failed: %08x %s"), FullName, NtStatus, ErrText);
@@ -395,8 +493,10 @@ ENTRYPOINT(
     YORI_ALLOC_SIZE_T StartArg = 0;
     OBJDIR_CONTEXT ObjDirContext;
     YORI_STRING Arg;
+    DWORD MatchFlags;
 
     ZeroMemory(&ObjDirContext, sizeof(ObjDirContext));
+    YoriLibInitEmptyString(&ObjDirContext.CurrentDirectory);
 
     for (i = 1; i < ArgC; i++) {
 
@@ -414,6 +514,9 @@ ENTRYPOINT(
             } else if (YoriLibCompareStringLitIns(&Arg, _T("m")) == 0) {
                 ObjDirContext.MinimalDisplay = TRUE;
                 ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("s")) == 0) {
+                ObjDirContext.Recursive = TRUE;
+                ArgumentUnderstood = TRUE;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("-")) == 0) {
                 ArgumentUnderstood = TRUE;
                 StartArg = i + 1;
@@ -434,24 +537,44 @@ ENTRYPOINT(
     YoriLibCancelEnable(FALSE);
 #endif
 
+    MatchFlags = 0;
+    if (ObjDirContext.Recursive) {
+        MatchFlags = YORILIB_OBJENUM_RECURSE_AFTER_RETURN;
+    }
+
     if (StartArg == 0 || StartArg == ArgC) {
         YORI_STRING FilesInDirectorySpec;
         YoriLibConstantString(&FilesInDirectorySpec, _T("\\"));
-        if (!ObjDirContext.MinimalDisplay) {
-            ObjDirOutputBeginningOfDirectorySummary(&FilesInDirectorySpec);
-        }
+        ObjDirUpdateCurrentDirectory(&ObjDirContext, &FilesInDirectorySpec);
         YoriLibForEachObjectEnum(&FilesInDirectorySpec,
-                                 0,
+                                 MatchFlags,
                                  ObjDirFileFoundCallback,
                                  ObjDirFileEnumerateErrorCallback,
                                  &ObjDirContext);
     } else {
         for (i = StartArg; i < ArgC; i++) {
-            if (!ObjDirContext.MinimalDisplay) {
-                ObjDirOutputBeginningOfDirectorySummary(&ArgV[i]);
+            YORI_STRING Spec;
+
+            //
+            //  Objects found when recursing are compared against their
+            //  parent without a trailing separator, so display the header
+            //  for the top level directory the same way.
+            //
+
+            YoriLibInitEmptyString(&Spec);
+            Spec.StartOfString = ArgV[i].StartOfString;
+            Spec.LengthInChars = ArgV[i].LengthInChars;
+            if (ObjDirContext.Recursive &&
+                Spec.LengthInChars > 1 &&
+                YoriLibIsSep(Spec.StartOfString[Spec.LengthInChars - 1])) {
+
+                Spec.LengthInChars--;
             }
+
+            YoriLibFreeStringContents(&ObjDirContext.CurrentDirectory);
+            ObjDirUpdateCurrentDirectory(&ObjDirContext, &Spec);
             YoriLibForEachObjectEnum(&ArgV[i],
-                                     0,
+                                     MatchFlags,
                                      ObjDirFileFoundCallback,
                                      ObjDirFileEnumerateErrorCallback,
                                      &ObjDirContext);
@@ -466,6 +589,8 @@ ENTRYPOINT(
         YoriLibFree(ObjDirContext.SymbolicLinkBuffer);
     }
 
+    YoriLibFreeStringContents(&ObjDirContext.CurrentDirectory);
+
     if (ObjDirContext.ObjectsFound == 0 && ObjDirContext.DirsFound == 0) {
         YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("objdir: no objects found\n"));
         return EXIT_FAILURE;
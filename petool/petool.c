@@ -3,7 +3,7 @@
  *
  * Yori shell PE tool for manipulating PE files
  *
- * Copyright (c) 2021-2022 Malcolm J. Smith
+ * Copyright (c) 2021-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -36,13 +36,15 @@ CHAR strPeToolHelpText[] =
         "Manage PE files.\n"
         "\n"
         "PETOOL [-license]\n"
-        "PETOOL -c file\n"
-        "PETOOL -cu file\n"
+        "PETOOL [-b] [-s] -c <file>...\n"
+        "PETOOL [-b] [-s] -cu <file>...\n"
         "PETOOL -os file version\n"
         "\n"
-        "   -c             Calculate the PE checksum for a binary\n"
+        "   -b             Use basic search criteria for files only\n"
+        "   -c             Calculate the PE checksum for binaries\n"
         "   -cu            Update the checksum in the PE header from contents\n"
-        "   -os            Set the minimum OS version and update checksum\n";
+        "   -os            Set the minimum OS version and update checksum\n"
+        "   -s             Process files from all subdirectories\n";
 
 /**
  Display usage text to the user.
@@ -375,99 +377,340 @@ PeToolWriteSubsystemVersionToFile(
 
 
 /**
- Calculate and display the checksum for a specified file.
+ Information about a single file whose checksum is being calculated.
+ */
+typedef struct _PETOOL_CHECKSUM_ENTRY {
 
- @param FileName Pointer to the file name to calculate a checksum for.
+    /**
+     The full path to the file.
+     */
+    YORI_STRING FullPath;
 
- @return TRUE to indicate success, FALSE to indicate failure.
- */
-BOOLEAN
-PeToolCalculateChecksum(
-    __in PYORI_STRING FileName
-    )
-{
-    DWORD Err;
+    /**
+     The checksum currently recorded in the PE header.
+     */
     DWORD HeaderChecksum;
+
+    /**
+     The checksum calculated from the contents of the file.
+     */
     DWORD DataChecksum;
-    YORI_STRING FullPath;
 
-    YoriLibLoadImageHlpFunctions();
+    /**
+     A Win32 error code describing the result of processing the file.
+     */
+    DWORD Err;
+} PETOOL_CHECKSUM_ENTRY, *PPETOOL_CHECKSUM_ENTRY;
 
-    if (DllImageHlp.pMapFileAndCheckSumW == NULL) {
-        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("petool: OS support not present\n"));
-        return FALSE;
+/**
+ Context describing a set of files whose checksums are being calculated.
+ */
+typedef struct _PETOOL_CHECKSUM_CONTEXT {
+
+    /**
+     An array of files found while enumerating the user's arguments.
+     */
+    PPETOOL_CHECKSUM_ENTRY Entries;
+
+    /**
+     The number of elements in Entries that are populated.
+     */
+    DWORD EntryCount;
+
+    /**
+     The number of elements allocated in Entries.
+     */
+    DWORD EntriesAllocated;
+
+    /**
+     TRUE if the checksum in the PE header should be updated to match the
+     file contents.
+     */
+    BOOLEAN Update;
+
+    /**
+     TRUE if files are being enumerated recursively.
+     */
+    BOOLEAN Recursive;
+
+    /**
+     TRUE if a file could not be recorded because memory could not be
+     allocated.
+     */
+    BOOLEAN OutOfMemory;
+} PETOOL_CHECKSUM_CONTEXT, *PPETOOL_CHECKSUM_CONTEXT;
+
+/**
+ A callback that is invoked when a file is found that matches a search
+ criteria specified in the set of strings to enumerate.  The file is
+ recorded so its checksum can be calculated once enumeration is complete.
+
+ @param FilePath Pointer to the file path that was found.
+
+ @param FileInfo Information about the file.
+
+ @param Depth Specifies recursion depth.  Ignored in this application.
+
+ @param Context Pointer to the checksum context.
+
+ @return TRUE to continue enumerating, FALSE to abort.
+ */
+BOOL
+PeToolChecksumFileFoundCallback(
+    __in PYORI_STRING FilePath,
+    __in PWIN32_FIND_DATA FileInfo,
+    __in DWORD Depth,
+    __in PVOID Context
+    )
+{
+    PPETOOL_CHECKSUM_CONTEXT ChecksumContext = (PPETOOL_CHECKSUM_CONTEXT)Context;
+    PPETOOL_CHECKSUM_ENTRY NewEntries;
+    PPETOOL_CHECKSUM_ENTRY Entry;
+    DWORD NewAllocated;
+
+    UNREFERENCED_PARAMETER(FileInfo);
+    UNREFERENCED_PARAMETER(Depth);
+
+    if (ChecksumContext->EntryCount >= ChecksumContext->EntriesAllocated) {
+        NewAllocated = ChecksumContext->EntriesAllocated * 2;
+        if (NewAllocated < 64) {
+            NewAllocated = 64;
+        }
+        if (!YoriLibIsSizeAllocatable(NewAllocated * sizeof(PETOOL_CHECKSUM_ENTRY))) {
+            ChecksumContext->OutOfMemory = TRUE;
+            return FALSE;
+        }
+        NewEntries = YoriLibMalloc((YORI_ALLOC_SIZE_T)(NewAllocated * sizeof(PETOOL_CHECKSUM_ENTRY)));
+        if (NewEntries == NULL) {
+            ChecksumContext->OutOfMemory = TRUE;
+            return FALSE;
+        }
+        if (ChecksumContext->Entries != NULL) {
+            memcpy(NewEntries, ChecksumContext->Entries, ChecksumContext->EntryCount * sizeof(PETOOL_CHECKSUM_ENTRY));
+            YoriLibFree(ChecksumContext->Entries);
+        }
+        ChecksumContext->Entries = NewEntries;
+        ChecksumContext->EntriesAllocated = NewAllocated;
     }
 
-    YoriLibInitEmptyString(&FullPath);
-    if (!YoriLibUserStringToSingleFilePath(FileName, TRUE, &FullPath)) {
+    Entry = &ChecksumContext->Entries[ChecksumContext->EntryCount];
+    if (!YoriLibCopyString(&Entry->FullPath, FilePath)) {
+        ChecksumContext->OutOfMemory = TRUE;
         return FALSE;
     }
+    Entry->HeaderChecksum = 0;
+    Entry->DataChecksum = 0;
+    Entry->Err = ERROR_SUCCESS;
+    ChecksumContext->EntryCount++;
 
-    Err = DllImageHlp.pMapFileAndCheckSumW(FullPath.StartOfString, &HeaderChecksum, &DataChecksum);
-    if (Err != 0) {
-        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Open of source failed: %y\n"), FileName);
-        YoriLibFreeStringContents(&FullPath);
-        return FALSE;
+    return TRUE;
+}
+
+/**
+ A callback that is invoked when a directory cannot be successfully
+ enumerated.
+
+ @param FilePath Pointer to the file path that could not be enumerated.
+
+ @param ErrorCode The Win32 error code describing the failure.
+
+ @param Depth Recursion depth, ignored in this application.
+
+ @param Context Pointer to the checksum context.
+
+ @return TRUE to continue enumerating, FALSE to abort.
+ */
+BOOL
+PeToolChecksumFileEnumerateErrorCallback(
+    __in PYORI_STRING FilePath,
+    __in DWORD ErrorCode,
+    __in DWORD Depth,
+    __in PVOID Context
+    )
+{
+    YORI_STRING UnescapedFilePath;
+    BOOL Result = FALSE;
+    PPETOOL_CHECKSUM_CONTEXT ChecksumContext = (PPETOOL_CHECKSUM_CONTEXT)Context;
+
+    UNREFERENCED_PARAMETER(Depth);
+
+    YoriLibInitEmptyString(&UnescapedFilePath);
+    if (!YoriLibUnescapePath(FilePath, &UnescapedFilePath)) {
+        UnescapedFilePath.StartOfString = FilePath->StartOfString;
+        UnescapedFilePath.LengthInChars = FilePath->LengthInChars;
     }
 
-    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("Checksum in PE header: %08x\n")
-                                          _T("Checksum of file contents: %08x\n"),
-                                          HeaderChecksum,
-                                          DataChecksum);
+    if (ErrorCode == ERROR_FILE_NOT_FOUND || ErrorCode == ERROR_PATH_NOT_FOUND) {
+        if (!ChecksumContext->Recursive) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("File or directory not found: %y\n"), &UnescapedFilePath);
+        }
+        Result = TRUE;
+    } else {
+        LPTSTR ErrText = YoriLibGetWinErrorText(ErrorCode);
+        YORI_STRING DirName;
+        LPTSTR FilePart;
+        YoriLibInitEmptyString(&DirName);
+        DirName.StartOfString = UnescapedFilePath.StartOfString;
+        FilePart = YoriLibFindRightMostCharacter(&UnescapedFilePath, '\\');
+        if (FilePart != NULL) {
+            DirName.LengthInChars = (YORI_ALLOC_SIZE_T)(FilePart - DirName.StartOfString);
+        } else {
+            DirName.LengthInChars = UnescapedFilePath.LengthInChars;
+        }
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Enumerate of %y failed: %s"), &DirName, ErrText);
+        YoriLibFreeWinErrorText(ErrText);
+    }
+    YoriLibFreeStringContents(&UnescapedFilePath);
+    return Result;
+}
 
-    YoriLibFreeStringContents(&FullPath);
-    return TRUE;
+/**
+ Calculate the checksum for a single file, and optionally update the PE
+ header.  Each file has its own entry, so this can be invoked on multiple
+ threads concurrently without further synchronization.
+
+ @param Context Pointer to the checksum context.
+
+ @param Index The index of the entry to process.
+ */
+VOID
+PeToolChecksumEntry(
+    __in PVOID Context,
+    __in DWORD Index
+    )
+{
+    PPETOOL_CHECKSUM_CONTEXT ChecksumContext;
+    PPETOOL_CHECKSUM_ENTRY Entry;
+
+    ChecksumContext = (PPETOOL_CHECKSUM_CONTEXT)Context;
+
+    Entry = &ChecksumContext->Entries[Index];
+    Entry->Err = YoriLibPeChecksumFile(&Entry->FullPath, &Entry->HeaderChecksum, &Entry->DataChecksum);
+    if (Entry->Err == ERROR_SUCCESS &&
+        ChecksumContext->Update &&
+        Entry->HeaderChecksum != Entry->DataChecksum) {
+
+        Entry->Err = PeToolWriteChecksumToFile(&Entry->FullPath, Entry->DataChecksum);
+    }
 }
 
 /**
- Generate the checksum for a binary and update the header.
+ Calculate checksums for all files found in the checksum context.  Files
+ are processed by a pool of threads since each file is independent.
 
- @param FileName Pointer to the file name to generate a checksum for.
+ @param ChecksumContext Pointer to the checksum context.
+ */
+VOID
+PeToolProcessChecksums(
+    __inout PPETOOL_CHECKSUM_CONTEXT ChecksumContext
+    )
+{
+    WORD PerformanceProcessors;
+    WORD EfficiencyProcessors;
+
+    YoriLibQueryCpuCount(&PerformanceProcessors, &EfficiencyProcessors);
+    YoriLibProcessItemsInParallel(ChecksumContext->EntryCount,
+                                  PerformanceProcessors + EfficiencyProcessors,
+                                  PeToolChecksumEntry,
+                                  ChecksumContext);
+}
+
+/**
+ Calculate and display the checksum for a set of files, and optionally
+ update the checksum in the PE header.
+
+ @param ArgC The number of file specifications.
+
+ @param ArgV An array of file specifications, which may contain wildcards.
+
+ @param Update TRUE if the checksum in the PE header should be updated to
+        match the file contents.
+
+ @param MatchFlags Flags to use when enumerating files.
 
  @return TRUE to indicate success, FALSE to indicate failure.
  */
 BOOLEAN
-PeToolUpdateChecksum(
-    __in PYORI_STRING FileName
+PeToolChecksumFiles(
+    __in YORI_ALLOC_SIZE_T ArgC,
+    __in YORI_STRING ArgV[],
+    __in BOOLEAN Update,
+    __in WORD MatchFlags
     )
 {
-    DWORD Err;
-    DWORD HeaderChecksum;
-    DWORD DataChecksum;
-    YORI_STRING FullPath;
-
-    YoriLibLoadImageHlpFunctions();
-
-    if (DllImageHlp.pMapFileAndCheckSumW == NULL) {
-        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("petool: OS support not present\n"));
-        return FALSE;
+    PETOOL_CHECKSUM_CONTEXT ChecksumContext;
+    PPETOOL_CHECKSUM_ENTRY Entry;
+    YORI_ALLOC_SIZE_T ArgIndex;
+    DWORD Index;
+    BOOLEAN SingleFile;
+    BOOLEAN Result;
+    LPTSTR ErrText;
+
+    ZeroMemory(&ChecksumContext, sizeof(ChecksumContext));
+    ChecksumContext.Update = Update;
+    if (MatchFlags & YORILIB_FILEENUM_RECURSE_BEFORE_RETURN) {
+        ChecksumContext.Recursive = TRUE;
     }
 
-    YoriLibInitEmptyString(&FullPath);
-    if (!YoriLibUserStringToSingleFilePath(FileName, TRUE, &FullPath)) {
-        return FALSE;
+    for (ArgIndex = 0; ArgIndex < ArgC; ArgIndex++) {
+        YoriLibForEachFile(&ArgV[ArgIndex], MatchFlags, 0, PeToolChecksumFileFoundCallback, PeToolChecksumFileEnumerateErrorCallback, &ChecksumContext);
+        if (ChecksumContext.OutOfMemory) {
+            break;
+        }
     }
 
-    Err = DllImageHlp.pMapFileAndCheckSumW(FullPath.StartOfString, &HeaderChecksum, &DataChecksum);
-    if (Err != 0) {
-        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Open of source failed: %y\n"), FileName);
-        YoriLibFreeStringContents(&FullPath);
-        return FALSE;
+    Result = TRUE;
+    if (ChecksumContext.OutOfMemory) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("petool: out of memory\n"));
+        Result = FALSE;
+    } else if (ChecksumContext.EntryCount == 0) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("petool: no matching files found\n"));
+        Result = FALSE;
+    } else {
+        PeToolProcessChecksums(&ChecksumContext);
     }
 
-    ASSERT(YoriLibIsStringNullTerminated(&FullPath));
+    //
+    //  A single file displays its checksums in the same form as previous
+    //  versions.  Multiple files display one line per file, in the order
+    //  they were found.
+    //
 
-    Err = PeToolWriteChecksumToFile(&FullPath, DataChecksum);
-    if (Err != ERROR_SUCCESS) {
-        LPTSTR ErrText;
-        ErrText = YoriLibGetWinErrorText(Err);
-        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Open of file failed: %y: %s"), &FullPath, ErrText);
-        YoriLibFreeWinErrorText(ErrText);
+    SingleFile = FALSE;
+    if (ArgC == 1 &&
+        ChecksumContext.EntryCount == 1 &&
+        !ChecksumContext.Recursive) {
+
+        SingleFile = TRUE;
     }
 
-    YoriLibFreeStringContents(&FullPath);
+    for (Index = 0; Index < ChecksumContext.EntryCount; Index++) {
+        Entry = &ChecksumContext.Entries[Index];
+        if (!ChecksumContext.OutOfMemory) {
+            if (Entry->Err != ERROR_SUCCESS) {
+                ErrText = YoriLibGetWinErrorText(Entry->Err);
+                YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Open of file failed: %y: %s"), &Entry->FullPath, ErrText);
+                YoriLibFreeWinErrorText(ErrText);
+                Result = FALSE;
+            } else if (!Update) {
+                if (SingleFile) {
+                    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("Checksum in PE header: %08x\n")
+                                                          _T("Checksum of file contents: %08x\n"),
+                                                          Entry->HeaderChecksum,
+                                                          Entry->DataChecksum);
+                } else {
+                    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%08x %08x %y\n"), Entry->HeaderChecksum, Entry->DataChecksum, &Entry->FullPath);
+                }
+            }
+        }
+        YoriLibFreeStringContents(&Entry->FullPath);
+    }
 
-    return TRUE;
+    if (ChecksumContext.Entries != NULL) {
+        YoriLibFree(ChecksumContext.Entries);
+    }
+
+    return Result;
 }
 
 /**
@@ -495,13 +738,6 @@ PeToolUpdateSubsystemVersion(
     WORD MajorVersion;
     WORD MinorVersion;
 
-    YoriLibLoadImageHlpFunctions();
-
-    if (DllImageHlp.pMapFileAndCheckSumW == NULL) {
-        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("petool: OS support not present\n"));
-        return FALSE;
-    }
-
     YoriLibInitEmptyString(&FullPath);
     if (!YoriLibUserStringToSingleFilePath(FileName, TRUE, &FullPath)) {
         return FALSE;
@@ -539,8 +775,8 @@ PeToolUpdateSubsystemVersion(
         return FALSE;
     }
 
-    Err = DllImageHlp.pMapFileAndCheckSumW(FullPath.StartOfString, &HeaderChecksum, &DataChecksum);
-    if (Err != 0) {
+    Err = YoriLibPeChecksumFile(&FullPath, &HeaderChecksum, &DataChecksum);
+    if (Err != ERROR_SUCCESS) {
         YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Open of source failed: %y\n"), FileName);
         YoriLibFreeStringContents(&FullPath);
         return FALSE;
@@ -609,8 +845,12 @@ ENTRYPOINT(
     PYORI_STRING NewSubsystemVersion = NULL;
     PETOOL_OP Op;
     DWORD Result;
+    BOOLEAN Recursive = FALSE;
+    BOOLEAN BasicEnumeration = FALSE;
+    WORD MatchFlags;
 
     Op = PeToolOpNone;
+    StartArg = 0;
 
     for (i = 1; i < ArgC; i++) {
 
@@ -623,20 +863,24 @@ ENTRYPOINT(
                 PeToolHelp();
                 return EXIT_SUCCESS;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("license")) == 0) {
-                YoriLibDisplayMitLicense(_T("2021"));
+                YoriLibDisplayMitLicense(_T("2021-2026"));
                 return EXIT_SUCCESS;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("b")) == 0) {
+                BasicEnumeration = TRUE;
+                ArgumentUnderstood = TRUE;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("c")) == 0) {
                 if (ArgC > i + 1) {
-                    FileName = &ArgV[i + 1];
                     Op = PeToolOpCalculateChecksum;
                     ArgumentUnderstood = TRUE;
                 }
             } else if (YoriLibCompareStringLitIns(&Arg, _T("cu")) == 0) {
                 if (ArgC > i + 1) {
-                    FileName = &ArgV[i + 1];
                     Op = PeToolOpUpdateChecksum;
                     ArgumentUnderstood = TRUE;
                 }
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("s")) == 0) {
+                Recursive = TRUE;
+                ArgumentUnderstood = TRUE;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("os")) == 0) {
                 if (ArgC > i + 2) {
                     FileName = &ArgV[i + 1];
@@ -663,14 +907,22 @@ ENTRYPOINT(
 
     Result = EXIT_SUCCESS;
 
+    MatchFlags = YORILIB_FILEENUM_RETURN_FILES;
+    if (Recursive) {
+        MatchFlags |= YORILIB_FILEENUM_RECURSE_BEFORE_RETURN | YORILIB_FILEENUM_RECURSE_PRESERVE_WILD;
+    }
+    if (BasicEnumeration) {
+        MatchFlags |= YORILIB_FILEENUM_BASIC_EXPANSION;
+    }
+
     switch(Op) {
         case PeToolOpCalculateChecksum:
-            if (!PeToolCalculateChecksum(FileName)) {
-                Result = EXIT_FAILURE;
-            }
-            break;
         case PeToolOpUpdateChecksum:
-            if (!PeToolUpdateChecksum(FileName)) {
+            if (StartArg == 0 || StartArg >= ArgC) {
+                YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("petool: missing argument\n"));
+                return EXIT_FAILURE;
+            }
+            if (!PeToolChecksumFiles(ArgC - StartArg, &ArgV[StartArg], (BOOLEAN)(Op == PeToolOpUpdateChecksum), MatchFlags)) {
                 Result = EXIT_FAILURE;
             }
             break;
@@ -46,7 +46,7 @@ YoriPkgUpgradeInstalledPackages(
     __in_opt PYORI_STRING NewArchitecture
     )
 {
-    YORI_STRING PkgIniFile;
+    YORI_LIB_INI PkgIni;
     YORI_STRING InstalledSection;
     LPTSTR ThisLine;
     LPTSTR Equals;
@@ -58,43 +58,38 @@ YoriPkgUpgradeInstalledPackages(
     DWORD Error;
     BOOL Result;
     BOOL UpgradeThisPackage;
+    BOOL Queued;
     YORIPKG_PACKAGES_PENDING_INSTALL PendingPackages;
-
-    if (DllKernel32.pGetPrivateProfileIntW == NULL ||
-        DllKernel32.pGetPrivateProfileSectionW == NULL ||
-        DllKernel32.pGetPrivateProfileStringW == NULL ||
-        DllKernel32.pWritePrivateProfileStringW == NULL) {
-
-        return FALSE;
-    }
+    PYORI_LIST_ENTRY ListEntry;
+    PYORIPKG_DOWNLOAD Download;
 
     if (!YoriPkgInitializePendingPackages(&PendingPackages)) {
         return FALSE;
     }
 
-    if (!YoriPkgGetPackageIniFile(NULL, &PkgIniFile)) {
+    if (!YoriPkgLoadPackageIni(NULL, &PkgIni)) {
         YoriPkgDeletePendingPackages(&PendingPackages);
         return FALSE;
     }
 
     if (!YoriLibAllocateString(&InstalledSection, YORIPKG_MAX_SECTION_LENGTH)) {
         YoriPkgDeletePendingPackages(&PendingPackages);
-        YoriLibFreeStringContents(&PkgIniFile);
+        YoriLibIniCleanup(&PkgIni);
         return FALSE;
     }
 
     if (!YoriLibAllocateString(&UpgradePath, YORIPKG_MAX_FIELD_LENGTH)) {
         YoriPkgDeletePendingPackages(&PendingPackages);
         YoriLibFreeStringContents(&InstalledSection);
-        YoriLibFreeStringContents(&PkgIniFile);
+        YoriLibIniCleanup(&PkgIni);
         return FALSE;
     }
 
     InstalledSection.LengthInChars = (YORI_ALLOC_SIZE_T)
-        DllKernel32.pGetPrivateProfileSectionW(_T("Installed"),
-                                               InstalledSection.StartOfString,
-                                               InstalledSection.LengthAllocated,
-                                               PkgIniFile.StartOfString);
+        YoriLibIniGetSection(&PkgIni,
+                             _T("Installed"),
+                             InstalledSection.StartOfString,
+                             InstalledSection.LengthAllocated);
 
     YoriLibInitEmptyString(&PkgNameOnly);
     ThisLine = InstalledSection.StartOfString;
@@ -116,52 +111,58 @@ YoriPkgUpgradeInstalledPackages(
         UpgradePath.LengthInChars = 0;
         if (Prefer == YoriPkgUpgradePreferStable) {
             UpgradePath.LengthInChars = (YORI_ALLOC_SIZE_T)
-                DllKernel32.pGetPrivateProfileStringW(PkgNameOnly.StartOfString,
-                                                      _T("UpgradeToStablePath"),
-                                                      _T(""),
-                                                      UpgradePath.StartOfString,
-                                                      UpgradePath.LengthAllocated,
-                                                      PkgIniFile.StartOfString);
+                YoriLibIniGetString(&PkgIni,
+                                    PkgNameOnly.StartOfString,
+                                    _T("UpgradeToStablePath"),
+                                    _T(""),
+                                    UpgradePath.StartOfString,
+                                    UpgradePath.LengthAllocated);
         } else if (Prefer == YoriPkgUpgradePreferDaily) {
             UpgradePath.LengthInChars = (YORI_ALLOC_SIZE_T)
-                DllKernel32.pGetPrivateProfileStringW(PkgNameOnly.StartOfString,
-                                                      _T("UpgradeToDailyPath"),
-                                                      _T(""),
-                                                      UpgradePath.StartOfString,
-                                                      UpgradePath.LengthAllocated,
-                                                      PkgIniFile.StartOfString);
+                YoriLibIniGetString(&PkgIni,
+                                    PkgNameOnly.StartOfString,
+                                    _T("UpgradeToDailyPath"),
+                                    _T(""),
+                                    UpgradePath.StartOfString,
+                                    UpgradePath.LengthAllocated);
         }
 
         if (UpgradePath.LengthInChars == 0) {
             UpgradePath.LengthInChars = (YORI_ALLOC_SIZE_T)
-                DllKernel32.pGetPrivateProfileStringW(PkgNameOnly.StartOfString,
-                                                      _T("UpgradePath"),
-                                                      _T(""),
-                                                      UpgradePath.StartOfString,
-                                                      UpgradePath.LengthAllocated,
-                                                      PkgIniFile.StartOfString);
+                YoriLibIniGetString(&PkgIni,
+                                    PkgNameOnly.StartOfString,
+                                    _T("UpgradePath"),
+                                    _T(""),
+                                    UpgradePath.StartOfString,
+                                    UpgradePath.LengthAllocated);
         }
         if (UpgradePath.LengthInChars > 0) {
             UpgradeThisPackage = TRUE;
             YoriLibInitEmptyString(&RedirectedPath);
             if (NewArchitecture != NULL) {
-                YoriPkgBuildUpgradeLocationForNewArchitecture(&PkgNameOnly, NewArchitecture, &PkgIniFile, &UpgradePath);
+                YoriPkgBuildUpgradeLocationForNewArchitecture(&PkgNameOnly, NewArchitecture, &PkgIni, &UpgradePath);
             } else {
-                if (!YoriPkgIsNewerVersionAvailable(&PendingPackages, &PkgIniFile, &UpgradePath, &InstalledVersion, &RedirectedPath)) {
+                if (!YoriPkgIsNewerVersionAvailable(&PendingPackages, &PkgIni.FileName, &UpgradePath, &InstalledVersion, &RedirectedPath)) {
                     YoriLibFreeStringContents(&RedirectedPath);
                     YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y version %y is already installed\n"), &PkgNameOnly, &InstalledVersion);
                     UpgradeThisPackage = FALSE;
                 }
             }
             if (UpgradeThisPackage) {
+
+                //
+                //  Queue the package to download.  All packages are
+                //  downloaded together below, then prepared for install.
+                //
+
                 if (RedirectedPath.LengthInChars > 0) {
-                    Error = YoriPkgPreparePackageForInstallRedirectBuild(&PkgIniFile, NULL, &PendingPackages, &RedirectedPath);
+                    Queued = YoriPkgQueueDownload(&PendingPackages.Downloads, &RedirectedPath);
                     YoriLibFreeStringContents(&RedirectedPath);
                 } else {
-                    Error = YoriPkgPreparePackageForInstallRedirectBuild(&PkgIniFile, NULL, &PendingPackages, &UpgradePath);
+                    Queued = YoriPkgQueueDownload(&PendingPackages.Downloads, &UpgradePath);
                 }
-                if (Error != ERROR_SUCCESS) {
-                    YoriPkgDisplayErrorStringForInstallFailure(Error);
+                if (!Queued) {
+                    YoriPkgDisplayErrorStringForInstallFailure(ERROR_NOT_ENOUGH_MEMORY);
                     goto Exit;
                 }
             }
@@ -174,11 +175,25 @@ YoriPkgUpgradeInstalledPackages(
         ThisLine++;
     }
 
+    YoriPkgResolveDownloadsFromCache(&PkgIni.FileName, &PendingPackages);
+    YoriPkgCompleteDownloads(&PendingPackages.Downloads, &PkgIni.FileName);
+
+    ListEntry = YoriLibGetNextListEntry(&PendingPackages.Downloads, NULL);
+    while (ListEntry != NULL) {
+        Download = CONTAINING_RECORD(ListEntry, YORIPKG_DOWNLOAD, ListEntry);
+        Error = YoriPkgPreparePackageForInstallRedirectBuild(&PkgIni, NULL, &PendingPackages, &Download->PackagePath);
+        if (Error != ERROR_SUCCESS) {
+            YoriPkgDisplayErrorStringForInstallFailure(Error);
+            goto Exit;
+        }
+        ListEntry = YoriLibGetNextListEntry(&PendingPackages.Downloads, ListEntry);
+    }
+
     //
     //  Upgrade all packages which specify an upgrade path.
     //
 
-    Result = YoriPkgInstallPendingPackages(&PkgIniFile, NULL, &PendingPackages);
+    Result = YoriPkgInstallPendingPackages(&PkgIni, NULL, &PendingPackages);
 
 Exit:
 
@@ -187,12 +202,12 @@ Exit:
     //
 
     if (!YoriLibIsListEmpty(&PendingPackages.BackupPackages)) {
-        YoriPkgRollbackAndFreeBackupPackageList(&PkgIniFile, NULL, &PendingPackages.BackupPackages);
+        YoriPkgRollbackAndFreeBackupPackageList(&PkgIni, NULL, &PendingPackages.BackupPackages);
     }
 
     YoriPkgDeletePendingPackages(&PendingPackages);
 
-    YoriLibFreeStringContents(&PkgIniFile);
+    YoriLibIniCleanup(&PkgIni);
     YoriLibFreeStringContents(&InstalledSection);
     YoriLibFreeStringContents(&UpgradePath);
 
@@ -219,44 +234,37 @@ YoriPkgUpgradeSinglePackage(
     __in_opt PYORI_STRING NewArchitecture
     )
 {
-    YORI_STRING PkgIniFile;
+    YORI_LIB_INI PkgIni;
     YORI_STRING IniValue;
     BOOL Result;
     DWORD Error;
     YORIPKG_PACKAGES_PENDING_INSTALL PendingPackages;
 
-    if (DllKernel32.pGetPrivateProfileIntW == NULL ||
-        DllKernel32.pGetPrivateProfileStringW == NULL ||
-        DllKernel32.pWritePrivateProfileStringW == NULL) {
-
-        return FALSE;
-    }
-
     if (!YoriPkgInitializePendingPackages(&PendingPackages)) {
         return FALSE;
     }
 
-    if (!YoriPkgGetPackageIniFile(NULL, &PkgIniFile)) {
+    if (!YoriPkgLoadPackageIni(NULL, &PkgIni)) {
         YoriPkgDeletePendingPackages(&PendingPackages);
         return FALSE;
     }
 
     if (!YoriLibAllocateString(&IniValue, YORIPKG_MAX_FIELD_LENGTH)) {
         YoriPkgDeletePendingPackages(&PendingPackages);
-        YoriLibFreeStringContents(&PkgIniFile);
+        YoriLibIniCleanup(&PkgIni);
         return FALSE;
     }
 
     IniValue.LengthInChars = (YORI_ALLOC_SIZE_T)
-        DllKernel32.pGetPrivateProfileStringW(_T("Installed"),
-                                              PackageName->StartOfString,
-                                              _T(""),
-                                              IniValue.StartOfString,
-                                              IniValue.LengthAllocated,
-                                              PkgIniFile.StartOfString);
+        YoriLibIniGetString(&PkgIni,
+                            _T("Installed"),
+                            PackageName->StartOfString,
+                            _T(""),
+                            IniValue.StartOfString,
+                            IniValue.LengthAllocated);
     if (IniValue.LengthInChars == 0) {
         YoriPkgDeletePendingPackages(&PendingPackages);
-        YoriLibFreeStringContents(&PkgIniFile);
+        YoriLibIniCleanup(&PkgIni);
         YoriLibFreeStringContents(&IniValue);
         YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y is not installed\n"), PackageName);
         return FALSE;
@@ -265,61 +273,61 @@ YoriPkgUpgradeSinglePackage(
     IniValue.LengthInChars = 0;
     if (Prefer == YoriPkgUpgradePreferStable) {
         IniValue.LengthInChars = (YORI_ALLOC_SIZE_T)
-            DllKernel32.pGetPrivateProfileStringW(PackageName->StartOfString,
-                                                  _T("UpgradeToStablePath"),
-                                                  _T(""),
-                                                  IniValue.StartOfString,
-                                                  IniValue.LengthAllocated,
-                                                  PkgIniFile.StartOfString);
+            YoriLibIniGetString(&PkgIni,
+                                PackageName->StartOfString,
+                                _T("UpgradeToStablePath"),
+                                _T(""),
+                                IniValue.StartOfString,
+                                IniValue.LengthAllocated);
     } else if (Prefer == YoriPkgUpgradePreferDaily) {
         IniValue.LengthInChars = (YORI_ALLOC_SIZE_T)
-            DllKernel32.pGetPrivateProfileStringW(PackageName->StartOfString,
-                                                  _T("UpgradeToDailyPath"),
-                                                  _T(""),
-                                                  IniValue.StartOfString,
-                                                  IniValue.LengthAllocated,
-                                                  PkgIniFile.StartOfString);
+            YoriLibIniGetString(&PkgIni,
+                                PackageName->StartOfString,
+                                _T("UpgradeToDailyPath"),
+                                _T(""),
+                                IniValue.StartOfString,
+                                IniValue.LengthAllocated);
     }
 
     if (IniValue.LengthInChars == 0) {
         IniValue.LengthInChars = (YORI_ALLOC_SIZE_T)
-            DllKernel32.pGetPrivateProfileStringW(PackageName->StartOfString,
-                                                  _T("UpgradePath"),
-                                                  _T(""),
-                                                  IniValue.StartOfString,
-                                                  IniValue.LengthAllocated,
-                                                  PkgIniFile.StartOfString);
+            YoriLibIniGetString(&PkgIni,
+                                PackageName->StartOfString,
+                                _T("UpgradePath"),
+                                _T(""),
+                                IniValue.StartOfString,
+                                IniValue.LengthAllocated);
     }
 
     if (IniValue.LengthInChars == 0) {
         YoriPkgDeletePendingPackages(&PendingPackages);
-        YoriLibFreeStringContents(&PkgIniFile);
+        YoriLibIniCleanup(&PkgIni);
         YoriLibFreeStringContents(&IniValue);
         YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y does not specify an upgrade path\n"), PackageName);
         return FALSE;
     }
 
     if (NewArchitecture != NULL) {
-        YoriPkgBuildUpgradeLocationForNewArchitecture(PackageName, NewArchitecture, &PkgIniFile, &IniValue);
+        YoriPkgBuildUpgradeLocationForNewArchitecture(PackageName, NewArchitecture, &PkgIni, &IniValue);
     }
 
     Result = FALSE;
-    Error = YoriPkgPreparePackageForInstallRedirectBuild(&PkgIniFile, NULL, &PendingPackages, &IniValue);
+    Error = YoriPkgPreparePackageForInstallRedirectBuild(&PkgIni, NULL, &PendingPackages, &IniValue);
     if (Error != ERROR_SUCCESS) {
         YoriPkgDisplayErrorStringForInstallFailure(Error);
         goto Exit;
     }
 
-    Result = YoriPkgInstallPendingPackages(&PkgIniFile, NULL, &PendingPackages);
+    Result = YoriPkgInstallPendingPackages(&PkgIni, NULL, &PendingPackages);
 
 Exit:
     if (!YoriLibIsListEmpty(&PendingPackages.BackupPackages)) {
-        YoriPkgRollbackAndFreeBackupPackageList(&PkgIniFile, NULL, &PendingPackages.BackupPackages);
+        YoriPkgRollbackAndFreeBackupPackageList(&PkgIni, NULL, &PendingPackages.BackupPackages);
     }
 
     YoriPkgDeletePendingPackages(&PendingPackages);
 
-    YoriLibFreeStringContents(&PkgIniFile);
+    YoriLibIniCleanup(&PkgIni);
     YoriLibFreeStringContents(&IniValue);
 
     return Result;
@@ -342,20 +350,16 @@ YoriPkgInstallSinglePackage(
     __in_opt PCYORI_STRING TargetDirectory
     )
 {
-    YORI_STRING PkgIniFile;
+    YORI_LIB_INI PkgIni;
     BOOL Result;
     DWORD Error;
     YORIPKG_PACKAGES_PENDING_INSTALL PendingPackages;
 
-    if (DllKernel32.pWritePrivateProfileStringW == NULL) {
-        return FALSE;
-    }
-
     if (!YoriPkgInitializePendingPackages(&PendingPackages)) {
         return FALSE;
     }
 
-    if (!YoriPkgGetPackageIniFile(TargetDirectory, &PkgIniFile)) {
+    if (!YoriPkgLoadPackageIni(TargetDirectory, &PkgIni)) {
         YoriPkgDeletePendingPackages(&PendingPackages);
         return FALSE;
     }
@@ -364,22 +368,22 @@ YoriPkgInstallSinglePackage(
     if (YoriLibIsPathUrl(PackagePath)) {
         YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("Downloading %y...\n"), PackagePath);
     }
-    Error = YoriPkgPreparePackageForInstall(&PkgIniFile, TargetDirectory, &PendingPackages, PackagePath, NULL);
+    Error = YoriPkgPreparePackageForInstall(&PkgIni, TargetDirectory, &PendingPackages, PackagePath, NULL);
     if (Error != ERROR_SUCCESS) {
         YoriPkgDisplayErrorStringForInstallFailure(Error);
         goto Exit;
     }
 
-    Result = YoriPkgInstallPendingPackages(&PkgIniFile, TargetDirectory, &PendingPackages);
+    Result = YoriPkgInstallPendingPackages(&PkgIni, TargetDirectory, &PendingPackages);
 
 Exit:
     if (!YoriLibIsListEmpty(&PendingPackages.BackupPackages)) {
-        YoriPkgRollbackAndFreeBackupPackageList(&PkgIniFile, TargetDirectory, &PendingPackages.BackupPackages);
+        YoriPkgRollbackAndFreeBackupPackageList(&PkgIni, TargetDirectory, &PendingPackages.BackupPackages);
     }
 
     YoriPkgDeletePendingPackages(&PendingPackages);
 
-    YoriLibFreeStringContents(&PkgIniFile);
+    YoriLibIniCleanup(&PkgIni);
 
     return Result;
 }
@@ -393,7 +397,7 @@ Exit:
 BOOL
 YoriPkgInstallSourceForInstalledPackages(VOID)
 {
-    YORI_STRING PkgIniFile;
+    YORI_LIB_INI PkgIni;
     YORI_STRING InstalledSection;
     LPTSTR ThisLine;
     LPTSTR Equals;
@@ -404,41 +408,33 @@ YoriPkgInstallSourceForInstalledPackages(VOID)
     BOOL Result;
     YORIPKG_PACKAGES_PENDING_INSTALL PendingPackages;
 
-    if (DllKernel32.pGetPrivateProfileIntW == NULL ||
-        DllKernel32.pGetPrivateProfileSectionW == NULL ||
-        DllKernel32.pGetPrivateProfileStringW == NULL ||
-        DllKernel32.pWritePrivateProfileStringW == NULL) {
-
-        return FALSE;
-    }
-
     if (!YoriPkgInitializePendingPackages(&PendingPackages)) {
         return FALSE;
     }
 
-    if (!YoriPkgGetPackageIniFile(NULL, &PkgIniFile)) {
+    if (!YoriPkgLoadPackageIni(NULL, &PkgIni)) {
         YoriPkgDeletePendingPackages(&PendingPackages);
         return FALSE;
     }
 
     if (!YoriLibAllocateString(&InstalledSection, YORIPKG_MAX_SECTION_LENGTH)) {
         YoriPkgDeletePendingPackages(&PendingPackages);
-        YoriLibFreeStringContents(&PkgIniFile);
+        YoriLibIniCleanup(&PkgIni);
         return FALSE;
     }
 
     if (!YoriLibAllocateString(&SourcePath, YORIPKG_MAX_FIELD_LENGTH)) {
         YoriPkgDeletePendingPackages(&PendingPackages);
         YoriLibFreeStringContents(&InstalledSection);
-        YoriLibFreeStringContents(&PkgIniFile);
+        YoriLibIniCleanup(&PkgIni);
         return FALSE;
     }
 
     InstalledSection.LengthInChars = (YORI_ALLOC_SIZE_T)
-        DllKernel32.pGetPrivateProfileSectionW(_T("Installed"),
-                                               InstalledSection.StartOfString,
-                                               InstalledSection.LengthAllocated,
-                                               PkgIniFile.StartOfString);
+        YoriLibIniGetSection(&PkgIni,
+                             _T("Installed"),
+                             InstalledSection.StartOfString,
+                             InstalledSection.LengthAllocated);
 
     YoriLibInitEmptyString(&PkgNameOnly);
     ThisLine = InstalledSection.StartOfString;
@@ -456,17 +452,17 @@ YoriPkgInstallSourceForInstalledPackages(VOID)
         }
 
         SourcePath.LengthInChars = (YORI_ALLOC_SIZE_T)
-            DllKernel32.pGetPrivateProfileStringW(PkgNameOnly.StartOfString,
-                                                  _T("SourcePath"),
-                                                  _T(""),
-                                                  SourcePath.StartOfString,
-                                                  SourcePath.LengthAllocated,
-                                                  PkgIniFile.StartOfString);
+            YoriLibIniGetString(&PkgIni,
+                                PkgNameOnly.StartOfString,
+                                _T("SourcePath"),
+                                _T(""),
+                                SourcePath.StartOfString,
+                                SourcePath.LengthAllocated);
         if (SourcePath.LengthInChars > 0) {
             if (YoriLibIsPathUrl(&SourcePath)) {
                 YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("Downloading source for %y from %y...\n"), &PkgNameOnly, &SourcePath);
             }
-            Error = YoriPkgPreparePackageForInstall(&PkgIniFile, NULL, &PendingPackages, &SourcePath, NULL);
+            Error = YoriPkgPreparePackageForInstall(&PkgIni, NULL, &PendingPackages, &SourcePath, NULL);
             if (Error != ERROR_SUCCESS) {
                 YoriPkgDisplayErrorStringForInstallFailure(Error);
                 goto Exit;
@@ -484,7 +480,7 @@ YoriPkgInstallSourceForInstalledPackages(VOID)
     //  Install all packages which specify a source path.
     //
 
-    Result = YoriPkgInstallPendingPackages(&PkgIniFile, NULL, &PendingPackages);
+    Result = YoriPkgInstallPendingPackages(&PkgIni, NULL, &PendingPackages);
 
 Exit:
 
@@ -493,12 +489,12 @@ Exit:
     //
 
     if (!YoriLibIsListEmpty(&PendingPackages.BackupPackages)) {
-        YoriPkgRollbackAndFreeBackupPackageList(&PkgIniFile, NULL, &PendingPackages.BackupPackages);
+        YoriPkgRollbackAndFreeBackupPackageList(&PkgIni, NULL, &PendingPackages.BackupPackages);
     }
 
     YoriPkgDeletePendingPackages(&PendingPackages);
 
-    YoriLibFreeStringContents(&PkgIniFile);
+    YoriLibIniCleanup(&PkgIni);
     YoriLibFreeStringContents(&InstalledSection);
     YoriLibFreeStringContents(&SourcePath);
 
@@ -517,60 +513,53 @@ YoriPkgInstallSourceForSinglePackage(
     __in PYORI_STRING PackageName
     )
 {
-    YORI_STRING PkgIniFile;
+    YORI_LIB_INI PkgIni;
     YORI_STRING IniValue;
     BOOL Result;
     DWORD Error;
     YORIPKG_PACKAGES_PENDING_INSTALL PendingPackages;
 
-    if (DllKernel32.pGetPrivateProfileIntW == NULL ||
-        DllKernel32.pGetPrivateProfileStringW == NULL ||
-        DllKernel32.pWritePrivateProfileStringW == NULL) {
-
-        return FALSE;
-    }
-
     if (!YoriPkgInitializePendingPackages(&PendingPackages)) {
         return FALSE;
     }
 
-    if (!YoriPkgGetPackageIniFile(NULL, &PkgIniFile)) {
+    if (!YoriPkgLoadPackageIni(NULL, &PkgIni)) {
         YoriPkgDeletePendingPackages(&PendingPackages);
         return FALSE;
     }
 
     if (!YoriLibAllocateString(&IniValue, YORIPKG_MAX_FIELD_LENGTH)) {
         YoriPkgDeletePendingPackages(&PendingPackages);
-        YoriLibFreeStringContents(&PkgIniFile);
+        YoriLibIniCleanup(&PkgIni);
         return FALSE;
     }
 
     IniValue.LengthInChars = (YORI_ALLOC_SIZE_T)
-        DllKernel32.pGetPrivateProfileStringW(_T("Installed"),
-                                              PackageName->StartOfString,
-                                              _T(""),
-                                              IniValue.StartOfString,
-                                              IniValue.LengthAllocated,
-                                              PkgIniFile.StartOfString);
+        YoriLibIniGetString(&PkgIni,
+                            _T("Installed"),
+                            PackageName->StartOfString,
+                            _T(""),
+                            IniValue.StartOfString,
+                            IniValue.LengthAllocated);
     if (IniValue.LengthInChars == 0) {
         YoriPkgDeletePendingPackages(&PendingPackages);
-        YoriLibFreeStringContents(&PkgIniFile);
+        YoriLibIniCleanup(&PkgIni);
         YoriLibFreeStringContents(&IniValue);
         YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y is not installed\n"), PackageName);
         return FALSE;
     }
 
     IniValue.LengthInChars = (YORI_ALLOC_SIZE_T)
-        DllKernel32.pGetPrivateProfileStringW(PackageName->StartOfString,
-                                              _T("SourcePath"),
-                                              _T(""),
-                                              IniValue.StartOfString,
-                                              IniValue.LengthAllocated,
-                                              PkgIniFile.StartOfString);
+        YoriLibIniGetString(&PkgIni,
+                            PackageName->StartOfString,
+                            _T("SourcePath"),
+                            _T(""),
+                            IniValue.StartOfString,
+                            IniValue.LengthAllocated);
 
     if (IniValue.LengthInChars == 0) {
         YoriPkgDeletePendingPackages(&PendingPackages);
-        YoriLibFreeStringContents(&PkgIniFile);
+        YoriLibIniCleanup(&PkgIni);
         YoriLibFreeStringContents(&IniValue);
         YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y does not specify a source path\n"), PackageName);
         return FALSE;
@@ -580,22 +569,22 @@ YoriPkgInstallSourceForSinglePackage(
     if (YoriLibIsPathUrl(&IniValue)) {
         YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("Downloading %y...\n"), &IniValue);
     }
-    Error = YoriPkgPreparePackageForInstall(&PkgIniFile, NULL, &PendingPackages, &IniValue, NULL);
+    Error = YoriPkgPreparePackageForInstall(&PkgIni, NULL, &PendingPackages, &IniValue, NULL);
     if (Error != ERROR_SUCCESS) {
         YoriPkgDisplayErrorStringForInstallFailure(Error);
         goto Exit;
     }
 
-    Result = YoriPkgInstallPendingPackages(&PkgIniFile, NULL, &PendingPackages);
+    Result = YoriPkgInstallPendingPackages(&PkgIni, NULL, &PendingPackages);
 
 Exit:
     if (!YoriLibIsListEmpty(&PendingPackages.BackupPackages)) {
-        YoriPkgRollbackAndFreeBackupPackageList(&PkgIniFile, NULL, &PendingPackages.BackupPackages);
+        YoriPkgRollbackAndFreeBackupPackageList(&PkgIni, NULL, &PendingPackages.BackupPackages);
     }
 
     YoriPkgDeletePendingPackages(&PendingPackages);
 
-    YoriLibFreeStringContents(&PkgIniFile);
+    YoriLibIniCleanup(&PkgIni);
     YoriLibFreeStringContents(&IniValue);
 
     return Result;
@@ -609,7 +598,7 @@ Exit:
 BOOL
 YoriPkgInstallSymbolsForInstalledPackages(VOID)
 {
-    YORI_STRING PkgIniFile;
+    YORI_LIB_INI PkgIni;
     YORI_STRING InstalledSection;
     LPTSTR ThisLine;
     LPTSTR Equals;
@@ -621,41 +610,33 @@ YoriPkgInstallSymbolsForInstalledPackages(VOID)
     BOOL Result;
     YORIPKG_PACKAGES_PENDING_INSTALL PendingPackages;
 
-    if (DllKernel32.pGetPrivateProfileIntW == NULL ||
-        DllKernel32.pGetPrivateProfileSectionW == NULL ||
-        DllKernel32.pGetPrivateProfileStringW == NULL ||
-        DllKernel32.pWritePrivateProfileStringW == NULL) {
-
-        return FALSE;
-    }
-
     if (!YoriPkgInitializePendingPackages(&PendingPackages)) {
         return FALSE;
     }
 
-    if (!YoriPkgGetPackageIniFile(NULL, &PkgIniFile)) {
+    if (!YoriPkgLoadPackageIni(NULL, &PkgIni)) {
         YoriPkgDeletePendingPackages(&PendingPackages);
         return FALSE;
     }
 
     if (!YoriLibAllocateString(&InstalledSection, YORIPKG_MAX_SECTION_LENGTH)) {
         YoriPkgDeletePendingPackages(&PendingPackages);
-        YoriLibFreeStringContents(&PkgIniFile);
+        YoriLibIniCleanup(&PkgIni);
         return FALSE;
     }
 
     if (!YoriLibAllocateString(&SymbolPath, YORIPKG_MAX_FIELD_LENGTH)) {
         YoriPkgDeletePendingPackages(&PendingPackages);
         YoriLibFreeStringContents(&InstalledSection);
-        YoriLibFreeStringContents(&PkgIniFile);
+        YoriLibIniCleanup(&PkgIni);
         return FALSE;
     }
 
     InstalledSection.LengthInChars = (YORI_ALLOC_SIZE_T)
-        DllKernel32.pGetPrivateProfileSectionW(_T("Installed"),
-                                               InstalledSection.StartOfString,
-                                               InstalledSection.LengthAllocated,
-                                               PkgIniFile.StartOfString);
+        YoriLibIniGetSection(&PkgIni,
+                             _T("Installed"),
+                             InstalledSection.StartOfString,
+                             InstalledSection.LengthAllocated);
 
     YoriLibInitEmptyString(&PkgNameOnly);
     ThisLine = InstalledSection.StartOfString;
@@ -674,17 +655,17 @@ YoriPkgInstallSymbolsForInstalledPackages(VOID)
         }
 
         SymbolPath.LengthInChars = (YORI_ALLOC_SIZE_T)
-            DllKernel32.pGetPrivateProfileStringW(PkgNameOnly.StartOfString,
-                                                  _T("SymbolPath"),
-                                                  _T(""),
-                                                  SymbolPath.StartOfString,
-                                                  SymbolPath.LengthAllocated,
-                                                  PkgIniFile.StartOfString);
+            YoriLibIniGetString(&PkgIni,
+                                PkgNameOnly.StartOfString,
+                                _T("SymbolPath"),
+                                _T(""),
+                                SymbolPath.StartOfString,
+                                SymbolPath.LengthAllocated);
         if (SymbolPath.LengthInChars > 0) {
             if (YoriLibIsPathUrl(&SymbolPath)) {
                 YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("Downloading symbols for %y from %y...\n"), &PkgNameOnly, &SymbolPath);
             }
-            Error = YoriPkgPreparePackageForInstall(&PkgIniFile, NULL, &PendingPackages, &SymbolPath, NULL);
+            Error = YoriPkgPreparePackageForInstall(&PkgIni, NULL, &PendingPackages, &SymbolPath, NULL);
             if (Error != ERROR_SUCCESS) {
                 YoriPkgDisplayErrorStringForInstallFailure(Error);
                 goto Exit;
@@ -703,7 +684,7 @@ YoriPkgInstallSymbolsForInstalledPackages(VOID)
     //  Install all packages which specify a source path.
     //
 
-    Result = YoriPkgInstallPendingPackages(&PkgIniFile, NULL, &PendingPackages);
+    Result = YoriPkgInstallPendingPackages(&PkgIni, NULL, &PendingPackages);
 
 Exit:
 
@@ -712,12 +693,12 @@ Exit:
     //
 
     if (!YoriLibIsListEmpty(&PendingPackages.BackupPackages)) {
-        YoriPkgRollbackAndFreeBackupPackageList(&PkgIniFile, NULL, &PendingPackages.BackupPackages);
+        YoriPkgRollbackAndFreeBackupPackageList(&PkgIni, NULL, &PendingPackages.BackupPackages);
     }
 
     YoriPkgDeletePendingPackages(&PendingPackages);
 
-    YoriLibFreeStringContents(&PkgIniFile);
+    YoriLibIniCleanup(&PkgIni);
     YoriLibFreeStringContents(&InstalledSection);
     YoriLibFreeStringContents(&SymbolPath);
 
@@ -736,60 +717,53 @@ YoriPkgInstallSymbolForSinglePackage(
     __in PYORI_STRING PackageName
     )
 {
-    YORI_STRING PkgIniFile;
+    YORI_LIB_INI PkgIni;
     YORI_STRING IniValue;
     DWORD Error;
     BOOL Result;
     YORIPKG_PACKAGES_PENDING_INSTALL PendingPackages;
 
-    if (DllKernel32.pGetPrivateProfileIntW == NULL ||
-        DllKernel32.pGetPrivateProfileStringW == NULL ||
-        DllKernel32.pWritePrivateProfileStringW == NULL) {
-
-        return FALSE;
-    }
-
     if (!YoriPkgInitializePendingPackages(&PendingPackages)) {
         return FALSE;
     }
 
-    if (!YoriPkgGetPackageIniFile(NULL, &PkgIniFile)) {
+    if (!YoriPkgLoadPackageIni(NULL, &PkgIni)) {
         YoriPkgDeletePendingPackages(&PendingPackages);
         return FALSE;
     }
 
     if (!YoriLibAllocateString(&IniValue, YORIPKG_MAX_FIELD_LENGTH)) {
         YoriPkgDeletePendingPackages(&PendingPackages);
-        YoriLibFreeStringContents(&PkgIniFile);
+        YoriLibIniCleanup(&PkgIni);
         return FALSE;
     }
 
     IniValue.LengthInChars = (YORI_ALLOC_SIZE_T)
-        DllKernel32.pGetPrivateProfileStringW(_T("Installed"),
-                                              PackageName->StartOfString,
-                                              _T(""),
-                                              IniValue.StartOfString,
-                                              IniValue.LengthAllocated,
-                                              PkgIniFile.StartOfString);
+        YoriLibIniGetString(&PkgIni,
+                            _T("Installed"),
+                            PackageName->StartOfString,
+                            _T(""),
+                            IniValue.StartOfString,
+                            IniValue.LengthAllocated);
     if (IniValue.LengthInChars == 0) {
         YoriPkgDeletePendingPackages(&PendingPackages);
-        YoriLibFreeStringContents(&PkgIniFile);
+        YoriLibIniCleanup(&PkgIni);
         YoriLibFreeStringContents(&IniValue);
         YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y is not installed\n"), PackageName);
         return FALSE;
     }
 
     IniValue.LengthInChars = (YORI_ALLOC_SIZE_T)
-        DllKernel32.pGetPrivateProfileStringW(PackageName->StartOfString,
-                                              _T("SymbolPath"),
-                                              _T(""),
-                                              IniValue.StartOfString,
-                                              IniValue.LengthAllocated,
-                                              PkgIniFile.StartOfString);
+        YoriLibIniGetString(&PkgIni,
+                            PackageName->StartOfString,
+                            _T("SymbolPath"),
+                            _T(""),
+                            IniValue.StartOfString,
+                            IniValue.LengthAllocated);
 
     if (IniValue.LengthInChars == 0) {
         YoriPkgDeletePendingPackages(&PendingPackages);
-        YoriLibFreeStringContents(&PkgIniFile);
+        YoriLibIniCleanup(&PkgIni);
         YoriLibFreeStringContents(&IniValue);
         YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y does not specify a source path\n"), PackageName);
         return FALSE;
@@ -799,22 +773,22 @@ YoriPkgInstallSymbolForSinglePackage(
     if (YoriLibIsPathUrl(&IniValue)) {
         YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("Downloading %y...\n"), &IniValue);
     }
-    Error = YoriPkgPreparePackageForInstall(&PkgIniFile, NULL, &PendingPackages, &IniValue, NULL);
+    Error = YoriPkgPreparePackageForInstall(&PkgIni, NULL, &PendingPackages, &IniValue, NULL);
     if (Error != ERROR_SUCCESS) {
         YoriPkgDisplayErrorStringForInstallFailure(Error);
         goto Exit;
     }
 
-    Result = YoriPkgInstallPendingPackages(&PkgIniFile, NULL, &PendingPackages);
+    Result = YoriPkgInstallPendingPackages(&PkgIni, NULL, &PendingPackages);
 
 Exit:
     if (!YoriLibIsListEmpty(&PendingPackages.BackupPackages)) {
-        YoriPkgRollbackAndFreeBackupPackageList(&PkgIniFile, NULL, &PendingPackages.BackupPackages);
+        YoriPkgRollbackAndFreeBackupPackageList(&PkgIni, NULL, &PendingPackages.BackupPackages);
     }
 
     YoriPkgDeletePendingPackages(&PendingPackages);
 
-    YoriLibFreeStringContents(&PkgIniFile);
+    YoriLibIniCleanup(&PkgIni);
     YoriLibFreeStringContents(&IniValue);
 
     return Result;
@@ -833,7 +807,7 @@ YoriPkgListInstalledPackages(
     __in BOOL Verbose
     )
 {
-    YORI_STRING PkgIniFile;
+    YORI_LIB_INI PkgIni;
     YORI_STRING InstalledSection;
     LPTSTR ThisLine;
     LPTSTR Equals;
@@ -841,32 +815,26 @@ YoriPkgListInstalledPackages(
     YORI_STRING PkgVersion;
     YORI_STRING PkgArch;
 
-    if (DllKernel32.pGetPrivateProfileIntW == NULL ||
-        DllKernel32.pGetPrivateProfileSectionW == NULL ||
-        DllKernel32.pGetPrivateProfileStringW == NULL) {
-        return FALSE;
-    }
-
-    if (!YoriPkgGetPackageIniFile(NULL, &PkgIniFile)) {
+    if (!YoriPkgLoadPackageIni(NULL, &PkgIni)) {
         return FALSE;
     }
 
     if (!YoriLibAllocateString(&InstalledSection, YORIPKG_MAX_SECTION_LENGTH)) {
-        YoriLibFreeStringContents(&PkgIniFile);
+        YoriLibIniCleanup(&PkgIni);
         return FALSE;
     }
 
     if (!YoriLibAllocateString(&PkgArch, YORIPKG_MAX_FIELD_LENGTH)) {
         YoriLibFreeStringContents(&InstalledSection);
-        YoriLibFreeStringContents(&PkgIniFile);
+        YoriLibIniCleanup(&PkgIni);
         return FALSE;
     }
 
     InstalledSection.LengthInChars = (YORI_ALLOC_SIZE_T)
-        DllKernel32.pGetPrivateProfileSectionW(_T("Installed"),
-                                               InstalledSection.StartOfString,
-                                               InstalledSection.LengthAllocated,
-                                               PkgIniFile.StartOfString);
+        YoriLibIniGetSection(&PkgIni,
+                             _T("Installed"),
+                             InstalledSection.StartOfString,
+                             InstalledSection.LengthAllocated);
 
     YoriLibInitEmptyString(&PkgNameOnly);
     YoriLibInitEmptyString(&PkgVersion);
@@ -891,12 +859,12 @@ YoriPkgListInstalledPackages(
         PkgNameOnly.StartOfString[PkgNameOnly.LengthInChars] = '\0';
 
         PkgArch.LengthInChars = (YORI_ALLOC_SIZE_T)
-            DllKernel32.pGetPrivateProfileStringW(PkgNameOnly.StartOfString,
-                                                  _T("Architecture"),
-                                                  _T(""),
-                                                  PkgArch.StartOfString,
-                                                  PkgArch.LengthAllocated,
-                                                  PkgIniFile.StartOfString);
+            YoriLibIniGetString(&PkgIni,
+                                PkgNameOnly.StartOfString,
+                                _T("Architecture"),
+                                _T(""),
+                                PkgArch.StartOfString,
+                                PkgArch.LengthAllocated);
 
         if (Verbose) {
             YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y %y (%y)\n"), &PkgNameOnly, &PkgVersion, &PkgArch);
@@ -905,7 +873,7 @@ YoriPkgListInstalledPackages(
         }
     }
 
-    YoriLibFreeStringContents(&PkgIniFile);
+    YoriLibIniCleanup(&PkgIni);
     YoriLibFreeStringContents(&InstalledSection);
     YoriLibFreeStringContents(&PkgArch);
 
@@ -933,53 +901,56 @@ YoriPkgDeletePackage(
     __in BOOL WarnIfNotInstalled
     )
 {
-    YORI_STRING PkgIniFile;
+    YORI_LIB_INI PkgIni;
     YORI_STRING IniValue;
     DWORD FileCount;
     DWORD Error;
 
-    if (DllKernel32.pGetPrivateProfileIntW == NULL ||
-        DllKernel32.pGetPrivateProfileStringW == NULL ||
-        DllKernel32.pWritePrivateProfileStringW == NULL) {
-
-        return FALSE;
-    }
-
-    if (!YoriPkgGetPackageIniFile(TargetDirectory, &PkgIniFile)) {
+    if (!YoriPkgLoadPackageIni(TargetDirectory, &PkgIni)) {
         return FALSE;
     }
 
     if (!YoriLibAllocateString(&IniValue, YORIPKG_MAX_FIELD_LENGTH)) {
-        YoriLibFreeStringContents(&PkgIniFile);
+        YoriLibIniCleanup(&PkgIni);
         return FALSE;
     }
 
     IniValue.LengthInChars = (YORI_ALLOC_SIZE_T)
-        DllKernel32.pGetPrivateProfileStringW(_T("Installed"),
-                                              PackageName->StartOfString,
-                                              _T(""),
-                                              IniValue.StartOfString,
-                                              IniValue.LengthAllocated,
-                                              PkgIniFile.StartOfString);
+        YoriLibIniGetString(&PkgIni,
+                            _T("Installed"),
+                            PackageName->StartOfString,
+                            _T(""),
+                            IniValue.StartOfString,
+                            IniValue.LengthAllocated);
     if (IniValue.LengthInChars == 0) {
         if (WarnIfNotInstalled) {
             YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%y is not an installed package\n"), PackageName);
         }
-        YoriLibFreeStringContents(&PkgIniFile);
+        YoriLibIniCleanup(&PkgIni);
         YoriLibFreeStringContents(&IniValue);
         return FALSE;
     }
 
-    FileCount = DllKernel32.pGetPrivateProfileIntW(PackageName->StartOfString, _T("FileCount"), 0, PkgIniFile.StartOfString);
+    FileCount = YoriLibIniGetInt(&PkgIni, PackageName->StartOfString, _T("FileCount"), 0);
     if (FileCount == 0) {
         YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%y contains nothing to remove\n"), PackageName);
-        YoriLibFreeStringContents(&PkgIniFile);
+        YoriLibIniCleanup(&PkgIni);
         YoriLibFreeStringContents(&IniValue);
         return FALSE;
     }
 
-    Error = YoriPkgDeletePackageInternal(&PkgIniFile, TargetDirectory, PackageName, FALSE);
-    YoriLibFreeStringContents(&PkgIniFile);
+    //
+    //  If the delete fails part way through, the files that were removed
+    //  are still removed from the INI file, so write back whatever was done.
+    //
+
+    Error = YoriPkgDeletePackageInternal(&PkgIni, TargetDirectory, PackageName, FALSE);
+    if (!YoriPkgFlushPackageIni(&PkgIni) && Error == ERROR_SUCCESS) {
+        YoriLibIniCleanup(&PkgIni);
+        YoriLibFreeStringContents(&IniValue);
+        return FALSE;
+    }
+    YoriLibIniCleanup(&PkgIni);
     YoriLibFreeStringContents(&IniValue);
     if (Error != ERROR_SUCCESS) {
         YoriPkgDisplayErrorStringForInstallFailure(Error);
@@ -996,7 +967,7 @@ YoriPkgDeletePackage(
 BOOL
 YoriPkgDeleteAllPackages(VOID)
 {
-    YORI_STRING PkgIniFile;
+    YORI_LIB_INI PkgIni;
     YORI_STRING InstalledSection;
     LPTSTR ThisLine;
     LPTSTR Equals;
@@ -1004,28 +975,20 @@ YoriPkgDeleteAllPackages(VOID)
     BOOL Result;
     DWORD Error;
 
-    if (DllKernel32.pGetPrivateProfileIntW == NULL ||
-        DllKernel32.pGetPrivateProfileSectionW == NULL ||
-        DllKernel32.pGetPrivateProfileStringW == NULL ||
-        DllKernel32.pWritePrivateProfileStringW == NULL) {
-
-        return FALSE;
-    }
-
-    if (!YoriPkgGetPackageIniFile(NULL, &PkgIniFile)) {
+    if (!YoriPkgLoadPackageIni(NULL, &PkgIni)) {
         return FALSE;
     }
 
     if (!YoriLibAllocateString(&InstalledSection, YORIPKG_MAX_SECTION_LENGTH)) {
-        YoriLibFreeStringContents(&PkgIniFile);
+        YoriLibIniCleanup(&PkgIni);
         return FALSE;
     }
 
     InstalledSection.LengthInChars = (YORI_ALLOC_SIZE_T)
-        DllKernel32.pGetPrivateProfileSectionW(_T("Installed"),
-                                               InstalledSection.StartOfString,
-                                               InstalledSection.LengthAllocated,
-                                               PkgIniFile.StartOfString);
+        YoriLibIniGetSection(&PkgIni,
+                             _T("Installed"),
+                             InstalledSection.StartOfString,
+                             InstalledSection.LengthAllocated);
 
     YoriLibInitEmptyString(&PkgNameOnly);
     ThisLine = InstalledSection.StartOfString;
@@ -1050,7 +1013,7 @@ YoriPkgDeleteAllPackages(VOID)
         ThisLine++;
 
         PkgNameOnly.StartOfString[PkgNameOnly.LengthInChars] = '\0';
-        if (!YoriPkgCheckIfPackageDeleteable(&PkgIniFile, NULL, &PkgNameOnly, TRUE)) {
+        if (!YoriPkgCheckIfPackageDeleteable(&PkgIni, NULL, &PkgNameOnly, TRUE)) {
             YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Could not remove package %y\n"), &PkgNameOnly);
             Result = FALSE;
             break;
@@ -1058,17 +1021,17 @@ YoriPkgDeleteAllPackages(VOID)
     }
 
     if (!Result) {
-        YoriLibFreeStringContents(&PkgIniFile);
+        YoriLibIniCleanup(&PkgIni);
         YoriLibFreeStringContents(&InstalledSection);
 
         return Result;
     }
 
     InstalledSection.LengthInChars = (YORI_ALLOC_SIZE_T)
-        DllKernel32.pGetPrivateProfileSectionW(_T("Installed"),
-                                               InstalledSection.StartOfString,
-                                               InstalledSection.LengthAllocated,
-                                               PkgIniFile.StartOfString);
+        YoriLibIniGetSection(&PkgIni,
+                             _T("Installed"),
+                             InstalledSection.StartOfString,
+                             InstalledSection.LengthAllocated);
 
     YoriLibInitEmptyString(&PkgNameOnly);
     ThisLine = InstalledSection.StartOfString;
@@ -1087,7 +1050,7 @@ YoriPkgDeleteAllPackages(VOID)
         ThisLine++;
 
         PkgNameOnly.StartOfString[PkgNameOnly.LengthInChars] = '\0';
-        Error = YoriPkgDeletePackageInternal(&PkgIniFile, NULL, &PkgNameOnly, TRUE);
+        Error = YoriPkgDeletePackageInternal(&PkgIni, NULL, &PkgNameOnly, TRUE);
         if (Error != ERROR_SUCCESS) {
             YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Could not remove package %y\n"), &PkgNameOnly);
             YoriPkgDisplayErrorStringForInstallFailure(Error);
@@ -1096,7 +1059,11 @@ YoriPkgDeleteAllPackages(VOID)
         }
     }
 
-    YoriLibFreeStringContents(&PkgIniFile);
+    if (!YoriPkgFlushPackageIni(&PkgIni)) {
+        Result = FALSE;
+    }
+
+    YoriLibIniCleanup(&PkgIni);
     YoriLibFreeStringContents(&InstalledSection);
 
     return Result;
@@ -1134,35 +1101,32 @@ YoriPkgInstallPseudoPackage(
     __in_opt PCYORI_STRING TargetDirectory
     )
 {
-    YORI_STRING PkgIniFile;
+    YORI_LIB_INI PkgIni;
     DWORD FileIndex;
     TCHAR FileIndexString[16];
+    BOOL Result;
 
-    if (DllKernel32.pWritePrivateProfileStringW == NULL) {
-        return FALSE;
-    }
-
-    if (!YoriPkgGetPackageIniFile(TargetDirectory, &PkgIniFile)) {
+    if (!YoriPkgLoadPackageIni(TargetDirectory, &PkgIni)) {
         return FALSE;
     }
 
-    DllKernel32.pWritePrivateProfileStringW(_T("Installed"), Name->StartOfString, Version->StartOfString, PkgIniFile.StartOfString);
-    DllKernel32.pWritePrivateProfileStringW(Name->StartOfString, _T("Version"), Version->StartOfString, PkgIniFile.StartOfString);
-    DllKernel32.pWritePrivateProfileStringW(Name->StartOfString, _T("Architecture"), Architecture->StartOfString, PkgIniFile.StartOfString);
-    DllKernel32.pWritePrivateProfileStringW(Name->StartOfString, _T("BestEffortDelete"), _T("1"), PkgIniFile.StartOfString);
+    YoriLibIniSetString(&PkgIni, _T("Installed"), Name->StartOfString, Version->StartOfString);
+    YoriLibIniSetString(&PkgIni, Name->StartOfString, _T("Version"), Version->StartOfString);
+    YoriLibIniSetString(&PkgIni, Name->StartOfString, _T("Architecture"), Architecture->StartOfString);
+    YoriLibIniSetString(&PkgIni, Name->StartOfString, _T("BestEffortDelete"), _T("1"));
 
     for (FileIndex = 1; FileIndex <= FileCount; FileIndex++) {
         YoriLibSPrintf(FileIndexString, _T("File%i"), FileIndex);
 
-        DllKernel32.pWritePrivateProfileStringW(Name->StartOfString, FileIndexString, FileArray[FileIndex - 1].StartOfString, PkgIniFile.StartOfString);
+        YoriLibIniSetString(&PkgIni, Name->StartOfString, FileIndexString, FileArray[FileIndex - 1].StartOfString);
     }
     YoriLibSPrintf(FileIndexString, _T("%i"), FileCount);
-    DllKernel32.pWritePrivateProfileStringW(Name->StartOfString, _T("FileCount"), FileIndexString, PkgIniFile.StartOfString);
-
+    YoriLibIniSetString(&PkgIni, Name->StartOfString, _T("FileCount"), FileIndexString);
 
-    YoriLibFreeStringContents(&PkgIniFile);
+    Result = YoriPkgFlushPackageIni(&PkgIni);
+    YoriLibIniCleanup(&PkgIni);
 
-    return TRUE;
+    return Result;
 }
 
 /**
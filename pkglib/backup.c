@@ -87,6 +87,7 @@ YoriPkgDeleteRenamedFiles(
 
         YoriLibFreeStringContents(&BackupFile->BackupName);
         YoriLibFreeStringContents(&BackupFile->OriginalName);
+        YoriLibFreeStringContents(&BackupFile->RecordedDigest);
         YoriLibDereference(BackupFile);
     }
 }
@@ -96,7 +97,7 @@ YoriPkgDeleteRenamedFiles(
  this also restores each file entry back into the INI file.  Note this routine
  is best effort and continues on error.
 
- @param IniPath Pointer to the system global INI file.
+ @param PkgIni Pointer to the system global INI file.
 
  @param PackageBackup Pointer to the backed up package.
 
@@ -106,19 +107,17 @@ YoriPkgDeleteRenamedFiles(
  */
 VOID
 YoriPkgRollbackRenamedFiles(
-    __in PCYORI_STRING IniPath,
+    __in PYORI_LIB_INI PkgIni,
     __in PYORIPKG_BACKUP_PACKAGE PackageBackup,
     __in BOOL RestoreIni
     )
 {
     PYORI_LIST_ENTRY ListEntry = NULL;
     PYORIPKG_BACKUP_FILE BackupFile;
-    TCHAR FileIndexString[16];
+    TCHAR FileIndexString[32];
     DWORD Index;
     BOOL Result;
 
-    ASSERT(DllKernel32.pWritePrivateProfileStringW != NULL);
-
     ListEntry = YoriLibGetNextListEntry(&PackageBackup->FileList, ListEntry);
     Index = 1;
     while (ListEntry != NULL) {
@@ -128,8 +127,11 @@ YoriPkgRollbackRenamedFiles(
 
         if (RestoreIni) {
             YoriLibSPrintf(FileIndexString, _T("File%i"), Index);
-            DllKernel32.pWritePrivateProfileStringW(PackageBackup->PackageName.StartOfString, FileIndexString, BackupFile->OriginalRelativeName.StartOfString, IniPath->StartOfString);
-
+            YoriLibIniSetString(PkgIni, PackageBackup->PackageName.StartOfString, FileIndexString, BackupFile->OriginalRelativeName.StartOfString);
+            if (BackupFile->RecordedDigest.LengthInChars > 0) {
+                YoriLibSPrintf(FileIndexString, _T("File%iDigest"), Index);
+                YoriLibIniSetString(PkgIni, PackageBackup->PackageName.StartOfString, FileIndexString, BackupFile->RecordedDigest.StartOfString);
+            }
         }
 
         //
@@ -151,6 +153,7 @@ YoriPkgRollbackRenamedFiles(
 
         YoriLibFreeStringContents(&BackupFile->BackupName);
         YoriLibFreeStringContents(&BackupFile->OriginalName);
+        YoriLibFreeStringContents(&BackupFile->RecordedDigest);
         YoriLibDereference(BackupFile);
     }
 }
@@ -160,22 +163,18 @@ YoriPkgRollbackRenamedFiles(
  package INI entries to indicate the backed up package is once again
  installed.  Note this routine is best effort and continues on error.
 
- @param IniPath Pointer to the system global INI file.
+ @param PkgIni Pointer to the system global INI file.
 
  @param PackageBackup Pointer to the backed up package.
  */
 VOID
 YoriPkgRollbackPackage(
-    __in PCYORI_STRING IniPath,
+    __in PYORI_LIB_INI PkgIni,
     __in PYORIPKG_BACKUP_PACKAGE PackageBackup
     )
 {
     TCHAR FileCountString[16];
 
-    ASSERT(DllKernel32.pWritePrivateProfileStringW != NULL);
-
-    ASSERT(YoriLibIsStringNullTerminated(IniPath));
-
     ASSERT(YoriLibIsStringNullTerminated(&PackageBackup->PackageName));
     ASSERT(YoriLibIsStringNullTerminated(&PackageBackup->Version));
     ASSERT(YoriLibIsStringNullTerminated(&PackageBackup->Architecture));
@@ -189,62 +188,62 @@ YoriPkgRollbackPackage(
     //  added there that aren't part of the backed up package.
     //
 
-    DllKernel32.pWritePrivateProfileStringW(PackageBackup->PackageName.StartOfString, NULL, NULL, IniPath->StartOfString);
+    YoriLibIniSetString(PkgIni, PackageBackup->PackageName.StartOfString, NULL, NULL);
 
     //
     //  Put back the files and recreate their INI entries.
     //
 
-    YoriPkgRollbackRenamedFiles(IniPath, PackageBackup, TRUE);
+    YoriPkgRollbackRenamedFiles(PkgIni, PackageBackup, TRUE);
     YoriLibSPrintf(FileCountString, _T("%i"), PackageBackup->FileCount);
 
     //
     //  Restore all of the fixed headers for the package.
     //
 
-    DllKernel32.pWritePrivateProfileStringW(PackageBackup->PackageName.StartOfString, _T("FileCount"), FileCountString, IniPath->StartOfString);
-    DllKernel32.pWritePrivateProfileStringW(PackageBackup->PackageName.StartOfString, _T("Version"), PackageBackup->Version.StartOfString, IniPath->StartOfString);
-    DllKernel32.pWritePrivateProfileStringW(PackageBackup->PackageName.StartOfString, _T("Architecture"), PackageBackup->Architecture.StartOfString, IniPath->StartOfString);
+    YoriLibIniSetString(PkgIni, PackageBackup->PackageName.StartOfString, _T("FileCount"), FileCountString);
+    YoriLibIniSetString(PkgIni, PackageBackup->PackageName.StartOfString, _T("Version"), PackageBackup->Version.StartOfString);
+    YoriLibIniSetString(PkgIni, PackageBackup->PackageName.StartOfString, _T("Architecture"), PackageBackup->Architecture.StartOfString);
 
     //
     //  Restore any optional headers for the package.
     //
 
     if (PackageBackup->UpgradePath.LengthInChars > 0) {
-        DllKernel32.pWritePrivateProfileStringW(PackageBackup->PackageName.StartOfString, _T("UpgradePath"), PackageBackup->UpgradePath.StartOfString, IniPath->StartOfString);
+        YoriLibIniSetString(PkgIni, PackageBackup->PackageName.StartOfString, _T("UpgradePath"), PackageBackup->UpgradePath.StartOfString);
     } else {
-        DllKernel32.pWritePrivateProfileStringW(PackageBackup->PackageName.StartOfString, _T("UpgradePath"), NULL, IniPath->StartOfString);
+        YoriLibIniSetString(PkgIni, PackageBackup->PackageName.StartOfString, _T("UpgradePath"), NULL);
     }
 
     if (PackageBackup->SourcePath.LengthInChars > 0) {
-        DllKernel32.pWritePrivateProfileStringW(PackageBackup->PackageName.StartOfString, _T("SourcePath"), PackageBackup->SourcePath.StartOfString, IniPath->StartOfString);
+        YoriLibIniSetString(PkgIni, PackageBackup->PackageName.StartOfString, _T("SourcePath"), PackageBackup->SourcePath.StartOfString);
     } else {
-        DllKernel32.pWritePrivateProfileStringW(PackageBackup->PackageName.StartOfString, _T("SourcePath"), NULL, IniPath->StartOfString);
+        YoriLibIniSetString(PkgIni, PackageBackup->PackageName.StartOfString, _T("SourcePath"), NULL);
     }
 
     if (PackageBackup->SymbolPath.LengthInChars > 0) {
-        DllKernel32.pWritePrivateProfileStringW(PackageBackup->PackageName.StartOfString, _T("SymbolPath"), PackageBackup->SymbolPath.StartOfString, IniPath->StartOfString);
+        YoriLibIniSetString(PkgIni, PackageBackup->PackageName.StartOfString, _T("SymbolPath"), PackageBackup->SymbolPath.StartOfString);
     } else {
-        DllKernel32.pWritePrivateProfileStringW(PackageBackup->PackageName.StartOfString, _T("SymbolPath"), NULL, IniPath->StartOfString);
+        YoriLibIniSetString(PkgIni, PackageBackup->PackageName.StartOfString, _T("SymbolPath"), NULL);
     }
 
     if (PackageBackup->UpgradeToDailyPath.LengthInChars > 0) {
-        DllKernel32.pWritePrivateProfileStringW(PackageBackup->PackageName.StartOfString, _T("UpgradeToDailyPath"), PackageBackup->UpgradeToDailyPath.StartOfString, IniPath->StartOfString);
+        YoriLibIniSetString(PkgIni, PackageBackup->PackageName.StartOfString, _T("UpgradeToDailyPath"), PackageBackup->UpgradeToDailyPath.StartOfString);
     } else {
-        DllKernel32.pWritePrivateProfileStringW(PackageBackup->PackageName.StartOfString, _T("UpgradeToDailyPath"), NULL, IniPath->StartOfString);
+        YoriLibIniSetString(PkgIni, PackageBackup->PackageName.StartOfString, _T("UpgradeToDailyPath"), NULL);
     }
 
     if (PackageBackup->UpgradeToStablePath.LengthInChars > 0) {
-        DllKernel32.pWritePrivateProfileStringW(PackageBackup->PackageName.StartOfString, _T("UpgradeToStablePath"), PackageBackup->UpgradeToStablePath.StartOfString, IniPath->StartOfString);
+        YoriLibIniSetString(PkgIni, PackageBackup->PackageName.StartOfString, _T("UpgradeToStablePath"), PackageBackup->UpgradeToStablePath.StartOfString);
     } else {
-        DllKernel32.pWritePrivateProfileStringW(PackageBackup->PackageName.StartOfString, _T("UpgradeToStablePath"), NULL, IniPath->StartOfString);
+        YoriLibIniSetString(PkgIni, PackageBackup->PackageName.StartOfString, _T("UpgradeToStablePath"), NULL);
     }
 
     //
     //  Indicate the package is installed.
     //
 
-    DllKernel32.pWritePrivateProfileStringW(_T("Installed"), PackageBackup->PackageName.StartOfString, PackageBackup->Version.StartOfString, IniPath->StartOfString);
+    YoriLibIniSetString(PkgIni, _T("Installed"), PackageBackup->PackageName.StartOfString, PackageBackup->Version.StartOfString);
 }
 
 /**
@@ -253,7 +252,7 @@ YoriPkgRollbackPackage(
  the package are loaded into RAM, and the file names are therefore available
  for reuse by a subsequent package installation.
 
- @param IniPath Pointer to the system global INI file to back up a package
+ @param PkgIni Pointer to the system global INI file to back up a package
         from.
 
  @param PackageName Pointer to the canonical package name to back up.
@@ -262,6 +261,11 @@ YoriPkgRollbackPackage(
         directory to back up data from.  If not specified, the application
         directory is used.
 
+ @param UnchangedFiles Optionally points to the [Files] section of a delta
+        package which is replacing this package.  Files listed here are
+        retained by the new package, so they are not renamed, although they
+        are still recorded so their INI entries can be restored on rollback.
+
  @param PackageBackup On successful completion, populated with a backup
         structure indicating the files that have been backed up and all of the
         associated INI entries needed to restore it.
@@ -272,9 +276,10 @@ YoriPkgRollbackPackage(
 __success(return == ERROR_SUCCESS)
 DWORD
 YoriPkgBackupPackage(
-    __in PYORI_STRING IniPath,
+    __in PYORI_LIB_INI PkgIni,
     __in PCYORI_STRING PackageName,
     __in_opt PCYORI_STRING TargetDirectory,
+    __in_opt PYORI_STRING UnchangedFiles,
     __out PYORIPKG_BACKUP_PACKAGE * PackageBackup
     )
 {
@@ -282,16 +287,10 @@ YoriPkgBackupPackage(
     PYORIPKG_BACKUP_FILE BackupFile;
     YORI_STRING FullTargetDirectory;
     YORI_STRING IniValue;
+    YORI_STRING Digest;
     DWORD FileIndex;
     DWORD Err;
-    TCHAR FileIndexString[16];
-
-    if (DllKernel32.pGetPrivateProfileIntW == NULL ||
-        DllKernel32.pGetPrivateProfileStringW == NULL ||
-        DllKernel32.pWritePrivateProfileStringW == NULL) {
-
-        return ERROR_PROC_NOT_FOUND;
-    }
+    TCHAR FileIndexString[32];
 
     Context = YoriLibMalloc(sizeof(YORIPKG_BACKUP_PACKAGE));
     if (Context == NULL) {
@@ -325,7 +324,7 @@ YoriPkgBackupPackage(
     Context->PackageName.LengthInChars = PackageName->LengthInChars;
     Context->PackageName.StartOfString[PackageName->LengthInChars] = '\0';
 
-    if (!YoriPkgGetInstalledPackageInfo(IniPath,
+    if (!YoriPkgGetInstalledPackageInfo(PkgIni,
                                         &Context->PackageName,
                                         &Context->Version,
                                         &Context->Architecture,
@@ -339,12 +338,11 @@ YoriPkgBackupPackage(
         return ERROR_NOT_ENOUGH_MEMORY;
     }
 
-    Context->FileCount = DllKernel32.pGetPrivateProfileIntW(Context->PackageName.StartOfString, _T("FileCount"), 0, IniPath->StartOfString);
+    Context->FileCount = YoriLibIniGetInt(PkgIni, Context->PackageName.StartOfString, _T("FileCount"), 0);
     if (Context->FileCount == 0) {
-        Err = GetLastError();
         YoriLibFreeStringContents(&FullTargetDirectory);
         YoriPkgFreeBackupPackage(Context);
-        return Err;
+        return ERROR_FILE_NOT_FOUND;
     }
 
     if (!YoriLibAllocateString(&IniValue, YORIPKG_MAX_FIELD_LENGTH)) {
@@ -357,12 +355,12 @@ YoriPkgBackupPackage(
         YoriLibSPrintf(FileIndexString, _T("File%i"), FileIndex);
 
         IniValue.LengthInChars = (YORI_ALLOC_SIZE_T)
-            DllKernel32.pGetPrivateProfileStringW(Context->PackageName.StartOfString,
-                                                  FileIndexString,
-                                                  _T(""),
-                                                  IniValue.StartOfString,
-                                                  IniValue.LengthAllocated,
-                                                  IniPath->StartOfString);
+            YoriLibIniGetString(PkgIni,
+                                Context->PackageName.StartOfString,
+                                FileIndexString,
+                                _T(""),
+                                IniValue.StartOfString,
+                                IniValue.LengthAllocated);
 
         //
         //  Don't backup files with absolute paths
@@ -374,7 +372,7 @@ YoriPkgBackupPackage(
 
         BackupFile = YoriLibReferencedMalloc(sizeof(YORIPKG_BACKUP_FILE));
         if (BackupFile == NULL) {
-            YoriPkgRollbackRenamedFiles(IniPath, Context, FALSE);
+            YoriPkgRollbackRenamedFiles(PkgIni, Context, FALSE);
             YoriLibFreeStringContents(&FullTargetDirectory);
             YoriLibFreeStringContents(&IniValue);
             YoriPkgFreeBackupPackage(Context);
@@ -385,7 +383,7 @@ YoriPkgBackupPackage(
 
         YoriLibYPrintf(&BackupFile->OriginalName, _T("%y\\%y"), &FullTargetDirectory, &IniValue);
         if (BackupFile->OriginalName.LengthInChars == 0) {
-            YoriPkgRollbackRenamedFiles(IniPath, Context, FALSE);
+            YoriPkgRollbackRenamedFiles(PkgIni, Context, FALSE);
             YoriLibFreeStringContents(&FullTargetDirectory);
             YoriLibFreeStringContents(&IniValue);
             YoriLibDereference(BackupFile);
@@ -398,11 +396,53 @@ YoriPkgBackupPackage(
         BackupFile->OriginalRelativeName.LengthInChars = BackupFile->OriginalName.LengthInChars - FullTargetDirectory.LengthInChars - 1;
         BackupFile->OriginalRelativeName.LengthAllocated = BackupFile->OriginalName.LengthAllocated - FullTargetDirectory.LengthInChars - 1;
 
+        //
+        //  Capture the digest recorded for the file, if any, so it can be
+        //  restored along with the file name on rollback.  The file name
+        //  has been captured in OriginalRelativeName, so the buffer can be
+        //  reused.
+        //
+
+        YoriLibSPrintf(FileIndexString, _T("File%iDigest"), FileIndex);
+        IniValue.LengthInChars = (YORI_ALLOC_SIZE_T)
+            YoriLibIniGetString(PkgIni,
+                                Context->PackageName.StartOfString,
+                                FileIndexString,
+                                _T(""),
+                                IniValue.StartOfString,
+                                IniValue.LengthAllocated);
+
+        if (IniValue.LengthInChars > 0 &&
+            !YoriLibCopyString(&BackupFile->RecordedDigest, &IniValue)) {
+
+            YoriPkgRollbackRenamedFiles(PkgIni, Context, FALSE);
+            YoriLibFreeStringContents(&BackupFile->OriginalName);
+            YoriLibFreeStringContents(&FullTargetDirectory);
+            YoriLibFreeStringContents(&IniValue);
+            YoriLibDereference(BackupFile);
+            YoriPkgFreeBackupPackage(Context);
+            return ERROR_NOT_ENOUGH_MEMORY;
+        }
+
+        //
+        //  If the new package retains this file, leave it in place.  It is
+        //  recorded without a backup name so the INI entry is restored on
+        //  rollback and the file is not deleted on commit.
+        //
+
+        if (UnchangedFiles != NULL &&
+            YoriPkgFindSectionValue(UnchangedFiles, BackupFile->OriginalRelativeName.StartOfString, &Digest)) {
+
+            YoriLibAppendList(&Context->FileList, &BackupFile->ListEntry);
+            continue;
+        }
+
         if (!YoriLibRenameFileToBackupName(&BackupFile->OriginalName, &BackupFile->BackupName)) {
             Err = GetLastError();
             if (Err != ERROR_FILE_NOT_FOUND) {
-                YoriPkgRollbackRenamedFiles(IniPath, Context, FALSE);
+                YoriPkgRollbackRenamedFiles(PkgIni, Context, FALSE);
                 YoriLibFreeStringContents(&BackupFile->OriginalName);
+                YoriLibFreeStringContents(&BackupFile->RecordedDigest);
                 YoriLibFreeStringContents(&FullTargetDirectory);
                 YoriLibFreeStringContents(&IniValue);
                 YoriLibDereference(BackupFile);
@@ -426,7 +466,7 @@ YoriPkgBackupPackage(
  backup has been generated, so all of these values can be restored.  It ensures
  the INI file is clean in preparation for a subsequent package installation.
 
- @param IniPath Pointer to the INI file name to remove all entries from.
+ @param PkgIni Pointer to the INI file to remove all entries from.
 
  @param PackageBackup Pointer to a package backup structure.  All that's
         needed here is the package name, but the structure is used to 
@@ -434,14 +474,12 @@ YoriPkgBackupPackage(
  */
 VOID
 YoriPkgRemoveSystemReferencesToPackage(
-    __in PYORI_STRING IniPath,
+    __in PYORI_LIB_INI PkgIni,
     __in PYORIPKG_BACKUP_PACKAGE PackageBackup
     )
 {
-    ASSERT(DllKernel32.pWritePrivateProfileStringW != NULL);
-
-    DllKernel32.pWritePrivateProfileStringW(PackageBackup->PackageName.StartOfString, NULL, NULL, IniPath->StartOfString);
-    DllKernel32.pWritePrivateProfileStringW(_T("Installed"), PackageBackup->PackageName.StartOfString, NULL, IniPath->StartOfString);
+    YoriLibIniSetString(PkgIni, PackageBackup->PackageName.StartOfString, NULL, NULL);
+    YoriLibIniSetString(PkgIni, _T("Installed"), PackageBackup->PackageName.StartOfString, NULL);
 }
 
 /**
@@ -451,7 +489,7 @@ YoriPkgRemoveSystemReferencesToPackage(
  much we can do if anything goes wrong in this process, so this function
  swallows all errors.
 
- @param IniPath Pointer to the INI file name to restore entries into.
+ @param PkgIni Pointer to the INI file to restore entries into.
 
  @param NewDirectory Optionally points to a string containing the install
         directory to restore data back to.  If not specified, the application
@@ -461,7 +499,7 @@ YoriPkgRemoveSystemReferencesToPackage(
  */
 VOID
 YoriPkgRollbackAndFreeBackupPackageList(
-    __in PCYORI_STRING IniPath,
+    __in PYORI_LIB_INI PkgIni,
     __in_opt PCYORI_STRING NewDirectory,
     __in PYORI_LIST_ENTRY ListHead
     )
@@ -469,14 +507,12 @@ YoriPkgRollbackAndFreeBackupPackageList(
     PYORI_LIST_ENTRY ListEntry = NULL;
     PYORIPKG_BACKUP_PACKAGE BackupPackage;
 
-    ASSERT(DllKernel32.pWritePrivateProfileStringW != NULL);
-
     ListEntry = YoriLibGetNextListEntry(ListHead, ListEntry);
     while (ListEntry != NULL) {
         BackupPackage = CONTAINING_RECORD(ListEntry, YORIPKG_BACKUP_PACKAGE, PackageList);
         ListEntry = YoriLibGetNextListEntry(ListHead, ListEntry);
-        YoriPkgDeletePackage(NewDirectory, &BackupPackage->PackageName, FALSE);
-        YoriPkgRollbackPackage(IniPath, BackupPackage);
+        YoriPkgDeletePackageInternal(PkgIni, NewDirectory, &BackupPackage->PackageName, FALSE);
+        YoriPkgRollbackPackage(PkgIni, BackupPackage);
         YoriLibRemoveListItem(&BackupPackage->PackageList);
         YoriLibInitializeListHead(&BackupPackage->PackageList);
         YoriPkgFreeBackupPackage(BackupPackage);
@@ -560,17 +596,17 @@ YoriPkgFreeExistingFiles(
     __in PYORIPKG_PACKAGES_PENDING_INSTALL PendingPackages
     )
 {
-    DWORD BucketIndex;
-    PYORI_HASH_BUCKET Bucket;
+    PYORI_HASH_ENTRY HashEntry;
+    PYORI_HASH_ENTRY NextEntry;
     PYORIPKG_EXISTING_FILE ExistingFile;
 
-    for (BucketIndex = 0; BucketIndex < PendingPackages->ExistingFilesTable->NumberBuckets; BucketIndex++) {
-        Bucket = &PendingPackages->ExistingFilesTable->Buckets[BucketIndex];
-        while (!YoriLibIsListEmpty(&Bucket->ListHead)) {
-            ExistingFile = CONTAINING_RECORD(Bucket->ListHead.Next, YORIPKG_EXISTING_FILE, HashEntry.ListEntry);
-            YoriLibHashRemoveByEntry(&ExistingFile->HashEntry);
-            YoriLibDereference(ExistingFile);
-        }
+    HashEntry = YoriLibHashGetNextEntry(PendingPackages->ExistingFilesTable, NULL);
+    while (HashEntry != NULL) {
+        NextEntry = YoriLibHashGetNextEntry(PendingPackages->ExistingFilesTable, HashEntry);
+        ExistingFile = CONTAINING_RECORD(HashEntry, YORIPKG_EXISTING_FILE, HashEntry);
+        YoriLibHashRemoveByEntry(&ExistingFile->HashEntry);
+        YoriLibDereference(ExistingFile);
+        HashEntry = NextEntry;
     }
 }
 
@@ -606,7 +642,7 @@ YoriPkgCheckIfFileAlreadyExists(
  appear to be installed are those from packages which will remain after this
  installation operation is complete.
 
- @param PkgIniFile Pointer to the system global INI file.
+ @param PkgIni Pointer to the system global INI file.
 
  @param PendingPackages Pointer to the packages to install which will be
         populated with currently installed file information.
@@ -615,7 +651,7 @@ YoriPkgCheckIfFileAlreadyExists(
  */
 BOOL
 YoriPkgAddExistingFilesToPendingPackages(
-    __in PYORI_STRING PkgIniFile,
+    __in PYORI_LIB_INI PkgIni,
     __in PYORIPKG_PACKAGES_PENDING_INSTALL PendingPackages
     )
 {
@@ -629,12 +665,6 @@ YoriPkgAddExistingFilesToPendingPackages(
     DWORD FileIndex;
     TCHAR FileIndexString[16];
 
-    if (DllKernel32.pGetPrivateProfileIntW == NULL ||
-        DllKernel32.pGetPrivateProfileSectionW == NULL ||
-        DllKernel32.pGetPrivateProfileStringW == NULL) {
-        return FALSE;
-    }
-
     if (!YoriLibAllocateString(&InstalledSection, YORIPKG_MAX_SECTION_LENGTH)) {
         return FALSE;
     }
@@ -645,10 +675,10 @@ YoriPkgAddExistingFilesToPendingPackages(
     }
 
     InstalledSection.LengthInChars = (YORI_ALLOC_SIZE_T)
-        DllKernel32.pGetPrivateProfileSectionW(_T("Installed"),
-                                               InstalledSection.StartOfString,
-                                               InstalledSection.LengthAllocated,
-                                               PkgIniFile->StartOfString);
+        YoriLibIniGetSection(PkgIni,
+                             _T("Installed"),
+                             InstalledSection.StartOfString,
+                             InstalledSection.LengthAllocated);
 
     YoriLibInitEmptyString(&PkgNameOnly);
     ThisLine = InstalledSection.StartOfString;
@@ -666,18 +696,18 @@ YoriPkgAddExistingFilesToPendingPackages(
         ThisLine++;
         PkgNameOnly.StartOfString[PkgNameOnly.LengthInChars] = '\0';
 
-        FileCount = DllKernel32.pGetPrivateProfileIntW(PkgNameOnly.StartOfString, _T("FileCount"), 0, PkgIniFile->StartOfString);
+        FileCount = YoriLibIniGetInt(PkgIni, PkgNameOnly.StartOfString, _T("FileCount"), 0);
 
         for (FileIndex = 1; FileIndex <= FileCount; FileIndex++) {
             YoriLibSPrintf(FileIndexString, _T("File%i"), FileIndex);
 
             IniValue.LengthInChars = (YORI_ALLOC_SIZE_T)
-                DllKernel32.pGetPrivateProfileStringW(PkgNameOnly.StartOfString,
-                                                      FileIndexString,
-                                                      _T(""),
-                                                      IniValue.StartOfString,
-                                                      IniValue.LengthAllocated,
-                                                      PkgIniFile->StartOfString);
+                YoriLibIniGetString(PkgIni,
+                                    PkgNameOnly.StartOfString,
+                                    FileIndexString,
+                                    _T(""),
+                                    IniValue.StartOfString,
+                                    IniValue.LengthAllocated);
             if (!YoriPkgAddExistingFileToPendingPackages(PendingPackages, &IniValue)) {
                 YoriLibFreeStringContents(&InstalledSection);
                 YoriLibFreeStringContents(&IniValue);
@@ -709,6 +739,7 @@ YoriPkgInitializePendingPackages(
     YoriLibInitializeListHead(&PendingPackages->PackageList);
     YoriLibInitializeListHead(&PendingPackages->BackupPackages);
     YoriLibInitializeListHead(&PendingPackages->KnownPackages);
+    YoriLibInitializeListHead(&PendingPackages->Downloads);
     PendingPackages->ExistingFilesTable = YoriLibAllocateHashTable(253);
     if (PendingPackages->ExistingFilesTable == NULL) {
         return FALSE;
@@ -745,6 +776,7 @@ YoriPkgDeletePendingPackage(
     YoriLibFreeStringContents(&PendingPackage->SymbolPath);
     YoriLibFreeStringContents(&PendingPackage->UpgradeToDailyPath);
     YoriLibFreeStringContents(&PendingPackage->UpgradeToStablePath);
+    YoriLibFreeStringContents(&PendingPackage->UnchangedFiles);
     YoriLibFree(PendingPackage);
 }
 
@@ -773,6 +805,7 @@ YoriPkgDeletePendingPackages(
     ASSERT(YoriLibIsListEmpty(&PendingPackages->BackupPackages));
 
     YoriPkgFreeAllSourcesAndPackages(NULL, &PendingPackages->KnownPackages);
+    YoriPkgFreeDownloads(&PendingPackages->Downloads);
 
     ListEntry = YoriLibGetNextListEntry(&PendingPackages->PackageList, ListEntry);
     while (ListEntry != NULL) {
@@ -790,6 +823,149 @@ YoriPkgDeletePendingPackages(
     }
 }
 
+/**
+ Check whether a delta package can be applied to the installed version of a
+ package.  A delta package only contains files which changed since the
+ version it was generated from, and lists the files it retains from that
+ version along with their digests.  It can only be applied if that version is
+ installed and each retained file on disk still matches its digest.
+
+ @param PkgInfoPath Pointer to the path of the delta package's pkginfo.ini.
+
+ @param TargetDirectory Optionally points to a string containing the install
+        directory.  If not specified, the application directory is used.
+
+ @param InstalledVersion Pointer to the version of the package that is
+        currently installed.
+
+ @param DeltaFrom Pointer to the version that the delta package was
+        generated from.
+
+ @param UnchangedFiles On successful completion, populated with the
+        package's [Files] section listing the files to retain.
+
+ @return ERROR_SUCCESS to indicate the delta package can be applied,
+         ERROR_REVISION_MISMATCH to indicate the complete package should be
+         installed instead, or another Win32 error code.
+ */
+__success(return == ERROR_SUCCESS)
+DWORD
+YoriPkgLoadDeltaPackageFiles(
+    __in PCYORI_STRING PkgInfoPath,
+    __in_opt PCYORI_STRING TargetDirectory,
+    __in PCYORI_STRING InstalledVersion,
+    __in PCYORI_STRING DeltaFrom,
+    __out PYORI_STRING UnchangedFiles
+    )
+{
+    YORI_STRING FilesSection;
+    YORI_STRING FullTargetDirectory;
+    YORI_STRING FilePath;
+    YORI_STRING ExpectedDigest;
+    YORI_STRING Digest;
+    HCRYPTPROV Provider;
+    LPTSTR ThisLine;
+    LPTSTR Equals;
+    YORI_ALLOC_SIZE_T LineLength;
+    DWORD Result;
+
+    YoriLibInitEmptyString(UnchangedFiles);
+
+    if (YoriLibCompareString(InstalledVersion, DeltaFrom) != 0) {
+        return ERROR_REVISION_MISMATCH;
+    }
+
+    YoriLibInitEmptyString(&FilesSection);
+    YoriLibInitEmptyString(&FullTargetDirectory);
+    YoriLibInitEmptyString(&FilePath);
+    YoriLibInitEmptyString(&Digest);
+    Provider = 0;
+
+    if (!YoriLibAllocateString(&FilesSection, YORIPKG_MAX_SECTION_LENGTH) ||
+        !YoriLibAllocateString(&Digest, YORIPKG_HASH_SIZE * 2 + 1)) {
+
+        Result = ERROR_NOT_ENOUGH_MEMORY;
+        goto Exit;
+    }
+
+    if (TargetDirectory != NULL) {
+        if (!YoriLibUserStringToSingleFilePath(TargetDirectory, FALSE, &FullTargetDirectory)) {
+            Result = ERROR_NOT_ENOUGH_MEMORY;
+            goto Exit;
+        }
+    } else {
+        if (!YoriPkgGetApplicationDirectory(&FullTargetDirectory)) {
+            Result = ERROR_NOT_ENOUGH_MEMORY;
+            goto Exit;
+        }
+    }
+
+    //
+    //  If the files can't be verified, the delta can't be applied safely,
+    //  so fall back to the complete package.
+    //
+
+    if (!YoriPkgAcquireHashProvider(&Provider)) {
+        Result = ERROR_REVISION_MISMATCH;
+        goto Exit;
+    }
+
+    FilesSection.LengthInChars = (YORI_ALLOC_SIZE_T)
+        DllKernel32.pGetPrivateProfileSectionW(_T("Files"),
+                                               FilesSection.StartOfString,
+                                               FilesSection.LengthAllocated,
+                                               PkgInfoPath->StartOfString);
+
+    YoriLibInitEmptyString(&ExpectedDigest);
+    ThisLine = FilesSection.StartOfString;
+    Result = ERROR_SUCCESS;
+
+    while (*ThisLine != '\0') {
+        LineLength = (YORI_ALLOC_SIZE_T)_tcslen(ThisLine);
+        Equals = _tcschr(ThisLine, '=');
+        if (Equals == NULL) {
+            Result = ERROR_REVISION_MISMATCH;
+            break;
+        }
+
+        ExpectedDigest.StartOfString = Equals + 1;
+        ExpectedDigest.LengthInChars = (YORI_ALLOC_SIZE_T)(LineLength - (Equals - ThisLine) - 1);
+
+        *Equals = '\0';
+        YoriLibYPrintf(&FilePath, _T("%y\\%s"), &FullTargetDirectory, ThisLine);
+        *Equals = '=';
+        if (FilePath.LengthInChars == 0) {
+            Result = ERROR_NOT_ENOUGH_MEMORY;
+            break;
+        }
+
+        if (!YoriPkgHashFile(Provider, &FilePath, &Digest) ||
+            YoriLibCompareStringIns(&Digest, &ExpectedDigest) != 0) {
+
+            Result = ERROR_REVISION_MISMATCH;
+            break;
+        }
+
+        ThisLine += LineLength;
+        ThisLine++;
+    }
+
+    if (Result == ERROR_SUCCESS) {
+        memcpy(UnchangedFiles, &FilesSection, sizeof(YORI_STRING));
+        YoriLibInitEmptyString(&FilesSection);
+    }
+
+Exit:
+    if (Provider != 0) {
+        DllAdvApi32.pCryptReleaseContext(Provider, 0);
+    }
+    YoriLibFreeStringContents(&FilesSection);
+    YoriLibFreeStringContents(&FullTargetDirectory);
+    YoriLibFreeStringContents(&FilePath);
+    YoriLibFreeStringContents(&Digest);
+    return Result;
+}
+
 /**
  Given a package URL, download if necessary, extract metadata, check if an
  existing package needs to be upgraded or replaced, back up any packages that
@@ -801,7 +977,7 @@ YoriPkgDeletePendingPackages(
  @ref YoriPkgDeletePendingPackages to ensure any backed up files are either
  deleted or restored, and the memory allocated by this routine is freed.
 
- @param PkgIniFile Pointer to the system global INI file.
+ @param PkgIni Pointer to the system global INI file.
 
  @param TargetDirectory Optionally points to a string containing the install
         directory to back up data from.  If not specified, the application
@@ -817,19 +993,21 @@ YoriPkgDeletePendingPackages(
  @param RedirectToPackageUrl On completion may be updated to contain a
         referenced string to a version of the package which should be
         attempted on this system because the PackageUrl requires a newer
-        host operating system.  This is only meaningful if
-        ERROR_OLD_WIN_VERSION is returned.
+        host operating system, or because PackageUrl is a delta package
+        which cannot be applied to the installed files.  This is only
+        meaningful if ERROR_OLD_WIN_VERSION or ERROR_REVISION_MISMATCH is
+        returned.
 
  @return A Win32 error code, including ERROR_SUCCESS to indicate success.
  */
 __success(return == ERROR_SUCCESS)
 DWORD
 YoriPkgPreparePackageForInstall(
-    __in PYORI_STRING PkgIniFile,
+    __in PYORI_LIB_INI PkgIni,
     __in_opt PCYORI_STRING TargetDirectory,
     __inout PYORIPKG_PACKAGES_PENDING_INSTALL PackageList,
     __in PYORI_STRING PackageUrl,
-    __out_opt _On_failure_(_When_(return == ERROR_OLD_WIN_VERSION, _Post_valid_)) PYORI_STRING RedirectToPackageUrl
+    __out_opt _On_failure_(_When_(return == ERROR_OLD_WIN_VERSION || return == ERROR_REVISION_MISMATCH, _Post_valid_)) PYORI_STRING RedirectToPackageUrl
     )
 {
     PYORIPKG_PACKAGE_PENDING_INSTALL PendingPackage;
@@ -840,6 +1018,8 @@ YoriPkgPreparePackageForInstall(
     YORI_STRING ReplacesList;
     YORI_STRING PkgInstalled;
     YORI_STRING PkgToReplace;
+    YORI_STRING DeltaFrom;
+    PYORI_STRING UnchangedFiles;
     YORI_ALLOC_SIZE_T LineLength;
     YORI_MAX_SIGNED_T RequiredBuildNumber;
     YORI_ALLOC_SIZE_T CharsConsumed;
@@ -874,6 +1054,7 @@ YoriPkgPreparePackageForInstall(
 
     YoriLibConstantString(&PkgInfoFile, _T("pkginfo.ini"));
     YoriLibInitEmptyString(&TempPath);
+    YoriLibInitEmptyString(&DeltaFrom);
 
     PendingPackage = YoriLibMalloc(sizeof(YORIPKG_PACKAGE_PENDING_INSTALL));
     if (PendingPackage == NULL) {
@@ -881,7 +1062,20 @@ YoriPkgPreparePackageForInstall(
     }
     ZeroMemory(PendingPackage, sizeof(YORIPKG_PACKAGE_PENDING_INSTALL));
 
-    Result = YoriPkgPackagePathToLocalPath(PackageUrl, PkgIniFile, &PendingPackage->LocalPackagePath, &PendingPackage->DeleteLocalPackagePath);
+    //
+    //  If the package has already been downloaded, use the result of that
+    //  download.  Otherwise use a cached copy if one exists, or download
+    //  it now.
+    //
+
+    if (!YoriPkgTakeDownload(&PackageList->Downloads, PackageUrl, &Result, &PendingPackage->LocalPackagePath, &PendingPackage->DeleteLocalPackagePath)) {
+        if (YoriPkgFindCachedPackage(&PkgIni->FileName, PackageList, PackageUrl, &PendingPackage->LocalPackagePath)) {
+            PendingPackage->DeleteLocalPackagePath = FALSE;
+            Result = ERROR_SUCCESS;
+        } else {
+            Result = YoriPkgPackagePathToLocalPath(PackageUrl, &PkgIni->FileName, &PendingPackage->LocalPackagePath, &PendingPackage->DeleteLocalPackagePath);
+        }
+    }
     if (Result != ERROR_SUCCESS) {
         YoriLibFree(PendingPackage);
         return Result;
@@ -933,6 +1127,41 @@ YoriPkgPreparePackageForInstall(
         goto Exit;
     }
 
+    //
+    //  Check if this is a delta package, which only contains the files that
+    //  changed since a previous version.
+    //
+
+    if (!YoriLibAllocateString(&DeltaFrom, YORIPKG_MAX_FIELD_LENGTH)) {
+        Result = ERROR_NOT_ENOUGH_MEMORY;
+        goto Exit;
+    }
+
+    DeltaFrom.LengthInChars = (YORI_ALLOC_SIZE_T)
+        DllKernel32.pGetPrivateProfileStringW(_T("Package"),
+                                              _T("DeltaFrom"),
+                                              _T(""),
+                                              DeltaFrom.StartOfString,
+                                              DeltaFrom.LengthAllocated,
+                                              TempPath.StartOfString);
+
+    //
+    //  If the package was downloaded, keep a copy in the package cache so
+    //  it doesn't need to be downloaded again.  Delta packages aren't
+    //  cached since they can't be installed in place of the complete
+    //  package for the same version.
+    //
+
+    if (PendingPackage->DeleteLocalPackagePath &&
+        DeltaFrom.LengthInChars == 0 &&
+        YoriLibIsPathUrl(PackageUrl)) {
+        YoriPkgAddPackageToCache(&PkgIni->FileName,
+                                 &PendingPackage->PackageName,
+                                 &PendingPackage->Version,
+                                 &PendingPackage->Architecture,
+                                 &PendingPackage->LocalPackagePath);
+    }
+
     //
     //  Check if a different version of the package being installed
     //  is already present.  If it is, we need to delete it.
@@ -944,12 +1173,12 @@ YoriPkgPreparePackageForInstall(
     }
 
     PkgInstalled.LengthInChars = (YORI_ALLOC_SIZE_T)
-        DllKernel32.pGetPrivateProfileStringW(_T("Installed"),
-                                              PendingPackage->PackageName.StartOfString,
-                                              _T(""),
-                                              PkgInstalled.StartOfString,
-                                              PkgInstalled.LengthAllocated,
-                                              PkgIniFile->StartOfString);
+        YoriLibIniGetString(PkgIni,
+                            _T("Installed"),
+                            PendingPackage->PackageName.StartOfString,
+                            _T(""),
+                            PkgInstalled.StartOfString,
+                            PkgInstalled.LengthAllocated);
 
     //
     //  If the version being installed is already there, we're done.
@@ -987,17 +1216,43 @@ YoriPkgPreparePackageForInstall(
         }
     }
 
+    //
+    //  If this is a delta package, check that it can be applied to the
+    //  installed files.  If not, install the complete package instead.
+    //
+
+    UnchangedFiles = NULL;
+    if (DeltaFrom.LengthInChars > 0) {
+        Result = YoriPkgLoadDeltaPackageFiles(&TempPath, TargetDirectory, &PkgInstalled, &DeltaFrom, &PendingPackage->UnchangedFiles);
+        if (Result != ERROR_SUCCESS) {
+            if (Result == ERROR_REVISION_MISMATCH && RedirectToPackageUrl != NULL &&
+                YoriLibAllocateString(RedirectToPackageUrl, YORIPKG_MAX_FIELD_LENGTH)) {
+
+                RedirectToPackageUrl->LengthInChars = (YORI_ALLOC_SIZE_T)
+                    DllKernel32.pGetPrivateProfileStringW(_T("Package"),
+                                                          _T("FullPackagePath"),
+                                                          _T(""),
+                                                          RedirectToPackageUrl->StartOfString,
+                                                          RedirectToPackageUrl->LengthAllocated,
+                                                          TempPath.StartOfString);
+            }
+            YoriLibFreeStringContents(&PkgInstalled);
+            goto Exit;
+        }
+        UnchangedFiles = &PendingPackage->UnchangedFiles;
+    }
+
     //
     //  Backup the current version
     //
 
     if (PkgInstalled.LengthInChars > 0) {
-        Result = YoriPkgBackupPackage(PkgIniFile, &PendingPackage->PackageName, TargetDirectory, &BackupPackage);
+        Result = YoriPkgBackupPackage(PkgIni, &PendingPackage->PackageName, TargetDirectory, UnchangedFiles, &BackupPackage);
         if (Result != ERROR_SUCCESS) {
             YoriLibFreeStringContents(&PkgInstalled);
             goto Exit;
         }
-        YoriPkgRemoveSystemReferencesToPackage(PkgIniFile, BackupPackage);
+        YoriPkgRemoveSystemReferencesToPackage(PkgIni, BackupPackage);
         YoriLibAppendList(&PackageList->BackupPackages, &BackupPackage->PackageList);
     }
 
@@ -1037,19 +1292,19 @@ YoriPkgPreparePackageForInstall(
         //
 
         PkgInstalled.LengthInChars = (YORI_ALLOC_SIZE_T)
-            DllKernel32.pGetPrivateProfileStringW(_T("Installed"),
-                                                  PkgToReplace.StartOfString,
-                                                  _T(""),
-                                                  PkgInstalled.StartOfString,
-                                                  PkgInstalled.LengthAllocated,
-                                                  PkgIniFile->StartOfString);
+            YoriLibIniGetString(PkgIni,
+                                _T("Installed"),
+                                PkgToReplace.StartOfString,
+                                _T(""),
+                                PkgInstalled.StartOfString,
+                                PkgInstalled.LengthAllocated);
         if (PkgInstalled.LengthInChars > 0) {
-            Result = YoriPkgBackupPackage(PkgIniFile, &PkgToReplace, TargetDirectory, &BackupPackage);
+            Result = YoriPkgBackupPackage(PkgIni, &PkgToReplace, TargetDirectory, NULL, &BackupPackage);
             if (Result != ERROR_SUCCESS) {
                 YoriLibFreeStringContents(&ReplacesList);
                 goto Exit;
             }
-            YoriPkgRemoveSystemReferencesToPackage(PkgIniFile, BackupPackage);
+            YoriPkgRemoveSystemReferencesToPackage(PkgIni, BackupPackage);
             YoriLibAppendList(&PackageList->BackupPackages, &BackupPackage->PackageList);
         }
         ThisLine += LineLength + 1;
@@ -1059,6 +1314,7 @@ YoriPkgPreparePackageForInstall(
 
     DeleteFile(TempPath.StartOfString);
     YoriLibFreeStringContents(&TempPath);
+    YoriLibFreeStringContents(&DeltaFrom);
 
     YoriLibAppendList(&PackageList->PackageList, &PendingPackage->PackageList);
     return ERROR_SUCCESS;
@@ -1069,6 +1325,7 @@ Exit:
         DeleteFile(TempPath.StartOfString);
     }
     YoriLibFreeStringContents(&TempPath);
+    YoriLibFreeStringContents(&DeltaFrom);
     YoriPkgDeletePendingPackage(PendingPackage);
     return Result;
 }
@@ -1084,7 +1341,7 @@ Exit:
  @ref YoriPkgDeletePendingPackages to ensure any backed up files are either
  deleted or restored, and the memory allocated by this routine is freed.
 
- @param PkgIniFile Pointer to the system global INI file.
+ @param PkgIni Pointer to the system global INI file.
 
  @param TargetDirectory Optionally points to a string containing the install
         directory to back up data from.  If not specified, the application
@@ -1102,7 +1359,7 @@ Exit:
  */
 DWORD
 YoriPkgPreparePackageForInstallRedirectBuild(
-    __in PYORI_STRING PkgIniFile,
+    __in PYORI_LIB_INI PkgIni,
     __in_opt PYORI_STRING TargetDirectory,
     __inout PYORIPKG_PACKAGES_PENDING_INSTALL PackageList,
     __in PYORI_STRING PackageUrl
@@ -1117,12 +1374,12 @@ YoriPkgPreparePackageForInstallRedirectBuild(
     YoriLibInitEmptyString(&RedirectedUrl);
     YoriLibInitEmptyString(&PreviousRedirectedUrl);
     UrlToInstall = PackageUrl;
-    do {
+    while (TRUE) {
         if (YoriLibIsPathUrl(UrlToInstall)) {
             YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("Downloading %y...\n"), UrlToInstall);
         }
         YoriLibInitEmptyString(&RedirectedUrl);
-        Error = YoriPkgPreparePackageForInstall(PkgIniFile, TargetDirectory, PackageList, UrlToInstall, &RedirectedUrl);
+        Error = YoriPkgPreparePackageForInstall(PkgIni, TargetDirectory, PackageList, UrlToInstall, &RedirectedUrl);
         YoriLibFreeStringContents(&PreviousRedirectedUrl);
         YoriLibInitEmptyString(&PreviousRedirectedUrl);
 
@@ -1132,10 +1389,15 @@ YoriPkgPreparePackageForInstallRedirectBuild(
             YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("Version not supported on this version of Windows, attempting %y...\n"), UrlToInstall);
             continue;
         }
-        if (Error != ERROR_SUCCESS && Error != ERROR_OLD_WIN_VERSION) {
-            break;
+        if (Error == ERROR_REVISION_MISMATCH && RedirectedUrl.LengthInChars > 0) {
+            memcpy(&PreviousRedirectedUrl, &RedirectedUrl, sizeof(YORI_STRING));
+            UrlToInstall = &PreviousRedirectedUrl;
+            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("Update does not match installed files, attempting %y...\n"), UrlToInstall);
+            continue;
         }
-    } while (Error == ERROR_OLD_WIN_VERSION);
+        YoriLibFreeStringContents(&RedirectedUrl);
+        break;
+    }
 
     return Error;
 }
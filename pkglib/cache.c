@@ -0,0 +1,870 @@
+/**
+ * @file pkglib/cache.c
+ *
+ * Yori package manager local package cache support
+ *
+ * Copyright (c) 2026 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <yoripch.h>
+#include <yorilib.h>
+#include "yoripkg.h"
+#include "yoripkgp.h"
+
+/**
+ The maximum size of a cache directory if the user has not specified one.
+ */
+#define YORIPKG_CACHE_DEFAULT_MAXIMUM_SIZE (1024 * 1024 * 1024)
+
+/**
+ The configuration of the package cache, as loaded from packages.ini.
+ */
+typedef struct _YORIPKG_CACHE_CONFIG {
+
+    /**
+     A fully qualified path to the local cache directory.  This may be empty
+     if no local cache is configured.
+     */
+    YORI_STRING Path;
+
+    /**
+     A fully qualified path to a cache directory shared with other systems,
+     typically a UNC path.  This may be empty if no peer cache is configured.
+     */
+    YORI_STRING PeerPath;
+
+    /**
+     The maximum number of bytes to retain in each cache directory.  When
+     this is exceeded, the least recently used packages are deleted.
+     */
+    LARGE_INTEGER MaximumSize;
+
+    /**
+     A handle to the crypto provider used to generate digests of packages.
+     */
+    HCRYPTPROV Provider;
+
+} YORIPKG_CACHE_CONFIG, *PYORIPKG_CACHE_CONFIG;
+
+/**
+ Read a single path from the [Cache] section of packages.ini and convert it
+ into a fully qualified path.
+
+ @param PkgIniFile Pointer to the path to packages.ini.
+
+ @param KeyName The name of the value to read.
+
+ @param Path On successful completion, updated to contain a fully qualified
+        path.
+
+ @return TRUE to indicate a path was found, FALSE if it was not.
+ */
+__success(return)
+BOOL
+YoriPkgCacheLoadPath(
+    __in PCYORI_STRING PkgIniFile,
+    __in LPCTSTR KeyName,
+    __out PYORI_STRING Path
+    )
+{
+    YORI_STRING IniValue;
+    BOOL Result;
+
+    YoriLibInitEmptyString(Path);
+    if (!YoriLibAllocateString(&IniValue, YORIPKG_MAX_FIELD_LENGTH)) {
+        return FALSE;
+    }
+
+    IniValue.LengthInChars = (YORI_ALLOC_SIZE_T)
+        DllKernel32.pGetPrivateProfileStringW(_T("Cache"),
+                                              KeyName,
+                                              _T(""),
+                                              IniValue.StartOfString,
+                                              IniValue.LengthAllocated,
+                                              PkgIniFile->StartOfString);
+
+    Result = FALSE;
+    if (IniValue.LengthInChars > 0) {
+        Result = YoriLibUserStringToSingleFilePath(&IniValue, TRUE, Path);
+    }
+
+    YoriLibFreeStringContents(&IniValue);
+    return Result;
+}
+
+/**
+ Free the configuration of the package cache.
+
+ @param Config Pointer to the cache configuration to free.
+ */
+VOID
+YoriPkgCacheFreeConfig(
+    __inout PYORIPKG_CACHE_CONFIG Config
+    )
+{
+    if (Config->Provider != 0) {
+        DllAdvApi32.pCryptReleaseContext(Config->Provider, 0);
+        Config->Provider = 0;
+    }
+    YoriLibFreeStringContents(&Config->Path);
+    YoriLibFreeStringContents(&Config->PeerPath);
+}
+
+/**
+ Load the configuration of the package cache from packages.ini.  The cache
+ is configured in the [Cache] section, where Path refers to a local
+ directory, PeerPath refers to a directory shared with other systems, and
+ MaximumSize specifies the number of bytes to retain in each directory.
+
+ @param PkgIniFile Pointer to the path to packages.ini.
+
+ @param Config On successful completion, populated with the cache
+        configuration.  The caller should free this with
+        @ref YoriPkgCacheFreeConfig .
+
+ @return TRUE to indicate a package cache is configured and can be used,
+         FALSE if it cannot.
+ */
+__success(return)
+BOOL
+YoriPkgCacheLoadConfig(
+    __in PCYORI_STRING PkgIniFile,
+    __out PYORIPKG_CACHE_CONFIG Config
+    )
+{
+    YORI_STRING IniValue;
+
+    ZeroMemory(Config, sizeof(YORIPKG_CACHE_CONFIG));
+
+    if (DllKernel32.pGetPrivateProfileStringW == NULL) {
+        return FALSE;
+    }
+
+    YoriPkgCacheLoadPath(PkgIniFile, _T("Path"), &Config->Path);
+    YoriPkgCacheLoadPath(PkgIniFile, _T("PeerPath"), &Config->PeerPath);
+    if (Config->Path.LengthInChars == 0 && Config->PeerPath.LengthInChars == 0) {
+        YoriPkgCacheFreeConfig(Config);
+        return FALSE;
+    }
+
+    Config->MaximumSize.QuadPart = YORIPKG_CACHE_DEFAULT_MAXIMUM_SIZE;
+    if (YoriLibAllocateString(&IniValue, YORIPKG_MAX_FIELD_LENGTH)) {
+        IniValue.LengthInChars = (YORI_ALLOC_SIZE_T)
+            DllKernel32.pGetPrivateProfileStringW(_T("Cache"),
+                                                  _T("MaximumSize"),
+                                                  _T(""),
+                                                  IniValue.StartOfString,
+                                                  IniValue.LengthAllocated,
+                                                  PkgIniFile->StartOfString);
+        if (IniValue.LengthInChars > 0) {
+            Config->MaximumSize = YoriLibStringToFileSize(&IniValue);
+        }
+        YoriLibFreeStringContents(&IniValue);
+    }
+
+    if (!YoriPkgAcquireHashProvider(&Config->Provider)) {
+        YoriPkgCacheFreeConfig(Config);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ Append a component of a package's identity to the name of a cached package.
+ Characters which are not letters, numbers or periods are replaced so the
+ name is valid on any file system and the separators between components are
+ unambiguous.
+
+ @param Prefix Pointer to the string being constructed.  This is assumed to
+        have sufficient space for the component plus a separator.
+
+ @param Component Pointer to the component to append.
+ */
+VOID
+YoriPkgCacheAppendNameComponent(
+    __inout PYORI_STRING Prefix,
+    __in PCYORI_STRING Component
+    )
+{
+    YORI_ALLOC_SIZE_T Index;
+    TCHAR Char;
+
+    for (Index = 0; Index < Component->LengthInChars; Index++) {
+        Char = Component->StartOfString[Index];
+        if (!((Char >= 'a' && Char <= 'z') ||
+              (Char >= 'A' && Char <= 'Z') ||
+              (Char >= '0' && Char <= '9') ||
+              Char == '.')) {
+            Char = '_';
+        }
+        Prefix->StartOfString[Prefix->LengthInChars] = Char;
+        Prefix->LengthInChars++;
+    }
+    Prefix->StartOfString[Prefix->LengthInChars] = '-';
+    Prefix->LengthInChars++;
+    Prefix->StartOfString[Prefix->LengthInChars] = '\0';
+}
+
+/**
+ Generate the prefix of the file name used to cache a package.  Packages are
+ cached as name-version-arch-digest.cab, so this prefix identifies all cached
+ copies of a particular version of a package.
+
+ @param PackageName Pointer to the name of the package.
+
+ @param Version Pointer to the version of the package.
+
+ @param Architecture Pointer to the architecture of the package.
+
+ @param Prefix On successful completion, updated to contain a newly
+        allocated prefix.  This has space to append the digest and
+        extension.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriPkgCacheBuildPrefix(
+    __in PCYORI_STRING PackageName,
+    __in PCYORI_STRING Version,
+    __in PCYORI_STRING Architecture,
+    __out PYORI_STRING Prefix
+    )
+{
+    YORI_ALLOC_SIZE_T LengthNeeded;
+
+    LengthNeeded = (YORI_ALLOC_SIZE_T)(PackageName->LengthInChars + Version->LengthInChars + Architecture->LengthInChars + 3 + YORIPKG_HASH_SIZE * 2 + sizeof(".cab"));
+    if (!YoriLibAllocateString(Prefix, LengthNeeded)) {
+        return FALSE;
+    }
+
+    Prefix->LengthInChars = 0;
+    YoriPkgCacheAppendNameComponent(Prefix, PackageName);
+    YoriPkgCacheAppendNameComponent(Prefix, Version);
+    YoriPkgCacheAppendNameComponent(Prefix, Architecture);
+    return TRUE;
+}
+
+/**
+ Update the last write time of a cached package to indicate it has been
+ used, so that it is retained in preference to packages which have not been
+ used recently.
+
+ @param FilePath Pointer to the path of the cached package.
+ */
+VOID
+YoriPkgCacheMarkUsed(
+    __in PCYORI_STRING FilePath
+    )
+{
+    HANDLE FileHandle;
+    FILETIME Now;
+
+    FileHandle = CreateFile(FilePath->StartOfString,
+                            FILE_WRITE_ATTRIBUTES,
+                            FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                            NULL,
+                            OPEN_EXISTING,
+                            FILE_ATTRIBUTE_NORMAL,
+                            NULL);
+
+    if (FileHandle == INVALID_HANDLE_VALUE) {
+        return;
+    }
+
+    GetSystemTimeAsFileTime(&Now);
+    SetFileTime(FileHandle, NULL, NULL, &Now);
+    CloseHandle(FileHandle);
+}
+
+/**
+ Search a cache directory for a package whose name starts with a specified
+ prefix, and whose contents match the digest in its name.
+
+ @param Config Pointer to the cache configuration.
+
+ @param Directory Pointer to the cache directory to search.
+
+ @param Prefix Pointer to the prefix of the cached package name.
+
+ @param DeleteCorrupt If TRUE, any package whose contents do not match its
+        name is deleted.  This is appropriate for the local cache, which
+        this system manages.
+
+ @param FoundPath On successful completion, updated to contain the fully
+        qualified path to the cached package.
+
+ @return TRUE to indicate a valid cached package was found, FALSE if it was
+         not.
+ */
+__success(return)
+BOOL
+YoriPkgCacheFindInDirectory(
+    __in PYORIPKG_CACHE_CONFIG Config,
+    __in PCYORI_STRING Directory,
+    __in PCYORI_STRING Prefix,
+    __in BOOLEAN DeleteCorrupt,
+    __out PYORI_STRING FoundPath
+    )
+{
+    YORI_STRING SearchPath;
+    YORI_STRING FileName;
+    YORI_STRING NameDigest;
+    YORI_STRING Digest;
+    WIN32_FIND_DATA FindData;
+    HANDLE FindHandle;
+    BOOL Found;
+
+    YoriLibInitEmptyString(FoundPath);
+
+    if (!YoriLibAllocateString(&SearchPath, Directory->LengthInChars + 1 + Prefix->LengthInChars + MAX_PATH)) {
+        return FALSE;
+    }
+
+    if (!YoriLibAllocateString(&Digest, YORIPKG_HASH_SIZE * 2 + 1)) {
+        YoriLibFreeStringContents(&SearchPath);
+        return FALSE;
+    }
+
+    SearchPath.LengthInChars = YoriLibSPrintf(SearchPath.StartOfString, _T("%y\\%y*.cab"), Directory, Prefix);
+
+    FindHandle = FindFirstFile(SearchPath.StartOfString, &FindData);
+    if (FindHandle == INVALID_HANDLE_VALUE) {
+        YoriLibFreeStringContents(&Digest);
+        YoriLibFreeStringContents(&SearchPath);
+        return FALSE;
+    }
+
+    Found = FALSE;
+    do {
+        YoriLibConstantString(&FileName, FindData.cFileName);
+        if (FileName.LengthInChars != Prefix->LengthInChars + YORIPKG_HASH_SIZE * 2 + sizeof(".cab") - 1 ||
+            (FindData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0) {
+            continue;
+        }
+
+        YoriLibInitEmptyString(&NameDigest);
+        NameDigest.StartOfString = &FileName.StartOfString[Prefix->LengthInChars];
+        NameDigest.LengthInChars = YORIPKG_HASH_SIZE * 2;
+
+        SearchPath.LengthInChars = YoriLibSPrintf(SearchPath.StartOfString, _T("%y\\%y"), Directory, &FileName);
+        if (YoriPkgHashFile(Config->Provider, &SearchPath, &Digest) &&
+            YoriLibCompareStringIns(&Digest, &NameDigest) == 0) {
+
+            Found = TRUE;
+            break;
+        }
+
+        if (DeleteCorrupt) {
+            DeleteFile(SearchPath.StartOfString);
+        }
+
+    } while (FindNextFile(FindHandle, &FindData));
+
+    FindClose(FindHandle);
+    YoriLibFreeStringContents(&Digest);
+
+    if (!Found) {
+        YoriLibFreeStringContents(&SearchPath);
+        return FALSE;
+    }
+
+    memcpy(FoundPath, &SearchPath, sizeof(YORI_STRING));
+    return TRUE;
+}
+
+/**
+ Delete the least recently used packages from a cache directory until the
+ total size of packages in the directory is within the configured maximum.
+
+ @param Config Pointer to the cache configuration.
+
+ @param Directory Pointer to the cache directory to trim.
+ */
+VOID
+YoriPkgCacheTrimDirectory(
+    __in PYORIPKG_CACHE_CONFIG Config,
+    __in PCYORI_STRING Directory
+    )
+{
+    YORI_STRING SearchPath;
+    WIN32_FIND_DATA FindData;
+    HANDLE FindHandle;
+    LARGE_INTEGER TotalSize;
+    LARGE_INTEGER FileSize;
+    FILETIME OldestTime;
+    TCHAR OldestName[MAX_PATH];
+    BOOLEAN OldestFound;
+
+    if (!YoriLibAllocateString(&SearchPath, Directory->LengthInChars + 1 + MAX_PATH)) {
+        return;
+    }
+
+    //
+    //  Each pass finds the total size and the least recently used package.
+    //  If the total is too large, the oldest package is deleted and the
+    //  directory is scanned again.
+    //
+
+    while (TRUE) {
+        SearchPath.LengthInChars = YoriLibSPrintf(SearchPath.StartOfString, _T("%y\\*.cab"), Directory);
+        FindHandle = FindFirstFile(SearchPath.StartOfString, &FindData);
+        if (FindHandle == INVALID_HANDLE_VALUE) {
+            break;
+        }
+
+        TotalSize.QuadPart = 0;
+        OldestFound = FALSE;
+        OldestTime.dwLowDateTime = 0;
+        OldestTime.dwHighDateTime = 0;
+        do {
+            if ((FindData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0) {
+                continue;
+            }
+
+            FileSize.LowPart = FindData.nFileSizeLow;
+            FileSize.HighPart = FindData.nFileSizeHigh;
+            TotalSize.QuadPart = TotalSize.QuadPart + FileSize.QuadPart;
+
+            if (!OldestFound || CompareFileTime(&FindData.ftLastWriteTime, &OldestTime) < 0) {
+                OldestFound = TRUE;
+                OldestTime = FindData.ftLastWriteTime;
+                YoriLibSPrintfS(OldestName, sizeof(OldestName)/sizeof(OldestName[0]), _T("%s"), FindData.cFileName);
+            }
+        } while (FindNextFile(FindHandle, &FindData));
+        FindClose(FindHandle);
+
+        if (!OldestFound || TotalSize.QuadPart <= Config->MaximumSize.QuadPart) {
+            break;
+        }
+
+        SearchPath.LengthInChars = YoriLibSPrintf(SearchPath.StartOfString, _T("%y\\%s"), Directory, OldestName);
+        if (!DeleteFile(SearchPath.StartOfString)) {
+            break;
+        }
+    }
+
+    YoriLibFreeStringContents(&SearchPath);
+}
+
+/**
+ Copy a package into a cache directory.  The package is copied to a
+ temporary name and renamed once complete, so that other processes using the
+ cache never observe a partially written package.  If the package is already
+ present, it is marked as used.
+
+ @param Directory Pointer to the cache directory.
+
+ @param FileName Pointer to the file name of the package within the cache.
+
+ @param SourcePath Pointer to the package to copy.
+
+ @param CachedPath Optionally points to a string to receive the fully
+        qualified path to the cached package.
+
+ @return TRUE to indicate the package is in the cache, FALSE if it is not.
+ */
+__success(return)
+BOOL
+YoriPkgCacheCopyToDirectory(
+    __in PCYORI_STRING Directory,
+    __in PCYORI_STRING FileName,
+    __in PCYORI_STRING SourcePath,
+    __out_opt PYORI_STRING CachedPath
+    )
+{
+    YORI_STRING TargetPath;
+    YORI_STRING TempPath;
+    YORI_STRING DirectoryCopy;
+    YORI_STRING TempPrefix;
+
+    if (CachedPath != NULL) {
+        YoriLibInitEmptyString(CachedPath);
+    }
+
+    if (!YoriLibAllocateString(&TargetPath, Directory->LengthInChars + 1 + FileName->LengthInChars + 1)) {
+        return FALSE;
+    }
+
+    TargetPath.LengthInChars = YoriLibSPrintf(TargetPath.StartOfString, _T("%y\\%y"), Directory, FileName);
+
+    if (GetFileAttributes(TargetPath.StartOfString) == (DWORD)-1) {
+
+        if (!YoriLibCopyString(&DirectoryCopy, Directory)) {
+            YoriLibFreeStringContents(&TargetPath);
+            return FALSE;
+        }
+        YoriLibCreateDirectoryAndParents(&DirectoryCopy);
+
+        YoriLibConstantString(&TempPrefix, _T("ypc"));
+        if (!YoriLibGetTempFileName(&DirectoryCopy, &TempPrefix, NULL, &TempPath)) {
+            YoriLibFreeStringContents(&DirectoryCopy);
+            YoriLibFreeStringContents(&TargetPath);
+            return FALSE;
+        }
+        YoriLibFreeStringContents(&DirectoryCopy);
+
+        if (!CopyFile(SourcePath->StartOfString, TempPath.StartOfString, FALSE)) {
+            DeleteFile(TempPath.StartOfString);
+            YoriLibFreeStringContents(&TempPath);
+            YoriLibFreeStringContents(&TargetPath);
+            return FALSE;
+        }
+
+        //
+        //  If another process added the same package concurrently, its
+        //  contents are identical, so discard this copy and use that one.
+        //
+
+        if (!MoveFileEx(TempPath.StartOfString, TargetPath.StartOfString, 0)) {
+            DeleteFile(TempPath.StartOfString);
+            if (GetFileAttributes(TargetPath.StartOfString) == (DWORD)-1) {
+                YoriLibFreeStringContents(&TempPath);
+                YoriLibFreeStringContents(&TargetPath);
+                return FALSE;
+            }
+        }
+        YoriLibFreeStringContents(&TempPath);
+    }
+
+    YoriPkgCacheMarkUsed(&TargetPath);
+
+    if (CachedPath != NULL) {
+        memcpy(CachedPath, &TargetPath, sizeof(YORI_STRING));
+    } else {
+        YoriLibFreeStringContents(&TargetPath);
+    }
+
+    return TRUE;
+}
+
+/**
+ Find the package metadata which describes a package URL.  This metadata is
+ obtained from pkglist.ini on remote sources and is used to identify a
+ package before it has been downloaded.
+
+ @param PkgIniFile Pointer to the path to packages.ini, used to apply mirrors
+        to the URL.
+
+ @param PackageList Pointer to the set of packages being operated on, which
+        contains the packages known from remote sources.
+
+ @param PackageUrl Pointer to the URL of the package.
+
+ @return Pointer to the known package, or NULL if the package is not known.
+ */
+PYORIPKG_REMOTE_PACKAGE
+YoriPkgCacheFindKnownPackage(
+    __in PCYORI_STRING PkgIniFile,
+    __in PYORIPKG_PACKAGES_PENDING_INSTALL PackageList,
+    __in PYORI_STRING PackageUrl
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PYORIPKG_REMOTE_PACKAGE KnownPackage;
+    YORI_STRING MirroredPath;
+    PYORIPKG_REMOTE_PACKAGE Result;
+
+    YoriLibInitEmptyString(&MirroredPath);
+    if (!YoriPkgConvertUserPackagePathToMirroredPath(PackageUrl, PkgIniFile, &MirroredPath)) {
+        YoriLibInitEmptyString(&MirroredPath);
+    }
+
+    Result = NULL;
+    ListEntry = YoriLibGetNextListEntry(&PackageList->KnownPackages, NULL);
+    while (ListEntry != NULL) {
+        KnownPackage = CONTAINING_RECORD(ListEntry, YORIPKG_REMOTE_PACKAGE, PackageList);
+        if (YoriLibCompareString(PackageUrl, &KnownPackage->InstallUrl) == 0 ||
+            (MirroredPath.LengthInChars > 0 &&
+             YoriLibCompareString(&MirroredPath, &KnownPackage->InstallUrl) == 0)) {
+
+            Result = KnownPackage;
+            break;
+        }
+        ListEntry = YoriLibGetNextListEntry(&PackageList->KnownPackages, ListEntry);
+    }
+
+    YoriLibFreeStringContents(&MirroredPath);
+    return Result;
+}
+
+/**
+ Look for a package in the local cache, followed by the peer cache, using a
+ loaded cache configuration.  If the package is found in the peer cache, it
+ is copied to the local cache.
+
+ @param Config Pointer to the cache configuration.
+
+ @param PkgIniFile Pointer to the path to packages.ini.
+
+ @param PackageList Pointer to the set of packages being operated on.
+
+ @param PackageUrl Pointer to the URL of the package.
+
+ @param LocalPath On successful completion, updated to contain the path to
+        the cached package.  This file should not be deleted by the caller.
+
+ @return TRUE to indicate the package was found in a cache, FALSE if it was
+         not.
+ */
+__success(return)
+BOOL
+YoriPkgCacheFindWithConfig(
+    __in PYORIPKG_CACHE_CONFIG Config,
+    __in PCYORI_STRING PkgIniFile,
+    __in PYORIPKG_PACKAGES_PENDING_INSTALL PackageList,
+    __in PYORI_STRING PackageUrl,
+    __out PYORI_STRING LocalPath
+    )
+{
+    PYORIPKG_REMOTE_PACKAGE KnownPackage;
+    YORI_STRING Prefix;
+    YORI_STRING PeerPath;
+    YORI_STRING FileName;
+    YORI_ALLOC_SIZE_T Index;
+
+    if (!YoriLibIsPathUrl(PackageUrl)) {
+        return FALSE;
+    }
+
+    KnownPackage = YoriPkgCacheFindKnownPackage(PkgIniFile, PackageList, PackageUrl);
+    if (KnownPackage == NULL ||
+        KnownPackage->Version.LengthInChars == 0 ||
+        KnownPackage->Architecture.LengthInChars == 0) {
+
+        return FALSE;
+    }
+
+    if (!YoriPkgCacheBuildPrefix(&KnownPackage->PackageName, &KnownPackage->Version, &KnownPackage->Architecture, &Prefix)) {
+        return FALSE;
+    }
+
+    if (Config->Path.LengthInChars > 0 &&
+        YoriPkgCacheFindInDirectory(Config, &Config->Path, &Prefix, TRUE, LocalPath)) {
+
+        YoriPkgCacheMarkUsed(LocalPath);
+        YoriLibFreeStringContents(&Prefix);
+        return TRUE;
+    }
+
+    if (Config->PeerPath.LengthInChars == 0 ||
+        !YoriPkgCacheFindInDirectory(Config, &Config->PeerPath, &Prefix, FALSE, &PeerPath)) {
+
+        YoriLibFreeStringContents(&Prefix);
+        return FALSE;
+    }
+
+    YoriLibFreeStringContents(&Prefix);
+    YoriPkgCacheMarkUsed(&PeerPath);
+
+    //
+    //  Copy the package from the peer to the local cache so the next
+    //  install doesn't need the peer.  If that fails, install from the
+    //  peer directly.
+    //
+
+    if (Config->Path.LengthInChars > 0) {
+        YoriLibInitEmptyString(&FileName);
+        for (Index = PeerPath.LengthInChars; Index > 0; Index--) {
+            if (YoriLibIsSep(PeerPath.StartOfString[Index - 1])) {
+                FileName.StartOfString = &PeerPath.StartOfString[Index];
+                FileName.LengthInChars = PeerPath.LengthInChars - Index;
+                break;
+            }
+        }
+
+        if (FileName.LengthInChars > 0 &&
+            YoriPkgCacheCopyToDirectory(&Config->Path, &FileName, &PeerPath, LocalPath)) {
+
+            YoriLibFreeStringContents(&PeerPath);
+            YoriPkgCacheTrimDirectory(Config, &Config->Path);
+            return TRUE;
+        }
+    }
+
+    memcpy(LocalPath, &PeerPath, sizeof(YORI_STRING));
+    return TRUE;
+}
+
+/**
+ Look for a package in the package cache.  The package is identified by
+ name, version and architecture from the metadata published by its remote
+ source, and its contents are verified against the digest recorded in the
+ cached file name.
+
+ @param PkgIniFile Pointer to the path to packages.ini.
+
+ @param PackageList Pointer to the set of packages being operated on, which
+        contains the packages known from remote sources.
+
+ @param PackageUrl Pointer to the URL of the package.
+
+ @param LocalPath On successful completion, updated to contain the path to
+        the cached package.  This file should not be deleted by the caller.
+
+ @return TRUE to indicate the package was found in a cache, FALSE if it was
+         not.
+ */
+__success(return)
+BOOL
+YoriPkgFindCachedPackage(
+    __in PCYORI_STRING PkgIniFile,
+    __in PYORIPKG_PACKAGES_PENDING_INSTALL PackageList,
+    __in PYORI_STRING PackageUrl,
+    __out PYORI_STRING LocalPath
+    )
+{
+    YORIPKG_CACHE_CONFIG Config;
+    BOOL Result;
+
+    if (!YoriLibIsPathUrl(PackageUrl) ||
+        YoriLibIsListEmpty(&PackageList->KnownPackages)) {
+        return FALSE;
+    }
+
+    if (!YoriPkgCacheLoadConfig(PkgIniFile, &Config)) {
+        return FALSE;
+    }
+
+    Result = YoriPkgCacheFindWithConfig(&Config, PkgIniFile, PackageList, PackageUrl, LocalPath);
+    YoriPkgCacheFreeConfig(&Config);
+    return Result;
+}
+
+/**
+ Satisfy any queued downloads from the package cache, so that only packages
+ which are not cached are downloaded.
+
+ @param PkgIniFile Pointer to the path to packages.ini.
+
+ @param PackageList Pointer to the set of packages being operated on, which
+        contains the list of downloads and the packages known from remote
+        sources.
+ */
+VOID
+YoriPkgResolveDownloadsFromCache(
+    __in PCYORI_STRING PkgIniFile,
+    __inout PYORIPKG_PACKAGES_PENDING_INSTALL PackageList
+    )
+{
+    YORIPKG_CACHE_CONFIG Config;
+    PYORI_LIST_ENTRY ListEntry;
+    PYORIPKG_DOWNLOAD Download;
+
+    if (YoriLibIsListEmpty(&PackageList->KnownPackages) ||
+        YoriLibIsListEmpty(&PackageList->Downloads)) {
+        return;
+    }
+
+    if (!YoriPkgCacheLoadConfig(PkgIniFile, &Config)) {
+        return;
+    }
+
+    ListEntry = YoriLibGetNextListEntry(&PackageList->Downloads, NULL);
+    while (ListEntry != NULL) {
+        Download = CONTAINING_RECORD(ListEntry, YORIPKG_DOWNLOAD, ListEntry);
+        if (Download->State == YoriPkgDownloadQueued &&
+            YoriPkgCacheFindWithConfig(&Config, PkgIniFile, PackageList, &Download->PackagePath, &Download->LocalPath)) {
+
+            Download->Error = ERROR_SUCCESS;
+            Download->DeleteWhenFinished = FALSE;
+            Download->State = YoriPkgDownloadComplete;
+        }
+        ListEntry = YoriLibGetNextListEntry(&PackageList->Downloads, ListEntry);
+    }
+
+    YoriPkgCacheFreeConfig(&Config);
+}
+
+/**
+ Add a downloaded package to the package cache.  The package is added to the
+ local cache and, if configured, the peer cache, and the least recently used
+ packages are removed if either exceeds its maximum size.  Failure to cache
+ a package is not an error.
+
+ @param PkgIniFile Pointer to the path to packages.ini.
+
+ @param PackageName Pointer to the name of the package.
+
+ @param Version Pointer to the version of the package.
+
+ @param Architecture Pointer to the architecture of the package.
+
+ @param LocalPath Pointer to the downloaded package.
+ */
+VOID
+YoriPkgAddPackageToCache(
+    __in PCYORI_STRING PkgIniFile,
+    __in PCYORI_STRING PackageName,
+    __in PCYORI_STRING Version,
+    __in PCYORI_STRING Architecture,
+    __in PCYORI_STRING LocalPath
+    )
+{
+    YORIPKG_CACHE_CONFIG Config;
+    YORI_STRING FileName;
+    YORI_STRING Digest;
+
+    if (PackageName->LengthInChars == 0 ||
+        Version->LengthInChars == 0 ||
+        Architecture->LengthInChars == 0) {
+        return;
+    }
+
+    if (!YoriPkgCacheLoadConfig(PkgIniFile, &Config)) {
+        return;
+    }
+
+    if (!YoriLibAllocateString(&Digest, YORIPKG_HASH_SIZE * 2 + 1)) {
+        YoriPkgCacheFreeConfig(&Config);
+        return;
+    }
+
+    if (!YoriPkgHashFile(Config.Provider, LocalPath, &Digest) ||
+        !YoriPkgCacheBuildPrefix(PackageName, Version, Architecture, &FileName)) {
+
+        YoriLibFreeStringContents(&Digest);
+        YoriPkgCacheFreeConfig(&Config);
+        return;
+    }
+
+    YoriLibSPrintf(&FileName.StartOfString[FileName.LengthInChars], _T("%y.cab"), &Digest);
+    FileName.LengthInChars = (YORI_ALLOC_SIZE_T)(FileName.LengthInChars + Digest.LengthInChars + sizeof(".cab") - 1);
+
+    if (Config.Path.LengthInChars > 0 &&
+        YoriPkgCacheCopyToDirectory(&Config.Path, &FileName, LocalPath, NULL)) {
+
+        YoriPkgCacheTrimDirectory(&Config, &Config.Path);
+    }
+
+    if (Config.PeerPath.LengthInChars > 0 &&
+        YoriPkgCacheCopyToDirectory(&Config.PeerPath, &FileName, LocalPath, NULL)) {
+
+        YoriPkgCacheTrimDirectory(&Config, &Config.PeerPath);
+    }
+
+    YoriLibFreeStringContents(&FileName);
+    YoriLibFreeStringContents(&Digest);
+    YoriPkgCacheFreeConfig(&Config);
+}
+
+// vim:sw=4:ts=4:et:
@@ -105,13 +105,10 @@ YoriPkgCreateBinaryPackage(
     PVOID LineContext = NULL;
     HANDLE FileListSource;
     YORI_ALLOC_SIZE_T Count;
+    YORI_LIB_INI PkgInfo;
 
     PVOID CabHandle;
 
-    if (DllKernel32.pWritePrivateProfileStringW == NULL) {
-        return FALSE;
-    }
-
     __analysis_assume(ReplaceCount == 0 || Replaces != NULL);
 
     //
@@ -140,35 +137,49 @@ YoriPkgCreateBinaryPackage(
     TempFile.LengthInChars = (YORI_ALLOC_SIZE_T)_tcslen(TempFile.StartOfString);
     YoriLibFreeStringContents(&TempPath);
 
-    DllKernel32.pWritePrivateProfileStringW(_T("Package"), _T("Name"), PackageName->StartOfString, TempFile.StartOfString);
-    DllKernel32.pWritePrivateProfileStringW(_T("Package"), _T("Architecture"), Architecture->StartOfString, TempFile.StartOfString);
-    DllKernel32.pWritePrivateProfileStringW(_T("Package"), _T("Version"), Version->StartOfString, TempFile.StartOfString);
+    if (!YoriLibIniLoad(&PkgInfo, &TempFile)) {
+        DeleteFile(TempFile.StartOfString);
+        YoriLibFreeStringContents(&TempFile);
+        return FALSE;
+    }
+
+    YoriLibIniSetString(&PkgInfo, _T("Package"), _T("Name"), PackageName->StartOfString);
+    YoriLibIniSetString(&PkgInfo, _T("Package"), _T("Architecture"), Architecture->StartOfString);
+    YoriLibIniSetString(&PkgInfo, _T("Package"), _T("Version"), Version->StartOfString);
     if (MinimumOSBuild != NULL) {
-        DllKernel32.pWritePrivateProfileStringW(_T("Package"), _T("MinimumOSBuild"), MinimumOSBuild->StartOfString, TempFile.StartOfString);
+        YoriLibIniSetString(&PkgInfo, _T("Package"), _T("MinimumOSBuild"), MinimumOSBuild->StartOfString);
         if (PackagePathForOlderBuilds != NULL) {
-            DllKernel32.pWritePrivateProfileStringW(_T("Package"), _T("PackagePathForOlderBuilds"), PackagePathForOlderBuilds->StartOfString, TempFile.StartOfString);
+            YoriLibIniSetString(&PkgInfo, _T("Package"), _T("PackagePathForOlderBuilds"), PackagePathForOlderBuilds->StartOfString);
         }
     }
     if (UpgradePath != NULL) {
-        DllKernel32.pWritePrivateProfileStringW(_T("Package"), _T("UpgradePath"), UpgradePath->StartOfString, TempFile.StartOfString);
+        YoriLibIniSetString(&PkgInfo, _T("Package"), _T("UpgradePath"), UpgradePath->StartOfString);
     }
     if (SourcePath != NULL) {
-        DllKernel32.pWritePrivateProfileStringW(_T("Package"), _T("SourcePath"), SourcePath->StartOfString, TempFile.StartOfString);
+        YoriLibIniSetString(&PkgInfo, _T("Package"), _T("SourcePath"), SourcePath->StartOfString);
     }
     if (SymbolPath != NULL) {
-        DllKernel32.pWritePrivateProfileStringW(_T("Package"), _T("SymbolPath"), SymbolPath->StartOfString, TempFile.StartOfString);
+        YoriLibIniSetString(&PkgInfo, _T("Package"), _T("SymbolPath"), SymbolPath->StartOfString);
     }
     if (UpgradeToStablePath != NULL) {
-        DllKernel32.pWritePrivateProfileStringW(_T("Package"), _T("UpgradeToStablePath"), UpgradeToStablePath->StartOfString, TempFile.StartOfString);
+        YoriLibIniSetString(&PkgInfo, _T("Package"), _T("UpgradeToStablePath"), UpgradeToStablePath->StartOfString);
     }
     if (UpgradeToDailyPath != NULL) {
-        DllKernel32.pWritePrivateProfileStringW(_T("Package"), _T("UpgradeToDailyPath"), UpgradeToDailyPath->StartOfString, TempFile.StartOfString);
+        YoriLibIniSetString(&PkgInfo, _T("Package"), _T("UpgradeToDailyPath"), UpgradeToDailyPath->StartOfString);
     }
 
     for (Count = 0; Count < ReplaceCount; Count++) {
-        DllKernel32.pWritePrivateProfileStringW(_T("Replaces"), Replaces[Count].StartOfString, _T("1"), TempFile.StartOfString);
+        YoriLibIniSetString(&PkgInfo, _T("Replaces"), Replaces[Count].StartOfString, _T("1"));
     }
 
+    if (!YoriLibIniFlush(&PkgInfo)) {
+        YoriLibIniCleanup(&PkgInfo);
+        DeleteFile(TempFile.StartOfString);
+        YoriLibFreeStringContents(&TempFile);
+        return FALSE;
+    }
+    YoriLibIniCleanup(&PkgInfo);
+
     if (!YoriLibUserStringToSingleFilePath(FileListFile, TRUE, &FullFileListFile)) {
         YoriLibFreeStringContents(&TempFile);
         return FALSE;
@@ -576,6 +587,7 @@ YoriPkgCreateSourcePackage(
     YORI_STRING TempFile;
     YORI_STRING PkgInfoName;
     YORI_STRING ExcludeFilePath;
+    YORI_LIB_INI PkgInfo;
     YORIPKG_CREATE_SOURCE_CONTEXT CreateSourceContext;
 
     ZeroMemory(&CreateSourceContext, sizeof(CreateSourceContext));
@@ -608,9 +620,23 @@ YoriPkgCreateSourcePackage(
     TempFile.LengthInChars = (YORI_ALLOC_SIZE_T)_tcslen(TempFile.StartOfString);
     YoriLibFreeStringContents(&TempPath);
 
-    DllKernel32.pWritePrivateProfileStringW(_T("Package"), _T("Name"), PackageName->StartOfString, TempFile.StartOfString);
-    DllKernel32.pWritePrivateProfileStringW(_T("Package"), _T("Version"), Version->StartOfString, TempFile.StartOfString);
-    DllKernel32.pWritePrivateProfileStringW(_T("Package"), _T("Architecture"), _T("noarch"), TempFile.StartOfString);
+    if (!YoriLibIniLoad(&PkgInfo, &TempFile)) {
+        DeleteFile(TempFile.StartOfString);
+        YoriLibFreeStringContents(&TempFile);
+        return FALSE;
+    }
+
+    YoriLibIniSetString(&PkgInfo, _T("Package"), _T("Name"), PackageName->StartOfString);
+    YoriLibIniSetString(&PkgInfo, _T("Package"), _T("Version"), Version->StartOfString);
+    YoriLibIniSetString(&PkgInfo, _T("Package"), _T("Architecture"), _T("noarch"));
+
+    if (!YoriLibIniFlush(&PkgInfo)) {
+        YoriLibIniCleanup(&PkgInfo);
+        DeleteFile(TempFile.StartOfString);
+        YoriLibFreeStringContents(&TempFile);
+        return FALSE;
+    }
+    YoriLibIniCleanup(&PkgInfo);
 
     if (!YoriLibCreateCab(FileName, &CreateSourceContext.CabHandle)) {
         YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("YoriLibCreateCab failure\n"));
@@ -696,4 +722,319 @@ YoriPkgCreateSourcePackage(
     return TRUE;
 }
 
+/**
+ Context passed between the delta package creation operation and every file
+ extracted from the new version of the package.
+ */
+typedef struct _YORIPKG_CREATE_DELTA_CONTEXT {
+
+    /**
+     A handle to the Cabinet being created.
+     */
+    PVOID CabHandle;
+
+    /**
+     Pointer to the directory containing the previous version of the
+     package.
+     */
+    PYORI_STRING BaseDirectory;
+
+    /**
+     Pointer to the pkginfo.ini file to record unchanged files in.
+     */
+    PYORI_LIB_INI PkgInfo;
+
+    /**
+     A handle to the crypto provider used to generate digests of files.
+     */
+    HCRYPTPROV Provider;
+
+    /**
+     A buffer to hold the path of a file in the previous version of the
+     package.
+     */
+    YORI_STRING BaseFilePath;
+
+    /**
+     A buffer to hold the digest of a file in the new version of the package.
+     */
+    YORI_STRING Digest;
+
+    /**
+     A buffer to hold the digest of a file in the previous version of the
+     package.
+     */
+    YORI_STRING BaseDigest;
+
+    /**
+     The number of files which are unchanged from the previous version.
+     */
+    DWORD UnchangedFileCount;
+
+    /**
+     The number of files which are included in the delta package.
+     */
+    DWORD ChangedFileCount;
+
+    /**
+     Set to TRUE if a file could not be added to the delta package.
+     */
+    BOOLEAN Failed;
+
+} YORIPKG_CREATE_DELTA_CONTEXT, *PYORIPKG_CREATE_DELTA_CONTEXT;
+
+/**
+ A callback invoked once each file has been extracted from the new version
+ of a package.  If the file is identical to the file from the previous
+ version, it is recorded as unchanged in pkginfo.ini.  Otherwise it is added
+ to the delta package.
+
+ @param FullPath The full path name of the file on disk.
+
+ @param RelativePath The relative path name of the file as stored within the
+        package.
+
+ @param Context Pointer to the YORIPKG_CREATE_DELTA_CONTEXT structure.
+
+ @return TRUE, but this value is ignored since the file is already extracted.
+ */
+BOOL
+YoriPkgCreateDeltaFileCallback(
+    __in PYORI_STRING FullPath,
+    __in PYORI_STRING RelativePath,
+    __in PVOID Context
+    )
+{
+    PYORIPKG_CREATE_DELTA_CONTEXT DeltaContext = (PYORIPKG_CREATE_DELTA_CONTEXT)Context;
+
+    ASSERT(YoriLibIsStringNullTerminated(RelativePath));
+
+    YoriLibYPrintf(&DeltaContext->BaseFilePath, _T("%y\\%y"), DeltaContext->BaseDirectory, RelativePath);
+    if (DeltaContext->BaseFilePath.LengthInChars > 0 &&
+        YoriPkgHashFile(DeltaContext->Provider, FullPath, &DeltaContext->Digest) &&
+        YoriPkgHashFile(DeltaContext->Provider, &DeltaContext->BaseFilePath, &DeltaContext->BaseDigest) &&
+        YoriLibCompareString(&DeltaContext->Digest, &DeltaContext->BaseDigest) == 0) {
+
+        YoriLibIniSetString(DeltaContext->PkgInfo, _T("Files"), RelativePath->StartOfString, DeltaContext->Digest.StartOfString);
+        DeltaContext->UnchangedFileCount++;
+        return TRUE;
+    }
+
+    if (!YoriLibAddFileToCab(DeltaContext->CabHandle, FullPath, RelativePath)) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("YoriLibAddFileToCab cannot add %y\n"), RelativePath);
+        DeltaContext->Failed = TRUE;
+        return TRUE;
+    }
+
+    DeltaContext->ChangedFileCount++;
+    return TRUE;
+}
+
+/**
+ Creates a delta package which upgrades a previous version of a package to a
+ new version.  The delta package only contains the files which changed
+ between the two versions, and records the digest of each file it retains
+ from the previous version so that the installer can verify that the
+ installed files match before applying it.
+
+ @param FileName The name of the CAB file to create.
+
+ @param BasePackage The name of the CAB file containing the previous version
+        of the package.
+
+ @param NewPackage The name of the CAB file containing the new version of the
+        package.
+
+ @param FullPackagePath A URL to the complete new version of the package, to
+        use if the delta package cannot be applied to the installed files.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+YoriPkgCreateDeltaPackage(
+    __in PYORI_STRING FileName,
+    __in PYORI_STRING BasePackage,
+    __in PYORI_STRING NewPackage,
+    __in PYORI_STRING FullPackagePath
+    )
+{
+    YORIPKG_CREATE_DELTA_CONTEXT DeltaContext;
+    YORI_STRING FullBasePackage;
+    YORI_STRING FullNewPackage;
+    YORI_STRING BaseDirectory;
+    YORI_STRING NewDirectory;
+    YORI_STRING PkgInfoFile;
+    YORI_STRING PkgInfoPath;
+    YORI_STRING BaseVersion;
+    YORI_STRING ErrorString;
+    YORI_LIB_INI PkgInfo;
+    DWORD Error;
+    BOOL Result;
+
+    if (DllKernel32.pGetPrivateProfileStringW == NULL) {
+        return FALSE;
+    }
+
+    Result = FALSE;
+    ZeroMemory(&DeltaContext, sizeof(DeltaContext));
+    YoriLibIniInitialize(&PkgInfo);
+    YoriLibInitEmptyString(&FullBasePackage);
+    YoriLibInitEmptyString(&FullNewPackage);
+    YoriLibInitEmptyString(&BaseDirectory);
+    YoriLibInitEmptyString(&NewDirectory);
+    YoriLibInitEmptyString(&PkgInfoPath);
+    YoriLibInitEmptyString(&BaseVersion);
+    YoriLibInitEmptyString(&ErrorString);
+    YoriLibConstantString(&PkgInfoFile, _T("pkginfo.ini"));
+
+    if (!YoriLibUserStringToSingleFilePath(BasePackage, TRUE, &FullBasePackage) ||
+        !YoriLibUserStringToSingleFilePath(NewPackage, TRUE, &FullNewPackage)) {
+        goto Exit;
+    }
+
+    if (!YoriLibAllocateString(&BaseVersion, YORIPKG_MAX_FIELD_LENGTH) ||
+        !YoriLibAllocateString(&DeltaContext.Digest, YORIPKG_HASH_SIZE * 2 + 1) ||
+        !YoriLibAllocateString(&DeltaContext.BaseDigest, YORIPKG_HASH_SIZE * 2 + 1)) {
+        goto Exit;
+    }
+
+    if (!YoriPkgAcquireHashProvider(&DeltaContext.Provider)) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Cannot generate digests on this system\n"));
+        goto Exit;
+    }
+
+    if (!YoriPkgCreateTempDirectory(NULL, &BaseDirectory)) {
+        YoriLibInitEmptyString(&BaseDirectory);
+        goto Exit;
+    }
+
+    if (!YoriPkgCreateTempDirectory(NULL, &NewDirectory)) {
+        YoriLibInitEmptyString(&NewDirectory);
+        goto Exit;
+    }
+
+    //
+    //  Extract the entire previous version, and find its version number.
+    //
+
+    if (!YoriLibExtractCab(&FullBasePackage, &BaseDirectory, TRUE, 0, NULL, 0, NULL, NULL, NULL, NULL, &Error, &ErrorString)) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Could not extract %y: %y\n"), &FullBasePackage, &ErrorString);
+        goto Exit;
+    }
+
+    YoriLibYPrintf(&PkgInfoPath, _T("%y\\%y"), &BaseDirectory, &PkgInfoFile);
+    if (PkgInfoPath.LengthInChars == 0) {
+        goto Exit;
+    }
+
+    BaseVersion.LengthInChars = (YORI_ALLOC_SIZE_T)
+        DllKernel32.pGetPrivateProfileStringW(_T("Package"),
+                                              _T("Version"),
+                                              _T(""),
+                                              BaseVersion.StartOfString,
+                                              BaseVersion.LengthAllocated,
+                                              PkgInfoPath.StartOfString);
+    if (BaseVersion.LengthInChars == 0) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%y does not specify a version\n"), &FullBasePackage);
+        goto Exit;
+    }
+
+    //
+    //  Extract pkginfo.ini from the new version first, so unchanged files
+    //  can be recorded in it as the remaining files are extracted.
+    //
+
+    if (!YoriLibExtractCab(&FullNewPackage, &NewDirectory, FALSE, 0, NULL, 1, &PkgInfoFile, NULL, NULL, NULL, &Error, &ErrorString)) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Could not extract %y: %y\n"), &FullNewPackage, &ErrorString);
+        goto Exit;
+    }
+
+    YoriLibYPrintf(&PkgInfoPath, _T("%y\\%y"), &NewDirectory, &PkgInfoFile);
+    if (PkgInfoPath.LengthInChars == 0) {
+        goto Exit;
+    }
+
+    if (!YoriLibIniLoad(&PkgInfo, &PkgInfoPath)) {
+        goto Exit;
+    }
+
+    YoriLibIniSetString(&PkgInfo, _T("Package"), _T("DeltaFrom"), BaseVersion.StartOfString);
+    YoriLibIniSetString(&PkgInfo, _T("Package"), _T("FullPackagePath"), FullPackagePath->StartOfString);
+
+    if (!YoriLibCreateCab(FileName, &DeltaContext.CabHandle)) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("YoriLibCreateCab failure\n"));
+        DeltaContext.CabHandle = NULL;
+        goto Exit;
+    }
+
+    //
+    //  Extract the remaining files from the new version, comparing each
+    //  against the previous version.
+    //
+
+    DeltaContext.BaseDirectory = &BaseDirectory;
+    DeltaContext.PkgInfo = &PkgInfo;
+    if (!YoriLibExtractCab(&FullNewPackage,
+                           &NewDirectory,
+                           TRUE,
+                           1,
+                           &PkgInfoFile,
+                           0,
+                           NULL,
+                           NULL,
+                           YoriPkgCreateDeltaFileCallback,
+                           &DeltaContext,
+                           &Error,
+                           &ErrorString)) {
+
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Could not extract %y: %y\n"), &FullNewPackage, &ErrorString);
+        goto Exit;
+    }
+
+    if (DeltaContext.Failed) {
+        goto Exit;
+    }
+
+    if (!YoriLibIniFlush(&PkgInfo)) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Could not update %y\n"), &PkgInfoPath);
+        goto Exit;
+    }
+
+    if (!YoriLibAddFileToCab(DeltaContext.CabHandle, &PkgInfoPath, &PkgInfoFile)) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("YoriLibAddFileToCab failure\n"));
+        goto Exit;
+    }
+
+    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT,
+                  _T("%i files changed, %i files unchanged from version %y\n"),
+                  DeltaContext.ChangedFileCount,
+                  DeltaContext.UnchangedFileCount,
+                  &BaseVersion);
+
+    Result = TRUE;
+
+Exit:
+    if (DeltaContext.CabHandle != NULL) {
+        YoriLibCloseCab(DeltaContext.CabHandle);
+        if (!Result) {
+            DeleteFile(FileName->StartOfString);
+        }
+    }
+    if (DeltaContext.Provider != 0) {
+        DllAdvApi32.pCryptReleaseContext(DeltaContext.Provider, 0);
+    }
+    YoriLibIniCleanup(&PkgInfo);
+    YoriPkgDeleteTempDirectory(&BaseDirectory);
+    YoriPkgDeleteTempDirectory(&NewDirectory);
+    YoriLibFreeStringContents(&DeltaContext.BaseFilePath);
+    YoriLibFreeStringContents(&DeltaContext.Digest);
+    YoriLibFreeStringContents(&DeltaContext.BaseDigest);
+    YoriLibFreeStringContents(&FullBasePackage);
+    YoriLibFreeStringContents(&FullNewPackage);
+    YoriLibFreeStringContents(&PkgInfoPath);
+    YoriLibFreeStringContents(&BaseVersion);
+    YoriLibFreeStringContents(&ErrorString);
+    return Result;
+}
+
 // vim:sw=4:ts=4:et:
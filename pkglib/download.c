@@ -0,0 +1,582 @@
+/**
+ * @file pkglib/download.c
+ *
+ * Yori package manager concurrent package download support
+ *
+ * Copyright (c) 2026 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <yoripch.h>
+#include <yorilib.h>
+#include "yoripkg.h"
+#include "yoripkgp.h"
+
+/**
+ The maximum number of threads downloading packages at any one time.
+ */
+#define YORIPKG_DOWNLOAD_THREADS (8)
+
+/**
+ The maximum number of packages to download from a single host at any one
+ time.
+ */
+#define YORIPKG_DOWNLOADS_PER_HOST (4)
+
+/**
+ The interval between updates to the progress display, in milliseconds.
+ */
+#define YORIPKG_DOWNLOAD_PROGRESS_INTERVAL (500)
+
+/**
+ A string of spaces used to erase the progress display.
+ */
+#define YORIPKG_DOWNLOAD_PROGRESS_BLANK _T("                                                                              ")
+
+/**
+ State shared between all threads downloading a set of packages.
+ */
+typedef struct _YORIPKG_DOWNLOAD_SCHEDULER {
+
+    /**
+     The list of downloads to perform.  Paired with
+     @ref YORIPKG_DOWNLOAD::ListEntry .
+     */
+    PYORI_LIST_ENTRY DownloadList;
+
+    /**
+     Optionally points to the package INI file, which is used to find
+     mirrors for package URLs.
+     */
+    PCYORI_STRING PkgIniFile;
+
+    /**
+     The user agent to report to remote servers.
+     */
+    YORI_STRING UserAgent;
+
+    /**
+     The number of downloads which have completed.  This is only used by
+     the thread that owns the work queue.
+     */
+    DWORD Completed;
+
+    /**
+     The number of downloads submitted to the work queue which have not
+     completed.  This is only used by the thread that owns the work queue.
+     */
+    DWORD Active;
+
+    /**
+     The total number of downloads to perform.
+     */
+    DWORD Total;
+
+    /**
+     Set to TRUE if a download was returned without being performed, which
+     indicates no workers remain to perform any more.
+     */
+    BOOLEAN WorkersLost;
+
+} YORIPKG_DOWNLOAD_SCHEDULER, *PYORIPKG_DOWNLOAD_SCHEDULER;
+
+/**
+ Find the host name component within a URL.  For paths which are not URLs,
+ an empty string is returned.
+
+ @param Url Pointer to the URL.
+
+ @param Host On completion, updated to point to a substring of Url containing
+        the host name.
+ */
+VOID
+YoriPkgGetUrlHost(
+    __in PCYORI_STRING Url,
+    __out PYORI_STRING Host
+    )
+{
+    YORI_ALLOC_SIZE_T Index;
+
+    YoriLibInitEmptyString(Host);
+    if (!YoriLibIsPathUrl(Url)) {
+        return;
+    }
+
+    for (Index = 0; Index + 2 < Url->LengthInChars; Index++) {
+        if (Url->StartOfString[Index] == ':' &&
+            Url->StartOfString[Index + 1] == '/' &&
+            Url->StartOfString[Index + 2] == '/') {
+
+            break;
+        }
+    }
+
+    if (Index + 2 >= Url->LengthInChars) {
+        return;
+    }
+
+    Host->StartOfString = &Url->StartOfString[Index + 3];
+    Host->LengthInChars = (YORI_ALLOC_SIZE_T)(Url->LengthInChars - Index - 3);
+
+    for (Index = 0; Index < Host->LengthInChars; Index++) {
+        if (Host->StartOfString[Index] == '/') {
+            Host->LengthInChars = Index;
+            break;
+        }
+    }
+}
+
+/**
+ Add a package to a list of packages to download.  If the package is already
+ in the list, it is not added again.
+
+ @param DownloadList Pointer to the list of downloads.
+
+ @param PackagePath Pointer to the path to the package, which is typically a
+        URL.
+
+ @return TRUE to indicate the package is in the list, FALSE to indicate
+         failure.
+ */
+__success(return)
+BOOL
+YoriPkgQueueDownload(
+    __inout PYORI_LIST_ENTRY DownloadList,
+    __in PCYORI_STRING PackagePath
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PYORIPKG_DOWNLOAD Download;
+
+    ListEntry = YoriLibGetNextListEntry(DownloadList, NULL);
+    while (ListEntry != NULL) {
+        Download = CONTAINING_RECORD(ListEntry, YORIPKG_DOWNLOAD, ListEntry);
+        if (YoriLibCompareString(PackagePath, &Download->PackagePath) == 0) {
+            return TRUE;
+        }
+        ListEntry = YoriLibGetNextListEntry(DownloadList, ListEntry);
+    }
+
+    Download = YoriLibMalloc(sizeof(YORIPKG_DOWNLOAD));
+    if (Download == NULL) {
+        return FALSE;
+    }
+
+    ZeroMemory(Download, sizeof(YORIPKG_DOWNLOAD));
+    if (!YoriLibCopyString(&Download->PackagePath, PackagePath)) {
+        YoriLibFree(Download);
+        return FALSE;
+    }
+
+    YoriPkgGetUrlHost(&Download->PackagePath, &Download->Host);
+    YoriLibInitEmptyString(&Download->LocalPath);
+    Download->State = YoriPkgDownloadQueued;
+    YoriLibAppendList(DownloadList, &Download->ListEntry);
+    return TRUE;
+}
+
+/**
+ Find the next download to submit to the work queue.  This is the first
+ queued download whose host does not already have the maximum number of
+ downloads in progress.
+
+ @param Scheduler Pointer to the scheduler.
+
+ @return Pointer to the download to perform, or NULL if no download can be
+         started now.
+ */
+PYORIPKG_DOWNLOAD
+YoriPkgSelectNextDownload(
+    __in PYORIPKG_DOWNLOAD_SCHEDULER Scheduler
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PYORI_LIST_ENTRY ActiveEntry;
+    PYORIPKG_DOWNLOAD Download;
+    PYORIPKG_DOWNLOAD ActiveDownload;
+    DWORD ActiveForHost;
+
+    ListEntry = YoriLibGetNextListEntry(Scheduler->DownloadList, NULL);
+    while (ListEntry != NULL) {
+        Download = CONTAINING_RECORD(ListEntry, YORIPKG_DOWNLOAD, ListEntry);
+        ListEntry = YoriLibGetNextListEntry(Scheduler->DownloadList, ListEntry);
+        if (Download->State != YoriPkgDownloadQueued) {
+            continue;
+        }
+
+        ActiveForHost = 0;
+        ActiveEntry = YoriLibGetNextListEntry(Scheduler->DownloadList, NULL);
+        while (ActiveEntry != NULL) {
+            ActiveDownload = CONTAINING_RECORD(ActiveEntry, YORIPKG_DOWNLOAD, ListEntry);
+            if (ActiveDownload->State == YoriPkgDownloadActive &&
+                YoriLibCompareStringIns(&ActiveDownload->Host, &Download->Host) == 0) {
+
+                ActiveForHost++;
+            }
+            ActiveEntry = YoriLibGetNextListEntry(Scheduler->DownloadList, ActiveEntry);
+        }
+
+        if (ActiveForHost < YORIPKG_DOWNLOADS_PER_HOST) {
+            return Download;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ Download a single package on a work queue worker thread.
+
+ @param Context Pointer to the scheduler.
+
+ @param WorkerContext The session used for all downloads on this worker,
+        which allows connections to be reused.  This can be NULL if a
+        session could not be opened, in which case each download opens its
+        own.
+
+ @param Item Pointer to the work item within the download to perform.
+
+ @return TRUE to indicate the worker should continue processing items.
+ */
+BOOLEAN
+YoriPkgDownloadExecute(
+    __in PVOID Context,
+    __in PVOID WorkerContext,
+    __in PYORILIB_WORK_ITEM Item
+    )
+{
+    PYORIPKG_DOWNLOAD_SCHEDULER Scheduler;
+    PYORIPKG_DOWNLOAD Download;
+
+    Scheduler = (PYORIPKG_DOWNLOAD_SCHEDULER)Context;
+    Download = CONTAINING_RECORD(Item, YORIPKG_DOWNLOAD, WorkItem);
+
+    YoriLibInitEmptyString(&Download->LocalPath);
+    Download->DeleteWhenFinished = FALSE;
+    Download->Error = YoriPkgPackagePathToLocalPathWithSession(WorkerContext,
+                                                               &Download->PackagePath,
+                                                               Scheduler->PkgIniFile,
+                                                               &Download->LocalPath,
+                                                               &Download->DeleteWhenFinished);
+    return TRUE;
+}
+
+/**
+ Record the completion of a download on the thread that owns the work
+ queue.
+
+ @param Context Pointer to the scheduler.
+
+ @param Item Pointer to the work item within the download that completed.
+ */
+VOID
+YoriPkgDownloadComplete(
+    __in PVOID Context,
+    __in PYORILIB_WORK_ITEM Item
+    )
+{
+    PYORIPKG_DOWNLOAD_SCHEDULER Scheduler;
+    PYORIPKG_DOWNLOAD Download;
+
+    Scheduler = (PYORIPKG_DOWNLOAD_SCHEDULER)Context;
+    Download = CONTAINING_RECORD(Item, YORIPKG_DOWNLOAD, WorkItem);
+    Scheduler->Active--;
+
+    //
+    //  If no worker picked this up, leave it queued so that it is
+    //  downloaded when it is needed.
+    //
+
+    if (!Item->Executed) {
+        Download->State = YoriPkgDownloadQueued;
+        Scheduler->WorkersLost = TRUE;
+        return;
+    }
+
+    if (Download->Error != ERROR_SUCCESS) {
+        YoriLibFreeStringContents(&Download->LocalPath);
+        Download->DeleteWhenFinished = FALSE;
+    }
+    Download->State = YoriPkgDownloadComplete;
+    Scheduler->Completed++;
+}
+
+/**
+ Display the progress of all downloads in progress.  This is only displayed
+ on a console, and is updated in place.
+
+ @param Scheduler Pointer to the scheduler.
+
+ @param BytesReceived The number of bytes received across all threads.
+ */
+VOID
+YoriPkgDisplayDownloadProgress(
+    __in PYORIPKG_DOWNLOAD_SCHEDULER Scheduler,
+    __in DWORDLONG BytesReceived
+    )
+{
+    YORI_STRING SizeString;
+    TCHAR SizeBuffer[10];
+    LARGE_INTEGER Size;
+
+    YoriLibInitEmptyString(&SizeString);
+    SizeString.StartOfString = SizeBuffer;
+    SizeString.LengthAllocated = sizeof(SizeBuffer)/sizeof(SizeBuffer[0]);
+    Size.QuadPart = BytesReceived;
+    YoriLibFileSizeToString(&SizeString, &Size);
+
+    YoriLibOutput(YORI_LIB_OUTPUT_STDERR,
+                  _T("\rDownloading: %i of %i complete, %i in progress, %y received"),
+                  Scheduler->Completed,
+                  Scheduler->Total,
+                  Scheduler->Active,
+                  &SizeString);
+}
+
+/**
+ Download all queued packages in a list.  Packages are downloaded
+ concurrently on a work queue, with a limited number of downloads from any
+ single host at one time.  Each worker uses a single session for all of its
+ downloads so that connections can be reused.  The result of each download
+ is recorded in the list, and can be retrieved with
+ @ref YoriPkgTakeDownload .  If downloads cannot be performed concurrently
+ for any reason, they are left in the list, and are performed when they are
+ needed.
+
+ @param DownloadList Pointer to the list of downloads.
+
+ @param PkgIniFile Optionally points to the package INI file, which is used
+        to find mirrors for package URLs.
+ */
+VOID
+YoriPkgCompleteDownloads(
+    __inout PYORI_LIST_ENTRY DownloadList,
+    __in_opt PCYORI_STRING PkgIniFile
+    )
+{
+    YORIPKG_DOWNLOAD_SCHEDULER Scheduler;
+    PVOID Sessions[YORIPKG_DOWNLOAD_THREADS];
+    PYORILIB_WORK_QUEUE Queue;
+    PYORI_LIST_ENTRY ListEntry;
+    PYORIPKG_DOWNLOAD Download;
+    DWORDLONG BytesReceived;
+    DWORD WorkerCount;
+    DWORD SessionCount;
+    DWORD Index;
+    DWORD ConsoleMode;
+    BOOLEAN ProgressToConsole;
+    BOOLEAN ProgressDisplayed;
+
+    ZeroMemory(&Scheduler, sizeof(Scheduler));
+    Scheduler.DownloadList = DownloadList;
+    Scheduler.PkgIniFile = PkgIniFile;
+
+    ListEntry = YoriLibGetNextListEntry(DownloadList, NULL);
+    while (ListEntry != NULL) {
+        Download = CONTAINING_RECORD(ListEntry, YORIPKG_DOWNLOAD, ListEntry);
+        if (Download->State == YoriPkgDownloadQueued) {
+            Scheduler.Total++;
+        }
+        ListEntry = YoriLibGetNextListEntry(DownloadList, ListEntry);
+    }
+
+    //
+    //  With a single package there's nothing to overlap, so leave it to be
+    //  downloaded when it is needed.
+    //
+
+    if (Scheduler.Total <= 1) {
+        return;
+    }
+
+    YoriLibInitEmptyString(&Scheduler.UserAgent);
+    YoriLibYPrintf(&Scheduler.UserAgent, _T("ypm %i.%02i\r\n"), YORI_VER_MAJOR, YORI_VER_MINOR);
+    if (Scheduler.UserAgent.StartOfString == NULL) {
+        return;
+    }
+
+    Queue = YoriLibWorkQueueCreate(0, 0, YoriPkgDownloadExecute, YoriPkgDownloadComplete, &Scheduler);
+    if (Queue == NULL) {
+        YoriLibFreeStringContents(&Scheduler.UserAgent);
+        return;
+    }
+
+    WorkerCount = YORIPKG_DOWNLOAD_THREADS;
+    if (WorkerCount > Scheduler.Total) {
+        WorkerCount = Scheduler.Total;
+    }
+
+    SessionCount = 0;
+    for (Index = 0; Index < WorkerCount; Index++) {
+        if (!YoriLibUpdateOpenSession(&Scheduler.UserAgent, &Sessions[SessionCount])) {
+            Sessions[SessionCount] = NULL;
+        }
+        if (!YoriLibWorkQueueAddWorker(Queue, Sessions[SessionCount])) {
+            if (Sessions[SessionCount] != NULL) {
+                YoriLibUpdateCloseSession(Sessions[SessionCount]);
+            }
+            break;
+        }
+        SessionCount++;
+    }
+    WorkerCount = SessionCount;
+
+    //
+    //  Submit downloads as workers and hosts become available, and
+    //  periodically display the aggregate progress of all downloads in
+    //  flight while waiting for them.  If no workers could be created,
+    //  nothing is submitted.
+    //
+
+    ProgressToConsole = (BOOLEAN)GetConsoleMode(GetStdHandle(STD_ERROR_HANDLE), &ConsoleMode);
+    ProgressDisplayed = FALSE;
+    while (WorkerCount > 0) {
+        while (Scheduler.Active < WorkerCount && !Scheduler.WorkersLost) {
+            Download = YoriPkgSelectNextDownload(&Scheduler);
+            if (Download == NULL) {
+                break;
+            }
+            Download->State = YoriPkgDownloadActive;
+            Scheduler.Active++;
+            YoriLibWorkQueueInitializeItem(&Download->WorkItem);
+            YoriLibWorkQueueSubmit(Queue, &Download->WorkItem);
+        }
+
+        if (Scheduler.Active == 0) {
+            break;
+        }
+
+        if (!YoriLibWorkQueueComplete(Queue, Scheduler.Active - 1, YORIPKG_DOWNLOAD_PROGRESS_INTERVAL) &&
+            ProgressToConsole) {
+
+            BytesReceived = 0;
+            for (Index = 0; Index < SessionCount; Index++) {
+                if (Sessions[Index] != NULL) {
+                    BytesReceived = BytesReceived + YoriLibUpdateGetSessionBytesReceived(Sessions[Index]);
+                }
+            }
+            YoriPkgDisplayDownloadProgress(&Scheduler, BytesReceived);
+            ProgressDisplayed = TRUE;
+        }
+    }
+
+    if (ProgressDisplayed) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("\r%s\r"), YORIPKG_DOWNLOAD_PROGRESS_BLANK);
+    }
+
+    YoriLibWorkQueueDestroy(Queue);
+
+    for (Index = 0; Index < SessionCount; Index++) {
+        if (Sessions[Index] != NULL) {
+            YoriLibUpdateCloseSession(Sessions[Index]);
+        }
+    }
+
+    YoriLibFreeStringContents(&Scheduler.UserAgent);
+}
+
+/**
+ Find the result of a completed download for a package.  If found, the
+ caller takes ownership of the local copy of the package, and the download
+ remains in the list so that the list can continue to be enumerated.
+
+ @param DownloadList Pointer to the list of downloads.
+
+ @param PackagePath Pointer to the path to the package.
+
+ @param Error On successful completion, populated with the result of the
+        download.
+
+ @param LocalPath On successful completion where Error is ERROR_SUCCESS,
+        populated with a fully qualified local path to the package.
+
+ @param DeleteWhenFinished On successful completion where Error is
+        ERROR_SUCCESS, set to TRUE to indicate the caller should delete the
+        file (it is temporary); set to FALSE to indicate the file should be
+        retained.
+
+ @return TRUE to indicate a completed download was found, FALSE if it was
+         not.  If not, the caller should download the package itself.
+ */
+__success(return)
+BOOL
+YoriPkgTakeDownload(
+    __in PYORI_LIST_ENTRY DownloadList,
+    __in PCYORI_STRING PackagePath,
+    __out PDWORD Error,
+    __out PYORI_STRING LocalPath,
+    __out PBOOLEAN DeleteWhenFinished
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PYORIPKG_DOWNLOAD Download;
+
+    ListEntry = YoriLibGetNextListEntry(DownloadList, NULL);
+    while (ListEntry != NULL) {
+        Download = CONTAINING_RECORD(ListEntry, YORIPKG_DOWNLOAD, ListEntry);
+        if (Download->State == YoriPkgDownloadComplete &&
+            YoriLibCompareString(PackagePath, &Download->PackagePath) == 0) {
+
+            *Error = Download->Error;
+            if (Download->Error == ERROR_SUCCESS) {
+                memcpy(LocalPath, &Download->LocalPath, sizeof(YORI_STRING));
+                *DeleteWhenFinished = Download->DeleteWhenFinished;
+                YoriLibInitEmptyString(&Download->LocalPath);
+                Download->DeleteWhenFinished = FALSE;
+            }
+            Download->State = YoriPkgDownloadTaken;
+            return TRUE;
+        }
+        ListEntry = YoriLibGetNextListEntry(DownloadList, ListEntry);
+    }
+
+    return FALSE;
+}
+
+/**
+ Free all downloads in a list.  Any temporary files for downloads which
+ were not taken with @ref YoriPkgTakeDownload are deleted.
+
+ @param DownloadList Pointer to the list of downloads.
+ */
+VOID
+YoriPkgFreeDownloads(
+    __inout PYORI_LIST_ENTRY DownloadList
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PYORIPKG_DOWNLOAD Download;
+
+    ListEntry = YoriLibGetNextListEntry(DownloadList, NULL);
+    while (ListEntry != NULL) {
+        Download = CONTAINING_RECORD(ListEntry, YORIPKG_DOWNLOAD, ListEntry);
+        ListEntry = YoriLibGetNextListEntry(DownloadList, ListEntry);
+
+        YoriLibRemoveListItem(&Download->ListEntry);
+        if (Download->DeleteWhenFinished && Download->LocalPath.StartOfString != NULL) {
+            DeleteFile(Download->LocalPath.StartOfString);
+        }
+        YoriLibFreeStringContents(&Download->LocalPath);
+        YoriLibFreeStringContents(&Download->PackagePath);
+        YoriLibFree(Download);
+    }
+}
+
+// vim:sw=4:ts=4:et:
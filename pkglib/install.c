@@ -103,7 +103,7 @@ YoriPkgCheckIfFileDeleteable(
 /**
  Check if all of the files in a specified package can be deleted.
 
- @param PkgIniFile Pointer to the full path to the packages.ini file.
+ @param PkgIni Pointer to the packages.ini file.
 
  @param TargetDirectory Pointer to a string specifying the directory
         containing the package.  If NULL, the directory containing the
@@ -121,7 +121,7 @@ YoriPkgCheckIfFileDeleteable(
  */
 BOOL
 YoriPkgCheckIfPackageDeleteable(
-    __in PYORI_STRING PkgIniFile,
+    __in PYORI_LIB_INI PkgIni,
     __in_opt PYORI_STRING TargetDirectory,
     __in PYORI_STRING PackageName,
     __in BOOLEAN IgnoreFailureOfCurrentExecutable
@@ -137,12 +137,6 @@ YoriPkgCheckIfPackageDeleteable(
     BOOL DeleteResult;
     BOOL BestEffortDelete;
 
-    if (DllKernel32.pGetPrivateProfileIntW == NULL ||
-        DllKernel32.pGetPrivateProfileStringW == NULL) {
-
-        return FALSE;
-    }
-
     if (!YoriLibAllocateString(&IniValue, YORIPKG_MAX_FIELD_LENGTH)) {
         return FALSE;
     }
@@ -161,9 +155,9 @@ YoriPkgCheckIfPackageDeleteable(
         AppPath.LengthInChars = TargetDirectory->LengthInChars;
     }
 
-    BestEffortDelete = DllKernel32.pGetPrivateProfileIntW(PackageName->StartOfString, _T("BestEffortDelete"), 0, PkgIniFile->StartOfString);
+    BestEffortDelete = YoriLibIniGetInt(PkgIni, PackageName->StartOfString, _T("BestEffortDelete"), 0);
 
-    FileCount = DllKernel32.pGetPrivateProfileIntW(PackageName->StartOfString, _T("FileCount"), 0, PkgIniFile->StartOfString);
+    FileCount = YoriLibIniGetInt(PkgIni, PackageName->StartOfString, _T("FileCount"), 0);
     if (FileCount == 0) {
         YoriLibFreeStringContents(&AppPath);
         YoriLibFreeStringContents(&IniValue);
@@ -181,12 +175,12 @@ YoriPkgCheckIfPackageDeleteable(
         YoriLibSPrintf(FileIndexString, _T("File%i"), FileIndex);
 
         IniValue.LengthInChars = (YORI_ALLOC_SIZE_T)
-            DllKernel32.pGetPrivateProfileStringW(PackageName->StartOfString,
-                                                  FileIndexString,
-                                                  _T(""),
-                                                  IniValue.StartOfString,
-                                                  IniValue.LengthAllocated,
-                                                  PkgIniFile->StartOfString);
+            YoriLibIniGetString(PkgIni,
+                                PackageName->StartOfString,
+                                FileIndexString,
+                                _T(""),
+                                IniValue.StartOfString,
+                                IniValue.LengthAllocated);
         if (IniValue.LengthInChars > 0) {
             if (!YoriLibIsPathPrefixed(&IniValue)) {
                 YoriLibYPrintf(&FileToDelete, _T("%y\\%y"), &AppPath, &IniValue);
@@ -316,7 +310,7 @@ YoriPkgDeleteInstalledPackageFile(
 /**
  Delete a specified package from the system.
 
- @param PkgIniFile Pointer to the full path to the packages.ini file.
+ @param PkgIni Pointer to the packages.ini file.
 
  @param TargetDirectory Pointer to a string specifying the directory
         containing the package.  If NULL, the directory containing the
@@ -335,7 +329,7 @@ YoriPkgDeleteInstalledPackageFile(
  */
 DWORD
 YoriPkgDeletePackageInternal(
-    __in PYORI_STRING PkgIniFile,
+    __in PYORI_LIB_INI PkgIni,
     __in_opt PCYORI_STRING TargetDirectory,
     __in PCYORI_STRING PackageName,
     __in BOOLEAN IgnoreFailureOfCurrentExecutable
@@ -351,13 +345,6 @@ YoriPkgDeletePackageInternal(
     DWORD DeleteResult;
     BOOL BestEffortDelete;
 
-    if (DllKernel32.pGetPrivateProfileIntW == NULL ||
-        DllKernel32.pGetPrivateProfileStringW == NULL ||
-        DllKernel32.pWritePrivateProfileStringW == NULL) {
-
-        return ERROR_PROC_NOT_FOUND;
-    }
-
     if (!YoriLibAllocateString(&IniValue, YORIPKG_MAX_FIELD_LENGTH)) {
         return ERROR_NOT_ENOUGH_MEMORY;
     }
@@ -376,9 +363,9 @@ YoriPkgDeletePackageInternal(
         AppPath.LengthInChars = TargetDirectory->LengthInChars;
     }
 
-    BestEffortDelete = DllKernel32.pGetPrivateProfileIntW(PackageName->StartOfString, _T("BestEffortDelete"), 0, PkgIniFile->StartOfString);
+    BestEffortDelete = YoriLibIniGetInt(PkgIni, PackageName->StartOfString, _T("BestEffortDelete"), 0);
 
-    FileCount = DllKernel32.pGetPrivateProfileIntW(PackageName->StartOfString, _T("FileCount"), 0, PkgIniFile->StartOfString);
+    FileCount = YoriLibIniGetInt(PkgIni, PackageName->StartOfString, _T("FileCount"), 0);
     if (FileCount == 0) {
         YoriLibFreeStringContents(&AppPath);
         YoriLibFreeStringContents(&IniValue);
@@ -396,12 +383,12 @@ YoriPkgDeletePackageInternal(
         YoriLibSPrintf(FileIndexString, _T("File%i"), FileIndex);
 
         IniValue.LengthInChars = (YORI_ALLOC_SIZE_T)
-            DllKernel32.pGetPrivateProfileStringW(PackageName->StartOfString,
-                                                  FileIndexString,
-                                                  _T(""),
-                                                  IniValue.StartOfString,
-                                                  IniValue.LengthAllocated,
-                                                  PkgIniFile->StartOfString);
+            YoriLibIniGetString(PkgIni,
+                                PackageName->StartOfString,
+                                FileIndexString,
+                                _T(""),
+                                IniValue.StartOfString,
+                                IniValue.LengthAllocated);
         if (IniValue.LengthInChars > 0) {
             if (!YoriLibIsPathPrefixed(&IniValue)) {
                 YoriLibYPrintf(&FileToDelete, _T("%y\\%y"), &AppPath, &IniValue);
@@ -447,20 +434,20 @@ YoriPkgDeletePackageInternal(
             }
         }
 
-        DllKernel32.pWritePrivateProfileStringW(PackageName->StartOfString, FileIndexString, NULL, PkgIniFile->StartOfString);
+        YoriLibIniSetString(PkgIni, PackageName->StartOfString, FileIndexString, NULL);
     }
 
-    DllKernel32.pWritePrivateProfileStringW(PackageName->StartOfString, _T("FileCount"), NULL, PkgIniFile->StartOfString);
-    DllKernel32.pWritePrivateProfileStringW(PackageName->StartOfString, _T("Architecture"), NULL, PkgIniFile->StartOfString);
-    DllKernel32.pWritePrivateProfileStringW(PackageName->StartOfString, _T("UpgradePath"), NULL, PkgIniFile->StartOfString);
-    DllKernel32.pWritePrivateProfileStringW(PackageName->StartOfString, _T("SourcePath"), NULL, PkgIniFile->StartOfString);
-    DllKernel32.pWritePrivateProfileStringW(PackageName->StartOfString, _T("SymbolPath"), NULL, PkgIniFile->StartOfString);
-    DllKernel32.pWritePrivateProfileStringW(PackageName->StartOfString, _T("UpgradeToDailyPath"), NULL, PkgIniFile->StartOfString);
-    DllKernel32.pWritePrivateProfileStringW(PackageName->StartOfString, _T("UpgradeToStablePath"), NULL, PkgIniFile->StartOfString);
-    DllKernel32.pWritePrivateProfileStringW(PackageName->StartOfString, _T("Version"), NULL, PkgIniFile->StartOfString);
-    DllKernel32.pWritePrivateProfileStringW(_T("Installed"), PackageName->StartOfString, NULL, PkgIniFile->StartOfString);
+    YoriLibIniSetString(PkgIni, PackageName->StartOfString, _T("FileCount"), NULL);
+    YoriLibIniSetString(PkgIni, PackageName->StartOfString, _T("Architecture"), NULL);
+    YoriLibIniSetString(PkgIni, PackageName->StartOfString, _T("UpgradePath"), NULL);
+    YoriLibIniSetString(PkgIni, PackageName->StartOfString, _T("SourcePath"), NULL);
+    YoriLibIniSetString(PkgIni, PackageName->StartOfString, _T("SymbolPath"), NULL);
+    YoriLibIniSetString(PkgIni, PackageName->StartOfString, _T("UpgradeToDailyPath"), NULL);
+    YoriLibIniSetString(PkgIni, PackageName->StartOfString, _T("UpgradeToStablePath"), NULL);
+    YoriLibIniSetString(PkgIni, PackageName->StartOfString, _T("Version"), NULL);
+    YoriLibIniSetString(PkgIni, _T("Installed"), PackageName->StartOfString, NULL);
 
-    DllKernel32.pWritePrivateProfileStringW(PackageName->StartOfString, NULL, NULL, PkgIniFile->StartOfString);
+    YoriLibIniSetString(PkgIni, PackageName->StartOfString, NULL, NULL);
 
     YoriLibFreeStringContents(&IniValue);
     YoriLibFreeStringContents(&AppPath);
@@ -482,9 +469,9 @@ typedef struct _YORIPKG_INSTALL_PKG_CONTEXT {
     PYORIPKG_PACKAGES_PENDING_INSTALL PendingPackages;
 
     /**
-     Path to the INI file recording package installation.
+     The INI file recording package installation.
      */
-    PYORI_STRING IniFileName;
+    PYORI_LIB_INI PkgIni;
 
     /**
      The name of the package being installed.
@@ -536,8 +523,6 @@ YoriPkgInstallPackageFileCallback(
     PYORIPKG_INSTALL_PKG_CONTEXT InstallContext = (PYORIPKG_INSTALL_PKG_CONTEXT)Context;
     TCHAR FileIndexString[16];
 
-    ASSERT(DllKernel32.pWritePrivateProfileStringW != NULL);
-
     if (InstallContext->ConflictingFileFound) {
         return FALSE;
     }
@@ -557,10 +542,10 @@ YoriPkgInstallPackageFileCallback(
     InstallContext->NumberFiles++;
     YoriLibSPrintf(FileIndexString, _T("File%i"), InstallContext->NumberFiles);
 
-    DllKernel32.pWritePrivateProfileStringW(InstallContext->PackageName->StartOfString,
-                                            FileIndexString,
-                                            RelativePath->StartOfString,
-                                            InstallContext->IniFileName->StartOfString);
+    YoriLibIniSetString(InstallContext->PkgIni,
+                        InstallContext->PackageName->StartOfString,
+                        FileIndexString,
+                        RelativePath->StartOfString);
     return TRUE;
 }
 
@@ -597,9 +582,178 @@ YoriPkgCompressPackageFileCallback(
 }
 
 
+/**
+ The maximum number of threads extracting packages at any one time.
+ */
+#define YORIPKG_STAGE_THREADS (8)
+
+/**
+ A package which has been extracted to a staging directory within the
+ install directory, so that its files can be moved into place with renames.
+ */
+typedef struct _YORIPKG_STAGED_PACKAGE {
+
+    /**
+     The package being extracted.
+     */
+    PYORIPKG_PACKAGE_PENDING_INSTALL Package;
+
+    /**
+     The directory that the package has been extracted into.
+     */
+    YORI_STRING StagingDirectory;
+
+    /**
+     The relative path of each file extracted from the package.
+     */
+    YORI_STRING_ARRAY Files;
+
+    /**
+     A description of any error encountered extracting the package.
+     */
+    YORI_STRING ErrorString;
+
+    /**
+     The Win32 error code of any error encountered extracting the package.
+     */
+    DWORD Error;
+
+    /**
+     Set to TRUE once the package has been completely extracted.
+     */
+    BOOLEAN Extracted;
+
+    /**
+     Set to TRUE if the name of an extracted file could not be recorded.
+     */
+    BOOLEAN Failed;
+
+} YORIPKG_STAGED_PACKAGE, *PYORIPKG_STAGED_PACKAGE;
+
+/**
+ A set of packages being extracted to staging directories by a set of
+ threads.
+ */
+typedef struct _YORIPKG_STAGED_INSTALL {
+
+    /**
+     The directory that packages are being installed into.
+     */
+    YORI_STRING FullTargetDirectory;
+
+    /**
+     An array of packages to extract.
+     */
+    PYORIPKG_STAGED_PACKAGE Packages;
+
+    /**
+     The number of elements in the Packages array.
+     */
+    DWORD Count;
+
+} YORIPKG_STAGED_INSTALL, *PYORIPKG_STAGED_INSTALL;
+
+/**
+ Move the files of a package from its staging directory into the install
+ directory, recording each file as part of the package.
+
+ @param Staged Pointer to the package which has been extracted.
+
+ @param FullTargetDirectory Pointer to the install directory.
+
+ @param InstallContext Pointer to the context describing the package being
+        installed.
+
+ @return ERROR_SUCCESS to indicate the files were moved or a file conflict
+         was found, which is indicated in InstallContext.  Otherwise a Win32
+         error code indicating the reason for any failure.
+ */
+DWORD
+YoriPkgMoveStagedPackageFiles(
+    __in PYORIPKG_STAGED_PACKAGE Staged,
+    __in PCYORI_STRING FullTargetDirectory,
+    __in PYORIPKG_INSTALL_PKG_CONTEXT InstallContext
+    )
+{
+    YORI_STRING StagedPath;
+    YORI_STRING TargetPath;
+    YORI_STRING ParentDirectory;
+    PYORI_STRING RelativePath;
+    YORI_ALLOC_SIZE_T Index;
+    YORI_ALLOC_SIZE_T SepIndex;
+    DWORD Error;
+
+    YoriLibInitEmptyString(&StagedPath);
+    YoriLibInitEmptyString(&TargetPath);
+    Error = ERROR_SUCCESS;
+
+    for (Index = 0; Index < Staged->Files.Count; Index++) {
+        RelativePath = &Staged->Files.Items[Index];
+
+        YoriLibYPrintf(&TargetPath, _T("%y\\%y"), FullTargetDirectory, RelativePath);
+        YoriLibYPrintf(&StagedPath, _T("%y\\%y"), &Staged->StagingDirectory, RelativePath);
+        if (TargetPath.LengthInChars == 0 || StagedPath.LengthInChars == 0) {
+            Error = ERROR_NOT_ENOUGH_MEMORY;
+            break;
+        }
+
+        if (!YoriPkgInstallPackageFileCallback(&TargetPath, RelativePath, InstallContext)) {
+            break;
+        }
+
+        if (!MoveFileEx(StagedPath.StartOfString, TargetPath.StartOfString, MOVEFILE_REPLACE_EXISTING)) {
+            Error = GetLastError();
+
+            //
+            //  If the file is in a directory which doesn't exist yet, create
+            //  it and try again.
+            //
+
+            if (Error == ERROR_PATH_NOT_FOUND) {
+                for (SepIndex = TargetPath.LengthInChars; SepIndex > FullTargetDirectory->LengthInChars; SepIndex--) {
+                    if (YoriLibIsSep(TargetPath.StartOfString[SepIndex - 1])) {
+                        break;
+                    }
+                }
+
+                if (SepIndex > FullTargetDirectory->LengthInChars + 1) {
+                    YoriLibInitEmptyString(&ParentDirectory);
+                    ParentDirectory.StartOfString = TargetPath.StartOfString;
+                    ParentDirectory.LengthInChars = SepIndex - 1;
+                    TargetPath.StartOfString[SepIndex - 1] = '\0';
+                    if (YoriLibCreateDirectoryAndParents(&ParentDirectory)) {
+                        TargetPath.StartOfString[SepIndex - 1] = '\\';
+                        if (MoveFileEx(StagedPath.StartOfString, TargetPath.StartOfString, MOVEFILE_REPLACE_EXISTING)) {
+                            Error = ERROR_SUCCESS;
+                        } else {
+                            Error = GetLastError();
+                        }
+                    } else {
+                        Error = GetLastError();
+                    }
+                }
+            }
+
+            if (Error != ERROR_SUCCESS) {
+                YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Could not install %y: "), RelativePath);
+                YoriPkgDisplayErrorStringForInstallFailure(Error);
+                break;
+            }
+        }
+
+        YoriPkgCompressPackageFileCallback(&TargetPath, RelativePath, InstallContext);
+    }
+
+    YoriLibFreeStringContents(&StagedPath);
+    YoriLibFreeStringContents(&TargetPath);
+    return Error;
+}
+
 /**
  Install a package into the system.
 
+ @param PkgIni Pointer to the system global package INI file.
+
  @param PendingPackages Pointer to a list of packages to install, and packages
         backed up in preparation for these installations.
 
@@ -609,17 +763,22 @@ YoriPkgCompressPackageFileCallback(
         install the package.  If NULL, the directory containing the
         application is used.
 
+ @param Staged Optionally points to the package contents which have already
+        been extracted to a staging directory.  If specified, files are moved
+        from the staging directory rather than extracted from the package.
+
  @return TRUE to indicate success, FALSE to indicate failure.
  */
 BOOL
 YoriPkgInstallPackage(
+    __in PYORI_LIB_INI PkgIni,
     __in PYORIPKG_PACKAGES_PENDING_INSTALL PendingPackages,
     __in PYORIPKG_PACKAGE_PENDING_INSTALL Package,
-    __in_opt PCYORI_STRING TargetDirectory
+    __in_opt PCYORI_STRING TargetDirectory,
+    __in_opt PYORIPKG_STAGED_PACKAGE Staged
     )
 {
     YORI_STRING PkgInfoFile;
-    YORI_STRING PkgIniFile;
     YORI_STRING FullTargetDirectory;
 
     YORI_STRING ErrorString;
@@ -634,22 +793,6 @@ YoriPkgInstallPackage(
     YoriLibConstantString(&PkgInfoFile, _T("pkginfo.ini"));
 
     YoriLibInitEmptyString(&FullTargetDirectory);
-    YoriLibInitEmptyString(&PkgIniFile);
-
-    if (DllKernel32.pGetPrivateProfileStringW == NULL ||
-        DllKernel32.pWritePrivateProfileStringW == NULL) {
-
-        goto Exit;
-    }
-
-    //
-    //  Create path to system packages.ini
-    //
-
-    if (!YoriPkgGetPackageIniFile(TargetDirectory, &PkgIniFile)) {
-        YoriLibInitEmptyString(&PkgIniFile);
-        goto Exit;
-    }
 
     if (TargetDirectory != NULL) {
         if (!YoriLibUserStringToSingleFilePath(TargetDirectory, FALSE, &FullTargetDirectory)) {
@@ -679,12 +822,12 @@ YoriPkgInstallPackage(
         }
 
         PkgToDelete.LengthInChars = (YORI_ALLOC_SIZE_T)
-            DllKernel32.pGetPrivateProfileStringW(_T("Installed"),
-                                                  Package->PackageName.StartOfString,
-                                                  _T(""),
-                                                  PkgToDelete.StartOfString,
-                                                  PkgToDelete.LengthAllocated,
-                                                  PkgIniFile.StartOfString);
+            YoriLibIniGetString(PkgIni,
+                                _T("Installed"),
+                                Package->PackageName.StartOfString,
+                                _T(""),
+                                PkgToDelete.StartOfString,
+                                PkgToDelete.LengthAllocated);
 
         //
         //  If the version being installed is already there, we're done.
@@ -715,12 +858,12 @@ YoriPkgInstallPackage(
     //  upgrade will detect a new version and will retry.
     //
 
-    DllKernel32.pWritePrivateProfileStringW(_T("Installed"), Package->PackageName.StartOfString, _T("0"), PkgIniFile.StartOfString);
+    YoriLibIniSetString(PkgIni, _T("Installed"), Package->PackageName.StartOfString, _T("0"));
     if (Package->UpgradePath.LengthInChars > 0) {
-        DllKernel32.pWritePrivateProfileStringW(Package->PackageName.StartOfString,
-                                                _T("UpgradePath"),
-                                                Package->UpgradePath.StartOfString,
-                                                PkgIniFile.StartOfString);
+        YoriLibIniSetString(PkgIni,
+                            Package->PackageName.StartOfString,
+                            _T("UpgradePath"),
+                            Package->UpgradePath.StartOfString);
     }
 
     if (YoriLibGetWofVersionAvailable(&FullTargetDirectory)) {
@@ -740,12 +883,18 @@ YoriPkgInstallPackage(
     //
 
     InstallContext.PendingPackages = PendingPackages;
-    InstallContext.IniFileName = &PkgIniFile;
+    InstallContext.PkgIni = PkgIni;
     InstallContext.PackageName = &Package->PackageName;
     InstallContext.NumberFiles = 0;
     InstallContext.ConflictingFileFound = FALSE;
     YoriLibInitEmptyString(&ErrorString);
-    if (!YoriLibExtractCab(&Package->LocalPackagePath,
+    if (Staged != NULL) {
+        Error = YoriPkgMoveStagedPackageFiles(Staged, &FullTargetDirectory, &InstallContext);
+        if (Error != ERROR_SUCCESS) {
+            YoriLibIniSetString(PkgIni, _T("Installed"), Package->PackageName.StartOfString, NULL);
+            goto Exit;
+        }
+    } else if (!YoriLibExtractCab(&Package->LocalPackagePath,
                            &FullTargetDirectory,
                            TRUE,
                            1,
@@ -762,7 +911,7 @@ YoriPkgInstallPackage(
         //  Mark the package as not requiring upgrade
         //
 
-        DllKernel32.pWritePrivateProfileStringW(_T("Installed"), Package->PackageName.StartOfString, NULL, PkgIniFile.StartOfString);
+        YoriLibIniSetString(PkgIni, _T("Installed"), Package->PackageName.StartOfString, NULL);
 
         //
         //  Remove any trailing newlines in the returned error string
@@ -789,45 +938,78 @@ YoriPkgInstallPackage(
     }
 
     if (InstallContext.ConflictingFileFound) {
-        DllKernel32.pWritePrivateProfileStringW(_T("Installed"), Package->PackageName.StartOfString, NULL, PkgIniFile.StartOfString);
+        YoriLibIniSetString(PkgIni, _T("Installed"), Package->PackageName.StartOfString, NULL);
         YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Install aborted due to file conflict\n"));
         goto Exit;
     }
 
-    DllKernel32.pWritePrivateProfileStringW(Package->PackageName.StartOfString, _T("Version"), Package->Version.StartOfString, PkgIniFile.StartOfString);
-    DllKernel32.pWritePrivateProfileStringW(Package->PackageName.StartOfString, _T("Architecture"), Package->Architecture.StartOfString, PkgIniFile.StartOfString);
+    //
+    //  If this is a delta package, the files it retains from the previous
+    //  version are still part of the package, so record them alongside the
+    //  files that were just extracted.
+    //
+
+    if (Package->UnchangedFiles.LengthInChars > 0) {
+        LPTSTR ThisLine;
+        LPTSTR Equals;
+        YORI_ALLOC_SIZE_T LineLength;
+
+        ThisLine = Package->UnchangedFiles.StartOfString;
+        while (*ThisLine != '\0') {
+            LineLength = (YORI_ALLOC_SIZE_T)_tcslen(ThisLine);
+            Equals = _tcschr(ThisLine, '=');
+            if (Equals != NULL) {
+                *Equals = '\0';
+                InstallContext.NumberFiles++;
+                YoriLibSPrintf(FileIndexString, _T("File%i"), InstallContext.NumberFiles);
+                YoriLibIniSetString(PkgIni, Package->PackageName.StartOfString, FileIndexString, ThisLine);
+                *Equals = '=';
+            }
+            ThisLine += LineLength;
+            ThisLine++;
+        }
+    }
+
+    YoriLibIniSetString(PkgIni, Package->PackageName.StartOfString, _T("Version"), Package->Version.StartOfString);
+    YoriLibIniSetString(PkgIni, Package->PackageName.StartOfString, _T("Architecture"), Package->Architecture.StartOfString);
     if (Package->UpgradePath.LengthInChars > 0) {
-        DllKernel32.pWritePrivateProfileStringW(Package->PackageName.StartOfString, _T("UpgradePath"), Package->UpgradePath.StartOfString, PkgIniFile.StartOfString);
+        YoriLibIniSetString(PkgIni, Package->PackageName.StartOfString, _T("UpgradePath"), Package->UpgradePath.StartOfString);
     }
     if (Package->SourcePath.LengthInChars > 0) {
-        DllKernel32.pWritePrivateProfileStringW(Package->PackageName.StartOfString, _T("SourcePath"), Package->SourcePath.StartOfString, PkgIniFile.StartOfString);
+        YoriLibIniSetString(PkgIni, Package->PackageName.StartOfString, _T("SourcePath"), Package->SourcePath.StartOfString);
     }
     if (Package->SymbolPath.LengthInChars > 0) {
-        DllKernel32.pWritePrivateProfileStringW(Package->PackageName.StartOfString, _T("SymbolPath"), Package->SymbolPath.StartOfString, PkgIniFile.StartOfString);
+        YoriLibIniSetString(PkgIni, Package->PackageName.StartOfString, _T("SymbolPath"), Package->SymbolPath.StartOfString);
     }
     if (Package->UpgradeToDailyPath.LengthInChars > 0) {
-        DllKernel32.pWritePrivateProfileStringW(Package->PackageName.StartOfString,
-                                                _T("UpgradeToDailyPath"),
-                                                Package->UpgradeToDailyPath.StartOfString,
-                                                PkgIniFile.StartOfString);
+        YoriLibIniSetString(PkgIni,
+                            Package->PackageName.StartOfString,
+                            _T("UpgradeToDailyPath"),
+                            Package->UpgradeToDailyPath.StartOfString);
     }
 
     if (Package->UpgradeToStablePath.LengthInChars > 0) {
-        DllKernel32.pWritePrivateProfileStringW(Package->PackageName.StartOfString,
-                                                _T("UpgradeToStablePath"),
-                                                Package->UpgradeToStablePath.StartOfString,
-                                                PkgIniFile.StartOfString);
+        YoriLibIniSetString(PkgIni,
+                            Package->PackageName.StartOfString,
+                            _T("UpgradeToStablePath"),
+                            Package->UpgradeToStablePath.StartOfString);
     }
 
     YoriLibSPrintf(FileIndexString, _T("%i"), InstallContext.NumberFiles);
 
-    DllKernel32.pWritePrivateProfileStringW(Package->PackageName.StartOfString, _T("FileCount"), FileIndexString, PkgIniFile.StartOfString);
-    DllKernel32.pWritePrivateProfileStringW(_T("Installed"), Package->PackageName.StartOfString, Package->Version.StartOfString, PkgIniFile.StartOfString);
+    YoriLibIniSetString(PkgIni, Package->PackageName.StartOfString, _T("FileCount"), FileIndexString);
+    YoriLibIniSetString(PkgIni, _T("Installed"), Package->PackageName.StartOfString, Package->Version.StartOfString);
+
+    //
+    //  Record a digest of each installed file so the package can later be
+    //  checked for modification without reinstalling it.
+    //
+
+    YoriPkgRecordPackageDigests(PkgIni, &FullTargetDirectory, &Package->PackageName, InstallContext.NumberFiles);
 
     Result = TRUE;
 
 Exit:
-    YoriLibFreeStringContents(&PkgIniFile);
     YoriLibFreeStringContents(&FullTargetDirectory);
     if (InstallContext.CompressFiles) {
         YoriLibFreeCompressContext(&InstallContext.CompressContext);
@@ -846,7 +1028,7 @@ Exit:
 
  @param NewArchitecture The new architecture to apply.
 
- @param PkgIniFile Path to the system global store of installed packages.
+ @param PkgIni Pointer to the system global store of installed packages.
 
  @param UpgradePath On input, refers to a fully qualified upgrade path for
         the package.  On successful completion, this is updated to contain
@@ -862,28 +1044,24 @@ BOOL
 YoriPkgBuildUpgradeLocationForNewArchitecture(
     __in PYORI_STRING PackageName,
     __in PYORI_STRING NewArchitecture,
-    __in PYORI_STRING PkgIniFile,
+    __in PYORI_LIB_INI PkgIni,
     __inout PYORI_STRING UpgradePath
     )
 {
     YORI_STRING IniValue;
     YORI_STRING ExistingArchAndExtension;
 
-    if (DllKernel32.pGetPrivateProfileStringW == NULL) {
-        return FALSE;
-    }
-
     if (!YoriLibAllocateString(&IniValue, YORIPKG_MAX_FIELD_LENGTH)) {
         return FALSE;
     }
 
     IniValue.LengthInChars = (YORI_ALLOC_SIZE_T)
-        DllKernel32.pGetPrivateProfileStringW(PackageName->StartOfString,
-                                              _T("Architecture"),
-                                              _T(""),
-                                              IniValue.StartOfString,
-                                              IniValue.LengthAllocated,
-                                              PkgIniFile->StartOfString);
+        YoriLibIniGetString(PkgIni,
+                            PackageName->StartOfString,
+                            _T("Architecture"),
+                            _T(""),
+                            IniValue.StartOfString,
+                            IniValue.LengthAllocated);
     if (IniValue.LengthInChars == 0) {
         YoriLibFreeStringContents(&IniValue);
         return FALSE;
@@ -929,13 +1107,333 @@ YoriPkgBuildUpgradeLocationForNewArchitecture(
 }
 
 
+/**
+ A callback invoked after each file has been extracted into a staging
+ directory, which records the name of the file so it can be moved into
+ place later.
+
+ @param FullPath The full path name of the file on disk.
+
+ @param RelativePath The relative path name of the file as stored within the
+        package.
+
+ @param Context Pointer to the YORIPKG_STAGED_PACKAGE structure.
+
+ @return TRUE, but this value is ignored since the file is already extracted.
+ */
+BOOL
+YoriPkgStagePackageFileCallback(
+    __in PYORI_STRING FullPath,
+    __in PYORI_STRING RelativePath,
+    __in PVOID Context
+    )
+{
+    PYORIPKG_STAGED_PACKAGE Staged = (PYORIPKG_STAGED_PACKAGE)Context;
+
+    UNREFERENCED_PARAMETER(FullPath);
+
+    if (!YoriStringArrayAddItems(&Staged->Files, RelativePath, 1)) {
+        Staged->Failed = TRUE;
+    }
+
+    return TRUE;
+}
+
+/**
+ Extract a single package into its staging directory.  This is invoked on
+ multiple threads concurrently, each operating on a different package.
+
+ @param Context Pointer to the YORIPKG_STAGED_INSTALL structure.
+
+ @param Index The index of the package within the set to extract.
+ */
+VOID
+YoriPkgStagePackage(
+    __in PVOID Context,
+    __in DWORD Index
+    )
+{
+    PYORIPKG_STAGED_INSTALL StagedInstall = (PYORIPKG_STAGED_INSTALL)Context;
+    PYORIPKG_STAGED_PACKAGE Staged;
+    YORI_STRING PkgInfoFile;
+
+    YoriLibConstantString(&PkgInfoFile, _T("pkginfo.ini"));
+
+    Staged = &StagedInstall->Packages[Index];
+    Staged->Error = ERROR_SUCCESS;
+    if (YoriLibExtractCab(&Staged->Package->LocalPackagePath,
+                          &Staged->StagingDirectory,
+                          TRUE,
+                          1,
+                          &PkgInfoFile,
+                          0,
+                          NULL,
+                          NULL,
+                          YoriPkgStagePackageFileCallback,
+                          Staged,
+                          &Staged->Error,
+                          &Staged->ErrorString)) {
+
+        if (Staged->Failed) {
+            Staged->Error = ERROR_NOT_ENOUGH_MEMORY;
+        } else {
+            Staged->Extracted = TRUE;
+        }
+    }
+}
+
+/**
+ Free a set of staged packages, including deleting anything that remains in
+ their staging directories.
+
+ @param StagedInstall Pointer to the set of staged packages.
+ */
+VOID
+YoriPkgFreeStagedInstall(
+    __inout PYORIPKG_STAGED_INSTALL StagedInstall
+    )
+{
+    DWORD Index;
+
+    if (StagedInstall->Packages != NULL) {
+        for (Index = 0; Index < StagedInstall->Count; Index++) {
+            YoriPkgDeleteTempDirectory(&StagedInstall->Packages[Index].StagingDirectory);
+            YoriStringArrayCleanup(&StagedInstall->Packages[Index].Files);
+            YoriLibFreeStringContents(&StagedInstall->Packages[Index].ErrorString);
+        }
+        YoriLibFree(StagedInstall->Packages);
+        StagedInstall->Packages = NULL;
+    }
+
+    YoriLibFreeStringContents(&StagedInstall->FullTargetDirectory);
+    StagedInstall->Count = 0;
+}
+
+/**
+ Extract every package awaiting installation into a staging directory
+ within the install directory, using a set of threads so that packages are
+ extracted concurrently.  Because the staging directories are on the same
+ volume as the install directory, the files can then be moved into place
+ with a short series of renames.
+
+ @param PendingPackages Pointer to the list of packages to install.
+
+ @param TargetDirectory Optionally points to the install directory.  If not
+        specified, the directory containing the application is used.
+
+ @param PackageCount The number of packages in PendingPackages.
+
+ @param StagedInstall On successful completion, populated with the set of
+        staged packages.  The caller should free this with
+        @ref YoriPkgFreeStagedInstall .  Note that individual packages may
+        have failed to extract, which is indicated within this structure.
+
+ @return TRUE to indicate packages were staged, FALSE if staging could not be
+         performed, in which case packages should be extracted directly.
+ */
+__success(return)
+BOOL
+YoriPkgStagePendingPackages(
+    __in PYORIPKG_PACKAGES_PENDING_INSTALL PendingPackages,
+    __in_opt PCYORI_STRING TargetDirectory,
+    __in DWORD PackageCount,
+    __out PYORIPKG_STAGED_INSTALL StagedInstall
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    DWORD Index;
+
+    ZeroMemory(StagedInstall, sizeof(YORIPKG_STAGED_INSTALL));
+
+    if (TargetDirectory != NULL) {
+        if (!YoriLibUserStringToSingleFilePath(TargetDirectory, FALSE, &StagedInstall->FullTargetDirectory)) {
+            YoriLibInitEmptyString(&StagedInstall->FullTargetDirectory);
+            return FALSE;
+        }
+    } else {
+        if (!YoriPkgGetApplicationDirectory(&StagedInstall->FullTargetDirectory)) {
+            YoriLibInitEmptyString(&StagedInstall->FullTargetDirectory);
+            return FALSE;
+        }
+    }
+
+    StagedInstall->Packages = YoriLibMalloc(PackageCount * sizeof(YORIPKG_STAGED_PACKAGE));
+    if (StagedInstall->Packages == NULL) {
+        YoriPkgFreeStagedInstall(StagedInstall);
+        return FALSE;
+    }
+
+    ZeroMemory(StagedInstall->Packages, PackageCount * sizeof(YORIPKG_STAGED_PACKAGE));
+
+    ListEntry = YoriLibGetNextListEntry(&PendingPackages->PackageList, NULL);
+    while (ListEntry != NULL && StagedInstall->Count < PackageCount) {
+        Index = StagedInstall->Count;
+        StagedInstall->Packages[Index].Package = CONTAINING_RECORD(ListEntry, YORIPKG_PACKAGE_PENDING_INSTALL, PackageList);
+        YoriStringArrayInitialize(&StagedInstall->Packages[Index].Files);
+        YoriLibInitEmptyString(&StagedInstall->Packages[Index].ErrorString);
+        StagedInstall->Count++;
+        if (!YoriPkgCreateTempDirectory(&StagedInstall->FullTargetDirectory, &StagedInstall->Packages[Index].StagingDirectory)) {
+            YoriLibInitEmptyString(&StagedInstall->Packages[Index].StagingDirectory);
+            YoriPkgFreeStagedInstall(StagedInstall);
+            return FALSE;
+        }
+        ListEntry = YoriLibGetNextListEntry(&PendingPackages->PackageList, ListEntry);
+    }
+
+    //
+    //  Load cabinet.dll before any threads need it.
+    //
+
+    YoriLibLoadCabinetFunctions();
+
+    YoriLibProcessItemsInParallel(StagedInstall->Count, YORIPKG_STAGE_THREADS, YoriPkgStagePackage, StagedInstall);
+
+    return TRUE;
+}
+
+/**
+ Check that every package has been extracted successfully, and that no file
+ in any package conflicts with a file from another installed package or with
+ a file from another package being installed.  This is performed before any
+ file is moved into place, so if any package cannot be installed, no files
+ have been changed.
+
+ @param PendingPackages Pointer to the list of packages to install.
+
+ @param StagedInstall Pointer to the set of staged packages.
+
+ @return TRUE to indicate all packages can be moved into place, FALSE if
+         they cannot.
+ */
+BOOL
+YoriPkgCheckStagedPackages(
+    __in PYORIPKG_PACKAGES_PENDING_INSTALL PendingPackages,
+    __in PYORIPKG_STAGED_INSTALL StagedInstall
+    )
+{
+    PYORIPKG_STAGED_PACKAGE Staged;
+    PYORIPKG_STAGED_PACKAGE OtherStaged;
+    PYORI_STRING RelativePath;
+    YORI_STRING TargetPath;
+    PYORI_HASH_TABLE StagedFilesTable;
+    PYORI_HASH_ENTRY StagedFileEntries;
+    PYORI_HASH_ENTRY HashEntry;
+    DWORD Index;
+    DWORD TotalFiles;
+    DWORD EntryCount;
+    YORI_ALLOC_SIZE_T FileIndex;
+    BOOL Result;
+
+    //
+    //  Build a table of every file being installed so that two packages
+    //  in this set which contain the same file can be detected.
+    //
+
+    TotalFiles = 0;
+    for (Index = 0; Index < StagedInstall->Count; Index++) {
+        TotalFiles += StagedInstall->Packages[Index].Files.Count;
+    }
+
+    StagedFilesTable = YoriLibAllocateHashTable(253);
+    if (StagedFilesTable == NULL) {
+        YoriPkgDisplayErrorStringForInstallFailure(ERROR_NOT_ENOUGH_MEMORY);
+        return FALSE;
+    }
+
+    StagedFileEntries = NULL;
+    if (TotalFiles > 0) {
+        StagedFileEntries = YoriLibMalloc(TotalFiles * sizeof(YORI_HASH_ENTRY));
+        if (StagedFileEntries == NULL) {
+            YoriLibFreeEmptyHashTable(StagedFilesTable);
+            YoriPkgDisplayErrorStringForInstallFailure(ERROR_NOT_ENOUGH_MEMORY);
+            return FALSE;
+        }
+    }
+
+    EntryCount = 0;
+    YoriLibInitEmptyString(&TargetPath);
+    Result = TRUE;
+
+    for (Index = 0; Index < StagedInstall->Count && Result; Index++) {
+        Staged = &StagedInstall->Packages[Index];
+        if (!Staged->Extracted) {
+
+            //
+            //  Remove any trailing newlines in the returned error string
+            //
+
+            while (Staged->ErrorString.LengthInChars > 0 &&
+                   (Staged->ErrorString.StartOfString[Staged->ErrorString.LengthInChars - 1] == '\r' ||
+                    Staged->ErrorString.StartOfString[Staged->ErrorString.LengthInChars - 1] == '\n')) {
+                Staged->ErrorString.LengthInChars--;
+            }
+
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Could not install %y: %y\n"), &Staged->Package->LocalPackagePath, &Staged->ErrorString);
+            if (Staged->Error == ERROR_ACCESS_DENIED || Staged->Error == ERROR_NOT_ENOUGH_MEMORY) {
+                YoriPkgDisplayErrorStringForInstallFailure(Staged->Error);
+            }
+            Result = FALSE;
+            break;
+        }
+
+        for (FileIndex = 0; FileIndex < Staged->Files.Count; FileIndex++) {
+            RelativePath = &Staged->Files.Items[FileIndex];
+            YoriLibYPrintf(&TargetPath, _T("%y\\%y"), &StagedInstall->FullTargetDirectory, RelativePath);
+            if (TargetPath.LengthInChars == 0) {
+                Result = FALSE;
+                break;
+            }
+
+            if (YoriPkgIsFileToBeDeletedOnReboot(&TargetPath)) {
+                YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("File %y is scheduled to be deleted on next reboot\n"), &TargetPath);
+                YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Install aborted due to file conflict\n"));
+                Result = FALSE;
+                break;
+            }
+
+            if (YoriPkgCheckIfFileAlreadyExists(PendingPackages, RelativePath)) {
+                YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Install of package %y conflicts with installed file %y\n"), &Staged->Package->PackageName, RelativePath);
+                YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Install aborted due to file conflict\n"));
+                Result = FALSE;
+                break;
+            }
+
+            HashEntry = YoriLibHashLookupByKey(StagedFilesTable, RelativePath);
+            if (HashEntry != NULL) {
+                OtherStaged = (PYORIPKG_STAGED_PACKAGE)HashEntry->Context;
+                YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Install of package %y conflicts with file %y from package %y\n"), &Staged->Package->PackageName, RelativePath, &OtherStaged->Package->PackageName);
+                YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Install aborted due to file conflict\n"));
+                Result = FALSE;
+                break;
+            }
+
+            ASSERT(EntryCount < TotalFiles);
+            YoriLibHashInsertByKey(StagedFilesTable, RelativePath, Staged, &StagedFileEntries[EntryCount]);
+            EntryCount++;
+        }
+    }
+
+    for (Index = 0; Index < EntryCount; Index++) {
+        YoriLibHashRemoveByEntry(&StagedFileEntries[Index]);
+    }
+    YoriLibFreeEmptyHashTable(StagedFilesTable);
+    if (StagedFileEntries != NULL) {
+        YoriLibFree(StagedFileEntries);
+    }
+
+    YoriLibFreeStringContents(&TargetPath);
+    return Result;
+}
+
 /**
  Install a set of packages.  If all installations succeed, commit the set
  (removing backups) and return TRUE.  If anything fails, roll back all backed
  up packages and return FALSE.  Note this function generates output for the
  user.
 
- @param PkgIniFile Pointer to the system global package INI file.
+ @param PkgIni Pointer to the system global package INI file.  On success,
+        all changes made to it are written back to disk, which is the point
+        at which the installation is committed.
 
  @param TargetDirectory Pointer to a string specifying the directory
         containing the package.  If NULL, the directory containing the
@@ -949,15 +1447,18 @@ YoriPkgBuildUpgradeLocationForNewArchitecture(
  */
 BOOL
 YoriPkgInstallPendingPackages(
-    __in PYORI_STRING PkgIniFile,
+    __in PYORI_LIB_INI PkgIni,
     __in_opt PCYORI_STRING TargetDirectory,
     __in PYORIPKG_PACKAGES_PENDING_INSTALL PendingPackages
     )
 {
     PYORIPKG_PACKAGE_PENDING_INSTALL PendingPackage;
+    PYORIPKG_STAGED_PACKAGE Staged;
+    YORIPKG_STAGED_INSTALL StagedInstall;
     PYORI_LIST_ENTRY ListEntry;
     DWORD TotalCount;
     DWORD CurrentIndex;
+    BOOL StagingActive;
     BOOL Result;
 
     //
@@ -965,7 +1466,7 @@ YoriPkgInstallPendingPackages(
     //  prior to this installation and are not replaced by it
     //
 
-    YoriPkgAddExistingFilesToPendingPackages(PkgIniFile, PendingPackages);
+    YoriPkgAddExistingFilesToPendingPackages(PkgIni, PendingPackages);
 
     //
     //  Count the number of packages to install
@@ -979,15 +1480,33 @@ YoriPkgInstallPendingPackages(
         ListEntry = YoriLibGetNextListEntry(&PendingPackages->PackageList, ListEntry);
     }
 
+    //
+    //  If there is more than one package, extract them all concurrently
+    //  into staging directories, and check that all of them can be
+    //  installed before changing anything.  Installing each package then
+    //  consists of moving files into place.  If staging cannot be
+    //  performed, each package is extracted in turn as it is installed.
+    //
+
+    Result = TRUE;
+    StagingActive = FALSE;
+    if (TotalCount > 1) {
+        if (YoriPkgStagePendingPackages(PendingPackages, TargetDirectory, TotalCount, &StagedInstall)) {
+            StagingActive = TRUE;
+            if (!YoriPkgCheckStagedPackages(PendingPackages, &StagedInstall)) {
+                Result = FALSE;
+            }
+        }
+    }
+
     //
     //  Install the list of packages
     //
 
     ListEntry = NULL;
-    Result = TRUE;
     CurrentIndex = 0;
     ListEntry = YoriLibGetNextListEntry(&PendingPackages->PackageList, ListEntry);
-    while (ListEntry != NULL) {
+    while (ListEntry != NULL && Result) {
         CurrentIndex++;
         PendingPackage = CONTAINING_RECORD(ListEntry, YORIPKG_PACKAGE_PENDING_INSTALL, PackageList);
         ListEntry = YoriLibGetNextListEntry(&PendingPackages->PackageList, ListEntry);
@@ -997,18 +1516,40 @@ YoriPkgInstallPendingPackages(
                       &PendingPackage->Version,
                       CurrentIndex,
                       TotalCount);
-        if (!YoriPkgInstallPackage(PendingPackages, PendingPackage, TargetDirectory)) {
+        Staged = NULL;
+        if (StagingActive) {
+            ASSERT(StagedInstall.Packages[CurrentIndex - 1].Package == PendingPackage);
+            Staged = &StagedInstall.Packages[CurrentIndex - 1];
+        }
+        if (!YoriPkgInstallPackage(PkgIni, PendingPackages, PendingPackage, TargetDirectory, Staged)) {
             Result = FALSE;
             break;
         }
     }
 
+    if (StagingActive) {
+        YoriPkgFreeStagedInstall(&StagedInstall);
+    }
+
+    //
+    //  Write the updated package state back to disk.  Until this point the
+    //  file on disk still describes the previously installed packages, so
+    //  if this fails, restoring the backed up files returns the system to
+    //  a consistent state.
+    //
+
+    if (Result) {
+        if (!YoriPkgFlushPackageIni(PkgIni)) {
+            Result = FALSE;
+        }
+    }
+
     if (Result) {
         YoriPkgCommitAndFreeBackupPackageList(&PendingPackages->BackupPackages);
     }
 
     if (!YoriLibIsListEmpty(&PendingPackages->BackupPackages)) {
-        YoriPkgRollbackAndFreeBackupPackageList(PkgIniFile, TargetDirectory, &PendingPackages->BackupPackages);
+        YoriPkgRollbackAndFreeBackupPackageList(PkgIni, TargetDirectory, &PendingPackages->BackupPackages);
     }
 
     return Result;
@@ -72,6 +72,20 @@ typedef struct _YORIPKG_REMOTE_PACKAGE {
      */
     YORI_STRING InstallUrl;
 
+    /**
+     The version of the package that DeltaUrl can be applied to.  Note that
+     this may be an empty string if the source does not provide a delta
+     package.
+     */
+    YORI_STRING DeltaFromVersion;
+
+    /**
+     A fully qualified path name or URL that contains a delta package, which
+     only contains the files that changed since DeltaFromVersion.  Note that
+     this may be an empty string.
+     */
+    YORI_STRING DeltaUrl;
+
     /**
      If attempting an upgrade, points to a backup of the previous version of
      the package.
@@ -219,6 +233,13 @@ YoriPkgFreeRemoteSource(
  @param RelativePackageUrl The path to the package relative to the
         SourceRootUrl.
 
+ @param DeltaFromVersion The version of the package that the delta package
+        can be applied to.  Note that this can be an empty string.
+
+ @param RelativeDeltaUrl The path to a delta package relative to the
+        SourceRootUrl.  Note that this can be an empty string if the source
+        does not provide a delta package.
+
  @return Pointer to the package object.  This can be freed with
          @ref YoriPkgFreeRemotePackage .  This will be NULL on allocation failure.
 
@@ -231,7 +252,9 @@ YoriPkgAllocateRemotePackage(
     __in PYORI_STRING MinimumOSBuild,
     __in PYORI_STRING PackagePathForOlderBuilds,
     __in PYORI_STRING SourceRootUrl,
-    __in PYORI_STRING RelativePackageUrl
+    __in PYORI_STRING RelativePackageUrl,
+    __in PYORI_STRING DeltaFromVersion,
+    __in PYORI_STRING RelativeDeltaUrl
     )
 {
     PYORIPKG_REMOTE_PACKAGE Package;
@@ -246,7 +269,10 @@ YoriPkgAllocateRemotePackage(
                      MinimumOSBuild->LengthInChars + 1 +
                      PackagePathForOlderBuilds->LengthInChars + 1 +
                      SourceRootUrl->LengthInChars + 1 +
-                     RelativePackageUrl->LengthInChars + 1) * sizeof(TCHAR);
+                     RelativePackageUrl->LengthInChars + 1 +
+                     DeltaFromVersion->LengthInChars + 1 +
+                     SourceRootUrl->LengthInChars + 1 +
+                     RelativeDeltaUrl->LengthInChars + 1) * sizeof(TCHAR);
 
     if (!YoriLibIsSizeAllocatable(BytesRequired)) {
         return NULL;
@@ -324,6 +350,32 @@ YoriPkgAllocateRemotePackage(
 
     Package->InstallUrl.LengthAllocated = Package->InstallUrl.LengthInChars + 1;
 
+    WritePtr += Package->InstallUrl.LengthAllocated;
+
+    YoriLibReference(Package);
+    Package->DeltaFromVersion.MemoryToFree = Package;
+    Package->DeltaFromVersion.StartOfString = WritePtr;
+    Package->DeltaFromVersion.LengthInChars = DeltaFromVersion->LengthInChars;
+    memcpy(Package->DeltaFromVersion.StartOfString, DeltaFromVersion->StartOfString, DeltaFromVersion->LengthInChars * sizeof(TCHAR));
+    Package->DeltaFromVersion.StartOfString[DeltaFromVersion->LengthInChars] = '\0';
+    Package->DeltaFromVersion.LengthAllocated = Package->DeltaFromVersion.LengthInChars + 1;
+
+    WritePtr += Package->DeltaFromVersion.LengthAllocated;
+
+    YoriLibReference(Package);
+    Package->DeltaUrl.MemoryToFree = Package;
+    Package->DeltaUrl.StartOfString = WritePtr;
+    if (RelativeDeltaUrl->LengthInChars == 0) {
+        Package->DeltaUrl.LengthInChars = 0;
+        Package->DeltaUrl.StartOfString[0] = '\0';
+    } else if (YoriLibIsPathUrl(SourceRootUrl)) {
+        Package->DeltaUrl.LengthInChars = YoriLibSPrintf(Package->DeltaUrl.StartOfString, _T("%y/%y"), SourceRootUrl, RelativeDeltaUrl);
+    } else {
+        Package->DeltaUrl.LengthInChars = YoriLibSPrintf(Package->DeltaUrl.StartOfString, _T("%y\\%y"), SourceRootUrl, RelativeDeltaUrl);
+    }
+
+    Package->DeltaUrl.LengthAllocated = Package->DeltaUrl.LengthInChars + 1;
+
     return Package;
 }
 
@@ -344,6 +396,8 @@ YoriPkgFreeRemotePackage(
     YoriLibFreeStringContents(&Package->MinimumOSBuild);
     YoriLibFreeStringContents(&Package->PackagePathForOlderBuilds);
     YoriLibFreeStringContents(&Package->InstallUrl);
+    YoriLibFreeStringContents(&Package->DeltaFromVersion);
+    YoriLibFreeStringContents(&Package->DeltaUrl);
     YoriLibDereference(Package);
 }
 
@@ -493,6 +547,61 @@ YoriPkgCollectSourcesFromIniWithDefaults(
 }
 
 
+/**
+ Find the value of a key within a section of an INI file which has been
+ loaded into memory with GetPrivateProfileSection.  Loading a complete
+ section and searching it in memory avoids reopening and parsing the INI
+ file for every key.
+
+ @param Section Pointer to the section contents, which consist of a series
+        of NULL terminated key=value lines, followed by an additional NULL.
+
+ @param KeyName The key to find.  This is compared case insensitively.
+
+ @param Value On successful completion, updated to point to the value within
+        the section.  This is not a new allocation.
+
+ @return TRUE to indicate the key was found, FALSE if it was not.
+ */
+__success(return)
+BOOL
+YoriPkgFindSectionValue(
+    __in PYORI_STRING Section,
+    __in LPCTSTR KeyName,
+    __out PYORI_STRING Value
+    )
+{
+    YORI_STRING Key;
+    LPTSTR ThisLine;
+    LPTSTR Equals;
+    YORI_ALLOC_SIZE_T LineLength;
+
+    YoriLibInitEmptyString(Value);
+    YoriLibInitEmptyString(&Key);
+    ThisLine = Section->StartOfString;
+
+    while (*ThisLine != '\0') {
+        LineLength = (YORI_ALLOC_SIZE_T)_tcslen(ThisLine);
+        Equals = _tcschr(ThisLine, '=');
+        if (Equals != NULL) {
+            Key.StartOfString = ThisLine;
+            Key.LengthInChars = (YORI_ALLOC_SIZE_T)(Equals - ThisLine);
+            YoriLibTrimSpaces(&Key);
+            if (YoriLibCompareStringLitIns(&Key, KeyName) == 0) {
+                Value->StartOfString = Equals + 1;
+                Value->LengthInChars = (YORI_ALLOC_SIZE_T)(LineLength - (Equals - ThisLine) - 1);
+                YoriLibTrimSpaces(Value);
+                return TRUE;
+            }
+        }
+
+        ThisLine += LineLength;
+        ThisLine++;
+    }
+
+    return FALSE;
+}
+
 /**
  Scan a repository of packages and collect all packages it contains into a
  caller provided list.
@@ -520,12 +629,15 @@ YoriPkgCollectPackagesFromSource(
 {
     YORI_STRING LocalPath;
     YORI_STRING ProvidesSection;
+    YORI_STRING PackageSection;
     YORI_STRING PkgNameOnly;
     YORI_STRING PkgVersion;
     YORI_STRING IniValue;
     YORI_STRING Architecture;
     YORI_STRING MinimumOSBuild;
     YORI_STRING PackagePathForOlderBuilds;
+    YORI_STRING DeltaFromVersion;
+    YORI_STRING DeltaUrl;
     BOOLEAN DeleteWhenFinished = FALSE;
     LPTSTR ThisLine;
     LPTSTR Equals;
@@ -547,10 +659,7 @@ YoriPkgCollectPackagesFromSource(
 
     YoriLibInitEmptyString(&LocalPath);
     YoriLibInitEmptyString(&ProvidesSection);
-    YoriLibInitEmptyString(&IniValue);
-    YoriLibInitEmptyString(&PkgVersion);
-    YoriLibInitEmptyString(&MinimumOSBuild);
-    YoriLibInitEmptyString(&PackagePathForOlderBuilds);
+    YoriLibInitEmptyString(&PackageSection);
 
     if (DllKernel32.pGetPrivateProfileSectionW == NULL) {
         Result = FALSE;
@@ -559,7 +668,7 @@ YoriPkgCollectPackagesFromSource(
         goto Exit;
     }
 
-    Result = YoriPkgPackagePathToLocalPath(&Source->SourcePkgList, PackagesIni, &LocalPath, &DeleteWhenFinished);
+    Result = YoriPkgPackageIndexToLocalPath(&Source->SourcePkgList, PackagesIni, &LocalPath, &DeleteWhenFinished);
     if (Result != ERROR_SUCCESS) {
         YoriLibInitEmptyString(&LocalPath);
         DeleteWhenFinished = FALSE;
@@ -571,22 +680,7 @@ YoriPkgCollectPackagesFromSource(
         goto Exit;
     }
 
-    if (!YoriLibAllocateString(&PkgVersion, YORIPKG_MAX_SECTION_LENGTH)) {
-        Result = ERROR_NOT_ENOUGH_MEMORY;
-        goto Exit;
-    }
-
-    if (!YoriLibAllocateString(&IniValue, YORIPKG_MAX_SECTION_LENGTH)) {
-        Result = ERROR_NOT_ENOUGH_MEMORY;
-        goto Exit;
-    }
-
-    if (!YoriLibAllocateString(&MinimumOSBuild, YORIPKG_MAX_SECTION_LENGTH)) {
-        Result = ERROR_NOT_ENOUGH_MEMORY;
-        goto Exit;
-    }
-
-    if (!YoriLibAllocateString(&PackagePathForOlderBuilds, YORIPKG_MAX_SECTION_LENGTH)) {
+    if (!YoriLibAllocateString(&PackageSection, YORIPKG_MAX_SECTION_LENGTH)) {
         Result = ERROR_NOT_ENOUGH_MEMORY;
         goto Exit;
     }
@@ -614,59 +708,58 @@ YoriPkgCollectPackagesFromSource(
 
         PkgNameOnly.StartOfString[PkgNameOnly.LengthInChars] = '\0';
 
-        PkgVersion.LengthInChars = (YORI_ALLOC_SIZE_T)
-            DllKernel32.pGetPrivateProfileStringW(PkgNameOnly.StartOfString,
-                                                  _T("Version"),
-                                                  _T(""),
-                                                  PkgVersion.StartOfString,
-                                                  PkgVersion.LengthAllocated,
-                                                  LocalPath.StartOfString);
-
-        if (PkgVersion.LengthInChars > 0) {
-            for (ArchIndex = 0; ArchIndex < sizeof(KnownArchitectures)/sizeof(KnownArchitectures[0]); ArchIndex++) {
-                YoriLibConstantString(&Architecture, KnownArchitectures[ArchIndex]);
-                IniValue.LengthInChars = (YORI_ALLOC_SIZE_T)
-                    DllKernel32.pGetPrivateProfileStringW(PkgNameOnly.StartOfString,
-                                                          Architecture.StartOfString,
-                                                          _T(""),
-                                                          IniValue.StartOfString,
-                                                          IniValue.LengthAllocated,
-                                                          LocalPath.StartOfString);
-                if (IniValue.LengthInChars > 0) {
-                    PYORIPKG_REMOTE_PACKAGE Package;
-
-                    PackagePathForOlderBuilds.LengthInChars = 0;
-
-                    YoriLibSPrintf(IniKey, _T("%y.minimumosbuild"), &Architecture);
-
-                    MinimumOSBuild.LengthInChars = (YORI_ALLOC_SIZE_T)
-                        DllKernel32.pGetPrivateProfileStringW(PkgNameOnly.StartOfString,
-                                                              IniKey,
-                                                              _T(""),
-                                                              MinimumOSBuild.StartOfString,
-                                                              MinimumOSBuild.LengthAllocated,
-                                                              LocalPath.StartOfString);
-                    if (MinimumOSBuild.LengthInChars > 0) {
-                        YoriLibSPrintf(IniKey, _T("%y.packagepathforolderbuilds"), &Architecture);
-                        PackagePathForOlderBuilds.LengthInChars = (YORI_ALLOC_SIZE_T)
-                            DllKernel32.pGetPrivateProfileStringW(PkgNameOnly.StartOfString,
-                                                                  IniKey,
-                                                                  _T(""),
-                                                                  PackagePathForOlderBuilds.StartOfString,
-                                                                  PackagePathForOlderBuilds.LengthAllocated,
-                                                                  LocalPath.StartOfString);
-                    }
+        //
+        //  Load the package's section once and find each value within it.
+        //
 
-                    Package = YoriPkgAllocateRemotePackage(&PkgNameOnly,
-                                                           &PkgVersion,
-                                                           &Architecture,
-                                                           &MinimumOSBuild,
-                                                           &PackagePathForOlderBuilds,
-                                                           &Source->SourceRootUrl,
-                                                           &IniValue);
-                    if (Package != NULL) {
-                        YoriLibAppendList(PackageList, &Package->PackageList);
-                    }
+        PackageSection.LengthInChars = (YORI_ALLOC_SIZE_T)
+            DllKernel32.pGetPrivateProfileSectionW(PkgNameOnly.StartOfString,
+                                                   PackageSection.StartOfString,
+                                                   PackageSection.LengthAllocated,
+                                                   LocalPath.StartOfString);
+
+        if (PackageSection.LengthInChars == 0 ||
+            !YoriPkgFindSectionValue(&PackageSection, _T("Version"), &PkgVersion) ||
+            PkgVersion.LengthInChars == 0) {
+
+            continue;
+        }
+
+        for (ArchIndex = 0; ArchIndex < sizeof(KnownArchitectures)/sizeof(KnownArchitectures[0]); ArchIndex++) {
+            YoriLibConstantString(&Architecture, KnownArchitectures[ArchIndex]);
+            if (YoriPkgFindSectionValue(&PackageSection, Architecture.StartOfString, &IniValue) &&
+                IniValue.LengthInChars > 0) {
+
+                PYORIPKG_REMOTE_PACKAGE Package;
+
+                YoriLibInitEmptyString(&PackagePathForOlderBuilds);
+
+                YoriLibSPrintf(IniKey, _T("%y.minimumosbuild"), &Architecture);
+                YoriPkgFindSectionValue(&PackageSection, IniKey, &MinimumOSBuild);
+                if (MinimumOSBuild.LengthInChars > 0) {
+                    YoriLibSPrintf(IniKey, _T("%y.packagepathforolderbuilds"), &Architecture);
+                    YoriPkgFindSectionValue(&PackageSection, IniKey, &PackagePathForOlderBuilds);
+                }
+
+                YoriLibInitEmptyString(&DeltaUrl);
+                YoriLibSPrintf(IniKey, _T("%y.deltafrom"), &Architecture);
+                YoriPkgFindSectionValue(&PackageSection, IniKey, &DeltaFromVersion);
+                if (DeltaFromVersion.LengthInChars > 0) {
+                    YoriLibSPrintf(IniKey, _T("%y.delta"), &Architecture);
+                    YoriPkgFindSectionValue(&PackageSection, IniKey, &DeltaUrl);
+                }
+
+                Package = YoriPkgAllocateRemotePackage(&PkgNameOnly,
+                                                       &PkgVersion,
+                                                       &Architecture,
+                                                       &MinimumOSBuild,
+                                                       &PackagePathForOlderBuilds,
+                                                       &Source->SourceRootUrl,
+                                                       &IniValue,
+                                                       &DeltaFromVersion,
+                                                       &DeltaUrl);
+                if (Package != NULL) {
+                    YoriLibAppendList(PackageList, &Package->PackageList);
                 }
             }
         }
@@ -683,10 +776,7 @@ Exit:
     }
     YoriLibFreeStringContents(&LocalPath);
     YoriLibFreeStringContents(&ProvidesSection);
-    YoriLibFreeStringContents(&IniValue);
-    YoriLibFreeStringContents(&PkgVersion);
-    YoriLibFreeStringContents(&MinimumOSBuild);
-    YoriLibFreeStringContents(&PackagePathForOlderBuilds);
+    YoriLibFreeStringContents(&PackageSection);
     return Result;
 }
 
@@ -900,6 +990,303 @@ YoriPkgDisplayAvailableRemotePackageNames(VOID)
     return TRUE;
 }
 
+/**
+ A package file within a local mirror, indexed by the digest of its
+ contents so that identical files can be shared between packages.
+ */
+typedef struct _YORIPKG_MIRROR_FILE {
+
+    /**
+     The entry of this file within the table of mirrored files.  The key is
+     the digest of the file contents.
+     */
+    YORI_HASH_ENTRY HashEntry;
+
+    /**
+     A fully specified path to the file within the mirror.
+     */
+    YORI_STRING FilePath;
+
+    /**
+     The digest of the file contents, which points to DigestBuffer.
+     */
+    YORI_STRING Digest;
+
+    /**
+     Buffer for Digest.
+     */
+    TCHAR DigestBuffer[YORIPKG_HASH_SIZE * 2 + 1];
+
+} YORIPKG_MIRROR_FILE, *PYORIPKG_MIRROR_FILE;
+
+/**
+ Find the final component of a package URL, which is used as the file name
+ for the package within a local mirror.
+
+ @param Url Pointer to the URL of the package.
+
+ @param FileName On completion, updated to point within the URL to the final
+        component.  This is an empty string if no final component is found.
+ */
+VOID
+YoriPkgGetUrlFileName(
+    __in PCYORI_STRING Url,
+    __out PYORI_STRING FileName
+    )
+{
+    YORI_ALLOC_SIZE_T Index;
+
+    YoriLibInitEmptyString(FileName);
+    for (Index = Url->LengthInChars; Index > 0; Index--) {
+        if (YoriLibIsSep(Url->StartOfString[Index - 1])) {
+            FileName->StartOfString = &Url->StartOfString[Index];
+            FileName->LengthInChars = Url->LengthInChars - Index;
+            break;
+        }
+    }
+}
+
+/**
+ Check whether a local mirror already contains the current version of a
+ remote package, so the package does not need to be fetched again.
+
+ @param PkgList Pointer to the package list of the local mirror.
+
+ @param DownloadPath Pointer to the directory containing the local mirror.
+
+ @param Package Pointer to the package found on the remote source.
+
+ @return TRUE if the mirror contains the same version of the package for the
+         same architecture under the same file name, and that file exists.
+ */
+BOOL
+YoriPkgIsMirroredPackageCurrent(
+    __in PYORI_LIB_INI PkgList,
+    __in PCYORI_STRING DownloadPath,
+    __in PYORIPKG_REMOTE_PACKAGE Package
+    )
+{
+    YORI_STRING FinalFileName;
+    YORI_STRING IniValue;
+    YORI_STRING FullFinalName;
+    BOOL Result;
+
+    YoriPkgGetUrlFileName(&Package->InstallUrl, &FinalFileName);
+    if (FinalFileName.LengthInChars == 0) {
+        return FALSE;
+    }
+
+    if (!YoriLibAllocateString(&IniValue, YORIPKG_MAX_FIELD_LENGTH)) {
+        return FALSE;
+    }
+
+    Result = FALSE;
+    IniValue.LengthInChars = (YORI_ALLOC_SIZE_T)
+        YoriLibIniGetString(PkgList,
+                            Package->PackageName.StartOfString,
+                            _T("Version"),
+                            _T(""),
+                            IniValue.StartOfString,
+                            IniValue.LengthAllocated);
+
+    if (YoriLibCompareString(&IniValue, &Package->Version) != 0) {
+        goto Exit;
+    }
+
+    IniValue.LengthInChars = (YORI_ALLOC_SIZE_T)
+        YoriLibIniGetString(PkgList,
+                            Package->PackageName.StartOfString,
+                            Package->Architecture.StartOfString,
+                            _T(""),
+                            IniValue.StartOfString,
+                            IniValue.LengthAllocated);
+
+    if (YoriLibCompareStringIns(&IniValue, &FinalFileName) != 0) {
+        goto Exit;
+    }
+
+    YoriLibInitEmptyString(&FullFinalName);
+    YoriLibYPrintf(&FullFinalName, _T("%y\\%y"), DownloadPath, &FinalFileName);
+    if (FullFinalName.LengthInChars > 0 &&
+        GetFileAttributes(FullFinalName.StartOfString) != (DWORD)-1) {
+
+        Result = TRUE;
+    }
+    YoriLibFreeStringContents(&FullFinalName);
+
+Exit:
+    YoriLibFreeStringContents(&IniValue);
+    return Result;
+}
+
+/**
+ Replace a file with a hard link to another file that has identical
+ contents.  If the link cannot be created, the original file is left in
+ place.
+
+ @param ExistingFile Pointer to the file to link to.
+
+ @param FileToReplace Pointer to the file to replace with a link.
+
+ @return TRUE to indicate the file was replaced with a link, FALSE if it was
+         not.
+ */
+__success(return)
+BOOL
+YoriPkgReplaceWithHardLink(
+    __in PCYORI_STRING ExistingFile,
+    __in PCYORI_STRING FileToReplace
+    )
+{
+    YORI_STRING BackupName;
+
+    if (DllKernel32.pCreateHardLinkW == NULL) {
+        return FALSE;
+    }
+
+    if (!YoriLibRenameFileToBackupName(FileToReplace, &BackupName)) {
+        return FALSE;
+    }
+
+    if (!DllKernel32.pCreateHardLinkW(FileToReplace->StartOfString, ExistingFile->StartOfString, NULL)) {
+        MoveFileEx(BackupName.StartOfString, FileToReplace->StartOfString, MOVEFILE_REPLACE_EXISTING);
+        YoriLibFreeStringContents(&BackupName);
+        return FALSE;
+    }
+
+    DeleteFile(BackupName.StartOfString);
+    YoriLibFreeStringContents(&BackupName);
+    return TRUE;
+}
+
+/**
+ Record the digest of a package file within a local mirror, and if another
+ file in the mirror has identical contents, replace the file with a hard link
+ to it.  Packages are often identical across architectures and versions, so
+ this avoids storing the same contents repeatedly.
+
+ @param MirrorFiles Pointer to the table of files in the mirror, indexed by
+        digest.
+
+ @param Provider A crypto provider returned from
+        @ref YoriPkgAcquireHashProvider .
+
+ @param PkgList Pointer to the package list of the local mirror.
+
+ @param Package Pointer to the package that the file contains.
+
+ @param FullFinalName Pointer to the path of the file within the mirror.
+
+ @param Downloaded TRUE if the file has just been fetched.  If FALSE, the
+        file was already present, and any digest previously recorded for it
+        is used.
+ */
+VOID
+YoriPkgAddMirroredFile(
+    __in PYORI_HASH_TABLE MirrorFiles,
+    __in HCRYPTPROV Provider,
+    __in PYORI_LIB_INI PkgList,
+    __in PYORIPKG_REMOTE_PACKAGE Package,
+    __in PYORI_STRING FullFinalName,
+    __in BOOL Downloaded
+    )
+{
+    PYORIPKG_MIRROR_FILE MirrorFile;
+    PYORIPKG_MIRROR_FILE ExistingFile;
+    PYORI_HASH_ENTRY HashEntry;
+    YORI_STRING KeyName;
+
+    MirrorFile = YoriLibReferencedMalloc(sizeof(YORIPKG_MIRROR_FILE));
+    if (MirrorFile == NULL) {
+        return;
+    }
+
+    ZeroMemory(MirrorFile, sizeof(YORIPKG_MIRROR_FILE));
+    YoriLibInitEmptyString(&MirrorFile->Digest);
+    MirrorFile->Digest.MemoryToFree = MirrorFile;
+    MirrorFile->Digest.StartOfString = MirrorFile->DigestBuffer;
+    MirrorFile->Digest.LengthAllocated = sizeof(MirrorFile->DigestBuffer) / sizeof(TCHAR);
+
+    YoriLibInitEmptyString(&KeyName);
+    YoriLibYPrintf(&KeyName, _T("%y.sha1"), &Package->Architecture);
+    if (KeyName.LengthInChars == 0) {
+        YoriLibDereference(MirrorFile);
+        return;
+    }
+
+    if (!Downloaded) {
+        MirrorFile->Digest.LengthInChars = (YORI_ALLOC_SIZE_T)
+            YoriLibIniGetString(PkgList,
+                                Package->PackageName.StartOfString,
+                                KeyName.StartOfString,
+                                _T(""),
+                                MirrorFile->Digest.StartOfString,
+                                MirrorFile->Digest.LengthAllocated);
+    }
+
+    if (MirrorFile->Digest.LengthInChars != YORIPKG_HASH_SIZE * 2) {
+        if (!YoriPkgHashFile(Provider, FullFinalName, &MirrorFile->Digest)) {
+            YoriLibFreeStringContents(&KeyName);
+            YoriLibDereference(MirrorFile);
+            return;
+        }
+    }
+
+    YoriLibIniSetString(PkgList,
+                        Package->PackageName.StartOfString,
+                        KeyName.StartOfString,
+                        MirrorFile->Digest.StartOfString);
+    YoriLibFreeStringContents(&KeyName);
+
+    //
+    //  If another file has the same contents, link a newly fetched file to
+    //  it.  Files which were already present are left alone, since they
+    //  are either linked already or were placed there deliberately.
+    //
+
+    HashEntry = YoriLibHashLookupByKey(MirrorFiles, &MirrorFile->Digest);
+    if (HashEntry != NULL) {
+        ExistingFile = CONTAINING_RECORD(HashEntry, YORIPKG_MIRROR_FILE, HashEntry);
+        if (Downloaded &&
+            YoriLibCompareStringIns(&ExistingFile->FilePath, FullFinalName) != 0 &&
+            YoriPkgReplaceWithHardLink(&ExistingFile->FilePath, FullFinalName)) {
+
+            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("Linked %y to identical %y\n"), FullFinalName, &ExistingFile->FilePath);
+        }
+        YoriLibDereference(MirrorFile);
+        return;
+    }
+
+    YoriLibCloneString(&MirrorFile->FilePath, FullFinalName);
+    YoriLibHashInsertByKey(MirrorFiles, &MirrorFile->Digest, MirrorFile, &MirrorFile->HashEntry);
+}
+
+/**
+ Free the table of files in a local mirror.
+
+ @param MirrorFiles Pointer to the table of files in the mirror.
+ */
+VOID
+YoriPkgFreeMirroredFiles(
+    __in PYORI_HASH_TABLE MirrorFiles
+    )
+{
+    PYORI_HASH_ENTRY HashEntry;
+    PYORI_HASH_ENTRY NextEntry;
+    PYORIPKG_MIRROR_FILE MirrorFile;
+
+    HashEntry = YoriLibHashGetNextEntry(MirrorFiles, NULL);
+    while (HashEntry != NULL) {
+        NextEntry = YoriLibHashGetNextEntry(MirrorFiles, HashEntry);
+        MirrorFile = CONTAINING_RECORD(HashEntry, YORIPKG_MIRROR_FILE, HashEntry);
+        YoriLibHashRemoveByEntry(&MirrorFile->HashEntry);
+        YoriLibFreeStringContents(&MirrorFile->FilePath);
+        YoriLibDereference(MirrorFile);
+        HashEntry = NextEntry;
+    }
+    YoriLibFreeEmptyHashTable(MirrorFiles);
+}
+
 /**
  Enumerate all packages on a server from its pkglist.ini, download all of the
  packages to a local directory, and generate a pkglist.ini in that directory
@@ -909,31 +1296,45 @@ YoriPkgDisplayAvailableRemotePackageNames(VOID)
 
  @param DownloadPath Pointer to a local path to save packages.
 
+ @param Incremental If TRUE, the local path is a mirror which is being kept
+        current.  Packages which the mirror already contains are not fetched
+        again, and fetched packages with contents identical to another
+        package in the mirror are replaced with hard links.  If FALSE, every
+        package is fetched.
+
  @return TRUE to indicate success, FALSE to indicate failure.
  */
 BOOL
 YoriPkgDownloadRemotePackages(
     __in PYORI_STRING Source,
-    __in PYORI_STRING DownloadPath
+    __in PYORI_STRING DownloadPath,
+    __in BOOL Incremental
     )
 {
     YORI_LIST_ENTRY SourcesList;
     YORI_LIST_ENTRY PackageList;
+    YORI_LIST_ENTRY CurrentPackageList;
     PYORI_LIST_ENTRY PackageEntry;
+    PYORI_LIST_ENTRY NextPackageEntry;
     PYORIPKG_REMOTE_PACKAGE Package;
     YORI_STRING FinalFileName;
     YORI_STRING FullFinalName;
     YORI_STRING TempLocalPath;
     YORI_STRING PackagesIni;
-    YORI_ALLOC_SIZE_T Index;
+    YORI_LIB_INI PkgList;
+    YORI_LIST_ENTRY Downloads;
+    PYORI_HASH_TABLE MirrorFiles;
+    HCRYPTPROV Provider;
+    DWORD CurrentCount;
     DWORD Err;
     BOOLEAN DeleteWhenFinished;
-
-    if (DllKernel32.pWritePrivateProfileStringW == NULL) {
-        return FALSE;
-    }
+    BOOL Result;
 
     YoriPkgCollectAllSourcesAndPackages(Source, NULL, &SourcesList, &PackageList);
+    YoriLibInitializeListHead(&Downloads);
+    YoriLibInitializeListHead(&CurrentPackageList);
+    MirrorFiles = NULL;
+    Provider = 0;
 
     YoriLibInitEmptyString(&PackagesIni);
     YoriLibYPrintf(&PackagesIni, _T("%y\\pkglist.ini"), DownloadPath);
@@ -943,9 +1344,86 @@ YoriPkgDownloadRemotePackages(
     }
 
     //
-    //  Download the packages we found.
+    //  Load any existing package list so that entries for packages which
+    //  are already there are retained.  All entries are written back once
+    //  every package has been saved.
+    //
+
+    if (!YoriLibIniLoad(&PkgList, &PackagesIni)) {
+        YoriLibFreeStringContents(&PackagesIni);
+        YoriPkgFreeAllSourcesAndPackages(&SourcesList, &PackageList);
+        return FALSE;
+    }
+
+    //
+    //  When keeping a mirror current, set aside the packages that the
+    //  mirror already contains.  This is decided for every package before
+    //  any entry is updated, since several architectures of a package
+    //  share its version.
     //
 
+    if (Incremental) {
+        CurrentCount = 0;
+        PackageEntry = YoriLibGetNextListEntry(&PackageList, NULL);
+        while (PackageEntry != NULL) {
+            NextPackageEntry = YoriLibGetNextListEntry(&PackageList, PackageEntry);
+            Package = CONTAINING_RECORD(PackageEntry, YORIPKG_REMOTE_PACKAGE, PackageList);
+            if (YoriPkgIsMirroredPackageCurrent(&PkgList, DownloadPath, Package)) {
+                YoriLibRemoveListItem(&Package->PackageList);
+                YoriLibAppendList(&CurrentPackageList, &Package->PackageList);
+                CurrentCount++;
+            }
+            PackageEntry = NextPackageEntry;
+        }
+
+        if (CurrentCount > 0) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%i packages are already current\n"), CurrentCount);
+        }
+
+        //
+        //  Index the contents of the mirror so identical packages can be
+        //  linked.  If digests can't be generated, packages are still
+        //  fetched, but not linked.
+        //
+
+        if (YoriPkgAcquireHashProvider(&Provider)) {
+            MirrorFiles = YoriLibAllocateHashTable(1000);
+            if (MirrorFiles == NULL) {
+                DllAdvApi32.pCryptReleaseContext(Provider, 0);
+            }
+        }
+
+        if (MirrorFiles != NULL) {
+            PackageEntry = YoriLibGetNextListEntry(&CurrentPackageList, NULL);
+            while (PackageEntry != NULL) {
+                Package = CONTAINING_RECORD(PackageEntry, YORIPKG_REMOTE_PACKAGE, PackageList);
+                YoriPkgGetUrlFileName(&Package->InstallUrl, &FinalFileName);
+                YoriLibInitEmptyString(&FullFinalName);
+                YoriLibYPrintf(&FullFinalName, _T("%y\\%y"), DownloadPath, &FinalFileName);
+                if (FullFinalName.LengthInChars > 0) {
+                    YoriPkgAddMirroredFile(MirrorFiles, Provider, &PkgList, Package, &FullFinalName, FALSE);
+                }
+                YoriLibFreeStringContents(&FullFinalName);
+                PackageEntry = YoriLibGetNextListEntry(&CurrentPackageList, PackageEntry);
+            }
+        }
+    }
+
+    //
+    //  Download the packages we found.  All of the packages are downloaded
+    //  concurrently first, then moved into place.
+    //
+
+    PackageEntry = NULL;
+    PackageEntry = YoriLibGetNextListEntry(&PackageList, PackageEntry);
+    while (PackageEntry != NULL) {
+        Package = CONTAINING_RECORD(PackageEntry, YORIPKG_REMOTE_PACKAGE, PackageList);
+        YoriPkgQueueDownload(&Downloads, &Package->InstallUrl);
+        PackageEntry = YoriLibGetNextListEntry(&PackageList, PackageEntry);
+    }
+
+    YoriPkgCompleteDownloads(&Downloads, NULL);
+
     PackageEntry = NULL;
     PackageEntry = YoriLibGetNextListEntry(&PackageList, PackageEntry);
     while (PackageEntry != NULL) {
@@ -955,14 +1433,7 @@ YoriPkgDownloadRemotePackages(
         //  Find the final file component in the URL
         //
 
-        YoriLibInitEmptyString(&FinalFileName);
-        for (Index = Package->InstallUrl.LengthInChars; Index > 0; Index--) {
-            if (YoriLibIsSep(Package->InstallUrl.StartOfString[Index - 1])) {
-                FinalFileName.StartOfString = &Package->InstallUrl.StartOfString[Index];
-                FinalFileName.LengthInChars = Package->InstallUrl.LengthInChars - Index;
-                break;
-            }
-        }
+        YoriPkgGetUrlFileName(&Package->InstallUrl, &FinalFileName);
 
         YoriLibInitEmptyString(&FullFinalName);
         if (FinalFileName.LengthInChars > 0) {
@@ -974,7 +1445,9 @@ YoriPkgDownloadRemotePackages(
             //
 
             YoriLibInitEmptyString(&TempLocalPath);
-            Err = YoriPkgPackagePathToLocalPath(&Package->InstallUrl, NULL, &TempLocalPath, &DeleteWhenFinished);
+            if (!YoriPkgTakeDownload(&Downloads, &Package->InstallUrl, &Err, &TempLocalPath, &DeleteWhenFinished)) {
+                Err = YoriPkgPackagePathToLocalPath(&Package->InstallUrl, NULL, &TempLocalPath, &DeleteWhenFinished);
+            }
             if (Err == ERROR_SUCCESS) {
                 YoriLibYPrintf(&FullFinalName, _T("%y\\%y"), DownloadPath, &FinalFileName);
                 if (FullFinalName.LengthInChars == 0) {
@@ -987,6 +1460,16 @@ YoriPkgDownloadRemotePackages(
                             DeleteFile(TempLocalPath.StartOfString);
                         }
                     } else {
+
+                        //
+                        //  In a mirror the existing file may be a hard link
+                        //  shared with another package, so remove it rather
+                        //  than overwriting the shared contents.
+                        //
+
+                        if (Incremental) {
+                            DeleteFile(FullFinalName.StartOfString);
+                        }
                         Err = YoriLibCopyFile(&TempLocalPath, &FullFinalName);
                     }
                 }
@@ -994,6 +1477,10 @@ YoriPkgDownloadRemotePackages(
                 YoriLibFreeStringContents(&TempLocalPath);
             }
 
+            if (Err == ERROR_SUCCESS && MirrorFiles != NULL) {
+                YoriPkgAddMirroredFile(MirrorFiles, Provider, &PkgList, Package, &FullFinalName, TRUE);
+            }
+
             //
             //  Write INI entries for the package that has been found on the
             //  remote source.  Note all this can do is propagate the values
@@ -1002,27 +1489,27 @@ YoriPkgDownloadRemotePackages(
 
             if (Err == ERROR_SUCCESS) {
                 YORI_STRING TempKeyString;
-                DllKernel32.pWritePrivateProfileStringW(_T("Provides"),
-                                                        Package->PackageName.StartOfString,
-                                                        Package->Version.StartOfString,
-                                                        PackagesIni.StartOfString);
-                DllKernel32.pWritePrivateProfileStringW(Package->PackageName.StartOfString,
-                                                        _T("Version"),
-                                                        Package->Version.StartOfString,
-                                                        PackagesIni.StartOfString);
-                DllKernel32.pWritePrivateProfileStringW(Package->PackageName.StartOfString,
-                                                        Package->Architecture.StartOfString,
-                                                        FinalFileName.StartOfString,
-                                                        PackagesIni.StartOfString);
+                YoriLibIniSetString(&PkgList,
+                                    _T("Provides"),
+                                    Package->PackageName.StartOfString,
+                                    Package->Version.StartOfString);
+                YoriLibIniSetString(&PkgList,
+                                    Package->PackageName.StartOfString,
+                                    _T("Version"),
+                                    Package->Version.StartOfString);
+                YoriLibIniSetString(&PkgList,
+                                    Package->PackageName.StartOfString,
+                                    Package->Architecture.StartOfString,
+                                    FinalFileName.StartOfString);
 
                 if (Package->MinimumOSBuild.LengthInChars != 0) {
                     YoriLibInitEmptyString(&TempKeyString);
                     YoriLibYPrintf(&TempKeyString, _T("%y.minimumosbuild"), &Package->Architecture);
                     if (TempKeyString.LengthInChars > 0) {
-                        DllKernel32.pWritePrivateProfileStringW(Package->PackageName.StartOfString,
-                                                                TempKeyString.StartOfString,
-                                                                Package->MinimumOSBuild.StartOfString,
-                                                                PackagesIni.StartOfString);
+                        YoriLibIniSetString(&PkgList,
+                                            Package->PackageName.StartOfString,
+                                            TempKeyString.StartOfString,
+                                            Package->MinimumOSBuild.StartOfString);
                         YoriLibFreeStringContents(&TempKeyString);
                     }
 
@@ -1032,10 +1519,10 @@ YoriPkgDownloadRemotePackages(
                     YoriLibInitEmptyString(&TempKeyString);
                     YoriLibYPrintf(&TempKeyString, _T("%y.packagepathforolderbuilds"), &Package->Architecture);
                     if (TempKeyString.LengthInChars > 0) {
-                        DllKernel32.pWritePrivateProfileStringW(Package->PackageName.StartOfString,
-                                                                TempKeyString.StartOfString,
-                                                                Package->PackagePathForOlderBuilds.StartOfString,
-                                                                PackagesIni.StartOfString);
+                        YoriLibIniSetString(&PkgList,
+                                            Package->PackageName.StartOfString,
+                                            TempKeyString.StartOfString,
+                                            Package->PackagePathForOlderBuilds.StartOfString);
                         YoriLibFreeStringContents(&TempKeyString);
                     }
 
@@ -1055,10 +1542,26 @@ YoriPkgDownloadRemotePackages(
         PackageEntry = YoriLibGetNextListEntry(&PackageList, PackageEntry);
     }
 
+    Result = TRUE;
+    if (!YoriLibIniFlush(&PkgList)) {
+        Err = GetLastError();
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("Error saving %y: "), &PackagesIni);
+        YoriPkgDisplayErrorStringForInstallFailure(Err);
+        Result = FALSE;
+    }
+
+    if (MirrorFiles != NULL) {
+        YoriPkgFreeMirroredFiles(MirrorFiles);
+        DllAdvApi32.pCryptReleaseContext(Provider, 0);
+    }
+
+    YoriPkgFreeDownloads(&Downloads);
+    YoriPkgFreeAllSourcesAndPackages(NULL, &CurrentPackageList);
     YoriPkgFreeAllSourcesAndPackages(&SourcesList, &PackageList);
+    YoriLibIniCleanup(&PkgList);
     YoriLibFreeStringContents(&PackagesIni);
 
-    return TRUE;
+    return Result;
 }
 
 /**
@@ -1351,7 +1854,7 @@ YoriPkgInstallRemotePackages(
     YORI_LIST_ENTRY PackagesMatchingCriteria;
     PYORI_LIST_ENTRY PackageEntry;
     PYORIPKG_REMOTE_PACKAGE Package;
-    YORI_STRING IniFile;
+    YORI_LIB_INI PkgIni;
     YORI_STRING IniValue;
     YORIPKG_PACKAGES_PENDING_INSTALL PendingPackages;
     DWORD Error;
@@ -1362,14 +1865,14 @@ YoriPkgInstallRemotePackages(
         return Result;
     }
 
-    if (!YoriPkgGetPackageIniFile(NewDirectory, &IniFile)) {
+    if (!YoriPkgLoadPackageIni(NewDirectory, &PkgIni)) {
         YoriPkgDeletePendingPackages(&PendingPackages);
         return Result;
     }
 
     if (!YoriLibAllocateString(&IniValue, YORIPKG_MAX_FIELD_LENGTH)) {
         YoriPkgDeletePendingPackages(&PendingPackages);
-        YoriLibFreeStringContents(&IniFile);
+        YoriLibIniCleanup(&PkgIni);
         return Result;
     }
 
@@ -1389,17 +1892,37 @@ YoriPkgInstallRemotePackages(
                                                      &PackagesMatchingCriteria);
 
     //
-    //  Find if any of these are installed and back them up.
+    //  Download all of the packages concurrently.  If a package can't be
+    //  queued, it is downloaded when it is prepared below.  The packages
+    //  are moved to the set of known packages so that their metadata can
+    //  be used to find them in the package cache.
     //
 
-    AttemptedCount = 0;
     PackageEntry = NULL;
     PackageEntry = YoriLibGetNextListEntry(&PackagesMatchingCriteria, PackageEntry);
     while (PackageEntry != NULL) {
         Package = CONTAINING_RECORD(PackageEntry, YORIPKG_REMOTE_PACKAGE, PackageList);
         PackageEntry = YoriLibGetNextListEntry(&PackagesMatchingCriteria, PackageEntry);
+        YoriLibRemoveListItem(&Package->PackageList);
+        YoriLibAppendList(&PendingPackages.KnownPackages, &Package->PackageList);
+        YoriPkgQueueDownload(&PendingPackages.Downloads, &Package->InstallUrl);
+    }
+
+    YoriPkgResolveDownloadsFromCache(&PkgIni.FileName, &PendingPackages);
+    YoriPkgCompleteDownloads(&PendingPackages.Downloads, &PkgIni.FileName);
+
+    //
+    //  Find if any of these are installed and back them up.
+    //
 
-        Error = YoriPkgPreparePackageForInstallRedirectBuild(&IniFile, NewDirectory, &PendingPackages, &Package->InstallUrl);
+    AttemptedCount = 0;
+    PackageEntry = NULL;
+    PackageEntry = YoriLibGetNextListEntry(&PendingPackages.KnownPackages, PackageEntry);
+    while (PackageEntry != NULL) {
+        Package = CONTAINING_RECORD(PackageEntry, YORIPKG_REMOTE_PACKAGE, PackageList);
+        PackageEntry = YoriLibGetNextListEntry(&PendingPackages.KnownPackages, PackageEntry);
+
+        Error = YoriPkgPreparePackageForInstallRedirectBuild(&PkgIni, NewDirectory, &PendingPackages, &Package->InstallUrl);
         if (Error != ERROR_SUCCESS && Error != ERROR_OLD_WIN_VERSION) {
             YoriPkgDisplayErrorStringForInstallFailure(Error);
             goto Exit;
@@ -1408,7 +1931,7 @@ YoriPkgInstallRemotePackages(
         AttemptedCount++;
     }
 
-    if (YoriPkgInstallPendingPackages(&IniFile, NewDirectory, &PendingPackages)) {
+    if (YoriPkgInstallPendingPackages(&PkgIni, NewDirectory, &PendingPackages)) {
         if (MatchingPackageCount == PackageNameCount) {
             Result = TRUE;
         }
@@ -1423,13 +1946,13 @@ Exit:
     //
 
     if (!YoriLibIsListEmpty(&PendingPackages.BackupPackages)) {
-        YoriPkgRollbackAndFreeBackupPackageList(&IniFile, NewDirectory, &PendingPackages.BackupPackages);
+        YoriPkgRollbackAndFreeBackupPackageList(&PkgIni, NewDirectory, &PendingPackages.BackupPackages);
     }
 
     YoriPkgDeletePendingPackages(&PendingPackages);
 
     YoriPkgFreeAllSourcesAndPackages(NULL, &PackagesMatchingCriteria);
-    YoriLibFreeStringContents(&IniFile);
+    YoriLibIniCleanup(&PkgIni);
     YoriLibFreeStringContents(&IniValue);
 
     return Result;
@@ -1620,6 +2143,53 @@ YoriPkgIsNewerVersionAvailableFromCache(
 }
 
 
+/**
+ Consult with an in memory cache to see if a delta package is available which
+ can upgrade a specific installed version to a package.
+
+ @param PendingPackages The set of packages being operated on.  This contains
+        a cache of URLs that are known.
+
+ @param PackageUrl Points to the URL of the complete package to install.
+
+ @param ExistingVersion Points to the currently installed version.
+
+ @param DeltaUrl On successful completion, updated to contain a referenced
+        string to the URL of a delta package which can be used instead of
+        PackageUrl.
+
+ @return TRUE to indicate a delta package was found, FALSE if it was not.
+ */
+__success(return)
+BOOL
+YoriPkgFindDeltaPackage(
+    __in PYORIPKG_PACKAGES_PENDING_INSTALL PendingPackages,
+    __in PYORI_STRING PackageUrl,
+    __in PYORI_STRING ExistingVersion,
+    __out PYORI_STRING DeltaUrl
+    )
+{
+    PYORI_LIST_ENTRY ListEntry = NULL;
+    PYORIPKG_REMOTE_PACKAGE KnownPackage;
+
+    ListEntry = YoriLibGetNextListEntry(&PendingPackages->KnownPackages, ListEntry);
+    while (ListEntry != NULL) {
+        KnownPackage = CONTAINING_RECORD(ListEntry, YORIPKG_REMOTE_PACKAGE, PackageList);
+        ListEntry = YoriLibGetNextListEntry(&PendingPackages->KnownPackages, ListEntry);
+        if (YoriLibCompareString(PackageUrl, &KnownPackage->InstallUrl) == 0) {
+            if (KnownPackage->DeltaUrl.LengthInChars > 0 &&
+                YoriLibCompareString(ExistingVersion, &KnownPackage->DeltaFromVersion) == 0) {
+
+                YoriLibCloneString(DeltaUrl, &KnownPackage->DeltaUrl);
+                return TRUE;
+            }
+            break;
+        }
+    }
+
+    return FALSE;
+}
+
 /**
  Consult with pkglist.ini in a Url's parent directory to see if a newer
  version is available.  Note that there is no guarantee that pkglist.ini
@@ -1646,9 +2216,10 @@ YoriPkgIsNewerVersionAvailableFromCache(
 
  @param RedirectToPackageUrl Points to a string to update with a referenced
         pointer to a package Url to install.  This can be different from the
-        input Url due to mirroring or because that Url is incompatible with
+        input Url due to mirroring, because that Url is incompatible with
         the running version of Windows and an older package should be
-        installed instead.  Note this value is only useful if the function
+        installed instead, or because a delta package is available which
+        upgrades the existing version.  Note this value is only useful if the function
         indicates a newer package is available; if the currently installed
         package is the current package, there's no point redirecting anywhere.
 
@@ -1674,6 +2245,7 @@ YoriPkgIsNewerVersionAvailable(
     YORI_STRING MirroredPath;
     YORI_STRING RedirectedUrl;
     YORI_STRING PreviousRedirectedUrl;
+    YORI_STRING DeltaUrl;
     PYORI_STRING UrlToCheck;
     PYORIPKG_REMOTE_SOURCE RemoteSource;
     BOOLEAN NewerVersionAvailable;
@@ -1763,6 +2335,18 @@ YoriPkgIsNewerVersionAvailable(
         break;
     }
 
+    //
+    //  If the source provides a delta package from the installed version,
+    //  download that instead of the complete package.
+    //
+
+    if (NewerVersionAvailable &&
+        YoriPkgFindDeltaPackage(PendingPackages, &MirroredPath, ExistingVersion, &DeltaUrl)) {
+
+        YoriLibFreeStringContents(&MirroredPath);
+        memcpy(&MirroredPath, &DeltaUrl, sizeof(YORI_STRING));
+    }
+
     memcpy(RedirectToPackageUrl, &MirroredPath, sizeof(YORI_STRING));
 
     if (!NewerVersionAvailable) {
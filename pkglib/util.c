@@ -141,6 +141,67 @@ YoriPkgGetPackageIniFile(
     return TRUE;
 }
 
+/**
+ Load the system global package INI file into memory.  Changes made to the
+ INI file are written back with @ref YoriPkgFlushPackageIni , and the caller
+ should free it with YoriLibIniCleanup.
+
+ @param InstallDirectory Optionally points to an install directory.  If not
+        specified, the directory of the currently running application is
+        used.
+
+ @param PkgIni On successful completion, populated with the contents of the
+        package INI file.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriPkgLoadPackageIni(
+    __in_opt PCYORI_STRING InstallDirectory,
+    __out PYORI_LIB_INI PkgIni
+    )
+{
+    YORI_STRING IniFileName;
+    BOOL Result;
+
+    YoriLibIniInitialize(PkgIni);
+
+    if (!YoriPkgGetPackageIniFile(InstallDirectory, &IniFileName)) {
+        return FALSE;
+    }
+
+    Result = YoriLibIniLoad(PkgIni, &IniFileName);
+    YoriLibFreeStringContents(&IniFileName);
+    return Result;
+}
+
+/**
+ Write any changes to the system global package INI file back to disk.  If
+ this fails, an error is displayed to the user.
+
+ @param PkgIni Pointer to the package INI file.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriPkgFlushPackageIni(
+    __in PYORI_LIB_INI PkgIni
+    )
+{
+    DWORD Err;
+
+    if (YoriLibIniFlush(PkgIni)) {
+        return TRUE;
+    }
+
+    Err = GetLastError();
+    YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Could not update %y: "), &PkgIni->FileName);
+    YoriPkgDisplayErrorStringForInstallFailure(Err);
+    return FALSE;
+}
+
 /**
  Given a fully qualified path to a package's INI file, extract package
  information.
@@ -198,13 +259,15 @@ YoriPkgGetPackageInfo(
     )
 {
     YORI_STRING TempBuffer;
+    YORI_LIB_INI PkgInfo;
     YORI_ALLOC_SIZE_T MaxFieldSize = YORIPKG_MAX_FIELD_LENGTH;
 
-    if (DllKernel32.pGetPrivateProfileStringW == NULL) {
+    if (!YoriLibIniLoad(&PkgInfo, IniPath)) {
         return FALSE;
     }
 
     if (!YoriLibAllocateString(&TempBuffer, 10 * MaxFieldSize)) {
+        YoriLibIniCleanup(&PkgInfo);
         return FALSE;
     }
 
@@ -212,130 +275,131 @@ YoriPkgGetPackageInfo(
     PackageName->LengthAllocated = MaxFieldSize;
 
     PackageName->LengthInChars = (YORI_ALLOC_SIZE_T)
-        DllKernel32.pGetPrivateProfileStringW(_T("Package"),
-                                              _T("Name"),
-                                              _T(""),
-                                              PackageName->StartOfString,
-                                              PackageName->LengthAllocated,
-                                              IniPath->StartOfString);
+        YoriLibIniGetString(&PkgInfo,
+                            _T("Package"),
+                            _T("Name"),
+                            _T(""),
+                            PackageName->StartOfString,
+                            PackageName->LengthAllocated);
 
     YoriLibCloneString(PackageVersion, &TempBuffer);
     PackageVersion->StartOfString += 1 * MaxFieldSize;
     PackageVersion->LengthAllocated = MaxFieldSize;
 
     PackageVersion->LengthInChars = (YORI_ALLOC_SIZE_T)
-        DllKernel32.pGetPrivateProfileStringW(_T("Package"),
-                                              _T("Version"),
-                                              _T(""),
-                                              PackageVersion->StartOfString,
-                                              PackageVersion->LengthAllocated,
-                                              IniPath->StartOfString);
+        YoriLibIniGetString(&PkgInfo,
+                            _T("Package"),
+                            _T("Version"),
+                            _T(""),
+                            PackageVersion->StartOfString,
+                            PackageVersion->LengthAllocated);
 
     YoriLibCloneString(PackageArch, &TempBuffer);
     PackageArch->StartOfString += 2 * MaxFieldSize;
     PackageArch->LengthAllocated = MaxFieldSize;
 
     PackageArch->LengthInChars = (YORI_ALLOC_SIZE_T)
-        DllKernel32.pGetPrivateProfileStringW(_T("Package"),
-                                              _T("Architecture"),
-                                              _T(""),
-                                              PackageArch->StartOfString,
-                                              PackageArch->LengthAllocated,
-                                              IniPath->StartOfString);
+        YoriLibIniGetString(&PkgInfo,
+                            _T("Package"),
+                            _T("Architecture"),
+                            _T(""),
+                            PackageArch->StartOfString,
+                            PackageArch->LengthAllocated);
 
     YoriLibCloneString(MinimumOSBuild, &TempBuffer);
     MinimumOSBuild->StartOfString += 3 * MaxFieldSize;
     MinimumOSBuild->LengthAllocated = MaxFieldSize;
 
     MinimumOSBuild->LengthInChars = (YORI_ALLOC_SIZE_T)
-        DllKernel32.pGetPrivateProfileStringW(_T("Package"),
-                                              _T("MinimumOSBuild"),
-                                              _T(""),
-                                              MinimumOSBuild->StartOfString,
-                                              MinimumOSBuild->LengthAllocated,
-                                              IniPath->StartOfString);
+        YoriLibIniGetString(&PkgInfo,
+                            _T("Package"),
+                            _T("MinimumOSBuild"),
+                            _T(""),
+                            MinimumOSBuild->StartOfString,
+                            MinimumOSBuild->LengthAllocated);
 
     YoriLibCloneString(PackagePathForOlderBuilds, &TempBuffer);
     PackagePathForOlderBuilds->StartOfString += 4 * MaxFieldSize;
     PackagePathForOlderBuilds->LengthAllocated = MaxFieldSize;
 
     PackagePathForOlderBuilds->LengthInChars = (YORI_ALLOC_SIZE_T)
-        DllKernel32.pGetPrivateProfileStringW(_T("Package"),
-                                              _T("PackagePathForOlderBuilds"),
-                                              _T(""),
-                                              PackagePathForOlderBuilds->StartOfString,
-                                              PackagePathForOlderBuilds->LengthAllocated,
-                                              IniPath->StartOfString);
+        YoriLibIniGetString(&PkgInfo,
+                            _T("Package"),
+                            _T("PackagePathForOlderBuilds"),
+                            _T(""),
+                            PackagePathForOlderBuilds->StartOfString,
+                            PackagePathForOlderBuilds->LengthAllocated);
 
     YoriLibCloneString(UpgradePath, &TempBuffer);
     UpgradePath->StartOfString += 5 * MaxFieldSize;
     UpgradePath->LengthAllocated = MaxFieldSize;
 
     UpgradePath->LengthInChars = (YORI_ALLOC_SIZE_T)
-        DllKernel32.pGetPrivateProfileStringW(_T("Package"),
-                                              _T("UpgradePath"),
-                                              _T(""),
-                                              UpgradePath->StartOfString,
-                                              UpgradePath->LengthAllocated,
-                                              IniPath->StartOfString);
+        YoriLibIniGetString(&PkgInfo,
+                            _T("Package"),
+                            _T("UpgradePath"),
+                            _T(""),
+                            UpgradePath->StartOfString,
+                            UpgradePath->LengthAllocated);
 
     YoriLibCloneString(SourcePath, &TempBuffer);
     SourcePath->StartOfString += 6 * MaxFieldSize;
     SourcePath->LengthAllocated = MaxFieldSize;
 
     SourcePath->LengthInChars = (YORI_ALLOC_SIZE_T)
-        DllKernel32.pGetPrivateProfileStringW(_T("Package"),
-                                              _T("SourcePath"),
-                                              _T(""),
-                                              SourcePath->StartOfString,
-                                              SourcePath->LengthAllocated,
-                                              IniPath->StartOfString);
+        YoriLibIniGetString(&PkgInfo,
+                            _T("Package"),
+                            _T("SourcePath"),
+                            _T(""),
+                            SourcePath->StartOfString,
+                            SourcePath->LengthAllocated);
 
     YoriLibCloneString(SymbolPath, &TempBuffer);
     SymbolPath->StartOfString += 7 * MaxFieldSize;
     SymbolPath->LengthAllocated = MaxFieldSize;
 
     SymbolPath->LengthInChars = (YORI_ALLOC_SIZE_T)
-        DllKernel32.pGetPrivateProfileStringW(_T("Package"),
-                                              _T("SymbolPath"),
-                                              _T(""),
-                                              SymbolPath->StartOfString,
-                                              SymbolPath->LengthAllocated,
-                                              IniPath->StartOfString);
+        YoriLibIniGetString(&PkgInfo,
+                            _T("Package"),
+                            _T("SymbolPath"),
+                            _T(""),
+                            SymbolPath->StartOfString,
+                            SymbolPath->LengthAllocated);
 
     YoriLibCloneString(UpgradeToDailyPath, &TempBuffer);
     UpgradeToDailyPath->StartOfString += 8 * MaxFieldSize;
     UpgradeToDailyPath->LengthAllocated = MaxFieldSize;
 
     UpgradeToDailyPath->LengthInChars = (YORI_ALLOC_SIZE_T)
-        DllKernel32.pGetPrivateProfileStringW(_T("Package"),
-                                              _T("UpgradeToDailyPath"),
-                                              _T(""),
-                                              UpgradeToDailyPath->StartOfString,
-                                              UpgradeToDailyPath->LengthAllocated,
-                                              IniPath->StartOfString);
+        YoriLibIniGetString(&PkgInfo,
+                            _T("Package"),
+                            _T("UpgradeToDailyPath"),
+                            _T(""),
+                            UpgradeToDailyPath->StartOfString,
+                            UpgradeToDailyPath->LengthAllocated);
 
     YoriLibCloneString(UpgradeToStablePath, &TempBuffer);
     UpgradeToStablePath->StartOfString += 9 * MaxFieldSize;
     UpgradeToStablePath->LengthAllocated = MaxFieldSize;
 
     UpgradeToStablePath->LengthInChars = (YORI_ALLOC_SIZE_T)
-        DllKernel32.pGetPrivateProfileStringW(_T("Package"),
-                                              _T("UpgradeToStablePath"),
-                                              _T(""),
-                                              UpgradeToStablePath->StartOfString,
-                                              UpgradeToStablePath->LengthAllocated,
-                                              IniPath->StartOfString);
+        YoriLibIniGetString(&PkgInfo,
+                            _T("Package"),
+                            _T("UpgradeToStablePath"),
+                            _T(""),
+                            UpgradeToStablePath->StartOfString,
+                            UpgradeToStablePath->LengthAllocated);
 
     YoriLibFreeStringContents(&TempBuffer);
+    YoriLibIniCleanup(&PkgInfo);
     return TRUE;
 }
 
 /**
- Given a fully qualified path to the system package INI file and a package
- name, extract fixed sized information.
+ Given the system package INI file and a package name, extract fixed sized
+ information.
 
- @param IniPath Pointer to a path to the system's INI file.
+ @param PkgIni Pointer to the system's INI file.
 
  @param PackageName Pointer to the package's canonical name.
 
@@ -365,7 +429,7 @@ YoriPkgGetPackageInfo(
 __success(return)
 BOOL
 YoriPkgGetInstalledPackageInfo(
-    __in PYORI_STRING IniPath,
+    __in PYORI_LIB_INI PkgIni,
     __in PYORI_STRING PackageName,
     __out PYORI_STRING PackageVersion,
     __out PYORI_STRING PackageArch,
@@ -379,13 +443,8 @@ YoriPkgGetInstalledPackageInfo(
     YORI_STRING TempBuffer;
     YORI_ALLOC_SIZE_T MaxFieldSize = YORIPKG_MAX_FIELD_LENGTH;
 
-    ASSERT(YoriLibIsStringNullTerminated(IniPath));
     ASSERT(YoriLibIsStringNullTerminated(PackageName));
 
-    if (DllKernel32.pGetPrivateProfileStringW == NULL) {
-        return FALSE;
-    }
-
     if (!YoriLibAllocateString(&TempBuffer, 7 * MaxFieldSize)) {
         return FALSE;
     }
@@ -394,84 +453,84 @@ YoriPkgGetInstalledPackageInfo(
     PackageVersion->LengthAllocated = MaxFieldSize;
 
     PackageVersion->LengthInChars = (YORI_ALLOC_SIZE_T)
-        DllKernel32.pGetPrivateProfileStringW(PackageName->StartOfString,
-                                              _T("Version"),
-                                              _T(""),
-                                              PackageVersion->StartOfString,
-                                              PackageVersion->LengthAllocated,
-                                              IniPath->StartOfString);
+        YoriLibIniGetString(PkgIni,
+                            PackageName->StartOfString,
+                            _T("Version"),
+                            _T(""),
+                            PackageVersion->StartOfString,
+                            PackageVersion->LengthAllocated);
 
     YoriLibCloneString(PackageArch, &TempBuffer);
     PackageArch->StartOfString += 1 * MaxFieldSize;
     PackageArch->LengthAllocated = MaxFieldSize;
 
     PackageArch->LengthInChars = (YORI_ALLOC_SIZE_T)
-        DllKernel32.pGetPrivateProfileStringW(PackageName->StartOfString,
-                                              _T("Architecture"),
-                                              _T(""),
-                                              PackageArch->StartOfString,
-                                              PackageArch->LengthAllocated,
-                                              IniPath->StartOfString);
+        YoriLibIniGetString(PkgIni,
+                            PackageName->StartOfString,
+                            _T("Architecture"),
+                            _T(""),
+                            PackageArch->StartOfString,
+                            PackageArch->LengthAllocated);
 
     YoriLibCloneString(UpgradePath, &TempBuffer);
     UpgradePath->StartOfString += 2 * MaxFieldSize;
     UpgradePath->LengthAllocated = MaxFieldSize;
 
     UpgradePath->LengthInChars = (YORI_ALLOC_SIZE_T)
-        DllKernel32.pGetPrivateProfileStringW(PackageName->StartOfString,
-                                              _T("UpgradePath"),
-                                              _T(""),
-                                              UpgradePath->StartOfString,
-                                              UpgradePath->LengthAllocated,
-                                              IniPath->StartOfString);
+        YoriLibIniGetString(PkgIni,
+                            PackageName->StartOfString,
+                            _T("UpgradePath"),
+                            _T(""),
+                            UpgradePath->StartOfString,
+                            UpgradePath->LengthAllocated);
 
     YoriLibCloneString(SourcePath, &TempBuffer);
     SourcePath->StartOfString += 3 * MaxFieldSize;
     SourcePath->LengthAllocated = MaxFieldSize;
 
     SourcePath->LengthInChars = (YORI_ALLOC_SIZE_T)
-        DllKernel32.pGetPrivateProfileStringW(PackageName->StartOfString,
-                                              _T("SourcePath"),
-                                              _T(""),
-                                              SourcePath->StartOfString,
-                                              SourcePath->LengthAllocated,
-                                              IniPath->StartOfString);
+        YoriLibIniGetString(PkgIni,
+                            PackageName->StartOfString,
+                            _T("SourcePath"),
+                            _T(""),
+                            SourcePath->StartOfString,
+                            SourcePath->LengthAllocated);
 
     YoriLibCloneString(SymbolPath, &TempBuffer);
     SymbolPath->StartOfString += 4 * MaxFieldSize;
     SymbolPath->LengthAllocated = MaxFieldSize;
 
     SymbolPath->LengthInChars = (YORI_ALLOC_SIZE_T)
-        DllKernel32.pGetPrivateProfileStringW(PackageName->StartOfString,
-                                              _T("SymbolPath"),
-                                              _T(""),
-                                              SymbolPath->StartOfString,
-                                              SymbolPath->LengthAllocated,
-                                              IniPath->StartOfString);
+        YoriLibIniGetString(PkgIni,
+                            PackageName->StartOfString,
+                            _T("SymbolPath"),
+                            _T(""),
+                            SymbolPath->StartOfString,
+                            SymbolPath->LengthAllocated);
 
     YoriLibCloneString(UpgradeToDailyPath, &TempBuffer);
     UpgradeToDailyPath->StartOfString += 5 * MaxFieldSize;
     UpgradeToDailyPath->LengthAllocated = MaxFieldSize;
 
     UpgradeToDailyPath->LengthInChars = (YORI_ALLOC_SIZE_T)
-        DllKernel32.pGetPrivateProfileStringW(PackageName->StartOfString,
-                                              _T("UpgradeToDailyPath"),
-                                              _T(""),
-                                              UpgradeToDailyPath->StartOfString,
-                                              UpgradeToDailyPath->LengthAllocated,
-                                              IniPath->StartOfString);
+        YoriLibIniGetString(PkgIni,
+                            PackageName->StartOfString,
+                            _T("UpgradeToDailyPath"),
+                            _T(""),
+                            UpgradeToDailyPath->StartOfString,
+                            UpgradeToDailyPath->LengthAllocated);
 
     YoriLibCloneString(UpgradeToStablePath, &TempBuffer);
     UpgradeToStablePath->StartOfString += 5 * MaxFieldSize;
     UpgradeToStablePath->LengthAllocated = MaxFieldSize;
 
     UpgradeToStablePath->LengthInChars = (YORI_ALLOC_SIZE_T)
-        DllKernel32.pGetPrivateProfileStringW(PackageName->StartOfString,
-                                              _T("UpgradeToStablePath"),
-                                              _T(""),
-                                              UpgradeToStablePath->StartOfString,
-                                              UpgradeToStablePath->LengthAllocated,
-                                              IniPath->StartOfString);
+        YoriLibIniGetString(PkgIni,
+                            PackageName->StartOfString,
+                            _T("UpgradeToStablePath"),
+                            _T(""),
+                            UpgradeToStablePath->StartOfString,
+                            UpgradeToStablePath->LengthAllocated);
 
     YoriLibFreeStringContents(&TempBuffer);
     return TRUE;
@@ -1065,6 +1124,10 @@ Exit:
  Download a remote package into a temporary location and return the
  temporary location to allow for subsequent processing.
 
+ @param Session Optionally points to a session returned from
+        @ref YoriLibUpdateOpenSession to perform any download within.  If not
+        specified, a new session is used for the download.
+
  @param PackagePath Pointer to a string referring to the package which can
         be local or remote.
 
@@ -1083,7 +1146,8 @@ Exit:
  */
 __success(return == ERROR_SUCCESS)
 DWORD
-YoriPkgPackagePathToLocalPath(
+YoriPkgPackagePathToLocalPathWithSession(
+    __in_opt PVOID Session,
     __in PYORI_STRING PackagePath,
     __in_opt PCYORI_STRING IniFilePath,
     __out PYORI_STRING LocalPath,
@@ -1161,7 +1225,11 @@ YoriPkgPackagePathToLocalPath(
             goto Exit;
         }
 
-        Error = YoriLibUpdateBinaryFromUrl(&MirroredPath, &TempFileName, &UserAgent, NULL);
+        if (Session != NULL) {
+            Error = YoriLibUpdateBinaryFromUrlWithSession(Session, &MirroredPath, &TempFileName, NULL);
+        } else {
+            Error = YoriLibUpdateBinaryFromUrl(&MirroredPath, &TempFileName, &UserAgent, NULL);
+        }
 
         if (Error != YoriLibUpdErrorSuccess) {
             switch(Error) {
@@ -1203,6 +1271,200 @@ Exit:
     return Result;
 }
 
+/**
+ Download a remote package into a temporary location and return the
+ temporary location to allow for subsequent processing.
+
+ @param PackagePath Pointer to a string referring to the package which can
+        be local or remote.
+
+ @param IniFilePath Pointer to a string containing a path to the package INI
+        file.
+
+ @param LocalPath On successful completion, populated with a string containing
+        a fully qualified local path to the package.
+
+ @param DeleteWhenFinished On successful completion, set to TRUE to indicate
+        the caller should delete the file (it is temporary); set to FALSE to
+        indicate the file should be retained.
+
+ @return ERROR_SUCCESS to indicate success, or other Win32 error to indicate
+         the type of failure.
+ */
+__success(return == ERROR_SUCCESS)
+DWORD
+YoriPkgPackagePathToLocalPath(
+    __in PYORI_STRING PackagePath,
+    __in_opt PCYORI_STRING IniFilePath,
+    __out PYORI_STRING LocalPath,
+    __out PBOOLEAN DeleteWhenFinished
+    )
+{
+    return YoriPkgPackagePathToLocalPathWithSession(NULL, PackagePath, IniFilePath, LocalPath, DeleteWhenFinished);
+}
+
+/**
+ Query or update the last write time of a retained package index.
+
+ @param FilePath Pointer to the path of the package index.
+
+ @param SetTime If TRUE, the last write time is updated from WriteTime.  If
+        FALSE, WriteTime is populated with the last write time of the file.
+
+ @param WriteTime Points to the last write time.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriPkgAccessIndexWriteTime(
+    __in PCYORI_STRING FilePath,
+    __in BOOLEAN SetTime,
+    __inout PFILETIME WriteTime
+    )
+{
+    HANDLE FileHandle;
+    BOOL Result;
+
+    FileHandle = CreateFile(FilePath->StartOfString,
+                            SetTime?FILE_WRITE_ATTRIBUTES:FILE_READ_ATTRIBUTES,
+                            FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                            NULL,
+                            OPEN_EXISTING,
+                            FILE_ATTRIBUTE_NORMAL,
+                            NULL);
+
+    if (FileHandle == INVALID_HANDLE_VALUE) {
+        return FALSE;
+    }
+
+    if (SetTime) {
+        Result = SetFileTime(FileHandle, NULL, NULL, WriteTime);
+    } else {
+        Result = GetFileTime(FileHandle, NULL, NULL, WriteTime);
+    }
+
+    CloseHandle(FileHandle);
+    return Result;
+}
+
+/**
+ Obtain a local copy of a package index (pkglist.ini) from a source.  Remote
+ indexes are retained in a pkgindex directory alongside packages.ini, and
+ are only downloaded again if the server indicates they have changed since
+ the retained copy was obtained.  If the server cannot be reached, the
+ retained copy is used.  Local indexes, and remote indexes which cannot be
+ retained, are handled by @ref YoriPkgPackagePathToLocalPath .
+
+ @param IndexPath Pointer to a string referring to the package index, which
+        can be local or remote.
+
+ @param IniFilePath Pointer to a string containing a path to the package INI
+        file.
+
+ @param LocalPath On successful completion, populated with a string containing
+        a fully qualified local path to the package index.
+
+ @param DeleteWhenFinished On successful completion, set to TRUE to indicate
+        the caller should delete the file (it is temporary); set to FALSE to
+        indicate the file should be retained.
+
+ @return ERROR_SUCCESS to indicate success, or other Win32 error to indicate
+         the type of failure.
+ */
+__success(return == ERROR_SUCCESS)
+DWORD
+YoriPkgPackageIndexToLocalPath(
+    __in PYORI_STRING IndexPath,
+    __in PCYORI_STRING IniFilePath,
+    __out PYORI_STRING LocalPath,
+    __out PBOOLEAN DeleteWhenFinished
+    )
+{
+    YORI_STRING MirroredPath;
+    YORI_STRING IndexDirectory;
+    YORI_STRING CachedPath;
+    YORI_STRING UserAgent;
+    FILETIME PreviousWriteTime;
+    FILETIME RequestTime;
+    SYSTEMTIME IfModifiedSince;
+    BOOLEAN CachedCopyExists;
+    YORI_LIB_UPDATE_ERROR Error;
+    LPTSTR FinalSeparator;
+
+    YoriLibInitEmptyString(&MirroredPath);
+    if (!YoriPkgConvertUserPackagePathToMirroredPath(IndexPath, IniFilePath, &MirroredPath)) {
+        YoriLibCloneString(&MirroredPath, IndexPath);
+    }
+
+    FinalSeparator = YoriLibFindRightMostCharacter(IniFilePath, '\\');
+    if (!YoriLibIsPathUrl(&MirroredPath) || FinalSeparator == NULL) {
+        YoriLibFreeStringContents(&MirroredPath);
+        return YoriPkgPackagePathToLocalPath(IndexPath, IniFilePath, LocalPath, DeleteWhenFinished);
+    }
+
+    //
+    //  The retained copy is named from a hash of its Url.  Two hashes with
+    //  different seeds are used to make collisions implausible.
+    //
+
+    YoriLibInitEmptyString(&IndexDirectory);
+    IndexDirectory.StartOfString = IniFilePath->StartOfString;
+    IndexDirectory.LengthInChars = (YORI_ALLOC_SIZE_T)(FinalSeparator - IniFilePath->StartOfString);
+
+    if (!YoriLibAllocateString(&CachedPath, IndexDirectory.LengthInChars + sizeof("\\pkgindex\\0123456789abcdef.ini"))) {
+        YoriLibFreeStringContents(&MirroredPath);
+        return ERROR_NOT_ENOUGH_MEMORY;
+    }
+
+    CachedPath.LengthInChars = YoriLibSPrintf(CachedPath.StartOfString, _T("%y\\pkgindex"), &IndexDirectory);
+    CreateDirectory(CachedPath.StartOfString, NULL);
+
+    CachedPath.LengthInChars = YoriLibSPrintf(CachedPath.StartOfString,
+                                              _T("%y\\pkgindex\\%08x%08x.ini"),
+                                              &IndexDirectory,
+                                              YoriLibHashString32(0, &MirroredPath),
+                                              YoriLibHashString32(0x5bd1e995, &MirroredPath));
+
+    CachedCopyExists = FALSE;
+    if (YoriPkgAccessIndexWriteTime(&CachedPath, FALSE, &PreviousWriteTime) &&
+        FileTimeToSystemTime(&PreviousWriteTime, &IfModifiedSince)) {
+
+        CachedCopyExists = TRUE;
+    }
+
+    YoriLibInitEmptyString(&UserAgent);
+    YoriLibYPrintf(&UserAgent, _T("ypm %i.%02i\r\n"), YORI_VER_MAJOR, YORI_VER_MINOR);
+    if (UserAgent.StartOfString == NULL) {
+        YoriLibFreeStringContents(&CachedPath);
+        YoriLibFreeStringContents(&MirroredPath);
+        return ERROR_NOT_ENOUGH_MEMORY;
+    }
+
+    GetSystemTimeAsFileTime(&RequestTime);
+    Error = YoriLibUpdateBinaryFromUrl(&MirroredPath, &CachedPath, &UserAgent, CachedCopyExists?&IfModifiedSince:NULL);
+    YoriLibFreeStringContents(&UserAgent);
+    YoriLibFreeStringContents(&MirroredPath);
+
+    //
+    //  The retained copy is known to be current as of the time the request
+    //  was made, whether or not it was downloaded again.  Using the time the
+    //  request was made ensures any change on the server while downloading
+    //  is found next time.
+    //
+
+    if (Error == YoriLibUpdErrorSuccess) {
+        YoriPkgAccessIndexWriteTime(&CachedPath, TRUE, &RequestTime);
+    } else if (!CachedCopyExists) {
+        YoriLibFreeStringContents(&CachedPath);
+        return YoriPkgPackagePathToLocalPath(IndexPath, IniFilePath, LocalPath, DeleteWhenFinished);
+    }
+
+    memcpy(LocalPath, &CachedPath, sizeof(YORI_STRING));
+    *DeleteWhenFinished = FALSE;
+    return ERROR_SUCCESS;
+}
+
 /**
  Display the best available error text given an installation failure with the
  specified Win32 error code.
@@ -1242,6 +1504,9 @@ YoriPkgDisplayErrorStringForInstallFailure(
                 YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Not running as Administrator and could not write to files.  Perhaps elevation is required?\n"));
             }
             break;
+        case ERROR_REVISION_MISMATCH:
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("The installed files do not match the version the update was built from.\n"));
+            break;
 
         default:
             ErrText = YoriLibGetWinErrorText(ErrorCode);
@@ -1251,4 +1516,263 @@ YoriPkgDisplayErrorStringForInstallFailure(
     }
 }
 
+/**
+ Acquire a crypto provider which can be used to generate SHA1 digests of
+ files.
+
+ @param Provider On successful completion, populated with a handle to the
+        crypto provider.  The caller should release this with
+        DllAdvApi32.pCryptReleaseContext.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriPkgAcquireHashProvider(
+    __out HCRYPTPROV * Provider
+    )
+{
+    //
+    //  SHA1 is implemented by the base provider, so this is available on
+    //  every system with CryptoAPI.  NT 4 RTM doesn't support
+    //  CRYPT_VERIFYCONTEXT and may need a keyset to be created.
+    //
+
+    YoriLibLoadAdvApi32Functions();
+    if (DllAdvApi32.pCryptAcquireContextW == NULL ||
+        DllAdvApi32.pCryptCreateHash == NULL ||
+        DllAdvApi32.pCryptDestroyHash == NULL ||
+        DllAdvApi32.pCryptGetHashParam == NULL ||
+        DllAdvApi32.pCryptHashData == NULL ||
+        DllAdvApi32.pCryptReleaseContext == NULL) {
+
+        return FALSE;
+    }
+
+    if (!DllAdvApi32.pCryptAcquireContextW(Provider, NULL, MS_DEF_PROV, PROV_RSA_FULL, CRYPT_VERIFYCONTEXT) &&
+        !DllAdvApi32.pCryptAcquireContextW(Provider, NULL, MS_DEF_PROV, PROV_RSA_FULL, 0) &&
+        (GetLastError() != (DWORD)NTE_BAD_KEYSET ||
+         !DllAdvApi32.pCryptAcquireContextW(Provider, NULL, MS_DEF_PROV, PROV_RSA_FULL, CRYPT_NEWKEYSET))) {
+
+        *Provider = 0;
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ Generate a SHA1 digest of the contents of a file, expressed as a hex string.
+
+ @param Provider A crypto provider returned from
+        @ref YoriPkgAcquireHashProvider .
+
+ @param FilePath Pointer to the path of the file.
+
+ @param HashString On input, points to an allocated string which is large
+        enough to contain two characters per byte of the digest plus a NULL.
+        On successful completion, updated to contain the digest.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriPkgHashFile(
+    __in HCRYPTPROV Provider,
+    __in PCYORI_STRING FilePath,
+    __inout PYORI_STRING HashString
+    )
+{
+    HANDLE FileHandle;
+    HCRYPTHASH hHash;
+    PUCHAR ReadBuffer;
+    UCHAR Digest[YORIPKG_HASH_SIZE];
+    DWORD BytesRead;
+    DWORD HashLength;
+    BOOL Result;
+
+    FileHandle = CreateFile(FilePath->StartOfString,
+                            GENERIC_READ,
+                            FILE_SHARE_READ | FILE_SHARE_DELETE,
+                            NULL,
+                            OPEN_EXISTING,
+                            FILE_FLAG_SEQUENTIAL_SCAN,
+                            NULL);
+
+    if (FileHandle == INVALID_HANDLE_VALUE) {
+        return FALSE;
+    }
+
+    ReadBuffer = YoriLibMalloc(YORIPKG_HASH_READ_BUFFER_SIZE);
+    if (ReadBuffer == NULL) {
+        CloseHandle(FileHandle);
+        return FALSE;
+    }
+
+    if (!DllAdvApi32.pCryptCreateHash(Provider, CALG_SHA1, 0, 0, &hHash)) {
+        YoriLibFree(ReadBuffer);
+        CloseHandle(FileHandle);
+        return FALSE;
+    }
+
+    Result = TRUE;
+    while (TRUE) {
+        if (!ReadFile(FileHandle, ReadBuffer, YORIPKG_HASH_READ_BUFFER_SIZE, &BytesRead, NULL)) {
+            Result = FALSE;
+            break;
+        }
+
+        if (BytesRead == 0) {
+            break;
+        }
+
+        if (!DllAdvApi32.pCryptHashData(hHash, ReadBuffer, BytesRead, 0)) {
+            Result = FALSE;
+            break;
+        }
+    }
+
+    if (Result) {
+        HashLength = sizeof(Digest);
+        if (!DllAdvApi32.pCryptGetHashParam(hHash, HP_HASHVAL, Digest, &HashLength, 0) ||
+            !YoriLibHexBufferToString(Digest, sizeof(Digest), HashString)) {
+            Result = FALSE;
+        }
+    }
+
+    DllAdvApi32.pCryptDestroyHash(hHash);
+    YoriLibFree(ReadBuffer);
+    CloseHandle(FileHandle);
+
+    return Result;
+}
+
+/**
+ Create a uniquely named temporary directory.
+
+ @param ParentDirectory Optionally points to the directory to create the
+        temporary directory within.  If not specified, the system temporary
+        directory is used.
+
+ @param DirectoryName On successful completion, populated with the path to
+        the newly created directory.  The caller should delete this with
+        @ref YoriPkgDeleteTempDirectory .
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriPkgCreateTempDirectory(
+    __in_opt PCYORI_STRING ParentDirectory,
+    __out PYORI_STRING DirectoryName
+    )
+{
+    YORI_STRING TempPath;
+
+    if (ParentDirectory != NULL) {
+        if (!YoriLibCopyString(&TempPath, ParentDirectory)) {
+            return FALSE;
+        }
+    } else if (!YoriLibGetTempPath(&TempPath, 0)) {
+        return FALSE;
+    }
+
+    if (!YoriLibAllocateString(DirectoryName, TempPath.LengthInChars + MAX_PATH)) {
+        YoriLibFreeStringContents(&TempPath);
+        return FALSE;
+    }
+
+    //
+    //  Generate a unique file name, then replace the file with a directory
+    //  of the same name.
+    //
+
+    if (GetTempFileName(TempPath.StartOfString, _T("ypm"), 0, DirectoryName->StartOfString) == 0) {
+        YoriLibFreeStringContents(&TempPath);
+        YoriLibFreeStringContents(DirectoryName);
+        return FALSE;
+    }
+
+    YoriLibFreeStringContents(&TempPath);
+    DirectoryName->LengthInChars = (YORI_ALLOC_SIZE_T)_tcslen(DirectoryName->StartOfString);
+
+    DeleteFile(DirectoryName->StartOfString);
+    if (!CreateDirectory(DirectoryName->StartOfString, NULL)) {
+        YoriLibFreeStringContents(DirectoryName);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ A callback invoked for each file or directory found within a temporary
+ directory, used to delete it.
+
+ @param FilePath Pointer to the fully qualified path to the object.
+
+ @param FileInfo Information about the object.
+
+ @param Depth Indicates the recursion depth.  Ignored in this function.
+
+ @param Context Ignored in this function.
+
+ @return TRUE to continue enumerating, FALSE to abort.
+ */
+BOOL
+YoriPkgDeleteTempFileCallback(
+    __in PYORI_STRING FilePath,
+    __in_opt PWIN32_FIND_DATA FileInfo,
+    __in DWORD Depth,
+    __in PVOID Context
+    )
+{
+    UNREFERENCED_PARAMETER(Depth);
+    UNREFERENCED_PARAMETER(Context);
+
+    ASSERT(YoriLibIsStringNullTerminated(FilePath));
+
+    if (FileInfo != NULL &&
+        (FileInfo->dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0) {
+        RemoveDirectory(FilePath->StartOfString);
+    } else {
+        DeleteFile(FilePath->StartOfString);
+    }
+    return TRUE;
+}
+
+/**
+ Delete a temporary directory created with
+ @ref YoriPkgCreateTempDirectory along with all of its contents, and
+ free the string describing it.
+
+ @param DirectoryName Pointer to the path to the directory.
+ */
+VOID
+YoriPkgDeleteTempDirectory(
+    __inout PYORI_STRING DirectoryName
+    )
+{
+    YORI_STRING FileSpec;
+
+    if (DirectoryName->LengthInChars == 0) {
+        return;
+    }
+
+    YoriLibInitEmptyString(&FileSpec);
+    YoriLibYPrintf(&FileSpec, _T("%y\\*"), DirectoryName);
+    if (FileSpec.LengthInChars > 0) {
+        YoriLibForEachFile(&FileSpec,
+                           YORILIB_FILEENUM_RETURN_FILES | YORILIB_FILEENUM_RETURN_DIRECTORIES | YORILIB_FILEENUM_RECURSE_BEFORE_RETURN | YORILIB_FILEENUM_NO_LINK_TRAVERSE | YORILIB_FILEENUM_INCLUDE_DOTFILES,
+                           0,
+                           YoriPkgDeleteTempFileCallback,
+                           NULL,
+                           NULL);
+    }
+    YoriLibFreeStringContents(&FileSpec);
+
+    RemoveDirectory(DirectoryName->StartOfString);
+    YoriLibFreeStringContents(DirectoryName);
+}
+
 // vim:sw=4:ts=4:et:
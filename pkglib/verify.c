@@ -0,0 +1,743 @@
+/**
+ * @file pkglib/verify.c
+ *
+ * Yori package manager record and verify digests of installed files
+ *
+ * Copyright (c) 2018-2021 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <yoripch.h>
+#include <yorilib.h>
+#include <yoripkg.h>
+#include "yoripkgp.h"
+
+/**
+ The maximum number of threads generating digests at any one time.
+ */
+#define YORIPKG_DIGEST_THREADS (8)
+
+/**
+ The number of files that each thread generates digests for with a single
+ crypto provider before claiming more files.
+ */
+#define YORIPKG_DIGEST_BATCH_SIZE (16)
+
+/**
+ The number of characters used to record the last write time of a file.
+ */
+#define YORIPKG_DIGEST_TIMESTAMP_LENGTH (16)
+
+/**
+ The number of characters in a recorded digest.  This consists of the last
+ write time of the file, a comma, and the hex encoded SHA1 of its contents.
+ */
+#define YORIPKG_DIGEST_LENGTH (YORIPKG_DIGEST_TIMESTAMP_LENGTH + 1 + YORIPKG_HASH_SIZE * 2)
+
+/**
+ A single installed file whose digest is being generated.
+ */
+typedef struct _YORIPKG_DIGEST_FILE {
+
+    /**
+     The name of the package that the file belongs to.  This is not owned by
+     this structure.
+     */
+    YORI_STRING PackageName;
+
+    /**
+     A fully specified path to the file.  This must be freed when the
+     structure is deallocated.
+     */
+    YORI_STRING FilePath;
+
+    /**
+     The name of the file as recorded in the INI file.  This points within
+     the FilePath allocation.
+     */
+    YORI_STRING RelativeName;
+
+    /**
+     The digest that was recorded for the file when it was installed, or an
+     empty string if no digest was recorded.
+     */
+    YORI_STRING RecordedDigest;
+
+    /**
+     On successful completion, the digest of the file as it is now.
+     */
+    YORI_STRING Digest;
+
+    /**
+     The index of the file within the package, as recorded in the INI file.
+     */
+    DWORD FileIndex;
+
+    /**
+     The Win32 error code of any error encountered generating the digest.
+     */
+    DWORD Error;
+
+    /**
+     Set to TRUE if no digest should be generated for the file.
+     */
+    BOOLEAN Skip;
+
+    /**
+     Set to TRUE if the file should not be hashed if its last write time
+     matches the recorded digest.
+     */
+    BOOLEAN SkipIfUnchanged;
+
+    /**
+     Set to TRUE if the file was not hashed because its last write time
+     matches the recorded digest.
+     */
+    BOOLEAN Unchanged;
+
+    /**
+     Buffer for RecordedDigest.
+     */
+    TCHAR RecordedDigestBuffer[YORIPKG_DIGEST_LENGTH + 1];
+
+    /**
+     Buffer for Digest.
+     */
+    TCHAR DigestBuffer[YORIPKG_DIGEST_LENGTH + 1];
+
+} YORIPKG_DIGEST_FILE, *PYORIPKG_DIGEST_FILE;
+
+/**
+ A set of files whose digests are being generated by a set of threads.
+ */
+typedef struct _YORIPKG_DIGEST_SET {
+
+    /**
+     An array of files to generate digests for.
+     */
+    PYORIPKG_DIGEST_FILE Files;
+
+    /**
+     The number of elements in the Files array which are populated.
+     */
+    DWORD Count;
+
+    /**
+     The number of elements allocated in the Files array.
+     */
+    DWORD Allocated;
+
+} YORIPKG_DIGEST_SET, *PYORIPKG_DIGEST_SET;
+
+/**
+ Allocate space in a digest set for a specified number of files.
+
+ @param DigestSet Pointer to the digest set to initialize.
+
+ @param FileCount The number of files that will be added to the set.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriPkgInitializeDigestSet(
+    __out PYORIPKG_DIGEST_SET DigestSet,
+    __in DWORD FileCount
+    )
+{
+    ZeroMemory(DigestSet, sizeof(YORIPKG_DIGEST_SET));
+    if (FileCount == 0) {
+        return TRUE;
+    }
+
+    DigestSet->Files = YoriLibMalloc(FileCount * sizeof(YORIPKG_DIGEST_FILE));
+    if (DigestSet->Files == NULL) {
+        return FALSE;
+    }
+
+    ZeroMemory(DigestSet->Files, FileCount * sizeof(YORIPKG_DIGEST_FILE));
+    DigestSet->Allocated = FileCount;
+    return TRUE;
+}
+
+/**
+ Free a digest set and all of the files within it.
+
+ @param DigestSet Pointer to the digest set to free.
+ */
+VOID
+YoriPkgCleanupDigestSet(
+    __inout PYORIPKG_DIGEST_SET DigestSet
+    )
+{
+    DWORD Index;
+
+    if (DigestSet->Files != NULL) {
+        for (Index = 0; Index < DigestSet->Count; Index++) {
+            YoriLibFreeStringContents(&DigestSet->Files[Index].FilePath);
+        }
+        YoriLibFree(DigestSet->Files);
+        DigestSet->Files = NULL;
+    }
+}
+
+/**
+ Add the files of an installed package to a digest set.
+
+ @param PkgIni Pointer to the system global package INI file.
+
+ @param TargetDirectory Pointer to the directory that the package is
+        installed into.
+
+ @param PackageName Pointer to the name of the package.  This string must
+        remain valid for the lifetime of the digest set.
+
+ @param FileCount The number of files recorded for the package.
+
+ @param SkipIfUnchanged If TRUE, files whose last write time matches the
+        recorded digest are not hashed.
+
+ @param DigestSet Pointer to the digest set to add files to.  This must have
+        space allocated for FileCount additional files.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriPkgAddPackageToDigestSet(
+    __in PYORI_LIB_INI PkgIni,
+    __in PCYORI_STRING TargetDirectory,
+    __in PCYORI_STRING PackageName,
+    __in DWORD FileCount,
+    __in BOOLEAN SkipIfUnchanged,
+    __inout PYORIPKG_DIGEST_SET DigestSet
+    )
+{
+    PYORIPKG_DIGEST_FILE DigestFile;
+    YORI_STRING IniValue;
+    TCHAR FileIndexString[32];
+    DWORD FileIndex;
+
+    if (!YoriLibAllocateString(&IniValue, YORIPKG_MAX_FIELD_LENGTH)) {
+        return FALSE;
+    }
+
+    for (FileIndex = 1; FileIndex <= FileCount && DigestSet->Count < DigestSet->Allocated; FileIndex++) {
+        YoriLibSPrintf(FileIndexString, _T("File%i"), FileIndex);
+
+        IniValue.LengthInChars = (YORI_ALLOC_SIZE_T)
+            YoriLibIniGetString(PkgIni,
+                                PackageName->StartOfString,
+                                FileIndexString,
+                                _T(""),
+                                IniValue.StartOfString,
+                                IniValue.LengthAllocated);
+
+        if (IniValue.LengthInChars == 0) {
+            continue;
+        }
+
+        DigestFile = &DigestSet->Files[DigestSet->Count];
+        YoriLibInitEmptyString(&DigestFile->PackageName);
+        DigestFile->PackageName.StartOfString = PackageName->StartOfString;
+        DigestFile->PackageName.LengthInChars = PackageName->LengthInChars;
+
+        //
+        //  Pseudo packages record absolute paths, which are used as is.
+        //
+
+        YoriLibInitEmptyString(&DigestFile->FilePath);
+        YoriLibInitEmptyString(&DigestFile->RelativeName);
+        if (YoriLibIsPathPrefixed(&IniValue)) {
+            YoriLibYPrintf(&DigestFile->FilePath, _T("%y"), &IniValue);
+            DigestFile->RelativeName.StartOfString = DigestFile->FilePath.StartOfString;
+            DigestFile->RelativeName.LengthInChars = DigestFile->FilePath.LengthInChars;
+        } else {
+            YoriLibYPrintf(&DigestFile->FilePath, _T("%y\\%y"), TargetDirectory, &IniValue);
+            if (DigestFile->FilePath.LengthInChars > 0) {
+                DigestFile->RelativeName.StartOfString = &DigestFile->FilePath.StartOfString[TargetDirectory->LengthInChars + 1];
+                DigestFile->RelativeName.LengthInChars = DigestFile->FilePath.LengthInChars - TargetDirectory->LengthInChars - 1;
+            }
+        }
+
+        if (DigestFile->FilePath.LengthInChars == 0) {
+            YoriLibFreeStringContents(&IniValue);
+            return FALSE;
+        }
+
+        YoriLibInitEmptyString(&DigestFile->RecordedDigest);
+        DigestFile->RecordedDigest.StartOfString = DigestFile->RecordedDigestBuffer;
+        DigestFile->RecordedDigest.LengthAllocated = sizeof(DigestFile->RecordedDigestBuffer) / sizeof(TCHAR);
+
+        YoriLibSPrintf(FileIndexString, _T("File%iDigest"), FileIndex);
+        DigestFile->RecordedDigest.LengthInChars = (YORI_ALLOC_SIZE_T)
+            YoriLibIniGetString(PkgIni,
+                                PackageName->StartOfString,
+                                FileIndexString,
+                                _T(""),
+                                DigestFile->RecordedDigest.StartOfString,
+                                DigestFile->RecordedDigest.LengthAllocated);
+
+        YoriLibInitEmptyString(&DigestFile->Digest);
+        DigestFile->Digest.StartOfString = DigestFile->DigestBuffer;
+        DigestFile->Digest.LengthAllocated = sizeof(DigestFile->DigestBuffer) / sizeof(TCHAR);
+        DigestFile->FileIndex = FileIndex;
+        DigestFile->SkipIfUnchanged = SkipIfUnchanged;
+        DigestSet->Count++;
+    }
+
+    YoriLibFreeStringContents(&IniValue);
+    return TRUE;
+}
+
+/**
+ Generate the digest for a single file.
+
+ @param Provider A crypto provider returned from
+        @ref YoriPkgAcquireHashProvider .
+
+ @param DigestFile Pointer to the file to generate a digest for.  On
+        completion, its Digest or Error member is updated.
+ */
+VOID
+YoriPkgGenerateFileDigest(
+    __in HCRYPTPROV Provider,
+    __inout PYORIPKG_DIGEST_FILE DigestFile
+    )
+{
+    BY_HANDLE_FILE_INFORMATION FileInfo;
+    HANDLE FileHandle;
+    YORI_STRING HashString;
+
+    FileHandle = CreateFile(DigestFile->FilePath.StartOfString,
+                            FILE_READ_ATTRIBUTES,
+                            FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                            NULL,
+                            OPEN_EXISTING,
+                            0,
+                            NULL);
+
+    if (FileHandle == INVALID_HANDLE_VALUE) {
+        DigestFile->Error = GetLastError();
+        return;
+    }
+
+    if (!GetFileInformationByHandle(FileHandle, &FileInfo)) {
+        DigestFile->Error = GetLastError();
+        CloseHandle(FileHandle);
+        return;
+    }
+
+    CloseHandle(FileHandle);
+
+    DigestFile->Digest.LengthInChars = (YORI_ALLOC_SIZE_T)
+        YoriLibSPrintf(DigestFile->Digest.StartOfString,
+                       _T("%08x%08x,"),
+                       FileInfo.ftLastWriteTime.dwHighDateTime,
+                       FileInfo.ftLastWriteTime.dwLowDateTime);
+
+    //
+    //  If the file has not been written since its digest was recorded,
+    //  assume its contents are unchanged.
+    //
+
+    if (DigestFile->SkipIfUnchanged &&
+        DigestFile->RecordedDigest.LengthInChars == YORIPKG_DIGEST_LENGTH &&
+        YoriLibCompareStringCnt(&DigestFile->Digest, &DigestFile->RecordedDigest, YORIPKG_DIGEST_TIMESTAMP_LENGTH + 1) == 0) {
+
+        memcpy(DigestFile->Digest.StartOfString, DigestFile->RecordedDigest.StartOfString, (YORIPKG_DIGEST_LENGTH + 1) * sizeof(TCHAR));
+        DigestFile->Digest.LengthInChars = YORIPKG_DIGEST_LENGTH;
+        DigestFile->Unchanged = TRUE;
+        return;
+    }
+
+    YoriLibInitEmptyString(&HashString);
+    HashString.StartOfString = &DigestFile->Digest.StartOfString[YORIPKG_DIGEST_TIMESTAMP_LENGTH + 1];
+    HashString.LengthAllocated = YORIPKG_HASH_SIZE * 2 + 1;
+
+    if (!YoriPkgHashFile(Provider, &DigestFile->FilePath, &HashString)) {
+        DigestFile->Error = GetLastError();
+        if (DigestFile->Error == ERROR_SUCCESS) {
+            DigestFile->Error = ERROR_READ_FAULT;
+        }
+        DigestFile->Digest.LengthInChars = 0;
+        return;
+    }
+
+    DigestFile->Digest.LengthInChars = YORIPKG_DIGEST_TIMESTAMP_LENGTH + 1 + HashString.LengthInChars;
+}
+
+/**
+ Generate digests for a batch of files within a digest set.  This is invoked
+ on multiple threads concurrently, each operating on a different batch.
+
+ @param Context Pointer to the YORIPKG_DIGEST_SET structure.
+
+ @param Index The index of the batch, in units of
+        YORIPKG_DIGEST_BATCH_SIZE files.
+ */
+VOID
+YoriPkgDigestBatch(
+    __in PVOID Context,
+    __in DWORD Index
+    )
+{
+    PYORIPKG_DIGEST_SET DigestSet = (PYORIPKG_DIGEST_SET)Context;
+    PYORIPKG_DIGEST_FILE DigestFile;
+    HCRYPTPROV Provider;
+    DWORD ProviderError;
+    DWORD FileIndex;
+    DWORD EndIndex;
+
+    FileIndex = Index * YORIPKG_DIGEST_BATCH_SIZE;
+    EndIndex = FileIndex + YORIPKG_DIGEST_BATCH_SIZE;
+    if (EndIndex > DigestSet->Count) {
+        EndIndex = DigestSet->Count;
+    }
+
+    //
+    //  A provider is not shared between threads, so acquire one for this
+    //  batch.
+    //
+
+    ProviderError = ERROR_SUCCESS;
+    if (!YoriPkgAcquireHashProvider(&Provider)) {
+        ProviderError = GetLastError();
+        if (ProviderError == ERROR_SUCCESS) {
+            ProviderError = ERROR_PROC_NOT_FOUND;
+        }
+    }
+
+    for (; FileIndex < EndIndex; FileIndex++) {
+        DigestFile = &DigestSet->Files[FileIndex];
+        if (DigestFile->Skip) {
+            continue;
+        } else if (ProviderError != ERROR_SUCCESS) {
+            DigestFile->Error = ProviderError;
+        } else {
+            YoriPkgGenerateFileDigest(Provider, DigestFile);
+        }
+    }
+
+    if (ProviderError == ERROR_SUCCESS) {
+        DllAdvApi32.pCryptReleaseContext(Provider, 0);
+    }
+}
+
+/**
+ Generate digests for every file in a digest set, using multiple threads.
+
+ @param DigestSet Pointer to the digest set.  On completion, each file has
+        either a Digest or an Error.
+ */
+VOID
+YoriPkgGenerateDigests(
+    __inout PYORIPKG_DIGEST_SET DigestSet
+    )
+{
+    DWORD BatchCount;
+
+    //
+    //  Load advapi32.dll before any threads need it.
+    //
+
+    YoriLibLoadAdvApi32Functions();
+
+    BatchCount = (DigestSet->Count + YORIPKG_DIGEST_BATCH_SIZE - 1) / YORIPKG_DIGEST_BATCH_SIZE;
+    YoriLibProcessItemsInParallel(BatchCount, YORIPKG_DIGEST_THREADS, YoriPkgDigestBatch, DigestSet);
+}
+
+/**
+ Record a digest for each file in a newly installed package, so that the
+ package can later be checked for modification.  This is best effort; if a
+ digest cannot be generated, the file is installed without one, and the
+ package can still be used normally.
+
+ @param PkgIni Pointer to the system global package INI file.
+
+ @param TargetDirectory Pointer to the directory that the package was
+        installed into.
+
+ @param PackageName Pointer to the name of the package.
+
+ @param FileCount The number of files recorded for the package.
+ */
+VOID
+YoriPkgRecordPackageDigests(
+    __in PYORI_LIB_INI PkgIni,
+    __in PCYORI_STRING TargetDirectory,
+    __in PCYORI_STRING PackageName,
+    __in DWORD FileCount
+    )
+{
+    YORIPKG_DIGEST_SET DigestSet;
+    PYORIPKG_DIGEST_FILE DigestFile;
+    TCHAR FileIndexString[32];
+    DWORD Index;
+
+    if (!YoriPkgInitializeDigestSet(&DigestSet, FileCount)) {
+        return;
+    }
+
+    if (!YoriPkgAddPackageToDigestSet(PkgIni, TargetDirectory, PackageName, FileCount, FALSE, &DigestSet)) {
+        YoriPkgCleanupDigestSet(&DigestSet);
+        return;
+    }
+
+    YoriPkgGenerateDigests(&DigestSet);
+
+    for (Index = 0; Index < DigestSet.Count; Index++) {
+        DigestFile = &DigestSet.Files[Index];
+        if (DigestFile->Error != ERROR_SUCCESS) {
+            continue;
+        }
+
+        YoriLibSPrintf(FileIndexString, _T("File%iDigest"), DigestFile->FileIndex);
+        YoriLibIniSetString(PkgIni, PackageName->StartOfString, FileIndexString, DigestFile->Digest.StartOfString);
+    }
+
+    YoriPkgCleanupDigestSet(&DigestSet);
+}
+
+/**
+ Check whether the files of installed packages match the digests recorded
+ when they were installed, and report any that have been modified or are
+ missing.
+
+ @param PackageNames Optionally points to an array of package names to
+        verify.  If not specified, all installed packages are verified.
+
+ @param PackageNameCount The number of elements in the PackageNames array.
+
+ @param ChangedOnly If TRUE, only files whose last write time has changed
+        since installation are hashed.  If FALSE, every file is hashed.
+
+ @return TRUE to indicate that every file matches its recorded digest,
+         FALSE to indicate that a file was modified or missing, or the
+         check could not be performed.
+ */
+BOOL
+YoriPkgVerifyInstalledPackages(
+    __in_opt PYORI_STRING PackageNames,
+    __in DWORD PackageNameCount,
+    __in BOOL ChangedOnly
+    )
+{
+    YORI_LIB_INI PkgIni;
+    YORI_STRING InstalledSection;
+    YORI_STRING AppDirectory;
+    YORI_STRING CurrentHash;
+    YORI_STRING RecordedHash;
+    PYORI_STRING PkgNames;
+    PYORIPKG_DIGEST_FILE DigestFile;
+    YORIPKG_DIGEST_SET DigestSet;
+    LPTSTR ThisLine;
+    LPTSTR Equals;
+    DWORD PkgCount;
+    DWORD TotalFiles;
+    DWORD Index;
+    DWORD CheckedCount;
+    DWORD UnchangedCount;
+    DWORD ModifiedCount;
+    DWORD MissingCount;
+    DWORD NotRecordedCount;
+    BOOL Result;
+
+    Result = FALSE;
+    PkgNames = NULL;
+    PkgCount = 0;
+    YoriLibInitEmptyString(&InstalledSection);
+    YoriLibInitEmptyString(&AppDirectory);
+    ZeroMemory(&DigestSet, sizeof(DigestSet));
+
+    if (!YoriPkgLoadPackageIni(NULL, &PkgIni)) {
+        return FALSE;
+    }
+
+    if (!YoriPkgGetApplicationDirectory(&AppDirectory)) {
+        YoriLibInitEmptyString(&AppDirectory);
+        goto Exit;
+    }
+
+    if (!YoriLibAllocateString(&InstalledSection, YORIPKG_MAX_SECTION_LENGTH)) {
+        goto Exit;
+    }
+
+    InstalledSection.LengthInChars = (YORI_ALLOC_SIZE_T)
+        YoriLibIniGetSection(&PkgIni,
+                             _T("Installed"),
+                             InstalledSection.StartOfString,
+                             InstalledSection.LengthAllocated);
+
+    //
+    //  If no packages were specified, verify everything that is installed.
+    //  Count the packages, then capture each name, terminating it in place.
+    //
+
+    if (PackageNames == NULL || PackageNameCount == 0) {
+        ThisLine = InstalledSection.StartOfString;
+        while (*ThisLine != '\0') {
+            PackageNameCount++;
+            ThisLine += _tcslen(ThisLine);
+            ThisLine++;
+        }
+
+        if (PackageNameCount > 0) {
+            PkgNames = YoriLibMalloc(PackageNameCount * sizeof(YORI_STRING));
+            if (PkgNames == NULL) {
+                goto Exit;
+            }
+        }
+
+        ThisLine = InstalledSection.StartOfString;
+        while (*ThisLine != '\0' && PkgCount < PackageNameCount) {
+            YoriLibInitEmptyString(&PkgNames[PkgCount]);
+            PkgNames[PkgCount].StartOfString = ThisLine;
+            Equals = _tcschr(ThisLine, '=');
+            ThisLine += _tcslen(ThisLine);
+            ThisLine++;
+            if (Equals != NULL) {
+                *Equals = '\0';
+            }
+            PkgNames[PkgCount].LengthInChars = (YORI_ALLOC_SIZE_T)_tcslen(PkgNames[PkgCount].StartOfString);
+            PkgCount++;
+        }
+    } else {
+        PkgNames = PackageNames;
+        PkgCount = PackageNameCount;
+    }
+
+    //
+    //  Size the set to hold every file from every package so all of the
+    //  files can be hashed by the same set of threads.
+    //
+
+    TotalFiles = 0;
+    for (Index = 0; Index < PkgCount; Index++) {
+        TotalFiles += YoriLibIniGetInt(&PkgIni, PkgNames[Index].StartOfString, _T("FileCount"), 0);
+    }
+
+    if (!YoriPkgInitializeDigestSet(&DigestSet, TotalFiles)) {
+        goto Exit;
+    }
+
+    for (Index = 0; Index < PkgCount; Index++) {
+        if (YoriLibIniGetInt(&PkgIni, PkgNames[Index].StartOfString, _T("FileCount"), 0) == 0) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%y is not installed\n"), &PkgNames[Index]);
+            continue;
+        }
+
+        if (!YoriPkgAddPackageToDigestSet(&PkgIni,
+                                          &AppDirectory,
+                                          &PkgNames[Index],
+                                          YoriLibIniGetInt(&PkgIni, PkgNames[Index].StartOfString, _T("FileCount"), 0),
+                                          (BOOLEAN)ChangedOnly,
+                                          &DigestSet)) {
+            goto Exit;
+        }
+    }
+
+    //
+    //  Files with no recorded digest have nothing to compare against, so
+    //  they are reported without being hashed.
+    //
+
+    NotRecordedCount = 0;
+    for (Index = 0; Index < DigestSet.Count; Index++) {
+        DigestFile = &DigestSet.Files[Index];
+        if (DigestFile->RecordedDigest.LengthInChars != YORIPKG_DIGEST_LENGTH) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y: %y has no recorded digest\n"), &DigestFile->PackageName, &DigestFile->RelativeName);
+            DigestFile->Skip = TRUE;
+            NotRecordedCount++;
+        }
+    }
+
+    YoriPkgGenerateDigests(&DigestSet);
+
+    CheckedCount = 0;
+    UnchangedCount = 0;
+    ModifiedCount = 0;
+    MissingCount = 0;
+
+    for (Index = 0; Index < DigestSet.Count; Index++) {
+        DigestFile = &DigestSet.Files[Index];
+        if (DigestFile->Skip) {
+            continue;
+        }
+
+        CheckedCount++;
+        if (DigestFile->Error == ERROR_FILE_NOT_FOUND ||
+            DigestFile->Error == ERROR_PATH_NOT_FOUND) {
+
+            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y: %y is missing\n"), &DigestFile->PackageName, &DigestFile->RelativeName);
+            MissingCount++;
+        } else if (DigestFile->Error != ERROR_SUCCESS) {
+            LPTSTR ErrText;
+            ErrText = YoriLibGetWinErrorText(DigestFile->Error);
+            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y: %y could not be read: %s"), &DigestFile->PackageName, &DigestFile->RelativeName, ErrText);
+            YoriLibFreeWinErrorText(ErrText);
+            ModifiedCount++;
+        } else if (DigestFile->Unchanged) {
+            UnchangedCount++;
+        } else {
+
+            //
+            //  A file may have been rewritten with identical contents, so
+            //  only the hash portion of the digest is compared.
+            //
+
+            YoriLibInitEmptyString(&CurrentHash);
+            CurrentHash.StartOfString = &DigestFile->Digest.StartOfString[YORIPKG_DIGEST_TIMESTAMP_LENGTH + 1];
+            CurrentHash.LengthInChars = DigestFile->Digest.LengthInChars - YORIPKG_DIGEST_TIMESTAMP_LENGTH - 1;
+            YoriLibInitEmptyString(&RecordedHash);
+            RecordedHash.StartOfString = &DigestFile->RecordedDigest.StartOfString[YORIPKG_DIGEST_TIMESTAMP_LENGTH + 1];
+            RecordedHash.LengthInChars = DigestFile->RecordedDigest.LengthInChars - YORIPKG_DIGEST_TIMESTAMP_LENGTH - 1;
+
+            if (YoriLibCompareStringIns(&CurrentHash, &RecordedHash) != 0) {
+                YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y: %y has been modified\n"), &DigestFile->PackageName, &DigestFile->RelativeName);
+                ModifiedCount++;
+            }
+        }
+    }
+
+    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT,
+                  _T("%i files checked, %i skipped as unchanged, %i modified, %i missing, %i without a recorded digest\n"),
+                  CheckedCount,
+                  UnchangedCount,
+                  ModifiedCount,
+                  MissingCount,
+                  NotRecordedCount);
+
+    if (ModifiedCount == 0 && MissingCount == 0) {
+        Result = TRUE;
+    }
+
+Exit:
+    YoriPkgCleanupDigestSet(&DigestSet);
+    if (PkgNames != NULL && PkgNames != PackageNames) {
+        YoriLibFree(PkgNames);
+    }
+    YoriLibFreeStringContents(&InstalledSection);
+    YoriLibFreeStringContents(&AppDirectory);
+    YoriLibIniCleanup(&PkgIni);
+    return Result;
+}
+
+// vim:sw=4:ts=4:et:
@@ -60,6 +60,14 @@ YoriPkgCreateSourcePackage(
     __in PYORI_STRING FileRoot
     );
 
+BOOL
+YoriPkgCreateDeltaPackage(
+    __in PYORI_STRING FileName,
+    __in PYORI_STRING BasePackage,
+    __in PYORI_STRING NewPackage,
+    __in PYORI_STRING FullPackagePath
+    );
+
 BOOL
 YoriPkgDeletePackage(
     __in_opt PCYORI_STRING TargetDirectory,
@@ -171,10 +179,18 @@ YoriPkgListInstalledPackages(
     __in BOOL Verbose
     );
 
+BOOL
+YoriPkgVerifyInstalledPackages(
+    __in_opt PYORI_STRING PackageNames,
+    __in DWORD PackageNameCount,
+    __in BOOL ChangedOnly
+    );
+
 BOOL
 YoriPkgDownloadRemotePackages(
     __in PYORI_STRING Source,
-    __in PYORI_STRING DownloadPath
+    __in PYORI_STRING DownloadPath,
+    __in BOOL Incremental
     );
 
 BOOL
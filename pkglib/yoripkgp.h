@@ -54,6 +54,13 @@ typedef struct _YORIPKG_BACKUP_FILE {
      stored in the master .ini file for the file.
      */
     YORI_STRING OriginalRelativeName;
+
+    /**
+     The digest recorded for the file when it was installed, or an empty
+     string if no digest was recorded.  This must be freed when the
+     structure is deallocated.
+     */
+    YORI_STRING RecordedDigest;
 } YORIPKG_BACKUP_FILE, *PYORIPKG_BACKUP_FILE;
 
 /**
@@ -151,6 +158,67 @@ typedef struct _YORIPKG_EXISTING_FILE {
     YORI_STRING RelativeFileName;
 } YORIPKG_EXISTING_FILE, *PYORIPKG_EXISTING_FILE;
 
+/**
+ The state of a package being downloaded ahead of being prepared for
+ install.
+ */
+typedef enum _YORIPKG_DOWNLOAD_STATE {
+    YoriPkgDownloadQueued = 0,
+    YoriPkgDownloadActive = 1,
+    YoriPkgDownloadComplete = 2,
+    YoriPkgDownloadTaken = 3
+} YORIPKG_DOWNLOAD_STATE;
+
+/**
+ A package being downloaded ahead of being prepared for install.  This
+ allows multiple packages to be downloaded concurrently.
+ */
+typedef struct _YORIPKG_DOWNLOAD {
+
+    /**
+     The linkage of this download within the list of downloads.
+     */
+    YORI_LIST_ENTRY ListEntry;
+
+    /**
+     The work queue item used to perform the download on a worker thread.
+     */
+    YORILIB_WORK_ITEM WorkItem;
+
+    /**
+     The path to the package, which is typically a URL.
+     */
+    YORI_STRING PackagePath;
+
+    /**
+     A substring of PackagePath containing the host name.  This is used to
+     limit the number of concurrent downloads from a single host.
+     */
+    YORI_STRING Host;
+
+    /**
+     Once the download is complete, the path to a local copy of the package.
+     */
+    YORI_STRING LocalPath;
+
+    /**
+     Once the download is complete, the result of the download.
+     */
+    DWORD Error;
+
+    /**
+     The state of the download.
+     */
+    YORIPKG_DOWNLOAD_STATE State;
+
+    /**
+     TRUE if LocalPath refers to a temporary file that should be deleted
+     when processing is complete.
+     */
+    BOOLEAN DeleteWhenFinished;
+
+} YORIPKG_DOWNLOAD, *PYORIPKG_DOWNLOAD;
+
 /**
  A list of packages awaiting installation.  These have been downloaded and
  parsed, and any existing packages that conflict with the new packages have
@@ -188,6 +256,12 @@ typedef struct _YORIPKG_PACKAGES_PENDING_INSTALL {
      */
     PYORI_HASH_TABLE ExistingFilesTable;
 
+    /**
+     A list of packages which have been downloaded ahead of being prepared
+     for install.  Paired with @ref YORIPKG_DOWNLOAD::ListEntry .
+     */
+    YORI_LIST_ENTRY Downloads;
+
 } YORIPKG_PACKAGES_PENDING_INSTALL, *PYORIPKG_PACKAGES_PENDING_INSTALL;
 
 /**
@@ -266,6 +340,15 @@ typedef struct _YORIPKG_PACKAGE_PENDING_INSTALL {
      */
     YORI_STRING UpgradeToStablePath;
 
+    /**
+     If the package is a delta package, the contents of its [Files] section,
+     which consists of a series of NULL terminated name=digest lines followed
+     by an additional NULL.  Each of these files is retained unchanged from
+     the installed version of the package rather than included in the CAB.
+     This is an empty string for a complete package.
+     */
+    YORI_STRING UnchangedFiles;
+
     /**
      A path to a local file containing the CAB file to install.
      */
@@ -302,6 +385,17 @@ typedef struct _YORIPKG_PACKAGE_PENDING_INSTALL {
 #define YORIPKG_MAX_SECTION_LENGTH (32 * 1024)
 #endif
 
+/**
+ The size of the digest used to identify the contents of files, in bytes.
+ This is a SHA1 digest.
+ */
+#define YORIPKG_HASH_SIZE (20)
+
+/**
+ The size of the buffer used to read files when generating a digest.
+ */
+#define YORIPKG_HASH_READ_BUFFER_SIZE (64 * 1024)
+
 __success(return)
 BOOL
 YoriPkgGetExecutableFile(
@@ -321,6 +415,19 @@ YoriPkgGetPackageIniFile(
     __out PYORI_STRING IniFileName
     );
 
+__success(return)
+BOOL
+YoriPkgLoadPackageIni(
+    __in_opt PCYORI_STRING InstallDirectory,
+    __out PYORI_LIB_INI PkgIni
+    );
+
+__success(return)
+BOOL
+YoriPkgFlushPackageIni(
+    __in PYORI_LIB_INI PkgIni
+    );
+
 __success(return)
 BOOL
 YoriPkgGetPackageInfo(
@@ -340,7 +447,7 @@ YoriPkgGetPackageInfo(
 __success(return)
 BOOL
 YoriPkgGetInstalledPackageInfo(
-    __in PYORI_STRING IniPath,
+    __in PYORI_LIB_INI PkgIni,
     __in PYORI_STRING PackageName,
     __out PYORI_STRING PackageVersion,
     __out PYORI_STRING PackageArch,
@@ -355,7 +462,7 @@ BOOL
 YoriPkgBuildUpgradeLocationForNewArchitecture(
     __in PYORI_STRING PackageName,
     __in PYORI_STRING NewArchitecture,
-    __in PYORI_STRING PkgIniFile,
+    __in PYORI_LIB_INI PkgIni,
     __inout PYORI_STRING UpgradePath
     );
 
@@ -367,6 +474,16 @@ YoriPkgConvertUserPackagePathToMirroredPath(
     __out PYORI_STRING MirroredPath
     );
 
+__success(return == ERROR_SUCCESS)
+DWORD
+YoriPkgPackagePathToLocalPathWithSession(
+    __in_opt PVOID Session,
+    __in PYORI_STRING PackagePath,
+    __in_opt PCYORI_STRING IniFilePath,
+    __out PYORI_STRING LocalPath,
+    __out PBOOLEAN DeleteWhenFinished
+    );
+
 __success(return == ERROR_SUCCESS)
 DWORD
 YoriPkgPackagePathToLocalPath(
@@ -376,6 +493,101 @@ YoriPkgPackagePathToLocalPath(
     __out PBOOLEAN DeleteWhenFinished
     );
 
+__success(return == ERROR_SUCCESS)
+DWORD
+YoriPkgPackageIndexToLocalPath(
+    __in PYORI_STRING IndexPath,
+    __in PCYORI_STRING IniFilePath,
+    __out PYORI_STRING LocalPath,
+    __out PBOOLEAN DeleteWhenFinished
+    );
+
+__success(return)
+BOOL
+YoriPkgAcquireHashProvider(
+    __out HCRYPTPROV * Provider
+    );
+
+__success(return)
+BOOL
+YoriPkgHashFile(
+    __in HCRYPTPROV Provider,
+    __in PCYORI_STRING FilePath,
+    __inout PYORI_STRING HashString
+    );
+
+VOID
+YoriPkgRecordPackageDigests(
+    __in PYORI_LIB_INI PkgIni,
+    __in PCYORI_STRING TargetDirectory,
+    __in PCYORI_STRING PackageName,
+    __in DWORD FileCount
+    );
+
+__success(return)
+BOOL
+YoriPkgCreateTempDirectory(
+    __in_opt PCYORI_STRING ParentDirectory,
+    __out PYORI_STRING DirectoryName
+    );
+
+VOID
+YoriPkgDeleteTempDirectory(
+    __inout PYORI_STRING DirectoryName
+    );
+
+__success(return)
+BOOL
+YoriPkgQueueDownload(
+    __inout PYORI_LIST_ENTRY DownloadList,
+    __in PCYORI_STRING PackagePath
+    );
+
+VOID
+YoriPkgCompleteDownloads(
+    __inout PYORI_LIST_ENTRY DownloadList,
+    __in_opt PCYORI_STRING PkgIniFile
+    );
+
+__success(return)
+BOOL
+YoriPkgTakeDownload(
+    __in PYORI_LIST_ENTRY DownloadList,
+    __in PCYORI_STRING PackagePath,
+    __out PDWORD Error,
+    __out PYORI_STRING LocalPath,
+    __out PBOOLEAN DeleteWhenFinished
+    );
+
+VOID
+YoriPkgFreeDownloads(
+    __inout PYORI_LIST_ENTRY DownloadList
+    );
+
+__success(return)
+BOOL
+YoriPkgFindCachedPackage(
+    __in PCYORI_STRING PkgIniFile,
+    __in PYORIPKG_PACKAGES_PENDING_INSTALL PackageList,
+    __in PYORI_STRING PackageUrl,
+    __out PYORI_STRING LocalPath
+    );
+
+VOID
+YoriPkgResolveDownloadsFromCache(
+    __in PCYORI_STRING PkgIniFile,
+    __inout PYORIPKG_PACKAGES_PENDING_INSTALL PackageList
+    );
+
+VOID
+YoriPkgAddPackageToCache(
+    __in PCYORI_STRING PkgIniFile,
+    __in PCYORI_STRING PackageName,
+    __in PCYORI_STRING Version,
+    __in PCYORI_STRING Architecture,
+    __in PCYORI_STRING LocalPath
+    );
+
 __success(return)
 BOOL
 YoriPkgIsNewerVersionAvailable(
@@ -386,6 +598,14 @@ YoriPkgIsNewerVersionAvailable(
     __out PYORI_STRING RedirectToPackageUrl
     );
 
+__success(return)
+BOOL
+YoriPkgFindSectionValue(
+    __in PYORI_STRING Section,
+    __in LPCTSTR KeyName,
+    __out PYORI_STRING Value
+    );
+
 VOID
 YoriPkgFreeAllSourcesAndPackages(
     __in_opt PYORI_LIST_ENTRY SourcesList,
@@ -404,28 +624,29 @@ YoriPkgFreeBackupPackage(
 
 VOID
 YoriPkgRollbackPackage(
-    __in PCYORI_STRING IniPath,
+    __in PYORI_LIB_INI PkgIni,
     __in PYORIPKG_BACKUP_PACKAGE PackageBackup
     );
 
 __success(return == ERROR_SUCCESS)
 DWORD
 YoriPkgBackupPackage(
-    __in PYORI_STRING IniPath,
+    __in PYORI_LIB_INI PkgIni,
     __in PCYORI_STRING PackageName,
     __in_opt PCYORI_STRING TargetDirectory,
+    __in_opt PYORI_STRING UnchangedFiles,
     __out PYORIPKG_BACKUP_PACKAGE * PackageBackup
     );
 
 VOID
 YoriPkgRemoveSystemReferencesToPackage(
-    __in PYORI_STRING IniPath,
+    __in PYORI_LIB_INI PkgIni,
     __in PYORIPKG_BACKUP_PACKAGE PackageBackup
     );
 
 VOID
 YoriPkgRollbackAndFreeBackupPackageList(
-    __in PCYORI_STRING IniPath,
+    __in PYORI_LIB_INI PkgIni,
     __in_opt PCYORI_STRING NewDirectory,
     __in PYORI_LIST_ENTRY ListHead
     );
@@ -453,16 +674,16 @@ YoriPkgDeletePendingPackages(
 __success(return == ERROR_SUCCESS)
 DWORD
 YoriPkgPreparePackageForInstall(
-    __in PYORI_STRING PkgIniFile,
+    __in PYORI_LIB_INI PkgIni,
     __in_opt PCYORI_STRING TargetDirectory,
     __inout PYORIPKG_PACKAGES_PENDING_INSTALL PackageList,
     __in PYORI_STRING PackageUrl,
-    __out_opt _On_failure_(_When_(return == ERROR_OLD_WIN_VERSION, _Post_valid_)) PYORI_STRING RedirectToPackageUrl
+    __out_opt _On_failure_(_When_(return == ERROR_OLD_WIN_VERSION || return == ERROR_REVISION_MISMATCH, _Post_valid_)) PYORI_STRING RedirectToPackageUrl
     );
 
 DWORD
 YoriPkgPreparePackageForInstallRedirectBuild(
-    __in PYORI_STRING PkgIniFile,
+    __in PYORI_LIB_INI PkgIni,
     __in_opt PYORI_STRING TargetDirectory,
     __inout PYORIPKG_PACKAGES_PENDING_INSTALL PackageList,
     __in PYORI_STRING PackageUrl
@@ -470,7 +691,7 @@ YoriPkgPreparePackageForInstallRedirectBuild(
 
 BOOL
 YoriPkgAddExistingFilesToPendingPackages(
-    __in PYORI_STRING PkgIniFile,
+    __in PYORI_LIB_INI PkgIni,
     __in PYORIPKG_PACKAGES_PENDING_INSTALL PendingPackages
     );
 
@@ -482,14 +703,14 @@ YoriPkgCheckIfFileAlreadyExists(
 
 BOOL
 YoriPkgInstallPendingPackages(
-    __in PYORI_STRING PkgIniFile,
+    __in PYORI_LIB_INI PkgIni,
     __in_opt PCYORI_STRING TargetDirectory,
     __in PYORIPKG_PACKAGES_PENDING_INSTALL PendingPackages
     );
 
 BOOL
 YoriPkgCheckIfPackageDeleteable(
-    __in PYORI_STRING PkgIniFile,
+    __in PYORI_LIB_INI PkgIni,
     __in_opt PYORI_STRING TargetDirectory,
     __in PYORI_STRING PackageName,
     __in BOOLEAN IgnoreFailureOfCurrentExecutable
@@ -497,7 +718,7 @@ YoriPkgCheckIfPackageDeleteable(
 
 DWORD
 YoriPkgDeletePackageInternal(
-    __in PYORI_STRING PkgIniFile,
+    __in PYORI_LIB_INI PkgIni,
     __in_opt PCYORI_STRING TargetDirectory,
     __in PCYORI_STRING PackageName,
     __in BOOLEAN IgnoreFailureOfCurrentExecutable
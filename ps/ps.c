@@ -26,6 +26,7 @@
 
 #include <yoripch.h>
 #include <yorilib.h>
+#include <yoriwin.h>
 
 /**
  Help text to display to the user.
@@ -36,10 +37,13 @@ CHAR strPsHelpText[] =
         "Display process list.\n"
         "\n"
         "PS [-license] [-a] [-f] [-l]\n"
+        "PS -t\n"
         "\n"
         "   -a             Display all processes\n"
         "   -f             Display full format including command line\n"
-        "   -l             Display long format including memory usage\n";
+        "   -l             Display long format including memory usage\n"
+        "   -t             Display a continuously refreshing list of processes\n"
+        "                    including CPU, working set and IO changes\n";
 
 /**
  Display usage text to the user.
@@ -501,6 +505,1033 @@ PsDisplayConsoleProcesses(
     return TRUE;
 }
 
+/**
+ The interval between refreshes of the process list in top mode, in
+ milliseconds.
+ */
+#define PS_TOP_REFRESH_INTERVAL (1000)
+
+/**
+ The number of characters to allocate for a formatted row in top mode.
+ */
+#define PS_TOP_ROW_LENGTH (256)
+
+/**
+ The set of orders that processes can be sorted into in top mode.
+ */
+typedef enum _PS_TOP_SORT {
+    PsTopSortCpu = 0,
+    PsTopSortWorkingSet = 1,
+    PsTopSortIo = 2,
+    PsTopSortPid = 3
+} PS_TOP_SORT;
+
+/**
+ Information about a single process in a snapshot, including the changes
+ since the previous snapshot.
+ */
+typedef struct _PS_TOP_ENTRY {
+
+    /**
+     Pointer to the system information about the process.  This points into
+     the buffer of the snapshot that contains this entry.
+     */
+    PYORI_SYSTEM_PROCESS_INFORMATION ProcessInfo;
+
+    /**
+     The number of bytes transferred by the process over its lifetime.
+     */
+    DWORDLONG IoBytes;
+
+    /**
+     The number of bytes transferred per second since the previous snapshot.
+     */
+    DWORDLONG IoBytesPerSecond;
+
+    /**
+     The change in the working set since the previous snapshot.
+     */
+    LONGLONG WorkingSetDelta;
+
+    /**
+     The share of total processor time used by the process since the
+     previous snapshot, in tenths of a percent.
+     */
+    DWORD CpuPermille;
+
+} PS_TOP_ENTRY, *PPS_TOP_ENTRY;
+
+/**
+ A single capture of all processes in the system.
+ */
+typedef struct _PS_TOP_SNAPSHOT {
+
+    /**
+     The buffer returned from the system describing all processes.  This is
+     retained between refreshes and only reallocated if it is too small.
+     */
+    PYORI_SYSTEM_PROCESS_INFORMATION Buffer;
+
+    /**
+     The size of Buffer, in bytes.
+     */
+    YORI_ALLOC_SIZE_T BufferSize;
+
+    /**
+     The system time when the snapshot was captured.
+     */
+    LONGLONG Time;
+
+    /**
+     An array of entries, one per process, in the order returned from the
+     system.
+     */
+    PPS_TOP_ENTRY Entries;
+
+    /**
+     An array of pointers to Entries, sorted by process ID so that entries
+     can be matched against the next snapshot.
+     */
+    PPS_TOP_ENTRY *PidOrder;
+
+    /**
+     The number of elements allocated in Entries and PidOrder.
+     */
+    YORI_ALLOC_SIZE_T EntriesAllocated;
+
+    /**
+     The number of elements populated in Entries and PidOrder.
+     */
+    YORI_ALLOC_SIZE_T EntryCount;
+
+} PS_TOP_SNAPSHOT, *PPS_TOP_SNAPSHOT;
+
+/**
+ Context describing the state of a continuously refreshing process display.
+ */
+typedef struct _PS_TOP_CONTEXT {
+
+    /**
+     Two snapshots, one describing the current state of the system and one
+     describing the state at the previous refresh.
+     */
+    PS_TOP_SNAPSHOT Snapshots[2];
+
+    /**
+     The index within Snapshots of the most recent snapshot.
+     */
+    DWORD CurrentSnapshot;
+
+    /**
+     The number of snapshots that have been captured.  Changes can only be
+     calculated once this is greater than one.
+     */
+    DWORD SnapshotsTaken;
+
+    /**
+     The number of processors in the system.  Processor usage is expressed as
+     a share of the time available on all processors.
+     */
+    DWORD ProcessorCount;
+
+    /**
+     The order to display processes in.
+     */
+    PS_TOP_SORT SortOrder;
+
+    /**
+     An array of pointers to entries in the current snapshot, in the order
+     they should be displayed.
+     */
+    PPS_TOP_ENTRY *DisplayOrder;
+
+    /**
+     The number of elements allocated in DisplayOrder.
+     */
+    YORI_ALLOC_SIZE_T DisplayOrderAllocated;
+
+    /**
+     The list control displaying processes.
+     */
+    PYORI_WIN_CTRL_HANDLE List;
+
+    /**
+     The label displaying a summary of the system.
+     */
+    PYORI_WIN_CTRL_HANDLE SummaryLabel;
+
+    /**
+     A buffer used to format a row of the list.  The list requests one row
+     at a time, so this buffer is reused for each row.
+     */
+    YORI_STRING RowText;
+
+} PS_TOP_CONTEXT, *PPS_TOP_CONTEXT;
+
+/**
+ Return TRUE if the first entry should be displayed before the second entry
+ in the specified sort order.
+
+ @param First Pointer to the first entry.
+
+ @param Second Pointer to the second entry.
+
+ @param SortOrder The order to sort entries into.
+
+ @return TRUE if First should precede Second, FALSE if not.
+ */
+BOOLEAN
+PsTopIsEntryBefore(
+    __in PPS_TOP_ENTRY First,
+    __in PPS_TOP_ENTRY Second,
+    __in PS_TOP_SORT SortOrder
+    )
+{
+    switch(SortOrder) {
+        case PsTopSortCpu:
+            if (First->CpuPermille != Second->CpuPermille) {
+                return (BOOLEAN)(First->CpuPermille > Second->CpuPermille);
+            }
+            break;
+        case PsTopSortWorkingSet:
+            if (First->ProcessInfo->WorkingSetSize != Second->ProcessInfo->WorkingSetSize) {
+                return (BOOLEAN)(First->ProcessInfo->WorkingSetSize > Second->ProcessInfo->WorkingSetSize);
+            }
+            break;
+        case PsTopSortIo:
+            if (First->IoBytesPerSecond != Second->IoBytesPerSecond) {
+                return (BOOLEAN)(First->IoBytesPerSecond > Second->IoBytesPerSecond);
+            }
+            break;
+        default:
+            break;
+    }
+
+    return (BOOLEAN)(First->ProcessInfo->ProcessId < Second->ProcessInfo->ProcessId);
+}
+
+/**
+ Move an element down a heap until both of its children should follow it.
+
+ @param Array Pointer to the array of entries forming the heap.
+
+ @param Index The index of the element to move.
+
+ @param Count The number of elements in the heap.
+
+ @param SortOrder The order to sort entries into.
+ */
+VOID
+PsTopSiftDown(
+    __inout PPS_TOP_ENTRY *Array,
+    __in YORI_ALLOC_SIZE_T Index,
+    __in YORI_ALLOC_SIZE_T Count,
+    __in PS_TOP_SORT SortOrder
+    )
+{
+    YORI_ALLOC_SIZE_T Child;
+    PPS_TOP_ENTRY Swap;
+
+    while (Index < Count / 2) {
+        Child = Index * 2 + 1;
+        if (Child + 1 < Count && PsTopIsEntryBefore(Array[Child], Array[Child + 1], SortOrder)) {
+            Child++;
+        }
+
+        if (!PsTopIsEntryBefore(Array[Index], Array[Child], SortOrder)) {
+            break;
+        }
+
+        Swap = Array[Index];
+        Array[Index] = Array[Child];
+        Array[Child] = Swap;
+        Index = Child;
+    }
+}
+
+/**
+ Sort an array of entries.  This uses a heap sort so that sorting thousands
+ of processes on every refresh remains cheap.
+
+ @param Array Pointer to the array of entries to sort.
+
+ @param Count The number of elements in the array.
+
+ @param SortOrder The order to sort entries into.
+ */
+VOID
+PsTopSortEntries(
+    __inout PPS_TOP_ENTRY *Array,
+    __in YORI_ALLOC_SIZE_T Count,
+    __in PS_TOP_SORT SortOrder
+    )
+{
+    YORI_ALLOC_SIZE_T Index;
+    PPS_TOP_ENTRY Swap;
+
+    if (Count < 2) {
+        return;
+    }
+
+    for (Index = Count / 2; Index > 0; Index--) {
+        PsTopSiftDown(Array, Index - 1, Count, SortOrder);
+    }
+
+    for (Index = Count - 1; Index > 0; Index--) {
+        Swap = Array[0];
+        Array[0] = Array[Index];
+        Array[Index] = Swap;
+        PsTopSiftDown(Array, 0, Index, SortOrder);
+    }
+}
+
+/**
+ Ensure a snapshot has space for a number of entries, and that the display
+ order array can describe that many entries.
+
+ @param TopContext Pointer to the top context.
+
+ @param Snapshot Pointer to the snapshot.
+
+ @param Count The number of entries required.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+PsTopEnsureEntries(
+    __in PPS_TOP_CONTEXT TopContext,
+    __in PPS_TOP_SNAPSHOT Snapshot,
+    __in YORI_ALLOC_SIZE_T Count
+    )
+{
+    YORI_ALLOC_SIZE_T NewAllocated;
+    PPS_TOP_ENTRY NewEntries;
+    PPS_TOP_ENTRY *NewOrder;
+
+    NewAllocated = Count + Count / 4 + 16;
+
+    if (Snapshot->EntriesAllocated < Count) {
+        if (!YoriLibIsSizeAllocatable(NewAllocated * sizeof(PS_TOP_ENTRY))) {
+            return FALSE;
+        }
+
+        NewEntries = YoriLibMalloc(NewAllocated * sizeof(PS_TOP_ENTRY));
+        if (NewEntries == NULL) {
+            return FALSE;
+        }
+
+        NewOrder = YoriLibMalloc(NewAllocated * sizeof(PPS_TOP_ENTRY));
+        if (NewOrder == NULL) {
+            YoriLibFree(NewEntries);
+            return FALSE;
+        }
+
+        if (Snapshot->Entries != NULL) {
+            YoriLibFree(Snapshot->Entries);
+            YoriLibFree(Snapshot->PidOrder);
+        }
+
+        Snapshot->Entries = NewEntries;
+        Snapshot->PidOrder = NewOrder;
+        Snapshot->EntriesAllocated = NewAllocated;
+        Snapshot->EntryCount = 0;
+    }
+
+    if (TopContext->DisplayOrderAllocated < Count) {
+        NewOrder = YoriLibMalloc(NewAllocated * sizeof(PPS_TOP_ENTRY));
+        if (NewOrder == NULL) {
+            return FALSE;
+        }
+
+        if (TopContext->DisplayOrder != NULL) {
+            YoriLibFree(TopContext->DisplayOrder);
+        }
+
+        TopContext->DisplayOrder = NewOrder;
+        TopContext->DisplayOrderAllocated = NewAllocated;
+    }
+
+    return TRUE;
+}
+
+/**
+ Calculate the changes for each process in the current snapshot compared to
+ the previous snapshot.  Both snapshots are sorted by process ID, so they
+ can be compared in a single pass.
+
+ @param TopContext Pointer to the top context.
+
+ @param Current Pointer to the current snapshot.
+
+ @param Previous Pointer to the previous snapshot, or NULL if no previous
+        snapshot exists.
+ */
+VOID
+PsTopCalculateDeltas(
+    __in PPS_TOP_CONTEXT TopContext,
+    __in PPS_TOP_SNAPSHOT Current,
+    __in_opt PPS_TOP_SNAPSHOT Previous
+    )
+{
+    YORI_ALLOC_SIZE_T CurrentIndex;
+    YORI_ALLOC_SIZE_T PreviousIndex;
+    PPS_TOP_ENTRY Entry;
+    PPS_TOP_ENTRY PreviousEntry;
+    PYORI_SYSTEM_PROCESS_INFORMATION ProcessInfo;
+    LONGLONG Elapsed;
+    LONGLONG ElapsedMs;
+    LONGLONG CpuTime;
+    LONGLONG CpuDelta;
+    DWORDLONG IoDelta;
+    LONGLONG WorkingSetDelta;
+
+    Elapsed = 0;
+    if (Previous != NULL) {
+        Elapsed = Current->Time - Previous->Time;
+    }
+    ElapsedMs = Elapsed / (10 * 1000);
+
+    PreviousIndex = 0;
+    for (CurrentIndex = 0; CurrentIndex < Current->EntryCount; CurrentIndex++) {
+        Entry = Current->PidOrder[CurrentIndex];
+        ProcessInfo = Entry->ProcessInfo;
+
+        Entry->CpuPermille = 0;
+        Entry->IoBytesPerSecond = 0;
+        Entry->WorkingSetDelta = 0;
+
+        if (Previous == NULL || Elapsed <= 0) {
+            continue;
+        }
+
+        PreviousEntry = NULL;
+        while (PreviousIndex < Previous->EntryCount &&
+               Previous->PidOrder[PreviousIndex]->ProcessInfo->ProcessId < ProcessInfo->ProcessId) {
+            PreviousIndex++;
+        }
+
+        if (PreviousIndex < Previous->EntryCount &&
+            Previous->PidOrder[PreviousIndex]->ProcessInfo->ProcessId == ProcessInfo->ProcessId &&
+            Previous->PidOrder[PreviousIndex]->ProcessInfo->CreateTime.QuadPart == ProcessInfo->CreateTime.QuadPart) {
+
+            PreviousEntry = Previous->PidOrder[PreviousIndex];
+        }
+
+        //
+        //  A process that was not present in the previous snapshot is
+        //  treated as having started from nothing.
+        //
+
+        CpuTime = ProcessInfo->KernelTime.QuadPart + ProcessInfo->UserTime.QuadPart;
+        CpuDelta = CpuTime;
+        IoDelta = Entry->IoBytes;
+        WorkingSetDelta = (LONGLONG)ProcessInfo->WorkingSetSize;
+        if (PreviousEntry != NULL) {
+            CpuDelta = CpuTime - (PreviousEntry->ProcessInfo->KernelTime.QuadPart + PreviousEntry->ProcessInfo->UserTime.QuadPart);
+            IoDelta = 0;
+            if (Entry->IoBytes > PreviousEntry->IoBytes) {
+                IoDelta = Entry->IoBytes - PreviousEntry->IoBytes;
+            }
+            WorkingSetDelta = WorkingSetDelta - (LONGLONG)PreviousEntry->ProcessInfo->WorkingSetSize;
+        }
+
+        if (CpuDelta > 0) {
+            CpuDelta = CpuDelta * 1000 / (Elapsed * TopContext->ProcessorCount);
+            if (CpuDelta > 1000) {
+                CpuDelta = 1000;
+            }
+            Entry->CpuPermille = (DWORD)CpuDelta;
+        }
+
+        if (ElapsedMs > 0) {
+            Entry->IoBytesPerSecond = IoDelta * 1000 / (DWORDLONG)ElapsedMs;
+        }
+
+        Entry->WorkingSetDelta = WorkingSetDelta;
+    }
+}
+
+/**
+ Capture a new snapshot of the processes in the system, calculate the
+ changes since the previous snapshot, and sort the result for display.
+
+ @param TopContext Pointer to the top context.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+PsTopRefresh(
+    __in PPS_TOP_CONTEXT TopContext
+    )
+{
+    PPS_TOP_SNAPSHOT Current;
+    PPS_TOP_SNAPSHOT Previous;
+    PYORI_SYSTEM_PROCESS_INFORMATION ProcessInfo;
+    PPS_TOP_ENTRY Entry;
+    DWORD NextSnapshot;
+    YORI_ALLOC_SIZE_T Count;
+    YORI_ALLOC_SIZE_T Index;
+
+    //
+    //  The previous snapshot must remain intact until the deltas have been
+    //  calculated, so populate the other one.  Its buffers are reused from
+    //  two refreshes ago.
+    //
+
+    NextSnapshot = TopContext->CurrentSnapshot;
+    Previous = NULL;
+    if (TopContext->SnapshotsTaken > 0) {
+        Previous = &TopContext->Snapshots[TopContext->CurrentSnapshot];
+        NextSnapshot = 1 - TopContext->CurrentSnapshot;
+    }
+    Current = &TopContext->Snapshots[NextSnapshot];
+
+    if (!YoriLibRefreshSystemProcessList(&Current->Buffer, &Current->BufferSize)) {
+        return FALSE;
+    }
+    Current->Time = YoriLibGetSystemTimeAsInteger();
+
+    Count = 0;
+    ProcessInfo = Current->Buffer;
+    do {
+        Count++;
+        if (ProcessInfo->NextEntryOffset == 0) {
+            break;
+        }
+        ProcessInfo = YoriLibAddToPointer(ProcessInfo, ProcessInfo->NextEntryOffset);
+    } while(TRUE);
+
+    if (!PsTopEnsureEntries(TopContext, Current, Count)) {
+        return FALSE;
+    }
+
+    Index = 0;
+    ProcessInfo = Current->Buffer;
+    do {
+        Entry = &Current->Entries[Index];
+        Entry->ProcessInfo = ProcessInfo;
+        Entry->IoBytes = (DWORDLONG)ProcessInfo->ReadTransferCount.QuadPart +
+                         (DWORDLONG)ProcessInfo->WriteTransferCount.QuadPart +
+                         (DWORDLONG)ProcessInfo->OtherTransferCount.QuadPart;
+        Current->PidOrder[Index] = Entry;
+        Index++;
+        if (ProcessInfo->NextEntryOffset == 0) {
+            break;
+        }
+        ProcessInfo = YoriLibAddToPointer(ProcessInfo, ProcessInfo->NextEntryOffset);
+    } while(TRUE);
+    Current->EntryCount = Count;
+
+    PsTopSortEntries(Current->PidOrder, Count, PsTopSortPid);
+    PsTopCalculateDeltas(TopContext, Current, Previous);
+
+    TopContext->CurrentSnapshot = NextSnapshot;
+    TopContext->SnapshotsTaken++;
+
+    memcpy(TopContext->DisplayOrder, Current->PidOrder, Count * sizeof(PPS_TOP_ENTRY));
+    PsTopSortEntries(TopContext->DisplayOrder, Count, TopContext->SortOrder);
+
+    return TRUE;
+}
+
+/**
+ Format a row of the process list on demand.  Only rows that are visible are
+ requested, so formatting is proportional to the screen size rather than the
+ number of processes.
+
+ @param Ctrl Pointer to the list control.
+
+ @param Index The index of the row to format.
+
+ @param String On successful completion, updated to point to the formatted
+        row.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+PsTopGetRow(
+    __in PYORI_WIN_CTRL_HANDLE Ctrl,
+    __in YORI_ALLOC_SIZE_T Index,
+    __inout PYORI_STRING String
+    )
+{
+    PPS_TOP_CONTEXT TopContext;
+    PPS_TOP_ENTRY Entry;
+    PYORI_SYSTEM_PROCESS_INFORMATION ProcessInfo;
+    YORI_STRING BaseName;
+    YORI_STRING WorkingSetString;
+    YORI_STRING DeltaString;
+    YORI_STRING IoString;
+    TCHAR WorkingSetStringBuffer[6];
+    TCHAR DeltaStringBuffer[6];
+    TCHAR IoStringBuffer[6];
+    LARGE_INTEGER liValue;
+    TCHAR DeltaSign;
+
+    TopContext = YoriWinGetControlContext(YoriWinGetControlParent(Ctrl));
+    if (Index >= TopContext->Snapshots[TopContext->CurrentSnapshot].EntryCount) {
+        return FALSE;
+    }
+
+    Entry = TopContext->DisplayOrder[Index];
+    ProcessInfo = Entry->ProcessInfo;
+
+    YoriLibInitEmptyString(&BaseName);
+    BaseName.StartOfString = ProcessInfo->ImageName;
+    BaseName.LengthInChars = ProcessInfo->ImageNameLengthInBytes / sizeof(WCHAR);
+
+    if (BaseName.LengthInChars == 0 && ProcessInfo->ProcessId == 0) {
+        YoriLibConstantString(&BaseName, _T("Idle"));
+    }
+
+    YoriLibInitEmptyString(&WorkingSetString);
+    WorkingSetString.StartOfString = WorkingSetStringBuffer;
+    WorkingSetString.LengthAllocated = sizeof(WorkingSetStringBuffer)/sizeof(WorkingSetStringBuffer[0]);
+    liValue.QuadPart = ProcessInfo->WorkingSetSize;
+    YoriLibFileSizeToString(&WorkingSetString, &liValue);
+
+    YoriLibInitEmptyString(&DeltaString);
+    DeltaString.StartOfString = DeltaStringBuffer;
+    DeltaString.LengthAllocated = sizeof(DeltaStringBuffer)/sizeof(DeltaStringBuffer[0]);
+    DeltaSign = ' ';
+    liValue.QuadPart = Entry->WorkingSetDelta;
+    if (liValue.QuadPart < 0) {
+        DeltaSign = '-';
+        liValue.QuadPart = -liValue.QuadPart;
+    } else if (liValue.QuadPart > 0) {
+        DeltaSign = '+';
+    }
+    YoriLibFileSizeToString(&DeltaString, &liValue);
+
+    YoriLibInitEmptyString(&IoString);
+    IoString.StartOfString = IoStringBuffer;
+    IoString.LengthAllocated = sizeof(IoStringBuffer)/sizeof(IoStringBuffer[0]);
+    liValue.QuadPart = (LONGLONG)Entry->IoBytesPerSecond;
+    YoriLibFileSizeToString(&IoString, &liValue);
+
+    TopContext->RowText.LengthInChars = YoriLibSPrintfS(TopContext->RowText.StartOfString,
+                                                        TopContext->RowText.LengthAllocated,
+                                                        _T("%-6i | %-6i | %-15y | %3i.%i | %-10y | %c%-9y | %-10y"),
+                                                        ProcessInfo->ProcessId,
+                                                        ProcessInfo->ParentProcessId,
+                                                        &BaseName,
+                                                        Entry->CpuPermille / 10,
+                                                        Entry->CpuPermille % 10,
+                                                        &WorkingSetString,
+                                                        DeltaSign,
+                                                        &DeltaString,
+                                                        &IoString);
+
+    String->StartOfString = TopContext->RowText.StartOfString;
+    String->LengthInChars = TopContext->RowText.LengthInChars;
+    return TRUE;
+}
+
+/**
+ Update the summary line and the process list to reflect the current
+ snapshot.  The active process is retained across the update, even if it
+ has moved within the sort order.
+
+ @param TopContext Pointer to the top context.
+
+ @param ActiveProcessId Specifies the process ID that should be active after
+        the update, or (DWORD_PTR)-1 if no process should be made active.
+ */
+VOID
+PsTopUpdateDisplay(
+    __in PPS_TOP_CONTEXT TopContext,
+    __in DWORD_PTR ActiveProcessId
+    )
+{
+    PPS_TOP_SNAPSHOT Current;
+    YORI_STRING Summary;
+    TCHAR SummaryBuffer[128];
+    YORI_ALLOC_SIZE_T Index;
+    DWORD TotalCpu;
+    LPCTSTR SortName;
+
+    Current = &TopContext->Snapshots[TopContext->CurrentSnapshot];
+
+    TotalCpu = 0;
+    for (Index = 0; Index < Current->EntryCount; Index++) {
+        if (Current->Entries[Index].ProcessInfo->ProcessId != 0) {
+            TotalCpu = TotalCpu + Current->Entries[Index].CpuPermille;
+        }
+    }
+    if (TotalCpu > 1000) {
+        TotalCpu = 1000;
+    }
+
+    switch(TopContext->SortOrder) {
+        case PsTopSortWorkingSet:
+            SortName = _T("working set");
+            break;
+        case PsTopSortIo:
+            SortName = _T("IO");
+            break;
+        case PsTopSortPid:
+            SortName = _T("process ID");
+            break;
+        default:
+            SortName = _T("CPU");
+            break;
+    }
+
+    YoriLibInitEmptyString(&Summary);
+    Summary.StartOfString = SummaryBuffer;
+    Summary.LengthAllocated = sizeof(SummaryBuffer)/sizeof(SummaryBuffer[0]);
+    Summary.LengthInChars = YoriLibSPrintfS(Summary.StartOfString,
+                                            Summary.LengthAllocated,
+                                            _T("Processes: %i  CPU: %i.%i%%  Processors: %i  Sorted by %s"),
+                                            Current->EntryCount,
+                                            TotalCpu / 10,
+                                            TotalCpu % 10,
+                                            TopContext->ProcessorCount,
+                                            SortName);
+    YoriWinLabelSetCaption(TopContext->SummaryLabel, &Summary);
+
+    YoriWinListSetVirtualItemCount(TopContext->List, Current->EntryCount);
+
+    if (ActiveProcessId != (DWORD_PTR)-1) {
+        for (Index = 0; Index < Current->EntryCount; Index++) {
+            if (TopContext->DisplayOrder[Index]->ProcessInfo->ProcessId == ActiveProcessId) {
+                YoriWinListSetActiveOption(TopContext->List, Index);
+                break;
+            }
+        }
+    }
+}
+
+/**
+ Return the process ID of the process that is currently active in the list,
+ so that it can remain active after the list is updated.
+
+ @param TopContext Pointer to the top context.
+
+ @return The process ID of the active process, or (DWORD_PTR)-1 if no
+         process is active.
+ */
+DWORD_PTR
+PsTopGetActiveProcessId(
+    __in PPS_TOP_CONTEXT TopContext
+    )
+{
+    YORI_ALLOC_SIZE_T ActiveIndex;
+
+    if (TopContext->SnapshotsTaken == 0 ||
+        !YoriWinListGetActiveOption(TopContext->List, &ActiveIndex) ||
+        ActiveIndex >= TopContext->Snapshots[TopContext->CurrentSnapshot].EntryCount) {
+
+        return (DWORD_PTR)-1;
+    }
+
+    return TopContext->DisplayOrder[ActiveIndex]->ProcessInfo->ProcessId;
+}
+
+/**
+ A callback invoked periodically to capture a new snapshot and update the
+ display.
+
+ @param WindowHandle Pointer to the window displaying processes.
+ */
+VOID
+PsTopTimer(
+    __in PYORI_WIN_WINDOW_HANDLE WindowHandle
+    )
+{
+    PPS_TOP_CONTEXT TopContext;
+    DWORD_PTR ActiveProcessId;
+
+    TopContext = YoriWinGetControlContext(YoriWinGetCtrlFromWindow(WindowHandle));
+    ActiveProcessId = PsTopGetActiveProcessId(TopContext);
+    if (PsTopRefresh(TopContext)) {
+        PsTopUpdateDisplay(TopContext, ActiveProcessId);
+    }
+}
+
+/**
+ Change the order that processes are displayed in without capturing a new
+ snapshot.
+
+ @param Ctrl Pointer to the button that was clicked.
+
+ @param SortOrder The new order to display processes in.
+ */
+VOID
+PsTopChangeSort(
+    __in PYORI_WIN_CTRL_HANDLE Ctrl,
+    __in PS_TOP_SORT SortOrder
+    )
+{
+    PPS_TOP_CONTEXT TopContext;
+    DWORD_PTR ActiveProcessId;
+
+    TopContext = YoriWinGetControlContext(YoriWinGetControlParent(Ctrl));
+    ActiveProcessId = PsTopGetActiveProcessId(TopContext);
+    TopContext->SortOrder = SortOrder;
+    PsTopSortEntries(TopContext->DisplayOrder,
+                     TopContext->Snapshots[TopContext->CurrentSnapshot].EntryCount,
+                     SortOrder);
+    PsTopUpdateDisplay(TopContext, ActiveProcessId);
+}
+
+/**
+ A callback invoked when the CPU sort button is clicked.
+
+ @param Ctrl Pointer to the button that was clicked.
+ */
+VOID
+PsTopCpuButtonClicked(
+    __in PYORI_WIN_CTRL_HANDLE Ctrl
+    )
+{
+    PsTopChangeSort(Ctrl, PsTopSortCpu);
+}
+
+/**
+ A callback invoked when the memory sort button is clicked.
+
+ @param Ctrl Pointer to the button that was clicked.
+ */
+VOID
+PsTopMemoryButtonClicked(
+    __in PYORI_WIN_CTRL_HANDLE Ctrl
+    )
+{
+    PsTopChangeSort(Ctrl, PsTopSortWorkingSet);
+}
+
+/**
+ A callback invoked when the IO sort button is clicked.
+
+ @param Ctrl Pointer to the button that was clicked.
+ */
+VOID
+PsTopIoButtonClicked(
+    __in PYORI_WIN_CTRL_HANDLE Ctrl
+    )
+{
+    PsTopChangeSort(Ctrl, PsTopSortIo);
+}
+
+/**
+ A callback invoked when the process ID sort button is clicked.
+
+ @param Ctrl Pointer to the button that was clicked.
+ */
+VOID
+PsTopPidButtonClicked(
+    __in PYORI_WIN_CTRL_HANDLE Ctrl
+    )
+{
+    PsTopChangeSort(Ctrl, PsTopSortPid);
+}
+
+/**
+ A callback invoked when the exit button is clicked.
+
+ @param Ctrl Pointer to the button that was clicked.
+ */
+VOID
+PsTopExitButtonClicked(
+    __in PYORI_WIN_CTRL_HANDLE Ctrl
+    )
+{
+    YoriWinCloseWindow(YoriWinGetControlParent(Ctrl), TRUE);
+}
+
+/**
+ Free all memory associated with the top context.
+
+ @param TopContext Pointer to the top context.
+ */
+VOID
+PsTopCleanupContext(
+    __in PPS_TOP_CONTEXT TopContext
+    )
+{
+    DWORD Index;
+
+    for (Index = 0; Index < sizeof(TopContext->Snapshots)/sizeof(TopContext->Snapshots[0]); Index++) {
+        if (TopContext->Snapshots[Index].Buffer != NULL) {
+            YoriLibFree(TopContext->Snapshots[Index].Buffer);
+        }
+        if (TopContext->Snapshots[Index].Entries != NULL) {
+            YoriLibFree(TopContext->Snapshots[Index].Entries);
+            YoriLibFree(TopContext->Snapshots[Index].PidOrder);
+        }
+    }
+
+    if (TopContext->DisplayOrder != NULL) {
+        YoriLibFree(TopContext->DisplayOrder);
+    }
+
+    YoriLibFreeStringContents(&TopContext->RowText);
+}
+
+/**
+ Display a continuously refreshing list of processes, including the processor
+ usage, working set change and IO rate of each process since the previous
+ refresh.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+PsDisplayTop(VOID)
+{
+    PYORI_WIN_WINDOW_MANAGER_HANDLE WinMgr;
+    PYORI_WIN_WINDOW_HANDLE Parent;
+    PYORI_WIN_CTRL_HANDLE Ctrl;
+    PS_TOP_CONTEXT TopContext;
+    SYSTEM_INFO SystemInfo;
+    SMALL_RECT CtrlRect;
+    COORD WindowSize;
+    YORI_STRING Caption;
+    WORD ButtonWidth;
+    WORD Index;
+    DWORD_PTR Result;
+    BOOL Success;
+    LPCTSTR ButtonCaptions[] = {
+        _T("&Cpu"),
+        _T("&Memory"),
+        _T("&Io"),
+        _T("&Pid"),
+        _T("E&xit")
+    };
+    PYORI_WIN_NOTIFY ButtonCallbacks[] = {
+        PsTopCpuButtonClicked,
+        PsTopMemoryButtonClicked,
+        PsTopIoButtonClicked,
+        PsTopPidButtonClicked,
+        PsTopExitButtonClicked
+    };
+
+    ZeroMemory(&TopContext, sizeof(TopContext));
+    Success = FALSE;
+    WinMgr = NULL;
+    Parent = NULL;
+
+    GetSystemInfo(&SystemInfo);
+    TopContext.ProcessorCount = SystemInfo.dwNumberOfProcessors;
+    if (TopContext.ProcessorCount == 0) {
+        TopContext.ProcessorCount = 1;
+    }
+
+    if (!YoriLibAllocateString(&TopContext.RowText, PS_TOP_ROW_LENGTH)) {
+        goto Exit;
+    }
+
+    if (!PsTopRefresh(&TopContext)) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("yps: Unable to load system process list\n"));
+        goto Exit;
+    }
+
+    if (!YoriWinOpenWindowManager(FALSE, YoriWinColorTableDefault, &WinMgr)) {
+        WinMgr = NULL;
+        goto Exit;
+    }
+
+    YoriWinGetWinMgrDimensions(WinMgr, &WindowSize);
+    if (WindowSize.X < 60 || WindowSize.Y < 12) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("yps: window size too small\n"));
+        goto Exit;
+    }
+
+    if (!YoriWinCreateWindow(WinMgr, WindowSize.X, WindowSize.Y, WindowSize.X, WindowSize.Y, 0, NULL, &Parent)) {
+        Parent = NULL;
+        goto Exit;
+    }
+
+    YoriWinGetClientSize(Parent, &WindowSize);
+
+    CtrlRect.Left = 1;
+    CtrlRect.Top = 0;
+    CtrlRect.Right = (SHORT)(WindowSize.X - 2);
+    CtrlRect.Bottom = 0;
+
+    YoriLibInitEmptyString(&Caption);
+    TopContext.SummaryLabel = YoriWinLabelCreate(Parent, &CtrlRect, &Caption, 0);
+    if (TopContext.SummaryLabel == NULL) {
+        goto Exit;
+    }
+
+    CtrlRect.Top = 1;
+    CtrlRect.Bottom = 1;
+    CtrlRect.Left = 2;
+
+    YoriLibConstantString(&Caption, _T("Pid    | Parent | Process         |  CPU% | WorkingSet | WS Change  | IO/sec"));
+    Ctrl = YoriWinLabelCreate(Parent, &CtrlRect, &Caption, 0);
+    if (Ctrl == NULL) {
+        goto Exit;
+    }
+
+    CtrlRect.Left = 0;
+    CtrlRect.Top = 2;
+    CtrlRect.Right = (SHORT)(WindowSize.X - 1);
+    CtrlRect.Bottom = (SHORT)(WindowSize.Y - 4);
+
+    TopContext.List = YoriWinListCreate(Parent, &CtrlRect, YORI_WIN_LIST_STYLE_VSCROLLBAR);
+    if (TopContext.List == NULL) {
+        goto Exit;
+    }
+
+    YoriWinSetControlContext(YoriWinGetCtrlFromWindow(Parent), &TopContext);
+
+    if (!YoriWinListSetVirtualItems(TopContext.List, PsTopGetRow, 0)) {
+        goto Exit;
+    }
+
+    ButtonWidth = (WORD)(sizeof("Memory") - 1 + 2);
+    CtrlRect.Top = (SHORT)(WindowSize.Y - 3);
+    CtrlRect.Bottom = (SHORT)(CtrlRect.Top + 2);
+
+    for (Index = 0; Index < sizeof(ButtonCaptions)/sizeof(ButtonCaptions[0]); Index++) {
+        DWORD Style;
+
+        Style = YORI_WIN_BUTTON_STYLE_DISABLE_FOCUS;
+        if (Index == sizeof(ButtonCaptions)/sizeof(ButtonCaptions[0]) - 1) {
+            Style = Style | YORI_WIN_BUTTON_STYLE_CANCEL;
+        }
+
+        CtrlRect.Left = (SHORT)(1 + Index * (ButtonWidth + 3));
+        CtrlRect.Right = (SHORT)(CtrlRect.Left + ButtonWidth + 1);
+
+        YoriLibConstantString(&Caption, ButtonCaptions[Index]);
+        Ctrl = YoriWinButtonCreate(Parent, &CtrlRect, &Caption, Style, ButtonCallbacks[Index]);
+        if (Ctrl == NULL) {
+            goto Exit;
+        }
+    }
+
+    PsTopUpdateDisplay(&TopContext, (DWORD_PTR)-1);
+
+    if (!YoriWinSetWindowTimerCallback(Parent, PS_TOP_REFRESH_INTERVAL, PsTopTimer)) {
+        goto Exit;
+    }
+
+    Result = FALSE;
+    if (YoriWinProcessInputForWindow(Parent, &Result)) {
+        Success = TRUE;
+    }
+
+Exit:
+
+    if (Parent != NULL) {
+        YoriWinDestroyWindow(Parent);
+    }
+
+    if (WinMgr != NULL) {
+        YoriWinCloseWindowManager(WinMgr);
+    }
+
+    PsTopCleanupContext(&TopContext);
+    return Success;
+}
+
 #ifdef YORI_BUILTIN
 /**
  The main entrypoint for the ps builtin command.
@@ -534,10 +1565,12 @@ ENTRYPOINT(
     YORI_ALLOC_SIZE_T StartArg = 0;
     YORI_STRING Arg;
     BOOLEAN DisplayAll;
+    BOOLEAN DisplayTop;
     PS_CONTEXT PsContext;
 
     ZeroMemory(&PsContext, sizeof(PsContext));
     DisplayAll = FALSE;
+    DisplayTop = FALSE;
 
     for (i = 1; i < ArgC; i++) {
 
@@ -561,6 +1594,9 @@ ENTRYPOINT(
             } else if (YoriLibCompareStringLitIns(&Arg, _T("l")) == 0) {
                 PsContext.DisplayMemory = TRUE;
                 ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("t")) == 0) {
+                DisplayTop = TRUE;
+                ArgumentUnderstood = TRUE;
             }
         } else {
             ArgumentUnderstood = TRUE;
@@ -573,6 +1609,13 @@ ENTRYPOINT(
         }
     }
 
+    if (DisplayTop) {
+        if (!PsDisplayTop()) {
+            return EXIT_FAILURE;
+        }
+        return EXIT_SUCCESS;
+    }
+
     PsContext.Now.QuadPart = YoriLibGetSystemTimeAsInteger();
 
     if (DisplayAll) {
@@ -62,26 +62,10 @@ RegeditHelp(VOID)
     return TRUE;
 }
 
-/**
- A structure describing the well known root keys.
- */
-typedef struct _REGEDIT_KEY_NAME_PAIR {
-
-    /**
-     The string description of the root key name.
-     */
-    YORI_STRING KeyName;
-
-    /**
-     The pseudo handle to the root key.
-     */
-    HKEY KeyHandle;
-} REGEDIT_KEY_NAME_PAIR, *PREGEDIT_KEY_NAME_PAIR;
-
 /**
  An array of well known root keys.
  */
-CONST REGEDIT_KEY_NAME_PAIR RegeditRootKeys[] = {
+CONST REGEDIT_KEY_NAME_PAIR RegeditRootKeys[REGEDIT_ROOT_KEY_COUNT] = {
     {YORILIB_CONSTANT_STRING(_T("HKEY_CLASSES_ROOT")), HKEY_CLASSES_ROOT},
     {YORILIB_CONSTANT_STRING(_T("HKEY_CURRENT_USER")), HKEY_CURRENT_USER},
     {YORILIB_CONSTANT_STRING(_T("HKEY_LOCAL_MACHINE")), HKEY_LOCAL_MACHINE},
@@ -162,6 +146,255 @@ RegeditValueListSelectionChanged(
 }
 
 
+/**
+ Free the names within a name list and reinitialize it to be empty.
+
+ @param NameList Pointer to the name list to free.
+ */
+VOID
+RegeditFreeNameList(
+    __inout PREGEDIT_NAME_LIST NameList
+    )
+{
+    if (NameList->Names != NULL) {
+        YoriLibFree(NameList->Names);
+        NameList->Names = NULL;
+    }
+    NameList->Count = 0;
+    YoriLibFreeStringContents(&NameList->Buffer);
+}
+
+/**
+ Enumerate the names of subkeys or values within a registry key into a name
+ list and sort them.  All names are packed into a single buffer, so a key
+ with a very large number of subkeys requires two allocations rather than
+ one per name.
+
+ @param Key The registry key to enumerate.
+
+ @param EnumerateValues TRUE to enumerate value names, FALSE to enumerate
+        subkey names.
+
+ @param Count The number of names reported by RegQueryInfoKey.  If more
+        names exist by the time they are enumerated, they are ignored.
+
+ @param MaxNameLength The length of the longest name reported by
+        RegQueryInfoKey, in characters.
+
+ @param NameList On successful completion, populated with the sorted names.
+        The caller should free this with @ref RegeditFreeNameList .
+
+ @return A Win32 error code, ERROR_SUCCESS to indicate success.
+ */
+DWORD
+RegeditEnumerateNames(
+    __in HKEY Key,
+    __in BOOLEAN EnumerateValues,
+    __in DWORD Count,
+    __in DWORD MaxNameLength,
+    __out PREGEDIT_NAME_LIST NameList
+    )
+{
+    YORI_STRING Name;
+    YORI_ALLOC_SIZE_T Index;
+    YORI_ALLOC_SIZE_T FixupIndex;
+    YORI_ALLOC_SIZE_T BufferUsed;
+    DWORDLONG BytesRequired;
+    DWORDLONG NewLength;
+    LPTSTR OldBase;
+    DWORD NameSize;
+    DWORD Err;
+
+    NameList->Names = NULL;
+    NameList->Count = 0;
+    YoriLibInitEmptyString(&NameList->Buffer);
+
+    if (Count == 0) {
+        return ERROR_SUCCESS;
+    }
+
+    BytesRequired = Count;
+    BytesRequired = BytesRequired * sizeof(YORI_STRING);
+    if (!YoriLibIsSizeAllocatable(Count) ||
+        !YoriLibIsSizeAllocatable(BytesRequired) ||
+        !YoriLibIsSizeAllocatable(MaxNameLength + 1)) {
+
+        return ERROR_NOT_ENOUGH_MEMORY;
+    }
+
+    NameList->Names = YoriLibMalloc((YORI_ALLOC_SIZE_T)BytesRequired);
+    if (NameList->Names == NULL) {
+        return ERROR_NOT_ENOUGH_MEMORY;
+    }
+
+    if (!YoriLibAllocateString(&Name, (YORI_ALLOC_SIZE_T)(MaxNameLength + 1))) {
+        RegeditFreeNameList(NameList);
+        return ERROR_NOT_ENOUGH_MEMORY;
+    }
+
+    //
+    //  Most names are far shorter than the longest one, so start with a
+    //  guess and grow the buffer as needed.
+    //
+
+    NewLength = Count;
+    NewLength = NewLength * 16 + MaxNameLength;
+    if (!YoriLibIsSizeAllocatable(NewLength) ||
+        !YoriLibAllocateString(&NameList->Buffer, (YORI_ALLOC_SIZE_T)NewLength)) {
+
+        YoriLibFreeStringContents(&Name);
+        RegeditFreeNameList(NameList);
+        return ERROR_NOT_ENOUGH_MEMORY;
+    }
+
+    Err = ERROR_SUCCESS;
+    BufferUsed = 0;
+    Index = 0;
+    while (Index < Count) {
+        NameSize = Name.LengthAllocated;
+        if (EnumerateValues) {
+            Err = DllAdvApi32.pRegEnumValueW(Key, Index, Name.StartOfString, &NameSize, NULL, NULL, NULL, NULL);
+        } else {
+            Err = DllAdvApi32.pRegEnumKeyExW(Key, Index, Name.StartOfString, &NameSize, NULL, NULL, NULL, NULL);
+        }
+
+        //
+        //  If a longer name was added since the key was queried, grow the
+        //  buffer and try again.
+        //
+
+        if (Err == ERROR_MORE_DATA) {
+            NewLength = Name.LengthAllocated;
+            NewLength = NewLength * 2;
+            if (!YoriLibIsSizeAllocatable(NewLength)) {
+                Err = ERROR_NOT_ENOUGH_MEMORY;
+                break;
+            }
+            YoriLibFreeStringContents(&Name);
+            if (!YoriLibAllocateString(&Name, (YORI_ALLOC_SIZE_T)NewLength)) {
+                Err = ERROR_NOT_ENOUGH_MEMORY;
+                break;
+            }
+            continue;
+        }
+
+        if (Err == ERROR_NO_MORE_ITEMS) {
+            Err = ERROR_SUCCESS;
+            break;
+        } else if (Err != ERROR_SUCCESS) {
+            break;
+        }
+
+        if (NameSize > (DWORD)(NameList->Buffer.LengthAllocated - BufferUsed)) {
+            NewLength = NameList->Buffer.LengthAllocated;
+            NewLength = NewLength * 2 + NameSize;
+            if (!YoriLibIsSizeAllocatable(NewLength)) {
+                Err = ERROR_NOT_ENOUGH_MEMORY;
+                break;
+            }
+
+            OldBase = NameList->Buffer.StartOfString;
+            if (!YoriLibReallocString(&NameList->Buffer, (YORI_ALLOC_SIZE_T)NewLength)) {
+                Err = ERROR_NOT_ENOUGH_MEMORY;
+                break;
+            }
+
+            for (FixupIndex = 0; FixupIndex < Index; FixupIndex++) {
+                NameList->Names[FixupIndex].StartOfString = NameList->Buffer.StartOfString + (NameList->Names[FixupIndex].StartOfString - OldBase);
+            }
+        }
+
+        YoriLibInitEmptyString(&NameList->Names[Index]);
+        NameList->Names[Index].StartOfString = NameList->Buffer.StartOfString + BufferUsed;
+        NameList->Names[Index].LengthInChars = (YORI_ALLOC_SIZE_T)NameSize;
+        memcpy(NameList->Names[Index].StartOfString, Name.StartOfString, NameSize * sizeof(TCHAR));
+        BufferUsed = BufferUsed + (YORI_ALLOC_SIZE_T)NameSize;
+        Index++;
+    }
+
+    YoriLibFreeStringContents(&Name);
+
+    if (Err != ERROR_SUCCESS) {
+        RegeditFreeNameList(NameList);
+        return Err;
+    }
+
+    NameList->Buffer.LengthInChars = BufferUsed;
+    NameList->Count = Index;
+    YoriLibSortStringArray(NameList->Names, NameList->Count);
+    return ERROR_SUCCESS;
+}
+
+/**
+ Return the text of an item in the key list.  The first item allows the user
+ to navigate to the parent key, and the remainder are subkey names owned by
+ the regedit context.
+
+ @param Ctrl Pointer to the key list control.
+
+ @param Index The index of the item within the list.
+
+ @param String On successful completion, updated to refer to the item text.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOLEAN
+RegeditGetKeyListItem(
+    __in PYORI_WIN_CTRL_HANDLE Ctrl,
+    __in YORI_ALLOC_SIZE_T Index,
+    __inout PYORI_STRING String
+    )
+{
+    PREGEDIT_CONTEXT RegeditContext;
+
+    RegeditContext = YoriWinGetControlContext(YoriWinGetControlParent(Ctrl));
+
+    if (Index == 0) {
+        YoriLibConstantString(String, _T(".."));
+        return TRUE;
+    }
+
+    if (Index - 1 >= RegeditContext->SubkeyNames.Count) {
+        return FALSE;
+    }
+
+    String->StartOfString = RegeditContext->SubkeyNames.Names[Index - 1].StartOfString;
+    String->LengthInChars = RegeditContext->SubkeyNames.Names[Index - 1].LengthInChars;
+    return TRUE;
+}
+
+/**
+ Return the text of an item in the value list.  Value names are owned by the
+ regedit context.
+
+ @param Ctrl Pointer to the value list control.
+
+ @param Index The index of the item within the list.
+
+ @param String On successful completion, updated to refer to the item text.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOLEAN
+RegeditGetValueListItem(
+    __in PYORI_WIN_CTRL_HANDLE Ctrl,
+    __in YORI_ALLOC_SIZE_T Index,
+    __inout PYORI_STRING String
+    )
+{
+    PREGEDIT_CONTEXT RegeditContext;
+
+    RegeditContext = YoriWinGetControlContext(YoriWinGetControlParent(Ctrl));
+
+    if (Index >= RegeditContext->ValueNames.Count) {
+        return FALSE;
+    }
+
+    String->StartOfString = RegeditContext->ValueNames.Names[Index].StartOfString;
+    String->LengthInChars = RegeditContext->ValueNames.Names[Index].LengthInChars;
+    return TRUE;
+}
+
 /**
  Open the current registry key and populate the lists containing the subkeys
  and values within the currently active key.
@@ -196,18 +429,16 @@ RegeditPopulateKeyValueList(
 {
     YORI_ALLOC_SIZE_T Index;
     PYORI_WIN_CTRL_HANDLE Parent;
-    YORI_ALLOC_SIZE_T ArrayCount;
-    DWORD BytesRequired;
-    YORI_ALLOC_SIZE_T ArrayElementSize;
     DWORD SubKeyCount;
     DWORD ValueCount;
     DWORD MaxValueNameLength;
     DWORD MaxSubKeyLength;
-    PYORI_STRING StringArray;
 
     Parent = YoriWinGetControlParent(KeyListCtrl);
     YoriWinListClearAllItems(KeyListCtrl);
     YoriWinListClearAllItems(ValueListCtrl);
+    RegeditFreeNameList(&RegeditContext->SubkeyNames);
+    RegeditFreeNameList(&RegeditContext->ValueNames);
 
     if (RegeditContext->TreeDepth == 0) {
         for (Index = 0; Index < sizeof(RegeditRootKeys)/sizeof(RegeditRootKeys[0]); Index++) {
@@ -217,7 +448,7 @@ RegeditPopulateKeyValueList(
         YORI_STRING Text;
         DWORD Err;
         YORI_ALLOC_SIZE_T SelectIndex;
-        DWORD ValueSize;
+        YORI_ALLOC_SIZE_T Count;
         DWORD MaxClassLength;
         DWORD MaxValueData;
         DWORD SecurityDescriptorLength;
@@ -225,8 +456,13 @@ RegeditPopulateKeyValueList(
         HKEY Key;
         FILETIME LastWriteTime;
 
-        YoriLibConstantString(&Text, _T(".."));
-        YoriWinListAddItems(KeyListCtrl, &Text, 1);
+        //
+        //  Subkeys and values are displayed from names owned by the regedit
+        //  context rather than copied into each list.  Until subkeys are
+        //  enumerated, the key list just allows navigating to the parent.
+        //
+
+        YoriWinListSetVirtualItems(KeyListCtrl, RegeditGetKeyListItem, 1);
 
         Err = DllAdvApi32.pRegOpenKeyExW(RegeditContext->ActiveRootKey, RegeditContext->Subkey.StartOfString, 0, KEY_READ, &Key);
         if (Err != ERROR_SUCCESS) {
@@ -289,93 +525,21 @@ RegeditPopulateKeyValueList(
         }
 
         //
-        //  Use a single array both for keys and values.  This means the
-        //  allocations need to be for the larger of the two.
-        //
-
-        if (!YoriLibIsSizeAllocatable(SubKeyCount) ||
-            !YoriLibIsSizeAllocatable(ValueCount) ||
-            !YoriLibIsSizeAllocatable(MaxSubKeyLength + 1) ||
-            !YoriLibIsSizeAllocatable(MaxValueNameLength + 1)) {
-
-            RegeditDisplayWin32Error(Parent, ERROR_NOT_ENOUGH_MEMORY);
-            DllAdvApi32.pRegCloseKey(Key);
-            return;
-        }
-        ArrayCount = (YORI_ALLOC_SIZE_T)SubKeyCount;
-        if (ValueCount > ArrayCount) {
-            ArrayCount = (YORI_ALLOC_SIZE_T)ValueCount;
-        }
-
-        ArrayElementSize = (YORI_ALLOC_SIZE_T)(MaxSubKeyLength + 1);
-        if (MaxValueNameLength + 1 > ArrayElementSize) {
-            ArrayElementSize = (YORI_ALLOC_SIZE_T)(MaxValueNameLength + 1);
-        }
-
-        BytesRequired = ArrayCount;
-        BytesRequired = BytesRequired * sizeof(YORI_STRING);
-        if (!YoriLibIsSizeAllocatable(BytesRequired)) {
-            RegeditDisplayWin32Error(Parent, ERROR_NOT_ENOUGH_MEMORY);
-            DllAdvApi32.pRegCloseKey(Key);
-            return;
-        }
-
-        StringArray = YoriLibMalloc((YORI_ALLOC_SIZE_T)BytesRequired);
-        if (StringArray == NULL) {
-            RegeditDisplayWin32Error(Parent, GetLastError());
-            DllAdvApi32.pRegCloseKey(Key);
-            return;
-        }
-
-        for (Index = 0; Index < ArrayCount; Index++) {
-            YoriLibInitEmptyString(&StringArray[Index]);
-        }
-
-        //
-        //  Enumerate keys
-        //
-
-        for (Index = 0; Index < SubKeyCount; Index++) {
-            if (!YoriLibAllocateString(&StringArray[Index], ArrayElementSize)) {
-                Err = ERROR_OUTOFMEMORY;
-                break;
-            }
-            ValueSize = ArrayElementSize;
-            Err = DllAdvApi32.pRegEnumKeyExW(Key, Index, StringArray[Index].StartOfString, &ValueSize, NULL, NULL, NULL, &LastWriteTime);
-
-            //
-            //  MSFIX Possibly reallocate
-            //
-
-            if (Err == ERROR_NO_MORE_ITEMS) {
-                Err = ERROR_SUCCESS;
-                break;
-            } else if (Err != ERROR_SUCCESS) {
-                break;
-            }
-
-            if (!YoriLibIsSizeAllocatable(ValueSize)) {
-                Err = ERROR_NOT_ENOUGH_MEMORY;
-                break;
-            }
-
-            StringArray[Index].LengthInChars = (YORI_ALLOC_SIZE_T)ValueSize;
-        }
-
-        //
-        //  If it failed, tell the user.  Otherwise, sort, and add them to the
-        //  list.  If an item should be selected, find the index of a matching
-        //  string or the first item to be greater than it, and select that.
+        //  Enumerate keys.  If it failed, tell the user.  Otherwise,
+        //  display them.  If an item should be selected, find the index of
+        //  a matching string or the first item to be greater than it, and
+        //  select that.
         //
 
+        Err = RegeditEnumerateNames(Key, FALSE, SubKeyCount, MaxSubKeyLength, &RegeditContext->SubkeyNames);
         if (Err != ERROR_SUCCESS) {
             RegeditDisplayWin32Error(Parent, Err);
-        } else if (Index > 0) {
-            YoriLibSortStringArray(StringArray, Index);
-            YoriWinListAddItems(KeyListCtrl, StringArray, Index);
+        } else if (RegeditContext->SubkeyNames.Count > 0) {
+            Count = RegeditContext->SubkeyNames.Count;
+            YoriWinListSetVirtualItemCount(KeyListCtrl, Count + 1);
             if (SelectKey != NULL) {
-                for (SelectIndex = 0; SelectIndex < Index; SelectIndex++) {
-                    if (YoriLibCompareStringIns(&StringArray[SelectIndex], SelectKey) >= 0) {
+                for (SelectIndex = 0; SelectIndex < Count; SelectIndex++) {
+                    if (YoriLibCompareStringIns(&RegeditContext->SubkeyNames.Names[SelectIndex], SelectKey) >= 0) {
                         break;
                     }
                 }
@@ -386,71 +550,37 @@ RegeditPopulateKeyValueList(
                 //  beyond the final element.
                 //
 
-                if (SelectIndex < Index) {
+                if (SelectIndex < Count) {
                     SelectIndex++;
                 }
                 YoriWinListSetActiveOption(KeyListCtrl, SelectIndex);
             }
         }
 
-        Err = ERROR_SUCCESS;
-
         //
         //  Collect values, sort, find item to select, etc.
         //
 
-        for (Index = 0; Index < ValueCount; Index++) {
-            if (StringArray[Index].LengthAllocated == 0) {
-                if (!YoriLibAllocateString(&StringArray[Index], (YORI_ALLOC_SIZE_T)(MaxValueNameLength + 1))) {
-                    Err = ERROR_OUTOFMEMORY;
-                    break;
-                }
-            }
-            ValueSize = StringArray[Index].LengthAllocated;
-            Err = DllAdvApi32.pRegEnumValueW(Key, Index, StringArray[Index].StartOfString, &ValueSize, NULL, NULL, NULL, NULL);
-
-            //
-            //  MSFIX Possibly reallocate
-            //
-            if (Err == ERROR_NO_MORE_ITEMS) {
-                Err = ERROR_SUCCESS;
-                break;
-            } else if (Err != ERROR_SUCCESS) {
-                break;
-            }
-
-            if (!YoriLibIsSizeAllocatable(ValueSize)) {
-                Err = ERROR_NOT_ENOUGH_MEMORY;
-                break;
-            }
-
-            StringArray[Index].LengthInChars = (YORI_ALLOC_SIZE_T)ValueSize;
-        }
-
+        Err = RegeditEnumerateNames(Key, TRUE, ValueCount, MaxValueNameLength, &RegeditContext->ValueNames);
         if (Err != ERROR_SUCCESS) {
             RegeditDisplayWin32Error(Parent, Err);
-        } else {
-            YoriLibSortStringArray(StringArray, Index);
-            YoriWinListAddItems(ValueListCtrl, StringArray, Index);
+        } else if (RegeditContext->ValueNames.Count > 0) {
+            Count = RegeditContext->ValueNames.Count;
+            YoriWinListSetVirtualItems(ValueListCtrl, RegeditGetValueListItem, Count);
             if (SelectValue != NULL) {
-                for (SelectIndex = 0; SelectIndex < Index; SelectIndex++) {
-                    if (YoriLibCompareStringIns(&StringArray[SelectIndex], SelectValue) >= 0) {
+                for (SelectIndex = 0; SelectIndex < Count; SelectIndex++) {
+                    if (YoriLibCompareStringIns(&RegeditContext->ValueNames.Names[SelectIndex], SelectValue) >= 0) {
                         break;
                     }
                 }
 
-                if (SelectIndex == Index) {
+                if (SelectIndex == Count) {
                     SelectIndex--;
                 }
                 YoriWinListSetActiveOption(ValueListCtrl, SelectIndex);
             }
         }
 
-        for (Index = 0; Index < ArrayCount; Index++) {
-            YoriLibFreeStringContents(&StringArray[Index]);
-        }
-        YoriLibFree(StringArray);
-
         DllAdvApi32.pRegCloseKey(Key);
     }
 }
@@ -887,6 +1017,53 @@ RegeditEditSelectedValue(
     YoriWinListSetActiveOption(ValueList, SelectedValueIndex);
 }
 
+/**
+ Update the caption above the key list to display the currently active key.
+
+ @param RegeditContext Pointer to the global registry editor context.
+
+ @param Parent Pointer to the main window.
+ */
+VOID
+RegeditUpdateKeyCaption(
+    __in PREGEDIT_CONTEXT RegeditContext,
+    __in PYORI_WIN_CTRL_HANDLE Parent
+    )
+{
+    PYORI_WIN_CTRL_HANDLE KeyCaption;
+    PCYORI_STRING RootString;
+    YORI_STRING String;
+    DWORD Index;
+
+    KeyCaption = YoriWinFindControlById(Parent, RegeditControlKeyName);
+    ASSERT(KeyCaption != NULL);
+    __analysis_assume(KeyCaption != NULL);
+
+    if (RegeditContext->TreeDepth > 0) {
+
+        RootString = NULL;
+        for (Index = 0; Index < sizeof(RegeditRootKeys)/sizeof(RegeditRootKeys[0]); Index++) {
+            if (RegeditContext->ActiveRootKey == RegeditRootKeys[Index].KeyHandle) {
+                RootString = &RegeditRootKeys[Index].KeyName;
+            }
+        }
+
+        ASSERT(RootString != NULL);
+        __analysis_assume(RootString != NULL);
+
+        if (YoriLibAllocateString(&String, RootString->LengthInChars + 1 + RegeditContext->Subkey.LengthInChars + 1)) {
+            if (RegeditContext->TreeDepth == 1) {
+                YoriLibYPrintf(&String, _T("%y"), RootString);
+            } else {
+                YoriLibYPrintf(&String, _T("%y\\%y"), RootString, &RegeditContext->Subkey);
+            }
+
+            YoriWinLabelSetCaption(KeyCaption, &String);
+            YoriLibFreeStringContents(&String);
+        }
+    }
+}
+
 /**
  Find the currently selected key within the key list control, and navigate to
  it.  This may be navigating to a subkey, or a parent key, or the magic root
@@ -912,13 +1089,7 @@ RegeditNavigateToSelectedKey(
     __in YORI_ALLOC_SIZE_T SelectedKeyIndex
     )
 {
-    PYORI_WIN_CTRL_HANDLE KeyCaption;
     YORI_STRING String;
-    YORI_STRING NewCaption;
-
-    KeyCaption = YoriWinFindControlById(Parent, RegeditControlKeyName);
-    ASSERT(KeyCaption != NULL);
-    __analysis_assume(KeyCaption != NULL);
 
     YoriLibInitEmptyString(&String);
     YoriWinListGetItemText(KeyList, SelectedKeyIndex, &String);
@@ -961,33 +1132,81 @@ RegeditNavigateToSelectedKey(
     }
     YoriLibFreeStringContents(&String);
 
-    YoriLibInitEmptyString(&NewCaption);
-    if (RegeditContext->TreeDepth > 0) {
-        PCYORI_STRING RootString;
-        DWORD Index;
+    RegeditUpdateKeyCaption(RegeditContext, Parent);
 
-        RootString = NULL;
-        for (Index = 0; Index < sizeof(RegeditRootKeys)/sizeof(RegeditRootKeys[0]); Index++) {
-            if (RegeditContext->ActiveRootKey == RegeditRootKeys[Index].KeyHandle) {
-                RootString = &RegeditRootKeys[Index].KeyName;
-            }
-        }
+    RegeditPopulateKeyValueList(RegeditContext, KeyList, ValueList, NULL, NULL);
+}
 
-        ASSERT(RootString != NULL);
+/**
+ Navigate to a specified key, and optionally select a value within it.
 
-        if (YoriLibAllocateString(&String, RootString->LengthInChars + 1 + RegeditContext->Subkey.LengthInChars + 1)) {
-            if (RegeditContext->TreeDepth == 1) {
-                YoriLibYPrintf(&String, _T("%y"), RootString);
-            } else {
-                YoriLibYPrintf(&String, _T("%y\\%y"), RootString, &RegeditContext->Subkey);
-            }
+ @param RegeditContext Pointer to the global registry editor context.
 
-            YoriWinLabelSetCaption(KeyCaption, &String);
-            YoriLibFreeStringContents(&String);
+ @param Parent Pointer to the main window.
+
+ @param RootKey The root key containing the key to navigate to.
+
+ @param Subkey Pointer to the path of the key to navigate to, relative to
+        RootKey.  This may be empty to navigate to the root key.
+
+ @param SelectValue Optionally points to the name of a value to select
+        within the key.
+ */
+VOID
+RegeditNavigateToKey(
+    __in PREGEDIT_CONTEXT RegeditContext,
+    __in PYORI_WIN_CTRL_HANDLE Parent,
+    __in HKEY RootKey,
+    __in PYORI_STRING Subkey,
+    __in_opt PYORI_STRING SelectValue
+    )
+{
+    PYORI_WIN_CTRL_HANDLE KeyList;
+    PYORI_WIN_CTRL_HANDLE ValueList;
+    YORI_STRING NewSubkey;
+    YORI_ALLOC_SIZE_T Index;
+
+    KeyList = YoriWinFindControlById(Parent, RegeditControlKeyList);
+    ASSERT(KeyList != NULL);
+    __analysis_assume(KeyList != NULL);
+
+    ValueList = YoriWinFindControlById(Parent, RegeditControlValueList);
+    ASSERT(ValueList != NULL);
+    __analysis_assume(ValueList != NULL);
+
+    if (!YoriLibCopyString(&NewSubkey, Subkey)) {
+        return;
+    }
+
+    //
+    //  The tree depth is one for the root key, plus one for each component
+    //  of the subkey.
+    //
+
+    RegeditContext->TreeDepth = 1;
+    if (NewSubkey.LengthInChars > 0) {
+        RegeditContext->TreeDepth++;
+        for (Index = 0; Index < NewSubkey.LengthInChars; Index++) {
+            if (NewSubkey.StartOfString[Index] == '\\') {
+                RegeditContext->TreeDepth++;
+            }
         }
     }
 
-    RegeditPopulateKeyValueList(RegeditContext, KeyList, ValueList, NULL, NULL);
+    RegeditContext->ActiveRootKey = RootKey;
+    YoriLibFreeStringContents(&RegeditContext->Subkey);
+    memcpy(&RegeditContext->Subkey, &NewSubkey, sizeof(YORI_STRING));
+
+    RegeditUpdateKeyCaption(RegeditContext, Parent);
+    RegeditPopulateKeyValueList(RegeditContext, KeyList, ValueList, NULL, SelectValue);
+
+    if (SelectValue != NULL) {
+        RegeditContext->MostRecentListSelectedControl = RegeditControlValueList;
+        YoriWinSetFocus(YoriWinGetWindowFromWindowCtrl(Parent), ValueList);
+    } else {
+        RegeditContext->MostRecentListSelectedControl = RegeditControlKeyList;
+        YoriWinSetFocus(YoriWinGetWindowFromWindowCtrl(Parent), KeyList);
+    }
 }
 
 /**
@@ -1500,6 +1719,59 @@ RegeditCopyKeyButtonClicked(
 }
 
 
+/**
+ Callback invoked when the find menu item is clicked.  This prompts for text
+ to search for, searches below the current key, and navigates to the result
+ selected by the user.
+
+ @param Ctrl Pointer to the menu control.
+ */
+VOID
+RegeditFindButtonClicked(
+    __in PYORI_WIN_CTRL_HANDLE Ctrl
+    )
+{
+    PYORI_WIN_CTRL_HANDLE Parent;
+    PREGEDIT_CONTEXT RegeditContext;
+    PYORI_WIN_WINDOW_MANAGER_HANDLE WinMgr;
+    YORI_STRING Title;
+    YORI_STRING SearchText;
+    YORI_STRING FoundSubkey;
+    YORI_STRING FoundValueName;
+    HKEY FoundRootKey;
+    BOOLEAN FoundValue;
+
+    Parent = YoriWinGetControlParent(Ctrl);
+    RegeditContext = YoriWinGetControlContext(Parent);
+    WinMgr = YoriWinGetWindowManagerHandle(YoriWinGetWindowFromWindowCtrl(Parent));
+
+    YoriLibInitEmptyString(&SearchText);
+    YoriLibConstantString(&Title, _T("Find"));
+
+    if (!YoriDlgInput(WinMgr, &Title, FALSE, &SearchText)) {
+        return;
+    }
+
+    if (SearchText.LengthInChars == 0) {
+        YoriLibFreeStringContents(&SearchText);
+        return;
+    }
+
+    YoriLibInitEmptyString(&FoundSubkey);
+    YoriLibInitEmptyString(&FoundValueName);
+    if (RegeditSearch(RegeditContext, WinMgr, &SearchText, &FoundRootKey, &FoundSubkey, &FoundValueName, &FoundValue)) {
+        if (FoundValue) {
+            RegeditNavigateToKey(RegeditContext, Parent, FoundRootKey, &FoundSubkey, &FoundValueName);
+        } else {
+            RegeditNavigateToKey(RegeditContext, Parent, FoundRootKey, &FoundSubkey, NULL);
+        }
+        YoriLibFreeStringContents(&FoundSubkey);
+        YoriLibFreeStringContents(&FoundValueName);
+    }
+
+    YoriLibFreeStringContents(&SearchText);
+}
+
 /**
  Callback invoked when the refresh menu item is clicked.
 
@@ -1696,7 +1968,7 @@ RegeditPopulateMenuBar(
     )
 {
     YORI_WIN_MENU_ENTRY FileMenuEntries[1];
-    YORI_WIN_MENU_ENTRY EditMenuEntries[5];
+    YORI_WIN_MENU_ENTRY EditMenuEntries[7];
     YORI_WIN_MENU_ENTRY ViewMenuEntries[1];
     YORI_WIN_MENU_ENTRY NewMenuEntries[7];
     YORI_WIN_MENU_ENTRY HelpMenuEntries[1];
@@ -1756,6 +2028,13 @@ RegeditPopulateMenuBar(
     YoriLibConstantString(&EditMenuEntries[MenuIndex].Hotkey, _T("Ctrl+C"));
     RegeditContext->CopyKeyMenuIndex = MenuIndex;
 
+    MenuIndex++;
+    EditMenuEntries[MenuIndex].Flags = YORI_WIN_MENU_ENTRY_SEPERATOR;
+    MenuIndex++;
+    YoriLibConstantString(&EditMenuEntries[MenuIndex].Caption, _T("&Find..."));
+    EditMenuEntries[MenuIndex].NotifyCallback = RegeditFindButtonClicked;
+    YoriLibConstantString(&EditMenuEntries[MenuIndex].Hotkey, _T("Ctrl+F"));
+
     ZeroMemory(&ViewMenuEntries, sizeof(ViewMenuEntries));
     MenuIndex = 0;
     YoriLibConstantString(&ViewMenuEntries[MenuIndex].Caption, _T("&Refresh"));
@@ -2175,7 +2454,8 @@ ENTRYPOINT(
     RegeditContext.UseAsciiDrawing = FALSE;
     RegeditContext.TreeDepth = 0;
     YoriLibInitEmptyString(&RegeditContext.Subkey);
-
+    ZeroMemory(&RegeditContext.SubkeyNames, sizeof(RegeditContext.SubkeyNames));
+    ZeroMemory(&RegeditContext.ValueNames, sizeof(RegeditContext.ValueNames));
 
     for (i = 1; i < ArgC; i++) {
 
@@ -2223,9 +2503,13 @@ ENTRYPOINT(
     }
 
     if (!RegeditCreateMainWindow(&RegeditContext)) {
+        RegeditFreeNameList(&RegeditContext.SubkeyNames);
+        RegeditFreeNameList(&RegeditContext.ValueNames);
         YoriLibFreeStringContents(&RegeditContext.Subkey);
         return EXIT_FAILURE;
     }
+    RegeditFreeNameList(&RegeditContext.SubkeyNames);
+    RegeditFreeNameList(&RegeditContext.ValueNames);
     YoriLibFreeStringContents(&RegeditContext.Subkey);
     return EXIT_SUCCESS;
 }
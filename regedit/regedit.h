@@ -39,6 +39,51 @@ typedef enum _REGEDIT_CONTROLS {
 } REGEDIT_CONTROLS;
 
 
+/**
+ A structure describing the well known root keys.
+ */
+typedef struct _REGEDIT_KEY_NAME_PAIR {
+
+    /**
+     The string description of the root key name.
+     */
+    YORI_STRING KeyName;
+
+    /**
+     The pseudo handle to the root key.
+     */
+    HKEY KeyHandle;
+} REGEDIT_KEY_NAME_PAIR, *PREGEDIT_KEY_NAME_PAIR;
+
+/**
+ The number of well known root keys.
+ */
+#define REGEDIT_ROOT_KEY_COUNT (4)
+
+extern CONST REGEDIT_KEY_NAME_PAIR RegeditRootKeys[REGEDIT_ROOT_KEY_COUNT];
+
+/**
+ A set of subkey or value names within the active key, sorted for display.
+ */
+typedef struct _REGEDIT_NAME_LIST {
+
+    /**
+     An array of names.  Each name refers to characters within Buffer.
+     */
+    PYORI_STRING Names;
+
+    /**
+     The number of elements in Names.
+     */
+    YORI_ALLOC_SIZE_T Count;
+
+    /**
+     A single allocation containing the characters of every name, without
+     NULL terminators.
+     */
+    YORI_STRING Buffer;
+} REGEDIT_NAME_LIST, *PREGEDIT_NAME_LIST;
+
 /**
  Context for the regedit application.
  */
@@ -68,6 +113,17 @@ typedef struct _REGEDIT_CONTEXT {
      */
     REGEDIT_CONTROLS MostRecentListSelectedControl;
 
+    /**
+     The names of subkeys within the active key.  The key list displays
+     these after its ".." entry.
+     */
+    REGEDIT_NAME_LIST SubkeyNames;
+
+    /**
+     The names of values within the active key, displayed in the value list.
+     */
+    REGEDIT_NAME_LIST ValueNames;
+
     /**
      Index of the edit menu.  This is used to enable and disable menu items
      based on the state of the application.
@@ -130,4 +186,16 @@ RegeditEditStringValue(
     __in BOOLEAN ValueReadOnly
     );
 
+__success(return)
+BOOLEAN
+RegeditSearch(
+    __in PREGEDIT_CONTEXT RegeditContext,
+    __in PYORI_WIN_WINDOW_MANAGER_HANDLE WinMgr,
+    __in PYORI_STRING SearchText,
+    __out PHKEY FoundRootKey,
+    __out PYORI_STRING FoundSubkey,
+    __out PYORI_STRING FoundValueName,
+    __out PBOOLEAN FoundValue
+    );
+
 // vim:sw=4:ts=4:et:
@@ -0,0 +1,1207 @@
+/**
+ * @file regedit/search.c
+ *
+ * Yori shell registry editor search for keys, values and data
+ *
+ * Copyright (c) 2026 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <yoripch.h>
+#include <yorilib.h>
+#include <yoriwin.h>
+#include <yoridlg.h>
+#include "regedit.h"
+
+/**
+ The maximum number of threads to use when searching.
+ */
+#define REGEDIT_SEARCH_MAX_THREADS (8)
+
+/**
+ The interval in milliseconds between updates of the search results
+ displayed while a search is in progress.
+ */
+#define REGEDIT_SEARCH_REFRESH_INTERVAL (100)
+
+/**
+ A single key or value that matched the search text.
+ */
+typedef struct _REGEDIT_SEARCH_RESULT {
+
+    /**
+     The root key containing the match.
+     */
+    HKEY RootKey;
+
+    /**
+     The path to the key containing the match, relative to RootKey.
+     */
+    YORI_STRING Subkey;
+
+    /**
+     If the match is a value, the name of the value.
+     */
+    YORI_STRING ValueName;
+
+    /**
+     TRUE if the match is a value, FALSE if it is a key.  This is needed
+     because the default value has an empty name.
+     */
+    BOOLEAN IsValue;
+
+    /**
+     The text to display in the result list.
+     */
+    YORI_STRING Display;
+} REGEDIT_SEARCH_RESULT, *PREGEDIT_SEARCH_RESULT;
+
+/**
+ A key to be searched by a worker thread.  The tree being searched is
+ divided by the subkeys immediately below the starting key, so that
+ threads can search large subtrees concurrently.
+ */
+typedef struct _REGEDIT_SEARCH_WORK_ITEM {
+
+    /**
+     The work queue item used to search this key on a worker thread.
+     */
+    YORILIB_WORK_ITEM QueueItem;
+
+    /**
+     The root key containing the key to search.
+     */
+    HKEY RootKey;
+
+    /**
+     The path to the key to search, relative to RootKey.
+     */
+    YORI_STRING Subkey;
+
+    /**
+     TRUE if the name of the key should be compared against the search
+     text and its subkeys searched.  FALSE to search only the values of the
+     key, which is used for the starting key.
+     */
+    BOOLEAN Recurse;
+} REGEDIT_SEARCH_WORK_ITEM, *PREGEDIT_SEARCH_WORK_ITEM;
+
+/**
+ The state of a search.
+ */
+typedef struct _REGEDIT_SEARCH {
+
+    /**
+     The text to search for.  Comparison is case insensitive.
+     */
+    YORI_STRING SearchText;
+
+    /**
+     Synchronizes access to the result array.
+     */
+    CRITICAL_SECTION Lock;
+
+    /**
+     An array of keys to search.
+     */
+    PREGEDIT_SEARCH_WORK_ITEM WorkItems;
+
+    /**
+     The number of elements in WorkItems.
+     */
+    YORI_ALLOC_SIZE_T WorkItemCount;
+
+    /**
+     The number of elements allocated in WorkItems.
+     */
+    YORI_ALLOC_SIZE_T WorkItemsAllocated;
+
+    /**
+     An array of pointers to results found so far.  Results are only
+     appended while the search is in progress, so an index remains valid,
+     but the array can be reallocated, so it is only accessed with Lock
+     held.
+     */
+    PREGEDIT_SEARCH_RESULT *Results;
+
+    /**
+     The number of elements in Results.
+     */
+    YORI_ALLOC_SIZE_T ResultCount;
+
+    /**
+     The number of elements allocated in Results.
+     */
+    YORI_ALLOC_SIZE_T ResultsAllocated;
+
+    /**
+     The number of keys searched so far.
+     */
+    DWORD KeysSearched;
+
+    /**
+     Set to TRUE to indicate that threads should stop searching.
+     */
+    BOOLEAN Cancelled;
+
+    /**
+     TRUE once all threads have completed.
+     */
+    BOOLEAN Complete;
+
+    /**
+     The work queue whose workers search each key in WorkItems.  This is
+     owned by the thread displaying the search window.
+     */
+    PYORILIB_WORK_QUEUE Queue;
+
+    /**
+     The list control displaying results.
+     */
+    PYORI_WIN_CTRL_HANDLE ResultList;
+
+    /**
+     The label control displaying search progress.
+     */
+    PYORI_WIN_CTRL_HANDLE StatusLabel;
+
+    /**
+     The number of results displayed in ResultList.
+     */
+    YORI_ALLOC_SIZE_T ResultsDisplayed;
+} REGEDIT_SEARCH, *PREGEDIT_SEARCH;
+
+/**
+ Return the display name of a root key.
+
+ @param RootKey The root key.
+
+ @return Pointer to the name of the root key.
+ */
+PCYORI_STRING
+RegeditSearchRootKeyName(
+    __in HKEY RootKey
+    )
+{
+    DWORD Index;
+
+    for (Index = 0; Index < REGEDIT_ROOT_KEY_COUNT; Index++) {
+        if (RootKey == RegeditRootKeys[Index].KeyHandle) {
+            return &RegeditRootKeys[Index].KeyName;
+        }
+    }
+
+    ASSERT(FALSE);
+    return &RegeditRootKeys[0].KeyName;
+}
+
+/**
+ Construct the path to a subkey.
+
+ @param Parent Pointer to the path of the parent key, which may be empty.
+
+ @param Name Pointer to the name of the subkey.
+
+ @param Path On successful completion, populated with the NULL terminated
+        path to the subkey.  The caller should free this with
+        @ref YoriLibFreeStringContents .
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+RegeditSearchBuildPath(
+    __in PYORI_STRING Parent,
+    __in PYORI_STRING Name,
+    __out PYORI_STRING Path
+    )
+{
+    YoriLibInitEmptyString(Path);
+    if (Parent->LengthInChars == 0) {
+        YoriLibYPrintf(Path, _T("%y"), Name);
+    } else {
+        YoriLibYPrintf(Path, _T("%y\\%y"), Parent, Name);
+    }
+
+    if (Path->StartOfString == NULL) {
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ Record a key or value that matched the search text.
+
+ @param Search Pointer to the search state.
+
+ @param RootKey The root key containing the match.
+
+ @param Subkey Pointer to the path to the key containing the match.
+
+ @param ValueName If the match is a value, points to the name of the value.
+        If the match is a key, this is NULL.
+ */
+VOID
+RegeditSearchAddResult(
+    __in PREGEDIT_SEARCH Search,
+    __in HKEY RootKey,
+    __in PYORI_STRING Subkey,
+    __in_opt PYORI_STRING ValueName
+    )
+{
+    PREGEDIT_SEARCH_RESULT Result;
+    PREGEDIT_SEARCH_RESULT *NewResults;
+    PCYORI_STRING RootName;
+    YORI_STRING DefaultName;
+    PYORI_STRING DisplayValueName;
+    DWORDLONG NewAllocated;
+
+    Result = YoriLibMalloc(sizeof(REGEDIT_SEARCH_RESULT));
+    if (Result == NULL) {
+        return;
+    }
+
+    ZeroMemory(Result, sizeof(REGEDIT_SEARCH_RESULT));
+    Result->RootKey = RootKey;
+    if (!YoriLibCopyString(&Result->Subkey, Subkey)) {
+        YoriLibFree(Result);
+        return;
+    }
+
+    RootName = RegeditSearchRootKeyName(RootKey);
+    if (Subkey->LengthInChars == 0) {
+        YoriLibYPrintf(&Result->Display, _T("%y"), RootName);
+    } else {
+        YoriLibYPrintf(&Result->Display, _T("%y\\%y"), RootName, Subkey);
+    }
+
+    if (ValueName != NULL) {
+        Result->IsValue = TRUE;
+        YoriLibCopyString(&Result->ValueName, ValueName);
+
+        DisplayValueName = ValueName;
+        if (ValueName->LengthInChars == 0) {
+            YoriLibConstantString(&DefaultName, _T("(Default)"));
+            DisplayValueName = &DefaultName;
+        }
+
+        if (Result->Display.StartOfString != NULL) {
+            YORI_STRING KeyDisplay;
+            memcpy(&KeyDisplay, &Result->Display, sizeof(YORI_STRING));
+            YoriLibInitEmptyString(&Result->Display);
+            YoriLibYPrintf(&Result->Display, _T("%y : %y"), &KeyDisplay, DisplayValueName);
+            YoriLibFreeStringContents(&KeyDisplay);
+        }
+    }
+
+    if (Result->Display.StartOfString == NULL) {
+        YoriLibFreeStringContents(&Result->Subkey);
+        YoriLibFreeStringContents(&Result->ValueName);
+        YoriLibFree(Result);
+        return;
+    }
+
+    EnterCriticalSection(&Search->Lock);
+    if (Search->ResultCount >= Search->ResultsAllocated) {
+        NewAllocated = Search->ResultsAllocated;
+        NewAllocated = NewAllocated * 2 + 64;
+        if (!YoriLibIsSizeAllocatable(NewAllocated * sizeof(PREGEDIT_SEARCH_RESULT))) {
+            LeaveCriticalSection(&Search->Lock);
+            YoriLibFreeStringContents(&Result->Display);
+            YoriLibFreeStringContents(&Result->Subkey);
+            YoriLibFreeStringContents(&Result->ValueName);
+            YoriLibFree(Result);
+            return;
+        }
+
+        NewResults = YoriLibMalloc((YORI_ALLOC_SIZE_T)(NewAllocated * sizeof(PREGEDIT_SEARCH_RESULT)));
+        if (NewResults == NULL) {
+            LeaveCriticalSection(&Search->Lock);
+            YoriLibFreeStringContents(&Result->Display);
+            YoriLibFreeStringContents(&Result->Subkey);
+            YoriLibFreeStringContents(&Result->ValueName);
+            YoriLibFree(Result);
+            return;
+        }
+
+        if (Search->Results != NULL) {
+            memcpy(NewResults, Search->Results, Search->ResultCount * sizeof(PREGEDIT_SEARCH_RESULT));
+            YoriLibFree(Search->Results);
+        }
+        Search->Results = NewResults;
+        Search->ResultsAllocated = (YORI_ALLOC_SIZE_T)NewAllocated;
+    }
+
+    Search->Results[Search->ResultCount] = Result;
+    Search->ResultCount++;
+    LeaveCriticalSection(&Search->Lock);
+}
+
+/**
+ Query the length of the longest subkey name, value name and value data
+ within a key.
+
+ @param Key The key to query.
+
+ @param MaxSubKeyLength On successful completion, populated with the length
+        of the longest subkey name, in characters.
+
+ @param MaxValueNameLength On successful completion, populated with the
+        length of the longest value name, in characters.
+
+ @param MaxValueData On successful completion, populated with the length of
+        the longest value data, in bytes.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+RegeditSearchQueryKey(
+    __in HKEY Key,
+    __out PDWORD MaxSubKeyLength,
+    __out PDWORD MaxValueNameLength,
+    __out PDWORD MaxValueData
+    )
+{
+    YORI_STRING Class;
+    DWORD ClassLength;
+    DWORD SubKeyCount;
+    DWORD MaxClassLength;
+    DWORD ValueCount;
+    DWORD SecurityDescriptorLength;
+    FILETIME LastWriteTime;
+    DWORD Err;
+
+    ClassLength = 0;
+    Err = DllAdvApi32.pRegQueryInfoKeyW(Key,
+                                        NULL,
+                                        &ClassLength,
+                                        NULL,
+                                        &SubKeyCount,
+                                        MaxSubKeyLength,
+                                        &MaxClassLength,
+                                        &ValueCount,
+                                        MaxValueNameLength,
+                                        MaxValueData,
+                                        &SecurityDescriptorLength,
+                                        &LastWriteTime);
+
+    //
+    //  Older versions of Windows insist on returning the class name.  If
+    //  needed, allocate space for it, call again, and throw it away.
+    //
+
+    if (Err == ERROR_MORE_DATA || Err == ERROR_INSUFFICIENT_BUFFER) {
+        if (!YoriLibIsSizeAllocatable(ClassLength + 1) ||
+            !YoriLibAllocateString(&Class, (YORI_ALLOC_SIZE_T)(ClassLength + 1))) {
+
+            return FALSE;
+        }
+
+        ClassLength = Class.LengthAllocated;
+        Err = DllAdvApi32.pRegQueryInfoKeyW(Key,
+                                            Class.StartOfString,
+                                            &ClassLength,
+                                            NULL,
+                                            &SubKeyCount,
+                                            MaxSubKeyLength,
+                                            &MaxClassLength,
+                                            &ValueCount,
+                                            MaxValueNameLength,
+                                            MaxValueData,
+                                            &SecurityDescriptorLength,
+                                            &LastWriteTime);
+        YoriLibFreeStringContents(&Class);
+    }
+
+    if (Err != ERROR_SUCCESS) {
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ Search a key for values whose name or string data contains the search
+ text, and optionally search its subkeys.
+
+ @param Search Pointer to the search state.
+
+ @param RootKey The root key containing the key to search.
+
+ @param Subkey Pointer to the NULL terminated path to the key to search,
+        relative to RootKey.
+
+ @param Recurse TRUE if the name of the key should be compared against the
+        search text and its subkeys searched.  FALSE to search only the
+        values of the key.
+ */
+VOID
+RegeditSearchKey(
+    __in PREGEDIT_SEARCH Search,
+    __in HKEY RootKey,
+    __in PYORI_STRING Subkey,
+    __in BOOLEAN Recurse
+    )
+{
+    HKEY Key;
+    DWORD Err;
+    DWORD MaxSubKeyLength;
+    DWORD MaxValueNameLength;
+    DWORD MaxValueData;
+    DWORD NameSize;
+    DWORD DataSize;
+    DWORD DataAllocated;
+    DWORD Type;
+    DWORD Index;
+    PUCHAR Data;
+    YORI_STRING Name;
+    YORI_STRING DataString;
+    YORI_STRING ChildPath;
+    LPTSTR FinalSeperator;
+    BOOLEAN Match;
+
+    if (Search->Cancelled) {
+        return;
+    }
+
+    InterlockedIncrement((INTERLOCKED_VOLATILE LONG *)&Search->KeysSearched);
+
+    if (Recurse) {
+        YoriLibInitEmptyString(&Name);
+        Name.StartOfString = Subkey->StartOfString;
+        Name.LengthInChars = Subkey->LengthInChars;
+        FinalSeperator = YoriLibFindRightMostCharacter(Subkey, '\\');
+        if (FinalSeperator != NULL) {
+            Name.StartOfString = FinalSeperator + 1;
+            Name.LengthInChars = Subkey->LengthInChars - (YORI_ALLOC_SIZE_T)(Name.StartOfString - Subkey->StartOfString);
+        }
+
+        if (YoriLibFindFirstMatchSubstrIns(&Name, 1, &Search->SearchText, NULL) != NULL) {
+            RegeditSearchAddResult(Search, RootKey, Subkey, NULL);
+        }
+    }
+
+    Err = DllAdvApi32.pRegOpenKeyExW(RootKey, Subkey->StartOfString, 0, KEY_READ, &Key);
+    if (Err != ERROR_SUCCESS) {
+        return;
+    }
+
+    if (!RegeditSearchQueryKey(Key, &MaxSubKeyLength, &MaxValueNameLength, &MaxValueData)) {
+        DllAdvApi32.pRegCloseKey(Key);
+        return;
+    }
+
+    if (MaxValueNameLength > MaxSubKeyLength) {
+        MaxSubKeyLength = MaxValueNameLength;
+    }
+
+    //
+    //  Allocate space for the data plus a terminator, since string data
+    //  isn't guaranteed to have one.
+    //
+
+    DataAllocated = MaxValueData + sizeof(TCHAR);
+    if (!YoriLibIsSizeAllocatable(MaxSubKeyLength + 1) ||
+        !YoriLibIsSizeAllocatable(DataAllocated) ||
+        !YoriLibAllocateString(&Name, (YORI_ALLOC_SIZE_T)(MaxSubKeyLength + 1))) {
+
+        DllAdvApi32.pRegCloseKey(Key);
+        return;
+    }
+
+    Data = YoriLibMalloc((YORI_ALLOC_SIZE_T)DataAllocated);
+    if (Data == NULL) {
+        YoriLibFreeStringContents(&Name);
+        DllAdvApi32.pRegCloseKey(Key);
+        return;
+    }
+
+    //
+    //  Values that changed size since the key was queried are skipped.
+    //
+
+    for (Index = 0; !Search->Cancelled; Index++) {
+        NameSize = Name.LengthAllocated;
+        DataSize = MaxValueData;
+        Err = DllAdvApi32.pRegEnumValueW(Key, Index, Name.StartOfString, &NameSize, NULL, &Type, Data, &DataSize);
+        if (Err == ERROR_NO_MORE_ITEMS) {
+            break;
+        } else if (Err != ERROR_SUCCESS) {
+            continue;
+        }
+
+        Name.LengthInChars = (YORI_ALLOC_SIZE_T)NameSize;
+        Match = FALSE;
+        if (YoriLibFindFirstMatchSubstrIns(&Name, 1, &Search->SearchText, NULL) != NULL) {
+            Match = TRUE;
+        } else if (Type == REG_SZ || Type == REG_EXPAND_SZ || Type == REG_MULTI_SZ) {
+            YoriLibInitEmptyString(&DataString);
+            DataString.StartOfString = (LPTSTR)Data;
+            DataString.LengthInChars = (YORI_ALLOC_SIZE_T)(DataSize / sizeof(TCHAR));
+            if (YoriLibFindFirstMatchSubstrIns(&DataString, 1, &Search->SearchText, NULL) != NULL) {
+                Match = TRUE;
+            }
+        }
+
+        if (Match) {
+            RegeditSearchAddResult(Search, RootKey, Subkey, &Name);
+        }
+    }
+
+    YoriLibFree(Data);
+
+    if (Recurse) {
+        for (Index = 0; !Search->Cancelled; Index++) {
+            NameSize = Name.LengthAllocated;
+            Err = DllAdvApi32.pRegEnumKeyExW(Key, Index, Name.StartOfString, &NameSize, NULL, NULL, NULL, NULL);
+            if (Err == ERROR_NO_MORE_ITEMS) {
+                break;
+            } else if (Err != ERROR_SUCCESS) {
+                continue;
+            }
+
+            Name.LengthInChars = (YORI_ALLOC_SIZE_T)NameSize;
+            if (RegeditSearchBuildPath(Subkey, &Name, &ChildPath)) {
+                RegeditSearchKey(Search, RootKey, &ChildPath, TRUE);
+                YoriLibFreeStringContents(&ChildPath);
+            }
+        }
+    }
+
+    YoriLibFreeStringContents(&Name);
+    DllAdvApi32.pRegCloseKey(Key);
+}
+
+/**
+ Add a key to the set of keys to be searched by worker threads.
+
+ @param Search Pointer to the search state.
+
+ @param RootKey The root key containing the key to search.
+
+ @param Subkey Pointer to the path to the key to search, relative to
+        RootKey.  This is copied into the work item.
+
+ @param Recurse TRUE if the name of the key should be compared against the
+        search text and its subkeys searched.  FALSE to search only the
+        values of the key.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+RegeditSearchAddWorkItem(
+    __in PREGEDIT_SEARCH Search,
+    __in HKEY RootKey,
+    __in PYORI_STRING Subkey,
+    __in BOOLEAN Recurse
+    )
+{
+    PREGEDIT_SEARCH_WORK_ITEM NewWorkItems;
+    PREGEDIT_SEARCH_WORK_ITEM WorkItem;
+    DWORDLONG NewAllocated;
+
+    if (Search->WorkItemCount >= Search->WorkItemsAllocated) {
+        NewAllocated = Search->WorkItemsAllocated;
+        NewAllocated = NewAllocated * 2 + 64;
+        if (!YoriLibIsSizeAllocatable(NewAllocated * sizeof(REGEDIT_SEARCH_WORK_ITEM))) {
+            return FALSE;
+        }
+
+        NewWorkItems = YoriLibMalloc((YORI_ALLOC_SIZE_T)(NewAllocated * sizeof(REGEDIT_SEARCH_WORK_ITEM)));
+        if (NewWorkItems == NULL) {
+            return FALSE;
+        }
+
+        if (Search->WorkItems != NULL) {
+            memcpy(NewWorkItems, Search->WorkItems, Search->WorkItemCount * sizeof(REGEDIT_SEARCH_WORK_ITEM));
+            YoriLibFree(Search->WorkItems);
+        }
+        Search->WorkItems = NewWorkItems;
+        Search->WorkItemsAllocated = (YORI_ALLOC_SIZE_T)NewAllocated;
+    }
+
+    WorkItem = &Search->WorkItems[Search->WorkItemCount];
+    WorkItem->RootKey = RootKey;
+    WorkItem->Recurse = Recurse;
+    if (!YoriLibCopyString(&WorkItem->Subkey, Subkey)) {
+        return FALSE;
+    }
+
+    Search->WorkItemCount++;
+    return TRUE;
+}
+
+/**
+ Add a starting key, and each of its immediate subkeys, to the set of keys
+ to be searched by worker threads.
+
+ @param Search Pointer to the search state.
+
+ @param RootKey The root key containing the key to search.
+
+ @param Subkey Pointer to the NULL terminated path to the key to search,
+        relative to RootKey.  This may be empty to search the root key.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+RegeditSearchAddStartingKey(
+    __in PREGEDIT_SEARCH Search,
+    __in HKEY RootKey,
+    __in PYORI_STRING Subkey
+    )
+{
+    HKEY Key;
+    DWORD Err;
+    DWORD Index;
+    DWORD NameSize;
+    DWORD MaxSubKeyLength;
+    DWORD MaxValueNameLength;
+    DWORD MaxValueData;
+    YORI_STRING Name;
+    YORI_STRING ChildPath;
+    BOOLEAN Result;
+
+    if (!RegeditSearchAddWorkItem(Search, RootKey, Subkey, FALSE)) {
+        return FALSE;
+    }
+
+    Err = DllAdvApi32.pRegOpenKeyExW(RootKey, Subkey->StartOfString, 0, KEY_READ, &Key);
+    if (Err != ERROR_SUCCESS) {
+        return TRUE;
+    }
+
+    if (!RegeditSearchQueryKey(Key, &MaxSubKeyLength, &MaxValueNameLength, &MaxValueData) ||
+        !YoriLibIsSizeAllocatable(MaxSubKeyLength + 1) ||
+        !YoriLibAllocateString(&Name, (YORI_ALLOC_SIZE_T)(MaxSubKeyLength + 1))) {
+
+        DllAdvApi32.pRegCloseKey(Key);
+        return TRUE;
+    }
+
+    Result = TRUE;
+    for (Index = 0; ; Index++) {
+        NameSize = Name.LengthAllocated;
+        Err = DllAdvApi32.pRegEnumKeyExW(Key, Index, Name.StartOfString, &NameSize, NULL, NULL, NULL, NULL);
+        if (Err == ERROR_NO_MORE_ITEMS) {
+            break;
+        } else if (Err != ERROR_SUCCESS) {
+            continue;
+        }
+
+        Name.LengthInChars = (YORI_ALLOC_SIZE_T)NameSize;
+        if (!RegeditSearchBuildPath(Subkey, &Name, &ChildPath)) {
+            Result = FALSE;
+            break;
+        }
+
+        if (!RegeditSearchAddWorkItem(Search, RootKey, &ChildPath, TRUE)) {
+            YoriLibFreeStringContents(&ChildPath);
+            Result = FALSE;
+            break;
+        }
+        YoriLibFreeStringContents(&ChildPath);
+    }
+
+    YoriLibFreeStringContents(&Name);
+    DllAdvApi32.pRegCloseKey(Key);
+    return Result;
+}
+
+/**
+ Search a single key from the set of keys to search.  This is invoked on a
+ work queue worker thread.
+
+ @param Context Pointer to the search state.
+
+ @param WorkerContext Unused.
+
+ @param Item Pointer to the work queue item within the key to search.
+
+ @return TRUE to indicate the worker should continue processing items.
+ */
+BOOLEAN
+RegeditSearchExecute(
+    __in PVOID Context,
+    __in PVOID WorkerContext,
+    __in PYORILIB_WORK_ITEM Item
+    )
+{
+    PREGEDIT_SEARCH Search;
+    PREGEDIT_SEARCH_WORK_ITEM WorkItem;
+
+    UNREFERENCED_PARAMETER(WorkerContext);
+
+    Search = (PREGEDIT_SEARCH)Context;
+    WorkItem = CONTAINING_RECORD(Item, REGEDIT_SEARCH_WORK_ITEM, QueueItem);
+
+    if (!Search->Cancelled) {
+        RegeditSearchKey(Search, WorkItem->RootKey, &WorkItem->Subkey, WorkItem->Recurse);
+    }
+
+    return TRUE;
+}
+
+/**
+ Invoked on the thread displaying the search window once a key has been
+ searched.  Results are recorded as they are found, and the work item is
+ owned by the WorkItems array, so there is nothing to do here.
+
+ @param Context Pointer to the search state.
+
+ @param Item Pointer to the work queue item within the key that was
+        searched.
+ */
+VOID
+RegeditSearchComplete(
+    __in PVOID Context,
+    __in PYORILIB_WORK_ITEM Item
+    )
+{
+    UNREFERENCED_PARAMETER(Context);
+    UNREFERENCED_PARAMETER(Item);
+}
+
+/**
+ Stop any threads that are still searching and free the search state.
+
+ @param Search Pointer to the search state.
+ */
+VOID
+RegeditSearchCleanup(
+    __in PREGEDIT_SEARCH Search
+    )
+{
+    YORI_ALLOC_SIZE_T Index;
+    PREGEDIT_SEARCH_RESULT Result;
+
+    Search->Cancelled = TRUE;
+    if (Search->Queue != NULL) {
+        YoriLibWorkQueueDestroy(Search->Queue);
+        Search->Queue = NULL;
+    }
+
+    for (Index = 0; Index < Search->WorkItemCount; Index++) {
+        YoriLibFreeStringContents(&Search->WorkItems[Index].Subkey);
+    }
+    if (Search->WorkItems != NULL) {
+        YoriLibFree(Search->WorkItems);
+        Search->WorkItems = NULL;
+    }
+
+    for (Index = 0; Index < Search->ResultCount; Index++) {
+        Result = Search->Results[Index];
+        YoriLibFreeStringContents(&Result->Display);
+        YoriLibFreeStringContents(&Result->Subkey);
+        YoriLibFreeStringContents(&Result->ValueName);
+        YoriLibFree(Result);
+    }
+    if (Search->Results != NULL) {
+        YoriLibFree(Search->Results);
+        Search->Results = NULL;
+    }
+
+    DeleteCriticalSection(&Search->Lock);
+}
+
+/**
+ Return the text of an item in the search result list.
+
+ @param Ctrl Pointer to the result list control.
+
+ @param Index The index of the item within the list.
+
+ @param String On successful completion, updated to refer to the item text.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOLEAN
+RegeditSearchGetResultItem(
+    __in PYORI_WIN_CTRL_HANDLE Ctrl,
+    __in YORI_ALLOC_SIZE_T Index,
+    __inout PYORI_STRING String
+    )
+{
+    PREGEDIT_SEARCH Search;
+    PREGEDIT_SEARCH_RESULT Result;
+
+    Search = YoriWinGetControlContext(YoriWinGetControlParent(Ctrl));
+
+    EnterCriticalSection(&Search->Lock);
+    if (Index >= Search->ResultCount) {
+        LeaveCriticalSection(&Search->Lock);
+        return FALSE;
+    }
+    Result = Search->Results[Index];
+    LeaveCriticalSection(&Search->Lock);
+
+    String->StartOfString = Result->Display.StartOfString;
+    String->LengthInChars = Result->Display.LengthInChars;
+    return TRUE;
+}
+
+/**
+ Update the result list and status label to reflect the progress of the
+ search.
+
+ @param Search Pointer to the search state.
+ */
+VOID
+RegeditSearchUpdateDisplay(
+    __in PREGEDIT_SEARCH Search
+    )
+{
+    YORI_ALLOC_SIZE_T ResultCount;
+    YORI_STRING Status;
+
+    EnterCriticalSection(&Search->Lock);
+    ResultCount = Search->ResultCount;
+    LeaveCriticalSection(&Search->Lock);
+
+    if (ResultCount != Search->ResultsDisplayed) {
+        YoriWinListSetVirtualItemCount(Search->ResultList, ResultCount);
+        if (Search->ResultsDisplayed == 0) {
+            YoriWinListSetActiveOption(Search->ResultList, 0);
+        }
+        Search->ResultsDisplayed = ResultCount;
+    }
+
+    YoriLibInitEmptyString(&Status);
+    if (Search->Complete) {
+        YoriLibYPrintf(&Status, _T("Search complete: %i keys searched, %i found"), Search->KeysSearched, ResultCount);
+    } else {
+        YoriLibYPrintf(&Status, _T("Searching: %i keys searched, %i found"), Search->KeysSearched, ResultCount);
+    }
+
+    if (Status.StartOfString != NULL) {
+        YoriWinLabelSetCaption(Search->StatusLabel, &Status);
+        YoriLibFreeStringContents(&Status);
+    }
+}
+
+/**
+ A callback invoked periodically while the search window is displayed.  This
+ displays results found so far, and detects when the search completes.
+
+ @param WindowHandle Handle to the search window.
+ */
+VOID
+RegeditSearchTimer(
+    __in PYORI_WIN_WINDOW_HANDLE WindowHandle
+    )
+{
+    PREGEDIT_SEARCH Search;
+
+    Search = YoriWinGetControlContext(YoriWinGetCtrlFromWindow(WindowHandle));
+
+    if (YoriLibWorkQueueComplete(Search->Queue, 0, 0)) {
+        Search->Complete = TRUE;
+        YoriWinSetWindowTimerCallback(WindowHandle, 0, NULL);
+    }
+
+    RegeditSearchUpdateDisplay(Search);
+}
+
+/**
+ Callback invoked when the go button is clicked.  This closes the dialog
+ while indicating that the selected result should be displayed.
+
+ @param Ctrl Pointer to the go button control.
+ */
+VOID
+RegeditSearchGoButtonClicked(
+    __in PYORI_WIN_CTRL_HANDLE Ctrl
+    )
+{
+    PYORI_WIN_CTRL_HANDLE Parent;
+    Parent = YoriWinGetControlParent(Ctrl);
+    YoriWinCloseWindow(Parent, TRUE);
+}
+
+/**
+ Callback invoked when the close button is clicked.  This closes the dialog
+ while indicating that no result should be displayed.
+
+ @param Ctrl Pointer to the close button control.
+ */
+VOID
+RegeditSearchCloseButtonClicked(
+    __in PYORI_WIN_CTRL_HANDLE Ctrl
+    )
+{
+    PYORI_WIN_CTRL_HANDLE Parent;
+    Parent = YoriWinGetControlParent(Ctrl);
+    YoriWinCloseWindow(Parent, FALSE);
+}
+
+/**
+ Search the registry below the currently active key for keys, value names
+ and string data containing the search text, and display the results as
+ they are found.  If the current view is the list of root keys, all root
+ keys are searched.  The subkeys below the starting key are distributed
+ across a set of threads.
+
+ @param RegeditContext Pointer to the registry editor global context,
+        indicating the key to search.
+
+ @param WinMgr Pointer to the window manager.
+
+ @param SearchText Pointer to the text to search for.
+
+ @param FoundRootKey On successful completion, populated with the root key
+        containing the result selected by the user.
+
+ @param FoundSubkey On successful completion, populated with the path to the
+        key containing the result selected by the user, relative to
+        FoundRootKey.  The caller should free this with
+        @ref YoriLibFreeStringContents .
+
+ @param FoundValueName On successful completion, if the selected result is a
+        value, populated with the name of the value.  The caller should free
+        this with @ref YoriLibFreeStringContents .
+
+ @param FoundValue On successful completion, set to TRUE if the selected
+        result is a value, or FALSE if it is a key.
+
+ @return TRUE to indicate that the user selected a result, FALSE to indicate
+         that a failure occurred or the user closed the window without
+         selecting a result.
+ */
+__success(return)
+BOOLEAN
+RegeditSearch(
+    __in PREGEDIT_CONTEXT RegeditContext,
+    __in PYORI_WIN_WINDOW_MANAGER_HANDLE WinMgr,
+    __in PYORI_STRING SearchText,
+    __out PHKEY FoundRootKey,
+    __out PYORI_STRING FoundSubkey,
+    __out PYORI_STRING FoundValueName,
+    __out PBOOLEAN FoundValue
+    )
+{
+    REGEDIT_SEARCH Search;
+    PYORI_WIN_WINDOW_HANDLE Parent;
+    PYORI_WIN_CTRL_HANDLE Ctrl;
+    PREGEDIT_SEARCH_RESULT Result;
+    SYSTEM_INFO SystemInfo;
+    COORD WinMgrSize;
+    COORD WindowSize;
+    SMALL_RECT Area;
+    YORI_STRING Caption;
+    YORI_STRING EmptySubkey;
+    YORI_ALLOC_SIZE_T ActiveOption;
+    DWORD_PTR WindowResult;
+    DWORD ThreadCount;
+    DWORD Index;
+    DWORD ButtonWidth;
+    BOOLEAN Success;
+
+    if (!YoriWinGetWinMgrDimensions(WinMgr, &WinMgrSize)) {
+        return FALSE;
+    }
+
+    if (WinMgrSize.X < 60 || WinMgrSize.Y < 20) {
+        return FALSE;
+    }
+
+    ZeroMemory(&Search, sizeof(Search));
+    Search.SearchText.StartOfString = SearchText->StartOfString;
+    Search.SearchText.LengthInChars = SearchText->LengthInChars;
+    InitializeCriticalSection(&Search.Lock);
+
+    Success = TRUE;
+    if (RegeditContext->TreeDepth == 0) {
+        YoriLibInitEmptyString(&EmptySubkey);
+        for (Index = 0; Index < REGEDIT_ROOT_KEY_COUNT; Index++) {
+            if (!RegeditSearchAddStartingKey(&Search, RegeditRootKeys[Index].KeyHandle, &EmptySubkey)) {
+                Success = FALSE;
+                break;
+            }
+        }
+    } else {
+        Success = RegeditSearchAddStartingKey(&Search, RegeditContext->ActiveRootKey, &RegeditContext->Subkey);
+    }
+
+    if (!Success) {
+        RegeditSearchCleanup(&Search);
+        return FALSE;
+    }
+
+    WindowSize.X = (WORD)(WinMgrSize.X - 6);
+    WindowSize.Y = (WORD)(WinMgrSize.Y - 4);
+
+    YoriLibConstantString(&Caption, _T("Find"));
+
+    if (!YoriWinCreateWindow(WinMgr, WindowSize.X, WindowSize.Y, WindowSize.X, WindowSize.Y, YORI_WIN_WINDOW_STYLE_BORDER_SINGLE | YORI_WIN_WINDOW_STYLE_SHADOW_TRANSPARENT, &Caption, &Parent)) {
+        RegeditSearchCleanup(&Search);
+        return FALSE;
+    }
+
+    YoriWinSetControlContext(YoriWinGetCtrlFromWindow(Parent), &Search);
+    YoriWinGetClientSize(Parent, &WindowSize);
+
+    YoriLibConstantString(&Caption, _T("Searching"));
+
+    Area.Left = 1;
+    Area.Top = 0;
+    Area.Right = (WORD)(WindowSize.X - 2);
+    Area.Bottom = Area.Top;
+
+    Search.StatusLabel = YoriWinLabelCreate(Parent, &Area, &Caption, 0);
+    if (Search.StatusLabel == NULL) {
+        YoriWinDestroyWindow(Parent);
+        RegeditSearchCleanup(&Search);
+        return FALSE;
+    }
+
+    Area.Left = 1;
+    Area.Top = 1;
+    Area.Right = (WORD)(WindowSize.X - 2);
+    Area.Bottom = (WORD)(WindowSize.Y - 4);
+
+    Search.ResultList = YoriWinListCreate(Parent, &Area, YORI_WIN_LIST_STYLE_VSCROLLBAR | YORI_WIN_LIST_STYLE_AUTO_HSCROLLBAR);
+    if (Search.ResultList == NULL ||
+        !YoriWinListSetVirtualItems(Search.ResultList, RegeditSearchGetResultItem, 0)) {
+
+        YoriWinDestroyWindow(Parent);
+        RegeditSearchCleanup(&Search);
+        return FALSE;
+    }
+
+    ButtonWidth = 8;
+
+    YoriLibConstantString(&Caption, _T("&Go"));
+
+    Area.Top = (WORD)(WindowSize.Y - 3);
+    Area.Left = 1;
+    Area.Bottom = (WORD)(Area.Top + 2);
+    Area.Right = (WORD)(Area.Left + 1 + ButtonWidth);
+
+    Ctrl = YoriWinButtonCreate(Parent, &Area, &Caption, YORI_WIN_BUTTON_STYLE_DEFAULT, RegeditSearchGoButtonClicked);
+    if (Ctrl == NULL) {
+        YoriWinDestroyWindow(Parent);
+        RegeditSearchCleanup(&Search);
+        return FALSE;
+    }
+
+    YoriLibConstantString(&Caption, _T("&Close"));
+
+    Area.Left = (WORD)(Area.Right + 2);
+    Area.Right = (WORD)(Area.Left + 1 + ButtonWidth);
+
+    Ctrl = YoriWinButtonCreate(Parent, &Area, &Caption, YORI_WIN_BUTTON_STYLE_CANCEL, RegeditSearchCloseButtonClicked);
+    if (Ctrl == NULL) {
+        YoriWinDestroyWindow(Parent);
+        RegeditSearchCleanup(&Search);
+        return FALSE;
+    }
+
+    //
+    //  Start the workers.  There's no point having more workers than keys
+    //  to search.
+    //
+
+    GetSystemInfo(&SystemInfo);
+    ThreadCount = SystemInfo.dwNumberOfProcessors;
+    if (ThreadCount > REGEDIT_SEARCH_MAX_THREADS) {
+        ThreadCount = REGEDIT_SEARCH_MAX_THREADS;
+    }
+    if (ThreadCount > Search.WorkItemCount) {
+        ThreadCount = Search.WorkItemCount;
+    }
+    if (ThreadCount < 1) {
+        ThreadCount = 1;
+    }
+
+    Search.Queue = YoriLibWorkQueueCreate(0, 0, RegeditSearchExecute, RegeditSearchComplete, &Search);
+    if (Search.Queue == NULL) {
+        YoriWinDestroyWindow(Parent);
+        RegeditSearchCleanup(&Search);
+        return FALSE;
+    }
+
+    for (Index = 0; Index < ThreadCount; Index++) {
+        if (!YoriLibWorkQueueAddWorker(Search.Queue, NULL)) {
+            break;
+        }
+    }
+
+    if (Index == 0) {
+        YoriWinDestroyWindow(Parent);
+        RegeditSearchCleanup(&Search);
+        return FALSE;
+    }
+
+    //
+    //  The work item array is no longer growing, so items within it can be
+    //  submitted.
+    //
+
+    for (Index = 0; Index < Search.WorkItemCount; Index++) {
+        YoriLibWorkQueueInitializeItem(&Search.WorkItems[Index].QueueItem);
+        YoriLibWorkQueueSubmit(Search.Queue, &Search.WorkItems[Index].QueueItem);
+    }
+
+    YoriWinSetFocus(Parent, Search.ResultList);
+    RegeditSearchUpdateDisplay(&Search);
+
+    if (!YoriWinSetWindowTimerCallback(Parent, REGEDIT_SEARCH_REFRESH_INTERVAL, RegeditSearchTimer)) {
+        YoriWinDestroyWindow(Parent);
+        RegeditSearchCleanup(&Search);
+        return FALSE;
+    }
+
+    WindowResult = FALSE;
+    if (!YoriWinProcessInputForWindow(Parent, &WindowResult)) {
+        WindowResult = FALSE;
+    }
+
+    //
+    //  Stop searching before looking at results, so the result array is no
+    //  longer changing.
+    //
+
+    YoriWinSetWindowTimerCallback(Parent, 0, NULL);
+    Search.Cancelled = TRUE;
+    YoriLibWorkQueueComplete(Search.Queue, 0, INFINITE);
+
+    Success = FALSE;
+    if (WindowResult &&
+        YoriWinListGetActiveOption(Search.ResultList, &ActiveOption) &&
+        ActiveOption < Search.ResultCount) {
+
+        Result = Search.Results[ActiveOption];
+        *FoundRootKey = Result->RootKey;
+        *FoundValue = Result->IsValue;
+        YoriLibCloneString(FoundSubkey, &Result->Subkey);
+        YoriLibCloneString(FoundValueName, &Result->ValueName);
+        Success = TRUE;
+    }
+
+    YoriWinDestroyWindow(Parent);
+    RegeditSearchCleanup(&Search);
+    return Success;
+}
+
+// vim:sw=4:ts=4:et:
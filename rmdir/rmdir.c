@@ -35,10 +35,11 @@ CHAR strRmdirHelpText[] =
         "\n"
         "Removes directories.\n"
         "\n"
-        "RMDIR [-license] [-b] [-r] [-s] <dir> [<dir>...]\n"
+        "RMDIR [-license] [-b] [-f] [-j n] [-l] [-p] [-r] [-s] <dir> [<dir>...]\n"
         "\n"
         "   -b             Use basic search criteria for directories only\n"
         "   -f             Delete files as well as directories\n"
+        "   -j             Delete up to n objects at the same time\n"
         "   -l             Delete links without contents\n"
         "   -p             Delete with POSIX semantics\n"
         "   -r             Send directories to the recycle bin\n"
@@ -58,6 +59,11 @@ RmdirHelp(VOID)
     return TRUE;
 }
 
+/**
+ The maximum number of objects that can be deleted at the same time.
+ */
+#define RMDIR_MAX_WORKERS (64)
+
 /**
  Context information when files are found.
  */
@@ -80,12 +86,127 @@ typedef struct _RMDIR_CONTEXT {
     BOOLEAN PosixSemantics;
 
     /**
-     The number of directories successfully removed.
+     Set to TRUE to indicate that worker threads should terminate once no
+     more work is pending.  Protected by Mutex.
+     */
+    BOOLEAN Terminate;
+
+    /**
+     The number of directories successfully removed.  When worker threads
+     are in use, this is protected by Mutex.
      */
     DWORD DirectoriesRemoved;
 
+    /**
+     The number of objects to delete at the same time.  If this is one,
+     objects are deleted on the main thread.
+     */
+    DWORD WorkerCount;
+
+    /**
+     The number of worker threads that have been created.
+     */
+    DWORD ThreadCount;
+
+    /**
+     The number of jobs which have been queued and not yet completed.
+     Protected by Mutex.
+     */
+    DWORD JobsOutstanding;
+
+    /**
+     Handles to worker threads.
+     */
+    HANDLE Threads[RMDIR_MAX_WORKERS];
+
+    /**
+     A mutex protecting the pending list and the counts of outstanding
+     children in each directory.
+     */
+    HANDLE Mutex;
+
+    /**
+     A semaphore which is signalled once for each job added to the pending
+     list, and once for each worker when terminating.
+     */
+    HANDLE WorkAvailableSemaphore;
+
+    /**
+     An event which is signalled whenever a worker completes a job.
+     */
+    HANDLE JobCompleteEvent;
+
+    /**
+     A list of objects which have not yet been picked up by a worker.
+     Protected by Mutex.
+     */
+    YORI_LIST_ENTRY PendingList;
+
+    /**
+     A list of directories whose contents are currently being enumerated,
+     with the most recently found at the end.  This is only used by the
+     enumerating thread.
+     */
+    YORI_LIST_ENTRY DirectoryStack;
+
 } RMDIR_CONTEXT, *PRMDIR_CONTEXT;
 
+/**
+ A single object to be deleted by a worker thread.
+ */
+typedef struct _RMDIR_JOB {
+
+    /**
+     The link within the list of pending jobs.
+     */
+    YORI_LIST_ENTRY PendingListEntry;
+
+    /**
+     The fully qualified path to the object to delete.
+     */
+    YORI_STRING FilePath;
+
+    /**
+     The attributes of the object from enumeration.
+     */
+    DWORD FileAttributes;
+
+    /**
+     The directory containing this object, to be notified when this object
+     has been processed, or NULL if the object was specified by the user.
+     */
+    struct _RMDIR_DIRECTORY *Parent;
+} RMDIR_JOB, *PRMDIR_JOB;
+
+/**
+ A directory whose contents are being deleted.  The directory can only be
+ removed once every object within it has been processed.
+ */
+typedef struct _RMDIR_DIRECTORY {
+
+    /**
+     The link within the list of directories being enumerated.
+     */
+    YORI_LIST_ENTRY StackEntry;
+
+    /**
+     The fully qualified path to the directory.
+     */
+    YORI_STRING Path;
+
+    /**
+     The number of objects within the directory which have been found but
+     not yet processed.  Protected by Mutex.
+     */
+    DWORD ChildrenOutstanding;
+
+    /**
+     The job to remove the directory itself, once the directory has been
+     found and while objects within it are outstanding.  Protected by Mutex.
+     */
+    PRMDIR_JOB DirectoryJob;
+} RMDIR_DIRECTORY, *PRMDIR_DIRECTORY;
+
 BOOL
 RmdirFileEnumerateErrorCallback(
     __in PYORI_STRING FilePath,
@@ -95,25 +216,25 @@ RmdirFileEnumerateErrorCallback(
     );
 
 /**
- A callback that is invoked when a file is found that matches a search criteria
- specified in the set of strings to enumerate.
+ Delete a single file or directory, sending it to the recycle bin if
+ requested, and clearing attributes which prevent deletion if needed.  This
+ may be called on the main thread or on a worker thread.
 
- @param FilePath Pointer to the file path that was found.
+ @param RmdirContext Pointer to the context indicating which delete mode to
+        use.
 
- @param FileInfo Information about the file.
+ @param FilePath Pointer to the object to delete.
 
- @param Depth Specifies the recursion depth.  Ignored in this application.
+ @param FileAttributes The attributes of the object from enumeration.
 
- @param Context Pointer to a RMDIR_CONTEXT.
-
- @return TRUE to continute enumerating, FALSE to abort.
+ @return TRUE if a directory was removed, FALSE if the object was a file or
+         could not be removed.
  */
-BOOL
-RmdirFileFoundCallback(
+BOOLEAN
+RmdirDeleteObject(
+    __in PRMDIR_CONTEXT RmdirContext,
     __in PYORI_STRING FilePath,
-    __in PWIN32_FIND_DATA FileInfo,
-    __in DWORD Depth,
-    __in PVOID Context
+    __in DWORD FileAttributes
     )
 {
     DWORD Err = NO_ERROR;
@@ -121,25 +242,10 @@ RmdirFileFoundCallback(
     DWORD OldAttributes;
     DWORD NewAttributes;
     BOOL FileDeleted;
-    PRMDIR_CONTEXT RmdirContext = (PRMDIR_CONTEXT)Context;
-
-    //
-    //  Don't delete any files that are specified on the command line
-    //  directly.  These can be deleted if they're enumerated underneath
-    //  a parent object.
-    //
-
-    if ((FileInfo->dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == 0 &&
-        Depth == 0 &&
-        !RmdirContext->DeleteFiles) {
-
-        RmdirFileEnumerateErrorCallback(FilePath, ERROR_DIRECTORY, Depth, Context);
-        return TRUE;
-    }
-
-    ASSERT(YoriLibIsStringNullTerminated(FilePath));
+    BOOLEAN DirectoryRemoved;
 
     FileDeleted = FALSE;
+    DirectoryRemoved = FALSE;
 
     //
     //  Try to delete it.
@@ -147,8 +253,8 @@ RmdirFileFoundCallback(
 
     if (RmdirContext->RecycleBin) {
         if (YoriLibRecycleBinFile(FilePath)) {
-            if ((FileInfo->dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0) {
-                RmdirContext->DirectoriesRemoved++;
+            if ((FileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0) {
+                DirectoryRemoved = TRUE;
             }
             FileDeleted = TRUE;
         }
@@ -158,10 +264,10 @@ RmdirFileFoundCallback(
         if (RmdirContext->PosixSemantics) {
             if (!YoriLibPosixDeleteFile(FilePath)) {
                 Err = GetLastError();
-            } else if ((FileInfo->dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0) {
-                RmdirContext->DirectoriesRemoved++;
+            } else if ((FileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0) {
+                DirectoryRemoved = TRUE;
             }
-        } else if ((FileInfo->dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == 0) {
+        } else if ((FileAttributes & FILE_ATTRIBUTE_DIRECTORY) == 0) {
             if (!DeleteFile(FilePath->StartOfString)) {
                 Err = GetLastError();
             }
@@ -169,7 +275,7 @@ RmdirFileFoundCallback(
             if (!RemoveDirectory(FilePath->StartOfString)) {
                 Err = GetLastError();
             } else {
-                RmdirContext->DirectoriesRemoved++;
+                DirectoryRemoved = TRUE;
             }
         }
     }
@@ -191,7 +297,7 @@ RmdirFileFoundCallback(
 
             Err = NO_ERROR;
 
-            if ((FileInfo->dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == 0) {
+            if ((FileAttributes & FILE_ATTRIBUTE_DIRECTORY) == 0) {
                 if (!DeleteFile(FilePath->StartOfString)) {
                     Err = GetLastError();
                 }
@@ -199,7 +305,7 @@ RmdirFileFoundCallback(
                 if (!RemoveDirectory(FilePath->StartOfString)) {
                     Err = GetLastError();
                 } else {
-                    RmdirContext->DirectoriesRemoved++;
+                    DirectoryRemoved = TRUE;
                 }
             }
 
@@ -215,13 +321,464 @@ RmdirFileFoundCallback(
 
     if (Err != NO_ERROR) {
         ErrText = YoriLibGetWinErrorText(Err);
-        if ((FileInfo->dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == 0) {
+        if ((FileAttributes & FILE_ATTRIBUTE_DIRECTORY) == 0) {
             YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("rmdir: delete failed: %y: %s"), FilePath, ErrText);
         } else {
             YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("rmdir: rmdir failed: %y: %s"), FilePath, ErrText);
         }
         YoriLibFreeWinErrorText(ErrText);
     }
+    return DirectoryRemoved;
+}
+
+/**
+ Add a job to the list of jobs for workers to process.  The caller must
+ hold the mutex.
+
+ @param RmdirContext Pointer to the rmdir context.
+
+ @param Job Pointer to the job to add.
+ */
+VOID
+RmdirQueueJobLocked(
+    __in PRMDIR_CONTEXT RmdirContext,
+    __in PRMDIR_JOB Job
+    )
+{
+    YoriLibAppendList(&RmdirContext->PendingList, &Job->PendingListEntry);
+    RmdirContext->JobsOutstanding++;
+    ReleaseSemaphore(RmdirContext->WorkAvailableSemaphore, 1, NULL);
+}
+
+/**
+ A worker thread which deletes objects that have been found by the main
+ thread.  When the last object within a directory has been processed, the
+ directory itself is queued for deletion.
+
+ @param Parameter Pointer to the rmdir context.
+
+ @return Exit code for the thread, currently always zero.
+ */
+DWORD WINAPI
+RmdirWorkerThread(
+    __in LPVOID Parameter
+    )
+{
+    PRMDIR_CONTEXT RmdirContext;
+    PYORI_LIST_ENTRY ListEntry;
+    PRMDIR_JOB Job;
+    PRMDIR_DIRECTORY Parent;
+    BOOLEAN DirectoryRemoved;
+
+    RmdirContext = (PRMDIR_CONTEXT)Parameter;
+
+    while (TRUE) {
+        WaitForSingleObject(RmdirContext->WorkAvailableSemaphore, INFINITE);
+
+        WaitForSingleObject(RmdirContext->Mutex, INFINITE);
+        ListEntry = YoriLibGetNextListEntry(&RmdirContext->PendingList, NULL);
+        if (ListEntry == NULL) {
+            ReleaseMutex(RmdirContext->Mutex);
+            if (RmdirContext->Terminate) {
+                break;
+            }
+            continue;
+        }
+        YoriLibRemoveListItem(ListEntry);
+        ReleaseMutex(RmdirContext->Mutex);
+
+        Job = CONTAINING_RECORD(ListEntry, RMDIR_JOB, PendingListEntry);
+        DirectoryRemoved = RmdirDeleteObject(RmdirContext, &Job->FilePath, Job->FileAttributes);
+
+        WaitForSingleObject(RmdirContext->Mutex, INFINITE);
+        if (DirectoryRemoved) {
+            RmdirContext->DirectoriesRemoved++;
+        }
+
+        //
+        //  If this was the last outstanding child of a directory which has
+        //  already been found, the directory can now be removed.  Queue it
+        //  before this job is marked complete so the number of outstanding
+        //  jobs doesn't reach zero while there is still work to do.
+        //
+
+        Parent = Job->Parent;
+        if (Parent != NULL) {
+            ASSERT(Parent->ChildrenOutstanding > 0);
+            Parent->ChildrenOutstanding--;
+            if (Parent->ChildrenOutstanding == 0 && Parent->DirectoryJob != NULL) {
+                RmdirQueueJobLocked(RmdirContext, Parent->DirectoryJob);
+                YoriLibFree(Parent);
+            }
+        }
+        RmdirContext->JobsOutstanding--;
+        ReleaseMutex(RmdirContext->Mutex);
+        SetEvent(RmdirContext->JobCompleteEvent);
+        YoriLibFree(Job);
+    }
+
+    return 0;
+}
+
+/**
+ Wait for queued deletes to complete until no more than a specified number
+ remain outstanding.
+
+ @param RmdirContext Pointer to the rmdir context.
+
+ @param JobsToLeaveOutstanding The number of jobs which may remain incomplete
+        when this function returns.  Zero waits for all jobs to complete.
+ */
+VOID
+RmdirCompleteJobs(
+    __in PRMDIR_CONTEXT RmdirContext,
+    __in DWORD JobsToLeaveOutstanding
+    )
+{
+    if (RmdirContext->Mutex == NULL) {
+        return;
+    }
+
+    while (TRUE) {
+        WaitForSingleObject(RmdirContext->Mutex, INFINITE);
+        if (RmdirContext->JobsOutstanding <= JobsToLeaveOutstanding) {
+            ReleaseMutex(RmdirContext->Mutex);
+            break;
+        }
+        ReleaseMutex(RmdirContext->Mutex);
+
+        WaitForSingleObject(RmdirContext->JobCompleteEvent, INFINITE);
+    }
+}
+
+/**
+ Find the tracking structure for a directory whose contents are being
+ enumerated, optionally creating it if it does not exist.  Because the
+ enumeration is depth first, the directory is normally the most recently
+ created one.
+
+ @param RmdirContext Pointer to the rmdir context.
+
+ @param DirPath Pointer to the full path of the directory.
+
+ @param Create If TRUE, a new structure is created if none exists.
+
+ @return Pointer to the directory structure, or NULL if it does not exist
+         and could not be created.
+ */
+PRMDIR_DIRECTORY
+RmdirFindDirectory(
+    __in PRMDIR_CONTEXT RmdirContext,
+    __in PYORI_STRING DirPath,
+    __in BOOLEAN Create
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PRMDIR_DIRECTORY Directory;
+    YORI_MAX_UNSIGNED_T BytesNeeded;
+
+    ListEntry = YoriLibGetPreviousListEntry(&RmdirContext->DirectoryStack, NULL);
+    while (ListEntry != NULL) {
+        Directory = CONTAINING_RECORD(ListEntry, RMDIR_DIRECTORY, StackEntry);
+        if (YoriLibCompareStringIns(&Directory->Path, DirPath) == 0) {
+            return Directory;
+        }
+        ListEntry = YoriLibGetPreviousListEntry(&RmdirContext->DirectoryStack, ListEntry);
+    }
+
+    if (!Create) {
+        return NULL;
+    }
+
+    BytesNeeded = sizeof(RMDIR_DIRECTORY);
+    BytesNeeded += ((YORI_MAX_UNSIGNED_T)DirPath->LengthInChars + 1) * sizeof(TCHAR);
+    if (!YoriLibIsSizeAllocatable(BytesNeeded)) {
+        return NULL;
+    }
+
+    Directory = YoriLibMalloc((YORI_ALLOC_SIZE_T)BytesNeeded);
+    if (Directory == NULL) {
+        return NULL;
+    }
+
+    YoriLibInitEmptyString(&Directory->Path);
+    Directory->Path.StartOfString = (LPTSTR)(Directory + 1);
+    Directory->Path.LengthInChars = DirPath->LengthInChars;
+    Directory->Path.LengthAllocated = DirPath->LengthInChars + 1;
+    memcpy(Directory->Path.StartOfString, DirPath->StartOfString, DirPath->LengthInChars * sizeof(TCHAR));
+    Directory->Path.StartOfString[Directory->Path.LengthInChars] = '\0';
+    Directory->ChildrenOutstanding = 0;
+    Directory->DirectoryJob = NULL;
+
+    YoriLibAppendList(&RmdirContext->DirectoryStack, &Directory->StackEntry);
+    return Directory;
+}
+
+/**
+ Queue an object to be deleted by a worker thread.  Files are queued
+ immediately.  Directories are queued once every object found within them
+ has been processed.  If too many deletes are outstanding, this waits for
+ some to complete, so the rate of requests sent to the file system is
+ bounded by the number of workers.
+
+ @param RmdirContext Pointer to the rmdir context.
+
+ @param FilePath Pointer to the object to delete.
+
+ @param FileAttributes The attributes of the object from enumeration.
+
+ @param Depth The recursion depth of the object.  Objects at depth zero were
+        specified by the user and are not within a directory being deleted.
+
+ @return TRUE to indicate the job was queued, FALSE if it could not be.
+ */
+BOOL
+RmdirQueueObject(
+    __in PRMDIR_CONTEXT RmdirContext,
+    __in PYORI_STRING FilePath,
+    __in DWORD FileAttributes,
+    __in DWORD Depth
+    )
+{
+    PRMDIR_JOB Job;
+    PRMDIR_DIRECTORY Parent;
+    PRMDIR_DIRECTORY Directory;
+    YORI_STRING ParentPath;
+    LPTSTR FinalSeperator;
+    YORI_MAX_UNSIGNED_T BytesNeeded;
+
+    Parent = NULL;
+    if (Depth > 0) {
+        FinalSeperator = YoriLibFindRightMostCharacter(FilePath, '\\');
+        if (FinalSeperator != NULL) {
+            YoriLibInitEmptyString(&ParentPath);
+            ParentPath.StartOfString = FilePath->StartOfString;
+            ParentPath.LengthInChars = (YORI_ALLOC_SIZE_T)(FinalSeperator - FilePath->StartOfString);
+            Parent = RmdirFindDirectory(RmdirContext, &ParentPath, TRUE);
+            if (Parent == NULL) {
+                return FALSE;
+            }
+        }
+    }
+
+    BytesNeeded = sizeof(RMDIR_JOB);
+    BytesNeeded += ((YORI_MAX_UNSIGNED_T)FilePath->LengthInChars + 1) * sizeof(TCHAR);
+
+    if (!YoriLibIsSizeAllocatable(BytesNeeded)) {
+        return FALSE;
+    }
+
+    Job = YoriLibMalloc((YORI_ALLOC_SIZE_T)BytesNeeded);
+    if (Job == NULL) {
+        return FALSE;
+    }
+
+    YoriLibInitEmptyString(&Job->FilePath);
+    Job->FilePath.StartOfString = (LPTSTR)(Job + 1);
+    Job->FilePath.LengthInChars = FilePath->LengthInChars;
+    Job->FilePath.LengthAllocated = FilePath->LengthInChars + 1;
+    memcpy(Job->FilePath.StartOfString, FilePath->StartOfString, FilePath->LengthInChars * sizeof(TCHAR));
+    Job->FilePath.StartOfString[Job->FilePath.LengthInChars] = '\0';
+    Job->FileAttributes = FileAttributes;
+    Job->Parent = Parent;
+
+    //
+    //  Directories are returned after their contents.  If any contents are
+    //  still being deleted, attach this job to the directory so the last
+    //  one to complete queues it.  Once the directory has been found,
+    //  nothing more will be found within it, so stop tracking it here.
+    //
+
+    Directory = NULL;
+    if (FileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+        Directory = RmdirFindDirectory(RmdirContext, FilePath, FALSE);
+        if (Directory != NULL) {
+            YoriLibRemoveListItem(&Directory->StackEntry);
+        }
+    }
+
+    WaitForSingleObject(RmdirContext->Mutex, INFINITE);
+    if (Parent != NULL) {
+        Parent->ChildrenOutstanding++;
+    }
+    if (Directory != NULL && Directory->ChildrenOutstanding > 0) {
+        Directory->DirectoryJob = Job;
+    } else {
+        RmdirQueueJobLocked(RmdirContext, Job);
+        if (Directory != NULL) {
+            YoriLibFree(Directory);
+        }
+    }
+    ReleaseMutex(RmdirContext->Mutex);
+
+    RmdirCompleteJobs(RmdirContext, RmdirContext->WorkerCount * 4);
+    return TRUE;
+}
+
+/**
+ Create the worker threads used to delete objects.
+
+ @param RmdirContext Pointer to the rmdir context indicating the number of
+        workers to create.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+RmdirStartWorkers(
+    __in PRMDIR_CONTEXT RmdirContext
+    )
+{
+    DWORD ThreadId;
+
+    RmdirContext->Mutex = CreateMutex(NULL, FALSE, NULL);
+    if (RmdirContext->Mutex == NULL) {
+        return FALSE;
+    }
+
+    RmdirContext->WorkAvailableSemaphore = CreateSemaphore(NULL, 0, 0x7FFFFFFF, NULL);
+    if (RmdirContext->WorkAvailableSemaphore == NULL) {
+        return FALSE;
+    }
+
+    RmdirContext->JobCompleteEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+    if (RmdirContext->JobCompleteEvent == NULL) {
+        return FALSE;
+    }
+
+    for (RmdirContext->ThreadCount = 0; RmdirContext->ThreadCount < RmdirContext->WorkerCount; RmdirContext->ThreadCount++) {
+        RmdirContext->Threads[RmdirContext->ThreadCount] = CreateThread(NULL, 0, RmdirWorkerThread, RmdirContext, 0, &ThreadId);
+        if (RmdirContext->Threads[RmdirContext->ThreadCount] == NULL) {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+/**
+ Wait for all queued objects to be deleted, terminate worker threads, and
+ free the resources used to communicate with them.
+
+ @param RmdirContext Pointer to the rmdir context.
+ */
+VOID
+RmdirStopWorkers(
+    __in PRMDIR_CONTEXT RmdirContext
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PRMDIR_DIRECTORY Directory;
+    DWORD Index;
+
+    if (RmdirContext->ThreadCount > 0) {
+        RmdirCompleteJobs(RmdirContext, 0);
+
+        WaitForSingleObject(RmdirContext->Mutex, INFINITE);
+        RmdirContext->Terminate = TRUE;
+        ReleaseMutex(RmdirContext->Mutex);
+        ReleaseSemaphore(RmdirContext->WorkAvailableSemaphore, RmdirContext->ThreadCount, NULL);
+
+        for (Index = 0; Index < RmdirContext->ThreadCount; Index++) {
+            WaitForSingleObject(RmdirContext->Threads[Index], INFINITE);
+            CloseHandle(RmdirContext->Threads[Index]);
+            RmdirContext->Threads[Index] = NULL;
+        }
+        RmdirContext->ThreadCount = 0;
+    }
+
+    //
+    //  Any directories still being tracked were not themselves found, so
+    //  there is no further work for them.
+    //
+
+    ListEntry = YoriLibGetNextListEntry(&RmdirContext->DirectoryStack, NULL);
+    while (ListEntry != NULL) {
+        YoriLibRemoveListItem(ListEntry);
+        Directory = CONTAINING_RECORD(ListEntry, RMDIR_DIRECTORY, StackEntry);
+        YoriLibFree(Directory);
+        ListEntry = YoriLibGetNextListEntry(&RmdirContext->DirectoryStack, NULL);
+    }
+
+    if (RmdirContext->JobCompleteEvent != NULL) {
+        CloseHandle(RmdirContext->JobCompleteEvent);
+        RmdirContext->JobCompleteEvent = NULL;
+    }
+
+    if (RmdirContext->WorkAvailableSemaphore != NULL) {
+        CloseHandle(RmdirContext->WorkAvailableSemaphore);
+        RmdirContext->WorkAvailableSemaphore = NULL;
+    }
+
+    if (RmdirContext->Mutex != NULL) {
+        CloseHandle(RmdirContext->Mutex);
+        RmdirContext->Mutex = NULL;
+    }
+}
+
+/**
+ A callback that is invoked when a file is found that matches a search criteria
+ specified in the set of strings to enumerate.
+
+ @param FilePath Pointer to the file path that was found.
+
+ @param FileInfo Information about the file.
+
+ @param Depth Specifies the recursion depth.
+
+ @param Context Pointer to a RMDIR_CONTEXT.
+
+ @return TRUE to continute enumerating, FALSE to abort.
+ */
+BOOL
+RmdirFileFoundCallback(
+    __in PYORI_STRING FilePath,
+    __in PWIN32_FIND_DATA FileInfo,
+    __in DWORD Depth,
+    __in PVOID Context
+    )
+{
+    PRMDIR_CONTEXT RmdirContext = (PRMDIR_CONTEXT)Context;
+
+    //
+    //  Don't delete any files that are specified on the command line
+    //  directly.  These can be deleted if they're enumerated underneath
+    //  a parent object.
+    //
+
+    if ((FileInfo->dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == 0 &&
+        Depth == 0 &&
+        !RmdirContext->DeleteFiles) {
+
+        RmdirFileEnumerateErrorCallback(FilePath, ERROR_DIRECTORY, Depth, Context);
+        return TRUE;
+    }
+
+    ASSERT(YoriLibIsStringNullTerminated(FilePath));
+
+    if (RmdirContext->ThreadCount > 0) {
+        if (RmdirQueueObject(RmdirContext, FilePath, FileInfo->dwFileAttributes, Depth)) {
+            return TRUE;
+        }
+
+        //
+        //  If the object couldn't be queued, wait for everything queued so
+        //  far, so a directory isn't removed ahead of its contents.
+        //
+
+        RmdirCompleteJobs(RmdirContext, 0);
+    }
+
+    if (RmdirDeleteObject(RmdirContext, FilePath, FileInfo->dwFileAttributes)) {
+        if (RmdirContext->Mutex != NULL) {
+            WaitForSingleObject(RmdirContext->Mutex, INFINITE);
+            RmdirContext->DirectoriesRemoved++;
+            ReleaseMutex(RmdirContext->Mutex);
+        } else {
+            RmdirContext->DirectoriesRemoved++;
+        }
+    }
+
     return TRUE;
 }
 
@@ -319,8 +876,13 @@ ENTRYPOINT(
     YORI_ALLOC_SIZE_T i;
     RMDIR_CONTEXT RmdirContext;
     YORI_STRING Arg;
+    YORI_MAX_SIGNED_T Temp;
+    YORI_ALLOC_SIZE_T CharsConsumed;
 
     ZeroMemory(&RmdirContext, sizeof(RmdirContext));
+    RmdirContext.WorkerCount = 1;
+    YoriLibInitializeListHead(&RmdirContext.PendingList);
+    YoriLibInitializeListHead(&RmdirContext.DirectoryStack);
 
     Recursive = FALSE;
     BasicEnumeration = FALSE;
@@ -345,6 +907,21 @@ ENTRYPOINT(
             } else if (YoriLibCompareStringLitIns(&Arg, _T("f")) == 0) {
                 ArgumentUnderstood = TRUE;
                 RmdirContext.DeleteFiles = TRUE;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("j")) == 0) {
+                if (i + 1 < ArgC) {
+                    if (YoriLibStringToNumber(&ArgV[i + 1], TRUE, &Temp, &CharsConsumed) &&
+                        CharsConsumed > 0) {
+
+                        if (Temp < 1) {
+                            Temp = 1;
+                        } else if (Temp > RMDIR_MAX_WORKERS) {
+                            Temp = RMDIR_MAX_WORKERS;
+                        }
+                        RmdirContext.WorkerCount = (DWORD)Temp;
+                        ArgumentUnderstood = TRUE;
+                        i++;
+                    }
+                }
             } else if (YoriLibCompareStringLitIns(&Arg, _T("l")) == 0) {
                 DeleteLinks = TRUE;
                 ArgumentUnderstood = TRUE;
@@ -391,6 +968,20 @@ ENTRYPOINT(
         return EXIT_FAILURE;
     }
 
+    //
+    //  The recycle bin is implemented by the shell, which is not expected
+    //  to be called from many threads at once, so only delete directly in
+    //  parallel.
+    //
+
+    if (RmdirContext.WorkerCount > 1 && !RmdirContext.RecycleBin) {
+        if (!RmdirStartWorkers(&RmdirContext)) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("rmdir: could not create worker threads\n"));
+            RmdirStopWorkers(&RmdirContext);
+            return EXIT_FAILURE;
+        }
+    }
+
     MatchFlags = YORILIB_FILEENUM_RETURN_DIRECTORIES;
     if (RmdirContext.DeleteFiles) {
         MatchFlags |= YORILIB_FILEENUM_RETURN_FILES;
@@ -414,6 +1005,8 @@ ENTRYPOINT(
                            &RmdirContext);
     }
 
+    RmdirStopWorkers(&RmdirContext);
+
     if (RmdirContext.DirectoriesRemoved == 0) {
         return EXIT_FAILURE;
     }
@@ -93,9 +93,16 @@ SdirSetConsoleTextAttribute(
     return YoriLibVtSetConsoleTextAttrDev(hConsole, 0, Attribute.Ctrl, Attribute.Win32Attr);
 }
 
+/**
+ The number of characters to accumulate before writing to the output device.
+ This is enough for a full line of text with a few color changes.
+ */
+#define SDIR_WRITE_BUFFER_CHARS (SDIR_MAX_WIDTH * 2)
+
 /**
  Write a string of characters with color attribute information to the current
- output device.
+ output device.  The characters are converted to a single string containing
+ VT escapes for each change in color, which is written to the device at once.
 
  @param str Pointer to the string of characters to write.
 
@@ -110,46 +117,63 @@ SdirWrite (
     )
 {
     HANDLE hConsole = GetStdHandle(STD_OUTPUT_HANDLE);
-    YORI_ALLOC_SIZE_T i, j;
-
-    YORILIB_COLOR_ATTRIBUTES CacheAttr;
-    TCHAR CharCache[64];
+    YORI_ALLOC_SIZE_T i;
+    YORI_STRING Output;
+    YORI_STRING Escape;
+    TCHAR Buffer[SDIR_WRITE_BUFFER_CHARS];
 
-    CacheAttr.Ctrl = SdirDefaultColor.Ctrl;
-    CacheAttr.Win32Attr = SdirDefaultColor.Win32Attr;
+    YoriLibInitEmptyString(&Output);
+    Output.StartOfString = Buffer;
+    Output.LengthAllocated = sizeof(Buffer)/sizeof(Buffer[0]);
 
     //
-    //  We firstly load as much as we can into a stack buffer, then write it
-    //  out.  Those syscalls are expensive - run in a slow VM to see.  We
-    //  have to write out the buffer either when the next character has 
-    //  different color (so we can't use the same WriteConsole call) or when
-    //  the stack buffer is full.
+    //  Each call to the output device is expensive, and the device needs
+    //  to be queried on each call to determine how to process escapes.
+    //  Build as much as possible into a single string, including escapes
+    //  to change color, and write it in one call.  If the buffer fills,
+    //  write what has been built so far and keep going.
     //
 
-    j = 0;
-    for (i = 0; i < count; i++) { 
+    for (i = 0; i < count; i++) {
+
+        if (Output.LengthAllocated - Output.LengthInChars < YORI_MAX_VT_ESCAPE_CHARS + 1) {
+            SdirWriteRawStringToOutputDevice(hConsole, Output.StartOfString, Output.LengthInChars);
+            Output.LengthInChars = 0;
+        }
+
+        if (!YoriLibAreColorsIdentical(str[i].Attr, SdirCurrentAttribute)) {
 
-        CacheAttr.Ctrl = str[i].Attr.Ctrl;
-        CacheAttr.Win32Attr = str[i].Attr.Win32Attr;
-        CharCache[j] = str[i].Char;
-        j++;
+            SdirCurrentAttribute.Ctrl = str[i].Attr.Ctrl;
+            SdirCurrentAttribute.Win32Attr = str[i].Attr.Win32Attr;
 
-        if (( i + 1 < count && !YoriLibAreColorsIdentical(str[i + 1].Attr, CacheAttr)) || (j >= sizeof(CharCache)/sizeof(CharCache[0]))) {
+            YoriLibInitEmptyString(&Escape);
+            Escape.StartOfString = &Output.StartOfString[Output.LengthInChars];
+            Escape.LengthAllocated = Output.LengthAllocated - Output.LengthInChars;
 
-            SdirSetConsoleTextAttribute(hConsole, CacheAttr);
-            SdirWriteRawStringToOutputDevice(hConsole, CharCache, j);
-            j = 0;
+            //
+            //  Because the escape is generated into the remaining buffer,
+            //  which was checked to be large enough above, this shouldn't
+            //  fail.
+            //
+
+            if (!YoriLibVtStringForTextAttribute(&Escape, SdirCurrentAttribute.Ctrl, SdirCurrentAttribute.Win32Attr)) {
+                ASSERT(FALSE);
+                return FALSE;
+            }
+            ASSERT(Escape.StartOfString == &Output.StartOfString[Output.LengthInChars]);
+            Output.LengthInChars = Output.LengthInChars + Escape.LengthInChars;
         }
+
+        Output.StartOfString[Output.LengthInChars] = str[i].Char;
+        Output.LengthInChars++;
     }
 
     //
     //  If we have anything left, flush it now.
     //
 
-    if (j > 0) {
-
-        SdirSetConsoleTextAttribute(hConsole, CacheAttr);
-        SdirWriteRawStringToOutputDevice(hConsole, CharCache, j);
+    if (Output.LengthInChars > 0) {
+        SdirWriteRawStringToOutputDevice(hConsole, Output.StartOfString, Output.LengthInChars);
     }
 
     return TRUE;
@@ -213,6 +213,15 @@ SdirOptInitialize(VOID)
 
     Opts->MetadataWidth = 1;  // Column seperator
 
+    //
+    //  If any sort order was requested, output can't be streamed because
+    //  all entries need to be found before any can be displayed.
+    //
+
+    if (Opts->CurrentSort > 0) {
+        Opts->StreamOutput = FALSE;
+    }
+
     //
     //  If no sorting algorithm was used, use the default that
     //  we prepopulated.
@@ -351,6 +360,9 @@ SdirParseOpt (
             Opts->TraverseLinks = TRUE;
             OptParsed = TRUE;
         }
+    } else if (Opt[0] == 's' && _tcsicmp(&Opt[1], _T("u")) == 0) {
+        Opts->StreamOutput = TRUE;
+        OptParsed = TRUE;
     } else if (Opt[0] == 's' || Opt[0] == 'i') {
 
         //
@@ -610,6 +622,11 @@ SdirAppCleanup(VOID)
     YoriLibFileFiltFreeFilter(&SdirGlobal.FileColorCriteria);
     YoriLibFileFiltFreeFilter(&SdirGlobal.FileHideCriteria);
 
+    if (SdirGlobal.CollectQueue != NULL) {
+        YoriLibFileInfoQueueDestroy(SdirGlobal.CollectQueue);
+        SdirGlobal.CollectQueue = NULL;
+    }
+
     if (SdirDirCollection != NULL) {
         YoriLibFree(SdirDirCollection);
         SdirDirCollection = NULL;
@@ -43,8 +43,9 @@ PYORI_FILE_INFO SdirDirCollection;
 
 /**
  Pointer to an array of pointers to directory entries.  These pointers
- are maintained sorted based on the user's sort criteria so that files
- can be displayed in order from this indirection.
+ are recorded in enumeration order and sorted based on the user's sort
+ criteria before display so that files can be displayed in order from this
+ indirection.
  */
 PYORI_FILE_INFO * SdirDirSorted;
 
@@ -87,6 +88,9 @@ SDIR_GLOBAL SdirGlobal;
 BOOL
 SdirDisplayCollection(VOID);
 
+VOID
+SdirStreamCollection(VOID);
+
 /**
  Capture all required information from a file found by the system into a
  directory entry.
@@ -96,6 +100,10 @@ SdirDisplayCollection(VOID);
 
  @param FindData Information returned by the system when enumerating files.
 
+ @param FindDataEx Optionally points to extended information returned by a
+        bulk enumerate.  If present, this is used in preference to opening
+        the file where it contains the requested information.
+
  @param FullPath Pointer to a string referring to the full path to the file.
 
  @param ForceDisplay If TRUE, suppress processing to hide the entry because it
@@ -106,6 +114,7 @@ VOID
 SdirCaptureFoundItemIntoDirent (
     __out PYORI_FILE_INFO CurrentEntry,
     __in PWIN32_FIND_DATA FindData,
+    __in_opt PYORILIB_FIND_DATA_EXTENDED FindDataEx,
     __in PYORI_STRING FullPath,
     __in BOOL ForceDisplay
     ) 
@@ -130,6 +139,12 @@ SdirCaptureFoundItemIntoDirent (
         if ((Feature->Flags & SDIR_FEATURE_COLLECT) &&
                SdirOptions[i].CollectFn) {
 
+            if (FindDataEx != NULL &&
+                YoriLibCollectFromFindDataExtended(CurrentEntry, FindDataEx, SdirOptions[i].CollectFn)) {
+
+                continue;
+            }
+
             SdirOptions[i].CollectFn(CurrentEntry, FindData, FullPath);
         }
     }
@@ -165,7 +180,7 @@ SdirRenderAttributesFromPath (
 
     hFind = FindFirstFile(FullPath->StartOfString, &FindData);
     if (hFind != INVALID_HANDLE_VALUE) {
-        SdirCaptureFoundItemIntoDirent(&CurrentEntry, &FindData, FullPath, TRUE);
+        SdirCaptureFoundItemIntoDirent(&CurrentEntry, &FindData, NULL, FullPath, TRUE);
         FindClose(hFind);
         OutAttributes->Ctrl = CurrentEntry.RenderAttributes.Ctrl;
         OutAttributes->Win32Attr = CurrentEntry.RenderAttributes.Win32Attr;
@@ -182,7 +197,7 @@ SdirRenderAttributesFromPath (
         memset(&FindData, 0, sizeof(FindData));
         DummyString.LengthInChars = YoriLibSPrintfS(DummyString.StartOfString, DummyString.LengthAllocated, _T("%s\\"), FullPath);
         YoriLibUpdateFindDataFromFileInformation(&FindData, DummyString.StartOfString, FALSE);
-        SdirCaptureFoundItemIntoDirent(&CurrentEntry, &FindData, &DummyString, TRUE);
+        SdirCaptureFoundItemIntoDirent(&CurrentEntry, &FindData, NULL, &DummyString, TRUE);
         YoriLibFreeStringContents(&DummyString);
         OutAttributes->Ctrl = CurrentEntry.RenderAttributes.Ctrl;
         OutAttributes->Win32Attr = CurrentEntry.RenderAttributes.Win32Attr;
@@ -191,11 +206,112 @@ SdirRenderAttributesFromPath (
 }
 
 /**
- Add a single found object to the set of files found so far.
+ Record a directory entry that has been populated in the next slot of the
+ collection, updating the state of the collection to include it.  If the
+ entry is hidden, the slot is released for the next entry.
+
+ @param CurrentEntry Pointer to the directory entry, which must be the most
+        recently allocated slot in the collection.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+SdirCompleteCollectedEntry (
+    __in PYORI_FILE_INFO CurrentEntry
+    )
+{
+    ASSERT(CurrentEntry == &SdirDirCollection[SdirDirCollectionCurrent - 1]);
+
+    if (CurrentEntry->RenderAttributes.Ctrl & YORILIB_ATTRCTRL_HIDE) {
+
+        SdirDirCollectionCurrent--;
+        return TRUE;
+    }
+
+    if (CurrentEntry->FileNameLengthInChars > SdirDirCollectionLongest) {
+        SdirDirCollectionLongest = CurrentEntry->FileNameLengthInChars;
+    }
+
+    SdirDirCollectionTotalNameLength += CurrentEntry->FileNameLengthInChars;
+
+    if (Opts->FtSummary.Flags & SDIR_FEATURE_COLLECT) {
+        SdirCollectSummary(CurrentEntry);
+    }
+
+    //
+    //  Entries are recorded in the order they are found.  They are sorted
+    //  according to the user's criteria once the collection is complete
+    //  and is about to be displayed.
+    //
+
+    SdirDirSorted[SdirDirCollectionCurrent - 1] = CurrentEntry;
+
+    //
+    //  If output is being streamed, display entries once the collection is
+    //  full rather than growing it.
+    //
+
+    if (Opts->StreamOutput && SdirDirCollectionCurrent >= SdirAllocatedDirents) {
+        SdirStreamCollection();
+    }
+    return TRUE;
+}
+
+/**
+ A callback invoked when information about a file submitted to the
+ collection queue has been collected.  This is invoked on the enumerating
+ thread, in the order that files were found.
+
+ @param Entry Pointer to the collected information about the file.
+
+ @param FindData Pointer to the block of data returned from the directory as
+        part of the enumeration.
+
+ @param FullPath Pointer to a fully specified file name for the file.
+
+ @param Context Unused.
+ */
+VOID
+SdirQueuedEntryCollected(
+    __in PYORI_FILE_INFO Entry,
+    __in PWIN32_FIND_DATA FindData,
+    __in PYORI_STRING FullPath,
+    __in PVOID Context
+    )
+{
+    PYORI_FILE_INFO CurrentEntry;
+
+    UNREFERENCED_PARAMETER(FindData);
+    UNREFERENCED_PARAMETER(FullPath);
+    UNREFERENCED_PARAMETER(Context);
+
+    if (SdirDirCollectionCurrent >= SdirAllocatedDirents) {
+        if (SdirDirCollectionCurrent < ((YORI_ALLOC_SIZE_T)-1)) {
+            SdirDirCollectionCurrent++;
+        }
+        return;
+    }
+
+    CurrentEntry = &SdirDirCollection[SdirDirCollectionCurrent];
+
+    SdirDirCollectionCurrent++;
+
+    memcpy(CurrentEntry, Entry, sizeof(YORI_FILE_INFO));
+    SdirApplyAttribute(CurrentEntry, FALSE, &CurrentEntry->RenderAttributes);
+    SdirCompleteCollectedEntry(CurrentEntry);
+}
+
+/**
+ Add a single found object to the set of files found so far.  If a
+ collection queue is in use, the object is submitted to it and is added to
+ the collection once its information has been collected.
 
  @param FindData Pointer to the block of data returned from the directory as
         part of the enumeration.
 
+ @param FindDataEx Optionally points to extended information returned by a
+        bulk enumerate.
+
  @param FullPath Pointer to a fully specified file name for the file.
 
  @return TRUE to indicate success, FALSE to indicate failure.
@@ -203,12 +319,24 @@ SdirRenderAttributesFromPath (
 BOOL
 SdirAddToCollection (
     __in PWIN32_FIND_DATA FindData,
+    __in_opt PYORILIB_FIND_DATA_EXTENDED FindDataEx,
     __in PYORI_STRING FullPath
     ) 
 {
     PYORI_FILE_INFO CurrentEntry;
-    YORI_ALLOC_SIZE_T i, j;
-    DWORD CompareResult = 0;
+
+    if (SdirGlobal.CollectQueue != NULL) {
+        if (YoriLibFileInfoQueueSubmit(SdirGlobal.CollectQueue, FindData, FindDataEx, FullPath)) {
+            return TRUE;
+        }
+
+        //
+        //  If the file can't be queued, collect it here, after any files
+        //  found before it.
+        //
+
+        YoriLibFileInfoQueueFlush(SdirGlobal.CollectQueue);
+    }
 
     if (SdirDirCollectionCurrent >= SdirAllocatedDirents) {
         if (SdirDirCollectionCurrent < ((YORI_ALLOC_SIZE_T)-1)) {
@@ -221,66 +349,436 @@ SdirAddToCollection (
 
     SdirDirCollectionCurrent++;
 
-    SdirCaptureFoundItemIntoDirent(CurrentEntry, FindData, FullPath, FALSE);
+    SdirCaptureFoundItemIntoDirent(CurrentEntry, FindData, FindDataEx, FullPath, FALSE);
+    return SdirCompleteCollectedEntry(CurrentEntry);
+}
 
-    if (CurrentEntry->RenderAttributes.Ctrl & YORILIB_ATTRCTRL_HIDE) {
+/**
+ Wait for any files submitted to the collection queue to be added to the
+ collection.  This must be called after each enumerate, before the
+ collection is examined or reallocated.  The last error is preserved so
+ that enumerate failures can be reported after this call.
+ */
+VOID
+SdirCompleteQueuedCollection(VOID)
+{
+    DWORD LastError;
 
-        SdirDirCollectionCurrent--;
-        return TRUE;
+    if (SdirGlobal.CollectQueue != NULL) {
+        LastError = GetLastError();
+        YoriLibFileInfoQueueFlush(SdirGlobal.CollectQueue);
+        SetLastError(LastError);
     }
+}
 
-    if (CurrentEntry->FileNameLengthInChars > SdirDirCollectionLongest) {
-        SdirDirCollectionLongest = CurrentEntry->FileNameLengthInChars;
+/**
+ If any information being collected requires opening files, create a pool
+ of threads to collect it so that files can be opened and queried
+ concurrently while enumeration continues.  If this is not beneficial or
+ not possible, information is collected synchronously.
+ */
+VOID
+SdirCreateCollectQueue(VOID)
+{
+    YORI_LIB_FILE_FILT_COLLECT_FN * CollectFns;
+    YORI_ALLOC_SIZE_T CollectFnCount;
+    YORI_ALLOC_SIZE_T Index;
+    PSDIR_FEATURE Feature;
+
+    CollectFns = YoriLibMalloc((YORI_ALLOC_SIZE_T)(SdirGetNumSdirOptions() * sizeof(YORI_LIB_FILE_FILT_COLLECT_FN)));
+    if (CollectFns == NULL) {
+        return;
     }
 
-    SdirDirCollectionTotalNameLength += CurrentEntry->FileNameLengthInChars;
+    //
+    //  This must collect the same information as
+    //  SdirCaptureFoundItemIntoDirent.
+    //
 
-    if (Opts->FtSummary.Flags & SDIR_FEATURE_COLLECT) {
-        SdirCollectSummary(CurrentEntry);
+    CollectFnCount = 0;
+    for (Index = 0; Index < SdirGetNumSdirOptions(); Index++) {
+        Feature = SdirFeatureByOptionNumber(Index);
+        if ((Feature->Flags & SDIR_FEATURE_COLLECT) &&
+            SdirOptions[Index].CollectFn) {
+
+            CollectFns[CollectFnCount] = SdirOptions[Index].CollectFn;
+            CollectFnCount++;
+        }
+    }
+
+    SdirGlobal.CollectQueue = YoriLibFileInfoQueueCreate(CollectFns, CollectFnCount, SdirQueuedEntryCollected, NULL);
+    YoriLibFree(CollectFns);
+}
+
+/**
+ The number of entries in each run that is sorted with an insertion sort
+ before the runs are merged together.
+ */
+#define SDIR_SORT_RUN_LENGTH (16)
+
+/**
+ The minimum number of entries in a collection before sorting is split
+ across multiple threads.  Below this point the cost of creating threads
+ exceeds the time spent sorting.
+ */
+#define SDIR_SORT_PARALLEL_THRESHOLD (0x8000)
+
+/**
+ The maximum number of threads to use when sorting a collection.
+ */
+#define SDIR_SORT_MAX_THREADS (8)
+
+/**
+ Check whether one directory entry should be displayed after another,
+ applying each of the user's sort criteria in turn.
+
+ @param Left Pointer to the entry that is currently earlier in the array.
+
+ @param Right Pointer to the entry that is currently later in the array.
+
+ @return TRUE if Left should be displayed after Right, FALSE if Left should
+         be displayed before Right or the two entries are equal in all sort
+         criteria.  Returning FALSE for equal entries keeps the sort stable.
+ */
+BOOLEAN
+SdirIsEntryAfter(
+    __in PYORI_FILE_INFO Left,
+    __in PYORI_FILE_INFO Right
+    )
+{
+    YORI_ALLOC_SIZE_T Index;
+    DWORD CompareResult;
+
+    for (Index = 0; Index < Opts->CurrentSort; Index++) {
+        CompareResult = Opts->Sort[Index].CompareFn(Left, Right);
+
+        if (CompareResult == Opts->Sort[Index].CompareBreakCondition) {
+            return TRUE;
+        }
+
+        if (CompareResult == Opts->Sort[Index].CompareInverseCondition) {
+            return FALSE;
+        }
+    }
+
+    return FALSE;
+}
+
+/**
+ Sort a range of entries with an insertion sort.  This is used for small
+ runs of entries, and as a fallback if memory cannot be allocated to perform
+ a merge sort.
+
+ @param Array Pointer to the array of entries to sort.
+
+ @param Count The number of entries in the array.
+ */
+VOID
+SdirInsertionSortRange(
+    __inout_ecount(Count) PYORI_FILE_INFO * Array,
+    __in YORI_ALLOC_SIZE_T Count
+    )
+{
+    YORI_ALLOC_SIZE_T Index;
+    YORI_ALLOC_SIZE_T Insert;
+    PYORI_FILE_INFO Entry;
+
+    for (Index = 1; Index < Count; Index++) {
+        Entry = Array[Index];
+        Insert = Index;
+        while (Insert > 0 && SdirIsEntryAfter(Array[Insert - 1], Entry)) {
+            Array[Insert] = Array[Insert - 1];
+            Insert--;
+        }
+        Array[Insert] = Entry;
+    }
+}
+
+/**
+ Merge two adjacent sorted runs from a source array into a target array.
+ When entries compare equal, the entry from the first run is taken first so
+ that the merge is stable.
+
+ @param Source Pointer to the array containing the two sorted runs.
+
+ @param Target Pointer to the array to populate with the merged result.
+
+ @param Start The index of the first entry in the first run.
+
+ @param Middle The index of the first entry in the second run.
+
+ @param End The index beyond the last entry in the second run.
+ */
+VOID
+SdirMergeRuns(
+    __in PYORI_FILE_INFO * Source,
+    __out PYORI_FILE_INFO * Target,
+    __in YORI_ALLOC_SIZE_T Start,
+    __in YORI_ALLOC_SIZE_T Middle,
+    __in YORI_ALLOC_SIZE_T End
+    )
+{
+    YORI_ALLOC_SIZE_T Left;
+    YORI_ALLOC_SIZE_T Right;
+    YORI_ALLOC_SIZE_T Dest;
+
+    Left = Start;
+    Right = Middle;
+    Dest = Start;
+
+    while (Left < Middle && Right < End) {
+        if (SdirIsEntryAfter(Source[Left], Source[Right])) {
+            Target[Dest] = Source[Right];
+            Right++;
+        } else {
+            Target[Dest] = Source[Left];
+            Left++;
+        }
+        Dest++;
+    }
+
+    if (Left < Middle) {
+        memcpy(&Target[Dest], &Source[Left], (Middle - Left) * sizeof(PYORI_FILE_INFO));
+    }
+
+    if (Right < End) {
+        memcpy(&Target[Dest], &Source[Right], (End - Right) * sizeof(PYORI_FILE_INFO));
+    }
+}
+
+/**
+ Merge sorted runs of entries until the entire array is sorted.  On entry,
+ each run of RunLength entries within the array must already be sorted.
+ On completion, the sorted result is in Array.
+
+ @param Array Pointer to the array of entries to sort.
+
+ @param Scratch Pointer to a scratch array of the same size as Array.
+
+ @param Count The number of entries in each array.
+
+ @param RunLength The number of entries in each presorted run.
+ */
+VOID
+SdirMergeSortedRuns(
+    __inout_ecount(Count) PYORI_FILE_INFO * Array,
+    __inout_ecount(Count) PYORI_FILE_INFO * Scratch,
+    __in YORI_ALLOC_SIZE_T Count,
+    __in YORI_ALLOC_SIZE_T RunLength
+    )
+{
+    PYORI_FILE_INFO * Source;
+    PYORI_FILE_INFO * Target;
+    PYORI_FILE_INFO * Swap;
+    YORI_ALLOC_SIZE_T Width;
+    YORI_ALLOC_SIZE_T Start;
+    YORI_ALLOC_SIZE_T Middle;
+    YORI_ALLOC_SIZE_T End;
+
+    Source = Array;
+    Target = Scratch;
+
+    for (Width = RunLength; Width < Count; Width = Width * 2) {
+
+        for (Start = 0; Start < Count; Start = End) {
+            if (Count - Start <= Width) {
+                Middle = Count;
+                End = Count;
+            } else {
+                Middle = Start + Width;
+                if (Count - Middle <= Width) {
+                    End = Count;
+                } else {
+                    End = Middle + Width;
+                }
+            }
+
+            SdirMergeRuns(Source, Target, Start, Middle, End);
+        }
+
+        Swap = Source;
+        Source = Target;
+        Target = Swap;
+
+        if (Width > Count / 2) {
+            break;
+        }
+    }
+
+    if (Source != Array) {
+        memcpy(Array, Source, Count * sizeof(PYORI_FILE_INFO));
+    }
+}
+
+/**
+ Sort an array of entries with a stable merge sort.
+
+ @param Array Pointer to the array of entries to sort.
+
+ @param Scratch Pointer to a scratch array of the same size as Array.
+
+ @param Count The number of entries in each array.
+ */
+VOID
+SdirMergeSortRange(
+    __inout_ecount(Count) PYORI_FILE_INFO * Array,
+    __inout_ecount(Count) PYORI_FILE_INFO * Scratch,
+    __in YORI_ALLOC_SIZE_T Count
+    )
+{
+    YORI_ALLOC_SIZE_T Start;
+    YORI_ALLOC_SIZE_T RunCount;
+
+    for (Start = 0; Start < Count; Start = Start + RunCount) {
+        RunCount = Count - Start;
+        if (RunCount > SDIR_SORT_RUN_LENGTH) {
+            RunCount = SDIR_SORT_RUN_LENGTH;
+        }
+        SdirInsertionSortRange(&Array[Start], RunCount);
+    }
+
+    SdirMergeSortedRuns(Array, Scratch, Count, SDIR_SORT_RUN_LENGTH);
+}
+
+/**
+ A range of entries to be sorted by a single thread.
+ */
+typedef struct _SDIR_SORT_CHUNK {
+
+    /**
+     Pointer to the first entry within the sorted array to sort.
+     */
+    PYORI_FILE_INFO * Array;
+
+    /**
+     Pointer to the first entry within the scratch array that corresponds to
+     this range.
+     */
+    PYORI_FILE_INFO * Scratch;
+
+    /**
+     The number of entries in the range.
+     */
+    YORI_ALLOC_SIZE_T Count;
+} SDIR_SORT_CHUNK, *PSDIR_SORT_CHUNK;
+
+/**
+ A thread entrypoint to sort a single range of entries.
+
+ @param Context Pointer to the SDIR_SORT_CHUNK describing the range to sort.
+
+ @return Zero.
+ */
+DWORD WINAPI
+SdirSortChunkWorker(
+    __in LPVOID Context
+    )
+{
+    PSDIR_SORT_CHUNK Chunk = (PSDIR_SORT_CHUNK)Context;
+    SdirMergeSortRange(Chunk->Array, Chunk->Scratch, Chunk->Count);
+    return 0;
+}
+
+/**
+ Sort the collection of entries according to the user's sort criteria.
+ Large collections are split into equally sized ranges which are sorted
+ concurrently, and the sorted ranges are then merged on this thread.
+ */
+VOID
+SdirSortCollection(VOID)
+{
+    PYORI_FILE_INFO * Scratch;
+    SDIR_SORT_CHUNK Chunks[SDIR_SORT_MAX_THREADS];
+    HANDLE Threads[SDIR_SORT_MAX_THREADS];
+    SYSTEM_INFO SystemInfo;
+    YORI_ALLOC_SIZE_T Count;
+    YORI_ALLOC_SIZE_T Index;
+    YORI_ALLOC_SIZE_T ChunkCount;
+    YORI_ALLOC_SIZE_T ChunkLength;
+    DWORD ThreadId;
+
+    Count = SdirDirCollectionCurrent;
+    if (Count <= 1 || Opts->CurrentSort == 0) {
+        return;
     }
 
     //
-    //  Now that our internal entry is fully poulated, insert it into the
-    //  correct sorted position.  As an optimization, check if we just need
-    //  to insert at the end (for file name sort on NTFS, this is the
-    //  common case.)
+    //  Entries are frequently returned in sorted order already, notably
+    //  file name sort on NTFS.  Check for this before doing any work.
     //
 
-    if (SdirDirCollectionCurrent > 1 &&
-        Opts->Sort[0].CompareFn(SdirDirSorted[SdirDirCollectionCurrent - 2], CurrentEntry) == Opts->Sort[0].CompareInverseCondition) {
+    for (Index = 1; Index < Count; Index++) {
+        if (SdirIsEntryAfter(SdirDirSorted[Index - 1], SdirDirSorted[Index])) {
+            break;
+        }
+    }
 
-        SdirDirSorted[SdirDirCollectionCurrent - 1] = CurrentEntry;
-        return TRUE;
+    if (Index == Count) {
+        return;
+    }
+
+    Scratch = YoriLibMalloc(Count * sizeof(PYORI_FILE_INFO));
+    if (Scratch == NULL) {
+        SdirInsertionSortRange(SdirDirSorted, Count);
+        return;
+    }
+
+    ChunkCount = 1;
+    if (Count >= SDIR_SORT_PARALLEL_THRESHOLD) {
+        GetSystemInfo(&SystemInfo);
+        while (ChunkCount * 2 <= SystemInfo.dwNumberOfProcessors &&
+               ChunkCount * 2 <= SDIR_SORT_MAX_THREADS) {
+
+            ChunkCount = ChunkCount * 2;
+        }
+    }
+
+    if (ChunkCount == 1) {
+        SdirMergeSortRange(SdirDirSorted, Scratch, Count);
+        YoriLibFree(Scratch);
+        return;
     }
 
     //
-    //  Currently sorting is done very inefficiently by a selection sort
-    //  type algorithm.  Generally this doesn't run due to the optimization
-    //  above.  When a different sort order is requested, performance could
-    //  be improved by using a better algorithm here.
+    //  Divide the array into ranges whose length is a multiple of the run
+    //  length, so the final merge passes operate on evenly sized runs.
     //
 
-    for (i = 0; i < SdirDirCollectionCurrent - 1; i++) {
+    ChunkLength = (Count + ChunkCount - 1) / ChunkCount;
+    ChunkLength = (ChunkLength + SDIR_SORT_RUN_LENGTH - 1) & ~(SDIR_SORT_RUN_LENGTH - 1);
 
-        for (j = 0; j < Opts->CurrentSort; j++) {
-            CompareResult = Opts->Sort[j].CompareFn(SdirDirSorted[i], CurrentEntry);
+    for (Index = 0; Index < ChunkCount; Index++) {
+        Chunks[Index].Array = &SdirDirSorted[Index * ChunkLength];
+        Chunks[Index].Scratch = &Scratch[Index * ChunkLength];
+        if (Index == ChunkCount - 1) {
+            Chunks[Index].Count = Count - Index * ChunkLength;
+        } else {
+            Chunks[Index].Count = ChunkLength;
+        }
 
-            if (CompareResult == Opts->Sort[j].CompareBreakCondition ||
-                CompareResult == Opts->Sort[j].CompareInverseCondition) {
-                break;
-            }
+        //
+        //  Sort the final range on this thread.  If a thread cannot be
+        //  created, sort that range on this thread too.
+        //
+
+        Threads[Index] = NULL;
+        if (Index < ChunkCount - 1) {
+            Threads[Index] = CreateThread(NULL, 0, SdirSortChunkWorker, &Chunks[Index], 0, &ThreadId);
+        }
+        if (Threads[Index] == NULL) {
+            SdirSortChunkWorker(&Chunks[Index]);
         }
+    }
 
-        if (CompareResult == Opts->Sort[j].CompareBreakCondition) {
-            for (j = SdirDirCollectionCurrent - 1; j > i; j--) {
-                SdirDirSorted[j] = SdirDirSorted[j - 1];
-            }
-            SdirDirSorted[i] = CurrentEntry;
-            return TRUE;
+    for (Index = 0; Index < ChunkCount; Index++) {
+        if (Threads[Index] != NULL) {
+            WaitForSingleObject(Threads[Index], INFINITE);
+            CloseHandle(Threads[Index]);
         }
     }
-    SdirDirSorted[SdirDirCollectionCurrent - 1] = CurrentEntry;
-    return TRUE;
+
+    SdirMergeSortedRuns(SdirDirSorted, Scratch, Count, ChunkLength);
+    YoriLibFree(Scratch);
 }
 
 /**
@@ -376,9 +874,17 @@ SdirItemFoundCallback(
     )
 {
     PSDIR_ITEM_FOUND_CONTEXT ItemContext = (PSDIR_ITEM_FOUND_CONTEXT)Context;
+    PYORILIB_FIND_DATA_EXTENDED FindDataEx;
 
     UNREFERENCED_PARAMETER(Depth);
 
+    //
+    //  The enumerate is performed with YORILIB_FILEENUM_BULK_QUERY, so the
+    //  find data is always embedded in extended find data.
+    //
+
+    FindDataEx = CONTAINING_RECORD(FindData, YORILIB_FIND_DATA_EXTENDED, FindData);
+
 #if defined(UNICODE)
     if (DllKernel32.pFindFirstStreamW != NULL &&
         (Opts->FtNamedStreams.Flags & SDIR_FEATURE_DISPLAY)) {
@@ -391,7 +897,7 @@ SdirItemFoundCallback(
         //  Display the default stream
         //
 
-        SdirAddToCollection(FindData, FullPath);
+        SdirAddToCollection(FindData, FindDataEx, FullPath);
 
         //
         //  Look for any named streams
@@ -461,7 +967,7 @@ SdirItemFoundCallback(
                     if (!YoriLibUpdateFindDataFromFileInformation(&BogusFindData, ItemContext->StreamFullPath.StartOfString, FALSE)) {
                         memcpy(&BogusFindData, &FindData, sizeof(FindData));
                     }
-                    SdirAddToCollection(&BogusFindData, &ItemContext->StreamFullPath);
+                    SdirAddToCollection(&BogusFindData, NULL, &ItemContext->StreamFullPath);
                 }
             } while (DllKernel32.pFindNextStreamW(hStreamFind, &FindStreamData));
         }
@@ -470,7 +976,7 @@ SdirItemFoundCallback(
 
     } else {
 #endif
-        SdirAddToCollection(FindData, FullPath);
+        SdirAddToCollection(FindData, FindDataEx, FullPath);
 #if defined(UNICODE)
     }
 #endif
@@ -727,7 +1233,7 @@ SdirEnumeratePathWithDepth (
         //
 
         ItemFoundContext.ItemsFound = 0;
-        MatchFlags = YORILIB_FILEENUM_RETURN_FILES | YORILIB_FILEENUM_RETURN_DIRECTORIES | YORILIB_FILEENUM_INCLUDE_DOTFILES;
+        MatchFlags = YORILIB_FILEENUM_RETURN_FILES | YORILIB_FILEENUM_RETURN_DIRECTORIES | YORILIB_FILEENUM_INCLUDE_DOTFILES | YORILIB_FILEENUM_BULK_QUERY;
 
         //
         //  MSFIX This isn't really correct without a major refactor.  What
@@ -750,6 +1256,8 @@ SdirEnumeratePathWithDepth (
                                 SdirEnumerateErrorCallback,
                                 &ItemFoundContext)) {
 
+            SdirCompleteQueuedCollection();
+
             if (!Opts->Recursive) {
                 if (ItemFoundContext.Error == ERROR_SUCCESS) {
                     ItemFoundContext.Error = GetLastError();
@@ -775,6 +1283,7 @@ SdirEnumeratePathWithDepth (
         }
 
         YoriLibFreeStringContents(&ItemFoundContext.StreamFullPath);
+        SdirCompleteQueuedCollection();
 
         if (ItemFoundContext.ItemsFound == 0) {
             if (!Opts->Recursive) {
@@ -899,32 +1408,23 @@ SdirFeatureColor(
 
 
 /**
- Display the loaded set of files.
+ Determine how to lay out the set of files that have been collected, based
+ on the longest file name found, the average file name length, and the
+ metadata being displayed.
+
+ @param Layout On successful completion, populated with the number of
+        columns and their width.
 
  @return TRUE to indicate success, FALSE to indicate failure.
  */
 BOOL
-SdirDisplayCollection(VOID)
+SdirCalculateLayout(
+    __out PSDIR_LAYOUT Layout
+    )
 {
-    PYORI_FILE_INFO CurrentEntry;
-    YORI_ALLOC_SIZE_T Index, Ext;
-    YORILIB_COLOR_ATTRIBUTES Attributes;
-    YORILIB_COLOR_ATTRIBUTES FeatureColor;
     YORI_ALLOC_SIZE_T Columns;
     YORI_ALLOC_SIZE_T ColumnWidth;
-    YORI_ALLOC_SIZE_T ActiveColumn = 0;
-    SDIR_FMTCHAR Line[SDIR_MAX_WIDTH];
-    YORI_ALLOC_SIZE_T CurrentChar = 0;
-    YORI_ALLOC_SIZE_T BufferRows;
     YORI_ALLOC_SIZE_T LongestDisplayedFileName = SdirDirCollectionLongest;
-    LPTSTR LineElements = SdirLineElementsText;
-    PSDIR_FEATURE Feature;
-
-#ifdef UNICODE
-    if (Opts->OutputExtendedCharacters) {
-        LineElements = SdirLineElementsRich;
-    }
-#endif
 
     //
     //  If we're allowed to shorten names to make the display more
@@ -946,6 +1446,16 @@ SdirDisplayCollection(VOID)
         }
     }
 
+    //
+    //  When streaming, the layout is based on the first entries found, and
+    //  any longer name found later will be truncated to fit.  Make sure
+    //  there's room to do that.
+    //
+
+    if (Opts->StreamOutput && LongestDisplayedFileName < 10) {
+        LongestDisplayedFileName = 10;
+    }
+
     ColumnWidth = Opts->ConsoleWidth;
     if (ColumnWidth > SDIR_MAX_WIDTH) {
         ColumnWidth = SDIR_MAX_WIDTH;
@@ -984,15 +1494,43 @@ SdirDisplayCollection(VOID)
         return FALSE;
     }
 
-    BufferRows = (SdirDirCollectionCurrent + Columns - 1) / Columns;
+    Layout->Columns = Columns;
+    Layout->ColumnWidth = ColumnWidth;
+    Layout->LongestDisplayedFileName = LongestDisplayedFileName;
+    return TRUE;
+}
+
+/**
+ Draw a grid line above or below a set of files.
 
-    //
-    //  Draw the top grid line.
-    //
+ @param Layout Pointer to the layout of the files.
+
+ @param IntersectElement The line element to draw between columns, either
+        SDIR_LINE_ELEMENT_TOP_T or SDIR_LINE_ELEMENT_BOTTOM_T.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+SdirDisplayGridLine(
+    __in PSDIR_LAYOUT Layout,
+    __in DWORD IntersectElement
+    )
+{
+    YORI_ALLOC_SIZE_T Index;
+    YORI_ALLOC_SIZE_T LineWidth;
+    SDIR_FMTCHAR Line[SDIR_MAX_WIDTH + 1];
+    LPTSTR LineElements = SdirLineElementsText;
+
+#ifdef UNICODE
+    if (Opts->OutputExtendedCharacters) {
+        LineElements = SdirLineElementsRich;
+    }
+#endif
 
-    for (Index = 0; Index < ColumnWidth * Columns; Index++) {
-        if (Index % ColumnWidth == ColumnWidth - 1 && Index < (ColumnWidth*Columns-1)) {
-            Line[Index].Char = LineElements[SDIR_LINE_ELEMENT_TOP_T];
+    LineWidth = Layout->ColumnWidth * Layout->Columns;
+    for (Index = 0; Index < LineWidth; Index++) {
+        if (Index % Layout->ColumnWidth == Layout->ColumnWidth - 1 && Index < (LineWidth - 1)) {
+            Line[Index].Char = LineElements[IntersectElement];
         } else {
             Line[Index].Char = LineElements[SDIR_LINE_ELEMENT_HORIZ];
         }
@@ -1000,16 +1538,69 @@ SdirDisplayCollection(VOID)
         Line[Index].Attr.Win32Attr = Opts->FtGrid.HighlightColor.Win32Attr;
     }
 
-    SdirWrite(Line, Index);
+    //
+    //  Add the newline to the same write, so the line is sent to the
+    //  output device at once.
+    //
 
-    if (ColumnWidth * Columns != Opts->ConsoleBufferWidth || !Opts->OutputHasAutoLineWrap) {
-        SdirNewlineThroughDisplay();
+    if (LineWidth != Opts->ConsoleBufferWidth || !Opts->OutputHasAutoLineWrap) {
+        Line[Index].Char = '\n';
+        Line[Index].Attr.Ctrl = SdirDefaultColor.Ctrl;
+        Line[Index].Attr.Win32Attr = SdirDefaultColor.Win32Attr;
+        Index++;
     }
 
+    SdirWrite(Line, Index);
+
     if (!SdirRowDisplayed()) {
         return FALSE;
     }
 
+    return TRUE;
+}
+
+/**
+ Display rows of files from the sorted array.
+
+ @param Layout Pointer to the layout of the files.
+
+ @param EntryCount The number of entries in the sorted array to display.
+
+ @param ColumnMajor If TRUE, entries are displayed down each column before
+        moving to the next column.  If FALSE, entries are displayed across
+        each row before moving to the next row.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+SdirDisplayRows(
+    __in PSDIR_LAYOUT Layout,
+    __in YORI_ALLOC_SIZE_T EntryCount,
+    __in BOOLEAN ColumnMajor
+    )
+{
+    PYORI_FILE_INFO CurrentEntry;
+    YORI_ALLOC_SIZE_T Index, Ext;
+    YORILIB_COLOR_ATTRIBUTES Attributes;
+    YORILIB_COLOR_ATTRIBUTES FeatureColor;
+    YORI_ALLOC_SIZE_T Columns = Layout->Columns;
+    YORI_ALLOC_SIZE_T ColumnWidth = Layout->ColumnWidth;
+    YORI_ALLOC_SIZE_T LongestDisplayedFileName = Layout->LongestDisplayedFileName;
+    YORI_ALLOC_SIZE_T ActiveColumn = 0;
+    SDIR_FMTCHAR Line[SDIR_MAX_WIDTH];
+    YORI_ALLOC_SIZE_T CurrentChar = 0;
+    YORI_ALLOC_SIZE_T BufferRows;
+    LPTSTR LineElements = SdirLineElementsText;
+    PSDIR_FEATURE Feature;
+
+#ifdef UNICODE
+    if (Opts->OutputExtendedCharacters) {
+        LineElements = SdirLineElementsRich;
+    }
+#endif
+
+    BufferRows = (EntryCount + Columns - 1) / Columns;
+
     //
     //  Enumerate through the entries.
     //
@@ -1017,13 +1608,17 @@ SdirDisplayCollection(VOID)
     for (Index = 0; Index < BufferRows * Columns && !Opts->Cancelled; Index++) {
 
         //
-        //  Because we're sorting down columns first, but rendering a row at a time,
+        //  If we're sorting down columns first, but rendering a row at a time,
         //  we need to do some matrix math to find which elements belong in which cells.
         //  Some cells in the bottom right might be empty.
         //
 
-        Ext = ActiveColumn * BufferRows + Index / Columns;
-        if (Ext < SdirDirCollectionCurrent) {
+        if (ColumnMajor) {
+            Ext = ActiveColumn * BufferRows + Index / Columns;
+        } else {
+            Ext = Index;
+        }
+        if (Ext < EntryCount) {
             CurrentEntry = SdirDirSorted[Ext];
         } else {
             CurrentEntry = NULL;
@@ -1145,33 +1740,159 @@ SdirDisplayCollection(VOID)
         }
     }
 
+    return TRUE;
+}
+
+/**
+ Display the name of a directory before displaying its contents when
+ recursing.
+
+ @param ParentDirectory Pointer to the fully qualified name of the
+        directory.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+SdirDisplayParentName(
+    __in PYORI_STRING ParentDirectory
+    )
+{
+    YORILIB_COLOR_ATTRIBUTES RenderAttributes;
+    SdirRenderAttributesFromPath(ParentDirectory, &RenderAttributes);
+
+    if (YoriLibIsFullPathUnc(ParentDirectory)) {
+        SdirWriteStringWithAttribute(_T("\\\\"), RenderAttributes);
+        SdirWriteStringWithAttribute(&ParentDirectory->StartOfString[8], RenderAttributes);
+    } else {
+        SdirWriteStringWithAttribute(&ParentDirectory->StartOfString[4], RenderAttributes);
+    }
+
+    SdirNewlineThroughDisplay();
+
+    return SdirRowDisplayed();
+}
+
+/**
+ When output is being streamed, display the entries collected so far once
+ the collection is full, so that it can be reused for entries found later.
+ The first time this occurs for a directory, the layout is chosen based on
+ the entries collected so far and is used for the remainder of the
+ directory.  Since the total number of entries isn't known, entries are
+ displayed across each row rather than down each column.  Entries that
+ don't fill a complete row are kept for the next row.
+ */
+VOID
+SdirStreamCollection(VOID)
+{
+    YORI_ALLOC_SIZE_T EntriesToDisplay;
+    YORI_ALLOC_SIZE_T EntriesRemaining;
+    YORI_ALLOC_SIZE_T Index;
+
+    if (!SdirGlobal.StreamLayoutValid) {
+        SdirGlobal.StreamLayoutValid = TRUE;
+
+        if (SdirGlobal.StreamParentName != NULL &&
+            !SdirDisplayParentName(SdirGlobal.StreamParentName)) {
+
+            SdirGlobal.StreamDisplayFailed = TRUE;
+        } else if (!SdirCalculateLayout(&SdirGlobal.StreamLayout) ||
+                   !SdirDisplayGridLine(&SdirGlobal.StreamLayout, SDIR_LINE_ELEMENT_TOP_T)) {
+
+            SdirGlobal.StreamDisplayFailed = TRUE;
+        }
+    }
+
     //
-    //  Render the bottom gridline.
+    //  If display has failed, the user doesn't want to see any more, so
+    //  just discard entries until enumeration completes.
     //
 
-    for (Index = 0; Index < ColumnWidth * Columns; Index++) {
-        if (Index % ColumnWidth == ColumnWidth - 1 && Index < (ColumnWidth*Columns-1)) {
-            Line[Index].Char = LineElements[SDIR_LINE_ELEMENT_BOTTOM_T];
-        } else {
-            Line[Index].Char = LineElements[SDIR_LINE_ELEMENT_HORIZ];
+    if (SdirGlobal.StreamDisplayFailed || Opts->Cancelled) {
+        Opts->Cancelled = TRUE;
+        SdirDirCollectionCurrent = 0;
+        return;
+    }
+
+    EntriesRemaining = SdirDirCollectionCurrent % SdirGlobal.StreamLayout.Columns;
+    EntriesToDisplay = SdirDirCollectionCurrent - EntriesRemaining;
+
+    if (!SdirDisplayRows(&SdirGlobal.StreamLayout, EntriesToDisplay, FALSE)) {
+        SdirGlobal.StreamDisplayFailed = TRUE;
+        Opts->Cancelled = TRUE;
+        SdirDirCollectionCurrent = 0;
+        return;
+    }
+
+    //
+    //  Move any partial row to the start of the collection.  Entries are
+    //  not sorted, so the sorted array refers to the collection in order.
+    //
+
+    if (EntriesRemaining > 0) {
+        memmove(SdirDirCollection,
+                &SdirDirCollection[EntriesToDisplay],
+                EntriesRemaining * sizeof(YORI_FILE_INFO));
+    }
+
+    for (Index = 0; Index < EntriesRemaining; Index++) {
+        SdirDirSorted[Index] = &SdirDirCollection[Index];
+    }
+
+    SdirDirCollectionCurrent = EntriesRemaining;
+}
+
+/**
+ Display the loaded set of files.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+SdirDisplayCollection(VOID)
+{
+    SDIR_LAYOUT Layout;
+
+    //
+    //  If rows have already been displayed while streaming, display the
+    //  remaining entries with the same layout.
+    //
+
+    if (SdirGlobal.StreamLayoutValid) {
+        SdirGlobal.StreamLayoutValid = FALSE;
+        if (SdirGlobal.StreamDisplayFailed) {
+            SdirGlobal.StreamDisplayFailed = FALSE;
+            return FALSE;
         }
-        Line[Index].Attr.Ctrl = Opts->FtGrid.HighlightColor.Ctrl;
-        Line[Index].Attr.Win32Attr = Opts->FtGrid.HighlightColor.Win32Attr;
+
+        if (!SdirDisplayRows(&SdirGlobal.StreamLayout, SdirDirCollectionCurrent, FALSE)) {
+            return FALSE;
+        }
+
+        return SdirDisplayGridLine(&SdirGlobal.StreamLayout, SDIR_LINE_ELEMENT_BOTTOM_T);
     }
 
-    SdirWrite(Line, Index);
-    CurrentChar = 0;
+    //
+    //  If output is being streamed but the entire directory fit in the
+    //  collection, display it in the order it was found with the same
+    //  layout as sorted output.
+    //
 
-    if (ColumnWidth * Columns != Opts->ConsoleBufferWidth || !Opts->OutputHasAutoLineWrap) {
-        SdirNewlineThroughDisplay();
-        CurrentChar = 0;
+    if (!Opts->StreamOutput) {
+        SdirSortCollection();
     }
 
-    if (!SdirRowDisplayed()) {
+    if (!SdirCalculateLayout(&Layout)) {
         return FALSE;
     }
 
-    return TRUE;
+    if (!SdirDisplayGridLine(&Layout, SDIR_LINE_ELEMENT_TOP_T)) {
+        return FALSE;
+    }
+
+    if (!SdirDisplayRows(&Layout, SdirDirCollectionCurrent, TRUE)) {
+        return FALSE;
+    }
+
+    return SdirDisplayGridLine(&Layout, SDIR_LINE_ELEMENT_BOTTOM_T);
 }
 
 /**
@@ -1320,7 +2041,7 @@ SdirEnumerateAndDisplay (
         return FALSE;
     }
 
-    if (SdirDirCollectionCurrent == 0) {
+    if (SdirDirCollectionCurrent == 0 && !SdirGlobal.StreamLayoutValid) {
         SdirDisplayError(ERROR_FILE_NOT_FOUND, NULL);
         return FALSE;
     }
@@ -1416,6 +2137,13 @@ SdirEnumerateAndDisplaySubtree (
         return FALSE;
     }
 
+    //
+    //  If output is being streamed, the directory name is displayed before
+    //  the first row, which may happen during enumeration.
+    //
+
+    SdirGlobal.StreamParentName = &ParentDirectory;
+
     if (!SdirEnumeratePathWithDepth(&NextSubDir, Depth)) {
         DWORD Err = GetLastError();
         if (SdirIsReportableError(Err)) {
@@ -1424,30 +2152,30 @@ SdirEnumerateAndDisplaySubtree (
         }
         if (!SdirContinuableError(Err)) {
 
+            SdirGlobal.StreamParentName = NULL;
+            SdirGlobal.StreamLayoutValid = FALSE;
+            SdirGlobal.StreamDisplayFailed = FALSE;
             YoriLibFreeStringContents(&NextSubDir);
             return FALSE;
         }
     }
 
+    SdirGlobal.StreamParentName = NULL;
+
     //
     //  If we have something to display, display it.
     //
 
-    if (SdirDirCollectionCurrent > 0) {
-
-        YORILIB_COLOR_ATTRIBUTES RenderAttributes;
-        SdirRenderAttributesFromPath(&ParentDirectory, &RenderAttributes);
+    if (SdirGlobal.StreamLayoutValid) {
 
-        if (YoriLibIsFullPathUnc(&ParentDirectory)) {
-            SdirWriteStringWithAttribute(_T("\\\\"), RenderAttributes);
-            SdirWriteStringWithAttribute(&ParentDirectory.StartOfString[8], RenderAttributes);
-        } else {
-            SdirWriteStringWithAttribute(&ParentDirectory.StartOfString[4], RenderAttributes);
+        if (!SdirDisplayCollection()) {
+            YoriLibFreeStringContents(&NextSubDir);
+            return FALSE;
         }
 
-        SdirNewlineThroughDisplay();
+    } else if (SdirDirCollectionCurrent > 0) {
 
-        if (!SdirRowDisplayed()) {
+        if (!SdirDisplayParentName(&ParentDirectory)) {
             YoriLibFreeStringContents(&NextSubDir);
             return FALSE;
         }
@@ -1633,10 +2361,29 @@ ENTRYPOINT(
     SdirDirCollectionTotalNameLength = 0;
     SdirWriteStringLinesDisplayed = 0;
 
+    //
+    //  Output is generated in small pieces, each with its own color, so
+    //  buffer it when it is going to a file or pipe.
+    //
+
+    YoriLibOutputBufferEnable(GetStdHandle(STD_OUTPUT_HANDLE));
+
     if (!SdirInit(ArgC, ArgV)) {
         goto restore_and_exit;
     }
 
+    SdirCreateCollectQueue();
+
+#ifndef YORI_BUILTIN
+    //
+    //  Executable headers and version resources are parsed together, so
+    //  remember each parse for the remaining columns of the same file.
+    //  The shell enables this cache for builtin commands.
+    //
+
+    YoriLibPeMetadataCacheEnable();
+#endif
+
     if (Opts->Recursive) {
         if (!SdirEnumerateAndDisplayRecursive(ArgC, ArgV)) {
             goto restore_and_exit;
@@ -1661,7 +2408,11 @@ restore_and_exit:
     if (Opts != NULL) {
         SdirSetConsoleTextAttribute(GetStdHandle(STD_OUTPUT_HANDLE), Opts->PreviousAttributes);
     }
+    YoriLibOutputBufferDisable(GetStdHandle(STD_OUTPUT_HANDLE));
     SdirAppCleanup();
+#ifndef YORI_BUILTIN
+    YoriLibPeMetadataCacheCleanup();
+#endif
 
     return 0;
 }
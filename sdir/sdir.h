@@ -137,9 +137,8 @@ typedef struct _SDIR_COMPARE {
 
     /**
      Can be set to YORI_LIB_EQUAL, YORI_LIB_GREATER_THAN, YORI_LIB_LESS_THAN.
-     Items are inserted into order by comparing against existing entries
-     until this condition is met, at which point the item can be inserted
-     into its sorted position.
+     When comparing two entries returns this condition, the first entry
+     should be displayed after the second.
      */
     DWORD           CompareBreakCondition;
 
@@ -508,6 +507,13 @@ typedef struct _SDIR_OPTS {
      */
     BOOLEAN         BasicEnumeration:1;
 
+    /**
+     TRUE if no sort order has been requested and entries should be
+     displayed as they are found, without holding the whole directory in
+     memory.
+     */
+    BOOLEAN         StreamOutput:1;
+
     /**
      The color attributes from when the program was started, that should
      be restored on exit.
@@ -656,6 +662,28 @@ typedef struct _SDIR_EXEC {
 } SDIR_EXEC, *PSDIR_EXEC;
 #pragma pack(pop)
 
+/**
+ The dimensions used to display a set of files.
+ */
+typedef struct _SDIR_LAYOUT {
+
+    /**
+     The number of columns of files to display on each line.
+     */
+    YORI_ALLOC_SIZE_T Columns;
+
+    /**
+     The number of characters in each column, including the separator.
+     */
+    YORI_ALLOC_SIZE_T ColumnWidth;
+
+    /**
+     The number of characters to display for each file name.  Names longer
+     than this are truncated.
+     */
+    YORI_ALLOC_SIZE_T LongestDisplayedFileName;
+} SDIR_LAYOUT, *PSDIR_LAYOUT;
+
 /**
  A structure containing state that is global for each instance of sdir.
  */
@@ -672,6 +700,39 @@ typedef struct _SDIR_GLOBAL {
      which files to hide.
      */
     YORI_LIB_FILE_FILTER FileHideCriteria;
+
+    /**
+     If any information being collected requires opening files, points to
+     a pool of threads collecting it while enumeration continues.  NULL if
+     information is collected synchronously.
+     */
+    PYORILIB_FILE_INFO_QUEUE CollectQueue;
+
+    /**
+     When output is being streamed, points to the name of the directory
+     being enumerated, which is displayed before its first row.  NULL if
+     no directory name should be displayed.
+     */
+    PYORI_STRING StreamParentName;
+
+    /**
+     When output is being streamed, the layout that was chosen from the
+     first entries found in the current directory.
+     */
+    SDIR_LAYOUT StreamLayout;
+
+    /**
+     When output is being streamed, TRUE once rows of the current directory
+     have been displayed, so the remaining entries must be displayed with
+     StreamLayout.
+     */
+    BOOLEAN StreamLayoutValid;
+
+    /**
+     When output is being streamed, TRUE if rows could not be displayed
+     during enumeration and display should not continue.
+     */
+    BOOLEAN StreamDisplayFailed;
 } SDIR_GLOBAL, *PSDIR_GLOBAL;
 
 extern SDIR_GLOBAL SdirGlobal;
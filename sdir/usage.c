@@ -337,6 +337,13 @@ SdirUsageDisplay(VOID)
 const
 CHAR strSortHeader[] = "SORT OPTIONS";
 
+/**
+ An ANSI string describing how to display files without sorting.
+ */
+const
+CHAR strSortUnsorted[] = 
+                   "   -su          Display unsorted as files are found, for large directories\n";
+
 /**
  Display usage information for sorting files.
 
@@ -378,6 +385,12 @@ SdirUsageSort(VOID)
         }
     }
 
+    SdirAnsiToUnicode(strUsage, sizeof(strUsage)/sizeof(strUsage[0]), strSortUnsorted);
+
+    if (!SdirWriteString(strUsage)) {
+        return FALSE;
+    }
+
     SdirAnsiToUnicode(strUsage, sizeof(strUsage)/sizeof(strUsage[0]), strCmdLineUsage2);
 
     if (!SdirWriteString(strUsage)) {
@@ -83,17 +83,20 @@ PYORI_HASH_TABLE YoriShAliasesHash;
 #define ALIAS_IMPORT_APP_NAME _T("CMD.EXE")
 
 /**
- Delete an existing shell alias.
+ Delete an existing shell alias whose name has already been hashed.
 
  @param Alias The alias to delete.
 
+ @param Hash The hash of the alias name, as returned by @ref YoriLibHashKey.
+
  @return TRUE if the alias was successfully deleted, FALSE if it was not
          found.
  */
 __success(return)
 BOOL
-YoriShDeleteAlias(
-    __in PYORI_STRING Alias
+YoriShDeleteAliasWithHash(
+    __in PYORI_STRING Alias,
+    __in DWORD Hash
     )
 {
     PYORI_HASH_ENTRY HashEntry;
@@ -103,7 +106,7 @@ YoriShDeleteAlias(
         return FALSE;
     }
 
-    HashEntry = YoriLibHashRemoveByKey(YoriShAliasesHash, Alias);
+    HashEntry = YoriLibHashRemoveByKeyWithHash(YoriShAliasesHash, Alias, Hash);
     if (HashEntry == NULL) {
         return FALSE;
     }
@@ -120,6 +123,23 @@ YoriShDeleteAlias(
     return TRUE;
 }
 
+/**
+ Delete an existing shell alias.
+
+ @param Alias The alias to delete.
+
+ @return TRUE if the alias was successfully deleted, FALSE if it was not
+         found.
+ */
+__success(return)
+BOOL
+YoriShDeleteAlias(
+    __in PYORI_STRING Alias
+    )
+{
+    return YoriShDeleteAliasWithHash(Alias, YoriLibHashKey(Alias));
+}
+
 
 /**
  Add a new, or replace an existing, shell alias.
@@ -144,12 +164,19 @@ YoriShAddAlias(
     PYORI_ALIAS NewAlias;
     YORI_ALLOC_SIZE_T AliasNameLengthInChars;
     YORI_ALLOC_SIZE_T ValueNameLengthInChars;
+    DWORD Hash;
+
+    //
+    //  The name is looked up, removed and inserted, so hash it once.
+    //
+
+    Hash = YoriLibHashKey(Alias);
 
     if (YoriShAliasesHash != NULL) {
         if (Internal) {
             PYORI_HASH_ENTRY HashEntry;
             PYORI_ALIAS ExistingAlias;
-            HashEntry = YoriLibHashLookupByKey(YoriShAliasesHash, Alias);
+            HashEntry = YoriLibHashLookupByKeyWithHash(YoriShAliasesHash, Alias, Hash);
             if (HashEntry != NULL) {
                 ExistingAlias = HashEntry->Context;
                 if (!ExistingAlias->Internal) {
@@ -157,7 +184,7 @@ YoriShAddAlias(
                 }
             }
         }
-        YoriShDeleteAlias(Alias);
+        YoriShDeleteAliasWithHash(Alias, Hash);
     } else {
         YoriLibInitializeListHead(&YoriShAliasesList);
         YoriShAliasesHash = YoriLibAllocateHashTable(250);
@@ -197,7 +224,7 @@ YoriShAddAlias(
     }
 
     YoriLibAppendList(&YoriShAliasesList, &NewAlias->ListEntry);
-    YoriLibHashInsertByKey(YoriShAliasesHash, &NewAlias->Alias, NewAlias, &NewAlias->HashEntry);
+    YoriLibHashInsertByKeyWithHash(YoriShAliasesHash, &NewAlias->Alias, Hash, NewAlias, &NewAlias->HashEntry);
 
     return TRUE;
 }
@@ -294,8 +321,17 @@ YoriShExpandAlias(
 
     ExistingAlias = HashEntry->Context;
 
+    //
+    //  Most aliases do not refer to their arguments.  For these, parse the
+    //  alias value directly rather than copying it.
+    //
+
     YoriLibInitEmptyString(&NewCmdString);
-    YoriLibExpandCommandVariables(&ExistingAlias->Value, '$', TRUE, YoriShExpandAliasHelper, CmdContext, &NewCmdString);
+    if (YoriLibFindLeftMostCharacter(&ExistingAlias->Value, '$') == NULL) {
+        YoriLibCloneString(&NewCmdString, &ExistingAlias->Value);
+    } else {
+        YoriLibExpandCommandVariables(&ExistingAlias->Value, '$', TRUE, YoriShExpandAliasHelper, CmdContext, &NewCmdString);
+    }
     if (NewCmdString.LengthInChars > 0) {
         if (YoriLibShParseCmdlineToCmdContext(&NewCmdString, 0, &NewCmdContext) &&
             NewCmdContext.ArgC > 0) {
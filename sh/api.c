@@ -366,6 +366,27 @@ YoriApiGetJobInformation(
     return YoriShGetJobInformation(JobId, HasCompleted, HasOutput, ExitCode, Command);
 }
 
+/**
+ Returns the resources consumed by an executing or completed job ID,
+ including all processes launched by the job.
+
+ @param JobId The ID to query information for.
+
+ @param Accounting On successful completion, populated with the resources
+        consumed by the job's process tree.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriApiGetJobAccounting(
+    __in DWORD JobId,
+    __out PYORI_LIB_JOB_ACCOUNTING Accounting
+    )
+{
+    return YoriShGetJobAccounting(JobId, Accounting);
+}
+
 /**
  Get any output buffers from a completed job, including stdout and stderr
  buffers.
@@ -390,6 +411,19 @@ YoriApiGetJobOutput(
     return YoriShGetJobOutput(JobId, Output, Errors);
 }
 
+/**
+ Returns the maximum number of background jobs that can execute
+ concurrently.
+
+ @return The maximum number of concurrent jobs, or zero if there is no
+         limit.
+ */
+DWORD
+YoriApiGetJobLimit(VOID)
+{
+    return YoriShGlobal.JobLimit;
+}
+
 /**
  Given a previous job ID, return the next ID that is currently executing.
  To commence from the beginning, specify a PreviousJobId of zero.
@@ -495,7 +529,9 @@ YoriApiPipeJobOutput(
 }
 
 /**
- Set the current directory in the Yori shell process.
+ Set the current directory in the Yori shell process.  Callers typically
+ record the previous directory on its drive in the environment afterwards,
+ so the environment is treated as changed.
 
  @param NewCurrentDirectory The new current directory to apply.
 
@@ -506,6 +542,7 @@ YoriApiSetCurrentDirectory(
     __in PYORI_STRING NewCurrentDirectory
     )
 {
+    YoriShGlobal.EnvironmentGeneration++;
     return YoriLibSetCurrentDirectory(NewCurrentDirectory);
 }
 
@@ -559,6 +596,25 @@ YoriApiSetJobPriority(
     return YoriShJobSetPriority(JobId, PriorityClass);
 }
 
+/**
+ Sets the maximum number of background jobs that can execute concurrently.
+ Once this many jobs are executing, launching another job waits until one
+ completes.
+
+ @param JobLimit The maximum number of concurrent jobs, or zero to remove
+        any limit.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+YoriApiSetJobLimit(
+    __in DWORD JobLimit
+    )
+{
+    YoriShGlobal.JobLimit = JobLimit;
+    return TRUE;
+}
+
 /**
  Set the command to prepopulate on the prompt for the user to edit next time
  a command needs to be entered.
@@ -615,6 +671,18 @@ YoriApiTerminateJob(
     return YoriShTerminateJob(JobId);
 }
 
+/**
+ Waits until any executing job completes.
+
+ @return The ID of the job that completed, or zero if no jobs are executing
+         or the wait was cancelled.
+ */
+DWORD
+YoriApiWaitForAnyJob(VOID)
+{
+    return YoriShJobWaitAny();
+}
+
 /**
  Waits until the specified job ID is no longer active.
 
@@ -386,6 +386,121 @@ YoriShExecuteNamedModuleInProc(
 }
 
 
+/**
+ Check whether a program that was found in the path is a Yori tool that the
+ shell can execute as a builtin, and if so, replace the program with the name
+ of the builtin.  This only occurs if the user has set YORIINPROC to 1, the
+ program is an executable in the same directory as the shell, and a builtin
+ with the same name as the executable exists, either because the shell was
+ compiled with it (as oneyori is) or because a module registered it via
+ YoriCallBuiltinRegister.  Executing a tool this way avoids creating a
+ process, which is significant for scripts that execute small tools
+ repeatedly.
+
+ @param CmdContext Pointer to the command context whose first argument is the
+        fully qualified path to a program.  On successful completion, the
+        first argument is replaced with the name of the builtin.
+
+ @return TRUE to indicate the command should be executed as a builtin, FALSE
+         if it should be executed as a program.
+ */
+__success(return)
+BOOLEAN
+YoriShResolveToolToBuiltin(
+    __inout PYORI_LIBSH_CMD_CONTEXT CmdContext
+    )
+{
+    YORI_STRING EnvVar;
+    TCHAR EnvVarBuffer[4];
+    YORI_STRING ToolName;
+    YORI_STRING Extension;
+    YORI_STRING BuiltinName;
+    PYORI_STRING Program;
+    YORI_ALLOC_SIZE_T Length;
+
+    if (YoriShGlobal.InProcToolsGeneration != YoriShGlobal.EnvironmentGeneration) {
+        YoriShGlobal.InProcTools = FALSE;
+
+        YoriLibInitEmptyString(&EnvVar);
+        EnvVar.StartOfString = EnvVarBuffer;
+        EnvVar.LengthAllocated = sizeof(EnvVarBuffer)/sizeof(EnvVarBuffer[0]);
+        EnvVar.LengthInChars = YoriShGetEnvironmentVariableWithoutSubstitution(_T("YORIINPROC"), EnvVar.StartOfString, EnvVar.LengthAllocated, NULL);
+        if (EnvVar.LengthInChars < EnvVar.LengthAllocated &&
+            YoriLibCompareStringLit(&EnvVar, _T("1")) == 0) {
+
+            YoriShGlobal.InProcTools = TRUE;
+        }
+
+        YoriShGlobal.InProcToolsGeneration = YoriShGlobal.EnvironmentGeneration;
+    }
+
+    if (!YoriShGlobal.InProcTools) {
+        return FALSE;
+    }
+
+    //
+    //  Only programs supplied with the shell are considered, so that an
+    //  unrelated program which happens to share a name with a builtin is
+    //  still executed.
+    //
+
+    if (YoriShGlobal.AppDirectory.LengthInChars == 0) {
+        Length = YoriShGetAppDirectoryWithTrailingSlash(0, NULL);
+        if (Length == 0 || !YoriLibAllocateString(&YoriShGlobal.AppDirectory, Length)) {
+            return FALSE;
+        }
+
+        YoriShGlobal.AppDirectory.LengthInChars = YoriShGetAppDirectoryWithTrailingSlash(Length, YoriShGlobal.AppDirectory.StartOfString);
+        if (YoriShGlobal.AppDirectory.LengthInChars == 0 ||
+            YoriShGlobal.AppDirectory.LengthInChars >= Length) {
+
+            YoriLibFreeStringContents(&YoriShGlobal.AppDirectory);
+            return FALSE;
+        }
+    }
+
+    Program = &CmdContext->ArgV[0];
+    if (Program->LengthInChars <= YoriShGlobal.AppDirectory.LengthInChars + sizeof(".exe") - 1 ||
+        YoriLibCompareStringInsCnt(Program, &YoriShGlobal.AppDirectory, YoriShGlobal.AppDirectory.LengthInChars) != 0) {
+
+        return FALSE;
+    }
+
+    YoriLibInitEmptyString(&ToolName);
+    ToolName.StartOfString = &Program->StartOfString[YoriShGlobal.AppDirectory.LengthInChars];
+    ToolName.LengthInChars = Program->LengthInChars - YoriShGlobal.AppDirectory.LengthInChars;
+
+    if (YoriLibFindLeftMostCharacter(&ToolName, '\\') != NULL) {
+        return FALSE;
+    }
+
+    YoriLibInitEmptyString(&Extension);
+    Extension.StartOfString = &ToolName.StartOfString[ToolName.LengthInChars - (sizeof(".exe") - 1)];
+    Extension.LengthInChars = (YORI_ALLOC_SIZE_T)(sizeof(".exe") - 1);
+    if (YoriLibCompareStringLitIns(&Extension, _T(".exe")) != 0) {
+        return FALSE;
+    }
+
+    ToolName.LengthInChars = ToolName.LengthInChars - Extension.LengthInChars;
+    if (YoriLibShLookupBuiltinByName(&ToolName) == NULL) {
+        return FALSE;
+    }
+
+    if (!YoriLibAllocateString(&BuiltinName, ToolName.LengthInChars + 1)) {
+        return FALSE;
+    }
+
+    memcpy(BuiltinName.StartOfString, ToolName.StartOfString, ToolName.LengthInChars * sizeof(TCHAR));
+    BuiltinName.StartOfString[ToolName.LengthInChars] = '\0';
+    BuiltinName.LengthInChars = ToolName.LengthInChars;
+
+    YoriLibFreeStringContents(Program);
+    memcpy(Program, &BuiltinName, sizeof(YORI_STRING));
+    YoriLibShCheckIfArgNeedsQuotes(CmdContext, 0);
+
+    return TRUE;
+}
+
 /**
  Execute a function if we can't find it in the PATH.  Because Yori looks
  for programs in the path first, this function acts as a "last chance" to
@@ -435,13 +550,7 @@ YoriShBuiltIn (
 
             CmdString = &ExecContext->CmdToExec.ArgV[0];
             NewString = &ExecContext->CmdToExec.ArgV[1];
-            if (CmdString->MemoryToFree != NULL) {
-                YoriLibReference(CmdString->MemoryToFree);
-            }
-            NewString->MemoryToFree = CmdString->MemoryToFree;
-            NewString->StartOfString = &CmdString->StartOfString[LenBeforeSep];
-            NewString->LengthInChars = CmdString->LengthInChars - LenBeforeSep;
-            NewString->LengthAllocated = CmdString->LengthAllocated - LenBeforeSep;
+            YoriLibCloneSubstring(NewString, CmdString, LenBeforeSep, CmdString->LengthInChars - LenBeforeSep);
 
             YoriLibShCheckIfArgNeedsQuotes(&ExecContext->CmdToExec, 1);
 
@@ -182,7 +182,6 @@ YoriShPerformHistoryTabCompletion(
 {
     LPTSTR FoundPath;
     YORI_ALLOC_SIZE_T CompareLength;
-    PYORI_LIST_ENTRY ListEntry;
     PYORI_SH_HISTORY_ENTRY HistoryEntry;
     PYORI_SH_TAB_COMPLETE_MATCH Match;
     PYORI_HASH_ENTRY PriorEntry;
@@ -202,56 +201,52 @@ YoriShPerformHistoryTabCompletion(
     FoundPath = NULL;
 
     //
-    //  Search the list of history.
+    //  Search the list of history, most recent first.
     //
 
-    ListEntry = YoriLibGetPreviousListEntry(&YoriShGlobal.CommandHistory, NULL);
-    while (ListEntry != NULL) {
-        HistoryEntry = CONTAINING_RECORD(ListEntry, YORI_SH_HISTORY_ENTRY, ListEntry);
+    HistoryEntry = YoriShGetPreviousHistoryMatch(&TabContext->SearchString, CompareLength, NULL);
+    while (HistoryEntry != NULL) {
 
-        if (YoriLibCompareStringInsCnt(&HistoryEntry->CmdLine, &TabContext->SearchString, CompareLength) == 0) {
+        //
+        //  Allocate a match entry for this file.
+        //
 
-            //
-            //  Allocate a match entry for this file.
-            //
+        Match = YoriLibReferencedMalloc(sizeof(YORI_SH_TAB_COMPLETE_MATCH) + (HistoryEntry->CmdLine.LengthInChars + 1) * sizeof(TCHAR));
+        if (Match == NULL) {
+            return;
+        }
 
-            Match = YoriLibReferencedMalloc(sizeof(YORI_SH_TAB_COMPLETE_MATCH) + (HistoryEntry->CmdLine.LengthInChars + 1) * sizeof(TCHAR));
-            if (Match == NULL) {
-                return;
-            }
+        //
+        //  Populate the file into the entry.
+        //
 
-            //
-            //  Populate the file into the entry.
-            //
+        YoriLibInitEmptyString(&Match->Value);
+        Match->Value.StartOfString = (LPTSTR)(Match + 1);
+        YoriLibReference(Match);
+        Match->Value.MemoryToFree = Match;
+        YoriLibSPrintf(Match->Value.StartOfString, _T("%y"), &HistoryEntry->CmdLine);
+        Match->Value.LengthInChars = HistoryEntry->CmdLine.LengthInChars;
+        Match->CursorOffset = Match->Value.LengthInChars;
 
-            YoriLibInitEmptyString(&Match->Value);
-            Match->Value.StartOfString = (LPTSTR)(Match + 1);
-            YoriLibReference(Match);
-            Match->Value.MemoryToFree = Match;
-            YoriLibSPrintf(Match->Value.StartOfString, _T("%y"), &HistoryEntry->CmdLine);
-            Match->Value.LengthInChars = HistoryEntry->CmdLine.LengthInChars;
-            Match->CursorOffset = Match->Value.LengthInChars;
+        //
+        //  If the user is requesting all matches to be enumerates for
+        //  tab completion, don't add an entry if there's a duplicate.
+        //  If the user is requesting to be able to cycle to the next
+        //  entry, keep duplicates, because they're an in-order record
+        //  of the commands the user entered.
 
-            //
-            //  If the user is requesting all matches to be enumerates for
-            //  tab completion, don't add an entry if there's a duplicate.
-            //  If the user is requesting to be able to cycle to the next
-            //  entry, keep duplicates, because they're an in-order record
-            //  of the commands the user entered.
-
-            PriorEntry = NULL;
-            if (YoriShGlobal.CompletionListAll) {
-                PriorEntry = YoriLibHashLookupByKey(TabContext->MatchHashTable, &Match->Value);
-            }
+        PriorEntry = NULL;
+        if (YoriShGlobal.CompletionListAll) {
+            PriorEntry = YoriLibHashLookupByKey(TabContext->MatchHashTable, &Match->Value);
+        }
 
-            if (PriorEntry == NULL) {
-                YoriShAddMatchToTabContextAtEnd(TabContext, Match);
-            } else {
-                YoriLibFreeStringContents(&Match->Value);
-                YoriLibDereference(Match);
-            }
+        if (PriorEntry == NULL) {
+            YoriShAddMatchToTabContextAtEnd(TabContext, Match);
+        } else {
+            YoriLibFreeStringContents(&Match->Value);
+            YoriLibDereference(Match);
         }
-        ListEntry = YoriLibGetPreviousListEntry(&YoriShGlobal.CommandHistory, ListEntry);
+        HistoryEntry = YoriShGetPreviousHistoryMatch(&TabContext->SearchString, CompareLength, HistoryEntry);
     }
 }
 
@@ -718,7 +713,7 @@ YoriShPerformEnvironmentTabCompletion(
         return;
     }
 
-    if (!YoriLibGetEnvironmentStrings(&EnvironmentStrings)) {
+    if (!YoriShGetEnvironmentStrings(&EnvironmentStrings)) {
         return;
     }
 
@@ -813,6 +808,11 @@ YoriShFileTabCompletionCallback(
 
     UNREFERENCED_PARAMETER(Depth);
 
+    if (FileCompleteContext->TabContext->Cancelled) {
+        FileCompleteContext->AbortMatching = TRUE;
+        return FALSE;
+    }
+
     if (FileCompleteContext->ExpandFullPath) {
 
         //
@@ -1032,6 +1032,11 @@ YoriShFileTabCompletionErrorCallback(
     UNREFERENCED_PARAMETER(FilePath);
     UNREFERENCED_PARAMETER(Depth);
 
+    if (FileCompleteContext->TabContext->Cancelled) {
+        FileCompleteContext->AbortMatching = TRUE;
+        return FALSE;
+    }
+
     if (ErrorCode == ERROR_BAD_NET_NAME ||
         ErrorCode == ERROR_NETNAME_DELETED ||
         ErrorCode == ERROR_NETWORK_ACCESS_DENIED ||
@@ -1256,7 +1261,7 @@ YoriShFindMatchingStreamsForStringOrCursorPosition(
 
  */
 VOID
-YoriShPerformFileTabCompletion(
+YoriShPerformFileTabCompletionSynchronous(
     __inout PYORI_SH_TAB_COMPLETE_CONTEXT TabContext,
     __in BOOLEAN ExpandFullPath,
     __in BOOLEAN IncludeDirectories,
@@ -1469,6 +1474,348 @@ YoriShPerformFileTabCompletion(
     return;
 }
 
+/**
+ The maximum number of console input records to inspect when checking for
+ key presses that arrived while a file enumeration is in progress.
+ */
+#define YORI_SH_ASYNC_COMPLETE_INPUT_RECORDS (64)
+
+/**
+ The interval, in milliseconds, to wait for a file enumeration to complete
+ before checking for new key presses when the console has pending input
+ that is not a key press.
+ */
+#define YORI_SH_ASYNC_COMPLETE_POLL_INTERVAL (50)
+
+/**
+ A request to enumerate files for tab completion on a background thread.
+ This is shared between the input thread and the enumeration thread, and
+ is freed by whichever is the last to finish with it.  This allows the
+ input thread to abandon a request that is blocked enumerating a slow
+ network path without waiting for it.
+ */
+typedef struct _YORI_SH_ASYNC_FILE_COMPLETE_REQUEST {
+
+    /**
+     The number of parties (being the input thread and enumeration thread)
+     that still refer to this request.
+     */
+    LONG ReferenceCount;
+
+    /**
+     A private tab context which is populated by the enumeration thread.
+     On successful completion, its matches are moved to the tab context
+     that the input thread is populating.
+     */
+    YORI_SH_TAB_COMPLETE_CONTEXT TabContext;
+
+    /**
+     Specifies if full path expansion should be performed.
+     */
+    BOOLEAN ExpandFullPath;
+
+    /**
+     TRUE if directories should be included in results.
+     */
+    BOOLEAN IncludeDirectories;
+
+    /**
+     TRUE if files should be included in results.
+     */
+    BOOLEAN IncludeFiles;
+
+    /**
+     TRUE to keep the list of completion options sorted.
+     */
+    BOOLEAN KeepCompletionsSorted;
+} YORI_SH_ASYNC_FILE_COMPLETE_REQUEST, *PYORI_SH_ASYNC_FILE_COMPLETE_REQUEST;
+
+/**
+ Release a reference on a background file enumeration request.  When the
+ final reference is released, any matches that have not been moved to
+ another tab context are freed along with the request.
+
+ @param Request Pointer to the request to dereference.
+ */
+VOID
+YoriShDereferenceAsyncFileCompleteRequest(
+    __in PYORI_SH_ASYNC_FILE_COMPLETE_REQUEST Request
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PYORI_SH_TAB_COMPLETE_MATCH Match;
+
+    if (InterlockedDecrement(&Request->ReferenceCount) != 0) {
+        return;
+    }
+
+    ListEntry = YoriLibGetNextListEntry(&Request->TabContext.MatchList, NULL);
+    while (ListEntry != NULL) {
+        Match = CONTAINING_RECORD(ListEntry, YORI_SH_TAB_COMPLETE_MATCH, ListEntry);
+        ListEntry = YoriLibGetNextListEntry(&Request->TabContext.MatchList, ListEntry);
+        YoriShRemoveMatchFromTabContext(&Request->TabContext, Match);
+    }
+
+    if (Request->TabContext.MatchHashTable != NULL) {
+        YoriLibFreeEmptyHashTable(Request->TabContext.MatchHashTable);
+    }
+    YoriLibFreeStringContents(&Request->TabContext.SearchString);
+    YoriLibFree(Request);
+}
+
+/**
+ The entrypoint for a background thread which enumerates files for tab
+ completion.
+
+ @param Context Pointer to the request to populate.
+
+ @return Thread exit code, which is unused.
+ */
+DWORD WINAPI
+YoriShAsyncFileTabCompletionWorker(
+    __in PVOID Context
+    )
+{
+    PYORI_SH_ASYNC_FILE_COMPLETE_REQUEST Request;
+
+    Request = (PYORI_SH_ASYNC_FILE_COMPLETE_REQUEST)Context;
+
+    YoriShPerformFileTabCompletionSynchronous(&Request->TabContext,
+                                              Request->ExpandFullPath,
+                                              Request->IncludeDirectories,
+                                              Request->IncludeFiles,
+                                              Request->KeepCompletionsSorted);
+
+    YoriShDereferenceAsyncFileCompleteRequest(Request);
+    return 0;
+}
+
+/**
+ Count the number of key presses which are waiting in the console input
+ queue.  Presses of modifier keys alone are not counted, since these do
+ not indicate that the user has continued typing.
+
+ @param InputHandle Handle to the console input.
+
+ @return The number of key presses found.
+ */
+DWORD
+YoriShCountPendingKeyPresses(
+    __in HANDLE InputHandle
+    )
+{
+    INPUT_RECORD InputRecords[YORI_SH_ASYNC_COMPLETE_INPUT_RECORDS];
+    DWORD RecordsRead;
+    DWORD Index;
+    DWORD KeyPresses;
+    WORD KeyCode;
+
+    if (!PeekConsoleInput(InputHandle, InputRecords, sizeof(InputRecords)/sizeof(InputRecords[0]), &RecordsRead)) {
+        return 0;
+    }
+
+    KeyPresses = 0;
+    for (Index = 0; Index < RecordsRead; Index++) {
+        if (InputRecords[Index].EventType == KEY_EVENT &&
+            InputRecords[Index].Event.KeyEvent.bKeyDown) {
+
+            KeyCode = InputRecords[Index].Event.KeyEvent.wVirtualKeyCode;
+            if (KeyCode != VK_SHIFT &&
+                KeyCode != VK_CONTROL &&
+                KeyCode != VK_MENU) {
+
+                KeyPresses++;
+            }
+        }
+    }
+
+    return KeyPresses;
+}
+
+/**
+ Populates the list of matches for a file based tab completion.  Because
+ enumerating files can take a long time, particularly on network paths,
+ the enumeration is performed on a background thread while this thread
+ monitors console input.  If the user presses a key before the enumeration
+ completes, the request is cancelled and abandoned so the key can be
+ processed immediately, and the tab context is marked as incomplete so a
+ later tab operation will search again.  If a background thread cannot be
+ used, the enumeration is performed on this thread.
+
+ @param TabContext Pointer to the tab completion context.  This provides
+        the search criteria and has its match list populated with results
+        on success.
+
+ @param ExpandFullPath Specifies if full path expansion should be performed.
+
+ @param IncludeDirectories TRUE if directories should be included in results,
+        FALSE if they should be ommitted.
+
+ @param IncludeFiles TRUE if files should be included in results, FALSE if
+        they should be ommitted (used for directory only results.)
+
+ @param KeepCompletionsSorted TRUE to keep the list of completion options
+        sorted.
+ */
+VOID
+YoriShPerformFileTabCompletion(
+    __inout PYORI_SH_TAB_COMPLETE_CONTEXT TabContext,
+    __in BOOLEAN ExpandFullPath,
+    __in BOOLEAN IncludeDirectories,
+    __in BOOLEAN IncludeFiles,
+    __in BOOLEAN KeepCompletionsSorted
+    )
+{
+    PYORI_SH_ASYNC_FILE_COMPLETE_REQUEST Request;
+    PYORI_LIST_ENTRY ListEntry;
+    PYORI_SH_TAB_COMPLETE_MATCH Match;
+    PYORI_HASH_ENTRY PriorEntry;
+    HANDLE InputHandle;
+    HANDLE WaitHandles[2];
+    HANDLE ThreadHandle;
+    DWORD ThreadId;
+    DWORD ConsoleMode;
+    DWORD KeyPressesAtStart;
+    DWORD Err;
+    BOOLEAN Completed;
+
+    //
+    //  If input isn't a console there's nothing to monitor, so there's no
+    //  benefit from a background thread.
+    //
+
+    InputHandle = GetStdHandle(STD_INPUT_HANDLE);
+    if (!GetConsoleMode(InputHandle, &ConsoleMode)) {
+        YoriShPerformFileTabCompletionSynchronous(TabContext, ExpandFullPath, IncludeDirectories, IncludeFiles, KeepCompletionsSorted);
+        return;
+    }
+
+    Request = YoriLibMalloc(sizeof(YORI_SH_ASYNC_FILE_COMPLETE_REQUEST));
+    if (Request == NULL) {
+        YoriShPerformFileTabCompletionSynchronous(TabContext, ExpandFullPath, IncludeDirectories, IncludeFiles, KeepCompletionsSorted);
+        return;
+    }
+
+    //
+    //  The search string is copied rather than referenced, since the
+    //  request may outlive the caller's tab context and reference counts
+    //  on strings are not updated atomically.
+    //
+
+    ZeroMemory(Request, sizeof(YORI_SH_ASYNC_FILE_COMPLETE_REQUEST));
+    Request->ReferenceCount = 1;
+    Request->ExpandFullPath = ExpandFullPath;
+    Request->IncludeDirectories = IncludeDirectories;
+    Request->IncludeFiles = IncludeFiles;
+    Request->KeepCompletionsSorted = KeepCompletionsSorted;
+    Request->TabContext.TabFlagsUsedCreatingList = TabContext->TabFlagsUsedCreatingList;
+    Request->TabContext.SearchType = TabContext->SearchType;
+    Request->TabContext.SearchStringOffset = TabContext->SearchStringOffset;
+    YoriLibInitializeListHead(&Request->TabContext.MatchList);
+    Request->TabContext.MatchHashTable = YoriLibAllocateHashTable(250);
+    if (Request->TabContext.MatchHashTable == NULL ||
+        !YoriLibAllocateString(&Request->TabContext.SearchString, TabContext->SearchString.LengthInChars + 1)) {
+
+        YoriShDereferenceAsyncFileCompleteRequest(Request);
+        YoriShPerformFileTabCompletionSynchronous(TabContext, ExpandFullPath, IncludeDirectories, IncludeFiles, KeepCompletionsSorted);
+        return;
+    }
+
+    memcpy(Request->TabContext.SearchString.StartOfString, TabContext->SearchString.StartOfString, TabContext->SearchString.LengthInChars * sizeof(TCHAR));
+    Request->TabContext.SearchString.StartOfString[TabContext->SearchString.LengthInChars] = '\0';
+    Request->TabContext.SearchString.LengthInChars = TabContext->SearchString.LengthInChars;
+
+    //
+    //  Any key presses that were already queued before this request started
+    //  are type-ahead that the input loop is still processing, so only key
+    //  presses beyond these indicate the user has continued typing.
+    //
+
+    KeyPressesAtStart = YoriShCountPendingKeyPresses(InputHandle);
+
+    Request->ReferenceCount = 2;
+    ThreadHandle = CreateThread(NULL, 0, YoriShAsyncFileTabCompletionWorker, Request, 0, &ThreadId);
+    if (ThreadHandle == NULL) {
+        Request->ReferenceCount = 1;
+        YoriShDereferenceAsyncFileCompleteRequest(Request);
+        YoriShPerformFileTabCompletionSynchronous(TabContext, ExpandFullPath, IncludeDirectories, IncludeFiles, KeepCompletionsSorted);
+        return;
+    }
+
+    WaitHandles[0] = ThreadHandle;
+    WaitHandles[1] = InputHandle;
+    Completed = FALSE;
+
+    while (TRUE) {
+        Err = WaitForMultipleObjects(2, WaitHandles, FALSE, INFINITE);
+        if (Err == WAIT_OBJECT_0) {
+            Completed = TRUE;
+            break;
+        }
+
+        if (Err != (WAIT_OBJECT_0 + 1)) {
+            break;
+        }
+
+        if (YoriShCountPendingKeyPresses(InputHandle) > KeyPressesAtStart) {
+            break;
+        }
+
+        //
+        //  The console has input which isn't a new key press, such as mouse
+        //  or window events.  These remain in the queue until the input loop
+        //  processes them, so the console handle stays signalled; wait on
+        //  the thread for a while before checking again.
+        //
+
+        if (WaitForSingleObject(ThreadHandle, YORI_SH_ASYNC_COMPLETE_POLL_INTERVAL) == WAIT_OBJECT_0) {
+            Completed = TRUE;
+            break;
+        }
+    }
+
+    CloseHandle(ThreadHandle);
+
+    if (!Completed) {
+
+        //
+        //  Tell the enumeration to stop, and let it clean up whenever it
+        //  observes this.  Indicate that the results here are incomplete so
+        //  the next tab operation searches again.
+        //
+
+        Request->TabContext.Cancelled = TRUE;
+        TabContext->PotentialNonPrefixMatch = TRUE;
+        YoriShDereferenceAsyncFileCompleteRequest(Request);
+        return;
+    }
+
+    //
+    //  Move the results into the caller's context.  Matches are appended in
+    //  the order the enumeration produced them, which is sorted if requested.
+    //  Any match already in the caller's context is discarded.
+    //
+
+    if (Request->TabContext.PotentialNonPrefixMatch) {
+        TabContext->PotentialNonPrefixMatch = TRUE;
+    }
+
+    ListEntry = YoriLibGetNextListEntry(&Request->TabContext.MatchList, NULL);
+    while (ListEntry != NULL) {
+        Match = CONTAINING_RECORD(ListEntry, YORI_SH_TAB_COMPLETE_MATCH, ListEntry);
+        ListEntry = YoriLibGetNextListEntry(&Request->TabContext.MatchList, ListEntry);
+
+        PriorEntry = YoriLibHashLookupByKey(TabContext->MatchHashTable, &Match->Value);
+        if (PriorEntry == NULL) {
+            YoriLibHashRemoveByEntry(&Match->HashEntry);
+            YoriLibRemoveListItem(&Match->ListEntry);
+            YoriShAddMatchToTabContextAtEnd(TabContext, Match);
+        }
+    }
+
+    YoriShDereferenceAsyncFileCompleteRequest(Request);
+}
+
 /**
  A context describing the actions that can be performed in response to a
  completion within a command argument.
@@ -2108,6 +2455,14 @@ YoriShPopulateTabCompletionMatches(
     BOOLEAN KeepSorted;
     BOOLEAN SearchHistory = FALSE;
     BOOLEAN ExpandFullPath = FALSE;
+    DWORDLONG StartTime;
+    DWORDLONG MatchCount;
+    PYORI_LIST_ENTRY ListEntry;
+
+    StartTime = 0;
+    if (YoriLibEtwIsEnabled(YORI_LIB_ETW_KEYWORD_COMPLETE)) {
+        StartTime = YoriLibEtwGetTimestamp();
+    }
 
     if ((TabFlags & YORI_SH_TAB_COMPLETE_FULL_PATH) != 0) {
         ExpandFullPath = TRUE;
@@ -2198,6 +2553,24 @@ YoriShPopulateTabCompletionMatches(
     } else {
         YoriShPerformFileTabCompletion(&Buffer->TabContext, ExpandFullPath, TRUE, TRUE, KeepSorted);
     }
+
+    if (StartTime != 0) {
+        MatchCount = 0;
+        ListEntry = YoriLibGetNextListEntry(&Buffer->TabContext.MatchList, NULL);
+        while (ListEntry != NULL) {
+            MatchCount++;
+            ListEntry = YoriLibGetNextListEntry(&Buffer->TabContext.MatchList, ListEntry);
+        }
+
+        YoriLibEtwWriteEvent(YORI_LIB_ETW_KEYWORD_COMPLETE,
+                             "TabComplete",
+                             "SearchString",
+                             &Buffer->TabContext.SearchString,
+                             "MatchCount",
+                             MatchCount,
+                             "DurationUs",
+                             YoriLibEtwGetTimestamp() - StartTime);
+    }
 }
 
 /**
@@ -2653,7 +3026,7 @@ YoriShTabCompletion(
 
     ASSERT(Buffer->CurrentOffset >= PrefixBeforeBackquoteSubstring.LengthInChars);
 
-    if (!YoriLibShParseCmdlineToCmdContext(&BackquoteSubset, OffsetInSubstring, &CmdContext)) {
+    if (!YoriShParseCmdlineWithCache(&Buffer->ParseCache, &BackquoteSubset, OffsetInSubstring, &CmdContext)) {
         return FALSE;
     }
 
@@ -2869,7 +3242,7 @@ YoriShPrependParentDirectory(
 
     ASSERT(Buffer->CurrentOffset >= PrefixBeforeBackquoteSubstring.LengthInChars);
 
-    if (!YoriLibShParseCmdlineToCmdContext(&BackquoteSubset, OffsetInSubstring, &CmdContext)) {
+    if (!YoriShParseCmdlineWithCache(&Buffer->ParseCache, &BackquoteSubset, OffsetInSubstring, &CmdContext)) {
         return;
     }
 
@@ -3075,6 +3448,23 @@ YoriShCompleteSuggestion(
         return;
     }
 
+    //
+    //  If the cursor is at the end of the line and a previous command
+    //  started with the same text, suggest the rest of that command.  This
+    //  is a lookup in the history trie, so it is preferred to parsing the
+    //  line and enumerating files.  Since no match list is populated, as
+    //  more characters are typed the suggestion is advanced if it remains
+    //  consistent or discarded so this function is invoked again.
+    //
+
+    if (Buffer->CurrentOffset == Buffer->String.LengthInChars &&
+        Buffer->String.LengthInChars >= YoriShGlobal.MinimumCharsInArgBeforeSuggesting &&
+        YoriShGetHistorySuggestion(&Buffer->String, &Buffer->SuggestionString)) {
+
+        Buffer->TabContext.CurrentArgLength = 0;
+        return;
+    }
+
     YoriShFindStringSubsetForCompletion(&Buffer->String,
                                         Buffer->CurrentOffset,
                                         Buffer->TabContext.SearchType,
@@ -3087,7 +3477,7 @@ YoriShCompleteSuggestion(
         return;
     }
 
-    if (!YoriLibShParseCmdlineToCmdContext(&BackquoteSubset, OffsetInSubstring, &CmdContext)) {
+    if (!YoriShParseCmdlineWithCache(&Buffer->ParseCache, &BackquoteSubset, OffsetInSubstring, &CmdContext)) {
         return;
     }
 
@@ -1054,79 +1054,323 @@ YoriShSetEnvironmentVariable(
 }
 
 /**
- Apply an environment block into the running process.  Variables not explicitly
- included in this block are discarded.
+ Return the environment block of the shell process.  The shell keeps a copy
+ of the block which is regenerated when the environment generation changes,
+ and the caller receives a reference to that copy, which must be treated as
+ read only and released with YoriLibFreeStringContents.
 
- @param NewEnv Pointer to the new environment block to apply.
+ @param EnvStrings On successful completion, populated with a reference to
+        the environment block.
 
  @return TRUE to indicate success, FALSE to indicate failure.
  */
 __success(return)
 BOOLEAN
-YoriShSetEnvironmentStrings(
-    __in PYORI_STRING NewEnv
+YoriShGetEnvironmentStrings(
+    __out PYORI_STRING EnvStrings
+    )
+{
+    YORI_STRING NewEnvironment;
+
+    if (YoriShGlobal.EnvironmentStrings.StartOfString == NULL ||
+        YoriShGlobal.EnvironmentStringsGeneration != YoriShGlobal.EnvironmentGeneration) {
+
+        if (!YoriLibGetEnvironmentStrings(&NewEnvironment)) {
+            return FALSE;
+        }
+
+        YoriLibFreeStringContents(&YoriShGlobal.EnvironmentStrings);
+        memcpy(&YoriShGlobal.EnvironmentStrings, &NewEnvironment, sizeof(YORI_STRING));
+        YoriShGlobal.EnvironmentStringsGeneration = YoriShGlobal.EnvironmentGeneration;
+    }
+
+    YoriLibCloneString(EnvStrings, &YoriShGlobal.EnvironmentStrings);
+    return TRUE;
+}
+
+/**
+ A variable within the environment of the shell process, used to determine
+ which variables change when a new environment block is applied.
+ */
+typedef struct _YORI_SH_ENV_APPLY_ENTRY {
+
+    /**
+     The hash entry for the variable, keyed by the variable name.  The key
+     points into the environment block.
+     */
+    YORI_HASH_ENTRY HashEntry;
+
+    /**
+     The value of the variable.  This points into the environment block.
+     */
+    YORI_STRING Value;
+
+    /**
+     Set to TRUE if the new environment block contains a variable with
+     exactly this name, so the variable should not be deleted.
+     */
+    BOOLEAN Retained;
+
+} YORI_SH_ENV_APPLY_ENTRY, *PYORI_SH_ENV_APPLY_ENTRY;
+
+/**
+ Split an entry within an environment block into its name and value.  The
+ first character is always part of the name, even if it is an equals sign,
+ since that's how drive current directories are recorded.
+
+ @param ThisVar Pointer to the NULL terminated entry.
+
+ @param Name On successful completion, populated to refer to the name
+        within the entry.  This is not NULL terminated.
+
+ @param Value On successful completion, populated to refer to the value
+        within the entry.  This is NULL terminated.
+
+ @return TRUE if the entry contains a name and value, FALSE if it does not.
+ */
+__success(return)
+BOOLEAN
+YoriShSplitEnvironmentEntry(
+    __in LPTSTR ThisVar,
+    __out PYORI_STRING Name,
+    __out PYORI_STRING Value
+    )
+{
+    LPTSTR ThisValue;
+
+    ThisValue = _tcschr(&ThisVar[1], '=');
+    if (ThisValue == NULL) {
+        return FALSE;
+    }
+
+    YoriLibInitEmptyString(Name);
+    Name->StartOfString = ThisVar;
+    Name->LengthInChars = (YORI_ALLOC_SIZE_T)(ThisValue - ThisVar);
+
+    ThisValue++;
+    YoriLibInitEmptyString(Value);
+    Value->StartOfString = ThisValue;
+    Value->LengthInChars = (YORI_ALLOC_SIZE_T)_tcslen(ThisValue);
+    Value->LengthAllocated = Value->LengthInChars + 1;
+    return TRUE;
+}
+
+/**
+ Apply an environment block into the running process.  Only variables whose
+ values differ from the current environment are changed, so applying a block
+ that matches the current environment does not modify the process
+ environment or advance the environment generation.
+
+ @param NewEnv Pointer to the new environment block to apply.  This is not
+        modified.
+
+ @param RemoveMissing If TRUE, variables not explicitly included in this
+        block are discarded.  If FALSE, they are left unchanged.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+YoriShApplyEnvironmentStrings(
+    __in PYORI_STRING NewEnv,
+    __in BOOLEAN RemoveMissing
     )
 {
     YORI_STRING CurrentEnvironment;
+    YORI_STRING Name;
+    YORI_STRING Value;
+    PYORI_HASH_TABLE CurrentVariables;
+    PYORI_SH_ENV_APPLY_ENTRY Entries;
+    PYORI_SH_ENV_APPLY_ENTRY Entry;
+    PYORI_HASH_ENTRY HashEntry;
+    LPTSTR NameBuffer;
     LPTSTR ThisVar;
-    LPTSTR ThisValue;
-    DWORD VarLen;
+    YORI_ALLOC_SIZE_T VarCount;
+    YORI_ALLOC_SIZE_T MaxNameLength;
+    YORI_ALLOC_SIZE_T Index;
+    BOOLEAN Changed;
 
     //
-    //  Query the current environment and delete everything in it.
+    //  Query the current environment and count the variables in it, along
+    //  with the longest name in either block so names can be NULL
+    //  terminated for the system without modifying either block.
     //
 
-    if (!YoriLibGetEnvironmentStrings(&CurrentEnvironment)) {
+    if (!YoriShGetEnvironmentStrings(&CurrentEnvironment)) {
         return FALSE;
     }
+
+    VarCount = 0;
+    MaxNameLength = 0;
     ThisVar = CurrentEnvironment.StartOfString;
     while (*ThisVar != '\0') {
-        VarLen = _tcslen(ThisVar);
+        if (YoriShSplitEnvironmentEntry(ThisVar, &Name, &Value)) {
+            VarCount++;
+            if (Name.LengthInChars > MaxNameLength) {
+                MaxNameLength = Name.LengthInChars;
+            }
+        }
+        ThisVar += _tcslen(ThisVar);
+        ThisVar++;
+    }
 
-        //
-        //  We know there's at least one char.  Skip it if it's equals since
-        //  that's how drive current directories are recorded.
-        //
+    ThisVar = NewEnv->StartOfString;
+    while (*ThisVar != '\0') {
+        if (YoriShSplitEnvironmentEntry(ThisVar, &Name, &Value)) {
+            if (Name.LengthInChars > MaxNameLength) {
+                MaxNameLength = Name.LengthInChars;
+            }
+        }
+        ThisVar += _tcslen(ThisVar);
+        ThisVar++;
+    }
 
-        ThisValue = _tcschr(&ThisVar[1], '=');
-        if (ThisValue != NULL) {
-            ThisValue[0] = '\0';
-            SetEnvironmentVariable(ThisVar, NULL);
+    CurrentVariables = YoriLibAllocateHashTable(256);
+    Entries = YoriLibMalloc((VarCount + 1) * (YORI_ALLOC_SIZE_T)sizeof(YORI_SH_ENV_APPLY_ENTRY));
+    NameBuffer = YoriLibMalloc((MaxNameLength + 1) * (YORI_ALLOC_SIZE_T)sizeof(TCHAR));
+    if (CurrentVariables == NULL || Entries == NULL || NameBuffer == NULL) {
+        if (CurrentVariables != NULL) {
+            YoriLibFreeEmptyHashTable(CurrentVariables);
+        }
+        if (Entries != NULL) {
+            YoriLibFree(Entries);
         }
+        if (NameBuffer != NULL) {
+            YoriLibFree(NameBuffer);
+        }
+        YoriLibFreeStringContents(&CurrentEnvironment);
+        return FALSE;
+    }
+
+    //
+    //  Index the current environment by name.  Names are compared without
+    //  regard to case, as the system does.
+    //
 
-        ThisVar += VarLen;
+    Index = 0;
+    ThisVar = CurrentEnvironment.StartOfString;
+    while (*ThisVar != '\0') {
+        if (YoriShSplitEnvironmentEntry(ThisVar, &Name, &Value)) {
+            Entry = &Entries[Index];
+            memcpy(&Entry->Value, &Value, sizeof(YORI_STRING));
+            Entry->Retained = FALSE;
+            YoriLibHashInsertByKey(CurrentVariables, &Name, Entry, &Entry->HashEntry);
+            Index++;
+        }
+        ThisVar += _tcslen(ThisVar);
         ThisVar++;
     }
-    YoriLibFreeStringContents(&CurrentEnvironment);
 
     //
-    //  Now load the new environment.
+    //  Mark every variable that the new block also contains.  A variable
+    //  whose name differs only in case is deleted and recreated so the new
+    //  block's case is used.
     //
 
     ThisVar = NewEnv->StartOfString;
     while (*ThisVar != '\0') {
-        VarLen = _tcslen(ThisVar);
+        if (YoriShSplitEnvironmentEntry(ThisVar, &Name, &Value)) {
+            HashEntry = YoriLibHashLookupByKey(CurrentVariables, &Name);
+            if (HashEntry != NULL &&
+                YoriLibCompareString(&HashEntry->Key, &Name) == 0) {
 
-        //
-        //  We know there's at least one char.  Skip it if it's equals since
-        //  that's how drive current directories are recorded.
-        //
+                Entry = HashEntry->Context;
+                Entry->Retained = TRUE;
+            }
+        }
+        ThisVar += _tcslen(ThisVar);
+        ThisVar++;
+    }
 
-        ThisValue = _tcschr(&ThisVar[1], '=');
-        if (ThisValue != NULL) {
-            ThisValue[0] = '\0';
-            ThisValue++;
-            SetEnvironmentVariable(ThisVar, ThisValue);
+    //
+    //  Delete the variables that are not retained, then set each variable
+    //  that is new or whose value has changed.
+    //
+
+    Changed = FALSE;
+    for (Index = 0; Index < VarCount && RemoveMissing; Index++) {
+        Entry = &Entries[Index];
+        if (!Entry->Retained) {
+            memcpy(NameBuffer, Entry->HashEntry.Key.StartOfString, Entry->HashEntry.Key.LengthInChars * sizeof(TCHAR));
+            NameBuffer[Entry->HashEntry.Key.LengthInChars] = '\0';
+            SetEnvironmentVariable(NameBuffer, NULL);
+            Changed = TRUE;
         }
+    }
 
-        ThisVar += VarLen;
+    ThisVar = NewEnv->StartOfString;
+    while (*ThisVar != '\0') {
+        if (YoriShSplitEnvironmentEntry(ThisVar, &Name, &Value)) {
+            HashEntry = YoriLibHashLookupByKey(CurrentVariables, &Name);
+            Entry = NULL;
+            if (HashEntry != NULL) {
+                Entry = HashEntry->Context;
+            }
+
+            if (Entry == NULL ||
+                !Entry->Retained ||
+                YoriLibCompareString(&Entry->Value, &Value) != 0) {
+
+                memcpy(NameBuffer, Name.StartOfString, Name.LengthInChars * sizeof(TCHAR));
+                NameBuffer[Name.LengthInChars] = '\0';
+                SetEnvironmentVariable(NameBuffer, Value.StartOfString);
+                Changed = TRUE;
+            }
+        }
+        ThisVar += _tcslen(ThisVar);
         ThisVar++;
     }
 
-    YoriShGlobal.EnvironmentGeneration++;
+    for (Index = 0; Index < VarCount; Index++) {
+        YoriLibHashRemoveByEntry(&Entries[Index].HashEntry);
+    }
+    YoriLibFreeEmptyHashTable(CurrentVariables);
+    YoriLibFree(Entries);
+    YoriLibFree(NameBuffer);
+    YoriLibFreeStringContents(&CurrentEnvironment);
+
+    if (Changed) {
+        YoriShGlobal.EnvironmentGeneration++;
+    }
 
     return TRUE;
 }
 
+/**
+ Apply an environment block into the running process.  Variables not explicitly
+ included in this block are discarded.
+
+ @param NewEnv Pointer to the new environment block to apply.  This is not
+        modified.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+YoriShSetEnvironmentStrings(
+    __in PYORI_STRING NewEnv
+    )
+{
+    return YoriShApplyEnvironmentStrings(NewEnv, TRUE);
+}
+
+/**
+ Apply a set of variables into the running process.  Variables not included
+ in this block are left unchanged.
+
+ @param NewEnv Pointer to a block of variables to apply, in environment block
+        form.  This is not modified.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+YoriShMergeEnvironmentStrings(
+    __in PYORI_STRING NewEnv
+    )
+{
+    return YoriShApplyEnvironmentStrings(NewEnv, FALSE);
+}
+
 
 // vim:sw=4:ts=4:et:
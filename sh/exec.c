@@ -260,6 +260,7 @@ YoriShExecuteSingleProgram(
                 if (YoriShCreateNewJob(ExecContext)) {
                     ExecContext->dwProcessId = 0;
                     ExecContext->hProcess = NULL;
+                    ExecContext->hJob = NULL;
                 }
             }
         }
@@ -380,6 +381,18 @@ YoriShExecExecPlan(
     PVOID PreviouslyObservedOutputBuffer = NULL;
     BOOLEAN ExecutableFound;
 
+    //
+    //  If this plan will become a background job and the user has limited
+    //  the number of concurrent jobs, hold it until a job completes.
+    //
+
+    if (OutputBuffer == NULL &&
+        !ExecPlan->WaitForCompletion &&
+        !YoriShJobWaitForSlot()) {
+
+        return;
+    }
+
     //
     //  If a plan requires executing multiple tasks without waiting, hand the
     //  request to a subshell so we can execute a single thing without
@@ -432,6 +445,12 @@ YoriShExecExecPlan(
                 break;
             }
 
+            if (ExecutableFound &&
+                YoriShResolveToolToBuiltin(&ExecContext->CmdToExec)) {
+
+                ExecutableFound = FALSE;
+            }
+
             if (ExecutableFound) {
                 YoriShGlobal.ErrorLevel = YoriShExecuteSingleProgram(ExecContext);
             } else if (ExecPlan->NumberCommands == 1 && !ExecPlan->WaitForCompletion) {
@@ -521,51 +540,78 @@ YoriShExecExecPlan(
 }
 
 /**
- Execute an expression and capture the output of the entire expression into
- a buffer.  This is used when evaluating backquoted expressions.
+ The maximum number of backquote substrings that are executed concurrently.
+ */
+#define YORI_SH_MAX_CONCURRENT_BACKQUOTES 16
+
+/**
+ A backquote expression which has been parsed and prepared for execution,
+ and which may have been launched, but whose output has not been collected.
+ */
+typedef struct _YORI_SH_PENDING_CAPTURE {
+
+    /**
+     The parsed form of the expression.
+     */
+    YORI_LIBSH_CMD_CONTEXT CmdContext;
+
+    /**
+     The plan to execute the expression.
+     */
+    YORI_LIBSH_EXEC_PLAN ExecPlan;
+
+    /**
+     TRUE if the expression is a single program which has already been
+     launched and is writing into a buffer.  FALSE if the plan has not
+     started executing.
+     */
+    BOOLEAN Launched;
+} YORI_SH_PENDING_CAPTURE, *PYORI_SH_PENDING_CAPTURE;
+
+/**
+ Parse an expression whose output should be captured into a buffer, and
+ construct a plan to execute it.
 
  @param Expression Pointer to a string describing the expression to execute.
 
- @param ProcessOutput On successful completion, populated with the result of
-        the expression.
+ @param Pending On successful completion, populated with the plan to execute.
+        The caller should pass this to @ref YoriShCompleteCapture .
 
  @return TRUE to indicate success, FALSE to indicate failure.
  */
 __success(return)
-BOOL
-YoriShExecuteExpressionAndCaptureOutput(
+BOOLEAN
+YoriShPrepareCapture(
     __in PYORI_STRING Expression,
-    __out PYORI_STRING ProcessOutput
+    __out PYORI_SH_PENDING_CAPTURE Pending
     )
 {
-    YORI_LIBSH_EXEC_PLAN ExecPlan;
     PYORI_LIBSH_SINGLE_EXEC_CONTEXT ExecContext;
-    YORI_LIBSH_CMD_CONTEXT CmdContext;
-    PVOID OutputBuffer;
-    YORI_ALLOC_SIZE_T Index;
+
+    Pending->Launched = FALSE;
 
     //
     //  Parse the expression we're trying to execute.
     //
 
-    if (!YoriLibShParseCmdlineToCmdContext(Expression, 0, &CmdContext)) {
+    if (!YoriShParseCmdlineForExecution(Expression, &Pending->CmdContext)) {
         YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Parse error\n"));
         return FALSE;
     }
 
-    if (CmdContext.ArgC == 0) {
-        YoriLibShFreeCmdContext(&CmdContext);
+    if (Pending->CmdContext.ArgC == 0) {
+        YoriLibShFreeCmdContext(&Pending->CmdContext);
         return FALSE;
     }
 
-    if (!YoriShExpandEnvironmentInCmdContext(&CmdContext)) {
-        YoriLibShFreeCmdContext(&CmdContext);
+    if (!YoriShExpandEnvironmentInCmdContext(&Pending->CmdContext)) {
+        YoriLibShFreeCmdContext(&Pending->CmdContext);
         return FALSE;
     }
 
-    if (!YoriLibShParseCmdContextToExecPlan(&CmdContext, &ExecPlan, NULL, NULL, NULL, NULL)) {
+    if (!YoriLibShParseCmdContextToExecPlan(&Pending->CmdContext, &Pending->ExecPlan, NULL, NULL, NULL, NULL)) {
         YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Parse error\n"));
-        YoriLibShFreeCmdContext(&CmdContext);
+        YoriLibShFreeCmdContext(&Pending->CmdContext);
         return FALSE;
     }
 
@@ -574,7 +620,7 @@ YoriShExecuteExpressionAndCaptureOutput(
     //  shell owned buffer, and the process must wait.
     //
 
-    ExecContext = ExecPlan.FirstCmd;
+    ExecContext = Pending->ExecPlan.FirstCmd;
     while (ExecContext != NULL) {
 
         if (ExecContext->StdOutType == StdOutTypeDefault) {
@@ -590,7 +636,139 @@ YoriShExecuteExpressionAndCaptureOutput(
         ExecContext = ExecContext->NextProgram;
     }
 
-    YoriShExecExecPlan(&ExecPlan, &OutputBuffer);
+    return TRUE;
+}
+
+/**
+ Attempt to launch a prepared backquote expression without waiting for it
+ to complete, so that it can execute concurrently with other backquote
+ expressions.  This is only done for an expression consisting of a single
+ external program.  Builtins, scripts, and anything else that needs to run
+ within the shell or change its state are left to execute serially when
+ their output is collected.
+
+ @param Pending Pointer to the prepared expression.
+
+ @return TRUE if the program was launched, FALSE if it should be executed
+         when its output is collected.
+ */
+BOOLEAN
+YoriShLaunchCaptureConcurrently(
+    __inout PYORI_SH_PENDING_CAPTURE Pending
+    )
+{
+    PYORI_LIBSH_SINGLE_EXEC_CONTEXT ExecContext;
+    YORI_LIBSH_CMD_CONTEXT ResolvedCmd;
+    YORI_STRING Extension;
+    LPTSTR szExt;
+    BOOLEAN ExecutableFound;
+    BOOL FailedInRedirection;
+
+    ExecContext = Pending->ExecPlan.FirstCmd;
+    if (Pending->ExecPlan.NumberCommands != 1 ||
+        ExecContext == NULL ||
+        !ExecContext->WaitForCompletion ||
+        ExecContext->StdOutType != StdOutTypeBuffer ||
+        YoriLibIsPathUrl(&ExecContext->CmdToExec.ArgV[0]) ||
+        YoriLibCompareStringLitIns(&ExecContext->CmdToExec.ArgV[0], _T("BUILTIN")) == 0) {
+
+        return FALSE;
+    }
+
+    //
+    //  Resolve the program in a copy of the arguments, so that if it can't
+    //  be launched here, the plan is unchanged and alias expansion is only
+    //  applied once when it is executed.
+    //
+
+    if (!YoriLibShCopyCmdContext(&ResolvedCmd, &ExecContext->CmdToExec)) {
+        return FALSE;
+    }
+
+    if (!YoriShResolveCommandToExecutable(&ResolvedCmd, &ExecutableFound) ||
+        !ExecutableFound ||
+        YoriShResolveToolToBuiltin(&ResolvedCmd)) {
+
+        YoriLibShFreeCmdContext(&ResolvedCmd);
+        return FALSE;
+    }
+
+    szExt = YoriLibFindRightMostCharacter(&ResolvedCmd.ArgV[0], '.');
+    if (szExt == NULL) {
+        YoriLibShFreeCmdContext(&ResolvedCmd);
+        return FALSE;
+    }
+
+    YoriLibInitEmptyString(&Extension);
+    Extension.StartOfString = szExt;
+    Extension.LengthInChars = ResolvedCmd.ArgV[0].LengthInChars - (YORI_ALLOC_SIZE_T)(szExt - ResolvedCmd.ArgV[0].StartOfString);
+    if (YoriLibCompareStringLitIns(&Extension, _T(".exe")) != 0) {
+        YoriLibShFreeCmdContext(&ResolvedCmd);
+        return FALSE;
+    }
+
+    YoriLibShFreeCmdContext(&ExecContext->CmdToExec);
+    memcpy(&ExecContext->CmdToExec, &ResolvedCmd, sizeof(YORI_LIBSH_CMD_CONTEXT));
+
+    //
+    //  If the launch fails, the program is executed again when its output
+    //  is collected, which reports the error or tries other ways to launch
+    //  it.  Since the arguments are already resolved, resolving them again
+    //  finds the same program.
+    //
+
+    ExecContext->StdOut.Buffer.ProcessBuffers = NULL;
+    FailedInRedirection = FALSE;
+    if (YoriLibShCreateProcess(ExecContext, NULL, &FailedInRedirection) != NO_ERROR) {
+        YoriLibShCleanupFailedProcessLaunch(ExecContext);
+        return FALSE;
+    }
+
+    YoriLibShCommenceProcessBuffersIfNeeded(ExecContext);
+    Pending->Launched = TRUE;
+    return TRUE;
+}
+
+/**
+ Execute a prepared backquote expression if it has not been launched, wait
+ for it to complete, and return its output.  This frees the prepared
+ expression.
+
+ @param Pending Pointer to the prepared expression.
+
+ @param ProcessOutput On successful completion, populated with the result of
+        the expression.
+ */
+VOID
+YoriShCompleteCapture(
+    __inout PYORI_SH_PENDING_CAPTURE Pending,
+    __out PYORI_STRING ProcessOutput
+    )
+{
+    PYORI_LIBSH_SINGLE_EXEC_CONTEXT ExecContext;
+    PVOID OutputBuffer;
+    YORI_ALLOC_SIZE_T Index;
+    DWORD ExitCode;
+
+    if (Pending->Launched) {
+        ExecContext = Pending->ExecPlan.FirstCmd;
+        if (!YoriLibIsOperationCancelled()) {
+            YoriShWaitForProcessToTerminate(ExecContext);
+        }
+
+        if (YoriLibIsOperationCancelled()) {
+            YoriShCancelExecPlan(&Pending->ExecPlan);
+        }
+
+        ExitCode = EXIT_FAILURE;
+        if (ExecContext->hProcess != NULL) {
+            GetExitCodeProcess(ExecContext->hProcess, &ExitCode);
+        }
+        YoriShGlobal.ErrorLevel = ExitCode;
+        OutputBuffer = ExecContext->StdOut.Buffer.ProcessBuffers;
+    } else {
+        YoriShExecExecPlan(&Pending->ExecPlan, &OutputBuffer);
+    }
 
     YoriLibInitEmptyString(ProcessOutput);
     if (OutputBuffer != NULL) {
@@ -619,9 +797,35 @@ YoriShExecuteExpressionAndCaptureOutput(
         }
     }
 
-    YoriLibShFreeExecPlan(&ExecPlan);
-    YoriLibShFreeCmdContext(&CmdContext);
+    YoriLibShFreeExecPlan(&Pending->ExecPlan);
+    YoriLibShFreeCmdContext(&Pending->CmdContext);
+}
+
+/**
+ Execute an expression and capture the output of the entire expression into
+ a buffer.  This is used when evaluating backquoted expressions.
+
+ @param Expression Pointer to a string describing the expression to execute.
+
+ @param ProcessOutput On successful completion, populated with the result of
+        the expression.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriShExecuteExpressionAndCaptureOutput(
+    __in PYORI_STRING Expression,
+    __out PYORI_STRING ProcessOutput
+    )
+{
+    YORI_SH_PENDING_CAPTURE Pending;
+
+    if (!YoriShPrepareCapture(Expression, &Pending)) {
+        return FALSE;
+    }
 
+    YoriShCompleteCapture(&Pending, ProcessOutput);
     return TRUE;
 }
 
@@ -629,7 +833,10 @@ YoriShExecuteExpressionAndCaptureOutput(
 /**
  Parse and execute all backquotes in an expression, potentially resulting
  in a new expression.  This will internally perform parsing and redirection,
- as well as execute multiple subprocesses as needed.
+ as well as execute multiple subprocesses as needed.  Backquotes at the same
+ level of nesting are independent, so where several of these consist of a
+ single external program, the programs execute concurrently.  Output from
+ each is captured separately and substituted in order.
 
  @param Expression The string to execute.
 
@@ -647,16 +854,19 @@ YoriShExpandBackquotes(
     )
 {
     YORI_STRING CurrentFullExpression;
-    YORI_STRING CurrentExpressionSubset;
-
-    YORI_STRING ProcessOutput;
+    YORI_STRING ExpressionSubsets[YORI_SH_MAX_CONCURRENT_BACKQUOTES];
+    YORI_ALLOC_SIZE_T CharsInBackquotePrefix[YORI_SH_MAX_CONCURRENT_BACKQUOTES];
+    YORI_ALLOC_SIZE_T SubsetCount;
+    YORI_ALLOC_SIZE_T Index;
+    YORI_ALLOC_SIZE_T PreparedCount;
+    YORI_ALLOC_SIZE_T CharsNeeded;
+    YORI_ALLOC_SIZE_T SubsetStart;
+    PYORI_SH_PENDING_CAPTURE Pending;
+    PYORI_STRING ProcessOutput;
 
     YORI_STRING InitialPortion;
-    YORI_STRING TrailingPortion;
     YORI_STRING NewFullExpression;
 
-    YORI_ALLOC_SIZE_T CharsInBackquotePrefix;
-
     YoriLibInitEmptyString(&CurrentFullExpression);
     CurrentFullExpression.StartOfString = Expression->StartOfString;
     CurrentFullExpression.LengthInChars = Expression->LengthInChars;
@@ -669,46 +879,96 @@ YoriShExpandBackquotes(
         //  create commands that can nest further backticks?
         //
 
-        if (!YoriLibShFindNextBackquoteSubstring(&CurrentFullExpression, &CurrentExpressionSubset, &CharsInBackquotePrefix)) {
+        if (!YoriLibShFindNextBackquoteSubstrings(&CurrentFullExpression, YORI_SH_MAX_CONCURRENT_BACKQUOTES, ExpressionSubsets, CharsInBackquotePrefix, &SubsetCount)) {
             break;
         }
 
-        if (!YoriShExecuteExpressionAndCaptureOutput(&CurrentExpressionSubset, &ProcessOutput)) {
-            break;
+        Pending = YoriLibMalloc(SubsetCount * (sizeof(YORI_SH_PENDING_CAPTURE) + sizeof(YORI_STRING)));
+        if (Pending == NULL) {
+            YoriLibFreeStringContents(&CurrentFullExpression);
+            return FALSE;
+        }
+        ProcessOutput = (PYORI_STRING)YoriLibAddToPointer(Pending, SubsetCount * sizeof(YORI_SH_PENDING_CAPTURE));
+
+        for (PreparedCount = 0; PreparedCount < SubsetCount; PreparedCount++) {
+            if (!YoriShPrepareCapture(&ExpressionSubsets[PreparedCount], &Pending[PreparedCount])) {
+                break;
+            }
         }
 
         //
-        //  Calculate the number of characters from before the first
-        //  backquote, the number after the last backquote, and the
-        //  number just obtained from the buffer.
+        //  If any expression can't be executed, stop evaluating backquotes,
+        //  consistent with when each was executed in turn.
         //
 
-        YoriLibInitEmptyString(&InitialPortion);
-        YoriLibInitEmptyString(&TrailingPortion);
+        if (PreparedCount < SubsetCount) {
+            for (Index = 0; Index < PreparedCount; Index++) {
+                YoriLibShFreeExecPlan(&Pending[Index].ExecPlan);
+                YoriLibShFreeCmdContext(&Pending[Index].CmdContext);
+            }
+            YoriLibFree(Pending);
+            break;
+        }
 
-        InitialPortion.StartOfString = CurrentFullExpression.StartOfString;
-        InitialPortion.LengthInChars = (YORI_ALLOC_SIZE_T)(CurrentExpressionSubset.StartOfString - CurrentFullExpression.StartOfString - CharsInBackquotePrefix);
+        if (SubsetCount > 1) {
+            for (Index = 0; Index < SubsetCount; Index++) {
+                YoriShLaunchCaptureConcurrently(&Pending[Index]);
+            }
+        }
+
+        //
+        //  Collect output in order.  Calculate the number of characters
+        //  in the new expression, which is the current expression without
+        //  each backquote and its delimiters, plus the output of each.
+        //
 
-        TrailingPortion.StartOfString = &CurrentFullExpression.StartOfString[InitialPortion.LengthInChars + CurrentExpressionSubset.LengthInChars + 1 + CharsInBackquotePrefix];
-        TrailingPortion.LengthInChars = CurrentFullExpression.LengthInChars - InitialPortion.LengthInChars - CurrentExpressionSubset.LengthInChars - 1 - CharsInBackquotePrefix;
+        CharsNeeded = CurrentFullExpression.LengthInChars + 1;
+        for (Index = 0; Index < SubsetCount; Index++) {
+            YoriShCompleteCapture(&Pending[Index], &ProcessOutput[Index]);
+            CharsNeeded = CharsNeeded - ExpressionSubsets[Index].LengthInChars - CharsInBackquotePrefix[Index] - 1;
+            CharsNeeded = CharsNeeded + ProcessOutput[Index].LengthInChars;
+        }
 
-        if (!YoriLibAllocateString(&NewFullExpression, InitialPortion.LengthInChars + ProcessOutput.LengthInChars + TrailingPortion.LengthInChars + 1)) {
+        if (!YoriLibAllocateString(&NewFullExpression, CharsNeeded)) {
+            for (Index = 0; Index < SubsetCount; Index++) {
+                YoriLibFreeStringContents(&ProcessOutput[Index]);
+            }
+            YoriLibFree(Pending);
             YoriLibFreeStringContents(&CurrentFullExpression);
-            YoriLibFreeStringContents(&ProcessOutput);
             return FALSE;
         }
 
-        NewFullExpression.LengthInChars = YoriLibSPrintf(NewFullExpression.StartOfString,
-                                                         _T("%y%y%y"),
-                                                         &InitialPortion,
-                                                         &ProcessOutput,
-                                                         &TrailingPortion);
+        //
+        //  Copy the text before each backquote followed by its output, then
+        //  the text after the final backquote.
+        //
+
+        YoriLibInitEmptyString(&InitialPortion);
+        InitialPortion.StartOfString = CurrentFullExpression.StartOfString;
+        for (Index = 0; Index < SubsetCount; Index++) {
+            SubsetStart = (YORI_ALLOC_SIZE_T)(ExpressionSubsets[Index].StartOfString - CurrentFullExpression.StartOfString);
+            InitialPortion.LengthInChars = SubsetStart - CharsInBackquotePrefix[Index] - (YORI_ALLOC_SIZE_T)(InitialPortion.StartOfString - CurrentFullExpression.StartOfString);
+
+            NewFullExpression.LengthInChars = NewFullExpression.LengthInChars +
+                YoriLibSPrintf(&NewFullExpression.StartOfString[NewFullExpression.LengthInChars],
+                               _T("%y%y"),
+                               &InitialPortion,
+                               &ProcessOutput[Index]);
+
+            InitialPortion.StartOfString = &CurrentFullExpression.StartOfString[SubsetStart + ExpressionSubsets[Index].LengthInChars + 1];
+            YoriLibFreeStringContents(&ProcessOutput[Index]);
+        }
+
+        InitialPortion.LengthInChars = CurrentFullExpression.LengthInChars - (YORI_ALLOC_SIZE_T)(InitialPortion.StartOfString - CurrentFullExpression.StartOfString);
+        NewFullExpression.LengthInChars = NewFullExpression.LengthInChars +
+            YoriLibSPrintf(&NewFullExpression.StartOfString[NewFullExpression.LengthInChars],
+                           _T("%y"),
+                           &InitialPortion);
 
+        YoriLibFree(Pending);
         YoriLibFreeStringContents(&CurrentFullExpression);
 
         memcpy(&CurrentFullExpression, &NewFullExpression, sizeof(YORI_STRING));
-
-        YoriLibFreeStringContents(&ProcessOutput);
     }
 
     memcpy(ResultingExpression, &CurrentFullExpression, sizeof(YORI_STRING));
@@ -750,7 +1010,7 @@ YoriShExecuteExpression(
     //  Parse the expression we're trying to execute.
     //
 
-    if (!YoriLibShParseCmdlineToCmdContext(&CurrentFullExpression, 0, &CmdContext)) {
+    if (!YoriShParseCmdlineForExecution(&CurrentFullExpression, &CmdContext)) {
         YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Parse error\n"));
         YoriLibFreeStringContents(&CurrentFullExpression);
         return FALSE;
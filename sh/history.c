@@ -48,6 +48,477 @@ HANDLE YoriShHistoryLock;
  */
 BOOL YoriShHistoryInitialized;
 
+/**
+ A hash table of history trigrams, keyed by each sequence of
+ @ref YORI_SH_HISTORY_TRIGRAM_LENGTH characters found within a command.  Any
+ command matching a search string must contain every trigram of that string,
+ so searches only need to consider the commands on the shortest of those
+ lists, which matters when history is very large.  This is allocated on
+ first use and may be NULL if no history has been indexed or allocation
+ failed, in which case searches fall back to scanning all history.
+ */
+PYORI_HASH_TABLE YoriShHistoryTrigramIndex;
+
+/**
+ Set to TRUE if the trigram index could not be maintained for every entry.
+ When this occurs, searches scan all history rather than trusting the index.
+ */
+BOOLEAN YoriShHistoryTrigramIndexIncomplete;
+
+/**
+ The number of lines believed to be in the history file.  This is the
+ number of lines found when loading plus the number appended since.  When
+ this grows well beyond the number of entries retained in memory the file is
+ rewritten.
+ */
+DWORD YoriShHistoryFileLineCount;
+
+/**
+ Set to TRUE if an entry which has already been written to the history file
+ has been removed, meaning the file must be rewritten rather than appended
+ to.
+ */
+BOOLEAN YoriShHistoryFileNeedsRewrite;
+
+/**
+ The root of the history suggestion trie.  The root describes no characters
+ and is never a terminal node.
+ */
+YORI_SH_HISTORY_TRIE_NODE YoriShHistoryTrieRoot;
+
+/**
+ A sequence number incremented each time a command is added to the history
+ suggestion trie, used to determine how recently a command was used.
+ */
+DWORD YoriShHistoryTrieSequence;
+
+/**
+ Return the score of a terminal node in the history suggestion trie.  Higher
+ scores are preferred when suggesting.
+
+ @param Node Pointer to the terminal node.
+
+ @return The score of the node.
+ */
+DWORDLONG
+YoriShHistoryTrieScore(
+    __in PYORI_SH_HISTORY_TRIE_NODE Node
+    )
+{
+    return (DWORDLONG)Node->LastUsed + (DWORDLONG)Node->Frequency * YORI_SH_HISTORY_FREQUENCY_WEIGHT;
+}
+
+/**
+ Return the number of leading characters that two strings have in common,
+ compared case insensitively, up to a specified maximum.
+
+ @param Str1 Pointer to the first string.
+
+ @param Str2 Pointer to the second string.
+
+ @param MaxLength The maximum number of characters to compare.  Both strings
+        must contain at least this many characters.
+
+ @return The number of characters in common.
+ */
+YORI_ALLOC_SIZE_T
+YoriShHistoryTrieCommonLength(
+    __in LPCTSTR Str1,
+    __in LPCTSTR Str2,
+    __in YORI_ALLOC_SIZE_T MaxLength
+    )
+{
+    YORI_ALLOC_SIZE_T Index;
+
+    for (Index = 0; Index < MaxLength; Index++) {
+        if (YoriLibUpcaseChar(Str1[Index]) != YoriLibUpcaseChar(Str2[Index])) {
+            break;
+        }
+    }
+
+    return Index;
+}
+
+/**
+ Find the child of a history suggestion trie node whose label starts with
+ the specified character.
+
+ @param Node Pointer to the parent node.
+
+ @param Char The character to find.
+
+ @return Pointer to the link that refers to the matching child, which is
+         either the parent's FirstChild or a sibling's NextSibling field.
+         If no child matches, the link that terminates the list of children
+         is returned, which refers to NULL.
+ */
+PYORI_SH_HISTORY_TRIE_NODE*
+YoriShHistoryTrieFindChild(
+    __in PYORI_SH_HISTORY_TRIE_NODE Node,
+    __in TCHAR Char
+    )
+{
+    PYORI_SH_HISTORY_TRIE_NODE *Link;
+    TCHAR UpcaseChar;
+
+    UpcaseChar = YoriLibUpcaseChar(Char);
+    Link = &Node->FirstChild;
+    while (*Link != NULL) {
+        if (YoriLibUpcaseChar((*Link)->Label.StartOfString[0]) == UpcaseChar) {
+            break;
+        }
+        Link = &(*Link)->NextSibling;
+    }
+
+    return Link;
+}
+
+/**
+ Allocate a new node for the history suggestion trie.  The node is not
+ linked into the trie.
+
+ @param Label Pointer to the characters that the node should describe.
+
+ @param LabelLength The number of characters that the node should describe.
+
+ @return Pointer to the new node, or NULL on allocation failure.
+ */
+PYORI_SH_HISTORY_TRIE_NODE
+YoriShHistoryTrieAllocateNode(
+    __in LPCTSTR Label,
+    __in YORI_ALLOC_SIZE_T LabelLength
+    )
+{
+    PYORI_SH_HISTORY_TRIE_NODE Node;
+
+    Node = YoriLibMalloc(sizeof(YORI_SH_HISTORY_TRIE_NODE) + LabelLength * sizeof(TCHAR));
+    if (Node == NULL) {
+        return NULL;
+    }
+
+    ZeroMemory(Node, sizeof(YORI_SH_HISTORY_TRIE_NODE));
+    YoriLibInitEmptyString(&Node->Label);
+    YoriLibInitEmptyString(&Node->CmdLine);
+    Node->Label.StartOfString = (LPTSTR)(Node + 1);
+    Node->Label.LengthInChars = LabelLength;
+    memcpy(Node->Label.StartOfString, Label, LabelLength * sizeof(TCHAR));
+    return Node;
+}
+
+/**
+ Recalculate the highest scoring terminal node for a node in the history
+ suggestion trie and each of its ancestors.  This is invoked after the score
+ of a node changes or a node is added or removed.
+
+ @param Node Pointer to the lowest node whose subtree has changed.
+ */
+VOID
+YoriShHistoryTrieUpdateBest(
+    __in PYORI_SH_HISTORY_TRIE_NODE Node
+    )
+{
+    PYORI_SH_HISTORY_TRIE_NODE Best;
+    PYORI_SH_HISTORY_TRIE_NODE Child;
+
+    while (Node != NULL) {
+        Best = NULL;
+        if (Node->Frequency > 0) {
+            Best = Node;
+        }
+
+        Child = Node->FirstChild;
+        while (Child != NULL) {
+            if (Child->Best != NULL &&
+                (Best == NULL || YoriShHistoryTrieScore(Child->Best) > YoriShHistoryTrieScore(Best))) {
+
+                Best = Child->Best;
+            }
+            Child = Child->NextSibling;
+        }
+
+        Node->Best = Best;
+        Node = Node->Parent;
+    }
+}
+
+/**
+ Add a history entry to the history suggestion trie.  If the command has
+ been seen before, its frequency is incremented and it is marked as the
+ most recently used; otherwise new nodes are added, splitting an existing
+ node if the command diverges partway through its label.  If memory cannot
+ be allocated the entry is left out of the trie, which only means it will
+ not be suggested.  The caller is expected to hold the history lock.
+
+ @param HistoryEntry Pointer to the history entry to add.
+ */
+VOID
+YoriShHistoryTrieInsert(
+    __in PYORI_SH_HISTORY_ENTRY HistoryEntry
+    )
+{
+    PYORI_SH_HISTORY_TRIE_NODE Node;
+    PYORI_SH_HISTORY_TRIE_NODE Child;
+    PYORI_SH_HISTORY_TRIE_NODE Split;
+    PYORI_SH_HISTORY_TRIE_NODE *Link;
+    YORI_STRING Remaining;
+    YORI_ALLOC_SIZE_T Common;
+
+    HistoryEntry->TrieNode = NULL;
+    if (HistoryEntry->CmdLine.LengthInChars == 0) {
+        return;
+    }
+
+    YoriLibInitEmptyString(&Remaining);
+    Remaining.StartOfString = HistoryEntry->CmdLine.StartOfString;
+    Remaining.LengthInChars = HistoryEntry->CmdLine.LengthInChars;
+
+    Node = &YoriShHistoryTrieRoot;
+    while (Remaining.LengthInChars > 0) {
+        Link = YoriShHistoryTrieFindChild(Node, Remaining.StartOfString[0]);
+        Child = *Link;
+
+        //
+        //  If no child starts with the next character, the rest of the
+        //  command becomes a new leaf.
+        //
+
+        if (Child == NULL) {
+            Child = YoriShHistoryTrieAllocateNode(Remaining.StartOfString, Remaining.LengthInChars);
+            if (Child == NULL) {
+                return;
+            }
+            Child->Parent = Node;
+            *Link = Child;
+            Node = Child;
+            break;
+        }
+
+        Common = Child->Label.LengthInChars;
+        if (Common > Remaining.LengthInChars) {
+            Common = Remaining.LengthInChars;
+        }
+        Common = YoriShHistoryTrieCommonLength(Child->Label.StartOfString, Remaining.StartOfString, Common);
+
+        //
+        //  If the command ends or diverges partway through the child's
+        //  label, insert a node for the common part above the child.
+        //
+
+        if (Common < Child->Label.LengthInChars) {
+            Split = YoriShHistoryTrieAllocateNode(Child->Label.StartOfString, Common);
+            if (Split == NULL) {
+                return;
+            }
+            Split->Parent = Node;
+            Split->NextSibling = Child->NextSibling;
+            Split->FirstChild = Child;
+            Split->Best = Child->Best;
+            *Link = Split;
+
+            Child->Parent = Split;
+            Child->NextSibling = NULL;
+            Child->Label.StartOfString = Child->Label.StartOfString + Common;
+            Child->Label.LengthInChars = Child->Label.LengthInChars - Common;
+            Child = Split;
+        }
+
+        Node = Child;
+        Remaining.StartOfString = Remaining.StartOfString + Common;
+        Remaining.LengthInChars = Remaining.LengthInChars - Common;
+    }
+
+    //
+    //  Remember the most recent form of the command, since commands that
+    //  differ only in case share a node.
+    //
+
+    YoriLibFreeStringContents(&Node->CmdLine);
+    YoriLibCloneString(&Node->CmdLine, &HistoryEntry->CmdLine);
+    Node->Frequency++;
+    YoriShHistoryTrieSequence++;
+    Node->LastUsed = YoriShHistoryTrieSequence;
+    HistoryEntry->TrieNode = Node;
+    YoriShHistoryTrieUpdateBest(Node);
+}
+
+/**
+ Remove a history entry from the history suggestion trie.  Once no history
+ entries end at a node and it has no children, the node is freed, along
+ with any ancestors that are left empty as a result.  The caller is
+ expected to hold the history lock.
+
+ @param HistoryEntry Pointer to the history entry to remove.
+ */
+VOID
+YoriShHistoryTrieRemove(
+    __in PYORI_SH_HISTORY_ENTRY HistoryEntry
+    )
+{
+    PYORI_SH_HISTORY_TRIE_NODE Node;
+    PYORI_SH_HISTORY_TRIE_NODE Parent;
+    PYORI_SH_HISTORY_TRIE_NODE *Link;
+
+    Node = HistoryEntry->TrieNode;
+    if (Node == NULL) {
+        return;
+    }
+    HistoryEntry->TrieNode = NULL;
+
+    ASSERT(Node->Frequency > 0);
+    Node->Frequency--;
+    if (Node->Frequency == 0) {
+        YoriLibFreeStringContents(&Node->CmdLine);
+
+        while (Node->Parent != NULL &&
+               Node->Frequency == 0 &&
+               Node->FirstChild == NULL) {
+
+            Parent = Node->Parent;
+            Link = YoriShHistoryTrieFindChild(Parent, Node->Label.StartOfString[0]);
+            ASSERT(*Link == Node);
+            *Link = Node->NextSibling;
+            YoriLibFree(Node);
+            Node = Parent;
+        }
+    }
+
+    YoriShHistoryTrieUpdateBest(Node);
+}
+
+/**
+ Add a history entry to the trigram index.  Each distinct trigram within the
+ command is linked to the entry once.  If the entry is too short to be
+ indexed it is left unindexed; if the index cannot be updated, the index is
+ marked incomplete so that searches no longer rely on it.
+
+ @param HistoryEntry Pointer to the history entry to index.
+ */
+VOID
+YoriShIndexHistoryEntry(
+    __in PYORI_SH_HISTORY_ENTRY HistoryEntry
+    )
+{
+    YORI_STRING Key;
+    PYORI_HASH_ENTRY HashEntry;
+    PYORI_SH_HISTORY_TRIGRAM Trigram;
+    PYORI_SH_HISTORY_TRIGRAM_LINK Link;
+    PYORI_LIST_ENTRY ListEntry;
+    YORI_ALLOC_SIZE_T MaximumLinks;
+    YORI_ALLOC_SIZE_T Index;
+
+    HistoryEntry->TrigramLinks = NULL;
+    HistoryEntry->TrigramLinkCount = 0;
+    if (HistoryEntry->CmdLine.LengthInChars < YORI_SH_HISTORY_TRIGRAM_LENGTH) {
+        return;
+    }
+
+    if (YoriShHistoryTrigramIndex == NULL) {
+        YoriShHistoryTrigramIndex = YoriLibAllocateHashTable(1000);
+        if (YoriShHistoryTrigramIndex == NULL) {
+            YoriShHistoryTrigramIndexIncomplete = TRUE;
+            return;
+        }
+    }
+
+    MaximumLinks = HistoryEntry->CmdLine.LengthInChars - YORI_SH_HISTORY_TRIGRAM_LENGTH + 1;
+    if (!YoriLibIsSizeAllocatable((YORI_MAX_UNSIGNED_T)MaximumLinks * sizeof(YORI_SH_HISTORY_TRIGRAM_LINK))) {
+        YoriShHistoryTrigramIndexIncomplete = TRUE;
+        return;
+    }
+
+    HistoryEntry->TrigramLinks = YoriLibMalloc(MaximumLinks * sizeof(YORI_SH_HISTORY_TRIGRAM_LINK));
+    if (HistoryEntry->TrigramLinks == NULL) {
+        YoriShHistoryTrigramIndexIncomplete = TRUE;
+        return;
+    }
+
+    //
+    //  The hash table is case insensitive, which matches the comparison
+    //  used when searching history.  Note the hash table copies the key
+    //  when inserting, so it's safe to point into the command here.
+    //
+
+    YoriLibInitEmptyString(&Key);
+    Key.LengthInChars = YORI_SH_HISTORY_TRIGRAM_LENGTH;
+
+    for (Index = 0; Index < MaximumLinks; Index++) {
+        Key.StartOfString = &HistoryEntry->CmdLine.StartOfString[Index];
+
+        HashEntry = YoriLibHashLookupByKey(YoriShHistoryTrigramIndex, &Key);
+        if (HashEntry != NULL) {
+            Trigram = HashEntry->Context;
+
+            //
+            //  This entry is always the newest on any list it has been
+            //  added to, so if the trigram occurred earlier in the command
+            //  it has already been linked.
+            //
+
+            ListEntry = YoriLibGetPreviousListEntry(&Trigram->LinkList, NULL);
+            Link = CONTAINING_RECORD(ListEntry, YORI_SH_HISTORY_TRIGRAM_LINK, ListEntry);
+            if (Link->HistoryEntry == HistoryEntry) {
+                continue;
+            }
+        } else {
+            Trigram = YoriLibMalloc(sizeof(YORI_SH_HISTORY_TRIGRAM));
+            if (Trigram == NULL) {
+                YoriShHistoryTrigramIndexIncomplete = TRUE;
+                continue;
+            }
+
+            YoriLibInitializeListHead(&Trigram->LinkList);
+            Trigram->LinkCount = 0;
+            YoriLibHashInsertByKey(YoriShHistoryTrigramIndex, &Key, Trigram, &Trigram->HashEntry);
+        }
+
+        Link = &HistoryEntry->TrigramLinks[HistoryEntry->TrigramLinkCount];
+        Link->Trigram = Trigram;
+        Link->HistoryEntry = HistoryEntry;
+        YoriLibAppendList(&Trigram->LinkList, &Link->ListEntry);
+        Trigram->LinkCount++;
+        HistoryEntry->TrigramLinkCount++;
+    }
+}
+
+/**
+ Remove a history entry from all history lists, including the trigram
+ index, and free it.  The caller is expected to hold the history lock.
+
+ @param HistoryEntry Pointer to the history entry to free.
+ */
+VOID
+YoriShFreeHistoryEntry(
+    __in PYORI_SH_HISTORY_ENTRY HistoryEntry
+    )
+{
+    PYORI_SH_HISTORY_TRIGRAM Trigram;
+    YORI_ALLOC_SIZE_T Index;
+
+    for (Index = 0; Index < HistoryEntry->TrigramLinkCount; Index++) {
+        Trigram = HistoryEntry->TrigramLinks[Index].Trigram;
+        YoriLibRemoveListItem(&HistoryEntry->TrigramLinks[Index].ListEntry);
+        Trigram->LinkCount--;
+        if (Trigram->LinkCount == 0) {
+            YoriLibHashRemoveByEntry(&Trigram->HashEntry);
+            YoriLibFree(Trigram);
+        }
+    }
+
+    if (HistoryEntry->TrigramLinks != NULL) {
+        YoriLibFree(HistoryEntry->TrigramLinks);
+    }
+
+    if (HistoryEntry->Persisted) {
+        YoriShHistoryFileNeedsRewrite = TRUE;
+    }
+
+    YoriShHistoryTrieRemove(HistoryEntry);
+    YoriLibRemoveListItem(&HistoryEntry->ListEntry);
+    YoriLibFreeStringContents(&HistoryEntry->CmdLine);
+    YoriLibFree(HistoryEntry);
+    YoriShCommandHistoryCount--;
+}
+
 /**
  Add an entered command into the command history buffer.
 
@@ -102,8 +573,11 @@ YoriShAddToHistory(
         }
 
         YoriLibCloneString(&NewHistoryEntry->CmdLine, NewCmd);
+        NewHistoryEntry->Persisted = FALSE;
 
         YoriLibAppendList(&YoriShGlobal.CommandHistory, &NewHistoryEntry->ListEntry);
+        YoriShIndexHistoryEntry(NewHistoryEntry);
+        YoriShHistoryTrieInsert(NewHistoryEntry);
         YoriShCommandHistoryCount++;
         while (YoriShCommandHistoryCount > YoriShCommandHistoryMax) {
             PYORI_LIST_ENTRY ListEntry;
@@ -111,10 +585,15 @@ YoriShAddToHistory(
 
             ListEntry = YoriLibGetNextListEntry(&YoriShGlobal.CommandHistory, NULL);
             OldHistoryEntry = CONTAINING_RECORD(ListEntry, YORI_SH_HISTORY_ENTRY, ListEntry);
-            YoriLibRemoveListItem(ListEntry);
-            YoriLibFreeStringContents(&OldHistoryEntry->CmdLine);
-            YoriLibFree(OldHistoryEntry);
-            YoriShCommandHistoryCount--;
+
+            //
+            //  Entries that age out of memory can remain in the file.  The
+            //  file is rewritten once it is sufficiently larger than the
+            //  history retained in memory.
+            //
+
+            OldHistoryEntry->Persisted = FALSE;
+            YoriShFreeHistoryEntry(OldHistoryEntry);
         }
         ReleaseMutex(YoriShHistoryLock);
     }
@@ -139,10 +618,7 @@ YoriShRemoveOneHistoryEntry(
     )
 {
     if (WaitForSingleObject(YoriShHistoryLock, 0) == WAIT_OBJECT_0) {
-        YoriLibRemoveListItem(&HistoryEntry->ListEntry);
-        YoriLibFreeStringContents(&HistoryEntry->CmdLine);
-        YoriLibFree(HistoryEntry);
-        YoriShCommandHistoryCount--;
+        YoriShFreeHistoryEntry(HistoryEntry);
         ReleaseMutex(YoriShHistoryLock);
     }
 }
@@ -161,15 +637,369 @@ YoriShClearAllHistory(VOID)
         while (ListEntry != NULL) {
             HistoryEntry = CONTAINING_RECORD(ListEntry, YORI_SH_HISTORY_ENTRY, ListEntry);
             ListEntry = YoriLibGetNextListEntry(&YoriShGlobal.CommandHistory, ListEntry);
-            YoriLibRemoveListItem(&HistoryEntry->ListEntry);
-            YoriLibFreeStringContents(&HistoryEntry->CmdLine);
-            YoriLibFree(HistoryEntry);
-            YoriShCommandHistoryCount--;
+            YoriShFreeHistoryEntry(HistoryEntry);
         }
+
+        if (YoriShHistoryTrigramIndex != NULL) {
+            YoriLibFreeEmptyHashTable(YoriShHistoryTrigramIndex);
+            YoriShHistoryTrigramIndex = NULL;
+        }
+        YoriShHistoryTrigramIndexIncomplete = FALSE;
         ReleaseMutex(YoriShHistoryLock);
     }
 }
 
+/**
+ Test whether a history entry matches a search string.
+
+ @param HistoryEntry Pointer to the history entry to test.
+
+ @param SearchString Pointer to the string to search for.
+
+ @param Substring If TRUE, the search string can occur anywhere within the
+        command.  If FALSE, the command must start with the search string.
+
+ @param MatchOffset On successful completion, updated to contain the offset
+        within the command where the search string was found.
+
+ @return TRUE to indicate the entry matches, FALSE if it does not.
+ */
+__success(return)
+BOOLEAN
+YoriShHistoryEntryMatches(
+    __in PYORI_SH_HISTORY_ENTRY HistoryEntry,
+    __in PCYORI_STRING SearchString,
+    __in BOOLEAN Substring,
+    __out PYORI_ALLOC_SIZE_T MatchOffset
+    )
+{
+    YORI_STRING Match;
+
+    if (!Substring) {
+        if (YoriLibCompareStringInsCnt(&HistoryEntry->CmdLine, SearchString, SearchString->LengthInChars) == 0) {
+            *MatchOffset = 0;
+            return TRUE;
+        }
+        return FALSE;
+    }
+
+    YoriLibInitEmptyString(&Match);
+    Match.StartOfString = SearchString->StartOfString;
+    Match.LengthInChars = SearchString->LengthInChars;
+    if (YoriLibFindFirstMatchSubstrIns(&HistoryEntry->CmdLine, 1, &Match, MatchOffset) != NULL) {
+        return TRUE;
+    }
+    return FALSE;
+}
+
+/**
+ Find the trigram within a search string that is contained in the fewest
+ history entries.  Every entry matching the search string must contain each
+ of its trigrams, so only entries linked to this trigram need to be checked.
+
+ @param SearchString Pointer to the string to search for.  This must contain
+        at least @ref YORI_SH_HISTORY_TRIGRAM_LENGTH characters.
+
+ @return Pointer to the trigram, or NULL if some trigram within the search
+         string is not contained in any history entry, meaning no entry can
+         match.
+ */
+PYORI_SH_HISTORY_TRIGRAM
+YoriShFindRarestHistoryTrigram(
+    __in PCYORI_STRING SearchString
+    )
+{
+    YORI_STRING Key;
+    PYORI_HASH_ENTRY HashEntry;
+    PYORI_SH_HISTORY_TRIGRAM Trigram;
+    PYORI_SH_HISTORY_TRIGRAM Rarest;
+    YORI_ALLOC_SIZE_T Index;
+
+    if (YoriShHistoryTrigramIndex == NULL) {
+        return NULL;
+    }
+
+    Rarest = NULL;
+    YoriLibInitEmptyString(&Key);
+    Key.LengthInChars = YORI_SH_HISTORY_TRIGRAM_LENGTH;
+    for (Index = 0; Index + YORI_SH_HISTORY_TRIGRAM_LENGTH <= SearchString->LengthInChars; Index++) {
+        Key.StartOfString = &SearchString->StartOfString[Index];
+        HashEntry = YoriLibHashLookupByKey(YoriShHistoryTrigramIndex, &Key);
+        if (HashEntry == NULL) {
+            return NULL;
+        }
+        Trigram = HashEntry->Context;
+        if (Rarest == NULL || Trigram->LinkCount < Rarest->LinkCount) {
+            Rarest = Trigram;
+        }
+    }
+
+    return Rarest;
+}
+
+/**
+ Find the next older history entry which matches a search string.  If the
+ trigram index is available and the search string is long enough, only
+ entries containing the rarest trigram of the search string are considered;
+ otherwise all history is scanned.
+
+ @param SearchString Pointer to the string to search for.  Comparison is
+        case insensitive.
+
+ @param Substring If TRUE, the search string can occur anywhere within the
+        command.  If FALSE, the command must start with the search string.
+
+ @param PreviousMatch Optionally points to a history entry to search before.
+        If NULL, the search starts from the most recent entry.
+
+ @param MatchOffset On successful completion, updated to contain the offset
+        within the command where the search string was found.
+
+ @return Pointer to the next older matching history entry, or NULL if no
+         further entries match.
+ */
+PYORI_SH_HISTORY_ENTRY
+YoriShFindPreviousHistoryEntry(
+    __in PCYORI_STRING SearchString,
+    __in BOOLEAN Substring,
+    __in_opt PYORI_SH_HISTORY_ENTRY PreviousMatch,
+    __out PYORI_ALLOC_SIZE_T MatchOffset
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PYORI_SH_HISTORY_ENTRY HistoryEntry;
+    PYORI_SH_HISTORY_TRIGRAM Trigram;
+    PYORI_SH_HISTORY_TRIGRAM_LINK Link;
+    YORI_ALLOC_SIZE_T Index;
+
+    if (YoriShGlobal.CommandHistory.Next == NULL) {
+        return NULL;
+    }
+
+    if (SearchString->LengthInChars >= YORI_SH_HISTORY_TRIGRAM_LENGTH &&
+        !YoriShHistoryTrigramIndexIncomplete) {
+
+        Trigram = YoriShFindRarestHistoryTrigram(SearchString);
+        if (Trigram == NULL) {
+            return NULL;
+        }
+
+        //
+        //  Continue from the previous match's position within this
+        //  trigram's list.  If the previous match doesn't contain the
+        //  trigram, it wasn't returned for this search string, so fall
+        //  through to scanning all history from that point.
+        //
+
+        ListEntry = NULL;
+        if (PreviousMatch != NULL) {
+            for (Index = 0; Index < PreviousMatch->TrigramLinkCount; Index++) {
+                if (PreviousMatch->TrigramLinks[Index].Trigram == Trigram) {
+                    ListEntry = &PreviousMatch->TrigramLinks[Index].ListEntry;
+                    break;
+                }
+            }
+        }
+
+        if (PreviousMatch == NULL || ListEntry != NULL) {
+            ListEntry = YoriLibGetPreviousListEntry(&Trigram->LinkList, ListEntry);
+            while (ListEntry != NULL) {
+                Link = CONTAINING_RECORD(ListEntry, YORI_SH_HISTORY_TRIGRAM_LINK, ListEntry);
+                if (YoriShHistoryEntryMatches(Link->HistoryEntry, SearchString, Substring, MatchOffset)) {
+                    return Link->HistoryEntry;
+                }
+                ListEntry = YoriLibGetPreviousListEntry(&Trigram->LinkList, ListEntry);
+            }
+
+            return NULL;
+        }
+    }
+
+    if (PreviousMatch != NULL) {
+        ListEntry = &PreviousMatch->ListEntry;
+    } else {
+        ListEntry = NULL;
+    }
+
+    ListEntry = YoriLibGetPreviousListEntry(&YoriShGlobal.CommandHistory, ListEntry);
+    while (ListEntry != NULL) {
+        HistoryEntry = CONTAINING_RECORD(ListEntry, YORI_SH_HISTORY_ENTRY, ListEntry);
+        if (YoriShHistoryEntryMatches(HistoryEntry, SearchString, Substring, MatchOffset)) {
+            return HistoryEntry;
+        }
+        ListEntry = YoriLibGetPreviousListEntry(&YoriShGlobal.CommandHistory, ListEntry);
+    }
+
+    return NULL;
+}
+
+/**
+ Find the next older history entry whose command starts with the specified
+ string.
+
+ @param SearchString Pointer to the string to search for.
+
+ @param CompareLength The number of characters of SearchString that must
+        match the start of a history entry.  Comparison is case insensitive.
+
+ @param PreviousMatch Optionally points to a previous match returned from
+        this function.  If NULL, the search starts from the most recent
+        entry.
+
+ @return Pointer to the next older matching history entry, or NULL if no
+         further entries match.
+ */
+PYORI_SH_HISTORY_ENTRY
+YoriShGetPreviousHistoryMatch(
+    __in PCYORI_STRING SearchString,
+    __in YORI_ALLOC_SIZE_T CompareLength,
+    __in_opt PYORI_SH_HISTORY_ENTRY PreviousMatch
+    )
+{
+    YORI_STRING Prefix;
+    YORI_ALLOC_SIZE_T MatchOffset;
+
+    YoriLibInitEmptyString(&Prefix);
+    Prefix.StartOfString = SearchString->StartOfString;
+    Prefix.LengthInChars = CompareLength;
+    if (Prefix.LengthInChars > SearchString->LengthInChars) {
+        Prefix.LengthInChars = SearchString->LengthInChars;
+    }
+
+    return YoriShFindPreviousHistoryEntry(&Prefix, FALSE, PreviousMatch, &MatchOffset);
+}
+
+/**
+ Find the next older history entry whose command contains the specified
+ string anywhere within it.  This is used for reverse incremental search.
+
+ @param SearchString Pointer to the string to search for.  Comparison is
+        case insensitive.
+
+ @param PreviousMatch Optionally points to a history entry to search before.
+        If NULL, the search starts from the most recent entry.
+
+ @param MatchOffset On successful completion, updated to contain the offset
+        within the command where the search string was found.
+
+ @return Pointer to the next older matching history entry, or NULL if no
+         further entries match.
+ */
+PYORI_SH_HISTORY_ENTRY
+YoriShGetPreviousHistorySubstringMatch(
+    __in PCYORI_STRING SearchString,
+    __in_opt PYORI_SH_HISTORY_ENTRY PreviousMatch,
+    __out PYORI_ALLOC_SIZE_T MatchOffset
+    )
+{
+    if (SearchString->LengthInChars == 0) {
+        return NULL;
+    }
+
+    return YoriShFindPreviousHistoryEntry(SearchString, TRUE, PreviousMatch, MatchOffset);
+}
+
+/**
+ Find the best previous command that starts with the specified string, for
+ use as an inline suggestion.  Commands are ranked by a combination of how
+ recently and how frequently they were used.  This locates the node for the
+ string in the history suggestion trie, which requires time proportional to
+ the length of the string rather than the amount of history, and returns
+ the best command that was recorded for that subtree as commands were added.
+
+ @param Prefix Pointer to the string that the command should start with.
+        Comparison is case insensitive.
+
+ @param Suggestion On successful completion, populated with the characters
+        of the command which follow Prefix.  The caller should free this
+        with @ref YoriLibFreeStringContents .
+
+ @return TRUE to indicate a suggestion was found, FALSE if it was not.
+ */
+__success(return)
+BOOL
+YoriShGetHistorySuggestion(
+    __in PCYORI_STRING Prefix,
+    __out PYORI_STRING Suggestion
+    )
+{
+    PYORI_SH_HISTORY_TRIE_NODE Node;
+    PYORI_SH_HISTORY_TRIE_NODE Child;
+    PYORI_SH_HISTORY_TRIE_NODE Best;
+    YORI_STRING Remaining;
+    YORI_ALLOC_SIZE_T Common;
+    BOOL Result;
+
+    YoriLibInitEmptyString(Suggestion);
+    if (Prefix->LengthInChars == 0) {
+        return FALSE;
+    }
+
+    if (WaitForSingleObject(YoriShHistoryLock, 0) != WAIT_OBJECT_0) {
+        return FALSE;
+    }
+
+    YoriLibInitEmptyString(&Remaining);
+    Remaining.StartOfString = Prefix->StartOfString;
+    Remaining.LengthInChars = Prefix->LengthInChars;
+
+    Node = &YoriShHistoryTrieRoot;
+    while (Remaining.LengthInChars > 0) {
+        Child = *YoriShHistoryTrieFindChild(Node, Remaining.StartOfString[0]);
+        if (Child == NULL) {
+            Node = NULL;
+            break;
+        }
+
+        Common = Child->Label.LengthInChars;
+        if (Common > Remaining.LengthInChars) {
+            Common = Remaining.LengthInChars;
+        }
+        if (YoriShHistoryTrieCommonLength(Child->Label.StartOfString, Remaining.StartOfString, Common) != Common) {
+            Node = NULL;
+            break;
+        }
+
+        Node = Child;
+        Remaining.StartOfString = Remaining.StartOfString + Common;
+        Remaining.LengthInChars = Remaining.LengthInChars - Common;
+    }
+
+    //
+    //  If the best command is the prefix itself there's nothing to suggest,
+    //  so use the best of the longer commands below it.
+    //
+
+    Best = NULL;
+    if (Node != NULL) {
+        Best = Node->Best;
+        if (Best != NULL && Best->CmdLine.LengthInChars <= Prefix->LengthInChars) {
+            Best = NULL;
+            Child = Node->FirstChild;
+            while (Child != NULL) {
+                if (Child->Best != NULL &&
+                    (Best == NULL || YoriShHistoryTrieScore(Child->Best) > YoriShHistoryTrieScore(Best))) {
+
+                    Best = Child->Best;
+                }
+                Child = Child->NextSibling;
+            }
+        }
+    }
+
+    Result = FALSE;
+    if (Best != NULL) {
+        ASSERT(Best->CmdLine.LengthInChars > Prefix->LengthInChars);
+        YoriLibCloneString(Suggestion, &Best->CmdLine);
+        Suggestion->StartOfString = Suggestion->StartOfString + Prefix->LengthInChars;
+        Suggestion->LengthInChars = Suggestion->LengthInChars - Prefix->LengthInChars;
+        Result = TRUE;
+    }
+
+    ReleaseMutex(YoriShHistoryLock);
+    return Result;
+}
+
 /**
  Configure the maximum amount of history to retain if the user has requested
  this behavior by setting YORIHISTSIZE.
@@ -324,6 +1154,25 @@ YoriShLoadHistoryFromFile(VOID)
             break;
         }
 
+        //
+        //  Every line in the file is counted, including lines that are
+        //  empty or have already aged out of memory, since these contribute
+        //  to the size of the file.  Entries that were loaded do not need
+        //  to be written again.
+        //
+
+        YoriShHistoryFileLineCount++;
+        if (LineString.LengthInChars > 0) {
+            PYORI_LIST_ENTRY ListEntry;
+            PYORI_SH_HISTORY_ENTRY HistoryEntry;
+
+            ListEntry = YoriLibGetPreviousListEntry(&YoriShGlobal.CommandHistory, NULL);
+            if (ListEntry != NULL) {
+                HistoryEntry = CONTAINING_RECORD(ListEntry, YORI_SH_HISTORY_ENTRY, ListEntry);
+                HistoryEntry->Persisted = TRUE;
+            }
+        }
+
         YoriLibFreeStringContents(&LineString);
         YoriLibInitEmptyString(&LineString);
     }
@@ -337,6 +1186,12 @@ YoriShLoadHistoryFromFile(VOID)
 /**
  Write the current command history buffer to a file, if the user has requested
  this behavior by configuring the YORIHISTFILE environment variable.
+ Normally this appends any entries added since the file was loaded or last
+ saved, which allows multiple processes to share a history file without
+ discarding each other's commands.  The file is rewritten from the history
+ retained in memory if entries that were previously saved have been removed,
+ or if the file has grown to more than twice the size of history retained
+ in memory.
 
  @return TRUE to indicate success, FALSE to indicate failure.
  */
@@ -350,6 +1205,7 @@ YoriShSaveHistoryToFile(VOID)
     HANDLE FileHandle;
     PYORI_LIST_ENTRY ListEntry;
     PYORI_SH_HISTORY_ENTRY HistoryEntry;
+    BOOLEAN Rewrite;
 
     FileNameLength = YoriShGetEnvironmentVariableWithoutSubstitution(_T("YORIHISTFILE"), NULL, 0, NULL);
     if (FileNameLength == 0) {
@@ -378,7 +1234,7 @@ YoriShSaveHistoryToFile(VOID)
                             GENERIC_WRITE,
                             FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
                             NULL,
-                            CREATE_ALWAYS,
+                            OPEN_ALWAYS,
                             FILE_ATTRIBUTE_NORMAL,
                             NULL);
 
@@ -398,14 +1254,47 @@ YoriShSaveHistoryToFile(VOID)
     //
 
     if (WaitForSingleObject(YoriShHistoryLock, 0) == WAIT_OBJECT_0) {
-        ListEntry = YoriLibGetNextListEntry(&YoriShGlobal.CommandHistory, NULL);
+
+        Rewrite = YoriShHistoryFileNeedsRewrite;
+        if (YoriShHistoryFileLineCount > 2 * YoriShCommandHistoryMax) {
+            Rewrite = TRUE;
+        }
+
+        //
+        //  If appending, find the oldest entry that hasn't been written.
+        //  Entries are written in order, so everything after the most
+        //  recent persisted entry is new.
+        //
+
+        ListEntry = NULL;
+        if (Rewrite) {
+            SetFilePointer(FileHandle, 0, NULL, FILE_BEGIN);
+            SetEndOfFile(FileHandle);
+            YoriShHistoryFileLineCount = 0;
+        } else {
+            SetFilePointer(FileHandle, 0, NULL, FILE_END);
+            ListEntry = YoriLibGetPreviousListEntry(&YoriShGlobal.CommandHistory, NULL);
+            while (ListEntry != NULL) {
+                HistoryEntry = CONTAINING_RECORD(ListEntry, YORI_SH_HISTORY_ENTRY, ListEntry);
+                if (HistoryEntry->Persisted) {
+                    break;
+                }
+                ListEntry = YoriLibGetPreviousListEntry(&YoriShGlobal.CommandHistory, ListEntry);
+            }
+        }
+
+        ListEntry = YoriLibGetNextListEntry(&YoriShGlobal.CommandHistory, ListEntry);
         while (ListEntry != NULL) {
             HistoryEntry = CONTAINING_RECORD(ListEntry, YORI_SH_HISTORY_ENTRY, ListEntry);
 
             YoriLibOutputToDevice(FileHandle, 0, _T("%y\n"), &HistoryEntry->CmdLine);
+            HistoryEntry->Persisted = TRUE;
+            YoriShHistoryFileLineCount++;
 
             ListEntry = YoriLibGetNextListEntry(&YoriShGlobal.CommandHistory, ListEntry);
         }
+
+        YoriShHistoryFileNeedsRewrite = FALSE;
         ReleaseMutex(YoriShHistoryLock);
     }
 
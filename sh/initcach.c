@@ -0,0 +1,1290 @@
+/**
+ * @file sh/initcach.c
+ *
+ * Yori shell cache of the effects of init scripts
+ *
+ * Copyright (c) 2026 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "yori.h"
+
+//
+//  If YORIINITCACHE is set, the shell records the environment variables and
+//  aliases that init scripts change, and on later starts applies these
+//  changes directly rather than executing the scripts.  The cache file
+//  consists of:
+//
+//      YORIINITCACHE 1
+//      S <last write time>,<size>,<script>     (for each script, in order)
+//      -
+//      R                                       (for each record)
+//      <lines describing the record>
+//      END
+//
+//  Each record contains lines describing the state that the scripts
+//  changed, as it was before they executed, and lines describing the
+//  resulting state.  A record is only applied if the current state of
+//  everything it changes matches the state it was recorded from, so a
+//  nested shell which already has these changes applied will not apply
+//  them again.  Several records are retained so that shells starting from
+//  different states do not continually replace each other's record.
+//
+//  The before state is described with:
+//
+//      B name=value                            (variable had this value)
+//      b name                                  (variable was not defined)
+//      C name=value                            (user alias had this value)
+//      K name=value                            (internal alias had this value)
+//      c name                                  (alias was not defined)
+//
+//  and the resulting state with:
+//
+//      E name=value                            (set variable)
+//      e name                                  (delete variable)
+//      A name=value                            (set user alias)
+//      I name=value                            (set internal alias)
+//      a name                                  (delete alias)
+//
+//  Scripts whose behavior depends on state they do not change, or that have
+//  effects other than environment variables and aliases, should not be used
+//  with the cache.  If the scripts register builtin commands or change the
+//  current directory, their effects are not recorded, and they will be
+//  executed each time.
+//
+
+/**
+ The version string at the start of the cache file.
+ */
+#define YORI_SH_INIT_CACHE_HEADER _T("YORIINITCACHE 1")
+
+/**
+ The maximum number of records to retain in the cache file.
+ */
+#define YORI_SH_INIT_CACHE_MAX_RECORDS (4)
+
+/**
+ A single line within a cache record.
+ */
+typedef struct _YORI_SH_INIT_CACHE_LINE {
+
+    /**
+     The links for this line within the record.  Paired with
+     @ref YORI_SH_INIT_CACHE_RECORD::LineList .
+     */
+    YORI_LIST_ENTRY ListEntry;
+
+    /**
+     The text of the line, without a line terminator.
+     */
+    YORI_STRING Line;
+} YORI_SH_INIT_CACHE_LINE, *PYORI_SH_INIT_CACHE_LINE;
+
+/**
+ A record describing the effects of init scripts from a particular state.
+ */
+typedef struct _YORI_SH_INIT_CACHE_RECORD {
+
+    /**
+     The links for this record within the cache.  Paired with
+     @ref YORI_SH_INIT_CACHE::RecordList .
+     */
+    YORI_LIST_ENTRY ListEntry;
+
+    /**
+     The list of lines in this record.  Paired with
+     @ref YORI_SH_INIT_CACHE_LINE::ListEntry .
+     */
+    YORI_LIST_ENTRY LineList;
+} YORI_SH_INIT_CACHE_RECORD, *PYORI_SH_INIT_CACHE_RECORD;
+
+/**
+ Prepare a cache context.  If the user has configured YORIINITCACHE, the
+ name of the cache file is resolved here; otherwise the cache is disabled
+ and the context just collects scripts to execute.
+
+ @param Cache Pointer to the cache context to initialize.
+ */
+VOID
+YoriShInitCacheInitialize(
+    __out PYORI_SH_INIT_CACHE Cache
+    )
+{
+    YORI_STRING UserCacheFileName;
+    YORI_ALLOC_SIZE_T EnvVarLength;
+
+    ZeroMemory(Cache, sizeof(YORI_SH_INIT_CACHE));
+    YoriLibInitializeListHead(&Cache->ScriptList);
+    YoriLibInitializeListHead(&Cache->RecordList);
+
+    EnvVarLength = YoriShGetEnvironmentVariableWithoutSubstitution(_T("YORIINITCACHE"), NULL, 0, NULL);
+    if (EnvVarLength == 0) {
+        return;
+    }
+
+    if (!YoriLibAllocateString(&UserCacheFileName, EnvVarLength)) {
+        return;
+    }
+
+    UserCacheFileName.LengthInChars = YoriShGetEnvironmentVariableWithoutSubstitution(_T("YORIINITCACHE"), UserCacheFileName.StartOfString, UserCacheFileName.LengthAllocated, NULL);
+    if (UserCacheFileName.LengthInChars == 0 || UserCacheFileName.LengthInChars >= UserCacheFileName.LengthAllocated) {
+        YoriLibFreeStringContents(&UserCacheFileName);
+        return;
+    }
+
+    if (!YoriLibUserStringToSingleFilePath(&UserCacheFileName, TRUE, &Cache->CacheFileName)) {
+        YoriLibInitEmptyString(&Cache->CacheFileName);
+    }
+
+    YoriLibFreeStringContents(&UserCacheFileName);
+}
+
+/**
+ Add a script to the set of init scripts to execute.
+
+ @param Cache Pointer to the cache context.
+
+ @param FileName Pointer to the fully qualified name of the script.
+
+ @param FindData Pointer to information about the script returned from
+        directory enumeration.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+YoriShInitCacheAddScript(
+    __inout PYORI_SH_INIT_CACHE Cache,
+    __in PYORI_STRING FileName,
+    __in PWIN32_FIND_DATA FindData
+    )
+{
+    PYORI_SH_INIT_SCRIPT Script;
+
+    Script = YoriLibReferencedMalloc(sizeof(YORI_SH_INIT_SCRIPT) + (FileName->LengthInChars + 1) * sizeof(TCHAR));
+    if (Script == NULL) {
+        return FALSE;
+    }
+
+    YoriLibInitEmptyString(&Script->FileName);
+    Script->FileName.StartOfString = (LPTSTR)(Script + 1);
+    memcpy(Script->FileName.StartOfString, FileName->StartOfString, FileName->LengthInChars * sizeof(TCHAR));
+    Script->FileName.StartOfString[FileName->LengthInChars] = '\0';
+    Script->FileName.LengthInChars = FileName->LengthInChars;
+    Script->FileName.LengthAllocated = FileName->LengthInChars + 1;
+    YoriLibReference(Script);
+    Script->FileName.MemoryToFree = Script;
+
+    memcpy(&Script->FindData, FindData, sizeof(WIN32_FIND_DATA));
+
+    YoriLibAppendList(&Cache->ScriptList, &Script->ListEntry);
+    return TRUE;
+}
+
+/**
+ Free a cache record and all of its lines.
+
+ @param Record Pointer to the record to free.  This should already have been
+        removed from any list.
+ */
+VOID
+YoriShInitCacheFreeRecord(
+    __in PYORI_SH_INIT_CACHE_RECORD Record
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PYORI_SH_INIT_CACHE_LINE Line;
+
+    ListEntry = YoriLibGetNextListEntry(&Record->LineList, NULL);
+    while (ListEntry != NULL) {
+        Line = CONTAINING_RECORD(ListEntry, YORI_SH_INIT_CACHE_LINE, ListEntry);
+        ListEntry = YoriLibGetNextListEntry(&Record->LineList, ListEntry);
+        YoriLibRemoveListItem(&Line->ListEntry);
+        YoriLibFreeStringContents(&Line->Line);
+        YoriLibFree(Line);
+    }
+
+    YoriLibFree(Record);
+}
+
+/**
+ Allocate a new, empty cache record.
+
+ @return Pointer to the record, or NULL on allocation failure.
+ */
+PYORI_SH_INIT_CACHE_RECORD
+YoriShInitCacheAllocateRecord(VOID)
+{
+    PYORI_SH_INIT_CACHE_RECORD Record;
+
+    Record = YoriLibMalloc(sizeof(YORI_SH_INIT_CACHE_RECORD));
+    if (Record == NULL) {
+        return NULL;
+    }
+
+    YoriLibInitializeListHead(&Record->LineList);
+    return Record;
+}
+
+/**
+ Add a line to a cache record, taking ownership of the string.
+
+ @param Record Pointer to the record to add the line to.
+
+ @param LineString Pointer to the string to add.  On success, the record
+        owns this string and the caller's copy is reinitialized.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+YoriShInitCacheAddLineString(
+    __in PYORI_SH_INIT_CACHE_RECORD Record,
+    __inout PYORI_STRING LineString
+    )
+{
+    PYORI_SH_INIT_CACHE_LINE Line;
+
+    Line = YoriLibMalloc(sizeof(YORI_SH_INIT_CACHE_LINE));
+    if (Line == NULL) {
+        return FALSE;
+    }
+
+    memcpy(&Line->Line, LineString, sizeof(YORI_STRING));
+    YoriLibInitEmptyString(LineString);
+    YoriLibAppendList(&Record->LineList, &Line->ListEntry);
+    return TRUE;
+}
+
+/**
+ Add a line describing a name and optional value to a cache record.
+
+ @param Record Pointer to the record to add the line to.
+
+ @param Prefix Pointer to the string indicating the type of the line.
+
+ @param Name Pointer to the name of the variable or alias.
+
+ @param Value Optionally points to the value of the variable or alias.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+YoriShInitCacheAddLine(
+    __in PYORI_SH_INIT_CACHE_RECORD Record,
+    __in LPCTSTR Prefix,
+    __in PYORI_STRING Name,
+    __in_opt PYORI_STRING Value
+    )
+{
+    YORI_STRING LineString;
+
+    YoriLibInitEmptyString(&LineString);
+    if (Value != NULL) {
+        YoriLibYPrintf(&LineString, _T("%s %y=%y"), Prefix, Name, Value);
+    } else {
+        YoriLibYPrintf(&LineString, _T("%s %y"), Prefix, Name);
+    }
+
+    if (LineString.LengthInChars == 0) {
+        return FALSE;
+    }
+
+    if (!YoriShInitCacheAddLineString(Record, &LineString)) {
+        YoriLibFreeStringContents(&LineString);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ Split a name=value string into its name and value.  Note that the name
+ may begin with an equals sign, as occurs for environment variables that
+ record the current directory on each drive.
+
+ @param Entry Pointer to the NULL terminated entry to split.
+
+ @param Name On successful completion, updated to point to the name within
+        the entry.
+
+ @param Value On successful completion, updated to point to the value within
+        the entry.
+
+ @return TRUE to indicate the entry was split, FALSE if it does not contain
+         a value.
+ */
+__success(return)
+BOOLEAN
+YoriShInitCacheSplitEntry(
+    __in LPTSTR Entry,
+    __out PYORI_STRING Name,
+    __out PYORI_STRING Value
+    )
+{
+    YORI_STRING EntryString;
+    LPTSTR Equals;
+
+    YoriLibConstantString(&EntryString, Entry);
+    if (EntryString.LengthInChars < 2) {
+        return FALSE;
+    }
+
+    EntryString.StartOfString++;
+    EntryString.LengthInChars--;
+    Equals = YoriLibFindLeftMostCharacter(&EntryString, '=');
+    if (Equals == NULL) {
+        return FALSE;
+    }
+
+    YoriLibInitEmptyString(Name);
+    Name->StartOfString = Entry;
+    Name->LengthInChars = (YORI_ALLOC_SIZE_T)(Equals - Entry);
+    Name->LengthAllocated = Name->LengthInChars + 1;
+
+    YoriLibInitEmptyString(Value);
+    Value->StartOfString = Equals + 1;
+    Value->LengthInChars = (YORI_ALLOC_SIZE_T)_tcslen(Value->StartOfString);
+    Value->LengthAllocated = Value->LengthInChars + 1;
+    return TRUE;
+}
+
+/**
+ Find an entry within a set of NULL terminated name=value strings, which is
+ itself terminated by an empty string.
+
+ @param Strings Pointer to the set of strings to search.
+
+ @param Name Pointer to the name to find.  Comparison is case insensitive.
+
+ @param Value On successful completion, updated to point to the value of the
+        entry within Strings.
+
+ @return TRUE to indicate the entry was found, FALSE if it was not.
+ */
+__success(return)
+BOOLEAN
+YoriShInitCacheFindEntry(
+    __in PYORI_STRING Strings,
+    __in PYORI_STRING Name,
+    __out PYORI_STRING Value
+    )
+{
+    LPTSTR ThisEntry;
+    YORI_STRING EntryName;
+
+    if (Strings->StartOfString == NULL) {
+        return FALSE;
+    }
+
+    ThisEntry = Strings->StartOfString;
+    while (*ThisEntry != '\0') {
+        if (YoriShInitCacheSplitEntry(ThisEntry, &EntryName, Value) &&
+            YoriLibCompareStringIns(&EntryName, Name) == 0) {
+
+            return TRUE;
+        }
+
+        ThisEntry += _tcslen(ThisEntry);
+        ThisEntry++;
+    }
+
+    return FALSE;
+}
+
+/**
+ Find the state of an alias, which may be defined as a user alias, an
+ internal alias, or not at all.
+
+ @param UserAliases Pointer to the set of user aliases.
+
+ @param InternalAliases Pointer to the set of internal aliases.
+
+ @param Name Pointer to the name of the alias to find.
+
+ @param Value On successful completion, updated to point to the value of
+        the alias.
+
+ @param Internal On successful completion, set to TRUE if the alias is an
+        internal alias, FALSE if it is a user alias.
+
+ @return TRUE to indicate the alias is defined, FALSE if it is not.
+ */
+__success(return)
+BOOLEAN
+YoriShInitCacheFindAlias(
+    __in PYORI_STRING UserAliases,
+    __in PYORI_STRING InternalAliases,
+    __in PYORI_STRING Name,
+    __out PYORI_STRING Value,
+    __out PBOOLEAN Internal
+    )
+{
+    if (YoriShInitCacheFindEntry(UserAliases, Name, Value)) {
+        *Internal = FALSE;
+        return TRUE;
+    }
+
+    if (YoriShInitCacheFindEntry(InternalAliases, Name, Value)) {
+        *Internal = TRUE;
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+/**
+ Count the builtin commands that are currently registered, and find the
+ most recently registered one.  This is used to detect whether init scripts
+ have registered or unregistered any builtins, which cannot be replayed.
+
+ @param Newest On completion, updated to point to the most recently
+        registered builtin, or NULL if none are registered.
+
+ @return The number of registered builtins.
+ */
+DWORD
+YoriShInitCacheCountBuiltins(
+    __out PYORI_LIBSH_BUILTIN_CALLBACK *Newest
+    )
+{
+    PYORI_LIBSH_BUILTIN_CALLBACK Callback;
+    DWORD Count;
+
+    Count = 0;
+    *Newest = NULL;
+    Callback = YoriLibShGetPreviousBuiltinCallback(NULL);
+    while (Callback != NULL) {
+        Count++;
+        *Newest = Callback;
+        Callback = YoriLibShGetPreviousBuiltinCallback(Callback);
+    }
+
+    return Count;
+}
+
+/**
+ Build the line that describes a script in the cache file header.
+
+ @param Script Pointer to the script.
+
+ @param LineString On successful completion, populated with the line.  The
+        caller should free this with @ref YoriLibFreeStringContents .
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+YoriShInitCacheBuildScriptLine(
+    __in PYORI_SH_INIT_SCRIPT Script,
+    __out PYORI_STRING LineString
+    )
+{
+    YoriLibInitEmptyString(LineString);
+    YoriLibYPrintf(LineString,
+                   _T("S %08x%08x,%08x%08x,%y"),
+                   Script->FindData.ftLastWriteTime.dwHighDateTime,
+                   Script->FindData.ftLastWriteTime.dwLowDateTime,
+                   Script->FindData.nFileSizeHigh,
+                   Script->FindData.nFileSizeLow,
+                   &Script->FileName);
+
+    if (LineString->LengthInChars == 0) {
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/**
+ Load records from the cache file.  Records are only loaded if the file
+ was generated from the current set of scripts, and each record is only
+ loaded if it is complete.
+
+ @param Cache Pointer to the cache context.
+ */
+VOID
+YoriShInitCacheLoad(
+    __inout PYORI_SH_INIT_CACHE Cache
+    )
+{
+    HANDLE FileHandle;
+    PVOID LineContext;
+    YORI_STRING LineString;
+    YORI_STRING ExpectedLine;
+    PYORI_LIST_ENTRY ListEntry;
+    PYORI_SH_INIT_SCRIPT Script;
+    PYORI_SH_INIT_CACHE_RECORD Record;
+    BOOLEAN HeaderMatches;
+
+    FileHandle = CreateFile(Cache->CacheFileName.StartOfString,
+                            GENERIC_READ,
+                            FILE_SHARE_READ | FILE_SHARE_DELETE,
+                            NULL,
+                            OPEN_EXISTING,
+                            FILE_ATTRIBUTE_NORMAL,
+                            NULL);
+
+    if (FileHandle == INVALID_HANDLE_VALUE) {
+        return;
+    }
+
+    LineContext = NULL;
+    YoriLibInitEmptyString(&LineString);
+    HeaderMatches = FALSE;
+
+    //
+    //  Check the version and that each script is the same, in the same
+    //  order, with the same timestamp and size.
+    //
+
+    if (YoriLibReadLineToString(&LineString, &LineContext, FileHandle) &&
+        YoriLibCompareStringLit(&LineString, YORI_SH_INIT_CACHE_HEADER) == 0) {
+
+        HeaderMatches = TRUE;
+        ListEntry = YoriLibGetNextListEntry(&Cache->ScriptList, NULL);
+        while (ListEntry != NULL) {
+            Script = CONTAINING_RECORD(ListEntry, YORI_SH_INIT_SCRIPT, ListEntry);
+            if (!YoriShInitCacheBuildScriptLine(Script, &ExpectedLine)) {
+                HeaderMatches = FALSE;
+                break;
+            }
+
+            if (!YoriLibReadLineToString(&LineString, &LineContext, FileHandle) ||
+                YoriLibCompareString(&LineString, &ExpectedLine) != 0) {
+
+                YoriLibFreeStringContents(&ExpectedLine);
+                HeaderMatches = FALSE;
+                break;
+            }
+
+            YoriLibFreeStringContents(&ExpectedLine);
+            ListEntry = YoriLibGetNextListEntry(&Cache->ScriptList, ListEntry);
+        }
+
+        if (HeaderMatches) {
+            if (!YoriLibReadLineToString(&LineString, &LineContext, FileHandle) ||
+                YoriLibCompareStringLit(&LineString, _T("-")) != 0) {
+
+                HeaderMatches = FALSE;
+            }
+        }
+    }
+
+    //
+    //  Load each complete record.  A record that is not terminated, because
+    //  the file was truncated, is discarded.
+    //
+
+    Record = NULL;
+    while (HeaderMatches &&
+           Cache->RecordCount < YORI_SH_INIT_CACHE_MAX_RECORDS &&
+           YoriLibReadLineToString(&LineString, &LineContext, FileHandle)) {
+
+        if (Record == NULL) {
+            if (YoriLibCompareStringLit(&LineString, _T("R")) != 0) {
+                break;
+            }
+            Record = YoriShInitCacheAllocateRecord();
+            if (Record == NULL) {
+                break;
+            }
+        } else if (YoriLibCompareStringLit(&LineString, _T("END")) == 0) {
+            YoriLibAppendList(&Cache->RecordList, &Record->ListEntry);
+            Cache->RecordCount++;
+            Record = NULL;
+        } else {
+
+            //
+            //  Every line within a record has a single character type
+            //  followed by a space.  Lines are NULL terminated so that
+            //  they can be passed directly when they are applied.
+            //
+
+            if (LineString.LengthInChars < 3 ||
+                LineString.StartOfString[1] != ' ' ||
+                LineString.LengthAllocated <= LineString.LengthInChars) {
+
+                break;
+            }
+
+            LineString.StartOfString[LineString.LengthInChars] = '\0';
+
+            if (!YoriShInitCacheAddLineString(Record, &LineString)) {
+                break;
+            }
+        }
+
+        YoriLibFreeStringContents(&LineString);
+    }
+
+    if (Record != NULL) {
+        YoriShInitCacheFreeRecord(Record);
+    }
+
+    YoriLibLineReadCloseOrCache(LineContext);
+    YoriLibFreeStringContents(&LineString);
+    CloseHandle(FileHandle);
+}
+
+/**
+ Check whether a record applies to the current state, meaning that every
+ variable and alias it changes currently has the state it had when the
+ record was generated.
+
+ @param Record Pointer to the record to check.
+
+ @param Environment Pointer to the current environment.
+
+ @param UserAliases Pointer to the current set of user aliases.
+
+ @param InternalAliases Pointer to the current set of internal aliases.
+
+ @return TRUE if the record can be applied, FALSE if it cannot.
+ */
+BOOLEAN
+YoriShInitCacheDoesRecordApply(
+    __in PYORI_SH_INIT_CACHE_RECORD Record,
+    __in PYORI_STRING Environment,
+    __in PYORI_STRING UserAliases,
+    __in PYORI_STRING InternalAliases
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PYORI_SH_INIT_CACHE_LINE Line;
+    YORI_STRING Entry;
+    YORI_STRING Name;
+    YORI_STRING ExpectedValue;
+    YORI_STRING CurrentValue;
+    BOOLEAN Found;
+    BOOLEAN Internal;
+    TCHAR Type;
+
+    ListEntry = YoriLibGetNextListEntry(&Record->LineList, NULL);
+    while (ListEntry != NULL) {
+        Line = CONTAINING_RECORD(ListEntry, YORI_SH_INIT_CACHE_LINE, ListEntry);
+        ListEntry = YoriLibGetNextListEntry(&Record->LineList, ListEntry);
+
+        Type = Line->Line.StartOfString[0];
+
+        YoriLibInitEmptyString(&Entry);
+        Entry.StartOfString = &Line->Line.StartOfString[2];
+        Entry.LengthInChars = Line->Line.LengthInChars - 2;
+        Entry.LengthAllocated = Line->Line.LengthAllocated - 2;
+
+        switch(Type) {
+            case 'B':
+                if (!YoriShInitCacheSplitEntry(Entry.StartOfString, &Name, &ExpectedValue) ||
+                    !YoriShInitCacheFindEntry(Environment, &Name, &CurrentValue) ||
+                    YoriLibCompareString(&CurrentValue, &ExpectedValue) != 0) {
+
+                    return FALSE;
+                }
+                break;
+            case 'b':
+                if (YoriShInitCacheFindEntry(Environment, &Entry, &CurrentValue)) {
+                    return FALSE;
+                }
+                break;
+            case 'C':
+            case 'K':
+                if (!YoriShInitCacheSplitEntry(Entry.StartOfString, &Name, &ExpectedValue)) {
+                    return FALSE;
+                }
+                Found = YoriShInitCacheFindAlias(UserAliases, InternalAliases, &Name, &CurrentValue, &Internal);
+                if (!Found ||
+                    Internal != (BOOLEAN)(Type == 'K') ||
+                    YoriLibCompareString(&CurrentValue, &ExpectedValue) != 0) {
+
+                    return FALSE;
+                }
+                break;
+            case 'c':
+                if (YoriShInitCacheFindAlias(UserAliases, InternalAliases, &Entry, &CurrentValue, &Internal)) {
+                    return FALSE;
+                }
+                break;
+            case 'E':
+            case 'e':
+            case 'A':
+            case 'I':
+            case 'a':
+                break;
+            default:
+                return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+/**
+ Apply the resulting state described by a record.
+
+ @param Record Pointer to the record to apply.
+ */
+VOID
+YoriShInitCacheApplyRecord(
+    __in PYORI_SH_INIT_CACHE_RECORD Record
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PYORI_SH_INIT_CACHE_LINE Line;
+    YORI_STRING Entry;
+    YORI_STRING Name;
+    YORI_STRING Value;
+
+    ListEntry = YoriLibGetNextListEntry(&Record->LineList, NULL);
+    while (ListEntry != NULL) {
+        Line = CONTAINING_RECORD(ListEntry, YORI_SH_INIT_CACHE_LINE, ListEntry);
+        ListEntry = YoriLibGetNextListEntry(&Record->LineList, ListEntry);
+
+        YoriLibInitEmptyString(&Entry);
+        Entry.StartOfString = &Line->Line.StartOfString[2];
+        Entry.LengthInChars = Line->Line.LengthInChars - 2;
+        Entry.LengthAllocated = Line->Line.LengthAllocated - 2;
+
+        switch(Line->Line.StartOfString[0]) {
+            case 'E':
+                if (YoriShInitCacheSplitEntry(Entry.StartOfString, &Name, &Value)) {
+
+                    //
+                    //  The name is followed by an equals sign, so write a
+                    //  NULL terminator there temporarily.  The value is
+                    //  already NULL terminated by the line.
+                    //
+
+                    Name.StartOfString[Name.LengthInChars] = '\0';
+                    YoriShSetEnvironmentVariable(&Name, &Value);
+                    Name.StartOfString[Name.LengthInChars] = '=';
+                }
+                break;
+            case 'e':
+                YoriShSetEnvironmentVariable(&Entry, NULL);
+                break;
+            case 'A':
+            case 'I':
+                if (YoriShInitCacheSplitEntry(Entry.StartOfString, &Name, &Value)) {
+                    YoriShAddAlias(&Name, &Value, (Line->Line.StartOfString[0] == 'I'));
+                }
+                break;
+            case 'a':
+                YoriShDeleteAlias(&Entry);
+                break;
+        }
+    }
+}
+
+/**
+ Attempt to apply the cached effects of the init scripts rather than
+ executing them.
+
+ @param Cache Pointer to the cache context.
+
+ @return TRUE to indicate the cached effects were applied, so the scripts
+         do not need to be executed.  FALSE if the scripts should be
+         executed.
+ */
+__success(return)
+BOOLEAN
+YoriShInitCacheReplay(
+    __inout PYORI_SH_INIT_CACHE Cache
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PYORI_SH_INIT_CACHE_RECORD Record;
+    YORI_STRING Environment;
+    YORI_STRING UserAliases;
+    YORI_STRING InternalAliases;
+    BOOLEAN Applied;
+
+    if (Cache->CacheFileName.LengthInChars == 0) {
+        return FALSE;
+    }
+
+    YoriShInitCacheLoad(Cache);
+    if (Cache->RecordCount == 0) {
+        return FALSE;
+    }
+
+    YoriLibInitEmptyString(&UserAliases);
+    YoriLibInitEmptyString(&InternalAliases);
+    if (!YoriLibGetEnvironmentStrings(&Environment)) {
+        return FALSE;
+    }
+
+    if (!YoriShGetAliasStrings(YORI_SH_GET_ALIAS_STRINGS_INCLUDE_USER, &UserAliases) ||
+        !YoriShGetAliasStrings(YORI_SH_GET_ALIAS_STRINGS_INCLUDE_INTERNAL, &InternalAliases)) {
+
+        YoriLibFreeStringContents(&UserAliases);
+        YoriLibFreeStringContents(&InternalAliases);
+        YoriLibFreeStringContents(&Environment);
+        return FALSE;
+    }
+
+    Applied = FALSE;
+    ListEntry = YoriLibGetNextListEntry(&Cache->RecordList, NULL);
+    while (ListEntry != NULL) {
+        Record = CONTAINING_RECORD(ListEntry, YORI_SH_INIT_CACHE_RECORD, ListEntry);
+        if (YoriShInitCacheDoesRecordApply(Record, &Environment, &UserAliases, &InternalAliases)) {
+            YoriShInitCacheApplyRecord(Record);
+            Applied = TRUE;
+            break;
+        }
+        ListEntry = YoriLibGetNextListEntry(&Cache->RecordList, ListEntry);
+    }
+
+    YoriLibFreeStringContents(&UserAliases);
+    YoriLibFreeStringContents(&InternalAliases);
+    YoriLibFreeStringContents(&Environment);
+    return Applied;
+}
+
+/**
+ Capture the state of the shell before executing init scripts, so that
+ their effects can be recorded after they complete.
+
+ @param Cache Pointer to the cache context.
+ */
+VOID
+YoriShInitCacheCaptureState(
+    __inout PYORI_SH_INIT_CACHE Cache
+    )
+{
+    if (Cache->CacheFileName.LengthInChars == 0) {
+        return;
+    }
+
+    if (!YoriLibGetEnvironmentStrings(&Cache->EnvironmentBefore)) {
+        return;
+    }
+
+    if (!YoriShGetAliasStrings(YORI_SH_GET_ALIAS_STRINGS_INCLUDE_USER, &Cache->UserAliasesBefore) ||
+        !YoriShGetAliasStrings(YORI_SH_GET_ALIAS_STRINGS_INCLUDE_INTERNAL, &Cache->InternalAliasesBefore) ||
+        !YoriLibGetCurrentDirectory(&Cache->CurrentDirectoryBefore)) {
+
+        return;
+    }
+
+    Cache->BuiltinCountBefore = YoriShInitCacheCountBuiltins(&Cache->NewestBuiltinBefore);
+    Cache->StateCaptured = TRUE;
+}
+
+/**
+ Add lines to a record describing every environment variable that differs
+ between two environment blocks.
+
+ @param Record Pointer to the record to populate.
+
+ @param Before Pointer to the environment before init scripts executed.
+
+ @param After Pointer to the environment after init scripts executed.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+YoriShInitCacheRecordEnvironmentChanges(
+    __in PYORI_SH_INIT_CACHE_RECORD Record,
+    __in PYORI_STRING Before,
+    __in PYORI_STRING After
+    )
+{
+    LPTSTR ThisEntry;
+    YORI_STRING Name;
+    YORI_STRING Value;
+    YORI_STRING OtherValue;
+
+    //
+    //  Variables beginning with an equals sign describe the current
+    //  directory on each drive, which is not something that is replayed.
+    //
+
+    ThisEntry = After->StartOfString;
+    while (*ThisEntry != '\0') {
+        if (ThisEntry[0] != '=' &&
+            YoriShInitCacheSplitEntry(ThisEntry, &Name, &Value)) {
+
+            if (!YoriShInitCacheFindEntry(Before, &Name, &OtherValue)) {
+                if (!YoriShInitCacheAddLine(Record, _T("b"), &Name, NULL) ||
+                    !YoriShInitCacheAddLine(Record, _T("E"), &Name, &Value)) {
+                    return FALSE;
+                }
+            } else if (YoriLibCompareString(&Value, &OtherValue) != 0) {
+                if (!YoriShInitCacheAddLine(Record, _T("B"), &Name, &OtherValue) ||
+                    !YoriShInitCacheAddLine(Record, _T("E"), &Name, &Value)) {
+                    return FALSE;
+                }
+            }
+        }
+
+        ThisEntry += _tcslen(ThisEntry);
+        ThisEntry++;
+    }
+
+    ThisEntry = Before->StartOfString;
+    while (*ThisEntry != '\0') {
+        if (ThisEntry[0] != '=' &&
+            YoriShInitCacheSplitEntry(ThisEntry, &Name, &Value) &&
+            !YoriShInitCacheFindEntry(After, &Name, &OtherValue)) {
+
+            if (!YoriShInitCacheAddLine(Record, _T("B"), &Name, &Value) ||
+                !YoriShInitCacheAddLine(Record, _T("e"), &Name, NULL)) {
+                return FALSE;
+            }
+        }
+
+        ThisEntry += _tcslen(ThisEntry);
+        ThisEntry++;
+    }
+
+    return TRUE;
+}
+
+/**
+ Add lines to a record describing the prior state of an alias.
+
+ @param Record Pointer to the record to populate.
+
+ @param Name Pointer to the name of the alias.
+
+ @param UserAliasesBefore Pointer to the user aliases before init scripts
+        executed.
+
+ @param InternalAliasesBefore Pointer to the internal aliases before init
+        scripts executed.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+YoriShInitCacheRecordAliasBefore(
+    __in PYORI_SH_INIT_CACHE_RECORD Record,
+    __in PYORI_STRING Name,
+    __in PYORI_STRING UserAliasesBefore,
+    __in PYORI_STRING InternalAliasesBefore
+    )
+{
+    YORI_STRING Value;
+    BOOLEAN Internal;
+
+    if (!YoriShInitCacheFindAlias(UserAliasesBefore, InternalAliasesBefore, Name, &Value, &Internal)) {
+        return YoriShInitCacheAddLine(Record, _T("c"), Name, NULL);
+    }
+
+    if (Internal) {
+        return YoriShInitCacheAddLine(Record, _T("K"), Name, &Value);
+    }
+
+    return YoriShInitCacheAddLine(Record, _T("C"), Name, &Value);
+}
+
+/**
+ Add lines to a record describing every alias that differs between the
+ state captured before init scripts executed and the current state.
+
+ @param Record Pointer to the record to populate.
+
+ @param Cache Pointer to the cache context, which contains the aliases
+        before init scripts executed.
+
+ @param UserAliasesAfter Pointer to the user aliases after init scripts
+        executed.
+
+ @param InternalAliasesAfter Pointer to the internal aliases after init
+        scripts executed.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+YoriShInitCacheRecordAliasChanges(
+    __in PYORI_SH_INIT_CACHE_RECORD Record,
+    __in PYORI_SH_INIT_CACHE Cache,
+    __in PYORI_STRING UserAliasesAfter,
+    __in PYORI_STRING InternalAliasesAfter
+    )
+{
+    PYORI_STRING AliasSets[2];
+    LPCTSTR SetPrefixes[2];
+    DWORD SetIndex;
+    LPTSTR ThisEntry;
+    YORI_STRING Name;
+    YORI_STRING Value;
+    YORI_STRING OtherValue;
+    BOOLEAN OtherInternal;
+
+    //
+    //  Any alias defined after the scripts execute which either wasn't
+    //  defined before, or was defined differently, needs to be recorded.
+    //
+
+    AliasSets[0] = UserAliasesAfter;
+    SetPrefixes[0] = _T("A");
+    AliasSets[1] = InternalAliasesAfter;
+    SetPrefixes[1] = _T("I");
+
+    for (SetIndex = 0; SetIndex < sizeof(AliasSets)/sizeof(AliasSets[0]); SetIndex++) {
+        ThisEntry = AliasSets[SetIndex]->StartOfString;
+        while (*ThisEntry != '\0') {
+            if (YoriShInitCacheSplitEntry(ThisEntry, &Name, &Value)) {
+                if (!YoriShInitCacheFindAlias(&Cache->UserAliasesBefore, &Cache->InternalAliasesBefore, &Name, &OtherValue, &OtherInternal) ||
+                    OtherInternal != (BOOLEAN)(SetIndex == 1) ||
+                    YoriLibCompareString(&Value, &OtherValue) != 0) {
+
+                    if (!YoriShInitCacheRecordAliasBefore(Record, &Name, &Cache->UserAliasesBefore, &Cache->InternalAliasesBefore) ||
+                        !YoriShInitCacheAddLine(Record, SetPrefixes[SetIndex], &Name, &Value)) {
+                        return FALSE;
+                    }
+                }
+            }
+
+            ThisEntry += _tcslen(ThisEntry);
+            ThisEntry++;
+        }
+    }
+
+    //
+    //  Any alias defined before that is no longer defined needs to be
+    //  recorded as deleted.
+    //
+
+    AliasSets[0] = &Cache->UserAliasesBefore;
+    AliasSets[1] = &Cache->InternalAliasesBefore;
+
+    for (SetIndex = 0; SetIndex < sizeof(AliasSets)/sizeof(AliasSets[0]); SetIndex++) {
+        ThisEntry = AliasSets[SetIndex]->StartOfString;
+        while (*ThisEntry != '\0') {
+            if (YoriShInitCacheSplitEntry(ThisEntry, &Name, &Value) &&
+                !YoriShInitCacheFindAlias(UserAliasesAfter, InternalAliasesAfter, &Name, &OtherValue, &OtherInternal)) {
+
+                if (!YoriShInitCacheRecordAliasBefore(Record, &Name, &Cache->UserAliasesBefore, &Cache->InternalAliasesBefore) ||
+                    !YoriShInitCacheAddLine(Record, _T("a"), &Name, NULL)) {
+                    return FALSE;
+                }
+            }
+
+            ThisEntry += _tcslen(ThisEntry);
+            ThisEntry++;
+        }
+    }
+
+    return TRUE;
+}
+
+/**
+ Write the cache file, consisting of a header describing the current
+ scripts followed by the specified record and any previously loaded
+ records.
+
+ @param Cache Pointer to the cache context.
+
+ @param NewRecord Pointer to the record describing the scripts that have
+        just been executed.
+ */
+VOID
+YoriShInitCacheWrite(
+    __in PYORI_SH_INIT_CACHE Cache,
+    __in PYORI_SH_INIT_CACHE_RECORD NewRecord
+    )
+{
+    HANDLE FileHandle;
+    PYORI_LIST_ENTRY ListEntry;
+    PYORI_LIST_ENTRY LineEntry;
+    PYORI_SH_INIT_SCRIPT Script;
+    PYORI_SH_INIT_CACHE_RECORD Record;
+    PYORI_SH_INIT_CACHE_LINE Line;
+    YORI_STRING LineString;
+    DWORD RecordsWritten;
+
+    //
+    //  Don't allow other processes to write concurrently.  If another
+    //  process is writing, it is recording the same thing, so this process
+    //  can skip writing.  Because each record is terminated, a process
+    //  reading while this one is writing will ignore an incomplete record.
+    //
+
+    FileHandle = CreateFile(Cache->CacheFileName.StartOfString,
+                            GENERIC_WRITE,
+                            FILE_SHARE_READ | FILE_SHARE_DELETE,
+                            NULL,
+                            CREATE_ALWAYS,
+                            FILE_ATTRIBUTE_NORMAL,
+                            NULL);
+
+    if (FileHandle == INVALID_HANDLE_VALUE) {
+        return;
+    }
+
+    YoriLibOutputToDevice(FileHandle, 0, _T("%s\n"), YORI_SH_INIT_CACHE_HEADER);
+    ListEntry = YoriLibGetNextListEntry(&Cache->ScriptList, NULL);
+    while (ListEntry != NULL) {
+        Script = CONTAINING_RECORD(ListEntry, YORI_SH_INIT_SCRIPT, ListEntry);
+        if (YoriShInitCacheBuildScriptLine(Script, &LineString)) {
+            YoriLibOutputToDevice(FileHandle, 0, _T("%y\n"), &LineString);
+            YoriLibFreeStringContents(&LineString);
+        }
+        ListEntry = YoriLibGetNextListEntry(&Cache->ScriptList, ListEntry);
+    }
+    YoriLibOutputToDevice(FileHandle, 0, _T("-\n"));
+
+    //
+    //  Write the new record first, so it is found first next time, followed
+    //  by previous records until the limit is reached.
+    //
+
+    Record = NewRecord;
+    ListEntry = NULL;
+    RecordsWritten = 0;
+    while (Record != NULL && RecordsWritten < YORI_SH_INIT_CACHE_MAX_RECORDS) {
+        YoriLibOutputToDevice(FileHandle, 0, _T("R\n"));
+        LineEntry = YoriLibGetNextListEntry(&Record->LineList, NULL);
+        while (LineEntry != NULL) {
+            Line = CONTAINING_RECORD(LineEntry, YORI_SH_INIT_CACHE_LINE, ListEntry);
+            YoriLibOutputToDevice(FileHandle, 0, _T("%y\n"), &Line->Line);
+            LineEntry = YoriLibGetNextListEntry(&Record->LineList, LineEntry);
+        }
+        YoriLibOutputToDevice(FileHandle, 0, _T("END\n"));
+        RecordsWritten++;
+
+        ListEntry = YoriLibGetNextListEntry(&Cache->RecordList, ListEntry);
+        if (ListEntry == NULL) {
+            break;
+        }
+        Record = CONTAINING_RECORD(ListEntry, YORI_SH_INIT_CACHE_RECORD, ListEntry);
+    }
+
+    CloseHandle(FileHandle);
+}
+
+/**
+ After init scripts have executed, record their effects in the cache file
+ so that later shells can apply them without executing the scripts.
+
+ @param Cache Pointer to the cache context.
+ */
+VOID
+YoriShInitCacheSave(
+    __inout PYORI_SH_INIT_CACHE Cache
+    )
+{
+    YORI_STRING EnvironmentAfter;
+    YORI_STRING UserAliasesAfter;
+    YORI_STRING InternalAliasesAfter;
+    YORI_STRING CurrentDirectoryAfter;
+    PYORI_SH_INIT_CACHE_RECORD Record;
+    PYORI_LIBSH_BUILTIN_CALLBACK NewestBuiltin;
+    DWORD BuiltinCount;
+
+    if (!Cache->StateCaptured) {
+        return;
+    }
+
+    //
+    //  If the scripts registered or removed builtins, or changed the current
+    //  directory, their effects cannot be replayed.
+    //
+
+    BuiltinCount = YoriShInitCacheCountBuiltins(&NewestBuiltin);
+    if (BuiltinCount != Cache->BuiltinCountBefore ||
+        NewestBuiltin != Cache->NewestBuiltinBefore) {
+
+        return;
+    }
+
+    if (!YoriLibGetCurrentDirectory(&CurrentDirectoryAfter)) {
+        return;
+    }
+
+    if (YoriLibCompareString(&CurrentDirectoryAfter, &Cache->CurrentDirectoryBefore) != 0) {
+        YoriLibFreeStringContents(&CurrentDirectoryAfter);
+        return;
+    }
+    YoriLibFreeStringContents(&CurrentDirectoryAfter);
+
+    YoriLibInitEmptyString(&UserAliasesAfter);
+    YoriLibInitEmptyString(&InternalAliasesAfter);
+    if (!YoriLibGetEnvironmentStrings(&EnvironmentAfter)) {
+        return;
+    }
+
+    Record = NULL;
+    if (YoriShGetAliasStrings(YORI_SH_GET_ALIAS_STRINGS_INCLUDE_USER, &UserAliasesAfter) &&
+        YoriShGetAliasStrings(YORI_SH_GET_ALIAS_STRINGS_INCLUDE_INTERNAL, &InternalAliasesAfter)) {
+
+        Record = YoriShInitCacheAllocateRecord();
+    }
+
+    if (Record != NULL) {
+        if (YoriShInitCacheRecordEnvironmentChanges(Record, &Cache->EnvironmentBefore, &EnvironmentAfter) &&
+            YoriShInitCacheRecordAliasChanges(Record, Cache, &UserAliasesAfter, &InternalAliasesAfter)) {
+
+            YoriShInitCacheWrite(Cache, Record);
+        }
+
+        YoriShInitCacheFreeRecord(Record);
+    }
+
+    YoriLibFreeStringContents(&UserAliasesAfter);
+    YoriLibFreeStringContents(&InternalAliasesAfter);
+    YoriLibFreeStringContents(&EnvironmentAfter);
+}
+
+/**
+ Free all state associated with a cache context.
+
+ @param Cache Pointer to the cache context.
+ */
+VOID
+YoriShInitCacheCleanup(
+    __inout PYORI_SH_INIT_CACHE Cache
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PYORI_SH_INIT_SCRIPT Script;
+    PYORI_SH_INIT_CACHE_RECORD Record;
+
+    ListEntry = YoriLibGetNextListEntry(&Cache->ScriptList, NULL);
+    while (ListEntry != NULL) {
+        Script = CONTAINING_RECORD(ListEntry, YORI_SH_INIT_SCRIPT, ListEntry);
+        ListEntry = YoriLibGetNextListEntry(&Cache->ScriptList, ListEntry);
+        YoriLibRemoveListItem(&Script->ListEntry);
+        YoriLibFreeStringContents(&Script->FileName);
+        YoriLibDereference(Script);
+    }
+
+    ListEntry = YoriLibGetNextListEntry(&Cache->RecordList, NULL);
+    while (ListEntry != NULL) {
+        Record = CONTAINING_RECORD(ListEntry, YORI_SH_INIT_CACHE_RECORD, ListEntry);
+        ListEntry = YoriLibGetNextListEntry(&Cache->RecordList, ListEntry);
+        YoriLibRemoveListItem(&Record->ListEntry);
+        YoriShInitCacheFreeRecord(Record);
+    }
+    Cache->RecordCount = 0;
+
+    YoriLibFreeStringContents(&Cache->EnvironmentBefore);
+    YoriLibFreeStringContents(&Cache->UserAliasesBefore);
+    YoriLibFreeStringContents(&Cache->InternalAliasesBefore);
+    YoriLibFreeStringContents(&Cache->CurrentDirectoryBefore);
+    YoriLibFreeStringContents(&Cache->CacheFileName);
+    Cache->StateCaptured = FALSE;
+}
+
+// vim:sw=4:ts=4:et:
@@ -751,6 +751,8 @@ YoriShTerminateInput(
     Buffer->SuggestionPopulated = FALSE;
     YoriLibFreeStringContents(&Buffer->SuggestionString);
     YoriLibFreeStringContents(&Buffer->SearchString);
+    YoriLibFreeStringContents(&Buffer->PreSearchString);
+    YoriShFreeParseCache(&Buffer->ParseCache);
     SetConsoleCtrlHandler(YoriShAppCloseCtrlHandler, FALSE);
     YoriShDisplayAfterKeyPress(Buffer);
     YoriShPostKeyPress(Buffer);
@@ -819,6 +821,7 @@ YoriShClearInput(
     Buffer->SuggestionPopulated = FALSE;
     YoriLibFreeStringContents(&Buffer->SuggestionString);
     YoriLibFreeStringContents(&Buffer->SearchString);
+    YoriLibFreeStringContents(&Buffer->PreSearchString);
     YoriShClearTabCompletionMatches(Buffer);
     if (Buffer->String.LengthInChars > 0) {
         YoriShExtendDirtyRangeToCover(Buffer, 0, Buffer->String.LengthInChars);
@@ -826,12 +829,59 @@ YoriShClearInput(
     Buffer->String.LengthInChars = 0;
     Buffer->CurrentOffset = 0;
     Buffer->SearchMode = FALSE;
+    Buffer->HistorySearchMode = FALSE;
     YoriShClearInputSelections(Buffer);
 }
 
+/**
+ Based on the search text entered so far, find the next older command in
+ history containing the text, replace the input buffer with it, and set the
+ current offset to the end of the text within it.  If no command matches,
+ the input buffer is left unchanged.
+
+ @param Buffer Pointer to the input buffer to update.
+
+ @param PreviousMatch Optionally points to the history entry to search
+        before.  If NULL, the search starts from the most recent command.
+ */
+VOID
+YoriShUpdateInputWithHistorySearchResult(
+    __inout PYORI_SH_INPUT_BUFFER Buffer,
+    __in_opt PYORI_LIST_ENTRY PreviousMatch
+    )
+{
+    PYORI_SH_HISTORY_ENTRY HistoryEntry;
+    YORI_ALLOC_SIZE_T MatchOffset;
+
+    HistoryEntry = NULL;
+    if (PreviousMatch != NULL) {
+        HistoryEntry = CONTAINING_RECORD(PreviousMatch, YORI_SH_HISTORY_ENTRY, ListEntry);
+    }
+
+    HistoryEntry = YoriShGetPreviousHistorySubstringMatch(&Buffer->SearchString, HistoryEntry, &MatchOffset);
+    if (HistoryEntry == NULL) {
+        return;
+    }
+
+    if (Buffer->SuggestionString.LengthInChars > 0) {
+        Buffer->SuggestionDirty = TRUE;
+    }
+    Buffer->SuggestionPopulated = FALSE;
+    YoriLibFreeStringContents(&Buffer->SuggestionString);
+    YoriShClearTabCompletionMatches(Buffer);
+
+    if (!YoriShReplaceInputBufferTrackDirtyRange(Buffer, &HistoryEntry->CmdLine)) {
+        return;
+    }
+
+    Buffer->HistoryEntryToUse = &HistoryEntry->ListEntry;
+    Buffer->CurrentOffset = MatchOffset + Buffer->SearchString.LengthInChars;
+}
+
 /**
  Based on the search text entered so far, find the first match within the
- main string and set the current offset to it.
+ main string and set the current offset to it.  When searching history, the
+ search restarts from the most recent command.
 
  @param Buffer Pointer to the input buffer to update.
  */
@@ -842,6 +892,11 @@ YoriShUpdateSelectionWithSearchResult(
 {
     YORI_ALLOC_SIZE_T StringOffsetOfMatch;
 
+    if (Buffer->HistorySearchMode) {
+        YoriShUpdateInputWithHistorySearchResult(Buffer, NULL);
+        return;
+    }
+
     //
     //  MSFIX Would like to do something with selection for this, but that
     //  implies having a selection that follows text around lines rather
@@ -855,6 +910,124 @@ YoriShUpdateSelectionWithSearchResult(
     }
 }
 
+/**
+ Begin searching, so that subsequent keystrokes are added to the search
+ string rather than the input buffer.
+
+ @param Buffer Pointer to the input buffer.
+
+ @param SearchHistory If TRUE, the search is for older commands containing
+        the search string, which replace the input buffer as they are found.
+        If FALSE, the search is within the current input buffer.
+
+ @return TRUE to indicate searching has started, FALSE on allocation
+         failure.
+ */
+__success(return)
+BOOLEAN
+YoriShStartSearch(
+    __inout PYORI_SH_INPUT_BUFFER Buffer,
+    __in BOOLEAN SearchHistory
+    )
+{
+    YoriLibFreeStringContents(&Buffer->SearchString);
+    YoriLibFreeStringContents(&Buffer->PreSearchString);
+
+    //
+    //  If the search is cancelled, history search needs to put back the
+    //  input buffer as it was before any commands were found.
+    //
+
+    if (SearchHistory &&
+        !YoriLibCopyString(&Buffer->PreSearchString, &Buffer->String)) {
+
+        return FALSE;
+    }
+
+    Buffer->SearchMode = TRUE;
+    Buffer->HistorySearchMode = SearchHistory;
+    Buffer->PreSearchOffset = Buffer->CurrentOffset;
+    return TRUE;
+}
+
+/**
+ Stop searching, so that subsequent keystrokes are added to the input
+ buffer.
+
+ @param Buffer Pointer to the input buffer.
+
+ @param Cancel If TRUE, the input buffer and current offset are restored to
+        their state before the search started.  If FALSE, the result of the
+        search is retained.
+ */
+VOID
+YoriShEndSearch(
+    __inout PYORI_SH_INPUT_BUFFER Buffer,
+    __in BOOLEAN Cancel
+    )
+{
+    if (Cancel) {
+        if (Buffer->HistorySearchMode &&
+            YoriShReplaceInputBufferTrackDirtyRange(Buffer, &Buffer->PreSearchString)) {
+
+            Buffer->HistoryEntryToUse = NULL;
+        }
+        Buffer->CurrentOffset = Buffer->PreSearchOffset;
+        if (Buffer->CurrentOffset > Buffer->String.LengthInChars) {
+            Buffer->CurrentOffset = Buffer->String.LengthInChars;
+        }
+    }
+
+    Buffer->SearchMode = FALSE;
+    Buffer->HistorySearchMode = FALSE;
+    YoriLibFreeStringContents(&Buffer->SearchString);
+    YoriLibFreeStringContents(&Buffer->PreSearchString);
+}
+
+
+/**
+ Prepare to display output while the user is entering input.  This is
+ patterned after YoriShTerminateInput but leaves the input string and any
+ tab completion matches unaltered.
+
+ @param Buffer Pointer to the input buffer.
+ */
+VOID
+YoriShPrepareInputForOutput(
+    __inout PYORI_SH_INPUT_BUFFER Buffer
+    )
+{
+    if (Buffer->SuggestionString.LengthInChars > 0) {
+        Buffer->SuggestionDirty = TRUE;
+    }
+    Buffer->SuggestionPopulated = FALSE;
+    YoriLibFreeStringContents(&Buffer->SuggestionString);
+    YoriShDisplayAfterKeyPress(Buffer);
+    Buffer->String.StartOfString[Buffer->String.LengthInChars] = '\0';
+    YoriShMoveCursor(Buffer, Buffer->String.LengthInChars - Buffer->CurrentOffset);
+    YoriShConfigureMouseForPrograms(Buffer->ConsoleInputHandle);
+}
+
+/**
+ Save off the currently entered string to be used for the next input
+ operation, and reset the currently entered string.  This is used after
+ output has been displayed while the user is entering input, and expects
+ the current input operation to be terminated.
+
+ @param Buffer Pointer to the input buffer.
+ */
+VOID
+YoriShCarryInputToNextPrompt(
+    __inout PYORI_SH_INPUT_BUFFER Buffer
+    )
+{
+    YoriLibFreeStringContents(&YoriShGlobal.NextCommand);
+    memcpy(&YoriShGlobal.NextCommand, &Buffer->String, sizeof(YORI_STRING));
+    YoriLibInitEmptyString(&Buffer->String);
+    YoriShGlobal.NextCommandOffset = Buffer->CurrentOffset;
+    Buffer->CurrentOffset = 0;
+    Buffer->PreviousCurrentOffset = 0;
+}
 
 /**
  Display all of the tab completion matches.  Note this routine needs to
@@ -882,20 +1055,11 @@ YoriShCompletionListAllMatches(
     TCHAR FormatString[16];
 
     //
-    //  Perform a minimal termination of the current input line.  This is
-    //  patterned after YoriShTerminateInput but needs to preserve any tab
-    //  completion matches and leave the input string unaltered (for now.)
+    //  Perform a minimal termination of the current input line, preserving
+    //  any tab completion matches and the input string (for now.)
     //
 
-    if (Buffer->SuggestionString.LengthInChars > 0) {
-        Buffer->SuggestionDirty = TRUE;
-    }
-    Buffer->SuggestionPopulated = FALSE;
-    YoriLibFreeStringContents(&Buffer->SuggestionString);
-    YoriShDisplayAfterKeyPress(Buffer);
-    Buffer->String.StartOfString[Buffer->String.LengthInChars] = '\0';
-    YoriShMoveCursor(Buffer, Buffer->String.LengthInChars - Buffer->CurrentOffset);
-    YoriShConfigureMouseForPrograms(Buffer->ConsoleInputHandle);
+    YoriShPrepareInputForOutput(Buffer);
 
     //
     //  Find the longest suggestion and query the width of the console to
@@ -953,17 +1117,32 @@ YoriShCompletionListAllMatches(
         EntryIndex++;
     }
 
-    //
-    //  Save off the currently entered string to be used for the next input
-    //  operation, and reset the currently entered string.
-    //
+    YoriShCarryInputToNextPrompt(Buffer);
+}
 
-    YoriLibFreeStringContents(&YoriShGlobal.NextCommand);
-    memcpy(&YoriShGlobal.NextCommand, &Buffer->String, sizeof(YORI_STRING));
-    YoriLibInitEmptyString(&Buffer->String);
-    YoriShGlobal.NextCommandOffset = Buffer->CurrentOffset;
-    Buffer->CurrentOffset = 0;
-    Buffer->PreviousCurrentOffset = 0;
+/**
+ The number of allocation call sites to display when the user requests an
+ allocation profile.
+ */
+#define YORI_SH_ALLOCATION_PROFILE_ENTRIES (25)
+
+/**
+ Display the most frequent allocation call sites when allocation profiling
+ is active in a debug build.  Like @ref YoriShCompletionListAllMatches, this
+ expects the current input operation to be terminated, and the current user
+ text is reentered on the next prompt.
+
+ @param Buffer Pointer to the input buffer.
+ */
+VOID
+YoriShDisplayAllocationProfile(
+    __inout PYORI_SH_INPUT_BUFFER Buffer
+    )
+{
+    YoriShPrepareInputForOutput(Buffer);
+    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("\n"));
+    YoriLibDisplayAllocationProfile(YORI_SH_ALLOCATION_PROFILE_ENTRIES);
+    YoriShCarryInputToNextPrompt(Buffer);
 }
 
 
@@ -1344,7 +1523,7 @@ YoriShMoveCursorToPriorArgument(
     YORI_ALLOC_SIZE_T BeginCurrentArg = 0;
     YORI_ALLOC_SIZE_T EndCurrentArg = 0;
 
-    if (!YoriLibShParseCmdlineToCmdContext(&Buffer->String, Buffer->CurrentOffset, &CmdContext)) {
+    if (!YoriShParseCmdlineWithCache(&Buffer->ParseCache, &Buffer->String, Buffer->CurrentOffset, &CmdContext)) {
         return;
     }
 
@@ -1419,7 +1598,7 @@ YoriShMoveCursorToNextArgument(
     YORI_ALLOC_SIZE_T EndCurrentArg;
     BOOL MoveToEnd = FALSE;
 
-    if (!YoriLibShParseCmdlineToCmdContext(&Buffer->String, Buffer->CurrentOffset, &CmdContext)) {
+    if (!YoriShParseCmdlineWithCache(&Buffer->ParseCache, &Buffer->String, Buffer->CurrentOffset, &CmdContext)) {
         return;
     }
 
@@ -1474,7 +1653,7 @@ YoriShDeleteArgument(
     YORI_ALLOC_SIZE_T EndCurrentArg;
     PVOID MemoryToFree;
 
-    if (!YoriLibShParseCmdlineToCmdContext(&Buffer->String, Buffer->CurrentOffset, &CmdContext)) {
+    if (!YoriShParseCmdlineWithCache(&Buffer->ParseCache, &Buffer->String, Buffer->CurrentOffset, &CmdContext)) {
         return;
     }
 
@@ -1863,6 +2042,195 @@ YoriShClearScreen(
     YoriShExtendDirtyRangeToCover(Buffer, 0, Buffer->String.LengthInChars);
 }
 
+/**
+ Redisplay the prompt in place because the value of an asynchronous prompt
+ segment has changed, and redraw the input buffer following it.
+
+ @param Buffer Pointer to the input buffer.
+ */
+VOID
+YoriShRedisplayPromptInPlace(
+    __inout PYORI_SH_INPUT_BUFFER Buffer
+    )
+{
+    HANDLE ConsoleHandle;
+    CONSOLE_SCREEN_BUFFER_INFO ScreenInfo;
+    COORD PromptStart;
+    COORD PromptEnd;
+    COORD InputStart;
+    DWORD StartCell;
+    DWORD EndCell;
+    DWORD CharsWritten;
+    SHORT RowsScrolled;
+
+    if (!YoriShGetPromptPosition(&PromptStart, &PromptEnd)) {
+        return;
+    }
+
+    //
+    //  Clear any selection so its highlight doesn't survive the redraw.
+    //
+
+    if (YoriShClearInputSelections(Buffer)) {
+        YoriShDisplayAfterKeyPress(Buffer);
+    }
+
+    ConsoleHandle = Buffer->ConsoleOutputHandle;
+    if (!GetConsoleScreenBufferInfo(ConsoleHandle, &ScreenInfo)) {
+        return;
+    }
+
+    if (!YoriShDetermineCellLocationIfMovedCacheResult(Buffer, &ScreenInfo, -1 * (INT)Buffer->PreviousCurrentOffset, &InputStart)) {
+        return;
+    }
+
+    //
+    //  If the input has caused the console to scroll since the prompt was
+    //  displayed, the prompt has moved up by the same number of rows.  If
+    //  the input doesn't start where the prompt ended, or the prompt has
+    //  scrolled out of the buffer, it can't be redrawn in place.
+    //
+
+    if (InputStart.X != PromptEnd.X || InputStart.Y > PromptEnd.Y) {
+        return;
+    }
+
+    RowsScrolled = (SHORT)(PromptEnd.Y - InputStart.Y);
+    if (PromptStart.Y < RowsScrolled) {
+        return;
+    }
+    PromptStart.Y = (SHORT)(PromptStart.Y - RowsScrolled);
+
+    //
+    //  Erase the prompt and the input, display the new prompt, and redraw
+    //  the input after it.
+    //
+
+    StartCell = (DWORD)PromptStart.Y * ScreenInfo.dwSize.X + PromptStart.X;
+    EndCell = (DWORD)InputStart.Y * ScreenInfo.dwSize.X + InputStart.X + Buffer->PreviousCharsDisplayed;
+
+    FillConsoleOutputCharacter(ConsoleHandle, ' ', EndCell - StartCell, PromptStart, &CharsWritten);
+    FillConsoleOutputAttribute(ConsoleHandle, ScreenInfo.wAttributes, EndCell - StartCell, PromptStart, &CharsWritten);
+    SetConsoleCursorPosition(ConsoleHandle, PromptStart);
+
+    YoriShPreCommand(FALSE);
+    YoriShRedisplayPrompt();
+    YoriShPreCommand(TRUE);
+
+    Buffer->PreviousCurrentOffset = 0;
+    Buffer->PreviousCharsDisplayed = 0;
+    if (Buffer->String.LengthInChars > 0) {
+        YoriShExtendDirtyRangeToCover(Buffer, 0, Buffer->String.LengthInChars);
+    }
+    if (Buffer->SuggestionString.LengthInChars > 0) {
+        Buffer->SuggestionDirty = TRUE;
+    }
+    YoriShDisplayAfterKeyPress(Buffer);
+}
+
+/**
+ Report background jobs which have completed while the user is entering
+ input.  The reports are displayed on the lines following the input, and
+ the prompt and input buffer are redisplayed after them.
+
+ @param Buffer Pointer to the input buffer.
+ */
+VOID
+YoriShReportCompletedJobsAtPrompt(
+    __inout PYORI_SH_INPUT_BUFFER Buffer
+    )
+{
+    if (!YoriShJobsCompletedUnreported()) {
+        return;
+    }
+
+    if (YoriShClearInputSelections(Buffer)) {
+        YoriShDisplayAfterKeyPress(Buffer);
+    }
+
+    //
+    //  Move past everything displayed, including any suggestion, so the
+    //  reports don't overwrite the input.
+    //
+
+    YoriShMoveCursor(Buffer, (INT)Buffer->PreviousCharsDisplayed - (INT)Buffer->PreviousCurrentOffset);
+    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("\n"));
+    YoriShReportCompletedJobs();
+
+    YoriShPreCommand(FALSE);
+    YoriShDisplayPrompt();
+    YoriShPreCommand(TRUE);
+
+    Buffer->PreviousCurrentOffset = 0;
+    Buffer->PreviousCharsDisplayed = 0;
+    if (Buffer->String.LengthInChars > 0) {
+        YoriShExtendDirtyRangeToCover(Buffer, 0, Buffer->String.LengthInChars);
+    }
+    if (Buffer->SuggestionString.LengthInChars > 0) {
+        Buffer->SuggestionDirty = TRUE;
+    }
+    YoriShDisplayAfterKeyPress(Buffer);
+}
+
+/**
+ Wait for input to arrive or for a timeout to elapse.  While waiting, if an
+ asynchronous prompt segment completes with a new value, the prompt is
+ redisplayed and the wait continues.  If a background job completes, it is
+ reported immediately and the wait continues.
+
+ @param Buffer Pointer to the input buffer.
+
+ @param InputHandle Handle to the console input.
+
+ @param Timeout The maximum time to wait, in milliseconds.
+
+ @return WAIT_OBJECT_0 if input has arrived, WAIT_TIMEOUT if the timeout
+         elapsed, or another value on failure.
+ */
+DWORD
+YoriShWaitForInputOrPromptUpdate(
+    __inout PYORI_SH_INPUT_BUFFER Buffer,
+    __in HANDLE InputHandle,
+    __in DWORD Timeout
+    )
+{
+    HANDLE WaitHandles[3];
+    HANDLE PromptSegmentEvent;
+    HANDLE JobCompletionEvent;
+    DWORD HandleCount;
+    DWORD Err;
+
+    WaitHandles[0] = InputHandle;
+    while (TRUE) {
+        HandleCount = 1;
+        PromptSegmentEvent = YoriShGetPromptSegmentEvent();
+        if (PromptSegmentEvent != NULL) {
+            WaitHandles[HandleCount] = PromptSegmentEvent;
+            HandleCount++;
+        }
+        JobCompletionEvent = YoriShGetJobCompletionEvent();
+        if (JobCompletionEvent != NULL) {
+            WaitHandles[HandleCount] = JobCompletionEvent;
+            HandleCount++;
+        }
+
+        if (HandleCount == 1) {
+            return WaitForSingleObject(InputHandle, Timeout);
+        }
+
+        Err = WaitForMultipleObjects(HandleCount, WaitHandles, FALSE, Timeout);
+        if (Err <= WAIT_OBJECT_0 || Err >= WAIT_OBJECT_0 + HandleCount) {
+            return Err;
+        }
+
+        if (WaitHandles[Err - WAIT_OBJECT_0] == JobCompletionEvent) {
+            YoriShReportCompletedJobsAtPrompt(Buffer);
+        } else if (YoriShCollectPromptSegments()) {
+            YoriShRedisplayPromptInPlace(Buffer);
+        }
+    }
+}
+
 /**
  Create a new selection, and if one already exists, extend it to the specified
  buffer offset.
@@ -2088,8 +2456,7 @@ YoriShProcessEnhancedKeyDown(
         }
     } else if (KeyCode == VK_RETURN) {
         if (Buffer->SearchMode) {
-            Buffer->SearchMode = FALSE;
-            YoriLibFreeStringContents(&Buffer->SearchString);
+            YoriShEndSearch(Buffer, FALSE);
         } else {
             if (!YoriLibCopySelectionIfPresent(&Buffer->Selection)) {
                 *TerminateInput = TRUE;
@@ -2317,8 +2684,7 @@ YoriShProcessKeyDown(
 
         if (Char == '\r') {
             if (Buffer->SearchMode) {
-                Buffer->SearchMode = FALSE;
-                YoriLibFreeStringContents(&Buffer->SearchString);
+                YoriShEndSearch(Buffer, FALSE);
             } else {
                 if (!YoriLibCopySelectionIfPresent(&Buffer->Selection)) {
                     *TerminateInput = TRUE;
@@ -2328,9 +2694,7 @@ YoriShProcessKeyDown(
             }
         } else if (Char == 27) {
             if (Buffer->SearchMode) {
-                Buffer->SearchMode = FALSE;
-                Buffer->CurrentOffset = Buffer->PreSearchOffset;
-                YoriLibFreeStringContents(&Buffer->SearchString);
+                YoriShEndSearch(Buffer, TRUE);
             } else {
                 YoriShClearInput(Buffer);
                 Buffer->HistoryEntryToUse = NULL;
@@ -2429,6 +2793,19 @@ YoriShProcessKeyDown(
             ClearSelection = TRUE;
         } else if (KeyCode == 'L') {
             YoriShClearScreen(Buffer);
+        } else if (KeyCode == 'R') {
+
+            //
+            //  The first Ctrl+R starts searching history.  Each subsequent
+            //  one finds the next older command containing the search
+            //  string.
+            //
+
+            if (Buffer->HistorySearchMode) {
+                YoriShUpdateInputWithHistorySearchResult(Buffer, Buffer->HistoryEntryToUse);
+            } else {
+                YoriShStartSearch(Buffer, TRUE);
+            }
         } else if (KeyCode == 'V') {
             YORI_STRING ClipboardData;
             YoriLibInitEmptyString(&ClipboardData);
@@ -2442,16 +2819,13 @@ YoriShProcessKeyDown(
             YoriShAddYoriStringToInput(Buffer, &YoriShGlobal.YankBuffer);
         } else if (KeyCode == 0xDB) { // Aka VK_OEM_4, { or [ on US keyboards
             if (Buffer->SearchMode) {
-                Buffer->SearchMode = FALSE;
-                Buffer->CurrentOffset = Buffer->PreSearchOffset;
-                YoriLibFreeStringContents(&Buffer->SearchString);
+                YoriShEndSearch(Buffer, TRUE);
             } else {
                 YoriShClearInput(Buffer);
                 Buffer->HistoryEntryToUse = NULL;
             }
         } else if (KeyCode == 0xBF) { // Aka VK_OEM_2, / or ? on US keyboards
-            Buffer->SearchMode = TRUE;
-            Buffer->PreSearchOffset = Buffer->CurrentOffset;
+            YoriShStartSearch(Buffer, FALSE);
         } else if (KeyCode == VK_TAB) {
             YoriShConfigureConsoleForTabComplete(Buffer);
             ListAll = YoriShTabCompletion(Buffer, YORI_SH_TAB_COMPLETE_FULL_PATH);
@@ -2482,6 +2856,9 @@ YoriShProcessKeyDown(
                 YoriShCompletionListAllMatches(Buffer);
                 *TerminateInput = TRUE;
             }
+        } else if (KeyCode == 'M' && YoriLibIsAllocationProfileEnabled()) {
+            YoriShDisplayAllocationProfile(Buffer);
+            *TerminateInput = TRUE;
         }
     } else if (CtrlMask == ENHANCED_KEY) {
         if (YoriShProcessEnhancedKeyDown(Buffer, InputRecord, TerminateInput)) {
@@ -3213,7 +3590,8 @@ YoriShGetExpressionFromConsole(
         //
 
         if (YoriShGlobal.DelayBeforeSuggesting == 0 ||
-            Buffer.TabContext.TabCount != 0) {
+            Buffer.TabContext.TabCount != 0 ||
+            Buffer.SearchMode) {
 
             Buffer.SuggestionPopulated = TRUE;
         }
@@ -3222,7 +3600,7 @@ YoriShGetExpressionFromConsole(
         while (TRUE) {
             if (YoriLibIsPeriodicScrollActive(&Buffer.Selection)) {
 
-                err = WaitForSingleObject(InputHandle, 100);
+                err = YoriShWaitForInputOrPromptUpdate(&Buffer, InputHandle, 100);
                 if (err == WAIT_OBJECT_0) {
                     break;
                 }
@@ -3230,7 +3608,7 @@ YoriShGetExpressionFromConsole(
                     YoriLibPeriodicScrollForSelection(&Buffer.Selection);
                 }
             } else if (!Buffer.SuggestionPopulated) {
-                err = WaitForSingleObject(InputHandle, YoriShGlobal.DelayBeforeSuggesting);
+                err = YoriShWaitForInputOrPromptUpdate(&Buffer, InputHandle, YoriShGlobal.DelayBeforeSuggesting);
                 if (err == WAIT_OBJECT_0) {
                     break;
                 }
@@ -3247,7 +3625,7 @@ YoriShGetExpressionFromConsole(
                     }
                 }
             } else if (!RestartStateSaved) {
-                err = WaitForSingleObject(InputHandle, 30 * 1000);
+                err = YoriShWaitForInputOrPromptUpdate(&Buffer, InputHandle, 30 * 1000);
                 if (err == WAIT_OBJECT_0) {
                     break;
                 }
@@ -3257,7 +3635,7 @@ YoriShGetExpressionFromConsole(
                     RestartStateSaved = TRUE;
                 }
             } else {
-                err = WaitForSingleObject(InputHandle, INFINITE);
+                err = YoriShWaitForInputOrPromptUpdate(&Buffer, InputHandle, INFINITE);
                 if (err == WAIT_OBJECT_0) {
                     break;
                 }
@@ -78,6 +78,12 @@ typedef struct _YORI_JOB {
      */
     HANDLE hProcess;
 
+    /**
+     A handle to a job object containing the child process and its
+     descendants, or NULL if the process could not be placed in a job.
+     */
+    HANDLE hJob;
+
 
     /**
      The full command line that was used to execute the child process.
@@ -95,6 +101,89 @@ typedef struct _YORI_JOB {
  */
 YORI_LIST_ENTRY JobList;
 
+/**
+ An event that is signalled when any background job completes.  This allows
+ the shell to report completion while waiting for input, without polling
+ each job.
+ */
+HANDLE YoriShJobCompletionEvent;
+
+/**
+ A background thread that waits for a job's process to terminate and
+ signals the job completion event.  The thread operates on its own handle
+ to the process so that it does not depend on the lifetime of the job.
+
+ @param Context The thread's handle to the process, which it closes before
+        returning.
+
+ @return Zero, ignored.
+ */
+DWORD WINAPI
+YoriShJobCompletionWaiter(
+    __in LPVOID Context
+    )
+{
+    HANDLE ProcessHandle;
+
+    ProcessHandle = (HANDLE)Context;
+    WaitForSingleObject(ProcessHandle, INFINITE);
+    CloseHandle(ProcessHandle);
+    SetEvent(YoriShJobCompletionEvent);
+    return 0;
+}
+
+/**
+ Start a background thread to signal the job completion event when a job
+ terminates.  If this fails, the job's completion is still found when the
+ shell next scans jobs before displaying a prompt.
+
+ @param ThisJob The job to wait for.
+ */
+VOID
+YoriShJobStartCompletionWaiter(
+    __in PYORI_JOB ThisJob
+    )
+{
+    HANDLE ProcessHandle;
+    HANDLE ThreadHandle;
+    DWORD ThreadId;
+
+    if (ThisJob->hProcess == NULL) {
+        return;
+    }
+
+    if (YoriShJobCompletionEvent == NULL) {
+        YoriShJobCompletionEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+        if (YoriShJobCompletionEvent == NULL) {
+            return;
+        }
+    }
+
+    if (!DuplicateHandle(GetCurrentProcess(), ThisJob->hProcess, GetCurrentProcess(), &ProcessHandle, SYNCHRONIZE, FALSE, 0)) {
+        return;
+    }
+
+    ThreadHandle = CreateThread(NULL, 0, YoriShJobCompletionWaiter, ProcessHandle, 0, &ThreadId);
+    if (ThreadHandle == NULL) {
+        CloseHandle(ProcessHandle);
+        return;
+    }
+
+    CloseHandle(ThreadHandle);
+}
+
+/**
+ Return the event that is signalled when any background job completes.
+
+ @return The event, or NULL if no job has been able to register for
+         completion notification.
+ */
+HANDLE
+YoriShGetJobCompletionEvent(VOID)
+{
+    return YoriShJobCompletionEvent;
+}
+
 /**
  Allocate a new job for background processing.
 
@@ -129,6 +218,7 @@ YoriShCreateNewJob(
 
     ThisJob->JobId = ++YoriShGlobal.PreviousJobId;
     ThisJob->hProcess = ExecContext->hProcess;
+    ThisJob->hJob = ExecContext->hJob;
     ThisJob->dwProcessId = ExecContext->dwProcessId;
 
     if (ExecContext->StdOutType == StdOutTypeBuffer &&
@@ -147,6 +237,7 @@ YoriShCreateNewJob(
 
     YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("Job %i: %y\n"), ThisJob->JobId, &ThisJob->CmdLine);
     YoriLibAppendList(&JobList, &ThisJob->ListEntry);
+    YoriShJobStartCompletionWaiter(ThisJob);
 
     return TRUE;
 }
@@ -167,10 +258,50 @@ YoriShFreeJob(
         YoriLibShDereferenceProcessBuffer(ThisJob->ProcessBuffers);
     }
 
+    if (ThisJob->hJob != NULL) {
+        CloseHandle(ThisJob->hJob);
+    }
+
     YoriLibFreeStringContents(&ThisJob->CmdLine);
     YoriLibFree(ThisJob);
 }
 
+/**
+ Check whether an executing job has completed, and if so, record its exit
+ code and mark it as completed.
+
+ @param ThisJob The job to check.
+
+ @param Report TRUE if the user should be told that the job has completed.
+
+ @return TRUE to indicate the job has completed, FALSE if it is still
+         executing.
+ */
+BOOL
+YoriShJobCheckCompletion(
+    __in PYORI_JOB ThisJob,
+    __in BOOL Report
+    )
+{
+    if (ThisJob->JobState != JobStateExecuting) {
+        return TRUE;
+    }
+
+    if (WaitForSingleObject(ThisJob->hProcess, 0) != WAIT_OBJECT_0) {
+        return FALSE;
+    }
+
+    GetExitCodeProcess(ThisJob->hProcess, &ThisJob->ExitCode);
+    ThisJob->JobState = JobStateCompletedAwaitingDelete;
+    if (YoriLibEtwIsEnabled(YORI_LIB_ETW_KEYWORD_JOB)) {
+        YoriLibEtwWriteEvent(YORI_LIB_ETW_KEYWORD_JOB, "JobComplete", "CmdLine", &ThisJob->CmdLine, "JobId", ThisJob->JobId, "ExitCode", ThisJob->ExitCode);
+    }
+    if (Report) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("Job %i completed, result %i: %y\n"), ThisJob->JobId, ThisJob->ExitCode, &ThisJob->CmdLine);
+    }
+    return TRUE;
+}
+
 /**
  Scan the set of outstanding jobs and report to the user if any have
  completed.
@@ -198,15 +329,7 @@ YoriShScanJobsReportCompletion(
     while (ListEntry != NULL) {
         ThisJob = CONTAINING_RECORD(ListEntry, YORI_JOB, ListEntry);
         ListEntry = YoriLibGetNextListEntry(&JobList, ListEntry);
-        if (ThisJob->JobState == JobStateExecuting) {
-            if (WaitForSingleObject(ThisJob->hProcess, 0) == WAIT_OBJECT_0) {
-                GetExitCodeProcess(ThisJob->hProcess, &ThisJob->ExitCode);
-                ThisJob->JobState = JobStateCompletedAwaitingDelete;
-                if (!TeardownAll) {
-                    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("Job %i completed, result %i: %y\n"), ThisJob->JobId, ThisJob->ExitCode, &ThisJob->CmdLine);
-                }
-            }
-        }
+        YoriShJobCheckCompletion(ThisJob, !TeardownAll);
 
         if (TeardownAll && ThisJob->JobState == JobStateExecuting) {
             ThisJob->JobState = JobStateCompletedAwaitingDelete;
@@ -226,6 +349,62 @@ YoriShScanJobsReportCompletion(
     return TRUE;
 }
 
+/**
+ Check whether any executing job has terminated but its completion has not
+ yet been reported to the user.
+
+ @return TRUE if a job has completed and should be reported, FALSE if not.
+ */
+BOOL
+YoriShJobsCompletedUnreported(VOID)
+{
+    PYORI_JOB ThisJob;
+    PYORI_LIST_ENTRY ListEntry;
+
+    if (YoriShGlobal.PreviousJobId == 0) {
+        return FALSE;
+    }
+
+    ListEntry = YoriLibGetNextListEntry(&JobList, NULL);
+    while (ListEntry != NULL) {
+        ThisJob = CONTAINING_RECORD(ListEntry, YORI_JOB, ListEntry);
+        ListEntry = YoriLibGetNextListEntry(&JobList, ListEntry);
+        if (ThisJob->JobState == JobStateExecuting &&
+            ThisJob->hProcess != NULL &&
+            WaitForSingleObject(ThisJob->hProcess, 0) == WAIT_OBJECT_0) {
+
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+/**
+ Report to the user any executing jobs which have completed.  Unlike
+ YoriShScanJobsReportCompletion, this does not age or delete completed jobs,
+ so it can be called whenever a job completes without changing how long
+ completed jobs are retained.
+ */
+VOID
+YoriShReportCompletedJobs(VOID)
+{
+    PYORI_JOB ThisJob;
+    PYORI_LIST_ENTRY ListEntry;
+
+    if (YoriShGlobal.PreviousJobId == 0) {
+        return;
+    }
+
+    ListEntry = YoriLibGetNextListEntry(&JobList, NULL);
+    while (ListEntry != NULL) {
+        ThisJob = CONTAINING_RECORD(ListEntry, YORI_JOB, ListEntry);
+        ListEntry = YoriLibGetNextListEntry(&JobList, ListEntry);
+        if (ThisJob->hProcess != NULL) {
+            YoriShJobCheckCompletion(ThisJob, TRUE);
+        }
+    }
+}
 
 /**
  Terminates a specified job.
@@ -396,6 +575,135 @@ YoriShJobWait(
     YoriShCleanupWaitContext(&WaitContext);
 }
 
+/**
+ Waits until any executing job completes, or until the user cancels the
+ wait.  If a job has already completed but has not yet been reported, it is
+ returned immediately.  Once a job is returned it is considered completed,
+ so a subsequent call waits for a different job.
+
+ @return The ID of the job that completed, or zero if no jobs are executing
+         or the wait was cancelled.
+ */
+DWORD
+YoriShJobWaitAny(VOID)
+{
+    HANDLE WaitOn[MAXIMUM_WAIT_OBJECTS];
+    PYORI_JOB WaitJobs[MAXIMUM_WAIT_OBJECTS];
+    PYORI_JOB ThisJob;
+    PYORI_LIST_ENTRY ListEntry;
+    DWORD Count;
+    DWORD Result;
+
+    if (YoriShGlobal.PreviousJobId == 0) {
+        return 0;
+    }
+
+    //
+    //  Collect the executing jobs, leaving one slot for the cancel event.
+    //  If there are more jobs than can be waited on at once, only the oldest
+    //  are waited on, which still returns once one of them completes.
+    //
+
+    Count = 0;
+    ListEntry = YoriLibGetNextListEntry(&JobList, NULL);
+    while (ListEntry != NULL) {
+        ThisJob = CONTAINING_RECORD(ListEntry, YORI_JOB, ListEntry);
+        ListEntry = YoriLibGetNextListEntry(&JobList, ListEntry);
+        if (ThisJob->JobState != JobStateExecuting || ThisJob->hProcess == NULL) {
+            continue;
+        }
+
+        if (YoriShJobCheckCompletion(ThisJob, TRUE)) {
+            return ThisJob->JobId;
+        }
+
+        if (Count < MAXIMUM_WAIT_OBJECTS - 1) {
+            WaitOn[Count] = ThisJob->hProcess;
+            WaitJobs[Count] = ThisJob;
+            Count++;
+        }
+    }
+
+    if (Count == 0) {
+        return 0;
+    }
+
+    YoriLibCancelEnable(FALSE);
+    WaitOn[Count] = YoriLibCancelGetEvent();
+    Result = WaitForMultipleObjects(Count + 1, WaitOn, FALSE, INFINITE);
+    YoriLibCancelIgnore();
+
+    if (Result >= WAIT_OBJECT_0 && Result < WAIT_OBJECT_0 + Count) {
+        ThisJob = WaitJobs[Result - WAIT_OBJECT_0];
+        YoriShJobCheckCompletion(ThisJob, TRUE);
+        return ThisJob->JobId;
+    }
+
+    return 0;
+}
+
+/**
+ Return the number of jobs that are currently executing.  Any job found to
+ have completed is marked as completed and reported to the user.
+
+ @return The number of executing jobs.
+ */
+DWORD
+YoriShJobCountExecuting(VOID)
+{
+    PYORI_JOB ThisJob;
+    PYORI_LIST_ENTRY ListEntry;
+    DWORD Count;
+
+    if (YoriShGlobal.PreviousJobId == 0) {
+        return 0;
+    }
+
+    Count = 0;
+    ListEntry = YoriLibGetNextListEntry(&JobList, NULL);
+    while (ListEntry != NULL) {
+        ThisJob = CONTAINING_RECORD(ListEntry, YORI_JOB, ListEntry);
+        ListEntry = YoriLibGetNextListEntry(&JobList, ListEntry);
+        if (ThisJob->hProcess != NULL &&
+            !YoriShJobCheckCompletion(ThisJob, TRUE)) {
+
+            Count++;
+        }
+    }
+
+    return Count;
+}
+
+/**
+ If the user has limited the number of concurrently executing jobs, wait
+ until fewer than that number are executing so that a new job can be
+ started.  This allows a script to launch a large number of background
+ commands and have them execute as a bounded pool, since each launch is held
+ until a previous job completes.
+
+ @return TRUE to indicate a new job can be started, FALSE if the user
+         cancelled the wait.
+ */
+__success(return)
+BOOL
+YoriShJobWaitForSlot(VOID)
+{
+    if (YoriShGlobal.JobLimit == 0) {
+        return TRUE;
+    }
+
+    while (YoriShJobCountExecuting() >= YoriShGlobal.JobLimit) {
+        if (YoriShJobWaitAny() == 0) {
+            if (YoriShJobCountExecuting() >= YoriShGlobal.JobLimit) {
+                return FALSE;
+            }
+            break;
+        }
+    }
+
+    return TRUE;
+}
+
 /**
  Sets the priority associated with a job.
 
@@ -609,5 +917,46 @@ YoriShGetJobInformation(
     return FALSE;
 }
 
+/**
+ Returns the resources consumed by an executing or completed job ID,
+ including all processes launched by the job.
+
+ @param JobId The ID to query information for.
+
+ @param Accounting On successful completion, populated with the resources
+        consumed by the job's process tree.
+
+ @return TRUE to indicate success, FALSE to indicate failure, including if
+         the job could not be tracked with a job object.
+ */
+__success(return)
+BOOL
+YoriShGetJobAccounting(
+    __in DWORD JobId,
+    __out PYORI_LIB_JOB_ACCOUNTING Accounting
+    )
+{
+    PYORI_JOB ThisJob;
+    PYORI_LIST_ENTRY ListEntry;
+
+    if (YoriShGlobal.PreviousJobId == 0) {
+        return FALSE;
+    }
+
+    ListEntry = YoriLibGetNextListEntry(&JobList, NULL);
+    while (ListEntry != NULL) {
+        ThisJob = CONTAINING_RECORD(ListEntry, YORI_JOB, ListEntry);
+        ListEntry = YoriLibGetNextListEntry(&JobList, ListEntry);
+        if (ThisJob->JobId == JobId) {
+            if (ThisJob->hJob == NULL) {
+                return FALSE;
+            }
+            return YoriLibQueryJobObjectAccounting(ThisJob->hJob, Accounting);
+        }
+    }
+
+    return FALSE;
+}
+
 
 // vim:sw=4:ts=4:et:
@@ -39,12 +39,13 @@ CHAR strHelpText[] =
         "\n"
         "Start a Yori shell instance.\n"
         "\n"
-        "YORI [-license] [-c <cmd>] [-k <cmd>]\n"
+        "YORI [-license] [-c <cmd>] [-k <cmd>] [-server <name>]\n"
         "\n"
         "   -license       Display license text\n"
         "   -c <cmd>       Execute command and terminate the shell\n"
         "   -k <cmd>       Execute command and continue as an interactive shell\n"
-        "   -nouser        Do not execute per-user AutoInit scripts\n";
+        "   -nouser        Do not execute per-user AutoInit scripts\n"
+        "   -server <name> Execute commands sent by yrun clients to this name\n";
 
 /**
  Display usage text to the user.
@@ -119,6 +120,48 @@ YoriShExecuteYoriInit(
     return TRUE;
 }
 
+/**
+ A callback function for every init script found, which records the script
+ so that the set of scripts can be checked against the init cache before
+ executing them.
+
+ @param Filename Pointer to the fully qualified file name of the script.
+
+ @param FileInfo Pointer to information about the file.
+
+ @param Depth The recursion depth.  Ignored in this function.
+
+ @param Context Pointer to the init cache context.
+
+ @return TRUE to continue enumerating, FALSE to terminate.
+ */
+BOOL
+YoriShCollectYoriInit(
+    __in PYORI_STRING Filename,
+    __in PWIN32_FIND_DATA FileInfo,
+    __in DWORD Depth,
+    __in PVOID Context
+    )
+{
+    PYORI_SH_INIT_CACHE Cache;
+
+    UNREFERENCED_PARAMETER(Depth);
+
+    Cache = (PYORI_SH_INIT_CACHE)Context;
+    if (!YoriShInitCacheAddScript(Cache, Filename, FileInfo)) {
+
+        //
+        //  If the script can't be recorded, execute it now so that it is
+        //  not skipped.  Since the set of scripts is now incomplete, the
+        //  cache will not be used.
+        //
+
+        YoriShExecuteYoriInit(Filename, FileInfo, Depth, NULL);
+        YoriLibFreeStringContents(&Cache->CacheFileName);
+    }
+    return TRUE;
+}
+
 /**
  Initialize the console and populate the shell's environment with default
  values.
@@ -138,6 +181,48 @@ YoriShInit(VOID)
 
     YoriLibEnableBackupPrivilege();
 
+    //
+    //  The shell makes many small allocations over a long lifetime, so
+    //  service these from per thread pools rather than the process heap.
+    //
+
+    YoriLibPoolEnable();
+
+    //
+    //  The shell searches the path for every command and during tab
+    //  completion, so cache the contents of path directories.
+    //
+
+    YoriLibPathCacheEnable();
+
+    //
+    //  Free space queries can block on unresponsive network drives, so
+    //  share recent results between commands run within the shell.
+    //
+
+    YoriLibVolumeSpaceCacheEnable();
+
+    //
+    //  Arguments and enumerated files are resolved to full paths
+    //  repeatedly, so remember recent resolutions.
+    //
+
+    YoriLibFullPathCacheEnable();
+
+    //
+    //  Directory listings display the version and architecture of the same
+    //  executables repeatedly, so remember what was parsed from each one.
+    //
+
+    YoriLibPeMetadataCacheEnable();
+
+    //
+    //  Prompts display the status of the same git repository after each
+    //  command, so remember it until the repository changes.
+    //
+
+    YoriLibGitStatusCacheEnable();
+
     //
     //  Translate the constant builtin function mapping into dynamic function
     //  mappings.
@@ -153,6 +238,8 @@ YoriShInit(VOID)
         BuiltinNameMapping++;
     }
 
+    YoriShStartupTraceMark(_T("Register builtins"), NULL);
+
     //
     //  If we don't have a prompt defined, set a default.  If outputting to
     //  the console directly, use VT color; otherwise, default to monochrome.
@@ -277,6 +364,8 @@ YoriShInit(VOID)
     //  Register any builtin aliases, including drive letter colon commands.
     //
 
+    YoriShStartupTraceMark(_T("Initialize environment"), NULL);
+
     YoriShRegisterDefaultAliases();
 
     AliasName[1] = ':';
@@ -298,6 +387,8 @@ YoriShInit(VOID)
     YoriShLoadSystemAliases(TRUE);
     YoriShLoadSystemAliases(FALSE);
 
+    YoriShStartupTraceMark(_T("Register aliases"), NULL);
+
     return TRUE;
 }
 
@@ -316,27 +407,57 @@ YoriShExecuteInitScripts(
     )
 {
     YORI_STRING RelativeYoriInitName;
+    YORI_SH_INIT_CACHE Cache;
+    PYORI_LIST_ENTRY ListEntry;
+    PYORI_SH_INIT_SCRIPT Script;
+
+    YoriShInitCacheInitialize(&Cache);
 
     //
-    //  Execute all system YoriInit scripts.
+    //  Find all system YoriInit scripts.
     //
 
     YoriLibConstantString(&RelativeYoriInitName, _T("~AppDir\\YoriInit.d\\*"));
-    YoriLibForEachFile(&RelativeYoriInitName, YORILIB_FILEENUM_RETURN_FILES, 0, YoriShExecuteYoriInit, NULL, NULL);
+    YoriLibForEachFile(&RelativeYoriInitName, YORILIB_FILEENUM_RETURN_FILES, 0, YoriShCollectYoriInit, NULL, &Cache);
     YoriLibConstantString(&RelativeYoriInitName, _T("~AppDir\\YoriInit*"));
-    YoriLibForEachFile(&RelativeYoriInitName, YORILIB_FILEENUM_RETURN_FILES, 0, YoriShExecuteYoriInit, NULL, NULL);
+    YoriLibForEachFile(&RelativeYoriInitName, YORILIB_FILEENUM_RETURN_FILES, 0, YoriShCollectYoriInit, NULL, &Cache);
 
     //
-    //  Execute all user YoriInit scripts.
+    //  Find all user YoriInit scripts.
     //
 
     if (!IgnoreUserScripts) {
         YoriLibConstantString(&RelativeYoriInitName, _T("~\\YoriInit.d\\*"));
-        YoriLibForEachFile(&RelativeYoriInitName, YORILIB_FILEENUM_RETURN_FILES, 0, YoriShExecuteYoriInit, NULL, NULL);
+        YoriLibForEachFile(&RelativeYoriInitName, YORILIB_FILEENUM_RETURN_FILES, 0, YoriShCollectYoriInit, NULL, &Cache);
         YoriLibConstantString(&RelativeYoriInitName, _T("~\\YoriInit*"));
-        YoriLibForEachFile(&RelativeYoriInitName, YORILIB_FILEENUM_RETURN_FILES, 0, YoriShExecuteYoriInit, NULL, NULL);
+        YoriLibForEachFile(&RelativeYoriInitName, YORILIB_FILEENUM_RETURN_FILES, 0, YoriShCollectYoriInit, NULL, &Cache);
     }
 
+    YoriShStartupTraceMark(_T("Find init scripts"), NULL);
+
+    //
+    //  If the effects of these scripts have been cached, apply them.
+    //  Otherwise, execute the scripts in order and record their effects.
+    //
+
+    if (YoriShInitCacheReplay(&Cache)) {
+        YoriShStartupTraceMark(_T("Apply init cache"), NULL);
+    } else {
+        YoriShInitCacheCaptureState(&Cache);
+        YoriShStartupTraceMark(_T("Check init cache"), NULL);
+        ListEntry = YoriLibGetNextListEntry(&Cache.ScriptList, NULL);
+        while (ListEntry != NULL) {
+            Script = CONTAINING_RECORD(ListEntry, YORI_SH_INIT_SCRIPT, ListEntry);
+            YoriShExecuteYoriInit(&Script->FileName, &Script->FindData, 0, NULL);
+            YoriShStartupTraceMark(_T("Execute init script"), &Script->FileName);
+            ListEntry = YoriLibGetNextListEntry(&Cache.ScriptList, ListEntry);
+        }
+        YoriShInitCacheSave(&Cache);
+        YoriShStartupTraceMark(_T("Save init cache"), NULL);
+    }
+
+    YoriShInitCacheCleanup(&Cache);
+
     //
     //  Reload any state next time it's requested.
     //
@@ -377,6 +498,7 @@ YoriShParseArgs(
     BOOLEAN IgnoreUserScripts = FALSE;
     BOOLEAN Interactive = TRUE;
     BOOLEAN IgnoreInteractive = FALSE;
+    PYORI_STRING ServerName = NULL;
 
     *TerminateApp = FALSE;
     *ExitCode = 0;
@@ -417,11 +539,21 @@ YoriShParseArgs(
                 if (ArgC > i + 1) {
                     YoriShLoadSavedRestartState(&ArgV[i + 1]);
                     YoriShDiscardSavedRestartState(&ArgV[i + 1]);
+                    YoriShStartupTraceMark(_T("Load restart state"), NULL);
                     i++;
                     ExecuteStartupScripts = FALSE;
                     ArgumentUnderstood = TRUE;
                     break;
                 }
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("server")) == 0) {
+                if (ArgC > i + 1) {
+                    Interactive = FALSE;
+                    *TerminateApp = TRUE;
+                    ServerName = &ArgV[i + 1];
+                    i++;
+                    ArgumentUnderstood = TRUE;
+                    break;
+                }
             } else if (YoriLibCompareStringLitIns(&Arg, _T("ss")) == 0) {
                 if (ArgC > i + 1) {
                     Interactive = FALSE;
@@ -467,6 +599,14 @@ YoriShParseArgs(
             }
             YoriLibFreeStringContents(&YsCmdToExec);
         }
+        YoriShStartupTraceMark(_T("Execute initial command"), NULL);
+    }
+
+    if (ServerName != NULL) {
+        YoriShStartupTraceReport();
+        if (!YoriShRunServer(ServerName)) {
+            *ExitCode = EXIT_FAILURE;
+        }
     }
 
     return TRUE;
@@ -769,13 +909,16 @@ ymain (
     YORI_STRING CurrentExpression;
     BOOLEAN TerminateApp = FALSE;
 
+    YoriShStartupTraceInitialize();
     YoriShInit();
     YoriShParseArgs(ArgC, ArgV, &TerminateApp, &YoriShGlobal.ExitProcessExitCode);
 
     if (!TerminateApp) {
 
         YoriShDisplayWarnings();
+        YoriShStartupTraceMark(_T("Display warnings"), NULL);
         YoriShLoadHistoryFromFile();
+        YoriShStartupTraceMark(_T("Load history"), NULL);
 
         while(TRUE) {
 
@@ -797,6 +940,7 @@ ymain (
             //
 
             YoriShPreCommand(FALSE);
+            YoriShStartupTraceReport();
             YoriShDisplayPrompt();
             YoriShPreCommand(FALSE);
 
@@ -807,6 +951,7 @@ ymain (
                 break;
             }
             YoriShPreCommand(TRUE);
+            YoriShFlushCommandCache();
             YoriShExecPreCommandString();
             if (CurrentExpression.LengthInChars > 0) {
                 YoriShExecuteExpression(&CurrentExpression);
@@ -821,15 +966,25 @@ ymain (
     YoriShScanJobsReportCompletion(TRUE);
     YoriShClearAllHistory();
     YoriShClearAllAliases();
+    YoriShClearExecCaches();
     YoriLibShBuiltinUnregisterAll();
     YoriShDiscardSavedRestartState(NULL);
+    YoriShStartupTraceReport();
     YoriShCleanupInputContext();
+    YoriShCleanupPromptSegments();
     YoriLibLineReadCleanupCache();
+    YoriLibPathCacheCleanup();
+    YoriLibVolumeSpaceCacheCleanup();
+    YoriLibFullPathCacheCleanup();
+    YoriLibPeMetadataCacheCleanup();
+    YoriLibGitStatusCacheCleanup();
     YoriLibCleanupCurrentDirectory();
     YoriLibFreeStringContents(&YoriShGlobal.PreCmdVariable);
     YoriLibFreeStringContents(&YoriShGlobal.PostCmdVariable);
     YoriLibFreeStringContents(&YoriShGlobal.PromptVariable);
     YoriLibFreeStringContents(&YoriShGlobal.TitleVariable);
+    YoriLibFreeStringContents(&YoriShGlobal.EnvironmentStrings);
+    YoriLibFreeStringContents(&YoriShGlobal.AppDirectory);
     YoriLibFreeStringContents(&YoriShGlobal.NextCommand);
     YoriLibFreeStringContents(&YoriShGlobal.YankBuffer);
     YoriLibFreeStringContents(&YoriShGlobal.CurrentDirectoryBuffers[0]);
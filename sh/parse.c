@@ -26,6 +26,319 @@
 
 #include "yori.h"
 
+/**
+ The maximum number of parsed command lines to retain.
+ */
+#define YORI_SH_MAX_CACHED_LINES 128
+
+/**
+ The maximum number of resolved commands to retain.
+ */
+#define YORI_SH_MAX_CACHED_COMMANDS 256
+
+/**
+ The result of parsing a command line which has previously been executed.
+ Scripts commonly execute the same lines repeatedly, and since environment
+ variables are expanded after parsing, the parsed form of a line can be
+ reused each time it is executed.
+ */
+typedef struct _YORI_SH_CACHED_LINE {
+
+    /**
+     The links of this line within the list of cached lines, ordered from
+     most recently used to least recently used.
+     */
+    YORI_LIST_ENTRY ListEntry;
+
+    /**
+     The entry for this line within the hash table of cached lines.  The key
+     is the text of the line.
+     */
+    YORI_HASH_ENTRY HashEntry;
+
+    /**
+     The parsed form of the line.
+     */
+    YORI_LIBSH_CMD_CONTEXT CmdContext;
+} YORI_SH_CACHED_LINE, *PYORI_SH_CACHED_LINE;
+
+/**
+ The result of searching the path for a command.
+ */
+typedef struct _YORI_SH_CACHED_COMMAND {
+
+    /**
+     The entry for this command within the hash table of cached commands.
+     The key is the command name that was searched for.
+     */
+    YORI_HASH_ENTRY HashEntry;
+
+    /**
+     The fully qualified executable that was found, or an empty string if
+     no executable was found.
+     */
+    YORI_STRING FoundExecutable;
+
+    /**
+     The environment generation when the path was searched.  Changes to
+     the environment or current directory invalidate the result.
+     */
+    DWORD EnvironmentGeneration;
+} YORI_SH_CACHED_COMMAND, *PYORI_SH_CACHED_COMMAND;
+
+/**
+ A hash table of previously parsed command lines.
+ */
+PYORI_HASH_TABLE YoriShCachedLineTable;
+
+/**
+ A list of previously parsed command lines, ordered from most recently used
+ to least recently used.
+ */
+YORI_LIST_ENTRY YoriShCachedLineList;
+
+/**
+ The number of entries in YoriShCachedLineList.
+ */
+DWORD YoriShCachedLineCount;
+
+/**
+ A hash table of previous path searches.
+ */
+PYORI_HASH_TABLE YoriShCachedCommandTable;
+
+/**
+ Free a previously parsed command line.
+
+ @param CachedLine Pointer to the line to free.
+ */
+VOID
+YoriShFreeCachedLine(
+    __in PYORI_SH_CACHED_LINE CachedLine
+    )
+{
+    YoriLibRemoveListItem(&CachedLine->ListEntry);
+    YoriLibHashRemoveByEntry(&CachedLine->HashEntry);
+    YoriLibShFreeCmdContext(&CachedLine->CmdContext);
+    YoriLibFree(CachedLine);
+    YoriShCachedLineCount--;
+}
+
+/**
+ Free a previous path search.
+
+ @param CachedCommand Pointer to the path search to free.
+ */
+VOID
+YoriShFreeCachedCommand(
+    __in PYORI_SH_CACHED_COMMAND CachedCommand
+    )
+{
+    YoriLibHashRemoveByEntry(&CachedCommand->HashEntry);
+    YoriLibFreeStringContents(&CachedCommand->FoundExecutable);
+    YoriLibFree(CachedCommand);
+}
+
+/**
+ Discard all previous path searches.  This is done before executing each
+ command entered interactively, so that an executable which is created
+ while the shell is waiting for input is found by the next command.
+ Within a script, or a single interactive command, previous path searches
+ are reused until the environment or current directory changes.
+ */
+VOID
+YoriShFlushCommandCache(VOID)
+{
+    PYORI_HASH_ENTRY HashEntry;
+
+    if (YoriShCachedCommandTable == NULL) {
+        return;
+    }
+
+    HashEntry = YoriLibHashGetNextEntry(YoriShCachedCommandTable, NULL);
+    while (HashEntry != NULL) {
+        YoriShFreeCachedCommand((PYORI_SH_CACHED_COMMAND)HashEntry->Context);
+        HashEntry = YoriLibHashGetNextEntry(YoriShCachedCommandTable, NULL);
+    }
+}
+
+/**
+ Free all previously parsed command lines and path searches.  This is
+ called when the shell is exiting.
+ */
+VOID
+YoriShClearExecCaches(VOID)
+{
+    PYORI_LIST_ENTRY ListEntry;
+
+    if (YoriShCachedLineTable != NULL) {
+        ListEntry = YoriLibGetNextListEntry(&YoriShCachedLineList, NULL);
+        while (ListEntry != NULL) {
+            YoriShFreeCachedLine(CONTAINING_RECORD(ListEntry, YORI_SH_CACHED_LINE, ListEntry));
+            ListEntry = YoriLibGetNextListEntry(&YoriShCachedLineList, NULL);
+        }
+        YoriLibFreeEmptyHashTable(YoriShCachedLineTable);
+        YoriShCachedLineTable = NULL;
+    }
+
+    if (YoriShCachedCommandTable != NULL) {
+        YoriShFlushCommandCache();
+        YoriLibFreeEmptyHashTable(YoriShCachedCommandTable);
+        YoriShCachedCommandTable = NULL;
+    }
+}
+
+/**
+ Parse a command line for execution, reusing the result of a previous parse
+ of the same text if one exists.  The result is identical to
+ @ref YoriLibShParseCmdlineToCmdContext with a CurrentOffset of zero.
+
+ @param CmdLine Pointer to the command line to parse.
+
+ @param CmdContext On successful completion, populated with the parsed
+        command line.  Each argument is a reference to the cached result,
+        so the caller must replace rather than modify arguments in place.
+        The caller should free this with @ref YoriLibShFreeCmdContext .
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+YoriShParseCmdlineForExecution(
+    __in PYORI_STRING CmdLine,
+    __out PYORI_LIBSH_CMD_CONTEXT CmdContext
+    )
+{
+    PYORI_HASH_ENTRY HashEntry;
+    PYORI_SH_CACHED_LINE CachedLine;
+    PYORI_LIST_ENTRY ListEntry;
+
+    if (YoriShCachedLineTable == NULL) {
+        YoriShCachedLineTable = YoriLibAllocateHashTable(YORI_SH_MAX_CACHED_LINES);
+        if (YoriShCachedLineTable == NULL) {
+            return YoriLibShParseCmdlineToCmdContext(CmdLine, 0, CmdContext);
+        }
+        YoriLibInitializeListHead(&YoriShCachedLineList);
+    }
+
+    //
+    //  The hash table compares keys case insensitively, but parsing must
+    //  preserve case, so an entry which only matches case insensitively is
+    //  discarded.
+    //
+
+    HashEntry = YoriLibHashLookupByKey(YoriShCachedLineTable, CmdLine);
+    if (HashEntry != NULL) {
+        CachedLine = (PYORI_SH_CACHED_LINE)HashEntry->Context;
+        if (YoriLibCompareString(&HashEntry->Key, CmdLine) == 0) {
+            YoriLibRemoveListItem(&CachedLine->ListEntry);
+            YoriLibInsertList(&YoriShCachedLineList, &CachedLine->ListEntry);
+            return YoriLibShCopyCmdContext(CmdContext, &CachedLine->CmdContext);
+        }
+        YoriShFreeCachedLine(CachedLine);
+    }
+
+    if (!YoriLibShParseCmdlineToCmdContext(CmdLine, 0, CmdContext)) {
+        return FALSE;
+    }
+
+    //
+    //  Only lines with arguments are retained.  If the result can't be
+    //  retained, the caller still has a parsed line to execute.
+    //
+
+    if (CmdContext->ArgC == 0) {
+        return TRUE;
+    }
+
+    CachedLine = YoriLibMalloc(sizeof(YORI_SH_CACHED_LINE));
+    if (CachedLine == NULL) {
+        return TRUE;
+    }
+
+    if (!YoriLibShCopyCmdContext(&CachedLine->CmdContext, CmdContext)) {
+        YoriLibFree(CachedLine);
+        return TRUE;
+    }
+
+    if (YoriShCachedLineCount >= YORI_SH_MAX_CACHED_LINES) {
+        ListEntry = YoriLibGetPreviousListEntry(&YoriShCachedLineList, NULL);
+        YoriShFreeCachedLine(CONTAINING_RECORD(ListEntry, YORI_SH_CACHED_LINE, ListEntry));
+    }
+
+    YoriLibHashInsertByKey(YoriShCachedLineTable, CmdLine, CachedLine, &CachedLine->HashEntry);
+    YoriLibInsertList(&YoriShCachedLineList, &CachedLine->ListEntry);
+    YoriShCachedLineCount++;
+
+    return TRUE;
+}
+
+/**
+ Search the path for a command, reusing the result of a previous search if
+ the environment and current directory have not changed since.  The result
+ is identical to @ref YoriLibLocateExecutableInPath .
+
+ @param SearchFor The command to search for.
+
+ @param FoundExecutable On successful completion, populated with the fully
+        qualified executable, or an empty string if no executable was found.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+YoriShLocateExecutableInPathCached(
+    __in PYORI_STRING SearchFor,
+    __out PYORI_STRING FoundExecutable
+    )
+{
+    PYORI_HASH_ENTRY HashEntry;
+    PYORI_SH_CACHED_COMMAND CachedCommand;
+
+    if (YoriShCachedCommandTable == NULL) {
+        YoriShCachedCommandTable = YoriLibAllocateHashTable(YORI_SH_MAX_CACHED_COMMANDS);
+        if (YoriShCachedCommandTable == NULL) {
+            return YoriLibLocateExecutableInPath(SearchFor, NULL, NULL, FoundExecutable);
+        }
+    }
+
+    //
+    //  A previously found executable is only used if it still exists.
+    //
+
+    HashEntry = YoriLibHashLookupByKey(YoriShCachedCommandTable, SearchFor);
+    if (HashEntry != NULL) {
+        CachedCommand = (PYORI_SH_CACHED_COMMAND)HashEntry->Context;
+        if (CachedCommand->EnvironmentGeneration == YoriShGlobal.EnvironmentGeneration &&
+            (CachedCommand->FoundExecutable.LengthInChars == 0 ||
+             GetFileAttributes(CachedCommand->FoundExecutable.StartOfString) != (DWORD)-1)) {
+
+            YoriLibCloneString(FoundExecutable, &CachedCommand->FoundExecutable);
+            return TRUE;
+        }
+        YoriShFreeCachedCommand(CachedCommand);
+    }
+
+    if (!YoriLibLocateExecutableInPath(SearchFor, NULL, NULL, FoundExecutable)) {
+        return FALSE;
+    }
+
+    if (YoriShCachedCommandTable->NumberEntries >= YORI_SH_MAX_CACHED_COMMANDS) {
+        YoriShFlushCommandCache();
+    }
+
+    CachedCommand = YoriLibMalloc(sizeof(YORI_SH_CACHED_COMMAND));
+    if (CachedCommand == NULL) {
+        return TRUE;
+    }
+
+    YoriLibCloneString(&CachedCommand->FoundExecutable, FoundExecutable);
+    CachedCommand->EnvironmentGeneration = YoriShGlobal.EnvironmentGeneration;
+    YoriLibHashInsertByKey(YoriShCachedCommandTable, SearchFor, CachedCommand, &CachedCommand->HashEntry);
+
+    return TRUE;
+}
+
 /**
  Expand any aliases in a command context, resolve any executable via path
  lookups, and return with an exec context indicating which program to run.
@@ -59,7 +372,7 @@ YoriShResolveCommandToExecutable(
         YoriLibCloneString(&ExpandedCmd, &CmdContext->ArgV[0]);
     }
 
-    if (YoriLibLocateExecutableInPath(&ExpandedCmd, NULL, NULL, &FoundExecutable)) {
+    if (YoriShLocateExecutableInPathCached(&ExpandedCmd, &FoundExecutable)) {
 
         if (FoundExecutable.LengthInChars > 0) {
             YoriLibFreeStringContents(&CmdContext->ArgV[0]);
@@ -122,4 +435,245 @@ YoriShExpandEnvironmentInCmdContext(
 }
 
 
+/**
+ Return a copy of a parsed command context.  Each argument in the copy is a
+ reference to the corresponding argument in the source, so the caller is
+ free to modify or replace arguments without affecting the source.
+
+ @param SrcCmdContext Pointer to the command context to copy.
+
+ @param DestCmdContext On successful completion, populated with a copy of
+        the source.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+YoriShCopyParsedCmdContext(
+    __in PYORI_LIBSH_CMD_CONTEXT SrcCmdContext,
+    __out PYORI_LIBSH_CMD_CONTEXT DestCmdContext
+    )
+{
+    if (SrcCmdContext->ArgC == 0) {
+        DestCmdContext->ArgC = 0;
+        DestCmdContext->ArgV = NULL;
+        DestCmdContext->ArgContexts = NULL;
+        DestCmdContext->MemoryToFreeArgV = NULL;
+        DestCmdContext->MemoryToFreeArgContexts = NULL;
+        DestCmdContext->CurrentArg = SrcCmdContext->CurrentArg;
+        DestCmdContext->CurrentArgOffset = SrcCmdContext->CurrentArgOffset;
+    } else if (!YoriLibShCopyCmdContext(DestCmdContext, SrcCmdContext)) {
+        return FALSE;
+    }
+
+    DestCmdContext->TrailingChars = SrcCmdContext->TrailingChars;
+    return TRUE;
+}
+
+/**
+ Find the last argument in a previously parsed command line where parsing
+ of a new command line can resume.  Parsing is restartable at an argument
+ if all text before it is unchanged, the cursor is beyond it, and the
+ argument was started by a space.  Arguments that start because of a
+ seperator such as "|" or ">" are not restartable, because when they are
+ parsed in isolation they are not recognized as seperators.
+
+ @param Cache Pointer to the previous parse result.
+
+ @param CmdLine Pointer to the new command line.
+
+ @param CommonLength The number of characters at the beginning of the
+        previously parsed string and the new command line that are
+        identical.
+
+ @param CurrentOffset The cursor offset within the new command line.
+
+ @return The argument index to restart parsing from.  Zero indicates that
+         no argument is suitable and the entire command line should be
+         parsed.
+ */
+YORI_ALLOC_SIZE_T
+YoriShFindParseRestartArg(
+    __in PYORI_SH_PARSE_CACHE Cache,
+    __in PYORI_STRING CmdLine,
+    __in YORI_ALLOC_SIZE_T CommonLength,
+    __in YORI_ALLOC_SIZE_T CurrentOffset
+    )
+{
+    YORI_ALLOC_SIZE_T Index;
+    YORI_ALLOC_SIZE_T SourceOffset;
+    YORI_STRING Remaining;
+
+    for (Index = Cache->CmdContext.ArgC; Index > 1; Index--) {
+        SourceOffset = Cache->CmdContext.ArgContexts[Index - 1].SourceOffset;
+        if (SourceOffset == 0 ||
+            SourceOffset >= CommonLength ||
+            SourceOffset >= CurrentOffset) {
+
+            continue;
+        }
+
+        if (CmdLine->StartOfString[SourceOffset - 1] != ' ' ||
+            CmdLine->StartOfString[SourceOffset] == '@') {
+
+            continue;
+        }
+
+        YoriLibInitEmptyString(&Remaining);
+        Remaining.StartOfString = &CmdLine->StartOfString[SourceOffset];
+        Remaining.LengthInChars = CmdLine->LengthInChars - SourceOffset;
+        if (YoriLibShIsArgumentSeperator(&Remaining, NULL, NULL)) {
+            continue;
+        }
+
+        return Index - 1;
+    }
+
+    return 0;
+}
+
+/**
+ Parse a command line into a command context, using the result of a
+ previous parse where possible.  When the user edits a line, the text before
+ the edit is unchanged, so arguments before the edit are taken from the
+ previous result and only the text from the last restartable argument is
+ parsed again.
+
+ @param Cache Pointer to the previous parse result.  On successful
+        completion, this is updated to describe the new command line.
+
+ @param CmdLine Pointer to the command line to parse.
+
+ @param CurrentOffset The cursor offset within the command line.
+
+ @param CmdContext On successful completion, populated with the parsed
+        command line.  The caller should free this with
+        @ref YoriLibShFreeCmdContext .
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+YoriShParseCmdlineWithCache(
+    __inout PYORI_SH_PARSE_CACHE Cache,
+    __in PYORI_STRING CmdLine,
+    __in YORI_ALLOC_SIZE_T CurrentOffset,
+    __out PYORI_LIBSH_CMD_CONTEXT CmdContext
+    )
+{
+    YORI_LIBSH_CMD_CONTEXT NewCmdContext;
+    YORI_LIBSH_CMD_CONTEXT TailCmdContext;
+    YORI_STRING Tail;
+    YORI_ALLOC_SIZE_T CommonLength;
+    YORI_ALLOC_SIZE_T RestartArg;
+    YORI_ALLOC_SIZE_T RestartOffset;
+    YORI_ALLOC_SIZE_T Index;
+
+    RestartArg = 0;
+    if (Cache->Valid) {
+        CommonLength = 0;
+        while (CommonLength < Cache->Text.LengthInChars &&
+               CommonLength < CmdLine->LengthInChars &&
+               Cache->Text.StartOfString[CommonLength] == CmdLine->StartOfString[CommonLength]) {
+
+            CommonLength++;
+        }
+
+        if (CommonLength == Cache->Text.LengthInChars &&
+            CommonLength == CmdLine->LengthInChars &&
+            CurrentOffset == Cache->CurrentOffset) {
+
+            return YoriShCopyParsedCmdContext(&Cache->CmdContext, CmdContext);
+        }
+
+        RestartArg = YoriShFindParseRestartArg(Cache, CmdLine, CommonLength, CurrentOffset);
+    }
+
+    if (RestartArg == 0) {
+        if (!YoriLibShParseCmdlineToCmdContext(CmdLine, CurrentOffset, &NewCmdContext)) {
+            return FALSE;
+        }
+    } else {
+
+        //
+        //  Parse the text from the restart argument onwards, then build a
+        //  context consisting of the unchanged arguments from the previous
+        //  parse followed by the newly parsed ones.
+        //
+
+        RestartOffset = Cache->CmdContext.ArgContexts[RestartArg].SourceOffset;
+        YoriLibInitEmptyString(&Tail);
+        Tail.StartOfString = &CmdLine->StartOfString[RestartOffset];
+        Tail.LengthInChars = CmdLine->LengthInChars - RestartOffset;
+
+        if (!YoriLibShParseCmdlineToCmdContext(&Tail, CurrentOffset - RestartOffset, &TailCmdContext)) {
+            return FALSE;
+        }
+
+        ASSERT(TailCmdContext.ArgC > 0);
+
+        if (!YoriLibShAllocateArgCount(&NewCmdContext, RestartArg + TailCmdContext.ArgC, 0, NULL)) {
+            YoriLibShFreeCmdContext(&TailCmdContext);
+            return FALSE;
+        }
+
+        for (Index = 0; Index < RestartArg; Index++) {
+            YoriLibShCopyArg(&Cache->CmdContext, Index, &NewCmdContext, Index);
+        }
+
+        for (Index = 0; Index < TailCmdContext.ArgC; Index++) {
+            YoriLibShCopyArg(&TailCmdContext, Index, &NewCmdContext, RestartArg + Index);
+            NewCmdContext.ArgContexts[RestartArg + Index].SourceOffset = NewCmdContext.ArgContexts[RestartArg + Index].SourceOffset + RestartOffset;
+        }
+
+        NewCmdContext.CurrentArg = RestartArg + TailCmdContext.CurrentArg;
+        NewCmdContext.CurrentArgOffset = TailCmdContext.CurrentArgOffset;
+        NewCmdContext.TrailingChars = TailCmdContext.TrailingChars;
+        YoriLibShFreeCmdContext(&TailCmdContext);
+    }
+
+    //
+    //  Save the new result into the cache.  If the text can't be saved,
+    //  give the result to the caller and leave the cache empty.
+    //
+
+    if (Cache->Valid) {
+        YoriLibShFreeCmdContext(&Cache->CmdContext);
+        Cache->Valid = FALSE;
+    }
+
+    if (Cache->Text.LengthAllocated < CmdLine->LengthInChars) {
+        YoriLibFreeStringContents(&Cache->Text);
+        if (!YoriLibAllocateString(&Cache->Text, CmdLine->LengthInChars + 64)) {
+            memcpy(CmdContext, &NewCmdContext, sizeof(YORI_LIBSH_CMD_CONTEXT));
+            return TRUE;
+        }
+    }
+
+    memcpy(Cache->Text.StartOfString, CmdLine->StartOfString, CmdLine->LengthInChars * sizeof(TCHAR));
+    Cache->Text.LengthInChars = CmdLine->LengthInChars;
+    Cache->CurrentOffset = CurrentOffset;
+    memcpy(&Cache->CmdContext, &NewCmdContext, sizeof(YORI_LIBSH_CMD_CONTEXT));
+    Cache->Valid = TRUE;
+
+    return YoriShCopyParsedCmdContext(&Cache->CmdContext, CmdContext);
+}
+
+/**
+ Free any previous parse result.
+
+ @param Cache Pointer to the parse cache to free.
+ */
+VOID
+YoriShFreeParseCache(
+    __inout PYORI_SH_PARSE_CACHE Cache
+    )
+{
+    if (Cache->Valid) {
+        YoriLibShFreeCmdContext(&Cache->CmdContext);
+        Cache->Valid = FALSE;
+    }
+    YoriLibFreeStringContents(&Cache->Text);
+}
+
 // vim:sw=4:ts=4:et:
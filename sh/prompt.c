@@ -57,6 +57,757 @@ YoriShPromptIsAdmin(VOID)
     return YoriShPromptAdminPresent;
 }
 
+/**
+ The maximum amount of time, in milliseconds, that a command generating an
+ asynchronous prompt segment can run before it is terminated.
+ */
+#define YORI_SH_PROMPT_SEGMENT_TIMEOUT (10 * 1000)
+
+/**
+ The interval, in milliseconds, at which a thread generating an asynchronous
+ prompt segment checks for output, process termination and cancellation.
+ */
+#define YORI_SH_PROMPT_SEGMENT_POLL_INTERVAL (50)
+
+/**
+ The maximum number of bytes of output to capture from a command generating
+ an asynchronous prompt segment.  Any further output is discarded.
+ */
+#define YORI_SH_PROMPT_SEGMENT_MAX_OUTPUT (4096)
+
+/**
+ The maximum number of asynchronous prompt segment values to retain.  Values
+ are retained for each segment in each directory, and the least recently
+ used are discarded beyond this limit.
+ */
+#define YORI_SH_PROMPT_SEGMENT_MAX_CACHED (64)
+
+/**
+ A request to run a command in the background to generate the value of an
+ asynchronous prompt segment.  This is shared between the input thread and
+ the thread running the command, and is freed by whichever is the last to
+ finish with it.
+ */
+typedef struct _YORI_SH_PROMPT_SEGMENT_REQUEST {
+
+    /**
+     The number of parties (being the cache entry and the thread running the
+     command) that still refer to this request.
+     */
+    LONG ReferenceCount;
+
+    /**
+     Set to TRUE by the input thread to indicate that the result is no
+     longer needed and the command should be terminated.
+     */
+    BOOLEAN Cancelled;
+
+    /**
+     Set to TRUE by the thread running the command if the command completed
+     within the timeout and Output contains its result.
+     */
+    BOOLEAN Succeeded;
+
+    /**
+     Set to nonzero by the thread running the command once it has finished
+     with the request.  After this point the input thread owns Output.
+     */
+    LONG Complete;
+
+    /**
+     The NULL terminated command line to execute.
+     */
+    YORI_STRING CmdLine;
+
+    /**
+     The NULL terminated directory to execute the command in.
+     */
+    YORI_STRING Directory;
+
+    /**
+     On successful completion, the output of the command, with newlines
+     converted to spaces.
+     */
+    YORI_STRING Output;
+} YORI_SH_PROMPT_SEGMENT_REQUEST, *PYORI_SH_PROMPT_SEGMENT_REQUEST;
+
+/**
+ The cached value of an asynchronous prompt segment in a single directory.
+ */
+typedef struct _YORI_SH_PROMPT_SEGMENT {
+
+    /**
+     The link within the list of cached segments, ordered by most recent
+     use.
+     */
+    YORI_LIST_ENTRY ListEntry;
+
+    /**
+     The name of the segment, which is the name of the prompt variable
+     without the ASYNC_ prefix.
+     */
+    YORI_STRING Name;
+
+    /**
+     The directory that the value was generated in.
+     */
+    YORI_STRING Directory;
+
+    /**
+     The most recently generated value of the segment.
+     */
+    YORI_STRING Value;
+
+    /**
+     Pointer to a request that is currently generating a new value, or NULL
+     if no request is outstanding.
+     */
+    PYORI_SH_PROMPT_SEGMENT_REQUEST Request;
+} YORI_SH_PROMPT_SEGMENT, *PYORI_SH_PROMPT_SEGMENT;
+
+/**
+ Context passed when expanding variables in a prompt.
+ */
+typedef struct _YORI_SH_PROMPT_EXPAND_CONTEXT {
+
+    /**
+     If TRUE, asynchronous segments should start generating a new value.  If
+     FALSE, the cached value is used without generating a new one, which is
+     used when redisplaying a prompt because a value has changed.
+     */
+    BOOLEAN StartRequests;
+
+    /**
+     Set to TRUE if the prompt refers to any asynchronous segment.
+     */
+    BOOLEAN AsyncSegmentFound;
+} YORI_SH_PROMPT_EXPAND_CONTEXT, *PYORI_SH_PROMPT_EXPAND_CONTEXT;
+
+/**
+ A list of cached asynchronous prompt segment values, ordered by most recent
+ use.
+ */
+YORI_LIST_ENTRY YoriShPromptSegmentList;
+
+/**
+ The number of entries in YoriShPromptSegmentList.
+ */
+DWORD YoriShPromptSegmentCount;
+
+/**
+ An event which is signalled when a command generating an asynchronous prompt
+ segment completes.  This is created on first use and retained for the
+ lifetime of the process, since threads running commands may signal it at
+ any time.
+ */
+HANDLE YoriShPromptSegmentEvent;
+
+/**
+ The prompt expression after backquotes and environment variables have been
+ expanded.  This is retained if the prompt contains asynchronous segments so
+ the prompt can be redisplayed when they change without executing anything
+ again.
+ */
+YORI_STRING YoriShPromptExpression;
+
+/**
+ The location of the cursor before the prompt was displayed.
+ */
+COORD YoriShPromptStartPosition;
+
+/**
+ The location of the cursor after the prompt was displayed.
+ */
+COORD YoriShPromptEndPosition;
+
+/**
+ TRUE if YoriShPromptStartPosition and YoriShPromptEndPosition describe the
+ most recently displayed prompt, and that prompt can be redisplayed in place.
+ */
+BOOLEAN YoriShPromptPositionValid;
+
+/**
+ The status of the git repository containing the current directory, if
+ YoriShPromptGitStatusQueried is TRUE and YoriShPromptGitStatusFound is TRUE.
+ */
+YORI_LIB_GIT_STATUS YoriShPromptGitStatus;
+
+/**
+ Set to TRUE once the git status has been queried for the prompt being
+ displayed.
+ */
+BOOLEAN YoriShPromptGitStatusQueried;
+
+/**
+ Set to TRUE if the current directory is within a git repository and
+ YoriShPromptGitStatus describes it.
+ */
+BOOLEAN YoriShPromptGitStatusFound;
+
+/**
+ Return the status of the git repository containing the current directory.
+ This is queried once each time the prompt is displayed, and reused for each
+ variable in the prompt and when redisplaying it.
+
+ @return Pointer to the status, or NULL if the current directory is not in
+         a git repository.
+ */
+PYORI_LIB_GIT_STATUS
+YoriShGetPromptGitStatus(VOID)
+{
+    if (!YoriShPromptGitStatusQueried) {
+        YoriShPromptGitStatusQueried = TRUE;
+        YoriShPromptGitStatusFound = YoriLibGitGetStatus(&YoriShGlobal.CurrentDirectoryBuffers[YoriShGlobal.ActiveCurrentDirectory], &YoriShPromptGitStatus);
+    }
+
+    if (YoriShPromptGitStatusFound) {
+        return &YoriShPromptGitStatus;
+    }
+
+    return NULL;
+}
+
+/**
+ Discard the git status used by the previous prompt.
+ */
+VOID
+YoriShResetPromptGitStatus(VOID)
+{
+    if (YoriShPromptGitStatusFound) {
+        YoriLibGitFreeStatus(&YoriShPromptGitStatus);
+        YoriShPromptGitStatusFound = FALSE;
+    }
+    YoriShPromptGitStatusQueried = FALSE;
+}
+
+/**
+ Release a reference on an asynchronous prompt segment request.  When the
+ final reference is released, the request is freed.
+
+ @param Request Pointer to the request to dereference.
+ */
+VOID
+YoriShDereferencePromptSegmentRequest(
+    __in PYORI_SH_PROMPT_SEGMENT_REQUEST Request
+    )
+{
+    if (InterlockedDecrement(&Request->ReferenceCount) != 0) {
+        return;
+    }
+
+    YoriLibFreeStringContents(&Request->CmdLine);
+    YoriLibFreeStringContents(&Request->Directory);
+    YoriLibFreeStringContents(&Request->Output);
+    YoriLibFree(Request);
+}
+
+/**
+ Convert the output captured from a command into the value of a prompt
+ segment.  Trailing newlines are removed and any remaining newlines are
+ converted to spaces, matching the behavior of backquotes.
+
+ @param Request Pointer to the request whose Output should be populated.
+
+ @param Buffer Pointer to the output captured from the command.
+
+ @param BytesInBuffer The number of bytes in Buffer.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+YoriShPromptSegmentOutputToString(
+    __in PYORI_SH_PROMPT_SEGMENT_REQUEST Request,
+    __in_ecount(BytesInBuffer) LPCSTR Buffer,
+    __in YORI_ALLOC_SIZE_T BytesInBuffer
+    )
+{
+    YORI_ALLOC_SIZE_T CharsNeeded;
+    YORI_ALLOC_SIZE_T Index;
+
+    YoriLibInitEmptyString(&Request->Output);
+    if (BytesInBuffer == 0) {
+        return TRUE;
+    }
+
+    CharsNeeded = YoriLibGetMultibyteInputSizeNeeded(Buffer, BytesInBuffer);
+    if (!YoriLibAllocateString(&Request->Output, CharsNeeded + 1)) {
+        return FALSE;
+    }
+
+    YoriLibMultibyteInput(Buffer, BytesInBuffer, Request->Output.StartOfString, CharsNeeded);
+    Request->Output.LengthInChars = CharsNeeded;
+    YoriLibTrimTrailingNewlines(&Request->Output);
+
+    for (Index = 0; Index < Request->Output.LengthInChars; Index++) {
+        if (Request->Output.StartOfString[Index] == '\n' ||
+            Request->Output.StartOfString[Index] == '\r') {
+
+            Request->Output.StartOfString[Index] = ' ';
+        }
+    }
+
+    Request->Output.StartOfString[Request->Output.LengthInChars] = '\0';
+    return TRUE;
+}
+
+/**
+ The entrypoint for a background thread which runs a command to generate the
+ value of an asynchronous prompt segment.  The command is executed by a
+ subshell whose output is captured via a pipe.  Input and errors are
+ directed to NUL so the command cannot interfere with the console while the
+ user is entering a command.
+
+ @param Context Pointer to the request to process.
+
+ @return Zero.
+ */
+DWORD WINAPI
+YoriShPromptSegmentWorker(
+    __in PVOID Context
+    )
+{
+    PYORI_SH_PROMPT_SEGMENT_REQUEST Request;
+    SECURITY_ATTRIBUTES InheritableAttributes;
+    STARTUPINFO StartupInfo;
+    PROCESS_INFORMATION ProcessInfo;
+    HANDLE ReadHandle;
+    HANDLE WriteHandle;
+    HANDLE NulHandle;
+    LPTSTR Directory;
+    LPSTR Buffer;
+    CHAR DiscardBuffer[256];
+    YORI_ALLOC_SIZE_T BytesInBuffer;
+    DWORD BytesAvailable;
+    DWORD BytesToRead;
+    DWORD BytesRead;
+    DWORD StartTick;
+    BOOLEAN ProcessExited;
+
+    Request = (PYORI_SH_PROMPT_SEGMENT_REQUEST)Context;
+    ReadHandle = NULL;
+    WriteHandle = NULL;
+    NulHandle = INVALID_HANDLE_VALUE;
+    ZeroMemory(&ProcessInfo, sizeof(ProcessInfo));
+
+    Buffer = YoriLibMalloc(YORI_SH_PROMPT_SEGMENT_MAX_OUTPUT);
+    if (Buffer == NULL) {
+        goto Exit;
+    }
+
+    InheritableAttributes.nLength = sizeof(InheritableAttributes);
+    InheritableAttributes.lpSecurityDescriptor = NULL;
+    InheritableAttributes.bInheritHandle = TRUE;
+
+    NulHandle = CreateFile(_T("NUL"),
+                           GENERIC_READ | GENERIC_WRITE,
+                           FILE_SHARE_READ | FILE_SHARE_WRITE,
+                           &InheritableAttributes,
+                           OPEN_EXISTING,
+                           0,
+                           NULL);
+    if (NulHandle == INVALID_HANDLE_VALUE) {
+        goto Exit;
+    }
+
+    if (!CreatePipe(&ReadHandle, &WriteHandle, NULL, 0)) {
+        ReadHandle = NULL;
+        WriteHandle = NULL;
+        goto Exit;
+    }
+
+    if (!YoriLibMakeInheritableHandle(WriteHandle, &WriteHandle)) {
+        goto Exit;
+    }
+
+    ZeroMemory(&StartupInfo, sizeof(StartupInfo));
+    StartupInfo.cb = sizeof(StartupInfo);
+    StartupInfo.dwFlags = STARTF_USESTDHANDLES;
+    StartupInfo.hStdInput = NulHandle;
+    StartupInfo.hStdOutput = WriteHandle;
+    StartupInfo.hStdError = NulHandle;
+
+    Directory = NULL;
+    if (Request->Directory.LengthInChars > 0) {
+        Directory = Request->Directory.StartOfString;
+    }
+
+    if (!CreateProcess(NULL,
+                       Request->CmdLine.StartOfString,
+                       NULL,
+                       NULL,
+                       TRUE,
+                       CREATE_NEW_PROCESS_GROUP | CREATE_DEFAULT_ERROR_MODE,
+                       NULL,
+                       Directory,
+                       &StartupInfo,
+                       &ProcessInfo)) {
+
+        ZeroMemory(&ProcessInfo, sizeof(ProcessInfo));
+        goto Exit;
+    }
+
+    CloseHandle(WriteHandle);
+    WriteHandle = NULL;
+
+    //
+    //  Read output as it becomes available.  Once the process has exited,
+    //  read anything that remains in the pipe.  Output beyond the size of
+    //  the buffer is still read so the process is not blocked writing it,
+    //  but it is discarded.
+    //
+
+    BytesInBuffer = 0;
+    ProcessExited = FALSE;
+#if defined(_MSC_VER) && (_MSC_VER >= 1700)
+#pragma warning(suppress: 28159) // Deprecated GetTickCount; overflows are
+                                 // deterministic
+#endif
+    StartTick = GetTickCount();
+
+    while (TRUE) {
+        BytesAvailable = 0;
+        if (!PeekNamedPipe(ReadHandle, NULL, 0, NULL, &BytesAvailable, NULL)) {
+            BytesAvailable = 0;
+        }
+
+        if (BytesAvailable > 0) {
+            if (BytesInBuffer < YORI_SH_PROMPT_SEGMENT_MAX_OUTPUT) {
+                BytesToRead = YORI_SH_PROMPT_SEGMENT_MAX_OUTPUT - BytesInBuffer;
+                if (BytesToRead > BytesAvailable) {
+                    BytesToRead = BytesAvailable;
+                }
+                if (!ReadFile(ReadHandle, &Buffer[BytesInBuffer], BytesToRead, &BytesRead, NULL)) {
+                    break;
+                }
+                BytesInBuffer = BytesInBuffer + (YORI_ALLOC_SIZE_T)BytesRead;
+            } else {
+                BytesToRead = sizeof(DiscardBuffer);
+                if (BytesToRead > BytesAvailable) {
+                    BytesToRead = BytesAvailable;
+                }
+                if (!ReadFile(ReadHandle, DiscardBuffer, BytesToRead, &BytesRead, NULL)) {
+                    break;
+                }
+            }
+            continue;
+        }
+
+        if (ProcessExited) {
+            Request->Succeeded = TRUE;
+            break;
+        }
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1700)
+#pragma warning(suppress: 28159) // Deprecated GetTickCount; overflows are
+                                 // deterministic
+#endif
+        if (Request->Cancelled ||
+            GetTickCount() - StartTick > YORI_SH_PROMPT_SEGMENT_TIMEOUT) {
+
+            TerminateProcess(ProcessInfo.hProcess, EXIT_FAILURE);
+            break;
+        }
+
+        if (WaitForSingleObject(ProcessInfo.hProcess, YORI_SH_PROMPT_SEGMENT_POLL_INTERVAL) == WAIT_OBJECT_0) {
+            ProcessExited = TRUE;
+        }
+    }
+
+    if (Request->Succeeded) {
+        if (!YoriShPromptSegmentOutputToString(Request, Buffer, BytesInBuffer)) {
+            Request->Succeeded = FALSE;
+        }
+    }
+
+Exit:
+
+    if (ProcessInfo.hProcess != NULL) {
+        CloseHandle(ProcessInfo.hProcess);
+        CloseHandle(ProcessInfo.hThread);
+    }
+    if (ReadHandle != NULL) {
+        CloseHandle(ReadHandle);
+    }
+    if (WriteHandle != NULL) {
+        CloseHandle(WriteHandle);
+    }
+    if (NulHandle != INVALID_HANDLE_VALUE) {
+        CloseHandle(NulHandle);
+    }
+    if (Buffer != NULL) {
+        YoriLibFree(Buffer);
+    }
+
+    InterlockedExchange(&Request->Complete, TRUE);
+    SetEvent(YoriShPromptSegmentEvent);
+    YoriShDereferencePromptSegmentRequest(Request);
+    return 0;
+}
+
+/**
+ Start a background thread to generate a new value for an asynchronous
+ prompt segment.  The command to execute is found in the environment
+ variable YORIASYNC_ followed by the segment name.  If no such variable is
+ defined, the segment is left empty.
+
+ @param Segment Pointer to the segment to generate a new value for.
+ */
+VOID
+YoriShStartPromptSegmentRequest(
+    __inout PYORI_SH_PROMPT_SEGMENT Segment
+    )
+{
+    PYORI_SH_PROMPT_SEGMENT_REQUEST Request;
+    YORI_STRING VariableName;
+    YORI_STRING Command;
+    YORI_STRING PathToYori;
+    HANDLE ThreadHandle;
+    DWORD ThreadId;
+
+    ASSERT(Segment->Request == NULL);
+
+    if (YoriShPromptSegmentEvent == NULL) {
+        YoriShPromptSegmentEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+        if (YoriShPromptSegmentEvent == NULL) {
+            return;
+        }
+    }
+
+    YoriLibInitEmptyString(&VariableName);
+    if (YoriLibYPrintf(&VariableName, _T("YORIASYNC_%y"), &Segment->Name) < 0) {
+        return;
+    }
+
+    if (!YoriShAllocateAndGetEnvironmentVariable(VariableName.StartOfString, &Command, NULL)) {
+        YoriLibFreeStringContents(&VariableName);
+        return;
+    }
+    YoriLibFreeStringContents(&VariableName);
+
+    if (Command.LengthInChars == 0) {
+        YoriLibFreeStringContents(&Command);
+        YoriLibFreeStringContents(&Segment->Value);
+        return;
+    }
+
+    if (!YoriShAllocateAndGetEnvironmentVariable(_T("YORISPEC"), &PathToYori, NULL)) {
+        YoriLibFreeStringContents(&Command);
+        return;
+    }
+
+    Request = YoriLibMalloc(sizeof(YORI_SH_PROMPT_SEGMENT_REQUEST));
+    if (Request == NULL) {
+        YoriLibFreeStringContents(&PathToYori);
+        YoriLibFreeStringContents(&Command);
+        return;
+    }
+
+    ZeroMemory(Request, sizeof(YORI_SH_PROMPT_SEGMENT_REQUEST));
+    Request->ReferenceCount = 1;
+
+    if (PathToYori.LengthInChars == 0 ||
+        YoriLibYPrintf(&Request->CmdLine, _T("\"%y\" /ss %y"), &PathToYori, &Command) < 0 ||
+        !YoriLibCopyString(&Request->Directory, &Segment->Directory)) {
+
+        YoriLibFreeStringContents(&PathToYori);
+        YoriLibFreeStringContents(&Command);
+        YoriShDereferencePromptSegmentRequest(Request);
+        return;
+    }
+
+    YoriLibFreeStringContents(&PathToYori);
+    YoriLibFreeStringContents(&Command);
+
+    Request->ReferenceCount = 2;
+    ThreadHandle = CreateThread(NULL, 0, YoriShPromptSegmentWorker, Request, 0, &ThreadId);
+    if (ThreadHandle == NULL) {
+        Request->ReferenceCount = 1;
+        YoriShDereferencePromptSegmentRequest(Request);
+        return;
+    }
+
+    CloseHandle(ThreadHandle);
+    Segment->Request = Request;
+}
+
+/**
+ Free a cached asynchronous prompt segment.  If a request is outstanding to
+ generate a new value, it is cancelled.
+
+ @param Segment Pointer to the segment to free.
+ */
+VOID
+YoriShFreePromptSegment(
+    __in PYORI_SH_PROMPT_SEGMENT Segment
+    )
+{
+    YoriLibRemoveListItem(&Segment->ListEntry);
+    YoriShPromptSegmentCount--;
+
+    if (Segment->Request != NULL) {
+        Segment->Request->Cancelled = TRUE;
+        YoriShDereferencePromptSegmentRequest(Segment->Request);
+    }
+
+    YoriLibFreeStringContents(&Segment->Name);
+    YoriLibFreeStringContents(&Segment->Directory);
+    YoriLibFreeStringContents(&Segment->Value);
+    YoriLibFree(Segment);
+}
+
+/**
+ Find the cached value of an asynchronous prompt segment in the current
+ directory, creating a new empty value if none exists.
+
+ @param Name Pointer to the name of the segment.
+
+ @return Pointer to the segment, or NULL on allocation failure.
+ */
+PYORI_SH_PROMPT_SEGMENT
+YoriShFindPromptSegment(
+    __in PYORI_STRING Name
+    )
+{
+    PYORI_STRING CurrentDirectory;
+    PYORI_LIST_ENTRY ListEntry;
+    PYORI_SH_PROMPT_SEGMENT Segment;
+
+    if (YoriShPromptSegmentList.Next == NULL) {
+        YoriLibInitializeListHead(&YoriShPromptSegmentList);
+    }
+
+    CurrentDirectory = &YoriShGlobal.CurrentDirectoryBuffers[YoriShGlobal.ActiveCurrentDirectory];
+
+    ListEntry = YoriLibGetNextListEntry(&YoriShPromptSegmentList, NULL);
+    while (ListEntry != NULL) {
+        Segment = CONTAINING_RECORD(ListEntry, YORI_SH_PROMPT_SEGMENT, ListEntry);
+        if (YoriLibCompareStringIns(&Segment->Name, Name) == 0 &&
+            YoriLibCompareStringIns(&Segment->Directory, CurrentDirectory) == 0) {
+
+            YoriLibRemoveListItem(&Segment->ListEntry);
+            YoriLibInsertList(&YoriShPromptSegmentList, &Segment->ListEntry);
+            return Segment;
+        }
+        ListEntry = YoriLibGetNextListEntry(&YoriShPromptSegmentList, ListEntry);
+    }
+
+    Segment = YoriLibMalloc(sizeof(YORI_SH_PROMPT_SEGMENT));
+    if (Segment == NULL) {
+        return NULL;
+    }
+
+    ZeroMemory(Segment, sizeof(YORI_SH_PROMPT_SEGMENT));
+    if (!YoriLibCopyString(&Segment->Name, Name)) {
+        YoriLibFree(Segment);
+        return NULL;
+    }
+
+    if (!YoriLibCopyString(&Segment->Directory, CurrentDirectory)) {
+        YoriLibFreeStringContents(&Segment->Name);
+        YoriLibFree(Segment);
+        return NULL;
+    }
+
+    YoriLibInsertList(&YoriShPromptSegmentList, &Segment->ListEntry);
+    YoriShPromptSegmentCount++;
+
+    while (YoriShPromptSegmentCount > YORI_SH_PROMPT_SEGMENT_MAX_CACHED) {
+        ListEntry = YoriLibGetPreviousListEntry(&YoriShPromptSegmentList, NULL);
+        YoriShFreePromptSegment(CONTAINING_RECORD(ListEntry, YORI_SH_PROMPT_SEGMENT, ListEntry));
+    }
+
+    return Segment;
+}
+
+/**
+ Collect the results of any asynchronous prompt segments whose commands have
+ completed.
+
+ @return TRUE if the value of a segment in the current directory has
+         changed, indicating the prompt should be redisplayed.
+ */
+BOOLEAN
+YoriShCollectPromptSegments(VOID)
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PYORI_SH_PROMPT_SEGMENT Segment;
+    PYORI_SH_PROMPT_SEGMENT_REQUEST Request;
+    PYORI_STRING CurrentDirectory;
+    BOOLEAN Changed;
+
+    Changed = FALSE;
+    if (YoriShPromptSegmentList.Next == NULL) {
+        return Changed;
+    }
+
+    CurrentDirectory = &YoriShGlobal.CurrentDirectoryBuffers[YoriShGlobal.ActiveCurrentDirectory];
+
+    ListEntry = YoriLibGetNextListEntry(&YoriShPromptSegmentList, NULL);
+    while (ListEntry != NULL) {
+        Segment = CONTAINING_RECORD(ListEntry, YORI_SH_PROMPT_SEGMENT, ListEntry);
+        ListEntry = YoriLibGetNextListEntry(&YoriShPromptSegmentList, ListEntry);
+
+        Request = Segment->Request;
+        if (Request == NULL || !Request->Complete) {
+            continue;
+        }
+
+        if (Request->Succeeded &&
+            YoriLibCompareString(&Segment->Value, &Request->Output) != 0) {
+
+            YoriLibFreeStringContents(&Segment->Value);
+            memcpy(&Segment->Value, &Request->Output, sizeof(YORI_STRING));
+            YoriLibInitEmptyString(&Request->Output);
+
+            if (YoriLibCompareStringIns(&Segment->Directory, CurrentDirectory) == 0) {
+                Changed = TRUE;
+            }
+        }
+
+        Segment->Request = NULL;
+        YoriShDereferencePromptSegmentRequest(Request);
+    }
+
+    return Changed;
+}
+
+/**
+ Return the event which is signalled when a command generating an
+ asynchronous prompt segment completes.
+
+ @return The event handle, or NULL if no asynchronous segment has been used.
+ */
+HANDLE
+YoriShGetPromptSegmentEvent(VOID)
+{
+    return YoriShPromptSegmentEvent;
+}
+
+/**
+ Free all cached asynchronous prompt segments, cancelling any outstanding
+ requests, along with state retained to redisplay the prompt.
+ */
+VOID
+YoriShCleanupPromptSegments(VOID)
+{
+    PYORI_LIST_ENTRY ListEntry;
+
+    YoriLibFreeStringContents(&YoriShPromptExpression);
+    YoriShPromptPositionValid = FALSE;
+    YoriShResetPromptGitStatus();
+
+    if (YoriShPromptSegmentList.Next == NULL) {
+        return;
+    }
+
+    ListEntry = YoriLibGetNextListEntry(&YoriShPromptSegmentList, NULL);
+    while (ListEntry != NULL) {
+        YoriShFreePromptSegment(CONTAINING_RECORD(ListEntry, YORI_SH_PROMPT_SEGMENT, ListEntry));
+        ListEntry = YoriLibGetNextListEntry(&YoriShPromptSegmentList, NULL);
+    }
+}
+
 /**
  Expand variables in a prompt environment variable to form a displayable
  string.
@@ -65,7 +816,8 @@ YoriShPromptIsAdmin(VOID)
 
  @param VariableName The name of the variable that requires expansion.
 
- @param Context Ignored.
+ @param Context Pointer to a YORI_SH_PROMPT_EXPAND_CONTEXT describing how
+        asynchronous segments should be expanded.
 
  @return The number of characters populated or the number of characters
          required if the buffer is too small.
@@ -78,8 +830,9 @@ YoriShExpandPrompt(
     )
 {
     YORI_ALLOC_SIZE_T CharsNeeded = 0;
+    PYORI_SH_PROMPT_EXPAND_CONTEXT ExpandContext;
 
-    UNREFERENCED_PARAMETER(Context);
+    ExpandContext = (PYORI_SH_PROMPT_EXPAND_CONTEXT)Context;
 
     if (YoriLibCompareStringLitIns(VariableName, _T("A")) == 0) {
         CharsNeeded = 1;
@@ -120,6 +873,41 @@ YoriShExpandPrompt(
                 OutputString->StartOfString[0] = '>';
             }
         }
+    } else if (YoriLibCompareStringLitIns(VariableName, _T("GIT_BRANCH")) == 0) {
+        PYORI_LIB_GIT_STATUS GitStatus;
+        GitStatus = YoriShGetPromptGitStatus();
+        if (GitStatus != NULL) {
+            CharsNeeded = GitStatus->Branch.LengthInChars;
+            if (OutputString->LengthAllocated >= CharsNeeded) {
+                memcpy(OutputString->StartOfString, GitStatus->Branch.StartOfString, CharsNeeded * sizeof(TCHAR));
+            }
+        }
+    } else if (YoriLibCompareStringLitIns(VariableName, _T("GIT_MODIFIED")) == 0) {
+        PYORI_LIB_GIT_STATUS GitStatus;
+        GitStatus = YoriShGetPromptGitStatus();
+        if (GitStatus != NULL && GitStatus->Modified) {
+            CharsNeeded = 1;
+            if (OutputString->LengthAllocated > CharsNeeded) {
+                OutputString->StartOfString[0] = '*';
+            }
+        }
+    } else if (YoriLibCompareStringLitIns(VariableName, _T("GIT_UPSTREAM")) == 0) {
+        PYORI_LIB_GIT_STATUS GitStatus;
+        GitStatus = YoriShGetPromptGitStatus();
+        if (GitStatus != NULL && (GitStatus->ValidFields & YORI_LIB_GIT_STATUS_UPSTREAM) != 0) {
+            if (GitStatus->UpstreamMatches) {
+                CharsNeeded = 1;
+                if (OutputString->LengthAllocated > CharsNeeded) {
+                    OutputString->StartOfString[0] = '=';
+                }
+            } else {
+                CharsNeeded = 2;
+                if (OutputString->LengthAllocated > CharsNeeded) {
+                    OutputString->StartOfString[0] = '<';
+                    OutputString->StartOfString[1] = '>';
+                }
+            }
+        }
     } else if (YoriLibCompareStringLitIns(VariableName, _T("L")) == 0) {
         CharsNeeded = 1;
         if (OutputString->LengthAllocated > CharsNeeded) {
@@ -166,6 +954,34 @@ YoriShExpandPrompt(
                 OutputString->StartOfString[Index] = '+';
             }
         }
+    } else if (VariableName->LengthInChars > sizeof("ASYNC_") - 1 &&
+               YoriLibCompareStringLitInsCnt(VariableName, _T("ASYNC_"), sizeof("ASYNC_") - 1) == 0) {
+
+        YORI_STRING SegmentName;
+        PYORI_SH_PROMPT_SEGMENT Segment;
+
+        //
+        //  Display the most recent value of the segment for this directory
+        //  immediately, and if a new value is not already being generated,
+        //  start generating one.  When it completes the prompt is
+        //  redisplayed with the new value.
+        //
+
+        YoriLibInitEmptyString(&SegmentName);
+        SegmentName.StartOfString = &VariableName->StartOfString[sizeof("ASYNC_") - 1];
+        SegmentName.LengthInChars = VariableName->LengthInChars - (sizeof("ASYNC_") - 1);
+
+        ExpandContext->AsyncSegmentFound = TRUE;
+        Segment = YoriShFindPromptSegment(&SegmentName);
+        if (Segment != NULL) {
+            CharsNeeded = Segment->Value.LengthInChars;
+            if (OutputString->LengthAllocated >= CharsNeeded) {
+                memcpy(OutputString->StartOfString, Segment->Value.StartOfString, CharsNeeded * sizeof(TCHAR));
+            }
+            if (ExpandContext->StartRequests && Segment->Request == NULL) {
+                YoriShStartPromptSegmentRequest(Segment);
+            }
+        }
     }
 
     return CharsNeeded;
@@ -185,7 +1001,27 @@ YoriShDisplayPrompt(VOID)
     YORI_STRING PromptAfterEnvExpansion;
     YORI_STRING DisplayString;
     PYORI_STRING StringToUse;
+    YORI_SH_PROMPT_EXPAND_CONTEXT ExpandContext;
+    CONSOLE_SCREEN_BUFFER_INFO ScreenInfo;
+    HANDLE ConsoleHandle;
     DWORD SavedErrorLevel = YoriShGlobal.ErrorLevel;
+    DWORDLONG StartTime;
+
+    StartTime = 0;
+    if (YoriLibEtwIsEnabled(YORI_LIB_ETW_KEYWORD_PROMPT)) {
+        StartTime = YoriLibEtwGetTimestamp();
+    }
+
+    //
+    //  Pick up any asynchronous segment values that completed while the
+    //  previous command was executing, and forget the previous prompt.
+    //
+
+    YoriShCollectPromptSegments();
+    YoriLibFreeStringContents(&YoriShPromptExpression);
+    YoriShPromptPositionValid = FALSE;
+    YoriShResetPromptGitStatus();
+    ConsoleHandle = GetStdHandle(STD_OUTPUT_HANDLE);
 
     //
     //  Don't update taskbar UI while executing processes executed as part of
@@ -291,14 +1127,39 @@ YoriShDisplayPrompt(VOID)
         //  Expand any prompt command variables.
         //
 
-        YoriLibExpandCommandVariables(StringToUse, '$', FALSE, YoriShExpandPrompt, NULL, &DisplayString);
+        ExpandContext.StartRequests = TRUE;
+        ExpandContext.AsyncSegmentFound = FALSE;
+        YoriLibExpandCommandVariables(StringToUse, '$', FALSE, YoriShExpandPrompt, &ExpandContext, &DisplayString);
 
         //
-        //  Display the result.
+        //  If the prompt contains asynchronous segments, keep the expression
+        //  so it can be redisplayed when they complete.
+        //
+
+        if (ExpandContext.AsyncSegmentFound) {
+            if (!YoriLibCopyString(&YoriShPromptExpression, StringToUse)) {
+                YoriLibInitEmptyString(&YoriShPromptExpression);
+            }
+        }
+
+        //
+        //  Display the result.  If it may need to be redisplayed, record
+        //  where it was displayed.
         //
 
         if (DisplayString.StartOfString != NULL) {
-            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y"), &DisplayString);
+            if (YoriShPromptExpression.LengthInChars > 0 &&
+                GetConsoleScreenBufferInfo(ConsoleHandle, &ScreenInfo)) {
+
+                YoriShPromptStartPosition = ScreenInfo.dwCursorPosition;
+                YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y"), &DisplayString);
+                if (GetConsoleScreenBufferInfo(ConsoleHandle, &ScreenInfo)) {
+                    YoriShPromptEndPosition = ScreenInfo.dwCursorPosition;
+                    YoriShPromptPositionValid = TRUE;
+                }
+            } else {
+                YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y"), &DisplayString);
+            }
             YoriLibFreeStringContents(&DisplayString);
         }
 
@@ -397,7 +1258,9 @@ YoriShDisplayPrompt(VOID)
         //  Expand any prompt command variables.
         //
 
-        YoriLibExpandCommandVariables(StringToUse, '$', FALSE, YoriShExpandPrompt, NULL, &DisplayString);
+        ExpandContext.StartRequests = TRUE;
+        ExpandContext.AsyncSegmentFound = FALSE;
+        YoriLibExpandCommandVariables(StringToUse, '$', FALSE, YoriShExpandPrompt, &ExpandContext, &DisplayString);
 
         //
         //  Display the result.
@@ -429,6 +1292,94 @@ YoriShDisplayPrompt(VOID)
 
     YoriShGlobal.ErrorLevel = SavedErrorLevel;
 
+    if (StartTime != 0) {
+        YoriLibEtwWriteEvent(YORI_LIB_ETW_KEYWORD_PROMPT, "PromptDisplay", NULL, NULL, "DurationUs", YoriLibEtwGetTimestamp() - StartTime, NULL, 0);
+    }
+
+    return TRUE;
+}
+
+/**
+ Redisplay the most recently displayed prompt at the current cursor location
+ using the current values of any asynchronous segments.  This is used after
+ an asynchronous segment has completed while the user is entering a command.
+ Nothing is executed; the prompt expression is the one previously expanded
+ for backquotes and environment variables.
+
+ @return TRUE to indicate the prompt was redisplayed, FALSE if it was not.
+ */
+__success(return)
+BOOL
+YoriShRedisplayPrompt(VOID)
+{
+    YORI_SH_PROMPT_EXPAND_CONTEXT ExpandContext;
+    YORI_STRING DisplayString;
+    CONSOLE_SCREEN_BUFFER_INFO ScreenInfo;
+    HANDLE ConsoleHandle;
+
+    if (!YoriShPromptPositionValid ||
+        YoriShPromptExpression.LengthInChars == 0) {
+
+        return FALSE;
+    }
+
+    YoriShPromptPositionValid = FALSE;
+    ConsoleHandle = GetStdHandle(STD_OUTPUT_HANDLE);
+    if (!GetConsoleScreenBufferInfo(ConsoleHandle, &ScreenInfo)) {
+        return FALSE;
+    }
+
+    YoriLibInitEmptyString(&DisplayString);
+    ExpandContext.StartRequests = FALSE;
+    ExpandContext.AsyncSegmentFound = FALSE;
+    YoriLibExpandCommandVariables(&YoriShPromptExpression, '$', FALSE, YoriShExpandPrompt, &ExpandContext, &DisplayString);
+    if (DisplayString.StartOfString == NULL) {
+        return FALSE;
+    }
+
+    YoriShPromptStartPosition = ScreenInfo.dwCursorPosition;
+    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y"), &DisplayString);
+    YoriLibFreeStringContents(&DisplayString);
+
+    if (YoriLibEtwIsEnabled(YORI_LIB_ETW_KEYWORD_PROMPT)) {
+        YoriLibEtwWriteEvent(YORI_LIB_ETW_KEYWORD_PROMPT, "PromptRedisplay", NULL, NULL, NULL, 0, NULL, 0);
+    }
+
+    if (GetConsoleScreenBufferInfo(ConsoleHandle, &ScreenInfo)) {
+        YoriShPromptEndPosition = ScreenInfo.dwCursorPosition;
+        YoriShPromptPositionValid = TRUE;
+    }
+
+    return TRUE;
+}
+
+/**
+ Return the location on the console where the most recent prompt was
+ displayed, if that prompt contains asynchronous segments and can be
+ redisplayed.
+
+ @param StartPosition On successful completion, updated to contain the
+        location of the beginning of the prompt.
+
+ @param EndPosition On successful completion, updated to contain the
+        location of the end of the prompt, being where input begins.
+
+ @return TRUE to indicate the prompt can be redisplayed and the positions
+         were returned, FALSE if not.
+ */
+__success(return)
+BOOLEAN
+YoriShGetPromptPosition(
+    __out PCOORD StartPosition,
+    __out PCOORD EndPosition
+    )
+{
+    if (!YoriShPromptPositionValid) {
+        return FALSE;
+    }
+
+    *StartPosition = YoriShPromptStartPosition;
+    *EndPosition = YoriShPromptEndPosition;
     return TRUE;
 }
 
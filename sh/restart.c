@@ -212,6 +212,793 @@ YoriShCleanupStaleRestartStates(VOID)
 }
 
 
+/**
+ The signature at the start of a binary restart file, which is "YRST".
+ */
+#define YORI_SH_RESTART_SIGNATURE 0x54535259
+
+/**
+ The version of the binary restart file format.  This should be incremented
+ if the layout of the file changes so an older file is not misinterpreted.
+ */
+#define YORI_SH_RESTART_VERSION 1
+
+/**
+ Indicates that the window position in a restart state is valid.
+ */
+#define YORI_SH_RESTART_WINDOW_POSITION_VALID (0x00000001)
+
+/**
+ Indicates that the font information in a restart state is valid.
+ */
+#define YORI_SH_RESTART_FONT_VALID            (0x00000002)
+
+/**
+ Fixed size information describing the console window.  This is written
+ verbatim into a binary restart file.
+ */
+typedef struct _YORI_SH_RESTART_WINDOW {
+
+    /**
+     A combination of YORI_SH_RESTART_ flags indicating which optional fields
+     are valid.
+     */
+    DWORD Flags;
+
+    /**
+     The width of the console screen buffer, in characters.
+     */
+    WORD BufferWidth;
+
+    /**
+     The height of the console screen buffer, in characters.
+     */
+    WORD BufferHeight;
+
+    /**
+     The width of the visible console window, in characters.
+     */
+    WORD WindowWidth;
+
+    /**
+     The height of the visible console window, in characters.
+     */
+    WORD WindowHeight;
+
+    /**
+     The default color of the console.
+     */
+    WORD DefaultColor;
+
+    /**
+     The color of popups in the console.
+     */
+    WORD PopupColor;
+
+    /**
+     The RGB values of each console color.
+     */
+    DWORD ColorTable[16];
+
+    /**
+     The horizontal position of the console window, in pixels.
+     */
+    LONG WindowLeft;
+
+    /**
+     The vertical position of the console window, in pixels.
+     */
+    LONG WindowTop;
+
+    /**
+     The index of the console font.
+     */
+    DWORD FontIndex;
+
+    /**
+     The width of each character in the console font.
+     */
+    WORD FontWidth;
+
+    /**
+     The height of each character in the console font.
+     */
+    WORD FontHeight;
+
+    /**
+     The family of the console font.
+     */
+    DWORD FontFamily;
+
+    /**
+     The weight of the console font.
+     */
+    DWORD FontWeight;
+
+    /**
+     The NULL terminated name of the console font.
+     */
+    WCHAR FaceName[LF_FACESIZE];
+} YORI_SH_RESTART_WINDOW, *PYORI_SH_RESTART_WINDOW;
+
+/**
+ Describes a range of a binary restart file containing a sequence of NULL
+ terminated strings.
+ */
+typedef struct _YORI_SH_RESTART_BLOCK {
+
+    /**
+     The offset from the start of the file to the first character, in bytes.
+     */
+    DWORD Offset;
+
+    /**
+     The number of characters in the range, including NULL terminators.
+     */
+    DWORD LengthInChars;
+} YORI_SH_RESTART_BLOCK, *PYORI_SH_RESTART_BLOCK;
+
+/**
+ The header at the start of a binary restart file.  The string data that
+ the header refers to follows it in the file.
+ */
+typedef struct _YORI_SH_RESTART_HEADER {
+
+    /**
+     Set to YORI_SH_RESTART_SIGNATURE.
+     */
+    DWORD Signature;
+
+    /**
+     Set to YORI_SH_RESTART_VERSION.
+     */
+    DWORD Version;
+
+    /**
+     The size of the entire file in bytes.  This allows a file that was only
+     partially written to be detected and ignored.
+     */
+    DWORD FileSize;
+
+    /**
+     The size of a character in the string data, in bytes.
+     */
+    DWORD CharSize;
+
+    /**
+     Information describing the console window.
+     */
+    YORI_SH_RESTART_WINDOW Window;
+
+    /**
+     The console window title.
+     */
+    YORI_SH_RESTART_BLOCK Title;
+
+    /**
+     The current directory.
+     */
+    YORI_SH_RESTART_BLOCK CurrentDirectory;
+
+    /**
+     Environment variable names, each followed by its value.
+     */
+    YORI_SH_RESTART_BLOCK Environment;
+
+    /**
+     Alias names, each followed by its value.
+     */
+    YORI_SH_RESTART_BLOCK Aliases;
+
+    /**
+     History entries, oldest first.
+     */
+    YORI_SH_RESTART_BLOCK History;
+
+    /**
+     The name of the file containing the console window contents.
+     */
+    YORI_SH_RESTART_BLOCK ContentsFileName;
+} YORI_SH_RESTART_HEADER, *PYORI_SH_RESTART_HEADER;
+
+/**
+ The state of the shell that is saved and restored across a restart.
+ */
+typedef struct _YORI_SH_RESTART_STATE {
+
+    /**
+     Information describing the console window.
+     */
+    YORI_SH_RESTART_WINDOW Window;
+
+    /**
+     The console window title.  This string is NULL terminated.
+     */
+    YORI_STRING Title;
+
+    /**
+     The current directory.  This string is NULL terminated.
+     */
+    YORI_STRING CurrentDirectory;
+
+    /**
+     A sequence of NULL terminated strings consisting of an environment
+     variable name followed by its value.  Current directories for other
+     drives are included as names in the form "=C:".
+     */
+    YORI_STRING Environment;
+
+    /**
+     A sequence of NULL terminated strings consisting of an alias name
+     followed by its value.
+     */
+    YORI_STRING Aliases;
+
+    /**
+     A sequence of NULL terminated history entries, oldest first.
+     */
+    YORI_STRING History;
+
+    /**
+     The name of the file containing the console window contents.  This
+     string is NULL terminated, and is empty if no contents were saved.
+     */
+    YORI_STRING ContentsFileName;
+} YORI_SH_RESTART_STATE, *PYORI_SH_RESTART_STATE;
+
+/**
+ Initialize a restart state so that it contains no information.
+
+ @param State Pointer to the restart state to initialize.
+ */
+VOID
+YoriShInitRestartState(
+    __out PYORI_SH_RESTART_STATE State
+    )
+{
+    ZeroMemory(&State->Window, sizeof(State->Window));
+    YoriLibInitEmptyString(&State->Title);
+    YoriLibInitEmptyString(&State->CurrentDirectory);
+    YoriLibInitEmptyString(&State->Environment);
+    YoriLibInitEmptyString(&State->Aliases);
+    YoriLibInitEmptyString(&State->History);
+    YoriLibInitEmptyString(&State->ContentsFileName);
+}
+
+/**
+ Free any allocations within a restart state.
+
+ @param State Pointer to the restart state to free.
+ */
+VOID
+YoriShFreeRestartState(
+    __inout PYORI_SH_RESTART_STATE State
+    )
+{
+    YoriLibFreeStringContents(&State->Title);
+    YoriLibFreeStringContents(&State->CurrentDirectory);
+    YoriLibFreeStringContents(&State->Environment);
+    YoriLibFreeStringContents(&State->Aliases);
+    YoriLibFreeStringContents(&State->History);
+    YoriLibFreeStringContents(&State->ContentsFileName);
+}
+
+/**
+ Return the number of characters in a set of NULL terminated strings that
+ is terminated by an additional NULL, including all terminators.
+
+ @param Strings Pointer to the set of strings.
+
+ @return The number of characters, including all terminators.
+ */
+YORI_ALLOC_SIZE_T
+YoriShRestartMultiStringLength(
+    __in LPTSTR Strings
+    )
+{
+    YORI_ALLOC_SIZE_T Index;
+
+    Index = 0;
+    while (Strings[Index] != '\0') {
+        Index = Index + (YORI_ALLOC_SIZE_T)_tcslen(&Strings[Index]) + 1;
+    }
+    return Index + 1;
+}
+
+/**
+ Append a NULL terminated string to a sequence of strings.  The caller is
+ expected to have allocated sufficient space.
+
+ @param Target Pointer to the sequence of strings to append to.
+
+ @param String Pointer to the characters to append.
+
+ @param LengthInChars The number of characters to append, not including a
+        NULL terminator.
+ */
+VOID
+YoriShRestartAppendString(
+    __inout PYORI_STRING Target,
+    __in LPCTSTR String,
+    __in YORI_ALLOC_SIZE_T LengthInChars
+    )
+{
+    ASSERT(Target->LengthInChars + LengthInChars < Target->LengthAllocated);
+    memcpy(&Target->StartOfString[Target->LengthInChars], String, LengthInChars * sizeof(TCHAR));
+    Target->LengthInChars = Target->LengthInChars + LengthInChars;
+    Target->StartOfString[Target->LengthInChars] = '\0';
+    Target->LengthInChars++;
+}
+
+/**
+ Append a set of strings in "Name=Value" form to a sequence of strings as
+ a name followed by a value.  Entries whose name starts with '=' are skipped
+ unless they describe the current directory of a drive.
+
+ @param Target Pointer to the sequence of strings to append to.  The caller
+        is expected to have allocated sufficient space.
+
+ @param Source Pointer to a set of NULL terminated strings, terminated by an
+        additional NULL.
+ */
+VOID
+YoriShRestartAppendPairs(
+    __inout PYORI_STRING Target,
+    __in LPTSTR Source
+    )
+{
+    LPTSTR ThisPair;
+    LPTSTR ThisVar;
+    LPTSTR ThisValue;
+
+    ThisPair = Source;
+    while (*ThisPair != '\0') {
+        ThisVar = ThisPair;
+        ThisPair += _tcslen(ThisPair) + 1;
+
+        if (ThisVar[0] == '=') {
+            if (((ThisVar[1] >= 'A' && ThisVar[1] <= 'Z') ||
+                 (ThisVar[1] >= 'a' && ThisVar[1] <= 'z')) &&
+                ThisVar[2] == ':' &&
+                ThisVar[3] == '=') {
+
+                ThisValue = &ThisVar[3];
+            } else {
+                continue;
+            }
+        } else {
+            ThisValue = _tcschr(ThisVar, '=');
+            if (ThisValue == NULL) {
+                continue;
+            }
+        }
+
+        YoriShRestartAppendString(Target, ThisVar, (YORI_ALLOC_SIZE_T)(ThisValue - ThisVar));
+        ThisValue++;
+        YoriShRestartAppendString(Target, ThisValue, (YORI_ALLOC_SIZE_T)_tcslen(ThisValue));
+    }
+}
+
+/**
+ Return the next string from a sequence of NULL terminated strings.
+
+ @param Strings Pointer to the sequence of strings.
+
+ @param Offset On input, the offset in characters of the next string to
+        return.  On successful completion, updated to the offset of the
+        string following it.
+
+ @param String On successful completion, updated to refer to the next
+        string.  This string is NULL terminated.
+
+ @return TRUE to indicate a string was returned, FALSE to indicate no more
+         strings remain.
+ */
+__success(return)
+BOOLEAN
+YoriShRestartGetNextString(
+    __in PCYORI_STRING Strings,
+    __inout PYORI_ALLOC_SIZE_T Offset,
+    __out PYORI_STRING String
+    )
+{
+    YORI_ALLOC_SIZE_T Index;
+
+    for (Index = *Offset; Index < Strings->LengthInChars; Index++) {
+        if (Strings->StartOfString[Index] == '\0') {
+            YoriLibInitEmptyString(String);
+            String->StartOfString = &Strings->StartOfString[*Offset];
+            String->LengthInChars = Index - *Offset;
+            *Offset = Index + 1;
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+/**
+ Query the current state of the shell and console in preparation for saving
+ it.
+
+ @param State On successful completion, populated with the current state.
+        The caller should free this with @ref YoriShFreeRestartState.
+
+ @param ScreenBufferInfo Pointer to information about the console screen
+        buffer.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriShCaptureRestartState(
+    __out PYORI_SH_RESTART_STATE State,
+    __in PYORI_CONSOLE_SCREEN_BUFFER_INFOEX ScreenBufferInfo
+    )
+{
+    YORI_CONSOLE_FONT_INFOEX FontInfo;
+    YORI_STRING Env;
+    YORI_ALLOC_SIZE_T Count;
+
+    YoriShInitRestartState(State);
+
+    State->Window.BufferWidth = (WORD)ScreenBufferInfo->dwSize.X;
+    State->Window.BufferHeight = (WORD)ScreenBufferInfo->dwSize.Y;
+    State->Window.WindowWidth = (WORD)(ScreenBufferInfo->srWindow.Right - ScreenBufferInfo->srWindow.Left + 1);
+    State->Window.WindowHeight = (WORD)(ScreenBufferInfo->srWindow.Bottom - ScreenBufferInfo->srWindow.Top + 1);
+    State->Window.DefaultColor = YoriLibVtGetDefaultColor();
+    State->Window.PopupColor = ScreenBufferInfo->wPopupAttributes;
+
+    for (Count = 0; Count < sizeof(State->Window.ColorTable)/sizeof(State->Window.ColorTable[0]); Count++) {
+        State->Window.ColorTable[Count] = ScreenBufferInfo->ColorTable[Count];
+    }
+
+    //
+    //  Query window position.  Note this is not trying to save the window
+    //  size (in GUI terms) since the window size can be determined by font
+    //  and console size instead.
+    //
+
+    if (DllUser32.pGetWindowRect != NULL) {
+        RECT WindowRect;
+
+        if (DllUser32.pGetWindowRect(DllKernel32.pGetConsoleWindow(), &WindowRect)) {
+            State->Window.WindowLeft = WindowRect.left;
+            State->Window.WindowTop = WindowRect.top;
+            State->Window.Flags = State->Window.Flags | YORI_SH_RESTART_WINDOW_POSITION_VALID;
+        }
+    }
+
+    //
+    //  Query window font information.
+    //
+
+    ZeroMemory(&FontInfo, sizeof(FontInfo));
+    FontInfo.cbSize = sizeof(FontInfo);
+    if (DllKernel32.pGetCurrentConsoleFontEx(GetStdHandle(STD_OUTPUT_HANDLE), FALSE, &FontInfo)) {
+        State->Window.FontIndex = FontInfo.nFont;
+        State->Window.FontWidth = (WORD)FontInfo.dwFontSize.X;
+        State->Window.FontHeight = (WORD)FontInfo.dwFontSize.Y;
+        State->Window.FontFamily = FontInfo.FontFamily;
+        State->Window.FontWeight = FontInfo.FontWeight;
+        memcpy(State->Window.FaceName, FontInfo.FaceName, sizeof(State->Window.FaceName));
+        State->Window.FaceName[LF_FACESIZE - 1] = '\0';
+        State->Window.Flags = State->Window.Flags | YORI_SH_RESTART_FONT_VALID;
+    }
+
+    //
+    //  Query the window title.  Apparently GetConsoleTitle can't tell us how
+    //  much memory it needs.
+    //
+
+    if (!YoriLibAllocateString(&State->Title, 4096)) {
+        return FALSE;
+    }
+
+    State->Title.LengthInChars = (YORI_ALLOC_SIZE_T)GetConsoleTitle(State->Title.StartOfString, State->Title.LengthAllocated - 1);
+    if (State->Title.LengthInChars == 0) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("Error getting window title: %i\n"), GetLastError());
+    }
+    State->Title.StartOfString[State->Title.LengthInChars] = '\0';
+
+    //
+    //  Query the current directory.
+    //
+
+    if (!YoriLibGetCurrentDirectory(&State->CurrentDirectory)) {
+        YoriShFreeRestartState(State);
+        return FALSE;
+    }
+
+    //
+    //  Query the environment.  This includes the current directories on
+    //  other drives.
+    //
+
+    if (YoriLibGetEnvironmentStrings(&Env)) {
+        if (YoriLibAllocateString(&State->Environment, YoriShRestartMultiStringLength(Env.StartOfString))) {
+            YoriShRestartAppendPairs(&State->Environment, Env.StartOfString);
+        }
+        YoriLibFreeStringContents(&Env);
+    }
+
+    //
+    //  Query user defined aliases.
+    //
+
+    YoriLibInitEmptyString(&Env);
+    if (YoriShGetAliasStrings(YORI_SH_GET_ALIAS_STRINGS_INCLUDE_USER, &Env)) {
+        if (YoriLibAllocateString(&State->Aliases, YoriShRestartMultiStringLength(Env.StartOfString))) {
+            YoriShRestartAppendPairs(&State->Aliases, Env.StartOfString);
+        }
+        YoriLibFreeStringContents(&Env);
+    }
+
+    //
+    //  Query history.
+    //
+
+    YoriLibInitEmptyString(&Env);
+    if (YoriShGetHistoryStrings(100, &Env)) {
+        if (YoriLibAllocateString(&State->History, YoriShRestartMultiStringLength(Env.StartOfString))) {
+            LPTSTR ThisValue;
+            YORI_ALLOC_SIZE_T ValueLength;
+
+            ThisValue = Env.StartOfString;
+            while (*ThisValue != '\0') {
+                ValueLength = (YORI_ALLOC_SIZE_T)_tcslen(ThisValue);
+                YoriShRestartAppendString(&State->History, ThisValue, ValueLength);
+                ThisValue += ValueLength + 1;
+            }
+        }
+        YoriLibFreeStringContents(&Env);
+    }
+
+    return TRUE;
+}
+
+/**
+ Copy a sequence of characters into a binary restart file buffer and
+ describe its location in the header.
+
+ @param Buffer Pointer to the start of the buffer.
+
+ @param Offset On input, the offset in bytes to copy the characters to.  On
+        completion, updated to point after the copied characters.
+
+ @param Block On completion, updated to describe the location of the
+        characters.
+
+ @param String Pointer to the characters to copy.
+
+ @param AddTerminator If TRUE, a NULL terminator is written after the
+        characters.
+ */
+VOID
+YoriShRestartPackBlock(
+    __in PUCHAR Buffer,
+    __inout PDWORD Offset,
+    __out PYORI_SH_RESTART_BLOCK Block,
+    __in PCYORI_STRING String,
+    __in BOOLEAN AddTerminator
+    )
+{
+    Block->Offset = *Offset;
+    Block->LengthInChars = String->LengthInChars;
+    if (String->LengthInChars > 0) {
+        memcpy(Buffer + *Offset, String->StartOfString, String->LengthInChars * sizeof(TCHAR));
+    }
+    if (AddTerminator) {
+        ((LPTSTR)(Buffer + *Offset))[String->LengthInChars] = '\0';
+        Block->LengthInChars++;
+    }
+    *Offset = *Offset + Block->LengthInChars * sizeof(TCHAR);
+}
+
+/**
+ Save a restart state into a binary restart file.  The file is constructed
+ in memory and written in a single operation.
+
+ @param State Pointer to the restart state to save.
+
+ @param FileName Pointer to the name of the file to write.  This string is
+        NULL terminated.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriShSaveRestartStateBinary(
+    __in PYORI_SH_RESTART_STATE State,
+    __in PYORI_STRING FileName
+    )
+{
+    PYORI_SH_RESTART_HEADER Header;
+    PUCHAR Buffer;
+    DWORD BufferSize;
+    DWORD Offset;
+    DWORD BytesWritten;
+    HANDLE hFile;
+    BOOL Result;
+
+    BufferSize = sizeof(YORI_SH_RESTART_HEADER);
+    BufferSize = BufferSize + (State->Title.LengthInChars + 1) * sizeof(TCHAR);
+    BufferSize = BufferSize + (State->CurrentDirectory.LengthInChars + 1) * sizeof(TCHAR);
+    BufferSize = BufferSize + State->Environment.LengthInChars * sizeof(TCHAR);
+    BufferSize = BufferSize + State->Aliases.LengthInChars * sizeof(TCHAR);
+    BufferSize = BufferSize + State->History.LengthInChars * sizeof(TCHAR);
+    BufferSize = BufferSize + (State->ContentsFileName.LengthInChars + 1) * sizeof(TCHAR);
+
+    Buffer = YoriLibMalloc(BufferSize);
+    if (Buffer == NULL) {
+        return FALSE;
+    }
+
+    Header = (PYORI_SH_RESTART_HEADER)Buffer;
+    ZeroMemory(Header, sizeof(YORI_SH_RESTART_HEADER));
+    Header->Signature = YORI_SH_RESTART_SIGNATURE;
+    Header->Version = YORI_SH_RESTART_VERSION;
+    Header->FileSize = BufferSize;
+    Header->CharSize = sizeof(TCHAR);
+    memcpy(&Header->Window, &State->Window, sizeof(YORI_SH_RESTART_WINDOW));
+
+    Offset = sizeof(YORI_SH_RESTART_HEADER);
+    YoriShRestartPackBlock(Buffer, &Offset, &Header->Title, &State->Title, TRUE);
+    YoriShRestartPackBlock(Buffer, &Offset, &Header->CurrentDirectory, &State->CurrentDirectory, TRUE);
+    YoriShRestartPackBlock(Buffer, &Offset, &Header->Environment, &State->Environment, FALSE);
+    YoriShRestartPackBlock(Buffer, &Offset, &Header->Aliases, &State->Aliases, FALSE);
+    YoriShRestartPackBlock(Buffer, &Offset, &Header->History, &State->History, FALSE);
+    YoriShRestartPackBlock(Buffer, &Offset, &Header->ContentsFileName, &State->ContentsFileName, TRUE);
+    ASSERT(Offset == BufferSize);
+
+    hFile = CreateFile(FileName->StartOfString,
+                       GENERIC_WRITE,
+                       FILE_SHARE_READ | FILE_SHARE_DELETE,
+                       NULL,
+                       CREATE_ALWAYS,
+                       FILE_ATTRIBUTE_NORMAL,
+                       NULL);
+
+    if (hFile == INVALID_HANDLE_VALUE) {
+        YoriLibFree(Buffer);
+        return FALSE;
+    }
+
+    Result = WriteFile(hFile, Buffer, BufferSize, &BytesWritten, NULL);
+    if (Result && BytesWritten != BufferSize) {
+        Result = FALSE;
+    }
+
+    CloseHandle(hFile);
+    YoriLibFree(Buffer);
+
+    if (!Result) {
+        DeleteFile(FileName->StartOfString);
+    }
+
+    return Result;
+}
+
+/**
+ Save a restart state into an INI file.  This is used if the binary restart
+ file cannot be written.
+
+ @param State Pointer to the restart state to save.
+
+ @param FileName Pointer to the name of the file to write.  This string is
+        NULL terminated.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriShSaveRestartStateIni(
+    __in PYORI_SH_RESTART_STATE State,
+    __in PYORI_STRING FileName
+    )
+{
+    TCHAR WriteBuffer[32];
+    YORI_STRING ThisVar;
+    YORI_STRING ThisValue;
+    YORI_ALLOC_SIZE_T Offset;
+    YORI_ALLOC_SIZE_T Count;
+
+    if (DllKernel32.pWritePrivateProfileStringW == NULL) {
+        return FALSE;
+    }
+
+    YoriLibSPrintf(WriteBuffer, _T("%i"), State->Window.BufferWidth);
+    DllKernel32.pWritePrivateProfileStringW(_T("Window"), _T("BufferWidth"), WriteBuffer, FileName->StartOfString);
+    YoriLibSPrintf(WriteBuffer, _T("%i"), State->Window.BufferHeight);
+    DllKernel32.pWritePrivateProfileStringW(_T("Window"), _T("BufferHeight"), WriteBuffer, FileName->StartOfString);
+    YoriLibSPrintf(WriteBuffer, _T("%i"), State->Window.WindowWidth);
+    DllKernel32.pWritePrivateProfileStringW(_T("Window"), _T("WindowWidth"), WriteBuffer, FileName->StartOfString);
+    YoriLibSPrintf(WriteBuffer, _T("%i"), State->Window.WindowHeight);
+    DllKernel32.pWritePrivateProfileStringW(_T("Window"), _T("WindowHeight"), WriteBuffer, FileName->StartOfString);
+
+    YoriLibSPrintf(WriteBuffer, _T("%i"), State->Window.DefaultColor);
+    DllKernel32.pWritePrivateProfileStringW(_T("Window"), _T("DefaultColor"), WriteBuffer, FileName->StartOfString);
+    YoriLibSPrintf(WriteBuffer, _T("%i"), State->Window.PopupColor);
+    DllKernel32.pWritePrivateProfileStringW(_T("Window"), _T("PopupColor"), WriteBuffer, FileName->StartOfString);
+
+    for (Count = 0; Count < sizeof(State->Window.ColorTable)/sizeof(State->Window.ColorTable[0]); Count++) {
+        TCHAR ColorName[32];
+        YoriLibSPrintf(ColorName, _T("Color%i"), Count);
+        YoriLibSPrintf(WriteBuffer, _T("%i"), State->Window.ColorTable[Count]);
+        DllKernel32.pWritePrivateProfileStringW(_T("Window"), ColorName, WriteBuffer, FileName->StartOfString);
+    }
+
+    if (State->Window.Flags & YORI_SH_RESTART_WINDOW_POSITION_VALID) {
+        YoriLibSPrintf(WriteBuffer, _T("%i"), State->Window.WindowLeft);
+        DllKernel32.pWritePrivateProfileStringW(_T("Window"), _T("WindowLeft"), WriteBuffer, FileName->StartOfString);
+        YoriLibSPrintf(WriteBuffer, _T("%i"), State->Window.WindowTop);
+        DllKernel32.pWritePrivateProfileStringW(_T("Window"), _T("WindowTop"), WriteBuffer, FileName->StartOfString);
+    }
+
+    if (State->Title.LengthInChars > 0) {
+        DllKernel32.pWritePrivateProfileStringW(_T("Window"), _T("Title"), State->Title.StartOfString, FileName->StartOfString);
+    }
+
+    if (State->Window.Flags & YORI_SH_RESTART_FONT_VALID) {
+        YoriLibSPrintf(WriteBuffer, _T("%i"), State->Window.FontIndex);
+        DllKernel32.pWritePrivateProfileStringW(_T("Window"), _T("FontIndex"), WriteBuffer, FileName->StartOfString);
+        YoriLibSPrintf(WriteBuffer, _T("%i"), State->Window.FontWidth);
+        DllKernel32.pWritePrivateProfileStringW(_T("Window"), _T("FontWidth"), WriteBuffer, FileName->StartOfString);
+        YoriLibSPrintf(WriteBuffer, _T("%i"), State->Window.FontHeight);
+        DllKernel32.pWritePrivateProfileStringW(_T("Window"), _T("FontHeight"), WriteBuffer, FileName->StartOfString);
+        YoriLibSPrintf(WriteBuffer, _T("%i"), State->Window.FontFamily);
+        DllKernel32.pWritePrivateProfileStringW(_T("Window"), _T("FontFamily"), WriteBuffer, FileName->StartOfString);
+        YoriLibSPrintf(WriteBuffer, _T("%i"), State->Window.FontWeight);
+        DllKernel32.pWritePrivateProfileStringW(_T("Window"), _T("FontWeight"), WriteBuffer, FileName->StartOfString);
+        DllKernel32.pWritePrivateProfileStringW(_T("Window"), _T("FontName"), State->Window.FaceName, FileName->StartOfString);
+    }
+
+    DllKernel32.pWritePrivateProfileStringW(_T("Window"), _T("CurrentDirectory"), State->CurrentDirectory.StartOfString, FileName->StartOfString);
+
+    //
+    //  Current directories on other drives are inexpressible in the INI
+    //  format as regular entries, so they get their own section, without
+    //  the leading '='.
+    //
+
+    Offset = 0;
+    while (YoriShRestartGetNextString(&State->Environment, &Offset, &ThisVar) &&
+           YoriShRestartGetNextString(&State->Environment, &Offset, &ThisValue)) {
+
+        if (ThisVar.StartOfString[0] == '=') {
+            DllKernel32.pWritePrivateProfileStringW(_T("CurrentDirectories"), &ThisVar.StartOfString[1], ThisValue.StartOfString, FileName->StartOfString);
+        } else {
+            DllKernel32.pWritePrivateProfileStringW(_T("Environment"), ThisVar.StartOfString, ThisValue.StartOfString, FileName->StartOfString);
+        }
+    }
+
+    Offset = 0;
+    while (YoriShRestartGetNextString(&State->Aliases, &Offset, &ThisVar) &&
+           YoriShRestartGetNextString(&State->Aliases, &Offset, &ThisValue)) {
+
+        DllKernel32.pWritePrivateProfileStringW(_T("Aliases"), ThisVar.StartOfString, ThisValue.StartOfString, FileName->StartOfString);
+    }
+
+    //
+    //  History only needs values but sort order needs to be maintained, so
+    //  use a zero prefixed count as a key.
+    //
+
+    Offset = 0;
+    Count = 1;
+    while (YoriShRestartGetNextString(&State->History, &Offset, &ThisValue)) {
+        YoriLibSPrintf(WriteBuffer, _T("%03i"), Count);
+        DllKernel32.pWritePrivateProfileStringW(_T("History"), WriteBuffer, ThisValue.StartOfString, FileName->StartOfString);
+        Count++;
+    }
+
+    if (State->ContentsFileName.LengthInChars > 0) {
+        DllKernel32.pWritePrivateProfileStringW(_T("Window"), _T("Contents"), State->ContentsFileName.StartOfString, FileName->StartOfString);
+    }
+
+    return TRUE;
+}
+
 /**
  Try to save the current state of the process so that it can be recovered
  from this state after a subsequent unexpected termination.
@@ -224,13 +1011,12 @@ YoriShSaveRestartStateWorker(
     )
 {
     YORI_CONSOLE_SCREEN_BUFFER_INFOEX ScreenBufferInfo;
-    YORI_CONSOLE_FONT_INFOEX FontInfo;
-
-    YORI_STRING WriteBuffer;
+    YORI_SH_RESTART_STATE State;
     YORI_STRING RestartFileName;
     YORI_STRING RestartBufferFileName;
-    YORI_STRING Env;
+    TCHAR CommandLine[32];
     LPTSTR Comma;
+    LPTSTR FileNameSuffix;
     YORI_ALLOC_SIZE_T Count;
     DWORD LineCount;
 
@@ -246,8 +1032,7 @@ YoriShSaveRestartStateWorker(
     if (DllKernel32.pRegisterApplicationRestart == NULL ||
         DllKernel32.pGetConsoleScreenBufferInfoEx == NULL ||
         DllKernel32.pGetCurrentConsoleFontEx == NULL ||
-        DllKernel32.pGetConsoleWindow == NULL ||
-        DllKernel32.pWritePrivateProfileStringW == NULL) {
+        DllKernel32.pGetConsoleWindow == NULL) {
 
         return 0;
     }
@@ -311,7 +1096,8 @@ YoriShSaveRestartStateWorker(
     YoriLibFreeStringContents(&RestartFileName);
 
     //
-    //  Query console window size and state, and save it.
+    //  Query console window size and state, and everything else that
+    //  should be saved.
     //
 
     ZeroMemory(&ScreenBufferInfo, sizeof(ScreenBufferInfo));
@@ -321,206 +1107,15 @@ YoriShSaveRestartStateWorker(
         return 0;
     }
 
-    if (!YoriLibGetTempPath(&RestartFileName, sizeof("\\yori-restart-.ini") + 2 * sizeof(DWORD))) {
+    if (!YoriShCaptureRestartState(&State, &ScreenBufferInfo)) {
         return 0;
     }
 
-    YoriLibSPrintf(RestartFileName.StartOfString + RestartFileName.LengthInChars,
-                   _T("\\yori-restart-%x.ini"),
-                   GetCurrentProcessId());
-
-    if (!YoriLibAllocateString(&WriteBuffer, 32 * 1024)) {
-        YoriLibFreeStringContents(&RestartFileName);
+    if (!YoriLibGetTempPath(&RestartFileName, sizeof("\\yori-restart-.ini") + 2 * sizeof(DWORD))) {
+        YoriShFreeRestartState(&State);
         return 0;
     }
 
-    YoriLibSPrintf(WriteBuffer.StartOfString, _T("%i"), ScreenBufferInfo.dwSize.X);
-    DllKernel32.pWritePrivateProfileStringW(_T("Window"), _T("BufferWidth"), WriteBuffer.StartOfString, RestartFileName.StartOfString);
-    YoriLibSPrintf(WriteBuffer.StartOfString, _T("%i"), ScreenBufferInfo.dwSize.Y);
-    DllKernel32.pWritePrivateProfileStringW(_T("Window"), _T("BufferHeight"), WriteBuffer.StartOfString, RestartFileName.StartOfString);
-    YoriLibSPrintf(WriteBuffer.StartOfString, _T("%i"), ScreenBufferInfo.srWindow.Right - ScreenBufferInfo.srWindow.Left + 1);
-    DllKernel32.pWritePrivateProfileStringW(_T("Window"), _T("WindowWidth"), WriteBuffer.StartOfString, RestartFileName.StartOfString);
-    YoriLibSPrintf(WriteBuffer.StartOfString, _T("%i"), ScreenBufferInfo.srWindow.Bottom - ScreenBufferInfo.srWindow.Top + 1);
-    DllKernel32.pWritePrivateProfileStringW(_T("Window"), _T("WindowHeight"), WriteBuffer.StartOfString, RestartFileName.StartOfString);
-
-    YoriLibSPrintf(WriteBuffer.StartOfString, _T("%i"), YoriLibVtGetDefaultColor());
-    DllKernel32.pWritePrivateProfileStringW(_T("Window"), _T("DefaultColor"), WriteBuffer.StartOfString, RestartFileName.StartOfString);
-    YoriLibSPrintf(WriteBuffer.StartOfString, _T("%i"), ScreenBufferInfo.wPopupAttributes);
-    DllKernel32.pWritePrivateProfileStringW(_T("Window"), _T("PopupColor"), WriteBuffer.StartOfString, RestartFileName.StartOfString);
-
-    for (Count = 0; Count < sizeof(ScreenBufferInfo.ColorTable)/sizeof(ScreenBufferInfo.ColorTable[0]); Count++) {
-        TCHAR ColorName[32];
-        YoriLibSPrintf(ColorName, _T("Color%i"), Count);
-        YoriLibSPrintf(WriteBuffer.StartOfString, _T("%i"), ScreenBufferInfo.ColorTable[Count]);
-        DllKernel32.pWritePrivateProfileStringW(_T("Window"), ColorName, WriteBuffer.StartOfString, RestartFileName.StartOfString);
-    }
-
-    //
-    //  Query window position and save it.  Note this is not trying to save
-    //  the window size (in GUI terms) since the window size can be determined
-    //  by font and console size instead.
-    //
-
-    if (DllUser32.pGetWindowRect != NULL) {
-        RECT WindowRect;
-
-        if (DllUser32.pGetWindowRect(DllKernel32.pGetConsoleWindow(), &WindowRect)) {
-            YoriLibSPrintf(WriteBuffer.StartOfString, _T("%i"), WindowRect.left);
-            DllKernel32.pWritePrivateProfileStringW(_T("Window"), _T("WindowLeft"), WriteBuffer.StartOfString, RestartFileName.StartOfString);
-            YoriLibSPrintf(WriteBuffer.StartOfString, _T("%i"), WindowRect.top);
-            DllKernel32.pWritePrivateProfileStringW(_T("Window"), _T("WindowTop"), WriteBuffer.StartOfString, RestartFileName.StartOfString);
-        }
-    }
-
-    //
-    //  Query the window title and save it.
-    //
-
-    WriteBuffer.LengthInChars = (YORI_ALLOC_SIZE_T)GetConsoleTitle(WriteBuffer.StartOfString, 4095);
-    if (WriteBuffer.LengthInChars > 0) {
-        DllKernel32.pWritePrivateProfileStringW(_T("Window"), _T("Title"), WriteBuffer.StartOfString, RestartFileName.StartOfString);
-    } else {
-        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("Error getting window title: %i\n"), GetLastError());
-    }
-
-    //
-    //  Query window font information and save it.
-    //
-
-    ZeroMemory(&FontInfo, sizeof(FontInfo));
-    FontInfo.cbSize = sizeof(FontInfo);
-    if (DllKernel32.pGetCurrentConsoleFontEx(GetStdHandle(STD_OUTPUT_HANDLE), FALSE, &FontInfo)) {
-        YoriLibSPrintf(WriteBuffer.StartOfString, _T("%i"), FontInfo.nFont);
-        DllKernel32.pWritePrivateProfileStringW(_T("Window"), _T("FontIndex"), WriteBuffer.StartOfString, RestartFileName.StartOfString);
-        YoriLibSPrintf(WriteBuffer.StartOfString, _T("%i"), FontInfo.dwFontSize.X);
-        DllKernel32.pWritePrivateProfileStringW(_T("Window"), _T("FontWidth"), WriteBuffer.StartOfString, RestartFileName.StartOfString);
-        YoriLibSPrintf(WriteBuffer.StartOfString, _T("%i"), FontInfo.dwFontSize.Y);
-        DllKernel32.pWritePrivateProfileStringW(_T("Window"), _T("FontHeight"), WriteBuffer.StartOfString, RestartFileName.StartOfString);
-        YoriLibSPrintf(WriteBuffer.StartOfString, _T("%i"), FontInfo.FontFamily);
-        DllKernel32.pWritePrivateProfileStringW(_T("Window"), _T("FontFamily"), WriteBuffer.StartOfString, RestartFileName.StartOfString);
-        YoriLibSPrintf(WriteBuffer.StartOfString, _T("%i"), FontInfo.FontWeight);
-        DllKernel32.pWritePrivateProfileStringW(_T("Window"), _T("FontWeight"), WriteBuffer.StartOfString, RestartFileName.StartOfString);
-        DllKernel32.pWritePrivateProfileStringW(_T("Window"), _T("FontName"), FontInfo.FaceName, RestartFileName.StartOfString);
-    }
-
-    //
-    //  Query the current directory and save it.
-    //
-
-    WriteBuffer.LengthInChars = (YORI_ALLOC_SIZE_T)GetCurrentDirectory(WriteBuffer.LengthAllocated, WriteBuffer.StartOfString);
-    if (WriteBuffer.LengthInChars > 0 && WriteBuffer.LengthInChars < WriteBuffer.LengthAllocated) {
-        DllKernel32.pWritePrivateProfileStringW(_T("Window"), _T("CurrentDirectory"), WriteBuffer.StartOfString, RestartFileName.StartOfString);
-    }
-
-    //
-    //  Write the current environment
-    //
-
-    if (YoriLibGetEnvironmentStrings(&Env)) {
-        LPTSTR ThisPair;
-        LPTSTR ThisVar;
-        LPTSTR ThisValue;
-
-        ThisPair = Env.StartOfString;
-        while (*ThisPair != '\0') {
-            ThisVar = ThisPair;
-            ThisPair += _tcslen(ThisPair) + 1;
-
-            if (ThisVar[0] != '=') {
-                ThisValue = _tcschr(ThisVar, '=');
-                if (ThisValue) {
-                    ThisValue[0] = '\0';
-                    ThisValue++;
-
-                    DllKernel32.pWritePrivateProfileStringW(_T("Environment"), ThisVar, ThisValue, RestartFileName.StartOfString);
-
-                    ThisValue--;
-                    ThisValue[0] = '=';
-                }
-            }
-        }
-
-        //
-        //  With the "regular" environment done, go through and write a new
-        //  section for current directories on alternate drives.  These are
-        //  part of the environment but inexpressible in the INI format as
-        //  regular entries, so they get their own section.
-        //
-
-        ThisPair = Env.StartOfString;
-        while (*ThisPair != '\0') {
-            ThisVar = ThisPair;
-            ThisPair += _tcslen(ThisPair) + 1;
-
-            if (ThisVar[0] == '=' &&
-                ((ThisVar[1] >= 'A' && ThisVar[1] <= 'Z') ||
-                 (ThisVar[1] >= 'a' && ThisVar[1] <= 'z')) &&
-                ThisVar[2] == ':' &&
-                ThisVar[3] == '=') {
-
-                ThisValue = &ThisVar[3];
-                ThisVar++;
-                ThisValue[0] = '\0';
-                ThisValue++;
-
-                DllKernel32.pWritePrivateProfileStringW(_T("CurrentDirectories"), ThisVar, ThisValue, RestartFileName.StartOfString);
-
-                ThisValue--;
-                ThisValue[0] = '=';
-            }
-        }
-
-        YoriLibFreeStringContents(&Env);
-    }
-
-    //
-    //  Write the current aliases
-    //
-
-    YoriLibInitEmptyString(&Env);
-    if (YoriShGetAliasStrings(YORI_SH_GET_ALIAS_STRINGS_INCLUDE_USER, &Env)) {
-        LPTSTR ThisPair;
-        LPTSTR ThisVar;
-        LPTSTR ThisValue;
-
-        ThisPair = Env.StartOfString;
-        while (*ThisPair != '\0') {
-            ThisVar = ThisPair;
-            ThisPair += _tcslen(ThisPair) + 1;
-            if (ThisVar[0] != '=') {
-                ThisValue = _tcschr(ThisVar, '=');
-                if (ThisValue) {
-                    ThisValue[0] = '\0';
-                    ThisValue++;
-
-                    DllKernel32.pWritePrivateProfileStringW(_T("Aliases"), ThisVar, ThisValue, RestartFileName.StartOfString);
-                }
-            }
-        }
-
-        YoriLibFreeStringContents(&Env);
-    }
-
-    //
-    //  Write history.  We only care about values here but want to maintain
-    //  sort order, so zero prefix count to use as a key.
-    //
-
-    if (YoriShGetHistoryStrings(100, &Env)) {
-        LPTSTR ThisValue;
-
-        ThisValue = Env.StartOfString;
-        Count = 1;
-        while (*ThisValue != '\0') {
-            YoriLibSPrintf(WriteBuffer.StartOfString, _T("%03i"), Count);
-            DllKernel32.pWritePrivateProfileStringW(_T("History"), WriteBuffer.StartOfString, ThisValue, RestartFileName.StartOfString);
-            ThisValue += _tcslen(ThisValue) + 1;
-            Count++;
-        }
-
-        YoriLibFreeStringContents(&Env);
-    }
-
     //
     //  Write the window contents
     //
@@ -531,9 +1126,10 @@ YoriShSaveRestartStateWorker(
 
         memcpy(RestartBufferFileName.StartOfString, RestartFileName.StartOfString, RestartFileName.LengthInChars * sizeof(TCHAR));
         RestartBufferFileName.LengthInChars = RestartFileName.LengthInChars;
-        YoriLibSPrintf(RestartBufferFileName.StartOfString + RestartBufferFileName.LengthInChars,
-                       _T("\\yori-restart-%x.txt"),
-                       GetCurrentProcessId());
+        RestartBufferFileName.LengthInChars = RestartBufferFileName.LengthInChars + (YORI_ALLOC_SIZE_T)
+            YoriLibSPrintf(RestartBufferFileName.StartOfString + RestartBufferFileName.LengthInChars,
+                           _T("\\yori-restart-%x.txt"),
+                           GetCurrentProcessId());
 
         hBufferFile = CreateFile(RestartBufferFileName.StartOfString,
                                  GENERIC_WRITE,
@@ -545,26 +1141,41 @@ YoriShSaveRestartStateWorker(
 
         if (hBufferFile != INVALID_HANDLE_VALUE) {
             YoriLibRewriteConsoleContents(hBufferFile, LineCount, 0);
-            DllKernel32.pWritePrivateProfileStringW(_T("Window"), _T("Contents"), RestartBufferFileName.StartOfString, RestartFileName.StartOfString);
             CloseHandle(hBufferFile);
+            memcpy(&State.ContentsFileName, &RestartBufferFileName, sizeof(YORI_STRING));
+        } else {
+            YoriLibFreeStringContents(&RestartBufferFileName);
         }
+    }
+
+    //
+    //  Write everything else.  The binary format is written in a single
+    //  operation; if that fails, fall back to the INI format.
+    //
 
-        YoriLibFreeStringContents(&RestartBufferFileName);
+    FileNameSuffix = RestartFileName.StartOfString + RestartFileName.LengthInChars;
+    RestartFileName.LengthInChars = RestartFileName.LengthInChars + (YORI_ALLOC_SIZE_T)
+        YoriLibSPrintf(FileNameSuffix, _T("\\yori-restart-%x.bin"), GetCurrentProcessId());
+
+    if (!YoriShSaveRestartStateBinary(&State, &RestartFileName)) {
+        YoriLibSPrintf(FileNameSuffix, _T("\\yori-restart-%x.ini"), GetCurrentProcessId());
+        YoriShSaveRestartStateIni(&State, &RestartFileName);
     }
 
+    YoriShFreeRestartState(&State);
+
     //
     //  Register the process to be restarted on failure
     //
 
     if (!YoriShProcessRegisteredForRestart) {
-        YoriLibSPrintf(WriteBuffer.StartOfString, _T("-restart %x"), GetCurrentProcessId());
+        YoriLibSPrintf(CommandLine, _T("-restart %x"), GetCurrentProcessId());
 
-        DllKernel32.pRegisterApplicationRestart(WriteBuffer.StartOfString, 0);
+        DllKernel32.pRegisterApplicationRestart(CommandLine, 0);
         YoriShProcessRegisteredForRestart = TRUE;
     }
 
     YoriLibFreeStringContents(&RestartFileName);
-    YoriLibFreeStringContents(&WriteBuffer);
 
     YoriShCleanupStaleRestartStates();
 
@@ -604,191 +1215,406 @@ YoriShSaveRestartState(VOID)
     return TRUE;
 }
 
-/**
- Check if a restart thread has been created, and if it has finished.  If it
- has finished, close the handle to allow the thread to be cleaned up from
- the system.
+/**
+ Check if a restart thread has been created, and if it has finished.  If it
+ has finished, close the handle to allow the thread to be cleaned up from
+ the system.
+ */
+VOID
+YoriShCleanupRestartSaveThreadIfCompleted(VOID)
+{
+    if (YoriShGlobal.RestartSaveThread != NULL) {
+        if (WaitForSingleObject(YoriShGlobal.RestartSaveThread, 0) == WAIT_OBJECT_0) {
+            CloseHandle(YoriShGlobal.RestartSaveThread);
+            YoriShGlobal.RestartSaveThread = NULL;
+        }
+    }
+}
+
+/**
+ Update a string to refer to a range of a mapped binary restart file, after
+ checking that the range is within the file.
+
+ @param View Pointer to the start of the mapped file.
+
+ @param FileSize The size of the mapped file, in bytes.
+
+ @param Block Pointer to the description of the range.
+
+ @param IsSingleString If TRUE, the range is expected to contain a single
+        NULL terminated string, and the resulting string length excludes the
+        terminator.  If FALSE, the range contains a sequence of NULL
+        terminated strings.
+
+ @param String On successful completion, updated to refer to the range.
+
+ @return TRUE to indicate success, FALSE to indicate the range is invalid.
+ */
+__success(return)
+BOOL
+YoriShRestartBlockToString(
+    __in PUCHAR View,
+    __in DWORD FileSize,
+    __in PYORI_SH_RESTART_BLOCK Block,
+    __in BOOLEAN IsSingleString,
+    __out PYORI_STRING String
+    )
+{
+    if (Block->Offset < sizeof(YORI_SH_RESTART_HEADER) ||
+        Block->Offset > FileSize ||
+        (Block->Offset % sizeof(TCHAR)) != 0 ||
+        Block->LengthInChars > (FileSize - Block->Offset) / sizeof(TCHAR)) {
+
+        return FALSE;
+    }
+
+    YoriLibInitEmptyString(String);
+    String->StartOfString = (LPTSTR)(View + Block->Offset);
+    String->LengthInChars = Block->LengthInChars;
+    String->LengthAllocated = Block->LengthInChars;
+
+    if (IsSingleString) {
+        if (String->LengthInChars == 0 ||
+            String->StartOfString[String->LengthInChars - 1] != '\0') {
+
+            return FALSE;
+        }
+        String->LengthInChars--;
+    }
+
+    return TRUE;
+}
+
+/**
+ Load a restart state from a binary restart file.  The file is mapped into
+ memory and the strings in the restart state refer to the mapping, so the
+ mapping must remain until the state is no longer needed.
+
+ @param FileName Pointer to the name of the file to load.  This string is
+        NULL terminated.
+
+ @param State On successful completion, populated with the saved state.
+
+ @param MappedView On successful completion, updated to point to the mapped
+        view of the file.  The caller should unmap this with UnmapViewOfFile
+        after the state is no longer needed.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YoriShLoadRestartStateBinary(
+    __in PYORI_STRING FileName,
+    __out PYORI_SH_RESTART_STATE State,
+    __out PVOID *MappedView
+    )
+{
+    PYORI_SH_RESTART_HEADER Header;
+    HANDLE hFile;
+    HANDLE MapHandle;
+    PUCHAR View;
+    DWORD FileSize;
+
+    hFile = CreateFile(FileName->StartOfString,
+                       GENERIC_READ,
+                       FILE_SHARE_READ | FILE_SHARE_DELETE,
+                       NULL,
+                       OPEN_EXISTING,
+                       FILE_ATTRIBUTE_NORMAL,
+                       NULL);
+
+    if (hFile == INVALID_HANDLE_VALUE) {
+        return FALSE;
+    }
+
+    FileSize = GetFileSize(hFile, NULL);
+    if (FileSize == INVALID_FILE_SIZE ||
+        FileSize < sizeof(YORI_SH_RESTART_HEADER)) {
+
+        CloseHandle(hFile);
+        return FALSE;
+    }
+
+    MapHandle = CreateFileMapping(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(hFile);
+    if (MapHandle == NULL) {
+        return FALSE;
+    }
+
+    View = MapViewOfFile(MapHandle, FILE_MAP_READ, 0, 0, FileSize);
+    CloseHandle(MapHandle);
+    if (View == NULL) {
+        return FALSE;
+    }
+
+    Header = (PYORI_SH_RESTART_HEADER)View;
+    YoriShInitRestartState(State);
+
+    if (Header->Signature != YORI_SH_RESTART_SIGNATURE ||
+        Header->Version != YORI_SH_RESTART_VERSION ||
+        Header->FileSize != FileSize ||
+        Header->CharSize != sizeof(TCHAR) ||
+        Header->Window.BufferWidth == 0 ||
+        Header->Window.BufferHeight == 0 ||
+        Header->Window.WindowWidth == 0 ||
+        Header->Window.WindowHeight == 0 ||
+        !YoriShRestartBlockToString(View, FileSize, &Header->Title, TRUE, &State->Title) ||
+        !YoriShRestartBlockToString(View, FileSize, &Header->CurrentDirectory, TRUE, &State->CurrentDirectory) ||
+        !YoriShRestartBlockToString(View, FileSize, &Header->Environment, FALSE, &State->Environment) ||
+        !YoriShRestartBlockToString(View, FileSize, &Header->Aliases, FALSE, &State->Aliases) ||
+        !YoriShRestartBlockToString(View, FileSize, &Header->History, FALSE, &State->History) ||
+        !YoriShRestartBlockToString(View, FileSize, &Header->ContentsFileName, TRUE, &State->ContentsFileName)) {
+
+        UnmapViewOfFile(View);
+        return FALSE;
+    }
+
+    memcpy(&State->Window, &Header->Window, sizeof(YORI_SH_RESTART_WINDOW));
+    State->Window.FaceName[LF_FACESIZE - 1] = '\0';
+
+    *MappedView = View;
+    return TRUE;
+}
+
+/**
+ Allocate a string and copy a NULL terminated string into it.
+
+ @param String On successful completion, updated to contain a copy of
+        Source.  This string is NULL terminated.
+
+ @param Source Pointer to the NULL terminated string to copy.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
  */
-VOID
-YoriShCleanupRestartSaveThreadIfCompleted(VOID)
+__success(return)
+BOOL
+YoriShRestartAllocateCopy(
+    __out PYORI_STRING String,
+    __in LPCTSTR Source
+    )
 {
-    if (YoriShGlobal.RestartSaveThread != NULL) {
-        if (WaitForSingleObject(YoriShGlobal.RestartSaveThread, 0) == WAIT_OBJECT_0) {
-            CloseHandle(YoriShGlobal.RestartSaveThread);
-            YoriShGlobal.RestartSaveThread = NULL;
-        }
+    YORI_ALLOC_SIZE_T Length;
+
+    Length = (YORI_ALLOC_SIZE_T)_tcslen(Source);
+    if (!YoriLibAllocateString(String, Length + 1)) {
+        return FALSE;
     }
+
+    memcpy(String->StartOfString, Source, (Length + 1) * sizeof(TCHAR));
+    String->LengthInChars = Length;
+    return TRUE;
 }
 
 /**
- Try to recover a previous process ID that terminated unexpectedly.
+ Load a restart state from an INI file.  This is used for restart states
+ written by earlier versions, or where a binary restart file could not be
+ written.
 
- @param ProcessId Pointer to the process ID to try to recover.
+ @param FileName Pointer to the name of the file to load.  This string is
+        NULL terminated.
+
+ @param State On successful completion, populated with the saved state.
+        The caller should free this with @ref YoriShFreeRestartState.
 
  @return TRUE to indicate success, FALSE to indicate failure.
  */
+__success(return)
 BOOL
-YoriShLoadSavedRestartState(
-    __in PYORI_STRING ProcessId
+YoriShLoadRestartStateIni(
+    __in PYORI_STRING FileName,
+    __out PYORI_SH_RESTART_STATE State
     )
 {
-    YORI_STRING RestartFileName;
     YORI_STRING ReadBuffer;
-    YORI_CONSOLE_SCREEN_BUFFER_INFOEX ScreenBufferInfo;
-    DWORD Count;
-    YORI_CONSOLE_FONT_INFOEX FontInfo;
-    HWND ConsoleWindow;
+    YORI_ALLOC_SIZE_T Count;
+    YORI_ALLOC_SIZE_T EnvironmentLength;
     INT WindowLeft;
     INT WindowTop;
+    LPTSTR ThisPair;
+    LPTSTR ThisVar;
+    LPTSTR ThisValue;
 
-    YoriLibLoadUser32Functions();
-
-    if (DllKernel32.pSetConsoleScreenBufferInfoEx == NULL ||
-        DllKernel32.pSetCurrentConsoleFontEx == NULL ||
-        DllKernel32.pGetConsoleWindow == NULL ||
-        DllKernel32.pGetPrivateProfileIntW == NULL ||
+    if (DllKernel32.pGetPrivateProfileIntW == NULL ||
         DllKernel32.pGetPrivateProfileSectionW == NULL ||
-        DllKernel32.pGetPrivateProfileStringW == NULL ||
-        DllUser32.pGetWindowRect == NULL ||
-        DllUser32.pSetWindowPos == NULL) {
-
-        return FALSE;
-    }
+        DllKernel32.pGetPrivateProfileStringW == NULL) {
 
-    if (!YoriLibGetTempPath(&RestartFileName, sizeof("\\yori-restart-.ini") + 2 * sizeof(DWORD))) {
         return FALSE;
     }
 
-    ZeroMemory(&ScreenBufferInfo, sizeof(ScreenBufferInfo));
-    ScreenBufferInfo.cbSize = sizeof(ScreenBufferInfo);
-
-    YoriLibSPrintf(RestartFileName.StartOfString + RestartFileName.LengthInChars,
-                   _T("\\yori-restart-%y.ini"),
-                   ProcessId);
+    YoriShInitRestartState(State);
 
     //
-    //  Read and populate window settings
+    //  Read window settings
     //
 
-    ScreenBufferInfo.dwSize.X = (USHORT)DllKernel32.pGetPrivateProfileIntW(_T("Window"), _T("BufferWidth"), 0, RestartFileName.StartOfString);
-    ScreenBufferInfo.dwSize.Y = (USHORT)DllKernel32.pGetPrivateProfileIntW(_T("Window"), _T("BufferHeight"), 0, RestartFileName.StartOfString);
-
-    if (ScreenBufferInfo.dwSize.X == 0 || ScreenBufferInfo.dwSize.Y == 0) {
-        YoriLibFreeStringContents(&RestartFileName);
-        return FALSE;
-    }
+    State->Window.BufferWidth = (WORD)DllKernel32.pGetPrivateProfileIntW(_T("Window"), _T("BufferWidth"), 0, FileName->StartOfString);
+    State->Window.BufferHeight = (WORD)DllKernel32.pGetPrivateProfileIntW(_T("Window"), _T("BufferHeight"), 0, FileName->StartOfString);
+    State->Window.WindowWidth = (WORD)DllKernel32.pGetPrivateProfileIntW(_T("Window"), _T("WindowWidth"), 0, FileName->StartOfString);
+    State->Window.WindowHeight = (WORD)DllKernel32.pGetPrivateProfileIntW(_T("Window"), _T("WindowHeight"), 0, FileName->StartOfString);
 
-    ScreenBufferInfo.dwMaximumWindowSize.X = (USHORT)DllKernel32.pGetPrivateProfileIntW(_T("Window"), _T("WindowWidth"), 0, RestartFileName.StartOfString);
-    ScreenBufferInfo.dwMaximumWindowSize.Y = (USHORT)DllKernel32.pGetPrivateProfileIntW(_T("Window"), _T("WindowHeight"), 0, RestartFileName.StartOfString);
+    if (State->Window.BufferWidth == 0 || State->Window.BufferHeight == 0 ||
+        State->Window.WindowWidth == 0 || State->Window.WindowHeight == 0) {
 
-    if (ScreenBufferInfo.dwMaximumWindowSize.X == 0 || ScreenBufferInfo.dwMaximumWindowSize.Y == 0) {
-        YoriLibFreeStringContents(&RestartFileName);
         return FALSE;
     }
 
-    ScreenBufferInfo.srWindow.Bottom = (USHORT)(ScreenBufferInfo.dwMaximumWindowSize.Y);
-    ScreenBufferInfo.srWindow.Right = (USHORT)(ScreenBufferInfo.dwMaximumWindowSize.X);
-
-    ScreenBufferInfo.wAttributes = (USHORT)DllKernel32.pGetPrivateProfileIntW(_T("Window"), _T("DefaultColor"), 0, RestartFileName.StartOfString);
-    ScreenBufferInfo.wPopupAttributes = (USHORT)DllKernel32.pGetPrivateProfileIntW(_T("Window"), _T("PopupColor"), 0, RestartFileName.StartOfString);
+    State->Window.DefaultColor = (WORD)DllKernel32.pGetPrivateProfileIntW(_T("Window"), _T("DefaultColor"), 0, FileName->StartOfString);
+    State->Window.PopupColor = (WORD)DllKernel32.pGetPrivateProfileIntW(_T("Window"), _T("PopupColor"), 0, FileName->StartOfString);
 
-    for (Count = 0; Count < sizeof(ScreenBufferInfo.ColorTable)/sizeof(ScreenBufferInfo.ColorTable[0]); Count++) {
+    for (Count = 0; Count < sizeof(State->Window.ColorTable)/sizeof(State->Window.ColorTable[0]); Count++) {
         TCHAR ColorName[32];
         YoriLibSPrintf(ColorName, _T("Color%i"), Count);
-        ScreenBufferInfo.ColorTable[Count] = DllKernel32.pGetPrivateProfileIntW(_T("Window"), ColorName, 0, RestartFileName.StartOfString);
+        State->Window.ColorTable[Count] = DllKernel32.pGetPrivateProfileIntW(_T("Window"), ColorName, 0, FileName->StartOfString);
     }
 
-    YoriLibVtSetDefaultColor(ScreenBufferInfo.wAttributes);
+    State->Window.FontIndex = DllKernel32.pGetPrivateProfileIntW(_T("Window"), _T("FontIndex"), 0, FileName->StartOfString);
+    State->Window.FontWidth = (WORD)DllKernel32.pGetPrivateProfileIntW(_T("Window"), _T("FontWidth"), 0, FileName->StartOfString);
+    State->Window.FontHeight = (WORD)DllKernel32.pGetPrivateProfileIntW(_T("Window"), _T("FontHeight"), 0, FileName->StartOfString);
+    State->Window.FontFamily = DllKernel32.pGetPrivateProfileIntW(_T("Window"), _T("FontFamily"), 0, FileName->StartOfString);
+    State->Window.FontWeight = DllKernel32.pGetPrivateProfileIntW(_T("Window"), _T("FontWeight"), 0, FileName->StartOfString);
+    DllKernel32.pGetPrivateProfileStringW(_T("Window"),
+                                          _T("FontName"),
+                                          _T(""),
+                                          State->Window.FaceName,
+                                          sizeof(State->Window.FaceName)/sizeof(State->Window.FaceName[0]),
+                                          FileName->StartOfString);
+    State->Window.Flags = State->Window.Flags | YORI_SH_RESTART_FONT_VALID;
+
+    WindowLeft = DllKernel32.pGetPrivateProfileIntW(_T("Window"), _T("WindowLeft"), INT_MAX, FileName->StartOfString);
+    WindowTop = DllKernel32.pGetPrivateProfileIntW(_T("Window"), _T("WindowTop"), INT_MAX, FileName->StartOfString);
+
+    if (WindowLeft != INT_MAX &&
+        WindowTop != INT_MAX) {
+
+        State->Window.WindowLeft = WindowLeft;
+        State->Window.WindowTop = WindowTop;
+        State->Window.Flags = State->Window.Flags | YORI_SH_RESTART_WINDOW_POSITION_VALID;
+    }
 
     //
-    //  Apparently GetConsoleTitle can't tell us how much memory it needs, but
-    //  it needs less than 32Kb
+    //  Sections are read into a 32Kb buffer, consistent with the maximum
+    //  size of an environment block
     //
 
     if (!YoriLibAllocateString(&ReadBuffer, 32 * 1024)) {
-        YoriLibFreeStringContents(&RestartFileName);
         return FALSE;
     }
 
-    //
-    //  Read and populate window fonts
-    //
+    DllKernel32.pGetPrivateProfileStringW(_T("Window"),
+                                          _T("Title"),
+                                          _T("Yori"),
+                                          ReadBuffer.StartOfString,
+                                          ReadBuffer.LengthAllocated,
+                                          FileName->StartOfString);
+
+    if (!YoriShRestartAllocateCopy(&State->Title, ReadBuffer.StartOfString)) {
+        YoriLibFreeStringContents(&ReadBuffer);
+        return FALSE;
+    }
 
-    ZeroMemory(&FontInfo, sizeof(FontInfo));
-    FontInfo.cbSize = sizeof(FontInfo);
-    FontInfo.nFont = DllKernel32.pGetPrivateProfileIntW(_T("Window"), _T("FontIndex"), 0, RestartFileName.StartOfString);
-    FontInfo.dwFontSize.X = (USHORT)DllKernel32.pGetPrivateProfileIntW(_T("Window"), _T("FontWidth"), 0, RestartFileName.StartOfString);
-    FontInfo.dwFontSize.Y = (USHORT)DllKernel32.pGetPrivateProfileIntW(_T("Window"), _T("FontHeight"), 0, RestartFileName.StartOfString);
-    FontInfo.FontFamily = DllKernel32.pGetPrivateProfileIntW(_T("Window"), _T("FontFamily"), 0, RestartFileName.StartOfString);
-    FontInfo.FontWeight = DllKernel32.pGetPrivateProfileIntW(_T("Window"), _T("FontWeight"), 0, RestartFileName.StartOfString);
     DllKernel32.pGetPrivateProfileStringW(_T("Window"),
-                                          _T("FontName"),
+                                          _T("CurrentDirectory"),
                                           _T(""),
-                                          FontInfo.FaceName,
-                                          sizeof(FontInfo.FaceName)/sizeof(FontInfo.FaceName[0]),
-                                          RestartFileName.StartOfString);
+                                          ReadBuffer.StartOfString,
+                                          ReadBuffer.LengthAllocated,
+                                          FileName->StartOfString);
 
-    if (FontInfo.dwFontSize.X > 0 && FontInfo.dwFontSize.Y > 0 && FontInfo.FontWeight > 0) {
-        DllKernel32.pSetCurrentConsoleFontEx(GetStdHandle(STD_OUTPUT_HANDLE), FALSE, &FontInfo);
+    if (!YoriShRestartAllocateCopy(&State->CurrentDirectory, ReadBuffer.StartOfString)) {
+        YoriLibFreeStringContents(&ReadBuffer);
+        YoriShFreeRestartState(State);
+        return FALSE;
     }
 
-    DllKernel32.pSetConsoleScreenBufferInfoEx(GetStdHandle(STD_OUTPUT_HANDLE), &ScreenBufferInfo);
+    DllKernel32.pGetPrivateProfileStringW(_T("Window"),
+                                          _T("Contents"),
+                                          _T(""),
+                                          ReadBuffer.StartOfString,
+                                          ReadBuffer.LengthAllocated,
+                                          FileName->StartOfString);
+
+    if (!YoriShRestartAllocateCopy(&State->ContentsFileName, ReadBuffer.StartOfString)) {
+        YoriLibFreeStringContents(&ReadBuffer);
+        YoriShFreeRestartState(State);
+        return FALSE;
+    }
 
     //
-    //  Read and set window position
+    //  Read the environment, followed by current directories on other
+    //  drives which are stored without their leading '='.  Each current
+    //  directory gains a character when converted back.
     //
 
-    ConsoleWindow = DllKernel32.pGetConsoleWindow();
-    WindowLeft = DllKernel32.pGetPrivateProfileIntW(_T("Window"), _T("WindowLeft"), INT_MAX, RestartFileName.StartOfString);
-    WindowTop = DllKernel32.pGetPrivateProfileIntW(_T("Window"), _T("WindowTop"), INT_MAX, RestartFileName.StartOfString);
+    EnvironmentLength = (YORI_ALLOC_SIZE_T)
+        DllKernel32.pGetPrivateProfileSectionW(_T("Environment"),
+                                               ReadBuffer.StartOfString,
+                                               ReadBuffer.LengthAllocated,
+                                               FileName->StartOfString);
 
-    if (WindowLeft != INT_MAX &&
-        WindowTop != INT_MAX) {
+    if (YoriLibAllocateString(&State->Environment, 2 * ReadBuffer.LengthAllocated + 1)) {
+        if (EnvironmentLength > 0) {
+            YoriShRestartAppendPairs(&State->Environment, ReadBuffer.StartOfString);
+        }
 
-        DllUser32.pSetWindowPos(ConsoleWindow, NULL, WindowLeft, WindowTop, 0, 0, SWP_NOACTIVATE | SWP_NOSIZE | SWP_NOZORDER);
+        ReadBuffer.LengthInChars = (YORI_ALLOC_SIZE_T)
+            DllKernel32.pGetPrivateProfileSectionW(_T("CurrentDirectories"),
+                                                   ReadBuffer.StartOfString,
+                                                   ReadBuffer.LengthAllocated,
+                                                   FileName->StartOfString);
+
+        if (ReadBuffer.LengthInChars > 0) {
+            TCHAR DriveLetterBuffer[sizeof("=C:")];
+
+            ThisPair = ReadBuffer.StartOfString;
+            while (*ThisPair != '\0') {
+                ThisVar = ThisPair;
+                ThisPair += _tcslen(ThisPair) + 1;
+                if (ThisVar[0] != '=') {
+                    ThisValue = _tcschr(ThisVar, '=');
+                    if (ThisValue) {
+                        ThisValue++;
+
+                        DriveLetterBuffer[0] = '=';
+                        DriveLetterBuffer[1] = ThisVar[0];
+                        DriveLetterBuffer[2] = ':';
+                        DriveLetterBuffer[3] = '\0';
+
+                        YoriShRestartAppendString(&State->Environment, DriveLetterBuffer, 3);
+                        YoriShRestartAppendString(&State->Environment, ThisValue, (YORI_ALLOC_SIZE_T)_tcslen(ThisValue));
+                    }
+                }
+            }
+        }
     }
 
     //
-    //  Read and populate the window title
+    //  Read aliases
     //
 
-    DllKernel32.pGetPrivateProfileStringW(_T("Window"),
-                                          _T("Title"),
-                                          _T("Yori"),
-                                          ReadBuffer.StartOfString,
-                                          ReadBuffer.LengthAllocated,
-                                          RestartFileName.StartOfString);
-    SetConsoleTitle(ReadBuffer.StartOfString);
+    ReadBuffer.LengthInChars = (YORI_ALLOC_SIZE_T)
+        DllKernel32.pGetPrivateProfileSectionW(_T("Aliases"),
+                                               ReadBuffer.StartOfString,
+                                               ReadBuffer.LengthAllocated,
+                                               FileName->StartOfString);
 
-    //
-    //  Read and populate the current directory
-    //
+    if (ReadBuffer.LengthInChars > 0 &&
+        YoriLibAllocateString(&State->Aliases, ReadBuffer.LengthInChars + 1)) {
 
-    ReadBuffer.LengthInChars = (YORI_ALLOC_SIZE_T)
-        DllKernel32.pGetPrivateProfileStringW(_T("Window"),
-                                              _T("CurrentDirectory"),
-                                              _T(""),
-                                              ReadBuffer.StartOfString,
-                                              ReadBuffer.LengthAllocated,
-                                              RestartFileName.StartOfString);
-    if (ReadBuffer.LengthInChars > 0) {
-        YoriLibSetCurrentDirectory(&ReadBuffer);
+        YoriShRestartAppendPairs(&State->Aliases, ReadBuffer.StartOfString);
     }
 
     //
-    //  Populate the environment.
+    //  Read history, discarding the keys which only exist to maintain
+    //  ordering
     //
 
     ReadBuffer.LengthInChars = (YORI_ALLOC_SIZE_T)
-        DllKernel32.pGetPrivateProfileSectionW(_T("Environment"),
+        DllKernel32.pGetPrivateProfileSectionW(_T("History"),
                                                ReadBuffer.StartOfString,
                                                ReadBuffer.LengthAllocated,
-                                               RestartFileName.StartOfString);
+                                               FileName->StartOfString);
 
-    if (ReadBuffer.LengthInChars > 0) {
-        LPTSTR ThisPair;
-        LPTSTR ThisVar;
-        LPTSTR ThisValue;
+    if (ReadBuffer.LengthInChars > 0 &&
+        YoriLibAllocateString(&State->History, ReadBuffer.LengthInChars + 1)) {
 
         ThisPair = ReadBuffer.StartOfString;
         while (*ThisPair != '\0') {
@@ -797,122 +1623,179 @@ YoriShLoadSavedRestartState(
             if (ThisVar[0] != '=') {
                 ThisValue = _tcschr(ThisVar, '=');
                 if (ThisValue) {
-                    ThisValue[0] = '\0';
                     ThisValue++;
-
-                    SetEnvironmentVariable(ThisVar, ThisValue);
+                    YoriShRestartAppendString(&State->History, ThisValue, (YORI_ALLOC_SIZE_T)_tcslen(ThisValue));
                 }
             }
         }
     }
 
+    YoriLibFreeStringContents(&ReadBuffer);
+    return TRUE;
+}
+
+/**
+ Apply a previously saved restart state to the current process and console.
+
+ @param State Pointer to the restart state to apply.
+ */
+VOID
+YoriShApplyRestartState(
+    __in PYORI_SH_RESTART_STATE State
+    )
+{
+    YORI_CONSOLE_SCREEN_BUFFER_INFOEX ScreenBufferInfo;
+    YORI_CONSOLE_FONT_INFOEX FontInfo;
+    YORI_STRING ThisVar;
+    YORI_STRING ThisValue;
+    YORI_STRING ThisEntry;
+    YORI_ALLOC_SIZE_T Offset;
+    YORI_ALLOC_SIZE_T Count;
+    BOOLEAN EnvironmentApplied;
+
     //
-    //  Populate current directories.
+    //  Populate window settings
     //
 
-    ReadBuffer.LengthInChars = (YORI_ALLOC_SIZE_T)
-        DllKernel32.pGetPrivateProfileSectionW(_T("CurrentDirectories"),
-                                               ReadBuffer.StartOfString,
-                                               ReadBuffer.LengthAllocated,
-                                               RestartFileName.StartOfString);
+    ZeroMemory(&ScreenBufferInfo, sizeof(ScreenBufferInfo));
+    ScreenBufferInfo.cbSize = sizeof(ScreenBufferInfo);
 
-    if (ReadBuffer.LengthInChars > 0) {
-        LPTSTR ThisPair;
-        LPTSTR ThisVar;
-        LPTSTR ThisValue;
-        TCHAR DriveLetterBuffer[sizeof("=C:")];
+    ScreenBufferInfo.dwSize.X = (SHORT)State->Window.BufferWidth;
+    ScreenBufferInfo.dwSize.Y = (SHORT)State->Window.BufferHeight;
+    ScreenBufferInfo.dwMaximumWindowSize.X = (SHORT)State->Window.WindowWidth;
+    ScreenBufferInfo.dwMaximumWindowSize.Y = (SHORT)State->Window.WindowHeight;
+    ScreenBufferInfo.srWindow.Bottom = (SHORT)State->Window.WindowHeight;
+    ScreenBufferInfo.srWindow.Right = (SHORT)State->Window.WindowWidth;
+    ScreenBufferInfo.wAttributes = State->Window.DefaultColor;
+    ScreenBufferInfo.wPopupAttributes = State->Window.PopupColor;
 
-        ThisPair = ReadBuffer.StartOfString;
-        while (*ThisPair != '\0') {
-            ThisVar = ThisPair;
-            ThisPair += _tcslen(ThisPair) + 1;
-            if (ThisVar[0] != '=') {
-                ThisValue = _tcschr(ThisVar, '=');
-                if (ThisValue) {
-                    ThisValue[0] = '\0';
-                    ThisValue++;
+    for (Count = 0; Count < sizeof(ScreenBufferInfo.ColorTable)/sizeof(ScreenBufferInfo.ColorTable[0]); Count++) {
+        ScreenBufferInfo.ColorTable[Count] = State->Window.ColorTable[Count];
+    }
 
-                    DriveLetterBuffer[0] = '=';
-                    DriveLetterBuffer[1] = ThisVar[0];
-                    DriveLetterBuffer[2] = ':';
-                    DriveLetterBuffer[3] = '\0';
+    YoriLibVtSetDefaultColor(ScreenBufferInfo.wAttributes);
 
-                    SetEnvironmentVariable(DriveLetterBuffer, ThisValue);
-                }
-            }
-        }
+    //
+    //  Populate window fonts
+    //
+
+    if ((State->Window.Flags & YORI_SH_RESTART_FONT_VALID) &&
+        State->Window.FontWidth > 0 &&
+        State->Window.FontHeight > 0 &&
+        State->Window.FontWeight > 0) {
+
+        ZeroMemory(&FontInfo, sizeof(FontInfo));
+        FontInfo.cbSize = sizeof(FontInfo);
+        FontInfo.nFont = State->Window.FontIndex;
+        FontInfo.dwFontSize.X = (SHORT)State->Window.FontWidth;
+        FontInfo.dwFontSize.Y = (SHORT)State->Window.FontHeight;
+        FontInfo.FontFamily = State->Window.FontFamily;
+        FontInfo.FontWeight = State->Window.FontWeight;
+        memcpy(FontInfo.FaceName, State->Window.FaceName, sizeof(FontInfo.FaceName));
+
+        DllKernel32.pSetCurrentConsoleFontEx(GetStdHandle(STD_OUTPUT_HANDLE), FALSE, &FontInfo);
     }
 
+    DllKernel32.pSetConsoleScreenBufferInfoEx(GetStdHandle(STD_OUTPUT_HANDLE), &ScreenBufferInfo);
+
     //
-    //  Populate aliases
+    //  Set window position
     //
 
-    ReadBuffer.LengthInChars = (YORI_ALLOC_SIZE_T)
-        DllKernel32.pGetPrivateProfileSectionW(_T("Aliases"),
-                                               ReadBuffer.StartOfString,
-                                               ReadBuffer.LengthAllocated,
-                                               RestartFileName.StartOfString);
+    if (State->Window.Flags & YORI_SH_RESTART_WINDOW_POSITION_VALID) {
+        DllUser32.pSetWindowPos(DllKernel32.pGetConsoleWindow(), NULL, State->Window.WindowLeft, State->Window.WindowTop, 0, 0, SWP_NOACTIVATE | SWP_NOSIZE | SWP_NOZORDER);
+    }
 
-    if (ReadBuffer.LengthInChars > 0) {
-        LPTSTR ThisPair;
-        LPTSTR ThisVar;
-        LPTSTR ThisValue;
+    //
+    //  Populate the window title
+    //
 
-        ThisPair = ReadBuffer.StartOfString;
-        while (*ThisPair != '\0') {
-            ThisVar = ThisPair;
-            ThisPair += _tcslen(ThisPair) + 1;
-            if (ThisVar[0] != '=') {
-                ThisValue = _tcschr(ThisVar, '=');
-                if (ThisValue) {
-                    ThisValue[0] = '\0';
-                    ThisValue++;
+    if (State->Title.LengthInChars > 0) {
+        SetConsoleTitle(State->Title.StartOfString);
+    } else {
+        SetConsoleTitle(_T("Yori"));
+    }
 
-                    YoriShAddAliasLiteral(ThisVar, ThisValue, FALSE);
-                }
-            }
+    //
+    //  Populate the current directory
+    //
+
+    if (State->CurrentDirectory.LengthInChars > 0) {
+        YoriLibSetCurrentDirectory(&State->CurrentDirectory);
+    }
+
+    //
+    //  Populate the environment, including current directories on other
+    //  drives.  Most of the saved environment typically matches the
+    //  environment the new process inherited, so convert it back into an
+    //  environment block and apply only the variables that differ.  If
+    //  that can't be done, set each variable individually.
+    //
+
+    EnvironmentApplied = FALSE;
+    if (YoriLibAllocateString(&ThisEntry, State->Environment.LengthInChars + 1)) {
+        Offset = 0;
+        ThisEntry.LengthInChars = 0;
+        while (YoriShRestartGetNextString(&State->Environment, &Offset, &ThisVar) &&
+               YoriShRestartGetNextString(&State->Environment, &Offset, &ThisValue)) {
+
+            memcpy(&ThisEntry.StartOfString[ThisEntry.LengthInChars],
+                   ThisVar.StartOfString,
+                   ThisVar.LengthInChars * sizeof(TCHAR));
+            ThisEntry.LengthInChars = ThisEntry.LengthInChars + ThisVar.LengthInChars;
+            ThisEntry.StartOfString[ThisEntry.LengthInChars] = '=';
+            ThisEntry.LengthInChars++;
+            memcpy(&ThisEntry.StartOfString[ThisEntry.LengthInChars],
+                   ThisValue.StartOfString,
+                   ThisValue.LengthInChars * sizeof(TCHAR));
+            ThisEntry.LengthInChars = ThisEntry.LengthInChars + ThisValue.LengthInChars;
+            ThisEntry.StartOfString[ThisEntry.LengthInChars] = '\0';
+            ThisEntry.LengthInChars++;
+        }
+        ThisEntry.StartOfString[ThisEntry.LengthInChars] = '\0';
+
+        EnvironmentApplied = YoriShMergeEnvironmentStrings(&ThisEntry);
+        YoriLibFreeStringContents(&ThisEntry);
+    }
+
+    if (!EnvironmentApplied) {
+        Offset = 0;
+        while (YoriShRestartGetNextString(&State->Environment, &Offset, &ThisVar) &&
+               YoriShRestartGetNextString(&State->Environment, &Offset, &ThisValue)) {
+
+            SetEnvironmentVariable(ThisVar.StartOfString, ThisValue.StartOfString);
         }
     }
 
     //
-    //  Populate history
+    //  Populate aliases
     //
 
-    ReadBuffer.LengthInChars = (YORI_ALLOC_SIZE_T)
-        DllKernel32.pGetPrivateProfileSectionW(_T("History"),
-                                               ReadBuffer.StartOfString,
-                                               ReadBuffer.LengthAllocated,
-                                               RestartFileName.StartOfString);
+    Offset = 0;
+    while (YoriShRestartGetNextString(&State->Aliases, &Offset, &ThisVar) &&
+           YoriShRestartGetNextString(&State->Aliases, &Offset, &ThisValue)) {
+
+        YoriShAddAliasLiteral(ThisVar.StartOfString, ThisValue.StartOfString, FALSE);
+    }
 
-    if (ReadBuffer.LengthInChars > 0) {
-        LPTSTR ThisPair;
-        LPTSTR ThisVar;
-        LPTSTR ThisValue;
-        YORI_STRING ThisEntry;
-        YORI_ALLOC_SIZE_T ValueLength;
+    //
+    //  Populate history.  The saved state may be a view of a file, so each
+    //  entry is copied into its own allocation.
+    //
 
+    if (State->History.LengthInChars > 0) {
         YoriShInitHistory();
 
-        ThisPair = ReadBuffer.StartOfString;
-        while (*ThisPair != '\0') {
-            ThisVar = ThisPair;
-            ThisPair += _tcslen(ThisPair) + 1;
-            if (ThisVar[0] != '=') {
-                ThisValue = _tcschr(ThisVar, '=');
-                if (ThisValue) {
-                    ThisValue[0] = '\0';
-                    ThisValue++;
-                    ValueLength = (YORI_ALLOC_SIZE_T)_tcslen(ThisValue);
-                    if (YoriLibAllocateString(&ThisEntry, ValueLength + 1)) {
-                        memcpy(ThisEntry.StartOfString,
-                               ThisValue,
-                               (ValueLength + 1) * sizeof(TCHAR));
-                        ThisEntry.LengthInChars = ValueLength;
-
-                        YoriShAddToHistory(&ThisEntry, FALSE);
-                        YoriLibFreeStringContents(&ThisEntry);
-                    }
-                }
+        Offset = 0;
+        while (YoriShRestartGetNextString(&State->History, &Offset, &ThisValue)) {
+            if (YoriLibAllocateString(&ThisEntry, ThisValue.LengthInChars + 1)) {
+                memcpy(ThisEntry.StartOfString,
+                       ThisValue.StartOfString,
+                       (ThisValue.LengthInChars + 1) * sizeof(TCHAR));
+                ThisEntry.LengthInChars = ThisValue.LengthInChars;
+
+                YoriShAddToHistory(&ThisEntry, FALSE);
+                YoriLibFreeStringContents(&ThisEntry);
             }
         }
     }
@@ -921,18 +1804,10 @@ YoriShLoadSavedRestartState(
     //  Populate window contents
     //
 
-    ReadBuffer.LengthInChars = (YORI_ALLOC_SIZE_T)
-        DllKernel32.pGetPrivateProfileStringW(_T("Window"),
-                                              _T("Contents"),
-                                              _T(""),
-                                              ReadBuffer.StartOfString,
-                                              ReadBuffer.LengthAllocated,
-                                              RestartFileName.StartOfString);
-
-    if (ReadBuffer.LengthInChars > 0) {
+    if (State->ContentsFileName.LengthInChars > 0) {
         HANDLE hBufferFile;
 
-        hBufferFile = CreateFile(ReadBuffer.StartOfString,
+        hBufferFile = CreateFile(State->ContentsFileName.StartOfString,
                                  GENERIC_READ,
                                  FILE_SHARE_READ | FILE_SHARE_DELETE,
                                  NULL,
@@ -957,14 +1832,69 @@ YoriShLoadSavedRestartState(
         }
     }
 
-    YoriLibFreeStringContents(&ReadBuffer);
-    YoriLibFreeStringContents(&RestartFileName);
-
     //
     //  Reload any state next time it's requested.
     //
 
     YoriShGlobal.EnvironmentGeneration++;
+}
+
+/**
+ Try to recover a previous process ID that terminated unexpectedly.
+
+ @param ProcessId Pointer to the process ID to try to recover.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+YoriShLoadSavedRestartState(
+    __in PYORI_STRING ProcessId
+    )
+{
+    YORI_STRING RestartFileName;
+    YORI_SH_RESTART_STATE State;
+    LPTSTR FileNameSuffix;
+    PVOID MappedView;
+
+    YoriLibLoadUser32Functions();
+
+    if (DllKernel32.pSetConsoleScreenBufferInfoEx == NULL ||
+        DllKernel32.pSetCurrentConsoleFontEx == NULL ||
+        DllKernel32.pGetConsoleWindow == NULL ||
+        DllUser32.pGetWindowRect == NULL ||
+        DllUser32.pSetWindowPos == NULL) {
+
+        return FALSE;
+    }
+
+    if (!YoriLibGetTempPath(&RestartFileName, sizeof("\\yori-restart-.ini") + 2 * sizeof(DWORD))) {
+        return FALSE;
+    }
+
+    //
+    //  Look for a binary restart file first, and if it is not present or
+    //  not valid, look for an INI file.
+    //
+
+    MappedView = NULL;
+    FileNameSuffix = RestartFileName.StartOfString + RestartFileName.LengthInChars;
+    YoriLibSPrintf(FileNameSuffix, _T("\\yori-restart-%y.bin"), ProcessId);
+
+    if (!YoriShLoadRestartStateBinary(&RestartFileName, &State, &MappedView)) {
+        YoriLibSPrintf(FileNameSuffix, _T("\\yori-restart-%y.ini"), ProcessId);
+        if (!YoriShLoadRestartStateIni(&RestartFileName, &State)) {
+            YoriLibFreeStringContents(&RestartFileName);
+            return FALSE;
+        }
+    }
+
+    YoriShApplyRestartState(&State);
+
+    YoriShFreeRestartState(&State);
+    if (MappedView != NULL) {
+        UnmapViewOfFile(MappedView);
+    }
+    YoriLibFreeStringContents(&RestartFileName);
 
     return TRUE;
 }
@@ -982,6 +1912,8 @@ YoriShDiscardSavedRestartState(
     )
 {
     YORI_STRING RestartFileName;
+    LPCTSTR Extensions[] = {_T("bin"), _T("ini"), _T("txt")};
+    DWORD Index;
 
     if (YoriShGlobal.RestartSaveThread != NULL) {
         WaitForSingleObject(YoriShGlobal.RestartSaveThread, INFINITE);
@@ -993,29 +1925,22 @@ YoriShDiscardSavedRestartState(
         return;
     }
 
-    if (ProcessId != NULL) {
-        YoriLibSPrintf(RestartFileName.StartOfString + RestartFileName.LengthInChars,
-                       _T("\\yori-restart-%y.ini"),
-                       ProcessId);
-    } else {
-        YoriLibSPrintf(RestartFileName.StartOfString + RestartFileName.LengthInChars,
-                       _T("\\yori-restart-%x.ini"),
-                       GetCurrentProcessId());
-    }
-
-    DeleteFile(RestartFileName.StartOfString);
+    for (Index = 0; Index < sizeof(Extensions)/sizeof(Extensions[0]); Index++) {
+        if (ProcessId != NULL) {
+            YoriLibSPrintf(RestartFileName.StartOfString + RestartFileName.LengthInChars,
+                           _T("\\yori-restart-%y.%s"),
+                           ProcessId,
+                           Extensions[Index]);
+        } else {
+            YoriLibSPrintf(RestartFileName.StartOfString + RestartFileName.LengthInChars,
+                           _T("\\yori-restart-%x.%s"),
+                           GetCurrentProcessId(),
+                           Extensions[Index]);
+        }
 
-    if (ProcessId != NULL) {
-        YoriLibSPrintf(RestartFileName.StartOfString + RestartFileName.LengthInChars,
-                       _T("\\yori-restart-%y.txt"),
-                       ProcessId);
-    } else {
-        YoriLibSPrintf(RestartFileName.StartOfString + RestartFileName.LengthInChars,
-                       _T("\\yori-restart-%x.txt"),
-                       GetCurrentProcessId());
+        DeleteFile(RestartFileName.StartOfString);
     }
 
-    DeleteFile(RestartFileName.StartOfString);
     YoriLibFreeStringContents(&RestartFileName);
 }
 
@@ -0,0 +1,599 @@
+/**
+ * @file sh/server.c
+ *
+ * Yori shell server that executes commands on behalf of clients
+ *
+ * Copyright (c) 2026 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "yori.h"
+
+#ifndef PIPE_REJECT_REMOTE_CLIENTS
+/**
+ A flag to indicate a named pipe should not accept connections from other
+ machines.  Older compilers don't define this.
+ */
+#define PIPE_REJECT_REMOTE_CLIENTS 0x00000008
+#endif
+
+/**
+ The size of the buffer used to forward output to the client.
+ */
+#define YORI_SH_SERVER_PUMP_BUFFER_SIZE (16 * 1024)
+
+/**
+ Context for a thread that forwards output from a command to the client.
+ */
+typedef struct _YORI_SH_SERVER_PUMP {
+
+    /**
+     The handle to read command output from.
+     */
+    HANDLE ReadHandle;
+
+    /**
+     The pipe connected to the client.
+     */
+    HANDLE ClientPipe;
+
+    /**
+     A mutex which serializes writes to the client pipe, since standard
+     output and standard error are forwarded by different threads.
+     */
+    HANDLE WriteMutex;
+
+    /**
+     The type of packet to send to the client, one of the
+     YORI_LIBSH_SERVER_RESPONSE_* values.
+     */
+    DWORD PacketType;
+
+    /**
+     The thread forwarding output.
+     */
+    HANDLE Thread;
+} YORI_SH_SERVER_PUMP, *PYORI_SH_SERVER_PUMP;
+
+/**
+ Read a specified number of bytes from the client.
+
+ @param ClientPipe The pipe connected to the client.
+
+ @param Buffer Pointer to the buffer to populate.
+
+ @param Length The number of bytes to read.
+
+ @return TRUE if the requested number of bytes were read, FALSE if the
+         client disconnected or an error occurred.
+ */
+__success(return)
+BOOLEAN
+YoriShServerReadFromClient(
+    __in HANDLE ClientPipe,
+    __out_bcount(Length) PVOID Buffer,
+    __in DWORD Length
+    )
+{
+    DWORD BytesRead;
+    DWORD TotalRead;
+
+    TotalRead = 0;
+    while (TotalRead < Length) {
+        if (!ReadFile(ClientPipe, YoriLibAddToPointer(Buffer, TotalRead), Length - TotalRead, &BytesRead, NULL) ||
+            BytesRead == 0) {
+
+            return FALSE;
+        }
+        TotalRead = TotalRead + BytesRead;
+    }
+
+    return TRUE;
+}
+
+/**
+ Send a packet to the client.
+
+ @param ClientPipe The pipe connected to the client.
+
+ @param WriteMutex Optionally points to a mutex to acquire while writing the
+        packet.
+
+ @param PacketType The type of packet, one of the
+        YORI_LIBSH_SERVER_RESPONSE_* values.
+
+ @param Buffer Pointer to the payload of the packet.
+
+ @param Length The number of bytes of payload.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+YoriShServerSendPacket(
+    __in HANDLE ClientPipe,
+    __in_opt HANDLE WriteMutex,
+    __in DWORD PacketType,
+    __in_bcount(Length) PVOID Buffer,
+    __in DWORD Length
+    )
+{
+    YORI_LIBSH_SERVER_RESPONSE Header;
+    DWORD BytesWritten;
+    BOOLEAN Result;
+
+    Header.Type = PacketType;
+    Header.Length = Length;
+
+    if (WriteMutex != NULL) {
+        WaitForSingleObject(WriteMutex, INFINITE);
+    }
+
+    Result = FALSE;
+    if (WriteFile(ClientPipe, &Header, sizeof(Header), &BytesWritten, NULL) &&
+        BytesWritten == sizeof(Header) &&
+        WriteFile(ClientPipe, Buffer, Length, &BytesWritten, NULL) &&
+        BytesWritten == Length) {
+
+        Result = TRUE;
+    }
+
+    if (WriteMutex != NULL) {
+        ReleaseMutex(WriteMutex);
+    }
+
+    return Result;
+}
+
+/**
+ A thread which forwards output from a command to the client until all
+ processes writing to the output have closed it.
+
+ @param Context Pointer to the pump context.
+
+ @return Exit code for the thread, which is not used.
+ */
+DWORD WINAPI
+YoriShServerPumpOutput(
+    __in PVOID Context
+    )
+{
+    PYORI_SH_SERVER_PUMP Pump;
+    PUCHAR Buffer;
+    DWORD BytesRead;
+    BOOLEAN ClientConnected;
+
+    Pump = (PYORI_SH_SERVER_PUMP)Context;
+    Buffer = YoriLibMalloc(YORI_SH_SERVER_PUMP_BUFFER_SIZE);
+
+    //
+    //  If the buffer can't be allocated, forward output in small pieces.
+    //  If the client disconnects, keep reading and discarding output so
+    //  that the command doesn't block writing to a full pipe.
+    //
+
+    if (Buffer == NULL) {
+        UCHAR SmallBuffer[256];
+        while (ReadFile(Pump->ReadHandle, SmallBuffer, sizeof(SmallBuffer), &BytesRead, NULL) && BytesRead > 0) {
+            YoriShServerSendPacket(Pump->ClientPipe, Pump->WriteMutex, Pump->PacketType, SmallBuffer, BytesRead);
+        }
+        return 0;
+    }
+
+    ClientConnected = TRUE;
+    while (ReadFile(Pump->ReadHandle, Buffer, YORI_SH_SERVER_PUMP_BUFFER_SIZE, &BytesRead, NULL) && BytesRead > 0) {
+        if (ClientConnected) {
+            ClientConnected = YoriShServerSendPacket(Pump->ClientPipe, Pump->WriteMutex, Pump->PacketType, Buffer, BytesRead);
+        }
+    }
+
+    YoriLibFree(Buffer);
+    return 0;
+}
+
+/**
+ Create a pipe to capture output from a command, and a thread to forward
+ that output to the client.
+
+ @param Pump Pointer to the pump context to initialize.
+
+ @param ClientPipe The pipe connected to the client.
+
+ @param WriteMutex The mutex which serializes writes to the client pipe.
+
+ @param PacketType The type of packet to send to the client, one of the
+        YORI_LIBSH_SERVER_RESPONSE_* values.
+
+ @param WriteHandle On successful completion, populated with an inheritable
+        handle that the command should write its output to.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+YoriShServerStartPump(
+    __out PYORI_SH_SERVER_PUMP Pump,
+    __in HANDLE ClientPipe,
+    __in HANDLE WriteMutex,
+    __in DWORD PacketType,
+    __out PHANDLE WriteHandle
+    )
+{
+    HANDLE PipeWriteHandle;
+    HANDLE InheritableWriteHandle;
+    DWORD ThreadId;
+
+    Pump->ClientPipe = ClientPipe;
+    Pump->WriteMutex = WriteMutex;
+    Pump->PacketType = PacketType;
+    Pump->Thread = NULL;
+
+    if (!CreatePipe(&Pump->ReadHandle, &PipeWriteHandle, NULL, 0)) {
+        return FALSE;
+    }
+
+    if (!YoriLibMakeInheritableHandle(PipeWriteHandle, &InheritableWriteHandle)) {
+        CloseHandle(PipeWriteHandle);
+        CloseHandle(Pump->ReadHandle);
+        return FALSE;
+    }
+
+    Pump->Thread = CreateThread(NULL, 0, YoriShServerPumpOutput, Pump, 0, &ThreadId);
+    if (Pump->Thread == NULL) {
+        CloseHandle(InheritableWriteHandle);
+        CloseHandle(Pump->ReadHandle);
+        return FALSE;
+    }
+
+    *WriteHandle = InheritableWriteHandle;
+    return TRUE;
+}
+
+/**
+ Wait for a pump thread to forward all output and clean up its resources.
+ This should be called after the shell has closed its handle to the write
+ end of the pipe.
+
+ @param Pump Pointer to the pump context.
+ */
+VOID
+YoriShServerFinishPump(
+    __in PYORI_SH_SERVER_PUMP Pump
+    )
+{
+    WaitForSingleObject(Pump->Thread, INFINITE);
+    CloseHandle(Pump->Thread);
+    CloseHandle(Pump->ReadHandle);
+}
+
+/**
+ Execute a command on behalf of a client, with the client's environment and
+ current directory, forwarding its output to the client.  Once complete,
+ the server's environment and current directory are restored, so each
+ request starts from the state the server was in after executing its init
+ scripts.
+
+ @param ClientPipe The pipe connected to the client.
+
+ @param CurrentDirectory Pointer to the current directory to execute the
+        command in.
+
+ @param Environment Pointer to the environment block to execute the command
+        with.  If this is empty, the server's environment is used.
+
+ @param Command Pointer to the command to execute.
+
+ @return The exit code of the command.
+ */
+DWORD
+YoriShServerExecute(
+    __in HANDLE ClientPipe,
+    __in PYORI_STRING CurrentDirectory,
+    __in PYORI_STRING Environment,
+    __in PYORI_STRING Command
+    )
+{
+    YORI_STRING SavedEnvironment;
+    YORI_STRING SavedCurrentDirectory;
+    YORI_SH_SERVER_PUMP OutputPump;
+    YORI_SH_SERVER_PUMP ErrorPump;
+    HANDLE WriteMutex;
+    HANDLE OutputHandle;
+    HANDLE ErrorHandle;
+    HANDLE InputHandle;
+    HANDLE SavedInput;
+    HANDLE SavedOutput;
+    HANDLE SavedError;
+    SECURITY_ATTRIBUTES InheritHandle;
+    DWORD ExitCode;
+
+    if (!YoriShGetEnvironmentStrings(&SavedEnvironment)) {
+        return EXIT_FAILURE;
+    }
+
+    if (!YoriLibGetCurrentDirectory(&SavedCurrentDirectory)) {
+        YoriLibFreeStringContents(&SavedEnvironment);
+        return EXIT_FAILURE;
+    }
+
+    WriteMutex = CreateMutex(NULL, FALSE, NULL);
+    if (WriteMutex == NULL) {
+        YoriLibFreeStringContents(&SavedCurrentDirectory);
+        YoriLibFreeStringContents(&SavedEnvironment);
+        return EXIT_FAILURE;
+    }
+
+    if (!YoriShServerStartPump(&OutputPump, ClientPipe, WriteMutex, YORI_LIBSH_SERVER_RESPONSE_STDOUT, &OutputHandle)) {
+        CloseHandle(WriteMutex);
+        YoriLibFreeStringContents(&SavedCurrentDirectory);
+        YoriLibFreeStringContents(&SavedEnvironment);
+        return EXIT_FAILURE;
+    }
+
+    if (!YoriShServerStartPump(&ErrorPump, ClientPipe, WriteMutex, YORI_LIBSH_SERVER_RESPONSE_STDERR, &ErrorHandle)) {
+        CloseHandle(OutputHandle);
+        YoriShServerFinishPump(&OutputPump);
+        CloseHandle(WriteMutex);
+        YoriLibFreeStringContents(&SavedCurrentDirectory);
+        YoriLibFreeStringContents(&SavedEnvironment);
+        return EXIT_FAILURE;
+    }
+
+    //
+    //  Commands have no input, since reading from the server's console
+    //  would never be what the client intended.
+    //
+
+    InheritHandle.nLength = sizeof(InheritHandle);
+    InheritHandle.lpSecurityDescriptor = NULL;
+    InheritHandle.bInheritHandle = TRUE;
+
+    InputHandle = CreateFile(_T("NUL"), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, &InheritHandle, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+
+    SavedInput = GetStdHandle(STD_INPUT_HANDLE);
+    SavedOutput = GetStdHandle(STD_OUTPUT_HANDLE);
+    SavedError = GetStdHandle(STD_ERROR_HANDLE);
+
+    if (InputHandle != INVALID_HANDLE_VALUE) {
+        SetStdHandle(STD_INPUT_HANDLE, InputHandle);
+    }
+    SetStdHandle(STD_OUTPUT_HANDLE, OutputHandle);
+    SetStdHandle(STD_ERROR_HANDLE, ErrorHandle);
+
+    //
+    //  Apply the client's state and execute the command.
+    //
+
+    ExitCode = EXIT_FAILURE;
+    if (Environment->LengthInChars > 0 && !YoriShSetEnvironmentStrings(Environment)) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("yori: could not apply environment\n"));
+    } else if (CurrentDirectory->LengthInChars > 0 && !YoriLibSetCurrentDirectory(CurrentDirectory)) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("yori: could not change to directory %y\n"), CurrentDirectory);
+    } else {
+        YoriShGlobal.ErrorLevel = EXIT_SUCCESS;
+        if (YoriShExecuteExpression(Command)) {
+            ExitCode = YoriShGlobal.ErrorLevel;
+        }
+
+        //
+        //  If the command asked the shell to exit, that ends the command,
+        //  not the server.
+        //
+
+        if (YoriShGlobal.ExitProcess) {
+            ExitCode = YoriShGlobal.ExitProcessExitCode;
+            YoriShGlobal.ExitProcess = FALSE;
+            YoriShGlobal.ExitProcessExitCode = 0;
+        }
+    }
+
+    //
+    //  Restore the server's handles and wait for any output to be
+    //  forwarded.  Note this waits for any background process that is still
+    //  writing to the output to exit.
+    //
+
+    SetStdHandle(STD_INPUT_HANDLE, SavedInput);
+    SetStdHandle(STD_OUTPUT_HANDLE, SavedOutput);
+    SetStdHandle(STD_ERROR_HANDLE, SavedError);
+
+    if (InputHandle != INVALID_HANDLE_VALUE) {
+        CloseHandle(InputHandle);
+    }
+    CloseHandle(OutputHandle);
+    CloseHandle(ErrorHandle);
+
+    YoriShServerFinishPump(&OutputPump);
+    YoriShServerFinishPump(&ErrorPump);
+    CloseHandle(WriteMutex);
+
+    //
+    //  Restore the server's state for the next request.  Only variables
+    //  that differ are changed, so consecutive requests with the same
+    //  environment do not rebuild the environment of this process.
+    //
+
+    YoriShSetEnvironmentStrings(&SavedEnvironment);
+    YoriLibSetCurrentDirectory(&SavedCurrentDirectory);
+
+    YoriLibFreeStringContents(&SavedCurrentDirectory);
+    YoriLibFreeStringContents(&SavedEnvironment);
+
+    return ExitCode;
+}
+
+/**
+ Read a request from a connected client, execute it, and send the result
+ to the client.
+
+ @param ClientPipe The pipe connected to the client.
+ */
+VOID
+YoriShServerProcessRequest(
+    __in HANDLE ClientPipe
+    )
+{
+    YORI_LIBSH_SERVER_REQUEST Request;
+    YORI_STRING Buffer;
+    YORI_STRING CurrentDirectory;
+    YORI_STRING Environment;
+    YORI_STRING Command;
+    YORI_ALLOC_SIZE_T CharsNeeded;
+    DWORD ExitCode;
+
+    if (!YoriShServerReadFromClient(ClientPipe, &Request, sizeof(Request))) {
+        return;
+    }
+
+    if (Request.Version != YORI_LIBSH_SERVER_VERSION ||
+        Request.CurrentDirectoryLength > YORI_LIBSH_SERVER_MAX_REQUEST_CHARS ||
+        Request.EnvironmentLength > YORI_LIBSH_SERVER_MAX_REQUEST_CHARS ||
+        Request.CommandLength > YORI_LIBSH_SERVER_MAX_REQUEST_CHARS ||
+        Request.CommandLength == 0) {
+
+        return;
+    }
+
+    //
+    //  Read all three strings into a single allocation, leaving space for
+    //  each to be NULL terminated, and the environment block to be double
+    //  NULL terminated.
+    //
+
+    CharsNeeded = (YORI_ALLOC_SIZE_T)(Request.CurrentDirectoryLength + 1 + Request.EnvironmentLength + 2 + Request.CommandLength + 1);
+    if (!YoriLibAllocateString(&Buffer, CharsNeeded)) {
+        return;
+    }
+
+    YoriLibInitEmptyString(&CurrentDirectory);
+    CurrentDirectory.StartOfString = Buffer.StartOfString;
+    CurrentDirectory.LengthInChars = (YORI_ALLOC_SIZE_T)Request.CurrentDirectoryLength;
+    CurrentDirectory.LengthAllocated = CurrentDirectory.LengthInChars + 1;
+
+    YoriLibInitEmptyString(&Environment);
+    Environment.StartOfString = CurrentDirectory.StartOfString + CurrentDirectory.LengthAllocated;
+    Environment.LengthInChars = (YORI_ALLOC_SIZE_T)Request.EnvironmentLength;
+    Environment.LengthAllocated = Environment.LengthInChars + 2;
+
+    YoriLibInitEmptyString(&Command);
+    Command.StartOfString = Environment.StartOfString + Environment.LengthAllocated;
+    Command.LengthInChars = (YORI_ALLOC_SIZE_T)Request.CommandLength;
+    Command.LengthAllocated = Command.LengthInChars + 1;
+
+    if (!YoriShServerReadFromClient(ClientPipe, CurrentDirectory.StartOfString, CurrentDirectory.LengthInChars * sizeof(TCHAR)) ||
+        !YoriShServerReadFromClient(ClientPipe, Environment.StartOfString, Environment.LengthInChars * sizeof(TCHAR)) ||
+        !YoriShServerReadFromClient(ClientPipe, Command.StartOfString, Command.LengthInChars * sizeof(TCHAR))) {
+
+        YoriLibFreeStringContents(&Buffer);
+        return;
+    }
+
+    CurrentDirectory.StartOfString[CurrentDirectory.LengthInChars] = '\0';
+    Environment.StartOfString[Environment.LengthInChars] = '\0';
+    Environment.StartOfString[Environment.LengthInChars + 1] = '\0';
+    Command.StartOfString[Command.LengthInChars] = '\0';
+
+    ExitCode = YoriShServerExecute(ClientPipe, &CurrentDirectory, &Environment, &Command);
+    YoriShServerSendPacket(ClientPipe, NULL, YORI_LIBSH_SERVER_RESPONSE_EXIT, &ExitCode, sizeof(ExitCode));
+
+    YoriLibFreeStringContents(&Buffer);
+}
+
+/**
+ Run the shell as a server, accepting commands from clients over a named
+ pipe and executing them one at a time.  Several servers can be started
+ with the same name, and each client will connect to whichever is
+ available.  This function only returns if the pipe cannot be created.
+
+ @param ServerName Pointer to the name of the server.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+YoriShRunServer(
+    __in PYORI_STRING ServerName
+    )
+{
+    YORI_STRING PipeName;
+    HANDLE ClientPipe;
+    DWORD PipeMode;
+    DWORD Err;
+    LPTSTR ErrText;
+
+    YoriLibInitEmptyString(&PipeName);
+    YoriLibYPrintf(&PipeName, _T("%s%y"), YORI_LIBSH_SERVER_PIPE_PREFIX, ServerName);
+    if (PipeName.StartOfString == NULL) {
+        return FALSE;
+    }
+
+    PipeMode = PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS;
+
+    while (TRUE) {
+        ClientPipe = CreateNamedPipe(PipeName.StartOfString,
+                                     PIPE_ACCESS_DUPLEX,
+                                     PipeMode,
+                                     PIPE_UNLIMITED_INSTANCES,
+                                     YORI_SH_SERVER_PUMP_BUFFER_SIZE,
+                                     YORI_SH_SERVER_PUMP_BUFFER_SIZE,
+                                     0,
+                                     NULL);
+
+        //
+        //  Systems before Vista don't support rejecting remote clients, and
+        //  fail the request.
+        //
+
+        if (ClientPipe == INVALID_HANDLE_VALUE &&
+            GetLastError() == ERROR_INVALID_PARAMETER &&
+            (PipeMode & PIPE_REJECT_REMOTE_CLIENTS) != 0) {
+
+            PipeMode = PipeMode & ~(PIPE_REJECT_REMOTE_CLIENTS);
+            continue;
+        }
+
+        if (ClientPipe == INVALID_HANDLE_VALUE) {
+            Err = GetLastError();
+            ErrText = YoriLibGetWinErrorText(Err);
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("yori: could not create %y: %s"), &PipeName, ErrText);
+            YoriLibFreeWinErrorText(ErrText);
+            YoriLibFreeStringContents(&PipeName);
+            return FALSE;
+        }
+
+        if (ConnectNamedPipe(ClientPipe, NULL) || GetLastError() == ERROR_PIPE_CONNECTED) {
+            YoriLibCancelReset();
+            YoriShServerProcessRequest(ClientPipe);
+            FlushFileBuffers(ClientPipe);
+            DisconnectNamedPipe(ClientPipe);
+        }
+
+        CloseHandle(ClientPipe);
+
+        //
+        //  Clean up any state from completed commands, as the interactive
+        //  shell would before displaying a prompt.
+        //
+
+        YoriShScanJobsReportCompletion(FALSE);
+        YoriLibShScanProcessBuffersForTeardown(FALSE);
+    }
+}
+
+// vim:sw=4:ts=4:et:
@@ -0,0 +1,302 @@
+/**
+ * @file sh/starttrc.c
+ *
+ * Yori shell startup time trace
+ *
+ * Copyright (c) 2026 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "yori.h"
+
+/**
+ A single phase of shell startup that has been timed.
+ */
+typedef struct _YORI_SH_STARTUP_TRACE_PHASE {
+
+    /**
+     The links for this phase within the list of phases.  Paired with
+     @ref YoriShStartupTracePhases .
+     */
+    YORI_LIST_ENTRY ListEntry;
+
+    /**
+     A constant string describing the phase.
+     */
+    LPCTSTR Phase;
+
+    /**
+     Optionally describes the object that the phase operated on, such as
+     the name of an init script.  This may be an empty string.
+     */
+    YORI_STRING Detail;
+
+    /**
+     The number of microseconds that the phase took.
+     */
+    DWORDLONG Duration;
+} YORI_SH_STARTUP_TRACE_PHASE, *PYORI_SH_STARTUP_TRACE_PHASE;
+
+/**
+ TRUE if startup is being traced.  This is set when the shell starts if the
+ user has set YORISTARTUPTRACE, and cleared once the trace is reported.
+ */
+BOOLEAN YoriShStartupTraceEnabled;
+
+/**
+ The value of YORISTARTUPTRACE, indicating where to report the trace.
+ */
+YORI_STRING YoriShStartupTraceTarget;
+
+/**
+ The frequency of the performance counter.
+ */
+LARGE_INTEGER YoriShStartupTraceFrequency;
+
+/**
+ The performance counter value when the previous phase completed.
+ */
+LARGE_INTEGER YoriShStartupTraceLastTime;
+
+/**
+ The list of phases that have completed.  Paired with
+ @ref YORI_SH_STARTUP_TRACE_PHASE::ListEntry .
+ */
+YORI_LIST_ENTRY YoriShStartupTracePhases;
+
+/**
+ Add a phase to the list of completed phases.
+
+ @param Phase Pointer to a constant string describing the phase.
+
+ @param Detail Optionally points to a string describing the object that the
+        phase operated on.
+
+ @param Duration The number of microseconds that the phase took.
+ */
+VOID
+YoriShStartupTraceAddPhase(
+    __in LPCTSTR Phase,
+    __in_opt PCYORI_STRING Detail,
+    __in DWORDLONG Duration
+    )
+{
+    PYORI_SH_STARTUP_TRACE_PHASE TracePhase;
+    YORI_ALLOC_SIZE_T DetailLength;
+
+    DetailLength = 0;
+    if (Detail != NULL) {
+        DetailLength = Detail->LengthInChars;
+    }
+
+    TracePhase = YoriLibReferencedMalloc(sizeof(YORI_SH_STARTUP_TRACE_PHASE) + DetailLength * sizeof(TCHAR));
+    if (TracePhase == NULL) {
+        return;
+    }
+
+    TracePhase->Phase = Phase;
+    TracePhase->Duration = Duration;
+    YoriLibInitEmptyString(&TracePhase->Detail);
+    if (DetailLength > 0) {
+        TracePhase->Detail.StartOfString = (LPTSTR)(TracePhase + 1);
+        memcpy(TracePhase->Detail.StartOfString, Detail->StartOfString, DetailLength * sizeof(TCHAR));
+        TracePhase->Detail.LengthInChars = DetailLength;
+    }
+
+    YoriLibAppendList(&YoriShStartupTracePhases, &TracePhase->ListEntry);
+}
+
+/**
+ Begin tracing shell startup if the user has requested it by setting
+ YORISTARTUPTRACE.  This should be called as early as possible in the
+ shell's execution.  The time between the process being created and this
+ call is recorded as the first phase.
+ */
+VOID
+YoriShStartupTraceInitialize(VOID)
+{
+    YORI_ALLOC_SIZE_T EnvVarLength;
+    FILETIME CreationTime;
+    FILETIME ExitTime;
+    FILETIME KernelTime;
+    FILETIME UserTime;
+    LARGE_INTEGER liCreationTime;
+    LARGE_INTEGER liNow;
+
+    YoriLibInitializeListHead(&YoriShStartupTracePhases);
+
+    EnvVarLength = YoriShGetEnvironmentVariableWithoutSubstitution(_T("YORISTARTUPTRACE"), NULL, 0, NULL);
+    if (EnvVarLength == 0) {
+        return;
+    }
+
+    if (!YoriLibAllocateString(&YoriShStartupTraceTarget, EnvVarLength)) {
+        return;
+    }
+
+    YoriShStartupTraceTarget.LengthInChars = YoriShGetEnvironmentVariableWithoutSubstitution(_T("YORISTARTUPTRACE"), YoriShStartupTraceTarget.StartOfString, YoriShStartupTraceTarget.LengthAllocated, NULL);
+    if (YoriShStartupTraceTarget.LengthInChars == 0 ||
+        YoriShStartupTraceTarget.LengthInChars >= YoriShStartupTraceTarget.LengthAllocated ||
+        !QueryPerformanceFrequency(&YoriShStartupTraceFrequency)) {
+
+        YoriLibFreeStringContents(&YoriShStartupTraceTarget);
+        return;
+    }
+
+    QueryPerformanceCounter(&YoriShStartupTraceLastTime);
+    YoriShStartupTraceEnabled = TRUE;
+
+    //
+    //  The performance counter has no relationship to process creation
+    //  time, so the time taken to load the process, and the libraries it
+    //  depends on, is measured with the system clock.  This is only
+    //  accurate to the resolution of the system timer.
+    //
+
+    if (GetProcessTimes(GetCurrentProcess(), &CreationTime, &ExitTime, &KernelTime, &UserTime)) {
+        liNow.QuadPart = YoriLibGetSystemTimeAsInteger();
+        liCreationTime.LowPart = CreationTime.dwLowDateTime;
+        liCreationTime.HighPart = CreationTime.dwHighDateTime;
+        if (liNow.QuadPart > liCreationTime.QuadPart) {
+            YoriShStartupTraceAddPhase(_T("Process creation"), NULL, (DWORDLONG)(liNow.QuadPart - liCreationTime.QuadPart) / 10);
+        }
+    }
+}
+
+/**
+ Record the completion of a phase of shell startup.  The phase is considered
+ to have started when the previous phase completed.
+
+ @param Phase Pointer to a constant string describing the phase.  This
+        string must remain valid until the trace is reported.
+
+ @param Detail Optionally points to a string describing the object that the
+        phase operated on, such as the name of an init script.
+ */
+VOID
+YoriShStartupTraceMark(
+    __in LPCTSTR Phase,
+    __in_opt PCYORI_STRING Detail
+    )
+{
+    LARGE_INTEGER Now;
+    DWORDLONG Delta;
+    DWORDLONG Frequency;
+
+    if (!YoriShStartupTraceEnabled) {
+        return;
+    }
+
+    QueryPerformanceCounter(&Now);
+    Delta = (DWORDLONG)(Now.QuadPart - YoriShStartupTraceLastTime.QuadPart);
+    Frequency = (DWORDLONG)YoriShStartupTraceFrequency.QuadPart;
+    YoriShStartupTraceAddPhase(Phase, Detail, (Delta / Frequency) * 1000000 + (Delta % Frequency) * 1000000 / Frequency);
+
+    //
+    //  Measure the next phase from now, so the time taken to record this
+    //  phase is not attributed to it.
+    //
+
+    QueryPerformanceCounter(&YoriShStartupTraceLastTime);
+}
+
+/**
+ Report the startup trace, if one is in progress, and stop tracing.  This
+ is called before the first prompt is displayed.  If YORISTARTUPTRACE is
+ set to 1, the trace is displayed on the console; otherwise it is the name
+ of a file that the trace is appended to.
+ */
+VOID
+YoriShStartupTraceReport(VOID)
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PYORI_SH_STARTUP_TRACE_PHASE TracePhase;
+    YORI_STRING FullFileName;
+    HANDLE OutputHandle;
+    HANDLE FileHandle;
+    DWORDLONG Total;
+    SYSTEMTIME Now;
+
+    if (!YoriShStartupTraceEnabled) {
+        return;
+    }
+
+    YoriShStartupTraceEnabled = FALSE;
+
+    FileHandle = NULL;
+    if (YoriLibCompareStringLit(&YoriShStartupTraceTarget, _T("1")) == 0) {
+        OutputHandle = GetStdHandle(STD_ERROR_HANDLE);
+    } else {
+        YoriLibInitEmptyString(&FullFileName);
+        if (YoriLibUserStringToSingleFilePath(&YoriShStartupTraceTarget, TRUE, &FullFileName)) {
+            FileHandle = CreateFile(FullFileName.StartOfString, FILE_APPEND_DATA, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+            YoriLibFreeStringContents(&FullFileName);
+        }
+        if (FileHandle == INVALID_HANDLE_VALUE) {
+            FileHandle = NULL;
+        }
+        OutputHandle = FileHandle;
+    }
+
+    if (OutputHandle != NULL) {
+        GetLocalTime(&Now);
+        YoriLibOutputToDevice(OutputHandle,
+                              0,
+                              _T("Yori startup trace, process %i, %04i/%02i/%02i %02i:%02i:%02i\n"),
+                              GetCurrentProcessId(),
+                              Now.wYear,
+                              Now.wMonth,
+                              Now.wDay,
+                              Now.wHour,
+                              Now.wMinute,
+                              Now.wSecond);
+    }
+
+    Total = 0;
+    ListEntry = YoriLibGetNextListEntry(&YoriShStartupTracePhases, NULL);
+    while (ListEntry != NULL) {
+        TracePhase = CONTAINING_RECORD(ListEntry, YORI_SH_STARTUP_TRACE_PHASE, ListEntry);
+        ListEntry = YoriLibGetNextListEntry(&YoriShStartupTracePhases, ListEntry);
+
+        if (OutputHandle != NULL) {
+            if (TracePhase->Detail.LengthInChars > 0) {
+                YoriLibOutputToDevice(OutputHandle, 0, _T("%10lli us  %s: %y\n"), TracePhase->Duration, TracePhase->Phase, &TracePhase->Detail);
+            } else {
+                YoriLibOutputToDevice(OutputHandle, 0, _T("%10lli us  %s\n"), TracePhase->Duration, TracePhase->Phase);
+            }
+        }
+
+        Total = Total + TracePhase->Duration;
+        YoriLibRemoveListItem(&TracePhase->ListEntry);
+        YoriLibDereference(TracePhase);
+    }
+
+    if (OutputHandle != NULL) {
+        YoriLibOutputToDevice(OutputHandle, 0, _T("%10lli us  Total\n"), Total);
+    }
+
+    if (FileHandle != NULL) {
+        CloseHandle(FileHandle);
+    }
+
+    YoriLibFreeStringContents(&YoriShStartupTraceTarget);
+}
+
+// vim:sw=4:ts=4:et:
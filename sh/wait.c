@@ -546,6 +546,7 @@ YoriShPumpProcessDebugEventsAndApplyEnvironmentOnExit(
                 YoriShSetEnvironmentStrings(&EnvString);
 
                 YoriLibSetCurrentDirectorySaveDriveCurrentDirectory(&CurrentDirectory);
+                YoriShGlobal.EnvironmentGeneration++;
                 YoriLibFreeStringContents(&EnvString);
                 YoriLibFreeStringContents(&CurrentDirectory);
             }
@@ -156,6 +156,11 @@ YORI_CMD_BUILTIN YoriCmd_YDIRCASE;
  */
 YORI_CMD_BUILTIN YoriCmd_DIRENV;
 
+/**
+ Declaration for the builtin command.
+ */
+YORI_CMD_BUILTIN YoriCmd_GITSTAT;
+
 /**
  Declaration for the builtin command.
  */
@@ -451,6 +456,11 @@ YORI_CMD_BUILTIN YoriCmd_SLEEP;
  */
 YORI_CMD_BUILTIN YoriCmd_SLMENU;
 
+/**
+ Declaration for the builtin command.
+ */
+YORI_CMD_BUILTIN YoriCmd_YSORT;
+
 /**
  Declaration for the builtin command.
  */
@@ -598,6 +608,7 @@ YoriShBuiltins[] = {
                     {_T("FINFO"),     YoriCmd_FINFO},
                     {_T("FOR"),       YoriCmd_FOR},
                     {_T("FSCMP"),     YoriCmd_FSCMP},
+                    {_T("GITSTAT"),   YoriCmd_GITSTAT},
                     {_T("GRPCMP"),    YoriCmd_GRPCMP},
                     {_T("HEXDUMP"),   YoriCmd_HEXDUMP},
                     {_T("HILITE"),    YoriCmd_HILITE},
@@ -683,6 +694,7 @@ YoriShBuiltins[] = {
                     {_T("YRMDIR"),    YoriCmd_YRMDIR},
                     {_T("YS"),        YoriCmd_YS},
                     {_T("YSHUTDN"),   YoriCmd_YSHUTDN},
+                    {_T("YSORT"),     YoriCmd_YSORT},
                     {_T("YSPEAK"),    YoriCmd_YSPEAK},
                     {_T("YSPLIT"),    YoriCmd_YSPLIT},
                     {_T("YSPONGE"),   YoriCmd_YSPONGE},
@@ -759,6 +771,7 @@ YoriShDefaultAliasEntries[] = {
     {_T("sha384sum"),_T("yhash -a sha384 $*$")},
     {_T("sha512sum"),_T("yhash -a sha512 $*$")},
     {_T("shutdn"),   _T("yshutdn $*$")},
+    {_T("sort"),     _T("ysort $*$")},
     {_T("speak"),    _T("yspeak $*$")},
     {_T("split"),    _T("ysplit $*$")},
     {_T("sponge"),   _T("ysponge $*$")},
@@ -126,6 +126,12 @@ YoriShExecuteNamedModuleInProc(
     __out PDWORD ExitCode
     );
 
+__success(return)
+BOOLEAN
+YoriShResolveToolToBuiltin(
+    __inout PYORI_LIBSH_CMD_CONTEXT CmdContext
+    );
+
 DWORD
 YoriShBuiltIn (
     __in PYORI_LIBSH_SINGLE_EXEC_CONTEXT ExecContext
@@ -198,6 +204,13 @@ YoriShIsEnvironmentVariableChar(
     __in TCHAR Char
     );
 
+__success(return != 0 && return < Size)
+YORI_ALLOC_SIZE_T
+YoriShGetAppDirectoryWithTrailingSlash(
+    __in YORI_ALLOC_SIZE_T Size,
+    __out_ecount_part_opt(Size, return + 1) _When_(Size > 0, __out_ecount_part(Size, return + 1)) LPTSTR Buffer
+    );
+
 __success(return != 0)
 YORI_ALLOC_SIZE_T
 YoriShGetEnvironmentVariableWithoutSubstitution(
@@ -247,12 +260,24 @@ YoriShSetEnvironmentVariable(
     __in_opt PYORI_STRING Value
     );
 
+__success(return)
+BOOLEAN
+YoriShGetEnvironmentStrings(
+    __out PYORI_STRING EnvStrings
+    );
+
 __success(return)
 BOOLEAN
 YoriShSetEnvironmentStrings(
     __in PYORI_STRING NewEnv
     );
 
+__success(return)
+BOOLEAN
+YoriShMergeEnvironmentStrings(
+    __in PYORI_STRING NewEnv
+    );
+
 // *** EXEC.C ***
 
 DWORD
@@ -303,6 +328,27 @@ YoriShRemoveOneHistoryEntry(
 VOID
 YoriShClearAllHistory(VOID);
 
+PYORI_SH_HISTORY_ENTRY
+YoriShGetPreviousHistoryMatch(
+    __in PCYORI_STRING SearchString,
+    __in YORI_ALLOC_SIZE_T CompareLength,
+    __in_opt PYORI_SH_HISTORY_ENTRY PreviousMatch
+    );
+
+PYORI_SH_HISTORY_ENTRY
+YoriShGetPreviousHistorySubstringMatch(
+    __in PCYORI_STRING SearchString,
+    __in_opt PYORI_SH_HISTORY_ENTRY PreviousMatch,
+    __out PYORI_ALLOC_SIZE_T MatchOffset
+    );
+
+__success(return)
+BOOL
+YoriShGetHistorySuggestion(
+    __in PCYORI_STRING Prefix,
+    __out PYORI_STRING Suggestion
+    );
+
 __success(return)
 BOOL
 YoriShInitHistory(VOID);
@@ -322,6 +368,42 @@ YoriShGetHistoryStrings(
     __inout PYORI_STRING HistoryStrings
     );
 
+// *** INITCACH.C ***
+
+VOID
+YoriShInitCacheInitialize(
+    __out PYORI_SH_INIT_CACHE Cache
+    );
+
+__success(return)
+BOOLEAN
+YoriShInitCacheAddScript(
+    __inout PYORI_SH_INIT_CACHE Cache,
+    __in PYORI_STRING FileName,
+    __in PWIN32_FIND_DATA FindData
+    );
+
+__success(return)
+BOOLEAN
+YoriShInitCacheReplay(
+    __inout PYORI_SH_INIT_CACHE Cache
+    );
+
+VOID
+YoriShInitCacheCaptureState(
+    __inout PYORI_SH_INIT_CACHE Cache
+    );
+
+VOID
+YoriShInitCacheSave(
+    __inout PYORI_SH_INIT_CACHE Cache
+    );
+
+VOID
+YoriShInitCacheCleanup(
+    __inout PYORI_SH_INIT_CACHE Cache
+    );
+
 // *** INPUT.C ***
 
 __success(return)
@@ -361,6 +443,15 @@ YoriShScanJobsReportCompletion(
     __in BOOL TeardownAll
     );
 
+HANDLE
+YoriShGetJobCompletionEvent(VOID);
+
+BOOL
+YoriShJobsCompletedUnreported(VOID);
+
+VOID
+YoriShReportCompletedJobs(VOID);
+
 DWORD
 YoriShGetNextJobId(
     __in DWORD PreviousJobId
@@ -384,6 +475,13 @@ YoriShJobWait(
     __in DWORD JobId
     );
 
+DWORD
+YoriShJobWaitAny(VOID);
+
+__success(return)
+BOOL
+YoriShJobWaitForSlot(VOID);
+
 __success(return)
 BOOL
 YoriShGetJobOutput(
@@ -410,6 +508,13 @@ YoriShGetJobInformation(
     __inout PYORI_STRING Command
     );
 
+__success(return)
+BOOL
+YoriShGetJobAccounting(
+    __in DWORD JobId,
+    __out PYORI_LIB_JOB_ACCOUNTING Accounting
+    );
+
 // *** MAIN.C ***
 
 VOID
@@ -419,11 +524,45 @@ YoriShPreCommand(
 
 // *** PARSE.C ***
 
+VOID
+YoriShClearExecCaches(VOID);
+
 BOOLEAN
 YoriShExpandEnvironmentInCmdContext(
     __inout PYORI_LIBSH_CMD_CONTEXT CmdContext
     );
 
+VOID
+YoriShFlushCommandCache(VOID);
+
+VOID
+YoriShFreeParseCache(
+    __inout PYORI_SH_PARSE_CACHE Cache
+    );
+
+__success(return)
+BOOLEAN
+YoriShLocateExecutableInPathCached(
+    __in PYORI_STRING SearchFor,
+    __out PYORI_STRING FoundExecutable
+    );
+
+__success(return)
+BOOLEAN
+YoriShParseCmdlineForExecution(
+    __in PYORI_STRING CmdLine,
+    __out PYORI_LIBSH_CMD_CONTEXT CmdContext
+    );
+
+__success(return)
+BOOLEAN
+YoriShParseCmdlineWithCache(
+    __inout PYORI_SH_PARSE_CACHE Cache,
+    __in PYORI_STRING CmdLine,
+    __in YORI_ALLOC_SIZE_T CurrentOffset,
+    __out PYORI_LIBSH_CMD_CONTEXT CmdContext
+    );
+
 __success(return)
 BOOLEAN
 YoriShResolveCommandToExecutable(
@@ -432,9 +571,29 @@ YoriShResolveCommandToExecutable(
     );
 
 // *** PROMPT.C ***
+BOOLEAN
+YoriShCollectPromptSegments(VOID);
+
+HANDLE
+YoriShGetPromptSegmentEvent(VOID);
+
+VOID
+YoriShCleanupPromptSegments(VOID);
+
 BOOL
 YoriShDisplayPrompt(VOID);
 
+__success(return)
+BOOL
+YoriShRedisplayPrompt(VOID);
+
+__success(return)
+BOOLEAN
+YoriShGetPromptPosition(
+    __out PCOORD StartPosition,
+    __out PCOORD EndPosition
+    );
+
 BOOL
 YoriShExecPreCommandString(VOID);
 
@@ -456,6 +615,27 @@ YoriShDiscardSavedRestartState(
     __in_opt PYORI_STRING ProcessId
     );
 
+// *** SERVER.C ***
+
+BOOL
+YoriShRunServer(
+    __in PYORI_STRING ServerName
+    );
+
+// *** STARTTRC.C ***
+
+VOID
+YoriShStartupTraceInitialize(VOID);
+
+VOID
+YoriShStartupTraceMark(
+    __in LPCTSTR Phase,
+    __in_opt PCYORI_STRING Detail
+    );
+
+VOID
+YoriShStartupTraceReport(VOID);
+
 // *** WAIT.C ***
 
 VOID
@@ -46,6 +46,11 @@ YORI_CMD_BUILTIN YoriCmd_COLOR;
  */
 YORI_CMD_BUILTIN YoriCmd_DIRENV;
 
+/**
+ Declaration for the builtin command.
+ */
+YORI_CMD_BUILTIN YoriCmd_GITSTAT;
+
 /**
  Declaration for the builtin command.
  */
@@ -165,6 +170,7 @@ YoriShBuiltins[] = {
                     {_T("FALSE"),     YoriCmd_FALSE},
                     {_T("FG"),        YoriCmd_FG},
                     {_T("FOR"),       YoriCmd_FOR},
+                    {_T("GITSTAT"),   YoriCmd_GITSTAT},
                     {_T("HISTORY"),   YoriCmd_HISTORY},
                     {_T("IF"),        YoriCmd_IF},
                     {_T("INTCMP"),    YoriCmd_INTCMP},
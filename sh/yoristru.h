@@ -24,6 +24,120 @@
  * THE SOFTWARE.
  */
 
+/**
+ The number of consecutive characters within a command that are used to
+ index history entries.  Commands shorter than this are not indexed.
+ */
+#define YORI_SH_HISTORY_TRIGRAM_LENGTH 3
+
+/**
+ A set of history entries which all contain the same sequence of
+ @ref YORI_SH_HISTORY_TRIGRAM_LENGTH characters somewhere within the command.
+ */
+typedef struct _YORI_SH_HISTORY_TRIGRAM {
+
+    /**
+     The entry for this trigram within the history trigram hash table.
+     */
+    YORI_HASH_ENTRY HashEntry;
+
+    /**
+     The list of links to history entries containing this trigram, in the
+     order the entries were added.  Paired with
+     @ref YORI_SH_HISTORY_TRIGRAM_LINK::ListEntry .
+     */
+    YORI_LIST_ENTRY LinkList;
+
+    /**
+     The number of links on LinkList.
+     */
+    DWORD LinkCount;
+} YORI_SH_HISTORY_TRIGRAM, *PYORI_SH_HISTORY_TRIGRAM;
+
+/**
+ Records that a single history entry contains a single trigram.
+ */
+typedef struct _YORI_SH_HISTORY_TRIGRAM_LINK {
+
+    /**
+     The links for this entry within the set of entries containing the
+     trigram.  Paired with @ref YORI_SH_HISTORY_TRIGRAM::LinkList .
+     */
+    YORI_LIST_ENTRY ListEntry;
+
+    /**
+     Pointer to the trigram.
+     */
+    PYORI_SH_HISTORY_TRIGRAM Trigram;
+
+    /**
+     Pointer to the history entry containing the trigram.
+     */
+    struct _YORI_SH_HISTORY_ENTRY *HistoryEntry;
+} YORI_SH_HISTORY_TRIGRAM_LINK, *PYORI_SH_HISTORY_TRIGRAM_LINK;
+
+/**
+ The weight given to each use of a command when ranking history based
+ suggestions.  A command's score is the sequence number of its most recent
+ use plus this value for every time it appears in history, so a command that
+ is used frequently is preferred over one used once slightly more recently.
+ */
+#define YORI_SH_HISTORY_FREQUENCY_WEIGHT 8
+
+/**
+ A node within the history suggestion trie.  Each node describes a run of
+ characters following its parent, and siblings never share a first
+ character.  Comparisons are case insensitive.  A node where one or more
+ history entries end is a terminal node and records the command along with
+ how often and how recently it was used.
+ */
+typedef struct _YORI_SH_HISTORY_TRIE_NODE {
+
+    /**
+     Pointer to the parent node, or NULL for the root.
+     */
+    struct _YORI_SH_HISTORY_TRIE_NODE *Parent;
+
+    /**
+     Pointer to the first child of this node, or NULL if it has no children.
+     */
+    struct _YORI_SH_HISTORY_TRIE_NODE *FirstChild;
+
+    /**
+     Pointer to the next child of this node's parent.
+     */
+    struct _YORI_SH_HISTORY_TRIE_NODE *NextSibling;
+
+    /**
+     Pointer to the highest scoring terminal node within the subtree rooted
+     at this node, including this node, or NULL if the subtree contains no
+     terminal nodes.
+     */
+    struct _YORI_SH_HISTORY_TRIE_NODE *Best;
+
+    /**
+     The characters described by this node.  These are allocated along with
+     the node.
+     */
+    YORI_STRING Label;
+
+    /**
+     For a terminal node, the most recently executed form of the command.
+     Empty for other nodes.
+     */
+    YORI_STRING CmdLine;
+
+    /**
+     The number of history entries which end at this node.
+     */
+    DWORD Frequency;
+
+    /**
+     The history sequence number when this command was most recently added.
+     */
+    DWORD LastUsed;
+} YORI_SH_HISTORY_TRIE_NODE, *PYORI_SH_HISTORY_TRIE_NODE;
+
 /**
  Information about a previous command executed by the user.
  */
@@ -34,10 +148,33 @@ typedef struct _YORI_SH_HISTORY_ENTRY {
      */
     YORI_LIST_ENTRY ListEntry;
 
+    /**
+     An array of links, one for each distinct trigram within the command,
+     or NULL if the command is too short to be indexed.
+     */
+    PYORI_SH_HISTORY_TRIGRAM_LINK TrigramLinks;
+
+    /**
+     The number of elements in TrigramLinks.
+     */
+    YORI_ALLOC_SIZE_T TrigramLinkCount;
+
+    /**
+     Pointer to the node in the history suggestion trie where this command
+     ends, or NULL if the command could not be added to the trie.
+     */
+    PYORI_SH_HISTORY_TRIE_NODE TrieNode;
+
     /**
      The command that was executed by the user.
      */
     YORI_STRING CmdLine;
+
+    /**
+     TRUE if this entry has already been written to the history file, so
+     saving history only needs to append entries after it.
+     */
+    BOOLEAN Persisted;
 } YORI_SH_HISTORY_ENTRY, *PYORI_SH_HISTORY_ENTRY;
 
 /**
@@ -156,8 +293,47 @@ typedef struct _YORI_SH_TAB_COMPLETE_CONTEXT {
      */
     YORI_ALLOC_SIZE_T SearchStringOffset;
 
+    /**
+     Set to TRUE by the input thread when a context being populated by a
+     background file enumeration is no longer needed, because the user
+     has continued typing.  The enumeration stops as soon as it observes
+     this.
+     */
+    BOOLEAN Cancelled;
+
 } YORI_SH_TAB_COMPLETE_CONTEXT, *PYORI_SH_TAB_COMPLETE_CONTEXT;
 
+/**
+ The most recent parse of the input line.  Keystrokes that move between
+ arguments, tab completion and suggestions all parse the line being edited,
+ and typically the line has only changed near the cursor since the previous
+ parse.  Keeping the previous result allows arguments before the change to
+ be reused, so only the remainder of the line is parsed again.
+ */
+typedef struct _YORI_SH_PARSE_CACHE {
+
+    /**
+     A copy of the string that was parsed to generate CmdContext.
+     */
+    YORI_STRING Text;
+
+    /**
+     The cursor offset that was used when parsing Text.
+     */
+    YORI_ALLOC_SIZE_T CurrentOffset;
+
+    /**
+     The parsed form of Text.
+     */
+    YORI_LIBSH_CMD_CONTEXT CmdContext;
+
+    /**
+     TRUE if Text and CmdContext are populated.
+     */
+    BOOLEAN Valid;
+
+} YORI_SH_PARSE_CACHE, *PYORI_SH_PARSE_CACHE;
+
 /**
  The context of a line that is currently being entered by the user.
  */
@@ -306,6 +482,14 @@ typedef struct _YORI_SH_INPUT_BUFFER {
      */
     BOOLEAN SearchMode;
 
+    /**
+     If TRUE, the search is for older commands in history containing the
+     search string, which replace the input buffer as they are found.  If
+     FALSE, the search is within the input buffer itself.  Only meaningful
+     when SearchMode is TRUE.
+     */
+    BOOLEAN HistorySearchMode;
+
     /**
      The offset as it was when the search operation started.  This is used
      if no match is found or a search is cancelled.
@@ -313,10 +497,21 @@ typedef struct _YORI_SH_INPUT_BUFFER {
     YORI_ALLOC_SIZE_T PreSearchOffset;
 
     /**
-     The current search string, when searching within the buffer itself.
+     The current search string.
      */
     YORI_STRING SearchString;
 
+    /**
+     A copy of the input buffer as it was when a history search started.
+     This is used if the search is cancelled.
+     */
+    YORI_STRING PreSearchString;
+
+    /**
+     The result of the most recent parse of String.
+     */
+    YORI_SH_PARSE_CACHE ParseCache;
+
 } YORI_SH_INPUT_BUFFER, *PYORI_SH_INPUT_BUFFER;
 
 /**
@@ -412,6 +607,99 @@ typedef enum _YORI_SH_WAIT_OUTCOME {
     YoriShWaitOutcomeLoseFocus = 3
 } YORI_SH_WAIT_OUTCOME;
 
+/**
+ Information about a single init script that is run when the shell starts.
+ */
+typedef struct _YORI_SH_INIT_SCRIPT {
+
+    /**
+     The links for this script within the list of init scripts.  Paired
+     with @ref YORI_SH_INIT_CACHE::ScriptList .
+     */
+    YORI_LIST_ENTRY ListEntry;
+
+    /**
+     The fully qualified name of the script.
+     */
+    YORI_STRING FileName;
+
+    /**
+     Information about the script returned from directory enumeration.  The
+     last write time and size are used to determine whether the script has
+     changed since its effects were cached.
+     */
+    WIN32_FIND_DATA FindData;
+} YORI_SH_INIT_SCRIPT, *PYORI_SH_INIT_SCRIPT;
+
+/**
+ State used to record the effects of init scripts, or replay previously
+ recorded effects instead of executing the scripts.
+ */
+typedef struct _YORI_SH_INIT_CACHE {
+
+    /**
+     The fully qualified name of the cache file.  If this is empty, the
+     cache is not enabled and scripts are always executed.
+     */
+    YORI_STRING CacheFileName;
+
+    /**
+     The list of init scripts to execute, in the order they should be
+     executed.  Paired with @ref YORI_SH_INIT_SCRIPT::ListEntry .
+     */
+    YORI_LIST_ENTRY ScriptList;
+
+    /**
+     A list of records loaded from the cache file that were generated from
+     the current set of scripts.  Each record describes the effects of the
+     scripts for a particular initial state.
+     */
+    YORI_LIST_ENTRY RecordList;
+
+    /**
+     The number of records in RecordList.
+     */
+    DWORD RecordCount;
+
+    /**
+     The environment before any init scripts were executed.
+     */
+    YORI_STRING EnvironmentBefore;
+
+    /**
+     The user defined aliases before any init scripts were executed.
+     */
+    YORI_STRING UserAliasesBefore;
+
+    /**
+     The internal aliases before any init scripts were executed.
+     */
+    YORI_STRING InternalAliasesBefore;
+
+    /**
+     The current directory before any init scripts were executed.
+     */
+    YORI_STRING CurrentDirectoryBefore;
+
+    /**
+     The number of builtin commands registered before any init scripts were
+     executed.
+     */
+    DWORD BuiltinCountBefore;
+
+    /**
+     The most recently registered builtin command before any init scripts
+     were executed.
+     */
+    PYORI_LIBSH_BUILTIN_CALLBACK NewestBuiltinBefore;
+
+    /**
+     TRUE if the state above has been captured, so the effects of the
+     scripts can be recorded once they have been executed.
+     */
+    BOOLEAN StateCaptured;
+} YORI_SH_INIT_CACHE, *PYORI_SH_INIT_CACHE;
+
 /**
  A structure containing state that is global across the Yori shell process.
  */
@@ -433,6 +721,13 @@ typedef struct _YORI_SH_GLOBALS {
     */
     DWORD PreviousJobId;
 
+    /**
+     The maximum number of background jobs that can execute concurrently.
+     When this many are executing, launching another job waits for one to
+     complete.  Zero indicates no limit.
+     */
+    DWORD JobLimit;
+
     /**
      A pointer to the argument count of the currently active builtin
      command before escapes have been removed.  This can be given to a
@@ -468,6 +763,18 @@ typedef struct _YORI_SH_GLOBALS {
      */
     DWORD EnvironmentGeneration;
 
+    /**
+     A copy of the environment block of the process.  This is regenerated
+     when it is requested after the environment generation has changed.
+     */
+    YORI_STRING EnvironmentStrings;
+
+    /**
+     The generation of the environment at the time EnvironmentStrings was
+     captured.
+     */
+    DWORD EnvironmentStringsGeneration;
+
     /**
      The number of ms to wait before suggesting the completion to a command.
      */
@@ -536,6 +843,17 @@ typedef struct _YORI_SH_GLOBALS {
      */
     DWORD TitleGeneration;
 
+    /**
+     The directory containing the shell executable, including a trailing
+     slash.  This is populated the first time it is needed.
+     */
+    YORI_STRING AppDirectory;
+
+    /**
+     The generation of the environment at the time YORIINPROC was queried.
+     */
+    DWORD InProcToolsGeneration;
+
     /**
      The offset within NextCommand to initialize the cursor to.
      */
@@ -601,6 +919,13 @@ typedef struct _YORI_SH_GLOBALS {
      */
     BOOLEAN TaskUiActive;
 
+    /**
+     Set to TRUE if the user has requested that Yori tools found in the
+     shell's directory are executed as builtins where the shell has a builtin
+     with the same name.
+     */
+    BOOLEAN InProcTools;
+
     /**
      Set to TRUE to indicate child processes launched without explicit user
      request, including to generate prompts and titles.  This implies ignoring
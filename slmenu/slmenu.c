@@ -155,6 +155,7 @@ SlmenuFindButtonClicked(
                          &Title,
                          &MenuContext->SearchString,
                          &MatchCase,
+                         NULL,
                          &Text)) {
 
         return;
@@ -0,0 +1,1726 @@
+/**
+ * @file sort/sort.c
+ *
+ * Yori shell sort lines of text
+ *
+ * Copyright (c) 2026 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <yoripch.h>
+#include <yorilib.h>
+
+/**
+ Help text to display to the user.
+ */
+const
+CHAR strSortHelpText[] =
+        "\n"
+        "Sort lines of text.\n"
+        "\n"
+        "SORT [-license] [-b] [-s] [-f n] [-d <delimiter chars>] [-i] [-j <count>]\n"
+        "     [-m <size>] [-n] [-r] [-u] [file...]\n"
+        "\n"
+        "   -b             Use basic search criteria for files only\n"
+        "   -d             The set of characters which delimit fields, default comma\n"
+        "   -f n           The field number to sort by\n"
+        "   -i             Compare text case insensitively\n"
+        "   -j             Sort using count threads\n"
+        "   -m             Megabytes of lines to sort before using temporary files\n"
+        "   -n             Compare fields as numbers\n"
+        "   -r             Sort in reverse order\n"
+        "   -s             Match files from all subdirectories\n"
+        "   -u             Only output the first line for each unique field\n"
+        ;
+
+/**
+ Display usage text to the user.
+ */
+BOOL
+SortHelp(VOID)
+{
+    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("Sort %i.%02i\n"), YORI_VER_MAJOR, YORI_VER_MINOR);
+#if YORI_BUILD_ID
+    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("  Build %i\n"), YORI_BUILD_ID);
+#endif
+    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%hs"), strSortHelpText);
+    return TRUE;
+}
+
+/**
+ The maximum number of threads to sort with.
+ */
+#define SORT_MAX_WORKERS (64)
+
+/**
+ The minimum number of lines to give each thread.  Below this, the cost of
+ creating threads and merging their results outweighs the benefit.
+ */
+#define SORT_MIN_LINES_PER_WORKER (0x4000)
+
+/**
+ The default number of megabytes of lines to hold in memory before sorting
+ them and writing them to a temporary file.
+ */
+#define SORT_DEFAULT_MEMORY_MB (256)
+
+/**
+ The number of characters in each block of line data.  Lines longer than
+ this are placed in a block of their own.
+ */
+#define SORT_BLOCK_CHARS (512 * 1024)
+
+/**
+ The size of the buffer used to read and write each temporary file.
+ */
+#define SORT_FILE_BUFFER_SIZE (64 * 1024)
+
+/**
+ The maximum number of temporary files to keep.  When this many have been
+ written, they are merged into a single temporary file, so the number of
+ files open at once is bounded when the input is very large.
+ */
+#define SORT_MAX_TEMP_FILES (64)
+
+/**
+ A block of memory containing the characters of many lines.
+ */
+typedef struct _SORT_BLOCK {
+
+    /**
+     The next block in the list.
+     */
+    struct _SORT_BLOCK *Next;
+
+    /**
+     The number of characters in use in this block.
+     */
+    YORI_ALLOC_SIZE_T CharsUsed;
+
+    /**
+     The number of characters that can be stored in this block.
+     */
+    YORI_ALLOC_SIZE_T CharsAllocated;
+
+    /**
+     Pointer to the characters in this block, which follow the structure in
+     the same allocation.
+     */
+    LPTSTR Chars;
+
+} SORT_BLOCK, *PSORT_BLOCK;
+
+/**
+ Context describing the operations to perform on each file found.
+ */
+typedef struct _SORT_CONTEXT {
+
+    /**
+     TRUE if file enumeration is being performed recursively; FALSE if it is
+     in one directory only.
+     */
+    BOOLEAN Recursive;
+
+    /**
+     TRUE if lines should be compared by a single field.  If FALSE, the
+     entire line is compared.
+     */
+    BOOLEAN FieldDelimited;
+
+    /**
+     TRUE if comparisons should be case insensitive.
+     */
+    BOOLEAN CaseInsensitive;
+
+    /**
+     TRUE if fields should be compared as numbers.  Fields which are not
+     numbers are treated as zero.
+     */
+    BOOLEAN Numeric;
+
+    /**
+     TRUE if lines should be output from greatest to least.
+     */
+    BOOLEAN Reverse;
+
+    /**
+     TRUE if only the first line for each distinct field should be output.
+     */
+    BOOLEAN Unique;
+
+    /**
+     TRUE if an operation failed and the output would be incomplete.
+     */
+    BOOLEAN Failed;
+
+    /**
+     For a field delimited stream, contains the NULL terminated string
+     indicating one or more characters to interpret as delimiters.
+     */
+    LPTSTR FieldSeperator;
+
+    /**
+     For a field delimited stream, indicates the field number that should
+     be compared.
+     */
+    DWORD FieldOfInterest;
+
+    /**
+     The number of threads to sort with.
+     */
+    DWORD WorkerCount;
+
+    /**
+     The first error encountered when enumerating objects from a single arg.
+     This is used to preserve file not found/path not found errors so that
+     when the program falls back to interpreting the argument as a literal,
+     if that still doesn't work, this is the error code that is displayed.
+     */
+    DWORD SavedErrorThisArg;
+
+    /**
+     The number of bytes of lines to hold in memory before sorting them and
+     writing them to a temporary file.
+     */
+    YORI_MAX_UNSIGNED_T MemoryLimit;
+
+    /**
+     The number of bytes of memory used by the lines currently held.
+     */
+    YORI_MAX_UNSIGNED_T MemoryUsed;
+
+    /**
+     The first block of line data.
+     */
+    PSORT_BLOCK FirstBlock;
+
+    /**
+     The block of line data that new lines are added to.
+     */
+    PSORT_BLOCK CurrentBlock;
+
+    /**
+     An array of lines currently held in memory.  The characters of each
+     line are within a block.
+     */
+    PYORI_STRING Lines;
+
+    /**
+     The number of lines currently held in memory.
+     */
+    YORI_ALLOC_SIZE_T LineCount;
+
+    /**
+     The number of elements allocated in the Lines array.
+     */
+    YORI_ALLOC_SIZE_T LinesAllocated;
+
+    /**
+     The directory to create temporary files in.  This is empty until the
+     first temporary file is needed.
+     */
+    YORI_STRING TempPath;
+
+    /**
+     An array of temporary file names.  Each file contains sorted lines, and
+     files are ordered from the earliest input to the latest.
+     */
+    YORI_STRING TempFiles[SORT_MAX_TEMP_FILES];
+
+    /**
+     The number of temporary files in the TempFiles array.
+     */
+    DWORD TempFileCount;
+
+    /**
+     Counts the number of files encountered as files are processed.
+     */
+    LONGLONG FilesFound;
+
+    /**
+     Counts the number of files encountered as files are processed within each
+     command line argument.
+     */
+    LONGLONG FilesFoundThisArg;
+
+} SORT_CONTEXT, *PSORT_CONTEXT;
+
+/**
+ A range of lines to be sorted by a single thread.
+ */
+typedef struct _SORT_SEGMENT {
+
+    /**
+     Pointer to the sort context, describing how lines are compared.
+     */
+    PSORT_CONTEXT SortContext;
+
+    /**
+     Pointer to the first line in the range.
+     */
+    PYORI_STRING Lines;
+
+    /**
+     The number of lines in the range.
+     */
+    YORI_ALLOC_SIZE_T LineCount;
+
+    /**
+     Set to TRUE if the range was sorted successfully.
+     */
+    BOOL Succeeded;
+
+} SORT_SEGMENT, *PSORT_SEGMENT;
+
+/**
+ A buffered handle to a temporary file.
+ */
+typedef struct _SORT_FILE {
+
+    /**
+     Handle to the temporary file.
+     */
+    HANDLE hFile;
+
+    /**
+     The buffer of data read from or to be written to the file.
+     */
+    PUCHAR Buffer;
+
+    /**
+     The number of bytes of valid data in the buffer.
+     */
+    DWORD BytesInBuffer;
+
+    /**
+     When reading, the offset within the buffer of the next byte to return.
+     */
+    DWORD BufferOffset;
+
+} SORT_FILE, *PSORT_FILE;
+
+/**
+ A source of sorted lines to merge.  This is either a sorted range of lines
+ in memory or a temporary file.
+ */
+typedef struct _SORT_SOURCE {
+
+    /**
+     If the source is in memory, points to the next line to return.
+     */
+    PYORI_STRING Lines;
+
+    /**
+     If the source is in memory, the number of lines remaining.
+     */
+    YORI_ALLOC_SIZE_T LinesRemaining;
+
+    /**
+     If the source is a temporary file, the file to read from.  If the
+     source is in memory, hFile within this structure is NULL.
+     */
+    SORT_FILE File;
+
+    /**
+     If the source is a temporary file, an allocation to read each line
+     into.
+     */
+    YORI_STRING LineBuffer;
+
+    /**
+     The current line from this source.
+     */
+    YORI_STRING Current;
+
+} SORT_SOURCE, *PSORT_SOURCE;
+
+/**
+ Return the portion of a line that should be compared.
+
+ @param SortContext Pointer to the sort context, indicating the field to
+        compare.
+
+ @param Line Pointer to the line.
+
+ @param Key On completion, updated to point to the portion of the line to
+        compare.
+ */
+VOID
+SortGetKey(
+    __in PSORT_CONTEXT SortContext,
+    __in PYORI_STRING Line,
+    __out PYORI_STRING Key
+    )
+{
+    YORI_ALLOC_SIZE_T CurrentField;
+    YORI_ALLOC_SIZE_T CharsBeforeSeperator;
+
+    YoriLibInitEmptyString(Key);
+    Key->StartOfString = Line->StartOfString;
+    Key->LengthInChars = Line->LengthInChars;
+
+    if (!SortContext->FieldDelimited) {
+        return;
+    }
+
+    for (CurrentField = 0; CurrentField <= SortContext->FieldOfInterest; CurrentField++) {
+        CharsBeforeSeperator = YoriLibCntStringNotWithChars(Key, SortContext->FieldSeperator);
+        if (CurrentField == SortContext->FieldOfInterest) {
+            Key->LengthInChars = CharsBeforeSeperator;
+        } else {
+            Key->LengthInChars = Key->LengthInChars - CharsBeforeSeperator;
+            if (Key->LengthInChars == 0) {
+                break;
+            }
+            Key->LengthInChars -= 1;
+            Key->StartOfString = &Key->StartOfString[CharsBeforeSeperator + 1];
+        }
+    }
+}
+
+/**
+ Compare two lines according to the options specified by the user.
+
+ @param Str1 Pointer to the first line.
+
+ @param Str2 Pointer to the second line.
+
+ @param Context Pointer to the sort context.
+
+ @return Less than zero if the first line should be output before the second,
+         zero if they are equal, or greater than zero if the first line should
+         be output after the second.
+ */
+INT
+SortCompareLines(
+    __in PYORI_STRING Str1,
+    __in PYORI_STRING Str2,
+    __in PVOID Context
+    )
+{
+    PSORT_CONTEXT SortContext = (PSORT_CONTEXT)Context;
+    YORI_STRING Key1;
+    YORI_STRING Key2;
+    YORI_MAX_SIGNED_T Number1;
+    YORI_MAX_SIGNED_T Number2;
+    YORI_ALLOC_SIZE_T CharsConsumed;
+    INT Result;
+
+    SortGetKey(SortContext, Str1, &Key1);
+    SortGetKey(SortContext, Str2, &Key2);
+
+    if (SortContext->Numeric) {
+        if (!YoriLibStringToNumber(&Key1, TRUE, &Number1, &CharsConsumed)) {
+            Number1 = 0;
+        }
+        if (!YoriLibStringToNumber(&Key2, TRUE, &Number2, &CharsConsumed)) {
+            Number2 = 0;
+        }
+        Result = 0;
+        if (Number1 < Number2) {
+            Result = -1;
+        } else if (Number1 > Number2) {
+            Result = 1;
+        }
+    } else if (SortContext->CaseInsensitive) {
+        Result = YoriLibCompareStringIns(&Key1, &Key2);
+    } else {
+        Result = YoriLibCompareString(&Key1, &Key2);
+    }
+
+    if (SortContext->Reverse) {
+        Result = -Result;
+    }
+
+    return Result;
+}
+
+/**
+ Add a line to the set of lines held in memory.
+
+ @param SortContext Pointer to the sort context.
+
+ @param Line Pointer to the line to add.  The characters are copied into a
+        block owned by the sort context.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+SortAddLine(
+    __in PSORT_CONTEXT SortContext,
+    __in PYORI_STRING Line
+    )
+{
+    PSORT_BLOCK Block;
+    PYORI_STRING NewLines;
+    YORI_ALLOC_SIZE_T NewAllocated;
+    YORI_ALLOC_SIZE_T CharsToAllocate;
+
+    if (SortContext->LineCount == SortContext->LinesAllocated) {
+        NewAllocated = SortContext->LinesAllocated * 2;
+        if (NewAllocated < 0x1000) {
+            NewAllocated = 0x1000;
+        }
+        if (!YoriLibIsSizeAllocatable((YORI_MAX_UNSIGNED_T)NewAllocated * sizeof(YORI_STRING))) {
+            return FALSE;
+        }
+        NewLines = YoriLibMalloc((YORI_ALLOC_SIZE_T)(NewAllocated * sizeof(YORI_STRING)));
+        if (NewLines == NULL) {
+            return FALSE;
+        }
+        if (SortContext->Lines != NULL) {
+            memcpy(NewLines, SortContext->Lines, SortContext->LineCount * sizeof(YORI_STRING));
+            YoriLibFree(SortContext->Lines);
+        }
+        SortContext->Lines = NewLines;
+        SortContext->LinesAllocated = NewAllocated;
+    }
+
+    Block = SortContext->CurrentBlock;
+    if (Block == NULL ||
+        Block->CharsAllocated - Block->CharsUsed < Line->LengthInChars) {
+
+        CharsToAllocate = SORT_BLOCK_CHARS;
+        if (Line->LengthInChars > CharsToAllocate) {
+            CharsToAllocate = Line->LengthInChars;
+        }
+        if (!YoriLibIsSizeAllocatable(sizeof(SORT_BLOCK) + (YORI_MAX_UNSIGNED_T)CharsToAllocate * sizeof(TCHAR))) {
+            return FALSE;
+        }
+        Block = YoriLibMalloc((YORI_ALLOC_SIZE_T)(sizeof(SORT_BLOCK) + CharsToAllocate * sizeof(TCHAR)));
+        if (Block == NULL) {
+            return FALSE;
+        }
+        Block->Next = NULL;
+        Block->CharsUsed = 0;
+        Block->CharsAllocated = CharsToAllocate;
+        Block->Chars = (LPTSTR)(Block + 1);
+        if (SortContext->CurrentBlock == NULL) {
+            SortContext->FirstBlock = Block;
+        } else {
+            SortContext->CurrentBlock->Next = Block;
+        }
+        SortContext->CurrentBlock = Block;
+    }
+
+    YoriLibInitEmptyString(&SortContext->Lines[SortContext->LineCount]);
+    SortContext->Lines[SortContext->LineCount].StartOfString = &Block->Chars[Block->CharsUsed];
+    SortContext->Lines[SortContext->LineCount].LengthInChars = Line->LengthInChars;
+    memcpy(&Block->Chars[Block->CharsUsed], Line->StartOfString, Line->LengthInChars * sizeof(TCHAR));
+    Block->CharsUsed = Block->CharsUsed + Line->LengthInChars;
+    SortContext->LineCount++;
+    SortContext->MemoryUsed = SortContext->MemoryUsed + sizeof(YORI_STRING) + Line->LengthInChars * sizeof(TCHAR);
+
+    return TRUE;
+}
+
+/**
+ Free the lines held in memory, but retain the array describing them so it
+ can be used for the next set of lines.
+
+ @param SortContext Pointer to the sort context.
+ */
+VOID
+SortFreeLines(
+    __in PSORT_CONTEXT SortContext
+    )
+{
+    PSORT_BLOCK Block;
+    PSORT_BLOCK NextBlock;
+
+    Block = SortContext->FirstBlock;
+    while (Block != NULL) {
+        NextBlock = Block->Next;
+        YoriLibFree(Block);
+        Block = NextBlock;
+    }
+
+    SortContext->FirstBlock = NULL;
+    SortContext->CurrentBlock = NULL;
+    SortContext->LineCount = 0;
+    SortContext->MemoryUsed = 0;
+}
+
+/**
+ A thread function to sort a range of lines.
+
+ @param Context Pointer to the segment describing the range of lines.
+
+ @return Zero.
+ */
+DWORD WINAPI
+SortSegmentWorker(
+    __in PVOID Context
+    )
+{
+    PSORT_SEGMENT Segment = (PSORT_SEGMENT)Context;
+
+    Segment->Succeeded = YoriLibStableSortStringArray(Segment->Lines,
+                                                      Segment->LineCount,
+                                                      SortCompareLines,
+                                                      Segment->SortContext);
+    return 0;
+}
+
+/**
+ Sort the lines held in memory.  The lines are divided into ranges which
+ are each sorted on a separate thread, and the caller is expected to merge
+ the ranges.
+
+ @param SortContext Pointer to the sort context.
+
+ @param Segments Pointer to an array of SORT_MAX_WORKERS segments, populated
+        on completion with the ranges of sorted lines.
+
+ @param SegmentCount On successful completion, updated to indicate the number
+        of segments populated.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+SortSortLines(
+    __in PSORT_CONTEXT SortContext,
+    __out_ecount(SORT_MAX_WORKERS) PSORT_SEGMENT Segments,
+    __out PDWORD SegmentCount
+    )
+{
+    HANDLE Threads[SORT_MAX_WORKERS];
+    YORI_ALLOC_SIZE_T LinesPerSegment;
+    DWORD ThreadId;
+    DWORD Count;
+    DWORD Index;
+    BOOLEAN Succeeded;
+
+    Count = SortContext->WorkerCount;
+    if (Count > SortContext->LineCount / SORT_MIN_LINES_PER_WORKER) {
+        Count = SortContext->LineCount / SORT_MIN_LINES_PER_WORKER;
+    }
+    if (Count == 0) {
+        Count = 1;
+    }
+
+    LinesPerSegment = SortContext->LineCount / Count;
+    for (Index = 0; Index < Count; Index++) {
+        Segments[Index].SortContext = SortContext;
+        Segments[Index].Lines = &SortContext->Lines[Index * LinesPerSegment];
+        Segments[Index].LineCount = LinesPerSegment;
+        Segments[Index].Succeeded = FALSE;
+    }
+    Segments[Count - 1].LineCount = SortContext->LineCount - (Count - 1) * LinesPerSegment;
+
+    //
+    //  Sort the final range on this thread.  If a thread cannot be
+    //  created, sort its range on this thread too.
+    //
+
+    for (Index = 0; Index < Count - 1; Index++) {
+        Threads[Index] = CreateThread(NULL, 0, SortSegmentWorker, &Segments[Index], 0, &ThreadId);
+        if (Threads[Index] == NULL) {
+            SortSegmentWorker(&Segments[Index]);
+        }
+    }
+
+    SortSegmentWorker(&Segments[Count - 1]);
+
+    for (Index = 0; Index < Count - 1; Index++) {
+        if (Threads[Index] != NULL) {
+            WaitForSingleObject(Threads[Index], INFINITE);
+            CloseHandle(Threads[Index]);
+        }
+    }
+
+    Succeeded = TRUE;
+    for (Index = 0; Index < Count; Index++) {
+        if (!Segments[Index].Succeeded) {
+            Succeeded = FALSE;
+        }
+    }
+
+    if (!Succeeded) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("sort: out of memory\n"));
+        return FALSE;
+    }
+
+    *SegmentCount = Count;
+    return TRUE;
+}
+
+/**
+ Write the contents of a temporary file buffer to the file.
+
+ @param File Pointer to the temporary file.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+SortFileFlush(
+    __in PSORT_FILE File
+    )
+{
+    DWORD BytesWritten;
+
+    if (File->BytesInBuffer > 0) {
+        if (!WriteFile(File->hFile, File->Buffer, File->BytesInBuffer, &BytesWritten, NULL) ||
+            BytesWritten != File->BytesInBuffer) {
+
+            return FALSE;
+        }
+        File->BytesInBuffer = 0;
+    }
+
+    return TRUE;
+}
+
+/**
+ Write data to a temporary file via its buffer.
+
+ @param File Pointer to the temporary file.
+
+ @param Data Pointer to the data to write.
+
+ @param Length The number of bytes to write.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+SortFileWrite(
+    __in PSORT_FILE File,
+    __in PVOID Data,
+    __in DWORD Length
+    )
+{
+    DWORD BytesThisCopy;
+    DWORD BytesCopied;
+
+    BytesCopied = 0;
+    while (BytesCopied < Length) {
+        if (File->BytesInBuffer == SORT_FILE_BUFFER_SIZE) {
+            if (!SortFileFlush(File)) {
+                return FALSE;
+            }
+        }
+        BytesThisCopy = SORT_FILE_BUFFER_SIZE - File->BytesInBuffer;
+        if (BytesThisCopy > Length - BytesCopied) {
+            BytesThisCopy = Length - BytesCopied;
+        }
+        memcpy(&File->Buffer[File->BytesInBuffer], (PUCHAR)Data + BytesCopied, BytesThisCopy);
+        File->BytesInBuffer = File->BytesInBuffer + BytesThisCopy;
+        BytesCopied = BytesCopied + BytesThisCopy;
+    }
+
+    return TRUE;
+}
+
+/**
+ Read data from a temporary file via its buffer.
+
+ @param File Pointer to the temporary file.
+
+ @param Data Pointer to a buffer to receive the data.
+
+ @param Length The number of bytes to read.
+
+ @return The number of bytes read, which is less than Length only if the
+         end of the file is reached or the file cannot be read.
+ */
+DWORD
+SortFileRead(
+    __in PSORT_FILE File,
+    __out_bcount(Length) PVOID Data,
+    __in DWORD Length
+    )
+{
+    DWORD BytesThisCopy;
+    DWORD BytesCopied;
+    DWORD BytesRead;
+
+    BytesCopied = 0;
+    while (BytesCopied < Length) {
+        if (File->BufferOffset == File->BytesInBuffer) {
+            File->BufferOffset = 0;
+            File->BytesInBuffer = 0;
+            if (!ReadFile(File->hFile, File->Buffer, SORT_FILE_BUFFER_SIZE, &BytesRead, NULL) ||
+                BytesRead == 0) {
+
+                break;
+            }
+            File->BytesInBuffer = BytesRead;
+        }
+        BytesThisCopy = File->BytesInBuffer - File->BufferOffset;
+        if (BytesThisCopy > Length - BytesCopied) {
+            BytesThisCopy = Length - BytesCopied;
+        }
+        memcpy((PUCHAR)Data + BytesCopied, &File->Buffer[File->BufferOffset], BytesThisCopy);
+        File->BufferOffset = File->BufferOffset + BytesThisCopy;
+        BytesCopied = BytesCopied + BytesThisCopy;
+    }
+
+    return BytesCopied;
+}
+
+/**
+ Open a temporary file and allocate its buffer.
+
+ @param FileName Pointer to the name of the temporary file to open.
+
+ @param File On successful completion, populated with the opened file.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+SortFileOpen(
+    __in PYORI_STRING FileName,
+    __out PSORT_FILE File
+    )
+{
+    ZeroMemory(File, sizeof(SORT_FILE));
+    File->Buffer = YoriLibMalloc(SORT_FILE_BUFFER_SIZE);
+    if (File->Buffer == NULL) {
+        return FALSE;
+    }
+
+    File->hFile = CreateFile(FileName->StartOfString,
+                             GENERIC_READ,
+                             FILE_SHARE_READ | FILE_SHARE_DELETE,
+                             NULL,
+                             OPEN_EXISTING,
+                             FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
+                             NULL);
+    if (File->hFile == INVALID_HANDLE_VALUE) {
+        YoriLibFree(File->Buffer);
+        File->Buffer = NULL;
+        File->hFile = NULL;
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ Close a temporary file and free its buffer.
+
+ @param File Pointer to the temporary file.
+ */
+VOID
+SortFileClose(
+    __in PSORT_FILE File
+    )
+{
+    if (File->hFile != NULL) {
+        CloseHandle(File->hFile);
+        File->hFile = NULL;
+    }
+    if (File->Buffer != NULL) {
+        YoriLibFree(File->Buffer);
+        File->Buffer = NULL;
+    }
+}
+
+/**
+ Advance a source to its next line.
+
+ @param Source Pointer to the source.
+
+ @return TRUE if the source has a line, FALSE if the source is exhausted.
+ */
+BOOLEAN
+SortSourceNext(
+    __in PSORT_SOURCE Source
+    )
+{
+    DWORD LengthInChars;
+
+    if (Source->File.hFile == NULL) {
+        if (Source->LinesRemaining == 0) {
+            return FALSE;
+        }
+        memcpy(&Source->Current, Source->Lines, sizeof(YORI_STRING));
+        Source->Lines++;
+        Source->LinesRemaining--;
+        return TRUE;
+    }
+
+    if (SortFileRead(&Source->File, &LengthInChars, sizeof(LengthInChars)) != sizeof(LengthInChars)) {
+        return FALSE;
+    }
+
+    if (LengthInChars > Source->LineBuffer.LengthAllocated) {
+        if (!YoriLibReallocStringNoContents(&Source->LineBuffer, (YORI_ALLOC_SIZE_T)LengthInChars)) {
+            return FALSE;
+        }
+    }
+
+    if (SortFileRead(&Source->File, Source->LineBuffer.StartOfString, LengthInChars * sizeof(TCHAR)) != LengthInChars * sizeof(TCHAR)) {
+        return FALSE;
+    }
+
+    Source->LineBuffer.LengthInChars = (YORI_ALLOC_SIZE_T)LengthInChars;
+    YoriLibInitEmptyString(&Source->Current);
+    Source->Current.StartOfString = Source->LineBuffer.StartOfString;
+    Source->Current.LengthInChars = Source->LineBuffer.LengthInChars;
+    return TRUE;
+}
+
+/**
+ Determine if the current line in one source should be output before the
+ current line in another.  Lines which are equal are output from the source
+ that occurs earlier in the input, so the sort remains stable.
+
+ @param SortContext Pointer to the sort context.
+
+ @param Sources Pointer to the array of sources.
+
+ @param First The index of the first source.
+
+ @param Second The index of the second source.
+
+ @return TRUE if the line from the first source should be output before the
+         line from the second source.
+ */
+BOOLEAN
+SortSourceLess(
+    __in PSORT_CONTEXT SortContext,
+    __in PSORT_SOURCE Sources,
+    __in DWORD First,
+    __in DWORD Second
+    )
+{
+    INT Result;
+
+    Result = SortCompareLines(&Sources[First].Current, &Sources[Second].Current, SortContext);
+    if (Result != 0) {
+        return (BOOLEAN)(Result < 0);
+    }
+
+    return (BOOLEAN)(First < Second);
+}
+
+/**
+ Move an entry in the heap of sources down until both of its children are
+ greater than it.
+
+ @param SortContext Pointer to the sort context.
+
+ @param Sources Pointer to the array of sources.
+
+ @param Heap Pointer to an array of source indexes arranged as a heap.
+
+ @param HeapCount The number of entries in the heap.
+
+ @param Index The index of the heap entry to move.
+ */
+VOID
+SortHeapSiftDown(
+    __in PSORT_CONTEXT SortContext,
+    __in PSORT_SOURCE Sources,
+    __inout PDWORD Heap,
+    __in DWORD HeapCount,
+    __in DWORD Index
+    )
+{
+    DWORD Child;
+    DWORD Swap;
+
+    while (TRUE) {
+        Child = Index * 2 + 1;
+        if (Child >= HeapCount) {
+            break;
+        }
+        if (Child + 1 < HeapCount &&
+            SortSourceLess(SortContext, Sources, Heap[Child + 1], Heap[Child])) {
+
+            Child = Child + 1;
+        }
+        if (!SortSourceLess(SortContext, Sources, Heap[Child], Heap[Index])) {
+            break;
+        }
+        Swap = Heap[Index];
+        Heap[Index] = Heap[Child];
+        Heap[Child] = Swap;
+        Index = Child;
+    }
+}
+
+/**
+ Merge sorted sources, writing the result either to a temporary file or to
+ standard output.
+
+ @param SortContext Pointer to the sort context.
+
+ @param Sources Pointer to an array of sources.  The current line of each
+        source is populated by this routine.
+
+ @param SourceCount The number of sources.
+
+ @param Target Optionally points to a temporary file to write lines to.  If
+        NULL, lines are written to standard output.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+SortMergeSources(
+    __in PSORT_CONTEXT SortContext,
+    __in PSORT_SOURCE Sources,
+    __in DWORD SourceCount,
+    __in_opt PSORT_FILE Target
+    )
+{
+    PDWORD Heap;
+    DWORD HeapCount;
+    DWORD Index;
+    DWORD LengthInChars;
+    PSORT_SOURCE Source;
+    YORI_STRING PreviousLine;
+    BOOLEAN HavePreviousLine;
+    BOOLEAN Duplicate;
+    BOOLEAN Result;
+
+    Heap = YoriLibMalloc((YORI_ALLOC_SIZE_T)(SourceCount * sizeof(DWORD)));
+    if (Heap == NULL) {
+        return FALSE;
+    }
+
+    HeapCount = 0;
+    for (Index = 0; Index < SourceCount; Index++) {
+        if (SortSourceNext(&Sources[Index])) {
+            Heap[HeapCount] = Index;
+            HeapCount++;
+        }
+    }
+
+    for (Index = HeapCount / 2; Index > 0; Index--) {
+        SortHeapSiftDown(SortContext, Sources, Heap, HeapCount, Index - 1);
+    }
+
+    YoriLibInitEmptyString(&PreviousLine);
+    HavePreviousLine = FALSE;
+    Result = TRUE;
+
+    while (HeapCount > 0) {
+        Source = &Sources[Heap[0]];
+
+        //
+        //  When only unique lines are requested, the first line with each
+        //  value is output.  Later lines with the same value follow it
+        //  because the merge is stable.
+        //
+
+        Duplicate = FALSE;
+        if (SortContext->Unique &&
+            HavePreviousLine &&
+            SortCompareLines(&PreviousLine, &Source->Current, SortContext) == 0) {
+
+            Duplicate = TRUE;
+        }
+
+        if (!Duplicate) {
+            if (Target != NULL) {
+                LengthInChars = Source->Current.LengthInChars;
+                if (!SortFileWrite(Target, &LengthInChars, sizeof(LengthInChars)) ||
+                    !SortFileWrite(Target, Source->Current.StartOfString, LengthInChars * sizeof(TCHAR))) {
+
+                    Result = FALSE;
+                    break;
+                }
+            } else {
+                YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y\n"), &Source->Current);
+            }
+
+            if (SortContext->Unique) {
+                if (Source->Current.LengthInChars > PreviousLine.LengthAllocated) {
+                    if (!YoriLibReallocStringNoContents(&PreviousLine, Source->Current.LengthInChars)) {
+                        Result = FALSE;
+                        break;
+                    }
+                }
+                memcpy(PreviousLine.StartOfString, Source->Current.StartOfString, Source->Current.LengthInChars * sizeof(TCHAR));
+                PreviousLine.LengthInChars = Source->Current.LengthInChars;
+                HavePreviousLine = TRUE;
+            }
+        }
+
+        if (!SortSourceNext(Source)) {
+            HeapCount--;
+            Heap[0] = Heap[HeapCount];
+        }
+        SortHeapSiftDown(SortContext, Sources, Heap, HeapCount, 0);
+
+        if (YoriLibIsOperationCancelled()) {
+            Result = FALSE;
+            break;
+        }
+    }
+
+    YoriLibFreeStringContents(&PreviousLine);
+    YoriLibFree(Heap);
+
+    if (Result && Target != NULL) {
+        Result = SortFileFlush(Target);
+    }
+
+    return Result;
+}
+
+/**
+ Create a new temporary file to write sorted lines to.
+
+ @param SortContext Pointer to the sort context.
+
+ @param FileName On successful completion, populated with the name of the
+        temporary file.
+
+ @param File On successful completion, populated with the opened file.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+SortCreateTempFile(
+    __in PSORT_CONTEXT SortContext,
+    __out PYORI_STRING FileName,
+    __out PSORT_FILE File
+    )
+{
+    YORI_STRING Prefix;
+
+    if (SortContext->TempPath.LengthInChars == 0) {
+        if (!YoriLibGetTempPath(&SortContext->TempPath, 0)) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("sort: could not find temporary directory\n"));
+            return FALSE;
+        }
+    }
+
+    ZeroMemory(File, sizeof(SORT_FILE));
+    File->Buffer = YoriLibMalloc(SORT_FILE_BUFFER_SIZE);
+    if (File->Buffer == NULL) {
+        return FALSE;
+    }
+
+    YoriLibConstantString(&Prefix, _T("SRT"));
+    if (!YoriLibGetTempFileName(&SortContext->TempPath, &Prefix, &File->hFile, FileName)) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("sort: could not create temporary file in %y\n"), &SortContext->TempPath);
+        YoriLibFree(File->Buffer);
+        File->Buffer = NULL;
+        File->hFile = NULL;
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ Merge sorted ranges of lines and temporary files.
+
+ @param SortContext Pointer to the sort context.
+
+ @param Segments Pointer to an array of sorted ranges of lines in memory.
+
+ @param SegmentCount The number of elements in the Segments array.
+
+ @param UseFiles If TRUE, the temporary files in the sort context are
+        merged ahead of the ranges in memory.
+
+ @param Target Optionally points to a temporary file to write lines to.  If
+        NULL, lines are written to standard output.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+SortMerge(
+    __in PSORT_CONTEXT SortContext,
+    __in_ecount(SegmentCount) PSORT_SEGMENT Segments,
+    __in DWORD SegmentCount,
+    __in BOOLEAN UseFiles,
+    __in_opt PSORT_FILE Target
+    )
+{
+    PSORT_SOURCE Sources;
+    DWORD SourceCount;
+    DWORD FileCount;
+    DWORD Index;
+    BOOLEAN Result;
+
+    FileCount = 0;
+    if (UseFiles) {
+        FileCount = SortContext->TempFileCount;
+    }
+
+    SourceCount = FileCount + SegmentCount;
+    if (SourceCount == 0) {
+        return TRUE;
+    }
+
+    Sources = YoriLibMalloc((YORI_ALLOC_SIZE_T)(SourceCount * sizeof(SORT_SOURCE)));
+    if (Sources == NULL) {
+        return FALSE;
+    }
+    ZeroMemory(Sources, SourceCount * sizeof(SORT_SOURCE));
+
+    Result = TRUE;
+    for (Index = 0; Index < FileCount; Index++) {
+        if (!SortFileOpen(&SortContext->TempFiles[Index], &Sources[Index].File)) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("sort: could not open temporary file %y\n"), &SortContext->TempFiles[Index]);
+            Result = FALSE;
+            break;
+        }
+    }
+
+    for (Index = 0; Index < SegmentCount; Index++) {
+        Sources[FileCount + Index].Lines = Segments[Index].Lines;
+        Sources[FileCount + Index].LinesRemaining = Segments[Index].LineCount;
+    }
+
+    if (Result) {
+        Result = SortMergeSources(SortContext, Sources, SourceCount, Target);
+    }
+
+    for (Index = 0; Index < SourceCount; Index++) {
+        SortFileClose(&Sources[Index].File);
+        YoriLibFreeStringContents(&Sources[Index].LineBuffer);
+    }
+
+    YoriLibFree(Sources);
+    return Result;
+}
+
+/**
+ Delete the temporary files in the sort context.
+
+ @param SortContext Pointer to the sort context.
+ */
+VOID
+SortDeleteTempFiles(
+    __in PSORT_CONTEXT SortContext
+    )
+{
+    DWORD Index;
+
+    for (Index = 0; Index < SortContext->TempFileCount; Index++) {
+        DeleteFile(SortContext->TempFiles[Index].StartOfString);
+        YoriLibFreeStringContents(&SortContext->TempFiles[Index]);
+    }
+    SortContext->TempFileCount = 0;
+}
+
+/**
+ Sort the lines held in memory and write them to a new temporary file.  If
+ the maximum number of temporary files exist, they are merged into a single
+ file first.
+
+ @param SortContext Pointer to the sort context.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+SortSpillLines(
+    __in PSORT_CONTEXT SortContext
+    )
+{
+    SORT_SEGMENT Segments[SORT_MAX_WORKERS];
+    DWORD SegmentCount;
+    YORI_STRING FileName;
+    SORT_FILE File;
+    BOOLEAN Result;
+
+    if (SortContext->TempFileCount == SORT_MAX_TEMP_FILES) {
+        if (!SortCreateTempFile(SortContext, &FileName, &File)) {
+            return FALSE;
+        }
+        Result = SortMerge(SortContext, NULL, 0, TRUE, &File);
+        SortFileClose(&File);
+        SortDeleteTempFiles(SortContext);
+        memcpy(&SortContext->TempFiles[0], &FileName, sizeof(YORI_STRING));
+        SortContext->TempFileCount = 1;
+        if (!Result) {
+            return FALSE;
+        }
+    }
+
+    if (!SortSortLines(SortContext, Segments, &SegmentCount)) {
+        return FALSE;
+    }
+
+    if (!SortCreateTempFile(SortContext, &FileName, &File)) {
+        return FALSE;
+    }
+
+    Result = SortMerge(SortContext, Segments, SegmentCount, FALSE, &File);
+    SortFileClose(&File);
+    memcpy(&SortContext->TempFiles[SortContext->TempFileCount], &FileName, sizeof(YORI_STRING));
+    SortContext->TempFileCount++;
+    if (!Result) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("sort: could not write temporary file %y\n"), &FileName);
+        return FALSE;
+    }
+
+    SortFreeLines(SortContext);
+    return TRUE;
+}
+
+/**
+ Read lines from a single handle and add them to the set of lines to sort.
+
+ @param hSource The source handle containing lines to sort.
+
+ @param SortContext Pointer to the sort context.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+SortProcessStream(
+    __in HANDLE hSource,
+    __in PSORT_CONTEXT SortContext
+    )
+{
+    PVOID LineContext = NULL;
+    YORI_STRING LineString;
+    BOOLEAN Result;
+
+    YoriLibInitEmptyString(&LineString);
+    Result = TRUE;
+
+    while (TRUE) {
+        if (!YoriLibReadLineToView(&LineString, &LineContext, hSource)) {
+            break;
+        }
+
+        if (YoriLibIsOperationCancelled()) {
+            Result = FALSE;
+            break;
+        }
+
+        if (!SortAddLine(SortContext, &LineString)) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("sort: out of memory\n"));
+            Result = FALSE;
+            break;
+        }
+
+        if (SortContext->MemoryUsed >= SortContext->MemoryLimit) {
+            if (!SortSpillLines(SortContext)) {
+                Result = FALSE;
+                break;
+            }
+        }
+    }
+
+    YoriLibLineReadCloseOrCache(LineContext);
+
+    if (!Result) {
+        SortContext->Failed = TRUE;
+    }
+
+    return Result;
+}
+
+/**
+ A callback that is invoked when a file is found that matches a search criteria
+ specified in the set of strings to enumerate.
+
+ @param FilePath Pointer to the file path that was found.
+
+ @param FileInfo Information about the file.  This can be NULL if the file
+        was not found by enumeration.
+
+ @param Depth Specifies the recursion depth.  Ignored in this application.
+
+ @param Context Pointer to the sort context structure.
+
+ @return TRUE to continute enumerating, FALSE to abort.
+ */
+BOOL
+SortFileFoundCallback(
+    __in PYORI_STRING FilePath,
+    __in_opt PWIN32_FIND_DATA FileInfo,
+    __in DWORD Depth,
+    __in PVOID Context
+    )
+{
+    HANDLE FileHandle;
+    PSORT_CONTEXT SortContext = (PSORT_CONTEXT)Context;
+
+    UNREFERENCED_PARAMETER(Depth);
+
+    ASSERT(YoriLibIsStringNullTerminated(FilePath));
+
+    if (FileInfo == NULL ||
+        (FileInfo->dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == 0) {
+
+        FileHandle = CreateFile(FilePath->StartOfString,
+                                GENERIC_READ,
+                                FILE_SHARE_READ | FILE_SHARE_DELETE,
+                                NULL,
+                                OPEN_EXISTING,
+                                FILE_ATTRIBUTE_NORMAL | FILE_FLAG_BACKUP_SEMANTICS,
+                                NULL);
+
+        if (FileHandle == NULL || FileHandle == INVALID_HANDLE_VALUE) {
+            if (SortContext->SavedErrorThisArg == ERROR_SUCCESS) {
+                DWORD LastError = GetLastError();
+                LPTSTR ErrText = YoriLibGetWinErrorText(LastError);
+                YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("sort: open of %y failed: %s"), FilePath, ErrText);
+                YoriLibFreeWinErrorText(ErrText);
+            }
+            return TRUE;
+        }
+
+        SortContext->SavedErrorThisArg = ERROR_SUCCESS;
+        SortContext->FilesFound++;
+        SortContext->FilesFoundThisArg++;
+        if (!SortProcessStream(FileHandle, SortContext)) {
+            CloseHandle(FileHandle);
+            return FALSE;
+        }
+
+        CloseHandle(FileHandle);
+    }
+
+    return TRUE;
+}
+
+/**
+ A callback that is invoked when a directory cannot be successfully enumerated.
+
+ @param FilePath Pointer to the file path that could not be enumerated.
+
+ @param ErrorCode The Win32 error code describing the failure.
+
+ @param Depth Recursion depth, ignored in this application.
+
+ @param Context Pointer to the context block indicating whether the
+        enumeration was recursive.  Recursive enumerates do not complain
+        if a matching file is not in every single directory, because
+        common usage expects files to be in a subset of directories only.
+
+ @return TRUE to continute enumerating, FALSE to abort.
+ */
+BOOL
+SortFileEnumerateErrorCallback(
+    __in PYORI_STRING FilePath,
+    __in DWORD ErrorCode,
+    __in DWORD Depth,
+    __in PVOID Context
+    )
+{
+    YORI_STRING UnescapedFilePath;
+    BOOL Result = FALSE;
+    PSORT_CONTEXT SortContext = (PSORT_CONTEXT)Context;
+
+    UNREFERENCED_PARAMETER(Depth);
+
+    YoriLibInitEmptyString(&UnescapedFilePath);
+    if (!YoriLibUnescapePath(FilePath, &UnescapedFilePath)) {
+        UnescapedFilePath.StartOfString = FilePath->StartOfString;
+        UnescapedFilePath.LengthInChars = FilePath->LengthInChars;
+    }
+
+    if (ErrorCode == ERROR_FILE_NOT_FOUND || ErrorCode == ERROR_PATH_NOT_FOUND) {
+        if (!SortContext->Recursive) {
+            SortContext->SavedErrorThisArg = ErrorCode;
+        }
+        Result = TRUE;
+    } else {
+        LPTSTR ErrText = YoriLibGetWinErrorText(ErrorCode);
+        YORI_STRING DirName;
+        LPTSTR FilePart;
+        YoriLibInitEmptyString(&DirName);
+        DirName.StartOfString = UnescapedFilePath.StartOfString;
+        FilePart = YoriLibFindRightMostCharacter(&UnescapedFilePath, '\\');
+        if (FilePart != NULL) {
+            DirName.LengthInChars = (YORI_ALLOC_SIZE_T)(FilePart - DirName.StartOfString);
+        } else {
+            DirName.LengthInChars = UnescapedFilePath.LengthInChars;
+        }
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("sort: Enumerate of %y failed: %s"), &DirName, ErrText);
+        YoriLibFreeWinErrorText(ErrText);
+    }
+    YoriLibFreeStringContents(&UnescapedFilePath);
+    return Result;
+}
+
+/**
+ Sort any lines remaining in memory, merge them with any temporary files,
+ and write the result to standard output.
+
+ @param SortContext Pointer to the sort context.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+SortOutputLines(
+    __in PSORT_CONTEXT SortContext
+    )
+{
+    SORT_SEGMENT Segments[SORT_MAX_WORKERS];
+    DWORD SegmentCount;
+    BOOLEAN Result;
+
+    SegmentCount = 0;
+    if (SortContext->LineCount > 0) {
+        if (!SortSortLines(SortContext, Segments, &SegmentCount)) {
+            return FALSE;
+        }
+    }
+
+    YoriLibOutputBufferEnable(GetStdHandle(STD_OUTPUT_HANDLE));
+    Result = SortMerge(SortContext, Segments, SegmentCount, TRUE, NULL);
+    YoriLibOutputBufferDisable(GetStdHandle(STD_OUTPUT_HANDLE));
+
+    return Result;
+}
+
+/**
+ Free all memory and temporary files associated with the sort context.
+
+ @param SortContext Pointer to the sort context.
+ */
+VOID
+SortCleanupContext(
+    __in PSORT_CONTEXT SortContext
+    )
+{
+    SortFreeLines(SortContext);
+    if (SortContext->Lines != NULL) {
+        YoriLibFree(SortContext->Lines);
+        SortContext->Lines = NULL;
+    }
+    SortContext->LinesAllocated = 0;
+    SortDeleteTempFiles(SortContext);
+    YoriLibFreeStringContents(&SortContext->TempPath);
+}
+
+#ifdef YORI_BUILTIN
+/**
+ The main entrypoint for the sort builtin command.
+ */
+#define ENTRYPOINT YoriCmd_YSORT
+#else
+/**
+ The main entrypoint for the sort standalone application.
+ */
+#define ENTRYPOINT ymain
+#endif
+
+/**
+ The main entrypoint for the sort cmdlet.
+
+ @param ArgC The number of arguments.
+
+ @param ArgV An array of arguments.
+
+ @return Exit code of zero to indicate success, nonzero to indicate failure.
+ */
+DWORD
+ENTRYPOINT(
+    __in YORI_ALLOC_SIZE_T ArgC,
+    __in YORI_STRING ArgV[]
+    )
+{
+    BOOLEAN ArgumentUnderstood;
+    YORI_ALLOC_SIZE_T i;
+    YORI_ALLOC_SIZE_T StartArg = 0;
+    YORI_ALLOC_SIZE_T CharsConsumed;
+    YORI_MAX_SIGNED_T Temp;
+    SORT_CONTEXT SortContext;
+    BOOLEAN BasicEnumeration = FALSE;
+    YORI_STRING Arg;
+    DWORD Result;
+
+    ZeroMemory(&SortContext, sizeof(SortContext));
+    SortContext.WorkerCount = 1;
+    SortContext.MemoryLimit = (YORI_MAX_UNSIGNED_T)SORT_DEFAULT_MEMORY_MB * 1024 * 1024;
+
+    for (i = 1; i < ArgC; i++) {
+
+        ArgumentUnderstood = FALSE;
+        ASSERT(YoriLibIsStringNullTerminated(&ArgV[i]));
+
+        if (YoriLibIsCommandLineOption(&ArgV[i], &Arg)) {
+
+            if (YoriLibCompareStringLitIns(&Arg, _T("?")) == 0) {
+                SortHelp();
+                return EXIT_SUCCESS;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("license")) == 0) {
+                YoriLibDisplayMitLicense(_T("2026"));
+                return EXIT_SUCCESS;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("b")) == 0) {
+                BasicEnumeration = TRUE;
+                ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("d")) == 0) {
+                if (ArgC > i + 1) {
+                    SortContext.FieldDelimited = TRUE;
+                    SortContext.FieldSeperator = ArgV[i + 1].StartOfString;
+                    ArgumentUnderstood = TRUE;
+                    i++;
+                }
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("f")) == 0) {
+                if (ArgC > i + 1) {
+                    if (YoriLibStringToNumber(&ArgV[i + 1], TRUE, &Temp, &CharsConsumed) &&
+                        Temp >= 0) {
+
+                        SortContext.FieldDelimited = TRUE;
+                        SortContext.FieldOfInterest = (DWORD)Temp;
+                        ArgumentUnderstood = TRUE;
+                        i++;
+                    }
+                }
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("i")) == 0) {
+                SortContext.CaseInsensitive = TRUE;
+                ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("j")) == 0) {
+                if (ArgC > i + 1) {
+                    if (YoriLibStringToNumber(&ArgV[i + 1], TRUE, &Temp, &CharsConsumed) &&
+                        CharsConsumed > 0) {
+
+                        if (Temp < 1) {
+                            Temp = 1;
+                        } else if (Temp > SORT_MAX_WORKERS) {
+                            Temp = SORT_MAX_WORKERS;
+                        }
+                        SortContext.WorkerCount = (DWORD)Temp;
+                        ArgumentUnderstood = TRUE;
+                        i++;
+                    }
+                }
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("m")) == 0) {
+                if (ArgC > i + 1) {
+                    if (YoriLibStringToNumber(&ArgV[i + 1], TRUE, &Temp, &CharsConsumed) &&
+                        CharsConsumed > 0 &&
+                        Temp > 0) {
+
+                        SortContext.MemoryLimit = (YORI_MAX_UNSIGNED_T)Temp * 1024 * 1024;
+                        ArgumentUnderstood = TRUE;
+                        i++;
+                    }
+                }
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("n")) == 0) {
+                SortContext.Numeric = TRUE;
+                ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("r")) == 0) {
+                SortContext.Reverse = TRUE;
+                ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("s")) == 0) {
+                SortContext.Recursive = TRUE;
+                ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("u")) == 0) {
+                SortContext.Unique = TRUE;
+                ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("-")) == 0) {
+                ArgumentUnderstood = TRUE;
+                StartArg = i + 1;
+                break;
+            }
+        } else {
+            ArgumentUnderstood = TRUE;
+            StartArg = i;
+            break;
+        }
+
+        if (!ArgumentUnderstood) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Argument not understood, ignored: %y\n"), &ArgV[i]);
+        }
+    }
+
+    if (SortContext.FieldSeperator == NULL) {
+        SortContext.FieldSeperator = _T(",");
+    }
+
+#if YORI_BUILTIN
+    YoriLibCancelEnable(FALSE);
+#endif
+
+    //
+    //  Attempt to enable backup privilege so an administrator can access more
+    //  objects successfully.
+    //
+
+    YoriLibEnableBackupPrivilege();
+
+    if (StartArg == 0 || StartArg == ArgC) {
+        if (YoriLibIsStdInConsole()) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("sort: No file or pipe for input\n"));
+            return EXIT_FAILURE;
+        }
+
+        SortProcessStream(GetStdHandle(STD_INPUT_HANDLE), &SortContext);
+    } else {
+        WORD MatchFlags = YORILIB_FILEENUM_RETURN_FILES | YORILIB_FILEENUM_DIRECTORY_CONTENTS;
+        if (SortContext.Recursive) {
+            MatchFlags |= YORILIB_FILEENUM_RECURSE_BEFORE_RETURN;
+        }
+        if (BasicEnumeration) {
+            MatchFlags |= YORILIB_FILEENUM_BASIC_EXPANSION;
+        }
+
+        for (i = StartArg; i < ArgC && !SortContext.Failed; i++) {
+
+            SortContext.FilesFoundThisArg = 0;
+            SortContext.SavedErrorThisArg = ERROR_SUCCESS;
+
+            YoriLibForEachStream(&ArgV[i],
+                                 MatchFlags,
+                                 0,
+                                 SortFileFoundCallback,
+                                 SortFileEnumerateErrorCallback,
+                                 &SortContext);
+
+            if (SortContext.FilesFoundThisArg == 0 && !SortContext.Failed) {
+                YORI_STRING FullPath;
+                YoriLibInitEmptyString(&FullPath);
+                if (YoriLibUserStringToSingleFilePathOrDevice(&ArgV[i], TRUE, &FullPath)) {
+                    SortFileFoundCallback(&FullPath, NULL, 0, &SortContext);
+                    YoriLibFreeStringContents(&FullPath);
+                }
+                if (SortContext.SavedErrorThisArg != ERROR_SUCCESS) {
+                    YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("sort: File or directory not found: %y\n"), &ArgV[i]);
+                }
+            }
+        }
+
+        if (SortContext.FilesFound == 0 && !SortContext.Failed) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("sort: no matching files found\n"));
+            SortContext.Failed = TRUE;
+        }
+    }
+
+    Result = EXIT_SUCCESS;
+    if (SortContext.Failed || !SortOutputLines(&SortContext)) {
+        Result = EXIT_FAILURE;
+    }
+
+    SortCleanupContext(&SortContext);
+
+#if !YORI_BUILTIN
+    YoriLibLineReadCleanupCache();
+#endif
+
+    return Result;
+}
+
+// vim:sw=4:ts=4:et:
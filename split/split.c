@@ -91,6 +91,357 @@ typedef struct _SPLIT_CONTEXT {
 
 } SPLIT_CONTEXT, *PSPLIT_CONTEXT;
 
+/**
+ The size of each buffer used to move data when splitting or joining in
+ bytes mode.  Two of these are allocated, so one can be filled from the
+ source while the other is written.
+ */
+#define SPLIT_BUFFER_SIZE (1024 * 1024)
+
+/**
+ A pipeline which reads from a source on a background thread into one buffer
+ while the caller writes the contents of the other buffer.
+ */
+typedef struct _SPLIT_PIPELINE {
+
+    /**
+     Handle to the source being read.  This may be a file or a pipe.
+     */
+    HANDLE Source;
+
+    /**
+     Handle to the thread which reads data from the source.
+     */
+    HANDLE ReaderThread;
+
+    /**
+     The buffers to read data into.
+     */
+    PUCHAR Buffers[2];
+
+    /**
+     Events which are signalled when a buffer has been filled by the reader.
+     */
+    HANDLE BufferFull[2];
+
+    /**
+     Events which are signalled when a buffer has been consumed by the
+     writer and can be filled again.
+     */
+    HANDLE BufferEmpty[2];
+
+    /**
+     The number of bytes of valid data in each buffer.  Zero indicates the
+     end of the source, or that it could not be read.
+     */
+    DWORD BytesInBuffer[2];
+
+    /**
+     The size of each buffer, in bytes.
+     */
+    DWORD BufferSize;
+
+    /**
+     The index of the buffer which the writer will consume next.
+     */
+    DWORD CurrentBuffer;
+
+    /**
+     If reading from the source failed, the Win32 error code of the
+     failure.  Zero if the end of the source was reached normally.
+     */
+    DWORD ReadError;
+
+    /**
+     Set to TRUE to indicate the reader should stop reading before the end
+     of the source.
+     */
+    BOOLEAN Terminate;
+
+} SPLIT_PIPELINE, *PSPLIT_PIPELINE;
+
+/**
+ A background thread which reads the source into each buffer in turn,
+ waiting for the writer to consume a buffer before filling it again.
+
+ @param Context Pointer to the pipeline.
+
+ @return Zero.
+ */
+DWORD WINAPI
+SplitPipelineReader(
+    __in LPVOID Context
+    )
+{
+    PSPLIT_PIPELINE Pipeline = (PSPLIT_PIPELINE)Context;
+    DWORD Index;
+    DWORD BytesRead;
+    DWORD LastError;
+
+    Index = 0;
+    while (TRUE) {
+        WaitForSingleObject(Pipeline->BufferEmpty[Index], INFINITE);
+        if (Pipeline->Terminate) {
+            break;
+        }
+
+        if (!ReadFile(Pipeline->Source, Pipeline->Buffers[Index], Pipeline->BufferSize, &BytesRead, NULL)) {
+            LastError = GetLastError();
+            if (LastError != ERROR_HANDLE_EOF && LastError != ERROR_BROKEN_PIPE) {
+                Pipeline->ReadError = LastError;
+            }
+            BytesRead = 0;
+        }
+
+        Pipeline->BytesInBuffer[Index] = BytesRead;
+        SetEvent(Pipeline->BufferFull[Index]);
+        if (BytesRead == 0) {
+            break;
+        }
+
+        Index = (Index + 1) % 2;
+    }
+
+    return 0;
+}
+
+/**
+ Stop a pipeline, wait for its reader thread to terminate, and free its
+ resources.  This can be called on a partially initialized pipeline.
+
+ @param Pipeline Pointer to the pipeline to stop.
+ */
+VOID
+SplitPipelineStop(
+    __in PSPLIT_PIPELINE Pipeline
+    )
+{
+    DWORD Index;
+
+    if (Pipeline->ReaderThread != NULL) {
+        Pipeline->Terminate = TRUE;
+        SetEvent(Pipeline->BufferEmpty[0]);
+        SetEvent(Pipeline->BufferEmpty[1]);
+        WaitForSingleObject(Pipeline->ReaderThread, INFINITE);
+        CloseHandle(Pipeline->ReaderThread);
+        Pipeline->ReaderThread = NULL;
+    }
+
+    for (Index = 0; Index < 2; Index++) {
+        if (Pipeline->BufferFull[Index] != NULL) {
+            CloseHandle(Pipeline->BufferFull[Index]);
+            Pipeline->BufferFull[Index] = NULL;
+        }
+        if (Pipeline->BufferEmpty[Index] != NULL) {
+            CloseHandle(Pipeline->BufferEmpty[Index]);
+            Pipeline->BufferEmpty[Index] = NULL;
+        }
+        if (Pipeline->Buffers[Index] != NULL) {
+            YoriLibFree(Pipeline->Buffers[Index]);
+            Pipeline->Buffers[Index] = NULL;
+        }
+    }
+}
+
+/**
+ Allocate the buffers for a pipeline and start reading from the source on a
+ background thread.
+
+ @param Pipeline Pointer to the pipeline to initialize.
+
+ @param Source Handle to the source to read from.
+
+ @return TRUE to indicate the pipeline was started, FALSE on failure.
+ */
+__success(return)
+BOOL
+SplitPipelineStart(
+    __out PSPLIT_PIPELINE Pipeline,
+    __in HANDLE Source
+    )
+{
+    DWORD Index;
+    DWORD ThreadId;
+
+    ZeroMemory(Pipeline, sizeof(SPLIT_PIPELINE));
+    Pipeline->Source = Source;
+    Pipeline->BufferSize = YoriLibMaximumAllocationInRange(60 * 1024, SPLIT_BUFFER_SIZE);
+
+    for (Index = 0; Index < 2; Index++) {
+        Pipeline->Buffers[Index] = YoriLibMalloc(Pipeline->BufferSize);
+        Pipeline->BufferFull[Index] = CreateEvent(NULL, FALSE, FALSE, NULL);
+        Pipeline->BufferEmpty[Index] = CreateEvent(NULL, FALSE, TRUE, NULL);
+        if (Pipeline->Buffers[Index] == NULL ||
+            Pipeline->BufferFull[Index] == NULL ||
+            Pipeline->BufferEmpty[Index] == NULL) {
+
+            SplitPipelineStop(Pipeline);
+            return FALSE;
+        }
+    }
+
+    Pipeline->ReaderThread = CreateThread(NULL, 0, SplitPipelineReader, Pipeline, 0, &ThreadId);
+    if (Pipeline->ReaderThread == NULL) {
+        SplitPipelineStop(Pipeline);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ Wait for the next buffer to be filled by the reader.  The caller must
+ return the buffer with @ref SplitPipelineReturnBuffer before requesting
+ another one.
+
+ @param Pipeline Pointer to the pipeline.
+
+ @param Buffer On successful completion, updated to point to the data.
+
+ @param BytesInBuffer On successful completion, updated to contain the number
+        of bytes of data in the buffer.
+
+ @return TRUE to indicate a buffer containing data was returned, FALSE to
+         indicate the end of the source was reached or it could not be read.
+ */
+__success(return)
+BOOL
+SplitPipelineGetBuffer(
+    __in PSPLIT_PIPELINE Pipeline,
+    __out PUCHAR *Buffer,
+    __out PDWORD BytesInBuffer
+    )
+{
+    DWORD Index;
+
+    Index = Pipeline->CurrentBuffer;
+    WaitForSingleObject(Pipeline->BufferFull[Index], INFINITE);
+    if (Pipeline->BytesInBuffer[Index] == 0) {
+        return FALSE;
+    }
+
+    *Buffer = Pipeline->Buffers[Index];
+    *BytesInBuffer = Pipeline->BytesInBuffer[Index];
+    return TRUE;
+}
+
+/**
+ Indicate that the writer has finished with the buffer returned from
+ @ref SplitPipelineGetBuffer so the reader can fill it again.
+
+ @param Pipeline Pointer to the pipeline.
+ */
+VOID
+SplitPipelineReturnBuffer(
+    __in PSPLIT_PIPELINE Pipeline
+    )
+{
+    SetEvent(Pipeline->BufferEmpty[Pipeline->CurrentBuffer]);
+    Pipeline->CurrentBuffer = (Pipeline->CurrentBuffer + 1) % 2;
+}
+
+/**
+ Display an error describing a failure to read from the source of a
+ pipeline.
+
+ @param Pipeline Pointer to the pipeline which has reached the end of its
+        source.
+
+ @param SourceName Optionally points to the name of the source, for display.
+
+ @return TRUE to indicate the source was read to completion, FALSE to
+         indicate a read failed.
+ */
+BOOL
+SplitPipelineCheckReadError(
+    __in PSPLIT_PIPELINE Pipeline,
+    __in_opt LPTSTR SourceName
+    )
+{
+    LPTSTR ErrText;
+
+    if (Pipeline->ReadError == 0) {
+        return TRUE;
+    }
+
+    ErrText = YoriLibGetWinErrorText(Pipeline->ReadError);
+    if (SourceName != NULL) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("split: read of %s failed: %s"), SourceName, ErrText);
+    } else {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("split: read failed: %s"), ErrText);
+    }
+    YoriLibFreeWinErrorText(ErrText);
+    return FALSE;
+}
+
+/**
+ Extend a file to a specified size and return the file pointer to the start
+ of the file.  This allows the file system to allocate space for the file
+ in one operation rather than as each write arrives.  Failure is not fatal,
+ since the file will be extended by writes anyway.
+
+ @param FileHandle Handle to the file to extend.
+
+ @param FileSize The size to extend the file to.
+ */
+VOID
+SplitPreallocateFile(
+    __in HANDLE FileHandle,
+    __in LARGE_INTEGER FileSize
+    )
+{
+    LONG HighPart;
+
+    if (FileSize.QuadPart == 0 || GetFileType(FileHandle) != FILE_TYPE_DISK) {
+        return;
+    }
+
+    HighPart = FileSize.HighPart;
+    if (SetFilePointer(FileHandle, FileSize.LowPart, &HighPart, FILE_BEGIN) == INVALID_SET_FILE_POINTER &&
+        GetLastError() != NO_ERROR) {
+
+        return;
+    }
+
+    SetEndOfFile(FileHandle);
+    SetFilePointer(FileHandle, 0, NULL, FILE_BEGIN);
+}
+
+/**
+ Generate the file name for a single part of a split file.
+
+ @param Prefix Pointer to the prefix of part files.
+
+ @param PartNumber The number of the part.
+
+ @return Pointer to a newly allocated NULL terminated file name, which the
+         caller should free with YoriLibFree, or NULL on failure.
+ */
+LPTSTR
+SplitGetPartFileName(
+    __in PYORI_STRING Prefix,
+    __in YORI_MAX_SIGNED_T PartNumber
+    )
+{
+    LPTSTR NewFileName;
+    YORI_STRING NumberString;
+
+    YoriLibInitEmptyString(&NumberString);
+    if (!YoriLibNumberToString(&NumberString, PartNumber, 10, 0, '\0')) {
+        return NULL;
+    }
+
+    NewFileName = YoriLibMalloc((Prefix->LengthInChars + NumberString.LengthInChars + 1) * sizeof(TCHAR));
+    if (NewFileName == NULL) {
+        YoriLibFreeStringContents(&NumberString);
+        return NULL;
+    }
+
+    YoriLibSPrintf(NewFileName, _T("%y%y"), Prefix, &NumberString);
+    YoriLibFreeStringContents(&NumberString);
+    return NewFileName;
+}
+
 /**
  Open a file in which to output the result of a fragment of the split
  operation.
@@ -106,23 +457,13 @@ SplitOpenTargetForCurrentPart(
     )
 {
     LPTSTR NewFileName;
-    YORI_STRING NumberString;
     HANDLE hDestFile;
 
-    YoriLibInitEmptyString(&NumberString);
-    if (!YoriLibNumberToString(&NumberString, SplitContext->CurrentPartNumber, 10, 0, '\0')) {
-        return NULL;
-    }
-
-    NewFileName = YoriLibMalloc((SplitContext->Prefix.LengthInChars + NumberString.LengthInChars + 1) * sizeof(TCHAR));
+    NewFileName = SplitGetPartFileName(&SplitContext->Prefix, SplitContext->CurrentPartNumber);
     if (NewFileName == NULL) {
-        YoriLibFreeStringContents(&NumberString);
         return NULL;
     }
 
-    YoriLibSPrintf(NewFileName, _T("%y%y"), &SplitContext->Prefix, &NumberString);
-    YoriLibFreeStringContents(&NumberString);
-
     hDestFile = CreateFile(NewFileName,
                            GENERIC_WRITE,
                            FILE_SHARE_READ|FILE_SHARE_DELETE,
@@ -143,6 +484,116 @@ SplitOpenTargetForCurrentPart(
     return hDestFile;
 }
 
+/**
+ Take a single incoming stream and break it into pieces containing a
+ specified number of bytes.  The stream is read into fixed size buffers on a
+ background thread while the previous buffer is written, so memory usage
+ does not depend on the size of each part.
+
+ @param hSource A handle to the incoming stream, which may be a file or a
+        pipe.
+
+ @param SplitContext Pointer to a context describing the actions to perform.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+SplitProcessStreamBytes(
+    __in HANDLE hSource,
+    __in PSPLIT_CONTEXT SplitContext
+    )
+{
+    SPLIT_PIPELINE Pipeline;
+    HANDLE hDestFile = NULL;
+    PUCHAR Buffer;
+    DWORD BytesInBuffer;
+    DWORD BufferOffset;
+    DWORD BytesToWrite;
+    DWORD BytesWritten;
+    LARGE_INTEGER SourceRemaining;
+    LARGE_INTEGER PartSize;
+    YORI_MAX_SIGNED_T PartRemaining;
+    BOOL Result = FALSE;
+
+    //
+    //  If the source is a file, its size is known, so the size of each part
+    //  is known as it is created.
+    //
+
+    SourceRemaining.QuadPart = 0;
+    if (GetFileType(hSource) == FILE_TYPE_DISK) {
+        SourceRemaining.LowPart = GetFileSize(hSource, (LPDWORD)&SourceRemaining.HighPart);
+        if (SourceRemaining.LowPart == INVALID_FILE_SIZE && GetLastError() != NO_ERROR) {
+            SourceRemaining.QuadPart = 0;
+        }
+    }
+
+    if (!SplitPipelineStart(&Pipeline, hSource)) {
+        return FALSE;
+    }
+
+    PartRemaining = 0;
+    while (SplitPipelineGetBuffer(&Pipeline, &Buffer, &BytesInBuffer)) {
+        BufferOffset = 0;
+        while (BufferOffset < BytesInBuffer) {
+            if (hDestFile == NULL) {
+                hDestFile = SplitOpenTargetForCurrentPart(SplitContext);
+                if (hDestFile == NULL) {
+                    goto Exit;
+                }
+                SplitContext->CurrentPartNumber++;
+                PartRemaining = SplitContext->BytesPerPart;
+
+                PartSize.QuadPart = PartRemaining;
+                if (PartSize.QuadPart > SourceRemaining.QuadPart) {
+                    PartSize.QuadPart = SourceRemaining.QuadPart;
+                }
+                SplitPreallocateFile(hDestFile, PartSize);
+                SourceRemaining.QuadPart = SourceRemaining.QuadPart - PartSize.QuadPart;
+            }
+
+            BytesToWrite = BytesInBuffer - BufferOffset;
+            if ((YORI_MAX_SIGNED_T)BytesToWrite > PartRemaining) {
+                BytesToWrite = (DWORD)PartRemaining;
+            }
+
+            if (!WriteFile(hDestFile, Buffer + BufferOffset, BytesToWrite, &BytesWritten, NULL)) {
+                DWORD LastError = GetLastError();
+                LPTSTR ErrText = YoriLibGetWinErrorText(LastError);
+                YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("split: write failed: %s"), ErrText);
+                YoriLibFreeWinErrorText(ErrText);
+                goto Exit;
+            }
+
+            BufferOffset = BufferOffset + BytesToWrite;
+            PartRemaining = PartRemaining - BytesToWrite;
+
+            if (PartRemaining == 0) {
+                SetEndOfFile(hDestFile);
+                CloseHandle(hDestFile);
+                hDestFile = NULL;
+            }
+        }
+        SplitPipelineReturnBuffer(&Pipeline);
+    }
+
+    Result = SplitPipelineCheckReadError(&Pipeline, NULL);
+
+Exit:
+    if (hDestFile != NULL) {
+
+        //
+        //  If the source was smaller than expected, truncate the part to
+        //  the data that was written.
+        //
+
+        SetEndOfFile(hDestFile);
+        CloseHandle(hDestFile);
+    }
+    SplitPipelineStop(&Pipeline);
+    return Result;
+}
+
 /**
  Take a single incoming stream and break it into pieces.
 
@@ -194,47 +645,14 @@ SplitProcessStream(
             LineNumber++;
         }
 
-        YoriLibLineReadCloseOrCache(LineContext);
-        YoriLibFreeStringContents(&LineString);
-    } else {
-        PVOID Buffer;
-        ULONG BytesRead;
-
-        Buffer = YoriLibMalloc((YORI_ALLOC_SIZE_T)SplitContext->BytesPerPart);
-        if (Buffer == NULL) {
-            return FALSE;
-        }
-
-        while (TRUE) {
-            if (!ReadFile(hSource, Buffer, (YORI_ALLOC_SIZE_T)SplitContext->BytesPerPart, &BytesRead, NULL)) {
-                break;
-            }
-
-            if (BytesRead == 0) {
-                break;
-            }
-
-            hDestFile = SplitOpenTargetForCurrentPart(SplitContext);
-            if (hDestFile == NULL) {
-                YoriLibFree(Buffer);
-                return FALSE;
-            }
-            SplitContext->CurrentPartNumber++;
-
-            if (!WriteFile(hDestFile, Buffer, BytesRead, &BytesRead, NULL)) {
-                DWORD LastError = GetLastError();
-                LPTSTR ErrText = YoriLibGetWinErrorText(LastError);
-                YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("split: write failed: %s"), ErrText);
-                YoriLibFreeWinErrorText(ErrText);
-                CloseHandle(hDestFile);
-                YoriLibFree(Buffer);
-                return FALSE;
-            }
-
+        if (hDestFile != NULL) {
             CloseHandle(hDestFile);
         }
 
-        YoriLibFree(Buffer);
+        YoriLibLineReadCloseOrCache(LineContext);
+        YoriLibFreeStringContents(&LineString);
+    } else {
+        return SplitProcessStreamBytes(hSource, SplitContext);
     }
 
     return TRUE;
@@ -260,23 +678,21 @@ SplitJoin(
 {
     HANDLE SourceHandle;
     HANDLE TargetHandle;
+    HANDLE FindHandle;
+    WIN32_FIND_DATA FindData;
+    SPLIT_PIPELINE Pipeline;
     PUCHAR Buffer;
-    DWORD BytesRead;
-    YORI_ALLOC_SIZE_T BytesAllocated;
+    DWORD BytesInBuffer;
+    DWORD BytesWritten;
+    LARGE_INTEGER TotalSize;
     YORI_MAX_SIGNED_T CurrentFragment;
     LPTSTR FragmentFileName;
-    YORI_STRING NumberString;
     DWORD LastError;
     LPTSTR ErrText;
+    BOOL Result;
 
     ASSERT(YoriLibIsStringNullTerminated(OutputFile));
 
-    BytesAllocated = YoriLibMaximumAllocationInRange(60 * 1024, 256 * 1024);
-    Buffer = YoriLibMalloc(BytesAllocated);
-    if (Buffer == NULL) {
-        return FALSE;
-    }
-
     TargetHandle = CreateFile(OutputFile->StartOfString,
                               GENERIC_WRITE,
                               FILE_SHARE_READ | FILE_SHARE_DELETE,
@@ -290,38 +706,50 @@ SplitJoin(
         ErrText = YoriLibGetWinErrorText(LastError);
         YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("split: open of %y failed: %s"), OutputFile, ErrText);
         YoriLibFreeWinErrorText(ErrText);
-        YoriLibFree(Buffer);
         return FALSE;
     }
 
-    CurrentFragment = 0;
-
-    while(TRUE) {
+    //
+    //  Find the combined size of all of the fragments and extend the target
+    //  to that size before writing to it.
+    //
 
-        YoriLibInitEmptyString(&NumberString);
-        if (!YoriLibNumberToString(&NumberString, CurrentFragment, 10, 0, '\0')) {
+    TotalSize.QuadPart = 0;
+    for (CurrentFragment = 0; ; CurrentFragment++) {
+        FragmentFileName = SplitGetPartFileName(Prefix, CurrentFragment);
+        if (FragmentFileName == NULL) {
             CloseHandle(TargetHandle);
-            YoriLibFree(Buffer);
             return FALSE;
         }
 
-        FragmentFileName = YoriLibMalloc((Prefix->LengthInChars + NumberString.LengthInChars + 1) * sizeof(TCHAR));
+        FindHandle = FindFirstFile(FragmentFileName, &FindData);
+        YoriLibFree(FragmentFileName);
+        if (FindHandle == INVALID_HANDLE_VALUE) {
+            break;
+        }
+        FindClose(FindHandle);
+        TotalSize.HighPart += FindData.nFileSizeHigh;
+        TotalSize.QuadPart += FindData.nFileSizeLow;
+    }
+
+    SplitPreallocateFile(TargetHandle, TotalSize);
+
+    CurrentFragment = 0;
+
+    while(TRUE) {
+
+        FragmentFileName = SplitGetPartFileName(Prefix, CurrentFragment);
         if (FragmentFileName == NULL) {
-            YoriLibFreeStringContents(&NumberString);
             CloseHandle(TargetHandle);
-            YoriLibFree(Buffer);
             return FALSE;
         }
 
-        YoriLibSPrintf(FragmentFileName, _T("%y%y"), Prefix, &NumberString);
-        YoriLibFreeStringContents(&NumberString);
-
         SourceHandle = CreateFile(FragmentFileName,
                                   GENERIC_READ,
                                   FILE_SHARE_READ|FILE_SHARE_DELETE,
                                   NULL,
                                   OPEN_EXISTING,
-                                  FILE_ATTRIBUTE_NORMAL | FILE_FLAG_BACKUP_SEMANTICS,
+                                  FILE_ATTRIBUTE_NORMAL | FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_SEQUENTIAL_SCAN,
                                   NULL);
         if (SourceHandle == INVALID_HANDLE_VALUE) {
             LastError = GetLastError();
@@ -334,50 +762,53 @@ SplitJoin(
             YoriLibFreeWinErrorText(ErrText);
             YoriLibFree(FragmentFileName);
             CloseHandle(TargetHandle);
-            YoriLibFree(Buffer);
             return FALSE;
         }
 
-        while(TRUE) {
-
-            if (!ReadFile(SourceHandle, Buffer, BytesAllocated, &BytesRead, NULL)) {
-                LastError = GetLastError();
-                if (LastError == ERROR_HANDLE_EOF) {
-                    break;
-                }
-                ErrText = YoriLibGetWinErrorText(LastError);
-                YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("split: read of %s failed: %s"), FragmentFileName, ErrText);
-                YoriLibFreeWinErrorText(ErrText);
-                YoriLibFree(FragmentFileName);
-                CloseHandle(TargetHandle);
-                CloseHandle(SourceHandle);
-                YoriLibFree(Buffer);
-                return FALSE;
-            }
+        if (!SplitPipelineStart(&Pipeline, SourceHandle)) {
+            YoriLibFree(FragmentFileName);
+            CloseHandle(SourceHandle);
+            CloseHandle(TargetHandle);
+            return FALSE;
+        }
 
-            if (BytesRead == 0) {
-                break;
-            }
+        Result = TRUE;
+        while (SplitPipelineGetBuffer(&Pipeline, &Buffer, &BytesInBuffer)) {
 
-            if (!WriteFile(TargetHandle, Buffer, BytesRead, &BytesRead, NULL)) {
+            if (!WriteFile(TargetHandle, Buffer, BytesInBuffer, &BytesWritten, NULL)) {
                 LastError = GetLastError();
                 ErrText = YoriLibGetWinErrorText(LastError);
                 YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("split: write to %y failed: %s"), OutputFile, ErrText);
                 YoriLibFreeWinErrorText(ErrText);
-                YoriLibFree(FragmentFileName);
-                CloseHandle(TargetHandle);
-                CloseHandle(SourceHandle);
-                YoriLibFree(Buffer);
-                return FALSE;
+                Result = FALSE;
+                break;
             }
+
+            SplitPipelineReturnBuffer(&Pipeline);
+        }
+
+        if (Result) {
+            Result = SplitPipelineCheckReadError(&Pipeline, FragmentFileName);
         }
 
+        SplitPipelineStop(&Pipeline);
         CloseHandle(SourceHandle);
         YoriLibFree(FragmentFileName);
+
+        if (!Result) {
+            CloseHandle(TargetHandle);
+            return FALSE;
+        }
+
         CurrentFragment++;
     }
 
-    YoriLibFree(Buffer);
+    //
+    //  If the fragments changed since their sizes were checked, make sure
+    //  the target ends where the data does.
+    //
+
+    SetEndOfFile(TargetHandle);
     CloseHandle(TargetHandle);
     return TRUE;
 }
@@ -515,7 +946,7 @@ ENTRYPOINT(
                 Result = EXIT_FAILURE;
             }
         } else {
-            if (SplitContext.BytesPerPart == 0 || SplitContext.BytesPerPart >= YORI_MAX_ALLOC_SIZE) {
+            if (SplitContext.BytesPerPart <= 0) {
                 YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("split: invalid bytes per part\n"));
                 Result = EXIT_FAILURE;
             }
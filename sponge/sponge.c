@@ -34,11 +34,21 @@ const
 CHAR strSpongeHelpText[] =
         "\n"
         "Read input into memory and output once all input is read,\n"
-        "  allowing the output to modify the source stream.\n"
+        "  allowing the output to modify the source stream.  Large input is\n"
+        "  held in a temporary file which is renamed over the output file.\n"
         "\n"
-        "SPONGE [-license] [file]\n"
+        "SPONGE [-license] [-m size] [file]\n"
+        "\n"
+        "   -m             Hold up to size bytes in memory before using a temporary\n"
+        "                    file in the directory of the output file\n"
         ;
 
+/**
+ The default amount of data to hold in memory before spilling to a
+ temporary file.
+ */
+#define SPONGE_DEFAULT_MEMORY_LIMIT (64 * 1024 * 1024)
+
 /**
  Display usage text to the user.
  */
@@ -68,8 +78,153 @@ typedef struct _SPONGE_BUFFER {
      */
     YORI_LIB_BYTE_BUFFER ByteBuffer;
 
+    /**
+     The maximum number of bytes to hold in memory.  When the buffer
+     reaches this size, its contents are written to a temporary file.
+     */
+    YORI_MAX_UNSIGNED_T MemoryLimit;
+
+    /**
+     Pointer to the full path of the output file, or NULL if output is being
+     sent to standard output.  The temporary file is created in the same
+     directory so that it can be renamed over the output file once all
+     input has been read.
+     */
+    PYORI_STRING TargetFile;
+
+    /**
+     A handle to the temporary file, or NULL if all data is held in memory.
+     */
+    HANDLE hSpillFile;
+
+    /**
+     The name of the temporary file.
+     */
+    YORI_STRING SpillFileName;
+
 } SPONGE_BUFFER, *PSPONGE_BUFFER;
 
+/**
+ Output the collected buffer to a stream.
+
+ @param ThisBuffer Pointer to the buffer to output.
+
+ @param hTarget Handle to the target stream to output the buffer to.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOLEAN
+SpongeBufferForward(
+    __in PSPONGE_BUFFER ThisBuffer,
+    __in HANDLE hTarget
+    )
+{
+    YORI_MAX_UNSIGNED_T BytesSent;
+    BOOLEAN Result;
+    YORI_MAX_UNSIGNED_T BytesPopulated;
+    PUCHAR SrcBuffer;
+    YORI_ALLOC_SIZE_T BytesToWrite;
+
+    BytesSent = 0;
+    Result = TRUE;
+
+    BytesPopulated = YoriLibByteBufferGetValidBytes(&ThisBuffer->ByteBuffer);
+
+    while (BytesSent < BytesPopulated) {
+        DWORD BytesWritten;
+
+        SrcBuffer = YoriLibByteBufferGetPointerToValidData(&ThisBuffer->ByteBuffer, BytesSent, &BytesToWrite);
+
+        if (WriteFile(hTarget,
+                      SrcBuffer,
+                      BytesToWrite,
+                      &BytesWritten,
+                      NULL)) {
+
+            BytesSent += BytesWritten;
+        } else {
+            Result = FALSE;
+            break;
+        }
+
+        ASSERT(BytesSent <= BytesPopulated);
+    }
+
+    return Result;
+}
+
+/**
+ Write the contents of the memory buffer to the temporary file, creating
+ the temporary file if it does not already exist, and empty the memory
+ buffer.
+
+ @param ThisBuffer A pointer to the process buffer set.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOLEAN
+SpongeBufferSpill(
+    __in PSPONGE_BUFFER ThisBuffer
+    )
+{
+    YORI_STRING ParentDirectory;
+    YORI_STRING Prefix;
+    YORI_ALLOC_SIZE_T Index;
+    BOOLEAN Result;
+
+    if (ThisBuffer->hSpillFile == NULL) {
+
+        //
+        //  When writing to a file, create the temporary file in the same
+        //  directory so it can be renamed into place.  When writing to
+        //  standard output, use the temporary directory.
+        //
+
+        YoriLibInitEmptyString(&ParentDirectory);
+        if (ThisBuffer->TargetFile != NULL) {
+            for (Index = ThisBuffer->TargetFile->LengthInChars; Index > 0; Index--) {
+                if (YoriLibIsSep(ThisBuffer->TargetFile->StartOfString[Index - 1])) {
+                    ParentDirectory.StartOfString = ThisBuffer->TargetFile->StartOfString;
+                    ParentDirectory.LengthInChars = Index - 1;
+                    break;
+                }
+            }
+
+            if (Index == 0) {
+                YoriLibConstantString(&ParentDirectory, _T("."));
+            }
+        } else {
+            if (!YoriLibGetTempPath(&ParentDirectory, 0)) {
+                return FALSE;
+            }
+
+            if (ParentDirectory.LengthInChars > 0 &&
+                YoriLibIsSep(ParentDirectory.StartOfString[ParentDirectory.LengthInChars - 1])) {
+
+                ParentDirectory.LengthInChars--;
+                ParentDirectory.StartOfString[ParentDirectory.LengthInChars] = '\0';
+            }
+        }
+
+        YoriLibConstantString(&Prefix, _T("YSPG"));
+        Result = YoriLibGetTempFileName(&ParentDirectory, &Prefix, &ThisBuffer->hSpillFile, &ThisBuffer->SpillFileName);
+        YoriLibFreeStringContents(&ParentDirectory);
+        if (!Result) {
+            ThisBuffer->hSpillFile = NULL;
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("sponge: could not create temporary file\n"));
+            return FALSE;
+        }
+    }
+
+    if (!SpongeBufferForward(ThisBuffer, ThisBuffer->hSpillFile)) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("sponge: write to temporary file failed\n"));
+        return FALSE;
+    }
+
+    YoriLibByteBufferReset(&ThisBuffer->ByteBuffer);
+    return TRUE;
+}
+
 /**
  Populate data from stdin into an in memory buffer.
 
@@ -106,6 +261,12 @@ SpongeBufferPump(
             }
 
             YoriLibByteBufferAddToPopulatedLength(&ThisBuffer->ByteBuffer, BytesRead);
+
+            if (YoriLibByteBufferGetValidBytes(&ThisBuffer->ByteBuffer) >= ThisBuffer->MemoryLimit) {
+                if (!SpongeBufferSpill(ThisBuffer)) {
+                    break;
+                }
+            }
         } else {
             Result = TRUE;
             break;
@@ -116,79 +277,179 @@ SpongeBufferPump(
 }
 
 /**
- Output the collected buffer to a stream.
+ Allocate and initialize a buffer for an input stream.
 
- @param ThisBuffer Pointer to the buffer to output.
+ @param Buffer Pointer to the buffer to allocate structures for.
 
- @param hTarget Handle to the target stream to output the buffer to.
+ @return TRUE if the buffer is successfully initialized, FALSE if it is not.
+ */
+BOOL
+SpongeAllocateBuffer(
+    __out PSPONGE_BUFFER Buffer
+    )
+{
+    return YoriLibByteBufferInitialize(&Buffer->ByteBuffer, 1024);
+}
+
+/**
+ Free structures associated with a single input stream.  If a temporary file
+ still exists, it is deleted.
+
+ @param Buffer Pointer to the single stream's buffers to deallocate.
+ */
+VOID
+SpongeFreeBuffer(
+    __in PSPONGE_BUFFER Buffer
+    )
+{
+    if (Buffer->hSpillFile != NULL) {
+        CloseHandle(Buffer->hSpillFile);
+        Buffer->hSpillFile = NULL;
+        DeleteFile(Buffer->SpillFileName.StartOfString);
+    }
+    YoriLibFreeStringContents(&Buffer->SpillFileName);
+    YoriLibByteBufferCleanup(&Buffer->ByteBuffer);
+}
+
+/**
+ Output the contents of the temporary file to a stream.
+
+ @param ThisBuffer A pointer to the process buffer set, where all data has
+        been written to the temporary file.
+
+ @param hTarget Handle to the target stream to output the data to.
 
  @return TRUE to indicate success, FALSE to indicate failure.
  */
 BOOLEAN
-SpongeBufferForward(
+SpongeBufferForwardSpill(
     __in PSPONGE_BUFFER ThisBuffer,
     __in HANDLE hTarget
     )
 {
-    YORI_MAX_UNSIGNED_T BytesSent;
+    PUCHAR Buffer;
+    YORI_ALLOC_SIZE_T BufferSize;
+    DWORD BytesRead;
+    DWORD BytesWritten;
     BOOLEAN Result;
-    YORI_MAX_UNSIGNED_T BytesPopulated;
-    PUCHAR SrcBuffer;
-    YORI_ALLOC_SIZE_T BytesToWrite;
 
-    BytesSent = 0;
-    Result = TRUE;
-
-    BytesPopulated = YoriLibByteBufferGetValidBytes(&ThisBuffer->ByteBuffer);
+    if (SetFilePointer(ThisBuffer->hSpillFile, 0, NULL, FILE_BEGIN) == INVALID_SET_FILE_POINTER) {
+        return FALSE;
+    }
 
-    while (BytesSent < BytesPopulated) {
-        DWORD BytesWritten;
+    BufferSize = YoriLibMaximumAllocationInRange(64 * 1024, 1024 * 1024);
+    Buffer = YoriLibMalloc(BufferSize);
+    if (Buffer == NULL) {
+        return FALSE;
+    }
 
-        SrcBuffer = YoriLibByteBufferGetPointerToValidData(&ThisBuffer->ByteBuffer, BytesSent, &BytesToWrite);
+    Result = TRUE;
+    while (TRUE) {
+        if (!ReadFile(ThisBuffer->hSpillFile, Buffer, BufferSize, &BytesRead, NULL)) {
+            Result = FALSE;
+            break;
+        }
 
-        if (WriteFile(hTarget,
-                      SrcBuffer,
-                      BytesToWrite,
-                      &BytesWritten,
-                      NULL)) {
+        if (BytesRead == 0) {
+            break;
+        }
 
-            BytesSent += BytesWritten;
-        } else {
+        if (!WriteFile(hTarget, Buffer, BytesRead, &BytesWritten, NULL)) {
             Result = FALSE;
+            break;
         }
-
-        ASSERT(BytesSent <= BytesPopulated);
     }
 
+    YoriLibFree(Buffer);
     return Result;
 }
 
 /**
- Allocate and initialize a buffer for an input stream.
+ Once all input has been read into a temporary file, rename the temporary
+ file over the output file.  This avoids reading and writing the data a
+ second time.  If the rename fails, for example because another process has
+ the output file open, fall back to copying the temporary file into the
+ output file.
 
- @param Buffer Pointer to the buffer to allocate structures for.
+ @param ThisBuffer A pointer to the process buffer set, where all data has
+        been written to the temporary file.
 
- @return TRUE if the buffer is successfully initialized, FALSE if it is not.
+ @return TRUE to indicate success, FALSE to indicate failure.
  */
-BOOL
-SpongeAllocateBuffer(
-    __out PSPONGE_BUFFER Buffer
+BOOLEAN
+SpongeBufferRenameSpill(
+    __in PSPONGE_BUFFER ThisBuffer
     )
 {
-    return YoriLibByteBufferInitialize(&Buffer->ByteBuffer, 1024);
-}
+    DWORD Attributes;
+    HANDLE hTarget;
+    DWORD LastError;
+    LPTSTR ErrText;
 
-/**
- Free structures associated with a single input stream.
+    //
+    //  Flush the temporary file to ensure it's durable before it replaces
+    //  the output file.
+    //
 
- @param Buffer Pointer to the single stream's buffers to deallocate.
- */
-VOID
-SpongeFreeBuffer(
-    __in PSPONGE_BUFFER Buffer
-    )
-{
-    YoriLibByteBufferCleanup(&Buffer->ByteBuffer);
+    if (!FlushFileBuffers(ThisBuffer->hSpillFile)) {
+        return FALSE;
+    }
+
+    CloseHandle(ThisBuffer->hSpillFile);
+    ThisBuffer->hSpillFile = NULL;
+
+    //
+    //  If the file exists and ReplaceFile is present, replace it, which
+    //  retains the attributes and security of the output file.  Otherwise
+    //  rename the temporary file into place.
+    //
+
+    Attributes = GetFileAttributes(ThisBuffer->TargetFile->StartOfString);
+    if (Attributes != (DWORD)-1 &&
+        DllKernel32.pReplaceFileW != NULL &&
+        DllKernel32.pReplaceFileW(ThisBuffer->TargetFile->StartOfString, ThisBuffer->SpillFileName.StartOfString, NULL, 0, NULL, NULL)) {
+
+        return TRUE;
+    }
+
+    if (MoveFileEx(ThisBuffer->SpillFileName.StartOfString, ThisBuffer->TargetFile->StartOfString, MOVEFILE_REPLACE_EXISTING)) {
+        return TRUE;
+    }
+
+    ThisBuffer->hSpillFile = CreateFile(ThisBuffer->SpillFileName.StartOfString,
+                                        GENERIC_READ,
+                                        FILE_SHARE_READ | FILE_SHARE_DELETE,
+                                        NULL,
+                                        OPEN_EXISTING,
+                                        FILE_FLAG_SEQUENTIAL_SCAN,
+                                        NULL);
+    if (ThisBuffer->hSpillFile == INVALID_HANDLE_VALUE) {
+        ThisBuffer->hSpillFile = NULL;
+        return FALSE;
+    }
+
+    hTarget = CreateFile(ThisBuffer->TargetFile->StartOfString,
+                         GENERIC_WRITE,
+                         FILE_SHARE_READ | FILE_SHARE_DELETE,
+                         NULL,
+                         CREATE_ALWAYS,
+                         0,
+                         NULL);
+    if (hTarget == INVALID_HANDLE_VALUE) {
+        LastError = GetLastError();
+        ErrText = YoriLibGetWinErrorText(LastError);
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("sponge: open file failed: %s"), ErrText);
+        YoriLibFreeWinErrorText(ErrText);
+        return FALSE;
+    }
+
+    if (!SpongeBufferForwardSpill(ThisBuffer, hTarget)) {
+        CloseHandle(hTarget);
+        return FALSE;
+    }
+
+    CloseHandle(hTarget);
+    return TRUE;
 }
 
 
@@ -227,8 +488,11 @@ ENTRYPOINT(
     SPONGE_BUFFER SpongeBuffer;
     YORI_STRING FullFilePath;
     HANDLE hTarget;
+    LARGE_INTEGER MemoryLimit;
+    BOOLEAN Result;
 
     ZeroMemory(&SpongeBuffer, sizeof(SpongeBuffer));
+    SpongeBuffer.MemoryLimit = SPONGE_DEFAULT_MEMORY_LIMIT;
 
     for (i = 1; i < ArgC; i++) {
 
@@ -242,6 +506,15 @@ ENTRYPOINT(
             } else if (YoriLibCompareStringLitIns(&Arg, _T("license")) == 0) {
                 YoriLibDisplayMitLicense(_T("2019"));
                 return EXIT_SUCCESS;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("m")) == 0) {
+                if (i + 1 < ArgC) {
+                    MemoryLimit = YoriLibStringToFileSize(&ArgV[i + 1]);
+                    if (MemoryLimit.QuadPart > 0) {
+                        SpongeBuffer.MemoryLimit = (YORI_MAX_UNSIGNED_T)MemoryLimit.QuadPart;
+                    }
+                    ArgumentUnderstood = TRUE;
+                    i++;
+                }
             } else if (YoriLibCompareStringLitIns(&Arg, _T("-")) == 0) {
                 ArgumentUnderstood = TRUE;
                 StartArg = i + 1;
@@ -280,13 +553,41 @@ ENTRYPOINT(
             SpongeFreeBuffer(&SpongeBuffer);
             return EXIT_FAILURE;
         }
+        SpongeBuffer.TargetFile = &FullFilePath;
     }
 
     if (!SpongeBufferPump(&SpongeBuffer)) {
         SpongeFreeBuffer(&SpongeBuffer);
+        YoriLibFreeStringContents(&FullFilePath);
         return EXIT_FAILURE;
     }
 
+    //
+    //  If the input was too large to hold in memory, write the remainder to
+    //  the temporary file and move it into place.
+    //
+
+    if (SpongeBuffer.hSpillFile != NULL) {
+        Result = SpongeBufferSpill(&SpongeBuffer);
+        if (Result) {
+            if (SpongeBuffer.TargetFile != NULL) {
+                Result = SpongeBufferRenameSpill(&SpongeBuffer);
+                if (!Result) {
+                    YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("sponge: could not replace %y\n"), &FullFilePath);
+                }
+            } else {
+                Result = SpongeBufferForwardSpill(&SpongeBuffer, hTarget);
+            }
+        }
+
+        SpongeFreeBuffer(&SpongeBuffer);
+        YoriLibFreeStringContents(&FullFilePath);
+        if (!Result) {
+            return EXIT_FAILURE;
+        }
+        return EXIT_SUCCESS;
+    }
+
     if (FullFilePath.LengthInChars > 0) {
         hTarget = CreateFile(FullFilePath.StartOfString,
                              GENERIC_WRITE,
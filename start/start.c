@@ -35,10 +35,16 @@ CHAR strStartHelpText[] =
         "\n"
         "Ask the shell to open a file.\n"
         "\n"
-        "START [-license] [-c] [-e] [-s:b|-s:h|-s:m] <file>\n"
+        "START [-license] [-c] [-cpu n] [-e] [-io low|verylow] [-mem low|verylow]\n"
+        "      [-node n] [-s:b|-s:h|-s:m] <file>\n"
         "\n"
         "   -c             Start with a clean environment\n"
+        "   -cpu n         Limit the program and processes it launches to n percent\n"
+        "                    of processor time\n"
         "   -e             Start elevated\n"
+        "   -io            Start with low or very low I/O priority\n"
+        "   -mem           Start with low or very low memory priority\n"
+        "   -node n        Start on the processors of NUMA node n\n"
         "   -s:b           Start in the background\n"
         "   -s:h           Start hidden\n"
         "   -s:m           Start minimized\n";
@@ -58,8 +64,15 @@ StartHelp(VOID)
 }
 
 /**
- Try to launch a single program via CreateProcess.  This branch is only used
- on OS editions that do not support ShellExecute.
+ A value indicating that the program should not be restricted to a NUMA
+ node.
+ */
+#define START_NO_NODE ((DWORD)-1)
+
+/**
+ Try to launch a single program via CreateProcess.  This branch is used on
+ OS editions that do not support ShellExecute, or when the program needs
+ to be controlled in ways that ShellExecute does not provide.
 
  @param ArgC Count of arguments.
 
@@ -71,6 +84,13 @@ StartHelp(VOID)
         be allocated.  FALSE to inherit the environment from the current
         process.
 
+ @param NodeNumber The NUMA node whose processors the program should run on,
+        or START_NO_NODE to let the system schedule it anywhere.
+
+ @param Limits Pointer to limits to apply to the program.  Processes that
+        the program launches inherit its I/O and memory priority, and are
+        included in any processor rate limit.
+
  @return TRUE to indicate success, FALSE on failure.
  */
 BOOLEAN
@@ -78,7 +98,9 @@ StartCreateProcess(
     __in YORI_ALLOC_SIZE_T ArgC,
     __in YORI_STRING ArgV[],
     __in INT ShowState,
-    __in BOOLEAN CleanEnvironment
+    __in BOOLEAN CleanEnvironment,
+    __in DWORD NodeNumber,
+    __in PYORI_LIB_PROCESS_LIMITS Limits
     )
 {
     PROCESS_INFORMATION ProcessInfo;
@@ -86,6 +108,8 @@ StartCreateProcess(
     YORI_STRING CmdLine;
     DWORD CreationFlags;
     PVOID EnvironmentBlock;
+    HANDLE hJob;
+    YORI_LIB_PROCESSOR_PLACEMENT ProcessorPlacement;
 
     YoriLibInitEmptyString(&CmdLine);
     if (!YoriLibBuildCmdlineFromArgcArgv(ArgC, ArgV, TRUE, TRUE, &CmdLine)) {
@@ -102,6 +126,13 @@ StartCreateProcess(
     StartupInfo.wShowWindow = (WORD)ShowState;
 
     CreationFlags = CREATE_NEW_CONSOLE | CREATE_NEW_PROCESS_GROUP | CREATE_DEFAULT_ERROR_MODE;
+    if (NodeNumber != START_NO_NODE ||
+        Limits->CpuRate != 0 ||
+        Limits->IoPriority != YORI_LIB_PRIORITY_UNCHANGED ||
+        Limits->MemoryPriority != YORI_LIB_PRIORITY_UNCHANGED) {
+
+        CreationFlags = CreationFlags | CREATE_SUSPENDED;
+    }
 
     //
     //  If the user requested a clean environment and the OS can provide one,
@@ -146,6 +177,49 @@ StartCreateProcess(
 
     YoriLibFreeStringContents(&CmdLine);
 
+    //
+    //  If the program should run on a specific node, restrict its primary
+    //  thread before it starts executing.  Threads it creates later inherit
+    //  the same processors.
+    //
+
+    if (NodeNumber != START_NO_NODE) {
+        YoriLibInitializeProcessorPlacement(&ProcessorPlacement, YoriLibPlacementByNumaNode);
+        if (!YoriLibPlaceProcessOnSet(&ProcessorPlacement, ProcessInfo.hThread, NodeNumber)) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("start: could not place program on node %i\n"), NodeNumber);
+        }
+        YoriLibCleanupProcessorPlacement(&ProcessorPlacement);
+    }
+
+    //
+    //  A processor rate limit is applied to a job object so that it
+    //  constrains the program and everything it launches.  The job remains
+    //  after this process exits, as long as processes are running in it.
+    //
+
+    hJob = NULL;
+    if (Limits->CpuRate != 0) {
+        hJob = YoriLibCreateJobObject();
+        if (hJob != NULL &&
+            !YoriLibAssignProcessToJobObject(hJob, ProcessInfo.hProcess)) {
+
+            CloseHandle(hJob);
+            hJob = NULL;
+        }
+    }
+
+    if (!YoriLibApplyProcessLimits(ProcessInfo.hProcess, hJob, Limits)) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("start: some limits are not supported on this system\n"));
+    }
+
+    if (hJob != NULL) {
+        CloseHandle(hJob);
+    }
+
+    if (CreationFlags & CREATE_SUSPENDED) {
+        ResumeThread(ProcessInfo.hThread);
+    }
+
     if (ProcessInfo.hThread != NULL) {
         CloseHandle(ProcessInfo.hThread);
     }
@@ -316,6 +390,15 @@ StartShellExecute(
         be allocated.  FALSE to inherit the environment from the current
         process.
 
+ @param NodeNumber The NUMA node whose processors the program should run on,
+        or START_NO_NODE to let the system schedule it anywhere.  ShellExecute
+        cannot restrict the program this way, so specifying a node requires
+        the program to be launched with CreateProcess.
+
+ @param Limits Pointer to limits to apply to the program.  As with
+        NodeNumber, specifying any limit requires the program to be launched
+        with CreateProcess.
+
  @return TRUE to indicate success, FALSE on failure.
  */
 BOOLEAN
@@ -325,14 +408,21 @@ StartExecute(
     __in INT ShowState,
     __in BOOLEAN Elevate,
     __in BOOLEAN NoElevate,
-    __in BOOLEAN CleanEnvironment
+    __in BOOLEAN CleanEnvironment,
+    __in DWORD NodeNumber,
+    __in PYORI_LIB_PROCESS_LIMITS Limits
     )
 {
     YoriLibLoadShell32Functions();
     YoriLibLoadUserEnvFunctions();
     YoriLibLoadAdvApi32Functions();
 
-    if (!CleanEnvironment) {
+    if (!CleanEnvironment &&
+        NodeNumber == START_NO_NODE &&
+        Limits->CpuRate == 0 &&
+        Limits->IoPriority == YORI_LIB_PRIORITY_UNCHANGED &&
+        Limits->MemoryPriority == YORI_LIB_PRIORITY_UNCHANGED) {
+
         if (Elevate && DllShell32.pShellExecuteExW == NULL) {
             return FALSE;
         }
@@ -342,7 +432,7 @@ StartExecute(
         }
     }
 
-    return StartCreateProcess(ArgC, ArgV, ShowState, CleanEnvironment);
+    return StartCreateProcess(ArgC, ArgV, ShowState, CleanEnvironment, NodeNumber, Limits);
 }
 
 #ifdef YORI_BUILTIN
@@ -384,8 +474,12 @@ ENTRYPOINT(
     BOOLEAN Result;
     BOOLEAN NoElevate = FALSE;
     BOOLEAN CleanEnvironment = FALSE;
+    DWORD NodeNumber = START_NO_NODE;
+    YORI_LIB_PROCESS_LIMITS Limits;
+    YORI_ALLOC_SIZE_T ArgsConsumed;
 
     ShowState = SW_SHOWNORMAL;
+    YoriLibInitializeProcessLimits(&Limits);
 
     for (i = 1; i < ArgC; i++) {
 
@@ -411,6 +505,22 @@ ENTRYPOINT(
                 NoElevate = TRUE;
                 Elevate = FALSE;
                 ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("node")) == 0) {
+                if (ArgC > i + 1) {
+                    YORI_MAX_SIGNED_T LlNodeNumber;
+                    YORI_ALLOC_SIZE_T CharsConsumed;
+                    if (YoriLibStringToNumber(&ArgV[i + 1], TRUE, &LlNodeNumber, &CharsConsumed) &&
+                        CharsConsumed > 0 &&
+                        LlNodeNumber >= 0) {
+
+                        NodeNumber = (DWORD)LlNodeNumber;
+                        ArgumentUnderstood = TRUE;
+                        i++;
+                    }
+                }
+            } else if (YoriLibParseProcessLimitArgument(&Arg, ArgC, ArgV, i, &Limits, &ArgsConsumed)) {
+                i = i + ArgsConsumed;
+                ArgumentUnderstood = TRUE;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("s:b")) == 0) {
                 ShowState = SW_SHOWNOACTIVATE;
                 ArgumentUnderstood = TRUE;
@@ -446,6 +556,20 @@ ENTRYPOINT(
         return EXIT_FAILURE;
     }
 
+    if (NodeNumber != START_NO_NODE && (Elevate || NoElevate)) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("start: node incompatible with elevation\n"));
+        return EXIT_FAILURE;
+    }
+
+    if ((Limits.CpuRate != 0 ||
+         Limits.IoPriority != YORI_LIB_PRIORITY_UNCHANGED ||
+         Limits.MemoryPriority != YORI_LIB_PRIORITY_UNCHANGED) &&
+        (Elevate || NoElevate)) {
+
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("start: limits incompatible with elevation\n"));
+        return EXIT_FAILURE;
+    }
+
     if (Elevate && NoElevate) {
         YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("start: elevate incompatible with no elevate\n"));
         return EXIT_FAILURE;
@@ -512,11 +636,11 @@ ENTRYPOINT(
             ArgArray[Index + 2].MemoryToFree = NULL;
         }
 
-        Result = StartExecute(ArgCount + 2, ArgArray, ShowState, Elevate, NoElevate, CleanEnvironment);
+        Result = StartExecute(ArgCount + 2, ArgArray, ShowState, Elevate, NoElevate, CleanEnvironment, NodeNumber, &Limits);
         YoriLibFreeStringContents(&ArgArray[0]);
         YoriLibFree(ArgArray);
     } else {
-        Result = StartExecute(ArgC - StartArg, &ArgV[StartArg], ShowState, Elevate, NoElevate, CleanEnvironment);
+        Result = StartExecute(ArgC - StartArg, &ArgV[StartArg], ShowState, Elevate, NoElevate, CleanEnvironment, NodeNumber, &Limits);
     }
 
     if (Result) {
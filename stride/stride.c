@@ -35,13 +35,21 @@ CHAR strStrideHelpText[] =
         "\n"
         "Output periodic contents of one or more files.\n"
         "\n"
-        "STRIDE [-license] [-b] [-s] [-h <num>] [-n] [<file>...]\n"
+        "STRIDE [-license] [-b] [-s] [-c <size>] [-i <num>] [-l <num>] [-o <num>]\n"
+        "       [-f <value> [-t <value>]] [<file>...]\n"
         "\n"
         "   -b             Use basic search criteria for files only\n"
+        "   -c <size>      The number of bytes between each output, seeking within\n"
+        "                    the file rather than reading every line\n"
+        "   -f <value>     Search a sorted file for the first line starting with\n"
+        "                    a value greater than or equal to value, and output\n"
+        "                    from that line\n"
         "   -i <num>       The number of lines between each output\n"
         "   -l <num>       The number of lines to output on each interval\n"
         "   -o <num>       The number of lines to offset from each interval\n"
-        "   -s             Process files from all subdirectories\n";
+        "   -s             Process files from all subdirectories\n"
+        "   -t <value>     With -f, stop at the first line starting with a value\n"
+        "                    greater than value\n";
 
 /**
  Display usage text to the user.
@@ -90,6 +98,25 @@ typedef struct _STRIDE_CONTEXT {
      */
     DWORD LinesOnEachInterval;
 
+    /**
+     If nonzero, specifies the number of bytes between each stride.  Files
+     are sampled by seeking rather than reading every line.
+     */
+    DWORDLONG ByteInterval;
+
+    /**
+     If not NULL, points to a value to search for in a sorted file.  Lines
+     are output from the first line whose prefix is greater than or equal to
+     this value.
+     */
+    PYORI_STRING FindFrom;
+
+    /**
+     If not NULL, points to a value that ends output when FindFrom is used.
+     Output stops at the first line whose prefix is greater than this value.
+     */
+    PYORI_STRING FindTo;
+
     /**
      Records the total number of files processed.
      */
@@ -108,6 +135,536 @@ typedef struct _STRIDE_CONTEXT {
 
 } STRIDE_CONTEXT, *PSTRIDE_CONTEXT;
 
+/**
+ Output a single line, followed by a newline unless the line has caused the
+ console cursor to wrap to the next line already.
+
+ @param Line Pointer to the line to output.
+
+ @param OutputHandle Handle to standard output.
+
+ @param OutputIsConsole TRUE if standard output is a console.
+ */
+VOID
+StrideOutputLine(
+    __in PYORI_STRING Line,
+    __in HANDLE OutputHandle,
+    __in BOOL OutputIsConsole
+    )
+{
+    CONSOLE_SCREEN_BUFFER_INFO ScreenInfo;
+
+    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y"), Line);
+    if (Line->LengthInChars == 0 ||
+        !OutputIsConsole ||
+        !GetConsoleScreenBufferInfo(OutputHandle, &ScreenInfo) ||
+        ScreenInfo.dwCursorPosition.X != 0) {
+
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("\n"));
+    }
+}
+
+/**
+ The number of bytes to read from a file when locating a line at an
+ arbitrary offset.  Lines longer than this are truncated when displayed.
+ */
+#define STRIDE_SEEK_BUFFER_SIZE (64 * 1024)
+
+/**
+ State used to read lines from arbitrary offsets within a file.
+ */
+typedef struct _STRIDE_SEEK_CONTEXT {
+
+    /**
+     Handle to the file being read.
+     */
+    HANDLE hSource;
+
+    /**
+     A buffer containing data read from the file.
+     */
+    PUCHAR Buffer;
+
+    /**
+     The number of bytes of valid data in Buffer.
+     */
+    DWORD BytesInBuffer;
+
+    /**
+     The offset within the file of the first byte in Buffer.
+     */
+    DWORDLONG BufferOffset;
+
+    /**
+     The size of the file, in bytes.
+     */
+    DWORDLONG FileSize;
+
+    /**
+     The number of bytes in each character, which is two for UTF16 and one
+     for other encodings.
+     */
+    DWORD CharSize;
+
+    /**
+     The most recently read line, decoded from the file's encoding.
+     */
+    YORI_STRING Line;
+
+} STRIDE_SEEK_CONTEXT, *PSTRIDE_SEEK_CONTEXT;
+
+/**
+ Fill the seek buffer with data starting at a specified offset.
+
+ @param Seek Pointer to the seek context.
+
+ @param Offset The offset within the file to read from.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+StrideSeekRead(
+    __inout PSTRIDE_SEEK_CONTEXT Seek,
+    __in DWORDLONG Offset
+    )
+{
+    LARGE_INTEGER ReadOffset;
+    DWORD BytesRead;
+
+    Seek->BytesInBuffer = 0;
+    ReadOffset.QuadPart = Offset;
+    if (SetFilePointer(Seek->hSource, ReadOffset.LowPart, &ReadOffset.HighPart, FILE_BEGIN) == INVALID_SET_FILE_POINTER &&
+        GetLastError() != NO_ERROR) {
+
+        return FALSE;
+    }
+
+    if (!ReadFile(Seek->hSource, Seek->Buffer, STRIDE_SEEK_BUFFER_SIZE, &BytesRead, NULL)) {
+        return FALSE;
+    }
+
+    Seek->BufferOffset = Offset;
+    Seek->BytesInBuffer = BytesRead - (BytesRead % Seek->CharSize);
+    return TRUE;
+}
+
+/**
+ Find the end of the line containing a specified offset.  On success, the
+ line from Offset to LineEnd is contained within the seek buffer.
+
+ @param Seek Pointer to the seek context.
+
+ @param Offset The offset within the file to search from.
+
+ @param LineEnd On successful completion, populated with the offset of the
+        newline character that terminates the line, or the end of the data
+        if the line is not terminated.
+
+ @param NextLine On successful completion, populated with the offset of the
+        line that follows.  If the line is truncated, this is the same as
+        LineEnd.
+
+ @param Truncated On successful completion, set to TRUE if the line is longer
+        than the seek buffer, so LineEnd is not the end of the line.
+
+ @return TRUE if the line was found, FALSE if Offset is beyond the end of
+         the file or the file could not be read.
+ */
+__success(return)
+BOOL
+StrideSeekFindLineEnd(
+    __inout PSTRIDE_SEEK_CONTEXT Seek,
+    __in DWORDLONG Offset,
+    __out PDWORDLONG LineEnd,
+    __out PDWORDLONG NextLine,
+    __out PBOOLEAN Truncated
+    )
+{
+    DWORD Index;
+    DWORD Char;
+
+    if (Offset >= Seek->FileSize) {
+        return FALSE;
+    }
+
+    while (TRUE) {
+
+        //
+        //  Use data that has already been read if it contains the offset.
+        //
+
+        if (Offset < Seek->BufferOffset ||
+            Offset >= Seek->BufferOffset + Seek->BytesInBuffer) {
+
+            if (!StrideSeekRead(Seek, Offset) || Seek->BytesInBuffer == 0) {
+                return FALSE;
+            }
+        }
+
+        for (Index = (DWORD)(Offset - Seek->BufferOffset); Index + Seek->CharSize <= Seek->BytesInBuffer; Index = Index + Seek->CharSize) {
+            if (Seek->CharSize == sizeof(WCHAR)) {
+                Char = *(PWCHAR)(&Seek->Buffer[Index]);
+            } else {
+                Char = Seek->Buffer[Index];
+            }
+
+            if (Char == '\n') {
+                *LineEnd = Seek->BufferOffset + Index;
+                *NextLine = *LineEnd + Seek->CharSize;
+                *Truncated = FALSE;
+                return TRUE;
+            }
+        }
+
+        //
+        //  If the buffer reaches the end of the file, the line ends there.
+        //  If the buffer was read from this offset, the line is longer than
+        //  the buffer.  Otherwise, read again from this offset.
+        //
+
+        if (Seek->BufferOffset + Seek->BytesInBuffer >= Seek->FileSize) {
+            *LineEnd = Seek->BufferOffset + Seek->BytesInBuffer;
+            *NextLine = *LineEnd;
+            *Truncated = FALSE;
+            return TRUE;
+        }
+
+        if (Seek->BufferOffset == Offset) {
+            *LineEnd = Seek->BufferOffset + Seek->BytesInBuffer;
+            *NextLine = *LineEnd;
+            *Truncated = TRUE;
+            return TRUE;
+        }
+
+        Seek->BytesInBuffer = 0;
+    }
+}
+
+/**
+ Find the start of the line following the line containing a specified
+ offset.
+
+ @param Seek Pointer to the seek context.
+
+ @param Offset The offset within the file.
+
+ @return The offset of the following line, or the size of the file if there
+         is no following line.
+ */
+DWORDLONG
+StrideSeekSkipLine(
+    __inout PSTRIDE_SEEK_CONTEXT Seek,
+    __in DWORDLONG Offset
+    )
+{
+    DWORDLONG LineEnd;
+    DWORDLONG NextLine;
+    BOOLEAN Truncated;
+
+    while (StrideSeekFindLineEnd(Seek, Offset, &LineEnd, &NextLine, &Truncated)) {
+        if (!Truncated) {
+            return NextLine;
+        }
+        Offset = LineEnd;
+    }
+
+    return Seek->FileSize;
+}
+
+/**
+ Find the first line that starts at or after a specified offset.
+
+ @param Seek Pointer to the seek context.
+
+ @param Offset The offset within the file.
+
+ @return The offset of the first line that starts at or after Offset, or the
+         size of the file if no line does.
+ */
+DWORDLONG
+StrideSeekGetLineStart(
+    __inout PSTRIDE_SEEK_CONTEXT Seek,
+    __in DWORDLONG Offset
+    )
+{
+    Offset = Offset - (Offset % Seek->CharSize);
+    if (Offset == 0) {
+        return 0;
+    }
+
+    //
+    //  Whether a line begins at the offset depends on the character before
+    //  it, so search from one character earlier.
+    //
+
+    return StrideSeekSkipLine(Seek, Offset - Seek->CharSize);
+}
+
+/**
+ Read the line that starts at a specified offset into the Line member of the
+ seek context.
+
+ @param Seek Pointer to the seek context.
+
+ @param LineStart The offset within the file of the start of the line.
+
+ @param NextLine On successful completion, populated with the offset of the
+        line that follows.
+
+ @return TRUE to indicate success, FALSE to indicate the end of the file was
+         reached or the line could not be read.
+ */
+__success(return)
+BOOL
+StrideSeekGetLine(
+    __inout PSTRIDE_SEEK_CONTEXT Seek,
+    __in DWORDLONG LineStart,
+    __out PDWORDLONG NextLine
+    )
+{
+    DWORDLONG LineEnd;
+    PUCHAR LineBytes;
+    YORI_ALLOC_SIZE_T LineLength;
+    YORI_ALLOC_SIZE_T CharsNeeded;
+    BOOLEAN Truncated;
+
+    if (!StrideSeekFindLineEnd(Seek, LineStart, &LineEnd, NextLine, &Truncated)) {
+        return FALSE;
+    }
+
+    LineBytes = &Seek->Buffer[LineStart - Seek->BufferOffset];
+    LineLength = (YORI_ALLOC_SIZE_T)(LineEnd - LineStart);
+
+    //
+    //  Remove the carriage return from a CRLF line ending, and the byte
+    //  order mark from the first line, as the line reader does.
+    //
+
+    if (Seek->CharSize == sizeof(WCHAR)) {
+        if (LineLength >= sizeof(WCHAR) &&
+            *(PWCHAR)(&LineBytes[LineLength - sizeof(WCHAR)]) == '\r') {
+
+            LineLength = LineLength - sizeof(WCHAR);
+        }
+    } else if (LineLength > 0 && LineBytes[LineLength - 1] == '\r') {
+        LineLength--;
+    }
+
+    if (LineStart == 0) {
+        UCHAR BomLength;
+        BomLength = YoriLibBytesInBom(LineBytes, LineLength);
+        LineBytes = LineBytes + BomLength;
+        LineLength = LineLength - BomLength;
+    }
+
+    if (Seek->CharSize == sizeof(WCHAR)) {
+        CharsNeeded = LineLength / sizeof(WCHAR);
+    } else if (LineLength > 0) {
+        CharsNeeded = YoriLibGetMultibyteInputSizeNeeded((LPCSTR)LineBytes, LineLength);
+    } else {
+        CharsNeeded = 0;
+    }
+
+    if (Seek->Line.LengthAllocated < CharsNeeded + 1) {
+        YoriLibFreeStringContents(&Seek->Line);
+        if (!YoriLibAllocateString(&Seek->Line, CharsNeeded + 1)) {
+            return FALSE;
+        }
+    }
+
+    if (Seek->CharSize == sizeof(WCHAR)) {
+        memcpy(Seek->Line.StartOfString, LineBytes, CharsNeeded * sizeof(WCHAR));
+    } else if (CharsNeeded > 0) {
+        YoriLibMultibyteInput((LPCSTR)LineBytes, LineLength, Seek->Line.StartOfString, CharsNeeded);
+    }
+
+    Seek->Line.LengthInChars = CharsNeeded;
+    Seek->Line.StartOfString[CharsNeeded] = '\0';
+
+    //
+    //  A line longer than the buffer is displayed truncated, but the
+    //  following line still needs to be found.  This reuses the buffer, so
+    //  must happen after the line has been decoded.
+    //
+
+    if (Truncated) {
+        *NextLine = StrideSeekSkipLine(Seek, LineEnd);
+    }
+
+    return TRUE;
+}
+
+/**
+ Find the first line in a sorted file whose prefix is greater than or equal
+ to a specified value, by binary search over byte offsets.
+
+ @param Seek Pointer to the seek context.
+
+ @param Value Pointer to the value to search for.
+
+ @return The offset of the first line whose prefix is greater than or equal
+         to Value, or the size of the file if no line is.
+ */
+DWORDLONG
+StrideSeekFindFirstLine(
+    __inout PSTRIDE_SEEK_CONTEXT Seek,
+    __in PYORI_STRING Value
+    )
+{
+    DWORDLONG Low;
+    DWORDLONG High;
+    DWORDLONG Mid;
+    DWORDLONG LineStart;
+    DWORDLONG NextLine;
+
+    //
+    //  The line being searched for is always the first line starting at or
+    //  after Low, and the first line starting at or after High.  Each
+    //  iteration examines the first line starting at or after the midpoint,
+    //  and if it is before the line being searched for, so is every line up
+    //  to it.
+    //
+
+    Low = 0;
+    High = Seek->FileSize;
+    while (Low < High) {
+        Mid = Low + (High - Low) / 2;
+        LineStart = StrideSeekGetLineStart(Seek, Mid);
+        if (LineStart >= Seek->FileSize ||
+            !StrideSeekGetLine(Seek, LineStart, &NextLine) ||
+            YoriLibCompareStringCnt(&Seek->Line, Value, Value->LengthInChars) >= 0) {
+
+            High = Mid;
+        } else {
+            Low = Mid + 1;
+        }
+    }
+
+    return StrideSeekGetLineStart(Seek, Low);
+}
+
+/**
+ Process a single opened file by seeking to offsets within it rather than
+ reading it sequentially.  If a value to search for is specified, lines are
+ displayed from the first line at or after that value.  Otherwise, lines are
+ displayed at each byte interval.
+
+ @param hSource The opened source file.
+
+ @param StrideContext Pointer to context information specifying which lines
+        to display.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+StrideProcessSeekable(
+    __in HANDLE hSource,
+    __in PSTRIDE_CONTEXT StrideContext
+    )
+{
+    STRIDE_SEEK_CONTEXT Seek;
+    LARGE_INTEGER FileSize;
+    DWORDLONG Offset;
+    DWORDLONG LineStart;
+    DWORDLONG NextLine;
+    DWORDLONG NextUnread;
+    DWORD Count;
+    DWORD dwMode;
+    BOOL OutputIsConsole;
+    HANDLE OutputHandle;
+
+    if ((GetFileType(hSource) & ~(FILE_TYPE_REMOTE)) != FILE_TYPE_DISK) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("stride: seeking requires a file\n"));
+        return FALSE;
+    }
+
+    FileSize.LowPart = GetFileSize(hSource, (LPDWORD)&FileSize.HighPart);
+    if (FileSize.LowPart == INVALID_FILE_SIZE && GetLastError() != NO_ERROR) {
+        return FALSE;
+    }
+
+    ZeroMemory(&Seek, sizeof(Seek));
+    Seek.hSource = hSource;
+    Seek.FileSize = FileSize.QuadPart;
+    Seek.CharSize = 1;
+    if (YoriLibGetMultibyteInputEncoding() == CP_UTF16) {
+        Seek.CharSize = sizeof(WCHAR);
+    }
+    YoriLibInitEmptyString(&Seek.Line);
+    Seek.Buffer = YoriLibMalloc(STRIDE_SEEK_BUFFER_SIZE);
+    if (Seek.Buffer == NULL) {
+        return FALSE;
+    }
+
+    OutputHandle = GetStdHandle(STD_OUTPUT_HANDLE);
+    OutputIsConsole = FALSE;
+    if (GetConsoleMode(OutputHandle, &dwMode)) {
+        OutputIsConsole = TRUE;
+    }
+
+    if (StrideContext->FindFrom != NULL) {
+
+        //
+        //  Display every line from the first line at or after the starting
+        //  value until a line is found after the ending value.
+        //
+
+        LineStart = StrideSeekFindFirstLine(&Seek, StrideContext->FindFrom);
+        while (StrideSeekGetLine(&Seek, LineStart, &NextLine)) {
+            if (StrideContext->FindTo != NULL &&
+                YoriLibCompareStringCnt(&Seek.Line, StrideContext->FindTo, StrideContext->FindTo->LengthInChars) > 0) {
+
+                break;
+            }
+
+            if (YoriLibIsOperationCancelled()) {
+                break;
+            }
+
+            StrideOutputLine(&Seek.Line, OutputHandle, OutputIsConsole);
+            StrideContext->FileLinesFound++;
+            LineStart = NextLine;
+        }
+    } else {
+
+        //
+        //  Display lines from the first line that starts at each interval.
+        //  If lines displayed from the previous interval extend beyond this
+        //  point, continue from the end of those lines so that no line is
+        //  displayed twice.
+        //
+
+        NextUnread = 0;
+        for (Offset = 0; Offset < Seek.FileSize; Offset = Offset + StrideContext->ByteInterval) {
+            if (YoriLibIsOperationCancelled()) {
+                break;
+            }
+
+            LineStart = StrideSeekGetLineStart(&Seek, Offset);
+            if (LineStart < NextUnread) {
+                LineStart = NextUnread;
+            }
+
+            for (Count = 0; Count < StrideContext->LinesOnEachInterval; Count++) {
+                if (!StrideSeekGetLine(&Seek, LineStart, &NextLine)) {
+                    break;
+                }
+
+                StrideOutputLine(&Seek.Line, OutputHandle, OutputIsConsole);
+                StrideContext->FileLinesFound++;
+                LineStart = NextLine;
+            }
+
+            NextUnread = LineStart;
+        }
+    }
+
+    YoriLibFreeStringContents(&Seek.Line);
+    YoriLibFree(Seek.Buffer);
+
+    return TRUE;
+}
+
 /**
  Process a single opened stream, enumerating through all lines and displaying
  the set requested by the user.
@@ -126,22 +683,24 @@ StrideProcessStream(
     )
 {
     PVOID LineContext = NULL;
-    CONSOLE_SCREEN_BUFFER_INFO ScreenInfo;
     YORI_STRING LineString;
     BOOL OutputIsConsole;
     DWORD dwMode;
-    DWORD CharactersDisplayed;
     DWORD LineRelativeToStride;
     HANDLE OutputHandle;
 
-    OutputHandle = GetStdHandle(STD_OUTPUT_HANDLE);
-
-    YoriLibInitEmptyString(&LineString);
-
     StrideContext->FilesFound++;
     StrideContext->FilesFoundThisArg++;
     StrideContext->FileLinesFound = 0;
 
+    if (StrideContext->ByteInterval != 0 || StrideContext->FindFrom != NULL) {
+        return StrideProcessSeekable(hSource, StrideContext);
+    }
+
+    OutputHandle = GetStdHandle(STD_OUTPUT_HANDLE);
+
+    YoriLibInitEmptyString(&LineString);
+
     OutputIsConsole = FALSE;
     if (GetConsoleMode(OutputHandle, &dwMode)) {
         OutputIsConsole = TRUE;
@@ -157,16 +716,7 @@ StrideProcessStream(
         StrideContext->FileLinesFound++;
 
         if (LineRelativeToStride < StrideContext->LinesOnEachInterval) {
-
-            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y"), &LineString);
-            CharactersDisplayed = LineString.LengthInChars;
-            if (CharactersDisplayed == 0 ||
-                !OutputIsConsole ||
-                !GetConsoleScreenBufferInfo(OutputHandle, &ScreenInfo) ||
-                ScreenInfo.dwCursorPosition.X != 0) {
-
-                YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("\n"));
-            }
+            StrideOutputLine(&LineString, OutputHandle, OutputIsConsole);
         }
     }
 
@@ -354,6 +904,20 @@ ENTRYPOINT(
             } else if (YoriLibCompareStringLitIns(&Arg, _T("b")) == 0) {
                 BasicEnumeration = TRUE;
                 ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("c")) == 0) {
+                if (ArgC > i + 1) {
+                    StrideContext.ByteInterval = YoriLibStringToFileSize(&ArgV[i + 1]).QuadPart;
+                    if (StrideContext.ByteInterval > 0) {
+                        ArgumentUnderstood = TRUE;
+                        i++;
+                    }
+                }
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("f")) == 0) {
+                if (ArgC > i + 1) {
+                    StrideContext.FindFrom = &ArgV[i + 1];
+                    ArgumentUnderstood = TRUE;
+                    i++;
+                }
             } else if (YoriLibCompareStringLitIns(&Arg, _T("i")) == 0) {
                 if (ArgC > i + 1) {
                     if (YoriLibStringToNumber(&ArgV[i + 1], TRUE, &llTemp, &CharsConsumed) &&
@@ -387,6 +951,12 @@ ENTRYPOINT(
             } else if (YoriLibCompareStringLitIns(&Arg, _T("s")) == 0) {
                 StrideContext.Recursive = TRUE;
                 ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("t")) == 0) {
+                if (ArgC > i + 1) {
+                    StrideContext.FindTo = &ArgV[i + 1];
+                    ArgumentUnderstood = TRUE;
+                    i++;
+                }
             } else if (YoriLibCompareStringLitIns(&Arg, _T("-")) == 0) {
                 StartArg = i + 1;
                 ArgumentUnderstood = TRUE;
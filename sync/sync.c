@@ -3,7 +3,7 @@
  *
  * Yori flush files, directories or volumes to disk.
  *
- * Copyright (c) 2018 Malcolm J. Smith
+ * Copyright (c) 2018-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -41,7 +41,10 @@ CHAR strSyncHelpText[] =
         "   -q             Query if the volume is in use, and flush if it is not in use\n"
         "   -r             Dismount and remount the volume\n"
         "   -s             Process files from all subdirectories\n"
-        "   -v             Display verbose output\n";
+        "   -v             Display verbose output and time taken for each volume\n"
+        "\n"
+        "Specifying the root of a volume flushes the entire volume if it can be\n"
+        "opened, which typically requires administrative privilege.\n";
 
 /**
  Display usage text to the user.
@@ -57,6 +60,71 @@ SyncHelp(VOID)
     return TRUE;
 }
 
+/**
+ The maximum number of threads to use when flushing objects.  Flushing is
+ dominated by device latency rather than processor time, so this is not
+ related to the number of processors.
+ */
+#define SYNC_MAX_THREADS (16)
+
+/**
+ A value for a volume index indicating that the volume hosting an object
+ could not be determined.
+ */
+#define SYNC_NO_VOLUME ((DWORD)-1)
+
+/**
+ Information about a volume hosting objects to flush.
+ */
+typedef struct _SYNC_VOLUME {
+
+    /**
+     The path to the volume.
+     */
+    YORI_STRING VolumePath;
+
+    /**
+     A handle to the volume if the entire volume is being flushed, or NULL
+     if individual objects on the volume are being flushed.
+     */
+    HANDLE VolumeHandle;
+
+    /**
+     The number of objects on this volume that were flushed successfully.
+     */
+    DWORD ObjectsFlushed;
+
+    /**
+     The number of objects on this volume that could not be flushed.
+     */
+    DWORD ObjectsFailed;
+
+    /**
+     The time that the final flush on this volume completed.
+     */
+    LONGLONG EndTime;
+
+} SYNC_VOLUME, *PSYNC_VOLUME;
+
+/**
+ Information about a single object to flush.
+ */
+typedef struct _SYNC_ENTRY {
+
+    /**
+     The path to the object to flush.  This is empty if the entry describes
+     a flush of an entire volume.
+     */
+    YORI_STRING FilePath;
+
+    /**
+     The index of the volume hosting the object, or SYNC_NO_VOLUME if it
+     could not be determined.
+     */
+    DWORD VolumeIndex;
+
+} SYNC_ENTRY, *PSYNC_ENTRY;
+
 /**
  Context passed to the callback which is invoked for each file found.
  */
@@ -86,11 +154,360 @@ typedef struct _SYNC_CONTEXT {
      */
     BOOL Verbose;
 
+    /**
+     TRUE if an object could not be recorded because memory could not be
+     allocated.
+     */
+    BOOLEAN OutOfMemory;
+
+    /**
+     An array of volumes hosting objects to flush.
+     */
+    PSYNC_VOLUME Volumes;
+
+    /**
+     The number of elements in Volumes that are populated.
+     */
+    DWORD VolumeCount;
+
+    /**
+     The number of elements allocated in Volumes.
+     */
+    DWORD VolumesAllocated;
+
+    /**
+     An array of objects to flush, in the order they were found.
+     */
+    PSYNC_ENTRY Entries;
+
+    /**
+     The number of elements in Entries that are populated.
+     */
+    DWORD EntryCount;
+
+    /**
+     The number of elements allocated in Entries.
+     */
+    DWORD EntriesAllocated;
+
+    /**
+     An array of indexes into Entries describing the order that objects are
+     flushed.  Objects are grouped by volume, and objects on volumes that
+     are flushed in their entirety are omitted.
+     */
+    PDWORD WorkItems;
+
+    /**
+     The number of elements in WorkItems.
+     */
+    DWORD WorkItemCount;
+
+    /**
+     The time that flushing started.
+     */
+    LONGLONG StartTime;
+
+    /**
+     Synchronizes updates to volume statistics and output from worker
+     threads.
+     */
+    CRITICAL_SECTION Lock;
+
 } SYNC_CONTEXT, *PSYNC_CONTEXT;
 
+/**
+ Find the volume hosting an object, adding it to the set of known volumes
+ if it has not been seen before.
+
+ @param SyncContext Pointer to the sync context.
+
+ @param VolumePath Pointer to the path of the volume.
+
+ @return The index of the volume, or SYNC_NO_VOLUME on allocation failure.
+ */
+DWORD
+SyncFindOrAddVolume(
+    __inout PSYNC_CONTEXT SyncContext,
+    __in PYORI_STRING VolumePath
+    )
+{
+    PSYNC_VOLUME NewVolumes;
+    PSYNC_VOLUME Volume;
+    DWORD NewAllocated;
+    DWORD Index;
+
+    for (Index = 0; Index < SyncContext->VolumeCount; Index++) {
+        if (YoriLibCompareStringIns(&SyncContext->Volumes[Index].VolumePath, VolumePath) == 0) {
+            return Index;
+        }
+    }
+
+    if (SyncContext->VolumeCount >= SyncContext->VolumesAllocated) {
+        NewAllocated = SyncContext->VolumesAllocated * 2;
+        if (NewAllocated < 8) {
+            NewAllocated = 8;
+        }
+        NewVolumes = YoriLibMalloc((YORI_ALLOC_SIZE_T)(NewAllocated * sizeof(SYNC_VOLUME)));
+        if (NewVolumes == NULL) {
+            return SYNC_NO_VOLUME;
+        }
+        if (SyncContext->Volumes != NULL) {
+            memcpy(NewVolumes, SyncContext->Volumes, SyncContext->VolumeCount * sizeof(SYNC_VOLUME));
+            YoriLibFree(SyncContext->Volumes);
+        }
+        SyncContext->Volumes = NewVolumes;
+        SyncContext->VolumesAllocated = NewAllocated;
+    }
+
+    Volume = &SyncContext->Volumes[SyncContext->VolumeCount];
+    ZeroMemory(Volume, sizeof(SYNC_VOLUME));
+    if (!YoriLibCopyString(&Volume->VolumePath, VolumePath)) {
+        return SYNC_NO_VOLUME;
+    }
+
+    Index = SyncContext->VolumeCount;
+    SyncContext->VolumeCount++;
+    return Index;
+}
+
+/**
+ Record an object to flush.
+
+ @param SyncContext Pointer to the sync context.
+
+ @param FilePath Pointer to the path of the object to flush.  If this is
+        NULL, the entry describes a flush of the entire volume.
+
+ @param VolumeIndex The index of the volume hosting the object, or
+        SYNC_NO_VOLUME if it could not be determined.
+
+ @return TRUE to indicate success, FALSE on allocation failure.
+ */
+BOOLEAN
+SyncAddEntry(
+    __inout PSYNC_CONTEXT SyncContext,
+    __in_opt PYORI_STRING FilePath,
+    __in DWORD VolumeIndex
+    )
+{
+    PSYNC_ENTRY NewEntries;
+    PSYNC_ENTRY Entry;
+    DWORD NewAllocated;
+
+    if (SyncContext->EntryCount >= SyncContext->EntriesAllocated) {
+        NewAllocated = SyncContext->EntriesAllocated * 2;
+        if (NewAllocated < 64) {
+            NewAllocated = 64;
+        }
+        if (!YoriLibIsSizeAllocatable(NewAllocated * sizeof(SYNC_ENTRY))) {
+            return FALSE;
+        }
+        NewEntries = YoriLibMalloc((YORI_ALLOC_SIZE_T)(NewAllocated * sizeof(SYNC_ENTRY)));
+        if (NewEntries == NULL) {
+            return FALSE;
+        }
+        if (SyncContext->Entries != NULL) {
+            memcpy(NewEntries, SyncContext->Entries, SyncContext->EntryCount * sizeof(SYNC_ENTRY));
+            YoriLibFree(SyncContext->Entries);
+        }
+        SyncContext->Entries = NewEntries;
+        SyncContext->EntriesAllocated = NewAllocated;
+    }
+
+    Entry = &SyncContext->Entries[SyncContext->EntryCount];
+    YoriLibInitEmptyString(&Entry->FilePath);
+    if (FilePath != NULL) {
+        if (!YoriLibCopyString(&Entry->FilePath, FilePath)) {
+            return FALSE;
+        }
+    }
+    Entry->VolumeIndex = VolumeIndex;
+    SyncContext->EntryCount++;
+    return TRUE;
+}
+
+/**
+ Check if a user argument refers to the root of a volume, or everything on
+ the volume when enumerating recursively.  If so, and the volume can be
+ opened for flushing, a single flush of the volume is used instead of
+ flushing every object on it.  Opening a volume typically requires
+ administrative privilege, so when this is not possible the caller
+ enumerates and flushes individual objects instead.
+
+ @param SyncContext Pointer to the sync context.
+
+ @param FileSpec Pointer to the user's argument.
+
+ @param Recursive TRUE if objects are being enumerated recursively.
+
+ @return TRUE if the argument is satisfied by flushing the volume, FALSE
+         if objects should be enumerated and flushed individually.
+ */
+BOOLEAN
+SyncTryAddVolumeFlush(
+    __inout PSYNC_CONTEXT SyncContext,
+    __in PYORI_STRING FileSpec,
+    __in BOOLEAN Recursive
+    )
+{
+    YORI_STRING FullPath;
+    YORI_STRING VolumePath;
+    YORI_STRING Remainder;
+    PSYNC_VOLUME Volume;
+    HANDLE VolumeHandle;
+    DWORD VolumeIndex;
+    BOOLEAN WholeVolume;
+
+    YoriLibInitEmptyString(&FullPath);
+    if (!YoriLibUserStringToSingleFilePath(FileSpec, TRUE, &FullPath)) {
+        return FALSE;
+    }
+
+    YoriLibInitEmptyString(&VolumePath);
+    if (!YoriLibGetVolumePathName(&FullPath, &VolumePath) ||
+        VolumePath.LengthInChars > FullPath.LengthInChars ||
+        YoriLibCompareStringInsCnt(&FullPath, &VolumePath, VolumePath.LengthInChars) != 0) {
+
+        YoriLibFreeStringContents(&VolumePath);
+        YoriLibFreeStringContents(&FullPath);
+        return FALSE;
+    }
+
+    YoriLibInitEmptyString(&Remainder);
+    Remainder.StartOfString = &FullPath.StartOfString[VolumePath.LengthInChars];
+    Remainder.LengthInChars = FullPath.LengthInChars - VolumePath.LengthInChars;
+
+    WholeVolume = FALSE;
+    if (Remainder.LengthInChars == 0 ||
+        YoriLibCompareStringLit(&Remainder, _T("\\")) == 0) {
+        WholeVolume = TRUE;
+    } else if (Recursive && YoriLibCompareStringLit(&Remainder, _T("\\*")) == 0) {
+        WholeVolume = TRUE;
+    }
+
+    YoriLibFreeStringContents(&FullPath);
+
+    if (!WholeVolume) {
+        YoriLibFreeStringContents(&VolumePath);
+        return FALSE;
+    }
+
+    VolumeIndex = SyncFindOrAddVolume(SyncContext, &VolumePath);
+    if (VolumeIndex == SYNC_NO_VOLUME) {
+        YoriLibFreeStringContents(&VolumePath);
+        return FALSE;
+    }
+
+    Volume = &SyncContext->Volumes[VolumeIndex];
+    if (Volume->VolumeHandle != NULL) {
+        YoriLibFreeStringContents(&VolumePath);
+        return TRUE;
+    }
+
+    VolumeHandle = CreateFile(VolumePath.StartOfString,
+                              GENERIC_WRITE,
+                              FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                              NULL,
+                              OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL,
+                              NULL);
+
+    YoriLibFreeStringContents(&VolumePath);
+
+    if (VolumeHandle == NULL || VolumeHandle == INVALID_HANDLE_VALUE) {
+        return FALSE;
+    }
+
+    if (!SyncAddEntry(SyncContext, NULL, VolumeIndex)) {
+        CloseHandle(VolumeHandle);
+        SyncContext->OutOfMemory = TRUE;
+        return FALSE;
+    }
+
+    Volume->VolumeHandle = VolumeHandle;
+    return TRUE;
+}
+
+/**
+ Lock or dismount the volume hosting a file.
+
+ @param FilePath Pointer to the file path that was found.
+
+ @param SyncContext Pointer to the sync context structure indicating the
+        action to perform.
+ */
+VOID
+SyncLockOrDismountVolume(
+    __in PYORI_STRING FilePath,
+    __in PSYNC_CONTEXT SyncContext
+    )
+{
+    YORI_STRING VolumePath;
+    HANDLE FileHandle;
+    DWORD LastError;
+    DWORD BytesReturned;
+    LPTSTR ErrText;
+
+    YoriLibInitEmptyString(&VolumePath);
+    if (!YoriLibGetVolumePathName(FilePath, &VolumePath)) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("sync: could not determine volume for %y\n"), FilePath);
+        return;
+    }
+
+    if (SyncContext->Verbose) {
+        if (SyncContext->VolumeDismount) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("sync: dismounting %y\n"), &VolumePath);
+        } else {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("sync: locking %y\n"), &VolumePath);
+        }
+    }
+
+    FileHandle = CreateFile(VolumePath.StartOfString,
+                            GENERIC_WRITE,
+                            FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                            NULL,
+                            OPEN_EXISTING,
+                            FILE_ATTRIBUTE_NORMAL | FILE_FLAG_BACKUP_SEMANTICS,
+                            NULL);
+
+    if (FileHandle == NULL || FileHandle == INVALID_HANDLE_VALUE) {
+        LastError = GetLastError();
+        ErrText = YoriLibGetWinErrorText(LastError);
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("sync: open of %y failed: %s"), &VolumePath, ErrText);
+        YoriLibFreeWinErrorText(ErrText);
+        YoriLibFreeStringContents(&VolumePath);
+        return;
+    }
+
+    if (SyncContext->VolumeDismount) {
+        if (!DeviceIoControl(FileHandle, FSCTL_DISMOUNT_VOLUME, NULL, 0, NULL, 0, &BytesReturned, NULL)) {
+            LastError = GetLastError();
+            ErrText = YoriLibGetWinErrorText(LastError);
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("sync: dismount of %y failed: %s"), &VolumePath, ErrText);
+            YoriLibFreeWinErrorText(ErrText);
+            YoriLibFreeStringContents(&VolumePath);
+            return;
+        }
+    } else {
+        if (!DeviceIoControl(FileHandle, FSCTL_LOCK_VOLUME, NULL, 0, NULL, 0, &BytesReturned, NULL)) {
+            LastError = GetLastError();
+            ErrText = YoriLibGetWinErrorText(LastError);
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("sync: lock of %y failed, volume may be in use: %s"), &VolumePath, ErrText);
+            YoriLibFreeWinErrorText(ErrText);
+            YoriLibFreeStringContents(&VolumePath);
+            return;
+        }
+    }
+
+    YoriLibFreeStringContents(&VolumePath);
+    CloseHandle(FileHandle);
+}
+
 /**
  A callback that is invoked when a file is found that matches a search criteria
- specified in the set of strings to enumerate.
+ specified in the set of strings to enumerate.  Volume operations are
+ performed immediately.  Objects to flush are recorded, grouped by volume,
+ and flushed concurrently once enumeration is complete.
 
  @param FilePath Pointer to the file path that was found.
 
@@ -112,11 +529,8 @@ SyncFileFoundCallback(
     __in PVOID Context
     )
 {
-    HANDLE FileHandle;
-    DWORD DesiredAccess;
-    DWORD LastError;
-    DWORD BytesReturned;
-    LPTSTR ErrText;
+    YORI_STRING VolumePath;
+    DWORD VolumeIndex;
     PSYNC_CONTEXT SyncContext = (PSYNC_CONTEXT)Context;
 
     UNREFERENCED_PARAMETER(Depth);
@@ -126,104 +540,271 @@ SyncFileFoundCallback(
 
     SyncContext->FilesFoundThisArg++;
 
-    DesiredAccess = GENERIC_WRITE;
-
     //
     //  If the user requested a volume operation, find the volume name and
-    //  attempt the operation on the volume.  If not, just use the file name
+    //  attempt the operation on the volume.  If not, record the file name
     //  that has already been located.
     //
 
     if (SyncContext->VolumeDismount || SyncContext->LockVolume) {
-        YORI_STRING VolumePath;
-        YoriLibInitEmptyString(&VolumePath);
-        if (!YoriLibGetVolumePathName(FilePath, &VolumePath)) {
-            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("sync: could not determine volume for %y\n"), FilePath);
-            return TRUE;
-        }
+        SyncLockOrDismountVolume(FilePath, SyncContext);
+        return TRUE;
+    }
+
+    VolumeIndex = SYNC_NO_VOLUME;
+    YoriLibInitEmptyString(&VolumePath);
+    if (YoriLibGetVolumePathName(FilePath, &VolumePath)) {
+        VolumeIndex = SyncFindOrAddVolume(SyncContext, &VolumePath);
+        YoriLibFreeStringContents(&VolumePath);
+    }
+
+    //
+    //  If the entire volume is being flushed, there's no need to flush
+    //  this object separately.
+    //
 
+    if (VolumeIndex != SYNC_NO_VOLUME &&
+        SyncContext->Volumes[VolumeIndex].VolumeHandle != NULL) {
+
+        return TRUE;
+    }
+
+    if (!SyncAddEntry(SyncContext, FilePath, VolumeIndex)) {
+        SyncContext->OutOfMemory = TRUE;
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ Flush a single object.
+
+ @param SyncContext Pointer to the sync context.
+
+ @param Entry Pointer to the object to flush.
+
+ @return TRUE if the object was flushed, FALSE if it was not.
+ */
+BOOLEAN
+SyncFlushEntry(
+    __in PSYNC_CONTEXT SyncContext,
+    __in PSYNC_ENTRY Entry
+    )
+{
+    HANDLE FileHandle;
+    DWORD LastError;
+    LPTSTR ErrText;
+    PSYNC_VOLUME Volume;
+
+    //
+    //  If the entry describes an entire volume, the volume was opened when
+    //  it was added.
+    //
+
+    if (Entry->FilePath.LengthInChars == 0) {
+        ASSERT(Entry->VolumeIndex != SYNC_NO_VOLUME);
+        Volume = &SyncContext->Volumes[Entry->VolumeIndex];
         if (SyncContext->Verbose) {
-            if (SyncContext->VolumeDismount) {
-                YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("sync: dismounting %y\n"), &VolumePath);
-            } else {
-                YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("sync: locking %y\n"), &VolumePath);
-            }
+            EnterCriticalSection(&SyncContext->Lock);
+            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("sync: syncing volume %y\n"), &Volume->VolumePath);
+            LeaveCriticalSection(&SyncContext->Lock);
         }
 
-        FileHandle = CreateFile(VolumePath.StartOfString,
-                                DesiredAccess,
-                                FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
-                                NULL,
-                                OPEN_EXISTING,
-                                FILE_ATTRIBUTE_NORMAL | FILE_FLAG_BACKUP_SEMANTICS,
-                                NULL);
-
-        if (FileHandle == NULL || FileHandle == INVALID_HANDLE_VALUE) {
+        if (!FlushFileBuffers(Volume->VolumeHandle)) {
             LastError = GetLastError();
             ErrText = YoriLibGetWinErrorText(LastError);
-            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("sync: open of %y failed: %s"), &VolumePath, ErrText);
+            EnterCriticalSection(&SyncContext->Lock);
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("sync: flush of %y failed: %s"), &Volume->VolumePath, ErrText);
+            LeaveCriticalSection(&SyncContext->Lock);
             YoriLibFreeWinErrorText(ErrText);
-            YoriLibFreeStringContents(&VolumePath);
-            return TRUE;
+            return FALSE;
         }
+        return TRUE;
+    }
 
-        if (SyncContext->VolumeDismount) {
-            if (!DeviceIoControl(FileHandle, FSCTL_DISMOUNT_VOLUME, NULL, 0, NULL, 0, &BytesReturned, NULL)) {
-                LastError = GetLastError();
-                ErrText = YoriLibGetWinErrorText(LastError);
-                YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("sync: dismount of %y failed: %s"), &VolumePath, ErrText);
-                YoriLibFreeWinErrorText(ErrText);
-                YoriLibFreeStringContents(&VolumePath);
-                return TRUE;
-            }
+    if (SyncContext->Verbose) {
+        EnterCriticalSection(&SyncContext->Lock);
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("sync: syncing %y\n"), &Entry->FilePath);
+        LeaveCriticalSection(&SyncContext->Lock);
+    }
+
+    FileHandle = CreateFile(Entry->FilePath.StartOfString,
+                            GENERIC_WRITE,
+                            FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                            NULL,
+                            OPEN_ALWAYS,
+                            FILE_ATTRIBUTE_NORMAL | FILE_FLAG_BACKUP_SEMANTICS,
+                            NULL);
+
+    if (FileHandle == NULL || FileHandle == INVALID_HANDLE_VALUE) {
+        LastError = GetLastError();
+        ErrText = YoriLibGetWinErrorText(LastError);
+        EnterCriticalSection(&SyncContext->Lock);
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("sync: open of %y failed: %s"), &Entry->FilePath, ErrText);
+        LeaveCriticalSection(&SyncContext->Lock);
+        YoriLibFreeWinErrorText(ErrText);
+        return FALSE;
+    }
+
+    if (!FlushFileBuffers(FileHandle)) {
+        LastError = GetLastError();
+        ErrText = YoriLibGetWinErrorText(LastError);
+        EnterCriticalSection(&SyncContext->Lock);
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("sync: flush of %y failed: %s"), &Entry->FilePath, ErrText);
+        LeaveCriticalSection(&SyncContext->Lock);
+        YoriLibFreeWinErrorText(ErrText);
+        CloseHandle(FileHandle);
+        return FALSE;
+    }
+
+    CloseHandle(FileHandle);
+    return TRUE;
+}
+
+/**
+ Flush a single object.  This is invoked on multiple threads concurrently.
+ Each object is flushed independently, so threads only need to synchronize
+ to update volume statistics.
+
+ @param Context Pointer to the sync context.
+
+ @param Index The index of the element in WorkItems to flush.
+ */
+VOID
+SyncFlushWorkItem(
+    __in PVOID Context,
+    __in DWORD Index
+    )
+{
+    PSYNC_CONTEXT SyncContext;
+    PSYNC_ENTRY Entry;
+    PSYNC_VOLUME Volume;
+    BOOLEAN Flushed;
+
+    SyncContext = (PSYNC_CONTEXT)Context;
+
+    Entry = &SyncContext->Entries[SyncContext->WorkItems[Index]];
+    Flushed = SyncFlushEntry(SyncContext, Entry);
+
+    if (Entry->VolumeIndex != SYNC_NO_VOLUME) {
+        Volume = &SyncContext->Volumes[Entry->VolumeIndex];
+        EnterCriticalSection(&SyncContext->Lock);
+        if (Flushed) {
+            Volume->ObjectsFlushed++;
         } else {
-            if (!DeviceIoControl(FileHandle, FSCTL_LOCK_VOLUME, NULL, 0, NULL, 0, &BytesReturned, NULL)) {
-                LastError = GetLastError();
-                ErrText = YoriLibGetWinErrorText(LastError);
-                YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("sync: lock of %y failed, volume may be in use: %s"), &VolumePath, ErrText);
-                YoriLibFreeWinErrorText(ErrText);
-                YoriLibFreeStringContents(&VolumePath);
-                return TRUE;
-            }
+            Volume->ObjectsFailed++;
         }
+        Volume->EndTime = YoriLibGetSystemTimeAsInteger();
+        LeaveCriticalSection(&SyncContext->Lock);
+    }
+}
 
-        YoriLibFreeStringContents(&VolumePath);
-        CloseHandle(FileHandle);
+/**
+ Flush all recorded objects.  Objects are ordered so that objects on the
+ same volume are adjacent, and objects on volumes that are flushed in their
+ entirety are skipped.  The objects are then flushed by a pool of threads
+ so that the latency of each flush is overlapped.
+
+ @param SyncContext Pointer to the sync context.
+
+ @return TRUE to indicate success, FALSE on allocation failure.
+ */
+BOOLEAN
+SyncFlushAll(
+    __inout PSYNC_CONTEXT SyncContext
+    )
+{
+    PSYNC_ENTRY Entry;
+    PSYNC_VOLUME Volume;
+    DWORD VolumeIndex;
+    DWORD Index;
+    LONGLONG ElapsedMs;
+
+    if (SyncContext->EntryCount == 0) {
         return TRUE;
+    }
 
-    } else {
+    SyncContext->WorkItems = YoriLibMalloc((YORI_ALLOC_SIZE_T)(SyncContext->EntryCount * sizeof(DWORD)));
+    if (SyncContext->WorkItems == NULL) {
+        return FALSE;
+    }
 
-        if (SyncContext->Verbose) {
-            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("sync: syncing %y\n"), FilePath);
+    SyncContext->WorkItemCount = 0;
+    for (VolumeIndex = 0; VolumeIndex <= SyncContext->VolumeCount; VolumeIndex++) {
+        for (Index = 0; Index < SyncContext->EntryCount; Index++) {
+            Entry = &SyncContext->Entries[Index];
+            if (VolumeIndex == SyncContext->VolumeCount) {
+                if (Entry->VolumeIndex != SYNC_NO_VOLUME) {
+                    continue;
+                }
+            } else {
+                if (Entry->VolumeIndex != VolumeIndex) {
+                    continue;
+                }
+                if (SyncContext->Volumes[VolumeIndex].VolumeHandle != NULL &&
+                    Entry->FilePath.LengthInChars > 0) {
+
+                    continue;
+                }
+            }
+            SyncContext->WorkItems[SyncContext->WorkItemCount] = Index;
+            SyncContext->WorkItemCount++;
         }
+    }
 
-        FileHandle = CreateFile(FilePath->StartOfString,
-                                DesiredAccess,
-                                FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
-                                NULL,
-                                OPEN_ALWAYS,
-                                FILE_ATTRIBUTE_NORMAL | FILE_FLAG_BACKUP_SEMANTICS,
-                                NULL);
+    SyncContext->StartTime = YoriLibGetSystemTimeAsInteger();
+    YoriLibProcessItemsInParallel(SyncContext->WorkItemCount, SYNC_MAX_THREADS, SyncFlushWorkItem, SyncContext);
 
-        if (FileHandle == NULL || FileHandle == INVALID_HANDLE_VALUE) {
-            LastError = GetLastError();
-            ErrText = YoriLibGetWinErrorText(LastError);
-            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("sync: open of %y failed: %s"), FilePath, ErrText);
-            YoriLibFreeWinErrorText(ErrText);
-            return TRUE;
+    if (SyncContext->Verbose) {
+        for (VolumeIndex = 0; VolumeIndex < SyncContext->VolumeCount; VolumeIndex++) {
+            Volume = &SyncContext->Volumes[VolumeIndex];
+            if (Volume->ObjectsFlushed == 0 && Volume->ObjectsFailed == 0) {
+                continue;
+            }
+            ElapsedMs = (Volume->EndTime - SyncContext->StartTime) / 10000;
+            if (Volume->VolumeHandle != NULL) {
+                YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("sync: %y: volume flushed in %lli ms\n"), &Volume->VolumePath, ElapsedMs);
+            } else {
+                YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("sync: %y: %i objects flushed, %i failed, in %lli ms\n"), &Volume->VolumePath, Volume->ObjectsFlushed, Volume->ObjectsFailed, ElapsedMs);
+            }
         }
+    }
 
-        if (!FlushFileBuffers(FileHandle)) {
-            LastError = GetLastError();
-            ErrText = YoriLibGetWinErrorText(LastError);
-            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("sync: flush of %y failed: %s"), FilePath, ErrText);
-            YoriLibFreeWinErrorText(ErrText);
-            return TRUE;
-        }
+    return TRUE;
+}
 
-        CloseHandle(FileHandle);
-        return TRUE;
+/**
+ Free all recorded objects and volumes.
+
+ @param SyncContext Pointer to the sync context.
+ */
+VOID
+SyncCleanupContext(
+    __inout PSYNC_CONTEXT SyncContext
+    )
+{
+    DWORD Index;
+
+    for (Index = 0; Index < SyncContext->EntryCount; Index++) {
+        YoriLibFreeStringContents(&SyncContext->Entries[Index].FilePath);
+    }
+    for (Index = 0; Index < SyncContext->VolumeCount; Index++) {
+        if (SyncContext->Volumes[Index].VolumeHandle != NULL) {
+            CloseHandle(SyncContext->Volumes[Index].VolumeHandle);
+        }
+        YoriLibFreeStringContents(&SyncContext->Volumes[Index].VolumePath);
+    }
+    if (SyncContext->Entries != NULL) {
+        YoriLibFree(SyncContext->Entries);
+    }
+    if (SyncContext->Volumes != NULL) {
+        YoriLibFree(SyncContext->Volumes);
     }
+    if (SyncContext->WorkItems != NULL) {
+        YoriLibFree(SyncContext->WorkItems);
+    }
+    DeleteCriticalSection(&SyncContext->Lock);
 }
 
 #ifdef YORI_BUILTIN
@@ -262,6 +843,7 @@ ENTRYPOINT(
     BOOLEAN BasicEnumeration = FALSE;
     SYNC_CONTEXT SyncContext;
     YORI_STRING Arg;
+    DWORD Result;
 
     ZeroMemory(&SyncContext, sizeof(SyncContext));
 
@@ -276,7 +858,7 @@ ENTRYPOINT(
                 SyncHelp();
                 return EXIT_SUCCESS;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("license")) == 0) {
-                YoriLibDisplayMitLicense(_T("2018"));
+                YoriLibDisplayMitLicense(_T("2018-2026"));
                 return EXIT_SUCCESS;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("b")) == 0) {
                 BasicEnumeration = TRUE;
@@ -323,31 +905,55 @@ ENTRYPOINT(
     if (StartArg == 0 || StartArg == ArgC) {
         YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("sync: missing argument\n"));
         return EXIT_FAILURE;
-    } else {
-        MatchFlags = YORILIB_FILEENUM_RETURN_FILES | YORILIB_FILEENUM_RETURN_DIRECTORIES;
-        if (Recursive) {
-            MatchFlags |= YORILIB_FILEENUM_RECURSE_BEFORE_RETURN | YORILIB_FILEENUM_RECURSE_PRESERVE_WILD;
-        }
-        if (BasicEnumeration) {
-            MatchFlags |= YORILIB_FILEENUM_BASIC_EXPANSION;
+    }
+
+    InitializeCriticalSection(&SyncContext.Lock);
+    Result = EXIT_SUCCESS;
+
+    MatchFlags = YORILIB_FILEENUM_RETURN_FILES | YORILIB_FILEENUM_RETURN_DIRECTORIES;
+    if (Recursive) {
+        MatchFlags |= YORILIB_FILEENUM_RECURSE_BEFORE_RETURN | YORILIB_FILEENUM_RECURSE_PRESERVE_WILD;
+    }
+    if (BasicEnumeration) {
+        MatchFlags |= YORILIB_FILEENUM_BASIC_EXPANSION;
+    }
+
+    for (i = StartArg; i < ArgC; i++) {
+
+        if (!SyncContext.VolumeDismount &&
+            !SyncContext.LockVolume &&
+            SyncTryAddVolumeFlush(&SyncContext, &ArgV[i], Recursive)) {
+
+            continue;
         }
 
-        for (i = StartArg; i < ArgC; i++) {
+        if (SyncContext.OutOfMemory) {
+            break;
+        }
 
-            SyncContext.FilesFoundThisArg = 0;
-            YoriLibForEachStream(&ArgV[i], MatchFlags, 0, SyncFileFoundCallback, NULL, &SyncContext);
-            if (SyncContext.FilesFoundThisArg == 0) {
-                YORI_STRING FullPath;
-                YoriLibInitEmptyString(&FullPath);
-                if (YoriLibUserStringToSingleFilePath(&ArgV[i], TRUE, &FullPath)) {
-                    SyncFileFoundCallback(&FullPath, NULL, 0, &SyncContext);
-                    YoriLibFreeStringContents(&FullPath);
-                }
+        SyncContext.FilesFoundThisArg = 0;
+        YoriLibForEachStream(&ArgV[i], MatchFlags, 0, SyncFileFoundCallback, NULL, &SyncContext);
+        if (SyncContext.FilesFoundThisArg == 0) {
+            YORI_STRING FullPath;
+            YoriLibInitEmptyString(&FullPath);
+            if (YoriLibUserStringToSingleFilePath(&ArgV[i], TRUE, &FullPath)) {
+                SyncFileFoundCallback(&FullPath, NULL, 0, &SyncContext);
+                YoriLibFreeStringContents(&FullPath);
             }
         }
+        if (SyncContext.OutOfMemory) {
+            break;
+        }
+    }
+
+    if (SyncContext.OutOfMemory || !SyncFlushAll(&SyncContext)) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("sync: out of memory\n"));
+        Result = EXIT_FAILURE;
     }
 
-    return EXIT_SUCCESS;
+    SyncCleanupContext(&SyncContext);
+
+    return Result;
 }
 
 // vim:sw=4:ts=4:et:
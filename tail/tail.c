@@ -41,7 +41,9 @@ CHAR strTailHelpText[] =
         "\n"
         "   -b             Use basic search criteria for files only\n"
         "   -c             Specify a line to display context around instead of EOF\n"
-        "   -f             Wait for new output and continue outputting\n"
+        "   -f             Wait for new output and continue outputting.  When multiple\n"
+        "                    files are specified, all are followed, along with any\n"
+        "                    newly created files matching a wildcard\n"
         "   -n             Specify the number of lines to display\n"
         "   -s             Process files from all subdirectories\n";
 
@@ -59,6 +61,59 @@ TailHelp(VOID)
     return TRUE;
 }
 
+/**
+ A file that is being followed for new output after its initial lines have
+ been displayed.
+ */
+typedef struct _TAIL_FOLLOW_FILE {
+
+    /**
+     The entry for this file on the list of files being followed.
+     */
+    YORI_LIST_ENTRY ListEntry;
+
+    /**
+     A handle to the opened file.
+     */
+    HANDLE FileHandle;
+
+    /**
+     The line read context used to read lines from the file.
+     */
+    PVOID LineContext;
+
+    /**
+     The full path to the file.  This is used to prefix output lines and to
+     detect files that are already being followed.
+     */
+    YORI_STRING FilePath;
+
+} TAIL_FOLLOW_FILE, *PTAIL_FOLLOW_FILE;
+
+/**
+ A directory that is being monitored for the creation of new files that
+ match a command line argument.
+ */
+typedef struct _TAIL_FOLLOW_WATCH {
+
+    /**
+     The entry for this directory on the list of directories being watched.
+     */
+    YORI_LIST_ENTRY ListEntry;
+
+    /**
+     A change notification handle for the directory.
+     */
+    HANDLE ChangeNotification;
+
+    /**
+     Pointer to the command line argument to enumerate again when the
+     directory changes.
+     */
+    PYORI_STRING Arg;
+
+} TAIL_FOLLOW_WATCH, *PTAIL_FOLLOW_WATCH;
+
 /**
  Context passed to the callback which is invoked for each file found.
  */
@@ -117,8 +172,309 @@ typedef struct _TAIL_CONTEXT {
      */
     BOOLEAN Recursive;
 
+    /**
+     TRUE if files are being enumerated again to find new files to follow.
+     In this case, files already being followed are skipped, new files are
+     followed from their beginning, and errors are not displayed.
+     */
+    BOOLEAN Rescanning;
+
+    /**
+     The list of files being followed.  Paired with TAIL_FOLLOW_FILE.
+     */
+    YORI_LIST_ENTRY FollowList;
+
+    /**
+     The number of files on FollowList.
+     */
+    DWORD FollowCount;
+
+    /**
+     The list of directories being monitored for new files.  Paired with
+     TAIL_FOLLOW_WATCH.
+     */
+    YORI_LIST_ENTRY WatchList;
+
 } TAIL_CONTEXT, *PTAIL_CONTEXT;
 
+/**
+ The interval in milliseconds to poll followed files if any cannot be
+ monitored with a change notification.
+ */
+#define TAIL_FOLLOW_POLL_INTERVAL (200)
+
+/**
+ The maximum interval in milliseconds to wait for a change notification
+ before checking followed files anyway.
+ */
+#define TAIL_FOLLOW_NOTIFY_INTERVAL (1000)
+
+/**
+ The size of each block read when scanning a file for line breaks.
+ */
+#define TAIL_SCAN_BLOCK_SIZE (64 * 1024)
+
+/**
+ Return a character from a block of data read from a file.
+
+ @param Block Pointer to the block of data.
+
+ @param Index The index of the character to return.
+
+ @param CharSize The size of each character, in bytes.  This is two if the
+        input is UTF16, and one otherwise.
+
+ @return The character.
+ */
+DWORD
+TailGetCharFromBlock(
+    __in PUCHAR Block,
+    __in DWORD Index,
+    __in DWORD CharSize
+    )
+{
+    if (CharSize == sizeof(WCHAR)) {
+        return ((PWCHAR)Block)[Index];
+    }
+    return Block[Index];
+}
+
+/**
+ Position a file at the beginning of the final lines within it.  The file is
+ read backwards from its end in large blocks, counting line breaks, so only
+ the end of the file needs to be read regardless of its size.  A line is
+ terminated by a CR, an LF, or a CR followed by an LF, matching the line
+ read routines.  If the file has fewer lines than requested, it is
+ positioned at its beginning.
+
+ @param hSource The opened source stream, which must support seeking.
+
+ @param LineCount The number of lines to position before the end of the
+        file.
+
+ @return TRUE to indicate the file has been positioned, FALSE if it could not
+         be scanned.
+ */
+__success(return)
+BOOL
+TailSeekToFinalLines(
+    __in HANDLE hSource,
+    __in YORI_ALLOC_SIZE_T LineCount
+    )
+{
+    LARGE_INTEGER FileSize;
+    LARGE_INTEGER BlockStart;
+    LARGE_INTEGER BlockEnd;
+    LARGE_INTEGER LineStart;
+    PUCHAR Block;
+    DWORD CharSize;
+    DWORD BlockLength;
+    DWORD BytesRead;
+    DWORD Index;
+    DWORD Char;
+    DWORD NextChar;
+    YORI_ALLOC_SIZE_T BreaksFound;
+    BOOLEAN Found;
+
+    CharSize = 1;
+    if (YoriLibGetMultibyteInputEncoding() == CP_UTF16) {
+        CharSize = sizeof(WCHAR);
+    }
+
+    FileSize.LowPart = GetFileSize(hSource, (LPDWORD)&FileSize.HighPart);
+    if (FileSize.LowPart == INVALID_FILE_SIZE && GetLastError() != NO_ERROR) {
+        return FALSE;
+    }
+
+    Block = YoriLibMalloc(TAIL_SCAN_BLOCK_SIZE);
+    if (Block == NULL) {
+        return FALSE;
+    }
+
+    //
+    //  Ignore any partial character at the end of the file.
+    //
+
+    FileSize.QuadPart = FileSize.QuadPart - (FileSize.QuadPart % CharSize);
+    BlockEnd.QuadPart = FileSize.QuadPart;
+    LineStart.QuadPart = 0;
+    BreaksFound = 0;
+    NextChar = 0;
+    Found = FALSE;
+
+    while (BlockEnd.QuadPart > 0 && !Found) {
+        BlockLength = TAIL_SCAN_BLOCK_SIZE;
+        if (BlockEnd.QuadPart < BlockLength) {
+            BlockLength = BlockEnd.LowPart;
+        }
+        BlockStart.QuadPart = BlockEnd.QuadPart - BlockLength;
+
+        if (SetFilePointer(hSource, BlockStart.LowPart, &BlockStart.HighPart, FILE_BEGIN) == INVALID_SET_FILE_POINTER &&
+            GetLastError() != NO_ERROR) {
+
+            YoriLibFree(Block);
+            return FALSE;
+        }
+
+        if (!ReadFile(hSource, Block, BlockLength, &BytesRead, NULL) ||
+            BytesRead != BlockLength) {
+
+            YoriLibFree(Block);
+            return FALSE;
+        }
+
+        //
+        //  Each line break is counted at the character before the line it
+        //  terminates.  A CR followed by an LF is counted at the LF.  The
+        //  terminator of the final line in the file is not counted.
+        //
+
+        for (Index = BlockLength / CharSize; Index > 0; Index--) {
+            Char = TailGetCharFromBlock(Block, Index - 1, CharSize);
+            if (Char == '\n' || (Char == '\r' && NextChar != '\n')) {
+                LineStart.QuadPart = BlockStart.QuadPart + Index * CharSize;
+                if (LineStart.QuadPart != FileSize.QuadPart) {
+                    BreaksFound++;
+                    if (BreaksFound == LineCount) {
+                        Found = TRUE;
+                        break;
+                    }
+                }
+            }
+            NextChar = Char;
+        }
+
+        BlockEnd.QuadPart = BlockStart.QuadPart;
+    }
+
+    YoriLibFree(Block);
+
+    if (!Found) {
+        LineStart.QuadPart = 0;
+    }
+
+    if (SetFilePointer(hSource, LineStart.LowPart, &LineStart.HighPart, FILE_BEGIN) == INVALID_SET_FILE_POINTER &&
+        GetLastError() != NO_ERROR) {
+
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ Position a file at the beginning of a specified line.  The file is read in
+ large blocks counting line breaks, which avoids processing each line
+ individually.  A line is terminated by a CR, an LF, or a CR followed by an
+ LF, matching the line read routines.
+
+ @param hSource The opened source stream, which must support seeking.
+
+ @param LinesToSkip The number of lines to skip from the beginning of the
+        file.
+
+ @return TRUE to indicate the file has been positioned at the beginning of
+         the requested line.  FALSE to indicate the file does not contain
+         more than that many lines or could not be scanned, in which case it
+         is positioned at its beginning.
+ */
+__success(return)
+BOOL
+TailSeekToLine(
+    __in HANDLE hSource,
+    __in DWORDLONG LinesToSkip
+    )
+{
+    LARGE_INTEGER FileSize;
+    LARGE_INTEGER BlockStart;
+    LARGE_INTEGER LineStart;
+    PUCHAR Block;
+    DWORD CharSize;
+    DWORD BytesRead;
+    DWORD Index;
+    DWORD Char;
+    DWORD PreviousChar;
+    DWORDLONG BreaksFound;
+    BOOLEAN Found;
+
+    CharSize = 1;
+    if (YoriLibGetMultibyteInputEncoding() == CP_UTF16) {
+        CharSize = sizeof(WCHAR);
+    }
+
+    FileSize.LowPart = GetFileSize(hSource, (LPDWORD)&FileSize.HighPart);
+    if (FileSize.LowPart == INVALID_FILE_SIZE && GetLastError() != NO_ERROR) {
+        SetFilePointer(hSource, 0, NULL, FILE_BEGIN);
+        return FALSE;
+    }
+
+    Block = YoriLibMalloc(TAIL_SCAN_BLOCK_SIZE);
+    if (Block == NULL) {
+        SetFilePointer(hSource, 0, NULL, FILE_BEGIN);
+        return FALSE;
+    }
+
+    SetFilePointer(hSource, 0, NULL, FILE_BEGIN);
+    BlockStart.QuadPart = 0;
+    LineStart.QuadPart = 0;
+    BreaksFound = 0;
+    PreviousChar = 0;
+    Found = FALSE;
+
+    while (!Found) {
+        if (!ReadFile(hSource, Block, TAIL_SCAN_BLOCK_SIZE, &BytesRead, NULL) ||
+            BytesRead == 0) {
+
+            break;
+        }
+
+        //
+        //  Each line break is counted at the character after it, so that a
+        //  CR followed by an LF is only counted once.
+        //
+
+        for (Index = 0; Index < BytesRead / CharSize; Index++) {
+            Char = TailGetCharFromBlock(Block, Index, CharSize);
+            if (Char == '\n') {
+                LineStart.QuadPart = BlockStart.QuadPart + (Index + 1) * CharSize;
+                BreaksFound++;
+            } else if (PreviousChar == '\r') {
+                LineStart.QuadPart = BlockStart.QuadPart + Index * CharSize;
+                BreaksFound++;
+            }
+            PreviousChar = Char;
+
+            if (BreaksFound == LinesToSkip) {
+                Found = TRUE;
+                break;
+            }
+        }
+
+        BlockStart.QuadPart = BlockStart.QuadPart + BytesRead;
+    }
+
+    YoriLibFree(Block);
+
+    //
+    //  If there are no lines after the requested one, the caller wants to
+    //  display the final lines in the file, so read it from the top.
+    //
+
+    if (!Found || LineStart.QuadPart >= FileSize.QuadPart - (FileSize.QuadPart % CharSize)) {
+        SetFilePointer(hSource, 0, NULL, FILE_BEGIN);
+        return FALSE;
+    }
+
+    if (SetFilePointer(hSource, LineStart.LowPart, &LineStart.HighPart, FILE_BEGIN) == INVALID_SET_FILE_POINTER &&
+        GetLastError() != NO_ERROR) {
+
+        SetFilePointer(hSource, 0, NULL, FILE_BEGIN);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
 /**
  Process a single opened stream, enumerating through all lines and displaying
  the set requested by the user.
@@ -127,22 +483,29 @@ typedef struct _TAIL_CONTEXT {
 
  @param TailContext Pointer to context information specifying which lines to
         display.
+
+ @param FollowLineContext Optionally points to a location to receive the
+        line read context for the stream if the caller intends to follow it
+        for more output.  If this is NULL and the user requested waiting
+        for more output, this routine follows the stream until it is
+        cancelled.
  
  @return TRUE to indicate success, FALSE to indicate failure.
  */
 BOOL
 TailProcessStream(
     __in HANDLE hSource,
-    __in PTAIL_CONTEXT TailContext
+    __in PTAIL_CONTEXT TailContext,
+    __out_opt PVOID * FollowLineContext
     )
 {
     PVOID LineContext = NULL;
     DWORDLONG StartLine = 0;
     DWORDLONG CurrentLine;
+    DWORDLONG LinesSkipped = 0;
     PYORI_STRING LineString;
     YORI_LIB_LINE_ENDING LineEnding;
     BOOL TimeoutReached;
-    DWORD SeekToEndOffset = 0;
     DWORD Err;
     DWORD BytesWritten;
 
@@ -150,82 +513,60 @@ TailProcessStream(
     FileType = FileType & ~(FILE_TYPE_REMOTE);
 
     //
-    //  If it's a file and we want the final few lines, start searching
-    //  from the end, assuming an average line size of 256 bytes.
+    //  If it's a file, position it at the first line that could be
+    //  displayed, so that lines before it do not need to be read.  If
+    //  this fails, all lines are read from the current position.
     //
 
-    if (FileType == FILE_TYPE_DISK && TailContext->FinalLine == 0) {
-        SeekToEndOffset = 256 * TailContext->LinesToDisplay;
+    if (FileType == FILE_TYPE_DISK) {
+        if (TailContext->FinalLine == 0) {
+            TailSeekToFinalLines(hSource, TailContext->LinesToDisplay);
+        } else if (TailContext->FinalLine > TailContext->LinesToDisplay) {
+            if (TailSeekToLine(hSource, TailContext->FinalLine - TailContext->LinesToDisplay)) {
+                LinesSkipped = TailContext->FinalLine - TailContext->LinesToDisplay;
+            }
+        }
     }
 
     TailContext->FilesFound++;
     TailContext->FilesFoundThisArg++;
 
+    TailContext->LinesFound = 0;
+
     while (TRUE) {
 
-        if (SeekToEndOffset != 0) {
-            if (!SetFilePointer(hSource, -1 * SeekToEndOffset, NULL, FILE_END)) {
-                SeekToEndOffset = 0;
-                SetFilePointer(hSource, 0, NULL, FILE_BEGIN);
-            }
+        if (!YoriLibReadLineToStringEx(&TailContext->LinesArray[TailContext->LinesFound % TailContext->LinesToDisplay],
+                                       &LineContext,
+                                       !TailContext->WaitForMore,
+                                       INFINITE,
+                                       hSource,
+                                       &LineEnding,
+                                       &TimeoutReached)) {
+            break;
         }
-        TailContext->LinesFound = 0;
-
-        while (TRUE) {
-
-            if (!YoriLibReadLineToStringEx(&TailContext->LinesArray[TailContext->LinesFound % TailContext->LinesToDisplay],
-                                           &LineContext,
-                                           !TailContext->WaitForMore,
-                                           INFINITE,
-                                           hSource,
-                                           &LineEnding,
-                                           &TimeoutReached)) {
-                break;
-            }
-
-            TailContext->LinesFound++;
 
-            if (TailContext->FinalLine != 0 && TailContext->LinesFound >= TailContext->FinalLine) {
-                break;
-            }
-        }
+        TailContext->LinesFound++;
 
-        if (TailContext->LinesFound > TailContext->LinesToDisplay) {
-            StartLine = TailContext->LinesFound - TailContext->LinesToDisplay;
-            break;
-        } else if (SeekToEndOffset != 0) {
-            DWORD DesiredSeek;
-            DesiredSeek = 4096;
-            DesiredSeek = DesiredSeek * TailContext->LinesToDisplay;
-
-            //
-            //  If we didn't get enough lines and we have a file that
-            //  supports arbitrary seeks, try to grab more data.  If
-            //  we've already hit our arbitrary maximum (a 4Kb average
-            //  line size) start scanning from the top.
-            //
-
-            if (SeekToEndOffset < DesiredSeek) {
-                SeekToEndOffset = DesiredSeek;
-            } else {
-                SeekToEndOffset = 0;
-                SetFilePointer(hSource, 0, NULL, FILE_BEGIN);
-            }
-            YoriLibLineReadCloseOrCache(LineContext);
-            LineContext = NULL;
-            continue;
-        } else {
-            StartLine = 0;
+        if (TailContext->FinalLine != 0 && LinesSkipped + TailContext->LinesFound >= TailContext->FinalLine) {
             break;
         }
     }
 
+    if (TailContext->LinesFound > TailContext->LinesToDisplay) {
+        StartLine = TailContext->LinesFound - TailContext->LinesToDisplay;
+    }
+
     for (CurrentLine = StartLine; CurrentLine < TailContext->LinesFound; CurrentLine++) {
         LineString = &TailContext->LinesArray[CurrentLine % TailContext->LinesToDisplay];
         YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y\n"), LineString);
     }
 
     if (TailContext->WaitForMore) {
+        if (FollowLineContext != NULL) {
+            *FollowLineContext = LineContext;
+            return TRUE;
+        }
+
         while (TRUE) {
 
             if (!YoriLibReadLineToStringEx(&TailContext->LinesArray[0], &LineContext, FALSE, INFINITE, hSource, &LineEnding, &TimeoutReached)) {
@@ -246,7 +587,9 @@ TailProcessStream(
                     break;
                 }
 
-                Sleep(200);
+                if (!YoriLibLineReadWaitForMore(LineContext, hSource, NULL)) {
+                    break;
+                }
                 continue;
             }
             YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y\n"), &TailContext->LinesArray[0]);
@@ -257,6 +600,79 @@ TailProcessStream(
     return TRUE;
 }
 
+/**
+ Add an opened file to the list of files being followed.
+
+ @param TailContext Pointer to the tail context.
+
+ @param FileHandle The opened file.  On success, this is owned by the follow
+        list.
+
+ @param LineContext The line read context for the file, which may be NULL if
+        no lines have been read yet.  On success, this is owned by the follow
+        list.
+
+ @param FilePath Pointer to the full path to the file.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+TailAddFollowFile(
+    __in PTAIL_CONTEXT TailContext,
+    __in HANDLE FileHandle,
+    __in_opt PVOID LineContext,
+    __in PYORI_STRING FilePath
+    )
+{
+    PTAIL_FOLLOW_FILE FollowFile;
+
+    FollowFile = YoriLibMalloc(sizeof(TAIL_FOLLOW_FILE));
+    if (FollowFile == NULL) {
+        return FALSE;
+    }
+
+    if (!YoriLibCopyString(&FollowFile->FilePath, FilePath)) {
+        YoriLibFree(FollowFile);
+        return FALSE;
+    }
+
+    FollowFile->FileHandle = FileHandle;
+    FollowFile->LineContext = LineContext;
+    YoriLibAppendList(&TailContext->FollowList, &FollowFile->ListEntry);
+    TailContext->FollowCount++;
+    return TRUE;
+}
+
+/**
+ Check whether a file is already being followed.
+
+ @param TailContext Pointer to the tail context.
+
+ @param FilePath Pointer to the full path to the file.
+
+ @return TRUE if the file is already being followed, FALSE if it is not.
+ */
+BOOL
+TailIsFileFollowed(
+    __in PTAIL_CONTEXT TailContext,
+    __in PYORI_STRING FilePath
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PTAIL_FOLLOW_FILE FollowFile;
+
+    ListEntry = YoriLibGetNextListEntry(&TailContext->FollowList, NULL);
+    while (ListEntry != NULL) {
+        FollowFile = CONTAINING_RECORD(ListEntry, TAIL_FOLLOW_FILE, ListEntry);
+        if (YoriLibCompareStringIns(&FollowFile->FilePath, FilePath) == 0) {
+            return TRUE;
+        }
+        ListEntry = YoriLibGetNextListEntry(&TailContext->FollowList, ListEntry);
+    }
+
+    return FALSE;
+}
+
 /**
  A callback that is invoked when a file is found that matches a search criteria
  specified in the set of strings to enumerate.
@@ -282,6 +698,7 @@ TailFileFoundCallback(
     )
 {
     HANDLE FileHandle;
+    PVOID LineContext;
     PTAIL_CONTEXT TailContext = (PTAIL_CONTEXT)Context;
 
     UNREFERENCED_PARAMETER(Depth);
@@ -291,6 +708,11 @@ TailFileFoundCallback(
     if (FileInfo == NULL ||
         (FileInfo->dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == 0) {
 
+        if (TailContext->WaitForMore && TailIsFileFollowed(TailContext, FilePath)) {
+            TailContext->FilesFoundThisArg++;
+            return TRUE;
+        }
+
         FileHandle = CreateFile(FilePath->StartOfString,
                                 GENERIC_READ,
                                 FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
@@ -300,7 +722,8 @@ TailFileFoundCallback(
                                 NULL);
 
         if (FileHandle == NULL || FileHandle == INVALID_HANDLE_VALUE) {
-            if (TailContext->SavedErrorThisArg == ERROR_SUCCESS) {
+            if (TailContext->SavedErrorThisArg == ERROR_SUCCESS &&
+                !TailContext->Rescanning) {
                 DWORD LastError = GetLastError();
                 LPTSTR ErrText = YoriLibGetWinErrorText(LastError);
                 YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("tail: open of %y failed: %s"), FilePath, ErrText);
@@ -310,7 +733,28 @@ TailFileFoundCallback(
         }
 
         TailContext->SavedErrorThisArg = ERROR_SUCCESS;
-        TailProcessStream(FileHandle, TailContext);
+
+        //
+        //  If following, files found when enumerating initially have their
+        //  final lines displayed.  Files found later are new, so are
+        //  followed from their beginning.
+        //
+
+        if (TailContext->WaitForMore) {
+            LineContext = NULL;
+            if (TailContext->Rescanning) {
+                TailContext->FilesFound++;
+                TailContext->FilesFoundThisArg++;
+            } else {
+                TailProcessStream(FileHandle, TailContext, &LineContext);
+            }
+            if (TailAddFollowFile(TailContext, FileHandle, LineContext, FilePath)) {
+                return TRUE;
+            }
+            YoriLibLineReadCloseOrCache(LineContext);
+        } else {
+            TailProcessStream(FileHandle, TailContext, NULL);
+        }
 
         CloseHandle(FileHandle);
     }
@@ -378,6 +822,354 @@ TailFileEnumerateErrorCallback(
     return Result;
 }
 
+/**
+ Return TRUE if a string contains wildcard characters.
+
+ @param String Pointer to the string to check.
+
+ @param StartOffset The offset within the string to start checking from.
+
+ @param EndOffset The offset within the string to stop checking at.
+
+ @return TRUE if the string contains a wildcard, FALSE if it does not.
+ */
+BOOL
+TailHasWildcard(
+    __in PYORI_STRING String,
+    __in YORI_ALLOC_SIZE_T StartOffset,
+    __in YORI_ALLOC_SIZE_T EndOffset
+    )
+{
+    YORI_ALLOC_SIZE_T Index;
+
+    for (Index = StartOffset; Index < EndOffset; Index++) {
+        if (String->StartOfString[Index] == '*' ||
+            String->StartOfString[Index] == '?') {
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+/**
+ If a command line argument contains a wildcard, monitor the directory that
+ it refers to so that newly created files that match can be followed.  This
+ is only possible if the directory component of the argument does not
+ itself contain a wildcard.
+
+ @param TailContext Pointer to the tail context.
+
+ @param Arg Pointer to the command line argument.
+ */
+VOID
+TailAddFollowWatch(
+    __in PTAIL_CONTEXT TailContext,
+    __in PYORI_STRING Arg
+    )
+{
+    YORI_STRING FullPath;
+    YORI_ALLOC_SIZE_T PrefixLength;
+    LPTSTR FilePart;
+    HANDLE ChangeNotification;
+    PTAIL_FOLLOW_WATCH Watch;
+
+    if (!TailHasWildcard(Arg, 0, Arg->LengthInChars)) {
+        return;
+    }
+
+    YoriLibInitEmptyString(&FullPath);
+    if (!YoriLibUserStringToSingleFilePath(Arg, TRUE, &FullPath)) {
+        return;
+    }
+
+    FilePart = YoriLibFindRightMostCharacter(&FullPath, '\\');
+    if (FilePart == NULL) {
+        YoriLibFreeStringContents(&FullPath);
+        return;
+    }
+
+    //
+    //  Retain the trailing separator so that a root directory refers to
+    //  the directory and not the volume.
+    //
+
+    FullPath.LengthInChars = (YORI_ALLOC_SIZE_T)(FilePart - FullPath.StartOfString + 1);
+
+    //
+    //  Skip any \\?\ prefix, which is not a wildcard.
+    //
+
+    PrefixLength = 0;
+    if (FullPath.LengthInChars >= 4 &&
+        FullPath.StartOfString[0] == '\\' &&
+        FullPath.StartOfString[1] == '\\' &&
+        FullPath.StartOfString[2] == '?' &&
+        FullPath.StartOfString[3] == '\\') {
+
+        PrefixLength = 4;
+    }
+
+    if (TailHasWildcard(&FullPath, PrefixLength, FullPath.LengthInChars)) {
+        YoriLibFreeStringContents(&FullPath);
+        return;
+    }
+
+    FullPath.StartOfString[FullPath.LengthInChars] = '\0';
+
+    ChangeNotification = FindFirstChangeNotification(FullPath.StartOfString,
+                                                     TailContext->Recursive,
+                                                     FILE_NOTIFY_CHANGE_FILE_NAME);
+    YoriLibFreeStringContents(&FullPath);
+
+    if (ChangeNotification == INVALID_HANDLE_VALUE) {
+        return;
+    }
+
+    Watch = YoriLibMalloc(sizeof(TAIL_FOLLOW_WATCH));
+    if (Watch == NULL) {
+        FindCloseChangeNotification(ChangeNotification);
+        return;
+    }
+
+    Watch->ChangeNotification = ChangeNotification;
+    Watch->Arg = Arg;
+    YoriLibAppendList(&TailContext->WatchList, &Watch->ListEntry);
+}
+
+/**
+ Display any new complete lines that are available in a followed file.
+
+ @param TailContext Pointer to the tail context.
+
+ @param FollowFile Pointer to the file to display new lines from.
+
+ @param DisplayPrefix If TRUE, prefix each line with the path of the file.
+ */
+VOID
+TailDisplayNewLines(
+    __in PTAIL_CONTEXT TailContext,
+    __in PTAIL_FOLLOW_FILE FollowFile,
+    __in BOOLEAN DisplayPrefix
+    )
+{
+    YORI_LIB_LINE_ENDING LineEnding;
+    BOOL TimeoutReached;
+
+    while (YoriLibReadLineToStringEx(&TailContext->LinesArray[0], &FollowFile->LineContext, FALSE, INFINITE, FollowFile->FileHandle, &LineEnding, &TimeoutReached)) {
+        if (DisplayPrefix) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y: %y\n"), &FollowFile->FilePath, &TailContext->LinesArray[0]);
+        } else {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y\n"), &TailContext->LinesArray[0]);
+        }
+    }
+}
+
+/**
+ Follow all of the files on the follow list, displaying new lines as they
+ arrive, until the operation is cancelled or the output handle is closed.
+ A single wait is performed across change notifications for all of the
+ files, along with any directories being monitored for new files.  If any
+ file cannot be monitored, or there are too many to wait on at once, the
+ wait is bounded by a polling interval.
+
+ @param TailContext Pointer to the tail context.
+
+ @param MatchFlags Specifies the flags to use when enumerating arguments
+        again to find new files.
+ */
+VOID
+TailFollowFiles(
+    __in PTAIL_CONTEXT TailContext,
+    __in WORD MatchFlags
+    )
+{
+    HANDLE HandleArray[MAXIMUM_WAIT_OBJECTS];
+    DWORD HandleCount;
+    DWORD FirstWatchIndex;
+    DWORD FirstFileIndex;
+    DWORD WaitResult;
+    DWORD Timeout;
+    DWORD Err;
+    DWORD BytesWritten;
+    BOOLEAN Polling;
+    BOOLEAN DisplayPrefix;
+    BOOLEAN RescanRequired;
+    HANDLE ChangeNotification;
+    PYORI_LIST_ENTRY ListEntry;
+    PTAIL_FOLLOW_FILE FollowFile;
+    PTAIL_FOLLOW_WATCH Watch;
+
+    RescanRequired = FALSE;
+
+    while (TRUE) {
+
+        //
+        //  If directories changed, look for new files matching the
+        //  arguments.
+        //
+
+        if (RescanRequired) {
+            TailContext->Rescanning = TRUE;
+            ListEntry = YoriLibGetNextListEntry(&TailContext->WatchList, NULL);
+            while (ListEntry != NULL) {
+                Watch = CONTAINING_RECORD(ListEntry, TAIL_FOLLOW_WATCH, ListEntry);
+                TailContext->FilesFoundThisArg = 0;
+                TailContext->SavedErrorThisArg = ERROR_SUCCESS;
+                YoriLibForEachStream(Watch->Arg,
+                                     MatchFlags,
+                                     0,
+                                     TailFileFoundCallback,
+                                     TailFileEnumerateErrorCallback,
+                                     TailContext);
+                ListEntry = YoriLibGetNextListEntry(&TailContext->WatchList, ListEntry);
+            }
+            TailContext->Rescanning = FALSE;
+            RescanRequired = FALSE;
+        }
+
+        //
+        //  Display any new lines from every file.  If more than one file
+        //  can be displayed, indicate which file each line came from.
+        //
+
+        DisplayPrefix = FALSE;
+        if (TailContext->FollowCount > 1 || !YoriLibIsListEmpty(&TailContext->WatchList)) {
+            DisplayPrefix = TRUE;
+        }
+
+        ListEntry = YoriLibGetNextListEntry(&TailContext->FollowList, NULL);
+        while (ListEntry != NULL) {
+            FollowFile = CONTAINING_RECORD(ListEntry, TAIL_FOLLOW_FILE, ListEntry);
+            TailDisplayNewLines(TailContext, FollowFile, DisplayPrefix);
+            ListEntry = YoriLibGetNextListEntry(&TailContext->FollowList, ListEntry);
+        }
+
+        //
+        //  Check if the target handle is still around
+        //
+
+        if (!WriteFile(GetStdHandle(STD_OUTPUT_HANDLE), NULL, 0, &BytesWritten, NULL)) {
+            Err = GetLastError();
+            if (Err == ERROR_NO_DATA ||
+                Err == ERROR_PIPE_NOT_CONNECTED) {
+                break;
+            }
+        }
+
+        if (YoriLibIsOperationCancelled()) {
+            break;
+        }
+
+        //
+        //  Construct the set of handles to wait on.  The cancel event is
+        //  first, followed by directories being watched for new files,
+        //  followed by the followed files themselves.
+        //
+
+        HandleCount = 0;
+        Polling = FALSE;
+        if (YoriLibCancelGetEvent() != NULL) {
+            HandleArray[HandleCount] = YoriLibCancelGetEvent();
+            HandleCount++;
+        }
+
+        FirstWatchIndex = HandleCount;
+        ListEntry = YoriLibGetNextListEntry(&TailContext->WatchList, NULL);
+        while (ListEntry != NULL) {
+            Watch = CONTAINING_RECORD(ListEntry, TAIL_FOLLOW_WATCH, ListEntry);
+            if (HandleCount == MAXIMUM_WAIT_OBJECTS) {
+                Polling = TRUE;
+                break;
+            }
+            HandleArray[HandleCount] = Watch->ChangeNotification;
+            HandleCount++;
+            ListEntry = YoriLibGetNextListEntry(&TailContext->WatchList, ListEntry);
+        }
+
+        FirstFileIndex = HandleCount;
+        ListEntry = YoriLibGetNextListEntry(&TailContext->FollowList, NULL);
+        while (ListEntry != NULL) {
+            FollowFile = CONTAINING_RECORD(ListEntry, TAIL_FOLLOW_FILE, ListEntry);
+            ChangeNotification = YoriLibLineReadGetChangeNotification(FollowFile->LineContext, FollowFile->FileHandle);
+            if (ChangeNotification == NULL || HandleCount == MAXIMUM_WAIT_OBJECTS) {
+                Polling = TRUE;
+            } else {
+                HandleArray[HandleCount] = ChangeNotification;
+                HandleCount++;
+            }
+            ListEntry = YoriLibGetNextListEntry(&TailContext->FollowList, ListEntry);
+        }
+
+        Timeout = TAIL_FOLLOW_NOTIFY_INTERVAL;
+        if (Polling) {
+            Timeout = TAIL_FOLLOW_POLL_INTERVAL;
+        }
+
+        if (HandleCount == 0) {
+            Sleep(Timeout);
+            continue;
+        }
+
+        WaitResult = WaitForMultipleObjectsEx(HandleCount, HandleArray, FALSE, Timeout, FALSE);
+        if (WaitResult == WAIT_TIMEOUT) {
+            continue;
+        }
+
+        if (WaitResult < WAIT_OBJECT_0 || WaitResult >= WAIT_OBJECT_0 + HandleCount) {
+            Sleep(TAIL_FOLLOW_POLL_INTERVAL);
+            continue;
+        }
+
+        WaitResult = WaitResult - WAIT_OBJECT_0;
+        if (WaitResult < FirstWatchIndex) {
+            break;
+        }
+
+        FindNextChangeNotification(HandleArray[WaitResult]);
+        if (WaitResult < FirstFileIndex) {
+            RescanRequired = TRUE;
+        }
+    }
+}
+
+/**
+ Stop following all files and directories, and free the lists used to track
+ them.
+
+ @param TailContext Pointer to the tail context.
+ */
+VOID
+TailCleanupFollow(
+    __in PTAIL_CONTEXT TailContext
+    )
+{
+    PYORI_LIST_ENTRY ListEntry;
+    PTAIL_FOLLOW_FILE FollowFile;
+    PTAIL_FOLLOW_WATCH Watch;
+
+    ListEntry = YoriLibGetNextListEntry(&TailContext->FollowList, NULL);
+    while (ListEntry != NULL) {
+        FollowFile = CONTAINING_RECORD(ListEntry, TAIL_FOLLOW_FILE, ListEntry);
+        YoriLibRemoveListItem(ListEntry);
+        YoriLibLineReadCloseOrCache(FollowFile->LineContext);
+        CloseHandle(FollowFile->FileHandle);
+        YoriLibFreeStringContents(&FollowFile->FilePath);
+        YoriLibFree(FollowFile);
+        ListEntry = YoriLibGetNextListEntry(&TailContext->FollowList, NULL);
+    }
+    TailContext->FollowCount = 0;
+
+    ListEntry = YoriLibGetNextListEntry(&TailContext->WatchList, NULL);
+    while (ListEntry != NULL) {
+        Watch = CONTAINING_RECORD(ListEntry, TAIL_FOLLOW_WATCH, ListEntry);
+        YoriLibRemoveListItem(ListEntry);
+        FindCloseChangeNotification(Watch->ChangeNotification);
+        YoriLibFree(Watch);
+        ListEntry = YoriLibGetNextListEntry(&TailContext->WatchList, NULL);
+    }
+}
+
 
 #ifdef YORI_BUILTIN
 /**
@@ -419,6 +1211,8 @@ ENTRYPOINT(
 
     ZeroMemory(&TailContext, sizeof(TailContext));
     TailContext.LinesToDisplay = 10;
+    YoriLibInitializeListHead(&TailContext.FollowList);
+    YoriLibInitializeListHead(&TailContext.WatchList);
     ContextLine = -1;
 
     for (i = 1; i < ArgC; i++) {
@@ -519,7 +1313,7 @@ ENTRYPOINT(
             return EXIT_FAILURE;
         }
 
-        TailProcessStream(GetStdHandle(STD_INPUT_HANDLE), &TailContext);
+        TailProcessStream(GetStdHandle(STD_INPUT_HANDLE), &TailContext, NULL);
     } else {
         MatchFlags = YORILIB_FILEENUM_RETURN_FILES | YORILIB_FILEENUM_DIRECTORY_CONTENTS;
         if (TailContext.Recursive) {
@@ -553,6 +1347,17 @@ ENTRYPOINT(
                     YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("File or directory not found: %y\n"), &ArgV[i]);
                 }
             }
+
+            if (TailContext.WaitForMore) {
+                TailAddFollowWatch(&TailContext, &ArgV[i]);
+            }
+        }
+
+        if (TailContext.WaitForMore) {
+            if (TailContext.FollowCount > 0 || !YoriLibIsListEmpty(&TailContext.WatchList)) {
+                TailFollowFiles(&TailContext, MatchFlags);
+            }
+            TailCleanupFollow(&TailContext);
         }
     }
 
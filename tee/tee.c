@@ -1,7 +1,7 @@
 /**
  * @file tee/tee.c
  *
- * Yori shell output to a file and stdout
+ * Yori shell output to files and stdout
  *
  * Copyright (c) 2017-2023 Malcolm J. Smith
  *
@@ -33,13 +33,16 @@
 const
 CHAR strTeeHelpText[] =
         "\n"
-        "Output the contents of standard input to standard output and a file.\n"
+        "Output the contents of standard input to standard output and files.\n"
         "\n"
-        "TEE [-license] -c\n"
-        "TEE [-license] [-a] <file>]\n"
+        "TEE [-license] [-a] [-b] [-c] [-p <cmd>]... [<file>...]\n"
         "\n"
-        "   -a             Append to the file\n"
-        "   -c             Write to the console and standard output\n";
+        "   -a             Append to the files\n"
+        "   -b             Buffer output to each destination and write it on a\n"
+        "                    separate thread, so a slow destination does not\n"
+        "                    delay the others\n"
+        "   -c             Write to the console and standard output\n"
+        "   -p             Write to the input of a child process executing <cmd>\n";
 
 /**
  Display usage text to the user.
@@ -55,6 +58,101 @@ TeeHelp(VOID)
     return TRUE;
 }
 
+/**
+ The size of the buffer allocated for each destination when output is
+ written on separate threads.  When a buffer is full, reading input waits
+ for the destination to write some of its data.
+ */
+#define TEE_BUFFER_SIZE (1024 * 1024)
+
+/**
+ A single destination which receives a copy of all input.
+ */
+typedef struct _TEE_OUTPUT {
+
+    /**
+     A name describing the destination, used when reporting errors.
+     */
+    YORI_STRING Name;
+
+    /**
+     Handle to the destination device.
+     */
+    HANDLE hDevice;
+
+    /**
+     If the destination is the input to a child process, a handle to the
+     process, so this program can wait for it to complete.  NULL if the
+     destination is not a child process.
+     */
+    HANDLE hProcess;
+
+    /**
+     Handle to a thread which writes buffered data to this destination.
+     NULL if data is written to this destination synchronously.
+     */
+    HANDLE hWriterThread;
+
+    /**
+     A mutex synchronizing access to the buffer.
+     */
+    HANDLE Mutex;
+
+    /**
+     An event signalled when data has been added to the buffer, or when the
+     writer thread should terminate.
+     */
+    HANDLE DataAvailable;
+
+    /**
+     An event signalled when the writer thread has removed data from the
+     buffer.
+     */
+    HANDLE SpaceAvailable;
+
+    /**
+     A circular buffer of data waiting to be written to this destination.
+     */
+    PUCHAR Buffer;
+
+    /**
+     The offset within the buffer of the next byte to write to the
+     destination.
+     */
+    DWORD ReadOffset;
+
+    /**
+     The number of bytes in the buffer which have not yet been written to
+     the destination.
+     */
+    DWORD BytesQueued;
+
+    /**
+     TRUE if the destination is a console; FALSE if it is a different type
+     of device.
+     */
+    BOOLEAN IsConsole;
+
+    /**
+     TRUE if hDevice was opened by this program and should be closed when
+     output is complete.
+     */
+    BOOLEAN CloseDevice;
+
+    /**
+     Set to TRUE if a write to this destination has failed.  No further
+     data is written to it.
+     */
+    BOOLEAN WriteFailed;
+
+    /**
+     Set to TRUE to indicate the writer thread should terminate once the
+     buffer is empty.
+     */
+    BOOLEAN Terminate;
+
+} TEE_OUTPUT, *PTEE_OUTPUT;
+
 /**
  Context passed to the callback which is invoked for each source stream
  processed.
@@ -62,16 +160,20 @@ TeeHelp(VOID)
 typedef struct _TEE_CONTEXT {
 
     /**
-     Handle to a file which will receive all output in addition to standard
-     output.
+     An array of destinations which receive all output.
+     */
+    PTEE_OUTPUT Outputs;
+
+    /**
+     The number of elements in the Outputs array which are in use.
      */
-    HANDLE hFile;
+    YORI_ALLOC_SIZE_T OutputCount;
 
     /**
-     TRUE if hFile is a handle to a console; FALSE if it is a handle to a
-     different type of device.
+     If TRUE, each destination other than a console has its own buffer and
+     writer thread.
      */
-    BOOLEAN FileIsConsole;
+    BOOLEAN Background;
 
 } TEE_CONTEXT, *PTEE_CONTEXT;
 
@@ -114,13 +216,419 @@ TeeWriteLine(
     }
 }
 
+/**
+ A background thread which writes data from the buffer of a destination to
+ the destination.
+
+ @param Context Pointer to the destination.
+
+ @return Zero.
+ */
+DWORD WINAPI
+TeeWriterThread(
+    __in LPVOID Context
+    )
+{
+    PTEE_OUTPUT Output = (PTEE_OUTPUT)Context;
+    PUCHAR Data;
+    DWORD Length;
+    DWORD BytesWritten;
+
+    while (TRUE) {
+        WaitForSingleObject(Output->Mutex, INFINITE);
+        if (Output->BytesQueued == 0) {
+            if (Output->Terminate) {
+                ReleaseMutex(Output->Mutex);
+                break;
+            }
+            ReleaseMutex(Output->Mutex);
+            WaitForSingleObject(Output->DataAvailable, INFINITE);
+            continue;
+        }
+
+        //
+        //  Write as much as is contiguous in the buffer.  The reader does
+        //  not overwrite this region until BytesQueued is reduced below.
+        //
+
+        Data = Output->Buffer + Output->ReadOffset;
+        Length = Output->BytesQueued;
+        if (Length > TEE_BUFFER_SIZE - Output->ReadOffset) {
+            Length = TEE_BUFFER_SIZE - Output->ReadOffset;
+        }
+        ReleaseMutex(Output->Mutex);
+
+        if (!Output->WriteFailed) {
+            if (!WriteFile(Output->hDevice, Data, Length, &BytesWritten, NULL)) {
+                Output->WriteFailed = TRUE;
+            }
+        }
+
+        WaitForSingleObject(Output->Mutex, INFINITE);
+        Output->ReadOffset = (Output->ReadOffset + Length) % TEE_BUFFER_SIZE;
+        Output->BytesQueued = Output->BytesQueued - Length;
+        ReleaseMutex(Output->Mutex);
+        SetEvent(Output->SpaceAvailable);
+    }
+
+    return 0;
+}
+
+/**
+ Allocate a buffer for a destination and start a thread to write its
+ contents.
+
+ @param Output Pointer to the destination.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+TeeStartWriter(
+    __inout PTEE_OUTPUT Output
+    )
+{
+    DWORD ThreadId;
+
+    Output->Buffer = YoriLibMalloc(TEE_BUFFER_SIZE);
+    if (Output->Buffer == NULL) {
+        return FALSE;
+    }
+
+    Output->Mutex = CreateMutex(NULL, FALSE, NULL);
+    if (Output->Mutex == NULL) {
+        return FALSE;
+    }
+
+    Output->DataAvailable = CreateEvent(NULL, FALSE, FALSE, NULL);
+    if (Output->DataAvailable == NULL) {
+        return FALSE;
+    }
+
+    Output->SpaceAvailable = CreateEvent(NULL, FALSE, FALSE, NULL);
+    if (Output->SpaceAvailable == NULL) {
+        return FALSE;
+    }
+
+    Output->hWriterThread = CreateThread(NULL, 0, TeeWriterThread, Output, 0, &ThreadId);
+    if (Output->hWriterThread == NULL) {
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ Write data to a destination.  If the destination has a writer thread, the
+ data is copied into its buffer, waiting for space if the buffer is full.
+ Otherwise the data is written immediately.
+
+ @param Output Pointer to the destination.
+
+ @param Data Pointer to the data to write.
+
+ @param Length The number of bytes to write.
+ */
+VOID
+TeeWriteData(
+    __in PTEE_OUTPUT Output,
+    __in PUCHAR Data,
+    __in DWORD Length
+    )
+{
+    DWORD WriteOffset;
+    DWORD Chunk;
+    DWORD BytesWritten;
+
+    if (Output->hWriterThread == NULL) {
+        if (!Output->WriteFailed) {
+            if (!WriteFile(Output->hDevice, Data, Length, &BytesWritten, NULL)) {
+                Output->WriteFailed = TRUE;
+            }
+        }
+        return;
+    }
+
+    while (Length > 0) {
+        WaitForSingleObject(Output->Mutex, INFINITE);
+        if (Output->BytesQueued == TEE_BUFFER_SIZE) {
+            ReleaseMutex(Output->Mutex);
+            WaitForSingleObject(Output->SpaceAvailable, INFINITE);
+            continue;
+        }
+
+        WriteOffset = (Output->ReadOffset + Output->BytesQueued) % TEE_BUFFER_SIZE;
+        Chunk = TEE_BUFFER_SIZE - Output->BytesQueued;
+        if (Chunk > TEE_BUFFER_SIZE - WriteOffset) {
+            Chunk = TEE_BUFFER_SIZE - WriteOffset;
+        }
+        if (Chunk > Length) {
+            Chunk = Length;
+        }
+
+        memcpy(Output->Buffer + WriteOffset, Data, Chunk);
+        Output->BytesQueued = Output->BytesQueued + Chunk;
+        ReleaseMutex(Output->Mutex);
+        SetEvent(Output->DataAvailable);
+
+        Data = Data + Chunk;
+        Length = Length - Chunk;
+    }
+}
+
+/**
+ Wait for all data to be written to a destination, then close it and free
+ its resources.  If the destination is a child process, wait for the child
+ process to complete.
+
+ @param Output Pointer to the destination.
+
+ @return TRUE if all data was written to the destination, FALSE if a write
+         failed.  Failures writing to standard output are not reported,
+         since it is common for a downstream process to stop reading early.
+ */
+BOOL
+TeeCloseOutput(
+    __in PTEE_OUTPUT Output
+    )
+{
+    BOOL Result = TRUE;
+
+    if (Output->hWriterThread != NULL) {
+        WaitForSingleObject(Output->Mutex, INFINITE);
+        Output->Terminate = TRUE;
+        ReleaseMutex(Output->Mutex);
+        SetEvent(Output->DataAvailable);
+        WaitForSingleObject(Output->hWriterThread, INFINITE);
+        CloseHandle(Output->hWriterThread);
+        Output->hWriterThread = NULL;
+    }
+
+    if (Output->Mutex != NULL) {
+        CloseHandle(Output->Mutex);
+        Output->Mutex = NULL;
+    }
+
+    if (Output->DataAvailable != NULL) {
+        CloseHandle(Output->DataAvailable);
+        Output->DataAvailable = NULL;
+    }
+
+    if (Output->SpaceAvailable != NULL) {
+        CloseHandle(Output->SpaceAvailable);
+        Output->SpaceAvailable = NULL;
+    }
+
+    if (Output->Buffer != NULL) {
+        YoriLibFree(Output->Buffer);
+        Output->Buffer = NULL;
+    }
+
+    if (Output->CloseDevice && Output->hDevice != NULL) {
+        CloseHandle(Output->hDevice);
+        Output->hDevice = NULL;
+    }
+
+    //
+    //  Closing the pipe above indicates end of input to the child process.
+    //
+
+    if (Output->hProcess != NULL) {
+        WaitForSingleObject(Output->hProcess, INFINITE);
+        CloseHandle(Output->hProcess);
+        Output->hProcess = NULL;
+    }
+
+    if (Output->WriteFailed && Output->CloseDevice) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("tee: write to %y failed\n"), &Output->Name);
+        Result = FALSE;
+    }
+
+    YoriLibFreeStringContents(&Output->Name);
+    return Result;
+}
+
+/**
+ Open a file as a destination.
+
+ @param Output Pointer to the destination to initialize.
+
+ @param FileName Pointer to the file name, as specified by the user.
+
+ @param Append TRUE if data should be appended to the file, FALSE if it
+        should be written from the beginning of the file.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+TeeOpenFile(
+    __inout PTEE_OUTPUT Output,
+    __in PYORI_STRING FileName,
+    __in BOOLEAN Append
+    )
+{
+    DWORD DesiredAccess;
+
+    if (!YoriLibUserStringToSingleFilePath(FileName, TRUE, &Output->Name)) {
+        DWORD LastError = GetLastError();
+        LPTSTR ErrText = YoriLibGetWinErrorText(LastError);
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("tee: getfullpathname of %y failed: %s"), FileName, ErrText);
+        YoriLibFreeWinErrorText(ErrText);
+        return FALSE;
+    }
+    DesiredAccess = (Append?FILE_APPEND_DATA:FILE_WRITE_DATA) | SYNCHRONIZE;
+
+    Output->hDevice = CreateFile(Output->Name.StartOfString,
+                                 DesiredAccess,
+                                 FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                                 NULL,
+                                 OPEN_ALWAYS,
+                                 FILE_ATTRIBUTE_NORMAL,
+                                 NULL);
+
+    if (Output->hDevice == INVALID_HANDLE_VALUE || Output->hDevice == NULL) {
+        DWORD LastError = GetLastError();
+        LPTSTR ErrText = YoriLibGetWinErrorText(LastError);
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("tee: open of %y failed: %s"), &Output->Name, ErrText);
+        YoriLibFreeWinErrorText(ErrText);
+        Output->hDevice = NULL;
+        return FALSE;
+    }
+
+    Output->CloseDevice = TRUE;
+    return TRUE;
+}
+
+/**
+ Open the console as a destination.
+
+ @param Output Pointer to the destination to initialize.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+TeeOpenConsole(
+    __inout PTEE_OUTPUT Output
+    )
+{
+    YoriLibConstantString(&Output->Name, _T("CONOUT$"));
+
+    //
+    //  Open for read and write so we can query the cursor location.
+    //
+
+    Output->hDevice = CreateFile(Output->Name.StartOfString,
+                                 GENERIC_READ | GENERIC_WRITE,
+                                 FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                                 NULL,
+                                 OPEN_ALWAYS,
+                                 FILE_ATTRIBUTE_NORMAL,
+                                 NULL);
+
+    if (Output->hDevice == INVALID_HANDLE_VALUE || Output->hDevice == NULL) {
+        DWORD LastError = GetLastError();
+        LPTSTR ErrText = YoriLibGetWinErrorText(LastError);
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("tee: open of %y failed: %s"), &Output->Name, ErrText);
+        YoriLibFreeWinErrorText(ErrText);
+        Output->hDevice = NULL;
+        return FALSE;
+    }
+
+    Output->CloseDevice = TRUE;
+    Output->IsConsole = TRUE;
+    return TRUE;
+}
+
+/**
+ Launch a child process whose input is a destination.  The command is
+ executed by the shell, so it can contain anything that could be entered
+ at a prompt.  The child process shares the standard output and standard
+ error of this program.
+
+ @param Output Pointer to the destination to initialize.
+
+ @param Command Pointer to the command to execute.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+TeeOpenProcess(
+    __inout PTEE_OUTPUT Output,
+    __in PYORI_STRING Command
+    )
+{
+    YORI_STRING ShellPath;
+    HANDLE ReadPipe;
+    HANDLE InheritableReadPipe;
+    STARTUPINFO StartupInfo;
+    PROCESS_INFORMATION ProcessInfo;
+    BOOL Result;
+
+    YoriLibInitEmptyString(&ShellPath);
+    if (!YoriLibAllocateAndGetEnvVar(_T("YORISPEC"), &ShellPath) ||
+        ShellPath.LengthInChars == 0) {
+
+        YoriLibFreeStringContents(&ShellPath);
+        YoriLibConstantString(&ShellPath, _T("yori.exe"));
+    }
+
+    YoriLibYPrintf(&Output->Name, _T("\"%y\" /c %y"), &ShellPath, Command);
+    YoriLibFreeStringContents(&ShellPath);
+    if (Output->Name.StartOfString == NULL) {
+        return FALSE;
+    }
+
+    //
+    //  Create the pipe without inheritance, then duplicate only the read
+    //  end as inheritable.  If the write end were inherited, the child
+    //  would never see the end of its input.
+    //
+
+    if (!CreatePipe(&ReadPipe, &Output->hDevice, NULL, 0)) {
+        Output->hDevice = NULL;
+        return FALSE;
+    }
+    Output->CloseDevice = TRUE;
+
+    if (!DuplicateHandle(GetCurrentProcess(), ReadPipe, GetCurrentProcess(), &InheritableReadPipe, 0, TRUE, DUPLICATE_SAME_ACCESS)) {
+        CloseHandle(ReadPipe);
+        return FALSE;
+    }
+    CloseHandle(ReadPipe);
+
+    ZeroMemory(&StartupInfo, sizeof(StartupInfo));
+    StartupInfo.cb = sizeof(StartupInfo);
+    StartupInfo.dwFlags = STARTF_USESTDHANDLES;
+    StartupInfo.hStdInput = InheritableReadPipe;
+    StartupInfo.hStdOutput = GetStdHandle(STD_OUTPUT_HANDLE);
+    StartupInfo.hStdError = GetStdHandle(STD_ERROR_HANDLE);
+
+    Result = CreateProcess(NULL, Output->Name.StartOfString, NULL, NULL, TRUE, CREATE_DEFAULT_ERROR_MODE, NULL, NULL, &StartupInfo, &ProcessInfo);
+    CloseHandle(InheritableReadPipe);
+
+    if (!Result) {
+        DWORD LastError = GetLastError();
+        LPTSTR ErrText = YoriLibGetWinErrorText(LastError);
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("tee: execution of %y failed: %s"), Command, ErrText);
+        YoriLibFreeWinErrorText(ErrText);
+        return FALSE;
+    }
+
+    CloseHandle(ProcessInfo.hThread);
+    Output->hProcess = ProcessInfo.hProcess;
+    return TRUE;
+}
+
 /**
  Process a single stream.
 
  @param hSource Handle to the source.
 
- @param TeeContext Pointer to the context for the operation, including a
-        handle to the output stream to write data to.
+ @param TeeContext Pointer to the context for the operation, including the
+        destinations to write data to.
 
  @return TRUE to indicate success or FALSE to indicate failure.
  */
@@ -131,19 +639,33 @@ TeeProcessStream(
     )
 {
     PVOID LineContext = NULL;
-    DWORD Junk;
     YORI_STRING LineString;
-    HANDLE StdOutHandle;
-    BOOLEAN StdOutIsConsole;
+    YORI_STRING Newline;
+    PTEE_OUTPUT Output;
+    PUCHAR Encoded;
+    YORI_ALLOC_SIZE_T EncodedAllocated;
+    YORI_ALLOC_SIZE_T LineBytes;
+    YORI_ALLOC_SIZE_T NewlineBytes;
+    YORI_ALLOC_SIZE_T Index;
+    BOOLEAN NeedEncoded;
 
-    StdOutIsConsole = FALSE;
+    //
+    //  Destinations other than consoles receive the same bytes, so encode
+    //  each line once and write the result to each of them.
+    //
 
-    StdOutHandle = GetStdHandle(STD_OUTPUT_HANDLE);
-    if (GetConsoleMode(StdOutHandle, &Junk)) {
-        StdOutIsConsole = TRUE;
+    NeedEncoded = FALSE;
+    for (Index = 0; Index < TeeContext->OutputCount; Index++) {
+        if (!TeeContext->Outputs[Index].IsConsole) {
+            NeedEncoded = TRUE;
+        }
     }
 
     YoriLibInitEmptyString(&LineString);
+    YoriLibConstantString(&Newline, _T("\n"));
+    NewlineBytes = YoriLibGetMbyteOutputSizeNeeded(Newline.StartOfString, Newline.LengthInChars);
+    Encoded = NULL;
+    EncodedAllocated = 0;
 
     while (TRUE) {
 
@@ -151,8 +673,40 @@ TeeProcessStream(
             break;
         }
 
-        TeeWriteLine(StdOutHandle, StdOutIsConsole, &LineString);
-        TeeWriteLine(TeeContext->hFile, TeeContext->FileIsConsole, &LineString);
+        if (NeedEncoded) {
+            LineBytes = YoriLibGetMbyteOutputSizeNeeded(LineString.StartOfString, LineString.LengthInChars);
+            if (LineBytes + NewlineBytes > EncodedAllocated) {
+                if (Encoded != NULL) {
+                    YoriLibFree(Encoded);
+                }
+                EncodedAllocated = (LineBytes + NewlineBytes) * 2;
+                if (EncodedAllocated < 4096) {
+                    EncodedAllocated = 4096;
+                }
+                Encoded = YoriLibMalloc(EncodedAllocated);
+                if (Encoded == NULL) {
+                    break;
+                }
+            }
+
+            YoriLibMultibyteOutput(LineString.StartOfString, LineString.LengthInChars, (LPSTR)Encoded, LineBytes);
+            YoriLibMultibyteOutput(Newline.StartOfString, Newline.LengthInChars, (LPSTR)Encoded + LineBytes, NewlineBytes);
+        } else {
+            LineBytes = 0;
+        }
+
+        for (Index = 0; Index < TeeContext->OutputCount; Index++) {
+            Output = &TeeContext->Outputs[Index];
+            if (Output->IsConsole) {
+                TeeWriteLine(Output->hDevice, TRUE, &LineString);
+            } else {
+                TeeWriteData(Output, Encoded, LineBytes + NewlineBytes);
+            }
+        }
+    }
+
+    if (Encoded != NULL) {
+        YoriLibFree(Encoded);
     }
 
     YoriLibLineReadCloseOrCache(LineContext);
@@ -192,15 +746,38 @@ ENTRYPOINT(
     BOOLEAN ArgumentUnderstood;
     YORI_ALLOC_SIZE_T i;
     YORI_ALLOC_SIZE_T StartArg = 0;
-    DWORD DesiredAccess;
+    YORI_ALLOC_SIZE_T Index;
+    YORI_ALLOC_SIZE_T CommandCount;
+    PYORI_ALLOC_SIZE_T CommandArgs;
+    PTEE_OUTPUT Output;
+    DWORD Junk;
+    DWORD Result;
     BOOLEAN Append = FALSE;
     BOOLEAN Console = FALSE;
     TEE_CONTEXT TeeContext;
-    YORI_STRING FileName;
     YORI_STRING Arg;
 
     ZeroMemory(&TeeContext, sizeof(TeeContext));
 
+    //
+    //  Each argument can specify at most one destination, in addition to
+    //  standard output.
+    //
+
+    CommandArgs = YoriLibMalloc((YORI_ALLOC_SIZE_T)(ArgC * sizeof(YORI_ALLOC_SIZE_T)));
+    TeeContext.Outputs = YoriLibMalloc((YORI_ALLOC_SIZE_T)((ArgC + 1) * sizeof(TEE_OUTPUT)));
+    if (CommandArgs == NULL || TeeContext.Outputs == NULL) {
+        if (CommandArgs != NULL) {
+            YoriLibFree(CommandArgs);
+        }
+        if (TeeContext.Outputs != NULL) {
+            YoriLibFree(TeeContext.Outputs);
+        }
+        return EXIT_FAILURE;
+    }
+    ZeroMemory(TeeContext.Outputs, (ArgC + 1) * sizeof(TEE_OUTPUT));
+    CommandCount = 0;
+
     for (i = 1; i < ArgC; i++) {
 
         ArgumentUnderstood = FALSE;
@@ -210,16 +787,30 @@ ENTRYPOINT(
 
             if (YoriLibCompareStringLitIns(&Arg, _T("?")) == 0) {
                 TeeHelp();
+                YoriLibFree(CommandArgs);
+                YoriLibFree(TeeContext.Outputs);
                 return EXIT_SUCCESS;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("license")) == 0) {
                 YoriLibDisplayMitLicense(_T("2017-2023"));
+                YoriLibFree(CommandArgs);
+                YoriLibFree(TeeContext.Outputs);
                 return EXIT_SUCCESS;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("a")) == 0) {
                 Append = TRUE;
                 ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("b")) == 0) {
+                TeeContext.Background = TRUE;
+                ArgumentUnderstood = TRUE;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("c")) == 0) {
                 Console = TRUE;
                 ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("p")) == 0) {
+                if (i + 1 < ArgC) {
+                    CommandArgs[CommandCount] = i + 1;
+                    CommandCount++;
+                    ArgumentUnderstood = TRUE;
+                    i++;
+                }
             } else if (YoriLibCompareStringLitIns(&Arg, _T("-")) == 0) {
                 StartArg = i + 1;
                 ArgumentUnderstood = TRUE;
@@ -236,69 +827,99 @@ ENTRYPOINT(
         }
     }
 
-    //
-    //  If no file name is specified, use stdin; otherwise open
-    //  the file and use that
-    //
+    if (StartArg == ArgC) {
+        StartArg = 0;
+    }
 
-    if (!Console && (StartArg == 0 || StartArg == ArgC)) {
+    if (!Console && CommandCount == 0 && StartArg == 0) {
         YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("tee: argument missing\n"));
+        YoriLibFree(CommandArgs);
+        YoriLibFree(TeeContext.Outputs);
         return EXIT_FAILURE;
     }
 
     if (YoriLibIsStdInConsole()) {
         YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("tee: No file or pipe for input\n"));
+        YoriLibFree(CommandArgs);
+        YoriLibFree(TeeContext.Outputs);
         return EXIT_FAILURE;
     }
 
-    if (Console) {
-        YoriLibConstantString(&FileName, _T("CONOUT$"));
-        TeeContext.FileIsConsole = TRUE;
+    //
+    //  Standard output is always the first destination.
+    //
 
-        //
-        //  Open for read and write so we can query the cursor location.
-        //
+    Result = EXIT_SUCCESS;
+    Output = &TeeContext.Outputs[0];
+    YoriLibConstantString(&Output->Name, _T("standard output"));
+    Output->hDevice = GetStdHandle(STD_OUTPUT_HANDLE);
+    if (GetConsoleMode(Output->hDevice, &Junk)) {
+        Output->IsConsole = TRUE;
+    }
+    TeeContext.OutputCount = 1;
 
-        DesiredAccess = GENERIC_READ | GENERIC_WRITE;
-    } else {
+    if (Console) {
+        if (!TeeOpenConsole(&TeeContext.Outputs[TeeContext.OutputCount])) {
+            Result = EXIT_FAILURE;
+        } else {
+            TeeContext.OutputCount++;
+        }
+    }
 
-        if (!YoriLibUserStringToSingleFilePath(&ArgV[StartArg], TRUE, &FileName)) {
-            DWORD LastError = GetLastError();
-            LPTSTR ErrText = YoriLibGetWinErrorText(LastError);
-            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("tee: getfullpathname of %y failed: %s"), &ArgV[StartArg], ErrText);
-            YoriLibFreeWinErrorText(ErrText);
-            return EXIT_FAILURE;
+    for (Index = 0; Result == EXIT_SUCCESS && Index < CommandCount; Index++) {
+        if (!TeeOpenProcess(&TeeContext.Outputs[TeeContext.OutputCount], &ArgV[CommandArgs[Index]])) {
+            TeeCloseOutput(&TeeContext.Outputs[TeeContext.OutputCount]);
+            Result = EXIT_FAILURE;
+        } else {
+            TeeContext.OutputCount++;
         }
-        DesiredAccess = (Append?FILE_APPEND_DATA:FILE_WRITE_DATA) | SYNCHRONIZE;
     }
 
-    TeeContext.hFile = CreateFile(FileName.StartOfString,
-                                  DesiredAccess,
-                                  FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
-                                  NULL,
-                                  OPEN_ALWAYS,
-                                  FILE_ATTRIBUTE_NORMAL,
-                                  NULL);
+    if (StartArg != 0) {
+        for (i = StartArg; Result == EXIT_SUCCESS && i < ArgC; i++) {
+            if (!TeeOpenFile(&TeeContext.Outputs[TeeContext.OutputCount], &ArgV[i], Append)) {
+                TeeCloseOutput(&TeeContext.Outputs[TeeContext.OutputCount]);
+                Result = EXIT_FAILURE;
+            } else {
+                TeeContext.OutputCount++;
+            }
+        }
+    }
 
-    if (TeeContext.hFile == INVALID_HANDLE_VALUE || TeeContext.hFile == NULL) {
-        DWORD LastError = GetLastError();
-        LPTSTR ErrText = YoriLibGetWinErrorText(LastError);
-        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("tee: open of %y failed: %s"), &FileName, ErrText);
-        YoriLibFreeWinErrorText(ErrText);
-        YoriLibFreeStringContents(&FileName);
-        return EXIT_FAILURE;
+    //
+    //  Consoles are always written synchronously, since output needs to
+    //  inspect the cursor position.
+    //
+
+    if (TeeContext.Background) {
+        for (Index = 0; Result == EXIT_SUCCESS && Index < TeeContext.OutputCount; Index++) {
+            Output = &TeeContext.Outputs[Index];
+            if (!Output->IsConsole && !TeeStartWriter(Output)) {
+                YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("tee: could not create writer for %y\n"), &Output->Name);
+                Result = EXIT_FAILURE;
+            }
+        }
     }
 
-    TeeProcessStream(GetStdHandle(STD_INPUT_HANDLE), &TeeContext);
+    if (Result == EXIT_SUCCESS) {
+        TeeProcessStream(GetStdHandle(STD_INPUT_HANDLE), &TeeContext);
+    }
 
 #if !YORI_BUILTIN
     YoriLibLineReadCleanupCache();
 #endif
 
-    CloseHandle(TeeContext.hFile);
-    YoriLibFreeStringContents(&FileName);
+    for (Index = 0; Index < TeeContext.OutputCount; Index++) {
+        Output = &TeeContext.Outputs[Index];
+        if (!TeeCloseOutput(Output)) {
+            Result = EXIT_FAILURE;
+        }
+    }
+
+    YoriLibFree(CommandArgs);
+    YoriLibFree(TeeContext.Outputs);
 
-    return EXIT_SUCCESS;
+    return Result;
 }
 
 // vim:sw=4:ts=4:et:
@@ -391,4 +391,69 @@ TestEnumWindows(VOID)
     return TRUE;
 }
 
+/**
+ A test variation to recursively enumerate files in a system directory on
+ multiple threads and check that the same files are found as a serial
+ enumerate.
+ */
+BOOLEAN
+TestEnumRecurseParallel(VOID)
+{
+    TEST_ENUM_CONTEXT TestContext;
+    DWORDLONG SerialFilesFound;
+    WORD MatchFlags;
+
+    TestContext.Failed = FALSE;
+    TestContext.FilesFound = 0;
+
+    MatchFlags = YORILIB_FILEENUM_RETURN_FILES |
+                 YORILIB_FILEENUM_RETURN_DIRECTORIES |
+                 YORILIB_FILEENUM_RECURSE_BEFORE_RETURN |
+                 YORILIB_FILEENUM_NO_LINK_TRAVERSE;
+
+    YoriLibConstantString(&TestContext.FileSpec, _T("C:\\Windows\\System32\\drivers\\*"));
+    if (!YoriLibForEachFile(&TestContext.FileSpec,
+                            MatchFlags,
+                            0,
+                            TestEnumFileFoundCallback,
+                            TestEnumFileEnumerateErrorCallback,
+                            &TestContext)) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i YoriLibForEachFile failed searching %y, error %i\n"), __FILE__, __LINE__, &TestContext.FileSpec, GetLastError());
+        return FALSE;
+    }
+
+    if (TestContext.FilesFound == 0) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i YoriLibForEachFile found no files looking for %y\n"), __FILE__, __LINE__, &TestContext.FileSpec);
+        return FALSE;
+    }
+
+    if (TestContext.Failed) {
+        return FALSE;
+    }
+
+    SerialFilesFound = TestContext.FilesFound;
+    TestContext.FilesFound = 0;
+
+    if (!YoriLibForEachFile(&TestContext.FileSpec,
+                            MatchFlags | YORILIB_FILEENUM_PARALLEL,
+                            0,
+                            TestEnumFileFoundCallback,
+                            TestEnumFileEnumerateErrorCallback,
+                            &TestContext)) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i YoriLibForEachFile failed parallel search of %y, error %i\n"), __FILE__, __LINE__, &TestContext.FileSpec, GetLastError());
+        return FALSE;
+    }
+
+    if (TestContext.FilesFound != SerialFilesFound) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i YoriLibForEachFile found %lli files in parallel, %lli serially, looking for %y\n"), __FILE__, __LINE__, TestContext.FilesFound, SerialFilesFound, &TestContext.FileSpec);
+        return FALSE;
+    }
+
+    if (TestContext.Failed) {
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
 // vim:sw=4:ts=4:et:
@@ -0,0 +1,182 @@
+/**
+ * @file test/hash.c
+ *
+ * Yori shell test hash table routines
+ *
+ * Copyright (c) 2026 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <yoripch.h>
+#include <yorilib.h>
+#include "test.h"
+
+/**
+ The number of entries to insert when testing hash table growth.  This is
+ large enough to force many rounds of bucket splits from a small table.
+ */
+#define TEST_HASH_ENTRY_COUNT (5000)
+
+/**
+ A test variation to insert enough entries into a hash table to cause it to
+ grow, checking that every entry can be found, enumerated and removed.
+ */
+BOOLEAN
+TestHashGrow(VOID)
+{
+    PYORI_HASH_TABLE HashTable;
+    PYORI_HASH_ENTRY Entries;
+    PYORI_HASH_ENTRY HashEntry;
+    PYORI_HASH_ENTRY NextEntry;
+    YORI_STRING Key;
+    TCHAR KeyBuffer[32];
+    YORI_ALLOC_SIZE_T Index;
+    YORI_ALLOC_SIZE_T Count;
+    BOOLEAN Result;
+
+    Result = FALSE;
+    HashTable = YoriLibAllocateHashTable(4);
+    if (HashTable == NULL) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i YoriLibAllocateHashTable failed\n"), __FILE__, __LINE__);
+        return FALSE;
+    }
+
+    Entries = YoriLibMalloc(TEST_HASH_ENTRY_COUNT * sizeof(YORI_HASH_ENTRY));
+    if (Entries == NULL) {
+        YoriLibFreeEmptyHashTable(HashTable);
+        return FALSE;
+    }
+
+    YoriLibInitEmptyString(&Key);
+    Key.StartOfString = KeyBuffer;
+    Key.LengthAllocated = sizeof(KeyBuffer)/sizeof(KeyBuffer[0]);
+
+    for (Index = 0; Index < TEST_HASH_ENTRY_COUNT; Index++) {
+        Key.LengthInChars = YoriLibSPrintf(KeyBuffer, _T("Key%i.obj"), Index);
+        YoriLibHashInsertByKey(HashTable, &Key, &Entries[Index], &Entries[Index]);
+    }
+
+    if (HashTable->NumberBuckets <= 4) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i hash table did not grow, have %i buckets\n"), __FILE__, __LINE__, HashTable->NumberBuckets);
+        goto Exit;
+    }
+
+    //
+    //  Check that every entry is found, using a key with different case to
+    //  check lookups remain case insensitive.
+    //
+
+    for (Index = 0; Index < TEST_HASH_ENTRY_COUNT; Index++) {
+        Key.LengthInChars = YoriLibSPrintf(KeyBuffer, _T("KEY%i.OBJ"), Index);
+        HashEntry = YoriLibHashLookupByKey(HashTable, &Key);
+        if (HashEntry != &Entries[Index]) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i YoriLibHashLookupByKey did not find %y\n"), __FILE__, __LINE__, &Key);
+            goto Exit;
+        }
+    }
+
+    Key.LengthInChars = YoriLibSPrintf(KeyBuffer, _T("Key%i.obj"), TEST_HASH_ENTRY_COUNT);
+    if (YoriLibHashLookupByKey(HashTable, &Key) != NULL) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i YoriLibHashLookupByKey found nonexistent %y\n"), __FILE__, __LINE__, &Key);
+        goto Exit;
+    }
+
+    Result = TRUE;
+
+Exit:
+
+    //
+    //  Remove every entry via enumeration, which also checks that
+    //  enumeration returns each entry exactly once.
+    //
+
+    Count = 0;
+    HashEntry = YoriLibHashGetNextEntry(HashTable, NULL);
+    while (HashEntry != NULL) {
+        NextEntry = YoriLibHashGetNextEntry(HashTable, HashEntry);
+        YoriLibHashRemoveByEntry(HashEntry);
+        Count++;
+        HashEntry = NextEntry;
+    }
+
+    if (Result && Count != TEST_HASH_ENTRY_COUNT) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i YoriLibHashGetNextEntry returned %i entries, expected %i\n"), __FILE__, __LINE__, Count, TEST_HASH_ENTRY_COUNT);
+        Result = FALSE;
+    }
+
+    YoriLibFree(Entries);
+    YoriLibFreeEmptyHashTable(HashTable);
+    return Result;
+}
+
+/**
+ A test variation to check that hashing a key is insensitive to case for
+ every length and alignment of key, including keys mixing ASCII and other
+ characters, and that keys differing in their final character hash
+ differently.
+ */
+BOOLEAN
+TestHashKeyCase(VOID)
+{
+    YORI_STRING Lower;
+    YORI_STRING Upper;
+    TCHAR LowerBuffer[] = _T("abcdefghijklmnopqrstuvwxyz\x00e9[`{@");
+    TCHAR UpperBuffer[] = _T("ABCDEFGHIJKLMNOPQRSTUVWXYZ\x00e9[`{@");
+    YORI_ALLOC_SIZE_T Length;
+    YORI_ALLOC_SIZE_T Offset;
+    YORI_ALLOC_SIZE_T BufferLength;
+    DWORD Hash;
+
+    BufferLength = sizeof(LowerBuffer)/sizeof(LowerBuffer[0]) - 1;
+
+    YoriLibInitEmptyString(&Lower);
+    YoriLibInitEmptyString(&Upper);
+
+    for (Offset = 0; Offset < BufferLength; Offset++) {
+        for (Length = 0; Offset + Length <= BufferLength; Length++) {
+            Lower.StartOfString = &LowerBuffer[Offset];
+            Lower.LengthInChars = Length;
+            Upper.StartOfString = &UpperBuffer[Offset];
+            Upper.LengthInChars = Length;
+            if (YoriLibHashKey(&Lower) != YoriLibHashKey(&Upper)) {
+                YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i YoriLibHashKey differs for %y and %y\n"), __FILE__, __LINE__, &Lower, &Upper);
+                return FALSE;
+            }
+        }
+    }
+
+    //
+    //  The final five characters are not letters, so their case must not
+    //  be altered.  Check that changing the last one changes the hash.
+    //
+
+    Lower.StartOfString = LowerBuffer;
+    Lower.LengthInChars = BufferLength;
+    Hash = YoriLibHashKey(&Lower);
+    LowerBuffer[BufferLength - 1] = '`';
+    if (YoriLibHashKey(&Lower) == Hash) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i YoriLibHashKey did not change with the final character of %y\n"), __FILE__, __LINE__, &Lower);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+// vim:sw=4:ts=4:et:
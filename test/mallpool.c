@@ -0,0 +1,417 @@
+/**
+ * @file test/mallpool.c
+ *
+ * Yori shell test pooled allocator routines
+ *
+ * Copyright (c) 2026 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <yoripch.h>
+#include <yorilib.h>
+#include "test.h"
+
+/**
+ The largest allocation that the pool services.  Allocations larger than
+ this are serviced from the process heap.
+ */
+#define TEST_POOL_MAX_BLOCK_SIZE (512)
+
+/**
+ The number of blocks allocated by each thread when testing allocations
+ across threads.  This is large enough that a thread freeing another
+ thread's blocks exceeds its cache and returns blocks to the process wide
+ list.
+ */
+#define TEST_POOL_THREAD_BLOCK_COUNT (2000)
+
+/**
+ State shared with a second thread when testing allocations across threads.
+ */
+typedef struct _TEST_POOL_THREAD_CONTEXT {
+
+    /**
+     Blocks allocated by the main thread, which the second thread checks and
+     frees.
+     */
+    PVOID *MainBlocks;
+
+    /**
+     Blocks allocated by the second thread, which the main thread checks and
+     frees once the second thread has exited.
+     */
+    PVOID *ThreadBlocks;
+
+    /**
+     Set to TRUE if the second thread found a problem.
+     */
+    BOOLEAN Failed;
+
+} TEST_POOL_THREAD_CONTEXT, *PTEST_POOL_THREAD_CONTEXT;
+
+/**
+ Return the size of a block used by the tests, which cycles through every
+ size class and sizes on either side of each class boundary.
+
+ @param Index The index of the block.
+
+ @return The number of bytes to allocate.
+ */
+YORI_ALLOC_SIZE_T
+TestPoolBlockSize(
+    __in DWORD Index
+    )
+{
+    return (YORI_ALLOC_SIZE_T)((Index * 37) % TEST_POOL_MAX_BLOCK_SIZE + 1);
+}
+
+/**
+ Allocate a block and fill it with a pattern derived from its index, so that
+ a block which overlaps another or is handed out twice is detected.
+
+ @param Index The index of the block.
+
+ @param Size The number of bytes to allocate.
+
+ @return Pointer to the block, or NULL on failure.
+ */
+PVOID
+TestPoolAllocateBlock(
+    __in DWORD Index,
+    __in YORI_ALLOC_SIZE_T Size
+    )
+{
+    PUCHAR Block;
+
+    Block = YoriLibMalloc(Size);
+    if (Block == NULL) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i YoriLibMalloc of %i bytes failed\n"), __FILE__, __LINE__, Size);
+        return NULL;
+    }
+
+    if (((DWORD_PTR)Block % (2 * sizeof(PVOID))) != 0) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i YoriLibMalloc of %i bytes returned unaligned %p\n"), __FILE__, __LINE__, Size, Block);
+        YoriLibFree(Block);
+        return NULL;
+    }
+
+    memset(Block, (UCHAR)Index, Size);
+    return Block;
+}
+
+/**
+ Check that a block still contains the pattern it was filled with.
+
+ @param Block Pointer to the block.
+
+ @param Index The index of the block.
+
+ @param Size The number of bytes in the block.
+
+ @return TRUE if the block is intact, FALSE if it has been overwritten.
+ */
+BOOLEAN
+TestPoolCheckBlock(
+    __in PVOID Block,
+    __in DWORD Index,
+    __in YORI_ALLOC_SIZE_T Size
+    )
+{
+    PUCHAR Bytes;
+    YORI_ALLOC_SIZE_T Offset;
+
+    Bytes = (PUCHAR)Block;
+    for (Offset = 0; Offset < Size; Offset++) {
+        if (Bytes[Offset] != (UCHAR)Index) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i block %i of %i bytes overwritten at offset %i\n"), __FILE__, __LINE__, Index, Size, Offset);
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+/**
+ Enable the pool for this process.
+
+ @return TRUE if the pool is enabled, FALSE if it could not be.
+ */
+BOOLEAN
+TestPoolEnable(VOID)
+{
+    if (!YoriLibPoolEnable()) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i YoriLibPoolEnable failed\n"), __FILE__, __LINE__);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/**
+ A test variation to allocate a block of every size the pool services and
+ some larger ones, check that no blocks overlap, free and reallocate half of
+ them, and check that small blocks came from the pool.
+ */
+BOOLEAN
+TestPoolSizeClasses(VOID)
+{
+#if YORI_SPECIAL_HEAP
+
+    //
+    //  Debug builds place every allocation against a guard page, so the
+    //  pool is never enabled.
+    //
+
+    return TRUE;
+#else
+    PVOID Blocks[TEST_POOL_MAX_BLOCK_SIZE + 2];
+    YORI_ALLOC_SIZE_T Sizes[TEST_POOL_MAX_BLOCK_SIZE + 2];
+    DWORD Index;
+    DWORD Count;
+    BOOLEAN Result;
+
+    if (!TestPoolEnable()) {
+        return FALSE;
+    }
+
+    //
+    //  Allocate every size up to the largest the pool services, then two
+    //  sizes which must be serviced from the process heap.
+    //
+
+    Count = sizeof(Blocks)/sizeof(Blocks[0]);
+    for (Index = 0; Index < TEST_POOL_MAX_BLOCK_SIZE; Index++) {
+        Sizes[Index] = (YORI_ALLOC_SIZE_T)(Index + 1);
+    }
+    Sizes[TEST_POOL_MAX_BLOCK_SIZE] = TEST_POOL_MAX_BLOCK_SIZE + 1;
+    Sizes[TEST_POOL_MAX_BLOCK_SIZE + 1] = 4096;
+
+    ZeroMemory(Blocks, sizeof(Blocks));
+    Result = FALSE;
+
+    for (Index = 0; Index < Count; Index++) {
+        Blocks[Index] = TestPoolAllocateBlock(Index, Sizes[Index]);
+        if (Blocks[Index] == NULL) {
+            goto Exit;
+        }
+    }
+
+    for (Index = 0; Index < Count; Index++) {
+        if (!TestPoolCheckBlock(Blocks[Index], Index, Sizes[Index])) {
+            goto Exit;
+        }
+    }
+
+    //
+    //  Free every other block and allocate it again, so blocks are reused
+    //  from the free lists rather than only carved from new slabs.
+    //
+
+    for (Index = 0; Index < Count; Index += 2) {
+        YoriLibFree(Blocks[Index]);
+        Blocks[Index] = NULL;
+    }
+
+    for (Index = 0; Index < Count; Index += 2) {
+        Blocks[Index] = TestPoolAllocateBlock(Index, Sizes[Index]);
+        if (Blocks[Index] == NULL) {
+            goto Exit;
+        }
+    }
+
+    for (Index = 0; Index < Count; Index++) {
+        if (!TestPoolCheckBlock(Blocks[Index], Index, Sizes[Index])) {
+            goto Exit;
+        }
+    }
+
+    //
+    //  YoriLibPoolFree only frees blocks that came from the pool, so use it
+    //  to check which blocks were pooled.
+    //
+
+    for (Index = 0; Index < Count; Index++) {
+        if (YoriLibPoolFree(Blocks[Index])) {
+            if (Sizes[Index] > TEST_POOL_MAX_BLOCK_SIZE) {
+                YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i allocation of %i bytes was serviced from the pool\n"), __FILE__, __LINE__, Sizes[Index]);
+                Blocks[Index] = NULL;
+                goto Exit;
+            }
+        } else {
+            if (Sizes[Index] <= TEST_POOL_MAX_BLOCK_SIZE) {
+                YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i allocation of %i bytes was not serviced from the pool\n"), __FILE__, __LINE__, Sizes[Index]);
+                goto Exit;
+            }
+            YoriLibFree(Blocks[Index]);
+        }
+        Blocks[Index] = NULL;
+    }
+
+    Result = TRUE;
+
+Exit:
+    for (Index = 0; Index < Count; Index++) {
+        if (Blocks[Index] != NULL) {
+            YoriLibFree(Blocks[Index]);
+        }
+    }
+
+    return Result;
+#endif
+}
+
+/**
+ A thread which checks and frees blocks allocated by the main thread, then
+ allocates blocks of its own for the main thread to free.
+
+ @param Parameter Pointer to the test context.
+
+ @return Exit code for the thread, currently always zero.
+ */
+DWORD WINAPI
+TestPoolThread(
+    __in LPVOID Parameter
+    )
+{
+    PTEST_POOL_THREAD_CONTEXT Context;
+    DWORD Index;
+
+    Context = (PTEST_POOL_THREAD_CONTEXT)Parameter;
+
+    for (Index = 0; Index < TEST_POOL_THREAD_BLOCK_COUNT; Index++) {
+        if (!TestPoolCheckBlock(Context->MainBlocks[Index], Index, TestPoolBlockSize(Index))) {
+            Context->Failed = TRUE;
+        }
+        YoriLibFree(Context->MainBlocks[Index]);
+        Context->MainBlocks[Index] = NULL;
+    }
+
+    for (Index = 0; Index < TEST_POOL_THREAD_BLOCK_COUNT; Index++) {
+        Context->ThreadBlocks[Index] = TestPoolAllocateBlock(Index, TestPoolBlockSize(Index));
+        if (Context->ThreadBlocks[Index] == NULL) {
+            Context->Failed = TRUE;
+            break;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ A test variation to allocate blocks on one thread and free them on a
+ second thread, and to allocate blocks on the second thread and free them
+ once it has exited, checking that no block is handed out twice.
+ */
+BOOLEAN
+TestPoolCrossThread(VOID)
+{
+#if YORI_SPECIAL_HEAP
+
+    //
+    //  Debug builds place every allocation against a guard page, so the
+    //  pool is never enabled.
+    //
+
+    return TRUE;
+#else
+    TEST_POOL_THREAD_CONTEXT Context;
+    PVOID *Blocks;
+    HANDLE hThread;
+    DWORD ThreadId;
+    DWORD Index;
+    BOOLEAN Result;
+
+    if (!TestPoolEnable()) {
+        return FALSE;
+    }
+
+    //
+    //  One allocation holds the blocks for the main thread, the second
+    //  thread, and the main thread's allocations after the second thread
+    //  has exited.
+    //
+
+    Blocks = YoriLibMalloc(3 * TEST_POOL_THREAD_BLOCK_COUNT * sizeof(PVOID));
+    if (Blocks == NULL) {
+        return FALSE;
+    }
+
+    ZeroMemory(Blocks, 3 * TEST_POOL_THREAD_BLOCK_COUNT * sizeof(PVOID));
+    Context.MainBlocks = Blocks;
+    Context.ThreadBlocks = &Blocks[TEST_POOL_THREAD_BLOCK_COUNT];
+    Context.Failed = FALSE;
+    Result = FALSE;
+
+    for (Index = 0; Index < TEST_POOL_THREAD_BLOCK_COUNT; Index++) {
+        Context.MainBlocks[Index] = TestPoolAllocateBlock(Index, TestPoolBlockSize(Index));
+        if (Context.MainBlocks[Index] == NULL) {
+            goto Exit;
+        }
+    }
+
+    hThread = CreateThread(NULL, 0, TestPoolThread, &Context, 0, &ThreadId);
+    if (hThread == NULL) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i CreateThread failed, error %i\n"), __FILE__, __LINE__, GetLastError());
+        goto Exit;
+    }
+
+    WaitForSingleObject(hThread, INFINITE);
+    CloseHandle(hThread);
+
+    if (Context.Failed) {
+        goto Exit;
+    }
+
+    //
+    //  Allocate again on the main thread, which reuses blocks that the
+    //  second thread freed, while the second thread's blocks are still
+    //  allocated.
+    //
+
+    for (Index = 0; Index < TEST_POOL_THREAD_BLOCK_COUNT; Index++) {
+        Blocks[2 * TEST_POOL_THREAD_BLOCK_COUNT + Index] = TestPoolAllocateBlock(Index + 1, TestPoolBlockSize(Index));
+        if (Blocks[2 * TEST_POOL_THREAD_BLOCK_COUNT + Index] == NULL) {
+            goto Exit;
+        }
+    }
+
+    for (Index = 0; Index < TEST_POOL_THREAD_BLOCK_COUNT; Index++) {
+        if (!TestPoolCheckBlock(Context.ThreadBlocks[Index], Index, TestPoolBlockSize(Index))) {
+            goto Exit;
+        }
+        if (!TestPoolCheckBlock(Blocks[2 * TEST_POOL_THREAD_BLOCK_COUNT + Index], Index + 1, TestPoolBlockSize(Index))) {
+            goto Exit;
+        }
+    }
+
+    Result = TRUE;
+
+Exit:
+    for (Index = 0; Index < 3 * TEST_POOL_THREAD_BLOCK_COUNT; Index++) {
+        if (Blocks[Index] != NULL) {
+            YoriLibFree(Blocks[Index]);
+        }
+    }
+
+    YoriLibFree(Blocks);
+    return Result;
+#endif
+}
+
+// vim:sw=4:ts=4:et:
@@ -0,0 +1,371 @@
+/**
+ * @file test/printf.c
+ *
+ * Yori shell test printf routines
+ *
+ * Copyright (c) 2026 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <yoripch.h>
+#include <yorilib.h>
+#include "test.h"
+
+/**
+ The number of characters in buffers used to hold formatted output.
+ */
+#define TEST_PRINTF_BUFFER_SIZE (64)
+
+/**
+ Format a string with a format string that is parsed on each call and with
+ the same format string once it has been compiled, and check that both
+ produce the expected result and report the same size.
+
+ @param Line The line number of the caller, used to report failures.
+
+ @param Expected The expected result.
+
+ @param Format The format string.
+
+ @return TRUE if every form of printf produced the expected result, FALSE if
+         any did not.
+ */
+BOOLEAN
+TestPrintfCheck(
+    __in DWORD Line,
+    __in LPCTSTR Expected,
+    __in LPCTSTR Format,
+    ...
+    )
+{
+    va_list marker;
+    YORI_LIB_PRINTF_FORMAT Compiled;
+    TCHAR Buffer[TEST_PRINTF_BUFFER_SIZE];
+    TCHAR CompiledBuffer[TEST_PRINTF_BUFFER_SIZE];
+    YORI_STRING Result;
+    YORI_STRING ExpectedString;
+    YORI_SIGNED_ALLOC_SIZE_T Length;
+    YORI_SIGNED_ALLOC_SIZE_T Size;
+    YORI_SIGNED_ALLOC_SIZE_T ExpectedLength;
+    BOOLEAN Succeeded;
+
+    YoriLibConstantString(&ExpectedString, Expected);
+    ExpectedLength = ExpectedString.LengthInChars;
+
+    va_start(marker, Format);
+    Length = YoriLibVSPrintf(Buffer, TEST_PRINTF_BUFFER_SIZE, Format, marker);
+    va_end(marker);
+
+    YoriLibConstantString(&Result, Buffer);
+    if (Length != ExpectedLength || YoriLibCompareStringLit(&Result, Expected) != 0) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i YoriLibVSPrintf of \"%s\" returned \"%s\" (%i), expected \"%s\"\n"), __FILE__, Line, Format, Buffer, Length, Expected);
+        return FALSE;
+    }
+
+    va_start(marker, Format);
+    Size = YoriLibVSPrintfSize(Format, marker);
+    va_end(marker);
+
+    if (Size != ExpectedLength + 1) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i YoriLibVSPrintfSize of \"%s\" returned %i, expected %i\n"), __FILE__, Line, Format, Size, ExpectedLength + 1);
+        return FALSE;
+    }
+
+    if (!YoriLibCompilePrintfFormat(Format, &Compiled)) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i YoriLibCompilePrintfFormat of \"%s\" failed\n"), __FILE__, Line, Format);
+        return FALSE;
+    }
+
+    Succeeded = FALSE;
+
+    va_start(marker, Format);
+    Length = YoriLibVSPrintfCompiled(CompiledBuffer, TEST_PRINTF_BUFFER_SIZE, &Compiled, marker);
+    va_end(marker);
+
+    YoriLibConstantString(&Result, CompiledBuffer);
+    if (Length != ExpectedLength || YoriLibCompareStringLit(&Result, Buffer) != 0) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i YoriLibVSPrintfCompiled of \"%s\" returned \"%s\" (%i), uncompiled returned \"%s\"\n"), __FILE__, Line, Format, CompiledBuffer, Length, Buffer);
+        goto Exit;
+    }
+
+    va_start(marker, Format);
+    Size = YoriLibVSPrintfCompiledSize(&Compiled, marker);
+    va_end(marker);
+
+    if (Size != ExpectedLength + 1) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i YoriLibVSPrintfCompiledSize of \"%s\" returned %i, expected %i\n"), __FILE__, Line, Format, Size, ExpectedLength + 1);
+        goto Exit;
+    }
+
+    Succeeded = TRUE;
+
+Exit:
+    YoriLibFreePrintfFormat(&Compiled);
+    return Succeeded;
+}
+
+/**
+ A test variation to format numbers and strings with and without widths,
+ zero padding and left alignment, checking that a compiled format produces
+ the same result as a format that is parsed on each call.
+ */
+BOOLEAN
+TestPrintfFormat(VOID)
+{
+    YORI_STRING Str;
+    DWORDLONG LargeNumber;
+
+    YoriLibConstantString(&Str, _T("yori"));
+
+    //
+    //  Literal text, including text following the final specifier.
+    //
+
+    if (!TestPrintfCheck(__LINE__, _T(""), _T("")) ||
+        !TestPrintfCheck(__LINE__, _T("plain text"), _T("plain text")) ||
+        !TestPrintfCheck(__LINE__, _T("100%"), _T("100%%")) ||
+        !TestPrintfCheck(__LINE__, _T("[x]"), _T("[%c]"), 'x')) {
+
+        return FALSE;
+    }
+
+    //
+    //  32 bit decimal numbers.  A 32 bit number with more digits than its
+    //  width only displays the low order digits.
+    //
+
+    if (!TestPrintfCheck(__LINE__, _T("0"), _T("%i"), 0) ||
+        !TestPrintfCheck(__LINE__, _T("7"), _T("%i"), 7) ||
+        !TestPrintfCheck(__LINE__, _T("99"), _T("%i"), 99) ||
+        !TestPrintfCheck(__LINE__, _T("100"), _T("%i"), 100) ||
+        !TestPrintfCheck(__LINE__, _T("1234567"), _T("%i"), 1234567) ||
+        !TestPrintfCheck(__LINE__, _T("4294967295"), _T("%i"), (DWORD)-1) ||
+        !TestPrintfCheck(__LINE__, _T("   42"), _T("%5i"), 42) ||
+        !TestPrintfCheck(__LINE__, _T("00042"), _T("%05i"), 42) ||
+        !TestPrintfCheck(__LINE__, _T("42   |"), _T("%-5i|"), 42) ||
+        !TestPrintfCheck(__LINE__, _T("12345"), _T("%5i"), 12345) ||
+        !TestPrintfCheck(__LINE__, _T("45"), _T("%2i"), 12345) ||
+        !TestPrintfCheck(__LINE__, _T("a1b22c"), _T("a%ib%ic"), 1, 22)) {
+
+        return FALSE;
+    }
+
+    //
+    //  64 bit decimal numbers, including values that need 64 bit division,
+    //  and widths smaller than the number, which do not truncate.
+    //
+
+    LargeNumber = 0x11f71fb04cb;
+    if (!TestPrintfCheck(__LINE__, _T("0"), _T("%lli"), (DWORDLONG)0) ||
+        !TestPrintfCheck(__LINE__, _T("4294967296"), _T("%lli"), (DWORDLONG)0x100000000) ||
+        !TestPrintfCheck(__LINE__, _T("1234567890123"), _T("%lli"), LargeNumber) ||
+        !TestPrintfCheck(__LINE__, _T("18446744073709551615"), _T("%lli"), (DWORDLONG)-1) ||
+        !TestPrintfCheck(__LINE__, _T("001234567890123"), _T("%015lli"), LargeNumber) ||
+        !TestPrintfCheck(__LINE__, _T("  1234567890123"), _T("%15lli"), LargeNumber) ||
+        !TestPrintfCheck(__LINE__, _T("1234567890123  |"), _T("%-15lli|"), LargeNumber) ||
+        !TestPrintfCheck(__LINE__, _T("1234567890123"), _T("%4lli"), LargeNumber)) {
+
+        return FALSE;
+    }
+
+    //
+    //  Hexadecimal numbers.
+    //
+
+    if (!TestPrintfCheck(__LINE__, _T("0"), _T("%x"), 0) ||
+        !TestPrintfCheck(__LINE__, _T("deadbeef"), _T("%x"), 0xdeadbeef) ||
+        !TestPrintfCheck(__LINE__, _T(" abc"), _T("%4x"), 0xabc) ||
+        !TestPrintfCheck(__LINE__, _T("0000001f"), _T("%08x"), 0x1f) ||
+        !TestPrintfCheck(__LINE__, _T("1f  |"), _T("%-4x|"), 0x1f) ||
+        !TestPrintfCheck(__LINE__, _T("123456789abcdef0"), _T("%llx"), (DWORDLONG)0x123456789abcdef0) ||
+        !TestPrintfCheck(__LINE__, _T("00000000ffffffff"), _T("%016llx"), (DWORDLONG)0xffffffff)) {
+
+        return FALSE;
+    }
+
+    //
+    //  Strings, with padding, left alignment, and widths smaller than the
+    //  string, which truncate.
+    //
+
+    if (!TestPrintfCheck(__LINE__, _T("abc"), _T("%s"), _T("abc")) ||
+        !TestPrintfCheck(__LINE__, _T("   abc|"), _T("%6s|"), _T("abc")) ||
+        !TestPrintfCheck(__LINE__, _T("abc   |"), _T("%-6s|"), _T("abc")) ||
+        !TestPrintfCheck(__LINE__, _T("ab|"), _T("%2s|"), _T("abcdef")) ||
+        !TestPrintfCheck(__LINE__, _T("abc"), _T("%hs"), "abc") ||
+        !TestPrintfCheck(__LINE__, _T("yori  |"), _T("%-6y|"), &Str) ||
+        !TestPrintfCheck(__LINE__, _T("<yori> 12"), _T("<%y> %i"), &Str, 12)) {
+
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ Process a compiled printf format and output the result into a NULL
+ terminated buffer of specified size.
+
+ @param szDest The buffer to populate with the result.
+
+ @param len The number of characters in the buffer.
+
+ @param Format The compiled format to process.
+
+ @return The number of characters successfully populated into the buffer, or
+         -1 on error.
+ */
+YORI_SIGNED_ALLOC_SIZE_T
+TestPrintfSPrintfCompiledS(
+    __out_ecount(len) LPTSTR szDest,
+    __in YORI_ALLOC_SIZE_T len,
+    __in PYORI_LIB_PRINTF_FORMAT Format,
+    ...
+    )
+{
+    va_list marker;
+    YORI_SIGNED_ALLOC_SIZE_T out_len;
+
+    va_start(marker, Format);
+    out_len = YoriLibVSPrintfCompiled(szDest, len, Format, marker);
+    va_end(marker);
+    return out_len;
+}
+
+/**
+ A test variation to format into buffers that are too small, checking that
+ a fixed size buffer reports failure, that a result which exactly fits is
+ not truncated, and that a Yori string which is too small is reallocated.
+ */
+BOOLEAN
+TestPrintfTruncate(VOID)
+{
+    TCHAR Buffer[TEST_PRINTF_BUFFER_SIZE];
+    YORI_LIB_PRINTF_FORMAT Compiled;
+    YORI_STRING Dest;
+    YORI_SIGNED_ALLOC_SIZE_T Length;
+
+    //
+    //  A result which is one character too large for the buffer, including
+    //  its terminator, fails and leaves an empty string.  This is checked
+    //  for a number, for literal text which is copied as a run, for a
+    //  string, and for padding.
+    //
+
+    Length = YoriLibSPrintfS(Buffer, 6, _T("%i"), 123456);
+    if (Length != -1 || Buffer[0] != '\0') {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i YoriLibSPrintfS of a number into a short buffer returned %i\n"), __FILE__, __LINE__, Length);
+        return FALSE;
+    }
+
+    Length = YoriLibSPrintfS(Buffer, 4, _T("abcd"));
+    if (Length != -1 || Buffer[0] != '\0') {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i YoriLibSPrintfS of literal text into a short buffer returned %i\n"), __FILE__, __LINE__, Length);
+        return FALSE;
+    }
+
+    Length = YoriLibSPrintfS(Buffer, 4, _T("%s"), _T("abcd"));
+    if (Length != -1 || Buffer[0] != '\0') {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i YoriLibSPrintfS of a string into a short buffer returned %i\n"), __FILE__, __LINE__, Length);
+        return FALSE;
+    }
+
+    Length = YoriLibSPrintfS(Buffer, 6, _T("%-6s"), _T("ab"));
+    if (Length != -1 || Buffer[0] != '\0') {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i YoriLibSPrintfS of padding into a short buffer returned %i\n"), __FILE__, __LINE__, Length);
+        return FALSE;
+    }
+
+    //
+    //  A result which exactly fits succeeds, for both a format that is
+    //  parsed on each call and a compiled format.
+    //
+
+    Length = YoriLibSPrintfS(Buffer, 7, _T("%i"), 123456);
+    YoriLibConstantString(&Dest, Buffer);
+    if (Length != 6 || YoriLibCompareStringLit(&Dest, _T("123456")) != 0) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i YoriLibSPrintfS of a number into an exact buffer returned %i\n"), __FILE__, __LINE__, Length);
+        return FALSE;
+    }
+
+    if (!YoriLibCompilePrintfFormat(_T("<%08x>"), &Compiled)) {
+        return FALSE;
+    }
+
+    Length = TestPrintfSPrintfCompiledS(Buffer, 10, &Compiled, 0xabcdef);
+    if (Length != -1 || Buffer[0] != '\0') {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i YoriLibVSPrintfCompiled into a short buffer returned %i\n"), __FILE__, __LINE__, Length);
+        YoriLibFreePrintfFormat(&Compiled);
+        return FALSE;
+    }
+
+    Length = TestPrintfSPrintfCompiledS(Buffer, 11, &Compiled, 0xabcdef);
+    YoriLibConstantString(&Dest, Buffer);
+    if (Length != 10 || YoriLibCompareStringLit(&Dest, _T("<00abcdef>")) != 0) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i YoriLibVSPrintfCompiled into an exact buffer returned %i\n"), __FILE__, __LINE__, Length);
+        YoriLibFreePrintfFormat(&Compiled);
+        return FALSE;
+    }
+
+    //
+    //  A Yori string with a buffer that is too small is reallocated, which
+    //  requires the arguments to be processed again after the first
+    //  attempt fails.
+    //
+
+    if (!YoriLibAllocateString(&Dest, 4)) {
+        YoriLibFreePrintfFormat(&Compiled);
+        return FALSE;
+    }
+
+    Length = YoriLibYPrintf(&Dest, _T("%i-%s"), 123456789, _T("abc"));
+    if (Length != 13 ||
+        Dest.LengthAllocated < 14 ||
+        YoriLibCompareStringLit(&Dest, _T("123456789-abc")) != 0) {
+
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i YoriLibYPrintf into a short string returned %i, %y\n"), __FILE__, __LINE__, Length, &Dest);
+        YoriLibFreeStringContents(&Dest);
+        YoriLibFreePrintfFormat(&Compiled);
+        return FALSE;
+    }
+
+    YoriLibFreeStringContents(&Dest);
+
+    if (!YoriLibAllocateString(&Dest, 4)) {
+        YoriLibFreePrintfFormat(&Compiled);
+        return FALSE;
+    }
+
+    Length = YoriLibYPrintfCompiled(&Dest, &Compiled, 0xabcdef);
+    if (Length != 10 ||
+        YoriLibCompareStringLit(&Dest, _T("<00abcdef>")) != 0) {
+
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i YoriLibYPrintfCompiled into a short string returned %i, %y\n"), __FILE__, __LINE__, Length, &Dest);
+        YoriLibFreeStringContents(&Dest);
+        YoriLibFreePrintfFormat(&Compiled);
+        return FALSE;
+    }
+
+    YoriLibFreeStringContents(&Dest);
+    YoriLibFreePrintfFormat(&Compiled);
+    return TRUE;
+}
+
+// vim:sw=4:ts=4:et:
@@ -0,0 +1,166 @@
+/**
+ * @file test/regex.c
+ *
+ * Yori shell test regular expression routines
+ *
+ * Copyright (c) 2026 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <yoripch.h>
+#include <yorilib.h>
+#include "test.h"
+
+/**
+ A single regular expression search and its expected result.
+ */
+typedef struct _TEST_REGEX_CASE {
+
+    /**
+     The regular expression to compile.
+     */
+    LPCTSTR Pattern;
+
+    /**
+     The string to search within.
+     */
+    LPCTSTR String;
+
+    /**
+     TRUE if the regular expression should be compiled case insensitively.
+     */
+    BOOLEAN Insensitive;
+
+    /**
+     The expected offset of the match, or -1 if no match should be found.
+     */
+    INT ExpectedOffset;
+
+    /**
+     The expected length of the match.
+     */
+    INT ExpectedLength;
+} TEST_REGEX_CASE, *PTEST_REGEX_CASE;
+
+/**
+ Regular expressions to search for and the expected results.
+ */
+TEST_REGEX_CASE TestRegexCases[] = {
+    {_T("abc"),          _T("xxabcxx"),      FALSE,  2,  3},
+    {_T("ABC"),          _T("xxabcxx"),      FALSE, -1,  0},
+    {_T("ABC"),          _T("xxabcxx"),      TRUE,   2,  3},
+    {_T("a.c"),          _T("abc adc"),      FALSE,  0,  3},
+    {_T("a*"),           _T("bbb"),          FALSE,  0,  0},
+    {_T("a+"),           _T("baaab"),        FALSE,  1,  3},
+    {_T("colou?r"),      _T("the color"),    FALSE,  4,  5},
+    {_T("(ab)+"),        _T("xababab"),      FALSE,  1,  6},
+    {_T("(?:cat|dog)s"), _T("hot dogs"),     FALSE,  4,  4},
+    {_T("a|ab|abc"),     _T("abcd"),         FALSE,  0,  3},
+    {_T("[0-9]+"),       _T("abc 1234 x"),   FALSE,  4,  4},
+    {_T("[^a-z ]+"),     _T("abc DEF"),      FALSE,  4,  3},
+    {_T("[a-f]+"),       _T("XYZ CAFE"),     TRUE,   4,  4},
+    {_T("\\d{2,3}"),     _T("1 12345"),      FALSE,  2,  3},
+    {_T("x{3}"),         _T("xx xxxx"),      FALSE,  3,  3},
+    {_T("a{2,1}"),       _T("aa a{2,1}"),    FALSE,  3,  6},
+    {_T("\\w+"),         _T("  foo_1 "),     FALSE,  2,  5},
+    {_T("\\s+\\S"),      _T("a   b"),        FALSE,  1,  4},
+    {_T("\\bis\\b"),     _T("this is it"),   FALSE,  5,  2},
+    {_T("\\Bis"),        _T("is this"),      FALSE,  5,  2},
+    {_T("^ab"),          _T("abab"),         FALSE,  0,  2},
+    {_T("ab$"),          _T("abab"),         FALSE,  2,  2},
+    {_T("^$"),           _T(""),             FALSE,  0,  0},
+    {_T("\\.\\*"),       _T("a.*b"),         FALSE,  1,  2},
+    {_T("\\x41"),        _T("zA"),           FALSE,  1,  1},
+    {_T("(x+x+)+y"),     _T("xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx"), FALSE, -1, 0},
+    {_T("(a?){20}a{20}"), _T("aaaaaaaaaaaaaaaaaaaa"), FALSE, 0, 20},
+};
+
+/**
+ Regular expressions which are not valid, or which are too large, and should
+ fail to compile.
+ */
+LPCTSTR TestRegexInvalid[] = {
+    _T("(abc"),
+    _T("abc)"),
+    _T("[abc"),
+    _T("*a"),
+    _T("(a{1000}){1000}"),
+    _T("\\"),
+};
+
+/**
+ A test variation to check that regular expressions find the expected
+ matches, including expressions which would take exponential time with a
+ backtracking implementation, and that invalid expressions are rejected.
+ */
+BOOLEAN
+TestRegex(VOID)
+{
+    YORI_LIB_REGEX Regex;
+    YORI_STRING Pattern;
+    YORI_STRING String;
+    YORI_ALLOC_SIZE_T Index;
+    YORI_ALLOC_SIZE_T MatchOffset;
+    YORI_ALLOC_SIZE_T MatchLength;
+    PTEST_REGEX_CASE Case;
+    BOOLEAN Found;
+
+    for (Index = 0; Index < sizeof(TestRegexCases)/sizeof(TestRegexCases[0]); Index++) {
+        Case = &TestRegexCases[Index];
+        YoriLibConstantString(&Pattern, Case->Pattern);
+        YoriLibConstantString(&String, Case->String);
+
+        if (!YoriLibRegexCompile(&Regex, &Pattern, Case->Insensitive, NULL)) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i YoriLibRegexCompile failed for %y\n"), __FILE__, __LINE__, &Pattern);
+            return FALSE;
+        }
+
+        MatchOffset = 0;
+        MatchLength = 0;
+        Found = (BOOLEAN)YoriLibRegexSearch(&Regex, &String, 0, &MatchOffset, &MatchLength);
+        YoriLibRegexCleanup(&Regex);
+
+        if (Case->ExpectedOffset == -1) {
+            if (Found) {
+                YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i %y unexpectedly found in %y at %i\n"), __FILE__, __LINE__, &Pattern, &String, MatchOffset);
+                return FALSE;
+            }
+        } else if (!Found ||
+                   MatchOffset != (YORI_ALLOC_SIZE_T)Case->ExpectedOffset ||
+                   MatchLength != (YORI_ALLOC_SIZE_T)Case->ExpectedLength) {
+
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i %y in %y: expected %i length %i, found %i length %i\n"), __FILE__, __LINE__, &Pattern, &String, Case->ExpectedOffset, Case->ExpectedLength, Found?(int)MatchOffset:-1, MatchLength);
+            return FALSE;
+        }
+    }
+
+    for (Index = 0; Index < sizeof(TestRegexInvalid)/sizeof(TestRegexInvalid[0]); Index++) {
+        YoriLibConstantString(&Pattern, TestRegexInvalid[Index]);
+        if (YoriLibRegexCompile(&Regex, &Pattern, FALSE, NULL)) {
+            YoriLibRegexCleanup(&Regex);
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i invalid expression %y compiled\n"), __FILE__, __LINE__, &Pattern);
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+// vim:sw=4:ts=4:et:
@@ -0,0 +1,179 @@
+/**
+ * @file test/strmatch.c
+ *
+ * Yori shell test substring matcher routines
+ *
+ * Copyright (c) 2026 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <yoripch.h>
+#include <yorilib.h>
+#include "test.h"
+
+/**
+ Strings to search for.  These overlap so that one match string is a suffix
+ or prefix of another, and include an empty string.
+ */
+LPCTSTR TestSubstringMatchStrings[] = {
+    _T("he"),
+    _T("she"),
+    _T("his"),
+    _T("hers"),
+    _T("ERS"),
+    _T("s"),
+    _T(""),
+};
+
+/**
+ Strings to search within.
+ */
+LPCTSTR TestSubstringSearchStrings[] = {
+    _T(""),
+    _T("x"),
+    _T("ushers"),
+    _T("USHERS"),
+    _T("this is his"),
+    _T("abcdefg"),
+    _T("Hers and his"),
+    _T("sshhee"),
+};
+
+/**
+ Compare the result of a substring matcher with searching for each string
+ directly.
+
+ @param NumberMatches The number of strings to search for.
+
+ @param MatchArray The strings to search for.
+
+ @param Insensitive TRUE to search case insensitively.
+
+ @return TRUE if every search returned the same result, FALSE if not.
+ */
+BOOLEAN
+TestSubstringMatcherCompare(
+    __in YORI_ALLOC_SIZE_T NumberMatches,
+    __in PYORI_STRING MatchArray,
+    __in BOOLEAN Insensitive
+    )
+{
+    YORI_LIB_SUBSTRING_MATCHER Matcher;
+    YORI_STRING String;
+    PYORI_STRING Expected;
+    PYORI_STRING Found;
+    YORI_ALLOC_SIZE_T ExpectedOffset;
+    YORI_ALLOC_SIZE_T FoundOffset;
+    YORI_ALLOC_SIZE_T Index;
+    YORI_ALLOC_SIZE_T MatchIndex;
+    BOOLEAN Result;
+
+    if (!YoriLibSubstringMatcherInitialize(&Matcher, NumberMatches, MatchArray, Insensitive)) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i YoriLibSubstringMatcherInitialize failed\n"), __FILE__, __LINE__);
+        return FALSE;
+    }
+
+    Result = FALSE;
+    for (Index = 0; Index < sizeof(TestSubstringSearchStrings)/sizeof(TestSubstringSearchStrings[0]); Index++) {
+        YoriLibConstantString(&String, TestSubstringSearchStrings[Index]);
+
+        //
+        //  Check the earliest match in the string.
+        //
+
+        if (Insensitive) {
+            Expected = YoriLibFindFirstMatchSubstrIns(&String, NumberMatches, MatchArray, &ExpectedOffset);
+        } else {
+            Expected = YoriLibFindFirstMatchSubstr(&String, NumberMatches, MatchArray, &ExpectedOffset);
+        }
+        Found = YoriLibSubstringMatcherFindFirst(&Matcher, &String, &FoundOffset);
+
+        if (Expected != Found || ExpectedOffset != FoundOffset) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i first match in %y differs: expected %i at %i, found %i at %i\n"), __FILE__, __LINE__, &String, Expected == NULL?-1:(int)(Expected - MatchArray), ExpectedOffset, Found == NULL?-1:(int)(Found - MatchArray), FoundOffset);
+            goto Exit;
+        }
+
+        //
+        //  Check the first match string, in array order, that occurs
+        //  anywhere in the string.
+        //
+
+        Expected = NULL;
+        ExpectedOffset = 0;
+        for (MatchIndex = 0; MatchIndex < NumberMatches; MatchIndex++) {
+            if (Insensitive) {
+                Expected = YoriLibFindFirstMatchSubstrIns(&String, 1, &MatchArray[MatchIndex], &ExpectedOffset);
+            } else {
+                Expected = YoriLibFindFirstMatchSubstr(&String, 1, &MatchArray[MatchIndex], &ExpectedOffset);
+            }
+            if (Expected != NULL) {
+                break;
+            }
+        }
+        Found = YoriLibSubstringMatcherFindByPriority(&Matcher, &String, &FoundOffset);
+
+        if (Expected != Found || ExpectedOffset != FoundOffset) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("%hs:%i priority match in %y differs: expected %i at %i, found %i at %i\n"), __FILE__, __LINE__, &String, Expected == NULL?-1:(int)(Expected - MatchArray), ExpectedOffset, Found == NULL?-1:(int)(Found - MatchArray), FoundOffset);
+            goto Exit;
+        }
+    }
+
+    Result = TRUE;
+
+Exit:
+    YoriLibSubstringMatcherCleanup(&Matcher);
+    return Result;
+}
+
+/**
+ A test variation to check that searching with a substring matcher returns
+ the same result as searching for each string directly, for every subset of
+ a set of overlapping strings and with and without case sensitivity.
+ */
+BOOLEAN
+TestSubstringMatcher(VOID)
+{
+    YORI_STRING MatchArray[sizeof(TestSubstringMatchStrings)/sizeof(TestSubstringMatchStrings[0])];
+    YORI_ALLOC_SIZE_T TotalCount;
+    YORI_ALLOC_SIZE_T Count;
+    YORI_ALLOC_SIZE_T Index;
+    DWORD Subset;
+
+    TotalCount = sizeof(TestSubstringMatchStrings)/sizeof(TestSubstringMatchStrings[0]);
+
+    for (Subset = 1; Subset < (1UL << TotalCount); Subset++) {
+        Count = 0;
+        for (Index = 0; Index < TotalCount; Index++) {
+            if (Subset & (1 << Index)) {
+                YoriLibConstantString(&MatchArray[Count], TestSubstringMatchStrings[Index]);
+                Count++;
+            }
+        }
+
+        if (!TestSubstringMatcherCompare(Count, MatchArray, FALSE) ||
+            !TestSubstringMatcherCompare(Count, MatchArray, TRUE)) {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+// vim:sw=4:ts=4:et:
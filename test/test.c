@@ -79,6 +79,15 @@ typedef struct _TEST_VARIATION {
 TEST_VARIATION TestVariations[] = {
     {TestEnumRoot,                         _T("EnumRoot")},
     {TestEnumWindows,                      _T("EnumWindows")},
+    {TestEnumRecurseParallel,              _T("EnumRecurseParallel")},
+    {TestHashGrow,                         _T("HashGrow")},
+    {TestHashKeyCase,                      _T("HashKeyCase")},
+    {TestSubstringMatcher,                 _T("SubstringMatcher")},
+    {TestRegex,                            _T("Regex")},
+    {TestPrintfFormat,                     _T("PrintfFormat")},
+    {TestPrintfTruncate,                   _T("PrintfTruncate")},
+    {TestPoolSizeClasses,                  _T("PoolSizeClasses")},
+    {TestPoolCrossThread,                  _T("PoolCrossThread")},
     {TestParseTwoArgCmd,                   _T("ParseTwoArgCmd")},
     {TestParseOneArgContainingQuotesCmd,   _T("ParseOneArgContainingQuotesCmd")},
     {TestParseOneArgEnclosedInQuotesCmd,   _T("ParseOneArgEnclosedInQuotesCmd")},
@@ -46,6 +46,57 @@ YORI_TEST_FN TestEnumRoot;
  */
 YORI_TEST_FN TestEnumWindows;
 
+/**
+ A test variation to recursively enumerate files on multiple threads.
+ */
+YORI_TEST_FN TestEnumRecurseParallel;
+
+/**
+ A test variation to insert enough entries into a hash table to cause it to
+ grow.
+ */
+YORI_TEST_FN TestHashGrow;
+
+/**
+ A test variation to check that hashing a key is insensitive to case for
+ every length and alignment of key.
+ */
+YORI_TEST_FN TestHashKeyCase;
+
+/**
+ A test variation to compare searching with a substring matcher to searching
+ for each string directly.
+ */
+YORI_TEST_FN TestSubstringMatcher;
+
+/**
+ A test variation to search for regular expressions and check the result.
+ */
+YORI_TEST_FN TestRegex;
+
+/**
+ A test variation to format numbers and strings with and without widths,
+ checking that a compiled format produces the same result as a format that
+ is parsed on each call.
+ */
+YORI_TEST_FN TestPrintfFormat;
+
+/**
+ A test variation to format into buffers that are too small.
+ */
+YORI_TEST_FN TestPrintfTruncate;
+
+/**
+ A test variation to allocate and free a block of every size serviced by the
+ pool.
+ */
+YORI_TEST_FN TestPoolSizeClasses;
+
+/**
+ A test variation to allocate blocks on one thread and free them on another.
+ */
+YORI_TEST_FN TestPoolCrossThread;
+
 /**
  A test variation to parse a command with two space delimited arguments.
  */
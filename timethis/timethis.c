@@ -29,6 +29,7 @@
 #ifdef YORI_BUILTIN
 #include <yoricall.h>
 #endif
+#include "timethis.h"
 
 /**
  Help text to display to the user.
@@ -38,7 +39,18 @@ CHAR strTimeThisHelpText[] =
         "\n"
         "Runs a child program and times its execution.\n"
         "\n"
-        "TIMETHIS [-license] [-f <fmt>] <command>\n"
+        "TIMETHIS [-license] [-f <fmt>] [-json] [-m] [-n <count>] [-prepare <cmd>]\n"
+        "         [-q] [-trace] [-warmup <count>] <command>\n"
+        "\n"
+        "   -f             Specify a format string for the result of a single run\n"
+        "   -json          Display statistics in JSON form\n"
+        "   -m             Display statistics in comma separated form\n"
+        "   -n             Run the command multiple times and display statistics\n"
+        "   -prepare       Run a command before each run of the command without\n"
+        "                    measuring it\n"
+        "   -q             Discard output from the command\n"
+        "   -trace         Trace file I/O and image loads by all child processes\n"
+        "   -warmup        Run the command this many times before measuring\n"
         "\n"
         "Format specifiers are:\n"
         "   $CHILDCPU$         Amount of CPU time used by the child process\n"
@@ -53,8 +65,15 @@ CHAR strTimeThisHelpText[] =
         "   $TREECPUMS$        Amount of CPU time used by all child processes in ms\n"
         "   $TREEKERNEL$       Amount of kernel time used by all child processes\n"
         "   $TREEKERNELMS$     Amount of kernel time used by all child processes in ms\n"
+        "   $TREEPAGEFAULTS$   Number of page faults incurred by all child processes\n"
+        "   $TREEPEAKCOMMIT$   Largest memory committed by all child processes in bytes\n"
+        "   $TREEPROCESSES$    Number of child processes launched\n"
+        "   $TREEREADBYTES$    Number of bytes read by all child processes\n"
+        "   $TREEREADOPS$      Number of read operations by all child processes\n"
         "   $TREEUSER$         Amount of user time used by all child processes\n"
-        "   $TREEUSERMS$       Amount of user time used by all child processes in ms\n";
+        "   $TREEUSERMS$       Amount of user time used by all child processes in ms\n"
+        "   $TREEWRITEBYTES$   Number of bytes written by all child processes\n"
+        "   $TREEWRITEOPS$     Number of write operations by all child processes\n";
 
 /**
  Display usage text to the user.
@@ -192,6 +211,17 @@ typedef struct _TIMETHIS_CONTEXT {
      Amount of time taken to execute the child process.
      */
     LARGE_INTEGER WallTimeInMs;
+
+    /**
+     The largest working set of the immediate child process, in bytes.
+     */
+    DWORDLONG PeakWorkingSet;
+
+    /**
+     The resources consumed by the child process tree.  This is only
+     populated if a job object could be used to track the tree.
+     */
+    YORI_LIB_JOB_ACCOUNTING TreeAccounting;
 } TIMETHIS_CONTEXT, *PTIMETHIS_CONTEXT;
 
 /**
@@ -218,6 +248,7 @@ TimeThisExpandVariables(
     )
 {
     LARGE_INTEGER CpuTime;
+    LARGE_INTEGER Count;
     PTIMETHIS_CONTEXT TimeThisContext = (PTIMETHIS_CONTEXT)Context;
 
     if (YoriLibCompareStringLit(VariableName, _T("CHILDCPU")) == 0) {
@@ -248,14 +279,608 @@ TimeThisExpandVariables(
         return TimeThisOutputTimestamp(TimeThisContext->KernelTimeTreeInMs, OutputBuffer);
     } else if (YoriLibCompareStringLit(VariableName, _T("TREEKERNELMS")) == 0) {
         return TimeThisOutputLargeInteger(TimeThisContext->KernelTimeTreeInMs, 10, OutputBuffer);
+    } else if (YoriLibCompareStringLit(VariableName, _T("TREEPAGEFAULTS")) == 0) {
+        Count.QuadPart = TimeThisContext->TreeAccounting.TotalPageFaultCount;
+        return TimeThisOutputLargeInteger(Count, 10, OutputBuffer);
+    } else if (YoriLibCompareStringLit(VariableName, _T("TREEPEAKCOMMIT")) == 0) {
+        Count.QuadPart = (LONGLONG)TimeThisContext->TreeAccounting.PeakJobCommit;
+        return TimeThisOutputLargeInteger(Count, 10, OutputBuffer);
+    } else if (YoriLibCompareStringLit(VariableName, _T("TREEPROCESSES")) == 0) {
+        Count.QuadPart = TimeThisContext->TreeAccounting.TotalProcesses;
+        return TimeThisOutputLargeInteger(Count, 10, OutputBuffer);
+    } else if (YoriLibCompareStringLit(VariableName, _T("TREEREADBYTES")) == 0) {
+        Count.QuadPart = (LONGLONG)TimeThisContext->TreeAccounting.IoCounters.ReadBytes;
+        return TimeThisOutputLargeInteger(Count, 10, OutputBuffer);
+    } else if (YoriLibCompareStringLit(VariableName, _T("TREEREADOPS")) == 0) {
+        Count.QuadPart = (LONGLONG)TimeThisContext->TreeAccounting.IoCounters.ReadOperations;
+        return TimeThisOutputLargeInteger(Count, 10, OutputBuffer);
     } else if (YoriLibCompareStringLit(VariableName, _T("TREEUSER")) == 0) {
         return TimeThisOutputTimestamp(TimeThisContext->UserTimeTreeInMs, OutputBuffer);
     } else if (YoriLibCompareStringLit(VariableName, _T("TREEUSERMS")) == 0) {
         return TimeThisOutputLargeInteger(TimeThisContext->UserTimeTreeInMs, 10, OutputBuffer);
+    } else if (YoriLibCompareStringLit(VariableName, _T("TREEWRITEBYTES")) == 0) {
+        Count.QuadPart = (LONGLONG)TimeThisContext->TreeAccounting.IoCounters.WriteBytes;
+        return TimeThisOutputLargeInteger(Count, 10, OutputBuffer);
+    } else if (YoriLibCompareStringLit(VariableName, _T("TREEWRITEOPS")) == 0) {
+        Count.QuadPart = (LONGLONG)TimeThisContext->TreeAccounting.IoCounters.WriteOperations;
+        return TimeThisOutputLargeInteger(Count, 10, OutputBuffer);
     }
     return 0;
 }
 
+/**
+ Launch a child process, wait for it to complete, and record the resources
+ it consumed.
+
+ @param CmdLine The command line of the child process to launch.
+
+ @param OutputHandle Optionally points to a handle to use as the standard
+        output and standard error of the child process.  If NULL, the child
+        inherits the handles of this process.
+
+ @param TimeThisContext On successful completion, populated with the
+        resources consumed by the child process and its tree.
+
+ @param ExitCode On successful completion, populated with the exit code of
+        the child process.
+
+ @return TRUE to indicate the child process was executed, FALSE if it could
+         not be launched or the wait was cancelled.
+ */
+__success(return)
+BOOL
+TimeThisExecute(
+    __in PYORI_STRING CmdLine,
+    __in_opt HANDLE OutputHandle,
+    __out PTIMETHIS_CONTEXT TimeThisContext,
+    __out PDWORD ExitCode
+    )
+{
+    PROCESS_INFORMATION ProcessInfo;
+    STARTUPINFO StartupInfo;
+    HANDLE hJob;
+    FILETIME ftCreationTime;
+    FILETIME ftExitTime;
+    FILETIME ftKernelTime;
+    FILETIME ftUserTime;
+    LARGE_INTEGER liCreationTime;
+    LARGE_INTEGER liExitTime;
+
+    ZeroMemory(TimeThisContext, sizeof(TIMETHIS_CONTEXT));
+
+    hJob = YoriLibCreateJobObject();
+
+    memset(&StartupInfo, 0, sizeof(StartupInfo));
+    StartupInfo.cb = sizeof(StartupInfo);
+    if (OutputHandle != NULL) {
+        StartupInfo.dwFlags = STARTF_USESTDHANDLES;
+        StartupInfo.hStdInput = GetStdHandle(STD_INPUT_HANDLE);
+        StartupInfo.hStdOutput = OutputHandle;
+        StartupInfo.hStdError = OutputHandle;
+    }
+
+    if (!CreateProcess(NULL, CmdLine->StartOfString, NULL, NULL, TRUE, CREATE_SUSPENDED | CREATE_DEFAULT_ERROR_MODE, NULL, NULL, &StartupInfo, &ProcessInfo)) {
+        DWORD LastError = GetLastError();
+        LPTSTR ErrText = YoriLibGetWinErrorText(LastError);
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("timethis: execution failed: %s"), ErrText);
+        YoriLibFreeWinErrorText(ErrText);
+        if (hJob != NULL) {
+            CloseHandle(hJob);
+        }
+        return FALSE;
+    }
+
+    if (hJob != NULL) {
+        YoriLibAssignProcessToJobObject(hJob, ProcessInfo.hProcess);
+    }
+
+    ResumeThread(ProcessInfo.hThread);
+
+    //
+    //  Wait for the immediate child process to terminate.
+    //
+
+#if YORI_BUILTIN
+    {
+        HANDLE HandleArray[2];
+        DWORD WaitResult;
+
+        YoriLibCancelEnable(FALSE);
+        HandleArray[1] = YoriLibCancelGetEvent();
+        HandleArray[0] = ProcessInfo.hProcess;
+
+        WaitResult = WaitForMultipleObjectsEx(2, HandleArray, FALSE, INFINITE, FALSE);
+
+        //
+        //  If cancelled, abort
+        //
+
+        if (WaitResult == WAIT_OBJECT_0 + 1) {
+            CloseHandle(ProcessInfo.hProcess);
+            CloseHandle(ProcessInfo.hThread);
+            if (hJob != NULL) {
+                CloseHandle(hJob);
+            }
+
+            return FALSE;
+        }
+    }
+#else
+    WaitForSingleObject(ProcessInfo.hProcess, INFINITE);
+#endif
+    GetExitCodeProcess(ProcessInfo.hProcess, ExitCode);
+
+    //
+    //  Save off times from the child process.
+    //
+
+    GetProcessTimes(ProcessInfo.hProcess, &ftCreationTime, &ftExitTime, &ftKernelTime, &ftUserTime);
+
+    liCreationTime.HighPart = ftCreationTime.dwHighDateTime;
+    liCreationTime.LowPart = ftCreationTime.dwLowDateTime;
+    liExitTime.HighPart = ftExitTime.dwHighDateTime;
+    liExitTime.LowPart = ftExitTime.dwLowDateTime;
+    TimeThisContext->KernelTimeInMs.HighPart = ftKernelTime.dwHighDateTime;
+    TimeThisContext->KernelTimeInMs.LowPart = ftKernelTime.dwLowDateTime;
+    TimeThisContext->KernelTimeInMs.QuadPart = TimeThisContext->KernelTimeInMs.QuadPart / (10 * 1000);
+    TimeThisContext->UserTimeInMs.HighPart = ftUserTime.dwHighDateTime;
+    TimeThisContext->UserTimeInMs.LowPart = ftUserTime.dwLowDateTime;
+    TimeThisContext->UserTimeInMs.QuadPart = TimeThisContext->UserTimeInMs.QuadPart / (10 * 1000);
+
+    TimeThisContext->WallTimeInMs.QuadPart = (liExitTime.QuadPart - liCreationTime.QuadPart) / (10 * 1000);
+
+    //
+    //  The process object retains its memory counters after it exits, so
+    //  the peak working set can be queried now.
+    //
+
+    if (DllPsapi.pGetProcessMemoryInfo != NULL) {
+        YORI_PROCESS_MEMORY_COUNTERS MemoryCounters;
+
+        ZeroMemory(&MemoryCounters, sizeof(MemoryCounters));
+        MemoryCounters.cb = sizeof(MemoryCounters);
+        if (DllPsapi.pGetProcessMemoryInfo(ProcessInfo.hProcess, &MemoryCounters, sizeof(MemoryCounters))) {
+            TimeThisContext->PeakWorkingSet = MemoryCounters.PeakWorkingSetSize;
+        }
+    }
+
+    //
+    //  Save off times from all processes within the job, if it exists.
+    //  Note that currently we're not waiting for all processes within the
+    //  job to terminate.
+    //
+
+    TimeThisContext->KernelTimeTreeInMs.QuadPart = TimeThisContext->KernelTimeInMs.QuadPart;
+    TimeThisContext->UserTimeTreeInMs.QuadPart = TimeThisContext->UserTimeInMs.QuadPart;
+
+    if (hJob != NULL) {
+        if (YoriLibQueryJobObjectAccounting(hJob, &TimeThisContext->TreeAccounting)) {
+            TimeThisContext->KernelTimeTreeInMs.QuadPart = TimeThisContext->TreeAccounting.TotalKernelTime.QuadPart / (10 * 1000);
+            TimeThisContext->UserTimeTreeInMs.QuadPart = TimeThisContext->TreeAccounting.TotalUserTime.QuadPart / (10 * 1000);
+        }
+        CloseHandle(hJob);
+    }
+
+    CloseHandle(ProcessInfo.hProcess);
+    CloseHandle(ProcessInfo.hThread);
+
+    return TRUE;
+}
+
+/**
+ Indexes for each measurement recorded when running a command repeatedly.
+ */
+typedef enum _TIMETHIS_METRIC {
+    TimeThisMetricElapsed = 0,
+    TimeThisMetricTreeUser,
+    TimeThisMetricTreeKernel,
+    TimeThisMetricPeakWorkingSet,
+    TimeThisMetricPeakCommit,
+    TimeThisMetricPageFaults,
+    TimeThisMetricProcesses,
+    TimeThisMetricReadOperations,
+    TimeThisMetricWriteOperations,
+    TimeThisMetricOtherOperations,
+    TimeThisMetricReadBytes,
+    TimeThisMetricWriteBytes,
+    TimeThisMetricCount
+} TIMETHIS_METRIC;
+
+/**
+ Names of each measurement for display.  These are padded so values align.
+ */
+CONST LPCTSTR TimeThisMetricDisplayNames[TimeThisMetricCount] = {
+    _T("Elapsed time (ms)       "),
+    _T("Tree user time (ms)     "),
+    _T("Tree kernel time (ms)   "),
+    _T("Child peak working set  "),
+    _T("Tree peak commit        "),
+    _T("Tree page faults        "),
+    _T("Tree processes          "),
+    _T("Tree read operations    "),
+    _T("Tree write operations   "),
+    _T("Tree other operations   "),
+    _T("Tree bytes read         "),
+    _T("Tree bytes written      ")
+};
+
+/**
+ Names of each measurement for comma separated output.
+ */
+CONST LPCTSTR TimeThisMetricMachineNames[TimeThisMetricCount] = {
+    _T("ElapsedMs"),
+    _T("TreeUserMs"),
+    _T("TreeKernelMs"),
+    _T("ChildPeakWorkingSet"),
+    _T("TreePeakCommit"),
+    _T("TreePageFaults"),
+    _T("TreeProcesses"),
+    _T("TreeReadOperations"),
+    _T("TreeWriteOperations"),
+    _T("TreeOtherOperations"),
+    _T("TreeReadBytes"),
+    _T("TreeWriteBytes")
+};
+
+/**
+ Statistics describing a set of samples for a single measurement.
+ */
+typedef struct _TIMETHIS_STATISTICS {
+
+    /**
+     The smallest sample.
+     */
+    DWORDLONG Min;
+
+    /**
+     The median sample.
+     */
+    DWORDLONG Median;
+
+    /**
+     The 95th percentile sample.
+     */
+    DWORDLONG P95;
+
+    /**
+     The largest sample.
+     */
+    DWORDLONG Max;
+
+    /**
+     The population standard deviation of the samples.
+     */
+    DWORDLONG StdDev;
+} TIMETHIS_STATISTICS, *PTIMETHIS_STATISTICS;
+
+/**
+ The form used to display statistics across multiple runs.
+ */
+typedef enum _TIMETHIS_STATISTICS_FORMAT {
+    TimeThisStatisticsTable = 0,
+    TimeThisStatisticsCsv,
+    TimeThisStatisticsJson
+} TIMETHIS_STATISTICS_FORMAT;
+
+/**
+ Record the measurements from a single run into the sample array.
+
+ @param TimeThisContext Pointer to the measurements from the run.
+
+ @param Samples Pointer to an array of samples, consisting of RunCount
+        samples for each measurement.
+
+ @param RunCount The number of measured runs.
+
+ @param RunIndex The index of this run.
+ */
+VOID
+TimeThisRecordSamples(
+    __in PTIMETHIS_CONTEXT TimeThisContext,
+    __inout PDWORDLONG Samples,
+    __in YORI_ALLOC_SIZE_T RunCount,
+    __in YORI_ALLOC_SIZE_T RunIndex
+    )
+{
+    Samples[TimeThisMetricElapsed * RunCount + RunIndex] = (DWORDLONG)TimeThisContext->WallTimeInMs.QuadPart;
+    Samples[TimeThisMetricTreeUser * RunCount + RunIndex] = (DWORDLONG)TimeThisContext->UserTimeTreeInMs.QuadPart;
+    Samples[TimeThisMetricTreeKernel * RunCount + RunIndex] = (DWORDLONG)TimeThisContext->KernelTimeTreeInMs.QuadPart;
+    Samples[TimeThisMetricPeakWorkingSet * RunCount + RunIndex] = TimeThisContext->PeakWorkingSet;
+    Samples[TimeThisMetricPeakCommit * RunCount + RunIndex] = TimeThisContext->TreeAccounting.PeakJobCommit;
+    Samples[TimeThisMetricPageFaults * RunCount + RunIndex] = TimeThisContext->TreeAccounting.TotalPageFaultCount;
+    Samples[TimeThisMetricProcesses * RunCount + RunIndex] = TimeThisContext->TreeAccounting.TotalProcesses;
+    Samples[TimeThisMetricReadOperations * RunCount + RunIndex] = TimeThisContext->TreeAccounting.IoCounters.ReadOperations;
+    Samples[TimeThisMetricWriteOperations * RunCount + RunIndex] = TimeThisContext->TreeAccounting.IoCounters.WriteOperations;
+    Samples[TimeThisMetricOtherOperations * RunCount + RunIndex] = TimeThisContext->TreeAccounting.IoCounters.OtherOperations;
+    Samples[TimeThisMetricReadBytes * RunCount + RunIndex] = TimeThisContext->TreeAccounting.IoCounters.ReadBytes;
+    Samples[TimeThisMetricWriteBytes * RunCount + RunIndex] = TimeThisContext->TreeAccounting.IoCounters.WriteBytes;
+}
+
+/**
+ Calculate the integer square root of a value.
+
+ @param Value The value to calculate the square root of.
+
+ @return The largest integer whose square is less than or equal to Value.
+ */
+DWORDLONG
+TimeThisSquareRoot(
+    __in DWORDLONG Value
+    )
+{
+    DWORDLONG Root;
+    DWORDLONG Bit;
+
+    Root = 0;
+    Bit = ((DWORDLONG)1) << 62;
+    while (Bit > Value) {
+        Bit = Bit >> 2;
+    }
+
+    while (Bit != 0) {
+        if (Value >= Root + Bit) {
+            Value = Value - (Root + Bit);
+            Root = (Root >> 1) + Bit;
+        } else {
+            Root = Root >> 1;
+        }
+        Bit = Bit >> 2;
+    }
+
+    return Root;
+}
+
+/**
+ Calculate statistics for a set of samples.  The samples are sorted as a
+ side effect.
+
+ @param Samples Pointer to an array of samples.
+
+ @param Count The number of samples in the array.  This must be nonzero.
+
+ @param Statistics On completion, populated with statistics describing the
+        samples.
+ */
+VOID
+TimeThisCalculateStatistics(
+    __inout PDWORDLONG Samples,
+    __in YORI_ALLOC_SIZE_T Count,
+    __out PTIMETHIS_STATISTICS Statistics
+    )
+{
+    YORI_ALLOC_SIZE_T Index;
+    YORI_ALLOC_SIZE_T InsertIndex;
+    DWORDLONG Value;
+    DWORDLONG Sum;
+    DWORDLONG Mean;
+    DWORDLONG Difference;
+    DWORDLONG Variance;
+
+    //
+    //  The number of runs is small, so an insertion sort suffices.
+    //
+
+    for (Index = 1; Index < Count; Index++) {
+        Value = Samples[Index];
+        InsertIndex = Index;
+        while (InsertIndex > 0 && Samples[InsertIndex - 1] > Value) {
+            Samples[InsertIndex] = Samples[InsertIndex - 1];
+            InsertIndex--;
+        }
+        Samples[InsertIndex] = Value;
+    }
+
+    Statistics->Min = Samples[0];
+    Statistics->Max = Samples[Count - 1];
+    if (Count % 2 == 0) {
+        Statistics->Median = (Samples[Count / 2 - 1] + Samples[Count / 2]) / 2;
+    } else {
+        Statistics->Median = Samples[Count / 2];
+    }
+
+    //
+    //  Use the nearest rank method, so the 95th percentile is the smallest
+    //  sample that is at least as large as 95% of the samples.
+    //
+
+    Statistics->P95 = Samples[(YORI_ALLOC_SIZE_T)(((DWORDLONG)Count * 95 + 99) / 100 - 1)];
+
+    Sum = 0;
+    for (Index = 0; Index < Count; Index++) {
+        Sum = Sum + Samples[Index];
+    }
+    Mean = Sum / Count;
+
+    //
+    //  Divide each squared difference as it is accumulated so large
+    //  values, such as byte counts, don't overflow the sum.
+    //
+
+    Variance = 0;
+    for (Index = 0; Index < Count; Index++) {
+        if (Samples[Index] > Mean) {
+            Difference = Samples[Index] - Mean;
+        } else {
+            Difference = Mean - Samples[Index];
+        }
+        Variance = Variance + Difference * Difference / Count;
+    }
+
+    Statistics->StdDev = TimeThisSquareRoot(Variance);
+}
+
+/**
+ Display statistics for each measurement across all measured runs.
+
+ @param Samples Pointer to an array of samples, consisting of RunCount
+        samples for each measurement.  The samples are sorted as a side
+        effect.
+
+ @param RunCount The number of measured runs.
+
+ @param WarmupCount The number of runs performed before measuring.
+
+ @param Format Specifies whether to display statistics in a table, in
+        comma separated form, or in JSON form.
+ */
+VOID
+TimeThisDisplayStatistics(
+    __inout PDWORDLONG Samples,
+    __in YORI_ALLOC_SIZE_T RunCount,
+    __in YORI_ALLOC_SIZE_T WarmupCount,
+    __in TIMETHIS_STATISTICS_FORMAT Format
+    )
+{
+    TIMETHIS_STATISTICS Statistics;
+    DWORD Metric;
+
+    if (Format == TimeThisStatisticsCsv) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("Metric,Runs,Min,Median,P95,Max,StdDev\n"));
+    } else if (Format == TimeThisStatisticsJson) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("{\n  \"Runs\": %i,\n  \"Warmup\": %i,\n  \"Metrics\": {\n"), RunCount, WarmupCount);
+    } else {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("Runs: %i (after %i warmup)\n\n"), RunCount, WarmupCount);
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("                                 Min       Median          P95          Max       StdDev\n"));
+    }
+
+    for (Metric = 0; Metric < TimeThisMetricCount; Metric++) {
+        TimeThisCalculateStatistics(&Samples[Metric * RunCount], RunCount, &Statistics);
+        if (Format == TimeThisStatisticsCsv) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT,
+                          _T("%s,%i,%lli,%lli,%lli,%lli,%lli\n"),
+                          TimeThisMetricMachineNames[Metric],
+                          RunCount,
+                          Statistics.Min,
+                          Statistics.Median,
+                          Statistics.P95,
+                          Statistics.Max,
+                          Statistics.StdDev);
+        } else if (Format == TimeThisStatisticsJson) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT,
+                          _T("    \"%s\": {\"Min\": %lli, \"Median\": %lli, \"P95\": %lli, \"Max\": %lli, \"StdDev\": %lli}%s\n"),
+                          TimeThisMetricMachineNames[Metric],
+                          Statistics.Min,
+                          Statistics.Median,
+                          Statistics.P95,
+                          Statistics.Max,
+                          Statistics.StdDev,
+                          (Metric + 1 < TimeThisMetricCount)?_T(","):_T(""));
+        } else {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT,
+                          _T("%s%12lli %12lli %12lli %12lli %12lli\n"),
+                          TimeThisMetricDisplayNames[Metric],
+                          Statistics.Min,
+                          Statistics.Median,
+                          Statistics.P95,
+                          Statistics.Max,
+                          Statistics.StdDev);
+        }
+    }
+
+    if (Format == TimeThisStatisticsJson) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("  }\n}\n"));
+    }
+}
+
+/**
+ Build a command line to launch a child process from a set of arguments,
+ resolving the first argument to the executable to launch.
+
+ @param ArgC The number of arguments.
+
+ @param ArgV An array of arguments.  The first argument is the program to
+        launch.
+
+ @param CmdLine On successful completion, populated with the command line.
+        The caller should free this with YoriLibFreeStringContents.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+TimeThisBuildCmdLine(
+    __in YORI_ALLOC_SIZE_T ArgC,
+    __in PYORI_STRING ArgV,
+    __out PYORI_STRING CmdLine
+    )
+{
+    YORI_STRING Executable;
+    PYORI_STRING ChildArgs;
+
+    ChildArgs = YoriLibMalloc(ArgC * sizeof(YORI_STRING));
+    if (ChildArgs == NULL) {
+        return FALSE;
+    }
+
+    YoriLibInitEmptyString(&Executable);
+    if (!YoriLibLocateExecutableInPath(&ArgV[0], NULL, NULL, &Executable) ||
+        Executable.LengthInChars == 0) {
+
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("timethis: unable to find executable %y\n"), &ArgV[0]);
+        YoriLibFree(ChildArgs);
+        YoriLibFreeStringContents(&Executable);
+        return FALSE;
+    }
+
+    memcpy(&ChildArgs[0], &Executable, sizeof(YORI_STRING));
+    if (ArgC > 1) {
+        memcpy(&ChildArgs[1], &ArgV[1], (ArgC - 1) * sizeof(YORI_STRING));
+    }
+
+    if (!YoriLibBuildCmdlineFromArgcArgv(ArgC, ChildArgs, TRUE, TRUE, CmdLine)) {
+        YoriLibFree(ChildArgs);
+        YoriLibFreeStringContents(&Executable);
+        return FALSE;
+    }
+
+    ASSERT(YoriLibIsStringNullTerminated(CmdLine));
+
+    YoriLibFreeStringContents(&Executable);
+    YoriLibFree(ChildArgs);
+    return TRUE;
+}
+
+/**
+ Build a command line to launch a child process from a single string
+ containing the program to launch and its arguments.
+
+ @param String The program to launch and its arguments.
+
+ @param CmdLine On successful completion, populated with the command line.
+        The caller should free this with YoriLibFreeStringContents.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+TimeThisBuildCmdLineFromString(
+    __in PYORI_STRING String,
+    __out PYORI_STRING CmdLine
+    )
+{
+    PYORI_STRING ArgV;
+    YORI_ALLOC_SIZE_T ArgC;
+    YORI_ALLOC_SIZE_T Index;
+    BOOL Result;
+
+    ASSERT(YoriLibIsStringNullTerminated(String));
+    ArgV = YoriLibCmdlineToArgcArgv(String->StartOfString, (YORI_ALLOC_SIZE_T)-1, FALSE, &ArgC);
+    if (ArgV == NULL) {
+        return FALSE;
+    }
+
+    Result = FALSE;
+    if (ArgC > 0) {
+        Result = TimeThisBuildCmdLine(ArgC, ArgV, CmdLine);
+    }
+
+    for (Index = 0; Index < ArgC; Index++) {
+        YoriLibFreeStringContents(&ArgV[Index]);
+    }
+    YoriLibDereference(ArgV);
+    return Result;
+}
+
 #ifdef YORI_BUILTIN
 /**
  The main entrypoint for the timethis builtin command.
@@ -285,33 +910,41 @@ ENTRYPOINT(
     )
 {
     YORI_STRING CmdLine;
+    YORI_STRING PrepareCmdLine;
     DWORD ExitCode;
+    DWORD PrepareExitCode;
     BOOLEAN ArgumentUnderstood;
+    BOOLEAN Quiet = FALSE;
+    BOOLEAN Trace = FALSE;
+    TIMETHIS_STATISTICS_FORMAT Format = TimeThisStatisticsTable;
     YORI_ALLOC_SIZE_T StartArg = 0;
     YORI_ALLOC_SIZE_T i;
+    YORI_ALLOC_SIZE_T RunCount = 1;
+    YORI_ALLOC_SIZE_T WarmupCount = 0;
+    YORI_ALLOC_SIZE_T Run;
+    YORI_ALLOC_SIZE_T CharsConsumed;
+    YORI_MAX_SIGNED_T llTemp;
     YORI_STRING Arg;
     YORI_STRING DisplayString;
     YORI_STRING AllocatedFormatString;
+    PYORI_STRING PrepareCommand = NULL;
     TIMETHIS_CONTEXT TimeThisContext;
-    YORI_STRING Executable;
-    PYORI_STRING ChildArgs;
-    PROCESS_INFORMATION ProcessInfo;
-    STARTUPINFO StartupInfo;
-    HANDLE hJob;
-    FILETIME ftCreationTime;
-    FILETIME ftExitTime;
-    FILETIME ftKernelTime;
-    FILETIME ftUserTime;
-
-    LARGE_INTEGER liCreationTime;
-    LARGE_INTEGER liExitTime;
+    TIMETHIS_CONTEXT PrepareContext;
+    PDWORDLONG Samples;
+    HANDLE OutputHandle;
+    PTIMETHIS_TRACE_CONTEXT TraceContext;
     LPTSTR DefaultFormatString = _T("Elapsed time:      $ELAPSEDTIME$\n")
                                  _T("Child CPU time:    $CHILDCPU$\n")
                                  _T("Child kernel time: $CHILDKERNEL$\n")
                                  _T("Child user time:   $CHILDUSER$\n")
                                  _T("Tree CPU time:     $TREECPU$\n")
                                  _T("Tree kernel time:  $TREEKERNEL$\n")
-                                 _T("Tree user time:    $TREEUSER$\n");
+                                 _T("Tree user time:    $TREEUSER$\n")
+                                 _T("Tree processes:    $TREEPROCESSES$\n")
+                                 _T("Tree page faults:  $TREEPAGEFAULTS$\n")
+                                 _T("Tree peak commit:  $TREEPEAKCOMMIT$ bytes\n")
+                                 _T("Tree reads:        $TREEREADOPS$ ($TREEREADBYTES$ bytes)\n")
+                                 _T("Tree writes:       $TREEWRITEOPS$ ($TREEWRITEBYTES$ bytes)\n");
 
     YoriLibInitEmptyString(&AllocatedFormatString);
     YoriLibConstantString(&AllocatedFormatString, DefaultFormatString);
@@ -336,6 +969,48 @@ ENTRYPOINT(
                     ArgumentUnderstood = TRUE;
                     i++;
                 }
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("json")) == 0) {
+                Format = TimeThisStatisticsJson;
+                ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("m")) == 0) {
+                Format = TimeThisStatisticsCsv;
+                ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("n")) == 0) {
+                if (ArgC > i + 1) {
+                    if (YoriLibStringToNumber(&ArgV[i + 1], TRUE, &llTemp, &CharsConsumed) &&
+                        CharsConsumed > 0 &&
+                        llTemp > 0 &&
+                        YoriLibIsSizeAllocatable((YORI_MAX_UNSIGNED_T)llTemp * TimeThisMetricCount * sizeof(DWORDLONG))) {
+
+                        RunCount = (YORI_ALLOC_SIZE_T)llTemp;
+                        ArgumentUnderstood = TRUE;
+                        i++;
+                    }
+                }
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("prepare")) == 0) {
+                if (ArgC > i + 1) {
+                    PrepareCommand = &ArgV[i + 1];
+                    ArgumentUnderstood = TRUE;
+                    i++;
+                }
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("q")) == 0) {
+                Quiet = TRUE;
+                ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("trace")) == 0) {
+                Trace = TRUE;
+                ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("warmup")) == 0) {
+                if (ArgC > i + 1) {
+                    if (YoriLibStringToNumber(&ArgV[i + 1], TRUE, &llTemp, &CharsConsumed) &&
+                        CharsConsumed > 0 &&
+                        llTemp >= 0 &&
+                        llTemp < 0x10000) {
+
+                        WarmupCount = (YORI_ALLOC_SIZE_T)llTemp;
+                        ArgumentUnderstood = TRUE;
+                        i++;
+                    }
+                }
             }
         } else {
             ArgumentUnderstood = TRUE;
@@ -353,154 +1028,166 @@ ENTRYPOINT(
         return EXIT_FAILURE;
     }
 
-    ChildArgs = YoriLibMalloc((ArgC - StartArg) * sizeof(YORI_STRING));
-    if (ChildArgs == NULL) {
+    if (Trace && (RunCount != 1 || WarmupCount != 0 || Format != TimeThisStatisticsTable || PrepareCommand != NULL)) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("timethis: -trace cannot be combined with -json, -m, -n, -prepare or -warmup\n"));
         YoriLibFreeStringContents(&AllocatedFormatString);
         return EXIT_FAILURE;
     }
 
-    YoriLibInitEmptyString(&Executable);
-    if (!YoriLibLocateExecutableInPath(&ArgV[StartArg], NULL, NULL, &Executable) ||
-        Executable.LengthInChars == 0) {
-
-        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("timethis: unable to find executable\n"));
+    if (!TimeThisBuildCmdLine(ArgC - StartArg, &ArgV[StartArg], &CmdLine)) {
         YoriLibFreeStringContents(&AllocatedFormatString);
-        YoriLibFree(ChildArgs);
-        YoriLibFreeStringContents(&Executable);
         return EXIT_FAILURE;
     }
 
+    YoriLibInitEmptyString(&PrepareCmdLine);
+    if (PrepareCommand != NULL &&
+        !TimeThisBuildCmdLineFromString(PrepareCommand, &PrepareCmdLine)) {
 
-    memcpy(&ChildArgs[0], &Executable, sizeof(YORI_STRING));
-    if (StartArg + 1 < (YORI_ALLOC_SIZE_T)ArgC) {
-        memcpy(&ChildArgs[1], &ArgV[StartArg + 1], (ArgC - StartArg - 1) * sizeof(YORI_STRING));
-    }
-
-    if (!YoriLibBuildCmdlineFromArgcArgv(ArgC - StartArg, ChildArgs, TRUE, TRUE, &CmdLine)) {
-        YoriLibFree(ChildArgs);
-        YoriLibFreeStringContents(&Executable);
+        YoriLibFreeStringContents(&CmdLine);
         YoriLibFreeStringContents(&AllocatedFormatString);
         return EXIT_FAILURE;
     }
 
-    ASSERT(YoriLibIsStringNullTerminated(&CmdLine));
+    //
+    //  If output from the child is being discarded, send it to the null
+    //  device.  The handle is inherited by the child.
+    //
 
-    hJob = YoriLibCreateJobObject();
+    OutputHandle = NULL;
+    if (Quiet) {
+        SECURITY_ATTRIBUTES SecurityAttributes;
 
-    memset(&StartupInfo, 0, sizeof(StartupInfo));
-    StartupInfo.cb = sizeof(StartupInfo);
+        ZeroMemory(&SecurityAttributes, sizeof(SecurityAttributes));
+        SecurityAttributes.nLength = sizeof(SecurityAttributes);
+        SecurityAttributes.bInheritHandle = TRUE;
 
-    if (!CreateProcess(NULL, CmdLine.StartOfString, NULL, NULL, TRUE, CREATE_SUSPENDED | CREATE_DEFAULT_ERROR_MODE, NULL, NULL, &StartupInfo, &ProcessInfo)) {
-        DWORD LastError = GetLastError();
-        LPTSTR ErrText = YoriLibGetWinErrorText(LastError);
-        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("timethis: execution failed: %s"), ErrText);
-        YoriLibFreeWinErrorText(ErrText);
-        YoriLibFree(ChildArgs);
-        YoriLibFreeStringContents(&CmdLine);
-        YoriLibFreeStringContents(&Executable);
-        YoriLibFreeStringContents(&AllocatedFormatString);
-        if (hJob != NULL) {
-            CloseHandle(hJob);
+        OutputHandle = CreateFile(_T("NUL"), GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, &SecurityAttributes, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (OutputHandle == INVALID_HANDLE_VALUE) {
+            YoriLibFreeStringContents(&PrepareCmdLine);
+            YoriLibFreeStringContents(&CmdLine);
+            YoriLibFreeStringContents(&AllocatedFormatString);
+            return EXIT_FAILURE;
         }
-        return EXIT_FAILURE;
-    }
-
-    if (hJob != NULL) {
-        YoriLibAssignProcessToJobObject(hJob, ProcessInfo.hProcess);
     }
 
-    ResumeThread(ProcessInfo.hThread);
-
-    YoriLibFreeStringContents(&Executable);
-    YoriLibFreeStringContents(&CmdLine);
-    YoriLibFree(ChildArgs);
+    YoriLibLoadPsapiFunctions();
 
     //
-    //  Wait for the immediate child process to terminate.
+    //  If the command is only being run once, display the result using the
+    //  format string.
     //
 
-#if YORI_BUILTIN
-    {
-        HANDLE HandleArray[2];
-        DWORD WaitResult;
+    if (RunCount == 1 && WarmupCount == 0 && Format == TimeThisStatisticsTable) {
+        TraceContext = NULL;
+        if (Trace) {
+            TraceContext = TimeThisTraceStart();
+            if (TraceContext == NULL) {
+                if (OutputHandle != NULL) {
+                    CloseHandle(OutputHandle);
+                }
+                YoriLibFreeStringContents(&CmdLine);
+                YoriLibFreeStringContents(&AllocatedFormatString);
+                return EXIT_FAILURE;
+            }
+        }
 
-        YoriLibCancelEnable(FALSE);
-        HandleArray[1] = YoriLibCancelGetEvent();
-        HandleArray[0] = ProcessInfo.hProcess;
+        if (PrepareCmdLine.LengthInChars > 0 &&
+            !TimeThisExecute(&PrepareCmdLine, OutputHandle, &PrepareContext, &PrepareExitCode)) {
 
-        WaitResult = WaitForMultipleObjectsEx(2, HandleArray, FALSE, INFINITE, FALSE);
+            if (OutputHandle != NULL) {
+                CloseHandle(OutputHandle);
+            }
+            YoriLibFreeStringContents(&PrepareCmdLine);
+            YoriLibFreeStringContents(&CmdLine);
+            YoriLibFreeStringContents(&AllocatedFormatString);
+            return EXIT_FAILURE;
+        }
 
-        //
-        //  If cancelled, abort
-        //
+        YoriLibFreeStringContents(&PrepareCmdLine);
 
-        if (WaitResult == WAIT_OBJECT_0 + 1) {
-            CloseHandle(ProcessInfo.hProcess);
-            CloseHandle(ProcessInfo.hThread);
-            if (hJob != NULL) {
-                CloseHandle(hJob);
+        if (!TimeThisExecute(&CmdLine, OutputHandle, &TimeThisContext, &ExitCode)) {
+            if (TraceContext != NULL) {
+                TimeThisTraceFree(TraceContext);
             }
+            if (OutputHandle != NULL) {
+                CloseHandle(OutputHandle);
+            }
+            YoriLibFreeStringContents(&CmdLine);
             YoriLibFreeStringContents(&AllocatedFormatString);
-
             return EXIT_FAILURE;
         }
-    }
-#else
-    WaitForSingleObject(ProcessInfo.hProcess, INFINITE);
-#endif
-    GetExitCodeProcess(ProcessInfo.hProcess, &ExitCode);
 
-    //
-    //  Save off times from the child process.
-    //
+        if (TraceContext != NULL) {
+            TimeThisTraceStop(TraceContext);
+        }
 
-    GetProcessTimes(ProcessInfo.hProcess, &ftCreationTime, &ftExitTime, &ftKernelTime, &ftUserTime);
+        if (OutputHandle != NULL) {
+            CloseHandle(OutputHandle);
+        }
+        YoriLibFreeStringContents(&CmdLine);
 
-    liCreationTime.HighPart = ftCreationTime.dwHighDateTime;
-    liCreationTime.LowPart = ftCreationTime.dwLowDateTime;
-    liExitTime.HighPart = ftExitTime.dwHighDateTime;
-    liExitTime.LowPart = ftExitTime.dwLowDateTime;
-    TimeThisContext.KernelTimeInMs.HighPart = ftKernelTime.dwHighDateTime;
-    TimeThisContext.KernelTimeInMs.LowPart = ftKernelTime.dwLowDateTime;
-    TimeThisContext.KernelTimeInMs.QuadPart = TimeThisContext.KernelTimeInMs.QuadPart / (10 * 1000);
-    TimeThisContext.UserTimeInMs.HighPart = ftUserTime.dwHighDateTime;
-    TimeThisContext.UserTimeInMs.LowPart = ftUserTime.dwLowDateTime;
-    TimeThisContext.UserTimeInMs.QuadPart = TimeThisContext.UserTimeInMs.QuadPart / (10 * 1000);
+        YoriLibInitEmptyString(&DisplayString);
+        YoriLibExpandCommandVariables(&AllocatedFormatString, '$', FALSE, TimeThisExpandVariables, &TimeThisContext, &DisplayString);
+        if (DisplayString.StartOfString != NULL) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y"), &DisplayString);
+            YoriLibFreeStringContents(&DisplayString);
+        }
+        YoriLibFreeStringContents(&AllocatedFormatString);
+
+        if (TraceContext != NULL) {
+            TimeThisTraceDisplay(TraceContext);
+            TimeThisTraceFree(TraceContext);
+        }
 
-    TimeThisContext.WallTimeInMs.QuadPart = (liExitTime.QuadPart - liCreationTime.QuadPart) / (10 * 1000);
+        return ExitCode;
+    }
 
     //
-    //  Save off times from all processes within the job, if it exists.
-    //  Note that currently we're not waiting for all processes within the
-    //  job to terminate.
+    //  Run the command repeatedly, discarding the warmup runs, and display
+    //  statistics for the measured runs.  The prepare command, if any, runs
+    //  before every run including warmup runs and is not measured.
     //
 
-    TimeThisContext.KernelTimeTreeInMs.QuadPart = TimeThisContext.KernelTimeInMs.QuadPart;
-    TimeThisContext.UserTimeTreeInMs.QuadPart = TimeThisContext.UserTimeInMs.QuadPart;
+    YoriLibFreeStringContents(&AllocatedFormatString);
 
-    if (hJob != NULL) {
-        YORI_JOB_BASIC_ACCOUNTING_INFORMATION JobInfo;
-        DWORD BytesReturned;
+    Samples = YoriLibMalloc(RunCount * TimeThisMetricCount * sizeof(DWORDLONG));
+    if (Samples == NULL) {
+        if (OutputHandle != NULL) {
+            CloseHandle(OutputHandle);
+        }
+        YoriLibFreeStringContents(&PrepareCmdLine);
+        YoriLibFreeStringContents(&CmdLine);
+        return EXIT_FAILURE;
+    }
 
-        if (DllKernel32.pQueryInformationJobObject != NULL &&
-            DllKernel32.pQueryInformationJobObject(hJob, 1, &JobInfo, sizeof(JobInfo), &BytesReturned)) {
+    ExitCode = EXIT_SUCCESS;
+    for (Run = 0; Run < WarmupCount + RunCount; Run++) {
+        if ((PrepareCmdLine.LengthInChars > 0 &&
+             !TimeThisExecute(&PrepareCmdLine, OutputHandle, &PrepareContext, &PrepareExitCode)) ||
+            !TimeThisExecute(&CmdLine, OutputHandle, &TimeThisContext, &ExitCode)) {
 
-            TimeThisContext.KernelTimeTreeInMs.QuadPart = JobInfo.TotalKernelTime.QuadPart / (10 * 1000);
-            TimeThisContext.UserTimeTreeInMs.QuadPart = JobInfo.TotalUserTime.QuadPart / (10 * 1000);
+            if (OutputHandle != NULL) {
+                CloseHandle(OutputHandle);
+            }
+            YoriLibFree(Samples);
+            YoriLibFreeStringContents(&PrepareCmdLine);
+            YoriLibFreeStringContents(&CmdLine);
+            return EXIT_FAILURE;
         }
-        CloseHandle(hJob);
-    }
 
-    CloseHandle(ProcessInfo.hProcess);
-    CloseHandle(ProcessInfo.hThread);
+        if (Run >= WarmupCount) {
+            TimeThisRecordSamples(&TimeThisContext, Samples, RunCount, Run - WarmupCount);
+        }
+    }
 
-    YoriLibInitEmptyString(&DisplayString);
-    YoriLibExpandCommandVariables(&AllocatedFormatString, '$', FALSE, TimeThisExpandVariables, &TimeThisContext, &DisplayString);
-    if (DisplayString.StartOfString != NULL) {
-        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%y"), &DisplayString);
-        YoriLibFreeStringContents(&DisplayString);
+    if (OutputHandle != NULL) {
+        CloseHandle(OutputHandle);
     }
-    YoriLibFreeStringContents(&AllocatedFormatString);
+    YoriLibFreeStringContents(&PrepareCmdLine);
+    YoriLibFreeStringContents(&CmdLine);
+
+    TimeThisDisplayStatistics(Samples, RunCount, WarmupCount, Format);
+    YoriLibFree(Samples);
 
     return ExitCode;
 }
@@ -0,0 +1,51 @@
+/**
+ * @file timethis/timethis.h
+ *
+ * Yori shell child process timer tool master header
+ *
+ * Copyright (c) 2017-2019 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/**
+ A pointer to an opaque structure describing an event trace of the child
+ process tree.
+ */
+typedef struct _TIMETHIS_TRACE_CONTEXT *PTIMETHIS_TRACE_CONTEXT;
+
+PTIMETHIS_TRACE_CONTEXT
+TimeThisTraceStart(VOID);
+
+VOID
+TimeThisTraceStop(
+    __in PTIMETHIS_TRACE_CONTEXT TraceContext
+    );
+
+VOID
+TimeThisTraceDisplay(
+    __in PTIMETHIS_TRACE_CONTEXT TraceContext
+    );
+
+VOID
+TimeThisTraceFree(
+    __in PTIMETHIS_TRACE_CONTEXT TraceContext
+    );
+
+// vim:sw=4:ts=4:et:
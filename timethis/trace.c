@@ -0,0 +1,1523 @@
+/**
+ * @file timethis/trace.c
+ *
+ * Yori shell child process file I/O tracing
+ *
+ * Copyright (c) 2026 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <yoripch.h>
+#include <yorilib.h>
+#include "timethis.h"
+
+/**
+ The GUID used to control the kernel logger session.
+ */
+const GUID TimeThisSystemTraceControlGuid = {0x9e814aad, 0x3204, 0x11d2, {0x9a, 0x82, 0x00, 0x60, 0x08, 0xa8, 0x69, 0x39}};
+
+/**
+ The GUID of kernel file I/O events.
+ */
+const GUID TimeThisFileIoGuid = {0x90cbdc39, 0x4a3e, 0x11d1, {0x84, 0xf4, 0x00, 0x00, 0xf8, 0x04, 0x64, 0xe3}};
+
+/**
+ The GUID of kernel process events.
+ */
+const GUID TimeThisProcessGuid = {0x3d6fa8d0, 0xfe05, 0x11d0, {0x9d, 0xda, 0x00, 0xc0, 0x4f, 0xd7, 0xba, 0x7c}};
+
+/**
+ The GUID of kernel image load events.
+ */
+const GUID TimeThisImageGuid = {0x2cb15d1d, 0x5fc1, 0x11d2, {0xab, 0xe1, 0x00, 0xa0, 0xc9, 0x11, 0xf5, 0x18}};
+
+/**
+ The opcode of a process start event.
+ */
+#define TIMETHIS_OPCODE_PROCESS_START   1
+
+/**
+ The opcode of a process end event.
+ */
+#define TIMETHIS_OPCODE_PROCESS_END     2
+
+/**
+ The opcode of an image load event.
+ */
+#define TIMETHIS_OPCODE_IMAGE_LOAD      10
+
+/**
+ The opcode of a file create event.
+ */
+#define TIMETHIS_OPCODE_FILE_CREATE     64
+
+/**
+ The opcode of a file close event.
+ */
+#define TIMETHIS_OPCODE_FILE_CLOSE      66
+
+/**
+ The opcode of a file read event.
+ */
+#define TIMETHIS_OPCODE_FILE_READ       67
+
+/**
+ The opcode of a file write event.
+ */
+#define TIMETHIS_OPCODE_FILE_WRITE      68
+
+/**
+ The opcode of an event indicating a file operation has completed.
+ */
+#define TIMETHIS_OPCODE_FILE_OPEND      76
+
+/**
+ The number of milliseconds to wait for outstanding events to be delivered
+ after the trace session is stopped.
+ */
+#define TIMETHIS_TRACE_DRAIN_TIMEOUT    5000
+
+/**
+ A single slot within a table that maps a pointer or process ID to a value.
+ */
+typedef struct _TIMETHIS_TRACE_SLOT {
+
+    /**
+     The key of the slot.  Zero indicates the slot is not in use.
+     */
+    DWORDLONG Key;
+
+    /**
+     The value associated with the key.
+     */
+    PVOID Value;
+} TIMETHIS_TRACE_SLOT, *PTIMETHIS_TRACE_SLOT;
+
+/**
+ A table that maps a pointer or process ID to a value.  These are looked up
+ for almost every event, so this uses open addressing rather than a general
+ purpose string hash table.
+ */
+typedef struct _TIMETHIS_TRACE_TABLE {
+
+    /**
+     An array of slots.  The number of slots is always a power of two.
+     */
+    PTIMETHIS_TRACE_SLOT Slots;
+
+    /**
+     The number of slots in the array.
+     */
+    YORI_ALLOC_SIZE_T Capacity;
+
+    /**
+     The number of slots that are in use.
+     */
+    YORI_ALLOC_SIZE_T Count;
+} TIMETHIS_TRACE_TABLE, *PTIMETHIS_TRACE_TABLE;
+
+/**
+ Information about a single file or image accessed by the child process
+ tree.
+ */
+typedef struct _TIMETHIS_TRACE_FILE {
+
+    /**
+     The entry of this file within the hash table of files.  The key of the
+     entry is the name of the file.
+     */
+    YORI_HASH_ENTRY HashEntry;
+
+    /**
+     The number of times the file was opened, or for an image, the number of
+     times it was loaded.
+     */
+    DWORD Opens;
+
+    /**
+     The number of times an attempt to open the file failed.
+     */
+    DWORD FailedOpens;
+
+    /**
+     The number of read operations.
+     */
+    DWORD Reads;
+
+    /**
+     The number of write operations.
+     */
+    DWORD Writes;
+
+    /**
+     The number of bytes read.
+     */
+    DWORDLONG ReadBytes;
+
+    /**
+     The number of bytes written.
+     */
+    DWORDLONG WriteBytes;
+
+    /**
+     The total time spent waiting for operations on the file, in 100ns
+     units.
+     */
+    DWORDLONG IoTime;
+
+    /**
+     The longest time taken for a single operation on the file, in 100ns
+     units.
+     */
+    DWORDLONG MaxLatency;
+} TIMETHIS_TRACE_FILE, *PTIMETHIS_TRACE_FILE;
+
+/**
+ Information about a file operation that has been issued but has not yet
+ completed.
+ */
+typedef struct _TIMETHIS_TRACE_IRP {
+
+    /**
+     The file that the operation refers to.
+     */
+    PTIMETHIS_TRACE_FILE File;
+
+    /**
+     The kernel file object that the operation refers to.
+     */
+    DWORDLONG FileObject;
+
+    /**
+     The time the operation was issued.
+     */
+    LONGLONG StartTime;
+
+    /**
+     The opcode of the event that issued the operation.
+     */
+    UCHAR Opcode;
+} TIMETHIS_TRACE_IRP, *PTIMETHIS_TRACE_IRP;
+
+/**
+ The state of an event trace of the child process tree.
+ */
+typedef struct _TIMETHIS_TRACE_CONTEXT {
+
+    /**
+     The properties used to start and stop the trace session.  The session
+     name follows this structure in the same allocation.
+     */
+    PYORI_EVENT_TRACE_PROPERTIES Properties;
+
+    /**
+     Information used to open a consumer of the trace session.
+     */
+    YORI_EVENT_TRACE_LOGFILEW LogFile;
+
+    /**
+     The handle to the trace session.
+     */
+    YORI_TRACEHANDLE SessionHandle;
+
+    /**
+     The handle to the consumer of the trace session.
+     */
+    YORI_TRACEHANDLE ConsumerHandle;
+
+    /**
+     The thread that receives events from the trace session.
+     */
+    HANDLE ConsumerThread;
+
+    /**
+     The set of process IDs that are part of the child process tree.
+     */
+    TIMETHIS_TRACE_TABLE Processes;
+
+    /**
+     A table mapping outstanding operations to TIMETHIS_TRACE_IRP
+     structures.
+     */
+    TIMETHIS_TRACE_TABLE Irps;
+
+    /**
+     A table mapping kernel file objects to TIMETHIS_TRACE_FILE structures.
+     */
+    TIMETHIS_TRACE_TABLE FileObjects;
+
+    /**
+     A hash table of TIMETHIS_TRACE_FILE structures for files, indexed by
+     name.
+     */
+    PYORI_HASH_TABLE Files;
+
+    /**
+     A hash table of TIMETHIS_TRACE_FILE structures for images, indexed by
+     name.
+     */
+    PYORI_HASH_TABLE Images;
+
+    /**
+     The number of entries in the Files table.
+     */
+    YORI_ALLOC_SIZE_T FileCount;
+
+    /**
+     The number of entries in the Images table.
+     */
+    YORI_ALLOC_SIZE_T ImageCount;
+
+    /**
+     The number of processes launched within the child process tree.
+     */
+    DWORD ProcessCount;
+
+    /**
+     The number of events that could not be recorded because memory could
+     not be allocated.
+     */
+    DWORD EventsDropped;
+
+    /**
+     The number of events that the system could not deliver.
+     */
+    DWORD EventsLost;
+
+    /**
+     TRUE if the trace session has been started and has not been stopped.
+     */
+    BOOLEAN SessionStarted;
+} TIMETHIS_TRACE_CONTEXT;
+
+/**
+ Initialize a table that maps a pointer or process ID to a value.
+
+ @param Table Pointer to the table to initialize.
+
+ @param Capacity The initial number of slots in the table.  This must be a
+        power of two.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+TimeThisTraceTableInitialize(
+    __out PTIMETHIS_TRACE_TABLE Table,
+    __in YORI_ALLOC_SIZE_T Capacity
+    )
+{
+    Table->Slots = YoriLibMalloc(Capacity * sizeof(TIMETHIS_TRACE_SLOT));
+    if (Table->Slots == NULL) {
+        Table->Capacity = 0;
+        Table->Count = 0;
+        return FALSE;
+    }
+
+    ZeroMemory(Table->Slots, Capacity * sizeof(TIMETHIS_TRACE_SLOT));
+    Table->Capacity = Capacity;
+    Table->Count = 0;
+    return TRUE;
+}
+
+/**
+ Return the preferred slot for a key within a table.
+
+ @param Table Pointer to the table.
+
+ @param Key The key to locate the preferred slot for.
+
+ @return The index of the preferred slot.
+ */
+YORI_ALLOC_SIZE_T
+TimeThisTraceTableHome(
+    __in PTIMETHIS_TRACE_TABLE Table,
+    __in DWORDLONG Key
+    )
+{
+    DWORD Hash;
+
+    //
+    //  Pointers are aligned and process IDs are multiples of four, so
+    //  discard the low bits before scattering the rest across the table.
+    //
+
+    Hash = (DWORD)((Key >> 2) ^ (Key >> 32));
+    Hash = Hash * 2654435761u;
+    return (YORI_ALLOC_SIZE_T)(Hash & (Table->Capacity - 1));
+}
+
+/**
+ Find the slot containing a key within a table.
+
+ @param Table Pointer to the table.
+
+ @param Key The key to find.
+
+ @return Pointer to the slot containing the key, or NULL if the key is not
+         in the table.
+ */
+PTIMETHIS_TRACE_SLOT
+TimeThisTraceTableFind(
+    __in PTIMETHIS_TRACE_TABLE Table,
+    __in DWORDLONG Key
+    )
+{
+    YORI_ALLOC_SIZE_T Index;
+
+    if (Table->Capacity == 0 || Key == 0) {
+        return NULL;
+    }
+
+    Index = TimeThisTraceTableHome(Table, Key);
+    while (Table->Slots[Index].Key != 0) {
+        if (Table->Slots[Index].Key == Key) {
+            return &Table->Slots[Index];
+        }
+        Index = (Index + 1) & (Table->Capacity - 1);
+    }
+
+    return NULL;
+}
+
+/**
+ Insert a key into a table, or update the value of a key that is already
+ present.  The table is grown when it becomes half full.
+
+ @param Table Pointer to the table.
+
+ @param Key The key to insert.  This must not be zero.
+
+ @param Value The value to associate with the key.
+
+ @param PreviousValue Optionally points to a location to receive the value
+        that was previously associated with the key, or NULL if the key was
+        not previously present.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+TimeThisTraceTableInsert(
+    __in PTIMETHIS_TRACE_TABLE Table,
+    __in DWORDLONG Key,
+    __in PVOID Value,
+    __out_opt PVOID *PreviousValue
+    )
+{
+    YORI_ALLOC_SIZE_T Index;
+    YORI_ALLOC_SIZE_T OldIndex;
+    TIMETHIS_TRACE_TABLE NewTable;
+    PTIMETHIS_TRACE_SLOT Slot;
+
+    if (PreviousValue != NULL) {
+        *PreviousValue = NULL;
+    }
+
+    Slot = TimeThisTraceTableFind(Table, Key);
+    if (Slot != NULL) {
+        if (PreviousValue != NULL) {
+            *PreviousValue = Slot->Value;
+        }
+        Slot->Value = Value;
+        return TRUE;
+    }
+
+    if ((Table->Count + 1) * 2 > Table->Capacity) {
+        if (!YoriLibIsSizeAllocatable(Table->Capacity * 2 * sizeof(TIMETHIS_TRACE_SLOT)) ||
+            !TimeThisTraceTableInitialize(&NewTable, Table->Capacity * 2)) {
+
+            return FALSE;
+        }
+
+        for (OldIndex = 0; OldIndex < Table->Capacity; OldIndex++) {
+            if (Table->Slots[OldIndex].Key != 0) {
+                Index = TimeThisTraceTableHome(&NewTable, Table->Slots[OldIndex].Key);
+                while (NewTable.Slots[Index].Key != 0) {
+                    Index = (Index + 1) & (NewTable.Capacity - 1);
+                }
+                NewTable.Slots[Index] = Table->Slots[OldIndex];
+                NewTable.Count++;
+            }
+        }
+
+        YoriLibFree(Table->Slots);
+        Table->Slots = NewTable.Slots;
+        Table->Capacity = NewTable.Capacity;
+    }
+
+    Index = TimeThisTraceTableHome(Table, Key);
+    while (Table->Slots[Index].Key != 0) {
+        Index = (Index + 1) & (Table->Capacity - 1);
+    }
+
+    Table->Slots[Index].Key = Key;
+    Table->Slots[Index].Value = Value;
+    Table->Count++;
+    return TRUE;
+}
+
+/**
+ Remove a slot from a table.  Later entries that collided with this one are
+ shifted back so that lookups do not need to skip over deleted slots.
+
+ @param Table Pointer to the table.
+
+ @param Slot Pointer to the slot to remove, as returned from
+        TimeThisTraceTableFind.
+ */
+VOID
+TimeThisTraceTableRemove(
+    __in PTIMETHIS_TRACE_TABLE Table,
+    __in PTIMETHIS_TRACE_SLOT Slot
+    )
+{
+    YORI_ALLOC_SIZE_T Hole;
+    YORI_ALLOC_SIZE_T Index;
+    YORI_ALLOC_SIZE_T Home;
+    YORI_ALLOC_SIZE_T Mask;
+
+    Mask = Table->Capacity - 1;
+    Hole = (YORI_ALLOC_SIZE_T)(Slot - Table->Slots);
+    Index = Hole;
+
+    while (TRUE) {
+        Index = (Index + 1) & Mask;
+        if (Table->Slots[Index].Key == 0) {
+            break;
+        }
+
+        //
+        //  An entry can move into the hole if its preferred slot is not
+        //  between the hole and its current position.
+        //
+
+        Home = TimeThisTraceTableHome(Table, Table->Slots[Index].Key);
+        if (((Index - Home) & Mask) >= ((Index - Hole) & Mask)) {
+            Table->Slots[Hole] = Table->Slots[Index];
+            Hole = Index;
+        }
+    }
+
+    Table->Slots[Hole].Key = 0;
+    Table->Slots[Hole].Value = NULL;
+    Table->Count--;
+}
+
+/**
+ Free a table that maps a pointer or process ID to a value.  If the values
+ are allocations, they must be freed by the caller first.
+
+ @param Table Pointer to the table to free.
+ */
+VOID
+TimeThisTraceTableCleanup(
+    __in PTIMETHIS_TRACE_TABLE Table
+    )
+{
+    if (Table->Slots != NULL) {
+        YoriLibFree(Table->Slots);
+        Table->Slots = NULL;
+    }
+    Table->Capacity = 0;
+    Table->Count = 0;
+}
+
+/**
+ Return TRUE if a process ID is part of the child process tree.
+
+ @param TraceContext Pointer to the trace context.
+
+ @param ProcessId The process ID to check.
+
+ @return TRUE if the process is part of the child process tree, FALSE if it
+         is not.
+ */
+BOOLEAN
+TimeThisTraceIsProcessInTree(
+    __in PTIMETHIS_TRACE_CONTEXT TraceContext,
+    __in DWORD ProcessId
+    )
+{
+    if (TimeThisTraceTableFind(&TraceContext->Processes, ProcessId) != NULL) {
+        return TRUE;
+    }
+    return FALSE;
+}
+
+/**
+ Read a field of the specified size from the data of an event.
+
+ @param Event Pointer to the event.
+
+ @param Offset The offset of the field within the data of the event, in
+        bytes.
+
+ @param Size The size of the field, in bytes.  This can be 4 or 8.
+
+ @param Value On successful completion, populated with the value of the
+        field.
+
+ @return TRUE to indicate the field was read, FALSE if it is beyond the end
+         of the data.
+ */
+__success(return)
+BOOLEAN
+TimeThisTraceReadField(
+    __in PYORI_EVENT_RECORD Event,
+    __in DWORD Offset,
+    __in DWORD Size,
+    __out PDWORDLONG Value
+    )
+{
+    DWORD Value32;
+
+    if (Offset + Size > Event->UserDataLength) {
+        return FALSE;
+    }
+
+    if (Size == sizeof(DWORD)) {
+        memcpy(&Value32, YoriLibAddToPointer(Event->UserData, Offset), sizeof(DWORD));
+        *Value = Value32;
+    } else {
+        memcpy(Value, YoriLibAddToPointer(Event->UserData, Offset), sizeof(DWORDLONG));
+    }
+
+    return TRUE;
+}
+
+/**
+ Describe a NULL terminated string within the data of an event.  The
+ resulting string refers to the event data and is not NULL terminated.
+
+ @param Event Pointer to the event.
+
+ @param Offset The offset of the string within the data of the event, in
+        bytes.
+
+ @param String On successful completion, updated to describe the string.
+
+ @return TRUE to indicate a nonempty string was found, FALSE if it was not.
+ */
+__success(return)
+BOOLEAN
+TimeThisTraceReadString(
+    __in PYORI_EVENT_RECORD Event,
+    __in DWORD Offset,
+    __out PYORI_STRING String
+    )
+{
+    DWORD MaxChars;
+    DWORD Index;
+    LPWSTR Chars;
+
+    YoriLibInitEmptyString(String);
+    if (Offset >= Event->UserDataLength) {
+        return FALSE;
+    }
+
+    MaxChars = (Event->UserDataLength - Offset) / sizeof(WCHAR);
+    Chars = YoriLibAddToPointer(Event->UserData, Offset);
+    for (Index = 0; Index < MaxChars; Index++) {
+        if (Chars[Index] == '\0') {
+            break;
+        }
+    }
+
+    if (Index == 0) {
+        return FALSE;
+    }
+
+    String->StartOfString = Chars;
+    String->LengthInChars = (YORI_ALLOC_SIZE_T)Index;
+    return TRUE;
+}
+
+/**
+ Find or create the record describing a file or image.
+
+ @param TraceContext Pointer to the trace context.
+
+ @param Table The hash table to search, which is either the table of files
+        or the table of images.
+
+ @param Name The name of the file or image.
+
+ @return Pointer to the record, or NULL if a new record could not be
+         allocated.
+ */
+PTIMETHIS_TRACE_FILE
+TimeThisTraceGetFile(
+    __in PTIMETHIS_TRACE_CONTEXT TraceContext,
+    __in PYORI_HASH_TABLE Table,
+    __in PYORI_STRING Name
+    )
+{
+    PYORI_HASH_ENTRY HashEntry;
+    PTIMETHIS_TRACE_FILE File;
+
+    HashEntry = YoriLibHashLookupByKey(Table, Name);
+    if (HashEntry != NULL) {
+        return HashEntry->Context;
+    }
+
+    File = YoriLibMalloc(sizeof(TIMETHIS_TRACE_FILE));
+    if (File == NULL) {
+        return NULL;
+    }
+
+    ZeroMemory(File, sizeof(TIMETHIS_TRACE_FILE));
+    YoriLibHashInsertByKey(Table, Name, File, &File->HashEntry);
+    if (File->HashEntry.Key.StartOfString == NULL) {
+        YoriLibHashRemoveByEntry(&File->HashEntry);
+        YoriLibFree(File);
+        return NULL;
+    }
+
+    if (Table == TraceContext->Files) {
+        TraceContext->FileCount++;
+    } else {
+        TraceContext->ImageCount++;
+    }
+
+    return File;
+}
+
+/**
+ Record that a file operation has been issued so that its latency can be
+ calculated when it completes.
+
+ @param TraceContext Pointer to the trace context.
+
+ @param Event Pointer to the event that issued the operation.
+
+ @param IrpPtr The kernel pointer identifying the operation.
+
+ @param FileObject The kernel file object that the operation refers to.
+
+ @param File The file that the operation refers to.
+ */
+VOID
+TimeThisTraceTrackIrp(
+    __in PTIMETHIS_TRACE_CONTEXT TraceContext,
+    __in PYORI_EVENT_RECORD Event,
+    __in DWORDLONG IrpPtr,
+    __in DWORDLONG FileObject,
+    __in PTIMETHIS_TRACE_FILE File
+    )
+{
+    PTIMETHIS_TRACE_IRP Irp;
+    PVOID PreviousValue;
+
+    if (IrpPtr == 0) {
+        return;
+    }
+
+    Irp = YoriLibMalloc(sizeof(TIMETHIS_TRACE_IRP));
+    if (Irp == NULL) {
+        TraceContext->EventsDropped++;
+        return;
+    }
+
+    Irp->File = File;
+    Irp->FileObject = FileObject;
+    Irp->StartTime = Event->EventHeader.TimeStamp.QuadPart;
+    Irp->Opcode = Event->EventHeader.EventDescriptor.Opcode;
+
+    //
+    //  Operations that complete without a completion event leave their
+    //  record behind, so if the IRP is reused, discard the stale record.
+    //
+
+    if (!TimeThisTraceTableInsert(&TraceContext->Irps, IrpPtr, Irp, &PreviousValue)) {
+        TraceContext->EventsDropped++;
+        YoriLibFree(Irp);
+        return;
+    }
+
+    if (PreviousValue != NULL) {
+        YoriLibFree(PreviousValue);
+    }
+}
+
+/**
+ Process an event describing a process starting or ending.  Processes whose
+ parent is part of the child process tree are added to it.
+
+ @param TraceContext Pointer to the trace context.
+
+ @param Event Pointer to the event.
+
+ @param PointerSize The size of a pointer within the event data, in bytes.
+ */
+VOID
+TimeThisTraceProcessEvent(
+    __in PTIMETHIS_TRACE_CONTEXT TraceContext,
+    __in PYORI_EVENT_RECORD Event,
+    __in DWORD PointerSize
+    )
+{
+    DWORDLONG ProcessId;
+    DWORDLONG ParentId;
+    PTIMETHIS_TRACE_SLOT Slot;
+
+    if (!TimeThisTraceReadField(Event, PointerSize, sizeof(DWORD), &ProcessId) ||
+        !TimeThisTraceReadField(Event, PointerSize + sizeof(DWORD), sizeof(DWORD), &ParentId)) {
+
+        return;
+    }
+
+    if (Event->EventHeader.EventDescriptor.Opcode == TIMETHIS_OPCODE_PROCESS_START) {
+        if (TimeThisTraceIsProcessInTree(TraceContext, (DWORD)ParentId) &&
+            !TimeThisTraceIsProcessInTree(TraceContext, (DWORD)ProcessId)) {
+
+            if (TimeThisTraceTableInsert(&TraceContext->Processes, ProcessId, NULL, NULL)) {
+                TraceContext->ProcessCount++;
+            } else {
+                TraceContext->EventsDropped++;
+            }
+        }
+    } else if (Event->EventHeader.EventDescriptor.Opcode == TIMETHIS_OPCODE_PROCESS_END) {
+
+        //
+        //  Forget processes as they exit so a later, unrelated process that
+        //  reuses the ID is not attributed to the tree.
+        //
+
+        if (ProcessId != GetCurrentProcessId()) {
+            Slot = TimeThisTraceTableFind(&TraceContext->Processes, ProcessId);
+            if (Slot != NULL) {
+                TimeThisTraceTableRemove(&TraceContext->Processes, Slot);
+            }
+        }
+    }
+}
+
+/**
+ Process an event describing an image being loaded.
+
+ @param TraceContext Pointer to the trace context.
+
+ @param Event Pointer to the event.
+
+ @param PointerSize The size of a pointer within the event data, in bytes.
+ */
+VOID
+TimeThisTraceImageEvent(
+    __in PTIMETHIS_TRACE_CONTEXT TraceContext,
+    __in PYORI_EVENT_RECORD Event,
+    __in DWORD PointerSize
+    )
+{
+    DWORDLONG ProcessId;
+    YORI_STRING FileName;
+    PTIMETHIS_TRACE_FILE Image;
+
+    if (Event->EventHeader.EventDescriptor.Opcode != TIMETHIS_OPCODE_IMAGE_LOAD) {
+        return;
+    }
+
+    //
+    //  The event contains the image base and size, the process, four
+    //  32 bit fields, the default base, four more 32 bit fields, and the
+    //  file name.
+    //
+
+    if (!TimeThisTraceReadField(Event, 2 * PointerSize, sizeof(DWORD), &ProcessId) ||
+        !TimeThisTraceIsProcessInTree(TraceContext, (DWORD)ProcessId) ||
+        !TimeThisTraceReadString(Event, 3 * PointerSize + 8 * sizeof(DWORD), &FileName)) {
+
+        return;
+    }
+
+    Image = TimeThisTraceGetFile(TraceContext, TraceContext->Images, &FileName);
+    if (Image == NULL) {
+        TraceContext->EventsDropped++;
+        return;
+    }
+
+    Image->Opens++;
+}
+
+/**
+ Process an event describing file I/O.
+
+ @param TraceContext Pointer to the trace context.
+
+ @param Event Pointer to the event.
+
+ @param PointerSize The size of a pointer within the event data, in bytes.
+ */
+VOID
+TimeThisTraceFileIoEvent(
+    __in PTIMETHIS_TRACE_CONTEXT TraceContext,
+    __in PYORI_EVENT_RECORD Event,
+    __in DWORD PointerSize
+    )
+{
+    DWORDLONG IrpPtr;
+    DWORDLONG FileObject;
+    DWORDLONG IoSize;
+    DWORDLONG Status;
+    DWORDLONG Latency;
+    DWORD Offset;
+    BOOLEAN Version2;
+    YORI_STRING FileName;
+    PTIMETHIS_TRACE_FILE File;
+    PTIMETHIS_TRACE_IRP Irp;
+    PTIMETHIS_TRACE_SLOT Slot;
+
+    //
+    //  Version 2 events contain the issuing thread as a pointer sized field
+    //  after the IRP.  Version 3 events moved it after the file object and
+    //  made it 32 bits.
+    //
+
+    Version2 = FALSE;
+    if (Event->EventHeader.EventDescriptor.Version <= 2) {
+        Version2 = TRUE;
+    }
+
+    switch(Event->EventHeader.EventDescriptor.Opcode) {
+        case TIMETHIS_OPCODE_FILE_CREATE:
+            if (!TimeThisTraceIsProcessInTree(TraceContext, Event->EventHeader.ProcessId)) {
+                break;
+            }
+
+            if (Version2) {
+                Offset = 2 * PointerSize;
+            } else {
+                Offset = PointerSize;
+            }
+
+            if (!TimeThisTraceReadField(Event, 0, PointerSize, &IrpPtr) ||
+                !TimeThisTraceReadField(Event, Offset, PointerSize, &FileObject)) {
+
+                break;
+            }
+
+            //
+            //  The name follows the thread, create options, attributes and
+            //  share access.
+            //
+
+            Offset = 3 * PointerSize + 3 * sizeof(DWORD);
+            if (!Version2) {
+                Offset = 2 * PointerSize + 4 * sizeof(DWORD);
+            }
+
+            if (!TimeThisTraceReadString(Event, Offset, &FileName)) {
+                break;
+            }
+
+            File = TimeThisTraceGetFile(TraceContext, TraceContext->Files, &FileName);
+            if (File == NULL) {
+                TraceContext->EventsDropped++;
+                break;
+            }
+
+            File->Opens++;
+            if (!TimeThisTraceTableInsert(&TraceContext->FileObjects, FileObject, File, NULL)) {
+                TraceContext->EventsDropped++;
+            }
+            TimeThisTraceTrackIrp(TraceContext, Event, IrpPtr, FileObject, File);
+            break;
+
+        case TIMETHIS_OPCODE_FILE_READ:
+        case TIMETHIS_OPCODE_FILE_WRITE:
+            if (!TimeThisTraceIsProcessInTree(TraceContext, Event->EventHeader.ProcessId)) {
+                break;
+            }
+
+            //
+            //  The event starts with a 64 bit file offset followed by the
+            //  IRP, file object, file key and I/O size.
+            //
+
+            if (Version2) {
+                Offset = sizeof(DWORDLONG) + 2 * PointerSize;
+            } else {
+                Offset = sizeof(DWORDLONG) + PointerSize;
+            }
+
+            if (!TimeThisTraceReadField(Event, sizeof(DWORDLONG), PointerSize, &IrpPtr) ||
+                !TimeThisTraceReadField(Event, Offset, PointerSize, &FileObject)) {
+
+                break;
+            }
+
+            if (Version2) {
+                Offset = sizeof(DWORDLONG) + 4 * PointerSize;
+            } else {
+                Offset = sizeof(DWORDLONG) + 3 * PointerSize + sizeof(DWORD);
+            }
+
+            if (!TimeThisTraceReadField(Event, Offset, sizeof(DWORD), &IoSize)) {
+                break;
+            }
+
+            Slot = TimeThisTraceTableFind(&TraceContext->FileObjects, FileObject);
+            if (Slot == NULL) {
+                break;
+            }
+
+            File = Slot->Value;
+            if (Event->EventHeader.EventDescriptor.Opcode == TIMETHIS_OPCODE_FILE_READ) {
+                File->Reads++;
+                File->ReadBytes = File->ReadBytes + IoSize;
+            } else {
+                File->Writes++;
+                File->WriteBytes = File->WriteBytes + IoSize;
+            }
+            TimeThisTraceTrackIrp(TraceContext, Event, IrpPtr, FileObject, File);
+            break;
+
+        case TIMETHIS_OPCODE_FILE_CLOSE:
+            if (Version2) {
+                Offset = 2 * PointerSize;
+            } else {
+                Offset = PointerSize;
+            }
+
+            if (!TimeThisTraceReadField(Event, Offset, PointerSize, &FileObject)) {
+                break;
+            }
+
+            Slot = TimeThisTraceTableFind(&TraceContext->FileObjects, FileObject);
+            if (Slot != NULL) {
+                TimeThisTraceTableRemove(&TraceContext->FileObjects, Slot);
+            }
+            break;
+
+        case TIMETHIS_OPCODE_FILE_OPEND:
+
+            //
+            //  Completion events can be logged in an arbitrary process
+            //  context, so these are matched by IRP rather than by process.
+            //
+
+            if (!TimeThisTraceReadField(Event, 0, PointerSize, &IrpPtr) ||
+                !TimeThisTraceReadField(Event, 2 * PointerSize, sizeof(DWORD), &Status)) {
+
+                break;
+            }
+
+            Slot = TimeThisTraceTableFind(&TraceContext->Irps, IrpPtr);
+            if (Slot == NULL) {
+                break;
+            }
+
+            Irp = Slot->Value;
+            TimeThisTraceTableRemove(&TraceContext->Irps, Slot);
+
+            File = Irp->File;
+            if (Event->EventHeader.TimeStamp.QuadPart > Irp->StartTime) {
+                Latency = (DWORDLONG)(Event->EventHeader.TimeStamp.QuadPart - Irp->StartTime);
+                File->IoTime = File->IoTime + Latency;
+                if (Latency > File->MaxLatency) {
+                    File->MaxLatency = Latency;
+                }
+            }
+
+            //
+            //  A failed open leaves no file object behind, so stop
+            //  attributing the file object to the file.
+            //
+
+            if (Irp->Opcode == TIMETHIS_OPCODE_FILE_CREATE && (Status & 0xC0000000) == 0xC0000000) {
+                File->FailedOpens++;
+                Slot = TimeThisTraceTableFind(&TraceContext->FileObjects, Irp->FileObject);
+                if (Slot != NULL && Slot->Value == File) {
+                    TimeThisTraceTableRemove(&TraceContext->FileObjects, Slot);
+                }
+            }
+
+            YoriLibFree(Irp);
+            break;
+    }
+}
+
+/**
+ A callback invoked for each event delivered from the trace session.
+
+ @param Event Pointer to the event.
+ */
+VOID WINAPI
+TimeThisTraceEventCallback(
+    __in PYORI_EVENT_RECORD Event
+    )
+{
+    PTIMETHIS_TRACE_CONTEXT TraceContext;
+    DWORD PointerSize;
+
+    TraceContext = Event->UserContext;
+
+    PointerSize = sizeof(PVOID);
+    if (Event->EventHeader.Flags & YORI_EVENT_HEADER_FLAG_64_BIT_HEADER) {
+        PointerSize = sizeof(DWORDLONG);
+    } else if (Event->EventHeader.Flags & YORI_EVENT_HEADER_FLAG_32_BIT_HEADER) {
+        PointerSize = sizeof(DWORD);
+    }
+
+    if (memcmp(&Event->EventHeader.ProviderId, &TimeThisFileIoGuid, sizeof(GUID)) == 0) {
+        TimeThisTraceFileIoEvent(TraceContext, Event, PointerSize);
+    } else if (memcmp(&Event->EventHeader.ProviderId, &TimeThisProcessGuid, sizeof(GUID)) == 0) {
+        TimeThisTraceProcessEvent(TraceContext, Event, PointerSize);
+    } else if (memcmp(&Event->EventHeader.ProviderId, &TimeThisImageGuid, sizeof(GUID)) == 0) {
+        TimeThisTraceImageEvent(TraceContext, Event, PointerSize);
+    }
+}
+
+/**
+ A thread that receives events from the trace session.  This returns when
+ the session is stopped and all events have been delivered.
+
+ @param Context Pointer to the trace context.
+
+ @return The result of ProcessTrace.
+ */
+DWORD WINAPI
+TimeThisTraceConsumerThread(
+    __in LPVOID Context
+    )
+{
+    PTIMETHIS_TRACE_CONTEXT TraceContext;
+
+    TraceContext = (PTIMETHIS_TRACE_CONTEXT)Context;
+    return DllAdvApi32.pProcessTrace(&TraceContext->ConsumerHandle, 1, NULL, NULL);
+}
+
+/**
+ Start tracing file I/O, process and image load events for processes
+ launched by this process.  This requires administrative access because it
+ uses the kernel logger session, of which only one can exist on the system.
+
+ @return Pointer to the trace context, or NULL if the trace could not be
+         started.  An error is displayed on failure.
+ */
+PTIMETHIS_TRACE_CONTEXT
+TimeThisTraceStart(VOID)
+{
+    PTIMETHIS_TRACE_CONTEXT TraceContext;
+    YORI_ALLOC_SIZE_T PropertiesSize;
+    DWORD Err;
+    DWORD ThreadId;
+    LPTSTR ErrText;
+
+    YoriLibLoadAdvApi32Functions();
+    if (DllAdvApi32.pCloseTrace == NULL ||
+        DllAdvApi32.pControlTraceW == NULL ||
+        DllAdvApi32.pOpenTraceW == NULL ||
+        DllAdvApi32.pProcessTrace == NULL ||
+        DllAdvApi32.pStartTraceW == NULL) {
+
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("timethis: OS support not present\n"));
+        return NULL;
+    }
+
+    TraceContext = YoriLibMalloc(sizeof(TIMETHIS_TRACE_CONTEXT));
+    if (TraceContext == NULL) {
+        return NULL;
+    }
+
+    ZeroMemory(TraceContext, sizeof(TIMETHIS_TRACE_CONTEXT));
+    TraceContext->ConsumerHandle = YORI_INVALID_PROCESSTRACE_HANDLE;
+
+    TraceContext->Files = YoriLibAllocateHashTable(1000);
+    TraceContext->Images = YoriLibAllocateHashTable(100);
+    if (TraceContext->Files == NULL ||
+        TraceContext->Images == NULL ||
+        !TimeThisTraceTableInitialize(&TraceContext->Processes, 64) ||
+        !TimeThisTraceTableInitialize(&TraceContext->Irps, 256) ||
+        !TimeThisTraceTableInitialize(&TraceContext->FileObjects, 1024) ||
+        !TimeThisTraceTableInsert(&TraceContext->Processes, GetCurrentProcessId(), NULL, NULL)) {
+
+        goto Fail;
+    }
+
+    PropertiesSize = sizeof(YORI_EVENT_TRACE_PROPERTIES) + sizeof(YORI_KERNEL_LOGGER_NAME);
+    TraceContext->Properties = YoriLibMalloc(PropertiesSize);
+    if (TraceContext->Properties == NULL) {
+        goto Fail;
+    }
+
+    ZeroMemory(TraceContext->Properties, PropertiesSize);
+    TraceContext->Properties->Wnode.BufferSize = PropertiesSize;
+    TraceContext->Properties->Wnode.Flags = YORI_WNODE_FLAG_TRACED_GUID;
+    TraceContext->Properties->Wnode.ClientContext = 1;
+    memcpy(&TraceContext->Properties->Wnode.Guid, &TimeThisSystemTraceControlGuid, sizeof(GUID));
+    TraceContext->Properties->BufferSize = 64;
+    TraceContext->Properties->LogFileMode = YORI_EVENT_TRACE_REAL_TIME_MODE;
+    TraceContext->Properties->FlushTimer = 1;
+    TraceContext->Properties->EnableFlags = YORI_EVENT_TRACE_FLAG_PROCESS |
+                                            YORI_EVENT_TRACE_FLAG_IMAGE_LOAD |
+                                            YORI_EVENT_TRACE_FLAG_FILE_IO |
+                                            YORI_EVENT_TRACE_FLAG_FILE_IO_INIT;
+    TraceContext->Properties->LoggerNameOffset = sizeof(YORI_EVENT_TRACE_PROPERTIES);
+
+    Err = DllAdvApi32.pStartTraceW(&TraceContext->SessionHandle, YORI_KERNEL_LOGGER_NAME, TraceContext->Properties);
+    if (Err == ERROR_ALREADY_EXISTS) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("timethis: the kernel logger is already in use by another program\n"));
+        goto Fail;
+    } else if (Err != ERROR_SUCCESS) {
+        ErrText = YoriLibGetWinErrorText(Err);
+        if (Err == ERROR_ACCESS_DENIED) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("timethis: tracing requires administrative access: %s"), ErrText);
+        } else {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("timethis: could not start trace: %s"), ErrText);
+        }
+        YoriLibFreeWinErrorText(ErrText);
+        goto Fail;
+    }
+
+    TraceContext->SessionStarted = TRUE;
+
+    TraceContext->LogFile.LoggerName = YORI_KERNEL_LOGGER_NAME;
+    TraceContext->LogFile.ProcessTraceMode = YORI_PROCESS_TRACE_MODE_REAL_TIME | YORI_PROCESS_TRACE_MODE_EVENT_RECORD;
+    TraceContext->LogFile.EventRecordCallback = TimeThisTraceEventCallback;
+    TraceContext->LogFile.Context = TraceContext;
+
+    TraceContext->ConsumerHandle = DllAdvApi32.pOpenTraceW(&TraceContext->LogFile);
+    if (TraceContext->ConsumerHandle == YORI_INVALID_PROCESSTRACE_HANDLE) {
+        Err = GetLastError();
+        ErrText = YoriLibGetWinErrorText(Err);
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("timethis: could not open trace: %s"), ErrText);
+        YoriLibFreeWinErrorText(ErrText);
+        goto Fail;
+    }
+
+    TraceContext->ConsumerThread = CreateThread(NULL, 0, TimeThisTraceConsumerThread, TraceContext, 0, &ThreadId);
+    if (TraceContext->ConsumerThread == NULL) {
+        Err = GetLastError();
+        ErrText = YoriLibGetWinErrorText(Err);
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("timethis: could not create thread: %s"), ErrText);
+        YoriLibFreeWinErrorText(ErrText);
+        goto Fail;
+    }
+
+    return TraceContext;
+
+Fail:
+    TimeThisTraceFree(TraceContext);
+    return NULL;
+}
+
+/**
+ Stop the trace session and wait for all outstanding events to be
+ processed.  Once this returns, the results of the trace can be displayed.
+
+ @param TraceContext Pointer to the trace context.
+ */
+VOID
+TimeThisTraceStop(
+    __in PTIMETHIS_TRACE_CONTEXT TraceContext
+    )
+{
+    if (TraceContext->SessionStarted) {
+        if (DllAdvApi32.pControlTraceW(TraceContext->SessionHandle, NULL, TraceContext->Properties, YORI_EVENT_TRACE_CONTROL_STOP) == ERROR_SUCCESS) {
+            TraceContext->EventsLost = TraceContext->Properties->EventsLost + TraceContext->Properties->RealTimeBuffersLost;
+        }
+        TraceContext->SessionStarted = FALSE;
+    }
+
+    //
+    //  Stopping the session causes the consumer to return once buffered
+    //  events are delivered.  If that does not happen promptly, closing the
+    //  consumer forces it to return.
+    //
+
+    if (TraceContext->ConsumerThread != NULL) {
+        if (WaitForSingleObject(TraceContext->ConsumerThread, TIMETHIS_TRACE_DRAIN_TIMEOUT) != WAIT_OBJECT_0) {
+            DllAdvApi32.pCloseTrace(TraceContext->ConsumerHandle);
+            TraceContext->ConsumerHandle = YORI_INVALID_PROCESSTRACE_HANDLE;
+            WaitForSingleObject(TraceContext->ConsumerThread, INFINITE);
+        }
+        CloseHandle(TraceContext->ConsumerThread);
+        TraceContext->ConsumerThread = NULL;
+    }
+
+    if (TraceContext->ConsumerHandle != YORI_INVALID_PROCESSTRACE_HANDLE) {
+        DllAdvApi32.pCloseTrace(TraceContext->ConsumerHandle);
+        TraceContext->ConsumerHandle = YORI_INVALID_PROCESSTRACE_HANDLE;
+    }
+}
+
+/**
+ Return TRUE if the first record should be displayed before the second.
+ Records are ordered by time spent waiting for I/O, then by the number of
+ opens.
+
+ @param Left Pointer to the first record.
+
+ @param Right Pointer to the second record.
+
+ @return TRUE if Left should be displayed before Right.
+ */
+BOOLEAN
+TimeThisTraceIsFileBefore(
+    __in PTIMETHIS_TRACE_FILE Left,
+    __in PTIMETHIS_TRACE_FILE Right
+    )
+{
+    if (Left->IoTime != Right->IoTime) {
+        return (BOOLEAN)(Left->IoTime > Right->IoTime);
+    }
+    if (Left->Opens != Right->Opens) {
+        return (BOOLEAN)(Left->Opens > Right->Opens);
+    }
+    return (BOOLEAN)(Left->ReadBytes + Left->WriteBytes > Right->ReadBytes + Right->WriteBytes);
+}
+
+/**
+ Move an element down a heap until the heap property is restored.  The
+ heap is arranged so the record that should be displayed last is at the
+ root.
+
+ @param Array Pointer to the array of records.
+
+ @param Index The index of the element to move.
+
+ @param Count The number of elements in the heap.
+ */
+VOID
+TimeThisTraceSiftDown(
+    __inout PTIMETHIS_TRACE_FILE *Array,
+    __in YORI_ALLOC_SIZE_T Index,
+    __in YORI_ALLOC_SIZE_T Count
+    )
+{
+    YORI_ALLOC_SIZE_T Child;
+    PTIMETHIS_TRACE_FILE Swap;
+
+    while (Index < Count / 2) {
+        Child = Index * 2 + 1;
+        if (Child + 1 < Count && TimeThisTraceIsFileBefore(Array[Child], Array[Child + 1])) {
+            Child++;
+        }
+
+        if (!TimeThisTraceIsFileBefore(Array[Index], Array[Child])) {
+            break;
+        }
+
+        Swap = Array[Index];
+        Array[Index] = Array[Child];
+        Array[Child] = Swap;
+        Index = Child;
+    }
+}
+
+/**
+ Sort an array of records into display order.
+
+ @param Array Pointer to the array of records.
+
+ @param Count The number of elements in the array.
+ */
+VOID
+TimeThisTraceSortFiles(
+    __inout PTIMETHIS_TRACE_FILE *Array,
+    __in YORI_ALLOC_SIZE_T Count
+    )
+{
+    YORI_ALLOC_SIZE_T Index;
+    PTIMETHIS_TRACE_FILE Swap;
+
+    if (Count < 2) {
+        return;
+    }
+
+    for (Index = Count / 2; Index > 0; Index--) {
+        TimeThisTraceSiftDown(Array, Index - 1, Count);
+    }
+
+    for (Index = Count - 1; Index > 0; Index--) {
+        Swap = Array[0];
+        Array[0] = Array[Index];
+        Array[Index] = Swap;
+        TimeThisTraceSiftDown(Array, 0, Index);
+    }
+}
+
+/**
+ Collect the records in a hash table into an array sorted into display
+ order.
+
+ @param Table The hash table of records.
+
+ @param Count The number of records in the hash table.
+
+ @return Pointer to an array of records, which should be freed with
+         YoriLibFree, or NULL on allocation failure.
+ */
+PTIMETHIS_TRACE_FILE *
+TimeThisTraceCollectFiles(
+    __in PYORI_HASH_TABLE Table,
+    __in YORI_ALLOC_SIZE_T Count
+    )
+{
+    PTIMETHIS_TRACE_FILE *Array;
+    PYORI_HASH_ENTRY HashEntry;
+    YORI_ALLOC_SIZE_T Index;
+
+    Array = YoriLibMalloc((Count + 1) * sizeof(PTIMETHIS_TRACE_FILE));
+    if (Array == NULL) {
+        return NULL;
+    }
+
+    Index = 0;
+    HashEntry = YoriLibHashGetNextEntry(Table, NULL);
+    while (HashEntry != NULL && Index < Count) {
+        Array[Index] = HashEntry->Context;
+        Index++;
+        HashEntry = YoriLibHashGetNextEntry(Table, HashEntry);
+    }
+
+    TimeThisTraceSortFiles(Array, Index);
+    return Array;
+}
+
+/**
+ Display the results of a trace.
+
+ @param TraceContext Pointer to the trace context.  The trace must have been
+        stopped.
+ */
+VOID
+TimeThisTraceDisplay(
+    __in PTIMETHIS_TRACE_CONTEXT TraceContext
+    )
+{
+    PTIMETHIS_TRACE_FILE *Array;
+    PTIMETHIS_TRACE_FILE File;
+    YORI_ALLOC_SIZE_T Index;
+    DWORD FailedOpens;
+
+    FailedOpens = 0;
+    Array = TimeThisTraceCollectFiles(TraceContext->Files, TraceContext->FileCount);
+    if (Array == NULL) {
+        return;
+    }
+
+    for (Index = 0; Index < TraceContext->FileCount; Index++) {
+        FailedOpens = FailedOpens + Array[Index]->FailedOpens;
+    }
+
+    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("\nTrace processes:   %i\n"), TraceContext->ProcessCount);
+    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("Trace files:       %i (%i failed opens)\n"), TraceContext->FileCount, FailedOpens);
+    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("Trace images:      %i\n"), TraceContext->ImageCount);
+    if (TraceContext->EventsLost > 0 || TraceContext->EventsDropped > 0) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("Trace events lost: %i\n"), TraceContext->EventsLost + TraceContext->EventsDropped);
+    }
+
+    if (TraceContext->FileCount > 0) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("\n  Opens  Failed   Reads   Read bytes  Writes  Write bytes  I/O ms  Max ms File\n"));
+        for (Index = 0; Index < TraceContext->FileCount; Index++) {
+            File = Array[Index];
+            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT,
+                          _T("%7i %7i %7i %12lli %7i %12lli %7lli %7lli %y\n"),
+                          File->Opens,
+                          File->FailedOpens,
+                          File->Reads,
+                          File->ReadBytes,
+                          File->Writes,
+                          File->WriteBytes,
+                          File->IoTime / 10000,
+                          File->MaxLatency / 10000,
+                          &File->HashEntry.Key);
+        }
+    }
+    YoriLibFree(Array);
+
+    if (TraceContext->ImageCount > 0) {
+        Array = TimeThisTraceCollectFiles(TraceContext->Images, TraceContext->ImageCount);
+        if (Array == NULL) {
+            return;
+        }
+
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("\n  Loads Image\n"));
+        for (Index = 0; Index < TraceContext->ImageCount; Index++) {
+            File = Array[Index];
+            YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%7i %y\n"), File->Opens, &File->HashEntry.Key);
+        }
+        YoriLibFree(Array);
+    }
+}
+
+/**
+ Free all of the records in a hash table of files or images, and the table
+ itself.
+
+ @param Table The hash table to free.
+ */
+VOID
+TimeThisTraceFreeFiles(
+    __in PYORI_HASH_TABLE Table
+    )
+{
+    PYORI_HASH_ENTRY HashEntry;
+    PTIMETHIS_TRACE_FILE File;
+
+    HashEntry = YoriLibHashGetNextEntry(Table, NULL);
+    while (HashEntry != NULL) {
+        File = HashEntry->Context;
+        YoriLibHashRemoveByEntry(HashEntry);
+        YoriLibFree(File);
+        HashEntry = YoriLibHashGetNextEntry(Table, NULL);
+    }
+    YoriLibFreeEmptyHashTable(Table);
+}
+
+/**
+ Free a trace context, stopping the trace if it is still running.
+
+ @param TraceContext Pointer to the trace context.
+ */
+VOID
+TimeThisTraceFree(
+    __in PTIMETHIS_TRACE_CONTEXT TraceContext
+    )
+{
+    YORI_ALLOC_SIZE_T Index;
+
+    TimeThisTraceStop(TraceContext);
+
+    for (Index = 0; Index < TraceContext->Irps.Capacity; Index++) {
+        if (TraceContext->Irps.Slots[Index].Key != 0) {
+            YoriLibFree(TraceContext->Irps.Slots[Index].Value);
+        }
+    }
+
+    TimeThisTraceTableCleanup(&TraceContext->Irps);
+    TimeThisTraceTableCleanup(&TraceContext->FileObjects);
+    TimeThisTraceTableCleanup(&TraceContext->Processes);
+
+    if (TraceContext->Files != NULL) {
+        TimeThisTraceFreeFiles(TraceContext->Files);
+    }
+    if (TraceContext->Images != NULL) {
+        TimeThisTraceFreeFiles(TraceContext->Images);
+    }
+    if (TraceContext->Properties != NULL) {
+        YoriLibFree(TraceContext->Properties);
+    }
+    YoriLibFree(TraceContext);
+}
+
+// vim:sw=4:ts=4:et:
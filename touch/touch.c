@@ -3,7 +3,7 @@
  *
  * Yori create files or update timestamps
  *
- * Copyright (c) 2018-2022 Malcolm J. Smith
+ * Copyright (c) 2018-2026 Malcolm J. Smith
  *
  * Permission is hereby granted, free of charge, to any person obtaining a copy
  * of this software and associated documentation files (the "Software"), to deal
@@ -35,8 +35,8 @@ CHAR strTouchHelpText[] =
         "\n"
         "Create files or update timestamps.\n"
         "\n"
-        "TOUCH [-license] [-a] [-b] [-c] [-e] [-f size] [-h] [-s] [-t <date and time>]\n"
-        "      [-w] <file>...\n"
+        "TOUCH [-license] [-a] [-b] [-c] [-e] [-f size [-p|-sparse] [-v]] [-h]\n"
+        "      [-j <n>] [-s] [-t <date and time>] [-w] <file>...\n"
         "\n"
         "   -a             Update last access time\n"
         "   -b             Use basic search criteria for files only\n"
@@ -44,8 +44,14 @@ CHAR strTouchHelpText[] =
         "   -e             Only update existing files\n"
         "   -f             Create new file with specified file size\n"
         "   -h             Operate on links as opposed to link targets\n"
+        "   -j             Create or update the specified number of files concurrently\n"
+        "   -p             Allocate space for new files before extending them\n"
         "   -s             Process files from all subdirectories\n"
+        "   -sparse        Create new files as sparse files\n"
         "   -t             Specify the timestamp to set\n"
+        "   -v             Mark new file contents valid without writing zeroes.  This\n"
+        "                    requires manage volume privilege and exposes any data\n"
+        "                    previously stored in the space allocated\n"
         "   -w             Update write time\n";
 
 /**
@@ -104,44 +110,165 @@ typedef struct _TOUCH_CONTEXT {
      */
     BOOLEAN NoFollowLinks;
 
+    /**
+     If TRUE, space for new files should be allocated before the file size
+     is set, so the file system can allocate it contiguously.
+     */
+    BOOLEAN Preallocate;
+
+    /**
+     If TRUE, new files should be marked sparse before the file size is set,
+     so no space is allocated.
+     */
+    BOOLEAN Sparse;
+
+    /**
+     If TRUE, the contents of new files should be marked as valid, so the
+     file system does not need to write zeroes to them.
+     */
+    BOOLEAN SetValidData;
+
+    /**
+     If existing files are being updated concurrently, points to the pool
+     of threads performing the updates.  NULL if files are updated as they
+     are found.
+     */
+    PYORILIB_FILE_UPDATE_QUEUE UpdateQueue;
+
+    /**
+     If new files are being created concurrently, an array of full paths to
+     files to create.  These are created once all arguments are processed.
+     */
+    PYORI_STRING FilesToCreate;
+
+    /**
+     The number of entries in the FilesToCreate array.
+     */
+    DWORD FilesToCreateCount;
+
+    /**
+     The number of entries allocated in the FilesToCreate array.
+     */
+    DWORD FilesToCreateAllocated;
+
 } TOUCH_CONTEXT, *PTOUCH_CONTEXT;
 
 /**
- A callback that is invoked when a file is found that matches a search criteria
- specified in the set of strings to enumerate.
+ Display an error encountered when touching a file.
 
- @param FilePath Pointer to the file path that was found.
+ @param Action Pointer to a string describing the step that failed.
 
- @param FileInfo Information about the file.  Note in this application this can
-        be NULL when it is operating on files that do not yet exist.
+ @param FilePath Pointer to the file being touched.
 
- @param Depth Specifies the recursion depth.  Ignored in this application.
+ @param LastError The Win32 error code describing the failure.
+ */
+VOID
+TouchReportError(
+    __in LPCTSTR Action,
+    __in PYORI_STRING FilePath,
+    __in DWORD LastError
+    )
+{
+    LPTSTR ErrText = YoriLibGetWinErrorText(LastError);
+    YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("touch: %s of %y failed: %s"), Action, FilePath, ErrText);
+    YoriLibFreeWinErrorText(ErrText);
+}
 
- @param Context Pointer to the touch context structure indicating the
-        action to perform and populated with the file and line count found.
+/**
+ Set the size of a newly created file.  Depending on the options specified,
+ the file is marked sparse, or space for it is allocated before the size is
+ set, and its contents can be marked valid so that the file system does not
+ write zeroes to it.  Failures are reported but do not prevent the
+ remaining steps.
 
- @return TRUE to continute enumerating, FALSE to abort.
+ @param TouchContext Pointer to the context describing the file size and
+        how to allocate it.
+
+ @param FileHandle Handle to the new file, opened for write.
+
+ @param FilePath Pointer to the path of the file, used for error messages.
+ */
+VOID
+TouchSetNewFileSize(
+    __in PTOUCH_CONTEXT TouchContext,
+    __in HANDLE FileHandle,
+    __in PYORI_STRING FilePath
+    )
+{
+    YORI_FILE_ALLOCATION_INFORMATION AllocationInfo;
+    YORI_FILE_VALID_DATA_LENGTH_INFORMATION ValidDataInfo;
+    IO_STATUS_BLOCK IoStatusBlock;
+    LARGE_INTEGER NewFileSize;
+    DWORD BytesReturned;
+    LONG NtStatus;
+    LPTSTR ErrText;
+
+    if (TouchContext->Sparse) {
+        if (!DeviceIoControl(FileHandle, FSCTL_SET_SPARSE, NULL, 0, NULL, 0, &BytesReturned, NULL)) {
+            TouchReportError(_T("marking sparse"), FilePath, GetLastError());
+        }
+    } else if (TouchContext->Preallocate && DllNtDll.pNtSetInformationFile != NULL) {
+
+        //
+        //  Requesting the full allocation in one operation lets the file
+        //  system find a contiguous range, rather than growing the file
+        //  as it is written.
+        //
+
+        AllocationInfo.AllocationSize.QuadPart = TouchContext->NewFileSize.QuadPart;
+        NtStatus = DllNtDll.pNtSetInformationFile(FileHandle, &IoStatusBlock, &AllocationInfo, sizeof(AllocationInfo), FileAllocationInformation);
+        if (NtStatus != 0) {
+            ErrText = YoriLibGetNtErrorText(NtStatus);
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("touch: allocating space of %y failed: %s"), FilePath, ErrText);
+            YoriLibFreeWinErrorText(ErrText);
+        }
+    }
+
+    NewFileSize.QuadPart = TouchContext->NewFileSize.QuadPart;
+    SetFilePointer(FileHandle, NewFileSize.LowPart, &NewFileSize.HighPart, FILE_BEGIN);
+    if (!SetEndOfFile(FileHandle)) {
+        TouchReportError(_T("setting file size"), FilePath, GetLastError());
+        return;
+    }
+
+    if (TouchContext->SetValidData && DllNtDll.pNtSetInformationFile != NULL) {
+        ValidDataInfo.ValidDataLength.QuadPart = TouchContext->NewFileSize.QuadPart;
+        NtStatus = DllNtDll.pNtSetInformationFile(FileHandle, &IoStatusBlock, &ValidDataInfo, sizeof(ValidDataInfo), FileValidDataLengthInformation);
+        if (NtStatus != 0) {
+            ErrText = YoriLibGetNtErrorText(NtStatus);
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("touch: setting valid data of %y failed: %s"), FilePath, ErrText);
+            YoriLibFreeWinErrorText(ErrText);
+        }
+    }
+}
+
+/**
+ Open a file, creating it if it does not exist and this is requested, and
+ apply the requested size and timestamps.
+
+ @param TouchContext Pointer to the context describing the changes to apply.
+
+ @param FilePath Pointer to a NULL terminated full path to the file.
+
+ @param NewFile TRUE if the file was not found and should be created.  FALSE
+        if the file exists.
+
+ @return TRUE if the file was opened, FALSE if it could not be opened.  Any
+         error is displayed before returning.
  */
 BOOL
-TouchFileFoundCallback(
+TouchOpenAndUpdateFile(
+    __in PTOUCH_CONTEXT TouchContext,
     __in PYORI_STRING FilePath,
-    __in_opt PWIN32_FIND_DATA FileInfo,
-    __in DWORD Depth,
-    __in PVOID Context
+    __in BOOLEAN NewFile
     )
 {
     HANDLE FileHandle;
     DWORD DesiredAccess;
     DWORD OpenFlags;
-    PTOUCH_CONTEXT TouchContext = (PTOUCH_CONTEXT)Context;
-
-    UNREFERENCED_PARAMETER(Depth);
-    UNREFERENCED_PARAMETER(FileInfo);
-
-    ASSERT(YoriLibIsStringNullTerminated(FilePath));
 
     DesiredAccess = GENERIC_READ | FILE_WRITE_ATTRIBUTES;
-    if (FileInfo == NULL) {
+    if (NewFile) {
         DesiredAccess |= GENERIC_WRITE;
     }
 
@@ -159,36 +286,20 @@ TouchFileFoundCallback(
                             NULL);
 
     if (FileHandle == NULL || FileHandle == INVALID_HANDLE_VALUE) {
-        DWORD LastError = GetLastError();
-        LPTSTR ErrText = YoriLibGetWinErrorText(LastError);
-        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("touch: open of %y failed: %s"), FilePath, ErrText);
-        YoriLibFreeWinErrorText(ErrText);
-        return TRUE;
+        TouchReportError(_T("open"), FilePath, GetLastError());
+        return FALSE;
     }
 
-    TouchContext->FilesFoundThisArg++;
+    if (NewFile && TouchContext->NewFileSize.QuadPart != 0) {
+        TouchSetNewFileSize(TouchContext, FileHandle, FilePath);
 
-    if (FileInfo == NULL) {
-        if (TouchContext->NewFileSize.QuadPart != 0) {
-            SetFilePointer(FileHandle, TouchContext->NewFileSize.LowPart, &TouchContext->NewFileSize.HighPart, FILE_BEGIN);
-            if (!SetEndOfFile(FileHandle)) {
-                DWORD LastError = GetLastError();
-                LPTSTR ErrText = YoriLibGetWinErrorText(LastError);
-                YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("touch: setting file size of %y failed: %s"), FilePath, ErrText);
-                YoriLibFreeWinErrorText(ErrText);
-
-                //
-                //  Intentional fallout
-                //
-            }
-        }
+        //
+        //  Intentional fallout
+        //
     }
 
     if (!SetFileTime(FileHandle, &TouchContext->NewCreationTime, &TouchContext->NewAccessTime, &TouchContext->NewWriteTime)) {
-        DWORD LastError = GetLastError();
-        LPTSTR ErrText = YoriLibGetWinErrorText(LastError);
-        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("touch: updating timestamps of %y failed: %s"), FilePath, ErrText);
-        YoriLibFreeWinErrorText(ErrText);
+        TouchReportError(_T("updating timestamps"), FilePath, GetLastError());
 
         //
         //  Intentional fallout
@@ -199,6 +310,148 @@ TouchFileFoundCallback(
     return TRUE;
 }
 
+/**
+ A callback that is invoked when a file is found that matches a search criteria
+ specified in the set of strings to enumerate.
+
+ @param FilePath Pointer to the file path that was found.
+
+ @param FileInfo Information about the file.  Note in this application this can
+        be NULL when it is operating on files that do not yet exist.
+
+ @param Depth Specifies the recursion depth.  Ignored in this application.
+
+ @param Context Pointer to the touch context structure indicating the
+        action to perform and populated with the file and line count found.
+
+ @return TRUE to continute enumerating, FALSE to abort.
+ */
+BOOL
+TouchFileFoundCallback(
+    __in PYORI_STRING FilePath,
+    __in_opt PWIN32_FIND_DATA FileInfo,
+    __in DWORD Depth,
+    __in PVOID Context
+    )
+{
+    PTOUCH_CONTEXT TouchContext = (PTOUCH_CONTEXT)Context;
+
+    UNREFERENCED_PARAMETER(Depth);
+
+    ASSERT(YoriLibIsStringNullTerminated(FilePath));
+
+    if (FileInfo != NULL && TouchContext->UpdateQueue != NULL) {
+        TouchContext->FilesFoundThisArg++;
+        YoriLibFileUpdateQueueSubmit(TouchContext->UpdateQueue, FilePath);
+        return TRUE;
+    }
+
+    if (TouchOpenAndUpdateFile(TouchContext, FilePath, (BOOLEAN)(FileInfo == NULL))) {
+        TouchContext->FilesFoundThisArg++;
+    }
+
+    return TRUE;
+}
+
+/**
+ Add a file to the set of files to create concurrently once all arguments
+ have been processed.
+
+ @param TouchContext Pointer to the context containing the set of files to
+        create.
+
+ @param FilePath Pointer to a full path to the file.  On success, ownership
+        of the string's allocation is transferred to the context.
+
+ @return TRUE to indicate the file was added, FALSE on allocation failure.
+ */
+BOOL
+TouchAddFileToCreate(
+    __inout PTOUCH_CONTEXT TouchContext,
+    __in PYORI_STRING FilePath
+    )
+{
+    PYORI_STRING NewFiles;
+    DWORD NewAllocated;
+
+    if (TouchContext->FilesToCreateCount >= TouchContext->FilesToCreateAllocated) {
+        NewAllocated = TouchContext->FilesToCreateAllocated * 2;
+        if (NewAllocated < 64) {
+            NewAllocated = 64;
+        }
+        if (!YoriLibIsSizeAllocatable(NewAllocated * sizeof(YORI_STRING))) {
+            return FALSE;
+        }
+        NewFiles = YoriLibMalloc((YORI_ALLOC_SIZE_T)(NewAllocated * sizeof(YORI_STRING)));
+        if (NewFiles == NULL) {
+            return FALSE;
+        }
+        if (TouchContext->FilesToCreate != NULL) {
+            memcpy(NewFiles, TouchContext->FilesToCreate, TouchContext->FilesToCreateCount * sizeof(YORI_STRING));
+            YoriLibFree(TouchContext->FilesToCreate);
+        }
+        TouchContext->FilesToCreate = NewFiles;
+        TouchContext->FilesToCreateAllocated = NewAllocated;
+    }
+
+    memcpy(&TouchContext->FilesToCreate[TouchContext->FilesToCreateCount], FilePath, sizeof(YORI_STRING));
+    TouchContext->FilesToCreateCount++;
+    return TRUE;
+}
+
+/**
+ Create a single file from the set of files to create.  This is invoked on
+ multiple threads concurrently, each with a different file.
+
+ @param Context Pointer to the touch context.
+
+ @param Index The index of the file to create within FilesToCreate.
+ */
+VOID
+TouchCreateEntry(
+    __in PVOID Context,
+    __in DWORD Index
+    )
+{
+    PTOUCH_CONTEXT TouchContext;
+
+    TouchContext = (PTOUCH_CONTEXT)Context;
+    TouchOpenAndUpdateFile(TouchContext, &TouchContext->FilesToCreate[Index], TRUE);
+}
+
+/**
+ Create the set of files that were found not to exist, using the specified
+ number of threads, and free the set.  Each file is created and sized
+ independently, so for large files the time spent allocating space and
+ extending files on one thread overlaps with others.
+
+ @param TouchContext Pointer to the context containing the set of files to
+        create.
+
+ @param ThreadCount The number of threads to use, including the calling
+        thread.
+ */
+VOID
+TouchCreateFiles(
+    __inout PTOUCH_CONTEXT TouchContext,
+    __in DWORD ThreadCount
+    )
+{
+    DWORD Index;
+
+    YoriLibProcessItemsInParallel(TouchContext->FilesToCreateCount, ThreadCount, TouchCreateEntry, TouchContext);
+
+    for (Index = 0; Index < TouchContext->FilesToCreateCount; Index++) {
+        YoriLibFreeStringContents(&TouchContext->FilesToCreate[Index]);
+    }
+    if (TouchContext->FilesToCreate != NULL) {
+        YoriLibFree(TouchContext->FilesToCreate);
+    }
+    TouchContext->FilesToCreate = NULL;
+    TouchContext->FilesToCreateCount = 0;
+    TouchContext->FilesToCreateAllocated = 0;
+}
+
 #ifdef YORI_BUILTIN
 /**
  The main entrypoint for the touch builtin command.
@@ -236,6 +489,8 @@ ENTRYPOINT(
     BOOLEAN UpdateLastAccess = FALSE;
     BOOLEAN UpdateCreationTime = FALSE;
     BOOLEAN UpdateWriteTime = FALSE;
+    DWORD ThreadCount = 1;
+    YORILIB_FILE_UPDATE_OPERATION UpdateOperation;
     SYSTEMTIME CurrentSystemTime;
     FILETIME TimestampToUse;
     TOUCH_CONTEXT TouchContext;
@@ -259,7 +514,7 @@ ENTRYPOINT(
                 TouchHelp();
                 return EXIT_SUCCESS;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("license")) == 0) {
-                YoriLibDisplayMitLicense(_T("2018-2022"));
+                YoriLibDisplayMitLicense(_T("2018-2026"));
                 return EXIT_SUCCESS;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("a")) == 0) {
                 UpdateLastAccess = TRUE;
@@ -282,9 +537,30 @@ ENTRYPOINT(
             } else if (YoriLibCompareStringLitIns(&Arg, _T("h")) == 0) {
                 TouchContext.NoFollowLinks = TRUE;
                 ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("p")) == 0) {
+                TouchContext.Preallocate = TRUE;
+                TouchContext.Sparse = FALSE;
+                ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("j")) == 0) {
+                if (i + 1 < ArgC) {
+                    YORI_MAX_SIGNED_T LlThreadCount = 0;
+                    YORI_ALLOC_SIZE_T CharsConsumed = 0;
+                    if (YoriLibStringToNumber(&ArgV[i + 1], TRUE, &LlThreadCount, &CharsConsumed) &&
+                        CharsConsumed > 0 &&
+                        LlThreadCount > 0) {
+
+                        ThreadCount = (DWORD)LlThreadCount;
+                        ArgumentUnderstood = TRUE;
+                        i++;
+                    }
+                }
             } else if (YoriLibCompareStringLitIns(&Arg, _T("s")) == 0) {
                 Recursive = TRUE;
                 ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("sparse")) == 0) {
+                TouchContext.Sparse = TRUE;
+                TouchContext.Preallocate = FALSE;
+                ArgumentUnderstood = TRUE;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("t")) == 0) {
                 if (i + 1 < ArgC) {
                     SYSTEMTIME NewTime;
@@ -306,6 +582,9 @@ ENTRYPOINT(
                     }
                     i++;
                 }
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("v")) == 0) {
+                TouchContext.SetValidData = TRUE;
+                ArgumentUnderstood = TRUE;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("w")) == 0) {
                 UpdateWriteTime = TRUE;
                 ArgumentUnderstood = TRUE;
@@ -350,6 +629,22 @@ ENTRYPOINT(
         TouchContext.NewWriteTime.dwHighDateTime = (DWORD)-1;
     }
 
+    //
+    //  Marking data valid requires a privilege, and isn't meaningful for a
+    //  sparse file, which has no allocation to expose.  If the privilege
+    //  isn't available, new files are still created, and the file system
+    //  zeroes them as usual.
+    //
+
+    if (TouchContext.SetValidData) {
+        if (TouchContext.Sparse) {
+            TouchContext.SetValidData = FALSE;
+        } else if (!YoriLibEnableManageVolumePrivilege()) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("touch: manage volume privilege is not available, file contents will not be marked valid\n"));
+            TouchContext.SetValidData = FALSE;
+        }
+    }
+
     //
     //  If no file name is specified, use stdin; otherwise open
     //  the file and use that
@@ -359,6 +654,26 @@ ENTRYPOINT(
         YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("touch: missing argument\n"));
         return EXIT_FAILURE;
     } else {
+
+        //
+        //  Files that already exist can be updated concurrently as they
+        //  are found.  Files that need to be created are collected and
+        //  created concurrently once all arguments are processed.
+        //
+
+        if (ThreadCount > 1) {
+            ZeroMemory(&UpdateOperation, sizeof(UpdateOperation));
+            UpdateOperation.Flags = YORILIB_FILE_UPDATE_SET_TIMES;
+            if (TouchContext.NoFollowLinks) {
+                UpdateOperation.Flags |= YORILIB_FILE_UPDATE_NO_FOLLOW_LINKS;
+            }
+            UpdateOperation.CreationTime = TouchContext.NewCreationTime;
+            UpdateOperation.LastAccessTime = TouchContext.NewAccessTime;
+            UpdateOperation.LastWriteTime = TouchContext.NewWriteTime;
+            UpdateOperation.ProgramName = _T("touch");
+            TouchContext.UpdateQueue = YoriLibFileUpdateQueueCreate(&UpdateOperation, ThreadCount);
+        }
+
         MatchFlags = YORILIB_FILEENUM_RETURN_FILES | YORILIB_FILEENUM_RETURN_DIRECTORIES;
         if (Recursive) {
             MatchFlags |= YORILIB_FILEENUM_RECURSE_BEFORE_RETURN | YORILIB_FILEENUM_RECURSE_PRESERVE_WILD;
@@ -375,11 +690,25 @@ ENTRYPOINT(
                 YORI_STRING FullPath;
                 YoriLibInitEmptyString(&FullPath);
                 if (YoriLibUserStringToSingleFilePath(&ArgV[i], TRUE, &FullPath)) {
-                    TouchFileFoundCallback(&FullPath, NULL, 0, &TouchContext);
-                    YoriLibFreeStringContents(&FullPath);
+                    if (ThreadCount > 1 &&
+                        TouchAddFileToCreate(&TouchContext, &FullPath)) {
+
+                        YoriLibInitEmptyString(&FullPath);
+                    } else {
+                        TouchFileFoundCallback(&FullPath, NULL, 0, &TouchContext);
+                        YoriLibFreeStringContents(&FullPath);
+                    }
                 }
             }
         }
+
+        if (TouchContext.FilesToCreateCount > 0) {
+            TouchCreateFiles(&TouchContext, ThreadCount);
+        }
+
+        if (TouchContext.UpdateQueue != NULL) {
+            YoriLibFileUpdateQueueDestroy(TouchContext.UpdateQueue);
+        }
     }
 
     return EXIT_SUCCESS;
@@ -142,7 +142,7 @@ TypeProcessStream(
 
     while (TRUE) {
 
-        if (!YoriLibReadLineToString(&LineString, &LineContext, hSource)) {
+        if (!YoriLibReadLineToView(&LineString, &LineContext, hSource)) {
             break;
         }
 
@@ -169,7 +169,6 @@ TypeProcessStream(
     }
 
     YoriLibLineReadCloseOrCache(LineContext);
-    YoriLibFreeStringContents(&LineString);
 
     return TRUE;
 }
@@ -414,6 +413,13 @@ ENTRYPOINT(
 
     YoriLibEnableBackupPrivilege();
 
+    //
+    //  Buffer output so that each line isn't written separately when output
+    //  is going to a file or pipe.
+    //
+
+    YoriLibOutputBufferEnable(GetStdHandle(STD_OUTPUT_HANDLE));
+
     //
     //  If no file name is specified, use stdin; otherwise open
     //  the file and use that
@@ -421,6 +427,7 @@ ENTRYPOINT(
 
     if (StartArg == 0 || StartArg == ArgC) {
         if (YoriLibIsStdInConsole()) {
+            YoriLibOutputBufferDisable(GetStdHandle(STD_OUTPUT_HANDLE));
             YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("No file or pipe for input\n"));
             return EXIT_FAILURE;
         }
@@ -461,6 +468,8 @@ ENTRYPOINT(
         }
     }
 
+    YoriLibOutputBufferDisable(GetStdHandle(STD_OUTPUT_HANDLE));
+
 #if !YORI_BUILTIN
     YoriLibLineReadCleanupCache();
 #endif
@@ -38,7 +38,7 @@ CHAR strVhdToolHelpText[] =
         "VHDTOOL [-license]\n"
         "VHDTOOL [-sector:512|-sector:512e|-sector:4096] -clonedynamic <file> <source>\n"
         "VHDTOOL [-sector:512|-sector:512e|-sector:4096] -clonefixed <file> <source>\n"
-        "VHDTOOL -compact <file>\n"
+        "VHDTOOL [-fs] -compact <file>\n"
         "VHDTOOL -creatediff <file> <parent>\n"
         "VHDTOOL [-sector:512|-sector:512e|-sector:4096] -createdynamic <file> <size>\n"
         "VHDTOOL [-sector:512|-sector:512e|-sector:4096] -createfixed <file> <size>\n"
@@ -60,6 +60,8 @@ CHAR strVhdToolHelpText[] =
         "                  specified with a 'k', 'm', 'g', or 't' suffix.\n"
         "   -expand        Increase the size of a .vhd or .vhdx file.  Size can be\n"
         "                  specified with a 'k', 'm', 'g', or 't' suffix.\n"
+        "   -fs            When compacting, attach the disk read only and also remove\n"
+        "                  regions that its file system is not using\n"
         "   -merge         Merge a differencing .vhd or .vhdx file into its parent\n"
         "   -shrink        Decrease the size of a .vhdx file.  Size can be specified\n"
         "                  with a 'k', 'm', 'g', or 't' suffix.\n";
@@ -98,6 +100,212 @@ typedef enum _VHDTOOL_SECTOR_SIZE {
     VhdToolSector4kNative = 3
 } VHDTOOL_SECTOR_SIZE;
 
+/**
+ The number of buffers to use when cloning, allowing data from one buffer to
+ be written to the target while the next buffer is read from the source.
+ */
+#define VHDTOOL_CLONE_BUFFER_COUNT (2)
+
+/**
+ The number of bytes of volume bitmap to request at a time.  Each byte
+ describes eight clusters.
+ */
+#define VHDTOOL_BITMAP_QUERY_SIZE (64 * 1024)
+
+/**
+ A portion of the allocation bitmap of a source volume, used to skip
+ regions of the volume that contain no data.
+ */
+typedef struct _VHDTOOL_VOLUME_BITMAP {
+
+    /**
+     Pointer to the most recently queried portion of the bitmap.
+     */
+    PVOLUME_BITMAP_BUFFER Buffer;
+
+    /**
+     The size of the allocation pointed to by Buffer, in bytes.
+     */
+    DWORD BufferLength;
+
+    /**
+     The number of bytes in each cluster of the volume.
+     */
+    DWORDLONG BytesPerCluster;
+
+    /**
+     The number of clusters on the volume.
+     */
+    DWORDLONG TotalClusters;
+
+    /**
+     The first cluster described by Buffer.
+     */
+    DWORDLONG FirstCluster;
+
+    /**
+     The number of clusters described by Buffer.
+     */
+    DWORDLONG ClusterCount;
+} VHDTOOL_VOLUME_BITMAP, *PVHDTOOL_VOLUME_BITMAP;
+
+/**
+ Query the allocation bitmap of a volume starting from a specified cluster.
+
+ @param SourceHandle Handle to the volume.
+
+ @param Bitmap Pointer to the bitmap to populate.
+
+ @param Cluster The first cluster to describe.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+BOOL
+VhdToolQueryVolumeBitmap(
+    __in HANDLE SourceHandle,
+    __inout PVHDTOOL_VOLUME_BITMAP Bitmap,
+    __in DWORDLONG Cluster
+    )
+{
+    STARTING_LCN_INPUT_BUFFER StartingLcn;
+    DWORD BytesReturned;
+    DWORDLONG ClusterCount;
+
+    StartingLcn.StartingLcn.QuadPart = (LONGLONG)Cluster;
+    if (!DeviceIoControl(SourceHandle, FSCTL_GET_VOLUME_BITMAP, &StartingLcn, sizeof(StartingLcn), Bitmap->Buffer, Bitmap->BufferLength, &BytesReturned, NULL) &&
+        GetLastError() != ERROR_MORE_DATA) {
+
+        return FALSE;
+    }
+
+    if (BytesReturned <= FIELD_OFFSET(VOLUME_BITMAP_BUFFER, Buffer)) {
+        return FALSE;
+    }
+
+    ClusterCount = BytesReturned - FIELD_OFFSET(VOLUME_BITMAP_BUFFER, Buffer);
+    ClusterCount = ClusterCount * 8;
+    if (ClusterCount > (DWORDLONG)Bitmap->Buffer->BitmapSize.QuadPart) {
+        ClusterCount = (DWORDLONG)Bitmap->Buffer->BitmapSize.QuadPart;
+    }
+
+    Bitmap->FirstCluster = (DWORDLONG)Bitmap->Buffer->StartingLcn.QuadPart;
+    Bitmap->ClusterCount = ClusterCount;
+
+    if (Cluster < Bitmap->FirstCluster ||
+        Cluster >= Bitmap->FirstCluster + Bitmap->ClusterCount) {
+
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ Prepare to skip unallocated regions of a source volume.  This is only
+ supported on NTFS, where cluster numbers correspond directly to offsets
+ within the volume.
+
+ @param SourceHandle Handle to the source, which may or may not be a volume.
+
+ @param Bitmap On successful completion, populated with the first portion of
+        the allocation bitmap of the volume.
+
+ @return TRUE if the bitmap was loaded, FALSE if the source should be copied
+         in full.
+ */
+BOOL
+VhdToolLoadVolumeBitmap(
+    __in HANDLE SourceHandle,
+    __out PVHDTOOL_VOLUME_BITMAP Bitmap
+    )
+{
+    NTFS_VOLUME_DATA_BUFFER NtfsVolumeData;
+    DWORD BytesReturned;
+
+    ZeroMemory(Bitmap, sizeof(VHDTOOL_VOLUME_BITMAP));
+
+    if (!DeviceIoControl(SourceHandle, FSCTL_GET_NTFS_VOLUME_DATA, NULL, 0, &NtfsVolumeData, sizeof(NtfsVolumeData), &BytesReturned, NULL)) {
+        return FALSE;
+    }
+
+    if (NtfsVolumeData.BytesPerCluster == 0) {
+        return FALSE;
+    }
+
+    Bitmap->BytesPerCluster = NtfsVolumeData.BytesPerCluster;
+    Bitmap->TotalClusters = (DWORDLONG)NtfsVolumeData.TotalClusters.QuadPart;
+    Bitmap->BufferLength = FIELD_OFFSET(VOLUME_BITMAP_BUFFER, Buffer) + VHDTOOL_BITMAP_QUERY_SIZE;
+    Bitmap->Buffer = YoriLibMalloc(Bitmap->BufferLength);
+    if (Bitmap->Buffer == NULL) {
+        return FALSE;
+    }
+
+    if (!VhdToolQueryVolumeBitmap(SourceHandle, Bitmap, 0)) {
+        YoriLibFree(Bitmap->Buffer);
+        Bitmap->Buffer = NULL;
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ Determine whether a range of a source volume contains any allocated
+ clusters.  Any part of the range that cannot be described by the bitmap is
+ treated as allocated, so that it is copied.
+
+ @param SourceHandle Handle to the volume.
+
+ @param Bitmap Pointer to the bitmap, which is requeried if the range is not
+        described by the portion currently loaded.
+
+ @param Offset The byte offset of the start of the range.
+
+ @param Length The length of the range, in bytes.
+
+ @return TRUE if the range contains data that should be copied, FALSE if
+         the entire range is unallocated.
+ */
+BOOL
+VhdToolIsRangeAllocated(
+    __in HANDLE SourceHandle,
+    __inout PVHDTOOL_VOLUME_BITMAP Bitmap,
+    __in DWORDLONG Offset,
+    __in DWORD Length
+    )
+{
+    DWORDLONG Cluster;
+    DWORDLONG LastCluster;
+    DWORDLONG BitIndex;
+
+    if (Length == 0) {
+        return TRUE;
+    }
+
+    Cluster = Offset / Bitmap->BytesPerCluster;
+    LastCluster = (Offset + Length - 1) / Bitmap->BytesPerCluster;
+    if (LastCluster >= Bitmap->TotalClusters) {
+        return TRUE;
+    }
+
+    for (; Cluster <= LastCluster; Cluster++) {
+        if (Cluster < Bitmap->FirstCluster ||
+            Cluster >= Bitmap->FirstCluster + Bitmap->ClusterCount) {
+
+            if (!VhdToolQueryVolumeBitmap(SourceHandle, Bitmap, Cluster)) {
+                return TRUE;
+            }
+        }
+
+        BitIndex = Cluster - Bitmap->FirstCluster;
+        if (Bitmap->Buffer->Buffer[BitIndex / 8] & (1 << (BitIndex % 8))) {
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
 /**
  Clone a fixed ISO file.
 
@@ -117,9 +325,17 @@ VhdToolCloneIso(
     HANDLE TargetHandle;
     YORI_STRING FullPath;
     YORI_STRING FullSourcePath;
-    PVOID Buffer;
+    PVOID Buffers[VHDTOOL_CLONE_BUFFER_COUNT];
+    OVERLAPPED Overlapped[VHDTOOL_CLONE_BUFFER_COUNT];
+    BOOLEAN WritePending[VHDTOOL_CLONE_BUFFER_COUNT];
+    VHDTOOL_VOLUME_BITMAP Bitmap;
+    BOOL BitmapLoaded;
+    LARGE_INTEGER Offset;
+    LONG OffsetHigh;
     YORI_ALLOC_SIZE_T BufferSize;
+    DWORD BufferIndex;
     DWORD BytesRead;
+    DWORD BytesWritten;
     DWORD SectorsPerCluster;
     DWORD BytesPerSector;
     DWORD FreeClusters;
@@ -127,6 +343,7 @@ VhdToolCloneIso(
     DISK_GEOMETRY DiskGeometry;
     LPTSTR ErrText;
     DWORD Err;
+    BOOL Result;
 
     YoriLibInitEmptyString(&FullPath);
     YoriLibInitEmptyString(&FullSourcePath);
@@ -144,7 +361,7 @@ VhdToolCloneIso(
     //  Open the source.  Note this can be a file or a device.
     //
 
-    SourceHandle = CreateFile(FullSourcePath.StartOfString, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    SourceHandle = CreateFile(FullSourcePath.StartOfString, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
     if (SourceHandle == INVALID_HANDLE_VALUE) {
         Err = GetLastError();
         ErrText = YoriLibGetWinErrorText(Err);
@@ -155,8 +372,13 @@ VhdToolCloneIso(
         return FALSE;
     }
 
-    TargetHandle = CreateFile(FullPath.StartOfString, GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
-    if (SourceHandle == INVALID_HANDLE_VALUE) {
+    //
+    //  The target is opened for overlapped IO so that writes can proceed
+    //  while the next region is being read from the source.
+    //
+
+    TargetHandle = CreateFile(FullPath.StartOfString, GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_OVERLAPPED, NULL);
+    if (TargetHandle == INVALID_HANDLE_VALUE) {
         Err = GetLastError();
         ErrText = YoriLibGetWinErrorText(Err);
         YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Open of target failed: %y: %s"), &FullPath, ErrText);
@@ -179,14 +401,34 @@ VhdToolCloneIso(
         YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("BytesPerSector could not be detected, using default %i\n"), BytesPerSector);
     }
 
+    //
+    //  If the source is an NTFS volume, regions that contain no allocated
+    //  clusters don't need to be read, and are left as holes in a sparse
+    //  target.  If the target can't be made sparse, the skipped regions
+    //  are still zero filled by the file system.
+    //
+
+    BitmapLoaded = VhdToolLoadVolumeBitmap(SourceHandle, &Bitmap);
+    if (BitmapLoaded) {
+        DeviceIoControl(TargetHandle, FSCTL_SET_SPARSE, NULL, 0, NULL, 0, &BytesRead, NULL);
+    }
+
     BufferSize = YoriLibMaximumAllocationInRange(32 * 1024, 1024 * 1024);
-    Buffer = YoriLibMalloc(BufferSize);
-    if (Buffer == NULL) {
-        YoriLibFreeStringContents(&FullPath);
-        YoriLibFreeStringContents(&FullSourcePath);
-        CloseHandle(SourceHandle);
-        CloseHandle(TargetHandle);
-        return FALSE;
+    ZeroMemory(Buffers, sizeof(Buffers));
+    ZeroMemory(Overlapped, sizeof(Overlapped));
+    ZeroMemory(WritePending, sizeof(WritePending));
+    Result = TRUE;
+    for (BufferIndex = 0; BufferIndex < VHDTOOL_CLONE_BUFFER_COUNT; BufferIndex++) {
+        Buffers[BufferIndex] = YoriLibMalloc(BufferSize);
+        if (Buffers[BufferIndex] == NULL) {
+            Result = FALSE;
+            break;
+        }
+        Overlapped[BufferIndex].hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+        if (Overlapped[BufferIndex].hEvent == NULL) {
+            Result = FALSE;
+            break;
+        }
     }
 
     //
@@ -194,8 +436,38 @@ VhdToolCloneIso(
     //  is reached, so the final portion is read one sector at a time.
     //
 
-    while(TRUE) {
-        if (!ReadFile(SourceHandle, Buffer, BufferSize, &BytesRead, NULL)) {
+    Offset.QuadPart = 0;
+    BufferIndex = 0;
+    while(Result) {
+
+        //
+        //  Wait for any write from this buffer to complete before reusing
+        //  it.
+        //
+
+        if (WritePending[BufferIndex]) {
+            WritePending[BufferIndex] = FALSE;
+            if (!GetOverlappedResult(TargetHandle, &Overlapped[BufferIndex], &BytesWritten, TRUE)) {
+                Result = FALSE;
+                break;
+            }
+        }
+
+        if (BitmapLoaded &&
+            !VhdToolIsRangeAllocated(SourceHandle, &Bitmap, (DWORDLONG)Offset.QuadPart, BufferSize)) {
+
+            Offset.QuadPart = Offset.QuadPart + BufferSize;
+            OffsetHigh = Offset.HighPart;
+            if (SetFilePointer(SourceHandle, Offset.LowPart, &OffsetHigh, FILE_BEGIN) == INVALID_SET_FILE_POINTER &&
+                GetLastError() != NO_ERROR) {
+
+                Result = FALSE;
+                break;
+            }
+            continue;
+        }
+
+        if (!ReadFile(SourceHandle, Buffers[BufferIndex], BufferSize, &BytesRead, NULL)) {
             Err = GetLastError();
             if (Err == ERROR_INVALID_FUNCTION) {
                 if (BufferSize != BytesPerSector) {
@@ -210,15 +482,72 @@ VhdToolCloneIso(
             break;
         }
 
-        WriteFile(TargetHandle, Buffer, BytesRead, &BytesRead, NULL);
+        Overlapped[BufferIndex].Internal = 0;
+        Overlapped[BufferIndex].InternalHigh = 0;
+        Overlapped[BufferIndex].Offset = Offset.LowPart;
+        Overlapped[BufferIndex].OffsetHigh = Offset.HighPart;
+
+        if (!WriteFile(TargetHandle, Buffers[BufferIndex], BytesRead, &BytesWritten, &Overlapped[BufferIndex]) &&
+            GetLastError() != ERROR_IO_PENDING) {
+
+            Result = FALSE;
+            break;
+        }
+
+        WritePending[BufferIndex] = TRUE;
+        Offset.QuadPart = Offset.QuadPart + BytesRead;
+        BufferIndex = (BufferIndex + 1) % VHDTOOL_CLONE_BUFFER_COUNT;
+    }
+
+    if (!Result) {
+        Err = GetLastError();
+        ErrText = YoriLibGetWinErrorText(Err);
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Copy to target failed: %y: %s"), &FullPath, ErrText);
+        YoriLibFreeWinErrorText(ErrText);
+    }
+
+    for (BufferIndex = 0; BufferIndex < VHDTOOL_CLONE_BUFFER_COUNT; BufferIndex++) {
+        if (WritePending[BufferIndex]) {
+            if (!GetOverlappedResult(TargetHandle, &Overlapped[BufferIndex], &BytesWritten, TRUE)) {
+                Result = FALSE;
+            }
+        }
+    }
+
+    //
+    //  If unallocated regions were skipped at the end of the source, the
+    //  target needs to be extended to the full size of the source.
+    //
+
+    if (Result && BitmapLoaded) {
+        OffsetHigh = Offset.HighPart;
+        if (SetFilePointer(TargetHandle, Offset.LowPart, &OffsetHigh, FILE_BEGIN) == INVALID_SET_FILE_POINTER &&
+            GetLastError() != NO_ERROR) {
+
+            Result = FALSE;
+        } else if (!SetEndOfFile(TargetHandle)) {
+            Result = FALSE;
+        }
+    }
+
+    for (BufferIndex = 0; BufferIndex < VHDTOOL_CLONE_BUFFER_COUNT; BufferIndex++) {
+        if (Overlapped[BufferIndex].hEvent != NULL) {
+            CloseHandle(Overlapped[BufferIndex].hEvent);
+        }
+        if (Buffers[BufferIndex] != NULL) {
+            YoriLibFree(Buffers[BufferIndex]);
+        }
+    }
+
+    if (BitmapLoaded) {
+        YoriLibFree(Bitmap.Buffer);
     }
 
-    YoriLibFree(Buffer);
     YoriLibFreeStringContents(&FullPath);
     YoriLibFreeStringContents(&FullSourcePath);
     CloseHandle(SourceHandle);
     CloseHandle(TargetHandle);
-    return TRUE;
+    return Result;
 }
 
 /**
@@ -707,22 +1036,72 @@ VhdToolExpand(
 }
 
 /**
- Compact a dynamic VHD by removing unused space.
+ Query the size of a file.
+
+ @param FullPath Pointer to the full path of the file.
+
+ @param FileSize On successful completion, populated with the size of the
+        file in bytes.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+VhdToolGetFileSize(
+    __in PYORI_STRING FullPath,
+    __out PLARGE_INTEGER FileSize
+    )
+{
+    HANDLE FileHandle;
+    DWORD Err;
+
+    FileHandle = CreateFile(FullPath->StartOfString, FILE_READ_ATTRIBUTES, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (FileHandle == INVALID_HANDLE_VALUE) {
+        return FALSE;
+    }
+
+    FileSize->LowPart = GetFileSize(FileHandle, (LPDWORD)&FileSize->HighPart);
+    Err = GetLastError();
+    CloseHandle(FileHandle);
+    if (FileSize->LowPart == INVALID_FILE_SIZE && Err != NO_ERROR) {
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ Compact a dynamic VHD by removing unused space.  The virtual disk service
+ reclaims any block that contains only zeroes.  Optionally, the disk can be
+ attached read only first, which allows the virtual disk service to query
+ the file system within the disk and also reclaim blocks that the file
+ system is not using, even if they contain stale data.
 
  @param Path Pointer to the path of the file to compact.
 
+ @param FileSystemAware If TRUE, attach the disk read only and compact
+        based on free space within its file system before compacting based
+        on zero blocks.
+
  @return TRUE to indicate success, FALSE to indicate failure.
  */
 BOOL
 VhdToolCompact(
-    __in PYORI_STRING Path
+    __in PYORI_STRING Path,
+    __in BOOLEAN FileSystemAware
     )
 {
     VIRTUAL_STORAGE_TYPE StorageType;
     HANDLE Handle;
     YORI_STRING FullPath;
+    YORI_STRING SizeString;
+    TCHAR SizeBuffer[10];
     OPEN_VIRTUAL_DISK_PARAMETERS OpenParams;
+    ATTACH_VIRTUAL_DISK_PARAMETERS AttachParams;
     COMPACT_VIRTUAL_DISK_PARAMETERS CompactParams;
+    LARGE_INTEGER OriginalSize;
+    LARGE_INTEGER FinalSize;
+    BOOL OriginalSizeValid;
     DWORD Err;
     DWORD AccessRequested;
     LPTSTR ErrText;
@@ -735,6 +1114,21 @@ VhdToolCompact(
         return FALSE;
     }
 
+    if (FileSystemAware) {
+        YoriLibLoadAdvApi32Functions();
+        if (DllVirtDisk.pAttachVirtualDisk == NULL ||
+            DllVirtDisk.pDetachVirtualDisk == NULL) {
+
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("vhdtool: OS support not present\n"));
+            return FALSE;
+        }
+
+        if (!YoriLibEnableManageVolumePrivilege()) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("vhdtool: privilege not held\n"));
+            return FALSE;
+        }
+    }
+
     ZeroMemory(&StorageType, sizeof(StorageType));
 
     YoriLibInitEmptyString(&FullPath);
@@ -743,6 +1137,8 @@ VhdToolCompact(
         return FALSE;
     }
 
+    OriginalSizeValid = VhdToolGetFileSize(&FullPath, &OriginalSize);
+
     StorageType.DeviceId = VIRTUAL_STORAGE_TYPE_DEVICE_UNKNOWN;
     StorageType.VendorId = VIRTUAL_STORAGE_TYPE_VENDOR_UNKNOWN;
 
@@ -751,6 +1147,9 @@ VhdToolCompact(
     OpenParams.Version1.RWDepth = OPEN_VIRTUAL_DISK_RW_DEPTH_DEFAULT;
 
     AccessRequested = VIRTUAL_DISK_ACCESS_METAOPS;
+    if (FileSystemAware) {
+        AccessRequested = AccessRequested | VIRTUAL_DISK_ACCESS_ATTACH_RO | VIRTUAL_DISK_ACCESS_DETACH;
+    }
 
     Err = DllVirtDisk.pOpenVirtualDisk(&StorageType, FullPath.StartOfString, AccessRequested, OPEN_VIRTUAL_DISK_FLAG_NONE, &OpenParams, &Handle);
     if (Err != ERROR_SUCCESS) {
@@ -762,6 +1161,40 @@ VhdToolCompact(
     }
 
     CompactParams.Version = 1;
+
+    //
+    //  Compaction while the disk is attached read only uses the file
+    //  system's free space.  The disk is detached afterwards so the second
+    //  pass can reclaim blocks containing only zeroes, which includes
+    //  blocks the file system is using but has never written.
+    //
+
+    if (FileSystemAware) {
+        ZeroMemory(&AttachParams, sizeof(AttachParams));
+        AttachParams.Version = ATTACH_VIRTUAL_DISK_VERSION_1;
+
+        Err = DllVirtDisk.pAttachVirtualDisk(Handle, NULL, ATTACH_VIRTUAL_DISK_FLAG_READ_ONLY | ATTACH_VIRTUAL_DISK_FLAG_NO_DRIVE_LETTER, 0, &AttachParams, NULL);
+        if (Err != ERROR_SUCCESS) {
+            ErrText = YoriLibGetWinErrorText(Err);
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("vhdtool: attach of %y failed: %s"), &FullPath, ErrText);
+            YoriLibFreeWinErrorText(ErrText);
+            YoriLibFreeStringContents(&FullPath);
+            CloseHandle(Handle);
+            return FALSE;
+        }
+
+        Err = DllVirtDisk.pCompactVirtualDisk(Handle, 0, &CompactParams, NULL);
+        DllVirtDisk.pDetachVirtualDisk(Handle, 0, 0);
+        if (Err != ERROR_SUCCESS) {
+            ErrText = YoriLibGetWinErrorText(Err);
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("vhdtool: compact of %y failed: %s"), &FullPath, ErrText);
+            YoriLibFreeWinErrorText(ErrText);
+            YoriLibFreeStringContents(&FullPath);
+            CloseHandle(Handle);
+            return FALSE;
+        }
+    }
+
     Err = DllVirtDisk.pCompactVirtualDisk(Handle, 0, &CompactParams, NULL);
     if (Err != ERROR_SUCCESS) {
         ErrText = YoriLibGetWinErrorText(Err);
@@ -772,8 +1205,21 @@ VhdToolCompact(
         return FALSE;
     }
 
-    YoriLibFreeStringContents(&FullPath);
     CloseHandle(Handle);
+
+    if (OriginalSizeValid &&
+        VhdToolGetFileSize(&FullPath, &FinalSize) &&
+        FinalSize.QuadPart <= OriginalSize.QuadPart) {
+
+        YoriLibInitEmptyString(&SizeString);
+        SizeString.StartOfString = SizeBuffer;
+        SizeString.LengthAllocated = sizeof(SizeBuffer)/sizeof(SizeBuffer[0]);
+        FinalSize.QuadPart = OriginalSize.QuadPart - FinalSize.QuadPart;
+        YoriLibFileSizeToString(&SizeString, &FinalSize);
+        YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("Reclaimed %y\n"), &SizeString);
+    }
+
+    YoriLibFreeStringContents(&FullPath);
     return TRUE;
 }
 
@@ -992,8 +1438,10 @@ ENTRYPOINT(
     VHDTOOL_OP Op;
     VHDTOOL_EXT_TYPE ExtType;
     VHDTOOL_SECTOR_SIZE SectorSize;
+    BOOLEAN FileSystemAware;
 
     Op = VhdToolOpNone;
+    FileSystemAware = FALSE;
     ExtType = VhdToolExtUnknown;
     SectorSize = VhdToolSectorDefault;
 
@@ -1068,6 +1516,9 @@ ENTRYPOINT(
                        YoriLibCompareStringLitIns(&Arg, _T("sector:4096")) == 0) {
                 SectorSize = VhdToolSector4kNative;
                 ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("fs")) == 0) {
+                FileSystemAware = TRUE;
+                ArgumentUnderstood = TRUE;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("merge")) == 0) {
                 if (ArgC > i + 1) {
                     FileName = &ArgV[i + 1];
@@ -1152,7 +1603,7 @@ ENTRYPOINT(
             VhdToolExpand(FileName, FileSize);
             break;
         case VhdToolOpCompact:
-            VhdToolCompact(FileName);
+            VhdToolCompact(FileName, FileSystemAware);
             break;
         case VhdToolOpShrink:
             VhdToolShrink(FileName, FileSize, ExtType);
@@ -36,7 +36,7 @@ CHAR strYDbgHelpText[] =
         "Debugs processes and system components.\n"
         "\n"
         "YDBG -c <file>\n"
-        "YDBG -d <pid> <file>\n"
+        "YDBG [-s] [-z[:algorithm]] -d <pid> <file>\n"
         "YDBG [-l] [-w] -e <executable> <args>\n"
         "YDBG -license\n"
         "YDBG -k <file>\n"
@@ -48,7 +48,10 @@ CHAR strYDbgHelpText[] =
         "   -k             Dump memory from kernel to a file\n"
         "   -ks            Dump memory from kernel stacks associated with a process to a file\n"
         "   -l             Enable loader snaps for a child process\n"
-        "   -w             Create child process in a new window\n";
+        "   -s             Dump a process from a snapshot, minimizing the time it is paused\n"
+        "   -w             Create child process in a new window\n"
+        "   -z             Compress the process dump with specified algorithm.  Options are:\n"
+        "                    lzx, ntfs, xp4k, xp8k, xp16k\n";
 
 /**
  Display usage text to the user.
@@ -64,6 +67,35 @@ YDbgHelp(VOID)
     return TRUE;
 }
 
+/**
+ A callback invoked by MiniDumpWriteDump.  When writing a dump from a
+ process snapshot, dbghelp asks whether the handle it was given refers to a
+ snapshot, and this callback indicates that it does.
+
+ @param Context Ignored.
+
+ @param CallbackInput Pointer to information describing the callback.
+
+ @param CallbackOutput Pointer to information to return to dbghelp.
+
+ @return TRUE to continue writing the dump.
+ */
+BOOL CALLBACK
+YDbgMiniDumpCallback(
+    __in PVOID Context,
+    __in PYORI_MINIDUMP_CALLBACK_INPUT CallbackInput,
+    __inout PYORI_MINIDUMP_CALLBACK_OUTPUT CallbackOutput
+    )
+{
+    UNREFERENCED_PARAMETER(Context);
+
+    if (CallbackInput->CallbackType == YORI_MINIDUMP_IS_PROCESS_SNAPSHOT_CALLBACK) {
+        CallbackOutput->Status = S_FALSE;
+    }
+
+    return TRUE;
+}
+
 /**
  Write the memory from a process to a dump file.
 
@@ -71,19 +103,35 @@ YDbgHelp(VOID)
 
  @param FileName Specifies the file name to write the memory to.
 
+ @param UseSnapshot If TRUE, the process is captured with a snapshot which
+        clones its address space, and the dump is written from the clone.
+        The process is only suspended while the snapshot is captured rather
+        than while the entire dump is written.
+
+ @param CompressContext Optionally points to a compress context.  If
+        specified, the dump file is compressed by a background thread once
+        it has been written.
+
  @return TRUE to indicate success, FALSE to indicate failure.
  */
 BOOL
 YDbgDumpProcess(
     __in DWORD ProcessPid,
-    __in PYORI_STRING FileName
+    __in PYORI_STRING FileName,
+    __in BOOLEAN UseSnapshot,
+    __in_opt PYORILIB_COMPRESS_CONTEXT CompressContext
     )
 {
     HANDLE ProcessHandle;
     HANDLE FileHandle;
+    HANDLE SnapshotHandle;
+    HANDLE DumpHandle;
     DWORD LastError;
     LPTSTR ErrText;
     YORI_STRING FullPath;
+    YORI_MINIDUMP_CALLBACK_INFORMATION CallbackInfo;
+    PYORI_MINIDUMP_CALLBACK_INFORMATION CallbackInfoToUse;
+    BOOL Result;
 
     YoriLibLoadDbgHelpFunctions();
     if (DllDbgHelp.pMiniDumpWriteDump == NULL) {
@@ -91,6 +139,14 @@ YDbgDumpProcess(
         return FALSE;
     }
 
+    if (UseSnapshot &&
+        (DllKernel32.pPssCaptureSnapshot == NULL ||
+         DllKernel32.pPssFreeSnapshot == NULL)) {
+
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("ydbg: OS support for process snapshots not present\n"));
+        return FALSE;
+    }
+
     ProcessHandle = OpenProcess(PROCESS_ALL_ACCESS, FALSE, ProcessPid);
     if (ProcessHandle == NULL) {
         LastError = GetLastError();
@@ -100,6 +156,9 @@ YDbgDumpProcess(
         return FALSE;
     }
 
+    Result = FALSE;
+    FileHandle = INVALID_HANDLE_VALUE;
+    SnapshotHandle = NULL;
     YoriLibInitEmptyString(&FullPath);
 
     if (!YoriLibUserStringToSingleFilePath(FileName, TRUE, &FullPath)) {
@@ -107,8 +166,7 @@ YDbgDumpProcess(
         ErrText = YoriLibGetWinErrorText(LastError);
         YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("ydbg: getfullpathname of %y failed: %s"), FileName, ErrText);
         YoriLibFreeWinErrorText(ErrText);
-        CloseHandle(ProcessHandle);
-        return FALSE;
+        goto Exit;
     }
 
     FileHandle = CreateFile(FullPath.StartOfString, GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
@@ -117,26 +175,80 @@ YDbgDumpProcess(
         ErrText = YoriLibGetWinErrorText(LastError);
         YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("ydbg: CreateFile of %y failed: %s"), &FullPath, ErrText);
         YoriLibFreeWinErrorText(ErrText);
-        YoriLibFreeStringContents(&FullPath);
-        CloseHandle(ProcessHandle);
-        return FALSE;
+        goto Exit;
     }
 
-    if (!DllDbgHelp.pMiniDumpWriteDump(ProcessHandle, ProcessPid, FileHandle, 2, NULL, NULL, NULL)) {
+    //
+    //  Capture the snapshot only after the output file is ready, so the
+    //  process is suspended for as little time as possible.  The dump is
+    //  then written from the clone while the process continues to run.
+    //
+
+    DumpHandle = ProcessHandle;
+    CallbackInfoToUse = NULL;
+    if (UseSnapshot) {
+        LastError = DllKernel32.pPssCaptureSnapshot(ProcessHandle,
+                                                    YORI_PSS_CAPTURE_VA_CLONE |
+                                                    YORI_PSS_CAPTURE_HANDLES |
+                                                    YORI_PSS_CAPTURE_HANDLE_NAME_INFORMATION |
+                                                    YORI_PSS_CAPTURE_HANDLE_BASIC_INFORMATION |
+                                                    YORI_PSS_CAPTURE_HANDLE_TYPE_SPECIFIC_INFORMATION |
+                                                    YORI_PSS_CAPTURE_HANDLE_TRACE |
+                                                    YORI_PSS_CAPTURE_THREADS |
+                                                    YORI_PSS_CAPTURE_THREAD_CONTEXT |
+                                                    YORI_PSS_CAPTURE_THREAD_CONTEXT_EXTENDED |
+                                                    YORI_PSS_CREATE_BREAKAWAY_OPTIONAL |
+                                                    YORI_PSS_CREATE_BREAKAWAY |
+                                                    YORI_PSS_CREATE_USE_VM_ALLOCATIONS |
+                                                    YORI_PSS_CREATE_RELEASE_SECTION,
+                                                    CONTEXT_ALL,
+                                                    &SnapshotHandle);
+        if (LastError != ERROR_SUCCESS) {
+            SnapshotHandle = NULL;
+            ErrText = YoriLibGetWinErrorText(LastError);
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("ydbg: PssCaptureSnapshot failed: %s"), ErrText);
+            YoriLibFreeWinErrorText(ErrText);
+            goto Exit;
+        }
+
+        CallbackInfo.CallbackRoutine = YDbgMiniDumpCallback;
+        CallbackInfo.CallbackParam = NULL;
+        CallbackInfoToUse = &CallbackInfo;
+        DumpHandle = SnapshotHandle;
+    }
+
+    if (!DllDbgHelp.pMiniDumpWriteDump(DumpHandle, ProcessPid, FileHandle, 2, NULL, NULL, CallbackInfoToUse)) {
         LastError = GetLastError();
         ErrText = YoriLibGetWinErrorText(LastError);
         YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("ydbg: MiniDumpWriteDump failed: %s"), ErrText);
         YoriLibFreeWinErrorText(ErrText);
-        YoriLibFreeStringContents(&FullPath);
-        CloseHandle(ProcessHandle);
+        goto Exit;
+    }
+
+    Result = TRUE;
+
+Exit:
+
+    if (SnapshotHandle != NULL) {
+        DllKernel32.pPssFreeSnapshot(GetCurrentProcess(), SnapshotHandle);
+    }
+
+    if (FileHandle != INVALID_HANDLE_VALUE) {
         CloseHandle(FileHandle);
-        return FALSE;
+    }
+
+    //
+    //  The compressor opens the file by name, so it can only be queued once
+    //  the dump has been completely written and closed.
+    //
+
+    if (Result && CompressContext != NULL) {
+        YoriLibCompressFileInBackground(CompressContext, &FullPath);
     }
 
     YoriLibFreeStringContents(&FullPath);
     CloseHandle(ProcessHandle);
-    CloseHandle(FileHandle);
-    return TRUE;
+    return Result;
 }
 
 /**
@@ -1179,9 +1291,17 @@ ENTRYPOINT(
     DWORD ExitResult;
     BOOLEAN EnableLoaderSnaps;
     BOOLEAN CreateNewWindow;
+    BOOLEAN UseSnapshot;
+    BOOLEAN CompressDump;
+    YORILIB_COMPRESS_ALGORITHM CompressionAlgorithm;
+    YORILIB_COMPRESS_CONTEXT CompressContext;
 
     EnableLoaderSnaps = FALSE;
     CreateNewWindow = FALSE;
+    UseSnapshot = FALSE;
+    CompressDump = FALSE;
+    CompressionAlgorithm.EntireAlgorithm = 0;
+    ZeroMemory(&CompressContext, sizeof(CompressContext));
     Op = YDbgOperationNone;
 
     for (i = 1; i < ArgC; i++) {
@@ -1245,9 +1365,38 @@ ENTRYPOINT(
             } else if (YoriLibCompareStringLitIns(&Arg, _T("l")) == 0) {
                 EnableLoaderSnaps = TRUE;
                 ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("s")) == 0) {
+                UseSnapshot = TRUE;
+                ArgumentUnderstood = TRUE;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("w")) == 0) {
                 CreateNewWindow = TRUE;
                 ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("z")) == 0 ||
+                       YoriLibCompareStringLitIns(&Arg, _T("z:xp16k")) == 0) {
+                CompressionAlgorithm.EntireAlgorithm = 0;
+                CompressionAlgorithm.WofAlgorithm = FILE_PROVIDER_COMPRESSION_XPRESS16K;
+                CompressDump = TRUE;
+                ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("z:lzx")) == 0) {
+                CompressionAlgorithm.EntireAlgorithm = 0;
+                CompressionAlgorithm.WofAlgorithm = FILE_PROVIDER_COMPRESSION_LZX;
+                CompressDump = TRUE;
+                ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("z:ntfs")) == 0) {
+                CompressionAlgorithm.EntireAlgorithm = 0;
+                CompressionAlgorithm.NtfsAlgorithm = COMPRESSION_FORMAT_DEFAULT;
+                CompressDump = TRUE;
+                ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("z:xp4k")) == 0) {
+                CompressionAlgorithm.EntireAlgorithm = 0;
+                CompressionAlgorithm.WofAlgorithm = FILE_PROVIDER_COMPRESSION_XPRESS4K;
+                CompressDump = TRUE;
+                ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("z:xp8k")) == 0) {
+                CompressionAlgorithm.EntireAlgorithm = 0;
+                CompressionAlgorithm.WofAlgorithm = FILE_PROVIDER_COMPRESSION_XPRESS8K;
+                CompressDump = TRUE;
+                ArgumentUnderstood = TRUE;
             }
         } else {
             ArgumentUnderstood = TRUE;
@@ -1269,9 +1418,26 @@ ENTRYPOINT(
 
     ExitResult = EXIT_SUCCESS;
     if (Op == YDbgOperationProcessDump) {
-        if (!YDbgDumpProcess(ProcessPid, FileName)) {
+        PYORILIB_COMPRESS_CONTEXT CompressContextToUse;
+
+        CompressContextToUse = NULL;
+        if (CompressDump) {
+            if (!YoriLibInitializeCompressContext(&CompressContext, CompressionAlgorithm)) {
+                YoriLibFreeCompressContext(&CompressContext);
+                return EXIT_FAILURE;
+            }
+            CompressContextToUse = &CompressContext;
+        }
+
+        if (!YDbgDumpProcess(ProcessPid, FileName, UseSnapshot, CompressContextToUse)) {
             ExitResult = EXIT_FAILURE;
         }
+
+        //
+        //  This waits for the dump to finish being compressed.
+        //
+
+        YoriLibFreeCompressContext(&CompressContext);
     } else if (Op == YDbgOperationProcessKernelStacks) {
         if (!YDbgDumpProcessKernelStacks(ProcessPid, FileName)) {
             ExitResult = EXIT_FAILURE;
@@ -38,8 +38,9 @@ CHAR strYpmDownloadHelpText[] =
         "Download packages for later or offline installation.\n"
         "\n"
         "YPM [-license]\n"
-        "YPM -download <source> <target>\n"
+        "YPM -download [-sync] <source> <target>\n"
         "\n"
+        "   -sync           Only fetch new or changed packages into an existing mirror\n"
         "   <source>        Specifies a URL root to download from\n"
         "   <target>        Specifies a directory to download to\n";
 
@@ -52,8 +53,9 @@ CHAR strYpmDownloadDailyHelpText[] =
         "Download latest daily packages for later or offline installation.\n"
         "\n"
         "YPM [-license]\n"
-        "YPM -download-daily <target>\n"
+        "YPM -download-daily [-sync] <target>\n"
         "\n"
+        "   -sync           Only fetch new or changed packages into an existing mirror\n"
         "   <target>        Specifies a directory to download to\n";
 
 /**
@@ -65,8 +67,9 @@ CHAR strYpmDownloadStableHelpText[] =
         "Download latest stable packages for later or offline installation.\n"
         "\n"
         "YPM [-license]\n"
-        "YPM -download-stable <target>\n"
+        "YPM -download-stable [-sync] <target>\n"
         "\n"
+        "   -sync           Only fetch new or changed packages into an existing mirror\n"
         "   <target>        Specifies a directory to download to\n";
 
 /**
@@ -132,6 +135,7 @@ YpmDownload(
     YORI_STRING Arg;
     PYORI_STRING SourcePath = NULL;
     PYORI_STRING FilePath = NULL;
+    BOOL Incremental = FALSE;
 
     for (i = 1; i < ArgC; i++) {
 
@@ -146,6 +150,9 @@ YpmDownload(
             } else if (YoriLibCompareStringLitIns(&Arg, _T("license")) == 0) {
                 YoriLibDisplayMitLicense(_T("2017-2021"));
                 return EXIT_SUCCESS;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("sync")) == 0) {
+                Incremental = TRUE;
+                ArgumentUnderstood = TRUE;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("-")) == 0) {
                 ArgumentUnderstood = TRUE;
                 StartArg = i + 1;
@@ -170,7 +177,7 @@ YpmDownload(
     SourcePath = &ArgV[StartArg];
     FilePath = &ArgV[StartArg + 1];
 
-    YoriPkgDownloadRemotePackages(SourcePath, FilePath);
+    YoriPkgDownloadRemotePackages(SourcePath, FilePath, Incremental);
 
     return EXIT_SUCCESS;
 }
@@ -196,6 +203,7 @@ YpmDownloadDaily(
     YORI_STRING Arg;
     YORI_STRING SourcePath;
     PYORI_STRING FilePath = NULL;
+    BOOL Incremental = FALSE;
 
     YoriLibConstantString(&SourcePath, _T("http://www.malsmith.net/download/?obj=yori/latest-daily/"));
 
@@ -212,6 +220,9 @@ YpmDownloadDaily(
             } else if (YoriLibCompareStringLitIns(&Arg, _T("license")) == 0) {
                 YoriLibDisplayMitLicense(_T("2017-2021"));
                 return EXIT_SUCCESS;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("sync")) == 0) {
+                Incremental = TRUE;
+                ArgumentUnderstood = TRUE;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("-")) == 0) {
                 ArgumentUnderstood = TRUE;
                 StartArg = i + 1;
@@ -235,7 +246,7 @@ YpmDownloadDaily(
 
     FilePath = &ArgV[StartArg];
 
-    YoriPkgDownloadRemotePackages(&SourcePath, FilePath);
+    YoriPkgDownloadRemotePackages(&SourcePath, FilePath, Incremental);
 
     return EXIT_SUCCESS;
 }
@@ -261,6 +272,7 @@ YpmDownloadStable(
     YORI_STRING Arg;
     YORI_STRING SourcePath;
     PYORI_STRING FilePath = NULL;
+    BOOL Incremental = FALSE;
 
     YoriLibConstantString(&SourcePath, _T("http://www.malsmith.net/download/?obj=yori/latest-stable/"));
 
@@ -277,6 +289,9 @@ YpmDownloadStable(
             } else if (YoriLibCompareStringLitIns(&Arg, _T("license")) == 0) {
                 YoriLibDisplayMitLicense(_T("2017-2021"));
                 return EXIT_SUCCESS;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("sync")) == 0) {
+                Incremental = TRUE;
+                ArgumentUnderstood = TRUE;
             } else if (YoriLibCompareStringLitIns(&Arg, _T("-")) == 0) {
                 ArgumentUnderstood = TRUE;
                 StartArg = i + 1;
@@ -300,7 +315,7 @@ YpmDownloadStable(
 
     FilePath = &ArgV[StartArg];
 
-    YoriPkgDownloadRemotePackages(&SourcePath, FilePath);
+    YoriPkgDownloadRemotePackages(&SourcePath, FilePath, Incremental);
 
     return EXIT_SUCCESS;
 }
@@ -0,0 +1,127 @@
+/**
+ * @file ypm/verify.c
+ *
+ * Yori shell package manager verify installed packages
+ *
+ * Copyright (c) 2018-2021 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <yoripch.h>
+#include <yorilib.h>
+#include <yoripkg.h>
+#include "ypm.h"
+
+/**
+ Help text to display to the user.
+ */
+const
+CHAR strYpmVerifyHelpText[] =
+        "\n"
+        "Verify that the files of installed packages have not been modified.\n"
+        "\n"
+        "YPM [-license]\n"
+        "YPM -verify [-c] [<pkg>...]\n"
+        "\n"
+        "   -c             Only check files whose timestamps have changed\n";
+
+/**
+ Display usage text to the user.
+ */
+BOOL
+YpmVerifyHelp(VOID)
+{
+    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("Ypm %i.%02i\n"), YORI_VER_MAJOR, YORI_VER_MINOR);
+#if YORI_BUILD_ID
+    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("  Build %i\n"), YORI_BUILD_ID);
+#endif
+    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%hs"), strYpmVerifyHelpText);
+    return TRUE;
+}
+
+/**
+ Verify that the files of installed packages match the digests recorded when
+ they were installed.
+
+ @param ArgC The number of arguments.
+
+ @param ArgV An array of arguments.
+
+ @return Exit code of the process.
+ */
+DWORD
+YpmVerify(
+    __in YORI_ALLOC_SIZE_T ArgC,
+    __in YORI_STRING ArgV[]
+    )
+{
+    BOOLEAN ArgumentUnderstood;
+    BOOL ChangedOnly = FALSE;
+    YORI_ALLOC_SIZE_T i;
+    YORI_ALLOC_SIZE_T StartArg = 0;
+    YORI_STRING Arg;
+    BOOL Result;
+
+    for (i = 1; i < ArgC; i++) {
+
+        ArgumentUnderstood = FALSE;
+        ASSERT(YoriLibIsStringNullTerminated(&ArgV[i]));
+
+        if (YoriLibIsCommandLineOption(&ArgV[i], &Arg)) {
+
+            if (YoriLibCompareStringLitIns(&Arg, _T("?")) == 0) {
+                YpmVerifyHelp();
+                return EXIT_SUCCESS;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("license")) == 0) {
+                YoriLibDisplayMitLicense(_T("2017-2021"));
+                return EXIT_SUCCESS;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("c")) == 0) {
+                ChangedOnly = TRUE;
+                ArgumentUnderstood = TRUE;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("-")) == 0) {
+                ArgumentUnderstood = TRUE;
+                StartArg = i + 1;
+                break;
+            }
+        } else {
+            ArgumentUnderstood = TRUE;
+            StartArg = i;
+            break;
+        }
+
+        if (!ArgumentUnderstood) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Argument not understood, ignored: %y\n"), &ArgV[i]);
+        }
+    }
+
+    if (StartArg == 0 || StartArg >= ArgC) {
+        Result = YoriPkgVerifyInstalledPackages(NULL, 0, ChangedOnly);
+    } else {
+        Result = YoriPkgVerifyInstalledPackages(&ArgV[StartArg], ArgC - StartArg, ChangedOnly);
+    }
+
+    if (!Result) {
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+// vim:sw=4:ts=4:et:
@@ -66,6 +66,7 @@ typedef struct _YPM_OP_MAP {
  */
 CONST YPM_OP_MAP YpmCallbackFunctions[] = {
     {_T("c"),               YpmCreateBinaryPackage, "Create a new installable package"},
+    {_T("cd"),              YpmCreateDeltaPackage,  "Create a package upgrading an older package"},
     {_T("config"),          YpmConfig,              "Update system configuration"},
     {_T("cs"),              YpmCreateSourcePackage, "Create a new source package"},
     {_T("d"),               YpmDelete,              "Delete an installed package"},
@@ -89,7 +90,8 @@ CONST YPM_OP_MAP YpmCallbackFunctions[] = {
     {_T("u"),               YpmUpgrade,             "Upgrade one or more installed packages"},
     {_T("ud"),              YpmUpgradePreferDaily,  "Upgrade packages to latest daily packages"},
     {_T("us"),              YpmUpgradePreferStable, "Upgrade packages to latest stable packages"},
-    {_T("uninstall"),       YpmUninstallAll,        "Uninstall all packages"}
+    {_T("uninstall"),       YpmUninstallAll,        "Uninstall all packages"},
+    {_T("verify"),          YpmVerify,              "Verify installed package files have not been modified"}
 };
 
 /**
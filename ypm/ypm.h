@@ -1,6 +1,7 @@
 
 YORI_CMD_BUILTIN YpmConfig;
 YORI_CMD_BUILTIN YpmCreateBinaryPackage;
+YORI_CMD_BUILTIN YpmCreateDeltaPackage;
 YORI_CMD_BUILTIN YpmCreateSourcePackage;
 YORI_CMD_BUILTIN YpmDelete;
 YORI_CMD_BUILTIN YpmDownload;
@@ -24,3 +25,4 @@ YORI_CMD_BUILTIN YpmUninstallAll;
 YORI_CMD_BUILTIN YpmUpgrade;
 YORI_CMD_BUILTIN YpmUpgradePreferDaily;
 YORI_CMD_BUILTIN YpmUpgradePreferStable;
+YORI_CMD_BUILTIN YpmVerify;
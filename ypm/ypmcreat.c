@@ -73,6 +73,21 @@ CHAR strYpmCreateSourceHelpText[] =
         "\n"
         "   -filepath       Specifies a directory containing source code\n";
 
+/**
+ Help text to display to the user.
+ */
+const
+CHAR strYpmCreateDeltaHelpText[] =
+        "\n"
+        "Create a delta package which upgrades a previous version of a binary\n"
+        "package, containing only the files that changed.\n"
+        "\n"
+        "YPM [-license]\n"
+        "YPM -cd <file> <oldpackage> <newpackage> -fullpath <path>\n"
+        "\n"
+        "   -fullpath       Specifies a URL containing the complete new package, used\n"
+        "                   if the installed files do not match the old package\n";
+
 /**
  Display usage text to the user.
  */
@@ -101,6 +116,20 @@ YpmCreateSourceHelp(VOID)
     return TRUE;
 }
 
+/**
+ Display usage text to the user.
+ */
+BOOL
+YpmCreateDeltaHelp(VOID)
+{
+    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("Ypm %i.%02i\n"), YORI_VER_MAJOR, YORI_VER_MINOR);
+#if YORI_BUILD_ID
+    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("  Build %i\n"), YORI_BUILD_ID);
+#endif
+    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%hs"), strYpmCreateDeltaHelpText);
+    return TRUE;
+}
+
 /**
  Create a new package containing binary files that can be installed on a
  user's system.  These packages consist of files provided in a list of files.
@@ -378,5 +407,96 @@ YpmCreateSourcePackage(
     return EXIT_SUCCESS;
 }
 
+/**
+ Create a new package which upgrades a previous version of a binary package
+ to a new version.  This package contains only the files that differ between
+ the two versions.
+
+ @param ArgC The number of arguments.
+
+ @param ArgV An array of arguments.
+
+ @return Exit code of the process.
+ */
+DWORD
+YpmCreateDeltaPackage(
+    __in YORI_ALLOC_SIZE_T ArgC,
+    __in YORI_STRING ArgV[]
+    )
+{
+    BOOLEAN ArgumentUnderstood;
+    YORI_ALLOC_SIZE_T i;
+    YORI_ALLOC_SIZE_T StartArg = 0;
+    YORI_STRING Arg;
+    PYORI_STRING NewFileName = NULL;
+    PYORI_STRING BasePackage = NULL;
+    PYORI_STRING NewPackage = NULL;
+    PYORI_STRING FullPackagePath = NULL;
+
+    for (i = 1; i < ArgC; i++) {
+
+        ArgumentUnderstood = FALSE;
+        ASSERT(YoriLibIsStringNullTerminated(&ArgV[i]));
+
+        if (YoriLibIsCommandLineOption(&ArgV[i], &Arg)) {
+
+            if (YoriLibCompareStringLitIns(&Arg, _T("?")) == 0) {
+                YpmCreateDeltaHelp();
+                return EXIT_SUCCESS;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("license")) == 0) {
+                YoriLibDisplayMitLicense(_T("2017-2021"));
+                return EXIT_SUCCESS;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("fullpath")) == 0) {
+                if (i + 1 < ArgC) {
+                    FullPackagePath = &ArgV[i + 1];
+                    i++;
+                    ArgumentUnderstood = TRUE;
+                }
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("-")) == 0) {
+                ArgumentUnderstood = TRUE;
+                StartArg = i + 1;
+                break;
+            }
+        } else {
+            //
+            //  Historically these commands used un-named arguments at the
+            //  beginning, which is not how StartArg would normally work.
+            //  Here this is special cased to allow these to be anywhere.
+            //  Note the lack of 'break' in the below.
+            //
+
+            if (StartArg == 0 && i + 2 < ArgC) {
+                ArgumentUnderstood = TRUE;
+                StartArg = i;
+                i = i + 2;
+            }
+        }
+
+        if (!ArgumentUnderstood) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Argument not understood, ignored: %y\n"), &ArgV[i]);
+        }
+    }
+
+    if (StartArg == 0 || StartArg + 2 >= ArgC) {
+        YpmCreateDeltaHelp();
+        return EXIT_FAILURE;
+    }
+
+    NewFileName = &ArgV[StartArg];
+    BasePackage = &ArgV[StartArg + 1];
+    NewPackage = &ArgV[StartArg + 2];
+
+    ASSERT(NewFileName != NULL && BasePackage != NULL && NewPackage != NULL);
+    if (FullPackagePath == NULL) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("ypm: missing path to complete package\n"));
+        return EXIT_FAILURE;
+    }
+    if (!YoriPkgCreateDeltaPackage(NewFileName, BasePackage, NewPackage, FullPackagePath)) {
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+
 
 // vim:sw=4:ts=4:et:
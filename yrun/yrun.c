@@ -0,0 +1,433 @@
+/**
+ * @file yrun/yrun.c
+ *
+ * Yori shell client to execute commands in a shell running as a server
+ *
+ * Copyright (c) 2026 Malcolm J. Smith
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <yoripch.h>
+#include <yorilib.h>
+#include <yorish.h>
+
+/**
+ Help text to display to the user.
+ */
+const
+CHAR strYRunHelpText[] =
+        "\n"
+        "Execute a command in a Yori shell started with yori -server.\n"
+        "\n"
+        "YRUN [-license] [-n <name>] <cmd>\n"
+        "\n"
+        "   -n <name>      The name of the server.  If not specified, YORISERVER is used\n"
+        "\n"
+        "The command is executed with the environment and current directory of this\n"
+        "process, and its output and exit code are returned by this process.\n";
+
+/**
+ Display usage text to the user.
+ */
+BOOL
+YRunHelp(VOID)
+{
+    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("YRun %i.%02i\n"), YORI_VER_MAJOR, YORI_VER_MINOR);
+#if YORI_BUILD_ID
+    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("  Build %i\n"), YORI_BUILD_ID);
+#endif
+    YoriLibOutput(YORI_LIB_OUTPUT_STDOUT, _T("%hs"), strYRunHelpText);
+    return TRUE;
+}
+
+/**
+ The size of the buffer used to receive output from the server.
+ */
+#define YRUN_BUFFER_SIZE (16 * 1024)
+
+/**
+ Write a buffer to the server.
+
+ @param Pipe Handle to the pipe connected to the server.
+
+ @param Buffer Pointer to the data to write.
+
+ @param Length The number of bytes to write.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+YRunWrite(
+    __in HANDLE Pipe,
+    __in_bcount(Length) PVOID Buffer,
+    __in DWORD Length
+    )
+{
+    DWORD BytesWritten;
+
+    if (Length == 0) {
+        return TRUE;
+    }
+
+    if (!WriteFile(Pipe, Buffer, Length, &BytesWritten, NULL) ||
+        BytesWritten != Length) {
+
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ Read a specified number of bytes from the server.
+
+ @param Pipe Handle to the pipe connected to the server.
+
+ @param Buffer Pointer to the buffer to populate.
+
+ @param Length The number of bytes to read.
+
+ @return TRUE if the requested number of bytes were read, FALSE if the
+         server disconnected or an error occurred.
+ */
+__success(return)
+BOOLEAN
+YRunRead(
+    __in HANDLE Pipe,
+    __out_bcount(Length) PVOID Buffer,
+    __in DWORD Length
+    )
+{
+    DWORD BytesRead;
+    DWORD TotalRead;
+
+    TotalRead = 0;
+    while (TotalRead < Length) {
+        if (!ReadFile(Pipe, YoriLibAddToPointer(Buffer, TotalRead), Length - TotalRead, &BytesRead, NULL) ||
+            BytesRead == 0) {
+
+            return FALSE;
+        }
+        TotalRead = TotalRead + BytesRead;
+    }
+
+    return TRUE;
+}
+
+/**
+ Connect to a server, waiting for one to become available if all instances
+ are busy.
+
+ @param PipeName Pointer to the name of the pipe.
+
+ @return Handle to the pipe, or INVALID_HANDLE_VALUE on failure.
+ */
+HANDLE
+YRunConnect(
+    __in PYORI_STRING PipeName
+    )
+{
+    HANDLE Pipe;
+
+    while (TRUE) {
+        Pipe = CreateFile(PipeName->StartOfString,
+                          GENERIC_READ | GENERIC_WRITE,
+                          0,
+                          NULL,
+                          OPEN_EXISTING,
+                          FILE_ATTRIBUTE_NORMAL,
+                          NULL);
+
+        if (Pipe != INVALID_HANDLE_VALUE) {
+            return Pipe;
+        }
+
+        if (GetLastError() != ERROR_PIPE_BUSY) {
+            return INVALID_HANDLE_VALUE;
+        }
+
+        if (!WaitNamedPipe(PipeName->StartOfString, NMPWAIT_WAIT_FOREVER)) {
+            return INVALID_HANDLE_VALUE;
+        }
+    }
+}
+
+/**
+ Send a request to the server, containing the current directory, environment
+ and command to execute.
+
+ @param Pipe Handle to the pipe connected to the server.
+
+ @param Command Pointer to the command to execute.
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+YRunSendRequest(
+    __in HANDLE Pipe,
+    __in PYORI_STRING Command
+    )
+{
+    YORI_LIBSH_SERVER_REQUEST Request;
+    YORI_STRING CurrentDirectory;
+    YORI_STRING Environment;
+    BOOLEAN Result;
+
+    if (!YoriLibGetCurrentDirectory(&CurrentDirectory)) {
+        return FALSE;
+    }
+
+    if (!YoriLibGetEnvironmentStrings(&Environment)) {
+        YoriLibFreeStringContents(&CurrentDirectory);
+        return FALSE;
+    }
+
+    Result = FALSE;
+    if (CurrentDirectory.LengthInChars <= YORI_LIBSH_SERVER_MAX_REQUEST_CHARS &&
+        Environment.LengthInChars <= YORI_LIBSH_SERVER_MAX_REQUEST_CHARS &&
+        Command->LengthInChars <= YORI_LIBSH_SERVER_MAX_REQUEST_CHARS) {
+
+        Request.Version = YORI_LIBSH_SERVER_VERSION;
+        Request.CurrentDirectoryLength = CurrentDirectory.LengthInChars;
+        Request.EnvironmentLength = Environment.LengthInChars;
+        Request.CommandLength = Command->LengthInChars;
+
+        if (YRunWrite(Pipe, &Request, sizeof(Request)) &&
+            YRunWrite(Pipe, CurrentDirectory.StartOfString, CurrentDirectory.LengthInChars * sizeof(TCHAR)) &&
+            YRunWrite(Pipe, Environment.StartOfString, Environment.LengthInChars * sizeof(TCHAR)) &&
+            YRunWrite(Pipe, Command->StartOfString, Command->LengthInChars * sizeof(TCHAR))) {
+
+            Result = TRUE;
+        }
+    }
+
+    YoriLibFreeStringContents(&Environment);
+    YoriLibFreeStringContents(&CurrentDirectory);
+    return Result;
+}
+
+/**
+ Receive output from the server until the command completes.
+
+ @param Pipe Handle to the pipe connected to the server.
+
+ @param ExitCode On successful completion, populated with the exit code of
+        the command.
+
+ @return TRUE to indicate the command completed, FALSE if the server
+         disconnected before the command completed.
+ */
+__success(return)
+BOOLEAN
+YRunReceiveResponse(
+    __in HANDLE Pipe,
+    __out PDWORD ExitCode
+    )
+{
+    YORI_LIBSH_SERVER_RESPONSE Response;
+    PUCHAR Buffer;
+    HANDLE OutputHandle;
+    DWORD BytesToRead;
+    DWORD BytesWritten;
+
+    Buffer = YoriLibMalloc(YRUN_BUFFER_SIZE);
+    if (Buffer == NULL) {
+        return FALSE;
+    }
+
+    while (YRunRead(Pipe, &Response, sizeof(Response))) {
+        if (Response.Type == YORI_LIBSH_SERVER_RESPONSE_EXIT) {
+            if (Response.Length != sizeof(DWORD) ||
+                !YRunRead(Pipe, ExitCode, sizeof(DWORD))) {
+
+                break;
+            }
+            YoriLibFree(Buffer);
+            return TRUE;
+        }
+
+        if (Response.Type == YORI_LIBSH_SERVER_RESPONSE_STDERR) {
+            OutputHandle = GetStdHandle(STD_ERROR_HANDLE);
+        } else {
+            OutputHandle = GetStdHandle(STD_OUTPUT_HANDLE);
+        }
+
+        while (Response.Length > 0) {
+            BytesToRead = Response.Length;
+            if (BytesToRead > YRUN_BUFFER_SIZE) {
+                BytesToRead = YRUN_BUFFER_SIZE;
+            }
+
+            if (!YRunRead(Pipe, Buffer, BytesToRead)) {
+                YoriLibFree(Buffer);
+                return FALSE;
+            }
+
+            WriteFile(OutputHandle, Buffer, BytesToRead, &BytesWritten, NULL);
+            Response.Length = Response.Length - BytesToRead;
+        }
+    }
+
+    YoriLibFree(Buffer);
+    return FALSE;
+}
+
+#ifdef YORI_BUILTIN
+/**
+ The main entrypoint for the yrun builtin command.
+ */
+#define ENTRYPOINT YoriCmd_YRUN
+#else
+/**
+ The main entrypoint for the yrun standalone application.
+ */
+#define ENTRYPOINT ymain
+#endif
+
+/**
+ The main entrypoint for the yrun cmdlet.
+
+ @param ArgC The number of arguments.
+
+ @param ArgV An array of arguments.
+
+ @return Exit code of the process, which is the exit code of the command
+         if it was executed.
+ */
+DWORD
+ENTRYPOINT(
+    __in YORI_ALLOC_SIZE_T ArgC,
+    __in YORI_STRING ArgV[]
+    )
+{
+    BOOLEAN ArgumentUnderstood;
+    YORI_ALLOC_SIZE_T StartArg;
+    YORI_ALLOC_SIZE_T i;
+    YORI_STRING Arg;
+    YORI_STRING ServerName;
+    YORI_STRING PipeName;
+    YORI_STRING Command;
+    YORI_ALLOC_SIZE_T EnvVarLength;
+    HANDLE Pipe;
+    DWORD ExitCode;
+    DWORD Err;
+    LPTSTR ErrText;
+
+    StartArg = 0;
+    YoriLibInitEmptyString(&ServerName);
+
+    for (i = 1; i < ArgC; i++) {
+
+        ArgumentUnderstood = FALSE;
+        ASSERT(YoriLibIsStringNullTerminated(&ArgV[i]));
+
+        if (YoriLibIsCommandLineOption(&ArgV[i], &Arg)) {
+
+            if (YoriLibCompareStringLitIns(&Arg, _T("?")) == 0) {
+                YRunHelp();
+                return EXIT_SUCCESS;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("license")) == 0) {
+                YoriLibDisplayMitLicense(_T("2026"));
+                return EXIT_SUCCESS;
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("n")) == 0) {
+                if (ArgC > i + 1) {
+                    YoriLibFreeStringContents(&ServerName);
+                    YoriLibCloneString(&ServerName, &ArgV[i + 1]);
+                    i++;
+                    ArgumentUnderstood = TRUE;
+                }
+            } else if (YoriLibCompareStringLitIns(&Arg, _T("-")) == 0) {
+                StartArg = i + 1;
+                ArgumentUnderstood = TRUE;
+                break;
+            }
+        } else {
+            ArgumentUnderstood = TRUE;
+            StartArg = i;
+            break;
+        }
+
+        if (!ArgumentUnderstood) {
+            YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("Argument not understood, ignored: %y\n"), &ArgV[i]);
+        }
+    }
+
+    if (StartArg == 0 || StartArg >= ArgC) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("yrun: missing argument\n"));
+        YoriLibFreeStringContents(&ServerName);
+        return EXIT_FAILURE;
+    }
+
+    if (ServerName.LengthInChars == 0) {
+        EnvVarLength = (YORI_ALLOC_SIZE_T)GetEnvironmentVariable(_T("YORISERVER"), NULL, 0);
+        if (EnvVarLength > 0 && YoriLibAllocateString(&ServerName, EnvVarLength)) {
+            ServerName.LengthInChars = (YORI_ALLOC_SIZE_T)GetEnvironmentVariable(_T("YORISERVER"), ServerName.StartOfString, ServerName.LengthAllocated);
+            if (ServerName.LengthInChars >= ServerName.LengthAllocated) {
+                ServerName.LengthInChars = 0;
+            }
+        }
+    }
+
+    if (ServerName.LengthInChars == 0) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("yrun: no server specified\n"));
+        YoriLibFreeStringContents(&ServerName);
+        return EXIT_FAILURE;
+    }
+
+    YoriLibInitEmptyString(&PipeName);
+    YoriLibYPrintf(&PipeName, _T("%s%y"), YORI_LIBSH_SERVER_PIPE_PREFIX, &ServerName);
+    YoriLibFreeStringContents(&ServerName);
+    if (PipeName.StartOfString == NULL) {
+        return EXIT_FAILURE;
+    }
+
+    if (!YoriLibBuildCmdlineFromArgcArgv(ArgC - StartArg, &ArgV[StartArg], TRUE, TRUE, &Command)) {
+        YoriLibFreeStringContents(&PipeName);
+        return EXIT_FAILURE;
+    }
+
+    Pipe = YRunConnect(&PipeName);
+    if (Pipe == INVALID_HANDLE_VALUE) {
+        Err = GetLastError();
+        ErrText = YoriLibGetWinErrorText(Err);
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("yrun: could not connect to %y: %s"), &PipeName, ErrText);
+        YoriLibFreeWinErrorText(ErrText);
+        YoriLibFreeStringContents(&Command);
+        YoriLibFreeStringContents(&PipeName);
+        return EXIT_FAILURE;
+    }
+
+    ExitCode = EXIT_FAILURE;
+    if (!YRunSendRequest(Pipe, &Command)) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("yrun: could not send request\n"));
+    } else if (!YRunReceiveResponse(Pipe, &ExitCode)) {
+        YoriLibOutput(YORI_LIB_OUTPUT_STDERR, _T("yrun: server disconnected before command completed\n"));
+        ExitCode = EXIT_FAILURE;
+    }
+
+    CloseHandle(Pipe);
+    YoriLibFreeStringContents(&Command);
+    YoriLibFreeStringContents(&PipeName);
+    return ExitCode;
+}
+
+// vim:sw=4:ts=4:et:
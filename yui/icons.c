@@ -40,6 +40,14 @@ typedef struct _YUI_ICON_CACHE_STATE {
      */
     YORI_LIST_ENTRY CachedIcons;
 
+    /**
+     A hash table of icons known to the icon cache, keyed by a string
+     combining the file name, icon index and size.  The start menu can
+     contain hundreds of icons, so this avoids a linear scan of the cache
+     for each one.
+     */
+    PYORI_HASH_TABLE CachedIconTable;
+
     /**
      The number of times an icon lookup was resolved from the cache.
      */
@@ -80,6 +88,11 @@ YuiIconCacheCleanupContext(VOID)
         ASSERT(Icon->ReferenceCount == 1);
         YuiIconCacheDereference(Icon);
     }
+
+    if (YuiIconCacheState.CachedIconTable != NULL) {
+        YoriLibFreeEmptyHashTable(YuiIconCacheState.CachedIconTable);
+        YuiIconCacheState.CachedIconTable = NULL;
+    }
 }
 
 /**
@@ -96,6 +109,52 @@ YuiIconCacheInitializeContext(
 {
     UNREFERENCED_PARAMETER(YuiContext);
     YoriLibInitializeListHead(&YuiIconCacheState.CachedIcons);
+    YuiIconCacheState.CachedIconTable = YoriLibAllocateHashTable(250);
+    if (YuiIconCacheState.CachedIconTable == NULL) {
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/**
+ Generate the key used to find an icon in the cache.
+
+ @param FileName Optional pointer to the file name to load the icon from.
+        If not specified, the icon is loaded from the running executable.
+
+ @param IconIndex The index of the icon within the file, or the resource
+        identifier of the icon within the executable.
+
+ @param LargeIcon TRUE if the large icon should be loaded; FALSE if the small
+        icon should be loaded.
+
+ @param HashKey On successful completion, populated with the key.  The caller
+        should free this with @ref YoriLibFreeStringContents .
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOLEAN
+YuiIconCacheBuildKey(
+    __in_opt PYORI_STRING FileName,
+    __in DWORD IconIndex,
+    __in BOOLEAN LargeIcon,
+    __out PYORI_STRING HashKey
+    )
+{
+    YORI_STRING EmptyFileName;
+
+    YoriLibInitEmptyString(&EmptyFileName);
+    if (FileName == NULL) {
+        FileName = &EmptyFileName;
+    }
+
+    YoriLibInitEmptyString(HashKey);
+    YoriLibYPrintf(HashKey, _T("%08x%c%y"), IconIndex, LargeIcon?'L':'S', FileName);
+    if (HashKey->StartOfString == NULL) {
+        return FALSE;
+    }
+
     return TRUE;
 }
 
@@ -122,25 +181,23 @@ YuiIconCacheLookupAndReference(
     __in BOOLEAN LargeIcon
     )
 {
-    PYORI_LIST_ENTRY ListEntry;
+    PYORI_HASH_ENTRY HashEntry;
     PYUI_MENU_SHARED_ICON Icon;
+    YORI_STRING HashKey;
 
-    ListEntry = YoriLibGetNextListEntry(&YuiIconCacheState.CachedIcons, NULL);
-
-    while (ListEntry != NULL) {
-        Icon = CONTAINING_RECORD(ListEntry, YUI_MENU_SHARED_ICON, ListEntry);
-        if (((FileName == NULL && Icon->FileName.StartOfString == NULL) ||
-             (FileName != NULL && YoriLibCompareStringIns(FileName, &Icon->FileName) == 0)) &&
-            Icon->IconIndex == IconIndex &&
-            Icon->LargeIcon == LargeIcon) {
+    if (!YuiIconCacheBuildKey(FileName, IconIndex, LargeIcon, &HashKey)) {
+        return NULL;
+    }
 
-            Icon->ReferenceCount = Icon->ReferenceCount + 1;
-            return Icon;
-        }
-        ListEntry = YoriLibGetNextListEntry(&YuiIconCacheState.CachedIcons, ListEntry);
+    HashEntry = YoriLibHashLookupByKey(YuiIconCacheState.CachedIconTable, &HashKey);
+    YoriLibFreeStringContents(&HashKey);
+    if (HashEntry == NULL) {
+        return NULL;
     }
 
-    return NULL;
+    Icon = HashEntry->Context;
+    Icon->ReferenceCount = Icon->ReferenceCount + 1;
+    return Icon;
 }
 
 /**
@@ -400,6 +457,12 @@ YuiIconCacheCreateOrReference(
 
     Icon->ReferenceCount = 1;
 
+    if (!YuiIconCacheBuildKey(FileName, IconIndex, LargeIcon, &Icon->HashKey)) {
+        YoriLibDereference(Icon);
+        YuiIconCacheState.CacheFailures++;
+        return NULL;
+    }
+
     if (LargeIcon) {
         IconWidth = YuiContext->TallIconWidth;
         IconHeight = YuiContext->TallIconHeight;
@@ -422,6 +485,7 @@ YuiIconCacheCreateOrReference(
         }
 
         if (Icon->Icon == NULL) {
+            YoriLibFreeStringContents(&Icon->HashKey);
             YoriLibDereference(Icon);
             YuiIconCacheState.CacheFailures++;
             return FALSE;
@@ -438,6 +502,7 @@ YuiIconCacheCreateOrReference(
         }
         Icon->Icon = YuiExtractIcon(FileName, IconIndex, Width, Height);
         if (Icon->Icon == NULL) {
+            YoriLibFreeStringContents(&Icon->HashKey);
             YoriLibDereference(Icon);
             YuiIconCacheState.CacheFailures++;
             return FALSE;
@@ -458,6 +523,7 @@ YuiIconCacheCreateOrReference(
     Icon->IconIndex = IconIndex;
     Icon->LargeIcon = LargeIcon;
     YoriLibAppendList(&YuiIconCacheState.CachedIcons, &Icon->ListEntry);
+    YoriLibHashInsertByKey(YuiIconCacheState.CachedIconTable, &Icon->HashKey, Icon, &Icon->HashEntry);
 
     return Icon;
 }
@@ -478,6 +544,7 @@ YuiIconCacheDereference(
     if (Icon->ReferenceCount == 0) {
         if (Icon->ListEntry.Next != NULL) {
             YoriLibRemoveListItem(&Icon->ListEntry);
+            YoriLibHashRemoveByEntry(&Icon->HashEntry);
         }
 
         if (Icon->Icon != NULL) {
@@ -485,6 +552,7 @@ YuiIconCacheDereference(
             Icon->Icon = NULL;
         }
         YoriLibFreeStringContents(&Icon->FileName);
+        YoriLibFreeStringContents(&Icon->HashKey);
         YoriLibDereference(Icon);
     }
 }
@@ -129,6 +129,124 @@ typedef struct _YUI_MENU_FILE {
     DWORD MenuId;
 } YUI_MENU_FILE, *PYUI_MENU_FILE;
 
+/**
+ The signature at the start of the shortcut cache file, 'YMNU'.
+ */
+#define YUI_MENU_SHORTCUT_CACHE_SIGNATURE 0x554e4d59
+
+/**
+ The version of the shortcut cache file format.
+ */
+#define YUI_MENU_SHORTCUT_CACHE_VERSION 1
+
+/**
+ The largest shortcut cache file that will be loaded.  This is far beyond
+ any plausible start menu and exists to avoid allocating arbitrary amounts
+ of memory for a corrupt file.
+ */
+#define YUI_MENU_SHORTCUT_CACHE_MAX_SIZE (16 * 1024 * 1024)
+
+/**
+ Information previously obtained by opening a shortcut.  Opening each
+ shortcut is the most expensive part of populating the start menu, so this
+ is retained across reloads and saved to disk, and a shortcut is only opened
+ again if its timestamp or size has changed.
+ */
+typedef struct _YUI_MENU_SHORTCUT_INFO {
+
+    /**
+     The entry for this shortcut within the shortcut cache, keyed by the
+     full path to the shortcut.
+     */
+    YORI_HASH_ENTRY HashEntry;
+
+    /**
+     A fully qualified path to the shortcut.
+     */
+    YORI_STRING FilePath;
+
+    /**
+     The file containing the icon for the shortcut.  This is empty if the
+     shortcut has no icon that can be used.
+     */
+    YORI_STRING IconPath;
+
+    /**
+     The last write time of the shortcut when it was opened.
+     */
+    LARGE_INTEGER LastWriteTime;
+
+    /**
+     The size of the shortcut when it was opened.
+     */
+    LARGE_INTEGER FileSize;
+
+    /**
+     The index of the icon within IconPath.
+     */
+    DWORD IconIndex;
+
+    /**
+     TRUE if the shortcut has been found while populating the start menu.
+     Entries that are not found are discarded once population completes.
+     */
+    BOOLEAN Seen;
+} YUI_MENU_SHORTCUT_INFO, *PYUI_MENU_SHORTCUT_INFO;
+
+/**
+ The header of the shortcut cache file.
+ */
+typedef struct _YUI_MENU_SHORTCUT_CACHE_HEADER {
+
+    /**
+     Set to @ref YUI_MENU_SHORTCUT_CACHE_SIGNATURE .
+     */
+    DWORD Signature;
+
+    /**
+     Set to @ref YUI_MENU_SHORTCUT_CACHE_VERSION .
+     */
+    DWORD Version;
+
+    /**
+     The number of records following the header.
+     */
+    DWORD EntryCount;
+} YUI_MENU_SHORTCUT_CACHE_HEADER, *PYUI_MENU_SHORTCUT_CACHE_HEADER;
+
+/**
+ A single shortcut within the shortcut cache file.  This is followed by the
+ characters of the shortcut path and then the characters of the icon path,
+ without NULL terminators.
+ */
+typedef struct _YUI_MENU_SHORTCUT_CACHE_RECORD {
+
+    /**
+     The last write time of the shortcut when it was opened.
+     */
+    LARGE_INTEGER LastWriteTime;
+
+    /**
+     The size of the shortcut when it was opened.
+     */
+    LARGE_INTEGER FileSize;
+
+    /**
+     The index of the icon within the icon path.
+     */
+    DWORD IconIndex;
+
+    /**
+     The number of characters in the shortcut path.
+     */
+    DWORD FilePathLength;
+
+    /**
+     The number of characters in the icon path.
+     */
+    DWORD IconPathLength;
+} YUI_MENU_SHORTCUT_CACHE_RECORD, *PYUI_MENU_SHORTCUT_CACHE_RECORD;
+
 
 /**
  A context structure for the menu module.
@@ -318,6 +436,22 @@ typedef struct _YUI_MENU_CONTEXT {
      */
     YUI_MENU_OWNERDRAW_ITEM WinContextLaunchNew;
 
+    /**
+     Information about shortcuts found when the start menu was previously
+     populated, keyed by the full path to each shortcut.
+     */
+    PYORI_HASH_TABLE ShortcutCache;
+
+    /**
+     TRUE if an attempt has been made to load ShortcutCache from disk.
+     */
+    BOOLEAN ShortcutCacheLoaded;
+
+    /**
+     TRUE if ShortcutCache has changed since it was loaded or saved.
+     */
+    BOOLEAN ShortcutCacheDirty;
+
 } YUI_MENU_CONTEXT, *PYUI_MENU_CONTEXT;
 
 /**
@@ -325,6 +459,487 @@ typedef struct _YUI_MENU_CONTEXT {
  */
 YUI_MENU_CONTEXT YuiMenuContext;
 
+/**
+ Return the fully qualified name of the file used to save shortcut
+ information between instances.
+
+ @param FileName On successful completion, populated with the file name.
+        The caller should free this with @ref YoriLibFreeStringContents .
+
+ @return TRUE to indicate success, FALSE to indicate failure.
+ */
+__success(return)
+BOOL
+YuiMenuGetShortcutCacheFileName(
+    __out PYORI_STRING FileName
+    )
+{
+    YORI_STRING UserName;
+
+    YoriLibInitEmptyString(FileName);
+    YoriLibConstantString(&UserName, _T("~LOCALAPPDATA\\Yori\\YuiMenu.dat"));
+    return YoriLibUserStringToSingleFilePath(&UserName, TRUE, FileName);
+}
+
+/**
+ Remove a shortcut from the shortcut cache and free it.
+
+ @param Info Pointer to the shortcut information to free.
+ */
+VOID
+YuiMenuFreeShortcutInfo(
+    __in PYUI_MENU_SHORTCUT_INFO Info
+    )
+{
+    YoriLibHashRemoveByEntry(&Info->HashEntry);
+    YoriLibFreeStringContents(&Info->FilePath);
+    YoriLibFreeStringContents(&Info->IconPath);
+    YoriLibDereference(Info);
+}
+
+/**
+ Record information about a shortcut in the shortcut cache, replacing any
+ information previously recorded for the same shortcut.
+
+ @param FilePath Pointer to the fully qualified path to the shortcut.
+
+ @param LastWriteTime Pointer to the last write time of the shortcut.
+
+ @param FileSize Pointer to the size of the shortcut.
+
+ @param IconPath Pointer to the file containing the shortcut's icon.  This
+        may be empty if the shortcut has no usable icon.
+
+ @param IconIndex The index of the icon within IconPath.
+
+ @return Pointer to the new shortcut information, or NULL on allocation
+         failure.
+ */
+PYUI_MENU_SHORTCUT_INFO
+YuiMenuAddShortcutInfo(
+    __in PYORI_STRING FilePath,
+    __in PLARGE_INTEGER LastWriteTime,
+    __in PLARGE_INTEGER FileSize,
+    __in PYORI_STRING IconPath,
+    __in DWORD IconIndex
+    )
+{
+    PYUI_MENU_SHORTCUT_INFO Info;
+    PYORI_HASH_ENTRY HashEntry;
+
+    if (YuiMenuContext.ShortcutCache == NULL) {
+        YuiMenuContext.ShortcutCache = YoriLibAllocateHashTable(250);
+        if (YuiMenuContext.ShortcutCache == NULL) {
+            return NULL;
+        }
+    }
+
+    HashEntry = YoriLibHashLookupByKey(YuiMenuContext.ShortcutCache, FilePath);
+    if (HashEntry != NULL) {
+        YuiMenuFreeShortcutInfo(HashEntry->Context);
+    }
+
+    Info = YoriLibReferencedMalloc(sizeof(YUI_MENU_SHORTCUT_INFO) + (FilePath->LengthInChars + 1 + IconPath->LengthInChars + 1) * sizeof(TCHAR));
+    if (Info == NULL) {
+        return NULL;
+    }
+
+    YoriLibReference(Info);
+    YoriLibReference(Info);
+
+    YoriLibInitEmptyString(&Info->FilePath);
+    Info->FilePath.StartOfString = (LPTSTR)(Info + 1);
+    Info->FilePath.LengthAllocated = FilePath->LengthInChars + 1;
+    Info->FilePath.LengthInChars = FilePath->LengthInChars;
+    Info->FilePath.MemoryToFree = Info;
+    memcpy(Info->FilePath.StartOfString, FilePath->StartOfString, FilePath->LengthInChars * sizeof(TCHAR));
+    Info->FilePath.StartOfString[Info->FilePath.LengthInChars] = '\0';
+
+    YoriLibInitEmptyString(&Info->IconPath);
+    Info->IconPath.StartOfString = Info->FilePath.StartOfString + Info->FilePath.LengthAllocated;
+    Info->IconPath.LengthAllocated = IconPath->LengthInChars + 1;
+    Info->IconPath.LengthInChars = IconPath->LengthInChars;
+    Info->IconPath.MemoryToFree = Info;
+    memcpy(Info->IconPath.StartOfString, IconPath->StartOfString, IconPath->LengthInChars * sizeof(TCHAR));
+    Info->IconPath.StartOfString[Info->IconPath.LengthInChars] = '\0';
+
+    Info->LastWriteTime.QuadPart = LastWriteTime->QuadPart;
+    Info->FileSize.QuadPart = FileSize->QuadPart;
+    Info->IconIndex = IconIndex;
+    Info->Seen = FALSE;
+
+    YoriLibHashInsertByKey(YuiMenuContext.ShortcutCache, &Info->FilePath, Info, &Info->HashEntry);
+    YuiMenuContext.ShortcutCacheDirty = TRUE;
+
+    return Info;
+}
+
+/**
+ Load shortcut information saved by a previous instance.  If the file does
+ not exist or is not valid, the cache is left empty and shortcuts are opened
+ as they are found.
+
+ @return TRUE to indicate the cache was loaded, FALSE if it was not.
+ */
+BOOL
+YuiMenuLoadShortcutCache(VOID)
+{
+    YORI_STRING FileName;
+    YORI_STRING FilePath;
+    YORI_STRING IconPath;
+    YUI_MENU_SHORTCUT_CACHE_HEADER Header;
+    YUI_MENU_SHORTCUT_CACHE_RECORD Record;
+    HANDLE hFile;
+    PUCHAR Buffer;
+    DWORD FileSize;
+    DWORD BytesRead;
+    DWORD Offset;
+    DWORD Index;
+    DWORD CharsRemaining;
+
+    YuiMenuContext.ShortcutCacheLoaded = TRUE;
+
+    if (!YuiMenuGetShortcutCacheFileName(&FileName)) {
+        return FALSE;
+    }
+
+    hFile = CreateFile(FileName.StartOfString,
+                       GENERIC_READ,
+                       FILE_SHARE_READ | FILE_SHARE_DELETE,
+                       NULL,
+                       OPEN_EXISTING,
+                       FILE_ATTRIBUTE_NORMAL,
+                       NULL);
+
+    YoriLibFreeStringContents(&FileName);
+    if (hFile == INVALID_HANDLE_VALUE) {
+        return FALSE;
+    }
+
+    FileSize = GetFileSize(hFile, NULL);
+    if (FileSize == INVALID_FILE_SIZE ||
+        FileSize < sizeof(Header) ||
+        FileSize > YUI_MENU_SHORTCUT_CACHE_MAX_SIZE) {
+
+        CloseHandle(hFile);
+        return FALSE;
+    }
+
+    Buffer = YoriLibMalloc(FileSize);
+    if (Buffer == NULL) {
+        CloseHandle(hFile);
+        return FALSE;
+    }
+
+    if (!ReadFile(hFile, Buffer, FileSize, &BytesRead, NULL) ||
+        BytesRead != FileSize) {
+
+        YoriLibFree(Buffer);
+        CloseHandle(hFile);
+        return FALSE;
+    }
+    CloseHandle(hFile);
+
+    memcpy(&Header, Buffer, sizeof(Header));
+    if (Header.Signature != YUI_MENU_SHORTCUT_CACHE_SIGNATURE ||
+        Header.Version != YUI_MENU_SHORTCUT_CACHE_VERSION) {
+
+        YoriLibFree(Buffer);
+        return FALSE;
+    }
+
+    //
+    //  Records are copied out of the buffer since they are not aligned.
+    //  Stop at the first record that doesn't fit in the file.
+    //
+
+    Offset = sizeof(Header);
+    for (Index = 0; Index < Header.EntryCount; Index++) {
+        if (FileSize - Offset < sizeof(Record)) {
+            break;
+        }
+
+        memcpy(&Record, &Buffer[Offset], sizeof(Record));
+        Offset = Offset + sizeof(Record);
+
+        CharsRemaining = (FileSize - Offset) / sizeof(TCHAR);
+        if (Record.FilePathLength == 0 ||
+            Record.FilePathLength > CharsRemaining ||
+            Record.IconPathLength > CharsRemaining - Record.FilePathLength) {
+
+            break;
+        }
+
+        YoriLibInitEmptyString(&FilePath);
+        FilePath.StartOfString = (LPTSTR)&Buffer[Offset];
+        FilePath.LengthInChars = (YORI_ALLOC_SIZE_T)Record.FilePathLength;
+
+        YoriLibInitEmptyString(&IconPath);
+        IconPath.StartOfString = FilePath.StartOfString + FilePath.LengthInChars;
+        IconPath.LengthInChars = (YORI_ALLOC_SIZE_T)Record.IconPathLength;
+
+        if (YuiMenuAddShortcutInfo(&FilePath, &Record.LastWriteTime, &Record.FileSize, &IconPath, Record.IconIndex) == NULL) {
+            break;
+        }
+
+        Offset = Offset + (Record.FilePathLength + Record.IconPathLength) * sizeof(TCHAR);
+    }
+
+    YoriLibFree(Buffer);
+    YuiMenuContext.ShortcutCacheDirty = FALSE;
+    return TRUE;
+}
+
+/**
+ Save the shortcut cache so that a later instance can populate the start
+ menu without opening every shortcut.
+
+ @return TRUE to indicate the cache was saved, FALSE if it was not.
+ */
+BOOL
+YuiMenuSaveShortcutCache(VOID)
+{
+    YORI_STRING FileName;
+    YUI_MENU_SHORTCUT_CACHE_HEADER Header;
+    YUI_MENU_SHORTCUT_CACHE_RECORD Record;
+    PYUI_MENU_SHORTCUT_INFO Info;
+    PYORI_HASH_ENTRY HashEntry;
+    HANDLE hFile;
+    PUCHAR Buffer;
+    LPTSTR Sep;
+    DWORDLONG BufferSize;
+    DWORD Offset;
+    DWORD BytesWritten;
+    BOOL Result;
+
+    if (YuiMenuContext.ShortcutCache == NULL) {
+        return FALSE;
+    }
+
+    Header.Signature = YUI_MENU_SHORTCUT_CACHE_SIGNATURE;
+    Header.Version = YUI_MENU_SHORTCUT_CACHE_VERSION;
+    Header.EntryCount = 0;
+
+    BufferSize = sizeof(Header);
+    HashEntry = YoriLibHashGetNextEntry(YuiMenuContext.ShortcutCache, NULL);
+    while (HashEntry != NULL) {
+        Info = HashEntry->Context;
+        BufferSize = BufferSize + sizeof(Record) + (Info->FilePath.LengthInChars + Info->IconPath.LengthInChars) * sizeof(TCHAR);
+        Header.EntryCount++;
+        HashEntry = YoriLibHashGetNextEntry(YuiMenuContext.ShortcutCache, HashEntry);
+    }
+
+    if (BufferSize > YUI_MENU_SHORTCUT_CACHE_MAX_SIZE) {
+        return FALSE;
+    }
+
+    Buffer = YoriLibMalloc((YORI_ALLOC_SIZE_T)BufferSize);
+    if (Buffer == NULL) {
+        return FALSE;
+    }
+
+    memcpy(Buffer, &Header, sizeof(Header));
+    Offset = sizeof(Header);
+
+    HashEntry = YoriLibHashGetNextEntry(YuiMenuContext.ShortcutCache, NULL);
+    while (HashEntry != NULL) {
+        Info = HashEntry->Context;
+        Record.LastWriteTime.QuadPart = Info->LastWriteTime.QuadPart;
+        Record.FileSize.QuadPart = Info->FileSize.QuadPart;
+        Record.IconIndex = Info->IconIndex;
+        Record.FilePathLength = Info->FilePath.LengthInChars;
+        Record.IconPathLength = Info->IconPath.LengthInChars;
+        memcpy(&Buffer[Offset], &Record, sizeof(Record));
+        Offset = Offset + sizeof(Record);
+        memcpy(&Buffer[Offset], Info->FilePath.StartOfString, Info->FilePath.LengthInChars * sizeof(TCHAR));
+        Offset = Offset + Info->FilePath.LengthInChars * sizeof(TCHAR);
+        memcpy(&Buffer[Offset], Info->IconPath.StartOfString, Info->IconPath.LengthInChars * sizeof(TCHAR));
+        Offset = Offset + Info->IconPath.LengthInChars * sizeof(TCHAR);
+        HashEntry = YoriLibHashGetNextEntry(YuiMenuContext.ShortcutCache, HashEntry);
+    }
+
+    ASSERT(Offset == BufferSize);
+
+    if (!YuiMenuGetShortcutCacheFileName(&FileName)) {
+        YoriLibFree(Buffer);
+        return FALSE;
+    }
+
+    //
+    //  The directory may not exist if Yori has not been installed per
+    //  user, so try to create it.  If this fails, creating the file will
+    //  fail too.
+    //
+
+    Sep = YoriLibFindRightMostCharacter(&FileName, '\\');
+    if (Sep != NULL) {
+        *Sep = '\0';
+        CreateDirectory(FileName.StartOfString, NULL);
+        *Sep = '\\';
+    }
+
+    hFile = CreateFile(FileName.StartOfString,
+                       GENERIC_WRITE,
+                       0,
+                       NULL,
+                       CREATE_ALWAYS,
+                       FILE_ATTRIBUTE_NORMAL,
+                       NULL);
+
+    YoriLibFreeStringContents(&FileName);
+    if (hFile == INVALID_HANDLE_VALUE) {
+        YoriLibFree(Buffer);
+        return FALSE;
+    }
+
+    Result = FALSE;
+    if (WriteFile(hFile, Buffer, Offset, &BytesWritten, NULL) &&
+        BytesWritten == Offset) {
+
+        Result = TRUE;
+        YuiMenuContext.ShortcutCacheDirty = FALSE;
+    }
+
+    CloseHandle(hFile);
+    YoriLibFree(Buffer);
+    return Result;
+}
+
+/**
+ Discard information about any shortcut that was not found when populating
+ the start menu, since it has been deleted or renamed, and prepare the
+ remaining entries for the next population.
+ */
+VOID
+YuiMenuTrimShortcutCache(VOID)
+{
+    PYUI_MENU_SHORTCUT_INFO Info;
+    PYORI_HASH_ENTRY HashEntry;
+
+    if (YuiMenuContext.ShortcutCache == NULL) {
+        return;
+    }
+
+    HashEntry = YoriLibHashGetNextEntry(YuiMenuContext.ShortcutCache, NULL);
+    while (HashEntry != NULL) {
+        Info = HashEntry->Context;
+        HashEntry = YoriLibHashGetNextEntry(YuiMenuContext.ShortcutCache, HashEntry);
+        if (Info->Seen) {
+            Info->Seen = FALSE;
+        } else {
+            YuiMenuFreeShortcutInfo(Info);
+            YuiMenuContext.ShortcutCacheDirty = TRUE;
+        }
+    }
+}
+
+/**
+ Free all shortcut information.
+ */
+VOID
+YuiMenuFreeShortcutCache(VOID)
+{
+    PYORI_HASH_ENTRY HashEntry;
+
+    if (YuiMenuContext.ShortcutCache == NULL) {
+        return;
+    }
+
+    HashEntry = YoriLibHashGetNextEntry(YuiMenuContext.ShortcutCache, NULL);
+    while (HashEntry != NULL) {
+        YuiMenuFreeShortcutInfo(HashEntry->Context);
+        HashEntry = YoriLibHashGetNextEntry(YuiMenuContext.ShortcutCache, NULL);
+    }
+
+    YoriLibFreeEmptyHashTable(YuiMenuContext.ShortcutCache);
+    YuiMenuContext.ShortcutCache = NULL;
+}
+
+/**
+ Find the icon for a shortcut.  If the shortcut is unchanged since it was
+ last opened, the result is returned from the shortcut cache; otherwise the
+ shortcut is opened and the cache is updated.
+
+ @param FilePath Pointer to the fully qualified path to the shortcut.
+
+ @param FileInfo Pointer to information about the shortcut returned from
+        directory enumeration.
+
+ @param IconPath On successful completion, populated with the file
+        containing the icon.  The caller should free this with
+        @ref YoriLibFreeStringContents .
+
+ @param IconIndex On successful completion, populated with the index of the
+        icon within IconPath.
+
+ @return TRUE to indicate the shortcut has an icon, FALSE if it does not.
+ */
+__success(return)
+BOOL
+YuiMenuGetShortcutIconPath(
+    __in PYORI_STRING FilePath,
+    __in PWIN32_FIND_DATA FileInfo,
+    __out PYORI_STRING IconPath,
+    __out PDWORD IconIndex
+    )
+{
+    PYUI_MENU_SHORTCUT_INFO Info;
+    PYORI_HASH_ENTRY HashEntry;
+    LARGE_INTEGER LastWriteTime;
+    LARGE_INTEGER FileSize;
+    YORI_STRING LoadedIconPath;
+    DWORD LoadedIconIndex;
+
+    LastWriteTime.LowPart = FileInfo->ftLastWriteTime.dwLowDateTime;
+    LastWriteTime.HighPart = (LONG)FileInfo->ftLastWriteTime.dwHighDateTime;
+    FileSize.LowPart = FileInfo->nFileSizeLow;
+    FileSize.HighPart = (LONG)FileInfo->nFileSizeHigh;
+
+    YoriLibInitEmptyString(IconPath);
+
+    if (YuiMenuContext.ShortcutCache != NULL) {
+        HashEntry = YoriLibHashLookupByKey(YuiMenuContext.ShortcutCache, FilePath);
+        if (HashEntry != NULL) {
+            Info = HashEntry->Context;
+            if (Info->LastWriteTime.QuadPart == LastWriteTime.QuadPart &&
+                Info->FileSize.QuadPart == FileSize.QuadPart) {
+
+                Info->Seen = TRUE;
+                if (Info->IconPath.LengthInChars == 0) {
+                    return FALSE;
+                }
+                YoriLibCloneString(IconPath, &Info->IconPath);
+                *IconIndex = Info->IconIndex;
+                return TRUE;
+            }
+        }
+    }
+
+    //
+    //  Record shortcuts without a usable icon too, so they aren't opened
+    //  again each time the menu is populated.
+    //
+
+    if (!YoriLibLoadShortcutIconPath(FilePath, &LoadedIconPath, &LoadedIconIndex)) {
+        YoriLibInitEmptyString(&LoadedIconPath);
+        LoadedIconIndex = 0;
+    }
+
+    Info = YuiMenuAddShortcutInfo(FilePath, &LastWriteTime, &FileSize, &LoadedIconPath, LoadedIconIndex);
+    if (Info != NULL) {
+        Info->Seen = TRUE;
+    }
+
+    if (LoadedIconPath.LengthInChars == 0) {
+        YoriLibFreeStringContents(&LoadedIconPath);
+        return FALSE;
+    }
+
+    memcpy(IconPath, &LoadedIconPath, sizeof(YORI_STRING));
+    *IconIndex = LoadedIconIndex;
+    return TRUE;
+}
+
 /**
  Initialize an empty ownerdraw menu item.
 
@@ -408,6 +1023,8 @@ YuiMenuCleanupContext(VOID)
     YuiMenuCleanupItem(&YuiMenuContext.WinContextClose);
     YuiMenuCleanupItem(&YuiMenuContext.WinContextTerminateProcess);
     YuiMenuCleanupItem(&YuiMenuContext.WinContextLaunchNew);
+
+    YuiMenuFreeShortcutCache();
 }
 
 /**
@@ -754,6 +1371,9 @@ YuiDeleteMenuDirectory(
 
  @param FilePath Pointer to the full path to a shortcut file for this entry.
 
+ @param FileInfo Pointer to information about the shortcut file returned
+        from directory enumeration.
+
  @param FriendlyName Pointer to the human readable name for the file.
 
  @param TallItem TRUE if the item should be a full height item, FALSE if the
@@ -765,6 +1385,7 @@ PYUI_MENU_FILE
 YuiCreateMenuFile(
     __in PYUI_CONTEXT YuiContext,
     __in PYORI_STRING FilePath,
+    __in PWIN32_FIND_DATA FileInfo,
     __in PYORI_STRING FriendlyName,
     __in BOOLEAN TallItem
     )
@@ -807,7 +1428,7 @@ YuiCreateMenuFile(
     memcpy(Entry->Item.Text.StartOfString, FriendlyName->StartOfString, FriendlyName->LengthInChars * sizeof(TCHAR));
     Entry->Item.Text.StartOfString[Entry->Item.Text.LengthInChars] = '\0';
 
-    if (YoriLibLoadShortcutIconPath(FilePath, &IconPath, &IconIndex)) {
+    if (YuiMenuGetShortcutIconPath(FilePath, FileInfo, &IconPath, &IconIndex)) {
         YORI_STRING Ext;
 
         YoriLibInitEmptyString(&Ext);
@@ -1488,7 +2109,7 @@ YuiFileFoundCallback(
             if (YoriLibCompareStringLitIns(&Ext, _T(".lnk")) == 0 &&
                 YuiFindDepthComponent(FilePath, &FriendlyName, 0, TRUE)) {
 
-                NewFile = YuiCreateMenuFile(YuiContext, FilePath, &FriendlyName, TRUE);
+                NewFile = YuiCreateMenuFile(YuiContext, FilePath, FileInfo, &FriendlyName, TRUE);
                 if (NewFile != NULL) {
                     NewFile->Depth = Depth + 1;
                     YuiInsertFileInOrder(&YuiMenuContext.StartDirectory, NewFile);
@@ -1529,7 +2150,7 @@ YuiFileFoundCallback(
         if (Parent != NULL &&
             YoriLibCompareStringLitIns(&Ext, _T(".lnk")) == 0 &&
             YuiFindDepthComponent(FilePath, &FriendlyName, 0, TRUE)) {
-            NewFile = YuiCreateMenuFile(YuiContext, FilePath, &FriendlyName, FALSE);
+            NewFile = YuiCreateMenuFile(YuiContext, FilePath, FileInfo, &FriendlyName, FALSE);
             if (NewFile != NULL) {
                 NewFile->Depth = Depth + 1;
                 YuiInsertFileInOrder(Parent, NewFile);
@@ -1792,6 +2413,16 @@ YuiMenuPopulate(
     MatchFlags = YORILIB_FILEENUM_RETURN_FILES | YORILIB_FILEENUM_RETURN_DIRECTORIES;
     MatchFlags |= YORILIB_FILEENUM_RECURSE_AFTER_RETURN | YORILIB_FILEENUM_RECURSE_PRESERVE_WILD;
 
+    //
+    //  Shortcuts that haven't changed since they were last opened are not
+    //  opened again.  On the first population, use the results from the
+    //  previous instance.
+    //
+
+    if (!YuiMenuContext.ShortcutCacheLoaded) {
+        YuiMenuLoadShortcutCache();
+    }
+
     //
     //  Load everything from the user's start menu directory, ignoring
     //  anything that's also under the programs directory.
@@ -1861,6 +2492,11 @@ YuiMenuPopulate(
                        YuiFileEnumerateErrorCallback,
                        YuiContext);
 
+    YuiMenuTrimShortcutCache();
+    if (YuiMenuContext.ShortcutCacheDirty) {
+        YuiMenuSaveShortcutCache();
+    }
+
     //
     //  Populate the menus with human readable strings from the entries we
     //  just loaded, and assign each menu an identifier that corresponds
@@ -342,6 +342,65 @@ YuiTaskbarMungeButtonText(
     }
 }
 
+/**
+ Query the icon for the window associated with a taskbar button, and update
+ the button's copy of the icon if it has changed.  This can invoke a
+ different process window procedure, so it is performed when a window is
+ created or indicates it should be redrawn, not each time the button is
+ painted.
+
+ @param Button Pointer to the taskbar button.
+
+ @return TRUE if the icon has changed and the button should be repainted,
+         FALSE if it has not changed.
+ */
+BOOLEAN
+YuiTaskbarUpdateWindowIcon(
+    __in PYUI_TASKBAR_BUTTON Button
+    )
+{
+    HICON Icon;
+    LRESULT Result;
+    DWORD_PTR MsgResult;
+
+    //
+    //  Set a fairly small timeout - if the remote window procedure doesn't
+    //  respond really fast, just fall back to the class icon.
+    //
+
+    Icon = NULL;
+    Result = SendMessageTimeout(Button->hWndToActivate, WM_GETICON, ICON_SMALL, 0, SMTO_ABORTIFHUNG | SMTO_BLOCK, 10, &MsgResult);
+    if (Result) {
+        Icon = (HICON)MsgResult;
+    }
+
+    if (Icon == NULL) {
+        Icon = (HICON)GetClassLongPtr(Button->hWndToActivate, GCLP_HICONSM);
+    }
+
+    if (Button->WindowIconQueried && Icon == Button->WindowIconSource) {
+        return FALSE;
+    }
+
+    Button->WindowIconQueried = TRUE;
+    Button->WindowIconSource = Icon;
+    if (Button->WindowIcon != NULL) {
+        DestroyIcon(Button->WindowIcon);
+        Button->WindowIcon = NULL;
+    }
+
+    //
+    //  The icon belongs to the window and can be destroyed by it at any
+    //  time, so keep a private copy to draw.
+    //
+
+    if (Icon != NULL) {
+        Button->WindowIcon = CopyIcon(Icon);
+    }
+
+    return TRUE;
+}
+
 /**
  Allocate memory for the structure that describes a taskbar button.  Note
  this does not create the button control itself.
@@ -392,6 +451,9 @@ YuiTaskbarAllocateAndAddButton(
     NewButton->WindowActive = FALSE;
     NewButton->AssociatedWindowFound = TRUE;
     NewButton->Flashing = FALSE;
+    NewButton->WindowIconQueried = FALSE;
+    NewButton->WindowIconSource = NULL;
+    NewButton->WindowIcon = NULL;
     NewButton->ProcessId = 0;
 
     CurrentTime = YoriLibGetSystemTimeAsInteger();
@@ -471,6 +533,10 @@ YuiTaskbarFreeButton(
         YoriLibDereference(ChildProcess);
         Button->ChildProcess = NULL;
     }
+    if (Button->WindowIcon != NULL) {
+        DestroyIcon(Button->WindowIcon);
+        Button->WindowIcon = NULL;
+    }
     YoriLibFreeStringContents(&Button->ButtonText);
     YoriLibDereference(Button);
 }
@@ -1190,12 +1256,37 @@ YuiTaskbarNotifyTitleChange(
         YuiTaskbarNotifyNewWindow(YuiContext, hWnd);
     } else {
         YORI_STRING NewTitle;
+        YORI_STRING OldTitle;
+        BOOLEAN IconChanged;
+
+        //
+        //  Windows indicate that they should be redrawn when their icon
+        //  changes, so check for a new icon here.
+        //
+
+        IconChanged = YuiTaskbarUpdateWindowIcon(ThisButton);
         YoriLibInitEmptyString(&NewTitle);
         if (YoriLibAllocateString(&NewTitle, (YORI_ALLOC_SIZE_T)GetWindowTextLength(hWnd) + 1)) {
             NewTitle.LengthInChars = (YORI_ALLOC_SIZE_T)GetWindowText(hWnd, NewTitle.StartOfString, NewTitle.LengthAllocated);
-            YoriLibFreeStringContents(&ThisButton->ButtonText);
+            memcpy(&OldTitle, &ThisButton->ButtonText, sizeof(YORI_STRING));
             memcpy(&ThisButton->ButtonText, &NewTitle, sizeof(YORI_STRING));
             YuiTaskbarMungeButtonText(ThisButton);
+
+            //
+            //  Notifications arrive for many reasons other than a title
+            //  change, so only repaint the button if its text is different.
+            //
+
+            if (YoriLibCompareString(&OldTitle, &ThisButton->ButtonText) == 0) {
+                YoriLibFreeStringContents(&ThisButton->ButtonText);
+                memcpy(&ThisButton->ButtonText, &OldTitle, sizeof(YORI_STRING));
+            } else {
+                YoriLibFreeStringContents(&OldTitle);
+                IconChanged = TRUE;
+            }
+        }
+
+        if (IconChanged) {
             RedrawWindow(ThisButton->hWndButton, NULL, NULL, RDW_ERASE | RDW_INVALIDATE);
         }
     }
@@ -1309,8 +1400,10 @@ YuiTaskbarSyncWindowCallback(
 /**
  Enumerate all current windows and update the taskbar with any changes.
  Also activates the taskbar button corresponding to the currently active
- window.  This is degenerate fallback code that executes on systems incapable
- of providing real time window notifications.
+ window.  This is degenerate fallback code that executes frequently on
+ systems incapable of providing real time window notifications.  On systems
+ with notifications, it executes rarely to correct for any notification that
+ was missed.
 
  @param YuiContext Pointer to the application context.
  */
@@ -1626,9 +1719,6 @@ YuiTaskbarDrawButton(
     )
 {
     PYUI_TASKBAR_BUTTON ThisButton;
-    HICON Icon;
-    LRESULT Result;
-    DWORD_PTR MsgResult;
 
     ThisButton = YuiTaskbarFindButtonFromCtrlId(YuiMonitor, CtrlId);
     if (ThisButton == NULL) {
@@ -1636,21 +1726,12 @@ YuiTaskbarDrawButton(
     }
 
     //
-    //  Try to get the icon for the window.  This can invoke a different
-    //  process window procedure, and we're currently in the rendering path
-    //  of the taskbar.  Set a fairly small timeout - if the remote window
-    //  procedure doesn't respond really fast, just fall back to the class
-    //  icon.
+    //  The icon is normally obtained when the window is created or
+    //  redrawn.  If this is the first paint, obtain it now.
     //
 
-    Icon = NULL;
-    Result = SendMessageTimeout(ThisButton->hWndToActivate, WM_GETICON, ICON_SMALL, 0, SMTO_ABORTIFHUNG | SMTO_BLOCK, 10, &MsgResult);
-    if (Result) {
-        Icon = (HICON)MsgResult;
-    }
-
-    if (Icon == NULL) {
-        Icon = (HICON)GetClassLongPtr(ThisButton->hWndToActivate, GCLP_HICONSM);
+    if (!ThisButton->WindowIconQueried) {
+        YuiTaskbarUpdateWindowIcon(ThisButton);
     }
 
     YuiDrawButton(YuiMonitor,
@@ -1658,7 +1739,7 @@ YuiTaskbarDrawButton(
                   ThisButton->WindowActive,
                   ThisButton->Flashing,
                   FALSE,
-                  Icon,
+                  ThisButton->WindowIcon,
                   &ThisButton->ButtonText,
                   FALSE);
 }
@@ -1662,7 +1662,8 @@ YuiInitializeApplication(
     //
     //  If the refresh frequency is specified, or the OS doesn't support
     //  notifications, or setting up notifications failed, set up polling
-    //  now.
+    //  now.  Otherwise the taskbar is maintained from notifications, and
+    //  only needs an occasional full sync in case one was missed.
     //
 
     if (Context->TaskbarRefreshFrequency != 0) {
@@ -1670,6 +1671,11 @@ YuiInitializeApplication(
                                         YUI_WINDOW_POLL_TIMER,
                                         Context->TaskbarRefreshFrequency,
                                         NULL);
+    } else {
+        Context->SyncTimerId = SetTimer(hWnd,
+                                        YUI_WINDOW_POLL_TIMER,
+                                        YUI_WINDOW_RESYNC_INTERVAL,
+                                        NULL);
     }
 
     if (Context->LoginShell) {
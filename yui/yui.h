@@ -156,6 +156,25 @@ typedef struct _YUI_TASKBAR_BUTTON {
      */
     BOOLEAN Flashing;
 
+    /**
+     TRUE if the associated window has been asked for its icon.  The icon is
+     queried again when the window indicates that it should be redrawn, but
+     not every time the button is painted.
+     */
+    BOOLEAN WindowIconQueried;
+
+    /**
+     The icon returned by the associated window.  This is owned by the
+     window and is only used to detect when the window's icon changes.
+     */
+    HICON WindowIconSource;
+
+    /**
+     A copy of the associated window's icon, owned by the taskbar button, or
+     NULL if the window has no icon.
+     */
+    HICON WindowIcon;
+
     /**
      The text to display on the taskbar button.
      */
@@ -546,8 +565,9 @@ typedef struct _YUI_CONTEXT {
     HMENU ShutdownMenu;
 
     /**
-     An identifier for a periodic timer used to refresh taskbar buttons.  This
-     is only meaningful when polling is used to sync taskbar state.
+     An identifier for a periodic timer used to refresh taskbar buttons.  When
+     polling is used to sync taskbar state this fires frequently; otherwise
+     it fires rarely to check that no notification was missed.
      */
     DWORD_PTR SyncTimerId;
 
@@ -738,6 +758,18 @@ typedef struct _YUI_MENU_SHARED_ICON {
      */
     YORI_LIST_ENTRY ListEntry;
 
+    /**
+     The entry for the icon in the hash table used to find icons in the
+     global icon cache.
+     */
+    YORI_HASH_ENTRY HashEntry;
+
+    /**
+     The key for the icon in the hash table, combining the file name, icon
+     index and size.
+     */
+    YORI_STRING HashKey;
+
     /**
      The file name containing the icon.
      */
@@ -870,6 +902,13 @@ typedef struct _YUI_MENU_OWNERDRAW_ITEM {
  */
 #define YUI_WINDOW_POLL_TIMER (1)
 
+/**
+ The interval in milliseconds between full taskbar syncs on systems that
+ support notifications.  These only exist to recover from a missed
+ notification, so they are infrequent.
+ */
+#define YUI_WINDOW_RESYNC_INTERVAL (60000)
+
 /**
  The timer identifier of the timer that updates the clock in the task bar.
  */